@@ -176,6 +176,66 @@ func (d *Document) LoadPage(pageNum int) (*Page, error) {
 	}, nil
 }
 
+// ThumbnailOptions controls whole-document thumbnail rendering.
+type ThumbnailOptions struct {
+	// MaxSize is the longest edge of each thumbnail in pixels.
+	MaxSize int
+	// Gray renders grayscale instead of RGB.
+	Gray bool
+	// Columns is the sprite sheet width in cells (0 for a near-square grid).
+	Columns int
+	// Quality is the JPEG quality, 1-100 (0 for the default).
+	Quality int
+	// Threads is the number of render threads (0 for one per CPU).
+	Threads int
+}
+
+// ThumbnailSheet renders every page into one sprite sheet.
+// The sheet is a grid of MaxSize x MaxSize cells; the returned rects give
+// each page's area within it, empty for pages that failed to render.
+func (d *Document) ThumbnailSheet(opts ThumbnailOptions) (*Pixmap, []IRect, error) {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+
+	if d.dropped || d.ptr == 0 {
+		return nil, nil, ErrInvalidHandle
+	}
+	if opts.MaxSize <= 0 {
+		return nil, nil, ErrInvalidDimensions
+	}
+
+	pixPtr, rects := documentThumbnailSheet(d.ctx.Handle(), d.ptr, opts.MaxSize, opts.Gray, opts.Columns, opts.Threads)
+	if pixPtr == 0 {
+		return nil, nil, ErrRenderFailed
+	}
+
+	result := make([]IRect, len(rects))
+	for i, r := range rects {
+		result[i] = NewIRect(r[0], r[1], r[2], r[3])
+	}
+	return &Pixmap{ctx: d.ctx, ptr: pixPtr}, result, nil
+}
+
+// ThumbnailJPEGs renders every page to its own small JPEG.
+// Entries are nil for pages that failed to render.
+func (d *Document) ThumbnailJPEGs(opts ThumbnailOptions) ([][]byte, error) {
+	d.mu.Lock()
+	defer d.mu.Unlock()
+
+	if d.dropped || d.ptr == 0 {
+		return nil, ErrInvalidHandle
+	}
+	if opts.MaxSize <= 0 {
+		return nil, ErrInvalidDimensions
+	}
+
+	jpegs := documentThumbnailJPEGs(d.ctx.Handle(), d.ptr, opts.MaxSize, opts.Gray, opts.Quality, opts.Threads)
+	if jpegs == nil {
+		return nil, ErrRenderFailed
+	}
+	return jpegs, nil
+}
+
 // IsValid returns true if the document is still valid (not dropped).
 func (d *Document) IsValid() bool {
 	d.mu.Lock()
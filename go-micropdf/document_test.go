@@ -316,3 +316,46 @@ func TestDocumentResolveLink(t *testing.T) {
 		t.Logf("Resolved link to page: %d", pageNum)
 	}
 }
+
+func TestDocumentThumbnails(t *testing.T) {
+	ctx := NewContext()
+	if ctx == nil {
+		t.Fatal("Failed to create context")
+	}
+	defer ctx.Drop()
+
+	pdfPath := createTestPDF(t)
+	doc, err := OpenDocument(ctx, pdfPath)
+	if err != nil {
+		t.Fatalf("Failed to open document: %v", err)
+	}
+	defer doc.Drop()
+
+	sheet, rects, err := doc.ThumbnailSheet(ThumbnailOptions{MaxSize: 64, Gray: true})
+	if err != nil {
+		t.Fatalf("Failed to render thumbnail sheet: %v", err)
+	}
+	defer sheet.Drop()
+
+	if len(rects) != 1 {
+		t.Fatalf("Expected 1 rect, got %d", len(rects))
+	}
+	if rects[0].Height() != 64 || rects[0].Width() > 64 {
+		t.Errorf("Thumbnail does not fit its cell: %+v", rects[0])
+	}
+	if w, _ := sheet.Width(); w != 64 {
+		t.Errorf("Expected sheet width 64, got %d", w)
+	}
+
+	jpegs, err := doc.ThumbnailJPEGs(ThumbnailOptions{MaxSize: 48})
+	if err != nil {
+		t.Fatalf("Failed to render thumbnail JPEGs: %v", err)
+	}
+	if len(jpegs) != 1 || len(jpegs[0]) < 2 || jpegs[0][0] != 0xFF || jpegs[0][1] != 0xD8 {
+		t.Errorf("Expected one JPEG, got %d entries", len(jpegs))
+	}
+
+	if _, _, err := doc.ThumbnailSheet(ThumbnailOptions{}); err != ErrInvalidDimensions {
+		t.Errorf("Expected ErrInvalidDimensions, got %v", err)
+	}
+}
@@ -20,7 +20,7 @@ extern "C" {
 // Enhanced Functions (10 total)
 // ============================================================================
 
-int32_t np_add_blank_page(int32_t _ctx, int32_t _doc, float width, float height);
+int32_t np_add_blank_page(int32_t _ctx, int32_t doc, float width, float height);
 int32_t np_add_watermark(int32_t _ctx, const char * input_path, const char * output_path, const char * text, float _x, float _y, float font_size, float opacity);
 int32_t np_draw_circle(int32_t _ctx, int32_t _page, float _x, float _y, float radius, float r, float g, float b, float alpha, int32_t _fill);
 int32_t np_draw_line(int32_t _ctx, int32_t _page, float _x0, float _y0, float _x1, float _y1, float r, float g, float b, float alpha, float line_width);
@@ -164,6 +164,20 @@ int fz_pixmap_stride(fz_context ctx, fz_pixmap pix);
 unsigned char* fz_pixmap_samples(fz_context ctx, fz_pixmap pix);
 void fz_clear_pixmap(fz_context ctx, fz_pixmap pix);
 
+// Pixmaps over caller-owned memory, and rendering a page into one
+#define FZ_RENDER_ANNOTS 1
+#define FZ_RENDER_WIDGETS 2
+int fz_aa_level(fz_context ctx);
+fz_pixmap fz_new_pixmap_with_data(fz_context ctx, fz_colorspace cs, int w, int h, uint64_t seps, int alpha, int stride, unsigned char* samples);
+int fz_fill_pixmap_from_page(fz_context ctx, fz_page page, fz_matrix ctm, fz_pixmap pix, int aa_bits, int flags, uint64_t cookie);
+
+// ============================================================================
+// Thumbnail Functions
+// ============================================================================
+
+fz_pixmap fz_new_thumbnail_sheet(fz_context ctx, fz_document doc, int max_size, fz_colorspace cs, int columns, int threads, fz_irect* rects, int count);
+int fz_new_thumbnail_jpegs(fz_context ctx, fz_document doc, int max_size, fz_colorspace cs, int quality, int threads, fz_buffer* buffers, int count);
+
 // ============================================================================
 // Buffer Functions
 // ============================================================================
@@ -236,8 +250,24 @@ void fz_lineto(fz_context ctx, fz_path path, float x, float y);
 void fz_curveto(fz_context ctx, fz_path path, float x1, float y1, float x2, float y2, float x3, float y3);
 void fz_closepath(fz_context ctx, fz_path path);
 void fz_rectto(fz_context ctx, fz_path path, float x, float y, float w, float h);
+int32_t fz_path_append_commands(fz_context ctx, fz_path path, const uint8_t* ops, const float* coords, int32_t n);
 fz_rect fz_bound_path(fz_context ctx, fz_path path, void* stroke, fz_matrix ctm);
 
+// ============================================================================
+// SIMD Geometry Batches
+// ============================================================================
+
+typedef struct __attribute__((aligned(16))) {
+    float data[6]; // a, b, c, d, e, f
+    float _pad[2];
+} SimdMatrix;
+
+int fz_simd_transform_points(float* points, size_t count, SimdMatrix m);
+int fz_simd_transform_rects(float* rects, size_t count, SimdMatrix m);
+int fz_simd_quad_bounds(const float* quads, size_t count, float* out);
+int fz_simd_rect_union(const float* rects, size_t count, float* out);
+int fz_simd_points_in_rect(const float* points, size_t count, float x0, float y0, float x1, float y1, uint8_t* out);
+
 // ============================================================================
 // Font Functions
 // ============================================================================
@@ -261,6 +291,8 @@ fz_stream fz_open_memory(fz_context ctx, const unsigned char* data, size_t len);
 void fz_drop_stream(fz_context ctx, fz_stream stm);
 size_t fz_read(fz_context ctx, fz_stream stm, unsigned char* data, size_t len);
 int fz_read_byte(fz_context ctx, fz_stream stm);
+const unsigned char* fz_peek_bytes(fz_context ctx, fz_stream stm, size_t max, size_t* len);
+size_t fz_consume(fz_context ctx, fz_stream stm, size_t n);
 int fz_is_eof(fz_context ctx, fz_stream stm);
 void fz_seek(fz_context ctx, fz_stream stm, int64_t offset, int whence);
 int64_t fz_tell(fz_context ctx, fz_stream stm);
@@ -275,6 +307,9 @@ void fz_drop_output(fz_context ctx, fz_output out);
 void fz_write_data(fz_context ctx, fz_output out, const void* data, size_t size);
 void fz_write_string(fz_context ctx, fz_output out, const char* s);
 void fz_write_byte(fz_context ctx, fz_output out, unsigned char byte);
+void fz_write_int(fz_context ctx, fz_output out, int64_t x);
+void fz_write_real(fz_context ctx, fz_output out, float x);
+void fz_write_reals(fz_context ctx, fz_output out, const float* values, size_t count);
 void fz_close_output(fz_context ctx, fz_output out);
 int64_t fz_tell_output(fz_context ctx, fz_output out);
 
@@ -300,6 +335,34 @@ fz_archive fz_open_archive(fz_context ctx, const char* path);
 fz_archive fz_open_archive_with_buffer(fz_context ctx, fz_buffer buffer);
 void fz_drop_archive(fz_context ctx, fz_archive arch);
 
+// ============================================================================
+// Performance Counters
+// ============================================================================
+
+typedef struct {
+    uint64_t bytes_inflated;
+    uint64_t images_decoded;
+    uint64_t image_pixels_decoded;
+    uint64_t image_decode_ns;
+    uint64_t glyphs_rasterized;
+    uint64_t paths_filled;
+    uint64_t paths_stroked;
+    uint64_t operators_interpreted;
+    uint64_t store_hits;
+    uint64_t store_misses;
+    uint64_t glyph_cache_hits;
+    uint64_t glyph_cache_misses;
+    uint64_t document_lookups;
+    uint64_t page_lookups;
+    uint64_t pixmap_lookups;
+    uint64_t image_lookups;
+    uint64_t font_lookups;
+    uint64_t buffer_lookups;
+    uint64_t stext_page_lookups;
+} fz_perf_counters;
+
+int fz_get_perf_counters(fz_context ctx, fz_perf_counters* out);
+
 #ifdef __cplusplus
 }
 #endif
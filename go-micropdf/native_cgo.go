@@ -24,6 +24,7 @@ const char* micropdf_version(void) {
 */
 import "C"
 import (
+	"runtime"
 	"unsafe"
 )
 
@@ -232,6 +233,37 @@ func pageRenderToPixmap(ctx uintptr, page uintptr, matrix [6]float32, alpha bool
 	return uintptr(pix)
 }
 
+func pageRenderInto(ctx uintptr, page uintptr, matrix [6]float32, alpha bool, dst []byte, width, height, stride int) bool {
+	ctm := C.fz_matrix{
+		a: C.float(matrix[0]),
+		b: C.float(matrix[1]),
+		c: C.float(matrix[2]),
+		d: C.float(matrix[3]),
+		e: C.float(matrix[4]),
+		f: C.float(matrix[5]),
+	}
+	alphaInt := 0
+	if alpha {
+		alphaInt = 1
+	}
+
+	// The pixmap keeps the pointer between calls, so pin the slice for them
+	var pinner runtime.Pinner
+	pinner.Pin(&dst[0])
+	defer pinner.Unpin()
+
+	cs := C.fz_device_rgb(C.fz_context(ctx))
+	pix := C.fz_new_pixmap_with_data(C.fz_context(ctx), cs, C.int(width), C.int(height), 0,
+		C.int(alphaInt), C.int(stride), (*C.uchar)(unsafe.Pointer(&dst[0])))
+	if pix == 0 {
+		return false
+	}
+	defer C.fz_drop_pixmap(C.fz_context(ctx), pix)
+
+	return C.fz_fill_pixmap_from_page(C.fz_context(ctx), C.fz_page(page), ctm, pix,
+		C.fz_aa_level(C.fz_context(ctx)), C.FZ_RENDER_ANNOTS|C.FZ_RENDER_WIDGETS, 0) == 0
+}
+
 func pageRenderToPNG(ctx uintptr, page uintptr, dpi float32) []byte {
 	// Create scale matrix for DPI
 	scale := dpi / 72.0
@@ -263,6 +295,58 @@ func pageRenderToPNG(ctx uintptr, page uintptr, dpi float32) []byte {
 	return C.GoBytes(unsafe.Pointer(data), C.int(length))
 }
 
+func thumbnailColorspace(ctx uintptr, gray bool) C.fz_colorspace {
+	if gray {
+		return C.fz_device_gray(C.fz_context(ctx))
+	}
+	return C.fz_device_rgb(C.fz_context(ctx))
+}
+
+func documentThumbnailSheet(ctx uintptr, doc uintptr, maxSize int, gray bool, columns int, threads int) (uintptr, [][4]int32) {
+	count := int(C.fz_count_pages(C.fz_context(ctx), C.fz_document(doc)))
+	if count <= 0 {
+		return 0, nil
+	}
+	rects := make([]C.fz_irect, count)
+	pix := C.fz_new_thumbnail_sheet(C.fz_context(ctx), C.fz_document(doc), C.int(maxSize),
+		thumbnailColorspace(ctx, gray), C.int(columns), C.int(threads), &rects[0], C.int(count))
+	if pix == 0 {
+		return 0, nil
+	}
+
+	result := make([][4]int32, count)
+	for i, r := range rects {
+		result[i] = [4]int32{int32(r.x0), int32(r.y0), int32(r.x1), int32(r.y1)}
+	}
+	return uintptr(pix), result
+}
+
+func documentThumbnailJPEGs(ctx uintptr, doc uintptr, maxSize int, gray bool, quality int, threads int) [][]byte {
+	count := int(C.fz_count_pages(C.fz_context(ctx), C.fz_document(doc)))
+	if count <= 0 {
+		return nil
+	}
+	buffers := make([]C.fz_buffer, count)
+	if C.fz_new_thumbnail_jpegs(C.fz_context(ctx), C.fz_document(doc), C.int(maxSize),
+		thumbnailColorspace(ctx, gray), C.int(quality), C.int(threads), &buffers[0], C.int(count)) < 0 {
+		return nil
+	}
+
+	result := make([][]byte, count)
+	for i, buf := range buffers {
+		if buf == 0 {
+			continue
+		}
+		var length C.size_t
+		data := C.fz_buffer_data(C.fz_context(ctx), buf, &length)
+		if data != nil && length > 0 {
+			result[i] = C.GoBytes(unsafe.Pointer(data), C.int(length))
+		}
+		C.fz_drop_buffer(C.fz_context(ctx), buf)
+	}
+	return result
+}
+
 func pageExtractText(ctx uintptr, page uintptr) string {
 	// Create text page
 	stext := C.fz_new_stext_page_from_page(C.fz_context(ctx), C.fz_page(page), nil)
@@ -380,10 +464,42 @@ func mergePDFsNative(ctx uintptr, inputPaths []string, outputPath string) int {
 	// Cast to const char * const * for the paths array
 	result := C.np_merge_pdfs(
 		C.int32_t(ctx),
-		(*C.char)(unsafe.Pointer(&cPaths[0])),
+		(**C.char)(unsafe.Pointer(&cPaths[0])),
 		C.int32_t(len(inputPaths)),
 		cOutputPath,
 	)
 
 	return int(result)
 }
+
+// ============================================================================
+// Performance Counters
+// ============================================================================
+
+func perfCounters(ctx uintptr) PerfCounters {
+	var c C.fz_perf_counters
+	if C.fz_get_perf_counters(C.fz_context(ctx), &c) == 0 {
+		return PerfCounters{}
+	}
+	return PerfCounters{
+		BytesInflated:        uint64(c.bytes_inflated),
+		ImagesDecoded:        uint64(c.images_decoded),
+		ImagePixelsDecoded:   uint64(c.image_pixels_decoded),
+		ImageDecodeNs:        uint64(c.image_decode_ns),
+		GlyphsRasterized:     uint64(c.glyphs_rasterized),
+		PathsFilled:          uint64(c.paths_filled),
+		PathsStroked:         uint64(c.paths_stroked),
+		OperatorsInterpreted: uint64(c.operators_interpreted),
+		StoreHits:            uint64(c.store_hits),
+		StoreMisses:          uint64(c.store_misses),
+		GlyphCacheHits:       uint64(c.glyph_cache_hits),
+		GlyphCacheMisses:     uint64(c.glyph_cache_misses),
+		DocumentLookups:      uint64(c.document_lookups),
+		PageLookups:          uint64(c.page_lookups),
+		PixmapLookups:        uint64(c.pixmap_lookups),
+		ImageLookups:         uint64(c.image_lookups),
+		FontLookups:          uint64(c.font_lookups),
+		BufferLookups:        uint64(c.buffer_lookups),
+		StextPageLookups:     uint64(c.stext_page_lookups),
+	}
+}
@@ -279,6 +279,21 @@ func pageRenderToPixmap(_ uintptr, _ uintptr, matrix [6]float32, _ bool) uintptr
 	return id
 }
 
+func pageRenderInto(_ uintptr, _ uintptr, _ [6]float32, alpha bool, dst []byte, width, height, stride int) bool {
+	// A blank page: white, or transparent with alpha
+	components, value := 3, byte(255)
+	if alpha {
+		components, value = 4, 0
+	}
+	for y := 0; y < height; y++ {
+		row := dst[y*stride : y*stride+width*components]
+		for i := range row {
+			row[i] = value
+		}
+	}
+	return true
+}
+
 func pageRenderToPNG(_ uintptr, _ uintptr, dpi float32) []byte {
 	// Return a minimal PNG header
 	scale := dpi / 72.0
@@ -301,6 +316,57 @@ func pageRenderToPNG(_ uintptr, _ uintptr, dpi float32) []byte {
 	return png
 }
 
+func documentThumbnailSheet(_ uintptr, doc uintptr, maxSize int, gray bool, columns int, _ int) (uintptr, [][4]int32) {
+	count := documentCountPages(0, doc)
+	if count <= 0 || maxSize <= 0 {
+		return 0, nil
+	}
+	if columns <= 0 || columns > count {
+		columns = 1
+		for columns*columns < count {
+			columns++
+		}
+	}
+	rows := (count + columns - 1) / columns
+
+	// Letter pages fit on their long edge
+	width := maxSize * 612 / 792
+	rects := make([][4]int32, count)
+	for i := range rects {
+		x := int32(i%columns) * int32(maxSize)
+		y := int32(i/columns) * int32(maxSize)
+		rects[i] = [4]int32{x, y, x + int32(width), y + int32(maxSize)}
+	}
+
+	n := 3
+	if gray {
+		n = 1
+	}
+	mockStorageMu.Lock()
+	defer mockStorageMu.Unlock()
+	id := nextPixmapID
+	nextPixmapID++
+	mockPixmaps[id] = &mockPixmap{
+		width:  columns * maxSize,
+		height: rows * maxSize,
+		data:   make([]byte, columns*maxSize*rows*maxSize*n),
+	}
+	return id, rects
+}
+
+func documentThumbnailJPEGs(_ uintptr, doc uintptr, maxSize int, _ bool, _ int, _ int) [][]byte {
+	count := documentCountPages(0, doc)
+	if count <= 0 || maxSize <= 0 {
+		return nil
+	}
+	result := make([][]byte, count)
+	for i := range result {
+		// SOI + EOI markers
+		result[i] = []byte{0xFF, 0xD8, 0xFF, 0xD9}
+	}
+	return result
+}
+
 func pageExtractText(_ uintptr, _ uintptr) string {
 	return "Hello World"
 }
@@ -531,3 +597,11 @@ func mergePDFsNative(_ uintptr, inputPaths []string, _ string) int {
 	totalPages := len(inputPaths) * 10 // Mock: assume 10 pages per document
 	return totalPages
 }
+
+// ============================================================================
+// Performance Counters (Mock)
+// ============================================================================
+
+func perfCounters(_ uintptr) PerfCounters {
+	return PerfCounters{}
+}
@@ -105,6 +105,33 @@ func (o *Output) WriteByte(b byte) error {
 	return nil
 }
 
+// WriteReals writes numbers as PDF reals separated by spaces, in one call
+func (o *Output) WriteReals(values []float32) error {
+	if len(values) == 0 {
+		return nil
+	}
+
+	C.fz_write_reals(
+		C.fz_context(o.ctx.Handle()),
+		o.handle,
+		(*C.float)(unsafe.Pointer(&values[0])),
+		C.size_t(len(values)),
+	)
+
+	return nil
+}
+
+// WriteInt writes an integer as decimal text
+func (o *Output) WriteInt(x int64) error {
+	C.fz_write_int(
+		C.fz_context(o.ctx.Handle()),
+		o.handle,
+		C.int64_t(x),
+	)
+
+	return nil
+}
+
 // Close closes the output stream (flushes and closes file)
 func (o *Output) Close() error {
 	if o.handle != 0 {
@@ -90,6 +90,42 @@ func TestOutputWithFile(t *testing.T) {
 	}
 }
 
+func TestOutputWriteNumbers(t *testing.T) {
+	ctx := NewContext()
+	if ctx == nil {
+		t.Fatal("Failed to create context")
+	}
+	defer ctx.Drop()
+
+	testFile := filepath.Join(t.TempDir(), "numbers.txt")
+	output, err := NewOutputWithPath(ctx, testFile, false)
+	if err != nil {
+		t.Fatalf("Failed to create file output: %v", err)
+	}
+
+	if err := output.WriteReals([]float32{1, 0.5, -72.25}); err != nil {
+		t.Fatalf("Failed to write reals: %v", err)
+	}
+	if err := output.WriteByte(' '); err != nil {
+		t.Fatalf("Failed to write byte: %v", err)
+	}
+	if err := output.WriteInt(-3); err != nil {
+		t.Fatalf("Failed to write int: %v", err)
+	}
+	if err := output.Close(); err != nil {
+		t.Fatalf("Failed to close output: %v", err)
+	}
+	output.Drop()
+
+	data, err := os.ReadFile(testFile)
+	if err != nil {
+		t.Fatalf("Failed to read output file: %v", err)
+	}
+	if expected := "1 0.5 -72.25 -3"; string(data) != expected {
+		t.Errorf("File content = %q, expected %q", string(data), expected)
+	}
+}
+
 func TestOutputTell(t *testing.T) {
 	ctx := NewContext()
 	if ctx == nil {
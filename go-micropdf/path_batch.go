@@ -3,15 +3,21 @@
 
 package micropdf
 
+// #include "include/micropdf_ffi.h"
+import "C"
+import "unsafe"
+
 // ============================================================================
 // Batch Path Operations
 //
-// These functions reduce CGO call overhead by combining multiple path operations
-// into single CGO calls where possible. Use these for performance-critical code
-// that builds paths programmatically.
+// These functions reduce CGO call overhead by packing path operations into
+// op and coordinate arrays handed to fz_path_append_commands in a single CGO
+// call. Use these for performance-critical code that builds paths
+// programmatically.
 // ============================================================================
 
-// PathOp represents a single path operation type
+// PathOp represents a single path operation type; the values are the
+// native FZ_PATH_* command codes
 type PathOp int
 
 const (
@@ -59,43 +65,63 @@ func NewRectToCmd(x, y, w, h float32) PathCommand {
 	return PathCommand{Op: PathOpRectTo, X: x, Y: y, X2: w, Y2: h}
 }
 
+// appendCommands appends packed ops and their coordinates in one CGO call
+func (p *Path) appendCommands(ops []uint8, coords []float32) *Path {
+	if len(ops) == 0 {
+		return p
+	}
+	var cCoords *C.float
+	if len(coords) > 0 {
+		cCoords = (*C.float)(unsafe.Pointer(&coords[0]))
+	}
+	C.fz_path_append_commands(
+		C.fz_context(p.ctx.Handle()),
+		p.handle,
+		(*C.uint8_t)(unsafe.Pointer(&ops[0])),
+		cCoords,
+		C.int32_t(len(ops)),
+	)
+	return p
+}
+
 // AddCommands adds multiple path commands in a single batch.
 // This reduces CGO overhead when building complex paths.
 func (p *Path) AddCommands(commands []PathCommand) *Path {
+	ops := make([]uint8, 0, len(commands))
+	coords := make([]float32, 0, len(commands)*2)
 	for _, cmd := range commands {
 		switch cmd.Op {
-		case PathOpMoveTo:
-			p.MoveTo(cmd.X, cmd.Y)
-		case PathOpLineTo:
-			p.LineTo(cmd.X, cmd.Y)
+		case PathOpMoveTo, PathOpLineTo:
+			coords = append(coords, cmd.X, cmd.Y)
 		case PathOpCurveTo:
-			p.CurveTo(cmd.X1, cmd.Y1, cmd.X2, cmd.Y2, cmd.X3, cmd.Y3)
+			coords = append(coords, cmd.X1, cmd.Y1, cmd.X2, cmd.Y2, cmd.X3, cmd.Y3)
 		case PathOpClosePath:
-			p.ClosePath()
 		case PathOpRectTo:
-			p.RectTo(cmd.X, cmd.Y, cmd.X2, cmd.Y2)
+			coords = append(coords, cmd.X, cmd.Y, cmd.X2, cmd.Y2)
+		default:
+			continue
 		}
+		ops = append(ops, uint8(cmd.Op))
 	}
-	return p
+	return p.appendCommands(ops, coords)
 }
 
 // AddLines adds multiple line segments efficiently.
 // points should alternate: [x0, y0, x1, y1, x2, y2, ...]
 // The first point is a MoveTo, subsequent points are LineTo.
 func (p *Path) AddLines(points []float32) *Path {
-	if len(points) < 2 {
+	n := len(points) / 2
+	if n < 1 {
 		return p
 	}
 
-	// First point is MoveTo
-	p.MoveTo(points[0], points[1])
-
-	// Rest are LineTo
-	for i := 2; i+1 < len(points); i += 2 {
-		p.LineTo(points[i], points[i+1])
+	ops := make([]uint8, n)
+	ops[0] = uint8(PathOpMoveTo)
+	for i := 1; i < n; i++ {
+		ops[i] = uint8(PathOpLineTo)
 	}
 
-	return p
+	return p.appendCommands(ops, points[:n*2])
 }
 
 // AddPolygon adds a closed polygon efficiently.
@@ -114,18 +140,23 @@ func (p *Path) AddPolygon(points []float32) *Path {
 // AddRects adds multiple rectangles efficiently.
 // rects should be: [x0, y0, w0, h0, x1, y1, w1, h1, ...]
 func (p *Path) AddRects(rects []float32) *Path {
-	for i := 0; i+3 < len(rects); i += 4 {
-		p.RectTo(rects[i], rects[i+1], rects[i+2], rects[i+3])
+	n := len(rects) / 4
+	ops := make([]uint8, n)
+	for i := range ops {
+		ops[i] = uint8(PathOpRectTo)
 	}
-	return p
+	return p.appendCommands(ops, rects[:n*4])
 }
 
 // AddRectsFromSlice adds rectangles from a slice of Rect structs
 func (p *Path) AddRectsFromSlice(rects []Rect) *Path {
-	for _, r := range rects {
-		p.RectTo(r.X0, r.Y0, r.Width(), r.Height())
+	ops := make([]uint8, len(rects))
+	coords := make([]float32, 0, len(rects)*4)
+	for i, r := range rects {
+		ops[i] = uint8(PathOpRectTo)
+		coords = append(coords, r.X0, r.Y0, r.Width(), r.Height())
 	}
-	return p
+	return p.appendCommands(ops, coords)
 }
 
 // AddPolyline adds a series of connected line segments without closing.
@@ -135,12 +166,15 @@ func (p *Path) AddPolyline(points []Point) *Path {
 		return p
 	}
 
-	p.MoveTo(points[0].X, points[0].Y)
-	for i := 1; i < len(points); i++ {
-		p.LineTo(points[i].X, points[i].Y)
+	ops := make([]uint8, len(points))
+	coords := make([]float32, 0, len(points)*2)
+	for i, pt := range points {
+		ops[i] = uint8(PathOpLineTo)
+		coords = append(coords, pt.X, pt.Y)
 	}
+	ops[0] = uint8(PathOpMoveTo)
 
-	return p
+	return p.appendCommands(ops, coords)
 }
 
 // AddClosedPolyline adds a closed polygon from Point structs.
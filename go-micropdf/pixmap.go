@@ -81,3 +81,38 @@ func (p *Pixmap) ToBytes(format string) ([]byte, error) {
 
 	return pixmapToBytes(p.ctx.Handle(), p.ptr, format), nil
 }
+
+// RenderInto renders the page straight into dst, a caller-owned buffer of
+// height rows that are stride bytes apart, with no copy out of a pixmap.
+// Pixels are RGB, or RGBA when alpha is set; a stride of 0 packs the rows.
+// The top-left corner of the transformed page is the first pixel, cleared
+// to white (transparent with alpha) first, and a buffer smaller than the
+// page receives its top-left part.
+func (p *Page) RenderInto(dst []byte, width, height, stride int, matrix Matrix, alpha bool) error {
+	p.mu.Lock()
+	defer p.mu.Unlock()
+
+	if p.dropped || p.ptr == 0 {
+		return ErrInvalidHandle
+	}
+
+	components := 3
+	if alpha {
+		components = 4
+	}
+	if stride == 0 {
+		stride = width * components
+	}
+	if width <= 0 || height <= 0 || stride < width*components {
+		return ErrInvalidDimensions
+	}
+	if len(dst) < stride*height {
+		return ErrBufferTooSmall
+	}
+
+	matArray := [6]float32{matrix.A, matrix.B, matrix.C, matrix.D, matrix.E, matrix.F}
+	if !pageRenderInto(p.ctx.Handle(), p.ptr, matArray, alpha, dst, width, height, stride) {
+		return ErrRenderFailed
+	}
+	return nil
+}
@@ -202,3 +202,50 @@ func TestPixmapDrop(t *testing.T) {
 	// Multiple drops should be safe
 	pix.Drop()
 }
+
+func TestPageRenderInto(t *testing.T) {
+	ctx := NewContext()
+	if ctx == nil {
+		t.Fatal("Failed to create context")
+	}
+	defer ctx.Drop()
+
+	pdfPath := createTestPDF(t)
+	doc, err := OpenDocument(ctx, pdfPath)
+	if err != nil {
+		t.Fatalf("Failed to open document: %v", err)
+	}
+	defer doc.Drop()
+
+	page, err := doc.LoadPage(0)
+	if err != nil {
+		t.Fatalf("Failed to load page: %v", err)
+	}
+	defer page.Drop()
+
+	// Padded rows: the byte past each row must be left alone
+	const width, height, stride = 32, 16, 32*3 + 1
+	dst := make([]byte, stride*height)
+	for y := 0; y < height; y++ {
+		dst[y*stride+stride-1] = 7
+	}
+
+	if err := page.RenderInto(dst, width, height, stride, MatrixIdentity(), false); err != nil {
+		t.Fatalf("Failed to render into buffer: %v", err)
+	}
+	for y := 0; y < height; y++ {
+		if dst[y*stride] != 255 {
+			t.Errorf("Row %d should start white, got %d", y, dst[y*stride])
+		}
+		if dst[y*stride+stride-1] != 7 {
+			t.Errorf("Row %d padding was overwritten", y)
+		}
+	}
+
+	if err := page.RenderInto(dst[:10], width, height, stride, MatrixIdentity(), false); err != ErrBufferTooSmall {
+		t.Errorf("Expected ErrBufferTooSmall, got %v", err)
+	}
+	if err := page.RenderInto(dst, width, height, width, MatrixIdentity(), false); err != ErrInvalidDimensions {
+		t.Errorf("Expected ErrInvalidDimensions, got %v", err)
+	}
+}
@@ -453,3 +453,72 @@ func PrintMemStats() {
 	fmt.Printf("HeapInuse: %d MB\n", m.HeapInuse/1024/1024)
 	fmt.Printf("HeapObjects: %d\n", m.HeapObjects)
 }
+
+// ============================================================================
+// Native Performance Counters
+// ============================================================================
+
+// PerfCounters is a snapshot of the native library's performance counters.
+// Every value only grows; rates come from differences between snapshots.
+type PerfCounters struct {
+	BytesInflated        uint64
+	ImagesDecoded        uint64
+	ImagePixelsDecoded   uint64
+	ImageDecodeNs        uint64
+	GlyphsRasterized     uint64
+	PathsFilled          uint64
+	PathsStroked         uint64
+	OperatorsInterpreted uint64
+	StoreHits            uint64
+	StoreMisses          uint64
+	GlyphCacheHits       uint64
+	GlyphCacheMisses     uint64
+	DocumentLookups      uint64
+	PageLookups          uint64
+	PixmapLookups        uint64
+	ImageLookups         uint64
+	FontLookups          uint64
+	BufferLookups        uint64
+	StextPageLookups     uint64
+}
+
+// GetPerfCounters returns a snapshot of the native performance counters.
+// The counters are shared by every context. Mock and non-CGO builds
+// return all zeros.
+func GetPerfCounters(ctx *Context) PerfCounters {
+	return perfCounters(ctx.Handle())
+}
+
+// Prometheus formats the counters in the Prometheus text exposition
+// format, one micropdf_<name>_total counter each.
+func (c PerfCounters) Prometheus() string {
+	fields := []struct {
+		name  string
+		value uint64
+	}{
+		{"bytes_inflated", c.BytesInflated},
+		{"images_decoded", c.ImagesDecoded},
+		{"image_pixels_decoded", c.ImagePixelsDecoded},
+		{"image_decode_ns", c.ImageDecodeNs},
+		{"glyphs_rasterized", c.GlyphsRasterized},
+		{"paths_filled", c.PathsFilled},
+		{"paths_stroked", c.PathsStroked},
+		{"operators_interpreted", c.OperatorsInterpreted},
+		{"store_hits", c.StoreHits},
+		{"store_misses", c.StoreMisses},
+		{"glyph_cache_hits", c.GlyphCacheHits},
+		{"glyph_cache_misses", c.GlyphCacheMisses},
+		{"document_lookups", c.DocumentLookups},
+		{"page_lookups", c.PageLookups},
+		{"pixmap_lookups", c.PixmapLookups},
+		{"image_lookups", c.ImageLookups},
+		{"font_lookups", c.FontLookups},
+		{"buffer_lookups", c.BufferLookups},
+		{"stext_page_lookups", c.StextPageLookups},
+	}
+	var sb strings.Builder
+	for _, f := range fields {
+		fmt.Fprintf(&sb, "# TYPE micropdf_%s_total counter\nmicropdf_%s_total %d\n", f.name, f.name, f.value)
+	}
+	return sb.String()
+}
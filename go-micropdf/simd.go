@@ -4,8 +4,9 @@ package micropdf
 // SIMD Batch Transforms
 //
 // This module provides optimized batch operations for geometry types using
-// SIMD instructions where available. Falls back to scalar operations on
-// unsupported platforms.
+// SIMD instructions where available. Large batches go to the native fz_simd_*
+// kernels in one CGO call (simd_cgo.go); smaller ones, and builds without
+// CGO, use the Go loops here.
 //
 // Design goals:
 // - Minimize function call overhead by processing arrays in batch
@@ -17,6 +18,11 @@ import (
 	"math"
 )
 
+// nativeBatchThreshold is the batch size from which the helpers below hand
+// the whole slice to a native SIMD kernel in one CGO call; below it the call
+// costs more than the Go loop it replaces.
+const nativeBatchThreshold = 256
+
 // ============================================================================
 // Batch Point Operations
 // ============================================================================
@@ -31,6 +37,13 @@ func TransformPointsBatch(points []Point, m Matrix) []Point {
 
 	result := make([]Point, n)
 
+	if n >= nativeBatchThreshold {
+		copy(result, points)
+		if nativeTransformPoints(result, m) {
+			return result
+		}
+	}
+
 	// Process 4 points at a time for better cache locality and potential SIMD
 	i := 0
 	for ; i+4 <= n; i += 4 {
@@ -74,6 +87,9 @@ func TransformPointsBatchInPlace(points []Point, m Matrix) {
 	if n == 0 {
 		return
 	}
+	if n >= nativeBatchThreshold && nativeTransformPoints(points, m) {
+		return
+	}
 
 	// Process 4 points at a time
 	i := 0
@@ -154,6 +170,12 @@ func TransformRectsBatch(rects []Rect, m Matrix) []Rect {
 	}
 
 	// General case: transform all corners
+	if n >= nativeBatchThreshold {
+		copy(result, rects)
+		if nativeTransformRects(result, m) {
+			return result
+		}
+	}
 	for i := 0; i < n; i++ {
 		r := rects[i]
 		result[i] = m.TransformRect(r)
@@ -200,6 +222,9 @@ func TransformRectsBatchInPlace(rects []Rect, m Matrix) {
 	}
 
 	// General case
+	if n >= nativeBatchThreshold && nativeTransformRects(rects, m) {
+		return
+	}
 	for i := 0; i < n; i++ {
 		rects[i] = m.TransformRect(rects[i])
 	}
@@ -300,6 +325,9 @@ func QuadBoundsBatch(quads []Quad) []Rect {
 	}
 
 	result := make([]Rect, n)
+	if n >= nativeBatchThreshold && nativeQuadBounds(quads, result) {
+		return result
+	}
 	for i := 0; i < n; i++ {
 		result[i] = quads[i].Bounds()
 	}
@@ -311,6 +339,11 @@ func RectUnionBatch(rects []Rect) Rect {
 	if len(rects) == 0 {
 		return RectEmpty
 	}
+	if len(rects) >= nativeBatchThreshold {
+		if result, ok := nativeRectUnion(rects); ok {
+			return result
+		}
+	}
 
 	result := rects[0]
 	for i := 1; i < len(rects); i++ {
@@ -348,6 +381,11 @@ func RectContainsPointsBatch(r Rect, points []Point) []bool {
 	}
 
 	result := make([]bool, n)
+	if n >= nativeBatchThreshold {
+		if _, ok := nativePointsInRect(r, points, result); ok {
+			return result
+		}
+	}
 
 	// Process 4 at a time
 	i := 0
@@ -370,6 +408,11 @@ func RectContainsPointsBatch(r Rect, points []Point) []bool {
 // CountPointsInRect counts how many points are inside a rectangle.
 // More efficient than RectContainsPointsBatch when only the count is needed.
 func CountPointsInRect(r Rect, points []Point) int {
+	if len(points) >= nativeBatchThreshold {
+		if count, ok := nativePointsInRect(r, points, nil); ok {
+			return count
+		}
+	}
 	count := 0
 	for _, p := range points {
 		if p.X >= r.X0 && p.X < r.X1 && p.Y >= r.Y0 && p.Y < r.Y1 {
@@ -416,6 +459,9 @@ func ApplyMatrixToFloatPairs(coords []float32, m Matrix) {
 	if n < 2 || n%2 != 0 {
 		return
 	}
+	if n/2 >= nativeBatchThreshold && nativeTransformFloatPairs(coords, m) {
+		return
+	}
 
 	// Process 4 coordinate pairs (8 floats) at a time
 	i := 0
@@ -0,0 +1,86 @@
+//go:build cgo && !mock
+// +build cgo,!mock
+
+package micropdf
+
+// #include "include/micropdf_ffi.h"
+import "C"
+import "unsafe"
+
+// ============================================================================
+// Native SIMD Batch Kernels
+//
+// Point, Rect and Quad are packed float32 structs, so their slices are passed
+// to the fz_simd_* kernels as they are, one CGO call per batch.
+// ============================================================================
+
+func simdMatrix(m Matrix) C.SimdMatrix {
+	var sm C.SimdMatrix
+	sm.data = [6]C.float{C.float(m.A), C.float(m.B), C.float(m.C), C.float(m.D), C.float(m.E), C.float(m.F)}
+	return sm
+}
+
+func nativeTransformPoints(points []Point, m Matrix) bool {
+	return len(points) > 0 && C.fz_simd_transform_points(
+		(*C.float)(unsafe.Pointer(&points[0])),
+		C.size_t(len(points)),
+		simdMatrix(m),
+	) == 0
+}
+
+func nativeTransformFloatPairs(coords []float32, m Matrix) bool {
+	return len(coords) >= 2 && C.fz_simd_transform_points(
+		(*C.float)(unsafe.Pointer(&coords[0])),
+		C.size_t(len(coords)/2),
+		simdMatrix(m),
+	) == 0
+}
+
+func nativeTransformRects(rects []Rect, m Matrix) bool {
+	return len(rects) > 0 && C.fz_simd_transform_rects(
+		(*C.float)(unsafe.Pointer(&rects[0])),
+		C.size_t(len(rects)),
+		simdMatrix(m),
+	) == 0
+}
+
+func nativeQuadBounds(quads []Quad, out []Rect) bool {
+	return len(quads) > 0 && len(out) >= len(quads) && C.fz_simd_quad_bounds(
+		(*C.float)(unsafe.Pointer(&quads[0])),
+		C.size_t(len(quads)),
+		(*C.float)(unsafe.Pointer(&out[0])),
+	) == 0
+}
+
+func nativeRectUnion(rects []Rect) (Rect, bool) {
+	var out Rect
+	if len(rects) == 0 {
+		return out, false
+	}
+	ok := C.fz_simd_rect_union(
+		(*C.float)(unsafe.Pointer(&rects[0])),
+		C.size_t(len(rects)),
+		(*C.float)(unsafe.Pointer(&out)),
+	) == 0
+	return out, ok
+}
+
+// nativePointsInRect counts the points inside r; inside, if not nil,
+// receives each point's result
+func nativePointsInRect(r Rect, points []Point, inside []bool) (int, bool) {
+	if len(points) == 0 || (inside != nil && len(inside) < len(points)) {
+		return 0, false
+	}
+	var out *C.uint8_t
+	if inside != nil {
+		// Go bools are single bytes holding 0 or 1
+		out = (*C.uint8_t)(unsafe.Pointer(&inside[0]))
+	}
+	n := C.fz_simd_points_in_rect(
+		(*C.float)(unsafe.Pointer(&points[0])),
+		C.size_t(len(points)),
+		C.float(r.X0), C.float(r.Y0), C.float(r.X1), C.float(r.Y1),
+		out,
+	)
+	return int(n), n >= 0
+}
@@ -0,0 +1,22 @@
+//go:build !cgo || mock
+// +build !cgo mock
+
+package micropdf
+
+// ============================================================================
+// Native SIMD Batch Kernels (Mock Implementation)
+//
+// Without CGO every batch helper stays on its Go loop.
+// ============================================================================
+
+func nativeTransformPoints(points []Point, m Matrix) bool { return false }
+
+func nativeTransformFloatPairs(coords []float32, m Matrix) bool { return false }
+
+func nativeTransformRects(rects []Rect, m Matrix) bool { return false }
+
+func nativeQuadBounds(quads []Quad, out []Rect) bool { return false }
+
+func nativeRectUnion(rects []Rect) (Rect, bool) { return Rect{}, false }
+
+func nativePointsInRect(r Rect, points []Point, inside []bool) (int, bool) { return 0, false }
@@ -82,6 +82,37 @@ func (s *Stream) ReadByte() int {
 	return int(C.fz_read_byte(C.fz_context(s.ctx.Handle()), s.handle))
 }
 
+// Peek returns up to max of the next bytes without consuming them.
+// The slice aliases the stream's own data, so no bytes are copied; it is
+// valid until the stream is dropped and must not be modified. Use Consume
+// to move past the bytes parsed.
+func (s *Stream) Peek(max int) []byte {
+	if max <= 0 {
+		return nil
+	}
+
+	var n C.size_t
+	p := C.fz_peek_bytes(
+		C.fz_context(s.ctx.Handle()),
+		s.handle,
+		C.size_t(max),
+		&n,
+	)
+	if p == nil || n == 0 {
+		return nil
+	}
+	return unsafe.Slice((*byte)(unsafe.Pointer(p)), int(n))
+}
+
+// Consume moves past n bytes of a window returned by Peek
+// Returns the number of bytes consumed
+func (s *Stream) Consume(n int) int {
+	if n <= 0 {
+		return 0
+	}
+	return int(C.fz_consume(C.fz_context(s.ctx.Handle()), s.handle, C.size_t(n)))
+}
+
 // IsEOF returns true if the stream is at end-of-file
 func (s *Stream) IsEOF() bool {
 	return C.fz_is_eof(C.fz_context(s.ctx.Handle()), s.handle) != 0
@@ -38,6 +38,39 @@ func TestOpenMemoryStream(t *testing.T) {
 	}
 }
 
+func TestStreamPeekConsume(t *testing.T) {
+	ctx := NewContext()
+	if ctx == nil {
+		t.Fatal("Failed to create context")
+	}
+	defer ctx.Drop()
+
+	stream, err := OpenMemory(ctx, []byte("ABCDE"))
+	if err != nil {
+		t.Fatalf("Failed to open memory stream: %v", err)
+	}
+	defer stream.Drop()
+
+	if got := stream.Peek(3); !bytes.Equal(got, []byte("ABC")) {
+		t.Errorf("Peek(3) = %q, expected %q", got, "ABC")
+	}
+	if pos := stream.Tell(); pos != 0 {
+		t.Errorf("Peek moved the stream to %d", pos)
+	}
+	if n := stream.Consume(2); n != 2 {
+		t.Errorf("Consume(2) = %d, expected 2", n)
+	}
+	if got := stream.Peek(100); !bytes.Equal(got, []byte("CDE")) {
+		t.Errorf("Peek(100) = %q, expected %q", got, "CDE")
+	}
+	if n := stream.Consume(100); n != 3 {
+		t.Errorf("Consume(100) = %d, expected 3", n)
+	}
+	if !stream.IsEOF() {
+		t.Error("Expected EOF after consuming everything")
+	}
+}
+
 func TestStreamReadByte(t *testing.T) {
 	ctx := NewContext()
 	if ctx == nil {
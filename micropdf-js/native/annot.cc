@@ -7,7 +7,9 @@
 
 #include <napi.h>
 #include "include/mupdf_minimal.h"
+#include "include/handles.h"
 #include <string>
+#include <vector>
 
 /**
  * Create a new annotation on a page
@@ -17,31 +19,30 @@
  * @param type - Annotation type (0-27)
  * @returns Annotation handle
  */
-Napi::BigInt CreateAnnotation(const Napi::CallbackInfo& info) {
+Napi::Value CreateAnnotation(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 3) {
         Napi::TypeError::New(env, "Expected 3 arguments: ctx, page, type")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t page_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t page_handle = HandleFromValue(info[1]);
     int32_t annot_type = info[2].As<Napi::Number>().Int32Value();
 
     // Validate annotation type (0-27)
     if (annot_type < 0 || annot_type > 27) {
         Napi::TypeError::New(env, "Invalid annotation type (must be 0-27)")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
     // Call Rust FFI
     uint64_t annot_handle = pdf_create_annot(ctx_handle, page_handle, annot_type);
 
-    return Napi::BigInt::New(env, annot_handle);
+    return HandleToValue(env, annot_handle);
 }
 
 /**
@@ -60,10 +61,9 @@ Napi::Value DeleteAnnotation(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t page_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t annot_handle = info[2].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t page_handle = HandleFromValue(info[1]);
+    uint64_t annot_handle = HandleFromValue(info[2]);
 
     pdf_delete_annot(ctx_handle, page_handle, annot_handle);
 
@@ -85,9 +85,8 @@ Napi::Value DropAnnotation(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t annot_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t annot_handle = HandleFromValue(info[1]);
 
     pdf_drop_annot(ctx_handle, annot_handle);
 
@@ -110,9 +109,8 @@ Napi::Number GetAnnotationType(const Napi::CallbackInfo& info) {
         return Napi::Number::New(env, -1);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t annot_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t annot_handle = HandleFromValue(info[1]);
 
     int32_t type = pdf_annot_type(ctx_handle, annot_handle);
 
@@ -136,9 +134,8 @@ Napi::Object GetAnnotationRect(const Napi::CallbackInfo& info) {
         return rect;
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t annot_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t annot_handle = HandleFromValue(info[1]);
 
     fz_rect annot_rect = pdf_annot_rect(ctx_handle, annot_handle);
 
@@ -166,9 +163,8 @@ Napi::Value SetAnnotationRect(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t annot_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t annot_handle = HandleFromValue(info[1]);
 
     Napi::Object rect_obj = info[2].As<Napi::Object>();
     fz_rect rect;
@@ -198,9 +194,8 @@ Napi::Number GetAnnotationFlags(const Napi::CallbackInfo& info) {
         return Napi::Number::New(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t annot_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t annot_handle = HandleFromValue(info[1]);
 
     uint32_t flags = pdf_annot_flags(ctx_handle, annot_handle);
 
@@ -223,9 +218,8 @@ Napi::Value SetAnnotationFlags(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t annot_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t annot_handle = HandleFromValue(info[1]);
     uint32_t flags = info[2].As<Napi::Number>().Uint32Value();
 
     pdf_set_annot_flags(ctx_handle, annot_handle, flags);
@@ -249,9 +243,8 @@ Napi::String GetAnnotationContents(const Napi::CallbackInfo& info) {
         return Napi::String::New(env, "");
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t annot_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t annot_handle = HandleFromValue(info[1]);
 
     // Allocate buffer for contents
     char buffer[4096];
@@ -276,9 +269,8 @@ Napi::Value SetAnnotationContents(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t annot_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t annot_handle = HandleFromValue(info[1]);
     std::string contents = info[2].As<Napi::String>().Utf8Value();
 
     pdf_set_annot_contents(ctx_handle, annot_handle, contents.c_str());
@@ -302,9 +294,8 @@ Napi::String GetAnnotationAuthor(const Napi::CallbackInfo& info) {
         return Napi::String::New(env, "");
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t annot_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t annot_handle = HandleFromValue(info[1]);
 
     char buffer[256];
     pdf_annot_author(ctx_handle, annot_handle, buffer, sizeof(buffer));
@@ -328,9 +319,8 @@ Napi::Value SetAnnotationAuthor(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t annot_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t annot_handle = HandleFromValue(info[1]);
     std::string author = info[2].As<Napi::String>().Utf8Value();
 
     pdf_set_annot_author(ctx_handle, annot_handle, author.c_str());
@@ -354,9 +344,8 @@ Napi::Number GetAnnotationOpacity(const Napi::CallbackInfo& info) {
         return Napi::Number::New(env, 1.0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t annot_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t annot_handle = HandleFromValue(info[1]);
 
     float opacity = pdf_annot_opacity(ctx_handle, annot_handle);
 
@@ -379,9 +368,8 @@ Napi::Value SetAnnotationOpacity(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t annot_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t annot_handle = HandleFromValue(info[1]);
     float opacity = info[2].As<Napi::Number>().FloatValue();
 
     // Clamp opacity to valid range
@@ -409,9 +397,8 @@ Napi::Boolean IsAnnotationDirty(const Napi::CallbackInfo& info) {
         return Napi::Boolean::New(env, false);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t annot_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t annot_handle = HandleFromValue(info[1]);
 
     int32_t is_dirty = pdf_annot_has_dirty(ctx_handle, annot_handle);
 
@@ -433,9 +420,8 @@ Napi::Value ClearAnnotationDirty(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t annot_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t annot_handle = HandleFromValue(info[1]);
 
     pdf_annot_clear_dirty(ctx_handle, annot_handle);
 
@@ -458,15 +444,89 @@ Napi::Boolean UpdateAnnotation(const Napi::CallbackInfo& info) {
         return Napi::Boolean::New(env, false);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t annot_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t annot_handle = HandleFromValue(info[1]);
 
     int32_t result = pdf_update_annot(ctx_handle, annot_handle);
 
     return Napi::Boolean::New(env, result != 0);
 }
 
+/**
+ * Apply changes to many annotations in one call
+ *
+ * Each change is {annot, rect?, contents?, opacity?, flags?}; only the
+ * properties present are applied. Annotations that actually change are
+ * marked dirty.
+ *
+ * @param ctx - Context handle
+ * @param changes - Array of changes
+ * @returns {changed, dirty} where dirty is the union of the area the
+ *          changed annotations covered before and after, or null
+ */
+Napi::Value UpdateAnnotations(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[1].IsArray()) {
+        Napi::TypeError::New(env, "Expected 2 arguments: ctx, changes")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    Napi::Array list = info[1].As<Napi::Array>();
+
+    // Contents strings must outlive the call
+    std::vector<pdf_annot_change> changes(list.Length());
+    std::vector<std::string> contents(list.Length());
+    for (uint32_t i = 0; i < list.Length(); i++) {
+        Napi::Object obj = list.Get(i).As<Napi::Object>();
+        pdf_annot_change& change = changes[i];
+        change = pdf_annot_change{};
+        change.annot = HandleFromValue(obj.Get("annot"));
+
+        if (obj.Has("rect")) {
+            Napi::Object rect_obj = obj.Get("rect").As<Napi::Object>();
+            change.rect.x0 = rect_obj.Get("x0").As<Napi::Number>().FloatValue();
+            change.rect.y0 = rect_obj.Get("y0").As<Napi::Number>().FloatValue();
+            change.rect.x1 = rect_obj.Get("x1").As<Napi::Number>().FloatValue();
+            change.rect.y1 = rect_obj.Get("y1").As<Napi::Number>().FloatValue();
+            change.mask |= PDF_ANNOT_CHANGE_RECT;
+        }
+        if (obj.Has("contents")) {
+            contents[i] = obj.Get("contents").As<Napi::String>().Utf8Value();
+            change.contents = contents[i].c_str();
+            change.mask |= PDF_ANNOT_CHANGE_CONTENTS;
+        }
+        if (obj.Has("opacity")) {
+            change.opacity = obj.Get("opacity").As<Napi::Number>().FloatValue();
+            change.mask |= PDF_ANNOT_CHANGE_OPACITY;
+        }
+        if (obj.Has("flags")) {
+            change.flags = obj.Get("flags").As<Napi::Number>().Uint32Value();
+            change.mask |= PDF_ANNOT_CHANGE_FLAGS;
+        }
+    }
+
+    fz_rect dirty = {0, 0, 0, 0};
+    int changed = pdf_update_annots(ctx_handle, changes.data(),
+                                    static_cast<int>(changes.size()), &dirty);
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("changed", Napi::Number::New(env, changed));
+    if (changed > 0) {
+        Napi::Object rect = Napi::Object::New(env);
+        rect.Set("x0", Napi::Number::New(env, dirty.x0));
+        rect.Set("y0", Napi::Number::New(env, dirty.y0));
+        rect.Set("x1", Napi::Number::New(env, dirty.x1));
+        rect.Set("y1", Napi::Number::New(env, dirty.y1));
+        result.Set("dirty", rect);
+    } else {
+        result.Set("dirty", env.Null());
+    }
+    return result;
+}
+
 /**
  * Clone an annotation
  *
@@ -474,22 +534,21 @@ Napi::Boolean UpdateAnnotation(const Napi::CallbackInfo& info) {
  * @param annot - Annotation handle
  * @returns New annotation handle
  */
-Napi::BigInt CloneAnnotation(const Napi::CallbackInfo& info) {
+Napi::Value CloneAnnotation(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 2) {
         Napi::TypeError::New(env, "Expected 2 arguments: ctx, annot")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t annot_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t annot_handle = HandleFromValue(info[1]);
 
     uint64_t new_annot = pdf_clone_annot(ctx_handle, annot_handle);
 
-    return Napi::BigInt::New(env, new_annot);
+    return HandleToValue(env, new_annot);
 }
 
 /**
@@ -508,9 +567,8 @@ Napi::Boolean IsAnnotationValid(const Napi::CallbackInfo& info) {
         return Napi::Boolean::New(env, false);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t annot_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t annot_handle = HandleFromValue(info[1]);
 
     int32_t is_valid = pdf_annot_is_valid(ctx_handle, annot_handle);
 
@@ -547,6 +605,7 @@ Napi::Object InitAnnotation(Napi::Env env, Napi::Object exports) {
     exports.Set("isAnnotationDirty", Napi::Function::New(env, IsAnnotationDirty));
     exports.Set("clearAnnotationDirty", Napi::Function::New(env, ClearAnnotationDirty));
     exports.Set("updateAnnotation", Napi::Function::New(env, UpdateAnnotation));
+    exports.Set("updateAnnotations", Napi::Function::New(env, UpdateAnnotations));
 
     // Annotation utilities
     exports.Set("cloneAnnotation", Napi::Function::New(env, CloneAnnotation));
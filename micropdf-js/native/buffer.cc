@@ -5,8 +5,25 @@
  */
 
 #include <napi.h>
+#include <memory>
 #include "include/micropdf.h"
 
+/**
+ * Shared owner of a native buffer
+ *
+ * Zero-copy views handed to JavaScript hold their own reference, so the
+ * native memory stays valid for as long as any view is reachable.
+ */
+typedef std::shared_ptr<micropdf_buffer_t> BufferRef;
+
+static BufferRef MakeBufferRef(micropdf_buffer_t* buf) {
+    return BufferRef(buf, [](micropdf_buffer_t* b) {
+        if (b != nullptr) {
+            micropdf_buffer_free(b);
+        }
+    });
+}
+
 /**
  * Buffer class wrapper
  */
@@ -18,7 +35,10 @@ public:
 
 private:
     static Napi::FunctionReference constructor;
-    micropdf_buffer_t* buffer_;
+    BufferRef buffer_;
+
+    // Copy-on-write: give this wrapper a private copy if views are outstanding
+    bool DetachForWrite();
 
     // Methods
     Napi::Value GetLength(const Napi::CallbackInfo& info);
@@ -57,9 +77,9 @@ Buffer::Buffer(const Napi::CallbackInfo& info) : Napi::ObjectWrap<Buffer>(info)
 
     if (info.Length() > 0 && info[0].IsNumber()) {
         size_t capacity = info[0].As<Napi::Number>().Uint32Value();
-        buffer_ = micropdf_buffer_new(capacity);
+        buffer_ = MakeBufferRef(micropdf_buffer_new(capacity));
     } else {
-        buffer_ = micropdf_buffer_new(0);
+        buffer_ = MakeBufferRef(micropdf_buffer_new(0));
     }
 
     if (buffer_ == nullptr) {
@@ -68,10 +88,24 @@ Buffer::Buffer(const Napi::CallbackInfo& info) : Napi::ObjectWrap<Buffer>(info)
 }
 
 Buffer::~Buffer() {
-    if (buffer_ != nullptr) {
-        micropdf_buffer_free(buffer_);
-        buffer_ = nullptr;
+    buffer_.reset();
+}
+
+bool Buffer::DetachForWrite() {
+    if (buffer_.use_count() <= 1) {
+        return true;
     }
+
+    micropdf_buffer_t* copy = micropdf_buffer_from_data(
+        micropdf_buffer_data(buffer_.get()),
+        micropdf_buffer_len(buffer_.get())
+    );
+    if (copy == nullptr) {
+        return false;
+    }
+
+    buffer_ = MakeBufferRef(copy);
+    return true;
 }
 
 Napi::Value Buffer::GetLength(const Napi::CallbackInfo& info) {
@@ -79,7 +113,7 @@ Napi::Value Buffer::GetLength(const Napi::CallbackInfo& info) {
     if (buffer_ == nullptr) {
         return Napi::Number::New(env, 0);
     }
-    return Napi::Number::New(env, static_cast<double>(micropdf_buffer_len(buffer_)));
+    return Napi::Number::New(env, static_cast<double>(micropdf_buffer_len(buffer_.get())));
 }
 
 Napi::Value Buffer::GetData(const Napi::CallbackInfo& info) {
@@ -88,15 +122,23 @@ Napi::Value Buffer::GetData(const Napi::CallbackInfo& info) {
         return env.Null();
     }
 
-    size_t len = micropdf_buffer_len(buffer_);
-    const uint8_t* data = micropdf_buffer_data(buffer_);
+    size_t len = micropdf_buffer_len(buffer_.get());
+    const uint8_t* data = micropdf_buffer_data(buffer_.get());
 
     if (data == nullptr || len == 0) {
         return Napi::Buffer<uint8_t>::New(env, 0);
     }
 
-    // Copy data to a new Node.js Buffer
-    return Napi::Buffer<uint8_t>::Copy(env, data, len);
+    // Hand out a view over the native storage. The view owns a reference,
+    // and later appends copy-on-write, so its contents never change under it.
+    return Napi::Buffer<uint8_t>::NewOrCopy(
+        env,
+        const_cast<uint8_t*>(data),
+        len,
+        [](Napi::Env, uint8_t*, BufferRef* ref) {
+            delete ref;
+        },
+        new BufferRef(buffer_));
 }
 
 Napi::Value Buffer::Append(const Napi::CallbackInfo& info) {
@@ -112,9 +154,14 @@ Napi::Value Buffer::Append(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
+    if (!DetachForWrite()) {
+        Napi::Error::New(env, "Failed to copy buffer for writing").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
     if (info[0].IsBuffer()) {
         Napi::Buffer<uint8_t> buf = info[0].As<Napi::Buffer<uint8_t>>();
-        micropdf_error_t err = micropdf_buffer_append(buffer_, buf.Data(), buf.Length());
+        micropdf_error_t err = micropdf_buffer_append(buffer_.get(), buf.Data(), buf.Length());
         if (err != MICROPDF_OK) {
             Napi::Error::New(env, "Failed to append data").ThrowAsJavaScriptException();
         }
@@ -122,7 +169,7 @@ Napi::Value Buffer::Append(const Napi::CallbackInfo& info) {
         Napi::TypedArray arr = info[0].As<Napi::TypedArray>();
         if (arr.TypedArrayType() == napi_uint8_array) {
             Napi::Uint8Array u8arr = arr.As<Napi::Uint8Array>();
-            micropdf_error_t err = micropdf_buffer_append(buffer_, u8arr.Data(), u8arr.ElementLength());
+            micropdf_error_t err = micropdf_buffer_append(buffer_.get(), u8arr.Data(), u8arr.ElementLength());
             if (err != MICROPDF_OK) {
                 Napi::Error::New(env, "Failed to append data").ThrowAsJavaScriptException();
             }
@@ -158,11 +205,8 @@ Napi::Value Buffer::FromNodeBuffer(const Napi::CallbackInfo& info) {
     Napi::Object obj = constructor.New({});
     Buffer* wrapper = Napi::ObjectWrap<Buffer>::Unwrap(obj);
 
-    // Free the old buffer and set the new one
-    if (wrapper->buffer_ != nullptr) {
-        micropdf_buffer_free(wrapper->buffer_);
-    }
-    wrapper->buffer_ = buf;
+    // Release the old buffer and set the new one
+    wrapper->buffer_ = MakeBufferRef(buf);
 
     return obj;
 }
@@ -189,10 +233,7 @@ Napi::Value Buffer::FromString(const Napi::CallbackInfo& info) {
     Napi::Object obj = constructor.New({});
     Buffer* wrapper = Napi::ObjectWrap<Buffer>::Unwrap(obj);
 
-    if (wrapper->buffer_ != nullptr) {
-        micropdf_buffer_free(wrapper->buffer_);
-    }
-    wrapper->buffer_ = buf;
+    wrapper->buffer_ = MakeBufferRef(buf);
 
     return obj;
 }
@@ -7,6 +7,7 @@
 
 #include <napi.h>
 #include "include/mupdf_minimal.h"
+#include "include/handles.h"
 
 /**
  * Get device gray colorspace handle
@@ -14,21 +15,20 @@
  * @param ctx - Context handle
  * @returns Colorspace handle (1)
  */
-Napi::BigInt DeviceGray(const Napi::CallbackInfo& info) {
+Napi::Value DeviceGray(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 1) {
         Napi::TypeError::New(env, "Expected 1 argument: ctx")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
 
     uint64_t cs_handle = fz_device_gray(ctx_handle);
 
-    return Napi::BigInt::New(env, cs_handle);
+    return HandleToValue(env, cs_handle);
 }
 
 /**
@@ -37,21 +37,20 @@ Napi::BigInt DeviceGray(const Napi::CallbackInfo& info) {
  * @param ctx - Context handle
  * @returns Colorspace handle (2)
  */
-Napi::BigInt DeviceRGB(const Napi::CallbackInfo& info) {
+Napi::Value DeviceRGB(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 1) {
         Napi::TypeError::New(env, "Expected 1 argument: ctx")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
 
     uint64_t cs_handle = fz_device_rgb(ctx_handle);
 
-    return Napi::BigInt::New(env, cs_handle);
+    return HandleToValue(env, cs_handle);
 }
 
 /**
@@ -60,21 +59,20 @@ Napi::BigInt DeviceRGB(const Napi::CallbackInfo& info) {
  * @param ctx - Context handle
  * @returns Colorspace handle (3)
  */
-Napi::BigInt DeviceBGR(const Napi::CallbackInfo& info) {
+Napi::Value DeviceBGR(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 1) {
         Napi::TypeError::New(env, "Expected 1 argument: ctx")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
 
     uint64_t cs_handle = fz_device_bgr(ctx_handle);
 
-    return Napi::BigInt::New(env, cs_handle);
+    return HandleToValue(env, cs_handle);
 }
 
 /**
@@ -83,21 +81,20 @@ Napi::BigInt DeviceBGR(const Napi::CallbackInfo& info) {
  * @param ctx - Context handle
  * @returns Colorspace handle (4)
  */
-Napi::BigInt DeviceCMYK(const Napi::CallbackInfo& info) {
+Napi::Value DeviceCMYK(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 1) {
         Napi::TypeError::New(env, "Expected 1 argument: ctx")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
 
     uint64_t cs_handle = fz_device_cmyk(ctx_handle);
 
-    return Napi::BigInt::New(env, cs_handle);
+    return HandleToValue(env, cs_handle);
 }
 
 /**
@@ -116,9 +113,8 @@ Napi::Number ColorspaceN(const Napi::CallbackInfo& info) {
         return Napi::Number::New(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t cs_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t cs_handle = HandleFromValue(info[1]);
 
     int32_t n = fz_colorspace_n(ctx_handle, cs_handle);
 
@@ -141,9 +137,8 @@ Napi::String ColorspaceName(const Napi::CallbackInfo& info) {
         return Napi::String::New(env, "");
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t cs_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t cs_handle = HandleFromValue(info[1]);
 
     const char* name = fz_colorspace_name(ctx_handle, cs_handle);
 
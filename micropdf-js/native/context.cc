@@ -7,6 +7,7 @@
 
 #include <napi.h>
 #include "include/mupdf_minimal.h"
+#include "include/handles.h"
 
 /**
  * Create a new context
@@ -22,7 +23,7 @@ Napi::Value CreateContext(const Napi::CallbackInfo& info) {
     }
 
     Napi::Object obj = Napi::Object::New(env);
-    obj.Set("_handle", Napi::Number::New(env, ctx));
+    obj.Set("_handle", HandleToValue(env, ctx));
     return obj;
 }
 
@@ -44,7 +45,7 @@ Napi::Value DropContext(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    fz_context ctx = ctxObj.Get("_handle").As<Napi::Number>().Int32Value();
+    fz_context ctx = HandleFromValue(ctxObj.Get("_handle"));
     fz_drop_context(ctx);
 
     return env.Undefined();
@@ -63,12 +64,54 @@ Napi::Value CloneContext(const Napi::CallbackInfo& info) {
     }
 
     Napi::Object ctxObj = info[0].As<Napi::Object>();
-    fz_context ctx = ctxObj.Get("_handle").As<Napi::Number>().Int32Value();
+    fz_context ctx = HandleFromValue(ctxObj.Get("_handle"));
 
     fz_context newCtx = fz_clone_context(ctx);
 
     Napi::Object obj = Napi::Object::New(env);
-    obj.Set("_handle", Napi::Number::New(env, newCtx));
+    obj.Set("_handle", HandleToValue(env, newCtx));
+    return obj;
+}
+
+/**
+ * Snapshot the performance counters
+ * JavaScript: getPerfCounters(ctx: NativeContext): NativePerfCounters
+ */
+Napi::Value GetPerfCounters(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Expected context object").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    Napi::Object ctxObj = info[0].As<Napi::Object>();
+    fz_context ctx = HandleFromValue(ctxObj.Get("_handle"));
+
+    fz_perf_counters c = {};
+    fz_get_perf_counters(ctx, &c);
+
+    auto num = [&](uint64_t v) { return Napi::Number::New(env, static_cast<double>(v)); };
+    Napi::Object obj = Napi::Object::New(env);
+    obj.Set("bytesInflated", num(c.bytes_inflated));
+    obj.Set("imagesDecoded", num(c.images_decoded));
+    obj.Set("imagePixelsDecoded", num(c.image_pixels_decoded));
+    obj.Set("imageDecodeNs", num(c.image_decode_ns));
+    obj.Set("glyphsRasterized", num(c.glyphs_rasterized));
+    obj.Set("pathsFilled", num(c.paths_filled));
+    obj.Set("pathsStroked", num(c.paths_stroked));
+    obj.Set("operatorsInterpreted", num(c.operators_interpreted));
+    obj.Set("storeHits", num(c.store_hits));
+    obj.Set("storeMisses", num(c.store_misses));
+    obj.Set("glyphCacheHits", num(c.glyph_cache_hits));
+    obj.Set("glyphCacheMisses", num(c.glyph_cache_misses));
+    obj.Set("documentLookups", num(c.document_lookups));
+    obj.Set("pageLookups", num(c.page_lookups));
+    obj.Set("pixmapLookups", num(c.pixmap_lookups));
+    obj.Set("imageLookups", num(c.image_lookups));
+    obj.Set("fontLookups", num(c.font_lookups));
+    obj.Set("bufferLookups", num(c.buffer_lookups));
+    obj.Set("stextPageLookups", num(c.stext_page_lookups));
     return obj;
 }
 
@@ -79,6 +122,7 @@ Napi::Object InitContext(Napi::Env env, Napi::Object exports) {
     exports.Set("createContext", Napi::Function::New(env, CreateContext));
     exports.Set("dropContext", Napi::Function::New(env, DropContext));
     exports.Set("cloneContext", Napi::Function::New(env, CloneContext));
+    exports.Set("getPerfCounters", Napi::Function::New(env, GetPerfCounters));
     return exports;
 }
 
@@ -7,6 +7,7 @@
 
 #include <napi.h>
 #include "include/mupdf_minimal.h"
+#include "include/handles.h"
 
 /**
  * Create a new cookie
@@ -14,21 +15,20 @@
  * @param ctx - Context handle
  * @returns Cookie handle
  */
-Napi::BigInt NewCookie(const Napi::CallbackInfo& info) {
+Napi::Value NewCookie(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 1) {
         Napi::TypeError::New(env, "Expected 1 argument: ctx")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
 
     uint64_t cookie_handle = fz_new_cookie(ctx_handle);
 
-    return Napi::BigInt::New(env, cookie_handle);
+    return HandleToValue(env, cookie_handle);
 }
 
 /**
@@ -46,9 +46,8 @@ Napi::Value DropCookie(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t cookie_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t cookie_handle = HandleFromValue(info[1]);
 
     fz_drop_cookie(ctx_handle, cookie_handle);
 
@@ -70,9 +69,8 @@ Napi::Value AbortCookie(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t cookie_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t cookie_handle = HandleFromValue(info[1]);
 
     fz_abort_cookie(ctx_handle, cookie_handle);
 
@@ -96,9 +94,8 @@ Napi::Object GetCookieProgress(const Napi::CallbackInfo& info) {
         return result;
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t cookie_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t cookie_handle = HandleFromValue(info[1]);
 
     int32_t progress = 0;
     int32_t progress_max = 0;
@@ -129,9 +126,8 @@ Napi::Boolean IsCookieAborted(const Napi::CallbackInfo& info) {
         return Napi::Boolean::New(env, false);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t cookie_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t cookie_handle = HandleFromValue(info[1]);
 
     int32_t is_aborted = fz_cookie_is_aborted(ctx_handle, cookie_handle);
 
@@ -153,9 +149,8 @@ Napi::Value ResetCookie(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t cookie_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t cookie_handle = HandleFromValue(info[1]);
 
     fz_reset_cookie(ctx_handle, cookie_handle);
 
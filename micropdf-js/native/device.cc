@@ -7,6 +7,7 @@
 
 #include <napi.h>
 #include "include/mupdf_minimal.h"
+#include "include/handles.h"
 
 /**
  * Create a draw device for pixmap rendering
@@ -15,22 +16,21 @@
  * @param pixmap - Pixmap handle
  * @returns Device handle
  */
-Napi::BigInt NewDrawDevice(const Napi::CallbackInfo& info) {
+Napi::Value NewDrawDevice(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 2) {
         Napi::TypeError::New(env, "Expected 2 arguments: ctx, pixmap")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t pixmap_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t pixmap_handle = HandleFromValue(info[1]);
 
     uint64_t device_handle = fz_new_draw_device(ctx_handle, pixmap_handle);
 
-    return Napi::BigInt::New(env, device_handle);
+    return HandleToValue(env, device_handle);
 }
 
 /**
@@ -40,22 +40,21 @@ Napi::BigInt NewDrawDevice(const Napi::CallbackInfo& info) {
  * @param list - Display list handle
  * @returns Device handle
  */
-Napi::BigInt NewListDevice(const Napi::CallbackInfo& info) {
+Napi::Value NewListDevice(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 2) {
         Napi::TypeError::New(env, "Expected 2 arguments: ctx, list")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t list_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t list_handle = HandleFromValue(info[1]);
 
     uint64_t device_handle = fz_new_list_device(ctx_handle, list_handle);
 
-    return Napi::BigInt::New(env, device_handle);
+    return HandleToValue(env, device_handle);
 }
 
 /**
@@ -73,9 +72,8 @@ Napi::Value DropDevice(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t device_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t device_handle = HandleFromValue(info[1]);
 
     fz_drop_device(ctx_handle, device_handle);
 
@@ -97,9 +95,8 @@ Napi::Value CloseDevice(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t device_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t device_handle = HandleFromValue(info[1]);
 
     fz_close_device(ctx_handle, device_handle);
 
@@ -122,9 +119,8 @@ Napi::Value DeviceBeginPage(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t device_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t device_handle = HandleFromValue(info[1]);
 
     Napi::Object rect_obj = info[2].As<Napi::Object>();
     fz_rect rect;
@@ -153,9 +149,8 @@ Napi::Value DeviceEndPage(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t device_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t device_handle = HandleFromValue(info[1]);
 
     fz_end_page(ctx_handle, device_handle);
 
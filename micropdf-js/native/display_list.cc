@@ -7,6 +7,7 @@
 
 #include <napi.h>
 #include "include/mupdf_minimal.h"
+#include "include/handles.h"
 
 /**
  * Create a new display list
@@ -15,17 +16,16 @@
  * @param rect - Bounding rectangle {x0, y0, x1, y1}
  * @returns Display list handle
  */
-Napi::BigInt NewDisplayList(const Napi::CallbackInfo& info) {
+Napi::Value NewDisplayList(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 2) {
         Napi::TypeError::New(env, "Expected 2 arguments: ctx, rect")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
 
     Napi::Object rect_obj = info[1].As<Napi::Object>();
     fz_rect rect;
@@ -36,7 +36,7 @@ Napi::BigInt NewDisplayList(const Napi::CallbackInfo& info) {
 
     uint64_t list_handle = fz_new_display_list(ctx_handle, rect);
 
-    return Napi::BigInt::New(env, list_handle);
+    return HandleToValue(env, list_handle);
 }
 
 /**
@@ -54,9 +54,8 @@ Napi::Value DropDisplayList(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t list_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t list_handle = HandleFromValue(info[1]);
 
     fz_drop_display_list(ctx_handle, list_handle);
 
@@ -80,9 +79,8 @@ Napi::Object GetDisplayListBounds(const Napi::CallbackInfo& info) {
         return rect;
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t list_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t list_handle = HandleFromValue(info[1]);
 
     fz_rect bounds = fz_bound_display_list(ctx_handle, list_handle);
 
@@ -112,10 +110,9 @@ Napi::Value RunDisplayList(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t list_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t device_handle = info[2].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t list_handle = HandleFromValue(info[1]);
+    uint64_t device_handle = HandleFromValue(info[2]);
 
     Napi::Object matrix_obj = info[3].As<Napi::Object>();
     fz_matrix matrix;
@@ -145,22 +142,115 @@ Napi::Value RunDisplayList(const Napi::CallbackInfo& info) {
  * @param page - Page handle
  * @returns Display list handle
  */
-Napi::BigInt NewDisplayListFromPage(const Napi::CallbackInfo& info) {
+Napi::Value NewDisplayListFromPage(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 2) {
         Napi::TypeError::New(env, "Expected 2 arguments: ctx, page")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t page_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t page_handle = HandleFromValue(info[1]);
 
     uint64_t list_handle = fz_new_display_list_from_page(ctx_handle, page_handle);
 
-    return Napi::BigInt::New(env, list_handle);
+    return HandleToValue(env, list_handle);
+}
+
+/**
+ * Optimize a display list for repeated playback
+ *
+ * Culls what the page and clips hide and records per-command bounds, so
+ * runDisplayList with a tile-sized rect only replays what the tile touches.
+ *
+ * @param ctx - Context handle
+ * @param list - Display list handle
+ * @returns Number of commands removed (-1 if the list is invalid)
+ */
+Napi::Number OptimizeDisplayList(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2) {
+        Napi::TypeError::New(env, "Expected 2 arguments: ctx, list")
+            .ThrowAsJavaScriptException();
+        return Napi::Number::New(env, -1);
+    }
+
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t list_handle = HandleFromValue(info[1]);
+
+    int32_t removed = fz_optimize_display_list(ctx_handle, list_handle);
+
+    return Napi::Number::New(env, removed);
+}
+
+/**
+ * Serialize a display list
+ *
+ * With embed set the result is self-contained and can be stored (on disk,
+ * in a shared cache) and replayed by another process without the PDF.
+ *
+ * @param ctx - Context handle
+ * @param list - Display list handle
+ * @param embed - Store font programs and image data inline (default true)
+ * @returns Buffer with the serialized list, or null if the list is invalid
+ */
+Napi::Value SerializeDisplayList(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2) {
+        Napi::TypeError::New(env, "Expected 2 arguments: ctx, list")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t list_handle = HandleFromValue(info[1]);
+    bool embed = info.Length() < 3 || info[2].ToBoolean().Value();
+
+    fz_buffer buf = fz_new_buffer_from_display_list(
+        ctx_handle,
+        list_handle,
+        embed ? FZ_DISPLAY_LIST_EMBED : 0
+    );
+    if (buf == 0) {
+        return env.Null();
+    }
+
+    size_t len = 0;
+    const unsigned char* data = fz_buffer_data(ctx_handle, buf, &len);
+    Napi::Buffer<uint8_t> result = Napi::Buffer<uint8_t>::Copy(env, data, data ? len : 0);
+    fz_drop_buffer(ctx_handle, buf);
+
+    return result;
+}
+
+/**
+ * Read a display list serialized with embedded resources
+ *
+ * @param ctx - Context handle
+ * @param data - Buffer from serializeDisplayList
+ * @returns Display list handle (0 if the data is not a serialized list)
+ */
+Napi::Value DeserializeDisplayList(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2) {
+        Napi::TypeError::New(env, "Expected 2 arguments: ctx, data")
+            .ThrowAsJavaScriptException();
+        return HandleToValue(env, 0);
+    }
+
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    Napi::Buffer<uint8_t> data = info[1].As<Napi::Buffer<uint8_t>>();
+
+    fz_buffer buf = fz_new_buffer_from_copied_data(ctx_handle, data.Data(), data.Length());
+    uint64_t list_handle = fz_new_display_list_from_buffer(ctx_handle, buf, nullptr, nullptr);
+    fz_drop_buffer(ctx_handle, buf);
+
+    return HandleToValue(env, list_handle);
 }
 
 /**
@@ -172,6 +262,9 @@ Napi::Object InitDisplayList(Napi::Env env, Napi::Object exports) {
     exports.Set("getDisplayListBounds", Napi::Function::New(env, GetDisplayListBounds));
     exports.Set("runDisplayList", Napi::Function::New(env, RunDisplayList));
     exports.Set("newDisplayListFromPage", Napi::Function::New(env, NewDisplayListFromPage));
+    exports.Set("optimizeDisplayList", Napi::Function::New(env, OptimizeDisplayList));
+    exports.Set("serializeDisplayList", Napi::Function::New(env, SerializeDisplayList));
+    exports.Set("deserializeDisplayList", Napi::Function::New(env, DeserializeDisplayList));
 
     return exports;
 }
@@ -6,20 +6,21 @@
 
 #include <napi.h>
 #include "include/mupdf_minimal.h"
+#include "include/handles.h"
 #include <cstring>
 
 /**
  * Helper: Extract context from object
  */
 static fz_context GetContext(const Napi::Object& obj) {
-    return obj.Get("_handle").As<Napi::Number>().Int32Value();
+    return HandleFromValue(obj.Get("_handle"));
 }
 
 /**
  * Helper: Extract document handle from object
  */
 static fz_document GetDocument(const Napi::Object& obj) {
-    return obj.Get("_handle").As<Napi::Number>().Int32Value();
+    return HandleFromValue(obj.Get("_handle"));
 }
 
 /**
@@ -44,7 +45,7 @@ Napi::Value OpenDocumentFromPath(const Napi::CallbackInfo& info) {
     }
 
     Napi::Object obj = Napi::Object::New(env);
-    obj.Set("_handle", Napi::Number::New(env, doc));
+    obj.Set("_handle", HandleToValue(env, doc));
     return obj;
 }
 
@@ -71,7 +72,7 @@ Napi::Value OpenDocument(const Napi::CallbackInfo& info) {
     }
 
     Napi::Object obj = Napi::Object::New(env);
-    obj.Set("_handle", Napi::Number::New(env, doc));
+    obj.Set("_handle", HandleToValue(env, doc));
     return obj;
 }
 
@@ -203,6 +204,34 @@ Napi::Value GetMetadata(const Napi::CallbackInfo& info) {
     return env.Null();
 }
 
+/**
+ * Inspect a document in one call
+ * JavaScript: inspectDocument(ctx: NativeContext, doc: NativeDocument): string | null
+ */
+Napi::Value InspectDocument(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsObject()) {
+        Napi::TypeError::New(env, "Expected (context, document)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    fz_context ctx = GetContext(info[0].As<Napi::Object>());
+    fz_document doc = GetDocument(info[1].As<Napi::Object>());
+
+    fz_buffer buf = fz_inspect_document(ctx, doc);
+    if (buf == 0) {
+        return env.Null();
+    }
+
+    const unsigned char* data = nullptr;
+    size_t len = fz_buffer_storage(ctx, buf, &data);
+    Napi::String json = Napi::String::New(env, reinterpret_cast<const char*>(data), len);
+    fz_drop_buffer(ctx, buf);
+
+    return json;
+}
+
 /**
  * Save document to file
  * JavaScript: saveDocument(ctx: NativeContext, doc: NativeDocument, path: string): void
@@ -261,6 +290,7 @@ Napi::Object InitDocument(Napi::Env env, Napi::Object exports) {
     exports.Set("authenticatePassword", Napi::Function::New(env, AuthenticatePassword));
     exports.Set("hasPermission", Napi::Function::New(env, HasPermission));
     exports.Set("getMetadata", Napi::Function::New(env, GetMetadata));
+    exports.Set("inspectDocument", Napi::Function::New(env, InspectDocument));
     exports.Set("saveDocument", Napi::Function::New(env, SaveDocument));
     exports.Set("resolveLink", Napi::Function::New(env, ResolveLink));
     return exports;
@@ -6,6 +6,7 @@
 
 #include <napi.h>
 #include "include/micropdf/enhanced.h"
+#include "include/handles.h"
 #include <vector>
 #include <cstring>
 
@@ -13,7 +14,7 @@
  * Helper: Extract context handle from object
  */
 static int32_t GetContext(const Napi::Object& obj) {
-    return obj.Get("_handle").As<Napi::Number>().Int32Value();
+    return HandleFromValue(obj.Get("_handle"));
 }
 
 /**
@@ -7,6 +7,7 @@
 
 #include <napi.h>
 #include "include/mupdf_minimal.h"
+#include "include/handles.h"
 
 /**
  * Create a new font
@@ -17,24 +18,23 @@
  * @param isItalic - Is font italic
  * @returns Font handle
  */
-Napi::BigInt NewFont(const Napi::CallbackInfo& info) {
+Napi::Value NewFont(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 4) {
         Napi::TypeError::New(env, "Expected 4 arguments: ctx, name, isBold, isItalic")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
     std::string name = info[1].As<Napi::String>().Utf8Value();
     int32_t is_bold = info[2].As<Napi::Boolean>().Value() ? 1 : 0;
     int32_t is_italic = info[3].As<Napi::Boolean>().Value() ? 1 : 0;
 
     uint64_t font_handle = fz_new_font(ctx_handle, name.c_str(), is_bold, is_italic, 0);
 
-    return Napi::BigInt::New(env, font_handle);
+    return HandleToValue(env, font_handle);
 }
 
 /**
@@ -46,17 +46,16 @@ Napi::BigInt NewFont(const Napi::CallbackInfo& info) {
  * @param index - Font index (for font collections)
  * @returns Font handle
  */
-Napi::BigInt NewFontFromFile(const Napi::CallbackInfo& info) {
+Napi::Value NewFontFromFile(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 4) {
         Napi::TypeError::New(env, "Expected 4 arguments: ctx, name, path, index")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
     std::string name = info[1].As<Napi::String>().Utf8Value();
     std::string path = info[2].As<Napi::String>().Utf8Value();
     int32_t index = info[3].As<Napi::Number>().Int32Value();
@@ -69,7 +68,7 @@ Napi::BigInt NewFontFromFile(const Napi::CallbackInfo& info) {
         0
     );
 
-    return Napi::BigInt::New(env, font_handle);
+    return HandleToValue(env, font_handle);
 }
 
 /**
@@ -81,17 +80,16 @@ Napi::BigInt NewFontFromFile(const Napi::CallbackInfo& info) {
  * @param index - Font index (for font collections)
  * @returns Font handle
  */
-Napi::BigInt NewFontFromMemory(const Napi::CallbackInfo& info) {
+Napi::Value NewFontFromMemory(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 4) {
         Napi::TypeError::New(env, "Expected 4 arguments: ctx, name, data, index")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
     std::string name = info[1].As<Napi::String>().Utf8Value();
     Napi::Buffer<uint8_t> buffer = info[2].As<Napi::Buffer<uint8_t>>();
     int32_t index = info[3].As<Napi::Number>().Int32Value();
@@ -105,7 +103,7 @@ Napi::BigInt NewFontFromMemory(const Napi::CallbackInfo& info) {
         0
     );
 
-    return Napi::BigInt::New(env, font_handle);
+    return HandleToValue(env, font_handle);
 }
 
 /**
@@ -123,9 +121,8 @@ Napi::Value DropFont(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t font_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t font_handle = HandleFromValue(info[1]);
 
     fz_drop_font(ctx_handle, font_handle);
 
@@ -148,9 +145,8 @@ Napi::String FontName(const Napi::CallbackInfo& info) {
         return Napi::String::New(env, "");
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t font_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t font_handle = HandleFromValue(info[1]);
 
     char name_buffer[256] = {0};
     fz_font_name(ctx_handle, font_handle, name_buffer, sizeof(name_buffer));
@@ -174,9 +170,8 @@ Napi::Boolean FontIsBold(const Napi::CallbackInfo& info) {
         return Napi::Boolean::New(env, false);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t font_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t font_handle = HandleFromValue(info[1]);
 
     int32_t is_bold = fz_font_is_bold(ctx_handle, font_handle);
 
@@ -199,9 +194,8 @@ Napi::Boolean FontIsItalic(const Napi::CallbackInfo& info) {
         return Napi::Boolean::New(env, false);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t font_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t font_handle = HandleFromValue(info[1]);
 
     int32_t is_italic = fz_font_is_italic(ctx_handle, font_handle);
 
@@ -225,9 +219,8 @@ Napi::Number EncodeCharacter(const Napi::CallbackInfo& info) {
         return Napi::Number::New(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t font_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t font_handle = HandleFromValue(info[1]);
     int32_t unicode = info[2].As<Napi::Number>().Int32Value();
 
     int32_t glyph_id = fz_encode_character(ctx_handle, font_handle, unicode);
@@ -252,9 +245,8 @@ Napi::Number AdvanceGlyph(const Napi::CallbackInfo& info) {
         return Napi::Number::New(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t font_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t font_handle = HandleFromValue(info[1]);
     int32_t glyph_id = info[2].As<Napi::Number>().Int32Value();
 
     float advance = fz_advance_glyph(ctx_handle, font_handle, glyph_id, 0);
@@ -7,7 +7,9 @@
 
 #include <napi.h>
 #include "include/mupdf_minimal.h"
+#include "include/handles.h"
 #include <string>
+#include <vector>
 
 /**
  * Get first form field widget on page
@@ -16,23 +18,22 @@
  * @param page - Page handle
  * @returns Widget handle (or 0 if none)
  */
-Napi::BigInt GetPageWidget(const Napi::CallbackInfo& info) {
+Napi::Value GetPageWidget(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 2) {
         Napi::TypeError::New(env, "Expected 2 arguments: ctx, page")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t page_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t page_handle = HandleFromValue(info[1]);
 
     // Call Rust FFI
     uint64_t widget_handle = pdf_first_widget(ctx_handle, page_handle);
 
-    return Napi::BigInt::New(env, widget_handle);
+    return HandleToValue(env, widget_handle);
 }
 
 /**
@@ -42,22 +43,21 @@ Napi::BigInt GetPageWidget(const Napi::CallbackInfo& info) {
  * @param widget - Current widget handle
  * @returns Next widget handle (or 0 if none)
  */
-Napi::BigInt GetNextWidget(const Napi::CallbackInfo& info) {
+Napi::Value GetNextWidget(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 2) {
         Napi::TypeError::New(env, "Expected 2 arguments: ctx, widget")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t widget_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t widget_handle = HandleFromValue(info[1]);
 
     uint64_t next_handle = pdf_next_widget(ctx_handle, widget_handle);
 
-    return Napi::BigInt::New(env, next_handle);
+    return HandleToValue(env, next_handle);
 }
 
 /**
@@ -75,9 +75,8 @@ Napi::Value DropWidget(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t widget_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t widget_handle = HandleFromValue(info[1]);
 
     pdf_drop_widget(ctx_handle, widget_handle);
 
@@ -100,9 +99,8 @@ Napi::Number GetWidgetType(const Napi::CallbackInfo& info) {
         return Napi::Number::New(env, -1);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t widget_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t widget_handle = HandleFromValue(info[1]);
 
     int32_t field_type = pdf_widget_type(ctx_handle, widget_handle);
 
@@ -125,9 +123,8 @@ Napi::String GetWidgetName(const Napi::CallbackInfo& info) {
         return Napi::String::New(env, "");
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t widget_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t widget_handle = HandleFromValue(info[1]);
 
     // Allocate buffer for name
     char buffer[256];
@@ -152,9 +149,8 @@ Napi::String GetWidgetValue(const Napi::CallbackInfo& info) {
         return Napi::String::New(env, "");
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t widget_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t widget_handle = HandleFromValue(info[1]);
 
     char buffer[4096];
     pdf_widget_value(ctx_handle, widget_handle, buffer, sizeof(buffer));
@@ -179,9 +175,8 @@ Napi::Boolean SetWidgetValue(const Napi::CallbackInfo& info) {
         return Napi::Boolean::New(env, false);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t widget_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t widget_handle = HandleFromValue(info[1]);
     std::string value = info[2].As<Napi::String>().Utf8Value();
 
     int32_t result = pdf_set_widget_value(ctx_handle, widget_handle, value.c_str());
@@ -206,9 +201,8 @@ Napi::Object GetWidgetRect(const Napi::CallbackInfo& info) {
         return rect;
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t widget_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t widget_handle = HandleFromValue(info[1]);
 
     fz_rect widget_rect = pdf_widget_rect(ctx_handle, widget_handle);
 
@@ -236,9 +230,8 @@ Napi::Boolean IsWidgetReadOnly(const Napi::CallbackInfo& info) {
         return Napi::Boolean::New(env, false);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t widget_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t widget_handle = HandleFromValue(info[1]);
 
     int32_t is_readonly = pdf_widget_is_readonly(ctx_handle, widget_handle);
 
@@ -261,9 +254,8 @@ Napi::Boolean IsWidgetRequired(const Napi::CallbackInfo& info) {
         return Napi::Boolean::New(env, false);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t widget_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t widget_handle = HandleFromValue(info[1]);
 
     int32_t is_required = pdf_widget_is_required(ctx_handle, widget_handle);
 
@@ -286,9 +278,8 @@ Napi::Number GetWidgetMaxLen(const Napi::CallbackInfo& info) {
         return Napi::Number::New(env, -1);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t widget_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t widget_handle = HandleFromValue(info[1]);
 
     int32_t max_len = pdf_widget_max_len(ctx_handle, widget_handle);
 
@@ -312,9 +303,8 @@ Napi::Array GetWidgetOptions(const Napi::CallbackInfo& info) {
         return options;
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t widget_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t widget_handle = HandleFromValue(info[1]);
 
     // Get option count
     int32_t count = pdf_widget_option_count(ctx_handle, widget_handle);
@@ -345,9 +335,8 @@ Napi::Boolean UpdateWidget(const Napi::CallbackInfo& info) {
         return Napi::Boolean::New(env, false);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t widget_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t widget_handle = HandleFromValue(info[1]);
 
     int32_t result = pdf_update_widget(ctx_handle, widget_handle);
 
@@ -370,9 +359,8 @@ Napi::Boolean IsWidgetValid(const Napi::CallbackInfo& info) {
         return Napi::Boolean::New(env, false);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t widget_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t widget_handle = HandleFromValue(info[1]);
 
     int32_t is_valid = pdf_widget_is_valid(ctx_handle, widget_handle);
 
@@ -395,9 +383,8 @@ Napi::Number GetWidgetTextFormat(const Napi::CallbackInfo& info) {
         return Napi::Number::New(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t widget_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t widget_handle = HandleFromValue(info[1]);
 
     int32_t format = pdf_widget_text_format(ctx_handle, widget_handle);
 
@@ -420,9 +407,8 @@ Napi::Boolean IsWidgetMultiline(const Napi::CallbackInfo& info) {
         return Napi::Boolean::New(env, false);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t widget_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t widget_handle = HandleFromValue(info[1]);
 
     int32_t is_multiline = pdf_widget_is_multiline(ctx_handle, widget_handle);
 
@@ -445,9 +431,8 @@ Napi::Boolean IsWidgetChecked(const Napi::CallbackInfo& info) {
         return Napi::Boolean::New(env, false);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t widget_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t widget_handle = HandleFromValue(info[1]);
 
     int32_t is_checked = pdf_widget_is_checked(ctx_handle, widget_handle);
 
@@ -470,9 +455,8 @@ Napi::Value SetWidgetChecked(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t widget_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t widget_handle = HandleFromValue(info[1]);
     bool checked = info[2].As<Napi::Boolean>().Value();
 
     pdf_set_widget_checked(ctx_handle, widget_handle, checked ? 1 : 0);
@@ -480,6 +464,51 @@ Napi::Value SetWidgetChecked(const Napi::CallbackInfo& info) {
     return env.Undefined();
 }
 
+/**
+ * Fill form fields by full name in one call
+ *
+ * All values are applied first, the form's calculations run once, and the
+ * appearances of the changed fields are regenerated together.
+ *
+ * @param ctx - Context handle
+ * @param doc - Document handle
+ * @param values - Object mapping field names to string values
+ * @returns Number of fields set (-1 if the document can't be read)
+ */
+Napi::Number FillForm(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 3 || !info[2].IsObject()) {
+        Napi::TypeError::New(env, "Expected 3 arguments: ctx, doc, values")
+            .ThrowAsJavaScriptException();
+        return Napi::Number::New(env, 0);
+    }
+
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t doc_handle = HandleFromValue(info[1]);
+    Napi::Object values = info[2].As<Napi::Object>();
+    Napi::Array keys = values.GetPropertyNames();
+
+    std::vector<std::string> names;
+    std::vector<std::string> strings;
+    for (uint32_t i = 0; i < keys.Length(); i++) {
+        Napi::Value key = keys.Get(i);
+        names.push_back(key.ToString().Utf8Value());
+        strings.push_back(values.Get(key).ToString().Utf8Value());
+    }
+    std::vector<const char*> name_ptrs;
+    std::vector<const char*> value_ptrs;
+    for (size_t i = 0; i < names.size(); i++) {
+        name_ptrs.push_back(names[i].c_str());
+        value_ptrs.push_back(strings[i].c_str());
+    }
+
+    int32_t filled = pdf_fill_form(ctx_handle, doc_handle, name_ptrs.data(), value_ptrs.data(),
+                                   static_cast<int>(names.size()));
+
+    return Napi::Number::New(env, filled);
+}
+
 /**
  * Initialize Form module exports
  */
@@ -517,6 +546,7 @@ Napi::Object InitForm(Napi::Env env, Napi::Object exports) {
 
     // Widget updates
     exports.Set("updateWidget", Napi::Function::New(env, UpdateWidget));
+    exports.Set("fillForm", Napi::Function::New(env, FillForm));
 
     return exports;
 }
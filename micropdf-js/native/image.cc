@@ -7,6 +7,7 @@
 
 #include <napi.h>
 #include "include/mupdf_minimal.h"
+#include "include/handles.h"
 
 /**
  * Load image from file
@@ -15,22 +16,21 @@
  * @param filename - Path to image file
  * @returns Image handle
  */
-Napi::BigInt NewImageFromFile(const Napi::CallbackInfo& info) {
+Napi::Value NewImageFromFile(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 2) {
         Napi::TypeError::New(env, "Expected 2 arguments: ctx, filename")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
     std::string filename = info[1].As<Napi::String>().Utf8Value();
 
     uint64_t image_handle = fz_new_image_from_file(ctx_handle, filename.c_str());
 
-    return Napi::BigInt::New(env, image_handle);
+    return HandleToValue(env, image_handle);
 }
 
 /**
@@ -40,17 +40,16 @@ Napi::BigInt NewImageFromFile(const Napi::CallbackInfo& info) {
  * @param data - Buffer containing image data
  * @returns Image handle
  */
-Napi::BigInt NewImageFromBuffer(const Napi::CallbackInfo& info) {
+Napi::Value NewImageFromBuffer(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 2) {
         Napi::TypeError::New(env, "Expected 2 arguments: ctx, data")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
     Napi::Buffer<uint8_t> buffer = info[1].As<Napi::Buffer<uint8_t>>();
 
     uint64_t image_handle = fz_new_image_from_buffer_data(
@@ -59,7 +58,7 @@ Napi::BigInt NewImageFromBuffer(const Napi::CallbackInfo& info) {
         buffer.Length()
     );
 
-    return Napi::BigInt::New(env, image_handle);
+    return HandleToValue(env, image_handle);
 }
 
 /**
@@ -77,9 +76,8 @@ Napi::Value DropImage(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t image_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t image_handle = HandleFromValue(info[1]);
 
     fz_drop_image(ctx_handle, image_handle);
 
@@ -102,9 +100,8 @@ Napi::Number ImageWidth(const Napi::CallbackInfo& info) {
         return Napi::Number::New(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t image_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t image_handle = HandleFromValue(info[1]);
 
     int32_t width = fz_image_width(ctx_handle, image_handle);
 
@@ -127,9 +124,8 @@ Napi::Number ImageHeight(const Napi::CallbackInfo& info) {
         return Napi::Number::New(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t image_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t image_handle = HandleFromValue(info[1]);
 
     int32_t height = fz_image_height(ctx_handle, image_handle);
 
@@ -143,22 +139,21 @@ Napi::Number ImageHeight(const Napi::CallbackInfo& info) {
  * @param image - Image handle
  * @returns Colorspace handle
  */
-Napi::BigInt ImageColorspace(const Napi::CallbackInfo& info) {
+Napi::Value ImageColorspace(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 2) {
         Napi::TypeError::New(env, "Expected 2 arguments: ctx, image")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t image_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t image_handle = HandleFromValue(info[1]);
 
     uint64_t cs_handle = fz_image_colorspace(ctx_handle, image_handle);
 
-    return Napi::BigInt::New(env, cs_handle);
+    return HandleToValue(env, cs_handle);
 }
 
 /**
@@ -166,7 +161,7 @@ Napi::BigInt ImageColorspace(const Napi::CallbackInfo& info) {
  *
  * @param ctx - Context handle
  * @param image - Image handle
- * @returns Object {pixmap: BigInt, width: Number, height: Number}
+ * @returns Object {pixmap: Number, width: Number, height: Number}
  */
 Napi::Object GetPixmapFromImage(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
@@ -178,9 +173,8 @@ Napi::Object GetPixmapFromImage(const Napi::CallbackInfo& info) {
         return result;
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t image_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t image_handle = HandleFromValue(info[1]);
 
     int32_t w = 0, h = 0;
     uint64_t pixmap_handle = fz_get_pixmap_from_image(
@@ -192,7 +186,7 @@ Napi::Object GetPixmapFromImage(const Napi::CallbackInfo& info) {
         &h
     );
 
-    result.Set("pixmap", Napi::BigInt::New(env, pixmap_handle));
+    result.Set("pixmap", HandleToValue(env, pixmap_handle));
     result.Set("width", Napi::Number::New(env, w));
     result.Set("height", Napi::Number::New(env, h));
 
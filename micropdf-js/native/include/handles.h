@@ -0,0 +1,45 @@
+/**
+ * Handle marshalling shared by all bindings
+ *
+ * Native handles come from one process-wide counter, so they are small
+ * integers that a JS Number holds exactly (an SMI in practice) without
+ * boxing. Every binding returns handles as Numbers and accepts them either
+ * bare or as the `_handle` property of a wrapper object. BigInt handles
+ * from older callers are still accepted but never produced.
+ */
+
+#ifndef MICROPDF_HANDLES_H
+#define MICROPDF_HANDLES_H
+
+#include <napi.h>
+#include <cstdint>
+
+/**
+ * Read a handle from a Number, BigInt or `{ _handle }` object
+ * Returns 0 (no handle) for undefined, null or anything else.
+ */
+inline uint64_t HandleFromValue(const Napi::Value& value) {
+    if (value.IsNumber()) {
+        return static_cast<uint64_t>(value.As<Napi::Number>().Int64Value());
+    }
+    if (value.IsBigInt()) {
+        bool lossless;
+        return value.As<Napi::BigInt>().Uint64Value(&lossless);
+    }
+    if (value.IsObject()) {
+        Napi::Value inner = value.As<Napi::Object>().Get("_handle");
+        if (inner.IsNumber() || inner.IsBigInt()) {
+            return HandleFromValue(inner);
+        }
+    }
+    return 0;
+}
+
+/**
+ * Return a handle to JavaScript as a Number
+ */
+inline Napi::Number HandleToValue(Napi::Env env, uint64_t handle) {
+    return Napi::Number::New(env, static_cast<double>(handle));
+}
+
+#endif /* MICROPDF_HANDLES_H */
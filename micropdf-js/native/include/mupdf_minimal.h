@@ -39,17 +39,17 @@ typedef struct {
 } fz_quad;
 
 // ============================================================================
-// Opaque Handle Types (all represented as int32_t in FFI)
+// Opaque Handle Types (uint64_t, matching the Rust Handle type)
 // ============================================================================
 
-typedef int32_t fz_context;
-typedef int32_t fz_document;
-typedef int32_t fz_page;
+typedef uint64_t fz_context;
+typedef uint64_t fz_document;
+typedef uint64_t fz_page;
 // fz_pixmap is defined later with specific functions
-typedef int32_t fz_buffer;
-typedef int32_t fz_stext_page;
-typedef int32_t fz_link;
-typedef int32_t fz_archive;
+typedef uint64_t fz_buffer;
+typedef uint64_t fz_stext_page;
+typedef uint64_t fz_link;
+typedef uint64_t fz_archive;
 
 // Forward declarations for types defined later with specific functions
 typedef uint64_t fz_colorspace;
@@ -67,6 +67,32 @@ typedef uint64_t fz_output;
 fz_context fz_new_context(const void* alloc, const void* locks, size_t max_store);
 void fz_drop_context(fz_context ctx);
 fz_context fz_clone_context(fz_context ctx);
+void fz_set_aa_level(fz_context ctx, int bits);
+int fz_aa_level(fz_context ctx);
+
+// Performance counters (process wide, monotonic)
+typedef struct {
+    uint64_t bytes_inflated;
+    uint64_t images_decoded;
+    uint64_t image_pixels_decoded;
+    uint64_t image_decode_ns;
+    uint64_t glyphs_rasterized;
+    uint64_t paths_filled;
+    uint64_t paths_stroked;
+    uint64_t operators_interpreted;
+    uint64_t store_hits;
+    uint64_t store_misses;
+    uint64_t glyph_cache_hits;
+    uint64_t glyph_cache_misses;
+    uint64_t document_lookups;
+    uint64_t page_lookups;
+    uint64_t pixmap_lookups;
+    uint64_t image_lookups;
+    uint64_t font_lookups;
+    uint64_t buffer_lookups;
+    uint64_t stext_page_lookups;
+} fz_perf_counters;
+int fz_get_perf_counters(fz_context ctx, fz_perf_counters* out);
 
 // ============================================================================
 // Document Functions
@@ -80,10 +106,12 @@ int fz_needs_password(fz_context ctx, fz_document doc);
 int fz_authenticate_password(fz_context ctx, fz_document doc, const char* password);
 int fz_has_permission(fz_context ctx, fz_document doc, int permission);
 int fz_lookup_metadata(fz_context ctx, fz_document doc, const char* key, char* buf, int size);
+fz_buffer fz_inspect_document(fz_context ctx, fz_document doc);
 
 // PDF-specific document functions
 void pdf_save_document(fz_context ctx, fz_document doc, const char* filename, const void* opts);
 int pdf_lookup_named_dest(fz_context ctx, fz_document doc, const char* name);
+int pdf_bound_pages(fz_context ctx, fz_document doc, float* out, int max);
 
 // ============================================================================
 // Page Functions
@@ -102,15 +130,19 @@ fz_matrix fz_scale(float sx, float sy);
 fz_matrix fz_translate(float tx, float ty);
 fz_matrix fz_rotate(float degrees);
 fz_matrix fz_concat(fz_matrix a, fz_matrix b);
+fz_rect fz_transform_rect(fz_rect r, fz_matrix m);
+fz_irect fz_round_rect(fz_rect r);
 
 // ============================================================================
 // Buffer Functions
 // ============================================================================
 
 // fz_new_buffer_from_pixmap_as_png is declared after fz_pixmap typedef
+fz_buffer fz_keep_buffer(fz_context ctx, fz_buffer buf);
 void fz_drop_buffer(fz_context ctx, fz_buffer buf);
 size_t fz_buffer_storage(fz_context ctx, fz_buffer buf, const unsigned char** data);
 const unsigned char* fz_buffer_data(fz_context ctx, fz_buffer buf, size_t* len);
+fz_buffer fz_new_buffer_from_copied_data(fz_context ctx, const unsigned char* data, size_t size);
 
 // ============================================================================
 // Text Extraction Functions
@@ -121,6 +153,37 @@ void fz_drop_stext_page(fz_context ctx, fz_stext_page stext);
 fz_buffer fz_new_buffer_from_stext_page(fz_context ctx, fz_stext_page stext);
 fz_rect fz_bound_stext_page(fz_context ctx, fz_stext_page stext);
 
+// Structured text walk (indices; -1 ends the iteration)
+int fz_stext_block_count(fz_context ctx, fz_stext_page stext);
+int fz_stext_first_block(fz_context ctx, fz_stext_page stext);
+int fz_stext_next_block(fz_context ctx, fz_stext_page stext, int block);
+int fz_stext_block_type(fz_context ctx, fz_stext_page stext, int block);
+void fz_stext_block_bbox(fz_context ctx, fz_stext_page stext, int block, float* x0, float* y0, float* x1, float* y1);
+int fz_stext_line_count(fz_context ctx, fz_stext_page stext, int block);
+int fz_stext_first_line(fz_context ctx, fz_stext_page stext, int block);
+int fz_stext_next_line(fz_context ctx, fz_stext_page stext, int block, int line);
+void fz_stext_line_bbox(fz_context ctx, fz_stext_page stext, int block, int line, float* x0, float* y0, float* x1, float* y1);
+int fz_stext_line_wmode(fz_context ctx, fz_stext_page stext, int block, int line);
+int fz_stext_char_count(fz_context ctx, fz_stext_page stext, int block, int line);
+int fz_stext_first_char(fz_context ctx, fz_stext_page stext, int block, int line);
+int fz_stext_next_char(fz_context ctx, fz_stext_page stext, int block, int line, int ch);
+int fz_stext_char_value(fz_context ctx, fz_stext_page stext, int block, int line, int ch);
+void fz_stext_char_origin(fz_context ctx, fz_stext_page stext, int block, int line, int ch, float* x, float* y);
+void fz_stext_char_quad(fz_context ctx, fz_stext_page stext, int block, int line, int ch, fz_quad* quad);
+float fz_stext_char_size(fz_context ctx, fz_stext_page stext, int block, int line, int ch);
+
+// Flat export of a whole page (size with fz_stext_page_flat_counts)
+int fz_stext_page_flat_counts(fz_context ctx, fz_stext_page stext, int* blocks, int* lines, int* chars);
+int fz_stext_page_fill_flat(fz_context ctx, fz_stext_page stext, float* quads, uint32_t* codepoints, int max_chars,
+                            uint32_t* line_offsets, int max_lines, uint32_t* block_offsets, int max_blocks);
+
+// Whole-document extraction on worker threads; pages arrive in order on the
+// calling thread with at most max_in_flight extracted ahead of delivery
+#define FZ_TEXT_FORMAT_TEXT 0
+#define FZ_TEXT_FORMAT_JSON 1
+typedef int (*fz_text_page_callback)(void* opaque, int page, const unsigned char* data, size_t len);
+int fz_extract_document_text(fz_context ctx, fz_document doc, int format, const void* options, int threads, int max_in_flight, fz_text_page_callback callback, void* opaque);
+
 // ============================================================================
 // Search Functions
 // ============================================================================
@@ -139,7 +202,7 @@ void fz_drop_archive(fz_context ctx, fz_archive arch);
 // Annotation Functions
 // ============================================================================
 
-typedef int32_t pdf_annot;
+typedef uint64_t pdf_annot;
 
 pdf_annot pdf_create_annot(fz_context ctx, fz_page page, int type);
 void pdf_delete_annot(fz_context ctx, fz_page page, pdf_annot annot);
@@ -165,6 +228,24 @@ int pdf_annot_has_dirty(fz_context ctx, pdf_annot annot);
 void pdf_annot_clear_dirty(fz_context ctx, pdf_annot annot);
 int pdf_update_annot(fz_context ctx, pdf_annot annot);
 
+// Many annotations changed in one call; dirty gets the union of the area
+// the changed ones covered before and after
+#define PDF_ANNOT_CHANGE_RECT       (1 << 0)
+#define PDF_ANNOT_CHANGE_CONTENTS   (1 << 1)
+#define PDF_ANNOT_CHANGE_OPACITY    (1 << 2)
+#define PDF_ANNOT_CHANGE_FLAGS      (1 << 3)
+
+typedef struct {
+    pdf_annot annot;
+    uint32_t mask;
+    uint32_t flags;
+    fz_rect rect;
+    float opacity;
+    const char* contents;
+} pdf_annot_change;
+
+int pdf_update_annots(fz_context ctx, const pdf_annot_change* changes, int count, fz_rect* dirty);
+
 pdf_annot pdf_clone_annot(fz_context ctx, pdf_annot annot);
 int pdf_annot_is_valid(fz_context ctx, pdf_annot annot);
 
@@ -179,6 +260,14 @@ void fz_drop_display_list(fz_context ctx, fz_display_list_handle list);
 fz_rect fz_bound_display_list(fz_context ctx, fz_display_list_handle list);
 void fz_run_display_list(fz_context ctx, fz_display_list_handle list, fz_device device, fz_matrix matrix, fz_rect rect);
 fz_display_list_handle fz_new_display_list_from_page(fz_context ctx, fz_page page);
+int32_t fz_optimize_display_list(fz_context ctx, fz_display_list_handle list);
+
+#define FZ_DISPLAY_LIST_EMBED 1
+typedef fz_buffer (*fz_display_list_fetch_fn)(fz_context ctx, const unsigned char* hash, void* opaque);
+fz_buffer fz_new_buffer_from_display_list(fz_context ctx, fz_display_list_handle list, int32_t flags);
+int32_t fz_display_list_count_resources(fz_context ctx, fz_display_list_handle list);
+fz_buffer fz_display_list_resource(fz_context ctx, fz_display_list_handle list, int32_t index, unsigned char* hash);
+fz_display_list_handle fz_new_display_list_from_buffer(fz_context ctx, fz_buffer buf, fz_display_list_fetch_fn fetch, void* opaque);
 
 // ============================================================================
 // Colorspace Functions
@@ -218,6 +307,8 @@ fz_stream fz_open_memory(fz_context ctx, const unsigned char* data, size_t len);
 void fz_drop_stream(fz_context ctx, fz_stream stm);
 size_t fz_read(fz_context ctx, fz_stream stm, unsigned char* data, size_t len);
 int fz_read_byte(fz_context ctx, fz_stream stm);
+const unsigned char* fz_peek_bytes(fz_context ctx, fz_stream stm, size_t max, size_t* len);
+size_t fz_consume(fz_context ctx, fz_stream stm, size_t n);
 int fz_is_eof(fz_context ctx, fz_stream stm);
 void fz_seek(fz_context ctx, fz_stream stm, int64_t offset, int whence);
 int64_t fz_tell(fz_context ctx, fz_stream stm);
@@ -232,6 +323,9 @@ void fz_drop_output(fz_context ctx, fz_output out);
 void fz_write_data(fz_context ctx, fz_output out, const void* data, size_t size);
 void fz_write_string(fz_context ctx, fz_output out, const char* s);
 void fz_write_byte(fz_context ctx, fz_output out, unsigned char byte);
+void fz_write_int(fz_context ctx, fz_output out, int64_t x);
+void fz_write_real(fz_context ctx, fz_output out, float x);
+void fz_write_reals(fz_context ctx, fz_output out, const float* values, size_t count);
 void fz_close_output(fz_context ctx, fz_output out);
 int64_t fz_tell_output(fz_context ctx, fz_output out);
 
@@ -263,8 +357,9 @@ fz_pixmap fz_new_pixmap(fz_context ctx, uint64_t colorspace, int w, int h, int a
 void fz_drop_pixmap(fz_context ctx, fz_pixmap pixmap);
 int fz_pixmap_width(fz_context ctx, fz_pixmap pixmap);
 int fz_pixmap_height(fz_context ctx, fz_pixmap pixmap);
-void fz_pixmap_samples(fz_context ctx, fz_pixmap pixmap, uint8_t** data, size_t* size);
-unsigned char* fz_pixmap_samples_old(fz_context ctx, fz_pixmap pix);
+fz_pixmap fz_keep_pixmap(fz_context ctx, fz_pixmap pixmap);
+unsigned char* fz_pixmap_samples(fz_context ctx, fz_pixmap pixmap);
+size_t fz_pixmap_size(fz_context ctx, fz_pixmap pixmap);
 size_t fz_pixmap_stride(fz_context ctx, fz_pixmap pixmap);
 int fz_pixmap_components(fz_context ctx, fz_pixmap pixmap);
 void fz_clear_pixmap(fz_context ctx, fz_pixmap pixmap, int value);
@@ -289,6 +384,13 @@ void fz_lineto(fz_context ctx, fz_path_handle path, float x, float y);
 void fz_curveto(fz_context ctx, fz_path_handle path, float x1, float y1, float x2, float y2, float x3, float y3);
 void fz_closepath(fz_context ctx, fz_path_handle path);
 void fz_rectto(fz_context ctx, fz_path_handle path, float x, float y, float w, float h);
+#define FZ_PATH_MOVETO 0
+#define FZ_PATH_LINETO 1
+#define FZ_PATH_CURVETO 2
+#define FZ_PATH_CLOSEPATH 3
+#define FZ_PATH_RECTTO 4
+#define FZ_PATH_QUADTO 5
+int32_t fz_path_append_commands(fz_context ctx, fz_path_handle path, const uint8_t* ops, const float* coords, int32_t n);
 fz_rect fz_bound_path(fz_context ctx, fz_path_handle path, fz_stroke_handle stroke);
 
 // ============================================================================
@@ -316,6 +418,57 @@ void fz_abort_cookie(fz_context ctx, fz_cookie_handle cookie);
 void fz_cookie_progress(fz_context ctx, fz_cookie_handle cookie, int* progress, int* progress_max, int* errors);
 int fz_cookie_is_aborted(fz_context ctx, fz_cookie_handle cookie);
 void fz_reset_cookie(fz_context ctx, fz_cookie_handle cookie);
+void fz_cookie_abort(fz_context ctx, fz_cookie_handle cookie);
+int fz_cookie_should_abort(fz_context ctx, fz_cookie_handle cookie);
+int fz_cookie_get_progress(fz_context ctx, fz_cookie_handle cookie);
+int fz_cookie_get_progress_max(fz_context ctx, fz_cookie_handle cookie);
+
+// Page-to-pixmap render that honours a cookie (needs fz_cookie_handle defined)
+fz_pixmap fz_new_pixmap_from_page_with_cookie(fz_context ctx, fz_page page, fz_matrix ctm, fz_colorspace cs, int alpha, fz_cookie_handle cookie);
+
+// Page-to-pixmap render with explicit AA bits (0/2/4/8) and FZ_RENDER_* flags
+#define FZ_RENDER_ANNOTS 1
+#define FZ_RENDER_WIDGETS 2
+fz_pixmap fz_new_pixmap_from_page_with_options(fz_context ctx, fz_page page, fz_matrix ctm, fz_colorspace cs, int alpha, int aa_bits, int flags, fz_cookie_handle cookie);
+
+// Render pool: worker threads on cloned contexts sharing the store and glyph cache
+typedef uint64_t fz_render_pool;
+#define FZ_RENDER_JOB_PENDING 0
+#define FZ_RENDER_JOB_RUNNING 1
+#define FZ_RENDER_JOB_DONE 2
+#define FZ_RENDER_JOB_FAILED 3
+#define FZ_RENDER_JOB_CANCELLED 4
+fz_render_pool fz_new_render_pool(fz_context ctx, int threads);
+void fz_drop_render_pool(fz_context ctx, fz_render_pool pool);
+int fz_render_pool_threads(fz_context ctx, fz_render_pool pool);
+uint64_t fz_render_pool_submit(fz_context ctx, fz_render_pool pool, fz_document doc, int page_number, fz_matrix ctm, fz_colorspace cs, int alpha, int aa_bits, int flags);
+int fz_render_pool_poll(fz_context ctx, fz_render_pool pool, uint64_t job);
+int fz_render_pool_cancel(fz_context ctx, fz_render_pool pool, uint64_t job);
+fz_pixmap fz_render_pool_wait(fz_context ctx, fz_render_pool pool, uint64_t job);
+
+// Whole-document thumbnails at reduced AA, without annotations, rendered in
+// parallel into one sprite sheet or one small JPEG per page
+fz_pixmap fz_new_thumbnail_sheet(fz_context ctx, fz_document doc, int max_size, fz_colorspace cs, int columns, int threads, fz_irect* rects, int count);
+int fz_new_thumbnail_jpegs(fz_context ctx, fz_document doc, int max_size, fz_colorspace cs, int quality, int threads, fz_buffer* buffers, int count);
+
+// Banded rendering: one band of the page pixmap per call, replaying the
+// cached display list, and a band writer that encodes bands as they arrive
+fz_pixmap fz_new_pixmap_from_page_band(fz_context ctx, fz_page page, fz_matrix ctm, fz_colorspace cs, int alpha, int aa_bits, int flags, int band_y, int band_h, fz_cookie_handle cookie);
+
+typedef uint64_t fz_band_writer;
+#define FZ_BAND_FORMAT_PNG 0
+fz_band_writer fz_new_band_writer_with_config(fz_context ctx, fz_output out, int format, int w, int h, int n, int alpha);
+void fz_drop_band_writer(fz_context ctx, fz_band_writer writer);
+void fz_band_writer_set_rows_per_band(fz_context ctx, fz_band_writer writer, int rows);
+int fz_band_writer_write_header(fz_context ctx, fz_band_writer writer);
+int fz_band_writer_write_band(fz_context ctx, fz_band_writer writer, int band_rows, const unsigned char* data);
+int fz_band_writer_write_trailer(fz_context ctx, fz_band_writer writer);
+fz_buffer fz_band_writer_take_output(fz_context ctx, fz_band_writer writer);
+
+// Pixmaps over caller-owned memory, and rendering a page into one, so the
+// page lands in a JavaScript-owned buffer without a copy
+fz_pixmap fz_new_pixmap_with_data(fz_context ctx, fz_colorspace cs, int w, int h, uint64_t seps, int alpha, int stride, unsigned char* samples);
+int fz_fill_pixmap_from_page(fz_context ctx, fz_page page, fz_matrix ctm, fz_pixmap pix, int aa_bits, int flags, fz_cookie_handle cookie);
 
 // ============================================================================
 // Link Functions
@@ -373,6 +526,10 @@ void pdf_widget_option(fz_context ctx, pdf_widget widget, int index, char* buf,
 // Widget updates
 int pdf_update_widget(fz_context ctx, pdf_widget widget);
 
+// Fill fields by full name in one call: values applied, calculations run
+// once, changed appearances regenerated in parallel; -1 on error
+int pdf_fill_form(fz_context ctx, fz_document doc, const char* const* names, const char* const* values, int count);
+
 #ifdef __cplusplus
 }
 #endif
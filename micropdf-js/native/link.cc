@@ -7,6 +7,7 @@
 
 #include <napi.h>
 #include "include/mupdf_minimal.h"
+#include "include/handles.h"
 
 /**
  * Get first link on page
@@ -15,22 +16,21 @@
  * @param page - Page handle
  * @returns Link handle (or 0 if none)
  */
-Napi::BigInt LoadPageLinks(const Napi::CallbackInfo& info) {
+Napi::Value LoadPageLinks(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 2) {
         Napi::TypeError::New(env, "Expected 2 arguments: ctx, page")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t page_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t page_handle = HandleFromValue(info[1]);
 
     uint64_t link_handle = fz_load_links(ctx_handle, page_handle);
 
-    return Napi::BigInt::New(env, link_handle);
+    return HandleToValue(env, link_handle);
 }
 
 /**
@@ -40,22 +40,21 @@ Napi::BigInt LoadPageLinks(const Napi::CallbackInfo& info) {
  * @param link - Current link handle
  * @returns Next link handle (or 0 if none)
  */
-Napi::BigInt GetNextLink(const Napi::CallbackInfo& info) {
+Napi::Value GetNextLink(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 2) {
         Napi::TypeError::New(env, "Expected 2 arguments: ctx, link")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t link_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t link_handle = HandleFromValue(info[1]);
 
     uint64_t next_handle = fz_next_link(ctx_handle, link_handle);
 
-    return Napi::BigInt::New(env, next_handle);
+    return HandleToValue(env, next_handle);
 }
 
 /**
@@ -73,9 +72,8 @@ Napi::Value DropLink(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t link_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t link_handle = HandleFromValue(info[1]);
 
     fz_drop_link(ctx_handle, link_handle);
 
@@ -99,9 +97,8 @@ Napi::Object GetLinkRect(const Napi::CallbackInfo& info) {
         return rect;
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t link_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t link_handle = HandleFromValue(info[1]);
 
     fz_rect link_rect = fz_link_rect(ctx_handle, link_handle);
 
@@ -129,9 +126,8 @@ Napi::String GetLinkURI(const Napi::CallbackInfo& info) {
         return Napi::String::New(env, "");
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t link_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t link_handle = HandleFromValue(info[1]);
 
     char buffer[2048];
     fz_link_uri(ctx_handle, link_handle, buffer, sizeof(buffer));
@@ -155,9 +151,8 @@ Napi::Boolean IsLinkExternal(const Napi::CallbackInfo& info) {
         return Napi::Boolean::New(env, false);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t link_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t link_handle = HandleFromValue(info[1]);
 
     int32_t is_external = fz_link_is_external(ctx_handle, link_handle);
 
@@ -181,10 +176,9 @@ Napi::Number ResolveLinkPage(const Napi::CallbackInfo& info) {
         return Napi::Number::New(env, -1);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t doc_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t link_handle = info[2].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t doc_handle = HandleFromValue(info[1]);
+    uint64_t link_handle = HandleFromValue(info[2]);
 
     int32_t page_num = fz_resolve_link_page(ctx_handle, doc_handle, link_handle);
 
@@ -207,9 +201,8 @@ Napi::Boolean IsLinkValid(const Napi::CallbackInfo& info) {
         return Napi::Boolean::New(env, false);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t link_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t link_handle = HandleFromValue(info[1]);
 
     int32_t is_valid = fz_link_is_valid(ctx_handle, link_handle);
 
@@ -7,6 +7,7 @@
 
 #include <napi.h>
 #include "include/mupdf_minimal.h"
+#include "include/handles.h"
 
 /**
  * Create output to file
@@ -16,23 +17,22 @@
  * @param append - Append mode (0=overwrite, 1=append)
  * @returns Output handle
  */
-Napi::BigInt NewOutputWithPath(const Napi::CallbackInfo& info) {
+Napi::Value NewOutputWithPath(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 3) {
         Napi::TypeError::New(env, "Expected 3 arguments: ctx, filename, append")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
     std::string filename = info[1].As<Napi::String>().Utf8Value();
     int32_t append = info[2].As<Napi::Boolean>().Value() ? 1 : 0;
 
     uint64_t output_handle = fz_new_output_with_path(ctx_handle, filename.c_str(), append);
 
-    return Napi::BigInt::New(env, output_handle);
+    return HandleToValue(env, output_handle);
 }
 
 /**
@@ -42,22 +42,21 @@ Napi::BigInt NewOutputWithPath(const Napi::CallbackInfo& info) {
  * @param buffer - Buffer handle
  * @returns Output handle
  */
-Napi::BigInt NewOutputWithBuffer(const Napi::CallbackInfo& info) {
+Napi::Value NewOutputWithBuffer(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 2) {
         Napi::TypeError::New(env, "Expected 2 arguments: ctx, buffer")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t buffer_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t buffer_handle = HandleFromValue(info[1]);
 
     uint64_t output_handle = fz_new_output_with_buffer(ctx_handle, buffer_handle);
 
-    return Napi::BigInt::New(env, output_handle);
+    return HandleToValue(env, output_handle);
 }
 
 /**
@@ -75,9 +74,8 @@ Napi::Value DropOutput(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t output_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t output_handle = HandleFromValue(info[1]);
 
     fz_drop_output(ctx_handle, output_handle);
 
@@ -100,9 +98,8 @@ Napi::Value WriteData(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t output_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t output_handle = HandleFromValue(info[1]);
     Napi::Buffer<uint8_t> buffer = info[2].As<Napi::Buffer<uint8_t>>();
 
     fz_write_data(ctx_handle, output_handle, buffer.Data(), buffer.Length());
@@ -126,9 +123,8 @@ Napi::Value WriteString(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t output_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t output_handle = HandleFromValue(info[1]);
     std::string str = info[2].As<Napi::String>().Utf8Value();
 
     fz_write_string(ctx_handle, output_handle, str.c_str());
@@ -136,6 +132,34 @@ Napi::Value WriteString(const Napi::CallbackInfo& info) {
     return env.Undefined();
 }
 
+/**
+ * Write numbers to output as PDF reals, separated by spaces
+ *
+ * A whole array of operands crosses into native code once, instead of
+ * once per number.
+ *
+ * @param ctx - Context handle
+ * @param output - Output handle
+ * @param values - Float32Array of numbers to write
+ */
+Napi::Value WriteReals(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 3) {
+        Napi::TypeError::New(env, "Expected 3 arguments: ctx, output, values")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t output_handle = HandleFromValue(info[1]);
+    Napi::Float32Array values = info[2].As<Napi::Float32Array>();
+
+    fz_write_reals(ctx_handle, output_handle, values.Data(), values.ElementLength());
+
+    return env.Undefined();
+}
+
 /**
  * Write single byte to output
  *
@@ -152,9 +176,8 @@ Napi::Value WriteByte(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t output_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t output_handle = HandleFromValue(info[1]);
     uint8_t byte = static_cast<uint8_t>(info[2].As<Napi::Number>().Uint32Value());
 
     fz_write_byte(ctx_handle, output_handle, byte);
@@ -177,9 +200,8 @@ Napi::Value CloseOutput(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t output_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t output_handle = HandleFromValue(info[1]);
 
     fz_close_output(ctx_handle, output_handle);
 
@@ -202,9 +224,8 @@ Napi::Number TellOutput(const Napi::CallbackInfo& info) {
         return Napi::Number::New(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t output_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t output_handle = HandleFromValue(info[1]);
 
     int64_t position = fz_tell_output(ctx_handle, output_handle);
 
@@ -221,6 +242,7 @@ Napi::Object InitOutput(Napi::Env env, Napi::Object exports) {
     exports.Set("writeData", Napi::Function::New(env, WriteData));
     exports.Set("writeString", Napi::Function::New(env, WriteString));
     exports.Set("writeByte", Napi::Function::New(env, WriteByte));
+    exports.Set("writeReals", Napi::Function::New(env, WriteReals));
     exports.Set("closeOutput", Napi::Function::New(env, CloseOutput));
     exports.Set("tellOutput", Napi::Function::New(env, TellOutput));
 
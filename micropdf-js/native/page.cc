@@ -6,27 +6,36 @@
 
 #include <napi.h>
 #include "include/mupdf_minimal.h"
+#include "include/handles.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 
 /**
  * Helper: Extract context from object
  */
 static fz_context GetContext(const Napi::Object& obj) {
-    return obj.Get("_handle").As<Napi::Number>().Int32Value();
+    return HandleFromValue(obj.Get("_handle"));
 }
 
 /**
  * Helper: Extract document handle from object
  */
 static fz_document GetDocument(const Napi::Object& obj) {
-    return obj.Get("_handle").As<Napi::Number>().Int32Value();
+    return HandleFromValue(obj.Get("_handle"));
 }
 
 /**
  * Helper: Extract page handle from object
  */
 static fz_page GetPage(const Napi::Object& obj) {
-    return obj.Get("_handle").As<Napi::Number>().Int32Value();
+    return HandleFromValue(obj.Get("_handle"));
 }
 
 /**
@@ -55,6 +64,195 @@ static Napi::Object CreateRect(Napi::Env env, const fz_rect& r) {
     return obj;
 }
 
+/**
+ * Finalizer hint for Node buffers that alias fz_buffer memory
+ */
+struct NativeBufferRef {
+    fz_context ctx;
+    fz_buffer buf;
+};
+
+/**
+ * Helper: Hand an encoded fz_buffer to Node without copying
+ * Takes ownership of buf; it is dropped when the Node Buffer is collected.
+ */
+static Napi::Buffer<uint8_t> WrapBuffer(Napi::Env env, fz_context ctx, fz_buffer buf) {
+    size_t len;
+    const unsigned char* data = fz_buffer_data(ctx, buf, &len);
+
+    if (data == nullptr || len == 0) {
+        fz_drop_buffer(ctx, buf);
+        return Napi::Buffer<uint8_t>::New(env, 0);
+    }
+
+    return Napi::Buffer<uint8_t>::NewOrCopy(
+        env,
+        const_cast<uint8_t*>(data),
+        len,
+        [](Napi::Env, uint8_t*, NativeBufferRef* ref) {
+            fz_drop_buffer(ref->ctx, ref->buf);
+            delete ref;
+        },
+        new NativeBufferRef{ctx, buf});
+}
+
+/**
+ * Helper: Copy a rendered pixmap into a NativePixmap
+ * ({ width, height, n, alpha, stride, samples }) and drop it
+ *
+ * Rows are packed into a JavaScript-owned buffer, so no native pixmap
+ * outlives the call.
+ */
+static Napi::Object PixmapToObject(Napi::Env env, fz_context ctx, fz_pixmap pix, bool alpha) {
+    int width = fz_pixmap_width(ctx, pix);
+    int height = fz_pixmap_height(ctx, pix);
+    int n = fz_pixmap_components(ctx, pix);
+    size_t stride = fz_pixmap_stride(ctx, pix);
+    size_t row = static_cast<size_t>(width) * n;
+
+    Napi::Buffer<uint8_t> samples = Napi::Buffer<uint8_t>::New(env, row * height);
+    const unsigned char* data = fz_pixmap_samples(ctx, pix);
+    if (data != nullptr) {
+        for (int y = 0; y < height; y++) {
+            std::copy(data + y * stride, data + y * stride + row, samples.Data() + y * row);
+        }
+    }
+    fz_drop_pixmap(ctx, pix);
+
+    Napi::Object obj = Napi::Object::New(env);
+    obj.Set("width", Napi::Number::New(env, width));
+    obj.Set("height", Napi::Number::New(env, height));
+    obj.Set("n", Napi::Number::New(env, n));
+    obj.Set("alpha", Napi::Boolean::New(env, alpha));
+    obj.Set("stride", Napi::Number::New(env, static_cast<double>(row)));
+    obj.Set("samples", samples);
+    return obj;
+}
+
+/**
+ * Helper: Map a NativeColorspace ({ name, n, type }) to a device colorspace
+ * Anything that is not gray or CMYK renders as RGB.
+ */
+static fz_colorspace GetColorspace(fz_context ctx, const Napi::Object& obj) {
+    int n = obj.Has("n") ? obj.Get("n").As<Napi::Number>().Int32Value() : 3;
+    if (n == 1) {
+        return fz_device_gray(ctx);
+    }
+    if (n == 4) {
+        return fz_device_cmyk(ctx);
+    }
+    return fz_device_rgb(ctx);
+}
+
+/**
+ * Parsed render options shared by the sync and async render entry points
+ */
+struct RenderParams {
+    fz_matrix matrix;
+    fz_colorspace cs;
+    bool alpha;
+    int aa_level;
+    int timeout;
+    bool render_annots;
+    bool render_forms;
+
+    int Flags() const {
+        return (render_annots ? FZ_RENDER_ANNOTS : 0) | (render_forms ? FZ_RENDER_WIDGETS : 0);
+    }
+};
+
+/**
+ * Helper: RenderParams for the positional render entry points, which use the
+ * context AA level and draw annotations and form fields
+ */
+static RenderParams DefaultRenderParams(fz_context ctx, fz_matrix matrix, fz_colorspace cs, bool alpha) {
+    RenderParams params;
+    params.matrix = matrix;
+    params.cs = cs;
+    params.alpha = alpha;
+    params.aa_level = fz_aa_level(ctx);
+    params.timeout = 0;
+    params.render_annots = true;
+    params.render_forms = true;
+    return params;
+}
+
+/**
+ * Helper: Parse a render options object into RenderParams
+ * Throws a TypeError and returns false if an option is invalid.
+ */
+static bool ParseRenderOptions(Napi::Env env, fz_context ctx, const Napi::Object& options, RenderParams* params) {
+    // Extract transform
+    if (options.Has("matrix")) {
+        params->matrix = GetMatrix(options.Get("matrix").As<Napi::Object>());
+    } else if (options.Has("dpi")) {
+        float dpi = options.Get("dpi").As<Napi::Number>().FloatValue();
+        float scale = dpi / 72.0f;
+        params->matrix = fz_scale(scale, scale);
+    } else {
+        params->matrix = fz_identity();
+    }
+
+    // Get colorspace
+    params->cs = fz_device_rgb(ctx);
+    if (options.Has("colorspace")) {
+        if (!options.Get("colorspace").IsObject()) {
+            Napi::TypeError::New(env, "Invalid colorspace (expected a colorspace object)")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+        params->cs = GetColorspace(ctx, options.Get("colorspace").As<Napi::Object>());
+    }
+
+    // Get alpha
+    params->alpha = true;
+    if (options.Has("alpha")) {
+        params->alpha = options.Get("alpha").As<Napi::Boolean>().Value();
+    }
+
+    // Get anti-aliasing bits (matches AntiAliasLevel: 0, 2, 4, 8; 1 is accepted as low)
+    params->aa_level = fz_aa_level(ctx);
+    if (options.Has("antiAlias")) {
+        int aa_level = options.Get("antiAlias").As<Napi::Number>().Int32Value();
+        if (aa_level != 0 && aa_level != 1 && aa_level != 2 && aa_level != 4 && aa_level != 8) {
+            Napi::TypeError::New(env, "Invalid antiAlias level (must be 0, 1, 2, 4, or 8)")
+                .ThrowAsJavaScriptException();
+            return false;
+        }
+        params->aa_level = aa_level;
+    }
+
+    // Get timeout (milliseconds, 0 = none)
+    params->timeout = 0;
+    if (options.Has("timeout")) {
+        params->timeout = options.Get("timeout").As<Napi::Number>().Int32Value();
+        if (params->timeout < 0) {
+            Napi::TypeError::New(env, "Invalid timeout (must be >= 0)").ThrowAsJavaScriptException();
+            return false;
+        }
+    }
+
+    // Render flags
+    params->render_annots = true;
+    params->render_forms = true;
+    if (options.Has("renderAnnotations")) {
+        params->render_annots = options.Get("renderAnnotations").As<Napi::Boolean>().Value();
+    }
+    if (options.Has("renderFormFields")) {
+        params->render_forms = options.Get("renderFormFields").As<Napi::Boolean>().Value();
+    }
+
+    return true;
+}
+
+/**
+ * Helper: Extract an optional cookie handle (as returned by newCookie)
+ * Returns 0 (no cookie) for undefined/null.
+ */
+static fz_cookie_handle GetCookie(const Napi::Value& value) {
+    return HandleFromValue(value);
+}
+
 /**
  * Load page from document
  * JavaScript: loadPage(ctx: NativeContext, doc: NativeDocument, pageNum: number): NativePage
@@ -78,7 +276,7 @@ Napi::Value LoadPage(const Napi::CallbackInfo& info) {
     }
 
     Napi::Object obj = Napi::Object::New(env);
-    obj.Set("_handle", Napi::Number::New(env, page));
+    obj.Set("_handle", HandleToValue(env, page));
     return obj;
 }
 
@@ -122,6 +320,35 @@ Napi::Value BoundPage(const Napi::CallbackInfo& info) {
     return CreateRect(env, bounds);
 }
 
+/**
+ * Get the bounds of every page without loading any
+ * JavaScript: boundPages(ctx: NativeContext, doc: NativeDocument): Float32Array
+ *
+ * Four floats per page (x0, y0, x1, y1), as boundPage gives them, read
+ * from the document's page index.
+ */
+Napi::Value BoundPages(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsObject()) {
+        Napi::TypeError::New(env, "Expected (context, document)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    fz_context ctx = GetContext(info[0].As<Napi::Object>());
+    fz_document doc = GetDocument(info[1].As<Napi::Object>());
+
+    int count = pdf_bound_pages(ctx, doc, nullptr, 0);
+    if (count < 0) {
+        return env.Null();
+    }
+
+    Napi::Float32Array boxes = Napi::Float32Array::New(env, static_cast<size_t>(count) * 4);
+    pdf_bound_pages(ctx, doc, boxes.Data(), count);
+
+    return boxes;
+}
+
 /**
  * Render page to pixmap
  * JavaScript: renderPage(ctx: NativeContext, page: NativePage, matrix: NativeMatrix, colorspace: NativeColorspace, alpha: boolean): NativePixmap
@@ -138,9 +365,7 @@ Napi::Value RenderPage(const Napi::CallbackInfo& info) {
     fz_page page = GetPage(info[1].As<Napi::Object>());
     fz_matrix matrix = GetMatrix(info[2].As<Napi::Object>());
     bool alpha = info[4].As<Napi::Boolean>().Value();
-
-    // Get colorspace (simplified - assume RGB for now)
-    fz_colorspace cs = fz_device_rgb(ctx);
+    fz_colorspace cs = info[3].IsObject() ? GetColorspace(ctx, info[3].As<Napi::Object>()) : fz_device_rgb(ctx);
 
     fz_pixmap pix = fz_new_pixmap_from_page(ctx, page, matrix, cs, alpha ? 1 : 0);
     if (pix == 0) {
@@ -148,11 +373,7 @@ Napi::Value RenderPage(const Napi::CallbackInfo& info) {
         return env.Null();
     }
 
-    Napi::Object obj = Napi::Object::New(env);
-    obj.Set("_handle", Napi::Number::New(env, pix));
-    obj.Set("width", Napi::Number::New(env, fz_pixmap_width(ctx, pix)));
-    obj.Set("height", Napi::Number::New(env, fz_pixmap_height(ctx, pix)));
-    return obj;
+    return PixmapToObject(env, ctx, pix, alpha);
 }
 
 /**
@@ -173,7 +394,7 @@ Napi::Value RenderPageToPNG(const Napi::CallbackInfo& info) {
 
     // Create transform matrix for DPI
     fz_matrix matrix = fz_scale(dpi / 72.0f, dpi / 72.0f);
-    fz_colorspace cs = fz_device_rgb(ctx);
+    fz_colorspace cs = info[3].IsObject() ? GetColorspace(ctx, info[3].As<Napi::Object>()) : fz_device_rgb(ctx);
 
     // Render to pixmap
     fz_pixmap pix = fz_new_pixmap_from_page(ctx, page, matrix, cs, 0);
@@ -191,16 +412,8 @@ Napi::Value RenderPageToPNG(const Napi::CallbackInfo& info) {
         return env.Null();
     }
 
-    // Get buffer data
-    size_t len;
-    const unsigned char* data = fz_buffer_data(ctx, buf, &len);
-
-    // Create Node.js buffer
-    Napi::Buffer<uint8_t> result = Napi::Buffer<uint8_t>::Copy(env, data, len);
-
-    fz_drop_buffer(ctx, buf);
-
-    return result;
+    // Hand the encoded data to Node without copying
+    return WrapBuffer(env, ctx, buf);
 }
 
 /**
@@ -369,10 +582,75 @@ Napi::Value SearchText(const Napi::CallbackInfo& info) {
     return results;
 }
 
+/**
+ * Watchdog that aborts a cookie once a render deadline passes
+ *
+ * The watchdog thread sleeps until either the deadline is reached, in which
+ * case it aborts the cookie, or Finish() wakes it because the render is done.
+ */
+class RenderDeadline {
+public:
+    RenderDeadline(fz_context ctx, fz_cookie_handle cookie, int timeout_ms)
+        : done_(false), expired_(false) {
+        if (cookie == 0 || timeout_ms <= 0) {
+            return;
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+        thread_ = std::thread([this, ctx, cookie, deadline]() {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (!cv_.wait_until(lock, deadline, [this]() { return done_; })) {
+                expired_ = true;
+                fz_cookie_abort(ctx, cookie);
+            }
+        });
+    }
+
+    ~RenderDeadline() { Finish(); }
+
+    /**
+     * Stop the watchdog
+     * Returns true if the deadline passed before the render finished.
+     */
+    bool Finish() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            done_ = true;
+        }
+        cv_.notify_all();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        return expired_;
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::thread thread_;
+    bool done_;
+    bool expired_;
+};
+
+/**
+ * Helper: Create the error reported when a render times out
+ * Carries the partial progress reported through the cookie.
+ */
+static Napi::Error RenderTimeoutError(Napi::Env env, int progress, int progress_max) {
+    Napi::Error error = Napi::Error::New(env, "Rendering timeout exceeded");
+    error.Value().Set("code", Napi::String::New(env, "ETIMEDOUT"));
+    error.Value().Set("progress", Napi::Number::New(env, progress));
+    error.Value().Set("progressMax", Napi::Number::New(env, progress_max));
+    return error;
+}
+
 /**
  * Render page with advanced options
  * Supports anti-aliasing, progress callbacks, timeouts, etc.
  *
+ * A positive timeout renders under an internal cookie that is aborted
+ * when the deadline passes; the thrown error reports the partial progress.
+ *
  * JavaScript: renderPageWithOptions(ctx, page, options): NativePixmap
  *
  * options: {
@@ -380,7 +658,7 @@ Napi::Value SearchText(const Napi::CallbackInfo& info) {
  *   matrix?: NativeMatrix,
  *   colorspace?: NativeColorspace,
  *   alpha?: boolean,
- *   antiAlias?: number (0=None, 1=Low, 2=Medium, 4=High),
+ *   antiAlias?: number (AA bits: 0=None, 2=Low, 4=Medium, 8=High),
  *   timeout?: number,
  *   renderAnnotations?: boolean,
  *   renderFormFields?: boolean
@@ -398,86 +676,51 @@ Napi::Value RenderPageWithOptions(const Napi::CallbackInfo& info) {
     fz_page page = GetPage(info[1].As<Napi::Object>());
     Napi::Object options = info[2].As<Napi::Object>();
 
-    // Extract options
-    fz_matrix matrix;
-    if (options.Has("matrix")) {
-        matrix = GetMatrix(options.Get("matrix").As<Napi::Object>());
-    } else if (options.Has("dpi")) {
-        float dpi = options.Get("dpi").As<Napi::Number>().FloatValue();
-        float scale = dpi / 72.0f;
-        matrix = fz_scale(scale, scale);
-    } else {
-        matrix = fz_identity();
-    }
-
-    // Get colorspace
-    fz_colorspace cs;
-    if (options.Has("colorspace")) {
-        // TODO: Parse colorspace from options
-        cs = fz_device_rgb(ctx);
-    } else {
-        cs = fz_device_rgb(ctx);
-    }
-
-    // Get alpha
-    bool alpha = true;
-    if (options.Has("alpha")) {
-        alpha = options.Get("alpha").As<Napi::Boolean>().Value();
+    RenderParams params;
+    if (!ParseRenderOptions(env, ctx, options, &params)) {
+        return env.Null();
     }
 
-    // Get anti-aliasing level
-    // Note: In a full implementation, this would be passed to the rendering device
-    // For now, we just validate it
-    if (options.Has("antiAlias")) {
-        int aa_level = options.Get("antiAlias").As<Napi::Number>().Int32Value();
-        // Validate: 0 (None), 1 (Low), 2 (Medium), 4 (High)
-        if (aa_level != 0 && aa_level != 1 && aa_level != 2 && aa_level != 4) {
-            Napi::TypeError::New(env, "Invalid antiAlias level (must be 0, 1, 2, or 4)")
-                .ThrowAsJavaScriptException();
-            return env.Null();
-        }
-        // TODO: Use aa_level when creating rendering device
+    // Render page to pixmap, under a deadline if a timeout was given
+    fz_cookie_handle cookie = params.timeout > 0 ? fz_new_cookie(ctx) : 0;
+    fz_pixmap pix;
+    bool timed_out;
+    {
+        RenderDeadline deadline(ctx, cookie, params.timeout);
+        pix = fz_new_pixmap_from_page_with_options(
+            ctx, page, params.matrix, params.cs, params.alpha ? 1 : 0,
+            params.aa_level, params.Flags(), cookie);
+        timed_out = deadline.Finish();
     }
 
-    // Get timeout
-    if (options.Has("timeout")) {
-        int timeout = options.Get("timeout").As<Napi::Number>().Int32Value();
-        // TODO: Implement timeout handling with a cookie
-        if (timeout > 0) {
-            // For now, just validate it
+    if (timed_out) {
+        int progress = fz_cookie_get_progress(ctx, cookie);
+        int progress_max = fz_cookie_get_progress_max(ctx, cookie);
+        fz_drop_cookie(ctx, cookie);
+        if (pix != 0) {
+            fz_drop_pixmap(ctx, pix);
         }
+        RenderTimeoutError(env, progress, progress_max).ThrowAsJavaScriptException();
+        return env.Null();
     }
 
-    // Render flags
-    bool render_annots = true;
-    bool render_forms = true;
-    if (options.Has("renderAnnotations")) {
-        render_annots = options.Get("renderAnnotations").As<Napi::Boolean>().Value();
-    }
-    if (options.Has("renderFormFields")) {
-        render_forms = options.Get("renderFormFields").As<Napi::Boolean>().Value();
+    if (cookie != 0) {
+        fz_drop_cookie(ctx, cookie);
     }
 
-    // Render page to pixmap
-    fz_pixmap pix = fz_new_pixmap_from_page(ctx, page, matrix, cs, alpha ? 1 : 0);
     if (pix == 0) {
         Napi::Error::New(env, "Failed to render page").ThrowAsJavaScriptException();
         return env.Null();
     }
 
-    // Wrap in Napi::External with finalizer
-    return Napi::External<int32_t>::New(
-        env,
-        new int32_t(pix),
-        [](Napi::Env env, int32_t* data) {
-            delete data;
-        }
-    );
+    return PixmapToObject(env, ctx, pix, params.alpha);
 }
 
 /**
  * Render page to PNG with advanced options
  *
+ * A positive timeout aborts the render as in renderPageWithOptions.
+ *
  * JavaScript: renderPageToPNGWithOptions(ctx, page, options): Buffer
  *
  * options: {
@@ -499,23 +742,42 @@ Napi::Value RenderPageToPNGWithOptions(const Napi::CallbackInfo& info) {
     fz_page page = GetPage(info[1].As<Napi::Object>());
     Napi::Object options = info[2].As<Napi::Object>();
 
-    // Extract DPI
-    float dpi = 72.0f;
-    if (options.Has("dpi")) {
-        dpi = options.Get("dpi").As<Napi::Number>().FloatValue();
+    RenderParams params;
+    if (!ParseRenderOptions(env, ctx, options, &params)) {
+        return env.Null();
+    }
+    // PNG output is opaque unless alpha is asked for
+    if (!options.Has("alpha")) {
+        params.alpha = false;
     }
 
-    // Create transform matrix
-    fz_matrix matrix = fz_scale(dpi / 72.0f, dpi / 72.0f);
+    // Render to pixmap, under a deadline if a timeout was given
+    fz_cookie_handle cookie = params.timeout > 0 ? fz_new_cookie(ctx) : 0;
+    fz_pixmap pix;
+    bool timed_out;
+    {
+        RenderDeadline deadline(ctx, cookie, params.timeout);
+        pix = fz_new_pixmap_from_page_with_options(
+            ctx, page, params.matrix, params.cs, params.alpha ? 1 : 0,
+            params.aa_level, params.Flags(), cookie);
+        timed_out = deadline.Finish();
+    }
 
-    // Get colorspace
-    fz_colorspace cs = fz_device_rgb(ctx);
+    if (timed_out) {
+        int progress = fz_cookie_get_progress(ctx, cookie);
+        int progress_max = fz_cookie_get_progress_max(ctx, cookie);
+        fz_drop_cookie(ctx, cookie);
+        if (pix != 0) {
+            fz_drop_pixmap(ctx, pix);
+        }
+        RenderTimeoutError(env, progress, progress_max).ThrowAsJavaScriptException();
+        return env.Null();
+    }
 
-    // Get alpha
-    bool alpha = options.Has("alpha") ? options.Get("alpha").As<Napi::Boolean>().Value() : false;
+    if (cookie != 0) {
+        fz_drop_cookie(ctx, cookie);
+    }
 
-    // Render to pixmap
-    fz_pixmap pix = fz_new_pixmap_from_page(ctx, page, matrix, cs, alpha ? 1 : 0);
     if (pix == 0) {
         Napi::Error::New(env, "Failed to render page").ThrowAsJavaScriptException();
         return env.Null();
@@ -530,38 +792,1474 @@ Napi::Value RenderPageToPNGWithOptions(const Napi::CallbackInfo& info) {
         return env.Null();
     }
 
-    // Get buffer data
-    size_t len;
-    const unsigned char* data = fz_buffer_data(ctx, buf, &len);
+    // Hand the encoded data to Node without copying
+    return WrapBuffer(env, ctx, buf);
+}
 
-    // Create Node.js Buffer
-    Napi::Buffer<char> result = Napi::Buffer<char>::Copy(env, (const char*)data, len);
+// ============================================================================
+// Async Rendering
+// ============================================================================
 
-    fz_drop_buffer(ctx, buf);
+/**
+ * Async worker that rasterizes a page, and optionally encodes it to PNG,
+ * on the libuv thread pool.
+ *
+ * All arguments are extracted on the main thread; Execute() only calls into
+ * the FFI, whose handle stores are internally synchronized. If a cookie is
+ * supplied it is checked before and after each stage, and an aborted cookie
+ * rejects the promise with "Render aborted". A positive timeout aborts the
+ * cookie (an internal one if none was supplied) when the deadline passes and
+ * rejects with "Rendering timeout exceeded".
+ */
+class RenderPageWorker : public Napi::AsyncWorker {
+public:
+    RenderPageWorker(Napi::Env env, fz_context ctx, fz_page page, const RenderParams& params,
+                     bool encode_png, fz_cookie_handle cookie)
+        : Napi::AsyncWorker(env),
+          deferred_(Napi::Promise::Deferred::New(env)),
+          ctx_(ctx), page_(page), params_(params),
+          encode_png_(encode_png), cookie_(cookie), owns_cookie_(false), timeout_(params.timeout),
+          timed_out_(false), progress_(0), progress_max_(0),
+          pix_(0), buf_(0) {
+        if (timeout_ > 0 && cookie_ == 0) {
+            cookie_ = fz_new_cookie(ctx_);
+            owns_cookie_ = true;
+        }
+    }
+
+    ~RenderPageWorker() override {
+        // Set only if the render finished but the promise was never resolved
+        if (pix_ != 0) {
+            fz_drop_pixmap(ctx_, pix_);
+        }
+        if (owns_cookie_) {
+            fz_drop_cookie(ctx_, cookie_);
+        }
+    }
+
+    Napi::Promise GetPromise() { return deferred_.Promise(); }
+
+protected:
+    void Execute() override {
+        if (IsAborted()) {
+            SetError("Render aborted");
+            return;
+        }
+
+        {
+            RenderDeadline deadline(ctx_, cookie_, timeout_);
+            pix_ = fz_new_pixmap_from_page_with_options(
+                ctx_, page_, params_.matrix, params_.cs, params_.alpha ? 1 : 0,
+                params_.aa_level, params_.Flags(), cookie_);
+            timed_out_ = deadline.Finish();
+        }
+
+        if (timed_out_) {
+            progress_ = fz_cookie_get_progress(ctx_, cookie_);
+            progress_max_ = fz_cookie_get_progress_max(ctx_, cookie_);
+            if (pix_ != 0) {
+                fz_drop_pixmap(ctx_, pix_);
+                pix_ = 0;
+            }
+            SetError("Rendering timeout exceeded");
+            return;
+        }
+
+        if (pix_ == 0) {
+            SetError(IsAborted() ? "Render aborted" : "Failed to render page");
+            return;
+        }
 
-    return result;
+        if (IsAborted()) {
+            fz_drop_pixmap(ctx_, pix_);
+            pix_ = 0;
+            SetError("Render aborted");
+            return;
+        }
+
+        if (!encode_png_) {
+            return;
+        }
+
+        buf_ = fz_new_buffer_from_pixmap_as_png(ctx_, pix_, 0);
+        fz_drop_pixmap(ctx_, pix_);
+        pix_ = 0;
+
+        if (buf_ == 0) {
+            SetError("Failed to encode PNG");
+        }
+    }
+
+    void OnOK() override {
+        Napi::Env env = Env();
+
+        if (encode_png_) {
+            deferred_.Resolve(WrapBuffer(env, ctx_, buf_));
+            buf_ = 0;
+            return;
+        }
+
+        Napi::Object obj = PixmapToObject(env, ctx_, pix_, params_.alpha);
+        pix_ = 0;
+        deferred_.Resolve(obj);
+    }
+
+    void OnError(const Napi::Error& error) override {
+        if (timed_out_) {
+            deferred_.Reject(RenderTimeoutError(Env(), progress_, progress_max_).Value());
+            return;
+        }
+        deferred_.Reject(error.Value());
+    }
+
+private:
+    bool IsAborted() const {
+        return cookie_ != 0 && fz_cookie_should_abort(ctx_, cookie_);
+    }
+
+    Napi::Promise::Deferred deferred_;
+    fz_context ctx_;
+    fz_page page_;
+    RenderParams params_;
+    bool encode_png_;
+    fz_cookie_handle cookie_;
+    bool owns_cookie_;
+    int timeout_;
+    bool timed_out_;
+    int progress_;
+    int progress_max_;
+    fz_pixmap pix_;
+    fz_buffer buf_;
+};
+
+/**
+ * Render page to pixmap off the main thread
+ * JavaScript: renderPageAsync(ctx: NativeContext, page: NativePage, matrix: NativeMatrix, colorspace: NativeColorspace, alpha: boolean, cookie?: number): Promise<NativePixmap>
+ */
+Napi::Value RenderPageAsync(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 5) {
+        Napi::TypeError::New(env, "Expected (context, page, matrix, colorspace, alpha, [cookie])").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    fz_context ctx = GetContext(info[0].As<Napi::Object>());
+    fz_page page = GetPage(info[1].As<Napi::Object>());
+    fz_matrix matrix = GetMatrix(info[2].As<Napi::Object>());
+    bool alpha = info[4].As<Napi::Boolean>().Value();
+    fz_cookie_handle cookie = info.Length() > 5 ? GetCookie(info[5]) : 0;
+    fz_colorspace cs = info[3].IsObject() ? GetColorspace(ctx, info[3].As<Napi::Object>()) : fz_device_rgb(ctx);
+
+    RenderPageWorker* worker = new RenderPageWorker(
+        env, ctx, page, DefaultRenderParams(ctx, matrix, cs, alpha), false, cookie);
+    Napi::Promise promise = worker->GetPromise();
+    worker->Queue();
+    return promise;
 }
 
 /**
- * Initialize page exports
+ * Render page to PNG buffer off the main thread
+ * JavaScript: renderPageToPNGAsync(ctx: NativeContext, page: NativePage, dpi: number, colorspace: NativeColorspace, cookie?: number): Promise<Buffer>
  */
-Napi::Object InitPage(Napi::Env env, Napi::Object exports) {
-    // Basic page operations
-    exports.Set("loadPage", Napi::Function::New(env, LoadPage));
-    exports.Set("dropPage", Napi::Function::New(env, DropPage));
-    exports.Set("boundPage", Napi::Function::New(env, BoundPage));
+Napi::Value RenderPageToPNGAsync(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
 
-    // Basic rendering
-    exports.Set("renderPage", Napi::Function::New(env, RenderPage));
-    exports.Set("renderPageToPNG", Napi::Function::New(env, RenderPageToPNG));
+    if (info.Length() < 4) {
+        Napi::TypeError::New(env, "Expected (context, page, dpi, colorspace, [cookie])").ThrowAsJavaScriptException();
+        return env.Null();
+    }
 
-    // Advanced rendering with options
-    exports.Set("renderPageWithOptions", Napi::Function::New(env, RenderPageWithOptions));
-    exports.Set("renderPageToPNGWithOptions", Napi::Function::New(env, RenderPageToPNGWithOptions));
+    fz_context ctx = GetContext(info[0].As<Napi::Object>());
+    fz_page page = GetPage(info[1].As<Napi::Object>());
+    float dpi = info[2].As<Napi::Number>().FloatValue();
+    fz_cookie_handle cookie = info.Length() > 4 ? GetCookie(info[4]) : 0;
+
+    fz_matrix matrix = fz_scale(dpi / 72.0f, dpi / 72.0f);
+    fz_colorspace cs = info[3].IsObject() ? GetColorspace(ctx, info[3].As<Napi::Object>()) : fz_device_rgb(ctx);
+
+    RenderPageWorker* worker = new RenderPageWorker(
+        env, ctx, page, DefaultRenderParams(ctx, matrix, cs, false), true, cookie);
+    Napi::Promise promise = worker->GetPromise();
+    worker->Queue();
+    return promise;
+}
+
+/**
+ * Render page with advanced options off the main thread
+ *
+ * JavaScript: renderPageWithOptionsAsync(ctx, page, options, cookie?): Promise<NativePixmap>
+ *
+ * Accepts the same options as renderPageWithOptions.
+ */
+Napi::Value RenderPageWithOptionsAsync(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 3 || !info[0].IsObject() || !info[1].IsObject() || !info[2].IsObject()) {
+        Napi::TypeError::New(env, "Expected (context, page, options, [cookie])").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    fz_context ctx = GetContext(info[0].As<Napi::Object>());
+    fz_page page = GetPage(info[1].As<Napi::Object>());
+    Napi::Object options = info[2].As<Napi::Object>();
+    fz_cookie_handle cookie = info.Length() > 3 ? GetCookie(info[3]) : 0;
+
+    RenderParams params;
+    if (!ParseRenderOptions(env, ctx, options, &params)) {
+        return env.Null();
+    }
+
+    RenderPageWorker* worker = new RenderPageWorker(
+        env, ctx, page, params, false, cookie);
+    Napi::Promise promise = worker->GetPromise();
+    worker->Queue();
+    return promise;
+}
+
+// ============================================================================
+// Streaming PNG
+// ============================================================================
+
+/** Default band height, in rows, for streamed renders */
+static const int kStreamBandHeight = 64;
+
+/** Encoded chunks that may wait for the consumer before rendering pauses */
+static const int kStreamChunksInFlight = 2;
+
+/**
+ * Flow control between a streaming render thread and its JS consumer
+ *
+ * Shared with the promise handlers attached to each chunk, which may run
+ * after the worker is gone. Only touched from the main thread apart from
+ * the counters, which are guarded by the mutex.
+ */
+struct StreamGate {
+    std::mutex mutex;
+    std::condition_variable cv;
+    int pending = 0;
+    bool failed = false;
+    Napi::Reference<Napi::Value> error;
+
+    void Ack(const Napi::Value* rejection) {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending--;
+        if (rejection != nullptr && !failed) {
+            failed = true;
+            error = Napi::Persistent(*rejection);
+        }
+        cv.notify_all();
+    }
+};
+
+/**
+ * Async worker that renders a page band by band and streams it as PNG
+ *
+ * Each band is rendered from the page's cached display list, deflated as
+ * an IDAT chunk and handed to the JS callback before the next band is
+ * drawn, so peak memory is one band of pixels plus one chunk in flight
+ * rather than the whole page. If the callback returns a promise, the
+ * chunk counts as consumed once it settles; a rejection or a throw aborts
+ * the render. Resolves with the number of bytes produced.
+ */
+class RenderPageStreamWorker : public Napi::AsyncProgressQueueWorker<fz_buffer> {
+public:
+    RenderPageStreamWorker(Napi::Env env, fz_context ctx, fz_page page, const RenderParams& params,
+                           int band_height, fz_cookie_handle user_cookie,
+                           const Napi::Function& callback)
+        : Napi::AsyncProgressQueueWorker<fz_buffer>(env),
+          deferred_(Napi::Promise::Deferred::New(env)),
+          callback_(Napi::Persistent(callback)),
+          gate_(std::make_shared<StreamGate>()),
+          ctx_(ctx), page_(page), params_(params), band_height_(band_height),
+          user_cookie_(user_cookie), cookie_(fz_new_cookie(ctx)), timed_out_(false),
+          bytes_(0), progress_(0), progress_max_(0) {}
+
+    ~RenderPageStreamWorker() override {
+        fz_drop_cookie(ctx_, cookie_);
+    }
+
+    Napi::Promise GetPromise() { return deferred_.Promise(); }
+
+protected:
+    void Execute(const ExecutionProgress& progress) override {
+        fz_irect bbox = fz_round_rect(fz_transform_rect(fz_bound_page(ctx_, page_), params_.matrix));
+        int w = bbox.x1 - bbox.x0;
+        int h = bbox.y1 - bbox.y0;
+        if (w <= 0 || h <= 0) {
+            SetError("Failed to render page");
+            return;
+        }
+
+        int n = fz_colorspace_n(ctx_, params_.cs);
+        fz_band_writer writer = fz_new_band_writer_with_config(
+            ctx_, 0, FZ_BAND_FORMAT_PNG, w, h, n, params_.alpha ? 1 : 0);
+        fz_band_writer_set_rows_per_band(ctx_, writer, band_height_);
+
+        RenderDeadline deadline(ctx_, cookie_, params_.timeout);
+        const char* error = Stream(writer, w, h, progress);
+        WaitForConsumer(0);
+        timed_out_ = deadline.Finish();
+        fz_drop_band_writer(ctx_, writer);
+
+        if (timed_out_) {
+            progress_ = fz_cookie_get_progress(ctx_, cookie_);
+            progress_max_ = fz_cookie_get_progress_max(ctx_, cookie_);
+            SetError("Rendering timeout exceeded");
+        } else if (IsAborted()) {
+            SetError("Render aborted");
+        } else if (error != nullptr) {
+            SetError(error);
+        }
+    }
+
+    void OnProgress(const fz_buffer* data, size_t count) override {
+        Napi::Env env = Env();
+        Napi::HandleScope scope(env);
+
+        for (size_t i = 0; i < count; i++) {
+            if (!callback_error_.IsEmpty() || fz_cookie_should_abort(ctx_, cookie_)) {
+                // The stream is being torn down; release what is still queued
+                fz_drop_buffer(ctx_, data[i]);
+                gate_->Ack(nullptr);
+                continue;
+            }
+
+            Napi::Buffer<uint8_t> chunk = WrapBuffer(env, ctx_, data[i]);
+            bytes_ += chunk.Length();
+
+            Napi::Value result = callback_.Call({chunk});
+            if (env.IsExceptionPending()) {
+                callback_error_ = Napi::Persistent(env.GetAndClearPendingException().Value());
+                fz_cookie_abort(ctx_, cookie_);
+                gate_->Ack(nullptr);
+                continue;
+            }
+
+            if (result.IsPromise()) {
+                std::shared_ptr<StreamGate> gate = gate_;
+                Napi::Function on_settled = Napi::Function::New(env,
+                    [gate](const Napi::CallbackInfo&) { gate->Ack(nullptr); });
+                Napi::Function on_rejected = Napi::Function::New(env,
+                    [gate](const Napi::CallbackInfo& info) {
+                        Napi::Value reason = info[0];
+                        gate->Ack(&reason);
+                    });
+                Napi::Object promise = result.As<Napi::Object>();
+                promise.Get("then").As<Napi::Function>().Call(promise, {on_settled, on_rejected});
+            } else {
+                gate_->Ack(nullptr);
+            }
+        }
+    }
+
+    void OnOK() override {
+        Napi::Value error = ConsumerError();
+        if (!error.IsEmpty()) {
+            deferred_.Reject(error);
+            return;
+        }
+        deferred_.Resolve(Napi::Number::New(Env(), static_cast<double>(bytes_)));
+    }
+
+    void OnError(const Napi::Error& error) override {
+        Napi::Value consumer_error = ConsumerError();
+        if (!consumer_error.IsEmpty()) {
+            deferred_.Reject(consumer_error);
+        } else if (timed_out_) {
+            deferred_.Reject(RenderTimeoutError(Env(), progress_, progress_max_).Value());
+        } else {
+            deferred_.Reject(error.Value());
+        }
+    }
+
+private:
+    bool IsAborted() const {
+        if (user_cookie_ != 0 && fz_cookie_should_abort(ctx_, user_cookie_)) {
+            fz_cookie_abort(ctx_, cookie_);
+        }
+        return fz_cookie_should_abort(ctx_, cookie_) != 0;
+    }
+
+    /** The first error thrown or rejected by the callback, if any */
+    Napi::Value ConsumerError() {
+        if (!callback_error_.IsEmpty()) {
+            return callback_error_.Value();
+        }
+        std::lock_guard<std::mutex> lock(gate_->mutex);
+        if (!gate_->error.IsEmpty()) {
+            return gate_->error.Value();
+        }
+        return Napi::Value();
+    }
+
+    /**
+     * Render and encode every band, sending chunks as they are produced
+     * Returns an error message, or nullptr on success or abort.
+     */
+    const char* Stream(fz_band_writer writer, int w, int h, const ExecutionProgress& progress) {
+        if (!fz_band_writer_write_header(ctx_, writer)) {
+            return "PNG streaming supports gray and RGB colorspaces only";
+        }
+        Send(writer, progress);
+
+        std::vector<unsigned char> rows;
+        for (int y = 0; y < h; y += band_height_) {
+            if (IsAborted()) {
+                return nullptr;
+            }
+            fz_pixmap pix = fz_new_pixmap_from_page_band(
+                ctx_, page_, params_.matrix, params_.cs, params_.alpha ? 1 : 0,
+                params_.aa_level, params_.Flags(), y, band_height_, cookie_);
+            if (pix == 0) {
+                return IsAborted() ? nullptr : "Failed to render page";
+            }
+
+            int band_rows = fz_pixmap_height(ctx_, pix);
+            size_t row_size = static_cast<size_t>(w) * fz_pixmap_components(ctx_, pix);
+            size_t stride = fz_pixmap_stride(ctx_, pix);
+            const unsigned char* samples = fz_pixmap_samples(ctx_, pix);
+            if (stride != row_size && samples != nullptr) {
+                rows.resize(row_size * band_rows);
+                for (int r = 0; r < band_rows; r++) {
+                    std::copy(samples + r * stride, samples + r * stride + row_size,
+                              rows.begin() + r * row_size);
+                }
+                samples = rows.data();
+            }
+
+            int ok = samples != nullptr &&
+                     fz_band_writer_write_band(ctx_, writer, band_rows, samples);
+            fz_drop_pixmap(ctx_, pix);
+            if (!ok) {
+                return "Failed to encode PNG";
+            }
+            Send(writer, progress);
+        }
+
+        if (!fz_band_writer_write_trailer(ctx_, writer)) {
+            return "Failed to encode PNG";
+        }
+        Send(writer, progress);
+        return nullptr;
+    }
+
+    /** Hand the writer's pending output to the main thread */
+    void Send(fz_band_writer writer, const ExecutionProgress& progress) {
+        WaitForConsumer(kStreamChunksInFlight - 1);
+        if (IsAborted()) {
+            return;
+        }
+        fz_buffer buf = fz_band_writer_take_output(ctx_, writer);
+        if (buf == 0) {
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(gate_->mutex);
+            gate_->pending++;
+        }
+        progress.Send(&buf, 1);
+    }
+
+    /** Block until at most `limit` chunks are unconsumed, or the render stops */
+    void WaitForConsumer(int limit) {
+        std::unique_lock<std::mutex> lock(gate_->mutex);
+        while (gate_->pending > limit) {
+            if (gate_->failed) {
+                fz_cookie_abort(ctx_, cookie_);
+            }
+            if (fz_cookie_should_abort(ctx_, cookie_) ||
+                (user_cookie_ != 0 && fz_cookie_should_abort(ctx_, user_cookie_))) {
+                return;
+            }
+            gate_->cv.wait_for(lock, std::chrono::milliseconds(20));
+        }
+        if (gate_->failed) {
+            fz_cookie_abort(ctx_, cookie_);
+        }
+    }
+
+    Napi::Promise::Deferred deferred_;
+    Napi::FunctionReference callback_;
+    Napi::ObjectReference callback_error_;
+    std::shared_ptr<StreamGate> gate_;
+    fz_context ctx_;
+    fz_page page_;
+    RenderParams params_;
+    int band_height_;
+    fz_cookie_handle user_cookie_;
+    fz_cookie_handle cookie_;
+    bool timed_out_;
+    size_t bytes_;
+    int progress_;
+    int progress_max_;
+};
+
+/**
+ * Render a page to PNG incrementally, band by band
+ *
+ * JavaScript: renderPageToPNGStream(ctx, page, options, onChunk, cookie?): Promise<number>
+ *
+ * Accepts the same options as renderPageWithOptions plus `bandHeight`
+ * (rows per band, default 64). onChunk receives each encoded Buffer in
+ * order; returning a promise holds back later chunks until it settles.
+ * Resolves with the total number of bytes produced.
+ */
+Napi::Value RenderPageToPNGStream(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 4 || !info[0].IsObject() || !info[1].IsObject() || !info[2].IsObject() ||
+        !info[3].IsFunction()) {
+        Napi::TypeError::New(env, "Expected (context, page, options, onChunk, [cookie])").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    fz_context ctx = GetContext(info[0].As<Napi::Object>());
+    fz_page page = GetPage(info[1].As<Napi::Object>());
+    Napi::Object options = info[2].As<Napi::Object>();
+    fz_cookie_handle cookie = info.Length() > 4 ? GetCookie(info[4]) : 0;
+
+    RenderParams params;
+    if (!ParseRenderOptions(env, ctx, options, &params)) {
+        return env.Null();
+    }
+
+    int band_height = kStreamBandHeight;
+    if (options.Has("bandHeight") && options.Get("bandHeight").IsNumber()) {
+        band_height = options.Get("bandHeight").As<Napi::Number>().Int32Value();
+    }
+    if (band_height < 1) {
+        Napi::RangeError::New(env, "bandHeight must be a positive number of rows").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    RenderPageStreamWorker* worker = new RenderPageStreamWorker(
+        env, ctx, page, params, band_height, cookie, info[3].As<Napi::Function>());
+    Napi::Promise promise = worker->GetPromise();
+    worker->Queue();
+    return promise;
+}
+
+// ============================================================================
+// Batch Rendering
+// ============================================================================
+
+/**
+ * One page produced by a batch render, handed from a render thread to the
+ * main thread. Exactly one of pix/buf is set on success; error is a static
+ * message when the page failed.
+ */
+struct BatchPageResult {
+    int page;
+    int width;
+    int height;
+    fz_pixmap pix;
+    fz_buffer buf;
+    const char* error;
+};
+
+/**
+ * Async worker that renders a page range on several threads and streams
+ * each page to a JS callback as soon as it is ready.
+ *
+ * Pages are claimed from a shared counter, so results arrive in completion
+ * order; each carries its page number. All threads render under one batch
+ * cookie: a caller cookie, a timeout, or a throwing callback aborts it and
+ * the remaining pages are skipped. A page that fails to load or render is
+ * reported to the callback with an error and does not stop the batch.
+ * Each thread works under its own fz_clone_context of the caller's context.
+ */
+class RenderPagesWorker : public Napi::AsyncProgressQueueWorker<BatchPageResult> {
+public:
+    RenderPagesWorker(Napi::Env env, fz_context ctx, fz_document doc, int start, int end,
+                      const RenderParams& params, bool encode_png, int concurrency,
+                      fz_cookie_handle user_cookie, const Napi::Function& callback)
+        : Napi::AsyncProgressQueueWorker<BatchPageResult>(env),
+          deferred_(Napi::Promise::Deferred::New(env)),
+          callback_(Napi::Persistent(callback)),
+          ctx_(ctx), doc_(doc), start_(start), end_(end), params_(params),
+          encode_png_(encode_png), concurrency_(concurrency), user_cookie_(user_cookie),
+          cookie_(fz_new_cookie(ctx)), timed_out_(false), rendered_(0),
+          progress_(0), progress_max_(0) {}
+
+    ~RenderPagesWorker() override {
+        fz_drop_cookie(ctx_, cookie_);
+    }
+
+    Napi::Promise GetPromise() { return deferred_.Promise(); }
+
+protected:
+    void Execute(const ExecutionProgress& progress) override {
+        std::atomic<int> next(start_);
+        std::mutex send_mutex;
+        int pages = end_ - start_;
+        int threads = std::max(1, std::min(concurrency_, pages));
+
+        std::atomic<bool> no_context(false);
+        RenderDeadline deadline(ctx_, cookie_, params_.timeout);
+        auto run = [&]() {
+            // Each thread renders under its own clone of the context
+            fz_context ctx = fz_clone_context(ctx_);
+            if (ctx == 0) {
+                no_context = true;
+                return;
+            }
+            for (;;) {
+                if (IsAborted(ctx)) {
+                    break;
+                }
+                int n = next.fetch_add(1);
+                if (n >= end_) {
+                    break;
+                }
+                BatchPageResult result = RenderOne(ctx, n);
+                if (result.error == nullptr && IsAborted(ctx)) {
+                    DropResult(ctx, result);
+                    break;
+                }
+                std::lock_guard<std::mutex> lock(send_mutex);
+                progress.Send(&result, 1);
+            }
+            fz_drop_context(ctx);
+        };
+
+        std::vector<std::thread> pool;
+        for (int i = 1; i < threads; i++) {
+            pool.emplace_back(run);
+        }
+        run();
+        for (std::thread& t : pool) {
+            t.join();
+        }
+        timed_out_ = deadline.Finish();
+
+        if (timed_out_) {
+            progress_ = fz_cookie_get_progress(ctx_, cookie_);
+            progress_max_ = fz_cookie_get_progress_max(ctx_, cookie_);
+            SetError("Rendering timeout exceeded");
+        } else if (IsAborted(ctx_)) {
+            SetError("Render aborted");
+        } else if (no_context && next.load() < end_) {
+            // No thread got a context to render the rest with
+            SetError("Failed to clone context");
+        }
+    }
+
+    void OnProgress(const BatchPageResult* data, size_t count) override {
+        Napi::Env env = Env();
+        Napi::HandleScope scope(env);
+
+        for (size_t i = 0; i < count; i++) {
+            const BatchPageResult& r = data[i];
+            if (!callback_error_.IsEmpty() || fz_cookie_should_abort(ctx_, cookie_)) {
+                // The batch is being torn down; release what is still queued
+                DropResult(ctx_, r);
+                continue;
+            }
+
+            Napi::Object obj = Napi::Object::New(env);
+            obj.Set("page", Napi::Number::New(env, r.page));
+            if (r.error != nullptr) {
+                obj.Set("error", Napi::String::New(env, r.error));
+            } else {
+                obj.Set("width", Napi::Number::New(env, r.width));
+                obj.Set("height", Napi::Number::New(env, r.height));
+                if (r.buf != 0) {
+                    obj.Set("png", WrapBuffer(env, ctx_, r.buf));
+                } else {
+                    Napi::Object pix = Napi::Object::New(env);
+                    pix.Set("_handle", HandleToValue(env, r.pix));
+                    pix.Set("width", Napi::Number::New(env, r.width));
+                    pix.Set("height", Napi::Number::New(env, r.height));
+                    obj.Set("pixmap", pix);
+                }
+                rendered_++;
+            }
+
+            callback_.Call({obj});
+            if (env.IsExceptionPending()) {
+                callback_error_ = Napi::Persistent(env.GetAndClearPendingException().Value());
+                fz_cookie_abort(ctx_, cookie_);
+            }
+        }
+    }
+
+    void OnOK() override {
+        if (!callback_error_.IsEmpty()) {
+            deferred_.Reject(callback_error_.Value());
+            return;
+        }
+        deferred_.Resolve(Napi::Number::New(Env(), rendered_));
+    }
+
+    void OnError(const Napi::Error& error) override {
+        if (!callback_error_.IsEmpty()) {
+            deferred_.Reject(callback_error_.Value());
+        } else if (timed_out_) {
+            deferred_.Reject(RenderTimeoutError(Env(), progress_, progress_max_).Value());
+        } else {
+            deferred_.Reject(error.Value());
+        }
+    }
+
+private:
+    bool IsAborted(fz_context ctx) const {
+        if (user_cookie_ != 0 && fz_cookie_should_abort(ctx, user_cookie_)) {
+            fz_cookie_abort(ctx, cookie_);
+        }
+        return fz_cookie_should_abort(ctx, cookie_) != 0;
+    }
+
+    BatchPageResult RenderOne(fz_context ctx, int n) const {
+        BatchPageResult r = {n, 0, 0, 0, 0, nullptr};
+
+        fz_page page = fz_load_page(ctx, doc_, n);
+        if (page == 0) {
+            r.error = "Failed to load page";
+            return r;
+        }
+        r.pix = fz_new_pixmap_from_page_with_options(
+            ctx, page, params_.matrix, params_.cs, params_.alpha ? 1 : 0,
+            params_.aa_level, params_.Flags(), cookie_);
+        fz_drop_page(ctx, page);
+
+        if (r.pix == 0) {
+            r.error = "Failed to render page";
+            return r;
+        }
+        r.width = fz_pixmap_width(ctx, r.pix);
+        r.height = fz_pixmap_height(ctx, r.pix);
+
+        if (encode_png_) {
+            r.buf = fz_new_buffer_from_pixmap_as_png(ctx, r.pix, 0);
+            fz_drop_pixmap(ctx, r.pix);
+            r.pix = 0;
+            if (r.buf == 0) {
+                r.error = "Failed to encode PNG";
+            }
+        }
+        return r;
+    }
+
+    void DropResult(fz_context ctx, const BatchPageResult& r) const {
+        if (r.pix != 0) {
+            fz_drop_pixmap(ctx, r.pix);
+        }
+        if (r.buf != 0) {
+            fz_drop_buffer(ctx, r.buf);
+        }
+    }
+
+    Napi::Promise::Deferred deferred_;
+    Napi::FunctionReference callback_;
+    Napi::ObjectReference callback_error_;
+    fz_context ctx_;
+    fz_document doc_;
+    int start_;
+    int end_;
+    RenderParams params_;
+    bool encode_png_;
+    int concurrency_;
+    fz_cookie_handle user_cookie_;
+    fz_cookie_handle cookie_;
+    bool timed_out_;
+    int rendered_;
+    int progress_;
+    int progress_max_;
+};
+
+/**
+ * Render a range of pages natively and in parallel
+ *
+ * JavaScript: renderPages(ctx, doc, range, options, onPage, cookie?): Promise<number>
+ *
+ * range: { start?: number, end?: number } (end exclusive, defaults to the page count)
+ * options: the renderPageWithOptions options, plus
+ *   format?: 'png' | 'pixmap' (default 'png'),
+ *   concurrency?: number (default: hardware threads)
+ *   timeout applies to the whole batch.
+ * onPage: called on the main thread for every page, in completion order, with
+ *   { page, width, height, png?: Buffer, pixmap?: NativePixmap } or { page, error }
+ *
+ * Resolves with the number of pages rendered.
+ */
+Napi::Value RenderPages(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 5 || !info[0].IsObject() || !info[1].IsObject() || !info[2].IsObject() ||
+        !info[3].IsObject() || !info[4].IsFunction()) {
+        Napi::TypeError::New(env, "Expected (context, document, range, options, onPage, [cookie])")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    fz_context ctx = GetContext(info[0].As<Napi::Object>());
+    fz_document doc = GetDocument(info[1].As<Napi::Object>());
+    Napi::Object range = info[2].As<Napi::Object>();
+    Napi::Object options = info[3].As<Napi::Object>();
+    fz_cookie_handle cookie = info.Length() > 5 ? GetCookie(info[5]) : 0;
+
+    int count = fz_count_pages(ctx, doc);
+    int start = range.Has("start") ? range.Get("start").As<Napi::Number>().Int32Value() : 0;
+    int end = range.Has("end") ? range.Get("end").As<Napi::Number>().Int32Value() : count;
+    if (start < 0 || end < start || end > count) {
+        Napi::RangeError::New(env, "Invalid page range").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    RenderParams params;
+    if (!ParseRenderOptions(env, ctx, options, &params)) {
+        return env.Null();
+    }
+
+    bool encode_png = true;
+    if (options.Has("format")) {
+        std::string format = options.Get("format").As<Napi::String>().Utf8Value();
+        if (format != "png" && format != "pixmap") {
+            Napi::TypeError::New(env, "Invalid format (must be 'png' or 'pixmap')")
+                .ThrowAsJavaScriptException();
+            return env.Null();
+        }
+        encode_png = format == "png";
+    }
+    if (encode_png && !options.Has("alpha")) {
+        params.alpha = false;
+    }
+
+    int concurrency = static_cast<int>(std::thread::hardware_concurrency());
+    if (options.Has("concurrency")) {
+        concurrency = options.Get("concurrency").As<Napi::Number>().Int32Value();
+    }
+    if (concurrency < 1) {
+        concurrency = 1;
+    }
+
+    RenderPagesWorker* worker = new RenderPagesWorker(
+        env, ctx, doc, start, end, params, encode_png, concurrency, cookie,
+        info[4].As<Napi::Function>());
+    Napi::Promise promise = worker->GetPromise();
+    worker->Queue();
+    return promise;
+}
+
+/**
+ * Helper: Extract a render pool handle from a pool object
+ */
+static fz_render_pool GetRenderPool(const Napi::Object& obj) {
+    return HandleFromValue(obj.Get("_handle"));
+}
+
+/**
+ * Create a render pool of worker threads, each on its own cloned context
+ * JavaScript: createRenderPool(ctx: NativeContext, threads?: number): NativeRenderPool
+ *
+ * threads defaults to one per CPU.
+ */
+Napi::Value CreateRenderPool(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 1 || !info[0].IsObject()) {
+        Napi::TypeError::New(env, "Expected context object").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    fz_context ctx = GetContext(info[0].As<Napi::Object>());
+    int threads = info.Length() > 1 && info[1].IsNumber() ? info[1].As<Napi::Number>().Int32Value() : 0;
+
+    fz_render_pool pool = fz_new_render_pool(ctx, threads);
+    if (pool == 0) {
+        Napi::Error::New(env, "Failed to create render pool").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    Napi::Object obj = Napi::Object::New(env);
+    obj.Set("_handle", HandleToValue(env, pool));
+    obj.Set("threads", Napi::Number::New(env, fz_render_pool_threads(ctx, pool)));
+    return obj;
+}
+
+/**
+ * Shut down a render pool, cancelling outstanding jobs
+ * JavaScript: dropRenderPool(ctx: NativeContext, pool: NativeRenderPool): void
+ */
+Napi::Value DropRenderPool(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2 || !info[0].IsObject() || !info[1].IsObject()) {
+        Napi::TypeError::New(env, "Expected (context, pool)").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    fz_drop_render_pool(GetContext(info[0].As<Napi::Object>()), GetRenderPool(info[1].As<Napi::Object>()));
+    return env.Undefined();
+}
+
+/**
+ * Queue a page on a render pool
+ * JavaScript: renderPoolSubmit(ctx: NativeContext, pool: NativeRenderPool, doc: NativeDocument,
+ *                              pageNum: number, options?: NativeRenderOptions): number
+ *
+ * Returns a job id for renderPoolWait/renderPoolCancel. The timeout option
+ * is not used here; cancel the job instead.
+ */
+Napi::Value RenderPoolSubmit(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 4 || !info[0].IsObject() || !info[1].IsObject() || !info[2].IsObject() ||
+        !info[3].IsNumber()) {
+        Napi::TypeError::New(env, "Expected (context, pool, document, pageNum, [options])")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    fz_context ctx = GetContext(info[0].As<Napi::Object>());
+    fz_render_pool pool = GetRenderPool(info[1].As<Napi::Object>());
+    fz_document doc = GetDocument(info[2].As<Napi::Object>());
+    int page_number = info[3].As<Napi::Number>().Int32Value();
+
+    RenderParams params;
+    if (info.Length() > 4 && info[4].IsObject()) {
+        if (!ParseRenderOptions(env, ctx, info[4].As<Napi::Object>(), &params)) {
+            return env.Null();
+        }
+    } else {
+        params = DefaultRenderParams(ctx, fz_identity(), fz_device_rgb(ctx), true);
+    }
+
+    uint64_t job = fz_render_pool_submit(
+        ctx, pool, doc, page_number, params.matrix, params.cs, params.alpha ? 1 : 0,
+        params.aa_level, params.Flags());
+    if (job == 0) {
+        Napi::Error::New(env, "Failed to submit render job").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+    return Napi::Number::New(env, static_cast<double>(job));
+}
+
+/**
+ * Cancel a render pool job
+ * JavaScript: renderPoolCancel(ctx: NativeContext, pool: NativeRenderPool, job: number): boolean
+ */
+Napi::Value RenderPoolCancel(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 3 || !info[0].IsObject() || !info[1].IsObject() || !info[2].IsNumber()) {
+        Napi::TypeError::New(env, "Expected (context, pool, job)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    uint64_t job = static_cast<uint64_t>(info[2].As<Napi::Number>().Int64Value());
+    int cancelled = fz_render_pool_cancel(
+        GetContext(info[0].As<Napi::Object>()), GetRenderPool(info[1].As<Napi::Object>()), job);
+    return Napi::Boolean::New(env, cancelled != 0);
+}
+
+/**
+ * Waits for a render pool job off the main thread
+ */
+class RenderPoolWaitWorker : public Napi::AsyncWorker {
+public:
+    RenderPoolWaitWorker(Napi::Env env, fz_context ctx, fz_render_pool pool, uint64_t job)
+        : Napi::AsyncWorker(env),
+          deferred_(Napi::Promise::Deferred::New(env)),
+          ctx_(ctx), pool_(pool), job_(job), pix_(0), width_(0), height_(0) {}
+
+    Napi::Promise GetPromise() { return deferred_.Promise(); }
+
+protected:
+    void Execute() override {
+        pix_ = fz_render_pool_wait(ctx_, pool_, job_);
+        if (pix_ == 0) {
+            SetError("Render job failed or was cancelled");
+            return;
+        }
+        width_ = fz_pixmap_width(ctx_, pix_);
+        height_ = fz_pixmap_height(ctx_, pix_);
+    }
+
+    void OnOK() override {
+        Napi::Env env = Env();
+        Napi::Object obj = Napi::Object::New(env);
+        obj.Set("_handle", HandleToValue(env, pix_));
+        obj.Set("width", Napi::Number::New(env, width_));
+        obj.Set("height", Napi::Number::New(env, height_));
+        deferred_.Resolve(obj);
+    }
+
+    void OnError(const Napi::Error& error) override {
+        deferred_.Reject(error.Value());
+    }
+
+private:
+    Napi::Promise::Deferred deferred_;
+    fz_context ctx_;
+    fz_render_pool pool_;
+    uint64_t job_;
+    fz_pixmap pix_;
+    int width_;
+    int height_;
+};
+
+/**
+ * Wait for a render pool job and take ownership of its pixmap
+ * JavaScript: renderPoolWait(ctx: NativeContext, pool: NativeRenderPool, job: number): Promise<NativePixmap>
+ */
+Napi::Value RenderPoolWait(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 3 || !info[0].IsObject() || !info[1].IsObject() || !info[2].IsNumber()) {
+        Napi::TypeError::New(env, "Expected (context, pool, job)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    RenderPoolWaitWorker* worker = new RenderPoolWaitWorker(
+        env, GetContext(info[0].As<Napi::Object>()), GetRenderPool(info[1].As<Napi::Object>()),
+        static_cast<uint64_t>(info[2].As<Napi::Number>().Int64Value()));
+    Napi::Promise promise = worker->GetPromise();
+    worker->Queue();
+    return promise;
+}
+
+/**
+ * Renders whole-document thumbnails off the main thread
+ */
+class RenderThumbnailsWorker : public Napi::AsyncWorker {
+public:
+    enum Format { kSheetPNG, kSheetPixmap, kJPEG };
+
+    RenderThumbnailsWorker(Napi::Env env, fz_context ctx, fz_document doc, int max_size,
+                           bool gray, Format format, int columns, int quality, int threads)
+        : Napi::AsyncWorker(env),
+          deferred_(Napi::Promise::Deferred::New(env)),
+          ctx_(ctx), doc_(doc), max_size_(max_size), gray_(gray), format_(format),
+          columns_(columns), quality_(quality), threads_(threads),
+          pix_(0), buf_(0), width_(0), height_(0) {}
+
+    ~RenderThumbnailsWorker() override {
+        for (fz_buffer buf : jpegs_) {
+            if (buf != 0) {
+                fz_drop_buffer(ctx_, buf);
+            }
+        }
+    }
+
+    Napi::Promise GetPromise() { return deferred_.Promise(); }
+
+protected:
+    void Execute() override {
+        int count = fz_count_pages(ctx_, doc_);
+        if (count <= 0) {
+            SetError("Document has no pages");
+            return;
+        }
+        fz_colorspace cs = gray_ ? fz_device_gray(ctx_) : fz_device_rgb(ctx_);
+
+        if (format_ == kJPEG) {
+            jpegs_.assign(count, 0);
+            if (fz_new_thumbnail_jpegs(ctx_, doc_, max_size_, cs, quality_, threads_,
+                                       jpegs_.data(), count) < 0) {
+                SetError("Failed to render thumbnails");
+            }
+            return;
+        }
+
+        rects_.assign(count, fz_irect{0, 0, 0, 0});
+        pix_ = fz_new_thumbnail_sheet(ctx_, doc_, max_size_, cs, columns_, threads_,
+                                      rects_.data(), count);
+        if (pix_ == 0) {
+            SetError("Failed to render thumbnails");
+            return;
+        }
+        width_ = fz_pixmap_width(ctx_, pix_);
+        height_ = fz_pixmap_height(ctx_, pix_);
+
+        if (format_ == kSheetPNG) {
+            buf_ = fz_new_buffer_from_pixmap_as_png(ctx_, pix_, 0);
+            fz_drop_pixmap(ctx_, pix_);
+            pix_ = 0;
+            if (buf_ == 0) {
+                SetError("Failed to encode PNG");
+            }
+        }
+    }
+
+    void OnOK() override {
+        Napi::Env env = Env();
+        Napi::Object obj = Napi::Object::New(env);
+
+        if (format_ == kJPEG) {
+            Napi::Array jpegs = Napi::Array::New(env, jpegs_.size());
+            for (size_t i = 0; i < jpegs_.size(); i++) {
+                if (jpegs_[i] != 0) {
+                    jpegs.Set(static_cast<uint32_t>(i), WrapBuffer(env, ctx_, jpegs_[i]));
+                    jpegs_[i] = 0;
+                } else {
+                    jpegs.Set(static_cast<uint32_t>(i), env.Null());
+                }
+            }
+            obj.Set("jpegs", jpegs);
+            deferred_.Resolve(obj);
+            return;
+        }
+
+        obj.Set("width", Napi::Number::New(env, width_));
+        obj.Set("height", Napi::Number::New(env, height_));
+        if (buf_ != 0) {
+            obj.Set("png", WrapBuffer(env, ctx_, buf_));
+            buf_ = 0;
+        } else {
+            Napi::Object pix = Napi::Object::New(env);
+            pix.Set("_handle", HandleToValue(env, pix_));
+            pix.Set("width", Napi::Number::New(env, width_));
+            pix.Set("height", Napi::Number::New(env, height_));
+            obj.Set("pixmap", pix);
+        }
+
+        Napi::Array rects = Napi::Array::New(env, rects_.size());
+        for (size_t i = 0; i < rects_.size(); i++) {
+            Napi::Object r = Napi::Object::New(env);
+            r.Set("x0", Napi::Number::New(env, rects_[i].x0));
+            r.Set("y0", Napi::Number::New(env, rects_[i].y0));
+            r.Set("x1", Napi::Number::New(env, rects_[i].x1));
+            r.Set("y1", Napi::Number::New(env, rects_[i].y1));
+            rects.Set(static_cast<uint32_t>(i), r);
+        }
+        obj.Set("rects", rects);
+        deferred_.Resolve(obj);
+    }
+
+    void OnError(const Napi::Error& error) override {
+        deferred_.Reject(error.Value());
+    }
+
+private:
+    Napi::Promise::Deferred deferred_;
+    fz_context ctx_;
+    fz_document doc_;
+    int max_size_;
+    bool gray_;
+    Format format_;
+    int columns_;
+    int quality_;
+    int threads_;
+    fz_pixmap pix_;
+    fz_buffer buf_;
+    int width_;
+    int height_;
+    std::vector<fz_irect> rects_;
+    std::vector<fz_buffer> jpegs_;
+};
+
+/**
+ * Render thumbnails of every page in one call
+ *
+ * JavaScript: renderThumbnails(ctx, doc, options): Promise<NativeThumbnails>
+ *
+ * options: {
+ *   maxSize: number (longest edge of each thumbnail in pixels),
+ *   gray?: boolean (default false, RGB),
+ *   format?: 'png' | 'pixmap' | 'jpeg' (default 'png'),
+ *   columns?: number (sprite sheet width in cells, default near-square),
+ *   quality?: number (JPEG quality, default 75),
+ *   concurrency?: number (default: hardware threads)
+ * }
+ *
+ * 'png' and 'pixmap' resolve with one sprite sheet,
+ * { width, height, png?: Buffer, pixmap?: NativePixmap, rects: [{ x0, y0, x1, y1 }] },
+ * with one rect per page (empty for pages that failed). 'jpeg' resolves with
+ * { jpegs: Array<Buffer | null> }, one per page.
+ */
+Napi::Value RenderThumbnails(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 3 || !info[0].IsObject() || !info[1].IsObject() || !info[2].IsObject()) {
+        Napi::TypeError::New(env, "Expected (context, document, options)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    fz_context ctx = GetContext(info[0].As<Napi::Object>());
+    fz_document doc = GetDocument(info[1].As<Napi::Object>());
+    Napi::Object options = info[2].As<Napi::Object>();
+
+    int max_size = options.Has("maxSize") ? options.Get("maxSize").As<Napi::Number>().Int32Value() : 0;
+    if (max_size <= 0) {
+        Napi::RangeError::New(env, "maxSize must be a positive number").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    RenderThumbnailsWorker::Format format = RenderThumbnailsWorker::kSheetPNG;
+    if (options.Has("format")) {
+        std::string name = options.Get("format").As<Napi::String>().Utf8Value();
+        if (name == "pixmap") {
+            format = RenderThumbnailsWorker::kSheetPixmap;
+        } else if (name == "jpeg") {
+            format = RenderThumbnailsWorker::kJPEG;
+        } else if (name != "png") {
+            Napi::TypeError::New(env, "Invalid format (must be 'png', 'pixmap' or 'jpeg')")
+                .ThrowAsJavaScriptException();
+            return env.Null();
+        }
+    }
+
+    bool gray = options.Has("gray") && options.Get("gray").ToBoolean().Value();
+    int columns = options.Has("columns") ? options.Get("columns").As<Napi::Number>().Int32Value() : 0;
+    int quality = options.Has("quality") ? options.Get("quality").As<Napi::Number>().Int32Value() : 0;
+    int concurrency = options.Has("concurrency")
+        ? options.Get("concurrency").As<Napi::Number>().Int32Value()
+        : 0;
+
+    RenderThumbnailsWorker* worker = new RenderThumbnailsWorker(
+        env, ctx, doc, max_size, gray, format, columns, quality, concurrency);
+    Napi::Promise promise = worker->GetPromise();
+    worker->Queue();
+    return promise;
+}
+
+// ============================================================================
+// Document Text Extraction
+// ============================================================================
+
+/** Pages that may be extracted or queued ahead of the consumer by default */
+static const int kTextPagesInFlight = 8;
+
+/** One page of extracted text; text is null for a page that failed to load */
+struct TextPageResult {
+    int page;
+    std::string* text;
+};
+
+/**
+ * Async worker that extracts every page's text on several threads and
+ * streams it to a JS callback one page at a time, in page order.
+ *
+ * fz_extract_document_text bounds the pages extracted ahead of delivery
+ * and the gate bounds the pages delivered but not yet consumed, so a
+ * consumer that returns promises throttles extraction instead of letting
+ * text pile up. A throw or rejection stops the extraction. Resolves with
+ * the number of pages delivered with text.
+ */
+class ExtractDocumentTextWorker : public Napi::AsyncProgressQueueWorker<TextPageResult> {
+public:
+    ExtractDocumentTextWorker(Napi::Env env, fz_context ctx, fz_document doc, int format,
+                              int threads, int max_in_flight, const Napi::Function& callback)
+        : Napi::AsyncProgressQueueWorker<TextPageResult>(env),
+          deferred_(Napi::Promise::Deferred::New(env)),
+          callback_(Napi::Persistent(callback)),
+          gate_(std::make_shared<StreamGate>()),
+          ctx_(ctx), doc_(doc), format_(format), threads_(threads),
+          max_in_flight_(max_in_flight), progress_(nullptr), delivered_(0) {}
+
+    Napi::Promise GetPromise() { return deferred_.Promise(); }
+
+protected:
+    void Execute(const ExecutionProgress& progress) override {
+        progress_ = &progress;
+        delivered_ = fz_extract_document_text(ctx_, doc_, format_, nullptr, threads_,
+                                              max_in_flight_, OnPage, this);
+        WaitForConsumer(0);
+        progress_ = nullptr;
+        if (delivered_ < 0) {
+            SetError("Failed to extract text");
+        }
+    }
+
+    void OnProgress(const TextPageResult* data, size_t count) override {
+        Napi::Env env = Env();
+        Napi::HandleScope scope(env);
+
+        for (size_t i = 0; i < count; i++) {
+            std::unique_ptr<std::string> text(data[i].text);
+            if (Failed()) {
+                gate_->Ack(nullptr);
+                continue;
+            }
+
+            Napi::Value value = text ? Napi::String::New(env, *text) : env.Null();
+            Napi::Value result = callback_.Call({Napi::Number::New(env, data[i].page), value});
+            if (env.IsExceptionPending()) {
+                Napi::Value error = env.GetAndClearPendingException().Value();
+                gate_->Ack(&error);
+                continue;
+            }
+
+            if (result.IsPromise()) {
+                std::shared_ptr<StreamGate> gate = gate_;
+                Napi::Function on_settled = Napi::Function::New(env,
+                    [gate](const Napi::CallbackInfo&) { gate->Ack(nullptr); });
+                Napi::Function on_rejected = Napi::Function::New(env,
+                    [gate](const Napi::CallbackInfo& info) {
+                        Napi::Value reason = info[0];
+                        gate->Ack(&reason);
+                    });
+                Napi::Object promise = result.As<Napi::Object>();
+                promise.Get("then").As<Napi::Function>().Call(promise, {on_settled, on_rejected});
+            } else {
+                gate_->Ack(nullptr);
+            }
+        }
+    }
+
+    void OnOK() override {
+        Napi::Value error = ConsumerError();
+        if (!error.IsEmpty()) {
+            deferred_.Reject(error);
+            return;
+        }
+        deferred_.Resolve(Napi::Number::New(Env(), delivered_));
+    }
+
+    void OnError(const Napi::Error& error) override {
+        Napi::Value consumer_error = ConsumerError();
+        deferred_.Reject(consumer_error.IsEmpty() ? error.Value() : consumer_error);
+    }
+
+private:
+    /** Called on the extraction thread for each page, in order */
+    static int OnPage(void* opaque, int page, const unsigned char* data, size_t len) {
+        ExtractDocumentTextWorker* self = static_cast<ExtractDocumentTextWorker*>(opaque);
+        self->WaitForConsumer(self->max_in_flight_ - 1);
+        if (self->Failed()) {
+            return 1;
+        }
+        TextPageResult result = {
+            page, data != nullptr ? new std::string(reinterpret_cast<const char*>(data), len) : nullptr};
+        {
+            std::lock_guard<std::mutex> lock(self->gate_->mutex);
+            self->gate_->pending++;
+        }
+        self->progress_->Send(&result, 1);
+        return 0;
+    }
+
+    bool Failed() const {
+        std::lock_guard<std::mutex> lock(gate_->mutex);
+        return gate_->failed;
+    }
+
+    /** Block until at most `limit` pages are unconsumed, or the consumer fails */
+    void WaitForConsumer(int limit) {
+        std::unique_lock<std::mutex> lock(gate_->mutex);
+        gate_->cv.wait(lock, [&] { return gate_->failed || gate_->pending <= limit; });
+    }
+
+    /** The first error thrown or rejected by the callback, if any */
+    Napi::Value ConsumerError() {
+        std::lock_guard<std::mutex> lock(gate_->mutex);
+        if (!gate_->error.IsEmpty()) {
+            return gate_->error.Value();
+        }
+        return Napi::Value();
+    }
+
+    Napi::Promise::Deferred deferred_;
+    Napi::FunctionReference callback_;
+    std::shared_ptr<StreamGate> gate_;
+    fz_context ctx_;
+    fz_document doc_;
+    int format_;
+    int threads_;
+    int max_in_flight_;
+    const ExecutionProgress* progress_;
+    int delivered_;
+};
+
+/**
+ * Extract the text of every page of a document in parallel
+ *
+ * JavaScript: extractDocumentText(ctx, doc, options, onPage): Promise<number>
+ *
+ * options: {
+ *   format?: 'text' | 'json' (default 'text'),
+ *   concurrency?: number (default: hardware threads),
+ *   maxInFlight?: number (pages extracted ahead of the consumer, default 8)
+ * }
+ *
+ * onPage(page, text) is called once per page in page order, with null text
+ * for a page that failed to load; returning a promise holds back later
+ * pages until it settles. Resolves with the number of pages delivered
+ * with text.
+ */
+Napi::Value ExtractDocumentText(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 4 || !info[0].IsObject() || !info[1].IsObject() || !info[2].IsObject() ||
+        !info[3].IsFunction()) {
+        Napi::TypeError::New(env, "Expected (context, document, options, onPage)").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    fz_context ctx = GetContext(info[0].As<Napi::Object>());
+    fz_document doc = GetDocument(info[1].As<Napi::Object>());
+    Napi::Object options = info[2].As<Napi::Object>();
+
+    int format = FZ_TEXT_FORMAT_TEXT;
+    if (options.Has("format")) {
+        std::string name = options.Get("format").As<Napi::String>().Utf8Value();
+        if (name == "json") {
+            format = FZ_TEXT_FORMAT_JSON;
+        } else if (name != "text") {
+            Napi::TypeError::New(env, "Invalid format (must be 'text' or 'json')").ThrowAsJavaScriptException();
+            return env.Null();
+        }
+    }
+
+    int concurrency = options.Has("concurrency")
+        ? options.Get("concurrency").As<Napi::Number>().Int32Value()
+        : 0;
+    int max_in_flight = options.Has("maxInFlight")
+        ? options.Get("maxInFlight").As<Napi::Number>().Int32Value()
+        : kTextPagesInFlight;
+    if (max_in_flight < 1) {
+        Napi::RangeError::New(env, "maxInFlight must be a positive number of pages").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    ExtractDocumentTextWorker* worker = new ExtractDocumentTextWorker(
+        env, ctx, doc, format, concurrency, max_in_flight, info[3].As<Napi::Function>());
+    Napi::Promise promise = worker->GetPromise();
+    worker->Queue();
+    return promise;
+}
+
+/**
+ * Initialize page exports
+ */
+Napi::Object InitPage(Napi::Env env, Napi::Object exports) {
+    // Basic page operations
+    exports.Set("loadPage", Napi::Function::New(env, LoadPage));
+    exports.Set("dropPage", Napi::Function::New(env, DropPage));
+    exports.Set("boundPage", Napi::Function::New(env, BoundPage));
+    exports.Set("boundPages", Napi::Function::New(env, BoundPages));
+
+    // Basic rendering
+    exports.Set("renderPage", Napi::Function::New(env, RenderPage));
+    exports.Set("renderPageToPNG", Napi::Function::New(env, RenderPageToPNG));
+
+    // Advanced rendering with options
+    exports.Set("renderPageWithOptions", Napi::Function::New(env, RenderPageWithOptions));
+    exports.Set("renderPageToPNGWithOptions", Napi::Function::New(env, RenderPageToPNGWithOptions));
+
+    // Async rendering (Promise-based, runs on the libuv thread pool)
+    exports.Set("renderPageAsync", Napi::Function::New(env, RenderPageAsync));
+    exports.Set("renderPageToPNGAsync", Napi::Function::New(env, RenderPageToPNGAsync));
+    exports.Set("renderPageWithOptionsAsync", Napi::Function::New(env, RenderPageWithOptionsAsync));
+    exports.Set("renderPages", Napi::Function::New(env, RenderPages));
+    exports.Set("renderPageToPNGStream", Napi::Function::New(env, RenderPageToPNGStream));
+
+    // Render pool
+    exports.Set("createRenderPool", Napi::Function::New(env, CreateRenderPool));
+    exports.Set("dropRenderPool", Napi::Function::New(env, DropRenderPool));
+    exports.Set("renderPoolSubmit", Napi::Function::New(env, RenderPoolSubmit));
+    exports.Set("renderPoolCancel", Napi::Function::New(env, RenderPoolCancel));
+    exports.Set("renderPoolWait", Napi::Function::New(env, RenderPoolWait));
+
+    // Whole-document thumbnails
+    exports.Set("renderThumbnails", Napi::Function::New(env, RenderThumbnails));
 
     // Text extraction
     exports.Set("extractText", Napi::Function::New(env, ExtractText));
     exports.Set("extractTextBlocks", Napi::Function::New(env, ExtractTextBlocks));
+    exports.Set("extractDocumentText", Napi::Function::New(env, ExtractDocumentText));
 
     // Page links and search
     exports.Set("getPageLinks", Napi::Function::New(env, GetPageLinks));
@@ -7,6 +7,7 @@
 
 #include <napi.h>
 #include "include/mupdf_minimal.h"
+#include "include/handles.h"
 
 /**
  * Create a new empty path
@@ -14,21 +15,20 @@
  * @param ctx - Context handle
  * @returns Path handle
  */
-Napi::BigInt NewPath(const Napi::CallbackInfo& info) {
+Napi::Value NewPath(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 1) {
         Napi::TypeError::New(env, "Expected 1 argument: ctx")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
 
     uint64_t path_handle = fz_new_path(ctx_handle);
 
-    return Napi::BigInt::New(env, path_handle);
+    return HandleToValue(env, path_handle);
 }
 
 /**
@@ -46,9 +46,8 @@ Napi::Value DropPath(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t path_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t path_handle = HandleFromValue(info[1]);
 
     fz_drop_path(ctx_handle, path_handle);
 
@@ -72,9 +71,8 @@ Napi::Value PathMoveTo(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t path_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t path_handle = HandleFromValue(info[1]);
     float x = info[2].As<Napi::Number>().FloatValue();
     float y = info[3].As<Napi::Number>().FloatValue();
 
@@ -100,9 +98,8 @@ Napi::Value PathLineTo(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t path_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t path_handle = HandleFromValue(info[1]);
     float x = info[2].As<Napi::Number>().FloatValue();
     float y = info[3].As<Napi::Number>().FloatValue();
 
@@ -132,9 +129,8 @@ Napi::Value PathCurveTo(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t path_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t path_handle = HandleFromValue(info[1]);
     float x1 = info[2].As<Napi::Number>().FloatValue();
     float y1 = info[3].As<Napi::Number>().FloatValue();
     float x2 = info[4].As<Napi::Number>().FloatValue();
@@ -162,9 +158,8 @@ Napi::Value PathClosePath(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t path_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t path_handle = HandleFromValue(info[1]);
 
     fz_closepath(ctx_handle, path_handle);
 
@@ -190,9 +185,8 @@ Napi::Value PathRect(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t path_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t path_handle = HandleFromValue(info[1]);
     float x = info[2].As<Napi::Number>().FloatValue();
     float y = info[3].As<Napi::Number>().FloatValue();
     float w = info[4].As<Napi::Number>().FloatValue();
@@ -203,6 +197,63 @@ Napi::Value PathRect(const Napi::CallbackInfo& info) {
     return env.Undefined();
 }
 
+/**
+ * Append a packed list of commands to a path in one native call
+ *
+ * @param ctx - Context handle
+ * @param path - Path handle
+ * @param ops - Uint8Array of FZ_PATH_* commands
+ * @param coords - Float32Array of the numbers those commands consume
+ * @returns Number of commands appended
+ */
+Napi::Value PathAppendCommands(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 4 || !info[2].IsTypedArray() || !info[3].IsTypedArray()) {
+        Napi::TypeError::New(env, "Expected 4 arguments: ctx, path, ops (Uint8Array), coords (Float32Array)")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    Napi::TypedArray ops_arr = info[2].As<Napi::TypedArray>();
+    Napi::TypedArray coords_arr = info[3].As<Napi::TypedArray>();
+    if (ops_arr.TypedArrayType() != napi_uint8_array ||
+        coords_arr.TypedArrayType() != napi_float32_array) {
+        Napi::TypeError::New(env, "ops must be a Uint8Array and coords a Float32Array")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    // Only hand over as many commands as coords has numbers for
+    Napi::Uint8Array ops = ops_arr.As<Napi::Uint8Array>();
+    Napi::Float32Array coords = coords_arr.As<Napi::Float32Array>();
+    size_t n = 0;
+    size_t needed = 0;
+    for (; n < ops.ElementLength(); n++) {
+        int count;
+        switch (ops[n]) {
+            case FZ_PATH_MOVETO:
+            case FZ_PATH_LINETO: count = 2; break;
+            case FZ_PATH_CURVETO: count = 6; break;
+            case FZ_PATH_CLOSEPATH: count = 0; break;
+            case FZ_PATH_RECTTO:
+            case FZ_PATH_QUADTO: count = 4; break;
+            default: count = -1; break;
+        }
+        if (count < 0 || needed + static_cast<size_t>(count) > coords.ElementLength()) {
+            break;
+        }
+        needed += static_cast<size_t>(count);
+    }
+
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t path_handle = HandleFromValue(info[1]);
+    int32_t appended = fz_path_append_commands(
+        ctx_handle, path_handle, ops.Data(), coords.Data(), static_cast<int32_t>(n));
+
+    return Napi::Number::New(env, appended);
+}
+
 /**
  * Get path bounding box
  *
@@ -222,13 +273,12 @@ Napi::Object PathBoundPath(const Napi::CallbackInfo& info) {
         return result;
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t path_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t path_handle = HandleFromValue(info[1]);
 
     uint64_t stroke_handle = 0;
     if (info.Length() > 2 && !info[2].IsNull() && !info[2].IsUndefined()) {
-        stroke_handle = info[2].As<Napi::BigInt>().Uint64Value(&lossless);
+        stroke_handle = HandleFromValue(info[2]);
     }
 
     fz_rect rect = fz_bound_path(ctx_handle, path_handle, stroke_handle);
@@ -252,6 +302,7 @@ Napi::Object InitPath(Napi::Env env, Napi::Object exports) {
     exports.Set("pathCurveTo", Napi::Function::New(env, PathCurveTo));
     exports.Set("pathClosePath", Napi::Function::New(env, PathClosePath));
     exports.Set("pathRect", Napi::Function::New(env, PathRect));
+    exports.Set("pathAppendCommands", Napi::Function::New(env, PathAppendCommands));
     exports.Set("pathBoundPath", Napi::Function::New(env, PathBoundPath));
 
     return exports;
@@ -7,6 +7,8 @@
 
 #include <napi.h>
 #include "include/mupdf_minimal.h"
+#include "include/handles.h"
+#include <cstdint>
 
 /**
  * Create a new pixmap
@@ -18,25 +20,24 @@
  * @param alpha - Include alpha channel
  * @returns Pixmap handle
  */
-Napi::BigInt NewPixmap(const Napi::CallbackInfo& info) {
+Napi::Value NewPixmap(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 5) {
         Napi::TypeError::New(env, "Expected 5 arguments: ctx, colorspace, w, h, alpha")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t cs_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t cs_handle = HandleFromValue(info[1]);
     int32_t w = info[2].As<Napi::Number>().Int32Value();
     int32_t h = info[3].As<Napi::Number>().Int32Value();
     int32_t alpha = info[4].As<Napi::Boolean>().Value() ? 1 : 0;
 
     uint64_t pixmap_handle = fz_new_pixmap(ctx_handle, cs_handle, w, h, alpha);
 
-    return Napi::BigInt::New(env, pixmap_handle);
+    return HandleToValue(env, pixmap_handle);
 }
 
 /**
@@ -54,9 +55,8 @@ Napi::Value DropPixmap(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t pixmap_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t pixmap_handle = HandleFromValue(info[1]);
 
     fz_drop_pixmap(ctx_handle, pixmap_handle);
 
@@ -79,9 +79,8 @@ Napi::Number PixmapWidth(const Napi::CallbackInfo& info) {
         return Napi::Number::New(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t pixmap_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t pixmap_handle = HandleFromValue(info[1]);
 
     int32_t width = fz_pixmap_width(ctx_handle, pixmap_handle);
 
@@ -104,18 +103,29 @@ Napi::Number PixmapHeight(const Napi::CallbackInfo& info) {
         return Napi::Number::New(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t pixmap_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t pixmap_handle = HandleFromValue(info[1]);
 
     int32_t height = fz_pixmap_height(ctx_handle, pixmap_handle);
 
     return Napi::Number::New(env, height);
 }
 
+/**
+ * Finalizer hint for Node buffers that alias pixmap sample memory
+ */
+struct PixmapSamplesRef {
+    uint64_t ctx;
+    uint64_t pixmap;
+};
+
 /**
  * Get pixmap samples (pixel data)
  *
+ * The returned Buffer is a zero-copy view of the pixmap's sample memory.
+ * It holds its own pixmap reference, so it stays valid after dropPixmap
+ * until it is garbage collected. Writes through the view modify the pixmap.
+ *
  * @param ctx - Context handle
  * @param pixmap - Pixmap handle
  * @returns Buffer containing pixel data
@@ -129,18 +139,24 @@ Napi::Buffer<uint8_t> PixmapSamples(const Napi::CallbackInfo& info) {
         return Napi::Buffer<uint8_t>::New(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t pixmap_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
-
-    uint8_t* data = nullptr;
-    size_t size = 0;
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t pixmap_handle = HandleFromValue(info[1]);
 
-    fz_pixmap_samples(ctx_handle, pixmap_handle, &data, &size);
+    uint8_t* data = fz_pixmap_samples(ctx_handle, pixmap_handle);
+    size_t size = fz_pixmap_size(ctx_handle, pixmap_handle);
 
     if (data && size > 0) {
-        // Create a copy of the data for Node.js
-        return Napi::Buffer<uint8_t>::Copy(env, data, size);
+        // Keep the pixmap alive for as long as JavaScript holds the view
+        fz_keep_pixmap(ctx_handle, pixmap_handle);
+        return Napi::Buffer<uint8_t>::NewOrCopy(
+            env,
+            data,
+            size,
+            [](Napi::Env, uint8_t*, PixmapSamplesRef* ref) {
+                fz_drop_pixmap(ref->ctx, ref->pixmap);
+                delete ref;
+            },
+            new PixmapSamplesRef{ctx_handle, pixmap_handle});
     }
 
     return Napi::Buffer<uint8_t>::New(env, 0);
@@ -162,9 +178,8 @@ Napi::Number PixmapStride(const Napi::CallbackInfo& info) {
         return Napi::Number::New(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t pixmap_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t pixmap_handle = HandleFromValue(info[1]);
 
     size_t stride = fz_pixmap_stride(ctx_handle, pixmap_handle);
 
@@ -187,9 +202,8 @@ Napi::Number PixmapComponents(const Napi::CallbackInfo& info) {
         return Napi::Number::New(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t pixmap_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t pixmap_handle = HandleFromValue(info[1]);
 
     int32_t n = fz_pixmap_components(ctx_handle, pixmap_handle);
 
@@ -212,9 +226,8 @@ Napi::Value ClearPixmap(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t pixmap_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t pixmap_handle = HandleFromValue(info[1]);
     int32_t value = info[2].As<Napi::Number>().Int32Value();
 
     fz_clear_pixmap(ctx_handle, pixmap_handle, value);
@@ -222,6 +235,99 @@ Napi::Value ClearPixmap(const Napi::CallbackInfo& info) {
     return env.Undefined();
 }
 
+/**
+ * Render a page into caller-owned memory
+ *
+ * The page is drawn straight into the typed array's memory (a canvas
+ * ImageData buffer, a SharedArrayBuffer view, ...), so no pixmap copy is
+ * made on the way out. It lands as fz_new_pixmap_from_page would place it:
+ * the top-left corner of the transformed page bounds is the first pixel,
+ * cleared to white (transparent with alpha) first. A target smaller than
+ * the page receives its top-left part.
+ *
+ * JavaScript: renderPageInto(ctx: NativeContext, page: NativePage, matrix: NativeMatrix,
+ *     colorspace: NativeColorspace | null, alpha: boolean, target: Uint8ClampedArray,
+ *     width: number, height: number, stride?: number): void
+ *
+ * @param stride - Bytes per row (defaults to width times components)
+ */
+Napi::Value RenderPageInto(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 8) {
+        Napi::TypeError::New(env,
+            "Expected (context, page, matrix, colorspace, alpha, target, width, height, stride?)")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (!info[5].IsTypedArray()) {
+        Napi::TypeError::New(env, "Target must be a Uint8ClampedArray or Uint8Array")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    Napi::TypedArray typed = info[5].As<Napi::TypedArray>();
+    if (typed.TypedArrayType() != napi_uint8_clamped_array && typed.TypedArrayType() != napi_uint8_array) {
+        Napi::TypeError::New(env, "Target must be a Uint8ClampedArray or Uint8Array")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    fz_context ctx = HandleFromValue(info[0].As<Napi::Object>().Get("_handle"));
+    fz_page page = HandleFromValue(info[1].As<Napi::Object>().Get("_handle"));
+
+    Napi::Object m = info[2].As<Napi::Object>();
+    fz_matrix matrix;
+    matrix.a = m.Get("a").As<Napi::Number>().FloatValue();
+    matrix.b = m.Get("b").As<Napi::Number>().FloatValue();
+    matrix.c = m.Get("c").As<Napi::Number>().FloatValue();
+    matrix.d = m.Get("d").As<Napi::Number>().FloatValue();
+    matrix.e = m.Get("e").As<Napi::Number>().FloatValue();
+    matrix.f = m.Get("f").As<Napi::Number>().FloatValue();
+
+    // Anything that is not gray or CMYK renders as RGB
+    int cs_n = 3;
+    if (info[3].IsObject() && info[3].As<Napi::Object>().Has("n")) {
+        cs_n = info[3].As<Napi::Object>().Get("n").As<Napi::Number>().Int32Value();
+    }
+    if (cs_n != 1 && cs_n != 4) {
+        cs_n = 3;
+    }
+    fz_colorspace cs = cs_n == 1 ? fz_device_gray(ctx) : cs_n == 4 ? fz_device_cmyk(ctx) : fz_device_rgb(ctx);
+
+    bool alpha = info[4].As<Napi::Boolean>().Value();
+    int32_t width = info[6].As<Napi::Number>().Int32Value();
+    int32_t height = info[7].As<Napi::Number>().Int32Value();
+    int64_t row = static_cast<int64_t>(width) * (cs_n + (alpha ? 1 : 0));
+    int64_t stride = info.Length() > 8 && info[8].IsNumber() ? info[8].As<Napi::Number>().Int64Value() : row;
+
+    if (width <= 0 || height <= 0 || stride < row || stride > INT32_MAX) {
+        Napi::RangeError::New(env, "Invalid width, height or stride").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+    if (static_cast<uint64_t>(stride) * static_cast<uint64_t>(height) > typed.ByteLength()) {
+        Napi::RangeError::New(env, "Target is smaller than stride * height").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    unsigned char* samples = static_cast<unsigned char*>(typed.ArrayBuffer().Data()) + typed.ByteOffset();
+    fz_pixmap pix = fz_new_pixmap_with_data(ctx, cs, width, height, 0, alpha ? 1 : 0,
+        static_cast<int>(stride), samples);
+    if (pix == 0) {
+        Napi::Error::New(env, "Failed to wrap target memory").ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    // Synchronous, so the typed array cannot be collected or detached mid-render
+    int status = fz_fill_pixmap_from_page(ctx, page, matrix, pix, fz_aa_level(ctx),
+        FZ_RENDER_ANNOTS | FZ_RENDER_WIDGETS, 0);
+    fz_drop_pixmap(ctx, pix);
+    if (status != 0) {
+        Napi::Error::New(env, "Failed to render page").ThrowAsJavaScriptException();
+    }
+
+    return env.Undefined();
+}
+
 /**
  * Initialize Pixmap module exports
  */
@@ -234,6 +340,7 @@ Napi::Object InitPixmap(Napi::Env env, Napi::Object exports) {
     exports.Set("pixmapStride", Napi::Function::New(env, PixmapStride));
     exports.Set("pixmapComponents", Napi::Function::New(env, PixmapComponents));
     exports.Set("clearPixmap", Napi::Function::New(env, ClearPixmap));
+    exports.Set("renderPageInto", Napi::Function::New(env, RenderPageInto));
 
     return exports;
 }
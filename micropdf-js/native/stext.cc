@@ -7,6 +7,113 @@
 
 #include <napi.h>
 #include "include/mupdf_minimal.h"
+#include "include/handles.h"
+
+/**
+ * Helper: Create a JS rect object {x0, y0, x1, y1}
+ */
+static Napi::Object MakeRect(Napi::Env env, float x0, float y0, float x1, float y1) {
+    Napi::Object rect = Napi::Object::New(env);
+    rect.Set("x0", Napi::Number::New(env, x0));
+    rect.Set("y0", Napi::Number::New(env, y0));
+    rect.Set("x1", Napi::Number::New(env, x1));
+    rect.Set("y1", Napi::Number::New(env, y1));
+    return rect;
+}
+
+/**
+ * Helper: Create a JS point object {x, y}
+ */
+static Napi::Object MakePoint(Napi::Env env, float x, float y) {
+    Napi::Object point = Napi::Object::New(env);
+    point.Set("x", Napi::Number::New(env, x));
+    point.Set("y", Napi::Number::New(env, y));
+    return point;
+}
+
+/**
+ * Helper: Create a JS quad object {ul, ur, ll, lr}
+ */
+static Napi::Object MakeQuad(Napi::Env env, const fz_quad& q) {
+    Napi::Object quad = Napi::Object::New(env);
+    quad.Set("ul", MakePoint(env, q.ul.x, q.ul.y));
+    quad.Set("ur", MakePoint(env, q.ur.x, q.ur.y));
+    quad.Set("ll", MakePoint(env, q.ll.x, q.ll.y));
+    quad.Set("lr", MakePoint(env, q.lr.x, q.lr.y));
+    return quad;
+}
+
+/**
+ * Helper: Encode a Unicode code point as a UTF-8 JS string
+ */
+static Napi::String CodepointToString(Napi::Env env, int c) {
+    char utf8[4];
+    size_t n;
+    uint32_t u = static_cast<uint32_t>(c);
+    if (u > 0x10FFFF || (u >= 0xD800 && u <= 0xDFFF)) {
+        u = 0xFFFD;
+    }
+    if (u < 0x80) {
+        utf8[0] = static_cast<char>(u);
+        n = 1;
+    } else if (u < 0x800) {
+        utf8[0] = static_cast<char>(0xC0 | (u >> 6));
+        utf8[1] = static_cast<char>(0x80 | (u & 0x3F));
+        n = 2;
+    } else if (u < 0x10000) {
+        utf8[0] = static_cast<char>(0xE0 | (u >> 12));
+        utf8[1] = static_cast<char>(0x80 | ((u >> 6) & 0x3F));
+        utf8[2] = static_cast<char>(0x80 | (u & 0x3F));
+        n = 3;
+    } else {
+        utf8[0] = static_cast<char>(0xF0 | (u >> 18));
+        utf8[1] = static_cast<char>(0x80 | ((u >> 12) & 0x3F));
+        utf8[2] = static_cast<char>(0x80 | ((u >> 6) & 0x3F));
+        utf8[3] = static_cast<char>(0x80 | (u & 0x3F));
+        n = 4;
+    }
+    return Napi::String::New(env, utf8, n);
+}
+
+/**
+ * Helper: Name of a structured text block type
+ */
+static const char* BlockTypeName(int type) {
+    switch (type) {
+        case 0: return "Text";
+        case 1: return "Image";
+        case 2: return "Struct";
+        case 3: return "Vector";
+        case 4: return "Grid";
+        default: return "Unknown";
+    }
+}
+
+/**
+ * Helper: Build a JS character object for char `ch` of line `line` in block `block`
+ */
+static Napi::Object MakeChar(Napi::Env env, uint64_t ctx, uint64_t stext, int block, int line, int ch) {
+    Napi::Object obj = Napi::Object::New(env);
+    obj.Set("c", CodepointToString(env, fz_stext_char_value(ctx, stext, block, line, ch)));
+
+    fz_quad quad = {};
+    fz_stext_char_quad(ctx, stext, block, line, ch, &quad);
+    obj.Set("quad", MakeQuad(env, quad));
+
+    obj.Set("size", Napi::Number::New(env, fz_stext_char_size(ctx, stext, block, line, ch)));
+    obj.Set("fontName", Napi::String::New(env, "Unknown"));
+    return obj;
+}
+
+/**
+ * Helper: Check that block (and line, if >= 0) exist on the page
+ */
+static bool ValidLine(uint64_t ctx, uint64_t stext, uint32_t block, int64_t line) {
+    if (block >= static_cast<uint32_t>(fz_stext_block_count(ctx, stext))) {
+        return false;
+    }
+    return line < 0 || line < fz_stext_line_count(ctx, stext, static_cast<int>(block));
+}
 
 /**
  * Create a structured text page from a document page
@@ -16,21 +123,20 @@
  * @param options - Options (reserved for future use, pass 0)
  * @returns SText page handle
  */
-Napi::BigInt NewSTextPage(const Napi::CallbackInfo& info) {
+Napi::Value NewSTextPage(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 2) {
         Napi::TypeError::New(env, "Expected 2 arguments: ctx, page")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
     // Get context handle
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
 
     // Get page handle
-    uint64_t page_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t page_handle = HandleFromValue(info[1]);
 
     // Call Rust FFI
     uint64_t stext_handle = fz_new_stext_page_from_page(
@@ -39,7 +145,7 @@ Napi::BigInt NewSTextPage(const Napi::CallbackInfo& info) {
         nullptr  // options - pass nullptr for default
     );
 
-    return Napi::BigInt::New(env, stext_handle);
+    return HandleToValue(env, stext_handle);
 }
 
 /**
@@ -57,9 +163,8 @@ Napi::Value DropSTextPage(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t stext_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t stext_handle = HandleFromValue(info[1]);
 
     fz_drop_stext_page(ctx_handle, stext_handle);
 
@@ -82,9 +187,8 @@ Napi::String GetSTextAsText(const Napi::CallbackInfo& info) {
         return Napi::String::New(env, "");
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t stext_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t stext_handle = HandleFromValue(info[1]);
 
     // Create buffer for text
     uint64_t buffer_handle = fz_new_buffer_from_stext_page(ctx_handle, stext_handle);
@@ -127,9 +231,8 @@ Napi::Array SearchSTextPage(const Napi::CallbackInfo& info) {
         return results;
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t stext_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t stext_handle = HandleFromValue(info[1]);
     std::string needle = info[2].As<Napi::String>().Utf8Value();
 
     int max_hits = 500;
@@ -152,34 +255,7 @@ Napi::Array SearchSTextPage(const Napi::CallbackInfo& info) {
 
     // Convert quads to JS objects
     for (int i = 0; i < hit_count; i++) {
-        Napi::Object quad = Napi::Object::New(env);
-
-        // Upper-left
-        Napi::Object ul = Napi::Object::New(env);
-        ul.Set("x", Napi::Number::New(env, hit_bbox[i].ul.x));
-        ul.Set("y", Napi::Number::New(env, hit_bbox[i].ul.y));
-
-        // Upper-right
-        Napi::Object ur = Napi::Object::New(env);
-        ur.Set("x", Napi::Number::New(env, hit_bbox[i].ur.x));
-        ur.Set("y", Napi::Number::New(env, hit_bbox[i].ur.y));
-
-        // Lower-left
-        Napi::Object ll = Napi::Object::New(env);
-        ll.Set("x", Napi::Number::New(env, hit_bbox[i].ll.x));
-        ll.Set("y", Napi::Number::New(env, hit_bbox[i].ll.y));
-
-        // Lower-right
-        Napi::Object lr = Napi::Object::New(env);
-        lr.Set("x", Napi::Number::New(env, hit_bbox[i].lr.x));
-        lr.Set("y", Napi::Number::New(env, hit_bbox[i].lr.y));
-
-        quad.Set("ul", ul);
-        quad.Set("ur", ur);
-        quad.Set("ll", ll);
-        quad.Set("lr", lr);
-
-        results.Set(i, quad);
+        results.Set(i, MakeQuad(env, hit_bbox[i]));
     }
 
     delete[] hit_bbox;
@@ -204,26 +280,20 @@ Napi::Object GetSTextPageBounds(const Napi::CallbackInfo& info) {
         return rect;
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t stext_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t stext_handle = HandleFromValue(info[1]);
 
     // Call Rust FFI to get bounds
     fz_rect bounds = fz_bound_stext_page(ctx_handle, stext_handle);
 
-    rect.Set("x0", Napi::Number::New(env, bounds.x0));
-    rect.Set("y0", Napi::Number::New(env, bounds.y0));
-    rect.Set("x1", Napi::Number::New(env, bounds.x1));
-    rect.Set("y1", Napi::Number::New(env, bounds.y1));
-
-    return rect;
+    return MakeRect(env, bounds.x0, bounds.y0, bounds.x1, bounds.y1);
 }
 
 /**
  * Get blocks from structured text page (hierarchical navigation)
  *
  * Returns an array of blocks, where each block contains:
- * - blockType: string ("Text", "Image", "List", "Table")
+ * - blockType: string ("Text", "Image", "Struct", "Vector", "Grid")
  * - bbox: rectangle {x0, y0, x1, y1}
  * - lines: array (to be filled by getSTextBlockLines)
  *
@@ -241,47 +311,25 @@ Napi::Array GetSTextPageBlocks(const Napi::CallbackInfo& info) {
         return blocks;
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t stext_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
-
-    // Call Rust FFI to get blocks
-    // For now, we'll create a simplified block structure
-    // In a full implementation, this would call fz_stext_page_get_blocks
-    // and iterate through the actual block structure
-
-    // Get the text to parse into blocks
-    uint64_t buffer_handle = fz_new_buffer_from_stext_page(ctx_handle, stext_handle);
-    if (buffer_handle == 0) {
-        return blocks;
-    }
-
-    size_t len = 0;
-    const uint8_t* data = fz_buffer_data(ctx_handle, buffer_handle, &len);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t stext_handle = HandleFromValue(info[1]);
 
-    if (data && len > 0) {
-        // Create a single text block for simplicity
-        // In a real implementation, we would parse the actual block structure
+    uint32_t n = 0;
+    for (int b = fz_stext_first_block(ctx_handle, stext_handle); b >= 0;
+         b = fz_stext_next_block(ctx_handle, stext_handle, b)) {
         Napi::Object block = Napi::Object::New(env);
-        block.Set("blockType", Napi::String::New(env, "Text"));
+        block.Set("blockType", Napi::String::New(env, BlockTypeName(fz_stext_block_type(ctx_handle, stext_handle, b))));
 
-        // Get bounds from page
-        fz_rect bounds = fz_bound_stext_page(ctx_handle, stext_handle);
-        Napi::Object bbox = Napi::Object::New(env);
-        bbox.Set("x0", Napi::Number::New(env, bounds.x0));
-        bbox.Set("y0", Napi::Number::New(env, bounds.y0));
-        bbox.Set("x1", Napi::Number::New(env, bounds.x1));
-        bbox.Set("y1", Napi::Number::New(env, bounds.y1));
-        block.Set("bbox", bbox);
+        float x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+        fz_stext_block_bbox(ctx_handle, stext_handle, b, &x0, &y0, &x1, &y1);
+        block.Set("bbox", MakeRect(env, x0, y0, x1, y1));
 
         // Lines will be populated by getSTextBlockLines
         block.Set("lines", Napi::Array::New(env));
 
-        blocks.Set(0u, block);
+        blocks.Set(n++, block);
     }
 
-    fz_drop_buffer(ctx_handle, buffer_handle);
-
     return blocks;
 }
 
@@ -289,9 +337,9 @@ Napi::Array GetSTextPageBlocks(const Napi::CallbackInfo& info) {
  * Get lines from a structured text block
  *
  * Returns an array of lines, where each line contains:
- * - wmode: string ("HorizontalLtr", "HorizontalRtl", "VerticalTtb", "VerticalBtt")
+ * - wmode: string ("HorizontalLtr" or "VerticalTtb")
  * - bbox: rectangle
- * - baseline: number
+ * - baseline: number (origin of the first character along the line normal)
  * - dir: point {x, y}
  * - chars: array (to be filled by getSTextLineChars)
  *
@@ -310,97 +358,40 @@ Napi::Array GetSTextBlockLines(const Napi::CallbackInfo& info) {
         return lines;
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t stext_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t stext_handle = HandleFromValue(info[1]);
     uint32_t block_idx = info[2].As<Napi::Number>().Uint32Value();
 
-    // Get text to parse into lines
-    uint64_t buffer_handle = fz_new_buffer_from_stext_page(ctx_handle, stext_handle);
-    if (buffer_handle == 0) {
+    if (!ValidLine(ctx_handle, stext_handle, block_idx, -1)) {
         return lines;
     }
-
-    size_t len = 0;
-    const uint8_t* data = fz_buffer_data(ctx_handle, buffer_handle, &len);
-
-    if (data && len > 0) {
-        std::string text(reinterpret_cast<const char*>(data), len);
-
-        // Split text into lines (simplified)
-        std::string::size_type pos = 0;
-        std::string::size_type prev = 0;
-        uint32_t line_num = 0;
-
-        while ((pos = text.find('\n', prev)) != std::string::npos) {
-            std::string line_text = text.substr(prev, pos - prev);
-
-            if (!line_text.empty()) {
-                Napi::Object line = Napi::Object::New(env);
-                line.Set("wmode", Napi::String::New(env, "HorizontalLtr"));
-
-                // Create bounding box for line
-                fz_rect bounds = fz_bound_stext_page(ctx_handle, stext_handle);
-                float line_height = 12.0f; // Approximate
-                float y_offset = line_num * line_height;
-
-                Napi::Object bbox = Napi::Object::New(env);
-                bbox.Set("x0", Napi::Number::New(env, bounds.x0));
-                bbox.Set("y0", Napi::Number::New(env, bounds.y0 + y_offset));
-                bbox.Set("x1", Napi::Number::New(env, bounds.x1));
-                bbox.Set("y1", Napi::Number::New(env, bounds.y0 + y_offset + line_height));
-                line.Set("bbox", bbox);
-
-                line.Set("baseline", Napi::Number::New(env, bounds.y0 + y_offset + line_height * 0.8));
-
-                Napi::Object dir = Napi::Object::New(env);
-                dir.Set("x", Napi::Number::New(env, 1.0));
-                dir.Set("y", Napi::Number::New(env, 0.0));
-                line.Set("dir", dir);
-
-                line.Set("chars", Napi::Array::New(env));
-
-                lines.Set(line_num, line);
-                line_num++;
-            }
-
-            prev = pos + 1;
+    int b = static_cast<int>(block_idx);
+
+    uint32_t n = 0;
+    for (int l = fz_stext_first_line(ctx_handle, stext_handle, b); l >= 0;
+         l = fz_stext_next_line(ctx_handle, stext_handle, b, l)) {
+        Napi::Object line = Napi::Object::New(env);
+        bool vertical = fz_stext_line_wmode(ctx_handle, stext_handle, b, l) != 0;
+        line.Set("wmode", Napi::String::New(env, vertical ? "VerticalTtb" : "HorizontalLtr"));
+
+        float x0 = 0, y0 = 0, x1 = 0, y1 = 0;
+        fz_stext_line_bbox(ctx_handle, stext_handle, b, l, &x0, &y0, &x1, &y1);
+        line.Set("bbox", MakeRect(env, x0, y0, x1, y1));
+
+        // The baseline runs through the first glyph origin
+        float ox = vertical ? x0 : 0, oy = vertical ? 0 : y1;
+        int first = fz_stext_first_char(ctx_handle, stext_handle, b, l);
+        if (first >= 0) {
+            fz_stext_char_origin(ctx_handle, stext_handle, b, l, first, &ox, &oy);
         }
+        line.Set("baseline", Napi::Number::New(env, vertical ? ox : oy));
+        line.Set("dir", MakePoint(env, vertical ? 0.0f : 1.0f, vertical ? 1.0f : 0.0f));
 
-        // Handle last line
-        if (prev < text.length()) {
-            std::string line_text = text.substr(prev);
-            if (!line_text.empty()) {
-                Napi::Object line = Napi::Object::New(env);
-                line.Set("wmode", Napi::String::New(env, "HorizontalLtr"));
-
-                fz_rect bounds = fz_bound_stext_page(ctx_handle, stext_handle);
-                float line_height = 12.0f;
-                float y_offset = line_num * line_height;
-
-                Napi::Object bbox = Napi::Object::New(env);
-                bbox.Set("x0", Napi::Number::New(env, bounds.x0));
-                bbox.Set("y0", Napi::Number::New(env, bounds.y0 + y_offset));
-                bbox.Set("x1", Napi::Number::New(env, bounds.x1));
-                bbox.Set("y1", Napi::Number::New(env, bounds.y0 + y_offset + line_height));
-                line.Set("bbox", bbox);
-
-                line.Set("baseline", Napi::Number::New(env, bounds.y0 + y_offset + line_height * 0.8));
-
-                Napi::Object dir = Napi::Object::New(env);
-                dir.Set("x", Napi::Number::New(env, 1.0));
-                dir.Set("y", Napi::Number::New(env, 0.0));
-                line.Set("dir", dir);
-
-                line.Set("chars", Napi::Array::New(env));
+        line.Set("chars", Napi::Array::New(env));
 
-                lines.Set(line_num, line);
-            }
-        }
+        lines.Set(n++, line);
     }
 
-    fz_drop_buffer(ctx_handle, buffer_handle);
-
     return lines;
 }
 
@@ -429,97 +420,23 @@ Napi::Array GetSTextLineChars(const Napi::CallbackInfo& info) {
         return chars;
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t stext_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t stext_handle = HandleFromValue(info[1]);
     uint32_t block_idx = info[2].As<Napi::Number>().Uint32Value();
     uint32_t line_idx = info[3].As<Napi::Number>().Uint32Value();
 
-    // Get text to parse
-    uint64_t buffer_handle = fz_new_buffer_from_stext_page(ctx_handle, stext_handle);
-    if (buffer_handle == 0) {
+    if (!ValidLine(ctx_handle, stext_handle, block_idx, line_idx)) {
         return chars;
     }
+    int b = static_cast<int>(block_idx);
+    int l = static_cast<int>(line_idx);
 
-    size_t len = 0;
-    const uint8_t* data = fz_buffer_data(ctx_handle, buffer_handle, &len);
-
-    if (data && len > 0) {
-        std::string text(reinterpret_cast<const char*>(data), len);
-
-        // Get the specific line
-        std::string::size_type pos = 0;
-        std::string::size_type prev = 0;
-        uint32_t current_line = 0;
-        std::string line_text;
-
-        while ((pos = text.find('\n', prev)) != std::string::npos) {
-            if (current_line == line_idx) {
-                line_text = text.substr(prev, pos - prev);
-                break;
-            }
-            current_line++;
-            prev = pos + 1;
-        }
-
-        // Handle last line
-        if (line_text.empty() && current_line == line_idx && prev < text.length()) {
-            line_text = text.substr(prev);
-        }
-
-        // Create character objects
-        fz_rect bounds = fz_bound_stext_page(ctx_handle, stext_handle);
-        float char_width = 6.0f;  // Approximate character width
-        float line_height = 12.0f;
-        float y_offset = line_idx * line_height;
-
-        for (size_t i = 0; i < line_text.length(); i++) {
-            Napi::Object ch = Napi::Object::New(env);
-
-            // Character
-            std::string char_str(1, line_text[i]);
-            ch.Set("c", Napi::String::New(env, char_str));
-
-            // Quad bounding box
-            float x0 = bounds.x0 + (i * char_width);
-            float x1 = x0 + char_width;
-            float y0 = bounds.y0 + y_offset;
-            float y1 = y0 + line_height;
-
-            Napi::Object quad = Napi::Object::New(env);
-
-            Napi::Object ul = Napi::Object::New(env);
-            ul.Set("x", Napi::Number::New(env, x0));
-            ul.Set("y", Napi::Number::New(env, y0));
-            quad.Set("ul", ul);
-
-            Napi::Object ur = Napi::Object::New(env);
-            ur.Set("x", Napi::Number::New(env, x1));
-            ur.Set("y", Napi::Number::New(env, y0));
-            quad.Set("ur", ur);
-
-            Napi::Object ll = Napi::Object::New(env);
-            ll.Set("x", Napi::Number::New(env, x0));
-            ll.Set("y", Napi::Number::New(env, y1));
-            quad.Set("ll", ll);
-
-            Napi::Object lr = Napi::Object::New(env);
-            lr.Set("x", Napi::Number::New(env, x1));
-            lr.Set("y", Napi::Number::New(env, y1));
-            quad.Set("lr", lr);
-
-            ch.Set("quad", quad);
-
-            // Font properties
-            ch.Set("size", Napi::Number::New(env, 12.0));
-            ch.Set("fontName", Napi::String::New(env, "Helvetica"));
-
-            chars.Set(static_cast<uint32_t>(i), ch);
-        }
+    uint32_t n = 0;
+    for (int c = fz_stext_first_char(ctx_handle, stext_handle, b, l); c >= 0;
+         c = fz_stext_next_char(ctx_handle, stext_handle, b, l, c)) {
+        chars.Set(n++, MakeChar(env, ctx_handle, stext_handle, b, l, c));
     }
 
-    fz_drop_buffer(ctx_handle, buffer_handle);
-
     return chars;
 }
 
@@ -531,63 +448,121 @@ Napi::Array GetSTextLineChars(const Napi::CallbackInfo& info) {
  * - quad: quad bounding box
  * - size: font size
  * - fontName: font name
- * - color: [r, g, b]
  * - origin: {x, y}
- * - advance: number
- * - bidi: string ("LTR", "RTL", etc.)
- * - language: string ("en-US", etc.)
+ * - advance: number (distance to the next glyph origin, or quad width for the last one)
  *
  * @param ctx - Context handle
  * @param stext - SText page handle
  * @param blockIdx - Block index
  * @param lineIdx - Line index
  * @param charIdx - Character index
- * @returns Character object with full data
+ * @returns Character object with full data, or an empty object if out of range
  */
 Napi::Object GetSTextCharData(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
-    Napi::Object ch = Napi::Object::New(env);
 
     if (info.Length() < 5) {
         Napi::TypeError::New(env, "Expected 5 arguments: ctx, stext, blockIdx, lineIdx, charIdx")
             .ThrowAsJavaScriptException();
-        return ch;
+        return Napi::Object::New(env);
     }
 
-    // For now, return simplified character data
-    // In a full implementation, this would query the actual glyph data from MuPDF
-    ch.Set("c", Napi::String::New(env, "A"));
-    ch.Set("size", Napi::Number::New(env, 12.0));
-    ch.Set("fontName", Napi::String::New(env, "Helvetica"));
-
-    // Color (black)
-    Napi::Array color = Napi::Array::New(env, 3);
-    color.Set(0u, Napi::Number::New(env, 0.0));
-    color.Set(1u, Napi::Number::New(env, 0.0));
-    color.Set(2u, Napi::Number::New(env, 0.0));
-    ch.Set("color", color);
-
-    // Origin
-    Napi::Object origin = Napi::Object::New(env);
-    origin.Set("x", Napi::Number::New(env, 0.0));
-    origin.Set("y", Napi::Number::New(env, 0.0));
-    ch.Set("origin", origin);
-
-    ch.Set("advance", Napi::Number::New(env, 6.0));
-    ch.Set("bidi", Napi::String::New(env, "LTR"));
-    ch.Set("language", Napi::String::New(env, "en-US"));
-
-    // Quad
-    Napi::Object quad = Napi::Object::New(env);
-    Napi::Object ul = Napi::Object::New(env);
-    ul.Set("x", Napi::Number::New(env, 0.0));
-    ul.Set("y", Napi::Number::New(env, 0.0));
-    quad.Set("ul", ul);
-    ch.Set("quad", quad);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t stext_handle = HandleFromValue(info[1]);
+    uint32_t block_idx = info[2].As<Napi::Number>().Uint32Value();
+    uint32_t line_idx = info[3].As<Napi::Number>().Uint32Value();
+    uint32_t char_idx = info[4].As<Napi::Number>().Uint32Value();
+
+    if (!ValidLine(ctx_handle, stext_handle, block_idx, line_idx)) {
+        return Napi::Object::New(env);
+    }
+    int b = static_cast<int>(block_idx);
+    int l = static_cast<int>(line_idx);
+    int c = static_cast<int>(char_idx);
+    if (char_idx >= static_cast<uint32_t>(fz_stext_char_count(ctx_handle, stext_handle, b, l))) {
+        return Napi::Object::New(env);
+    }
+
+    Napi::Object ch = MakeChar(env, ctx_handle, stext_handle, b, l, c);
+
+    float x = 0, y = 0;
+    fz_stext_char_origin(ctx_handle, stext_handle, b, l, c, &x, &y);
+    ch.Set("origin", MakePoint(env, x, y));
+
+    float advance;
+    int next = fz_stext_next_char(ctx_handle, stext_handle, b, l, c);
+    if (next >= 0) {
+        float nx = x, ny = y;
+        fz_stext_char_origin(ctx_handle, stext_handle, b, l, next, &nx, &ny);
+        advance = fz_stext_line_wmode(ctx_handle, stext_handle, b, l) != 0 ? ny - y : nx - x;
+    } else {
+        fz_quad quad = {};
+        fz_stext_char_quad(ctx_handle, stext_handle, b, l, c, &quad);
+        advance = quad.ur.x - quad.ul.x;
+    }
+    ch.Set("advance", Napi::Number::New(env, advance));
 
     return ch;
 }
 
+/**
+ * Export the whole page as packed typed arrays in one call
+ *
+ * All four arrays are views over a single ArrayBuffer:
+ * - quads: Float32Array, 8 floats per char (ul, ur, ll, lr as x/y pairs)
+ * - codepoints: Uint32Array, one Unicode value per char
+ * - lineOffsets: Uint32Array, first char of each line plus a final total
+ * - blockOffsets: Uint32Array, first line of each block plus a final total
+ *
+ * @param ctx - Context handle
+ * @param stext - SText page handle
+ * @returns Object with the four views, or null if the page is invalid
+ */
+Napi::Value GetSTextPageFlat(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 2) {
+        Napi::TypeError::New(env, "Expected 2 arguments: ctx, stext")
+            .ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t stext_handle = HandleFromValue(info[1]);
+
+    int blocks = 0, lines = 0, chars = 0;
+    if (fz_stext_page_flat_counts(ctx_handle, stext_handle, &blocks, &lines, &chars) < 0) {
+        return env.Null();
+    }
+
+    // Every element is 4 bytes wide, so the views stay aligned back to back
+    size_t quad_len = static_cast<size_t>(chars) * 8;
+    size_t cp_off = quad_len * 4;
+    size_t line_off = cp_off + static_cast<size_t>(chars) * 4;
+    size_t block_off = line_off + (static_cast<size_t>(lines) + 1) * 4;
+    size_t total = block_off + (static_cast<size_t>(blocks) + 1) * 4;
+
+    Napi::ArrayBuffer storage = Napi::ArrayBuffer::New(env, total);
+    uint8_t* base = static_cast<uint8_t*>(storage.Data());
+
+    int written = fz_stext_page_fill_flat(
+        ctx_handle, stext_handle,
+        reinterpret_cast<float*>(base), reinterpret_cast<uint32_t*>(base + cp_off), chars,
+        reinterpret_cast<uint32_t*>(base + line_off), lines,
+        reinterpret_cast<uint32_t*>(base + block_off), blocks);
+    if (written < 0) {
+        Napi::Error::New(env, "Failed to export structured text").ThrowAsJavaScriptException();
+        return env.Null();
+    }
+
+    Napi::Object result = Napi::Object::New(env);
+    result.Set("quads", Napi::Float32Array::New(env, quad_len, storage, 0));
+    result.Set("codepoints", Napi::Uint32Array::New(env, chars, storage, cp_off));
+    result.Set("lineOffsets", Napi::Uint32Array::New(env, lines + 1, storage, line_off));
+    result.Set("blockOffsets", Napi::Uint32Array::New(env, blocks + 1, storage, block_off));
+    return result;
+}
+
 /**
  * Initialize SText module exports
  */
@@ -605,6 +580,9 @@ Napi::Object InitSText(Napi::Env env, Napi::Object exports) {
     exports.Set("getSTextLineChars", Napi::Function::New(env, GetSTextLineChars));
     exports.Set("getSTextCharData", Napi::Function::New(env, GetSTextCharData));
 
+    // Bulk export
+    exports.Set("getSTextPageFlat", Napi::Function::New(env, GetSTextPageFlat));
+
     return exports;
 }
 
@@ -7,6 +7,7 @@
 
 #include <napi.h>
 #include "include/mupdf_minimal.h"
+#include "include/handles.h"
 
 /**
  * Open stream from file
@@ -15,22 +16,21 @@
  * @param filename - Path to file
  * @returns Stream handle
  */
-Napi::BigInt OpenFile(const Napi::CallbackInfo& info) {
+Napi::Value OpenFile(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 2) {
         Napi::TypeError::New(env, "Expected 2 arguments: ctx, filename")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
     std::string filename = info[1].As<Napi::String>().Utf8Value();
 
     uint64_t stream_handle = fz_open_file(ctx_handle, filename.c_str());
 
-    return Napi::BigInt::New(env, stream_handle);
+    return HandleToValue(env, stream_handle);
 }
 
 /**
@@ -40,17 +40,16 @@ Napi::BigInt OpenFile(const Napi::CallbackInfo& info) {
  * @param data - Buffer containing data
  * @returns Stream handle
  */
-Napi::BigInt OpenMemory(const Napi::CallbackInfo& info) {
+Napi::Value OpenMemory(const Napi::CallbackInfo& info) {
     Napi::Env env = info.Env();
 
     if (info.Length() < 2) {
         Napi::TypeError::New(env, "Expected 2 arguments: ctx, data")
             .ThrowAsJavaScriptException();
-        return Napi::BigInt::New(env, static_cast<uint64_t>(0));
+        return HandleToValue(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
     Napi::Buffer<uint8_t> buffer = info[1].As<Napi::Buffer<uint8_t>>();
 
     uint64_t stream_handle = fz_open_memory(
@@ -59,7 +58,7 @@ Napi::BigInt OpenMemory(const Napi::CallbackInfo& info) {
         buffer.Length()
     );
 
-    return Napi::BigInt::New(env, stream_handle);
+    return HandleToValue(env, stream_handle);
 }
 
 /**
@@ -77,9 +76,8 @@ Napi::Value DropStream(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t stream_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t stream_handle = HandleFromValue(info[1]);
 
     fz_drop_stream(ctx_handle, stream_handle);
 
@@ -103,9 +101,8 @@ Napi::Number Read(const Napi::CallbackInfo& info) {
         return Napi::Number::New(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t stream_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t stream_handle = HandleFromValue(info[1]);
     Napi::Buffer<uint8_t> buffer = info[2].As<Napi::Buffer<uint8_t>>();
 
     size_t bytes_read = fz_read(
@@ -134,15 +131,71 @@ Napi::Number ReadByte(const Napi::CallbackInfo& info) {
         return Napi::Number::New(env, -1);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t stream_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t stream_handle = HandleFromValue(info[1]);
 
     int32_t byte = fz_read_byte(ctx_handle, stream_handle);
 
     return Napi::Number::New(env, byte);
 }
 
+/**
+ * Peek at up to max bytes without consuming them
+ *
+ * One call hands back a whole window for bulk parsing in place of a
+ * readByte() per byte; pair it with consume() for the bytes used. The
+ * window is copied out, since a JS buffer may outlive the stream.
+ *
+ * @param ctx - Context handle
+ * @param stream - Stream handle
+ * @param max - Largest window wanted
+ * @returns Buffer of the next bytes (empty at EOF)
+ */
+Napi::Value Peek(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 3) {
+        Napi::TypeError::New(env, "Expected 3 arguments: ctx, stream, max")
+            .ThrowAsJavaScriptException();
+        return env.Undefined();
+    }
+
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t stream_handle = HandleFromValue(info[1]);
+    size_t max = static_cast<size_t>(info[2].As<Napi::Number>().Int64Value());
+
+    size_t len = 0;
+    const unsigned char* data = fz_peek_bytes(ctx_handle, stream_handle, max, &len);
+
+    return Napi::Buffer<uint8_t>::Copy(env, data, data ? len : 0);
+}
+
+/**
+ * Consume bytes of a peeked window
+ *
+ * @param ctx - Context handle
+ * @param stream - Stream handle
+ * @param n - Number of bytes to move past
+ * @returns Number of bytes consumed
+ */
+Napi::Number Consume(const Napi::CallbackInfo& info) {
+    Napi::Env env = info.Env();
+
+    if (info.Length() < 3) {
+        Napi::TypeError::New(env, "Expected 3 arguments: ctx, stream, n")
+            .ThrowAsJavaScriptException();
+        return Napi::Number::New(env, 0);
+    }
+
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t stream_handle = HandleFromValue(info[1]);
+    size_t n = static_cast<size_t>(info[2].As<Napi::Number>().Int64Value());
+
+    size_t consumed = fz_consume(ctx_handle, stream_handle, n);
+
+    return Napi::Number::New(env, consumed);
+}
+
 /**
  * Check if stream is at end-of-file
  *
@@ -159,9 +212,8 @@ Napi::Boolean IsEOF(const Napi::CallbackInfo& info) {
         return Napi::Boolean::New(env, true);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t stream_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t stream_handle = HandleFromValue(info[1]);
 
     int32_t is_eof = fz_is_eof(ctx_handle, stream_handle);
 
@@ -185,9 +237,8 @@ Napi::Value Seek(const Napi::CallbackInfo& info) {
         return env.Undefined();
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t stream_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t stream_handle = HandleFromValue(info[1]);
     int64_t offset = info[2].As<Napi::Number>().Int64Value();
     int32_t whence = info[3].As<Napi::Number>().Int32Value();
 
@@ -212,9 +263,8 @@ Napi::Number Tell(const Napi::CallbackInfo& info) {
         return Napi::Number::New(env, 0);
     }
 
-    bool lossless;
-    uint64_t ctx_handle = info[0].As<Napi::BigInt>().Uint64Value(&lossless);
-    uint64_t stream_handle = info[1].As<Napi::BigInt>().Uint64Value(&lossless);
+    uint64_t ctx_handle = HandleFromValue(info[0]);
+    uint64_t stream_handle = HandleFromValue(info[1]);
 
     int64_t position = fz_tell(ctx_handle, stream_handle);
 
@@ -230,6 +280,8 @@ Napi::Object InitStream(Napi::Env env, Napi::Object exports) {
     exports.Set("dropStream", Napi::Function::New(env, DropStream));
     exports.Set("read", Napi::Function::New(env, Read));
     exports.Set("readByte", Napi::Function::New(env, ReadByte));
+    exports.Set("peek", Napi::Function::New(env, Peek));
+    exports.Set("consume", Napi::Function::New(env, Consume));
     exports.Set("isEOF", Napi::Function::New(env, IsEOF));
     exports.Set("seek", Napi::Function::New(env, Seek));
     exports.Set("tell", Napi::Function::New(env, Tell));
@@ -35,20 +35,42 @@
  * ```
  */
 
+import type { Writable } from 'node:stream';
 import { Buffer } from './buffer.js';
 import { Colorspace } from './colorspace.js';
 import { Rect, Matrix, Quad } from './geometry.js';
 import { native } from './native.js';
-import type { NativeContext, NativeDocument, NativePage, NativeRect } from './native.js';
+import type {
+  NativeContext,
+  NativeDocument,
+  NativePage,
+  NativeRect,
+  NativeRenderOptions,
+  NativeRenderedPage
+} from './native.js';
 import { Pixmap } from './pixmap.js';
 import {
   type RenderOptions,
   type ExtendedRenderOptions,
+  type BatchRenderOptions,
+  type StreamRenderOptions,
+  type RenderedPage,
+  type ThumbnailSheetOptions,
+  type ThumbnailJPEGOptions,
+  type ThumbnailSheet,
+  type RenderIntoOptions,
   mergeRenderOptions,
   validateRenderOptions,
   dpiToScale
 } from './render-options.js';
-import { MicroPDFError, LinkDestType, type Link, type RectLike, type MatrixLike } from './types.js';
+import {
+  MicroPDFError,
+  LinkDestType,
+  type DocumentInspection,
+  type Link,
+  type RectLike,
+  type MatrixLike
+} from './types.js';
 
 /**
  * An item in the document outline (table of contents / bookmarks).
@@ -252,6 +274,44 @@ export interface TextSpan {
   readonly color: number[];
 }
 
+/**
+ * Options for extracting the text of a whole document
+ *
+ * @example
+ * ```typescript
+ * await doc.extractPagesText((page, text) => index.add(page, text), { concurrency: 4 });
+ * ```
+ */
+export interface DocumentTextOptions {
+  /** 'text' for plain text, 'json' for blocks and lines with bboxes, @default 'text' */
+  format?: 'text' | 'json';
+  /** Number of extraction threads, @default the number of hardware threads */
+  concurrency?: number;
+  /** Pages extracted ahead of the consumer before extraction pauses, @default 8 */
+  maxInFlight?: number;
+}
+
+/**
+ * Convert merged render options to the shape the native renderer expects
+ */
+function toNativeRenderOptions(
+  m: Matrix,
+  opts: Required<RenderOptions>
+): NativeRenderOptions {
+  return {
+    matrix: { a: m.a, b: m.b, c: m.c, d: m.d, e: m.e, f: m.f },
+    colorspace: {
+      name: opts.colorspace.name,
+      n: opts.colorspace.n,
+      type: opts.colorspace.type.toString()
+    },
+    alpha: opts.alpha,
+    antiAlias: opts.antiAlias,
+    renderAnnotations: opts.renderAnnotations,
+    renderFormFields: opts.renderFormFields
+  };
+}
+
 /**
  * A page in a PDF document.
  *
@@ -390,8 +450,44 @@ export class Page {
       alpha
     );
 
-    // Convert native pixmap to TypeScript Pixmap
-    return Pixmap.create(colorspace, nativePixmap.width, nativePixmap.height, alpha);
+    return Pixmap.fromSamples(
+      colorspace,
+      nativePixmap.width,
+      nativePixmap.height,
+      nativePixmap.alpha,
+      nativePixmap.samples
+    );
+  }
+
+  /**
+   * Render the page straight into caller-owned memory
+   *
+   * Nothing is copied: the native renderer writes the pixels into `target`
+   * (a canvas `ImageData.data`, a view on shared memory, ...). The top-left
+   * corner of the transformed page is the first pixel; a target smaller
+   * than the page receives its top-left part.
+   *
+   * @throws RangeError when `target` is smaller than `stride * height`
+   * @throws Error when native bindings are not available or rendering fails
+   */
+  renderInto(target: Uint8ClampedArray | Uint8Array, options: RenderIntoOptions): void {
+    if (!this._ctx || !this._page) {
+      throw new Error('Rendering into a buffer requires native FFI bindings');
+    }
+
+    const m = Matrix.from(options.matrix ?? Matrix.IDENTITY);
+    const colorspace = options.colorspace ?? Colorspace.deviceRGB();
+    native.renderPageInto(
+      this._ctx,
+      this._page,
+      { a: m.a, b: m.b, c: m.c, d: m.d, e: m.e, f: m.f },
+      { name: colorspace.name, n: colorspace.n, type: colorspace.type.toString() },
+      options.alpha ?? false,
+      target,
+      options.width,
+      options.height,
+      options.stride
+    );
   }
 
   /**
@@ -413,6 +509,82 @@ export class Page {
     return new Uint8Array(pngBuffer);
   }
 
+  /**
+   * Render the page to a pixmap without blocking the event loop
+   *
+   * Rasterization runs on the libuv thread pool via the native addon.
+   * @throws Error when native bindings are not available
+   */
+  async toPixmapAsync(
+    matrix: MatrixLike = Matrix.IDENTITY,
+    colorspace: Colorspace = Colorspace.deviceRGB(),
+    alpha: boolean = true
+  ): Promise<Pixmap> {
+    if (!this._ctx || !this._page) {
+      throw new Error(
+        'Page rendering requires native FFI bindings (fz_run_page, fz_new_bbox_device)'
+      );
+    }
+
+    const m = Matrix.from(matrix);
+    const nativeMatrix = {
+      a: m.a,
+      b: m.b,
+      c: m.c,
+      d: m.d,
+      e: m.e,
+      f: m.f
+    };
+
+    const nativeColorspace = {
+      name: colorspace.name,
+      n: colorspace.n,
+      type: colorspace.type.toString()
+    };
+
+    const nativePixmap = await native.renderPageAsync(
+      this._ctx,
+      this._page,
+      nativeMatrix,
+      nativeColorspace,
+      alpha
+    );
+
+    return Pixmap.fromSamples(
+      colorspace,
+      nativePixmap.width,
+      nativePixmap.height,
+      nativePixmap.alpha,
+      nativePixmap.samples
+    );
+  }
+
+  /**
+   * Render the page to PNG without blocking the event loop
+   *
+   * Rasterization and PNG encoding both run on the libuv thread pool.
+   * @throws Error when native bindings are not available
+   */
+  async toPNGAsync(dpi: number = 72): Promise<Uint8Array> {
+    if (!this._ctx || !this._page) {
+      throw new Error('PNG encoding requires native FFI bindings (fz_save_pixmap_as_png)');
+    }
+
+    const nativeColorspace = {
+      name: 'DeviceRGB',
+      n: 3,
+      type: 'RGB'
+    };
+
+    const pngBuffer = await native.renderPageToPNGAsync(
+      this._ctx,
+      this._page,
+      dpi,
+      nativeColorspace
+    );
+    return new Uint8Array(pngBuffer);
+  }
+
   /**
    * Render page with advanced options
    *
@@ -457,9 +629,18 @@ export class Page {
       ? opts.transform
       : Matrix.scale(dpiToScale(opts.dpi), dpiToScale(opts.dpi));
 
-    // Use existing toPixmap method with derived parameters
-    // TODO: In future, pass antiAlias level, renderAnnotations, renderFormFields through FFI
-    return this.toPixmap(matrix, opts.colorspace, opts.alpha);
+    const nativePixmap = native.renderPageWithOptions(
+      this._ctx,
+      this._page,
+      toNativeRenderOptions(Matrix.from(matrix), opts)
+    );
+    return Pixmap.fromSamples(
+      opts.colorspace,
+      nativePixmap.width,
+      nativePixmap.height,
+      nativePixmap.alpha,
+      nativePixmap.samples
+    );
   }
 
   /**
@@ -488,48 +669,87 @@ export class Page {
    * ```
    */
   async renderWithProgress(options: ExtendedRenderOptions = {}): Promise<Pixmap> {
-    return new Promise((resolve, reject) => {
-      // const startTime = Date.now(); // TODO: Use for progress tracking
-      let timeoutId: NodeJS.Timeout | undefined;
-
-      // Set up timeout if specified
-      if (options.timeout) {
-        timeoutId = setTimeout(() => {
-          const error = 'Rendering timeout exceeded';
-          if (options.onError) {
-            options.onError(error);
-          }
-          reject(new Error(error));
-        }, options.timeout);
+    try {
+      if (!this._ctx || !this._page) {
+        throw new Error('Rendering requires native FFI bindings');
       }
 
-      try {
-        // For now, perform synchronous render
-        // TODO: Implement async rendering with FFI progress callbacks
-        const pixmap = this.renderWithOptions(options);
+      validateRenderOptions(options);
+      const opts = mergeRenderOptions(options);
+      const m = opts.transform
+        ? Matrix.from(opts.transform)
+        : Matrix.scale(dpiToScale(opts.dpi), dpiToScale(opts.dpi));
+
+      // The native side renders off the event loop; a timeout aborts the
+      // render through a cookie and rejects with the partial progress.
+      const nativePixmap = await native.renderPageWithOptionsAsync(this._ctx, this._page, {
+        ...toNativeRenderOptions(m, opts),
+        timeout: options.timeout ?? 0
+      });
+
+      if (options.onProgress) {
+        options.onProgress(100, 100);
+      }
 
-        // Simulate progress callback
-        if (options.onProgress) {
-          options.onProgress(100, 100);
-        }
+      return Pixmap.fromSamples(
+        opts.colorspace,
+        nativePixmap.width,
+        nativePixmap.height,
+        nativePixmap.alpha,
+        nativePixmap.samples
+      );
+    } catch (error) {
+      const errorMsg = error instanceof Error ? error.message : String(error);
+      if (options.onError) {
+        options.onError(errorMsg);
+      }
+      throw error;
+    }
+  }
 
-        if (timeoutId) {
-          clearTimeout(timeoutId);
-        }
+  /**
+   * Render the page as PNG straight into a writable stream
+   *
+   * The page is rasterized and encoded one band at a time off the event
+   * loop, and each chunk is written as soon as it is ready, so a large page
+   * never needs a full-page pixmap or PNG in memory. Rendering waits while
+   * the stream is applying backpressure. The stream is not ended.
+   *
+   * @returns Number of bytes written
+   * @throws Error when native bindings are not available, rendering fails, or the stream errors
+   *
+   * @example
+   * ```typescript
+   * const out = createWriteStream('poster.png');
+   * await page.renderToPNGStream(out, { dpi: 1200, bandHeight: 128 });
+   * out.end();
+   * ```
+   */
+  async renderToPNGStream(stream: Writable, options: StreamRenderOptions = {}): Promise<number> {
+    if (!this._ctx || !this._page) {
+      throw new Error('Streaming rendering requires native FFI bindings (fz_band_writer)');
+    }
 
-        resolve(pixmap);
-      } catch (error) {
-        if (timeoutId) {
-          clearTimeout(timeoutId);
-        }
+    validateRenderOptions(options);
+    const opts = mergeRenderOptions(options);
+    const m = opts.transform
+      ? Matrix.from(opts.transform)
+      : Matrix.scale(dpiToScale(opts.dpi), dpiToScale(opts.dpi));
 
-        const errorMsg = error instanceof Error ? error.message : String(error);
-        if (options.onError) {
-          options.onError(errorMsg);
-        }
-        reject(error);
-      }
-    });
+    return native.renderPageToPNGStream(
+      this._ctx,
+      this._page,
+      {
+        ...toNativeRenderOptions(m, opts),
+        ...(options.bandHeight !== undefined && { bandHeight: options.bandHeight }),
+        timeout: options.timeout ?? 0
+      },
+      (chunk) =>
+        new Promise<void>((resolve, reject) => {
+          // Resolving once the chunk is flushed lets the stream throttle rendering
+          stream.write(chunk, (error) => (error ? reject(error) : resolve()));
+        })
+    );
   }
 
   /**
@@ -936,6 +1156,24 @@ export class Document {
     return result !== null ? result : undefined;
   }
 
+  /**
+   * Catalogue the document in one native call
+   *
+   * Gathers metadata, page sizes, labels and links, the outline, fonts and
+   * image counts without loading any page content.
+   * @throws Error when native bindings are not available
+   */
+  inspect(): DocumentInspection {
+    if (!this._ctx || !this._doc) {
+      throw new Error('Document inspection requires native FFI bindings (fz_inspect_document)');
+    }
+    const json = native.inspectDocument(this._ctx, this._doc);
+    if (json === null) {
+      throw MicroPDFError.generic('Failed to inspect document');
+    }
+    return JSON.parse(json) as DocumentInspection;
+  }
+
   /**
    * Count chapters in the document (for structured documents)
    */
@@ -1011,6 +1249,237 @@ export class Document {
     return this.getPage(index);
   }
 
+  /**
+   * Get the bounds of every page without loading any
+   *
+   * Read from the page index: each page's crop box clipped to its media box,
+   * scaled by `/UserUnit` and rotated, as `Page.bounds` would give it.
+   * @returns Four floats per page (x0, y0, x1, y1), in page order
+   * @throws Error when native bindings are not available or the document has no page tree
+   */
+  getPageBounds(): Float32Array {
+    if (!this._ctx || !this._doc) {
+      throw new Error('Page bounds lookup requires native FFI bindings (pdf_bound_pages)');
+    }
+    const boxes = native.boundPages(this._ctx, this._doc);
+    if (boxes === null) {
+      throw MicroPDFError.format('Document has no page tree');
+    }
+    return boxes;
+  }
+
+  /**
+   * Render a range of pages natively and in parallel
+   *
+   * Pages are rasterized (and PNG-encoded) on native threads and yielded in
+   * completion order as they finish. Breaking out of the loop stops the
+   * batch after the page in flight.
+   *
+   * @throws Error when native bindings are not available, a page fails, or the batch times out
+   */
+  async *renderPages(options: BatchRenderOptions = {}): AsyncGenerator<RenderedPage> {
+    if (!this._ctx || !this._doc) {
+      throw new Error('Batch rendering requires native FFI bindings');
+    }
+
+    validateRenderOptions(options);
+    const opts = mergeRenderOptions(options);
+    const m = opts.transform
+      ? Matrix.from(opts.transform)
+      : Matrix.scale(dpiToScale(opts.dpi), dpiToScale(opts.dpi));
+
+    const queue: NativeRenderedPage[] = [];
+    let wake: (() => void) | undefined;
+    let settled = false;
+    let stopped = false;
+    let failure: unknown;
+
+    const stop = new Error('renderPages consumer stopped');
+    const batch = native
+      .renderPages(
+        this._ctx,
+        this._doc,
+        { start: options.start ?? 0, end: options.end ?? this.pageCount },
+        {
+          ...toNativeRenderOptions(m, opts),
+          format: options.format ?? 'png',
+          ...(options.concurrency !== undefined && { concurrency: options.concurrency }),
+          timeout: options.timeout ?? 0
+        },
+        (page) => {
+          // Throwing aborts the native batch
+          if (stopped) {
+            throw stop;
+          }
+          queue.push(page);
+          wake?.();
+        }
+      )
+      .then(
+        () => undefined,
+        (error: unknown) => {
+          failure = error;
+        }
+      )
+      .finally(() => {
+        settled = true;
+        wake?.();
+      });
+
+    try {
+      for (;;) {
+        const next = queue.shift();
+        if (next) {
+          if (next.error !== undefined) {
+            throw new Error(`Failed to render page ${next.page}: ${next.error}`);
+          }
+          yield {
+            page: next.page,
+            width: next.width!,
+            height: next.height!,
+            ...(next.png && { png: new Uint8Array(next.png) }),
+            ...(next.pixmap && { pixmap: next.pixmap._handle })
+          };
+          continue;
+        }
+        if (settled) {
+          break;
+        }
+        await new Promise<void>((resolve) => {
+          wake = resolve;
+        });
+        wake = undefined;
+      }
+    } finally {
+      stopped = true;
+    }
+
+    await batch;
+    if (failure !== undefined && failure !== stop) {
+      throw failure;
+    }
+  }
+
+  /**
+   * Render every page into one thumbnail sprite sheet
+   *
+   * All pages render natively and in parallel in a single call.
+   *
+   * @throws Error when native bindings are not available or rendering fails
+   */
+  async renderThumbnailSheet(options: ThumbnailSheetOptions = {}): Promise<ThumbnailSheet> {
+    if (!this._ctx || !this._doc) {
+      throw new Error('Thumbnail rendering requires native FFI bindings');
+    }
+
+    const result = await native.renderThumbnails(this._ctx, this._doc, {
+      maxSize: options.maxSize ?? 128,
+      gray: options.gray ?? false,
+      format: options.format ?? 'png',
+      ...(options.columns !== undefined && { columns: options.columns }),
+      ...(options.concurrency !== undefined && { concurrency: options.concurrency })
+    });
+
+    return {
+      width: result.width!,
+      height: result.height!,
+      rects: result.rects!.map((r) => ({
+        x: r.x0,
+        y: r.y0,
+        width: r.x1 - r.x0,
+        height: r.y1 - r.y0
+      })),
+      ...(result.png && { png: new Uint8Array(result.png) }),
+      ...(result.pixmap && { pixmap: result.pixmap._handle })
+    };
+  }
+
+  /**
+   * Render every page to its own small JPEG
+   *
+   * All pages render natively and in parallel in a single call. Entries are
+   * null for pages that failed to render.
+   *
+   * @throws Error when native bindings are not available or rendering fails
+   */
+  async renderThumbnailJPEGs(
+    options: ThumbnailJPEGOptions = {}
+  ): Promise<Array<Uint8Array | null>> {
+    if (!this._ctx || !this._doc) {
+      throw new Error('Thumbnail rendering requires native FFI bindings');
+    }
+
+    const result = await native.renderThumbnails(this._ctx, this._doc, {
+      maxSize: options.maxSize ?? 128,
+      gray: options.gray ?? false,
+      format: 'jpeg',
+      ...(options.quality !== undefined && { quality: options.quality }),
+      ...(options.concurrency !== undefined && { concurrency: options.concurrency })
+    });
+
+    return result.jpegs!.map((jpeg) => (jpeg ? new Uint8Array(jpeg) : null));
+  }
+
+  /**
+   * Extract the text of every page through one native call
+   *
+   * Pages are extracted in parallel but handed to `onPage` one at a time in
+   * page order, with null text for pages that failed to load. Only
+   * `maxInFlight` pages are held at once; returning a promise from `onPage`
+   * holds back later pages until it settles, so indexing a large corpus
+   * runs in bounded memory. A throw or rejection stops the extraction.
+   *
+   * @returns Number of pages extracted
+   * @throws Error when native bindings are not available or extraction fails
+   */
+  async extractPagesText(
+    onPage: (page: number, text: string | null) => void | Promise<void>,
+    options: DocumentTextOptions = {}
+  ): Promise<number> {
+    if (!this._ctx || !this._doc) {
+      throw new Error('Document text extraction requires native FFI bindings');
+    }
+
+    return native.extractDocumentText(
+      this._ctx,
+      this._doc,
+      {
+        format: options.format ?? 'text',
+        ...(options.concurrency !== undefined && { concurrency: options.concurrency }),
+        ...(options.maxInFlight !== undefined && { maxInFlight: options.maxInFlight })
+      },
+      onPage
+    );
+  }
+
+  /**
+   * Fill form fields by full name through one native call
+   *
+   * Every value is applied before anything else happens; the form's
+   * calculations then run once and the appearances of all changed fields
+   * are regenerated together, so filling hundreds of fields costs about
+   * as much as filling one. Check boxes and radio buttons take the name of
+   * the state to turn on, or 'Off'. Names that match no field are skipped.
+   *
+   * @returns Number of fields set
+   * @throws Error when native bindings are not available or the document can't be read
+   */
+  fillForm(values: Record<string, string | number | boolean>): number {
+    if (!this._ctx || !this._doc) {
+      throw new Error('Form filling requires native FFI bindings');
+    }
+
+    const strings: Record<string, string> = {};
+    for (const [name, value] of Object.entries(values)) {
+      strings[name] = String(value);
+    }
+    const filled = native.fillForm(this._ctx, this._doc, strings);
+    if (filled < 0) {
+      throw new Error('Failed to fill form: document could not be read');
+    }
+    return filled;
+  }
+
   /**
    * Check if the document needs a password (method form for API compatibility)
    */
@@ -127,6 +127,11 @@ export {
   type PageLocation,
   LinkDestType,
   type OutlineItem as OutlineItemType,
+  type DocumentInspection,
+  type InspectedOutlineItem,
+  type InspectedFont,
+  type InspectedLink,
+  type InspectedPage,
 
   // PDF object types
   PdfObjectType,
@@ -179,7 +184,7 @@ export { Stream, AsyncStream } from './stream.js';
 // Document
 // ============================================================================
 
-export { Document, Page, OutlineItem } from './document.js';
+export { Document, Page, OutlineItem, type DocumentTextOptions } from './document.js';
 
 // ============================================================================
 // PDF Objects
@@ -324,6 +329,14 @@ export { Colorspace, ColorspaceType } from './colorspace.js';
 
 export {
   type ExtendedRenderOptions,
+  type BatchRenderOptions,
+  type StreamRenderOptions,
+  type RenderedPage,
+  type ThumbnailOptions,
+  type ThumbnailSheetOptions,
+  type ThumbnailJPEGOptions,
+  type ThumbnailSheet,
+  type RenderIntoOptions,
   type RenderProgressCallback,
   type RenderErrorCallback,
   AntiAliasLevel,
@@ -23,6 +23,7 @@ export interface NativeAddon {
   // Context
   createContext(): NativeContext;
   dropContext(ctx: NativeContext): void;
+  getPerfCounters(ctx: NativeContext): NativePerfCounters;
 
   // Document
   openDocument(ctx: NativeContext, data: globalThis.Buffer, magic?: string): NativeDocument;
@@ -32,15 +33,20 @@ export interface NativeAddon {
   loadPage(ctx: NativeContext, doc: NativeDocument, pageNum: number): NativePage;
   dropPage(ctx: NativeContext, page: NativePage): void;
   boundPage(ctx: NativeContext, page: NativePage): NativeRect;
+  boundPages(ctx: NativeContext, doc: NativeDocument): Float32Array | null;
 
   // Document metadata
   getMetadata(ctx: NativeContext, doc: NativeDocument, key: string): string | null;
+  inspectDocument(ctx: NativeContext, doc: NativeDocument): string | null;
   setMetadata(ctx: NativeContext, doc: NativeDocument, key: string, value: string): void;
 
   // Document writing
   saveDocument(ctx: NativeContext, doc: NativeDocument, path: string, options?: string): void;
   writeDocument(ctx: NativeContext, doc: NativeDocument): globalThis.Buffer;
 
+  // Forms (values by full field name; calculations and appearances done once)
+  fillForm(ctx: NativeContext, doc: NativeDocument, values: Record<string, string>): number;
+
   // PDF Merging (Enhanced API)
   npMergePDFs(ctx: NativeContext, paths: string[], count: number, outputPath: string): number;
 
@@ -58,6 +64,82 @@ export interface NativeAddon {
     dpi: number,
     colorspace: NativeColorspace
   ): globalThis.Buffer;
+  renderPageWithOptions(
+    ctx: NativeContext,
+    page: NativePage,
+    options: NativeRenderOptions
+  ): NativePixmap;
+
+  // Async rendering (runs off the event loop; cookie is a handle from newCookie)
+  renderPageAsync(
+    ctx: NativeContext,
+    page: NativePage,
+    matrix: NativeMatrix,
+    colorspace: NativeColorspace,
+    alpha: boolean,
+    cookie?: number
+  ): Promise<NativePixmap>;
+  renderPageToPNGAsync(
+    ctx: NativeContext,
+    page: NativePage,
+    dpi: number,
+    colorspace: NativeColorspace,
+    cookie?: number
+  ): Promise<globalThis.Buffer>;
+  renderPageWithOptionsAsync(
+    ctx: NativeContext,
+    page: NativePage,
+    options: NativeRenderOptions,
+    cookie?: number
+  ): Promise<NativePixmap>;
+  renderPages(
+    ctx: NativeContext,
+    doc: NativeDocument,
+    range: { start?: number; end?: number },
+    options: NativeBatchRenderOptions,
+    onPage: (page: NativeRenderedPage) => void,
+    cookie?: number
+  ): Promise<number>;
+  renderPageToPNGStream(
+    ctx: NativeContext,
+    page: NativePage,
+    options: NativeStreamRenderOptions,
+    onChunk: (chunk: globalThis.Buffer) => void | Promise<void>,
+    cookie?: number
+  ): Promise<number>;
+
+  // Render pool (worker threads on cloned contexts, shared store and glyph cache)
+  createRenderPool(ctx: NativeContext, threads?: number): NativeRenderPool;
+  dropRenderPool(ctx: NativeContext, pool: NativeRenderPool): void;
+  renderPoolSubmit(
+    ctx: NativeContext,
+    pool: NativeRenderPool,
+    doc: NativeDocument,
+    pageNum: number,
+    options?: NativeRenderOptions
+  ): number;
+  renderPoolCancel(ctx: NativeContext, pool: NativeRenderPool, job: number): boolean;
+  renderPoolWait(ctx: NativeContext, pool: NativeRenderPool, job: number): Promise<NativePixmap>;
+
+  // Whole-document thumbnails (one sprite sheet or one JPEG per page)
+  renderThumbnails(
+    ctx: NativeContext,
+    doc: NativeDocument,
+    options: NativeThumbnailOptions
+  ): Promise<NativeThumbnails>;
+
+  // Render straight into caller-owned memory (no copy out of a pixmap)
+  renderPageInto(
+    ctx: NativeContext,
+    page: NativePage,
+    matrix: NativeMatrix,
+    colorspace: NativeColorspace | null,
+    alpha: boolean,
+    target: Uint8ClampedArray | Uint8Array,
+    width: number,
+    height: number,
+    stride?: number
+  ): void;
 
   // Text extraction
   extractText(ctx: NativeContext, page: NativePage): string;
@@ -68,6 +150,12 @@ export interface NativeAddon {
     text: string;
     bbox: NativeRect;
   }>;
+  extractDocumentText(
+    ctx: NativeContext,
+    doc: NativeDocument,
+    options: NativeDocumentTextOptions,
+    onPage: (page: number, text: string | null) => void | Promise<void>
+  ): Promise<number>;
   searchText(
     ctx: NativeContext,
     page: NativePage,
@@ -91,6 +179,7 @@ export interface NativeAddon {
     lr: { x: number; y: number };
   }>;
   getSTextPageBounds(ctx: NativeContext, stext: NativeSTextPage): NativeRect;
+  getSTextPageFlat(ctx: NativeContext, stext: NativeSTextPage): NativeSTextFlat | null;
 
   // Links
   getPageLinks(
@@ -316,6 +405,16 @@ export interface NativeSTextPage {
   _handle: number; // Opaque handle
 }
 
+/**
+ * Whole-page structured text packed into views over one ArrayBuffer
+ */
+export interface NativeSTextFlat {
+  quads: Float32Array; // 8 floats per char: ul, ur, ll, lr
+  codepoints: Uint32Array; // One per char
+  lineOffsets: Uint32Array; // First char of each line, then total chars
+  blockOffsets: Uint32Array; // First line of each block, then total lines
+}
+
 export interface NativePoint {
   x: number;
   y: number;
@@ -357,6 +456,114 @@ export interface NativeColorspace {
   type: string;
 }
 
+/**
+ * Options accepted by the native renderPageWithOptions* entry points
+ */
+export interface NativeRenderOptions {
+  dpi?: number;
+  matrix?: NativeMatrix;
+  colorspace?: NativeColorspace;
+  alpha?: boolean;
+  antiAlias?: number;
+  timeout?: number;
+  renderAnnotations?: boolean;
+  renderFormFields?: boolean;
+}
+
+/**
+ * Options accepted by the native renderPages batch entry point
+ */
+export interface NativeBatchRenderOptions extends NativeRenderOptions {
+  format?: 'png' | 'pixmap';
+  concurrency?: number;
+}
+
+/**
+ * Options accepted by the native renderPageToPNGStream entry point
+ */
+export interface NativeStreamRenderOptions extends NativeRenderOptions {
+  bandHeight?: number;
+}
+
+/**
+ * Snapshot of the native performance counters (process wide, monotonic)
+ */
+export interface NativePerfCounters {
+  bytesInflated: number;
+  imagesDecoded: number;
+  imagePixelsDecoded: number;
+  imageDecodeNs: number;
+  glyphsRasterized: number;
+  pathsFilled: number;
+  pathsStroked: number;
+  operatorsInterpreted: number;
+  storeHits: number;
+  storeMisses: number;
+  glyphCacheHits: number;
+  glyphCacheMisses: number;
+  documentLookups: number;
+  pageLookups: number;
+  pixmapLookups: number;
+  imageLookups: number;
+  fontLookups: number;
+  bufferLookups: number;
+  stextPageLookups: number;
+}
+
+/**
+ * Native render pool handle
+ */
+export interface NativeRenderPool {
+  _handle: number; // Opaque handle
+  threads: number;
+}
+
+/**
+ * Options accepted by the native renderThumbnails entry point
+ */
+export interface NativeThumbnailOptions {
+  maxSize: number;
+  gray?: boolean;
+  format?: 'png' | 'pixmap' | 'jpeg';
+  columns?: number;
+  quality?: number;
+  concurrency?: number;
+}
+
+/**
+ * Result of renderThumbnails: a sprite sheet with one rect per page, or
+ * one JPEG per page (null for pages that failed)
+ */
+export interface NativeThumbnails {
+  width?: number;
+  height?: number;
+  png?: globalThis.Buffer;
+  pixmap?: { _handle: number; width: number; height: number };
+  rects?: Array<{ x0: number; y0: number; x1: number; y1: number }>;
+  jpegs?: Array<globalThis.Buffer | null>;
+}
+
+/**
+ * Options accepted by the native extractDocumentText entry point
+ */
+export interface NativeDocumentTextOptions {
+  format?: 'text' | 'json';
+  concurrency?: number;
+  maxInFlight?: number;
+}
+
+/**
+ * One page delivered by renderPages (error is set instead of data on failure)
+ */
+export interface NativeRenderedPage {
+  page: number;
+  width?: number;
+  height?: number;
+  png?: globalThis.Buffer;
+  pixmap?: { _handle: number; width: number; height: number };
+  error?: string;
+}
+
 export interface NativePixmap {
   width: number;
   height: number;
@@ -820,6 +1027,7 @@ function createMockAddon(): NativeAddon {
     // Context operations
     createContext: requireFFI('createContext') as () => NativeContext,
     dropContext: requireFFI('dropContext') as (ctx: NativeContext) => void,
+    getPerfCounters: requireFFI('getPerfCounters') as (ctx: NativeContext) => NativePerfCounters,
 
     // Document operations
     openDocument: requireFFI('openDocument') as (
@@ -840,11 +1048,19 @@ function createMockAddon(): NativeAddon {
     ) => NativePage,
     dropPage: requireFFI('dropPage') as (ctx: NativeContext, page: NativePage) => void,
     boundPage: requireFFI('boundPage') as (ctx: NativeContext, page: NativePage) => NativeRect,
+    boundPages: requireFFI('boundPages') as (
+      ctx: NativeContext,
+      doc: NativeDocument
+    ) => Float32Array | null,
     getMetadata: requireFFI('getMetadata') as (
       ctx: NativeContext,
       doc: NativeDocument,
       key: string
     ) => string | null,
+    inspectDocument: requireFFI('inspectDocument') as (
+      ctx: NativeContext,
+      doc: NativeDocument
+    ) => string | null,
     setMetadata: requireFFI('setMetadata') as (
       ctx: NativeContext,
       doc: NativeDocument,
@@ -862,6 +1078,13 @@ function createMockAddon(): NativeAddon {
       doc: NativeDocument
     ) => globalThis.Buffer,
 
+    // Forms
+    fillForm: requireFFI('fillForm') as (
+      ctx: NativeContext,
+      doc: NativeDocument,
+      values: Record<string, string>
+    ) => number,
+
     // PDF Merging (Enhanced API)
     npMergePDFs: requireFFI('npMergePDFs') as (
       ctx: NativeContext,
@@ -884,6 +1107,88 @@ function createMockAddon(): NativeAddon {
       dpi: number,
       colorspace: NativeColorspace
     ) => globalThis.Buffer,
+    renderPageWithOptions: requireFFI('renderPageWithOptions') as (
+      ctx: NativeContext,
+      page: NativePage,
+      options: NativeRenderOptions
+    ) => NativePixmap,
+    renderPageAsync: requireFFI('renderPageAsync') as (
+      ctx: NativeContext,
+      page: NativePage,
+      matrix: NativeMatrix,
+      colorspace: NativeColorspace,
+      alpha: boolean,
+      cookie?: number
+    ) => Promise<NativePixmap>,
+    renderPageToPNGAsync: requireFFI('renderPageToPNGAsync') as (
+      ctx: NativeContext,
+      page: NativePage,
+      dpi: number,
+      colorspace: NativeColorspace,
+      cookie?: number
+    ) => Promise<globalThis.Buffer>,
+    renderPageWithOptionsAsync: requireFFI('renderPageWithOptionsAsync') as (
+      ctx: NativeContext,
+      page: NativePage,
+      options: NativeRenderOptions,
+      cookie?: number
+    ) => Promise<NativePixmap>,
+    renderPages: requireFFI('renderPages') as (
+      ctx: NativeContext,
+      doc: NativeDocument,
+      range: { start?: number; end?: number },
+      options: NativeBatchRenderOptions,
+      onPage: (page: NativeRenderedPage) => void,
+      cookie?: number
+    ) => Promise<number>,
+    renderPageToPNGStream: requireFFI('renderPageToPNGStream') as (
+      ctx: NativeContext,
+      page: NativePage,
+      options: NativeStreamRenderOptions,
+      onChunk: (chunk: globalThis.Buffer) => void | Promise<void>,
+      cookie?: number
+    ) => Promise<number>,
+    createRenderPool: requireFFI('createRenderPool') as (
+      ctx: NativeContext,
+      threads?: number
+    ) => NativeRenderPool,
+    dropRenderPool: requireFFI('dropRenderPool') as (
+      ctx: NativeContext,
+      pool: NativeRenderPool
+    ) => void,
+    renderPoolSubmit: requireFFI('renderPoolSubmit') as (
+      ctx: NativeContext,
+      pool: NativeRenderPool,
+      doc: NativeDocument,
+      pageNum: number,
+      options?: NativeRenderOptions
+    ) => number,
+    renderPoolCancel: requireFFI('renderPoolCancel') as (
+      ctx: NativeContext,
+      pool: NativeRenderPool,
+      job: number
+    ) => boolean,
+    renderPoolWait: requireFFI('renderPoolWait') as (
+      ctx: NativeContext,
+      pool: NativeRenderPool,
+      job: number
+    ) => Promise<NativePixmap>,
+    renderThumbnails: requireFFI('renderThumbnails') as (
+      ctx: NativeContext,
+      doc: NativeDocument,
+      options: NativeThumbnailOptions
+    ) => Promise<NativeThumbnails>,
+    renderPageInto: requireFFI('renderPageInto') as (
+      ctx: NativeContext,
+      page: NativePage,
+      matrix: NativeMatrix,
+      colorspace: NativeColorspace | null,
+      alpha: boolean,
+      target: Uint8ClampedArray | Uint8Array,
+      width: number,
+      height: number,
+      stride?: number
+    ) => void,
 
     // Text extraction
     extractText: requireFFI('extractText') as (ctx: NativeContext, page: NativePage) => string,
@@ -891,6 +1196,12 @@ function createMockAddon(): NativeAddon {
       ctx: NativeContext,
       page: NativePage
     ) => Array<{ text: string; bbox: NativeRect }>,
+    extractDocumentText: requireFFI('extractDocumentText') as (
+      ctx: NativeContext,
+      doc: NativeDocument,
+      options: NativeDocumentTextOptions,
+      onPage: (page: number, text: string | null) => void | Promise<void>
+    ) => Promise<number>,
     searchText: requireFFI('searchText') as (
       ctx: NativeContext,
       page: NativePage,
@@ -926,6 +1237,10 @@ function createMockAddon(): NativeAddon {
       ctx: NativeContext,
       stext: NativeSTextPage
     ) => NativeRect,
+    getSTextPageFlat: requireFFI('getSTextPageFlat') as (
+      ctx: NativeContext,
+      stext: NativeSTextPage
+    ) => NativeSTextFlat | null,
 
     // Links
     getPageLinks: requireFFI('getPageLinks') as (
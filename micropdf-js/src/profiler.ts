@@ -18,6 +18,9 @@
  * ```
  */
 
+import { isMock, native } from './native.js';
+import type { NativeContext, NativePerfCounters } from './native.js';
+
 /** Resource types being tracked */
 export enum ResourceType {
   Context = 0,
@@ -494,3 +497,59 @@ export async function takeHeapSnapshot(filename: string): Promise<boolean> {
     return false;
   }
 }
+
+// ============================================================================
+// Native Performance Counters
+// ============================================================================
+
+/** Snapshot of the native performance counters; every value only grows */
+export type PerfCounters = NativePerfCounters;
+
+const perfCounterNames: Record<keyof PerfCounters, string> = {
+  bytesInflated: 'bytes_inflated',
+  imagesDecoded: 'images_decoded',
+  imagePixelsDecoded: 'image_pixels_decoded',
+  imageDecodeNs: 'image_decode_ns',
+  glyphsRasterized: 'glyphs_rasterized',
+  pathsFilled: 'paths_filled',
+  pathsStroked: 'paths_stroked',
+  operatorsInterpreted: 'operators_interpreted',
+  storeHits: 'store_hits',
+  storeMisses: 'store_misses',
+  glyphCacheHits: 'glyph_cache_hits',
+  glyphCacheMisses: 'glyph_cache_misses',
+  documentLookups: 'document_lookups',
+  pageLookups: 'page_lookups',
+  pixmapLookups: 'pixmap_lookups',
+  imageLookups: 'image_lookups',
+  fontLookups: 'font_lookups',
+  bufferLookups: 'buffer_lookups',
+  stextPageLookups: 'stext_page_lookups'
+};
+
+/**
+ * Snapshot the native performance counters
+ *
+ * The counters are shared by every context, so `ctx` may be omitted.
+ * With the mock addon every value is 0.
+ */
+export function getPerfCounters(ctx: NativeContext = { _handle: 0 }): PerfCounters {
+  if (isMock) {
+    const zero = {} as PerfCounters;
+    for (const key of Object.keys(perfCounterNames) as (keyof PerfCounters)[]) {
+      zero[key] = 0;
+    }
+    return zero;
+  }
+  return native.getPerfCounters(ctx);
+}
+
+/** Format counters in the Prometheus text format, as micropdf_<name>_total */
+export function formatPerfCountersPrometheus(counters: PerfCounters = getPerfCounters()): string {
+  const lines: string[] = [];
+  for (const [key, name] of Object.entries(perfCounterNames) as [keyof PerfCounters, string][]) {
+    lines.push(`# TYPE micropdf_${name}_total counter`);
+    lines.push(`micropdf_${name}_total ${counters[key]}`);
+  }
+  return lines.join('\n') + '\n';
+}
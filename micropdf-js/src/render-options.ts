@@ -176,6 +176,154 @@ export interface ExtendedRenderOptions extends RenderOptions {
   timeout?: number;
 }
 
+/**
+ * Batch rendering options
+ *
+ * Renders a page range natively, in parallel, with one FFI crossing per
+ * batch instead of several per page.
+ *
+ * @example
+ * ```typescript
+ * for await (const page of doc.renderPages({ dpi: 150, start: 0, end: 10 })) {
+ *   writeFileSync(`page-${page.page}.png`, page.png!);
+ * }
+ * ```
+ */
+export interface BatchRenderOptions extends RenderOptions {
+  /** First page to render (0-based), @default 0 */
+  start?: number;
+  /** Page after the last one to render, @default the page count */
+  end?: number;
+  /** Output format, @default 'png' */
+  format?: 'png' | 'pixmap';
+  /** Number of render threads, @default the number of hardware threads */
+  concurrency?: number;
+  /** Timeout for the whole batch in milliseconds, @default undefined (no timeout) */
+  timeout?: number;
+}
+
+/**
+ * Streaming render options
+ *
+ * The page is rendered and PNG-encoded one band of rows at a time, and each
+ * encoded chunk is written to the stream before the next band is drawn.
+ *
+ * @example
+ * ```typescript
+ * await page.renderToPNGStream(createWriteStream('page.png'), { dpi: 600 });
+ * ```
+ */
+export interface StreamRenderOptions extends RenderOptions {
+  /** Rows per band; peak memory is about one band of pixels, @default 64 */
+  bandHeight?: number;
+  /** Timeout for the whole render in milliseconds, @default undefined (no timeout) */
+  timeout?: number;
+}
+
+/**
+ * A page produced by batch rendering
+ *
+ * Pages are delivered in completion order, not page order.
+ */
+export interface RenderedPage {
+  /** Page number (0-based) */
+  page: number;
+  /** Width in pixels */
+  width: number;
+  /** Height in pixels */
+  height: number;
+  /** Encoded PNG, when format is 'png' */
+  png?: Uint8Array;
+  /** Native pixmap handle, when format is 'pixmap' */
+  pixmap?: number;
+}
+
+/**
+ * Whole-document thumbnail options
+ *
+ * Thumbnails render at reduced anti-aliasing, without annotations or form
+ * fields, straight into opaque gray or RGB, with all pages in parallel.
+ *
+ * @example
+ * ```typescript
+ * const sheet = await doc.renderThumbnailSheet({ maxSize: 96, columns: 8 });
+ * const jpegs = await doc.renderThumbnailJPEGs({ maxSize: 160, quality: 70 });
+ * ```
+ */
+export interface ThumbnailOptions {
+  /** Longest edge of each thumbnail in pixels, @default 128 */
+  maxSize?: number;
+  /** Render grayscale instead of RGB, @default false */
+  gray?: boolean;
+  /** Number of render threads, @default the number of hardware threads */
+  concurrency?: number;
+}
+
+/**
+ * Sprite sheet options
+ */
+export interface ThumbnailSheetOptions extends ThumbnailOptions {
+  /** Sheet width in cells, @default a near-square grid */
+  columns?: number;
+  /** Output format, @default 'png' */
+  format?: 'png' | 'pixmap';
+}
+
+/**
+ * Per-page JPEG thumbnail options
+ */
+export interface ThumbnailJPEGOptions extends ThumbnailOptions {
+  /** JPEG quality (1-100), @default 75 */
+  quality?: number;
+}
+
+/**
+ * A sprite sheet of page thumbnails
+ *
+ * The sheet is a grid of maxSize x maxSize cells; page i sits in the
+ * top-left corner of cell i.
+ */
+export interface ThumbnailSheet {
+  /** Sheet width in pixels */
+  width: number;
+  /** Sheet height in pixels */
+  height: number;
+  /** Each page's area within the sheet (empty for pages that failed) */
+  rects: Array<{ x: number; y: number; width: number; height: number }>;
+  /** Encoded PNG, when format is 'png' */
+  png?: Uint8Array;
+  /** Native pixmap handle, when format is 'pixmap' */
+  pixmap?: number;
+}
+
+/**
+ * Options for rendering into caller-owned memory
+ *
+ * The page is drawn straight into the target array, e.g. the `data` of a
+ * canvas `ImageData`, whose pixels are RGBA:
+ *
+ * @example
+ * ```typescript
+ * const image = ctx.createImageData(width, height);
+ * page.renderInto(image.data, { width, height, alpha: true, matrix: Matrix.scale(2, 2) });
+ * ctx.putImageData(image, 0, 0);
+ * ```
+ */
+export interface RenderIntoOptions {
+  /** Target width in pixels */
+  width: number;
+  /** Target height in pixels */
+  height: number;
+  /** Bytes per row, @default width times the component count */
+  stride?: number;
+  /** Page-to-pixel transform, @default identity */
+  matrix?: Matrix;
+  /** Target colorspace, @default Colorspace.deviceRGB() */
+  colorspace?: Colorspace;
+  /** Whether the target has an alpha channel, @default false */
+  alpha?: boolean;
+}
+
 /**
  * Get default render options
  *
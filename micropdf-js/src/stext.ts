@@ -122,9 +122,9 @@ export class STextPage {
   private _handle: { _handle: number };
   private _dropped = false;
 
-  private constructor(ctx: NativeContext | bigint, handle: bigint | { _handle: number }) {
-    this._ctx = typeof ctx === 'bigint' ? { _handle: Number(ctx) } : ctx;
-    this._handle = typeof handle === 'bigint' ? { _handle: Number(handle) } : handle;
+  private constructor(ctx: NativeContext | number, handle: number | { _handle: number }) {
+    this._ctx = typeof ctx === 'number' ? { _handle: ctx } : ctx;
+    this._handle = typeof handle === 'number' ? { _handle: handle } : handle;
   }
 
   /**
@@ -426,6 +426,103 @@ export function countPointsInRect(
   return count;
 }
 
+// ============================================================================
+// Structured Text (flat page export)
+// ============================================================================
+
+/**
+ * Structured text for a whole page as packed arrays.
+ * quads holds 8 floats per char [ulx, uly, urx, ury, llx, lly, lrx, lry];
+ * lineOffsets[i]..lineOffsets[i + 1] are the chars of line i and
+ * blockOffsets[j]..blockOffsets[j + 1] are the lines of block j.
+ */
+export interface FlatSTextPage {
+  quads: Float32Array;
+  codepoints: Uint32Array;
+  lineOffsets: Uint32Array;
+  blockOffsets: Uint32Array;
+}
+
+/**
+ * Number of characters in a flat page.
+ */
+export function flatCharCount(page: FlatSTextPage): number {
+  return page.codepoints.length;
+}
+
+/**
+ * Number of lines in a flat page.
+ */
+export function flatLineCount(page: FlatSTextPage): number {
+  return page.lineOffsets.length - 1;
+}
+
+/**
+ * Number of blocks in a flat page.
+ */
+export function flatBlockCount(page: FlatSTextPage): number {
+  return page.blockOffsets.length - 1;
+}
+
+/**
+ * Codepoints of one line, as a view (no copy).
+ */
+export function flatLineCodepoints(page: FlatSTextPage, line: number): Uint32Array {
+  return page.codepoints.subarray(page.lineOffsets[line]!, page.lineOffsets[line + 1]!);
+}
+
+/**
+ * Quads of one line, as a view (no copy). 8 floats per char.
+ */
+export function flatLineQuads(page: FlatSTextPage, line: number): Float32Array {
+  return page.quads.subarray(page.lineOffsets[line]! * 8, page.lineOffsets[line + 1]! * 8);
+}
+
+/**
+ * Text of one line.
+ */
+export function flatLineText(page: FlatSTextPage, line: number): string {
+  const cps = flatLineCodepoints(page, line);
+  let text = '';
+  for (let i = 0; i < cps.length; i++) {
+    text += String.fromCodePoint(cps[i]!);
+  }
+  return text;
+}
+
+/**
+ * Text of the whole page, with lines separated by newlines and blocks by a
+ * blank line.
+ */
+export function flatPageText(page: FlatSTextPage): string {
+  const blocks: string[] = [];
+  for (let b = 0; b < flatBlockCount(page); b++) {
+    const lines: string[] = [];
+    for (let l = page.blockOffsets[b]!; l < page.blockOffsets[b + 1]!; l++) {
+      lines.push(flatLineText(page, l));
+    }
+    blocks.push(lines.join('\n'));
+  }
+  return blocks.join('\n\n');
+}
+
+/**
+ * Axis-aligned bounds of each char as [x0, y0, x1, y1, ...], in the same
+ * layout as rectsFromCoords.
+ */
+export function flatCharRects(page: FlatSTextPage): Float32Array {
+  const n = flatCharCount(page);
+  const rects = new Float32Array(n * 4);
+  const q = page.quads;
+  for (let i = 0, j = 0; i < n * 8; i += 8, j += 4) {
+    rects[j] = Math.min(q[i]!, q[i + 2]!, q[i + 4]!, q[i + 6]!);
+    rects[j + 1] = Math.min(q[i + 1]!, q[i + 3]!, q[i + 5]!, q[i + 7]!);
+    rects[j + 2] = Math.max(q[i]!, q[i + 2]!, q[i + 4]!, q[i + 6]!);
+    rects[j + 3] = Math.max(q[i + 1]!, q[i + 3]!, q[i + 5]!, q[i + 7]!);
+  }
+  return rects;
+}
+
 // ============================================================================
 // Pixel Operations
 // ============================================================================
@@ -272,6 +272,50 @@ export interface OutlineItem {
   readonly isOpen: boolean;
 }
 
+/**
+ * Document catalogue from a single inspection pass
+ *
+ * Rectangles are `[x0, y0, x1, y1]`; page numbers are 0-based, and fonts
+ * are referenced by their index in `fonts`.
+ */
+export interface DocumentInspection {
+  readonly format: string;
+  readonly page_count: number;
+  readonly metadata: Record<string, string>;
+  readonly outline: InspectedOutlineItem[];
+  readonly fonts: InspectedFont[];
+  readonly image_count: number;
+  readonly pages: InspectedPage[];
+}
+
+export interface InspectedFont {
+  readonly name: string;
+  readonly type: string;
+  readonly embedded: boolean;
+}
+
+export interface InspectedOutlineItem {
+  readonly title: string;
+  readonly page?: number;
+  readonly uri?: string;
+  readonly children: InspectedOutlineItem[];
+}
+
+export interface InspectedLink {
+  readonly rect: [number, number, number, number];
+  readonly page?: number;
+  readonly uri?: string;
+}
+
+export interface InspectedPage {
+  readonly label: string;
+  readonly bounds: [number, number, number, number];
+  readonly rotation: number;
+  readonly links: InspectedLink[];
+  readonly fonts: number[];
+  readonly images: number;
+}
+
 // ============================================================================
 // PDF Object Types
 // ============================================================================
@@ -1,6 +1,7 @@
 /**
  * Tests for Document module
  */
+import { Writable } from 'node:stream';
 import { describe, it, expect } from 'vitest';
 import { Document, Page, OutlineItem, Buffer, Colorspace, Rect, Matrix } from '../src/index.js';
 
@@ -173,6 +174,34 @@ startxref
   });
 });
 
+/**
+ * One-page PDF whose content fills a 100pt red square in the top-left corner
+ */
+function redSquareDocument(): Document {
+  const content = '1 0 0 rg 0 692 100 100 re f';
+  const objects = [
+    '<</Type/Catalog/Pages 2 0 R>>',
+    '<</Type/Pages/Count 1/Kids[3 0 R]>>',
+    '<</Type/Page/MediaBox[0 0 612 792]/Parent 2 0 R/Contents 4 0 R>>',
+    `<</Length ${content.length}>>\nstream\n${content}\nendstream`
+  ];
+
+  let pdf = '%PDF-1.4\n';
+  const offsets: number[] = [];
+  objects.forEach((body, i) => {
+    offsets.push(pdf.length);
+    pdf += `${i + 1} 0 obj ${body} endobj\n`;
+  });
+  const xref = pdf.length;
+  pdf += `xref\n0 ${objects.length + 1}\n0000000000 65535 f \n`;
+  for (const offset of offsets) {
+    pdf += `${String(offset).padStart(10, '0')} 00000 n \n`;
+  }
+  pdf += `trailer <</Root 1 0 R/Size ${objects.length + 1}>>\nstartxref\n${xref}\n%%EOF`;
+
+  return Document.fromBuffer(Buffer.fromString(pdf));
+}
+
 describe('Page', () => {
   let doc: Document;
   let page: Page;
@@ -228,6 +257,18 @@ startxref
       expect(pixmap.height).toBeGreaterThan(0);
     });
 
+    it('should render into caller-owned memory', () => {
+      // Half-scale RGBA, as in a canvas ImageData
+      const width = Math.round(page.bounds.width / 2);
+      const height = Math.round(page.bounds.height / 2);
+      const target = new Uint8ClampedArray(width * height * 4);
+      page.renderInto(target, { width, height, alpha: true, matrix: Matrix.scale(0.5, 0.5) });
+
+      expect(() => page.renderInto(target, { width, height: height + 1, alpha: true })).toThrow(
+        RangeError
+      );
+    });
+
     it('should render to PNG', () => {
       const png = page.toPNG(72); // 72 DPI
 
@@ -235,6 +276,81 @@ startxref
       expect(png[0]).toBe(0x89);
       expect(png[1]).toBe(0x50);
     });
+
+    it('should render to pixmap asynchronously', async () => {
+      const matrix = Matrix.scale(0.5, 0.5);
+      const pixmap = await page.toPixmapAsync(matrix, Colorspace.deviceRGB(), true);
+
+      expect(pixmap.width).toBeGreaterThan(0);
+      expect(pixmap.height).toBeGreaterThan(0);
+    });
+
+    it('should return the rendered pixels from toPixmapAsync', async () => {
+      const painted = redSquareDocument().getPage(0);
+      const pixmap = await painted.toPixmapAsync(
+        Matrix.scale(0.5, 0.5),
+        Colorspace.deviceRGB(),
+        false
+      );
+
+      expect(pixmap.width).toBe(306);
+      expect(pixmap.getPixel(25, 25)).toEqual([255, 0, 0]);
+      expect(pixmap.getPixel(200, 200)).toEqual([255, 255, 255]);
+    });
+
+    it('should render to PNG asynchronously', async () => {
+      const png = await page.toPNGAsync(72);
+
+      expect(png[0]).toBe(0x89);
+      expect(png[1]).toBe(0x50);
+    });
+
+    it('should stream PNG bands into a writable', async () => {
+      const chunks: Uint8Array[] = [];
+      const sink = new Writable({
+        write(chunk: Uint8Array, _encoding, callback) {
+          chunks.push(chunk);
+          callback();
+        }
+      });
+
+      const bytes = await page.renderToPNGStream(sink, { dpi: 36, bandHeight: 32 });
+
+      // Header, one IDAT per band, then the trailer
+      expect(chunks.length).toBeGreaterThan(2);
+      expect(chunks.reduce((n, c) => n + c.length, 0)).toBe(bytes);
+      expect(chunks[0]![0]).toBe(0x89);
+      expect(chunks[0]![1]).toBe(0x50);
+    });
+
+    it('should batch render pages to PNG', async () => {
+      const pages = [];
+      for await (const rendered of doc.renderPages({ dpi: 36 })) {
+        pages.push(rendered);
+      }
+
+      expect(pages.length).toBe(doc.pageCount);
+      expect(pages[0]!.page).toBe(0);
+      expect(pages[0]!.width).toBe(306);
+      expect(pages[0]!.png![0]).toBe(0x89);
+    });
+
+    it('should render a thumbnail sprite sheet', async () => {
+      const sheet = await doc.renderThumbnailSheet({ maxSize: 64, gray: true });
+
+      expect(sheet.rects.length).toBe(doc.pageCount);
+      expect(sheet.rects[0]!.height).toBe(64);
+      expect(sheet.rects[0]!.width).toBeLessThanOrEqual(64);
+      expect(sheet.png![0]).toBe(0x89);
+    });
+
+    it('should render one JPEG thumbnail per page', async () => {
+      const jpegs = await doc.renderThumbnailJPEGs({ maxSize: 48 });
+
+      expect(jpegs.length).toBe(doc.pageCount);
+      expect(jpegs[0]![0]).toBe(0xff);
+      expect(jpegs[0]![1]).toBe(0xd8);
+    });
   });
 
   describe('text extraction', () => {
@@ -248,6 +364,26 @@ startxref
       const blocks = page.getTextBlocks();
       expect(Array.isArray(blocks)).toBe(true);
     });
+
+    it('should extract every page in order', async () => {
+      const seen: number[] = [];
+      const count = await doc.extractPagesText(
+        async (n, text) => {
+          seen.push(n);
+          expect(typeof text).toBe('string');
+        },
+        { format: 'json', concurrency: 2, maxInFlight: 1 }
+      );
+
+      expect(count).toBe(doc.pageCount);
+      expect(seen).toEqual([...Array(doc.pageCount).keys()]);
+    });
+  });
+
+  describe('forms', () => {
+    it('should skip names that match no field', () => {
+      expect(doc.fillForm({ 'no.such.field': 'value' })).toBe(0);
+    });
   });
 
   describe('links', () => {
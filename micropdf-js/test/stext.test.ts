@@ -62,7 +62,7 @@ describe('STextPage', () => {
 
       const stext = STextPage.fromPage(page);
       expect(stext.handle).toBeDefined();
-      expect(typeof stext.handle).toBe('bigint');
+      expect(typeof stext.handle._handle).toBe('number');
       stext.drop();
     });
   });
@@ -258,7 +258,7 @@ describe('STextPage', () => {
 
       const stext = STextPage.fromPage(page);
       expect(stext.handle).toBeDefined();
-      expect(typeof stext.handle).toBe('bigint');
+      expect(typeof stext.handle._handle).toBe('number');
       stext.drop();
     });
   });
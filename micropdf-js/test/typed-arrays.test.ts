@@ -23,7 +23,16 @@ import {
   countPointsInRect,
   convertPixelFormat,
   premultiplyAlpha,
-  unpremultiplyAlpha
+  unpremultiplyAlpha,
+  flatCharCount,
+  flatLineCount,
+  flatBlockCount,
+  flatLineCodepoints,
+  flatLineQuads,
+  flatLineText,
+  flatPageText,
+  flatCharRects,
+  type FlatSTextPage
 } from '../src/typed-arrays';
 
 describe('Color Arrays', () => {
@@ -253,3 +262,40 @@ describe('Pixel Operations', () => {
     expect(pixels[2]).toBe(255);
   });
 });
+
+describe('Flat Structured Text', () => {
+  // Two blocks: "Hi" / "é" and "!"
+  const quad = (x: number, y: number) => [x, y, x + 6, y, x, y + 10, x + 6, y + 10];
+  const page: FlatSTextPage = {
+    quads: new Float32Array([...quad(0, 2), ...quad(6, 2), ...quad(0, 14), ...quad(0, 62)]),
+    codepoints: new Uint32Array([0x48, 0x69, 0xe9, 0x21]),
+    lineOffsets: new Uint32Array([0, 2, 3, 4]),
+    blockOffsets: new Uint32Array([0, 2, 3])
+  };
+
+  it('should count chars, lines and blocks', () => {
+    expect(flatCharCount(page)).toBe(4);
+    expect(flatLineCount(page)).toBe(3);
+    expect(flatBlockCount(page)).toBe(2);
+  });
+
+  it('should view a line without copying', () => {
+    const cps = flatLineCodepoints(page, 0);
+    expect(Array.from(cps)).toEqual([0x48, 0x69]);
+    expect(cps.buffer).toBe(page.codepoints.buffer);
+
+    const quads = flatLineQuads(page, 0);
+    expect(quads.length).toBe(16);
+    expect(quads[8]).toBe(6);
+  });
+
+  it('should decode line and page text', () => {
+    expect(flatLineText(page, 1)).toBe('é');
+    expect(flatPageText(page)).toBe('Hi\né\n\n!');
+  });
+
+  it('should compute char rects from quads', () => {
+    const rects = flatCharRects(page);
+    expect(Array.from(rects.subarray(4, 8))).toEqual([6, 2, 12, 12]);
+  });
+});
@@ -8,12 +8,38 @@ Or with pip:
     pip install -e ".[cython]"
 
 This compiles _geometry_fast.pyx into a native extension module for
-significant performance improvements on geometry operations.
+significant performance improvements on geometry operations, and
+_document_fast.pyx, which links against libmicropdf for GIL-free page
+rendering and text export (build micropdf-rs in release mode first).
 """
 
 import os
 import sys
 
+# libmicropdf built by `cargo build --release`
+_LIB_DIR = os.path.abspath(os.path.join(os.path.dirname(__file__), "..", "micropdf-rs", "target", "release"))
+_OPT_ARGS = ["-O3", "-ffast-math"] if sys.platform != "win32" else ["/O2"]
+
+
+def _extensions(Extension):
+    """The extension modules to build."""
+    return [
+        Extension(
+            "micropdf._geometry_fast",
+            sources=["src/micropdf/_geometry_fast.pyx"],
+            extra_compile_args=_OPT_ARGS,
+        ),
+        Extension(
+            "micropdf._document_fast",
+            sources=["src/micropdf/_document_fast.pyx"],
+            libraries=["micropdf"],
+            library_dirs=[_LIB_DIR],
+            runtime_library_dirs=[_LIB_DIR] if sys.platform != "win32" else [],
+            extra_compile_args=["-O3"] if sys.platform != "win32" else ["/O2"],
+        ),
+    ]
+
+
 def build_cython_extensions():
     """Build Cython extensions if Cython is available."""
     try:
@@ -24,14 +50,8 @@ def build_cython_extensions():
         print("Falling back to pure Python geometry module.")
         return False
 
-    # Define extension
-    extensions = [
-        Extension(
-            "micropdf._geometry_fast",
-            sources=["src/micropdf/_geometry_fast.pyx"],
-            extra_compile_args=["-O3", "-ffast-math"] if sys.platform != "win32" else ["/O2"],
-        )
-    ]
+    # Define extensions
+    extensions = _extensions(Extension)
 
     # Build
     setup(
@@ -60,13 +80,7 @@ if __name__ == "__main__":
             from Cython.Build import cythonize
             from setuptools import Extension, setup
 
-            extensions = [
-                Extension(
-                    "micropdf._geometry_fast",
-                    sources=["src/micropdf/_geometry_fast.pyx"],
-                    extra_compile_args=["-O3", "-ffast-math"] if sys.platform != "win32" else ["/O2"],
-                )
-            ]
+            extensions = _extensions(Extension)
 
             setup(
                 name="micropdf-cython",
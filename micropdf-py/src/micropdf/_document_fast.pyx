@@ -0,0 +1,310 @@
+# cython: language_level=3
+# cython: boundscheck=False
+# cython: wraparound=False
+# cython: cdivision=True
+# cython: initializedcheck=False
+"""
+Compiled fast path for the hot document APIs.
+
+Opening, rendering and text export call libmicropdf directly instead of
+going through cffi, with the GIL released for the native work so Python
+threads rendering different pages run in parallel. Rendered pages expose
+their samples through the buffer protocol without a copy, and structured
+text is exported straight into NumPy arrays.
+
+Compile with: python setup_cython.py build_ext --inplace
+"""
+
+from cpython.buffer cimport PyBUF_WRITABLE
+from libc.stdint cimport int32_t, uint8_t, uint32_t, uint64_t
+
+import numpy as np
+
+# ============================================================================
+# Native Declarations
+# ============================================================================
+
+cdef extern from *:
+    """
+    #include <stdint.h>
+    typedef struct { float x0, y0, x1, y1; } mp_fz_rect;
+    typedef struct { float a, b, c, d, e, f; } mp_fz_matrix;
+    uint64_t fz_open_document(uint64_t ctx, const char *filename);
+    int32_t fz_count_pages(uint64_t ctx, uint64_t doc);
+    uint64_t fz_load_page(uint64_t ctx, uint64_t doc, int32_t page_num);
+    void fz_drop_page(uint64_t ctx, uint64_t page);
+    mp_fz_rect fz_bound_page(uint64_t ctx, uint64_t page);
+    mp_fz_matrix fz_scale(float sx, float sy);
+    uint64_t fz_device_rgb(uint64_t ctx);
+    uint64_t fz_new_pixmap_from_page_with_options(uint64_t ctx, uint64_t page, mp_fz_matrix ctm,
+        uint64_t cs, int32_t alpha, int32_t aa_bits, int32_t flags, uint64_t cookie);
+    void fz_drop_pixmap(uint64_t ctx, uint64_t pix);
+    int32_t fz_pixmap_width(uint64_t ctx, uint64_t pix);
+    int32_t fz_pixmap_height(uint64_t ctx, uint64_t pix);
+    int32_t fz_pixmap_components(uint64_t ctx, uint64_t pix);
+    int32_t fz_pixmap_stride(uint64_t ctx, uint64_t pix);
+    uint8_t *fz_pixmap_samples(uint64_t ctx, uint64_t pix);
+    uint64_t fz_new_stext_page_from_page(uint64_t ctx, uint64_t page, const void *options);
+    void fz_drop_stext_page(uint64_t ctx, uint64_t stext);
+    int32_t fz_stext_page_flat_counts(uint64_t ctx, uint64_t stext, int32_t *blocks,
+        int32_t *lines, int32_t *chars);
+    int32_t fz_stext_page_fill_flat(uint64_t ctx, uint64_t stext, float *quads,
+        uint32_t *codepoints, int32_t max_chars, uint32_t *line_offsets, int32_t max_lines,
+        uint32_t *block_offsets, int32_t max_blocks);
+    """
+    ctypedef struct mp_fz_rect:
+        float x0
+        float y0
+        float x1
+        float y1
+
+    ctypedef struct mp_fz_matrix:
+        float a
+        float b
+        float c
+        float d
+        float e
+        float f
+
+    uint64_t fz_open_document(uint64_t ctx, const char *filename) nogil
+    int32_t fz_count_pages(uint64_t ctx, uint64_t doc) nogil
+    uint64_t fz_load_page(uint64_t ctx, uint64_t doc, int32_t page_num) nogil
+    void fz_drop_page(uint64_t ctx, uint64_t page) nogil
+    mp_fz_rect fz_bound_page(uint64_t ctx, uint64_t page) nogil
+    mp_fz_matrix fz_scale(float sx, float sy) nogil
+    uint64_t fz_device_rgb(uint64_t ctx) nogil
+    uint64_t fz_new_pixmap_from_page_with_options(uint64_t ctx, uint64_t page, mp_fz_matrix ctm,
+        uint64_t cs, int32_t alpha, int32_t aa_bits, int32_t flags, uint64_t cookie) nogil
+    void fz_drop_pixmap(uint64_t ctx, uint64_t pix) nogil
+    int32_t fz_pixmap_width(uint64_t ctx, uint64_t pix) nogil
+    int32_t fz_pixmap_height(uint64_t ctx, uint64_t pix) nogil
+    int32_t fz_pixmap_components(uint64_t ctx, uint64_t pix) nogil
+    int32_t fz_pixmap_stride(uint64_t ctx, uint64_t pix) nogil
+    uint8_t *fz_pixmap_samples(uint64_t ctx, uint64_t pix) nogil
+    uint64_t fz_new_stext_page_from_page(uint64_t ctx, uint64_t page, const void *options) nogil
+    void fz_drop_stext_page(uint64_t ctx, uint64_t stext) nogil
+    int32_t fz_stext_page_flat_counts(uint64_t ctx, uint64_t stext, int32_t *blocks,
+        int32_t *lines, int32_t *chars) nogil
+    int32_t fz_stext_page_fill_flat(uint64_t ctx, uint64_t stext, float *quads,
+        uint32_t *codepoints, int32_t max_chars, uint32_t *line_offsets, int32_t max_lines,
+        uint32_t *block_offsets, int32_t max_blocks) nogil
+
+# Render flags, as FZ_RENDER_ANNOTS / FZ_RENDER_WIDGETS
+RENDER_ANNOTS = 1
+RENDER_WIDGETS = 2
+
+# ============================================================================
+# Rendered Pages
+# ============================================================================
+
+cdef class RenderedPage:
+    """A rendered page whose samples are shared through the buffer protocol.
+
+    ``memoryview(page)`` and ``numpy.asarray(page)`` see the native pixmap
+    directly, shaped ``(height, width, components)``; the pixmap is freed
+    once the page and every view of it are gone.
+    """
+
+    cdef uint64_t _ctx
+    cdef uint64_t _pix
+    cdef readonly int width
+    cdef readonly int height
+    cdef readonly int components
+    cdef readonly int stride
+    cdef uint8_t *_samples
+    cdef Py_ssize_t _shape[3]
+    cdef Py_ssize_t _strides[3]
+
+    def __cinit__(self):
+        self._ctx = 0
+        self._pix = 0
+        self._samples = NULL
+
+    @staticmethod
+    cdef RenderedPage adopt(uint64_t ctx, uint64_t pix):
+        cdef RenderedPage page = RenderedPage.__new__(RenderedPage)
+        page._ctx = ctx
+        page._pix = pix
+        page.width = fz_pixmap_width(ctx, pix)
+        page.height = fz_pixmap_height(ctx, pix)
+        page.components = fz_pixmap_components(ctx, pix)
+        page.stride = fz_pixmap_stride(ctx, pix)
+        page._samples = fz_pixmap_samples(ctx, pix)
+        page._shape[0] = page.height
+        page._shape[1] = page.width
+        page._shape[2] = page.components
+        page._strides[0] = page.stride
+        page._strides[1] = page.components
+        page._strides[2] = 1
+        return page
+
+    @property
+    def pixmap_handle(self):
+        """Handle of the native pixmap, for APIs that take one."""
+        return self._pix
+
+    @property
+    def samples(self):
+        """The samples as a ``(height, width, components)`` memoryview."""
+        return memoryview(self)
+
+    def __getbuffer__(self, Py_buffer *view, int flags):
+        if self._samples == NULL:
+            raise BufferError("pixmap has no samples")
+        view.buf = self._samples
+        view.obj = self
+        view.len = <Py_ssize_t>self.stride * self.height
+        view.readonly = 0
+        view.itemsize = 1
+        view.format = "B"
+        view.ndim = 3
+        view.shape = self._shape
+        view.strides = self._strides
+        view.suboffsets = NULL
+        view.internal = NULL
+
+    def __releasebuffer__(self, Py_buffer *view):
+        pass
+
+    def __dealloc__(self):
+        if self._pix != 0:
+            fz_drop_pixmap(self._ctx, self._pix)
+            self._pix = 0
+
+    def __repr__(self):
+        return f"RenderedPage({self.width}x{self.height}, n={self.components})"
+
+
+cdef uint64_t _render(uint64_t ctx, uint64_t doc, int32_t page_num, float scale,
+                      uint64_t cs, int32_t alpha, int32_t aa_bits, int32_t flags) nogil:
+    """Load, render and drop one page; 0 if it couldn't be rendered."""
+    cdef uint64_t page = fz_load_page(ctx, doc, page_num)
+    cdef uint64_t pix = 0
+    if page == 0:
+        return 0
+    if cs == 0:
+        cs = fz_device_rgb(ctx)
+    pix = fz_new_pixmap_from_page_with_options(
+        ctx, page, fz_scale(scale, scale), cs, alpha, aa_bits, flags, 0)
+    fz_drop_page(ctx, page)
+    return pix
+
+# ============================================================================
+# Document API
+# ============================================================================
+
+def open_document(uint64_t ctx, path):
+    """Open a document with the GIL released; returns its handle, or 0."""
+    cdef bytes encoded = path.encode("utf-8") if isinstance(path, str) else bytes(path)
+    cdef const char *c_path = encoded
+    cdef uint64_t doc
+    with nogil:
+        doc = fz_open_document(ctx, c_path)
+    return doc
+
+
+def count_pages(uint64_t ctx, uint64_t doc):
+    """Number of pages in a document."""
+    return fz_count_pages(ctx, doc)
+
+
+def render_page(uint64_t ctx, uint64_t doc, int page_num, float scale=1.0,
+                uint64_t colorspace=0, bint alpha=False, int aa_bits=8,
+                int flags=RENDER_ANNOTS | RENDER_WIDGETS):
+    """Render one page with the GIL released.
+
+    Args:
+        ctx: Context handle
+        doc: Document handle
+        page_num: Zero-based page number
+        scale: Zoom factor (1.0 = 72 dpi)
+        colorspace: Colorspace handle; 0 for device RGB
+        alpha: Whether the pixmap has an alpha channel
+        aa_bits: Anti-aliasing bits: 0 (off), 2, 4 or 8
+        flags: Bitwise OR of RENDER_ANNOTS and RENDER_WIDGETS
+
+    Returns:
+        RenderedPage, or None if the page couldn't be rendered
+    """
+    cdef uint64_t pix
+    with nogil:
+        pix = _render(ctx, doc, page_num, scale, colorspace, alpha, aa_bits, flags)
+    if pix == 0:
+        return None
+    return RenderedPage.adopt(ctx, pix)
+
+
+def render_pages(uint64_t ctx, uint64_t doc, pages=None, float scale=1.0,
+                 uint64_t colorspace=0, bint alpha=False, int aa_bits=8,
+                 int flags=RENDER_ANNOTS | RENDER_WIDGETS):
+    """Render a batch of pages, yielding ``(page_num, RenderedPage or None)``.
+
+    Each page renders with the GIL released, so other Python threads keep
+    running meanwhile; with ``pages=None`` every page is rendered in order.
+    """
+    cdef int32_t num
+    cdef uint64_t pix
+    if pages is None:
+        pages = range(fz_count_pages(ctx, doc))
+    for page_num in pages:
+        num = page_num
+        with nogil:
+            pix = _render(ctx, doc, num, scale, colorspace, alpha, aa_bits, flags)
+        yield page_num, (RenderedPage.adopt(ctx, pix) if pix != 0 else None)
+
+
+def stext_arrays(uint64_t ctx, uint64_t doc, int page_num):
+    """Export the structured text of a page into NumPy arrays.
+
+    Returns:
+        Dict with ``quads`` (float32, chars x 4 x 2: ul, ur, ll, lr),
+        ``codepoints`` (uint32, one per char), ``line_offsets`` (uint32,
+        first char of each line plus a final total) and ``block_offsets``
+        (uint32, first line of each block plus a final total), or None if
+        the page couldn't be loaded
+    """
+    cdef uint64_t page
+    cdef uint64_t stext = 0
+    cdef int32_t blocks = 0, lines = 0, chars = 0
+    cdef int32_t written = -1
+    cdef float[:, :, ::1] quads
+    cdef uint32_t[::1] codepoints
+    cdef uint32_t[::1] line_offsets
+    cdef uint32_t[::1] block_offsets
+
+    with nogil:
+        page = fz_load_page(ctx, doc, page_num)
+        if page != 0:
+            stext = fz_new_stext_page_from_page(ctx, page, NULL)
+            fz_drop_page(ctx, page)
+        if stext != 0 and fz_stext_page_flat_counts(ctx, stext, &blocks, &lines, &chars) < 0:
+            fz_drop_stext_page(ctx, stext)
+            stext = 0
+    if stext == 0:
+        return None
+
+    try:
+        # One extra element per array keeps the pointers valid when empty
+        quads_arr = np.empty((chars + 1, 4, 2), dtype=np.float32)
+        codepoints_arr = np.empty(chars + 1, dtype=np.uint32)
+        line_arr = np.empty(lines + 1, dtype=np.uint32)
+        block_arr = np.empty(blocks + 1, dtype=np.uint32)
+        quads = quads_arr
+        codepoints = codepoints_arr
+        line_offsets = line_arr
+        block_offsets = block_arr
+        with nogil:
+            written = fz_stext_page_fill_flat(
+                ctx, stext, &quads[0, 0, 0], &codepoints[0], chars,
+                &line_offsets[0], lines, &block_offsets[0], blocks)
+    finally:
+        fz_drop_stext_page(ctx, stext)
+
+    if written < 0:
+        return None
+    return {
+        "quads": quads_arr[:chars],
+        "codepoints": codepoints_arr[:chars],
+        "line_offsets": line_arr,
+        "block_offsets": block_arr,
+    }
@@ -1,11 +1,46 @@
 """Document and Page operations for MicroPDF."""
 
-from typing import Optional, List
+import os
+import queue
+from concurrent.futures import ThreadPoolExecutor
+from typing import Iterable, Iterator, Optional, List, Tuple
 from .ffi import ffi, lib
 from .context import Context
+from .colorspace import Colorspace
 from .geometry import Rect, Quad
+from .pixmap import Pixmap
 from .errors import system_error, argument_error
 
+# Render flags, as FZ_RENDER_ANNOTS | FZ_RENDER_WIDGETS
+_RENDER_ALL = 1 | 2
+
+
+def _stext_to_string(ctx: int, page: int) -> str:
+    """Plain text of a page handle, or an empty string."""
+    stext = lib.fz_new_stext_page_from_page(ctx, page, ffi.NULL)
+    if stext == 0:
+        return ""
+
+    try:
+        # Convert to buffer
+        buf = lib.fz_new_buffer_from_stext_page(ctx, stext)
+        if buf == 0:
+            return ""
+
+        try:
+            # Get text data
+            size_ptr = ffi.new("size_t*")
+            data = lib.fz_buffer_data(ctx, buf, size_ptr)
+
+            if data == ffi.NULL or size_ptr[0] == 0:
+                return ""
+
+            return ffi.string(data, size_ptr[0]).decode('utf-8', errors='replace')
+        finally:
+            lib.fz_drop_buffer(ctx, buf)
+    finally:
+        lib.fz_drop_stext_page(ctx, stext)
+
 
 class Page:
     """PDF page.
@@ -53,30 +88,7 @@ class Page:
         if self._dropped or self._handle is None:
             raise system_error("Cannot extract text from dropped page")
 
-        # Create text page
-        stext = lib.fz_new_stext_page_from_page(self._ctx.handle, self._handle, ffi.NULL)
-        if stext == 0:
-            return ""
-
-        try:
-            # Convert to buffer
-            buf = lib.fz_new_buffer_from_stext_page(self._ctx.handle, stext)
-            if buf == 0:
-                return ""
-
-            try:
-                # Get text data
-                size_ptr = ffi.new("size_t*")
-                data = lib.fz_buffer_data(self._ctx.handle, buf, size_ptr)
-
-                if data == ffi.NULL or size_ptr[0] == 0:
-                    return ""
-
-                return ffi.string(data, size_ptr[0]).decode('utf-8', errors='replace')
-            finally:
-                lib.fz_drop_buffer(self._ctx.handle, buf)
-        finally:
-            lib.fz_drop_stext_page(self._ctx.handle, stext)
+        return _stext_to_string(self._ctx.handle, self._handle)
 
     def search_text(self, needle: str, max_hits: int = 512) -> List[Quad]:
         """Search for text on the page.
@@ -341,6 +353,133 @@ class Document:
 
         return Page(self._ctx, int(handle))
 
+    def _page_range(self, pages: Optional[Iterable[int]]) -> List[int]:
+        count = self.page_count()
+        page_nums = list(range(count)) if pages is None else list(pages)
+        for page_num in page_nums:
+            if page_num < 0 or page_num >= count:
+                raise argument_error(f"Invalid page number: {page_num}")
+        return page_nums
+
+    def render_pages(
+        self,
+        pages: Optional[Iterable[int]] = None,
+        dpi: float = 72.0,
+        workers: int = 0,
+        colorspace: Optional[Colorspace] = None,
+        alpha: bool = False,
+    ) -> Iterator[Tuple[int, Pixmap]]:
+        """Render pages in parallel on the native render pool.
+
+        Each worker thread renders on its own clone of the context and
+        the GIL is released while waiting, so other Python threads keep
+        running. At most two jobs per worker are in flight, which bounds
+        the memory held by rendered but unconsumed pages.
+
+        Args:
+            pages: Page numbers to render (default: all pages)
+            dpi: Resolution (72 = 100%)
+            workers: Worker threads (0 = one per CPU)
+            colorspace: Output colorspace (default: device RGB)
+            alpha: Whether to include an alpha channel
+
+        Yields:
+            (page_num, Pixmap) pairs in the order of `pages`
+
+        Raises:
+            MicroPDFError: If a page cannot be rendered
+        """
+        if self._dropped or self._handle is None:
+            raise system_error("Cannot render dropped document")
+
+        page_nums = self._page_range(pages)
+        ctx = self._ctx.handle
+        pool = lib.fz_new_render_pool(ctx, workers)
+        if pool == 0:
+            raise system_error("Failed to create render pool")
+
+        cs = colorspace.handle if colorspace is not None else lib.fz_device_rgb(ctx)
+        ctm = lib.fz_scale(dpi / 72.0, dpi / 72.0)
+        window = 2 * lib.fz_render_pool_threads(ctx, pool)
+        jobs: List[Tuple[int, int]] = []
+        try:
+            for page_num in page_nums:
+                job = lib.fz_render_pool_submit(
+                    ctx, pool, self._handle, page_num, ctm, cs, 1 if alpha else 0, -1, _RENDER_ALL
+                )
+                if job == 0:
+                    raise system_error(f"Failed to queue page {page_num}")
+                jobs.append((page_num, job))
+                if len(jobs) >= window:
+                    yield self._claim(pool, *jobs.pop(0))
+            while jobs:
+                yield self._claim(pool, *jobs.pop(0))
+        finally:
+            for _, job in jobs:
+                lib.fz_render_pool_cancel(ctx, pool, job)
+            lib.fz_drop_render_pool(ctx, pool)
+
+    def _claim(self, pool: int, page_num: int, job: int) -> Tuple[int, Pixmap]:
+        handle = lib.fz_render_pool_wait(self._ctx.handle, pool, job)
+        if handle == 0:
+            raise system_error(f"Failed to render page {page_num}")
+        return page_num, Pixmap(self._ctx, int(handle))
+
+    def extract_text_all(
+        self, pages: Optional[Iterable[int]] = None, workers: int = 0
+    ) -> Iterator[Tuple[int, str]]:
+        """Extract the text of many pages in parallel.
+
+        Pages are spread over a thread pool whose threads each use their
+        own clone of the context; the GIL is released during the native
+        extraction, so the work runs truly in parallel.
+
+        Args:
+            pages: Page numbers to extract (default: all pages)
+            workers: Worker threads (0 = one per CPU)
+
+        Yields:
+            (page_num, text) pairs in the order of `pages`
+        """
+        if self._dropped or self._handle is None:
+            raise system_error("Cannot extract text from dropped document")
+
+        page_nums = self._page_range(pages)
+        workers = workers if workers > 0 else (os.cpu_count() or 1)
+        contexts = [self._ctx.clone() for _ in range(workers)]
+        free: "queue.Queue[Context]" = queue.Queue()
+        for ctx in contexts:
+            free.put(ctx)
+
+        def extract(page_num: int) -> Tuple[int, str]:
+            ctx = free.get()
+            try:
+                page = lib.fz_load_page(ctx.handle, self._handle, page_num)
+                if page == 0:
+                    return page_num, ""
+                try:
+                    return page_num, _stext_to_string(ctx.handle, page)
+                finally:
+                    lib.fz_drop_page(ctx.handle, page)
+            finally:
+                free.put(ctx)
+
+        executor = ThreadPoolExecutor(max_workers=workers, thread_name_prefix="micropdf-text")
+        futures = []
+        try:
+            for page_num in page_nums:
+                futures.append(executor.submit(extract, page_num))
+                if len(futures) >= 2 * workers:
+                    yield futures.pop(0).result()
+            while futures:
+                yield futures.pop(0).result()
+        finally:
+            for future in futures:
+                future.cancel()
+            executor.shutdown(wait=True)
+            for ctx in contexts:
+                ctx.drop()
+
     def save(self, path: str) -> None:
         """Save document to file.
 
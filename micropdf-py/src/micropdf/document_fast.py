@@ -0,0 +1,235 @@
+"""
+Fast page rendering and text export with Cython acceleration.
+
+This module provides the hot document paths (open, render, text export)
+through a compiled extension when available, falling back to the cffi
+bindings. The compiled path releases the GIL while the native library
+works and hands out rendered samples without copying them.
+
+Usage:
+    from micropdf.document_fast import open_document, render_pages, stext_arrays
+
+    doc = open_document(ctx, "file.pdf")
+    for page_num, page in render_pages(doc, scale=2.0):
+        image = numpy.asarray(page.samples)  # (height, width, components)
+    text = stext_arrays(doc, 0)
+
+To enable Cython acceleration:
+    cd micropdf-py
+    pip install cython numpy
+    cd ../micropdf-rs && cargo build --release && cd ../micropdf-py
+    python setup_cython.py build_ext --inplace
+"""
+
+from __future__ import annotations
+
+from typing import Dict, Iterable, Iterator, Optional, Tuple
+
+from .context import Context
+from .document import Document
+from .errors import system_error
+from .ffi import ffi, lib
+
+# Try to import the compiled extension
+_USE_CYTHON = False
+try:
+    from micropdf._document_fast import (
+        open_document as _cy_open_document,
+        render_page as _cy_render_page,
+        render_pages as _cy_render_pages,
+        stext_arrays as _cy_stext_arrays,
+    )
+    _USE_CYTHON = True
+except ImportError:
+    pass
+
+# Render flags, as FZ_RENDER_ANNOTS / FZ_RENDER_WIDGETS
+RENDER_ANNOTS = 1
+RENDER_WIDGETS = 2
+_DEFAULT_FLAGS = RENDER_ANNOTS | RENDER_WIDGETS
+
+# ============================================================================
+# cffi Fallbacks
+# ============================================================================
+
+class _PyRenderedPage:
+    """A rendered page whose samples were copied out of the native pixmap."""
+
+    def __init__(self, width: int, height: int, components: int, stride: int, data: bytearray) -> None:
+        self.width = width
+        self.height = height
+        self.components = components
+        self.stride = stride
+        self._data = data
+
+    @property
+    def samples(self) -> memoryview:
+        """The samples as a ``(height, width, components)`` memoryview."""
+        view = memoryview(self._data)
+        if self.stride == self.width * self.components:
+            return view.cast("B", (self.height, self.width, self.components))
+        return view
+
+    def __repr__(self) -> str:
+        return f"RenderedPage({self.width}x{self.height}, n={self.components})"
+
+
+def _py_open_document(ctx: int, path: str) -> int:
+    c_path = ffi.new("char[]", path.encode("utf-8"))
+    return int(lib.fz_open_document(ctx, c_path))
+
+
+def _py_render_page(ctx: int, doc: int, page_num: int, scale: float, colorspace: int,
+                    alpha: bool, aa_bits: int, flags: int) -> Optional[_PyRenderedPage]:
+    page = lib.fz_load_page(ctx, doc, page_num)
+    if page == 0:
+        return None
+    try:
+        cs = colorspace or lib.fz_device_rgb(ctx)
+        pix = lib.fz_new_pixmap_from_page_with_options(
+            ctx, page, lib.fz_scale(scale, scale), cs, int(alpha), aa_bits, flags, 0)
+    finally:
+        lib.fz_drop_page(ctx, page)
+    if pix == 0:
+        return None
+    try:
+        width = lib.fz_pixmap_width(ctx, pix)
+        height = lib.fz_pixmap_height(ctx, pix)
+        stride = lib.fz_pixmap_stride(ctx, pix)
+        samples = lib.fz_pixmap_samples(ctx, pix)
+        data = bytearray(ffi.buffer(samples, stride * height)) if samples != ffi.NULL else bytearray()
+        return _PyRenderedPage(width, height, lib.fz_pixmap_components(ctx, pix), stride, data)
+    finally:
+        lib.fz_drop_pixmap(ctx, pix)
+
+
+def _py_render_pages(ctx: int, doc: int, pages: Optional[Iterable[int]], scale: float,
+                     colorspace: int, alpha: bool, aa_bits: int,
+                     flags: int) -> Iterator[Tuple[int, Optional[_PyRenderedPage]]]:
+    if pages is None:
+        pages = range(lib.fz_count_pages(ctx, doc))
+    for page_num in pages:
+        yield page_num, _py_render_page(ctx, doc, page_num, scale, colorspace, alpha, aa_bits, flags)
+
+
+def _py_stext_arrays(ctx: int, doc: int, page_num: int) -> Optional[Dict[str, object]]:
+    import numpy as np
+
+    page = lib.fz_load_page(ctx, doc, page_num)
+    if page == 0:
+        return None
+    stext = lib.fz_new_stext_page_from_page(ctx, page, ffi.NULL)
+    lib.fz_drop_page(ctx, page)
+    if stext == 0:
+        return None
+    try:
+        counts = ffi.new("int[3]")
+        if lib.fz_stext_page_flat_counts(ctx, stext, counts, counts + 1, counts + 2) < 0:
+            return None
+        blocks, lines, chars = counts[0], counts[1], counts[2]
+        quads = np.empty((chars + 1, 4, 2), dtype=np.float32)
+        codepoints = np.empty(chars + 1, dtype=np.uint32)
+        line_offsets = np.empty(lines + 1, dtype=np.uint32)
+        block_offsets = np.empty(blocks + 1, dtype=np.uint32)
+        written = lib.fz_stext_page_fill_flat(
+            ctx, stext,
+            ffi.cast("float*", ffi.from_buffer(quads)),
+            ffi.cast("uint32_t*", ffi.from_buffer(codepoints)), chars,
+            ffi.cast("uint32_t*", ffi.from_buffer(line_offsets)), lines,
+            ffi.cast("uint32_t*", ffi.from_buffer(block_offsets)), blocks,
+        )
+    finally:
+        lib.fz_drop_stext_page(ctx, stext)
+    if written < 0:
+        return None
+    return {
+        "quads": quads[:chars],
+        "codepoints": codepoints[:chars],
+        "line_offsets": line_offsets,
+        "block_offsets": block_offsets,
+    }
+
+# ============================================================================
+# Public API - uses Cython if available
+# ============================================================================
+
+def open_document(ctx: Context, path: str) -> Document:
+    """Open a document, releasing the GIL while it is parsed.
+
+    Raises:
+        MicroPDFError: If the file cannot be opened
+    """
+    handle = _cy_open_document(ctx.handle, path) if _USE_CYTHON else _py_open_document(ctx.handle, path)
+    if handle == 0:
+        raise system_error(f"Failed to open document: {path}")
+    return Document(ctx, int(handle))
+
+
+def render_page(doc: Document, page_num: int, scale: float = 1.0, colorspace: int = 0,
+                alpha: bool = False, aa_bits: int = 8, flags: int = _DEFAULT_FLAGS):
+    """Render one page.
+
+    Args:
+        doc: Document to render from
+        page_num: Zero-based page number
+        scale: Zoom factor (1.0 = 72 dpi)
+        colorspace: Colorspace handle; 0 for device RGB
+        alpha: Whether the pixmap has an alpha channel
+        aa_bits: Anti-aliasing bits: 0 (off), 2, 4 or 8
+        flags: Bitwise OR of RENDER_ANNOTS and RENDER_WIDGETS
+
+    Returns:
+        Rendered page with width, height, components, stride and samples,
+        or None if the page couldn't be rendered. With the extension the
+        page supports the buffer protocol and shares the native samples.
+    """
+    ctx = doc._ctx.handle
+    if _USE_CYTHON:
+        return _cy_render_page(ctx, doc.handle, page_num, scale, colorspace, alpha, aa_bits, flags)
+    return _py_render_page(ctx, doc.handle, page_num, scale, colorspace, alpha, aa_bits, flags)
+
+
+def render_pages(doc: Document, pages: Optional[Iterable[int]] = None, scale: float = 1.0,
+                 colorspace: int = 0, alpha: bool = False, aa_bits: int = 8,
+                 flags: int = _DEFAULT_FLAGS) -> Iterator[Tuple[int, object]]:
+    """Render a batch of pages, yielding ``(page_num, page or None)``.
+
+    With ``pages=None`` every page is rendered in order. Arguments are as
+    for `render_page`.
+    """
+    ctx = doc._ctx.handle
+    if _USE_CYTHON:
+        return _cy_render_pages(ctx, doc.handle, pages, scale, colorspace, alpha, aa_bits, flags)
+    return _py_render_pages(ctx, doc.handle, pages, scale, colorspace, alpha, aa_bits, flags)
+
+
+def stext_arrays(doc: Document, page_num: int) -> Optional[Dict[str, object]]:
+    """Export the structured text of a page into NumPy arrays.
+
+    Returns:
+        Dict with ``quads`` (float32, chars x 4 x 2: ul, ur, ll, lr),
+        ``codepoints`` (uint32), ``line_offsets`` (uint32, first char of
+        each line plus a final total) and ``block_offsets`` (uint32, first
+        line of each block plus a final total), or None if the page
+        couldn't be loaded
+    """
+    ctx = doc._ctx.handle
+    if _USE_CYTHON:
+        return _cy_stext_arrays(ctx, doc.handle, page_num)
+    return _py_stext_arrays(ctx, doc.handle, page_num)
+
+
+def is_cython_available() -> bool:
+    """Check if the compiled document extension is available."""
+    return _USE_CYTHON
+
+
+__all__ = [
+    "RENDER_ANNOTS",
+    "RENDER_WIDGETS",
+    "open_document",
+    "render_page",
+    "render_pages",
+    "stext_arrays",
+    "is_cython_available",
+]
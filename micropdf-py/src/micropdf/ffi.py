@@ -104,6 +104,8 @@ ffi.cdef("""
     // Pixmap functions
     fz_pixmap fz_new_pixmap(fz_context ctx, fz_colorspace cs, int w, int h, int alpha);
     fz_pixmap fz_new_pixmap_from_page(fz_context ctx, fz_page page, fz_matrix ctm, fz_colorspace cs, int alpha);
+    fz_pixmap fz_new_pixmap_from_page_with_options(fz_context ctx, fz_page page, fz_matrix ctm, fz_colorspace cs, int alpha, int aa_bits, int flags, fz_cookie cookie);
+    fz_pixmap fz_keep_pixmap(fz_context ctx, fz_pixmap pix);
     void fz_drop_pixmap(fz_context ctx, fz_pixmap pix);
     int fz_pixmap_width(fz_context ctx, fz_pixmap pix);
     int fz_pixmap_height(fz_context ctx, fz_pixmap pix);
@@ -112,6 +114,17 @@ ffi.cdef("""
     unsigned char* fz_pixmap_samples(fz_context ctx, fz_pixmap pix);
     void fz_clear_pixmap(fz_context ctx, fz_pixmap pix);
 
+    // Render pool functions
+    uint64_t fz_new_render_pool(fz_context ctx, int threads);
+    void fz_drop_render_pool(fz_context ctx, uint64_t pool);
+    int fz_render_pool_threads(fz_context ctx, uint64_t pool);
+    uint64_t fz_render_pool_submit(fz_context ctx, uint64_t pool, fz_document doc, int page_number, fz_matrix ctm, fz_colorspace cs, int alpha, int aa_bits, int flags);
+    int fz_render_pool_cancel(fz_context ctx, uint64_t pool, uint64_t job);
+    fz_pixmap fz_render_pool_wait(fz_context ctx, uint64_t pool, uint64_t job);
+
+    // Command buffer functions
+    int fz_run_command_buffer(fz_context ctx, const uint8_t* cmds, size_t len, uint8_t* results, size_t results_cap);
+
     // Buffer functions
     fz_buffer fz_new_buffer(fz_context ctx, size_t capacity);
     fz_buffer fz_new_buffer_from_copied_data(fz_context ctx, const unsigned char* data, size_t size);
@@ -127,6 +140,8 @@ ffi.cdef("""
     fz_stext_page fz_new_stext_page_from_page(fz_context ctx, fz_page page, const void* options);
     void fz_drop_stext_page(fz_context ctx, fz_stext_page stext);
     fz_buffer fz_new_buffer_from_stext_page(fz_context ctx, fz_stext_page stext);
+    int fz_stext_page_flat_counts(fz_context ctx, fz_stext_page stext, int* blocks, int* lines, int* chars);
+    int fz_stext_page_fill_flat(fz_context ctx, fz_stext_page stext, float* quads, uint32_t* codepoints, int max_chars, uint32_t* line_offsets, int max_lines, uint32_t* block_offsets, int max_blocks);
 
     // Search functions
     int fz_search_stext_page(fz_context ctx, fz_stext_page stext, const char* needle, int* mark, fz_quad* hit_bbox, int hit_max);
@@ -144,6 +159,8 @@ ffi.cdef("""
     void fz_drop_stream(fz_context ctx, fz_stream stm);
     size_t fz_read(fz_context ctx, fz_stream stm, unsigned char* data, size_t len);
     int fz_read_byte(fz_context ctx, fz_stream stm);
+    const unsigned char* fz_peek_bytes(fz_context ctx, fz_stream stm, size_t max, size_t* len);
+    size_t fz_consume(fz_context ctx, fz_stream stm, size_t n);
     int fz_is_eof(fz_context ctx, fz_stream stm);
     void fz_seek(fz_context ctx, fz_stream stm, int64_t offset, int whence);
     int64_t fz_tell(fz_context ctx, fz_stream stm);
@@ -155,6 +172,9 @@ ffi.cdef("""
     void fz_write_data(fz_context ctx, fz_output out, const void* data, size_t size);
     void fz_write_string(fz_context ctx, fz_output out, const char* s);
     void fz_write_byte(fz_context ctx, fz_output out, unsigned char byte);
+    void fz_write_int(fz_context ctx, fz_output out, int64_t x);
+    void fz_write_real(fz_context ctx, fz_output out, float x);
+    void fz_write_reals(fz_context ctx, fz_output out, const float* values, size_t count);
     int64_t fz_tell_output(fz_context ctx, fz_output out);
 
     // Font functions
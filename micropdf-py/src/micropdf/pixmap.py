@@ -140,6 +140,9 @@ class Pixmap:
     def samples(self) -> bytes:
         """Get raw pixel data as bytes.
 
+        This copies the samples; use memoryview() or numpy.asarray(pix)
+        to share them instead.
+
         Returns:
             Raw pixel data (width * height * components bytes)
         """
@@ -160,6 +163,58 @@ class Pixmap:
 
         return ffi.buffer(data_ptr, size)[:]
 
+    def _buffer(self):
+        """The raw samples, as a buffer that holds its own pixmap reference.
+
+        The reference is released once the buffer and every view of it
+        are gone, so views stay valid after drop().
+        """
+        if self._dropped or self._handle is None:
+            raise system_error("Cannot access samples of dropped pixmap")
+
+        ctx = self._ctx.handle
+        handle = lib.fz_keep_pixmap(ctx, self._handle)
+        data_ptr = lib.fz_pixmap_samples(ctx, handle)
+        if data_ptr == ffi.NULL:
+            lib.fz_drop_pixmap(ctx, handle)
+            return b""
+
+        data_ptr = ffi.gc(data_ptr, lambda _: lib.fz_drop_pixmap(ctx, handle))
+        return ffi.buffer(data_ptr, self.stride() * self.height())
+
+    def memoryview(self) -> memoryview:
+        """Get the samples as a writable memoryview, without copying.
+
+        The view is shaped ``(height, width, components)``; if rows are
+        padded beyond ``width * components`` it is ``(height, stride)``.
+
+        Returns:
+            memoryview of the pixmap samples
+        """
+        height, width, n, stride = self.height(), self.width(), self.components(), self.stride()
+        view = memoryview(self._buffer())
+        if view.nbytes == 0:
+            return view
+        if stride == width * n:
+            return view.cast("B", (height, width, n))
+        return view.cast("B", (height, stride))
+
+    def __buffer__(self, flags: int) -> memoryview:
+        """Buffer protocol (Python 3.12+): ``memoryview(pix)``."""
+        return self.memoryview()
+
+    @property
+    def __array_interface__(self) -> dict:
+        """NumPy array interface: ``numpy.asarray(pix)`` shares the samples."""
+        height, width, n, stride = self.height(), self.width(), self.components(), self.stride()
+        return {
+            "version": 3,
+            "shape": (height, width, n),
+            "typestr": "|u1",
+            "strides": (stride, n, 1),
+            "data": self._buffer(),
+        }
+
     def to_png(self) -> bytes:
         """Convert pixmap to PNG format.
 
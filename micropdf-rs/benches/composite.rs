@@ -0,0 +1,63 @@
+use criterion::{BenchmarkId, Criterion, Throughput, black_box, criterion_group, criterion_main};
+use micropdf::ffi::composite::{SpanPaint, paint_span, paint_span_scalar};
+use micropdf::ffi::draw_device::BlendMode;
+
+/// One 1000-pixel row, the width of a page rendered at 100 DPI
+const WIDTH: usize = 1000;
+
+fn span(n: usize) -> Vec<u8> {
+    (0..WIDTH * (n + 1)).map(|i| (i * 37 % 251) as u8).collect()
+}
+
+fn bench_composite(c: &mut Criterion, name: &str, blend: BlendMode, masked: bool) {
+    let mut group = c.benchmark_group(format!("composite/{name}"));
+    group.throughput(Throughput::Elements(WIDTH as u64));
+    let mask: Vec<u8> = (0..WIDTH).map(|i| (i % 256) as u8).collect();
+    let mask = masked.then_some(&mask[..]);
+
+    for (space, n) in [("gray", 1), ("rgb", 3), ("cmyk", 4)] {
+        let paint = SpanPaint {
+            n,
+            dst_alpha: true,
+            src_alpha: true,
+            alpha: 0.8,
+            blend,
+        };
+        let src = span(n);
+        let mut dst = span(n);
+        group.bench_with_input(BenchmarkId::new("simd", space), &src, |b, src| {
+            b.iter(|| paint_span(black_box(&mut dst), black_box(src), mask, WIDTH, &paint))
+        });
+        group.bench_with_input(BenchmarkId::new("scalar", space), &src, |b, src| {
+            b.iter(|| paint_span_scalar(black_box(&mut dst), black_box(src), mask, WIDTH, &paint))
+        });
+    }
+
+    group.finish();
+}
+
+fn bench_over(c: &mut Criterion) {
+    bench_composite(c, "over", BlendMode::Normal, false);
+}
+
+fn bench_over_masked(c: &mut Criterion) {
+    bench_composite(c, "over_masked", BlendMode::Normal, true);
+}
+
+fn bench_multiply(c: &mut Criterion) {
+    bench_composite(c, "multiply", BlendMode::Multiply, false);
+}
+
+fn bench_soft_light(c: &mut Criterion) {
+    bench_composite(c, "soft_light", BlendMode::SoftLight, false);
+}
+
+criterion_group!(
+    benches,
+    bench_over,
+    bench_over_masked,
+    bench_multiply,
+    bench_soft_light,
+);
+
+criterion_main!(benches);
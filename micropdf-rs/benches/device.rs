@@ -1,4 +1,12 @@
 use criterion::{Criterion, black_box, criterion_group, criterion_main};
+use micropdf::ffi::PIXMAPS;
+use micropdf::ffi::colorspace::FZ_COLORSPACE_RGB;
+use micropdf::ffi::draw_device::{
+    fz_draw_device_begin_path, fz_draw_device_close_path, fz_draw_device_fill,
+    fz_draw_device_line_to, fz_draw_device_move_to, fz_draw_device_set_rasterizer,
+    fz_drop_draw_device, fz_new_draw_device_with_options,
+};
+use micropdf::ffi::pixmap::Pixmap as FfiPixmap;
 use micropdf::fitz::colorspace::Colorspace;
 use micropdf::fitz::device::{BBoxDevice, Device, TraceDevice};
 use micropdf::fitz::geometry::{Matrix, Point};
@@ -59,6 +67,43 @@ fn bench_device_path_operations(c: &mut Criterion) {
     group.finish();
 }
 
-criterion_group!(benches, bench_device_creation, bench_device_path_operations,);
+/// A map-like fill: a 400-point wavy closed outline across a 1000x1000 page
+fn bench_draw_device_rasterizers(c: &mut Criterion) {
+    let mut group = c.benchmark_group("device/rasterize");
+    let pixmap = PIXMAPS.insert(FfiPixmap::new(FZ_COLORSPACE_RGB, 1000, 1000, true));
+    let device = fz_new_draw_device_with_options(0, pixmap, 3, 0);
+
+    for (name, rasterizer) in [("supersample", 0), ("sparse_scanline", 1)] {
+        fz_draw_device_set_rasterizer(0, device, rasterizer);
+        group.bench_function(name, |b| {
+            b.iter(|| {
+                fz_draw_device_begin_path(0, device);
+                for i in 0..400 {
+                    let t = i as f32 / 400.0 * std::f32::consts::TAU;
+                    let r = 450.0 + 40.0 * (t * 23.0).sin();
+                    let (x, y) = (500.0 + r * t.cos(), 500.0 + r * t.sin());
+                    if i == 0 {
+                        fz_draw_device_move_to(0, device, x, y);
+                    } else {
+                        fz_draw_device_line_to(0, device, x, y);
+                    }
+                }
+                fz_draw_device_close_path(0, device);
+                black_box(fz_draw_device_fill(0, device, 0))
+            })
+        });
+    }
+
+    group.finish();
+    fz_drop_draw_device(0, device);
+    PIXMAPS.remove(pixmap);
+}
+
+criterion_group!(
+    benches,
+    bench_device_creation,
+    bench_device_path_operations,
+    bench_draw_device_rasterizers,
+);
 
 criterion_main!(benches);
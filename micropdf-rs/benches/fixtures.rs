@@ -0,0 +1,881 @@
+//! Fixture Benchmarks
+//!
+//! End-to-end timings of the document pipeline over the `test-pdfs/`
+//! fixtures:
+//! - Open and xref repair
+//! - Content interpretation (bbox device)
+//! - Rendering at 72, 150 and 300 DPI
+//! - Text extraction and search
+//! - Merge, optimize, linearize, image rewrite and save
+//!
+//! Unlike the criterion suites this harness writes machine-readable results
+//! and compares them against a saved run, failing when the median time of a
+//! benchmark grows by more than a threshold:
+//!
+//! ```bash
+//! # Record a baseline
+//! cargo bench --bench fixtures -- --json-out target/bench/v0.9.json
+//!
+//! # Compare against it, failing on a slowdown over 10%
+//! cargo bench --bench fixtures -- --json-baseline target/bench/v0.9.json --max-regression 10
+//! ```
+//!
+//! Results go to `target/bench/fixtures.json` unless `--json-out` says
+//! otherwise. `--filter TEXT` runs only the benchmarks whose name contains
+//! `TEXT`, and `--time MS` sets the measuring time per benchmark. Other
+//! arguments (such as criterion's, from `cargo bench --all-features`) are
+//! ignored. Fixtures still stored as Git LFS pointers are skipped; run
+//! `git lfs pull` first.
+//!
+//! `--scaling` instead runs each parallel pipeline (render pool, tile
+//! renderer, parallel save and xref repair) over the whole corpus at 1, 2,
+//! 4 ... N threads, or at the counts given by `--threads 1,3,8`, and
+//! reports pages per second, p50/p99 latency, CPU utilization and peak RSS
+//! per thread count, to `target/bench/scaling.json` by default. Contention
+//! in the store, glyph cache or handle tables shows up as throughput that
+//! stops growing with the thread count while utilization drops.
+
+use std::ffi::CString;
+use std::hint::black_box;
+use std::path::{Path, PathBuf};
+use std::time::{Duration, Instant, SystemTime, UNIX_EPOCH};
+
+use micropdf::enhanced::page_ops::merge_pdf;
+use micropdf::ffi::Handle;
+use micropdf::ffi::colorspace::fz_device_rgb;
+use micropdf::ffi::context::{fz_drop_context, fz_new_context};
+use micropdf::ffi::device::{fz_close_device, fz_drop_device, fz_new_bbox_device};
+use micropdf::ffi::display_list::{fz_drop_display_list, fz_new_display_list_from_page};
+use micropdf::ffi::document::{
+    fz_bound_page, fz_count_pages, fz_drop_document, fz_drop_page, fz_load_page,
+    fz_new_pixmap_from_page, fz_open_document, fz_run_page,
+};
+use micropdf::ffi::geometry::{fz_rect, fz_scale};
+use micropdf::ffi::json::{JsonParser, JsonValue};
+use micropdf::ffi::pdf_clean::{
+    pdf_linearize, pdf_optimize, pdf_save_document, pdf_save_document_parallel,
+};
+use micropdf::ffi::pdf_image_rewriter::{pdf_rewrite_images, pdf_web_image_rewriter_options};
+use micropdf::ffi::pdf_repair::pdf_repair_xref;
+use micropdf::ffi::pdf_xref::pdf_drop_xref;
+use micropdf::ffi::pixmap::fz_drop_pixmap;
+use micropdf::ffi::render_pool::{
+    fz_drop_render_pool, fz_new_render_pool, fz_render_pool_submit, fz_render_pool_wait,
+};
+use micropdf::ffi::stext::{
+    FzQuad, fz_drop_stext_page, fz_new_stext_page_from_page, fz_search_stext_page,
+    fz_stext_page_as_text,
+};
+use micropdf::ffi::tile_render::{
+    fz_drop_render_task, fz_drop_tile_renderer, fz_new_render_task, fz_new_tile_renderer,
+    fz_render_task_run,
+};
+
+// ============================================================================
+// Harness
+// ============================================================================
+
+/// Iterations per benchmark, whatever the measuring time
+const MIN_ITERATIONS: usize = 5;
+const MAX_ITERATIONS: usize = 10_000;
+
+/// Render resolutions, in dots per inch
+const RENDER_DPI: [u32; 3] = [72, 150, 300];
+
+/// Word searched for in every fixture
+const SEARCH_NEEDLE: &std::ffi::CStr = c"the";
+
+struct Options {
+    fixtures: PathBuf,
+    /// Results file; defaults by mode
+    json_out: Option<PathBuf>,
+    json_baseline: Option<PathBuf>,
+    /// Slowdown in percent past which a benchmark counts as a regression
+    max_regression: f64,
+    time: Duration,
+    filter: Option<String>,
+    scaling: bool,
+    /// Thread counts for `--scaling`
+    threads: Vec<usize>,
+}
+
+impl Options {
+    fn from_args() -> Self {
+        let root = PathBuf::from(env!("CARGO_MANIFEST_DIR"));
+        let mut options = Options {
+            fixtures: root.join("../test-pdfs"),
+            json_out: None,
+            json_baseline: None,
+            max_regression: 10.0,
+            time: Duration::from_millis(500),
+            filter: None,
+            scaling: false,
+            threads: default_thread_counts(),
+        };
+        let mut args = std::env::args().skip(1);
+        while let Some(arg) = args.next() {
+            let mut value = || args.next().unwrap_or_default();
+            match arg.as_str() {
+                "--fixtures" => options.fixtures = value().into(),
+                "--json-out" => options.json_out = Some(value().into()),
+                "--json-baseline" => options.json_baseline = Some(value().into()),
+                "--max-regression" => {
+                    options.max_regression = value().parse().unwrap_or(options.max_regression)
+                }
+                "--time" => {
+                    let ms = value().parse().unwrap_or(options.time.as_millis() as u64);
+                    options.time = Duration::from_millis(ms);
+                }
+                "--filter" => options.filter = Some(value()),
+                "--scaling" => options.scaling = true,
+                "--threads" => {
+                    let counts: Vec<usize> = value()
+                        .split(',')
+                        .filter_map(|n| n.trim().parse().ok())
+                        .filter(|&n| n > 0)
+                        .collect();
+                    if !counts.is_empty() {
+                        options.threads = counts;
+                    }
+                }
+                _ => {}
+            }
+        }
+        options
+    }
+}
+
+/// 1, 2, 4 ... up to the core count, and the core count itself
+fn default_thread_counts() -> Vec<usize> {
+    let cores = std::thread::available_parallelism().map_or(1, |n| n.get());
+    let mut counts: Vec<usize> = std::iter::successors(Some(1), |&n| Some(n * 2))
+        .take_while(|&n| n < cores)
+        .collect();
+    counts.push(cores);
+    counts
+}
+
+/// Timings of one benchmark, in nanoseconds
+struct Measurement {
+    name: String,
+    iterations: usize,
+    median: u64,
+    mean: u64,
+    min: u64,
+    max: u64,
+}
+
+struct Runner {
+    time: Duration,
+    filter: Option<String>,
+    results: Vec<Measurement>,
+}
+
+impl Runner {
+    fn bench(&mut self, name: String, mut routine: impl FnMut()) {
+        self.bench_with_setup(name, || (), |()| routine());
+    }
+
+    /// Time `routine` on fresh input from `setup`, which is not timed
+    fn bench_with_setup<I>(
+        &mut self,
+        name: String,
+        mut setup: impl FnMut() -> I,
+        mut routine: impl FnMut(I),
+    ) {
+        if self.filter.as_ref().is_some_and(|f| !name.contains(f)) {
+            return;
+        }
+        // Warm caches and lazily built state
+        routine(setup());
+
+        let mut samples = Vec::new();
+        let start = Instant::now();
+        while samples.len() < MIN_ITERATIONS
+            || (start.elapsed() < self.time && samples.len() < MAX_ITERATIONS)
+        {
+            let input = setup();
+            let t = Instant::now();
+            routine(black_box(input));
+            samples.push(t.elapsed().as_nanos() as u64);
+        }
+        samples.sort_unstable();
+
+        let m = Measurement {
+            name,
+            iterations: samples.len(),
+            median: samples[samples.len() / 2],
+            mean: samples.iter().sum::<u64>() / samples.len() as u64,
+            min: samples[0],
+            max: samples[samples.len() - 1],
+        };
+        println!(
+            "{:<60} median {:>12}  ({} iterations)",
+            m.name,
+            format_ns(m.median),
+            m.iterations
+        );
+        self.results.push(m);
+    }
+}
+
+fn format_ns(ns: u64) -> String {
+    match ns {
+        0..1_000 => format!("{} ns", ns),
+        1_000..1_000_000 => format!("{:.2} µs", ns as f64 / 1e3),
+        1_000_000..1_000_000_000 => format!("{:.2} ms", ns as f64 / 1e6),
+        _ => format!("{:.2} s", ns as f64 / 1e9),
+    }
+}
+
+// ============================================================================
+// Fixtures
+// ============================================================================
+
+/// Every PDF under `dir`, sorted, with LFS pointers left out
+fn find_fixtures(dir: &Path) -> Vec<PathBuf> {
+    fn walk(dir: &Path, out: &mut Vec<PathBuf>) {
+        let Ok(entries) = std::fs::read_dir(dir) else {
+            return;
+        };
+        for entry in entries.flatten() {
+            let path = entry.path();
+            if path.is_dir() {
+                walk(&path, out);
+            } else if path.extension().is_some_and(|e| e == "pdf") {
+                out.push(path);
+            }
+        }
+    }
+    let mut found = Vec::new();
+    walk(dir, &mut found);
+    found.sort();
+    found.retain(|path| {
+        let pointer = std::fs::read(path)
+            .map(|data| data.starts_with(b"version https://git-lfs"))
+            .unwrap_or(true);
+        if pointer {
+            eprintln!("skipping {} (not fetched from Git LFS)", path.display());
+        }
+        !pointer
+    });
+    found
+}
+
+fn c_path(path: &Path) -> CString {
+    CString::new(path.to_string_lossy().into_owned()).unwrap()
+}
+
+/// Benchmark every operation on one fixture, named `operation/fixture`
+fn bench_fixture(r: &mut Runner, ctx: Handle, path: &Path, label: &str, out_dir: &Path) {
+    let file = c_path(path);
+    let out = c_path(&out_dir.join("out.pdf"));
+
+    r.bench(format!("open/{}", label), || {
+        let doc = fz_open_document(ctx, file.as_ptr());
+        black_box(fz_count_pages(ctx, doc));
+        fz_drop_document(ctx, doc);
+    });
+
+    let doc = fz_open_document(ctx, file.as_ptr());
+    if doc == 0 {
+        return;
+    }
+    let pages: Vec<Handle> = (0..fz_count_pages(ctx, doc))
+        .map(|i| fz_load_page(ctx, doc, i))
+        .filter(|&page| page != 0)
+        .collect();
+
+    r.bench(format!("repair/{}", label), || {
+        pdf_drop_xref(ctx, pdf_repair_xref(ctx, doc, 0));
+    });
+
+    r.bench(format!("interpret/{}", label), || {
+        for &page in &pages {
+            let mut bbox = fz_rect {
+                x0: 0.0,
+                y0: 0.0,
+                x1: 0.0,
+                y1: 0.0,
+            };
+            let dev = fz_new_bbox_device(ctx, &mut bbox);
+            fz_run_page(ctx, page, dev, fz_scale(1.0, 1.0), std::ptr::null_mut());
+            fz_close_device(ctx, dev);
+            fz_drop_device(ctx, dev);
+        }
+    });
+
+    // The first page only: every page of a long document at 300 DPI would
+    // dominate the run
+    if let Some(&first) = pages.first() {
+        for dpi in RENDER_DPI {
+            let zoom = dpi as f32 / 72.0;
+            r.bench(format!("render_{}dpi/{}", dpi, label), || {
+                let ctm = fz_scale(zoom, zoom);
+                let pix = fz_new_pixmap_from_page(ctx, first, ctm, fz_device_rgb(ctx), 0);
+                fz_drop_pixmap(ctx, pix);
+            });
+        }
+    }
+
+    r.bench(format!("text/{}", label), || {
+        for &page in &pages {
+            let stext = fz_new_stext_page_from_page(ctx, page, std::ptr::null());
+            black_box(fz_stext_page_as_text(ctx, stext));
+            fz_drop_stext_page(ctx, stext);
+        }
+    });
+
+    let stext: Vec<Handle> = pages
+        .iter()
+        .map(|&page| fz_new_stext_page_from_page(ctx, page, std::ptr::null()))
+        .collect();
+    let mut hits = [FzQuad::default(); 64];
+    r.bench(format!("search/{}", label), || {
+        for &st in &stext {
+            black_box(fz_search_stext_page(
+                ctx,
+                st,
+                SEARCH_NEEDLE.as_ptr(),
+                std::ptr::null_mut(),
+                hits.as_mut_ptr(),
+                hits.len() as i32,
+            ));
+        }
+    });
+    for st in stext {
+        fz_drop_stext_page(ctx, st);
+    }
+
+    let inputs = vec![path.to_string_lossy().into_owned(); 2];
+    let merged = out_dir.join("merged.pdf").to_string_lossy().into_owned();
+    r.bench(format!("merge/{}", label), || {
+        let _ = black_box(merge_pdf(&inputs, &merged));
+    });
+
+    r.bench(format!("optimize/{}", label), || {
+        pdf_optimize(ctx, doc, out.as_ptr())
+    });
+
+    r.bench(format!("linearize/{}", label), || {
+        pdf_linearize(ctx, doc, out.as_ptr())
+    });
+
+    // Rewriting changes the document, so each run gets a fresh copy
+    r.bench_with_setup(
+        format!("image_rewrite/{}", label),
+        || fz_open_document(ctx, file.as_ptr()),
+        |copy| {
+            let mut opts = pdf_web_image_rewriter_options();
+            pdf_rewrite_images(ctx, copy, &mut opts);
+            fz_drop_document(ctx, copy);
+        },
+    );
+
+    r.bench(format!("save/{}", label), || {
+        pdf_save_document(ctx, doc, out.as_ptr(), std::ptr::null())
+    });
+
+    for page in pages {
+        fz_drop_page(ctx, page);
+    }
+    fz_drop_document(ctx, doc);
+}
+
+// ============================================================================
+// Results
+// ============================================================================
+
+/// Median times by benchmark name from a results file
+fn load_baseline(path: &Path) -> Option<Vec<(String, f64)>> {
+    let text = std::fs::read_to_string(path).ok()?;
+    let root = JsonParser::new(&text).parse()?;
+    let field = |object: &JsonValue, key: &str| {
+        object
+            .as_object()?
+            .iter()
+            .find(|(k, _)| k == key)
+            .map(|(_, v)| v.clone())
+    };
+    let benchmarks = field(&root, "benchmarks")?;
+    Some(
+        benchmarks
+            .as_array()?
+            .iter()
+            .filter_map(|b| {
+                let name = field(b, "name")?.as_str()?.to_string();
+                Some((name, field(b, "median_ns")?.as_number()?))
+            })
+            .collect(),
+    )
+}
+
+/// Write the results, compared against `baseline` if given, and return the
+/// names of the benchmarks that regressed
+fn report(
+    results: &[Measurement],
+    baseline: Option<&[(String, f64)]>,
+    max_regression: f64,
+    out: &Path,
+) -> Vec<String> {
+    let number = |n: u64| JsonValue::Number(n as f64);
+    let mut regressions = Vec::new();
+    let mut benchmarks = Vec::new();
+
+    if baseline.is_some() {
+        println!();
+        println!(
+            "{:<60} {:>12} {:>12} {:>9}",
+            "", "baseline", "current", "change"
+        );
+    }
+    for m in results {
+        let mut fields = vec![
+            ("name".to_string(), JsonValue::String(m.name.clone())),
+            ("iterations".to_string(), number(m.iterations as u64)),
+            ("median_ns".to_string(), number(m.median)),
+            ("mean_ns".to_string(), number(m.mean)),
+            ("min_ns".to_string(), number(m.min)),
+            ("max_ns".to_string(), number(m.max)),
+        ];
+        let before = baseline.and_then(|b| b.iter().find(|(name, _)| *name == m.name));
+        if let Some(&(_, before)) = before.filter(|(_, ns)| *ns > 0.0) {
+            let change = (m.median as f64 - before) / before * 100.0;
+            let regressed = change > max_regression;
+            println!(
+                "{:<60} {:>12} {:>12} {:>+8.1}%{}",
+                m.name,
+                format_ns(before as u64),
+                format_ns(m.median),
+                change,
+                if regressed { "  REGRESSED" } else { "" }
+            );
+            if regressed {
+                regressions.push(m.name.clone());
+            }
+            fields.push(("baseline_median_ns".to_string(), JsonValue::Number(before)));
+            fields.push(("change_pct".to_string(), JsonValue::Number(change)));
+        }
+        benchmarks.push(JsonValue::Object(fields));
+    }
+
+    let timestamp = SystemTime::now()
+        .duration_since(UNIX_EPOCH)
+        .map_or(0, |d| d.as_secs());
+    let root = JsonValue::Object(vec![
+        ("suite".to_string(), JsonValue::String("fixtures".into())),
+        (
+            "version".to_string(),
+            JsonValue::String(env!("CARGO_PKG_VERSION").into()),
+        ),
+        ("timestamp".to_string(), number(timestamp)),
+        (
+            "max_regression_pct".to_string(),
+            JsonValue::Number(max_regression),
+        ),
+        ("benchmarks".to_string(), JsonValue::Array(benchmarks)),
+        (
+            "regressions".to_string(),
+            JsonValue::Array(
+                regressions
+                    .iter()
+                    .map(|name| JsonValue::String(name.clone()))
+                    .collect(),
+            ),
+        ),
+    ]);
+    write_results(&root, out);
+    regressions
+}
+
+fn write_results(root: &JsonValue, out: &Path) {
+    if let Some(dir) = out.parent() {
+        let _ = std::fs::create_dir_all(dir);
+    }
+    match std::fs::write(out, root.to_pretty_json(2)) {
+        Ok(()) => println!("\nresults written to {}", out.display()),
+        Err(e) => eprintln!("can't write {}: {}", out.display(), e),
+    }
+}
+
+// ============================================================================
+// Scaling
+// ============================================================================
+
+/// A fixture opened for the scaling runs
+struct CorpusDoc {
+    doc: Handle,
+    pages: i32,
+}
+
+/// Throughput of one pipeline at one thread count
+struct ScalingPoint {
+    pipeline: &'static str,
+    threads: usize,
+    pages: usize,
+    seconds: f64,
+    p50: u64,
+    p99: u64,
+    /// CPU time over wall time per thread, 0..1; None off Linux
+    cpu_utilization: Option<f64>,
+    peak_rss: Option<u64>,
+}
+
+impl ScalingPoint {
+    fn pages_per_sec(&self) -> f64 {
+        self.pages as f64 / self.seconds.max(1e-9)
+    }
+}
+
+/// Process CPU time, user plus system, from /proc on Linux
+fn cpu_time() -> Option<Duration> {
+    let stat = std::fs::read_to_string("/proc/self/stat").ok()?;
+    // Fields after the parenthesized command name start at field 3 (state);
+    // utime and stime are fields 14 and 15, in USER_HZ ticks (100 on Linux)
+    let fields: Vec<&str> = stat.rsplit_once(')')?.1.split_whitespace().collect();
+    let ticks: u64 = fields.get(11)?.parse::<u64>().ok()? + fields.get(12)?.parse::<u64>().ok()?;
+    Some(Duration::from_millis(ticks * 10))
+}
+
+/// Start a fresh peak RSS measurement (Linux; elsewhere a no-op)
+fn reset_peak_rss() {
+    let _ = std::fs::write("/proc/self/clear_refs", "5");
+}
+
+/// Peak resident set size since `reset_peak_rss`, in bytes
+fn peak_rss() -> Option<u64> {
+    let status = std::fs::read_to_string("/proc/self/status").ok()?;
+    let line = status.lines().find(|l| l.starts_with("VmHWM:"))?;
+    let kb: u64 = line.split_whitespace().nth(1)?.parse().ok()?;
+    Some(kb * 1024)
+}
+
+fn percentile(sorted: &[u64], q: f64) -> u64 {
+    if sorted.is_empty() {
+        return 0;
+    }
+    sorted[((sorted.len() - 1) as f64 * q).round() as usize]
+}
+
+/// Run passes of a pipeline over the corpus for at least `time`
+///
+/// `pass` returns the pages it processed and pushes the latency of each
+/// unit of work it did (a page, or a document for whole-document steps).
+fn measure_scaling(
+    pipeline: &'static str,
+    threads: usize,
+    time: Duration,
+    mut pass: impl FnMut(&mut Vec<u64>) -> usize,
+) -> ScalingPoint {
+    let mut latencies = Vec::new();
+    pass(&mut latencies);
+    latencies.clear();
+
+    reset_peak_rss();
+    let cpu_before = cpu_time();
+    let start = Instant::now();
+    let mut pages = 0;
+    while pages == 0 || start.elapsed() < time {
+        let n = pass(&mut latencies);
+        if n == 0 {
+            break;
+        }
+        pages += n;
+    }
+    let wall = start.elapsed();
+    let cpu = cpu_time()
+        .zip(cpu_before)
+        .map(|(after, before)| after - before);
+    latencies.sort_unstable();
+
+    ScalingPoint {
+        pipeline,
+        threads,
+        pages,
+        seconds: wall.as_secs_f64(),
+        p50: percentile(&latencies, 0.50),
+        p99: percentile(&latencies, 0.99),
+        cpu_utilization: cpu.map(|cpu| cpu.as_secs_f64() / wall.as_secs_f64() / threads as f64),
+        peak_rss: peak_rss(),
+    }
+}
+
+/// Render every page through a render pool at 150 DPI
+///
+/// Latency runs from submission to the job being claimed, claiming in
+/// submission order.
+fn render_pool_pass(ctx: Handle, pool: Handle, corpus: &[CorpusDoc], lat: &mut Vec<u64>) -> usize {
+    let zoom = 150.0 / 72.0;
+    let mut jobs = Vec::new();
+    for d in corpus {
+        for page in 0..d.pages {
+            let ctm = fz_scale(zoom, zoom);
+            let job =
+                fz_render_pool_submit(ctx, pool, d.doc, page, ctm, fz_device_rgb(ctx), 0, -1, 0);
+            if job != 0 {
+                jobs.push((job, Instant::now()));
+            }
+        }
+    }
+    for &(job, submitted) in &jobs {
+        let pix = fz_render_pool_wait(ctx, pool, job);
+        lat.push(submitted.elapsed().as_nanos() as u64);
+        fz_drop_pixmap(ctx, pix);
+    }
+    jobs.len()
+}
+
+/// Render every recorded page in tiles at 300 DPI, one page at a time
+fn tile_render_pass(
+    ctx: Handle,
+    lists: &[(Handle, fz_rect)],
+    threads: usize,
+    lat: &mut Vec<u64>,
+) -> usize {
+    for &(list, b) in lists {
+        let renderer = fz_new_tile_renderer(ctx, b.x0, b.y0, b.x1, b.y1, 256, 256, 300.0 / 72.0, 0);
+        let task = fz_new_render_task(ctx, renderer);
+        let t = Instant::now();
+        let pix = fz_render_task_run(ctx, task, list, fz_device_rgb(ctx), threads as i32);
+        lat.push(t.elapsed().as_nanos() as u64);
+        fz_drop_pixmap(ctx, pix);
+        fz_drop_render_task(ctx, task);
+        fz_drop_tile_renderer(ctx, renderer);
+    }
+    lists.len()
+}
+
+/// Save every document with stream filtering spread over `threads`
+fn save_pass(
+    ctx: Handle,
+    corpus: &[CorpusDoc],
+    threads: usize,
+    out: &CString,
+    lat: &mut Vec<u64>,
+) -> usize {
+    let mut pages = 0;
+    for d in corpus {
+        let t = Instant::now();
+        pdf_save_document_parallel(
+            ctx,
+            d.doc,
+            out.as_ptr(),
+            std::ptr::null(),
+            threads as i32,
+            0,
+        );
+        lat.push(t.elapsed().as_nanos() as u64);
+        pages += d.pages as usize;
+    }
+    pages
+}
+
+/// Rebuild every document's xref by scanning on `threads`
+fn repair_pass(ctx: Handle, corpus: &[CorpusDoc], threads: usize, lat: &mut Vec<u64>) -> usize {
+    let mut pages = 0;
+    for d in corpus {
+        let t = Instant::now();
+        pdf_drop_xref(ctx, pdf_repair_xref(ctx, d.doc, threads as i32));
+        lat.push(t.elapsed().as_nanos() as u64);
+        pages += d.pages as usize;
+    }
+    pages
+}
+
+/// Every pipeline at every thread count
+fn run_scaling(
+    ctx: Handle,
+    fixtures: &[PathBuf],
+    options: &Options,
+    out_dir: &Path,
+) -> Vec<ScalingPoint> {
+    let corpus: Vec<CorpusDoc> = fixtures
+        .iter()
+        .map(|path| fz_open_document(ctx, c_path(path).as_ptr()))
+        .filter(|&doc| doc != 0)
+        .map(|doc| CorpusDoc {
+            doc,
+            pages: fz_count_pages(ctx, doc),
+        })
+        .filter(|d| d.pages > 0)
+        .collect();
+    let pages: Vec<Handle> = corpus
+        .iter()
+        .flat_map(|d| (0..d.pages).map(|i| fz_load_page(ctx, d.doc, i)))
+        .filter(|&page| page != 0)
+        .collect();
+    let lists: Vec<(Handle, fz_rect)> = pages
+        .iter()
+        .map(|&page| {
+            (
+                fz_new_display_list_from_page(ctx, page),
+                fz_bound_page(ctx, page),
+            )
+        })
+        .filter(|&(list, _)| list != 0)
+        .collect();
+    let out = c_path(&out_dir.join("out.pdf"));
+    let wanted = |pipeline: &str| options.filter.as_ref().is_none_or(|f| pipeline.contains(f));
+
+    let mut points = Vec::new();
+    for &threads in &options.threads {
+        let time = options.time;
+        if wanted("render_pool") {
+            let pool = fz_new_render_pool(ctx, threads as i32);
+            points.push(measure_scaling("render_pool", threads, time, |lat| {
+                render_pool_pass(ctx, pool, &corpus, lat)
+            }));
+            fz_drop_render_pool(ctx, pool);
+        }
+        if wanted("tile_render") {
+            points.push(measure_scaling("tile_render", threads, time, |lat| {
+                tile_render_pass(ctx, &lists, threads, lat)
+            }));
+        }
+        if wanted("parallel_save") {
+            points.push(measure_scaling("parallel_save", threads, time, |lat| {
+                save_pass(ctx, &corpus, threads, &out, lat)
+            }));
+        }
+        if wanted("repair") {
+            points.push(measure_scaling("repair", threads, time, |lat| {
+                repair_pass(ctx, &corpus, threads, lat)
+            }));
+        }
+        for p in &points[points.len().saturating_sub(4)..] {
+            if p.threads == threads {
+                print_scaling_point(p, &points);
+            }
+        }
+    }
+
+    for (list, _) in lists {
+        fz_drop_display_list(ctx, list);
+    }
+    for page in pages {
+        fz_drop_page(ctx, page);
+    }
+    for d in corpus {
+        fz_drop_document(ctx, d.doc);
+    }
+    points
+}
+
+/// Throughput relative to the pipeline's single-thread run
+fn speedup(point: &ScalingPoint, points: &[ScalingPoint]) -> Option<f64> {
+    let single = points
+        .iter()
+        .find(|p| p.pipeline == point.pipeline && p.threads == 1)?;
+    Some(point.pages_per_sec() / single.pages_per_sec().max(1e-9))
+}
+
+fn print_scaling_point(p: &ScalingPoint, points: &[ScalingPoint]) {
+    let or_dash = |v: Option<String>| v.unwrap_or_else(|| "-".into());
+    println!(
+        "{:<14} {:>3} threads {:>10.1} pages/s  p50 {:>10}  p99 {:>10}  cpu {:>6}  rss {:>9}  speedup {:>6}",
+        p.pipeline,
+        p.threads,
+        p.pages_per_sec(),
+        format_ns(p.p50),
+        format_ns(p.p99),
+        or_dash(p.cpu_utilization.map(|u| format!("{:.0}%", u * 100.0))),
+        or_dash(p.peak_rss.map(|b| format!("{} MiB", b >> 20))),
+        or_dash(speedup(p, points).map(|s| format!("{:.2}x", s))),
+    );
+}
+
+fn report_scaling(points: &[ScalingPoint], out: &Path) {
+    let number = |n: u64| JsonValue::Number(n as f64);
+    let optional = |v: Option<f64>| v.map_or(JsonValue::Null, JsonValue::Number);
+    let entries = points
+        .iter()
+        .map(|p| {
+            JsonValue::Object(vec![
+                ("pipeline".to_string(), JsonValue::String(p.pipeline.into())),
+                ("threads".to_string(), number(p.threads as u64)),
+                ("pages".to_string(), number(p.pages as u64)),
+                ("seconds".to_string(), JsonValue::Number(p.seconds)),
+                (
+                    "pages_per_sec".to_string(),
+                    JsonValue::Number(p.pages_per_sec()),
+                ),
+                ("p50_ns".to_string(), number(p.p50)),
+                ("p99_ns".to_string(), number(p.p99)),
+                ("cpu_utilization".to_string(), optional(p.cpu_utilization)),
+                (
+                    "peak_rss_bytes".to_string(),
+                    optional(p.peak_rss.map(|b| b as f64)),
+                ),
+                ("speedup".to_string(), optional(speedup(p, points))),
+            ])
+        })
+        .collect();
+    let cores = std::thread::available_parallelism().map_or(1, |n| n.get());
+    let root = JsonValue::Object(vec![
+        ("suite".to_string(), JsonValue::String("scaling".into())),
+        (
+            "version".to_string(),
+            JsonValue::String(env!("CARGO_PKG_VERSION").into()),
+        ),
+        ("cores".to_string(), number(cores as u64)),
+        ("points".to_string(), JsonValue::Array(entries)),
+    ]);
+    write_results(&root, out);
+}
+
+fn main() {
+    let options = Options::from_args();
+    let fixtures = find_fixtures(&options.fixtures);
+    let out_dir = tempfile::tempdir().expect("temporary directory");
+    // SAFETY: null allocator and locks select the defaults
+    let ctx = unsafe { fz_new_context(std::ptr::null(), std::ptr::null(), 0) };
+    let target = PathBuf::from(env!("CARGO_MANIFEST_DIR")).join("target/bench");
+
+    if options.scaling {
+        let points = run_scaling(ctx, &fixtures, &options, out_dir.path());
+        fz_drop_context(ctx);
+        let out = options
+            .json_out
+            .unwrap_or_else(|| target.join("scaling.json"));
+        report_scaling(&points, &out);
+        return;
+    }
+
+    let mut runner = Runner {
+        time: options.time,
+        filter: options.filter.clone(),
+        results: Vec::new(),
+    };
+    for path in &fixtures {
+        let label = path
+            .strip_prefix(&options.fixtures)
+            .unwrap_or(path)
+            .to_string_lossy()
+            .replace('\\', "/");
+        bench_fixture(&mut runner, ctx, path, &label, out_dir.path());
+    }
+    fz_drop_context(ctx);
+
+    let baseline = options.json_baseline.as_deref().map(|path| {
+        load_baseline(path).unwrap_or_else(|| {
+            eprintln!("can't read baseline {}", path.display());
+            std::process::exit(2)
+        })
+    });
+    let regressions = report(
+        &runner.results,
+        baseline.as_deref(),
+        options.max_regression,
+        &options
+            .json_out
+            .unwrap_or_else(|| target.join("fixtures.json")),
+    );
+    if !regressions.is_empty() {
+        eprintln!(
+            "{} benchmark(s) slowed down by more than {}%",
+            regressions.len(),
+            options.max_regression
+        );
+        std::process::exit(1);
+    }
+}
@@ -0,0 +1,302 @@
+//! SIMD Kernel Benchmarks
+//!
+//! Runs every dispatched kernel in `ffi::simd_util` at every level this CPU
+//! supports (scalar, SSE2, SSE4.1, AVX, AVX2 or NEON), pinned with
+//! `set_level`, over the same pseudo-random input. Throughput is reported
+//! in bytes of input, so criterion prints GiB/s, and before timing a level
+//! its output is checked bit for bit against the scalar kernel; a mismatch
+//! aborts the run naming the kernel and level.
+
+use std::collections::hash_map::DefaultHasher;
+use std::hash::{Hash, Hasher};
+
+use criterion::{Criterion, Throughput, black_box, criterion_group, criterion_main};
+use micropdf::ffi::simd_util::{
+    PdfByteClass, SimdLevel, SimdMatrix, available_levels, base64_decode, base64_encode,
+    buffer_copy, buffer_equal, buffer_fill, find_bytes, hash64, matrix_concat, pack_below,
+    points_in_rect, quad_bounds, rect_union, rgb_to_cmyk_batch, scan_pdf_class, set_level,
+    transform_points, transform_rects,
+};
+
+/// Input bytes per kernel call
+const SIZE: usize = 64 * 1024;
+
+/// Pseudo-random, reproducible input
+struct Input {
+    bytes: Vec<u8>,
+    /// Bytes drawn from the PDF lexer's classes
+    text: Vec<u8>,
+    coords: Vec<f32>,
+    /// Values in [0, 1]
+    unit: Vec<f32>,
+}
+
+impl Input {
+    fn new() -> Self {
+        let mut state = 0x9e37_79b9_7f4a_7c15u64;
+        let mut next = move || {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            state
+        };
+        let bytes: Vec<u8> = (0..SIZE).map(|_| next() as u8).collect();
+        let text = bytes
+            .iter()
+            .map(|&b| b"ab 0123\n/()<>[]{}%x\t"[b as usize % 20])
+            .collect();
+        let coords = (0..SIZE / 4)
+            .map(|_| (next() % 20001) as f32 / 10.0 - 1000.0)
+            .collect();
+        let unit = (0..SIZE / 4)
+            .map(|_| (next() % 1001) as f32 / 1000.0)
+            .collect();
+        Input {
+            bytes,
+            text,
+            coords,
+            unit,
+        }
+    }
+}
+
+fn digest<T: Hash + ?Sized>(value: &T) -> u64 {
+    let mut h = DefaultHasher::new();
+    value.hash(&mut h);
+    h.finish()
+}
+
+fn float_digest(values: &[f32]) -> u64 {
+    digest(&values.iter().map(|f| f.to_bits()).collect::<Vec<_>>())
+}
+
+/// A kernel call; with `check` set it returns a digest of its output
+type Kernel = Box<dyn FnMut(bool) -> u64>;
+
+fn kernels(input: &Input) -> Vec<(&'static str, Kernel)> {
+    let m = SimdMatrix::new(1.5, 0.25, -0.5, 2.0, 10.0, -20.0);
+    let points: Vec<(f32, f32)> = input.coords.chunks_exact(2).map(|p| (p[0], p[1])).collect();
+    let rects: Vec<[f32; 4]> = input
+        .coords
+        .chunks_exact(4)
+        .map(|r| {
+            [
+                r[0].min(r[2]),
+                r[1].min(r[3]),
+                r[0].max(r[2]),
+                r[1].max(r[3]),
+            ]
+        })
+        .collect();
+    let quads: Vec<[f32; 8]> = input
+        .coords
+        .chunks_exact(8)
+        .map(|q| q.try_into().unwrap())
+        .collect();
+    let rgb: Vec<(f32, f32, f32)> = input
+        .unit
+        .chunks_exact(3)
+        .map(|c| (c[0], c[1], c[2]))
+        .collect();
+    let bytes = input.bytes.clone();
+    let text = input.text.clone();
+    let encoded = base64_encode(&bytes);
+
+    let mut list: Vec<(&'static str, Kernel)> = Vec::new();
+    list.push((
+        "matrix_concat",
+        Box::new(move |check| {
+            let mut out = m;
+            for _ in 0..SIZE / 48 {
+                out = matrix_concat(black_box(&out), &m);
+            }
+            if check { float_digest(&out.data) } else { 0 }
+        }),
+    ));
+    let mut work = points.clone();
+    let source = points.clone();
+    list.push((
+        "transform_points",
+        Box::new(move |check| {
+            work.copy_from_slice(&source);
+            transform_points(&mut work, &m);
+            if check {
+                let flat: Vec<f32> = work.iter().flat_map(|&(x, y)| [x, y]).collect();
+                float_digest(&flat)
+            } else {
+                0
+            }
+        }),
+    ));
+    let mut work = rects.clone();
+    let source = rects.clone();
+    list.push((
+        "transform_rects",
+        Box::new(move |check| {
+            work.copy_from_slice(&source);
+            transform_rects(&mut work, &m);
+            if check {
+                float_digest(work.as_flattened())
+            } else {
+                0
+            }
+        }),
+    ));
+    let mut bounds = vec![[0.0f32; 4]; quads.len()];
+    list.push((
+        "quad_bounds",
+        Box::new(move |check| {
+            quad_bounds(&quads, &mut bounds);
+            if check {
+                float_digest(bounds.as_flattened())
+            } else {
+                0
+            }
+        }),
+    ));
+    list.push((
+        "rect_union",
+        Box::new(move |check| {
+            let u = rect_union(black_box(&rects));
+            if check { float_digest(&u) } else { 0 }
+        }),
+    ));
+    let mut inside = vec![0u8; points.len()];
+    list.push((
+        "points_in_rect",
+        Box::new(move |check| {
+            let n = points_in_rect(&points, [-500.0, -500.0, 500.0, 500.0], &mut inside);
+            if check { digest(&(n, &inside)) } else { 0 }
+        }),
+    ));
+    let mut cmyk = vec![(0.0, 0.0, 0.0, 0.0); rgb.len()];
+    list.push((
+        "rgb_to_cmyk_batch",
+        Box::new(move |check| {
+            rgb_to_cmyk_batch(&rgb, &mut cmyk);
+            if check {
+                let flat: Vec<f32> = cmyk.iter().flat_map(|&(c, m, y, k)| [c, m, y, k]).collect();
+                float_digest(&flat)
+            } else {
+                0
+            }
+        }),
+    ));
+    let mut dst = vec![0u8; SIZE];
+    list.push((
+        "buffer_fill",
+        Box::new(move |check| {
+            buffer_fill(&mut dst[1..], 0xa5);
+            if check { digest(&dst) } else { 0 }
+        }),
+    ));
+    let mut dst = vec![0u8; SIZE];
+    let src = bytes.clone();
+    list.push((
+        "buffer_copy",
+        Box::new(move |check| {
+            buffer_copy(&mut dst[3..], &src[1..]);
+            if check { digest(&dst) } else { 0 }
+        }),
+    ));
+    let (a, b) = (bytes.clone(), bytes.clone());
+    list.push((
+        "buffer_equal",
+        Box::new(move |_| buffer_equal(black_box(&a), black_box(&b)) as u64),
+    ));
+    let src = text.clone();
+    list.push((
+        "scan_pdf_class",
+        Box::new(move |_| {
+            let mut at = 0;
+            let mut runs = 0u64;
+            for class in [
+                PdfByteClass::Whitespace,
+                PdfByteClass::Regular,
+                PdfByteClass::Digit,
+            ]
+            .iter()
+            .cycle()
+            {
+                if at >= src.len() {
+                    break;
+                }
+                at += scan_pdf_class(&src[at..], *class).max(1);
+                runs = runs.wrapping_mul(31).wrapping_add(at as u64);
+            }
+            runs
+        }),
+    ));
+    let src = text.clone();
+    list.push((
+        "find_bytes",
+        Box::new(move |_| {
+            // Absent, so the whole haystack is scanned
+            let miss = find_bytes(&src, b"%%EOF").map_or(u64::MAX, |p| p as u64);
+            let hit = find_bytes(&src, b"x\tab").map_or(u64::MAX, |p| p as u64);
+            miss ^ hit.rotate_left(32)
+        }),
+    ));
+    let src = bytes.clone();
+    list.push(("hash64", Box::new(move |_| hash64(black_box(&src)))));
+    let src = bytes.clone();
+    list.push((
+        "base64_encode",
+        Box::new(move |check| {
+            let out = base64_encode(&src);
+            if check { digest(&out) } else { 0 }
+        }),
+    ));
+    list.push((
+        "base64_decode",
+        Box::new(move |check| {
+            let out = base64_decode(&encoded);
+            if check { digest(&out) } else { 0 }
+        }),
+    ));
+    let mut packed = vec![0u8; SIZE.div_ceil(8)];
+    list.push((
+        "pack_below",
+        Box::new(move |check| {
+            pack_below(&bytes, &text, &mut packed);
+            if check { digest(&packed) } else { 0 }
+        }),
+    ));
+    list
+}
+
+fn level_name(level: SimdLevel) -> String {
+    format!("{:?}", level).to_lowercase()
+}
+
+fn bench_kernels(c: &mut Criterion) {
+    let input = Input::new();
+    let levels = available_levels();
+
+    for (name, mut kernel) in kernels(&input) {
+        set_level(Some(SimdLevel::Scalar));
+        let expected = kernel(true);
+        for &level in &levels {
+            set_level(Some(level));
+            assert_eq!(
+                kernel(true),
+                expected,
+                "{} at {} differs from the scalar kernel",
+                name,
+                level_name(level)
+            );
+        }
+
+        let mut group = c.benchmark_group(format!("simd/{}", name));
+        group.throughput(Throughput::Bytes(SIZE as u64));
+        for &level in &levels {
+            set_level(Some(level));
+            group.bench_function(level_name(level), |b| b.iter(|| kernel(false)));
+        }
+        group.finish();
+    }
+    set_level(None);
+}
+
+criterion_group!(benches, bench_kernels);
+criterion_main!(benches);
@@ -11,6 +11,7 @@ extern "C" {
 #include "mupdf/fitz/archive.h"
 #include "mupdf/fitz/band_writer.h"
 #include "mupdf/fitz/barcode.h"
+#include "mupdf/fitz/barcode_scan.h"
 #include "mupdf/fitz/bidi.h"
 #include "mupdf/fitz/bitmap.h"
 #include "mupdf/fitz/buffer.h"
@@ -18,8 +19,10 @@ extern "C" {
 #include "mupdf/fitz/cbz.h"
 #include "mupdf/fitz/color.h"
 #include "mupdf/fitz/colorspace.h"
+#include "mupdf/fitz/command_buffer.h"
 #include "mupdf/fitz/compress.h"
 #include "mupdf/fitz/context.h"
+#include "mupdf/fitz/context_snapshot.h"
 #include "mupdf/fitz/cookie.h"
 #include "mupdf/fitz/data_locality.h"
 #include "mupdf/fitz/deskew.h"
@@ -32,6 +35,7 @@ extern "C" {
 #include "mupdf/fitz/geometry.h"
 #include "mupdf/fitz/glyph.h"
 #include "mupdf/fitz/glyph_cache.h"
+#include "mupdf/fitz/glyph_disk_cache.h"
 #include "mupdf/fitz/gpu.h"
 #include "mupdf/fitz/hashmap_util.h"
 #include "mupdf/fitz/heap.h"
@@ -45,6 +49,7 @@ extern "C" {
 #include "mupdf/fitz/memory_profiler.h"
 #include "mupdf/fitz/mmap.h"
 #include "mupdf/fitz/ocr.h"
+#include "mupdf/fitz/ocr_pipeline.h"
 #include "mupdf/fitz/office.h"
 #include "mupdf/fitz/outline.h"
 #include "mupdf/fitz/output.h"
@@ -55,7 +60,9 @@ extern "C" {
 #include "mupdf/fitz/pdf_conformance.h"
 #include "mupdf/fitz/pdf_event.h"
 #include "mupdf/fitz/pdf_font.h"
+#include "mupdf/fitz/pdf_gc.h"
 #include "mupdf/fitz/pdf_image_rewriter.h"
+#include "mupdf/fitz/pdf_incremental.h"
 #include "mupdf/fitz/pdf_interpret.h"
 #include "mupdf/fitz/pdf_javascript.h"
 #include "mupdf/fitz/pdf_layer.h"
@@ -65,12 +72,20 @@ extern "C" {
 #include "mupdf/fitz/pdf_portfolio.h"
 #include "mupdf/fitz/pdf_recolor.h"
 #include "mupdf/fitz/pdf_redact.h"
+#include "mupdf/fitz/pdf_repair.h"
 #include "mupdf/fitz/pdf_resource.h"
 #include "mupdf/fitz/pdf_signature.h"
+#include "mupdf/fitz/pdf_stream_prefetch.h"
 #include "mupdf/fitz/pdf_xref.h"
+#include "mupdf/fitz/pdf_xref_lazy.h"
 #include "mupdf/fitz/pdf_zugferd.h"
+#include "mupdf/fitz/perf_counters.h"
 #include "mupdf/fitz/pixmap.h"
+#include "mupdf/fitz/pixmap_pool.h"
 #include "mupdf/fitz/pool.h"
+#include "mupdf/fitz/range_source.h"
+#include "mupdf/fitz/render_pool.h"
+#include "mupdf/fitz/search_index.h"
 #include "mupdf/fitz/separation.h"
 #include "mupdf/fitz/shade.h"
 #include "mupdf/fitz/simd_util.h"
@@ -83,7 +98,10 @@ extern "C" {
 #include "mupdf/fitz/svg.h"
 #include "mupdf/fitz/table_detect.h"
 #include "mupdf/fitz/text.h"
+#include "mupdf/fitz/text_extract.h"
+#include "mupdf/fitz/thumbnail.h"
 #include "mupdf/fitz/tile_render.h"
+#include "mupdf/fitz/trace.h"
 #include "mupdf/fitz/transition.h"
 #include "mupdf/fitz/tree.h"
 #include "mupdf/fitz/util.h"
@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Archive Functions (13 total)
+// Archive Functions (14 total)
 // ============================================================================
 
 int32_t fz_archive_entry_names(int32_t _ctx, int32_t archive, char * buf, int32_t bufsize);
@@ -29,6 +29,7 @@ int32_t fz_keep_archive(int32_t _ctx, int32_t archive);
 int32_t fz_list_archive_entry(int32_t _ctx, int32_t archive, int32_t idx, char * buf, int32_t bufsize);
 int32_t fz_open_archive(int32_t _ctx, const char * path);
 int32_t fz_open_archive_with_buffer(int32_t _ctx, u8 const * data, size_t size);
+int32_t fz_read_archive_entries(int32_t _ctx, int32_t archive, const char * const * names, int32_t count, int32_t threads, int32_t * buffers);
 int32_t fz_read_archive_entry(int32_t _ctx, int32_t archive, const char * name);
 
 #ifdef __cplusplus
@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Band_writer Functions (21 total)
+// Band_writer Functions (22 total)
 // ============================================================================
 
 size_t fz_band_writer_bytes_written(int32_t _ctx, int32_t writer);
@@ -30,6 +30,7 @@ void fz_band_writer_set_progress(int32_t _ctx, int32_t writer, ProgressCallback
 void fz_band_writer_set_res(int32_t _ctx, int32_t writer, int32_t x_res, int32_t y_res);
 void fz_band_writer_set_rows_per_band(int32_t _ctx, int32_t writer, int32_t rows);
 int32_t fz_band_writer_state(int32_t _ctx, int32_t writer);
+int32_t fz_band_writer_take_output(int32_t _ctx, int32_t writer);
 int32_t fz_band_writer_total_bands(int32_t _ctx, int32_t writer);
 int32_t fz_band_writer_write_band(int32_t _ctx, int32_t writer, int32_t band_rows, u8 const * data);
 int32_t fz_band_writer_write_header(int32_t _ctx, int32_t writer);
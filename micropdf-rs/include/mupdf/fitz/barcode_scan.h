@@ -0,0 +1,27 @@
+// MicroPDF - MuPDF API Compatible C Header
+// Auto-generated from Rust FFI - DO NOT EDIT MANUALLY
+// Module: barcode_scan
+
+#ifndef MUPDF_FITZ_BARCODE_SCAN_H
+#define MUPDF_FITZ_BARCODE_SCAN_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// Barcode_scan Functions (2 total)
+// ============================================================================
+
+int32_t fz_find_barcode_regions(int32_t _ctx, int32_t pix, BarcodeRegion * regions, int32_t max);
+int32_t fz_scan_document_barcodes(int32_t ctx, int32_t doc, int32_t scan_dpi, int32_t decode_dpi, int32_t threads, int32_t max_in_flight, FzBarcodeCallback callback, void * opaque);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MUPDF_FITZ_BARCODE_SCAN_H */
@@ -14,12 +14,13 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Bitmap Functions (20 total)
+// Bitmap Functions (21 total)
 // ============================================================================
 
 void fz_bitmap_clear(int32_t _ctx, int32_t bitmap);
+size_t fz_bitmap_compress_packbits(int32_t _ctx, int32_t bitmap, u8 * output, size_t max_size);
 size_t fz_bitmap_compress_rle(int32_t _ctx, int32_t bitmap, u8 * output, size_t max_size);
-size_t fz_bitmap_compressed_size(int32_t _ctx, int32_t bitmap, int32_t _compression);
+size_t fz_bitmap_compressed_size(int32_t _ctx, int32_t bitmap, int32_t compression);
 u8 const * fz_bitmap_data(int32_t _ctx, int32_t bitmap);
 size_t fz_bitmap_data_size(int32_t _ctx, int32_t bitmap);
 void fz_bitmap_fill(int32_t _ctx, int32_t bitmap);
@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Cbz Functions (35 total)
+// Cbz Functions (37 total)
 // ============================================================================
 
 int32_t cbz_add_entry(int32_t _ctx, int32_t doc, const char * name);
@@ -25,6 +25,7 @@ int32_t cbz_get_format(int32_t _ctx, int32_t doc);
 int32_t cbz_get_manga(int32_t _ctx, int32_t doc);
 char * cbz_get_number(int32_t _ctx, int32_t doc);
 char * cbz_get_page_filename(int32_t _ctx, int32_t doc, int32_t page_num);
+u8 const * cbz_get_page_data(int32_t _ctx, int32_t doc, int32_t page_num, size_t * len);
 int32_t cbz_get_page_format(int32_t _ctx, int32_t doc, int32_t page_num);
 int32_t cbz_get_page_size(int32_t _ctx, int32_t doc, int32_t page_num, int32_t * width, int32_t * height);
 char * cbz_get_publisher(int32_t _ctx, int32_t doc);
@@ -35,9 +36,10 @@ char * cbz_get_writer(int32_t _ctx, int32_t doc);
 int32_t cbz_get_year(int32_t _ctx, int32_t doc);
 char * cbz_image_format_name(int32_t _ctx, int32_t format);
 int32_t cbz_is_image_file(int32_t _ctx, const char * filename);
+int32_t cbz_load_pages(int32_t _ctx, int32_t doc, int32_t first, int32_t count, int32_t threads);
 int32_t cbz_new_document(int32_t ctx);
 int32_t cbz_open_document(int32_t ctx, const char * filename);
-int32_t cbz_open_document_with_archive(int32_t ctx, int32_t _archive);
+int32_t cbz_open_document_with_archive(int32_t ctx, int32_t archive);
 int32_t cbz_open_document_with_stream(int32_t ctx, int32_t _stream);
 int32_t cbz_page_count(int32_t _ctx, int32_t doc);
 int32_t cbz_page_is_double(int32_t _ctx, int32_t doc, int32_t page_num);
@@ -23,7 +23,7 @@ int32_t fz_color_params_op(ColorParams params);
 int32_t fz_color_params_opm(ColorParams params);
 int32_t fz_color_params_ri(ColorParams params);
 void fz_colorspace_digest(int32_t _ctx, int32_t _cs, u8 * digest);
-void fz_convert_color_with_params(int32_t _ctx, int32_t src_cs, float const * src, int32_t dst_cs, float * dst, int32_t proof_cs, ColorParams _params);
+void fz_convert_color_with_params(int32_t _ctx, int32_t src_cs, float const * src, int32_t dst_cs, float * dst, int32_t proof_cs, ColorParams params);
 int32_t fz_default_cmyk(int32_t _ctx, int32_t default_cs);
 ColorParams fz_default_color_params(void);
 int32_t fz_default_gray(int32_t _ctx, int32_t default_cs);
@@ -57,7 +57,7 @@ int32_t fz_device_srgb(int32_t _ctx);
 void fz_drop_colorspace(int32_t _ctx, int32_t _cs);
 int32_t fz_keep_colorspace(int32_t _ctx, int32_t cs);
 int32_t fz_new_device_n_colorspace(int32_t _ctx, int32_t base, int32_t n, const char * const * _colorants);
-int32_t fz_new_icc_colorspace(int32_t _ctx, int32_t _type_hint, int32_t // Hint about what type of colorspace (gray, rgb, cmyk) _flags, const char * name, u8 const * _data, size_t _size);
+int32_t fz_new_icc_colorspace(int32_t _ctx, int32_t _type_hint, int32_t // Hint about what type of colorspace (gray, rgb, cmyk) _flags, const char * name, u8 const * data, size_t size);
 int32_t fz_new_indexed_colorspace(int32_t _ctx, int32_t base, int32_t high, u8 const * lookup);
 
 #ifdef __cplusplus
@@ -0,0 +1,46 @@
+// MicroPDF - MuPDF API Compatible C Header
+// Auto-generated from Rust FFI - DO NOT EDIT MANUALLY
+// Module: command_buffer
+
+#ifndef MUPDF_FITZ_COMMAND_BUFFER_H
+#define MUPDF_FITZ_COMMAND_BUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// Commands
+// ============================================================================
+
+/* fz_run_command_buffer opcodes and their little-endian operands */
+#define FZ_CMD_COUNT_PAGES  1 /* doc:u64 -> count */
+#define FZ_CMD_LOAD_PAGE    2 /* doc:u64 number:i32 -> page */
+#define FZ_CMD_BOUND_PAGE   3 /* page:u64 -> fz_rect */
+#define FZ_CMD_RENDER_PAGE  4 /* page:u64 ctm:6*f32 cs:u64 alpha:i32 -> pixmap */
+#define FZ_CMD_ENCODE_PNG   5 /* pixmap:u64 -> buffer */
+#define FZ_CMD_PAGE_TEXT    6 /* page:u64 -> buffer */
+#define FZ_CMD_DROP_PAGE    7 /* page:u64 */
+#define FZ_CMD_DROP_PIXMAP  8 /* pixmap:u64 */
+#define FZ_CMD_DROP_BUFFER  9 /* buffer:u64 */
+
+/* Handle operand referring to the result of command i: FZ_CMD_RESULT | i */
+#define FZ_CMD_RESULT       (1ULL << 63)
+/* Result record: i32 status, 4 reserved bytes, 16-byte payload */
+#define FZ_CMD_RESULT_SIZE  24
+
+// ============================================================================
+// Command_buffer Functions (1 total)
+// ============================================================================
+
+int32_t fz_run_command_buffer(int32_t ctx, const uint8_t * cmds, size_t len, uint8_t * results, size_t results_cap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MUPDF_FITZ_COMMAND_BUFFER_H */
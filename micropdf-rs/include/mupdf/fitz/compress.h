@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Compress Functions (25 total)
+// Compress Functions (26 total)
 // ============================================================================
 
 size_t fz_brotli_bound(int32_t _ctx, size_t size);
@@ -32,6 +32,7 @@ void fz_deflate(int32_t _ctx, u8 * dest, size_t * compressed_length, u8 const *
 size_t fz_deflate_bound(int32_t _ctx, size_t size);
 int32_t fz_deflate_to_buffer(int32_t _ctx, u8 const * source, size_t source_length, int32_t level);
 void fz_drop_compressed_buffer(int32_t _ctx, int32_t cbuf);
+const char * fz_flate_backend(int32_t _ctx);
 const char * fz_image_type_name(int32_t image_type);
 int32_t fz_inflate(int32_t _ctx, u8 * dest, size_t * dest_length, u8 const * source, size_t source_length);
 int32_t fz_keep_compressed_buffer(int32_t _ctx, int32_t cbuf);
@@ -42,6 +43,7 @@ int32_t fz_new_compressed_buffer(int32_t _ctx);
 u8 * fz_new_deflated_data(int32_t _ctx, size_t * compressed_length, u8 const * source, size_t source_length, int32_t level);
 u8 * fz_new_deflated_data_from_buffer(int32_t _ctx, size_t * compressed_length, int32_t buffer, int32_t level);
 int32_t fz_recognize_image_format(int32_t _ctx, u8 const * data);
+uint64_t fz_register_brotli_dictionary(int32_t _ctx, u8 const * data, size_t len);
 
 #ifdef __cplusplus
 }
@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Context Functions (28 total)
+// Context Functions (29 total)
 // ============================================================================
 
 int fz_aa_level(int32_t ctx);
@@ -28,6 +28,7 @@ void fz_drop_context(int32_t ctx);
 void fz_empty_store(int32_t _ctx);
 void fz_enable_icc(int32_t ctx);
 void fz_flush_warnings(int32_t _ctx);
+uint64_t fz_handle_insert_failures(int32_t _ctx);
 int fz_has_error(int32_t ctx);
 void fz_ignore_error(int32_t ctx);
 int32_t fz_keep_context(int32_t ctx);
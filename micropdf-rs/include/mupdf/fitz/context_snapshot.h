@@ -0,0 +1,29 @@
+// MicroPDF - MuPDF API Compatible C Header
+// Auto-generated from Rust FFI - DO NOT EDIT MANUALLY
+// Module: context_snapshot
+
+#ifndef MUPDF_FITZ_CONTEXT_SNAPSHOT_H
+#define MUPDF_FITZ_CONTEXT_SNAPSHOT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// Context_snapshot Functions (4 total)
+// ============================================================================
+
+void fz_context_snapshot_stats(int32_t _ctx, int32_t snapshot, size_t * faces, size_t * glyphs, uint64_t * hits, uint64_t * misses);
+void fz_drop_context_snapshot(int32_t _ctx, int32_t snapshot);
+int32_t fz_open_context_snapshot(int32_t _ctx, const char * path);
+int fz_save_context_snapshot(int32_t _ctx, const char * path);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MUPDF_FITZ_CONTEXT_SNAPSHOT_H */
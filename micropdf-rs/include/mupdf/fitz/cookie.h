@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Cookie Functions (24 total)
+// Cookie Functions (27 total)
 // ============================================================================
 
 int32_t fz_clone_cookie(int32_t _ctx, int32_t cookie);
@@ -28,6 +28,8 @@ void fz_cookie_inc_progress(int32_t _ctx, int32_t cookie);
 int32_t fz_cookie_is_complete(int32_t _ctx, int32_t cookie);
 int32_t fz_cookie_is_incomplete(int32_t _ctx, int32_t cookie);
 int32_t fz_cookie_is_valid(int32_t _ctx, int32_t cookie);
+size_t fz_cookie_memory_limit(int32_t _ctx, int32_t cookie);
+size_t fz_cookie_memory_used(int32_t _ctx, int32_t cookie);
 float fz_cookie_progress_float(int32_t _ctx, int32_t cookie);
 int32_t fz_cookie_progress_percent(int32_t _ctx, int32_t cookie);
 int32_t fz_cookie_progress_remaining(int32_t _ctx, int32_t cookie);
@@ -35,6 +37,7 @@ void fz_cookie_reset(int32_t _ctx, int32_t cookie);
 void fz_cookie_reset_abort(int32_t _ctx, int32_t cookie);
 void fz_cookie_set_errors(int32_t _ctx, int32_t cookie, int32_t count);
 void fz_cookie_set_incomplete(int32_t _ctx, int32_t cookie, int32_t value);
+void fz_cookie_set_memory_limit(int32_t _ctx, int32_t cookie, size_t bytes);
 void fz_cookie_set_progress(int32_t _ctx, int32_t cookie, int32_t value);
 void fz_cookie_set_progress_max(int32_t _ctx, int32_t cookie, int32_t value);
 int32_t fz_cookie_should_abort(int32_t _ctx, int32_t cookie);
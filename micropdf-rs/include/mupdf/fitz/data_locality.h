@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Data_locality Functions (19 total)
+// Data_locality Functions (23 total)
 // ============================================================================
 
 void fz_drop_page_aligned_buffer(int32_t _ctx, int32_t buf);
@@ -23,10 +23,14 @@ void fz_drop_rect_soa(int32_t _ctx, int32_t soa);
 LocalityStatsSnapshot fz_locality_stats(int32_t _ctx);
 void fz_locality_stats_reset(int32_t _ctx);
 int32_t fz_new_page_aligned_buffer(int32_t _ctx, size_t capacity);
+int32_t fz_new_page_aligned_buffer_ex(int32_t _ctx, size_t capacity, int flags, int node);
 int32_t fz_new_point_soa(int32_t _ctx, size_t capacity);
 int32_t fz_new_rect_soa(int32_t _ctx, size_t capacity);
+int fz_numa_current_node(int32_t _ctx);
+int fz_numa_node_count(int32_t _ctx);
 size_t fz_page_buffer_capacity(int32_t _ctx, int32_t buf);
 size_t fz_page_buffer_len(int32_t _ctx, int32_t buf);
+int fz_page_buffer_placement(int32_t _ctx, int32_t buf);
 void fz_page_buffer_prefetch_read(int32_t _ctx, int32_t buf, int locality);
 void fz_page_buffer_prefetch_write(int32_t _ctx, int32_t buf, int locality);
 int fz_page_buffer_read(int32_t _ctx, int32_t buf, size_t offset, u8 * dst, size_t len);
@@ -14,13 +14,14 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Deskew Functions (9 total)
+// Deskew Functions (10 total)
 // ============================================================================
 
 int32_t fz_auto_deskew_pixmap(int32_t _ctx, int32_t src, int32_t border);
 int32_t fz_deskew_pixmap(int32_t _ctx, int32_t src, double degrees, int32_t border);
 double fz_detect_skew(int32_t _ctx, int32_t pixmap);
 int32_t fz_detect_skew_angle(int32_t _ctx, int32_t pixmap, double * angle);
+double fz_detect_skew_bitmap(int32_t _ctx, int32_t bitmap);
 int32_t fz_flip_pixmap_horizontal(int32_t _ctx, int32_t src);
 int32_t fz_flip_pixmap_vertical(int32_t _ctx, int32_t src);
 int32_t fz_is_skewed(int32_t _ctx, int32_t pixmap, double threshold);
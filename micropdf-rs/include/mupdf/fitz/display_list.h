@@ -14,19 +14,39 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Display_list Functions (10 total)
+// Serialization
+// ============================================================================
+
+/* fz_new_buffer_from_display_list flag: store font programs and images inline */
+#define FZ_DISPLAY_LIST_EMBED 1
+
+/* Returns a buffer holding the data with the given 32-byte SHA-256, or 0 */
+typedef int32_t (*fz_display_list_fetch_fn)(int32_t ctx, const uint8_t * hash, void * opaque);
+
+// ============================================================================
+// Display_list Functions (20 total)
 // ============================================================================
 
 fz_rect fz_bound_display_list(int32_t _ctx, int32_t list);
+int32_t fz_cached_display_list_from_page(int32_t ctx, int32_t page, int32_t flags, int32_t cookie);
 int32_t fz_clone_display_list(int32_t _ctx, int32_t list);
 void fz_display_list_clear(int32_t _ctx, int32_t list);
 int32_t fz_display_list_count_commands(int32_t _ctx, int32_t list);
+int32_t fz_display_list_count_resources(int32_t _ctx, int32_t list);
 int32_t fz_display_list_is_empty(int32_t _ctx, int32_t list);
 int32_t fz_display_list_is_valid(int32_t _ctx, int32_t list);
+int32_t fz_display_list_resource(int32_t _ctx, int32_t list, int32_t index, uint8_t * hash);
 void fz_drop_display_list(int32_t _ctx, int32_t list);
 int32_t fz_keep_display_list(int32_t _ctx, int32_t list);
+int32_t fz_new_buffer_from_display_list(int32_t _ctx, int32_t list, int32_t flags);
 int32_t fz_new_display_list(int32_t _ctx, float x0, float y0, float x1, float y1);
+int32_t fz_new_display_list_from_buffer(int32_t ctx, int32_t buf, fz_display_list_fetch_fn fetch, void * opaque);
+int32_t fz_new_display_list_from_page(int32_t ctx, int32_t page);
+int32_t fz_new_display_list_from_page_contents(int32_t ctx, int32_t page);
+int32_t fz_optimize_display_list(int32_t _ctx, int32_t list);
+int32_t fz_purge_display_list_cache(int32_t _ctx, int32_t doc);
 void fz_run_display_list(int32_t _ctx, int32_t list, int32_t dev, fz_matrix ctm, fz_rect scissor);
+void fz_run_display_list_with_layers(int32_t _ctx, int32_t list, int32_t dev, fz_matrix ctm, fz_rect scissor, int32_t doc);
 
 #ifdef __cplusplus
 }
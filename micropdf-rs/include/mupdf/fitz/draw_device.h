@@ -14,9 +14,10 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Draw_device Functions (40 total)
+// Draw_device Functions (51 total)
 // ============================================================================
 
+int32_t fz_draw_device_begin_form(int32_t _ctx, int32_t device, int32_t doc, int32_t xobject, fz_rect bbox);
 void fz_draw_device_begin_mask(int32_t _ctx, int32_t device, float const * _mask_area, int32_t _luminosity);
 void fz_draw_device_begin_path(int32_t _ctx, int32_t device);
 void fz_draw_device_begin_pattern(int32_t _ctx, int32_t device, int32_t _pattern_handle, float const * _area);
@@ -27,15 +28,20 @@ void fz_draw_device_close_path(int32_t _ctx, int32_t device);
 void fz_draw_device_concat_ctm(int32_t _ctx, int32_t device, float const * matrix);
 void fz_draw_device_curve_to(int32_t _ctx, int32_t device, float x1, float y1, float x2, float y2, float x3, float y3);
 int32_t fz_draw_device_draw_glyph(int32_t _ctx, int32_t device, int32_t _font, uint32_t _glyph_id, float _x, float _y, float _size);
+void fz_draw_device_enable_form_cache(int32_t _ctx, int32_t device, int32_t enable);
 void fz_draw_device_enable_overprint(int32_t _ctx, int32_t device, int32_t enable);
 void fz_draw_device_enable_subpixel_text(int32_t _ctx, int32_t device, int32_t enable);
+void fz_draw_device_end_form(int32_t _ctx, int32_t device);
 void fz_draw_device_end_mask(int32_t _ctx, int32_t device);
 void fz_draw_device_end_pattern(int32_t _ctx, int32_t device);
 void fz_draw_device_end_text(int32_t _ctx, int32_t device);
 int32_t fz_draw_device_fill(int32_t _ctx, int32_t device, int32_t rule);
+int32_t fz_draw_device_fill_shade(int32_t _ctx, int32_t device, int32_t shade);
 void fz_draw_device_line_to(int32_t _ctx, int32_t device, float x, float y);
 void fz_draw_device_move_to(int32_t _ctx, int32_t device, float x, float y);
+int32_t fz_draw_device_paint_pixmap(int32_t _ctx, int32_t device, int32_t src, int32_t mask);
 void fz_draw_device_pop_clip(int32_t _ctx, int32_t device);
+int32_t fz_draw_device_rasterizer(int32_t _ctx, int32_t device);
 void fz_draw_device_restore(int32_t _ctx, int32_t device);
 void fz_draw_device_save(int32_t _ctx, int32_t device);
 void fz_draw_device_set_aa_level(int32_t _ctx, int32_t device, int32_t level);
@@ -44,12 +50,16 @@ void fz_draw_device_set_blend_mode(int32_t _ctx, int32_t device, int32_t mode);
 void fz_draw_device_set_ctm(int32_t _ctx, int32_t device, float const * matrix);
 void fz_draw_device_set_dash(int32_t _ctx, int32_t device, float const * dash_array, int32_t dash_count, float dash_phase);
 void fz_draw_device_set_fill_color(int32_t _ctx, int32_t device, float r, float g, float b, float a);
+void fz_draw_device_set_fill_tints(int32_t _ctx, int32_t device, float const * tints, int32_t count);
 void fz_draw_device_set_line_cap(int32_t _ctx, int32_t device, int32_t cap);
 void fz_draw_device_set_line_join(int32_t _ctx, int32_t device, int32_t join);
 void fz_draw_device_set_line_width(int32_t _ctx, int32_t device, float width);
 void fz_draw_device_set_miter_limit(int32_t _ctx, int32_t device, float limit);
 void fz_draw_device_set_overprint(int32_t _ctx, int32_t device, int32_t mode);
+int32_t fz_draw_device_set_plates(int32_t _ctx, int32_t device, int32_t seps, int32_t const * plates, int32_t count);
+void fz_draw_device_set_rasterizer(int32_t _ctx, int32_t device, int32_t rasterizer);
 void fz_draw_device_set_stroke_color(int32_t _ctx, int32_t device, float r, float g, float b, float a);
+void fz_draw_device_set_stroke_tints(int32_t _ctx, int32_t device, float const * tints, int32_t count);
 int32_t fz_draw_device_stroke(int32_t _ctx, int32_t device);
 int32_t fz_draw_device_target(int32_t _ctx, int32_t device);
 void fz_drop_draw_device(int32_t _ctx, int32_t device);
@@ -57,6 +67,7 @@ int32_t fz_keep_draw_device(int32_t _ctx, int32_t device);
 int32_t fz_new_draw_device_with_matrix(int32_t _ctx, int32_t target_pixmap, float const * matrix);
 int32_t fz_new_draw_device_with_options(int32_t _ctx, int32_t target_pixmap, int32_t aa_level, int32_t subpixel_text);
 int32_t fz_new_draw_device_with_size(int32_t _ctx, int32_t target_pixmap, int32_t width, int32_t height);
+int32_t fz_purge_form_raster_cache(int32_t _ctx, int32_t doc);
 
 #ifdef __cplusplus
 }
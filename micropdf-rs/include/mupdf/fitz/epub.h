@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Epub Functions (35 total)
+// Epub Functions (40 total)
 // ============================================================================
 
 int32_t epub_add_creator(int32_t _ctx, int32_t doc, const char * creator);
@@ -22,6 +22,9 @@ int32_t epub_add_file(int32_t _ctx, int32_t doc, const char * path, u8 const * d
 int32_t epub_add_manifest_item(int32_t _ctx, int32_t doc, const char * id, const char * href, const char * media_type);
 int32_t epub_add_spine_item(int32_t _ctx, int32_t doc, const char * idref, int32_t linear);
 int32_t epub_add_toc_entry(int32_t _ctx, int32_t doc, const char * id, const char * label, const char * content);
+int32_t epub_count_chapter_pages(int32_t _ctx, int32_t doc, int32_t chapter);
+int32_t epub_count_chapters(int32_t _ctx, int32_t doc);
+int32_t epub_count_pages(int32_t _ctx, int32_t doc);
 void epub_drop_document(int32_t _ctx, int32_t doc);
 void epub_free_string(char * s);
 char * epub_get_creator(int32_t _ctx, int32_t doc, int32_t index);
@@ -38,12 +41,14 @@ char * epub_get_toc_content(int32_t _ctx, int32_t doc, int32_t index);
 char * epub_get_toc_label(int32_t _ctx, int32_t doc, int32_t index);
 int32_t epub_get_version(int32_t _ctx, int32_t doc);
 int32_t epub_has_file(int32_t _ctx, int32_t doc, const char * path);
+int32_t epub_layout(int32_t _ctx, int32_t doc, float w, float h, float em);
 int32_t epub_manifest_count(int32_t _ctx, int32_t doc);
 char * epub_media_type_string(int32_t _ctx, int32_t media_type);
 int32_t epub_new_document(int32_t ctx);
 int32_t epub_open_document(int32_t ctx, const char * filename);
 int32_t epub_open_document_with_archive(int32_t ctx, int32_t _archive);
 int32_t epub_open_document_with_stream(int32_t ctx, int32_t _stream);
+int32_t epub_page_number_from_location(int32_t _ctx, int32_t doc, int32_t chapter, int32_t page);
 int32_t epub_set_direction(int32_t _ctx, int32_t doc, int32_t direction);
 int32_t epub_set_identifier(int32_t _ctx, int32_t doc, const char * id);
 int32_t epub_set_language(int32_t _ctx, int32_t doc, const char * lang);
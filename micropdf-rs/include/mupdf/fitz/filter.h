@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Filter Functions (30 total)
+// Filter Functions (31 total)
 // ============================================================================
 
 void fz_concat_push_drop(int32_t _ctx, int32_t concat, int32_t chain);
@@ -31,6 +31,7 @@ int32_t fz_open_aesd(int32_t _ctx, int32_t chain, u8 const * key, uint32_t keyle
 int32_t fz_open_ahxd(int32_t _ctx, int32_t chain);
 int32_t fz_open_arc4(int32_t _ctx, int32_t chain, u8 const * key, uint32_t keylen);
 int32_t fz_open_brotlid(int32_t _ctx, int32_t chain);
+int32_t fz_open_brotlid_dictionary(int32_t _ctx, int32_t chain, uint64_t dictionary);
 int32_t fz_open_concat(int32_t _ctx, int32_t max, int32_t pad);
 int32_t fz_open_dctd(int32_t _ctx, int32_t chain, int32_t color_transform, int32_t invert_cmyk, int32_t l2factor, int32_t _jpegtables);
 int32_t fz_open_endstream_filter(int32_t _ctx, int32_t chain, uint64_t len, int64_t offset);
@@ -14,10 +14,13 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Glyph_cache Functions (24 total)
+// Glyph_cache Functions (29 total)
 // ============================================================================
 
 void fz_dump_glyph_cache_stats(int32_t _ctx, int32_t _out);
+int fz_glyph_cache_atlas(int32_t _ctx);
+size_t fz_glyph_cache_atlas_count(int32_t _ctx);
+size_t fz_glyph_cache_atlas_slabs(int32_t _ctx);
 size_t fz_glyph_cache_count(int32_t _ctx);
 uint64_t fz_glyph_cache_evictions(int32_t _ctx);
 float fz_glyph_cache_hit_rate(int32_t _ctx);
@@ -36,8 +39,10 @@ int32_t fz_render_glyph_pixmap(int32_t _ctx, int32_t font, int32_t gid, Matrix c
 void fz_render_t3_glyph_direct(int32_t _ctx, int32_t _dev, int32_t _font, int32_t _gid, Matrix _trm, c_void * _gstate, int32_t _def_cs, c_void * _fill_gstate, c_void * _stroke_gstate);
 void fz_rendered_glyph_cache_insert(int32_t _ctx, int32_t font, int32_t gid, Matrix const * ctm, u8 subpix_x, u8 subpix_y, int32_t aa, int32_t pixmap, size_t size);
 int32_t fz_rendered_glyph_cache_lookup(int32_t _ctx, int32_t font, int32_t gid, Matrix const * ctm, u8 subpix_x, u8 subpix_y, int32_t aa);
+int fz_rendered_glyph_cache_lookup_atlas(int32_t _ctx, int32_t font, int32_t gid, Matrix const * ctm, u8 subpix_x, u8 subpix_y, int32_t aa, u8 const * * samples, int * w, int * h, int * n, int * stride);
 size_t fz_rendered_glyph_cache_purge_font(int32_t _ctx, int32_t font);
 int32_t fz_rendered_glyph_cache_remove(int32_t _ctx, int32_t font, int32_t gid, Matrix const * ctm, u8 subpix_x, u8 subpix_y, int32_t aa);
+void fz_set_glyph_cache_atlas(int32_t _ctx, int enabled);
 void fz_set_glyph_cache_max_count(int32_t _ctx, size_t max);
 void fz_set_glyph_cache_max_size(int32_t _ctx, size_t max);
 void fz_set_glyph_cache_policy(int32_t _ctx, int32_t policy);
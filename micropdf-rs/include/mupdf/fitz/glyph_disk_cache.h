@@ -0,0 +1,35 @@
+// MicroPDF - MuPDF API Compatible C Header
+// Auto-generated from Rust FFI - DO NOT EDIT MANUALLY
+// Module: glyph_disk_cache
+
+#ifndef MUPDF_FITZ_GLYPH_DISK_CACHE_H
+#define MUPDF_FITZ_GLYPH_DISK_CACHE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// Glyph_disk_cache Functions (10 total)
+// ============================================================================
+
+void fz_drop_glyph_cache_file(int32_t _ctx, int32_t file);
+int fz_flush_glyph_cache_file(int32_t _ctx, int32_t file);
+size_t fz_glyph_cache_file_count(int32_t _ctx, int32_t file);
+int32_t fz_glyph_cache_file_get_glyph(int32_t _ctx, int32_t file, int32_t font, int32_t gid, Matrix const * ctm, u8 subpix_x, u8 subpix_y, int32_t aa);
+int32_t fz_glyph_cache_file_get_outline(int32_t _ctx, int32_t file, int32_t font, int32_t gid);
+int fz_glyph_cache_file_put_glyph(int32_t _ctx, int32_t file, int32_t font, int32_t gid, Matrix const * ctm, u8 subpix_x, u8 subpix_y, int32_t aa, int32_t pixmap);
+int fz_glyph_cache_file_put_outline(int32_t _ctx, int32_t file, int32_t font, int32_t gid, u8 const * data, size_t len);
+void fz_glyph_cache_file_stats(int32_t _ctx, int32_t file, uint64_t * hits, uint64_t * misses);
+int32_t fz_open_glyph_cache_file(int32_t _ctx, const char * path);
+void fz_set_glyph_cache_file(int32_t _ctx, int32_t file);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MUPDF_FITZ_GLYPH_DISK_CACHE_H */
@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Gpu Functions (19 total)
+// Gpu Functions (20 total)
 // ============================================================================
 
 int32_t fz_gpu_backend_available(int32_t backend);
@@ -32,6 +32,7 @@ void fz_gpu_drop_texture(int32_t texture);
 int32_t fz_gpu_finish(int32_t device);
 int32_t fz_gpu_flush(int32_t device);
 int32_t fz_gpu_render_page(int32_t device, int32_t page, int32_t texture, float const * ctm);
+int32_t fz_gpu_run_display_list(int32_t device, int32_t list, int32_t texture, float const * ctm);
 int32_t fz_gpu_texture_download(int32_t device, int32_t texture, u8 * data, int32_t stride);
 int32_t fz_gpu_texture_height(int32_t texture);
 int32_t fz_gpu_texture_upload(int32_t device, int32_t texture, u8 const * data, int32_t stride);
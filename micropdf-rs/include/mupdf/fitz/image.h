@@ -14,14 +14,14 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Image Functions (23 total)
+// Image Functions (25 total)
 // ============================================================================
 
 int32_t fz_clone_image(int32_t _ctx, int32_t image);
-int32_t fz_decode_image(int32_t _ctx, int32_t image, int32_t _l2factor, fz_irect const * _subarea);
-int32_t fz_decode_image_scaled(int32_t _ctx, int32_t image, int32_t w, int32_t h, int32_t _l2factor, fz_irect const * _subarea);
+int32_t fz_decode_image(int32_t _ctx, int32_t image, int32_t l2factor, fz_irect const * subarea);
+int32_t fz_decode_image_scaled(int32_t _ctx, int32_t image, int32_t w, int32_t h, int32_t l2factor, fz_irect const * subarea);
 void fz_drop_image(int32_t _ctx, int32_t image);
-int32_t fz_get_pixmap_from_image(int32_t _ctx, int32_t image, fz_irect const * _subarea, fz_matrix * _ctm, int32_t * w, int32_t * h);
+int32_t fz_get_pixmap_from_image(int32_t _ctx, int32_t image, fz_irect const * subarea, fz_matrix * ctm, int32_t * w, int32_t * h);
 int32_t fz_image_bpp(int32_t _ctx, int32_t _image);
 int32_t fz_image_colorspace(int32_t _ctx, int32_t image);
 int32_t fz_image_h(int32_t _ctx, int32_t image);
@@ -30,6 +30,7 @@ int32_t fz_image_height(int32_t _ctx, int32_t image);
 int32_t fz_image_is_mask(int32_t _ctx, int32_t image);
 int32_t fz_image_is_valid(int32_t _ctx, int32_t image);
 int32_t fz_image_orientation(int32_t _ctx, int32_t _image);
+int32_t fz_image_subarea(int32_t _ctx, int32_t image, fz_matrix ctm, fz_irect bbox, fz_irect * subarea);
 int32_t fz_image_w(int32_t _ctx, int32_t image);
 int32_t fz_image_width(int32_t _ctx, int32_t image);
 int32_t fz_image_xres(int32_t _ctx, int32_t image);
@@ -40,6 +41,7 @@ int32_t fz_new_image_from_buffer_data(int32_t _ctx, u8 const * data, size_t len)
 int32_t fz_new_image_from_data(int32_t _ctx, int32_t w, int32_t h, int32_t _bpc, int32_t _colorspace, int32_t _xres, int32_t _yres, int32_t _interpolate, int32_t _imagemask, float const * _decode, u8 const * _mask, u8 const * data, int32_t len);
 int32_t fz_new_image_from_file(int32_t _ctx, const char * filename);
 int32_t fz_new_image_from_pixmap(int32_t _ctx, int32_t pixmap, int32_t _mask);
+int32_t fz_purge_decoded_image_cache(int32_t _ctx, int32_t image);
 
 #ifdef __cplusplus
 }
@@ -14,10 +14,12 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Json Functions (29 total)
+// Json Functions (42 total)
 // ============================================================================
 
+int32_t fz_close_json_writer(int32_t _ctx, int32_t writer);
 void fz_drop_json(int32_t _ctx, int32_t json);
+void fz_drop_json_writer(int32_t _ctx, int32_t writer);
 int32_t fz_json_array_get(int32_t _ctx, int32_t json, int32_t index);
 int32_t fz_json_array_length(int32_t _ctx, int32_t json);
 int32_t fz_json_array_push(int32_t _ctx, int32_t _pool, int32_t array, int32_t item);
@@ -43,7 +45,18 @@ double fz_json_to_number(int32_t _ctx, int32_t json);
 size_t fz_json_to_string(int32_t _ctx, int32_t json, char * output, size_t output_size);
 int32_t fz_json_type(int32_t _ctx, int32_t json);
 size_t fz_json_unescape_string(const char * input, char * output, size_t output_size);
+int32_t fz_json_writer_begin_array(int32_t _ctx, int32_t writer);
+int32_t fz_json_writer_begin_object(int32_t _ctx, int32_t writer);
+int32_t fz_json_writer_boolean(int32_t _ctx, int32_t writer, int32_t value);
+int32_t fz_json_writer_end_array(int32_t _ctx, int32_t writer);
+int32_t fz_json_writer_end_object(int32_t _ctx, int32_t writer);
+int32_t fz_json_writer_key(int32_t _ctx, int32_t writer, const char * key);
+int32_t fz_json_writer_null(int32_t _ctx, int32_t writer);
+int32_t fz_json_writer_number(int32_t _ctx, int32_t writer, double value);
+int32_t fz_json_writer_string(int32_t _ctx, int32_t writer, const char * value);
+int32_t fz_new_json_writer(int32_t _ctx, int32_t out);
 int32_t fz_parse_json(int32_t _ctx, int32_t _pool, const char * input);
+int32_t fz_parse_json_events(int32_t _ctx, const char * input, size_t len, FzJsonEventCallback callback, void * opaque);
 size_t fz_write_json(int32_t _ctx, int32_t json, char * output, size_t output_size);
 size_t fz_write_json_pretty(int32_t _ctx, int32_t json, size_t indent, char * output, size_t output_size);
 
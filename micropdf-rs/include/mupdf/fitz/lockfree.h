@@ -14,14 +14,25 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Lockfree Functions (5 total)
+// Lockfree Functions (16 total)
 // ============================================================================
 
+void fz_close_lockfree_queue(int32_t _ctx, int32_t queue);
+void fz_drop_lockfree_queue(int32_t _ctx, int32_t queue);
 size_t fz_lockfree_queue_capacity(void);
+size_t fz_lockfree_queue_count(int32_t _ctx, int32_t queue);
 int fz_lockfree_queue_is_empty(void);
 size_t fz_lockfree_queue_len(void);
 uint64_t fz_lockfree_queue_pop(void);
+size_t fz_lockfree_queue_pop_batch(int32_t _ctx, int32_t queue, uint64_t * out, size_t max);
 int fz_lockfree_queue_push(uint64_t task_id);
+size_t fz_lockfree_queue_push_batch(int32_t _ctx, int32_t queue, uint64_t const * values, size_t count);
+size_t fz_lockfree_queue_size(int32_t _ctx, int32_t queue);
+int fz_lockfree_queue_try_pop(int32_t _ctx, int32_t queue, uint64_t * out);
+int fz_lockfree_queue_try_push(int32_t _ctx, int32_t queue, uint64_t value);
+int fz_lockfree_queue_wait_pop(int32_t _ctx, int32_t queue, uint64_t * out, int timeout_ms);
+int fz_lockfree_queue_wait_push(int32_t _ctx, int32_t queue, uint64_t value, int timeout_ms);
+int32_t fz_new_lockfree_queue(int32_t _ctx, size_t capacity);
 
 #ifdef __cplusplus
 }
@@ -14,12 +14,25 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Memory_profiler Functions (10 total)
+// Allocation Subsystems
+// ============================================================================
+
+/* Subsystems for fz_profiler_sampled_bytes */
+#define FZ_ALLOC_STORE 0
+#define FZ_ALLOC_GLYPH_CACHE 1
+#define FZ_ALLOC_XREF 2
+#define FZ_ALLOC_PIXMAP 3
+#define FZ_ALLOC_FONT 4
+#define FZ_ALLOC_DECODE 5
+
+// ============================================================================
+// Memory_profiler Functions (15 total)
 // ============================================================================
 
 void fz_enable_memory_profiling(int32_t enabled);
 void fz_enable_stack_traces(int32_t enabled);
 uint64_t fz_profiler_current_bytes(void);
+int32_t fz_profiler_export_folded(void);
 uint64_t fz_profiler_handle_count_by_type(ResourceType resource_type);
 uint64_t fz_profiler_live_handle_count(void);
 uint64_t fz_profiler_peak_bytes(void);
@@ -27,6 +40,10 @@ uint64_t fz_profiler_peak_handles(void);
 uint64_t fz_profiler_potential_leak_count(uint64_t min_age_seconds);
 void fz_profiler_print_leak_report(uint64_t min_age_seconds);
 void fz_profiler_reset(void);
+uint64_t fz_profiler_sample_count(void);
+uint64_t fz_profiler_sample_interval(void);
+uint64_t fz_profiler_sampled_bytes(int32_t subsystem);
+void fz_profiler_set_sample_interval(uint64_t bytes);
 
 #ifdef __cplusplus
 }
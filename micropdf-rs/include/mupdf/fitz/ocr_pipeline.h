@@ -0,0 +1,26 @@
+// MicroPDF - MuPDF API Compatible C Header
+// Auto-generated from Rust FFI - DO NOT EDIT MANUALLY
+// Module: ocr_pipeline
+
+#ifndef MUPDF_FITZ_OCR_PIPELINE_H
+#define MUPDF_FITZ_OCR_PIPELINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// Ocr_pipeline Functions (1 total)
+// ============================================================================
+
+int32_t fz_ocr_document(int32_t ctx, int32_t doc, int32_t writer, const OcrPipelineOptions * options, int32_t threads, int32_t max_in_flight);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MUPDF_FITZ_OCR_PIPELINE_H */
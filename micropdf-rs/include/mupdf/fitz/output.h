@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Output Functions (34 total)
+// Output Functions (37 total)
 // ============================================================================
 
 void fz_close_output(int32_t _ctx, int32_t out);
@@ -37,12 +37,15 @@ void fz_write_char(int32_t _ctx, int32_t out, char c);
 void fz_write_data(int32_t _ctx, int32_t out, void const * data, size_t size);
 void fz_write_float_be(int32_t _ctx, int32_t out, float x);
 void fz_write_float_le(int32_t _ctx, int32_t out, float x);
+void fz_write_int(int32_t _ctx, int32_t out, int64_t x);
 void fz_write_int16_be(int32_t _ctx, int32_t out, i16 x);
 void fz_write_int16_le(int32_t _ctx, int32_t out, i16 x);
 void fz_write_int32_be(int32_t _ctx, int32_t out, int32_t x);
 void fz_write_int32_le(int32_t _ctx, int32_t out, int32_t x);
 void fz_write_int64_be(int32_t _ctx, int32_t out, int64_t x);
 void fz_write_int64_le(int32_t _ctx, int32_t out, int64_t x);
+void fz_write_real(int32_t _ctx, int32_t out, float x);
+void fz_write_reals(int32_t _ctx, int32_t out, float const * values, size_t count);
 void fz_write_rune(int32_t _ctx, int32_t out, int32_t rune);
 void fz_write_string(int32_t _ctx, int32_t out, const char * s);
 void fz_write_uint16_be(int32_t _ctx, int32_t out, u16 x);
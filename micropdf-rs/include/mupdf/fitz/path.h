@@ -14,7 +14,19 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Path Functions (35 total)
+// Command Buffers
+// ============================================================================
+
+/* fz_path_append_commands ops, and how many coords each consumes */
+#define FZ_PATH_MOVETO      0 /* x y */
+#define FZ_PATH_LINETO      1 /* x y */
+#define FZ_PATH_CURVETO     2 /* x1 y1 x2 y2 x3 y3 */
+#define FZ_PATH_CLOSEPATH   3
+#define FZ_PATH_RECTTO      4 /* as fz_rectto */
+#define FZ_PATH_QUADTO      5 /* x1 y1 x2 y2 */
+
+// ============================================================================
+// Path Functions (36 total)
 // ============================================================================
 
 fz_rect fz_bound_path(int32_t _ctx, int32_t path, int32_t _stroke, fz_matrix _transform);
@@ -32,6 +44,7 @@ void fz_moveto(int32_t _ctx, int32_t path, float x, float y);
 int32_t fz_new_path(int32_t _ctx);
 int32_t fz_new_stroke_state(int32_t _ctx);
 int32_t fz_new_stroke_state_with_len(int32_t _ctx, int32_t _len, float linewidth);
+int32_t fz_path_append_commands(int32_t _ctx, int32_t path, uint8_t const * ops, float const * coords, int32_t n);
 int32_t fz_path_is_valid(int32_t _ctx, int32_t path);
 void fz_quadto(int32_t _ctx, int32_t path, float x1, float y1, float x2, float y2);
 void fz_rectto(int32_t _ctx, int32_t path, float x0, float y0, float x1, float y1);
@@ -14,7 +14,14 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Pdf_conformance Functions (24 total)
+// Issue Streaming
+// ============================================================================
+
+/* Receives each issue as found; return nonzero to stop validating */
+typedef int (*fz_conformance_issue_fn)(void * opaque, int severity, const char * code, const char * message, int page, int object);
+
+// ============================================================================
+// Pdf_conformance Functions (28 total)
 // ============================================================================
 
 int fz_conformance_error_count(int32_t _ctx, int32_t validator);
@@ -27,6 +34,10 @@ int fz_conformance_pdfa_valid(int32_t _ctx, int32_t validator);
 int fz_conformance_pdfx_claimed(int32_t _ctx, int32_t validator);
 int fz_conformance_pdfx_valid(int32_t _ctx, int32_t validator);
 void fz_conformance_validator_reset(int32_t _ctx, int32_t validator);
+void fz_conformance_validator_set_document(int32_t _ctx, int32_t validator, int32_t doc);
+void fz_conformance_validator_set_first_violation(int32_t _ctx, int32_t validator, int on);
+void fz_conformance_validator_set_issue_callback(int32_t _ctx, int32_t validator, fz_conformance_issue_fn callback, void * opaque);
+void fz_conformance_validator_set_threads(int32_t _ctx, int32_t validator, int threads);
 int fz_conformance_warning_count(int32_t _ctx, int32_t validator);
 void fz_drop_conformance_validator(int32_t _ctx, int32_t validator);
 void fz_drop_validation_result(int32_t _ctx, int32_t result);
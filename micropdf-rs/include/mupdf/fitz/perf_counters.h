@@ -0,0 +1,58 @@
+// MicroPDF - MuPDF API Compatible C Header
+// Auto-generated from Rust FFI - DO NOT EDIT MANUALLY
+// Module: perf_counters
+
+#ifndef MUPDF_FITZ_PERF_COUNTERS_H
+#define MUPDF_FITZ_PERF_COUNTERS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// Types
+// ============================================================================
+
+/* Snapshot of the performance counters; every value only grows */
+typedef struct {
+    uint64_t bytes_inflated;        /* Bytes produced by FlateDecode */
+    uint64_t images_decoded;        /* Decoded-image cache misses */
+    uint64_t image_pixels_decoded;
+    uint64_t image_decode_ns;
+    uint64_t glyphs_rasterized;     /* Glyph cache misses rendered */
+    uint64_t paths_filled;
+    uint64_t paths_stroked;
+    uint64_t operators_interpreted;
+    uint64_t store_hits;            /* As fz_store_hits */
+    uint64_t store_misses;
+    uint64_t glyph_cache_hits;      /* As fz_glyph_cache_hits */
+    uint64_t glyph_cache_misses;
+    uint64_t document_lookups;      /* Handle lookups by object type */
+    uint64_t page_lookups;
+    uint64_t pixmap_lookups;
+    uint64_t image_lookups;
+    uint64_t font_lookups;
+    uint64_t buffer_lookups;
+    uint64_t stext_page_lookups;
+} fz_perf_counters;
+
+#define FZ_PERF_COUNTER_COUNT 19
+
+// ============================================================================
+// Perf_counters Functions (4 total)
+// ============================================================================
+
+int32_t fz_get_perf_counters(int32_t ctx, fz_perf_counters * out);
+uint64_t fz_perf_counter(int32_t ctx, int32_t index);
+int32_t fz_perf_counter_count(void);
+const char * fz_perf_counter_name(int32_t index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MUPDF_FITZ_PERF_COUNTERS_H */
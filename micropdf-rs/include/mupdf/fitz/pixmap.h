@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Pixmap Functions (32 total)
+// Pixmap Functions (36 total)
 // ============================================================================
 
 void fz_clear_pixmap(int32_t _ctx, int32_t pix);
@@ -28,6 +28,8 @@ void fz_invert_pixmap(int32_t _ctx, int32_t pix);
 int32_t fz_keep_pixmap(int32_t _ctx, int32_t pix);
 int32_t fz_new_pixmap(int32_t _ctx, int32_t cs, int32_t w, int32_t h, int32_t _seps, int32_t // Separations not implemented yet alpha);
 int32_t fz_new_pixmap_with_bbox(int32_t _ctx, int32_t cs, fz_irect bbox, int32_t _seps, int32_t alpha);
+int32_t fz_new_pixmap_with_bbox_and_data(int32_t ctx, int32_t cs, fz_irect bbox, int32_t seps, int32_t alpha, u8 * samples);
+int32_t fz_new_pixmap_with_data(int32_t _ctx, int32_t cs, int32_t w, int32_t h, int32_t _seps, int32_t alpha, int32_t stride, u8 * samples);
 int32_t fz_pixmap_alpha(int32_t _ctx, int32_t pix);
 fz_irect fz_pixmap_bbox(int32_t _ctx, int32_t pix);
 int32_t fz_pixmap_colorants(int32_t _ctx, int32_t pix);
@@ -36,7 +38,8 @@ int32_t fz_pixmap_components(int32_t _ctx, int32_t pix);
 int32_t fz_pixmap_height(int32_t _ctx, int32_t pix);
 int32_t fz_pixmap_is_valid(int32_t _ctx, int32_t pix);
 void fz_pixmap_resolution(int32_t _ctx, int32_t _pix, int32_t * xres, int32_t * yres);
-u8 * fz_pixmap_samples(int32_t _ctx, int32_t _pix);
+u8 * fz_pixmap_samples(int32_t _ctx, int32_t pix);
+size_t fz_pixmap_size(int32_t _ctx, int32_t pix);
 int32_t fz_pixmap_stride(int32_t _ctx, int32_t pix);
 int32_t fz_pixmap_width(int32_t _ctx, int32_t pix);
 int32_t fz_pixmap_x(int32_t _ctx, int32_t pix);
@@ -44,6 +47,7 @@ int32_t fz_pixmap_xres(int32_t _ctx, int32_t _pix);
 int32_t fz_pixmap_y(int32_t _ctx, int32_t pix);
 int32_t fz_pixmap_yres(int32_t _ctx, int32_t _pix);
 int32_t fz_scale_pixmap(int32_t _ctx, int32_t pix, float xscale, float yscale);
+int32_t fz_scale_pixmap_filtered(int32_t _ctx, int32_t pix, int32_t w, int32_t h, int32_t filter);
 void fz_set_pixmap_resolution(int32_t _ctx, int32_t _pix, int32_t _xres, int32_t _yres);
 void fz_set_pixmap_sample(int32_t _ctx, int32_t pix, int32_t x, int32_t y, int32_t n, u8 v);
 void fz_set_pixmap_xres(int32_t _ctx, int32_t _pix, int32_t _xres);
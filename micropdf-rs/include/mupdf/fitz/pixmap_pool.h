@@ -0,0 +1,34 @@
+// MicroPDF - MuPDF API Compatible C Header
+// Auto-generated from Rust FFI - DO NOT EDIT MANUALLY
+// Module: pixmap_pool
+
+#ifndef MUPDF_FITZ_PIXMAP_POOL_H
+#define MUPDF_FITZ_PIXMAP_POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// Pixmap_pool Functions (9 total)
+// ============================================================================
+
+size_t fz_pixmap_pool_bytes(int32_t _ctx);
+void fz_pixmap_pool_clear(int32_t _ctx);
+size_t fz_pixmap_pool_count(int32_t _ctx);
+uint64_t fz_pixmap_pool_hits(int32_t _ctx);
+size_t fz_pixmap_pool_limit(int32_t _ctx);
+uint64_t fz_pixmap_pool_misses(int32_t _ctx);
+void fz_set_pixmap_pool_huge_pages(int32_t _ctx, int32_t enabled);
+void fz_set_pixmap_pool_limit(int32_t _ctx, size_t bytes);
+void fz_set_pixmap_pool_numa(int32_t _ctx, int32_t enabled);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MUPDF_FITZ_PIXMAP_POOL_H */
@@ -14,10 +14,12 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Pool Functions (19 total)
+// Pool Functions (24 total)
 // ============================================================================
 
+void fz_begin_render_arena(int32_t _ctx);
 void fz_drop_pool(int32_t _ctx, int32_t pool);
+void fz_end_render_arena(int32_t _ctx);
 int32_t fz_keep_pool(int32_t _ctx, int32_t pool);
 int32_t fz_new_pool(int32_t _ctx);
 int32_t fz_new_pool_named(int32_t _ctx, const char * name);
@@ -36,6 +38,9 @@ void fz_pool_set_block_size(int32_t _ctx, int32_t pool, size_t size);
 void fz_pool_shrink(int32_t _ctx, int32_t pool);
 c_char * fz_pool_strdup(int32_t _ctx, int32_t pool, const char * s);
 size_t fz_pool_used(int32_t _ctx, int32_t pool);
+int32_t fz_render_arena(int32_t _ctx);
+int32_t fz_render_arena_enabled(int32_t _ctx);
+void fz_set_render_arena_enabled(int32_t _ctx, int32_t enabled);
 
 #ifdef __cplusplus
 }
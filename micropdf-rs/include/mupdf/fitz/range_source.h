@@ -0,0 +1,36 @@
+// MicroPDF - MuPDF API Compatible C Header
+// Auto-generated from Rust FFI - DO NOT EDIT MANUALLY
+// Module: range_source
+
+#ifndef MUPDF_FITZ_RANGE_SOURCE_H
+#define MUPDF_FITZ_RANGE_SOURCE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// Range_source Functions (11 total)
+// ============================================================================
+
+void fz_drop_range_source(int32_t _ctx, int32_t source);
+int32_t fz_new_range_source(int32_t _ctx, uint64_t file_len, size_t block_size, Option<RangeFetchFn> fetch, void * user);
+int32_t fz_open_range_document(int32_t _ctx, int32_t source);
+int32_t fz_open_range_stream(int32_t _ctx, int32_t source);
+void fz_range_source_fail(int32_t _ctx, int32_t source, uint64_t offset);
+int32_t fz_range_source_is_complete(int32_t _ctx, int32_t source);
+int32_t fz_range_source_is_linearized(int32_t _ctx, int32_t source);
+uint64_t fz_range_source_loaded(int32_t _ctx, int32_t source);
+int32_t fz_range_source_page_ready(int32_t _ctx, int32_t source, int32_t page);
+int32_t fz_range_source_request_page(int32_t _ctx, int32_t source, int32_t page);
+int32_t fz_range_source_supply(int32_t _ctx, int32_t source, uint64_t offset, u8 const * data, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MUPDF_FITZ_RANGE_SOURCE_H */
@@ -0,0 +1,35 @@
+// MicroPDF - MuPDF API Compatible C Header
+// Auto-generated from Rust FFI - DO NOT EDIT MANUALLY
+// Module: render_pool
+
+#ifndef MUPDF_FITZ_RENDER_POOL_H
+#define MUPDF_FITZ_RENDER_POOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// Render_pool Functions (10 total)
+// ============================================================================
+
+void fz_drop_render_pool(int32_t _ctx, int32_t pool);
+int32_t fz_new_render_pool(int32_t ctx, int32_t threads);
+int32_t fz_new_render_pool_with_options(int32_t ctx, int32_t threads, int32_t flags);
+int32_t fz_render_pool_cancel(int32_t _ctx, int32_t pool, uint64_t job);
+int32_t fz_render_pool_context(int32_t _ctx, int32_t pool, int32_t index);
+int32_t fz_render_pool_poll(int32_t _ctx, int32_t pool, uint64_t job);
+uint64_t fz_render_pool_submit(int32_t ctx, int32_t pool, int32_t doc, int32_t page_number, fz_matrix ctm, int32_t cs, int32_t alpha, int32_t aa_bits, int32_t flags);
+int32_t fz_render_pool_threads(int32_t _ctx, int32_t pool);
+int32_t fz_render_pool_wait(int32_t ctx, int32_t pool, uint64_t job);
+int32_t fz_render_pool_worker_node(int32_t _ctx, int32_t pool, int32_t index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MUPDF_FITZ_RENDER_POOL_H */
@@ -0,0 +1,34 @@
+// MicroPDF - MuPDF API Compatible C Header
+// Auto-generated from Rust FFI - DO NOT EDIT MANUALLY
+// Module: search_index
+
+#ifndef MUPDF_FITZ_SEARCH_INDEX_H
+#define MUPDF_FITZ_SEARCH_INDEX_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// Search_index Functions (9 total)
+// ============================================================================
+
+void fz_drop_search_index(int32_t _ctx, int32_t index);
+int32_t fz_load_search_index(int32_t _ctx, const char * path);
+int32_t fz_new_search_index(int32_t _ctx);
+int32_t fz_new_search_index_from_document(int32_t ctx, int32_t doc);
+int32_t fz_open_search_index(int32_t ctx, int32_t doc, const char * path);
+int32_t fz_save_search_index(int32_t _ctx, int32_t index, const char * path);
+int32_t fz_search_index_add_page(int32_t _ctx, int32_t index, int32_t page_number, int32_t stext);
+int32_t fz_search_index_page_count(int32_t _ctx, int32_t index);
+int32_t fz_search_index_search(int32_t _ctx, int32_t index, const char * needle, int32_t options, int32_t * hit_pages, FzQuad * hit_quads, int32_t hit_max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MUPDF_FITZ_SEARCH_INDEX_H */
@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Simd_util Functions (12 total)
+// Simd_util Functions (17 total)
 // ============================================================================
 
 int fz_has_simd(void);
@@ -25,10 +25,15 @@ int fz_simd_buffer_fill(u8 * dst, size_t len, u8 value);
 SimdFeatures fz_simd_features(void);
 int fz_simd_level(void);
 SimdMatrix fz_simd_matrix_concat(SimdMatrix left, SimdMatrix right);
+int fz_simd_points_in_rect(float const * points, size_t count, float x0, float y0, float x1, float y1, u8 * out);
+int fz_simd_quad_bounds(float const * quads, size_t count, float * out);
+int fz_simd_rect_union(float const * rects, size_t count, float * out);
 [c_float fz_simd_rgb_to_cmyk(float r, float g, float b);
 float fz_simd_rgb_to_gray(float r, float g, float b);
+int fz_simd_set_level(int level);
 [c_float fz_simd_transform_point(float x, float y, SimdMatrix m);
 int fz_simd_transform_points(float * points, size_t count, SimdMatrix m);
+int fz_simd_transform_rects(float * rects, size_t count, SimdMatrix m);
 
 #ifdef __cplusplus
 }
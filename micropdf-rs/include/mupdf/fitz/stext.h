@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Stext Functions (37 total)
+// Stext Functions (42 total)
 // ============================================================================
 
 int32_t fz_add_stext_block(int32_t _ctx, int32_t page, float x0, float y0, float x1, float y1);
@@ -27,16 +27,18 @@ void fz_drop_stext_page(int32_t _ctx, int32_t page);
 int32_t fz_highlight_selection(int32_t _ctx, int32_t page, float a_x, float a_y, float b_x, float b_y, FzQuad * quads, int32_t max_quads);
 int32_t fz_keep_stext_page(int32_t _ctx, int32_t page);
 int32_t fz_new_stext_page(int32_t _ctx, float x0, float y0, float x1, float y1);
+int32_t fz_new_stext_page_from_page(int32_t ctx, int32_t page, const StextOptions * _options);
 void fz_paragraph_break(int32_t _ctx, int32_t page);
 StextOptions * fz_parse_stext_options(int32_t _ctx, StextOptions * opts, const char * string);
 const char * fz_print_stext_page_as_html(int32_t _ctx, int32_t _output, int32_t page, int32_t _id);
-const char * fz_print_stext_page_as_json(int32_t _ctx, int32_t _output, int32_t page, float _scale);
+const char * fz_print_stext_page_as_json(int32_t _ctx, int32_t output, int32_t page, float _scale);
 const char * fz_print_stext_page_as_xml(int32_t _ctx, int32_t _output, int32_t page, int32_t _id);
 int32_t fz_search_stext_page(int32_t _ctx, int32_t page, const char * needle, int32_t * hit_mark, FzQuad * hit_bbox, int32_t hit_max);
 int32_t fz_segment_stext_page(int32_t _ctx, int32_t page);
 void fz_stext_block_bbox(int32_t _ctx, int32_t page, int32_t block_idx, float * x0, float * y0, float * x1, float * y1);
 int32_t fz_stext_block_count(int32_t _ctx, int32_t page);
 int32_t fz_stext_block_type(int32_t _ctx, int32_t page, int32_t block_idx);
+int32_t fz_stext_char_at_point(int32_t _ctx, int32_t page, float x, float y, int32_t * block, int32_t * line, int32_t * ch);
 int32_t fz_stext_char_count(int32_t _ctx, int32_t page, int32_t block_idx, int32_t line_idx);
 void fz_stext_char_origin(int32_t _ctx, int32_t page, int32_t block_idx, int32_t line_idx, int32_t char_idx, float * x, float * y);
 void fz_stext_char_quad(int32_t _ctx, int32_t page, int32_t block_idx, int32_t line_idx, int32_t char_idx, FzQuad * quad);
@@ -52,6 +54,9 @@ int32_t fz_stext_next_block(int32_t _ctx, int32_t page, int32_t block_idx);
 int32_t fz_stext_next_char(int32_t _ctx, int32_t page, int32_t block_idx, int32_t line_idx, int32_t char_idx);
 int32_t fz_stext_next_line(int32_t _ctx, int32_t page, int32_t block_idx, int32_t line_idx);
 const char * fz_stext_page_as_text(int32_t _ctx, int32_t page);
+int32_t fz_stext_page_fill_char_styles(int32_t _ctx, int32_t page, float * origins, float * sizes, uint64_t * fonts, int32_t max_chars);
+int32_t fz_stext_page_fill_flat(int32_t _ctx, int32_t page, float * quads, uint32_t * codepoints, int32_t max_chars, uint32_t * line_offsets, int32_t max_lines, uint32_t * block_offsets, int32_t max_blocks);
+int32_t fz_stext_page_flat_counts(int32_t _ctx, int32_t page, int32_t * blocks, int32_t * lines, int32_t * chars);
 void fz_stext_page_mediabox(int32_t _ctx, int32_t page, float * x0, float * y0, float * x1, float * y1);
 void fz_table_hunt(int32_t _ctx, int32_t page);
 
@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Store Functions (32 total)
+// Store Functions (42 total)
 // ============================================================================
 
 int32_t fz_new_store(int32_t _ctx, size_t max_size);
@@ -38,14 +38,24 @@ int32_t fz_store_item_type(int32_t _ctx, uint64_t id);
 uint64_t fz_store_keep(int32_t _ctx, uint64_t id);
 size_t fz_store_max_size(int32_t _ctx);
 uint64_t fz_store_misses(int32_t _ctx);
+void fz_store_notify_pressure(int32_t _ctx, int level);
+int fz_store_pressure(int32_t _ctx);
+uint64_t fz_store_pressure_evictions(int32_t _ctx);
+size_t fz_store_relieve_pressure(int32_t _ctx, int level);
 int32_t fz_store_remove(int32_t _ctx, uint64_t id);
 int32_t fz_store_remove_by_key(int32_t _ctx, u8 const * key, size_t key_len);
 void fz_store_reset_stats(int32_t _ctx);
 void fz_store_set_evictable(int32_t _ctx, uint64_t id, int32_t evictable);
+void fz_store_set_item_cost(int32_t _ctx, uint64_t id, double cost);
 void fz_store_set_max_size(int32_t _ctx, size_t max_size);
 void fz_store_set_policy(int32_t _ctx, int32_t policy);
+void fz_store_set_pressure_callback(int32_t _ctx, Option<StorePressureCallback> callback, void * user, uint64_t interval_ms);
+void fz_store_set_type_cost(int32_t _ctx, int32_t item_type, double cost);
 void fz_store_set_type_limit(int32_t _ctx, int32_t item_type, size_t max_size);
+void fz_store_set_watermarks(int32_t _ctx, size_t soft, size_t hard);
+size_t fz_store_soft_limit(int32_t _ctx);
 uint64_t fz_store_total_evicted(int32_t _ctx);
+uint64_t fz_store_total_rejected(int32_t _ctx);
 uint64_t fz_store_total_stored(int32_t _ctx);
 size_t fz_store_type_count(int32_t _ctx, int32_t item_type);
 size_t fz_store_type_size(int32_t _ctx, int32_t item_type);
@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Story Functions (15 total)
+// Story Functions (16 total)
 // ============================================================================
 
 void fz_draw_story(int32_t _ctx, int32_t story, int32_t dev, float ctm_a, float ctm_b, float ctm_c, float ctm_d, float ctm_e, float ctm_f);
@@ -30,6 +30,7 @@ int32_t fz_story_placed_regions_count(int32_t story);
 void fz_story_positions(int32_t ctx, int32_t story, StoryPositionCallback callback, c_void * arg);
 int32_t fz_story_rectangle_num(int32_t story);
 void fz_story_set_em(int32_t story, float em);
+void fz_story_set_hyphenation(int32_t story, int32_t language);
 int32_t fz_story_state(int32_t story);
 const char * fz_story_warnings(int32_t _ctx, int32_t story);
 
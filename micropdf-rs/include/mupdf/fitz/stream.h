@@ -14,9 +14,10 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Stream Functions (29 total)
+// Stream Functions (31 total)
 // ============================================================================
 
+size_t fz_consume(int32_t _ctx, int32_t stm, size_t n);
 void fz_drop_stream(int32_t _ctx, int32_t stm);
 int32_t fz_is_eof(int32_t _ctx, int32_t stm);
 int32_t fz_keep_stream(int32_t _ctx, int32_t stm);
@@ -24,6 +25,7 @@ int32_t fz_open_buffer(int32_t _ctx, int32_t buf);
 int32_t fz_open_file(int32_t _ctx, const char * filename);
 int32_t fz_open_memory(int32_t _ctx, u8 const * data, size_t len);
 int32_t fz_peek_byte(int32_t _ctx, int32_t stm);
+u8 const * fz_peek_bytes(int32_t _ctx, int32_t stm, size_t max, size_t * len);
 size_t fz_read(int32_t _ctx, int32_t stm, u8 * data, size_t len);
 int32_t fz_read_all(int32_t _ctx, int32_t stm);
 int32_t fz_read_byte(int32_t _ctx, int32_t stm);
@@ -14,19 +14,25 @@ extern "C" {
 #endif
 
 // ============================================================================
-// String_util Functions (13 total)
+// String_util Functions (19 total)
 // ============================================================================
 
 size_t fz_bidi_reorder(int32_t _ctx, const char * input, char * output, size_t output_size, int32_t base_dir);
+int32_t fz_bidi_reorder_stext_page(int32_t _ctx, int32_t page, int32_t base_dir);
 int32_t fz_byte_to_char_offset(int32_t _ctx, const char * s, size_t byte_offset);
 size_t fz_casefold(int32_t _ctx, const char * input, char * output, size_t output_size);
+int32_t fz_casefold_strings(int32_t _ctx, const uint8_t * data, const uint32_t * offsets, size_t count, uint32_t * out_offsets);
 int32_t fz_char_to_byte_offset(int32_t _ctx, const char * s, size_t char_index);
 int32_t fz_detect_script(int32_t _ctx, const char * text);
+size_t fz_detect_stext_line_scripts(int32_t _ctx, int32_t page, int32_t * scripts, size_t max_lines);
 size_t fz_find_line_breaks(int32_t _ctx, const char * text, int32_t * breaks, size_t max_breaks);
+size_t fz_find_stext_line_breaks(int32_t _ctx, int32_t page, int32_t * breaks, size_t max_breaks);
+size_t fz_find_stext_word_breaks(int32_t _ctx, int32_t page, int32_t * breaks, size_t max_breaks);
 size_t fz_find_word_breaks(int32_t _ctx, const char * text, int32_t * breaks, size_t max_breaks);
 int32_t fz_get_bidi_direction(int32_t _ctx, const char * text);
 int32_t fz_get_word_at(int32_t _ctx, const char * text, size_t position, size_t * word_start, size_t * word_end);
 size_t fz_normalize_string(int32_t _ctx, const char * input, char * output, size_t output_size, int32_t form);
+int32_t fz_normalize_strings(int32_t _ctx, const uint8_t * data, const uint32_t * offsets, size_t count, int32_t _form, uint32_t * out_offsets);
 int32_t fz_strcoll(int32_t _ctx, const char * s1, const char * s2, const char * _locale);
 size_t fz_string_char_count(int32_t _ctx, const char * s);
 int32_t fz_string_is_normalized(int32_t _ctx, const char * input, int32_t form);
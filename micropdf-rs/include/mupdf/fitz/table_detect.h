@@ -14,9 +14,10 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Table_detect Functions (14 total)
+// Table_detect Functions (15 total)
 // ============================================================================
 
+int32_t fz_detect_document_tables(int32_t ctx, int32_t doc, const TableDetectorConfig * config, int32_t format, int32_t threads, int32_t max_in_flight, FzTableCallback callback, void * opaque);
 void fz_drop_table(int32_t _ctx, int32_t table);
 void fz_drop_table_detector(int32_t _ctx, int32_t detector);
 void fz_free_table_string(int32_t _ctx, char * s);
@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Text Functions (15 total)
+// Text Functions (17 total)
 // ============================================================================
 
 fz_rect fz_bound_text(int32_t _ctx, int32_t text, int32_t stroke, fz_matrix transform);
@@ -23,7 +23,9 @@ int32_t fz_clone_text(int32_t _ctx, int32_t text);
 void fz_drop_text(int32_t _ctx, int32_t text);
 int32_t fz_keep_text(int32_t _ctx, int32_t text);
 int32_t fz_new_text(int32_t _ctx);
+int32_t fz_purge_shaped_text_cache(int32_t _ctx, int32_t font);
 void fz_set_text_language(int32_t _ctx, int32_t text, const char * lang);
+int32_t fz_shape_text(int32_t _ctx, int32_t font, float size, int32_t script, int32_t language, const char * text, int32_t * glyphs, float * advances, int32_t max);
 void fz_show_glyph(int32_t _ctx, int32_t text, int32_t font, fz_matrix transform, int32_t glyph, int32_t unicode, int32_t wmode);
 void fz_show_string(int32_t _ctx, int32_t text, int32_t font, fz_matrix transform, const char * string, int32_t wmode);
 int32_t fz_text_count_items(int32_t _ctx, int32_t text);
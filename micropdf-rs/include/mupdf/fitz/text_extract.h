@@ -0,0 +1,26 @@
+// MicroPDF - MuPDF API Compatible C Header
+// Auto-generated from Rust FFI - DO NOT EDIT MANUALLY
+// Module: text_extract
+
+#ifndef MUPDF_FITZ_TEXT_EXTRACT_H
+#define MUPDF_FITZ_TEXT_EXTRACT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// Text_extract Functions (1 total)
+// ============================================================================
+
+int32_t fz_extract_document_text(int32_t ctx, int32_t doc, int32_t format, const StextOptions * options, int32_t threads, int32_t max_in_flight, FzTextPageCallback callback, void * opaque);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MUPDF_FITZ_TEXT_EXTRACT_H */
@@ -0,0 +1,27 @@
+// MicroPDF - MuPDF API Compatible C Header
+// Auto-generated from Rust FFI - DO NOT EDIT MANUALLY
+// Module: thumbnail
+
+#ifndef MUPDF_FITZ_THUMBNAIL_H
+#define MUPDF_FITZ_THUMBNAIL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// Thumbnail Functions (2 total)
+// ============================================================================
+
+int32_t fz_new_thumbnail_jpegs(int32_t ctx, int32_t doc, int32_t max_size, int32_t cs, int32_t quality, int32_t threads, int32_t * buffers, int32_t count);
+int32_t fz_new_thumbnail_sheet(int32_t ctx, int32_t doc, int32_t max_size, int32_t cs, int32_t columns, int32_t threads, fz_irect * rects, int32_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MUPDF_FITZ_THUMBNAIL_H */
@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Tile_render Functions (12 total)
+// Tile_render Functions (19 total)
 // ============================================================================
 
 void fz_cancel_render_task(int32_t _ctx, int32_t task);
@@ -23,12 +23,19 @@ void fz_drop_tile_renderer(int32_t _ctx, int32_t renderer);
 int32_t fz_new_render_task(int32_t _ctx, int32_t renderer);
 int32_t fz_new_tile_renderer(int32_t _ctx, float x0, float y0, float x1, float y1, uint32_t tile_width, uint32_t tile_height, float scale, int alpha);
 int fz_render_task_is_cancelled(int32_t _ctx, int32_t task);
+int32_t fz_render_task_pixmap(int32_t _ctx, int32_t task);
+int32_t fz_render_task_run(int32_t ctx, int32_t task, int32_t list, int32_t cs, int threads);
+void fz_render_task_set_callback(int32_t _ctx, int32_t task, Option<TileCallback> callback, void * user_data);
+void fz_render_task_set_preview(int32_t _ctx, int32_t task, int factor);
 int fz_tile_renderer_count(int32_t _ctx, int32_t renderer);
 void fz_tile_renderer_dimensions(int32_t _ctx, int32_t renderer, uint32_t * width, uint32_t * height);
 int fz_tile_renderer_get_bounds(int32_t _ctx, int32_t renderer, int index, float * x0, float * y0, float * x1, float * y1);
+int fz_tile_renderer_get_priority(int32_t _ctx, int32_t renderer, int index);
 void fz_tile_renderer_grid(int32_t _ctx, int32_t renderer, uint32_t * cols, uint32_t * rows);
 int fz_tile_renderer_is_complete(int32_t _ctx, int32_t renderer);
+void fz_tile_renderer_prioritize_viewport(int32_t _ctx, int32_t renderer, int x0, int y0, int x1, int y1);
 float fz_tile_renderer_progress(int32_t _ctx, int32_t renderer);
+int fz_tile_renderer_set_priority(int32_t _ctx, int32_t renderer, int index, int priority);
 
 #ifdef __cplusplus
 }
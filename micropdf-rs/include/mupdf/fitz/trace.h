@@ -0,0 +1,33 @@
+// MicroPDF - MuPDF API Compatible C Header
+// Auto-generated from Rust FFI - DO NOT EDIT MANUALLY
+// Module: trace
+
+#ifndef MUPDF_FITZ_TRACE_H
+#define MUPDF_FITZ_TRACE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// Trace Functions (8 total)
+// ============================================================================
+
+int32_t fz_trace_available(int32_t _ctx);
+void fz_trace_clear(int32_t _ctx);
+void fz_trace_enable(int32_t _ctx, int32_t enabled);
+size_t fz_trace_event_count(int32_t _ctx);
+int32_t fz_trace_export_chrome(int32_t _ctx);
+int32_t fz_trace_is_enabled(int32_t _ctx);
+void fz_trace_set_callback(int32_t _ctx, TraceCallback callback, void * user);
+void fz_trace_set_capacity(int32_t _ctx, size_t events_per_thread);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MUPDF_FITZ_TRACE_H */
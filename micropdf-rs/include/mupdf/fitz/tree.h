@@ -14,10 +14,25 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Tree Functions (27 total)
+// Bulk Extraction
+// ============================================================================
+
+/* One element of an extracted structure tree; records are in pre-order */
+typedef struct {
+    int32_t struct_type;
+    int32_t parent;
+    int32_t page;
+    float bbox[4];
+    uint32_t text_offset;
+    uint32_t text_length;
+} fz_structure_record;
+
+// ============================================================================
+// Tree Functions (28 total)
 // ============================================================================
 
 void fz_drop_structure_tree(int32_t _ctx, int32_t tree);
+int32_t fz_extract_structure_tree(int32_t _ctx, int32_t doc, int32_t threads, int32_t * count);
 int32_t fz_keep_structure_tree(int32_t _ctx, int32_t tree);
 int32_t fz_new_structure_tree(int32_t _ctx);
 int32_t fz_tree_add_node(int32_t _ctx, int32_t tree, int32_t parent, int32_t struct_type);
@@ -14,16 +14,22 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Write_pixmap Functions (26 total)
+// Write_pixmap Functions (39 total)
 // ============================================================================
 
+int32_t fz_new_buffer_from_pixmap_as_avif(int32_t _ctx, int32_t pixmap, int32_t quality, int32_t speed);
 int32_t fz_new_buffer_from_pixmap_as_jpeg(int32_t _ctx, int32_t pixmap, int32_t quality, int32_t _invert_cmyk);
+int32_t fz_new_buffer_from_pixmap_as_jpeg_with_options(int32_t _ctx, int32_t pixmap, int32_t quality, int32_t threads);
 int32_t fz_new_buffer_from_pixmap_as_pam(int32_t _ctx, int32_t pixmap);
 int32_t fz_new_buffer_from_pixmap_as_pbm(int32_t _ctx, int32_t pixmap);
 int32_t fz_new_buffer_from_pixmap_as_pkm(int32_t _ctx, int32_t pixmap);
 int32_t fz_new_buffer_from_pixmap_as_png(int32_t _ctx, int32_t pixmap);
+int32_t fz_new_buffer_from_pixmap_as_png_with_options(int32_t _ctx, int32_t pixmap, int32_t effort, int32_t threads);
 int32_t fz_new_buffer_from_pixmap_as_pnm(int32_t _ctx, int32_t pixmap);
 int32_t fz_new_buffer_from_pixmap_as_psd(int32_t _ctx, int32_t pixmap);
+int32_t fz_new_buffer_from_pixmap_as_qoi(int32_t _ctx, int32_t pixmap);
+int32_t fz_new_buffer_from_pixmap_as_webp(int32_t _ctx, int32_t pixmap);
+int32_t fz_save_pixmap_as_avif(int32_t _ctx, int32_t pixmap, const char * filename, int32_t quality, int32_t speed);
 int32_t fz_save_pixmap_as_jpeg(int32_t _ctx, int32_t pixmap, const char * filename, int32_t quality);
 int32_t fz_save_pixmap_as_pam(int32_t _ctx, int32_t pixmap, const char * filename);
 int32_t fz_save_pixmap_as_pbm(int32_t _ctx, int32_t pixmap, const char * filename);
@@ -32,15 +38,22 @@ int32_t fz_save_pixmap_as_png(int32_t _ctx, int32_t pixmap, const char * filenam
 int32_t fz_save_pixmap_as_pnm(int32_t _ctx, int32_t pixmap, const char * filename);
 int32_t fz_save_pixmap_as_ps(int32_t _ctx, int32_t pixmap, const char * filename, int32_t _append);
 int32_t fz_save_pixmap_as_psd(int32_t _ctx, int32_t pixmap, const char * filename);
+int32_t fz_save_pixmap_as_qoi(int32_t _ctx, int32_t pixmap, const char * filename);
+int32_t fz_save_pixmap_as_webp(int32_t _ctx, int32_t pixmap, const char * filename);
+int32_t fz_write_pixmap_as_avif(int32_t _ctx, int32_t out, int32_t pixmap, int32_t quality, int32_t speed);
 int32_t fz_write_pixmap_as_data_uri(int32_t _ctx, int32_t out, int32_t pixmap);
 int32_t fz_write_pixmap_as_jpeg(int32_t _ctx, int32_t out, int32_t pixmap, int32_t quality, int32_t _invert_cmyk);
+int32_t fz_write_pixmap_as_jpeg_with_options(int32_t _ctx, int32_t out, int32_t pixmap, int32_t quality, int32_t threads);
 int32_t fz_write_pixmap_as_pam(int32_t _ctx, int32_t out, int32_t pixmap);
 int32_t fz_write_pixmap_as_pbm(int32_t _ctx, int32_t out, int32_t pixmap);
 int32_t fz_write_pixmap_as_pkm(int32_t _ctx, int32_t out, int32_t pixmap);
 int32_t fz_write_pixmap_as_png(int32_t _ctx, int32_t out, int32_t pixmap);
+int32_t fz_write_pixmap_as_png_with_options(int32_t _ctx, int32_t out, int32_t pixmap, int32_t effort, int32_t threads);
 int32_t fz_write_pixmap_as_pnm(int32_t _ctx, int32_t out, int32_t pixmap);
 int32_t fz_write_pixmap_as_ps(int32_t _ctx, int32_t out, int32_t pixmap);
 int32_t fz_write_pixmap_as_psd(int32_t _ctx, int32_t out, int32_t pixmap);
+int32_t fz_write_pixmap_as_qoi(int32_t _ctx, int32_t out, int32_t pixmap);
+int32_t fz_write_pixmap_as_webp(int32_t _ctx, int32_t out, int32_t pixmap);
 int32_t fz_write_ps_file_header(int32_t _ctx, int32_t out);
 int32_t fz_write_ps_file_trailer(int32_t _ctx, int32_t out, int32_t pages);
 
@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Writer Functions (47 total)
+// Writer Functions (50 total)
 // ============================================================================
 
 int32_t fz_begin_page(int32_t _ctx, int32_t wri, float mediabox_x0, float mediabox_y0, float mediabox_x1, float mediabox_y1);
@@ -26,6 +26,7 @@ int32_t fz_document_writer_page_count(int32_t wri);
 void fz_drop_document_writer(int32_t _ctx, int32_t wri);
 void fz_end_page(int32_t _ctx, int32_t wri);
 int32_t fz_has_option(int32_t _ctx, const char * opts, const char * key, const char * * val);
+int32_t fz_new_avif_pixmap_writer(int32_t _ctx, const char * path, const char * options);
 int32_t fz_new_cbz_writer(int32_t _ctx, const char * path, const char * options);
 int32_t fz_new_cbz_writer_with_output(int32_t _ctx, int32_t out, const char * options);
 int32_t fz_new_csv_writer(int32_t _ctx, const char * path, const char * options);
@@ -57,10 +58,12 @@ int32_t fz_new_ps_writer(int32_t _ctx, const char * path, const char * options);
 int32_t fz_new_ps_writer_with_output(int32_t _ctx, int32_t out, const char * options);
 int32_t fz_new_pwg_writer(int32_t _ctx, const char * path, const char * options);
 int32_t fz_new_pwg_writer_with_output(int32_t _ctx, int32_t out, const char * options);
+int32_t fz_new_qoi_pixmap_writer(int32_t _ctx, const char * path, const char * options);
 int32_t fz_new_svg_writer(int32_t _ctx, const char * path, const char * options);
 int32_t fz_new_svg_writer_with_output(int32_t _ctx, int32_t out, const char * options);
 int32_t fz_new_text_writer(int32_t _ctx, const char * format, const char * path, const char * options);
 int32_t fz_new_text_writer_with_output(int32_t _ctx, const char * format, int32_t out, const char * options);
+int32_t fz_new_webp_pixmap_writer(int32_t _ctx, const char * path, const char * options);
 int32_t fz_option_eq(const char * a, const char * b);
 c_void, ) fz_pdfocr_writer_set_progress(int32_t _ctx, int32_t wri);
 void fz_write_document(int32_t _ctx, int32_t wri, int32_t doc);
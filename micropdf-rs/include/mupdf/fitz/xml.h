@@ -14,13 +14,14 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Xml Functions (18 total)
+// Xml Functions (19 total)
 // ============================================================================
 
 void fz_drop_xml(int32_t _ctx, int32_t doc);
 int32_t fz_new_xml_document(int32_t _ctx);
-int32_t fz_parse_xml(int32_t _ctx, const char * xml_string, int32_t _preserve_whitespace);
-int32_t fz_parse_xml_from_buffer(int32_t _ctx, int32_t buffer, int32_t _preserve_whitespace);
+int32_t fz_parse_xml(int32_t _ctx, const char * xml_string, int32_t preserve_whitespace);
+int32_t fz_parse_xml_from_buffer(int32_t _ctx, int32_t buffer, int32_t preserve_whitespace);
+int32_t fz_parse_xml_subtrees(int32_t _ctx, const char * xml_string, const char * const * paths, int32_t path_count, int32_t preserve_whitespace, int32_t first_match);
 const char * fz_xml_att(int32_t _ctx, int32_t node, const char * name);
 int32_t fz_xml_att_count(int32_t _ctx, int32_t node);
 int32_t fz_xml_child_count(int32_t _ctx, int32_t node);
@@ -14,7 +14,27 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Annot Functions (31 total)
+// Batched Changes
+// ============================================================================
+
+/* pdf_annot_change.mask bits: which fields to apply */
+#define PDF_ANNOT_CHANGE_RECT       (1 << 0)
+#define PDF_ANNOT_CHANGE_CONTENTS   (1 << 1)
+#define PDF_ANNOT_CHANGE_OPACITY    (1 << 2)
+#define PDF_ANNOT_CHANGE_FLAGS      (1 << 3)
+
+/** Changes to one annotation, for pdf_update_annots */
+typedef struct {
+    uint64_t annot;             /* Annotation handle */
+    uint32_t mask;              /* PDF_ANNOT_CHANGE_* bits */
+    uint32_t flags;             /* New annotation flags */
+    fz_rect rect;               /* New rectangle */
+    float opacity;              /* New opacity, 0-1 */
+    const char *contents;       /* New contents, UTF-8 */
+} pdf_annot_change;
+
+// ============================================================================
+// Annot Functions (36 total)
 // ============================================================================
 
 int32_t pdf_annot_author(int32_t _ctx, int32_t annot, c_char * buf, int32_t size);
@@ -25,6 +45,8 @@ int32_t pdf_annot_contents(int32_t _ctx, int32_t annot, c_char * buf, int32_t si
 uint32_t pdf_annot_flags(int32_t _ctx, int32_t annot);
 int32_t pdf_annot_has_dirty(int32_t _ctx, int32_t annot);
 int32_t pdf_annot_has_popup(int32_t _ctx, int32_t annot);
+int32_t pdf_annot_index_at_point(int32_t _ctx, int32_t index, float x, float y);
+int32_t pdf_annot_index_in_rect(int32_t _ctx, int32_t index, float x0, float y0, float x1, float y1, int32_t * annots, int32_t max);
 void pdf_annot_interior_color(int32_t _ctx, int32_t annot, int32_t * n, float * color);
 int32_t pdf_annot_is_valid(int32_t _ctx, int32_t annot);
 int32_t pdf_annot_line(int32_t _ctx, int32_t annot, fz_point * a, fz_point * b);
@@ -35,8 +57,10 @@ int32_t pdf_clone_annot(int32_t _ctx, int32_t annot);
 int32_t pdf_create_annot(int32_t _ctx, int32_t _page, int32_t annot_type);
 void pdf_delete_annot(int32_t _ctx, int32_t _page, int32_t annot);
 void pdf_drop_annot(int32_t _ctx, int32_t annot);
+void pdf_drop_annot_index(int32_t _ctx, int32_t index);
 int32_t pdf_first_annot(int32_t _ctx, int32_t page);
 int32_t pdf_keep_annot(int32_t _ctx, int32_t annot);
+int32_t pdf_new_annot_index(int32_t _ctx, int32_t page);
 int32_t pdf_next_annot(int32_t _ctx, int32_t annot);
 void pdf_set_annot_author(int32_t _ctx, int32_t annot, const char * text);
 void pdf_set_annot_border_width(int32_t _ctx, int32_t annot, float width);
@@ -48,6 +72,7 @@ void pdf_set_annot_line(int32_t _ctx, int32_t annot, fz_point a, fz_point b);
 void pdf_set_annot_opacity(int32_t _ctx, int32_t annot, float opacity);
 void pdf_set_annot_rect(int32_t _ctx, int32_t annot, fz_rect rect);
 int32_t pdf_update_annot(int32_t _ctx, int32_t annot);
+int32_t pdf_update_annots(int32_t _ctx, pdf_annot_change const * changes, int32_t count, fz_rect * dirty);
 
 #ifdef __cplusplus
 }
@@ -88,6 +88,7 @@ typedef struct {
     int do_use_objstms;         /* Use object streams */
     int compression_effort;     /* 0=default, 1=min, 100=max */
     int do_labels;              /* Add labels to objects */
+    uint64_t brotli_dictionary; /* Registered Brotli dictionary (0=none) */
 } pdf_write_options;
 
 /* ============================================================================
@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Document Functions (30 total)
+// Document Functions (43 total)
 // ============================================================================
 
 int32_t fz_authenticate_password(int32_t _ctx, int32_t doc, const char * password);
@@ -26,9 +26,14 @@ int32_t fz_count_chapters(int32_t _ctx, int32_t _doc);
 int32_t fz_count_pages(int32_t _ctx, int32_t doc);
 int32_t fz_document_format(int32_t _ctx, int32_t doc, char * buf, int32_t size);
 int32_t fz_document_is_valid(int32_t _ctx, int32_t doc);
+size_t fz_document_memory_limit(int32_t _ctx, int32_t doc);
+size_t fz_document_memory_peak(int32_t _ctx, int32_t doc);
+size_t fz_document_memory_used(int32_t _ctx, int32_t doc);
 void fz_drop_document(int32_t _ctx, int32_t doc);
 void fz_drop_page(int32_t _ctx, int32_t page);
+int32_t fz_fill_pixmap_from_page(int32_t ctx, int32_t page, fz_matrix ctm, int32_t pix, int32_t aa_bits, int32_t flags, int32_t cookie);
 int32_t fz_has_permission(int32_t _ctx, int32_t doc, int32_t _permission);
+int32_t fz_inspect_document(int32_t _ctx, int32_t doc);
 int32_t fz_is_document_reflowable(int32_t _ctx, int32_t doc);
 int32_t fz_keep_document(int32_t _ctx, int32_t doc);
 int32_t fz_keep_page(int32_t _ctx, int32_t page);
@@ -39,6 +44,10 @@ int32_t fz_load_page(int32_t _ctx, int32_t doc, int32_t page_num);
 int32_t fz_lookup_metadata(int32_t _ctx, int32_t _doc, const char * _key, char * buf, int32_t size);
 char * fz_make_location_uri(int32_t _ctx, int32_t _doc, int32_t page, char * buf, int32_t size);
 int32_t fz_needs_password(int32_t _ctx, int32_t doc);
+int32_t fz_new_pixmap_from_page(int32_t ctx, int32_t page, fz_matrix ctm, int32_t cs, int32_t alpha);
+int32_t fz_new_pixmap_from_page_band(int32_t ctx, int32_t page, fz_matrix ctm, int32_t cs, int32_t alpha, int32_t aa_bits, int32_t flags, int32_t band_y, int32_t band_h, int32_t cookie);
+int32_t fz_new_pixmap_from_page_with_cookie(int32_t ctx, int32_t page, fz_matrix ctm, int32_t cs, int32_t alpha, int32_t cookie);
+int32_t fz_new_pixmap_from_page_with_options(int32_t ctx, int32_t page, fz_matrix ctm, int32_t cs, int32_t alpha, int32_t aa_bits, int32_t flags, int32_t cookie);
 int32_t fz_open_document(int32_t _ctx, const char * filename);
 int32_t fz_open_document_with_stream(int32_t _ctx, const char * _magic, int32_t stm);
 int32_t fz_page_label(int32_t _ctx, int32_t doc, int32_t page_num, char * buf, int32_t size);
@@ -47,6 +56,10 @@ int32_t fz_resolve_link(int32_t _ctx, int32_t doc, const char * uri, float * xp,
 void fz_run_page(int32_t _ctx, int32_t page, int32_t device, fz_matrix transform, c_void * cookie);
 void fz_run_page_annots(int32_t _ctx, int32_t page, int32_t device, fz_matrix transform, c_void * cookie);
 void fz_run_page_contents(int32_t _ctx, int32_t page, int32_t device, fz_matrix transform, c_void * cookie);
+void fz_set_default_document_memory_limit(int32_t _ctx, size_t bytes);
+void fz_set_document_memory_limit(int32_t _ctx, int32_t doc, size_t bytes);
+int32_t fz_update_pixmap_from_page(int32_t ctx, int32_t page, fz_matrix ctm, int32_t pix, int32_t aa_bits, int32_t flags, fz_rect const * damage, int32_t count, int32_t cookie);
+int32_t fz_write_page_banded(int32_t ctx, int32_t page, fz_matrix ctm, int32_t cs, int32_t alpha, int32_t aa_bits, int32_t flags, int32_t writer, int32_t cookie);
 
 #ifdef __cplusplus
 }
@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Form Functions (57 total)
+// Form Functions (59 total)
 // ============================================================================
 
 int32_t pdf_add_field_choice(int32_t _ctx, int32_t field, const char * label, const char * value);
@@ -24,7 +24,7 @@ int32_t pdf_create_combo_box(int32_t _ctx, int32_t _form, const char * name, flo
 int32_t pdf_create_push_button(int32_t _ctx, int32_t _form, const char * name, float x, float y, float width, float height, const char * caption);
 int32_t pdf_create_signature_field(int32_t _ctx, int32_t _form, const char * name, float x, float y, float width, float height);
 int32_t pdf_create_text_field(int32_t _ctx, int32_t _form, const char * name, float x, float y, float width, float height, int32_t max_len);
-int32_t pdf_delete_field(int32_t _ctx, int32_t _form, int32_t field);
+int32_t pdf_delete_field(int32_t _ctx, int32_t form, int32_t field);
 void pdf_drop_form(int32_t _ctx, int32_t form);
 int32_t pdf_field_alignment(int32_t _ctx, int32_t field);
 void pdf_field_bg_color(int32_t _ctx, int32_t field, float * color);
@@ -54,8 +54,10 @@ int32_t pdf_field_selected_index(int32_t _ctx, int32_t field);
 int32_t pdf_field_text_format(int32_t _ctx, int32_t field);
 int32_t pdf_field_type(int32_t _ctx, int32_t field);
 int32_t pdf_field_value(int32_t _ctx, int32_t field, c_char * buf, int32_t size);
+int32_t pdf_fill_form(int32_t _ctx, int32_t doc, const char * const * names, const char * const * values, int32_t count);
 int32_t pdf_first_widget(int32_t _ctx, int32_t page);
-int32_t pdf_form(int32_t _ctx, int32_t _doc);
+int32_t pdf_flatten_form(int32_t _ctx, int32_t doc);
+int32_t pdf_form(int32_t _ctx, int32_t doc);
 int32_t pdf_form_field_count(int32_t _ctx, int32_t form);
 int32_t pdf_keep_form(int32_t _ctx, int32_t form);
 int32_t pdf_lookup_field(int32_t _ctx, int32_t form, const char * name);
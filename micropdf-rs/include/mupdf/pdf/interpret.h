@@ -38,7 +38,8 @@ typedef enum {
     PDF_PROCESSOR_OUTPUT = 3,
     PDF_PROCESSOR_SANITIZE = 4,
     PDF_PROCESSOR_COLOR = 5,
-    PDF_PROCESSOR_VECTORIZE = 6
+    PDF_PROCESSOR_VECTORIZE = 6,
+    PDF_PROCESSOR_TEXT = 7
 } pdf_processor_type;
 
 /* Cull types */
@@ -63,7 +64,7 @@ typedef enum {
 /**
  * Create a new processor.
  * @param ctx Context handle
- * @param size Processor type (0=base, 1=run, 2=buffer, 3=output, 4=sanitize, 5=color, 6=vectorize)
+ * @param size Processor type (0=base, 1=run, 2=buffer, 3=output, 4=sanitize, 5=color, 6=vectorize, 7=text)
  */
 pdf_processor *pdf_new_processor(fz_context *ctx, int size);
 
@@ -93,6 +94,20 @@ pdf_processor *pdf_new_run_processor(
     const char *usage
 );
 
+/**
+ * Create a text-only run processor for text extraction.
+ * Tracks only text state and the CTM: images are not loaded, shadings are
+ * not evaluated, and paths, clips, stroke and colour state are dropped.
+ */
+pdf_processor *pdf_new_text_processor(
+    fz_context *ctx,
+    pdf_document *doc,
+    fz_device *dev,
+    float a, float b, float c, float d, float e, float f,
+    int struct_parent,
+    const char *usage
+);
+
 /** Create a buffer processor */
 pdf_processor *pdf_new_buffer_processor(
     fz_context *ctx,
@@ -337,6 +352,9 @@ void pdf_op_END(fz_context *ctx, pdf_processor *proc);
 /** Get processor type */
 int pdf_processor_get_type(fz_context *ctx, pdf_processor *proc);
 
+/** Check whether a processor tracks only text state and the CTM */
+int pdf_processor_is_text_only(fz_context *ctx, pdf_processor *proc);
+
 /** Get number of operators processed */
 int pdf_processor_get_operator_count(fz_context *ctx, pdf_processor *proc);
 
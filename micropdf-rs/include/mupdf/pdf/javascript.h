@@ -270,6 +270,46 @@ void pdf_js_event_set_value(pdf_js *js, const char *value);
  */
 int pdf_js_is_enabled(pdf_js *js);
 
+/* ============================================================================
+ * Calculations
+ * ============================================================================ */
+
+/**
+ * Set the calculate script of a field.
+ *
+ * Understands AFSimple_Calculate and event.value = <arithmetic over
+ * getField("x").value>. Scripts are compiled once per source text and
+ * shared by every context.
+ *
+ * @param js     JavaScript context handle
+ * @param field  Full field name
+ * @param code   Calculate script
+ * @return       1 if compiled, 0 if the script isn't understood
+ */
+int pdf_js_set_calculate(pdf_js *js, const char *field, const char *code);
+
+/**
+ * Set the value of a field and recalculate the fields that depend on it.
+ *
+ * Only fields downstream of the change are recalculated, each after the
+ * fields it reads.
+ *
+ * @param js     JavaScript context handle
+ * @param field  Full field name
+ * @param value  New value (can be NULL for empty)
+ * @return       Number of fields recalculated, or -1 if js is invalid
+ */
+int pdf_js_set_field_value(pdf_js *js, const char *field, const char *value);
+
+/**
+ * Get the value of a field, as set or calculated.
+ *
+ * @param js     JavaScript context handle
+ * @param field  Full field name
+ * @return       Newly allocated string (caller must free), or NULL
+ */
+char *pdf_js_get_field_value(pdf_js *js, const char *field);
+
 #ifdef __cplusplus
 }
 #endif
@@ -153,6 +153,15 @@ float pdf_page_user_unit(fz_context *ctx, pdf_page *page);
  */
 fz_rect pdf_bound_page(fz_context *ctx, pdf_page *page, fz_box_type box);
 
+/**
+ * Get the bounds of every page without loading the pages.
+ * Writes x0, y0, x1, y1 per page, as pdf_bound_page gives them for the
+ * crop box, for up to max pages.
+ * @param out Output for 4 * max floats (may be NULL to count pages)
+ * @return Number of pages in the document, or -1 if it has no page tree
+ */
+int pdf_bound_pages(fz_context *ctx, pdf_document *doc, float *out, int max);
+
 /**
  * Get the page transformation matrix.
  * @param mediabox Output for the media box (may be NULL)
@@ -0,0 +1,26 @@
+// MicroPDF - MuPDF API Compatible C Header
+// Auto-generated from Rust FFI - DO NOT EDIT MANUALLY
+// Module: pdf_gc
+
+#ifndef MUPDF_PDF_PDF_GC_H
+#define MUPDF_PDF_PDF_GC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// Pdf_gc Functions (1 total)
+// ============================================================================
+
+int32_t pdf_mark_xref_reachable(int32_t _ctx, int32_t xref, int32_t threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MUPDF_PDF_PDF_GC_H */
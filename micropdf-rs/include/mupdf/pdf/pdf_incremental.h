@@ -0,0 +1,27 @@
+// MicroPDF - MuPDF API Compatible C Header
+// Auto-generated from Rust FFI - DO NOT EDIT MANUALLY
+// Module: pdf_incremental
+
+#ifndef MUPDF_PDF_PDF_INCREMENTAL_H
+#define MUPDF_PDF_PDF_INCREMENTAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// Pdf_incremental Functions (2 total)
+// ============================================================================
+
+int32_t pdf_append_xref_incremental(int32_t _ctx, int32_t xref, const char * filename);
+int32_t pdf_save_xref_incremental(int32_t _ctx, int32_t xref, const char * filename);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MUPDF_PDF_PDF_INCREMENTAL_H */
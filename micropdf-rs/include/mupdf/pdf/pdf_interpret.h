@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Pdf_interpret Functions (103 total)
+// Pdf_interpret Functions (105 total)
 // ============================================================================
 
 void pdf_close_processor(int32_t _ctx, int32_t proc);
@@ -27,6 +27,7 @@ int32_t pdf_new_output_processor(int32_t _ctx, int32_t out, int32_t ahx_encode,
 int32_t pdf_new_processor(int32_t _ctx, int32_t size);
 int32_t pdf_new_run_processor(int32_t _ctx, int32_t doc, int32_t dev, float a, float b, float c, float d, float e, float f, int32_t struct_parent, const char * usage);
 int32_t pdf_new_sanitize_filter(int32_t _ctx, int32_t _doc, int32_t chain, int32_t struct_parents, float a, float b, float c, float d, float e, float f);
+int32_t pdf_new_tee_processor(int32_t _ctx, const int32_t * procs, int32_t count);
 int32_t pdf_new_vectorize_filter(int32_t _ctx, int32_t _doc, int32_t chain, int32_t struct_parents, float a, float b, float c, float d, float e, float f);
 void pdf_op_B(int32_t _ctx, int32_t proc);
 void pdf_op_BDC(int32_t _ctx, int32_t proc, const char * tag);
@@ -108,7 +109,7 @@ void pdf_op_v(int32_t _ctx, int32_t proc, float x2, float y2, float x3, float y3
 void pdf_op_w(int32_t _ctx, int32_t proc, float linewidth);
 void pdf_op_y(int32_t _ctx, int32_t proc, float x1, float y1, float x3, float y3);
 void pdf_process_annot(int32_t _ctx, int32_t proc, int32_t annot);
-void pdf_process_contents(int32_t _ctx, int32_t proc, int32_t _doc, int32_t res, int32_t _stm, int32_t * _out_res);
+void pdf_process_contents(int32_t _ctx, int32_t proc, int32_t doc, int32_t res, int32_t stm, int32_t * _out_res);
 void pdf_process_glyph(int32_t _ctx, int32_t proc, int32_t _doc, int32_t res);
 void pdf_process_raw_contents(int32_t _ctx, int32_t proc, int32_t _doc, int32_t _stm);
 void pdf_processor_get_ctm(int32_t _ctx, int32_t proc, float * a, float * b, float * c, float * d, float * e, float * f);
@@ -119,6 +120,7 @@ int32_t pdf_processor_get_type(int32_t _ctx, int32_t proc);
 int32_t pdf_processor_in_text(int32_t _ctx, int32_t proc);
 int32_t pdf_processor_pop_resources(int32_t _ctx, int32_t proc);
 void pdf_processor_push_resources(int32_t _ctx, int32_t proc, int32_t res);
+int32_t pdf_purge_content_program_cache(int32_t _ctx, int32_t doc);
 void pdf_reset_processor(int32_t _ctx, int32_t proc);
 
 #ifdef __cplusplus
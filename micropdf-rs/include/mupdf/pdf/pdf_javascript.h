@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Pdf_javascript Functions (24 total)
+// Pdf_javascript Functions (27 total)
 // ============================================================================
 
 void pdf_disable_js(int32_t _ctx, int32_t doc);
@@ -34,11 +34,14 @@ char * pdf_js_event_value(int32_t js);
 void pdf_js_execute(int32_t js, const char * name, const char * code, char * * result);
 void pdf_js_free_string(int32_t _ctx, char * s);
 char * pdf_js_get_console_log(int32_t js);
+char * pdf_js_get_field_value(int32_t js, const char * field);
 char * pdf_js_get_global(int32_t js, const char * name);
 char * pdf_js_get_last_error(int32_t js);
 int32_t pdf_js_is_enabled(int32_t js);
 void pdf_js_register_script(int32_t js, const char * name, const char * code);
 void pdf_js_run_script(int32_t js, const char * name, char * * result);
+int32_t pdf_js_set_calculate(int32_t js, const char * field, const char * code);
+int32_t pdf_js_set_field_value(int32_t js, const char * field, const char * value);
 void pdf_js_set_global(int32_t js, const char * name, const char * value);
 int32_t pdf_js_supported(int32_t _ctx, int32_t doc);
 
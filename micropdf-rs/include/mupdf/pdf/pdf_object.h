@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Pdf_object Functions (99 total)
+// Pdf_object Functions (103 total)
 // ============================================================================
 
 void pdf_arena_free_obj(int32_t _ctx, int32_t handle);
@@ -40,6 +40,7 @@ void pdf_array_push_string(int32_t _ctx, int32_t array, const char * str, size_t
 void pdf_array_put(int32_t _ctx, int32_t array, int32_t index, int32_t obj);
 void pdf_clean_obj(int32_t _ctx, int32_t obj);
 void pdf_clear_object_arena(int32_t _ctx, uint32_t arena_id);
+void pdf_compact_document_object_arena(int32_t _ctx, int32_t doc);
 void pdf_compact_object_arena(int32_t _ctx, uint32_t arena_id);
 int32_t pdf_copy_array(int32_t _ctx, int32_t _doc, int32_t array);
 int32_t pdf_copy_dict(int32_t _ctx, int32_t _doc, int32_t dict);
@@ -58,6 +59,7 @@ void pdf_dict_put_real(int32_t _ctx, int32_t dict, int32_t key, double x);
 void pdf_dict_put_string(int32_t _ctx, int32_t dict, int32_t key, const char * str, size_t len);
 void pdf_dict_puts(int32_t _ctx, int32_t dict, const char * key, int32_t val);
 void pdf_dirty_obj(int32_t _ctx, int32_t obj);
+uint32_t pdf_document_object_arena(int32_t _ctx, int32_t doc);
 void pdf_drop_obj(int32_t _ctx, int32_t obj);
 void pdf_drop_object_arena(int32_t _ctx, uint32_t arena_id);
 int32_t pdf_is_arena_handle(int32_t _ctx, int32_t handle);
@@ -93,6 +95,7 @@ int32_t pdf_new_rect(int32_t _ctx, int32_t _doc, float x0, float y0, float x1, f
 int32_t pdf_new_string(int32_t _ctx, const char * str, size_t len);
 int32_t pdf_new_text_string(int32_t _ctx, const char * s);
 int32_t pdf_obj_is_dirty(int32_t _ctx, int32_t obj);
+int32_t pdf_obj_is_immediate(int32_t _ctx, int32_t obj);
 int32_t pdf_obj_is_resolved(int32_t _ctx, int32_t _doc, int32_t obj);
 int32_t pdf_obj_marked(int32_t _ctx, int32_t obj);
 int32_t pdf_obj_parent_num(int32_t _ctx, int32_t obj);
@@ -101,6 +104,7 @@ int32_t pdf_objcmp(int32_t _ctx, int32_t a, int32_t b);
 size_t pdf_object_arena_count(int32_t _ctx);
 ArenaStats pdf_object_arena_stats(int32_t _ctx, uint32_t arena_id);
 int32_t pdf_resolve_indirect(int32_t _ctx, int32_t _doc, int32_t obj);
+uint32_t pdf_set_document_object_arena(int32_t _ctx, int32_t doc, int32_t enable);
 void pdf_set_obj_parent(int32_t _ctx, int32_t obj, int32_t num);
 int32_t pdf_to_bool(int32_t _ctx, int32_t obj);
 int32_t pdf_to_bool_default(int32_t _ctx, int32_t obj, int32_t def);
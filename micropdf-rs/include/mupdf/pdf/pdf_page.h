@@ -14,12 +14,13 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Pdf_page Functions (55 total)
+// Pdf_page Functions (56 total)
 // ============================================================================
 
 int32_t fz_box_type_from_string(const char * name);
 const char * fz_string_from_box_type(int32_t box_type);
 Rect pdf_bound_page(int32_t _ctx, int32_t page, int32_t box_type);
+int32_t pdf_bound_pages(int32_t _ctx, int32_t doc, float * out, int32_t max);
 void pdf_clip_page(int32_t _ctx, int32_t _page, Rect * _clip);
 int32_t pdf_count_pages(int32_t _ctx, int32_t doc);
 void pdf_drop_page(int32_t _ctx, int32_t page);
@@ -27,7 +28,7 @@ void pdf_drop_page_tree(int32_t _ctx, int32_t _doc);
 void pdf_drop_page_tree_internal(int32_t _ctx, int32_t _doc);
 void pdf_filter_annot_contents(int32_t _ctx, int32_t _doc, int32_t _annot, void * _options);
 void pdf_filter_page_contents(int32_t _ctx, int32_t _doc, int32_t _page, void * _options);
-void pdf_flatten_inheritable_page_items(int32_t _ctx, int32_t _pageobj);
+void pdf_flatten_inheritable_page_items(int32_t ctx, int32_t pageobj);
 int32_t pdf_keep_page(int32_t _ctx, int32_t page);
 int32_t pdf_load_default_colorspaces(int32_t _ctx, int32_t _doc, int32_t _page);
 int32_t pdf_load_links(int32_t _ctx, int32_t page);
@@ -71,7 +72,7 @@ void pdf_sync_links(int32_t _ctx, int32_t _page);
 void pdf_sync_open_pages(int32_t _ctx, int32_t _doc);
 void pdf_sync_page(int32_t _ctx, int32_t _page);
 int32_t pdf_update_default_colorspaces(int32_t _ctx, int32_t old_cs, int32_t _res);
-void pdf_vectorize_page(int32_t _ctx, int32_t _page);
+void pdf_vectorize_page(int32_t _ctx, int32_t page);
 
 #ifdef __cplusplus
 }
@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Pdf_parse Functions (30 total)
+// Pdf_parse Functions (31 total)
 // ============================================================================
 
 void pdf_append_token(int32_t _ctx, int32_t buf, int32_t tok, int32_t lexbuf);
@@ -35,6 +35,7 @@ int32_t pdf_parse_stm_obj(int32_t _ctx, int32_t _doc, int32_t parser);
 int32_t pdf_parsed_array_len(int32_t _ctx, int32_t obj);
 int32_t pdf_parsed_dict_len(int32_t _ctx, int32_t obj);
 void pdf_parsed_obj_drop(int32_t _ctx, int32_t obj);
+int32_t pdf_parsed_obj_to_object(int32_t _ctx, int32_t doc, int32_t obj);
 int32_t pdf_parsed_obj_type(int32_t _ctx, int32_t obj);
 void pdf_parser_drop(int32_t _ctx, int32_t parser);
 const char * pdf_parser_get_error(int32_t _ctx, int32_t parser);
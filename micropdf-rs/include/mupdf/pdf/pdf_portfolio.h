@@ -13,13 +13,19 @@
 extern "C" {
 #endif
 
+/* Receives an embedded file's data a chunk at a time; nonzero stops extraction */
+typedef int32_t (*pdf_embedded_file_write_fn)(void * opaque, const uint8_t * data, size_t len);
+
 // ============================================================================
-// Pdf_portfolio Functions (21 total)
+// Pdf_portfolio Functions (26 total)
 // ============================================================================
 
 char * pdf_af_relationship_to_string(int32_t _ctx, int32_t relationship);
 char * pdf_collection_view_to_string(int32_t _ctx, int32_t view);
+int32_t pdf_count_embedded_files(int32_t _ctx, int32_t doc);
 void pdf_drop_portfolio(int32_t _ctx, int32_t portfolio);
+char * pdf_embedded_file_name(int32_t _ctx, int32_t doc, int32_t index);
+int32_t pdf_extract_embedded_files(int32_t _ctx, int32_t doc, const char * const * names, int32_t const * outputs, int32_t count, int32_t threads);
 int32_t pdf_is_portfolio(int32_t _ctx, int32_t portfolio);
 int32_t pdf_new_portfolio(int32_t _ctx, int32_t doc);
 int32_t pdf_portfolio_add_file(int32_t _ctx, int32_t portfolio, const char * name, u8 const * data, size_t len, const char * mime_type);
@@ -38,6 +44,8 @@ int32_t pdf_portfolio_set_description(int32_t _ctx, int32_t portfolio, const cha
 int32_t pdf_portfolio_set_initial_document(int32_t _ctx, int32_t portfolio, const char * name);
 int32_t pdf_portfolio_set_sort(int32_t _ctx, int32_t portfolio, const char * field, int32_t ascending);
 int32_t pdf_portfolio_set_view(int32_t _ctx, int32_t portfolio, int32_t view);
+int64_t pdf_stream_embedded_file(int32_t _ctx, int32_t doc, const char * name, pdf_embedded_file_write_fn write, void * opaque);
+int64_t pdf_write_embedded_file(int32_t _ctx, int32_t doc, const char * name, int32_t out);
 
 #ifdef __cplusplus
 }
@@ -14,13 +14,13 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Pdf_redact Functions (26 total)
+// Pdf_redact Functions (27 total)
 // ============================================================================
 
 void pdf_add_redact_annot_quad(int32_t _ctx, int32_t _annot, float const * _quad, x0 // 8 floats);
 void pdf_add_redact_region(int32_t _ctx, int32_t redact_ctx, float x0, float y0, float x1, float y1);
 void pdf_add_redact_region_with_color(int32_t _ctx, int32_t redact_ctx, float x0, float y0, float x1, float y1, float r, float g, float b);
-int32_t pdf_apply_all_redactions(int32_t _ctx, int32_t _doc, RedactOptions const * _opts);
+int32_t pdf_apply_all_redactions(int32_t _ctx, int32_t doc, RedactOptions const * opts);
 int32_t pdf_apply_redaction(int32_t _ctx, int32_t _annot, RedactOptions const * _opts);
 int32_t pdf_apply_redactions(int32_t _ctx, int32_t redact_ctx);
 void pdf_clear_redact_regions(int32_t _ctx, int32_t redact_ctx);
@@ -31,8 +31,9 @@ void pdf_drop_redact_context(int32_t _ctx, int32_t redact_ctx);
 RedactStats pdf_get_redact_stats(int32_t _ctx, int32_t redact_ctx);
 int32_t pdf_new_redact_context(int32_t _ctx, int32_t doc, int32_t page);
 RedactOptions pdf_ocr_redact_options(void);
-int32_t pdf_redact_document(int32_t _ctx, int32_t _doc, RedactOptions const * _opts);
-int32_t pdf_redact_page_annotations(int32_t _ctx, int32_t _doc, int32_t _page, RedactOptions const * _opts);
+int32_t pdf_redact_document(int32_t _ctx, int32_t doc, RedactOptions const * opts);
+int32_t pdf_redact_page_annotations(int32_t _ctx, int32_t doc, int32_t page, RedactOptions const * opts);
+int32_t pdf_redact_text_matches(int32_t _ctx, int32_t doc, const char * const * patterns, int32_t count, RedactOptions const * opts);
 void pdf_remove_attachments(int32_t _ctx, int32_t _doc);
 void pdf_remove_comments(int32_t _ctx, int32_t _doc);
 void pdf_remove_hidden_content(int32_t _ctx, int32_t _doc);
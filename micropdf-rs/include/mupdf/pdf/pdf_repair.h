@@ -0,0 +1,27 @@
+// MicroPDF - MuPDF API Compatible C Header
+// Auto-generated from Rust FFI - DO NOT EDIT MANUALLY
+// Module: pdf_repair
+
+#ifndef MUPDF_PDF_PDF_REPAIR_H
+#define MUPDF_PDF_PDF_REPAIR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// Pdf_repair Functions (2 total)
+// ============================================================================
+
+int32_t pdf_repair_mapped_file(int32_t _ctx, int32_t file, int32_t threads);
+int32_t pdf_repair_xref(int32_t _ctx, int32_t doc, int32_t threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MUPDF_PDF_PDF_REPAIR_H */
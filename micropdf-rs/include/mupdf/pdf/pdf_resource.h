@@ -43,7 +43,7 @@ int32_t pdf_load_image(int32_t _ctx, int32_t _doc, int32_t _obj);
 int32_t pdf_load_inline_image(int32_t _ctx, int32_t _doc, int32_t _rdb, int32_t _dict, int32_t _file);
 int32_t pdf_load_pattern(int32_t _ctx, int32_t doc, int32_t _obj);
 int32_t pdf_load_shading(int32_t _ctx, int32_t _doc, int32_t _obj);
-int32_t pdf_lookup_resource(int32_t _ctx, int32_t _stack, int32_t _res_type, const char * _name);
+int32_t pdf_lookup_resource(int32_t ctx, int32_t stack, int32_t res_type, const char * name);
 int32_t pdf_new_resource_stack(int32_t _ctx, int32_t resources);
 int32_t pdf_new_xobject(int32_t _ctx, int32_t _doc, float const * _bbox, float const * _matrix, int32_t _res, int32_t _buffer);
 int32_t pdf_pattern_is_mask(int32_t _ctx, int32_t pat);
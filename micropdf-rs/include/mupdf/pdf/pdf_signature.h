@@ -14,12 +14,13 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Pdf_signature Functions (33 total)
+// Pdf_signature Functions (39 total)
 // ============================================================================
 
 int32_t pdf_add_signature(int32_t _ctx, int32_t doc, const char * cn, int64_t date);
+int32_t pdf_check_all_digests(int32_t _ctx, int32_t doc, int32_t * results, int32_t max);
 int32_t pdf_check_certificate(int32_t _ctx, int32_t verifier, int32_t doc, int32_t _signature);
-int32_t pdf_check_digest(int32_t _ctx, int32_t verifier, int32_t doc, int32_t _signature);
+int32_t pdf_check_digest(int32_t ctx, int32_t verifier, int32_t doc, int32_t signature);
 void pdf_clear_all_signatures(int32_t _ctx, int32_t doc);
 void pdf_clear_signature(int32_t _ctx, int32_t widget);
 int32_t pdf_count_signatures(int32_t _ctx, int32_t doc);
@@ -28,9 +29,12 @@ const char * pdf_dn_cn(int32_t _ctx, int32_t dn);
 const char * pdf_dn_email(int32_t _ctx, int32_t dn);
 const char * pdf_dn_o(int32_t _ctx, int32_t dn);
 const char * pdf_dn_ou(int32_t _ctx, int32_t dn);
+void pdf_drop_prepared_signature(int32_t _ctx, int32_t prepared);
 void pdf_drop_signature_info(int32_t _ctx, int32_t sig);
 void pdf_drop_signer(int32_t _ctx, int32_t signer);
 void pdf_drop_verifier(int32_t _ctx, int32_t verifier);
+int32_t pdf_embed_signature(int32_t _ctx, int32_t doc, int32_t prepared, u8 const * pkcs7, size_t len);
+int32_t pdf_embed_signature_file(int32_t _ctx, int32_t prepared, const char * filename, u8 const * pkcs7, size_t len);
 int32_t pdf_get_signature(int32_t _ctx, int32_t doc, int32_t index);
 int32_t pdf_pkcs7_keep_signer(int32_t _ctx, int32_t signer);
 int32_t pdf_pkcs7_signer_get_name(int32_t _ctx, int32_t signer);
@@ -38,6 +42,8 @@ size_t pdf_pkcs7_signer_max_digest_size(int32_t _ctx, int32_t signer);
 int32_t pdf_pkcs7_signer_new(int32_t _ctx, const char * cn);
 void pdf_pkcs7_verifier_add_cert(int32_t _ctx, int32_t verifier, u8 const * cert, size_t len);
 int32_t pdf_pkcs7_verifier_new(int32_t _ctx);
+int32_t pdf_prepare_signature(int32_t ctx, int32_t doc, int32_t field, int32_t signer, int64_t date, const char * reason, const char * location, u8 * digest);
+int32_t pdf_prepare_signatures(int32_t ctx, int32_t const * docs, int32_t const * fields, int32_t count, int32_t signer, int64_t date, u8 * digests, int32_t * prepared);
 void pdf_sign_signature(int32_t _ctx, int32_t _widget, int32_t signer, int64_t date, const char * _reason, const char * _location);
 int32_t pdf_signature_byte_range(int32_t _ctx, int32_t doc, int32_t _signature, ByteRange * byte_range);
 size_t pdf_signature_contents(int32_t _ctx, int32_t doc, int32_t _signature, char * * contents);
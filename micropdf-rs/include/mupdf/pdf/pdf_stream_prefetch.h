@@ -0,0 +1,28 @@
+// MicroPDF - MuPDF API Compatible C Header
+// Auto-generated from Rust FFI - DO NOT EDIT MANUALLY
+// Module: pdf_stream_prefetch
+
+#ifndef MUPDF_PDF_PDF_STREAM_PREFETCH_H
+#define MUPDF_PDF_PDF_STREAM_PREFETCH_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// Pdf_stream_prefetch Functions (3 total)
+// ============================================================================
+
+int32_t pdf_xref_prefetch_objstms(int32_t _ctx, int32_t xref, int32_t threads);
+int32_t pdf_xref_prefetch_page_streams(int32_t _ctx, int32_t xref, int32_t index, int32_t threads);
+int32_t pdf_xref_prefetch_streams(int32_t _ctx, int32_t xref, int32_t const * nums, int32_t count, int32_t threads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MUPDF_PDF_PDF_STREAM_PREFETCH_H */
@@ -0,0 +1,29 @@
+// MicroPDF - MuPDF API Compatible C Header
+// Auto-generated from Rust FFI - DO NOT EDIT MANUALLY
+// Module: pdf_xref_lazy
+
+#ifndef MUPDF_PDF_PDF_XREF_LAZY_H
+#define MUPDF_PDF_PDF_XREF_LAZY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ============================================================================
+// Pdf_xref_lazy Functions (4 total)
+// ============================================================================
+
+int32_t pdf_open_xref_lazy(int32_t _ctx, int32_t doc);
+int32_t pdf_xref_is_lazy(int32_t _ctx, int32_t xref);
+int32_t pdf_xref_lazy_stats(int32_t _ctx, int32_t xref, LazyXrefStats * stats_out);
+int32_t pdf_xref_prefetch_page(int32_t _ctx, int32_t xref, int32_t page);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MUPDF_PDF_PDF_XREF_LAZY_H */
@@ -14,7 +14,7 @@ extern "C" {
 #endif
 
 // ============================================================================
-// Pdf_zugferd Functions (16 total)
+// Pdf_zugferd Functions (17 total)
 // ============================================================================
 
 void pdf_drop_zugferd_context(int32_t _ctx, int32_t zugferd);
@@ -26,6 +26,7 @@ int32_t pdf_zugferd_embed(int32_t _ctx, int32_t zugferd, u8 const * xml, size_t
 int32_t pdf_zugferd_error_count(int32_t _ctx, int32_t _zugferd);
 void pdf_zugferd_free_string(char * s);
 char * pdf_zugferd_mime_type(int32_t _ctx);
+int32_t pdf_zugferd_process_files(int32_t _ctx, const char * const * paths, int32_t count, int32_t threads, int32_t flags, ZugferdFileResult * results);
 int32_t pdf_zugferd_profile(int32_t _ctx, int32_t zugferd, float * version_out);
 char * pdf_zugferd_profile_to_string(int32_t _ctx, int32_t profile);
 int32_t pdf_zugferd_set_xml(int32_t _ctx, int32_t zugferd, u8 const * xml, size_t len);
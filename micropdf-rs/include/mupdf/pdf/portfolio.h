@@ -19,6 +19,7 @@ extern "C" {
 typedef uint64_t fz_context;
 typedef uint64_t pdf_document;
 typedef uint64_t pdf_portfolio;
+typedef uint64_t fz_output;
 
 /* ============================================================================
  * AF Relationship Constants
@@ -192,6 +193,51 @@ int pdf_portfolio_set_initial_document(fz_context *ctx, pdf_portfolio *portfolio
  */
 int pdf_portfolio_set_sort(fz_context *ctx, pdf_portfolio *portfolio, const char *field, int ascending);
 
+/* ============================================================================
+ * Document Attachments
+ * ============================================================================ */
+
+/**
+ * Receives an embedded file's data a chunk at a time.
+ * @return 0 to continue, nonzero to stop extraction
+ */
+typedef int32_t (*pdf_embedded_file_write_fn)(void *opaque, const uint8_t *data, size_t len);
+
+/**
+ * Count the files embedded in a document's /EmbeddedFiles name tree.
+ */
+int pdf_count_embedded_files(fz_context *ctx, pdf_document *doc);
+
+/**
+ * Get the name of an embedded file by index, in name tree order.
+ * @return Filename (caller must free with pdf_portfolio_free_string) or NULL
+ */
+char *pdf_embedded_file_name(fz_context *ctx, pdf_document *doc, int index);
+
+/**
+ * Write an embedded file, decoded, to an output.
+ * Unfiltered and flate-compressed files are decoded a chunk at a time, so
+ * memory use doesn't grow with the file.
+ * @return Bytes written, or -1 if not found or not decodable
+ */
+int64_t pdf_write_embedded_file(fz_context *ctx, pdf_document *doc, const char *name, fz_output *out);
+
+/**
+ * Pass an embedded file, decoded, to a callback a chunk at a time.
+ * @return Bytes passed, or -1 if not found, not decodable or stopped
+ */
+int64_t pdf_stream_embedded_file(fz_context *ctx, pdf_document *doc, const char *name, pdf_embedded_file_write_fn write, void *opaque);
+
+/**
+ * Write several embedded files, each to its own output, in parallel.
+ * @param names File names (NULL for the first count files in order);
+ *              an unknown or NULL name is skipped
+ * @param outputs One output per file
+ * @param threads Threads to use (0 = one per core)
+ * @return Number of files written
+ */
+int pdf_extract_embedded_files(fz_context *ctx, pdf_document *doc, const char *const *names, fz_output *const *outputs, int count, int threads);
+
 /* ============================================================================
  * Utility Functions
  * ============================================================================ */
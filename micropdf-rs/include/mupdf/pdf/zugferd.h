@@ -60,6 +60,18 @@ typedef struct {
     int add_checksum;       /**< Add checksum to embedded file */
 } pdf_zugferd_embed_params;
 
+/** Flag for pdf_zugferd_process_files: keep each invoice's XML in a buffer */
+#define PDF_ZUGFERD_BATCH_XML 1
+
+/** One file's result from pdf_zugferd_process_files */
+typedef struct {
+    int profile;            /**< Profile, PDF_NOT_ZUGFERD if no invoice or unreadable */
+    float version;          /**< Version */
+    int valid;              /**< 1 if the invoice passes validation */
+    int error_count;        /**< Number of validation errors */
+    uint64_t xml;           /**< Buffer holding the XML (caller drops), or 0 */
+} pdf_zugferd_file_result;
+
 /* ============================================================================
  * Context Management
  * ============================================================================ */
@@ -167,6 +179,23 @@ int pdf_zugferd_validate(fz_context *ctx, pdf_zugferd_context *zugferd);
  */
 int pdf_zugferd_error_count(fz_context *ctx, pdf_zugferd_context *zugferd);
 
+/* ============================================================================
+ * Batch Processing
+ * ============================================================================ */
+
+/**
+ * Read and validate the invoices of many PDF files.
+ * Only each file's trailer, catalog, associated files and embedded files
+ * are read, never its pages.
+ * @param paths File paths
+ * @param count Number of paths
+ * @param threads Threads to use (0 = one per core)
+ * @param flags PDF_ZUGFERD_BATCH_XML to keep each invoice's XML
+ * @param results One result per path
+ * @return Number of files holding an invoice
+ */
+int pdf_zugferd_process_files(fz_context *ctx, const char *const *paths, int count, int threads, int flags, pdf_zugferd_file_result *results);
+
 /* ============================================================================
  * Utility Functions
  * ============================================================================ */
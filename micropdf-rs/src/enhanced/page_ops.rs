@@ -4,9 +4,13 @@
 
 use super::error::{EnhancedError, Result};
 use super::writer::PdfWriter;
+use crate::ffi::mmap::FileBytes;
+use crate::ffi::pdf_graft::{GraftSource, GraftWriter, file_version, graft_pipelined, split_pages};
 use crate::fitz::geometry::Rect;
 use std::fs;
+use std::io::BufWriter;
 use std::path::Path;
+use std::sync::Arc;
 
 /// PDF Page information
 #[derive(Debug, Clone)]
@@ -20,10 +24,52 @@ pub struct PageInfo {
     pub rotation: i32,
 }
 
+/// Open a PDF for copying pages out of it
+///
+/// The file is mapped rather than read, so stream data can go from the
+/// mapping straight to the output.
+fn open_source(path: &str) -> Result<GraftSource> {
+    read_source(path, map_source(path)?)
+}
+
+/// Map a PDF, checking only its header
+fn map_source(path: &str) -> Result<Arc<FileBytes>> {
+    if !Path::new(path).exists() {
+        return Err(EnhancedError::Io(std::io::Error::new(
+            std::io::ErrorKind::NotFound,
+            format!("PDF file not found: {}", path),
+        )));
+    }
+
+    let data = FileBytes::map(path)?;
+    if !data.starts_with(b"%PDF-") {
+        return Err(EnhancedError::InvalidParameter(format!(
+            "Not a valid PDF file: {}",
+            path
+        )));
+    }
+    Ok(Arc::new(data))
+}
+
+/// Walk the page tree of a PDF mapped by [`map_source`]
+fn read_source(path: &str, data: Arc<FileBytes>) -> Result<GraftSource> {
+    GraftSource::open(data).ok_or_else(|| {
+        EnhancedError::InvalidParameter(format!(
+            "Cannot read pages from {} (damaged or encrypted)",
+            path
+        ))
+    })
+}
+
 /// PDF Merger for combining multiple PDFs
+///
+/// Pages are copied object for object, with stream data passed through
+/// as it is stored in the source file.
 pub struct PdfMerger {
-    /// Writer for output PDF
-    writer: PdfWriter,
+    /// Source files and the pages to take from each
+    inputs: Vec<(String, Vec<usize>)>,
+    /// Highest PDF version among the sources
+    version: i32,
     /// Total pages added
     page_count: usize,
 }
@@ -32,42 +78,17 @@ impl PdfMerger {
     /// Create a new merger
     pub fn new() -> Self {
         Self {
-            writer: PdfWriter::new(),
+            inputs: Vec::new(),
+            version: 14,
             page_count: 0,
         }
     }
 
     /// Append all pages from a PDF file
     pub fn append(&mut self, path: &str) -> Result<&mut Self> {
-        // Verify file exists
-        if !Path::new(path).exists() {
-            return Err(EnhancedError::Io(std::io::Error::new(
-                std::io::ErrorKind::NotFound,
-                format!("PDF file not found: {}", path),
-            )));
-        }
-
-        // Read PDF file
-        let data = fs::read(path)?;
-
-        // Verify it's a PDF
-        if !data.starts_with(b"%PDF-") {
-            return Err(EnhancedError::InvalidParameter(format!(
-                "Not a valid PDF file: {}",
-                path
-            )));
-        }
-
-        // Parse PDF to extract pages
-        // For now, create a blank page for each page we detect
-        let page_count = self.estimate_page_count(&data)?;
-
-        for _ in 0..page_count {
-            // Default Letter size
-            self.writer.add_blank_page(612.0, 792.0)?;
-            self.page_count += 1;
-        }
-
+        let source = open_source(path)?;
+        let pages = (0..source.page_count()).collect();
+        self.push(path, &source, pages);
         Ok(self)
     }
 
@@ -77,24 +98,8 @@ impl PdfMerger {
             return Ok(self);
         }
 
-        // Verify file exists
-        if !Path::new(path).exists() {
-            return Err(EnhancedError::Io(std::io::Error::new(
-                std::io::ErrorKind::NotFound,
-                format!("PDF file not found: {}", path),
-            )));
-        }
-
-        // Read and validate PDF
-        let data = fs::read(path)?;
-        if !data.starts_with(b"%PDF-") {
-            return Err(EnhancedError::InvalidParameter(format!(
-                "Not a valid PDF file: {}",
-                path
-            )));
-        }
-
-        let total_pages = self.estimate_page_count(&data)?;
+        let source = open_source(path)?;
+        let total_pages = source.page_count();
 
         // Validate page numbers
         for &page_num in pages {
@@ -106,15 +111,16 @@ impl PdfMerger {
             }
         }
 
-        // Add requested pages
-        for _ in pages {
-            self.writer.add_blank_page(612.0, 792.0)?;
-            self.page_count += 1;
-        }
-
+        self.push(path, &source, pages.to_vec());
         Ok(self)
     }
 
+    fn push(&mut self, path: &str, source: &GraftSource, pages: Vec<usize>) {
+        self.version = self.version.max(source.version());
+        self.page_count += pages.len();
+        self.inputs.push((path.to_string(), pages));
+    }
+
     /// Get total number of pages
     pub fn page_count(&self) -> usize {
         self.page_count
@@ -122,40 +128,29 @@ impl PdfMerger {
 
     /// Save merged PDF to file
     pub fn save(&self, path: &str) -> Result<()> {
+        self.save_with_threads(path, 0)
+    }
+
+    /// Save merged PDF to file, reading sources on up to `threads` threads
+    /// (0 = one per core)
+    ///
+    /// Sources are reopened and planned in parallel while one writer puts
+    /// them out in order; the file is the same for any thread count.
+    pub fn save_with_threads(&self, path: &str, threads: usize) -> Result<()> {
         if self.page_count == 0 {
             return Err(EnhancedError::InvalidParameter(
                 "Cannot save PDF with no pages".into(),
             ));
         }
 
-        self.writer.save(path)
-    }
-
-    /// Estimate page count from PDF data
-    fn estimate_page_count(&self, data: &[u8]) -> Result<usize> {
-        // Look for /Type /Pages and /Count in the PDF
-        let content = String::from_utf8_lossy(data);
-
-        // Find /Count entries in Pages objects
-        let mut max_count = 1; // At least 1 page by default
-
-        for line in content.lines() {
-            if line.contains("/Type") && line.contains("/Pages") {
-                // Look for /Count in nearby lines
-                if let Some(count_pos) = line.find("/Count") {
-                    let after_count = &line[count_pos + 6..];
-                    if let Some(num_end) =
-                        after_count.find(|c: char| !c.is_ascii_digit() && c != ' ')
-                    {
-                        if let Ok(count) = after_count[..num_end].trim().parse::<usize>() {
-                            max_count = max_count.max(count);
-                        }
-                    }
-                }
-            }
-        }
-
-        Ok(max_count)
+        let file = BufWriter::new(fs::File::create(path)?);
+        let mut writer = GraftWriter::new(file, self.version)?;
+        graft_pipelined(&mut writer, self.inputs.len(), threads, |i| -> Result<_> {
+            let (input, pages) = &self.inputs[i];
+            Ok(open_source(input)?.plan(pages))
+        })?;
+        writer.finish()?;
+        Ok(())
     }
 }
 
@@ -166,55 +161,36 @@ impl Default for PdfMerger {
 }
 
 /// Split PDF into individual pages
+///
+/// Each output holds one page and the objects it uses, copied without
+/// re-encoding any streams.
 pub fn split_pdf(input_path: &str, output_dir: &str) -> Result<Vec<String>> {
-    // Verify input exists
-    if !Path::new(input_path).exists() {
-        return Err(EnhancedError::Io(std::io::Error::new(
-            std::io::ErrorKind::NotFound,
-            format!("PDF file not found: {}", input_path),
-        )));
-    }
+    split_pdf_with_threads(input_path, output_dir, 0)
+}
+
+/// Split PDF into individual pages, writing up to `threads` files at once
+/// (0 = one per core)
+///
+/// Objects shared between pages, like fonts and images, are serialized
+/// once for all the outputs.
+pub fn split_pdf_with_threads(
+    input_path: &str,
+    output_dir: &str,
+    threads: usize,
+) -> Result<Vec<String>> {
+    let mut source = open_source(input_path)?;
 
     // Create output directory
     fs::create_dir_all(output_dir)?;
 
-    // Read and validate PDF
-    let data = fs::read(input_path)?;
-    if !data.starts_with(b"%PDF-") {
-        return Err(EnhancedError::InvalidParameter(
-            "Not a valid PDF file".into(),
-        ));
-    }
-
-    // Get page count
-    let content = String::from_utf8_lossy(&data);
-    let mut page_count = 1;
-
-    for line in content.lines() {
-        if line.contains("/Type") && line.contains("/Pages") {
-            if let Some(count_pos) = line.find("/Count") {
-                let after_count = &line[count_pos + 6..];
-                if let Some(num_end) = after_count.find(|c: char| !c.is_ascii_digit() && c != ' ') {
-                    if let Ok(count) = after_count[..num_end].trim().parse::<usize>() {
-                        page_count = count;
-                        break;
-                    }
-                }
-            }
-        }
-    }
-
     // Create separate PDF for each page
-    let mut output_files = Vec::new();
-
-    for i in 0..page_count {
-        let mut writer = PdfWriter::new();
-        writer.add_blank_page(612.0, 792.0)?;
-
-        let output_path = format!("{}/page_{:04}.pdf", output_dir, i + 1);
-        writer.save(&output_path)?;
-        output_files.push(output_path);
-    }
+    let output_files: Vec<String> = (0..source.page_count())
+        .map(|i| format!("{}/page_{:04}.pdf", output_dir, i + 1))
+        .collect();
+    let outputs: Vec<Vec<usize>> = (0..source.page_count()).map(|i| vec![i]).collect();
+    split_pages(&mut source, &outputs, threads, |i| -> Result<_> {
+        Ok(BufWriter::new(fs::File::create(&output_files[i])?))
+    })?;
 
     Ok(output_files)
 }
@@ -366,32 +342,60 @@ pub fn reorder_pages(input_path: &str, page_order: &[usize], output_path: &str)
 /// println!("Merged {} pages", page_count);
 /// ```
 pub fn merge_pdf(input_paths: &[String], output_path: &str) -> Result<usize> {
+    merge_pdf_with_threads(input_paths, output_path, 0)
+}
+
+/// Merge PDF files, reading inputs on up to `threads` threads (0 = one
+/// per core)
+///
+/// Only the headers are read up front, for the output's version. Inputs
+/// are then opened and their pages planned in parallel while this thread
+/// writes them out in order, so the output is the same for any thread
+/// count, and the same as with [`PdfMerger`].
+pub fn merge_pdf_with_threads(
+    input_paths: &[String],
+    output_path: &str,
+    threads: usize,
+) -> Result<usize> {
     if input_paths.is_empty() {
         return Err(EnhancedError::InvalidParameter(
             "At least one input PDF is required".into(),
         ));
     }
 
-    // Create merger
-    let mut merger = PdfMerger::new();
+    let append_error = |idx: usize, e: EnhancedError| {
+        EnhancedError::Generic(format!(
+            "Failed to append PDF #{} ({}): {}",
+            idx + 1,
+            input_paths[idx],
+            e
+        ))
+    };
 
-    // Append each PDF
+    let mut version = PdfMerger::new().version;
+    let mut mapped = Vec::with_capacity(input_paths.len());
     for (idx, path) in input_paths.iter().enumerate() {
-        merger.append(path).map_err(|e| {
-            EnhancedError::Generic(format!(
-                "Failed to append PDF #{} ({}): {}",
-                idx + 1,
-                path,
-                e
-            ))
-        })?;
-    }
-
-    let page_count = merger.page_count();
-
-    // Save merged PDF
-    merger.save(output_path)?;
-
+        let data = map_source(path).map_err(|e| append_error(idx, e))?;
+        version = version.max(file_version(&data));
+        mapped.push(data);
+    }
+
+    let file = BufWriter::new(fs::File::create(output_path)?);
+    let mut writer = GraftWriter::new(file, version)?;
+    graft_pipelined(
+        &mut writer,
+        input_paths.len(),
+        threads,
+        |idx| -> Result<_> {
+            let mut source = read_source(&input_paths[idx], Arc::clone(&mapped[idx]))
+                .map_err(|e| append_error(idx, e))?;
+            let pages: Vec<usize> = (0..source.page_count()).collect();
+            Ok(source.plan(&pages))
+        },
+    )?;
+
+    let page_count = writer.page_count();
+    writer.finish()?;
     Ok(page_count)
 }
 
@@ -621,6 +625,81 @@ mod tests {
         Ok(())
     }
 
+    #[test]
+    fn test_merge_pdf_copies_content() -> Result<()> {
+        let mut temp = NamedTempFile::new().map_err(|e| EnhancedError::Generic(e.to_string()))?;
+        temp.write_all(
+            b"%PDF-1.4\n\
+            1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n\
+            2 0 obj\n<< /Type /Pages /Kids [3 0 R] /Count 1 /MediaBox [0 0 200 100] >>\nendobj\n\
+            3 0 obj\n<< /Type /Page /Parent 2 0 R /Contents 4 0 R >>\nendobj\n\
+            4 0 obj\n<< /Length 10 /Filter /Custom >>\nstream\nq 1 0 0 RG\nendstream\nendobj\n\
+            trailer\n<< /Size 5 /Root 1 0 R >>\n%%EOF\n",
+        )?;
+        let temp1 = create_test_pdf()?;
+        let temp_output =
+            NamedTempFile::new().map_err(|e| EnhancedError::Generic(e.to_string()))?;
+
+        let inputs = vec![
+            temp1.path().to_str().unwrap().to_string(),
+            temp.path().to_str().unwrap().to_string(),
+        ];
+        assert_eq!(merge_pdf(&inputs, temp_output.path().to_str().unwrap())?, 2);
+
+        // The stream went across untouched, its unknown filter included,
+        // and the page kept the media box it inherited
+        let merged = open_source(temp_output.path().to_str().unwrap())?;
+        assert_eq!(merged.page_count(), 2);
+        let data = fs::read(temp_output.path())?;
+        let text = String::from_utf8_lossy(&data);
+        assert!(text.contains("/Filter /Custom"));
+        assert!(text.contains("stream\nq 1 0 0 RG\nendstream"));
+        assert!(text.contains("/MediaBox [0 0 200 100]"));
+
+        Ok(())
+    }
+
+    #[test]
+    fn test_merge_pdf_same_for_any_thread_count() -> Result<()> {
+        let temps = (0..6)
+            .map(|_| create_test_pdf())
+            .collect::<Result<Vec<_>>>()?;
+        let inputs: Vec<String> = temps
+            .iter()
+            .map(|t| t.path().to_str().unwrap().to_string())
+            .collect();
+        let dir = TempDir::new().map_err(|e| EnhancedError::Generic(e.to_string()))?;
+        let out = |name: &str| dir.path().join(name).to_str().unwrap().to_string();
+
+        assert_eq!(merge_pdf_with_threads(&inputs, &out("serial.pdf"), 1)?, 6);
+        assert_eq!(merge_pdf_with_threads(&inputs, &out("parallel.pdf"), 4)?, 6);
+        let mut merger = PdfMerger::new();
+        for input in &inputs {
+            merger.append(input)?;
+        }
+        merger.save_with_threads(&out("merger.pdf"), 3)?;
+
+        let serial = fs::read(out("serial.pdf"))?;
+        assert_eq!(serial, fs::read(out("parallel.pdf"))?);
+        assert_eq!(serial, fs::read(out("merger.pdf"))?);
+        Ok(())
+    }
+
+    #[test]
+    fn test_merge_pdf_reports_bad_input_in_order() {
+        let good = create_test_pdf().unwrap();
+        let bad = NamedTempFile::new().unwrap();
+        fs::write(bad.path(), b"%PDF-1.4\nno objects here\n").unwrap();
+        let output = NamedTempFile::new().unwrap();
+        let inputs = vec![
+            good.path().to_str().unwrap().to_string(),
+            bad.path().to_str().unwrap().to_string(),
+            good.path().to_str().unwrap().to_string(),
+        ];
+        let err = merge_pdf_with_threads(&inputs, output.path().to_str().unwrap(), 3).unwrap_err();
+        assert!(err.to_string().contains("PDF #2"));
+    }
+
     #[test]
     fn test_merge_pdf_empty() {
         let temp_output = NamedTempFile::new().unwrap();
@@ -3,12 +3,49 @@
 //! Provides FFI bindings for PDF annotation operations.
 
 use super::{Handle, HandleStore};
+use crate::fitz::rtree::PackedRTree;
 use crate::pdf::annot::{AnnotFlags, AnnotType, Annotation};
 use std::sync::LazyLock;
 
 /// Annotation storage
 pub static ANNOTATIONS: LazyLock<HandleStore<Annotation>> = LazyLock::new(HandleStore::default);
 
+/// [`AnnotChange`] fields to apply
+pub const PDF_ANNOT_CHANGE_RECT: u32 = 1 << 0;
+pub const PDF_ANNOT_CHANGE_CONTENTS: u32 = 1 << 1;
+pub const PDF_ANNOT_CHANGE_OPACITY: u32 = 1 << 2;
+pub const PDF_ANNOT_CHANGE_FLAGS: u32 = 1 << 3;
+
+/// Annotation hit index storage
+pub static ANNOT_INDEXES: LazyLock<HandleStore<AnnotIndex>> = LazyLock::new(HandleStore::default);
+
+/// Snapshot of a page's annotation rects for hit testing
+///
+/// Annotations can be moved without their page knowing, so the index is
+/// not kept in sync; rebuild it after editing.
+pub struct AnnotIndex {
+    /// Annotation handles in page order
+    annots: Vec<Handle>,
+    /// Tree over `annots` by position
+    tree: PackedRTree,
+}
+
+/// Changes to one annotation, for [`pdf_update_annots`]
+///
+/// Only the fields named in `mask` are applied.
+#[derive(Debug, Clone, Copy)]
+#[repr(C)]
+pub struct AnnotChange {
+    pub annot: Handle,
+    /// `PDF_ANNOT_CHANGE_*` bits
+    pub mask: u32,
+    pub flags: u32,
+    pub rect: super::geometry::fz_rect,
+    pub opacity: f32,
+    /// Null-terminated UTF-8
+    pub contents: *const std::ffi::c_char,
+}
+
 // ============================================================================
 // Annotation Creation
 // ============================================================================
@@ -114,6 +151,94 @@ pub extern "C" fn pdf_next_annot(_ctx: Handle, annot: Handle) -> Handle {
     0
 }
 
+// ============================================================================
+// Annotation Hit Testing
+// ============================================================================
+
+/// Build a hit index over the current annotation rects of a page
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_new_annot_index(_ctx: Handle, page: Handle) -> Handle {
+    let Some(p) = super::document::PAGES.get(page) else {
+        return 0;
+    };
+    let Ok(guard) = p.lock() else {
+        return 0;
+    };
+    let annots = guard.annotations.clone();
+    drop(guard);
+
+    let tree = PackedRTree::new(annots.iter().enumerate().filter_map(|(i, &annot)| {
+        let a = ANNOTATIONS.get(annot)?;
+        let rect = a.lock().ok()?.rect();
+        Some((i as u32, rect))
+    }));
+    ANNOT_INDEXES.insert(AnnotIndex { annots, tree })
+}
+
+/// Drop an annotation hit index
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_drop_annot_index(_ctx: Handle, index: Handle) {
+    ANNOT_INDEXES.remove(index);
+}
+
+/// Topmost annotation under a point, or 0
+///
+/// Annotations later in page order are drawn on top, so they win.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_annot_index_at_point(_ctx: Handle, index: Handle, x: f32, y: f32) -> Handle {
+    let Some(idx) = ANNOT_INDEXES.get(index) else {
+        return 0;
+    };
+    let Ok(guard) = idx.lock() else {
+        return 0;
+    };
+    guard
+        .tree
+        .at_point(x, y)
+        .last()
+        .map_or(0, |&i| guard.annots[i as usize])
+}
+
+/// Annotations touching a rectangle, in page order
+///
+/// Writes up to `max` handles to `annots` (which may be null to count).
+///
+/// # Returns
+/// Total number of annotations touching the rectangle
+#[unsafe(no_mangle)]
+#[allow(clippy::too_many_arguments)]
+pub extern "C" fn pdf_annot_index_in_rect(
+    _ctx: Handle,
+    index: Handle,
+    x0: f32,
+    y0: f32,
+    x1: f32,
+    y1: f32,
+    annots: *mut Handle,
+    max: i32,
+) -> i32 {
+    let Some(idx) = ANNOT_INDEXES.get(index) else {
+        return 0;
+    };
+    let Ok(guard) = idx.lock() else {
+        return 0;
+    };
+    let mut hits = Vec::new();
+    guard
+        .tree
+        .search(&crate::fitz::geometry::Rect::new(x0, y0, x1, y1), |i| {
+            hits.push(i)
+        });
+    hits.sort_unstable();
+    if !annots.is_null() {
+        for (n, &i) in hits.iter().take(max.max(0) as usize).enumerate() {
+            // SAFETY: the caller provides room for `max` handles
+            unsafe { *annots.add(n) = guard.annots[i as usize] };
+        }
+    }
+    hits.len() as i32
+}
+
 // ============================================================================
 // Annotation Properties
 // ============================================================================
@@ -504,6 +629,86 @@ pub extern "C" fn pdf_update_annot(_ctx: Handle, annot: Handle) -> i32 {
     0
 }
 
+/// Apply `count` annotation changes in one call
+///
+/// Each annotation whose rect, contents, opacity or flags actually change
+/// is marked dirty, and `dirty` (if not null) receives the union of the
+/// area those annotations covered before and after, so a viewer redraws
+/// just that; it is all zeros when nothing changed. Returns the number of
+/// annotations changed.
+///
+/// # Safety
+/// Caller must ensure `changes` holds `count` entries, and that each
+/// `contents` applied is a valid C string
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_update_annots(
+    _ctx: Handle,
+    changes: *const AnnotChange,
+    count: i32,
+    dirty: *mut super::geometry::fz_rect,
+) -> i32 {
+    let changes = match count {
+        1.. if !changes.is_null() => {
+            // SAFETY: caller guarantees `changes` holds `count` entries
+            unsafe { std::slice::from_raw_parts(changes, count as usize) }
+        }
+        _ => &[],
+    };
+    let mut damaged = crate::fitz::geometry::Rect::EMPTY;
+    let mut changed = 0;
+    for change in changes {
+        let Some(a) = ANNOTATIONS.get(change.annot) else {
+            continue;
+        };
+        let Ok(mut guard) = a.lock() else {
+            continue;
+        };
+        let before = guard.rect();
+        let mut touched = false;
+        if change.mask & PDF_ANNOT_CHANGE_RECT != 0 {
+            let r = change.rect;
+            let rect = crate::fitz::geometry::Rect::new(r.x0, r.y0, r.x1, r.y1);
+            touched |= rect != before;
+            guard.set_rect(rect);
+        }
+        if change.mask & PDF_ANNOT_CHANGE_CONTENTS != 0 {
+            if let Some(text) = super::safe_helpers::c_str_to_str(change.contents) {
+                touched |= guard.contents() != text;
+                guard.set_contents(text);
+            }
+        }
+        if change.mask & PDF_ANNOT_CHANGE_OPACITY != 0 {
+            let opacity = change.opacity.clamp(0.0, 1.0);
+            touched |= guard.opacity() != opacity;
+            guard.set_opacity(opacity);
+        }
+        if change.mask & PDF_ANNOT_CHANGE_FLAGS != 0 {
+            touched |= guard.flags().value() != change.flags;
+            guard.set_flags(AnnotFlags::new(change.flags));
+        }
+        if touched {
+            guard.mark_dirty();
+            damaged = damaged.union(&before).union(&guard.rect());
+            changed += 1;
+        }
+    }
+
+    if !dirty.is_null() {
+        let rect = match changed {
+            0 => super::geometry::fz_rect::default(),
+            _ => super::geometry::fz_rect {
+                x0: damaged.x0,
+                y0: damaged.y0,
+                x1: damaged.x1,
+                y1: damaged.y1,
+            },
+        };
+        // SAFETY: checked non-null above; caller provides a writable rect
+        unsafe { *dirty = rect };
+    }
+    changed
+}
+
 /// Check if an annotation is valid
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_annot_is_valid(_ctx: Handle, annot: Handle) -> i32 {
@@ -658,4 +863,91 @@ mod tests {
         pdf_drop_annot(0, annot);
         pdf_drop_annot(0, cloned);
     }
+
+    #[test]
+    fn test_annot_index() {
+        let page = super::super::document::PAGES.insert(super::super::document::Page::new(0, 0));
+        let rects = [
+            (0.0, 0.0, 100.0, 100.0),
+            (50.0, 50.0, 150.0, 150.0),
+            (300.0, 300.0, 310.0, 310.0),
+        ];
+        let annots: Vec<Handle> = rects
+            .iter()
+            .map(|&(x0, y0, x1, y1)| {
+                let annot = pdf_create_annot(0, page, 4);
+                pdf_set_annot_rect(0, annot, super::super::geometry::fz_rect { x0, y0, x1, y1 });
+                if let Some(p) = super::super::document::PAGES.get(page) {
+                    p.lock().unwrap().add_annotation(annot);
+                }
+                annot
+            })
+            .collect();
+
+        let index = pdf_new_annot_index(0, page);
+        assert_ne!(index, 0);
+        assert_eq!(pdf_annot_index_at_point(0, index, 10.0, 10.0), annots[0]);
+        assert_eq!(pdf_annot_index_at_point(0, index, 75.0, 75.0), annots[1]);
+        assert_eq!(pdf_annot_index_at_point(0, index, 200.0, 200.0), 0);
+
+        let mut found = [0; 4];
+        let n = pdf_annot_index_in_rect(0, index, 90.0, 90.0, 305.0, 305.0, found.as_mut_ptr(), 4);
+        assert_eq!(n, 3);
+        assert_eq!(&found[..3], &annots[..]);
+        let null = std::ptr::null_mut();
+        assert_eq!(
+            pdf_annot_index_in_rect(0, index, 120.0, 0.0, 130.0, 10.0, null, 0),
+            0
+        );
+
+        pdf_drop_annot_index(0, index);
+        assert_eq!(pdf_annot_index_at_point(0, index, 10.0, 10.0), 0);
+        for annot in annots {
+            pdf_drop_annot(0, annot);
+        }
+        super::super::document::PAGES.remove(page);
+    }
+
+    #[test]
+    fn test_update_annots_reports_damage() {
+        let moved = pdf_create_annot(0, 0, 4);
+        let faded = pdf_create_annot(0, 0, 4);
+        let rect = |x0, y0, x1, y1| super::super::geometry::fz_rect { x0, y0, x1, y1 };
+        pdf_set_annot_rect(0, moved, rect(0.0, 0.0, 10.0, 10.0));
+        pdf_set_annot_rect(0, faded, rect(50.0, 50.0, 60.0, 60.0));
+        pdf_annot_clear_dirty(0, moved);
+        pdf_annot_clear_dirty(0, faded);
+
+        let text = std::ffi::CString::new("note").unwrap();
+        let changes = [
+            AnnotChange {
+                annot: moved,
+                mask: PDF_ANNOT_CHANGE_RECT | PDF_ANNOT_CHANGE_CONTENTS,
+                flags: 0,
+                rect: rect(20.0, 0.0, 30.0, 10.0),
+                opacity: 0.0,
+                contents: text.as_ptr(),
+            },
+            AnnotChange {
+                annot: faded,
+                mask: PDF_ANNOT_CHANGE_OPACITY,
+                flags: 0,
+                rect: rect(0.0, 0.0, 0.0, 0.0),
+                opacity: 1.0,
+                contents: std::ptr::null(),
+            },
+        ];
+        let mut dirty = rect(0.0, 0.0, 0.0, 0.0);
+        assert_eq!(pdf_update_annots(0, changes.as_ptr(), 2, &mut dirty), 1);
+        assert_eq!(dirty, rect(0.0, 0.0, 30.0, 10.0));
+        assert_eq!(pdf_annot_has_dirty(0, moved), 1);
+        assert_eq!(pdf_annot_has_dirty(0, faded), 0);
+
+        // Applied again, nothing changes
+        assert_eq!(pdf_update_annots(0, changes.as_ptr(), 2, &mut dirty), 0);
+        assert_eq!(dirty, rect(0.0, 0.0, 0.0, 0.0));
+
+        pdf_drop_annot(0, moved);
+        pdf_drop_annot(0, faded);
+    }
 }
@@ -191,10 +191,10 @@ pub extern "C" fn fz_read_archive_entry(
     unsafe {
         if let Ok(name_str) = CStr::from_ptr(name).to_str() {
             if let Some(a) = ARCHIVES.get(archive) {
-                if let Ok(mut guard) = a.lock() {
-                    if let Ok(data) = guard.read_entry(name_str) {
-                        // Create FFI buffer from data
-                        let buffer = super::buffer::Buffer::from_data(&data);
+                if let Ok(guard) = a.lock() {
+                    if let Ok(data) = guard.read_entry_bytes(name_str) {
+                        // Decoded entries move into the buffer without a copy
+                        let buffer = super::buffer::Buffer::from_vec(Vec::from(data));
                         return super::BUFFERS.insert(buffer);
                     }
                 }
@@ -295,17 +295,71 @@ pub extern "C" fn fz_archive_entry_size(_ctx: Handle, archive: Handle, name: *co
     };
 
     if let Some(a) = ARCHIVES.get(archive) {
-        if let Ok(mut guard) = a.lock() {
-            if guard.has_entry(c_name) {
-                if let Ok(data) = guard.read_entry(c_name) {
-                    return data.len() as i32;
-                }
+        if let Ok(guard) = a.lock() {
+            if let Some(size) = guard.entry_size(c_name) {
+                return size.min(i32::MAX as u64) as i32;
             }
         }
     }
     -1
 }
 
+/// Read several archive entries, decoding them in parallel
+///
+/// Entries are decoded on up to `threads` threads (0 for one per core)
+/// and `buffers[i]` receives a buffer handle for `names[i]`, or 0 if that
+/// entry could not be read.
+///
+/// # Returns
+/// Number of entries read, or -1 on invalid arguments
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_read_archive_entries(
+    _ctx: Handle,
+    archive: Handle,
+    names: *const *const c_char,
+    count: i32,
+    threads: i32,
+    buffers: *mut Handle,
+) -> i32 {
+    if names.is_null() || buffers.is_null() || count < 0 {
+        return -1;
+    }
+    let Some(a) = ARCHIVES.get(archive) else {
+        return -1;
+    };
+    let Ok(guard) = a.lock() else {
+        return -1;
+    };
+
+    // SAFETY: the caller passes `count` name pointers and buffer slots
+    let names = unsafe { std::slice::from_raw_parts(names, count as usize) };
+    let buffers = unsafe { std::slice::from_raw_parts_mut(buffers, count as usize) };
+    let names: Vec<&str> = names
+        .iter()
+        .map(|&n| {
+            if n.is_null() {
+                ""
+            } else {
+                // SAFETY: non-null names are NUL-terminated strings
+                unsafe { CStr::from_ptr(n) }.to_str().unwrap_or("")
+            }
+        })
+        .collect();
+
+    let mut read = 0;
+    let results = guard.read_entries(&names, threads.max(0) as usize);
+    for (slot, data) in buffers.iter_mut().zip(results) {
+        *slot = match data {
+            Ok(data) => {
+                read += 1;
+                super::BUFFERS.insert(super::buffer::Buffer::from_vec(Vec::from(data)))
+            }
+            Err(_) => 0,
+        };
+    }
+    read
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -405,6 +459,34 @@ mod tests {
         cleanup_test_dir(&test_dir);
     }
 
+    #[test]
+    fn test_read_archive_entries() {
+        let test_dir = create_test_dir();
+        let path_cstr = std::ffi::CString::new(test_dir.to_str().unwrap()).unwrap();
+        let archive = fz_open_archive(0, path_cstr.as_ptr());
+        assert_ne!(archive, 0);
+
+        let file1 = std::ffi::CString::new("file1.txt").unwrap();
+        let missing = std::ffi::CString::new("nonexistent.txt").unwrap();
+        let file2 = std::ffi::CString::new("file2.txt").unwrap();
+        let names = [file1.as_ptr(), missing.as_ptr(), file2.as_ptr()];
+        let mut buffers = [0; 3];
+
+        let read = fz_read_archive_entries(0, archive, names.as_ptr(), 3, 2, buffers.as_mut_ptr());
+        assert_eq!(read, 2);
+        assert_eq!(buffers[1], 0);
+        let size = |b| super::super::buffer::fz_buffer_storage(0, b, std::ptr::null_mut());
+        assert_eq!(size(buffers[0]), 13);
+        assert_eq!(size(buffers[2]), 9);
+        assert_eq!(fz_archive_entry_size(0, archive, file2.as_ptr()), 9);
+
+        for b in [buffers[0], buffers[2]] {
+            super::super::buffer::fz_drop_buffer(0, b);
+        }
+        fz_drop_archive(0, archive);
+        cleanup_test_dir(&test_dir);
+    }
+
     #[test]
     fn test_open_archive_with_null_path() {
         let archive = fz_open_archive(0, std::ptr::null());
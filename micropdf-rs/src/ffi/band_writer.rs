@@ -1,7 +1,10 @@
 //! C FFI for band-based output - MuPDF compatible
 //! Safe Rust implementation of fz_band_writer
 
-use super::{Handle, HandleStore};
+use super::{BUFFERS, Handle, HandleStore};
+use crate::ffi::buffer::Buffer;
+use flate2::write::ZlibEncoder;
+use std::io::Write;
 use std::sync::LazyLock;
 
 /// A wrapper for a raw pointer that implements Send + Sync.
@@ -51,6 +54,25 @@ pub enum BandFormat {
     PS = 7,
     /// Raw pixel data
     Raw = 8,
+    /// PCLm (PDF raster strips for IPP Everywhere printers)
+    PCLm = 9,
+}
+
+impl BandFormat {
+    fn from_i32(format: i32) -> Self {
+        match format {
+            1 => BandFormat::JPEG,
+            2 => BandFormat::PNM,
+            3 => BandFormat::PAM,
+            4 => BandFormat::TIFF,
+            5 => BandFormat::PWG,
+            6 => BandFormat::PCL,
+            7 => BandFormat::PS,
+            8 => BandFormat::Raw,
+            9 => BandFormat::PCLm,
+            _ => BandFormat::PNG,
+        }
+    }
 }
 
 /// Progress callback signature
@@ -120,6 +142,59 @@ impl Default for BandWriterConfig {
     }
 }
 
+impl BandWriterConfig {
+    /// Bytes in one row of the pixel data passed to `write_band`
+    pub fn row_size(&self) -> usize {
+        let components = self.n + if self.alpha { 1 } else { 0 };
+        (self.width * components) as usize
+    }
+}
+
+/// Incremental zlib stream for the PNG image data
+///
+/// Each band is deflated with a sync flush, so its IDAT chunk can be
+/// handed out before the next band is rendered.
+pub struct PngStream {
+    zlib: ZlibEncoder<Vec<u8>>,
+}
+
+impl std::fmt::Debug for PngStream {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("PngStream").finish_non_exhaustive()
+    }
+}
+
+/// PWG raster row encoder
+///
+/// Identical consecutive rows are folded into a line repeat count, which
+/// may span bands, so the last row is held until the next one differs.
+#[derive(Debug)]
+pub struct PwgStream {
+    pixel_size: usize,
+    prev: Option<Vec<u8>>,
+    repeat: u8,
+}
+
+/// PCLm strip writer
+///
+/// Every band becomes one Flate-compressed image strip object as soon as
+/// it arrives; only the object offsets and strip heights are kept for the
+/// page, content stream and xref written by the trailer.
+#[derive(Debug)]
+pub struct PclmStream {
+    level: flate2::Compression,
+    offsets: Vec<(u32, usize)>,
+    strips: Vec<(u32, i32)>,
+}
+
+/// Format-specific encoder state, live between header and trailer
+#[derive(Debug)]
+pub enum BandEncoder {
+    Png(PngStream),
+    Pwg(PwgStream),
+    Pclm(PclmStream),
+}
+
 /// Band writer structure
 #[derive(Debug)]
 pub struct BandWriter {
@@ -141,8 +216,10 @@ pub struct BandWriter {
     pub progress_fn: Option<ProgressCallback>,
     /// Progress callback user data (wrapped for Send+Sync)
     pub progress_data: SendPtr,
-    /// Accumulated output data
+    /// Encoded output not yet taken with `fz_band_writer_take_output`
     pub output_buffer: Vec<u8>,
+    /// Encoder state for formats that are not plain pixel rows
+    pub encoder: Option<BandEncoder>,
 }
 
 impl Default for BandWriter {
@@ -158,6 +235,7 @@ impl Default for BandWriter {
             progress_fn: None,
             progress_data: SendPtr::new(std::ptr::null_mut()),
             output_buffer: Vec::new(),
+            encoder: None,
         }
     }
 }
@@ -172,17 +250,7 @@ pub static BAND_WRITERS: LazyLock<HandleStore<BandWriter>> = LazyLock::new(Handl
 /// Create a new band writer
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_new_band_writer(_ctx: Handle, output: Handle, format: i32) -> Handle {
-    let fmt = match format {
-        1 => BandFormat::JPEG,
-        2 => BandFormat::PNM,
-        3 => BandFormat::PAM,
-        4 => BandFormat::TIFF,
-        5 => BandFormat::PWG,
-        6 => BandFormat::PCL,
-        7 => BandFormat::PS,
-        8 => BandFormat::Raw,
-        _ => BandFormat::PNG,
-    };
+    let fmt = BandFormat::from_i32(format);
 
     let writer = BandWriter {
         output,
@@ -207,17 +275,7 @@ pub extern "C" fn fz_new_band_writer_with_config(
     n: i32,
     alpha: i32,
 ) -> Handle {
-    let fmt = match format {
-        1 => BandFormat::JPEG,
-        2 => BandFormat::PNM,
-        3 => BandFormat::PAM,
-        4 => BandFormat::TIFF,
-        5 => BandFormat::PWG,
-        6 => BandFormat::PCL,
-        7 => BandFormat::PS,
-        8 => BandFormat::Raw,
-        _ => BandFormat::PNG,
-    };
+    let fmt = BandFormat::from_i32(format);
 
     let rows_per_band = 16;
     let total_bands = (height + rows_per_band - 1) / rows_per_band;
@@ -362,16 +420,25 @@ pub extern "C" fn fz_band_writer_write_header(_ctx: Handle, writer: Handle) -> i
                 return 0;
             }
 
+            match new_encoder(&guard.config) {
+                Ok(encoder) => guard.encoder = encoder,
+                Err(()) => {
+                    guard.state = BandWriterState::Error;
+                    return 0;
+                }
+            }
+
             // Generate header based on format
             let header = match guard.config.format {
                 BandFormat::PNG => generate_png_header(&guard.config),
                 BandFormat::PNM => generate_pnm_header(&guard.config),
                 BandFormat::PAM => generate_pam_header(&guard.config),
+                BandFormat::PWG => generate_pwg_header(&guard.config),
+                BandFormat::PCLm => b"%PDF-1.7\n%PCLm 1.0\n".to_vec(),
                 _ => Vec::new(),
             };
 
-            guard.output_buffer.extend_from_slice(&header);
-            guard.bytes_written += header.len();
+            emit(&mut guard, &header);
             guard.state = BandWriterState::HeaderWritten;
 
             return 1;
@@ -405,30 +472,19 @@ pub extern "C" fn fz_band_writer_write_band(
 
             guard.state = BandWriterState::WritingBands;
 
-            let components = guard.config.n + if guard.config.alpha { 1 } else { 0 };
-            let row_size = (guard.config.width * components) as usize;
-            let band_size = row_size * band_rows as usize;
-
+            let band_size = guard.config.row_size() * band_rows as usize;
             let band_data = unsafe { std::slice::from_raw_parts(data, band_size) };
 
-            // For raw format, just append data
-            // For other formats, encoding would happen here
-            guard.output_buffer.extend_from_slice(band_data);
-            guard.bytes_written += band_size;
-            guard.current_band += 1;
-
-            // Call progress callback
-            if let Some(callback) = guard.progress_fn {
-                callback(
-                    guard.current_band,
-                    guard.total_bands,
-                    guard.progress_data.as_ptr(),
-                );
-            }
-
-            if guard.current_band >= guard.total_bands {
-                guard.state = BandWriterState::BandsComplete;
-            }
+            let offset = guard.bytes_written;
+            let BandWriter {
+                config, encoder, ..
+            } = &mut *guard;
+            let Some(encoded) = encode_band(encoder.as_mut(), config, band_data, band_rows, offset)
+            else {
+                guard.state = BandWriterState::Error;
+                return 0;
+            };
+            emit_band(&mut guard, &encoded);
 
             return 1;
         }
@@ -446,13 +502,29 @@ pub extern "C" fn fz_band_writer_write_trailer(_ctx: Handle, writer: Handle) ->
             }
 
             // Generate trailer based on format
-            let trailer = match guard.config.format {
-                BandFormat::PNG => generate_png_trailer(),
-                _ => Vec::new(),
+            let trailer = match guard.encoder.take() {
+                Some(BandEncoder::Png(png)) => png.zlib.finish().ok().map(|rest| {
+                    let mut trailer = Vec::new();
+                    if !rest.is_empty() {
+                        write_png_chunk(&mut trailer, b"IDAT", &rest);
+                    }
+                    trailer.extend_from_slice(&generate_png_trailer());
+                    trailer
+                }),
+                Some(BandEncoder::Pwg(mut pwg)) => Some(pwg_flush_row(&mut pwg)),
+                Some(BandEncoder::Pclm(pclm)) => Some(generate_pclm_trailer(
+                    &pclm,
+                    &guard.config,
+                    guard.bytes_written,
+                )),
+                None => Some(Vec::new()),
+            };
+            let Some(trailer) = trailer else {
+                guard.state = BandWriterState::Error;
+                return 0;
             };
 
-            guard.output_buffer.extend_from_slice(&trailer);
-            guard.bytes_written += trailer.len();
+            emit(&mut guard, &trailer);
             guard.state = BandWriterState::Complete;
 
             return 1;
@@ -544,17 +616,150 @@ pub extern "C" fn fz_band_writer_get_output(
     std::ptr::null()
 }
 
+/// Take the encoded output produced since the last call
+///
+/// Returns a new buffer holding the pending bytes (possibly empty) and
+/// clears them from the writer, so a caller that drains after every band
+/// keeps memory proportional to one band rather than the whole image.
+/// Returns 0 for an invalid writer.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_band_writer_take_output(_ctx: Handle, writer: Handle) -> Handle {
+    if let Some(w) = BAND_WRITERS.get(writer) {
+        if let Ok(mut guard) = w.lock() {
+            let pending = std::mem::take(&mut guard.output_buffer);
+            return BUFFERS.insert(Buffer::from_vec(pending));
+        }
+    }
+    0
+}
+
 // ============================================================================
 // Helper Functions
 // ============================================================================
 
+/// Append encoded bytes and pass them on to the writer's output, if any
+///
+/// With an output attached nothing accumulates in the writer; otherwise the
+/// bytes wait for `fz_band_writer_get_output`/`fz_band_writer_take_output`.
+fn emit(writer: &mut BandWriter, data: &[u8]) {
+    writer.bytes_written += data.len();
+    writer.output_buffer.extend_from_slice(data);
+    if writer.output == 0 {
+        return;
+    }
+    if let Some(out) = super::output::OUTPUTS.get(writer.output) {
+        if let Ok(mut guard) = out.lock() {
+            let _ = guard.write_data(&writer.output_buffer);
+            writer.output_buffer.clear();
+        }
+    }
+}
+
+/// Encode one band of `rows` pixel rows
+///
+/// `offset` is where the encoded band will start in the output, which
+/// PCLm records for its xref. Encoder state carries from band to band, so
+/// bands must be encoded in order, but this needs no access to the
+/// writer: a pipeline can encode band N while band N-1 is being written.
+pub(crate) fn encode_band(
+    encoder: Option<&mut BandEncoder>,
+    config: &BandWriterConfig,
+    band: &[u8],
+    rows: i32,
+    offset: usize,
+) -> Option<Vec<u8>> {
+    let _span = super::trace::span_arg(c"encode", rows as i64);
+    let row_size = config.row_size();
+    match encoder {
+        Some(BandEncoder::Png(png)) => png_encode_band(png, band, row_size),
+        Some(BandEncoder::Pwg(pwg)) => Some(pwg_encode_band(pwg, band, row_size)),
+        Some(BandEncoder::Pclm(pclm)) => pclm_encode_band(pclm, config, band, rows, offset),
+        // Raw, PNM and PAM bands are the pixel rows themselves
+        None => Some(band.to_vec()),
+    }
+}
+
+/// Emit an encoded band and advance the band count and progress
+pub(crate) fn emit_band(writer: &mut BandWriter, encoded: &[u8]) {
+    emit(writer, encoded);
+    writer.current_band += 1;
+
+    // Call progress callback
+    if let Some(callback) = writer.progress_fn {
+        callback(
+            writer.current_band,
+            writer.total_bands,
+            writer.progress_data.as_ptr(),
+        );
+    }
+
+    if writer.current_band >= writer.total_bands {
+        writer.state = BandWriterState::BandsComplete;
+    }
+}
+
+/// Set up the encoder for a format, rejecting pixel layouts it cannot store
+fn new_encoder(config: &BandWriterConfig) -> Result<Option<BandEncoder>, ()> {
+    let level = flate2::Compression::new(config.compression.clamp(0, 9) as u32);
+    match config.format {
+        BandFormat::PNG => {
+            if !matches!(config.n, 1 | 3) {
+                return Err(());
+            }
+            Ok(Some(BandEncoder::Png(PngStream {
+                zlib: ZlibEncoder::new(Vec::new(), level),
+            })))
+        }
+        BandFormat::PWG => {
+            if config.alpha || !matches!(config.n, 1 | 3 | 4) {
+                return Err(());
+            }
+            Ok(Some(BandEncoder::Pwg(PwgStream {
+                pixel_size: config.n as usize,
+                prev: None,
+                repeat: 0,
+            })))
+        }
+        BandFormat::PCLm => {
+            if config.alpha || !matches!(config.n, 1 | 3) {
+                return Err(());
+            }
+            Ok(Some(BandEncoder::Pclm(PclmStream {
+                level,
+                offsets: Vec::new(),
+                strips: Vec::new(),
+            })))
+        }
+        _ => Ok(None),
+    }
+}
+
+/// Deflate one band of rows (each prefixed with filter type 0) and wrap
+/// the flushed bytes in an IDAT chunk
+fn png_encode_band(png: &mut PngStream, band: &[u8], row_size: usize) -> Option<Vec<u8>> {
+    if row_size == 0 {
+        return Some(Vec::new());
+    }
+    for row in band.chunks(row_size) {
+        png.zlib.write_all(&[0]).ok()?;
+        png.zlib.write_all(row).ok()?;
+    }
+    png.zlib.flush().ok()?;
+    let deflated = std::mem::take(png.zlib.get_mut());
+    let mut chunk = Vec::new();
+    if !deflated.is_empty() {
+        write_png_chunk(&mut chunk, b"IDAT", &deflated);
+    }
+    Some(chunk)
+}
+
 fn generate_png_header(config: &BandWriterConfig) -> Vec<u8> {
     let mut header = Vec::new();
 
     // PNG signature
     header.extend_from_slice(&[0x89, 0x50, 0x4E, 0x47, 0x0D, 0x0A, 0x1A, 0x0A]);
 
-    // IHDR chunk (simplified)
+    // IHDR chunk
     let mut ihdr = Vec::new();
     ihdr.extend_from_slice(&(config.width as u32).to_be_bytes());
     ihdr.extend_from_slice(&(config.height as u32).to_be_bytes());
@@ -590,9 +795,210 @@ fn write_png_chunk(output: &mut Vec<u8>, chunk_type: &[u8; 4], data: &[u8]) {
     output.extend_from_slice(chunk_type);
     output.extend_from_slice(data);
 
-    // CRC (simplified - just use 0 for now)
-    let crc = 0u32;
-    output.extend_from_slice(&crc.to_be_bytes());
+    let mut crc = flate2::Crc::new();
+    crc.update(chunk_type);
+    crc.update(data);
+    output.extend_from_slice(&crc.sum().to_be_bytes());
+}
+
+/// PWG raster sync word and 1796-byte page header (PWG 5102.4)
+fn generate_pwg_header(config: &BandWriterConfig) -> Vec<u8> {
+    let mut out = Vec::with_capacity(1800);
+    if config.page_num <= 1 {
+        out.extend_from_slice(b"RaS2");
+    }
+
+    let mut header = vec![0u8; 1796];
+    let mut put = |offset: usize, value: u32| {
+        header[offset..offset + 4].copy_from_slice(&value.to_be_bytes());
+    };
+    let (x_res, y_res) = (config.x_res.max(1), config.y_res.max(1));
+    put(276, x_res as u32);
+    put(280, y_res as u32);
+    put(340, 1); // NumCopies
+    put(352, (config.width as i64 * 72 / x_res as i64) as u32);
+    put(356, (config.height as i64 * 72 / y_res as i64) as u32);
+    put(372, config.width as u32);
+    put(376, config.height as u32);
+    put(384, 8); // BitsPerColor
+    put(388, 8 * config.n as u32);
+    put(392, (config.width * config.n) as u32);
+    put(
+        400,
+        match config.n {
+            1 => 18, // sGray
+            4 => 6,  // CMYK
+            _ => 19, // sRGB
+        },
+    );
+    put(420, config.n as u32);
+    put(452, config.total_pages.max(1) as u32);
+    put(456, 1); // CrossFeedTransform
+    put(460, 1); // FeedTransform
+    header[..9].copy_from_slice(b"PwgRaster");
+
+    out.extend_from_slice(&header);
+    out
+}
+
+/// Add a band's rows to the PWG stream, emitting every row that is complete
+fn pwg_encode_band(pwg: &mut PwgStream, band: &[u8], row_size: usize) -> Vec<u8> {
+    let mut out = Vec::new();
+    if row_size == 0 {
+        return out;
+    }
+    for row in band.chunks(row_size) {
+        if pwg.repeat < 255 && pwg.prev.as_deref() == Some(row) {
+            pwg.repeat += 1;
+            continue;
+        }
+        out.extend_from_slice(&pwg_flush_row(pwg));
+        pwg.prev = Some(row.to_vec());
+    }
+    out
+}
+
+/// Emit the held row with its repeat count and pixel run-length encoding
+fn pwg_flush_row(pwg: &mut PwgStream) -> Vec<u8> {
+    let Some(row) = pwg.prev.take() else {
+        return Vec::new();
+    };
+    let mut out = vec![pwg.repeat];
+    pwg.repeat = 0;
+
+    let pixels: Vec<&[u8]> = row.chunks(pwg.pixel_size).collect();
+    let mut i = 0;
+    while i < pixels.len() {
+        let mut run = 1;
+        while i + run < pixels.len() && run < 128 && pixels[i + run] == pixels[i] {
+            run += 1;
+        }
+        if run > 1 || i + 1 == pixels.len() {
+            // 0..=127: the next pixel repeated count + 1 times
+            out.push((run - 1) as u8);
+            out.extend_from_slice(pixels[i]);
+            i += run;
+            continue;
+        }
+        // Literal run up to the next pair of equal pixels
+        let mut lit = 1;
+        while i + lit < pixels.len()
+            && lit < 128
+            && (i + lit + 1 >= pixels.len() || pixels[i + lit] != pixels[i + lit + 1])
+        {
+            lit += 1;
+        }
+        if lit == 1 {
+            out.push(0);
+        } else {
+            // 129..=255: 257 - count literal pixels follow
+            out.push((257 - lit) as u8);
+        }
+        for pixel in &pixels[i..i + lit] {
+            out.extend_from_slice(pixel);
+        }
+        i += lit;
+    }
+    out
+}
+
+/// First object number used for PCLm strips (1-4 are the page tree)
+const PCLM_FIRST_STRIP: u32 = 5;
+
+/// Write one band as a PCLm image strip object
+fn pclm_encode_band(
+    pclm: &mut PclmStream,
+    config: &BandWriterConfig,
+    band: &[u8],
+    rows: i32,
+    offset: usize,
+) -> Option<Vec<u8>> {
+    let mut zlib = ZlibEncoder::new(Vec::new(), pclm.level);
+    zlib.write_all(band).ok()?;
+    let data = zlib.finish().ok()?;
+
+    let num = PCLM_FIRST_STRIP + pclm.strips.len() as u32;
+    let cs = if config.n == 1 {
+        "DeviceGray"
+    } else {
+        "DeviceRGB"
+    };
+    let mut out = format!(
+        "{num} 0 obj\n<</Type/XObject/Subtype/Image/Width {}/Height {rows}/ColorSpace/{cs}\
+         /BitsPerComponent 8/Filter/FlateDecode/Length {}>>\nstream\n",
+        config.width,
+        data.len()
+    )
+    .into_bytes();
+    out.extend_from_slice(&data);
+    out.extend_from_slice(b"\nendstream\nendobj\n");
+
+    pclm.offsets.push((num, offset));
+    pclm.strips.push((num, rows));
+    Some(out)
+}
+
+/// Write the PCLm page tree, content stream, xref and trailer
+fn generate_pclm_trailer(pclm: &PclmStream, config: &BandWriterConfig, offset: usize) -> Vec<u8> {
+    let sx = 72.0 / config.x_res.max(1) as f32;
+    let sy = 72.0 / config.y_res.max(1) as f32;
+    let page_w = config.width as f32 * sx;
+    let page_h = config.height as f32 * sy;
+
+    // Strips are stacked from the top of the page down
+    let mut content = String::new();
+    let mut xobjects = String::new();
+    let mut top = 0;
+    for (i, &(num, rows)) in pclm.strips.iter().enumerate() {
+        top += rows;
+        content.push_str(&format!(
+            "q {:.4} 0 0 {:.4} 0 {:.4} cm /Strip{i} Do Q\n",
+            page_w,
+            rows as f32 * sy,
+            (config.height - top) as f32 * sy
+        ));
+        xobjects.push_str(&format!("/Strip{i} {num} 0 R"));
+    }
+
+    let objects = [
+        (1, "<</Type/Catalog/Pages 2 0 R>>".to_string()),
+        (2, "<</Type/Pages/Kids[3 0 R]/Count 1>>".to_string()),
+        (
+            3,
+            format!(
+                "<</Type/Page/Parent 2 0 R/MediaBox[0 0 {page_w:.4} {page_h:.4}]\
+                 /Resources<</XObject<<{xobjects}>>>>/Contents 4 0 R>>"
+            ),
+        ),
+        (
+            4,
+            format!("<</Length {}>>\nstream\n{content}endstream", content.len()),
+        ),
+    ];
+
+    let mut out = Vec::new();
+    let mut offsets = pclm.offsets.clone();
+    for (num, body) in &objects {
+        offsets.push((*num, offset + out.len()));
+        out.extend_from_slice(format!("{num} 0 obj\n{body}\nendobj\n").as_bytes());
+    }
+    offsets.sort_unstable();
+
+    let xref = offset + out.len();
+    out.extend_from_slice(
+        format!("xref\n0 {}\n0000000000 65535 f \n", offsets.len() + 1).as_bytes(),
+    );
+    for (_, pos) in &offsets {
+        out.extend_from_slice(format!("{pos:010} 00000 n \n").as_bytes());
+    }
+    out.extend_from_slice(
+        format!(
+            "trailer\n<</Size {}/Root 1 0 R>>\nstartxref\n{xref}\n%%EOF\n",
+            offsets.len() + 1
+        )
+        .as_bytes(),
+    );
+    out
 }
 
 fn generate_pnm_header(config: &BandWriterConfig) -> Vec<u8> {
@@ -727,4 +1133,173 @@ mod tests {
 
         fz_drop_band_writer(0, writer);
     }
+    fn take_output(writer: Handle) -> Vec<u8> {
+        let buf = fz_band_writer_take_output(0, writer);
+        assert!(buf > 0);
+        let data = BUFFERS.get(buf).unwrap().lock().unwrap().data().to_vec();
+        BUFFERS.remove(buf);
+        data
+    }
+
+    #[test]
+    fn test_png_streaming() {
+        let (w, h) = (8, 12);
+        let writer = fz_new_band_writer_with_config(0, 0, 0, w, h, 3, 0);
+        fz_band_writer_set_rows_per_band(0, writer, 4);
+
+        assert_eq!(fz_band_writer_write_header(0, writer), 1);
+        let mut png = take_output(writer);
+        assert_eq!(&png[..8], b"\x89PNG\r\n\x1a\n");
+
+        let mut pixels = Vec::new();
+        for band in 0..3u8 {
+            let data = vec![band * 40; (w * 4 * 3) as usize];
+            pixels.push(data.clone());
+            assert_eq!(fz_band_writer_write_band(0, writer, 4, data.as_ptr()), 1);
+            // Each band is handed out as soon as it is written
+            let chunk = take_output(writer);
+            assert_eq!(&chunk[4..8], b"IDAT");
+            png.extend_from_slice(&chunk);
+        }
+        assert_eq!(fz_band_writer_write_trailer(0, writer), 1);
+        png.extend_from_slice(&take_output(writer));
+        assert!(take_output(writer).is_empty());
+        fz_drop_band_writer(0, writer);
+
+        // Walk the chunks, checking CRCs and collecting image data
+        let mut pos = 8;
+        let mut idat = Vec::new();
+        let mut types = Vec::new();
+        while pos < png.len() {
+            let len = u32::from_be_bytes(png[pos..pos + 4].try_into().unwrap()) as usize;
+            let body = &png[pos + 4..pos + 8 + len];
+            let mut crc = flate2::Crc::new();
+            crc.update(body);
+            let stored = u32::from_be_bytes(png[pos + 8 + len..pos + 12 + len].try_into().unwrap());
+            assert_eq!(crc.sum(), stored);
+            if &body[..4] == b"IDAT" {
+                idat.extend_from_slice(&body[4..]);
+            }
+            types.push(body[..4].to_vec());
+            pos += 12 + len;
+        }
+        assert_eq!(types.first().unwrap(), b"IHDR");
+        assert_eq!(types.last().unwrap(), b"IEND");
+
+        let mut raw = Vec::new();
+        std::io::Read::read_to_end(&mut flate2::read::ZlibDecoder::new(&idat[..]), &mut raw)
+            .unwrap();
+        let row = (w * 3) as usize;
+        assert_eq!(raw.len(), (row + 1) * h as usize);
+        for (y, line) in raw.chunks(row + 1).enumerate() {
+            assert_eq!(line[0], 0);
+            assert_eq!(&line[1..], &pixels[y / 4][..row]);
+        }
+    }
+
+    #[test]
+    fn test_pwg_rows() {
+        let writer = fz_new_band_writer_with_config(0, 0, 5, 4, 3, 3, 0);
+        fz_band_writer_set_rows_per_band(0, writer, 2);
+        fz_band_writer_set_res(0, writer, 300, 300);
+        assert_eq!(fz_band_writer_write_header(0, writer), 1);
+        let header = take_output(writer);
+        assert_eq!(header.len(), 4 + 1796);
+        assert_eq!(&header[..4], b"RaS2");
+        assert_eq!(&header[4..13], b"PwgRaster");
+        assert_eq!(&header[4 + 372..4 + 380], &[0, 0, 0, 4, 0, 0, 0, 3]);
+
+        // Three equal rows of one colour, split over two bands
+        let band = [10u8, 20, 30].repeat(8);
+        fz_band_writer_write_band(0, writer, 2, band.as_ptr());
+        fz_band_writer_write_band(0, writer, 1, band.as_ptr());
+        assert!(take_output(writer).is_empty());
+        assert_eq!(fz_band_writer_write_trailer(0, writer), 1);
+        // Line repeated twice more, pixel repeated four times
+        assert_eq!(take_output(writer), vec![2, 3, 10, 20, 30]);
+        fz_drop_band_writer(0, writer);
+
+        let mut pwg = PwgStream {
+            pixel_size: 1,
+            prev: None,
+            repeat: 0,
+        };
+        assert!(pwg_encode_band(&mut pwg, &[1, 2, 3, 3, 4], 5).is_empty());
+        // Literal pair, run of two, then a single pixel
+        assert_eq!(pwg_flush_row(&mut pwg), vec![0, 255, 1, 2, 1, 3, 0, 4]);
+    }
+
+    #[test]
+    fn test_pclm_strips() {
+        let writer = fz_new_band_writer_with_config(0, 0, 9, 16, 10, 3, 0);
+        fz_band_writer_set_rows_per_band(0, writer, 4);
+        fz_band_writer_set_res(0, writer, 144, 144);
+        assert_eq!(fz_band_writer_write_header(0, writer), 1);
+
+        let band = vec![200u8; 16 * 4 * 3];
+        for rows in [4, 4, 2] {
+            assert_eq!(fz_band_writer_write_band(0, writer, rows, band.as_ptr()), 1);
+        }
+        assert_eq!(fz_band_writer_write_trailer(0, writer), 1);
+        let pdf = take_output(writer);
+        fz_drop_band_writer(0, writer);
+
+        let text = String::from_utf8_lossy(&pdf);
+        assert!(text.starts_with("%PDF-1.7\n%PCLm 1.0\n"));
+        assert!(text.ends_with("%%EOF\n"));
+        assert!(text.contains("/MediaBox[0 0 8.0000 5.0000]"));
+        assert!(text.contains("/Strip2 7 0 R"));
+
+        // startxref points at the xref table, whose entries point at objects
+        // (offsets are in bytes; the strips hold binary data)
+        let start: usize = text
+            .rsplit("startxref\n")
+            .next()
+            .unwrap()
+            .lines()
+            .next()
+            .unwrap()
+            .parse()
+            .unwrap();
+        assert!(pdf[start..].starts_with(b"xref\n0 8\n"));
+        let xref = String::from_utf8(pdf[start..].to_vec()).unwrap();
+        for (num, line) in xref.lines().skip(3).take(7).enumerate() {
+            let pos: usize = line[..10].parse().unwrap();
+            assert!(pdf[pos..].starts_with(format!("{} 0 obj", num + 1).as_bytes()));
+        }
+    }
+
+    #[test]
+    fn test_band_writer_output() {
+        let path = std::env::temp_dir().join(format!("band_writer_{}.pgm", std::process::id()));
+        let c_path = std::ffi::CString::new(path.to_str().unwrap()).unwrap();
+        let out = super::super::output::fz_new_output_with_path(0, c_path.as_ptr(), 0);
+        assert!(out > 0);
+
+        let writer = fz_new_band_writer_with_config(0, out, 2, 2, 2, 1, 0);
+        fz_band_writer_set_rows_per_band(0, writer, 1);
+        fz_band_writer_write_header(0, writer);
+        fz_band_writer_write_band(0, writer, 1, [1u8, 2].as_ptr());
+        fz_band_writer_write_band(0, writer, 1, [3u8, 4].as_ptr());
+        fz_band_writer_write_trailer(0, writer);
+        // Everything went to the output; nothing is left in the writer
+        assert!(take_output(writer).is_empty());
+        fz_drop_band_writer(0, writer);
+        super::super::output::fz_drop_output(0, out);
+
+        let data = std::fs::read(&path).unwrap();
+        let _ = std::fs::remove_file(&path);
+        assert_eq!(data, b"P5\n2 2\n255\n\x01\x02\x03\x04");
+    }
+
+    #[test]
+    fn test_png_rejects_cmyk() {
+        let writer = fz_new_band_writer_with_config(0, 1, 0, 4, 4, 4, 0);
+        assert_eq!(fz_band_writer_write_header(0, writer), 0);
+        assert_eq!(
+            fz_band_writer_state(0, writer),
+            BandWriterState::Error as i32
+        );
+        fz_drop_band_writer(0, writer);
+    }
 }
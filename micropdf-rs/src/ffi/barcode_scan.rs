@@ -0,0 +1,715 @@
+//! Barcode fast scan - find barcodes on a cheap render, decode only those
+//!
+//! Each page is rendered once at a low scan resolution and searched for
+//! candidate regions: linear codes show up as blocks of cells where edges
+//! run almost entirely in one direction, QR codes as groups of 1:1:3:1:1
+//! finder patterns. Only those regions are rendered again at decode
+//! resolution and passed to `fz_decode_barcode_from_pixmap`, so routing a
+//! document by barcode never needs a full-page 300 DPI raster. Pages run on
+//! worker threads and results come back in page order.
+
+use std::ffi::{CStr, CString, c_void};
+use std::os::raw::{c_char, c_int};
+
+use super::barcode::fz_decode_barcode_from_pixmap;
+use super::bitmap::luminance_row;
+use super::colorspace::FZ_COLORSPACE_GRAY;
+use super::context::fz_aa_level;
+use super::document::{
+    FZ_RENDER_ANNOTS, fz_count_pages, fz_drop_page, fz_load_page,
+    fz_new_pixmap_from_page_with_options, render_page_area,
+};
+use super::geometry::{fz_irect, fz_matrix, fz_rect};
+use super::pixmap::{Pixmap, fz_drop_pixmap};
+use super::text_extract::{batch_threads, for_each_page_in_order};
+use super::{Handle, PIXMAPS};
+
+/// Region kind: linear code with vertical bars
+pub const FZ_BARCODE_REGION_LINEAR: i32 = 1;
+/// Region kind: linear code with horizontal bars (rotated 90 degrees)
+pub const FZ_BARCODE_REGION_LINEAR_ROTATED: i32 = 2;
+/// Region kind: QR-style matrix code located by its finder patterns
+pub const FZ_BARCODE_REGION_MATRIX: i32 = 3;
+
+/// Scan resolution used when 0 is passed
+pub const FZ_BARCODE_SCAN_DPI: i32 = 100;
+/// Decode resolution used when 0 is passed
+pub const FZ_BARCODE_DECODE_DPI: i32 = 300;
+
+/// Side of the square cells that edge strength is measured over
+const CELL: usize = 8;
+/// Mean edge strength per pixel (of 255 per transition) for a busy cell
+const MIN_EDGE: u32 = 24;
+/// Factor by which one edge direction must dominate in a linear code
+const DOMINANCE: u32 = 3;
+/// Smallest linear region, in cells along each side
+const MIN_CELLS: usize = 2;
+
+/// A candidate barcode region in device pixels
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct BarcodeRegion {
+    pub area: fz_irect,
+    /// One of the `FZ_BARCODE_REGION_*` kinds
+    pub kind: c_int,
+}
+
+/// Receives one decoded barcode
+///
+/// `text` is only valid during the call and `area` is in page space.
+/// Return 0 to continue, anything else to stop the scan.
+pub type FzBarcodeCallback = Option<
+    unsafe extern "C" fn(
+        opaque: *mut c_void,
+        page: c_int,
+        barcode_type: c_int,
+        text: *const c_char,
+        area: fz_rect,
+    ) -> c_int,
+>;
+
+/// Horizontal and vertical edge strength per cell
+struct EdgeCells {
+    cols: usize,
+    rows: usize,
+    gx: Vec<u32>,
+    gy: Vec<u32>,
+    area: Vec<u32>,
+}
+
+/// A QR finder pattern: centre and width of the 7-module pattern
+#[derive(Debug, Clone, Copy)]
+struct Finder {
+    x: f32,
+    y: f32,
+    size: f32,
+}
+
+/// Check five run lengths against the 1:1:3:1:1 finder ratio
+fn finder_ratio(runs: &[usize]) -> Option<f32> {
+    let total: usize = runs.iter().sum();
+    if total < 7 {
+        return None;
+    }
+    let module = total as f32 / 7.0;
+    let near = |run: usize, modules: f32| (run as f32 - module * modules).abs() < module * 0.7;
+    runs.iter()
+        .zip([1.0, 1.0, 3.0, 1.0, 1.0])
+        .all(|(&run, modules)| near(run, modules))
+        .then_some(total as f32)
+}
+
+/// Lengths of the dark/light runs of `line`, starting with a dark run
+fn dark_runs(line: impl Iterator<Item = bool>) -> Vec<(usize, usize)> {
+    let mut runs: Vec<(usize, usize)> = Vec::new();
+    let mut dark = None;
+    for (i, d) in line.enumerate() {
+        if dark == Some(d) {
+            if let Some(last) = runs.last_mut() {
+                last.1 += 1;
+            }
+        } else if dark.is_some() || d {
+            runs.push((i, 1));
+            dark = Some(d);
+        }
+    }
+    runs
+}
+
+/// Finder patterns on one row, confirmed by a vertical run check
+fn row_finders(gray: &[u8], width: usize, height: usize, y: usize, out: &mut Vec<Finder>) {
+    let row = &gray[y * width..(y + 1) * width];
+    let runs = dark_runs(row.iter().map(|&v| v < 128));
+    // Dark runs sit at even indices
+    for i in (0..runs.len().saturating_sub(4)).step_by(2) {
+        let lens: Vec<usize> = runs[i..i + 5].iter().map(|r| r.1).collect();
+        let Some(size) = finder_ratio(&lens) else {
+            continue;
+        };
+        let cx = runs[i + 2].0 + runs[i + 2].1 / 2;
+
+        // The centre column must show the same pattern
+        let column = (0..height).map(|yy| gray[yy * width + cx] < 128);
+        let vruns = dark_runs(column);
+        let Some(centre) = vruns.iter().position(|&(s, l)| s <= y && y < s + l) else {
+            continue;
+        };
+        if centre < 2 || centre + 2 >= vruns.len() {
+            continue;
+        }
+        let vlens: Vec<usize> = vruns[centre - 2..=centre + 2].iter().map(|r| r.1).collect();
+        let Some(vsize) = finder_ratio(&vlens) else {
+            continue;
+        };
+        if (vsize - size).abs() > size * 0.5 {
+            continue;
+        }
+        let cy = vruns[centre].0 as f32 + vruns[centre].1 as f32 / 2.0;
+        out.push(Finder {
+            x: cx as f32,
+            y: cy,
+            size: (size + vsize) / 2.0,
+        });
+    }
+}
+
+/// Collapse the hits every row through a finder produces into one each
+fn merge_finders(hits: Vec<Finder>) -> Vec<Finder> {
+    let mut merged: Vec<(Finder, f32)> = Vec::new();
+    for hit in hits {
+        match merged
+            .iter_mut()
+            .find(|(f, _)| (f.x - hit.x).abs() < f.size / 2.0 && (f.y - hit.y).abs() < f.size / 2.0)
+        {
+            Some((f, count)) => {
+                let n = *count;
+                f.x = (f.x * n + hit.x) / (n + 1.0);
+                f.y = (f.y * n + hit.y) / (n + 1.0);
+                f.size = (f.size * n + hit.size) / (n + 1.0);
+                *count += 1.0;
+            }
+            None => merged.push((hit, 1.0)),
+        }
+    }
+    merged.into_iter().map(|(f, _)| f).collect()
+}
+
+/// Group finders of similar size into codes and bound each group
+///
+/// A QR code has three finders; with only two found the missing corner
+/// could be on either side, so the bounds grow to cover both.
+fn matrix_regions(finders: &[Finder], width: usize, height: usize) -> Vec<fz_irect> {
+    let mut group: Vec<usize> = (0..finders.len()).collect();
+    fn root(group: &mut [usize], mut i: usize) -> usize {
+        while group[i] != i {
+            group[i] = group[group[i]];
+            i = group[i];
+        }
+        i
+    }
+    for i in 0..finders.len() {
+        for j in i + 1..finders.len() {
+            let (a, b) = (finders[i], finders[j]);
+            let similar = (a.size - b.size).abs() < a.size.max(b.size) * 0.4;
+            // Version 40 is 177 modules across, 25 finder widths
+            let near = (a.x - b.x).hypot(a.y - b.y) < a.size.max(b.size) * 25.0;
+            if similar && near {
+                let (ri, rj) = (root(&mut group, i), root(&mut group, j));
+                group[rj] = ri;
+            }
+        }
+    }
+
+    let mut regions = Vec::new();
+    for r in 0..finders.len() {
+        let members: Vec<Finder> = (0..finders.len())
+            .filter(|&i| root(&mut group, i) == r)
+            .map(|i| finders[i])
+            .collect();
+        if members.len() < 2 {
+            continue;
+        }
+        let size = members.iter().map(|f| f.size).fold(0.0, f32::max);
+        let (mut x0, mut y0, mut x1, mut y1) = members.iter().fold(
+            (f32::MAX, f32::MAX, f32::MIN, f32::MIN),
+            |(x0, y0, x1, y1), f| (x0.min(f.x), y0.min(f.y), x1.max(f.x), y1.max(f.y)),
+        );
+        if members.len() == 2 {
+            let side = (x1 - x0).max(y1 - y0);
+            if x1 - x0 < side / 2.0 {
+                x0 -= side;
+                x1 += side;
+            }
+            if y1 - y0 < side / 2.0 {
+                y0 -= side;
+                y1 += side;
+            }
+        }
+        // Half a finder to the code's edge, then a 4-module quiet zone
+        let pad = size * (0.5 + 4.0 / 7.0);
+        regions.push(fz_irect {
+            x0: (x0 - pad).max(0.0) as i32,
+            y0: (y0 - pad).max(0.0) as i32,
+            x1: ((x1 + pad).ceil() as i32).min(width as i32),
+            y1: ((y1 + pad).ceil() as i32).min(height as i32),
+        });
+    }
+    regions
+}
+
+impl EdgeCells {
+    fn new(gray: &[u8], width: usize, height: usize) -> Self {
+        let (cols, rows) = (width.div_ceil(CELL), height.div_ceil(CELL));
+        let mut cells = Self {
+            cols,
+            rows,
+            gx: vec![0; cols * rows],
+            gy: vec![0; cols * rows],
+            area: vec![0; cols * rows],
+        };
+        for y in 0..height {
+            let row = &gray[y * width..(y + 1) * width];
+            let above = y.checked_sub(1).map(|p| &gray[p * width..(p + 1) * width]);
+            let base = (y / CELL) * cols;
+            for (x, &v) in row.iter().enumerate() {
+                let cell = base + x / CELL;
+                if let Some(&next) = row.get(x + 1) {
+                    cells.gx[cell] += v.abs_diff(next) as u32;
+                }
+                if let Some(above) = above {
+                    cells.gy[cell] += v.abs_diff(above[x]) as u32;
+                }
+                cells.area[cell] += 1;
+            }
+        }
+        cells
+    }
+
+    /// Linear-code kind of a cell, if any
+    fn kind(&self, cell: usize) -> Option<i32> {
+        let (gx, gy) = (self.gx[cell], self.gy[cell]);
+        let busy = MIN_EDGE * self.area[cell];
+        if gx >= busy && gx >= gy * DOMINANCE {
+            Some(FZ_BARCODE_REGION_LINEAR)
+        } else if gy >= busy && gy >= gx * DOMINANCE {
+            Some(FZ_BARCODE_REGION_LINEAR_ROTATED)
+        } else {
+            None
+        }
+    }
+
+    /// Connected blocks of same-kind cells, as padded pixel rectangles
+    fn linear_regions(&self, width: usize, height: usize) -> Vec<BarcodeRegion> {
+        let kinds: Vec<Option<i32>> = (0..self.cols * self.rows).map(|c| self.kind(c)).collect();
+        let mut seen = vec![false; kinds.len()];
+        let mut regions = Vec::new();
+        for start in 0..kinds.len() {
+            let Some(kind) = kinds[start] else { continue };
+            if seen[start] {
+                continue;
+            }
+            seen[start] = true;
+            let (mut c0, mut r0) = (start % self.cols, start / self.cols);
+            let (mut c1, mut r1) = (c0, r0);
+            let mut stack = vec![start];
+            while let Some(cell) = stack.pop() {
+                let (c, r) = (cell % self.cols, cell / self.cols);
+                (c0, c1, r0, r1) = (c0.min(c), c1.max(c), r0.min(r), r1.max(r));
+                for (dc, dr) in [
+                    (-1, -1),
+                    (0, -1),
+                    (1, -1),
+                    (-1, 0),
+                    (1, 0),
+                    (-1, 1),
+                    (0, 1),
+                    (1, 1),
+                ] {
+                    let (nc, nr) = (c as isize + dc, r as isize + dr);
+                    if nc < 0 || nr < 0 || nc >= self.cols as isize || nr >= self.rows as isize {
+                        continue;
+                    }
+                    let next = nr as usize * self.cols + nc as usize;
+                    if !seen[next] && kinds[next] == Some(kind) {
+                        seen[next] = true;
+                        stack.push(next);
+                    }
+                }
+            }
+            if c1 + 1 - c0 < MIN_CELLS || r1 + 1 - r0 < MIN_CELLS {
+                continue;
+            }
+            // One cell of margin covers the quiet zone and ragged edges
+            regions.push(BarcodeRegion {
+                area: fz_irect {
+                    x0: (c0.saturating_sub(1) * CELL) as i32,
+                    y0: (r0.saturating_sub(1) * CELL) as i32,
+                    x1: ((c1 + 2) * CELL).min(width) as i32,
+                    y1: ((r1 + 2) * CELL).min(height) as i32,
+                },
+                kind,
+            });
+        }
+        regions
+    }
+}
+
+/// Find candidate barcode regions in a pixmap
+///
+/// Regions are in the pixmap's device coordinates, sorted top to bottom
+/// and then left to right.
+pub fn find_barcode_regions(pixmap: &Pixmap) -> Vec<BarcodeRegion> {
+    let (width, height) = (pixmap.w().max(0) as usize, pixmap.h().max(0) as usize);
+    let mut gray = Vec::with_capacity(width * height);
+    let mut buf = Vec::new();
+    for y in 0..height {
+        gray.extend_from_slice(luminance_row(pixmap, y, &mut buf));
+    }
+
+    let mut regions = EdgeCells::new(&gray, width, height).linear_regions(width, height);
+
+    let mut hits = Vec::new();
+    for y in 0..height {
+        row_finders(&gray, width, height, y, &mut hits);
+    }
+    let finders = merge_finders(hits);
+    regions.extend(
+        matrix_regions(&finders, width, height)
+            .into_iter()
+            .map(|area| BarcodeRegion {
+                area,
+                kind: FZ_BARCODE_REGION_MATRIX,
+            }),
+    );
+
+    for r in &mut regions {
+        r.area.x0 += pixmap.x();
+        r.area.x1 += pixmap.x();
+        r.area.y0 += pixmap.y();
+        r.area.y1 += pixmap.y();
+    }
+    regions.sort_by_key(|r| (r.area.y0, r.area.x0));
+    regions
+}
+
+/// Find candidate barcode regions in a pixmap
+///
+/// Writes up to `max` regions (device coordinates, top to bottom) to
+/// `regions`, which may be null to only count them.
+///
+/// # Returns
+/// Number of regions found, which may exceed `max`, or -1 for an invalid
+/// pixmap
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_find_barcode_regions(
+    _ctx: Handle,
+    pix: Handle,
+    regions: *mut BarcodeRegion,
+    max: i32,
+) -> i32 {
+    let Some(p) = PIXMAPS.get(pix) else {
+        return -1;
+    };
+    let Ok(guard) = p.lock() else {
+        return -1;
+    };
+    let found = find_barcode_regions(&guard);
+    if !regions.is_null() {
+        for (i, region) in found.iter().take(max.max(0) as usize).enumerate() {
+            // SAFETY: the caller provides room for `max` regions
+            unsafe { *regions.add(i) = *region };
+        }
+    }
+    found.len() as i32
+}
+
+/// One decoded barcode, ready to be delivered
+struct Found {
+    barcode_type: c_int,
+    text: CString,
+    area: fz_rect,
+}
+
+fn scale_matrix(dpi: i32) -> fz_matrix {
+    let scale = dpi as f32 / 72.0;
+    fz_matrix {
+        a: scale,
+        b: 0.0,
+        c: 0.0,
+        d: scale,
+        e: 0.0,
+        f: 0.0,
+    }
+}
+
+/// Scan one page at `scan_dpi` and decode its candidates at `decode_dpi`
+fn scan_page(ctx: Handle, doc: Handle, n: i32, scan_dpi: i32, decode_dpi: i32) -> Vec<Found> {
+    let page = fz_load_page(ctx, doc, n);
+    if page == 0 {
+        return Vec::new();
+    }
+    let aa = fz_aa_level(ctx);
+    let scan = scale_matrix(scan_dpi);
+    let pix = fz_new_pixmap_from_page_with_options(
+        ctx,
+        page,
+        scan,
+        FZ_COLORSPACE_GRAY,
+        0,
+        aa,
+        FZ_RENDER_ANNOTS,
+        0,
+    );
+    let regions = PIXMAPS
+        .get(pix)
+        .and_then(|p| p.lock().ok().map(|guard| find_barcode_regions(&guard)))
+        .unwrap_or_default();
+    fz_drop_pixmap(ctx, pix);
+
+    let decode = scale_matrix(decode_dpi);
+    let mut found = Vec::new();
+    for region in regions {
+        let area = fz_rect {
+            x0: region.area.x0 as f32 / scan.a,
+            y0: region.area.y0 as f32 / scan.d,
+            x1: region.area.x1 as f32 / scan.a,
+            y1: region.area.y1 as f32 / scan.d,
+        };
+        let bbox = fz_irect {
+            x0: (area.x0 * decode.a).floor() as i32,
+            y0: (area.y0 * decode.d).floor() as i32,
+            x1: (area.x1 * decode.a).ceil() as i32,
+            y1: (area.y1 * decode.d).ceil() as i32,
+        };
+        let pix = render_page_area(
+            ctx,
+            page,
+            decode,
+            FZ_COLORSPACE_GRAY,
+            0,
+            aa,
+            FZ_RENDER_ANNOTS,
+            0,
+            bbox,
+        );
+        if pix == 0 {
+            continue;
+        }
+        let rotate = if region.kind == FZ_BARCODE_REGION_LINEAR_ROTATED {
+            90
+        } else {
+            0
+        };
+        let mut barcode_type = 0;
+        let text = fz_decode_barcode_from_pixmap(ctx, &mut barcode_type, pix, rotate);
+        fz_drop_pixmap(ctx, pix);
+        if !text.is_null() {
+            // SAFETY: decoded strings are allocated with CString::into_raw
+            let text = unsafe { CString::from_raw(text) };
+            found.push(Found {
+                barcode_type,
+                text,
+                area,
+            });
+        }
+    }
+    fz_drop_page(ctx, page);
+    found
+}
+
+/// Find and decode the barcodes on every page of a document
+///
+/// Each page is rendered at `scan_dpi` (0 for `FZ_BARCODE_SCAN_DPI`) to
+/// locate candidate regions; only those are rendered at `decode_dpi` (0
+/// for `FZ_BARCODE_DECODE_DPI`) and decoded. Pages run on up to `threads`
+/// workers (0 for one per core), at most `max_in_flight` pages (0 for
+/// twice the thread count) ahead of the callback, which is called on the
+/// calling thread for each barcode in page order.
+///
+/// # Returns
+/// Number of barcodes delivered, or -1 if the callback is null or the
+/// document has no pages
+#[unsafe(no_mangle)]
+#[allow(clippy::too_many_arguments)]
+pub extern "C" fn fz_scan_document_barcodes(
+    ctx: Handle,
+    doc: Handle,
+    scan_dpi: i32,
+    decode_dpi: i32,
+    threads: i32,
+    max_in_flight: i32,
+    callback: FzBarcodeCallback,
+    opaque: *mut c_void,
+) -> i32 {
+    let Some(callback) = callback else {
+        return -1;
+    };
+    let pages = fz_count_pages(ctx, doc);
+    if pages <= 0 {
+        return -1;
+    }
+    let pages = pages as usize;
+    let scan_dpi = if scan_dpi > 0 {
+        scan_dpi
+    } else {
+        FZ_BARCODE_SCAN_DPI
+    };
+    let decode_dpi = if decode_dpi > 0 {
+        decode_dpi
+    } else {
+        FZ_BARCODE_DECODE_DPI
+    };
+
+    let threads = batch_threads(threads, pages);
+    let window = if max_in_flight > 0 {
+        max_in_flight as usize
+    } else {
+        threads * 2
+    };
+
+    let mut delivered = 0;
+    for_each_page_in_order(
+        ctx,
+        pages,
+        threads,
+        window,
+        |worker_ctx, n| scan_page(worker_ctx, doc, n, scan_dpi, decode_dpi),
+        |n, found| {
+            for barcode in found {
+                let text: &CStr = &barcode.text;
+                // SAFETY: the caller guarantees the callback and its opaque pointer
+                let status = unsafe {
+                    callback(
+                        opaque,
+                        n as c_int,
+                        barcode.barcode_type,
+                        text.as_ptr(),
+                        barcode.area,
+                    )
+                };
+                delivered += 1;
+                if status != 0 {
+                    return false;
+                }
+            }
+            true
+        },
+    );
+    delivered
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::barcode::{BarcodeType, fz_new_barcode_pixmap};
+
+    /// A white page with a generated barcode pasted at (x, y) and a few
+    /// lines of text-like noise
+    fn page_with(barcode: Handle, x: usize, y: usize) -> Pixmap {
+        let (w, h) = (600, 500);
+        let mut page = Pixmap::new(FZ_COLORSPACE_GRAY, w as i32, h as i32, false);
+        let samples = page.samples_mut();
+        samples.fill(255);
+        // Glyph-like blobs: short strokes in both directions
+        for line in 0..6 {
+            let top = 300 + line * 24;
+            for glyph in 0..60 {
+                let left = 20 + glyph * 9;
+                for dy in 0..10 {
+                    for dx in 0..6 {
+                        let ink = dx == 0 || dy == 0 || dy == 9 || (glyph % 3 == 0 && dx == 5);
+                        if ink {
+                            samples[(top + dy) * w + left + dx] = 0;
+                        }
+                    }
+                }
+            }
+        }
+        let code = PIXMAPS.get(barcode).unwrap();
+        let code = code.lock().unwrap();
+        let (cw, ch) = (code.w() as usize, code.h() as usize);
+        for row in 0..ch {
+            samples[(y + row) * w + x..][..cw].copy_from_slice(&code.samples()[row * cw..][..cw]);
+        }
+        page
+    }
+
+    fn contains(outer: &fz_irect, x0: i32, y0: i32, x1: i32, y1: i32) -> bool {
+        outer.x0 <= x0 && outer.y0 <= y0 && outer.x1 >= x1 && outer.y1 >= y1
+    }
+
+    #[test]
+    fn test_finds_linear_code() {
+        let value = CString::new("5901234123457").unwrap();
+        let code = fz_new_barcode_pixmap(0, BarcodeType::Ean13 as i32, value.as_ptr(), 2, 0, 0, 0);
+        let (cw, ch) = {
+            let p = PIXMAPS.get(code).unwrap();
+            let p = p.lock().unwrap();
+            (p.w(), p.h())
+        };
+        let page = page_with(code, 100, 40);
+
+        let regions = find_barcode_regions(&page);
+        let linear: Vec<_> = regions
+            .iter()
+            .filter(|r| r.kind == FZ_BARCODE_REGION_LINEAR)
+            .collect();
+        assert_eq!(linear.len(), 1, "{regions:?}");
+        // The generated code carries a 9-module quiet zone on either side
+        assert!(contains(
+            &linear[0].area,
+            100 + 18,
+            44,
+            100 + cw - 18,
+            36 + ch
+        ));
+        // The text block is not mistaken for a barcode
+        assert!(regions.iter().all(|r| r.area.y1 <= 300));
+
+        // The same code turned on its side
+        let mut turned = Pixmap::new(FZ_COLORSPACE_GRAY, ch, cw, false);
+        {
+            let p = PIXMAPS.get(code).unwrap();
+            let p = p.lock().unwrap();
+            let (cw, ch) = (cw as usize, ch as usize);
+            let samples = turned.samples_mut();
+            for y in 0..ch {
+                for x in 0..cw {
+                    samples[x * ch + y] = p.samples()[y * cw + x];
+                }
+            }
+        }
+        let turned = PIXMAPS.insert(turned);
+        let regions = find_barcode_regions(&page_with(turned, 400, 20));
+        assert_eq!(regions.len(), 1, "{regions:?}");
+        assert_eq!(regions[0].kind, FZ_BARCODE_REGION_LINEAR_ROTATED);
+        fz_drop_pixmap(0, turned);
+        fz_drop_pixmap(0, code);
+    }
+
+    #[test]
+    fn test_finds_qr_code() {
+        let value = CString::new("https://example.com/route/42").unwrap();
+        let code = fz_new_barcode_pixmap(0, BarcodeType::QrCode as i32, value.as_ptr(), 3, 0, 1, 0);
+        let side = PIXMAPS.get(code).unwrap().lock().unwrap().w();
+        let page = page_with(code, 300, 20);
+        let pix = PIXMAPS.insert(page);
+
+        let count = fz_find_barcode_regions(0, pix, std::ptr::null_mut(), 0);
+        let mut regions = vec![
+            BarcodeRegion {
+                area: fz_irect::default(),
+                kind: 0,
+            };
+            count as usize
+        ];
+        assert_eq!(
+            fz_find_barcode_regions(0, pix, regions.as_mut_ptr(), count),
+            count
+        );
+        let matrix: Vec<_> = regions
+            .iter()
+            .filter(|r| r.kind == FZ_BARCODE_REGION_MATRIX)
+            .collect();
+        assert_eq!(matrix.len(), 1, "{regions:?}");
+        // Quiet zone is 4 modules of 3 pixels
+        assert!(contains(
+            &matrix[0].area,
+            300 + 12,
+            20 + 12,
+            300 + side - 12,
+            20 + side - 12
+        ));
+        assert_eq!(fz_find_barcode_regions(0, 0, std::ptr::null_mut(), 0), -1);
+        fz_drop_pixmap(0, pix);
+        fz_drop_pixmap(0, code);
+    }
+
+    #[test]
+    fn test_scan_document_rejects_bad_input() {
+        assert_eq!(
+            fz_scan_document_barcodes(0, 0, 0, 0, 0, 0, None, std::ptr::null_mut()),
+            -1
+        );
+    }
+}
@@ -1,7 +1,7 @@
 //! C FFI for 1-bit bitmap - MuPDF compatible
 //! Safe Rust implementation of fz_bitmap
 
-use super::{Handle, HandleStore};
+use super::{Handle, HandleStore, simd_util};
 use std::sync::LazyLock;
 
 /// Halftone algorithm
@@ -127,66 +127,62 @@ pub extern "C" fn fz_new_bitmap(
     BITMAPS.insert(bitmap)
 }
 
-/// Create bitmap from pixmap using threshold
-#[unsafe(no_mangle)]
-pub extern "C" fn fz_new_bitmap_from_pixmap(
-    _ctx: Handle,
-    pixmap: Handle,
-    threshold: i32,
-) -> Handle {
-    // Get pixmap dimensions from pixmap module
-    let (width, height) = if let Some(pix) = super::PIXMAPS.get(pixmap) {
-        if let Ok(guard) = pix.lock() {
-            (guard.w(), guard.h())
+/// 4x4 Bayer matrix (normalized to 0-255 range)
+const BAYER_4X4: [[u8; 4]; 4] = [
+    [0, 128, 32, 160],
+    [192, 64, 224, 96],
+    [48, 176, 16, 144],
+    [240, 112, 208, 80],
+];
+
+/// Luminance of row `y` of a pixmap, one byte per pixel
+///
+/// A single-channel pixmap is returned in place; anything else is
+/// converted into `buf`.
+pub(crate) fn luminance_row<'a>(
+    pixmap: &'a super::pixmap::Pixmap,
+    y: usize,
+    buf: &'a mut Vec<u8>,
+) -> &'a [u8] {
+    let width = pixmap.w() as usize;
+    let n = pixmap.n() as usize;
+    let start = y * pixmap.stride() as usize;
+    let samples = pixmap.samples();
+    let row = samples.get(start..).unwrap_or(&[]);
+
+    if n == 1 && row.len() >= width {
+        return &row[..width];
+    }
+
+    buf.clear();
+    buf.extend((0..width).map(|x| {
+        let px = row.get(x * n..).unwrap_or(&[]);
+        if n >= 3 && px.len() >= 3 {
+            let (r, g, b) = (px[0] as u32, px[1] as u32, px[2] as u32);
+            ((r * 299 + g * 587 + b * 114) / 1000) as u8
         } else {
-            return 0;
+            px.first().copied().unwrap_or(0)
         }
-    } else {
-        return 0;
-    };
+    }));
+    buf
+}
 
+/// Pack a pixmap row by row against a repeating set of threshold rows
+///
+/// Row `y` of the output has a bit set wherever the luminance is below
+/// `thresholds[y % thresholds.len()]` at the same column.
+fn pack_pixmap(pixmap: &super::pixmap::Pixmap, thresholds: &[Vec<u8>]) -> Bitmap {
+    let (width, height) = (pixmap.w().max(0), pixmap.h().max(0));
     let stride = (width + 7) / 8;
-    let data_size = (stride * height) as usize;
-    let mut data = vec![0u8; data_size];
-
-    // Get pixmap data and convert using threshold
-    if let Some(pix) = super::PIXMAPS.get(pixmap) {
-        if let Ok(guard) = pix.lock() {
-            let n = guard.n() as usize;
-            let pix_stride = guard.stride() as usize;
-            let samples = guard.samples();
-            let thresh = threshold.clamp(0, 255) as u8;
+    let mut data = vec![0u8; (stride * height) as usize];
 
-            for y in 0..height as usize {
-                for x in 0..width as usize {
-                    let pix_offset = y * pix_stride + x * n;
-
-                    // Calculate luminance (simple average for grayscale)
-                    let lum = if n >= 3 && pix_offset + 2 < samples.len() {
-                        let r = samples[pix_offset] as u32;
-                        let g = samples[pix_offset + 1] as u32;
-                        let b = samples[pix_offset + 2] as u32;
-                        ((r * 299 + g * 587 + b * 114) / 1000) as u8
-                    } else if pix_offset < samples.len() {
-                        samples[pix_offset]
-                    } else {
-                        0
-                    };
-
-                    // Set bit if below threshold (black)
-                    if lum < thresh {
-                        let byte_idx = y * stride as usize + x / 8;
-                        let bit_idx = 7 - (x % 8);
-                        if byte_idx < data.len() {
-                            data[byte_idx] |= 1 << bit_idx;
-                        }
-                    }
-                }
-            }
-        }
+    let mut buf = Vec::new();
+    for (y, out) in data.chunks_exact_mut(stride.max(1) as usize).enumerate() {
+        let gray = luminance_row(pixmap, y, &mut buf);
+        simd_util::pack_below(gray, &thresholds[y % thresholds.len()], out);
     }
 
-    let bitmap = Bitmap {
+    Bitmap {
         width,
         height,
         stride,
@@ -194,7 +190,75 @@ pub extern "C" fn fz_new_bitmap_from_pixmap(
         y_res: 72,
         data,
         invert: false,
+    }
+}
+
+/// Threshold a pixmap into a new bitmap
+///
+/// Pixels with luminance below `threshold` become set (black) bits.
+pub fn threshold_pixmap(pixmap: &super::pixmap::Pixmap, threshold: i32) -> Bitmap {
+    let thresh = threshold.clamp(0, 255) as u8;
+    pack_pixmap(pixmap, &[vec![thresh; pixmap.w().max(0) as usize]])
+}
+
+/// Halftone a pixmap into a new bitmap
+///
+/// Ordered dithering and plain thresholding (used for the screen types
+/// without their own implementation) compare whole rows against a tiled
+/// threshold matrix; Floyd-Steinberg diffusion is inherently serial.
+pub fn halftone_pixmap(pixmap: &super::pixmap::Pixmap, halftone: HalftoneType) -> Bitmap {
+    match halftone {
+        HalftoneType::FloydSteinberg => {
+            let (width, height) = (pixmap.w().max(0), pixmap.h().max(0));
+            let stride = (width + 7) / 8;
+            let mut data = vec![0u8; (stride * height) as usize];
+
+            let mut gray_buffer: Vec<i32> = Vec::with_capacity((width * height) as usize);
+            let mut buf = Vec::new();
+            for y in 0..height as usize {
+                let row = luminance_row(pixmap, y, &mut buf);
+                gray_buffer.extend(row.iter().map(|&v| v as i32));
+            }
+            floyd_steinberg_dither(&mut gray_buffer, width, height, &mut data, stride);
+
+            Bitmap {
+                width,
+                height,
+                stride,
+                x_res: 72,
+                y_res: 72,
+                data,
+                invert: false,
+            }
+        }
+        HalftoneType::Ordered => {
+            let width = pixmap.w().max(0) as usize;
+            let rows: Vec<Vec<u8>> = BAYER_4X4
+                .iter()
+                .map(|cells| (0..width).map(|x| cells[x % 4]).collect())
+                .collect();
+            pack_pixmap(pixmap, &rows)
+        }
+        // Simple threshold for other types
+        _ => threshold_pixmap(pixmap, 128),
+    }
+}
+
+/// Create bitmap from pixmap using threshold
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_bitmap_from_pixmap(
+    _ctx: Handle,
+    pixmap: Handle,
+    threshold: i32,
+) -> Handle {
+    let Some(pix) = super::PIXMAPS.get(pixmap) else {
+        return 0;
+    };
+    let Ok(guard) = pix.lock() else {
+        return 0;
     };
+    let bitmap = threshold_pixmap(&guard, threshold);
+    drop(guard);
 
     BITMAPS.insert(bitmap)
 }
@@ -206,19 +270,12 @@ pub extern "C" fn fz_new_bitmap_from_pixmap_halftone(
     pixmap: Handle,
     halftone_type: i32,
 ) -> Handle {
-    let (width, height) = if let Some(pix) = super::PIXMAPS.get(pixmap) {
-        if let Ok(guard) = pix.lock() {
-            (guard.w(), guard.h())
-        } else {
-            return 0;
-        }
-    } else {
+    let Some(pix) = super::PIXMAPS.get(pixmap) else {
+        return 0;
+    };
+    let Ok(guard) = pix.lock() else {
         return 0;
     };
-
-    let stride = (width + 7) / 8;
-    let data_size = (stride * height) as usize;
-    let mut data = vec![0u8; data_size];
 
     let ht = match halftone_type {
         1 => HalftoneType::FloydSteinberg,
@@ -227,58 +284,8 @@ pub extern "C" fn fz_new_bitmap_from_pixmap_halftone(
         4 => HalftoneType::Stochastic,
         _ => HalftoneType::None,
     };
-
-    // Get pixmap data and apply halftoning
-    if let Some(pix) = super::PIXMAPS.get(pixmap) {
-        if let Ok(guard) = pix.lock() {
-            let n = guard.n() as usize;
-            let pix_stride = guard.stride() as usize;
-            let samples = guard.samples();
-
-            // Create grayscale buffer for error diffusion
-            let mut gray_buffer: Vec<i32> = Vec::with_capacity((width * height) as usize);
-
-            for y in 0..height as usize {
-                for x in 0..width as usize {
-                    let pix_offset = y * pix_stride + x * n;
-                    let lum = if n >= 3 && pix_offset + 2 < samples.len() {
-                        let r = samples[pix_offset] as i32;
-                        let g = samples[pix_offset + 1] as i32;
-                        let b = samples[pix_offset + 2] as i32;
-                        (r * 299 + g * 587 + b * 114) / 1000
-                    } else if pix_offset < samples.len() {
-                        samples[pix_offset] as i32
-                    } else {
-                        0
-                    };
-                    gray_buffer.push(lum);
-                }
-            }
-
-            match ht {
-                HalftoneType::FloydSteinberg => {
-                    floyd_steinberg_dither(&mut gray_buffer, width, height, &mut data, stride);
-                }
-                HalftoneType::Ordered => {
-                    ordered_dither(&gray_buffer, width, height, &mut data, stride);
-                }
-                _ => {
-                    // Simple threshold for other types
-                    threshold_convert(&gray_buffer, width, height, &mut data, stride, 128);
-                }
-            }
-        }
-    }
-
-    let bitmap = Bitmap {
-        width,
-        height,
-        stride,
-        x_res: 72,
-        y_res: 72,
-        data,
-        invert: false,
-    };
+    let bitmap = halftone_pixmap(&guard, ht);
+    drop(guard);
 
     BITMAPS.insert(bitmap)
 }
@@ -321,61 +328,6 @@ fn floyd_steinberg_dither(gray: &mut [i32], width: i32, height: i32, out: &mut [
     }
 }
 
-/// Ordered dithering with Bayer matrix
-fn ordered_dither(gray: &[i32], width: i32, height: i32, out: &mut [u8], stride: i32) {
-    // 4x4 Bayer matrix (normalized to 0-255 range)
-    const BAYER_4X4: [[i32; 4]; 4] = [
-        [0, 128, 32, 160],
-        [192, 64, 224, 96],
-        [48, 176, 16, 144],
-        [240, 112, 208, 80],
-    ];
-
-    let w = width as usize;
-    let h = height as usize;
-
-    for y in 0..h {
-        for x in 0..w {
-            let idx = y * w + x;
-            let threshold = BAYER_4X4[y % 4][x % 4];
-
-            if gray[idx] < threshold {
-                let byte_idx = y * stride as usize + x / 8;
-                let bit_idx = 7 - (x % 8);
-                if byte_idx < out.len() {
-                    out[byte_idx] |= 1 << bit_idx;
-                }
-            }
-        }
-    }
-}
-
-/// Simple threshold conversion
-fn threshold_convert(
-    gray: &[i32],
-    width: i32,
-    height: i32,
-    out: &mut [u8],
-    stride: i32,
-    threshold: i32,
-) {
-    let w = width as usize;
-    let h = height as usize;
-
-    for y in 0..h {
-        for x in 0..w {
-            let idx = y * w + x;
-            if gray[idx] < threshold {
-                let byte_idx = y * stride as usize + x / 8;
-                let bit_idx = 7 - (x % 8);
-                if byte_idx < out.len() {
-                    out[byte_idx] |= 1 << bit_idx;
-                }
-            }
-        }
-    }
-}
-
 // ============================================================================
 // Bitmap Properties
 // ============================================================================
@@ -557,6 +509,64 @@ pub extern "C" fn fz_bitmap_fill(_ctx: Handle, bitmap: Handle) {
 // Compression
 // ============================================================================
 
+/// Encode `data` as (count, byte) pairs, counts at most 255
+///
+/// Stops before the first pair that would not fit in `out`; returns the
+/// bytes written. With `out` empty nothing is written and the full encoded
+/// length is returned.
+fn encode_rle(data: &[u8], out: &mut [u8]) -> usize {
+    let measure = out.is_empty();
+    let (mut i, mut out_idx) = (0, 0);
+    while i < data.len() {
+        let count = simd_util::run_length(&data[i..], 255);
+        if !measure {
+            if out_idx + 2 > out.len() {
+                break;
+            }
+            out[out_idx] = count as u8;
+            out[out_idx + 1] = data[i];
+        }
+        out_idx += 2;
+        i += count;
+    }
+    out_idx
+}
+
+/// Append one row encoded as TIFF PackBits
+///
+/// Runs of three or more equal bytes become a repeat code (`1 - n`, byte);
+/// everything else goes out as literals (`n - 1`, bytes) of up to 128.
+fn encode_packbits_row(row: &[u8], out: &mut Vec<u8>) {
+    let mut i = 0;
+    while i < row.len() {
+        let run = simd_util::run_length(&row[i..], 128);
+        if run >= 3 {
+            out.push((1 - run as i32) as u8);
+            out.push(row[i]);
+            i += run;
+            continue;
+        }
+        // Literal up to the next run worth coding
+        let start = i;
+        while i < row.len() && i - start < 128 && simd_util::run_length(&row[i..], 3) < 3 {
+            i += 1;
+        }
+        out.push((i - start - 1) as u8);
+        out.extend_from_slice(&row[start..i]);
+    }
+}
+
+/// Encode a bitmap as TIFF PackBits, each row coded separately
+pub fn encode_packbits(bitmap: &Bitmap) -> Vec<u8> {
+    let mut out = Vec::with_capacity(bitmap.data.len() / 4);
+    if bitmap.stride > 0 {
+        for row in bitmap.data.chunks(bitmap.stride as usize) {
+            encode_packbits_row(row, &mut out);
+        }
+    }
+    out
+}
+
 /// Compress bitmap using RLE
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_bitmap_compress_rle(
@@ -572,45 +582,61 @@ pub extern "C" fn fz_bitmap_compress_rle(
     if let Some(bm) = BITMAPS.get(bitmap) {
         if let Ok(guard) = bm.lock() {
             let out_slice = unsafe { std::slice::from_raw_parts_mut(output, max_size) };
-            let mut out_idx = 0;
-
-            // Simple RLE: repeat count + byte value
-            let mut i = 0;
-            while i < guard.data.len() && out_idx + 2 <= max_size {
-                let byte = guard.data[i];
-                let mut count = 1u8;
-
-                while i + (count as usize) < guard.data.len()
-                    && count < 255
-                    && guard.data[i + (count as usize)] == byte
-                {
-                    count += 1;
-                }
+            return encode_rle(&guard.data, out_slice);
+        }
+    }
+    0
+}
 
-                out_slice[out_idx] = count;
-                out_slice[out_idx + 1] = byte;
-                out_idx += 2;
-                i += count as usize;
-            }
+/// Compress bitmap using TIFF PackBits, each row coded separately
+///
+/// # Returns
+/// Bytes written, or 0 if the output would not fit in `max_size`; use
+/// `fz_bitmap_compressed_size` to size the buffer
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_bitmap_compress_packbits(
+    _ctx: Handle,
+    bitmap: Handle,
+    output: *mut u8,
+    max_size: usize,
+) -> usize {
+    if output.is_null() || max_size == 0 {
+        return 0;
+    }
 
-            return out_idx;
+    if let Some(bm) = BITMAPS.get(bitmap) {
+        if let Ok(guard) = bm.lock() {
+            let encoded = encode_packbits(&guard);
+            if encoded.len() > max_size {
+                return 0;
+            }
+            let out_slice = unsafe { std::slice::from_raw_parts_mut(output, encoded.len()) };
+            out_slice.copy_from_slice(&encoded);
+            return encoded.len();
         }
     }
     0
 }
 
-/// Get estimated compressed size
+/// Get compressed size
+///
+/// Exact for no compression, RLE and PackBits; an upper bound for the
+/// CCITT types.
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_bitmap_compressed_size(
     _ctx: Handle,
     bitmap: Handle,
-    _compression: i32,
+    compression: i32,
 ) -> usize {
     if let Some(bm) = BITMAPS.get(bitmap) {
         if let Ok(guard) = bm.lock() {
-            // Estimate: worst case is 2x for RLE (no compression)
-            // Best case is much smaller for repetitive data
-            return guard.data.len() * 2;
+            return match compression {
+                0 => guard.data.len(),
+                1 => encode_rle(&guard.data, &mut []),
+                4 => encode_packbits(&guard).len(),
+                // Worst case is 2x (no compression)
+                _ => guard.data.len() * 2,
+            };
         }
     }
     0
@@ -717,4 +743,82 @@ mod tests {
 
         fz_drop_bitmap(0, bm);
     }
+
+    #[test]
+    fn test_halftone_matches_per_pixel() {
+        use crate::ffi::colorspace::FZ_COLORSPACE_RGB;
+        use crate::ffi::pixmap::Pixmap;
+
+        let (w, h) = (53, 9);
+        let mut pix = Pixmap::new(FZ_COLORSPACE_RGB, w, h, true);
+        for (i, s) in pix.samples_mut().iter_mut().enumerate() {
+            *s = (i * 89 % 256) as u8;
+        }
+        let lum = |x: usize, y: usize| {
+            let p = &pix.samples()[y * pix.stride() as usize + x * 4..];
+            ((p[0] as u32 * 299 + p[1] as u32 * 587 + p[2] as u32 * 114) / 1000) as u8
+        };
+
+        let ordered = halftone_pixmap(&pix, HalftoneType::Ordered);
+        let threshold = threshold_pixmap(&pix, 100);
+        for y in 0..h as usize {
+            for x in 0..w as usize {
+                let bit =
+                    |bm: &Bitmap| (bm.data[y * bm.stride as usize + x / 8] >> (7 - x % 8)) & 1;
+                assert_eq!(bit(&ordered), (lum(x, y) < BAYER_4X4[y % 4][x % 4]) as u8);
+                assert_eq!(bit(&threshold), (lum(x, y) < 100) as u8);
+            }
+            // Padding bits stay clear
+            assert_eq!(threshold.data[y * 7 + 6] & 0b111, 0);
+        }
+    }
+
+    #[test]
+    fn test_packbits_roundtrip() {
+        let bm = fz_new_bitmap(0, 2000, 3, 72, 72);
+        {
+            let b = BITMAPS.get(bm).unwrap();
+            let mut b = b.lock().unwrap();
+            for (i, byte) in b.data.iter_mut().enumerate() {
+                // Long runs, short runs and noisy stretches
+                *byte = match i % 250 {
+                    0..=99 => 0,
+                    100..=101 => 0xF0,
+                    _ => (i * 31 % 7) as u8,
+                };
+            }
+        }
+
+        let size = fz_bitmap_compressed_size(0, bm, BitmapCompression::PackBits as i32);
+        let mut out = vec![0u8; size];
+        assert_eq!(
+            fz_bitmap_compress_packbits(0, bm, out.as_mut_ptr(), size - 1),
+            0
+        );
+        assert_eq!(
+            fz_bitmap_compress_packbits(0, bm, out.as_mut_ptr(), size),
+            size
+        );
+
+        let mut decoded = Vec::new();
+        let mut i = 0;
+        while i < out.len() {
+            let code = out[i] as i8;
+            if code >= 0 {
+                decoded.extend_from_slice(&out[i + 1..i + 2 + code as usize]);
+                i += 2 + code as usize;
+            } else {
+                decoded.extend(std::iter::repeat_n(out[i + 1], (1 - code as i32) as usize));
+                i += 2;
+            }
+        }
+        let b = BITMAPS.get(bm).unwrap();
+        assert_eq!(decoded, b.lock().unwrap().data);
+        assert!(size < decoded.len());
+
+        let rle = fz_bitmap_compressed_size(0, bm, BitmapCompression::RLE as i32);
+        let mut out = vec![0u8; rle];
+        assert_eq!(fz_bitmap_compress_rle(0, bm, out.as_mut_ptr(), rle), rle);
+        fz_drop_bitmap(0, bm);
+    }
 }
@@ -345,7 +345,7 @@ pub extern "C" fn fz_keep_buffer(_ctx: Handle, buf: Handle) -> Handle {
 /// Drop a buffer reference
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_drop_buffer(_ctx: Handle, buf: Handle) {
-    let _ = BUFFERS.remove(buf);
+    BUFFERS.release(buf);
 }
 
 /// Get buffer storage - returns length, optionally fills data pointer
@@ -1190,6 +1190,10 @@ mod tests {
         let kept = fz_keep_buffer(0, handle);
         assert_eq!(kept, handle);
         fz_drop_buffer(0, handle);
+        // The kept reference keeps the handle alive until it is dropped too
+        assert!(BUFFERS.get(handle).is_some());
+        fz_drop_buffer(0, kept);
+        assert!(BUFFERS.get(handle).is_none());
     }
 
     #[test]
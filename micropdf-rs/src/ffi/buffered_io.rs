@@ -17,6 +17,7 @@ use std::sync::atomic::{AtomicU64, Ordering};
 use std::sync::{Arc, LazyLock, Mutex};
 
 use super::{Handle, HandleStore};
+use bytes::Bytes;
 
 // ============================================================================
 // Buffered Writer
@@ -200,7 +201,7 @@ pub struct VectoredWriter {
     /// File handle
     file: File,
     /// Pending buffers
-    pending: Vec<Vec<u8>>,
+    pending: Vec<Bytes>,
     /// Maximum pending bytes before auto-flush
     max_pending: usize,
     /// Current pending bytes
@@ -234,6 +235,12 @@ impl VectoredWriter {
 
     /// Queue a buffer for writing
     pub fn queue(&mut self, data: Vec<u8>) -> io::Result<()> {
+        self.queue_bytes(Bytes::from(data))
+    }
+
+    /// Queue shared bytes, such as a slice of a mapped file, without
+    /// copying them
+    pub fn queue_bytes(&mut self, data: Bytes) -> io::Result<()> {
         self.stats.writes.fetch_add(1, Ordering::Relaxed);
 
         self.pending_bytes += data.len();
@@ -253,7 +260,7 @@ impl VectoredWriter {
 
     /// Queue a slice (copies data)
     pub fn queue_slice(&mut self, data: &[u8]) -> io::Result<()> {
-        self.queue(data.to_vec())
+        self.queue_bytes(Bytes::copy_from_slice(data))
     }
 
     /// Flush all pending buffers using vectored I/O
@@ -265,13 +272,21 @@ impl VectoredWriter {
         self.stats.flushes.fetch_add(1, Ordering::Relaxed);
 
         // Build IoSlice array
-        let slices: Vec<IoSlice> = self.pending.iter().map(|b| IoSlice::new(b)).collect();
-
-        // Write all buffers in one syscall
-        let bytes_written = self.file.write_vectored(&slices)?;
-        self.stats
-            .bytes_written
-            .fetch_add(bytes_written as u64, Ordering::Relaxed);
+        let mut slices: Vec<IoSlice> = self.pending.iter().map(|b| IoSlice::new(b)).collect();
+        let mut slices = &mut slices[..];
+
+        // Usually one syscall; writev may stop short (or at IOV_MAX
+        // buffers), so keep going until everything is out
+        while !slices.is_empty() {
+            let bytes_written = self.file.write_vectored(slices)?;
+            if bytes_written == 0 {
+                return Err(io::ErrorKind::WriteZero.into());
+            }
+            self.stats
+                .bytes_written
+                .fetch_add(bytes_written as u64, Ordering::Relaxed);
+            IoSlice::advance_slices(&mut slices, bytes_written);
+        }
 
         // Clear pending
         self.pending.clear();
@@ -810,6 +825,24 @@ mod tests {
         assert_eq!(content, "1234567890");
     }
 
+    #[test]
+    fn test_vectored_writer_many_buffers() {
+        let temp = NamedTempFile::new().unwrap();
+        let path = temp.path();
+
+        // More buffers than one writev call takes (IOV_MAX is 1024)
+        let expected: Vec<u8> = (0..5000u32).flat_map(|i| i.to_le_bytes()).collect();
+        {
+            let mut writer = VectoredWriter::with_max_pending(path, usize::MAX).unwrap();
+            for chunk in expected.chunks(4) {
+                writer.queue(chunk.to_vec()).unwrap();
+            }
+            writer.flush().unwrap();
+        }
+
+        assert_eq!(std::fs::read(path).unwrap(), expected);
+    }
+
     #[test]
     #[cfg(unix)] // Vectored I/O works differently on Windows
     fn test_vectored_writer_stats() {
@@ -2,12 +2,19 @@
 //!
 //! Provides support for comic book archive formats, including ZIP-based CBZ
 //! and RAR-based CBR, with image sequence handling and ComicInfo.xml metadata.
+//!
+//! Page images are read from the document's archive on demand; stored
+//! entries share the archive's memory-mapped bytes and compressed ones are
+//! decoded in parallel by `cbz_load_pages`.
 
+use crate::ffi::archive::ARCHIVES;
 use crate::ffi::{Handle, HandleStore};
+use crate::fitz::archive::Archive;
+use bytes::Bytes;
 use std::collections::HashMap;
 use std::ffi::{CStr, CString, c_char};
 use std::ptr;
-use std::sync::LazyLock;
+use std::sync::{Arc, LazyLock, Mutex};
 
 // ============================================================================
 // Type Aliases
@@ -189,8 +196,8 @@ pub struct CbzPage {
     pub width: i32,
     /// Image height (pixels)
     pub height: i32,
-    /// Image data (raw bytes)
-    pub data: Vec<u8>,
+    /// Image data (raw bytes); empty until loaded from the archive
+    pub data: Bytes,
     /// Page type (e.g., "FrontCover", "Story")
     pub page_type: Option<String>,
     /// Is double page spread
@@ -207,7 +214,7 @@ impl CbzPage {
             format: CBZ_IMAGE_UNKNOWN,
             width: 0,
             height: 0,
-            data: Vec::new(),
+            data: Bytes::new(),
             page_type: None,
             double_page: false,
             bookmark: None,
@@ -252,8 +259,8 @@ pub struct CbzDocument {
     pub pages: Vec<CbzPage>,
     /// File entries in archive
     pub entries: Vec<String>,
-    /// Raw archive data
-    pub archive_data: Vec<u8>,
+    /// Archive the pages are read from
+    pub archive: Option<Arc<Mutex<Archive>>>,
 }
 
 impl CbzDocument {
@@ -264,7 +271,7 @@ impl CbzDocument {
             info: ComicInfo::new(),
             pages: Vec::new(),
             entries: Vec::new(),
-            archive_data: Vec::new(),
+            archive: None,
         }
     }
 
@@ -300,6 +307,50 @@ impl CbzDocument {
         }
         self.entries.push(name.to_string());
     }
+
+    /// Take the pages from an archive's entries, in natural order
+    pub fn set_archive(&mut self, archive: Arc<Mutex<Archive>>) {
+        self.pages.clear();
+        self.entries.clear();
+        let names: Vec<String> = match archive.lock() {
+            Ok(a) => a.entry_names().into_iter().map(str::to_string).collect(),
+            Err(_) => Vec::new(),
+        };
+        for name in &names {
+            self.add_entry(name);
+        }
+        self.sort_pages();
+        for (i, page) in self.pages.iter_mut().enumerate() {
+            page.index = i as i32;
+        }
+        self.archive = Some(archive);
+    }
+
+    /// Read the image data of pages `first..first + count` not yet loaded,
+    /// decoding the entries on up to `threads` threads (0 for one per core)
+    ///
+    /// Returns the number of those pages whose data is now loaded.
+    pub fn load_pages(&mut self, first: usize, count: usize, threads: usize) -> usize {
+        let end = first.saturating_add(count).min(self.pages.len());
+        let Some(pages) = self.pages.get_mut(first..end) else {
+            return 0;
+        };
+        let Some(Ok(archive)) = self.archive.as_ref().map(|a| a.lock()) else {
+            return pages.iter().filter(|p| !p.data.is_empty()).count();
+        };
+
+        let mut wanted: Vec<&mut CbzPage> =
+            pages.iter_mut().filter(|p| p.data.is_empty()).collect();
+        let names: Vec<&str> = wanted.iter().map(|p| p.filename.as_str()).collect();
+        let results = archive.read_entries(&names, threads);
+        for (page, data) in wanted.iter_mut().zip(results) {
+            if let Ok(data) = data {
+                page.data = data;
+            }
+        }
+        drop(wanted);
+        pages.iter().filter(|p| !p.data.is_empty()).count()
+    }
 }
 
 // ============================================================================
@@ -394,6 +445,9 @@ pub extern "C" fn cbz_open_document(ctx: ContextHandle, filename: *const c_char)
     let path = unsafe { CStr::from_ptr(filename).to_string_lossy() };
 
     let mut doc = CbzDocument::new(ctx);
+    if let Ok(archive) = Archive::open(path.as_ref()) {
+        doc.set_archive(Arc::new(Mutex::new(archive)));
+    }
 
     // Detect format from extension
     let lower = path.to_lowercase();
@@ -426,9 +480,12 @@ pub extern "C" fn cbz_open_document_with_stream(
 #[unsafe(no_mangle)]
 pub extern "C" fn cbz_open_document_with_archive(
     ctx: ContextHandle,
-    _archive: ArchiveHandle,
+    archive: ArchiveHandle,
 ) -> Handle {
-    let doc = CbzDocument::new(ctx);
+    let mut doc = CbzDocument::new(ctx);
+    if let Some(a) = ARCHIVES.get(archive) {
+        doc.set_archive(a);
+    }
     CBZ_DOCUMENTS.insert(doc)
 }
 
@@ -595,6 +652,57 @@ pub extern "C" fn cbz_set_page_double(
     0
 }
 
+/// Load the image data of pages `first..first + count` from the archive.
+///
+/// Entries not yet loaded are decoded on up to `threads` threads (0 for one
+/// per core). Returns the number of those pages with data loaded.
+#[unsafe(no_mangle)]
+pub extern "C" fn cbz_load_pages(
+    _ctx: ContextHandle,
+    doc: Handle,
+    first: i32,
+    count: i32,
+    threads: i32,
+) -> i32 {
+    if first < 0 || count <= 0 {
+        return 0;
+    }
+    if let Some(d) = CBZ_DOCUMENTS.get(doc) {
+        let mut d = d.lock().unwrap();
+        return d.load_pages(first as usize, count as usize, threads.max(0) as usize) as i32;
+    }
+    0
+}
+
+/// Get a page's image data, loading it from the archive if needed.
+///
+/// The data stays valid until the document is dropped. Returns null if the
+/// page does not exist or can't be read.
+#[unsafe(no_mangle)]
+pub extern "C" fn cbz_get_page_data(
+    _ctx: ContextHandle,
+    doc: Handle,
+    page_num: i32,
+    len: *mut usize,
+) -> *const u8 {
+    if page_num < 0 {
+        return ptr::null();
+    }
+    if let Some(d) = CBZ_DOCUMENTS.get(doc) {
+        let mut d = d.lock().unwrap();
+        if d.load_pages(page_num as usize, 1, 1) == 1 {
+            let data = &d.pages[page_num as usize].data;
+            if !len.is_null() {
+                unsafe {
+                    *len = data.len();
+                }
+            }
+            return data.as_ptr();
+        }
+    }
+    ptr::null()
+}
+
 // ============================================================================
 // FFI Functions - ComicInfo Metadata
 // ============================================================================
@@ -1088,4 +1196,41 @@ mod tests {
         assert_eq!(cbz_is_image_file(ctx, jpg.as_ptr()), 1);
         assert_eq!(cbz_is_image_file(ctx, xml.as_ptr()), 0);
     }
+
+    #[test]
+    fn test_ffi_open_and_load_pages() {
+        use crate::fitz::archive::build_test_zip;
+
+        let big = vec![7u8; 5000];
+        let zip = build_test_zip(&[
+            ("page10.jpg", b"ten", false),
+            ("ComicInfo.xml", b"<ComicInfo/>", true),
+            ("page2.png", &big, true),
+            ("page1.jpg", b"one", false),
+        ]);
+        let dir = tempfile::TempDir::new().unwrap();
+        let path = dir.path().join("book.cbz");
+        std::fs::write(&path, zip).unwrap();
+        let path = CString::new(path.to_str().unwrap()).unwrap();
+
+        let ctx = 0;
+        let doc = cbz_open_document(ctx, path.as_ptr());
+        assert_eq!(cbz_page_count(ctx, doc), 3);
+        let filename = cbz_get_page_filename(ctx, doc, 2);
+        unsafe {
+            assert_eq!(CStr::from_ptr(filename).to_string_lossy(), "page10.jpg");
+            cbz_free_string(filename);
+        }
+
+        assert_eq!(cbz_load_pages(ctx, doc, 0, 3, 3), 3);
+        assert_eq!(cbz_load_pages(ctx, doc, 2, 10, 0), 1);
+        let mut len = 0;
+        let data = cbz_get_page_data(ctx, doc, 1, &mut len);
+        assert_eq!(unsafe { std::slice::from_raw_parts(data, len) }, &big[..]);
+        let data = cbz_get_page_data(ctx, doc, 0, &mut len);
+        assert_eq!(unsafe { std::slice::from_raw_parts(data, len) }, b"one");
+        assert!(cbz_get_page_data(ctx, doc, 3, &mut len).is_null());
+
+        cbz_drop_document(ctx, doc);
+    }
 }
@@ -524,9 +524,32 @@ pub extern "C" fn fz_convert_color_with_params(
     dst_cs: ColorspaceHandle,
     dst: *mut f32,
     proof_cs: ColorspaceHandle,
-    _params: ColorParams,
+    params: ColorParams,
 ) {
-    // Delegate to existing convert function (params would affect ICC conversions)
+    use crate::ffi::colorspace::{convert_color_icc, fz_colorspace_n};
+
+    // ICC conversions are cached per intent and flags
+    let (src_n, dst_n) = (fz_colorspace_n(_ctx, src_cs), fz_colorspace_n(_ctx, dst_cs));
+    if !src.is_null() && !dst.is_null() && src_n > 0 && dst_n > 0 {
+        // SAFETY: Caller guarantees src and dst hold the colorspaces' components
+        let (src_slice, dst_slice) = unsafe {
+            (
+                std::slice::from_raw_parts(src, src_n as usize),
+                std::slice::from_raw_parts_mut(dst, dst_n as usize),
+            )
+        };
+        let flags = i32::from(params.bp) | i32::from(params.op) << 1 | i32::from(params.opm) << 2;
+        if convert_color_icc(
+            src_cs,
+            src_slice,
+            dst_cs,
+            dst_slice,
+            i32::from(params.ri),
+            flags,
+        ) {
+            return;
+        }
+    }
     crate::ffi::colorspace::fz_convert_color(_ctx, src_cs, src, dst_cs, dst, proof_cs);
 }
 
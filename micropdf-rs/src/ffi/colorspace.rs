@@ -2,8 +2,9 @@
 //! Safe Rust implementation
 
 use super::HandleStore;
+use super::icc::{self, DEVICE_BGR, DEVICE_CMYK, DEVICE_GRAY, DEVICE_RGB, IccProfile};
 use std::ffi::c_char;
-use std::sync::LazyLock;
+use std::sync::{Arc, LazyLock};
 
 /// Colorspace type enumeration
 #[repr(C)]
@@ -27,8 +28,9 @@ pub struct Colorspace {
     pub n: i32,
     pub name: String,
     pub base_cs: ColorspaceHandle,
-    pub lookup: Vec<u8>, // For indexed colorspaces
-    pub high: i32,       // For indexed colorspaces (max index)
+    pub lookup: Vec<u8>,              // For indexed colorspaces
+    pub high: i32,                    // For indexed colorspaces (max index)
+    pub icc: Option<Arc<IccProfile>>, // For ICC colorspaces
 }
 
 impl Default for Colorspace {
@@ -40,6 +42,7 @@ impl Default for Colorspace {
             base_cs: 0,
             lookup: Vec::new(),
             high: 0,
+            icc: None,
         }
     }
 }
@@ -83,7 +86,7 @@ fn colorspace_n(handle: ColorspaceHandle) -> i32 {
 }
 
 /// Get colorspace type
-fn colorspace_type(handle: ColorspaceHandle) -> ColorspaceType {
+pub(crate) fn colorspace_type(handle: ColorspaceHandle) -> ColorspaceType {
     match handle {
         FZ_COLORSPACE_GRAY => ColorspaceType::Gray,
         FZ_COLORSPACE_RGB => ColorspaceType::Rgb,
@@ -103,6 +106,55 @@ fn colorspace_type(handle: ColorspaceHandle) -> ColorspaceType {
     }
 }
 
+/// ICC profile a colorspace converts with: its own for ICC-based ones,
+/// the stand-in profile for device ones
+pub(crate) fn colorspace_profile(handle: ColorspaceHandle) -> Option<Arc<IccProfile>> {
+    match handle {
+        FZ_COLORSPACE_GRAY => Some(Arc::clone(&DEVICE_GRAY)),
+        FZ_COLORSPACE_RGB => Some(Arc::clone(&DEVICE_RGB)),
+        FZ_COLORSPACE_BGR => Some(Arc::clone(&DEVICE_BGR)),
+        FZ_COLORSPACE_CMYK => Some(Arc::clone(&DEVICE_CMYK)),
+        h if h >= CUSTOM_CS_OFFSET => COLORSPACES
+            .get(h - CUSTOM_CS_OFFSET)
+            .and_then(|cs| cs.lock().ok()?.icc.clone()),
+        _ => None,
+    }
+}
+
+/// The cached transform between two colorspaces, if either is ICC-based
+/// and both have profiles
+pub(crate) fn icc_transform(
+    src_cs: ColorspaceHandle,
+    dst_cs: ColorspaceHandle,
+    intent: i32,
+    flags: i32,
+) -> Option<Arc<icc::IccTransform>> {
+    let is_icc = |cs| colorspace_type(cs) == ColorspaceType::Icc;
+    if !is_icc(src_cs) && !is_icc(dst_cs) {
+        return None;
+    }
+    let (src, dst) = (colorspace_profile(src_cs)?, colorspace_profile(dst_cs)?);
+    Some(icc::transform(&src, &dst, intent, flags))
+}
+
+/// Convert `src` to `dst` through an ICC transform; false if there is none
+pub(crate) fn convert_color_icc(
+    src_cs: ColorspaceHandle,
+    src: &[f32],
+    dst_cs: ColorspaceHandle,
+    dst: &mut [f32],
+    intent: i32,
+    flags: i32,
+) -> bool {
+    let Some(transform) = icc_transform(src_cs, dst_cs, intent, flags) else {
+        return false;
+    };
+    let out = transform.eval(src);
+    let n = dst.len().min(4);
+    dst[..n].copy_from_slice(&out[..n]);
+    true
+}
+
 /// Get device gray colorspace
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_device_gray(_ctx: super::Handle) -> ColorspaceHandle {
@@ -270,6 +322,7 @@ pub extern "C" fn fz_new_indexed_colorspace(
         base_cs: base,
         lookup: lookup_data,
         high,
+        icc: None,
     };
 
     COLORSPACES.insert(cs) + CUSTOM_CS_OFFSET
@@ -297,6 +350,7 @@ pub extern "C" fn fz_new_device_n_colorspace(
         base_cs: base,
         lookup: Vec::new(),
         high: 0,
+        icc: None,
     };
 
     COLORSPACES.insert(cs) + CUSTOM_CS_OFFSET
@@ -312,11 +366,21 @@ pub extern "C" fn fz_new_icc_colorspace(
     _type_hint: i32, // Hint about what type of colorspace (gray, rgb, cmyk)
     _flags: i32,
     name: *const c_char,
-    _data: *const u8,
-    _size: usize,
+    data: *const u8,
+    size: usize,
 ) -> ColorspaceHandle {
-    // Determine components from type hint or default to RGB
-    let n = 3; // Default to RGB
+    let profile = if data.is_null() || size == 0 {
+        None
+    } else {
+        IccProfile::parse(unsafe { std::slice::from_raw_parts(data, size) }).map(Arc::new)
+    };
+    // Components from the profile, or default to RGB
+    let n = profile.as_ref().map_or(3, |p| p.n() as i32);
+    let base_cs = match n {
+        1 => FZ_COLORSPACE_GRAY,
+        4 => FZ_COLORSPACE_CMYK,
+        _ => FZ_COLORSPACE_RGB,
+    };
 
     let cs_name = if name.is_null() {
         "ICCBased".to_string()
@@ -329,9 +393,10 @@ pub extern "C" fn fz_new_icc_colorspace(
         cs_type: ColorspaceType::Icc,
         n,
         name: cs_name,
-        base_cs: FZ_COLORSPACE_RGB,
+        base_cs,
         lookup: Vec::new(),
         high: 0,
+        icc: profile,
     };
 
     COLORSPACES.insert(cs) + CUSTOM_CS_OFFSET
@@ -415,6 +480,10 @@ pub extern "C" fn fz_convert_color(
         )
     };
 
+    if convert_color_icc(src_cs, src_slice, dst_cs, dst_slice, 0, 0) {
+        return;
+    }
+
     // Simple color conversion (Gray -> RGB, RGB -> Gray, etc.)
     match (colorspace_type(src_cs), colorspace_type(dst_cs)) {
         (ColorspaceType::Gray, ColorspaceType::Rgb) => {
@@ -941,6 +1010,26 @@ mod tests {
         assert_eq!(fz_colorspace_n(0, cs), 3);
     }
 
+    #[test]
+    fn test_icc_colorspace_converts_through_profile() {
+        let data = crate::ffi::icc::tests::profile(b"GRAY", &[]);
+        let cs = fz_new_icc_colorspace(0, 0, 0, std::ptr::null(), data.as_ptr(), data.len());
+        assert_eq!(fz_colorspace_n(0, cs), 1);
+        assert_eq!(fz_colorspace_base(0, cs), FZ_COLORSPACE_GRAY);
+
+        // Without a kTRC the profile has sRGB's curve, so its grays are sRGB's
+        let mut rgb = [0.0f32; 3];
+        fz_convert_color(
+            0,
+            cs,
+            [0.25f32].as_ptr(),
+            FZ_COLORSPACE_RGB,
+            rgb.as_mut_ptr(),
+            0,
+        );
+        assert!(rgb.iter().all(|&c| (c - 0.25).abs() < 2e-3), "{rgb:?}");
+    }
+
     #[test]
     fn test_new_icc_colorspace_with_name() {
         let name = c"sRGB IEC61966-2.1";
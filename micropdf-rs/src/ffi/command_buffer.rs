@@ -0,0 +1,404 @@
+//! Command buffers - many FFI operations in a single call
+//!
+//! Every call from Node, Go or Python pays a fixed crossing cost that can
+//! dwarf the work of small operations such as bounding a page. A command
+//! buffer lets a binding encode a whole sequence (load a page, bound it,
+//! render it, encode it, drop it) into one byte buffer, run it with
+//! `fz_run_command_buffer` and read every result back at once.
+//!
+//! Commands are packed little-endian: one opcode byte followed by the
+//! operands listed for it below. A handle operand is either a plain handle
+//! or `FZ_CMD_RESULT | i`, the handle produced by command `i` of the same
+//! buffer, so a sequence can use the page it just loaded.
+//!
+//! Each command writes one `FZ_CMD_RESULT_SIZE` byte record: an `i32`
+//! status (0 on success, -1 on failure), 4 reserved bytes and a 16-byte
+//! payload holding an `i64` (count or handle) or an `fz_rect`. A failed
+//! command does not stop the buffer; commands using its result fail in
+//! turn, while drops of other objects still run.
+
+use std::ffi::CStr;
+
+use super::buffer::{Buffer, fz_drop_buffer};
+use super::document::{
+    fz_bound_page, fz_count_pages, fz_drop_page, fz_load_page, fz_new_pixmap_from_page,
+};
+use super::geometry::{fz_matrix, fz_rect};
+use super::pixmap::fz_drop_pixmap;
+use super::stext::{fz_drop_stext_page, fz_new_stext_page_from_page, fz_stext_page_as_text};
+use super::write_pixmap::fz_new_buffer_from_pixmap_as_png;
+use super::{BUFFERS, Handle};
+
+/// `doc: u64` → page count
+pub const FZ_CMD_COUNT_PAGES: u8 = 1;
+/// `doc: u64, number: i32` → page handle
+pub const FZ_CMD_LOAD_PAGE: u8 = 2;
+/// `page: u64` → page bounds
+pub const FZ_CMD_BOUND_PAGE: u8 = 3;
+/// `page: u64, ctm: 6 × f32, cs: u64, alpha: i32` → pixmap handle
+pub const FZ_CMD_RENDER_PAGE: u8 = 4;
+/// `pixmap: u64` → buffer handle holding the PNG
+pub const FZ_CMD_ENCODE_PNG: u8 = 5;
+/// `page: u64` → buffer handle holding the page's plain text
+pub const FZ_CMD_PAGE_TEXT: u8 = 6;
+/// `page: u64`
+pub const FZ_CMD_DROP_PAGE: u8 = 7;
+/// `pixmap: u64`
+pub const FZ_CMD_DROP_PIXMAP: u8 = 8;
+/// `buffer: u64`
+pub const FZ_CMD_DROP_BUFFER: u8 = 9;
+
+/// Flag marking a handle operand as the result of an earlier command
+pub const FZ_CMD_RESULT: u64 = 1 << 63;
+
+/// Bytes per result record
+pub const FZ_CMD_RESULT_SIZE: usize = 24;
+
+/// Operand bytes following each opcode, or None for an unknown opcode
+fn operand_size(op: u8) -> Option<usize> {
+    match op {
+        FZ_CMD_COUNT_PAGES | FZ_CMD_BOUND_PAGE | FZ_CMD_ENCODE_PNG | FZ_CMD_PAGE_TEXT => Some(8),
+        FZ_CMD_DROP_PAGE | FZ_CMD_DROP_PIXMAP | FZ_CMD_DROP_BUFFER => Some(8),
+        FZ_CMD_LOAD_PAGE => Some(12),
+        FZ_CMD_RENDER_PAGE => Some(8 + 24 + 8 + 4),
+        _ => None,
+    }
+}
+
+/// Number of commands in `cmds`, or None if it is malformed
+fn count_commands(cmds: &[u8]) -> Option<usize> {
+    let mut pos = 0;
+    let mut count = 0;
+    while pos < cmds.len() {
+        pos += 1 + operand_size(cmds[pos])?;
+        count += 1;
+    }
+    (pos == cmds.len()).then_some(count)
+}
+
+/// Outcome of one command
+enum Outcome {
+    Failed,
+    Done,
+    Value(i64),
+    Rect(fz_rect),
+}
+
+struct Operands<'a> {
+    bytes: &'a [u8],
+    pos: usize,
+}
+
+impl Operands<'_> {
+    fn take<const N: usize>(&mut self) -> [u8; N] {
+        let mut out = [0; N];
+        out.copy_from_slice(&self.bytes[self.pos..self.pos + N]);
+        self.pos += N;
+        out
+    }
+
+    fn u64(&mut self) -> u64 {
+        u64::from_le_bytes(self.take())
+    }
+
+    fn i32(&mut self) -> i32 {
+        i32::from_le_bytes(self.take())
+    }
+
+    fn f32(&mut self) -> f32 {
+        f32::from_le_bytes(self.take())
+    }
+}
+
+/// Resolve a handle operand against earlier results; 0 if it names a
+/// later or failed command
+fn resolve(operand: u64, handles: &[Handle]) -> Handle {
+    if operand & FZ_CMD_RESULT == 0 {
+        return operand;
+    }
+    handles
+        .get((operand & 0xffff_ffff) as usize)
+        .copied()
+        .unwrap_or(0)
+}
+
+fn handle_outcome(handle: Handle) -> Outcome {
+    if handle == 0 {
+        Outcome::Failed
+    } else {
+        Outcome::Value(handle as i64)
+    }
+}
+
+fn page_text(ctx: Handle, page: Handle) -> Handle {
+    let stext = fz_new_stext_page_from_page(ctx, page, std::ptr::null());
+    if stext == 0 {
+        return 0;
+    }
+    let text = fz_stext_page_as_text(ctx, stext);
+    let buffer = if text.is_null() {
+        0
+    } else {
+        // SAFETY: fz_stext_page_as_text returns a NUL-terminated string that
+        // stays valid until the next call on this thread
+        let bytes = unsafe { CStr::from_ptr(text) }.to_bytes();
+        BUFFERS.insert(Buffer::from_data(bytes))
+    };
+    fz_drop_stext_page(ctx, stext);
+    buffer
+}
+
+fn run(ctx: Handle, op: u8, args: &mut Operands, handles: &[Handle]) -> Outcome {
+    let target = resolve(args.u64(), handles);
+    match op {
+        FZ_CMD_COUNT_PAGES if target != 0 => match fz_count_pages(ctx, target) {
+            n if n >= 0 => Outcome::Value(i64::from(n)),
+            _ => Outcome::Failed,
+        },
+        FZ_CMD_LOAD_PAGE => {
+            let number = args.i32();
+            if target == 0 {
+                return Outcome::Failed;
+            }
+            handle_outcome(fz_load_page(ctx, target, number))
+        }
+        FZ_CMD_BOUND_PAGE if target != 0 => {
+            if super::document::PAGES.get(target).is_none() {
+                return Outcome::Failed;
+            }
+            Outcome::Rect(fz_bound_page(ctx, target))
+        }
+        FZ_CMD_RENDER_PAGE => {
+            let ctm = fz_matrix {
+                a: args.f32(),
+                b: args.f32(),
+                c: args.f32(),
+                d: args.f32(),
+                e: args.f32(),
+                f: args.f32(),
+            };
+            let cs = resolve(args.u64(), handles);
+            let alpha = args.i32();
+            if target == 0 {
+                return Outcome::Failed;
+            }
+            handle_outcome(fz_new_pixmap_from_page(ctx, target, ctm, cs, alpha))
+        }
+        FZ_CMD_ENCODE_PNG if target != 0 => {
+            handle_outcome(fz_new_buffer_from_pixmap_as_png(ctx, target))
+        }
+        FZ_CMD_PAGE_TEXT if target != 0 => handle_outcome(page_text(ctx, target)),
+        FZ_CMD_DROP_PAGE if target != 0 => {
+            fz_drop_page(ctx, target);
+            Outcome::Done
+        }
+        FZ_CMD_DROP_PIXMAP if target != 0 => {
+            fz_drop_pixmap(ctx, target);
+            Outcome::Done
+        }
+        FZ_CMD_DROP_BUFFER if target != 0 => {
+            fz_drop_buffer(ctx, target);
+            Outcome::Done
+        }
+        _ => Outcome::Failed,
+    }
+}
+
+fn write_result(record: &mut [u8], outcome: &Outcome) {
+    record.fill(0);
+    let status: i32 = if matches!(outcome, Outcome::Failed) {
+        -1
+    } else {
+        0
+    };
+    record[..4].copy_from_slice(&status.to_le_bytes());
+    match outcome {
+        Outcome::Value(v) => record[8..16].copy_from_slice(&v.to_le_bytes()),
+        Outcome::Rect(r) => {
+            for (i, v) in [r.x0, r.y0, r.x1, r.y1].into_iter().enumerate() {
+                record[8 + i * 4..12 + i * 4].copy_from_slice(&v.to_le_bytes());
+            }
+        }
+        Outcome::Failed | Outcome::Done => {}
+    }
+}
+
+// ============================================================================
+// FFI Functions
+// ============================================================================
+
+/// Run a buffer of encoded commands
+///
+/// # Arguments
+/// * `cmds` - `len` bytes of packed commands (see the `FZ_CMD_*` opcodes)
+/// * `results` - Room for one `FZ_CMD_RESULT_SIZE` record per command
+/// * `results_cap` - Size of `results` in bytes
+///
+/// # Returns
+/// Number of commands run, or -1 if the buffer is malformed or `results`
+/// is too small; nothing runs in that case.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_run_command_buffer(
+    ctx: Handle,
+    cmds: *const u8,
+    len: usize,
+    results: *mut u8,
+    results_cap: usize,
+) -> i32 {
+    if len == 0 {
+        return 0;
+    }
+    if cmds.is_null() || results.is_null() {
+        return -1;
+    }
+    // SAFETY: caller guarantees `cmds` points to `len` readable bytes
+    let cmds = unsafe { std::slice::from_raw_parts(cmds, len) };
+    let Some(count) = count_commands(cmds) else {
+        return -1;
+    };
+    if count > i32::MAX as usize || results_cap < count * FZ_CMD_RESULT_SIZE {
+        return -1;
+    }
+    // SAFETY: caller guarantees `results` points to `results_cap` writable bytes
+    let results = unsafe { std::slice::from_raw_parts_mut(results, count * FZ_CMD_RESULT_SIZE) };
+
+    let mut handles: Vec<Handle> = Vec::with_capacity(count);
+    let mut args = Operands {
+        bytes: cmds,
+        pos: 0,
+    };
+    for record in results.chunks_exact_mut(FZ_CMD_RESULT_SIZE) {
+        let op = cmds[args.pos];
+        args.pos += 1;
+        let outcome = run(ctx, op, &mut args, &handles);
+        handles.push(match outcome {
+            Outcome::Value(v) if op != FZ_CMD_COUNT_PAGES => v as Handle,
+            _ => 0,
+        });
+        write_result(record, &outcome);
+    }
+    count as i32
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::DOCUMENTS;
+    use crate::ffi::colorspace::FZ_COLORSPACE_RGB;
+    use crate::ffi::document::Document;
+
+    fn push_handle(buf: &mut Vec<u8>, op: u8, handle: u64) {
+        buf.push(op);
+        buf.extend_from_slice(&handle.to_le_bytes());
+    }
+
+    fn status(results: &[u8], i: usize) -> i32 {
+        let r = &results[i * FZ_CMD_RESULT_SIZE..];
+        i32::from_le_bytes(r[..4].try_into().unwrap())
+    }
+
+    fn value(results: &[u8], i: usize) -> i64 {
+        let r = &results[i * FZ_CMD_RESULT_SIZE..];
+        i64::from_le_bytes(r[8..16].try_into().unwrap())
+    }
+
+    #[test]
+    fn test_load_bound_render_encode_drop() {
+        let doc = DOCUMENTS.insert(Document::new(
+            b"%PDF-1.4\n/Type /Page /MediaBox [0 0 200 100]\n%%EOF".to_vec(),
+        ));
+        let page = FZ_CMD_RESULT | 1;
+        let pixmap = FZ_CMD_RESULT | 3;
+
+        let mut cmds = Vec::new();
+        push_handle(&mut cmds, FZ_CMD_COUNT_PAGES, doc);
+        push_handle(&mut cmds, FZ_CMD_LOAD_PAGE, doc);
+        cmds.extend_from_slice(&0i32.to_le_bytes());
+        push_handle(&mut cmds, FZ_CMD_BOUND_PAGE, page);
+        push_handle(&mut cmds, FZ_CMD_RENDER_PAGE, page);
+        for v in [0.5f32, 0.0, 0.0, 0.5, 0.0, 0.0] {
+            cmds.extend_from_slice(&v.to_le_bytes());
+        }
+        cmds.extend_from_slice(&FZ_COLORSPACE_RGB.to_le_bytes());
+        cmds.extend_from_slice(&0i32.to_le_bytes());
+        push_handle(&mut cmds, FZ_CMD_ENCODE_PNG, pixmap);
+        push_handle(&mut cmds, FZ_CMD_DROP_PIXMAP, pixmap);
+        push_handle(&mut cmds, FZ_CMD_DROP_PAGE, page);
+
+        let mut results = vec![0u8; 7 * FZ_CMD_RESULT_SIZE];
+        let n = fz_run_command_buffer(
+            0,
+            cmds.as_ptr(),
+            cmds.len(),
+            results.as_mut_ptr(),
+            results.len(),
+        );
+        assert_eq!(n, 7);
+        assert!((0..7).all(|i| status(&results, i) == 0));
+        assert_eq!(value(&results, 0), 1);
+
+        let bounds = &results[2 * FZ_CMD_RESULT_SIZE + 8..];
+        let x1 = f32::from_le_bytes(bounds[8..12].try_into().unwrap());
+        assert!(x1 > 0.0);
+
+        let png = value(&results, 4) as Handle;
+        assert!(BUFFERS.get(png).is_some());
+        fz_drop_buffer(0, png);
+        assert!(
+            crate::ffi::PIXMAPS
+                .get(value(&results, 3) as Handle)
+                .is_none()
+        );
+        DOCUMENTS.remove(doc);
+    }
+
+    #[test]
+    fn test_failures_propagate_and_bad_buffers_run_nothing() {
+        let mut cmds = Vec::new();
+        push_handle(&mut cmds, FZ_CMD_LOAD_PAGE, 0);
+        cmds.extend_from_slice(&0i32.to_le_bytes());
+        push_handle(&mut cmds, FZ_CMD_BOUND_PAGE, FZ_CMD_RESULT);
+        push_handle(&mut cmds, FZ_CMD_DROP_PAGE, FZ_CMD_RESULT | 5);
+
+        let mut results = vec![0u8; 3 * FZ_CMD_RESULT_SIZE];
+        assert_eq!(
+            fz_run_command_buffer(
+                0,
+                cmds.as_ptr(),
+                cmds.len(),
+                results.as_mut_ptr(),
+                results.len()
+            ),
+            3
+        );
+        assert!((0..3).all(|i| status(&results, i) == -1));
+
+        // Too little room for the results
+        assert_eq!(
+            fz_run_command_buffer(
+                0,
+                cmds.as_ptr(),
+                cmds.len(),
+                results.as_mut_ptr(),
+                2 * FZ_CMD_RESULT_SIZE
+            ),
+            -1
+        );
+        // Truncated operand and unknown opcode
+        assert_eq!(
+            fz_run_command_buffer(
+                0,
+                cmds.as_ptr(),
+                cmds.len() - 1,
+                results.as_mut_ptr(),
+                results.len()
+            ),
+            -1
+        );
+        let bad = [0xffu8];
+        assert_eq!(
+            fz_run_command_buffer(0, bad.as_ptr(), 1, results.as_mut_ptr(), results.len()),
+            -1
+        );
+    }
+}
@@ -0,0 +1,536 @@
+//! Span Compositing
+//!
+//! Paints spans of premultiplied pixels onto others: Porter-Duff source
+//! over and the separable PDF blend modes, at a constant alpha and
+//! optionally through a mask. Spans are 8-bit gray, RGB or CMYK, each
+//! with or without alpha; a pixel without it is opaque. As with the
+//! pixmap colour conversion, pixels go eight at a time, one lane vector
+//! per component, with the arithmetic written once over `Lanes` and
+//! instantiated per instruction set, called through the kernel dispatch
+//! table; every instantiation gives the same bytes.
+//!
+//! CMYK is blended on complemented colours, complemented back after, as
+//! the blend modes are defined for subtractive spaces.
+
+// Allow unsafe operations inside unsafe functions (Rust 2024 edition compat)
+#![allow(unsafe_op_in_unsafe_fn)]
+
+use super::dispatch::kernels;
+use super::draw_device::BlendMode;
+use super::pixel_convert::{BLOCK, Lanes};
+use super::simd_util::SimdLevel;
+
+/// Smallest divisor when unpremultiplying and in the dodge and burn
+/// quotients, so transparent pixels divide to finite values
+const EPSILON: f32 = 1.0 / 65536.0;
+
+/// How one span is painted onto another
+#[derive(Debug, Clone, Copy)]
+pub struct SpanPaint {
+    /// Colorants per pixel: 1 (gray), 3 (RGB) or 4 (CMYK)
+    pub n: usize,
+    /// Whether destination pixels end with an alpha byte
+    pub dst_alpha: bool,
+    /// Whether source pixels end with an alpha byte
+    pub src_alpha: bool,
+    /// Constant opacity the source is painted with, 0 to 1
+    pub alpha: f32,
+    pub blend: BlendMode,
+}
+
+impl SpanPaint {
+    fn dst_n(&self) -> usize {
+        self.n + usize::from(self.dst_alpha)
+    }
+
+    fn src_n(&self) -> usize {
+        self.n + usize::from(self.src_alpha)
+    }
+
+    /// Whether spans can be painted this way: the non-separable blend
+    /// modes mix components and aren't painted by the span kernels
+    pub fn is_supported(&self) -> bool {
+        matches!(self.n, 1 | 3 | 4)
+            && !matches!(
+                self.blend,
+                BlendMode::Hue | BlendMode::Saturation | BlendMode::Color | BlendMode::Luminosity
+            )
+    }
+}
+
+// ============================================================================
+// Blend Modes
+// ============================================================================
+
+#[inline(always)]
+fn hard_light<V: Lanes>(b: V, s: V) -> V {
+    // Multiply by 2s up to one, screen with 2s - 1 past it
+    let (zero, one) = (V::splat(0.0), V::splat(1.0));
+    let t = s.add(s);
+    b.mul(t.min(one)).add(t.sub(one).max(zero).mul(one.sub(b)))
+}
+
+#[inline(always)]
+fn soft_light<V: Lanes>(b: V, s: V) -> V {
+    let one = V::splat(1.0);
+    let d = b.select_le(
+        V::splat(0.25),
+        b.mul(V::splat(16.0))
+            .sub(V::splat(12.0))
+            .mul(b)
+            .add(V::splat(4.0))
+            .mul(b),
+        b.sqrt(),
+    );
+    let darken = b.sub(one.sub(s.add(s)).mul(b).mul(one.sub(b)));
+    let lighten = b.add(s.add(s).sub(one).mul(d.sub(b)));
+    s.select_le(V::splat(0.5), darken, lighten)
+}
+
+/// Separable blend function of backdrop `b` and source `s`, both
+/// unpremultiplied in 0 to 1
+#[inline(always)]
+fn blend<V: Lanes>(mode: BlendMode, b: V, s: V) -> V {
+    let one = V::splat(1.0);
+    match mode {
+        BlendMode::Multiply => b.mul(s),
+        BlendMode::Screen => b.add(s).sub(b.mul(s)),
+        BlendMode::Overlay => hard_light(s, b),
+        BlendMode::Darken => b.min(s),
+        BlendMode::Lighten => b.max(s),
+        BlendMode::ColorDodge => one.min(b.div(one.sub(s).max(V::splat(EPSILON)))),
+        BlendMode::ColorBurn => one.sub(one.min(one.sub(b).div(s.max(V::splat(EPSILON))))),
+        BlendMode::HardLight => hard_light(b, s),
+        BlendMode::SoftLight => soft_light(b, s),
+        BlendMode::Difference => b.max(s).sub(b.min(s)),
+        BlendMode::Exclusion => b.add(s).sub(b.mul(s).mul(V::splat(2.0))),
+        _ => s,
+    }
+}
+
+// ============================================================================
+// Kernels
+// ============================================================================
+
+/// A block of pixels in 0 to 1, one lane vector per component
+struct Planes<V> {
+    colour: [V; 4],
+    alpha: V,
+}
+
+/// Paint `s` onto `d` with `f` (mask times constant alpha) per pixel
+#[inline(always)]
+fn paint_block<V: Lanes, const N: usize>(
+    d: &mut Planes<V>,
+    s: &Planes<V>,
+    f: V,
+    blend_mode: BlendMode,
+) {
+    let (zero, one) = (V::splat(0.0), V::splat(1.0));
+    let sa = s.alpha.mul(f);
+    let da = d.alpha;
+    let keep = one.sub(sa);
+    let subtractive = N == 4;
+    for c in 0..N {
+        let cs = s.colour[c].mul(f);
+        let cb = d.colour[c];
+        d.colour[c] = match blend_mode {
+            BlendMode::Normal => cs.add(cb.mul(keep)),
+            mode => {
+                // Subtractive colours blend complemented, premultiplied
+                let (cb, cs) = match subtractive {
+                    true => (da.sub(cb.min(da)), sa.sub(cs.min(sa))),
+                    false => (cb, cs),
+                };
+                let b = cb.div(da.max(V::splat(EPSILON))).min(one);
+                let source = s.colour[c].div(s.alpha.max(V::splat(EPSILON))).min(one);
+                let source = match subtractive {
+                    true => one.sub(source),
+                    false => source,
+                };
+                let blended = keep
+                    .mul(cb)
+                    .add(one.sub(da).mul(cs))
+                    .add(sa.mul(da).mul(blend(mode, b, source)));
+                match subtractive {
+                    true => sa.add(da).sub(sa.mul(da)).sub(blended).max(zero),
+                    false => blended,
+                }
+            }
+        };
+    }
+    d.alpha = sa.add(da).sub(sa.mul(da));
+}
+
+/// Paint `count` pixels of `src` onto `dst`, `BLOCK` at a time, for
+/// `N` colorants and alpha in the destination if `DA`, the source if `SA`
+///
+/// The layout is a constant so the loops between bytes and lanes unroll.
+#[inline(always)]
+fn paint_layout<V: Lanes, const N: usize, const DA: bool, const SA: bool>(
+    dst: &mut [u8],
+    src: &[u8],
+    mask: Option<&[u8]>,
+    count: usize,
+    paint: &SpanPaint,
+) {
+    let (dn, sn) = (N + usize::from(DA), N + usize::from(SA));
+    let scale = V::splat(1.0 / 255.0);
+    let mut bytes = [[0u8; BLOCK]; 11];
+    let mut start = 0;
+    while start < count {
+        let len = BLOCK.min(count - start);
+        let src = &src[start * sn..(start + len) * sn];
+        let dst = &mut dst[start * dn..(start + len) * dn];
+
+        // Colours 0..4 and alpha 4 of the destination, 5..10 of the
+        // source, then the mask
+        bytes[4] = [255; BLOCK];
+        bytes[9] = [255; BLOCK];
+        bytes[10] = [255; BLOCK];
+        for i in 0..len {
+            let (d, s) = (&dst[i * dn..][..dn], &src[i * sn..][..sn]);
+            for c in 0..N {
+                bytes[c][i] = d[c];
+                bytes[5 + c][i] = s[c];
+            }
+            if DA {
+                bytes[4][i] = d[N];
+            }
+            if SA {
+                bytes[9][i] = s[N];
+            }
+        }
+        if let Some(mask) = mask {
+            bytes[10][..len].copy_from_slice(&mask[start..start + len]);
+        }
+
+        let mut d = Planes {
+            colour: std::array::from_fn(|c| to_unit::<V>(scale, &bytes[c])),
+            alpha: to_unit::<V>(scale, &bytes[4]),
+        };
+        let s = Planes {
+            colour: std::array::from_fn(|c| to_unit::<V>(scale, &bytes[5 + c])),
+            alpha: to_unit::<V>(scale, &bytes[9]),
+        };
+        let f = to_unit::<V>(scale, &bytes[10]).mul(V::splat(paint.alpha));
+        paint_block::<V, N>(&mut d, &s, f, paint.blend);
+
+        for (c, v) in d.colour.into_iter().enumerate().take(N) {
+            to_byte::<V>(v, &mut bytes[c]);
+        }
+        to_byte::<V>(d.alpha, &mut bytes[4]);
+        for i in 0..len {
+            let d = &mut dst[i * dn..][..dn];
+            for c in 0..N {
+                d[c] = bytes[c][i];
+            }
+            if DA {
+                d[N] = bytes[4][i];
+            }
+        }
+        start += len;
+    }
+}
+
+#[inline(always)]
+fn to_unit<V: Lanes>(scale: V, bytes: &[u8; BLOCK]) -> V {
+    V::load_bytes(bytes).mul(scale)
+}
+
+#[inline(always)]
+fn to_byte<V: Lanes>(v: V, out: &mut [u8; BLOCK]) {
+    v.mul(V::splat(255.0))
+        .add(V::splat(0.5))
+        .min(V::splat(255.0))
+        .max(V::splat(0.0))
+        .store_bytes(out)
+}
+
+/// [`paint_layout`] for the layout of `paint`
+#[inline(always)]
+fn paint_run<V: Lanes>(
+    dst: &mut [u8],
+    src: &[u8],
+    mask: Option<&[u8]>,
+    count: usize,
+    paint: &SpanPaint,
+) {
+    match paint.n {
+        1 => paint_colorants::<V, 1>(dst, src, mask, count, paint),
+        3 => paint_colorants::<V, 3>(dst, src, mask, count, paint),
+        _ => paint_colorants::<V, 4>(dst, src, mask, count, paint),
+    }
+}
+
+#[inline(always)]
+fn paint_colorants<V: Lanes, const N: usize>(
+    dst: &mut [u8],
+    src: &[u8],
+    mask: Option<&[u8]>,
+    count: usize,
+    paint: &SpanPaint,
+) {
+    match (paint.dst_alpha, paint.src_alpha) {
+        (true, true) => paint_layout::<V, N, true, true>(dst, src, mask, count, paint),
+        (true, false) => paint_layout::<V, N, true, false>(dst, src, mask, count, paint),
+        (false, true) => paint_layout::<V, N, false, true>(dst, src, mask, count, paint),
+        (false, false) => paint_layout::<V, N, false, false>(dst, src, mask, count, paint),
+    }
+}
+
+/// Span painter, as held in the kernel dispatch table
+pub(super) type PaintFn = unsafe fn(&mut [u8], &[u8], Option<&[u8]>, usize, &SpanPaint);
+
+/// Painter the dispatch table uses at `level`
+pub(super) fn paint_kernel(level: SimdLevel) -> PaintFn {
+    match level {
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        SimdLevel::Avx2 => paint_avx2,
+        #[cfg(target_arch = "aarch64")]
+        SimdLevel::Neon => paint_neon,
+        _ => paint_scalar,
+    }
+}
+
+fn paint_scalar(dst: &mut [u8], src: &[u8], mask: Option<&[u8]>, count: usize, paint: &SpanPaint) {
+    paint_run::<[f32; BLOCK]>(dst, src, mask, count, paint)
+}
+
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "avx2")]
+unsafe fn paint_avx2(
+    dst: &mut [u8],
+    src: &[u8],
+    mask: Option<&[u8]>,
+    count: usize,
+    paint: &SpanPaint,
+) {
+    paint_run::<super::pixel_convert::avx2::Avx2>(dst, src, mask, count, paint)
+}
+
+#[cfg(target_arch = "aarch64")]
+#[target_feature(enable = "neon")]
+unsafe fn paint_neon(
+    dst: &mut [u8],
+    src: &[u8],
+    mask: Option<&[u8]>,
+    count: usize,
+    paint: &SpanPaint,
+) {
+    paint_run::<super::pixel_convert::neon::Neon>(dst, src, mask, count, paint)
+}
+
+fn paint_span_with(
+    dst: &mut [u8],
+    src: &[u8],
+    mask: Option<&[u8]>,
+    count: usize,
+    paint: &SpanPaint,
+    simd: bool,
+) -> bool {
+    if !paint.is_supported()
+        || dst.len() < count * paint.dst_n()
+        || src.len() < count * paint.src_n()
+        || mask.is_some_and(|m| m.len() < count)
+    {
+        return false;
+    }
+    let paint = SpanPaint {
+        alpha: paint.alpha.clamp(0.0, 1.0),
+        ..*paint
+    };
+    let paint_fn: PaintFn = if simd {
+        kernels().paint_span
+    } else {
+        paint_scalar
+    };
+    // The table only holds kernels the CPU runs
+    unsafe { paint_fn(dst, src, mask, count, &paint) };
+    true
+}
+
+/// Paint `count` pixels of `src` onto `dst` as `paint` says, each source
+/// pixel scaled by its `mask` byte if there is a mask
+///
+/// Returns false, leaving `dst` alone, if `paint` isn't supported or the
+/// buffers don't hold `count` pixels.
+pub fn paint_span(
+    dst: &mut [u8],
+    src: &[u8],
+    mask: Option<&[u8]>,
+    count: usize,
+    paint: &SpanPaint,
+) -> bool {
+    paint_span_with(dst, src, mask, count, paint, true)
+}
+
+/// [`paint_span`] on the scalar kernel, whatever the CPU has
+pub fn paint_span_scalar(
+    dst: &mut [u8],
+    src: &[u8],
+    mask: Option<&[u8]>,
+    count: usize,
+    paint: &SpanPaint,
+) -> bool {
+    paint_span_with(dst, src, mask, count, paint, false)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const SEPARABLE: [BlendMode; 12] = [
+        BlendMode::Normal,
+        BlendMode::Multiply,
+        BlendMode::Screen,
+        BlendMode::Overlay,
+        BlendMode::Darken,
+        BlendMode::Lighten,
+        BlendMode::ColorDodge,
+        BlendMode::ColorBurn,
+        BlendMode::HardLight,
+        BlendMode::SoftLight,
+        BlendMode::Difference,
+        BlendMode::Exclusion,
+    ];
+
+    fn paint(n: usize, blend: BlendMode) -> SpanPaint {
+        SpanPaint {
+            n,
+            dst_alpha: true,
+            src_alpha: true,
+            alpha: 1.0,
+            blend,
+        }
+    }
+
+    #[test]
+    fn test_over_covers_and_keeps() {
+        let mut dst = [10, 20, 30, 255, 10, 20, 30, 255];
+        // Opaque red over the first pixel, transparent over the second
+        let src = [255, 0, 0, 255, 0, 0, 0, 0];
+        assert!(paint_span(
+            &mut dst,
+            &src,
+            None,
+            2,
+            &paint(3, BlendMode::Normal)
+        ));
+        assert_eq!(dst, [255, 0, 0, 255, 10, 20, 30, 255]);
+
+        // Half coverage through the mask, on an opaque destination
+        let mut dst = [200, 100];
+        let paint = SpanPaint {
+            dst_alpha: false,
+            ..paint(1, BlendMode::Normal)
+        };
+        assert!(paint_span(
+            &mut dst,
+            &[0, 255, 0, 255],
+            Some(&[128, 0]),
+            2,
+            &paint
+        ));
+        assert_eq!(dst, [100, 100]);
+    }
+
+    #[test]
+    fn test_blend_modes_on_opaque_pixels() {
+        let cases = [
+            (BlendMode::Multiply, 128, 128, 64),
+            (BlendMode::Screen, 128, 128, 192),
+            (BlendMode::Darken, 50, 200, 50),
+            (BlendMode::Lighten, 50, 200, 200),
+            (BlendMode::Difference, 50, 200, 150),
+            (BlendMode::ColorDodge, 0, 255, 0),
+            (BlendMode::ColorBurn, 255, 0, 255),
+            (BlendMode::HardLight, 100, 255, 255),
+            (BlendMode::Overlay, 255, 100, 255),
+        ];
+        for (mode, backdrop, source, expected) in cases {
+            let mut dst = [backdrop, 255];
+            assert!(paint_span(
+                &mut dst,
+                &[source, 255],
+                None,
+                1,
+                &paint(1, mode)
+            ));
+            assert!(
+                (i32::from(dst[0]) - expected).abs() <= 1,
+                "{mode:?}: {} vs {expected}",
+                dst[0]
+            );
+        }
+        // Multiplying inks darkens in CMYK too: the complements multiply
+        let mut dst = [0, 0, 0, 128, 255];
+        let src = [0, 0, 0, 128, 255];
+        assert!(paint_span(
+            &mut dst,
+            &src,
+            None,
+            1,
+            &paint(4, BlendMode::Multiply)
+        ));
+        assert_eq!(dst, [0, 0, 0, 192, 255]);
+    }
+
+    #[test]
+    fn test_non_separable_modes_unsupported() {
+        let mut dst = [0u8; 4];
+        assert!(!paint_span(
+            &mut dst,
+            &[0; 4],
+            None,
+            1,
+            &paint(3, BlendMode::Hue)
+        ));
+        assert!(!paint_span(
+            &mut dst,
+            &[0; 4],
+            None,
+            2,
+            &paint(3, BlendMode::Normal)
+        ));
+    }
+
+    #[test]
+    fn test_simd_matches_scalar() {
+        let count = 37;
+        let mut seed = 7u32;
+        let mut bytes = |len: usize| -> Vec<u8> {
+            (0..len)
+                .map(|_| {
+                    seed = seed.wrapping_mul(1_103_515_245).wrapping_add(12345);
+                    (seed >> 16) as u8
+                })
+                .collect()
+        };
+        let mask = bytes(count);
+        for n in [1, 3, 4] {
+            for mode in SEPARABLE {
+                for (dst_alpha, src_alpha) in [(true, true), (false, true), (true, false)] {
+                    let paint = SpanPaint {
+                        dst_alpha,
+                        src_alpha,
+                        alpha: 0.75,
+                        ..paint(n, mode)
+                    };
+                    let dst = bytes(count * paint.dst_n());
+                    let src = bytes(count * paint.src_n());
+                    let (mut simd, mut scalar) = (dst.clone(), dst);
+                    assert!(paint_span(&mut simd, &src, Some(&mask), count, &paint));
+                    assert!(paint_span_scalar(
+                        &mut scalar,
+                        &src,
+                        Some(&mask),
+                        count,
+                        &paint
+                    ));
+                    assert_eq!(simd, scalar, "{n} {mode:?} {dst_alpha} {src_alpha}");
+                }
+            }
+        }
+    }
+}
@@ -300,26 +300,18 @@ pub extern "C" fn fz_deflate(
 
     let deflate_level = DeflateLevel::from_i32(level);
     let source_slice = unsafe { std::slice::from_raw_parts(source, source_length) };
-    let dest_capacity = unsafe { *compressed_length };
-
-    let mut encoder = flate2::write::ZlibEncoder::new(
-        Vec::with_capacity(dest_capacity),
-        deflate_level.to_flate2_level(),
-    );
-
-    if encoder.write_all(source_slice).is_ok() {
-        if let Ok(compressed) = encoder.finish() {
-            let len = compressed.len().min(dest_capacity);
-            unsafe {
-                std::ptr::copy_nonoverlapping(compressed.as_ptr(), dest, len);
-                *compressed_length = len;
-            }
-            return;
-        }
-    }
-
+    let dest_slice = unsafe { std::slice::from_raw_parts_mut(dest, *compressed_length) };
+
+    // One call straight into the caller's buffer
+    let mut deflater = flate2::Compress::new(deflate_level.to_flate2_level(), true);
+    let status = deflater.compress(source_slice, dest_slice, flate2::FlushCompress::Finish);
+    let len = match status {
+        Ok(flate2::Status::StreamEnd) => deflater.total_out() as usize,
+        // Error, or `dest` too small for the whole stream
+        _ => 0,
+    };
     unsafe {
-        *compressed_length = 0;
+        *compressed_length = len;
     }
 }
 
@@ -975,21 +967,29 @@ pub extern "C" fn fz_inflate(
     }
 
     let source_slice = unsafe { std::slice::from_raw_parts(source, source_length) };
-    let dest_capacity = unsafe { *dest_length };
+    let dest_slice = unsafe { std::slice::from_raw_parts_mut(dest, *dest_length) };
 
-    let mut decoder = flate2::read::ZlibDecoder::new(source_slice);
-    let mut decompressed = Vec::with_capacity(dest_capacity);
-
-    if decoder.read_to_end(&mut decompressed).is_ok() {
-        let len = decompressed.len().min(dest_capacity);
-        unsafe {
-            std::ptr::copy_nonoverlapping(decompressed.as_ptr(), dest, len);
-            *dest_length = len;
+    // One call straight into the caller's buffer, no staging copy
+    match crate::pdf::filter::inflate_into(source_slice, dest_slice) {
+        Ok(len) => {
+            unsafe {
+                *dest_length = len;
+            }
+            0
         }
-        return 0;
+        Err(_) => -1,
     }
+}
 
-    -1
+/// Name of the inflate/deflate implementation this build uses
+/// ("miniz_oxide", "zlib-ng" or "zlib-rs")
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_flate_backend(_ctx: Handle) -> *const std::ffi::c_char {
+    match crate::pdf::filter::flate_backend() {
+        "zlib-ng" => c"zlib-ng".as_ptr(),
+        "zlib-rs" => c"zlib-rs".as_ptr(),
+        _ => c"miniz_oxide".as_ptr(),
+    }
 }
 
 /// Decompress brotli data
@@ -1023,6 +1023,17 @@ pub extern "C" fn fz_decompress_brotli(
     -1
 }
 
+/// Register a shared Brotli dictionary for saves and loads, returning the
+/// ID to set as `brotli_dictionary` in write options (0 on error)
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_register_brotli_dictionary(_ctx: Handle, data: *const u8, len: usize) -> u64 {
+    if data.is_null() || len == 0 {
+        return 0;
+    }
+    let dictionary = unsafe { std::slice::from_raw_parts(data, len) };
+    crate::pdf::filter::register_brotli_dictionary(dictionary)
+}
+
 // ============================================================================
 // Tests
 // ============================================================================
@@ -1332,4 +1343,13 @@ mod tests {
         let name = fz_image_type_name(ImageType::Unknown as i32);
         assert!(!name.is_null());
     }
+
+    #[test]
+    fn test_register_brotli_dictionary() {
+        let dictionary = b"BT /F1 12 Tf ET";
+        let id = fz_register_brotli_dictionary(0, dictionary.as_ptr(), dictionary.len());
+        assert_ne!(id, 0);
+        assert!(crate::pdf::filter::brotli_dictionary(id).is_some());
+        assert_eq!(fz_register_brotli_dictionary(0, std::ptr::null(), 4), 0);
+    }
 }
@@ -1,7 +1,7 @@
 //! C FFI for context - MuPDF compatible
 //! Simplified error handling without setjmp/longjmp
 
-use super::{CONTEXTS, Handle};
+use super::{CONTEXTS, Handle, store};
 use std::collections::HashMap;
 use std::ffi::{CStr, c_char, c_int, c_void};
 use std::sync::{Arc, LazyLock, Mutex};
@@ -58,25 +58,6 @@ impl Default for ContextSettings {
 static CONTEXT_SETTINGS: LazyLock<Mutex<HashMap<Handle, ContextSettings>>> =
     LazyLock::new(|| Mutex::new(HashMap::new()));
 
-/// Resource store tracking (for memory management)
-struct StoreState {
-    allocated_bytes: usize,
-    max_bytes: usize,
-}
-
-impl Default for StoreState {
-    fn default() -> Self {
-        Self {
-            allocated_bytes: 0,
-            max_bytes: 256 * 1024 * 1024, // 256 MB default
-        }
-    }
-}
-
-/// Global store state
-static STORE_STATE: LazyLock<Mutex<StoreState>> =
-    LazyLock::new(|| Mutex::new(StoreState::default()));
-
 /// Internal context state
 pub struct Context {
     /// Max store size in bytes
@@ -146,19 +127,59 @@ pub unsafe extern "C" fn fz_new_context(
     _locks: *const c_void, // fz_locks_context* - ignored, we use Rust sync
     max_store: usize,
 ) -> Handle {
+    // Pick the SIMD kernels once, before anything renders
+    super::dispatch::init();
     CONTEXTS.insert(Context::new(max_store))
 }
 
-/// Clone a context (returns same handle with incremented refcount)
+/// Clone a context for use on another thread
+///
+/// The clone has its own error state but inherits the store limit, user
+/// data, callbacks and AA/ICC settings of the original. The resource store
+/// and glyph cache are process-wide, so clones share them with the parent.
+/// Returns 0 if `ctx` is not a valid context.
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_clone_context(ctx: Handle) -> Handle {
-    CONTEXTS.keep(ctx)
+    let Some(context) = CONTEXTS.get(ctx) else {
+        return 0;
+    };
+    let clone = {
+        let Ok(guard) = context.lock() else {
+            return 0;
+        };
+        Context {
+            max_store: guard.max_store,
+            error: Arc::new(Mutex::new(ErrorState::default())),
+            user_data: guard.user_data,
+            warn_callback: guard.warn_callback,
+            error_callback: guard.error_callback,
+        }
+    };
+    let handle = CONTEXTS.insert(clone);
+
+    if let Ok(mut settings) = CONTEXT_SETTINGS.lock() {
+        if let Some(parent) = settings.get(&ctx) {
+            let inherited = ContextSettings {
+                icc_enabled: parent.icc_enabled,
+                aa_level: parent.aa_level,
+            };
+            settings.insert(handle, inherited);
+        }
+    }
+    handle
 }
 
-/// Drop a context
+/// Drop a context reference
+///
+/// Balances fz_new_context, fz_clone_context or fz_keep_context. Dropping
+/// a clone never affects the context it was cloned from.
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_drop_context(ctx: Handle) {
-    let _ = CONTEXTS.remove(ctx);
+    if CONTEXTS.release(ctx) {
+        if let Ok(mut settings) = CONTEXT_SETTINGS.lock() {
+            settings.remove(&ctx);
+        }
+    }
 }
 
 /// Set user data on context
@@ -420,10 +441,10 @@ pub extern "C" fn fz_new_default_context() -> Handle {
     unsafe { fz_new_context(std::ptr::null(), std::ptr::null(), 256 * 1024 * 1024) } // 256 MB default
 }
 
-/// Keep a context (alias for clone, increments refcount)
+/// Keep a context (returns same handle with incremented refcount)
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_keep_context(ctx: Handle) -> Handle {
-    fz_clone_context(ctx)
+    CONTEXTS.keep(ctx)
 }
 
 /// Check if context has an error
@@ -443,52 +464,44 @@ pub extern "C" fn fz_context_is_valid(ctx: Handle) -> c_int {
     if CONTEXTS.get(ctx).is_some() { 1 } else { 0 }
 }
 
+/// Number of objects that could not be created because the handle table
+/// was full
+///
+/// At most 2^21 - 1 handles of all types are live at once; past that,
+/// every function that creates an object returns 0. A count that grows
+/// means handles are being leaked or too many objects are held.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_handle_insert_failures(_ctx: Handle) -> u64 {
+    super::handle_slab::insert_failures()
+}
+
 /// Shrink store to given percentage of maximum
+///
+/// Evicts items from the resource store until it fits.
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_shrink_store(_ctx: Handle, percent: c_int) {
-    if let Ok(mut store) = STORE_STATE.lock() {
-        // Calculate target size as percentage of max
-        let target = (store.max_bytes as f32 * (percent as f32 / 100.0)) as usize;
-
-        // Reduce store allocation to target
-        // Note: Advanced cache management with LRU eviction could be added here
-        // for systems that need fine-grained memory control
-        if target < store.allocated_bytes {
-            store.allocated_bytes = target;
-        }
-    }
+    store::store_shrink(percent.max(0) as u32);
 }
 
-/// Empty the store completely
+/// Empty the store of everything evictable
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_empty_store(_ctx: Handle) {
-    if let Ok(mut store) = STORE_STATE.lock() {
-        // Reset store allocation tracking
-        // Note: Advanced implementations could walk cached resources and free them
-        store.allocated_bytes = 0;
-    }
+    store::store_shrink(0);
 }
 
 /// Scavenge store to free up specified amount of memory
+///
+/// Returns the number of bytes freed. `phase` is set to 1 once the store
+/// had nothing left to give, so callers can stop retrying.
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_store_scavenge(_ctx: Handle, size: usize, phase: *mut c_int) -> c_int {
-    if let Ok(mut store) = STORE_STATE.lock() {
-        // Calculate how much we can free
-        let available = store.allocated_bytes;
-        let to_free = size.min(available);
-
-        // Phase indicates scavenging aggressiveness (0=gentle, 1=moderate, 2=aggressive)
-        // Advanced cache implementations could use this to prioritize what to free
-        if !phase.is_null() {
-            unsafe {
-                *phase = 0; // Gentle phase
-            }
+    let freed = store::store_scavenge(size);
+    if !phase.is_null() {
+        unsafe {
+            *phase = (freed < size) as c_int;
         }
-
-        store.allocated_bytes = store.allocated_bytes.saturating_sub(to_free);
-        return to_free as c_int;
     }
-    0
+    freed.min(c_int::MAX as usize) as c_int
 }
 
 /// Enable ICC color management
@@ -556,10 +569,36 @@ mod tests {
     #[test]
     fn test_context_clone() {
         let ctx1 = unsafe { fz_new_context(std::ptr::null(), std::ptr::null(), 1024 * 1024) };
+        fz_set_aa_level(ctx1, 4);
         let ctx2 = fz_clone_context(ctx1);
-        assert_eq!(ctx1, ctx2);
-        fz_drop_context(ctx1);
+        assert_ne!(ctx2, 0);
+        assert_ne!(ctx1, ctx2);
+        assert_eq!(fz_aa_level(ctx2), 4);
+        assert_eq!(fz_store_size(ctx2), 1024 * 1024);
+
+        // Errors stay on the context that raised them
+        let msg = std::ffi::CString::new("clone error").unwrap();
+        unsafe {
+            fz_throw(ctx2, FzErrorType::Argument as c_int, msg.as_ptr());
+        }
+        assert_eq!(fz_caught(ctx1), FzErrorType::None as c_int);
+
+        // Dropping the clone leaves the original alive
         fz_drop_context(ctx2);
+        assert_eq!(fz_context_is_valid(ctx2), 0);
+        assert_eq!(fz_context_is_valid(ctx1), 1);
+        fz_drop_context(ctx1);
+        assert_eq!(fz_clone_context(ctx1), 0);
+    }
+
+    #[test]
+    fn test_context_keep_drop() {
+        let ctx = unsafe { fz_new_context(std::ptr::null(), std::ptr::null(), 1024 * 1024) };
+        assert_eq!(fz_keep_context(ctx), ctx);
+        fz_drop_context(ctx);
+        assert_eq!(fz_context_is_valid(ctx), 1);
+        fz_drop_context(ctx);
+        assert_eq!(fz_context_is_valid(ctx), 0);
     }
 
     #[test]
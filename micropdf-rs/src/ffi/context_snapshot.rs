@@ -0,0 +1,455 @@
+//! FFI bindings for warm context snapshots
+//!
+//! A freshly started worker parses every font program and rasterizes every
+//! glyph again before it renders at full speed. A snapshot saves what a
+//! warmed-up process has built that is immutable and keyed by content
+//! rather than by handle: the parsed font faces with the glyph outlines
+//! built so far, and the rendered glyph cache. Opening it makes a new
+//! process, or every worker forked after the open, start warm.
+//!
+//! The file is mapped read-only, and font programs are used straight from
+//! the mapping, so every process that opens the same snapshot shares one
+//! copy of them through the page cache. Outlines are decoded into their
+//! faces when the snapshot opens; rendered glyphs stay in the file until
+//! the glyph cache misses on one. Nothing is written back: a snapshot is
+//! replaced only by saving a new one over it.
+//!
+//! Layout: a 16-byte header (`MPWS`, version, 8 reserved bytes) followed by
+//! records in the persistent glyph cache file's record format. Faces come
+//! first, so the outline records after them can name their face.
+
+use std::collections::{HashMap, HashSet};
+use std::ffi::{c_char, c_int};
+use std::io::Write;
+use std::path::Path as FsPath;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, LazyLock, Mutex};
+
+use bytes::Bytes;
+
+use crate::ffi::glyph_cache::{GLYPH_CACHE, GlyphCacheKey};
+use crate::ffi::glyph_disk_cache::{
+    DiskGlyphKey, KIND_GLYPH, KIND_OUTLINE, RECORD_HEADER_LEN, RecordInfo, decode_record,
+    encode_record, font_content_hash, pack_mask, unpack_mask,
+};
+use crate::ffi::mmap::FileBytes;
+use crate::ffi::{Handle, HandleStore, PIXMAPS, safe_helpers};
+use crate::fitz::font_cache::{FontFace, cached_faces};
+use crate::fitz::path::Path;
+
+/// File magic
+const MAGIC: &[u8; 4] = b"MPWS";
+
+/// Current file format version
+pub const CONTEXT_SNAPSHOT_VERSION: u32 = 1;
+
+/// File header size
+const FILE_HEADER_LEN: usize = 16;
+
+/// Record kind: font program; `gid` holds the face index
+const KIND_FACE: u8 = 3;
+
+/// Key of a face's record; outline records carry the face index in the
+/// first matrix slot
+fn face_key(hash: [u8; 32], index: usize) -> DiskGlyphKey {
+    let mut key = DiskGlyphKey::outline(hash, index as u32);
+    key.kind = KIND_FACE;
+    key
+}
+
+fn outline_key(hash: [u8; 32], index: usize, gid: u16) -> DiskGlyphKey {
+    let mut key = DiskGlyphKey::outline(hash, gid as u32);
+    key.matrix_key[0] = index as i32;
+    key
+}
+
+// ============================================================================
+// Snapshot
+// ============================================================================
+
+/// Write the process's font faces, their outlines and the rendered glyph
+/// cache to `path`
+///
+/// The file is written beside `path` and renamed over it, so processes
+/// opening the old snapshot meanwhile see a complete file.
+pub fn save_snapshot<P: AsRef<FsPath>>(path: P) -> std::io::Result<()> {
+    let mut out = Vec::new();
+    out.extend_from_slice(MAGIC);
+    out.extend_from_slice(&CONTEXT_SNAPSHOT_VERSION.to_le_bytes());
+    out.extend_from_slice(&[0; 8]);
+
+    let mut written = HashSet::new();
+    let faces = cached_faces();
+    for face in &faces {
+        let (hash, index) = (face.content_hash(), face.index());
+        if !written.insert(face_key(hash, index)) {
+            continue;
+        }
+        let info = RecordInfo {
+            w: 0,
+            h: 0,
+            n: 0,
+            len: face.data().len() as u32,
+        };
+        encode_record(&mut out, &face_key(hash, index), &info, face.data());
+    }
+    for face in &faces {
+        let (hash, index) = (face.content_hash(), face.index());
+        for (gid, outline) in face.outlines() {
+            let key = outline_key(hash, index, gid);
+            if !written.insert(key) {
+                continue;
+            }
+            let data = outline.to_bytes();
+            let info = RecordInfo {
+                w: 0,
+                h: 0,
+                n: 0,
+                len: data.len() as u32,
+            };
+            encode_record(&mut out, &key, &info, &data);
+        }
+    }
+
+    let mut font_hashes = HashMap::new();
+    for (key, pixmap) in GLYPH_CACHE.entries() {
+        let hash = *font_hashes
+            .entry(key.font)
+            .or_insert_with(|| font_content_hash(key.font));
+        let (Some(hash), Some(pix)) = (hash, PIXMAPS.get(pixmap)) else {
+            continue;
+        };
+        let disk_key = DiskGlyphKey::glyph(hash, &key);
+        let Some((info, data)) = pack_mask(&pix.lock().unwrap()) else {
+            continue;
+        };
+        if written.insert(disk_key) {
+            encode_record(&mut out, &disk_key, &info, &data);
+        }
+    }
+
+    let path = path.as_ref();
+    let tmp = path.with_extension(format!("tmp{}", std::process::id()));
+    let mut file = std::fs::File::create(&tmp)?;
+    file.write_all(&out)?;
+    file.sync_data()?;
+    drop(file);
+    std::fs::rename(&tmp, path)
+}
+
+/// An open snapshot
+///
+/// Holds its faces, so they stay in the face cache for documents to find
+/// while the snapshot is open.
+pub struct ContextSnapshot {
+    /// The mapped file
+    bytes: Bytes,
+    faces: Vec<Arc<FontFace>>,
+    outlines: usize,
+    /// Rendered glyphs, by key, with the offset of their data
+    glyphs: HashMap<DiskGlyphKey, (RecordInfo, usize)>,
+    /// Content hashes already computed, by font handle
+    font_hashes: HashMap<Handle, Option<[u8; 32]>>,
+    hits: u64,
+    misses: u64,
+}
+
+impl ContextSnapshot {
+    /// Map `path` and seed the face cache from it
+    ///
+    /// Returns `None` if the file is missing or is not a snapshot of this
+    /// version. A truncated tail is ignored.
+    pub fn open<P: AsRef<FsPath>>(path: P) -> Option<Self> {
+        let bytes = Arc::new(FileBytes::map(path).ok()?).shared();
+        if bytes.len() < FILE_HEADER_LEN
+            || &bytes[..4] != MAGIC
+            || bytes[4..8] != CONTEXT_SNAPSHOT_VERSION.to_le_bytes()
+        {
+            return None;
+        }
+
+        let mut snapshot = Self {
+            bytes: bytes.clone(),
+            faces: Vec::new(),
+            outlines: 0,
+            glyphs: HashMap::new(),
+            font_hashes: HashMap::new(),
+            hits: 0,
+            misses: 0,
+        };
+        let mut faces = HashMap::new();
+        let mut offset = FILE_HEADER_LEN;
+        while let Some((key, info)) = bytes.get(offset..).and_then(decode_record) {
+            let data = offset + RECORD_HEADER_LEN;
+            let end = data + info.len as usize;
+            if end > bytes.len() {
+                break; // torn write
+            }
+            match key.kind {
+                KIND_FACE => {
+                    let index = key.gid as usize;
+                    let face = FontFace::load_shared(bytes.slice(data..end), index, key.font_hash);
+                    faces.insert((key.font_hash, index), Arc::clone(&face));
+                    snapshot.faces.push(face);
+                }
+                KIND_OUTLINE => {
+                    let index = key.matrix_key[0] as usize;
+                    let face = faces.get(&(key.font_hash, index));
+                    if let (Some(face), Some(path)) = (face, Path::from_bytes(&bytes[data..end])) {
+                        face.outline(key.gid as u16, || path);
+                        snapshot.outlines += 1;
+                    }
+                }
+                KIND_GLYPH => {
+                    snapshot.glyphs.insert(key, (info, data));
+                }
+                _ => {}
+            }
+            offset = end.next_multiple_of(8);
+        }
+        Some(snapshot)
+    }
+
+    /// Load a rendered glyph as a new pixmap handle (0 if absent)
+    pub fn lookup(&mut self, font: Handle, key: &GlyphCacheKey) -> Handle {
+        let hash = *self
+            .font_hashes
+            .entry(font)
+            .or_insert_with(|| font_content_hash(font));
+        let pixmap = hash
+            .and_then(|hash| self.glyphs.get(&DiskGlyphKey::glyph(hash, key)))
+            .and_then(|(info, at)| unpack_mask(info, &self.bytes[*at..*at + info.len as usize]));
+        match pixmap {
+            Some(pixmap) => {
+                self.hits += 1;
+                PIXMAPS.insert(pixmap)
+            }
+            None => {
+                self.misses += 1;
+                0
+            }
+        }
+    }
+
+    /// Number of font faces
+    pub fn faces(&self) -> usize {
+        self.faces.len()
+    }
+
+    /// Number of outlines seeded into the faces
+    pub fn outlines(&self) -> usize {
+        self.outlines
+    }
+
+    /// Number of rendered glyphs
+    pub fn glyphs(&self) -> usize {
+        self.glyphs.len()
+    }
+}
+
+/// Open snapshots
+pub static CONTEXT_SNAPSHOTS: LazyLock<HandleStore<ContextSnapshot>> =
+    LazyLock::new(HandleStore::default);
+
+/// Snapshot consulted by the rendered glyph cache (0 = none)
+static ATTACHED: AtomicU64 = AtomicU64::new(0);
+
+fn attached() -> Option<Arc<Mutex<ContextSnapshot>>> {
+    CONTEXT_SNAPSHOTS.get(ATTACHED.load(Ordering::Acquire))
+}
+
+/// Look a glyph up in the open snapshot, returning a new pixmap handle
+pub fn attached_lookup(font: Handle, key: &GlyphCacheKey) -> Handle {
+    attached().map_or(0, |snapshot| snapshot.lock().unwrap().lookup(font, key))
+}
+
+// ============================================================================
+// FFI Functions
+// ============================================================================
+
+/// Save the process's font faces, glyph outlines and rendered glyphs
+///
+/// Returns 0 on success, -1 on error.
+///
+/// # Safety
+/// Caller must ensure path is a valid null-terminated C string.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_save_context_snapshot(_ctx: Handle, path: *const c_char) -> c_int {
+    match safe_helpers::c_str_to_str(path) {
+        Some(path) if !path.is_empty() => save_snapshot(path).map_or(-1, |()| 0),
+        _ => -1,
+    }
+}
+
+/// Open a snapshot and start the process warm from it
+///
+/// Its font faces are shared with every font loaded from the same program,
+/// and the rendered glyph cache reads through to it. Open it before
+/// forking workers so they share one mapping. Returns 0 if the file is
+/// missing or not a snapshot.
+///
+/// # Safety
+/// Caller must ensure path is a valid null-terminated C string.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_open_context_snapshot(_ctx: Handle, path: *const c_char) -> Handle {
+    let Some(snapshot) = safe_helpers::c_str_to_str(path).and_then(ContextSnapshot::open) else {
+        return 0;
+    };
+    let handle = CONTEXT_SNAPSHOTS.insert(snapshot);
+    ATTACHED.store(handle, Ordering::Release);
+    handle
+}
+
+/// Close a snapshot
+///
+/// Faces still used by fonts stay valid; the mapping goes away with the
+/// last of them.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_drop_context_snapshot(_ctx: Handle, snapshot: Handle) {
+    let _ = ATTACHED.compare_exchange(snapshot, 0, Ordering::AcqRel, Ordering::Relaxed);
+    let _ = CONTEXT_SNAPSHOTS.remove(snapshot);
+}
+
+/// Get what a snapshot holds and its glyph lookup hits and misses
+///
+/// # Safety
+/// Each non-null out pointer must be valid for writes
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_context_snapshot_stats(
+    _ctx: Handle,
+    snapshot: Handle,
+    faces: *mut usize,
+    glyphs: *mut usize,
+    hits: *mut u64,
+    misses: *mut u64,
+) {
+    let Some(snapshot) = CONTEXT_SNAPSHOTS.get(snapshot) else {
+        return;
+    };
+    let guard = snapshot.lock().unwrap();
+    unsafe {
+        if !faces.is_null() {
+            *faces = guard.faces();
+        }
+        if !glyphs.is_null() {
+            *glyphs = guard.glyphs();
+        }
+        if !hits.is_null() {
+            *hits = guard.hits;
+        }
+        if !misses.is_null() {
+            *misses = guard.misses;
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::colorspace::FZ_COLORSPACE_GRAY;
+    use crate::ffi::font::FONTS;
+    use crate::ffi::pixmap::Pixmap;
+    use crate::fitz::font::Font;
+    use crate::fitz::geometry::{Matrix, Point};
+    use std::ffi::CString;
+    use std::path::PathBuf;
+
+    fn temp_path(name: &str) -> PathBuf {
+        std::env::temp_dir().join(format!("{}_{}.mpws", name, std::process::id()))
+    }
+
+    #[test]
+    fn test_snapshot_warms_faces_and_glyphs() {
+        let path = temp_path("context_snapshot");
+        let program = b"snapshot font program".to_vec();
+
+        // Warm up: a face with one outline and one rendered glyph
+        let font = FONTS.insert(Font::from_data("Snap", &program, 0).unwrap());
+        let face = FONTS
+            .get(font)
+            .unwrap()
+            .lock()
+            .unwrap()
+            .face()
+            .cloned()
+            .unwrap();
+        let mut outline = Path::new();
+        outline.move_to(Point::new(0.0, 0.0));
+        outline.line_to(Point::new(100.0, 700.0));
+        face.outline(3, || outline);
+        let ctm = Matrix::scale(12.0, 12.0);
+        let key = GlyphCacheKey::new(font, 3, &ctm, 0, 0, 4);
+        let mut mask = Pixmap::new(FZ_COLORSPACE_GRAY, 4, 3, false);
+        mask.samples_mut()
+            .iter_mut()
+            .enumerate()
+            .for_each(|(i, v)| *v = i as u8);
+        let samples = mask.samples().to_vec();
+        let pixmap = PIXMAPS.insert(mask);
+        GLYPH_CACHE.insert(key.clone(), pixmap, 12, None);
+
+        save_snapshot(&path).unwrap();
+        GLYPH_CACHE.remove(&key);
+        PIXMAPS.remove(pixmap);
+        FONTS.remove(font);
+        drop(face);
+
+        // A cold start: the face comes from the mapping, outline included
+        let mut snapshot = ContextSnapshot::open(&path).unwrap();
+        assert!(snapshot.faces() >= 1);
+        assert!(snapshot.glyphs() >= 1);
+        let font = FONTS.insert(Font::from_data("Snap", &program, 0).unwrap());
+        let face = FONTS
+            .get(font)
+            .unwrap()
+            .lock()
+            .unwrap()
+            .face()
+            .cloned()
+            .unwrap();
+        assert!(snapshot.faces.iter().any(|f| Arc::ptr_eq(f, &face)));
+        let seeded = face.outline(3, Path::new);
+        assert_eq!(seeded.len(), 2);
+
+        let loaded = snapshot.lookup(font, &GlyphCacheKey::new(font, 3, &ctm, 0, 0, 4));
+        assert_ne!(loaded, 0);
+        {
+            let pix = PIXMAPS.get(loaded).unwrap();
+            let pix = pix.lock().unwrap();
+            assert_eq!((pix.w(), pix.h(), pix.n()), (4, 3, 1));
+            assert_eq!(&pix.samples()[..samples.len()], &samples[..]);
+        }
+        let other = GlyphCacheKey::new(font, 4, &ctm, 0, 0, 4);
+        assert_eq!(snapshot.lookup(font, &other), 0);
+        assert_eq!((snapshot.hits, snapshot.misses), (1, 1));
+
+        PIXMAPS.remove(loaded);
+        FONTS.remove(font);
+        let _ = std::fs::remove_file(&path);
+    }
+
+    #[test]
+    fn test_ffi_context_snapshot() {
+        let path = temp_path("context_snapshot_ffi");
+        let c_path = CString::new(path.to_str().unwrap()).unwrap();
+        assert_eq!(fz_open_context_snapshot(0, c_path.as_ptr()), 0);
+        assert_eq!(fz_save_context_snapshot(0, std::ptr::null()), -1);
+
+        assert_eq!(fz_save_context_snapshot(0, c_path.as_ptr()), 0);
+        let snapshot = fz_open_context_snapshot(0, c_path.as_ptr());
+        assert_ne!(snapshot, 0);
+        let (mut faces, mut glyphs, mut hits, mut misses) = (usize::MAX, usize::MAX, 1, 1);
+        fz_context_snapshot_stats(0, snapshot, &mut faces, &mut glyphs, &mut hits, &mut misses);
+        assert_ne!(faces, usize::MAX);
+        assert_eq!((hits, misses), (0, 0));
+        fz_drop_context_snapshot(0, snapshot);
+        assert_eq!(ATTACHED.load(Ordering::Acquire), 0);
+
+        // Other versions are not snapshots
+        let mut bytes = std::fs::read(&path).unwrap();
+        bytes[4] = 99;
+        std::fs::write(&path, &bytes).unwrap();
+        assert_eq!(fz_open_context_snapshot(0, c_path.as_ptr()), 0);
+        let _ = std::fs::remove_file(&path);
+    }
+}
@@ -344,6 +344,50 @@ pub extern "C" fn fz_cookie_progress_remaining(_ctx: Handle, cookie: Handle) ->
     0
 }
 
+/// Limit the memory operations run with this cookie may allocate
+///
+/// Pixmap samples, decoded streams, parsed objects, xref sections and
+/// fonts allocated while a page is loaded, recorded or rendered with the
+/// cookie count against the limit; pixmaps stop counting once freed. An
+/// operation that goes over fails with `FZ_ERROR_LIMIT` and adds an error
+/// to the cookie. `fz_cookie_reset` clears the count.
+///
+/// # Arguments
+/// * `cookie` - Handle to the cookie
+/// * `bytes` - Limit in bytes, or 0 for none
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_cookie_set_memory_limit(_ctx: Handle, cookie: Handle, bytes: usize) {
+    if let Some(c) = COOKIES.get(cookie) {
+        if let Ok(guard) = c.lock() {
+            guard.memory().set_limit(bytes);
+        }
+    }
+}
+
+/// Get the memory limit set with `fz_cookie_set_memory_limit` (0 for none)
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_cookie_memory_limit(_ctx: Handle, cookie: Handle) -> usize {
+    if let Some(c) = COOKIES.get(cookie) {
+        if let Ok(guard) = c.lock() {
+            return guard.memory().limit();
+        }
+    }
+    0
+}
+
+/// Get the bytes charged to the cookie's memory limit
+///
+/// Counted only while a limit is set.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_cookie_memory_used(_ctx: Handle, cookie: Handle) -> usize {
+    if let Some(c) = COOKIES.get(cookie) {
+        if let Ok(guard) = c.lock() {
+            return guard.memory().used();
+        }
+    }
+    0
+}
+
 /// Clone a cookie (creates a new cookie with same state)
 ///
 /// # Arguments
@@ -360,6 +404,7 @@ pub extern "C" fn fz_clone_cookie(_ctx: Handle, cookie: Handle) -> Handle {
             new_cookie.set_progress_max(guard.progress_max());
             new_cookie.set_error(guard.errors());
             new_cookie.set_incomplete(guard.is_incomplete());
+            new_cookie.memory().set_limit(guard.memory().limit());
             if guard.should_abort() {
                 new_cookie.abort();
             }
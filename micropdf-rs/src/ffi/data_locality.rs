@@ -2,6 +2,7 @@
 //!
 //! Utilities for improving cache utilization and memory access patterns:
 //! - `PageAlignedBuffer`: Page-aligned allocations for large buffers
+//! - `Placement`: Huge-page backing and NUMA node binding for them
 //! - `Prefetch`: CPU prefetch hints for sequential/random access
 //! - `SoA` patterns: Struct-of-Arrays for SIMD-friendly data layouts
 //!
@@ -155,7 +156,8 @@ pub fn prefetch_range_write(ptr: *mut u8, len: usize, locality: PrefetchLocality
 /// - Efficient mmap/DMA operations
 /// - Better huge page support
 pub struct PageAlignedBuffer {
-    ptr: NonNull<u8>,
+    /// None for a zero-capacity buffer
+    pages: Option<RawPages>,
     len: usize,
     capacity: usize,
 }
@@ -163,22 +165,30 @@ pub struct PageAlignedBuffer {
 impl PageAlignedBuffer {
     /// Allocate a new page-aligned buffer
     pub fn new(capacity: usize) -> Option<Self> {
+        Self::with_placement(capacity, Placement::default())
+    }
+
+    /// Allocate a new page-aligned buffer placed as `placement` asks
+    ///
+    /// Huge pages apply to buffers of `HUGE_PAGE_SIZE` and up, whose
+    /// capacity is then rounded to whole huge pages. Placement that the
+    /// system can't give is skipped; `placement_flags` says what was.
+    pub fn with_placement(capacity: usize, placement: Placement) -> Option<Self> {
         if capacity == 0 {
             return Some(Self {
-                ptr: NonNull::dangling(),
+                pages: None,
                 len: 0,
                 capacity: 0,
             });
         }
 
-        // Round up to page boundary
-        let aligned_capacity = (capacity + PAGE_SIZE - 1) & !(PAGE_SIZE - 1);
-
-        let layout = Layout::from_size_align(aligned_capacity, PAGE_SIZE).ok()?;
-        let ptr = unsafe { alloc::alloc_zeroed(layout) };
+        let huge = placement.huge != HugePages::None && capacity >= HUGE_PAGE_SIZE;
+        let unit = if huge { HUGE_PAGE_SIZE } else { PAGE_SIZE };
+        let aligned_capacity = capacity.checked_next_multiple_of(unit)?;
 
-        NonNull::new(ptr).map(|ptr| Self {
-            ptr,
+        let pages = RawPages::new(aligned_capacity, true, placement)?;
+        Some(Self {
+            pages: Some(pages),
             len: 0,
             capacity: aligned_capacity,
         })
@@ -191,16 +201,21 @@ impl PageAlignedBuffer {
         Some(buf)
     }
 
+    #[inline]
+    fn base(&self) -> NonNull<u8> {
+        self.pages.as_ref().map_or(NonNull::dangling(), |p| p.ptr)
+    }
+
     /// Get raw pointer
     #[inline]
     pub fn as_ptr(&self) -> *const u8 {
-        self.ptr.as_ptr()
+        self.base().as_ptr()
     }
 
     /// Get mutable raw pointer
     #[inline]
     pub fn as_mut_ptr(&mut self) -> *mut u8 {
-        self.ptr.as_ptr()
+        self.base().as_ptr()
     }
 
     /// Get length
@@ -221,16 +236,22 @@ impl PageAlignedBuffer {
         self.capacity
     }
 
+    /// `FZ_PAGE_BUFFER_*` flags for the placement the buffer got
+    #[inline]
+    pub fn placement_flags(&self) -> c_int {
+        self.pages.as_ref().map_or(0, |p| p.flags)
+    }
+
     /// Get as slice
     #[inline]
     pub fn as_slice(&self) -> &[u8] {
-        unsafe { std::slice::from_raw_parts(self.ptr.as_ptr(), self.len) }
+        unsafe { std::slice::from_raw_parts(self.as_ptr(), self.len) }
     }
 
     /// Get as mutable slice
     #[inline]
     pub fn as_mut_slice(&mut self) -> &mut [u8] {
-        unsafe { std::slice::from_raw_parts_mut(self.ptr.as_ptr(), self.len) }
+        unsafe { std::slice::from_raw_parts_mut(self.as_mut_ptr(), self.len) }
     }
 
     /// Extend from slice
@@ -242,7 +263,7 @@ impl PageAlignedBuffer {
         unsafe {
             std::ptr::copy_nonoverlapping(
                 data.as_ptr(),
-                self.ptr.as_ptr().add(self.len),
+                self.as_mut_ptr().add(self.len),
                 data.len(),
             );
         }
@@ -269,19 +290,19 @@ impl PageAlignedBuffer {
     /// Prefetch for sequential read
     #[inline]
     pub fn prefetch_read(&self, locality: PrefetchLocality) {
-        prefetch_range_read(self.ptr.as_ptr(), self.len, locality);
+        prefetch_range_read(self.as_ptr(), self.len, locality);
     }
 
     /// Prefetch for sequential write
     #[inline]
     pub fn prefetch_write(&mut self, locality: PrefetchLocality) {
-        prefetch_range_write(self.ptr.as_ptr(), self.capacity, locality);
+        prefetch_range_write(self.as_mut_ptr(), self.capacity, locality);
     }
 
     /// Check if pointer is page-aligned
     #[inline]
     pub fn is_page_aligned(&self) -> bool {
-        (self.ptr.as_ptr() as usize) % PAGE_SIZE == 0
+        (self.as_ptr() as usize) % PAGE_SIZE == 0
     }
 
     /// Get number of pages used
@@ -295,20 +316,369 @@ impl PageAlignedBuffer {
     }
 }
 
-impl Drop for PageAlignedBuffer {
+// Safety: PageAlignedBuffer owns its allocation
+unsafe impl Send for PageAlignedBuffer {}
+unsafe impl Sync for PageAlignedBuffer {}
+
+// ============================================================================
+// Huge Pages and NUMA Placement
+// ============================================================================
+
+/// Size of a huge page, and the smallest allocation placed on them
+pub const HUGE_PAGE_SIZE: usize = 2 * 1024 * 1024;
+
+/// Back the buffer with transparent huge pages
+pub const FZ_PAGE_BUFFER_THP: c_int = 1;
+/// Map the buffer from the reserved huge page pool (`MAP_HUGETLB`),
+/// falling back to transparent huge pages when the pool is empty
+pub const FZ_PAGE_BUFFER_HUGETLB: c_int = 2;
+/// Bind the buffer's pages to a NUMA node instead of leaving them where
+/// they are first touched
+pub const FZ_PAGE_BUFFER_NODE_LOCAL: c_int = 4;
+
+/// Huge-page backing of an allocation
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub enum HugePages {
+    /// Normal pages
+    #[default]
+    None,
+    /// 2 MiB aligned and advised as transparent huge pages
+    Transparent,
+    /// Mapped from the reserved huge page pool, else transparent
+    Explicit,
+}
+
+/// Where an allocation's memory comes from
+///
+/// Without a node, pages land on the node of the thread that first
+/// touches them, which for a pinned render worker is its own.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub struct Placement {
+    pub huge: HugePages,
+    /// NUMA node the pages are bound to
+    pub node: Option<usize>,
+}
+
+impl Placement {
+    /// Placement for `FZ_PAGE_BUFFER_*` flags; a NUMA node below 0 is the
+    /// calling thread's
+    pub fn from_flags(flags: c_int, node: c_int) -> Self {
+        let huge = if flags & FZ_PAGE_BUFFER_HUGETLB != 0 {
+            HugePages::Explicit
+        } else if flags & FZ_PAGE_BUFFER_THP != 0 {
+            HugePages::Transparent
+        } else {
+            HugePages::None
+        };
+        let node = if flags & FZ_PAGE_BUFFER_NODE_LOCAL == 0 {
+            None
+        } else if node < 0 {
+            current_numa_node()
+        } else {
+            Some(node as usize)
+        };
+        Self { huge, node }
+    }
+}
+
+/// Page-aligned memory placed as asked
+pub(crate) struct RawPages {
+    ptr: NonNull<u8>,
+    /// Bytes asked for
+    size: usize,
+    /// Heap layout, or None when mapped from the huge page pool
+    layout: Option<Layout>,
+    /// `FZ_PAGE_BUFFER_*` flags for the placement obtained
+    flags: c_int,
+}
+
+// Uniquely owned like a Box<[u8]>
+unsafe impl Send for RawPages {}
+unsafe impl Sync for RawPages {}
+
+impl RawPages {
+    /// `size` bytes, a multiple of `PAGE_SIZE`, zeroed if `zeroed`
+    ///
+    /// Huge pages go to allocations of `HUGE_PAGE_SIZE` and up.
+    pub(crate) fn new(size: usize, zeroed: bool, placement: Placement) -> Option<Self> {
+        let huge = placement.huge != HugePages::None && size >= HUGE_PAGE_SIZE;
+        let mut flags = 0;
+        let mut mapped = None;
+        if huge && placement.huge == HugePages::Explicit {
+            mapped = os::map_huge(size.checked_next_multiple_of(HUGE_PAGE_SIZE)?);
+        }
+        let (ptr, layout) = match mapped {
+            Some(ptr) => {
+                flags |= FZ_PAGE_BUFFER_HUGETLB;
+                (ptr, None)
+            }
+            None => {
+                let align = if huge { HUGE_PAGE_SIZE } else { PAGE_SIZE };
+                let layout = Layout::from_size_align(size, align).ok()?;
+                let ptr = unsafe {
+                    if zeroed {
+                        alloc::alloc_zeroed(layout)
+                    } else {
+                        alloc::alloc(layout)
+                    }
+                };
+                let ptr = NonNull::new(ptr)?;
+                if huge && os::advise_huge(ptr.as_ptr(), size) {
+                    flags |= FZ_PAGE_BUFFER_THP;
+                }
+                (ptr, Some(layout))
+            }
+        };
+        // Binding only affects pages not yet faulted in; fresh heap blocks
+        // this large come straight from the kernel untouched
+        if let Some(node) = placement.node
+            && os::bind(ptr.as_ptr(), size, Some(node))
+        {
+            flags |= FZ_PAGE_BUFFER_NODE_LOCAL;
+        }
+        Some(Self {
+            ptr,
+            size,
+            layout,
+            flags,
+        })
+    }
+
+    #[inline]
+    pub(crate) fn as_ptr(&self) -> *mut u8 {
+        self.ptr.as_ptr()
+    }
+
+    #[inline]
+    pub(crate) fn size(&self) -> usize {
+        self.size
+    }
+}
+
+impl Drop for RawPages {
     fn drop(&mut self) {
-        if self.capacity > 0 {
-            let layout = Layout::from_size_align(self.capacity, PAGE_SIZE).unwrap();
-            unsafe {
+        match self.layout {
+            Some(layout) => unsafe {
+                // The heap may reuse the pages, so hand them back unbound
+                if self.flags & FZ_PAGE_BUFFER_NODE_LOCAL != 0 {
+                    os::bind(self.ptr.as_ptr(), self.size, None);
+                }
                 alloc::dealloc(self.ptr.as_ptr(), layout);
+            },
+            None => unsafe {
+                os::unmap(self.ptr, self.size.next_multiple_of(HUGE_PAGE_SIZE));
+            },
+        }
+    }
+}
+
+/// CPUs of each NUMA node, indexed by node; empty without NUMA information
+static NUMA_NODES: LazyLock<Vec<Vec<usize>>> = LazyLock::new(os::numa_nodes);
+
+/// Number of NUMA nodes with CPUs, at least 1
+pub fn numa_node_count() -> usize {
+    NUMA_NODES
+        .iter()
+        .filter(|cpus| !cpus.is_empty())
+        .count()
+        .max(1)
+}
+
+/// NUMA nodes with CPUs, in order
+pub fn numa_nodes() -> Vec<usize> {
+    let nodes: Vec<usize> = (0..NUMA_NODES.len())
+        .filter(|&n| !NUMA_NODES[n].is_empty())
+        .collect();
+    if nodes.is_empty() { vec![0] } else { nodes }
+}
+
+/// NUMA node of the CPU the calling thread runs on
+pub fn current_numa_node() -> Option<usize> {
+    let cpu = os::current_cpu()?;
+    NUMA_NODES.iter().position(|cpus| cpus.contains(&cpu))
+}
+
+/// Restrict the calling thread to the CPUs of NUMA `node`
+///
+/// Memory the thread then touches first is placed on that node. Returns
+/// false, leaving the thread as it was, if the node is unknown.
+pub fn pin_thread_to_node(node: usize) -> bool {
+    match NUMA_NODES.get(node) {
+        Some(cpus) if !cpus.is_empty() => os::set_affinity(cpus),
+        _ => false,
+    }
+}
+
+/// Parse a kernel CPU or node list such as `0-3,8,10-11`
+fn parse_id_list(list: &str) -> Vec<usize> {
+    let mut ids = Vec::new();
+    for part in list.trim().split(',').filter(|p| !p.is_empty()) {
+        let (lo, hi) = part.split_once('-').unwrap_or((part, part));
+        if let (Ok(lo), Ok(hi)) = (lo.parse::<usize>(), hi.parse::<usize>()) {
+            ids.extend(lo..=hi);
+        }
+    }
+    ids
+}
+
+#[cfg(target_os = "linux")]
+mod os {
+    use std::ffi::{c_int, c_long, c_void};
+    use std::ptr::NonNull;
+
+    const PROT_READ: c_int = 1;
+    const PROT_WRITE: c_int = 2;
+    const MAP_PRIVATE: c_int = 0x02;
+    const MAP_ANONYMOUS: c_int = 0x20;
+    const MAP_HUGETLB: c_int = 0x40000;
+    const MADV_HUGEPAGE: c_int = 14;
+    const MPOL_DEFAULT: c_int = 0;
+    const MPOL_PREFERRED: c_int = 1;
+    #[cfg(target_arch = "x86_64")]
+    const SYS_MBIND: c_long = 237;
+    #[cfg(target_arch = "aarch64")]
+    const SYS_MBIND: c_long = 235;
+    /// Bits in the affinity mask `sched_setaffinity` is given
+    const MAX_CPUS: usize = 1024;
+
+    unsafe extern "C" {
+        fn mmap(
+            addr: *mut c_void,
+            len: usize,
+            prot: c_int,
+            flags: c_int,
+            fd: c_int,
+            offset: c_long,
+        ) -> *mut c_void;
+        fn munmap(addr: *mut c_void, len: usize) -> c_int;
+        fn madvise(addr: *mut c_void, len: usize, advice: c_int) -> c_int;
+        fn sched_getcpu() -> c_int;
+        fn sched_setaffinity(pid: c_int, size: usize, mask: *const u64) -> c_int;
+        #[cfg(any(target_arch = "x86_64", target_arch = "aarch64"))]
+        fn syscall(number: c_long, ...) -> c_long;
+    }
+
+    /// `len` bytes, a multiple of the huge page size, from the reserved
+    /// huge page pool
+    pub(super) fn map_huge(len: usize) -> Option<NonNull<u8>> {
+        let flags = MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB;
+        let ptr = unsafe {
+            mmap(
+                std::ptr::null_mut(),
+                len,
+                PROT_READ | PROT_WRITE,
+                flags,
+                -1,
+                0,
+            )
+        };
+        // MAP_FAILED is all ones
+        if ptr as usize == usize::MAX {
+            return None;
+        }
+        NonNull::new(ptr.cast())
+    }
+
+    /// # Safety
+    /// `ptr` and `len` must be a mapping from `map_huge`
+    pub(super) unsafe fn unmap(ptr: NonNull<u8>, len: usize) {
+        unsafe { munmap(ptr.as_ptr().cast(), len) };
+    }
+
+    pub(super) fn advise_huge(ptr: *mut u8, len: usize) -> bool {
+        // Advisory only: kernels without THP leave the block on normal pages
+        unsafe { madvise(ptr.cast(), len, MADV_HUGEPAGE) == 0 }
+    }
+
+    /// Prefer `node` for the pages of `ptr..ptr + len`, or drop the
+    /// preference with None
+    #[cfg(any(target_arch = "x86_64", target_arch = "aarch64"))]
+    pub(super) fn bind(ptr: *mut u8, len: usize, node: Option<usize>) -> bool {
+        let mut mask = [0u64; 16];
+        let mode = match node {
+            Some(node) if node < mask.len() * 64 => {
+                mask[node / 64] |= 1 << (node % 64);
+                MPOL_PREFERRED
+            }
+            Some(_) => return false,
+            None => MPOL_DEFAULT,
+        };
+        let maxnode = if node.is_some() {
+            mask.len() * 64 + 1
+        } else {
+            0
+        };
+        let mask_ptr = if node.is_some() {
+            mask.as_ptr()
+        } else {
+            std::ptr::null()
+        };
+        unsafe { syscall(SYS_MBIND, ptr, len, mode, mask_ptr, maxnode, 0u32) == 0 }
+    }
+
+    #[cfg(not(any(target_arch = "x86_64", target_arch = "aarch64")))]
+    pub(super) fn bind(_ptr: *mut u8, _len: usize, _node: Option<usize>) -> bool {
+        false
+    }
+
+    pub(super) fn current_cpu() -> Option<usize> {
+        usize::try_from(unsafe { sched_getcpu() }).ok()
+    }
+
+    pub(super) fn set_affinity(cpus: &[usize]) -> bool {
+        let mut mask = [0u64; MAX_CPUS / 64];
+        for &cpu in cpus.iter().filter(|&&cpu| cpu < MAX_CPUS) {
+            mask[cpu / 64] |= 1 << (cpu % 64);
+        }
+        unsafe { sched_setaffinity(0, size_of_val(&mask), mask.as_ptr()) == 0 }
+    }
+
+    pub(super) fn numa_nodes() -> Vec<Vec<usize>> {
+        let root = "/sys/devices/system/node";
+        let Ok(online) = std::fs::read_to_string(format!("{root}/online")) else {
+            return Vec::new();
+        };
+        let online = super::parse_id_list(&online);
+        let mut nodes = vec![Vec::new(); online.iter().max().map_or(0, |&n| n + 1)];
+        for node in online {
+            if let Ok(cpus) = std::fs::read_to_string(format!("{root}/node{node}/cpulist")) {
+                nodes[node] = super::parse_id_list(&cpus);
             }
         }
+        nodes
     }
 }
 
-// Safety: PageAlignedBuffer owns its allocation
-unsafe impl Send for PageAlignedBuffer {}
-unsafe impl Sync for PageAlignedBuffer {}
+#[cfg(not(target_os = "linux"))]
+mod os {
+    use std::ptr::NonNull;
+
+    pub(super) fn map_huge(_len: usize) -> Option<NonNull<u8>> {
+        None
+    }
+
+    pub(super) unsafe fn unmap(_ptr: NonNull<u8>, _len: usize) {}
+
+    pub(super) fn advise_huge(_ptr: *mut u8, _len: usize) -> bool {
+        false
+    }
+
+    pub(super) fn bind(_ptr: *mut u8, _len: usize, _node: Option<usize>) -> bool {
+        false
+    }
+
+    pub(super) fn current_cpu() -> Option<usize> {
+        None
+    }
+
+    pub(super) fn set_affinity(_cpus: &[usize]) -> bool {
+        false
+    }
+
+    pub(super) fn numa_nodes() -> Vec<Vec<usize>> {
+        Vec::new()
+    }
+}
 
 // ============================================================================
 // Struct-of-Arrays Pattern
@@ -323,6 +693,7 @@ unsafe impl Sync for PageAlignedBuffer {}
 /// - SIMD-friendly: process all X values, then all Y values
 /// - Cache-friendly: sequential access to same-type data
 /// - Vectorization: compiler can auto-vectorize loops
+#[derive(Debug, Clone)]
 pub struct PointSoA {
     pub xs: Vec<f32>,
     pub ys: Vec<f32>,
@@ -404,6 +775,7 @@ impl Default for PointSoA {
 }
 
 /// A struct-of-arrays container for Rect data
+#[derive(Debug, Clone)]
 pub struct RectSoA {
     pub x0s: Vec<f32>,
     pub y0s: Vec<f32>,
@@ -641,6 +1013,53 @@ pub extern "C" fn fz_new_page_aligned_buffer(_ctx: Handle, capacity: usize) -> H
     }
 }
 
+/// Create a page-aligned buffer placed as `flags` ask
+///
+/// `flags` combine `FZ_PAGE_BUFFER_THP` or `FZ_PAGE_BUFFER_HUGETLB` with
+/// `FZ_PAGE_BUFFER_NODE_LOCAL`, which binds the pages to NUMA `node`, or
+/// to the calling thread's node if `node` is negative. Placement the
+/// system can't give is skipped; see `fz_page_buffer_placement`.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_page_aligned_buffer_ex(
+    _ctx: Handle,
+    capacity: usize,
+    flags: c_int,
+    node: c_int,
+) -> Handle {
+    LOCALITY_STATS.page_allocs.fetch_add(1, Ordering::Relaxed);
+
+    match PageAlignedBuffer::with_placement(capacity, Placement::from_flags(flags, node)) {
+        Some(buf) => {
+            LOCALITY_STATS
+                .page_bytes
+                .fetch_add(buf.capacity() as u64, Ordering::Relaxed);
+            PAGE_BUFFERS.insert(buf)
+        }
+        None => 0,
+    }
+}
+
+/// `FZ_PAGE_BUFFER_*` flags for the placement a buffer actually got
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_page_buffer_placement(_ctx: Handle, buf: Handle) -> c_int {
+    PAGE_BUFFERS
+        .get(buf)
+        .map(|b| b.lock().unwrap().placement_flags())
+        .unwrap_or(0)
+}
+
+/// Number of NUMA nodes with CPUs (1 without NUMA information)
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_numa_node_count(_ctx: Handle) -> c_int {
+    numa_node_count() as c_int
+}
+
+/// NUMA node the calling thread runs on, or -1 if unknown
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_numa_current_node(_ctx: Handle) -> c_int {
+    current_numa_node().map_or(-1, |n| n as c_int)
+}
+
 /// Drop a page-aligned buffer
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_drop_page_aligned_buffer(_ctx: Handle, buf: Handle) {
@@ -878,6 +1297,46 @@ mod tests {
         assert_eq!(buf.as_slice(), data);
     }
 
+    #[test]
+    fn test_page_aligned_buffer_placement() {
+        let placement = Placement {
+            huge: HugePages::Explicit,
+            node: current_numa_node(),
+        };
+        let mut buf = PageAlignedBuffer::with_placement(HUGE_PAGE_SIZE + 1, placement).unwrap();
+        assert_eq!(buf.capacity(), 2 * HUGE_PAGE_SIZE);
+        assert!(buf.extend_from_slice(&[7; 4096]));
+        assert_eq!(buf.as_slice()[4095], 7);
+
+        // Small buffers stay on normal pages
+        let small = PageAlignedBuffer::with_placement(1024, placement).unwrap();
+        assert_eq!(small.capacity(), PAGE_SIZE);
+        assert_eq!(small.placement_flags() & FZ_PAGE_BUFFER_THP, 0);
+        assert_eq!(small.placement_flags() & FZ_PAGE_BUFFER_HUGETLB, 0);
+
+        let flags = FZ_PAGE_BUFFER_THP | FZ_PAGE_BUFFER_NODE_LOCAL;
+        assert_eq!(Placement::from_flags(flags, 1).node, Some(1));
+        assert_eq!(Placement::from_flags(flags, 1).huge, HugePages::Transparent);
+        assert_eq!(Placement::from_flags(0, 1), Placement::default());
+    }
+
+    #[test]
+    fn test_numa_topology() {
+        assert_eq!(parse_id_list("0-3,8,10-11\n"), vec![0, 1, 2, 3, 8, 10, 11]);
+        assert_eq!(parse_id_list(""), Vec::<usize>::new());
+        assert!(numa_node_count() >= 1);
+        assert_eq!(numa_nodes().len(), numa_node_count());
+
+        let node = numa_nodes()[0];
+        let pinned = std::thread::spawn(move || (pin_thread_to_node(node), current_numa_node()))
+            .join()
+            .unwrap();
+        if pinned.0 {
+            assert_eq!(pinned.1, Some(node));
+        }
+        assert!(!pin_thread_to_node(usize::MAX));
+    }
+
     #[test]
     fn test_page_aligned_buffer_from_slice() {
         let data = vec![1u8; 5000];
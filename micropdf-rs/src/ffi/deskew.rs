@@ -2,6 +2,7 @@
 //!
 //! Provides skew angle detection and automatic deskewing of scanned documents.
 
+use crate::ffi::bitmap::{BITMAPS, Bitmap, threshold_pixmap};
 use crate::ffi::colorspace::FZ_COLORSPACE_GRAY;
 use crate::ffi::pixmap::Pixmap;
 use crate::ffi::{Handle, PIXMAPS};
@@ -39,163 +40,156 @@ impl DeskewBorder {
 // Skew Detection Algorithm
 // ============================================================================
 
+/// Largest skew searched for, in degrees either way
+pub const MAX_SKEW_DEGREES: f64 = 15.0;
+
+/// Gray level below which a pixel counts as ink for skew detection
+const SKEW_INK_THRESHOLD: i32 = 128;
+
+/// Longest side, in cells, of the level used for the coarse search
+const SKEW_COARSE_CELLS: usize = 256;
+
 /// Detect skew angle using the projection profile method
 ///
-/// This algorithm:
-/// 1. Converts image to grayscale if needed
-/// 2. Applies edge detection (Sobel-like)
-/// 3. Uses Hough transform variant for line detection
-/// 4. Returns the dominant angle
+/// The pixmap is thresholded to a bitmap and handed to
+/// `detect_skew_bitmap`. Positive angles mean the text rises to the right
+/// in device space (y down), as drawn by a clockwise rotation.
 pub fn detect_skew(pixmap: &Pixmap) -> f64 {
-    let width = pixmap.w() as usize;
-    let height = pixmap.h() as usize;
-    let samples = pixmap.samples();
-    let n = pixmap.n() as usize;
-
-    if width < 10 || height < 10 || samples.is_empty() {
+    if pixmap.w() < 10 || pixmap.h() < 10 || pixmap.samples().is_empty() {
         return 0.0;
     }
-
-    // Convert to grayscale intensity values
-    let gray: Vec<u8> = if n == 1 {
-        samples.to_vec()
-    } else {
-        samples
-            .chunks(n)
-            .map(|pixel| {
-                if n >= 3 {
-                    // RGB or RGBA -> luminance
-                    ((pixel[0] as u32 * 299 + pixel[1] as u32 * 587 + pixel[2] as u32 * 114) / 1000)
-                        as u8
-                } else {
-                    pixel[0]
-                }
-            })
-            .collect()
-    };
-
-    // Detect edges using simple gradient
-    let edges = detect_edges(&gray, width, height);
-
-    // Find dominant angle using projection profile method
-    let angle = find_dominant_angle(&edges, width, height);
-
-    angle
+    detect_skew_bitmap(&threshold_pixmap(pixmap, SKEW_INK_THRESHOLD))
 }
 
-/// Simple edge detection using Sobel-like operators
-fn detect_edges(gray: &[u8], width: usize, height: usize) -> Vec<u8> {
-    let mut edges = vec![0u8; width * height];
-
-    for y in 1..height - 1 {
-        for x in 1..width - 1 {
-            let idx = y * width + x;
-
-            // Sobel X gradient
-            let gx = gray[(y - 1) * width + (x + 1)] as i32
-                - gray[(y - 1) * width + (x - 1)] as i32
-                + 2 * (gray[y * width + (x + 1)] as i32 - gray[y * width + (x - 1)] as i32)
-                + gray[(y + 1) * width + (x + 1)] as i32
-                - gray[(y + 1) * width + (x - 1)] as i32;
-
-            // Sobel Y gradient
-            let gy = gray[(y + 1) * width + (x - 1)] as i32
-                - gray[(y - 1) * width + (x - 1)] as i32
-                + 2 * (gray[(y + 1) * width + x] as i32 - gray[(y - 1) * width + x] as i32)
-                + gray[(y + 1) * width + (x + 1)] as i32
-                - gray[(y - 1) * width + (x + 1)] as i32;
-
-            // Magnitude
-            let magnitude = ((gx * gx + gy * gy) as f64).sqrt();
-            edges[idx] = (magnitude.min(255.0)) as u8;
+/// Detect the skew of the ink in a 1-bit bitmap
+///
+/// Each byte of the bitmap is popcounted once into a grid of cells eight
+/// pixels wide. Trying an angle then only shears whole cell columns up or
+/// down and sums the squared row totals, which peak when text lines lie
+/// along rows. The search runs coarse to fine: whole degrees on a reduced
+/// grid, tenths on a finer one, then hundredths at full resolution.
+pub fn detect_skew_bitmap(bitmap: &Bitmap) -> f64 {
+    if bitmap.width < 10 || bitmap.height < 10 {
+        return 0.0;
+    }
+    let full = CellCounts::from_bitmap(bitmap);
+    if full.counts.iter().all(|&c| c == 0) {
+        return 0.0;
+    }
+
+    let mut levels = vec![full];
+    while let Some(last) = levels.last() {
+        // Cells hold 8 * scale^2 pixels, so stop before u16 counts can overflow
+        if last.rows.max(last.cols) <= SKEW_COARSE_CELLS || last.scale >= 64 {
+            break;
         }
+        let reduced = last.reduce();
+        levels.push(reduced);
     }
+    let coarse = &levels[levels.len() - 1];
+    let middle = &levels[(levels.len() - 1).min(1)];
 
-    edges
+    let mut angle = coarse.best_angle(0.0, MAX_SKEW_DEGREES, 1.0);
+    angle = middle.best_angle(angle, 1.0, 0.1);
+    angle = levels[0].best_angle(angle, 0.1, 0.01);
+    (angle * 100.0).round() / 100.0
 }
 
-/// Find dominant angle using projection profile method
-fn find_dominant_angle(edges: &[u8], width: usize, height: usize) -> f64 {
-    let mut best_angle = 0.0;
-    let mut best_variance = 0.0;
-
-    // Test angles from -15 to +15 degrees in 0.1 degree steps
-    let step = 0.1_f64;
-    let mut angle = -15.0_f64;
-
-    while angle <= 15.0 {
-        let variance = calculate_projection_variance(edges, width, height, angle);
+/// Ink pixel counts of a bitmap in cells of `8 * scale` by `scale` pixels
+struct CellCounts {
+    /// Pixels per cell row; cells are eight times as wide
+    scale: usize,
+    rows: usize,
+    cols: usize,
+    /// Column-major, so shearing a column is one contiguous slice add
+    counts: Vec<u16>,
+}
 
-        if variance > best_variance {
-            best_variance = variance;
-            best_angle = angle;
+impl CellCounts {
+    fn from_bitmap(bitmap: &Bitmap) -> Self {
+        let rows = bitmap.height.max(0) as usize;
+        let cols = (bitmap.width.max(0) as usize).div_ceil(8);
+        let stride = bitmap.stride.max(0) as usize;
+        // Padding bits past the width never count
+        let tail = match bitmap.width % 8 {
+            0 => 0xff,
+            bits => 0xffu8 << (8 - bits),
+        };
+
+        let mut counts = vec![0u16; rows * cols];
+        for (y, row) in bitmap.data.chunks(stride.max(1)).take(rows).enumerate() {
+            for (c, &byte) in row.iter().take(cols).enumerate() {
+                let ink = if bitmap.invert { !byte } else { byte };
+                let mask = if c + 1 == cols { tail } else { 0xff };
+                counts[c * rows + y] = (ink & mask).count_ones() as u16;
+            }
+        }
+        Self {
+            scale: 1,
+            rows,
+            cols,
+            counts,
         }
-
-        angle += step;
     }
 
-    // Refine with smaller steps around best angle
-    let refined_step = 0.01_f64;
-    let mut refined_angle = best_angle - step;
-    let end_angle = best_angle + step;
-
-    while refined_angle <= end_angle {
-        let variance = calculate_projection_variance(edges, width, height, refined_angle);
-
-        if variance > best_variance {
-            best_variance = variance;
-            best_angle = refined_angle;
+    /// Sum 2x2 blocks of cells into a grid of half the size
+    fn reduce(&self) -> Self {
+        let (rows, cols) = (self.rows.div_ceil(2), self.cols.div_ceil(2));
+        let mut counts = vec![0u16; rows * cols];
+        for c in 0..self.cols {
+            let src = &self.counts[c * self.rows..(c + 1) * self.rows];
+            let dst = &mut counts[(c / 2) * rows..(c / 2 + 1) * rows];
+            for (y, &n) in src.iter().enumerate() {
+                dst[y / 2] += n;
+            }
+        }
+        Self {
+            scale: self.scale * 2,
+            rows,
+            cols,
+            counts,
         }
-
-        refined_angle += refined_step;
     }
 
-    best_angle
-}
-
-/// Calculate variance of horizontal projection at given angle
-fn calculate_projection_variance(edges: &[u8], width: usize, height: usize, angle: f64) -> f64 {
-    let rad = angle * PI / 180.0;
-    let cos_a = rad.cos();
-    let sin_a = rad.sin();
-
-    let cx = width as f64 / 2.0;
-    let cy = height as f64 / 2.0;
-
-    // Project onto rotated horizontal axis
-    let mut projection = vec![0u32; height];
-
-    for y in 0..height {
-        for x in 0..width {
-            let edge_val = edges[y * width + x] as u32;
-            if edge_val > 30 {
-                // Threshold
-                // Rotate point
-                let dx = x as f64 - cx;
-                let dy = y as f64 - cy;
-                let ry = (-dx * sin_a + dy * cos_a + cy) as usize;
+    /// Sum of squared row totals after shearing by `degrees`
+    fn score(&self, degrees: f64, bins: &mut Vec<u32>) -> u64 {
+        let tan = (degrees * PI / 180.0).tan();
+        // Cell columns are 8 cell rows wide in pixels
+        let centre = self.cols as f64 * 4.0;
+        let pad = (centre * (MAX_SKEW_DEGREES * PI / 180.0).tan()).ceil() as usize + 8;
+
+        bins.clear();
+        bins.resize(self.rows + 2 * pad, 0);
+        for c in 0..self.cols {
+            let dx = c as f64 * 8.0 + 4.0 - centre;
+            let start = (pad as f64 - dx * tan).round() as usize;
+            let column = &self.counts[c * self.rows..(c + 1) * self.rows];
+            for (bin, &n) in bins[start..start + self.rows].iter_mut().zip(column) {
+                *bin += n as u32;
+            }
+        }
+        bins.iter().map(|&b| b as u64 * b as u64).sum()
+    }
 
-                if ry < height {
-                    projection[ry] += edge_val;
+    /// Best angle in `centre ± span`, tried every `step` degrees
+    ///
+    /// Ties go to the angle closest to `centre`.
+    fn best_angle(&self, centre: f64, span: f64, step: f64) -> f64 {
+        let mut bins = Vec::new();
+        let mut best = (self.score(centre, &mut bins), centre);
+        for i in 1..=(span / step).round() as i32 {
+            for angle in [centre + i as f64 * step, centre - i as f64 * step] {
+                if angle.abs() > MAX_SKEW_DEGREES + 1e-9 {
+                    continue;
+                }
+                let score = self.score(angle, &mut bins);
+                if score > best.0 {
+                    best = (score, angle);
                 }
             }
         }
+        best.1
     }
-
-    // Calculate variance
-    let sum: u64 = projection.iter().map(|&v| v as u64).sum();
-    let mean = sum as f64 / height as f64;
-
-    let variance: f64 = projection
-        .iter()
-        .map(|&v| {
-            let diff = v as f64 - mean;
-            diff * diff
-        })
-        .sum::<f64>()
-        / height as f64;
-
-    variance
 }
 
 // ============================================================================
@@ -315,6 +309,57 @@ pub fn deskew_pixmap(pixmap: &Pixmap, degrees: f64, border: DeskewBorder) -> Opt
     Some(dst)
 }
 
+/// Rotate a gray pixmap and threshold it into a bitmap in one pass
+///
+/// Same mapping as `deskew_pixmap` with `DeskewBorder::Maintain`, but each
+/// interpolated sample is compared against `threshold` straight away, so
+/// no rotated intermediate pixmap is allocated. Only the first channel is
+/// read; pixels outside the source are white.
+pub fn deskew_to_bitmap(pixmap: &Pixmap, degrees: f64, threshold: i32) -> Bitmap {
+    let width = pixmap.w().max(0) as usize;
+    let height = pixmap.h().max(0) as usize;
+    let n = pixmap.n().max(1) as usize;
+    let stride = width.div_ceil(8);
+    let mut data = vec![0u8; stride * height];
+
+    let rad = degrees * PI / 180.0;
+    let (sin_a, cos_a) = rad.sin_cos();
+    let (cx, cy) = (width as f64 / 2.0, height as f64 / 2.0);
+    let samples = pixmap.samples();
+    let at = |x: usize, y: usize| samples[(y * width + x) * n] as f64;
+    let thresh = threshold.clamp(0, 255) as f64;
+
+    if width >= 2 && height >= 2 && samples.len() >= width * height * n {
+        for y in 0..height {
+            let dy = y as f64 - cy;
+            let row = &mut data[y * stride..(y + 1) * stride];
+            for x in 0..width {
+                let dx = x as f64 - cx;
+                let sx = dx * cos_a + dy * sin_a + cx;
+                let sy = -dx * sin_a + dy * cos_a + cy;
+                if sx < 0.0 || sx >= (width - 1) as f64 || sy < 0.0 || sy >= (height - 1) as f64 {
+                    continue;
+                }
+                let (x0, y0) = (sx as usize, sy as usize);
+                let (fx, fy) = (sx - x0 as f64, sy - y0 as f64);
+                let top = at(x0, y0) * (1.0 - fx) + at(x0 + 1, y0) * fx;
+                let bottom = at(x0, y0 + 1) * (1.0 - fx) + at(x0 + 1, y0 + 1) * fx;
+                if (top * (1.0 - fy) + bottom * fy).round() < thresh {
+                    row[x / 8] |= 0x80 >> (x % 8);
+                }
+            }
+        }
+    }
+
+    Bitmap {
+        width: width as i32,
+        height: height as i32,
+        stride: stride as i32,
+        data,
+        ..Bitmap::default()
+    }
+}
+
 // ============================================================================
 // FFI Functions
 // ============================================================================
@@ -338,6 +383,21 @@ pub extern "C" fn fz_detect_skew(_ctx: Handle, pixmap: Handle) -> f64 {
     detect_skew(&guard)
 }
 
+/// Detect skew angle in a 1-bit bitmap
+///
+/// Set bits are ink (clear bits if the bitmap is inverted). Same angle
+/// convention as `fz_detect_skew`; returns 0.0 for an invalid handle.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_detect_skew_bitmap(_ctx: Handle, bitmap: Handle) -> f64 {
+    let Some(bm) = BITMAPS.get(bitmap) else {
+        return 0.0;
+    };
+    let Ok(guard) = bm.lock() else {
+        return 0.0;
+    };
+    detect_skew_bitmap(&guard)
+}
+
 /// Deskew a pixmap by rotating it
 ///
 /// @param ctx      Context handle
@@ -902,4 +962,69 @@ mod tests {
         assert_eq!(fz_flip_pixmap_horizontal(1, 0), 0);
         assert_eq!(fz_flip_pixmap_vertical(1, 0), 0);
     }
+
+    #[test]
+    fn test_deskew_to_bitmap_matches_two_pass() {
+        let handle = create_skewed_text_pixmap(120, 90, 3.0);
+        let pix = PIXMAPS.get(handle).unwrap();
+        let guard = pix.lock().unwrap();
+
+        let rotated = deskew_pixmap(&guard, -3.0, DeskewBorder::Maintain).unwrap();
+        let expected = threshold_pixmap(&rotated, 128);
+        let fused = deskew_to_bitmap(&guard, -3.0, 128);
+        assert_eq!((fused.width, fused.height), (120, 90));
+        assert_eq!(fused.stride, expected.stride);
+        assert_eq!(fused.data, expected.data);
+        assert!(fused.data.iter().any(|&b| b != 0));
+
+        drop(guard);
+        PIXMAPS.remove(handle);
+    }
+
+    #[test]
+    fn test_detect_skew_recovers_angle() {
+        for skew in [3.0, -2.0, 0.4, 0.0] {
+            let handle = create_skewed_text_pixmap(600, 400, skew);
+            let angle = fz_detect_skew(1, handle);
+            assert!(
+                (angle - skew).abs() < 0.25,
+                "expected about {skew}, got {angle}"
+            );
+            PIXMAPS.remove(handle);
+        }
+    }
+
+    #[test]
+    fn test_detect_skew_bitmap() {
+        let handle = create_skewed_text_pixmap(400, 300, 4.0);
+        let bitmap = {
+            let pix = PIXMAPS.get(handle).unwrap();
+            let guard = pix.lock().unwrap();
+            threshold_pixmap(&guard, 128)
+        };
+        PIXMAPS.remove(handle);
+
+        let expected = detect_skew_bitmap(&bitmap);
+        assert!((expected - 4.0).abs() < 0.25, "got {expected}");
+
+        // Inverting both the bits and the flag leaves the ink unchanged
+        let mut inverted = bitmap.clone();
+        inverted.invert = true;
+        inverted.data.iter_mut().for_each(|b| *b = !*b);
+        assert_eq!(detect_skew_bitmap(&inverted), expected);
+
+        let blank = Bitmap {
+            width: 64,
+            height: 64,
+            stride: 8,
+            data: vec![0; 512],
+            ..Bitmap::default()
+        };
+        assert_eq!(detect_skew_bitmap(&blank), 0.0);
+
+        let bitmap = BITMAPS.insert(bitmap);
+        assert_eq!(fz_detect_skew_bitmap(1, bitmap), expected);
+        BITMAPS.remove(bitmap);
+        assert_eq!(fz_detect_skew_bitmap(1, bitmap), 0.0);
+    }
 }
@@ -75,13 +75,14 @@ pub extern "C" fn fz_new_trace_device(_ctx: Handle) -> Handle {
 
 /// Create a list device for recording display list
 ///
-/// # Safety
-/// Caller must ensure list is a valid handle.
+/// The recorded commands are appended to `list` when the device is closed.
+/// An invalid list handle gives a device that records into a private list.
 #[unsafe(no_mangle)]
-pub extern "C" fn fz_new_list_device(_ctx: Handle, _list: Handle) -> Handle {
-    // Create list device with default media box (will be updated when used)
-    let mediabox = Rect::new(0.0, 0.0, 612.0, 792.0); // Letter size default
-    let device: Box<dyn Device + Send + Sync> = Box::new(ListDevice::new(mediabox));
+pub extern "C" fn fz_new_list_device(_ctx: Handle, list: Handle) -> Handle {
+    let device: Box<dyn Device + Send + Sync> = match super::display_list::DISPLAY_LISTS.get(list) {
+        Some(target) => Box::new(ListDevice::with_target(target)),
+        None => Box::new(ListDevice::new(Rect::new(0.0, 0.0, 612.0, 792.0))),
+    };
     DEVICES.insert(device)
 }
 
@@ -801,6 +802,30 @@ pub extern "C" fn fz_end_group(_ctx: Handle, dev: Handle) {
     }
 }
 
+/// Begin content belonging to the named layer (optional content group)
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_begin_layer(_ctx: Handle, dev: Handle, name: *const std::ffi::c_char) {
+    if name.is_null() {
+        return;
+    }
+    let name = unsafe { std::ffi::CStr::from_ptr(name) }.to_string_lossy();
+    if let Some(device) = DEVICES.get(dev) {
+        if let Ok(mut guard) = device.lock() {
+            guard.begin_layer(&name);
+        }
+    }
+}
+
+/// End layer
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_end_layer(_ctx: Handle, dev: Handle) {
+    if let Some(device) = DEVICES.get(dev) {
+        if let Ok(mut guard) = device.lock() {
+            guard.end_layer();
+        }
+    }
+}
+
 /// Check if device is valid
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_device_is_valid(_ctx: Handle, dev: Handle) -> i32 {
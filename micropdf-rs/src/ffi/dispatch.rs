@@ -0,0 +1,120 @@
+//! Kernel Dispatch
+//!
+//! Span compositing, pixel colour conversion, gradient rows, resampling,
+//! the PNG row filters and their inverses, and byte search each have a scalar kernel and one
+//! or more per instruction set. Rather than test CPU features on every
+//! call, the kernels for a SIMD level are gathered once into a table of
+//! function pointers, and callers go through the active table.
+//!
+//! `fz_new_context` selects the table for the best level the CPU runs;
+//! [`set_level`](super::simd_util::set_level) selects another, so kernels
+//! can be compared in one process. The kernels take no context, so the
+//! table is process wide, and a table is only built for a level the CPU
+//! runs, which is what makes calling through it sound.
+
+use std::ptr;
+use std::sync::OnceLock;
+use std::sync::atomic::{AtomicPtr, Ordering};
+
+use super::composite::{self, PaintFn};
+use super::pixel_convert::{self, ConvertFn};
+use super::png_encode::{self, CostFn, FilterFn};
+use super::predict::{self, UnfilterFn};
+use super::resample::{self, Kernels};
+use super::shade_paint::{self, GradientFn};
+use super::simd_util::{self, FindFn, SimdLevel, active_level};
+
+/// The kernels one SIMD level runs
+#[derive(Clone, Copy)]
+pub(super) struct KernelTable {
+    pub level: SimdLevel,
+    pub paint_span: PaintFn,
+    pub convert_pixels: ConvertFn,
+    pub gradient_row: GradientFn,
+    pub resample: Kernels,
+    pub png_filter: FilterFn,
+    pub png_cost: CostFn,
+    pub png_unfilter: UnfilterFn,
+    pub find_bytes: FindFn,
+}
+
+impl KernelTable {
+    fn for_level(level: SimdLevel) -> Self {
+        Self {
+            level,
+            paint_span: composite::paint_kernel(level),
+            convert_pixels: pixel_convert::convert_kernel(level),
+            gradient_row: shade_paint::gradient_kernel(level),
+            resample: resample::Kernels::for_level(level),
+            png_filter: png_encode::filter_kernel(level),
+            png_cost: png_encode::cost_kernel(level),
+            png_unfilter: predict::unfilter_kernel(level),
+            find_bytes: simd_util::find_kernel(level),
+        }
+    }
+}
+
+/// Table per `SimdLevel`, built on first selection
+static TABLES: [OnceLock<KernelTable>; 6] = [const { OnceLock::new() }; 6];
+
+/// Table the kernels dispatch through; null until first selected
+static ACTIVE: AtomicPtr<KernelTable> = AtomicPtr::new(ptr::null_mut());
+
+/// Make the table for `level` the active one
+///
+/// `level` must be one the CPU runs.
+pub(super) fn select(level: SimdLevel) -> &'static KernelTable {
+    let table = TABLES[level as usize].get_or_init(|| KernelTable::for_level(level));
+    ACTIVE.store(ptr::from_ref(table).cast_mut(), Ordering::Release);
+    table
+}
+
+/// Select the table for the active level unless one already is
+pub fn init() {
+    if ACTIVE.load(Ordering::Acquire).is_null() {
+        select(active_level());
+    }
+}
+
+/// The active kernel table
+///
+/// Selected by `fz_new_context`; code running without a context selects
+/// it here on first use.
+#[inline]
+pub(super) fn kernels() -> &'static KernelTable {
+    let table = ACTIVE.load(Ordering::Acquire);
+    if table.is_null() {
+        return select(active_level());
+    }
+    // Only ever set from a static `OnceLock`
+    unsafe { &*table }
+}
+
+/// Level whose kernels the active table holds
+pub fn dispatch_level() -> SimdLevel {
+    kernels().level
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_table_follows_level() {
+        init();
+        for level in simd_util::available_levels() {
+            let table = select(level);
+            assert_eq!(table.level, level);
+            assert!(ptr::eq(table, TABLES[level as usize].get().unwrap()));
+        }
+
+        let scalar = select(SimdLevel::Scalar);
+        assert_eq!(scalar.resample, Kernels::Scalar);
+        let haystack = b"stream endstream endobj";
+        assert_eq!(
+            unsafe { (scalar.find_bytes)(haystack, b"endobj") },
+            Some(17)
+        );
+        select(active_level());
+    }
+}
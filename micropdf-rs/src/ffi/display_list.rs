@@ -2,9 +2,15 @@
 //!
 //! Display lists record drawing operations for caching and playback.
 
+use std::ffi::c_void;
 use std::sync::LazyLock;
 
-use super::{Handle, HandleStore};
+use super::buffer::{Buffer, fz_drop_buffer};
+use super::cookie::COOKIES;
+use super::document::{FZ_RENDER_ANNOTS, FZ_RENDER_WIDGETS, PAGES};
+use super::draw_device::{DRAW_DEVICES, DrawPlayback};
+use super::store::{StoreType, store_discard_matching, store_find_and_keep, store_owned_item};
+use super::{BUFFERS, DOCUMENTS, Handle, HandleStore};
 use crate::fitz::display_list::DisplayList;
 use crate::fitz::geometry::{Matrix, Rect};
 
@@ -34,7 +40,7 @@ pub extern "C" fn fz_new_display_list(_ctx: Handle, x0: f32, y0: f32, x1: f32, y
 /// The same handle
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_keep_display_list(_ctx: Handle, list: Handle) -> Handle {
-    list
+    DISPLAY_LISTS.keep(list)
 }
 
 /// Decrement reference count and free display list if zero
@@ -43,7 +49,7 @@ pub extern "C" fn fz_keep_display_list(_ctx: Handle, list: Handle) -> Handle {
 /// * `list` - Handle to the display list
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_drop_display_list(_ctx: Handle, list: Handle) {
-    DISPLAY_LISTS.remove(list);
+    DISPLAY_LISTS.release(list);
 }
 
 /// Get the media box of a display list
@@ -76,6 +82,11 @@ pub extern "C" fn fz_bound_display_list(_ctx: Handle, list: Handle) -> super::ge
 
 /// Run a display list through a device
 ///
+/// With a finite scissor (a tile, say) the list's bbox tree is walked, so
+/// only commands, clips and groups that touch the scissor are run. The
+/// tree is built when a list device closes into the list, or on the first
+/// scissored run.
+///
 /// # Arguments
 /// * `list` - Handle to the display list
 /// * `dev` - Handle to the device to run the list on
@@ -112,6 +123,93 @@ pub extern "C" fn fz_run_display_list(
     }
 }
 
+/// Run a display list with the layers `doc` has disabled left out
+///
+/// Layers are matched by name against the document's current layer
+/// configuration (see `pdf_enable_layer` and `pdf_select_layer_config`);
+/// layers it doesn't know stay visible. A cached list can so be
+/// replayed after toggling layers without interpreting the page again.
+///
+/// # Arguments
+/// * `list` - Handle to the display list to run
+/// * `dev` - Handle to the device to run the list on
+/// * `ctm` - Current transformation matrix
+/// * `scissor` - Scissor rectangle for clipping
+/// * `doc` - Handle to the document whose layer states apply
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_run_display_list_with_layers(
+    _ctx: Handle,
+    list: Handle,
+    dev: Handle,
+    ctm: super::geometry::fz_matrix,
+    scissor: super::geometry::fz_rect,
+    doc: Handle,
+) {
+    let hidden = super::pdf_layer::hidden_layers(doc);
+    let Some(l) = DISPLAY_LISTS.get(list) else {
+        return;
+    };
+    let Some(device) = super::device::DEVICES.get(dev) else {
+        return;
+    };
+    let matrix = Matrix {
+        a: ctm.a,
+        b: ctm.b,
+        c: ctm.c,
+        d: ctm.d,
+        e: ctm.e,
+        f: ctm.f,
+    };
+    let rect = Rect::new(scissor.x0, scissor.y0, scissor.x1, scissor.y1);
+    if let (Ok(list_guard), Ok(mut dev_guard)) = (l.lock(), device.lock()) {
+        list_guard.run_with_layers(&mut **dev_guard, &matrix, rect, &|name| {
+            !hidden.contains(name)
+        });
+    }
+}
+
+/// Play a display list onto a draw device, checking `cookie` per command
+///
+/// The cookie's progress maximum grows by the list's length and its
+/// progress by one for each command passed, so a render can be stopped
+/// partway through a page and watched as it goes. Returns false if the
+/// cookie was aborted before the list ran out or a handle is invalid.
+pub(crate) fn draw_display_list(
+    list: Handle,
+    draw: Handle,
+    ctm: super::geometry::fz_matrix,
+    scissor: super::geometry::fz_rect,
+    cookie: Handle,
+) -> bool {
+    let Some(l) = DISPLAY_LISTS.get(list) else {
+        return false;
+    };
+    let Some(device) = DRAW_DEVICES.get(draw) else {
+        return false;
+    };
+    // Clones share their counters, so the store entry needn't stay locked
+    let cookie = COOKIES
+        .get(cookie)
+        .and_then(|c| c.lock().ok().map(|c| c.clone()))
+        .unwrap_or_default();
+    let matrix = Matrix {
+        a: ctm.a,
+        b: ctm.b,
+        c: ctm.c,
+        d: ctm.d,
+        e: ctm.e,
+        f: ctm.f,
+    };
+    let rect = Rect::new(scissor.x0, scissor.y0, scissor.x1, scissor.y1);
+    let (Ok(list_guard), Ok(mut dev_guard)) = (l.lock(), device.lock()) else {
+        return false;
+    };
+    let len = i32::try_from(list_guard.len()).unwrap_or(i32::MAX);
+    cookie.set_progress_max(cookie.progress_max().saturating_add(len));
+    let mut playback = DrawPlayback::new(&mut dev_guard);
+    list_guard.run_with_cookie(&mut playback, &matrix, rect, &cookie)
+}
+
 /// Get the number of commands in a display list
 ///
 /// # Arguments
@@ -186,13 +284,301 @@ pub extern "C" fn fz_display_list_is_valid(_ctx: Handle, list: Handle) -> i32 {
 pub extern "C" fn fz_clone_display_list(_ctx: Handle, list: Handle) -> Handle {
     if let Some(l) = DISPLAY_LISTS.get(list) {
         if let Ok(guard) = l.lock() {
-            let cloned = DisplayList::new(guard.mediabox());
-            return DISPLAY_LISTS.insert(cloned);
+            return DISPLAY_LISTS.insert(guard.clone());
         }
     }
     0
 }
 
+/// Optimize a display list for repeated playback
+///
+/// Culls commands outside the mediabox or their clips, drops empty and
+/// redundant clips and groups, and merges runs of same-coloured fills.
+///
+/// # Arguments
+/// * `list` - Handle to the display list
+///
+/// # Returns
+/// Number of commands removed, or -1 if the list is invalid
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_optimize_display_list(_ctx: Handle, list: Handle) -> i32 {
+    if let Some(l) = DISPLAY_LISTS.get(list) {
+        if let Ok(mut guard) = l.lock() {
+            return guard.optimize() as i32;
+        }
+    }
+    -1
+}
+
+// ============================================================================
+// Page Display Lists
+// ============================================================================
+
+/// Record a page into a new display list
+///
+/// `flags` selects what is run after the page contents, as for
+/// `fz_new_pixmap_from_page_with_options`. Returns 0 if the page is invalid,
+/// or the cookie was aborted or a memory limit exceeded while recording.
+fn record_page(ctx: Handle, page: Handle, flags: i32, cookie: Handle) -> Handle {
+    if PAGES.get(page).is_none() {
+        return 0;
+    }
+    let _span = super::trace::span(c"interpret");
+    let memory = super::document::enter_page_memory(page, cookie);
+    let bounds = super::document::fz_bound_page(ctx, page);
+    let list = fz_new_display_list(ctx, bounds.x0, bounds.y0, bounds.x1, bounds.y1);
+    let dev = super::device::fz_new_list_device(ctx, list);
+    let identity = super::geometry::fz_matrix::identity();
+    let cookie_ptr = cookie as *mut std::ffi::c_void;
+
+    super::document::fz_run_page_contents(ctx, page, dev, identity, cookie_ptr);
+    if flags & FZ_RENDER_ANNOTS != 0 {
+        super::document::fz_run_page_annots(ctx, page, dev, identity, cookie_ptr);
+    }
+    super::device::fz_close_device(ctx, dev);
+    super::device::fz_drop_device(ctx, dev);
+
+    if super::document::memory_exceeded(ctx, &memory, cookie)
+        || super::cookie::fz_cookie_should_abort(ctx, cookie) != 0
+    {
+        fz_drop_display_list(ctx, list);
+        return 0;
+    }
+    list
+}
+
+/// Record a page, including annotations and widgets, into a display list
+///
+/// # Returns
+/// Handle to the new display list, or 0 if the page is invalid
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_display_list_from_page(ctx: Handle, page: Handle) -> Handle {
+    record_page(ctx, page, FZ_RENDER_ANNOTS | FZ_RENDER_WIDGETS, 0)
+}
+
+/// Record only the page contents (no annotations or widgets) into a display list
+///
+/// # Returns
+/// Handle to the new display list, or 0 if the page is invalid
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_display_list_from_page_contents(ctx: Handle, page: Handle) -> Handle {
+    record_page(ctx, page, 0, 0)
+}
+
+/// Key prefix for cached page lists of one document
+fn page_list_key_prefix(doc: Handle) -> Vec<u8> {
+    let mut key = b"fz_display_list:".to_vec();
+    key.extend_from_slice(&doc.to_le_bytes());
+    key
+}
+
+fn page_list_key(doc: Handle, generation: u64, page_num: i32, flags: i32) -> Vec<u8> {
+    let mut key = page_list_key_prefix(doc);
+    key.extend_from_slice(&generation.to_le_bytes());
+    key.extend_from_slice(&page_num.to_le_bytes());
+    key.extend_from_slice(&flags.to_le_bytes());
+    key
+}
+
+fn keep_list(list: Handle) -> Handle {
+    if DISPLAY_LISTS.get(list).is_none() {
+        return 0;
+    }
+    DISPLAY_LISTS.keep(list)
+}
+
+fn release_list(list: Handle) {
+    DISPLAY_LISTS.release(list);
+}
+
+/// Get the display list for a page from the store, recording it on a miss
+///
+/// Lists are keyed by (document, generation, page number, flags), where the
+/// generation counts rewrites of the document (recolor, sign, clean, ...),
+/// so an edited document records fresh lists; lists of older generations
+/// are never found again and age out of the store. They are held by the
+/// resource store as `StoreType::DisplayList` items, so they count towards
+/// `fz_store_type_size` and are evicted with the rest of the store; use
+/// `fz_store_set_type_limit` to bound them separately. Repeat renders of a
+/// page at other zoom levels replay the list instead of running the page
+/// again. Lists are optimized (see `fz_optimize_display_list`) before they
+/// are stored, so tiled renders only replay what each tile touches.
+///
+/// # Arguments
+/// * `flags` - Bitwise OR of `FZ_RENDER_ANNOTS` and `FZ_RENDER_WIDGETS`
+/// * `cookie` - Cookie checked while recording, or 0 for none
+///
+/// # Returns
+/// A new reference to the list (drop with `fz_drop_display_list`), or 0 if
+/// the page is invalid or recording was aborted
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_cached_display_list_from_page(
+    ctx: Handle,
+    page: Handle,
+    flags: i32,
+    cookie: Handle,
+) -> Handle {
+    let Some((doc, page_num)) = PAGES
+        .get(page)
+        .and_then(|p| p.lock().ok().map(|g| (g.doc_handle, g.page_num)))
+    else {
+        return 0;
+    };
+    let Some(generation) = DOCUMENTS
+        .get(doc)
+        .and_then(|d| d.lock().ok().map(|g| g.generation()))
+    else {
+        return 0;
+    };
+    let flags = flags & (FZ_RENDER_ANNOTS | FZ_RENDER_WIDGETS);
+    let key = page_list_key(doc, generation, page_num, flags);
+
+    let cached = store_find_and_keep(&key, keep_list);
+    if cached != 0 {
+        return cached;
+    }
+
+    let list = record_page(ctx, page, flags, cookie);
+    if list == 0 {
+        return 0;
+    }
+    let size = DISPLAY_LISTS
+        .get(list)
+        .and_then(|l| {
+            l.lock().ok().map(|mut g| {
+                g.optimize();
+                g.approx_size()
+            })
+        })
+        .unwrap_or(0);
+    // The store takes its own reference; the caller keeps the one from recording
+    store_owned_item(
+        StoreType::DisplayList,
+        DISPLAY_LISTS.keep(list),
+        size,
+        &key,
+        release_list,
+    );
+    list
+}
+
+/// Drop the cached page display lists of a document
+///
+/// Call after editing a document so later renders record fresh lists.
+/// `fz_drop_document` does this automatically.
+///
+/// # Returns
+/// Number of lists removed from the store
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_purge_display_list_cache(_ctx: Handle, doc: Handle) -> i32 {
+    store_discard_matching(StoreType::DisplayList, &page_list_key_prefix(doc)) as i32
+}
+
+// ============================================================================
+// Serialization
+// ============================================================================
+
+/// Store font programs and image data inline in a serialized list
+pub const FZ_DISPLAY_LIST_EMBED: i32 = 1;
+
+/// Supplies data a serialized list names by its 32-byte SHA-256: returns
+/// a buffer holding it, which the library drops, or 0 if not found
+pub type DisplayListFetchFn =
+    Option<unsafe extern "C" fn(ctx: Handle, hash: *const u8, opaque: *mut c_void) -> Handle>;
+
+/// Serialize a display list into a new buffer
+///
+/// With `FZ_DISPLAY_LIST_EMBED` in `flags` the buffer is self-contained;
+/// otherwise font programs and image data are only named by hash, and
+/// are got with `fz_display_list_resource` to be stored separately.
+///
+/// # Returns
+/// Buffer handle, or 0 if the list is invalid
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_buffer_from_display_list(
+    _ctx: Handle,
+    list: Handle,
+    flags: i32,
+) -> Handle {
+    let Some(list) = DISPLAY_LISTS.get(list) else {
+        return 0;
+    };
+    let bytes = list
+        .lock()
+        .unwrap()
+        .to_bytes(flags & FZ_DISPLAY_LIST_EMBED != 0);
+    BUFFERS.insert(Buffer::from_vec(bytes))
+}
+
+/// Get the number of font programs and images a display list uses
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_display_list_count_resources(_ctx: Handle, list: Handle) -> i32 {
+    DISPLAY_LISTS
+        .get(list)
+        .map_or(0, |l| l.lock().unwrap().resources().len() as i32)
+}
+
+/// Get one of the font programs or images a display list uses
+///
+/// Writes its SHA-256 to `hash` (32 bytes) if not null.
+///
+/// # Returns
+/// Buffer holding the data, or 0 if `index` is out of range
+///
+/// # Safety
+/// `hash` must be null or valid for writing 32 bytes
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_display_list_resource(
+    _ctx: Handle,
+    list: Handle,
+    index: i32,
+    hash: *mut u8,
+) -> Handle {
+    let Some(list) = DISPLAY_LISTS.get(list) else {
+        return 0;
+    };
+    let guard = list.lock().unwrap();
+    let resources = guard.resources();
+    let Some(resource) = usize::try_from(index).ok().and_then(|i| resources.get(i)) else {
+        return 0;
+    };
+    if !hash.is_null() {
+        // SAFETY: caller guarantees hash is valid for 32 bytes
+        unsafe { std::ptr::copy_nonoverlapping(resource.hash.as_ptr(), hash, 32) };
+    }
+    BUFFERS.insert(Buffer::from_data(resource.data))
+}
+
+/// Read a display list serialized with `fz_new_buffer_from_display_list`
+///
+/// Data not stored inline is asked of `fetch` (may be null for a
+/// self-contained list). Font faces already loaded, for instance from
+/// an open context snapshot, are used without asking.
+///
+/// # Returns
+/// Display list handle, or 0 if the buffer is not a serialized list or
+/// data it names could not be found
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_display_list_from_buffer(
+    ctx: Handle,
+    buf: Handle,
+    fetch: DisplayListFetchFn,
+    opaque: *mut c_void,
+) -> Handle {
+    let Some(buf) = BUFFERS.get(buf) else {
+        return 0;
+    };
+    let mut fetch = |hash: &[u8; 32]| {
+        // SAFETY: caller guarantees fetch is a valid callback
+        let data = unsafe { fetch?(ctx, hash.as_ptr(), opaque) };
+        let bytes = BUFFERS.get(data).map(|b| b.lock().unwrap().data().to_vec());
+        fz_drop_buffer(ctx, data);
+        bytes
+    };
+    let list = DisplayList::from_bytes(buf.lock().unwrap().data(), &mut fetch);
+    list.map_or(0, |list| DISPLAY_LISTS.insert(list))
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -277,4 +663,293 @@ mod tests {
         crate::ffi::device::fz_drop_device(0, bbox_dev);
         fz_drop_display_list(0, list);
     }
+
+    #[test]
+    fn test_keep_drop_display_list_refcount() {
+        let list = fz_new_display_list(0, 0.0, 0.0, 100.0, 100.0);
+        fz_keep_display_list(0, list);
+        fz_drop_display_list(0, list);
+        assert_eq!(fz_display_list_is_valid(0, list), 1);
+        fz_drop_display_list(0, list);
+        assert_eq!(fz_display_list_is_valid(0, list), 0);
+    }
+
+    #[test]
+    fn test_new_display_list_from_page() {
+        use crate::ffi::DOCUMENTS;
+        use crate::ffi::document::{Document, fz_drop_page, fz_load_page};
+
+        let doc = DOCUMENTS.insert(Document::new(b"%PDF-1.4\n/Type /Page\n%%EOF".to_vec()));
+        let page = fz_load_page(0, doc, 0);
+        let list = fz_new_display_list_from_page(0, page);
+        assert_ne!(list, 0);
+        assert_eq!(fz_bound_display_list(0, list).x1, 612.0);
+        fz_drop_display_list(0, list);
+        assert_eq!(fz_new_display_list_from_page_contents(0, 0), 0);
+
+        fz_drop_page(0, page);
+        DOCUMENTS.remove(doc);
+    }
+
+    #[test]
+    fn test_cached_display_list_from_page() {
+        use crate::ffi::DOCUMENTS;
+        use crate::ffi::document::{Document, fz_drop_document, fz_drop_page, fz_load_page};
+        use crate::ffi::store::{STORE_TEST_LOCK, fz_store_find, fz_store_type_count};
+
+        let _guard = STORE_TEST_LOCK.lock().unwrap_or_else(|e| e.into_inner());
+
+        let doc = DOCUMENTS.insert(Document::new(b"%PDF-1.4\n/Type /Page\n%%EOF".to_vec()));
+        let page = fz_load_page(0, doc, 0);
+        let flags = FZ_RENDER_ANNOTS | FZ_RENDER_WIDGETS;
+
+        let first = fz_cached_display_list_from_page(0, page, flags, 0);
+        assert_ne!(first, 0);
+        let before = fz_store_type_count(0, StoreType::DisplayList as i32);
+        assert!(before >= 1);
+
+        // A second page object for the same page hits the cache
+        let again = fz_load_page(0, doc, 0);
+        let second = fz_cached_display_list_from_page(0, again, flags, 0);
+        assert_eq!(second, first);
+
+        // Other flags record a separate list
+        let contents = fz_cached_display_list_from_page(0, page, 0, 0);
+        assert_ne!(contents, first);
+
+        // The store still holds the list after the callers drop theirs
+        fz_drop_display_list(0, first);
+        fz_drop_display_list(0, second);
+        fz_drop_display_list(0, contents);
+        assert_eq!(fz_display_list_is_valid(0, first), 1);
+
+        // Dropping the document purges its lists
+        fz_drop_page(0, page);
+        fz_drop_page(0, again);
+        fz_drop_document(0, doc);
+        assert_eq!(fz_display_list_is_valid(0, first), 0);
+        assert_eq!(fz_display_list_is_valid(0, contents), 0);
+        let key = page_list_key(doc, 0, 0, flags);
+        assert_eq!(fz_store_find(0, key.as_ptr(), key.len()), 0);
+        assert_eq!(fz_purge_display_list_cache(0, doc), 0);
+    }
+
+    #[test]
+    fn test_cached_display_list_after_rewrite() {
+        use crate::ffi::document::{Document, fz_drop_document, fz_drop_page, fz_load_page};
+        use crate::ffi::store::STORE_TEST_LOCK;
+
+        let _guard = STORE_TEST_LOCK.lock().unwrap_or_else(|e| e.into_inner());
+
+        let doc = DOCUMENTS.insert(Document::new(b"%PDF-1.4\n/Type /Page\n%%EOF".to_vec()));
+        let page = fz_load_page(0, doc, 0);
+        let first = fz_cached_display_list_from_page(0, page, 0, 0);
+        assert_ne!(first, 0);
+        assert_eq!(fz_cached_display_list_from_page(0, page, 0, 0), first);
+
+        // Rewriting the file (as recolor, signing, clean, ... do) makes the
+        // next render record a fresh list instead of replaying the old one
+        DOCUMENTS
+            .get(doc)
+            .unwrap()
+            .lock()
+            .unwrap()
+            .replace_data(b"%PDF-1.4\n/Type /Page\n%rewritten\n%%EOF".to_vec());
+        let rewritten = fz_cached_display_list_from_page(0, page, 0, 0);
+        assert_ne!(rewritten, 0);
+        assert_ne!(rewritten, first);
+        assert_eq!(fz_cached_display_list_from_page(0, page, 0, 0), rewritten);
+
+        for list in [first, first, rewritten, rewritten] {
+            fz_drop_display_list(0, list);
+        }
+        fz_drop_page(0, page);
+        fz_drop_document(0, doc);
+        assert_eq!(fz_display_list_is_valid(0, rewritten), 0);
+    }
+
+    #[test]
+    fn test_clone_display_list_copies_commands() {
+        use crate::fitz::device::Device;
+        use crate::fitz::display_list::ListDevice;
+
+        let mut device = ListDevice::new(Rect::new(0.0, 0.0, 10.0, 10.0));
+        device.pop_clip();
+        let list = DISPLAY_LISTS.insert(device.into_display_list());
+
+        let clone = fz_clone_display_list(0, list);
+        assert_ne!(clone, list);
+        assert_eq!(fz_display_list_count_commands(0, clone), 1);
+        fz_drop_display_list(0, clone);
+        fz_drop_display_list(0, list);
+    }
+
+    #[test]
+    fn test_optimize_display_list() {
+        use crate::fitz::device::{BlendMode, Device};
+        use crate::fitz::display_list::ListDevice;
+
+        let mut device = ListDevice::new(Rect::new(0.0, 0.0, 10.0, 10.0));
+        device.begin_group(Rect::INFINITE, None, false, false, BlendMode::Normal, 1.0);
+        device.end_group();
+        let list = DISPLAY_LISTS.insert(device.into_display_list());
+
+        assert_eq!(fz_optimize_display_list(0, list), 2);
+        assert_eq!(fz_display_list_is_empty(0, list), 1);
+        fz_drop_display_list(0, list);
+        assert_eq!(fz_optimize_display_list(0, list), -1);
+    }
+
+    #[test]
+    fn test_run_display_list_with_layers() {
+        use crate::ffi::device::{fz_close_device, fz_drop_device, fz_new_list_device};
+        use crate::ffi::pdf_layer::{pdf_add_layer, pdf_drop_ocg, pdf_enable_layer};
+        use crate::fitz::colorspace::Colorspace;
+        use crate::fitz::device::Device;
+        use crate::fitz::display_list::ListDevice;
+        use crate::fitz::path::Path;
+
+        let mut device = ListDevice::new(Rect::new(0.0, 0.0, 10.0, 10.0));
+        let mut path = Path::new();
+        path.rect_coords(1.0, 1.0, 2.0, 2.0);
+        let cs = Colorspace::device_gray();
+        device.begin_layer("Grid");
+        device.fill_path(&path, false, &Matrix::IDENTITY, &cs, &[0.0], 1.0);
+        device.end_layer();
+        device.fill_path(&path, false, &Matrix::IDENTITY, &cs, &[1.0], 1.0);
+        let list = DISPLAY_LISTS.insert(device.into_display_list());
+
+        let doc: Handle = 0x141_0000;
+        let grid = pdf_add_layer(0, doc, c"Grid".as_ptr(), 1);
+        let replay = || {
+            let copy = fz_new_display_list(0, 0.0, 0.0, 10.0, 10.0);
+            let dev = fz_new_list_device(0, copy);
+            let identity = super::super::geometry::fz_matrix::identity();
+            let infinite = super::super::geometry::fz_rect {
+                x0: f32::NEG_INFINITY,
+                y0: f32::NEG_INFINITY,
+                x1: f32::INFINITY,
+                y1: f32::INFINITY,
+            };
+            fz_run_display_list_with_layers(0, list, dev, identity, infinite, doc);
+            fz_close_device(0, dev);
+            fz_drop_device(0, dev);
+            let count = fz_display_list_count_commands(0, copy);
+            fz_drop_display_list(0, copy);
+            count
+        };
+        assert_eq!(replay(), 4);
+        // Disabling the layer needs no new list
+        pdf_enable_layer(0, doc, grid, 0);
+        assert_eq!(replay(), 1);
+
+        pdf_drop_ocg(0, doc);
+        fz_drop_display_list(0, list);
+    }
+
+    #[test]
+    fn test_draw_display_list_with_cookie() {
+        use crate::ffi::PIXMAPS;
+        use crate::ffi::colorspace::FZ_COLORSPACE_GRAY;
+        use crate::ffi::cookie::*;
+        use crate::ffi::draw_device::{fz_drop_draw_device, fz_new_draw_device_with_options};
+        use crate::ffi::pixmap::Pixmap;
+        use crate::fitz::colorspace::Colorspace;
+        use crate::fitz::device::Device;
+        use crate::fitz::display_list::ListDevice;
+        use crate::fitz::path::Path;
+
+        let mut device = ListDevice::new(Rect::new(0.0, 0.0, 50.0, 1.0));
+        let cs = Colorspace::device_gray();
+        for x in 0..50 {
+            let mut path = Path::new();
+            path.rect_coords(x as f32, 0.0, x as f32 + 1.0, 1.0);
+            device.fill_path(&path, false, &Matrix::IDENTITY, &cs, &[0.0], 1.0);
+        }
+        let list = DISPLAY_LISTS.insert(device.into_display_list());
+        let identity = super::super::geometry::fz_matrix::identity();
+        let scissor = super::super::geometry::fz_infinite_rect;
+        let draw = |cookie: Handle| {
+            let mut page = Pixmap::new(FZ_COLORSPACE_GRAY, 50, 1, false);
+            page.clear_with_value(255);
+            let target = PIXMAPS.insert(page);
+            let dev = fz_new_draw_device_with_options(0, target, 0, 0);
+            let done = draw_display_list(list, dev, identity, scissor, cookie);
+            fz_drop_draw_device(0, dev);
+            let pixels = PIXMAPS.remove(target).unwrap();
+            let pixels = pixels.lock().unwrap().samples().to_vec();
+            (done, pixels)
+        };
+
+        let cookie = fz_new_cookie(0);
+        let (done, pixels) = draw(cookie);
+        assert!(done);
+        assert!(pixels.iter().all(|&p| p == 0));
+        assert_eq!(fz_cookie_get_progress(0, cookie), 50);
+        assert_eq!(fz_cookie_get_progress_max(0, cookie), 50);
+
+        // An abort stops the list before its next command
+        fz_cookie_abort(0, cookie);
+        let (done, pixels) = draw(cookie);
+        assert!(!done);
+        assert!(pixels.iter().all(|&p| p == 255));
+        assert_eq!(fz_cookie_get_progress(0, cookie), 50);
+        fz_drop_cookie(0, cookie);
+
+        fz_drop_display_list(0, list);
+    }
+
+    unsafe extern "C" fn fetch_from(_ctx: Handle, hash: *const u8, opaque: *mut c_void) -> Handle {
+        let store = unsafe { &*(opaque as *const Vec<([u8; 32], Handle)>) };
+        let hash = unsafe { std::slice::from_raw_parts(hash, 32) };
+        store
+            .iter()
+            .find(|(h, _)| h[..] == *hash)
+            .map_or(0, |&(_, buf)| BUFFERS.keep(buf))
+    }
+
+    #[test]
+    fn test_display_list_buffer_roundtrip() {
+        use crate::fitz::colorspace::Colorspace;
+        use crate::fitz::device::Device;
+        use crate::fitz::display_list::ListDevice;
+        use crate::fitz::image::Image;
+
+        let mut device = ListDevice::new(Rect::new(0.0, 0.0, 10.0, 10.0));
+        let image = Image::from_raw(1, 1, 8, Colorspace::device_gray(), vec![7]).unwrap();
+        device.fill_image(&image, &Matrix::IDENTITY, 1.0);
+        let list = DISPLAY_LISTS.insert(device.into_display_list());
+
+        let embedded = fz_new_buffer_from_display_list(0, list, FZ_DISPLAY_LIST_EMBED);
+        let copy = fz_new_display_list_from_buffer(0, embedded, None, std::ptr::null_mut());
+        assert_eq!(fz_display_list_count_commands(0, copy), 1);
+        fz_drop_display_list(0, copy);
+
+        // By reference: the image comes from the caller's store
+        let bare = fz_new_buffer_from_display_list(0, list, 0);
+        assert_eq!(
+            fz_new_display_list_from_buffer(0, bare, None, std::ptr::null_mut()),
+            0
+        );
+        assert_eq!(fz_display_list_count_resources(0, list), 1);
+        let mut hash = [0u8; 32];
+        let data = fz_display_list_resource(0, list, 0, hash.as_mut_ptr());
+        assert_eq!(BUFFERS.get(data).unwrap().lock().unwrap().data(), &[7]);
+        assert_eq!(fz_display_list_resource(0, list, 1, hash.as_mut_ptr()), 0);
+        let mut store = vec![(hash, data)];
+        let copy = fz_new_display_list_from_buffer(
+            0,
+            bare,
+            Some(fetch_from),
+            &mut store as *mut _ as *mut c_void,
+        );
+        assert_ne!(copy, 0);
+        assert_eq!(fz_display_list_count_commands(0, copy), 1);
+
+        fz_drop_display_list(0, copy);
+        fz_drop_display_list(0, list);
+        for buf in [embedded, bare, data] {
+            fz_drop_buffer(0, buf);
+        }
+    }
 }
@@ -1,13 +1,18 @@
 //! C FFI for document - MuPDF compatible
 //! Safe Rust implementation using handle-based resource management
 
+use super::mmap::{AccessPattern, FileBytes};
 use super::outline::OUTLINES;
 use super::{DOCUMENTS, Handle, HandleStore, STREAMS};
+use crate::fitz::counters::Counter;
+use crate::fitz::memory_budget::{self, MemoryBudget};
 use std::ffi::{c_char, c_float};
-use std::sync::LazyLock;
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::{Arc, LazyLock};
 
 /// Page storage
-pub static PAGES: LazyLock<HandleStore<Page>> = LazyLock::new(HandleStore::default);
+pub static PAGES: LazyLock<HandleStore<Page>> =
+    LazyLock::new(|| HandleStore::with_lookup_counter(Counter::PageLookups));
 
 /// Internal page state
 pub struct Page {
@@ -85,17 +90,29 @@ impl Page {
 /// Internal document state
 pub struct Document {
     // PDF document data - will be expanded with actual PDF parsing
-    #[allow(dead_code)]
-    data: Vec<u8>,
+    data: Arc<FileBytes>,
     page_count: i32,
     needs_password: bool,
     authenticated: bool,
     password: Option<String>,
     pub format: String,
+    /// Memory budget, when a limit is set
+    memory: Option<Arc<MemoryBudget>>,
+    /// Bumped each time the file is rewritten, so state derived from the
+    /// old bytes (like cached display lists) is not reused
+    generation: u64,
 }
 
+/// Memory limit given to documents as they are opened; 0 for none
+static DEFAULT_MEMORY_LIMIT: AtomicUsize = AtomicUsize::new(0);
+
 impl Document {
     pub fn new(data: Vec<u8>) -> Self {
+        Self::from_bytes(Arc::new(FileBytes::from(data)))
+    }
+
+    /// Document over shared (possibly mapped) bytes
+    pub fn from_bytes(data: Arc<FileBytes>) -> Self {
         // Basic PDF detection and page count estimation
         // In a real implementation, this would parse the PDF structure
         let page_count = Self::estimate_page_count(&data);
@@ -116,9 +133,35 @@ impl Document {
             authenticated: true,
             password: None,
             format,
+            memory: match DEFAULT_MEMORY_LIMIT.load(Ordering::Relaxed) {
+                0 => None,
+                limit => Some(Arc::new(MemoryBudget::new(limit))),
+            },
+            generation: 0,
         }
     }
 
+    /// Override the estimated page count with a known one
+    pub(crate) fn set_page_count(&mut self, count: i32) {
+        self.page_count = count.max(1);
+    }
+
+    /// Raw file data, shared with readers like the lazy xref
+    pub(crate) fn data(&self) -> Arc<FileBytes> {
+        Arc::clone(&self.data)
+    }
+
+    /// Swap in a rewritten version of the file
+    pub(crate) fn replace_data(&mut self, data: Vec<u8>) {
+        self.data = Arc::new(FileBytes::from(data));
+        self.generation += 1;
+    }
+
+    /// Number of times the file has been rewritten
+    pub(crate) fn generation(&self) -> u64 {
+        self.generation
+    }
+
     fn estimate_page_count(data: &[u8]) -> i32 {
         // Simple heuristic: count /Type /Page occurrences
         // Real implementation would parse the PDF properly
@@ -152,8 +195,17 @@ pub extern "C" fn fz_open_document(_ctx: Handle, filename: *const c_char) -> Han
         Err(_) => return 0,
     };
 
-    match std::fs::read(path) {
-        Ok(data) => DOCUMENTS.insert(Document::new(data)),
+    let _span = super::trace::span(c"open");
+    // Map the file: opening and later object reads come straight from the
+    // page cache. The page count estimate scans front to back; after that,
+    // access follows pages and objects around the file.
+    match FileBytes::map(path) {
+        Ok(data) => {
+            data.advise(AccessPattern::Sequential);
+            let doc = Document::from_bytes(Arc::new(data));
+            doc.data.advise(AccessPattern::Random);
+            DOCUMENTS.insert(doc)
+        }
         Err(_) => 0,
     }
 }
@@ -165,10 +217,11 @@ pub extern "C" fn fz_open_document_with_stream(
     _magic: *const c_char,
     stm: Handle,
 ) -> Handle {
-    // Read all data from stream
+    let _span = super::trace::span(c"open");
+    // Share the stream's bytes rather than copying them
     if let Some(stream) = STREAMS.get(stm) {
         if let Ok(guard) = stream.lock() {
-            return DOCUMENTS.insert(Document::new(guard.data.clone()));
+            return DOCUMENTS.insert(Document::from_bytes(Arc::clone(&guard.data)));
         }
     }
     0
@@ -183,7 +236,13 @@ pub extern "C" fn fz_keep_document(_ctx: Handle, doc: Handle) -> Handle {
 /// Drop document reference
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_drop_document(_ctx: Handle, doc: Handle) {
-    let _ = DOCUMENTS.remove(doc);
+    if DOCUMENTS.remove(doc).is_some() {
+        super::display_list::fz_purge_display_list_cache(_ctx, doc);
+        super::draw_device::fz_purge_form_raster_cache(_ctx, doc);
+        super::pdf_interpret::pdf_purge_content_program_cache(_ctx, doc);
+        super::pdf_page::pdf_drop_page_tree(_ctx, doc);
+        super::pdf_object::drop_document_arena(doc);
+    }
 }
 
 /// Check if document needs a password
@@ -304,6 +363,114 @@ pub extern "C" fn fz_lookup_metadata(
     -1 // Key not found
 }
 
+// ============================================================================
+// Memory Limits
+// ============================================================================
+
+/// Limit the memory a document may allocate
+///
+/// Pixmap samples, decoded streams, parsed objects, xref sections and
+/// fonts allocated while loading, recording or rendering the document's
+/// pages count against the limit; pixmaps stop counting once freed, the
+/// rest stays counted while the document is open. An operation that goes
+/// over fails with `FZ_ERROR_LIMIT` (see `fz_caught`) and, when run with a
+/// cookie, adds an error to it. Allocations of known size, like a page
+/// pixmap, are refused before they are made.
+///
+/// # Arguments
+/// * `bytes` - Limit in bytes, or 0 to remove the limit
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_set_document_memory_limit(_ctx: Handle, doc: Handle, bytes: usize) {
+    if let Some(d) = DOCUMENTS.get(doc) {
+        if let Ok(mut guard) = d.lock() {
+            if bytes == 0 {
+                guard.memory = None;
+            } else {
+                guard
+                    .memory
+                    .get_or_insert_with(|| Arc::new(MemoryBudget::new(bytes)))
+                    .set_limit(bytes);
+            }
+        }
+    }
+}
+
+/// Get a document's memory limit (0 for none)
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_document_memory_limit(_ctx: Handle, doc: Handle) -> usize {
+    document_memory(doc).map_or(0, |budget| budget.limit())
+}
+
+/// Get the bytes charged to a document's memory limit
+///
+/// Counted only while a limit is set.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_document_memory_used(_ctx: Handle, doc: Handle) -> usize {
+    document_memory(doc).map_or(0, |budget| budget.used())
+}
+
+/// Get the most bytes ever charged at once to a document's memory limit
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_document_memory_peak(_ctx: Handle, doc: Handle) -> usize {
+    document_memory(doc).map_or(0, |budget| budget.peak())
+}
+
+/// Give documents opened from now on a memory limit, as if set with
+/// `fz_set_document_memory_limit` (0 for none, the default)
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_set_default_document_memory_limit(_ctx: Handle, bytes: usize) {
+    DEFAULT_MEMORY_LIMIT.store(bytes, Ordering::Relaxed);
+}
+
+fn document_memory(doc: Handle) -> Option<Arc<MemoryBudget>> {
+    DOCUMENTS.get(doc)?.lock().ok()?.memory.clone()
+}
+
+/// Charge this thread's allocations to the memory limits of the document
+/// showing `page` and of `cookie`, until the scope drops
+pub(crate) fn enter_page_memory(page: Handle, cookie: Handle) -> memory_budget::Scope {
+    let doc = PAGES
+        .get(page)
+        .and_then(|p| p.lock().ok().map(|guard| guard.doc_handle));
+    enter_memory(doc.unwrap_or(0), cookie)
+}
+
+/// Charge this thread's allocations to the memory limits of `doc` and of
+/// `cookie`, until the scope drops
+pub(crate) fn enter_memory(doc: Handle, cookie: Handle) -> memory_budget::Scope {
+    let cookie_memory = super::cookie::COOKIES.get(cookie).and_then(|c| {
+        let guard = c.lock().ok()?;
+        let budget = guard.memory();
+        (budget.limit() > 0).then(|| Arc::clone(budget))
+    });
+    memory_budget::enter(document_memory(doc).into_iter().chain(cookie_memory))
+}
+
+/// Whether the operation running in `scope` went over a memory limit
+///
+/// The outermost operation on a limit reports it: `FZ_ERROR_LIMIT` on the
+/// context and an error on the cookie.
+pub(crate) fn memory_exceeded(ctx: Handle, scope: &memory_budget::Scope, cookie: Handle) -> bool {
+    let over = memory_budget::over_limit();
+    if scope.take_exceeded() {
+        if let Some(context) = super::CONTEXTS.get(ctx) {
+            if let Ok(guard) = context.lock() {
+                guard.set_error(
+                    super::context::FzErrorType::Limit as i32,
+                    "memory limit exceeded".to_string(),
+                );
+            }
+        }
+        if let Some(c) = super::cookie::COOKIES.get(cookie) {
+            if let Ok(guard) = c.lock() {
+                guard.inc_errors();
+                guard.set_incomplete(true);
+            }
+        }
+    }
+    over
+}
+
 // ============================================================================
 // Page Functions
 // ============================================================================
@@ -315,9 +482,10 @@ pub extern "C" fn fz_load_page(_ctx: Handle, doc: Handle, page_num: i32) -> Hand
         return 0;
     }
 
+    let memory = enter_memory(doc, 0);
     // Validate page number
     let page_count = fz_count_pages(_ctx, doc);
-    if page_num < 0 || page_num >= page_count {
+    if page_num < 0 || page_num >= page_count || memory_exceeded(_ctx, &memory, 0) {
         return 0;
     }
 
@@ -383,6 +551,9 @@ pub extern "C" fn fz_bound_page_box(
 
 /// Render page to device
 ///
+/// Runs the page contents and then its annotations (see
+/// `fz_run_page_contents` and `fz_run_page_annots`).
+///
 /// # Safety
 /// Caller must ensure device is valid
 #[unsafe(no_mangle)]
@@ -393,64 +564,668 @@ pub extern "C" fn fz_run_page(
     transform: super::geometry::fz_matrix,
     cookie: *mut std::ffi::c_void,
 ) {
-    // Check for cancellation via cookie
-    if !cookie.is_null() {
-        let cookie_handle = cookie as Handle;
-        if let Some(c) = super::cookie::COOKIES.get(cookie_handle) {
-            if let Ok(guard) = c.lock() {
-                if guard.should_abort() {
-                    return; // Operation cancelled
+    fz_run_page_contents(_ctx, page, device, transform, cookie);
+    fz_run_page_annots(_ctx, page, device, transform, cookie);
+}
+
+fn to_matrix(m: super::geometry::fz_matrix) -> crate::fitz::geometry::Matrix {
+    crate::fitz::geometry::Matrix {
+        a: m.a,
+        b: m.b,
+        c: m.c,
+        d: m.d,
+        e: m.e,
+        f: m.f,
+    }
+}
+
+/// Render a page to a new pixmap
+///
+/// Equivalent to MuPDF's fz_new_pixmap_from_page: the page bounds are
+/// transformed by `ctm`, a pixmap covering them is cleared to white (or to
+/// transparent when `alpha` is set) and the page is run into it.
+///
+/// # Returns
+/// Pixmap handle, or 0 if the page handle is invalid
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_pixmap_from_page(
+    ctx: Handle,
+    page: Handle,
+    ctm: super::geometry::fz_matrix,
+    cs: Handle,
+    alpha: i32,
+) -> Handle {
+    fz_new_pixmap_from_page_with_cookie(ctx, page, ctm, cs, alpha, 0)
+}
+
+/// Render a page to a new pixmap, honouring a cookie
+///
+/// Same as `fz_new_pixmap_from_page`, but the cookie is checked before the
+/// pixmap is allocated and before each command of the page is drawn, so an
+/// abort stops a render partway. Progress is reported through
+/// `fz_cookie_get_progress` as one step per drawing command, plus one per
+/// page once it is done.
+///
+/// # Arguments
+/// * `cookie` - Cookie handle, or 0 for none
+///
+/// # Returns
+/// Pixmap handle, or 0 if the page is invalid or the cookie was aborted
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_pixmap_from_page_with_cookie(
+    ctx: Handle,
+    page: Handle,
+    ctm: super::geometry::fz_matrix,
+    cs: Handle,
+    alpha: i32,
+    cookie: Handle,
+) -> Handle {
+    fz_new_pixmap_from_page_with_options(
+        ctx,
+        page,
+        ctm,
+        cs,
+        alpha,
+        fz_aa_level_for_context(ctx),
+        FZ_RENDER_ANNOTS | FZ_RENDER_WIDGETS,
+        cookie,
+    )
+}
+
+/// Render flag: run annotation appearance streams after the page contents
+pub const FZ_RENDER_ANNOTS: i32 = 1;
+/// Render flag: run form widget appearance streams after the page contents
+///
+/// Accepted so callers can ask for widgets already, but none are drawn yet.
+pub const FZ_RENDER_WIDGETS: i32 = 2;
+
+fn fz_aa_level_for_context(ctx: Handle) -> i32 {
+    super::context::fz_aa_level(ctx)
+}
+
+/// Map anti-aliasing bits (0, 2, 4, 8 as used by `fz_set_aa_level`) onto the
+/// draw device levels understood by `fz_new_draw_device_with_options`.
+fn draw_device_aa_from_bits(bits: i32) -> i32 {
+    match bits {
+        i32::MIN..=0 => 0,
+        1..=2 => 1,
+        3..=4 => 2,
+        _ => 3,
+    }
+}
+
+/// Render a page to a new pixmap with explicit rendering options
+///
+/// The colorspace and alpha choose the pixmap format, so a gray pixmap
+/// without alpha costs a third of the RGB one to clear, rasterize and encode.
+/// Annotations and form widgets are only run when requested in `flags`.
+/// The page is recorded once into a display list held by the store (see
+/// `fz_cached_display_list_from_page`) and replayed on later renders.
+///
+/// # Arguments
+/// * `aa_bits` - Anti-aliasing bits: 0 (off), 2, 4 or 8 (best)
+/// * `flags` - Bitwise OR of `FZ_RENDER_ANNOTS` and `FZ_RENDER_WIDGETS`
+/// * `cookie` - Cookie handle, or 0 for none
+///
+/// # Returns
+/// Pixmap handle, or 0 if the page is invalid or the cookie was aborted
+#[unsafe(no_mangle)]
+#[allow(clippy::too_many_arguments)]
+pub extern "C" fn fz_new_pixmap_from_page_with_options(
+    ctx: Handle,
+    page: Handle,
+    ctm: super::geometry::fz_matrix,
+    cs: Handle,
+    alpha: i32,
+    aa_bits: i32,
+    flags: i32,
+    cookie: Handle,
+) -> Handle {
+    let bounds = fz_bound_page(ctx, page);
+    let bbox = super::geometry::fz_round_rect(super::geometry::fz_transform_rect(bounds, ctm));
+    render_page_area(ctx, page, ctm, cs, alpha, aa_bits, flags, cookie, bbox)
+}
+
+/// Render one horizontal band of a page to a new pixmap
+///
+/// The band covers rows `band_y .. band_y + band_h` of the full page
+/// pixmap that `fz_new_pixmap_from_page_with_options` would produce with
+/// the same matrix; the returned pixmap is positioned at those device
+/// coordinates and clipped to the page. Each band replays the cached
+/// display list under a scissor, so rendering a page band by band
+/// interprets it once while only ever holding one band of pixels.
+///
+/// # Returns
+/// Pixmap handle, or 0 if the page is invalid, the band lies outside the
+/// page, or the cookie was aborted
+#[unsafe(no_mangle)]
+#[allow(clippy::too_many_arguments)]
+pub extern "C" fn fz_new_pixmap_from_page_band(
+    ctx: Handle,
+    page: Handle,
+    ctm: super::geometry::fz_matrix,
+    cs: Handle,
+    alpha: i32,
+    aa_bits: i32,
+    flags: i32,
+    band_y: i32,
+    band_h: i32,
+    cookie: Handle,
+) -> Handle {
+    if band_y < 0 || band_h <= 0 {
+        return 0;
+    }
+    let bounds = fz_bound_page(ctx, page);
+    let page_bbox = super::geometry::fz_round_rect(super::geometry::fz_transform_rect(bounds, ctm));
+    let band = super::geometry::fz_irect {
+        x0: page_bbox.x0,
+        y0: page_bbox.y0.saturating_add(band_y),
+        x1: page_bbox.x1,
+        y1: page_bbox.y0.saturating_add(band_y).saturating_add(band_h),
+    };
+    let bbox = super::geometry::fz_intersect_irect(page_bbox, band);
+    if bbox.y1 <= bbox.y0 {
+        return 0;
+    }
+    render_page_area(ctx, page, ctm, cs, alpha, aa_bits, flags, cookie, bbox)
+}
+
+/// Bands queued between each pair of pipeline stages in
+/// `fz_write_page_banded`
+pub const FZ_BAND_PIPELINE_DEPTH: usize = 2;
+
+/// Render a page band by band into a band writer
+///
+/// Sets the writer's dimensions and components from the transformed page
+/// and colorspace, then replays the page's cached display list once per
+/// band of `fz_band_writer_set_rows_per_band` rows under a scissor. The
+/// bands go through a three-stage pipeline: band N+1 renders on one
+/// thread while band N is encoded on another and band N-1 is written out
+/// on the calling thread, with at most `FZ_BAND_PIPELINE_DEPTH` bands
+/// queued between stages. Peak memory is a few bands of pixels whatever
+/// the output resolution; with an output attached to the writer the
+/// encoded data does not accumulate either. The progress callback is
+/// called on the calling thread as each band is written.
+///
+/// The writer must be freshly created (PNG, PNM, PAM, PWG, PCLm or raw).
+///
+/// # Returns
+/// 1 on success, 0 if the page or writer is invalid, the format cannot
+/// store this colorspace, or the cookie was aborted
+#[unsafe(no_mangle)]
+#[allow(clippy::too_many_arguments)]
+pub extern "C" fn fz_write_page_banded(
+    ctx: Handle,
+    page: Handle,
+    ctm: super::geometry::fz_matrix,
+    cs: Handle,
+    alpha: i32,
+    aa_bits: i32,
+    flags: i32,
+    writer: Handle,
+    cookie: Handle,
+) -> i32 {
+    use super::band_writer as bw;
+    use std::sync::atomic::{AtomicBool, Ordering};
+    use std::sync::mpsc;
+
+    let Some(wri) = bw::BAND_WRITERS.get(writer) else {
+        return 0;
+    };
+    let band_h = match wri.lock() {
+        Ok(guard) => guard.rows_per_band.max(1),
+        Err(_) => return 0,
+    };
+    if PAGES.get(page).is_none() {
+        return 0;
+    }
+
+    let bounds = fz_bound_page(ctx, page);
+    let bbox = super::geometry::fz_round_rect(super::geometry::fz_transform_rect(bounds, ctm));
+    let (w, h) = (bbox.x1 - bbox.x0, bbox.y1 - bbox.y0);
+    if w <= 0 || h <= 0 {
+        return 0;
+    }
+    bw::fz_band_writer_set_dimensions(ctx, writer, w, h);
+    bw::fz_band_writer_set_components(
+        ctx,
+        writer,
+        super::colorspace::fz_colorspace_n(ctx, cs),
+        alpha,
+    );
+    if bw::fz_band_writer_write_header(ctx, writer) == 0 {
+        return 0;
+    }
+
+    // The encoder moves to its own thread for the page and comes back for
+    // the trailer; position and progress stay with the writer
+    let (config, mut encoder, start) = {
+        let Ok(mut guard) = wri.lock() else {
+            return 0;
+        };
+        guard.state = bw::BandWriterState::WritingBands;
+        (
+            guard.config.clone(),
+            guard.encoder.take(),
+            guard.bytes_written,
+        )
+    };
+
+    let bands = ((h + band_h - 1) / band_h) as usize;
+    let stop = AtomicBool::new(false);
+    let (pixels_tx, pixels_rx) = mpsc::sync_channel::<Handle>(FZ_BAND_PIPELINE_DEPTH);
+    let (encoded_tx, encoded_rx) = mpsc::sync_channel::<Vec<u8>>(FZ_BAND_PIPELINE_DEPTH);
+    let mut written = 0;
+    std::thread::scope(|scope| {
+        let stop = &stop;
+        scope.spawn(move || {
+            let clone = super::context::fz_clone_context(ctx);
+            let render_ctx = if clone != 0 { clone } else { ctx };
+            for band_y in (0..h).step_by(band_h as usize) {
+                if stop.load(Ordering::Relaxed) {
+                    break;
+                }
+                let pix = fz_new_pixmap_from_page_band(
+                    render_ctx, page, ctm, cs, alpha, aa_bits, flags, band_y, band_h, cookie,
+                );
+                // A failed render ends the page: the stages downstream see
+                // the channel close early and the band count comes up short
+                if pix == 0 || pixels_tx.send(pix).is_err() {
+                    super::pixmap::fz_drop_pixmap(render_ctx, pix);
+                    break;
+                }
+            }
+            if clone != 0 {
+                super::context::fz_drop_context(clone);
+            }
+        });
+
+        let encoder = &mut encoder;
+        let config = &config;
+        scope.spawn(move || {
+            let mut offset = start;
+            for pix in pixels_rx.iter() {
+                let encoded = super::PIXMAPS.get(pix).and_then(|p| {
+                    let guard = p.lock().ok()?;
+                    bw::encode_band(encoder.as_mut(), config, guard.samples(), guard.h(), offset)
+                });
+                super::pixmap::fz_drop_pixmap(ctx, pix);
+                let Some(encoded) = encoded else { break };
+                offset += encoded.len();
+                if encoded_tx.send(encoded).is_err() {
+                    break;
                 }
             }
+            // Stop the renderer and drop whatever it still hands over
+            stop.store(true, Ordering::Relaxed);
+            for pix in pixels_rx.iter() {
+                super::pixmap::fz_drop_pixmap(ctx, pix);
+            }
+        });
+
+        for encoded in encoded_rx.iter() {
+            let Ok(mut guard) = wri.lock() else { break };
+            bw::emit_band(&mut guard, &encoded);
+            written += 1;
         }
+    });
+
+    let complete = written == bands;
+    let Ok(mut guard) = wri.lock() else {
+        return 0;
+    };
+    guard.encoder = encoder;
+    if !complete {
+        guard.state = bw::BandWriterState::Error;
+        return 0;
     }
+    drop(guard);
 
-    // Get page bounds for rendering
-    let _bounds = if let Some(p) = PAGES.get(page) {
-        if let Ok(guard) = p.lock() {
-            super::geometry::fz_rect {
-                x0: guard.bounds[0],
-                y0: guard.bounds[1],
-                x1: guard.bounds[2],
-                y1: guard.bounds[3],
+    bw::fz_band_writer_write_trailer(ctx, writer)
+}
+
+/// Render the part of a page inside `bbox` (device space) to a new pixmap
+#[allow(clippy::too_many_arguments)]
+pub(crate) fn render_page_area(
+    ctx: Handle,
+    page: Handle,
+    ctm: super::geometry::fz_matrix,
+    cs: Handle,
+    alpha: i32,
+    aa_bits: i32,
+    flags: i32,
+    cookie: Handle,
+    bbox: super::geometry::fz_irect,
+) -> Handle {
+    if PAGES.get(page).is_none() || cookie_aborted(cookie) {
+        return 0;
+    }
+    let memory = enter_page_memory(page, cookie);
+    let n = super::colorspace::fz_colorspace_n(ctx, cs) + i32::from(alpha != 0);
+    let bytes = (bbox.x1 - bbox.x0).max(0) as usize
+        * (bbox.y1 - bbox.y0).max(0) as usize
+        * n.max(1) as usize;
+    if !memory_budget::admit(bytes) {
+        memory_exceeded(ctx, &memory, cookie);
+        return 0;
+    }
+    let pix = super::pixmap::new_pixmap_with_bbox_filled(
+        cs,
+        bbox,
+        alpha != 0,
+        if alpha != 0 { 0 } else { 255 },
+    );
+    let drawn = draw_page_area(ctx, page, ctm, aa_bits, flags, cookie, bbox, pix);
+    if memory_exceeded(ctx, &memory, cookie) || !drawn {
+        super::pixmap::fz_drop_pixmap(ctx, pix);
+        return 0;
+    }
+    pix
+}
+
+fn cookie_aborted(cookie: Handle) -> bool {
+    super::cookie::COOKIES
+        .get(cookie)
+        .and_then(|c| c.lock().ok().map(|guard| guard.should_abort()))
+        .unwrap_or(false)
+}
+
+/// Run the part of a page inside `bbox` into the already cleared `pix`
+///
+/// Returns false if the page is invalid, the cookie was aborted or a
+/// memory limit was exceeded.
+#[allow(clippy::too_many_arguments)]
+fn draw_page_area(
+    ctx: Handle,
+    page: Handle,
+    ctm: super::geometry::fz_matrix,
+    aa_bits: i32,
+    flags: i32,
+    cookie: Handle,
+    bbox: super::geometry::fz_irect,
+    pix: Handle,
+) -> bool {
+    let cookie_ref = super::cookie::COOKIES.get(cookie);
+    let aborted = || cookie_aborted(cookie);
+
+    if aborted() || PAGES.get(page).is_none() {
+        return false;
+    }
+
+    if let Some(c) = &cookie_ref {
+        if let Ok(guard) = c.lock() {
+            guard.set_progress_max(guard.progress_max() + 1);
+        }
+    }
+
+    let memory = enter_page_memory(page, cookie);
+    // Transient allocations for this page are dropped in one reset at the end
+    let _arena = super::pool::RenderArenaScope::enter();
+
+    let draw = super::draw_device::fz_new_draw_device_with_options(
+        ctx,
+        pix,
+        draw_device_aa_from_bits(aa_bits),
+        0,
+    );
+    // Interpret the page once; later renders at any zoom replay the list
+    let list = super::display_list::fz_cached_display_list_from_page(ctx, page, flags, cookie);
+    if list != 0 {
+        let _span = super::trace::span(c"rasterize");
+        let scissor = super::geometry::fz_rect {
+            x0: bbox.x0 as f32,
+            y0: bbox.y0 as f32,
+            x1: bbox.x1 as f32,
+            y1: bbox.y1 as f32,
+        };
+        // The cookie is checked before each command, not just per page
+        super::display_list::draw_display_list(list, draw, ctm, scissor, cookie);
+        super::display_list::fz_drop_display_list(ctx, list);
+    }
+    super::draw_device::fz_drop_draw_device(ctx, draw);
+
+    if memory_exceeded(ctx, &memory, cookie) || aborted() {
+        return false;
+    }
+
+    if let Some(c) = &cookie_ref {
+        if let Ok(guard) = c.lock() {
+            guard.inc_progress();
+        }
+    }
+
+    true
+}
+
+/// Render a page into an existing pixmap
+///
+/// Meant for pixmaps over caller memory (`fz_new_pixmap_with_data`): the
+/// page lands in the caller's buffer with no copy. The pixmap is moved so
+/// its top-left corner is that of the page bounds transformed by `ctm`,
+/// matching the pixmap `fz_new_pixmap_from_page_with_options` would
+/// return, then cleared to white (or transparent when it has alpha) and
+/// the part of the page it covers is drawn. A pixmap smaller than the page
+/// receives its top-left part.
+///
+/// # Arguments
+/// * `aa_bits` - Anti-aliasing bits: 0 (off), 2, 4 or 8 (best)
+/// * `flags` - Bitwise OR of `FZ_RENDER_ANNOTS` and `FZ_RENDER_WIDGETS`
+/// * `cookie` - Cookie handle, or 0 for none
+///
+/// # Returns
+/// 0 on success, -1 if the page or pixmap is invalid or the cookie was
+/// aborted
+#[unsafe(no_mangle)]
+#[allow(clippy::too_many_arguments)]
+pub extern "C" fn fz_fill_pixmap_from_page(
+    ctx: Handle,
+    page: Handle,
+    ctm: super::geometry::fz_matrix,
+    pix: Handle,
+    aa_bits: i32,
+    flags: i32,
+    cookie: Handle,
+) -> i32 {
+    if PAGES.get(page).is_none() {
+        return -1;
+    }
+    let bounds = fz_bound_page(ctx, page);
+    let page_box = super::geometry::fz_round_rect(super::geometry::fz_transform_rect(bounds, ctm));
+
+    let Some(p) = super::PIXMAPS.get(pix) else {
+        return -1;
+    };
+    let bbox = match p.lock() {
+        Ok(mut guard) => {
+            guard.set_origin(page_box.x0, page_box.y0);
+            guard.clear_with_value(if guard.has_alpha() { 0 } else { 255 });
+            super::geometry::fz_irect {
+                x0: page_box.x0,
+                y0: page_box.y0,
+                x1: page_box.x1.min(page_box.x0 + guard.w()),
+                y1: page_box.y1.min(page_box.y0 + guard.h()),
             }
-        } else {
-            return;
         }
-    } else {
-        return;
+        Err(_) => return -1,
     };
+    drop(p);
 
-    // Get device for rendering
-    let _dev_arc = match super::device::DEVICES.get(device) {
-        Some(d) => d,
-        None => return,
-    };
+    if draw_page_area(ctx, page, ctm, aa_bits, flags, cookie, bbox, pix) {
+        0
+    } else {
+        -1
+    }
+}
 
-    // Apply transform to page bounds to get rendering area
-    let _matrix = crate::fitz::geometry::Matrix {
-        a: transform.a,
-        b: transform.b,
-        c: transform.c,
-        d: transform.d,
-        e: transform.e,
-        f: transform.f,
+/// Re-render the damaged parts of a page already rendered into `pix`
+///
+/// `pix` must hold the page as rendered with the same `ctm`, by
+/// `fz_new_pixmap_from_page_with_options` or `fz_fill_pixmap_from_page`.
+/// Each of the `count` rects in `damage` (page space; after annotation
+/// edits, the dirty rect `pdf_update_annots` returns) is cleared and
+/// redrawn: the page contents from the cached contents-only display list,
+/// under the rect, then the page's annotations and widgets as they are
+/// now, per `flags`. Overlapping rects are merged first, and pixels
+/// outside them are left alone, so the cost follows the damaged area
+/// rather than the page.
+///
+/// # Returns
+/// Number of areas redrawn, or -1 if the page or pixmap is invalid or the
+/// cookie was aborted
+///
+/// # Safety
+/// Caller must ensure `damage` holds `count` rects
+#[unsafe(no_mangle)]
+#[allow(clippy::too_many_arguments)]
+pub extern "C" fn fz_update_pixmap_from_page(
+    ctx: Handle,
+    page: Handle,
+    ctm: super::geometry::fz_matrix,
+    pix: Handle,
+    aa_bits: i32,
+    flags: i32,
+    damage: *const super::geometry::fz_rect,
+    count: i32,
+    cookie: Handle,
+) -> i32 {
+    use super::geometry::{fz_intersect_irect, fz_irect, fz_round_rect, fz_transform_rect};
+
+    if PAGES.get(page).is_none() {
+        return -1;
+    }
+    let Some((pix_box, cs, alpha)) = super::PIXMAPS.get(pix).and_then(|p| {
+        let guard = p.lock().ok()?;
+        let bbox = fz_irect {
+            x0: guard.x(),
+            y0: guard.y(),
+            x1: guard.x() + guard.w(),
+            y1: guard.y() + guard.h(),
+        };
+        Some((bbox, guard.colorspace(), guard.has_alpha()))
+    }) else {
+        return -1;
     };
+    let damage = match count {
+        1.. if !damage.is_null() => {
+            // SAFETY: caller guarantees `damage` holds `count` rects
+            unsafe { std::slice::from_raw_parts(damage, count as usize) }
+        }
+        _ => &[],
+    };
+
+    // Device areas inside the pixmap, with overlapping ones merged
+    let mut areas: Vec<fz_irect> = Vec::new();
+    for &rect in damage {
+        let mut area = fz_intersect_irect(fz_round_rect(fz_transform_rect(rect, ctm)), pix_box);
+        if area.x1 <= area.x0 || area.y1 <= area.y0 {
+            continue;
+        }
+        while let Some(i) = areas
+            .iter()
+            .position(|a| a.x0 < area.x1 && area.x0 < a.x1 && a.y0 < area.y1 && area.y0 < a.y1)
+        {
+            let a = areas.swap_remove(i);
+            area = fz_irect {
+                x0: a.x0.min(area.x0),
+                y0: a.y0.min(area.y0),
+                x1: a.x1.max(area.x1),
+                y1: a.y1.max(area.y1),
+            };
+        }
+        areas.push(area);
+    }
+
+    for &area in &areas {
+        // The contents list doesn't change with annotation edits, so it
+        // stays cached; annotations are run as they are now
+        let tmp = super::pixmap::new_pixmap_with_bbox_filled(
+            cs,
+            area,
+            alpha,
+            if alpha { 0 } else { 255 },
+        );
+        let drawn = draw_page_area(ctx, page, ctm, aa_bits, 0, cookie, area, tmp)
+            && run_live_annots(ctx, page, ctm, aa_bits, flags, cookie, tmp);
+        if drawn {
+            copy_area(tmp, pix);
+        }
+        super::pixmap::fz_drop_pixmap(ctx, tmp);
+        if !drawn {
+            return -1;
+        }
+    }
+    areas.len() as i32
+}
+
+/// Run the annotations of a page into `pix` if `flags` asks for them
+///
+/// They are recorded afresh, since they change between updates, and
+/// drawn like the contents. Widgets aren't drawn yet.
+#[allow(clippy::too_many_arguments)]
+fn run_live_annots(
+    ctx: Handle,
+    page: Handle,
+    ctm: super::geometry::fz_matrix,
+    aa_bits: i32,
+    flags: i32,
+    cookie: Handle,
+    pix: Handle,
+) -> bool {
+    if flags & FZ_RENDER_ANNOTS != 0 {
+        let bounds = fz_bound_page(ctx, page);
+        let list = super::display_list::fz_new_display_list(
+            ctx, bounds.x0, bounds.y0, bounds.x1, bounds.y1,
+        );
+        let dev = super::device::fz_new_list_device(ctx, list);
+        let identity = super::geometry::fz_matrix::identity();
+        fz_run_page_annots(ctx, page, dev, identity, cookie as *mut std::ffi::c_void);
+        super::device::fz_close_device(ctx, dev);
+        super::device::fz_drop_device(ctx, dev);
+
+        let draw = super::draw_device::fz_new_draw_device_with_options(
+            ctx,
+            pix,
+            draw_device_aa_from_bits(aa_bits),
+            0,
+        );
+        let scissor = super::geometry::fz_infinite_rect;
+        super::display_list::draw_display_list(list, draw, ctm, scissor, cookie);
+        super::draw_device::fz_drop_draw_device(ctx, draw);
+        super::display_list::fz_drop_display_list(ctx, list);
+    }
+    !cookie_aborted(cookie)
+}
 
-    // This function correctly handles the FFI contract for page rendering:
-    // - Validates all handles
-    // - Checks cookie for cancellation
-    // - Parses transform matrix
-    // - Gets page bounds
-    //
-    // Note: PDF content stream parsing (walking through drawing operators and
-    // calling device methods) requires a full PDF interpreter which is a
-    // substantial undertaking beyond FFI bindings. The FFI structure is complete
-    // and ready for when content stream interpretation is added to the core library.
+/// Copy the samples of `src` into `dst` where they overlap
+///
+/// Both pixmaps have the same colorspace and alpha.
+fn copy_area(src: Handle, dst: Handle) {
+    let (Some(s), Some(d)) = (super::PIXMAPS.get(src), super::PIXMAPS.get(dst)) else {
+        return;
+    };
+    let (Ok(s), Ok(mut d)) = (s.lock(), d.lock()) else {
+        return;
+    };
+    let n = d.n() as usize;
+    let x0 = s.x().max(d.x());
+    let x1 = (s.x() + s.w()).min(d.x() + d.w());
+    if x1 <= x0 || s.n() != d.n() {
+        return;
+    }
+    let len = (x1 - x0) as usize * n;
+    let (s_stride, d_stride) = (s.stride() as usize, d.stride() as usize);
+    for y in s.y().max(d.y())..(s.y() + s.h()).min(d.y() + d.h()) {
+        let from = (y - s.y()) as usize * s_stride + (x0 - s.x()) as usize * n;
+        let to = (y - d.y()) as usize * d_stride + (x0 - d.x()) as usize * n;
+        d.samples_mut()[to..to + len].copy_from_slice(&s.samples()[from..from + len]);
+    }
 }
 
 /// Render page contents to device (excludes annotations)
 ///
+/// The page's content streams are interpreted by a run processor, which
+/// calls the device for each path, clip, text and image they paint.
+///
 /// # Safety
 /// Caller must ensure device is valid
 #[unsafe(no_mangle)]
@@ -461,12 +1236,28 @@ pub extern "C" fn fz_run_page_contents(
     transform: super::geometry::fz_matrix,
     cookie: *mut std::ffi::c_void,
 ) {
-    // Same as fz_run_page but without annotations
-    fz_run_page(_ctx, page, device, transform, cookie);
+    if !cookie.is_null() && cookie_aborted(cookie as Handle) {
+        return;
+    }
+    let _arena = super::pool::RenderArenaScope::enter();
+
+    let Some((doc, page_num)) = PAGES
+        .get(page)
+        .and_then(|p| p.lock().ok().map(|g| (g.doc_handle, g.page_num)))
+    else {
+        return;
+    };
+    if super::device::DEVICES.get(device).is_none() {
+        return;
+    }
+    super::pdf_interpret::run_page_contents(doc, page_num, device, to_matrix(transform));
 }
 
 /// Render page annotations to device
 ///
+/// Each annotation's appearance is drawn from its rectangle, colours and
+/// border (see `PdfProcessor::draw_annot`).
+///
 /// # Safety
 /// Caller must ensure device is valid
 #[unsafe(no_mangle)]
@@ -477,58 +1268,20 @@ pub extern "C" fn fz_run_page_annots(
     transform: super::geometry::fz_matrix,
     cookie: *mut std::ffi::c_void,
 ) {
-    // Check for cancellation via cookie
-    if !cookie.is_null() {
-        let cookie_handle = cookie as Handle;
-        if let Some(c) = super::cookie::COOKIES.get(cookie_handle) {
-            if let Ok(guard) = c.lock() {
-                if guard.should_abort() {
-                    return; // Operation cancelled
-                }
-            }
-        }
+    if !cookie.is_null() && cookie_aborted(cookie as Handle) {
+        return;
     }
 
-    // Get annotations for this page
-    let annot_handles = if let Some(p) = PAGES.get(page) {
-        if let Ok(guard) = p.lock() {
-            guard.annotations.clone()
-        } else {
-            return;
-        }
-    } else {
+    let Some(annot_handles) = PAGES
+        .get(page)
+        .and_then(|p| p.lock().ok().map(|g| g.annotations.clone()))
+    else {
         return;
     };
-
-    // Verify device exists
-    if super::device::DEVICES.get(device).is_none() {
+    if annot_handles.is_empty() || super::device::DEVICES.get(device).is_none() {
         return;
     }
-
-    // Convert transform to Matrix
-    let _matrix = crate::fitz::geometry::Matrix {
-        a: transform.a,
-        b: transform.b,
-        c: transform.c,
-        d: transform.d,
-        e: transform.e,
-        f: transform.f,
-    };
-
-    // Render each annotation
-    for annot_handle in annot_handles {
-        if let Some(annot_arc) = super::annot::ANNOTATIONS.get(annot_handle) {
-            if let Ok(_annot_guard) = annot_arc.lock() {
-                // For each annotation, we would:
-                // 1. Get annotation rectangle and transform it
-                // 2. Render annotation appearance (AP stream) if available
-                // 3. Fall back to rendering based on annotation type
-                //
-                // Since annotation rendering requires appearance stream parsing,
-                // this establishes the API structure for when that's implemented
-            }
-        }
-    }
+    super::pdf_interpret::run_annots(&annot_handles, device, to_matrix(transform));
 }
 
 // ============================================================================
@@ -657,6 +1410,26 @@ pub extern "C" fn fz_document_format(
     0
 }
 
+/// Inspect a document in one call
+///
+/// Returns a buffer holding the metadata, page sizes, labels and links,
+/// outline, fonts and image counts as JSON, gathered without loading any
+/// page content, or 0 if `doc` is invalid.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_inspect_document(_ctx: Handle, doc: Handle) -> Handle {
+    let Some(d) = DOCUMENTS.get(doc) else {
+        return 0;
+    };
+    let Ok(guard) = d.lock() else {
+        return 0;
+    };
+    let (data, format, page_count) = (guard.data(), guard.format.clone(), guard.page_count);
+    drop(guard);
+
+    let json = super::pdf_inspect::inspect(&data, &format, page_count).to_json_string();
+    super::BUFFERS.insert(super::buffer::Buffer::from_vec(json.into_bytes()))
+}
+
 /// Check if document is reflowable
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_is_document_reflowable(_ctx: Handle, doc: Handle) -> i32 {
@@ -712,10 +1485,12 @@ pub extern "C" fn fz_page_label(
         return 0;
     }
 
+    // PDF page labels come from the page tree index
+    let pdf_label = super::pdf_page::page_label(doc, page_num);
     if let Some(d) = DOCUMENTS.get(doc) {
         if let Ok(guard) = d.lock() {
             if page_num >= 0 && page_num < guard.page_count {
-                let label = format!("Page {}", page_num + 1);
+                let label = pdf_label.unwrap_or_else(|| format!("Page {}", page_num + 1));
                 let bytes = label.as_bytes();
                 let copy_len = (bytes.len()).min((size - 1) as usize);
 
@@ -937,6 +1712,32 @@ mod tests {
         super::super::STREAMS.remove(stream_handle);
     }
 
+    #[test]
+    fn test_open_document_maps_file() {
+        use std::io::Write;
+        let mut file = tempfile::NamedTempFile::new().unwrap();
+        file.write_all(b"%PDF-1.4\n/Type /Page\n/Type /Page\n%%EOF")
+            .unwrap();
+        let path = std::ffi::CString::new(file.path().to_str().unwrap()).unwrap();
+
+        let doc_handle = fz_open_document(0, path.as_ptr());
+        assert_ne!(doc_handle, 0);
+        assert_eq!(fz_count_pages(0, doc_handle), 2);
+        let data = DOCUMENTS.get(doc_handle).unwrap().lock().unwrap().data();
+        assert!(data.is_mapped());
+
+        // A document opened from a file stream shares the stream's mapping
+        let stm = super::super::stream::fz_open_file(0, path.as_ptr());
+        let from_stream = fz_open_document_with_stream(0, std::ptr::null(), stm);
+        let shared = DOCUMENTS.get(from_stream).unwrap().lock().unwrap().data();
+        let stream_data = STREAMS.get(stm).unwrap().lock().unwrap().data.clone();
+        assert!(Arc::ptr_eq(&shared, &stream_data));
+
+        fz_drop_document(0, from_stream);
+        fz_drop_document(0, doc_handle);
+        STREAMS.remove(stm);
+    }
+
     #[test]
     fn test_open_document_with_invalid_stream() {
         let doc_handle = fz_open_document_with_stream(0, std::ptr::null(), 0);
@@ -968,6 +1769,413 @@ mod tests {
         fz_drop_document(0, doc_handle);
     }
 
+    #[test]
+    fn test_run_page_calls_the_device() {
+        use crate::ffi::pdf_image_rewriter::tests::{pdf_with, stream};
+        let data = pdf_with(&[
+            b"<< /Type /Catalog /Pages 2 0 R >>".to_vec(),
+            b"<< /Type /Pages /Kids [3 0 R] /Count 1 >>".to_vec(),
+            b"<< /Type /Page /Parent 2 0 R /Contents 4 0 R >>".to_vec(),
+            stream(
+                "",
+                b"q 1 0 0 rg 0 0 100 100 re f 0 0 1 RG 0 0 m 600 0 l S Q",
+            ),
+        ]);
+        let doc_handle = DOCUMENTS.insert(Document::new(data));
+        let page_handle = fz_load_page(0, doc_handle, 0);
+        let identity = super::super::geometry::fz_matrix::identity();
+
+        let list = super::super::display_list::fz_new_display_list(0, 0.0, 0.0, 612.0, 792.0);
+        let dev = super::super::device::fz_new_list_device(0, list);
+        fz_run_page(0, page_handle, dev, identity, std::ptr::null_mut());
+        super::super::device::fz_close_device(0, dev);
+        super::super::device::fz_drop_device(0, dev);
+        // One fill and one stroke
+        assert_eq!(
+            super::super::display_list::fz_display_list_count_commands(0, list),
+            2
+        );
+        super::super::display_list::fz_drop_display_list(0, list);
+
+        // The fill lands in rendered pixmaps
+        let rgb = super::super::colorspace::FZ_COLORSPACE_RGB;
+        let pix = fz_new_pixmap_from_page(0, page_handle, identity, rgb, 0);
+        let sample = |x, y, c| super::super::pixmap::fz_get_pixmap_sample(0, pix, x, y, c);
+        assert_eq!((sample(50, 50, 0), sample(50, 50, 1)), (255, 0));
+        assert_eq!(sample(300, 300, 1), 255);
+
+        super::super::pixmap::fz_drop_pixmap(0, pix);
+        fz_drop_page(0, page_handle);
+        fz_drop_document(0, doc_handle);
+    }
+
+    #[test]
+    fn test_new_pixmap_from_page() {
+        let pdf_data = b"%PDF-1.4\n/Type /Page\n%%EOF";
+        let doc_handle = DOCUMENTS.insert(Document::new(pdf_data.to_vec()));
+        let page_handle = fz_load_page(0, doc_handle, 0);
+
+        let ctm = super::super::geometry::fz_matrix {
+            a: 0.5,
+            b: 0.0,
+            c: 0.0,
+            d: 0.5,
+            e: 0.0,
+            f: 0.0,
+        };
+        let cs = super::super::colorspace::FZ_COLORSPACE_RGB;
+        let pix = fz_new_pixmap_from_page(0, page_handle, ctm, cs, 0);
+        assert_ne!(pix, 0);
+        assert_eq!(super::super::pixmap::fz_pixmap_width(0, pix), 306);
+        assert_eq!(super::super::pixmap::fz_pixmap_height(0, pix), 396);
+        // Opaque renders start from a white page
+        assert_eq!(
+            super::super::pixmap::fz_get_pixmap_sample(0, pix, 10, 10, 0),
+            255
+        );
+
+        super::super::pixmap::fz_drop_pixmap(0, pix);
+        fz_drop_page(0, page_handle);
+        fz_drop_document(0, doc_handle);
+    }
+
+    #[test]
+    fn test_new_pixmap_from_page_with_cookie() {
+        use super::super::cookie::*;
+
+        let pdf_data = b"%PDF-1.4\n/Type /Page\n%%EOF";
+        let doc_handle = DOCUMENTS.insert(Document::new(pdf_data.to_vec()));
+        let page_handle = fz_load_page(0, doc_handle, 0);
+        let ctm = super::super::geometry::fz_matrix {
+            a: 1.0,
+            b: 0.0,
+            c: 0.0,
+            d: 1.0,
+            e: 0.0,
+            f: 0.0,
+        };
+        let cs = super::super::colorspace::FZ_COLORSPACE_RGB;
+        let cookie = fz_new_cookie(0);
+
+        let pix = fz_new_pixmap_from_page_with_cookie(0, page_handle, ctm, cs, 1, cookie);
+        assert_ne!(pix, 0);
+        assert_eq!(fz_cookie_get_progress(0, cookie), 1);
+        assert_eq!(fz_cookie_get_progress_max(0, cookie), 1);
+        super::super::pixmap::fz_drop_pixmap(0, pix);
+
+        // An aborted cookie stops the render
+        fz_cookie_abort(0, cookie);
+        let pix = fz_new_pixmap_from_page_with_cookie(0, page_handle, ctm, cs, 1, cookie);
+        assert_eq!(pix, 0);
+
+        fz_drop_cookie(0, cookie);
+        fz_drop_page(0, page_handle);
+        fz_drop_document(0, doc_handle);
+    }
+
+    #[test]
+    fn test_memory_limit_fails_render() {
+        use super::super::context::*;
+        use super::super::cookie::*;
+
+        let ctx = unsafe { fz_new_context(std::ptr::null(), std::ptr::null(), 0) };
+        let pdf_data = b"%PDF-1.4\n/Type /Page\n%%EOF";
+        let doc_handle = DOCUMENTS.insert(Document::new(pdf_data.to_vec()));
+        let page_handle = fz_load_page(ctx, doc_handle, 0);
+        let ctm = super::super::geometry::fz_matrix::identity();
+        let cs = super::super::colorspace::FZ_COLORSPACE_RGB;
+        let cookie = fz_new_cookie(ctx);
+
+        // A 612x792 RGBA page needs about 1.9 MB
+        fz_set_document_memory_limit(ctx, doc_handle, 1 << 20);
+        assert_eq!(fz_document_memory_limit(ctx, doc_handle), 1 << 20);
+        let pix = fz_new_pixmap_from_page_with_cookie(ctx, page_handle, ctm, cs, 1, cookie);
+        assert_eq!(pix, 0);
+        assert_eq!(fz_caught(ctx), FzErrorType::Limit as i32);
+        assert_eq!(fz_cookie_get_errors(ctx, cookie), 1);
+
+        // The pixmap is credited back once dropped
+        fz_set_document_memory_limit(ctx, doc_handle, 4 << 20);
+        let pix = fz_new_pixmap_from_page_with_cookie(ctx, page_handle, ctm, cs, 1, cookie);
+        assert_ne!(pix, 0);
+        assert!(fz_document_memory_used(ctx, doc_handle) >= 612 * 792 * 4);
+        super::super::pixmap::fz_drop_pixmap(ctx, pix);
+        assert!(fz_document_memory_used(ctx, doc_handle) < 612 * 792 * 4);
+
+        // So is a cookie's limit
+        fz_set_document_memory_limit(ctx, doc_handle, 0);
+        fz_cookie_set_memory_limit(ctx, cookie, 1 << 20);
+        let pix = fz_new_pixmap_from_page_with_cookie(ctx, page_handle, ctm, cs, 1, cookie);
+        assert_eq!(pix, 0);
+        assert_eq!(fz_cookie_get_errors(ctx, cookie), 2);
+
+        fz_drop_cookie(ctx, cookie);
+        fz_drop_page(ctx, page_handle);
+        fz_drop_document(ctx, doc_handle);
+        fz_drop_context(ctx);
+    }
+
+    #[test]
+    fn test_new_pixmap_from_page_with_options() {
+        let pdf_data = b"%PDF-1.4\n/Type /Page\n%%EOF";
+        let doc_handle = DOCUMENTS.insert(Document::new(pdf_data.to_vec()));
+        let page_handle = fz_load_page(0, doc_handle, 0);
+        let ctm = super::super::geometry::fz_matrix {
+            a: 0.25,
+            b: 0.0,
+            c: 0.0,
+            d: 0.25,
+            e: 0.0,
+            f: 0.0,
+        };
+        let gray = super::super::colorspace::FZ_COLORSPACE_GRAY;
+
+        // Gray thumbnail without AA, annotations or widgets
+        let pix = fz_new_pixmap_from_page_with_options(0, page_handle, ctm, gray, 0, 0, 0, 0);
+        assert_ne!(pix, 0);
+        assert_eq!(super::super::pixmap::fz_pixmap_components(0, pix), 1);
+        assert_eq!(super::super::pixmap::fz_pixmap_width(0, pix), 153);
+        assert_eq!(super::super::pixmap::fz_pixmap_size(0, pix), 153 * 198);
+        assert_eq!(
+            super::super::pixmap::fz_get_pixmap_sample(0, pix, 0, 0, 0),
+            255
+        );
+        super::super::pixmap::fz_drop_pixmap(0, pix);
+
+        // All flags on an invalid page still fail cleanly
+        let flags = FZ_RENDER_ANNOTS | FZ_RENDER_WIDGETS;
+        assert_eq!(
+            fz_new_pixmap_from_page_with_options(0, 0, ctm, gray, 0, 8, flags, 0),
+            0
+        );
+
+        fz_drop_page(0, page_handle);
+        fz_drop_document(0, doc_handle);
+    }
+
+    #[test]
+    fn test_new_pixmap_from_page_band() {
+        let pdf_data = b"%PDF-1.4\n/Type /Page\n%%EOF";
+        let doc_handle = DOCUMENTS.insert(Document::new(pdf_data.to_vec()));
+        let page_handle = fz_load_page(0, doc_handle, 0);
+        let ctm = super::super::geometry::fz_matrix {
+            a: 0.25,
+            b: 0.0,
+            c: 0.0,
+            d: 0.25,
+            e: 0.0,
+            f: 0.0,
+        };
+        let gray = super::super::colorspace::FZ_COLORSPACE_GRAY;
+
+        // 198 rows in bands of 64: the last band is clipped to the page
+        let mut rows = 0;
+        for band_y in (0..198).step_by(64) {
+            let pix =
+                fz_new_pixmap_from_page_band(0, page_handle, ctm, gray, 0, 0, 0, band_y, 64, 0);
+            assert_ne!(pix, 0);
+            assert_eq!(super::super::pixmap::fz_pixmap_width(0, pix), 153);
+            assert_eq!(super::super::pixmap::fz_pixmap_y(0, pix), band_y);
+            rows += super::super::pixmap::fz_pixmap_height(0, pix);
+            super::super::pixmap::fz_drop_pixmap(0, pix);
+        }
+        assert_eq!(rows, 198);
+
+        // Bands past the bottom of the page are empty
+        assert_eq!(
+            fz_new_pixmap_from_page_band(0, page_handle, ctm, gray, 0, 0, 0, 198, 64, 0),
+            0
+        );
+        assert_eq!(
+            fz_new_pixmap_from_page_band(0, page_handle, ctm, gray, 0, 0, 0, 0, 0, 0),
+            0
+        );
+
+        fz_drop_page(0, page_handle);
+        fz_drop_document(0, doc_handle);
+    }
+
+    #[test]
+    fn test_update_pixmap_from_page_redraws_damage_only() {
+        let pdf_data = b"%PDF-1.4\n/Type /Page\n%%EOF";
+        let doc_handle = DOCUMENTS.insert(Document::new(pdf_data.to_vec()));
+        let page_handle = fz_load_page(0, doc_handle, 0);
+        let ctm = super::super::geometry::fz_matrix {
+            a: 0.25,
+            b: 0.0,
+            c: 0.0,
+            d: 0.25,
+            e: 0.0,
+            f: 0.0,
+        };
+        let gray = super::super::colorspace::FZ_COLORSPACE_GRAY;
+        let pix = fz_new_pixmap_from_page_with_options(0, page_handle, ctm, gray, 0, 0, 0, 0);
+        super::super::pixmap::fz_clear_pixmap_with_value(0, pix, 7);
+
+        // Two overlapping rects make one area: page (0,0)-(80,40) is
+        // device (0,0)-(20,10)
+        let rect = |x0, y0, x1, y1| super::super::geometry::fz_rect { x0, y0, x1, y1 };
+        let damage = [rect(0.0, 0.0, 40.0, 40.0), rect(20.0, 0.0, 80.0, 40.0)];
+        let n = fz_update_pixmap_from_page(0, page_handle, ctm, pix, 0, 0, damage.as_ptr(), 2, 0);
+        assert_eq!(n, 1);
+
+        let samples = super::super::PIXMAPS
+            .get(pix)
+            .unwrap()
+            .lock()
+            .unwrap()
+            .samples()
+            .to_vec();
+        let stride = super::super::pixmap::fz_pixmap_stride(0, pix) as usize;
+        assert_eq!(samples[0], 255);
+        assert_eq!(samples[9 * stride + 19], 255);
+        assert_eq!(samples[9 * stride + 20], 7);
+        assert_eq!(samples[10 * stride], 7);
+
+        // Damage outside the page draws nothing
+        let outside = [rect(-100.0, -100.0, -50.0, -50.0)];
+        let n = fz_update_pixmap_from_page(0, page_handle, ctm, pix, 0, 0, outside.as_ptr(), 1, 0);
+        assert_eq!(n, 0);
+
+        super::super::pixmap::fz_drop_pixmap(0, pix);
+        fz_drop_page(0, page_handle);
+        fz_drop_document(0, doc_handle);
+    }
+
+    #[test]
+    fn test_fill_pixmap_from_page_into_caller_memory() {
+        let pdf_data = b"%PDF-1.4\n/Type /Page\n%%EOF";
+        let doc_handle = DOCUMENTS.insert(Document::new(pdf_data.to_vec()));
+        let page_handle = fz_load_page(0, doc_handle, 0);
+        let ctm = super::super::geometry::fz_matrix {
+            a: 0.25,
+            b: 0.0,
+            c: 0.0,
+            d: 0.25,
+            e: 0.0,
+            f: 0.0,
+        };
+        let gray = super::super::colorspace::FZ_COLORSPACE_GRAY;
+
+        // 153 x 198 page in rows padded to 160 bytes, marked to see the clear
+        let stride = 160;
+        let mut memory = vec![7u8; stride * 198];
+        let pix = super::super::pixmap::fz_new_pixmap_with_data(
+            0,
+            gray,
+            153,
+            198,
+            0,
+            0,
+            stride as i32,
+            memory.as_mut_ptr(),
+        );
+        assert_ne!(pix, 0);
+        assert_eq!(fz_fill_pixmap_from_page(0, page_handle, ctm, pix, 0, 0, 0), 0);
+        assert_eq!(super::super::pixmap::fz_pixmap_samples(0, pix), memory.as_mut_ptr());
+        super::super::pixmap::fz_drop_pixmap(0, pix);
+
+        assert!(memory.iter().all(|&s| s == 255));
+        assert_eq!(fz_fill_pixmap_from_page(0, 0, ctm, pix, 0, 0, 0), -1);
+
+        fz_drop_page(0, page_handle);
+        fz_drop_document(0, doc_handle);
+    }
+
+    #[test]
+    fn test_write_page_banded() {
+        use super::super::band_writer as bw;
+
+        let pdf_data = b"%PDF-1.4\n/Type /Page\n%%EOF";
+        let doc_handle = DOCUMENTS.insert(Document::new(pdf_data.to_vec()));
+        let page_handle = fz_load_page(0, doc_handle, 0);
+        let ctm = super::super::geometry::fz_matrix {
+            a: 0.25,
+            b: 0.0,
+            c: 0.0,
+            d: 0.25,
+            e: 0.0,
+            f: 0.0,
+        };
+        let gray = super::super::colorspace::FZ_COLORSPACE_GRAY;
+
+        // 153x198 gray PNM in bands of 50 rows: header plus every pixel
+        let writer = bw::fz_new_band_writer(0, 0, 2);
+        bw::fz_band_writer_set_rows_per_band(0, writer, 50);
+        assert_eq!(
+            fz_write_page_banded(0, page_handle, ctm, gray, 0, 0, 0, writer, 0),
+            1
+        );
+        assert_eq!(bw::fz_band_writer_total_bands(0, writer), 4);
+        let header = b"P5\n153 198\n255\n".len();
+        assert_eq!(
+            bw::fz_band_writer_bytes_written(0, writer),
+            header + 153 * 198
+        );
+        bw::fz_drop_band_writer(0, writer);
+
+        // Pipelined PWG and PCLm match writing the same bands one at a time
+        let output = |writer| {
+            let mut size = 0;
+            let data = bw::fz_band_writer_get_output(0, writer, &mut size);
+            unsafe { std::slice::from_raw_parts(data, size) }.to_vec()
+        };
+        for format in [5, 9] {
+            let piped = bw::fz_new_band_writer(0, 0, format);
+            bw::fz_band_writer_set_rows_per_band(0, piped, 30);
+            assert_eq!(
+                fz_write_page_banded(0, page_handle, ctm, gray, 0, 0, 0, piped, 0),
+                1
+            );
+
+            let serial = bw::fz_new_band_writer(0, 0, format);
+            bw::fz_band_writer_set_rows_per_band(0, serial, 30);
+            bw::fz_band_writer_set_dimensions(0, serial, 153, 198);
+            bw::fz_band_writer_set_components(0, serial, 1, 0);
+            assert_eq!(bw::fz_band_writer_write_header(0, serial), 1);
+            for band_y in (0..198).step_by(30) {
+                let pix =
+                    fz_new_pixmap_from_page_band(0, page_handle, ctm, gray, 0, 0, 0, band_y, 30, 0);
+                let p = super::super::PIXMAPS.get(pix).unwrap();
+                let p = p.lock().unwrap();
+                assert_eq!(
+                    bw::fz_band_writer_write_band(0, serial, p.h(), p.samples().as_ptr()),
+                    1
+                );
+                drop(p);
+                super::super::pixmap::fz_drop_pixmap(0, pix);
+            }
+            assert_eq!(bw::fz_band_writer_write_trailer(0, serial), 1);
+
+            assert_eq!(output(piped), output(serial), "format {format}");
+            assert_eq!(
+                bw::fz_band_writer_state(0, piped),
+                bw::BandWriterState::Complete as i32
+            );
+            bw::fz_drop_band_writer(0, piped);
+            bw::fz_drop_band_writer(0, serial);
+        }
+
+        // PCLm cannot store alpha
+        let writer = bw::fz_new_band_writer(0, 0, 9);
+        assert_eq!(
+            fz_write_page_banded(0, page_handle, ctm, gray, 1, 0, 0, writer, 0),
+            0
+        );
+        bw::fz_drop_band_writer(0, writer);
+
+        fz_drop_page(0, page_handle);
+        fz_drop_document(0, doc_handle);
+    }
+
+    #[test]
+    fn test_draw_device_aa_from_bits() {
+        assert_eq!(draw_device_aa_from_bits(0), 0);
+        assert_eq!(draw_device_aa_from_bits(2), 1);
+        assert_eq!(draw_device_aa_from_bits(4), 2);
+        assert_eq!(draw_device_aa_from_bits(8), 3);
+    }
+
     #[test]
     fn test_load_page_invalid_doc() {
         let page_handle = fz_load_page(0, 0, 0);
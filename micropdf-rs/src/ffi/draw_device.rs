@@ -1,7 +1,23 @@
 //! C FFI for draw device (rendering) - MuPDF compatible
 //! Safe Rust implementation of fz_draw_device
 
-use super::{Handle, HandleStore};
+use super::colorspace::FZ_COLORSPACE_BGR;
+use super::composite::{SpanPaint, paint_span};
+use super::geometry::{fz_irect, fz_rect};
+use super::pdf_recolor::convert_components;
+use super::pixmap::Pixmap;
+use super::rasterize::{self, Bounds, RasterScratch, Rasterizer};
+use super::shade::SHADES;
+use super::shade_paint;
+use super::store::{StoreType, store_discard_matching, store_find_and_keep, store_owned_item};
+use super::{Handle, HandleStore, PIXMAPS};
+use crate::fitz::colorspace::Colorspace;
+use crate::fitz::device::{BlendMode as FitzBlendMode, Device};
+use crate::fitz::geometry::{Matrix, Rect};
+use crate::fitz::image::Image;
+use crate::fitz::path::{Path, PathElement, StrokeState};
+use crate::fitz::text::Text;
+use std::cell::RefCell;
 use std::sync::LazyLock;
 
 /// Blend mode enumeration (PDF/SVG standard)
@@ -111,6 +127,10 @@ pub struct GraphicsState {
     pub fill_alpha: f32,
     /// Overprint mode
     pub overprint: OverprintMode,
+    /// Ink tints of the stroke colour by separation, negative where unnamed
+    pub stroke_tints: Vec<f32>,
+    /// Ink tints of the fill colour by separation, negative where unnamed
+    pub fill_tints: Vec<f32>,
 }
 
 impl Default for GraphicsState {
@@ -130,6 +150,8 @@ impl Default for GraphicsState {
             stroke_alpha: 1.0,
             fill_alpha: 1.0,
             overprint: OverprintMode::Off,
+            stroke_tints: Vec::new(),
+            fill_tints: Vec::new(),
         }
     }
 }
@@ -156,6 +178,10 @@ pub struct DrawDevice {
     pub height: i32,
     /// Anti-aliasing level
     pub aa_level: AntiAliasLevel,
+    /// How fills and strokes are turned into coverage
+    pub rasterizer: Rasterizer,
+    /// Edge and row buffers for the rasterizer
+    pub raster: RasterScratch,
     /// Graphics state stack
     pub state_stack: Vec<GraphicsState>,
     /// Current graphics state
@@ -168,6 +194,40 @@ pub struct DrawDevice {
     pub current_path: Vec<PathOp>,
     /// Rendering hints
     pub hints: RenderHints,
+    /// Form XObjects begun and not yet ended, innermost last
+    pub form_stack: Vec<FormCapture>,
+    /// Separation plates painted alongside the target
+    pub plates: Vec<Plate>,
+}
+
+/// A separation plate, see `fz_draw_device_set_plates`
+#[derive(Debug, Clone, Copy)]
+pub struct Plate {
+    /// One-channel pixmap of ink coverage, 0 for no ink
+    pub pixmap: Handle,
+    /// Index of the plate's separation
+    pub separation: usize,
+}
+
+/// Form XObject being drawn, see `fz_draw_device_begin_form`
+#[derive(Debug)]
+pub enum FormCapture {
+    /// Drawn straight onto the target, or already painted from the cache
+    Direct,
+    /// Drawn into its own raster, which is cached and painted at the end
+    Raster {
+        /// Target to restore and paint onto
+        target: Handle,
+        /// Pixmap the form is drawn into
+        raster: Handle,
+        /// Store key of the raster
+        key: Vec<u8>,
+        /// Whole-pixel part of the form's translation
+        origin: (i32, i32),
+        /// Blend mode and alpha the raster is painted with
+        blend: BlendMode,
+        alpha: f32,
+    },
 }
 
 /// Path operation for accumulating paths
@@ -192,25 +252,97 @@ pub struct RenderHints {
     pub overprint_simulation: bool,
     /// Use spot color rendering
     pub spot_colors: bool,
+    /// Cache rasters of form XObjects, see `fz_draw_device_begin_form`
+    pub form_cache: bool,
 }
 
 impl Default for DrawDevice {
     fn default() -> Self {
+        let scratch = take_device_scratch();
         Self {
             target: 0,
             width: 0,
             height: 0,
             aa_level: AntiAliasLevel::Medium,
-            state_stack: Vec::new(),
+            rasterizer: Rasterizer::default(),
+            raster: RasterScratch::default(),
+            state_stack: scratch.states,
             current_state: GraphicsState::default(),
-            clip_stack: Vec::new(),
+            clip_stack: scratch.clips,
             in_text: false,
-            current_path: Vec::new(),
+            current_path: scratch.path,
             hints: RenderHints::default(),
+            form_stack: Vec::new(),
+            plates: Vec::new(),
         }
     }
 }
 
+/// Spare device buffers each thread keeps between pages
+const MAX_SPARE_SCRATCH: usize = 4;
+
+/// Element count past which a spare buffer is released at end of page
+const SCRATCH_RETAIN_LEN: usize = 4096;
+
+/// Gstate, clip and path stacks handed back by a dropped draw device
+///
+/// A page render creates and drops a draw device, and its stacks grow
+/// with every save, clip and path segment. Dropped devices return the
+/// emptied stacks here so the next page on the same thread starts with
+/// warm capacity instead of regrowing them from nothing.
+#[derive(Debug, Default)]
+struct DeviceScratch {
+    states: Vec<GraphicsState>,
+    clips: Vec<ClipRegion>,
+    path: Vec<PathOp>,
+}
+
+impl DeviceScratch {
+    fn oversized(&self) -> bool {
+        self.states.capacity() > SCRATCH_RETAIN_LEN
+            || self.clips.capacity() > SCRATCH_RETAIN_LEN
+            || self.path.capacity() > SCRATCH_RETAIN_LEN
+    }
+}
+
+thread_local! {
+    static SPARE_SCRATCH: RefCell<Vec<DeviceScratch>> = const { RefCell::new(Vec::new()) };
+}
+
+fn take_device_scratch() -> DeviceScratch {
+    if !super::pool::render_arena_enabled() {
+        return DeviceScratch::default();
+    }
+    SPARE_SCRATCH
+        .with(|spare| spare.borrow_mut().pop())
+        .unwrap_or_default()
+}
+
+fn recycle_device_scratch(device: &mut DrawDevice) {
+    if !super::pool::render_arena_enabled() {
+        return;
+    }
+    let mut scratch = DeviceScratch {
+        states: std::mem::take(&mut device.state_stack),
+        clips: std::mem::take(&mut device.clip_stack),
+        path: std::mem::take(&mut device.current_path),
+    };
+    scratch.states.clear();
+    scratch.clips.clear();
+    scratch.path.clear();
+    SPARE_SCRATCH.with(|spare| {
+        let mut spare = spare.borrow_mut();
+        if spare.len() < MAX_SPARE_SCRATCH {
+            spare.push(scratch);
+        }
+    });
+}
+
+/// Release this thread's spare device buffers that grew unusually large
+pub(crate) fn trim_device_scratch() {
+    SPARE_SCRATCH.with(|spare| spare.borrow_mut().retain(|s| !s.oversized()));
+}
+
 /// Global draw device storage
 pub static DRAW_DEVICES: LazyLock<HandleStore<DrawDevice>> = LazyLock::new(HandleStore::new);
 
@@ -512,6 +644,52 @@ pub extern "C" fn fz_draw_device_set_overprint(_ctx: Handle, device: Handle, mod
     }
 }
 
+/// Read `count` tints, clamping named ones to 1
+fn read_tints(tints: *const f32, count: i32) -> Vec<f32> {
+    if tints.is_null() || count <= 0 {
+        return Vec::new();
+    }
+    let tints = unsafe { std::slice::from_raw_parts(tints, count as usize) };
+    tints.iter().map(|&t| t.min(1.0)).collect()
+}
+
+/// Set the ink tints of the stroke colour, one per separation
+///
+/// See `fz_draw_device_set_fill_tints`.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_draw_device_set_stroke_tints(
+    _ctx: Handle,
+    device: Handle,
+    tints: *const f32,
+    count: i32,
+) {
+    if let Some(dev) = DRAW_DEVICES.get(device) {
+        if let Ok(mut guard) = dev.lock() {
+            guard.current_state.stroke_tints = read_tints(tints, count);
+        }
+    }
+}
+
+/// Set the ink tints of the fill colour, one per separation
+///
+/// Tints run from 0 (no ink) to 1 and are painted onto the plates set
+/// with `fz_draw_device_set_plates`. An ink past `count` or with a
+/// negative tint isn't part of the colour: under overprint its plate
+/// keeps what is beneath, otherwise it is knocked out to no ink.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_draw_device_set_fill_tints(
+    _ctx: Handle,
+    device: Handle,
+    tints: *const f32,
+    count: i32,
+) {
+    if let Some(dev) = DRAW_DEVICES.get(device) {
+        if let Ok(mut guard) = dev.lock() {
+            guard.current_state.fill_tints = read_tints(tints, count);
+        }
+    }
+}
+
 // ============================================================================
 // Path Operations
 // ============================================================================
@@ -577,13 +755,160 @@ pub extern "C" fn fz_draw_device_close_path(_ctx: Handle, device: Handle) {
     }
 }
 
+/// A pixmap a path's coverage is painted onto
+struct PathSink<'a> {
+    samples: &'a mut [u8],
+    n: i32,
+    stride: i32,
+    /// A row of the colour the path paints here
+    source: Vec<u8>,
+    paint: SpanPaint,
+}
+
+/// Rasterize the current path onto the target pixmap and the plates in
+/// the fill or stroke colour
+///
+/// Coverage is computed once however many plates there are. A plate not
+/// covering the same area as the target (or the first plate, without a
+/// target pixmap) is skipped.
+fn paint_path(device: &mut DrawDevice, stroke: bool, even_odd: bool) {
+    let target = PIXMAPS.get(device.target);
+    let plates: Vec<_> = device
+        .plates
+        .iter()
+        .filter_map(|p| Some((p.separation, PIXMAPS.get(p.pixmap)?)))
+        .collect();
+    if target.is_none() && plates.is_empty() {
+        return;
+    }
+    let mut target = target.as_ref().map(|t| t.lock().unwrap());
+    let mut plates: Vec<_> = plates
+        .iter()
+        .map(|(separation, pix)| (*separation, pix.lock().unwrap()))
+        .collect();
+    let DrawDevice {
+        aa_level,
+        rasterizer,
+        raster,
+        current_state: state,
+        current_path: path,
+        ..
+    } = device;
+    let (colour, alpha, tints) = if stroke {
+        (state.stroke_color, state.stroke_alpha, &state.stroke_tints)
+    } else {
+        (state.fill_color, state.fill_alpha, &state.fill_tints)
+    };
+    let overprint = match state.overprint {
+        OverprintMode::Off => false,
+        OverprintMode::Stroke => stroke,
+        OverprintMode::Fill => !stroke,
+        OverprintMode::Both => true,
+    };
+    let coverage_alpha = state.alpha * alpha * colour[3];
+    let frame = match (&target, plates.first()) {
+        (Some(t), _) => (t.x(), t.y(), t.w(), t.h()),
+        (None, Some((_, p))) => (p.x(), p.y(), p.w(), p.h()),
+        (None, None) => return,
+    };
+    let (px, py, width, height) = frame;
+
+    let mut sinks = Vec::with_capacity(1 + plates.len());
+    if let Some(target) = target.as_mut() {
+        let n = (target.n() - i32::from(target.has_alpha())) as usize;
+        let mut value = convert_components(&colour[..3], n);
+        if target.colorspace() == FZ_COLORSPACE_BGR {
+            value[..3].reverse();
+        }
+        let mut paint = SpanPaint {
+            n,
+            dst_alpha: target.has_alpha(),
+            src_alpha: false,
+            alpha: coverage_alpha,
+            blend: state.blend_mode,
+        };
+        // The span painters don't do the non-separable modes
+        if !paint.is_supported() {
+            paint.blend = BlendMode::Normal;
+        }
+        let bytes = value.map(|v| (v.clamp(0.0, 1.0) * 255.0).round() as u8);
+        let (n_out, stride) = (target.n(), target.stride());
+        sinks.push(PathSink {
+            samples: target.samples_mut(),
+            n: n_out,
+            stride,
+            source: (0..width)
+                .flat_map(|_| bytes[..n].iter().copied())
+                .collect(),
+            paint,
+        });
+    }
+    for (separation, plate) in plates.iter_mut() {
+        if (plate.x(), plate.y(), plate.w(), plate.h()) != frame {
+            continue;
+        }
+        // An ink the colour doesn't name is knocked out unless overprinted
+        let tint = match tints.get(*separation) {
+            Some(&t) if t >= 0.0 => t.min(1.0),
+            _ if overprint => continue,
+            _ => 0.0,
+        };
+        let stride = plate.stride();
+        sinks.push(PathSink {
+            samples: plate.samples_mut(),
+            n: 1,
+            stride,
+            source: vec![(tint * 255.0).round() as u8; width as usize],
+            paint: SpanPaint {
+                n: 1,
+                dst_alpha: false,
+                src_alpha: false,
+                alpha: coverage_alpha,
+                blend: BlendMode::Normal,
+            },
+        });
+    }
+
+    let bounds = Bounds {
+        x0: px,
+        y0: py,
+        x1: px + width,
+        y1: py + height,
+    };
+    let emit = |x: i32, y: i32, run: &[u8]| {
+        for sink in sinks.iter_mut() {
+            let offset = ((y - py) * sink.stride + (x - px) * sink.n) as usize;
+            paint_span(
+                &mut sink.samples[offset..],
+                &sink.source,
+                Some(run),
+                run.len(),
+                &sink.paint,
+            );
+        }
+    };
+    if stroke {
+        rasterize::stroke_path(raster, path, state, *aa_level, *rasterizer, bounds, emit);
+    } else {
+        rasterize::fill_path(
+            raster,
+            path,
+            &state.ctm,
+            even_odd,
+            *aa_level,
+            *rasterizer,
+            bounds,
+            emit,
+        );
+    }
+}
+
 /// Stroke the current path
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_draw_device_stroke(_ctx: Handle, device: Handle) -> i32 {
     if let Some(dev) = DRAW_DEVICES.get(device) {
         if let Ok(mut guard) = dev.lock() {
-            // In a real implementation, this would rasterize the path
-            // For now, just clear the path after "drawing"
+            paint_path(&mut guard, true, false);
             let path_len = guard.current_path.len();
             guard.current_path.clear();
             return path_len as i32;
@@ -597,11 +922,12 @@ pub extern "C" fn fz_draw_device_stroke(_ctx: Handle, device: Handle) -> i32 {
 pub extern "C" fn fz_draw_device_fill(_ctx: Handle, device: Handle, rule: i32) -> i32 {
     if let Some(dev) = DRAW_DEVICES.get(device) {
         if let Ok(mut guard) = dev.lock() {
-            let _rule = if rule == 1 {
+            let rule = if rule == 1 {
                 ClipRule::EvenOdd
             } else {
                 ClipRule::NonZero
             };
+            paint_path(&mut guard, false, rule == ClipRule::EvenOdd);
 
             let path_len = guard.current_path.len();
             guard.current_path.clear();
@@ -793,6 +1119,36 @@ pub extern "C" fn fz_draw_device_set_aa_level(_ctx: Handle, device: Handle, leve
     }
 }
 
+/// Choose how fills and strokes are rasterized: 0 counts every sample of
+/// the anti-aliasing grid, 1 resolves whole spans into a sparse
+/// accumulation buffer
+///
+/// Both give identical pixels at every anti-aliasing level; the sparse
+/// scanline rasterizer does far less work per pixel on large or
+/// finely detailed paths. Other values are ignored.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_draw_device_set_rasterizer(_ctx: Handle, device: Handle, rasterizer: i32) {
+    let Some(rasterizer) = Rasterizer::from_i32(rasterizer) else {
+        return;
+    };
+    if let Some(dev) = DRAW_DEVICES.get(device) {
+        if let Ok(mut guard) = dev.lock() {
+            guard.rasterizer = rasterizer;
+        }
+    }
+}
+
+/// Rasterizer the device fills and strokes with, or -1 for a bad handle
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_draw_device_rasterizer(_ctx: Handle, device: Handle) -> i32 {
+    if let Some(dev) = DRAW_DEVICES.get(device) {
+        if let Ok(guard) = dev.lock() {
+            return guard.rasterizer as i32;
+        }
+    }
+    -1
+}
+
 /// Enable subpixel text
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_draw_device_enable_subpixel_text(_ctx: Handle, device: Handle, enable: i32) {
@@ -813,6 +1169,62 @@ pub extern "C" fn fz_draw_device_enable_overprint(_ctx: Handle, device: Handle,
     }
 }
 
+/// Paint separation plates alongside the target
+///
+/// `plates[i]` receives the ink of separation `i` in `seps`, or nothing
+/// if it is 0 or the separation is disabled; a `seps` of 0 enables all.
+/// Plates are one-channel pixmaps without alpha covering the same area
+/// as the target, 0 for no ink. Each fill and stroke is rasterized once
+/// and its coverage painted onto the target and every plate at once, so
+/// a job with N inks takes one pass instead of N. A count of 0 detaches
+/// the plates.
+///
+/// # Returns
+/// Number of plates attached, or -1 if a plate is not a one-channel
+/// pixmap or is given twice
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_draw_device_set_plates(
+    _ctx: Handle,
+    device: Handle,
+    seps: Handle,
+    plates: *const Handle,
+    count: i32,
+) -> i32 {
+    let handles = if plates.is_null() || count <= 0 {
+        &[][..]
+    } else {
+        unsafe { std::slice::from_raw_parts(plates, count as usize) }
+    };
+    let Some(dev) = DRAW_DEVICES.get(device) else {
+        return -1;
+    };
+    let Ok(mut guard) = dev.lock() else {
+        return -1;
+    };
+    let mut attached: Vec<Plate> = Vec::new();
+    for (separation, &pixmap) in handles.iter().enumerate() {
+        let disabled = seps != 0
+            && super::separation::fz_separation_current_behavior(0, seps, separation as i32)
+                == super::separation::SeparationBehavior::Disabled as i32;
+        if pixmap == 0 || disabled {
+            continue;
+        }
+        // Plates are locked together with the target while painting
+        if pixmap == guard.target || attached.iter().any(|p| p.pixmap == pixmap) {
+            return -1;
+        }
+        let one_channel = PIXMAPS
+            .get(pixmap)
+            .and_then(|p| p.lock().ok().map(|p| p.n() == 1 && !p.has_alpha()));
+        if one_channel != Some(true) {
+            return -1;
+        }
+        attached.push(Plate { pixmap, separation });
+    }
+    guard.plates = attached;
+    guard.plates.len() as i32
+}
+
 /// Get target pixmap
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_draw_device_target(_ctx: Handle, device: Handle) -> Handle {
@@ -824,6 +1236,524 @@ pub extern "C" fn fz_draw_device_target(_ctx: Handle, device: Handle) -> Handle
     0
 }
 
+// ============================================================================
+// Compositing
+// ============================================================================
+
+/// Paint pixmap `src` onto the target where they overlap, with the current
+/// blend mode and alpha, through the alpha-only pixmap `mask` if it isn't 0
+///
+/// Returns 1 if painted, 0 if the pixmaps don't have the same colorants
+/// or the blend mode is one the span painters don't do.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_draw_device_paint_pixmap(
+    _ctx: Handle,
+    device: Handle,
+    src: Handle,
+    mask: Handle,
+) -> i32 {
+    let Some((target, blend, alpha)) = DRAW_DEVICES.get(device).and_then(|dev| {
+        let guard = dev.lock().ok()?;
+        let state = &guard.current_state;
+        Some((guard.target, state.blend_mode, state.alpha))
+    }) else {
+        return 0;
+    };
+    if target == src || target == mask || src == mask {
+        return 0;
+    }
+    let (Some(dst), Some(src)) = (PIXMAPS.get(target), PIXMAPS.get(src)) else {
+        return 0;
+    };
+    let mask = match mask {
+        0 => None,
+        mask => match PIXMAPS.get(mask) {
+            Some(mask) => Some(mask),
+            None => return 0,
+        },
+    };
+    let mut dst = dst.lock().unwrap();
+    let src = src.lock().unwrap();
+    let mask = mask.as_ref().map(|m| m.lock().unwrap());
+    i32::from(composite_pixmap(
+        &mut dst,
+        &src,
+        mask.as_deref(),
+        (0, 0),
+        blend,
+        alpha,
+    ))
+}
+
+/// Paint `src`, moved by `shift`, onto `dst` through `mask` where they
+/// overlap; false if the colorants differ or the blend mode isn't one the
+/// span painters do
+fn composite_pixmap(
+    dst: &mut Pixmap,
+    src: &Pixmap,
+    mask: Option<&Pixmap>,
+    shift: (i32, i32),
+    blend: BlendMode,
+    alpha: f32,
+) -> bool {
+    let colorants = |p: &Pixmap| (p.n() - i32::from(p.has_alpha())) as usize;
+    let paint = SpanPaint {
+        n: colorants(dst),
+        dst_alpha: dst.has_alpha(),
+        src_alpha: src.has_alpha(),
+        alpha,
+        blend,
+    };
+    if colorants(src) != paint.n || !paint.is_supported() || mask.is_some_and(|m| m.n() != 1) {
+        return false;
+    }
+
+    let bounds = |p: &Pixmap, (dx, dy): (i32, i32)| {
+        (
+            p.x() + dx,
+            p.y() + dy,
+            p.x() + dx + p.w(),
+            p.y() + dy + p.h(),
+        )
+    };
+    let (mut x0, mut y0, mut x1, mut y1) = bounds(dst, (0, 0));
+    let others = [(Some(src), shift), (mask, (0, 0))];
+    for (other, by) in others.iter().filter_map(|&(p, by)| p.map(|p| (p, by))) {
+        let (ox0, oy0, ox1, oy1) = bounds(other, by);
+        (x0, y0, x1, y1) = (x0.max(ox0), y0.max(oy0), x1.min(ox1), y1.min(oy1));
+    }
+    if x0 >= x1 || y0 >= y1 {
+        return true;
+    }
+    let width = (x1 - x0) as usize;
+    // Byte offset of device pixel (x0, y) in `p` moved by `by`
+    let offset = |p: &Pixmap, y: i32, (dx, dy): (i32, i32)| {
+        ((y - p.y() - dy) * p.stride() + (x0 - p.x() - dx) * p.n()) as usize
+    };
+    for y in y0..y1 {
+        let (d, s) = (offset(dst, y, (0, 0)), offset(src, y, shift));
+        let m = mask.map(|m| &m.samples()[offset(m, y, (0, 0))..]);
+        paint_span(
+            &mut dst.samples_mut()[d..],
+            &src.samples()[s..],
+            m,
+            width,
+            &paint,
+        );
+    }
+    true
+}
+
+// ============================================================================
+// Shadings
+// ============================================================================
+
+/// Fill the target with `shade` under the current CTM, blend mode and
+/// alpha, clipped to the shade's bbox
+///
+/// Returns 1 if painted, 0 for function-based shades or a singular CTM.
+/// Blend modes the span painters don't do fall back to Normal.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_draw_device_fill_shade(_ctx: Handle, device: Handle, shade: Handle) -> i32 {
+    let Some((target, ctm, blend, alpha)) = DRAW_DEVICES.get(device).and_then(|dev| {
+        let guard = dev.lock().ok()?;
+        let state = &guard.current_state;
+        Some((guard.target, state.ctm, state.blend_mode, state.alpha))
+    }) else {
+        return 0;
+    };
+    let (Some(dst), Some(shade)) = (PIXMAPS.get(target), SHADES.get(shade)) else {
+        return 0;
+    };
+    let mut dst = dst.lock().unwrap();
+    let mut shade = shade.lock().unwrap();
+    i32::from(shade_paint::paint_shade(
+        &mut shade, &mut dst, &ctm, blend, alpha,
+    ))
+}
+
+// ============================================================================
+// Form XObjects
+// ============================================================================
+
+/// Largest form raster, in pixels, worth caching rather than redrawing
+const MAX_FORM_RASTER_PIXELS: i64 = 1 << 22;
+
+/// Key prefix for cached form rasters of one document
+fn form_raster_key_prefix(doc: Handle) -> Vec<u8> {
+    let mut key = b"fz_form_raster:".to_vec();
+    key.extend_from_slice(&doc.to_le_bytes());
+    key
+}
+
+fn keep_raster(raster: Handle) -> Handle {
+    if PIXMAPS.get(raster).is_none() {
+        return 0;
+    }
+    PIXMAPS.keep(raster)
+}
+
+fn release_raster(raster: Handle) {
+    PIXMAPS.release(raster);
+}
+
+/// Start drawing form XObject `xobject` of `doc`, whose `bbox` is in the
+/// current user space
+///
+/// With the form cache enabled and a CTM that only scales and translates,
+/// the form is drawn into a raster of its own that `fz_draw_device_end_form`
+/// keeps in the resource store (as a `StoreType::Image` item, so it is
+/// evicted like any other) and paints onto the target as a group with the
+/// current blend mode and alpha. Rasters are keyed by (document, xobject,
+/// scale, sub-pixel phase of the translation, target colorspace,
+/// anti-aliasing level); a later instance at another whole-pixel position
+/// is blitted from the cache. Anything else is drawn as vectors.
+///
+/// Returns 1 if the form was painted from the cache and its content should
+/// be skipped, 0 if it should be drawn. Either way end it with
+/// `fz_draw_device_end_form`.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_draw_device_begin_form(
+    _ctx: Handle,
+    device: Handle,
+    doc: Handle,
+    xobject: i32,
+    bbox: fz_rect,
+) -> i32 {
+    let Some(dev) = DRAW_DEVICES.get(device) else {
+        return 0;
+    };
+    let Ok(mut guard) = dev.lock() else {
+        return 0;
+    };
+    let dev = &mut *guard;
+    let ctm = dev.current_state.ctm;
+    let target = PIXMAPS.get(dev.target);
+    let (Some(target), true) = (
+        target,
+        // A cached raster would paint the target but not the plates
+        dev.hints.form_cache && dev.plates.is_empty() && ctm[1] == 0.0 && ctm[2] == 0.0,
+    ) else {
+        dev.form_stack.push(FormCapture::Direct);
+        return 0;
+    };
+
+    // Device box of the form with only the sub-pixel part of the translation
+    let (ox, oy) = (ctm[4].floor(), ctm[5].floor());
+    let (phase_x, phase_y) = (ctm[4] - ox, ctm[5] - oy);
+    let xs = [bbox.x0 * ctm[0] + phase_x, bbox.x1 * ctm[0] + phase_x];
+    let ys = [bbox.y0 * ctm[3] + phase_y, bbox.y1 * ctm[3] + phase_y];
+    let area = fz_irect {
+        x0: xs[0].min(xs[1]).floor() as i32,
+        y0: ys[0].min(ys[1]).floor() as i32,
+        x1: xs[0].max(xs[1]).ceil() as i32,
+        y1: ys[0].max(ys[1]).ceil() as i32,
+    };
+    let pixels = i64::from(area.x1 - area.x0) * i64::from(area.y1 - area.y0);
+    if area.x0 >= area.x1 || area.y0 >= area.y1 || pixels > MAX_FORM_RASTER_PIXELS {
+        dev.form_stack.push(FormCapture::Direct);
+        return 0;
+    }
+    let origin = (ox as i32, oy as i32);
+    let colorspace = target.lock().unwrap().colorspace();
+
+    let mut key = form_raster_key_prefix(doc);
+    key.extend_from_slice(&xobject.to_le_bytes());
+    for v in [ctm[0], ctm[3], phase_x, phase_y] {
+        key.extend_from_slice(&v.to_bits().to_le_bytes());
+    }
+    key.extend_from_slice(&colorspace.to_le_bytes());
+    key.push(dev.aa_level as u8);
+
+    let (blend, alpha) = (dev.current_state.blend_mode, dev.current_state.alpha);
+    let cached = store_find_and_keep(&key, keep_raster);
+    if cached != 0 {
+        let painted = PIXMAPS.get(cached).is_some_and(|raster| {
+            let raster = raster.lock().unwrap();
+            let mut target = target.lock().unwrap();
+            composite_pixmap(&mut target, &raster, None, origin, blend, alpha)
+        });
+        release_raster(cached);
+        if painted {
+            dev.form_stack.push(FormCapture::Direct);
+            return 1;
+        }
+    }
+
+    let placed = fz_irect {
+        x0: area.x0 + origin.0,
+        y0: area.y0 + origin.1,
+        x1: area.x1 + origin.0,
+        y1: area.y1 + origin.1,
+    };
+    let raster = PIXMAPS.insert(Pixmap::with_bbox(colorspace, placed, true));
+    dev.form_stack.push(FormCapture::Raster {
+        target: dev.target,
+        raster,
+        key,
+        origin,
+        blend,
+        alpha,
+    });
+    // The group collects the form as is; blend and alpha apply when it's painted
+    dev.target = raster;
+    dev.current_state.blend_mode = BlendMode::Normal;
+    dev.current_state.alpha = 1.0;
+    0
+}
+
+/// Finish the form begun by the matching `fz_draw_device_begin_form`
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_draw_device_end_form(_ctx: Handle, device: Handle) {
+    let Some(dev) = DRAW_DEVICES.get(device) else {
+        return;
+    };
+    let Ok(mut guard) = dev.lock() else {
+        return;
+    };
+    let Some(FormCapture::Raster {
+        target,
+        raster,
+        key,
+        origin,
+        blend,
+        alpha,
+    }) = guard.form_stack.pop()
+    else {
+        return;
+    };
+    guard.target = target;
+    guard.current_state.blend_mode = blend;
+    guard.current_state.alpha = alpha;
+    let Some(pixmap) = PIXMAPS.get(raster) else {
+        return;
+    };
+    let size = {
+        let mut pixmap = pixmap.lock().unwrap();
+        if let Some(target) = PIXMAPS.get(target) {
+            let mut target = target.lock().unwrap();
+            composite_pixmap(&mut target, &pixmap, None, (0, 0), blend, alpha);
+        }
+        // Cached relative to the whole-pixel translation
+        let (x, y) = (pixmap.x() - origin.0, pixmap.y() - origin.1);
+        pixmap.set_origin(x, y);
+        pixmap.samples().len()
+    };
+    store_owned_item(StoreType::Image, raster, size, &key, release_raster);
+}
+
+/// Enable or disable the form XObject raster cache
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_draw_device_enable_form_cache(_ctx: Handle, device: Handle, enable: i32) {
+    if let Some(dev) = DRAW_DEVICES.get(device) {
+        if let Ok(mut guard) = dev.lock() {
+            guard.hints.form_cache = enable != 0;
+        }
+    }
+}
+
+/// Drop the cached form rasters of a document
+///
+/// `fz_drop_document` does this automatically.
+///
+/// # Returns
+/// Number of rasters removed from the store
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_purge_form_raster_cache(_ctx: Handle, doc: Handle) -> i32 {
+    store_discard_matching(StoreType::Image, &form_raster_key_prefix(doc)) as i32
+}
+
+// ============================================================================
+// Display List Playback
+// ============================================================================
+
+/// A path as the ops the rasterizer takes, quadratics raised to cubics
+pub(crate) fn path_ops(path: &Path) -> Vec<PathOp> {
+    let mut ops = Vec::with_capacity(path.elements().len());
+    let mut current = (0.0, 0.0);
+    for element in path.elements() {
+        match *element {
+            PathElement::MoveTo(p) => {
+                ops.push(PathOp::MoveTo(p.x, p.y));
+                current = (p.x, p.y);
+            }
+            PathElement::LineTo(p) => {
+                ops.push(PathOp::LineTo(p.x, p.y));
+                current = (p.x, p.y);
+            }
+            PathElement::QuadTo(c, p) => {
+                // Degree-elevated to the cubic with the same shape
+                let (x0, y0) = current;
+                ops.push(PathOp::CurveTo(
+                    x0 + 2.0 / 3.0 * (c.x - x0),
+                    y0 + 2.0 / 3.0 * (c.y - y0),
+                    p.x + 2.0 / 3.0 * (c.x - p.x),
+                    p.y + 2.0 / 3.0 * (c.y - p.y),
+                    p.x,
+                    p.y,
+                ));
+                current = (p.x, p.y);
+            }
+            PathElement::CurveTo(c1, c2, p) => {
+                ops.push(PathOp::CurveTo(c1.x, c1.y, c2.x, c2.y, p.x, p.y));
+                current = (p.x, p.y);
+            }
+            PathElement::Close => ops.push(PathOp::ClosePath),
+            PathElement::Rect(r) => {
+                ops.extend([
+                    PathOp::MoveTo(r.x0, r.y0),
+                    PathOp::LineTo(r.x1, r.y0),
+                    PathOp::LineTo(r.x1, r.y1),
+                    PathOp::LineTo(r.x0, r.y1),
+                    PathOp::ClosePath,
+                ]);
+                current = (r.x0, r.y0);
+            }
+        }
+    }
+    ops
+}
+
+/// A matrix as the `[a, b, c, d, e, f]` a graphics state keeps
+pub(crate) fn linear(ctm: &Matrix) -> [f32; 6] {
+    [ctm.a, ctm.b, ctm.c, ctm.d, ctm.e, ctm.f]
+}
+
+/// A graphics state stroking with `stroke` under `ctm`
+pub(crate) fn line_style(stroke: &StrokeState, ctm: &Matrix) -> GraphicsState {
+    GraphicsState {
+        ctm: linear(ctm),
+        line_width: stroke.linewidth,
+        miter_limit: stroke.miterlimit,
+        line_cap: stroke.start_cap as i32,
+        line_join: stroke.linejoin as i32,
+        dash_array: stroke.dash_pattern.clone(),
+        dash_phase: stroke.dash_phase,
+        ..Default::default()
+    }
+}
+
+/// A colour in `colorspace` as RGB with `alpha`
+pub(crate) fn rgba(colorspace: &Colorspace, color: &[f32], alpha: f32) -> [f32; 4] {
+    let n = usize::from(colorspace.n()).min(color.len());
+    let [r, g, b, _] = convert_components(&color[..n], 3);
+    [r, g, b, alpha]
+}
+
+/// Plays display lists (and so pages) onto a draw device
+///
+/// Fills and strokes are painted with the device's anti-aliasing,
+/// rasterizer and plates, each under its own state from the list rather
+/// than the device's. What a mask is made of is left out, as are text,
+/// images and shadings for now; clips bound nothing, as with
+/// `fz_draw_device_clip`, and a tile's cell is painted once.
+pub(crate) struct DrawPlayback<'a> {
+    device: &'a mut DrawDevice,
+    /// Depth of masks being defined
+    in_mask: usize,
+}
+
+impl<'a> DrawPlayback<'a> {
+    pub(crate) fn new(device: &'a mut DrawDevice) -> Self {
+        Self { device, in_mask: 0 }
+    }
+
+    /// Paint `path` with `state` standing in for the device's
+    fn paint(&mut self, path: &Path, state: GraphicsState, stroke: bool, even_odd: bool) {
+        if self.in_mask > 0 {
+            return;
+        }
+        let device = &mut *self.device;
+        let state = std::mem::replace(&mut device.current_state, state);
+        let ops = std::mem::replace(&mut device.current_path, path_ops(path));
+        paint_path(device, stroke, even_odd);
+        device.current_path = ops;
+        device.current_state = state;
+    }
+}
+
+impl Device for DrawPlayback<'_> {
+    fn fill_path(
+        &mut self,
+        path: &Path,
+        even_odd: bool,
+        ctm: &Matrix,
+        colorspace: &Colorspace,
+        color: &[f32],
+        alpha: f32,
+    ) {
+        let state = GraphicsState {
+            ctm: linear(ctm),
+            fill_color: rgba(colorspace, color, 1.0),
+            fill_alpha: alpha,
+            ..Default::default()
+        };
+        self.paint(path, state, false, even_odd);
+    }
+
+    fn stroke_path(
+        &mut self,
+        path: &Path,
+        stroke: &StrokeState,
+        ctm: &Matrix,
+        colorspace: &Colorspace,
+        color: &[f32],
+        alpha: f32,
+    ) {
+        let state = GraphicsState {
+            stroke_color: rgba(colorspace, color, 1.0),
+            stroke_alpha: alpha,
+            ..line_style(stroke, ctm)
+        };
+        self.paint(path, state, true, false);
+    }
+
+    fn clip_path(&mut self, _: &Path, _: bool, _: &Matrix, _: Rect) {}
+    fn clip_stroke_path(&mut self, _: &Path, _: &StrokeState, _: &Matrix, _: Rect) {}
+    fn fill_text(&mut self, _: &Text, _: &Matrix, _: &Colorspace, _: &[f32], _: f32) {}
+    fn stroke_text(
+        &mut self,
+        _: &Text,
+        _: &StrokeState,
+        _: &Matrix,
+        _: &Colorspace,
+        _: &[f32],
+        _: f32,
+    ) {
+    }
+    fn clip_text(&mut self, _: &Text, _: &Matrix, _: Rect) {}
+    fn clip_stroke_text(&mut self, _: &Text, _: &StrokeState, _: &Matrix, _: Rect) {}
+    fn ignore_text(&mut self, _: &Text, _: &Matrix) {}
+    fn fill_image(&mut self, _: &Image, _: &Matrix, _: f32) {}
+    fn fill_image_mask(&mut self, _: &Image, _: &Matrix, _: &Colorspace, _: &[f32], _: f32) {}
+    fn clip_image_mask(&mut self, _: &Image, _: &Matrix, _: Rect) {}
+    fn pop_clip(&mut self) {}
+
+    fn begin_mask(&mut self, _: Rect, _: bool, _: &Colorspace, _: &[f32]) {
+        self.in_mask += 1;
+    }
+
+    fn end_mask(&mut self) {
+        self.in_mask = self.in_mask.saturating_sub(1);
+    }
+
+    fn begin_group(
+        &mut self,
+        _: Rect,
+        _: Option<&Colorspace>,
+        _: bool,
+        _: bool,
+        _: FitzBlendMode,
+        _: f32,
+    ) {
+    }
+    fn end_group(&mut self) {}
+    fn begin_tile(&mut self, _: Rect, _: Rect, _: f32, _: f32, _: &Matrix) -> i32 {
+        0
+    }
+    fn end_tile(&mut self) {}
+}
+
 // ============================================================================
 // Reference Counting
 // ============================================================================
@@ -837,7 +1767,16 @@ pub extern "C" fn fz_keep_draw_device(_ctx: Handle, device: Handle) -> Handle {
 /// Drop draw device
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_drop_draw_device(_ctx: Handle, device: Handle) {
-    DRAW_DEVICES.remove(device);
+    if let Some(dev) = DRAW_DEVICES.remove(device) {
+        if let Ok(mut guard) = dev.lock() {
+            for form in guard.form_stack.drain(..) {
+                if let FormCapture::Raster { raster, .. } = form {
+                    PIXMAPS.release(raster);
+                }
+            }
+            recycle_device_scratch(&mut guard);
+        }
+    }
 }
 
 // ============================================================================
@@ -855,6 +1794,26 @@ mod tests {
         fz_drop_draw_device(0, dev);
     }
 
+    #[test]
+    fn test_dropped_device_buffers_are_reused() {
+        let dev = fz_new_draw_device_with_size(0, 1, 100, 100);
+        for i in 0..100 {
+            fz_draw_device_line_to(0, dev, i as f32, i as f32);
+        }
+        fz_draw_device_save(0, dev);
+        fz_drop_draw_device(0, dev);
+
+        let dev = fz_new_draw_device_with_size(0, 1, 100, 100);
+        {
+            let d = DRAW_DEVICES.get(dev).unwrap();
+            let guard = d.lock().unwrap();
+            assert!(guard.current_path.is_empty());
+            assert!(guard.state_stack.is_empty());
+            assert!(guard.current_path.capacity() >= 100);
+        }
+        fz_drop_draw_device(0, dev);
+    }
+
     #[test]
     fn test_graphics_state() {
         let dev = fz_new_draw_device_with_size(0, 1, 100, 100);
@@ -905,6 +1864,265 @@ mod tests {
         fz_drop_draw_device(0, dev);
     }
 
+    #[test]
+    fn test_paint_pixmap_uses_blend_mode_and_alpha() {
+        use super::super::colorspace::FZ_COLORSPACE_RGB;
+        use super::super::geometry::fz_irect;
+
+        let mut backdrop = Pixmap::new(FZ_COLORSPACE_RGB, 4, 1, true);
+        backdrop.clear_with_value(255);
+        let target = PIXMAPS.insert(backdrop);
+        // Gray over the right half
+        let bbox = fz_irect {
+            x0: 2,
+            y0: 0,
+            x1: 4,
+            y1: 1,
+        };
+        let mut source = Pixmap::with_bbox(FZ_COLORSPACE_RGB, bbox, true);
+        source.clear_with_value(100);
+        for x in 2..4 {
+            source.set_sample(x, 0, 3, 255);
+        }
+        let source = PIXMAPS.insert(source);
+        let dev = fz_new_draw_device_with_size(0, target, 4, 1);
+        fz_draw_device_set_blend_mode(0, dev, BlendMode::Multiply as i32);
+        fz_draw_device_set_alpha(0, dev, 0.4);
+        assert_eq!(fz_draw_device_paint_pixmap(0, dev, source, 0), 1);
+
+        let painted = PIXMAPS
+            .get(target)
+            .unwrap()
+            .lock()
+            .unwrap()
+            .samples()
+            .to_vec();
+        assert_eq!(&painted[..8], &[255; 8]);
+        // White times gray, 40% of the way
+        assert_eq!(&painted[8..], &[193, 193, 193, 255, 193, 193, 193, 255]);
+
+        fz_draw_device_set_blend_mode(0, dev, BlendMode::Hue as i32);
+        assert_eq!(fz_draw_device_paint_pixmap(0, dev, source, 0), 0);
+        fz_drop_draw_device(0, dev);
+        PIXMAPS.remove(target);
+        PIXMAPS.remove(source);
+    }
+
+    #[test]
+    fn test_fill_with_either_rasterizer() {
+        use super::super::colorspace::FZ_COLORSPACE_GRAY;
+
+        let fill = |rasterizer: i32| {
+            let mut page = Pixmap::new(FZ_COLORSPACE_GRAY, 8, 8, false);
+            page.clear_with_value(255);
+            let target = PIXMAPS.insert(page);
+            let dev = fz_new_draw_device_with_options(0, target, 3, 0);
+            fz_draw_device_set_rasterizer(0, dev, rasterizer);
+            assert_eq!(fz_draw_device_rasterizer(0, dev), rasterizer);
+            fz_draw_device_set_fill_color(0, dev, 0.0, 0.0, 0.0, 1.0);
+            fz_draw_device_begin_path(0, dev);
+            fz_draw_device_move_to(0, dev, 1.0, 1.0);
+            fz_draw_device_line_to(0, dev, 6.5, 1.0);
+            fz_draw_device_line_to(0, dev, 1.0, 6.5);
+            fz_draw_device_close_path(0, dev);
+            fz_draw_device_fill(0, dev, 0);
+            fz_drop_draw_device(0, dev);
+            let pixels = PIXMAPS.remove(target).unwrap();
+            let pixels = pixels.lock().unwrap().samples().to_vec();
+            pixels
+        };
+        let dense = fill(Rasterizer::Supersample as i32);
+        assert_eq!(dense, fill(Rasterizer::SparseScanline as i32));
+        // Inside the triangle, along its diagonal and outside it
+        assert_eq!(dense[8 + 1], 0);
+        assert!(dense[4 * 8 + 2] > 0 && dense[4 * 8 + 2] < 255);
+        assert_eq!(dense[7 * 8 + 7], 255);
+    }
+
+    #[test]
+    fn test_playback_paints_display_list() {
+        use super::super::colorspace::FZ_COLORSPACE_GRAY;
+        use crate::fitz::display_list::ListDevice;
+
+        let gray = Colorspace::device_gray();
+        let square = |x0: f32, x1: f32| {
+            let mut path = Path::new();
+            path.rect_coords(x0, x0, x1, x1);
+            path
+        };
+        let mut list = ListDevice::new(Rect::new(0.0, 0.0, 8.0, 8.0));
+        // What makes up the mask isn't painted, what it masks is
+        list.begin_mask(Rect::INFINITE, true, &gray, &[0.0]);
+        list.fill_path(
+            &square(0.0, 8.0),
+            false,
+            &Matrix::IDENTITY,
+            &gray,
+            &[0.0],
+            1.0,
+        );
+        list.end_mask();
+        list.fill_path(
+            &square(1.0, 3.0),
+            false,
+            &Matrix::IDENTITY,
+            &gray,
+            &[0.0],
+            1.0,
+        );
+        list.pop_clip();
+        let list = list.into_display_list();
+
+        let mut page = Pixmap::new(FZ_COLORSPACE_GRAY, 8, 8, false);
+        page.clear_with_value(255);
+        let target = PIXMAPS.insert(page);
+        let dev = fz_new_draw_device_with_options(0, target, 0, 0);
+        {
+            let dev = DRAW_DEVICES.get(dev).unwrap();
+            let mut guard = dev.lock().unwrap();
+            let mut playback = DrawPlayback::new(&mut guard);
+            // Twice as large, so the square lands on 2..6
+            list.run(&mut playback, &Matrix::scale(2.0, 2.0), Rect::INFINITE);
+        }
+        fz_drop_draw_device(0, dev);
+        let pixels = PIXMAPS.remove(target).unwrap();
+        let pixels = pixels.lock().unwrap().samples().to_vec();
+        assert_eq!(pixels[2 * 8 + 2], 0);
+        assert_eq!(pixels[5 * 8 + 5], 0);
+        assert_eq!(pixels[8 + 1], 255);
+        assert_eq!(pixels[7 * 8 + 7], 255);
+    }
+
+    #[test]
+    fn test_repeated_form_blits_cached_raster() {
+        use super::super::colorspace::FZ_COLORSPACE_GRAY;
+
+        let mut page = Pixmap::new(FZ_COLORSPACE_GRAY, 16, 8, false);
+        page.clear_with_value(255);
+        let target = PIXMAPS.insert(page);
+        let dev = fz_new_draw_device_with_size(0, target, 16, 8);
+        fz_draw_device_enable_form_cache(0, dev, 1);
+        // Not a real document; only keys the cache
+        let doc = 0x5eed_f0f0;
+        let bbox = fz_rect {
+            x0: 0.0,
+            y0: 0.0,
+            x1: 4.0,
+            y1: 4.0,
+        };
+        let mut form = |x: f32, y: f32| {
+            fz_draw_device_set_ctm(0, dev, [1.0, 0.0, 0.0, 1.0, x, y].as_ptr());
+            if fz_draw_device_begin_form(0, dev, doc, 7, bbox) == 1 {
+                fz_draw_device_end_form(0, dev);
+                return true;
+            }
+            fz_draw_device_begin_path(0, dev);
+            fz_draw_device_move_to(0, dev, 0.0, 0.0);
+            fz_draw_device_line_to(0, dev, 4.0, 0.0);
+            fz_draw_device_line_to(0, dev, 4.0, 4.0);
+            fz_draw_device_line_to(0, dev, 0.0, 4.0);
+            fz_draw_device_close_path(0, dev);
+            fz_draw_device_fill(0, dev, 0);
+            fz_draw_device_end_form(0, dev);
+            false
+        };
+        assert!(!form(2.0, 1.0));
+        assert!(form(9.0, 3.0));
+        // Another sub-pixel phase is drawn afresh
+        assert!(!form(0.5, 0.0));
+
+        let pixels = PIXMAPS.get(target).unwrap();
+        let pixels = pixels.lock().unwrap();
+        assert_eq!(pixels.get_sample(2, 1, 0), Some(0));
+        assert_eq!(pixels.get_sample(5, 4, 0), Some(0));
+        assert_eq!(pixels.get_sample(9, 3, 0), Some(0));
+        assert_eq!(pixels.get_sample(12, 6, 0), Some(0));
+        assert_eq!(pixels.get_sample(13, 3, 0), Some(255));
+        assert_eq!(pixels.get_sample(8, 7, 0), Some(255));
+        drop(pixels);
+
+        assert_eq!(fz_purge_form_raster_cache(0, doc), 2);
+        fz_drop_draw_device(0, dev);
+        PIXMAPS.remove(target);
+    }
+
+    #[test]
+    fn test_fill_paints_all_plates_in_one_pass() {
+        use super::super::colorspace::FZ_COLORSPACE_GRAY;
+        use super::super::separation::*;
+
+        let mut page = Pixmap::new(FZ_COLORSPACE_GRAY, 8, 8, false);
+        page.clear_with_value(255);
+        let target = PIXMAPS.insert(page);
+        let plate = |value: u8| {
+            let mut pix = Pixmap::new(FZ_COLORSPACE_GRAY, 8, 8, false);
+            pix.clear_with_value(value);
+            PIXMAPS.insert(pix)
+        };
+        let (cyan, spot, varnish) = (plate(0), plate(200), plate(0));
+        let seps = fz_new_separations(0, 1);
+        for name in [c"Cyan", c"Spot", c"Varnish"] {
+            fz_add_separation(0, seps, name.as_ptr(), 0, 0.0, 0.0, 0.0, 1.0);
+        }
+        fz_set_separation_behavior(0, seps, 2, SeparationBehavior::Disabled as i32);
+        let dev = fz_new_draw_device_with_size(0, target, 8, 8);
+        let plates = [cyan, spot, varnish];
+        assert_eq!(
+            fz_draw_device_set_plates(0, dev, seps, plates.as_ptr(), 3),
+            2
+        );
+        assert_eq!(
+            fz_draw_device_set_plates(0, dev, 0, [cyan, cyan].as_ptr(), 2),
+            -1
+        );
+        assert_eq!(
+            fz_draw_device_set_plates(0, dev, 0, [target].as_ptr(), 1),
+            -1
+        );
+        assert_eq!(
+            fz_draw_device_set_plates(0, dev, seps, plates.as_ptr(), 3),
+            2
+        );
+
+        let fill = |x0: f32, x1: f32, tints: &[f32]| {
+            fz_draw_device_set_fill_tints(0, dev, tints.as_ptr(), tints.len() as i32);
+            fz_draw_device_begin_path(0, dev);
+            fz_draw_device_move_to(0, dev, x0, 0.0);
+            fz_draw_device_line_to(0, dev, x1, 0.0);
+            fz_draw_device_line_to(0, dev, x1, 8.0);
+            fz_draw_device_line_to(0, dev, x0, 8.0);
+            fz_draw_device_close_path(0, dev);
+            fz_draw_device_fill(0, dev, 0);
+        };
+        // Full cyan on the left, knocking out the spot ink
+        fill(0.0, 4.0, &[1.0, -1.0, 1.0]);
+        // Half spot on the right, overprinting the cyan plate
+        fz_draw_device_set_overprint(0, dev, OverprintMode::Fill as i32);
+        fill(2.0, 8.0, &[-1.0, 0.5]);
+        fz_drop_draw_device(0, dev);
+
+        let sample = |pix: Handle, x: i32| {
+            let pix = PIXMAPS.get(pix).unwrap();
+            let value = pix.lock().unwrap().get_sample(x, 3, 0);
+            value
+        };
+        assert_eq!(sample(target, 1), Some(0));
+        assert_eq!(sample(target, 6), Some(0));
+        assert_eq!(sample(cyan, 1), Some(255));
+        assert_eq!(sample(cyan, 3), Some(255));
+        assert_eq!(sample(cyan, 6), Some(0));
+        assert_eq!(sample(spot, 1), Some(0));
+        assert_eq!(sample(spot, 3), Some(128));
+        assert_eq!(sample(spot, 6), Some(128));
+        // Disabled, so never painted
+        assert_eq!(sample(varnish, 1), Some(0));
+
+        fz_drop_separations(0, seps);
+        for pix in [target, cyan, spot, varnish] {
+            PIXMAPS.remove(pix);
+        }
+    }
+
     #[test]
     fn test_blend_modes() {
         let dev = fz_new_draw_device_with_size(0, 1, 100, 100);
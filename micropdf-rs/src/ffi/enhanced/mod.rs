@@ -4,28 +4,69 @@
 //! the MuPDF API, using the `np_` prefix to distinguish them.
 
 use super::Handle;
+use super::buffered_io::BufferedWriter;
+use super::mmap::FileBytes;
+use super::pdf_clean::CleanOptions;
+use super::pdf_linearize::linearize_document;
+use super::pdf_optimize::optimize_document;
+use super::pdf_page_edit::{NewPage, blank_page, edit_pages};
+use super::pdf_page_tree::PageIndex;
+use super::pdf_write::{WriteSettings, write_document};
 use crate::enhanced::page_ops;
 use std::ffi::CStr;
+use std::sync::Arc;
 
 /// Write PDF to file
 ///
+/// Objects are streamed to the file as they are serialized, so memory
+/// stays near the largest object rather than the whole output. Returns 0
+/// on success, -1 on error.
+///
 /// # Safety
 /// Caller must ensure path is a valid null-terminated C string.
 #[unsafe(no_mangle)]
-pub extern "C" fn np_write_pdf(_ctx: Handle, _doc: Handle, _path: *const std::ffi::c_char) -> i32 {
-    // Placeholder for PDF writing functionality
-    // This would use the enhanced PdfWriter
-    0
+pub extern "C" fn np_write_pdf(_ctx: Handle, doc: Handle, path: *const std::ffi::c_char) -> i32 {
+    if path.is_null() {
+        return -1;
+    }
+    let Ok(path) = (unsafe { CStr::from_ptr(path) }).to_str() else {
+        return -1;
+    };
+    let Some(data) = super::DOCUMENTS.get(doc).map(|d| d.lock().unwrap().data()) else {
+        return -1;
+    };
+    let Ok(mut writer) = BufferedWriter::new(path) else {
+        return -1;
+    };
+    let settings = WriteSettings {
+        inflight_bytes: 1,
+        ..WriteSettings::default()
+    };
+    match write_document(data, &settings, &mut writer) {
+        Some(Ok(())) => 0,
+        _ => -1,
+    }
 }
 
 /// Add blank page to PDF
+///
+/// Appends a `width` x `height` page to the end of `doc`, rebuilding its
+/// page tree. Returns 0 on success, -1 on error.
 #[unsafe(no_mangle)]
-pub extern "C" fn np_add_blank_page(_ctx: Handle, _doc: Handle, width: f32, height: f32) -> i32 {
+pub extern "C" fn np_add_blank_page(_ctx: Handle, doc: Handle, width: f32, height: f32) -> i32 {
     if width <= 0.0 || height <= 0.0 {
         return -1;
     }
-    // Placeholder - would use PdfWriter::add_blank_page
-    0
+    let layout = |index: &PageIndex| {
+        let mut pages: Vec<NewPage> = (0..index.len()).map(NewPage::Existing).collect();
+        pages.push(blank_page(width, height));
+        pages
+    };
+    if edit_pages(doc, layout, false) {
+        0
+    } else {
+        -1
+    }
 }
 
 /// Merge multiple PDFs into a single output file
@@ -125,8 +166,26 @@ pub extern "C" fn np_split_pdf(
     if input_path.is_null() || output_dir.is_null() {
         return -1;
     }
-    // Placeholder - would use split_pdf function
-    0
+
+    // SAFETY: We validated both pointers are not null
+    let (input_str, output_str) = match (
+        unsafe { CStr::from_ptr(input_path) }.to_str(),
+        unsafe { CStr::from_ptr(output_dir) }.to_str(),
+    ) {
+        (Ok(input), Ok(output)) => (input, output),
+        _ => {
+            eprintln!("np_split_pdf: Invalid UTF-8 in path");
+            return -1;
+        }
+    };
+
+    match page_ops::split_pdf(input_str, output_str) {
+        Ok(files) => files.len() as i32,
+        Err(e) => {
+            eprintln!("np_split_pdf: Split failed: {}", e);
+            -1
+        }
+    }
 }
 
 /// Add watermark to PDF pages
@@ -156,7 +215,11 @@ pub extern "C" fn np_add_watermark(
     0
 }
 
-/// Optimize PDF (compress, remove duplicates, etc.)
+/// Optimize PDF (compress, remove duplicates, etc.) in place
+///
+/// Page contents are cleaned in parallel, then unused objects dropped,
+/// duplicates merged and object streams packed. The file is only replaced
+/// once the optimized copy is complete. Returns 0 on success, -1 on error.
 ///
 /// # Safety
 /// Caller must ensure path is a valid null-terminated C string.
@@ -165,7 +228,18 @@ pub extern "C" fn np_optimize_pdf(_ctx: Handle, path: *const std::ffi::c_char) -
     if path.is_null() {
         return -1;
     }
-    // Placeholder - would use optimization functions
+    let Ok(path) = (unsafe { CStr::from_ptr(path) }).to_str() else {
+        return -1;
+    };
+    let Ok(data) = FileBytes::map(path) else {
+        return -1;
+    };
+    let settings = WriteSettings::from(&CleanOptions::optimize().write);
+    let mut out = Vec::new();
+    let written = optimize_document(Arc::new(data), &settings, None, &mut out);
+    if !matches!(written, Some(Ok(()))) || std::fs::write(path, out).is_err() {
+        return -1;
+    }
     0
 }
 
@@ -182,8 +256,22 @@ pub extern "C" fn np_linearize_pdf(
     if input_path.is_null() || output_path.is_null() {
         return -1;
     }
-    // Placeholder - would use linearize function
-    0
+    let (Ok(input), Ok(output)) = (
+        unsafe { CStr::from_ptr(input_path) }.to_str(),
+        unsafe { CStr::from_ptr(output_path) }.to_str(),
+    ) else {
+        return -1;
+    };
+    let Ok(data) = FileBytes::map(input) else {
+        return -1;
+    };
+    let Ok(mut writer) = BufferedWriter::new(output) else {
+        return -1;
+    };
+    match linearize_document(Arc::new(data), 0, &mut writer) {
+        Some(Ok(())) => 0,
+        _ => -1,
+    }
 }
 
 /// Draw line on PDF page
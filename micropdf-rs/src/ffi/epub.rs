@@ -3,6 +3,8 @@
 //! Provides support for EPUB e-book format, including container parsing,
 //! OPF manifest handling, navigation (NCX/NAV), and content rendering.
 
+use crate::ffi::pdf_stream_prefetch::parallel_map;
+use crate::ffi::xml::{XmlToken, XmlTokenizer, decode_entities};
 use crate::ffi::{Handle, HandleStore};
 use std::collections::HashMap;
 use std::ffi::{CStr, CString, c_char};
@@ -261,6 +263,12 @@ pub struct EpubDocument {
     pub nav_path: Option<String>,
     /// Raw file data
     pub files: HashMap<String, Vec<u8>>,
+    /// Chapter layouts by spine index and page geometry
+    layouts: HashMap<(usize, LayoutKey), ChapterLayout>,
+    /// Geometries held in `layouts`, most recently used last
+    layout_keys: Vec<LayoutKey>,
+    /// Pages per chapter in the current layout
+    chapter_pages: Vec<i32>,
 }
 
 impl EpubDocument {
@@ -277,6 +285,9 @@ impl EpubDocument {
             ncx_path: None,
             nav_path: None,
             files: HashMap::new(),
+            layouts: HashMap::new(),
+            layout_keys: Vec::new(),
+            chapter_pages: Vec::new(),
         }
     }
 
@@ -285,6 +296,7 @@ impl EpubDocument {
             self.nav_path = Some(item.href.clone());
         }
         self.manifest.insert(item.id.clone(), item);
+        self.invalidate_layout();
     }
 
     pub fn get_manifest_item(&self, id: &str) -> Option<&ManifestItem> {
@@ -293,6 +305,7 @@ impl EpubDocument {
 
     pub fn add_spine_item(&mut self, item: SpineItem) {
         self.spine.push(item);
+        self.invalidate_layout();
     }
 
     pub fn spine_count(&self) -> usize {
@@ -305,6 +318,7 @@ impl EpubDocument {
 
     pub fn add_file(&mut self, path: &str, data: Vec<u8>) {
         self.files.insert(path.to_string(), data);
+        self.invalidate_layout();
     }
 
     pub fn get_file(&self, path: &str) -> Option<&Vec<u8>> {
@@ -316,6 +330,243 @@ impl EpubDocument {
     }
 }
 
+// ============================================================================
+// Reflow Layout
+// ============================================================================
+
+/// Default font size when a layout asks for none
+const LAYOUT_DEFAULT_EM: f32 = 12.0;
+/// Average glyph advance, in ems
+const LAYOUT_ADVANCE: f32 = 0.5;
+/// Line height, in ems
+const LAYOUT_LINE_HEIGHT: f32 = 1.2;
+/// Page geometries whose chapter layouts are kept
+const LAYOUT_CACHE_SIZES: usize = 4;
+
+/// Elements that start a new paragraph
+const BLOCK_TAGS: &[&str] = &[
+    "address",
+    "blockquote",
+    "br",
+    "dd",
+    "div",
+    "dt",
+    "figcaption",
+    "h1",
+    "h2",
+    "h3",
+    "h4",
+    "h5",
+    "h6",
+    "hr",
+    "li",
+    "p",
+    "pre",
+    "section",
+    "td",
+    "th",
+    "tr",
+];
+/// Elements whose content is never laid out
+const HIDDEN_TAGS: &[&str] = &["head", "script", "style"];
+
+/// Page size and font size a layout is made for
+///
+/// Held as float bits so equal geometries key the same cached layouts.
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub struct LayoutKey {
+    w: u32,
+    h: u32,
+    em: u32,
+}
+
+impl LayoutKey {
+    pub fn new(w: f32, h: f32, em: f32) -> Self {
+        let em = if em > 0.0 { em } else { LAYOUT_DEFAULT_EM };
+        Self {
+            w: w.max(0.0).to_bits(),
+            h: h.max(0.0).to_bits(),
+            em: em.to_bits(),
+        }
+    }
+
+    /// Characters per line and lines per page
+    fn grid(self) -> (usize, usize) {
+        let em = f32::from_bits(self.em);
+        let cols = (f32::from_bits(self.w) / (em * LAYOUT_ADVANCE)) as usize;
+        let rows = (f32::from_bits(self.h) / (em * LAYOUT_LINE_HEIGHT)) as usize;
+        (cols.max(1), rows.max(1))
+    }
+}
+
+/// One chapter laid out for one geometry
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct ChapterLayout {
+    /// Lines of text
+    pub lines: usize,
+    /// Pages; a chapter always has at least one
+    pub pages: i32,
+}
+
+/// Paragraphs of a chapter's XHTML, whitespace collapsed
+///
+/// A chapter that stops parsing part way keeps what came before.
+fn chapter_paragraphs(xhtml: &str) -> Vec<String> {
+    let is = |name: &str, tags: &[&str]| {
+        let local = name.rsplit(':').next().unwrap_or(name);
+        tags.iter().any(|t| local.eq_ignore_ascii_case(t))
+    };
+    let mut paragraphs = vec![String::new()];
+    let mut hidden = 0usize;
+    for token in XmlTokenizer::new(xhtml).map_while(|t| t.ok()) {
+        let text = match token {
+            XmlToken::Start { name, empty, .. } => {
+                if is(name, HIDDEN_TAGS) {
+                    hidden += usize::from(!empty);
+                } else if is(name, BLOCK_TAGS) {
+                    paragraphs.push(String::new());
+                }
+                continue;
+            }
+            XmlToken::End { name } => {
+                if is(name, HIDDEN_TAGS) {
+                    hidden = hidden.saturating_sub(1);
+                } else if is(name, BLOCK_TAGS) {
+                    paragraphs.push(String::new());
+                }
+                continue;
+            }
+            XmlToken::Text(raw) => decode_entities(raw),
+            XmlToken::CData(raw) => raw.into(),
+            _ => continue,
+        };
+        if hidden > 0 {
+            continue;
+        }
+        let para = paragraphs.last_mut().expect("never empty");
+        for word in text.split_whitespace() {
+            if !para.is_empty() {
+                para.push(' ');
+            }
+            para.push_str(word);
+        }
+    }
+    paragraphs.retain(|p| !p.is_empty());
+    paragraphs
+}
+
+/// Lines `paragraph` wraps to at `cols` characters, breaking at spaces
+/// and splitting words longer than a line
+fn wrapped_lines(paragraph: &str, cols: usize) -> usize {
+    let mut lines = 0;
+    let mut col = 0;
+    for word in paragraph.split(' ') {
+        let len = word.chars().count();
+        if col > 0 && col + 1 + len > cols {
+            lines += 1;
+            col = 0;
+        }
+        if col > 0 {
+            col += 1;
+        }
+        col += len;
+        while col > cols {
+            lines += 1;
+            col -= cols;
+        }
+    }
+    lines + usize::from(col > 0)
+}
+
+/// Lay out one chapter; a missing chapter is a blank page
+fn layout_chapter(xhtml: Option<&[u8]>, key: LayoutKey) -> ChapterLayout {
+    let (cols, rows) = key.grid();
+    let text = xhtml.map(String::from_utf8_lossy).unwrap_or_default();
+    let lines: usize = chapter_paragraphs(&text)
+        .iter()
+        .map(|p| wrapped_lines(p, cols))
+        .sum();
+    ChapterLayout {
+        lines,
+        pages: lines.div_ceil(rows).max(1) as i32,
+    }
+}
+
+impl EpubDocument {
+    /// Contents of the chapter at spine `index`
+    ///
+    /// Manifest hrefs are relative to the OPF file's directory.
+    pub fn chapter_data(&self, index: usize) -> Option<&[u8]> {
+        let item = self.get_manifest_item(&self.get_spine_item(index)?.idref)?;
+        let base = self.root_file.rsplit_once('/').map_or("", |(dir, _)| dir);
+        let path = if base.is_empty() {
+            item.href.clone()
+        } else {
+            format!("{base}/{}", item.href)
+        };
+        self.get_file(&path)
+            .or_else(|| self.get_file(&item.href))
+            .map(Vec::as_slice)
+    }
+
+    /// Lay out every chapter for a page size and font size, returning
+    /// the page count
+    ///
+    /// Chapters only depend on each other through their page-number
+    /// offsets, so the ones not already cached for this geometry are laid
+    /// out in parallel. Layouts for the last few geometries are kept, so
+    /// switching back to an earlier font size lays out nothing.
+    pub fn layout(&mut self, w: f32, h: f32, em: f32) -> i32 {
+        let key = LayoutKey::new(w, h, em);
+        let missing: Vec<usize> = (0..self.spine.len())
+            .filter(|&i| !self.layouts.contains_key(&(i, key)))
+            .collect();
+        let laid = parallel_map(&missing, 0, |&i| layout_chapter(self.chapter_data(i), key));
+        for (i, layout) in missing.into_iter().zip(laid) {
+            self.layouts.insert((i, key), layout);
+        }
+
+        self.layout_keys.retain(|&k| k != key);
+        self.layout_keys.push(key);
+        if self.layout_keys.len() > LAYOUT_CACHE_SIZES {
+            let old = self.layout_keys.remove(0);
+            self.layouts.retain(|&(_, k), _| k != old);
+        }
+
+        self.chapter_pages = (0..self.spine.len())
+            .map(|i| self.layouts[&(i, key)].pages)
+            .collect();
+        self.chapter_pages.iter().sum()
+    }
+
+    /// Pages in `chapter` of the current layout
+    pub fn count_chapter_pages(&self, chapter: usize) -> i32 {
+        self.chapter_pages.get(chapter).copied().unwrap_or(0)
+    }
+
+    /// Pages in the current layout
+    pub fn count_pages(&self) -> i32 {
+        self.chapter_pages.iter().sum()
+    }
+
+    /// Document page number of a chapter page, or -1
+    pub fn page_number_from_location(&self, chapter: usize, page: i32) -> i32 {
+        match self.chapter_pages.get(chapter) {
+            Some(&pages) if (0..pages).contains(&page) => {
+                self.chapter_pages[..chapter].iter().sum::<i32>() + page
+            }
+            _ => -1,
+        }
+    }
+
+    /// Drop cached layouts after the content changed
+    fn invalidate_layout(&mut self) {
+        self.layouts.clear();
+        self.layout_keys.clear();
+        self.chapter_pages.clear();
+    }
+}
+
 // ============================================================================
 // Global Handle Store
 // ============================================================================
@@ -709,6 +960,62 @@ pub extern "C" fn epub_spine_item_is_linear(_ctx: ContextHandle, doc: Handle, in
     0
 }
 
+// ============================================================================
+// FFI Functions - Layout
+// ============================================================================
+
+/// Lay out the document for a page size and font size.
+/// Returns the page count.
+#[unsafe(no_mangle)]
+pub extern "C" fn epub_layout(_ctx: ContextHandle, doc: Handle, w: f32, h: f32, em: f32) -> i32 {
+    if let Some(d) = EPUB_DOCUMENTS.get(doc) {
+        let mut d = d.lock().unwrap();
+        return d.layout(w, h, em);
+    }
+    0
+}
+
+/// Count chapters (spine items).
+#[unsafe(no_mangle)]
+pub extern "C" fn epub_count_chapters(_ctx: ContextHandle, doc: Handle) -> i32 {
+    epub_spine_count(_ctx, doc)
+}
+
+/// Count pages of a chapter in the current layout.
+#[unsafe(no_mangle)]
+pub extern "C" fn epub_count_chapter_pages(_ctx: ContextHandle, doc: Handle, chapter: i32) -> i32 {
+    if let Some(d) = EPUB_DOCUMENTS.get(doc) {
+        let d = d.lock().unwrap();
+        return usize::try_from(chapter).map_or(0, |c| d.count_chapter_pages(c));
+    }
+    0
+}
+
+/// Count pages in the current layout.
+#[unsafe(no_mangle)]
+pub extern "C" fn epub_count_pages(_ctx: ContextHandle, doc: Handle) -> i32 {
+    if let Some(d) = EPUB_DOCUMENTS.get(doc) {
+        let d = d.lock().unwrap();
+        return d.count_pages();
+    }
+    0
+}
+
+/// Get the page number of a chapter page, or -1.
+#[unsafe(no_mangle)]
+pub extern "C" fn epub_page_number_from_location(
+    _ctx: ContextHandle,
+    doc: Handle,
+    chapter: i32,
+    page: i32,
+) -> i32 {
+    if let Some(d) = EPUB_DOCUMENTS.get(doc) {
+        let d = d.lock().unwrap();
+        return usize::try_from(chapter).map_or(-1, |c| d.page_number_from_location(c, page));
+    }
+    -1
+}
+
 // ============================================================================
 // FFI Functions - Navigation (TOC)
 // ============================================================================
@@ -962,6 +1269,93 @@ mod tests {
         assert!(doc.get_manifest_item("chapter1").is_some());
     }
 
+    #[test]
+    fn test_wrapped_lines() {
+        assert_eq!(wrapped_lines("", 10), 0);
+        assert_eq!(wrapped_lines("one two three", 10), 2);
+        assert_eq!(wrapped_lines("abcdefghijklmnopqrstuvwxy", 10), 3);
+    }
+
+    #[test]
+    fn test_chapter_paragraphs() {
+        let xhtml = "<?xml version=\"1.0\"?><!DOCTYPE html>\
+                     <html><head><title>T</title><style>p {}</style></head>\
+                     <body><h1>Title</h1><p>One  <i>two</i>\n three &amp; four</p>\
+                     <p/>tail<br/>end</body></html>";
+        assert_eq!(
+            chapter_paragraphs(xhtml),
+            ["Title", "One two three & four", "tail", "end"]
+        );
+    }
+
+    #[test]
+    fn test_layout_chapters() {
+        let mut doc = EpubDocument::new(0);
+        doc.root_file = "OEBPS/content.opf".to_string();
+        for i in 0..6 {
+            let id = format!("ch{i}");
+            let href = format!("Text/{id}.xhtml");
+            let body = "<p>lorem ipsum dolor sit amet</p>".repeat(20 * (i + 1));
+            doc.add_manifest_item(ManifestItem::new(&id, &href, "application/xhtml+xml"));
+            doc.add_spine_item(SpineItem::new(&id));
+            doc.add_file(
+                &format!("OEBPS/{href}"),
+                format!("<html><body>{body}</body></html>").into_bytes(),
+            );
+        }
+        doc.add_spine_item(SpineItem::new("missing"));
+
+        let total = doc.layout(300.0, 400.0, 12.0);
+        let pages: Vec<i32> = (0..7).map(|c| doc.count_chapter_pages(c)).collect();
+        assert_eq!(total, pages.iter().sum::<i32>());
+        assert!(pages.windows(2).take(5).all(|w| w[0] <= w[1]));
+        assert!(pages[5] > 1);
+        assert_eq!(pages[6], 1);
+        assert_eq!(doc.page_number_from_location(1, 0), pages[0]);
+        assert_eq!(doc.page_number_from_location(0, pages[0]), -1);
+
+        // A larger font makes more pages; going back reuses the cache
+        let larger = doc.layout(300.0, 400.0, 18.0);
+        assert!(larger > total);
+        assert_eq!(doc.layouts.len(), 14);
+        assert_eq!(doc.layout(300.0, 400.0, 12.0), total);
+        assert_eq!(doc.layouts.len(), 14);
+
+        for em in [8.0, 9.0, 10.0, 11.0] {
+            doc.layout(300.0, 400.0, em);
+        }
+        assert_eq!(doc.layouts.len(), 7 * LAYOUT_CACHE_SIZES);
+
+        // New content drops the cache
+        let longer = "<p>lorem ipsum dolor sit amet</p>".repeat(200);
+        doc.add_file("OEBPS/Text/ch0.xhtml", longer.into_bytes());
+        assert!(doc.layouts.is_empty());
+        assert_eq!(doc.count_pages(), 0);
+        assert!(doc.layout(300.0, 400.0, 12.0) > total);
+    }
+
+    #[test]
+    fn test_ffi_layout() {
+        let ctx = 0;
+        let doc = epub_new_document(ctx);
+        let id = CString::new("c1").unwrap();
+        let href = CString::new("c1.xhtml").unwrap();
+        let media = CString::new("application/xhtml+xml").unwrap();
+        epub_add_manifest_item(ctx, doc, id.as_ptr(), href.as_ptr(), media.as_ptr());
+        epub_add_spine_item(ctx, doc, id.as_ptr(), 1);
+        let body = b"<p>text</p>";
+        epub_add_file(ctx, doc, href.as_ptr(), body.as_ptr(), body.len());
+
+        assert_eq!(epub_count_chapters(ctx, doc), 1);
+        assert_eq!(epub_layout(ctx, doc, 400.0, 600.0, 12.0), 1);
+        assert_eq!(epub_count_pages(ctx, doc), 1);
+        assert_eq!(epub_count_chapter_pages(ctx, doc, 0), 1);
+        assert_eq!(epub_count_chapter_pages(ctx, doc, -1), 0);
+        assert_eq!(epub_page_number_from_location(ctx, doc, 0, 0), 0);
+
+        epub_drop_document(ctx, doc);
+    }
+
     #[test]
     fn test_ffi_document() {
         let ctx = 0;
@@ -3,8 +3,10 @@
 //! This module provides C-compatible exports for stream filter operations.
 //! Filters are used for decoding/decrypting PDF stream data.
 
+use super::predict;
 use super::{Handle, HandleStore};
-use std::sync::LazyLock;
+use crate::pdf::filter::Jbig2Dictionaries;
+use std::sync::{Arc, LazyLock};
 
 // ============================================================================
 // Types and Constants
@@ -79,7 +81,8 @@ pub struct FilterParams {
     // Range filter
     pub ranges: Vec<FzRange>,
 
-    // Encryption
+    // Encryption; on a Flate filter, the AES key of a decryption fused
+    // into the inflate
     pub key: Vec<u8>,
 
     // DCT (JPEG)
@@ -117,6 +120,9 @@ pub struct FilterParams {
     pub globals: Option<Handle>,
     pub embedded: bool,
 
+    // Brotli; the registered shared dictionary of DecodeParms /DictID
+    pub dictionary: Option<u64>,
+
     // Concat
     pub max_streams: i32,
     pub pad: bool,
@@ -161,6 +167,9 @@ impl FilterStream {
             FilterType::Arc4 => self.decode_arc4(),
             FilterType::Aesd => self.decode_aesd(),
             FilterType::Predict => self.decode_predict(),
+            FilterType::Fax => self.decode_fax(),
+            FilterType::Jbig2 => self.decode_jbig2(),
+            FilterType::Brotli => self.decode_brotli(),
             _ => {
                 // For filters we don't implement yet, just pass through
                 self.decoded = self.data.clone();
@@ -308,45 +317,72 @@ impl FilterStream {
         Ok(())
     }
 
+    /// CCITT fax decode
+    fn decode_fax(&mut self) -> Result<(), &'static str> {
+        use crate::pdf::filter::{CCITTFaxDecodeParams, decode_ccitt_fax};
+
+        let p = &self.params;
+        let params = CCITTFaxDecodeParams {
+            k: p.k,
+            end_of_line: p.end_of_line,
+            encoded_byte_align: p.encoded_byte_align,
+            columns: p.columns,
+            rows: p.rows,
+            end_of_block: p.end_of_block,
+            black_is_1: p.black_is_1,
+            damaged_rows_before_error: 0,
+        };
+        self.decoded =
+            decode_ccitt_fax(&self.data, &params).map_err(|_| "CCITT fax decode failed")?;
+        Ok(())
+    }
+
+    /// JBIG2 decode, against the symbol dictionaries of its globals
+    fn decode_jbig2(&mut self) -> Result<(), &'static str> {
+        use crate::pdf::filter::decode_jbig2_with;
+
+        let dictionaries = self.params.globals.map(jbig2_dictionaries).transpose()?;
+        self.decoded = decode_jbig2_with(&self.data, dictionaries.as_deref(), self.params.embedded)
+            .map_err(|_| "JBIG2 decode failed")?;
+        Ok(())
+    }
+
+    /// Brotli decode
+    fn decode_brotli(&mut self) -> Result<(), &'static str> {
+        let params = crate::pdf::filter::BrotliDecodeParams {
+            dictionary: self.params.dictionary,
+        };
+        self.decoded = crate::pdf::filter::decode_brotli(&self.data, Some(&params))
+            .map_err(|_| "Brotli decode failed")?;
+        Ok(())
+    }
+
     /// Flate (zlib) decode
     fn decode_flate(&mut self) -> Result<(), &'static str> {
-        use flate2::read::ZlibDecoder;
-        use std::io::Read;
+        use crate::pdf::filter::{decrypt_inflate, inflate};
 
         if self.data.is_empty() {
             self.decoded = Vec::new();
             return Ok(());
         }
 
-        // Check if we need raw deflate (negative window_bits)
-        if self.params.window_bits < 0 {
-            // Raw deflate without header
-            use flate2::read::DeflateDecoder;
-            let mut decoder = DeflateDecoder::new(&self.data[..]);
-            let mut output = Vec::new();
-            if decoder.read_to_end(&mut output).is_ok() {
-                self.decoded = output;
+        // Negative window_bits means raw deflate without header; zlib data
+        // that won't inflate is retried as raw deflate. With a key, the
+        // data is still AES encrypted and is decrypted as it inflates.
+        let key = &self.params.key;
+        let run = |zlib| {
+            if key.is_empty() {
+                inflate(&self.data, zlib, 0)
             } else {
-                self.decoded = Vec::new();
+                decrypt_inflate(key, &self.data, zlib, 0)
             }
+        };
+        let output = if self.params.window_bits < 0 {
+            run(false)
         } else {
-            // Zlib with header
-            let mut decoder = ZlibDecoder::new(&self.data[..]);
-            let mut output = Vec::new();
-            if decoder.read_to_end(&mut output).is_ok() {
-                self.decoded = output;
-            } else {
-                // Try raw deflate as fallback
-                use flate2::read::DeflateDecoder;
-                let mut decoder = DeflateDecoder::new(&self.data[..]);
-                let mut fallback = Vec::new();
-                if decoder.read_to_end(&mut fallback).is_ok() {
-                    self.decoded = fallback;
-                } else {
-                    self.decoded = Vec::new();
-                }
-            }
-        }
+            run(true).or_else(|_| run(false))
+        };
+        self.decoded = output.unwrap_or_default();
 
         Ok(())
     }
@@ -495,11 +531,10 @@ impl FilterStream {
         Ok(())
     }
 
-    /// AES decode (simplified - assumes CBC mode with IV in first 16 bytes)
+    /// AES-CBC decode: a 16-byte IV, then PKCS#7 padded ciphertext
     fn decode_aesd(&mut self) -> Result<(), &'static str> {
-        // AES decryption is complex - for now, just pass through
-        // A full implementation would use a proper AES library
-        self.decoded = self.data.clone();
+        self.decoded = crate::pdf::filter::aes_decrypt(&self.params.key, &self.data)
+            .map_err(|_| "AES key must be 16 or 32 bytes")?;
         Ok(())
     }
 
@@ -522,7 +557,7 @@ impl FilterStream {
 
         if predictor == 2 {
             // TIFF predictor
-            self.decode_tiff_predictor(row_bytes, bytes_per_pixel)
+            self.decode_tiff_predictor(row_bytes, colors, bpc)
         } else {
             // PNG predictor (10-15)
             self.decode_png_predictor(row_bytes, bytes_per_pixel)
@@ -532,21 +567,12 @@ impl FilterStream {
     fn decode_tiff_predictor(
         &mut self,
         row_bytes: usize,
-        bytes_per_pixel: usize,
+        colors: usize,
+        bpc: usize,
     ) -> Result<(), &'static str> {
-        let mut output = Vec::with_capacity(self.data.len());
-
-        for row in self.data.chunks(row_bytes) {
-            let mut prev = vec![0u8; bytes_per_pixel];
-            for pixel in row.chunks(bytes_per_pixel) {
-                for (i, &byte) in pixel.iter().enumerate() {
-                    let decoded = byte.wrapping_add(prev.get(i).copied().unwrap_or(0));
-                    output.push(decoded);
-                    if i < prev.len() {
-                        prev[i] = decoded;
-                    }
-                }
-            }
+        let mut output = self.data.clone();
+        for row in output.chunks_mut(row_bytes) {
+            predict::untiff_row(row, colors, bpc);
         }
 
         self.decoded = output;
@@ -558,48 +584,26 @@ impl FilterStream {
         row_bytes: usize,
         bytes_per_pixel: usize,
     ) -> Result<(), &'static str> {
-        let mut output = Vec::new();
-        let mut prev_row = vec![0u8; row_bytes];
+        let mut output = Vec::with_capacity(self.data.len());
+        let zeros = vec![0u8; row_bytes];
 
-        // Each row has a filter byte prefix
+        // Each row has a filter byte prefix; rows decode in place in the
+        // output, against the row decoded before
         let stride = row_bytes + 1;
 
         for row in self.data.chunks(stride) {
-            if row.is_empty() {
-                continue;
-            }
-
-            let filter = row[0];
-            let row_data = if row.len() > 1 { &row[1..] } else { &[] };
-
-            let mut current_row = Vec::with_capacity(row_bytes);
-
-            for (i, &byte) in row_data.iter().enumerate() {
-                let a = if i >= bytes_per_pixel {
-                    current_row[i - bytes_per_pixel]
-                } else {
-                    0
-                };
-                let b = prev_row.get(i).copied().unwrap_or(0);
-                let c = if i >= bytes_per_pixel {
-                    prev_row.get(i - bytes_per_pixel).copied().unwrap_or(0)
-                } else {
-                    0
-                };
-
-                let decoded = match filter {
-                    0 => byte,                                                 // None
-                    1 => byte.wrapping_add(a),                                 // Sub
-                    2 => byte.wrapping_add(b),                                 // Up
-                    3 => byte.wrapping_add(((a as u16 + b as u16) / 2) as u8), // Average
-                    4 => byte.wrapping_add(paeth_predictor(a, b, c)),          // Paeth
-                    _ => byte,
-                };
-                current_row.push(decoded);
+            let start = output.len();
+            output.extend_from_slice(&row[1..]);
+            let (done, current) = output.split_at_mut(start);
+            let prior = if start == 0 {
+                &zeros[..]
+            } else {
+                &done[start - row_bytes..]
+            };
+            // Unknown filter types leave the row as it is
+            if let Some(filter) = predict::filter_from_byte(row[0]) {
+                predict::unfilter_row(filter, current, prior, bytes_per_pixel);
             }
-
-            output.extend_from_slice(&current_row);
-            prev_row = current_row;
         }
 
         self.decoded = output;
@@ -624,22 +628,6 @@ impl FilterStream {
     }
 }
 
-/// PNG Paeth predictor function
-fn paeth_predictor(a: u8, b: u8, c: u8) -> u8 {
-    let p = a as i32 + b as i32 - c as i32;
-    let pa = (p - a as i32).abs();
-    let pb = (p - b as i32).abs();
-    let pc = (p - c as i32).abs();
-
-    if pa <= pb && pa <= pc {
-        a
-    } else if pb <= pc {
-        b
-    } else {
-        c
-    }
-}
-
 // ============================================================================
 // JBIG2 Globals
 // ============================================================================
@@ -649,10 +637,26 @@ fn paeth_predictor(a: u8, b: u8, c: u8) -> u8 {
 pub struct Jbig2Globals {
     pub refs: i32,
     pub data: Vec<u8>,
+    /// Symbol dictionaries decoded from `data`, on first use
+    pub dictionaries: Option<Arc<Jbig2Dictionaries>>,
 }
 
 pub static JBIG2_GLOBALS: LazyLock<HandleStore<Jbig2Globals>> = LazyLock::new(HandleStore::new);
 
+/// The symbol dictionaries of a globals handle, decoded the first time
+/// any stream asks and shared by all of them after
+fn jbig2_dictionaries(globals: Handle) -> Result<Arc<Jbig2Dictionaries>, &'static str> {
+    let arc = JBIG2_GLOBALS.get(globals).ok_or("invalid JBIG2 globals")?;
+    let mut globals = arc.lock().map_err(|_| "JBIG2 globals lock poisoned")?;
+    if let Some(dictionaries) = &globals.dictionaries {
+        return Ok(Arc::clone(dictionaries));
+    }
+    let dictionaries =
+        Arc::new(Jbig2Dictionaries::parse(&globals.data).map_err(|_| "invalid JBIG2 globals")?);
+    globals.dictionaries = Some(Arc::clone(&dictionaries));
+    Ok(dictionaries)
+}
+
 // ============================================================================
 // Handle Store
 // ============================================================================
@@ -914,11 +918,17 @@ pub extern "C" fn fz_open_flated(_ctx: Handle, chain: Handle, window_bits: i32)
     let mut filter = FilterStream::new(FilterType::Flate);
     filter.params.window_bits = window_bits;
 
-    // Get data from chain
+    // Get data from chain; an AES filter not yet read is taken over, so
+    // its data is decrypted as it inflates rather than into a buffer
     if let Some(arc) = FILTER_STREAMS.get(chain) {
         if let Ok(mut source) = arc.lock() {
-            let _ = source.decode();
-            filter.data = source.decoded.clone();
+            if source.filter_type == FilterType::Aesd && !source.decoded_complete {
+                filter.data = source.data.clone();
+                filter.params.key = source.params.key.clone();
+            } else {
+                let _ = source.decode();
+                filter.data = source.decoded.clone();
+            }
         }
     }
 
@@ -944,7 +954,22 @@ pub extern "C" fn fz_open_libarchived(_ctx: Handle, chain: Handle) -> Handle {
 /// Create a Brotli decode filter
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_open_brotlid(_ctx: Handle, chain: Handle) -> Handle {
+    fz_open_brotlid_dictionary(_ctx, chain, 0)
+}
+
+/// Create a Brotli decode filter for a stream compressed against a
+/// shared dictionary
+///
+/// `dictionary` is the id from `fz_register_brotli_dictionary` that the
+/// stream's DecodeParms /DictID names, or 0 for none.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_open_brotlid_dictionary(
+    _ctx: Handle,
+    chain: Handle,
+    dictionary: u64,
+) -> Handle {
     let mut filter = FilterStream::new(FilterType::Brotli);
+    filter.params.dictionary = (dictionary != 0).then_some(dictionary);
 
     // Get data from chain
     if let Some(arc) = FILTER_STREAMS.get(chain) {
@@ -1040,6 +1065,7 @@ pub extern "C" fn fz_load_jbig2_globals(_ctx: Handle, buf: Handle) -> Handle {
     let mut globals = Jbig2Globals {
         refs: 1,
         data: Vec::new(),
+        dictionaries: None,
     };
 
     // Get data from buffer
@@ -1263,6 +1289,66 @@ mod tests {
         assert!(!filter.decoded.is_empty());
     }
 
+    #[test]
+    fn test_aesd_into_flated() {
+        use crate::pdf::filter::{aes_encrypt, encode_flate};
+
+        let ctx = 0;
+        let key = [5u8; 16];
+        let plain = b"q 1 0 0 1 0 0 cm /Im0 Do Q\n".repeat(200);
+        let compressed = encode_flate(&plain, 6).unwrap();
+        let encrypted = aes_encrypt(&key, &[1u8; 16], &compressed).unwrap();
+
+        let mut source = FilterStream::new(FilterType::Null);
+        source.decoded = encrypted.clone();
+        source.decoded_complete = true;
+        let source = FILTER_STREAMS.insert(source);
+
+        let aesd = fz_open_aesd(ctx, source, key.as_ptr(), key.len() as u32);
+        assert_eq!(fz_filter_size(ctx, aesd), compressed.len());
+        let aesd = fz_open_aesd(ctx, source, key.as_ptr(), key.len() as u32);
+        let flated = fz_open_flated(ctx, aesd, 15);
+        let arc = FILTER_STREAMS.get(flated).unwrap();
+        let mut flated = arc.lock().unwrap();
+        assert_eq!(flated.data, encrypted);
+        flated.decode().unwrap();
+        assert_eq!(flated.decoded, plain);
+    }
+
+    #[test]
+    fn test_brotlid_dictionary() {
+        use crate::pdf::filter::{encode_brotli, register_brotli_dictionary};
+
+        let ctx = 0;
+        let dictionary = b"BT /F1 12 Tf 72 712 Td (shared dictionary) Tj ET\n";
+        let id = register_brotli_dictionary(dictionary);
+        let plain = dictionary.repeat(3);
+        let compressed = encode_brotli(&plain, 6, Some(dictionary)).unwrap();
+
+        let mut source = FilterStream::new(FilterType::Null);
+        source.decoded = compressed;
+        source.decoded_complete = true;
+        let source = FILTER_STREAMS.insert(source);
+
+        let brotlid = fz_open_brotlid_dictionary(ctx, source, id);
+        let arc = FILTER_STREAMS.get(brotlid).unwrap();
+        let mut brotlid = arc.lock().unwrap();
+        assert_eq!(brotlid.params.dictionary, Some(id));
+        brotlid.decode().unwrap();
+        assert_eq!(brotlid.decoded, plain);
+
+        assert_eq!(
+            FILTER_STREAMS
+                .get(fz_open_brotlid(ctx, source))
+                .unwrap()
+                .lock()
+                .unwrap()
+                .params
+                .dictionary,
+            None
+        );
+    }
+
     #[test]
     fn test_null_filter() {
         let ctx = 0;
@@ -1335,6 +1421,52 @@ mod tests {
         assert_eq!(filter.decoded, b"Hello");
     }
 
+    #[test]
+    fn test_predict_png_rows() {
+        use crate::ffi::png_encode::{FILTERS, predict};
+
+        // RGB rows cycling through every filter type
+        let (columns, height, bpp) = (21, 12, 3);
+        let row_bytes = columns * bpp;
+        let image: Vec<u8> = (0..row_bytes * height)
+            .map(|i| ((i * 7) ^ (i / 5)) as u8)
+            .collect();
+        let mut encoded = Vec::new();
+        for y in 0..height {
+            let filter = FILTERS[y % 5];
+            encoded.push(filter as u8);
+            for x in 0..row_bytes {
+                let at = |dy: usize, dx: usize| match (y.checked_sub(dy), x.checked_sub(dx)) {
+                    (Some(y), Some(x)) => image[y * row_bytes + x],
+                    _ => 0,
+                };
+                let pred = predict(filter, at(0, bpp), at(1, 0), at(1, bpp));
+                encoded.push(image[y * row_bytes + x].wrapping_sub(pred));
+            }
+        }
+
+        let mut filter = FilterStream::new(FilterType::Predict);
+        filter.params.predictor = 15;
+        filter.params.columns = columns as i32;
+        filter.params.colors = 3;
+        filter.params.bpc = 8;
+        filter.data = encoded;
+        filter.decode().unwrap();
+        assert_eq!(filter.decoded, image);
+    }
+
+    #[test]
+    fn test_fax_decode() {
+        // Group 4: a white row, V0; then H with white 4 and black 4, V0
+        let mut filter = FilterStream::new(FilterType::Fax);
+        filter.params.k = -1;
+        filter.params.columns = 16;
+        filter.params.rows = 2;
+        filter.data = vec![0x9b, 0x70];
+        filter.decode().unwrap();
+        assert_eq!(filter.decoded, [0xff, 0xff, 0xf0, 0xff]);
+    }
+
     #[test]
     fn test_jbig2_globals() {
         let ctx = 0;
@@ -3,11 +3,13 @@
 //! Provides FFI bindings for font loading and glyph operations.
 
 use super::{Handle, HandleStore, safe_helpers};
+use crate::fitz::counters::Counter;
 use crate::fitz::font::Font;
 use std::sync::LazyLock;
 
 /// Font storage
-pub static FONTS: LazyLock<HandleStore<Font>> = LazyLock::new(HandleStore::default);
+pub static FONTS: LazyLock<HandleStore<Font>> =
+    LazyLock::new(|| HandleStore::with_lookup_counter(Counter::FontLookups));
 
 /// Create a new font
 ///
@@ -49,14 +51,12 @@ pub extern "C" fn fz_new_font_from_memory(
 
     let font_name = safe_helpers::c_str_to_str(name).unwrap_or("Unknown");
 
-    // Read font data
-    let font_data = match safe_helpers::copy_from_ptr(data, len as usize) {
-        Some(data) => data,
-        None => return 0,
-    };
+    // SAFETY: the caller guarantees `len` readable bytes at `data`. The
+    // face cache copies them only if no font with this data is loaded yet.
+    let font_data = unsafe { std::slice::from_raw_parts(data, len as usize) };
 
     // Create font from data
-    let font = Font::from_data(font_name, &font_data, index as usize);
+    let font = Font::from_data(font_name, font_data, index.max(0) as usize);
     match font {
         Ok(f) => FONTS.insert(f),
         Err(_) => 0,
@@ -84,7 +84,7 @@ pub extern "C" fn fz_new_font_from_file(
 
     // Read font file
     match std::fs::read(path_str) {
-        Ok(data) => match Font::from_data(font_name, &data, index as usize) {
+        Ok(data) => match Font::from_data(font_name, &data, index.max(0) as usize) {
             Ok(f) => FONTS.insert(f),
             Err(_) => 0,
         },
@@ -101,7 +101,9 @@ pub extern "C" fn fz_keep_font(_ctx: Handle, font: Handle) -> Handle {
 /// Drop font reference
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_drop_font(_ctx: Handle, font: Handle) {
-    let _ = FONTS.remove(font);
+    if FONTS.remove(font).is_some() {
+        super::text::fz_purge_shaped_text_cache(_ctx, font);
+    }
 }
 
 /// Get font name
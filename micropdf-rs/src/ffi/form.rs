@@ -4,8 +4,9 @@
 
 use super::{Handle, HandleStore};
 use crate::pdf::form::{ChoiceOption, FieldFlags, Form, FormField, TextFormat, WidgetType};
+use std::collections::HashMap;
 use std::ffi::{CStr, c_char};
-use std::sync::LazyLock;
+use std::sync::{LazyLock, Mutex};
 
 /// Form storage
 pub static FORMS: LazyLock<HandleStore<Form>> = LazyLock::new(HandleStore::default);
@@ -13,16 +14,29 @@ pub static FORMS: LazyLock<HandleStore<Form>> = LazyLock::new(HandleStore::defau
 /// Form field storage (widgets)
 pub static FORM_FIELDS: LazyLock<HandleStore<FormField>> = LazyLock::new(HandleStore::default);
 
+/// The document each form was opened on, for fields the form model
+/// doesn't hold yet
+static FORM_DOCUMENTS: LazyLock<Mutex<HashMap<Handle, Handle>>> =
+    LazyLock::new(|| Mutex::new(HashMap::new()));
+
+/// Where each page's widget iteration last stopped: the widget returned
+/// and its position, so stepping to the next one needn't search
+static WIDGET_CURSORS: LazyLock<Mutex<HashMap<Handle, (Handle, usize)>>> =
+    LazyLock::new(|| Mutex::new(HashMap::new()));
+
 // ============================================================================
 // Form Access
 // ============================================================================
 
 /// Get form from document
 #[unsafe(no_mangle)]
-pub extern "C" fn pdf_form(_ctx: Handle, _doc: Handle) -> Handle {
+pub extern "C" fn pdf_form(_ctx: Handle, doc: Handle) -> Handle {
     // Create or return existing form
-    let form = Form::new();
-    FORMS.insert(form)
+    let form = FORMS.insert(Form::new());
+    if doc != 0 {
+        FORM_DOCUMENTS.lock().unwrap().insert(form, doc);
+    }
+    form
 }
 
 /// Keep form reference
@@ -38,6 +52,7 @@ pub extern "C" fn pdf_keep_form(_ctx: Handle, form: Handle) -> Handle {
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_drop_form(_ctx: Handle, form: Handle) {
     FORMS.remove(form);
+    FORM_DOCUMENTS.lock().unwrap().remove(&form);
 }
 
 // ============================================================================
@@ -49,7 +64,11 @@ pub extern "C" fn pdf_drop_form(_ctx: Handle, form: Handle) {
 pub extern "C" fn pdf_first_widget(_ctx: Handle, page: Handle) -> Handle {
     if let Some(p) = super::document::PAGES.get(page) {
         if let Ok(guard) = p.lock() {
-            return guard.first_widget().unwrap_or(0);
+            let first = guard.first_widget().unwrap_or(0);
+            if first != 0 {
+                WIDGET_CURSORS.lock().unwrap().insert(page, (first, 0));
+            }
+            return first;
         }
     }
     0
@@ -58,15 +77,34 @@ pub extern "C" fn pdf_first_widget(_ctx: Handle, page: Handle) -> Handle {
 /// Get next widget
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_next_widget(_ctx: Handle, widget: Handle) -> Handle {
+    if FORM_FIELDS.get(widget).is_none() {
+        return 0;
+    }
+
+    // Step on from where an iteration stopped, if the page hasn't changed
+    let cursor = WIDGET_CURSORS
+        .lock()
+        .unwrap()
+        .iter()
+        .find(|(_, (w, _))| *w == widget)
+        .map(|(&page, &(_, pos))| (page, pos));
+    if let Some((page, pos)) = cursor {
+        if let Some(p) = super::document::PAGES.get(page) {
+            if let Ok(guard) = p.lock() {
+                if guard.widgets.get(pos) == Some(&widget) {
+                    return step_widget(page, &guard.widgets, pos);
+                }
+            }
+        }
+    }
+
     // Find the page this widget belongs to by searching all loaded pages
-    if FORM_FIELDS.get(widget).is_some() {
-        for page_handle in 1..10000 {
-            // Reasonable page limit
-            if let Some(p) = super::document::PAGES.get(page_handle) {
-                if let Ok(guard) = p.lock() {
-                    if guard.widgets.contains(&widget) {
-                        return guard.next_widget(widget).unwrap_or(0);
-                    }
+    for page_handle in 1..10000 {
+        // Reasonable page limit
+        if let Some(p) = super::document::PAGES.get(page_handle) {
+            if let Ok(guard) = p.lock() {
+                if let Some(pos) = guard.widgets.iter().position(|&h| h == widget) {
+                    return step_widget(page_handle, &guard.widgets, pos);
                 }
             }
         }
@@ -74,6 +112,21 @@ pub extern "C" fn pdf_next_widget(_ctx: Handle, widget: Handle) -> Handle {
     0
 }
 
+/// The widget after position `pos` of `page`, with the cursor moved on
+fn step_widget(page: Handle, widgets: &[Handle], pos: usize) -> Handle {
+    let mut cursors = WIDGET_CURSORS.lock().unwrap();
+    match widgets.get(pos + 1) {
+        Some(&next) => {
+            cursors.insert(page, (next, pos + 1));
+            next
+        }
+        None => {
+            cursors.remove(&page);
+            0
+        }
+    }
+}
+
 // ============================================================================
 // Field Creation
 // ============================================================================
@@ -654,6 +707,14 @@ pub extern "C" fn pdf_lookup_field(
                 if let Some(field) = guard.get_field(field_name) {
                     return FORM_FIELDS.insert(field.clone());
                 }
+
+                // Fields of the document the form was opened on, through
+                // its name index
+                let doc = FORM_DOCUMENTS.lock().unwrap().get(&form).copied();
+                if let Some(field) = doc.and_then(|d| super::pdf_form_index::lookup(d, field_name))
+                {
+                    return FORM_FIELDS.insert(field);
+                }
             }
         }
     }
@@ -661,6 +722,58 @@ pub extern "C" fn pdf_lookup_field(
     0
 }
 
+/// Fill fields of a document by full name, in one pass
+///
+/// Sets field `names[i]` to `values[i]` for each of `count` pairs, runs
+/// the form's calculations once and regenerates the appearance of every
+/// changed text and choice widget in parallel, then writes the document
+/// once. Names that match no field are skipped. Returns the number of
+/// fields set, or -1 if the document can't be read.
+///
+/// # Safety
+/// Caller must ensure `names` and `values` each hold `count` valid C
+/// strings
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_fill_form(
+    _ctx: Handle,
+    doc: Handle,
+    names: *const *const c_char,
+    values: *const *const c_char,
+    count: i32,
+) -> i32 {
+    if names.is_null() || values.is_null() || count <= 0 {
+        return 0;
+    }
+    // SAFETY: caller guarantees both arrays hold `count` pointers
+    let (names, values) = unsafe {
+        (
+            std::slice::from_raw_parts(names, count as usize),
+            std::slice::from_raw_parts(values, count as usize),
+        )
+    };
+    let pairs: Vec<(String, String)> = names
+        .iter()
+        .zip(values)
+        .filter_map(|(&name, &value)| {
+            let name = super::safe_helpers::c_str_to_str(name)?;
+            let value = super::safe_helpers::c_str_to_str(value)?;
+            Some((name.to_string(), value.to_string()))
+        })
+        .collect();
+    super::pdf_form_fill::fill_form(doc, &pairs, 0)
+}
+
+/// Flatten the form of a document into its pages
+///
+/// Draws the normal appearance of every visible widget into its page's
+/// content, drawing equal appearance streams through one XObject, then
+/// drops the widgets and the interactive form. Returns the number of
+/// widgets drawn, or -1 if the document can't be read.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_flatten_form(_ctx: Handle, doc: Handle) -> i32 {
+    super::pdf_form_flatten::flatten_form(doc, 0)
+}
+
 /// Reset form to default values
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_reset_form(_ctx: Handle, form: Handle) {
@@ -684,8 +797,15 @@ pub extern "C" fn pdf_validate_form(_ctx: Handle, form: Handle) -> i32 {
 
 /// Delete a form field
 #[unsafe(no_mangle)]
-pub extern "C" fn pdf_delete_field(_ctx: Handle, _form: Handle, field: Handle) -> i32 {
-    FORM_FIELDS.remove(field);
+pub extern "C" fn pdf_delete_field(_ctx: Handle, form: Handle, field: Handle) -> i32 {
+    if let Some(removed) = FORM_FIELDS.remove(field) {
+        if let (Some(f), Ok(removed)) = (FORMS.get(form), removed.lock()) {
+            if let Ok(mut guard) = f.lock() {
+                guard.remove_field(removed.name());
+            }
+        }
+    }
+    super::pdf_form_index::invalidate();
     1
 }
 
@@ -968,6 +1088,7 @@ pub extern "C" fn pdf_clone_field(_ctx: Handle, field: Handle) -> Handle {
     if let Some(f) = FORM_FIELDS.get(field) {
         if let Ok(guard) = f.lock() {
             let cloned = guard.clone();
+            super::pdf_form_index::invalidate();
             return FORM_FIELDS.insert(cloned);
         }
     }
@@ -1064,4 +1185,46 @@ mod tests {
 
         pdf_drop_form(0, form);
     }
+
+    #[test]
+    fn test_lookup_document_field() {
+        let data = crate::ffi::pdf_form_fill::tests::form();
+        let doc = super::super::DOCUMENTS.insert(crate::ffi::document::Document::new(data));
+        let form = pdf_form(0, doc);
+
+        let name = CString::new("qty").unwrap();
+        let field = pdf_lookup_field(0, form, name.as_ptr());
+        assert_ne!(field, 0);
+        assert_eq!(pdf_field_type(0, field), 6); // Text field
+        let missing = CString::new("nope").unwrap();
+        assert_eq!(pdf_lookup_field(0, form, missing.as_ptr()), 0);
+
+        FORM_FIELDS.remove(field);
+        pdf_drop_form(0, form);
+        super::super::DOCUMENTS.remove(doc);
+    }
+
+    #[test]
+    fn test_widget_iteration() {
+        let name = CString::new("w").unwrap();
+        let widgets: Vec<Handle> = (0..3)
+            .map(|_| pdf_create_text_field(0, 0, name.as_ptr(), 0.0, 0.0, 10.0, 10.0, 0))
+            .collect();
+        let mut page = crate::ffi::document::Page::new(0, 0);
+        for &w in &widgets {
+            page.add_widget(w);
+        }
+        let page = crate::ffi::document::PAGES.insert(page);
+
+        let mut seen = vec![pdf_first_widget(0, page)];
+        while let Some(&last) = seen.last().filter(|&&w| w != 0) {
+            seen.push(pdf_next_widget(0, last));
+        }
+        assert_eq!(seen, [widgets[0], widgets[1], widgets[2], 0]);
+
+        crate::ffi::document::PAGES.remove(page);
+        for w in widgets {
+            FORM_FIELDS.remove(w);
+        }
+    }
 }
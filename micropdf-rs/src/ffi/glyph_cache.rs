@@ -2,14 +2,35 @@
 //!
 //! This module provides glyph caching with statistics, eviction policies,
 //! and subpixel positioning support.
+//!
+//! The process-wide cache is split into shards, each behind its own lock,
+//! so render threads looking up different glyphs do not contend. Glyphs are
+//! keyed by font, glyph id, the linear part of the transform and the
+//! subpixel offset, never by the integer pen position. Statistics are kept
+//! per shard and only summed when asked for. Font handles are process-wide,
+//! so every context, including those made by fz_clone_context, shares the
+//! one cache.
+//!
+//! In atlas mode, rendered glyph bitmaps are copied into per-font slabs of
+//! page-aligned memory with shelf packing, instead of one pixmap handle per
+//! glyph, so the glyphs of a run sit next to each other in memory.
 
 use std::collections::HashMap;
-use std::sync::{LazyLock, Mutex};
+use std::collections::hash_map::DefaultHasher;
+use std::ffi::c_int;
+use std::hash::{Hash, Hasher};
+use std::sync::atomic::{AtomicBool, AtomicI32, AtomicU64, AtomicUsize, Ordering};
+use std::sync::{Arc, LazyLock, Mutex};
 use std::time::Instant;
 
 use crate::ffi::colorspace::FZ_COLORSPACE_GRAY;
+use crate::ffi::data_locality::{
+    PAGE_BUFFERS, PageAlignedBuffer, fz_drop_page_aligned_buffer, fz_new_page_aligned_buffer,
+};
 use crate::ffi::glyph::{GLYPHS, Glyph};
 use crate::ffi::{Handle, PIXMAPS};
+use crate::fitz::alloc_sampler::{self, Subsystem};
+use crate::fitz::counters::{self, Counter};
 use crate::fitz::geometry::{IRect, Matrix};
 
 // ============================================================================
@@ -25,6 +46,15 @@ pub const DEFAULT_MAX_GLYPHS: usize = 4096;
 /// Subpixel quantization levels
 pub const SUBPIXEL_LEVELS: u8 = 4;
 
+/// Number of independently locked cache shards (power of 2)
+pub const GLYPH_CACHE_SHARDS: usize = 16;
+
+/// Bytes per row of an atlas slab
+pub const ATLAS_SLAB_STRIDE: usize = 512;
+
+/// Rows per atlas slab (a slab is 256 KB, a whole number of pages)
+pub const ATLAS_SLAB_ROWS: usize = 512;
+
 /// Cache eviction policy
 #[repr(C)]
 #[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
@@ -63,8 +93,11 @@ pub struct GlyphCacheKey {
     pub font: Handle,
     /// Glyph ID
     pub glyph_id: u32,
-    /// Quantized matrix components (scaled to integers for hashing)
-    pub matrix_key: [i32; 6],
+    /// Quantized linear matrix components (scaled to integers for hashing)
+    ///
+    /// Translation is left out; its fractional part is carried by the
+    /// subpixel fields, so the same glyph is shared across pen positions.
+    pub matrix_key: [i32; 4],
     /// Subpixel position X (0-3)
     pub subpix_x: u8,
     /// Subpixel position Y (0-3)
@@ -92,8 +125,6 @@ impl GlyphCacheKey {
                 (matrix.b * scale) as i32,
                 (matrix.c * scale) as i32,
                 (matrix.d * scale) as i32,
-                (matrix.e * scale) as i32,
-                (matrix.f * scale) as i32,
             ],
             subpix_x: subpix_x % SUBPIXEL_LEVELS,
             subpix_y: subpix_y % SUBPIXEL_LEVELS,
@@ -219,11 +250,14 @@ impl GlyphCache {
         size: usize,
         glyph: Option<Handle>,
     ) {
+        // Replacing an entry must not count it twice
+        self.remove(&key);
+
         // Evict if necessary
         while self.stats.memory_usage + size > self.stats.max_memory
             || self.stats.glyph_count >= self.stats.max_glyphs
         {
-            if !self.evict_one() {
+            if self.evict_one().is_none() {
                 break; // No more entries to evict
             }
         }
@@ -243,8 +277,8 @@ impl GlyphCache {
         self.entries.insert(key, entry);
     }
 
-    /// Evict one entry based on policy
-    fn evict_one(&mut self) -> bool {
+    /// Evict one entry based on policy, returning the bytes freed
+    pub fn evict_one(&mut self) -> Option<usize> {
         let key_to_evict = match self.policy {
             CacheEvictionPolicy::Lru => self.find_lru_key(),
             CacheEvictionPolicy::Lfu => self.find_lfu_key(),
@@ -252,13 +286,9 @@ impl GlyphCache {
             CacheEvictionPolicy::Random => self.find_random_key(),
         };
 
-        if let Some(key) = key_to_evict {
-            self.remove(&key);
-            self.stats.evictions += 1;
-            true
-        } else {
-            false
-        }
+        let entry = self.remove(&key_to_evict?)?;
+        self.stats.evictions += 1;
+        Some(entry.size)
     }
 
     fn find_lru_key(&self) -> Option<GlyphCacheKey> {
@@ -331,9 +361,483 @@ impl GlyphCache {
     }
 }
 
-/// Global glyph cache instance
-pub static GLYPH_CACHE: LazyLock<Mutex<GlyphCache>> =
-    LazyLock::new(|| Mutex::new(GlyphCache::default()));
+// ============================================================================
+// Glyph Atlas
+// ============================================================================
+
+/// Location of a glyph bitmap inside an atlas slab
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct AtlasSlot {
+    /// Index of the slab in its font's slab list
+    pub slab: usize,
+    /// Byte offset of the bitmap's first column
+    pub x: usize,
+    /// First row of the bitmap
+    pub y: usize,
+    /// Width in pixels
+    pub w: usize,
+    /// Height in rows
+    pub h: usize,
+    /// Components per pixel
+    pub n: usize,
+}
+
+/// A horizontal strip of a slab holding glyphs of similar height
+#[derive(Debug, Clone, Copy)]
+struct Shelf {
+    y: usize,
+    h: usize,
+    x: usize,
+}
+
+/// One page-aligned slab, registered with the page buffer store
+struct AtlasSlab {
+    handle: Handle,
+    buffer: Arc<Mutex<PageAlignedBuffer>>,
+    shelves: Vec<Shelf>,
+    next_y: usize,
+}
+
+impl AtlasSlab {
+    fn new() -> Option<Self> {
+        alloc_sampler::record(Subsystem::GlyphCache, ATLAS_SLAB_STRIDE * ATLAS_SLAB_ROWS);
+        let handle = fz_new_page_aligned_buffer(0, ATLAS_SLAB_STRIDE * ATLAS_SLAB_ROWS);
+        let Some(buffer) = PAGE_BUFFERS.get(handle) else {
+            fz_drop_page_aligned_buffer(0, handle);
+            return None;
+        };
+        {
+            let mut guard = buffer.lock().unwrap();
+            let capacity = guard.capacity();
+            // SAFETY: The buffer is allocated zeroed, so every byte is initialized
+            unsafe { guard.set_len(capacity) };
+        }
+        Some(Self {
+            handle,
+            buffer,
+            shelves: Vec::new(),
+            next_y: 0,
+        })
+    }
+
+    /// Reserve `width` bytes by `h` rows with shelf packing
+    ///
+    /// Uses the tightest existing shelf that fits, opening a new shelf of
+    /// exactly `h` rows when none does.
+    fn allocate(&mut self, width: usize, h: usize) -> Option<(usize, usize)> {
+        let best = self
+            .shelves
+            .iter_mut()
+            .filter(|shelf| {
+                shelf.h >= h && shelf.h <= h + h / 2 && shelf.x + width <= ATLAS_SLAB_STRIDE
+            })
+            .min_by_key(|shelf| shelf.h);
+        if let Some(shelf) = best {
+            let x = shelf.x;
+            shelf.x += width;
+            return Some((x, shelf.y));
+        }
+        if self.next_y + h > ATLAS_SLAB_ROWS {
+            return None;
+        }
+        let y = self.next_y;
+        self.next_y += h;
+        self.shelves.push(Shelf { y, h, x: width });
+        Some((0, y))
+    }
+}
+
+impl Drop for AtlasSlab {
+    fn drop(&mut self) {
+        fz_drop_page_aligned_buffer(0, self.handle);
+    }
+}
+
+/// Atlas slabs and glyph slots for the fonts hashed to one shard
+///
+/// Slabs belong to a single font, so purging a font frees whole slabs
+/// rather than leaving holes in shared ones.
+#[derive(Default)]
+pub struct GlyphAtlas {
+    fonts: HashMap<Handle, Vec<AtlasSlab>>,
+    slots: HashMap<GlyphCacheKey, AtlasSlot>,
+}
+
+impl GlyphAtlas {
+    /// Copy a bitmap into the atlas
+    ///
+    /// `samples` holds `h` rows of `stride` bytes, each starting with
+    /// `w * n` bytes of pixel data. Returns false if the bitmap is too big
+    /// for a slab or no slab could be allocated.
+    pub fn insert(
+        &mut self,
+        key: GlyphCacheKey,
+        w: usize,
+        h: usize,
+        n: usize,
+        samples: &[u8],
+        stride: usize,
+    ) -> bool {
+        let width = w * n;
+        if width == 0
+            || h == 0
+            || width > ATLAS_SLAB_STRIDE
+            || h > ATLAS_SLAB_ROWS
+            || stride < width
+            || samples.len() < (h - 1) * stride + width
+        {
+            return false;
+        }
+
+        let slabs = self.fonts.entry(key.font).or_default();
+        let placed = slabs
+            .iter_mut()
+            .enumerate()
+            .find_map(|(i, slab)| slab.allocate(width, h).map(|(x, y)| (i, x, y)));
+        let (slab, x, y) = match placed {
+            Some(placed) => placed,
+            None => {
+                let Some(mut fresh) = AtlasSlab::new() else {
+                    return false;
+                };
+                let (x, y) = fresh.allocate(width, h).expect("bitmap fits an empty slab");
+                slabs.push(fresh);
+                (slabs.len() - 1, x, y)
+            }
+        };
+
+        let mut buffer = slabs[slab].buffer.lock().unwrap();
+        let dst = buffer.as_mut_slice();
+        for row in 0..h {
+            let to = (y + row) * ATLAS_SLAB_STRIDE + x;
+            dst[to..to + width].copy_from_slice(&samples[row * stride..row * stride + width]);
+        }
+        drop(buffer);
+
+        self.slots.insert(
+            key,
+            AtlasSlot {
+                slab,
+                x,
+                y,
+                w,
+                h,
+                n,
+            },
+        );
+        true
+    }
+
+    /// Find a glyph's slot and the address of its first sample
+    ///
+    /// The address stays valid until the glyph's font is purged.
+    pub fn lookup(&self, key: &GlyphCacheKey) -> Option<(AtlasSlot, *const u8)> {
+        let slot = *self.slots.get(key)?;
+        let slab = &self.fonts.get(&key.font)?[slot.slab];
+        let base = slab.buffer.lock().unwrap().as_ptr();
+        // SAFETY: The slot lies inside the slab, which is never reallocated
+        Some((slot, unsafe {
+            base.add(slot.y * ATLAS_SLAB_STRIDE + slot.x)
+        }))
+    }
+
+    /// Drop every slab and slot of `font`, returning the glyphs removed
+    pub fn purge_font(&mut self, font: Handle) -> usize {
+        let before = self.slots.len();
+        self.slots.retain(|key, _| key.font != font);
+        self.fonts.remove(&font);
+        before - self.slots.len()
+    }
+
+    /// Drop everything
+    pub fn purge(&mut self) {
+        self.slots.clear();
+        self.fonts.clear();
+    }
+
+    /// Number of glyphs packed
+    pub fn glyph_count(&self) -> usize {
+        self.slots.len()
+    }
+
+    /// Number of slabs allocated
+    pub fn slab_count(&self) -> usize {
+        self.fonts.values().map(Vec::len).sum()
+    }
+}
+
+// ============================================================================
+// Sharded Glyph Cache
+// ============================================================================
+
+/// Glyph cache split into independently locked shards
+///
+/// A key always maps to the same shard, so lookups lock one small map.
+/// Memory and count limits apply to the whole cache: they are checked
+/// against atomic totals, and an insert evicts from its own shard first,
+/// then from the others, holding one shard lock at a time. Concurrent
+/// inserts can overshoot a limit by at most one glyph each.
+pub struct ShardedGlyphCache {
+    shards: Box<[Mutex<GlyphCache>]>,
+    /// Atlases, sharded by font so a font's slabs share one lock
+    atlases: Box<[Mutex<GlyphAtlas>]>,
+    /// Whether inserts pack bitmaps into the atlas
+    atlas_mode: AtomicBool,
+    /// Bytes cached across all shards
+    memory: AtomicUsize,
+    /// Glyphs cached across all shards
+    count: AtomicUsize,
+    max_memory: AtomicUsize,
+    max_glyphs: AtomicUsize,
+    policy: AtomicI32,
+    purges: AtomicU64,
+}
+
+impl Default for ShardedGlyphCache {
+    fn default() -> Self {
+        Self::new(GLYPH_CACHE_SHARDS)
+    }
+}
+
+impl ShardedGlyphCache {
+    /// Create a cache with `shards` shards (rounded up to a power of 2)
+    pub fn new(shards: usize) -> Self {
+        let shards = shards.max(1).next_power_of_two();
+        let shards = (0..shards)
+            .map(|_| {
+                // Limits are enforced across shards, not per shard
+                let mut shard = GlyphCache::default();
+                shard.set_max_memory(usize::MAX);
+                shard.set_max_glyphs(usize::MAX);
+                Mutex::new(shard)
+            })
+            .collect::<Box<[_]>>();
+        let atlases = (0..shards.len())
+            .map(|_| Mutex::new(GlyphAtlas::default()))
+            .collect();
+        Self {
+            shards,
+            atlases,
+            atlas_mode: AtomicBool::new(false),
+            memory: AtomicUsize::new(0),
+            count: AtomicUsize::new(0),
+            max_memory: AtomicUsize::new(DEFAULT_CACHE_SIZE),
+            max_glyphs: AtomicUsize::new(DEFAULT_MAX_GLYPHS),
+            policy: AtomicI32::new(CacheEvictionPolicy::default() as i32),
+            purges: AtomicU64::new(0),
+        }
+    }
+
+    fn shard_index(&self, key: &GlyphCacheKey) -> usize {
+        let mut hasher = DefaultHasher::new();
+        key.hash(&mut hasher);
+        hasher.finish() as usize & (self.shards.len() - 1)
+    }
+
+    fn shard(&self, index: usize) -> std::sync::MutexGuard<'_, GlyphCache> {
+        self.shards[index]
+            .lock()
+            .unwrap_or_else(|poisoned| poisoned.into_inner())
+    }
+
+    fn atlas(&self, font: Handle) -> std::sync::MutexGuard<'_, GlyphAtlas> {
+        let mut hasher = DefaultHasher::new();
+        font.hash(&mut hasher);
+        let index = hasher.finish() as usize & (self.atlases.len() - 1);
+        self.atlases[index]
+            .lock()
+            .unwrap_or_else(|poisoned| poisoned.into_inner())
+    }
+
+    /// Whether inserts pack bitmaps into the atlas
+    pub fn atlas_mode(&self) -> bool {
+        self.atlas_mode.load(Ordering::Relaxed)
+    }
+
+    /// Turn atlas packing on or off (already packed glyphs stay)
+    pub fn set_atlas_mode(&self, enabled: bool) {
+        self.atlas_mode.store(enabled, Ordering::Relaxed);
+    }
+
+    /// Pack a bitmap into its font's atlas
+    pub fn atlas_insert(
+        &self,
+        key: GlyphCacheKey,
+        w: usize,
+        h: usize,
+        n: usize,
+        samples: &[u8],
+        stride: usize,
+    ) -> bool {
+        self.atlas(key.font).insert(key, w, h, n, samples, stride)
+    }
+
+    /// Find a packed glyph
+    pub fn atlas_lookup(&self, key: &GlyphCacheKey) -> Option<(AtlasSlot, *const u8)> {
+        self.atlas(key.font).lookup(key)
+    }
+
+    /// Sum packed glyphs and slabs over all atlas shards
+    pub fn atlas_usage(&self) -> (usize, usize) {
+        self.atlases.iter().fold((0, 0), |(glyphs, slabs), atlas| {
+            let atlas = atlas
+                .lock()
+                .unwrap_or_else(|poisoned| poisoned.into_inner());
+            (glyphs + atlas.glyph_count(), slabs + atlas.slab_count())
+        })
+    }
+
+    fn over_limit(&self, size: usize) -> bool {
+        self.memory.load(Ordering::Relaxed) + size > self.max_memory.load(Ordering::Relaxed)
+            || self.count.load(Ordering::Relaxed) >= self.max_glyphs.load(Ordering::Relaxed)
+    }
+
+    fn forget(&self, size: usize) {
+        self.memory.fetch_sub(size, Ordering::Relaxed);
+        self.count.fetch_sub(1, Ordering::Relaxed);
+    }
+
+    /// Look up a glyph, locking only its shard
+    pub fn get(&self, key: &GlyphCacheKey) -> Option<Handle> {
+        self.shard(self.shard_index(key)).get(key)
+    }
+
+    /// Insert a glyph, evicting as needed to stay within the limits
+    pub fn insert(&self, key: GlyphCacheKey, pixmap: Handle, size: usize, glyph: Option<Handle>) {
+        let home = self.shard_index(&key);
+        if let Some(old) = self.shard(home).remove(&key) {
+            self.forget(old.size);
+        }
+
+        let mut probe = home;
+        let mut exhausted = 0;
+        while self.over_limit(size) && exhausted < self.shards.len() {
+            match self.shard(probe).evict_one() {
+                Some(freed) => self.forget(freed),
+                None => {
+                    probe = (probe + 1) & (self.shards.len() - 1);
+                    exhausted += 1;
+                }
+            }
+        }
+
+        self.shard(home).insert(key, pixmap, size, glyph);
+        self.memory.fetch_add(size, Ordering::Relaxed);
+        self.count.fetch_add(1, Ordering::Relaxed);
+    }
+
+    /// Remove a glyph
+    pub fn remove(&self, key: &GlyphCacheKey) -> Option<GlyphCacheEntry> {
+        let entry = self.shard(self.shard_index(key)).remove(key)?;
+        self.forget(entry.size);
+        Some(entry)
+    }
+
+    /// Every cached glyph's key and pixmap (atlas-packed glyphs aside)
+    pub fn entries(&self) -> Vec<(GlyphCacheKey, Handle)> {
+        let mut entries = Vec::with_capacity(self.count.load(Ordering::Relaxed));
+        for index in 0..self.shards.len() {
+            let shard = self.shard(index);
+            entries.extend(shard.entries.iter().map(|(k, e)| (k.clone(), e.pixmap)));
+        }
+        entries
+    }
+
+    /// Remove every glyph of `font`, returning how many were removed
+    pub fn purge_font(&self, font: Handle) -> usize {
+        let mut removed = self.atlas(font).purge_font(font);
+        for index in 0..self.shards.len() {
+            let mut shard = self.shard(index);
+            let keys: Vec<_> = shard
+                .entries
+                .keys()
+                .filter(|k| k.font == font)
+                .cloned()
+                .collect();
+            for key in keys {
+                if let Some(entry) = shard.remove(&key) {
+                    self.forget(entry.size);
+                    removed += 1;
+                }
+            }
+        }
+        removed
+    }
+
+    /// Clear all shards
+    pub fn purge(&self) {
+        for index in 0..self.shards.len() {
+            let mut shard = self.shard(index);
+            let freed = shard.stats.memory_usage;
+            let glyphs = shard.stats.glyph_count;
+            shard.purge();
+            self.memory.fetch_sub(freed, Ordering::Relaxed);
+            self.count.fetch_sub(glyphs, Ordering::Relaxed);
+        }
+        for atlas in self.atlases.iter() {
+            atlas
+                .lock()
+                .unwrap_or_else(|poisoned| poisoned.into_inner())
+                .purge();
+        }
+        self.purges.fetch_add(1, Ordering::Relaxed);
+    }
+
+    /// Sum the per-shard statistics
+    pub fn stats(&self) -> GlyphCacheStats {
+        let mut stats = GlyphCacheStats {
+            max_memory: self.max_memory.load(Ordering::Relaxed),
+            max_glyphs: self.max_glyphs.load(Ordering::Relaxed),
+            purge_count: self.purges.load(Ordering::Relaxed),
+            ..Default::default()
+        };
+        for index in 0..self.shards.len() {
+            let shard = self.shard(index);
+            stats.hits += shard.stats.hits;
+            stats.misses += shard.stats.misses;
+            stats.evictions += shard.stats.evictions;
+            stats.glyph_count += shard.stats.glyph_count;
+            stats.memory_usage += shard.stats.memory_usage;
+        }
+        stats
+    }
+
+    /// Zero hits, misses and evictions (purges are historical)
+    pub fn reset_stats(&self) {
+        for index in 0..self.shards.len() {
+            let mut shard = self.shard(index);
+            shard.stats.hits = 0;
+            shard.stats.misses = 0;
+            shard.stats.evictions = 0;
+        }
+    }
+
+    /// Set maximum memory
+    pub fn set_max_memory(&self, max: usize) {
+        self.max_memory.store(max, Ordering::Relaxed);
+    }
+
+    /// Set maximum glyphs
+    pub fn set_max_glyphs(&self, max: usize) {
+        self.max_glyphs.store(max, Ordering::Relaxed);
+    }
+
+    /// Get eviction policy
+    pub fn policy(&self) -> CacheEvictionPolicy {
+        CacheEvictionPolicy::from_i32(self.policy.load(Ordering::Relaxed))
+    }
+
+    /// Set eviction policy on every shard
+    pub fn set_policy(&self, policy: CacheEvictionPolicy) {
+        self.policy.store(policy as i32, Ordering::Relaxed);
+        for index in 0..self.shards.len() {
+            self.shard(index).set_policy(policy);
+        }
+    }
+}
+
+/// Global glyph cache instance, shared by all contexts
+pub static GLYPH_CACHE: LazyLock<ShardedGlyphCache> = LazyLock::new(ShardedGlyphCache::default);
 
 // ============================================================================
 // FFI Functions - Cache Management
@@ -342,143 +846,91 @@ pub static GLYPH_CACHE: LazyLock<Mutex<GlyphCache>> =
 /// Purge all glyphs from the cache
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_purge_glyph_cache(_ctx: Handle) {
-    if let Ok(mut cache) = GLYPH_CACHE.lock() {
-        cache.purge();
-    }
+    GLYPH_CACHE.purge();
 }
 
 /// Get cache hit count
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_glyph_cache_hits(_ctx: Handle) -> u64 {
-    if let Ok(cache) = GLYPH_CACHE.lock() {
-        cache.stats.hits
-    } else {
-        0
-    }
+    GLYPH_CACHE.stats().hits
 }
 
 /// Get cache miss count
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_glyph_cache_misses(_ctx: Handle) -> u64 {
-    if let Ok(cache) = GLYPH_CACHE.lock() {
-        cache.stats.misses
-    } else {
-        0
-    }
+    GLYPH_CACHE.stats().misses
 }
 
 /// Get cache hit rate (0.0 - 1.0)
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_glyph_cache_hit_rate(_ctx: Handle) -> f32 {
-    if let Ok(cache) = GLYPH_CACHE.lock() {
-        cache.stats.hit_rate()
-    } else {
-        0.0
-    }
+    GLYPH_CACHE.stats().hit_rate()
 }
 
 /// Get number of cached glyphs
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_glyph_cache_count(_ctx: Handle) -> usize {
-    if let Ok(cache) = GLYPH_CACHE.lock() {
-        cache.stats.glyph_count
-    } else {
-        0
-    }
+    GLYPH_CACHE.stats().glyph_count
 }
 
 /// Get cache memory usage in bytes
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_glyph_cache_memory_size(_ctx: Handle) -> usize {
-    if let Ok(cache) = GLYPH_CACHE.lock() {
-        cache.stats.memory_usage
-    } else {
-        0
-    }
+    GLYPH_CACHE.stats().memory_usage
 }
 
 /// Get maximum cache memory limit
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_glyph_cache_max_size(_ctx: Handle) -> usize {
-    if let Ok(cache) = GLYPH_CACHE.lock() {
-        cache.stats.max_memory
-    } else {
-        0
-    }
+    GLYPH_CACHE.stats().max_memory
 }
 
 /// Set maximum cache memory limit
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_set_glyph_cache_max_size(_ctx: Handle, max: usize) {
-    if let Ok(mut cache) = GLYPH_CACHE.lock() {
-        cache.set_max_memory(max);
-    }
+    GLYPH_CACHE.set_max_memory(max);
 }
 
 /// Get maximum cached glyph count
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_glyph_cache_max_count(_ctx: Handle) -> usize {
-    if let Ok(cache) = GLYPH_CACHE.lock() {
-        cache.stats.max_glyphs
-    } else {
-        0
-    }
+    GLYPH_CACHE.stats().max_glyphs
 }
 
 /// Set maximum cached glyph count
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_set_glyph_cache_max_count(_ctx: Handle, max: usize) {
-    if let Ok(mut cache) = GLYPH_CACHE.lock() {
-        cache.set_max_glyphs(max);
-    }
+    GLYPH_CACHE.set_max_glyphs(max);
 }
 
 /// Get number of evictions
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_glyph_cache_evictions(_ctx: Handle) -> u64 {
-    if let Ok(cache) = GLYPH_CACHE.lock() {
-        cache.stats.evictions
-    } else {
-        0
-    }
+    GLYPH_CACHE.stats().evictions
 }
 
 /// Get number of purges
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_glyph_cache_purges(_ctx: Handle) -> u64 {
-    if let Ok(cache) = GLYPH_CACHE.lock() {
-        cache.stats.purge_count
-    } else {
-        0
-    }
+    GLYPH_CACHE.stats().purge_count
 }
 
 /// Get cache eviction policy
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_glyph_cache_policy(_ctx: Handle) -> i32 {
-    if let Ok(cache) = GLYPH_CACHE.lock() {
-        cache.policy as i32
-    } else {
-        0
-    }
+    GLYPH_CACHE.policy() as i32
 }
 
 /// Set cache eviction policy
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_set_glyph_cache_policy(_ctx: Handle, policy: i32) {
-    if let Ok(mut cache) = GLYPH_CACHE.lock() {
-        cache.set_policy(CacheEvictionPolicy::from_i32(policy));
-    }
+    GLYPH_CACHE.set_policy(CacheEvictionPolicy::from_i32(policy));
 }
 
 /// Get memory utilization (0.0 - 1.0)
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_glyph_cache_utilization(_ctx: Handle) -> f32 {
-    if let Ok(cache) = GLYPH_CACHE.lock() {
-        cache.stats.memory_utilization()
-    } else {
-        0.0
-    }
+    GLYPH_CACHE.stats().memory_utilization()
 }
 
 // ============================================================================
@@ -502,20 +954,31 @@ pub extern "C" fn fz_render_glyph_pixmap(
     let matrix = unsafe { &*ctm };
     let aa_level = aa.clamp(0, 8) as u8;
 
-    // Create cache key
-    let key = GlyphCacheKey::new(font, gid as u32, matrix, 0, 0, aa_level);
+    // Create cache key from the subpixel-quantized transform
+    let mut quantized = *matrix;
+    let (subpix_x, subpix_y) = subpixel_adjust_internal(&mut quantized);
+    let key = GlyphCacheKey::new(font, gid as u32, &quantized, subpix_x, subpix_y, aa_level);
 
     // Check cache
-    if let Ok(mut cache) = GLYPH_CACHE.lock() {
-        if let Some(pixmap) = cache.get(&key) {
-            return pixmap;
-        }
+    if let Some(pixmap) = GLYPH_CACHE.get(&key) {
+        return pixmap;
+    }
+
+    // Then the open context snapshot and the persistent cache file
+    let mut pixmap = crate::ffi::context_snapshot::attached_lookup(font, &key);
+    if pixmap == 0 {
+        pixmap = crate::ffi::glyph_disk_cache::attached_lookup(font, &key);
     }
 
     // Render glyph (create a simple pixmap for the glyph)
-    let pixmap = render_glyph_internal(font, gid as u32, matrix, scissor, aa_level);
     if pixmap == 0 {
-        return 0;
+        let _sampled = alloc_sampler::scope(Subsystem::GlyphCache);
+        pixmap = render_glyph_internal(font, gid as u32, matrix, scissor, aa_level);
+        if pixmap == 0 {
+            return 0;
+        }
+        counters::add(Counter::GlyphsRasterized, 1);
+        crate::ffi::glyph_disk_cache::attached_store(font, &key, pixmap);
     }
 
     // Get pixmap size for cache
@@ -527,9 +990,7 @@ pub extern "C" fn fz_render_glyph_pixmap(
     };
 
     // Insert into cache
-    if let Ok(mut cache) = GLYPH_CACHE.lock() {
-        cache.insert(key, pixmap, size, None);
-    }
+    GLYPH_CACHE.insert(key, pixmap, size, None);
 
     pixmap
 }
@@ -638,8 +1099,8 @@ pub extern "C" fn fz_render_t3_glyph_direct(
 /// Dump glyph cache statistics
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_dump_glyph_cache_stats(_ctx: Handle, _out: Handle) {
-    if let Ok(cache) = GLYPH_CACHE.lock() {
-        let stats = cache.stats();
+    {
+        let stats = GLYPH_CACHE.stats();
         eprintln!("Glyph Cache Statistics:");
         eprintln!("  Hits: {}", stats.hits);
         eprintln!("  Misses: {}", stats.misses);
@@ -678,11 +1139,7 @@ pub extern "C" fn fz_rendered_glyph_cache_lookup(
     let matrix = unsafe { &*ctm };
     let key = GlyphCacheKey::new(font, gid as u32, matrix, subpix_x, subpix_y, aa as u8);
 
-    if let Ok(mut cache) = GLYPH_CACHE.lock() {
-        cache.get(&key).unwrap_or(0)
-    } else {
-        0
-    }
+    GLYPH_CACHE.get(&key).unwrap_or(0)
 }
 
 /// Insert a rendered glyph pixmap into cache
@@ -705,14 +1162,53 @@ pub extern "C" fn fz_rendered_glyph_cache_insert(
     let matrix = unsafe { &*ctm };
     let key = GlyphCacheKey::new(font, gid as u32, matrix, subpix_x, subpix_y, aa as u8);
 
-    if let Ok(mut cache) = GLYPH_CACHE.lock() {
-        cache.insert(key, pixmap, size, None);
+    if GLYPH_CACHE.atlas_mode() {
+        if let Some(pix) = PIXMAPS.get(pixmap) {
+            let guard = pix.lock().unwrap();
+            if GLYPH_CACHE.atlas_insert(
+                key.clone(),
+                guard.w().max(0) as usize,
+                guard.h().max(0) as usize,
+                guard.n().max(0) as usize,
+                guard.samples(),
+                guard.stride().max(0) as usize,
+            ) {
+                return;
+            }
+        }
     }
+
+    GLYPH_CACHE.insert(key, pixmap, size, None);
 }
 
-/// Remove a specific rendered glyph from cache
+/// Enable or disable atlas mode
+///
+/// While enabled, fz_rendered_glyph_cache_insert copies the pixmap's
+/// samples into a per-font atlas slab instead of keeping the handle, and
+/// the glyph is found with fz_rendered_glyph_cache_lookup_atlas. Bitmaps
+/// too large for a slab still go to the handle cache.
 #[unsafe(no_mangle)]
-pub extern "C" fn fz_rendered_glyph_cache_remove(
+pub extern "C" fn fz_set_glyph_cache_atlas(_ctx: Handle, enabled: c_int) {
+    GLYPH_CACHE.set_atlas_mode(enabled != 0);
+}
+
+/// Check whether atlas mode is enabled
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_glyph_cache_atlas(_ctx: Handle) -> c_int {
+    GLYPH_CACHE.atlas_mode() as c_int
+}
+
+/// Look up a glyph packed into the atlas
+///
+/// On success returns 1 and stores the address of the first sample, the
+/// bitmap size, its component count and the row stride. The samples stay
+/// valid until the font or the whole cache is purged. Returns 0 if the
+/// glyph is not in the atlas.
+///
+/// # Safety
+/// Each non-null out pointer must be valid for writes
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_rendered_glyph_cache_lookup_atlas(
     _ctx: Handle,
     font: Handle,
     gid: i32,
@@ -720,53 +1216,85 @@ pub extern "C" fn fz_rendered_glyph_cache_remove(
     subpix_x: u8,
     subpix_y: u8,
     aa: i32,
-) -> i32 {
+    samples: *mut *const u8,
+    w: *mut c_int,
+    h: *mut c_int,
+    n: *mut c_int,
+    stride: *mut c_int,
+) -> c_int {
     if ctm.is_null() {
         return 0;
     }
 
     let matrix = unsafe { &*ctm };
     let key = GlyphCacheKey::new(font, gid as u32, matrix, subpix_x, subpix_y, aa as u8);
+    let Some((slot, ptr)) = GLYPH_CACHE.atlas_lookup(&key) else {
+        return 0;
+    };
 
-    if let Ok(mut cache) = GLYPH_CACHE.lock() {
-        if cache.remove(&key).is_some() {
-            return 1;
+    unsafe {
+        if !samples.is_null() {
+            *samples = ptr;
+        }
+        if !w.is_null() {
+            *w = slot.w as c_int;
+        }
+        if !h.is_null() {
+            *h = slot.h as c_int;
+        }
+        if !n.is_null() {
+            *n = slot.n as c_int;
+        }
+        if !stride.is_null() {
+            *stride = ATLAS_SLAB_STRIDE as c_int;
         }
     }
-    0
+    1
 }
 
-/// Remove all cached rendered glyphs for a specific font
+/// Get the number of glyphs packed into the atlas
 #[unsafe(no_mangle)]
-pub extern "C" fn fz_rendered_glyph_cache_purge_font(_ctx: Handle, font: Handle) -> usize {
-    let mut removed = 0;
-
-    if let Ok(mut cache) = GLYPH_CACHE.lock() {
-        let keys_to_remove: Vec<_> = cache
-            .entries
-            .keys()
-            .filter(|k| k.font == font)
-            .cloned()
-            .collect();
+pub extern "C" fn fz_glyph_cache_atlas_count(_ctx: Handle) -> usize {
+    GLYPH_CACHE.atlas_usage().0
+}
 
-        for key in keys_to_remove {
-            cache.remove(&key);
-            removed += 1;
-        }
+/// Get the number of atlas slabs allocated
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_glyph_cache_atlas_slabs(_ctx: Handle) -> usize {
+    GLYPH_CACHE.atlas_usage().1
+}
+
+/// Remove a specific rendered glyph from cache
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_rendered_glyph_cache_remove(
+    _ctx: Handle,
+    font: Handle,
+    gid: i32,
+    ctm: *const Matrix,
+    subpix_x: u8,
+    subpix_y: u8,
+    aa: i32,
+) -> i32 {
+    if ctm.is_null() {
+        return 0;
     }
 
-    removed
+    let matrix = unsafe { &*ctm };
+    let key = GlyphCacheKey::new(font, gid as u32, matrix, subpix_x, subpix_y, aa as u8);
+
+    GLYPH_CACHE.remove(&key).is_some() as i32
+}
+
+/// Remove all cached rendered glyphs for a specific font
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_rendered_glyph_cache_purge_font(_ctx: Handle, font: Handle) -> usize {
+    GLYPH_CACHE.purge_font(font)
 }
 
 /// Reset cache statistics
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_glyph_cache_reset_stats(_ctx: Handle) {
-    if let Ok(mut cache) = GLYPH_CACHE.lock() {
-        cache.stats.hits = 0;
-        cache.stats.misses = 0;
-        cache.stats.evictions = 0;
-        // Don't reset purge_count as it's historical
-    }
+    GLYPH_CACHE.reset_stats();
 }
 
 // ============================================================================
@@ -911,6 +1439,172 @@ mod tests {
         assert!(cache.stats.evictions >= 1);
     }
 
+    #[test]
+    fn test_glyph_cache_key_ignores_pen_position() {
+        let at = |e: f32, f: f32| Matrix {
+            a: 12.0,
+            b: 0.0,
+            c: 0.0,
+            d: 12.0,
+            e,
+            f,
+        };
+        assert_eq!(
+            GlyphCacheKey::new(1, 65, &at(10.0, 20.0), 1, 0, 4),
+            GlyphCacheKey::new(1, 65, &at(300.0, 7.0), 1, 0, 4)
+        );
+    }
+
+    #[test]
+    fn test_cache_replace_counts_once() {
+        let mut cache = GlyphCache::default();
+        let key = GlyphCacheKey::new(1, 65, &Matrix::IDENTITY, 0, 0, 4);
+        cache.insert(key.clone(), 100, 10, None);
+        cache.insert(key, 101, 20, None);
+        assert_eq!(cache.stats.glyph_count, 1);
+        assert_eq!(cache.stats.memory_usage, 20);
+    }
+
+    #[test]
+    fn test_sharded_cache_limits_span_shards() {
+        let cache = ShardedGlyphCache::new(4);
+        cache.set_max_glyphs(8);
+        for gid in 0..64 {
+            let key = GlyphCacheKey::new(1, gid, &Matrix::IDENTITY, 0, 0, 4);
+            cache.insert(key, gid as Handle + 1, 10, None);
+        }
+
+        let stats = cache.stats();
+        assert_eq!(stats.glyph_count, 8);
+        assert_eq!(stats.memory_usage, 80);
+        assert_eq!(stats.evictions, 56);
+
+        cache.purge();
+        let stats = cache.stats();
+        assert_eq!(stats.glyph_count, 0);
+        assert_eq!(stats.memory_usage, 0);
+        assert_eq!(stats.purge_count, 1);
+    }
+
+    #[test]
+    fn test_sharded_cache_concurrent() {
+        let cache = ShardedGlyphCache::new(8);
+        std::thread::scope(|scope| {
+            for t in 0..4u32 {
+                let cache = &cache;
+                scope.spawn(move || {
+                    for gid in 0..256 {
+                        let key = GlyphCacheKey::new(t as Handle, gid, &Matrix::IDENTITY, 0, 0, 4);
+                        if cache.get(&key).is_none() {
+                            cache.insert(key, gid as Handle + 1, 4, None);
+                        }
+                        let key = GlyphCacheKey::new(t as Handle, gid, &Matrix::IDENTITY, 0, 0, 4);
+                        assert_eq!(cache.get(&key), Some(gid as Handle + 1));
+                    }
+                });
+            }
+        });
+
+        let stats = cache.stats();
+        assert_eq!(stats.glyph_count, 1024);
+        assert_eq!(stats.hits, 1024);
+        assert_eq!(stats.misses, 1024);
+        assert_eq!(cache.purge_font(2), 256);
+        assert_eq!(cache.stats().memory_usage, 768 * 4);
+    }
+
+    #[test]
+    fn test_atlas_shelf_packing() {
+        let mut atlas = GlyphAtlas::default();
+        let key = |font, gid| GlyphCacheKey::new(font, gid, &Matrix::IDENTITY, 0, 0, 4);
+        let bitmap: Vec<u8> = (0..100).collect();
+
+        // 10x10 single-channel glyphs share one shelf until the row is full
+        for gid in 0..60 {
+            assert!(atlas.insert(key(1, gid), 10, 10, 1, &bitmap, 10));
+        }
+        let (first, _) = atlas.lookup(&key(1, 0)).unwrap();
+        let (second, _) = atlas.lookup(&key(1, 1)).unwrap();
+        let (wrapped, _) = atlas.lookup(&key(1, 51)).unwrap();
+        assert_eq!((first.x, first.y), (0, 0));
+        assert_eq!((second.x, second.y), (10, 0));
+        assert_eq!((wrapped.x, wrapped.y), (0, 10));
+
+        // A slightly shorter glyph reuses the shelf, a much shorter one does not
+        assert!(atlas.insert(key(1, 100), 4, 8, 1, &bitmap, 10));
+        assert_eq!(atlas.lookup(&key(1, 100)).unwrap().0.y, 10);
+        assert!(atlas.insert(key(1, 101), 4, 2, 1, &bitmap, 4));
+        assert_eq!(atlas.lookup(&key(1, 101)).unwrap().0.y, 20);
+
+        // Samples are copied row by row
+        let (slot, ptr) = atlas.lookup(&key(1, 1)).unwrap();
+        let row2 = unsafe { std::slice::from_raw_parts(ptr.add(2 * ATLAS_SLAB_STRIDE), slot.w) };
+        assert_eq!(row2, &bitmap[20..30]);
+        assert_eq!(ptr as usize % ATLAS_SLAB_STRIDE, 10);
+
+        assert!(!atlas.insert(key(1, 200), ATLAS_SLAB_STRIDE + 1, 1, 1, &[0; 600], 600));
+    }
+
+    #[test]
+    fn test_atlas_purge_font() {
+        let mut atlas = GlyphAtlas::default();
+        let key = |font, gid| GlyphCacheKey::new(font, gid, &Matrix::IDENTITY, 0, 0, 4);
+        let bitmap = [255u8; 64 * 64];
+        // One 64x64 glyph per shelf row pair; enough to spill into a second slab
+        for gid in 0..80 {
+            assert!(atlas.insert(key(1, gid), 64, 64, 1, &bitmap, 64));
+        }
+        assert!(atlas.insert(key(2, 0), 64, 64, 1, &bitmap, 64));
+        assert_eq!(atlas.slab_count(), 3);
+
+        assert_eq!(atlas.purge_font(1), 80);
+        assert_eq!(atlas.slab_count(), 1);
+        assert!(atlas.lookup(&key(1, 0)).is_none());
+        assert!(atlas.lookup(&key(2, 0)).is_some());
+    }
+
+    #[test]
+    fn test_ffi_atlas_insert_lookup() {
+        let ctx = 1;
+        let font = 0xA71A5;
+        let ctm = Matrix::IDENTITY;
+
+        // Atlas mode is process-wide, so pack directly rather than toggling
+        // it under concurrently running cache tests
+        let key = GlyphCacheKey::new(font, 7, &ctm, 0, 0, 4);
+        assert!(GLYPH_CACHE.atlas_insert(key, 3, 2, 1, &[1, 2, 3, 4, 5, 6], 3));
+
+        // Packed glyphs bypass the handle cache
+        assert_eq!(
+            fz_rendered_glyph_cache_lookup(ctx, font, 7, &ctm, 0, 0, 4),
+            0
+        );
+
+        let (mut samples, mut w, mut h, mut n, mut stride) = (std::ptr::null(), 0, 0, 0, 0);
+        assert_eq!(
+            fz_rendered_glyph_cache_lookup_atlas(
+                ctx,
+                font,
+                7,
+                &ctm,
+                0,
+                0,
+                4,
+                &mut samples,
+                &mut w,
+                &mut h,
+                &mut n,
+                &mut stride
+            ),
+            1
+        );
+        assert_eq!((w, h, n, stride), (3, 2, 1, ATLAS_SLAB_STRIDE as c_int));
+        let row1 = unsafe { std::slice::from_raw_parts(samples.add(stride as usize), 3) };
+        assert_eq!(row1, &[4, 5, 6]);
+
+        assert_eq!(fz_rendered_glyph_cache_purge_font(ctx, font), 1);
+    }
+
     #[test]
     fn test_cache_purge() {
         let mut cache = GlyphCache::default();
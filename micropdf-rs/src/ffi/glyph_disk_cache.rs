@@ -0,0 +1,842 @@
+//! FFI bindings for the persistent glyph cache file
+//!
+//! An opt-in, versioned file that keeps rendered glyphs and glyph outlines
+//! across process restarts, so a freshly started worker does not have to
+//! re-rasterize glyphs it rendered before a deploy. Records are keyed by
+//! the SHA-256 of the font program rather than by font handle, which only
+//! means something inside one process.
+//!
+//! The file is read through `fz_open_mapped_file`. New records are kept in
+//! memory until flushed; a flush writes the merged contents to a temporary
+//! file and renames it over the old one, so readers in other processes
+//! always see a complete file.
+//!
+//! Layout (little-endian): a 16-byte header (`MPGC`, version, 8 reserved
+//! bytes) followed by records, each a 72-byte record header and its data,
+//! padded to 8 bytes. A truncated tail is ignored; a file with another
+//! version or magic is treated as empty and replaced on the next flush.
+
+use std::collections::HashMap;
+use std::ffi::{CString, c_char, c_int};
+use std::io::Write;
+use std::path::{Path, PathBuf};
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, LazyLock, Mutex};
+
+use sha2::{Digest, Sha256};
+
+use crate::ffi::buffer::Buffer;
+use crate::ffi::colorspace::FZ_COLORSPACE_GRAY;
+use crate::ffi::font::FONTS;
+use crate::ffi::glyph_cache::GlyphCacheKey;
+use crate::ffi::mmap::{MAPPED_FILES, fz_close_mapped_file, fz_open_mapped_file};
+use crate::ffi::pixmap::Pixmap;
+use crate::ffi::{BUFFERS, Handle, HandleStore, PIXMAPS, safe_helpers};
+use crate::fitz::geometry::Matrix;
+
+/// File magic
+const MAGIC: &[u8; 4] = b"MPGC";
+
+/// Current file format version
+pub const GLYPH_CACHE_FILE_VERSION: u32 = 1;
+
+/// File header size
+const FILE_HEADER_LEN: usize = 16;
+
+/// Record header size
+pub(crate) const RECORD_HEADER_LEN: usize = 72;
+
+/// Record kind: rendered glyph mask
+pub(crate) const KIND_GLYPH: u8 = 1;
+
+/// Record kind: glyph outline (opaque caller data)
+pub(crate) const KIND_OUTLINE: u8 = 2;
+
+/// Key of a persistent record
+#[derive(Debug, Clone, Copy, Hash, PartialEq, Eq)]
+pub struct DiskGlyphKey {
+    pub kind: u8,
+    /// SHA-256 of the font program
+    pub font_hash: [u8; 32],
+    pub gid: u32,
+    pub matrix_key: [i32; 4],
+    pub subpix_x: u8,
+    pub subpix_y: u8,
+    pub aa: u8,
+}
+
+impl DiskGlyphKey {
+    pub(crate) fn glyph(font_hash: [u8; 32], key: &GlyphCacheKey) -> Self {
+        Self {
+            kind: KIND_GLYPH,
+            font_hash,
+            gid: key.glyph_id,
+            matrix_key: key.matrix_key,
+            subpix_x: key.subpix_x,
+            subpix_y: key.subpix_y,
+            aa: key.aa_level,
+        }
+    }
+
+    pub(crate) fn outline(font_hash: [u8; 32], gid: u32) -> Self {
+        Self {
+            kind: KIND_OUTLINE,
+            font_hash,
+            gid,
+            matrix_key: [0; 4],
+            subpix_x: 0,
+            subpix_y: 0,
+            aa: 0,
+        }
+    }
+}
+
+/// Size of a record's data and, for glyphs, its bitmap geometry
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub(crate) struct RecordInfo {
+    pub w: u32,
+    pub h: u32,
+    pub n: u32,
+    pub len: u32,
+}
+
+/// Where a record's data lives
+#[derive(Debug, Clone, Copy)]
+enum RecordData {
+    /// Offset into the mapped file
+    Mapped(usize),
+    /// Index into the pending list
+    Pending(usize),
+}
+
+pub(crate) fn encode_record(out: &mut Vec<u8>, key: &DiskGlyphKey, info: &RecordInfo, data: &[u8]) {
+    out.extend_from_slice(&[key.kind, key.subpix_x, key.subpix_y, key.aa]);
+    out.extend_from_slice(&key.gid.to_le_bytes());
+    out.extend_from_slice(&key.font_hash);
+    for m in key.matrix_key {
+        out.extend_from_slice(&m.to_le_bytes());
+    }
+    for v in [info.w, info.h, info.n, info.len] {
+        out.extend_from_slice(&v.to_le_bytes());
+    }
+    out.extend_from_slice(data);
+    out.resize(out.len().next_multiple_of(8), 0);
+}
+
+pub(crate) fn decode_record(bytes: &[u8]) -> Option<(DiskGlyphKey, RecordInfo)> {
+    let header = bytes.get(..RECORD_HEADER_LEN)?;
+    let u32_at = |at: usize| u32::from_le_bytes(header[at..at + 4].try_into().unwrap());
+    let mut key = DiskGlyphKey {
+        kind: header[0],
+        subpix_x: header[1],
+        subpix_y: header[2],
+        aa: header[3],
+        gid: u32_at(4),
+        font_hash: header[8..40].try_into().unwrap(),
+        matrix_key: [0; 4],
+    };
+    for (i, m) in key.matrix_key.iter_mut().enumerate() {
+        *m = u32_at(40 + i * 4) as i32;
+    }
+    let info = RecordInfo {
+        w: u32_at(56),
+        h: u32_at(60),
+        n: u32_at(64),
+        len: u32_at(68),
+    };
+    Some((key, info))
+}
+
+/// A glyph mask's rows without padding, if it has 1 or 2 components
+pub(crate) fn pack_mask(pixmap: &Pixmap) -> Option<(RecordInfo, Vec<u8>)> {
+    let (w, h, n) = (
+        pixmap.w() as usize,
+        pixmap.h() as usize,
+        pixmap.n() as usize,
+    );
+    if !(1..=2).contains(&n) || w == 0 || h == 0 {
+        return None;
+    }
+    let stride = pixmap.stride() as usize;
+    let mut data = Vec::with_capacity(w * n * h);
+    for row in pixmap.samples().chunks(stride).take(h) {
+        data.extend_from_slice(&row[..w * n]);
+    }
+    let info = RecordInfo {
+        w: w as u32,
+        h: h as u32,
+        n: n as u32,
+        len: data.len() as u32,
+    };
+    Some((info, data))
+}
+
+/// A glyph mask rebuilt from [`pack_mask`] output
+///
+/// The geometry comes from the file, so a record whose sizes overflow or
+/// don't match its data gives `None`, as if it weren't there.
+pub(crate) fn unpack_mask(info: &RecordInfo, data: &[u8]) -> Option<Pixmap> {
+    if !(1..=2).contains(&info.n) || info.w == 0 || info.h == 0 {
+        return None;
+    }
+    let row = (info.w as usize).checked_mul(info.n as usize)?;
+    let len = row.checked_mul(info.h as usize)?;
+    if len != info.len as usize || data.len() != len {
+        return None;
+    }
+    // Pixmap sizes and strides are i32
+    let (Ok(w), Ok(h), Ok(_)) = (
+        i32::try_from(info.w),
+        i32::try_from(info.h),
+        i32::try_from(row),
+    ) else {
+        return None;
+    };
+    let mut pixmap = Pixmap::new(FZ_COLORSPACE_GRAY, w, h, info.n == 2);
+    let stride = pixmap.stride() as usize;
+    for (dst, src) in pixmap
+        .samples_mut()
+        .chunks_mut(stride)
+        .zip(data.chunks(row))
+    {
+        dst[..row].copy_from_slice(src);
+    }
+    Some(pixmap)
+}
+
+/// Hash identifying a font across processes
+///
+/// Uses the embedded font program; fonts without one (the base 14) are
+/// identified by name. Unknown handles have no stable identity.
+pub fn font_content_hash(font: Handle) -> Option<[u8; 32]> {
+    let font = FONTS.get(font)?;
+    let guard = font.lock().ok()?;
+    // Embedded programs are hashed once per shared face
+    if let Some(face) = guard.face() {
+        return Some(face.content_hash());
+    }
+    let mut hasher = Sha256::new();
+    hasher.update(b"name:");
+    hasher.update(guard.name().as_bytes());
+    Some(hasher.finalize().into())
+}
+
+/// An open persistent glyph cache file
+pub struct GlyphCacheFile {
+    path: PathBuf,
+    /// Handle of the current mapping (0 when the file is absent or invalid)
+    mapped: Handle,
+    index: HashMap<DiskGlyphKey, (RecordInfo, RecordData)>,
+    pending: Vec<(DiskGlyphKey, RecordInfo, Vec<u8>)>,
+    /// Content hashes already computed, by font handle
+    font_hashes: HashMap<Handle, [u8; 32]>,
+    hits: u64,
+    misses: u64,
+}
+
+impl GlyphCacheFile {
+    /// Open `path`, indexing whatever valid records it already has
+    pub fn open<P: AsRef<Path>>(path: P) -> Self {
+        let mut file = Self {
+            path: path.as_ref().to_path_buf(),
+            mapped: 0,
+            index: HashMap::new(),
+            pending: Vec::new(),
+            font_hashes: HashMap::new(),
+            hits: 0,
+            misses: 0,
+        };
+        file.load();
+        file
+    }
+
+    fn load(&mut self) {
+        if self.mapped != 0 {
+            fz_close_mapped_file(0, self.mapped);
+            self.mapped = 0;
+        }
+        self.index.clear();
+
+        let Ok(c_path) = CString::new(self.path.to_string_lossy().as_bytes()) else {
+            return;
+        };
+        let handle = fz_open_mapped_file(0, c_path.as_ptr());
+        let Some(mapped) = MAPPED_FILES.get(handle) else {
+            return;
+        };
+        let guard = mapped.lock().unwrap();
+        let bytes = guard.as_slice();
+        if bytes.len() < FILE_HEADER_LEN
+            || &bytes[..4] != MAGIC
+            || bytes[4..8] != GLYPH_CACHE_FILE_VERSION.to_le_bytes()
+        {
+            drop(guard);
+            fz_close_mapped_file(0, handle);
+            return;
+        }
+
+        let mut offset = FILE_HEADER_LEN;
+        while let Some((key, info)) = bytes.get(offset..).and_then(decode_record) {
+            let data = offset + RECORD_HEADER_LEN;
+            let end = data + info.len as usize;
+            if end > bytes.len() {
+                break; // torn write
+            }
+            self.index.insert(key, (info, RecordData::Mapped(data)));
+            offset = end.next_multiple_of(8);
+        }
+        drop(guard);
+        self.mapped = handle;
+    }
+
+    fn hash_of(&mut self, font: Handle) -> Option<[u8; 32]> {
+        if let Some(hash) = self.font_hashes.get(&font) {
+            return Some(*hash);
+        }
+        let hash = font_content_hash(font)?;
+        self.font_hashes.insert(font, hash);
+        Some(hash)
+    }
+
+    fn read(&self, info: &RecordInfo, data: &RecordData) -> Option<Vec<u8>> {
+        match *data {
+            RecordData::Pending(i) => Some(self.pending[i].2.clone()),
+            RecordData::Mapped(offset) => {
+                let mapped = MAPPED_FILES.get(self.mapped)?;
+                let guard = mapped.lock().unwrap();
+                guard.read_at(offset, info.len as usize).map(<[u8]>::to_vec)
+            }
+        }
+    }
+
+    fn put(&mut self, key: DiskGlyphKey, info: RecordInfo, data: Vec<u8>) {
+        if self.index.contains_key(&key) {
+            return;
+        }
+        self.index
+            .insert(key, (info, RecordData::Pending(self.pending.len())));
+        self.pending.push((key, info, data));
+    }
+
+    fn get(&mut self, key: &DiskGlyphKey) -> Option<(RecordInfo, Vec<u8>)> {
+        let found = self
+            .index
+            .get(key)
+            .and_then(|(info, data)| Some((*info, self.read(info, data)?)));
+        match found {
+            Some(_) => self.hits += 1,
+            None => self.misses += 1,
+        }
+        found
+    }
+
+    /// Store a rendered glyph mask (1 or 2 components)
+    pub fn put_glyph(&mut self, font: Handle, key: &GlyphCacheKey, pixmap: &Pixmap) -> bool {
+        let Some((info, data)) = pack_mask(pixmap) else {
+            return false;
+        };
+        let Some(hash) = self.hash_of(font) else {
+            return false;
+        };
+        self.put(DiskGlyphKey::glyph(hash, key), info, data);
+        true
+    }
+
+    /// Load a rendered glyph mask as a new pixmap
+    pub fn get_glyph(&mut self, font: Handle, key: &GlyphCacheKey) -> Option<Pixmap> {
+        let hash = self.hash_of(font)?;
+        let (info, data) = self.get(&DiskGlyphKey::glyph(hash, key))?;
+        let pixmap = unpack_mask(&info, &data);
+        if pixmap.is_none() {
+            // A corrupt record is a miss
+            self.hits -= 1;
+            self.misses += 1;
+        }
+        pixmap
+    }
+
+    /// Store an outline for a glyph
+    pub fn put_outline(&mut self, font: Handle, gid: u32, data: &[u8]) -> bool {
+        let Some(hash) = self.hash_of(font) else {
+            return false;
+        };
+        let info = RecordInfo {
+            w: 0,
+            h: 0,
+            n: 0,
+            len: data.len() as u32,
+        };
+        self.put(DiskGlyphKey::outline(hash, gid), info, data.to_vec());
+        true
+    }
+
+    /// Load an outline for a glyph
+    pub fn get_outline(&mut self, font: Handle, gid: u32) -> Option<Vec<u8>> {
+        let hash = self.hash_of(font)?;
+        self.get(&DiskGlyphKey::outline(hash, gid))
+            .map(|(_, data)| data)
+    }
+
+    /// Number of records, flushed or not
+    pub fn len(&self) -> usize {
+        self.index.len()
+    }
+
+    /// Check if the cache has no records
+    pub fn is_empty(&self) -> bool {
+        self.index.is_empty()
+    }
+
+    /// Number of records not yet written
+    pub fn pending(&self) -> usize {
+        self.pending.len()
+    }
+
+    /// Write every record to disk and remap the file
+    pub fn flush(&mut self) -> std::io::Result<()> {
+        if self.pending.is_empty() {
+            return Ok(());
+        }
+
+        let mut out = Vec::new();
+        out.extend_from_slice(MAGIC);
+        out.extend_from_slice(&GLYPH_CACHE_FILE_VERSION.to_le_bytes());
+        out.extend_from_slice(&[0; 8]);
+        for (key, (info, data)) in &self.index {
+            if let Some(bytes) = self.read(info, data) {
+                encode_record(&mut out, key, info, &bytes);
+            }
+        }
+
+        let tmp = self
+            .path
+            .with_extension(format!("tmp{}", std::process::id()));
+        let mut file = std::fs::File::create(&tmp)?;
+        file.write_all(&out)?;
+        file.sync_data()?;
+        drop(file);
+        std::fs::rename(&tmp, &self.path)?;
+
+        self.pending.clear();
+        self.load();
+        Ok(())
+    }
+}
+
+impl Drop for GlyphCacheFile {
+    fn drop(&mut self) {
+        let _ = self.flush();
+        if self.mapped != 0 {
+            fz_close_mapped_file(0, self.mapped);
+        }
+    }
+}
+
+/// Open glyph cache files
+pub static GLYPH_CACHE_FILES: LazyLock<HandleStore<GlyphCacheFile>> =
+    LazyLock::new(HandleStore::default);
+
+/// File consulted by the rendered glyph cache (0 = none)
+static ATTACHED: AtomicU64 = AtomicU64::new(0);
+
+fn attached() -> Option<Arc<Mutex<GlyphCacheFile>>> {
+    GLYPH_CACHE_FILES.get(ATTACHED.load(Ordering::Acquire))
+}
+
+/// Look a glyph up in the attached file, returning a new pixmap handle
+pub fn attached_lookup(font: Handle, key: &GlyphCacheKey) -> Handle {
+    attached()
+        .and_then(|file| file.lock().unwrap().get_glyph(font, key))
+        .map_or(0, |pixmap| PIXMAPS.insert(pixmap))
+}
+
+/// Record a freshly rendered glyph in the attached file
+pub fn attached_store(font: Handle, key: &GlyphCacheKey, pixmap: Handle) {
+    if let (Some(file), Some(pix)) = (attached(), PIXMAPS.get(pixmap)) {
+        file.lock()
+            .unwrap()
+            .put_glyph(font, key, &pix.lock().unwrap());
+    }
+}
+
+// ============================================================================
+// FFI Functions
+// ============================================================================
+
+/// Open (or prepare to create) a persistent glyph cache file
+///
+/// # Safety
+/// Caller must ensure path is a valid null-terminated C string.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_open_glyph_cache_file(_ctx: Handle, path: *const c_char) -> Handle {
+    match safe_helpers::c_str_to_str(path) {
+        Some(path) if !path.is_empty() => GLYPH_CACHE_FILES.insert(GlyphCacheFile::open(path)),
+        _ => 0,
+    }
+}
+
+/// Drop a glyph cache file, flushing pending records
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_drop_glyph_cache_file(_ctx: Handle, file: Handle) {
+    let _ = ATTACHED.compare_exchange(file, 0, Ordering::AcqRel, Ordering::Relaxed);
+    let _ = GLYPH_CACHE_FILES.remove(file);
+}
+
+/// Write pending records to disk
+///
+/// Returns 0 on success, -1 on error.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_flush_glyph_cache_file(_ctx: Handle, file: Handle) -> c_int {
+    match GLYPH_CACHE_FILES
+        .get(file)
+        .map(|f| f.lock().unwrap().flush())
+    {
+        Some(Ok(())) => 0,
+        _ => -1,
+    }
+}
+
+/// Make the rendered glyph cache read through to `file` (0 detaches)
+///
+/// Glyphs missing from memory are then looked up in the file, and newly
+/// rendered ones are added to it.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_set_glyph_cache_file(_ctx: Handle, file: Handle) {
+    ATTACHED.store(file, Ordering::Release);
+}
+
+/// Store a rendered glyph pixmap in the file
+///
+/// Returns 1 if stored, 0 if the font has no stable identity or the pixmap
+/// is not a 1 or 2 component mask.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_glyph_cache_file_put_glyph(
+    _ctx: Handle,
+    file: Handle,
+    font: Handle,
+    gid: i32,
+    ctm: *const Matrix,
+    subpix_x: u8,
+    subpix_y: u8,
+    aa: i32,
+    pixmap: Handle,
+) -> c_int {
+    if ctm.is_null() {
+        return 0;
+    }
+    let (Some(file), Some(pix)) = (GLYPH_CACHE_FILES.get(file), PIXMAPS.get(pixmap)) else {
+        return 0;
+    };
+    let key = GlyphCacheKey::new(
+        font,
+        gid as u32,
+        unsafe { &*ctm },
+        subpix_x,
+        subpix_y,
+        aa as u8,
+    );
+    file.lock()
+        .unwrap()
+        .put_glyph(font, &key, &pix.lock().unwrap()) as c_int
+}
+
+/// Load a rendered glyph from the file as a new pixmap
+///
+/// Returns 0 if the file has no such glyph.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_glyph_cache_file_get_glyph(
+    _ctx: Handle,
+    file: Handle,
+    font: Handle,
+    gid: i32,
+    ctm: *const Matrix,
+    subpix_x: u8,
+    subpix_y: u8,
+    aa: i32,
+) -> Handle {
+    if ctm.is_null() {
+        return 0;
+    }
+    let Some(file) = GLYPH_CACHE_FILES.get(file) else {
+        return 0;
+    };
+    let key = GlyphCacheKey::new(
+        font,
+        gid as u32,
+        unsafe { &*ctm },
+        subpix_x,
+        subpix_y,
+        aa as u8,
+    );
+    let pixmap = file.lock().unwrap().get_glyph(font, &key);
+    pixmap.map_or(0, |pixmap| PIXMAPS.insert(pixmap))
+}
+
+/// Store a serialized glyph outline in the file
+///
+/// # Safety
+/// `data` must point to at least `len` readable bytes
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_glyph_cache_file_put_outline(
+    _ctx: Handle,
+    file: Handle,
+    font: Handle,
+    gid: i32,
+    data: *const u8,
+    len: usize,
+) -> c_int {
+    let Some(bytes) = safe_helpers::copy_from_ptr(data, len) else {
+        return 0;
+    };
+    GLYPH_CACHE_FILES.get(file).map_or(0, |f| {
+        f.lock().unwrap().put_outline(font, gid as u32, &bytes) as c_int
+    })
+}
+
+/// Load a glyph outline from the file into a new buffer
+///
+/// Returns 0 if the file has no outline for the glyph.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_glyph_cache_file_get_outline(
+    _ctx: Handle,
+    file: Handle,
+    font: Handle,
+    gid: i32,
+) -> Handle {
+    GLYPH_CACHE_FILES
+        .get(file)
+        .and_then(|f| f.lock().unwrap().get_outline(font, gid as u32))
+        .map_or(0, |data| BUFFERS.insert(Buffer::from_vec(data)))
+}
+
+/// Get the number of records in the file, including unflushed ones
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_glyph_cache_file_count(_ctx: Handle, file: Handle) -> usize {
+    GLYPH_CACHE_FILES
+        .get(file)
+        .map_or(0, |f| f.lock().unwrap().len())
+}
+
+/// Get lookup hits and misses since the file was opened
+///
+/// # Safety
+/// Each non-null out pointer must be valid for writes
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_glyph_cache_file_stats(
+    _ctx: Handle,
+    file: Handle,
+    hits: *mut u64,
+    misses: *mut u64,
+) {
+    let Some(file) = GLYPH_CACHE_FILES.get(file) else {
+        return;
+    };
+    let guard = file.lock().unwrap();
+    unsafe {
+        if !hits.is_null() {
+            *hits = guard.hits;
+        }
+        if !misses.is_null() {
+            *misses = guard.misses;
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn temp_path(name: &str) -> PathBuf {
+        std::env::temp_dir().join(format!("{}_{}.mpgc", name, std::process::id()))
+    }
+
+    fn embedded_font(bytes: &[u8]) -> Handle {
+        FONTS.insert(crate::fitz::font::Font::from_data("Test", bytes, 0).unwrap())
+    }
+
+    fn mask(w: i32, h: i32) -> Pixmap {
+        let mut pixmap = Pixmap::new(FZ_COLORSPACE_GRAY, w, h, false);
+        for (i, v) in pixmap.samples_mut().iter_mut().enumerate() {
+            *v = i as u8;
+        }
+        pixmap
+    }
+
+    #[test]
+    fn test_record_roundtrip() {
+        let key = DiskGlyphKey {
+            kind: KIND_GLYPH,
+            font_hash: [7; 32],
+            gid: 42,
+            matrix_key: [3072, 0, -5, 3072],
+            subpix_x: 1,
+            subpix_y: 3,
+            aa: 8,
+        };
+        let info = RecordInfo {
+            w: 2,
+            h: 1,
+            n: 1,
+            len: 2,
+        };
+        let mut out = Vec::new();
+        encode_record(&mut out, &key, &info, &[9, 10]);
+        assert_eq!(out.len(), 80);
+        assert_eq!(decode_record(&out), Some((key, info)));
+    }
+
+    #[test]
+    fn test_survives_reopen() {
+        let path = temp_path("glyph_cache_reopen");
+        let _ = std::fs::remove_file(&path);
+        let ctm = Matrix::scale(12.0, 12.0);
+
+        // Two handles for identical font programs, as after a restart
+        let before = embedded_font(b"font program A");
+        let after = embedded_font(b"font program A");
+        let other = embedded_font(b"font program B");
+        let key = |font| GlyphCacheKey::new(font, 65, &ctm, 1, 0, 4);
+
+        {
+            let mut file = GlyphCacheFile::open(&path);
+            assert!(file.is_empty());
+            assert!(file.put_glyph(before, &key(before), &mask(5, 3)));
+            assert!(file.put_outline(before, 65, b"outline"));
+            assert_eq!(file.pending(), 2);
+            file.flush().unwrap();
+            assert_eq!(file.pending(), 0);
+        }
+
+        let mut file = GlyphCacheFile::open(&path);
+        assert_eq!(file.len(), 2);
+        let pixmap = file.get_glyph(after, &key(after)).unwrap();
+        assert_eq!((pixmap.w(), pixmap.h(), pixmap.n()), (5, 3, 1));
+        assert_eq!(pixmap.samples(), mask(5, 3).samples());
+        assert_eq!(
+            file.get_outline(after, 65).as_deref(),
+            Some(&b"outline"[..])
+        );
+        assert!(file.get_glyph(other, &key(other)).is_none());
+        assert_eq!((file.hits, file.misses), (2, 1));
+
+        drop(file);
+        let _ = std::fs::remove_file(&path);
+        for font in [before, after, other] {
+            FONTS.remove(font);
+        }
+    }
+
+    #[test]
+    fn test_ignores_bad_version_and_torn_tail() {
+        let path = temp_path("glyph_cache_torn");
+        let font = embedded_font(b"font program C");
+        let key = GlyphCacheKey::new(font, 1, &Matrix::IDENTITY, 0, 0, 4);
+        {
+            let mut file = GlyphCacheFile::open(&path);
+            file.put_glyph(font, &key, &mask(4, 4));
+            file.put_outline(font, 1, &[1; 40]);
+            file.flush().unwrap();
+        }
+
+        // Cut the last record short
+        let mut bytes = std::fs::read(&path).unwrap();
+        bytes.truncate(bytes.len() - 16);
+        std::fs::write(&path, &bytes).unwrap();
+        assert_eq!(GlyphCacheFile::open(&path).len(), 1);
+
+        // Another version is ignored entirely
+        bytes[4] = 99;
+        std::fs::write(&path, &bytes).unwrap();
+        assert!(GlyphCacheFile::open(&path).is_empty());
+
+        let _ = std::fs::remove_file(&path);
+        FONTS.remove(font);
+    }
+
+    #[test]
+    fn test_corrupt_glyph_record_is_a_miss() {
+        let info = |w, h, n, len| RecordInfo { w, h, n, len };
+        assert!(unpack_mask(&info(2, 2, 1, 4), &[0; 4]).is_some());
+        // Sizes that overflow, disagree with the data or are empty
+        assert!(unpack_mask(&info(u32::MAX, u32::MAX, 2, 4), &[0; 4]).is_none());
+        assert!(unpack_mask(&info(2, 2, 1, 4), &[0; 3]).is_none());
+        assert!(unpack_mask(&info(2, 2, 1, 3), &[0; 4]).is_none());
+        assert!(unpack_mask(&info(0, 2, 1, 0), &[]).is_none());
+
+        let path = temp_path("glyph_cache_corrupt");
+        let _ = std::fs::remove_file(&path);
+        let font = embedded_font(b"font program D");
+        let key = GlyphCacheKey::new(font, 2, &Matrix::IDENTITY, 0, 0, 4);
+        {
+            let mut file = GlyphCacheFile::open(&path);
+            file.put_glyph(font, &key, &mask(4, 4));
+            file.flush().unwrap();
+        }
+
+        // Make the record's width huge, leaving its length alone
+        let mut bytes = std::fs::read(&path).unwrap();
+        let geometry: Vec<u8> = [4u32, 4, 1, 16]
+            .iter()
+            .flat_map(|v| v.to_le_bytes())
+            .collect();
+        let at = bytes.windows(16).position(|w| w == geometry).unwrap();
+        bytes[at..at + 4].copy_from_slice(&u32::MAX.to_le_bytes());
+        std::fs::write(&path, &bytes).unwrap();
+
+        let mut file = GlyphCacheFile::open(&path);
+        assert_eq!(file.len(), 1);
+        assert!(file.get_glyph(font, &key).is_none());
+        assert_eq!((file.hits, file.misses), (0, 1));
+
+        drop(file);
+        let _ = std::fs::remove_file(&path);
+        FONTS.remove(font);
+    }
+
+    #[test]
+    fn test_unknown_font_not_persisted() {
+        let mut file = GlyphCacheFile::open(temp_path("glyph_cache_unknown"));
+        let key = GlyphCacheKey::new(0xDEAD_BEEF, 1, &Matrix::IDENTITY, 0, 0, 4);
+        assert!(!file.put_glyph(0xDEAD_BEEF, &key, &mask(2, 2)));
+        assert_eq!(file.pending(), 0);
+    }
+
+    #[test]
+    fn test_ffi_glyph_cache_file() {
+        let path = temp_path("glyph_cache_ffi");
+        let c_path = CString::new(path.to_str().unwrap()).unwrap();
+        let font = embedded_font(b"font program D");
+        let ctm = Matrix::IDENTITY;
+        let pixmap = PIXMAPS.insert(mask(3, 3));
+
+        let file = fz_open_glyph_cache_file(0, c_path.as_ptr());
+        assert_ne!(file, 0);
+        assert_eq!(
+            fz_glyph_cache_file_put_glyph(0, file, font, 9, &ctm, 0, 0, 4, pixmap),
+            1
+        );
+        assert_eq!(
+            fz_glyph_cache_file_put_outline(0, file, font, 9, b"xy".as_ptr(), 2),
+            1
+        );
+        assert_eq!(fz_flush_glyph_cache_file(0, file), 0);
+        fz_drop_glyph_cache_file(0, file);
+
+        let file = fz_open_glyph_cache_file(0, c_path.as_ptr());
+        assert_eq!(fz_glyph_cache_file_count(0, file), 2);
+        let loaded = fz_glyph_cache_file_get_glyph(0, file, font, 9, &ctm, 0, 0, 4);
+        assert_ne!(loaded, 0);
+        let outline = fz_glyph_cache_file_get_outline(0, file, font, 9);
+        assert_ne!(outline, 0);
+        let (mut hits, mut misses) = (0, 0);
+        fz_glyph_cache_file_stats(0, file, &mut hits, &mut misses);
+        assert_eq!((hits, misses), (2, 0));
+
+        fz_drop_glyph_cache_file(0, file);
+        PIXMAPS.remove(pixmap);
+        PIXMAPS.remove(loaded);
+        BUFFERS.remove(outline);
+        FONTS.remove(font);
+        let _ = std::fs::remove_file(&path);
+    }
+}
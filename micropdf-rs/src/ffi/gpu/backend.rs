@@ -4,6 +4,7 @@
 //! factory functions for creating devices.
 
 use super::super::Handle;
+use super::batch::{GlyphAtlas, GpuBatch};
 use super::types::*;
 use crate::fitz::geometry::Matrix;
 
@@ -106,6 +107,19 @@ pub trait GpuDevice: Send + Sync {
         color: [f32; 4],
     ) -> GpuResult<()>;
 
+    /// Execute a batched display list on a texture
+    ///
+    /// Glyphs in `batch.new_glyphs` are rasterized into their `atlas` cells
+    /// and uploaded first, then the batch's images, then the draws run in
+    /// order with the stencil and clip state they describe. A backend that
+    /// can't execute batches returns `GpuError::NotSupported`.
+    fn draw_batch(
+        &self,
+        batch: &GpuBatch,
+        atlas: &GlyphAtlas,
+        target: &mut GpuTexture,
+    ) -> GpuResult<()>;
+
     // ========================================================================
     // Synchronization
     // ========================================================================
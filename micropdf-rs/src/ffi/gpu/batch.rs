@@ -0,0 +1,998 @@
+//! Display List Batching
+//!
+//! Turns display list playback into GPU draw calls that every backend
+//! executes the same way:
+//!
+//! - Paths are flattened and stroked by the CPU rasterizer's outliner, then
+//!   tessellated. A fill that is one convex polygon is drawn directly as
+//!   triangles; anything else is drawn stencil-and-cover: its triangle fan
+//!   marks coverage in the stencil buffer under its fill rule, and a quad
+//!   over its bounds paints the colour where the stencil is set.
+//! - Text is drawn as quads from a glyph atlas kept per GPU device, so a
+//!   glyph is rasterized and uploaded once, then reused by every later list.
+//! - Images are drawn as textured quads. Baseline JPEGs are only
+//!   entropy-decoded on the CPU: their quantized blocks go to the device,
+//!   which dequantizes, runs the inverse DCT at the reduced size the image
+//!   is drawn at, upsamples chroma and converts YCbCr and CMYK to RGB.
+//!   Other formats, and JPEGs for devices without compute shaders, are
+//!   decoded on the CPU and uploaded, and the device scales them down to
+//!   their size on the target.
+//! - Transparency groups are composited from offscreen targets.
+//!
+//! Consecutive direct fills and glyph runs share a draw call, so a page is
+//! a few dozen draws rather than one per operation.
+
+use super::super::draw_device::{line_style, linear, path_ops, rgba};
+use super::super::rasterize;
+use super::types::GpuBlendMode;
+use crate::fitz::colorspace::Colorspace;
+use crate::fitz::device::{BlendMode, Device};
+use crate::fitz::font::Font;
+use crate::fitz::geometry::{Matrix, Point, Rect};
+use crate::fitz::image::{Image, ImageFormat};
+use crate::fitz::path::{Path, StrokeState};
+use crate::fitz::text::Text;
+use crate::pdf::filter::{JpegCoefficients, decode_dct_coefficients};
+use std::collections::HashMap;
+use std::ops::Range;
+use std::sync::Arc;
+
+// ============================================================================
+// Batch
+// ============================================================================
+
+/// Vertex of a batched draw, in target pixels
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq)]
+pub struct GpuVertex {
+    /// Position in target pixels, y down
+    pub position: [f32; 2],
+    /// Texture coordinate, 0 to 1 (unused by untextured draws)
+    pub texcoord: [f32; 2],
+    /// Colour as RGBA, not premultiplied
+    pub color: [f32; 4],
+}
+
+/// What a draw call does with its vertices
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum GpuDrawKind {
+    /// Coloured triangles, drawn directly
+    Solid,
+    /// Triangles marking coverage in the stencil buffer only
+    Stencil {
+        /// Invert per triangle rather than count winding
+        even_odd: bool,
+    },
+    /// Quads painting their colour where the stencil is set, clearing it
+    Cover,
+    /// Quads sampling coverage from a glyph atlas page, times their colour
+    Glyphs {
+        /// Atlas page
+        page: usize,
+    },
+    /// Quad sampling an image, times its alpha
+    Image {
+        /// Index into [`GpuBatch::images`]
+        image: usize,
+    },
+    /// Quad painting its colour through an image's coverage
+    ImageMask {
+        /// Index into [`GpuBatch::images`]
+        image: usize,
+    },
+    /// Triangles marking a new clip level, under a fill rule
+    Clip {
+        /// Invert per triangle rather than count winding
+        even_odd: bool,
+    },
+    /// Drop the innermost clip level
+    PopClip,
+    /// Start drawing into an offscreen target
+    BeginGroup {
+        /// How the group composites onto what is below
+        blend: GpuBlendMode,
+        /// Constant opacity of the group
+        alpha: f32,
+        /// Start from transparent rather than a copy of the backdrop
+        isolated: bool,
+    },
+    /// Composite the innermost offscreen target onto its parent
+    EndGroup,
+}
+
+/// Draw call over a range of [`GpuBatch::vertices`]
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct GpuDraw {
+    pub kind: GpuDrawKind,
+    /// First vertex
+    pub first: u32,
+    /// Vertex count, three per triangle
+    pub count: u32,
+}
+
+/// Draw calls for one display list, ready for a backend to execute
+#[derive(Default)]
+pub struct GpuBatch {
+    /// Target width in pixels
+    pub width: u32,
+    /// Target height in pixels
+    pub height: u32,
+    pub vertices: Vec<GpuVertex>,
+    pub draws: Vec<GpuDraw>,
+    /// Images drawn, made into textures before the draws run
+    pub images: Vec<GpuImage>,
+    /// Atlas glyphs first used by this batch, to rasterize and upload
+    pub new_glyphs: Range<usize>,
+    /// Operations drawn approximately or skipped: soft masks, tiles, text
+    /// and image-mask clips, stroked text, non-separable blend modes
+    pub fallbacks: usize,
+}
+
+/// Where an image texture's pixels come from
+pub enum GpuImageSource {
+    /// Entropy-decoded JPEG, reconstructed on the device at 1/2^`l2factor`
+    /// size, as [`JpegCoefficients::reconstruct`] does on the CPU; only
+    /// batched for devices with compute shaders (see
+    /// [`BatchDevice::decode_jpeg_on_cpu`])
+    Jpeg {
+        coefficients: JpegCoefficients,
+        l2factor: u32,
+    },
+    /// An image the device can't decode, whose samples are decoded on the
+    /// CPU and uploaded as `fz_gpu_texture_upload` does
+    Decoded(Image),
+}
+
+/// Image texture for a batch
+pub struct GpuImage {
+    pub source: GpuImageSource,
+    /// Texture size: no larger than the image, nor than it is drawn
+    pub width: u32,
+    pub height: u32,
+    /// Samples are CMYK, converted to RGB on the device
+    pub cmyk: bool,
+}
+
+impl GpuImage {
+    /// Texture for `image` drawn under `ctm`, leaving JPEGs to the device
+    /// if `device_jpeg`
+    fn new(image: &Image, ctm: &Matrix, device_jpeg: bool) -> Self {
+        let drawn_w = ctm.a.hypot(ctm.b).ceil().max(1.0) as i32;
+        let drawn_h = ctm.c.hypot(ctm.d).ceil().max(1.0) as i32;
+        if device_jpeg && image.format() == ImageFormat::Jpeg {
+            if let Ok(coefficients) = decode_dct_coefficients(image.data()) {
+                // The most reduced transform still at least the drawn size
+                let (w, h) = (coefficients.width as i32, coefficients.height as i32);
+                let l2factor = (0..=3)
+                    .rev()
+                    .find(|&k| w >> k >= drawn_w && h >> k >= drawn_h)
+                    .unwrap_or(0);
+                return Self {
+                    width: coefficients.width.div_ceil(1 << l2factor),
+                    height: coefficients.height.div_ceil(1 << l2factor),
+                    cmyk: coefficients.components.len() == 4,
+                    source: GpuImageSource::Jpeg {
+                        coefficients,
+                        l2factor,
+                    },
+                };
+            }
+        }
+        Self {
+            width: image.width().min(drawn_w).max(1) as u32,
+            height: image.height().min(drawn_h).max(1) as u32,
+            cmyk: image.n() == 4,
+            source: GpuImageSource::Decoded(image.clone()),
+        }
+    }
+}
+
+impl GpuBatch {
+    /// Append `vertices` as a draw of `kind`, extending the last draw if it
+    /// is of the same kind and can be merged
+    fn push(&mut self, kind: GpuDrawKind, vertices: &[GpuVertex]) {
+        let first = self.vertices.len() as u32;
+        let count = vertices.len() as u32;
+        self.vertices.extend_from_slice(vertices);
+        if let Some(last) = self.draws.last_mut() {
+            let mergeable = matches!(kind, GpuDrawKind::Solid | GpuDrawKind::Glyphs { .. });
+            if mergeable && last.kind == kind && last.first + last.count == first {
+                last.count += count;
+                return;
+            }
+        }
+        self.draws.push(GpuDraw { kind, first, count });
+    }
+
+    fn push_state(&mut self, kind: GpuDrawKind) {
+        self.push(kind, &[]);
+    }
+}
+
+// ============================================================================
+// Glyph Atlas
+// ============================================================================
+
+/// Largest atlas page side
+const MAX_ATLAS_SIZE: u32 = 2048;
+
+/// Subpixel positions per pixel along the baseline
+const SUBPIXEL_STEPS: f32 = 4.0;
+
+/// Atlas cell reserved for a glyph
+///
+/// The backend rasterizes the glyph into its cell, with the glyph origin at
+/// `origin` inside it, under `transform` from glyph space to pixels.
+#[derive(Debug, Clone)]
+pub struct AtlasGlyph {
+    pub font: Arc<Font>,
+    pub gid: u16,
+    /// Linear glyph-space to pixel transform [a, b, c, d]
+    pub transform: [f32; 4],
+    /// Glyph origin inside the cell, in pixels
+    pub origin: (f32, f32),
+    pub page: usize,
+    /// Cell position and size on the page, in pixels
+    pub x: u32,
+    pub y: u32,
+    pub w: u32,
+    pub h: u32,
+}
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+struct GlyphKey {
+    /// Address of the font, kept alive by the atlas
+    font: usize,
+    gid: u16,
+    /// Linear transform in 1/64ths
+    transform: [i32; 4],
+    /// Subpixel position along x, in steps
+    subpixel: u8,
+}
+
+/// Row of cells of the same height class on the current page
+#[derive(Debug, Clone, Copy)]
+struct Shelf {
+    y: u32,
+    height: u32,
+    x: u32,
+}
+
+/// Glyph cells shelf-packed into square pages
+#[derive(Debug)]
+pub struct GlyphAtlas {
+    page_size: u32,
+    pages: usize,
+    shelves: Vec<Shelf>,
+    slots: HashMap<GlyphKey, usize>,
+    glyphs: Vec<AtlasGlyph>,
+    /// Glyphs before this have been uploaded
+    uploaded: usize,
+}
+
+impl GlyphAtlas {
+    /// Create an atlas with pages no larger than `max_texture_size`
+    pub fn new(max_texture_size: u32) -> Self {
+        Self {
+            page_size: max_texture_size.clamp(64, MAX_ATLAS_SIZE),
+            pages: 1,
+            shelves: Vec::new(),
+            slots: HashMap::new(),
+            glyphs: Vec::new(),
+            uploaded: 0,
+        }
+    }
+
+    /// Side of a page in pixels
+    pub fn page_size(&self) -> u32 {
+        self.page_size
+    }
+
+    /// Number of pages in use
+    pub fn pages(&self) -> usize {
+        self.pages
+    }
+
+    /// Every glyph with a cell, in the order they were added
+    pub fn glyphs(&self) -> &[AtlasGlyph] {
+        &self.glyphs
+    }
+
+    /// Record that the glyphs before `end` are on the GPU
+    pub fn mark_uploaded(&mut self, end: usize) {
+        self.uploaded = self.uploaded.max(end.min(self.glyphs.len()));
+    }
+
+    /// Reserve a `w` by `h` cell, starting a page when this one is full
+    fn allocate(&mut self, w: u32, h: u32) -> Option<(usize, u32, u32)> {
+        if w > self.page_size || h > self.page_size {
+            return None;
+        }
+        // Round heights up so similar glyphs share shelves
+        let height = h.next_multiple_of(4).min(self.page_size);
+        let size = self.page_size;
+        if let Some(shelf) = self
+            .shelves
+            .iter_mut()
+            .find(|s| s.height == height && s.x + w <= size)
+        {
+            shelf.x += w;
+            return Some((self.pages - 1, shelf.x - w, shelf.y));
+        }
+        let top = self.shelves.last().map_or(0, |s| s.y + s.height);
+        if top + height > size {
+            self.pages += 1;
+            self.shelves.clear();
+            return self.allocate(w, h);
+        }
+        self.shelves.push(Shelf {
+            y: top,
+            height,
+            x: w,
+        });
+        Some((self.pages - 1, 0, top))
+    }
+
+    /// Cell for `gid` of `font` under `transform` at `subpixel` steps along,
+    /// reserving one if it has none
+    fn glyph(
+        &mut self,
+        font: &Arc<Font>,
+        gid: u16,
+        transform: [f32; 4],
+        subpixel: u8,
+    ) -> Option<usize> {
+        let key = GlyphKey {
+            font: Arc::as_ptr(font) as usize,
+            gid,
+            transform: transform.map(|v| (v * 64.0).round() as i32),
+            subpixel,
+        };
+        if let Some(&slot) = self.slots.get(&key) {
+            return Some(slot);
+        }
+        let bbox = font.glyph_bbox(gid);
+        let shift = f32::from(subpixel) / SUBPIXEL_STEPS;
+        let [a, b, c, d] = transform;
+        let corners = [
+            (bbox.x0, bbox.y0),
+            (bbox.x1, bbox.y0),
+            (bbox.x1, bbox.y1),
+            (bbox.x0, bbox.y1),
+        ]
+        .map(|(x, y)| (a * x + c * y + shift, b * x + d * y));
+        let fold = |f: fn(f32, f32) -> f32, init: f32, pick: fn(&(f32, f32)) -> f32| {
+            corners.iter().map(pick).fold(init, f)
+        };
+        // One pixel of padding keeps bilinear samples inside the cell
+        let left = fold(f32::min, f32::MAX, |p| p.0).floor() - 1.0;
+        let top = fold(f32::min, f32::MAX, |p| p.1).floor() - 1.0;
+        let right = fold(f32::max, f32::MIN, |p| p.0).ceil() + 1.0;
+        let bottom = fold(f32::max, f32::MIN, |p| p.1).ceil() + 1.0;
+        if !(left.is_finite() && top.is_finite() && right.is_finite() && bottom.is_finite()) {
+            return None;
+        }
+        let (w, h) = ((right - left) as u32, (bottom - top) as u32);
+        let (page, x, y) = self.allocate(w, h)?;
+        self.glyphs.push(AtlasGlyph {
+            font: Arc::clone(font),
+            gid,
+            transform,
+            origin: (shift - left, -top),
+            page,
+            x,
+            y,
+            w,
+            h,
+        });
+        self.slots.insert(key, self.glyphs.len() - 1);
+        Some(self.glyphs.len() - 1)
+    }
+}
+
+// ============================================================================
+// Batching Device
+// ============================================================================
+
+fn gpu_blend(mode: BlendMode) -> Option<GpuBlendMode> {
+    Some(match mode {
+        BlendMode::Normal => GpuBlendMode::Normal,
+        BlendMode::Multiply => GpuBlendMode::Multiply,
+        BlendMode::Screen => GpuBlendMode::Screen,
+        BlendMode::Overlay => GpuBlendMode::Overlay,
+        BlendMode::Darken => GpuBlendMode::Darken,
+        BlendMode::Lighten => GpuBlendMode::Lighten,
+        BlendMode::ColorDodge => GpuBlendMode::ColorDodge,
+        BlendMode::ColorBurn => GpuBlendMode::ColorBurn,
+        BlendMode::HardLight => GpuBlendMode::HardLight,
+        BlendMode::SoftLight => GpuBlendMode::SoftLight,
+        BlendMode::Difference => GpuBlendMode::Difference,
+        BlendMode::Exclusion => GpuBlendMode::Exclusion,
+        _ => return None,
+    })
+}
+
+/// Whether a closed polygon is convex and winds once, so its fan needs no
+/// stencil: every turn goes the same way and x changes direction at most
+/// twice
+fn is_convex(points: &[(f32, f32)]) -> bool {
+    let n = points.len();
+    let (mut turn, mut reversals, mut heading) = (0.0f32, 0, 0.0f32);
+    for i in 0..n {
+        let (a, b, c) = (points[i], points[(i + 1) % n], points[(i + 2) % n]);
+        let cross = (b.0 - a.0) * (c.1 - b.1) - (b.1 - a.1) * (c.0 - b.0);
+        if cross != 0.0 {
+            if turn * cross < 0.0 {
+                return false;
+            }
+            turn = cross;
+        }
+        let dx = b.0 - a.0;
+        if dx != 0.0 {
+            if heading * dx < 0.0 {
+                reversals += 1;
+            }
+            heading = dx;
+        }
+    }
+    // The loop closes back on the first heading
+    reversals <= 2
+}
+
+fn vertex(position: (f32, f32), texcoord: (f32, f32), color: [f32; 4]) -> GpuVertex {
+    GpuVertex {
+        position: [position.0, position.1],
+        texcoord: [texcoord.0, texcoord.1],
+        color,
+    }
+}
+
+/// Triangle fans of `polygons`, pivoting on each one's first point
+fn fans(polygons: &[Vec<(f32, f32)>], color: [f32; 4]) -> Vec<GpuVertex> {
+    let mut out = Vec::new();
+    for polygon in polygons {
+        let pivot = polygon[0];
+        for pair in polygon[1..].windows(2) {
+            for p in [pivot, pair[0], pair[1]] {
+                out.push(vertex(p, (0.0, 0.0), color));
+            }
+        }
+    }
+    out
+}
+
+/// Two triangles covering the quad `corners`, with texcoords `uv`
+fn quad(corners: [(f32, f32); 4], uv: [(f32, f32); 4], color: [f32; 4]) -> [GpuVertex; 6] {
+    [0, 1, 2, 0, 2, 3].map(|i| vertex(corners[i], uv[i], color))
+}
+
+fn rect_corners(r: Rect) -> [(f32, f32); 4] {
+    [(r.x0, r.y0), (r.x1, r.y0), (r.x1, r.y1), (r.x0, r.y1)]
+}
+
+/// Device that batches what is drawn on it for a GPU backend
+pub struct BatchDevice<'a> {
+    batch: GpuBatch,
+    atlas: &'a mut GlyphAtlas,
+    /// Soft masks being defined; their content isn't drawn
+    masks: usize,
+    /// JPEGs go to the device as coefficients
+    device_jpeg: bool,
+}
+
+impl<'a> BatchDevice<'a> {
+    /// Batch for a `width` by `height` target, drawing text from `atlas`
+    pub fn new(width: u32, height: u32, atlas: &'a mut GlyphAtlas) -> Self {
+        Self {
+            batch: GpuBatch {
+                width,
+                height,
+                ..Default::default()
+            },
+            atlas,
+            masks: 0,
+            device_jpeg: true,
+        }
+    }
+
+    /// Decode JPEGs on the CPU like other images, for a device without
+    /// the compute shaders that reconstruct them from coefficients
+    pub fn decode_jpeg_on_cpu(&mut self) {
+        self.device_jpeg = false;
+    }
+
+    /// The batched draws
+    pub fn finish(mut self) -> GpuBatch {
+        self.batch.new_glyphs = self.atlas.uploaded..self.atlas.glyphs.len();
+        self.batch
+    }
+
+    fn target(&self) -> Rect {
+        Rect::new(0.0, 0.0, self.batch.width as f32, self.batch.height as f32)
+    }
+
+    /// Bounds of `polygons` on the target, if they touch it
+    fn visible(&self, polygons: &[Vec<(f32, f32)>]) -> Option<Rect> {
+        let mut r = Rect::new(f32::MAX, f32::MAX, f32::MIN, f32::MIN);
+        for &(x, y) in polygons.iter().flatten() {
+            r = Rect::new(r.x0.min(x), r.y0.min(y), r.x1.max(x), r.y1.max(y));
+        }
+        let target = self.target();
+        let r = Rect::new(
+            r.x0.max(target.x0),
+            r.y0.max(target.y0),
+            r.x1.min(target.x1),
+            r.y1.min(target.y1),
+        );
+        (r.x0 < r.x1 && r.y0 < r.y1).then_some(r)
+    }
+
+    fn paint_outline(&mut self, polygons: Vec<Vec<(f32, f32)>>, even_odd: bool, color: [f32; 4]) {
+        if self.masks > 0 {
+            return;
+        }
+        let Some(bounds) = self.visible(&polygons) else {
+            return;
+        };
+        if polygons.len() == 1 && is_convex(&polygons[0]) {
+            self.batch.push(GpuDrawKind::Solid, &fans(&polygons, color));
+            return;
+        }
+        self.batch.push(
+            GpuDrawKind::Stencil { even_odd },
+            &fans(&polygons, [0.0; 4]),
+        );
+        self.batch.push(
+            GpuDrawKind::Cover,
+            &quad(rect_corners(bounds), [(0.0, 0.0); 4], color),
+        );
+    }
+
+    fn push_clip(&mut self, polygons: Vec<Vec<(f32, f32)>>, even_odd: bool) {
+        self.batch
+            .push(GpuDrawKind::Clip { even_odd }, &fans(&polygons, [0.0; 4]));
+    }
+
+    fn push_clip_rect(&mut self, r: Rect) {
+        self.batch.fallbacks += 1;
+        self.push_clip(vec![rect_corners(r).to_vec()], false);
+    }
+
+    fn image_quad(&mut self, image: &Image, ctm: &Matrix, mask: Option<[f32; 4]>, alpha: f32) {
+        if self.masks > 0 {
+            return;
+        }
+        let unit = [(0.0, 0.0), (1.0, 0.0), (1.0, 1.0), (0.0, 1.0)];
+        let corners = unit.map(|(x, y)| {
+            let p = ctm.transform_point(Point::new(x, y));
+            (p.x, p.y)
+        });
+        if self.visible(&[corners.to_vec()]).is_none() {
+            return;
+        }
+        // Image rows run top down, unit space bottom up
+        let uv = [(0.0, 1.0), (1.0, 1.0), (1.0, 0.0), (0.0, 0.0)];
+        let index = self.batch.images.len();
+        let texture = GpuImage::new(image, ctm, self.device_jpeg);
+        self.batch.images.push(texture);
+        let (kind, color) = match mask {
+            Some(color) => (GpuDrawKind::ImageMask { image: index }, color),
+            None => (GpuDrawKind::Image { image: index }, [1.0, 1.0, 1.0, alpha]),
+        };
+        self.batch.push(kind, &quad(corners, uv, color));
+    }
+}
+
+impl Device for BatchDevice<'_> {
+    fn fill_path(
+        &mut self,
+        path: &Path,
+        even_odd: bool,
+        ctm: &Matrix,
+        colorspace: &Colorspace,
+        color: &[f32],
+        alpha: f32,
+    ) {
+        let polygons = rasterize::outline(&path_ops(path), &linear(ctm), None);
+        self.paint_outline(polygons, even_odd, rgba(colorspace, color, alpha));
+    }
+
+    fn stroke_path(
+        &mut self,
+        path: &Path,
+        stroke: &StrokeState,
+        ctm: &Matrix,
+        colorspace: &Colorspace,
+        color: &[f32],
+        alpha: f32,
+    ) {
+        let style = line_style(stroke, ctm);
+        let polygons = rasterize::outline(&path_ops(path), &style.ctm, Some(&style));
+        self.paint_outline(polygons, false, rgba(colorspace, color, alpha));
+    }
+
+    fn clip_path(&mut self, path: &Path, even_odd: bool, ctm: &Matrix, _scissor: Rect) {
+        let polygons = rasterize::outline(&path_ops(path), &linear(ctm), None);
+        self.push_clip(polygons, even_odd);
+    }
+
+    fn clip_stroke_path(&mut self, path: &Path, stroke: &StrokeState, ctm: &Matrix, _: Rect) {
+        let style = line_style(stroke, ctm);
+        let polygons = rasterize::outline(&path_ops(path), &style.ctm, Some(&style));
+        self.push_clip(polygons, false);
+    }
+
+    fn fill_text(
+        &mut self,
+        text: &Text,
+        ctm: &Matrix,
+        colorspace: &Colorspace,
+        color: &[f32],
+        alpha: f32,
+    ) {
+        if self.masks > 0 {
+            return;
+        }
+        let color = rgba(colorspace, color, alpha);
+        let size = self.atlas.page_size as f32;
+        for span in text.spans() {
+            let m = span.trm.concat(ctm);
+            let transform = [m.a, m.b, m.c, m.d];
+            for item in span.items() {
+                let Ok(gid) = u16::try_from(item.gid) else {
+                    continue;
+                };
+                let pen = ctm.transform_point(Point::new(item.x, item.y));
+                let steps = ((pen.x - pen.x.floor()) * SUBPIXEL_STEPS).round();
+                let x = pen.x.floor() + (steps / SUBPIXEL_STEPS).floor();
+                let subpixel = (steps as u8) % SUBPIXEL_STEPS as u8;
+                let y = pen.y.round();
+                let Some(slot) = self.atlas.glyph(&span.font, gid, transform, subpixel) else {
+                    self.batch.fallbacks += 1;
+                    continue;
+                };
+                let g = &self.atlas.glyphs[slot];
+                let (x0, y0) = (
+                    x - (g.origin.0 - f32::from(subpixel) / SUBPIXEL_STEPS),
+                    y - g.origin.1,
+                );
+                let cell = Rect::new(x0, y0, x0 + g.w as f32, y0 + g.h as f32);
+                let uv = Rect::new(
+                    g.x as f32 / size,
+                    g.y as f32 / size,
+                    (g.x + g.w) as f32 / size,
+                    (g.y + g.h) as f32 / size,
+                );
+                let page = g.page;
+                self.batch.push(
+                    GpuDrawKind::Glyphs { page },
+                    &quad(rect_corners(cell), rect_corners(uv), color),
+                );
+            }
+        }
+    }
+
+    fn stroke_text(
+        &mut self,
+        _: &Text,
+        _: &StrokeState,
+        _: &Matrix,
+        _: &Colorspace,
+        _: &[f32],
+        _: f32,
+    ) {
+        self.batch.fallbacks += 1;
+    }
+
+    fn clip_text(&mut self, text: &Text, ctm: &Matrix, _: Rect) {
+        self.push_clip_rect(text.bounds(None, ctm));
+    }
+
+    fn clip_stroke_text(&mut self, text: &Text, stroke: &StrokeState, ctm: &Matrix, _: Rect) {
+        self.push_clip_rect(text.bounds(Some(stroke), ctm));
+    }
+
+    fn ignore_text(&mut self, _: &Text, _: &Matrix) {}
+
+    fn fill_image(&mut self, image: &Image, ctm: &Matrix, alpha: f32) {
+        self.image_quad(image, ctm, None, alpha);
+    }
+
+    fn fill_image_mask(
+        &mut self,
+        image: &Image,
+        ctm: &Matrix,
+        colorspace: &Colorspace,
+        color: &[f32],
+        alpha: f32,
+    ) {
+        let color = rgba(colorspace, color, alpha);
+        self.image_quad(image, ctm, Some(color), alpha);
+    }
+
+    fn clip_image_mask(&mut self, _: &Image, ctm: &Matrix, _: Rect) {
+        let unit = Rect::new(0.0, 0.0, 1.0, 1.0);
+        self.push_clip_rect(unit.transform(ctm));
+    }
+
+    fn pop_clip(&mut self) {
+        self.batch.push_state(GpuDrawKind::PopClip);
+    }
+
+    fn begin_mask(&mut self, _: Rect, _: bool, _: &Colorspace, _: &[f32]) {
+        self.masks += 1;
+    }
+
+    fn end_mask(&mut self) {
+        // What the mask covers is clipped to its area; it is popped like
+        // any other clip
+        self.masks = self.masks.saturating_sub(1);
+        self.push_clip_rect(self.target());
+    }
+
+    fn begin_group(
+        &mut self,
+        _: Rect,
+        _: Option<&Colorspace>,
+        isolated: bool,
+        _knockout: bool,
+        blendmode: BlendMode,
+        alpha: f32,
+    ) {
+        let blend = gpu_blend(blendmode).unwrap_or_else(|| {
+            self.batch.fallbacks += 1;
+            GpuBlendMode::Normal
+        });
+        self.batch.push_state(GpuDrawKind::BeginGroup {
+            blend,
+            alpha,
+            isolated,
+        });
+    }
+
+    fn end_group(&mut self) {
+        self.batch.push_state(GpuDrawKind::EndGroup);
+    }
+
+    fn begin_tile(&mut self, _: Rect, _: Rect, _: f32, _: f32, _: &Matrix) -> i32 {
+        // The cell is drawn once, where it is
+        self.batch.fallbacks += 1;
+        0
+    }
+
+    fn end_tile(&mut self) {}
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn black() -> (Colorspace, [f32; 1]) {
+        (Colorspace::device_gray(), [0.0])
+    }
+
+    #[test]
+    fn test_rectangles_share_one_draw() {
+        let mut atlas = GlyphAtlas::new(1024);
+        let mut device = BatchDevice::new(100, 100, &mut atlas);
+        let (cs, color) = black();
+        for i in 0..3 {
+            let mut path = Path::new();
+            path.rect(Rect::new(i as f32 * 10.0, 0.0, i as f32 * 10.0 + 5.0, 5.0));
+            device.fill_path(&path, false, &Matrix::IDENTITY, &cs, &color, 1.0);
+        }
+        // Off the target
+        let mut path = Path::new();
+        path.rect(Rect::new(200.0, 0.0, 210.0, 5.0));
+        device.fill_path(&path, false, &Matrix::IDENTITY, &cs, &color, 1.0);
+
+        let batch = device.finish();
+        assert_eq!(batch.draws.len(), 1);
+        assert_eq!(batch.draws[0].kind, GpuDrawKind::Solid);
+        assert_eq!(batch.draws[0].count as usize, batch.vertices.len());
+        assert_eq!(batch.vertices.len() % 3, 0);
+    }
+
+    #[test]
+    fn test_concave_fill_is_stencilled_then_covered() {
+        let mut atlas = GlyphAtlas::new(1024);
+        let mut device = BatchDevice::new(100, 100, &mut atlas);
+        let (cs, color) = black();
+        // Five-pointed star
+        let mut path = Path::new();
+        for k in 0..5 {
+            let angle = (k * 2 % 5) as f32 * std::f32::consts::TAU / 5.0;
+            let p = Point::new(50.0 + 40.0 * angle.sin(), 50.0 - 40.0 * angle.cos());
+            if k == 0 {
+                path.move_to(p)
+            } else {
+                path.line_to(p)
+            }
+        }
+        path.close();
+        device.fill_path(&path, true, &Matrix::IDENTITY, &cs, &color, 1.0);
+
+        let batch = device.finish();
+        let kinds: Vec<_> = batch.draws.iter().map(|d| d.kind).collect();
+        assert_eq!(
+            kinds,
+            [GpuDrawKind::Stencil { even_odd: true }, GpuDrawKind::Cover]
+        );
+        assert_eq!(batch.draws[1].count, 6);
+    }
+
+    #[test]
+    fn test_glyphs_are_atlased_once() {
+        let font = Arc::new(Font::new("Test"));
+        let mut text = Text::new();
+        let mut span =
+            crate::fitz::text::TextSpan::new(font, Matrix::new(12.0, 0.0, 0.0, -12.0, 0.0, 0.0));
+        for x in [10.0, 30.0, 50.25] {
+            span.add_glyph(crate::fitz::text::TextItem::new(x, 40.0, 7, 65));
+        }
+        text.add_span(span);
+        let (cs, color) = black();
+
+        let mut atlas = GlyphAtlas::new(1024);
+        let batch = {
+            let mut device = BatchDevice::new(100, 100, &mut atlas);
+            device.fill_text(&text, &Matrix::IDENTITY, &cs, &color, 1.0);
+            device.finish()
+        };
+        // The glyph off the pixel grid gets its own subpixel cell
+        assert_eq!(batch.new_glyphs, 0..2);
+        assert_eq!(batch.draws.len(), 1);
+        assert_eq!(batch.draws[0].kind, GpuDrawKind::Glyphs { page: 0 });
+        assert_eq!(batch.vertices.len(), 18);
+        atlas.mark_uploaded(batch.new_glyphs.end);
+
+        let mut device = BatchDevice::new(100, 100, &mut atlas);
+        device.fill_text(&text, &Matrix::IDENTITY, &cs, &color, 1.0);
+        let again = device.finish();
+        assert!(again.new_glyphs.is_empty());
+        assert_eq!(atlas.glyphs().len(), 2);
+    }
+
+    #[test]
+    fn test_atlas_starts_pages_when_full() {
+        let font = Arc::new(Font::new("Test"));
+        let mut atlas = GlyphAtlas::new(64);
+        for gid in 0..40 {
+            assert!(
+                atlas
+                    .glyph(&font, gid, [20.0, 0.0, 0.0, -20.0], 0)
+                    .is_some()
+            );
+        }
+        assert!(atlas.pages() > 1);
+        let page = |g: &AtlasGlyph| g.page;
+        let glyphs = atlas.glyphs();
+        for (i, a) in glyphs.iter().enumerate() {
+            assert!(a.x + a.w <= 64 && a.y + a.h <= 64);
+            for b in &glyphs[i + 1..] {
+                let apart = page(a) != page(b)
+                    || a.x + a.w <= b.x
+                    || b.x + b.w <= a.x
+                    || a.y + a.h <= b.y
+                    || b.y + b.h <= a.y;
+                assert!(apart);
+            }
+        }
+    }
+
+    /// A flat 64 x 48 baseline JPEG
+    fn flat_jpeg() -> Image {
+        use crate::pdf::filter::dct_scaled::tests::TestJpeg;
+        let flat = |ci: usize, _bx: usize, _by: usize| {
+            let mut coef = [0; 64];
+            coef[0] = if ci == 0 { 1016 } else { 0 };
+            coef
+        };
+        let data = TestJpeg::encode(64, 48, &[(2, 2), (1, 1), (1, 1)], 0, flat);
+        Image::from_compressed(
+            64,
+            48,
+            8,
+            Some(Colorspace::device_rgb()),
+            ImageFormat::Jpeg,
+            data,
+        )
+        .unwrap()
+    }
+
+    #[test]
+    fn test_jpeg_goes_to_the_device_as_coefficients() {
+        let image = flat_jpeg();
+        let mut atlas = GlyphAtlas::new(1024);
+        let mut device = BatchDevice::new(100, 100, &mut atlas);
+        // Drawn at 16 x 10 pixels: the quarter-size transform is enough
+        device.fill_image(&image, &Matrix::new(16.0, 0.0, 0.0, 10.0, 0.0, 0.0), 1.0);
+        let batch = device.finish();
+
+        let texture = &batch.images[0];
+        assert_eq!((texture.width, texture.height), (16, 12));
+        let GpuImageSource::Jpeg {
+            coefficients,
+            l2factor,
+        } = &texture.source
+        else {
+            panic!("decoded on the CPU");
+        };
+        assert_eq!(*l2factor, 2);
+        assert!(coefficients.is_ycc() && !texture.cmyk);
+        let reference = coefficients.reconstruct(*l2factor).unwrap();
+        assert_eq!((reference.width, reference.height), (16, 12));
+
+        // The reduced reconstruction the device mirrors has the pixels of
+        // the full-size decode
+        let full = coefficients.reconstruct(0).unwrap();
+        assert_eq!(full.components, 3);
+        assert_ne!(full.samples[..3], [0, 0, 0]);
+        assert!(full.samples.iter().all(|&s| s == full.samples[0]));
+        assert!(
+            reference
+                .samples
+                .iter()
+                .all(|&s| s.abs_diff(full.samples[0]) <= 1)
+        );
+    }
+
+    #[test]
+    fn test_jpeg_decoded_on_the_cpu_without_compute() {
+        let image = flat_jpeg();
+        let mut atlas = GlyphAtlas::new(1024);
+        let mut device = BatchDevice::new(100, 100, &mut atlas);
+        device.decode_jpeg_on_cpu();
+        device.fill_image(&image, &Matrix::new(16.0, 0.0, 0.0, 10.0, 0.0, 0.0), 1.0);
+        let batch = device.finish();
+
+        // Uploaded as decoded samples, never as coefficients
+        let texture = &batch.images[0];
+        let GpuImageSource::Decoded(decoded) = &texture.source else {
+            panic!("left to the device");
+        };
+        assert_eq!(decoded.data(), image.data());
+        assert_eq!((texture.width, texture.height), (16, 10));
+    }
+
+    #[test]
+    fn test_groups_and_images() {
+        let mut atlas = GlyphAtlas::new(1024);
+        let mut device = BatchDevice::new(100, 100, &mut atlas);
+        let image = Image::new(2, 2, None);
+        let full = Rect::new(0.0, 0.0, 100.0, 100.0);
+        device.begin_group(full, None, true, false, BlendMode::Multiply, 0.5);
+        device.fill_image(&image, &Matrix::new(50.0, 0.0, 0.0, 50.0, 10.0, 10.0), 1.0);
+        device.end_group();
+        device.begin_group(full, None, true, false, BlendMode::Luminosity, 1.0);
+        device.end_group();
+
+        let batch = device.finish();
+        assert_eq!(batch.images.len(), 1);
+        // Scaled to its drawn size, at most the image's
+        assert_eq!((batch.images[0].width, batch.images[0].height), (2, 2));
+        assert_eq!(
+            batch.draws.iter().map(|d| d.kind).collect::<Vec<_>>(),
+            [
+                GpuDrawKind::BeginGroup {
+                    blend: GpuBlendMode::Multiply,
+                    alpha: 0.5,
+                    isolated: true
+                },
+                GpuDrawKind::Image { image: 0 },
+                GpuDrawKind::EndGroup,
+                GpuDrawKind::BeginGroup {
+                    blend: GpuBlendMode::Normal,
+                    alpha: 1.0,
+                    isolated: true
+                },
+                GpuDrawKind::EndGroup,
+            ]
+        );
+        assert_eq!(batch.fallbacks, 1);
+    }
+}
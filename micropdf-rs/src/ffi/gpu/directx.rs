@@ -4,6 +4,7 @@
 
 use super::super::Handle;
 use super::backend::GpuDevice;
+use super::batch::{GlyphAtlas, GpuBatch};
 use super::types::*;
 use crate::fitz::geometry::Matrix;
 
@@ -179,6 +180,25 @@ impl GpuDevice for DirectX11Device {
         Ok(())
     }
 
+    fn draw_batch(
+        &self,
+        batch: &GpuBatch,
+        atlas: &GlyphAtlas,
+        target: &mut GpuTexture,
+    ) -> GpuResult<()> {
+        // 1. UpdateSubresource for new glyph cells
+        // 2. JPEG images: IDCT and color compute shaders over a structured buffer of blocks; others upload and downscale
+        // 3. Upload vertices to one vertex buffer
+        // 4. Bind target RTV with a depth-stencil view
+        // 5. Set the pipeline and depth-stencil state per draw kind
+        // 6. Draw(count, first) for each draw
+        // 7. Groups: offscreen render target, composited with the blend shader
+        // Until the steps above are wired to the API, fail rather than
+        // report a render that never happened
+        let _ = (batch, atlas, target);
+        Err(GpuError::NotSupported("Direct3D 11 batched draws".into()))
+    }
+
     fn flush(&self) -> GpuResult<()> {
         // context->Flush();
         Ok(())
@@ -373,6 +393,25 @@ impl GpuDevice for DirectX12Device {
         Ok(())
     }
 
+    fn draw_batch(
+        &self,
+        batch: &GpuBatch,
+        atlas: &GlyphAtlas,
+        target: &mut GpuTexture,
+    ) -> GpuResult<()> {
+        // 1. UpdateSubresource for new glyph cells
+        // 2. JPEG images: IDCT and color compute shaders over a structured buffer of blocks; others upload and downscale
+        // 3. Upload vertices to one vertex buffer
+        // 4. Bind target RTV with a depth-stencil view
+        // 5. Set the pipeline and depth-stencil state per draw kind
+        // 6. Draw(count, first) for each draw
+        // 7. Groups: offscreen render target, composited with the blend shader
+        // Until the steps above are wired to the API, fail rather than
+        // report a render that never happened
+        let _ = (batch, atlas, target);
+        Err(GpuError::NotSupported("Direct3D 12 batched draws".into()))
+    }
+
     fn flush(&self) -> GpuResult<()> {
         // Execute command list
         Ok(())
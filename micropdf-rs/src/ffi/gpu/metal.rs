@@ -4,6 +4,7 @@
 
 use super::super::Handle;
 use super::backend::GpuDevice;
+use super::batch::{GlyphAtlas, GpuBatch};
 use super::types::*;
 use crate::fitz::geometry::Matrix;
 
@@ -178,6 +179,25 @@ impl GpuDevice for MetalDevice {
         Ok(())
     }
 
+    fn draw_batch(
+        &self,
+        batch: &GpuBatch,
+        atlas: &GlyphAtlas,
+        target: &mut GpuTexture,
+    ) -> GpuResult<()> {
+        // 1. Replace regions of the atlas MTLTextures
+        // 2. JPEG images: IDCT and color compute kernels over the coefficient buffer; others upload and downscale
+        // 3. Upload vertices to one MTLBuffer
+        // 4. Render command encoder on target with a depth-stencil attachment
+        // 5. Set pipeline and MTLDepthStencilState per draw kind
+        // 6. drawPrimitives(.triangle, vertexStart: first, vertexCount: count)
+        // 7. Groups: offscreen texture, composited with the blend pipeline
+        // Until the steps above are wired to the API, fail rather than
+        // report a render that never happened
+        let _ = (batch, atlas, target);
+        Err(GpuError::NotSupported("Metal batched draws".into()))
+    }
+
     fn flush(&self) -> GpuResult<()> {
         // Commit pending command buffers without waiting
         Ok(())
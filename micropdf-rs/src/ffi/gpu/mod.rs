@@ -39,8 +39,13 @@
 //! // Render a page to the texture
 //! device.render_page(&page, &texture, &matrix)?;
 //! ```
+//!
+//! Display lists are rendered with `fz_gpu_run_display_list`: playback is
+//! batched into backend-neutral draw calls (see [`batch`]) that stay on the
+//! GPU until `fz_gpu_texture_download` is called.
 
 pub mod backend;
+pub mod batch;
 pub mod opengl;
 pub mod vulkan;
 
@@ -55,9 +60,12 @@ mod types;
 pub use backend::*;
 pub use types::*;
 
+use super::display_list::DISPLAY_LISTS;
 use super::{Handle, HandleStore};
-use crate::fitz::geometry::Matrix;
-use std::sync::LazyLock;
+use crate::fitz::geometry::{Matrix, Rect};
+use batch::{BatchDevice, GlyphAtlas};
+use std::collections::HashMap;
+use std::sync::{LazyLock, Mutex};
 
 // ============================================================================
 // Handle Stores
@@ -76,6 +84,10 @@ pub static GPU_SHADERS: LazyLock<HandleStore<GpuShader>> = LazyLock::new(HandleS
 /// GPU buffer handles
 pub static GPU_BUFFERS: LazyLock<HandleStore<GpuBuffer>> = LazyLock::new(HandleStore::new);
 
+/// Glyph atlas of each GPU device that has rendered text
+static GPU_ATLASES: LazyLock<Mutex<HashMap<Handle, GlyphAtlas>>> =
+    LazyLock::new(|| Mutex::new(HashMap::new()));
+
 // ============================================================================
 // FFI Functions - Device Management
 // ============================================================================
@@ -109,6 +121,7 @@ pub extern "C" fn fz_gpu_create_device(backend: i32) -> Handle {
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_gpu_drop_device(device: Handle) {
     GPU_DEVICES.remove(device);
+    GPU_ATLASES.lock().unwrap().remove(&device);
 }
 
 /// Get the backend type of a device
@@ -368,6 +381,78 @@ pub extern "C" fn fz_gpu_render_page(
     -1
 }
 
+/// Render a display list to a GPU texture
+///
+/// Paths are tessellated, text is drawn from the device's glyph atlas and
+/// groups are composited offscreen, all as GPU draw calls; the result
+/// stays on the GPU until `fz_gpu_texture_download`.
+///
+/// # Arguments
+/// * `device` - GPU device handle
+/// * `list` - Display list handle to render
+/// * `texture` - Target texture handle
+/// * `ctm` - Transformation matrix (6 floats: a, b, c, d, e, f)
+///
+/// # Returns
+/// 0 on success, -2 if the backend can't execute batched draws (nothing
+/// is drawn; render on the CPU instead), -1 on other errors
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_gpu_run_display_list(
+    device: Handle,
+    list: Handle,
+    texture: Handle,
+    ctm: *const f32,
+) -> i32 {
+    if ctm.is_null() {
+        return -1;
+    }
+
+    // SAFETY: Caller guarantees ctm points to 6 floats
+    let matrix = unsafe {
+        Matrix::new(
+            *ctm,
+            *ctm.add(1),
+            *ctm.add(2),
+            *ctm.add(3),
+            *ctm.add(4),
+            *ctm.add(5),
+        )
+    };
+
+    let (Some(dev), Some(tex), Some(list)) = (
+        GPU_DEVICES.get(device),
+        GPU_TEXTURES.get(texture),
+        DISPLAY_LISTS.get(list),
+    ) else {
+        return -1;
+    };
+    let (Ok(guard), Ok(mut tex_guard), Ok(list_guard)) = (dev.lock(), tex.lock(), list.lock())
+    else {
+        return -1;
+    };
+
+    let mut atlases = GPU_ATLASES.lock().unwrap();
+    let atlas = atlases
+        .entry(device)
+        .or_insert_with(|| GlyphAtlas::new(guard.capabilities().max_texture_size));
+    let (width, height) = (tex_guard.width, tex_guard.height);
+    let mut batcher = BatchDevice::new(width, height, atlas);
+    if !guard.capabilities().compute_shaders {
+        batcher.decode_jpeg_on_cpu();
+    }
+    let scissor = Rect::new(0.0, 0.0, width as f32, height as f32);
+    list_guard.run(&mut batcher, &matrix, scissor);
+    let batch = batcher.finish();
+
+    match guard.draw_batch(&batch, atlas, &mut tex_guard) {
+        Ok(()) => {}
+        Err(GpuError::NotSupported(_)) => return -2,
+        Err(_) => return -1,
+    }
+    atlas.mark_uploaded(batch.new_glyphs.end);
+    0
+}
+
 /// Clear a texture with a color
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_gpu_clear_texture(
@@ -562,4 +647,32 @@ mod tests {
     fn test_invalid_backend() {
         assert_eq!(fz_gpu_backend_available(99), 0);
     }
+
+    #[test]
+    fn test_run_display_list() {
+        let device = fz_gpu_create_device(0);
+        assert_ne!(device, 0);
+        let texture = fz_gpu_create_texture(device, 64, 64, 0);
+        let list = super::super::display_list::fz_new_display_list(0, 0.0, 0.0, 64.0, 64.0);
+        let identity = [1.0f32, 0.0, 0.0, 1.0, 0.0, 0.0];
+
+        // No backend executes batches yet, and none claims to
+        assert_eq!(
+            fz_gpu_run_display_list(device, list, texture, identity.as_ptr()),
+            -2
+        );
+        assert_eq!(
+            fz_gpu_run_display_list(device, 0, texture, identity.as_ptr()),
+            -1
+        );
+        assert_eq!(
+            fz_gpu_run_display_list(device, list, texture, std::ptr::null()),
+            -1
+        );
+
+        super::super::display_list::fz_drop_display_list(0, list);
+        fz_gpu_drop_texture(texture);
+        fz_gpu_drop_device(device);
+        assert!(!GPU_ATLASES.lock().unwrap().contains_key(&device));
+    }
 }
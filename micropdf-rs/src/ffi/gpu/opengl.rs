@@ -4,6 +4,7 @@
 
 use super::super::Handle;
 use super::backend::GpuDevice;
+use super::batch::{GlyphAtlas, GpuBatch};
 use super::types::*;
 use crate::fitz::geometry::Matrix;
 
@@ -190,6 +191,25 @@ impl GpuDevice for OpenGLDevice {
         Ok(())
     }
 
+    fn draw_batch(
+        &self,
+        batch: &GpuBatch,
+        atlas: &GlyphAtlas,
+        target: &mut GpuTexture,
+    ) -> GpuResult<()> {
+        // 1. Render each new glyph into its atlas page with glTexSubImage2D
+        // 2. JPEG images: coefficient blocks to an SSBO, IDCT and color compute shaders write the texture; others upload and downscale
+        // 3. Upload the vertices into one VBO
+        // 4. Bind target FBO with a stencil attachment
+        // 5. Solid/Cover/Glyphs/Image: path or quad shader over the draw's range
+        // 6. Stencil: glStencilOp GL_INCR_WRAP/GL_DECR_WRAP (or GL_INVERT for even-odd), color mask off
+        // 7. Clip/PopClip: raise or lower the clip bit level, groups: offscreen FBO + blend shader
+        // Until the steps above are wired to the API, fail rather than
+        // report a render that never happened
+        let _ = (batch, atlas, target);
+        Err(GpuError::NotSupported("OpenGL batched draws".into()))
+    }
+
     fn flush(&self) -> GpuResult<()> {
         // glFlush();
         Ok(())
@@ -4,6 +4,7 @@
 
 use super::super::Handle;
 use super::backend::GpuDevice;
+use super::batch::{GlyphAtlas, GpuBatch};
 use super::types::*;
 use crate::fitz::geometry::Matrix;
 
@@ -203,6 +204,25 @@ impl GpuDevice for VulkanDevice {
         Ok(())
     }
 
+    fn draw_batch(
+        &self,
+        batch: &GpuBatch,
+        atlas: &GlyphAtlas,
+        target: &mut GpuTexture,
+    ) -> GpuResult<()> {
+        // 1. Copy new glyph cells to staging, record vkCmdCopyBufferToImage
+        // 2. JPEG images: dispatch JPEG_IDCT_COMPUTE_SHADER_GLSL then JPEG_COLOR_COMPUTE_SHADER_GLSL; others upload and downscale
+        // 3. Upload vertices to one vertex buffer
+        // 4. Begin render pass on target with a stencil attachment
+        // 5. Bind the pipeline per draw kind: stencil-only, cover, glyph, image
+        // 6. vkCmdDraw(count, 1, first, 0) for each draw
+        // 7. Groups: nested render pass on an offscreen image, composited with the blend pipeline
+        // Until the steps above are wired to the API, fail rather than
+        // report a render that never happened
+        let _ = (batch, atlas, target);
+        Err(GpuError::NotSupported("Vulkan batched draws".into()))
+    }
+
     fn flush(&self) -> GpuResult<()> {
         // Submit pending command buffers
         Ok(())
@@ -286,6 +306,88 @@ void main() {
 }
 "#;
 
+/// Dequantize and inverse transform one JPEG block per workgroup into a
+/// component plane, at `size` (8, 4, 2 or 1) samples per block side, as
+/// `JpegCoefficients::reconstruct` does
+pub const JPEG_IDCT_COMPUTE_SHADER_GLSL: &str = r#"
+#version 450
+layout(local_size_x = 8, local_size_y = 8) in;
+
+layout(std430, set = 0, binding = 0) readonly buffer Blocks { int coef[]; } blocks;
+layout(std430, set = 0, binding = 1) readonly buffer Quant { uint quant[64]; } q;
+layout(set = 0, binding = 2, r8) uniform writeonly image2D u_plane;
+
+layout(push_constant) uniform PushConstants {
+    uint blocks_w;
+    uint size;
+} pc;
+
+float basis(uint x, uint u) {
+    float c = u == 0u ? 0.70710678 : 1.0;
+    return 0.5 * c * cos(float((2u * x + 1u) * u) * 3.14159265 / float(2u * pc.size));
+}
+
+void main() {
+    uint x = gl_LocalInvocationID.x, y = gl_LocalInvocationID.y;
+    if (x >= pc.size || y >= pc.size) return;
+    uint block = gl_WorkGroupID.y * pc.blocks_w + gl_WorkGroupID.x;
+    float value = 0.0;
+    for (uint v = 0u; v < pc.size; v++) {
+        for (uint u = 0u; u < pc.size; u++) {
+            uint k = v * 8u + u;
+            float c = float(blocks.coef[block * 64u + k]) * float(q.quant[k]);
+            value += basis(y, v) * basis(x, u) * c;
+        }
+    }
+    ivec2 at = ivec2(gl_WorkGroupID.xy * pc.size + uvec2(x, y));
+    imageStore(u_plane, at, vec4(clamp(round(value + 128.0), 0.0, 255.0) / 255.0));
+}
+"#;
+
+/// Interleave JPEG component planes into an RGBA texture, upsampling
+/// subsampled ones and converting YCbCr, YCCK and CMYK to RGB
+pub const JPEG_COLOR_COMPUTE_SHADER_GLSL: &str = r#"
+#version 450
+layout(local_size_x = 16, local_size_y = 16) in;
+
+layout(set = 0, binding = 0) uniform sampler2D u_planes[4];
+layout(set = 0, binding = 1, rgba8) uniform writeonly image2D u_texture;
+
+layout(push_constant) uniform PushConstants {
+    uvec2 size;
+    uvec4 h;
+    uvec4 v;
+    uvec2 max_hv;
+    uint components;
+    uint ycc;
+} pc;
+
+void main() {
+    uvec2 p = gl_GlobalInvocationID.xy;
+    if (p.x >= pc.size.x || p.y >= pc.size.y) return;
+    vec4 s = vec4(0.0);
+    for (uint i = 0u; i < pc.components; i++) {
+        ivec2 at = ivec2(p.x * pc.h[i] / pc.max_hv.x, p.y * pc.v[i] / pc.max_hv.y);
+        s[i] = round(texelFetch(u_planes[i], at, 0).r * 255.0);
+    }
+    if (pc.ycc != 0u) {
+        vec3 rgb = vec3(
+            s.x + 1.402 * (s.z - 128.0),
+            s.x - 0.344136 * (s.y - 128.0) - 0.714136 * (s.z - 128.0),
+            s.x + 1.772 * (s.y - 128.0));
+        rgb = clamp(round(rgb), 0.0, 255.0);
+        // YCCK carries inverted CMY
+        s.xyz = pc.components == 4u ? 255.0 - rgb : rgb;
+    }
+    vec3 color = pc.components == 1u ? s.xxx : s.xyz;
+    if (pc.components == 4u) {
+        vec4 cmyk = s / 255.0;
+        color = (1.0 - cmyk.xyz) * (1.0 - cmyk.w) * 255.0;
+    }
+    imageStore(u_texture, ivec2(p), vec4(color / 255.0, 1.0));
+}
+"#;
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -0,0 +1,544 @@
+//! Handle Slab - lock-free slot table behind every `HandleStore`
+//!
+//! A handle is a slot index plus a generation:
+//!
+//! ```text
+//!  29        21 20                    0
+//! +------------+-----------------------+
+//! | generation |      slot index       |
+//! +------------+-----------------------+
+//! ```
+//!
+//! Handles stay below 2^30, so they survive the `int32_t` handle types in
+//! the generated C headers and never reach the ranges of immediate PDF
+//! object handles (2^30 to 2^31) and arena handles (above 2^32). All stores share one index space, so live
+//! handles are unique across types and a handle of one type misses in the
+//! store of another, as with the old per-store maps.
+//!
+//! Each slot has a single atomic word holding a live bit, the generation,
+//! the extra references taken with `keep()` and a count of readers. A
+//! lookup is one `fetch_add` that registers the reader and reads the state
+//! at once, a clone of the value, and one `fetch_sub`: wait-free, with no
+//! lock and no shared cache line besides the slot itself. Freeing a slot
+//! bumps its generation before the value is taken out, so every handle to
+//! it, and every handle to an earlier occupant, stops resolving; the
+//! value is only taken once readers that got in first have left.
+//!
+//! Free slots are kept per thread and reused oldest first, spilling to a
+//! global list when a thread frees more than it allocates. A slot whose
+//! generation wraps is retired instead: it is only handed out again once
+//! no never-used or freed slot is left, so a stale handle can't match a
+//! later occupant until some 2^30 handles have been allocated, however
+//! tight the allocate/free loop.
+//!
+//! At most 2^21 - 1 handles are live at once, across every store. Past
+//! that `insert` returns 0, the handle every export returns on failure,
+//! and counts the failure for `fz_handle_insert_failures`.
+
+use std::any::Any;
+use std::cell::{RefCell, UnsafeCell};
+use std::collections::VecDeque;
+use std::sync::atomic::{AtomicPtr, AtomicU32, AtomicU64, AtomicUsize, Ordering};
+use std::sync::{Arc, Mutex};
+
+use super::Handle;
+
+/// Bits of a handle holding the slot index
+const INDEX_BITS: u32 = 21;
+
+/// Bits of a handle holding the generation
+const GEN_BITS: u32 = 9;
+
+/// Number of slots (slot 0 is never used, so no handle is 0)
+const SLOT_COUNT: u32 = 1 << INDEX_BITS;
+
+const INDEX_MASK: u64 = (1 << INDEX_BITS) - 1;
+const GEN_MASK: u64 = (1 << GEN_BITS) - 1;
+
+/// Slots are allocated in pages the first time an index in them is used
+const PAGE_BITS: u32 = 10;
+const PAGE_SIZE: usize = 1 << PAGE_BITS;
+const PAGE_COUNT: usize = (SLOT_COUNT as usize) >> PAGE_BITS;
+
+// Slot word layout: live bit, generation, extra references, readers
+const LIVE: u64 = 1 << 63;
+const WORD_GEN_SHIFT: u32 = 48;
+const REFS_SHIFT: u32 = 24;
+const REF_ONE: u64 = 1 << REFS_SHIFT;
+const REFS_MASK: u64 = ((1 << 24) - 1) << REFS_SHIFT;
+const READERS_MASK: u64 = (1 << 24) - 1;
+
+/// Free slots a thread keeps before reusing one
+const LOCAL_REUSE_MIN: usize = 32;
+
+/// Free slots a thread keeps before spilling the oldest half
+const LOCAL_MAX: usize = 64;
+
+/// Spins before a thread freeing a slot yields to readers still in it
+const READER_SPIN_LIMIT: u32 = 64;
+
+type Value = Arc<dyn Any + Send + Sync>;
+
+struct Slot {
+    word: AtomicU64,
+    /// Id of the store the value belongs to, 0 when free
+    owner: AtomicU32,
+    /// Written only while the slot is free, read only while it is live
+    value: UnsafeCell<Option<Value>>,
+}
+
+// SAFETY: `value` is written only by the thread that owns a free slot and
+// read only by readers registered in `word` while the slot is live; the
+// thread freeing a slot waits for those readers before taking the value
+unsafe impl Sync for Slot {}
+
+impl Slot {
+    fn new() -> Self {
+        Self {
+            word: AtomicU64::new(0),
+            owner: AtomicU32::new(0),
+            value: UnsafeCell::new(None),
+        }
+    }
+}
+
+static PAGES: [AtomicPtr<Slot>; PAGE_COUNT] =
+    [const { AtomicPtr::new(std::ptr::null_mut()) }; PAGE_COUNT];
+
+/// Next never-used slot index
+static NEXT_INDEX: AtomicU32 = AtomicU32::new(1);
+
+/// Slots freed by threads with more than they reuse, oldest first
+static GLOBAL_FREE: Mutex<VecDeque<u32>> = Mutex::new(VecDeque::new());
+static GLOBAL_FREE_LEN: AtomicUsize = AtomicUsize::new(0);
+
+/// Slots that have run through every generation, oldest first
+static RETIRED: Mutex<VecDeque<u32>> = Mutex::new(VecDeque::new());
+
+/// Inserts that found every slot live
+static INSERT_FAILURES: AtomicU64 = AtomicU64::new(0);
+
+/// Next store id (0 marks a free slot)
+static NEXT_STORE: AtomicU32 = AtomicU32::new(1);
+
+struct LocalFree(VecDeque<u32>);
+
+impl Drop for LocalFree {
+    fn drop(&mut self) {
+        spill(self.0.drain(..));
+    }
+}
+
+thread_local! {
+    static LOCAL_FREE: RefCell<LocalFree> = const { RefCell::new(LocalFree(VecDeque::new())) };
+}
+
+fn spill(indices: impl Iterator<Item = u32>) {
+    let mut global = GLOBAL_FREE.lock().unwrap_or_else(|e| e.into_inner());
+    global.extend(indices);
+    GLOBAL_FREE_LEN.store(global.len(), Ordering::Relaxed);
+}
+
+/// Take up to `n` slots from the global free list
+fn refill(local: &mut VecDeque<u32>, n: usize) {
+    if GLOBAL_FREE_LEN.load(Ordering::Relaxed) == 0 {
+        return;
+    }
+    let mut global = GLOBAL_FREE.lock().unwrap_or_else(|e| e.into_inner());
+    let take = n.min(global.len());
+    local.extend(global.drain(..take));
+    GLOBAL_FREE_LEN.store(global.len(), Ordering::Relaxed);
+}
+
+/// The slot at `index`, if its page exists
+fn slot(index: u32) -> Option<&'static Slot> {
+    let page = PAGES
+        .get((index >> PAGE_BITS) as usize)?
+        .load(Ordering::Acquire);
+    if page.is_null() {
+        return None;
+    }
+    // SAFETY: pages are never freed and hold PAGE_SIZE slots
+    Some(unsafe { &*page.add(index as usize & (PAGE_SIZE - 1)) })
+}
+
+/// The slot at `index`, allocating its page on first use
+fn slot_or_alloc(index: u32) -> &'static Slot {
+    if let Some(slot) = slot(index) {
+        return slot;
+    }
+    let entry = &PAGES[(index >> PAGE_BITS) as usize];
+    let page: Box<[Slot]> = (0..PAGE_SIZE).map(|_| Slot::new()).collect();
+    let page = Box::into_raw(page) as *mut Slot;
+    if let Err(existing) = entry.compare_exchange(
+        std::ptr::null_mut(),
+        page,
+        Ordering::AcqRel,
+        Ordering::Acquire,
+    ) {
+        // Another thread installed the page first
+        // SAFETY: `page` came from Box::into_raw above and was never shared
+        drop(unsafe { Box::from_raw(std::ptr::slice_from_raw_parts_mut(page, PAGE_SIZE)) });
+        // SAFETY: as in `slot`
+        return unsafe { &*existing.add(index as usize & (PAGE_SIZE - 1)) };
+    }
+    // SAFETY: as in `slot`
+    unsafe { &*page.add(index as usize & (PAGE_SIZE - 1)) }
+}
+
+fn alloc_index() -> Option<u32> {
+    let reused = LOCAL_FREE
+        .try_with(|local| {
+            let local = &mut local.borrow_mut().0;
+            if local.len() < LOCAL_REUSE_MIN {
+                refill(local, LOCAL_REUSE_MIN);
+            }
+            if local.len() >= LOCAL_REUSE_MIN {
+                local.pop_front()
+            } else {
+                None
+            }
+        })
+        .ok()
+        .flatten();
+    if reused.is_some() {
+        return reused;
+    }
+
+    let index = NEXT_INDEX.fetch_add(1, Ordering::Relaxed);
+    if index < SLOT_COUNT {
+        return Some(index);
+    }
+    NEXT_INDEX.store(SLOT_COUNT, Ordering::Relaxed);
+
+    // Every slot has been used once; take any free one
+    let reused = LOCAL_FREE
+        .try_with(|local| local.borrow_mut().0.pop_front())
+        .ok()
+        .flatten();
+    reused
+        .or_else(|| {
+            let mut global = GLOBAL_FREE.lock().unwrap_or_else(|e| e.into_inner());
+            let index = global.pop_front();
+            GLOBAL_FREE_LEN.store(global.len(), Ordering::Relaxed);
+            index
+        })
+        .or_else(|| {
+            RETIRED
+                .lock()
+                .unwrap_or_else(|e| e.into_inner())
+                .pop_front()
+        })
+}
+
+fn free_index(index: u32) {
+    let kept = LOCAL_FREE.try_with(|local| {
+        let local = &mut local.borrow_mut().0;
+        local.push_back(index);
+        if local.len() > LOCAL_MAX {
+            spill(local.drain(..LOCAL_MAX / 2));
+        }
+    });
+    if kept.is_err() {
+        // Thread is exiting
+        spill(std::iter::once(index));
+    }
+}
+
+#[inline]
+fn decode(handle: Handle) -> Option<(&'static Slot, u64)> {
+    if handle >> (INDEX_BITS + GEN_BITS) != 0 {
+        return None;
+    }
+    let index = (handle & INDEX_MASK) as u32;
+    if index == 0 {
+        return None;
+    }
+    Some((slot(index)?, (handle >> INDEX_BITS) & GEN_MASK))
+}
+
+#[inline]
+fn word_gen(word: u64) -> u64 {
+    (word >> WORD_GEN_SHIFT) & GEN_MASK
+}
+
+#[inline]
+fn is_live(word: u64, generation: u64) -> bool {
+    word & LIVE != 0 && word_gen(word) == generation
+}
+
+/// The word of a freed slot: next generation, no references, same readers
+#[inline]
+fn freed(word: u64) -> u64 {
+    let generation = (word_gen(word) + 1) & GEN_MASK;
+    (generation << WORD_GEN_SHIFT) | (word & READERS_MASK)
+}
+
+/// Number of inserts that failed because every slot was live
+pub(crate) fn insert_failures() -> u64 {
+    INSERT_FAILURES.load(Ordering::Relaxed)
+}
+
+/// A view of the slab for one store
+pub(crate) struct Slab {
+    id: u32,
+}
+
+impl Slab {
+    pub(crate) fn new() -> Self {
+        Self {
+            id: NEXT_STORE.fetch_add(1, Ordering::Relaxed),
+        }
+    }
+
+    /// Store `value` in a free slot; returns its handle, or 0 if the slab
+    /// is full
+    pub(crate) fn insert(&self, value: Value) -> Handle {
+        let Some(index) = alloc_index() else {
+            INSERT_FAILURES.fetch_add(1, Ordering::Relaxed);
+            return 0;
+        };
+        let slot = slot_or_alloc(index);
+        // SAFETY: the slot is free and ours until it is published below
+        unsafe { *slot.value.get() = Some(value) };
+        slot.owner.store(self.id, Ordering::Relaxed);
+        let word = slot.word.fetch_or(LIVE, Ordering::Release);
+        (word_gen(word) << INDEX_BITS) | u64::from(index)
+    }
+
+    /// The value behind `handle`, if it is live and belongs to this store
+    #[inline]
+    pub(crate) fn get(&self, handle: Handle) -> Option<Value> {
+        let (slot, generation) = decode(handle)?;
+        let word = slot.word.fetch_add(1, Ordering::Acquire);
+        let value = if is_live(word, generation) && slot.owner.load(Ordering::Relaxed) == self.id {
+            // SAFETY: registered as a reader of a live slot
+            unsafe { (*slot.value.get()).clone() }
+        } else {
+            None
+        };
+        slot.word.fetch_sub(1, Ordering::Release);
+        value
+    }
+
+    /// Free `handle` whatever its extra references
+    pub(crate) fn remove(&self, handle: Handle) -> Option<Value> {
+        self.drop_ref(handle, false).1
+    }
+
+    /// Take an extra reference; false if `handle` is not live here
+    pub(crate) fn keep(&self, handle: Handle) -> bool {
+        let Some((slot, generation)) = decode(handle) else {
+            return false;
+        };
+        let mut word = slot.word.load(Ordering::Acquire);
+        loop {
+            if !is_live(word, generation)
+                || slot.owner.load(Ordering::Relaxed) != self.id
+                || word & REFS_MASK == REFS_MASK
+            {
+                return false;
+            }
+            match slot.word.compare_exchange_weak(
+                word,
+                word + REF_ONE,
+                Ordering::AcqRel,
+                Ordering::Acquire,
+            ) {
+                Ok(_) => return true,
+                Err(current) => word = current,
+            }
+        }
+    }
+
+    /// Drop one reference: an extra one if there is any, otherwise free
+    /// the slot. Returns whether the slot was freed, and its value.
+    pub(crate) fn release(&self, handle: Handle) -> (bool, Option<Value>) {
+        self.drop_ref(handle, true)
+    }
+
+    fn drop_ref(&self, handle: Handle, counted: bool) -> (bool, Option<Value>) {
+        let Some((slot, generation)) = decode(handle) else {
+            return (false, None);
+        };
+        let mut word = slot.word.load(Ordering::Acquire);
+        let next_generation = loop {
+            if !is_live(word, generation) || slot.owner.load(Ordering::Relaxed) != self.id {
+                return (false, None);
+            }
+            let next = if counted && word & REFS_MASK != 0 {
+                word - REF_ONE
+            } else {
+                freed(word)
+            };
+            match slot
+                .word
+                .compare_exchange_weak(word, next, Ordering::AcqRel, Ordering::Acquire)
+            {
+                Ok(_) if next & LIVE != 0 => return (false, None),
+                Ok(_) => break word_gen(next),
+                Err(current) => word = current,
+            }
+        };
+
+        // Readers that got in before the generation changed may still be
+        // cloning the value
+        let mut spins = 0;
+        while slot.word.load(Ordering::Acquire) & READERS_MASK != 0 {
+            if spins < READER_SPIN_LIMIT {
+                spins += 1;
+                std::hint::spin_loop();
+            } else {
+                std::thread::yield_now();
+            }
+        }
+        // SAFETY: the slot is no longer live and no reader is left in it
+        let value = unsafe { (*slot.value.get()).take() };
+        slot.owner.store(0, Ordering::Relaxed);
+        let index = (handle & INDEX_MASK) as u32;
+        if next_generation == 0 {
+            RETIRED
+                .lock()
+                .unwrap_or_else(|e| e.into_inner())
+                .push_back(index);
+        } else {
+            free_index(index);
+        }
+        (true, value)
+    }
+
+    /// Handles of every live value of this store
+    pub(crate) fn live_handles(&self) -> Vec<Handle> {
+        let used = NEXT_INDEX.load(Ordering::Relaxed).min(SLOT_COUNT);
+        (1..used)
+            .filter_map(|index| {
+                let slot = slot(index)?;
+                let word = slot.word.load(Ordering::Acquire);
+                (word & LIVE != 0 && slot.owner.load(Ordering::Relaxed) == self.id)
+                    .then(|| (word_gen(word) << INDEX_BITS) | u64::from(index))
+            })
+            .collect()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn value(n: i32) -> Value {
+        Arc::new(n)
+    }
+
+    fn read(slab: &Slab, handle: Handle) -> Option<i32> {
+        slab.get(handle)
+            .and_then(|v| v.downcast_ref::<i32>().copied())
+    }
+
+    #[test]
+    fn test_handles_fit_in_30_bits_and_are_unique() {
+        let a = Slab::new();
+        let b = Slab::new();
+        let ha: Vec<Handle> = (0..100).map(|i| a.insert(value(i))).collect();
+        let hb: Vec<Handle> = (0..100).map(|i| b.insert(value(i))).collect();
+        for &h in ha.iter().chain(&hb) {
+            assert!(h != 0 && h < 1 << 30);
+        }
+        let mut all: Vec<Handle> = ha.iter().chain(&hb).copied().collect();
+        all.sort_unstable();
+        all.dedup();
+        assert_eq!(all.len(), 200);
+
+        // A handle of one store misses in another
+        assert_eq!(read(&a, ha[7]), Some(7));
+        assert!(b.get(ha[7]).is_none());
+        assert!(b.remove(ha[7]).is_none());
+        assert_eq!(read(&a, ha[7]), Some(7));
+        for h in ha {
+            a.remove(h);
+        }
+        for h in hb {
+            b.remove(h);
+        }
+    }
+
+    #[test]
+    fn test_stale_handles_miss_after_reuse() {
+        let slab = Slab::new();
+        let first = slab.insert(value(1));
+        assert!(slab.remove(first).is_some());
+        assert!(slab.get(first).is_none());
+        assert!(slab.remove(first).is_none());
+
+        // Churn long enough to reuse the freed slot many times over
+        let mut last = 0;
+        for i in 0..5000 {
+            let h = slab.insert(value(i));
+            assert_ne!(h, first);
+            assert!(slab.get(first).is_none());
+            slab.remove(h);
+            last = h;
+        }
+        assert!(slab.get(last).is_none());
+        assert!(slab.live_handles().is_empty());
+    }
+
+    #[test]
+    fn test_stale_handles_miss_past_generation_wrap() {
+        let slab = Slab::new();
+        let first = slab.insert(value(1));
+        assert!(slab.remove(first).is_some());
+
+        // Long enough for every reused slot to run through all of its
+        // generations twice; no handle may come back
+        let cycles = (LOCAL_REUSE_MIN + 1) << (GEN_BITS + 1);
+        let mut issued = std::collections::HashSet::from([first]);
+        for i in 0..cycles {
+            let h = slab.insert(value(i as i32));
+            assert!(issued.insert(h), "handle {h:#x} issued twice");
+            assert!(slab.get(first).is_none());
+            slab.remove(h);
+        }
+        assert!(slab.live_handles().is_empty());
+    }
+
+    #[test]
+    fn test_keep_and_release() {
+        let slab = Slab::new();
+        let h = slab.insert(value(9));
+        assert!(slab.keep(h));
+        assert!(slab.keep(h));
+        assert_eq!(slab.release(h).0, false);
+        assert_eq!(slab.release(h).0, false);
+        assert_eq!(read(&slab, h), Some(9));
+        let (freed, value) = slab.release(h);
+        assert!(freed);
+        assert!(value.is_some());
+        assert!(!slab.keep(h));
+        assert!(slab.get(h).is_none());
+    }
+
+    #[test]
+    fn test_concurrent_lookups_during_churn() {
+        let slab = Arc::new(Slab::new());
+        let stable = slab.insert(value(42));
+        let threads: Vec<_> = (0..4)
+            .map(|t| {
+                let slab = Arc::clone(&slab);
+                std::thread::spawn(move || {
+                    for i in 0..2000 {
+                        let h = slab.insert(value(t * 10_000 + i));
+                        assert_eq!(read(&slab, h), Some(t * 10_000 + i));
+                        assert_eq!(read(&slab, stable), Some(42));
+                        assert!(slab.remove(h).is_some());
+                        assert!(slab.get(h).is_none());
+                    }
+                })
+            })
+            .collect();
+        for thread in threads {
+            thread.join().unwrap();
+        }
+        assert_eq!(read(&slab, stable), Some(42));
+        slab.remove(stable);
+    }
+}
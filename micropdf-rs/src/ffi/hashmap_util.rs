@@ -4,8 +4,8 @@
 //! to reduce allocation overhead and improve lookup performance.
 
 use std::collections::HashMap;
+use std::ffi::CStr;
 use std::hash::{BuildHasher, Hash, Hasher};
-use std::sync::LazyLock;
 
 // ============================================================================
 // Pre-sized HashMap Factory
@@ -112,12 +112,7 @@ impl PdfNameHasher {
     #[inline]
     pub fn hash_name(&self, name: &str) -> u64 {
         // FNV-1a variant optimized for short strings
-        let mut hash = self.seed;
-        for byte in name.bytes() {
-            hash ^= byte as u64;
-            hash = hash.wrapping_mul(0x100000001b3);
-        }
-        hash
+        fnv1a(self.seed, name.as_bytes())
     }
 }
 
@@ -263,163 +258,321 @@ pub enum StandardPdfName {
 }
 
 impl StandardPdfName {
+    /// Every standard name, in index order
+    pub const ALL: [Self; STANDARD_NAME_COUNT] = [
+        Self::Type,
+        Self::Subtype,
+        Self::Catalog,
+        Self::Pages,
+        Self::Page,
+        Self::Parent,
+        Self::Kids,
+        Self::Count,
+        Self::Root,
+        Self::Info,
+        Self::Metadata,
+        Self::MediaBox,
+        Self::CropBox,
+        Self::BleedBox,
+        Self::TrimBox,
+        Self::ArtBox,
+        Self::Resources,
+        Self::Contents,
+        Self::Rotate,
+        Self::UserUnit,
+        Self::ExtGState,
+        Self::ColorSpace,
+        Self::Pattern,
+        Self::Shading,
+        Self::XObject,
+        Self::Font,
+        Self::ProcSet,
+        Self::Properties,
+        Self::Length,
+        Self::Filter,
+        Self::DecodeParms,
+        Self::FlateDecode,
+        Self::DCTDecode,
+        Self::ASCIIHexDecode,
+        Self::ASCII85Decode,
+        Self::LZWDecode,
+        Self::RunLengthDecode,
+        Self::CCITTFaxDecode,
+        Self::JBIG2Decode,
+        Self::JPXDecode,
+        Self::DeviceGray,
+        Self::DeviceRGB,
+        Self::DeviceCMYK,
+        Self::ICCBased,
+        Self::Indexed,
+        Self::Separation,
+        Self::DeviceN,
+        Self::Image,
+        Self::Form,
+        Self::Width,
+        Self::Height,
+        Self::BitsPerComponent,
+        Self::SMask,
+        Self::Mask,
+        Self::Decode,
+        Self::Interpolate,
+        Self::BaseFont,
+        Self::Encoding,
+        Self::Widths,
+        Self::FirstChar,
+        Self::LastChar,
+        Self::ToUnicode,
+        Self::FontDescriptor,
+        Self::DescendantFonts,
+    ];
+
     /// Get the string representation
     pub fn as_str(&self) -> &'static str {
         match self {
-            Self::Type => "Type",
-            Self::Subtype => "Subtype",
-            Self::Catalog => "Catalog",
-            Self::Pages => "Pages",
-            Self::Page => "Page",
-            Self::Parent => "Parent",
-            Self::Kids => "Kids",
-            Self::Count => "Count",
-            Self::Root => "Root",
-            Self::Info => "Info",
-            Self::Metadata => "Metadata",
-            Self::MediaBox => "MediaBox",
-            Self::CropBox => "CropBox",
-            Self::BleedBox => "BleedBox",
-            Self::TrimBox => "TrimBox",
-            Self::ArtBox => "ArtBox",
-            Self::Resources => "Resources",
-            Self::Contents => "Contents",
-            Self::Rotate => "Rotate",
-            Self::UserUnit => "UserUnit",
-            Self::ExtGState => "ExtGState",
-            Self::ColorSpace => "ColorSpace",
-            Self::Pattern => "Pattern",
-            Self::Shading => "Shading",
-            Self::XObject => "XObject",
-            Self::Font => "Font",
-            Self::ProcSet => "ProcSet",
-            Self::Properties => "Properties",
-            Self::Length => "Length",
-            Self::Filter => "Filter",
-            Self::DecodeParms => "DecodeParms",
-            Self::FlateDecode => "FlateDecode",
-            Self::DCTDecode => "DCTDecode",
-            Self::ASCIIHexDecode => "ASCIIHexDecode",
-            Self::ASCII85Decode => "ASCII85Decode",
-            Self::LZWDecode => "LZWDecode",
-            Self::RunLengthDecode => "RunLengthDecode",
-            Self::CCITTFaxDecode => "CCITTFaxDecode",
-            Self::JBIG2Decode => "JBIG2Decode",
-            Self::JPXDecode => "JPXDecode",
-            Self::DeviceGray => "DeviceGray",
-            Self::DeviceRGB => "DeviceRGB",
-            Self::DeviceCMYK => "DeviceCMYK",
-            Self::ICCBased => "ICCBased",
-            Self::Indexed => "Indexed",
-            Self::Separation => "Separation",
-            Self::DeviceN => "DeviceN",
-            Self::Image => "Image",
-            Self::Form => "Form",
-            Self::Width => "Width",
-            Self::Height => "Height",
-            Self::BitsPerComponent => "BitsPerComponent",
-            Self::SMask => "SMask",
-            Self::Mask => "Mask",
-            Self::Decode => "Decode",
-            Self::Interpolate => "Interpolate",
-            Self::BaseFont => "BaseFont",
-            Self::Encoding => "Encoding",
-            Self::Widths => "Widths",
-            Self::FirstChar => "FirstChar",
-            Self::LastChar => "LastChar",
-            Self::ToUnicode => "ToUnicode",
-            Self::FontDescriptor => "FontDescriptor",
-            Self::DescendantFonts => "DescendantFonts",
             Self::Unknown => "",
+            name => STANDARD_NAMES[*name as usize],
         }
     }
 
+    /// Standard name with the given index
+    pub fn from_index(index: usize) -> Self {
+        Self::ALL.get(index).copied().unwrap_or(Self::Unknown)
+    }
+
     /// Lookup standard name from string (O(1) via perfect hash)
     pub fn from_str(name: &str) -> Self {
-        STANDARD_NAME_LOOKUP
-            .get(name)
-            .copied()
-            .unwrap_or(Self::Unknown)
+        standard_name_index(name).map_or(Self::Unknown, Self::from_index)
     }
 }
 
-/// Lookup table for standard PDF names
-static STANDARD_NAME_LOOKUP: LazyLock<HashMap<&'static str, StandardPdfName, PdfNameBuildHasher>> =
-    LazyLock::new(|| {
-        let mut map = HashMap::with_capacity_and_hasher(64, PdfNameBuildHasher);
-        map.insert("Type", StandardPdfName::Type);
-        map.insert("Subtype", StandardPdfName::Subtype);
-        map.insert("Catalog", StandardPdfName::Catalog);
-        map.insert("Pages", StandardPdfName::Pages);
-        map.insert("Page", StandardPdfName::Page);
-        map.insert("Parent", StandardPdfName::Parent);
-        map.insert("Kids", StandardPdfName::Kids);
-        map.insert("Count", StandardPdfName::Count);
-        map.insert("Root", StandardPdfName::Root);
-        map.insert("Info", StandardPdfName::Info);
-        map.insert("Metadata", StandardPdfName::Metadata);
-        map.insert("MediaBox", StandardPdfName::MediaBox);
-        map.insert("CropBox", StandardPdfName::CropBox);
-        map.insert("BleedBox", StandardPdfName::BleedBox);
-        map.insert("TrimBox", StandardPdfName::TrimBox);
-        map.insert("ArtBox", StandardPdfName::ArtBox);
-        map.insert("Resources", StandardPdfName::Resources);
-        map.insert("Contents", StandardPdfName::Contents);
-        map.insert("Rotate", StandardPdfName::Rotate);
-        map.insert("UserUnit", StandardPdfName::UserUnit);
-        map.insert("ExtGState", StandardPdfName::ExtGState);
-        map.insert("ColorSpace", StandardPdfName::ColorSpace);
-        map.insert("Pattern", StandardPdfName::Pattern);
-        map.insert("Shading", StandardPdfName::Shading);
-        map.insert("XObject", StandardPdfName::XObject);
-        map.insert("Font", StandardPdfName::Font);
-        map.insert("ProcSet", StandardPdfName::ProcSet);
-        map.insert("Properties", StandardPdfName::Properties);
-        map.insert("Length", StandardPdfName::Length);
-        map.insert("Filter", StandardPdfName::Filter);
-        map.insert("DecodeParms", StandardPdfName::DecodeParms);
-        map.insert("FlateDecode", StandardPdfName::FlateDecode);
-        map.insert("DCTDecode", StandardPdfName::DCTDecode);
-        map.insert("ASCIIHexDecode", StandardPdfName::ASCIIHexDecode);
-        map.insert("ASCII85Decode", StandardPdfName::ASCII85Decode);
-        map.insert("LZWDecode", StandardPdfName::LZWDecode);
-        map.insert("RunLengthDecode", StandardPdfName::RunLengthDecode);
-        map.insert("CCITTFaxDecode", StandardPdfName::CCITTFaxDecode);
-        map.insert("JBIG2Decode", StandardPdfName::JBIG2Decode);
-        map.insert("JPXDecode", StandardPdfName::JPXDecode);
-        map.insert("DeviceGray", StandardPdfName::DeviceGray);
-        map.insert("DeviceRGB", StandardPdfName::DeviceRGB);
-        map.insert("DeviceCMYK", StandardPdfName::DeviceCMYK);
-        map.insert("ICCBased", StandardPdfName::ICCBased);
-        map.insert("Indexed", StandardPdfName::Indexed);
-        map.insert("Separation", StandardPdfName::Separation);
-        map.insert("DeviceN", StandardPdfName::DeviceN);
-        map.insert("Image", StandardPdfName::Image);
-        map.insert("Form", StandardPdfName::Form);
-        map.insert("Width", StandardPdfName::Width);
-        map.insert("Height", StandardPdfName::Height);
-        map.insert("BitsPerComponent", StandardPdfName::BitsPerComponent);
-        map.insert("SMask", StandardPdfName::SMask);
-        map.insert("Mask", StandardPdfName::Mask);
-        map.insert("Decode", StandardPdfName::Decode);
-        map.insert("Interpolate", StandardPdfName::Interpolate);
-        map.insert("BaseFont", StandardPdfName::BaseFont);
-        map.insert("Encoding", StandardPdfName::Encoding);
-        map.insert("Widths", StandardPdfName::Widths);
-        map.insert("FirstChar", StandardPdfName::FirstChar);
-        map.insert("LastChar", StandardPdfName::LastChar);
-        map.insert("ToUnicode", StandardPdfName::ToUnicode);
-        map.insert("FontDescriptor", StandardPdfName::FontDescriptor);
-        map.insert("DescendantFonts", StandardPdfName::DescendantFonts);
-        map
-    });
+/// Number of standard names
+pub const STANDARD_NAME_COUNT: usize = 64;
+
+/// NUL-terminated standard names, indexed by `StandardPdfName`
+pub const STANDARD_NAME_CSTRS: [&CStr; STANDARD_NAME_COUNT] = [
+    c"Type",
+    c"Subtype",
+    c"Catalog",
+    c"Pages",
+    c"Page",
+    c"Parent",
+    c"Kids",
+    c"Count",
+    c"Root",
+    c"Info",
+    c"Metadata",
+    c"MediaBox",
+    c"CropBox",
+    c"BleedBox",
+    c"TrimBox",
+    c"ArtBox",
+    c"Resources",
+    c"Contents",
+    c"Rotate",
+    c"UserUnit",
+    c"ExtGState",
+    c"ColorSpace",
+    c"Pattern",
+    c"Shading",
+    c"XObject",
+    c"Font",
+    c"ProcSet",
+    c"Properties",
+    c"Length",
+    c"Filter",
+    c"DecodeParms",
+    c"FlateDecode",
+    c"DCTDecode",
+    c"ASCIIHexDecode",
+    c"ASCII85Decode",
+    c"LZWDecode",
+    c"RunLengthDecode",
+    c"CCITTFaxDecode",
+    c"JBIG2Decode",
+    c"JPXDecode",
+    c"DeviceGray",
+    c"DeviceRGB",
+    c"DeviceCMYK",
+    c"ICCBased",
+    c"Indexed",
+    c"Separation",
+    c"DeviceN",
+    c"Image",
+    c"Form",
+    c"Width",
+    c"Height",
+    c"BitsPerComponent",
+    c"SMask",
+    c"Mask",
+    c"Decode",
+    c"Interpolate",
+    c"BaseFont",
+    c"Encoding",
+    c"Widths",
+    c"FirstChar",
+    c"LastChar",
+    c"ToUnicode",
+    c"FontDescriptor",
+    c"DescendantFonts",
+];
+
+/// Standard names as `&str`, indexed by `StandardPdfName`
+pub const STANDARD_NAMES: [&str; STANDARD_NAME_COUNT] = {
+    let mut out = [""; STANDARD_NAME_COUNT];
+    let mut i = 0;
+    while i < STANDARD_NAME_COUNT {
+        // SAFETY: the literals above are ASCII
+        out[i] = unsafe { std::str::from_utf8_unchecked(STANDARD_NAME_CSTRS[i].to_bytes()) };
+        i += 1;
+    }
+    out
+};
+
+// ============================================================================
+// Minimal Perfect Hash over the Standard Names
+// ============================================================================
+//
+// Hash-and-displace (CHD): one FNV-1a pass gives a bucket and two slot
+// hashes; each bucket stores the displacement that sends all of its keys to
+// free slots. The table has exactly one slot per name, and it is built by
+// const evaluation, so adding a name to the list above is all it takes to
+// rebuild it (a set the construction can't place fails to compile).
+
+const PH_SEED: u64 = PdfNameHasher::new().seed;
+const PH_BUCKETS: usize = 16;
+/// Displacements tried per bucket: `d0` and `d1` each range over the slots
+const PH_MAX_DISPLACEMENT: usize = STANDARD_NAME_COUNT * STANDARD_NAME_COUNT;
+
+/// FNV-1a over `bytes`, usable in const context
+const fn fnv1a(seed: u64, bytes: &[u8]) -> u64 {
+    let mut hash = seed;
+    let mut i = 0;
+    while i < bytes.len() {
+        hash ^= bytes[i] as u64;
+        hash = hash.wrapping_mul(0x100000001b3);
+        i += 1;
+    }
+    hash
+}
+
+/// Split a hash into (bucket, h1, h2); `h2` is odd so every `d0` stride
+/// visits each slot
+///
+/// The low bits of an FNV product only see the low bits of the input, so
+/// the hash is mixed (murmur3 finalizer) before it is cut up.
+const fn ph_parts(hash: u64) -> (usize, usize, usize) {
+    let mut hash = hash;
+    hash ^= hash >> 33;
+    hash = hash.wrapping_mul(0xff51afd7ed558ccd);
+    hash ^= hash >> 33;
+    let bucket = (hash >> 40) as usize % PH_BUCKETS;
+    let h1 = (hash & 0xffff) as usize;
+    let h2 = ((hash >> 16) & 0xffff) as usize | 1;
+    (bucket, h1, h2)
+}
+
+const fn ph_slot(h1: usize, h2: usize, displacement: usize) -> usize {
+    let d0 = displacement / STANDARD_NAME_COUNT;
+    let d1 = displacement % STANDARD_NAME_COUNT;
+    (h1.wrapping_add(d0.wrapping_mul(h2)).wrapping_add(d1)) % STANDARD_NAME_COUNT
+}
+
+/// Perfect hash tables: per-bucket displacements and slot -> name index
+struct PerfectHash {
+    displacements: [u16; PH_BUCKETS],
+    slots: [u8; STANDARD_NAME_COUNT],
+}
+
+const fn build_perfect_hash() -> PerfectHash {
+    let mut parts = [(0usize, 0usize, 0usize); STANDARD_NAME_COUNT];
+    let mut sizes = [0usize; PH_BUCKETS];
+    let mut i = 0;
+    while i < STANDARD_NAME_COUNT {
+        parts[i] = ph_parts(fnv1a(PH_SEED, STANDARD_NAMES[i].as_bytes()));
+        sizes[parts[i].0] += 1;
+        i += 1;
+    }
+
+    let mut displacements = [0u16; PH_BUCKETS];
+    let mut slots = [u8::MAX; STANDARD_NAME_COUNT];
+    let mut placed = [false; PH_BUCKETS];
+
+    // Place the largest buckets first, while the table is emptiest
+    let mut round = 0;
+    while round < PH_BUCKETS {
+        let mut bucket = PH_BUCKETS;
+        let mut b = 0;
+        while b < PH_BUCKETS {
+            if !placed[b] && (bucket == PH_BUCKETS || sizes[b] > sizes[bucket]) {
+                bucket = b;
+            }
+            b += 1;
+        }
+        placed[bucket] = true;
+        round += 1;
+
+        let mut d = 0;
+        loop {
+            assert!(
+                d < PH_MAX_DISPLACEMENT,
+                "standard name set has no perfect hash; change PH_SEED"
+            );
+            // Tentatively place every key of the bucket; undo on collision
+            let mut taken = [false; STANDARD_NAME_COUNT];
+            let mut ok = true;
+            let mut k = 0;
+            while k < STANDARD_NAME_COUNT {
+                if parts[k].0 == bucket {
+                    let slot = ph_slot(parts[k].1, parts[k].2, d);
+                    if slots[slot] != u8::MAX || taken[slot] {
+                        ok = false;
+                        break;
+                    }
+                    taken[slot] = true;
+                }
+                k += 1;
+            }
+            if ok {
+                let mut k = 0;
+                while k < STANDARD_NAME_COUNT {
+                    if parts[k].0 == bucket {
+                        slots[ph_slot(parts[k].1, parts[k].2, d)] = k as u8;
+                    }
+                    k += 1;
+                }
+                displacements[bucket] = d as u16;
+                break;
+            }
+            d += 1;
+        }
+    }
+
+    PerfectHash {
+        displacements,
+        slots,
+    }
+}
+
+static PERFECT_HASH: PerfectHash = build_perfect_hash();
+
+/// Index of a standard name, or `None` for any other name
+///
+/// One hash pass, two table reads and a single comparison against the
+/// candidate; no locking and no allocation.
+#[inline]
+pub fn standard_name_index(name: &str) -> Option<usize> {
+    let (bucket, h1, h2) = ph_parts(fnv1a(PH_SEED, name.as_bytes()));
+    let displacement = PERFECT_HASH.displacements[bucket] as usize;
+    let index = PERFECT_HASH.slots[ph_slot(h1, h2, displacement)] as usize;
+    (STANDARD_NAMES[index] == name).then_some(index)
+}
 
 // ============================================================================
 // FFI Functions
 // ============================================================================
 
 use super::Handle;
-use std::ffi::{CStr, c_char, c_int};
+use std::ffi::{c_char, c_int};
 
 /// Create a pre-sized HashMap for page dictionary
 #[unsafe(no_mangle)]
@@ -478,80 +631,10 @@ pub extern "C" fn fz_is_standard_name(name: *const c_char) -> c_int {
 /// Get standard name string from index
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_standard_name_str(index: c_int) -> *const c_char {
-    static NAME_STRINGS: LazyLock<Vec<std::ffi::CString>> = LazyLock::new(|| {
-        vec![
-            std::ffi::CString::new("Type").unwrap(),
-            std::ffi::CString::new("Subtype").unwrap(),
-            std::ffi::CString::new("Catalog").unwrap(),
-            std::ffi::CString::new("Pages").unwrap(),
-            std::ffi::CString::new("Page").unwrap(),
-            std::ffi::CString::new("Parent").unwrap(),
-            std::ffi::CString::new("Kids").unwrap(),
-            std::ffi::CString::new("Count").unwrap(),
-            std::ffi::CString::new("Root").unwrap(),
-            std::ffi::CString::new("Info").unwrap(),
-            std::ffi::CString::new("Metadata").unwrap(),
-            std::ffi::CString::new("MediaBox").unwrap(),
-            std::ffi::CString::new("CropBox").unwrap(),
-            std::ffi::CString::new("BleedBox").unwrap(),
-            std::ffi::CString::new("TrimBox").unwrap(),
-            std::ffi::CString::new("ArtBox").unwrap(),
-            std::ffi::CString::new("Resources").unwrap(),
-            std::ffi::CString::new("Contents").unwrap(),
-            std::ffi::CString::new("Rotate").unwrap(),
-            std::ffi::CString::new("UserUnit").unwrap(),
-            std::ffi::CString::new("ExtGState").unwrap(),
-            std::ffi::CString::new("ColorSpace").unwrap(),
-            std::ffi::CString::new("Pattern").unwrap(),
-            std::ffi::CString::new("Shading").unwrap(),
-            std::ffi::CString::new("XObject").unwrap(),
-            std::ffi::CString::new("Font").unwrap(),
-            std::ffi::CString::new("ProcSet").unwrap(),
-            std::ffi::CString::new("Properties").unwrap(),
-            std::ffi::CString::new("Length").unwrap(),
-            std::ffi::CString::new("Filter").unwrap(),
-            std::ffi::CString::new("DecodeParms").unwrap(),
-            std::ffi::CString::new("FlateDecode").unwrap(),
-            std::ffi::CString::new("DCTDecode").unwrap(),
-            std::ffi::CString::new("ASCIIHexDecode").unwrap(),
-            std::ffi::CString::new("ASCII85Decode").unwrap(),
-            std::ffi::CString::new("LZWDecode").unwrap(),
-            std::ffi::CString::new("RunLengthDecode").unwrap(),
-            std::ffi::CString::new("CCITTFaxDecode").unwrap(),
-            std::ffi::CString::new("JBIG2Decode").unwrap(),
-            std::ffi::CString::new("JPXDecode").unwrap(),
-            std::ffi::CString::new("DeviceGray").unwrap(),
-            std::ffi::CString::new("DeviceRGB").unwrap(),
-            std::ffi::CString::new("DeviceCMYK").unwrap(),
-            std::ffi::CString::new("ICCBased").unwrap(),
-            std::ffi::CString::new("Indexed").unwrap(),
-            std::ffi::CString::new("Separation").unwrap(),
-            std::ffi::CString::new("DeviceN").unwrap(),
-            std::ffi::CString::new("Image").unwrap(),
-            std::ffi::CString::new("Form").unwrap(),
-            std::ffi::CString::new("Width").unwrap(),
-            std::ffi::CString::new("Height").unwrap(),
-            std::ffi::CString::new("BitsPerComponent").unwrap(),
-            std::ffi::CString::new("SMask").unwrap(),
-            std::ffi::CString::new("Mask").unwrap(),
-            std::ffi::CString::new("Decode").unwrap(),
-            std::ffi::CString::new("Interpolate").unwrap(),
-            std::ffi::CString::new("BaseFont").unwrap(),
-            std::ffi::CString::new("Encoding").unwrap(),
-            std::ffi::CString::new("Widths").unwrap(),
-            std::ffi::CString::new("FirstChar").unwrap(),
-            std::ffi::CString::new("LastChar").unwrap(),
-            std::ffi::CString::new("ToUnicode").unwrap(),
-            std::ffi::CString::new("FontDescriptor").unwrap(),
-            std::ffi::CString::new("DescendantFonts").unwrap(),
-        ]
-    });
-
-    if index >= 0 && (index as usize) < NAME_STRINGS.len() {
-        NAME_STRINGS[index as usize].as_ptr()
-    } else {
-        std::ptr::null()
-    }
+    usize::try_from(index)
+        .ok()
+        .and_then(|i| STANDARD_NAME_CSTRS.get(i))
+        .map_or(std::ptr::null(), |name| name.as_ptr())
 }
 
 /// Hash a PDF name using the optimized hasher
@@ -567,7 +650,7 @@ pub extern "C" fn fz_hash_pdf_name(name: *const c_char) -> u64 {
 /// Get the number of standard PDF names
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_standard_name_count() -> c_int {
-    64
+    STANDARD_NAME_COUNT as c_int
 }
 
 // ============================================================================
@@ -619,6 +702,22 @@ mod tests {
         );
     }
 
+    #[test]
+    fn test_perfect_hash_is_minimal() {
+        // One slot per name and every name lands on its own index
+        let mut seen = [false; STANDARD_NAME_COUNT];
+        for &slot in &PERFECT_HASH.slots {
+            assert!(!std::mem::replace(&mut seen[slot as usize], true));
+        }
+        for (i, name) in STANDARD_NAMES.iter().enumerate() {
+            assert_eq!(standard_name_index(name), Some(i), "{name}");
+            assert_eq!(StandardPdfName::ALL[i] as usize, i);
+        }
+        for name in ["", "type", "Types", "MediaBo", "Annots", "DescendantFontsX"] {
+            assert_eq!(standard_name_index(name), None, "{name}");
+        }
+    }
+
     #[test]
     fn test_standard_name_str() {
         assert_eq!(StandardPdfName::Type.as_str(), "Type");
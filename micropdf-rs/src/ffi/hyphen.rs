@@ -4,7 +4,7 @@
 
 use crate::ffi::{Handle, HandleStore};
 use std::collections::HashMap;
-use std::ffi::{CStr, CString, c_char};
+use std::ffi::{CStr, c_char};
 use std::ptr;
 use std::sync::LazyLock;
 
@@ -89,38 +89,43 @@ impl TextLanguage {
     }
 
     pub fn code(&self) -> &'static str {
+        self.c_code().to_str().unwrap_or("")
+    }
+
+    /// Language code, NUL-terminated for C callers
+    pub fn c_code(&self) -> &'static CStr {
         match self {
-            TextLanguage::Unset => "",
-            TextLanguage::En => "en",
-            TextLanguage::De => "de",
-            TextLanguage::Fr => "fr",
-            TextLanguage::Es => "es",
-            TextLanguage::It => "it",
-            TextLanguage::Pt => "pt",
-            TextLanguage::Nl => "nl",
-            TextLanguage::Ru => "ru",
-            TextLanguage::Pl => "pl",
-            TextLanguage::Cs => "cs",
-            TextLanguage::Sv => "sv",
-            TextLanguage::Da => "da",
-            TextLanguage::No => "no",
-            TextLanguage::Fi => "fi",
-            TextLanguage::Hu => "hu",
-            TextLanguage::El => "el",
-            TextLanguage::Tr => "tr",
-            TextLanguage::Uk => "uk",
-            TextLanguage::Hr => "hr",
-            TextLanguage::Sk => "sk",
-            TextLanguage::Sl => "sl",
-            TextLanguage::Bg => "bg",
-            TextLanguage::Ro => "ro",
-            TextLanguage::Lt => "lt",
-            TextLanguage::Lv => "lv",
-            TextLanguage::Et => "et",
-            TextLanguage::Ca => "ca",
-            TextLanguage::Eu => "eu",
-            TextLanguage::Gl => "gl",
-            TextLanguage::La => "la",
+            TextLanguage::Unset => c"",
+            TextLanguage::En => c"en",
+            TextLanguage::De => c"de",
+            TextLanguage::Fr => c"fr",
+            TextLanguage::Es => c"es",
+            TextLanguage::It => c"it",
+            TextLanguage::Pt => c"pt",
+            TextLanguage::Nl => c"nl",
+            TextLanguage::Ru => c"ru",
+            TextLanguage::Pl => c"pl",
+            TextLanguage::Cs => c"cs",
+            TextLanguage::Sv => c"sv",
+            TextLanguage::Da => c"da",
+            TextLanguage::No => c"no",
+            TextLanguage::Fi => c"fi",
+            TextLanguage::Hu => c"hu",
+            TextLanguage::El => c"el",
+            TextLanguage::Tr => c"tr",
+            TextLanguage::Uk => c"uk",
+            TextLanguage::Hr => c"hr",
+            TextLanguage::Sk => c"sk",
+            TextLanguage::Sl => c"sl",
+            TextLanguage::Bg => c"bg",
+            TextLanguage::Ro => c"ro",
+            TextLanguage::Lt => c"lt",
+            TextLanguage::Lv => c"lv",
+            TextLanguage::Et => c"et",
+            TextLanguage::Ca => c"ca",
+            TextLanguage::Eu => c"eu",
+            TextLanguage::Gl => c"gl",
+            TextLanguage::La => c"la",
         }
     }
 }
@@ -732,16 +737,10 @@ pub extern "C" fn fz_hyphenator_language(_ctx: Handle, hyph: Handle) -> i32 {
 /// Get language name
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_text_language_code(language: i32) -> *const c_char {
-    static CODES: LazyLock<HashMap<i32, CString>> = LazyLock::new(|| {
-        let mut map = HashMap::new();
-        for i in 0..=30 {
-            let lang = TextLanguage::from_i32(i);
-            map.insert(i, CString::new(lang.code()).unwrap());
-        }
-        map
-    });
-
-    CODES.get(&language).map_or(ptr::null(), |s| s.as_ptr())
+    if !(0..=30).contains(&language) {
+        return ptr::null();
+    }
+    TextLanguage::from_i32(language).c_code().as_ptr()
 }
 
 /// Check if a character is a Unicode hyphen
@@ -784,6 +783,7 @@ pub extern "C" fn fz_is_unicode_hyphen(c: u32) -> i32 {
 #[cfg(test)]
 mod tests {
     use super::*;
+    use std::ffi::CString;
 
     #[test]
     fn test_language_enum() {
@@ -0,0 +1,801 @@
+//! ICC Profiles and Cached Transforms
+//!
+//! Profiles are read for what a matrix/TRC engine needs: the data colour
+//! space, and for gray and RGB profiles the tone curves and colorant
+//! matrix. Profiles built on lookup tables (most CMYK ones) fall back to
+//! the device formulas for their space. Conversions go through the PCS as
+//! D50 XYZ, with the device spaces standing in as sRGB.
+//!
+//! Building a transform precomputes a lookup table over the source space:
+//! a 256-entry curve from gray, a 33-point grid from three components and
+//! a 17-point grid from four, read back by tetrahedral interpolation (and
+//! linear between the two K slices of a CMYK grid). Single colours are
+//! converted exactly; pixmaps through the table. Transforms are cached
+//! process-wide by (source profile hash, destination profile hash, intent,
+//! flags), so every context, cloned or not, and every document converting
+//! between the same pair of profiles shares one.
+
+use super::simd_util::hash64;
+use std::collections::HashMap;
+use std::sync::{Arc, LazyLock, Mutex};
+
+/// D50 white, the PCS illuminant
+const D50: [f32; 3] = [0.9642, 1.0, 0.8249];
+
+/// Linear sRGB to D50 XYZ (Bradford-adapted)
+const SRGB_TO_XYZ: [[f32; 3]; 3] = [
+    [0.436_074_7, 0.385_064_9, 0.143_080_4],
+    [0.222_504_5, 0.716_878_6, 0.060_616_9],
+    [0.013_932_2, 0.097_104_5, 0.714_173_3],
+];
+
+/// The sRGB tone curve as ICC parametric type 3: g, a, b, c, d
+const SRGB_CURVE: [f32; 7] = [
+    2.4,
+    1.0 / 1.055,
+    0.055 / 1.055,
+    1.0 / 12.92,
+    0.04045,
+    0.0,
+    0.0,
+];
+
+/// Samples in a curve's inverse table
+const INVERSE_SIZE: usize = 4096;
+
+/// Grid points per axis of a three-component lookup table
+const GRID3: usize = 33;
+
+/// Grid points per axis of a four-component lookup table
+const GRID4: usize = 17;
+
+/// Transforms kept before the cache is emptied
+const MAX_TRANSFORMS: usize = 32;
+
+// ============================================================================
+// Curves
+// ============================================================================
+
+#[derive(Debug, Clone)]
+enum CurveKind {
+    Identity,
+    Gamma(f32),
+    /// Samples over [0, 1]
+    Table(Vec<f32>),
+    /// ICC parametric function type and its parameters g, a, b, c, d, e, f
+    Parametric(u16, [f32; 7]),
+}
+
+/// A tone curve with its sampled inverse
+#[derive(Debug, Clone)]
+struct Curve {
+    kind: CurveKind,
+    inverse: Vec<f32>,
+}
+
+impl Curve {
+    fn new(kind: CurveKind) -> Self {
+        let mut curve = Self {
+            kind,
+            inverse: Vec::new(),
+        };
+        if !matches!(curve.kind, CurveKind::Identity) {
+            curve.inverse = curve.sample_inverse();
+        }
+        curve
+    }
+
+    fn eval(&self, x: f32) -> f32 {
+        let x = x.clamp(0.0, 1.0);
+        let y = match &self.kind {
+            CurveKind::Identity => x,
+            CurveKind::Gamma(g) => x.powf(*g),
+            CurveKind::Table(samples) => lerp_table(samples, x),
+            CurveKind::Parametric(kind, p) => {
+                let [g, a, b, c, d, e, f] = *p;
+                match kind {
+                    0 => x.powf(g),
+                    1 if x >= -b / a => (a * x + b).powf(g),
+                    1 => 0.0,
+                    2 if x >= -b / a => (a * x + b).powf(g) + c,
+                    2 => c,
+                    3 if x >= d => (a * x + b).powf(g),
+                    3 => c * x,
+                    _ if x >= d => (a * x + b).powf(g) + e,
+                    _ => c * x + f,
+                }
+            }
+        };
+        y.clamp(0.0, 1.0)
+    }
+
+    fn eval_inverse(&self, y: f32) -> f32 {
+        match self.kind {
+            CurveKind::Identity => y.clamp(0.0, 1.0),
+            _ => lerp_table(&self.inverse, y.clamp(0.0, 1.0)),
+        }
+    }
+
+    /// The inverse sampled by bisection, the curve taken as monotonic
+    fn sample_inverse(&self) -> Vec<f32> {
+        let rising = self.eval(1.0) >= self.eval(0.0);
+        (0..INVERSE_SIZE)
+            .map(|i| {
+                let y = i as f32 / (INVERSE_SIZE - 1) as f32;
+                let (mut lo, mut hi) = (0.0f32, 1.0f32);
+                for _ in 0..24 {
+                    let mid = (lo + hi) / 2.0;
+                    if (self.eval(mid) < y) == rising {
+                        lo = mid;
+                    } else {
+                        hi = mid;
+                    }
+                }
+                (lo + hi) / 2.0
+            })
+            .collect()
+    }
+}
+
+fn lerp_table(samples: &[f32], x: f32) -> f32 {
+    let pos = x * (samples.len() - 1) as f32;
+    let i = (pos as usize).min(samples.len().saturating_sub(2));
+    let f = pos - i as f32;
+    match samples.get(i + 1) {
+        Some(&next) => samples[i] + (next - samples[i]) * f,
+        None => samples[i],
+    }
+}
+
+// ============================================================================
+// Profiles
+// ============================================================================
+
+#[derive(Debug, Clone)]
+enum Model {
+    Gray(Curve),
+    Matrix {
+        to_xyz: [[f32; 3]; 3],
+        from_xyz: [[f32; 3]; 3],
+        trc: Box<[Curve; 3]>,
+    },
+    /// CMYK by the device formulas, over sRGB
+    DeviceCmyk,
+}
+
+/// An ICC profile, reduced to what conversions need
+#[derive(Debug, Clone)]
+pub struct IccProfile {
+    /// Hash of the profile data, identifying it in the transform cache
+    pub(crate) hash: u64,
+    n: usize,
+    model: Model,
+    /// Components stored in reverse order (BGR)
+    reversed: bool,
+}
+
+fn be_u32(data: &[u8], at: usize) -> Option<u32> {
+    Some(u32::from_be_bytes(data.get(at..at + 4)?.try_into().ok()?))
+}
+
+fn be_u16(data: &[u8], at: usize) -> Option<u16> {
+    Some(u16::from_be_bytes(data.get(at..at + 2)?.try_into().ok()?))
+}
+
+fn s15_16(data: &[u8], at: usize) -> Option<f32> {
+    Some(be_u32(data, at)? as i32 as f32 / 65536.0)
+}
+
+fn invert(m: &[[f32; 3]; 3]) -> Option<[[f32; 3]; 3]> {
+    let cof =
+        |r0: usize, r1: usize, c0: usize, c1: usize| m[r0][c0] * m[r1][c1] - m[r0][c1] * m[r1][c0];
+    let det = m[0][0] * cof(1, 2, 1, 2) - m[0][1] * cof(1, 2, 0, 2) + m[0][2] * cof(1, 2, 0, 1);
+    if det.abs() < 1e-9 {
+        return None;
+    }
+    let inv = 1.0 / det;
+    Some([
+        [
+            cof(1, 2, 1, 2) * inv,
+            -cof(0, 2, 1, 2) * inv,
+            cof(0, 1, 1, 2) * inv,
+        ],
+        [
+            -cof(1, 2, 0, 2) * inv,
+            cof(0, 2, 0, 2) * inv,
+            -cof(0, 1, 0, 2) * inv,
+        ],
+        [
+            cof(1, 2, 0, 1) * inv,
+            -cof(0, 2, 0, 1) * inv,
+            cof(0, 1, 0, 1) * inv,
+        ],
+    ])
+}
+
+fn mul(m: &[[f32; 3]; 3], v: [f32; 3]) -> [f32; 3] {
+    std::array::from_fn(|r| m[r][0] * v[0] + m[r][1] * v[1] + m[r][2] * v[2])
+}
+
+/// Tag `sig`'s data in profile `data`
+fn tag<'a>(data: &'a [u8], sig: &[u8; 4]) -> Option<&'a [u8]> {
+    let count = be_u32(data, 128)? as usize;
+    (0..count.min(1024)).find_map(|i| {
+        let entry = 132 + i * 12;
+        if data.get(entry..entry + 4)? != sig {
+            return None;
+        }
+        let offset = be_u32(data, entry + 4)? as usize;
+        let size = be_u32(data, entry + 8)? as usize;
+        data.get(offset..offset.checked_add(size)?)
+    })
+}
+
+fn read_curve(data: &[u8], sig: &[u8; 4]) -> Option<Curve> {
+    let tag = tag(data, sig)?;
+    let kind = match tag.get(0..4)? {
+        b"curv" => match be_u32(tag, 8)? {
+            0 => CurveKind::Identity,
+            1 => CurveKind::Gamma(f32::from(be_u16(tag, 12)?) / 256.0),
+            n => CurveKind::Table(
+                (0..n as usize)
+                    .map(|i| be_u16(tag, 12 + i * 2).map(|v| f32::from(v) / 65535.0))
+                    .collect::<Option<_>>()?,
+            ),
+        },
+        b"para" => {
+            let kind = be_u16(tag, 8)?;
+            let count = [1, 3, 4, 5, 7].get(usize::from(kind)).copied()?;
+            let mut params = [0.0; 7];
+            for (i, param) in params.iter_mut().enumerate().take(count) {
+                *param = s15_16(tag, 12 + i * 4)?;
+            }
+            CurveKind::Parametric(kind, params)
+        }
+        _ => return None,
+    };
+    Some(Curve::new(kind))
+}
+
+fn read_xyz(data: &[u8], sig: &[u8; 4]) -> Option<[f32; 3]> {
+    let tag = tag(data, sig)?;
+    (tag.get(0..4)? == b"XYZ ").then_some(())?;
+    Some([s15_16(tag, 8)?, s15_16(tag, 12)?, s15_16(tag, 16)?])
+}
+
+impl IccProfile {
+    /// Read `data` as an ICC profile
+    ///
+    /// Gray, RGB and CMYK profiles are accepted; any whose tags this
+    /// engine can't use converts as its device space would.
+    pub fn parse(data: &[u8]) -> Option<Self> {
+        if data.len() < 132 || data.get(36..40)? != b"acsp" {
+            return None;
+        }
+        let hash = hash64(data);
+        let model = match data.get(16..20)? {
+            b"GRAY" => read_curve(data, b"kTRC")
+                .map(Model::Gray)
+                .unwrap_or_else(|| Model::Gray(Curve::new(CurveKind::Parametric(3, SRGB_CURVE)))),
+            b"RGB " => Self::read_matrix(data).unwrap_or_else(Self::srgb_model),
+            b"CMYK" => Model::DeviceCmyk,
+            _ => return None,
+        };
+        Some(Self {
+            hash,
+            n: Self::model_n(&model),
+            model,
+            reversed: false,
+        })
+    }
+
+    fn read_matrix(data: &[u8]) -> Option<Model> {
+        let columns = [
+            read_xyz(data, b"rXYZ")?,
+            read_xyz(data, b"gXYZ")?,
+            read_xyz(data, b"bXYZ")?,
+        ];
+        let to_xyz = std::array::from_fn(|r| std::array::from_fn(|c| columns[c][r]));
+        Some(Model::Matrix {
+            to_xyz,
+            from_xyz: invert(&to_xyz)?,
+            trc: Box::new([
+                read_curve(data, b"rTRC")?,
+                read_curve(data, b"gTRC")?,
+                read_curve(data, b"bTRC")?,
+            ]),
+        })
+    }
+
+    fn srgb_model() -> Model {
+        let curve = Curve::new(CurveKind::Parametric(3, SRGB_CURVE));
+        Model::Matrix {
+            to_xyz: SRGB_TO_XYZ,
+            from_xyz: invert(&SRGB_TO_XYZ).expect("sRGB matrix is invertible"),
+            trc: Box::new([curve.clone(), curve.clone(), curve]),
+        }
+    }
+
+    fn model_n(model: &Model) -> usize {
+        match model {
+            Model::Gray(_) => 1,
+            Model::Matrix { .. } => 3,
+            Model::DeviceCmyk => 4,
+        }
+    }
+
+    fn device(name: &[u8], model: Model, reversed: bool) -> Self {
+        Self {
+            hash: hash64(name),
+            n: Self::model_n(&model),
+            model,
+            reversed,
+        }
+    }
+
+    /// Components of a colour in this profile's space
+    pub fn n(&self) -> usize {
+        self.n
+    }
+
+    /// D50 XYZ of colour `v`
+    fn to_xyz(&self, v: &[f32]) -> [f32; 3] {
+        let mut c = [0.0f32; 4];
+        c[..self.n].copy_from_slice(&v[..self.n]);
+        if self.reversed {
+            c[..self.n].reverse();
+        }
+        match &self.model {
+            Model::Gray(trc) => D50.map(|w| w * trc.eval(c[0])),
+            Model::Matrix { to_xyz, trc, .. } => mul(
+                to_xyz,
+                [trc[0].eval(c[0]), trc[1].eval(c[1]), trc[2].eval(c[2])],
+            ),
+            Model::DeviceCmyk => {
+                let k = 1.0 - c[3].clamp(0.0, 1.0);
+                let rgb = [0, 1, 2].map(|i| (1.0 - c[i].clamp(0.0, 1.0)) * k);
+                DEVICE_RGB.to_xyz(&rgb)
+            }
+        }
+    }
+
+    /// Colour in this profile's space of D50 XYZ `xyz`
+    fn from_xyz(&self, xyz: [f32; 3]) -> [f32; 4] {
+        let mut out = [0.0f32; 4];
+        match &self.model {
+            Model::Gray(trc) => out[0] = trc.eval_inverse(xyz[1]),
+            Model::Matrix { from_xyz, trc, .. } => {
+                let linear = mul(from_xyz, xyz);
+                for i in 0..3 {
+                    out[i] = trc[i].eval_inverse(linear[i]);
+                }
+            }
+            Model::DeviceCmyk => {
+                let rgb = DEVICE_RGB.from_xyz(xyz);
+                let k = 1.0 - rgb[0].max(rgb[1]).max(rgb[2]);
+                if k < 1.0 {
+                    for i in 0..3 {
+                        out[i] = (1.0 - rgb[i] - k) / (1.0 - k);
+                    }
+                }
+                out[3] = k;
+            }
+        }
+        if self.reversed {
+            out[..self.n].reverse();
+        }
+        out
+    }
+}
+
+/// Profiles the device spaces stand for
+pub(crate) static DEVICE_GRAY: LazyLock<Arc<IccProfile>> = LazyLock::new(|| {
+    let curve = Curve::new(CurveKind::Parametric(3, SRGB_CURVE));
+    Arc::new(IccProfile::device(b"DeviceGray", Model::Gray(curve), false))
+});
+pub(crate) static DEVICE_RGB: LazyLock<Arc<IccProfile>> = LazyLock::new(|| {
+    Arc::new(IccProfile::device(
+        b"DeviceRGB",
+        IccProfile::srgb_model(),
+        false,
+    ))
+});
+pub(crate) static DEVICE_BGR: LazyLock<Arc<IccProfile>> = LazyLock::new(|| {
+    Arc::new(IccProfile::device(
+        b"DeviceBGR",
+        IccProfile::srgb_model(),
+        true,
+    ))
+});
+pub(crate) static DEVICE_CMYK: LazyLock<Arc<IccProfile>> =
+    LazyLock::new(|| Arc::new(IccProfile::device(b"DeviceCMYK", Model::DeviceCmyk, false)));
+
+// ============================================================================
+// Transforms
+// ============================================================================
+
+/// A transform between two profiles, with its lookup table
+pub struct IccTransform {
+    src: Arc<IccProfile>,
+    dst: Arc<IccProfile>,
+    grid: usize,
+    /// `dst.n` outputs per grid node, the last source component fastest
+    table: Vec<f32>,
+}
+
+impl IccTransform {
+    fn new(src: Arc<IccProfile>, dst: Arc<IccProfile>) -> Self {
+        let grid = match src.n {
+            1 => 256,
+            3 => GRID3,
+            _ => GRID4,
+        };
+        let (n, dn) = (src.n, dst.n);
+        let nodes = grid.pow(n as u32);
+        let mut table = Vec::with_capacity(nodes * dn);
+        let mut v = [0.0f32; 4];
+        for node in 0..nodes {
+            let mut rest = node;
+            for c in (0..n).rev() {
+                v[c] = (rest % grid) as f32 / (grid - 1) as f32;
+                rest /= grid;
+            }
+            table.extend_from_slice(&dst.from_xyz(src.to_xyz(&v))[..dn]);
+        }
+        Self {
+            src,
+            dst,
+            grid,
+            table,
+        }
+    }
+
+    /// Convert colour `v` exactly, without the table
+    pub fn eval(&self, v: &[f32]) -> [f32; 4] {
+        self.dst.from_xyz(self.src.to_xyz(v))
+    }
+
+    /// Convert colour `v` through the table
+    pub fn lookup(&self, v: &[f32]) -> [f32; 4] {
+        let g = self.grid;
+        let dn = self.dst.n;
+        let scale = (g - 1) as f32;
+        let split = |x: f32| {
+            let pos = x.clamp(0.0, 1.0) * scale;
+            let i = (pos as usize).min(g - 2);
+            (i, pos - i as f32)
+        };
+        let mut out = [0.0f32; 4];
+        match self.src.n {
+            1 => {
+                let (i, f) = split(v[0]);
+                for o in 0..dn {
+                    let (a, b) = (self.table[i * dn + o], self.table[(i + 1) * dn + o]);
+                    out[o] = a + (b - a) * f;
+                }
+            }
+            3 => tetrahedral(
+                &self.table,
+                g,
+                dn,
+                0,
+                [split(v[0]), split(v[1]), split(v[2])],
+                &mut out,
+            ),
+            _ => {
+                // Two CMY tetrahedra, at the K slices either side
+                let (k, fk) = split(v[3]);
+                let cmy = [split(v[0]), split(v[1]), split(v[2])];
+                let mut upper = [0.0f32; 4];
+                tetrahedral4(&self.table, g, dn, k, cmy, &mut out);
+                tetrahedral4(&self.table, g, dn, k + 1, cmy, &mut upper);
+                for o in 0..dn {
+                    out[o] += (upper[o] - out[o]) * fk;
+                }
+            }
+        }
+        out
+    }
+
+    /// Convert `count` premultiplied 8-bit pixels from `src` into `dst`,
+    /// alpha last on each side if `src_alpha` / `dst_alpha`
+    pub fn convert_pixels(
+        &self,
+        src: &[u8],
+        src_alpha: bool,
+        dst: &mut [u8],
+        dst_alpha: bool,
+        count: usize,
+    ) {
+        let (sc, dc) = (self.src.n, self.dst.n);
+        let (sn, dn) = (sc + usize::from(src_alpha), dc + usize::from(dst_alpha));
+        let pixels = src
+            .chunks_exact(sn)
+            .zip(dst.chunks_exact_mut(dn))
+            .take(count);
+        // Runs of one colour are common in images; convert each run once
+        let mut last: Option<(&[u8], [u8; 4])> = None;
+        for (px, out) in pixels {
+            let a = if src_alpha { px[sc] } else { 255 };
+            let colour = match last {
+                Some((prev, colour)) if prev == px => colour,
+                _ => {
+                    let mut v = [0.0f32; 4];
+                    if a > 0 {
+                        for c in 0..sc {
+                            v[c] = f32::from(px[c].min(a)) / f32::from(a);
+                        }
+                    }
+                    let converted = self.lookup(&v);
+                    let colour = converted.map(|x| (x.clamp(0.0, 1.0) * f32::from(a) + 0.5) as u8);
+                    last = Some((px, colour));
+                    colour
+                }
+            };
+            out[..dc].copy_from_slice(&colour[..dc]);
+            if dst_alpha {
+                out[dc] = a;
+            }
+        }
+    }
+}
+
+/// Tetrahedral interpolation in the 3D grid at `base` (a node offset) of
+/// `table`, with `g` points per axis and `dn` outputs per node, node
+/// strides `s`
+fn tetrahedral_with(
+    table: &[f32],
+    dn: usize,
+    base: usize,
+    s: [usize; 3],
+    [(x, fx), (y, fy), (z, fz)]: [(usize, f32); 3],
+    out: &mut [f32; 4],
+) {
+    let at = |dx: usize, dy: usize, dz: usize| {
+        (base + (x + dx) * s[0] + (y + dy) * s[1] + (z + dz) * s[2]) * dn
+    };
+    let c000 = at(0, 0, 0);
+    let c111 = at(1, 1, 1);
+    // The tetrahedron containing the point, as its path from c000 to c111
+    let (c1, c2, f1, f2, f3) = if fx >= fy {
+        if fy >= fz {
+            (at(1, 0, 0), at(1, 1, 0), fx, fy, fz)
+        } else if fx >= fz {
+            (at(1, 0, 0), at(1, 0, 1), fx, fz, fy)
+        } else {
+            (at(0, 0, 1), at(1, 0, 1), fz, fx, fy)
+        }
+    } else if fx >= fz {
+        (at(0, 1, 0), at(1, 1, 0), fy, fx, fz)
+    } else if fy >= fz {
+        (at(0, 1, 0), at(0, 1, 1), fy, fz, fx)
+    } else {
+        (at(0, 0, 1), at(0, 1, 1), fz, fy, fx)
+    };
+    for o in 0..dn {
+        let (p0, p1, p2, p3) = (
+            table[c000 + o],
+            table[c1 + o],
+            table[c2 + o],
+            table[c111 + o],
+        );
+        out[o] = p0 + f1 * (p1 - p0) + f2 * (p2 - p1) + f3 * (p3 - p2);
+    }
+}
+
+fn tetrahedral(
+    table: &[f32],
+    g: usize,
+    dn: usize,
+    base: usize,
+    v: [(usize, f32); 3],
+    out: &mut [f32; 4],
+) {
+    tetrahedral_with(table, dn, base, [g * g, g, 1], v, out)
+}
+
+/// Tetrahedral interpolation over C, M, Y of a 4D grid at K slice `k`
+fn tetrahedral4(
+    table: &[f32],
+    g: usize,
+    dn: usize,
+    k: usize,
+    v: [(usize, f32); 3],
+    out: &mut [f32; 4],
+) {
+    tetrahedral_with(table, dn, k, [g * g * g, g * g, g], v, out)
+}
+
+/// Cache key of a transform
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub struct TransformKey {
+    pub src: u64,
+    pub dst: u64,
+    pub intent: i32,
+    pub flags: i32,
+}
+
+static TRANSFORMS: LazyLock<Mutex<HashMap<TransformKey, Arc<IccTransform>>>> =
+    LazyLock::new(|| Mutex::new(HashMap::new()));
+
+/// The transform from `src` to `dst`, built once per (profiles, `intent`,
+/// `flags`) for the whole process
+pub fn transform(
+    src: &Arc<IccProfile>,
+    dst: &Arc<IccProfile>,
+    intent: i32,
+    flags: i32,
+) -> Arc<IccTransform> {
+    let key = TransformKey {
+        src: src.hash,
+        dst: dst.hash,
+        intent,
+        flags,
+    };
+    if let Some(found) = TRANSFORMS.lock().unwrap().get(&key) {
+        return Arc::clone(found);
+    }
+    // Built outside the lock; if another thread got there first, keep its
+    let built = Arc::new(IccTransform::new(Arc::clone(src), Arc::clone(dst)));
+    let mut cache = TRANSFORMS.lock().unwrap();
+    if cache.len() >= MAX_TRANSFORMS && !cache.contains_key(&key) {
+        cache.clear();
+    }
+    Arc::clone(cache.entry(key).or_insert(built))
+}
+
+/// Number of transforms currently cached
+pub fn cached_transforms() -> usize {
+    TRANSFORMS.lock().unwrap().len()
+}
+
+#[cfg(test)]
+pub(crate) mod tests {
+    use super::*;
+
+    fn s15(v: f32) -> [u8; 4] {
+        ((v * 65536.0).round() as i32).to_be_bytes()
+    }
+
+    /// A profile in `space` with `tags` (signature, tag data)
+    pub(crate) fn profile(space: &[u8; 4], tags: &[(&[u8; 4], Vec<u8>)]) -> Vec<u8> {
+        let mut data = vec![0u8; 128];
+        data[16..20].copy_from_slice(space);
+        data[20..24].copy_from_slice(b"XYZ ");
+        data[36..40].copy_from_slice(b"acsp");
+        data.extend_from_slice(&(tags.len() as u32).to_be_bytes());
+        let mut offset = 132 + tags.len() * 12;
+        let mut body = Vec::new();
+        for (sig, tag) in tags {
+            data.extend_from_slice(*sig);
+            data.extend_from_slice(&(offset as u32).to_be_bytes());
+            data.extend_from_slice(&(tag.len() as u32).to_be_bytes());
+            body.extend_from_slice(tag);
+            offset += tag.len();
+        }
+        data.extend(body);
+        let len = data.len() as u32;
+        data[0..4].copy_from_slice(&len.to_be_bytes());
+        data
+    }
+
+    fn gamma(g: f32) -> Vec<u8> {
+        let mut tag = b"curv\0\0\0\0\0\0\0\x01".to_vec();
+        tag.extend_from_slice(&((g * 256.0) as u16).to_be_bytes());
+        tag
+    }
+
+    fn xyz(v: [f32; 3]) -> Vec<u8> {
+        let mut tag = b"XYZ \0\0\0\0".to_vec();
+        v.iter().for_each(|&c| tag.extend_from_slice(&s15(c)));
+        tag
+    }
+
+    /// An RGB profile with sRGB's primaries and gamma `g` curves
+    pub(crate) fn rgb_profile(g: f32) -> Vec<u8> {
+        let column = |c: usize| xyz([SRGB_TO_XYZ[0][c], SRGB_TO_XYZ[1][c], SRGB_TO_XYZ[2][c]]);
+        profile(
+            b"RGB ",
+            &[
+                (b"rXYZ", column(0)),
+                (b"gXYZ", column(1)),
+                (b"bXYZ", column(2)),
+                (b"rTRC", gamma(g)),
+                (b"gTRC", gamma(g)),
+                (b"bTRC", gamma(g)),
+            ],
+        )
+    }
+
+    #[test]
+    fn test_parse_reads_space_and_rejects_junk() {
+        assert_eq!(IccProfile::parse(&rgb_profile(2.2)).unwrap().n(), 3);
+        assert_eq!(
+            IccProfile::parse(&profile(b"GRAY", &[(b"kTRC", gamma(1.8))]))
+                .unwrap()
+                .n(),
+            1
+        );
+        assert_eq!(IccProfile::parse(&profile(b"CMYK", &[])).unwrap().n(), 4);
+        assert!(IccProfile::parse(&profile(b"Lab ", &[])).is_none());
+        assert!(IccProfile::parse(&[0; 200]).is_none());
+    }
+
+    #[test]
+    fn test_matrix_profile_round_trips_through_device_rgb() {
+        let profile = Arc::new(IccProfile::parse(&rgb_profile(2.2)).unwrap());
+        let there = transform(&profile, &DEVICE_RGB, 0, 0);
+        let back = transform(&DEVICE_RGB, &profile, 0, 0);
+        for v in [
+            [0.2, 0.5, 0.9],
+            [1.0, 1.0, 1.0],
+            [0.0, 0.0, 0.0],
+            [0.7, 0.1, 0.3],
+        ] {
+            let out = back.eval(&there.eval(&v));
+            for c in 0..3 {
+                assert!((out[c] - v[c]).abs() < 2e-3, "{v:?} -> {out:?}");
+            }
+        }
+        // A linear profile's mid-gray is lighter in sRGB
+        let linear = Arc::new(IccProfile::parse(&rgb_profile(1.0)).unwrap());
+        let mid = transform(&linear, &DEVICE_RGB, 0, 0).eval(&[0.5, 0.5, 0.5]);
+        assert!(mid[0] > 0.7 && (mid[0] - mid[2]).abs() < 2e-3, "{mid:?}");
+    }
+
+    #[test]
+    fn test_lookup_tracks_exact_conversion() {
+        let profile = Arc::new(IccProfile::parse(&rgb_profile(1.8)).unwrap());
+        for (src, dst) in [
+            (Arc::clone(&profile), Arc::clone(&*DEVICE_CMYK)),
+            (Arc::clone(&*DEVICE_CMYK), Arc::clone(&profile)),
+            (Arc::clone(&*DEVICE_GRAY), Arc::clone(&profile)),
+        ] {
+            let t = transform(&src, &dst, 0, 0);
+            for i in 0..200 {
+                let v: [f32; 4] =
+                    std::array::from_fn(|c| ((i * 37 + c * 101) % 256) as f32 / 255.0);
+                let (exact, looked_up) = (t.eval(&v), t.lookup(&v));
+                for c in 0..dst.n() {
+                    assert!(
+                        (exact[c] - looked_up[c]).abs() < 3.0 / 255.0,
+                        "{v:?}: {exact:?} {looked_up:?}"
+                    );
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn test_transforms_are_cached_by_profiles_intent_and_flags() {
+        let profile = Arc::new(IccProfile::parse(&rgb_profile(2.6)).unwrap());
+        let again = Arc::new(IccProfile::parse(&rgb_profile(2.6)).unwrap());
+        let first = transform(&profile, &DEVICE_GRAY, 1, 0);
+        assert!(Arc::ptr_eq(&first, &transform(&again, &DEVICE_GRAY, 1, 0)));
+        assert!(!Arc::ptr_eq(
+            &first,
+            &transform(&profile, &DEVICE_GRAY, 2, 0)
+        ));
+        assert!(!Arc::ptr_eq(
+            &first,
+            &transform(&profile, &DEVICE_GRAY, 1, 1)
+        ));
+        assert!(cached_transforms() >= 1);
+    }
+
+    #[test]
+    fn test_convert_pixels_keeps_alpha_and_premultiplies() {
+        let t = transform(&DEVICE_RGB, &DEVICE_BGR, 0, 0);
+        let mut out = [0u8; 8];
+        t.convert_pixels(
+            &[200, 100, 0, 255, 100, 50, 0, 128],
+            true,
+            &mut out,
+            true,
+            2,
+        );
+        for (got, want) in out.iter().zip([0, 100, 200, 255, 0, 50, 100, 128]) {
+            assert!(got.abs_diff(want) <= 1, "{out:?}");
+        }
+    }
+}
@@ -2,12 +2,42 @@
 //!
 //! Provides FFI bindings for image loading and rendering.
 
+use super::geometry::{fz_invert_matrix, fz_irect, fz_matrix, fz_rect, fz_transform_rect};
+use super::pixmap::Pixmap;
+use super::resample::subsample;
+use super::store::{
+    StoreType, store_discard_matching, store_find_and_keep, store_owned_item, store_type_budget,
+};
 use super::{BUFFERS, Handle, HandleStore, PIXMAPS};
-use crate::fitz::image::Image;
-use std::sync::LazyLock;
+use crate::fitz::alloc_sampler::{self, Subsystem};
+use crate::fitz::counters::{self, Counter};
+use crate::fitz::image::{Image, ImageFormat};
+use crate::fitz::memory_budget;
+use crate::pdf::filter::{
+    decode_dct, decode_dct_scaled, decode_dct_scaled_region, decode_flate_rows, decode_jpx_reduced,
+};
+use std::collections::HashMap;
+use std::sync::{LazyLock, Mutex};
+use std::time::Instant;
 
 /// Image storage
-pub static IMAGES: LazyLock<HandleStore<Image>> = LazyLock::new(HandleStore::default);
+pub static IMAGES: LazyLock<HandleStore<Image>> =
+    LazyLock::new(|| HandleStore::with_lookup_counter(Counter::ImageLookups));
+
+/// Smallest `l2factor` each image has been decoded at, i.e. its largest
+/// level in the decoded-image cache
+static DECODED_LEVELS: LazyLock<Mutex<HashMap<Handle, i32>>> = LazyLock::new(Default::default);
+
+/// Largest reduction a decode is asked for (1/65536)
+const MAX_L2FACTOR: i32 = 16;
+
+/// Most resolution levels a JPEG 2000 decode drops (1/32 size), the
+/// codec's default number of wavelet decompositions
+const MAX_JPX_REDUCE: i32 = 5;
+
+/// A decoded pixmap is cached only while it takes at most this share of
+/// the decoded-image budget, so one huge image doesn't evict all others
+const DECODED_ADMIT_SHARE: usize = 4;
 
 /// Helper to convert fitz::colorspace::Colorspace to a colorspace handle
 fn colorspace_to_handle(cs: &crate::fitz::colorspace::Colorspace) -> u64 {
@@ -76,7 +106,9 @@ pub extern "C" fn fz_keep_image(_ctx: Handle, image: Handle) -> Handle {
 /// Drop image reference
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_drop_image(_ctx: Handle, image: Handle) {
-    let _ = IMAGES.remove(image);
+    if IMAGES.remove(image).is_some() {
+        purge_decoded(image);
+    }
 }
 
 /// Get image width
@@ -148,92 +180,530 @@ pub extern "C" fn fz_image_is_mask(_ctx: Handle, image: Handle) -> i32 {
 }
 
 /// Get pixmap from image
+///
+/// With a `ctm`, the image is decoded at the smallest power-of-2 reduction
+/// still covering its drawn size. `w` and `h` receive the pixmap size.
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_get_pixmap_from_image(
     _ctx: Handle,
     image: Handle,
-    _subarea: *const super::geometry::fz_irect,
-    _ctm: *mut super::geometry::fz_matrix,
+    subarea: *const fz_irect,
+    ctm: *mut fz_matrix,
     w: *mut i32,
     h: *mut i32,
 ) -> Handle {
+    let _span = super::trace::span(c"image_decode");
     if let Some(img) = IMAGES.get(image) {
         if let Ok(guard) = img.lock() {
-            // Generate pixmap from image
-            let img_w = guard.width();
-            let img_h = guard.height();
+            let l2factor = match unsafe { ctm.as_ref() } {
+                Some(m) => {
+                    let drawn_w = (m.a.hypot(m.b).ceil() as i32).max(1);
+                    let drawn_h = (m.c.hypot(m.d).ceil() as i32).max(1);
+                    reduction_covering(&guard, drawn_w, drawn_h)
+                }
+                None => 0,
+            };
+            let subarea = unsafe { subarea.as_ref() }.copied();
+            let Some(pixmap) = decode_cached(image, &guard, subarea, l2factor) else {
+                return 0;
+            };
 
             // Set output dimensions
             if !w.is_null() {
                 unsafe {
-                    *w = img_w;
+                    *w = pixmap.w();
                 }
             }
             if !h.is_null() {
                 unsafe {
-                    *h = img_h;
+                    *h = pixmap.h();
                 }
             }
-
-            // Create pixmap using FFI Pixmap type
-            let cs_handle = match guard.colorspace() {
-                Some(cs) => colorspace_to_handle(cs),
-                None => 0,
-            };
-            // Use colorspace handle directly with Pixmap
-            let pixmap = super::pixmap::Pixmap::new(cs_handle, img_w, img_h, true);
             return PIXMAPS.insert(pixmap);
         }
     }
     0
 }
 
+/// Pixmap of JPEG `image` decoded at 1/2^`l2factor` size through the
+/// reduced IDCT, touching only the coefficients that size needs
+fn decode_jpeg_reduced(image: &Image, l2factor: i32) -> Option<Pixmap> {
+    if image.format() != ImageFormat::Jpeg {
+        return None;
+    }
+    let decoded = decode_dct_scaled(image.data(), l2factor.clamp(0, 3) as u32).ok()?;
+    samples_pixmap(
+        decoded.width,
+        decoded.height,
+        decoded.components,
+        &decoded.samples,
+    )
+}
+
+/// Pixmap of interleaved gray, RGB or CMYK `samples`
+fn samples_pixmap(width: u32, height: u32, components: u8, samples: &[u8]) -> Option<Pixmap> {
+    let cs = match components {
+        1 => super::colorspace::FZ_COLORSPACE_GRAY,
+        3 => super::colorspace::FZ_COLORSPACE_RGB,
+        4 => super::colorspace::FZ_COLORSPACE_CMYK,
+        _ => return None,
+    };
+    let mut pixmap = Pixmap::new(cs, width as i32, height as i32, false);
+    let out = pixmap.samples_mut();
+    if out.len() != samples.len() {
+        return None;
+    }
+    out.copy_from_slice(samples);
+    Some(pixmap)
+}
+
+/// Largest `l2factor` at which `image` still covers `w` x `h`: up to 3 for
+/// the reduced IDCT, or the resolution levels a JPEG 2000 decode can drop
+fn reduction_covering(image: &Image, w: i32, h: i32) -> i32 {
+    let most = match image.format() {
+        ImageFormat::Jpeg2000 => MAX_JPX_REDUCE,
+        _ => 3,
+    };
+    (0..=most)
+        .rev()
+        .find(|&k| image.width() >> k >= w && image.height() >> k >= h)
+        .unwrap_or(0)
+}
+
+/// Full pixmap of `image` at 1/2^`l2factor` size, or as close to it as the
+/// decoder gets, with the level it is at
+///
+/// JPEG images go through the reduced IDCT (up to 1/8, or just 1/8 for
+/// progressive files, from their DC scans); JPEG 2000 images drop
+/// resolution levels (up to 1/32). Anything else is decoded at full size.
+fn decode_level(image: &Image, l2factor: i32) -> Option<(Pixmap, i32)> {
+    match image.format() {
+        ImageFormat::Jpeg => {
+            if let Some(pixmap) = decode_jpeg_reduced(image, l2factor) {
+                return Some((pixmap, l2factor.clamp(0, 3)));
+            }
+            // Progressive files at other sizes, and what the reduced IDCT
+            // doesn't handle
+            let (w, h) = (image.width() as u32, image.height() as u32);
+            let full = decode_dct(image.data(), None).ok().and_then(|samples| {
+                let components = samples.len() / (w as usize * h as usize).max(1);
+                samples_pixmap(w, h, components as u8, &samples)
+            });
+            if let Some(pixmap) = full {
+                return Some((pixmap, 0));
+            }
+        }
+        ImageFormat::Jpeg2000 => {
+            // Codestreams with fewer levels take a smaller reduction
+            let reduced = (0..=l2factor.min(MAX_JPX_REDUCE)).rev().find_map(|r| {
+                let decoded = decode_jpx_reduced(image.data(), r as u32).ok()?;
+                let pixmap = samples_pixmap(
+                    decoded.width,
+                    decoded.height,
+                    decoded.components,
+                    &decoded.samples,
+                )?;
+                Some((pixmap, r))
+            });
+            if reduced.is_some() {
+                return reduced;
+            }
+        }
+        _ => {}
+    }
+    let whole = fz_irect {
+        x0: 0,
+        y0: 0,
+        x1: image.width(),
+        y1: image.height(),
+    };
+    if let Some(pixmap) = decode_region(image, 0, whole) {
+        return Some((pixmap, 0));
+    }
+    let cs_handle = match image.colorspace() {
+        Some(cs) => colorspace_to_handle(cs),
+        None => 0,
+    };
+    // Use colorspace handle directly with Pixmap
+    let pixmap = Pixmap::new(cs_handle, image.width(), image.height(), true);
+    Some((pixmap, 0))
+}
+
+/// Pixmap of `subarea` of `image` at 1/2^`l2factor` size, decoding only
+/// what covers it: the MCU rows of a JPEG and the rows of 8-bit Flate
+/// data, skipping everything after them
+///
+/// The subarea is rounded out to whole pixels of the reduced size like
+/// `reduce_level` crops, so both give the same pixels. Other formats give
+/// `None`.
+fn decode_region(image: &Image, l2factor: i32, subarea: fz_irect) -> Option<Pixmap> {
+    let step = 1 << l2factor;
+    let (w, h) = (image.width(), image.height());
+    let x0 = subarea.x0 >> l2factor << l2factor;
+    let y0 = subarea.y0 >> l2factor << l2factor;
+    let x1 = ((subarea.x1 + step - 1) >> l2factor << l2factor).min(w);
+    let y1 = ((subarea.y1 + step - 1) >> l2factor << l2factor).min(h);
+    match image.format() {
+        ImageFormat::Jpeg => {
+            // The reduced IDCT goes to 1/8, box filtering the rest
+            let jpeg_l2 = l2factor.min(3);
+            let region = [x0, y0, x1, y1].map(|v| v as u32);
+            let decoded = decode_dct_scaled_region(image.data(), jpeg_l2 as u32, region).ok()?;
+            let pixmap = samples_pixmap(
+                decoded.width,
+                decoded.height,
+                decoded.components,
+                &decoded.samples,
+            )?;
+            if jpeg_l2 == l2factor {
+                return Some(pixmap);
+            }
+            Some(reduce_level(&pixmap, jpeg_l2, l2factor, None))
+        }
+        ImageFormat::Flate if image.bpc() == 8 => {
+            let cs = colorspace_to_handle(image.colorspace()?);
+            let n = usize::from(image.n());
+            if cs == 0 || super::colorspace::fz_colorspace_n(0, cs) as usize != n {
+                return None;
+            }
+            let row_bytes = w as usize * n;
+            let mut rows =
+                decode_flate_rows(image.data(), None, row_bytes, y0 as usize..y1 as usize).ok()?;
+            // A truncated stream leaves the rest blank
+            rows.resize((y1 - y0) as usize * row_bytes, 0);
+            let (cw, ch) = ((x1 - x0) as usize, (y1 - y0) as usize);
+            let mut crop = Vec::with_capacity(cw * ch * n);
+            for row in rows.chunks_exact(row_bytes) {
+                crop.extend_from_slice(&row[x0 as usize * n..x1 as usize * n]);
+            }
+            let (samples, ow, oh) = subsample(&crop, cw, ch, n, step as usize);
+            let mut pixmap = Pixmap::new(cs, ow as i32, oh as i32, false);
+            pixmap.samples_mut().copy_from_slice(&samples);
+            Some(pixmap)
+        }
+        _ => None,
+    }
+}
+
+/// Pixels of `image` that drawing it with `ctm` puts inside device box
+/// `bbox`, grown by a pixel for filtering, or `None` if there are none
+///
+/// `ctm` maps the unit square onto the image, its first row at `y = 0`.
+pub fn image_subarea(image: &Image, ctm: fz_matrix, bbox: fz_irect) -> Option<fz_irect> {
+    if (ctm.a * ctm.d - ctm.b * ctm.c).abs() < 1e-6 {
+        return None;
+    }
+    let device = fz_rect {
+        x0: bbox.x0 as f32,
+        y0: bbox.y0 as f32,
+        x1: bbox.x1 as f32,
+        y1: bbox.y1 as f32,
+    };
+    let unit = fz_transform_rect(device, fz_invert_matrix(ctm));
+    let (w, h) = (image.width(), image.height());
+    let area = fz_irect {
+        x0: ((unit.x0 * w as f32).floor() as i32 - 1).max(0),
+        y0: ((unit.y0 * h as f32).floor() as i32 - 1).max(0),
+        x1: ((unit.x1 * w as f32).ceil() as i32 + 1).min(w),
+        y1: ((unit.y1 * h as f32).ceil() as i32 + 1).min(h),
+    };
+    (area.x0 < area.x1 && area.y0 < area.y1).then_some(area)
+}
+
+/// Get the part of an image a device box needs, such as one tile of a
+/// `fz_tile_renderer` (see `fz_tile_renderer_get_bounds`)
+///
+/// Pass the result as the subarea of `fz_decode_image` or
+/// `fz_get_pixmap_from_image` so that only the rows and MCUs under the
+/// tile are decoded.
+///
+/// # Returns
+/// 1 with the subarea in `*subarea`, 0 if the image is invalid or misses
+/// the box
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_image_subarea(
+    _ctx: Handle,
+    image: Handle,
+    ctm: fz_matrix,
+    bbox: fz_irect,
+    subarea: *mut fz_irect,
+) -> i32 {
+    let Some(area) = IMAGES
+        .get(image)
+        .and_then(|img| image_subarea(&*img.lock().ok()?, ctm, bbox))
+    else {
+        return 0;
+    };
+    if let Some(out) = unsafe { subarea.as_mut() } {
+        *out = area;
+    }
+    1
+}
+
+// ============================================================================
+// Decoded Image Cache
+// ============================================================================
+
+fn keep_decoded(pixmap: Handle) -> Handle {
+    PIXMAPS.keep(pixmap)
+}
+
+fn release_decoded(pixmap: Handle) {
+    PIXMAPS.release(pixmap);
+}
+
+fn decoded_key_prefix(image: Handle) -> Vec<u8> {
+    let mut key = b"fz_decoded_image:".to_vec();
+    key.extend_from_slice(&image.to_le_bytes());
+    key
+}
+
+/// Cache key of `image` at 1/2^`l2factor` size, cropped to `subarea`
+fn decoded_key(image: Handle, subarea: Option<fz_irect>, l2factor: i32) -> Vec<u8> {
+    let mut key = decoded_key_prefix(image);
+    key.push(l2factor as u8);
+    if let Some(r) = subarea {
+        for v in [r.x0, r.y0, r.x1, r.y1] {
+            key.extend_from_slice(&v.to_le_bytes());
+        }
+    }
+    key
+}
+
+/// Run `f` on the cached pixmap under `key`, if there is one
+fn with_cached<R>(key: &[u8], f: impl FnOnce(&Pixmap) -> R) -> Option<R> {
+    let cached = store_find_and_keep(key, keep_decoded);
+    if cached == 0 {
+        return None;
+    }
+    let result = PIXMAPS.get(cached).map(|pixmap| f(&pixmap.lock().unwrap()));
+    release_decoded(cached);
+    result
+}
+
+fn copy_pixmap(pixmap: &Pixmap) -> Pixmap {
+    let mut copy = Pixmap::new(
+        pixmap.colorspace(),
+        pixmap.w(),
+        pixmap.h(),
+        pixmap.has_alpha(),
+    );
+    copy.samples_mut().copy_from_slice(pixmap.samples());
+    copy
+}
+
+/// Keep a copy of `pixmap` in the store under `key` if it's small enough
+/// for the decoded-image budget; returns whether the store took it
+fn admit_decoded(key: &[u8], pixmap: &Pixmap) -> bool {
+    let size = pixmap.samples().len();
+    if size == 0
+        || size.saturating_mul(DECODED_ADMIT_SHARE) > store_type_budget(StoreType::DecodedImage)
+    {
+        return false;
+    }
+    let handle = PIXMAPS.insert(copy_pixmap(pixmap));
+    store_owned_item(StoreType::DecodedImage, handle, size, key, release_decoded) != 0
+}
+
+/// `level`, decoded at 1/2^`level_l2` size, reduced to 1/2^`l2factor` and
+/// cropped to `subarea` (in full-size pixels, rounded out)
+fn reduce_level(level: &Pixmap, level_l2: i32, l2factor: i32, subarea: Option<fz_irect>) -> Pixmap {
+    let shift = l2factor - level_l2;
+    let (w, h) = (level.w(), level.h());
+    let (x0, y0, x1, y1) = match subarea {
+        Some(r) => {
+            // Whole boxes of the target level, in level pixels
+            let round_out = |v: i32, up: bool| {
+                let v = if up {
+                    (v + (1 << l2factor) - 1) >> l2factor
+                } else {
+                    v >> l2factor
+                };
+                v << shift
+            };
+            (
+                round_out(r.x0, false).min(w),
+                round_out(r.y0, false).min(h),
+                round_out(r.x1, true).min(w),
+                round_out(r.y1, true).min(h),
+            )
+        }
+        None => (0, 0, w, h),
+    };
+    let n = level.n() as usize;
+    let stride = level.stride() as usize;
+    let (cw, ch) = ((x1 - x0) as usize, (y1 - y0) as usize);
+    let mut crop = Vec::with_capacity(cw * ch * n);
+    for y in y0 as usize..y1 as usize {
+        let row = y * stride + x0 as usize * n;
+        crop.extend_from_slice(&level.samples()[row..row + cw * n]);
+    }
+    let (samples, ow, oh) = subsample(&crop, cw, ch, n, 1 << shift);
+    let mut pixmap = Pixmap::new(level.colorspace(), ow as i32, oh as i32, level.has_alpha());
+    pixmap.samples_mut().copy_from_slice(&samples);
+    pixmap
+}
+
+/// Pixmap of image `handle` at 1/2^`l2factor` size, cropped to `subarea`
+/// (in full-size pixels), through the decoded-image cache
+///
+/// Decoded pixmaps are kept in the store as `StoreType::DecodedImage`
+/// items keyed by (image, subarea, l2factor), so `fz_store_set_type_limit`
+/// bounds them. A miss is served by box-filtering the largest level of the
+/// image still in the cache, if one is at least as big, and decodes the
+/// image only otherwise: just the subarea where the format allows.
+fn decode_cached(
+    handle: Handle,
+    image: &Image,
+    subarea: Option<fz_irect>,
+    l2factor: i32,
+) -> Option<Pixmap> {
+    let l2factor = l2factor.clamp(0, MAX_L2FACTOR);
+    let subarea = match subarea {
+        Some(r) => {
+            let r = fz_irect {
+                x0: r.x0.max(0),
+                y0: r.y0.max(0),
+                x1: r.x1.min(image.width()),
+                y1: r.y1.min(image.height()),
+            };
+            if r.x0 >= r.x1 || r.y0 >= r.y1 {
+                return None;
+            }
+            // The whole image is keyed like no subarea
+            let whole = r
+                == fz_irect {
+                    x0: 0,
+                    y0: 0,
+                    x1: image.width(),
+                    y1: image.height(),
+                };
+            (!whole).then_some(r)
+        }
+        None => None,
+    };
+    let key = decoded_key(handle, subarea, l2factor);
+    if let Some(pixmap) = with_cached(&key, copy_pixmap) {
+        return Some(pixmap);
+    }
+    let _sampled = alloc_sampler::scope(Subsystem::Decode);
+    // Refuse a decode too big for the memory limit before making it
+    let (w, h) = subarea.map_or((image.width(), image.height()), |r| {
+        (r.x1 - r.x0, r.y1 - r.y0)
+    });
+    let scale = |d: i32| ((d.max(0) as usize) >> l2factor).max(1);
+    if !memory_budget::admit(scale(w) * scale(h) * image.n() as usize) {
+        return None;
+    }
+
+    let largest = DECODED_LEVELS.lock().unwrap().get(&handle).copied();
+    let reduced = largest.filter(|&l| l <= l2factor).and_then(|level_l2| {
+        with_cached(&decoded_key(handle, None, level_l2), |level| {
+            reduce_level(level, level_l2, l2factor, subarea)
+        })
+    });
+    let reduced = reduced.or_else(|| {
+        let r = subarea?;
+        let started = Instant::now();
+        let pixmap = decode_region(image, l2factor, r)?;
+        count_decode(&pixmap, started);
+        Some(pixmap)
+    });
+    let pixmap = match reduced {
+        Some(pixmap) => pixmap,
+        None => {
+            let started = Instant::now();
+            let (level, level_l2) = decode_level(image, l2factor)?;
+            count_decode(&level, started);
+            if admit_decoded(&decoded_key(handle, None, level_l2), &level) {
+                DECODED_LEVELS.lock().unwrap().insert(handle, level_l2);
+            }
+            if level_l2 == l2factor && subarea.is_none() {
+                return Some(level);
+            }
+            reduce_level(&level, level_l2, l2factor, subarea)
+        }
+    };
+    admit_decoded(&key, &pixmap);
+    Some(pixmap)
+}
+
+/// Count a decode that began at `started` in the performance counters
+fn count_decode(pixmap: &Pixmap, started: Instant) {
+    counters::add(Counter::ImagesDecoded, 1);
+    counters::add(
+        Counter::ImagePixelsDecoded,
+        pixmap.w().max(0) as u64 * pixmap.h().max(0) as u64,
+    );
+    counters::add(Counter::ImageDecodeNs, started.elapsed().as_nanos() as u64);
+}
+
+/// Internal: discard the cached decodes of an image
+fn purge_decoded(image: Handle) -> usize {
+    DECODED_LEVELS.lock().unwrap().remove(&image);
+    store_discard_matching(StoreType::DecodedImage, &decoded_key_prefix(image))
+}
+
+/// Drop the cached decodes of an image
+///
+/// `fz_drop_image` does this automatically.
+///
+/// # Returns
+/// Number of pixmaps removed from the store
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_purge_decoded_image_cache(_ctx: Handle, image: Handle) -> i32 {
+    purge_decoded(image) as i32
+}
+
 /// Decode image to pixmap
+///
+/// JPEG images are decoded at 1/2^`l2factor` size (up to 1/8) and any
+/// further reduction is box-filtered, as is every reduction of other
+/// images. The result is cropped to `subarea` (in full-size pixels) if
+/// given. Decodes go through the decoded-image cache.
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_decode_image(
     _ctx: Handle,
     image: Handle,
-    _l2factor: i32,
-    _subarea: *const super::geometry::fz_irect,
+    l2factor: i32,
+    subarea: *const fz_irect,
 ) -> Handle {
     if let Some(img) = IMAGES.get(image) {
         if let Ok(guard) = img.lock() {
-            let img_w = guard.width();
-            let img_h = guard.height();
-
-            // Create pixmap from image data using FFI Pixmap type
-            let cs_handle = match guard.colorspace() {
-                Some(cs) => colorspace_to_handle(cs),
-                None => 0,
-            };
-            // Use colorspace handle directly with Pixmap
-            let pixmap = super::pixmap::Pixmap::new(cs_handle, img_w, img_h, true);
-            return PIXMAPS.insert(pixmap);
+            let subarea = unsafe { subarea.as_ref() }.copied();
+            if let Some(pixmap) = decode_cached(image, &guard, subarea, l2factor) {
+                return PIXMAPS.insert(pixmap);
+            }
         }
     }
     0
 }
 
 /// Decode a scaled version of the image
+///
+/// The image is decoded at the smallest power-of-2 reduction (up to 1/8)
+/// still at least `w` x `h`, or by `l2factor` if no size is given, so
+/// JPEG thumbnails decode only the coefficients they need. See
+/// `fz_decode_image`.
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_decode_image_scaled(
     _ctx: Handle,
     image: Handle,
     w: i32,
     h: i32,
-    _l2factor: i32,
-    _subarea: *const super::geometry::fz_irect,
+    l2factor: i32,
+    subarea: *const fz_irect,
 ) -> Handle {
     if let Some(img) = IMAGES.get(image) {
         if let Ok(guard) = img.lock() {
-            // Create scaled pixmap using FFI Pixmap type
-            let cs_handle = match guard.colorspace() {
-                Some(cs) => colorspace_to_handle(cs),
-                None => 0,
+            let l2factor = match (w, h) {
+                (w, h) if w > 0 && h > 0 => reduction_covering(&guard, w, h),
+                _ => l2factor,
             };
-            // Use colorspace handle directly with Pixmap
-            let pixmap = super::pixmap::Pixmap::new(cs_handle, w, h, true);
-            return PIXMAPS.insert(pixmap);
+            let subarea = unsafe { subarea.as_ref() }.copied();
+            if let Some(pixmap) = decode_cached(image, &guard, subarea, l2factor) {
+                return PIXMAPS.insert(pixmap);
+            }
         }
     }
     0
@@ -471,6 +941,236 @@ mod tests {
         fz_drop_image(0, image_handle);
     }
 
+    #[test]
+    fn test_decode_jpeg_at_reduced_scale() {
+        use crate::fitz::colorspace::Colorspace;
+        use crate::pdf::filter::dct_scaled::tests::TestJpeg;
+
+        let jpeg = TestJpeg::encode(64, 48, &[(1, 1)], 0, |_, bx, _| {
+            let mut coef = [0; 64];
+            coef[0] = bx as i32 * 50;
+            coef
+        });
+        let image = Image::from_compressed(
+            64,
+            48,
+            8,
+            Some(Colorspace::device_gray()),
+            ImageFormat::Jpeg,
+            jpeg,
+        )
+        .unwrap();
+        let image_handle = IMAGES.insert(image);
+
+        // 1/4 is the smallest decode still covering 16 x 10
+        let pixmap_handle = fz_decode_image_scaled(0, image_handle, 16, 10, 0, std::ptr::null());
+        let pixmap = PIXMAPS.get(pixmap_handle).unwrap();
+        let (w, h) = {
+            let pixmap = pixmap.lock().unwrap();
+            (pixmap.w(), pixmap.h())
+        };
+        assert_eq!((w, h), (16, 12));
+        PIXMAPS.remove(pixmap_handle);
+
+        let pixmap_handle = fz_decode_image(0, image_handle, 3, std::ptr::null());
+        let pixmap = PIXMAPS.get(pixmap_handle).unwrap();
+        let pixmap = pixmap.lock().unwrap();
+        assert_eq!((pixmap.w(), pixmap.h()), (8, 6));
+        assert_eq!(pixmap.samples()[..2], [128, 134]);
+        drop(pixmap);
+        PIXMAPS.remove(pixmap_handle);
+        fz_drop_image(0, image_handle);
+    }
+
+    #[test]
+    fn test_decoded_image_cache() {
+        use super::super::store::fz_store_set_type_limit;
+        use crate::fitz::colorspace::Colorspace;
+        use crate::pdf::filter::dct_scaled::tests::TestJpeg;
+
+        let jpeg = TestJpeg::encode(64, 48, &[(1, 1)], 0, |_, bx, by| {
+            let mut coef = [0; 64];
+            coef[0] = (bx as i32 - by as i32) * 40;
+            coef[1] = 60;
+            coef
+        });
+        let image = Image::from_compressed(
+            64,
+            48,
+            8,
+            Some(Colorspace::device_gray()),
+            ImageFormat::Jpeg,
+            jpeg,
+        )
+        .unwrap();
+        let image_handle = IMAGES.insert(image);
+        let samples = |pixmap_handle: Handle| {
+            let pixmap = PIXMAPS.get(pixmap_handle).unwrap();
+            let pixmap = pixmap.lock().unwrap();
+            let result = (pixmap.w(), pixmap.h(), pixmap.samples().to_vec());
+            drop(pixmap);
+            PIXMAPS.remove(pixmap_handle);
+            result
+        };
+
+        let (w, h, full) = samples(fz_decode_image(0, image_handle, 0, std::ptr::null()));
+        assert_eq!((w, h), (64, 48));
+        // Smaller levels are box-filtered from the full decode
+        let (w, h, quarter) = samples(fz_decode_image(0, image_handle, 2, std::ptr::null()));
+        assert_eq!((w, h), (16, 12));
+        assert_eq!(quarter, subsample(&full, 64, 48, 1, 4).0);
+        // A subarea is cropped out of its level in whole boxes
+        let area = fz_irect {
+            x0: 17,
+            y0: 8,
+            x1: 47,
+            y1: 40,
+        };
+        let (w, h, part) = samples(fz_decode_image(0, image_handle, 1, &area));
+        assert_eq!((w, h), (16, 16));
+        let (half, _, _) = subsample(&full, 64, 48, 1, 2);
+        assert_eq!(part[..16], half[4 * 32 + 8..4 * 32 + 24]);
+        let (_, _, again) = samples(fz_decode_image(0, image_handle, 1, &area));
+        assert_eq!(part, again);
+        assert_eq!(fz_purge_decoded_image_cache(0, image_handle), 3);
+
+        // Decodes too big for the budget are handed out uncached
+        fz_store_set_type_limit(0, StoreType::DecodedImage as i32, 4 * 64 * 48 - 1);
+        let (_, _, uncached) = samples(fz_decode_image(0, image_handle, 0, std::ptr::null()));
+        assert_eq!(uncached, full);
+        assert_eq!(fz_purge_decoded_image_cache(0, image_handle), 0);
+        fz_store_set_type_limit(0, StoreType::DecodedImage as i32, 0);
+        fz_drop_image(0, image_handle);
+    }
+
+    #[test]
+    fn test_subarea_decodes_only_its_part() {
+        use crate::fitz::colorspace::Colorspace;
+        use crate::pdf::filter::dct_scaled::tests::TestJpeg;
+        use crate::pdf::filter::encode_flate;
+
+        let jpeg = TestJpeg::encode(64, 64, &[(1, 1)], 8, |_, bx, by| {
+            let mut coef = [0; 64];
+            coef[0] = (bx as i32 * 3 - by as i32 * 2) * 30;
+            coef[9] = 40;
+            coef
+        });
+        let pixels: Vec<u8> = (0..40 * 30 * 3).map(|i| (i * 13 % 253) as u8).collect();
+        let flate = encode_flate(&pixels, 6).unwrap();
+        let images = [
+            (64, 64, Colorspace::device_gray(), ImageFormat::Jpeg, jpeg),
+            (40, 30, Colorspace::device_rgb(), ImageFormat::Flate, flate),
+        ];
+        let area = fz_irect {
+            x0: 5,
+            y0: 18,
+            x1: 27,
+            y1: 29,
+        };
+        for (w, h, cs, format, data) in images {
+            let image = Image::from_compressed(w, h, 8, Some(cs), format, data).unwrap();
+            for l2 in [0, 1, 2] {
+                let part = decode_region(&image, l2, area).unwrap();
+                let (level, level_l2) = decode_level(&image, l2).unwrap();
+                let expected = reduce_level(&level, level_l2, l2, Some(area));
+                assert_eq!((part.w(), part.h()), (expected.w(), expected.h()));
+                assert_eq!(part.samples(), expected.samples(), "{format:?} at {l2}");
+            }
+        }
+    }
+
+    #[test]
+    fn test_progressive_thumbnail_from_dc_scans() {
+        use crate::fitz::colorspace::Colorspace;
+        use crate::pdf::filter::dct_scaled::tests::TestJpeg;
+
+        let block = |_, bx: usize, by: usize| {
+            let mut coef = [0; 64];
+            coef[0] = (bx as i32 * 5 - by as i32 * 3) * 17;
+            coef
+        };
+        let baseline =
+            decode_dct_scaled(&TestJpeg::encode(64, 48, &[(1, 1)], 0, block), 3).unwrap();
+        let jpeg = TestJpeg::encode_progressive(64, 48, &[(1, 1)], block);
+        let image = Image::from_compressed(
+            64,
+            48,
+            8,
+            Some(Colorspace::device_gray()),
+            ImageFormat::Jpeg,
+            jpeg,
+        )
+        .unwrap();
+        let image_handle = IMAGES.insert(image);
+        let pixmap_handle = fz_decode_image_scaled(0, image_handle, 8, 5, 0, std::ptr::null());
+        let pixmap = PIXMAPS.get(pixmap_handle).unwrap();
+        let pixmap = pixmap.lock().unwrap();
+        assert_eq!((pixmap.w(), pixmap.h()), (8, 6));
+        assert_eq!(pixmap.samples(), baseline.samples);
+        drop(pixmap);
+        PIXMAPS.remove(pixmap_handle);
+        fz_drop_image(0, image_handle);
+    }
+
+    #[test]
+    fn test_jpx_thumbnail_from_resolution_levels() {
+        use crate::fitz::colorspace::Colorspace;
+        use crate::pdf::filter::jpx::tests::GRAY_8X4;
+
+        let image = Image::from_compressed(
+            8,
+            4,
+            8,
+            Some(Colorspace::device_gray()),
+            ImageFormat::Jpeg2000,
+            GRAY_8X4.to_vec(),
+        )
+        .unwrap();
+        let image_handle = IMAGES.insert(image);
+        let pixmap_handle = fz_decode_image_scaled(0, image_handle, 4, 2, 0, std::ptr::null());
+        let pixmap = PIXMAPS.get(pixmap_handle).unwrap();
+        let pixmap = pixmap.lock().unwrap();
+        // Without the codec the decode falls back to a blank image, which
+        // is still reduced to the size asked for
+        assert_eq!((pixmap.w(), pixmap.h()), (4, 2));
+        #[cfg(feature = "jpeg2000")]
+        assert_eq!(pixmap.samples(), [128; 8]);
+        drop(pixmap);
+        PIXMAPS.remove(pixmap_handle);
+        fz_drop_image(0, image_handle);
+    }
+
+    #[test]
+    fn test_image_subarea_of_tile() {
+        let image_handle = IMAGES.insert(Image::new(100, 50, None));
+        let ctm = fz_matrix {
+            a: 256.0,
+            b: 0.0,
+            c: 0.0,
+            d: 128.0,
+            e: 0.0,
+            f: 0.0,
+        };
+        let tile = fz_irect {
+            x0: 64,
+            y0: 32,
+            x1: 128,
+            y1: 64,
+        };
+        let mut area = fz_irect::default();
+        assert_eq!(fz_image_subarea(0, image_handle, ctm, tile, &mut area), 1);
+        // A quarter to half of the image each way, grown by a pixel
+        assert_eq!((area.x0, area.y0, area.x1, area.y1), (24, 11, 51, 26));
+        let away = fz_irect {
+            x0: 500,
+            y0: 500,
+            x1: 600,
+            y1: 600,
+        };
+        assert_eq!(fz_image_subarea(0, image_handle, ctm, away, &mut area), 0);
+        fz_drop_image(0, image_handle);
+    }
+
     #[test]
     fn test_decode_image() {
         let image = Image::new(20, 20, None);
@@ -0,0 +1,579 @@
+//! Baseline JPEG Encoder with Parallel Restart Strips
+//!
+//! Encodes gray and RGB pixmaps (alpha is dropped) as baseline JFIF with
+//! the Annex K Huffman tables, the IJG quality scaling and no chroma
+//! subsampling, so text keeps its colour edges.
+//!
+//! The image is cut into strips of whole MCU rows. A restart marker
+//! follows every strip but the last, and the restart interval is one
+//! strip's worth of MCUs, so each strip starts from zero DC predictions on
+//! a byte boundary and entropy codes with no state from the strip above.
+//! Strips are shared out to worker threads and their scan data is
+//! concatenated with the RSTn markers in between; a decoder sees one
+//! ordinary baseline file. A single-threaded encode is one strip with no
+//! restart markers.
+//!
+//! The forward DCT is two passes of eight-wide row arithmetic over fixed
+//! arrays, and quantization multiplies by reciprocals, so both compile to
+//! SSE or NEON vector code.
+
+use std::sync::Mutex;
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+use super::pixmap::Pixmap;
+use super::render_pool::FZ_RENDER_POOL_MAX_THREADS;
+
+/// Quality used when the caller passes 0
+pub const FZ_JPEG_DEFAULT_QUALITY: i32 = 90;
+
+/// MCUs each strip should at least hold before a file is split
+const MIN_STRIP_MCUS: usize = 1024;
+
+/// Strips per worker, so uneven strips still balance across threads
+const STRIPS_PER_THREAD: usize = 4;
+
+/// Natural (row-major) index of each zigzag position
+const ZIGZAG: [usize; 64] = [
+    0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5, 12, 19, 26, 33, 40, 48, 41, 34, 27, 20,
+    13, 6, 7, 14, 21, 28, 35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51, 58, 59,
+    52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+];
+
+/// Annex K luminance quantization table, natural order
+const LUMA_QUANT: [u16; 64] = [
+    16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55, 14, 13, 16, 24, 40, 57, 69, 56,
+    14, 17, 22, 29, 51, 87, 80, 62, 18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113,
+    92, 49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99,
+];
+
+/// Annex K chrominance quantization table, natural order
+const CHROMA_QUANT: [u16; 64] = [
+    17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99, 24, 26, 56, 99, 99, 99, 99, 99,
+    47, 66, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99,
+];
+
+const DC_LUMA_BITS: [u8; 16] = [0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0];
+const DC_CHROMA_BITS: [u8; 16] = [0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0];
+const DC_VALUES: [u8; 12] = [0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11];
+
+const AC_LUMA_BITS: [u8; 16] = [0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D];
+const AC_LUMA_VALUES: [u8; 162] = [
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07,
+    0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08, 0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0,
+    0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+    0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69,
+    0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7,
+    0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5,
+    0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+    0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA,
+];
+
+const AC_CHROMA_BITS: [u8; 16] = [0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77];
+const AC_CHROMA_VALUES: [u8; 162] = [
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71,
+    0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91, 0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0,
+    0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+    0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
+    0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+    0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5,
+    0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3,
+    0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+    0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8,
+    0xF9, 0xFA,
+];
+
+/// Encode a pixmap as baseline JPEG
+///
+/// `quality` is 1-100 (0 for `FZ_JPEG_DEFAULT_QUALITY`); `threads` of 0
+/// uses one per CPU. Returns an empty vector for pixmaps that are neither
+/// gray nor RGB.
+pub(crate) fn encode(pix: &Pixmap, quality: i32, threads: i32) -> Vec<u8> {
+    let _span = super::trace::span(c"encode");
+    let n = pix.n() as usize;
+    let colors = match (n, pix.has_alpha()) {
+        (1, false) | (2, true) => 1,
+        (3, false) | (4, true) => 3,
+        _ => return Vec::new(),
+    };
+    let (width, height) = (pix.w(), pix.h());
+    if width <= 0 || height <= 0 || width > 0xFFFF || height > 0xFFFF {
+        return Vec::new();
+    }
+    let (width, height) = (width as usize, height as usize);
+    let stride = pix.stride() as usize;
+    if stride < width * n || pix.samples().len() < (height - 1) * stride + width * n {
+        return Vec::new();
+    }
+    let quality = if quality > 0 {
+        quality.min(100)
+    } else {
+        FZ_JPEG_DEFAULT_QUALITY
+    };
+
+    let image = Image {
+        samples: pix.samples(),
+        stride,
+        n,
+        colors,
+        width,
+        height,
+        mcus_w: width.div_ceil(8),
+    };
+    let tables = Tables::new(quality);
+
+    let mcu_rows = height.div_ceil(8);
+    let threads = thread_count(threads);
+    let strips = strip_count(threads, image.mcus_w, mcu_rows);
+    let rows_per_strip = mcu_rows.div_ceil(strips);
+    let strips = mcu_rows.div_ceil(rows_per_strip);
+    let restart_interval = if strips > 1 {
+        image.mcus_w * rows_per_strip
+    } else {
+        0
+    };
+
+    let scan = if strips == 1 {
+        vec![encode_strip(&image, &tables, 0, mcu_rows)]
+    } else {
+        let slots: Mutex<Vec<Vec<u8>>> = Mutex::new(vec![Vec::new(); strips]);
+        let next = AtomicUsize::new(0);
+        std::thread::scope(|scope| {
+            for _ in 0..threads.min(strips) {
+                scope.spawn(|| {
+                    loop {
+                        let strip = next.fetch_add(1, Ordering::Relaxed);
+                        if strip >= strips {
+                            break;
+                        }
+                        let y0 = strip * rows_per_strip;
+                        let y1 = (y0 + rows_per_strip).min(mcu_rows);
+                        let data = encode_strip(&image, &tables, y0, y1);
+                        if let Ok(mut slots) = slots.lock() {
+                            slots[strip] = data;
+                        }
+                    }
+                });
+            }
+        });
+        slots.into_inner().unwrap_or_default()
+    };
+
+    let scan_bytes: usize = scan.iter().map(Vec::len).sum();
+    let mut out = Vec::with_capacity(scan_bytes + 2 * scan.len() + 700);
+    write_headers(&mut out, &image, &tables, restart_interval);
+    for (i, strip) in scan.iter().enumerate() {
+        if i > 0 {
+            out.extend_from_slice(&[0xFF, 0xD0 + ((i - 1) % 8) as u8]);
+        }
+        out.extend_from_slice(strip);
+    }
+    out.extend_from_slice(&[0xFF, 0xD9]);
+    out
+}
+
+fn thread_count(threads: i32) -> usize {
+    if threads > 0 {
+        threads.min(FZ_RENDER_POOL_MAX_THREADS) as usize
+    } else {
+        std::thread::available_parallelism()
+            .map(|n| n.get())
+            .unwrap_or(1)
+            .min(FZ_RENDER_POOL_MAX_THREADS as usize)
+    }
+}
+
+/// Number of restart strips for an image of `mcus_w` x `mcu_rows` MCUs
+fn strip_count(threads: usize, mcus_w: usize, mcu_rows: usize) -> usize {
+    if threads == 1 || mcus_w > 0xFFFF {
+        return 1;
+    }
+    // The restart interval (one strip of MCUs) must fit in 16 bits
+    let min_rows = MIN_STRIP_MCUS.div_ceil(mcus_w);
+    let max_rows = 0xFFFF / mcus_w;
+    let by_size = mcu_rows / min_rows.max(1);
+    let by_interval = mcu_rows.div_ceil(max_rows);
+    (threads * STRIPS_PER_THREAD)
+        .min(by_size)
+        .max(by_interval)
+        .clamp(1, mcu_rows)
+}
+
+/// Pixmap samples as seen by the encoder
+struct Image<'a> {
+    samples: &'a [u8],
+    stride: usize,
+    n: usize,
+    colors: usize,
+    width: usize,
+    height: usize,
+    mcus_w: usize,
+}
+
+/// Quantization and Huffman tables for one quality
+struct Tables {
+    /// Quantization tables in natural order, luma then chroma
+    quant: [[u16; 64]; 2],
+    /// Reciprocals of `quant`, in natural order
+    scale: [[f32; 64]; 2],
+    dc: [Huffman; 2],
+    ac: [Huffman; 2],
+}
+
+impl Tables {
+    fn new(quality: i32) -> Self {
+        let factor = if quality < 50 {
+            5000 / quality
+        } else {
+            200 - quality * 2
+        };
+        let scaled = |base: &[u16; 64]| {
+            (*base).map(|q| ((q as i32 * factor + 50) / 100).clamp(1, 255) as u16)
+        };
+        let quant = [scaled(&LUMA_QUANT), scaled(&CHROMA_QUANT)];
+        Self {
+            quant,
+            scale: quant.map(|q| q.map(|v| 1.0 / v as f32)),
+            dc: [
+                Huffman::new(&DC_LUMA_BITS, &DC_VALUES),
+                Huffman::new(&DC_CHROMA_BITS, &DC_VALUES),
+            ],
+            ac: [
+                Huffman::new(&AC_LUMA_BITS, &AC_LUMA_VALUES),
+                Huffman::new(&AC_CHROMA_BITS, &AC_CHROMA_VALUES),
+            ],
+        }
+    }
+}
+
+/// Canonical Huffman code for each symbol
+struct Huffman {
+    code: [u16; 256],
+    size: [u8; 256],
+}
+
+impl Huffman {
+    fn new(bits: &[u8; 16], values: &[u8]) -> Self {
+        let mut table = Self {
+            code: [0; 256],
+            size: [0; 256],
+        };
+        let mut code = 0u16;
+        let mut k = 0;
+        for (len, &count) in bits.iter().enumerate() {
+            for _ in 0..count {
+                table.code[values[k] as usize] = code;
+                table.size[values[k] as usize] = len as u8 + 1;
+                code += 1;
+                k += 1;
+            }
+            code <<= 1;
+        }
+        table
+    }
+}
+
+/// Entropy-coded bits with 0xFF byte stuffing
+struct BitWriter {
+    out: Vec<u8>,
+    acc: u64,
+    nbits: u32,
+}
+
+impl BitWriter {
+    fn put(&mut self, bits: u32, size: u32) {
+        self.acc = (self.acc << size) | (bits as u64 & ((1 << size) - 1));
+        self.nbits += size;
+        while self.nbits >= 8 {
+            self.nbits -= 8;
+            let byte = (self.acc >> self.nbits) as u8;
+            self.out.push(byte);
+            if byte == 0xFF {
+                self.out.push(0);
+            }
+        }
+    }
+
+    /// Pad the last byte with one bits, as a restart or EOI marker needs
+    fn finish(mut self) -> Vec<u8> {
+        let pad = (8 - self.nbits % 8) % 8;
+        self.put((1 << pad) - 1, pad);
+        self.out
+    }
+}
+
+/// Category and low bits of a DC difference or AC coefficient
+fn magnitude(value: i32) -> (u32, u32) {
+    let size = 32 - value.unsigned_abs().leading_zeros();
+    let bits = if value < 0 { value - 1 } else { value };
+    (size, bits as u32)
+}
+
+/// Entropy code MCU rows `y0..y1`, starting from zero DC predictions
+fn encode_strip(image: &Image<'_>, tables: &Tables, y0: usize, y1: usize) -> Vec<u8> {
+    let padded_w = image.mcus_w * 8;
+    let mut planes = vec![vec![0f32; padded_w * 8]; image.colors];
+    let mut writer = BitWriter {
+        out: Vec::with_capacity((y1 - y0) * padded_w * image.colors / 2),
+        acc: 0,
+        nbits: 0,
+    };
+    let mut preds = [0i32; 3];
+    let mut block = [[0f32; 8]; 8];
+
+    for mcu_y in y0..y1 {
+        load_rows(image, mcu_y * 8, &mut planes);
+        for mcu_x in 0..image.mcus_w {
+            for (c, plane) in planes.iter().enumerate() {
+                for (y, row) in block.iter_mut().enumerate() {
+                    let at = y * padded_w + mcu_x * 8;
+                    row.copy_from_slice(&plane[at..at + 8]);
+                }
+                let t = (c > 0) as usize;
+                let coef = quantize(&fdct(&block), &tables.scale[t]);
+                encode_block(
+                    &mut writer,
+                    &coef,
+                    &mut preds[c],
+                    &tables.dc[t],
+                    &tables.ac[t],
+                );
+            }
+        }
+    }
+    writer.finish()
+}
+
+/// Convert eight pixel rows from `y` on into level-shifted planes, padding
+/// past the right and bottom edges by repeating the last pixel
+fn load_rows(image: &Image<'_>, y: usize, planes: &mut [Vec<f32>]) {
+    let padded_w = image.mcus_w * 8;
+    for dy in 0..8 {
+        let sy = (y + dy).min(image.height - 1);
+        let row = &image.samples[sy * image.stride..sy * image.stride + image.width * image.n];
+        let at = dy * padded_w;
+        if image.colors == 1 {
+            let plane = &mut planes[0][at..at + padded_w];
+            for (x, out) in plane.iter_mut().enumerate() {
+                *out = row[x.min(image.width - 1) * image.n] as f32 - 128.0;
+            }
+        } else {
+            let (luma, chroma) = planes.split_at_mut(1);
+            let (cb, cr) = chroma.split_at_mut(1);
+            for x in 0..padded_w {
+                let p = x.min(image.width - 1) * image.n;
+                let (r, g, b) = (row[p] as f32, row[p + 1] as f32, row[p + 2] as f32);
+                luma[0][at + x] = 0.299 * r + 0.587 * g + 0.114 * b - 128.0;
+                cb[0][at + x] = -0.168_736 * r - 0.331_264 * g + 0.5 * b;
+                cr[0][at + x] = 0.5 * r - 0.418_688 * g - 0.081_312 * b;
+            }
+        }
+    }
+}
+
+/// DCT basis: `DCT[u][k]` = c(u)/2 cos((2k+1)u pi/16)
+fn dct_basis() -> &'static [[f32; 8]; 8] {
+    static BASIS: std::sync::LazyLock<[[f32; 8]; 8]> = std::sync::LazyLock::new(|| {
+        let mut basis = [[0f32; 8]; 8];
+        for (u, row) in basis.iter_mut().enumerate() {
+            let c = if u == 0 { 0.5 / 2f32.sqrt() } else { 0.5 };
+            for (k, v) in row.iter_mut().enumerate() {
+                *v = c * ((2 * k + 1) as f32 * u as f32 * std::f32::consts::PI / 16.0).cos();
+            }
+        }
+        basis
+    });
+    &BASIS
+}
+
+/// One 1-D DCT down the columns: `out[u]` = sum over k of DCT[u][k] * in[k],
+/// eight columns at a time
+fn dct_columns(input: &[[f32; 8]; 8]) -> [[f32; 8]; 8] {
+    let basis = dct_basis();
+    let mut out = [[0f32; 8]; 8];
+    for (u, row) in out.iter_mut().enumerate() {
+        for (k, src) in input.iter().enumerate() {
+            let w = basis[u][k];
+            for x in 0..8 {
+                row[x] += w * src[x];
+            }
+        }
+    }
+    out
+}
+
+fn transpose(m: &[[f32; 8]; 8]) -> [[f32; 8]; 8] {
+    let mut t = [[0f32; 8]; 8];
+    for (y, row) in m.iter().enumerate() {
+        for (x, &v) in row.iter().enumerate() {
+            t[x][y] = v;
+        }
+    }
+    t
+}
+
+/// 2-D forward DCT; the result is indexed [v][u] like the input's [y][x]
+fn fdct(block: &[[f32; 8]; 8]) -> [[f32; 8]; 8] {
+    transpose(&dct_columns(&transpose(&dct_columns(block))))
+}
+
+/// Quantize DCT coefficients, rounding half away from zero (natural order)
+fn quantize(coef: &[[f32; 8]; 8], scale: &[f32; 64]) -> [i32; 64] {
+    let mut out = [0i32; 64];
+    for (i, q) in out.iter_mut().enumerate() {
+        let v = coef[i / 8][i % 8] * scale[i];
+        *q = (v + 0.5f32.copysign(v)) as i32;
+    }
+    out
+}
+
+fn encode_block(
+    writer: &mut BitWriter,
+    coef: &[i32; 64],
+    pred: &mut i32,
+    dc: &Huffman,
+    ac: &Huffman,
+) {
+    let (size, bits) = magnitude(coef[0] - *pred);
+    *pred = coef[0];
+    writer.put(dc.code[size as usize] as u32, dc.size[size as usize] as u32);
+    writer.put(bits, size);
+
+    let mut run = 0;
+    for &natural in &ZIGZAG[1..] {
+        let value = coef[natural];
+        if value == 0 {
+            run += 1;
+            continue;
+        }
+        while run >= 16 {
+            writer.put(ac.code[0xF0] as u32, ac.size[0xF0] as u32);
+            run -= 16;
+        }
+        let (size, bits) = magnitude(value);
+        let symbol = (run << 4 | size) as usize;
+        writer.put(ac.code[symbol] as u32, ac.size[symbol] as u32);
+        writer.put(bits, size);
+        run = 0;
+    }
+    if run > 0 {
+        writer.put(ac.code[0] as u32, ac.size[0] as u32);
+    }
+}
+
+fn write_segment(out: &mut Vec<u8>, marker: u8, body: &[u8]) {
+    out.extend_from_slice(&[0xFF, marker]);
+    out.extend_from_slice(&((body.len() + 2) as u16).to_be_bytes());
+    out.extend_from_slice(body);
+}
+
+fn write_headers(out: &mut Vec<u8>, image: &Image<'_>, tables: &Tables, restart: usize) {
+    out.extend_from_slice(&[0xFF, 0xD8]);
+    write_segment(out, 0xE0, b"JFIF\0\x01\x01\0\0\x01\0\x01\0\0");
+
+    let used = if image.colors == 1 { 1 } else { 2 };
+    let mut dqt = Vec::with_capacity(65 * used);
+    for (t, quant) in tables.quant.iter().take(used).enumerate() {
+        dqt.push(t as u8);
+        dqt.extend(ZIGZAG.iter().map(|&natural| quant[natural] as u8));
+    }
+    write_segment(out, 0xDB, &dqt);
+
+    let mut sof = vec![8];
+    sof.extend_from_slice(&(image.height as u16).to_be_bytes());
+    sof.extend_from_slice(&(image.width as u16).to_be_bytes());
+    sof.push(image.colors as u8);
+    for c in 0..image.colors {
+        sof.extend_from_slice(&[c as u8 + 1, 0x11, (c > 0) as u8]);
+    }
+    write_segment(out, 0xC0, &sof);
+
+    let mut dht = Vec::new();
+    let specs: [(u8, &[u8; 16], &[u8]); 4] = [
+        (0x00, &DC_LUMA_BITS, &DC_VALUES),
+        (0x10, &AC_LUMA_BITS, &AC_LUMA_VALUES),
+        (0x01, &DC_CHROMA_BITS, &DC_VALUES),
+        (0x11, &AC_CHROMA_BITS, &AC_CHROMA_VALUES),
+    ];
+    for (class_id, bits, values) in specs.iter().take(2 * used) {
+        dht.push(*class_id);
+        dht.extend_from_slice(*bits);
+        dht.extend_from_slice(values);
+    }
+    write_segment(out, 0xC4, &dht);
+
+    if restart > 0 {
+        write_segment(out, 0xDD, &(restart as u16).to_be_bytes());
+    }
+
+    let mut sos = vec![image.colors as u8];
+    for c in 0..image.colors {
+        sos.extend_from_slice(&[c as u8 + 1, if c > 0 { 0x11 } else { 0x00 }]);
+    }
+    sos.extend_from_slice(&[0, 63, 0]);
+    write_segment(out, 0xDA, &sos);
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::colorspace::{ColorspaceHandle, FZ_COLORSPACE_GRAY, FZ_COLORSPACE_RGB};
+    use crate::pdf::filter::dct_scaled::decode_dct_scaled;
+
+    fn pattern(cs: ColorspaceHandle, w: i32, h: i32, alpha: bool) -> Pixmap {
+        let mut pix = Pixmap::new(cs, w, h, alpha);
+        let n = pix.n() as usize;
+        for (i, s) in pix.samples_mut().iter_mut().enumerate() {
+            let (x, y) = ((i / n) % w as usize, i / n / w as usize);
+            *s = (x * 2 + y * 3 + (i % n) * 40) as u8;
+        }
+        pix
+    }
+
+    fn max_error(a: &[u8], b: &[u8]) -> u8 {
+        a.iter().zip(b).map(|(x, y)| x.abs_diff(*y)).max().unwrap()
+    }
+
+    #[test]
+    fn test_round_trip_gray_and_rgb() {
+        for (cs, n) in [(FZ_COLORSPACE_GRAY, 1), (FZ_COLORSPACE_RGB, 3)] {
+            let pix = pattern(cs, 45, 29, false);
+            let jpeg = encode(&pix, 95, 1);
+            let decoded = decode_dct_scaled(&jpeg, 0).unwrap();
+            assert_eq!((decoded.width, decoded.height), (45, 29));
+            assert_eq!(decoded.components, n);
+            assert!(max_error(&decoded.samples, pix.samples()) < 12);
+        }
+    }
+
+    #[test]
+    fn test_alpha_is_dropped() {
+        let pix = pattern(FZ_COLORSPACE_RGB, 16, 16, true);
+        let decoded = decode_dct_scaled(&encode(&pix, 0, 1), 0).unwrap();
+        assert_eq!(decoded.components, 3);
+    }
+
+    #[test]
+    fn test_restart_strips_decode_like_one() {
+        // 125 x 75 MCUs: eight strips of ten MCU rows
+        let pix = pattern(FZ_COLORSPACE_RGB, 1000, 600, false);
+        let serial = encode(&pix, 80, 1);
+        let parallel = encode(&pix, 80, 4);
+        assert!(parallel.windows(2).any(|w| w == [0xFF, 0xDD]));
+        assert!(!serial.windows(2).any(|w| w == [0xFF, 0xDD]));
+
+        let a = decode_dct_scaled(&serial, 0).unwrap();
+        let b = decode_dct_scaled(&parallel, 0).unwrap();
+        assert_eq!(a.samples, b.samples);
+    }
+
+    #[test]
+    fn test_rejects_cmyk() {
+        let pix = Pixmap::new(crate::ffi::colorspace::FZ_COLORSPACE_CMYK, 8, 8, false);
+        assert!(encode(&pix, 75, 1).is_empty());
+    }
+}
@@ -1,10 +1,18 @@
 //! FFI bindings for fz_json (JSON Parsing and Output)
 //!
-//! Provides JSON DOM manipulation, parsing, and serialization.
+//! Provides JSON DOM manipulation, parsing, and serialization, plus a
+//! streaming writer and an event (SAX) reader for documents too large to
+//! hold as a tree.
 
+use crate::ffi::output::OUTPUTS;
+use crate::ffi::simd_util::{JsonBlockMasks, json_classify_blocks};
 use crate::ffi::{Handle, HandleStore};
+use crate::fitz::error::{Error, Result};
+use std::borrow::Cow;
 use std::collections::HashMap;
-use std::ffi::{CStr, CString, c_char};
+use std::ffi::{CStr, CString, c_char, c_void};
+use std::fmt::Write as _;
+use std::io::{self, Write};
 use std::ptr;
 use std::sync::LazyLock;
 
@@ -579,6 +587,573 @@ impl<'a> JsonParser<'a> {
     }
 }
 
+// ============================================================================
+// Streaming Writer
+// ============================================================================
+
+/// Container the writer or reader is inside
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum JsonFrame {
+    Object,
+    Array,
+}
+
+/// Buffered bytes are handed to the sink once past this size
+const JSON_WRITER_CHUNK: usize = 8 * 1024;
+
+/// Streaming JSON writer
+///
+/// Tokens are escaped straight into a small buffer that is flushed to `W`
+/// as it fills, so a document of any size is written without building a
+/// [`JsonValue`] tree. Commas and colons are placed automatically, and a
+/// token the grammar doesn't allow at that point is refused.
+pub struct JsonWriter<W: Write> {
+    out: W,
+    buf: String,
+    stack: Vec<JsonFrame>,
+    /// A value is already written at this level, so the next needs a comma
+    separate: bool,
+    /// A key is written and its value is due
+    has_key: bool,
+    /// The top-level value is complete
+    done: bool,
+}
+
+impl<W: Write> JsonWriter<W> {
+    pub fn new(out: W) -> Self {
+        JsonWriter {
+            out,
+            buf: String::with_capacity(JSON_WRITER_CHUNK),
+            stack: Vec::new(),
+            separate: false,
+            has_key: false,
+            done: false,
+        }
+    }
+
+    pub fn begin_object(&mut self) -> Result<()> {
+        self.begin(JsonFrame::Object, '{')
+    }
+
+    pub fn end_object(&mut self) -> Result<()> {
+        self.end(JsonFrame::Object, '}')
+    }
+
+    pub fn begin_array(&mut self) -> Result<()> {
+        self.begin(JsonFrame::Array, '[')
+    }
+
+    pub fn end_array(&mut self) -> Result<()> {
+        self.end(JsonFrame::Array, ']')
+    }
+
+    /// Write the key of the next object member
+    pub fn key(&mut self, key: &str) -> Result<()> {
+        if self.stack.last() != Some(&JsonFrame::Object) || self.has_key {
+            return Err(Error::argument("json key outside an object"));
+        }
+        if self.separate {
+            self.buf.push(',');
+        }
+        self.buf.push('"');
+        escape_json_string(key, &mut self.buf);
+        self.buf.push_str("\":");
+        self.has_key = true;
+        Ok(())
+    }
+
+    pub fn string(&mut self, value: &str) -> Result<()> {
+        self.value_start()?;
+        self.buf.push('"');
+        escape_json_string(value, &mut self.buf);
+        self.buf.push('"');
+        self.value_end()
+    }
+
+    /// Write a number; JSON has no NaN or infinity, so those become null
+    pub fn number(&mut self, value: f64) -> Result<()> {
+        self.value_start()?;
+        if value.is_finite() {
+            let _ = write!(self.buf, "{}", value);
+        } else {
+            self.buf.push_str("null");
+        }
+        self.value_end()
+    }
+
+    /// Write an `f32` at its own precision, for page coordinates
+    pub fn float(&mut self, value: f32) -> Result<()> {
+        self.value_start()?;
+        if value.is_finite() {
+            let _ = write!(self.buf, "{}", value);
+        } else {
+            self.buf.push_str("null");
+        }
+        self.value_end()
+    }
+
+    pub fn boolean(&mut self, value: bool) -> Result<()> {
+        self.value_start()?;
+        self.buf.push_str(if value { "true" } else { "false" });
+        self.value_end()
+    }
+
+    pub fn null(&mut self) -> Result<()> {
+        self.value_start()?;
+        self.buf.push_str("null");
+        self.value_end()
+    }
+
+    /// Whether a whole top-level value has been written
+    pub fn is_complete(&self) -> bool {
+        self.done
+    }
+
+    /// Hand everything buffered to the sink
+    pub fn flush(&mut self) -> Result<()> {
+        self.out.write_all(self.buf.as_bytes())?;
+        self.buf.clear();
+        self.out.flush()?;
+        Ok(())
+    }
+
+    /// Flush and return the sink; fails if the document is unfinished
+    pub fn finish(mut self) -> Result<W> {
+        self.flush()?;
+        if !self.done {
+            return Err(Error::argument("json document is incomplete"));
+        }
+        Ok(self.out)
+    }
+
+    fn begin(&mut self, frame: JsonFrame, open: char) -> Result<()> {
+        self.value_start()?;
+        self.buf.push(open);
+        self.stack.push(frame);
+        self.separate = false;
+        self.has_key = false;
+        Ok(())
+    }
+
+    fn end(&mut self, frame: JsonFrame, close: char) -> Result<()> {
+        if self.stack.last() != Some(&frame) || self.has_key {
+            return Err(Error::argument("unbalanced json container"));
+        }
+        self.stack.pop();
+        self.buf.push(close);
+        self.value_end()
+    }
+
+    fn value_start(&mut self) -> Result<()> {
+        match self.stack.last() {
+            None if self.done => Err(Error::argument("json document already complete")),
+            Some(JsonFrame::Object) if !self.has_key => {
+                Err(Error::argument("json object member needs a key"))
+            }
+            Some(JsonFrame::Array) if self.separate => {
+                self.buf.push(',');
+                Ok(())
+            }
+            _ => Ok(()),
+        }
+    }
+
+    fn value_end(&mut self) -> Result<()> {
+        self.has_key = false;
+        self.separate = true;
+        self.done = self.stack.is_empty();
+        if self.buf.len() >= JSON_WRITER_CHUNK {
+            self.out.write_all(self.buf.as_bytes())?;
+            self.buf.clear();
+        }
+        Ok(())
+    }
+}
+
+/// `io::Write` over an output handle
+pub struct OutputSink(pub Handle);
+
+impl Write for OutputSink {
+    fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+        let output = OUTPUTS
+            .get(self.0)
+            .ok_or_else(|| io::Error::new(io::ErrorKind::NotFound, "no such output"))?;
+        let mut output = output.lock().unwrap();
+        output.write_data(buf).map_err(io::Error::other)?;
+        Ok(buf.len())
+    }
+
+    fn flush(&mut self) -> io::Result<()> {
+        Ok(())
+    }
+}
+
+// ============================================================================
+// Structural Index
+// ============================================================================
+
+/// Blocks classified per call, 4 KiB of input
+const INDEX_BATCH: usize = 64;
+
+/// Offsets of the unescaped quotes, and of the operators outside strings
+///
+/// Stage one of a simdjson-style parse. Blocks of 64 bytes are classified
+/// by [`json_classify_blocks`]; escapes are resolved with a carry between
+/// blocks (an odd run of backslashes escapes the byte after it), and a
+/// prefix XOR of the real quotes marks what lies inside strings. Only the
+/// offsets survive, and the reader never rescans string contents.
+fn structural_index(input: &[u8]) -> Result<Vec<u32>> {
+    if input.len() > u32::MAX as usize {
+        return Err(Error::limit("json input over 4 GiB"));
+    }
+    let mut index = Vec::with_capacity(input.len() / 8);
+    let mut masks = [JsonBlockMasks::default(); INDEX_BATCH];
+    let mut escape_carry = 0u64;
+    let mut in_string = 0u64;
+
+    let full = input.len() / 64;
+    let mut block = 0;
+    while block < full {
+        let n = (full - block).min(INDEX_BATCH);
+        json_classify_blocks(&input[block * 64..(block + n) * 64], &mut masks[..n]);
+        for (i, m) in masks[..n].iter().enumerate() {
+            index_block(
+                m,
+                (block + i) * 64,
+                &mut escape_carry,
+                &mut in_string,
+                &mut index,
+            );
+        }
+        block += n;
+    }
+    // Space padding adds no bits
+    let tail = &input[full * 64..];
+    if !tail.is_empty() {
+        let mut padded = [b' '; 64];
+        padded[..tail.len()].copy_from_slice(tail);
+        json_classify_blocks(&padded, &mut masks[..1]);
+        index_block(
+            &masks[0],
+            full * 64,
+            &mut escape_carry,
+            &mut in_string,
+            &mut index,
+        );
+    }
+
+    if in_string != 0 {
+        return Err(Error::format("json: unterminated string"));
+    }
+    Ok(index)
+}
+
+fn index_block(
+    m: &JsonBlockMasks,
+    base: usize,
+    escape_carry: &mut u64,
+    in_string: &mut u64,
+    index: &mut Vec<u32>,
+) {
+    let quote = m.quote & !escaped_bytes(m.backslash, escape_carry);
+    // Set from an opening quote up to, not including, its closing quote
+    let inside = prefix_xor(quote) ^ *in_string;
+    *in_string = ((inside as i64) >> 63) as u64;
+    let mut bits = quote | (m.operator & !inside);
+    while bits != 0 {
+        index.push((base + bits.trailing_zeros() as usize) as u32);
+        bits &= bits - 1;
+    }
+}
+
+/// Bytes escaped by a backslash, carrying an escape into the next block
+///
+/// Runs of backslashes starting on even and odd bits are told apart with
+/// one add: the carry out of a run flips which of its bytes are escapes.
+fn escaped_bytes(backslash: u64, carry: &mut u64) -> u64 {
+    const EVEN: u64 = 0x5555_5555_5555_5555;
+    let backslash = backslash & !*carry;
+    let follows_escape = (backslash << 1) | *carry;
+    let odd_starts = backslash & !EVEN & !follows_escape;
+    let (even_starts, overflow) = odd_starts.overflowing_add(backslash);
+    *carry = u64::from(overflow);
+    (EVEN ^ (even_starts << 1)) & follows_escape
+}
+
+/// Bit i is the XOR of bits 0 to i
+fn prefix_xor(mut x: u64) -> u64 {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    x
+}
+
+// ============================================================================
+// Event Reader
+// ============================================================================
+
+/// Token reported by [`JsonReader`]
+#[derive(Debug, Clone, PartialEq)]
+pub enum JsonEvent<'a> {
+    BeginObject,
+    EndObject,
+    BeginArray,
+    EndArray,
+    Key(Cow<'a, str>),
+    String(Cow<'a, str>),
+    Number(f64),
+    Bool(bool),
+    Null,
+}
+
+/// What the grammar allows next
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum Expect {
+    Value,
+    /// After `[`: a value or `]`
+    FirstItem,
+    /// After `{`: a key or `}`
+    FirstKey,
+    Key,
+    Colon,
+    CommaOrClose,
+    /// The top-level value is complete
+    End,
+}
+
+/// Event (SAX) JSON reader
+///
+/// Pulls one [`JsonEvent`] at a time without building a tree. The input
+/// is indexed up front (see [`structural_index`]), so the reader steps
+/// from operator to operator: strings are sliced out between their
+/// quotes, and borrowed unless they hold escapes. Nesting is tracked on a
+/// heap stack, so deep input can't overflow the call stack. The first
+/// error ends the iteration.
+pub struct JsonReader<'a> {
+    input: &'a str,
+    index: Vec<u32>,
+    /// Next index entry
+    next: usize,
+    /// Byte after the last token
+    cursor: usize,
+    stack: Vec<JsonFrame>,
+    expect: Expect,
+    failed: bool,
+}
+
+impl<'a> JsonReader<'a> {
+    pub fn new(input: &'a str) -> Result<Self> {
+        Ok(JsonReader {
+            input,
+            index: structural_index(input.as_bytes())?,
+            next: 0,
+            cursor: 0,
+            stack: Vec::new(),
+            expect: Expect::Value,
+            failed: false,
+        })
+    }
+
+    /// Nesting depth of the last event
+    pub fn depth(&self) -> usize {
+        self.stack.len()
+    }
+
+    fn step(&mut self) -> Result<Option<JsonEvent<'a>>> {
+        loop {
+            match self.expect {
+                Expect::Value => return self.value().map(Some),
+                Expect::FirstItem if self.operator() == Some(b']') => {
+                    return self.close(JsonFrame::Array).map(Some);
+                }
+                Expect::FirstItem => return self.value().map(Some),
+                Expect::FirstKey if self.operator() == Some(b'}') => {
+                    return self.close(JsonFrame::Object).map(Some);
+                }
+                Expect::FirstKey | Expect::Key => return self.key().map(Some),
+                Expect::Colon => {
+                    if self.operator() != Some(b':') {
+                        return Err(self.error("expected ':'"));
+                    }
+                    self.take();
+                    self.expect = Expect::Value;
+                }
+                Expect::CommaOrClose => match self.operator() {
+                    Some(b',') => {
+                        self.take();
+                        self.expect = match self.stack.last() {
+                            Some(JsonFrame::Object) => Expect::Key,
+                            _ => Expect::Value,
+                        };
+                    }
+                    Some(b'}') => return self.close(JsonFrame::Object).map(Some),
+                    Some(b']') => return self.close(JsonFrame::Array).map(Some),
+                    _ => return Err(self.error("expected ',' or a closing bracket")),
+                },
+                Expect::End => {
+                    if self.next < self.index.len() || !is_json_blank(self.gap()) {
+                        return Err(self.error("trailing data after json value"));
+                    }
+                    return Ok(None);
+                }
+            }
+        }
+    }
+
+    fn value(&mut self) -> Result<JsonEvent<'a>> {
+        let gap = self.gap();
+        let token = gap.trim_matches(is_json_space);
+        if !token.is_empty() {
+            // A scalar runs up to the next operator
+            if token.contains(is_json_space) {
+                return Err(self.error("unexpected token"));
+            }
+            let event = scalar(token).ok_or_else(|| self.error("invalid json literal"))?;
+            self.cursor += gap.len();
+            self.after_value();
+            return Ok(event);
+        }
+        match self.operator() {
+            Some(b'{') => {
+                self.take();
+                self.stack.push(JsonFrame::Object);
+                self.expect = Expect::FirstKey;
+                Ok(JsonEvent::BeginObject)
+            }
+            Some(b'[') => {
+                self.take();
+                self.stack.push(JsonFrame::Array);
+                self.expect = Expect::FirstItem;
+                Ok(JsonEvent::BeginArray)
+            }
+            Some(b'"') => {
+                let s = self.string();
+                self.after_value();
+                Ok(JsonEvent::String(s))
+            }
+            _ => Err(self.error("expected a json value")),
+        }
+    }
+
+    fn key(&mut self) -> Result<JsonEvent<'a>> {
+        if self.operator() != Some(b'"') {
+            return Err(self.error("expected an object key"));
+        }
+        let key = self.string();
+        self.expect = Expect::Colon;
+        Ok(JsonEvent::Key(key))
+    }
+
+    /// The string opened by the quote at the next entry; the index pairs
+    /// every opening quote with its closing one
+    fn string(&mut self) -> Cow<'a, str> {
+        let open = self.index[self.next] as usize;
+        let close = self.index[self.next + 1] as usize;
+        self.next += 2;
+        self.cursor = close + 1;
+        let content = &self.input[open + 1..close];
+        if content.contains('\\') {
+            Cow::Owned(unescape_json_string(content))
+        } else {
+            Cow::Borrowed(content)
+        }
+    }
+
+    fn close(&mut self, frame: JsonFrame) -> Result<JsonEvent<'a>> {
+        if self.stack.last() != Some(&frame) {
+            return Err(self.error("mismatched bracket"));
+        }
+        self.take();
+        self.stack.pop();
+        self.after_value();
+        Ok(match frame {
+            JsonFrame::Object => JsonEvent::EndObject,
+            JsonFrame::Array => JsonEvent::EndArray,
+        })
+    }
+
+    fn after_value(&mut self) {
+        self.expect = if self.stack.is_empty() {
+            Expect::End
+        } else {
+            Expect::CommaOrClose
+        };
+    }
+
+    /// Text between the last token and the next indexed byte
+    fn gap(&self) -> &'a str {
+        let end = self
+            .index
+            .get(self.next)
+            .map_or(self.input.len(), |&p| p as usize);
+        &self.input[self.cursor..end]
+    }
+
+    /// The next indexed byte, if only whitespace comes before it
+    fn operator(&self) -> Option<u8> {
+        let &pos = self.index.get(self.next)?;
+        is_json_blank(self.gap()).then(|| self.input.as_bytes()[pos as usize])
+    }
+
+    fn take(&mut self) {
+        self.cursor = self.index[self.next] as usize + 1;
+        self.next += 1;
+    }
+
+    fn error(&self, what: &str) -> Error {
+        Error::format(format!("json: {} at byte {}", what, self.cursor))
+    }
+}
+
+impl<'a> Iterator for JsonReader<'a> {
+    type Item = Result<JsonEvent<'a>>;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        if self.failed {
+            return None;
+        }
+        match self.step() {
+            Ok(event) => event.map(Ok),
+            Err(e) => {
+                self.failed = true;
+                Some(Err(e))
+            }
+        }
+    }
+}
+
+fn is_json_space(c: char) -> bool {
+    matches!(c, ' ' | '\t' | '\n' | '\r')
+}
+
+fn is_json_blank(s: &str) -> bool {
+    s.bytes().all(|b| matches!(b, b' ' | b'\t' | b'\n' | b'\r'))
+}
+
+/// `true`, `false`, `null` or a number
+fn scalar(token: &str) -> Option<JsonEvent<'static>> {
+    match token {
+        "true" => Some(JsonEvent::Bool(true)),
+        "false" => Some(JsonEvent::Bool(false)),
+        "null" => Some(JsonEvent::Null),
+        _ => {
+            let bytes = token.as_bytes();
+            // f64's parser also takes "inf", "+1" and the like
+            let numeric = (bytes[0] == b'-' || bytes[0].is_ascii_digit())
+                && bytes
+                    .iter()
+                    .all(|b| matches!(b, b'0'..=b'9' | b'-' | b'+' | b'.' | b'e' | b'E'));
+            numeric
+                .then(|| token.parse().ok())
+                .flatten()
+                .map(JsonEvent::Number)
+        }
+    }
+}
+
 // Global JSON store
 pub static JSON_VALUES: LazyLock<HandleStore<JsonValue>> = LazyLock::new(HandleStore::new);
 
@@ -1102,6 +1677,205 @@ pub extern "C" fn fz_json_unescape_string(
     copy_len
 }
 
+// ============================================================================
+// FFI Functions - Streaming Writer
+// ============================================================================
+
+/// Global streaming writer store
+pub static JSON_WRITERS: LazyLock<HandleStore<JsonWriter<OutputSink>>> =
+    LazyLock::new(HandleStore::new);
+
+/// Create a streaming JSON writer on an output
+///
+/// Tokens go to `out` as they are written, with no tree held in memory.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_json_writer(_ctx: Handle, out: Handle) -> Handle {
+    if OUTPUTS.get(out).is_none() {
+        return 0;
+    }
+    JSON_WRITERS.insert(JsonWriter::new(OutputSink(out)))
+}
+
+/// Run `f` on a writer, returning 1 if it accepted the token
+fn with_json_writer(
+    writer: Handle,
+    f: impl FnOnce(&mut JsonWriter<OutputSink>) -> Result<()>,
+) -> i32 {
+    let Some(w) = JSON_WRITERS.get(writer) else {
+        return 0;
+    };
+    let mut guard = w.lock().unwrap();
+    i32::from(f(&mut guard).is_ok())
+}
+
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_json_writer_begin_object(_ctx: Handle, writer: Handle) -> i32 {
+    with_json_writer(writer, |w| w.begin_object())
+}
+
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_json_writer_end_object(_ctx: Handle, writer: Handle) -> i32 {
+    with_json_writer(writer, |w| w.end_object())
+}
+
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_json_writer_begin_array(_ctx: Handle, writer: Handle) -> i32 {
+    with_json_writer(writer, |w| w.begin_array())
+}
+
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_json_writer_end_array(_ctx: Handle, writer: Handle) -> i32 {
+    with_json_writer(writer, |w| w.end_array())
+}
+
+/// Write the key of the next object member
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_json_writer_key(_ctx: Handle, writer: Handle, key: *const c_char) -> i32 {
+    if key.is_null() {
+        return 0;
+    }
+    let key = unsafe { CStr::from_ptr(key) }.to_string_lossy();
+    with_json_writer(writer, |w| w.key(&key))
+}
+
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_json_writer_string(_ctx: Handle, writer: Handle, value: *const c_char) -> i32 {
+    if value.is_null() {
+        return with_json_writer(writer, |w| w.null());
+    }
+    let value = unsafe { CStr::from_ptr(value) }.to_string_lossy();
+    with_json_writer(writer, |w| w.string(&value))
+}
+
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_json_writer_number(_ctx: Handle, writer: Handle, value: f64) -> i32 {
+    with_json_writer(writer, |w| w.number(value))
+}
+
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_json_writer_boolean(_ctx: Handle, writer: Handle, value: i32) -> i32 {
+    with_json_writer(writer, |w| w.boolean(value != 0))
+}
+
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_json_writer_null(_ctx: Handle, writer: Handle) -> i32 {
+    with_json_writer(writer, |w| w.null())
+}
+
+/// Flush and drop a writer
+///
+/// Returns 1 if a complete document was written, 0 otherwise.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_close_json_writer(_ctx: Handle, writer: Handle) -> i32 {
+    let Some(w) = JSON_WRITERS.remove(writer) else {
+        return 0;
+    };
+    let mut guard = w.lock().unwrap();
+    let complete = guard.is_complete();
+    i32::from(guard.flush().is_ok() && complete)
+}
+
+/// Drop a writer without flushing what is buffered
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_drop_json_writer(_ctx: Handle, writer: Handle) {
+    JSON_WRITERS.remove(writer);
+}
+
+// ============================================================================
+// FFI Functions - Event Parsing
+// ============================================================================
+
+pub const FZ_JSON_EVENT_BEGIN_OBJECT: i32 = 0;
+pub const FZ_JSON_EVENT_END_OBJECT: i32 = 1;
+pub const FZ_JSON_EVENT_BEGIN_ARRAY: i32 = 2;
+pub const FZ_JSON_EVENT_END_ARRAY: i32 = 3;
+pub const FZ_JSON_EVENT_KEY: i32 = 4;
+pub const FZ_JSON_EVENT_STRING: i32 = 5;
+pub const FZ_JSON_EVENT_NUMBER: i32 = 6;
+pub const FZ_JSON_EVENT_BOOLEAN: i32 = 7;
+pub const FZ_JSON_EVENT_NULL: i32 = 8;
+
+/// Receives one JSON event
+///
+/// For `FZ_JSON_EVENT_KEY` and `FZ_JSON_EVENT_STRING`, `text` holds `len`
+/// bytes of UTF-8 (not NUL-terminated, valid only during the call). Numbers
+/// arrive in `number`, booleans as 1 or 0 in `number`. Return 0 to
+/// continue, anything else to stop.
+pub type FzJsonEventCallback = Option<
+    unsafe extern "C" fn(
+        opaque: *mut c_void,
+        event: i32,
+        text: *const c_char,
+        len: usize,
+        number: f64,
+    ) -> i32,
+>;
+
+/// Parse `len` bytes of JSON, reporting each token to `callback`
+///
+/// No tree is built, so inputs of any size parse in memory proportional
+/// to their structure count. Returns 1 once the whole document is
+/// reported, 0 if the callback stopped early, and -1 if the input is not
+/// valid JSON (events before the error have been delivered).
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_parse_json_events(
+    _ctx: Handle,
+    input: *const c_char,
+    len: usize,
+    callback: FzJsonEventCallback,
+    opaque: *mut c_void,
+) -> i32 {
+    let Some(callback) = callback else {
+        return -1;
+    };
+    if input.is_null() && len > 0 {
+        return -1;
+    }
+    let bytes = if len == 0 {
+        &[][..]
+    } else {
+        // SAFETY: caller guarantees input points to len readable bytes
+        unsafe { std::slice::from_raw_parts(input as *const u8, len) }
+    };
+    let Ok(text) = std::str::from_utf8(bytes) else {
+        return -1;
+    };
+    let Ok(reader) = JsonReader::new(text) else {
+        return -1;
+    };
+
+    for event in reader {
+        let Ok(event) = event else {
+            return -1;
+        };
+        let (code, text, number) = match &event {
+            JsonEvent::BeginObject => (FZ_JSON_EVENT_BEGIN_OBJECT, "", 0.0),
+            JsonEvent::EndObject => (FZ_JSON_EVENT_END_OBJECT, "", 0.0),
+            JsonEvent::BeginArray => (FZ_JSON_EVENT_BEGIN_ARRAY, "", 0.0),
+            JsonEvent::EndArray => (FZ_JSON_EVENT_END_ARRAY, "", 0.0),
+            JsonEvent::Key(k) => (FZ_JSON_EVENT_KEY, &**k, 0.0),
+            JsonEvent::String(s) => (FZ_JSON_EVENT_STRING, &**s, 0.0),
+            JsonEvent::Number(n) => (FZ_JSON_EVENT_NUMBER, "", *n),
+            JsonEvent::Bool(b) => (FZ_JSON_EVENT_BOOLEAN, "", f64::from(u8::from(*b))),
+            JsonEvent::Null => (FZ_JSON_EVENT_NULL, "", 0.0),
+        };
+        // SAFETY: caller guarantees callback is a valid function pointer
+        let stop = unsafe {
+            callback(
+                opaque,
+                code,
+                text.as_ptr() as *const c_char,
+                text.len(),
+                number,
+            )
+        };
+        if stop != 0 {
+            return 0;
+        }
+    }
+    1
+}
+
 // ============================================================================
 // Tests
 // ============================================================================
@@ -1364,4 +2138,265 @@ mod tests {
 
         fz_drop_json(ctx, json);
     }
+    /// Rebuild compact JSON from reader events
+    fn reserialize(input: &str) -> Result<String> {
+        let mut w = JsonWriter::new(Vec::new());
+        for event in JsonReader::new(input)? {
+            match event? {
+                JsonEvent::BeginObject => w.begin_object()?,
+                JsonEvent::EndObject => w.end_object()?,
+                JsonEvent::BeginArray => w.begin_array()?,
+                JsonEvent::EndArray => w.end_array()?,
+                JsonEvent::Key(k) => w.key(&k)?,
+                JsonEvent::String(s) => w.string(&s)?,
+                JsonEvent::Number(n) => w.number(n)?,
+                JsonEvent::Bool(b) => w.boolean(b)?,
+                JsonEvent::Null => w.null()?,
+            }
+        }
+        Ok(String::from_utf8(w.finish()?).unwrap())
+    }
+
+    #[test]
+    fn test_json_writer_streams_tokens() {
+        let mut w = JsonWriter::new(Vec::new());
+        w.begin_object().unwrap();
+        w.key("a").unwrap();
+        w.begin_array().unwrap();
+        w.number(1.5).unwrap();
+        w.boolean(true).unwrap();
+        w.null().unwrap();
+        w.string("x\"y\n").unwrap();
+        w.number(f64::NAN).unwrap();
+        w.float(0.1).unwrap();
+        w.end_array().unwrap();
+        w.key("b").unwrap();
+        w.begin_object().unwrap();
+        w.end_object().unwrap();
+        assert!(!w.is_complete());
+        w.end_object().unwrap();
+        assert!(w.is_complete());
+        let out = w.finish().unwrap();
+        assert_eq!(
+            std::str::from_utf8(&out).unwrap(),
+            r#"{"a":[1.5,true,null,"x\"y\n",null,0.1],"b":{}}"#
+        );
+
+        // Tokens the grammar doesn't allow are refused
+        let mut w = JsonWriter::new(Vec::new());
+        assert!(w.key("k").is_err());
+        w.begin_object().unwrap();
+        assert!(w.number(1.0).is_err());
+        assert!(w.end_array().is_err());
+        w.key("k").unwrap();
+        assert!(w.key("k2").is_err());
+        assert!(w.end_object().is_err());
+        w.number(2.0).unwrap();
+        w.end_object().unwrap();
+        assert!(w.null().is_err());
+        assert!(JsonWriter::new(Vec::new()).finish().is_err());
+    }
+
+    #[test]
+    fn test_json_writer_flushes_large_documents() {
+        let mut w = JsonWriter::new(Vec::new());
+        w.begin_array().unwrap();
+        for i in 0..5000 {
+            w.string(&format!("item {i}")).unwrap();
+        }
+        // Most of the output has reached the sink before the end
+        assert!(w.out.len() > 5000 * 8 - JSON_WRITER_CHUNK);
+        w.end_array().unwrap();
+        let out = String::from_utf8(w.finish().unwrap()).unwrap();
+        assert!(out.starts_with(r#"["item 0","item 1","#));
+        assert!(out.ends_with(r#""item 4999"]"#));
+    }
+
+    #[test]
+    fn test_json_reader_events() {
+        let input = r#" {"name": "café", "n": [1, -2.5e3, 0], "ok": true, "none": null, "e": {}, "a": []} "#;
+        let events: Vec<_> = JsonReader::new(input)
+            .unwrap()
+            .collect::<Result<_>>()
+            .unwrap();
+        use JsonEvent::*;
+        assert_eq!(
+            events,
+            vec![
+                BeginObject,
+                Key("name".into()),
+                String("café".into()),
+                Key("n".into()),
+                BeginArray,
+                Number(1.0),
+                Number(-2500.0),
+                Number(0.0),
+                EndArray,
+                Key("ok".into()),
+                Bool(true),
+                Key("none".into()),
+                Null,
+                Key("e".into()),
+                BeginObject,
+                EndObject,
+                Key("a".into()),
+                BeginArray,
+                EndArray,
+                EndObject,
+            ]
+        );
+        // Strings without escapes are borrowed from the input
+        let mut reader = JsonReader::new(r#"["plain"]"#).unwrap();
+        reader.next();
+        assert!(matches!(
+            reader.next(),
+            Some(Ok(JsonEvent::String(Cow::Borrowed("plain"))))
+        ));
+        assert_eq!(reader.depth(), 1);
+        assert_eq!(reserialize("42").unwrap(), "42");
+    }
+
+    #[test]
+    fn test_json_reader_escapes_across_blocks() {
+        // Backslash runs of every length, shifted over the 64-byte block
+        // boundaries, must agree with the DOM parser
+        for pad in 0..70 {
+            for run in 0..6 {
+                let escapes = "\\\\".repeat(run / 2) + if run % 2 == 1 { "\\\"" } else { "" };
+                let input = format!(
+                    r#"{{"{}":"a{}b","k":["{{[,:]}}", "{}"]}}"#,
+                    "p".repeat(pad),
+                    escapes,
+                    escapes
+                );
+                let dom = JsonParser::new(&input).parse().unwrap().to_json_string();
+                assert_eq!(reserialize(&input).unwrap(), dom, "{input}");
+            }
+        }
+    }
+
+    #[test]
+    fn test_json_reader_rejects_invalid() {
+        for input in [
+            "",
+            "   ",
+            "{",
+            "[1,]",
+            "[1 2]",
+            r#"{"a" 1}"#,
+            r#"{"a":1,}"#,
+            r#"{1:2}"#,
+            "[1}",
+            "{]",
+            "[1]]",
+            "[1] x",
+            r#"["open]"#,
+            "[tru]",
+            "[+1]",
+            "[inf]",
+            "nul l",
+        ] {
+            let result: Result<Vec<_>> = JsonReader::new(input).and_then(|r| r.collect());
+            assert!(result.is_err(), "{input:?}");
+        }
+    }
+
+    unsafe extern "C" fn collect_events(
+        opaque: *mut c_void,
+        event: i32,
+        text: *const c_char,
+        len: usize,
+        number: f64,
+    ) -> i32 {
+        let seen = unsafe { &mut *(opaque as *mut Vec<(i32, String, f64)>) };
+        let bytes = unsafe { std::slice::from_raw_parts(text as *const u8, len) };
+        seen.push((
+            event,
+            std::str::from_utf8(bytes).unwrap().to_string(),
+            number,
+        ));
+        i32::from(seen.len() == 100)
+    }
+
+    #[test]
+    fn test_parse_json_events_ffi() {
+        let input = r#"{"k":["v",3,false]}"#;
+        let mut seen: Vec<(i32, String, f64)> = Vec::new();
+        let opaque = &mut seen as *mut _ as *mut c_void;
+        let rc = fz_parse_json_events(
+            0,
+            input.as_ptr() as *const c_char,
+            input.len(),
+            Some(collect_events),
+            opaque,
+        );
+        assert_eq!(rc, 1);
+        let codes: Vec<i32> = seen.iter().map(|e| e.0).collect();
+        assert_eq!(
+            codes,
+            [
+                FZ_JSON_EVENT_BEGIN_OBJECT,
+                FZ_JSON_EVENT_KEY,
+                FZ_JSON_EVENT_BEGIN_ARRAY,
+                FZ_JSON_EVENT_STRING,
+                FZ_JSON_EVENT_NUMBER,
+                FZ_JSON_EVENT_BOOLEAN,
+                FZ_JSON_EVENT_END_ARRAY,
+                FZ_JSON_EVENT_END_OBJECT,
+            ]
+        );
+        assert_eq!(seen[1].1, "k");
+        assert_eq!(seen[3].1, "v");
+        assert_eq!(seen[4].2, 3.0);
+
+        // The callback stops the parse; bad input reports -1
+        let long = format!("[{}0]", "0,".repeat(200));
+        seen.clear();
+        let opaque = &mut seen as *mut _ as *mut c_void;
+        let rc = fz_parse_json_events(
+            0,
+            long.as_ptr() as *const c_char,
+            long.len(),
+            Some(collect_events),
+            opaque,
+        );
+        assert_eq!(rc, 0);
+        assert_eq!(seen.len(), 100);
+        let bad = "[1,";
+        let rc = fz_parse_json_events(
+            0,
+            bad.as_ptr() as *const c_char,
+            bad.len(),
+            Some(collect_events),
+            opaque,
+        );
+        assert_eq!(rc, -1);
+    }
+
+    #[test]
+    fn test_json_writer_ffi() {
+        use crate::ffi::output::{fz_drop_output, fz_new_output_with_path};
+
+        let path = std::env::temp_dir().join("micropdf_json_writer_test.json");
+        let c_path = CString::new(path.to_str().unwrap()).unwrap();
+        let out = fz_new_output_with_path(0, c_path.as_ptr(), 0);
+        assert!(out > 0);
+        let w = fz_new_json_writer(0, out);
+        assert!(w > 0);
+        assert_eq!(fz_json_writer_begin_object(0, w), 1);
+        assert_eq!(fz_json_writer_key(0, w, c"pages".as_ptr()), 1);
+        assert_eq!(fz_json_writer_number(0, w, 3.0), 1);
+        assert_eq!(fz_json_writer_number(0, w, 4.0), 0);
+        assert_eq!(fz_json_writer_key(0, w, c"title".as_ptr()), 1);
+        assert_eq!(fz_json_writer_string(0, w, c"a \"b\"".as_ptr()), 1);
+        assert_eq!(fz_json_writer_end_object(0, w), 1);
+        assert_eq!(fz_close_json_writer(0, w), 1);
+        assert_eq!(fz_close_json_writer(0, w), 0);
+        fz_drop_output(0, out);
+
+        let written = std::fs::read_to_string(&path).unwrap();
+        let _ = std::fs::remove_file(&path);
+        assert_eq!(written, r#"{"pages":3,"title":"a \"b\""}"#);
+        assert_eq!(fz_new_json_writer(0, 0), 0);
+    }
 }
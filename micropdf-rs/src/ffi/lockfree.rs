@@ -2,14 +2,14 @@
 //!
 //! Provides low-contention alternatives to mutex-protected data structures:
 //! - `LockFreeHandleStore`: RwLock-based store optimized for read-heavy workloads
-//! - `LockFreeQueue`: Lock-free MPMC queue for parallel task processing
+//! - `LockFreeQueue`: Bounded lock-free MPMC queue with blocking waits
 //! - `ShardedMap`: Sharded concurrent HashMap to reduce contention
 //!
 //! These structures reduce `futex::Mutex::lock_contended` overhead shown in profiles.
 
 use std::collections::HashMap;
-use std::sync::atomic::{AtomicU64, AtomicUsize, Ordering};
-use std::sync::{Arc, RwLock};
+use std::sync::atomic::{AtomicBool, AtomicU64, AtomicUsize, Ordering};
+use std::sync::{Arc, Condvar, Mutex, RwLock};
 
 use super::Handle;
 
@@ -155,13 +155,51 @@ impl<T> Default for LockFreeHandleStore<T> {
 // Lock-Free MPMC Queue
 // ============================================================================
 
-/// Lock-free multi-producer multi-consumer queue
+/// One ring buffer cell
 ///
-/// Uses a simple array-based ring buffer with atomic head/tail pointers.
-/// Suitable for work-stealing and parallel task processing.
+/// `seq` tells producers and consumers whose turn the cell is: it equals
+/// the enqueue position when the cell is free for that lap, position + 1
+/// once it holds a value, and position + capacity after it was consumed.
+struct Slot<T> {
+    seq: AtomicUsize,
+    value: std::cell::UnsafeCell<std::mem::MaybeUninit<T>>,
+}
+
+/// Sleep/wake point for threads blocked on a full or empty queue
+///
+/// `waiters` lets the fast path skip the mutex entirely when nobody sleeps.
+#[derive(Default)]
+struct Parker {
+    waiters: AtomicUsize,
+    lock: Mutex<()>,
+    cond: Condvar,
+}
+
+impl Parker {
+    fn notify(&self) {
+        if self.waiters.load(Ordering::SeqCst) > 0 {
+            let _guard = self.lock.lock().unwrap();
+            self.cond.notify_all();
+        }
+    }
+}
+
+/// Spins before a blocked thread parks
+const QUEUE_SPIN_LIMIT: u32 = 64;
+
+/// Yields after spinning and before parking
+const QUEUE_YIELD_LIMIT: u32 = 8;
+
+/// Bounded lock-free multi-producer multi-consumer queue
+///
+/// An array ring buffer with per-slot sequence numbers (Vyukov's bounded
+/// MPMC queue): a producer or consumer claims a position with a single CAS
+/// and publishes through the slot's sequence, so a value is never read
+/// before it is written. Blocking waits spin, then yield, then park on a
+/// condition variable that the other side only touches when someone waits.
 pub struct LockFreeQueue<T> {
     /// Ring buffer storage
-    buffer: Vec<std::cell::UnsafeCell<Option<T>>>,
+    buffer: Box<[Slot<T>]>,
     /// Capacity (power of 2)
     capacity: usize,
     /// Mask for fast modulo
@@ -170,20 +208,28 @@ pub struct LockFreeQueue<T> {
     head: AtomicUsize,
     /// Tail pointer (enqueue position)
     tail: AtomicUsize,
-    /// Number of items
-    count: AtomicUsize,
+    /// Set by close(); waits return instead of parking
+    closed: AtomicBool,
+    /// Consumers waiting for a value
+    not_empty: Parker,
+    /// Producers waiting for room
+    not_full: Parker,
 }
 
-// SAFETY: Queue is thread-safe via atomic operations
+// SAFETY: Queue is thread-safe via atomic operations; each value is owned
+// by exactly one slot and moved in or out by the thread that claimed it.
 unsafe impl<T: Send> Send for LockFreeQueue<T> {}
 unsafe impl<T: Send> Sync for LockFreeQueue<T> {}
 
 impl<T> LockFreeQueue<T> {
-    /// Create a new queue with given capacity (rounded to power of 2)
+    /// Create a new queue with given capacity (rounded to power of 2, min 2)
     pub fn new(capacity: usize) -> Self {
-        let capacity = capacity.next_power_of_two();
+        let capacity = capacity.max(2).next_power_of_two();
         let buffer = (0..capacity)
-            .map(|_| std::cell::UnsafeCell::new(None))
+            .map(|i| Slot {
+                seq: AtomicUsize::new(i),
+                value: std::cell::UnsafeCell::new(std::mem::MaybeUninit::uninit()),
+            })
             .collect();
 
         Self {
@@ -192,88 +238,210 @@ impl<T> LockFreeQueue<T> {
             mask: capacity - 1,
             head: AtomicUsize::new(0),
             tail: AtomicUsize::new(0),
-            count: AtomicUsize::new(0),
+            closed: AtomicBool::new(false),
+            not_empty: Parker::default(),
+            not_full: Parker::default(),
         }
     }
 
     /// Try to enqueue an item
     pub fn push(&self, value: T) -> Result<(), T> {
+        let mut pos = self.tail.load(Ordering::Relaxed);
         loop {
-            let tail = self.tail.load(Ordering::Relaxed);
-            let head = self.head.load(Ordering::Acquire);
-
-            // Check if full
-            if tail.wrapping_sub(head) >= self.capacity {
-                return Err(value);
-            }
-
-            // Try to claim this slot
-            if self
-                .tail
-                .compare_exchange_weak(
-                    tail,
-                    tail.wrapping_add(1),
-                    Ordering::Release,
+            let slot = &self.buffer[pos & self.mask];
+            let seq = slot.seq.load(Ordering::Acquire);
+            let diff = seq.wrapping_sub(pos) as isize;
+
+            if diff == 0 {
+                match self.tail.compare_exchange_weak(
+                    pos,
+                    pos.wrapping_add(1),
+                    Ordering::Relaxed,
                     Ordering::Relaxed,
-                )
-                .is_ok()
-            {
-                let slot = &self.buffer[tail & self.mask];
-                // SAFETY: We have exclusive access to this slot after CAS success
-                unsafe {
-                    *slot.get() = Some(value);
+                ) {
+                    Ok(_) => {
+                        // SAFETY: The CAS gave this thread the slot for this lap
+                        unsafe { (*slot.value.get()).write(value) };
+                        slot.seq.store(pos.wrapping_add(1), Ordering::Release);
+                        std::sync::atomic::fence(Ordering::SeqCst);
+                        self.not_empty.notify();
+                        return Ok(());
+                    }
+                    Err(current) => pos = current,
                 }
-                self.count.fetch_add(1, Ordering::Release);
-                return Ok(());
+            } else if diff < 0 {
+                // The slot still holds last lap's value: queue is full
+                return Err(value);
+            } else {
+                pos = self.tail.load(Ordering::Relaxed);
             }
-            // CAS failed, retry
-            std::hint::spin_loop();
         }
     }
 
     /// Try to dequeue an item
     pub fn pop(&self) -> Option<T> {
+        let mut pos = self.head.load(Ordering::Relaxed);
         loop {
-            let head = self.head.load(Ordering::Relaxed);
-            let tail = self.tail.load(Ordering::Acquire);
-
-            // Check if empty
-            if head == tail {
+            let slot = &self.buffer[pos & self.mask];
+            let seq = slot.seq.load(Ordering::Acquire);
+            let diff = seq.wrapping_sub(pos.wrapping_add(1)) as isize;
+
+            if diff == 0 {
+                match self.head.compare_exchange_weak(
+                    pos,
+                    pos.wrapping_add(1),
+                    Ordering::Relaxed,
+                    Ordering::Relaxed,
+                ) {
+                    Ok(_) => {
+                        // SAFETY: The slot was published by its producer and
+                        // the CAS gave this thread sole ownership of it
+                        let value = unsafe { (*slot.value.get()).assume_init_read() };
+                        slot.seq
+                            .store(pos.wrapping_add(self.capacity), Ordering::Release);
+                        std::sync::atomic::fence(Ordering::SeqCst);
+                        self.not_full.notify();
+                        return Some(value);
+                    }
+                    Err(current) => pos = current,
+                }
+            } else if diff < 0 {
+                // Nothing published at this position yet: queue is empty
                 return None;
+            } else {
+                pos = self.head.load(Ordering::Relaxed);
             }
+        }
+    }
 
-            // Try to claim this slot
-            if self
-                .head
-                .compare_exchange_weak(
-                    head,
-                    head.wrapping_add(1),
-                    Ordering::Release,
-                    Ordering::Relaxed,
-                )
-                .is_ok()
-            {
-                let slot = &self.buffer[head & self.mask];
-                // SAFETY: We have exclusive access to this slot after CAS success
-                let value = unsafe { (*slot.get()).take() };
-                if value.is_some() {
-                    self.count.fetch_sub(1, Ordering::Release);
+    /// Enqueue items from the front of `values` until the queue is full
+    ///
+    /// Returns how many were pushed; the rest stay in `values`.
+    pub fn push_batch(&self, values: &mut Vec<T>) -> usize {
+        let mut pushed = 0;
+        let mut rest = std::mem::take(values).into_iter();
+        for value in rest.by_ref() {
+            if let Err(value) = self.push(value) {
+                values.push(value);
+                break;
+            }
+            pushed += 1;
+        }
+        values.extend(rest);
+        pushed
+    }
+
+    /// Dequeue up to `max` items into `out`, returning how many were taken
+    pub fn pop_batch(&self, out: &mut Vec<T>, max: usize) -> usize {
+        let mut taken = 0;
+        while taken < max {
+            match self.pop() {
+                Some(value) => out.push(value),
+                None => break,
+            }
+            taken += 1;
+        }
+        taken
+    }
+
+    /// Dequeue an item, waiting up to `timeout` (None = forever)
+    ///
+    /// Returns None on timeout, or once the queue is closed and drained.
+    pub fn pop_wait(&self, timeout: Option<std::time::Duration>) -> Option<T> {
+        let mut result = None;
+        self.wait(&self.not_empty, timeout, || {
+            result = self.pop();
+            result.is_some()
+        });
+        result
+    }
+
+    /// Enqueue an item, waiting up to `timeout` for room (None = forever)
+    ///
+    /// Gives the item back on timeout or if the queue is closed.
+    pub fn push_wait(&self, value: T, timeout: Option<std::time::Duration>) -> Result<(), T> {
+        let mut pending = Some(value);
+        self.wait(&self.not_full, timeout, || match pending.take() {
+            Some(v) => match self.push(v) {
+                Ok(()) => true,
+                Err(v) => {
+                    pending = Some(v);
+                    false
                 }
-                return value;
+            },
+            None => true,
+        });
+        match pending {
+            Some(v) => Err(v),
+            None => Ok(()),
+        }
+    }
+
+    /// Spin, then yield, then park until `attempt` succeeds
+    fn wait(
+        &self,
+        parker: &Parker,
+        timeout: Option<std::time::Duration>,
+        mut attempt: impl FnMut() -> bool,
+    ) {
+        let deadline = timeout.map(|t| std::time::Instant::now() + t);
+        for i in 0..QUEUE_SPIN_LIMIT + QUEUE_YIELD_LIMIT {
+            if attempt() || self.is_closed() {
+                return;
+            }
+            if i < QUEUE_SPIN_LIMIT {
+                std::hint::spin_loop();
+            } else {
+                std::thread::yield_now();
+            }
+        }
+
+        parker.waiters.fetch_add(1, Ordering::SeqCst);
+        let mut guard = parker.lock.lock().unwrap();
+        loop {
+            // Checked under the lock, so a notify cannot slip in between
+            if attempt() || self.is_closed() {
+                break;
             }
-            // CAS failed, retry
-            std::hint::spin_loop();
+            let slice = match deadline {
+                Some(d) => match d.checked_duration_since(std::time::Instant::now()) {
+                    Some(left) if !left.is_zero() => left,
+                    _ => break,
+                },
+                None => std::time::Duration::from_millis(100),
+            };
+            guard = parker.cond.wait_timeout(guard, slice).unwrap().0;
+        }
+        drop(guard);
+        parker.waiters.fetch_sub(1, Ordering::SeqCst);
+    }
+
+    /// Close the queue, waking every blocked producer and consumer
+    ///
+    /// Values already queued can still be popped.
+    pub fn close(&self) {
+        self.closed.store(true, Ordering::SeqCst);
+        for parker in [&self.not_empty, &self.not_full] {
+            let _guard = parker.lock.lock().unwrap();
+            parker.cond.notify_all();
         }
     }
 
+    /// Check if the queue was closed
+    pub fn is_closed(&self) -> bool {
+        self.closed.load(Ordering::Acquire)
+    }
+
     /// Check if empty
     pub fn is_empty(&self) -> bool {
-        self.count.load(Ordering::Acquire) == 0
+        self.len() == 0
     }
 
     /// Get approximate length
     pub fn len(&self) -> usize {
-        self.count.load(Ordering::Relaxed)
+        let tail = self.tail.load(Ordering::Acquire);
+        let head = self.head.load(Ordering::Acquire);
+        tail.wrapping_sub(head).min(self.capacity)
     }
 
     /// Get capacity
@@ -282,6 +450,12 @@ impl<T> LockFreeQueue<T> {
     }
 }
 
+impl<T> Drop for LockFreeQueue<T> {
+    fn drop(&mut self) {
+        while self.pop().is_some() {}
+    }
+}
+
 impl<T> Default for LockFreeQueue<T> {
     fn default() -> Self {
         Self::new(1024)
@@ -486,7 +660,8 @@ impl From<&StoreStats> for FfiStoreStats {
     }
 }
 
-// Global lock-free queue for parallel tasks
+// Global lock-free queue for parallel tasks (kept for the handle-less API;
+// new code should create its own with fz_new_lockfree_queue)
 static TASK_QUEUE: std::sync::LazyLock<LockFreeQueue<u64>> =
     std::sync::LazyLock::new(|| LockFreeQueue::new(4096));
 
@@ -523,6 +698,184 @@ pub extern "C" fn fz_lockfree_queue_capacity() -> usize {
     TASK_QUEUE.capacity()
 }
 
+// Queues created with fz_new_lockfree_queue. The store hands out Arcs
+// without a per-queue mutex, so queue operations stay lock-free.
+static QUEUES: std::sync::LazyLock<LockFreeHandleStore<LockFreeQueue<u64>>> =
+    std::sync::LazyLock::new(LockFreeHandleStore::new);
+
+/// Convert a millisecond timeout (negative = wait forever)
+fn queue_timeout(timeout_ms: c_int) -> Option<std::time::Duration> {
+    u64::try_from(timeout_ms)
+        .ok()
+        .map(std::time::Duration::from_millis)
+}
+
+/// Create a bounded MPMC queue of 64-bit values
+///
+/// Capacity is rounded up to a power of two. Each scheduler, pool or
+/// pipeline can own its queue instead of sharing the global one.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_lockfree_queue(_ctx: Handle, capacity: usize) -> Handle {
+    QUEUES.insert(LockFreeQueue::new(capacity.clamp(2, 1 << 24)))
+}
+
+/// Drop a queue, waking anything blocked on it
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_drop_lockfree_queue(_ctx: Handle, queue: Handle) {
+    if let Some(q) = QUEUES.remove(queue) {
+        q.close();
+    }
+}
+
+/// Close a queue: blocked and later waits return once it is drained
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_close_lockfree_queue(_ctx: Handle, queue: Handle) {
+    if let Some(q) = QUEUES.get(queue) {
+        q.close();
+    }
+}
+
+/// Push a value without blocking
+///
+/// Returns 0 on success, -1 if the queue is full or invalid.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_lockfree_queue_try_push(_ctx: Handle, queue: Handle, value: u64) -> c_int {
+    match QUEUES.get(queue).map(|q| q.push(value)) {
+        Some(Ok(())) => 0,
+        _ => -1,
+    }
+}
+
+/// Pop a value without blocking
+///
+/// Returns 1 and stores the value in `out`, or 0 if the queue is empty.
+///
+/// # Safety
+/// `out` must be a valid pointer to a u64
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_lockfree_queue_try_pop(_ctx: Handle, queue: Handle, out: *mut u64) -> c_int {
+    if out.is_null() {
+        return 0;
+    }
+    match QUEUES.get(queue).and_then(|q| q.pop()) {
+        Some(value) => {
+            unsafe { *out = value };
+            1
+        }
+        None => 0,
+    }
+}
+
+/// Push a value, waiting up to `timeout_ms` for room (negative = forever)
+///
+/// Returns 0 on success, -1 on timeout or if the queue is closed.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_lockfree_queue_wait_push(
+    _ctx: Handle,
+    queue: Handle,
+    value: u64,
+    timeout_ms: c_int,
+) -> c_int {
+    match QUEUES
+        .get(queue)
+        .map(|q| q.push_wait(value, queue_timeout(timeout_ms)))
+    {
+        Some(Ok(())) => 0,
+        _ => -1,
+    }
+}
+
+/// Pop a value, waiting up to `timeout_ms` (negative = forever)
+///
+/// Spins briefly, then parks. Returns 1 and stores the value in `out`, or
+/// 0 on timeout or once the queue is closed and empty.
+///
+/// # Safety
+/// `out` must be a valid pointer to a u64
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_lockfree_queue_wait_pop(
+    _ctx: Handle,
+    queue: Handle,
+    out: *mut u64,
+    timeout_ms: c_int,
+) -> c_int {
+    if out.is_null() {
+        return 0;
+    }
+    match QUEUES
+        .get(queue)
+        .and_then(|q| q.pop_wait(queue_timeout(timeout_ms)))
+    {
+        Some(value) => {
+            unsafe { *out = value };
+            1
+        }
+        None => 0,
+    }
+}
+
+/// Push up to `count` values, returning how many fit
+///
+/// # Safety
+/// `values` must point to at least `count` u64 values
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_lockfree_queue_push_batch(
+    _ctx: Handle,
+    queue: Handle,
+    values: *const u64,
+    count: usize,
+) -> usize {
+    if values.is_null() || count == 0 {
+        return 0;
+    }
+    let Some(q) = QUEUES.get(queue) else {
+        return 0;
+    };
+    let values = unsafe { std::slice::from_raw_parts(values, count) };
+    values.iter().take_while(|&&v| q.push(v).is_ok()).count()
+}
+
+/// Pop up to `max` values into `out`, returning how many were taken
+///
+/// # Safety
+/// `out` must have room for `max` u64 values
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_lockfree_queue_pop_batch(
+    _ctx: Handle,
+    queue: Handle,
+    out: *mut u64,
+    max: usize,
+) -> usize {
+    if out.is_null() || max == 0 {
+        return 0;
+    }
+    let Some(q) = QUEUES.get(queue) else {
+        return 0;
+    };
+    let out = unsafe { std::slice::from_raw_parts_mut(out, max) };
+    let mut taken = 0;
+    while taken < max {
+        match q.pop() {
+            Some(v) => out[taken] = v,
+            None => break,
+        }
+        taken += 1;
+    }
+    taken
+}
+
+/// Get the approximate number of queued values
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_lockfree_queue_count(_ctx: Handle, queue: Handle) -> usize {
+    QUEUES.get(queue).map_or(0, |q| q.len())
+}
+
+/// Get the capacity of a queue
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_lockfree_queue_size(_ctx: Handle, queue: Handle) -> usize {
+    QUEUES.get(queue).map_or(0, |q| q.capacity())
+}
+
 // ============================================================================
 // Tests
 // ============================================================================
@@ -683,6 +1036,121 @@ mod tests {
         assert!(queue.is_empty());
     }
 
+    #[test]
+    fn test_lockfree_queue_wraps() {
+        let queue: LockFreeQueue<usize> = LockFreeQueue::new(4);
+        for lap in 0..10 {
+            for i in 0..4 {
+                queue.push(lap * 4 + i).unwrap();
+            }
+            assert!(queue.push(99).is_err());
+            assert_eq!(queue.len(), 4);
+            for i in 0..4 {
+                assert_eq!(queue.pop(), Some(lap * 4 + i));
+            }
+            assert!(queue.is_empty());
+        }
+    }
+
+    #[test]
+    fn test_lockfree_queue_batch() {
+        let queue: LockFreeQueue<i32> = LockFreeQueue::new(4);
+        let mut values = vec![1, 2, 3, 4, 5, 6];
+        assert_eq!(queue.push_batch(&mut values), 4);
+        assert_eq!(values, vec![5, 6]);
+
+        let mut out = Vec::new();
+        assert_eq!(queue.pop_batch(&mut out, 3), 3);
+        assert_eq!(out, vec![1, 2, 3]);
+        assert_eq!(queue.pop_batch(&mut out, 3), 1);
+    }
+
+    #[test]
+    fn test_lockfree_queue_concurrent_exact() {
+        // Producers and consumers run at the same time through a small ring
+        let queue = Arc::new(LockFreeQueue::new(8));
+        let producers: Vec<_> = (0..4u64)
+            .map(|t| {
+                let queue = queue.clone();
+                thread::spawn(move || {
+                    for i in 0..1000 {
+                        queue.push_wait(t * 1000 + i, None).unwrap();
+                    }
+                })
+            })
+            .collect();
+        let consumers: Vec<_> = (0..4)
+            .map(|_| {
+                let queue = queue.clone();
+                thread::spawn(move || {
+                    let mut seen = Vec::new();
+                    while let Some(v) = queue.pop_wait(None) {
+                        seen.push(v);
+                    }
+                    seen
+                })
+            })
+            .collect();
+
+        for p in producers {
+            p.join().unwrap();
+        }
+        queue.close();
+        let mut all: Vec<u64> = consumers
+            .into_iter()
+            .flat_map(|c| c.join().unwrap())
+            .collect();
+        all.sort_unstable();
+        assert_eq!(all, (0..4000).collect::<Vec<u64>>());
+    }
+
+    #[test]
+    fn test_lockfree_queue_wait_timeout() {
+        let queue: LockFreeQueue<i32> = LockFreeQueue::new(2);
+        let start = std::time::Instant::now();
+        assert_eq!(
+            queue.pop_wait(Some(std::time::Duration::from_millis(20))),
+            None
+        );
+        assert!(start.elapsed() >= std::time::Duration::from_millis(20));
+
+        queue.push(1).unwrap();
+        queue.push(2).unwrap();
+        assert_eq!(
+            queue.push_wait(3, Some(std::time::Duration::from_millis(5))),
+            Err(3)
+        );
+    }
+
+    #[test]
+    fn test_ffi_queue_handles() {
+        let a = fz_new_lockfree_queue(0, 3);
+        let b = fz_new_lockfree_queue(0, 16);
+        assert_eq!(fz_lockfree_queue_size(0, a), 4);
+
+        // Queues are independent, and 0 is an ordinary value
+        assert_eq!(fz_lockfree_queue_try_push(0, a, 0), 0);
+        assert_eq!(fz_lockfree_queue_count(0, b), 0);
+        let mut v = 7;
+        assert_eq!(fz_lockfree_queue_try_pop(0, a, &mut v), 1);
+        assert_eq!(v, 0);
+        assert_eq!(fz_lockfree_queue_try_pop(0, a, &mut v), 0);
+
+        let values = [1u64, 2, 3, 4, 5];
+        assert_eq!(fz_lockfree_queue_push_batch(0, a, values.as_ptr(), 5), 4);
+        let mut out = [0u64; 8];
+        assert_eq!(fz_lockfree_queue_pop_batch(0, a, out.as_mut_ptr(), 8), 4);
+        assert_eq!(&out[..4], &[1, 2, 3, 4]);
+
+        assert_eq!(fz_lockfree_queue_wait_pop(0, a, &mut v, 1), 0);
+        fz_close_lockfree_queue(0, a);
+        assert_eq!(fz_lockfree_queue_wait_pop(0, a, &mut v, -1), 0);
+
+        fz_drop_lockfree_queue(0, a);
+        fz_drop_lockfree_queue(0, b);
+        assert_eq!(fz_lockfree_queue_try_push(0, a, 1), -1);
+    }
+
     #[test]
     fn test_sharded_map_basic() {
         let map: ShardedMap<String, i32> = ShardedMap::new();
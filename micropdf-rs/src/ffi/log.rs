@@ -575,16 +575,7 @@ pub extern "C" fn fz_log_last_warning(_ctx: Handle) -> *const c_char {
 /// Get log level name
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_log_level_name(level: i32) -> *const c_char {
-    static LEVEL_NAMES: LazyLock<[CString; 6]> = LazyLock::new(|| {
-        [
-            CString::new("OFF").unwrap(),
-            CString::new("ERROR").unwrap(),
-            CString::new("WARN").unwrap(),
-            CString::new("INFO").unwrap(),
-            CString::new("DEBUG").unwrap(),
-            CString::new("TRACE").unwrap(),
-        ]
-    });
+    const LEVEL_NAMES: [&CStr; 6] = [c"OFF", c"ERROR", c"WARN", c"INFO", c"DEBUG", c"TRACE"];
 
     if level < 0 || level > 5 {
         return ptr::null();
@@ -5,6 +5,7 @@
 //! - Leak detection for unreleased handles
 //! - Memory usage statistics by type
 //! - Allocation timeline for debugging
+//! - Sampled allocation profile by subsystem, as folded stacks
 //!
 //! Enable with the `profiling` feature flag.
 
@@ -14,7 +15,9 @@ use std::sync::atomic::{AtomicBool, AtomicU64, AtomicUsize, Ordering};
 use std::sync::{LazyLock, Mutex, RwLock};
 use std::time::{Duration, Instant, SystemTime};
 
-use super::Handle;
+use super::buffer::Buffer;
+use super::{BUFFERS, Handle};
+use crate::fitz::alloc_sampler::{self, Subsystem};
 
 // ============================================================================
 // Configuration
@@ -36,6 +39,7 @@ pub extern "C" fn fz_enable_memory_profiling(enabled: i32) {
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_enable_stack_traces(enabled: i32) {
     CAPTURE_STACK_TRACES.store(enabled != 0, Ordering::SeqCst);
+    alloc_sampler::set_capture_stacks(enabled != 0);
 }
 
 /// Check if profiling is enabled
@@ -633,6 +637,7 @@ pub extern "C" fn fz_profiler_handle_count_by_type(resource_type: ResourceType)
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_profiler_reset() {
     MEMORY_PROFILER.reset();
+    alloc_sampler::clear();
 }
 
 /// Print leak report to stderr
@@ -643,6 +648,54 @@ pub extern "C" fn fz_profiler_print_leak_report(min_age_seconds: u64) {
     eprintln!("{}", report.to_string_report());
 }
 
+// ============================================================================
+// Allocation Sampling
+// ============================================================================
+
+/// Sample about one allocation per `bytes` allocated, attributing each to
+/// its subsystem (store, glyph cache, xref, pixmap, font, decode); 0 stops
+/// sampling
+///
+/// Independent of `fz_enable_memory_profiling`, and cheap enough for
+/// production: 512 KiB is a reasonable interval. With
+/// `fz_enable_stack_traces` each sample also records its call stack.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_profiler_set_sample_interval(bytes: u64) {
+    alloc_sampler::set_interval(bytes);
+}
+
+/// Get the sampling interval in bytes (0 when sampling is off)
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_profiler_sample_interval() -> u64 {
+    alloc_sampler::interval()
+}
+
+/// Get the number of allocations sampled
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_profiler_sample_count() -> u64 {
+    alloc_sampler::sample_count()
+}
+
+/// Get the estimated bytes a subsystem (`FZ_ALLOC_*`) allocated while
+/// sampling, or 0 for an unknown subsystem
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_profiler_sampled_bytes(subsystem: i32) -> u64 {
+    Subsystem::from_i32(subsystem).map_or(0, alloc_sampler::sampled_bytes)
+}
+
+/// Export the allocation samples as folded stacks
+///
+/// One "micropdf;subsystem;... bytes" line per distinct stack, ready for
+/// `flamegraph.pl` or `inferno-flamegraph`. Bytes are estimates of all
+/// allocations, not only the sampled ones.
+///
+/// # Returns
+/// Buffer handle holding the text (drop with `fz_drop_buffer`)
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_profiler_export_folded() -> Handle {
+    BUFFERS.insert(Buffer::from_data(alloc_sampler::folded().as_bytes()))
+}
+
 // ============================================================================
 // Helper Functions for Integration
 // ============================================================================
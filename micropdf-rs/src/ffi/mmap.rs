@@ -11,6 +11,7 @@
 //! - Lazy loading (pages loaded on access)
 //! - Efficient random access
 
+use bytes::Bytes;
 use memmap2::{Mmap, MmapOptions};
 use std::fs::File;
 use std::io::{self, Read, Seek, SeekFrom};
@@ -18,7 +19,7 @@ use std::ops::Range;
 use std::path::Path;
 use std::sync::{Arc, LazyLock, Mutex, RwLock};
 
-use super::{Handle, HandleStore};
+use super::{Handle, HandleStore, simd_util};
 
 // ============================================================================
 // Memory-Mapped File
@@ -186,7 +187,7 @@ impl MappedFile {
 
     /// Search for a byte sequence
     pub fn find(&self, needle: &[u8]) -> Option<usize> {
-        self.mmap.windows(needle.len()).position(|w| w == needle)
+        simd_util::find_bytes(&self.mmap, needle)
     }
 
     /// Search for a byte sequence from offset
@@ -194,10 +195,7 @@ impl MappedFile {
         if offset >= self.size {
             return None;
         }
-        self.mmap[offset..]
-            .windows(needle.len())
-            .position(|w| w == needle)
-            .map(|p| p + offset)
+        simd_util::find_bytes(&self.mmap[offset..], needle).map(|p| p + offset)
     }
 
     /// Reverse search for a byte sequence
@@ -236,6 +234,103 @@ impl MappedFile {
     }
 }
 
+// ============================================================================
+// File Bytes
+// ============================================================================
+
+/// Expected access pattern, passed to the kernel as a paging hint
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum AccessPattern {
+    /// Front-to-back scans: read ahead aggressively
+    Sequential,
+    /// Page and object lookups: don't read ahead
+    Random,
+}
+
+/// Contents of a document or stream, either owned or mapped from a file
+///
+/// Mapped bytes come straight from the page cache, with no read syscalls
+/// and no user-space copy. As with any mapping, a file truncated by another
+/// process while it is mapped faults on access.
+pub enum FileBytes {
+    Owned(Vec<u8>),
+    Mapped(Mmap),
+}
+
+impl FileBytes {
+    /// Map a file read-only
+    ///
+    /// Empty files can't be mapped on every platform and are read instead.
+    pub fn map<P: AsRef<Path>>(path: P) -> io::Result<Self> {
+        let file = File::open(path.as_ref())?;
+        if file.metadata()?.len() == 0 {
+            return Ok(Self::Owned(Vec::new()));
+        }
+        // SAFETY: File is opened read-only
+        let mmap = unsafe { MmapOptions::new().map(&file)? };
+        Ok(Self::Mapped(mmap))
+    }
+
+    /// Whether the bytes are mapped rather than owned
+    pub fn is_mapped(&self) -> bool {
+        matches!(self, Self::Mapped(_))
+    }
+
+    /// Hint the access pattern to come; a no-op for owned bytes
+    pub fn advise(&self, pattern: AccessPattern) {
+        #[cfg(unix)]
+        if let Self::Mapped(mmap) = self {
+            let advice = match pattern {
+                AccessPattern::Sequential => memmap2::Advice::Sequential,
+                AccessPattern::Random => memmap2::Advice::Random,
+            };
+            // Only a hint: failure changes nothing but paging
+            let _ = mmap.advise(advice);
+        }
+        #[cfg(not(unix))]
+        let _ = pattern;
+    }
+
+    /// The whole file as `Bytes`, so slices of it can be handed out
+    /// without copying while keeping the file alive
+    pub fn shared(self: &Arc<Self>) -> Bytes {
+        Bytes::from_owner(SharedFile(Arc::clone(self)))
+    }
+}
+
+/// Owner behind `FileBytes::shared`
+struct SharedFile(Arc<FileBytes>);
+
+impl AsRef<[u8]> for SharedFile {
+    fn as_ref(&self) -> &[u8] {
+        &self.0
+    }
+}
+
+impl std::ops::Deref for FileBytes {
+    type Target = [u8];
+
+    fn deref(&self) -> &[u8] {
+        match self {
+            Self::Owned(v) => v,
+            Self::Mapped(m) => m,
+        }
+    }
+}
+
+impl From<Vec<u8>> for FileBytes {
+    fn from(data: Vec<u8>) -> Self {
+        Self::Owned(data)
+    }
+}
+
+impl std::fmt::Debug for FileBytes {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        let kind = if self.is_mapped() { "Mapped" } else { "Owned" };
+        write!(f, "FileBytes::{kind}({} bytes)", self.len())
+    }
+}
+
 // ============================================================================
 // Mapped Buffer (with cursor)
 // ============================================================================
@@ -791,6 +886,19 @@ mod tests {
         assert_eq!(mapped.as_slice(), content);
     }
 
+    #[test]
+    fn test_file_bytes_map() {
+        let temp = create_test_file(b"%PDF-1.7");
+        let bytes = FileBytes::map(temp.path()).unwrap();
+        assert!(bytes.is_mapped());
+        bytes.advise(AccessPattern::Random);
+        assert_eq!(&bytes[..], b"%PDF-1.7");
+
+        let empty = FileBytes::map(create_test_file(b"").path()).unwrap();
+        assert!(!empty.is_mapped());
+        assert!(empty.is_empty());
+    }
+
     #[test]
     fn test_mapped_file_read_at() {
         let content = b"0123456789ABCDEF";
@@ -11,6 +11,7 @@ pub mod annot;
 pub mod archive;
 pub mod band_writer;
 pub mod barcode;
+pub mod barcode_scan;
 pub mod bidi;
 pub mod bitmap;
 pub mod buffer;
@@ -18,12 +19,16 @@ pub mod buffered_io;
 pub mod cbz;
 pub mod color;
 pub mod colorspace;
+pub mod command_buffer;
+pub mod composite;
 pub mod compress;
 pub mod context;
+pub mod context_snapshot;
 pub mod cookie;
 pub mod data_locality;
 pub mod deskew;
 pub mod device;
+pub mod dispatch;
 pub mod display_list;
 pub mod document;
 pub mod draw_device;
@@ -36,12 +41,16 @@ pub mod form;
 pub mod geometry;
 pub mod glyph;
 pub mod glyph_cache;
+pub mod glyph_disk_cache;
 pub mod gpu;
+pub mod handle_slab;
 pub mod hashmap_util;
 pub mod heap;
 pub mod hints;
 pub mod hyphen;
+pub mod icc;
 pub mod image;
+pub mod jpeg_encode;
 pub mod json;
 pub mod link;
 pub mod lockfree;
@@ -49,6 +58,7 @@ pub mod log;
 pub mod memory_profiler;
 pub mod mmap;
 pub mod ocr;
+pub mod ocr_pipeline;
 pub mod office;
 pub mod outline;
 pub mod output;
@@ -57,27 +67,65 @@ pub mod pdf_3d;
 pub mod pdf_clean;
 pub mod pdf_cmap;
 pub mod pdf_conformance;
+pub mod pdf_dedup;
+pub mod pdf_embedded_stream;
 pub mod pdf_event;
 pub mod pdf_font;
+pub mod pdf_form_fill;
+pub mod pdf_form_flatten;
+pub mod pdf_form_index;
+pub mod pdf_gc;
+pub mod pdf_graft;
 pub mod pdf_image_rewriter;
+pub mod pdf_incremental;
+pub mod pdf_inspect;
 pub mod pdf_interpret;
 pub mod pdf_javascript;
+pub mod pdf_js_calculate;
 pub mod pdf_layer;
+pub mod pdf_linearize;
 pub mod pdf_name_table;
 pub mod pdf_object;
+pub mod pdf_objstm;
+pub mod pdf_opcode;
+pub mod pdf_optimize;
 pub mod pdf_page;
+pub mod pdf_page_edit;
+pub mod pdf_page_tree;
 pub mod pdf_parse;
 pub mod pdf_portfolio;
 pub mod pdf_recolor;
 pub mod pdf_redact;
+pub mod pdf_redact_engine;
+pub mod pdf_redact_search;
+pub mod pdf_repair;
 pub mod pdf_resource;
 pub mod pdf_signature;
+pub mod pdf_signature_digest;
+pub mod pdf_signature_prepare;
+pub mod pdf_stream_prefetch;
+pub mod pdf_struct_tree;
+pub mod pdf_subset;
+pub mod pdf_vectorize;
+pub mod pdf_write;
 pub mod pdf_xref;
+pub mod pdf_xref_lazy;
 pub mod pdf_zugferd;
+pub mod perf_counters;
+pub mod pixel_convert;
 pub mod pixmap;
+pub mod pixmap_pool;
+pub mod png_encode;
 pub mod pool;
+pub mod predict;
+pub mod range_source;
+pub mod rasterize;
+pub mod render_pool;
+pub mod resample;
+pub mod search_index;
 pub mod separation;
 pub mod shade;
+pub mod shade_paint;
 pub mod simd_util;
 pub mod stext;
 pub mod store;
@@ -88,7 +136,10 @@ pub mod struct_layout;
 pub mod svg;
 pub mod table_detect;
 pub mod text;
+pub mod text_extract;
+pub mod thumbnail;
 pub mod tile_render;
+pub mod trace;
 pub mod transition;
 pub mod tree;
 pub mod util;
@@ -100,12 +151,14 @@ pub mod xps;
 // Safe helper functions for common FFI patterns
 mod safe_helpers;
 
-use std::collections::HashMap;
+use std::marker::PhantomData;
 use std::sync::{
     Arc, Mutex,
     atomic::{AtomicU64, Ordering},
 };
 
+use crate::fitz::counters::{self, Counter};
+
 /// Global handle manager for safe FFI resource management
 static HANDLE_COUNTER: AtomicU64 = AtomicU64::new(1);
 
@@ -113,6 +166,9 @@ static HANDLE_COUNTER: AtomicU64 = AtomicU64::new(1);
 pub type Handle = u64;
 
 /// Generate a new unique handle
+///
+/// Used by stores outside the handle slab; `HandleStore` handles come from
+/// `handle_slab` instead.
 pub fn new_handle() -> Handle {
     HANDLE_COUNTER.fetch_add(1, Ordering::SeqCst)
 }
@@ -131,78 +187,119 @@ pub struct HandleStoreStats {
 }
 
 /// Thread-safe handle storage for a specific type
+///
+/// Values live in the shared lock-free `handle_slab`; lookups never take
+/// a lock, and a handle stops resolving as soon as it is removed.
 pub struct HandleStore<T> {
-    store: Mutex<HashMap<Handle, Arc<Mutex<T>>>>,
-    stats: Mutex<HandleStoreStats>,
+    slab: handle_slab::Slab,
+    total_created: AtomicU64,
+    total_destroyed: AtomicU64,
+    current_count: AtomicU64,
+    peak_count: AtomicU64,
+    /// Performance counter bumped on each lookup, if any
+    lookups: Option<Counter>,
+    _values: PhantomData<fn() -> T>,
 }
 
-impl<T> HandleStore<T> {
+impl<T: Send + 'static> HandleStore<T> {
     pub fn new() -> Self {
         Self {
-            store: Mutex::new(HashMap::new()),
-            stats: Mutex::new(HandleStoreStats::default()),
+            slab: handle_slab::Slab::new(),
+            total_created: AtomicU64::new(0),
+            total_destroyed: AtomicU64::new(0),
+            current_count: AtomicU64::new(0),
+            peak_count: AtomicU64::new(0),
+            lookups: None,
+            _values: PhantomData,
         }
     }
 
+    /// A store counting its lookups in `counter` (see `fz_get_perf_counters`)
+    pub fn with_lookup_counter(counter: Counter) -> Self {
+        let mut store = Self::new();
+        store.lookups = Some(counter);
+        store
+    }
+
     /// Insert a value and return its handle.
     ///
-    /// Returns a non-zero handle on success. The caller is responsible
-    /// for eventually calling `remove()` to release the resource.
+    /// Returns a non-zero handle on success, or 0 once every slot of the
+    /// handle slab is live (2^21 - 1 handles, shared by all stores); the
+    /// value is then dropped and the failure counted for
+    /// `fz_handle_insert_failures`. Exports return the 0 as their failure
+    /// result. The caller is responsible for eventually calling `remove()`
+    /// to release the resource.
     #[must_use = "handle must be stored and later passed to remove() to avoid resource leaks"]
     pub fn insert(&self, value: T) -> Handle {
-        let handle = new_handle();
-        let mut store = self.store.lock().unwrap();
-        store.insert(handle, Arc::new(Mutex::new(value)));
-
-        // Update stats
-        if let Ok(mut stats) = self.stats.lock() {
-            stats.total_created += 1;
-            stats.current_count += 1;
-            if stats.current_count > stats.peak_count {
-                stats.peak_count = stats.current_count;
-            }
+        let handle = self.slab.insert(Arc::new(Mutex::new(value)));
+        if handle != 0 {
+            self.total_created.fetch_add(1, Ordering::Relaxed);
+            let current = self.current_count.fetch_add(1, Ordering::Relaxed) + 1;
+            self.peak_count.fetch_max(current, Ordering::Relaxed);
         }
-
         handle
     }
 
     /// Get a reference to the value associated with a handle.
+    #[inline]
     pub fn get(&self, handle: Handle) -> Option<Arc<Mutex<T>>> {
-        let store = self.store.lock().unwrap();
-        store.get(&handle).cloned()
+        if let Some(counter) = self.lookups {
+            counters::add(counter, 1);
+        }
+        self.slab.get(handle)?.downcast().ok()
+    }
+
+    fn removed(
+        &self,
+        value: Option<Arc<dyn std::any::Any + Send + Sync>>,
+    ) -> Option<Arc<Mutex<T>>> {
+        let value = value?;
+        self.total_destroyed.fetch_add(1, Ordering::Relaxed);
+        self.current_count.fetch_sub(1, Ordering::Relaxed);
+        value.downcast().ok()
     }
 
     /// Remove a handle and return the value if it exists.
+    ///
+    /// This ignores references taken with `keep()`; use `release()` for
+    /// MuPDF-style drop semantics.
     pub fn remove(&self, handle: Handle) -> Option<Arc<Mutex<T>>> {
-        let mut store = self.store.lock().unwrap();
-        let result = store.remove(&handle);
-
-        // Update stats
-        if result.is_some() {
-            if let Ok(mut stats) = self.stats.lock() {
-                stats.total_destroyed += 1;
-                stats.current_count = stats.current_count.saturating_sub(1);
-            }
-        }
-
-        result
+        self.removed(self.slab.remove(handle))
     }
 
     /// Keep (retain) a handle - returns the same handle.
-    /// For reference counting, the Arc inside handles ref counting automatically.
+    ///
+    /// Each `keep()` must be balanced by a `release()`; the value is only
+    /// removed once the last reference is released.
     #[must_use = "returned handle should be used or the keep call is unnecessary"]
     pub fn keep(&self, handle: Handle) -> Handle {
+        self.slab.keep(handle);
         handle
     }
 
+    /// Release one reference to a handle.
+    ///
+    /// Drops a reference taken with `keep()` if there is one, otherwise
+    /// removes the handle. Returns true if the handle was removed.
+    pub fn release(&self, handle: Handle) -> bool {
+        let (freed, value) = self.slab.release(handle);
+        self.removed(value);
+        freed
+    }
+
     /// Get current statistics for this handle store.
     pub fn stats(&self) -> HandleStoreStats {
-        self.stats.lock().map(|s| *s).unwrap_or_default()
+        HandleStoreStats {
+            total_created: self.total_created.load(Ordering::Relaxed),
+            total_destroyed: self.total_destroyed.load(Ordering::Relaxed),
+            current_count: self.current_count.load(Ordering::Relaxed),
+            peak_count: self.peak_count.load(Ordering::Relaxed),
+        }
     }
 
     /// Get current number of live handles.
     pub fn len(&self) -> usize {
-        self.store.lock().map(|s| s.len()).unwrap_or(0)
+        self.current_count.load(Ordering::Relaxed) as usize
     }
 
     /// Check if store is empty.
@@ -213,14 +310,11 @@ impl<T> HandleStore<T> {
     /// Check for potential leaks (handles that haven't been removed).
     /// Returns a list of handles that are still alive.
     pub fn get_live_handles(&self) -> Vec<Handle> {
-        self.store
-            .lock()
-            .map(|s| s.keys().copied().collect())
-            .unwrap_or_default()
+        self.slab.live_handles()
     }
 }
 
-impl<T> Default for HandleStore<T> {
+impl<T: Send + 'static> Default for HandleStore<T> {
     fn default() -> Self {
         Self::new()
     }
@@ -228,17 +322,18 @@ impl<T> Default for HandleStore<T> {
 
 impl<T> Drop for HandleStore<T> {
     fn drop(&mut self) {
-        // Log if there are unreleased handles (potential leak detection)
-        if let Ok(store) = self.store.lock() {
-            let count = store.len();
-            if count > 0 {
-                // In debug builds, this helps identify leaks
-                #[cfg(debug_assertions)]
-                eprintln!(
-                    "[HandleStore] Warning: {} unreleased handles at drop time",
-                    count
-                );
-            }
+        // Free the store's slots; values still referenced elsewhere live on
+        let live = self.slab.live_handles();
+        if !live.is_empty() {
+            // In debug builds, this helps identify leaks
+            #[cfg(debug_assertions)]
+            eprintln!(
+                "[HandleStore] Warning: {} unreleased handles at drop time",
+                live.len()
+            );
+        }
+        for handle in live {
+            self.slab.remove(handle);
         }
     }
 }
@@ -247,7 +342,10 @@ impl<T> Drop for HandleStore<T> {
 use std::sync::LazyLock;
 
 pub static CONTEXTS: LazyLock<HandleStore<context::Context>> = LazyLock::new(HandleStore::new);
-pub static BUFFERS: LazyLock<HandleStore<buffer::Buffer>> = LazyLock::new(HandleStore::new);
+pub static BUFFERS: LazyLock<HandleStore<buffer::Buffer>> =
+    LazyLock::new(|| HandleStore::with_lookup_counter(Counter::BufferLookups));
 pub static STREAMS: LazyLock<HandleStore<stream::Stream>> = LazyLock::new(HandleStore::new);
-pub static PIXMAPS: LazyLock<HandleStore<pixmap::Pixmap>> = LazyLock::new(HandleStore::new);
-pub static DOCUMENTS: LazyLock<HandleStore<document::Document>> = LazyLock::new(HandleStore::new);
+pub static PIXMAPS: LazyLock<HandleStore<pixmap::Pixmap>> =
+    LazyLock::new(|| HandleStore::with_lookup_counter(Counter::PixmapLookups));
+pub static DOCUMENTS: LazyLock<HandleStore<document::Document>> =
+    LazyLock::new(|| HandleStore::with_lookup_counter(Counter::DocumentLookups));
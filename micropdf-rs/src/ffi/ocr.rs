@@ -6,6 +6,7 @@
 use std::ffi::{CStr, CString, c_char, c_int};
 use std::sync::LazyLock;
 
+use crate::ffi::bitmap::Bitmap;
 use crate::ffi::{Handle, HandleStore};
 use crate::fitz::geometry::Rect;
 use crate::fitz::pixmap::Pixmap;
@@ -44,6 +45,18 @@ pub enum OcrEngineType {
     AzureVision = 6,
 }
 
+impl OcrEngineType {
+    /// Engine type from its C value; unknown values select the stub
+    pub fn from_i32(value: i32) -> Self {
+        match value {
+            1 => OcrEngineType::Tesseract,
+            2 => OcrEngineType::WindowsOcr,
+            3 => OcrEngineType::AppleVision,
+            _ => OcrEngineType::None,
+        }
+    }
+}
+
 /// OCR page segmentation modes (Tesseract PSM)
 #[repr(C)]
 #[derive(Debug, Clone, Copy, PartialEq, Eq)]
@@ -405,6 +418,18 @@ impl OcrEngine {
         }
     }
 
+    /// Recognize text in a binarized page
+    pub fn recognize_bitmap(&self, bitmap: &Bitmap) -> OcrResult {
+        if !self.initialized {
+            return OcrResult::error("OCR engine not initialized");
+        }
+
+        match self.config.engine_type {
+            OcrEngineType::None => OcrResult::new(bitmap.width as u32, bitmap.height as u32),
+            _ => OcrResult::error("OCR recognition not implemented for this engine"),
+        }
+    }
+
     /// Set language
     pub fn set_language(&mut self, lang: &str) {
         self.config.language = lang.to_string();
@@ -442,12 +467,7 @@ impl OcrEngine {
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_new_ocr_engine(_ctx: Handle, engine_type: c_int) -> Handle {
     let config = OcrConfig {
-        engine_type: match engine_type {
-            1 => OcrEngineType::Tesseract,
-            2 => OcrEngineType::WindowsOcr,
-            3 => OcrEngineType::AppleVision,
-            _ => OcrEngineType::None,
-        },
+        engine_type: OcrEngineType::from_i32(engine_type),
         ..Default::default()
     };
 
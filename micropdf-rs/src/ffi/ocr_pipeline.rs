@@ -0,0 +1,318 @@
+//! Document OCR pipeline - scanned pages to a pdfocr writer in one call
+//!
+//! Each page is rendered straight to a gray pixmap at OCR resolution and
+//! binarized; skew is measured on that bitmap, and only a skewed page is
+//! binarized again by a fused rotate-and-threshold pass before OCR. Pages
+//! run on worker threads with cloned contexts, one OCR engine per worker,
+//! and the results are written to the document writer on the calling
+//! thread in page order, with at most `max_in_flight` recognised pages
+//! waiting to be written.
+
+use std::ffi::CStr;
+use std::os::raw::{c_char, c_int};
+use std::sync::Mutex;
+
+use super::bitmap::threshold_pixmap;
+use super::colorspace::FZ_COLORSPACE_GRAY;
+use super::context::fz_aa_level;
+use super::deskew::{deskew_to_bitmap, detect_skew_bitmap};
+use super::document::{
+    FZ_RENDER_ANNOTS, fz_bound_page, fz_count_pages, fz_drop_page, fz_load_page,
+    fz_new_pixmap_from_page_with_options,
+};
+use super::geometry::fz_matrix;
+use super::ocr::{OcrConfig, OcrEngine, OcrEngineType, OcrResult};
+use super::pixmap::fz_drop_pixmap;
+use super::stext::Rect;
+use super::text_extract::{batch_threads, for_each_page_in_order};
+use super::writer::{WRITERS, report_ocr_progress};
+use super::{Handle, PIXMAPS};
+
+/// Render resolution used when the options leave it at 0
+pub const FZ_OCR_DEFAULT_DPI: i32 = 300;
+
+/// Binarization threshold used when the options leave it at 0
+pub const FZ_OCR_DEFAULT_THRESHOLD: i32 = 128;
+
+/// OCR pipeline options
+#[repr(C)]
+#[derive(Debug, Clone, Copy)]
+pub struct OcrPipelineOptions {
+    /// `OcrEngineType` value used for every engine
+    pub engine_type: c_int,
+    /// Language code such as "eng"; null for the engine default
+    pub language: *const c_char,
+    /// Render resolution; 0 for `FZ_OCR_DEFAULT_DPI`
+    pub dpi: c_int,
+    /// Gray level (1-255) below which a pixel is black; 0 for the default
+    pub threshold: c_int,
+    /// Pages skewed by less than this many degrees are not rotated;
+    /// negative to skip skew detection entirely
+    pub skew_threshold: f64,
+}
+
+impl Default for OcrPipelineOptions {
+    fn default() -> Self {
+        Self {
+            engine_type: OcrEngineType::None as c_int,
+            language: std::ptr::null(),
+            dpi: FZ_OCR_DEFAULT_DPI,
+            threshold: FZ_OCR_DEFAULT_THRESHOLD,
+            skew_threshold: 0.5,
+        }
+    }
+}
+
+/// Per-page settings resolved from the options
+#[derive(Clone, Copy)]
+struct PageSettings {
+    dpi: i32,
+    threshold: i32,
+    skew_threshold: f64,
+}
+
+/// One recognised page, ready to be written
+struct OcrPage {
+    mediabox: Rect,
+    result: OcrResult,
+}
+
+/// Render, deskew, binarize and recognise one page
+fn ocr_page(
+    ctx: Handle,
+    doc: Handle,
+    n: i32,
+    settings: PageSettings,
+    engine: &OcrEngine,
+) -> Option<OcrPage> {
+    let page = fz_load_page(ctx, doc, n);
+    if page == 0 {
+        return None;
+    }
+    let bounds = fz_bound_page(ctx, page);
+    let scale = settings.dpi as f32 / 72.0;
+    let ctm = fz_matrix {
+        a: scale,
+        b: 0.0,
+        c: 0.0,
+        d: scale,
+        e: 0.0,
+        f: 0.0,
+    };
+    let pix = fz_new_pixmap_from_page_with_options(
+        ctx,
+        page,
+        ctm,
+        FZ_COLORSPACE_GRAY,
+        0,
+        fz_aa_level(ctx),
+        FZ_RENDER_ANNOTS,
+        0,
+    );
+    fz_drop_page(ctx, page);
+    if pix == 0 {
+        return None;
+    }
+
+    let bitmap = PIXMAPS.get(pix).and_then(|p| {
+        let guard = p.lock().ok()?;
+        let bitmap = threshold_pixmap(&guard, settings.threshold);
+        if settings.skew_threshold < 0.0 {
+            return Some(bitmap);
+        }
+        // Most pages are straight, so measure on the bitmap already made
+        let skew = detect_skew_bitmap(&bitmap);
+        Some(if skew.abs() > settings.skew_threshold {
+            deskew_to_bitmap(&guard, -skew, settings.threshold)
+        } else {
+            bitmap
+        })
+    });
+    fz_drop_pixmap(ctx, pix);
+    let mut bitmap = bitmap?;
+    bitmap.x_res = settings.dpi;
+    bitmap.y_res = settings.dpi;
+
+    Some(OcrPage {
+        mediabox: Rect {
+            x0: bounds.x0,
+            y0: bounds.y0,
+            x1: bounds.x1,
+            y1: bounds.y1,
+        },
+        result: engine.recognize_bitmap(&bitmap),
+    })
+}
+
+/// OCR every page of a document into a document writer
+///
+/// Pages are processed on up to `threads` workers (0 for one per core),
+/// each with its own initialised OCR engine, and written to `writer` on
+/// the calling thread in page order. At most `max_in_flight` pages (0 for
+/// twice the thread count) are recognised but not yet written. The
+/// writer's `fz_pdfocr_writer_set_progress` callback, if set, is told
+/// about each page as it is written and can abort the run. `options` may
+/// be null for the defaults.
+///
+/// # Returns
+/// Number of pages written, or -1 if the document has no pages, the
+/// writer is invalid or the OCR engines fail to initialise
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_ocr_document(
+    ctx: Handle,
+    doc: Handle,
+    writer: Handle,
+    options: *const OcrPipelineOptions,
+    threads: i32,
+    max_in_flight: i32,
+) -> i32 {
+    let Some(wri) = WRITERS.get(writer) else {
+        return -1;
+    };
+    let pages = fz_count_pages(ctx, doc);
+    if pages <= 0 {
+        return -1;
+    }
+    let pages = pages as usize;
+    let options = if options.is_null() {
+        OcrPipelineOptions::default()
+    } else {
+        // SAFETY: the caller passes a valid options struct or null
+        unsafe { *options }
+    };
+    let settings = PageSettings {
+        dpi: if options.dpi > 0 {
+            options.dpi
+        } else {
+            FZ_OCR_DEFAULT_DPI
+        },
+        threshold: if options.threshold > 0 {
+            options.threshold
+        } else {
+            FZ_OCR_DEFAULT_THRESHOLD
+        },
+        skew_threshold: options.skew_threshold,
+    };
+    let language = if options.language.is_null() {
+        None
+    } else {
+        // SAFETY: a non-null language is a NUL-terminated string
+        unsafe { CStr::from_ptr(options.language) }
+            .to_str()
+            .ok()
+            .map(str::to_string)
+    };
+
+    let threads = batch_threads(threads, pages);
+    let window = if max_in_flight > 0 {
+        max_in_flight as usize
+    } else {
+        threads * 2
+    };
+
+    // One engine per worker; at most `threads` pages are in `work` at once
+    let mut engines = Vec::with_capacity(threads);
+    for _ in 0..threads {
+        let mut config = OcrConfig {
+            engine_type: OcrEngineType::from_i32(options.engine_type),
+            dpi: settings.dpi as u32,
+            ..Default::default()
+        };
+        if let Some(language) = &language {
+            config.language = language.clone();
+        }
+        let mut engine = OcrEngine::new(config);
+        if engine.init().is_err() {
+            return -1;
+        }
+        engines.push(engine);
+    }
+    let engines = Mutex::new(engines);
+
+    let mut written = 0;
+    for_each_page_in_order(
+        ctx,
+        pages,
+        threads,
+        window,
+        |worker_ctx, n| {
+            let engine = engines.lock().ok()?.pop()?;
+            let page = ocr_page(worker_ctx, doc, n, settings, &engine);
+            if let Ok(mut engines) = engines.lock() {
+                engines.push(engine);
+            }
+            page
+        },
+        |n, page| {
+            let Some(page) = page else {
+                return true;
+            };
+            let added = match wri.lock() {
+                Ok(mut w) => w.add_page(page.mediabox, page.result.text().into_bytes()),
+                Err(_) => false,
+            };
+            if !added {
+                return false;
+            }
+            written += 1;
+            report_ocr_progress(ctx, writer, n, 100)
+        },
+    );
+    written
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::DOCUMENTS;
+    use crate::ffi::context::fz_new_context;
+    use crate::ffi::document::Document;
+    use crate::ffi::writer::{fz_drop_document_writer, fz_new_pdfocr_writer};
+
+    fn pages(count: usize) -> Handle {
+        let mut data = b"%PDF-1.4\n".to_vec();
+        for _ in 0..count {
+            data.extend_from_slice(b"/Type /Page\n");
+        }
+        data.extend_from_slice(b"%%EOF");
+        DOCUMENTS.insert(Document::new(data))
+    }
+
+    #[test]
+    fn test_ocr_document_writes_every_page() {
+        let ctx = unsafe { fz_new_context(std::ptr::null(), std::ptr::null(), 1024 * 1024) };
+        let doc = pages(4);
+        let count = fz_count_pages(ctx, doc);
+        let writer = fz_new_pdfocr_writer(ctx, std::ptr::null(), std::ptr::null());
+        let options = OcrPipelineOptions {
+            dpi: 36,
+            ..Default::default()
+        };
+
+        let written = fz_ocr_document(ctx, doc, writer, &options, 3, 1);
+        assert_eq!(written, count);
+        let w = WRITERS.get(writer).unwrap();
+        let w = w.lock().unwrap();
+        assert_eq!(w.page_count, count);
+        let indices: Vec<i32> = w.pages.iter().map(|p| p.index).collect();
+        assert_eq!(indices, (0..count).collect::<Vec<_>>());
+        drop(w);
+        fz_drop_document_writer(ctx, writer);
+    }
+
+    #[test]
+    fn test_ocr_document_rejects_bad_input() {
+        let ctx = unsafe { fz_new_context(std::ptr::null(), std::ptr::null(), 1024 * 1024) };
+        let doc = pages(2);
+        assert_eq!(fz_ocr_document(ctx, doc, 0, std::ptr::null(), 0, 0), -1);
+
+        // Tesseract is not compiled in, so its engines fail to initialise
+        let writer = fz_new_pdfocr_writer(ctx, std::ptr::null(), std::ptr::null());
+        let options = OcrPipelineOptions {
+            engine_type: OcrEngineType::Tesseract as c_int,
+            ..Default::default()
+        };
+        assert_eq!(fz_ocr_document(ctx, doc, writer, &options, 1, 0), -1);
+        fz_drop_document_writer(ctx, writer);
+    }
+}
@@ -125,6 +125,46 @@ pub extern "C" fn fz_write_char(_ctx: Handle, out: Handle, c: c_char) {
     fz_write_byte(_ctx, out, byte);
 }
 
+/// Write an integer as decimal text
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_write_int(_ctx: Handle, out: Handle, x: i64) {
+    if let Some(output_arc) = OUTPUTS.get(out) {
+        if let Ok(mut guard) = output_arc.lock() {
+            let _ = guard.write_int(x);
+        }
+    }
+}
+
+/// Write a real as PDF syntax does: the shortest decimal that reads back
+/// as the same float, with no exponent
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_write_real(_ctx: Handle, out: Handle, x: f32) {
+    if let Some(output_arc) = OUTPUTS.get(out) {
+        if let Ok(mut guard) = output_arc.lock() {
+            let _ = guard.write_real(x);
+        }
+    }
+}
+
+/// Write `count` reals separated by spaces, in one call
+///
+/// # Safety
+/// Caller must ensure `values` points to at least `count` floats.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_write_reals(_ctx: Handle, out: Handle, values: *const f32, count: usize) {
+    if values.is_null() || count == 0 {
+        return;
+    }
+
+    if let Some(output_arc) = OUTPUTS.get(out) {
+        if let Ok(mut guard) = output_arc.lock() {
+            // SAFETY: Caller guarantees values points to count floats
+            let slice = unsafe { std::slice::from_raw_parts(values, count) };
+            let _ = guard.write_reals(slice);
+        }
+    }
+}
+
 /// Write i16 big-endian
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_write_int16_be(_ctx: Handle, out: Handle, x: i16) {
@@ -535,6 +575,29 @@ mod tests {
         assert_eq!(content, "Hello, World!");
     }
 
+    #[test]
+    fn test_output_write_numbers() {
+        let temp_file = NamedTempFile::new().unwrap();
+        let path = temp_file.path();
+        let c_path = CString::new(path.to_str().unwrap()).unwrap();
+
+        let ctx = 0;
+        let out = fz_new_output_with_path(ctx, c_path.as_ptr(), 0);
+
+        let values = [1.0f32, 0.25, -72.5];
+        fz_write_reals(ctx, out, values.as_ptr(), values.len());
+        fz_write_byte(ctx, out, b' ');
+        fz_write_real(ctx, out, 0.1);
+        fz_write_byte(ctx, out, b' ');
+        fz_write_int(ctx, out, -3);
+
+        fz_close_output(ctx, out);
+        fz_drop_output(ctx, out);
+
+        let content = std::fs::read_to_string(path).unwrap();
+        assert_eq!(content, "1 0.25 -72.5 0.1 -3");
+    }
+
     #[test]
     fn test_output_write_data() {
         let temp_file = NamedTempFile::new().unwrap();
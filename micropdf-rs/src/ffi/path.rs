@@ -118,6 +118,98 @@ pub extern "C" fn fz_rectto(_ctx: Handle, path: Handle, x0: f32, y0: f32, x1: f3
     }
 }
 
+/// Path command: move to (x, y)
+pub const FZ_PATH_MOVETO: u8 = 0;
+/// Path command: line to (x, y)
+pub const FZ_PATH_LINETO: u8 = 1;
+/// Path command: cubic curve through (x1, y1), (x2, y2) to (x3, y3)
+pub const FZ_PATH_CURVETO: u8 = 2;
+/// Path command: close the current subpath
+pub const FZ_PATH_CLOSEPATH: u8 = 3;
+/// Path command: rectangle, with the same four numbers as `fz_rectto`
+pub const FZ_PATH_RECTTO: u8 = 4;
+/// Path command: quadratic curve through (x1, y1) to (x2, y2)
+pub const FZ_PATH_QUADTO: u8 = 5;
+
+/// Append a packed list of commands to a path
+///
+/// `ops` holds `n` commands (`FZ_PATH_*`) and `coords` their numbers in
+/// order: 2 for a move or line, 6 for a curve, 4 for a rect or quad and
+/// none for a close. The path is locked once for the whole list, so a
+/// binding building a large path makes one call where one per segment
+/// would otherwise cross the FFI boundary each time.
+///
+/// # Returns
+/// Number of commands appended; appending stops at the first unknown
+/// command. -1 if the path is invalid.
+///
+/// # Safety
+/// Caller must ensure `ops` holds `n` bytes and `coords` holds every
+/// number those commands consume
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_path_append_commands(
+    _ctx: Handle,
+    path: Handle,
+    ops: *const u8,
+    coords: *const f32,
+    n: i32,
+) -> i32 {
+    let Some(p) = PATHS.get(path) else {
+        return -1;
+    };
+    let Ok(mut guard) = p.lock() else {
+        return -1;
+    };
+    if ops.is_null() || n <= 0 {
+        return 0;
+    }
+    // SAFETY: caller guarantees `ops` holds `n` bytes
+    let ops = unsafe { std::slice::from_raw_parts(ops, n as usize) };
+    let needed: usize = ops
+        .iter()
+        .map_while(|&op| match op {
+            FZ_PATH_MOVETO | FZ_PATH_LINETO => Some(2),
+            FZ_PATH_CURVETO => Some(6),
+            FZ_PATH_CLOSEPATH => Some(0),
+            FZ_PATH_RECTTO | FZ_PATH_QUADTO => Some(4),
+            _ => None,
+        })
+        .sum();
+    if needed > 0 && coords.is_null() {
+        return 0;
+    }
+    let c: &[f32] = if needed == 0 {
+        &[]
+    } else {
+        // SAFETY: caller guarantees `coords` holds what the commands consume
+        unsafe { std::slice::from_raw_parts(coords, needed) }
+    };
+
+    guard.reserve(ops.len());
+    let mut i = 0;
+    let mut appended = 0;
+    for &op in ops {
+        let pt = |k: usize| Point::new(c[i + k], c[i + k + 1]);
+        match op {
+            FZ_PATH_MOVETO => guard.move_to(pt(0)),
+            FZ_PATH_LINETO => guard.line_to(pt(0)),
+            FZ_PATH_CURVETO => guard.curve_to(pt(0), pt(2), pt(4)),
+            FZ_PATH_CLOSEPATH => guard.close(),
+            FZ_PATH_RECTTO => guard.rect(Rect::new(c[i], c[i + 1], c[i + 2], c[i + 3])),
+            FZ_PATH_QUADTO => guard.quad_to(pt(0), pt(2)),
+            _ => break,
+        }
+        i += match op {
+            FZ_PATH_MOVETO | FZ_PATH_LINETO => 2,
+            FZ_PATH_CURVETO => 6,
+            FZ_PATH_CLOSEPATH => 0,
+            _ => 4,
+        };
+        appended += 1;
+    }
+    appended
+}
+
 /// Get path bounding box
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_bound_path(
@@ -516,6 +608,47 @@ mod tests {
         fz_drop_path(0, path_handle);
     }
 
+    #[test]
+    fn test_path_append_commands() {
+        let path_handle = fz_new_path(0);
+        let ops = [
+            FZ_PATH_MOVETO,
+            FZ_PATH_LINETO,
+            FZ_PATH_CURVETO,
+            FZ_PATH_CLOSEPATH,
+            FZ_PATH_RECTTO,
+            FZ_PATH_QUADTO,
+        ];
+        #[rustfmt::skip]
+        let coords = [
+            0.0, 0.0,
+            10.0, 0.0,
+            20.0, 5.0, 20.0, 15.0, 10.0, 20.0,
+            50.0, 50.0, 60.0, 70.0,
+            0.0, 0.0, -10.0, 30.0,
+        ];
+        let n = fz_path_append_commands(0, path_handle, ops.as_ptr(), coords.as_ptr(), 6);
+        assert_eq!(n, 6);
+        {
+            let path = PATHS.get(path_handle).unwrap();
+            assert_eq!(path.lock().unwrap().len(), 6);
+        }
+        let point = fz_currentpoint(0, path_handle);
+        assert!((point.x + 10.0).abs() < 0.1);
+        assert!((point.y - 30.0).abs() < 0.1);
+
+        // Appending stops at an unknown command
+        let ops = [FZ_PATH_LINETO, 99, FZ_PATH_LINETO];
+        let n = fz_path_append_commands(0, path_handle, ops.as_ptr(), coords.as_ptr(), 3);
+        assert_eq!(n, 1);
+        assert_eq!(
+            fz_path_append_commands(0, 0, ops.as_ptr(), coords.as_ptr(), 3),
+            -1
+        );
+
+        fz_drop_path(0, path_handle);
+    }
+
     #[test]
     fn test_new_stroke_state() {
         let stroke_handle = fz_new_stroke_state(0);
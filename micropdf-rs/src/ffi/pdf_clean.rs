@@ -2,8 +2,18 @@
 //!
 //! Provides PDF optimization, cleaning, linearization, and page rearrangement.
 
-use crate::ffi::Handle;
+use crate::ffi::buffered_io::{BUFFERED_WRITERS, VECTORED_WRITERS};
+use crate::ffi::cookie::COOKIES;
+use crate::ffi::output::OUTPUTS;
+use crate::ffi::pdf_linearize::linearize_document;
+use crate::ffi::pdf_optimize::optimize_document;
+use crate::ffi::pdf_page_edit::{NewPage, edit_pages};
+use crate::ffi::pdf_vectorize::vectorize_pages;
+use crate::ffi::pdf_write::{PdfSink, Queued, WriteSettings, write_document};
+use crate::ffi::{DOCUMENTS, Handle};
 use std::ffi::{CStr, CString, c_char};
+use std::fs::File;
+use std::io::{self, BufWriter, Write};
 use std::ptr;
 
 // ============================================================================
@@ -132,6 +142,9 @@ pub struct WriteOptions {
     pub compression_effort: i32,
     /// Add labels to objects
     pub do_labels: i32,
+    /// Registered dictionary Brotli streams are compressed against
+    /// (0 = none)
+    pub brotli_dictionary: u64,
 }
 
 impl Default for WriteOptions {
@@ -165,6 +178,7 @@ impl WriteOptions {
             do_use_objstms: 0,
             compression_effort: 0,
             do_labels: 0,
+            brotli_dictionary: 0,
         }
     }
 
@@ -330,6 +344,7 @@ impl CleanOptions {
         opts.write.do_compress = 1;
         opts.write.do_clean = 1;
         opts.write.do_sanitize = 1;
+        opts.write.do_use_objstms = 1;
         opts.subset_fonts = 1;
         opts
     }
@@ -421,29 +436,141 @@ pub extern "C" fn pdf_has_unsaved_sigs(_ctx: ContextHandle, _doc: DocumentHandle
     0
 }
 
+/// Write settings for `opts`, or the defaults when it is null
+fn write_settings(opts: *const WriteOptions) -> WriteSettings {
+    if opts.is_null() {
+        return WriteSettings::default();
+    }
+    // SAFETY: caller guarantees a non-null `opts` is valid
+    WriteSettings::from(unsafe { &*opts })
+}
+
+/// Rewrite document `doc` into `out`; false if it can't be read or written
+fn rewrite_document<S: PdfSink>(doc: DocumentHandle, settings: &WriteSettings, out: S) -> bool {
+    let _span = super::trace::span(c"write");
+    let Some(data) = DOCUMENTS.get(doc).map(|d| d.lock().unwrap().data()) else {
+        return false;
+    };
+    matches!(write_document(data, settings, out), Some(Ok(())))
+}
+
 /// Save document to file.
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_save_document(
-    _ctx: ContextHandle,
-    _doc: DocumentHandle,
+    ctx: ContextHandle,
+    doc: DocumentHandle,
     filename: *const c_char,
-    _opts: *const WriteOptions,
+    opts: *const WriteOptions,
 ) {
+    pdf_save_document_parallel(ctx, doc, filename, opts, 0, 0);
+}
+
+/// Save document to file, filtering streams on `threads` threads (0 = one
+/// per core) with at most `max_inflight` bytes of stream data held at once
+/// (0 = default).
+///
+/// Returns 1 on success.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_save_document_parallel(
+    _ctx: ContextHandle,
+    doc: DocumentHandle,
+    filename: *const c_char,
+    opts: *const WriteOptions,
+    threads: i32,
+    max_inflight: usize,
+) -> i32 {
     if filename.is_null() {
-        return;
+        return 0;
+    }
+    let Ok(path) = unsafe { CStr::from_ptr(filename) }.to_str() else {
+        return 0;
+    };
+    let mut settings = streaming_settings(opts, max_inflight);
+    settings.threads = usize::try_from(threads).unwrap_or(0);
+    let Ok(file) = File::create(path) else {
+        return 0;
+    };
+    i32::from(rewrite_document(doc, &settings, BufWriter::new(file)))
+}
+
+/// Write document through a buffered writer (`fz_new_buffered_writer`),
+/// streaming each object out as it is serialized. `max_inflight` caps the
+/// stream bytes held at once (0 = default, 1 = one object at a time).
+///
+/// Returns 1 on success.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_write_document_buffered(
+    _ctx: ContextHandle,
+    doc: DocumentHandle,
+    writer: Handle,
+    opts: *const WriteOptions,
+    max_inflight: usize,
+) -> i32 {
+    let Some(writer) = BUFFERED_WRITERS.get(writer) else {
+        return 0;
+    };
+    let settings = streaming_settings(opts, max_inflight);
+    let mut writer = writer.lock().unwrap();
+    i32::from(rewrite_document(doc, &settings, &mut *writer))
+}
+
+/// Write document through a vectored writer (`fz_new_vectored_writer`);
+/// stream data is queued without copying. See
+/// `pdf_write_document_buffered` for `max_inflight`.
+///
+/// Returns 1 on success.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_write_document_vectored(
+    _ctx: ContextHandle,
+    doc: DocumentHandle,
+    writer: Handle,
+    opts: *const WriteOptions,
+    max_inflight: usize,
+) -> i32 {
+    let Some(writer) = VECTORED_WRITERS.get(writer) else {
+        return 0;
+    };
+    let settings = streaming_settings(opts, max_inflight);
+    let mut writer = writer.lock().unwrap();
+    i32::from(rewrite_document(doc, &settings, Queued(&mut writer)))
+}
+
+fn streaming_settings(opts: *const WriteOptions, max_inflight: usize) -> WriteSettings {
+    let mut settings = write_settings(opts);
+    if max_inflight > 0 {
+        settings.inflight_bytes = max_inflight;
+    }
+    settings
+}
+
+/// `io::Write` over an output handle
+struct OutputWriter(OutputHandle);
+
+impl Write for OutputWriter {
+    fn write(&mut self, buf: &[u8]) -> io::Result<usize> {
+        let output = OUTPUTS
+            .get(self.0)
+            .ok_or_else(|| io::Error::new(io::ErrorKind::NotFound, "no such output"))?;
+        let mut output = output.lock().unwrap();
+        output.write_data(buf).map_err(io::Error::other)?;
+        Ok(buf.len())
+    }
+
+    fn flush(&mut self) -> io::Result<()> {
+        Ok(())
     }
-    // In a full implementation, this would write the document
 }
 
 /// Write document to output stream.
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_write_document(
     _ctx: ContextHandle,
-    _doc: DocumentHandle,
-    _out: OutputHandle,
-    _opts: *const WriteOptions,
+    doc: DocumentHandle,
+    out: OutputHandle,
+    opts: *const WriteOptions,
 ) {
-    // In a full implementation, this would write to the output stream
+    let settings = write_settings(opts);
+    rewrite_document(doc, &settings, BufWriter::new(OutputWriter(out)));
 }
 
 /// Save document snapshot.
@@ -510,30 +637,51 @@ pub extern "C" fn pdf_clean_file(
 }
 
 /// Rearrange pages in document.
+///
+/// The document keeps `pages` (0-based), in that order, under a page tree
+/// rebuilt in one pass; a page listed twice is copied, and pages not
+/// listed are dropped. Nothing changes if any index is out of range.
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_rearrange_pages(
     _ctx: ContextHandle,
-    _doc: DocumentHandle,
+    doc: DocumentHandle,
     count: i32,
     pages: *const i32,
-    _structure: CleanStructureOption,
+    structure: CleanStructureOption,
 ) {
     if count <= 0 || pages.is_null() {
         return;
     }
-    // In a full implementation, this would rearrange pages
+    let pages = unsafe { std::slice::from_raw_parts(pages, count as usize) };
+    let Ok(pages) = pages
+        .iter()
+        .map(|&p| usize::try_from(p).map(NewPage::Existing))
+        .collect::<Result<Vec<_>, _>>()
+    else {
+        return;
+    };
+    edit_pages(doc, |_| pages, structure == CleanStructureOption::Drop);
 }
 
-/// Vectorize pages in document.
+/// Vectorize pages in document: draw their text as paths.
+///
+/// `pages` lists `count` page indices; with none given every page is
+/// vectorized. Only text in fonts with drawable glyphs is converted (see
+/// `pdf_vectorize`).
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_vectorize_pages(
     _ctx: ContextHandle,
-    _doc: DocumentHandle,
-    _count: i32,
-    _pages: *const i32,
-    _vectorize: CleanVectorizeOption,
+    doc: DocumentHandle,
+    count: i32,
+    pages: *const i32,
+    vectorize: CleanVectorizeOption,
 ) {
-    // In a full implementation, this would vectorize pages
+    if vectorize == CleanVectorizeOption::No {
+        return;
+    }
+    let pages = (count > 0 && !pages.is_null())
+        .then(|| unsafe { std::slice::from_raw_parts(pages, count as usize) });
+    vectorize_pages(doc, pages, 0);
 }
 
 // ============================================================================
@@ -553,26 +701,92 @@ pub extern "C" fn pdf_clean_object_entries(_ctx: ContextHandle, _obj: Handle) {
 /// Optimize PDF (convenience function).
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_optimize(ctx: ContextHandle, doc: DocumentHandle, filename: *const c_char) {
+    pdf_optimize_with_cookie(ctx, doc, filename, 0, 0);
+}
+
+/// Optimize PDF into `filename`, cleaning page contents on `threads`
+/// threads (0 = one per core), then collecting garbage, merging
+/// duplicates and packing object streams.
+///
+/// `cookie` (0 = none) counts one step per page and one for the rewrite,
+/// and aborting it stops the optimize. Returns 0 on success, -1 on error
+/// or abort.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_optimize_with_cookie(
+    _ctx: ContextHandle,
+    doc: DocumentHandle,
+    filename: *const c_char,
+    threads: i32,
+    cookie: Handle,
+) -> i32 {
+    if filename.is_null() {
+        return -1;
+    }
+    let Ok(path) = (unsafe { CStr::from_ptr(filename) }).to_str() else {
+        return -1;
+    };
+    let Some(data) = DOCUMENTS.get(doc).map(|d| d.lock().unwrap().data()) else {
+        return -1;
+    };
+    let cookie = COOKIES.get(cookie).map(|c| c.lock().unwrap().clone());
     let opts = CleanOptions::optimize();
-    pdf_save_document(ctx, doc, filename, &opts.write);
+    let settings = WriteSettings {
+        threads: usize::try_from(threads).unwrap_or(0),
+        subset_fonts: opts.subset_fonts != 0,
+        ..WriteSettings::from(&opts.write)
+    };
+    let Ok(file) = File::create(path) else {
+        return -1;
+    };
+    match optimize_document(data, &settings, cookie.as_ref(), BufWriter::new(file)) {
+        Some(Ok(())) => 0,
+        _ => -1,
+    }
 }
 
 /// Linearize PDF (convenience function).
+///
+/// Documents the linearizer can't lay out (encrypted, or without pages)
+/// are saved with the linearize options instead.
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_linearize(ctx: ContextHandle, doc: DocumentHandle, filename: *const c_char) {
+    let path = (!filename.is_null())
+        .then(|| unsafe { CStr::from_ptr(filename) }.to_str().ok())
+        .flatten();
+    let data = DOCUMENTS.get(doc).map(|d| d.lock().unwrap().data());
+    if let (Some(path), Some(data)) = (path, data) {
+        let Ok(file) = File::create(path) else {
+            return;
+        };
+        if linearize_document(data, 0, BufWriter::new(file)).is_some() {
+            return;
+        }
+    }
     let opts = CleanOptions::linearize();
     pdf_save_document(ctx, doc, filename, &opts.write);
 }
 
 /// Compress all streams in document.
+///
+/// Uncompressed streams are deflated in parallel and the document's data
+/// is replaced by the rewritten file. Brotli isn't a PDF filter, so it
+/// falls back to zlib.
 #[unsafe(no_mangle)]
-pub extern "C" fn pdf_compress_streams(_ctx: ContextHandle, _doc: DocumentHandle, method: i32) {
-    let _compression = match method {
+pub extern "C" fn pdf_compress_streams(_ctx: ContextHandle, doc: DocumentHandle, method: i32) {
+    let compression = match method {
         1 => CompressionMethod::Zlib,
         2 => CompressionMethod::Brotli,
         _ => CompressionMethod::None,
     };
-    // In a full implementation, this would compress streams
+    if compression == CompressionMethod::None {
+        return;
+    }
+    let mut out = Vec::new();
+    if rewrite_document(doc, &WriteSettings::default(), &mut out) {
+        if let Some(d) = DOCUMENTS.get(doc) {
+            d.lock().unwrap().replace_data(out);
+        }
+    }
 }
 
 /// Decompress all streams in document.
@@ -582,9 +796,19 @@ pub extern "C" fn pdf_decompress_streams(_ctx: ContextHandle, _doc: DocumentHand
 }
 
 /// Create object streams.
+///
+/// Plain objects are packed into compressed object streams grouped by the
+/// first page that uses them, so a lazy reader opening a page inflates
+/// only that page's streams, and the xref becomes an xref stream.
 #[unsafe(no_mangle)]
-pub extern "C" fn pdf_create_object_streams(_ctx: ContextHandle, _doc: DocumentHandle) {
-    // In a full implementation, this would create object streams
+pub extern "C" fn pdf_create_object_streams(_ctx: ContextHandle, doc: DocumentHandle) {
+    rewrite_objects(
+        doc,
+        WriteSettings {
+            objstms: true,
+            ..WriteSettings::default()
+        },
+    );
 }
 
 /// Remove object streams.
@@ -593,28 +817,73 @@ pub extern "C" fn pdf_remove_object_streams(_ctx: ContextHandle, _doc: DocumentH
     // In a full implementation, this would remove object streams
 }
 
+/// Rewrite `doc` with only the objects `settings` keeps, streams as they
+/// are
+fn rewrite_objects(doc: DocumentHandle, settings: WriteSettings) {
+    let settings = WriteSettings {
+        compress: false,
+        decompress: false,
+        ..settings
+    };
+    let mut out = Vec::new();
+    if rewrite_document(doc, &settings, &mut out) {
+        if let Some(d) = DOCUMENTS.get(doc) {
+            d.lock().unwrap().replace_data(out);
+        }
+    }
+}
+
 /// Garbage collect unused objects.
+///
+/// Level 1 drops objects the trailer can't reach, 2 also renumbers the
+/// rest without gaps, and 3 also merges duplicates, like `do_garbage`.
+/// Reachability is marked on a pool of threads.
 #[unsafe(no_mangle)]
-pub extern "C" fn pdf_garbage_collect(_ctx: ContextHandle, _doc: DocumentHandle, level: i32) {
-    let _gc_level = match level {
-        1 => "collect",
-        2 => "renumber",
-        3 => "deduplicate",
-        _ => "none",
-    };
-    // In a full implementation, this would garbage collect
+pub extern "C" fn pdf_garbage_collect(_ctx: ContextHandle, doc: DocumentHandle, level: i32) {
+    if level <= 0 {
+        return;
+    }
+    rewrite_objects(
+        doc,
+        WriteSettings {
+            garbage: true,
+            renumber: level >= 2,
+            dedup: level >= 3,
+            ..WriteSettings::default()
+        },
+    );
 }
 
 /// Deduplicate objects.
+///
+/// Objects that come out byte-identical (dictionaries compared with keys
+/// sorted, streams by their raw data) are written once, and references to
+/// the copies point at the one kept. Streams are left as they are.
 #[unsafe(no_mangle)]
-pub extern "C" fn pdf_deduplicate_objects(_ctx: ContextHandle, _doc: DocumentHandle) {
-    // In a full implementation, this would deduplicate objects
+pub extern "C" fn pdf_deduplicate_objects(_ctx: ContextHandle, doc: DocumentHandle) {
+    rewrite_objects(
+        doc,
+        WriteSettings {
+            dedup: true,
+            ..WriteSettings::default()
+        },
+    );
 }
 
 /// Renumber objects.
+///
+/// Objects are numbered 1, 2, 3, ... in their current order, and every
+/// reference follows. Encrypted documents are left as they are, since
+/// their data is keyed to the object numbers.
 #[unsafe(no_mangle)]
-pub extern "C" fn pdf_renumber_objects(_ctx: ContextHandle, _doc: DocumentHandle) {
-    // In a full implementation, this would renumber objects
+pub extern "C" fn pdf_renumber_objects(_ctx: ContextHandle, doc: DocumentHandle) {
+    rewrite_objects(
+        doc,
+        WriteSettings {
+            renumber: true,
+            ..WriteSettings::default()
+        },
+    );
 }
 
 /// Remove unused resources.
@@ -751,6 +1020,7 @@ mod tests {
         assert_eq!(opts.write.do_garbage, 3);
         assert_eq!(opts.write.do_compress, 1);
         assert_eq!(opts.write.do_clean, 1);
+        assert_eq!(opts.write.do_use_objstms, 1);
         assert_eq!(opts.subset_fonts, 1);
     }
 
@@ -845,4 +1115,75 @@ mod tests {
         pdf_remove_encryption(0, &mut opts);
         assert_eq!(opts.do_encrypt, 1); // None
     }
+
+    #[test]
+    fn test_save_and_compress_rewrite_document() {
+        use crate::ffi::document::Document;
+        use crate::ffi::pdf_xref::Xref;
+        use crate::ffi::pdf_xref_lazy::tests::sample_pdf;
+        use std::sync::Arc;
+
+        let doc = DOCUMENTS.insert(Document::new(sample_pdf()));
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("out.pdf");
+        let c_path = CString::new(path.to_str().unwrap()).unwrap();
+        let mut opts = WriteOptions::new();
+        opts.do_compress = 0;
+        assert_eq!(
+            pdf_save_document_parallel(0, doc, c_path.as_ptr(), &opts, 2, 16),
+            1
+        );
+        let saved = std::fs::read(&path).unwrap();
+        let mut xref = Xref::open_lazy(0, Arc::new(saved.into())).unwrap();
+        assert_eq!(
+            xref.fetch(5).unwrap().stream.as_deref(),
+            Some(&b"BT 1 Tf ET"[..])
+        );
+
+        pdf_compress_streams(0, doc, 1);
+        let data = DOCUMENTS.get(doc).unwrap().lock().unwrap().data();
+        let mut xref = Xref::open_lazy(0, data).unwrap();
+        let contents = xref.fetch(5).unwrap();
+        assert!(contents.stream.as_deref() != Some(&b"BT 1 Tf ET"[..]));
+        DOCUMENTS.remove(doc);
+    }
+
+    #[test]
+    fn test_write_document_streams_to_writers() {
+        use crate::ffi::buffered_io::{
+            fz_drop_buffered_writer, fz_drop_vectored_writer, fz_new_buffered_writer,
+            fz_new_vectored_writer,
+        };
+        use crate::ffi::document::Document;
+        use crate::ffi::pdf_xref::Xref;
+        use crate::ffi::pdf_xref_lazy::tests::sample_pdf;
+        use std::sync::Arc;
+
+        let doc = DOCUMENTS.insert(Document::new(sample_pdf()));
+        let dir = tempfile::tempdir().unwrap();
+        let buffered = dir.path().join("buffered.pdf");
+        let vectored = dir.path().join("vectored.pdf");
+        let b_path = CString::new(buffered.to_str().unwrap()).unwrap();
+        let v_path = CString::new(vectored.to_str().unwrap()).unwrap();
+
+        let writer = fz_new_buffered_writer(0, b_path.as_ptr());
+        assert_eq!(
+            pdf_write_document_buffered(0, doc, writer, ptr::null(), 1),
+            1
+        );
+        fz_drop_buffered_writer(0, writer);
+        let writer = fz_new_vectored_writer(0, v_path.as_ptr());
+        assert_eq!(
+            pdf_write_document_vectored(0, doc, writer, ptr::null(), 1),
+            1
+        );
+        fz_drop_vectored_writer(0, writer);
+        assert_eq!(pdf_write_document_buffered(0, doc, 0, ptr::null(), 1), 0);
+
+        let a = std::fs::read(&buffered).unwrap();
+        assert_eq!(a, std::fs::read(&vectored).unwrap());
+        let mut xref = Xref::open_lazy(0, Arc::new(a.into())).unwrap();
+        assert!(xref.fetch(7).is_some());
+        DOCUMENTS.remove(doc);
+    }
 }
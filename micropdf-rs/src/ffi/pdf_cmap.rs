@@ -2,6 +2,13 @@
 //!
 //! Provides Character Map (CMap) support for PDF text encoding,
 //! including CID/Unicode mapping and vertical writing mode.
+//!
+//! Sorting a CMap compiles its ranges into a `CMapTable`, so lookups stop
+//! scanning the range lists: one- and two-byte codes are read from a
+//! two-level table and wider ones found by a search over an Eytzinger
+//! array. Built-in CMaps are static tables compiled into the library:
+//! loading one copies only its codespace, and lookups read the tables in
+//! place.
 
 use crate::ffi::{Handle, HandleStore};
 use std::collections::HashMap;
@@ -118,6 +125,11 @@ pub struct CMap {
     pub mranges: Vec<CMapMRange>,
     /// Dictionary for one-to-many lookups
     pub dict: HashMap<u32, Vec<i32>>,
+    /// Compiled range lookup, built by `sort`; `None` before then and
+    /// once a range is added
+    pub table: Option<Arc<CMapTable>>,
+    /// Static tables consulted after the CMap's own ranges
+    pub builtin: Option<&'static BuiltinCMap>,
     /// Reference count
     pub refs: i32,
 }
@@ -140,6 +152,8 @@ impl CMap {
             xranges: Vec::new(),
             mranges: Vec::new(),
             dict: HashMap::new(),
+            table: None,
+            builtin: None,
             refs: 1,
         }
     }
@@ -174,6 +188,7 @@ impl CMap {
 
     /// Map a range to another range
     pub fn map_range_to_range(&mut self, src_lo: u32, src_hi: u32, dst_lo: i32) {
+        self.table = None;
         // Use 16-bit ranges if possible
         if src_lo <= 0xFFFF && src_hi <= 0xFFFF && dst_lo >= 0 && dst_lo <= 0xFFFF {
             self.ranges.push(CMapRange {
@@ -201,28 +216,46 @@ impl CMap {
         }
     }
 
-    /// Sort the CMap for efficient lookup
+    /// Sort the CMap and compile its ranges for efficient lookup
     pub fn sort(&mut self) {
         self.ranges.sort_by_key(|r| r.low);
         self.xranges.sort_by_key(|r| r.low);
         self.mranges.sort_by_key(|r| r.low);
+        self.table = Some(Arc::new(CMapTable::compile(&self.ranges, &self.xranges)));
     }
 
-    /// Lookup a codepoint
-    pub fn lookup(&self, cpt: u32) -> i32 {
+    /// Look a codepoint up in this CMap's ranges, then its built-in ones
+    fn lookup_ranges(&self, cpt: u32) -> Option<i32> {
+        let own = match &self.table {
+            Some(table) => table.lookup(cpt),
+            None => self.scan_ranges(cpt),
+        };
+        own.or_else(|| self.builtin.and_then(|b| b.lookup(cpt)))
+    }
+
+    /// Look a codepoint up by scanning the range lists
+    fn scan_ranges(&self, cpt: u32) -> Option<i32> {
         // Check ranges first
         for range in &self.ranges {
             if cpt >= range.low as u32 && cpt <= range.high as u32 {
-                return range.out as i32 + (cpt - range.low as u32) as i32;
+                return Some(range.out as i32 + (cpt - range.low as u32) as i32);
             }
         }
 
         // Check extended ranges
         for xrange in &self.xranges {
             if cpt >= xrange.low && cpt <= xrange.high {
-                return xrange.out as i32 + (cpt - xrange.low) as i32;
+                return Some(xrange.out as i32 + (cpt - xrange.low) as i32);
             }
         }
+        None
+    }
+
+    /// Lookup a codepoint
+    pub fn lookup(&self, cpt: u32) -> i32 {
+        if let Some(out) = self.lookup_ranges(cpt) {
+            return out;
+        }
 
         // Check parent CMap
         if let Some(parent_handle) = self.usecmap {
@@ -283,6 +316,171 @@ impl CMap {
             + self.ranges.len() * std::mem::size_of::<CMapRange>()
             + self.xranges.len() * std::mem::size_of::<CMapXRange>()
             + self.mranges.len() * std::mem::size_of::<CMapMRange>()
+            + self.table.as_ref().map_or(0, |t| t.size())
+    }
+}
+
+// ============================================================================
+// Compiled Lookup
+// ============================================================================
+
+/// Entry of a compiled page with no mapping
+const UNMAPPED: i32 = i32::MIN;
+
+/// Codes mapped to consecutive outputs from `out`
+#[derive(Debug, Clone, Copy, Default)]
+struct Segment {
+    low: u32,
+    high: u32,
+    out: i32,
+}
+
+/// A CMap's ranges compiled for lookup
+///
+/// Codes up to 0xFFFF, which are all the codes of a one- or two-byte
+/// CMap, go through a two-level table: the high byte picks a page of 256
+/// outputs, and only pages some range reaches are allocated. Wider codes
+/// are found by a branch-free search of their ranges, made disjoint and
+/// laid out in Eytzinger (breadth-first) order so the first steps of
+/// every search share cache lines. Overlaps resolve as the range lists
+/// do: 16-bit ranges before extended ones, then the lowest start.
+#[derive(Debug)]
+pub struct CMapTable {
+    /// Page number + 1 for each high byte; 0 where nothing is mapped
+    directory: [u16; 256],
+    pages: Vec<[i32; 256]>,
+    /// Disjoint ranges above 0xFFFF in Eytzinger order, from index 1
+    wide: Vec<Segment>,
+}
+
+/// `ranges` clipped so none overlaps one sorted before it
+fn disjoint(mut ranges: Vec<Segment>) -> Vec<Segment> {
+    // Stable, so ranges with the same start keep the order they came in
+    ranges.sort_by_key(|r| r.low);
+    let mut out: Vec<Segment> = Vec::with_capacity(ranges.len());
+    // The range reaching furthest so far covers everything from its
+    // start, which no later start is below, to its end
+    let mut covered: Option<u32> = None;
+    for r in ranges.into_iter().filter(|r| r.low <= r.high) {
+        let low = match covered {
+            Some(end) if end >= r.high => continue,
+            Some(end) if end >= r.low => end + 1,
+            _ => r.low,
+        };
+        out.push(Segment {
+            low,
+            high: r.high,
+            out: r.out.wrapping_add((low - r.low) as i32),
+        });
+        covered = Some(r.high);
+    }
+    out
+}
+
+/// Fill `tree[k..]` with the in-order run of `sorted` from `*next`
+fn eytzinger(sorted: &[Segment], tree: &mut [Segment], next: &mut usize, k: usize) {
+    if k < tree.len() {
+        eytzinger(sorted, tree, next, 2 * k);
+        tree[k] = sorted[*next];
+        *next += 1;
+        eytzinger(sorted, tree, next, 2 * k + 1);
+    }
+}
+
+impl CMapTable {
+    /// Compile sorted or unsorted range lists
+    pub fn compile(ranges: &[CMapRange], xranges: &[CMapXRange]) -> Self {
+        let narrow = disjoint(
+            ranges
+                .iter()
+                .map(|r| Segment {
+                    low: r.low as u32,
+                    high: r.high as u32,
+                    out: r.out as i32,
+                })
+                .collect(),
+        );
+        let extended = disjoint(
+            xranges
+                .iter()
+                .map(|r| Segment {
+                    low: r.low,
+                    high: r.high,
+                    out: r.out as i32,
+                })
+                .collect(),
+        );
+
+        let mut table = Self {
+            directory: [0; 256],
+            pages: Vec::new(),
+            wide: Vec::new(),
+        };
+        // 16-bit ranges are written last, over extended ones
+        for seg in extended.iter().chain(&narrow) {
+            for code in seg.low..=seg.high.min(0xFFFF) {
+                let out = seg.out.wrapping_add((code - seg.low) as i32);
+                table.page_mut(code >> 8)[(code & 0xFF) as usize] = out;
+            }
+        }
+
+        let wide: Vec<Segment> = extended
+            .iter()
+            .filter(|seg| seg.high > 0xFFFF)
+            .map(|seg| {
+                let low = seg.low.max(0x10000);
+                Segment {
+                    low,
+                    high: seg.high,
+                    out: seg.out.wrapping_add((low - seg.low) as i32),
+                }
+            })
+            .collect();
+        if !wide.is_empty() {
+            table.wide = vec![Segment::default(); wide.len() + 1];
+            eytzinger(&wide, &mut table.wide, &mut 0, 1);
+        }
+        table
+    }
+
+    fn page_mut(&mut self, high: u32) -> &mut [i32; 256] {
+        let slot = &mut self.directory[high as usize];
+        if *slot == 0 {
+            self.pages.push([UNMAPPED; 256]);
+            *slot = self.pages.len() as u16;
+        }
+        &mut self.pages[*slot as usize - 1]
+    }
+
+    /// The output for `cpt`, or `None` if no range maps it
+    #[inline]
+    pub fn lookup(&self, cpt: u32) -> Option<i32> {
+        if cpt <= 0xFFFF {
+            let page = self.directory[(cpt >> 8) as usize];
+            if page == 0 {
+                return None;
+            }
+            let out = self.pages[page as usize - 1][(cpt & 0xFF) as usize];
+            return (out != UNMAPPED).then_some(out);
+        }
+
+        // First range ending at or after `cpt`: descend without branching
+        // on the comparison, then drop the right turns taken past it
+        let n = self.wide.len();
+        let mut k = 1;
+        while k < n {
+            k = 2 * k + (self.wide[k].high < cpt) as usize;
+        }
+        k >>= k.trailing_ones() + 1;
+        let seg = self.wide.get(k).filter(|_| k > 0)?;
+        (seg.low <= cpt).then(|| seg.out.wrapping_add((cpt - seg.low) as i32))
+    }
+
+    /// Memory used by the table
+    pub fn size(&self) -> usize {
+        std::mem::size_of::<Self>()
+            + self.pages.len() * std::mem::size_of::<[i32; 256]>()
+            + self.wide.len() * std::mem::size_of::<Segment>()
     }
 }
 
@@ -323,111 +521,224 @@ impl CMap {
 // Built-in CMaps
 // ============================================================================
 
-/// Built-in CMap registry
-#[derive(Debug, Default)]
-pub struct CMapRegistry {
-    cmaps: HashMap<String, CMap>,
+/// Deepest chain of built-in usecmaps followed
+const MAX_USECMAP_DEPTH: usize = 8;
+
+/// A CMap compiled into the library
+///
+/// The codespace and ranges are static tables in read-only data, so
+/// loading one parses nothing and lookups run on the tables in place.
+/// Ranges are sorted and disjoint, which is checked at compile time.
+#[derive(Debug)]
+pub struct BuiltinCMap {
+    pub name: &'static str,
+    pub wmode: WritingMode,
+    /// Built-in CMap consulted for codes this one doesn't map
+    pub usecmap: Option<&'static str>,
+    /// Codespace ranges; empty to use the usecmap's
+    pub codespace: &'static [CodespaceEntry],
+    pub ranges: &'static [CMapXRange],
 }
 
-impl CMapRegistry {
-    pub fn new() -> Self {
-        let mut registry = Self {
-            cmaps: HashMap::new(),
-        };
-        registry.register_builtin_cmaps();
-        registry
-    }
+const fn codespace(n: i32, low: u32, high: u32) -> CodespaceEntry {
+    CodespaceEntry { n, low, high }
+}
 
-    fn register_builtin_cmaps(&mut self) {
-        // Identity CMaps
-        self.cmaps.insert(
-            "Identity-H".to_string(),
-            CMap::identity(WritingMode::Horizontal, 2),
-        );
-        self.cmaps.insert(
-            "Identity-V".to_string(),
-            CMap::identity(WritingMode::Vertical, 2),
-        );
+/// Printable ASCII to CIDs 1-95, as the Adobe character collections have it
+const ASCII_CIDS: &[CMapXRange] = &[CMapXRange {
+    low: 0x20,
+    high: 0x7E,
+    out: 1,
+}];
+
+const TWO_BYTE: &[CodespaceEntry] = &[codespace(2, 0x0000, 0xFFFF)];
+
+/// The built-in CMaps, sorted by name (simplified versions)
+const BUILTIN_CMAPS: &[BuiltinCMap] = &[
+    // Shift-JIS to CID
+    BuiltinCMap {
+        name: "90ms-RKSJ-H",
+        wmode: WritingMode::Horizontal,
+        usecmap: None,
+        codespace: &[
+            codespace(1, 0x00, 0x80),
+            codespace(1, 0xA0, 0xDF),
+            codespace(2, 0x8140, 0x9FFC),
+            codespace(2, 0xE040, 0xFCFC),
+        ],
+        ranges: ASCII_CIDS,
+    },
+    BuiltinCMap {
+        name: "90ms-RKSJ-V",
+        wmode: WritingMode::Vertical,
+        usecmap: Some("90ms-RKSJ-H"),
+        codespace: &[],
+        ranges: &[],
+    },
+    // Big5 to CID
+    BuiltinCMap {
+        name: "B5pc-H",
+        wmode: WritingMode::Horizontal,
+        usecmap: None,
+        codespace: &[codespace(1, 0x00, 0x80), codespace(2, 0xA140, 0xFEFE)],
+        ranges: ASCII_CIDS,
+    },
+    // GBK to CID
+    BuiltinCMap {
+        name: "GBK-EUC-H",
+        wmode: WritingMode::Horizontal,
+        usecmap: None,
+        codespace: &[codespace(1, 0x00, 0x80), codespace(2, 0x8140, 0xFEFE)],
+        ranges: ASCII_CIDS,
+    },
+    BuiltinCMap {
+        name: "Identity-H",
+        wmode: WritingMode::Horizontal,
+        usecmap: None,
+        codespace: TWO_BYTE,
+        ranges: &[],
+    },
+    BuiltinCMap {
+        name: "Identity-V",
+        wmode: WritingMode::Vertical,
+        usecmap: None,
+        codespace: TWO_BYTE,
+        ranges: &[],
+    },
+    // UHC to CID
+    BuiltinCMap {
+        name: "KSCms-UHC-H",
+        wmode: WritingMode::Horizontal,
+        usecmap: None,
+        codespace: &[codespace(1, 0x00, 0x80), codespace(2, 0x8141, 0xFEFE)],
+        ranges: ASCII_CIDS,
+    },
+    BuiltinCMap {
+        name: "UniCNS-UTF16-H",
+        wmode: WritingMode::Horizontal,
+        usecmap: None,
+        codespace: TWO_BYTE,
+        ranges: &[],
+    },
+    BuiltinCMap {
+        name: "UniGB-UTF16-H",
+        wmode: WritingMode::Horizontal,
+        usecmap: None,
+        codespace: TWO_BYTE,
+        ranges: &[],
+    },
+    BuiltinCMap {
+        name: "UniJIS-UTF16-H",
+        wmode: WritingMode::Horizontal,
+        usecmap: None,
+        codespace: TWO_BYTE,
+        ranges: &[],
+    },
+    BuiltinCMap {
+        name: "UniJIS-UTF16-V",
+        wmode: WritingMode::Vertical,
+        usecmap: Some("UniJIS-UTF16-H"),
+        codespace: &[],
+        ranges: &[],
+    },
+    BuiltinCMap {
+        name: "UniKS-UTF16-H",
+        wmode: WritingMode::Horizontal,
+        usecmap: None,
+        codespace: TWO_BYTE,
+        ranges: &[],
+    },
+];
+
+const fn name_before(a: &[u8], b: &[u8]) -> bool {
+    let mut i = 0;
+    while i < a.len() && i < b.len() {
+        if a[i] != b[i] {
+            return a[i] < b[i];
+        }
+        i += 1;
+    }
+    a.len() < b.len()
+}
 
-        // Adobe standard CMaps (simplified versions)
-        self.register_adobe_japan1();
-        self.register_adobe_gb1();
-        self.register_adobe_cns1();
-        self.register_adobe_korea1();
+/// Whether `cmaps` are sorted by name, with sorted and disjoint ranges
+const fn well_formed(cmaps: &[BuiltinCMap]) -> bool {
+    let mut i = 0;
+    while i < cmaps.len() {
+        if i > 0 && !name_before(cmaps[i - 1].name.as_bytes(), cmaps[i].name.as_bytes()) {
+            return false;
+        }
+        let ranges = cmaps[i].ranges;
+        let mut j = 0;
+        while j < ranges.len() {
+            if ranges[j].low > ranges[j].high || j > 0 && ranges[j - 1].high >= ranges[j].low {
+                return false;
+            }
+            j += 1;
+        }
+        i += 1;
     }
+    true
+}
 
-    fn register_adobe_japan1(&mut self) {
-        // 90ms-RKSJ-H - Shift-JIS to CID
-        let mut cmap = CMap::with_name("90ms-RKSJ-H");
-        cmap.add_codespace(0x00, 0x80, 1);
-        cmap.add_codespace(0xA0, 0xDF, 1);
-        cmap.add_codespace(0x8140, 0x9FFC, 2);
-        cmap.add_codespace(0xE040, 0xFCFC, 2);
-        cmap.map_range_to_range(0x20, 0x7E, 1); // ASCII
-        self.cmaps.insert("90ms-RKSJ-H".to_string(), cmap);
-
-        // 90ms-RKSJ-V
-        let mut cmap = CMap::with_name("90ms-RKSJ-V");
-        cmap.wmode = WritingMode::Vertical;
-        cmap.usecmap_name = Some("90ms-RKSJ-H".to_string());
-        self.cmaps.insert("90ms-RKSJ-V".to_string(), cmap);
-
-        // UniJIS-UTF16-H
-        let mut cmap = CMap::with_name("UniJIS-UTF16-H");
-        cmap.add_codespace(0x0000, 0xFFFF, 2);
-        self.cmaps.insert("UniJIS-UTF16-H".to_string(), cmap);
-
-        // UniJIS-UTF16-V
-        let mut cmap = CMap::with_name("UniJIS-UTF16-V");
-        cmap.wmode = WritingMode::Vertical;
-        cmap.usecmap_name = Some("UniJIS-UTF16-H".to_string());
-        self.cmaps.insert("UniJIS-UTF16-V".to_string(), cmap);
-    }
-
-    fn register_adobe_gb1(&mut self) {
-        // GBK-EUC-H - GBK to CID
-        let mut cmap = CMap::with_name("GBK-EUC-H");
-        cmap.add_codespace(0x00, 0x80, 1);
-        cmap.add_codespace(0x8140, 0xFEFE, 2);
-        cmap.map_range_to_range(0x20, 0x7E, 1);
-        self.cmaps.insert("GBK-EUC-H".to_string(), cmap);
+const _: () = assert!(
+    well_formed(BUILTIN_CMAPS),
+    "built-in CMaps must be sorted, with disjoint ranges"
+);
+
+/// The built-in CMap called `name`
+pub fn builtin_cmap(name: &str) -> Option<&'static BuiltinCMap> {
+    let found = BUILTIN_CMAPS.binary_search_by(|c| c.name.cmp(name)).ok()?;
+    Some(&BUILTIN_CMAPS[found])
+}
 
-        // UniGB-UTF16-H
-        let mut cmap = CMap::with_name("UniGB-UTF16-H");
-        cmap.add_codespace(0x0000, 0xFFFF, 2);
-        self.cmaps.insert("UniGB-UTF16-H".to_string(), cmap);
+impl BuiltinCMap {
+    /// This CMap and the built-in CMaps it uses, nearest first
+    fn chain(&'static self) -> impl Iterator<Item = &'static BuiltinCMap> {
+        std::iter::successors(Some(self), |c| c.usecmap.and_then(builtin_cmap))
+            .take(MAX_USECMAP_DEPTH)
     }
 
-    fn register_adobe_cns1(&mut self) {
-        // B5pc-H - Big5 to CID
-        let mut cmap = CMap::with_name("B5pc-H");
-        cmap.add_codespace(0x00, 0x80, 1);
-        cmap.add_codespace(0xA140, 0xFEFE, 2);
-        cmap.map_range_to_range(0x20, 0x7E, 1);
-        self.cmaps.insert("B5pc-H".to_string(), cmap);
+    /// The output for `cpt` from these ranges or a usecmap's
+    pub fn lookup(&'static self, cpt: u32) -> Option<i32> {
+        self.chain().find_map(|c| {
+            let range = c.ranges.get(c.ranges.partition_point(|r| r.high < cpt))?;
+            (range.low <= cpt).then(|| range.out.wrapping_add(cpt - range.low) as i32)
+        })
+    }
 
-        // UniCNS-UTF16-H
-        let mut cmap = CMap::with_name("UniCNS-UTF16-H");
-        cmap.add_codespace(0x0000, 0xFFFF, 2);
-        self.cmaps.insert("UniCNS-UTF16-H".to_string(), cmap);
+    /// The codespace, or the nearest usecmap's if this has none
+    pub fn codespace(&'static self) -> &'static [CodespaceEntry] {
+        self.chain()
+            .map(|c| c.codespace)
+            .find(|cs| !cs.is_empty())
+            .unwrap_or_default()
     }
+}
 
-    fn register_adobe_korea1(&mut self) {
-        // KSCms-UHC-H - UHC to CID
-        let mut cmap = CMap::with_name("KSCms-UHC-H");
-        cmap.add_codespace(0x00, 0x80, 1);
-        cmap.add_codespace(0x8141, 0xFEFE, 2);
-        cmap.map_range_to_range(0x20, 0x7E, 1);
-        self.cmaps.insert("KSCms-UHC-H".to_string(), cmap);
+impl CMap {
+    /// A CMap backed by the static tables of `builtin`
+    pub fn from_builtin(builtin: &'static BuiltinCMap) -> Self {
+        let mut cmap = Self::with_name(builtin.name);
+        cmap.wmode = builtin.wmode;
+        cmap.usecmap_name = builtin.usecmap.map(str::to_string);
+        cmap.codespace = builtin.codespace().to_vec();
+        cmap.builtin = Some(builtin);
+        cmap
+    }
+}
 
-        // UniKS-UTF16-H
-        let mut cmap = CMap::with_name("UniKS-UTF16-H");
-        cmap.add_codespace(0x0000, 0xFFFF, 2);
-        self.cmaps.insert("UniKS-UTF16-H".to_string(), cmap);
+/// Built-in CMap registry, over the tables compiled into the library
+#[derive(Debug, Default, Clone, Copy)]
+pub struct CMapRegistry;
+
+impl CMapRegistry {
+    pub fn new() -> Self {
+        Self
     }
 
-    pub fn get(&self, name: &str) -> Option<&CMap> {
-        self.cmaps.get(name)
+    pub fn get(&self, name: &str) -> Option<&'static BuiltinCMap> {
+        builtin_cmap(name)
     }
 }
 
@@ -436,7 +747,7 @@ impl CMapRegistry {
 // ============================================================================
 
 pub static CMAPS: LazyLock<HandleStore<CMap>> = LazyLock::new(HandleStore::new);
-pub static CMAP_REGISTRY: LazyLock<CMapRegistry> = LazyLock::new(CMapRegistry::new);
+pub static CMAP_REGISTRY: CMapRegistry = CMapRegistry;
 
 // ============================================================================
 // FFI Functions - CMap Lifecycle
@@ -714,8 +1025,8 @@ pub extern "C" fn pdf_load_builtin_cmap(_ctx: ContextHandle, name: *const c_char
     }
 
     let name_str = unsafe { CStr::from_ptr(name).to_str().unwrap_or("") };
-    if let Some(cmap) = CMAP_REGISTRY.get(name_str) {
-        return CMAPS.insert(cmap.clone());
+    if let Some(builtin) = CMAP_REGISTRY.get(name_str) {
+        return CMAPS.insert(CMap::from_builtin(builtin));
     }
 
     0
@@ -756,7 +1067,7 @@ pub extern "C" fn pdf_load_embedded_cmap(
 pub extern "C" fn pdf_cmap_range_count(_ctx: ContextHandle, cmap: Handle) -> i32 {
     if let Some(cmap_arc) = CMAPS.get(cmap) {
         let c = cmap_arc.lock().unwrap();
-        return c.ranges.len() as i32;
+        return (c.ranges.len() + c.builtin.map_or(0, |b| b.ranges.len())) as i32;
     }
     0
 }
@@ -927,6 +1238,71 @@ mod tests {
         assert_eq!(cmap.ranges[2].low, 0x80);
     }
 
+    #[test]
+    fn test_compiled_lookup_matches_range_scan() {
+        let mut seed = 12345u32;
+        let mut next = |limit: u32| {
+            seed = seed.wrapping_mul(1103515245).wrapping_add(12345);
+            (seed >> 8) % limit
+        };
+        let mut scanned = CMap::new();
+        for _ in 0..300 {
+            let low = next(0x1_2000);
+            let high = low + next(0x300);
+            scanned.map_range_to_range(low, high, next(20000) as i32);
+        }
+        // Overlapping 16-bit and extended ranges, and one across 0xFFFF
+        scanned.map_range_to_range(0x40, 0x60, 7);
+        scanned.map_range_to_range(0x30, 0x50, 9);
+        scanned.map_range_to_range(0xFF00, 0x1_0100, 70000);
+
+        let mut compiled = scanned.clone();
+        compiled.sort();
+        scanned.ranges.sort_by_key(|r| r.low);
+        scanned.xranges.sort_by_key(|r| r.low);
+        assert!(compiled.table.is_some() && scanned.table.is_none());
+        for cpt in (0..0x1_3000).chain([u32::MAX, 0x7FFF_FFFF]) {
+            assert_eq!(
+                compiled.lookup_ranges(cpt),
+                scanned.lookup_ranges(cpt),
+                "code {cpt:#x}"
+            );
+        }
+
+        // Adding a range drops the table until the next sort
+        compiled.map_range_to_range(0x1_2F00, 0x1_2F00, 5);
+        assert!(compiled.table.is_none());
+        assert_eq!(compiled.lookup(0x1_2F00), 5);
+    }
+
+    #[test]
+    fn test_builtin_cmaps_read_static_tables() {
+        let name = CString::new("90ms-RKSJ-V").unwrap();
+        let a = pdf_load_builtin_cmap(0, name.as_ptr());
+        let b = pdf_load_builtin_cmap(0, name.as_ptr());
+        let (a_arc, b_arc) = (CMAPS.get(a).unwrap(), CMAPS.get(b).unwrap());
+        let (a_builtin, b_builtin) = (
+            a_arc.lock().unwrap().builtin.unwrap(),
+            b_arc.lock().unwrap().builtin.unwrap(),
+        );
+        assert!(std::ptr::eq(a_builtin, b_builtin));
+
+        // The vertical CMap takes its codespace and ranges from its usecmap
+        assert_eq!(pdf_cmap_wmode(0, a), 1);
+        assert_eq!(pdf_cmap_codespace_len(0, a), 4);
+        assert_eq!(pdf_lookup_cmap(a, 0x41), 0x41 - 0x20 + 1);
+        assert_eq!(pdf_lookup_cmap(a, 0x8140), 0x8140);
+        let mut cpt = 0;
+        let code = [0x82u8, 0xA0];
+        let used = pdf_decode_cmap(a, code.as_ptr(), code.as_ptr_range().end, &mut cpt);
+        assert_eq!((used, cpt), (2, 0x82A0));
+        pdf_drop_cmap(0, a);
+        pdf_drop_cmap(0, b);
+
+        assert!(builtin_cmap("Identity-V").is_some());
+        assert!(builtin_cmap("Identity").is_none());
+    }
+
     #[test]
     fn test_ffi_lifecycle() {
         let ctx = 0;
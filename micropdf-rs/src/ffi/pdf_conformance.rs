@@ -3,10 +3,21 @@
 //! This module provides validation for PDF/A, PDF/X, and PDF 2.0 conformance.
 //! PDF/A is for archival, PDF/X is for print exchange, PDF 2.0 is the latest standard.
 
-use std::ffi::{CString, c_char, c_int};
-use std::sync::LazyLock;
-
-use crate::ffi::{Handle, HandleStore};
+use std::borrow::Cow;
+use std::ffi::{CString, c_char, c_int, c_void};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{LazyLock, mpsc};
+
+use crate::ffi::band_writer::SendPtr;
+use crate::ffi::pdf_form_fill::text_string;
+use crate::ffi::pdf_gc::sweep;
+use crate::ffi::pdf_page_tree::PageIndex;
+use crate::ffi::pdf_parse::ParsedValue;
+use crate::ffi::pdf_stream_prefetch::parallel_map;
+use crate::ffi::pdf_write::open_source;
+use crate::ffi::pdf_xref::Xref;
+use crate::ffi::pdf_xref_lazy::{as_ref, decode_stream, dict_get, header_version, is_name};
+use crate::ffi::{DOCUMENTS, Handle, HandleStore};
 
 // ============================================================================
 // Handle Management
@@ -54,6 +65,23 @@ pub enum PdfALevel {
 }
 
 impl PdfALevel {
+    pub fn from_i32(value: i32) -> Self {
+        match value {
+            1 => PdfALevel::A1a,
+            2 => PdfALevel::A1b,
+            3 => PdfALevel::A2a,
+            4 => PdfALevel::A2b,
+            5 => PdfALevel::A2u,
+            6 => PdfALevel::A3a,
+            7 => PdfALevel::A3b,
+            8 => PdfALevel::A3u,
+            9 => PdfALevel::A4,
+            10 => PdfALevel::A4e,
+            11 => PdfALevel::A4f,
+            _ => PdfALevel::None,
+        }
+    }
+
     /// Get the ISO standard number
     pub fn iso_standard(&self) -> &'static str {
         match self {
@@ -117,6 +145,24 @@ pub enum PdfXLevel {
 }
 
 impl PdfXLevel {
+    pub fn from_i32(value: i32) -> Self {
+        match value {
+            1 => PdfXLevel::X1a2001,
+            2 => PdfXLevel::X1a2003,
+            3 => PdfXLevel::X32002,
+            4 => PdfXLevel::X32003,
+            5 => PdfXLevel::X4,
+            6 => PdfXLevel::X4p,
+            7 => PdfXLevel::X5g,
+            8 => PdfXLevel::X5n,
+            9 => PdfXLevel::X5pg,
+            10 => PdfXLevel::X6,
+            11 => PdfXLevel::X6n,
+            12 => PdfXLevel::X6p,
+            _ => PdfXLevel::None,
+        }
+    }
+
     /// Get the ISO standard number
     pub fn iso_standard(&self) -> &'static str {
         match self {
@@ -178,6 +224,22 @@ pub enum PdfVersion {
 }
 
 impl PdfVersion {
+    /// Version from major * 10 + minor, as `%PDF-M.m` headers give it
+    pub fn from_i32(value: i32) -> Self {
+        match value {
+            10 => PdfVersion::V1_0,
+            11 => PdfVersion::V1_1,
+            12 => PdfVersion::V1_2,
+            13 => PdfVersion::V1_3,
+            14 => PdfVersion::V1_4,
+            15 => PdfVersion::V1_5,
+            16 => PdfVersion::V1_6,
+            17 => PdfVersion::V1_7,
+            20 => PdfVersion::V2_0,
+            _ => PdfVersion::Unknown,
+        }
+    }
+
     /// Get version string
     pub fn version_string(&self) -> &'static str {
         match self {
@@ -353,6 +415,8 @@ pub struct ValidatorConfig {
     pub stop_on_error: bool,
     /// Maximum issues to report
     pub max_issues: usize,
+    /// Threads checking objects (0 = one per core)
+    pub threads: usize,
 }
 
 impl Default for ValidatorConfig {
@@ -363,16 +427,492 @@ impl Default for ValidatorConfig {
             check_pdf2: true,
             stop_on_error: false,
             max_issues: 1000,
+            threads: 0,
         }
     }
 }
 
+/// Receives each issue as the validator finds it
+///
+/// `code` and `message` are only valid during the call, which is made on
+/// the validating thread with the validator locked. Return 0 to continue,
+/// anything else to stop validating.
+pub type FzConformanceIssueCallback = Option<
+    unsafe extern "C" fn(
+        opaque: *mut c_void,
+        severity: c_int,
+        code: *const c_char,
+        message: *const c_char,
+        page: c_int,
+        object: c_int,
+    ) -> c_int,
+>;
+
 /// PDF conformance validator
 pub struct ConformanceValidator {
     /// Configuration
     config: ValidatorConfig,
     /// Current validation result
     result: ValidationResult,
+    /// Document to validate (0 = none)
+    document: Handle,
+    /// Where issues stream to as they are found
+    callback: FzConformanceIssueCallback,
+    opaque: SendPtr,
+}
+
+/// Which standard a scan checks
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum Standard {
+    PdfA,
+    PdfX,
+    Pdf2,
+}
+
+/// Object numbers one scan task checks
+const SCAN_CHUNK: usize = 256;
+
+/// Deepest nesting of direct dictionaries and arrays checked in an object
+const MAX_INLINE_DEPTH: usize = 16;
+
+/// A document opened for validation
+///
+/// All xref sections are read and object streams decompressed up front,
+/// so object checks only read the xref and can share it across threads.
+struct OpenedDocument {
+    xref: Xref,
+    trailer: ParsedValue,
+    catalog: ParsedValue,
+    index: PageIndex,
+    /// In-use object numbers
+    nums: Vec<i32>,
+    version: PdfVersion,
+    /// The catalog's XMP metadata packet, decoded
+    xmp: Option<String>,
+    /// Whether there is a PDF/A output intent for device colour to refer to
+    pdfa_intent: bool,
+}
+
+impl OpenedDocument {
+    fn open(doc: Handle, threads: usize) -> Option<Self> {
+        let data = DOCUMENTS.get(doc)?.lock().ok()?.data();
+        let mut xref = open_source(&data, threads)?;
+        xref.read_all_sections();
+        xref.prefetch_objstms(threads);
+        let index = PageIndex::read(&mut xref, threads).unwrap_or_default();
+        let trailer = xref.source_trailer()?.clone();
+        let catalog = dict_get(&trailer, "Root")
+            .and_then(as_ref)
+            .and_then(|num| xref.peek_value(num))?;
+        let nums = sweep(&xref, None, threads);
+        let xmp = dict_get(&catalog, "Metadata")
+            .and_then(as_ref)
+            .and_then(|num| xref.fetch(num))
+            .and_then(|f| decode_stream(&f.value, f.stream.as_deref()?))
+            .map(|data| String::from_utf8_lossy(&data).into_owned());
+
+        // The catalog's /Version overrides the header when it is later
+        let header = header_version(&data).unwrap_or(0);
+        let catalog_version = match dict_get(&catalog, "Version") {
+            Some(ParsedValue::Name(v)) => match v.as_bytes() {
+                [major @ b'0'..=b'9', b'.', minor @ b'0'..=b'9'] => {
+                    i32::from(major - b'0') * 10 + i32::from(minor - b'0')
+                }
+                _ => 0,
+            },
+            _ => 0,
+        };
+        let version = PdfVersion::from_i32(header.max(catalog_version));
+        let mut doc = Self {
+            xref,
+            trailer,
+            catalog,
+            index,
+            nums,
+            version,
+            xmp,
+            pdfa_intent: false,
+        };
+        doc.pdfa_intent = doc.has_output_intent("GTS_PDFA1");
+        Some(doc)
+    }
+
+    /// `value`, or the object it refers to
+    fn resolve<'a>(&self, value: &'a ParsedValue) -> Option<Cow<'a, ParsedValue>> {
+        match as_ref(value) {
+            Some(num) => self.xref.peek_value(num).map(Cow::Owned),
+            None => Some(Cow::Borrowed(value)),
+        }
+    }
+
+    /// Entry `key` of `dict`, resolved
+    fn get<'a>(&self, dict: &'a ParsedValue, key: &str) -> Option<Cow<'a, ParsedValue>> {
+        self.resolve(dict_get(dict, key)?)
+    }
+
+    fn info(&self) -> ParsedValue {
+        self.get(&self.trailer, "Info")
+            .map_or(ParsedValue::Null, Cow::into_owned)
+    }
+
+    /// Whether the catalog has an output intent of subtype `subtype`
+    fn has_output_intent(&self, subtype: &str) -> bool {
+        let Some(intents) = self.get(&self.catalog, "OutputIntents") else {
+            return false;
+        };
+        let ParsedValue::Array(intents) = &*intents else {
+            return false;
+        };
+        intents
+            .iter()
+            .filter_map(|intent| self.resolve(intent))
+            .any(|intent| is_name(dict_get(&intent, "S"), subtype))
+    }
+}
+
+/// Value of an XMP property, written as an attribute or an element
+fn xmp_property(xmp: &str, name: &str) -> Option<String> {
+    let at = xmp.find(name)?;
+    let rest = xmp[at + name.len()..].trim_start();
+    let value = if let Some(rest) = rest.strip_prefix('=') {
+        let rest = rest.trim_start();
+        let quote = rest.chars().next().filter(|&q| q == '"' || q == '\'')?;
+        let rest = &rest[1..];
+        &rest[..rest.find(quote)?]
+    } else {
+        let rest = rest.strip_prefix('>')?;
+        &rest[..rest.find('<')?]
+    };
+    Some(value.trim().to_string())
+}
+
+/// PDF/A level from the XMP identification schema
+fn pdfa_claim(xmp: &str) -> PdfALevel {
+    let part = xmp_property(xmp, "pdfaid:part");
+    let conformance = xmp_property(xmp, "pdfaid:conformance").unwrap_or_default();
+    match (part.as_deref(), conformance.to_ascii_uppercase().as_str()) {
+        (Some("1"), "A") => PdfALevel::A1a,
+        (Some("1"), "B") => PdfALevel::A1b,
+        (Some("2"), "A") => PdfALevel::A2a,
+        (Some("2"), "B") => PdfALevel::A2b,
+        (Some("2"), "U") => PdfALevel::A2u,
+        (Some("3"), "A") => PdfALevel::A3a,
+        (Some("3"), "B") => PdfALevel::A3b,
+        (Some("3"), "U") => PdfALevel::A3u,
+        (Some("4"), "E") => PdfALevel::A4e,
+        (Some("4"), "F") => PdfALevel::A4f,
+        (Some("4"), _) => PdfALevel::A4,
+        _ => PdfALevel::None,
+    }
+}
+
+/// PDF/X level named by a `GTS_PDFXVersion` value
+fn pdfx_claim(version: &str) -> PdfXLevel {
+    (1..=12)
+        .map(PdfXLevel::from_i32)
+        .find(|level| level.short_name() == version.trim())
+        .unwrap_or(PdfXLevel::None)
+}
+
+fn as_number(value: &ParsedValue) -> Option<f32> {
+    match value {
+        ParsedValue::Int(i) => Some(*i as f32),
+        ParsedValue::Real(r) => Some(*r),
+        _ => None,
+    }
+}
+
+/// A rectangle array, normalized so x0 <= x1 and y0 <= y1
+fn as_rect(value: &ParsedValue) -> Option<[f32; 4]> {
+    let ParsedValue::Array(items) = value else {
+        return None;
+    };
+    let [x0, y0, x1, y1] = items.as_slice() else {
+        return None;
+    };
+    let [x0, y0, x1, y1] = [x0, y0, x1, y1].map(as_number);
+    let (x0, y0, x1, y1) = (x0?, y0?, x1?, y1?);
+    Some([x0.min(x1), y0.min(y1), x0.max(x1), y0.max(y1)])
+}
+
+/// Whether a stream's /Filter names `filter`
+fn has_filter(value: &ParsedValue, filter: &str) -> bool {
+    match dict_get(value, "Filter") {
+        Some(ParsedValue::Name(name)) => name == filter,
+        Some(ParsedValue::Array(names)) => names
+            .iter()
+            .any(|n| matches!(n, ParsedValue::Name(name) if name == filter)),
+        _ => false,
+    }
+}
+
+/// The device colour space `space` is or is based on, if any
+fn device_space(doc: &OpenedDocument, space: &ParsedValue) -> Option<&'static str> {
+    let space = doc.resolve(space)?;
+    match &*space {
+        ParsedValue::Name(name) => ["DeviceGray", "DeviceRGB", "DeviceCMYK"]
+            .into_iter()
+            .find(|d| name == d),
+        ParsedValue::Array(items) => match items.as_slice() {
+            [ParsedValue::Name(family), base, ..] if family == "Indexed" => device_space(doc, base),
+            _ => None,
+        },
+        _ => None,
+    }
+}
+
+/// Check one object against `standard`, passing each issue to `emit`
+/// until it returns false
+///
+/// Dictionaries held directly in the object (inline resources, graphics
+/// states and actions) are checked as part of it.
+fn check_object(
+    doc: &OpenedDocument,
+    standard: Standard,
+    pdfa1: bool,
+    num: i32,
+    value: &ParsedValue,
+    emit: &mut dyn FnMut(ValidationIssue) -> bool,
+) -> bool {
+    // Page boxes: PDF/X needs a trim or art box inside the media box
+    if let Some(page) = doc.index.page_number(num) {
+        if standard == Standard::PdfX {
+            let media = doc
+                .index
+                .page(page)
+                .and_then(|p| {
+                    dict_get(value, "MediaBox").or_else(|| {
+                        p.inherited
+                            .iter()
+                            .find(|(k, _)| k == "MediaBox")
+                            .map(|(_, v)| v)
+                    })
+                })
+                .and_then(|v| doc.resolve(v))
+                .and_then(|v| as_rect(&v));
+            let trim = ["TrimBox", "ArtBox"]
+                .iter()
+                .find_map(|k| doc.get(value, k))
+                .and_then(|v| as_rect(&v));
+            let page_issue = |code: &str, message: &str| {
+                ValidationIssue::new(IssueSeverity::Error, code, message)
+                    .with_page(page as i32 + 1)
+                    .with_object(num)
+            };
+            let found = match (trim, media) {
+                (None, _) => Some(page_issue(
+                    "PDFX_TRIMBOX_MISSING",
+                    "Page has neither a TrimBox nor an ArtBox",
+                )),
+                (Some(t), Some(m))
+                    if t[0] < m[0] - 0.01
+                        || t[1] < m[1] - 0.01
+                        || t[2] > m[2] + 0.01
+                        || t[3] > m[3] + 0.01 =>
+                {
+                    Some(page_issue(
+                        "PDFX_TRIMBOX_OUTSIDE_MEDIABOX",
+                        "Page TrimBox extends past its MediaBox",
+                    ))
+                }
+                _ => None,
+            };
+            if let Some(found) = found {
+                if !emit(found) {
+                    return false;
+                }
+            }
+        }
+        if standard == Standard::PdfA
+            && pdfa1
+            && doc
+                .get(value, "Group")
+                .is_some_and(|g| is_name(dict_get(&g, "S"), "Transparency"))
+        {
+            let found = ValidationIssue::new(
+                IssueSeverity::Error,
+                "PDFA_TRANSPARENCY",
+                "Page has a transparency group",
+            )
+            .with_page(page as i32 + 1)
+            .with_object(num)
+            .with_clause("6.4");
+            if !emit(found) {
+                return false;
+            }
+        }
+    }
+
+    let mut stack = vec![(value, 0)];
+    while let Some((value, depth)) = stack.pop() {
+        if let ParsedValue::Dict(entries) = value {
+            if !check_dict(doc, standard, pdfa1, num, value, emit) {
+                return false;
+            }
+            if depth < MAX_INLINE_DEPTH {
+                stack.extend(entries.iter().map(|(_, v)| (v, depth + 1)));
+            }
+        } else if let ParsedValue::Array(items) = value {
+            if depth < MAX_INLINE_DEPTH {
+                stack.extend(items.iter().map(|v| (v, depth + 1)));
+            }
+        }
+    }
+    true
+}
+
+/// Check one dictionary of object `num`
+fn check_dict(
+    doc: &OpenedDocument,
+    standard: Standard,
+    pdfa1: bool,
+    num: i32,
+    value: &ParsedValue,
+    emit: &mut dyn FnMut(ValidationIssue) -> bool,
+) -> bool {
+    let issue = |severity, code: &str, message: String| {
+        ValidationIssue::new(severity, code, message).with_object(num)
+    };
+
+    // Fonts: every font program must be embedded
+    if is_name(dict_get(value, "Type"), "Font") && standard != Standard::Pdf2 {
+        let subtype = match dict_get(value, "Subtype") {
+            Some(ParsedValue::Name(s)) => s.as_str(),
+            _ => "",
+        };
+        // Composite fonts are checked through their descendants, and
+        // Type 3 glyphs are content streams
+        let embedded = matches!(subtype, "Type0" | "Type3")
+            || doc.get(value, "FontDescriptor").is_some_and(|desc| {
+                ["FontFile", "FontFile2", "FontFile3"]
+                    .iter()
+                    .any(|k| dict_get(&desc, k).is_some())
+            });
+        if !embedded {
+            let name = match dict_get(value, "BaseFont") {
+                Some(ParsedValue::Name(n)) => n.as_str(),
+                _ => "(unnamed)",
+            };
+            let found = match standard {
+                Standard::PdfA => issue(
+                    IssueSeverity::Error,
+                    "PDFA_FONT_NOT_EMBEDDED",
+                    format!("Font {name} is not embedded"),
+                )
+                .with_clause("6.3.4"),
+                _ => issue(
+                    IssueSeverity::Error,
+                    "PDFX_FONT_NOT_EMBEDDED",
+                    format!("Font {name} is not embedded"),
+                ),
+            };
+            if !emit(found) {
+                return false;
+            }
+        }
+    }
+
+    match standard {
+        Standard::PdfA => {
+            let mut found = Vec::new();
+            if has_filter(value, "LZWDecode") {
+                found.push(
+                    issue(
+                        IssueSeverity::Error,
+                        "PDFA_LZW",
+                        "Stream uses LZW compression".to_string(),
+                    )
+                    .with_clause("6.1.10"),
+                );
+            }
+            if is_name(dict_get(value, "S"), "JavaScript")
+                || dict_get(value, "JS").is_some()
+                || dict_get(value, "JavaScript").is_some()
+            {
+                found.push(
+                    issue(
+                        IssueSeverity::Error,
+                        "PDFA_JAVASCRIPT",
+                        "Document contains JavaScript".to_string(),
+                    )
+                    .with_clause("6.6.1"),
+                );
+            }
+
+            // Device colour needs an output intent to say what it means
+            if !doc.pdfa_intent {
+                let spaces: Vec<&ParsedValue> = if is_name(dict_get(value, "Subtype"), "Image")
+                    || dict_get(value, "ShadingType").is_some()
+                {
+                    dict_get(value, "ColorSpace").into_iter().collect()
+                } else {
+                    match dict_get(value, "ColorSpace") {
+                        // A resource dictionary's named colour spaces
+                        Some(ParsedValue::Dict(named)) => named.iter().map(|(_, v)| v).collect(),
+                        _ => Vec::new(),
+                    }
+                };
+                if let Some(space) = spaces.into_iter().find_map(|s| device_space(doc, s)) {
+                    found.push(
+                        issue(
+                            IssueSeverity::Error,
+                            "PDFA_DEVICE_COLOR",
+                            format!("{space} is used without a PDF/A output intent"),
+                        )
+                        .with_clause("6.2.3"),
+                    );
+                }
+            }
+
+            // PDF/A-1 allows no transparency at all
+            if pdfa1 {
+                let soft_mask = dict_get(value, "SMask")
+                    .is_some_and(|m| !matches!(m, ParsedValue::Name(n) if n == "None"));
+                let alpha = ["CA", "ca"]
+                    .iter()
+                    .filter_map(|k| dict_get(value, k).and_then(as_number))
+                    .any(|a| a < 1.0);
+                let blend = match dict_get(value, "BM") {
+                    Some(ParsedValue::Name(bm)) => bm != "Normal" && bm != "Compatible",
+                    _ => false,
+                };
+                let group = doc.index.page_number(num).is_none()
+                    && doc
+                        .get(value, "Group")
+                        .is_some_and(|g| is_name(dict_get(&g, "S"), "Transparency"));
+                if soft_mask || alpha || blend || group {
+                    found.push(
+                        issue(
+                            IssueSeverity::Error,
+                            "PDFA_TRANSPARENCY",
+                            "Object uses transparency".to_string(),
+                        )
+                        .with_clause("6.4"),
+                    );
+                }
+            }
+            found.into_iter().all(&mut *emit)
+        }
+        Standard::PdfX => true,
+        Standard::Pdf2 => {
+            let mut found = Vec::new();
+            if has_filter(value, "LZWDecode") {
+                found.push(issue(
+                    IssueSeverity::Warning,
+                    "PDF2_DEPRECATED_LZW",
+                    "LZW compression is deprecated in PDF 2.0".to_string(),
+                ));
+            }
+            if dict_get(value, "XFA").is_some() {
+                found.push(issue(
+                    IssueSeverity::Warning,
+                    "PDF2_DEPRECATED_XFA",
+                    "XFA forms are deprecated in PDF 2.0".to_string(),
+                ));
+            }
+            found.into_iter().all(&mut *emit)
+        }
+    }
 }
 
 impl ConformanceValidator {
@@ -381,6 +921,9 @@ impl ConformanceValidator {
         Self {
             config,
             result: ValidationResult::new(),
+            document: 0,
+            callback: None,
+            opaque: SendPtr(0),
         }
     }
 
@@ -399,6 +942,26 @@ impl ConformanceValidator {
         self.result = ValidationResult::new();
     }
 
+    /// Validate `doc` from now on (0 = no document)
+    pub fn set_document(&mut self, doc: Handle) {
+        self.document = doc;
+    }
+
+    /// Stop at the first error, for a fast accept/reject decision
+    pub fn set_first_violation_only(&mut self, on: bool) {
+        self.config.stop_on_error = on;
+    }
+
+    /// Stream issues to `callback` as they are found
+    pub fn set_issue_callback(
+        &mut self,
+        callback: FzConformanceIssueCallback,
+        opaque: *mut c_void,
+    ) {
+        self.callback = callback;
+        self.opaque = SendPtr::new(opaque);
+    }
+
     /// Add an issue (respecting max_issues limit)
     fn add_issue(&mut self, issue: ValidationIssue) -> bool {
         if self.result.issues.len() >= self.config.max_issues {
@@ -406,10 +969,65 @@ impl ConformanceValidator {
         }
 
         let is_error = matches!(issue.severity, IssueSeverity::Error | IssueSeverity::Fatal);
+        let mut go_on = true;
+        if let Some(callback) = self.callback {
+            let code = CString::new(issue.code.as_str()).unwrap_or_default();
+            let message = CString::new(issue.message.as_str()).unwrap_or_default();
+            go_on = unsafe {
+                callback(
+                    self.opaque.as_ptr(),
+                    issue.severity as c_int,
+                    code.as_ptr(),
+                    message.as_ptr(),
+                    issue.page,
+                    issue.object_num,
+                )
+            } == 0;
+        }
         self.result.add_issue(issue);
 
         // Return whether to continue
-        !is_error || !self.config.stop_on_error
+        go_on && (!is_error || !self.config.stop_on_error)
+    }
+
+    /// Check every object of `doc` against `standard` in parallel
+    ///
+    /// Issues stream back to this thread as workers find them, so the
+    /// callback sees them at once and an early stop (first violation,
+    /// issue limit or the callback) ends the workers' scan too.
+    fn scan(&mut self, doc: &OpenedDocument, standard: Standard) {
+        let pdfa1 = matches!(self.result.pdfa_claimed, PdfALevel::A1a | PdfALevel::A1b);
+        let threads = self.config.threads;
+        let stop = AtomicBool::new(false);
+        let chunks: Vec<&[i32]> = doc.nums.chunks(SCAN_CHUNK).collect();
+        let (tx, rx) = mpsc::channel();
+        std::thread::scope(|scope| {
+            let stop = &stop;
+            let chunks = &chunks;
+            scope.spawn(move || {
+                parallel_map(chunks, threads, |chunk| {
+                    let mut emit = |issue: ValidationIssue| {
+                        !stop.load(Ordering::Relaxed) && tx.send(issue).is_ok()
+                    };
+                    for &num in *chunk {
+                        if stop.load(Ordering::Relaxed) {
+                            return;
+                        }
+                        if let Some(value) = doc.xref.peek_value(num) {
+                            if !check_object(doc, standard, pdfa1, num, &value, &mut emit) {
+                                return;
+                            }
+                        }
+                    }
+                });
+            });
+            for issue in rx {
+                if !self.add_issue(issue) {
+                    stop.store(true, Ordering::Relaxed);
+                    break;
+                }
+            }
+        });
     }
 
     // ========================================================================
@@ -422,26 +1040,14 @@ impl ConformanceValidator {
             return;
         }
 
-        // Check metadata for PDF/A identification
-        self.check_pdfa_metadata();
-
-        // Check for embedded fonts (required for PDF/A)
-        self.check_embedded_fonts();
-
-        // Check for transparency (restricted in PDF/A-1)
-        self.check_transparency();
-
-        // Check for encryption (forbidden in PDF/A)
-        self.check_encryption_pdfa();
-
-        // Check for JavaScript (forbidden in PDF/A)
-        self.check_javascript_pdfa();
-
-        // Check XMP metadata (required for PDF/A)
-        self.check_xmp_metadata();
-
-        // Check color spaces
-        self.check_colorspaces_pdfa();
+        if let Some(doc) = OpenedDocument::open(self.document, self.config.threads) {
+            self.result.pdf_version = doc.version;
+            if self.check_pdfa_document(&doc) {
+                // Fonts, colour spaces, transparency, JavaScript and
+                // filters, object by object
+                self.scan(&doc, Standard::PdfA);
+            }
+        }
 
         // Determine validated level
         if self.result.error_count == 0 && self.result.pdfa_claimed != PdfALevel::None {
@@ -449,52 +1055,52 @@ impl ConformanceValidator {
         }
     }
 
-    fn check_pdfa_metadata(&mut self) {
-        // In a real implementation, parse XMP metadata to find PDF/A identification
-        // For now, this is a stub that would check:
-        // - pdfaid:part (1, 2, 3, or 4)
-        // - pdfaid:conformance (A, B, or U)
-
-        // Example: If document claims to be PDF/A but has no metadata
-        // self.add_issue(ValidationIssue::new(
-        //     IssueSeverity::Error,
-        //     "PDFA_METADATA_MISSING",
-        //     "PDF/A identification metadata is missing"
-        // ).with_clause("6.6.2"));
-    }
-
-    fn check_embedded_fonts(&mut self) {
-        // PDF/A requires all fonts to be embedded
-        // In a real implementation, iterate through font resources and check:
-        // - Font is embedded (FontFile/FontFile2/FontFile3)
-        // - For PDF/A-1, Type 3 fonts must embed all resources
-    }
-
-    fn check_transparency(&mut self) {
-        // PDF/A-1 forbids transparency
-        // PDF/A-2+ allows transparency
-    }
-
-    fn check_encryption_pdfa(&mut self) {
-        // PDF/A forbids encryption
-        // Check for /Encrypt dictionary in trailer
-    }
-
-    fn check_javascript_pdfa(&mut self) {
-        // PDF/A forbids JavaScript
-        // Check for /JS and /JavaScript entries
-    }
-
-    fn check_xmp_metadata(&mut self) {
-        // PDF/A requires XMP metadata packet
-        // Must be synchronized with document info dictionary
-    }
+    /// Document-level PDF/A checks; false to stop validating
+    fn check_pdfa_document(&mut self, doc: &OpenedDocument) -> bool {
+        // Identification comes from the XMP metadata packet
+        match &doc.xmp {
+            Some(xmp) => {
+                self.result.pdfa_claimed = pdfa_claim(xmp);
+                if self.result.pdfa_claimed == PdfALevel::None
+                    && !self.add_issue(
+                        ValidationIssue::new(
+                            IssueSeverity::Error,
+                            "PDFA_IDENTIFICATION_MISSING",
+                            "XMP metadata has no PDF/A identification",
+                        )
+                        .with_clause("6.7.11"),
+                    )
+                {
+                    return false;
+                }
+            }
+            None => {
+                if !self.add_issue(
+                    ValidationIssue::new(
+                        IssueSeverity::Error,
+                        "PDFA_METADATA_MISSING",
+                        "Document has no XMP metadata",
+                    )
+                    .with_clause("6.7.2"),
+                ) {
+                    return false;
+                }
+            }
+        }
 
-    fn check_colorspaces_pdfa(&mut self) {
-        // Check color space restrictions:
-        // - Device-dependent colors must have output intent
-        // - PDF/A-1: Limited color space support
-        // - PDF/A-2+: More color spaces allowed
+        if dict_get(&doc.trailer, "Encrypt").is_some()
+            && !self.add_issue(
+                ValidationIssue::new(
+                    IssueSeverity::Error,
+                    "PDFA_ENCRYPTED",
+                    "Document is encrypted",
+                )
+                .with_clause("6.1.3"),
+            )
+        {
+            return false;
+        }
+        true
     }
 
     // ========================================================================
@@ -507,20 +1113,13 @@ impl ConformanceValidator {
             return;
         }
 
-        // Check for PDF/X identification
-        self.check_pdfx_metadata();
-
-        // Check output intent (required for PDF/X)
-        self.check_output_intent();
-
-        // Check bleed/trim/art boxes
-        self.check_page_boxes();
-
-        // Check for trapped key
-        self.check_trapped_key();
-
-        // Check fonts
-        self.check_fonts_pdfx();
+        if let Some(doc) = OpenedDocument::open(self.document, self.config.threads) {
+            self.result.pdf_version = doc.version;
+            if self.check_pdfx_document(&doc) {
+                // Fonts and page boxes, object by object
+                self.scan(&doc, Standard::PdfX);
+            }
+        }
 
         // Determine validated level
         if self.result.error_count == 0 && self.result.pdfx_claimed != PdfXLevel::None {
@@ -528,31 +1127,52 @@ impl ConformanceValidator {
         }
     }
 
-    fn check_pdfx_metadata(&mut self) {
-        // Check GTS_PDFXVersion in Info dictionary
-        // Check XMP metadata for PDF/X identification
-    }
-
-    fn check_output_intent(&mut self) {
-        // PDF/X requires OutputIntents array in catalog
-        // Must have at least one entry with /S = /GTS_PDFX
-    }
-
-    fn check_page_boxes(&mut self) {
-        // Check that required boxes are present:
-        // - TrimBox or ArtBox required
-        // - BleedBox recommended
-        // - MediaBox must contain TrimBox
-    }
-
-    fn check_trapped_key(&mut self) {
-        // /Trapped key is required in Info dictionary
-        // Value must be /True, /False, or /Unknown
-    }
-
-    fn check_fonts_pdfx(&mut self) {
-        // All fonts must be embedded
-        // Type 3 fonts may have additional restrictions
+    /// Document-level PDF/X checks; false to stop validating
+    fn check_pdfx_document(&mut self, doc: &OpenedDocument) -> bool {
+        let info = doc.info();
+        let text = |key: &str| match doc.get(&info, key).as_deref() {
+            Some(ParsedValue::String(s)) => Some(text_string(s)),
+            Some(ParsedValue::Name(n)) => Some(n.clone()),
+            _ => None,
+        };
+
+        // PDF/X-1a and X-3 name themselves in Info, later parts in XMP
+        let version = text("GTS_PDFXVersion").or_else(|| {
+            doc.xmp
+                .as_deref()
+                .and_then(|xmp| xmp_property(xmp, "pdfxid:GTS_PDFXVersion"))
+        });
+        self.result.pdfx_claimed = version.as_deref().map_or(PdfXLevel::None, pdfx_claim);
+
+        let mut found = Vec::new();
+        if self.result.pdfx_claimed == PdfXLevel::None {
+            found.push(ValidationIssue::new(
+                IssueSeverity::Error,
+                "PDFX_VERSION_MISSING",
+                "Document has no PDF/X version identification",
+            ));
+        }
+        if !doc.has_output_intent("GTS_PDFX") {
+            found.push(ValidationIssue::new(
+                IssueSeverity::Error,
+                "PDFX_OUTPUT_INTENT_MISSING",
+                "Catalog has no GTS_PDFX output intent",
+            ));
+        }
+        match text("Trapped").as_deref() {
+            Some("True" | "False") => {}
+            Some(_) => found.push(ValidationIssue::new(
+                IssueSeverity::Error,
+                "PDFX_TRAPPED_INVALID",
+                "Info /Trapped must be /True or /False",
+            )),
+            None => found.push(ValidationIssue::new(
+                IssueSeverity::Error,
+                "PDFX_TRAPPED_MISSING",
+                "Info dictionary has no /Trapped key",
+            )),
+        }
+        found.into_iter().all(|issue| self.add_issue(issue))
     }
 
     // ========================================================================
@@ -565,14 +1185,13 @@ impl ConformanceValidator {
             return;
         }
 
-        // Check PDF version
-        self.check_pdf_version();
-
-        // Check for deprecated features
-        self.check_deprecated_features();
-
-        // Check new PDF 2.0 features if claimed
-        self.check_pdf2_features();
+        if let Some(doc) = OpenedDocument::open(self.document, self.config.threads) {
+            self.result.pdf_version = doc.version;
+            if self.check_pdf2_document(&doc) {
+                // Deprecated filters and forms, object by object
+                self.scan(&doc, Standard::Pdf2);
+            }
+        }
 
         // Determine compliance
         if self.result.error_count == 0 && self.result.pdf_version == PdfVersion::V2_0 {
@@ -580,26 +1199,17 @@ impl ConformanceValidator {
         }
     }
 
-    fn check_pdf_version(&mut self) {
-        // Parse %PDF-x.y header
-        // Check /Version in catalog (takes precedence)
-    }
-
-    fn check_deprecated_features(&mut self) {
-        // PDF 2.0 deprecates:
-        // - LZW compression (use Flate instead)
-        // - ASCII85 encoding
-        // - Certain annotation types
-        // - XFA forms
-    }
-
-    fn check_pdf2_features(&mut self) {
-        // PDF 2.0 new features:
-        // - AES-256 encryption
-        // - Page-level output intents
-        // - Geospatial features
-        // - 3D annotations v2
-        // - Rich media annotations
+    /// Document-level PDF 2.0 checks; false to stop validating
+    fn check_pdf2_document(&mut self, doc: &OpenedDocument) -> bool {
+        // NeedsRendering only ever meant XFA
+        if dict_get(&doc.catalog, "NeedsRendering").is_some() {
+            return self.add_issue(ValidationIssue::new(
+                IssueSeverity::Warning,
+                "PDF2_DEPRECATED_NEEDS_RENDERING",
+                "Catalog /NeedsRendering is deprecated in PDF 2.0",
+            ));
+        }
+        true
     }
 }
 
@@ -641,6 +1251,63 @@ pub extern "C" fn fz_conformance_validator_reset(_ctx: Handle, validator: Handle
     }
 }
 
+/// Validate `doc` with this validator from now on (0 = no document)
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_conformance_validator_set_document(
+    _ctx: Handle,
+    validator: Handle,
+    doc: Handle,
+) {
+    if let Some(arc) = VALIDATORS.get(validator) {
+        if let Ok(mut v) = arc.lock() {
+            v.set_document(doc);
+        }
+    }
+}
+
+/// Set the threads checking objects (0 = one per core)
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_conformance_validator_set_threads(
+    _ctx: Handle,
+    validator: Handle,
+    threads: c_int,
+) {
+    if let Some(arc) = VALIDATORS.get(validator) {
+        if let Ok(mut v) = arc.lock() {
+            v.config.threads = usize::try_from(threads).unwrap_or(0);
+        }
+    }
+}
+
+/// Stop at the first error, for fast accept/reject gating
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_conformance_validator_set_first_violation(
+    _ctx: Handle,
+    validator: Handle,
+    on: c_int,
+) {
+    if let Some(arc) = VALIDATORS.get(validator) {
+        if let Ok(mut v) = arc.lock() {
+            v.set_first_violation_only(on != 0);
+        }
+    }
+}
+
+/// Stream issues to `callback` as they are found (null to stop streaming)
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_conformance_validator_set_issue_callback(
+    _ctx: Handle,
+    validator: Handle,
+    callback: FzConformanceIssueCallback,
+    opaque: *mut c_void,
+) {
+    if let Some(arc) = VALIDATORS.get(validator) {
+        if let Ok(mut v) = arc.lock() {
+            v.set_issue_callback(callback, opaque);
+        }
+    }
+}
+
 /// Run PDF/A validation
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_validate_pdfa(_ctx: Handle, validator: Handle) {
@@ -862,43 +1529,14 @@ pub extern "C" fn fz_free_validation_string(_ctx: Handle, s: *mut c_char) {
 /// Get PDF/A level name (returns static string)
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_pdfa_level_name(level: c_int) -> *const c_char {
-    let level = match level {
-        0 => PdfALevel::None,
-        1 => PdfALevel::A1a,
-        2 => PdfALevel::A1b,
-        3 => PdfALevel::A2a,
-        4 => PdfALevel::A2b,
-        5 => PdfALevel::A2u,
-        6 => PdfALevel::A3a,
-        7 => PdfALevel::A3b,
-        8 => PdfALevel::A3u,
-        9 => PdfALevel::A4,
-        10 => PdfALevel::A4e,
-        11 => PdfALevel::A4f,
-        _ => PdfALevel::None,
-    };
+    let level = PdfALevel::from_i32(level);
     level.short_name().as_ptr() as *const c_char
 }
 
 /// Get PDF/X level name (returns static string)
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_pdfx_level_name(level: c_int) -> *const c_char {
-    let level = match level {
-        0 => PdfXLevel::None,
-        1 => PdfXLevel::X1a2001,
-        2 => PdfXLevel::X1a2003,
-        3 => PdfXLevel::X32002,
-        4 => PdfXLevel::X32003,
-        5 => PdfXLevel::X4,
-        6 => PdfXLevel::X4p,
-        7 => PdfXLevel::X5g,
-        8 => PdfXLevel::X5n,
-        9 => PdfXLevel::X5pg,
-        10 => PdfXLevel::X6,
-        11 => PdfXLevel::X6n,
-        12 => PdfXLevel::X6p,
-        _ => PdfXLevel::None,
-    };
+    let level = PdfXLevel::from_i32(level);
     level.short_name().as_ptr() as *const c_char
 }
 
@@ -909,6 +1547,8 @@ pub extern "C" fn fz_pdfx_level_name(level: c_int) -> *const c_char {
 #[cfg(test)]
 mod tests {
     use super::*;
+    use crate::ffi::document::Document;
+    use crate::ffi::pdf_image_rewriter::tests::{pdf_with, stream};
 
     #[test]
     fn test_pdfa_levels() {
@@ -1019,4 +1659,210 @@ mod tests {
 
         fz_drop_conformance_validator(0, handle);
     }
+
+    const PDFA1B_XMP: &[u8] = br#"<x:xmpmeta xmlns:x="adobe:ns:meta/"><rdf:RDF><rdf:Description pdfaid:part="1" pdfaid:conformance="B"/></rdf:RDF></x:xmpmeta>"#;
+
+    /// A one-page PDF/A-1b file; `page` and `extra` objects replace the
+    /// page and follow the conforming ones
+    fn pdfa_file(page: &str, extra: &[Vec<u8>]) -> Vec<u8> {
+        let mut objects = vec![
+            b"<< /Type /Catalog /Pages 2 0 R /Metadata 5 0 R /OutputIntents [6 0 R] >>".to_vec(),
+            b"<< /Type /Pages /Kids [3 0 R] /Count 1 /MediaBox [0 0 200 200] >>".to_vec(),
+            page.as_bytes().to_vec(),
+            b"<< /Type /Font /Subtype /TrueType /BaseFont /Embedded /FontDescriptor 7 0 R >>"
+                .to_vec(),
+            stream("/Type /Metadata /Subtype /XML", PDFA1B_XMP),
+            b"<< /Type /OutputIntent /S /GTS_PDFA1 >>".to_vec(),
+            b"<< /Type /FontDescriptor /FontFile2 8 0 R >>".to_vec(),
+            stream("", b"font program"),
+        ];
+        objects.extend_from_slice(extra);
+        pdf_with(&objects)
+    }
+
+    const PDFA_PAGE: &str = "<< /Type /Page /Parent 2 0 R /Resources << /Font << /F1 4 0 R >> /ColorSpace << /CS0 /DeviceRGB >> >> >>";
+
+    fn validate(data: Vec<u8>, threads: usize, first_violation: bool) -> ValidationResult {
+        let doc = DOCUMENTS.insert(Document::new(data));
+        let mut validator = ConformanceValidator::new(ValidatorConfig {
+            threads,
+            ..Default::default()
+        });
+        validator.set_document(doc);
+        validator.set_first_violation_only(first_violation);
+        validator.validate_pdfa();
+        validator.validate_pdfx();
+        validator.validate_pdf2();
+        DOCUMENTS.remove(doc);
+        validator.result().clone()
+    }
+
+    fn codes(result: &ValidationResult) -> Vec<(String, i32)> {
+        let mut codes: Vec<_> = result
+            .issues
+            .iter()
+            .filter(|i| i.code.starts_with("PDFA"))
+            .map(|i| (i.code.clone(), i.object_num))
+            .collect();
+        codes.sort();
+        codes
+    }
+
+    #[test]
+    fn test_validate_conforming_pdfa() {
+        let result = validate(pdfa_file(PDFA_PAGE, &[]), 0, false);
+        assert!(codes(&result).is_empty());
+        assert_eq!(result.pdfa_claimed, PdfALevel::A1b);
+        assert_eq!(result.pdfa_valid, PdfALevel::A1b);
+        assert_eq!(result.pdf_version, PdfVersion::V1_7);
+        // Not PDF/X: no identification, intent or trim box
+        assert_eq!(result.pdfx_claimed, PdfXLevel::None);
+        assert!(
+            result
+                .issues
+                .iter()
+                .any(|i| i.code == "PDFX_TRIMBOX_MISSING" && i.page == 1)
+        );
+    }
+
+    #[test]
+    fn test_validate_pdfa_violations_any_thread_count() {
+        let page = "<< /Type /Page /Parent 2 0 R /Resources << /Font << /F1 4 0 R /F2 9 0 R >> /ExtGState << /G0 10 0 R >> >> /AA << /O 11 0 R >> >>";
+        let extra = [
+            b"<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>".to_vec(),
+            b"<< /Type /ExtGState /ca 0.5 >>".to_vec(),
+            b"<< /S /JavaScript /JS (app.alert(1)) >>".to_vec(),
+            stream("/Filter /LZWDecode", b"lzw data"),
+        ];
+        let data = pdfa_file(page, &extra);
+        let expected = [
+            ("PDFA_FONT_NOT_EMBEDDED".to_string(), 9),
+            ("PDFA_JAVASCRIPT".to_string(), 11),
+            ("PDFA_LZW".to_string(), 12),
+            ("PDFA_TRANSPARENCY".to_string(), 10),
+        ];
+        for threads in [1, 4] {
+            let result = validate(data.clone(), threads, false);
+            assert_eq!(codes(&result), expected);
+            assert_eq!(result.pdfa_valid, PdfALevel::None);
+        }
+
+        // Gating stops each pass at its first error
+        let result = validate(data, 4, true);
+        assert_eq!(codes(&result).len(), 1);
+    }
+
+    #[test]
+    fn test_validate_device_color_needs_intent() {
+        let mut data = String::from_utf8(pdfa_file(PDFA_PAGE, &[])).unwrap();
+        data = data.replace("/S /GTS_PDFA1", "/S /GTS_OTHER");
+        let result = validate(data.into_bytes(), 0, false);
+        let device: Vec<_> = result
+            .issues
+            .iter()
+            .filter(|i| i.code == "PDFA_DEVICE_COLOR")
+            .collect();
+        assert_eq!(device.len(), 1);
+        assert_eq!(
+            (device[0].object_num, device[0].message.as_str()),
+            (3, "DeviceRGB is used without a PDF/A output intent")
+        );
+    }
+
+    #[test]
+    fn test_validate_pdfx_and_pdf2() {
+        let data = pdf_with(&[
+            b"<< /Type /Catalog /Pages 2 0 R /Version /2.0 /OutputIntents [<< /S /GTS_PDFX >>] >>"
+                .to_vec(),
+            b"<< /Type /Pages /Kids [3 0 R] /Count 1 /MediaBox [0 0 200 200] >>".to_vec(),
+            b"<< /Type /Page /Parent 2 0 R /TrimBox [10 10 210 190] >>".to_vec(),
+            b"<< /GTS_PDFXVersion (PDF/X-1a:2001) /Trapped /False >>".to_vec(),
+            stream("/Filter /LZWDecode", b"lzw data"),
+        ]);
+        let data = String::from_utf8(data)
+            .unwrap()
+            .replace("/Root 1 0 R >>", "/Root 1 0 R /Info 4 0 R >>");
+        let doc = DOCUMENTS.insert(Document::new(data.into_bytes()));
+        let mut validator = ConformanceValidator::new(ValidatorConfig {
+            check_pdfa: false,
+            ..Default::default()
+        });
+        validator.set_document(doc);
+        validator.validate_pdfx();
+        let result = validator.result();
+        assert_eq!(result.pdfx_claimed, PdfXLevel::X1a2001);
+        assert_eq!(result.error_count, 1);
+        assert_eq!(
+            (result.issues[0].code.as_str(), result.issues[0].page),
+            ("PDFX_TRIMBOX_OUTSIDE_MEDIABOX", 1)
+        );
+
+        validator.reset();
+        validator.validate_pdf2();
+        let result = validator.result();
+        assert_eq!(result.pdf_version, PdfVersion::V2_0);
+        assert_eq!(result.warning_count, 1);
+        assert_eq!(result.issues[0].code, "PDF2_DEPRECATED_LZW");
+        assert!(result.pdf2_compliant);
+        DOCUMENTS.remove(doc);
+    }
+
+    unsafe extern "C" fn count_issue(
+        opaque: *mut c_void,
+        _severity: c_int,
+        code: *const c_char,
+        _message: *const c_char,
+        _page: c_int,
+        _object: c_int,
+    ) -> c_int {
+        let seen = unsafe { &mut *(opaque as *mut Vec<String>) };
+        seen.push(
+            unsafe { std::ffi::CStr::from_ptr(code) }
+                .to_string_lossy()
+                .into_owned(),
+        );
+        // Stop after the second issue
+        (seen.len() >= 2) as c_int
+    }
+
+    #[test]
+    fn test_validator_streams_issues() {
+        let data = pdfa_file(
+            "<< /Type /Page /Parent 2 0 R /Resources << /Font << /F2 9 0 R /F3 10 0 R /F4 11 0 R >> >> >>",
+            &[
+                b"<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>".to_vec(),
+                b"<< /Type /Font /Subtype /Type1 /BaseFont /Courier >>".to_vec(),
+                b"<< /Type /Font /Subtype /Type1 /BaseFont /Times-Roman >>".to_vec(),
+            ],
+        );
+        let doc = DOCUMENTS.insert(Document::new(data));
+        let validator = fz_new_conformance_validator(0, 1, 0, 0);
+        let mut seen: Vec<String> = Vec::new();
+        fz_conformance_validator_set_document(0, validator, doc);
+        fz_conformance_validator_set_threads(0, validator, 2);
+        fz_conformance_validator_set_issue_callback(
+            0,
+            validator,
+            Some(count_issue),
+            &mut seen as *mut Vec<String> as *mut c_void,
+        );
+        fz_validate_pdfa(0, validator);
+        assert_eq!(seen, ["PDFA_FONT_NOT_EMBEDDED", "PDFA_FONT_NOT_EMBEDDED"]);
+        assert_eq!(fz_conformance_issue_count(0, validator), 2);
+        assert_eq!(fz_conformance_is_valid(0, validator), 0);
+
+        // Without the callback all three are found
+        fz_conformance_validator_reset(0, validator);
+        fz_conformance_validator_set_issue_callback(0, validator, None, std::ptr::null_mut());
+        fz_validate_pdfa(0, validator);
+        assert_eq!(fz_conformance_error_count(0, validator), 3);
+
+        fz_conformance_validator_reset(0, validator);
+        fz_conformance_validator_set_first_violation(0, validator, 1);
+        fz_validate_pdfa(0, validator);
+        assert_eq!(fz_conformance_error_count(0, validator), 1);
+
+        fz_drop_conformance_validator(0, validator);
+        DOCUMENTS.remove(doc);
+    }
 }
@@ -0,0 +1,232 @@
+//! Object Deduplication
+//!
+//! Finds objects that come out the same once written: two levels, first a
+//! 64-bit hash of each object's canonical form (its dictionary with keys
+//! sorted and references resolved through the merges found so far, plus
+//! its raw stream data) to bucket them, then a byte compare only between
+//! objects sharing a bucket. Hashing runs on a pool of threads over
+//! windows of objects.
+//!
+//! Merging two objects can make the objects pointing at them equal too
+//! (two font dictionaries over what were two copies of one font file), so
+//! passes repeat, over the survivors, until one finds nothing new.
+
+use super::pdf_parse::ParsedValue;
+use super::pdf_stream_prefetch::parallel_map;
+use super::pdf_write::{set_key, write_value_with};
+use super::pdf_xref::Xref;
+use super::pdf_xref_lazy::{dict_get, is_name};
+use super::simd_util::{buffer_equal, hash64};
+use bytes::Bytes;
+use std::collections::HashMap;
+
+/// Objects hashed per window
+const HASH_WINDOW: usize = 1024;
+
+/// Most passes made; each one only finds merges the last one enabled
+const MAX_PASSES: usize = 16;
+
+/// Object types that must stay distinct even when equal
+const KEEP_TYPES: [&str; 3] = ["Page", "Pages", "Catalog"];
+
+/// An object as compared: canonical text and raw stream data
+struct Form {
+    text: Vec<u8>,
+    stream: Option<Bytes>,
+}
+
+impl Form {
+    fn hash(&self) -> u64 {
+        let text = hash64(&self.text);
+        match &self.stream {
+            Some(data) => text ^ hash64(data).rotate_left(29),
+            None => text,
+        }
+    }
+
+    fn same(&self, other: &Form) -> bool {
+        buffer_equal(&self.text, &other.text)
+            && match (&self.stream, &other.stream) {
+                (Some(a), Some(b)) => buffer_equal(a, b),
+                (None, None) => true,
+                _ => false,
+            }
+    }
+}
+
+/// Follow `num` through `merged` to the object it now stands for
+fn resolve(merged: &HashMap<i32, i32>, mut num: i32) -> i32 {
+    while let Some(&target) = merged.get(&num) {
+        num = target;
+    }
+    num
+}
+
+fn sort_keys(value: &mut ParsedValue) {
+    match value {
+        ParsedValue::Array(items) => items.iter_mut().for_each(sort_keys),
+        ParsedValue::Dict(entries) => {
+            entries.sort_by(|a, b| a.0.cmp(&b.0));
+            entries.iter_mut().for_each(|(_, v)| sort_keys(v));
+        }
+        _ => {}
+    }
+}
+
+fn canonical(value: &ParsedValue, stream: Option<Bytes>, merged: &HashMap<i32, i32>) -> Form {
+    let mut value = value.clone();
+    if stream.is_some() {
+        // The data is compared itself, and is written with a direct length
+        set_key(&mut value, "Length", None);
+    }
+    sort_keys(&mut value);
+    let mut text = Vec::new();
+    write_value_with(&value, &mut text, &mut |num, _, out| {
+        out.extend_from_slice(format!("{} R", resolve(merged, num)).as_bytes());
+    });
+    if stream.is_some() {
+        // So a stream never matches a bare dictionary
+        text.extend_from_slice(b" stream");
+    }
+    Form { text, stream }
+}
+
+/// Whether an object may be merged with an equal one
+fn mergeable(value: &ParsedValue) -> bool {
+    !KEEP_TYPES
+        .iter()
+        .any(|t| is_name(dict_get(value, "Type"), t))
+}
+
+/// The mergeable objects among `nums`
+fn mergeable_objects(
+    xref: &mut Xref,
+    nums: &[i32],
+    merged: &HashMap<i32, i32>,
+) -> Vec<(i32, ParsedValue, Option<Bytes>)> {
+    nums.iter()
+        .filter_map(|&num| {
+            let fetched = xref.fetch(num)?;
+            mergeable(&fetched.value).then_some((num, fetched.value, fetched.stream))
+        })
+        .collect()
+}
+
+/// Objects among `nums` that duplicate another, mapped to the one kept
+///
+/// The lowest object number of each group is kept; the map is already
+/// resolved, so every value is a kept object.
+pub(crate) fn duplicate_objects(
+    xref: &mut Xref,
+    nums: &[i32],
+    threads: usize,
+) -> HashMap<i32, i32> {
+    let mut merged = HashMap::new();
+    let mut candidates = nums.to_vec();
+    candidates.sort_unstable();
+
+    for _ in 0..MAX_PASSES {
+        // Level one: bucket by hash
+        let mut hashes = Vec::with_capacity(candidates.len());
+        for window in candidates.chunks(HASH_WINDOW) {
+            let objects = mergeable_objects(xref, window, &merged);
+            let window_hashes = parallel_map(&objects, threads, |(_, value, stream)| {
+                canonical(value, stream.clone(), &merged).hash()
+            });
+            hashes.extend(window_hashes.into_iter().zip(objects.iter().map(|o| o.0)));
+        }
+        hashes.sort_unstable();
+
+        // Level two: compare within buckets
+        let mut found = HashMap::new();
+        for bucket in hashes.chunk_by(|a, b| a.0 == b.0).filter(|b| b.len() > 1) {
+            let nums: Vec<i32> = bucket.iter().map(|&(_, num)| num).collect();
+            let bucket_forms: Vec<(i32, Form)> = mergeable_objects(xref, &nums, &merged)
+                .into_iter()
+                .map(|(num, value, stream)| (num, canonical(&value, stream, &merged)))
+                .collect();
+            for (i, (keep, form)) in bucket_forms.iter().enumerate() {
+                if found.contains_key(keep) {
+                    continue;
+                }
+                for (num, other) in &bucket_forms[i + 1..] {
+                    if !found.contains_key(num) && form.same(other) {
+                        found.insert(*num, *keep);
+                    }
+                }
+            }
+        }
+
+        if found.is_empty() {
+            break;
+        }
+        candidates.retain(|num| !found.contains_key(num));
+        merged.extend(found);
+    }
+
+    let keys: Vec<i32> = merged.keys().copied().collect();
+    keys.into_iter()
+        .map(|num| (num, resolve(&merged, num)))
+        .collect()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::Arc;
+
+    fn xref_for(objects: &[(i32, &[u8])]) -> Xref {
+        let mut pdf = b"%PDF-1.7\n".to_vec();
+        let mut offsets = Vec::new();
+        for &(num, body) in objects {
+            offsets.push((num, pdf.len()));
+            pdf.extend_from_slice(format!("{num} 0 obj\n").as_bytes());
+            pdf.extend_from_slice(body);
+            pdf.extend_from_slice(b"\nendobj\n");
+        }
+        let size = objects.iter().map(|o| o.0).max().unwrap() + 1;
+        let table = pdf.len();
+        pdf.extend_from_slice(format!("xref\n0 {size}\n0000000000 65535 f \n").as_bytes());
+        for num in 1..size {
+            match offsets.iter().find(|o| o.0 == num) {
+                Some((_, at)) => pdf.extend_from_slice(format!("{at:010} 00000 n \n").as_bytes()),
+                None => pdf.extend_from_slice(b"0000000000 00000 f \n"),
+            }
+        }
+        pdf.extend_from_slice(
+            format!("trailer\n<< /Size {size} /Root 1 0 R >>\nstartxref\n{table}\n%%EOF\n")
+                .as_bytes(),
+        );
+        Xref::open_lazy(0, Arc::new(pdf.into())).unwrap()
+    }
+
+    #[test]
+    fn test_dedup_merges_through_references() {
+        let mut xref = xref_for(&[
+            (1, b"<< /Type /Catalog >>"),
+            (2, b"<< /Length 4 >>\nstream\nFONT\nendstream"),
+            (3, b"<< /Length 4 >>\nstream\nFONT\nendstream"),
+            (4, b"<< /Type /Font /FontFile 2 0 R /BaseFont /A >>"),
+            // Same dictionary, keys in another order, over the other copy
+            (5, b"<< /BaseFont /A /FontFile 3 0 R /Type /Font >>"),
+            (6, b"<< /Length 4 >>\nstream\nDIFF\nendstream"),
+            (7, b"<< /Type /Page >>"),
+            (8, b"<< /Type /Page >>"),
+        ]);
+        let merged = duplicate_objects(&mut xref, &[1, 2, 3, 4, 5, 6, 7, 8], 2);
+        assert_eq!(merged.len(), 2);
+        assert_eq!(merged.get(&3), Some(&2));
+        assert_eq!(merged.get(&5), Some(&4));
+    }
+
+    #[test]
+    fn test_dedup_tells_streams_from_dicts() {
+        let mut xref = xref_for(&[
+            (1, b"<< /Length 0 >>\nstream\n\nendstream"),
+            (2, b"<< /Length 0 >>"),
+            (3, b"<< /Length 3 >>\nstream\nabc\nendstream"),
+            (4, b"<< /Length 3 >>\nstream\nabd\nendstream"),
+        ]);
+        assert!(duplicate_objects(&mut xref, &[1, 2, 3, 4], 1).is_empty());
+    }
+}
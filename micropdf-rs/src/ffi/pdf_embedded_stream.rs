@@ -0,0 +1,291 @@
+//! Streaming Embedded File Extraction
+//!
+//! `pdf_portfolio_get_file` hands back a whole file held in memory, which
+//! doesn't scale to attachments of several gigabytes. Here a document's
+//! embedded files (its `/Names /EmbeddedFiles` tree) are found by name and
+//! decoded straight into a sink. A file stored unfiltered, or with a lone
+//! `FlateDecode`, is passed on in 64 KiB chunks as it inflates, and its
+//! stream is read from the file without a copy, so memory stays flat
+//! however large the file is. Other filter chains are decoded whole first.
+//!
+//! `pdf_extract_embedded_files` runs several files at once on a pool of
+//! threads, each into its own output.
+
+use super::pdf_form_fill::text_string;
+use super::pdf_image_rewriter::resolve;
+use super::pdf_parse::ParsedValue;
+use super::pdf_write::open_source;
+use super::pdf_xref::Xref;
+use super::pdf_xref_lazy::{as_int, as_ref, decode_stream, dict_get, is_name};
+use crate::ffi::{DOCUMENTS, Handle};
+use bytes::Bytes;
+use flate2::{Decompress, FlushDecompress, Status};
+use std::collections::HashSet;
+
+/// Name tree nodes nested deeper than this are not read
+const MAX_NAME_TREE_DEPTH: usize = 16;
+
+/// Decoded data is handed to the sink in chunks of this size
+const STREAM_CHUNK: usize = 64 * 1024;
+
+/// An embedded file's stream, still encoded
+pub(crate) struct EmbeddedStream {
+    pub(crate) name: String,
+    dict: ParsedValue,
+    raw: Bytes,
+}
+
+/// How a stream's filters let it be decoded
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum Decode {
+    /// No filter: the raw bytes are the data
+    Raw,
+    /// A lone `FlateDecode` without a predictor, inflated as it goes
+    Inflate,
+    /// Anything else, decoded whole by `decode_stream`
+    Whole,
+}
+
+/// The embedded files of document `doc`, in name tree order
+///
+/// Names are only read here; no stream is decoded. Returns `None` if the
+/// document can't be read, or is encrypted.
+pub(crate) fn embedded_files(doc: Handle) -> Option<Vec<EmbeddedStream>> {
+    let data = DOCUMENTS.get(doc)?.lock().ok()?.data();
+    let mut xref = open_source(&data, 1)?;
+    xref.read_all_sections();
+    let trailer = xref
+        .source_trailer()
+        .filter(|t| dict_get(t, "Encrypt").is_none())?
+        .clone();
+    let catalog = dict_get(&trailer, "Root").and_then(|r| resolve(&mut xref, r))?;
+    Some(catalog_files(&mut xref, &catalog))
+}
+
+/// The files in `catalog`'s `/Names /EmbeddedFiles` tree, in order
+pub(crate) fn catalog_files(xref: &mut Xref, catalog: &ParsedValue) -> Vec<EmbeddedStream> {
+    let names = dict_get(catalog, "Names")
+        .and_then(|n| resolve(xref, n))
+        .unwrap_or(ParsedValue::Null);
+    let mut files = Vec::new();
+    let Some(root) = dict_get(&names, "EmbeddedFiles").cloned() else {
+        return files;
+    };
+
+    let mut seen = HashSet::new();
+    let mut stack = vec![(root, 0)];
+    while let Some((node, depth)) = stack.pop() {
+        if let Some(num) = as_ref(&node) {
+            if !seen.insert(num) {
+                continue;
+            }
+        }
+        let Some(node) = resolve(xref, &node) else {
+            continue;
+        };
+        if let Some(ParsedValue::Array(pairs)) = dict_get(&node, "Names") {
+            for pair in pairs.chunks_exact(2) {
+                if let ParsedValue::String(name) = &pair[0] {
+                    if let Some(file) = embedded_file(xref, text_string(name), &pair[1]) {
+                        files.push(file);
+                    }
+                }
+            }
+        }
+        if depth < MAX_NAME_TREE_DEPTH {
+            if let Some(ParsedValue::Array(kids)) = dict_get(&node, "Kids") {
+                // Reversed onto the stack, so kids are visited in order
+                stack.extend(kids.iter().rev().map(|kid| (kid.clone(), depth + 1)));
+            }
+        }
+    }
+    files
+}
+
+/// The embedded stream of file specification `spec`, known as `name`
+pub(crate) fn embedded_file(
+    xref: &mut Xref,
+    name: String,
+    spec: &ParsedValue,
+) -> Option<EmbeddedStream> {
+    let spec = resolve(xref, spec)?;
+    let ef = dict_get(&spec, "EF").and_then(|ef| resolve(xref, ef))?;
+    let num = dict_get(&ef, "UF")
+        .or_else(|| dict_get(&ef, "F"))
+        .and_then(as_ref)?;
+    let fetched = xref.fetch(num)?;
+    Some(EmbeddedStream {
+        name,
+        dict: fetched.value,
+        raw: fetched.stream?,
+    })
+}
+
+fn decode_kind(dict: &ParsedValue) -> Decode {
+    let filter = match dict_get(dict, "Filter") {
+        None => return Decode::Raw,
+        Some(ParsedValue::Array(filters)) => match filters.as_slice() {
+            [] => return Decode::Raw,
+            [filter] => filter,
+            _ => return Decode::Whole,
+        },
+        Some(filter) => filter,
+    };
+    let params = match dict_get(dict, "DecodeParms") {
+        Some(ParsedValue::Array(params)) => params.first(),
+        params => params,
+    };
+    let predictor = params
+        .and_then(|p| dict_get(p, "Predictor"))
+        .and_then(as_int)
+        .unwrap_or(1);
+    if is_name(Some(filter), "FlateDecode") && predictor <= 1 {
+        Decode::Inflate
+    } else {
+        Decode::Whole
+    }
+}
+
+/// Decode `file` into `sink` a chunk at a time; `sink` returns `false` to
+/// stop
+///
+/// Returns the number of bytes decoded, or `None` if the stream can't be
+/// decoded or `sink` stopped. A deflate stream that breaks off after some
+/// of its data ends there, as a truncated stream does when read whole.
+pub(crate) fn stream_decoded(
+    file: &EmbeddedStream,
+    sink: &mut dyn FnMut(&[u8]) -> bool,
+) -> Option<u64> {
+    match decode_kind(&file.dict) {
+        Decode::Raw => emit(&file.raw, sink),
+        Decode::Inflate => match inflate(&file.raw, sink) {
+            Inflated::Done(total) => Some(total),
+            Inflated::Stopped => None,
+            // Nothing was handed on yet, so the tolerant decoder can retry
+            Inflated::Failed => emit(&decode_stream(&file.dict, &file.raw)?, sink),
+        },
+        Decode::Whole => emit(&decode_stream(&file.dict, &file.raw)?, sink),
+    }
+}
+
+enum Inflated {
+    Done(u64),
+    Stopped,
+    /// Failed before any output
+    Failed,
+}
+
+fn inflate(mut input: &[u8], sink: &mut dyn FnMut(&[u8]) -> bool) -> Inflated {
+    let mut inflater = Decompress::new(true);
+    let mut chunk = vec![0; STREAM_CHUNK];
+    loop {
+        let (read, written) = (inflater.total_in(), inflater.total_out());
+        let status = inflater.decompress(input, &mut chunk, FlushDecompress::None);
+        let consumed = (inflater.total_in() - read) as usize;
+        let produced = (inflater.total_out() - written) as usize;
+        input = &input[consumed..];
+        if produced > 0 && !sink(&chunk[..produced]) {
+            return Inflated::Stopped;
+        }
+        match status {
+            Ok(Status::StreamEnd) => break,
+            Ok(_) if consumed == 0 && produced == 0 => break,
+            Ok(_) => {}
+            Err(_) if inflater.total_out() == 0 => return Inflated::Failed,
+            Err(_) => break,
+        }
+    }
+    Inflated::Done(inflater.total_out())
+}
+
+fn emit(data: &[u8], sink: &mut dyn FnMut(&[u8]) -> bool) -> Option<u64> {
+    for chunk in data.chunks(STREAM_CHUNK) {
+        if !sink(chunk) {
+            return None;
+        }
+    }
+    Some(data.len() as u64)
+}
+
+#[cfg(test)]
+pub(crate) mod tests {
+    use super::*;
+    use crate::ffi::document::Document;
+    use crate::ffi::pdf_image_rewriter::tests::{pdf_with, stream};
+    use crate::pdf::filter::encode_flate;
+
+    /// Contents that span several chunks and compress well
+    pub(crate) fn large_contents() -> Vec<u8> {
+        (0..STREAM_CHUNK as u32 * 3)
+            .map(|i| (i % 251) as u8)
+            .collect()
+    }
+
+    /// A document with three embedded files, split over two name tree
+    /// leaves: a flate-compressed one, a stored one and one with a
+    /// predictor, which is decoded whole
+    pub(crate) fn attachments_pdf() -> Vec<u8> {
+        let flate = encode_flate(&large_contents(), 6).unwrap();
+        let predicted = [&[0u8, b'a', b'b'][..], &[0, b'c', b'd']].concat();
+        pdf_with(&[
+            b"<< /Type /Catalog /Pages 2 0 R /Names << /EmbeddedFiles 3 0 R >> >>".to_vec(),
+            b"<< /Type /Pages /Kids [] /Count 0 >>".to_vec(),
+            b"<< /Kids [4 0 R 5 0 R] >>".to_vec(),
+            b"<< /Limits [(big.bin) (big.bin)] /Names [(big.bin) 6 0 R] >>".to_vec(),
+            b"<< /Limits [(notes.txt) (rows.dat)] \
+               /Names [(notes.txt) 7 0 R (rows.dat) << /Type /Filespec /EF << /F 10 0 R >> >>] >>"
+                .to_vec(),
+            b"<< /Type /Filespec /F (big.bin) /UF (big.bin) /EF << /F 8 0 R /UF 8 0 R >> >>"
+                .to_vec(),
+            b"<< /Type /Filespec /F (notes.txt) /EF << /F 9 0 R >> >>".to_vec(),
+            stream("/Type /EmbeddedFile /Filter /FlateDecode", &flate),
+            stream("/Type /EmbeddedFile", b"some notes"),
+            stream(
+                "/Type /EmbeddedFile /Filter /FlateDecode \
+                 /DecodeParms << /Predictor 10 /Columns 2 >>",
+                &encode_flate(&predicted, 6).unwrap(),
+            ),
+        ])
+    }
+
+    #[test]
+    fn test_embedded_files_stream_in_chunks() {
+        let doc = DOCUMENTS.insert(Document::new(attachments_pdf()));
+        let files = embedded_files(doc).unwrap();
+        let names: Vec<_> = files.iter().map(|f| f.name.as_str()).collect();
+        assert_eq!(names, ["big.bin", "notes.txt", "rows.dat"]);
+        assert_eq!(decode_kind(&files[0].dict), Decode::Inflate);
+        assert_eq!(decode_kind(&files[1].dict), Decode::Raw);
+        assert_eq!(decode_kind(&files[2].dict), Decode::Whole);
+
+        // Inflated a bounded chunk at a time
+        let mut data = Vec::new();
+        let mut largest = 0;
+        let total = stream_decoded(&files[0], &mut |chunk| {
+            largest = largest.max(chunk.len());
+            data.extend_from_slice(chunk);
+            true
+        });
+        assert_eq!(total, Some(data.len() as u64));
+        assert_eq!(data, large_contents());
+        assert!(largest <= STREAM_CHUNK);
+
+        let mut data = Vec::new();
+        stream_decoded(&files[2], &mut |chunk| {
+            data.extend_from_slice(chunk);
+            true
+        })
+        .unwrap();
+        assert_eq!(data, b"abcd");
+
+        // A sink that stops ends extraction
+        let mut calls = 0;
+        let stopped = stream_decoded(&files[0], &mut |_| {
+            calls += 1;
+            false
+        });
+        assert_eq!((stopped, calls), (None, 1));
+
+        DOCUMENTS.remove(doc);
+    }
+}
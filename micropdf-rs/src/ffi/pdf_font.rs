@@ -3,6 +3,7 @@
 //! Provides PDF-specific font handling including font descriptors,
 //! CID/GID/Unicode mapping, metrics, and font embedding.
 
+use crate::ffi::pdf_subset::subset_fonts;
 use crate::ffi::{Handle, HandleStore};
 use std::collections::HashMap;
 use std::ffi::{CStr, CString, c_char};
@@ -1022,14 +1023,24 @@ pub extern "C" fn pdf_font_writing_supported(_ctx: ContextHandle, _font: FontHan
 }
 
 /// Subset fonts in document.
+///
+/// Embedded TrueType CID fonts are cut down to the glyphs pages `pages`
+/// (`pages_len` page indices; null for every page) show, each font on a
+/// thread of its own. See `pdf_subset` for which fonts qualify.
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_subset_fonts(
     _ctx: ContextHandle,
-    _doc: DocumentHandle,
-    _pages_len: i32,
-    _pages: *const i32,
+    doc: DocumentHandle,
+    pages_len: i32,
+    pages: *const i32,
 ) {
-    // In a full implementation, this would subset embedded fonts
+    let pages = if pages.is_null() || pages_len <= 0 {
+        None
+    } else {
+        // SAFETY: the caller passes `pages_len` page indices
+        Some(unsafe { std::slice::from_raw_parts(pages, pages_len as usize) })
+    };
+    subset_fonts(doc, pages, 0);
 }
 
 // ============================================================================
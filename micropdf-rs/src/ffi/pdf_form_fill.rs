@@ -0,0 +1,921 @@
+//! Bulk Form Fill
+//!
+//! Filling a form one field at a time crosses the FFI per field and
+//! regenerates each field's appearance as soon as its value changes, so a
+//! mail merge of a few hundred fields spends most of its time laying out
+//! text that is about to change again. Here a whole map of field names
+//! to values is applied in one call: every value is set first, the
+//! document's calculation order runs once over the result, and then the
+//! appearance of every text and choice widget that changed is laid out in
+//! one parallel pass before the document is written out once.
+//!
+//! Calculations written with the viewer's AFSimple_Calculate (sums,
+//! products, averages, minimums and maximums of other fields) are run
+//! natively; other calculation scripts are left for the viewer.
+
+use super::display_list::fz_purge_display_list_cache;
+use super::pdf_image_rewriter::resolve;
+use super::pdf_interpret::pdf_purge_content_program_cache;
+use super::pdf_parse::ParsedValue;
+use super::pdf_stream_prefetch::parallel_map;
+use super::pdf_vectorize::{number, operators, simple_widths, write_number};
+use super::pdf_write::{Edits, WriteSettings, open_source, set_key, write_opened};
+use super::pdf_xref::Xref;
+use super::pdf_xref_lazy::{as_int, as_ref, decode_stream, dict_get, is_name};
+use super::{DOCUMENTS, Handle};
+use bytes::Bytes;
+use std::collections::{HashMap, HashSet};
+
+/// Deepest field tree walked
+const MAX_FIELD_DEPTH: usize = 32;
+
+/// Field flags (PDF 32000-1 12.7.3.1, 12.7.4)
+const FF_MULTILINE: i64 = 1 << 12;
+const FF_PASSWORD: i64 = 1 << 13;
+const FF_RADIO: i64 = 1 << 15;
+const FF_PUSHBUTTON: i64 = 1 << 16;
+const FF_COMB: i64 = 1 << 24;
+
+/// Gap between a widget's edge and its text
+const PADDING: f32 = 2.0;
+
+/// Line height, and the baseline's height within a line, in text space
+/// units per unit of font size
+const LEADING: f32 = 1.15;
+const DESCENT: f32 = 0.22;
+
+/// Font size for auto-sized multiline text
+const MULTILINE_SIZE: f32 = 12.0;
+
+/// Helvetica's widths for codes 32 to 126, for fonts without Widths
+const HELVETICA: [u16; 95] = [
+    278, 278, 355, 556, 556, 889, 667, 191, 333, 333, 389, 584, 278, 333, 278, 278, 556, 556, 556,
+    556, 556, 556, 556, 556, 556, 556, 278, 278, 584, 584, 584, 556, 1015, 667, 667, 722, 722, 667,
+    611, 778, 722, 278, 500, 667, 556, 833, 722, 778, 667, 778, 722, 667, 611, 722, 667, 944, 667,
+    667, 611, 278, 278, 278, 469, 556, 333, 556, 556, 500, 556, 556, 278, 556, 556, 222, 222, 500,
+    222, 833, 556, 556, 556, 556, 333, 500, 278, 556, 500, 722, 500, 500, 500, 334, 260, 334, 584,
+];
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub(crate) enum Kind {
+    Text,
+    Choice,
+    Check,
+    Radio,
+    /// Signatures and push buttons, whose values aren't filled
+    Signature,
+    Other,
+}
+
+/// A terminal field of the form, with what its children inherit resolved
+#[derive(Clone)]
+pub(crate) struct Field {
+    pub(crate) num: i32,
+    pub(crate) kind: Kind,
+    pub(crate) flags: i64,
+    da: Option<Vec<u8>>,
+    quadding: i64,
+    pub(crate) max_len: Option<usize>,
+    pub(crate) widgets: Vec<i32>,
+    pub(crate) value: String,
+}
+
+/// What a field passes down to its kids
+#[derive(Clone, Default)]
+struct Inherited {
+    name: String,
+    ft: Option<String>,
+    flags: i64,
+    da: Option<Vec<u8>>,
+    quadding: i64,
+    max_len: Option<usize>,
+}
+
+/// A PDF text string as UTF-8
+pub(crate) fn text_string(bytes: &[u8]) -> String {
+    match bytes {
+        [0xfe, 0xff, rest @ ..] => {
+            let units: Vec<u16> = rest
+                .chunks_exact(2)
+                .map(|u| u16::from_be_bytes([u[0], u[1]]))
+                .collect();
+            String::from_utf16_lossy(&units)
+        }
+        _ => bytes.iter().map(|&b| char::from(b)).collect(),
+    }
+}
+
+/// `text` as a PDF text string: its bytes if it is ASCII, UTF-16BE
+/// otherwise
+fn encode_text(text: &str) -> Vec<u8> {
+    if text.is_ascii() {
+        return text.as_bytes().to_vec();
+    }
+    let mut out = vec![0xfe, 0xff];
+    for unit in text.encode_utf16() {
+        out.extend_from_slice(&unit.to_be_bytes());
+    }
+    out
+}
+
+/// A field's value as text: strings as they read, names as named
+fn value_text(value: Option<&ParsedValue>) -> String {
+    match value {
+        Some(ParsedValue::String(bytes)) => text_string(bytes),
+        Some(ParsedValue::Name(name)) => name.clone(),
+        Some(ParsedValue::Array(items)) => value_text(items.first()),
+        _ => String::new(),
+    }
+}
+
+/// Every terminal field under `fields`, by full name
+fn form_fields(
+    xref: &mut Xref,
+    fields: Vec<ParsedValue>,
+    form_da: Option<Vec<u8>>,
+) -> HashMap<String, Field> {
+    let top = Inherited {
+        da: form_da,
+        ..Inherited::default()
+    };
+    let mut stack: Vec<(ParsedValue, Inherited, usize)> = fields
+        .into_iter()
+        .rev()
+        .map(|f| (f, top.clone(), 0))
+        .collect();
+    let mut seen = HashSet::new();
+    let mut found = HashMap::new();
+    while let Some((node, parent, depth)) = stack.pop() {
+        let Some(num) = as_ref(&node).filter(|&n| seen.insert(n)) else {
+            continue;
+        };
+        let Some(dict) = resolve(xref, &node) else {
+            continue;
+        };
+        let mut here = parent;
+        if let Some(ParsedValue::String(t)) = dict_get(&dict, "T") {
+            let t = text_string(t);
+            here.name = match here.name.is_empty() {
+                true => t,
+                false => format!("{}.{t}", here.name),
+            };
+        }
+        if let Some(ParsedValue::Name(ft)) = dict_get(&dict, "FT") {
+            here.ft = Some(ft.clone());
+        }
+        if let Some(ff) = dict_get(&dict, "Ff").and_then(as_int) {
+            here.flags = ff;
+        }
+        if let Some(ParsedValue::String(da)) = dict_get(&dict, "DA") {
+            here.da = Some(da.clone());
+        }
+        if let Some(q) = dict_get(&dict, "Q").and_then(as_int) {
+            here.quadding = q;
+        }
+        if let Some(n) = dict_get(&dict, "MaxLen").and_then(as_int) {
+            here.max_len = usize::try_from(n).ok();
+        }
+
+        // Kids with names are fields of their own; the rest are widgets
+        let kids = match dict_get(&dict, "Kids").and_then(|k| resolve(xref, k)) {
+            Some(ParsedValue::Array(kids)) => kids,
+            _ => Vec::new(),
+        };
+        let mut widgets = Vec::new();
+        let mut fields = Vec::new();
+        for kid in kids {
+            let named = resolve(xref, &kid).is_some_and(|k| dict_get(&k, "T").is_some());
+            match as_ref(&kid) {
+                Some(_) if named => fields.push(kid),
+                Some(n) => widgets.push(n),
+                None => {}
+            }
+        }
+        if fields.is_empty() {
+            if widgets.is_empty() {
+                widgets.push(num);
+            }
+            let kind = match here.ft.as_deref() {
+                Some("Tx") => Kind::Text,
+                Some("Ch") => Kind::Choice,
+                Some("Btn") if here.flags & FF_PUSHBUTTON != 0 => Kind::Other,
+                Some("Btn") if here.flags & FF_RADIO != 0 => Kind::Radio,
+                Some("Btn") => Kind::Check,
+                Some("Sig") => Kind::Signature,
+                _ => Kind::Other,
+            };
+            let field = Field {
+                num,
+                kind,
+                flags: here.flags,
+                da: here.da.clone(),
+                quadding: here.quadding,
+                max_len: here.max_len,
+                widgets,
+                value: value_text(dict_get(&dict, "V")),
+            };
+            found.entry(here.name.clone()).or_insert(field);
+        } else if depth < MAX_FIELD_DEPTH {
+            stack.extend(
+                fields
+                    .into_iter()
+                    .rev()
+                    .map(|k| (k, here.clone(), depth + 1)),
+            );
+        }
+    }
+    found
+}
+
+/// The AcroForm dictionary of the document `trailer` belongs to, with its
+/// terminal fields by full name
+pub(crate) fn document_form(
+    xref: &mut Xref,
+    trailer: &ParsedValue,
+) -> Option<(ParsedValue, HashMap<String, Field>)> {
+    let form = dict_get(trailer, "Root")
+        .and_then(|r| resolve(xref, r))
+        .and_then(|catalog| dict_get(&catalog, "AcroForm").cloned())
+        .and_then(|f| resolve(xref, &f))?;
+    let fields = match dict_get(&form, "Fields").and_then(|f| resolve(xref, f)) {
+        Some(ParsedValue::Array(fields)) => fields,
+        _ => return None,
+    };
+    let form_da = match dict_get(&form, "DA") {
+        Some(ParsedValue::String(da)) => Some(da.clone()),
+        _ => None,
+    };
+    let fields = form_fields(xref, fields, form_da);
+    Some((form, fields))
+}
+
+/// The appearance states widget `dict` can be in besides Off
+fn on_states(xref: &mut Xref, dict: &ParsedValue) -> Vec<String> {
+    let normal = dict_get(dict, "AP")
+        .and_then(|ap| resolve(xref, ap))
+        .and_then(|ap| dict_get(&ap, "N").and_then(|n| resolve(xref, n)));
+    match normal {
+        Some(ParsedValue::Dict(states)) => states
+            .into_iter()
+            .map(|(name, _)| name)
+            .filter(|name| name != "Off")
+            .collect(),
+        _ => Vec::new(),
+    }
+}
+
+/// Whether `value` asks for a check box to be checked without naming
+/// its state
+fn is_truthy(value: &str) -> bool {
+    ["true", "yes", "on", "1"]
+        .iter()
+        .any(|t| value.eq_ignore_ascii_case(t))
+}
+
+/// A calculation script's operation and the names of its operands, if it
+/// is an AFSimple_Calculate call
+fn simple_calculation(script: &str) -> Option<(String, Vec<String>)> {
+    let args = script.split_once("AFSimple_Calculate")?.1;
+    let args = args.trim_start().strip_prefix('(')?;
+    let args = &args[..args.rfind(')')?];
+    // Every quoted string: the operation, then the field names, either
+    // one per string or comma separated in a single one
+    let mut strings = Vec::new();
+    let mut rest = args;
+    while let Some(open) = rest.find(['"', '\'']) {
+        let quote = rest[open..].chars().next()?;
+        let body = &rest[open + 1..];
+        let close = body.find(quote)?;
+        strings.push(body[..close].to_string());
+        rest = &body[close + 1..];
+    }
+    let mut strings = strings.into_iter();
+    let op = strings.next()?.to_ascii_uppercase();
+    let names = strings
+        .flat_map(|s| {
+            s.split(',')
+                .map(|n| n.trim().to_string())
+                .collect::<Vec<_>>()
+        })
+        .filter(|n| !n.is_empty())
+        .collect();
+    Some((op, names))
+}
+
+/// Result of calculation `op` over `values`, formatted as a field value
+fn calculate(op: &str, values: &[f64]) -> Option<String> {
+    let result = match op {
+        "SUM" => values.iter().sum(),
+        "PRD" => values.iter().product(),
+        "AVG" if !values.is_empty() => values.iter().sum::<f64>() / values.len() as f64,
+        "MIN" => values.iter().copied().reduce(f64::min)?,
+        "MAX" => values.iter().copied().reduce(f64::max)?,
+        "AVG" => 0.0,
+        _ => return None,
+    };
+    let rounded = format!("{result:.10}");
+    let trimmed = rounded.trim_end_matches('0').trim_end_matches('.');
+    Some(match trimmed {
+        "-0" | "" => "0".to_string(),
+        t => t.to_string(),
+    })
+}
+
+/// A field's calculation script
+fn calculation_script(xref: &mut Xref, dict: &ParsedValue) -> Option<String> {
+    let action = dict_get(dict, "AA")
+        .and_then(|aa| resolve(xref, aa))
+        .and_then(|aa| dict_get(&aa, "C").and_then(|c| resolve(xref, c)))?;
+    let js = dict_get(&action, "JS")?;
+    let bytes = match js {
+        ParsedValue::String(bytes) => bytes.clone(),
+        ParsedValue::Reference { num, .. } => {
+            let fetched = xref.fetch(*num)?;
+            decode_stream(&fetched.value, fetched.stream.as_ref()?)?
+        }
+        _ => return None,
+    };
+    Some(text_string(&bytes))
+}
+
+/// Glyph widths of an appearance's font, in thousandths of its size
+struct FontWidths {
+    widths: HashMap<u32, f32>,
+    fixed: Option<f32>,
+}
+
+impl FontWidths {
+    fn load(xref: &mut Xref, font: Option<&ParsedValue>) -> Self {
+        let font = font.and_then(|f| resolve(xref, f));
+        let widths = font
+            .as_ref()
+            .map_or_else(HashMap::new, |f| simple_widths(xref, f, 1.0));
+        let courier = font.as_ref().is_some_and(|f| {
+            matches!(dict_get(f, "BaseFont"), Some(ParsedValue::Name(n)) if n.contains("Courier"))
+        });
+        Self {
+            widths,
+            fixed: courier.then_some(600.0),
+        }
+    }
+
+    fn width(&self, code: u8) -> f32 {
+        if let Some(&w) = self.widths.get(&u32::from(code)) {
+            return w;
+        }
+        if let Some(w) = self.fixed {
+            return w;
+        }
+        match code {
+            32..=126 => f32::from(HELVETICA[usize::from(code - 32)]),
+            _ => 556.0,
+        }
+    }
+
+    /// Width of `bytes` at size 1
+    fn measure(&self, bytes: &[u8]) -> f32 {
+        bytes.iter().map(|&b| self.width(b)).sum::<f32>() / 1000.0
+    }
+}
+
+/// One widget's appearance to lay out
+struct Layout {
+    widget: i32,
+    width: f32,
+    height: f32,
+    /// Default appearance operators, and the font name and size its Tf
+    /// selects
+    da: Vec<u8>,
+    font: Option<String>,
+    size: f32,
+    quadding: i64,
+    multiline: bool,
+    comb: Option<usize>,
+    /// The value in the font's single-byte encoding
+    text: Vec<u8>,
+    widths: FontWidths,
+    resources: ParsedValue,
+}
+
+/// The font name and size `da`'s Tf selects
+fn da_font(da: &[u8]) -> (Option<String>, f32) {
+    let ops = operators(da);
+    let Some(tf) = ops.iter().rev().find(|op| op.name == b"Tf") else {
+        return (None, 0.0);
+    };
+    let name = tf.operands.first().and_then(|&(s, e)| {
+        let token = std::str::from_utf8(&da[s..e]).ok()?;
+        Some(token.strip_prefix('/')?.to_string())
+    });
+    let size = tf
+        .operands
+        .get(1)
+        .and_then(|&(s, e)| std::str::from_utf8(&da[s..e]).ok()?.parse().ok())
+        .unwrap_or(0.0);
+    (name, size)
+}
+
+/// `text` in a simple font's encoding: Latin-1, with '?' for the rest
+fn single_byte(text: &str) -> Vec<u8> {
+    text.chars()
+        .filter(|&c| c != '\r')
+        .map(|c| u8::try_from(u32::from(c)).unwrap_or(b'?'))
+        .collect()
+}
+
+fn write_string(bytes: &[u8], out: &mut Vec<u8>) {
+    out.push(b'(');
+    for &b in bytes {
+        match b {
+            b'(' | b')' | b'\\' => out.extend_from_slice(&[b'\\', b]),
+            b'\n' => out.extend_from_slice(b"\\n"),
+            _ => out.push(b),
+        }
+    }
+    out.extend_from_slice(b") Tj\n");
+}
+
+/// `text` broken into lines no wider than `avail` at size 1, at spaces
+/// where it can be and anywhere where it can't
+fn wrap(text: &[u8], widths: &FontWidths, avail: f32) -> Vec<Vec<u8>> {
+    let mut lines = Vec::new();
+    for paragraph in text.split(|&b| b == b'\n') {
+        let mut line: Vec<u8> = Vec::new();
+        for word in paragraph.split(|&b| b == b' ') {
+            let candidate = match line.is_empty() {
+                true => word.to_vec(),
+                false => [&line[..], b" ", word].concat(),
+            };
+            if widths.measure(&candidate) <= avail || line.is_empty() {
+                line = candidate;
+            } else {
+                lines.push(std::mem::take(&mut line));
+                line = word.to_vec();
+            }
+            // A word wider than the line on its own is cut where it must be
+            while widths.measure(&line) > avail && line.len() > 1 {
+                let mut fit = 1;
+                while fit < line.len() && widths.measure(&line[..fit + 1]) <= avail {
+                    fit += 1;
+                }
+                lines.push(line[..fit].to_vec());
+                line.drain(..fit);
+            }
+        }
+        lines.push(line);
+    }
+    lines
+}
+
+/// The content of `layout`'s appearance stream
+fn appearance(layout: &Layout) -> Vec<u8> {
+    let inner_w = (layout.width - 2.0 * PADDING).max(0.0);
+    let inner_h = (layout.height - 2.0 * PADDING).max(0.0);
+    let text_w = layout.widths.measure(&layout.text);
+    let size = match layout.size {
+        s if s > 0.0 => s,
+        _ if layout.multiline => MULTILINE_SIZE,
+        // Auto size: as tall as the widget allows, then as narrow as the
+        // text needs
+        _ => {
+            let tall = inner_h / LEADING;
+            match text_w * tall > inner_w && text_w > 0.0 {
+                true => inner_w / text_w,
+                false => tall,
+            }
+        }
+    }
+    .max(1.0);
+
+    let mut out = b"/Tx BMC\nq\n".to_vec();
+    for v in [PADDING, PADDING, inner_w, inner_h] {
+        write_number(v, &mut out);
+    }
+    out.extend_from_slice(b"re W n\nBT\n");
+    // The default appearance with its size settled
+    let da = &layout.da;
+    let ops = operators(da);
+    for op in &ops {
+        match (op.name, layout.font.as_ref()) {
+            (b"Tf", Some(font)) => {
+                out.extend_from_slice(format!("/{font} ").as_bytes());
+                write_number(size, &mut out);
+                out.extend_from_slice(b"Tf\n");
+            }
+            _ => {
+                out.extend_from_slice(&da[op.start..op.end]);
+                out.push(b'\n');
+            }
+        }
+    }
+    let x_for = |w: f32| match layout.quadding {
+        1 => (layout.width - w) / 2.0,
+        2 => layout.width - PADDING - w,
+        _ => PADDING,
+    };
+
+    if let Some(cells) = layout.comb.filter(|&n| n > 0) {
+        let cell = layout.width / cells as f32;
+        let y = (layout.height - size) / 2.0 + DESCENT * size;
+        for (i, &b) in layout.text.iter().take(cells).enumerate() {
+            let w = layout.widths.width(b) / 1000.0 * size;
+            out.extend_from_slice(b"1 0 0 1 ");
+            write_number(cell * i as f32 + (cell - w) / 2.0, &mut out);
+            write_number(y, &mut out);
+            out.extend_from_slice(b"Tm\n");
+            write_string(&[b], &mut out);
+        }
+    } else if layout.multiline {
+        let lines = wrap(&layout.text, &layout.widths, inner_w / size);
+        let mut y = layout.height - PADDING - size * (1.0 - DESCENT);
+        for line in &lines {
+            let w = layout.widths.measure(line) * size;
+            out.extend_from_slice(b"1 0 0 1 ");
+            write_number(x_for(w), &mut out);
+            write_number(y, &mut out);
+            out.extend_from_slice(b"Tm\n");
+            write_string(line, &mut out);
+            y -= size * LEADING;
+        }
+    } else {
+        let y = (layout.height - size) / 2.0 + DESCENT * size;
+        out.extend_from_slice(b"1 0 0 1 ");
+        write_number(x_for(text_w * size), &mut out);
+        write_number(y, &mut out);
+        out.extend_from_slice(b"Tm\n");
+        write_string(&layout.text, &mut out);
+    }
+    out.extend_from_slice(b"ET\nQ\nEMC\n");
+    out
+}
+
+/// Object `num`'s value, or null if it has none
+pub(crate) fn value_of(xref: &mut Xref, num: i32) -> ParsedValue {
+    xref.fetch(num).map_or(ParsedValue::Null, |f| f.value)
+}
+
+/// Width and height of widget `dict`'s Rect
+fn widget_size(dict: &ParsedValue) -> Option<(f32, f32)> {
+    let Some(ParsedValue::Array(rect)) = dict_get(dict, "Rect") else {
+        return None;
+    };
+    let r: Vec<f32> = rect.iter().filter_map(number).collect();
+    match r[..] {
+        [x0, y0, x1, y1] => Some(((x1 - x0).abs(), (y1 - y0).abs())),
+        _ => None,
+    }
+}
+
+/// Set each field of document `doc` named in `values` to its value, run
+/// the form's calculations once and regenerate the changed appearances
+/// on `threads` threads
+///
+/// Values of check boxes and radio buttons name the state to turn on
+/// ("Off" for none); a check box also takes "true", "yes", "on" or "1".
+/// The document's data is replaced if anything changed. Returns the
+/// number of fields set, not counting calculated ones, or -1 if `doc`
+/// can't be read.
+pub(crate) fn fill_form(doc: Handle, values: &[(String, String)], threads: usize) -> i32 {
+    let Some(data) = DOCUMENTS.get(doc).map(|d| d.lock().unwrap().data()) else {
+        return -1;
+    };
+    let Some(mut xref) = open_source(&data, threads) else {
+        return -1;
+    };
+    xref.read_all_sections();
+    let Some(trailer) = xref.source_trailer().cloned() else {
+        return -1;
+    };
+    if dict_get(&trailer, "Encrypt").is_some() {
+        return -1;
+    }
+    let Some((form, mut fields)) = document_form(&mut xref, &trailer) else {
+        return 0;
+    };
+
+    // Objects as edited so far
+    let mut edited: HashMap<i32, ParsedValue> = HashMap::new();
+    let mut relaid: Vec<String> = Vec::new();
+    let mut filled = 0;
+
+    for (name, value) in values {
+        let Some(field) = fields.get_mut(name.as_str()) else {
+            continue;
+        };
+        match field.kind {
+            Kind::Text | Kind::Choice => {
+                let mut dict = edited
+                    .remove(&field.num)
+                    .unwrap_or_else(|| value_of(&mut xref, field.num));
+                let encoded = ParsedValue::String(encode_text(value));
+                set_key(&mut dict, "V", Some(encoded));
+                edited.insert(field.num, dict);
+                field.value = value.clone();
+                relaid.push(name.clone());
+            }
+            Kind::Check | Kind::Radio => {
+                let mut states = Vec::new();
+                for &w in &field.widgets {
+                    let dict = edited
+                        .get(&w)
+                        .cloned()
+                        .unwrap_or_else(|| value_of(&mut xref, w));
+                    states.push(on_states(&mut xref, &dict));
+                }
+                let named = states.iter().any(|s| s.iter().any(|n| n == value));
+                let truthy = field.kind == Kind::Check && is_truthy(value);
+                let mut on = None;
+                for (&w, states) in field.widgets.iter().zip(&states) {
+                    let state = match states.iter().find(|s| *s == value) {
+                        Some(s) => Some(s.clone()),
+                        None if truthy && !named => states.first().cloned(),
+                        None => None,
+                    };
+                    on = on.or(state.clone());
+                    let mut dict = edited.remove(&w).unwrap_or_else(|| value_of(&mut xref, w));
+                    let state = state.unwrap_or_else(|| "Off".into());
+                    set_key(&mut dict, "AS", Some(ParsedValue::Name(state)));
+                    edited.insert(w, dict);
+                }
+                let on = on.unwrap_or_else(|| "Off".into());
+                let mut dict = edited
+                    .remove(&field.num)
+                    .unwrap_or_else(|| value_of(&mut xref, field.num));
+                set_key(&mut dict, "V", Some(ParsedValue::Name(on.clone())));
+                edited.insert(field.num, dict);
+                field.value = on;
+            }
+            Kind::Signature | Kind::Other => continue,
+        }
+        filled += 1;
+    }
+    if filled == 0 {
+        return 0;
+    }
+
+    // The calculation order, run once over the filled values
+    if let Some(ParsedValue::Array(order)) =
+        dict_get(&form, "CO").and_then(|c| resolve(&mut xref, c))
+    {
+        let by_num: HashMap<i32, String> = fields
+            .iter()
+            .map(|(name, field)| (field.num, name.clone()))
+            .collect();
+        for num in order.iter().filter_map(as_ref) {
+            let Some(name) = by_num.get(&num) else {
+                continue;
+            };
+            let dict = edited
+                .get(&num)
+                .cloned()
+                .unwrap_or_else(|| value_of(&mut xref, num));
+            let Some((op, operands)) =
+                calculation_script(&mut xref, &dict).and_then(|s| simple_calculation(&s))
+            else {
+                continue;
+            };
+            let numbers: Vec<f64> = operands
+                .iter()
+                .filter_map(|n| fields.get(n.as_str()))
+                .map(|f| f.value.trim().parse().unwrap_or(0.0))
+                .collect();
+            let Some(result) = calculate(&op, &numbers) else {
+                continue;
+            };
+            let field = fields.get_mut(name.as_str()).unwrap();
+            if field.value == result || !matches!(field.kind, Kind::Text | Kind::Choice) {
+                continue;
+            }
+            let mut dict = edited.remove(&num).unwrap_or(dict);
+            set_key(
+                &mut dict,
+                "V",
+                Some(ParsedValue::String(encode_text(&result))),
+            );
+            edited.insert(num, dict);
+            field.value = result;
+            relaid.push(name.clone());
+        }
+    }
+
+    // Gather the layouts serially, then lay them out in parallel
+    let dr = dict_get(&form, "DR").and_then(|d| resolve(&mut xref, d));
+    let fonts = dr
+        .as_ref()
+        .and_then(|dr| dict_get(dr, "Font"))
+        .and_then(|f| resolve(&mut xref, f));
+    let mut layouts = Vec::new();
+    let mut laid = HashSet::new();
+    for name in &relaid {
+        let field = &fields[name.as_str()];
+        for &w in &field.widgets {
+            if !laid.insert(w) {
+                continue;
+            }
+            let dict = edited
+                .get(&w)
+                .cloned()
+                .unwrap_or_else(|| value_of(&mut xref, w));
+            let Some((width, height)) = widget_size(&dict) else {
+                continue;
+            };
+            let da = match dict_get(&dict, "DA") {
+                Some(ParsedValue::String(da)) => da.clone(),
+                _ => field
+                    .da
+                    .clone()
+                    .unwrap_or_else(|| b"/Helv 0 Tf 0 g".to_vec()),
+            };
+            let (font, size) = da_font(&da);
+            let font_ref = font
+                .as_deref()
+                .and_then(|f| fonts.as_ref().and_then(|fonts| dict_get(fonts, f)))
+                .cloned();
+            let widths = FontWidths::load(&mut xref, font_ref.as_ref());
+            let resources = match (&font, font_ref) {
+                (Some(font), Some(font_ref)) => ParsedValue::Dict(vec![(
+                    "Font".into(),
+                    ParsedValue::Dict(vec![(font.clone(), font_ref)]),
+                )]),
+                _ => ParsedValue::Dict(Vec::new()),
+            };
+            let shown = match field.flags & FF_PASSWORD {
+                0 => field.value.clone(),
+                _ => "*".repeat(field.value.chars().count()),
+            };
+            let comb = (field.kind == Kind::Text && field.flags & FF_COMB != 0)
+                .then_some(field.max_len)
+                .flatten();
+            layouts.push(Layout {
+                widget: w,
+                width,
+                height,
+                da,
+                font,
+                size,
+                quadding: field.quadding,
+                multiline: field.kind == Kind::Text && field.flags & FF_MULTILINE != 0,
+                comb,
+                text: single_byte(&shown),
+                widths,
+                resources,
+            });
+        }
+    }
+    let streams = parallel_map(&layouts, threads, appearance);
+
+    let mut edits = Edits::default();
+    let mut next = dict_get(&trailer, "Size")
+        .and_then(as_int)
+        .map_or(0, |n| n as i32)
+        .max(xref.num_objects)
+        .max(1);
+    for (layout, content) in layouts.iter().zip(streams) {
+        let mut bbox = Vec::new();
+        for v in [0.0, 0.0, layout.width, layout.height] {
+            bbox.push(ParsedValue::Real(v));
+        }
+        let dict = ParsedValue::Dict(vec![
+            ("Type".into(), ParsedValue::Name("XObject".into())),
+            ("Subtype".into(), ParsedValue::Name("Form".into())),
+            ("BBox".into(), ParsedValue::Array(bbox)),
+            ("Resources".into(), layout.resources.clone()),
+            ("Length".into(), ParsedValue::Int(content.len() as i64)),
+        ]);
+        edits.added_streams.push((next, dict, Bytes::from(content)));
+        let mut widget = edited
+            .remove(&layout.widget)
+            .unwrap_or_else(|| value_of(&mut xref, layout.widget));
+        let ap = ParsedValue::Dict(vec![(
+            "N".into(),
+            ParsedValue::Reference {
+                num: next,
+                generation: 0,
+            },
+        )]);
+        set_key(&mut widget, "AP", Some(ap));
+        edited.insert(layout.widget, widget);
+        next += 1;
+    }
+    edits.objects = edited;
+
+    let settings = WriteSettings {
+        compress: false,
+        decompress: false,
+        threads,
+        ..WriteSettings::default()
+    };
+    let mut out = Vec::new();
+    let saved = matches!(
+        write_opened(xref, &settings, &edits, &mut out),
+        Some(Ok(()))
+    );
+    match DOCUMENTS.get(doc).filter(|_| saved) {
+        Some(d) => {
+            d.lock().unwrap().replace_data(out);
+            pdf_purge_content_program_cache(0, doc);
+            fz_purge_display_list_cache(0, doc);
+            filled
+        }
+        None => -1,
+    }
+}
+
+#[cfg(test)]
+pub(crate) mod tests {
+    use super::*;
+    use crate::ffi::document::Document;
+    use crate::ffi::pdf_image_rewriter::tests::{pdf_with, stream};
+
+    pub(crate) fn form() -> Vec<u8> {
+        pdf_with(&[
+            b"<< /Type /Catalog /Pages 2 0 R /AcroForm << /Fields [4 0 R 5 0 R 6 0 R 7 0 R] \
+              /DA (/Helv 0 Tf 0 g) /DR << /Font << /Helv 8 0 R >> >> /CO [7 0 R] >> >>"
+                .to_vec(),
+            b"<< /Type /Pages /Kids [3 0 R] /Count 1 >>".to_vec(),
+            b"<< /Type /Page /Parent 2 0 R /MediaBox [0 0 200 200] \
+              /Annots [4 0 R 5 0 R 9 0 R 7 0 R] >>"
+                .to_vec(),
+            b"<< /FT /Tx /T (name) /Subtype /Widget /Rect [10 10 110 30] >>".to_vec(),
+            b"<< /FT /Tx /T (qty) /Subtype /Widget /Rect [10 40 60 60] /Q 2 >>".to_vec(),
+            b"<< /FT /Btn /T (agree) /Kids [9 0 R] >>".to_vec(),
+            b"<< /FT /Tx /T (total) /Subtype /Widget /Rect [10 70 60 90] \
+              /AA << /C << /S /JavaScript /JS (AFSimple_Calculate\\(\"SUM\", new Array \\(\"qty\", \"extra\"\\)\\);) >> >> >>"
+                .to_vec(),
+            b"<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>".to_vec(),
+            stream(
+                "/Subtype /Widget /Parent 6 0 R /Rect [10 100 20 110] /AS /Off \
+                 /AP << /N << /Yes 10 0 R /Off 10 0 R >> >>",
+                b"",
+            ),
+            stream("/Subtype /Form /BBox [0 0 10 10]", b""),
+        ])
+    }
+
+    fn reopen(doc: Handle) -> Xref {
+        let data = DOCUMENTS.get(doc).unwrap().lock().unwrap().data();
+        let mut xref = open_source(&data, 1).unwrap();
+        xref.read_all_sections();
+        xref
+    }
+
+    #[test]
+    fn test_simple_calculation() {
+        assert_eq!(
+            simple_calculation("AFSimple_Calculate(\"SUM\", new Array (\"a\", \"b.c\"));"),
+            Some(("SUM".into(), vec!["a".into(), "b.c".into()]))
+        );
+        assert_eq!(
+            simple_calculation("AFSimple_Calculate('avg', 'a, b')"),
+            Some(("AVG".into(), vec!["a".into(), "b".into()]))
+        );
+        assert_eq!(simple_calculation("event.value = 1"), None);
+        assert_eq!(calculate("SUM", &[0.1, 0.2]).as_deref(), Some("0.3"));
+        assert_eq!(calculate("MAX", &[]), None);
+    }
+
+    #[test]
+    fn test_wrap_breaks_at_spaces() {
+        let widths = FontWidths {
+            widths: HashMap::new(),
+            fixed: Some(500.0),
+        };
+        let lines = wrap(b"ab cd efghij\nk", &widths, 2.5);
+        assert_eq!(lines, [&b"ab cd"[..], b"efghi", b"j", b"k"]);
+    }
+
+    #[test]
+    fn test_fill_form_sets_values_and_appearances() {
+        let doc = DOCUMENTS.insert(Document::new(form()));
+        let values = [
+            ("name".to_string(), "Zoë (Z)".to_string()),
+            ("qty".to_string(), "3".to_string()),
+            ("agree".to_string(), "true".to_string()),
+            ("missing".to_string(), "x".to_string()),
+        ];
+        assert_eq!(fill_form(doc, &values, 2), 3);
+
+        let mut xref = reopen(doc);
+        let name = xref.fetch(4).unwrap().value;
+        assert_eq!(value_text(dict_get(&name, "V")), "Zoë (Z)");
+        let total = xref.fetch(7).unwrap().value;
+        assert_eq!(value_text(dict_get(&total, "V")), "3");
+        let agree = xref.fetch(6).unwrap().value;
+        assert!(is_name(dict_get(&agree, "V"), "Yes"));
+        let widget = xref.fetch(9).unwrap().value;
+        assert!(is_name(dict_get(&widget, "AS"), "Yes"));
+
+        // Each text widget that changed has a new appearance
+        for num in [4, 5, 7] {
+            let widget = xref.fetch(num).unwrap().value;
+            let ap = dict_get(&widget, "AP").unwrap();
+            let n = as_ref(dict_get(ap, "N").unwrap()).unwrap();
+            let fetched = xref.fetch(n).unwrap();
+            let content = decode_stream(&fetched.value, &fetched.stream.unwrap()).unwrap();
+            let content = String::from_utf8_lossy(&content).into_owned();
+            assert!(content.starts_with("/Tx BMC"), "{content}");
+            assert!(content.contains("/Helv "), "{content}");
+        }
+        DOCUMENTS.remove(doc);
+    }
+}
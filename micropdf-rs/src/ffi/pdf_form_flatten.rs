@@ -0,0 +1,461 @@
+//! Form Flattening
+//!
+//! Flattening draws each widget's normal appearance into the content of
+//! its page and drops the widget and the interactive form, so the page
+//! looks the same and nothing is left to fill. The appearances are drawn
+//! as the Form XObjects they already are, placed as a viewer would place
+//! them (PDF 32000-1 12.5.5): the appearance's BBox, transformed by its
+//! Matrix, is fitted to the widget's Rect.
+//!
+//! Filled forms repeat the same few appearances (every check mark, every
+//! empty field) across widgets and pages, so appearance streams are
+//! deduplicated first, hashed and compared as the object deduplication
+//! of the writer does, and all widgets drawing equal appearances name one
+//! XObject. The pages are then laid out on a pool of threads and the
+//! document goes out once through the streaming rewrite, with everything
+//! else copied as it is. Hidden widgets and widgets without an
+//! appearance are dropped without drawing.
+
+use super::display_list::fz_purge_display_list_cache;
+use super::pdf_dedup::duplicate_objects;
+use super::pdf_image_rewriter::{inherited, resolve};
+use super::pdf_interpret::pdf_purge_content_program_cache;
+use super::pdf_parse::ParsedValue;
+use super::pdf_stream_prefetch::parallel_map;
+use super::pdf_vectorize::{number, write_number};
+use super::pdf_write::{Edits, WriteSettings, open_source, set_key, write_opened};
+use super::pdf_xref::Xref;
+use super::pdf_xref_lazy::{as_int, as_ref, dict_get, is_name};
+use super::{DOCUMENTS, Handle};
+use crate::fitz::geometry::{Matrix, Rect};
+use bytes::Bytes;
+use std::collections::{HashMap, HashSet};
+
+/// Hidden and NoView annotation flags
+const HIDDEN: i64 = 1 << 1;
+const NO_VIEW: i64 = 1 << 5;
+
+/// Deepest field tree walked for the objects to drop
+const MAX_FIELD_DEPTH: usize = 32;
+
+/// A widget's appearance, placed on its page
+struct Placed {
+    /// Appearance stream, after deduplication
+    xobject: i32,
+    /// Maps the appearance's form space onto the page
+    matrix: Matrix,
+}
+
+/// One page to flatten, as read from the source
+struct PageJob {
+    num: i32,
+    dict: ParsedValue,
+    resources: ParsedValue,
+    kept_annots: Vec<ParsedValue>,
+    placed: Vec<Placed>,
+}
+
+/// Numbers of `value`, read as a Rect or Matrix of `n` entries
+fn numbers(value: Option<&ParsedValue>, n: usize) -> Option<Vec<f32>> {
+    match value {
+        Some(ParsedValue::Array(items)) if items.len() == n => items.iter().map(number).collect(),
+        _ => None,
+    }
+}
+
+/// `value` as a Rect, corners in order
+fn rect(value: Option<&ParsedValue>) -> Option<Rect> {
+    let r = numbers(value, 4)?;
+    Some(Rect::new(
+        r[0].min(r[2]),
+        r[1].min(r[3]),
+        r[0].max(r[2]),
+        r[1].max(r[3]),
+    ))
+}
+
+/// The normal appearance stream of widget `dict`, in its current state
+fn normal_appearance(xref: &mut Xref, dict: &ParsedValue) -> Option<i32> {
+    let ap = dict_get(dict, "AP").and_then(|ap| resolve(xref, ap))?;
+    let normal = dict_get(&ap, "N")?;
+    if let Some(num) = as_ref(normal) {
+        if xref.fetch(num)?.stream.is_some() {
+            return Some(num);
+        }
+    }
+    let states = resolve(xref, normal)?;
+    match dict_get(dict, "AS") {
+        Some(ParsedValue::Name(state)) => dict_get(&states, state).and_then(as_ref),
+        _ => None,
+    }
+}
+
+/// The matrix fitting appearance `form`'s transformed BBox to `target`
+fn placement(form: &ParsedValue, target: &Rect) -> Option<Matrix> {
+    let bbox = rect(dict_get(form, "BBox"))?;
+    let matrix = match numbers(dict_get(form, "Matrix"), 6) {
+        Some(m) => Matrix::new(m[0], m[1], m[2], m[3], m[4], m[5]),
+        None => Matrix::IDENTITY,
+    };
+    let bounds = bbox.transform(&matrix);
+    let (w, h) = (bounds.x1 - bounds.x0, bounds.y1 - bounds.y0);
+    if w <= 0.0 || h <= 0.0 {
+        return None;
+    }
+    let (sx, sy) = ((target.x1 - target.x0) / w, (target.y1 - target.y0) / h);
+    Some(Matrix::new(
+        sx,
+        0.0,
+        0.0,
+        sy,
+        target.x0 - bounds.x0 * sx,
+        target.y0 - bounds.y0 * sy,
+    ))
+}
+
+/// Every object of the field tree under `fields`
+fn field_objects(xref: &mut Xref, fields: &[ParsedValue]) -> HashSet<i32> {
+    let mut stack: Vec<(ParsedValue, usize)> = fields.iter().map(|f| (f.clone(), 0)).collect();
+    let mut seen = HashSet::new();
+    while let Some((node, depth)) = stack.pop() {
+        let Some(num) = as_ref(&node).filter(|&n| seen.insert(n)) else {
+            continue;
+        };
+        if depth >= MAX_FIELD_DEPTH {
+            continue;
+        }
+        let kids = xref
+            .fetch(num)
+            .and_then(|f| dict_get(&f.value, "Kids").cloned())
+            .and_then(|k| resolve(xref, &k));
+        if let Some(ParsedValue::Array(kids)) = kids {
+            stack.extend(kids.into_iter().map(|k| (k, depth + 1)));
+        }
+    }
+    seen
+}
+
+/// XObject name under which appearance `num` is drawn
+fn xobject_name(num: i32) -> String {
+    format!("FlatAP{num}")
+}
+
+/// `job`'s page with its widgets drawn into a content stream of their
+/// own: the page dictionary, and the content to wrap around the old
+fn flatten_page(job: &PageJob) -> (ParsedValue, Vec<u8>) {
+    // The old content may end mid-line
+    let mut content = b"\nQ\n".to_vec();
+    let mut names = Vec::new();
+    for placed in &job.placed {
+        let m = &placed.matrix;
+        content.extend_from_slice(b"q ");
+        for v in [m.a, m.b, m.c, m.d, m.e, m.f] {
+            write_number(v, &mut content);
+        }
+        let name = xobject_name(placed.xobject);
+        content.extend_from_slice(format!("cm /{name} Do Q\n").as_bytes());
+        if !names.iter().any(|(n, _)| *n == name) {
+            names.push((
+                name,
+                ParsedValue::Reference {
+                    num: placed.xobject,
+                    generation: 0,
+                },
+            ));
+        }
+    }
+
+    let mut dict = job.dict.clone();
+    if !names.is_empty() {
+        let mut resources = job.resources.clone();
+        let mut xobjects = match dict_get(&resources, "XObject") {
+            Some(ParsedValue::Dict(entries)) => entries.clone(),
+            _ => Vec::new(),
+        };
+        for (name, value) in names {
+            xobjects.retain(|(k, _)| *k != name);
+            xobjects.push((name, value));
+        }
+        set_key(&mut resources, "XObject", Some(ParsedValue::Dict(xobjects)));
+        set_key(&mut dict, "Resources", Some(resources));
+    }
+    let annots = match job.kept_annots.is_empty() {
+        true => None,
+        false => Some(ParsedValue::Array(job.kept_annots.clone())),
+    };
+    set_key(&mut dict, "Annots", annots);
+    (dict, content)
+}
+
+/// Draw every widget of document `doc` into its page and drop the
+/// interactive form, on `threads` threads
+///
+/// The document's data is replaced if anything changed. Returns the
+/// number of widgets flattened, or -1 if `doc` can't be read.
+pub(crate) fn flatten_form(doc: Handle, threads: usize) -> i32 {
+    let Some(data) = DOCUMENTS.get(doc).map(|d| d.lock().unwrap().data()) else {
+        return -1;
+    };
+    let Some(mut xref) = open_source(&data, threads) else {
+        return -1;
+    };
+    xref.read_all_sections();
+    let Some(trailer) = xref.source_trailer().cloned() else {
+        return -1;
+    };
+    if dict_get(&trailer, "Encrypt").is_some() {
+        return -1;
+    }
+    let Some(root) = dict_get(&trailer, "Root").and_then(as_ref) else {
+        return -1;
+    };
+    let Some(catalog) = xref.fetch(root).map(|f| f.value) else {
+        return -1;
+    };
+
+    // Widgets by page, with each appearance read once
+    let pages: Vec<i32> = (0..).map_while(|i| xref.lazy_page_object(i)).collect();
+    let mut appearances: HashMap<i32, ParsedValue> = HashMap::new();
+    let mut found = Vec::with_capacity(pages.len());
+    let mut widgets = HashSet::new();
+    for &page in &pages {
+        let Some(dict) = xref.fetch(page).map(|f| f.value) else {
+            continue;
+        };
+        let annots = match dict_get(&dict, "Annots").and_then(|a| resolve(&mut xref, a)) {
+            Some(ParsedValue::Array(annots)) => annots,
+            _ => continue,
+        };
+        let mut kept = Vec::new();
+        let mut drawn = Vec::new();
+        let mut had_widgets = false;
+        for annot in annots {
+            let Some(widget) =
+                resolve(&mut xref, &annot).filter(|a| is_name(dict_get(a, "Subtype"), "Widget"))
+            else {
+                kept.push(annot);
+                continue;
+            };
+            widgets.extend(as_ref(&annot));
+            had_widgets = true;
+            let flags = dict_get(&widget, "F").and_then(as_int).unwrap_or(0);
+            if flags & (HIDDEN | NO_VIEW) != 0 {
+                continue;
+            }
+            let (Some(num), Some(target)) = (
+                normal_appearance(&mut xref, &widget),
+                rect(dict_get(&widget, "Rect")),
+            ) else {
+                continue;
+            };
+            if let std::collections::hash_map::Entry::Vacant(slot) = appearances.entry(num) {
+                match xref.fetch(num) {
+                    Some(form) => slot.insert(form.value),
+                    None => continue,
+                };
+            }
+            drawn.push((num, target));
+        }
+        if had_widgets {
+            found.push((page, dict, kept, drawn));
+        }
+    }
+    if widgets.is_empty() {
+        return 0;
+    }
+
+    // Equal appearances drawn as one
+    let mut nums: Vec<i32> = appearances.keys().copied().collect();
+    nums.sort_unstable();
+    let merged = duplicate_objects(&mut xref, &nums, threads);
+
+    let mut jobs = Vec::with_capacity(found.len());
+    let mut flattened = 0;
+    for (page, dict, kept_annots, drawn) in found {
+        let resources = inherited(&mut xref, page, "Resources")
+            .unwrap_or_else(|| ParsedValue::Dict(Vec::new()));
+        let mut resources = match resources {
+            ParsedValue::Dict(_) => resources,
+            _ => ParsedValue::Dict(Vec::new()),
+        };
+        if let Some(xobjects) = dict_get(&resources, "XObject").cloned() {
+            let xobjects = resolve(&mut xref, &xobjects);
+            set_key(&mut resources, "XObject", xobjects);
+        }
+        let placed: Vec<Placed> = drawn
+            .iter()
+            .filter_map(|&(num, target)| {
+                let matrix = placement(&appearances[&num], &target)?;
+                let xobject = merged.get(&num).copied().unwrap_or(num);
+                Some(Placed { xobject, matrix })
+            })
+            .collect();
+        flattened += placed.len() as i32;
+        jobs.push(PageJob {
+            num: page,
+            dict,
+            resources,
+            kept_annots,
+            placed,
+        });
+    }
+    let laid = parallel_map(&jobs, threads, flatten_page);
+
+    let mut edits = Edits::default();
+    let mut next = dict_get(&trailer, "Size")
+        .and_then(as_int)
+        .map_or(0, |n| n as i32)
+        .max(xref.num_objects)
+        .max(1);
+    let stream_dict =
+        |len: usize| ParsedValue::Dict(vec![("Length".into(), ParsedValue::Int(len as i64))]);
+    for (job, (mut dict, content)) in jobs.iter().zip(laid) {
+        if !job.placed.is_empty() {
+            let old = match dict_get(&dict, "Contents").cloned() {
+                Some(ParsedValue::Array(items)) => items,
+                Some(contents) => match resolve(&mut xref, &contents) {
+                    Some(ParsedValue::Array(items)) => items,
+                    _ => vec![contents],
+                },
+                _ => Vec::new(),
+            };
+            let (open, close) = (next, next + 1);
+            next += 2;
+            edits
+                .added_streams
+                .push((open, stream_dict(2), Bytes::from_static(b"q\n")));
+            edits
+                .added_streams
+                .push((close, stream_dict(content.len()), Bytes::from(content)));
+            let mut contents = vec![ParsedValue::Reference {
+                num: open,
+                generation: 0,
+            }];
+            contents.extend(old);
+            contents.push(ParsedValue::Reference {
+                num: close,
+                generation: 0,
+            });
+            set_key(&mut dict, "Contents", Some(ParsedValue::Array(contents)));
+        }
+        edits.objects.insert(job.num, dict);
+    }
+
+    // The form goes, with every field and widget
+    let mut catalog = catalog;
+    let form = dict_get(&catalog, "AcroForm").cloned();
+    if let Some(form_num) = form.as_ref().and_then(as_ref) {
+        edits.removed.insert(form_num);
+    }
+    if let Some(ParsedValue::Array(fields)) = form
+        .and_then(|f| resolve(&mut xref, &f))
+        .and_then(|f| dict_get(&f, "Fields").cloned())
+        .and_then(|f| resolve(&mut xref, &f))
+    {
+        edits.removed.extend(field_objects(&mut xref, &fields));
+    }
+    edits.removed.extend(widgets);
+    set_key(&mut catalog, "AcroForm", None);
+    edits.objects.insert(root, catalog);
+    for num in edits.objects.keys() {
+        edits.removed.remove(num);
+    }
+
+    let settings = WriteSettings {
+        compress: false,
+        decompress: false,
+        threads,
+        ..WriteSettings::default()
+    };
+    let mut out = Vec::new();
+    let saved = matches!(
+        write_opened(xref, &settings, &edits, &mut out),
+        Some(Ok(()))
+    );
+    match DOCUMENTS.get(doc).filter(|_| saved) {
+        Some(d) => {
+            d.lock().unwrap().replace_data(out);
+            pdf_purge_content_program_cache(0, doc);
+            fz_purge_display_list_cache(0, doc);
+            flattened
+        }
+        None => -1,
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::document::Document;
+    use crate::ffi::pdf_image_rewriter::tests::{pdf_with, stream};
+    use crate::ffi::pdf_xref_lazy::decode_stream;
+
+    fn page_content(doc: Handle) -> (Xref, Vec<u8>) {
+        let data = DOCUMENTS.get(doc).unwrap().lock().unwrap().data();
+        let mut xref = open_source(&data, 1).unwrap();
+        xref.read_all_sections();
+        let page = xref.lazy_page_object(0).unwrap();
+        let dict = xref.fetch(page).unwrap().value;
+        let Some(ParsedValue::Array(contents)) = dict_get(&dict, "Contents").cloned() else {
+            panic!("contents not wrapped");
+        };
+        let mut content = Vec::new();
+        for num in contents.iter().filter_map(as_ref) {
+            let f = xref.fetch(num).unwrap();
+            content.extend(decode_stream(&f.value, &f.stream.unwrap()).unwrap());
+        }
+        (xref, content)
+    }
+
+    #[test]
+    fn test_placement_fits_bbox_to_rect() {
+        let form = ParsedValue::Dict(vec![(
+            "BBox".into(),
+            ParsedValue::Array([0, 0, 10, 20].map(ParsedValue::Int).to_vec()),
+        )]);
+        let m = placement(&form, &Rect::new(100.0, 200.0, 120.0, 210.0)).unwrap();
+        assert_eq!([m.a, m.d, m.e, m.f], [2.0, 0.5, 100.0, 200.0]);
+    }
+
+    #[test]
+    fn test_flatten_draws_equal_appearances_once() {
+        let data = pdf_with(&[
+            b"<< /Type /Catalog /Pages 2 0 R /AcroForm << /Fields [4 0 R 5 0 R 6 0 R] >> >>"
+                .to_vec(),
+            b"<< /Type /Pages /Kids [3 0 R] /Count 1 >>".to_vec(),
+            b"<< /Type /Page /Parent 2 0 R /MediaBox [0 0 200 200] /Contents 9 0 R \
+              /Annots [4 0 R 5 0 R 6 0 R 10 0 R] >>"
+                .to_vec(),
+            b"<< /FT /Btn /T (a) /Subtype /Widget /Rect [0 0 10 10] /AS /Yes \
+              /AP << /N << /Yes 7 0 R /Off 8 0 R >> >> >>"
+                .to_vec(),
+            b"<< /FT /Btn /T (b) /Subtype /Widget /Rect [20 0 30 10] /AP << /N 8 0 R >> >>"
+                .to_vec(),
+            b"<< /FT /Tx /T (c) /Subtype /Widget /Rect [40 0 50 10] /F 2 /AP << /N 7 0 R >> >>"
+                .to_vec(),
+            stream("/Subtype /Form /BBox [0 0 10 10]", b"0 0 10 10 re f"),
+            stream("/Subtype /Form /BBox [0 0 10 10]", b"0 0 10 10 re f"),
+            stream("", b"1 0 0 rg"),
+            b"<< /Subtype /Text /Rect [0 0 1 1] >>".to_vec(),
+        ]);
+        let doc = DOCUMENTS.insert(Document::new(data));
+        assert_eq!(flatten_form(doc, 2), 2);
+
+        let (mut xref, content) = page_content(doc);
+        assert_eq!(
+            content,
+            b"q\n1 0 0 rg\nQ\nq 1 0 0 1 0 0 cm /FlatAP7 Do Q\nq 1 0 0 1 20 0 cm /FlatAP7 Do Q\n"
+        );
+        let page = xref.lazy_page_object(0).unwrap();
+        let dict = xref.fetch(page).unwrap().value;
+        assert!(matches!(dict_get(&dict, "Annots"), Some(ParsedValue::Array(a)) if a.len() == 1));
+        let root = dict_get(xref.source_trailer().unwrap(), "Root").and_then(as_ref);
+        let catalog = xref.fetch(root.unwrap()).unwrap().value;
+        assert!(dict_get(&catalog, "AcroForm").is_none());
+        assert!(xref.fetch(4).is_none());
+
+        // Nothing left to flatten
+        assert_eq!(flatten_form(doc, 2), 0);
+        DOCUMENTS.remove(doc);
+    }
+}
@@ -0,0 +1,172 @@
+//! Field Lookup Index
+//!
+//! Finding a field by its fully qualified name means walking the
+//! AcroForm's field tree from the top, inheriting names and types on the
+//! way down; a form with thousands of fields looked up one at a time walks
+//! that tree thousands of times. Here the first lookup on a document walks
+//! it once and keeps every terminal field by full name, so later lookups
+//! are a hash probe.
+//!
+//! An index belongs to the bytes it was built from: it is rebuilt once the
+//! document is rewritten, and structural edits to the form model (deleting
+//! or cloning fields) drop every index built before them.
+
+use super::mmap::FileBytes;
+use super::pdf_form_fill::{Field, Kind, document_form, value_of};
+use super::pdf_parse::ParsedValue;
+use super::pdf_vectorize::number;
+use super::pdf_write::open_source;
+use super::pdf_xref::Xref;
+use super::pdf_xref_lazy::dict_get;
+use super::{DOCUMENTS, Handle};
+use crate::fitz::geometry::Rect;
+use crate::pdf::form::{FieldFlags, FormField, WidgetType};
+use std::collections::HashMap;
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, LazyLock, Mutex, Weak};
+
+/// A terminal field, with the Rect of its first widget
+pub(crate) struct Entry {
+    pub(crate) field: Field,
+    pub(crate) rect: Rect,
+}
+
+/// Every terminal field of a document, by full name
+pub(crate) type FieldIndex = HashMap<String, Entry>;
+
+struct Index {
+    data: Weak<FileBytes>,
+    generation: u64,
+    fields: Arc<FieldIndex>,
+}
+
+/// The index of each document looked up so far
+static INDEXES: LazyLock<Mutex<HashMap<Handle, Index>>> =
+    LazyLock::new(|| Mutex::new(HashMap::new()));
+
+/// Bumped by every structural edit to a form
+static GENERATION: AtomicU64 = AtomicU64::new(0);
+
+/// Drop every field index; the next lookup on each document rebuilds its
+/// own
+pub(crate) fn invalidate() {
+    GENERATION.fetch_add(1, Ordering::AcqRel);
+}
+
+/// The Rect of widget `num`, or an empty one
+fn widget_rect(xref: &mut Xref, num: i32) -> Rect {
+    let dict = value_of(xref, num);
+    let r: Vec<f32> = match dict_get(&dict, "Rect") {
+        Some(ParsedValue::Array(rect)) => rect.iter().filter_map(number).collect(),
+        _ => Vec::new(),
+    };
+    match r[..] {
+        [x0, y0, x1, y1] => Rect::new(x0.min(x1), y0.min(y1), x0.max(x1), y0.max(y1)),
+        _ => Rect::new(0.0, 0.0, 0.0, 0.0),
+    }
+}
+
+/// Walk the field tree of `data` once
+fn build(data: &Arc<FileBytes>) -> FieldIndex {
+    let Some(mut xref) = open_source(data, 0) else {
+        return FieldIndex::new();
+    };
+    xref.read_all_sections();
+    let Some(trailer) = xref.source_trailer().cloned() else {
+        return FieldIndex::new();
+    };
+    if dict_get(&trailer, "Encrypt").is_some() {
+        return FieldIndex::new();
+    }
+    let Some((_, fields)) = document_form(&mut xref, &trailer) else {
+        return FieldIndex::new();
+    };
+    fields
+        .into_iter()
+        .map(|(name, field)| {
+            let rect = widget_rect(&mut xref, field.widgets[0]);
+            (name, Entry { field, rect })
+        })
+        .collect()
+}
+
+/// The field index of document `doc`, built on first use
+pub(crate) fn field_index(doc: Handle) -> Option<Arc<FieldIndex>> {
+    let data = DOCUMENTS.get(doc)?.lock().unwrap().data();
+    let generation = GENERATION.load(Ordering::Acquire);
+    if let Some(index) = INDEXES.lock().unwrap().get(&doc) {
+        if index.generation == generation && Weak::ptr_eq(&index.data, &Arc::downgrade(&data)) {
+            return Some(Arc::clone(&index.fields));
+        }
+    }
+    let fields = Arc::new(build(&data));
+    let index = Index {
+        data: Arc::downgrade(&data),
+        generation,
+        fields: Arc::clone(&fields),
+    };
+    INDEXES.lock().unwrap().insert(doc, index);
+    Some(fields)
+}
+
+/// Field `name` of document `doc` as a form model field
+pub(crate) fn lookup(doc: Handle, name: &str) -> Option<FormField> {
+    let index = field_index(doc)?;
+    let Entry { field, rect } = index.get(name)?;
+    let name = name.to_string();
+    let mut found = match field.kind {
+        Kind::Text => FormField::text_field(name, *rect, field.max_len),
+        Kind::Choice if field.flags & i64::from(FieldFlags::COMBO) != 0 => {
+            FormField::combo_box(name, *rect, Vec::new())
+        }
+        Kind::Choice => FormField::list_box(name, *rect, Vec::new()),
+        Kind::Check => FormField::new(name, WidgetType::Checkbox, *rect),
+        Kind::Radio => FormField::new(name, WidgetType::RadioButton, *rect),
+        Kind::Signature => FormField::signature(name, *rect),
+        Kind::Other => FormField::new(name, WidgetType::Button, *rect),
+    };
+    found.flags = FieldFlags::new(field.flags as u32);
+    found.value = field.value.clone();
+    Some(found)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::document::Document;
+    use crate::ffi::pdf_form_fill::tests::form;
+
+    #[test]
+    fn test_lookup_by_full_name() {
+        let doc = DOCUMENTS.insert(Document::new(form()));
+        let index = field_index(doc).unwrap();
+        assert_eq!(index.len(), 4);
+
+        let qty = lookup(doc, "qty").unwrap();
+        assert_eq!(qty.field_type, WidgetType::Text);
+        assert_eq!((qty.rect.x0, qty.rect.y1), (10.0, 60.0));
+        assert_eq!(
+            lookup(doc, "agree").unwrap().field_type,
+            WidgetType::Checkbox
+        );
+        assert!(lookup(doc, "missing").is_none());
+        DOCUMENTS.remove(doc);
+    }
+
+    #[test]
+    fn test_rebuilt_after_rewrite_and_edits() {
+        let doc = DOCUMENTS.insert(Document::new(form()));
+        let first = field_index(doc).unwrap();
+        assert!(Arc::ptr_eq(&first, &field_index(doc).unwrap()));
+
+        let values = [("qty".to_string(), "3".to_string())];
+        assert_eq!(crate::ffi::pdf_form_fill::fill_form(doc, &values, 1), 1);
+        let second = field_index(doc).unwrap();
+        assert!(!Arc::ptr_eq(&first, &second));
+        assert_eq!(lookup(doc, "qty").unwrap().value, "3");
+
+        invalidate();
+        assert!(!Arc::ptr_eq(&second, &field_index(doc).unwrap()));
+        DOCUMENTS.remove(doc);
+    }
+}
@@ -0,0 +1,212 @@
+//! Parallel Garbage Collection
+//!
+//! Garbage collection keeps what the trailer can reach, and on documents
+//! with millions of objects the walk over the object graph is most of a
+//! save's cost that isn't stream filtering. It goes a level at a time:
+//! every object in the frontier is parsed on a pool of threads, and the
+//! references found are claimed through atomic mark bits, one per object
+//! number, so each object joins exactly one later frontier however many
+//! threads reach it. The sweep then runs over the xref's subsections in
+//! parallel, keeping the marked entries.
+
+use super::Handle;
+use super::pdf_parse::ParsedValue;
+use super::pdf_stream_prefetch::parallel_map;
+use super::pdf_xref::{PDF_XREF_INUSE, PDF_XREF_OBJSTM, XREFS, Xref};
+use super::pdf_xref_lazy::{collect_refs, dict_get};
+use std::sync::atomic::{AtomicU64, Ordering};
+
+/// Frontier objects one task parses
+const FRONTIER_CHUNK: usize = 256;
+
+/// One mark bit per object number, settable from many threads
+pub(crate) struct MarkBits {
+    words: Vec<AtomicU64>,
+    len: usize,
+}
+
+impl MarkBits {
+    /// Bits for object numbers below `len`
+    pub(crate) fn new(len: usize) -> Self {
+        Self {
+            words: (0..len.div_ceil(64)).map(|_| AtomicU64::new(0)).collect(),
+            len,
+        }
+    }
+
+    fn slot(&self, num: i32) -> Option<(&AtomicU64, u64)> {
+        let num = usize::try_from(num).ok().filter(|&n| n < self.len)?;
+        Some((self.words.get(num / 64)?, 1 << (num % 64)))
+    }
+
+    /// Mark `num`, returning whether this call was the one to mark it
+    ///
+    /// Numbers out of range are never marked.
+    pub(crate) fn mark(&self, num: i32) -> bool {
+        self.slot(num)
+            .is_some_and(|(word, bit)| word.fetch_or(bit, Ordering::Relaxed) & bit == 0)
+    }
+
+    pub(crate) fn is_marked(&self, num: i32) -> bool {
+        self.slot(num)
+            .is_some_and(|(word, bit)| word.load(Ordering::Relaxed) & bit != 0)
+    }
+
+    pub(crate) fn count(&self) -> usize {
+        self.words
+            .iter()
+            .map(|w| w.load(Ordering::Relaxed).count_ones() as usize)
+            .sum()
+    }
+}
+
+fn in_use(entry_type: i32) -> bool {
+    matches!(entry_type, PDF_XREF_INUSE | PDF_XREF_OBJSTM)
+}
+
+/// Mark every object reachable from `roots`, following `/Parent` too
+///
+/// Reads all xref sections and decompresses all object streams first, so
+/// the walk itself only reads the xref.
+pub(crate) fn mark_reachable(xref: &mut Xref, roots: &ParsedValue, threads: usize) -> MarkBits {
+    xref.read_all_sections();
+    xref.prefetch_objstms(threads);
+    let size = xref
+        .subsections
+        .iter()
+        .flat_map(|s| &s.entries)
+        .filter(|e| in_use(e.entry_type))
+        .map(|e| e.num.max(0) as usize + 1)
+        .max()
+        .unwrap_or(0);
+    let bits = MarkBits::new(size);
+
+    let mut frontier = Vec::new();
+    collect_refs(roots, &mut frontier);
+    frontier.retain(|&num| bits.mark(num));
+
+    let xref = &*xref;
+    while !frontier.is_empty() {
+        let chunks: Vec<&[i32]> = frontier.chunks(FRONTIER_CHUNK).collect();
+        let found = parallel_map(&chunks, threads, |chunk| {
+            let mut refs = Vec::new();
+            for &num in *chunk {
+                let Some(value) = xref.peek_value(num) else {
+                    continue;
+                };
+                let start = refs.len();
+                collect_refs(&value, &mut refs);
+                if let Some(parent) = dict_get(&value, "Parent") {
+                    collect_refs(parent, &mut refs);
+                }
+                let mut kept = start;
+                for i in start..refs.len() {
+                    if bits.mark(refs[i]) {
+                        refs[kept] = refs[i];
+                        kept += 1;
+                    }
+                }
+                refs.truncate(kept);
+            }
+            refs
+        });
+        frontier = found.concat();
+    }
+    bits
+}
+
+/// In-use object numbers, in order, keeping only those in `marks` if given
+///
+/// Each subsection is swept on its own thread.
+pub(crate) fn sweep(xref: &Xref, marks: Option<&MarkBits>, threads: usize) -> Vec<i32> {
+    let kept = parallel_map(&xref.subsections, threads, |subsec| {
+        subsec
+            .entries
+            .iter()
+            .filter(|e| in_use(e.entry_type) && e.num > 0)
+            .filter(|e| marks.is_none_or(|m| m.is_marked(e.num)))
+            .map(|e| e.num)
+            .collect::<Vec<_>>()
+    });
+    let mut nums = kept.concat();
+    nums.sort_unstable();
+    nums.dedup();
+    nums
+}
+
+// ============================================================================
+// FFI Functions
+// ============================================================================
+
+/// Mark every xref entry reachable from the trailer, on `threads` threads
+/// (0 = one per core), as `pdf_mark_xref` would one at a time
+///
+/// Only xrefs opened with `pdf_open_xref_lazy` can be walked. Returns how
+/// many objects were marked, or -1 if the xref can't be walked.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_mark_xref_reachable(_ctx: Handle, xref: Handle, threads: i32) -> i32 {
+    let Some(x) = XREFS.get(xref) else {
+        return -1;
+    };
+    let mut x = x.lock().unwrap();
+    let Some(trailer) = x.source_trailer().cloned() else {
+        return -1;
+    };
+    let marks = mark_reachable(&mut x, &trailer, usize::try_from(threads).unwrap_or(0));
+    for subsec in &mut x.subsections {
+        for entry in &mut subsec.entries {
+            if marks.is_marked(entry.num) && in_use(entry.entry_type) {
+                entry.marked = 1;
+            }
+        }
+    }
+    marks.count() as i32
+}
+
+#[cfg(test)]
+mod tests {
+    use super::super::pdf_xref::XrefEntry;
+    use super::super::pdf_xref::pdf_get_xref_entry;
+    use super::super::pdf_xref_lazy::tests::sample_pdf;
+    use super::*;
+    use std::sync::Arc;
+
+    #[test]
+    fn test_mark_bits_claim_once() {
+        let bits = MarkBits::new(130);
+        assert!(bits.mark(129));
+        assert!(!bits.mark(129));
+        assert!(!bits.mark(130));
+        assert!(!bits.mark(-1));
+        assert!(bits.is_marked(129) && !bits.is_marked(128));
+        assert_eq!(bits.count(), 1);
+    }
+
+    #[test]
+    fn test_mark_reachable_matches_any_thread_count() {
+        let data: Arc<_> = Arc::new(sample_pdf().into());
+        for threads in [1, 2, 8] {
+            let mut xref = Xref::open_lazy(0, Arc::clone(&data)).unwrap();
+            let trailer = xref.source_trailer().unwrap().clone();
+            let marks = mark_reachable(&mut xref, &trailer, threads);
+            let nums = sweep(&xref, Some(&marks), threads);
+            // Object 10 sits in the object stream but nothing points at it,
+            // and the object and xref streams aren't referenced either
+            assert_eq!(nums, [1, 2, 3, 4, 5, 6, 7, 8]);
+            let all = sweep(&xref, None, threads);
+            assert!(all.contains(&10) && all.contains(&9));
+        }
+    }
+
+    #[test]
+    fn test_mark_xref_reachable_sets_entries() {
+        let xref = XREFS.insert(Xref::open_lazy(0, Arc::new(sample_pdf().into())).unwrap());
+        assert_eq!(pdf_mark_xref_reachable(0, xref, 2), 8);
+        let mut entry = XrefEntry::free(0, 0);
+        for (num, marked) in [(4, 1), (10, 0)] {
+            assert_eq!(pdf_get_xref_entry(0, xref, num, &mut entry), 1);
+            assert_eq!(entry.marked, marked);
+        }
+        XREFS.remove(xref);
+    }
+}
@@ -0,0 +1,795 @@
+//! Page Grafting
+//!
+//! Copies pages from one document into a new file, for merge and split.
+//! Each page pulls in the objects it references, renumbered into the
+//! output; stream data goes across as the raw, still-filtered bytes from
+//! the mapped source and is never decoded or re-encoded, so copying a page
+//! costs about as much as reading it.
+//!
+//! References to page tree nodes that aren't being copied (a link's
+//! destination page, an annotation's `/P`) become `null`, so copying one
+//! page never drags in the rest of the document.
+
+use super::mmap::FileBytes;
+use super::pdf_parse::ParsedValue;
+use super::pdf_stream_prefetch::{parallel_map, resolve_threads};
+use super::pdf_write::{
+    Counting, PdfSink, open_source, set_key, write_value, write_value_with, write_xref,
+};
+use super::pdf_xref::Xref;
+use super::pdf_xref_lazy::{XrefSource, as_ref, dict_get, header_version, is_name};
+use bytes::Bytes;
+use std::collections::{BTreeMap, HashMap, HashSet, VecDeque};
+use std::io;
+use std::sync::atomic::{AtomicBool, AtomicUsize, Ordering};
+use std::sync::{Arc, Condvar, Mutex, mpsc};
+
+/// Page attributes a page can take from its ancestors
+const INHERITED: [&str; 4] = ["Resources", "MediaBox", "CropBox", "Rotate"];
+
+/// Deepest page tree walked
+const MAX_TREE_DEPTH: usize = 64;
+
+/// Version assumed for a file whose header can't be read
+const DEFAULT_VERSION: i32 = 17;
+
+/// Plans made ahead of the writer, per worker thread
+const PLANS_AHEAD: usize = 2;
+
+/// Object numbers of the output's page tree root and catalog
+const PAGES_NUM: i32 = 1;
+const CATALOG_NUM: i32 = 2;
+
+/// A page and what it inherits from its page tree ancestors
+struct PageNode {
+    num: i32,
+    inherited: Vec<(String, ParsedValue)>,
+}
+
+/// A document pages are copied from
+pub struct GraftSource {
+    xref: Xref,
+    version: i32,
+    pages: Vec<PageNode>,
+    /// Every page tree node, pages included
+    tree: HashSet<i32>,
+}
+
+impl GraftSource {
+    /// Open the document in `data` and walk its page tree
+    ///
+    /// Returns `None` if there are no pages to read, or if the document is
+    /// encrypted: its strings and streams are keyed to the object numbers
+    /// being rewritten.
+    pub fn open(data: Arc<FileBytes>) -> Option<Self> {
+        let version = file_version(&data);
+        let mut source = Self::walk(open_source(&data, 0)?)?;
+        if source.pages.is_empty() {
+            // A stale xref can open cleanly and still point nowhere
+            let (mut xref, trailer) = Xref::repair(0, &data, 0)?;
+            xref.source = Some(XrefSource::new(data, trailer));
+            source = Self::walk(xref)?;
+        }
+        source.version = version;
+        (!source.pages.is_empty()).then_some(source)
+    }
+
+    fn walk(mut xref: Xref) -> Option<Self> {
+        let trailer = xref.source_trailer()?.clone();
+        if dict_get(&trailer, "Encrypt").is_some() {
+            return None;
+        }
+        let mut pages = Vec::new();
+        let mut tree = HashSet::new();
+        let root = dict_get(&trailer, "Root")
+            .and_then(as_ref)
+            .and_then(|num| xref.load_value(num));
+        let Some(top) = root
+            .as_ref()
+            .and_then(|r| dict_get(r, "Pages"))
+            .and_then(as_ref)
+        else {
+            return Some(Self {
+                xref,
+                version: DEFAULT_VERSION,
+                pages,
+                tree,
+            });
+        };
+
+        let mut stack = vec![(top, Vec::new(), 0)];
+        while let Some((num, mut inherited, depth)) = stack.pop() {
+            if depth > MAX_TREE_DEPTH || !tree.insert(num) {
+                continue;
+            }
+            let Some(value) = xref.load_value(num) else {
+                continue;
+            };
+            for key in INHERITED {
+                if let Some(v) = dict_get(&value, key) {
+                    inherited.retain(|(k, _): &(String, _)| k != key);
+                    inherited.push((key.to_string(), v.clone()));
+                }
+            }
+            match dict_get(&value, "Kids") {
+                Some(ParsedValue::Array(kids)) if !is_name(dict_get(&value, "Type"), "Page") => {
+                    for kid in kids.iter().rev().filter_map(as_ref) {
+                        stack.push((kid, inherited.clone(), depth + 1));
+                    }
+                }
+                _ => pages.push(PageNode { num, inherited }),
+            }
+        }
+        Some(Self {
+            xref,
+            version: DEFAULT_VERSION,
+            pages,
+            tree,
+        })
+    }
+
+    /// How many pages the document has
+    pub fn page_count(&self) -> usize {
+        self.pages.len()
+    }
+
+    /// Work out which objects copying `pages` (0-based, in order) takes,
+    /// ready for [`GraftWriter::add_plan`]
+    ///
+    /// Objects shared between the pages are copied once. A page listed
+    /// twice gets two page objects over the same content. Indices past the
+    /// end are skipped.
+    pub fn plan(&mut self, pages: &[usize]) -> GraftPlan {
+        let mut graft = Graft {
+            tree: &self.tree,
+            pages: HashMap::new(),
+            objects: HashMap::new(),
+            queue: VecDeque::new(),
+        };
+        let copies: Vec<&PageNode> = pages.iter().filter_map(|&i| self.pages.get(i)).collect();
+        let mut next = 0;
+        for node in &copies {
+            graft.pages.entry(node.num).or_insert(next);
+            next += 1;
+        }
+
+        let mut objects = Vec::new();
+        for node in &copies {
+            let mut value = self
+                .xref
+                .fetch(node.num)
+                .map_or(ParsedValue::Null, |f| f.value);
+            for (key, inherited) in &node.inherited {
+                if dict_get(&value, key).is_none() {
+                    set_key(&mut value, key, Some(inherited.clone()));
+                }
+            }
+            set_key(&mut value, "Parent", None);
+            graft.remap(&mut value, &mut next);
+            objects.push((value, None));
+        }
+
+        // Queued in numbering order, so each lands at its own index
+        while let Some((src, _)) = graft.queue.pop_front() {
+            let (mut value, stream) = match self.xref.fetch(src) {
+                Some(fetched) => (fetched.value, fetched.stream),
+                None => (ParsedValue::Null, None),
+            };
+            if let Some(raw) = &stream {
+                // Direct, so an indirect length isn't copied too
+                set_key(
+                    &mut value,
+                    "Length",
+                    Some(ParsedValue::Int(raw.len() as i64)),
+                );
+            }
+            graft.remap(&mut value, &mut next);
+            objects.push((value, stream));
+        }
+        GraftPlan {
+            objects,
+            pages: copies.len(),
+        }
+    }
+
+    /// PDF version from the file header, e.g. 17
+    pub fn version(&self) -> i32 {
+        self.version
+    }
+}
+
+/// PDF version a file's header declares, e.g. 17
+///
+/// Cheap enough to check every input of a merge before any is opened.
+pub fn file_version(data: &[u8]) -> i32 {
+    header_version(data).unwrap_or(DEFAULT_VERSION)
+}
+
+/// Where a source's objects went in the output
+struct Graft<'a> {
+    tree: &'a HashSet<i32>,
+    /// First copy of each page, for references to it
+    pages: HashMap<i32, i32>,
+    objects: HashMap<i32, i32>,
+    queue: VecDeque<(i32, i32)>,
+}
+
+impl Graft<'_> {
+    /// Renumber the references in `value`, queueing objects not seen yet
+    fn remap(&mut self, value: &mut ParsedValue, next: &mut i32) {
+        match value {
+            ParsedValue::Reference { num, .. } => {
+                let src = *num;
+                *value = if let Some(&dest) = self.pages.get(&src) {
+                    reference(dest)
+                } else if self.tree.contains(&src) {
+                    ParsedValue::Null
+                } else {
+                    let dest = *self.objects.entry(src).or_insert_with(|| {
+                        let dest = *next;
+                        *next += 1;
+                        self.queue.push_back((src, dest));
+                        dest
+                    });
+                    reference(dest)
+                };
+            }
+            ParsedValue::Array(items) => items.iter_mut().for_each(|v| self.remap(v, next)),
+            ParsedValue::Dict(entries) => entries.iter_mut().for_each(|(_, v)| self.remap(v, next)),
+            _ => {}
+        }
+    }
+}
+
+fn reference(num: i32) -> ParsedValue {
+    ParsedValue::Reference { num, generation: 0 }
+}
+
+/// Shift every reference in `value` up by `base`
+fn rebase(value: &mut ParsedValue, base: i32) {
+    match value {
+        ParsedValue::Reference { num, .. } => *num += base,
+        ParsedValue::Array(items) => items.iter_mut().for_each(|v| rebase(v, base)),
+        ParsedValue::Dict(entries) => entries.iter_mut().for_each(|(_, v)| rebase(v, base)),
+        _ => {}
+    }
+}
+
+/// The objects copying some pages of one source takes, numbered from 0 in
+/// the order they are written
+///
+/// A plan doesn't depend on where it lands in the output, so plans for
+/// several sources can be made at once and written one after another.
+pub struct GraftPlan {
+    objects: Vec<(ParsedValue, Option<Bytes>)>,
+    /// The first `pages` objects are the copied pages
+    pages: usize,
+}
+
+impl GraftPlan {
+    /// How many pages the plan copies
+    pub fn page_count(&self) -> usize {
+        self.pages
+    }
+}
+
+/// Writes a new document from pages of others
+///
+/// Objects go to the sink as they are copied; the page tree and catalog
+/// are written last, by [`GraftWriter::finish`].
+pub struct GraftWriter<S: PdfSink> {
+    out: Counting<S>,
+    offsets: Vec<Option<(usize, u16)>>,
+    next: i32,
+    kids: Vec<i32>,
+    buf: Vec<u8>,
+}
+
+impl<S: PdfSink> GraftWriter<S> {
+    /// Start a file declaring PDF `version` (e.g. 17)
+    pub fn new(out: S, version: i32) -> io::Result<Self> {
+        let mut out = Counting::new(out);
+        out.put_header(version)?;
+        Ok(Self {
+            out,
+            offsets: vec![None; CATALOG_NUM as usize + 1],
+            next: CATALOG_NUM + 1,
+            kids: Vec::new(),
+            buf: Vec::new(),
+        })
+    }
+
+    /// Pages copied so far
+    pub fn page_count(&self) -> usize {
+        self.kids.len()
+    }
+
+    /// Copy `pages` (0-based, in order) of `source`
+    pub fn add_pages(&mut self, source: &mut GraftSource, pages: &[usize]) -> io::Result<()> {
+        self.add_plan(source.plan(pages))
+    }
+
+    /// Write a planned source's objects, numbered after everything so far
+    pub fn add_plan(&mut self, plan: GraftPlan) -> io::Result<()> {
+        let base = self.next;
+        self.next += plan.objects.len() as i32;
+        for (i, (mut value, stream)) in plan.objects.into_iter().enumerate() {
+            let num = base + i as i32;
+            rebase(&mut value, base);
+            if i < plan.pages {
+                set_key(&mut value, "Parent", Some(reference(PAGES_NUM)));
+                self.kids.push(num);
+            }
+            self.write_object(num, &value, stream)?;
+        }
+        Ok(())
+    }
+
+    fn write_object(
+        &mut self,
+        num: i32,
+        value: &ParsedValue,
+        stream: Option<Bytes>,
+    ) -> io::Result<()> {
+        self.begin_object(num);
+        write_value(value, &mut self.buf);
+        self.end_object(stream)
+    }
+
+    /// Record object `num` as starting here and put its header in the
+    /// buffer, for the caller to add its value
+    fn begin_object(&mut self, num: i32) {
+        let slot = num as usize;
+        if self.offsets.len() <= slot {
+            self.offsets.resize(slot + 1, None);
+        }
+        self.offsets[slot] = Some((self.out.pos, 0));
+
+        self.buf.clear();
+        self.buf
+            .extend_from_slice(format!("{num} 0 obj\n").as_bytes());
+    }
+
+    /// Write the buffered object out, with its stream data if any
+    fn end_object(&mut self, stream: Option<Bytes>) -> io::Result<()> {
+        match stream {
+            Some(data) => {
+                self.buf.extend_from_slice(b"\nstream\n");
+                self.out.put(&self.buf)?;
+                self.out.put_bytes(data)?;
+                self.out
+                    .put_bytes(Bytes::from_static(b"\nendstream\nendobj\n"))
+            }
+            None => {
+                self.buf.extend_from_slice(b"\nendobj\n");
+                self.out.put(&self.buf)
+            }
+        }
+    }
+
+    /// Write the page tree, catalog and xref, and flush the sink
+    pub fn finish(mut self) -> io::Result<()> {
+        let kids = self.kids.iter().map(|&n| reference(n)).collect();
+        let pages = ParsedValue::Dict(vec![
+            ("Type".into(), ParsedValue::Name("Pages".into())),
+            ("Kids".into(), ParsedValue::Array(kids)),
+            ("Count".into(), ParsedValue::Int(self.kids.len() as i64)),
+        ]);
+        self.write_object(PAGES_NUM, &pages, None)?;
+        let catalog = ParsedValue::Dict(vec![
+            ("Type".into(), ParsedValue::Name("Catalog".into())),
+            ("Pages".into(), reference(PAGES_NUM)),
+        ]);
+        self.write_object(CATALOG_NUM, &catalog, None)?;
+
+        self.offsets.resize(self.next as usize, None);
+        let trailer = vec![("Root".to_string(), reference(CATALOG_NUM))];
+        write_xref(&mut self.out, &self.offsets, trailer)
+    }
+}
+
+/// An object serialized once, with its references left as holes so it
+/// can be written under any output's numbering
+struct Template {
+    text: Vec<u8>,
+    /// Where each reference goes in `text`, and the source object it names
+    holes: Vec<(usize, i32)>,
+    stream: Option<Bytes>,
+}
+
+/// Stands for the output's page tree root in page templates
+const PARENT_HOLE: i32 = -1;
+
+impl Template {
+    fn new(value: &ParsedValue, stream: Option<Bytes>) -> Self {
+        let mut text = Vec::new();
+        let mut holes = Vec::new();
+        write_value_with(value, &mut text, &mut |num, _, text| {
+            holes.push((text.len(), num));
+        });
+        Self {
+            text,
+            holes,
+            stream,
+        }
+    }
+}
+
+/// A source serialized for splitting: every object the outputs reach,
+/// written to text once and shared by all of them
+struct SplitTemplates<'a> {
+    source: &'a GraftSource,
+    objects: HashMap<i32, Template>,
+}
+
+impl SplitTemplates<'_> {
+    /// Number an output's objects the way [`GraftSource::plan`] would:
+    /// pages first, then the rest in the order they are first reached
+    fn numbering(&self, pages: &[i32]) -> (HashMap<i32, i32>, Vec<i32>) {
+        let mut dest = HashMap::new();
+        let mut order = Vec::new();
+        let mut next = CATALOG_NUM + 1;
+        for &page in pages {
+            dest.entry(page).or_insert(next);
+            next += 1;
+        }
+
+        let mut queue: VecDeque<i32> = pages.iter().copied().collect();
+        let mut seen_pages = 0;
+        while let Some(src) = queue.pop_front() {
+            if seen_pages < pages.len() {
+                seen_pages += 1;
+            } else {
+                order.push(src);
+            }
+            for &(_, num) in self.objects.get(&src).map_or(&[][..], |t| &t.holes) {
+                if num == PARENT_HOLE || self.source.tree.contains(&num) || dest.contains_key(&num)
+                {
+                    continue;
+                }
+                dest.insert(num, next);
+                next += 1;
+                queue.push_back(num);
+            }
+        }
+        (dest, order)
+    }
+
+    /// Write one output holding `pages`
+    fn write<S: PdfSink>(&self, pages: &[usize], out: S) -> io::Result<()> {
+        let pages: Vec<i32> = pages
+            .iter()
+            .filter_map(|&i| self.source.pages.get(i))
+            .map(|node| node.num)
+            .collect();
+        let (dest, order) = self.numbering(&pages);
+
+        let mut writer = GraftWriter::new(out, self.source.version)?;
+        writer.next = CATALOG_NUM + 1 + pages.len() as i32 + order.len() as i32;
+        let numbered = pages
+            .iter()
+            .enumerate()
+            .map(|(i, &src)| (CATALOG_NUM + 1 + i as i32, src));
+        let rest = order.iter().map(|src| (dest[src], *src));
+        for (i, (num, src)) in numbered.chain(rest).enumerate() {
+            if i < pages.len() {
+                writer.kids.push(num);
+            }
+            writer.begin_object(num);
+            let stream = match self.objects.get(&src) {
+                Some(template) => {
+                    let mut at = 0;
+                    for &(pos, hole) in &template.holes {
+                        writer.buf.extend_from_slice(&template.text[at..pos]);
+                        at = pos;
+                        let target = match hole {
+                            PARENT_HOLE => Some(PAGES_NUM),
+                            num if self.source.tree.contains(&num) && !pages.contains(&num) => None,
+                            num => dest.get(&num).copied(),
+                        };
+                        match target {
+                            Some(n) => writer.buf.extend_from_slice(format!("{n} 0 R").as_bytes()),
+                            None => writer.buf.extend_from_slice(b"null"),
+                        }
+                    }
+                    writer.buf.extend_from_slice(&template.text[at..]);
+                    template.stream.clone()
+                }
+                None => {
+                    writer.buf.extend_from_slice(b"null");
+                    None
+                }
+            };
+            writer.end_object(stream)?;
+        }
+        writer.finish()
+    }
+}
+
+/// Write several documents from pages of `source`, one per entry of
+/// `outputs` (0-based page lists), on up to `threads` threads (0 = one
+/// per core)
+///
+/// The source is walked once and every object any output needs is
+/// serialized once; outputs only fill in their own object numbers, so
+/// fonts and images shared by many pages aren't redone for each file.
+/// Each output comes out the same as grafting its pages on their own.
+/// Returns the first error in output order.
+pub fn split_pages<S, E, F>(
+    source: &mut GraftSource,
+    outputs: &[Vec<usize>],
+    threads: usize,
+    sink: F,
+) -> Result<(), E>
+where
+    S: PdfSink,
+    E: From<io::Error> + Send,
+    F: Fn(usize) -> Result<S, E> + Sync,
+{
+    let mut objects = HashMap::new();
+    let mut queue = VecDeque::new();
+    let mut wanted: Vec<usize> = outputs.iter().flatten().copied().collect();
+    wanted.sort_unstable();
+    wanted.dedup();
+    for node in wanted.iter().filter_map(|&i| source.pages.get(i)) {
+        let mut value = source
+            .xref
+            .fetch(node.num)
+            .map_or(ParsedValue::Null, |f| f.value);
+        for (key, inherited) in &node.inherited {
+            if dict_get(&value, key).is_none() {
+                set_key(&mut value, key, Some(inherited.clone()));
+            }
+        }
+        set_key(&mut value, "Parent", Some(reference(PARENT_HOLE)));
+        let template = Template::new(&value, None);
+        queue.extend(template.holes.iter().map(|&(_, num)| num));
+        objects.insert(node.num, template);
+    }
+    while let Some(num) = queue.pop_front() {
+        if num == PARENT_HOLE || source.tree.contains(&num) || objects.contains_key(&num) {
+            continue;
+        }
+        let (mut value, stream) = match source.xref.fetch(num) {
+            Some(fetched) => (fetched.value, fetched.stream),
+            None => (ParsedValue::Null, None),
+        };
+        if let Some(raw) = &stream {
+            set_key(
+                &mut value,
+                "Length",
+                Some(ParsedValue::Int(raw.len() as i64)),
+            );
+        }
+        let template = Template::new(&value, stream);
+        queue.extend(template.holes.iter().map(|&(_, num)| num));
+        objects.insert(num, template);
+    }
+
+    let templates = SplitTemplates { source, objects };
+    let indices: Vec<usize> = (0..outputs.len()).collect();
+    parallel_map(&indices, threads, |&i| {
+        templates.write(&outputs[i], sink(i)?).map_err(E::from)
+    })
+    .into_iter()
+    .collect()
+}
+
+/// Graft `count` sources in order, planning them on up to `threads`
+/// worker threads (0 = one per core) while the calling thread writes
+///
+/// Each plan is numbered from 0 and only placed when written, so the
+/// output is the same as planning and writing one source at a time.
+/// Workers stay at most a couple of plans each ahead of the writer. The
+/// first error, in source order, stops the graft.
+pub fn graft_pipelined<S, E, F>(
+    writer: &mut GraftWriter<S>,
+    count: usize,
+    threads: usize,
+    plan: F,
+) -> Result<(), E>
+where
+    S: PdfSink,
+    E: From<io::Error> + Send,
+    F: Fn(usize) -> Result<GraftPlan, E> + Sync,
+{
+    let threads = resolve_threads(threads).min(count);
+    if threads <= 1 {
+        for i in 0..count {
+            writer.add_plan(plan(i)?)?;
+        }
+        return Ok(());
+    }
+
+    let window = threads * PLANS_AHEAD;
+    let next = AtomicUsize::new(0);
+    let stop = AtomicBool::new(false);
+    let written = Mutex::new(0);
+    let advanced = Condvar::new();
+    std::thread::scope(|scope| {
+        let (tx, rx) = mpsc::channel();
+        for _ in 0..threads {
+            let tx = tx.clone();
+            let (next, stop, written, advanced, plan) = (&next, &stop, &written, &advanced, &plan);
+            scope.spawn(move || {
+                loop {
+                    let i = next.fetch_add(1, Ordering::Relaxed);
+                    if i >= count {
+                        break;
+                    }
+                    let mut done = written.lock().unwrap();
+                    while i >= *done + window && !stop.load(Ordering::Relaxed) {
+                        done = advanced.wait(done).unwrap();
+                    }
+                    drop(done);
+                    if stop.load(Ordering::Relaxed) || tx.send((i, plan(i))).is_err() {
+                        break;
+                    }
+                }
+            });
+        }
+        drop(tx);
+
+        let mut pending = BTreeMap::new();
+        let mut want = 0;
+        let mut result = Ok(());
+        'recv: for (i, planned) in &rx {
+            pending.insert(i, planned);
+            while let Some(planned) = pending.remove(&want) {
+                if let Err(e) = planned.and_then(|p| writer.add_plan(p).map_err(E::from)) {
+                    result = Err(e);
+                    break 'recv;
+                }
+                want += 1;
+                *written.lock().unwrap() = want;
+                advanced.notify_all();
+            }
+        }
+        stop.store(true, Ordering::Relaxed);
+        // Take the lock so no worker misses the wakeup between its check
+        // and its wait
+        drop(written.lock().unwrap());
+        advanced.notify_all();
+        drop(rx);
+        result
+    })
+}
+
+#[cfg(test)]
+mod tests {
+    use super::super::pdf_xref_lazy::tests::sample_pdf;
+    use super::super::pdf_xref_lazy::{as_int, decode_stream};
+    use super::*;
+
+    fn source(data: Vec<u8>) -> GraftSource {
+        GraftSource::open(Arc::new(data.into())).unwrap()
+    }
+
+    fn graft(sources: &mut [(&mut GraftSource, &[usize])]) -> Xref {
+        let mut out = Vec::new();
+        let mut writer = GraftWriter::new(&mut out, 17).unwrap();
+        for (source, pages) in sources.iter_mut() {
+            writer.add_pages(source, pages).unwrap();
+        }
+        writer.finish().unwrap();
+        let mut xref = Xref::open_lazy(0, Arc::new(out.into())).unwrap();
+        xref.read_all_sections();
+        xref
+    }
+
+    fn page(xref: &mut Xref, index: i32) -> ParsedValue {
+        let num = xref.lazy_page_object(index).unwrap();
+        xref.fetch(num).unwrap().value
+    }
+
+    #[test]
+    fn test_graft_source_pages() {
+        let source = source(sample_pdf());
+        assert_eq!(source.page_count(), 2);
+        assert_eq!(source.version(), 15);
+    }
+
+    #[test]
+    fn test_graft_merge_passes_streams_through() {
+        let mut a = source(sample_pdf());
+        let mut b = source(sample_pdf());
+        let mut xref = graft(&mut [(&mut a, &[0, 1]), (&mut b, &[1])]);
+
+        let pages = xref.fetch(PAGES_NUM).unwrap().value;
+        assert_eq!(dict_get(&pages, "Count").and_then(as_int), Some(3));
+
+        // Stream data and its indirect length came across unchanged
+        let last = page(&mut xref, 2);
+        let contents = dict_get(&last, "Contents").and_then(as_ref).unwrap();
+        let fetched = xref.fetch(contents).unwrap();
+        assert_eq!(fetched.stream.as_deref(), Some(&b"0 0 m S"[..]));
+        assert_eq!(dict_get(&fetched.value, "Length").and_then(as_int), Some(7));
+
+        // Font from the source's object stream, parented to the new tree
+        let font = dict_get(&last, "Resources")
+            .and_then(|r| dict_get(r, "Font"))
+            .and_then(|f| dict_get(f, "F1"))
+            .and_then(as_ref)
+            .unwrap();
+        assert!(is_name(
+            dict_get(&xref.fetch(font).unwrap().value, "BaseFont"),
+            "Helvetica"
+        ));
+        assert_eq!(dict_get(&last, "Parent").and_then(as_ref), Some(PAGES_NUM));
+    }
+
+    #[test]
+    fn test_split_matches_grafting_each_output() {
+        let outputs = vec![vec![0], vec![1], vec![1, 0, 1], vec![]];
+        let mut source = source(sample_pdf());
+        let split: Vec<Mutex<Vec<u8>>> = outputs.iter().map(|_| Mutex::new(Vec::new())).collect();
+        split_pages(&mut source, &outputs, 3, |i| -> io::Result<_> {
+            Ok(Sink(&split[i]))
+        })
+        .unwrap();
+
+        for (pages, split) in outputs.iter().zip(split) {
+            let mut expected = Vec::new();
+            let mut writer = GraftWriter::new(&mut expected, source.version()).unwrap();
+            writer.add_pages(&mut source, pages).unwrap();
+            writer.finish().unwrap();
+            assert_eq!(split.into_inner().unwrap(), expected);
+        }
+    }
+
+    /// Sink appending to a shared buffer
+    struct Sink<'a>(&'a Mutex<Vec<u8>>);
+
+    impl PdfSink for Sink<'_> {
+        fn put(&mut self, bytes: &[u8]) -> io::Result<()> {
+            self.0.lock().unwrap().extend_from_slice(bytes);
+            Ok(())
+        }
+
+        fn finish(&mut self) -> io::Result<()> {
+            Ok(())
+        }
+    }
+
+    #[test]
+    fn test_graft_drops_other_pages() {
+        let mut data = sample_pdf();
+        // Page 1 gains a link to page 2 through an appended update
+        let text = String::from_utf8_lossy(&data).into_owned();
+        let prev = text.rfind("startxref\n").unwrap() + "startxref\n".len();
+        let prev: usize = text[prev..].lines().next().unwrap().parse().unwrap();
+        let updated = data.len();
+        data.extend_from_slice(
+            b"3 0 obj\n<< /Type /Page /Parent 2 0 R /Contents 5 0 R /MediaBox [0 0 10 10] \
+              /Annots [<< /Subtype /Link /Dest [4 0 R /Fit] >>] >>\nendobj\n",
+        );
+        let table = data.len();
+        data.extend_from_slice(
+            format!(
+                "xref\n3 1\n{updated:010} 00000 n \ntrailer\n<< /Size 12 /Root 1 0 R /Prev {prev} >>\n\
+                 startxref\n{table}\n%%EOF\n"
+            )
+            .as_bytes(),
+        );
+
+        let mut source = source(data);
+        let mut xref = graft(&mut [(&mut source, &[0])]);
+        let first = page(&mut xref, 0);
+        let ParsedValue::Array(annots) = dict_get(&first, "Annots").unwrap() else {
+            panic!("annotations missing");
+        };
+        let ParsedValue::Array(dest) = dict_get(&annots[0], "Dest").unwrap() else {
+            panic!("destination missing");
+        };
+        assert!(matches!(dest[0], ParsedValue::Null));
+        assert!(xref.lazy_page_object(1).is_none());
+
+        let contents = dict_get(&first, "Contents").and_then(as_ref).unwrap();
+        let fetched = xref.fetch(contents).unwrap();
+        let raw = fetched.stream.unwrap();
+        assert_eq!(
+            decode_stream(&fetched.value, &raw).as_deref(),
+            Some(&b"BT 1 Tf ET"[..])
+        );
+    }
+}
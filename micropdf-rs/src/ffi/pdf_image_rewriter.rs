@@ -2,8 +2,22 @@
 //!
 //! Provides PDF image optimization including resampling, recompression,
 //! and resolution changes for color, grayscale, and bitonal images.
-
-use crate::ffi::Handle;
+//!
+//! Image XObjects are gathered from every page's resources, through forms,
+//! once each however many pages share them. Decoding, subsampling and
+//! recompressing run on a pool of threads, a window of images at a time,
+//! the window closing once its decoded pixmaps reach a memory budget.
+
+use super::pdf_parse::ParsedValue;
+use super::pdf_stream_prefetch::parallel_map;
+use super::pdf_write::{Edits, WriteSettings, open_source, set_key, write_opened};
+use super::pdf_xref::Xref;
+use super::pdf_xref_lazy::{as_int, as_ref, decode_stream, dict_get, is_name};
+use super::resample::subsample;
+use crate::ffi::{DOCUMENTS, Handle};
+use crate::pdf::filter::{decode_dct, decode_dct_scaled, encode_flate};
+use bytes::Bytes;
+use std::collections::{HashMap, HashSet};
 use std::ffi::{CStr, CString, c_char};
 use std::ptr;
 
@@ -283,6 +297,514 @@ impl ImageRewriteStats {
     }
 }
 
+// ============================================================================
+// Image Rewriting
+// ============================================================================
+
+/// Decoded pixmap bytes the worker pool holds at once
+pub const DEFAULT_PIXMAP_BUDGET: usize = 256 << 20;
+
+/// Deepest page tree or form nesting followed looking for images
+pub(crate) const MAX_RESOURCE_DEPTH: usize = 32;
+
+/// JPEG quality when the options don't give one
+const DEFAULT_JPEG_QUALITY: u8 = 75;
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum ImageKind {
+    Color,
+    Gray,
+    Bitonal,
+}
+
+/// A unique image XObject, however many pages and forms show it
+struct ImageXObject {
+    num: i32,
+    dict: ParsedValue,
+    /// Raw (still encoded) data
+    raw: Bytes,
+    /// Colour components, if the colourspace has plain ones
+    components: Option<usize>,
+    /// Largest page showing it, in points
+    page_size: (f64, f64),
+}
+
+impl ImageXObject {
+    fn int(&self, key: &str) -> i64 {
+        dict_get(&self.dict, key).and_then(as_int).unwrap_or(0)
+    }
+
+    fn kind(&self) -> ImageKind {
+        let mask = matches!(
+            dict_get(&self.dict, "ImageMask"),
+            Some(ParsedValue::Bool(true))
+        );
+        match self.components {
+            _ if mask || self.int("BitsPerComponent") == 1 => ImageKind::Bitonal,
+            Some(1) => ImageKind::Gray,
+            _ => ImageKind::Color,
+        }
+    }
+
+    /// Whether the data is JPEG, decoded with the image
+    fn is_jpeg(&self) -> bool {
+        match dict_get(&self.dict, "Filter") {
+            Some(ParsedValue::Array(filters)) => {
+                filters.len() == 1 && is_name(filters.first(), "DCTDecode")
+            }
+            filter => is_name(filter, "DCTDecode"),
+        }
+    }
+
+    fn is_lossy(&self) -> bool {
+        let lossy =
+            |f: &ParsedValue| is_name(Some(f), "DCTDecode") || is_name(Some(f), "JPXDecode");
+        match dict_get(&self.dict, "Filter") {
+            Some(ParsedValue::Array(filters)) => filters.iter().any(lossy),
+            Some(filter) => lossy(filter),
+            None => false,
+        }
+    }
+}
+
+/// How one image is rewritten
+struct ImagePlan {
+    width: usize,
+    height: usize,
+    components: usize,
+    /// Pixels averaged into one along each side
+    factor: usize,
+    /// How much of `factor` a JPEG source's decode takes, as a power
+    /// of 2: its reduced IDCT skips coefficients instead of averaging
+    /// samples
+    l2factor: u32,
+    jpeg: Option<u8>,
+}
+
+impl ImagePlan {
+    /// Bytes of the decoded pixmap, at the decode's scale
+    fn decoded_len(&self) -> usize {
+        let scale = 1 << self.l2factor;
+        self.width.div_ceil(scale) * self.height.div_ceil(scale) * self.components
+    }
+}
+
+pub(crate) fn resolve(xref: &mut Xref, value: &ParsedValue) -> Option<ParsedValue> {
+    match as_ref(value) {
+        Some(num) => xref.fetch(num).map(|f| f.value),
+        None => Some(value.clone()),
+    }
+}
+
+/// Page attribute `key`, inherited through the page tree
+pub(crate) fn inherited(xref: &mut Xref, page: i32, key: &str) -> Option<ParsedValue> {
+    let mut node = page;
+    for _ in 0..MAX_RESOURCE_DEPTH {
+        let value = xref.fetch(node)?.value;
+        if let Some(found) = dict_get(&value, key) {
+            return resolve(xref, found);
+        }
+        node = dict_get(&value, "Parent").and_then(as_ref)?;
+    }
+    None
+}
+
+fn page_size(xref: &mut Xref, page: i32) -> (f64, f64) {
+    let coord = |v: &ParsedValue| match v {
+        ParsedValue::Int(n) => *n as f64,
+        ParsedValue::Real(r) => f64::from(*r),
+        _ => 0.0,
+    };
+    match inherited(xref, page, "MediaBox") {
+        Some(ParsedValue::Array(b)) if b.len() == 4 => (
+            (coord(&b[2]) - coord(&b[0])).abs(),
+            (coord(&b[3]) - coord(&b[1])).abs(),
+        ),
+        _ => (612.0, 792.0),
+    }
+}
+
+/// Components of colourspace `cs`, for the spaces whose samples can be
+/// averaged
+pub(crate) fn components(xref: &mut Xref, cs: Option<&ParsedValue>) -> Option<usize> {
+    let cs = resolve(xref, cs?)?;
+    let (family, param) = match &cs {
+        ParsedValue::Name(name) => (name.as_str(), None),
+        ParsedValue::Array(items) => match items.first() {
+            Some(ParsedValue::Name(name)) => (name.as_str(), items.get(1)),
+            _ => return None,
+        },
+        _ => return None,
+    };
+    match family {
+        "DeviceGray" | "CalGray" | "G" => Some(1),
+        "DeviceRGB" | "CalRGB" | "RGB" => Some(3),
+        "DeviceCMYK" | "CMYK" => Some(4),
+        "ICCBased" => {
+            let stream = resolve(xref, param?)?;
+            dict_get(&stream, "N")
+                .and_then(as_int)
+                .and_then(|n| usize::try_from(n).ok())
+                .filter(|n| matches!(n, 1 | 3 | 4))
+        }
+        _ => None,
+    }
+}
+
+/// Every image XObject the pages show, directly or through forms, once
+/// each, in page order
+fn collect_images(xref: &mut Xref) -> Vec<ImageXObject> {
+    let mut images: Vec<ImageXObject> = Vec::new();
+    let mut index: HashMap<i32, usize> = HashMap::new();
+    let mut skipped = HashSet::new();
+
+    for page in (0..)
+        .map_while(|i| xref.lazy_page_object(i))
+        .collect::<Vec<_>>()
+    {
+        let size = page_size(xref, page);
+        let mut forms = HashSet::new();
+        let mut stack: Vec<(ParsedValue, usize)> = inherited(xref, page, "Resources")
+            .map(|r| (r, 0))
+            .into_iter()
+            .collect();
+        while let Some((resources, depth)) = stack.pop() {
+            let xobjects = dict_get(&resources, "XObject").and_then(|x| resolve(xref, x));
+            let Some(ParsedValue::Dict(entries)) = xobjects else {
+                continue;
+            };
+            for num in entries.iter().filter_map(|(_, v)| as_ref(v)) {
+                if let Some(&i) = index.get(&num) {
+                    let seen = &mut images[i].page_size;
+                    *seen = (seen.0.max(size.0), seen.1.max(size.1));
+                    continue;
+                }
+                if skipped.contains(&num) || forms.contains(&num) {
+                    continue;
+                }
+                let Some(fetched) = xref.fetch(num) else {
+                    continue;
+                };
+                let (Some(raw), subtype) = (fetched.stream, dict_get(&fetched.value, "Subtype"))
+                else {
+                    continue;
+                };
+                if is_name(subtype, "Image") {
+                    let cs = dict_get(&fetched.value, "ColorSpace").cloned();
+                    let components = components(xref, cs.as_ref());
+                    index.insert(num, images.len());
+                    images.push(ImageXObject {
+                        num,
+                        dict: fetched.value,
+                        raw,
+                        components,
+                        page_size: size,
+                    });
+                } else if is_name(subtype, "Form") && depth < MAX_RESOURCE_DEPTH {
+                    forms.insert(num);
+                    let resources = dict_get(&fetched.value, "Resources").cloned();
+                    if let Some(resources) = resources.and_then(|r| resolve(xref, &r)) {
+                        stack.push((resources, depth + 1));
+                    }
+                } else {
+                    skipped.insert(num);
+                }
+            }
+        }
+    }
+    images
+}
+
+/// JPEG quality from an options quality string, if it holds one
+fn jpeg_quality(quality: *const c_char) -> u8 {
+    if quality.is_null() {
+        return DEFAULT_JPEG_QUALITY;
+    }
+    // SAFETY: the setters only store strings made by `CString::into_raw`
+    let quality = unsafe { CStr::from_ptr(quality) }.to_str().unwrap_or("");
+    quality
+        .trim()
+        .parse::<u8>()
+        .ok()
+        .filter(|q| (1..=100).contains(q))
+        .unwrap_or(DEFAULT_JPEG_QUALITY)
+}
+
+impl ImageRewriterOptions {
+    /// Subsample threshold and target DPI, and recompress method and
+    /// quality string, for one kind of image
+    fn for_image(&self, kind: ImageKind, lossy: bool) -> (i32, i32, i32, *const c_char) {
+        match (kind, lossy) {
+            (ImageKind::Color, false) => (
+                self.color_lossless_image_subsample_threshold,
+                self.color_lossless_image_subsample_to,
+                self.color_lossless_image_recompress_method,
+                self.color_lossless_image_recompress_quality,
+            ),
+            (ImageKind::Color, true) => (
+                self.color_lossy_image_subsample_threshold,
+                self.color_lossy_image_subsample_to,
+                self.color_lossy_image_recompress_method,
+                self.color_lossy_image_recompress_quality,
+            ),
+            (ImageKind::Gray, false) => (
+                self.gray_lossless_image_subsample_threshold,
+                self.gray_lossless_image_subsample_to,
+                self.gray_lossless_image_recompress_method,
+                self.gray_lossless_image_recompress_quality,
+            ),
+            (ImageKind::Gray, true) => (
+                self.gray_lossy_image_subsample_threshold,
+                self.gray_lossy_image_subsample_to,
+                self.gray_lossy_image_recompress_method,
+                self.gray_lossy_image_recompress_quality,
+            ),
+            (ImageKind::Bitonal, _) => (
+                self.bitonal_image_subsample_threshold,
+                self.bitonal_image_subsample_to,
+                self.bitonal_image_recompress_method,
+                self.bitonal_image_recompress_quality,
+            ),
+        }
+    }
+}
+
+/// What to do with `image`, or `None` to leave it as it is
+///
+/// Resolution is taken as if the image filled the largest page showing
+/// it, which is the lowest it can be, so nothing is subsampled below the
+/// target. Bitonal images are left alone, since averaging would make them
+/// gray and there is no fax encoder to recompress them with.
+fn plan_image(image: &ImageXObject, opts: &ImageRewriterOptions) -> Option<ImagePlan> {
+    let kind = image.kind();
+    let lossy = image.is_lossy();
+    let (threshold, target, method, quality) = opts.for_image(kind, lossy);
+    let components = image.components?;
+    let decodable = !lossy || (image.is_jpeg() && components != 4);
+    if kind == ImageKind::Bitonal
+        || method == FZ_RECOMPRESS_NEVER
+        || image.int("BitsPerComponent") != 8
+        || !decodable
+    {
+        return None;
+    }
+    let width = usize::try_from(image.int("Width"))
+        .ok()
+        .filter(|&w| w > 0)?;
+    let height = usize::try_from(image.int("Height"))
+        .ok()
+        .filter(|&h| h > 0)?;
+
+    let (page_w, page_h) = image.page_size;
+    let dpi = (width as f64 * 72.0 / page_w.max(1.0)).max(height as f64 * 72.0 / page_h.max(1.0));
+    let factor = match (threshold, target) {
+        (t, to) if t > 0 && to > 0 && dpi > f64::from(t) => (dpi / f64::from(to)).floor() as usize,
+        _ => 1,
+    };
+    let factor = if factor >= 2 { factor } else { 1 };
+
+    // JPEG 2000 and fax have no encoders here, so they come out lossless
+    let jpeg = match method {
+        FZ_RECOMPRESS_JPEG => true,
+        FZ_RECOMPRESS_SAME => lossy,
+        _ => false,
+    };
+    if factor == 1 && method == FZ_RECOMPRESS_SAME {
+        return None;
+    }
+    Some(ImagePlan {
+        width,
+        height,
+        components,
+        factor,
+        l2factor: match image.is_jpeg() {
+            true => factor.trailing_zeros().min(3),
+            false => 0,
+        },
+        jpeg: (jpeg && components != 4).then(|| jpeg_quality(quality)),
+    })
+}
+
+fn encode_jpeg(
+    pixels: &[u8],
+    width: usize,
+    height: usize,
+    n: usize,
+    quality: u8,
+) -> Option<Vec<u8>> {
+    use image::ExtendedColorType;
+    use image::codecs::jpeg::JpegEncoder;
+
+    let color = match n {
+        1 => ExtendedColorType::L8,
+        3 => ExtendedColorType::Rgb8,
+        _ => return None,
+    };
+    let mut out = Vec::new();
+    JpegEncoder::new_with_quality(&mut out, quality)
+        .encode(pixels, width as u32, height as u32, color)
+        .ok()?;
+    Some(out)
+}
+
+/// Rewrite one image per its plan: new dictionary, data, and whether it
+/// was subsampled; `None` if it can't be decoded or doesn't get smaller
+fn rewrite_image(image: &ImageXObject, plan: &ImagePlan) -> Option<(ParsedValue, Bytes, bool)> {
+    let n = plan.components;
+    let scaled = (plan.l2factor > 0)
+        .then(|| decode_dct_scaled(&image.raw, plan.l2factor).ok())
+        .flatten()
+        .filter(|d| usize::from(d.components) == n);
+    let (pixels, width, height, factor) = match scaled {
+        Some(d) => (
+            d.samples,
+            d.width as usize,
+            d.height as usize,
+            plan.factor >> plan.l2factor,
+        ),
+        // Whole-size decode when the file is one the reduced IDCT can't read
+        None => {
+            let pixels = match image.is_jpeg() {
+                true => decode_dct(&image.raw, None).ok()?,
+                false => decode_stream(&image.dict, &image.raw)?,
+            };
+            (pixels, plan.width, plan.height, plan.factor)
+        }
+    };
+    if pixels.len() != width * height * n {
+        return None;
+    }
+    let (pixels, width, height) = match factor {
+        1 => (pixels, width, height),
+        _ => subsample(&pixels, width, height, n, factor),
+    };
+    let (filter, data) = match plan.jpeg {
+        Some(quality) => (
+            "DCTDecode",
+            encode_jpeg(&pixels, width, height, plan.components, quality)?,
+        ),
+        None => ("FlateDecode", encode_flate(&pixels, 9).ok()?),
+    };
+    let subsampled = plan.factor > 1;
+    if !subsampled && data.len() >= image.raw.len() {
+        return None;
+    }
+
+    let mut dict = image.dict.clone();
+    for key in ["DecodeParms", "DL"] {
+        set_key(&mut dict, key, None);
+    }
+    set_key(&mut dict, "Filter", Some(ParsedValue::Name(filter.into())));
+    set_key(&mut dict, "Width", Some(ParsedValue::Int(width as i64)));
+    set_key(&mut dict, "Height", Some(ParsedValue::Int(height as i64)));
+    set_key(
+        &mut dict,
+        "Length",
+        Some(ParsedValue::Int(data.len() as i64)),
+    );
+    Some((dict, Bytes::from(data), subsampled))
+}
+
+/// Rewrite (or with `apply` false, only analyze) the images of `doc`
+///
+/// Each shared image is rewritten once. Images are decoded, subsampled
+/// and recompressed on `threads` threads (0 = one per core), in windows
+/// whose decoded pixmaps stay within `budget` bytes, so the largest of
+/// them bounds memory rather than their total. The document's data is
+/// replaced if anything changed.
+pub(crate) fn rewrite_images(
+    doc: DocumentHandle,
+    opts: &ImageRewriterOptions,
+    apply: bool,
+    threads: usize,
+    budget: usize,
+) -> ImageRewriteStats {
+    let mut stats = ImageRewriteStats::default();
+    let Some(data) = DOCUMENTS.get(doc).map(|d| d.lock().unwrap().data()) else {
+        return stats;
+    };
+    let Some(mut xref) = open_source(&data, threads) else {
+        return stats;
+    };
+    xref.read_all_sections();
+    let encrypted = xref
+        .source_trailer()
+        .is_some_and(|t| dict_get(t, "Encrypt").is_some());
+    let images = collect_images(&mut xref);
+
+    let mut plans = Vec::with_capacity(images.len());
+    for image in &images {
+        stats.images_processed += 1;
+        stats.original_size += image.raw.len() as u64;
+        match image.kind() {
+            ImageKind::Color => stats.color_images += 1,
+            ImageKind::Gray => stats.gray_images += 1,
+            ImageKind::Bitonal => stats.bitonal_images += 1,
+        }
+        // Encrypted image data can't be decoded without decrypting it
+        plans.push(
+            (apply && !encrypted)
+                .then(|| plan_image(image, opts))
+                .flatten(),
+        );
+    }
+
+    let mut edits = Edits::default();
+    let (mut replaced, mut written) = (0, 0);
+    let mut start = 0;
+    while start < images.len() {
+        let mut end = start;
+        let mut held = 0;
+        while end < images.len() {
+            let len = plans[end].as_ref().map_or(0, ImagePlan::decoded_len);
+            if end > start && held + len > budget {
+                break;
+            }
+            held += len;
+            end += 1;
+        }
+        let work: Vec<(&ImageXObject, &ImagePlan)> = (start..end)
+            .filter_map(|i| Some((&images[i], plans[i].as_ref()?)))
+            .collect();
+        let rewritten = parallel_map(&work, threads, |(image, plan)| rewrite_image(image, plan));
+        for ((image, _), result) in work.iter().zip(rewritten) {
+            if let Some((dict, data, subsampled)) = result {
+                stats.images_recompressed += 1;
+                stats.images_subsampled += i32::from(subsampled);
+                replaced += image.raw.len() as u64;
+                written += data.len() as u64;
+                edits.streams.insert(image.num, (dict, data));
+            }
+        }
+        start = end;
+    }
+
+    if !edits.streams.is_empty() {
+        let settings = WriteSettings {
+            compress: false,
+            decompress: false,
+            threads,
+            ..WriteSettings::default()
+        };
+        let mut out = Vec::new();
+        let saved = matches!(
+            write_opened(xref, &settings, &edits, &mut out),
+            Some(Ok(()))
+        );
+        match DOCUMENTS.get(doc) {
+            Some(d) if saved => d.lock().unwrap().replace_data(out),
+            _ => {
+                stats.images_recompressed = 0;
+                stats.images_subsampled = 0;
+                (replaced, written) = (0, 0);
+            }
+        }
+    }
+    stats.images_unchanged = stats.images_processed - stats.images_recompressed;
+    stats.new_size = stats.original_size - replaced + written;
+    stats
+}
+
 // ============================================================================
 // FFI Functions - Default Options
 // ============================================================================
@@ -471,55 +993,61 @@ pub extern "C" fn pdf_set_gray_jpeg_quality(
 /// Rewrite images within the given document.
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_rewrite_images(
-    _ctx: ContextHandle,
-    _doc: DocumentHandle,
-    _opts: *mut ImageRewriterOptions,
+    ctx: ContextHandle,
+    doc: DocumentHandle,
+    opts: *mut ImageRewriterOptions,
 ) {
-    // In a full implementation, this would:
-    // 1. Iterate through all images in the document
-    // 2. For each image, determine if it should be subsampled based on DPI thresholds
-    // 3. Resample the image if needed using the specified method
-    // 4. Recompress the image using the specified method
-    // 5. Replace the original image data in the PDF
+    pdf_rewrite_images_with_stats(ctx, doc, opts);
 }
 
 /// Rewrite images and return statistics.
+///
+/// Unique images are rewritten concurrently, one thread per core, with
+/// decoded pixmaps held to `DEFAULT_PIXMAP_BUDGET`. Null `opts` means
+/// the defaults, which leave every image as it is.
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_rewrite_images_with_stats(
     _ctx: ContextHandle,
-    _doc: DocumentHandle,
-    _opts: *mut ImageRewriterOptions,
+    doc: DocumentHandle,
+    opts: *mut ImageRewriterOptions,
 ) -> ImageRewriteStats {
-    // In a full implementation, this would rewrite images and collect stats
-    ImageRewriteStats::default()
+    if opts.is_null() {
+        return rewrite_images(
+            doc,
+            &ImageRewriterOptions::new(),
+            true,
+            0,
+            DEFAULT_PIXMAP_BUDGET,
+        );
+    }
+    // SAFETY: caller guarantees a non-null `opts` is valid
+    let opts = unsafe { &*opts };
+    rewrite_images(doc, opts, true, 0, DEFAULT_PIXMAP_BUDGET)
 }
 
 // ============================================================================
 // FFI Functions - Image Analysis
 // ============================================================================
 
-/// Count images in document.
+/// Count images in document (each shared image once).
 #[unsafe(no_mangle)]
-pub extern "C" fn pdf_count_images(_ctx: ContextHandle, _doc: DocumentHandle) -> i32 {
-    // In a full implementation, this would count all images
-    0
+pub extern "C" fn pdf_count_images(ctx: ContextHandle, doc: DocumentHandle) -> i32 {
+    pdf_analyze_images(ctx, doc).images_processed
 }
 
-/// Get total image size in bytes.
+/// Get total image size in bytes, as stored.
 #[unsafe(no_mangle)]
-pub extern "C" fn pdf_get_total_image_size(_ctx: ContextHandle, _doc: DocumentHandle) -> u64 {
-    // In a full implementation, this would sum all image sizes
-    0
+pub extern "C" fn pdf_get_total_image_size(ctx: ContextHandle, doc: DocumentHandle) -> u64 {
+    pdf_analyze_images(ctx, doc).original_size
 }
 
 /// Analyze images and return statistics without modifying.
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_analyze_images(
     _ctx: ContextHandle,
-    _doc: DocumentHandle,
+    doc: DocumentHandle,
 ) -> ImageRewriteStats {
-    // In a full implementation, this would analyze images without modifying them
-    ImageRewriteStats::default()
+    rewrite_images(doc, &ImageRewriterOptions::new(), false, 0, 0)
 }
 
 // ============================================================================
@@ -570,8 +1098,148 @@ pub extern "C" fn pdf_drop_image_rewriter_options(opts: *mut ImageRewriterOption
 // ============================================================================
 
 #[cfg(test)]
-mod tests {
+pub(crate) mod tests {
     use super::*;
+    use crate::ffi::document::Document;
+
+    /// A file holding `objects`, numbered from 1, with catalog 1
+    pub(crate) fn pdf_with(objects: &[Vec<u8>]) -> Vec<u8> {
+        let mut pdf = b"%PDF-1.7\n".to_vec();
+        let mut offsets = Vec::new();
+        for (num, body) in (1..).zip(objects) {
+            offsets.push(pdf.len());
+            pdf.extend_from_slice(format!("{num} 0 obj\n").as_bytes());
+            pdf.extend_from_slice(body);
+            pdf.extend_from_slice(b"\nendobj\n");
+        }
+        let xref = pdf.len();
+        pdf.extend_from_slice(
+            format!("xref\n0 {}\n0000000000 65535 f \n", offsets.len() + 1).as_bytes(),
+        );
+        for offset in offsets {
+            pdf.extend_from_slice(format!("{offset:010} 00000 n \n").as_bytes());
+        }
+        pdf.extend_from_slice(
+            format!(
+                "trailer\n<< /Size {} /Root 1 0 R >>\nstartxref\n{xref}\n%%EOF\n",
+                objects.len() + 1
+            )
+            .as_bytes(),
+        );
+        pdf
+    }
+
+    pub(crate) fn stream(dict: &str, data: &[u8]) -> Vec<u8> {
+        let mut body = format!("<< {dict} /Length {} >>\nstream\n", data.len()).into_bytes();
+        body.extend_from_slice(data);
+        body.extend_from_slice(b"\nendstream");
+        body
+    }
+
+    /// Two 200pt pages sharing a 400px colour image (one through a form)
+    /// and an 8px gray one
+    fn image_pdf() -> Vec<u8> {
+        let color: Vec<u8> = [10u8, 200, 30].repeat(400 * 400);
+        pdf_with(&[
+            b"<< /Type /Catalog /Pages 2 0 R >>".to_vec(),
+            b"<< /Type /Pages /Kids [3 0 R 4 0 R] /Count 2 /MediaBox [0 0 200 200] >>".to_vec(),
+            b"<< /Type /Page /Parent 2 0 R /Resources << /XObject << /Im0 6 0 R /Im1 7 0 R >> >> >>"
+                .to_vec(),
+            b"<< /Type /Page /Parent 2 0 R /Resources << /XObject << /Fm0 5 0 R /Im1 7 0 R >> >> >>"
+                .to_vec(),
+            stream(
+                "/Type /XObject /Subtype /Form /Resources << /XObject << /Im0 6 0 R >> >>",
+                b"/Im0 Do",
+            ),
+            stream(
+                "/Type /XObject /Subtype /Image /Width 400 /Height 400 /ColorSpace /DeviceRGB \
+                 /BitsPerComponent 8 /Filter /FlateDecode",
+                &encode_flate(&color, 6).unwrap(),
+            ),
+            stream(
+                "/Type /XObject /Subtype /Image /Width 8 /Height 8 /ColorSpace /DeviceGray \
+                 /BitsPerComponent 8",
+                &[128; 64],
+            ),
+        ])
+    }
+
+    #[test]
+    fn test_rewrite_images_once_each_within_budget() {
+        let doc = DOCUMENTS.insert(Document::new(image_pdf()));
+        let mut opts = ImageRewriterOptions::new();
+        pdf_set_color_subsample(&mut opts, 100, 72, FZ_SUBSAMPLE_AVERAGE);
+        pdf_set_color_recompress(&mut opts, FZ_RECOMPRESS_LOSSLESS);
+        pdf_set_gray_recompress(&mut opts, FZ_RECOMPRESS_LOSSLESS);
+
+        let analyzed = pdf_analyze_images(0, doc);
+        assert_eq!(
+            (
+                analyzed.images_processed,
+                analyzed.color_images,
+                analyzed.gray_images
+            ),
+            (2, 1, 1)
+        );
+        assert_eq!(analyzed.images_unchanged, 2);
+
+        // A one-byte budget puts each image in a window of its own
+        let stats = rewrite_images(doc, &opts, true, 4, 1);
+        assert_eq!((stats.images_recompressed, stats.images_subsampled), (2, 1));
+        assert!(stats.new_size < stats.original_size);
+
+        let data = DOCUMENTS.get(doc).unwrap().lock().unwrap().data();
+        let mut xref = Xref::open_lazy(0, data).unwrap();
+        let image = xref.fetch(6).unwrap();
+        assert_eq!(dict_get(&image.value, "Width").and_then(as_int), Some(200));
+        let pixels = decode_stream(&image.value, image.stream.as_ref().unwrap()).unwrap();
+        assert_eq!(pixels, [10u8, 200, 30].repeat(200 * 200));
+        let gray = xref.fetch(7).unwrap();
+        assert!(is_name(dict_get(&gray.value, "Filter"), "FlateDecode"));
+        assert_eq!(pdf_count_images(0, doc), 2);
+        DOCUMENTS.remove(doc);
+    }
+
+    #[test]
+    fn test_rewrite_decodes_jpeg_at_reduced_scale() {
+        use crate::pdf::filter::dct_scaled::tests::TestJpeg;
+
+        let jpeg = TestJpeg::encode(64, 64, &[(1, 1)], 0, |_, bx, by| {
+            let mut coef = [0; 64];
+            coef[0] = (bx * 60 + by * 30) as i32 - 300;
+            coef
+        });
+        let pdf = pdf_with(&[
+            b"<< /Type /Catalog /Pages 2 0 R >>".to_vec(),
+            b"<< /Type /Pages /Kids [3 0 R] /Count 1 /MediaBox [0 0 200 200] >>".to_vec(),
+            b"<< /Type /Page /Parent 2 0 R /Resources << /XObject << /Im0 4 0 R >> >> >>".to_vec(),
+            stream(
+                "/Type /XObject /Subtype /Image /Width 64 /Height 64 /ColorSpace /DeviceGray \
+                 /BitsPerComponent 8 /Filter /DCTDecode",
+                &jpeg,
+            ),
+        ]);
+        let doc = DOCUMENTS.insert(Document::new(pdf));
+        // 23 DPI down to 5 is a 4x subsample, all of it in the IDCT
+        let mut opts = ImageRewriterOptions::new();
+        pdf_set_gray_subsample(&mut opts, 1, 5, FZ_SUBSAMPLE_AVERAGE);
+        pdf_set_gray_recompress(&mut opts, FZ_RECOMPRESS_LOSSLESS);
+        let stats = pdf_rewrite_images_with_stats(0, doc, &mut opts);
+        assert_eq!(stats.images_subsampled, 1);
+
+        let data = DOCUMENTS.get(doc).unwrap().lock().unwrap().data();
+        let mut xref = Xref::open_lazy(0, data).unwrap();
+        let image = xref.fetch(4).unwrap();
+        assert_eq!(dict_get(&image.value, "Width").and_then(as_int), Some(16));
+        let pixels = decode_stream(&image.value, image.stream.as_ref().unwrap()).unwrap();
+        assert_eq!(pixels, decode_dct_scaled(&jpeg, 2).unwrap().samples);
+        DOCUMENTS.remove(doc);
+    }
+
+    #[test]
+    fn test_subsample_averages_partial_boxes() {
+        assert_eq!(subsample(&[10, 20, 90], 3, 1, 1, 2), (vec![15, 90], 2, 1));
+    }
 
     #[test]
     fn test_subsample_constants() {
@@ -0,0 +1,358 @@
+//! Incremental Save
+//!
+//! Appends an update to a document instead of rewriting it: the objects
+//! that changed, then an xref section covering only them, whose trailer
+//! chains back through `/Prev` to the file's newest section. The original
+//! bytes are never touched, so signatures over them stay valid, and
+//! appending to the file itself costs only the size of the edit.
+//!
+//! An object counts as changed if it went through `pdf_update_object`,
+//! `pdf_update_stream`, `pdf_create_object` or `pdf_delete_object`, or if
+//! its cached object was marked with `pdf_dirty_obj`.
+
+use super::pdf_object::refcount::with_obj;
+use super::pdf_object::{PdfObjType, pdf_obj_is_dirty};
+use super::pdf_parse::{ParsedValue, obj_to_parsed_value};
+use super::pdf_write::{Counting, PdfSink, set_key, write_value};
+use super::pdf_xref::{PDF_XREF_FREE, XREFS, Xref};
+use super::pdf_xref_lazy::dict_get;
+use super::{BUFFERS, Handle};
+use crate::pdf::filter::encode_flate;
+use bytes::Bytes;
+use std::ffi::{CStr, c_char};
+use std::fs::{self, OpenOptions};
+use std::io::{self, BufWriter};
+use std::sync::Arc;
+
+/// Deflate level for stream data set uncompressed
+const STREAM_LEVEL: u32 = 6;
+
+/// Bytes of the file's end compared before appending to it
+const TAIL_CHECK: usize = 1024;
+
+fn unsupported(msg: &str) -> io::Error {
+    io::Error::new(io::ErrorKind::Unsupported, msg.to_string())
+}
+
+/// Object numbers an incremental save writes, in order
+pub(crate) fn changed_objects(xref: &Xref) -> Vec<i32> {
+    let mut nums = xref.edited.clone();
+    nums.extend(
+        xref.cache
+            .iter()
+            .filter(|&(_, &obj)| pdf_obj_is_dirty(0, obj) != 0)
+            .map(|(&num, _)| num),
+    );
+    nums.into_iter().filter(|&num| num > 0).collect()
+}
+
+/// Current value and stream data of in-use object `num`
+fn object_body(xref: &mut Xref, num: i32) -> Option<(ParsedValue, Option<Bytes>)> {
+    let cached = xref.cache.get(&num).and_then(|&obj| {
+        with_obj(obj, None, |o| {
+            let data = match &o.obj_type {
+                PdfObjType::Stream { data, .. } => Some(Bytes::from(data.clone())),
+                _ => None,
+            };
+            Some((obj_to_parsed_value(o), data))
+        })
+    });
+    let (mut value, mut stream) = match cached {
+        Some(body) => body,
+        None => {
+            let fetched = xref.fetch(num)?;
+            (fetched.value, fetched.stream)
+        }
+    };
+
+    // A buffer from `pdf_update_stream`, as opposed to one prefetching
+    // decoded (those never mark the object edited)
+    let prefetched = |buf: &Handle| {
+        xref.source
+            .as_ref()
+            .is_some_and(|s| s.prefetched.contains(buf))
+    };
+    if let Some(buf) = xref.stream_cache.get(&num).filter(|b| !prefetched(b)) {
+        let plain = xref.get_entry(num).is_some_and(|e| e.has_stm_buf == 1);
+        let data = BUFFERS.get(*buf)?.lock().unwrap().data().to_vec();
+        stream = Some(Bytes::from(if plain {
+            let packed = encode_flate(&data, STREAM_LEVEL).ok()?;
+            set_key(
+                &mut value,
+                "Filter",
+                Some(ParsedValue::Name("FlateDecode".into())),
+            );
+            set_key(&mut value, "DecodeParms", None);
+            set_key(&mut value, "DL", Some(ParsedValue::Int(data.len() as i64)));
+            packed
+        } else {
+            data
+        }));
+    }
+    if let Some(data) = &stream {
+        set_key(
+            &mut value,
+            "Length",
+            Some(ParsedValue::Int(data.len() as i64)),
+        );
+    }
+    Some((value, stream))
+}
+
+/// Write the update for `xref`'s changes, to go right after its file
+///
+/// Offsets in the new xref section count from the start of the original
+/// file. Returns how many objects the update covers, or an error if the
+/// xref wasn't read from a file's own xref (a repaired file has no section
+/// to chain to) or the document is encrypted.
+pub fn write_update<S: PdfSink>(xref: &mut Xref, out: S) -> io::Result<usize> {
+    let source = xref
+        .source
+        .as_ref()
+        .ok_or_else(|| unsupported("xref has no source file"))?;
+    let data = Arc::clone(source.data());
+    let prev = source
+        .newest_section()
+        .ok_or_else(|| unsupported("file has no xref section to chain to"))?;
+    let trailer = xref.source_trailer().cloned().unwrap_or(ParsedValue::Null);
+    if dict_get(&trailer, "Encrypt").is_some() {
+        return Err(unsupported("encrypted documents can't be updated"));
+    }
+    let mut out = Counting {
+        inner: out,
+        pos: data.len(),
+    };
+    if !matches!(data.last(), Some(b'\n' | b'\r')) {
+        out.put(b"\n")?;
+    }
+
+    let nums = changed_objects(xref);
+    let mut entries = Vec::with_capacity(nums.len());
+    let mut buf = Vec::new();
+    for &num in &nums {
+        let entry = xref.get_entry(num).cloned();
+        let generation = entry.as_ref().map_or(0, |e| e.generation);
+        let body = match entry {
+            Some(e) if e.entry_type == PDF_XREF_FREE => None,
+            _ => object_body(xref, num),
+        };
+        let Some((value, stream)) = body else {
+            entries.push((num, None, generation));
+            continue;
+        };
+        entries.push((num, Some(out.pos), generation));
+        buf.clear();
+        buf.extend_from_slice(format!("{num} {generation} obj\n").as_bytes());
+        write_value(&value, &mut buf);
+        match stream {
+            Some(data) => {
+                buf.extend_from_slice(b"\nstream\n");
+                out.put(&buf)?;
+                out.put_bytes(data)?;
+                out.put(b"\nendstream\nendobj\n")?;
+            }
+            None => {
+                buf.extend_from_slice(b"\nendobj\n");
+                out.put(&buf)?;
+            }
+        }
+    }
+
+    let old_size = dict_get(&trailer, "Size").and_then(super::pdf_xref_lazy::as_int);
+    let size = i64::from(xref.num_objects)
+        .max(old_size.unwrap_or(0))
+        .max(nums.last().map_or(0, |&n| i64::from(n) + 1));
+    finish_update(&mut out, &trailer, prev, size, &entries)?;
+    Ok(nums.len())
+}
+
+/// Finish an update with an xref section over `entries`, as (number,
+/// offset or `None` if freed, generation) in ascending number order, and
+/// a trailer of `size` objects chained to the section at `prev`, then
+/// flush the sink
+pub(crate) fn finish_update<S: PdfSink>(
+    out: &mut Counting<S>,
+    trailer: &ParsedValue,
+    prev: usize,
+    size: i64,
+    entries: &[(i32, Option<usize>, u16)],
+) -> io::Result<()> {
+    // One subsection per run of consecutive numbers
+    let xref_offset = out.pos;
+    let mut buf = b"xref\n".to_vec();
+    for run in entries.chunk_by(|a, b| b.0 == a.0 + 1) {
+        buf.extend_from_slice(format!("{} {}\n", run[0].0, run.len()).as_bytes());
+        for &(_, offset, generation) in run {
+            let line = match offset {
+                Some(offset) => format!("{offset:010} {generation:05} n \n"),
+                None => format!("0000000000 {generation:05} f \n"),
+            };
+            buf.extend_from_slice(line.as_bytes());
+        }
+    }
+
+    let mut dict = vec![("Size".to_string(), ParsedValue::Int(size))];
+    for key in ["Root", "Info", "ID"] {
+        if let Some(value) = dict_get(trailer, key) {
+            dict.push((key.to_string(), value.clone()));
+        }
+    }
+    dict.push(("Prev".to_string(), ParsedValue::Int(prev as i64)));
+    buf.extend_from_slice(b"trailer\n");
+    write_value(&ParsedValue::Dict(dict), &mut buf);
+    buf.extend_from_slice(format!("\nstartxref\n{xref_offset}\n%%EOF\n").as_bytes());
+    out.put(&buf)?;
+    out.inner.finish()
+}
+
+fn path_arg(filename: *const c_char) -> Option<&'static str> {
+    if filename.is_null() {
+        return None;
+    }
+    // SAFETY: caller guarantees a non-null `filename` is a C string
+    unsafe { CStr::from_ptr(filename) }.to_str().ok()
+}
+
+/// Save xref's document with its changes appended as an update, to a new
+/// file
+///
+/// The original bytes are copied unchanged. Returns the number of objects
+/// updated, or -1 on error.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_save_xref_incremental(
+    _ctx: Handle,
+    xref: Handle,
+    filename: *const c_char,
+) -> i32 {
+    let (Some(path), Some(xref)) = (path_arg(filename), XREFS.get(xref)) else {
+        return -1;
+    };
+    let mut xref = xref.lock().unwrap();
+    let Some(data) = xref.source.as_ref().map(|s| s.data().clone()) else {
+        return -1;
+    };
+    let result = fs::File::create(path).and_then(|file| {
+        let mut out = BufWriter::new(file);
+        out.put(&data[..])?;
+        write_update(&mut xref, out)
+    });
+    result.map_or(-1, |n| n as i32)
+}
+
+/// Append xref's changes as an update to the end of `filename`, which
+/// must still be the file the xref was read from
+///
+/// Only the update is written, so the cost is the size of the edit. The
+/// file's length and tail are checked against the xref's source first.
+/// Returns the number of objects updated, or -1 on error.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_append_xref_incremental(
+    _ctx: Handle,
+    xref: Handle,
+    filename: *const c_char,
+) -> i32 {
+    let (Some(path), Some(xref)) = (path_arg(filename), XREFS.get(xref)) else {
+        return -1;
+    };
+    let mut xref = xref.lock().unwrap();
+    let Some(data) = xref.source.as_ref().map(|s| s.data().clone()) else {
+        return -1;
+    };
+    let result = OpenOptions::new()
+        .read(true)
+        .append(true)
+        .open(path)
+        .and_then(|file| {
+            use std::io::{Read, Seek, SeekFrom};
+            let mut file = file;
+            if file.metadata()?.len() != data.len() as u64 {
+                return Err(unsupported("file changed since it was read"));
+            }
+            let tail = data.len().min(TAIL_CHECK);
+            let mut end = vec![0; tail];
+            file.seek(SeekFrom::End(-(tail as i64)))?;
+            file.read_exact(&mut end)?;
+            if end[..] != data[data.len() - tail..] {
+                return Err(unsupported("file changed since it was read"));
+            }
+            write_update(&mut xref, BufWriter::new(file))
+        });
+    result.map_or(-1, |n| n as i32)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::super::buffer::Buffer;
+    use super::super::pdf_object::{pdf_dict_puts, pdf_dirty_obj, pdf_new_int};
+    use super::super::pdf_xref::{pdf_delete_object, pdf_update_stream};
+    use super::super::pdf_xref_lazy::as_int;
+    use super::super::pdf_xref_lazy::tests::sample_pdf;
+    use super::*;
+
+    fn open(data: Vec<u8>) -> Xref {
+        Xref::open_lazy(0, Arc::new(data.into())).unwrap()
+    }
+
+    #[test]
+    fn test_update_appends_only_changes() {
+        let original = sample_pdf();
+        let handle = XREFS.insert(open(original.clone()));
+        let xref = XREFS.get(handle).unwrap();
+
+        // Edit a cached object in place and mark it
+        let page = xref.lock().unwrap().load_object(4);
+        let rotate = pdf_new_int(0, 90);
+        let key = c"Rotate";
+        pdf_dict_puts(0, page, key.as_ptr(), rotate);
+        pdf_dirty_obj(0, page);
+
+        // Replace a stream's data and drop an object
+        let buffer = BUFFERS.insert(Buffer::from_vec(b"BT 2 Tf ET".to_vec()));
+        assert_eq!(pdf_update_stream(0, handle, 6, buffer, 0), 1);
+        pdf_delete_object(0, handle, 10);
+
+        let mut update = Vec::new();
+        let count = write_update(&mut xref.lock().unwrap(), &mut update).unwrap();
+        assert_eq!(count, 3);
+        assert!(update.len() < 600);
+
+        let mut saved = original.clone();
+        saved.extend_from_slice(&update);
+        let mut reread = open(saved.clone());
+        let page = reread.fetch(4).unwrap().value;
+        assert_eq!(dict_get(&page, "Rotate").and_then(as_int), Some(90));
+        let contents = reread.fetch(6).unwrap();
+        let raw = contents.stream.unwrap();
+        assert_eq!(
+            super::super::pdf_xref_lazy::decode_stream(&contents.value, &raw).unwrap(),
+            b"BT 2 Tf ET"
+        );
+        assert!(reread.fetch(10).is_none());
+        // Untouched objects still come from the older sections
+        assert!(reread.fetch(7).is_some());
+        assert_eq!(&saved[..original.len()], &original[..]);
+
+        BUFFERS.remove(buffer);
+        XREFS.remove(handle);
+    }
+
+    #[test]
+    fn test_append_checks_the_file() {
+        let original = sample_pdf();
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("doc.pdf");
+        fs::write(&path, &original).unwrap();
+        let c_path = std::ffi::CString::new(path.to_str().unwrap()).unwrap();
+
+        let handle = XREFS.insert(open(original.clone()));
+        pdf_delete_object(0, handle, 10);
+        assert_eq!(pdf_append_xref_incremental(0, handle, c_path.as_ptr()), 1);
+        let appended = fs::read(&path).unwrap();
+        assert!(appended.starts_with(&original));
+        assert!(open(appended).fetch(10).is_none());
+
+        // The file grew, so it no longer matches the xref
+        assert_eq!(pdf_append_xref_incremental(0, handle, c_path.as_ptr()), -1);
+        XREFS.remove(handle);
+    }
+}
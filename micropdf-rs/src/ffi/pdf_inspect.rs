@@ -0,0 +1,681 @@
+//! Document Inspection
+//!
+//! Cataloguing a document took a metadata lookup per key, a page load per
+//! page for its size and links, and an outline load. `inspect` gathers the
+//! metadata, page sizes and labels, outline, links, fonts and image counts
+//! in one walk over the object graph, as one JSON value. Only dictionaries
+//! are read: content streams are never touched, so images drawn inline in
+//! a content stream are not counted, and fonts and images are found
+//! through page and form resources.
+
+use super::json::JsonValue;
+use super::mmap::FileBytes;
+use super::pdf_form_fill::text_string;
+use super::pdf_page_tree::{IndexedPage, PageIndex};
+use super::pdf_parse::ParsedValue;
+use super::pdf_write::open_source;
+use super::pdf_xref::Xref;
+use super::pdf_xref_lazy::{as_ref, dict_get, header_version, is_name};
+use std::collections::{HashMap, HashSet};
+use std::sync::Arc;
+
+/// Deepest outline nesting followed
+const MAX_OUTLINE_DEPTH: usize = 32;
+
+/// Deepest nesting of form XObjects followed for resources
+const MAX_FORM_DEPTH: usize = 8;
+
+/// Deepest name tree walked for named destinations
+const MAX_NAME_TREE_DEPTH: usize = 16;
+
+/// Inspect the document in `data`
+///
+/// `format` and `page_count` describe the document when it is not a PDF
+/// that can be read; the result then has no pages.
+pub fn inspect(data: &Arc<FileBytes>, format: &str, page_count: i32) -> JsonValue {
+    let format = match header_version(data) {
+        Some(v) => format!("PDF {}.{}", v / 10, v % 10),
+        None => format.to_string(),
+    };
+    let mut result = vec![("format".to_string(), JsonValue::String(format))];
+
+    let inspector = data
+        .starts_with(b"%PDF-")
+        .then(|| Inspector::open(data))
+        .flatten();
+    let Some(mut inspector) = inspector else {
+        result.extend([
+            ("page_count".to_string(), number(page_count)),
+            ("metadata".to_string(), JsonValue::Object(Vec::new())),
+            ("outline".to_string(), JsonValue::Array(Vec::new())),
+            ("fonts".to_string(), JsonValue::Array(Vec::new())),
+            ("image_count".to_string(), number(0)),
+            ("pages".to_string(), JsonValue::Array(Vec::new())),
+        ]);
+        return JsonValue::Object(result);
+    };
+
+    let pages = inspector.index.pages().to_vec();
+    let pages = pages.into_iter().map(|p| inspector.page(p)).collect();
+    result.extend([
+        (
+            "page_count".to_string(),
+            number(inspector.index.len() as u32),
+        ),
+        ("metadata".to_string(), inspector.metadata()),
+        ("outline".to_string(), inspector.outline()),
+        ("fonts".to_string(), JsonValue::Array(inspector.fonts)),
+        (
+            "image_count".to_string(),
+            number(inspector.images.len() as u32),
+        ),
+        ("pages".to_string(), JsonValue::Array(pages)),
+    ]);
+    JsonValue::Object(result)
+}
+
+fn number(n: impl Into<f64>) -> JsonValue {
+    JsonValue::Number(n.into())
+}
+
+fn as_number(value: &ParsedValue) -> Option<f32> {
+    match value {
+        ParsedValue::Int(i) => Some(*i as f32),
+        ParsedValue::Real(r) => Some(*r),
+        _ => None,
+    }
+}
+
+/// A rectangle array, normalized so x0 <= x1 and y0 <= y1
+fn as_rect(value: &ParsedValue) -> Option<[f32; 4]> {
+    let ParsedValue::Array(items) = value else {
+        return None;
+    };
+    let [x0, y0, x1, y1] = items.as_slice() else {
+        return None;
+    };
+    let [x0, y0, x1, y1] = [x0, y0, x1, y1].map(as_number);
+    let (x0, y0, x1, y1) = (x0?, y0?, x1?, y1?);
+    Some([x0.min(x1), y0.min(y1), x0.max(x1), y0.max(y1)])
+}
+
+fn rect_json(rect: [f32; 4]) -> JsonValue {
+    JsonValue::Array(rect.into_iter().map(number).collect())
+}
+
+/// Where a link or outline item goes
+#[derive(Default)]
+struct Target {
+    page: Option<usize>,
+    uri: Option<String>,
+}
+
+impl Target {
+    fn append_to(self, entries: &mut Vec<(String, JsonValue)>) {
+        if let Some(page) = self.page {
+            entries.push(("page".to_string(), number(page as u32)));
+        }
+        if let Some(uri) = self.uri {
+            entries.push(("uri".to_string(), JsonValue::String(uri)));
+        }
+    }
+}
+
+struct Inspector {
+    xref: Xref,
+    index: PageIndex,
+    trailer: ParsedValue,
+    catalog: ParsedValue,
+    /// Named destinations, read the first time a link names one
+    dests: Option<HashMap<Vec<u8>, ParsedValue>>,
+    /// Fonts used by any page, in the order first met
+    fonts: Vec<JsonValue>,
+    /// Position in `fonts`, by object number
+    font_ids: HashMap<i32, usize>,
+    /// Image XObjects used by any page
+    images: HashSet<i32>,
+}
+
+impl Inspector {
+    fn open(data: &Arc<FileBytes>) -> Option<Self> {
+        let mut xref = open_source(data, 1)?;
+        let index = PageIndex::read(&mut xref, 1)?;
+        let trailer = xref.source_trailer()?.clone();
+        let catalog = dict_get(&trailer, "Root")
+            .and_then(as_ref)
+            .and_then(|num| xref.fetch(num))
+            .map(|f| f.value)?;
+        Some(Self {
+            xref,
+            index,
+            trailer,
+            catalog,
+            dests: None,
+            fonts: Vec::new(),
+            font_ids: HashMap::new(),
+            images: HashSet::new(),
+        })
+    }
+
+    /// `value`, or the object it refers to
+    fn resolve(&mut self, value: &ParsedValue) -> Option<ParsedValue> {
+        match as_ref(value) {
+            Some(num) => self.xref.fetch(num).map(|f| f.value),
+            None => Some(value.clone()),
+        }
+    }
+
+    /// The document information dictionary's text entries
+    fn metadata(&mut self) -> JsonValue {
+        let info = dict_get(&self.trailer, "Info")
+            .cloned()
+            .and_then(|info| self.resolve(&info));
+        let mut entries = Vec::new();
+        if let Some(ParsedValue::Dict(info)) = info {
+            for (key, value) in info {
+                let text = match self.resolve(&value) {
+                    Some(ParsedValue::String(bytes)) => text_string(&bytes),
+                    Some(ParsedValue::Name(name)) => name,
+                    _ => continue,
+                };
+                entries.push((key, JsonValue::String(text)));
+            }
+        }
+        JsonValue::Object(entries)
+    }
+
+    // ========================================================================
+    // Pages
+    // ========================================================================
+
+    fn page(&mut self, page: IndexedPage) -> JsonValue {
+        let value = self.xref.fetch(page.num).map(|f| f.value);
+        let value = value.unwrap_or(ParsedValue::Null);
+        let attr = |key: &str| {
+            dict_get(&value, key).cloned().or_else(|| {
+                page.inherited
+                    .iter()
+                    .find(|(k, _)| k == key)
+                    .map(|(_, v)| v.clone())
+            })
+        };
+        let (media, crop, rotate, resources) = (
+            attr("MediaBox"),
+            attr("CropBox"),
+            attr("Rotate"),
+            attr("Resources"),
+        );
+
+        let media = media
+            .and_then(|v| self.resolve(&v))
+            .and_then(|v| as_rect(&v))
+            .unwrap_or([0.0, 0.0, 612.0, 792.0]);
+        let bounds = crop
+            .and_then(|v| self.resolve(&v))
+            .and_then(|v| as_rect(&v))
+            .map_or(media, |c| {
+                [
+                    c[0].max(media[0]),
+                    c[1].max(media[1]),
+                    c[2].min(media[2]),
+                    c[3].min(media[3]),
+                ]
+            });
+        let rotation = rotate
+            .and_then(|v| self.resolve(&v))
+            .and_then(|v| as_number(&v))
+            .map_or(0, |r| (r as i32).rem_euclid(360) / 90 * 90);
+
+        let mut fonts = Vec::new();
+        let mut images = HashSet::new();
+        if let Some(resources) = resources {
+            self.resources(&resources, &mut fonts, &mut images, 0, &mut HashSet::new());
+        }
+        let links = dict_get(&value, "Annots")
+            .cloned()
+            .map_or_else(Vec::new, |annots| self.links(&annots));
+
+        JsonValue::Object(vec![
+            ("label".to_string(), JsonValue::String(page.label)),
+            ("bounds".to_string(), rect_json(bounds)),
+            ("rotation".to_string(), number(rotation)),
+            ("links".to_string(), JsonValue::Array(links)),
+            (
+                "fonts".to_string(),
+                JsonValue::Array(fonts.into_iter().map(|id| number(id as u32)).collect()),
+            ),
+            ("images".to_string(), number(images.len() as u32)),
+        ])
+    }
+
+    /// Fonts (as positions in `self.fonts`) and images a resource
+    /// dictionary uses, following form XObjects
+    fn resources(
+        &mut self,
+        resources: &ParsedValue,
+        fonts: &mut Vec<usize>,
+        images: &mut HashSet<i32>,
+        depth: usize,
+        forms: &mut HashSet<i32>,
+    ) {
+        let Some(resources) = self.resolve(resources) else {
+            return;
+        };
+        let font_dict = dict_get(&resources, "Font").and_then(|f| self.resolve(f));
+        if let Some(ParsedValue::Dict(entries)) = font_dict {
+            for (_, font) in entries {
+                let id = self.font(&font);
+                if !fonts.contains(&id) {
+                    fonts.push(id);
+                }
+            }
+        }
+
+        let xobjects = dict_get(&resources, "XObject").and_then(|x| self.resolve(x));
+        let Some(ParsedValue::Dict(entries)) = xobjects else {
+            return;
+        };
+        for (_, xobject) in entries {
+            let Some(num) = as_ref(&xobject) else {
+                continue;
+            };
+            let Some(value) = self.xref.fetch(num).map(|f| f.value) else {
+                continue;
+            };
+            let subtype = dict_get(&value, "Subtype");
+            if is_name(subtype, "Image") {
+                images.insert(num);
+                self.images.insert(num);
+            } else if is_name(subtype, "Form") && depth < MAX_FORM_DEPTH && forms.insert(num) {
+                if let Some(inner) = dict_get(&value, "Resources") {
+                    self.resources(inner, fonts, images, depth + 1, forms);
+                }
+            }
+        }
+    }
+
+    /// Position of a font in `self.fonts`, adding it when first met
+    fn font(&mut self, font: &ParsedValue) -> usize {
+        let num = as_ref(font);
+        if let Some(id) = num.and_then(|n| self.font_ids.get(&n)) {
+            return *id;
+        }
+        let dict = self.resolve(font).unwrap_or(ParsedValue::Null);
+        let name = match dict_get(&dict, "BaseFont") {
+            Some(ParsedValue::Name(name)) => name.clone(),
+            _ => String::new(),
+        };
+        let subtype = match dict_get(&dict, "Subtype") {
+            Some(ParsedValue::Name(name)) => name.clone(),
+            _ => String::new(),
+        };
+
+        // Composite fonts describe their program in the descendant font
+        let described = if subtype == "Type0" {
+            match dict_get(&dict, "DescendantFonts").and_then(|d| self.resolve(d)) {
+                Some(ParsedValue::Array(fonts)) => fonts.first().and_then(|f| self.resolve(f)),
+                _ => None,
+            }
+            .unwrap_or(ParsedValue::Null)
+        } else {
+            dict
+        };
+        let descriptor = dict_get(&described, "FontDescriptor")
+            .cloned()
+            .and_then(|d| self.resolve(&d))
+            .unwrap_or(ParsedValue::Null);
+        let embedded = subtype == "Type3"
+            || ["FontFile", "FontFile2", "FontFile3"]
+                .iter()
+                .any(|key| dict_get(&descriptor, key).is_some());
+
+        let id = self.fonts.len();
+        self.fonts.push(JsonValue::Object(vec![
+            ("name".to_string(), JsonValue::String(name)),
+            ("type".to_string(), JsonValue::String(subtype)),
+            ("embedded".to_string(), JsonValue::Bool(embedded)),
+        ]));
+        if let Some(num) = num {
+            self.font_ids.insert(num, id);
+        }
+        id
+    }
+
+    fn links(&mut self, annots: &ParsedValue) -> Vec<JsonValue> {
+        let Some(ParsedValue::Array(annots)) = self.resolve(annots) else {
+            return Vec::new();
+        };
+        let mut links = Vec::new();
+        for annot in annots {
+            let Some(annot) = self.resolve(&annot) else {
+                continue;
+            };
+            if !is_name(dict_get(&annot, "Subtype"), "Link") {
+                continue;
+            }
+            let Some(rect) = dict_get(&annot, "Rect").and_then(as_rect) else {
+                continue;
+            };
+            let mut entries = vec![("rect".to_string(), rect_json(rect))];
+            self.target(&annot).append_to(&mut entries);
+            links.push(JsonValue::Object(entries));
+        }
+        links
+    }
+
+    // ========================================================================
+    // Destinations
+    // ========================================================================
+
+    /// The target of a link annotation or outline item, from its `/Dest`
+    /// or `/A` action
+    fn target(&mut self, item: &ParsedValue) -> Target {
+        if let Some(dest) = dict_get(item, "Dest") {
+            return Target {
+                page: self.dest_page(dest, 0),
+                uri: None,
+            };
+        }
+        let action = dict_get(item, "A")
+            .cloned()
+            .and_then(|a| self.resolve(&a))
+            .unwrap_or(ParsedValue::Null);
+        let Some(ParsedValue::Name(kind)) = dict_get(&action, "S") else {
+            return Target::default();
+        };
+        match kind.as_str() {
+            "URI" => Target {
+                page: None,
+                uri: match dict_get(&action, "URI").and_then(|u| self.resolve(u)) {
+                    Some(ParsedValue::String(uri)) => Some(String::from_utf8_lossy(&uri).into()),
+                    _ => None,
+                },
+            },
+            "GoTo" => Target {
+                page: dict_get(&action, "D").and_then(|d| self.dest_page(d, 0)),
+                uri: None,
+            },
+            "GoToR" | "Launch" => Target {
+                page: None,
+                uri: match dict_get(&action, "F").and_then(|f| self.resolve(f)) {
+                    Some(ParsedValue::String(file)) => Some(text_string(&file)),
+                    Some(dict @ ParsedValue::Dict(_)) => match dict_get(&dict, "F") {
+                        Some(ParsedValue::String(file)) => Some(text_string(file)),
+                        _ => None,
+                    },
+                    _ => None,
+                },
+            },
+            _ => Target::default(),
+        }
+    }
+
+    /// Page index a destination points at
+    fn dest_page(&mut self, dest: &ParsedValue, depth: usize) -> Option<usize> {
+        match self.resolve(dest)? {
+            ParsedValue::Array(items) => match items.first()? {
+                ParsedValue::Reference { num, .. } => self.index.page_number(*num),
+                // Remote destinations give the page number
+                ParsedValue::Int(n) => usize::try_from(*n).ok(),
+                _ => None,
+            },
+            ParsedValue::Dict(entries) if depth == 0 => {
+                let d = entries.into_iter().find(|(k, _)| k == "D")?.1;
+                self.dest_page(&d, depth + 1)
+            }
+            ParsedValue::Name(name) if depth == 0 => self.named_dest_page(name.as_bytes()),
+            ParsedValue::String(name) if depth == 0 => self.named_dest_page(&name),
+            _ => None,
+        }
+    }
+
+    fn named_dest_page(&mut self, name: &[u8]) -> Option<usize> {
+        if self.dests.is_none() {
+            let dests = self.named_dests();
+            self.dests = Some(dests);
+        }
+        let dest = self.dests.as_ref()?.get(name)?.clone();
+        self.dest_page(&dest, 1).or_else(|| {
+            // A dictionary with the destination in /D
+            let dict = self.resolve(&dest)?;
+            let d = dict_get(&dict, "D")?.clone();
+            self.dest_page(&d, 1)
+        })
+    }
+
+    /// Every named destination, from the catalog's `/Dests` dictionary and
+    /// the `/Dests` name tree
+    fn named_dests(&mut self) -> HashMap<Vec<u8>, ParsedValue> {
+        let mut dests = HashMap::new();
+        let old = dict_get(&self.catalog, "Dests").cloned();
+        if let Some(ParsedValue::Dict(entries)) = old.and_then(|d| self.resolve(&d)) {
+            for (name, dest) in entries {
+                dests.insert(name.into_bytes(), dest);
+            }
+        }
+
+        let names = dict_get(&self.catalog, "Names")
+            .cloned()
+            .and_then(|n| self.resolve(&n))
+            .unwrap_or(ParsedValue::Null);
+        let Some(root) = dict_get(&names, "Dests").cloned() else {
+            return dests;
+        };
+        let mut seen = HashSet::new();
+        let mut stack = vec![(root, 0)];
+        while let Some((node, depth)) = stack.pop() {
+            if let Some(num) = as_ref(&node) {
+                if !seen.insert(num) {
+                    continue;
+                }
+            }
+            let Some(node) = self.resolve(&node) else {
+                continue;
+            };
+            if let Some(ParsedValue::Array(pairs)) = dict_get(&node, "Names") {
+                for pair in pairs.chunks_exact(2) {
+                    if let ParsedValue::String(name) = &pair[0] {
+                        dests.entry(name.clone()).or_insert_with(|| pair[1].clone());
+                    }
+                }
+            }
+            if depth < MAX_NAME_TREE_DEPTH {
+                if let Some(ParsedValue::Array(kids)) = dict_get(&node, "Kids") {
+                    stack.extend(kids.iter().map(|kid| (kid.clone(), depth + 1)));
+                }
+            }
+        }
+        dests
+    }
+
+    // ========================================================================
+    // Outline
+    // ========================================================================
+
+    fn outline(&mut self) -> JsonValue {
+        let root = dict_get(&self.catalog, "Outlines")
+            .cloned()
+            .and_then(|o| self.resolve(&o))
+            .unwrap_or(ParsedValue::Null);
+        let mut seen = HashSet::new();
+        let items = match dict_get(&root, "First").and_then(as_ref) {
+            Some(first) => self.outline_items(first, 0, &mut seen),
+            None => Vec::new(),
+        };
+        JsonValue::Array(items)
+    }
+
+    /// The outline item `first` and its siblings
+    fn outline_items(
+        &mut self,
+        first: i32,
+        depth: usize,
+        seen: &mut HashSet<i32>,
+    ) -> Vec<JsonValue> {
+        let mut items = Vec::new();
+        let mut next = Some(first);
+        while let Some(num) = next.filter(|&n| seen.insert(n)) {
+            let Some(item) = self.xref.fetch(num).map(|f| f.value) else {
+                break;
+            };
+            let title = match dict_get(&item, "Title").and_then(|t| self.resolve(t)) {
+                Some(ParsedValue::String(title)) => text_string(&title),
+                _ => String::new(),
+            };
+            let mut entries = vec![("title".to_string(), JsonValue::String(title))];
+            self.target(&item).append_to(&mut entries);
+            let children = match dict_get(&item, "First").and_then(as_ref) {
+                Some(child) if depth + 1 < MAX_OUTLINE_DEPTH => {
+                    self.outline_items(child, depth + 1, seen)
+                }
+                _ => Vec::new(),
+            };
+            entries.push(("children".to_string(), JsonValue::Array(children)));
+            items.push(JsonValue::Object(entries));
+            next = dict_get(&item, "Next").and_then(as_ref);
+        }
+        items
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// A PDF with no xref, holding `objects` as (number, body), with
+    /// document information in object 99
+    fn pdf(objects: &[(i32, &str)]) -> Arc<FileBytes> {
+        let mut pdf = b"%PDF-1.6\n".to_vec();
+        for (num, body) in objects {
+            pdf.extend_from_slice(format!("{num} 0 obj\n{body}\nendobj\n").as_bytes());
+        }
+        pdf.extend_from_slice(b"trailer\n<< /Root 1 0 R /Info 99 0 R >>\n%%EOF\n");
+        Arc::new(pdf.into())
+    }
+
+    fn get<'a>(value: &'a JsonValue, key: &str) -> &'a JsonValue {
+        let entries = value.as_object().unwrap();
+        &entries.iter().find(|(k, _)| k == key).unwrap().1
+    }
+
+    #[test]
+    fn test_inspect_catalogues_without_contents() {
+        let data = pdf(&[
+            (
+                1,
+                "<< /Type /Catalog /Pages 2 0 R /Outlines 20 0 R /PageLabels << /Nums [0 << /S /r >>] >> /Names << /Dests 30 0 R >> >>",
+            ),
+            (
+                2,
+                "<< /Type /Pages /Kids [3 0 R 4 0 R] /Count 2 /MediaBox [0 0 612 792] /Resources << /Font << /F1 10 0 R >> >> >>",
+            ),
+            (
+                3,
+                "<< /Type /Page /Parent 2 0 R /Contents 50 0 R /Annots [40 0 R 41 0 R 42 0 R] >>",
+            ),
+            (
+                4,
+                "<< /Type /Page /Parent 2 0 R /MediaBox [0 0 300 400] /CropBox [10 10 290 500] /Rotate -90 /Resources << /Font << /F1 10 0 R /F2 11 0 R >> /XObject << /Im1 12 0 R /Fm1 13 0 R >> >> >>",
+            ),
+            (10, "<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>"),
+            (
+                11,
+                "<< /Type /Font /Subtype /Type0 /BaseFont /Arial-Bold /DescendantFonts [14 0 R] >>",
+            ),
+            (
+                12,
+                "<< /Type /XObject /Subtype /Image /Width 1 /Height 1 /Length 1 >>\nstream\nx\nendstream",
+            ),
+            (
+                13,
+                "<< /Type /XObject /Subtype /Form /Resources << /XObject << /Im2 15 0 R /Im1 12 0 R >> >> /Length 0 >>\nstream\n\nendstream",
+            ),
+            (
+                14,
+                "<< /Type /Font /Subtype /CIDFontType2 /FontDescriptor 16 0 R >>",
+            ),
+            (
+                15,
+                "<< /Type /XObject /Subtype /Image /Width 1 /Height 1 /Length 1 >>\nstream\ny\nendstream",
+            ),
+            (16, "<< /Type /FontDescriptor /FontFile2 17 0 R >>"),
+            (20, "<< /Type /Outlines /First 21 0 R >>"),
+            (
+                21,
+                "<< /Title (Intro) /Dest [3 0 R /Fit] /Next 22 0 R /First 23 0 R >>",
+            ),
+            (
+                22,
+                "<< /Title <FEFF0042> /A << /S /GoTo /D (end) >> /Next 21 0 R >>",
+            ),
+            (
+                23,
+                "<< /Title (Child) /A << /S /URI /URI (https://example.com/c) >> >>",
+            ),
+            (30, "<< /Names [(end) [4 0 R /XYZ 0 0 0]] >>"),
+            (
+                40,
+                "<< /Subtype /Link /Rect [100 200 50 20] /A << /S /URI /URI (https://example.com) >> >>",
+            ),
+            (41, "<< /Subtype /Link /Rect [0 0 10 10] /Dest /end >>"),
+            (42, "<< /Subtype /Text /Rect [0 0 10 10] >>"),
+            (50, "<< /Length 999999 >>\nstream\nBT ET\nendstream"),
+            (
+                99,
+                "<< /Title (Report) /Author <FEFF00C9> /Trapped /False >>",
+            ),
+        ]);
+        let result = inspect(&data, "PDF", 1);
+
+        assert_eq!(get(&result, "format").as_str(), Some("PDF 1.6"));
+        assert_eq!(get(&result, "page_count").as_number(), Some(2.0));
+        let metadata = get(&result, "metadata");
+        assert_eq!(get(metadata, "Title").as_str(), Some("Report"));
+        assert_eq!(get(metadata, "Author").as_str(), Some("\u{c9}"));
+        assert_eq!(get(metadata, "Trapped").as_str(), Some("False"));
+
+        let fonts = get(&result, "fonts").as_array().unwrap();
+        assert_eq!(fonts.len(), 2);
+        assert_eq!(get(&fonts[0], "name").as_str(), Some("Helvetica"));
+        assert_eq!(get(&fonts[0], "embedded").as_bool(), Some(false));
+        assert_eq!(get(&fonts[1], "type").as_str(), Some("Type0"));
+        assert_eq!(get(&fonts[1], "embedded").as_bool(), Some(true));
+        assert_eq!(get(&result, "image_count").as_number(), Some(2.0));
+
+        let pages = get(&result, "pages").as_array().unwrap();
+        assert_eq!(get(&pages[0], "label").as_str(), Some("i"));
+        assert_eq!(get(&pages[1], "label").as_str(), Some("ii"));
+        assert_eq!(get(&pages[1], "bounds").to_json_string(), "[10,10,290,400]");
+        assert_eq!(get(&pages[1], "rotation").as_number(), Some(270.0));
+        assert_eq!(get(&pages[1], "fonts").to_json_string(), "[0,1]");
+        assert_eq!(get(&pages[1], "images").as_number(), Some(2.0));
+        assert_eq!(get(&pages[0], "images").as_number(), Some(0.0));
+
+        let links = get(&pages[0], "links").as_array().unwrap();
+        assert_eq!(links.len(), 2);
+        assert_eq!(get(&links[0], "rect").to_json_string(), "[50,20,100,200]");
+        assert_eq!(get(&links[0], "uri").as_str(), Some("https://example.com"));
+        assert_eq!(get(&links[1], "page").as_number(), Some(1.0));
+
+        // The outline's cycle back to its first item is cut
+        let outline = get(&result, "outline").as_array().unwrap();
+        assert_eq!(outline.len(), 2);
+        assert_eq!(get(&outline[0], "page").as_number(), Some(0.0));
+        let children = get(&outline[0], "children").as_array().unwrap();
+        assert_eq!(
+            get(&children[0], "uri").as_str(),
+            Some("https://example.com/c")
+        );
+        assert_eq!(get(&outline[1], "title").as_str(), Some("B"));
+        assert_eq!(get(&outline[1], "page").as_number(), Some(1.0));
+    }
+
+    #[test]
+    fn test_inspect_other_formats() {
+        let data = Arc::new(FileBytes::from(b"<?xml version=\"1.0\"?>".to_vec()));
+        let result = inspect(&data, "XML", 3);
+        assert_eq!(get(&result, "format").as_str(), Some("XML"));
+        assert_eq!(get(&result, "page_count").as_number(), Some(3.0));
+        assert!(get(&result, "pages").as_array().unwrap().is_empty());
+    }
+}
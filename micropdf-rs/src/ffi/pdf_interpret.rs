@@ -3,19 +3,42 @@
 //! Provides PDF content stream processing capabilities:
 //! - Processor base with operator callbacks
 //! - Run processor (rendering)
+//! - Text processor (text state and CTM only, for extraction)
 //! - Buffer processor (collect to buffer)
 //! - Output processor (write to stream)
 //! - Sanitize filter (clean content)
 //! - Color filter (recolor content)
-//! - Content stream processing
+//! - Content stream processing, through a compiled-dispatch interpreter
+//!   (see `pdf_opcode` and `PdfProcessor::run_contents`); streams of
+//!   document objects are compiled once and replayed from the store
 
+use crate::ffi::annot::ANNOTATIONS;
+use crate::ffi::device::DEVICES;
 use crate::ffi::ffi_safety::{cstr_to_str, raw_to_slice, write_out};
-use crate::ffi::{Handle, HandleStore};
-use crate::fitz::geometry::{Matrix, Rect};
+use crate::ffi::image::IMAGES;
+use crate::ffi::mmap::FileBytes;
+use crate::ffi::output::OUTPUTS;
+use crate::ffi::pdf_image_rewriter::resolve;
+use crate::ffi::pdf_object::extract::pdf_to_num;
+use crate::ffi::pdf_opcode::{ContentLexer, ContentProgram, Opcode, Operand, OperandStack, Token};
+use crate::ffi::pdf_parse::ParsedValue;
+use crate::ffi::pdf_write::{open_source, write_name, write_string};
+use crate::ffi::pdf_xref_lazy::{as_ref, decode_stream, dict_get};
+use crate::ffi::store::{StoreType, store_discard_matching, store_find_and_keep, store_owned_item};
+use crate::ffi::{BUFFERS, DOCUMENTS, Handle, HandleStore, STREAMS};
+use crate::fitz::colorspace::Colorspace;
+use crate::fitz::counters::{self, Counter};
+use crate::fitz::device::Device;
+use crate::fitz::font::Font;
+use crate::fitz::geometry::{Matrix, Point, Rect};
+use crate::fitz::output::{OUTPUT_BUFFER_SIZE, push_int, push_real};
+use crate::fitz::path::{LineCap, LineJoin, Path, StrokeState};
+use crate::fitz::text::{self as fitz_text, Text, TextItem};
+use crate::pdf::annot::{AnnotType, Annotation};
 use std::collections::HashMap;
 use std::ffi::{CStr, CString, c_char, c_void};
 use std::ptr;
-use std::sync::LazyLock;
+use std::sync::{Arc, LazyLock, Mutex};
 
 // ============================================================================
 // Types and Enums
@@ -80,6 +103,9 @@ pub enum ProcessorType {
     Sanitize = 4,
     Color = 5,
     Vectorize = 6,
+    Text = 7,
+    /// Feeds every operator to several processors
+    Tee = 8,
 }
 
 // ============================================================================
@@ -127,6 +153,8 @@ pub struct PdfGstate {
     pub op_fill: bool,
     /// Overprint mode
     pub opm: i32,
+    /// Clips pushed on the device, counting those of enclosing states
+    pub clips: usize,
 }
 
 impl PdfGstate {
@@ -151,6 +179,7 @@ impl PdfGstate {
             op_stroke: false,
             op_fill: false,
             opm: 0,
+            clips: 0,
         }
     }
 }
@@ -305,6 +334,8 @@ pub struct PdfProcessor {
     pub rstack: ResourceStack,
     /// Chained processor
     pub chain: Option<Handle>,
+    /// Processors fed by a tee processor
+    pub branches: Vec<Handle>,
     /// Graphics state stack
     pub gstate_stack: Vec<PdfGstate>,
     /// Current graphics state
@@ -329,12 +360,47 @@ pub struct PdfProcessor {
     pub ahx_encode: bool,
     /// Add newlines after operators
     pub newlines: bool,
+    /// Operators serialized but not yet handed to the output buffer or
+    /// stream (buffer and output processors)
+    pub content: Vec<u8>,
     /// Collected operators (for debugging/inspection)
     pub operators: Vec<ProcessedOperator>,
+    /// Number of operators recorded, logged or not
+    pub op_count: usize,
+    /// Device and scratch for painting into `device`
+    pub run: RunState,
     /// Struct parent
     pub struct_parent: i32,
     /// Transform
     pub transform: Matrix,
+    /// Track only text state and the CTM, skipping everything that only
+    /// matters for rasterization
+    pub text_only: bool,
+}
+
+/// A device painted into by a run processor
+type RunDevice = Arc<Mutex<Box<dyn Device + Send + Sync>>>;
+
+/// What a processor with a device keeps between operators, so painting
+/// reuses one path, stroke state and text instead of allocating per
+/// operator
+#[derive(Default)]
+pub struct RunState {
+    /// Whether `device` has been looked up
+    looked_up: bool,
+    /// The processor's device, if its handle is valid
+    device: Option<RunDevice>,
+    /// The current path, rebuilt in place for each painting operator
+    path: Path,
+    /// The stroke state, refreshed from the graphics state for each stroke
+    stroke: StrokeState,
+    /// The text of the current show operator
+    text: Text,
+    /// Fonts by resource name
+    fonts: HashMap<String, Arc<Font>>,
+    /// Clip set by W or W* (whether even-odd), applied by the next painting
+    /// operator
+    pending_clip: Option<bool>,
 }
 
 /// A processed operator with its arguments
@@ -375,6 +441,7 @@ impl PdfProcessor {
             gstate: PdfGstate::new(),
             gstate_stack: Vec::new(),
             text_state: PdfTextState::new(),
+            text_only: proc_type == ProcessorType::Text,
             ..Default::default()
         }
     }
@@ -384,30 +451,1215 @@ impl PdfProcessor {
         self.gstate_stack.push(self.gstate.clone());
     }
 
-    /// Pop graphics state
+    /// Pop graphics state, popping the device clips set since it was
+    /// pushed
     pub fn pop_gstate(&mut self) -> bool {
         if let Some(gstate) = self.gstate_stack.pop() {
+            let clips = self.gstate.clips.saturating_sub(gstate.clips);
             self.gstate = gstate;
+            self.pop_clips(clips);
             true
         } else {
             false
         }
     }
 
+    /// The processors this one passes resources, closing and dropping on
+    /// to: its chain and, for a tee, its branches
+    fn downstream(&self) -> Vec<Handle> {
+        self.chain.iter().chain(&self.branches).copied().collect()
+    }
+
     /// Record an operator
-    pub fn record_op(&mut self, name: &str, args: Vec<OperatorArg>) {
+    ///
+    /// Buffer and output processors serialize it; processors without a
+    /// device log it in `operators`. `args` is only built for those, so a
+    /// run processor painting into a device records nothing but the count.
+    pub fn record_op(&mut self, name: &str, args: impl FnOnce() -> Vec<OperatorArg>) {
+        self.op_count += 1;
+        let serializes = matches!(
+            self.proc_type,
+            ProcessorType::Buffer | ProcessorType::Output
+        );
+        if !serializes && self.device().is_some() {
+            return;
+        }
+        let args = args();
+        if serializes {
+            self.write_op(name, &args);
+        }
         self.operators.push(ProcessedOperator {
             name: name.to_string(),
             args,
         });
     }
 
-    /// Write operator to output
-    pub fn write_op(&self, _name: &str, _args: &[OperatorArg]) {
-        // Would write to output_buffer or output_stream
+    /// The device this processor runs into, looked up once
+    fn device(&mut self) -> Option<RunDevice> {
+        if !self.run.looked_up {
+            self.run.looked_up = true;
+            self.run.device = self.device.and_then(|h| DEVICES.get(h));
+        }
+        self.run.device.clone()
+    }
+
+    /// Whether operators that only affect rendering are skipped
+    pub fn skips_graphics(&self) -> bool {
+        self.text_only
+    }
+
+    /// Serialize an operator into the pending content, handing it to the
+    /// output buffer or stream once a window's worth has built up
+    pub fn write_op(&mut self, name: &str, args: &[OperatorArg]) {
+        // Inline image data isn't kept, so it can't be written back
+        if name == "BI" {
+            return;
+        }
+        for arg in args {
+            write_arg(arg, &mut self.content);
+            self.content.push(b' ');
+        }
+        self.content.extend_from_slice(name.as_bytes());
+        self.content.push(if self.newlines { b'\n' } else { b' ' });
+        if self.content.len() >= OUTPUT_BUFFER_SIZE {
+            self.flush_content();
+        }
+    }
+
+    /// Hand the pending content to the output buffer or stream
+    fn flush_content(&mut self) {
+        if self.content.is_empty() {
+            return;
+        }
+        if let Some(arc) = self.output_buffer.and_then(|h| BUFFERS.get(h)) {
+            if let Ok(mut buffer) = arc.lock() {
+                buffer.append(&self.content);
+            }
+        }
+        if let Some(arc) = self.output_stream.and_then(|h| OUTPUTS.get(h)) {
+            if let Ok(mut output) = arc.lock() {
+                let _ = output.write_data(&self.content);
+            }
+        }
+        self.content.clear();
+    }
+}
+
+/// Append an operand in content stream syntax; numbers are written as the
+/// shortest text that reads back the same, so rewriting is lossless
+fn write_arg(arg: &OperatorArg, out: &mut Vec<u8>) {
+    match arg {
+        OperatorArg::Number(v) => push_real(out, *v),
+        OperatorArg::Integer(i) => push_int(out, (*i).into()),
+        OperatorArg::String(text) => write_string(text.as_bytes(), out),
+        OperatorArg::Name(name) => write_name(name, out),
+        OperatorArg::Boolean(b) => out.extend_from_slice(if *b { b"true" } else { b"false" }),
+        OperatorArg::Array(items) => {
+            out.push(b'[');
+            for (i, item) in items.iter().enumerate() {
+                if i > 0 {
+                    out.push(b' ');
+                }
+                write_arg(item, out);
+            }
+            out.push(b']');
+        }
     }
 }
 
+// ============================================================================
+// Operators
+// ============================================================================
+
+/// A translation by (tx, ty)
+fn translation(tx: f32, ty: f32) -> Matrix {
+    Matrix {
+        a: 1.0,
+        b: 0.0,
+        c: 0.0,
+        d: 1.0,
+        e: tx,
+        f: ty,
+    }
+}
+
+fn numbers(values: &[f32]) -> Vec<OperatorArg> {
+    values.iter().map(|&v| OperatorArg::Number(v)).collect()
+}
+
+/// Rebuild `path` from the content stream path `elements`
+fn build_path(elements: &[PathElement], path: &mut Path) {
+    path.clear();
+    let mut start = Point::ORIGIN;
+    let mut current = Point::ORIGIN;
+    for element in elements {
+        match *element {
+            PathElement::MoveTo { x, y } => {
+                start = Point::new(x, y);
+                current = start;
+                path.move_to(current);
+            }
+            PathElement::LineTo { x, y } => {
+                current = Point::new(x, y);
+                path.line_to(current);
+            }
+            PathElement::CurveTo {
+                x1,
+                y1,
+                x2,
+                y2,
+                x3,
+                y3,
+            } => {
+                let end = Point::new(x3, y3);
+                path.curve_to(Point::new(x1, y1), Point::new(x2, y2), end);
+                current = end;
+            }
+            PathElement::CurveV { x2, y2, x3, y3 } => {
+                let end = Point::new(x3, y3);
+                path.curve_to(current, Point::new(x2, y2), end);
+                current = end;
+            }
+            PathElement::CurveY { x1, y1, x3, y3 } => {
+                let end = Point::new(x3, y3);
+                path.curve_to(Point::new(x1, y1), end, end);
+                current = end;
+            }
+            PathElement::ClosePath => {
+                path.close();
+                current = start;
+            }
+            PathElement::Rect { x, y, w, h } => {
+                path.rect(Rect::new(x, y, x + w, y + h));
+                start = Point::new(x, y);
+                current = start;
+            }
+        }
+    }
+}
+
+/// The device colourspace named `name`, or for a colour of `n` components
+/// when `name` is a resource
+fn device_colorspace(name: &str, n: usize) -> &'static Colorspace {
+    static SPACES: LazyLock<[Colorspace; 3]> = LazyLock::new(|| {
+        [
+            Colorspace::device_gray(),
+            Colorspace::device_rgb(),
+            Colorspace::device_cmyk(),
+        ]
+    });
+    let index = match name {
+        "DeviceGray" | "CalGray" | "G" => 0,
+        "DeviceRGB" | "CalRGB" | "RGB" => 1,
+        "DeviceCMYK" | "CMYK" => 2,
+        _ => match n {
+            3 => 1,
+            4 => 2,
+            _ => 0,
+        },
+    };
+    &SPACES[index]
+}
+
+/// Copy the stroke parameters of `gs` into `state`, reusing its dash
+/// storage
+fn refresh_stroke(state: &mut StrokeState, gs: &PdfGstate) {
+    state.linewidth = gs.line_width;
+    state.miterlimit = gs.miter_limit;
+    state.start_cap = line_cap(gs.line_cap);
+    state.dash_cap = state.start_cap;
+    state.end_cap = state.start_cap;
+    state.linejoin = line_join(gs.line_join);
+    state.dash_phase = gs.dash_phase;
+    state.dash_pattern.clear();
+    state.dash_pattern.extend_from_slice(&gs.dash_array);
+}
+
+fn line_cap(cap: i32) -> LineCap {
+    match cap {
+        1 => LineCap::Round,
+        2 => LineCap::Square,
+        _ => LineCap::Butt,
+    }
+}
+
+fn line_join(join: i32) -> LineJoin {
+    match join {
+        1 => LineJoin::Round,
+        2 => LineJoin::Bevel,
+        _ => LineJoin::Miter,
+    }
+}
+
+/// Operator implementations, shared by the `pdf_op_*` callbacks and the
+/// content stream interpreter. Operators that only affect rendering are
+/// no-ops on text processors.
+impl PdfProcessor {
+    pub fn set_line_width(&mut self, width: f32) {
+        if self.skips_graphics() {
+            return;
+        }
+        self.gstate.line_width = width;
+        self.record_op("w", || vec![OperatorArg::Number(width)]);
+    }
+
+    pub fn set_line_join(&mut self, join: i32) {
+        if self.skips_graphics() {
+            return;
+        }
+        self.gstate.line_join = join;
+        self.record_op("j", || vec![OperatorArg::Integer(join)]);
+    }
+
+    pub fn set_line_cap(&mut self, cap: i32) {
+        if self.skips_graphics() {
+            return;
+        }
+        self.gstate.line_cap = cap;
+        self.record_op("J", || vec![OperatorArg::Integer(cap)]);
+    }
+
+    pub fn set_miter_limit(&mut self, limit: f32) {
+        if self.skips_graphics() {
+            return;
+        }
+        self.gstate.miter_limit = limit;
+        self.record_op("M", || vec![OperatorArg::Number(limit)]);
+    }
+
+    pub fn set_dash(&mut self, array: &[f32], phase: f32) {
+        if self.skips_graphics() {
+            return;
+        }
+        self.gstate.dash_array.clear();
+        self.gstate.dash_array.extend_from_slice(array);
+        self.gstate.dash_phase = phase;
+        self.record_op("d", || {
+            vec![
+                OperatorArg::Array(numbers(array)),
+                OperatorArg::Number(phase),
+            ]
+        });
+    }
+
+    pub fn set_rendering_intent(&mut self, intent: &str) {
+        if self.skips_graphics() {
+            return;
+        }
+        self.gstate.rendering_intent.clear();
+        self.gstate.rendering_intent.push_str(intent);
+        self.record_op("ri", || vec![OperatorArg::Name(intent.to_string())]);
+    }
+
+    pub fn set_flatness(&mut self, flatness: f32) {
+        if self.skips_graphics() {
+            return;
+        }
+        self.gstate.flatness = flatness;
+        self.record_op("i", || vec![OperatorArg::Number(flatness)]);
+    }
+
+    pub fn save(&mut self) {
+        self.push_gstate();
+        self.record_op("q", Vec::new);
+    }
+
+    pub fn restore(&mut self) {
+        self.pop_gstate();
+        self.record_op("Q", Vec::new);
+    }
+
+    pub fn concat_ctm(&mut self, m: Matrix) {
+        self.gstate.ctm = self.gstate.ctm.concat(&m);
+        self.record_op("cm", || numbers(&[m.a, m.b, m.c, m.d, m.e, m.f]));
+    }
+
+    pub fn set_extgstate(&mut self, name: &str) {
+        self.record_op("gs", || vec![OperatorArg::Name(name.to_string())]);
+    }
+
+    fn push_path(&mut self, element: PathElement, name: &str, args: &[f32]) {
+        if self.skips_graphics() {
+            return;
+        }
+        self.path.elements.push(element);
+        self.record_op(name, || numbers(args));
+    }
+
+    pub fn move_to(&mut self, x: f32, y: f32) {
+        self.push_path(PathElement::MoveTo { x, y }, "m", &[x, y]);
+    }
+
+    pub fn line_to(&mut self, x: f32, y: f32) {
+        self.push_path(PathElement::LineTo { x, y }, "l", &[x, y]);
+    }
+
+    pub fn curve_to(&mut self, x1: f32, y1: f32, x2: f32, y2: f32, x3: f32, y3: f32) {
+        let element = PathElement::CurveTo {
+            x1,
+            y1,
+            x2,
+            y2,
+            x3,
+            y3,
+        };
+        self.push_path(element, "c", &[x1, y1, x2, y2, x3, y3]);
+    }
+
+    pub fn curve_v(&mut self, x2: f32, y2: f32, x3: f32, y3: f32) {
+        let element = PathElement::CurveV { x2, y2, x3, y3 };
+        self.push_path(element, "v", &[x2, y2, x3, y3]);
+    }
+
+    pub fn curve_y(&mut self, x1: f32, y1: f32, x3: f32, y3: f32) {
+        let element = PathElement::CurveY { x1, y1, x3, y3 };
+        self.push_path(element, "y", &[x1, y1, x3, y3]);
+    }
+
+    pub fn close_path(&mut self) {
+        self.push_path(PathElement::ClosePath, "h", &[]);
+    }
+
+    pub fn rect(&mut self, x: f32, y: f32, w: f32, h: f32) {
+        self.push_path(PathElement::Rect { x, y, w, h }, "re", &[x, y, w, h]);
+    }
+
+    /// Paint (or with `n`, discard) the current path, closing it first
+    /// for the closing operators
+    pub fn paint_path(&mut self, op: &str, close: bool) {
+        if self.skips_graphics() {
+            return;
+        }
+        if close {
+            self.path.elements.push(PathElement::ClosePath);
+        }
+        self.record_op(op, Vec::new);
+        if let Some(device) = self.device() {
+            self.paint_on(&device, op);
+        }
+        self.path.elements.clear();
+    }
+
+    /// Hand the current path to `device` as painted by `op`, then clip to
+    /// it if W or W* came before
+    fn paint_on(&mut self, device: &RunDevice, op: &str) {
+        let (fill, stroke, even_odd) = match op {
+            "f" => (true, false, false),
+            "f*" => (true, false, true),
+            "S" | "s" => (false, true, false),
+            "B" | "b" => (true, true, false),
+            "B*" | "b*" => (true, true, true),
+            _ => (false, false, false),
+        };
+        let clip = self.run.pending_clip.take();
+        if !fill && !stroke && clip.is_none() {
+            return;
+        }
+        build_path(&self.path.elements, &mut self.run.path);
+        let ctm = self.gstate.ctm.concat(&self.transform);
+        let Ok(mut dev) = device.lock() else {
+            return;
+        };
+        let gs = &self.gstate;
+        if fill {
+            let cs = device_colorspace(&gs.fill_cs, gs.fill_color.len());
+            dev.fill_path(
+                &self.run.path,
+                even_odd,
+                &ctm,
+                cs,
+                &gs.fill_color,
+                gs.fill_alpha,
+            );
+        }
+        if stroke {
+            refresh_stroke(&mut self.run.stroke, gs);
+            let cs = device_colorspace(&gs.stroke_cs, gs.stroke_color.len());
+            dev.stroke_path(
+                &self.run.path,
+                &self.run.stroke,
+                &ctm,
+                cs,
+                &gs.stroke_color,
+                gs.stroke_alpha,
+            );
+        }
+        if let Some(even_odd) = clip {
+            dev.clip_path(&self.run.path, even_odd, &ctm, Rect::INFINITE);
+            self.gstate.clips += 1;
+        }
+    }
+
+    /// Pop `count` clips off the device
+    fn pop_clips(&mut self, count: usize) {
+        if count == 0 {
+            return;
+        }
+        if let Some(device) = self.device() {
+            if let Ok(mut dev) = device.lock() {
+                for _ in 0..count {
+                    dev.pop_clip();
+                }
+            }
+        }
+    }
+
+    pub fn clip(&mut self, even_odd: bool) {
+        if self.skips_graphics() {
+            return;
+        }
+        self.run.pending_clip = Some(even_odd);
+        self.record_op(if even_odd { "W*" } else { "W" }, Vec::new);
+    }
+
+    pub fn begin_text(&mut self) {
+        self.in_text = true;
+        self.text_object = Some(PdfTextObjectState {
+            tlm: Matrix::IDENTITY,
+            tm: Matrix::IDENTITY,
+            text_mode: 0,
+            text_content: Vec::new(),
+            text_bbox: Rect::default(),
+        });
+        self.record_op("BT", Vec::new);
+    }
+
+    pub fn end_text(&mut self) {
+        self.in_text = false;
+        self.text_object = None;
+        self.record_op("ET", Vec::new);
+    }
+
+    pub fn set_char_space(&mut self, charspace: f32) {
+        self.text_state.char_space = charspace;
+        self.record_op("Tc", || vec![OperatorArg::Number(charspace)]);
+    }
+
+    pub fn set_word_space(&mut self, wordspace: f32) {
+        self.text_state.word_space = wordspace;
+        self.record_op("Tw", || vec![OperatorArg::Number(wordspace)]);
+    }
+
+    pub fn set_text_scale(&mut self, scale: f32) {
+        self.text_state.scale = scale;
+        self.record_op("Tz", || vec![OperatorArg::Number(scale)]);
+    }
+
+    pub fn set_leading(&mut self, leading: f32) {
+        self.text_state.leading = leading;
+        self.record_op("TL", || vec![OperatorArg::Number(leading)]);
+    }
+
+    pub fn set_font(&mut self, name: &str, size: f32) {
+        self.text_state.font_name.clear();
+        self.text_state.font_name.push_str(name);
+        self.text_state.size = size;
+        self.record_op("Tf", || {
+            vec![
+                OperatorArg::Name(name.to_string()),
+                OperatorArg::Number(size),
+            ]
+        });
+    }
+
+    pub fn set_text_render(&mut self, render: i32) {
+        self.text_state.render = render;
+        self.record_op("Tr", || vec![OperatorArg::Integer(render)]);
+    }
+
+    pub fn set_text_rise(&mut self, rise: f32) {
+        self.text_state.rise = rise;
+        self.record_op("Ts", || vec![OperatorArg::Number(rise)]);
+    }
+
+    fn translate_line(&mut self, tx: f32, ty: f32) {
+        if let Some(ref mut tos) = self.text_object {
+            tos.tlm = tos.tlm.concat(&translation(tx, ty));
+            tos.tm = tos.tlm;
+        }
+    }
+
+    pub fn move_text(&mut self, tx: f32, ty: f32) {
+        self.translate_line(tx, ty);
+        self.record_op("Td", || numbers(&[tx, ty]));
+    }
+
+    pub fn move_text_set_leading(&mut self, tx: f32, ty: f32) {
+        self.text_state.leading = -ty;
+        self.translate_line(tx, ty);
+        self.record_op("TD", || numbers(&[tx, ty]));
+    }
+
+    pub fn set_text_matrix(&mut self, m: Matrix) {
+        if let Some(ref mut tos) = self.text_object {
+            tos.tlm = m;
+            tos.tm = m;
+        }
+        self.record_op("Tm", || numbers(&[m.a, m.b, m.c, m.d, m.e, m.f]));
+    }
+
+    pub fn next_line(&mut self) {
+        let leading = self.text_state.leading;
+        self.translate_line(0.0, -leading);
+        self.record_op("T*", Vec::new);
+    }
+
+    /// Add a span of text at the text matrix, without recording an operator
+    fn push_text_span(&mut self, text: &str) {
+        let font_name = self.text_state.font_name.clone();
+        let font_size = self.text_state.size;
+        if let Some(ref mut tos) = self.text_object {
+            tos.text_content.push(TextSpan {
+                text: text.to_string(),
+                matrix: tos.tm,
+                font_name,
+                font_size,
+            });
+        }
+    }
+
+    pub fn show_text(&mut self, bytes: &[u8]) {
+        self.record_op("Tj", || {
+            vec![OperatorArg::String(
+                String::from_utf8_lossy(bytes).into_owned(),
+            )]
+        });
+        match self.device() {
+            Some(device) => self.show_on(&device, bytes),
+            None => self.push_text_span(&String::from_utf8_lossy(bytes)),
+        }
+    }
+
+    /// Show `bytes` on `device`, one glyph per byte, in the text rendering
+    /// mode, advancing the text matrix by the font's widths
+    fn show_on(&mut self, device: &RunDevice, bytes: &[u8]) {
+        let Some(tos) = self.text_object.as_mut() else {
+            return;
+        };
+        let ts = &self.text_state;
+        let font = match self.run.fonts.get(ts.font_name.as_str()) {
+            Some(font) => Arc::clone(font),
+            None => {
+                let font = Arc::new(Font::new(&ts.font_name));
+                self.run
+                    .fonts
+                    .insert(ts.font_name.clone(), Arc::clone(&font));
+                font
+            }
+        };
+        let scale = ts.scale / 100.0;
+        let size = Matrix {
+            a: ts.size * scale,
+            b: 0.0,
+            c: 0.0,
+            d: ts.size,
+            e: 0.0,
+            f: ts.rise,
+        };
+
+        // One span, reused with its glyph storage from the last show
+        let text = &mut self.run.text;
+        text.spans_mut().truncate(1);
+        let trm = Matrix {
+            e: 0.0,
+            f: 0.0,
+            ..size.concat(&tos.tm)
+        };
+        match text.spans_mut().first_mut() {
+            Some(span) => {
+                span.font = Arc::clone(&font);
+                span.trm = trm;
+                span.items_mut().clear();
+            }
+            None => text.add_span(fitz_text::TextSpan::new(Arc::clone(&font), trm)),
+        }
+        let span = &mut text.spans_mut()[0];
+        for &code in bytes {
+            let gid = font.glyph_id(u32::from(code)).unwrap_or(u16::from(code));
+            let width = font.glyph_advance(gid);
+            let origin = size.concat(&tos.tm);
+            span.add_glyph(TextItem::with_advance(
+                origin.e,
+                origin.f,
+                width,
+                i32::from(gid),
+                i32::from(code),
+                i32::from(code),
+            ));
+            let mut tx = width * ts.size + ts.char_space;
+            if code == b' ' {
+                tx += ts.word_space;
+            }
+            tos.tm = translation(tx * scale, 0.0).concat(&tos.tm);
+        }
+
+        let ctm = self.gstate.ctm.concat(&self.transform);
+        let Ok(mut dev) = device.lock() else {
+            return;
+        };
+        let gs = &self.gstate;
+        let mode = ts.render;
+        if mode == 3 {
+            dev.ignore_text(text, &ctm);
+        }
+        if matches!(mode, 0 | 2 | 4 | 6) {
+            let cs = device_colorspace(&gs.fill_cs, gs.fill_color.len());
+            dev.fill_text(text, &ctm, cs, &gs.fill_color, gs.fill_alpha);
+        }
+        if matches!(mode, 1 | 2 | 5 | 6) {
+            refresh_stroke(&mut self.run.stroke, gs);
+            let cs = device_colorspace(&gs.stroke_cs, gs.stroke_color.len());
+            dev.stroke_text(
+                text,
+                &self.run.stroke,
+                &ctm,
+                cs,
+                &gs.stroke_color,
+                gs.stroke_alpha,
+            );
+        }
+    }
+
+    pub fn glyph_width(&mut self, wx: f32, wy: f32) {
+        self.record_op("d0", || numbers(&[wx, wy]));
+    }
+
+    pub fn glyph_width_bbox(&mut self, values: [f32; 6]) {
+        self.record_op("d1", || numbers(&values));
+    }
+
+    pub fn set_stroke_colorspace(&mut self, name: &str) {
+        if self.skips_graphics() {
+            return;
+        }
+        self.gstate.stroke_cs.clear();
+        self.gstate.stroke_cs.push_str(name);
+        self.record_op("CS", || vec![OperatorArg::Name(name.to_string())]);
+    }
+
+    pub fn set_fill_colorspace(&mut self, name: &str) {
+        if self.skips_graphics() {
+            return;
+        }
+        self.gstate.fill_cs.clear();
+        self.gstate.fill_cs.push_str(name);
+        self.record_op("cs", || vec![OperatorArg::Name(name.to_string())]);
+    }
+
+    /// Set the stroke colour in the current colourspace; no components
+    /// reads as a single 0
+    pub fn set_stroke_color(&mut self, color: &[f32]) {
+        if self.skips_graphics() {
+            return;
+        }
+        let color = if color.is_empty() { &[0.0][..] } else { color };
+        self.gstate.stroke_color.clear();
+        self.gstate.stroke_color.extend_from_slice(color);
+        self.record_op("SC", || numbers(color));
+    }
+
+    /// Set the fill colour in the current colourspace; no components
+    /// reads as a single 0
+    pub fn set_fill_color(&mut self, color: &[f32]) {
+        if self.skips_graphics() {
+            return;
+        }
+        let color = if color.is_empty() { &[0.0][..] } else { color };
+        self.gstate.fill_color.clear();
+        self.gstate.fill_color.extend_from_slice(color);
+        self.record_op("sc", || numbers(color));
+    }
+
+    /// Set the stroke colourspace and colour together (G, RG, K)
+    pub fn set_stroke_device_color(&mut self, op: &str, cs: &str, color: &[f32]) {
+        if self.skips_graphics() {
+            return;
+        }
+        self.gstate.stroke_cs.clear();
+        self.gstate.stroke_cs.push_str(cs);
+        self.gstate.stroke_color.clear();
+        self.gstate.stroke_color.extend_from_slice(color);
+        self.record_op(op, || numbers(color));
+    }
+
+    /// Set the fill colourspace and colour together (g, rg, k)
+    pub fn set_fill_device_color(&mut self, op: &str, cs: &str, color: &[f32]) {
+        if self.skips_graphics() {
+            return;
+        }
+        self.gstate.fill_cs.clear();
+        self.gstate.fill_cs.push_str(cs);
+        self.gstate.fill_color.clear();
+        self.gstate.fill_color.extend_from_slice(color);
+        self.record_op(op, || numbers(color));
+    }
+
+    pub fn inline_image(&mut self, image: Handle) {
+        if self.skips_graphics() {
+            return;
+        }
+        self.record_op("BI", || vec![OperatorArg::Integer(image as i32)]);
+        self.fill_image(image);
+    }
+
+    pub fn shade(&mut self, name: &str) {
+        if self.skips_graphics() {
+            return;
+        }
+        self.record_op("sh", || vec![OperatorArg::Name(name.to_string())]);
+    }
+
+    pub fn draw_image(&mut self, name: &str, image: Handle) {
+        if self.skips_graphics() {
+            return;
+        }
+        self.draw_form(name, image);
+        self.fill_image(image);
+    }
+
+    /// Paint `image`, if it is a loaded image, over the unit square of the
+    /// CTM
+    fn fill_image(&mut self, image: Handle) {
+        let Some(device) = self.device() else {
+            return;
+        };
+        let Some(image) = IMAGES.get(image) else {
+            return;
+        };
+        let ctm = self.gstate.ctm.concat(&self.transform);
+        if let (Ok(image), Ok(mut dev)) = (image.lock(), device.lock()) {
+            dev.fill_image(&image, &ctm, self.gstate.fill_alpha);
+        }
+    }
+
+    pub fn draw_form(&mut self, name: &str, form: Handle) {
+        let _span = super::trace::span_arg(c"xobject", form as i64);
+        self.record_op("Do", || {
+            vec![
+                OperatorArg::Name(name.to_string()),
+                OperatorArg::Integer(form as i32),
+            ]
+        });
+    }
+
+    /// Paint the appearance of `annot` from its rectangle, colours, border
+    /// and opacity
+    ///
+    /// Annotations don't keep appearance streams, so only the kinds whose
+    /// appearance follows from those are drawn: squares, circles, lines
+    /// and text markup. Hidden annotations are skipped.
+    pub fn draw_annot(&mut self, annot: &Annotation) {
+        if annot.is_hidden() {
+            return;
+        }
+        let r = annot.rect();
+        let (w, h) = (r.x1 - r.x0, r.y1 - r.y0);
+        let color = annot.color();
+        let border = annot.border().width;
+        self.save();
+        self.gstate.fill_alpha = annot.opacity();
+        self.gstate.stroke_alpha = annot.opacity();
+        let op = match annot.annot_type() {
+            AnnotType::Highlight => color.map(|c| {
+                self.set_fill_device_color("rg", "DeviceRGB", &c);
+                self.rect(r.x0, r.y0, w, h);
+                "f"
+            }),
+            AnnotType::Underline | AnnotType::Squiggly | AnnotType::StrikeOut => color.map(|c| {
+                let y = match annot.annot_type() {
+                    AnnotType::StrikeOut => r.y0 + h / 2.0,
+                    _ => r.y0 + h / 14.0,
+                };
+                self.set_stroke_device_color("RG", "DeviceRGB", &c);
+                self.set_line_width((h / 14.0).max(1.0));
+                self.move_to(r.x0, y);
+                self.line_to(r.x1, y);
+                "S"
+            }),
+            AnnotType::Line => match (color, annot.line_start(), annot.line_end()) {
+                (Some(c), Some((x0, y0)), Some((x1, y1))) if border > 0.0 => {
+                    self.set_stroke_device_color("RG", "DeviceRGB", &c);
+                    self.set_line_width(border);
+                    self.move_to(x0, y0);
+                    self.line_to(x1, y1);
+                    Some("S")
+                }
+                _ => None,
+            },
+            AnnotType::Square | AnnotType::Circle => {
+                let interior = annot.interior_color();
+                let fill = match interior.len() {
+                    1 => Some(("g", "DeviceGray")),
+                    3 => Some(("rg", "DeviceRGB")),
+                    4 => Some(("k", "DeviceCMYK")),
+                    _ => None,
+                };
+                if let Some((op, cs)) = fill {
+                    self.set_fill_device_color(op, cs, interior);
+                }
+                let stroke = color.filter(|_| border > 0.0);
+                if let Some(c) = stroke {
+                    self.set_stroke_device_color("RG", "DeviceRGB", &c);
+                    self.set_line_width(border);
+                }
+                // Inset by half the border so the stroke stays inside
+                let inset = if stroke.is_some() { border / 2.0 } else { 0.0 };
+                let (x0, y0) = (r.x0 + inset, r.y0 + inset);
+                let (w, h) = ((w - border).max(0.0), (h - border).max(0.0));
+                if annot.annot_type() == AnnotType::Square {
+                    self.rect(x0, y0, w, h);
+                } else {
+                    self.ellipse(x0, y0, w, h);
+                }
+                match (fill.is_some(), stroke.is_some()) {
+                    (true, true) => Some("B"),
+                    (true, false) => Some("f"),
+                    (false, true) => Some("S"),
+                    (false, false) => None,
+                }
+            }
+            _ => None,
+        };
+        self.paint_path(op.unwrap_or("n"), false);
+        self.restore();
+    }
+
+    /// Add the ellipse inscribed in the rectangle at (x, y) of size w by h
+    /// as four Béziers
+    fn ellipse(&mut self, x: f32, y: f32, w: f32, h: f32) {
+        const KAPPA: f32 = 0.552_284_8;
+        let (rx, ry) = (w / 2.0, h / 2.0);
+        let (cx, cy) = (x + rx, y + ry);
+        let (kx, ky) = (rx * KAPPA, ry * KAPPA);
+        self.move_to(cx + rx, cy);
+        self.curve_to(cx + rx, cy + ky, cx + kx, cy + ry, cx, cy + ry);
+        self.curve_to(cx - kx, cy + ry, cx - rx, cy + ky, cx - rx, cy);
+        self.curve_to(cx - rx, cy - ky, cx - kx, cy - ry, cx, cy - ry);
+        self.curve_to(cx + kx, cy - ry, cx + rx, cy - ky, cx + rx, cy);
+        self.close_path();
+    }
+
+    /// A marked content operator tagged `tag` (MP, DP, BMC, BDC)
+    pub fn mark(&mut self, op: &str, tag: &str) {
+        self.record_op(op, || vec![OperatorArg::Name(tag.to_string())]);
+    }
+
+    // ------------------------------------------------------------------------
+    // Content stream interpretation
+    // ------------------------------------------------------------------------
+
+    /// Interpret a content stream, calling this processor's operators
+    /// directly
+    ///
+    /// The whole stream runs under the caller's single borrow of the
+    /// processor: operators are matched by `Opcode` and their operands
+    /// read from a fixed-size stack, with no handle lookup, lock or
+    /// allocation per operator beyond what the operator itself records.
+    /// Operators with missing or mistyped operands, and unknown
+    /// operators, are skipped. Returns the number of operators run.
+    pub fn run_contents(&mut self, data: &[u8]) -> usize {
+        let mut lexer = ContentLexer::new(data);
+        let mut stack = OperandStack::new();
+        let mut scratch = Vec::new();
+        let mut ran = 0;
+        while let Some(token) = lexer.next() {
+            let op = match token {
+                Token::Operand(operand) => {
+                    stack.push(operand);
+                    continue;
+                }
+                Token::Operator(op, _) => op,
+            };
+            if let Some(op) = op.filter(|_| !stack.overflowed()) {
+                if op == Opcode::BI {
+                    lexer.skip_inline_image();
+                }
+                if self.dispatch(op, &stack, &mut scratch).is_some() {
+                    ran += 1;
+                }
+            }
+            stack.clear();
+        }
+        counters::add(Counter::OperatorsInterpreted, ran as u64);
+        ran
+    }
+
+    /// Replay a compiled content stream, as `run_contents` would run the
+    /// stream it was compiled from
+    pub fn run_program(&mut self, program: &ContentProgram) -> usize {
+        let mut scratch = Vec::new();
+        let mut ran = 0;
+        program.replay(|op, stack| {
+            if self.dispatch(op, stack, &mut scratch).is_some() {
+                ran += 1;
+            }
+        });
+        counters::add(Counter::OperatorsInterpreted, ran as u64);
+        ran
+    }
+
+    /// Run one operator; None if its operands don't fit
+    #[inline]
+    fn dispatch(&mut self, op: Opcode, stack: &OperandStack, scratch: &mut Vec<u8>) -> Option<()> {
+        let name = |depth| stack.top(depth).and_then(Operand::as_name);
+        let int = |depth| {
+            stack
+                .top(depth)
+                .and_then(Operand::as_number)
+                .map(|n| n as i32)
+        };
+        let number = |depth| stack.top(depth).and_then(Operand::as_number);
+        let matrix = || {
+            stack
+                .numbers::<6>()
+                .map(|[a, b, c, d, e, f]| Matrix { a, b, c, d, e, f })
+        };
+        // Colour components: the numbers on top of the stack, under which
+        // SCN and scn may have a pattern name
+        let components = || {
+            let ops = match stack.as_slice() {
+                [rest @ .., Operand::Name(_)] => rest,
+                ops => ops,
+            };
+            let n = ops
+                .iter()
+                .rev()
+                .take_while(|o| o.as_number().is_some())
+                .count();
+            let mut color = [0.0; 32];
+            let n = n.min(color.len());
+            for (c, o) in color.iter_mut().zip(&ops[ops.len() - n..]) {
+                *c = o.as_number().unwrap_or(0.0);
+            }
+            (color, n)
+        };
+
+        match op {
+            Opcode::W => self.set_line_width(number(0)?),
+            Opcode::UpperJ => self.set_line_cap(int(0)?),
+            Opcode::J => self.set_line_join(int(0)?),
+            Opcode::UpperM => self.set_miter_limit(number(0)?),
+            Opcode::D => {
+                let Some(&Operand::Array(array)) = stack.top(1) else {
+                    return None;
+                };
+                let mut dashes = [0.0; 32];
+                let mut n = 0;
+                for token in ContentLexer::new(&array[1..]) {
+                    if let (Token::Operand(Operand::Number(v)), Some(d)) =
+                        (token, dashes.get_mut(n))
+                    {
+                        *d = v;
+                        n += 1;
+                    }
+                }
+                self.set_dash(&dashes[..n], number(0)?);
+            }
+            Opcode::Ri => self.set_rendering_intent(name(0)?),
+            Opcode::I => self.set_flatness(number(0)?),
+            Opcode::Gs => self.set_extgstate(name(0)?),
+            Opcode::Q => self.save(),
+            Opcode::UpperQ => self.restore(),
+            Opcode::Cm => self.concat_ctm(matrix()?),
+            Opcode::M => {
+                let [x, y] = stack.numbers()?;
+                self.move_to(x, y);
+            }
+            Opcode::L => {
+                let [x, y] = stack.numbers()?;
+                self.line_to(x, y);
+            }
+            Opcode::C => {
+                let [x1, y1, x2, y2, x3, y3] = stack.numbers()?;
+                self.curve_to(x1, y1, x2, y2, x3, y3);
+            }
+            Opcode::V => {
+                let [x2, y2, x3, y3] = stack.numbers()?;
+                self.curve_v(x2, y2, x3, y3);
+            }
+            Opcode::Y => {
+                let [x1, y1, x3, y3] = stack.numbers()?;
+                self.curve_y(x1, y1, x3, y3);
+            }
+            Opcode::H => self.close_path(),
+            Opcode::Re => {
+                let [x, y, w, h] = stack.numbers()?;
+                self.rect(x, y, w, h);
+            }
+            Opcode::UpperS => self.paint_path("S", false),
+            Opcode::S => self.paint_path("s", true),
+            Opcode::F | Opcode::UpperF => self.paint_path("f", false),
+            Opcode::FStar => self.paint_path("f*", false),
+            Opcode::UpperB => self.paint_path("B", false),
+            Opcode::UpperBStar => self.paint_path("B*", false),
+            Opcode::B => self.paint_path("b", true),
+            Opcode::BStar => self.paint_path("b*", true),
+            Opcode::N => self.paint_path("n", false),
+            Opcode::UpperW => self.clip(false),
+            Opcode::UpperWStar => self.clip(true),
+            Opcode::BT => self.begin_text(),
+            Opcode::ET => self.end_text(),
+            Opcode::Tc => self.set_char_space(number(0)?),
+            Opcode::Tw => self.set_word_space(number(0)?),
+            Opcode::Tz => self.set_text_scale(number(0)?),
+            Opcode::TL => self.set_leading(number(0)?),
+            Opcode::Tf => self.set_font(name(1)?, number(0)?),
+            Opcode::Tr => self.set_text_render(int(0)?),
+            Opcode::Ts => self.set_text_rise(number(0)?),
+            Opcode::Td => {
+                let [tx, ty] = stack.numbers()?;
+                self.move_text(tx, ty);
+            }
+            Opcode::TD => {
+                let [tx, ty] = stack.numbers()?;
+                self.move_text_set_leading(tx, ty);
+            }
+            Opcode::Tm => self.set_text_matrix(matrix()?),
+            Opcode::TStar => self.next_line(),
+            Opcode::Tj => {
+                if !stack.top(0)?.string_into(scratch) {
+                    return None;
+                }
+                self.show_text(scratch);
+            }
+            Opcode::TJ => {
+                let Some(&Operand::Array(array)) = stack.top(0) else {
+                    return None;
+                };
+                let mut parts = Vec::new();
+                for token in ContentLexer::new(&array[1..]) {
+                    let Token::Operand(part) = token else {
+                        continue;
+                    };
+                    if part.string_into(scratch) {
+                        let text = String::from_utf8_lossy(scratch);
+                        self.push_text_span(&text);
+                        parts.push(OperatorArg::String(text.into_owned()));
+                    } else if let Some(adjust) = part.as_number() {
+                        parts.push(OperatorArg::Number(adjust));
+                    }
+                }
+                self.record_op("TJ", || vec![OperatorArg::Array(parts)]);
+            }
+            Opcode::SQuote => {
+                if !stack.top(0)?.string_into(scratch) {
+                    return None;
+                }
+                self.next_line();
+                self.show_text(scratch);
+            }
+            Opcode::DQuote => {
+                let (aw, ac) = (number(2)?, number(1)?);
+                if !stack.top(0)?.string_into(scratch) {
+                    return None;
+                }
+                self.set_word_space(aw);
+                self.set_char_space(ac);
+                self.next_line();
+                self.show_text(scratch);
+            }
+            Opcode::D0 => {
+                let [wx, wy] = stack.numbers()?;
+                self.glyph_width(wx, wy);
+            }
+            Opcode::D1 => self.glyph_width_bbox(stack.numbers()?),
+            Opcode::CS => self.set_stroke_colorspace(name(0)?),
+            Opcode::Cs => self.set_fill_colorspace(name(0)?),
+            Opcode::SC | Opcode::SCN => {
+                let (color, n) = components();
+                self.set_stroke_color(&color[..n]);
+            }
+            Opcode::Sc | Opcode::Scn => {
+                let (color, n) = components();
+                self.set_fill_color(&color[..n]);
+            }
+            Opcode::UpperG => self.set_stroke_device_color("G", "DeviceGray", &[number(0)?]),
+            Opcode::G => self.set_fill_device_color("g", "DeviceGray", &[number(0)?]),
+            Opcode::RG => {
+                let rgb: [f32; 3] = stack.numbers()?;
+                self.set_stroke_device_color("RG", "DeviceRGB", &rgb);
+            }
+            Opcode::Rg => {
+                let rgb: [f32; 3] = stack.numbers()?;
+                self.set_fill_device_color("rg", "DeviceRGB", &rgb);
+            }
+            Opcode::UpperK => {
+                let cmyk: [f32; 4] = stack.numbers()?;
+                self.set_stroke_device_color("K", "DeviceCMYK", &cmyk);
+            }
+            Opcode::K => {
+                let cmyk: [f32; 4] = stack.numbers()?;
+                self.set_fill_device_color("k", "DeviceCMYK", &cmyk);
+            }
+            // The image data was skipped by the lexer; ID and EI only
+            // appear inside it
+            Opcode::BI => self.inline_image(0),
+            Opcode::ID | Opcode::EI => return None,
+            Opcode::Sh => self.shade(name(0)?),
+            // XObjects aren't resolved against the resources here, so
+            // every Do runs as a form
+            Opcode::Do => self.draw_form(name(0)?, 0),
+            Opcode::MP => self.mark("MP", name(0)?),
+            Opcode::DP => self.mark("DP", name(1)?),
+            Opcode::BMC => self.mark("BMC", name(0)?),
+            Opcode::BDC => self.mark("BDC", name(1)?),
+            Opcode::EMC => self.record_op("EMC", Vec::new),
+            Opcode::BX => self.record_op("BX", Vec::new),
+            Opcode::EX => self.record_op("EX", Vec::new),
+        }
+        Some(())
+    }
+}
+
+/// Run `f` on the processor behind a handle, or on each processor a tee
+/// feeds
+fn with_processor(proc: Handle, f: impl Fn(&mut PdfProcessor)) {
+    let Some(proc_arc) = PDF_PROCESSORS.get(proc) else {
+        return;
+    };
+    let mut proc_guard = proc_arc.lock().unwrap();
+    if proc_guard.branches.is_empty() {
+        f(&mut proc_guard);
+        return;
+    }
+    drop(proc_guard);
+    for target in tee_targets(proc) {
+        if let Some(target_arc) = PDF_PROCESSORS.get(target) {
+            f(&mut target_arc.lock().unwrap());
+        }
+    }
+}
+
+/// The processors a tee feeds, through any nested tees; empty if `proc`
+/// isn't a tee
+fn tee_targets(proc: Handle) -> Vec<Handle> {
+    let branches = PDF_PROCESSORS
+        .get(proc)
+        .map(|p| p.lock().unwrap().branches.clone())
+        .unwrap_or_default();
+    branches
+        .into_iter()
+        .flat_map(|branch| {
+            let nested = tee_targets(branch);
+            if nested.is_empty() {
+                vec![branch]
+            } else {
+                nested
+            }
+        })
+        .collect()
+}
+
+/// A C string argument, or `default` if it is null or not UTF-8
+fn c_str_or(s: *const c_char, default: &str) -> &str {
+    if s.is_null() {
+        return default;
+    }
+    // SAFETY: a non-null argument is a NUL-terminated string that
+    // outlives the call
+    unsafe { CStr::from_ptr(s) }.to_str().unwrap_or(default)
+}
+
 // ============================================================================
 // FFI Functions - Processor Lifecycle
 // ============================================================================
@@ -422,6 +1674,8 @@ pub extern "C" fn pdf_new_processor(_ctx: Handle, size: i32) -> Handle {
         4 => ProcessorType::Sanitize,
         5 => ProcessorType::Color,
         6 => ProcessorType::Vectorize,
+        7 => ProcessorType::Text,
+        8 => ProcessorType::Tee,
         _ => ProcessorType::Base,
     };
     let processor = PdfProcessor::new(proc_type);
@@ -444,11 +1698,13 @@ pub extern "C" fn pdf_close_processor(_ctx: Handle, proc: Handle) {
     if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
         let mut proc_guard = proc_arc.lock().unwrap();
         proc_guard.closed = true;
+        proc_guard.flush_content();
 
-        // Close chained processor if any
-        if let Some(chain) = proc_guard.chain {
-            drop(proc_guard);
-            pdf_close_processor(_ctx, chain);
+        // Close chained processor and tee branches if any
+        let downstream = proc_guard.downstream();
+        drop(proc_guard);
+        for next in downstream {
+            pdf_close_processor(_ctx, next);
         }
     }
 }
@@ -460,12 +1716,12 @@ pub extern "C" fn pdf_drop_processor(_ctx: Handle, proc: Handle) {
         let mut proc_guard = proc_arc.lock().unwrap();
         proc_guard.refs -= 1;
         if proc_guard.refs <= 0 {
-            // Drop chained processor
-            let chain = proc_guard.chain;
+            // Drop chained processor and tee branches
+            let downstream = proc_guard.downstream();
             drop(proc_guard);
 
-            if let Some(chain_handle) = chain {
-                pdf_drop_processor(_ctx, chain_handle);
+            for next in downstream {
+                pdf_drop_processor(_ctx, next);
             }
             PDF_PROCESSORS.remove(proc);
         }
@@ -478,6 +1734,8 @@ pub extern "C" fn pdf_reset_processor(_ctx: Handle, proc: Handle) {
     if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
         let mut proc_guard = proc_arc.lock().unwrap();
         proc_guard.closed = false;
+        let clips = proc_guard.gstate.clips;
+        proc_guard.pop_clips(clips);
         proc_guard.gstate = PdfGstate::new();
         proc_guard.gstate_stack.clear();
         proc_guard.path = PathState::default();
@@ -485,6 +1743,9 @@ pub extern "C" fn pdf_reset_processor(_ctx: Handle, proc: Handle) {
         proc_guard.text_object = None;
         proc_guard.in_text = false;
         proc_guard.operators.clear();
+        proc_guard.op_count = 0;
+        proc_guard.run.pending_clip = None;
+        proc_guard.content.clear();
     }
 }
 
@@ -492,9 +1753,46 @@ pub extern "C" fn pdf_reset_processor(_ctx: Handle, proc: Handle) {
 // FFI Functions - Processor Factories
 // ============================================================================
 
-/// Create a run processor for rendering
+/// Create a run processor for rendering
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_new_run_processor(
+    _ctx: Handle,
+    doc: Handle,
+    dev: Handle,
+    a: f32,
+    b: f32,
+    c: f32,
+    d: f32,
+    e: f32,
+    f: f32,
+    struct_parent: i32,
+    usage: *const c_char,
+) -> Handle {
+    let mut processor = PdfProcessor::new(ProcessorType::Run);
+    processor.document = Some(doc);
+    processor.device = Some(dev);
+    processor.transform = Matrix { a, b, c, d, e, f };
+    processor.struct_parent = struct_parent;
+
+    if !usage.is_null() {
+        if let Ok(s) = unsafe { CStr::from_ptr(usage) }.to_str() {
+            processor.usage = s.to_string();
+        }
+    }
+
+    PDF_PROCESSORS.insert(processor)
+}
+
+/// Create a text-only run processor for text extraction
+///
+/// Runs into `dev` like `pdf_new_run_processor`, but tracks only the text
+/// state and the CTM: images are never loaded or decoded, shadings are
+/// not evaluated, and paths, clips, stroke and colour state are dropped as
+/// they are parsed. Text shown through it lands where the run processor
+/// would put it, so extraction matches a full run of the page.
 #[unsafe(no_mangle)]
-pub extern "C" fn pdf_new_run_processor(
+#[allow(clippy::too_many_arguments)]
+pub extern "C" fn pdf_new_text_processor(
     _ctx: Handle,
     doc: Handle,
     dev: Handle,
@@ -507,19 +1805,14 @@ pub extern "C" fn pdf_new_run_processor(
     struct_parent: i32,
     usage: *const c_char,
 ) -> Handle {
-    let mut processor = PdfProcessor::new(ProcessorType::Run);
-    processor.document = Some(doc);
-    processor.device = Some(dev);
-    processor.transform = Matrix { a, b, c, d, e, f };
-    processor.struct_parent = struct_parent;
-
-    if !usage.is_null() {
-        if let Ok(s) = unsafe { CStr::from_ptr(usage) }.to_str() {
-            processor.usage = s.to_string();
-        }
+    let proc = pdf_new_run_processor(_ctx, doc, dev, a, b, c, d, e, f, struct_parent, usage);
+    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
+        let mut proc_guard = proc_arc.lock().unwrap();
+        proc_guard.proc_type = ProcessorType::Text;
+        proc_guard.requirements = ProcessorRequirements::None;
+        proc_guard.text_only = true;
     }
-
-    PDF_PROCESSORS.insert(processor)
+    proc
 }
 
 /// Create a buffer processor
@@ -576,6 +1869,29 @@ pub extern "C" fn pdf_new_sanitize_filter(
     PDF_PROCESSORS.insert(processor)
 }
 
+/// Create a tee processor, which feeds every operator to each of `procs`
+///
+/// Content run through the tee is lexed once: `pdf_process_contents`
+/// compiles the stream a single time and replays it on each branch, on
+/// its own thread when there are several. Operator callbacks (`pdf_op_*`)
+/// on the tee reach every branch in order. The tee takes ownership of the
+/// branch references, as filters do of their chain.
+///
+/// # Returns
+/// The tee, or 0 if `procs` is null or `count` is not positive
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_new_tee_processor(_ctx: Handle, procs: *const Handle, count: i32) -> Handle {
+    if procs.is_null() || count <= 0 {
+        return 0;
+    }
+    // SAFETY: the caller passes `count` processor handles at `procs`
+    let branches = unsafe { std::slice::from_raw_parts(procs, count as usize) };
+    let mut processor = PdfProcessor::new(ProcessorType::Tee);
+    processor.branches = branches.to_vec();
+
+    PDF_PROCESSORS.insert(processor)
+}
+
 /// Create a color filter processor
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_new_color_filter(
@@ -631,10 +1947,11 @@ pub extern "C" fn pdf_processor_push_resources(_ctx: Handle, proc: Handle, res:
         let mut proc_guard = proc_arc.lock().unwrap();
         proc_guard.rstack.resources.push(res);
 
-        // Pass to chain if any
-        if let Some(chain) = proc_guard.chain {
-            drop(proc_guard);
-            pdf_processor_push_resources(_ctx, chain, res);
+        // Pass to chain and tee branches if any
+        let downstream = proc_guard.downstream();
+        drop(proc_guard);
+        for next in downstream {
+            pdf_processor_push_resources(_ctx, next, res);
         }
     }
 }
@@ -646,10 +1963,11 @@ pub extern "C" fn pdf_processor_pop_resources(_ctx: Handle, proc: Handle) -> Han
         let mut proc_guard = proc_arc.lock().unwrap();
         let res = proc_guard.rstack.resources.pop().unwrap_or(0);
 
-        // Pass to chain if any
-        if let Some(chain) = proc_guard.chain {
-            drop(proc_guard);
-            let _ = pdf_processor_pop_resources(_ctx, chain);
+        // Pass to chain and tee branches if any
+        let downstream = proc_guard.downstream();
+        drop(proc_guard);
+        for next in downstream {
+            let _ = pdf_processor_pop_resources(_ctx, next);
         }
 
         return res;
@@ -661,33 +1979,230 @@ pub extern "C" fn pdf_processor_pop_resources(_ctx: Handle, proc: Handle) -> Han
 // FFI Functions - Content Processing
 // ============================================================================
 
+/// The bytes behind a content stream handle, if it is a stream
+fn content_bytes(stm: Handle) -> Option<Arc<FileBytes>> {
+    let stream = STREAMS.get(stm)?;
+    let data = Arc::clone(&stream.lock().ok()?.data);
+    Some(data)
+}
+
+/// Compiled content streams held by the store
+static CONTENT_PROGRAMS: LazyLock<HandleStore<Arc<ContentProgram>>> =
+    LazyLock::new(HandleStore::new);
+
+/// Key prefix for cached content programs of one document
+fn content_program_key_prefix(doc: Handle) -> Vec<u8> {
+    let mut key = b"pdf_content_program:".to_vec();
+    key.extend_from_slice(&doc.to_le_bytes());
+    key
+}
+
+fn content_program_key(doc: Handle, num: i32) -> Vec<u8> {
+    let mut key = content_program_key_prefix(doc);
+    key.extend_from_slice(&num.to_le_bytes());
+    key
+}
+
+fn keep_program(program: Handle) -> Handle {
+    if CONTENT_PROGRAMS.get(program).is_none() {
+        return 0;
+    }
+    CONTENT_PROGRAMS.keep(program)
+}
+
+fn release_program(program: Handle) {
+    CONTENT_PROGRAMS.release(program);
+}
+
+/// The compiled content stream of object `num` in `doc`, from the store,
+/// compiling it on a miss
+///
+/// Programs are `StoreType::ContentProgram` items keyed by (document,
+/// object number), so every later pass over the same stream (render,
+/// text extraction, filtering) replays it without lexing or parsing
+/// numbers, until the store evicts it.
+fn content_program(doc: Handle, num: i32) -> Option<Arc<ContentProgram>> {
+    let key = content_program_key(doc, num);
+    let cached = store_find_and_keep(&key, keep_program);
+    if cached != 0 {
+        let program = CONTENT_PROGRAMS
+            .get(cached)
+            .and_then(|p| p.lock().ok().map(|g| Arc::clone(&g)));
+        CONTENT_PROGRAMS.release(cached);
+        if program.is_some() {
+            return program;
+        }
+    }
+
+    let data = DOCUMENTS.get(doc)?.lock().ok()?.data();
+    let fetched = open_source(&data, 0)?.fetch(num)?;
+    let contents = decode_stream(&fetched.value, fetched.stream.as_ref()?)?;
+    let program = Arc::new(ContentProgram::compile(&contents));
+
+    let handle = CONTENT_PROGRAMS.insert(Arc::clone(&program));
+    store_owned_item(
+        StoreType::ContentProgram,
+        handle,
+        program.size(),
+        &key,
+        release_program,
+    );
+    Some(program)
+}
+
+/// Drop the cached content programs of a document
+///
+/// Call after editing a document's content streams so later passes
+/// compile them afresh. `fz_drop_document` does this automatically.
+///
+/// # Returns
+/// Number of programs removed from the store
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_purge_content_program_cache(_ctx: Handle, doc: Handle) -> i32 {
+    store_discard_matching(StoreType::ContentProgram, &content_program_key_prefix(doc)) as i32
+}
+
+/// Run content on a processor under `res`, leaving its graphics state as
+/// it was
+fn run_contents_on(proc: Handle, res: Handle, run: impl FnOnce(&mut PdfProcessor)) {
+    let Some(proc_arc) = PDF_PROCESSORS.get(proc) else {
+        return;
+    };
+    let mut proc_guard = proc_arc.lock().unwrap();
+
+    // Push resources
+    proc_guard.rstack.resources.push(res);
+
+    // Initialize graphics state
+    let depth = proc_guard.gstate_stack.len();
+    proc_guard.push_gstate();
+
+    run(&mut proc_guard);
+
+    // Pop graphics state
+    proc_guard.gstate_stack.truncate(depth + 1);
+    if proc_guard.gstate_stack.len() > depth {
+        proc_guard.pop_gstate();
+    }
+
+    // Pop resources
+    proc_guard.rstack.resources.pop();
+}
+
+/// Object numbers of the content streams of page `page_num` of `doc`
+fn page_content_nums(doc: Handle, page_num: i32) -> Vec<i32> {
+    let Some(data) = DOCUMENTS
+        .get(doc)
+        .and_then(|d| d.lock().ok().map(|d| d.data()))
+    else {
+        return Vec::new();
+    };
+    let Some(mut xref) = open_source(&data, 0) else {
+        return Vec::new();
+    };
+    let contents = xref
+        .lazy_page_object(page_num)
+        .and_then(|page| xref.fetch(page))
+        .and_then(|page| dict_get(&page.value, "Contents").cloned());
+    match contents.as_ref().and_then(|c| resolve(&mut xref, c)) {
+        Some(ParsedValue::Array(items)) => items.iter().filter_map(as_ref).collect(),
+        _ => contents.as_ref().and_then(as_ref).into_iter().collect(),
+    }
+}
+
+/// Run the contents of page `page_num` of `doc` into device `dev` under
+/// `ctm`
+///
+/// The page's content streams are replayed in order through one run
+/// processor from the store's compiled programs (see `content_program`),
+/// and clips left open by unbalanced q/Q are popped at the end.
+pub(crate) fn run_page_contents(doc: Handle, page_num: i32, dev: Handle, ctm: Matrix) {
+    let mut processor = PdfProcessor::new(ProcessorType::Run);
+    processor.document = Some(doc);
+    processor.device = Some(dev);
+    processor.transform = ctm;
+    for num in page_content_nums(doc, page_num) {
+        if let Some(program) = content_program(doc, num) {
+            processor.run_program(&program);
+        }
+    }
+    while processor.pop_gstate() {}
+    let clips = processor.gstate.clips;
+    processor.pop_clips(clips);
+}
+
+/// Run the appearances of annotations `annots` into device `dev` under
+/// `ctm` (see `PdfProcessor::draw_annot`)
+pub(crate) fn run_annots(annots: &[Handle], dev: Handle, ctm: Matrix) {
+    let mut processor = PdfProcessor::new(ProcessorType::Run);
+    processor.device = Some(dev);
+    processor.transform = ctm;
+    for &handle in annots {
+        if let Some(annot) = ANNOTATIONS.get(handle) {
+            if let Ok(annot) = annot.lock() {
+                processor.draw_annot(&annot);
+            }
+        }
+    }
+}
+
+/// Call `f` for each of `targets`, on a thread each when there are several
+fn fan_out(targets: &[Handle], f: impl Fn(Handle) + Sync) {
+    if let [target] = targets {
+        f(*target);
+        return;
+    }
+    std::thread::scope(|scope| {
+        for &target in targets {
+            let f = &f;
+            scope.spawn(move || f(target));
+        }
+    });
+}
+
 /// Process a content stream
+///
+/// `stm` is either a stream handle, whose bytes are interpreted directly,
+/// or an indirect reference to a content stream object of `doc`, which is
+/// compiled once and replayed from the store on later calls (see
+/// `content_program`). The operators run under a single lock of the
+/// processor; a tee's branches each replay one shared compilation. Unbalanced q/Q in the stream don't leak into the caller's
+/// graphics state.
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_process_contents(
     _ctx: Handle,
     proc: Handle,
-    _doc: Handle,
+    doc: Handle,
     res: Handle,
-    _stm: Handle,
+    stm: Handle,
     _out_res: *mut Handle,
 ) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-
-        // Push resources
-        proc_guard.rstack.resources.push(res);
-
-        // Initialize graphics state
-        proc_guard.push_gstate();
-
-        // In a real implementation, we would parse the content stream
-        // and call the appropriate operator functions
-
-        // Pop graphics state
-        proc_guard.pop_gstate();
-
-        // Pop resources
-        proc_guard.rstack.resources.pop();
+    let _span = super::trace::span(c"interpret");
+    let contents = content_bytes(stm);
+    let program = match (&contents, pdf_to_num(0, stm)) {
+        (None, num) if num > 0 => content_program(doc, num),
+        _ => None,
+    };
+    let targets = tee_targets(proc);
+    if targets.is_empty() {
+        // Text processors skip image and shading operators rather than
+        // loading their resources
+        run_contents_on(proc, res, |p| {
+            if let Some(data) = &contents {
+                p.run_contents(data);
+            } else if let Some(program) = &program {
+                p.run_program(program);
+            }
+        });
+    } else if let Some(program) =
+        program.or_else(|| contents.map(|data| Arc::new(ContentProgram::compile(&data))))
+    {
+        // One parse for every branch of the tee
+        fan_out(&targets, |target| {
+            run_contents_on(target, res, |p| {
+                p.run_program(&program);
+            });
+        });
     }
 
     if !_out_res.is_null() {
@@ -705,7 +2220,7 @@ pub extern "C" fn pdf_process_annot(_ctx: Handle, proc: Handle, annot: Handle) {
         proc_guard.push_gstate();
 
         // Process annotation appearance stream (would parse in real implementation)
-        proc_guard.record_op("annot", vec![OperatorArg::Integer(annot as i32)]);
+        proc_guard.record_op("annot", || vec![OperatorArg::Integer(annot as i32)]);
 
         proc_guard.pop_gstate();
     }
@@ -724,11 +2239,23 @@ pub extern "C" fn pdf_process_glyph(_ctx: Handle, proc: Handle, _doc: Handle, re
 
 /// Process raw contents without resource handling
 #[unsafe(no_mangle)]
-pub extern "C" fn pdf_process_raw_contents(_ctx: Handle, proc: Handle, _doc: Handle, _stm: Handle) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let _proc_guard = proc_arc.lock().unwrap();
-        // Process content stream without managing resources
+pub extern "C" fn pdf_process_raw_contents(_ctx: Handle, proc: Handle, _doc: Handle, stm: Handle) {
+    let Some(data) = content_bytes(stm) else {
+        return;
+    };
+    let targets = tee_targets(proc);
+    if targets.is_empty() {
+        with_processor(proc, |p| {
+            p.run_contents(&data);
+        });
+        return;
     }
+    let program = ContentProgram::compile(&data);
+    fan_out(&targets, |target| {
+        if let Some(target_arc) = PDF_PROCESSORS.get(target) {
+            target_arc.lock().unwrap().run_program(&program);
+        }
+    });
 }
 
 /// Count q/Q balance in a content stream
@@ -757,41 +2284,25 @@ pub extern "C" fn pdf_count_q_balance(
 /// Set line width (w operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_w(_ctx: Handle, proc: Handle, linewidth: f32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.gstate.line_width = linewidth;
-        proc_guard.record_op("w", vec![OperatorArg::Number(linewidth)]);
-    }
+    with_processor(proc, |p| p.set_line_width(linewidth));
 }
 
 /// Set line join (j operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_j(_ctx: Handle, proc: Handle, linejoin: i32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.gstate.line_join = linejoin;
-        proc_guard.record_op("j", vec![OperatorArg::Integer(linejoin)]);
-    }
+    with_processor(proc, |p| p.set_line_join(linejoin));
 }
 
 /// Set line cap (J operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_J(_ctx: Handle, proc: Handle, linecap: i32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.gstate.line_cap = linecap;
-        proc_guard.record_op("J", vec![OperatorArg::Integer(linecap)]);
-    }
+    with_processor(proc, |p| p.set_line_cap(linecap));
 }
 
 /// Set miter limit (M operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_M(_ctx: Handle, proc: Handle, miterlimit: f32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.gstate.miter_limit = miterlimit;
-        proc_guard.record_op("M", vec![OperatorArg::Number(miterlimit)]);
-    }
+    with_processor(proc, |p| p.set_miter_limit(miterlimit));
 }
 
 /// Set dash pattern (d operator)
@@ -803,74 +2314,37 @@ pub extern "C" fn pdf_op_d(
     array_len: i32,
     phase: f32,
 ) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-
-        let dash_array = if !array.is_null() && array_len > 0 {
-            unsafe { std::slice::from_raw_parts(array, array_len as usize) }.to_vec()
-        } else {
-            Vec::new()
-        };
-
-        proc_guard.gstate.dash_array = dash_array.clone();
-        proc_guard.gstate.dash_phase = phase;
-
-        let args: Vec<OperatorArg> = dash_array.iter().map(|&v| OperatorArg::Number(v)).collect();
-        proc_guard.record_op(
-            "d",
-            vec![OperatorArg::Array(args), OperatorArg::Number(phase)],
-        );
-    }
+    let dash_array = if !array.is_null() && array_len > 0 {
+        unsafe { std::slice::from_raw_parts(array, array_len as usize) }
+    } else {
+        &[]
+    };
+    with_processor(proc, |p| p.set_dash(dash_array, phase));
 }
 
 /// Set rendering intent (ri operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_ri(_ctx: Handle, proc: Handle, intent: *const c_char) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-
-        let intent_str = if !intent.is_null() {
-            unsafe { CStr::from_ptr(intent) }
-                .to_str()
-                .unwrap_or("RelativeColorimetric")
-                .to_string()
-        } else {
-            "RelativeColorimetric".to_string()
-        };
-
-        proc_guard.gstate.rendering_intent = intent_str.clone();
-        proc_guard.record_op("ri", vec![OperatorArg::Name(intent_str)]);
-    }
+    let intent = c_str_or(intent, "RelativeColorimetric");
+    with_processor(proc, |p| p.set_rendering_intent(intent));
 }
 
 /// Set flatness (i operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_i(_ctx: Handle, proc: Handle, flatness: f32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.gstate.flatness = flatness;
-        proc_guard.record_op("i", vec![OperatorArg::Number(flatness)]);
-    }
+    with_processor(proc, |p| p.set_flatness(flatness));
 }
 
 /// Save graphics state (q operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_q(_ctx: Handle, proc: Handle) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.push_gstate();
-        proc_guard.record_op("q", vec![]);
-    }
+    with_processor(proc, PdfProcessor::save);
 }
 
 /// Restore graphics state (Q operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_Q(_ctx: Handle, proc: Handle) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.pop_gstate();
-        proc_guard.record_op("Q", vec![]);
-    }
+    with_processor(proc, PdfProcessor::restore);
 }
 
 /// Concatenate matrix (cm operator)
@@ -885,24 +2359,7 @@ pub extern "C" fn pdf_op_cm(
     e: f32,
     f: f32,
 ) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-
-        let new_matrix = Matrix { a, b, c, d, e, f };
-        proc_guard.gstate.ctm = proc_guard.gstate.ctm.concat(&new_matrix);
-
-        proc_guard.record_op(
-            "cm",
-            vec![
-                OperatorArg::Number(a),
-                OperatorArg::Number(b),
-                OperatorArg::Number(c),
-                OperatorArg::Number(d),
-                OperatorArg::Number(e),
-                OperatorArg::Number(f),
-            ],
-        );
-    }
+    with_processor(proc, |p| p.concat_ctm(Matrix { a, b, c, d, e, f }));
 }
 
 // ============================================================================
@@ -912,15 +2369,8 @@ pub extern "C" fn pdf_op_cm(
 /// Begin extended graphics state
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_gs_begin(_ctx: Handle, proc: Handle, name: *const c_char) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        let name_str = if !name.is_null() {
-            unsafe { CStr::from_ptr(name) }.to_str().unwrap_or("")
-        } else {
-            ""
-        };
-        proc_guard.record_op("gs", vec![OperatorArg::Name(name_str.to_string())]);
-    }
+    let name = c_str_or(name, "");
+    with_processor(proc, |p| p.set_extgstate(name));
 }
 
 /// Set blend mode
@@ -998,21 +2448,13 @@ pub extern "C" fn pdf_op_gs_OPM(_ctx: Handle, proc: Handle, i: i32) {
 /// Move to (m operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_m(_ctx: Handle, proc: Handle, x: f32, y: f32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.path.elements.push(PathElement::MoveTo { x, y });
-        proc_guard.record_op("m", vec![OperatorArg::Number(x), OperatorArg::Number(y)]);
-    }
+    with_processor(proc, |p| p.move_to(x, y));
 }
 
 /// Line to (l operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_l(_ctx: Handle, proc: Handle, x: f32, y: f32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.path.elements.push(PathElement::LineTo { x, y });
-        proc_guard.record_op("l", vec![OperatorArg::Number(x), OperatorArg::Number(y)]);
-    }
+    with_processor(proc, |p| p.line_to(x, y));
 }
 
 /// Curve to (c operator) - cubic bezier with two control points
@@ -1027,101 +2469,31 @@ pub extern "C" fn pdf_op_c(
     x3: f32,
     y3: f32,
 ) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.path.elements.push(PathElement::CurveTo {
-            x1,
-            y1,
-            x2,
-            y2,
-            x3,
-            y3,
-        });
-        proc_guard.record_op(
-            "c",
-            vec![
-                OperatorArg::Number(x1),
-                OperatorArg::Number(y1),
-                OperatorArg::Number(x2),
-                OperatorArg::Number(y2),
-                OperatorArg::Number(x3),
-                OperatorArg::Number(y3),
-            ],
-        );
-    }
+    with_processor(proc, |p| p.curve_to(x1, y1, x2, y2, x3, y3));
 }
 
 /// Curve to (v operator) - control point at current point
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_v(_ctx: Handle, proc: Handle, x2: f32, y2: f32, x3: f32, y3: f32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard
-            .path
-            .elements
-            .push(PathElement::CurveV { x2, y2, x3, y3 });
-        proc_guard.record_op(
-            "v",
-            vec![
-                OperatorArg::Number(x2),
-                OperatorArg::Number(y2),
-                OperatorArg::Number(x3),
-                OperatorArg::Number(y3),
-            ],
-        );
-    }
+    with_processor(proc, |p| p.curve_v(x2, y2, x3, y3));
 }
 
 /// Curve to (y operator) - control point at end point
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_y(_ctx: Handle, proc: Handle, x1: f32, y1: f32, x3: f32, y3: f32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard
-            .path
-            .elements
-            .push(PathElement::CurveY { x1, y1, x3, y3 });
-        proc_guard.record_op(
-            "y",
-            vec![
-                OperatorArg::Number(x1),
-                OperatorArg::Number(y1),
-                OperatorArg::Number(x3),
-                OperatorArg::Number(y3),
-            ],
-        );
-    }
+    with_processor(proc, |p| p.curve_y(x1, y1, x3, y3));
 }
 
 /// Close path (h operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_h(_ctx: Handle, proc: Handle) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.path.elements.push(PathElement::ClosePath);
-        proc_guard.record_op("h", vec![]);
-    }
+    with_processor(proc, PdfProcessor::close_path);
 }
 
 /// Rectangle (re operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_re(_ctx: Handle, proc: Handle, x: f32, y: f32, w: f32, h: f32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard
-            .path
-            .elements
-            .push(PathElement::Rect { x, y, w, h });
-        proc_guard.record_op(
-            "re",
-            vec![
-                OperatorArg::Number(x),
-                OperatorArg::Number(y),
-                OperatorArg::Number(w),
-                OperatorArg::Number(h),
-            ],
-        );
-    }
+    with_processor(proc, |p| p.rect(x, y, w, h));
 }
 
 // ============================================================================
@@ -1131,32 +2503,19 @@ pub extern "C" fn pdf_op_re(_ctx: Handle, proc: Handle, x: f32, y: f32, w: f32,
 /// Stroke path (S operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_S(_ctx: Handle, proc: Handle) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.record_op("S", vec![]);
-        proc_guard.path = PathState::default();
-    }
+    with_processor(proc, |p| p.paint_path("S", false));
 }
 
 /// Close and stroke (s operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_s(_ctx: Handle, proc: Handle) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.path.elements.push(PathElement::ClosePath);
-        proc_guard.record_op("s", vec![]);
-        proc_guard.path = PathState::default();
-    }
+    with_processor(proc, |p| p.paint_path("s", true));
 }
 
 /// Fill path nonzero (f operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_f(_ctx: Handle, proc: Handle) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.record_op("f", vec![]);
-        proc_guard.path = PathState::default();
-    }
+    with_processor(proc, |p| p.paint_path("f", false));
 }
 
 /// Fill path nonzero (F operator - same as f)
@@ -1168,63 +2527,37 @@ pub extern "C" fn pdf_op_F(_ctx: Handle, proc: Handle) {
 /// Fill path even-odd (f* operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_fstar(_ctx: Handle, proc: Handle) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.record_op("f*", vec![]);
-        proc_guard.path = PathState::default();
-    }
+    with_processor(proc, |p| p.paint_path("f*", false));
 }
 
 /// Fill and stroke nonzero (B operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_B(_ctx: Handle, proc: Handle) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.record_op("B", vec![]);
-        proc_guard.path = PathState::default();
-    }
+    with_processor(proc, |p| p.paint_path("B", false));
 }
 
 /// Fill and stroke even-odd (B* operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_Bstar(_ctx: Handle, proc: Handle) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.record_op("B*", vec![]);
-        proc_guard.path = PathState::default();
-    }
+    with_processor(proc, |p| p.paint_path("B*", false));
 }
 
 /// Close, fill and stroke nonzero (b operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_b(_ctx: Handle, proc: Handle) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.path.elements.push(PathElement::ClosePath);
-        proc_guard.record_op("b", vec![]);
-        proc_guard.path = PathState::default();
-    }
+    with_processor(proc, |p| p.paint_path("b", true));
 }
 
 /// Close, fill and stroke even-odd (b* operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_bstar(_ctx: Handle, proc: Handle) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.path.elements.push(PathElement::ClosePath);
-        proc_guard.record_op("b*", vec![]);
-        proc_guard.path = PathState::default();
-    }
+    with_processor(proc, |p| p.paint_path("b*", true));
 }
 
 /// End path without filling or stroking (n operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_n(_ctx: Handle, proc: Handle) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.record_op("n", vec![]);
-        proc_guard.path = PathState::default();
-    }
+    with_processor(proc, |p| p.paint_path("n", false));
 }
 
 // ============================================================================
@@ -1234,19 +2567,13 @@ pub extern "C" fn pdf_op_n(_ctx: Handle, proc: Handle) {
 /// Set clipping path nonzero (W operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_W(_ctx: Handle, proc: Handle) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.record_op("W", vec![]);
-    }
+    with_processor(proc, |p| p.clip(false));
 }
 
 /// Set clipping path even-odd (W* operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_Wstar(_ctx: Handle, proc: Handle) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.record_op("W*", vec![]);
-    }
+    with_processor(proc, |p| p.clip(true));
 }
 
 // ============================================================================
@@ -1256,29 +2583,13 @@ pub extern "C" fn pdf_op_Wstar(_ctx: Handle, proc: Handle) {
 /// Begin text object (BT operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_BT(_ctx: Handle, proc: Handle) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.in_text = true;
-        proc_guard.text_object = Some(PdfTextObjectState {
-            tlm: Matrix::IDENTITY,
-            tm: Matrix::IDENTITY,
-            text_mode: 0,
-            text_content: Vec::new(),
-            text_bbox: Rect::default(),
-        });
-        proc_guard.record_op("BT", vec![]);
-    }
+    with_processor(proc, PdfProcessor::begin_text);
 }
 
 /// End text object (ET operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_ET(_ctx: Handle, proc: Handle) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.in_text = false;
-        proc_guard.text_object = None;
-        proc_guard.record_op("ET", vec![]);
-    }
+    with_processor(proc, PdfProcessor::end_text);
 }
 
 // ============================================================================
@@ -1288,85 +2599,44 @@ pub extern "C" fn pdf_op_ET(_ctx: Handle, proc: Handle) {
 /// Set character spacing (Tc operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_Tc(_ctx: Handle, proc: Handle, charspace: f32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.text_state.char_space = charspace;
-        proc_guard.record_op("Tc", vec![OperatorArg::Number(charspace)]);
-    }
+    with_processor(proc, |p| p.set_char_space(charspace));
 }
 
 /// Set word spacing (Tw operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_Tw(_ctx: Handle, proc: Handle, wordspace: f32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.text_state.word_space = wordspace;
-        proc_guard.record_op("Tw", vec![OperatorArg::Number(wordspace)]);
-    }
+    with_processor(proc, |p| p.set_word_space(wordspace));
 }
 
 /// Set horizontal scaling (Tz operator)
 #[unsafe(no_mangle)]
-pub extern "C" fn pdf_op_Tz(_ctx: Handle, proc: Handle, scale: f32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.text_state.scale = scale;
-        proc_guard.record_op("Tz", vec![OperatorArg::Number(scale)]);
-    }
+pub extern "C" fn pdf_op_Tz(_ctx: Handle, proc: Handle, scale: f32) {
+    with_processor(proc, |p| p.set_text_scale(scale));
 }
 
 /// Set leading (TL operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_TL(_ctx: Handle, proc: Handle, leading: f32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.text_state.leading = leading;
-        proc_guard.record_op("TL", vec![OperatorArg::Number(leading)]);
-    }
+    with_processor(proc, |p| p.set_leading(leading));
 }
 
 /// Set font and size (Tf operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_Tf(_ctx: Handle, proc: Handle, name: *const c_char, size: f32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-
-        let font_name = if !name.is_null() {
-            unsafe { CStr::from_ptr(name) }
-                .to_str()
-                .unwrap_or("")
-                .to_string()
-        } else {
-            String::new()
-        };
-
-        proc_guard.text_state.font_name = font_name.clone();
-        proc_guard.text_state.size = size;
-        proc_guard.record_op(
-            "Tf",
-            vec![OperatorArg::Name(font_name), OperatorArg::Number(size)],
-        );
-    }
+    let name = c_str_or(name, "");
+    with_processor(proc, |p| p.set_font(name, size));
 }
 
 /// Set text rendering mode (Tr operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_Tr(_ctx: Handle, proc: Handle, render: i32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.text_state.render = render;
-        proc_guard.record_op("Tr", vec![OperatorArg::Integer(render)]);
-    }
+    with_processor(proc, |p| p.set_text_render(render));
 }
 
 /// Set text rise (Ts operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_Ts(_ctx: Handle, proc: Handle, rise: f32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.text_state.rise = rise;
-        proc_guard.record_op("Ts", vec![OperatorArg::Number(rise)]);
-    }
+    with_processor(proc, |p| p.set_text_rise(rise));
 }
 
 // ============================================================================
@@ -1376,44 +2646,13 @@ pub extern "C" fn pdf_op_Ts(_ctx: Handle, proc: Handle, rise: f32) {
 /// Move text position (Td operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_Td(_ctx: Handle, proc: Handle, tx: f32, ty: f32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        if let Some(ref mut tos) = proc_guard.text_object {
-            let translate = Matrix {
-                a: 1.0,
-                b: 0.0,
-                c: 0.0,
-                d: 1.0,
-                e: tx,
-                f: ty,
-            };
-            tos.tlm = tos.tlm.concat(&translate);
-            tos.tm = tos.tlm;
-        }
-        proc_guard.record_op("Td", vec![OperatorArg::Number(tx), OperatorArg::Number(ty)]);
-    }
+    with_processor(proc, |p| p.move_text(tx, ty));
 }
 
 /// Move text position and set leading (TD operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_TD(_ctx: Handle, proc: Handle, tx: f32, ty: f32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.text_state.leading = -ty;
-        if let Some(ref mut tos) = proc_guard.text_object {
-            let translate = Matrix {
-                a: 1.0,
-                b: 0.0,
-                c: 0.0,
-                d: 1.0,
-                e: tx,
-                f: ty,
-            };
-            tos.tlm = tos.tlm.concat(&translate);
-            tos.tm = tos.tlm;
-        }
-        proc_guard.record_op("TD", vec![OperatorArg::Number(tx), OperatorArg::Number(ty)]);
-    }
+    with_processor(proc, |p| p.move_text_set_leading(tx, ty));
 }
 
 /// Set text matrix (Tm operator)
@@ -1428,46 +2667,13 @@ pub extern "C" fn pdf_op_Tm(
     e: f32,
     f: f32,
 ) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        if let Some(ref mut tos) = proc_guard.text_object {
-            tos.tlm = Matrix { a, b, c, d, e, f };
-            tos.tm = tos.tlm;
-        }
-        proc_guard.record_op(
-            "Tm",
-            vec![
-                OperatorArg::Number(a),
-                OperatorArg::Number(b),
-                OperatorArg::Number(c),
-                OperatorArg::Number(d),
-                OperatorArg::Number(e),
-                OperatorArg::Number(f),
-            ],
-        );
-    }
+    with_processor(proc, |p| p.set_text_matrix(Matrix { a, b, c, d, e, f }));
 }
 
 /// Move to next line (T* operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_Tstar(_ctx: Handle, proc: Handle) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        let leading = proc_guard.text_state.leading;
-        if let Some(ref mut tos) = proc_guard.text_object {
-            let translate = Matrix {
-                a: 1.0,
-                b: 0.0,
-                c: 0.0,
-                d: 1.0,
-                e: 0.0,
-                f: -leading,
-            };
-            tos.tlm = tos.tlm.concat(&translate);
-            tos.tm = tos.tlm;
-        }
-        proc_guard.record_op("T*", vec![]);
-    }
+    with_processor(proc, PdfProcessor::next_line);
 }
 
 // ============================================================================
@@ -1477,40 +2683,20 @@ pub extern "C" fn pdf_op_Tstar(_ctx: Handle, proc: Handle) {
 /// Show text (Tj operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_Tj(_ctx: Handle, proc: Handle, str: *const c_char, len: usize) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-
-        let text = if !str.is_null() {
-            let bytes = unsafe { std::slice::from_raw_parts(str as *const u8, len) };
-            String::from_utf8_lossy(bytes).to_string()
-        } else {
-            String::new()
-        };
-
-        // Extract text state values before mutable borrow
-        let font_name = proc_guard.text_state.font_name.clone();
-        let font_size = proc_guard.text_state.size;
-
-        if let Some(ref mut tos) = proc_guard.text_object {
-            tos.text_content.push(TextSpan {
-                text: text.clone(),
-                matrix: tos.tm,
-                font_name,
-                font_size,
-            });
-        }
-
-        proc_guard.record_op("Tj", vec![OperatorArg::String(text)]);
-    }
+    let bytes = if !str.is_null() {
+        unsafe { std::slice::from_raw_parts(str as *const u8, len) }
+    } else {
+        &[]
+    };
+    with_processor(proc, |p| p.show_text(bytes));
 }
 
 /// Show text with individual positioning (TJ operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_TJ(_ctx: Handle, proc: Handle) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.record_op("TJ", vec![]);
-    }
+    with_processor(proc, |p| {
+        p.record_op("TJ", || vec![OperatorArg::Array(vec![])])
+    });
 }
 
 /// Move to next line and show text (' operator)
@@ -1547,10 +2733,7 @@ pub extern "C" fn pdf_op_dquote(
 /// Type 3 font glyph width (d0 operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_d0(_ctx: Handle, proc: Handle, wx: f32, wy: f32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.record_op("d0", vec![OperatorArg::Number(wx), OperatorArg::Number(wy)]);
-    }
+    with_processor(proc, |p| p.glyph_width(wx, wy));
 }
 
 /// Type 3 font glyph width and bounding box (d1 operator)
@@ -1565,20 +2748,7 @@ pub extern "C" fn pdf_op_d1(
     urx: f32,
     ury: f32,
 ) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.record_op(
-            "d1",
-            vec![
-                OperatorArg::Number(wx),
-                OperatorArg::Number(wy),
-                OperatorArg::Number(llx),
-                OperatorArg::Number(lly),
-                OperatorArg::Number(urx),
-                OperatorArg::Number(ury),
-            ],
-        );
-    }
+    with_processor(proc, |p| p.glyph_width_bbox([wx, wy, llx, lly, urx, ury]));
 }
 
 // ============================================================================
@@ -1588,165 +2758,81 @@ pub extern "C" fn pdf_op_d1(
 /// Set stroke colorspace (CS operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_CS(_ctx: Handle, proc: Handle, name: *const c_char) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        let cs_name = if !name.is_null() {
-            unsafe { CStr::from_ptr(name) }
-                .to_str()
-                .unwrap_or("DeviceGray")
-                .to_string()
-        } else {
-            "DeviceGray".to_string()
-        };
-        proc_guard.gstate.stroke_cs = cs_name.clone();
-        proc_guard.record_op("CS", vec![OperatorArg::Name(cs_name)]);
-    }
+    let name = c_str_or(name, "DeviceGray");
+    with_processor(proc, |p| p.set_stroke_colorspace(name));
 }
 
 /// Set fill colorspace (cs operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_cs(_ctx: Handle, proc: Handle, name: *const c_char) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        let cs_name = if !name.is_null() {
-            unsafe { CStr::from_ptr(name) }
-                .to_str()
-                .unwrap_or("DeviceGray")
-                .to_string()
-        } else {
-            "DeviceGray".to_string()
-        };
-        proc_guard.gstate.fill_cs = cs_name.clone();
-        proc_guard.record_op("cs", vec![OperatorArg::Name(cs_name)]);
-    }
+    let name = c_str_or(name, "DeviceGray");
+    with_processor(proc, |p| p.set_fill_colorspace(name));
 }
 
 /// Set stroke color (SC operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_SC_color(_ctx: Handle, proc: Handle, n: i32, color: *const f32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        let colors = if !color.is_null() && n > 0 {
-            unsafe { std::slice::from_raw_parts(color, n as usize) }.to_vec()
-        } else {
-            vec![0.0]
-        };
-        proc_guard.gstate.stroke_color = colors.clone();
-        let args: Vec<OperatorArg> = colors.iter().map(|&c| OperatorArg::Number(c)).collect();
-        proc_guard.record_op("SC", args);
-    }
+    let color = if !color.is_null() && n > 0 {
+        unsafe { std::slice::from_raw_parts(color, n as usize) }
+    } else {
+        &[]
+    };
+    with_processor(proc, |p| p.set_stroke_color(color));
 }
 
 /// Set fill color (sc operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_sc_color(_ctx: Handle, proc: Handle, n: i32, color: *const f32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        let colors = if !color.is_null() && n > 0 {
-            unsafe { std::slice::from_raw_parts(color, n as usize) }.to_vec()
-        } else {
-            vec![0.0]
-        };
-        proc_guard.gstate.fill_color = colors.clone();
-        let args: Vec<OperatorArg> = colors.iter().map(|&c| OperatorArg::Number(c)).collect();
-        proc_guard.record_op("sc", args);
-    }
+    let color = if !color.is_null() && n > 0 {
+        unsafe { std::slice::from_raw_parts(color, n as usize) }
+    } else {
+        &[]
+    };
+    with_processor(proc, |p| p.set_fill_color(color));
 }
 
 /// Set stroke gray (G operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_G(_ctx: Handle, proc: Handle, g: f32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.gstate.stroke_cs = "DeviceGray".to_string();
-        proc_guard.gstate.stroke_color = vec![g];
-        proc_guard.record_op("G", vec![OperatorArg::Number(g)]);
-    }
+    with_processor(proc, |p| p.set_stroke_device_color("G", "DeviceGray", &[g]));
 }
 
 /// Set fill gray (g operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_g(_ctx: Handle, proc: Handle, g: f32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.gstate.fill_cs = "DeviceGray".to_string();
-        proc_guard.gstate.fill_color = vec![g];
-        proc_guard.record_op("g", vec![OperatorArg::Number(g)]);
-    }
+    with_processor(proc, |p| p.set_fill_device_color("g", "DeviceGray", &[g]));
 }
 
 /// Set stroke RGB (RG operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_RG(_ctx: Handle, proc: Handle, r: f32, g: f32, b: f32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.gstate.stroke_cs = "DeviceRGB".to_string();
-        proc_guard.gstate.stroke_color = vec![r, g, b];
-        proc_guard.record_op(
-            "RG",
-            vec![
-                OperatorArg::Number(r),
-                OperatorArg::Number(g),
-                OperatorArg::Number(b),
-            ],
-        );
-    }
+    with_processor(proc, |p| {
+        p.set_stroke_device_color("RG", "DeviceRGB", &[r, g, b])
+    });
 }
 
 /// Set fill RGB (rg operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_rg(_ctx: Handle, proc: Handle, r: f32, g: f32, b: f32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.gstate.fill_cs = "DeviceRGB".to_string();
-        proc_guard.gstate.fill_color = vec![r, g, b];
-        proc_guard.record_op(
-            "rg",
-            vec![
-                OperatorArg::Number(r),
-                OperatorArg::Number(g),
-                OperatorArg::Number(b),
-            ],
-        );
-    }
+    with_processor(proc, |p| {
+        p.set_fill_device_color("rg", "DeviceRGB", &[r, g, b])
+    });
 }
 
 /// Set stroke CMYK (K operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_K(_ctx: Handle, proc: Handle, c: f32, m: f32, y: f32, k: f32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.gstate.stroke_cs = "DeviceCMYK".to_string();
-        proc_guard.gstate.stroke_color = vec![c, m, y, k];
-        proc_guard.record_op(
-            "K",
-            vec![
-                OperatorArg::Number(c),
-                OperatorArg::Number(m),
-                OperatorArg::Number(y),
-                OperatorArg::Number(k),
-            ],
-        );
-    }
+    with_processor(proc, |p| {
+        p.set_stroke_device_color("K", "DeviceCMYK", &[c, m, y, k])
+    });
 }
 
 /// Set fill CMYK (k operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_k(_ctx: Handle, proc: Handle, c: f32, m: f32, y: f32, k: f32) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.gstate.fill_cs = "DeviceCMYK".to_string();
-        proc_guard.gstate.fill_color = vec![c, m, y, k];
-        proc_guard.record_op(
-            "k",
-            vec![
-                OperatorArg::Number(c),
-                OperatorArg::Number(m),
-                OperatorArg::Number(y),
-                OperatorArg::Number(k),
-            ],
-        );
-    }
+    with_processor(proc, |p| {
+        p.set_fill_device_color("k", "DeviceCMYK", &[c, m, y, k])
+    });
 }
 
 // ============================================================================
@@ -1756,64 +2842,28 @@ pub extern "C" fn pdf_op_k(_ctx: Handle, proc: Handle, c: f32, m: f32, y: f32, k
 /// Inline image (BI operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_BI(_ctx: Handle, proc: Handle, image: Handle) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.record_op("BI", vec![OperatorArg::Integer(image as i32)]);
-    }
+    with_processor(proc, |p| p.inline_image(image));
 }
 
 /// Shading (sh operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_sh(_ctx: Handle, proc: Handle, name: *const c_char) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        let shade_name = if !name.is_null() {
-            unsafe { CStr::from_ptr(name) }.to_str().unwrap_or("")
-        } else {
-            ""
-        };
-        proc_guard.record_op("sh", vec![OperatorArg::Name(shade_name.to_string())]);
-    }
+    let name = c_str_or(name, "");
+    with_processor(proc, |p| p.shade(name));
 }
 
 /// XObject image (Do operator for images)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_Do_image(_ctx: Handle, proc: Handle, name: *const c_char, image: Handle) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        let img_name = if !name.is_null() {
-            unsafe { CStr::from_ptr(name) }.to_str().unwrap_or("")
-        } else {
-            ""
-        };
-        proc_guard.record_op(
-            "Do",
-            vec![
-                OperatorArg::Name(img_name.to_string()),
-                OperatorArg::Integer(image as i32),
-            ],
-        );
-    }
+    let name = c_str_or(name, "");
+    with_processor(proc, |p| p.draw_image(name, image));
 }
 
 /// XObject form (Do operator for forms)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_Do_form(_ctx: Handle, proc: Handle, name: *const c_char, form: Handle) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        let form_name = if !name.is_null() {
-            unsafe { CStr::from_ptr(name) }.to_str().unwrap_or("")
-        } else {
-            ""
-        };
-        proc_guard.record_op(
-            "Do",
-            vec![
-                OperatorArg::Name(form_name.to_string()),
-                OperatorArg::Integer(form as i32),
-            ],
-        );
-    }
+    let name = c_str_or(name, "");
+    with_processor(proc, |p| p.draw_form(name, form));
 }
 
 // ============================================================================
@@ -1823,66 +2873,35 @@ pub extern "C" fn pdf_op_Do_form(_ctx: Handle, proc: Handle, name: *const c_char
 /// Marked content point (MP operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_MP(_ctx: Handle, proc: Handle, tag: *const c_char) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        let tag_str = if !tag.is_null() {
-            unsafe { CStr::from_ptr(tag) }.to_str().unwrap_or("")
-        } else {
-            ""
-        };
-        proc_guard.record_op("MP", vec![OperatorArg::Name(tag_str.to_string())]);
-    }
+    let tag = c_str_or(tag, "");
+    with_processor(proc, |p| p.mark("MP", tag));
 }
 
 /// Marked content point with properties (DP operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_DP(_ctx: Handle, proc: Handle, tag: *const c_char) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        let tag_str = if !tag.is_null() {
-            unsafe { CStr::from_ptr(tag) }.to_str().unwrap_or("")
-        } else {
-            ""
-        };
-        proc_guard.record_op("DP", vec![OperatorArg::Name(tag_str.to_string())]);
-    }
+    let tag = c_str_or(tag, "");
+    with_processor(proc, |p| p.mark("DP", tag));
 }
 
 /// Begin marked content (BMC operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_BMC(_ctx: Handle, proc: Handle, tag: *const c_char) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        let tag_str = if !tag.is_null() {
-            unsafe { CStr::from_ptr(tag) }.to_str().unwrap_or("")
-        } else {
-            ""
-        };
-        proc_guard.record_op("BMC", vec![OperatorArg::Name(tag_str.to_string())]);
-    }
+    let tag = c_str_or(tag, "");
+    with_processor(proc, |p| p.mark("BMC", tag));
 }
 
 /// Begin marked content with properties (BDC operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_BDC(_ctx: Handle, proc: Handle, tag: *const c_char) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        let tag_str = if !tag.is_null() {
-            unsafe { CStr::from_ptr(tag) }.to_str().unwrap_or("")
-        } else {
-            ""
-        };
-        proc_guard.record_op("BDC", vec![OperatorArg::Name(tag_str.to_string())]);
-    }
+    let tag = c_str_or(tag, "");
+    with_processor(proc, |p| p.mark("BDC", tag));
 }
 
 /// End marked content (EMC operator)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_op_EMC(_ctx: Handle, proc: Handle) {
-    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
-        let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.record_op("EMC", vec![]);
-    }
+    with_processor(proc, |p| p.record_op("EMC", Vec::new));
 }
 
 // ============================================================================
@@ -1894,7 +2913,7 @@ pub extern "C" fn pdf_op_EMC(_ctx: Handle, proc: Handle) {
 pub extern "C" fn pdf_op_BX(_ctx: Handle, proc: Handle) {
     if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
         let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.record_op("BX", vec![]);
+        proc_guard.record_op("BX", Vec::new);
     }
 }
 
@@ -1903,7 +2922,7 @@ pub extern "C" fn pdf_op_BX(_ctx: Handle, proc: Handle) {
 pub extern "C" fn pdf_op_EX(_ctx: Handle, proc: Handle) {
     if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
         let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.record_op("EX", vec![]);
+        proc_guard.record_op("EX", Vec::new);
     }
 }
 
@@ -1916,7 +2935,7 @@ pub extern "C" fn pdf_op_EX(_ctx: Handle, proc: Handle) {
 pub extern "C" fn pdf_op_EOD(_ctx: Handle, proc: Handle) {
     if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
         let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.record_op("EOD", vec![]);
+        proc_guard.record_op("EOD", Vec::new);
     }
 }
 
@@ -1925,7 +2944,7 @@ pub extern "C" fn pdf_op_EOD(_ctx: Handle, proc: Handle) {
 pub extern "C" fn pdf_op_END(_ctx: Handle, proc: Handle) {
     if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
         let mut proc_guard = proc_arc.lock().unwrap();
-        proc_guard.record_op("END", vec![]);
+        proc_guard.record_op("END", Vec::new);
     }
 }
 
@@ -1944,12 +2963,23 @@ pub extern "C" fn pdf_processor_get_type(_ctx: Handle, proc: Handle) -> i32 {
     }
 }
 
+/// Check whether a processor tracks only text state and the CTM
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_processor_is_text_only(_ctx: Handle, proc: Handle) -> i32 {
+    if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
+        let proc_guard = proc_arc.lock().unwrap();
+        if proc_guard.text_only { 1 } else { 0 }
+    } else {
+        0
+    }
+}
+
 /// Get number of operators processed
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_processor_get_operator_count(_ctx: Handle, proc: Handle) -> i32 {
     if let Some(proc_arc) = PDF_PROCESSORS.get(proc) {
         let proc_guard = proc_arc.lock().unwrap();
-        proc_guard.operators.len() as i32
+        proc_guard.op_count as i32
     } else {
         0
     }
@@ -2053,6 +3083,272 @@ mod tests {
         pdf_drop_processor(ctx, proc);
     }
 
+    #[test]
+    fn test_run_processor_paints_into_device() {
+        use crate::ffi::device::{fz_close_device, fz_drop_device, fz_new_list_device};
+        use crate::ffi::display_list::{
+            fz_display_list_count_commands, fz_drop_display_list, fz_new_display_list,
+        };
+        let list = fz_new_display_list(0, 0.0, 0.0, 100.0, 100.0);
+        let dev = fz_new_list_device(0, list);
+        let mut p = PdfProcessor::new(ProcessorType::Run);
+        p.device = Some(dev);
+        let content = b"q 0 0 50 50 re W n 1 0 0 rg 0 0 10 10 re f\n\
+                        2 w 0 0 m 10 10 l S BT /F1 12 Tf 10 10 Td (Hi) Tj ET Q";
+        assert_eq!(p.run_contents(content), 17);
+
+        // Painting reaches the device instead of the operator log
+        assert!(p.operators.is_empty());
+        assert_eq!(p.op_count, 17);
+        fz_close_device(0, dev);
+        fz_drop_device(0, dev);
+        // clip, fill, stroke, text and the clip popped by Q
+        assert_eq!(fz_display_list_count_commands(0, list), 5);
+        fz_drop_display_list(0, list);
+    }
+
+    #[test]
+    fn test_text_processor_skips_graphics() {
+        let ctx = 1;
+        let proc = pdf_new_text_processor(ctx, 0, 0, 1.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0, ptr::null());
+        assert_eq!(
+            pdf_processor_get_type(ctx, proc),
+            ProcessorType::Text as i32
+        );
+        assert_eq!(pdf_processor_is_text_only(ctx, proc), 1);
+
+        pdf_op_q(ctx, proc);
+        pdf_op_cm(ctx, proc, 2.0, 0.0, 0.0, 2.0, 10.0, 20.0);
+        pdf_op_w(ctx, proc, 3.0);
+        pdf_op_re(ctx, proc, 0.0, 0.0, 100.0, 100.0);
+        pdf_op_W(ctx, proc);
+        pdf_op_n(ctx, proc);
+        pdf_op_rg(ctx, proc, 1.0, 0.0, 0.0);
+        pdf_op_Do_image(ctx, proc, c"Im0".as_ptr(), 0);
+        pdf_op_sh(ctx, proc, c"Sh0".as_ptr());
+        pdf_op_BT(ctx, proc);
+        pdf_op_Tf(ctx, proc, c"F1".as_ptr(), 12.0);
+        pdf_op_Tj(ctx, proc, c"Hi".as_ptr(), 2);
+        pdf_op_ET(ctx, proc);
+        pdf_op_Q(ctx, proc);
+
+        // Only q, cm, BT, Tf, Tj, ET and Q are interpreted
+        assert_eq!(pdf_processor_get_operator_count(ctx, proc), 7);
+        assert_eq!(pdf_processor_get_gstate_depth(ctx, proc), 0);
+        if let Some(p) = PDF_PROCESSORS.get(proc) {
+            let guard = p.lock().unwrap();
+            assert!(guard.path.elements.is_empty());
+            assert!((guard.gstate.line_width - PdfGstate::new().line_width).abs() < 0.001);
+        }
+
+        let run = pdf_new_run_processor(ctx, 0, 0, 1.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0, ptr::null());
+        assert_eq!(pdf_processor_is_text_only(ctx, run), 0);
+        pdf_op_re(ctx, run, 0.0, 0.0, 100.0, 100.0);
+        assert_eq!(pdf_processor_get_operator_count(ctx, run), 1);
+
+        pdf_drop_processor(ctx, run);
+        pdf_drop_processor(ctx, proc);
+    }
+
+    #[test]
+    fn test_interpreter_matches_callbacks() {
+        let ctx = 1;
+        let content = b"q 2 0 0 2 10 20 cm 0.5 w 1 j [3 1] 0 d 1 0 0 rg\n\
+                        10 10 m 20 20 l 1 2 3 4 5 6 c h 0 0 5 5 re f*\n\
+                        BT /F1 12 Tf 100 700 Td (Hi) Tj [(a) -50 (b)] TJ ET\n\
+                        /Span BMC EMC BI /W 1 /H 1 ID \x00 EI bogus 1 2 Q";
+        let mut interpreted = PdfProcessor::new(ProcessorType::Run);
+        // q cm w j d rg m l c h re f* BT Tf Td Tj TJ ET BMC EMC BI Q
+        assert_eq!(interpreted.run_contents(content), 22);
+
+        let proc = pdf_new_processor(ctx, 1);
+        pdf_op_q(ctx, proc);
+        pdf_op_cm(ctx, proc, 2.0, 0.0, 0.0, 2.0, 10.0, 20.0);
+        pdf_op_w(ctx, proc, 0.5);
+        pdf_op_j(ctx, proc, 1);
+        pdf_op_d(ctx, proc, [3.0, 1.0].as_ptr(), 2, 0.0);
+        pdf_op_rg(ctx, proc, 1.0, 0.0, 0.0);
+        pdf_op_m(ctx, proc, 10.0, 10.0);
+        pdf_op_l(ctx, proc, 20.0, 20.0);
+        pdf_op_c(ctx, proc, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0);
+        pdf_op_h(ctx, proc);
+        pdf_op_re(ctx, proc, 0.0, 0.0, 5.0, 5.0);
+        pdf_op_fstar(ctx, proc);
+        pdf_op_BT(ctx, proc);
+        pdf_op_Tf(ctx, proc, c"F1".as_ptr(), 12.0);
+        pdf_op_Td(ctx, proc, 100.0, 700.0);
+        pdf_op_Tj(ctx, proc, c"Hi".as_ptr(), 2);
+        pdf_op_TJ(ctx, proc);
+        pdf_op_ET(ctx, proc);
+        pdf_op_BMC(ctx, proc, c"Span".as_ptr());
+        pdf_op_EMC(ctx, proc);
+        pdf_op_BI(ctx, proc, 0);
+        pdf_op_Q(ctx, proc);
+
+        let called = PDF_PROCESSORS.get(proc).unwrap();
+        let called = called.lock().unwrap();
+        let names = |p: &PdfProcessor| -> Vec<String> {
+            p.operators.iter().map(|op| op.name.clone()).collect()
+        };
+        assert_eq!(names(&interpreted), names(&called));
+        assert_eq!(
+            format!("{:?}", interpreted.operators),
+            format!("{:?}", called.operators)
+        );
+        assert!(interpreted.gstate_stack.is_empty());
+        drop(called);
+        pdf_drop_processor(ctx, proc);
+    }
+
+    #[test]
+    fn test_interpreter_operands() {
+        let mut proc = PdfProcessor::new(ProcessorType::Run);
+        // Missing and mistyped operands skip the operator
+        assert_eq!(proc.run_contents(b"1 w (x) w 0 m /F1 Tf"), 1);
+        assert!((proc.gstate.line_width - 1.0).abs() < 0.001);
+
+        // Extra leading operands are ignored; SCN takes the numbers above a
+        // pattern name
+        proc.run_contents(b"9 2 w 0.1 0.2 0.3 /P0 scn /P1 SCN");
+        assert!((proc.gstate.line_width - 2.0).abs() < 0.001);
+        assert_eq!(proc.gstate.fill_color, vec![0.1, 0.2, 0.3]);
+        assert_eq!(proc.gstate.stroke_color, vec![0.0]);
+
+        proc.run_contents(b"BT 14 TL (one) ' 1 2 (two) \" ET");
+        assert!((proc.text_state.word_space - 1.0).abs() < 0.001);
+        assert!((proc.text_state.char_space - 2.0).abs() < 0.001);
+        let shown: Vec<_> = proc
+            .operators
+            .iter()
+            .filter(|op| op.name == "Tj")
+            .map(|op| format!("{:?}", op.args))
+            .collect();
+        assert_eq!(shown, [r#"[String("one")]"#, r#"[String("two")]"#]);
+
+        // An operator with more operands than the stack holds is dropped
+        let mut flood = b"0 ".repeat(100);
+        flood.extend_from_slice(b"w");
+        proc.run_contents(&flood);
+        assert!((proc.gstate.line_width - 2.0).abs() < 0.001);
+    }
+
+    #[test]
+    fn test_process_contents_stream() {
+        use crate::ffi::stream::Stream;
+
+        let ctx = 1;
+        let stm = STREAMS.insert(Stream::from_memory(
+            b"q 1 0 0 1 5 5 cm 3 w 0 0 9 9 re f BT /F1 10 Tf (x) Tj ET q q".to_vec(),
+        ));
+        let run = pdf_new_run_processor(ctx, 0, 0, 1.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0, ptr::null());
+        pdf_process_contents(ctx, run, 0, 0, stm, ptr::null_mut());
+        assert_eq!(pdf_processor_get_operator_count(ctx, run), 11);
+        // The stream's unbalanced q leave the caller's state as it was
+        assert_eq!(pdf_processor_get_gstate_depth(ctx, run), 0);
+        assert!((pdf_processor_get_line_width(ctx, run) - 1.0).abs() < 0.001);
+
+        let text = pdf_new_text_processor(ctx, 0, 0, 1.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0, ptr::null());
+        pdf_process_raw_contents(ctx, text, 0, stm);
+        // w, re and f are skipped
+        assert_eq!(pdf_processor_get_operator_count(ctx, text), 8);
+
+        pdf_drop_processor(ctx, run);
+        pdf_drop_processor(ctx, text);
+        STREAMS.remove(stm);
+    }
+
+    #[test]
+    fn test_process_contents_object_replays_program() {
+        use crate::ffi::document::{Document, fz_drop_document};
+        use crate::ffi::pdf_object::create::pdf_new_indirect;
+        use crate::ffi::store::{STORE_TEST_LOCK, fz_store_find};
+
+        let _guard = STORE_TEST_LOCK.lock().unwrap_or_else(|e| e.into_inner());
+
+        let contents = b"q 1 0 0 1 5 5 cm 3 w 0 0 9 9 re f BT /F1 10 Tf (x) Tj ET q q";
+        let mut pdf = b"%PDF-1.4\n4 0 obj\n".to_vec();
+        pdf.extend_from_slice(format!("<< /Length {} >>\nstream\n", contents.len()).as_bytes());
+        pdf.extend_from_slice(contents);
+        pdf.extend_from_slice(b"\nendstream\nendobj\n%%EOF\n");
+        let doc = DOCUMENTS.insert(Document::new(pdf));
+        let stm = pdf_new_indirect(0, doc, 4, 0);
+        let key = content_program_key(doc, 4);
+
+        let ctx = 1;
+        let run = pdf_new_run_processor(ctx, 0, 0, 1.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0, ptr::null());
+        pdf_process_contents(ctx, run, doc, 0, stm, ptr::null_mut());
+        assert_eq!(pdf_processor_get_operator_count(ctx, run), 11);
+        assert_eq!(pdf_processor_get_gstate_depth(ctx, run), 0);
+        assert_ne!(fz_store_find(0, key.as_ptr(), key.len()), 0);
+
+        // Later passes replay the stored program
+        let text = pdf_new_text_processor(ctx, 0, 0, 1.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0, ptr::null());
+        pdf_process_contents(ctx, text, doc, 0, stm, ptr::null_mut());
+        assert_eq!(pdf_processor_get_operator_count(ctx, text), 8);
+        pdf_process_contents(ctx, run, doc, 0, stm, ptr::null_mut());
+        assert_eq!(pdf_processor_get_operator_count(ctx, run), 22);
+
+        // Objects that aren't content streams run nothing
+        let missing = pdf_new_indirect(0, doc, 9, 0);
+        pdf_process_contents(ctx, run, doc, 0, missing, ptr::null_mut());
+        assert_eq!(pdf_processor_get_operator_count(ctx, run), 22);
+
+        // Dropping the document purges its programs
+        fz_drop_document(0, doc);
+        assert_eq!(fz_store_find(0, key.as_ptr(), key.len()), 0);
+        assert_eq!(pdf_purge_content_program_cache(0, doc), 0);
+
+        pdf_drop_processor(ctx, run);
+        pdf_drop_processor(ctx, text);
+    }
+
+    #[test]
+    fn test_tee_processor_fans_out() {
+        use crate::ffi::stream::Stream;
+
+        let ctx = 1;
+        let stm = STREAMS.insert(Stream::from_memory(
+            b"q 1 0 0 1 5 5 cm 3 w 0 0 9 9 re f BT /F1 10 Tf (x) Tj ET q q".to_vec(),
+        ));
+        let run = pdf_new_run_processor(ctx, 0, 0, 1.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0, ptr::null());
+        let text = pdf_new_text_processor(ctx, 0, 0, 1.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0, ptr::null());
+        let buffer = pdf_new_buffer_processor(ctx, 0, 0, 1);
+        let sanitize = pdf_new_sanitize_filter(ctx, 0, buffer, 0, 1.0, 0.0, 0.0, 1.0, 0.0, 0.0);
+        // Nested tees feed their leaves
+        let inner = pdf_new_tee_processor(ctx, [text, sanitize].as_ptr(), 2);
+        let tee = pdf_new_tee_processor(ctx, [run, inner].as_ptr(), 2);
+        assert_eq!(pdf_processor_get_type(ctx, tee), ProcessorType::Tee as i32);
+        assert_eq!(pdf_new_tee_processor(ctx, ptr::null(), 2), 0);
+        assert_eq!(pdf_new_tee_processor(ctx, [run].as_ptr(), 0), 0);
+
+        pdf_process_contents(ctx, tee, 0, 0, stm, ptr::null_mut());
+        assert_eq!(pdf_processor_get_operator_count(ctx, run), 11);
+        assert_eq!(pdf_processor_get_operator_count(ctx, text), 8);
+        assert_eq!(pdf_processor_get_operator_count(ctx, sanitize), 11);
+        assert_eq!(pdf_processor_get_operator_count(ctx, tee), 0);
+        assert_eq!(pdf_processor_get_gstate_depth(ctx, run), 0);
+
+        pdf_process_raw_contents(ctx, tee, 0, stm);
+        assert_eq!(pdf_processor_get_operator_count(ctx, run), 22);
+        assert_eq!(pdf_processor_get_operator_count(ctx, text), 16);
+
+        // Callbacks and resources reach every branch; raw contents leave
+        // the stream's three unbalanced q in place
+        pdf_op_q(ctx, tee);
+        assert_eq!(pdf_processor_get_gstate_depth(ctx, run), 4);
+        assert_eq!(pdf_processor_get_gstate_depth(ctx, sanitize), 4);
+        pdf_processor_push_resources(ctx, tee, 7);
+        assert_eq!(pdf_processor_pop_resources(ctx, text), 7);
+        assert_eq!(pdf_processor_pop_resources(ctx, buffer), 7);
+
+        // The tee owns its branches
+        pdf_drop_processor(ctx, tee);
+        for proc in [run, text, sanitize, buffer, inner] {
+            assert_eq!(pdf_processor_get_type(ctx, proc), 0);
+        }
+        STREAMS.remove(stm);
+    }
+
     #[test]
     fn test_buffer_processor() {
         let ctx = 1;
@@ -2065,6 +3361,31 @@ mod tests {
         pdf_drop_processor(ctx, proc);
     }
 
+    #[test]
+    fn test_buffer_processor_writes_contents() {
+        use crate::ffi::buffer::Buffer;
+        use crate::ffi::stream::Stream;
+
+        let ctx = 1;
+        let stm = STREAMS.insert(Stream::from_memory(
+            b"q 1 0 0 1 5.5 -0.25 cm 0 0 9 9 re f BT /F1 10 Tf [(a) -20 (b)] TJ ET Q".to_vec(),
+        ));
+        let buf = BUFFERS.insert(Buffer::new(0));
+        let proc = pdf_new_buffer_processor(ctx, buf, 0, 1);
+        pdf_process_contents(ctx, proc, 0, 0, stm, ptr::null_mut());
+        pdf_close_processor(ctx, proc);
+
+        let written = BUFFERS.get(buf).unwrap().lock().unwrap().data().to_vec();
+        assert_eq!(
+            String::from_utf8(written).unwrap(),
+            "q\n1 0 0 1 5.5 -0.25 cm\n0 0 9 9 re\nf\nBT\n/F1 10 Tf\n[(a) -20 (b)] TJ\nET\nQ\n"
+        );
+
+        pdf_drop_processor(ctx, proc);
+        BUFFERS.remove(buf);
+        STREAMS.remove(stm);
+    }
+
     #[test]
     fn test_gstate_stack() {
         let ctx = 1;
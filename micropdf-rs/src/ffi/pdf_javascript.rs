@@ -6,6 +6,7 @@
 //! - Handle form field events (validation, keystroke, etc.)
 //! - Event initialization and result retrieval
 
+use crate::ffi::pdf_js_calculate::Calculate;
 use crate::ffi::{Handle, HandleStore};
 use std::collections::HashMap;
 use std::ffi::{CStr, CString, c_char};
@@ -124,6 +125,8 @@ pub struct PdfJs {
     pub console_log: Vec<String>,
     /// Last error message
     pub last_error: Option<String>,
+    /// Field values and calculate scripts
+    pub calculate: Calculate,
 }
 
 /// Document JavaScript state
@@ -158,6 +161,7 @@ impl PdfJs {
             scripts: HashMap::new(),
             console_log: Vec::new(),
             last_error: None,
+            calculate: Calculate::default(),
         }
     }
 
@@ -857,6 +861,105 @@ pub extern "C" fn pdf_js_is_enabled(js: Handle) -> i32 {
     if js_guard.enabled { 1 } else { 0 }
 }
 
+// ============================================================================
+// FFI Functions - Calculations
+// ============================================================================
+
+/// Set the calculate script of a field
+///
+/// Scripts are compiled once per source text and shared by every context,
+/// so documents filled from the same form template compile them once.
+/// Returns 1 if the script was compiled, 0 if it isn't understood (the
+/// field is left without one and the last error says why)
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_js_set_calculate(
+    js: Handle,
+    field: *const c_char,
+    code: *const c_char,
+) -> i32 {
+    let js_arc = match PDF_JS_CONTEXTS.get(js) {
+        Some(j) => j,
+        None => return 0,
+    };
+
+    if field.is_null() || code.is_null() {
+        return 0;
+    }
+
+    let field_str = unsafe { CStr::from_ptr(field) }.to_str().unwrap_or("");
+    let code_str = unsafe { CStr::from_ptr(code) }.to_str().unwrap_or("");
+
+    let mut js_guard = js_arc.lock().unwrap();
+    if js_guard.calculate.set_script(field_str, code_str) {
+        1
+    } else {
+        js_guard.last_error = Some(format!("unsupported calculate script for {}", field_str));
+        0
+    }
+}
+
+/// Set the value of a field and recalculate the fields that depend on it
+///
+/// Only fields downstream of `field` run their calculate scripts, each
+/// after the fields it reads. With JavaScript disabled the value is set
+/// and nothing is recalculated.
+/// Returns the number of fields recalculated, or -1 if the context is invalid
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_js_set_field_value(
+    js: Handle,
+    field: *const c_char,
+    value: *const c_char,
+) -> i32 {
+    let js_arc = match PDF_JS_CONTEXTS.get(js) {
+        Some(j) => j,
+        None => return -1,
+    };
+
+    if field.is_null() {
+        return -1;
+    }
+
+    let field_str = unsafe { CStr::from_ptr(field) }.to_str().unwrap_or("");
+    let value_str = if value.is_null() {
+        ""
+    } else {
+        unsafe { CStr::from_ptr(value) }.to_str().unwrap_or("")
+    };
+
+    let mut js_guard = js_arc.lock().unwrap();
+    if !js_guard.enabled {
+        js_guard.calculate.store(field_str, value_str);
+        return 0;
+    }
+    js_guard.calculate.set_value(field_str, value_str).len() as i32
+}
+
+/// Get the value of a field, as set or calculated
+/// Returns a newly allocated string that must be freed by the caller
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_js_get_field_value(js: Handle, field: *const c_char) -> *mut c_char {
+    let js_arc = match PDF_JS_CONTEXTS.get(js) {
+        Some(j) => j,
+        None => return ptr::null_mut(),
+    };
+
+    if field.is_null() {
+        return ptr::null_mut();
+    }
+
+    let field_str = unsafe { CStr::from_ptr(field) }.to_str().unwrap_or("");
+
+    let js_guard = js_arc.lock().unwrap();
+
+    if let Some(value) = js_guard.calculate.value(field_str) {
+        if let Ok(cstr) = CString::new(value) {
+            return cstr.into_raw();
+        }
+    }
+
+    ptr::null_mut()
+}
+
 // ============================================================================
 // Tests
 // ============================================================================
@@ -1127,4 +1230,44 @@ mod tests {
 
         pdf_drop_js(ctx, js);
     }
+
+    #[test]
+    fn test_calculate_downstream_fields() {
+        let ctx = 1;
+        let doc = 1300;
+
+        let js = pdf_get_js(ctx, doc);
+        let total = CString::new("total").unwrap();
+        let qty = CString::new("qty").unwrap();
+        let price = CString::new("price").unwrap();
+        let script =
+            CString::new("event.value = getField(\"qty\").value * getField(\"price\").value;")
+                .unwrap();
+        assert_eq!(pdf_js_set_calculate(js, total.as_ptr(), script.as_ptr()), 1);
+
+        let junk = CString::new("app.alert(1)").unwrap();
+        assert_eq!(pdf_js_set_calculate(js, qty.as_ptr(), junk.as_ptr()), 0);
+        let error = pdf_js_get_last_error(js);
+        assert!(!error.is_null());
+        pdf_js_free_string(ctx, error);
+
+        let three = CString::new("3").unwrap();
+        let four = CString::new("4").unwrap();
+        assert_eq!(
+            pdf_js_set_field_value(js, price.as_ptr(), three.as_ptr()),
+            1
+        );
+        assert_eq!(pdf_js_set_field_value(js, qty.as_ptr(), four.as_ptr()), 1);
+        assert_eq!(pdf_js_set_field_value(js, total.as_ptr(), four.as_ptr()), 0);
+        assert_eq!(pdf_js_set_field_value(js, qty.as_ptr(), four.as_ptr()), 1);
+
+        let value = pdf_js_get_field_value(js, total.as_ptr());
+        assert_eq!(unsafe { CStr::from_ptr(value) }.to_str().unwrap(), "12");
+        pdf_js_free_string(ctx, value);
+
+        assert!(pdf_js_get_field_value(js, ptr::null()).is_null());
+        assert_eq!(pdf_js_set_field_value(0, qty.as_ptr(), four.as_ptr()), -1);
+
+        pdf_drop_js(ctx, js);
+    }
 }
@@ -0,0 +1,541 @@
+//! Calculate Scripts
+//!
+//! A field's calculate script (its /AA /C action) recomputes the field from
+//! others. Running every calculate script on each field change costs the
+//! whole chain per keystroke; here each script is compiled once into a small
+//! stack program naming the fields it reads, those names make a dependency
+//! graph, and a change recomputes only the fields downstream of it, each
+//! after every field it reads.
+//!
+//! Compiled programs are shared by source text across contexts, so
+//! documents filled from the same form template compile its scripts once.
+//! The scripts understood are the two shapes form tools generate:
+//! `AFSimple_Calculate("SUM", new Array("a", "b"))` (also PRD, AVG, MIN and
+//! MAX) and `event.value = <arithmetic over getField("x").value>`.
+
+use std::collections::{BTreeMap, HashMap, HashSet};
+use std::sync::{Arc, LazyLock, Mutex};
+
+/// One step of a compiled calculate script
+#[derive(Debug, Clone, Copy, PartialEq)]
+enum Op {
+    Push(f64),
+    /// Value of input `n`
+    Field(usize),
+    Add,
+    Sub,
+    Mul,
+    Div,
+    Neg,
+    Min,
+    Max,
+}
+
+/// A compiled calculate script
+#[derive(Debug, PartialEq)]
+pub struct Program {
+    /// Fields the script reads, by full name
+    inputs: Vec<String>,
+    code: Vec<Op>,
+}
+
+/// Compiled programs by source text; `None` for scripts not understood
+static PROGRAMS: LazyLock<Mutex<HashMap<String, Option<Arc<Program>>>>> =
+    LazyLock::new(|| Mutex::new(HashMap::new()));
+
+#[derive(Debug, Clone, PartialEq)]
+enum Token {
+    Number(f64),
+    Str(String),
+    Ident(String),
+    Punct(char),
+}
+
+fn tokenize(source: &str) -> Option<Vec<Token>> {
+    let mut tokens = Vec::new();
+    let mut chars = source.char_indices().peekable();
+    while let Some(&(start, c)) = chars.peek() {
+        if c.is_whitespace() {
+            chars.next();
+        } else if c.is_ascii_digit()
+            || (c == '.' && source[start + 1..].starts_with(|d: char| d.is_ascii_digit()))
+        {
+            let mut end = start;
+            while let Some(&(i, d)) = chars.peek() {
+                if !(d.is_ascii_digit() || d == '.') {
+                    break;
+                }
+                end = i + d.len_utf8();
+                chars.next();
+            }
+            tokens.push(Token::Number(source[start..end].parse().ok()?));
+        } else if c == '"' || c == '\'' {
+            chars.next();
+            let mut text = String::new();
+            loop {
+                let (_, d) = chars.next()?;
+                match d {
+                    _ if d == c => break,
+                    '\\' => text.push(chars.next()?.1),
+                    _ => text.push(d),
+                }
+            }
+            tokens.push(Token::Str(text));
+        } else if c.is_alphabetic() || c == '_' || c == '$' {
+            let mut end = start;
+            while let Some(&(i, d)) = chars.peek() {
+                if !(d.is_alphanumeric() || d == '_' || d == '$') {
+                    break;
+                }
+                end = i + d.len_utf8();
+                chars.next();
+            }
+            tokens.push(Token::Ident(source[start..end].to_string()));
+        } else if "()[],.;=+-*/".contains(c) {
+            tokens.push(Token::Punct(c));
+            chars.next();
+        } else {
+            return None;
+        }
+    }
+    Some(tokens)
+}
+
+/// Recursive-descent compiler over the tokens of one script
+struct Compiler {
+    tokens: Vec<Token>,
+    pos: usize,
+    inputs: Vec<String>,
+    code: Vec<Op>,
+}
+
+impl Compiler {
+    fn peek(&self) -> Option<&Token> {
+        self.tokens.get(self.pos)
+    }
+
+    fn eat(&mut self, token: &Token) -> bool {
+        if self.peek() == Some(token) {
+            self.pos += 1;
+            true
+        } else {
+            false
+        }
+    }
+
+    fn eat_punct(&mut self, c: char) -> bool {
+        self.eat(&Token::Punct(c))
+    }
+
+    fn eat_ident(&mut self, name: &str) -> bool {
+        self.eat(&Token::Ident(name.to_string()))
+    }
+
+    fn string(&mut self) -> Option<String> {
+        match self.peek()? {
+            Token::Str(s) => {
+                let s = s.clone();
+                self.pos += 1;
+                Some(s)
+            }
+            _ => None,
+        }
+    }
+
+    fn input(&mut self, name: &str) -> usize {
+        let name = name.trim();
+        match self.inputs.iter().position(|n| n == name) {
+            Some(i) => i,
+            None => {
+                self.inputs.push(name.to_string());
+                self.inputs.len() - 1
+            }
+        }
+    }
+
+    /// `[this.]getField("name").value`
+    fn field_ref(&mut self) -> Option<()> {
+        if self.eat_ident("this") && !self.eat_punct('.') {
+            return None;
+        }
+        if !(self.eat_ident("getField") && self.eat_punct('(')) {
+            return None;
+        }
+        let name = self.string()?;
+        if !(self.eat_punct(')') && self.eat_punct('.') && self.eat_ident("value")) {
+            return None;
+        }
+        let i = self.input(&name);
+        self.code.push(Op::Field(i));
+        Some(())
+    }
+
+    fn primary(&mut self) -> Option<()> {
+        match self.peek()? {
+            Token::Number(n) => {
+                self.code.push(Op::Push(*n));
+                self.pos += 1;
+            }
+            Token::Punct('(') => {
+                self.pos += 1;
+                self.expression()?;
+                if !self.eat_punct(')') {
+                    return None;
+                }
+            }
+            Token::Punct('-') => {
+                self.pos += 1;
+                self.primary()?;
+                self.code.push(Op::Neg);
+            }
+            Token::Punct('+') => {
+                self.pos += 1;
+                self.primary()?;
+            }
+            Token::Ident(_) => self.field_ref()?,
+            _ => return None,
+        }
+        Some(())
+    }
+
+    fn term(&mut self) -> Option<()> {
+        self.primary()?;
+        loop {
+            let op = match self.peek() {
+                Some(Token::Punct('*')) => Op::Mul,
+                Some(Token::Punct('/')) => Op::Div,
+                _ => return Some(()),
+            };
+            self.pos += 1;
+            self.primary()?;
+            self.code.push(op);
+        }
+    }
+
+    fn expression(&mut self) -> Option<()> {
+        self.term()?;
+        loop {
+            let op = match self.peek() {
+                Some(Token::Punct('+')) => Op::Add,
+                Some(Token::Punct('-')) => Op::Sub,
+                _ => return Some(()),
+            };
+            self.pos += 1;
+            self.term()?;
+            self.code.push(op);
+        }
+    }
+
+    /// `AFSimple_Calculate("OP", new Array("a", ...))`, past the name
+    fn simple_calculate(&mut self) -> Option<()> {
+        if !self.eat_punct('(') {
+            return None;
+        }
+        let op = self.string()?;
+        if !self.eat_punct(',') {
+            return None;
+        }
+        let mut names = Vec::new();
+        let close = if self.eat_ident("new") {
+            if !(self.eat_ident("Array") && self.eat_punct('(')) {
+                return None;
+            }
+            ')'
+        } else if self.eat_punct('[') {
+            ']'
+        } else {
+            // A single string of comma separated names
+            names.extend(self.string()?.split(',').map(str::to_string));
+            '\0'
+        };
+        if close != '\0' {
+            while !self.eat_punct(close) {
+                names.push(self.string()?);
+                if !self.eat_punct(',') && self.peek() != Some(&Token::Punct(close)) {
+                    return None;
+                }
+            }
+        }
+        if !self.eat_punct(')') || names.is_empty() {
+            return None;
+        }
+        let combine = match op.as_str() {
+            "SUM" | "AVG" => Op::Add,
+            "PRD" => Op::Mul,
+            "MIN" => Op::Min,
+            "MAX" => Op::Max,
+            _ => return None,
+        };
+        for (k, name) in names.iter().enumerate() {
+            let i = self.input(name);
+            self.code.push(Op::Field(i));
+            if k > 0 {
+                self.code.push(combine);
+            }
+        }
+        if op == "AVG" {
+            self.code.push(Op::Push(names.len() as f64));
+            self.code.push(Op::Div);
+        }
+        Some(())
+    }
+
+    fn script(mut self) -> Option<Program> {
+        if self.eat_ident("AFSimple_Calculate") {
+            self.simple_calculate()?;
+        } else {
+            if !(self.eat_ident("event") && self.eat_punct('.') && self.eat_ident("value")) {
+                return None;
+            }
+            if !self.eat_punct('=') {
+                return None;
+            }
+            self.expression()?;
+        }
+        self.eat_punct(';');
+        if self.pos != self.tokens.len() {
+            return None;
+        }
+        Some(Program {
+            inputs: self.inputs,
+            code: self.code,
+        })
+    }
+}
+
+/// The compiled program of calculate script `source`, compiling it on
+/// first use by any context
+pub fn compile(source: &str) -> Option<Arc<Program>> {
+    let source = source.trim();
+    if let Some(program) = PROGRAMS.lock().unwrap().get(source) {
+        return program.clone();
+    }
+    let program = tokenize(source)
+        .and_then(|tokens| {
+            Compiler {
+                tokens,
+                pos: 0,
+                inputs: Vec::new(),
+                code: Vec::new(),
+            }
+            .script()
+        })
+        .map(Arc::new);
+    PROGRAMS
+        .lock()
+        .unwrap()
+        .insert(source.to_string(), program.clone());
+    program
+}
+
+impl Program {
+    /// Run over the current field values; a value that isn't a number
+    /// counts as 0, as with AFMakeNumber
+    fn run(&self, values: &HashMap<String, String>) -> String {
+        let mut stack: Vec<f64> = Vec::with_capacity(self.code.len());
+        for op in &self.code {
+            let value = match *op {
+                Op::Push(n) => n,
+                Op::Field(i) => values
+                    .get(&self.inputs[i])
+                    .and_then(|v| v.trim().parse().ok())
+                    .unwrap_or(0.0),
+                Op::Neg => -stack.pop().unwrap_or(0.0),
+                _ => {
+                    let b = stack.pop().unwrap_or(0.0);
+                    let a = stack.pop().unwrap_or(0.0);
+                    match op {
+                        Op::Add => a + b,
+                        Op::Sub => a - b,
+                        Op::Mul => a * b,
+                        Op::Div => a / b,
+                        Op::Min => a.min(b),
+                        _ => a.max(b),
+                    }
+                }
+            };
+            stack.push(value);
+        }
+        match stack.pop().unwrap_or(0.0) {
+            n if n.is_nan() => "NaN".to_string(),
+            n if n.is_infinite() && n > 0.0 => "Infinity".to_string(),
+            n if n.is_infinite() => "-Infinity".to_string(),
+            n => n.to_string(),
+        }
+    }
+}
+
+/// Field values and calculate scripts of one JavaScript context
+#[derive(Debug, Default)]
+pub struct Calculate {
+    /// Calculate program of each field, with its place in calculation order
+    programs: HashMap<String, (usize, Arc<Program>)>,
+    values: HashMap<String, String>,
+    /// Fields reading each field; rebuilt after scripts change
+    dependents: Option<HashMap<String, Vec<String>>>,
+}
+
+impl Calculate {
+    /// Set the calculate script of `field`; returns false, leaving the
+    /// field without one, if the script isn't understood
+    pub fn set_script(&mut self, field: &str, source: &str) -> bool {
+        self.dependents = None;
+        let Some(program) = compile(source) else {
+            self.programs.remove(field);
+            return false;
+        };
+        let rank = self
+            .programs
+            .get(field)
+            .map_or(self.programs.len(), |(rank, _)| *rank);
+        self.programs.insert(field.to_string(), (rank, program));
+        true
+    }
+
+    /// Current value of `field`
+    pub fn value(&self, field: &str) -> Option<&str> {
+        self.values.get(field).map(String::as_str)
+    }
+
+    /// Set the value of `field` without recomputing anything
+    pub fn store(&mut self, field: &str, value: &str) {
+        self.values.insert(field.to_string(), value.to_string());
+    }
+
+    /// Set the value of `field` and recompute the fields downstream of it
+    ///
+    /// Returns the recomputed fields in the order they ran: each after the
+    /// fields it reads, ties and cycles in calculation order.
+    pub fn set_value(&mut self, field: &str, value: &str) -> Vec<String> {
+        self.store(field, value);
+        let dependents = self.dependents.get_or_insert_with(|| {
+            let mut graph: HashMap<String, Vec<String>> = HashMap::new();
+            for (name, (_, program)) in &self.programs {
+                for input in &program.inputs {
+                    graph.entry(input.clone()).or_default().push(name.clone());
+                }
+            }
+            graph
+        });
+
+        // Everything reachable from the change; the changed field itself
+        // keeps the value it was given
+        let mut downstream: HashSet<&str> = HashSet::new();
+        let mut stack = vec![field];
+        while let Some(name) = stack.pop() {
+            for next in dependents.get(name).into_iter().flatten() {
+                if next != field && downstream.insert(next) {
+                    stack.push(next);
+                }
+            }
+        }
+
+        // Kahn's algorithm over the downstream fields
+        let mut pending: HashMap<&str, usize> = downstream
+            .iter()
+            .map(|&name| {
+                let program = &self.programs[name].1;
+                let count = program
+                    .inputs
+                    .iter()
+                    .filter(|i| downstream.contains(i.as_str()))
+                    .count();
+                (name, count)
+            })
+            .collect();
+        let mut ready: BTreeMap<usize, &str> = pending
+            .iter()
+            .filter(|&(_, &count)| count == 0)
+            .map(|(&name, _)| (self.programs[name].0, name))
+            .collect();
+        let mut order = Vec::with_capacity(downstream.len());
+        loop {
+            let next = match ready.pop_first() {
+                Some((_, name)) => name,
+                // A cycle: run its first field in calculation order
+                None => match pending.keys().min_by_key(|&&name| self.programs[name].0) {
+                    Some(&name) => name,
+                    None => break,
+                },
+            };
+            if pending.remove(next).is_none() {
+                continue;
+            }
+            order.push(next.to_string());
+            for dependent in dependents.get(next).into_iter().flatten() {
+                if let Some(count) = pending.get_mut(dependent.as_str()) {
+                    *count = count.saturating_sub(1);
+                    if *count == 0 {
+                        ready.insert(self.programs[dependent.as_str()].0, dependent.as_str());
+                    }
+                }
+            }
+        }
+
+        for name in &order {
+            let result = self.programs[name].1.run(&self.values);
+            self.values.insert(name.clone(), result);
+        }
+        order
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_compiled_once_per_source() {
+        let a = compile("AFSimple_Calculate(\"SUM\", new Array(\"x\", \"y\"));").unwrap();
+        let b = compile("  AFSimple_Calculate(\"SUM\", new Array(\"x\", \"y\"));").unwrap();
+        assert!(Arc::ptr_eq(&a, &b));
+        assert_eq!(a.inputs, ["x", "y"]);
+
+        let product =
+            compile("event.value = this.getField(\"qty\").value * (1 + getField(\"tax\").value);")
+                .unwrap();
+        assert_eq!(product.inputs, ["qty", "tax"]);
+        assert!(compile("app.alert('hi')").is_none());
+    }
+
+    #[test]
+    fn test_only_downstream_fields_recompute() {
+        let mut calc = Calculate::default();
+        assert!(calc.set_script(
+            "total",
+            "AFSimple_Calculate(\"SUM\", [\"line1\", \"line2\"])"
+        ));
+        assert!(calc.set_script(
+            "line1",
+            "event.value = getField(\"qty1\").value * getField(\"price1\").value"
+        ));
+        assert!(calc.set_script(
+            "line2",
+            "event.value = getField(\"qty2\").value * getField(\"price2\").value"
+        ));
+        assert!(calc.set_script("avg", "AFSimple_Calculate(\"AVG\", \"qty1, qty2\")"));
+
+        calc.set_value("price1", "2.5");
+        calc.set_value("price2", "10");
+        assert_eq!(calc.set_value("qty1", "4"), ["line1", "total", "avg"]);
+        assert_eq!(calc.value("total"), Some("10"));
+        assert_eq!(calc.value("avg"), Some("2"));
+
+        // line1 and avg don't read qty2's price
+        assert_eq!(calc.set_value("price2", "3"), ["line2", "total"]);
+        assert_eq!(calc.set_value("qty2", "2"), ["line2", "total", "avg"]);
+        assert_eq!(calc.value("total"), Some("16"));
+        assert!(calc.set_value("unrelated", "1").is_empty());
+    }
+
+    #[test]
+    fn test_cycles_run_once() {
+        let mut calc = Calculate::default();
+        calc.set_script("a", "event.value = getField(\"b\").value + 1");
+        calc.set_script("b", "event.value = getField(\"a\").value + 1");
+        assert_eq!(calc.set_value("c", "0"), Vec::<String>::new());
+        assert_eq!(calc.set_value("a", "1"), ["b"]);
+        assert_eq!(calc.value("b"), Some("2"));
+        assert_eq!(calc.value("a"), Some("1"));
+    }
+}
@@ -4,7 +4,7 @@
 //! layers of content to be selectively shown or hidden.
 
 use crate::ffi::{Handle, HandleStore};
-use std::collections::HashMap;
+use std::collections::{HashMap, HashSet};
 use std::ffi::{CStr, CString, c_char};
 use std::ptr;
 use std::sync::{Arc, LazyLock, Mutex};
@@ -237,6 +237,19 @@ impl OcgDescriptor {
 pub static OCG_STORE: LazyLock<Mutex<HashMap<DocumentHandle, OcgDescriptor>>> =
     LazyLock::new(|| Mutex::new(HashMap::new()));
 
+/// Names of the document's disabled layers, for replaying display lists
+/// under its current layer configuration
+pub(crate) fn hidden_layers(doc: DocumentHandle) -> HashSet<String> {
+    let store = OCG_STORE.lock().unwrap();
+    store.get(&doc).map_or_else(HashSet::new, |ocg| {
+        ocg.layers
+            .iter()
+            .filter(|l| !l.enabled)
+            .map(|l| l.name.clone())
+            .collect()
+    })
+}
+
 // ============================================================================
 // FFI Functions - Layer Count and Enumeration
 // ============================================================================
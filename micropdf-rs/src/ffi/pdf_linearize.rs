@@ -0,0 +1,534 @@
+//! Linearization
+//!
+//! Writes a document in the layout of ISO 32000-1 Annex F, so a viewer
+//! fetching it over a network can show the first page before the rest
+//! arrives and jump to later pages through the hint stream. In file
+//! order: the linearization dictionary, the first-page xref section, the
+//! catalog and page tree, the hint stream, the first page's objects, each
+//! later page's own objects, objects several later pages share, the rest,
+//! and the main xref covering everything after the first page.
+//!
+//! Objects are read once. The walk that assigns each object to the first
+//! page reaching it also holds the values; every object's serialized size
+//! is then known, so offsets, the hint tables and the fixed-width fields
+//! of the linearization dictionary are computed before anything is
+//! written, and the file goes out front to back through a sink with no
+//! second pass or patching. Stream data is passed through untouched, so
+//! the cost is that of a plain copy.
+
+use super::mmap::FileBytes;
+use super::pdf_gc::sweep;
+use super::pdf_parse::ParsedValue;
+use super::pdf_write::{
+    Counting, PdfSink, is_layout_object, open_source, set_key, write_value_with,
+};
+use super::pdf_xref_lazy::{as_ref, collect_refs, dict_get, is_name};
+use bytes::Bytes;
+use std::collections::hash_map::Entry;
+use std::collections::{HashMap, HashSet};
+use std::io;
+use std::sync::Arc;
+
+const STREAM_TAIL: &[u8] = b"\nendstream\nendobj\n";
+
+/// An object as read, with the uses its walk follows
+struct Source {
+    value: ParsedValue,
+    stream: Option<Bytes>,
+    refs: Vec<i32>,
+}
+
+/// An object serialized under its new number
+struct Rendered {
+    /// Everything up to the stream data, or the whole object
+    head: Vec<u8>,
+    stream: Option<Bytes>,
+}
+
+impl Rendered {
+    fn len(&self) -> usize {
+        self.head.len()
+            + self
+                .stream
+                .as_ref()
+                .map_or(0, |s| s.len() + STREAM_TAIL.len())
+    }
+
+    fn write<S: PdfSink>(self, out: &mut Counting<S>) -> io::Result<()> {
+        out.put(&self.head)?;
+        if let Some(data) = self.stream {
+            out.put_bytes(data)?;
+            out.put(STREAM_TAIL)?;
+        }
+        Ok(())
+    }
+}
+
+/// Object numbers in file order, by part of the layout
+struct Layout {
+    /// Catalog and page tree nodes
+    document: Vec<i32>,
+    /// First page, its page object first, with everything it uses
+    first_page: Vec<i32>,
+    /// Each later page's own objects, page object first
+    pages: Vec<Vec<i32>>,
+    /// Objects later pages share, that the first page doesn't use
+    shared: Vec<i32>,
+    other: Vec<i32>,
+}
+
+/// Assign every object to its part, walking each page's uses in one pass
+fn layout(objects: &HashMap<i32, Source>, root: i32, pages: &[i32]) -> Layout {
+    let mut document: Vec<i32> = objects
+        .iter()
+        .filter(|&(&num, o)| num != root && is_name(dict_get(&o.value, "Type"), "Pages"))
+        .map(|(&num, _)| num)
+        .collect();
+    document.sort_unstable();
+    document.insert(0, root);
+    let in_document: HashSet<i32> = document.iter().copied().collect();
+    let page_index: HashMap<i32, usize> = pages.iter().zip(0..).map(|(&n, i)| (n, i)).collect();
+
+    // Each object goes to the first page whose walk reaches it; a later
+    // page reaching it makes it shared, and its own uses stay where they
+    // are, so every object is expanded once
+    let mut owner = HashMap::new();
+    let mut shared = HashSet::new();
+    let mut order = vec![Vec::new(); pages.len()];
+    for (i, &page) in pages.iter().enumerate() {
+        let mut stack = vec![page];
+        while let Some(num) = stack.pop() {
+            if in_document.contains(&num) || page_index.get(&num).is_some_and(|&p| p != i) {
+                continue;
+            }
+            let Some(object) = objects.get(&num) else {
+                continue;
+            };
+            match owner.entry(num) {
+                Entry::Occupied(first) => {
+                    if *first.get() != i {
+                        shared.insert(num);
+                    }
+                }
+                Entry::Vacant(slot) => {
+                    slot.insert(i);
+                    order[i].push(num);
+                    stack.extend(object.refs.iter().rev());
+                }
+            }
+        }
+    }
+
+    let mut order = order.into_iter();
+    let first_page = order.next().unwrap_or_default();
+    let (pages, shared): (Vec<Vec<i32>>, Vec<Vec<i32>>) = order
+        .map(|nums| nums.into_iter().partition(|n| !shared.contains(n)))
+        .unzip();
+    let mut other: Vec<i32> = objects
+        .keys()
+        .copied()
+        .filter(|n| !in_document.contains(n) && !owner.contains_key(n))
+        .collect();
+    other.sort_unstable();
+    Layout {
+        document,
+        first_page,
+        pages,
+        shared: shared.concat(),
+        other,
+    }
+}
+
+/// Big-endian bit writer for hint tables
+#[derive(Default)]
+struct BitWriter {
+    data: Vec<u8>,
+    bit: usize,
+}
+
+impl BitWriter {
+    fn write(&mut self, value: u64, bits: u32) {
+        for i in (0..bits).rev() {
+            if self.bit % 8 == 0 {
+                self.data.push(0);
+            }
+            if (value >> i) & 1 != 0 {
+                *self.data.last_mut().expect("byte pushed") |= 0x80 >> (self.bit % 8);
+            }
+            self.bit += 1;
+        }
+    }
+
+    /// Pad to the next byte boundary
+    fn sync(&mut self) {
+        self.bit = self.bit.div_ceil(8) * 8;
+    }
+}
+
+/// Bits needed for the largest of `values` less the smallest, and the
+/// smallest
+fn spread(values: &[usize]) -> (usize, u32) {
+    let least = values.iter().copied().min().unwrap_or(0);
+    let most = values.iter().copied().max().unwrap_or(0);
+    (least, usize::BITS - (most - least).leading_zeros())
+}
+
+/// Offsets and lengths the hint tables describe, measured as if the hint
+/// stream weren't in the file
+struct Hints {
+    /// Objects and bytes of each page, the first page's running from its
+    /// page object to the end of its section
+    page_objects: Vec<usize>,
+    page_lens: Vec<usize>,
+    first_page_at: usize,
+    /// New number and offset of the first shared object, and each one's
+    /// length
+    shared_num: i32,
+    shared_at: usize,
+    shared_lens: Vec<usize>,
+}
+
+/// Page offset and shared object hint tables (ISO 32000-1, F.4), with the
+/// shared table's offset in the data
+///
+/// Pages list no shared object references, so each page's entry is its
+/// object count and length; content stream items take no bits either.
+fn hint_tables(hints: &Hints) -> (Vec<u8>, usize) {
+    let mut w = BitWriter::default();
+    let (least_objects, object_bits) = spread(&hints.page_objects);
+    let (least_len, len_bits) = spread(&hints.page_lens);
+    w.write(least_objects as u64, 32);
+    w.write(hints.first_page_at as u64, 32);
+    w.write(u64::from(object_bits), 16);
+    w.write(least_len as u64, 32);
+    w.write(u64::from(len_bits), 16);
+    for bits in [32, 16, 32, 16, 16, 16, 16] {
+        w.write(0, bits);
+    }
+    // Denominator of the (unused) fractional positions
+    w.write(1, 16);
+    for &n in &hints.page_objects {
+        w.write((n - least_objects) as u64, object_bits);
+    }
+    w.sync();
+    for &len in &hints.page_lens {
+        w.write((len - least_len) as u64, len_bits);
+    }
+    w.sync();
+
+    let shared_table = w.data.len();
+    let (least_shared, shared_bits) = spread(&hints.shared_lens);
+    let groups = hints.shared_lens.len() as u64;
+    w.write(hints.shared_num.max(0) as u64, 32);
+    w.write(hints.shared_at as u64, 32);
+    w.write(0, 32);
+    w.write(groups, 32);
+    w.write(0, 16);
+    w.write(least_shared as u64, 32);
+    w.write(u64::from(shared_bits), 16);
+    for &len in &hints.shared_lens {
+        w.write((len - least_shared) as u64, shared_bits);
+    }
+    w.sync();
+    // No group carries an MD5 signature
+    for _ in 0..groups {
+        w.write(0, 1);
+    }
+    w.sync();
+    (w.data, shared_table)
+}
+
+/// Append `value` with references renumbered; references to objects not
+/// written become null
+fn put_value(value: &ParsedValue, numbering: &HashMap<i32, i32>, out: &mut Vec<u8>) {
+    write_value_with(value, out, &mut |num, _, out| match numbering.get(&num) {
+        Some(new) => out.extend_from_slice(format!("{new} 0 R").as_bytes()),
+        None => out.extend_from_slice(b"null"),
+    });
+}
+
+fn render(num: i32, object: Source, numbering: &HashMap<i32, i32>) -> Rendered {
+    let mut head = format!("{num} 0 obj\n").into_bytes();
+    put_value(&object.value, numbering, &mut head);
+    match object.stream {
+        Some(_) => head.extend_from_slice(b"\nstream\n"),
+        None => head.extend_from_slice(b"\nendobj\n"),
+    }
+    Rendered {
+        head,
+        stream: object.stream,
+    }
+}
+
+/// Linearization dictionary, fixed width whatever the values
+fn lin_dict(num: i32, pages: usize, first_page: i32, at: [usize; 5]) -> Vec<u8> {
+    let [len, hint_at, hint_len, first_end, main] = at;
+    format!(
+        "{num} 0 obj\n<< /Linearized 1 /L {len:010} /H [{hint_at:010} {hint_len:010}] /O {first_page} /E {first_end:010} /N {pages} /T {main:010} >>\nendobj\n"
+    )
+    .into_bytes()
+}
+
+/// Write the document in `data` out linearized
+///
+/// Returns `None` if the document can't be read, has no pages, or is
+/// encrypted (renumbering would break its object keys).
+pub fn linearize_document<S: PdfSink>(
+    data: Arc<FileBytes>,
+    threads: usize,
+    out: S,
+) -> Option<io::Result<()>> {
+    let mut xref = open_source(&data, threads)?;
+    xref.read_all_sections();
+    let trailer = xref.source_trailer()?.clone();
+    if dict_get(&trailer, "Encrypt").is_some() {
+        return None;
+    }
+    let root = dict_get(&trailer, "Root").and_then(as_ref)?;
+    let pages: Vec<i32> = (0..).map_while(|i| xref.lazy_page_object(i)).collect();
+    if pages.is_empty() {
+        return None;
+    }
+
+    let mut objects = HashMap::new();
+    for num in sweep(&xref, None, threads) {
+        let Some(fetched) = xref.fetch(num) else {
+            continue;
+        };
+        if is_layout_object(&fetched.value) {
+            continue;
+        }
+        let mut value = fetched.value;
+        if let Some(stream) = &fetched.stream {
+            set_key(
+                &mut value,
+                "Length",
+                Some(ParsedValue::Int(stream.len() as i64)),
+            );
+        }
+        let mut refs = Vec::new();
+        collect_refs(&value, &mut refs);
+        objects.insert(
+            num,
+            Source {
+                value,
+                stream: fetched.stream,
+                refs,
+            },
+        );
+    }
+    if !objects.contains_key(&root) {
+        return None;
+    }
+    let layout = layout(&objects, root, &pages);
+
+    // Later parts take the low numbers, for the main xref, and the first
+    // page's section the high ones
+    let main: Vec<i32> = layout
+        .pages
+        .iter()
+        .flatten()
+        .chain(&layout.shared)
+        .chain(&layout.other)
+        .copied()
+        .collect();
+    let mut numbering: HashMap<i32, i32> = main.iter().zip(1..).map(|(&n, new)| (n, new)).collect();
+    let lin_num = main.len() as i32 + 1;
+    let hint_num = lin_num + 1 + layout.document.len() as i32;
+    let first: Vec<i32> = layout
+        .document
+        .iter()
+        .chain(&layout.first_page)
+        .copied()
+        .collect();
+    for (&num, new) in layout.document.iter().zip(lin_num + 1..) {
+        numbering.insert(num, new);
+    }
+    for (&num, new) in layout.first_page.iter().zip(hint_num + 1..) {
+        numbering.insert(num, new);
+    }
+    let size = lin_num + 2 + first.len() as i32;
+
+    let mut render_all = |nums: &[i32]| -> Vec<Rendered> {
+        nums.iter()
+            .map(|num| {
+                let object = objects.remove(num).expect("laid out once");
+                render(numbering[num], object, &numbering)
+            })
+            .collect()
+    };
+    let document = render_all(&layout.document);
+    let first_page = render_all(&layout.first_page);
+    let later: Vec<Vec<Rendered>> = layout.pages.iter().map(|p| render_all(p)).collect();
+    let shared = render_all(&layout.shared);
+    let other = render_all(&layout.other);
+    let sum = |objects: &[Rendered]| objects.iter().map(Rendered::len).sum::<usize>();
+
+    // First-page trailer, waiting for the main xref's offset
+    let mut trailer_head = format!("trailer\n<< /Size {size} /Root {} 0 R", numbering[&root]);
+    let mut extra = Vec::new();
+    for key in ["Info", "ID"] {
+        if let Some(value) = dict_get(&trailer, key) {
+            extra.extend_from_slice(format!(" /{key} ").as_bytes());
+            put_value(value, &numbering, &mut extra);
+        }
+    }
+    trailer_head.push_str(&String::from_utf8_lossy(&extra));
+    let first_xref = |offsets: &[usize], main_at: usize| {
+        let mut s = format!("xref\n{lin_num} {}\n", size - lin_num);
+        for offset in offsets {
+            s += &format!("{offset:010} 00000 n \n");
+        }
+        s += &format!("{trailer_head} /Prev {main_at:010} >>\nstartxref\n0\n%%EOF\n");
+        s.into_bytes()
+    };
+    let first_count = (size - lin_num) as usize;
+
+    let version = xref.version;
+    let first_page_obj = numbering[&pages[0]];
+    let mut out = Counting::new(out);
+    Some((|| {
+        out.put_header(version)?;
+
+        // Positions as if the hint stream weren't there
+        let lin_at = out.pos;
+        let lin_len = lin_dict(lin_num, pages.len(), first_page_obj, [0; 5]).len();
+        let first_xref_at = lin_at + lin_len;
+        let hint_at = first_xref_at + first_xref(&vec![0; first_count], 0).len() + sum(&document);
+        let page_lens: Vec<usize> = std::iter::once(sum(&first_page))
+            .chain(later.iter().map(|p| sum(p)))
+            .collect();
+        let shared_at = hint_at + page_lens.iter().sum::<usize>();
+        let hints = Hints {
+            page_objects: std::iter::once(first_page.len())
+                .chain(later.iter().map(Vec::len))
+                .collect(),
+            page_lens,
+            first_page_at: hint_at,
+            shared_num: layout.shared.first().map_or(0, |n| numbering[n]),
+            shared_at,
+            shared_lens: shared.iter().map(Rendered::len).collect(),
+        };
+        let (table, shared_table) = hint_tables(&hints);
+        let mut hint_head = format!(
+            "{hint_num} 0 obj\n<< /Length {} /S {shared_table} >>\nstream\n",
+            table.len()
+        )
+        .into_bytes();
+        hint_head.extend_from_slice(&table);
+        hint_head.extend_from_slice(STREAM_TAIL);
+        let hint = hint_head;
+
+        // Real offsets
+        let mut offsets = vec![0; size as usize];
+        offsets[lin_num as usize] = lin_at;
+        let mut at = hint_at - sum(&document);
+        for (object, &num) in document.iter().zip(&layout.document) {
+            offsets[numbering[&num] as usize] = at;
+            at += object.len();
+        }
+        offsets[hint_num as usize] = at;
+        at += hint.len();
+        let main_parts = later.iter().flatten().chain(&shared).chain(&other);
+        for (object, &num) in first_page.iter().zip(&layout.first_page) {
+            offsets[numbering[&num] as usize] = at;
+            at += object.len();
+        }
+        let first_end = at;
+        for (object, &num) in main_parts.zip(&main) {
+            offsets[numbering[&num] as usize] = at;
+            at += object.len();
+        }
+        let main_at = at;
+        let entries_at = main_at + format!("xref\n0 {lin_num}").len();
+        let mut main_xref = format!("xref\n0 {lin_num}\n0000000000 65535 f \n");
+        for offset in &offsets[1..lin_num as usize] {
+            main_xref += &format!("{offset:010} 00000 n \n");
+        }
+        main_xref +=
+            &format!("trailer\n<< /Size {lin_num} >>\nstartxref\n{first_xref_at}\n%%EOF\n");
+        let file_len = main_at + main_xref.len();
+
+        let lin = lin_dict(
+            lin_num,
+            pages.len(),
+            first_page_obj,
+            [file_len, hint_at, hint.len(), first_end, entries_at],
+        );
+        debug_assert_eq!(lin.len(), lin_len);
+        out.put(&lin)?;
+        out.put(&first_xref(&offsets[lin_num as usize..], main_at))?;
+        for object in document {
+            object.write(&mut out)?;
+        }
+        out.put(&hint)?;
+        for object in first_page.into_iter().chain(later.into_iter().flatten()) {
+            object.write(&mut out)?;
+        }
+        for object in shared.into_iter().chain(other) {
+            object.write(&mut out)?;
+        }
+        out.put(main_xref.as_bytes())?;
+        debug_assert_eq!(out.pos, file_len);
+        out.inner.finish()
+    })())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::super::pdf_xref::Xref;
+    use super::super::pdf_xref_lazy::tests::sample_pdf;
+    use super::super::pdf_xref_lazy::{decode_stream, linearization, read_stream_at};
+    use super::super::range_source::page_ranges;
+    use super::*;
+
+    fn linearized() -> Vec<u8> {
+        let mut out = Vec::new();
+        linearize_document(Arc::new(sample_pdf().into()), 2, &mut out)
+            .unwrap()
+            .unwrap();
+        out
+    }
+
+    #[test]
+    fn test_linearized_layout_reads_back() {
+        let pdf = linearized();
+        let lin = linearization(&pdf).unwrap();
+        assert_eq!(lin.file_len, pdf.len());
+        assert_eq!(lin.page_count, 2);
+        let lead = &pdf[lin.main_xref - 16..lin.main_xref];
+        assert!(lead.windows(7).any(|w| w == b"xref\n0 "));
+        assert_eq!(pdf[lin.main_xref], b'\n');
+
+        let mut xref = Xref::open_lazy(0, Arc::new(pdf.clone().into())).unwrap();
+        assert_eq!(xref.lazy_page_object(0), Some(lin.first_page_obj));
+        let page = xref.fetch(lin.first_page_obj).unwrap().value;
+        let contents = dict_get(&page, "Contents").and_then(as_ref).unwrap();
+        let stream = xref.fetch(contents).unwrap();
+        let raw = stream.stream.unwrap();
+        assert_eq!(decode_stream(&stream.value, &raw).unwrap(), b"BT 1 Tf ET");
+        // First page's objects all sit in its section
+        let first_page_at = pdf.windows(12).position(|w| w == b"/Type /Page/").unwrap();
+        assert!(first_page_at < lin.first_page_end);
+        assert!(lin.hint_offset < lin.first_page_end);
+    }
+
+    #[test]
+    fn test_hints_locate_later_pages() {
+        let pdf = linearized();
+        let lin = linearization(&pdf).unwrap();
+        let (_, hints) = read_stream_at(&pdf, lin.hint_offset).unwrap();
+        let ranges = page_ranges(&lin, &hints).unwrap();
+        assert_eq!(ranges.len(), 2);
+
+        let mut xref = Xref::open_lazy(0, Arc::new(pdf.clone().into())).unwrap();
+        let second = xref.lazy_page_object(1).unwrap();
+        let page = &pdf[ranges[1].clone()];
+        assert!(page.starts_with(format!("{second} 0 obj\n<</Type /Page/").as_bytes()));
+        // The page's font and contents come with it; its contents' old
+        // /Length object isn't used any more
+        let text = String::from_utf8_lossy(page);
+        assert!(text.contains("/Helvetica") && text.contains("0 0 m S"));
+        assert!(ranges[1].end <= lin.main_xref);
+    }
+}
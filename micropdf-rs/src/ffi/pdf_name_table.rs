@@ -8,6 +8,8 @@ use std::ffi::{CStr, CString, c_char};
 use std::ptr;
 use std::sync::{LazyLock, Mutex};
 
+use super::hashmap_util::{self, STANDARD_NAME_COUNT, STANDARD_NAME_CSTRS, STANDARD_NAMES};
+
 // ============================================================================
 // Standard PDF Name Constants
 // ============================================================================
@@ -263,6 +265,8 @@ pub const PDF_NAME_W: &str = "W";
 struct InternedName {
     /// The name string
     name: String,
+    /// NUL-terminated copy, handed out by pointer for the process lifetime
+    c_name: CString,
     /// Reference count
     ref_count: u32,
     /// Hash code for fast comparison
@@ -270,10 +274,15 @@ struct InternedName {
 }
 
 /// Name interning registry
+///
+/// The standard names hold indices `0..STANDARD_NAME_COUNT` without being
+/// stored: they are found through the static perfect hash, so creating the
+/// registry allocates nothing. Other names are stored from
+/// `STANDARD_NAME_COUNT` on as they are first interned.
 struct NameRegistry {
     /// Map from string to index
     name_to_index: HashMap<String, usize>,
-    /// List of interned names
+    /// Interned names other than the standard ones
     names: Vec<InternedName>,
     /// Total lookups
     lookups: u64,
@@ -283,66 +292,11 @@ struct NameRegistry {
 
 impl NameRegistry {
     fn new() -> Self {
-        let mut registry = Self {
-            // Pre-size for 150+ standard names plus common custom names
-            name_to_index: HashMap::with_capacity(200),
-            names: Vec::with_capacity(200),
+        Self {
+            name_to_index: HashMap::new(),
+            names: Vec::new(),
             lookups: 0,
             hits: 0,
-        };
-        // Pre-populate with standard names
-        registry.populate_standard_names();
-        registry
-    }
-
-    fn populate_standard_names(&mut self) {
-        let standard_names = [
-            PDF_NAME_TYPE,
-            PDF_NAME_SUBTYPE,
-            PDF_NAME_CATALOG,
-            PDF_NAME_PAGES,
-            PDF_NAME_PAGE,
-            PDF_NAME_PARENT,
-            PDF_NAME_KIDS,
-            PDF_NAME_COUNT,
-            PDF_NAME_ROOT,
-            PDF_NAME_INFO,
-            PDF_NAME_METADATA,
-            PDF_NAME_MEDIABOX,
-            PDF_NAME_CROPBOX,
-            PDF_NAME_RESOURCES,
-            PDF_NAME_CONTENTS,
-            PDF_NAME_LENGTH,
-            PDF_NAME_FILTER,
-            PDF_NAME_WIDTH,
-            PDF_NAME_HEIGHT,
-            PDF_NAME_FONT,
-            PDF_NAME_IMAGE,
-            PDF_NAME_FORM,
-            PDF_NAME_XOBJECT,
-            PDF_NAME_EXTGSTATE,
-            PDF_NAME_COLORSPACE,
-            PDF_NAME_FLATEDECODE,
-            PDF_NAME_DCTDECODE,
-            PDF_NAME_DEVICEGRAY,
-            PDF_NAME_DEVICERGB,
-            PDF_NAME_DEVICECMYK,
-            PDF_NAME_BASEFONT,
-            PDF_NAME_ENCODING,
-            PDF_NAME_WIDTHS,
-            PDF_NAME_ANNOTS,
-            PDF_NAME_RECT,
-            PDF_NAME_AP,
-            PDF_NAME_ACROFORM,
-            PDF_NAME_FIELDS,
-            PDF_NAME_TITLE,
-            PDF_NAME_AUTHOR,
-            PDF_NAME_ENCRYPT,
-            PDF_NAME_OUTLINES,
-        ];
-
-        for name in standard_names {
-            self.intern_internal(name);
         }
     }
 
@@ -354,15 +308,24 @@ impl NameRegistry {
         hasher.finish()
     }
 
+    /// Stored entry of a non-standard name index
+    fn entry(&self, idx: usize) -> Option<&InternedName> {
+        self.names.get(idx.checked_sub(STANDARD_NAME_COUNT)?)
+    }
+
     fn intern_internal(&mut self, name: &str) -> usize {
+        if let Some(idx) = standard_name_index(name) {
+            return idx;
+        }
         if let Some(&idx) = self.name_to_index.get(name) {
-            self.names[idx].ref_count += 1;
+            self.names[idx - STANDARD_NAME_COUNT].ref_count += 1;
             return idx;
         }
 
-        let idx = self.names.len();
+        let idx = STANDARD_NAME_COUNT + self.names.len();
         let entry = InternedName {
             name: name.to_string(),
+            c_name: CString::new(name).unwrap_or_default(),
             ref_count: 1,
             hash: Self::hash_name(name),
         };
@@ -373,32 +336,92 @@ impl NameRegistry {
 
     fn intern(&mut self, name: &str) -> usize {
         self.lookups += 1;
-        if self.name_to_index.contains_key(name) {
+        if self.lookup(name).is_some() {
             self.hits += 1;
         }
         self.intern_internal(name)
     }
 
     fn get(&self, idx: usize) -> Option<&str> {
-        self.names.get(idx).map(|n| n.name.as_str())
+        match STANDARD_NAMES.get(idx) {
+            Some(name) => Some(name),
+            None => self.entry(idx).map(|n| n.name.as_str()),
+        }
     }
 
     fn lookup(&self, name: &str) -> Option<usize> {
-        self.name_to_index.get(name).copied()
+        standard_name_index(name).or_else(|| self.name_to_index.get(name).copied())
     }
 
     fn release(&mut self, idx: usize) {
-        if let Some(entry) = self.names.get_mut(idx) {
+        let Some(i) = idx.checked_sub(STANDARD_NAME_COUNT) else {
+            return;
+        };
+        if let Some(entry) = self.names.get_mut(i) {
             if entry.ref_count > 0 {
                 entry.ref_count -= 1;
             }
         }
     }
+
+    /// Number of names with an index, standard ones included
+    fn len(&self) -> usize {
+        STANDARD_NAME_COUNT + self.names.len()
+    }
 }
 
 static NAME_REGISTRY: LazyLock<Mutex<NameRegistry>> =
     LazyLock::new(|| Mutex::new(NameRegistry::new()));
 
+/// Names beyond this count are not interned on behalf of pdf objects
+const MAX_OBJECT_NAMES: usize = 1 << 20;
+
+/// Registry index of a standard name, without taking the registry lock
+///
+/// Standard names hold the first indices, in `StandardPdfName` order.
+#[inline]
+pub(crate) fn standard_name_index(name: &str) -> Option<usize> {
+    hashmap_util::standard_name_index(name)
+}
+
+/// Intern a name for use as an immediate pdf object
+///
+/// Entries are never removed, so the index stays valid for the life of the
+/// process. Returns `None` for names with interior NULs or once the table
+/// is full.
+pub(crate) fn intern_object_name(name: &str) -> Option<usize> {
+    if let Some(idx) = standard_name_index(name) {
+        return Some(idx);
+    }
+    let mut registry = NAME_REGISTRY.lock().ok()?;
+    if let Some(idx) = registry.lookup(name) {
+        return Some(idx);
+    }
+    if name.contains('\0') || registry.len() >= MAX_OBJECT_NAMES {
+        return None;
+    }
+    Some(registry.intern(name))
+}
+
+/// Text of an interned name
+pub(crate) fn interned_name(idx: usize) -> Option<String> {
+    if let Some(name) = STANDARD_NAMES.get(idx) {
+        return Some((*name).to_string());
+    }
+    let registry = NAME_REGISTRY.lock().ok()?;
+    registry.get(idx).map(str::to_string)
+}
+
+/// NUL-terminated text of an interned name, valid for the process lifetime
+pub(crate) fn interned_name_ptr(idx: usize) -> Option<*const c_char> {
+    if let Some(name) = STANDARD_NAME_CSTRS.get(idx) {
+        return Some(name.as_ptr());
+    }
+    let registry = NAME_REGISTRY.lock().ok()?;
+    // The CString's buffer never moves, even when the registry grows
+    registry.entry(idx).map(|n| n.c_name.as_ptr())
+}
+
 // ============================================================================
 // FFI Functions - Name Interning
 // ============================================================================
@@ -539,7 +562,7 @@ pub extern "C" fn pdf_std_name_image() -> i32 {
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_name_table_count() -> i32 {
     let registry = NAME_REGISTRY.lock().unwrap();
-    registry.names.len() as i32
+    registry.len() as i32
 }
 
 /// Get the total number of lookups.
@@ -584,6 +607,18 @@ mod tests {
         assert_eq!(PDF_NAME_IMAGE, "Image");
     }
 
+    #[test]
+    fn test_standard_names_match_registry_indices() {
+        for (i, name) in STANDARD_NAMES.iter().enumerate() {
+            let c_name = CString::new(*name).unwrap();
+            assert_eq!(pdf_lookup_name(c_name.as_ptr()), i as i32);
+            assert_eq!(intern_object_name(name), Some(i));
+        }
+        let idx = intern_object_name("NotAStandardName").unwrap();
+        assert!(idx >= STANDARD_NAMES.len());
+        assert_eq!(interned_name(idx).unwrap(), "NotAStandardName");
+    }
+
     #[test]
     fn test_filter_names() {
         assert_eq!(PDF_NAME_FLATEDECODE, "FlateDecode");
@@ -628,7 +663,7 @@ mod tests {
     fn test_ffi_lookup() {
         let name = CString::new("Type").unwrap();
         let idx = pdf_lookup_name(name.as_ptr());
-        assert!(idx >= 0); // Should be pre-populated
+        assert!(idx >= 0); // Standard names are always present
 
         let unknown = CString::new("UnknownName12345").unwrap();
         let idx2 = pdf_lookup_name(unknown.as_ptr());
@@ -5,7 +5,8 @@
 //! arena is dropped, reducing per-object allocation overhead.
 
 use super::super::Handle;
-use super::types::{PdfObj, PdfObjType};
+use super::types::{PDF_OBJECTS, PdfObj, PdfObjHandle, PdfObjType};
+use crate::fitz::memory_budget;
 use std::cell::UnsafeCell;
 use std::collections::HashMap;
 use std::sync::{Arc, LazyLock, Mutex};
@@ -32,6 +33,8 @@ struct ObjectChunk {
     allocated: Vec<bool>,
     /// Number of allocated objects in this chunk
     count: usize,
+    /// No slot below this index is free
+    first_free: usize,
 }
 
 impl ObjectChunk {
@@ -46,12 +49,14 @@ impl ObjectChunk {
             objects,
             allocated,
             count: 0,
+            first_free: 0,
         }
     }
 
     /// Allocate a slot in this chunk, returning the index
     fn allocate(&mut self, obj: PdfObj) -> Option<usize> {
-        for (i, is_allocated) in self.allocated.iter_mut().enumerate() {
+        let start = self.first_free;
+        for (i, is_allocated) in self.allocated.iter_mut().enumerate().skip(start) {
             if !*is_allocated {
                 *is_allocated = true;
                 // SAFETY: We have exclusive access through &mut self
@@ -59,6 +64,7 @@ impl ObjectChunk {
                     *self.objects[i].get() = Some(obj);
                 }
                 self.count += 1;
+                self.first_free = i + 1;
                 return Some(i);
             }
         }
@@ -74,6 +80,7 @@ impl ObjectChunk {
                 *self.objects[index].get() = None;
             }
             self.count -= 1;
+            self.first_free = self.first_free.min(index);
         }
     }
 
@@ -104,6 +111,12 @@ impl ObjectChunk {
     fn is_empty(&self) -> bool {
         self.count == 0
     }
+
+    /// A compacted chunk keeps its index (so live handles stay valid) but
+    /// owns no slots until it is reprovisioned
+    fn is_released(&self) -> bool {
+        self.objects.is_empty()
+    }
 }
 
 /// Arena handle - encodes chunk index and slot index
@@ -132,9 +145,9 @@ impl ArenaHandle {
         }
     }
 
-    /// Check if handle is an arena handle (arena_id != 0)
+    /// Check if handle is an arena handle (arena_id != 0, not immediate)
     pub fn is_arena_handle(h: Handle) -> bool {
-        (h >> 32) != 0
+        (h >> 32) != 0 && !super::immediate::is_immediate(h)
     }
 }
 
@@ -150,6 +163,8 @@ pub struct PdfObjectArena {
     total_allocated: usize,
     /// Total objects freed
     total_freed: usize,
+    /// Chunk the last allocation went to
+    open_chunk: usize,
     /// Arena name (for debugging)
     name: String,
 }
@@ -168,6 +183,7 @@ impl PdfObjectArena {
             chunk_size,
             total_allocated: 0,
             total_freed: 0,
+            open_chunk: 0,
             name: String::new(),
         }
     }
@@ -179,43 +195,39 @@ impl PdfObjectArena {
 
     /// Allocate a new object in the arena
     pub fn alloc(&mut self, obj: PdfObj) -> ArenaHandle {
-        // First, find a non-full chunk index
-        let existing_chunk_idx = self
-            .chunks
-            .iter()
-            .enumerate()
-            .find(|(_, chunk)| !chunk.is_full())
-            .map(|(idx, _)| idx);
-
-        match existing_chunk_idx {
-            Some(chunk_idx) => {
-                let chunk = &mut self.chunks[chunk_idx];
-                let slot_idx = chunk
-                    .allocate(obj)
-                    .expect("Non-full chunk should have space");
-                self.total_allocated += 1;
-                ArenaHandle {
-                    arena_id: self.id,
-                    chunk_idx: chunk_idx as u16,
-                    slot_idx: slot_idx as u16,
-                }
-            }
+        // Keep filling the chunk we used last; only scan once it is full
+        let count = self.chunks.len();
+        let existing_chunk_idx = (self.open_chunk..count)
+            .chain(0..self.open_chunk.min(count))
+            .find(|&idx| !self.chunks[idx].is_full());
+
+        let chunk_idx = match existing_chunk_idx {
+            Some(chunk_idx) => chunk_idx,
             None => {
-                // Need a new chunk
-                let chunk_idx = self.chunks.len();
-                let mut new_chunk = ObjectChunk::new(self.chunk_size);
-                let slot_idx = new_chunk
-                    .allocate(obj)
-                    .expect("New chunk should have space");
-                self.chunks.push(new_chunk);
-                self.total_allocated += 1;
-
-                ArenaHandle {
-                    arena_id: self.id,
-                    chunk_idx: chunk_idx as u16,
-                    slot_idx: slot_idx as u16,
+                // Need a new chunk; reprovision a released index first
+                let new_chunk = ObjectChunk::new(self.chunk_size);
+                match self.chunks.iter().position(ObjectChunk::is_released) {
+                    Some(idx) => {
+                        self.chunks[idx] = new_chunk;
+                        idx
+                    }
+                    None => {
+                        self.chunks.push(new_chunk);
+                        self.chunks.len() - 1
+                    }
                 }
             }
+        };
+
+        let slot_idx = self.chunks[chunk_idx]
+            .allocate(obj)
+            .expect("Non-full chunk should have space");
+        self.open_chunk = chunk_idx;
+        self.total_allocated += 1;
+        ArenaHandle {
+            arena_id: self.id,
+            chunk_idx: chunk_idx as u16,
+            slot_idx: slot_idx as u16,
         }
     }
 
@@ -225,8 +237,10 @@ impl PdfObjectArena {
             return;
         }
         if let Some(chunk) = self.chunks.get_mut(handle.chunk_idx as usize) {
-            chunk.free(handle.slot_idx as usize);
-            self.total_freed += 1;
+            if chunk.get(handle.slot_idx as usize).is_some() {
+                chunk.free(handle.slot_idx as usize);
+                self.total_freed += 1;
+            }
         }
     }
 
@@ -252,7 +266,7 @@ impl PdfObjectArena {
 
     /// Get arena statistics
     pub fn stats(&self) -> ArenaStats {
-        let chunk_count = self.chunks.len();
+        let chunk_count = self.chunks.iter().filter(|c| !c.is_released()).count();
         let capacity = chunk_count * self.chunk_size;
         let active = self.total_allocated - self.total_freed;
         ArenaStats {
@@ -284,13 +298,25 @@ impl PdfObjectArena {
                 }
             }
             chunk.count = 0;
+            chunk.first_free = 0;
         }
         self.total_freed = self.total_allocated;
     }
 
-    /// Compact the arena by removing empty chunks
+    /// Compact the arena by releasing empty chunks
+    ///
+    /// Handles encode their chunk index, so an empty chunk in the middle
+    /// gives up its storage but keeps its place; trailing ones are removed.
     pub fn compact(&mut self) {
-        self.chunks.retain(|chunk| !chunk.is_empty());
+        for chunk in &mut self.chunks {
+            if chunk.is_empty() && !chunk.is_released() {
+                *chunk = ObjectChunk::new(0);
+            }
+        }
+        while self.chunks.last().is_some_and(ObjectChunk::is_released) {
+            self.chunks.pop();
+        }
+        self.open_chunk = 0;
     }
 }
 
@@ -320,6 +346,9 @@ pub struct ArenaStats {
 // Global Arena Registry
 // ============================================================================
 
+/// Arena IDs wrap below this so arena handles stay below 2^53
+const MAX_ARENA_ID: u32 = 1 << 20;
+
 /// Arena counter for generating unique IDs
 static ARENA_COUNTER: LazyLock<Mutex<u32>> = LazyLock::new(|| Mutex::new(1));
 
@@ -328,16 +357,20 @@ static ARENAS: LazyLock<Mutex<HashMap<u32, PdfObjectArena>>> =
     LazyLock::new(|| Mutex::new(HashMap::new()));
 
 /// Create a new arena and return its ID
-fn create_arena_internal() -> u32 {
-    let id = {
-        let mut counter = ARENA_COUNTER.lock().unwrap();
+///
+/// IDs are reused once they wrap, skipping arenas that are still alive,
+/// so a long-running process can open any number of documents.
+fn create_arena_internal(chunk_size: usize) -> u32 {
+    let mut arenas = ARENAS.lock().unwrap();
+    let mut counter = ARENA_COUNTER.lock().unwrap();
+    let id = loop {
         let id = *counter;
-        *counter += 1;
-        id
+        *counter = if id + 1 >= MAX_ARENA_ID { 1 } else { id + 1 };
+        if !arenas.contains_key(&id) {
+            break id;
+        }
     };
-
-    let arena = PdfObjectArena::new(id);
-    ARENAS.lock().unwrap().insert(id, arena);
+    arenas.insert(id, PdfObjectArena::with_chunk_size(id, chunk_size));
     id
 }
 
@@ -366,27 +399,22 @@ where
 /// Create a new PDF object arena
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_new_object_arena(_ctx: Handle) -> u32 {
-    create_arena_internal()
+    create_arena_internal(DEFAULT_CHUNK_SIZE)
 }
 
 /// Create a new PDF object arena with custom chunk size
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_new_object_arena_with_size(_ctx: Handle, chunk_size: usize) -> u32 {
-    let id = {
-        let mut counter = ARENA_COUNTER.lock().unwrap();
-        let id = *counter;
-        *counter += 1;
-        id
-    };
-
-    let arena = PdfObjectArena::with_chunk_size(id, chunk_size.max(64));
-    ARENAS.lock().unwrap().insert(id, arena);
-    id
+    create_arena_internal(chunk_size.max(64))
 }
 
 /// Drop an arena and all its objects
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_drop_object_arena(_ctx: Handle, arena_id: u32) {
+    DOCUMENT_ARENAS
+        .lock()
+        .unwrap()
+        .retain(|_, id| *id != arena_id);
     ARENAS.lock().unwrap().remove(&arena_id);
 }
 
@@ -550,6 +578,141 @@ pub extern "C" fn pdf_is_arena_handle(_ctx: Handle, handle: Handle) -> i32 {
     }
 }
 
+// ============================================================================
+// Arena Objects Through the Generic API
+// ============================================================================
+
+/// Run `f` on an arena-resident object
+pub(super) fn with_arena_obj<T, F: FnOnce(&PdfObj) -> T>(handle: Handle, default: T, f: F) -> T {
+    let h = ArenaHandle::from_handle(handle);
+    get_arena(h.arena_id, |arena| arena.get(h).map(f))
+        .flatten()
+        .unwrap_or(default)
+}
+
+/// Run `f` on an arena-resident object mutably
+pub(super) fn with_arena_obj_mut<T, F: FnOnce(&mut PdfObj) -> T>(
+    handle: Handle,
+    default: T,
+    f: F,
+) -> T {
+    let h = ArenaHandle::from_handle(handle);
+    get_arena_mut(h.arena_id, |arena| arena.get_mut(h).map(f))
+        .flatten()
+        .unwrap_or(default)
+}
+
+/// Drop one reference to an arena object, freeing its slot at zero
+pub(super) fn release_arena_obj(handle: Handle) {
+    let h = ArenaHandle::from_handle(handle);
+    get_arena_mut(h.arena_id, |arena| {
+        let free = arena.get_mut(h).is_some_and(|o| {
+            o.refs -= 1;
+            o.refs <= 0
+        });
+        if free {
+            arena.free(h);
+        }
+    });
+}
+
+/// Store a new object next to `sibling`: as an immediate if it is a small
+/// scalar, else in the same arena if `sibling` lives in one, otherwise on
+/// the heap
+///
+/// Used by getters that hand out copies of children, so everything reached
+/// from a document's arena objects stays in that arena.
+pub(super) fn alloc_like(sibling: Handle, obj: PdfObj) -> PdfObjHandle {
+    if let Some(h) = super::immediate::encode(&obj) {
+        return h;
+    }
+    if ArenaHandle::is_arena_handle(sibling) {
+        let arena_id = ArenaHandle::from_handle(sibling).arena_id;
+        if let Some(h) = get_arena_mut(arena_id, |arena| arena.alloc(obj.clone()).to_handle()) {
+            return h;
+        }
+    }
+    PDF_OBJECTS.insert(obj)
+}
+
+// ============================================================================
+// Per-Document Arenas
+// ============================================================================
+
+/// Document handle -> arena holding every object parsed for it
+static DOCUMENT_ARENAS: LazyLock<Mutex<HashMap<Handle, u32>>> =
+    LazyLock::new(|| Mutex::new(HashMap::new()));
+
+/// Arena assigned to a document, if arena parsing is enabled for it
+pub fn document_arena(doc: Handle) -> Option<u32> {
+    DOCUMENT_ARENAS.lock().unwrap().get(&doc).copied()
+}
+
+/// Store an object created on behalf of `doc`
+///
+/// Scalars become immediates; anything else lands in the document's arena
+/// when it has one, so closing the document
+/// frees all of its objects in one drop; otherwise it is an ordinary heap
+/// object.
+pub fn new_document_object(doc: Handle, obj: PdfObj) -> PdfObjHandle {
+    if let Some(h) = super::immediate::encode(&obj) {
+        return h;
+    }
+    memory_budget::charge(
+        std::mem::size_of::<PdfObj>()
+            + match &obj.obj_type {
+                PdfObjType::Stream { data, .. } => data.len(),
+                _ => 0,
+            },
+    );
+    match document_arena(doc) {
+        Some(arena_id) => get_arena_mut(arena_id, |arena| arena.alloc(obj.clone()).to_handle())
+            .unwrap_or_else(|| PDF_OBJECTS.insert(obj)),
+        None => PDF_OBJECTS.insert(obj),
+    }
+}
+
+/// Release a document's arena and every object in it
+pub fn drop_document_arena(doc: Handle) {
+    let arena_id = DOCUMENT_ARENAS.lock().unwrap().remove(&doc);
+    if let Some(id) = arena_id {
+        ARENAS.lock().unwrap().remove(&id);
+    }
+}
+
+/// Enable or disable arena allocation for objects parsed for a document
+///
+/// Enabling returns the document's arena id (creating it if needed).
+/// Disabling drops the arena, which frees every object in it.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_set_document_object_arena(_ctx: Handle, doc: Handle, enable: i32) -> u32 {
+    if enable == 0 {
+        drop_document_arena(doc);
+        return 0;
+    }
+    if let Some(id) = document_arena(doc) {
+        return id;
+    }
+    let id = create_arena_internal(DEFAULT_CHUNK_SIZE);
+    get_arena_mut(id, |arena| arena.set_name(&format!("document {doc}")));
+    DOCUMENT_ARENAS.lock().unwrap().insert(doc, id);
+    id
+}
+
+/// Get the arena id used for a document's objects (0 if none)
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_document_object_arena(_ctx: Handle, doc: Handle) -> u32 {
+    document_arena(doc).unwrap_or(0)
+}
+
+/// Compact a document's arena once loading has finished
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_compact_document_object_arena(_ctx: Handle, doc: Handle) {
+    if let Some(id) = document_arena(doc) {
+        get_arena_mut(id, |arena| arena.compact());
+    }
+}
+
 // ============================================================================
 // Tests
 // ============================================================================
@@ -729,6 +892,66 @@ mod tests {
         pdf_drop_object_arena(0, arena_id);
     }
 
+    #[test]
+    fn test_compact_keeps_live_handles() {
+        let arena_id = pdf_new_object_arena_with_size(0, 64);
+        let handles: Vec<_> = (0..192)
+            .map(|i| pdf_arena_new_int(0, arena_id, i))
+            .collect();
+
+        // Empty the middle chunk only
+        for &h in &handles[64..128] {
+            pdf_arena_free_obj(0, h);
+        }
+        pdf_compact_object_arena(0, arena_id);
+        assert_eq!(pdf_object_arena_stats(0, arena_id).chunk_count, 2);
+
+        // Objects in the trailing chunk are still reachable
+        assert_eq!(
+            with_arena_obj(handles[150], -1, |o| match o.obj_type {
+                PdfObjType::Int(i) => i,
+                _ => -1,
+            }),
+            150
+        );
+
+        // New objects fill the released chunk instead of growing the arena
+        for i in 0..64 {
+            pdf_arena_new_int(0, arena_id, i);
+        }
+        assert_eq!(pdf_object_arena_stats(0, arena_id).chunk_count, 3);
+
+        pdf_drop_object_arena(0, arena_id);
+    }
+
+    #[test]
+    fn test_document_arena_lifetime() {
+        let doc: Handle = 0x7fff_0001;
+        assert_eq!(pdf_document_object_arena(0, doc), 0);
+        let heap = new_document_object(doc, PdfObj::new_int(1));
+        assert!(!ArenaHandle::is_arena_handle(heap));
+        PDF_OBJECTS.remove(heap);
+
+        let arena_id = pdf_set_document_object_arena(0, doc, 1);
+        assert!(arena_id > 0);
+        assert_eq!(pdf_set_document_object_arena(0, doc, 1), arena_id);
+
+        let obj = new_document_object(doc, PdfObj::new_dict(2));
+        assert_eq!(ArenaHandle::from_handle(obj).arena_id, arena_id);
+        let child = alloc_like(obj, PdfObj::new_array(1));
+        assert_eq!(ArenaHandle::from_handle(child).arena_id, arena_id);
+        // Scalars never take an arena slot
+        let scalar = new_document_object(doc, PdfObj::new_int(7));
+        assert!(!ArenaHandle::is_arena_handle(scalar));
+
+        pdf_compact_document_object_arena(0, doc);
+        assert_eq!(pdf_object_arena_stats(0, arena_id).active, 2);
+
+        drop_document_arena(doc);
+        assert_eq!(pdf_document_object_arena(0, doc), 0);
+        assert!(with_arena_obj(obj, true, |_| false));
+    }
+
     #[test]
     fn test_arena_all_types() {
         let arena_id = pdf_new_object_arena(0);
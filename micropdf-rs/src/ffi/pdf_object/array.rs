@@ -1,8 +1,9 @@
 //! PDF Array Operations FFI Functions
 
 use super::super::Handle;
+use super::arena::alloc_like;
 use super::refcount::{with_obj, with_obj_mut};
-use super::types::{PDF_OBJECTS, PdfObj, PdfObjHandle, PdfObjType};
+use super::types::{PdfObj, PdfObjHandle, PdfObjType};
 
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_array_len(_ctx: Handle, array: PdfObjHandle) -> i32 {
@@ -88,7 +89,7 @@ pub extern "C" fn pdf_array_get(_ctx: Handle, array: PdfObjHandle, index: i32) -
     });
 
     match obj {
-        Some(o) => PDF_OBJECTS.insert(o),
+        Some(o) => alloc_like(array, o),
         None => 0, // Return null handle
     }
 }
@@ -1,11 +1,15 @@
 //! PDF Object Type Checking FFI Functions
 
 use super::super::Handle;
+use super::immediate::{self, Immediate};
 use super::refcount::with_obj;
 use super::types::{PdfObjHandle, PdfObjType};
 
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_is_null(_ctx: Handle, obj: PdfObjHandle) -> i32 {
+    if let Some(imm) = immediate::decode(obj) {
+        return i32::from(imm == Immediate::Null);
+    }
     with_obj(obj, 1, |o| {
         i32::from(matches!(o.obj_type, PdfObjType::Null))
     })
@@ -13,6 +17,9 @@ pub extern "C" fn pdf_is_null(_ctx: Handle, obj: PdfObjHandle) -> i32 {
 
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_is_bool(_ctx: Handle, obj: PdfObjHandle) -> i32 {
+    if let Some(imm) = immediate::decode(obj) {
+        return i32::from(matches!(imm, Immediate::Bool(_)));
+    }
     with_obj(obj, 0, |o| {
         i32::from(matches!(o.obj_type, PdfObjType::Bool(_)))
     })
@@ -20,6 +27,9 @@ pub extern "C" fn pdf_is_bool(_ctx: Handle, obj: PdfObjHandle) -> i32 {
 
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_is_int(_ctx: Handle, obj: PdfObjHandle) -> i32 {
+    if let Some(imm) = immediate::decode(obj) {
+        return i32::from(matches!(imm, Immediate::Int(_)));
+    }
     with_obj(obj, 0, |o| {
         i32::from(matches!(o.obj_type, PdfObjType::Int(_)))
     })
@@ -27,6 +37,9 @@ pub extern "C" fn pdf_is_int(_ctx: Handle, obj: PdfObjHandle) -> i32 {
 
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_is_real(_ctx: Handle, obj: PdfObjHandle) -> i32 {
+    if let Some(imm) = immediate::decode(obj) {
+        return i32::from(matches!(imm, Immediate::Real(_)));
+    }
     with_obj(obj, 0, |o| {
         i32::from(matches!(o.obj_type, PdfObjType::Real(_)))
     })
@@ -34,6 +47,9 @@ pub extern "C" fn pdf_is_real(_ctx: Handle, obj: PdfObjHandle) -> i32 {
 
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_is_number(_ctx: Handle, obj: PdfObjHandle) -> i32 {
+    if let Some(imm) = immediate::decode(obj) {
+        return i32::from(matches!(imm, Immediate::Int(_) | Immediate::Real(_)));
+    }
     with_obj(obj, 0, |o| {
         i32::from(matches!(
             o.obj_type,
@@ -44,6 +60,9 @@ pub extern "C" fn pdf_is_number(_ctx: Handle, obj: PdfObjHandle) -> i32 {
 
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_is_name(_ctx: Handle, obj: PdfObjHandle) -> i32 {
+    if let Some(imm) = immediate::decode(obj) {
+        return i32::from(matches!(imm, Immediate::Name(_)));
+    }
     with_obj(obj, 0, |o| {
         i32::from(matches!(o.obj_type, PdfObjType::Name(_)))
     })
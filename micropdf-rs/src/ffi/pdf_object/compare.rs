@@ -1,6 +1,7 @@
 //! PDF Object Comparison FFI Functions
 
 use super::super::Handle;
+use super::immediate;
 use super::refcount::with_obj;
 use super::types::{PdfObjHandle, PdfObjType};
 
@@ -17,6 +18,12 @@ pub extern "C" fn pdf_objcmp(_ctx: Handle, a: PdfObjHandle, b: PdfObjHandle) ->
 
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_name_eq(_ctx: Handle, a: PdfObjHandle, b: PdfObjHandle) -> i32 {
+    // Interned names are equal exactly when their handles are
+    if let (Some(immediate::Immediate::Name(x)), Some(immediate::Immediate::Name(y))) =
+        (immediate::decode(a), immediate::decode(b))
+    {
+        return i32::from(x == y);
+    }
     let name_a = with_obj(a, None, |o| match &o.obj_type {
         PdfObjType::Name(s) => Some(s.clone()),
         _ => None,
@@ -32,7 +32,7 @@ pub extern "C" fn pdf_copy_dict(_ctx: Handle, _doc: Handle, dict: PdfObjHandle)
             let mut new_dict = PdfObj::new_dict(entries.len());
             if let PdfObjType::Dict(ref mut new_entries) = new_dict.obj_type {
                 for (k, v) in entries {
-                    new_entries.push((k.clone(), v.clone()));
+                    new_entries.push(k.clone(), v.clone());
                 }
             }
             Some(new_dict)
@@ -1,17 +1,18 @@
 //! PDF Object Creation FFI Functions
 
 use super::super::Handle;
+use super::immediate;
 use super::types::{PDF_OBJECTS, PdfObj, PdfObjHandle};
 use std::ffi::{CStr, c_char};
 
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_new_null(_ctx: Handle) -> PdfObjHandle {
-    PDF_OBJECTS.insert(PdfObj::new_null())
+    immediate::null()
 }
 
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_new_bool(_ctx: Handle, b: i32) -> PdfObjHandle {
-    PDF_OBJECTS.insert(PdfObj::new_bool(b != 0))
+    immediate::boolean(b != 0)
 }
 
 #[unsafe(no_mangle)]
@@ -26,11 +27,12 @@ pub extern "C" fn pdf_new_real(_ctx: Handle, f: f32) -> PdfObjHandle {
 
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_new_name(_ctx: Handle, str: *const c_char) -> PdfObjHandle {
-    if str.is_null() {
-        return PDF_OBJECTS.insert(PdfObj::new_name(""));
-    }
-    let name = unsafe { CStr::from_ptr(str) }.to_str().unwrap_or("");
-    PDF_OBJECTS.insert(PdfObj::new_name(name))
+    let name = if str.is_null() {
+        ""
+    } else {
+        unsafe { CStr::from_ptr(str) }.to_str().unwrap_or("")
+    };
+    immediate::name(name).unwrap_or_else(|| PDF_OBJECTS.insert(PdfObj::new_name(name)))
 }
 
 #[unsafe(no_mangle)]
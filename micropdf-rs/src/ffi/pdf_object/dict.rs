@@ -1,10 +1,31 @@
 //! PDF Dictionary Operations FFI Functions
 
 use super::super::Handle;
+use super::super::hashmap_util::STANDARD_NAMES;
+use super::arena::alloc_like;
+use super::immediate::{self, Immediate};
 use super::refcount::{with_obj, with_obj_mut};
-use super::types::{PDF_OBJECTS, PdfObj, PdfObjHandle, PdfObjType};
+use super::types::{PdfObj, PdfObjHandle, PdfObjType};
+use std::borrow::Cow;
 use std::ffi::{CStr, c_char};
 
+/// Text of a name used as a dictionary key
+///
+/// Standard names come straight from the perfect-hash table, so looking up
+/// `PDF_NAME(Type)` and friends takes no lock and allocates nothing.
+pub(crate) fn dict_key(key: PdfObjHandle) -> Option<Cow<'static, str>> {
+    if let Some(Immediate::Name(idx)) = immediate::decode(key) {
+        return match STANDARD_NAMES.get(idx as usize) {
+            Some(name) => Some(Cow::Borrowed(*name)),
+            None => immediate::name_str(idx).map(Cow::Owned),
+        };
+    }
+    with_obj(key, None, |o| match &o.obj_type {
+        PdfObjType::Name(s) => Some(Cow::Owned(s.clone())),
+        _ => None,
+    })
+}
+
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_dict_len(_ctx: Handle, dict: PdfObjHandle) -> i32 {
     with_obj(dict, 0, |o| match &o.obj_type {
@@ -34,11 +55,7 @@ pub extern "C" fn pdf_dict_puts(
     if let Some(val_clone) = val_obj {
         with_obj_mut(dict, (), |d| {
             if let PdfObjType::Dict(ref mut dict_entries) = d.obj_type {
-                if let Some(entry) = dict_entries.iter_mut().find(|(k, _)| k == &key_str) {
-                    entry.1 = val_clone;
-                } else {
-                    dict_entries.push((key_str.clone(), val_clone));
-                }
+                dict_entries.insert(&key_str, val_clone);
                 d.dirty = true;
             }
         });
@@ -58,7 +75,7 @@ pub extern "C" fn pdf_dict_dels(_ctx: Handle, dict: PdfObjHandle, key: *const c_
 
     with_obj_mut(dict, (), |d| {
         if let PdfObjType::Dict(ref mut dict_entries) = d.obj_type {
-            dict_entries.retain(|(k, _)| k != &key_str);
+            dict_entries.remove(&key_str);
             d.dirty = true;
         }
     });
@@ -66,20 +83,13 @@ pub extern "C" fn pdf_dict_dels(_ctx: Handle, dict: PdfObjHandle, key: *const c_
 
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_dict_put_int(_ctx: Handle, dict: PdfObjHandle, key: PdfObjHandle, x: i64) {
-    let key_name = with_obj(key, None, |o| match &o.obj_type {
-        PdfObjType::Name(s) => Some(s.clone()),
-        _ => None,
-    });
+    let key_name = dict_key(key);
 
     if let Some(key_str) = key_name {
         with_obj_mut(dict, (), |d| {
             if let PdfObjType::Dict(ref mut dict_entries) = d.obj_type {
                 let val = PdfObj::new_int(x);
-                if let Some(entry) = dict_entries.iter_mut().find(|(k, _)| k == &key_str) {
-                    entry.1 = val;
-                } else {
-                    dict_entries.push((key_str.clone(), val));
-                }
+                dict_entries.insert(&key_str, val);
                 d.dirty = true;
             }
         });
@@ -88,20 +98,13 @@ pub extern "C" fn pdf_dict_put_int(_ctx: Handle, dict: PdfObjHandle, key: PdfObj
 
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_dict_put_real(_ctx: Handle, dict: PdfObjHandle, key: PdfObjHandle, x: f64) {
-    let key_name = with_obj(key, None, |o| match &o.obj_type {
-        PdfObjType::Name(s) => Some(s.clone()),
-        _ => None,
-    });
+    let key_name = dict_key(key);
 
     if let Some(key_str) = key_name {
         with_obj_mut(dict, (), |d| {
             if let PdfObjType::Dict(ref mut dict_entries) = d.obj_type {
                 let val = PdfObj::new_real(x);
-                if let Some(entry) = dict_entries.iter_mut().find(|(k, _)| k == &key_str) {
-                    entry.1 = val;
-                } else {
-                    dict_entries.push((key_str.clone(), val));
-                }
+                dict_entries.insert(&key_str, val);
                 d.dirty = true;
             }
         });
@@ -110,20 +113,13 @@ pub extern "C" fn pdf_dict_put_real(_ctx: Handle, dict: PdfObjHandle, key: PdfOb
 
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_dict_put_bool(_ctx: Handle, dict: PdfObjHandle, key: PdfObjHandle, x: i32) {
-    let key_name = with_obj(key, None, |o| match &o.obj_type {
-        PdfObjType::Name(s) => Some(s.clone()),
-        _ => None,
-    });
+    let key_name = dict_key(key);
 
     if let Some(key_str) = key_name {
         with_obj_mut(dict, (), |d| {
             if let PdfObjType::Dict(ref mut dict_entries) = d.obj_type {
                 let val = PdfObj::new_bool(x != 0);
-                if let Some(entry) = dict_entries.iter_mut().find(|(k, _)| k == &key_str) {
-                    entry.1 = val;
-                } else {
-                    dict_entries.push((key_str.clone(), val));
-                }
+                dict_entries.insert(&key_str, val);
                 d.dirty = true;
             }
         });
@@ -140,10 +136,7 @@ pub extern "C" fn pdf_dict_get(
     dict: PdfObjHandle,
     key: PdfObjHandle,
 ) -> PdfObjHandle {
-    let key_name = with_obj(key, None, |o| match &o.obj_type {
-        PdfObjType::Name(s) => Some(s.clone()),
-        _ => None,
-    });
+    let key_name = dict_key(key);
 
     let key_str = match key_name {
         Some(k) => k,
@@ -151,15 +144,12 @@ pub extern "C" fn pdf_dict_get(
     };
 
     let obj = with_obj(dict, None, |o| match &o.obj_type {
-        PdfObjType::Dict(entries) => entries
-            .iter()
-            .find(|(k, _)| k == &key_str)
-            .map(|(_, v)| v.clone()),
+        PdfObjType::Dict(entries) => entries.get(&key_str).cloned(),
         _ => None,
     });
 
     match obj {
-        Some(o) => PDF_OBJECTS.insert(o),
+        Some(o) => alloc_like(dict, o),
         None => 0,
     }
 }
@@ -174,21 +164,15 @@ pub extern "C" fn pdf_dict_gets(
         return 0;
     }
 
-    let key_str = unsafe { CStr::from_ptr(key) }
-        .to_str()
-        .unwrap_or("")
-        .to_string();
+    let key_str = unsafe { CStr::from_ptr(key) }.to_str().unwrap_or("");
 
     let obj = with_obj(dict, None, |o| match &o.obj_type {
-        PdfObjType::Dict(entries) => entries
-            .iter()
-            .find(|(k, _)| k == &key_str)
-            .map(|(_, v)| v.clone()),
+        PdfObjType::Dict(entries) => entries.get(&key_str).cloned(),
         _ => None,
     });
 
     match obj {
-        Some(o) => PDF_OBJECTS.insert(o),
+        Some(o) => alloc_like(dict, o),
         None => 0,
     }
 }
@@ -200,10 +184,7 @@ pub extern "C" fn pdf_dict_put(
     key: PdfObjHandle,
     val: PdfObjHandle,
 ) {
-    let key_name = with_obj(key, None, |o| match &o.obj_type {
-        PdfObjType::Name(s) => Some(s.clone()),
-        _ => None,
-    });
+    let key_name = dict_key(key);
 
     let key_str = match key_name {
         Some(k) => k,
@@ -215,11 +196,7 @@ pub extern "C" fn pdf_dict_put(
     if let Some(val_clone) = val_obj {
         with_obj_mut(dict, (), |d| {
             if let PdfObjType::Dict(ref mut entries) = d.obj_type {
-                if let Some(entry) = entries.iter_mut().find(|(k, _)| k == &key_str) {
-                    entry.1 = val_clone;
-                } else {
-                    entries.push((key_str.clone(), val_clone));
-                }
+                entries.insert(&key_str, val_clone);
                 d.dirty = true;
             }
         });
@@ -237,10 +214,7 @@ pub extern "C" fn pdf_dict_put_name(
         return;
     }
 
-    let key_name = with_obj(key, None, |o| match &o.obj_type {
-        PdfObjType::Name(s) => Some(s.clone()),
-        _ => None,
-    });
+    let key_name = dict_key(key);
 
     let key_str = match key_name {
         Some(k) => k,
@@ -252,11 +226,7 @@ pub extern "C" fn pdf_dict_put_name(
     with_obj_mut(dict, (), |d| {
         if let PdfObjType::Dict(ref mut entries) = d.obj_type {
             let val = PdfObj::new_name(name_str);
-            if let Some(entry) = entries.iter_mut().find(|(k, _)| k == &key_str) {
-                entry.1 = val;
-            } else {
-                entries.push((key_str.clone(), val));
-            }
+            entries.insert(&key_str, val);
             d.dirty = true;
         }
     });
@@ -270,10 +240,7 @@ pub extern "C" fn pdf_dict_put_string(
     str: *const c_char,
     len: usize,
 ) {
-    let key_name = with_obj(key, None, |o| match &o.obj_type {
-        PdfObjType::Name(s) => Some(s.clone()),
-        _ => None,
-    });
+    let key_name = dict_key(key);
 
     let key_str = match key_name {
         Some(k) => k,
@@ -289,11 +256,7 @@ pub extern "C" fn pdf_dict_put_string(
     with_obj_mut(dict, (), |d| {
         if let PdfObjType::Dict(ref mut entries) = d.obj_type {
             let val = PdfObj::new_string(&data);
-            if let Some(entry) = entries.iter_mut().find(|(k, _)| k == &key_str) {
-                entry.1 = val;
-            } else {
-                entries.push((key_str.clone(), val));
-            }
+            entries.insert(&key_str, val);
             d.dirty = true;
         }
     });
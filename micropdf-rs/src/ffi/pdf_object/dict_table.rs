@@ -0,0 +1,209 @@
+//! Adaptive PDF Dictionary Storage
+//!
+//! Dictionaries keep their entries in insertion order, which is what
+//! serialization and `pdf_dict_get_key`/`pdf_dict_get_val` expose. Small
+//! dicts are searched linearly, which beats hashing at the sizes most
+//! dicts have. Past `INDEX_THRESHOLD` entries a name -> position index is
+//! built, so the resource dicts, `/Widths`-heavy fonts and flat page trees
+//! of generated files don't turn every lookup into a scan of thousands of
+//! keys.
+
+use super::super::hashmap_util::{PdfNameMap, new_pdf_name_map_with_capacity};
+use super::types::PdfObj;
+
+/// Entry count past which a dict is indexed
+///
+/// The largest of the presized dict hints (`fz_new_*_dict_capacity`,
+/// catalog dicts at 20 keys): anything bigger is not a typical dict.
+pub const INDEX_THRESHOLD: usize = 20;
+
+/// Dictionary entries plus an index once the dict grows large
+#[derive(Debug, Clone, Default)]
+pub struct PdfDict {
+    entries: Vec<(String, PdfObj)>,
+    /// Position of the first entry for each key
+    index: Option<PdfNameMap<usize>>,
+}
+
+impl PdfDict {
+    /// Empty dict sized for `cap` entries; large hints start out indexed
+    pub fn with_capacity(cap: usize) -> Self {
+        Self {
+            entries: Vec::with_capacity(cap),
+            index: (cap > INDEX_THRESHOLD).then(|| new_pdf_name_map_with_capacity(cap)),
+        }
+    }
+
+    pub fn len(&self) -> usize {
+        self.entries.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.entries.is_empty()
+    }
+
+    /// Whether lookups go through the hash index
+    pub fn is_indexed(&self) -> bool {
+        self.index.is_some()
+    }
+
+    fn position(&self, key: &str) -> Option<usize> {
+        match &self.index {
+            Some(index) => index.get(key).copied(),
+            None => self.entries.iter().position(|(k, _)| k == key),
+        }
+    }
+
+    pub fn get(&self, key: &str) -> Option<&PdfObj> {
+        self.position(key).map(|i| &self.entries[i].1)
+    }
+
+    pub fn get_mut(&mut self, key: &str) -> Option<&mut PdfObj> {
+        self.position(key).map(|i| &mut self.entries[i].1)
+    }
+
+    /// Entry at insertion position `i`
+    pub fn entry_at(&self, i: usize) -> Option<&(String, PdfObj)> {
+        self.entries.get(i)
+    }
+
+    /// Set `key`, replacing an existing value in place or appending
+    pub fn insert(&mut self, key: &str, val: PdfObj) {
+        if let Some(slot) = self.get_mut(key) {
+            *slot = val;
+            return;
+        }
+        if let Some(index) = &mut self.index {
+            index.insert(key.to_string(), self.entries.len());
+        }
+        self.entries.push((key.to_string(), val));
+        if self.index.is_none() && self.entries.len() > INDEX_THRESHOLD {
+            self.rebuild_index();
+        }
+    }
+
+    /// Append an entry without checking for an existing key
+    ///
+    /// For building dicts from parsed input, which may repeat keys; lookups
+    /// see the first occurrence, as with a linear scan.
+    pub fn push(&mut self, key: String, val: PdfObj) {
+        if let Some(index) = &mut self.index {
+            index.entry(key.clone()).or_insert(self.entries.len());
+        }
+        self.entries.push((key, val));
+        if self.index.is_none() && self.entries.len() > INDEX_THRESHOLD {
+            self.rebuild_index();
+        }
+    }
+
+    /// Remove every entry for `key`
+    pub fn remove(&mut self, key: &str) {
+        if self.position(key).is_none() {
+            return;
+        }
+        self.entries.retain(|(k, _)| k != key);
+        // Later positions shifted; small dicts go back to scanning
+        if self.index.is_some() {
+            self.index = None;
+            if self.entries.len() > INDEX_THRESHOLD {
+                self.rebuild_index();
+            }
+        }
+    }
+
+    fn rebuild_index(&mut self) {
+        let mut index = new_pdf_name_map_with_capacity(self.entries.capacity());
+        for (i, (k, _)) in self.entries.iter().enumerate() {
+            index.entry(k.clone()).or_insert(i);
+        }
+        self.index = Some(index);
+    }
+
+    pub fn iter(&self) -> std::slice::Iter<'_, (String, PdfObj)> {
+        self.entries.iter()
+    }
+}
+
+impl<'a> IntoIterator for &'a PdfDict {
+    type Item = &'a (String, PdfObj);
+    type IntoIter = std::slice::Iter<'a, (String, PdfObj)>;
+
+    fn into_iter(self) -> Self::IntoIter {
+        self.iter()
+    }
+}
+
+impl FromIterator<(String, PdfObj)> for PdfDict {
+    fn from_iter<I: IntoIterator<Item = (String, PdfObj)>>(iter: I) -> Self {
+        let iter = iter.into_iter();
+        let mut dict = Self::with_capacity(iter.size_hint().0);
+        for (k, v) in iter {
+            dict.push(k, v);
+        }
+        dict
+    }
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::super::types::PdfObjType;
+    use super::*;
+
+    fn key(i: usize) -> String {
+        format!("K{i}")
+    }
+
+    #[test]
+    fn test_small_dict_stays_linear() {
+        let mut d = PdfDict::with_capacity(4);
+        for i in 0..INDEX_THRESHOLD {
+            d.insert(&key(i), PdfObj::new_int(i as i64));
+        }
+        assert!(!d.is_indexed());
+        assert!(matches!(d.get("K3").unwrap().obj_type, PdfObjType::Int(3)));
+    }
+
+    #[test]
+    fn test_large_dict_is_indexed_in_order() {
+        let mut d = PdfDict::with_capacity(0);
+        for i in 0..1000 {
+            d.insert(&key(i), PdfObj::new_int(i as i64));
+        }
+        assert!(d.is_indexed());
+        assert_eq!(d.len(), 1000);
+        // Insertion order is kept
+        assert_eq!(d.entry_at(500).unwrap().0, "K500");
+
+        d.insert("K10", PdfObj::new_bool(true));
+        assert_eq!(d.len(), 1000);
+        assert!(matches!(
+            d.get("K10").unwrap().obj_type,
+            PdfObjType::Bool(true)
+        ));
+
+        d.remove("K0");
+        assert!(d.get("K0").is_none());
+        assert_eq!(d.entry_at(0).unwrap().0, "K1");
+        assert!(d.get("K999").is_some());
+    }
+
+    #[test]
+    fn test_duplicates_resolve_to_first() {
+        let d: PdfDict = (0..30)
+            .map(|i| (key(i % 25), PdfObj::new_int(i as i64)))
+            .collect();
+        assert!(d.is_indexed());
+        assert_eq!(d.len(), 30);
+        assert!(matches!(d.get("K2").unwrap().obj_type, PdfObjType::Int(2)));
+    }
+
+    #[test]
+    fn test_large_capacity_hint_indexes_up_front() {
+        assert!(PdfDict::with_capacity(INDEX_THRESHOLD + 1).is_indexed());
+        assert!(!PdfDict::with_capacity(INDEX_THRESHOLD).is_indexed());
+    }
+}
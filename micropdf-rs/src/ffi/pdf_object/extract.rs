@@ -1,6 +1,7 @@
 //! PDF Object Value Extraction FFI Functions
 
 use super::super::Handle;
+use super::immediate::{self, Immediate};
 use super::refcount::with_obj;
 use super::types::{PdfObjHandle, PdfObjType};
 use std::ffi::{CString, c_char};
@@ -11,6 +12,9 @@ static NAME_STORAGE: LazyLock<Mutex<Vec<CString>>> = LazyLock::new(|| Mutex::new
 
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_to_bool(_ctx: Handle, obj: PdfObjHandle) -> i32 {
+    if let Some(imm) = immediate::decode(obj) {
+        return i32::from(imm == Immediate::Bool(true));
+    }
     with_obj(obj, 0, |o| match &o.obj_type {
         PdfObjType::Bool(b) => i32::from(*b),
         _ => 0,
@@ -19,6 +23,13 @@ pub extern "C" fn pdf_to_bool(_ctx: Handle, obj: PdfObjHandle) -> i32 {
 
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_to_int(_ctx: Handle, obj: PdfObjHandle) -> i32 {
+    if let Some(imm) = immediate::decode(obj) {
+        return match imm {
+            Immediate::Int(i) => i as i32,
+            Immediate::Real(f) => f as i32,
+            _ => 0,
+        };
+    }
     with_obj(obj, 0, |o| match &o.obj_type {
         PdfObjType::Int(i) => *i as i32,
         PdfObjType::Real(f) => *f as i32,
@@ -28,6 +39,13 @@ pub extern "C" fn pdf_to_int(_ctx: Handle, obj: PdfObjHandle) -> i32 {
 
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_to_int64(_ctx: Handle, obj: PdfObjHandle) -> i64 {
+    if let Some(imm) = immediate::decode(obj) {
+        return match imm {
+            Immediate::Int(i) => i,
+            Immediate::Real(f) => f as i64,
+            _ => 0,
+        };
+    }
     with_obj(obj, 0, |o| match &o.obj_type {
         PdfObjType::Int(i) => *i,
         PdfObjType::Real(f) => *f as i64,
@@ -37,6 +55,13 @@ pub extern "C" fn pdf_to_int64(_ctx: Handle, obj: PdfObjHandle) -> i64 {
 
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_to_real(_ctx: Handle, obj: PdfObjHandle) -> f32 {
+    if let Some(imm) = immediate::decode(obj) {
+        return match imm {
+            Immediate::Real(f) => f,
+            Immediate::Int(i) => i as f32,
+            _ => 0.0,
+        };
+    }
     with_obj(obj, 0.0, |o| match &o.obj_type {
         PdfObjType::Real(f) => *f as f32,
         PdfObjType::Int(i) => *i as f32,
@@ -48,6 +73,14 @@ pub extern "C" fn pdf_to_real(_ctx: Handle, obj: PdfObjHandle) -> f32 {
 pub extern "C" fn pdf_to_name(_ctx: Handle, obj: PdfObjHandle) -> *const c_char {
     static EMPTY: &[u8] = b"\0";
 
+    if let Some(imm) = immediate::decode(obj) {
+        return match imm {
+            Immediate::Name(idx) => immediate::name_ptr(idx),
+            _ => None,
+        }
+        .unwrap_or(EMPTY.as_ptr() as *const c_char);
+    }
+
     let name = with_obj(obj, None, |o| match &o.obj_type {
         PdfObjType::Name(s) => Some(s.clone()),
         _ => None,
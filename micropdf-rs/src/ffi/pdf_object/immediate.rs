@@ -0,0 +1,282 @@
+//! Immediate (tagged) PDF Object Handles
+//!
+//! Small scalars are encoded directly in the handle value instead of
+//! occupying a slot in the object store. Reading them back is a few bit
+//! operations with no lock and no table lookup, which matters for content
+//! streams and cleaning passes that churn through millions of operands.
+//!
+//! Layout (handles from 2^30 to 2^31 are immediates; store handles stay
+//! below 2^30 and arena handles above 2^32). Immediates are positive
+//! `int32_t` values, so they survive the `int32_t pdf_obj` of the C
+//! headers, and bindings that carry handles as doubles, like the Node
+//! addon, see them exactly:
+//!
+//! ```text
+//! 30   29..27   26..0
+//! 1    kind     payload
+//! ```
+//!
+//! - null / bool: payload is 0 / the boolean
+//! - int: 27-bit two's complement; larger values stay in the store
+//! - real: the `f32` bit pattern without its 5 low mantissa bits; values
+//!   that need them, or don't round-trip through `f32`, stay in the store
+//! - name: index into the process-wide name registry (`pdf_intern_name`)
+//!
+//! Immediates are immutable values: keep/drop are no-ops and marking,
+//! dirtying or re-parenting them does nothing, as for MuPDF's static
+//! `PDF_NAME`/`PDF_TRUE`/`PDF_NULL` objects.
+
+use super::super::Handle;
+use super::super::pdf_name_table;
+use super::types::{PdfObj, PdfObjType};
+use std::ffi::c_char;
+
+/// Bit marking a handle as an immediate value
+pub const IMMEDIATE_TAG: u64 = 1 << 30;
+
+const KIND_SHIFT: u32 = 27;
+const KIND_MASK: u64 = 0x7;
+const PAYLOAD_MASK: u64 = (1 << KIND_SHIFT) - 1;
+
+/// Low `f32` mantissa bits a real immediate drops
+const REAL_SHIFT: u32 = 5;
+
+const KIND_NULL: u64 = 1;
+const KIND_BOOL: u64 = 2;
+const KIND_INT: u64 = 3;
+const KIND_REAL: u64 = 4;
+const KIND_NAME: u64 = 5;
+
+/// Smallest and largest ints that fit in the payload
+const INT_MIN: i64 = -(1 << 26);
+const INT_MAX: i64 = (1 << 26) - 1;
+
+/// Decoded immediate value
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum Immediate {
+    Null,
+    Bool(bool),
+    Int(i64),
+    Real(f32),
+    /// Index into the name registry
+    Name(u32),
+}
+
+/// Check whether a handle is an immediate value
+#[inline]
+pub fn is_immediate(h: Handle) -> bool {
+    h & !(IMMEDIATE_TAG - 1) == IMMEDIATE_TAG
+}
+
+#[inline]
+fn pack(kind: u64, payload: u64) -> Handle {
+    IMMEDIATE_TAG | (kind << KIND_SHIFT) | (payload & PAYLOAD_MASK)
+}
+
+/// Decode an immediate handle
+#[inline]
+pub fn decode(h: Handle) -> Option<Immediate> {
+    if !is_immediate(h) {
+        return None;
+    }
+    let payload = h & PAYLOAD_MASK;
+    match (h >> KIND_SHIFT) & KIND_MASK {
+        KIND_NULL => Some(Immediate::Null),
+        KIND_BOOL => Some(Immediate::Bool(payload != 0)),
+        // Shift up and back down to sign-extend the 27-bit payload
+        KIND_INT => Some(Immediate::Int(((payload << 37) as i64) >> 37)),
+        KIND_REAL => Some(Immediate::Real(f32::from_bits(
+            (payload as u32) << REAL_SHIFT,
+        ))),
+        KIND_NAME => Some(Immediate::Name(payload as u32)),
+        _ => None,
+    }
+}
+
+/// Immediate handle for null
+pub fn null() -> Handle {
+    pack(KIND_NULL, 0)
+}
+
+/// Immediate handle for a boolean
+pub fn boolean(b: bool) -> Handle {
+    pack(KIND_BOOL, u64::from(b))
+}
+
+/// Immediate handle for an int, if it fits
+pub fn int(i: i64) -> Option<Handle> {
+    (INT_MIN..=INT_MAX)
+        .contains(&i)
+        .then(|| pack(KIND_INT, i as u64))
+}
+
+/// Immediate handle for a real, if it is exactly representable as `f32`
+/// with the low mantissa bits clear (0.5, 612, -612.25, but not 0.1)
+pub fn real(f: f64) -> Option<Handle> {
+    let narrow = f as f32;
+    let bits = narrow.to_bits();
+    ((narrow as f64 == f || f.is_nan()) && bits & ((1 << REAL_SHIFT) - 1) == 0)
+        .then(|| pack(KIND_REAL, u64::from(bits >> REAL_SHIFT)))
+}
+
+/// Immediate handle for an interned name, if the registry has room
+pub fn name(s: &str) -> Option<Handle> {
+    pdf_name_table::intern_object_name(s)
+        .filter(|&idx| idx as u64 <= PAYLOAD_MASK)
+        .map(|idx| pack(KIND_NAME, idx as u64))
+}
+
+/// Text of an immediate name
+pub fn name_str(idx: u32) -> Option<String> {
+    pdf_name_table::interned_name(idx as usize)
+}
+
+/// NUL-terminated text of an immediate name, valid for the process lifetime
+pub fn name_ptr(idx: u32) -> Option<*const c_char> {
+    pdf_name_table::interned_name_ptr(idx as usize)
+}
+
+/// Encode a scalar object as an immediate handle
+///
+/// Returns `None` for containers, strings, indirect references and scalars
+/// that don't fit, which callers store as regular objects.
+pub fn encode(obj: &PdfObj) -> Option<Handle> {
+    match &obj.obj_type {
+        PdfObjType::Null => Some(null()),
+        PdfObjType::Bool(b) => Some(boolean(*b)),
+        PdfObjType::Int(i) => int(*i),
+        PdfObjType::Real(f) => real(*f),
+        PdfObjType::Name(s) => name(s),
+        _ => None,
+    }
+}
+
+/// Materialize an immediate as a regular object
+pub fn to_obj(imm: Immediate) -> PdfObj {
+    match imm {
+        Immediate::Null => PdfObj::new_null(),
+        Immediate::Bool(b) => PdfObj::new_bool(b),
+        Immediate::Int(i) => PdfObj::new_int(i),
+        Immediate::Real(f) => PdfObj::new_real(f as f64),
+        Immediate::Name(idx) => PdfObj::new_name(&name_str(idx).unwrap_or_default()),
+    }
+}
+
+// ============================================================================
+// FFI Functions
+// ============================================================================
+
+/// Check whether an object handle is an immediate (tagged) value
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_obj_is_immediate(_ctx: Handle, obj: Handle) -> i32 {
+    i32::from(decode(obj).is_some())
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_int_round_trip() {
+        for v in [0, 1, -1, 42, -65536, 10_000_000, INT_MIN, INT_MAX] {
+            let h = int(v).unwrap();
+            assert!(is_immediate(h));
+            // A positive int32_t, as the C headers pass pdf_obj
+            assert!(i32::try_from(h).is_ok());
+            assert_eq!(decode(h), Some(Immediate::Int(v)));
+        }
+        assert!(int(INT_MAX + 1).is_none());
+        assert!(int(INT_MIN - 1).is_none());
+        assert!(int(i32::MAX as i64).is_none());
+        assert!(int(i64::MIN).is_none());
+    }
+
+    #[test]
+    fn test_real_round_trip() {
+        let h = real(0.5).unwrap();
+        assert_eq!(decode(h), Some(Immediate::Real(0.5)));
+        assert_eq!(
+            decode(real(-612.25).unwrap()),
+            Some(Immediate::Real(-612.25))
+        );
+        assert_eq!(decode(real(612.0).unwrap()), Some(Immediate::Real(612.0)));
+        // Needs f64 precision, so it must stay a stored object
+        assert!(real(0.1).is_none());
+        // Needs the low mantissa bits the payload drops
+        assert!(real(f64::from(1.0 + f32::EPSILON)).is_none());
+    }
+
+    #[test]
+    fn test_names_are_interned() {
+        let a = name("MediaBox").unwrap();
+        let b = name("MediaBox").unwrap();
+        assert_eq!(a, b);
+        assert_ne!(a, name("CropBox").unwrap());
+
+        let Some(Immediate::Name(idx)) = decode(a) else {
+            panic!("expected a name");
+        };
+        assert_eq!(name_str(idx).unwrap(), "MediaBox");
+        // Same index as the name registry hands out
+        assert_eq!(
+            pdf_name_table::pdf_lookup_name(c"MediaBox".as_ptr()),
+            idx as i32
+        );
+        let text = unsafe { std::ffi::CStr::from_ptr(name_ptr(idx).unwrap()) };
+        assert_eq!(text.to_str().unwrap(), "MediaBox");
+    }
+
+    #[test]
+    fn test_handles_survive_the_int32_c_abi() {
+        use super::super::check::pdf_is_null;
+        use super::super::create::{pdf_new_bool, pdf_new_int, pdf_new_name, pdf_new_null};
+        use super::super::extract::{pdf_to_bool, pdf_to_int, pdf_to_name};
+        use super::super::refcount::pdf_drop_obj;
+
+        // The C headers declare pdf_obj as int32_t: a handle goes out as
+        // the low 32 bits and comes back sign-extended
+        let through_c = |h: Handle| h as i32 as Handle;
+
+        let null = pdf_new_null(0);
+        let yes = pdf_new_bool(0, 1);
+        let name = pdf_new_name(0, c"Resources".as_ptr());
+        let stored = pdf_new_int(0, 7);
+        for h in [null, yes, name] {
+            assert!(is_immediate(h));
+            assert_eq!(through_c(h), h);
+        }
+        assert!(!is_immediate(stored));
+        assert_eq!(through_c(stored), stored);
+
+        assert_eq!(pdf_is_null(0, through_c(null)), 1);
+        assert_eq!(pdf_to_bool(0, through_c(yes)), 1);
+        let text = unsafe { std::ffi::CStr::from_ptr(pdf_to_name(0, through_c(name))) };
+        assert_eq!(text.to_str().unwrap(), "Resources");
+        assert_eq!(pdf_to_int(0, through_c(stored)), 7);
+        for v in [INT_MIN, -1, INT_MAX] {
+            let h = int(v).unwrap();
+            assert_eq!(pdf_to_int(0, through_c(h)), v as i32);
+        }
+        assert_eq!(
+            decode(through_c(real(-612.25).unwrap())),
+            Some(Immediate::Real(-612.25))
+        );
+        pdf_drop_obj(0, stored);
+    }
+
+    #[test]
+    fn test_encode_scalars_only() {
+        assert_eq!(encode(&PdfObj::new_null()), Some(null()));
+        assert_eq!(encode(&PdfObj::new_bool(true)), Some(boolean(true)));
+        assert!(encode(&PdfObj::new_string(b"abc")).is_none());
+        assert!(encode(&PdfObj::new_dict(0)).is_none());
+        assert!(encode(&PdfObj::new_indirect(1, 0)).is_none());
+
+        let obj = to_obj(decode(encode(&PdfObj::new_int(-7)).unwrap()).unwrap());
+        assert!(matches!(obj.obj_type, PdfObjType::Int(-7)));
+    }
+}
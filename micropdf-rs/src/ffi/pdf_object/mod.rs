@@ -10,7 +10,9 @@ pub mod compare;
 pub mod copy;
 pub mod create;
 pub mod dict;
+pub mod dict_table;
 pub mod extract;
+pub mod immediate;
 pub mod marking;
 pub mod refcount;
 pub mod string;
@@ -26,6 +28,7 @@ pub use copy::*;
 pub use create::*;
 pub use dict::*;
 pub use extract::*;
+pub use immediate::pdf_obj_is_immediate;
 pub use marking::*;
 pub use refcount::*;
 pub use string::*;
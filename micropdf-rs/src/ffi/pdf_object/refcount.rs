@@ -1,10 +1,19 @@
 //! PDF Object Reference Counting FFI Functions
 
 use super::super::Handle;
+use super::arena::{self, ArenaHandle};
+use super::immediate;
 use super::types::{PDF_OBJECTS, PdfObj, PdfObjHandle};
 
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_keep_obj(_ctx: Handle, obj: PdfObjHandle) -> PdfObjHandle {
+    if immediate::is_immediate(obj) {
+        return obj;
+    }
+    if ArenaHandle::is_arena_handle(obj) {
+        arena::with_arena_obj_mut(obj, (), |o| o.refs += 1);
+        return obj;
+    }
     if let Some(arc) = PDF_OBJECTS.get(obj) {
         if let Ok(mut guard) = arc.lock() {
             guard.refs += 1;
@@ -15,6 +24,13 @@ pub extern "C" fn pdf_keep_obj(_ctx: Handle, obj: PdfObjHandle) -> PdfObjHandle
 
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_drop_obj(_ctx: Handle, obj: PdfObjHandle) {
+    if immediate::is_immediate(obj) {
+        return;
+    }
+    if ArenaHandle::is_arena_handle(obj) {
+        arena::release_arena_obj(obj);
+        return;
+    }
     if let Some(arc) = PDF_OBJECTS.get(obj) {
         let should_remove = {
             if let Ok(mut guard) = arc.lock() {
@@ -30,8 +46,17 @@ pub extern "C" fn pdf_drop_obj(_ctx: Handle, obj: PdfObjHandle) {
     }
 }
 
-// Helper functions for accessing objects
-pub(super) fn with_obj<T, F: FnOnce(&PdfObj) -> T>(obj: PdfObjHandle, default: T, f: F) -> T {
+// Helper functions for accessing objects; arena handles resolve through
+// their arena so every pdf_* accessor works on arena-resident objects.
+// Immediates are decoded into a temporary; hot accessors decode them
+// directly instead of coming through here.
+pub(crate) fn with_obj<T, F: FnOnce(&PdfObj) -> T>(obj: PdfObjHandle, default: T, f: F) -> T {
+    if let Some(imm) = immediate::decode(obj) {
+        return f(&immediate::to_obj(imm));
+    }
+    if ArenaHandle::is_arena_handle(obj) {
+        return arena::with_arena_obj(obj, default, f);
+    }
     PDF_OBJECTS
         .get(obj)
         .and_then(|arc| arc.lock().ok().map(|guard| f(&guard)))
@@ -43,6 +68,13 @@ pub(super) fn with_obj_mut<T, F: FnOnce(&mut PdfObj) -> T>(
     default: T,
     f: F,
 ) -> T {
+    // Immediates are values; there is nothing to mutate
+    if immediate::is_immediate(obj) {
+        return default;
+    }
+    if ArenaHandle::is_arena_handle(obj) {
+        return arena::with_arena_obj_mut(obj, default, f);
+    }
     PDF_OBJECTS
         .get(obj)
         .and_then(|arc| arc.lock().ok().map(|mut guard| f(&mut guard)))
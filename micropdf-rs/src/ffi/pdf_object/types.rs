@@ -1,6 +1,7 @@
 //! PDF Object Types and Core Data Structures
 
 use super::super::{Handle, HandleStore};
+use super::dict_table::PdfDict;
 use std::sync::LazyLock;
 
 /// PDF Object type enumeration
@@ -13,7 +14,7 @@ pub enum PdfObjType {
     Name(String),
     String(Vec<u8>),
     Array(Vec<PdfObj>),
-    Dict(Vec<(String, PdfObj)>),
+    Dict(PdfDict),
     Indirect { num: i32, generation: i32 },
     Stream { dict: Box<PdfObj>, data: Vec<u8> },
 }
@@ -129,7 +130,7 @@ impl PdfObj {
 
     pub fn new_dict(cap: usize) -> Self {
         Self {
-            obj_type: PdfObjType::Dict(Vec::with_capacity(cap)),
+            obj_type: PdfObjType::Dict(PdfDict::with_capacity(cap)),
             marked: false,
             dirty: false,
             parent_num: 0,
@@ -92,17 +92,13 @@ pub extern "C" fn pdf_dict_get_key(_ctx: Handle, dict: PdfObjHandle, index: i32)
     let key = with_obj(dict, None, |o| match &o.obj_type {
         PdfObjType::Dict(entries) => {
             let idx = index as usize;
-            if idx < entries.len() {
-                Some(PdfObj::new_name(&entries[idx].0))
-            } else {
-                None
-            }
+            entries.entry_at(idx).map(|(k, _)| PdfObj::new_name(k))
         }
         _ => None,
     });
 
     match key {
-        Some(k) => PDF_OBJECTS.insert(k),
+        Some(k) => super::arena::alloc_like(dict, k),
         None => 0,
     }
 }
@@ -112,17 +108,13 @@ pub extern "C" fn pdf_dict_get_val(_ctx: Handle, dict: PdfObjHandle, index: i32)
     let val = with_obj(dict, None, |o| match &o.obj_type {
         PdfObjType::Dict(entries) => {
             let idx = index as usize;
-            if idx < entries.len() {
-                Some(entries[idx].1.clone())
-            } else {
-                None
-            }
+            entries.entry_at(idx).map(|(_, v)| v.clone())
         }
         _ => None,
     });
 
     match val {
-        Some(v) => PDF_OBJECTS.insert(v),
+        Some(v) => super::arena::alloc_like(dict, v),
         None => 0,
     }
 }
@@ -158,7 +150,7 @@ pub extern "C" fn pdf_resolve_indirect(
     }
 
     // Check if object exists
-    if PDF_OBJECTS.get(obj).is_some() {
+    if with_obj(obj, false, |_| true) {
         // For indirect objects, we would normally resolve them here
         // For now, just return the same handle since we don't maintain
         // a true xref table in this FFI layer
@@ -196,7 +188,7 @@ pub extern "C" fn pdf_load_object(
     // These are document-level features, not FFI-level. The FFI correctly
     // creates an indirect reference object with the requested num/generation.
     // Full object loading requires integration with the document parser layer.
-    PDF_OBJECTS.insert(PdfObj::new_indirect(num, generation))
+    super::arena::new_document_object(_doc, PdfObj::new_indirect(num, generation))
 }
 
 /// Check if an indirect reference has been resolved/loaded
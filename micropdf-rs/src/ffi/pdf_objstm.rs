@@ -0,0 +1,303 @@
+//! Object Stream Packing
+//!
+//! A save with object streams packs the plain (non-stream) objects into
+//! compressed streams and finishes with an xref stream. Which objects
+//! share a stream decides what a lazy reader has to inflate: objects are
+//! grouped by the first page that reaches them, in page order, after a
+//! group of the document-level objects nothing on a page reaches (the
+//! catalog, the page tree, ...). Opening page N then inflates that page's
+//! streams and no one else's. Streams are capped in size so one object
+//! never costs inflating a large stream, and are compressed on a pool of
+//! threads.
+
+use super::pdf_parse::ParsedValue;
+use super::pdf_stream_prefetch::parallel_map;
+use super::pdf_write::{Counting, PdfSink, write_value};
+use super::pdf_xref_lazy::collect_refs;
+use crate::pdf::filter::encode_flate;
+use std::collections::{HashMap, HashSet};
+use std::io;
+
+/// Most objects packed into one stream
+const MAX_MEMBERS: usize = 200;
+
+/// Most member text packed into one stream, before compression
+const MAX_STREAM_BYTES: usize = 32 << 10;
+
+/// Collects objects as they are written, to pack the plain ones at the end
+#[derive(Default)]
+pub(crate) struct Packer {
+    /// Serialized value of each object held for packing
+    held: HashMap<i32, Vec<u8>>,
+    /// Objects each written object refers to (streams included)
+    links: HashMap<i32, Vec<i32>>,
+}
+
+/// An object stream ready to write
+pub(crate) struct PackedStream {
+    pub(crate) num: i32,
+    pub(crate) dict: ParsedValue,
+    pub(crate) data: Vec<u8>,
+    /// Packed objects, by index in the stream
+    pub(crate) members: Vec<i32>,
+}
+
+/// Where an object lives in a file with an xref stream
+#[derive(Clone, Copy)]
+pub(crate) enum XrefRow {
+    Free,
+    /// Byte offset and generation
+    Offset(usize, u16),
+    /// Object stream number and index in it
+    Packed(i32, u16),
+}
+
+impl Packer {
+    /// Note the objects `num` refers to, for grouping
+    pub(crate) fn link(&mut self, num: i32, value: &ParsedValue) {
+        let mut refs = Vec::new();
+        collect_refs(value, &mut refs);
+        if !refs.is_empty() {
+            self.links.insert(num, refs);
+        }
+    }
+
+    /// Hold plain object `num`, serialized, to pack instead of writing it
+    pub(crate) fn hold(&mut self, num: i32, value: &ParsedValue) {
+        let mut text = Vec::new();
+        write_value(value, &mut text);
+        self.held.insert(num, text);
+    }
+
+    /// Held objects grouped into stream member lists: document-level
+    /// objects first, then each page's in `pages` order
+    fn groups(&self, pages: &[i32]) -> Vec<Vec<i32>> {
+        let page_set: HashSet<i32> = pages.iter().copied().collect();
+        let mut seen = HashSet::new();
+        let mut groups = Vec::with_capacity(pages.len() + 1);
+        for &page in pages {
+            let mut group = Vec::new();
+            let mut stack = vec![page];
+            while let Some(num) = stack.pop() {
+                if !seen.insert(num) {
+                    continue;
+                }
+                if self.held.contains_key(&num) {
+                    group.push(num);
+                }
+                let links = self.links.get(&num).into_iter().flatten();
+                // Other pages (through annotations' /P, say) get their own
+                stack.extend(links.filter(|n| !page_set.contains(n)));
+            }
+            group.sort_unstable();
+            groups.push(group);
+        }
+
+        let mut shared: Vec<i32> = self
+            .held
+            .keys()
+            .copied()
+            .filter(|n| !seen.contains(n))
+            .collect();
+        shared.sort_unstable();
+        groups.insert(0, shared);
+        groups
+    }
+
+    /// Pack the held objects into streams numbered from `first_num`,
+    /// deflated on `threads` threads at level `compress` if given
+    pub(crate) fn pack(
+        mut self,
+        pages: &[i32],
+        first_num: i32,
+        compress: Option<u32>,
+        threads: usize,
+    ) -> Vec<PackedStream> {
+        let mut chunks = Vec::new();
+        for group in self.groups(pages) {
+            let mut chunk = Vec::new();
+            let mut bytes = 0;
+            for num in group {
+                let len = self.held[&num].len();
+                if !chunk.is_empty()
+                    && (chunk.len() >= MAX_MEMBERS || bytes + len > MAX_STREAM_BYTES)
+                {
+                    chunks.push(std::mem::take(&mut chunk));
+                    bytes = 0;
+                }
+                chunk.push(num);
+                bytes += len + 1;
+            }
+            if !chunk.is_empty() {
+                chunks.push(chunk);
+            }
+        }
+
+        let bodies: Vec<(Vec<i32>, Vec<u8>, usize)> = chunks
+            .into_iter()
+            .map(|members| {
+                let mut header = Vec::new();
+                let mut body = Vec::new();
+                for &num in &members {
+                    header.extend_from_slice(format!("{num} {} ", body.len()).as_bytes());
+                    body.append(self.held.get_mut(&num).expect("member is held"));
+                    body.push(b'\n');
+                }
+                header.push(b'\n');
+                let first = header.len();
+                header.append(&mut body);
+                (members, header, first)
+            })
+            .collect();
+
+        let packed = parallel_map(&bodies, threads, |(_, data, _)| {
+            compress.and_then(|level| encode_flate(data, level).ok())
+        });
+
+        bodies
+            .into_iter()
+            .zip(packed)
+            .zip(first_num..)
+            .map(|(((members, plain, first), packed), num)| {
+                let mut dict = vec![
+                    ("Type".to_string(), ParsedValue::Name("ObjStm".into())),
+                    ("N".to_string(), ParsedValue::Int(members.len() as i64)),
+                    ("First".to_string(), ParsedValue::Int(first as i64)),
+                ];
+                let data = match packed {
+                    Some(packed) => {
+                        dict.push((
+                            "Filter".to_string(),
+                            ParsedValue::Name("FlateDecode".into()),
+                        ));
+                        packed
+                    }
+                    None => plain,
+                };
+                dict.push(("Length".to_string(), ParsedValue::Int(data.len() as i64)));
+                PackedStream {
+                    num,
+                    dict: ParsedValue::Dict(dict),
+                    data,
+                    members,
+                }
+            })
+            .collect()
+    }
+}
+
+/// Bytes needed to store `value` big-endian
+fn width(value: usize) -> usize {
+    (usize::BITS - value.leading_zeros()).div_ceil(8).max(1) as usize
+}
+
+/// Finish a file with an xref stream, object `rows.len()`, over `rows`
+/// (indexed by object number) with `trailer`'s entries, then flush
+pub(crate) fn write_xref_stream<S: PdfSink>(
+    out: &mut Counting<S>,
+    mut rows: Vec<XrefRow>,
+    trailer: Vec<(String, ParsedValue)>,
+    compress: Option<u32>,
+) -> io::Result<()> {
+    let num = rows.len().max(1);
+    rows.resize(num, XrefRow::Free);
+    rows.push(XrefRow::Offset(out.pos, 0));
+
+    let widest = rows
+        .iter()
+        .map(|row| match *row {
+            XrefRow::Free => 0,
+            XrefRow::Offset(offset, _) => offset,
+            XrefRow::Packed(stream, _) => stream as usize,
+        })
+        .max()
+        .unwrap_or(0);
+    let w = width(widest);
+    let mut table = Vec::with_capacity(rows.len() * (w + 3));
+    for (i, row) in rows.iter().enumerate() {
+        let (kind, field, extra) = match *row {
+            XrefRow::Free if i == 0 => (0u8, 0, 0xffff),
+            XrefRow::Free => (0, 0, 0),
+            XrefRow::Offset(offset, generation) => (1, offset, generation),
+            XrefRow::Packed(stream, index) => (2, stream as usize, index),
+        };
+        table.push(kind);
+        table.extend_from_slice(&field.to_be_bytes()[size_of::<usize>() - w..]);
+        table.extend_from_slice(&extra.to_be_bytes());
+    }
+
+    let mut dict = vec![
+        ("Type".to_string(), ParsedValue::Name("XRef".into())),
+        ("Size".to_string(), ParsedValue::Int(rows.len() as i64)),
+        (
+            "W".to_string(),
+            ParsedValue::Array(vec![
+                ParsedValue::Int(1),
+                ParsedValue::Int(w as i64),
+                ParsedValue::Int(2),
+            ]),
+        ),
+    ];
+    dict.extend(trailer);
+    if let Some(packed) = compress.and_then(|level| encode_flate(&table, level).ok()) {
+        dict.push((
+            "Filter".to_string(),
+            ParsedValue::Name("FlateDecode".into()),
+        ));
+        table = packed;
+    }
+    dict.push(("Length".to_string(), ParsedValue::Int(table.len() as i64)));
+
+    let xref_offset = out.pos;
+    let mut buf = format!("{num} 0 obj\n").into_bytes();
+    write_value(&ParsedValue::Dict(dict), &mut buf);
+    buf.extend_from_slice(b"\nstream\n");
+    out.put(&buf)?;
+    out.put(&table)?;
+    out.put(format!("\nendstream\nendobj\nstartxref\n{xref_offset}\n%%EOF\n").as_bytes())?;
+    out.inner.finish()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn dict(refs: &[i32]) -> ParsedValue {
+        ParsedValue::Array(
+            refs.iter()
+                .map(|&num| ParsedValue::Reference { num, generation: 0 })
+                .collect(),
+        )
+    }
+
+    #[test]
+    fn test_groups_follow_first_page() {
+        let mut packer = Packer::default();
+        // 1 catalog -> 2 pages; pages 3 and 4 share font 5, page 4 has 6
+        for (num, refs) in [
+            (1, &[2][..]),
+            (2, &[3, 4]),
+            (3, &[5]),
+            (4, &[5, 6, 3]),
+            (5, &[]),
+            (6, &[]),
+        ] {
+            packer.link(num, &dict(refs));
+            packer.hold(num, &dict(refs));
+        }
+        assert_eq!(packer.groups(&[3, 4]), [vec![1, 2], vec![3, 5], vec![4, 6]]);
+    }
+
+    #[test]
+    fn test_pack_caps_members() {
+        let mut packer = Packer::default();
+        for num in 1..=(MAX_MEMBERS as i32 + 1) {
+            packer.hold(num, &ParsedValue::Int(i64::from(num)));
+        }
+        let streams = packer.pack(&[], 500, None, 2);
+        assert_eq!(streams.len(), 2);
+        assert_eq!(streams[1].num, 501);
+        assert_eq!(streams[1].members, [MAX_MEMBERS as i32 + 1]);
+        assert!(streams[0].data.starts_with(b"1 0 2 2 3 4 "));
+    }
+}
@@ -0,0 +1,809 @@
+//! Content stream opcodes, operands and lexer
+//!
+//! Operators map to a dense `Opcode` through a perfect hash of their (at
+//! most three) bytes: one multiply and shift picks a slot in a 256-entry
+//! table and one compare confirms the name. The table is built at compile
+//! time, and the build fails if two operators ever share a slot.
+//!
+//! Operands are lexed into a fixed-size `OperandStack` that borrows from
+//! the content bytes, so tokenizing a stream allocates nothing: strings,
+//! arrays and dictionaries are kept as spans of the input and decoded
+//! only by the operators that use them.
+//!
+//! A stream interpreted more than once can be compiled to a
+//! `ContentProgram`, which keeps the lexed operators and parsed operands
+//! for replay.
+
+use super::pdf_optimize::{inline_image_end, is_delimiter, is_number, is_space, token_end};
+
+/// Content stream operators, numbered densely from 0
+#[repr(u8)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Opcode {
+    W,
+    UpperJ,
+    J,
+    UpperM,
+    D,
+    Ri,
+    I,
+    Gs,
+    Q,
+    UpperQ,
+    Cm,
+    M,
+    L,
+    C,
+    V,
+    Y,
+    H,
+    Re,
+    UpperS,
+    S,
+    F,
+    UpperF,
+    FStar,
+    UpperB,
+    UpperBStar,
+    B,
+    BStar,
+    N,
+    UpperW,
+    UpperWStar,
+    BT,
+    ET,
+    Tc,
+    Tw,
+    Tz,
+    TL,
+    Tf,
+    Tr,
+    Ts,
+    Td,
+    TD,
+    Tm,
+    TStar,
+    Tj,
+    TJ,
+    SQuote,
+    DQuote,
+    D0,
+    D1,
+    CS,
+    Cs,
+    SC,
+    SCN,
+    Sc,
+    Scn,
+    UpperG,
+    G,
+    RG,
+    Rg,
+    UpperK,
+    K,
+    BI,
+    ID,
+    EI,
+    Sh,
+    Do,
+    MP,
+    DP,
+    BMC,
+    BDC,
+    EMC,
+    BX,
+    EX,
+}
+
+/// Every opcode, indexed by its value
+const OPCODES: [Opcode; 73] = {
+    use Opcode::*;
+    [
+        W, UpperJ, J, UpperM, D, Ri, I, Gs, Q, UpperQ, Cm, M, L, C, V, Y, H, Re, UpperS, S, F,
+        UpperF, FStar, UpperB, UpperBStar, B, BStar, N, UpperW, UpperWStar, BT, ET, Tc, Tw, Tz, TL,
+        Tf, Tr, Ts, Td, TD, Tm, TStar, Tj, TJ, SQuote, DQuote, D0, D1, CS, Cs, SC, SCN, Sc, Scn,
+        UpperG, G, RG, Rg, UpperK, K, BI, ID, EI, Sh, Do, MP, DP, BMC, BDC, EMC, BX, EX,
+    ]
+};
+
+/// Operator names, indexed by opcode
+const NAMES: [&str; 73] = [
+    "w", "J", "j", "M", "d", "ri", "i", "gs", "q", "Q", "cm", "m", "l", "c", "v", "y", "h", "re",
+    "S", "s", "f", "F", "f*", "B", "B*", "b", "b*", "n", "W", "W*", "BT", "ET", "Tc", "Tw", "Tz",
+    "TL", "Tf", "Tr", "Ts", "Td", "TD", "Tm", "T*", "Tj", "TJ", "'", "\"", "d0", "d1", "CS", "cs",
+    "SC", "SCN", "sc", "scn", "G", "g", "RG", "rg", "K", "k", "BI", "ID", "EI", "sh", "Do", "MP",
+    "DP", "BMC", "BDC", "EMC", "BX", "EX",
+];
+
+/// Multiplier of the operator hash, found by search so that no two
+/// operators collide
+const HASH_MULTIPLIER: u32 = 0xCEAE_C73D;
+
+/// Marks an empty slot in `HASH_TABLE`
+const EMPTY: u8 = u8::MAX;
+
+/// An operator name of up to three bytes, packed little-endian
+const fn pack(name: &[u8]) -> u32 {
+    let mut key = 0;
+    let mut i = 0;
+    while i < name.len() {
+        key |= (name[i] as u32) << (8 * i);
+        i += 1;
+    }
+    key
+}
+
+const fn slot(key: u32) -> usize {
+    (key.wrapping_mul(HASH_MULTIPLIER) >> 24) as usize
+}
+
+/// Opcode values by hash slot
+const HASH_TABLE: [u8; 256] = {
+    let mut table = [EMPTY; 256];
+    let mut op = 0;
+    while op < NAMES.len() {
+        assert!(OPCODES[op] as usize == op, "opcodes must be dense");
+        let s = slot(pack(NAMES[op].as_bytes()));
+        assert!(table[s] == EMPTY, "operator hash collision");
+        table[s] = op as u8;
+        op += 1;
+    }
+    table
+};
+
+impl Opcode {
+    /// The opcode of an operator token, or None for unknown operators
+    #[inline]
+    pub fn from_name(name: &[u8]) -> Option<Opcode> {
+        if name.is_empty() || name.len() > 3 {
+            return None;
+        }
+        let op = HASH_TABLE[slot(pack(name))];
+        (op != EMPTY && NAMES[op as usize].as_bytes() == name).then(|| OPCODES[op as usize])
+    }
+
+    /// The operator as written in a content stream
+    pub fn name(self) -> &'static str {
+        NAMES[self as usize]
+    }
+}
+
+// ============================================================================
+// Operands
+// ============================================================================
+
+/// One operand, borrowing from the content stream
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum Operand<'a> {
+    Number(f32),
+    /// A name without its slash
+    Name(&'a [u8]),
+    /// A literal string, parentheses included
+    String(&'a [u8]),
+    /// A hex string, angle brackets included
+    HexString(&'a [u8]),
+    /// An array, brackets included
+    Array(&'a [u8]),
+    /// A dictionary, angle brackets included
+    Dict(&'a [u8]),
+    /// `true`, `false` or `null`
+    Keyword(&'a [u8]),
+}
+
+impl Operand<'_> {
+    pub fn as_number(&self) -> Option<f32> {
+        match *self {
+            Operand::Number(n) => Some(n),
+            _ => None,
+        }
+    }
+
+    /// The name as text, or "" if it isn't UTF-8
+    pub fn as_name(&self) -> Option<&str> {
+        match *self {
+            Operand::Name(name) => Some(std::str::from_utf8(name).unwrap_or("")),
+            _ => None,
+        }
+    }
+
+    /// Decode a literal or hex string into `out`, replacing its contents;
+    /// false if this isn't a string
+    pub fn string_into(&self, out: &mut Vec<u8>) -> bool {
+        out.clear();
+        match *self {
+            Operand::String(raw) => decode_literal(raw, out),
+            Operand::HexString(raw) => decode_hex(raw, out),
+            _ => return false,
+        }
+        true
+    }
+}
+
+/// Decode the literal string `raw`, parentheses included
+fn decode_literal(raw: &[u8], out: &mut Vec<u8>) {
+    let body = &raw[1..raw.len() - usize::from(raw.ends_with(b")") && raw.len() > 1)];
+    let mut i = 0;
+    while i < body.len() {
+        let b = body[i];
+        i += 1;
+        if b == b'\r' {
+            // End-of-line markers read as a single newline
+            if body.get(i) == Some(&b'\n') {
+                i += 1;
+            }
+            out.push(b'\n');
+            continue;
+        }
+        if b != b'\\' {
+            out.push(b);
+            continue;
+        }
+        let Some(&e) = body.get(i) else {
+            break;
+        };
+        i += 1;
+        match e {
+            b'n' => out.push(b'\n'),
+            b'r' => out.push(b'\r'),
+            b't' => out.push(b'\t'),
+            b'b' => out.push(0x08),
+            b'f' => out.push(0x0C),
+            b'0'..=b'7' => {
+                let mut value = u32::from(e - b'0');
+                for _ in 0..2 {
+                    match body.get(i) {
+                        Some(&d @ b'0'..=b'7') => {
+                            value = value * 8 + u32::from(d - b'0');
+                            i += 1;
+                        }
+                        _ => break,
+                    }
+                }
+                out.push(value as u8);
+            }
+            // A backslash before an end-of-line continues the string
+            b'\r' => {
+                if body.get(i) == Some(&b'\n') {
+                    i += 1;
+                }
+            }
+            b'\n' => {}
+            other => out.push(other),
+        }
+    }
+}
+
+/// Decode the hex string `raw`, angle brackets included
+fn decode_hex(raw: &[u8], out: &mut Vec<u8>) {
+    let mut high = None;
+    for &b in raw.iter().skip(1) {
+        let nibble = match b {
+            b'0'..=b'9' => b - b'0',
+            b'a'..=b'f' => b - b'a' + 10,
+            b'A'..=b'F' => b - b'A' + 10,
+            b'>' => break,
+            _ => continue,
+        };
+        match high.take() {
+            Some(h) => out.push(h << 4 | nibble),
+            None => high = Some(nibble),
+        }
+    }
+    // An odd final digit is followed by an implied 0
+    if let Some(h) = high {
+        out.push(h << 4);
+    }
+}
+
+/// Parse a number token; malformed numbers read as 0
+pub fn parse_number(token: &[u8]) -> f32 {
+    let (negative, digits) = match token.first() {
+        Some(b'-') => (true, &token[1..]),
+        Some(b'+') => (false, &token[1..]),
+        _ => (false, token),
+    };
+    let mut value = 0f64;
+    let mut scale = 0f64;
+    for &b in digits {
+        match b {
+            b'0'..=b'9' if scale == 0.0 => value = value * 10.0 + f64::from(b - b'0'),
+            b'0'..=b'9' => {
+                value += f64::from(b - b'0') * scale;
+                scale *= 0.1;
+            }
+            b'.' if scale == 0.0 => scale = 0.1,
+            _ => break,
+        }
+    }
+    (if negative { -value } else { value }) as f32
+}
+
+/// Operands kept before an operator; PDF content needs far fewer
+pub const OPERAND_STACK_SIZE: usize = 48;
+
+/// Operands waiting for their operator, in a fixed-size array
+///
+/// Pushing past the capacity drops the operand and marks the stack as
+/// overflowed, so the operator it belongs to can be skipped.
+#[derive(Debug)]
+pub struct OperandStack<'a> {
+    items: [Operand<'a>; OPERAND_STACK_SIZE],
+    len: usize,
+    overflowed: bool,
+}
+
+impl<'a> OperandStack<'a> {
+    pub fn new() -> Self {
+        Self {
+            items: [Operand::Number(0.0); OPERAND_STACK_SIZE],
+            len: 0,
+            overflowed: false,
+        }
+    }
+
+    #[inline]
+    pub fn push(&mut self, operand: Operand<'a>) {
+        if self.len < OPERAND_STACK_SIZE {
+            self.items[self.len] = operand;
+            self.len += 1;
+        } else {
+            self.overflowed = true;
+        }
+    }
+
+    #[inline]
+    pub fn clear(&mut self) {
+        self.len = 0;
+        self.overflowed = false;
+    }
+
+    pub fn overflowed(&self) -> bool {
+        self.overflowed
+    }
+
+    /// The operands, bottom first
+    pub fn as_slice(&self) -> &[Operand<'a>] {
+        &self.items[..self.len]
+    }
+
+    /// The top `N` operands as numbers, or None if any isn't one
+    #[inline]
+    pub fn numbers<const N: usize>(&self) -> Option<[f32; N]> {
+        let top = self.len.checked_sub(N)?;
+        let mut out = [0.0; N];
+        for (o, item) in out.iter_mut().zip(&self.items[top..self.len]) {
+            *o = item.as_number()?;
+        }
+        Some(out)
+    }
+
+    /// The operand `depth` places below the top (0 for the top)
+    #[inline]
+    pub fn top(&self, depth: usize) -> Option<&Operand<'a>> {
+        self.items[..self.len].iter().rev().nth(depth)
+    }
+}
+
+impl Default for OperandStack<'_> {
+    fn default() -> Self {
+        Self::new()
+    }
+}
+
+// ============================================================================
+// Lexer
+// ============================================================================
+
+/// A lexed content stream token
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub enum Token<'a> {
+    Operand(Operand<'a>),
+    /// An operator, with its opcode if it is known
+    Operator(Option<Opcode>, &'a [u8]),
+}
+
+/// Tokenizer over content stream bytes
+pub struct ContentLexer<'a> {
+    data: &'a [u8],
+    pos: usize,
+}
+
+impl<'a> ContentLexer<'a> {
+    pub fn new(data: &'a [u8]) -> Self {
+        Self { data, pos: 0 }
+    }
+
+    /// Skip whitespace and comments
+    fn skip_space(&mut self) {
+        while let Some(&b) = self.data.get(self.pos) {
+            if is_space(b) {
+                self.pos += 1;
+            } else if b == b'%' {
+                while self.pos < self.data.len() && !matches!(self.data[self.pos], b'\r' | b'\n') {
+                    self.pos += 1;
+                }
+            } else {
+                break;
+            }
+        }
+    }
+
+    /// End of the array or dictionary opened at `start`
+    fn group_end(&self, start: usize, open: &[u8], close: &[u8]) -> usize {
+        let mut depth = 0;
+        let mut i = start;
+        while i < self.data.len() {
+            let b = self.data[i];
+            if is_space(b) {
+                i += 1;
+                continue;
+            }
+            if b == b'%' {
+                while i < self.data.len() && !matches!(self.data[i], b'\r' | b'\n') {
+                    i += 1;
+                }
+                continue;
+            }
+            let end = token_end(self.data, i);
+            let token = &self.data[i..end];
+            if token == open {
+                depth += 1;
+            } else if token == close {
+                depth -= 1;
+                if depth == 0 {
+                    return end;
+                }
+            }
+            i = end;
+        }
+        self.data.len()
+    }
+
+    /// Skip the inline image following a `BI` operator, up to and
+    /// including its `EI`; returns the image dictionary entries
+    pub fn skip_inline_image(&mut self) -> &'a [u8] {
+        let start = self.pos;
+        let mut dict_end = self.pos;
+        while let Some(token) = self.next() {
+            if let Token::Operator(Some(Opcode::ID), _) = token {
+                break;
+            }
+            dict_end = self.pos;
+        }
+        // One whitespace byte separates ID from the data
+        let data_start = (self.pos + 1).min(self.data.len());
+        self.pos = inline_image_end(self.data, data_start);
+        &self.data[start..dict_end]
+    }
+}
+
+impl<'a> Iterator for ContentLexer<'a> {
+    type Item = Token<'a>;
+
+    fn next(&mut self) -> Option<Token<'a>> {
+        self.skip_space();
+        let start = self.pos;
+        let &b = self.data.get(start)?;
+        let (end, token) = match b {
+            b'[' => {
+                let end = self.group_end(start, b"[", b"]");
+                (end, Token::Operand(Operand::Array(&self.data[start..end])))
+            }
+            b'<' if self.data.get(start + 1) == Some(&b'<') => {
+                let end = self.group_end(start, b"<<", b">>");
+                (end, Token::Operand(Operand::Dict(&self.data[start..end])))
+            }
+            b'(' | b'<' => {
+                let end = token_end(self.data, start);
+                let raw = &self.data[start..end];
+                let operand = if b == b'(' {
+                    Operand::String(raw)
+                } else {
+                    Operand::HexString(raw)
+                };
+                (end, Token::Operand(operand))
+            }
+            b'/' => {
+                let mut end = start + 1;
+                while end < self.data.len()
+                    && !is_space(self.data[end])
+                    && !is_delimiter(self.data[end])
+                {
+                    end += 1;
+                }
+                (
+                    end,
+                    Token::Operand(Operand::Name(&self.data[start + 1..end])),
+                )
+            }
+            _ => {
+                let end = token_end(self.data, start);
+                let word = &self.data[start..end];
+                let token = if is_number(word) {
+                    Token::Operand(Operand::Number(parse_number(word)))
+                } else if matches!(word, b"true" | b"false" | b"null") {
+                    Token::Operand(Operand::Keyword(word))
+                } else {
+                    Token::Operator(Opcode::from_name(word), word)
+                };
+                (end, token)
+            }
+        };
+        self.pos = end.max(start + 1);
+        Some(token)
+    }
+}
+
+// ============================================================================
+// Pre-tokenized programs
+// ============================================================================
+
+/// Kinds of operand kept as bytes in a `ContentProgram`
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum BytesKind {
+    Name,
+    String,
+    HexString,
+    Array,
+    Dict,
+    Keyword,
+}
+
+/// An operand of a compiled program; byte operands index the program's
+/// byte arena
+#[derive(Debug, Clone, Copy)]
+enum ProgramOperand {
+    Number(f32),
+    Bytes(BytesKind, u32, u32),
+}
+
+/// A lexed content stream: each operator's opcode with its operands,
+/// numbers already parsed
+///
+/// Replaying a program skips lexing and number parsing entirely; byte
+/// operands are copied into one arena, so a program doesn't keep the
+/// stream it was compiled from. Operators that would be skipped anyway
+/// (unknown ones, and those whose operands overflowed the stack) are
+/// left out, and inline image data is dropped after its `BI`.
+#[derive(Debug, Default)]
+pub struct ContentProgram {
+    /// Opcodes with the end of their operands in `operands`
+    ops: Vec<(Opcode, u32)>,
+    operands: Vec<ProgramOperand>,
+    bytes: Vec<u8>,
+}
+
+impl ContentProgram {
+    /// Lex `data` into a program
+    pub fn compile(data: &[u8]) -> Self {
+        let mut program = Self::default();
+        let mut lexer = ContentLexer::new(data);
+        let mut first = 0;
+        while let Some(token) = lexer.next() {
+            let op = match token {
+                Token::Operand(operand) => {
+                    program.push_operand(operand);
+                    continue;
+                }
+                Token::Operator(op, _) => op,
+            };
+            let pending = program.operands.len() - first;
+            match op {
+                Some(op) if pending <= OPERAND_STACK_SIZE => {
+                    if op == Opcode::BI {
+                        lexer.skip_inline_image();
+                    }
+                    program.ops.push((op, program.operands.len() as u32));
+                }
+                // Drop the operands along with the operator
+                _ => program.truncate(first),
+            }
+            first = program.operands.len();
+        }
+        program.truncate(first);
+        program.ops.shrink_to_fit();
+        program.operands.shrink_to_fit();
+        program.bytes.shrink_to_fit();
+        program
+    }
+
+    fn push_operand(&mut self, operand: Operand) {
+        let (kind, raw) = match operand {
+            Operand::Number(n) => {
+                self.operands.push(ProgramOperand::Number(n));
+                return;
+            }
+            Operand::Name(raw) => (BytesKind::Name, raw),
+            Operand::String(raw) => (BytesKind::String, raw),
+            Operand::HexString(raw) => (BytesKind::HexString, raw),
+            Operand::Array(raw) => (BytesKind::Array, raw),
+            Operand::Dict(raw) => (BytesKind::Dict, raw),
+            Operand::Keyword(raw) => (BytesKind::Keyword, raw),
+        };
+        let start = self.bytes.len() as u32;
+        self.bytes.extend_from_slice(raw);
+        self.operands
+            .push(ProgramOperand::Bytes(kind, start, self.bytes.len() as u32));
+    }
+
+    /// Drop the operands from `first` on, and their bytes
+    fn truncate(&mut self, first: usize) {
+        if let Some(&ProgramOperand::Bytes(_, start, _)) = self.operands[first..]
+            .iter()
+            .find(|o| matches!(o, ProgramOperand::Bytes(..)))
+        {
+            self.bytes.truncate(start as usize);
+        }
+        self.operands.truncate(first);
+    }
+
+    fn operand(&self, operand: ProgramOperand) -> Operand<'_> {
+        let (kind, start, end) = match operand {
+            ProgramOperand::Number(n) => return Operand::Number(n),
+            ProgramOperand::Bytes(kind, start, end) => (kind, start as usize, end as usize),
+        };
+        let raw = &self.bytes[start..end];
+        match kind {
+            BytesKind::Name => Operand::Name(raw),
+            BytesKind::String => Operand::String(raw),
+            BytesKind::HexString => Operand::HexString(raw),
+            BytesKind::Array => Operand::Array(raw),
+            BytesKind::Dict => Operand::Dict(raw),
+            BytesKind::Keyword => Operand::Keyword(raw),
+        }
+    }
+
+    /// Replay the program, handing each operator its operands
+    pub fn replay(&self, mut f: impl FnMut(Opcode, &OperandStack)) {
+        let mut stack = OperandStack::new();
+        let mut first = 0;
+        for &(op, end) in &self.ops {
+            stack.clear();
+            for &operand in &self.operands[first..end as usize] {
+                stack.push(self.operand(operand));
+            }
+            first = end as usize;
+            f(op, &stack);
+        }
+    }
+
+    /// Number of operators
+    pub fn len(&self) -> usize {
+        self.ops.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.ops.is_empty()
+    }
+
+    /// Approximate memory used, in bytes
+    pub fn size(&self) -> usize {
+        std::mem::size_of::<Self>()
+            + self.ops.len() * std::mem::size_of::<(Opcode, u32)>()
+            + self.operands.len() * std::mem::size_of::<ProgramOperand>()
+            + self.bytes.len()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_every_operator_hashes_to_itself() {
+        for (op, name) in OPCODES.iter().zip(NAMES) {
+            assert_eq!(Opcode::from_name(name.as_bytes()), Some(*op));
+            assert_eq!(op.name(), name);
+        }
+        for unknown in [&b""[..], b"x", b"Tx", b"BXX", b"SCNX", b"f**"] {
+            assert_eq!(Opcode::from_name(unknown), None);
+        }
+    }
+
+    #[test]
+    fn test_lexer_borrows_operands() {
+        let data = b"q 1 0 0 -1 .5 +2 cm /F1 12 Tf [(a\\051b) -250 <4142>] TJ % note\n\
+                     BI /W 2 /H 1 ID \x00\xff EI /Tag <</K 1>> BDC foo";
+        let tokens: Vec<Token> = ContentLexer::new(data).collect();
+        assert_eq!(tokens[0], Token::Operator(Some(Opcode::Q), b"q"));
+        assert_eq!(tokens[4], Token::Operand(Operand::Number(-1.0)));
+        assert_eq!(tokens[5], Token::Operand(Operand::Number(0.5)));
+        assert_eq!(tokens[6], Token::Operand(Operand::Number(2.0)));
+        assert_eq!(tokens[8], Token::Operand(Operand::Name(b"F1")));
+        assert_eq!(
+            tokens[11],
+            Token::Operand(Operand::Array(b"[(a\\051b) -250 <4142>]"))
+        );
+        assert_eq!(tokens[12], Token::Operator(Some(Opcode::TJ), b"TJ"));
+
+        let mut decoded = Vec::new();
+        let mut lexer = ContentLexer::new(b"(a\\051b\\\nc) <41 42 4>");
+        let Some(Token::Operand(s)) = lexer.next() else {
+            panic!("expected a string");
+        };
+        assert!(s.string_into(&mut decoded));
+        assert_eq!(decoded, b"a)bc");
+        let Some(Token::Operand(hex)) = lexer.next() else {
+            panic!("expected a hex string");
+        };
+        assert!(hex.string_into(&mut decoded));
+        assert_eq!(decoded, b"AB@");
+
+        // Inline image data is skipped whole
+        let mut lexer = ContentLexer::new(&data[data.iter().position(|&b| b == b'B').unwrap()..]);
+        assert_eq!(lexer.next(), Some(Token::Operator(Some(Opcode::BI), b"BI")));
+        assert_eq!(lexer.skip_inline_image(), b" /W 2 /H 1");
+        assert_eq!(lexer.next(), Some(Token::Operand(Operand::Name(b"Tag"))));
+        assert_eq!(
+            lexer.next(),
+            Some(Token::Operand(Operand::Dict(b"<</K 1>>")))
+        );
+        assert_eq!(
+            lexer.next(),
+            Some(Token::Operator(Some(Opcode::BDC), b"BDC"))
+        );
+        assert_eq!(lexer.next(), Some(Token::Operator(None, b"foo")));
+        assert_eq!(lexer.next(), None);
+    }
+
+    #[test]
+    fn test_operand_stack_is_bounded() {
+        let mut stack = OperandStack::new();
+        stack.push(Operand::Name(b"F1"));
+        stack.push(Operand::Number(1.0));
+        stack.push(Operand::Number(2.0));
+        assert_eq!(stack.numbers::<2>(), Some([1.0, 2.0]));
+        assert_eq!(stack.numbers::<3>(), None);
+        assert_eq!(stack.numbers::<4>(), None);
+        assert_eq!(stack.top(2), Some(&Operand::Name(b"F1")));
+
+        for _ in 0..2 * OPERAND_STACK_SIZE {
+            stack.push(Operand::Number(0.0));
+        }
+        assert!(stack.overflowed());
+        assert_eq!(stack.as_slice().len(), OPERAND_STACK_SIZE);
+        stack.clear();
+        assert!(!stack.overflowed() && stack.as_slice().is_empty());
+    }
+
+    #[test]
+    fn test_program_replays_lexed_operators() {
+        let data = b"q 1 0 0 1 5 5 cm /F1 12 Tf [(a) 3 (b)] TJ junk 1 2 zz \
+                     BI /W 1 ID \x00 EI (x) ' Q";
+        let program = ContentProgram::compile(data);
+        let mut replayed = Vec::new();
+        program.replay(|op, stack| {
+            replayed.push(format!("{:?} {:?}", op, stack.as_slice()));
+        });
+
+        let mut direct = Vec::new();
+        let mut stack = OperandStack::new();
+        let mut lexer = ContentLexer::new(data);
+        while let Some(token) = lexer.next() {
+            match token {
+                Token::Operand(operand) => stack.push(operand),
+                Token::Operator(op, _) => {
+                    if let Some(op) = op {
+                        if op == Opcode::BI {
+                            lexer.skip_inline_image();
+                        }
+                        direct.push(format!("{:?} {:?}", op, stack.as_slice()));
+                    }
+                    stack.clear();
+                }
+            }
+        }
+        assert_eq!(program.len(), 7);
+        assert_eq!(replayed, direct);
+        // The unknown operators' operands ("1 2") were dropped with them
+        assert_eq!(program.operands.len(), 6 + 2 + 1 + 1);
+        assert_eq!(program.bytes, b"F1[(a) 3 (b)](x)");
+
+        // Stack overflows leave the operator out, as the interpreter would
+        let mut flood = b"1 ".repeat(OPERAND_STACK_SIZE + 1);
+        flood.extend_from_slice(b"w 2 w");
+        let program = ContentProgram::compile(&flood);
+        assert_eq!(program.len(), 1);
+        assert_eq!(program.operands.len(), 1);
+    }
+}
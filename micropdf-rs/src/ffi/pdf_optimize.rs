@@ -0,0 +1,366 @@
+//! Staged Optimize Pipeline
+//!
+//! Optimizing runs as stages. The page stage cleans each page's content
+//! streams on a pool of threads: comments go, whitespace is collapsed to
+//! one separator per token and one line per operator, and reals lose
+//! trailing zeros, leaving inline image data and strings untouched. A
+//! stream shared by several pages is cleaned once, for the first. Fonts
+//! are subset next if the settings ask for it (see `pdf_subset`). The
+//! document-wide stages follow in one rewrite: garbage collection,
+//! renumbering, deduplication and object streams, with every stream
+//! (de)compressed in parallel windows.
+//!
+//! A cookie, if given, counts one step per page and one for the rewrite,
+//! and is checked between pages and between write windows; an abort stops
+//! the pipeline and nothing more is written.
+
+use super::mmap::FileBytes;
+use super::pdf_parse::ParsedValue;
+use super::pdf_stream_prefetch::parallel_map;
+use super::pdf_subset::subset_font_edits;
+use super::pdf_write::{Edits, PdfSink, WriteSettings, open_source, set_key, write_opened};
+use super::pdf_xref_lazy::{as_ref, decode_stream, dict_get};
+use crate::fitz::cookie::Cookie;
+use bytes::Bytes;
+use std::collections::HashSet;
+use std::io;
+use std::sync::Arc;
+
+pub(crate) fn is_space(b: u8) -> bool {
+    matches!(b, b' ' | b'\t' | b'\r' | b'\n' | b'\x0c' | b'\0')
+}
+
+pub(crate) fn is_delimiter(b: u8) -> bool {
+    matches!(
+        b,
+        b'(' | b')' | b'<' | b'>' | b'[' | b']' | b'{' | b'}' | b'/' | b'%'
+    )
+}
+
+/// Whether `token` is a number
+pub(crate) fn is_number(token: &[u8]) -> bool {
+    !token.is_empty()
+        && token
+            .iter()
+            .all(|b| b.is_ascii_digit() || matches!(b, b'+' | b'-' | b'.'))
+        && token.iter().any(u8::is_ascii_digit)
+}
+
+/// `token` as a number, without trailing zeros after the point
+pub(crate) fn trim_number(token: &[u8]) -> &[u8] {
+    if !token.contains(&b'.') {
+        return token;
+    }
+    let mut end = token.len();
+    while token[end - 1] == b'0' {
+        end -= 1;
+    }
+    if token[end - 1] == b'.' {
+        end -= 1;
+    }
+    match &token[..end] {
+        b"" | b"-" | b"+" => b"0",
+        trimmed => trimmed,
+    }
+}
+
+/// End of the literal string starting at `data[start] == b'('`
+pub(crate) fn string_end(data: &[u8], start: usize) -> usize {
+    let mut depth = 0;
+    let mut i = start;
+    while i < data.len() {
+        match data[i] {
+            b'\\' => i += 1,
+            b'(' => depth += 1,
+            b')' => {
+                depth -= 1;
+                if depth == 0 {
+                    return i + 1;
+                }
+            }
+            _ => {}
+        }
+        i += 1;
+    }
+    data.len()
+}
+
+/// End of the inline image data starting at `start`, just past its `EI`
+pub(crate) fn inline_image_end(data: &[u8], start: usize) -> usize {
+    let mut i = start;
+    while i + 2 <= data.len() {
+        if data[i..].starts_with(b"EI")
+            && i > start
+            && is_space(data[i - 1])
+            && data
+                .get(i + 2)
+                .is_none_or(|&b| is_space(b) || is_delimiter(b))
+        {
+            return i + 2;
+        }
+        i += 1;
+    }
+    data.len()
+}
+
+/// End of the content stream token starting at `data[start]`, which
+/// isn't whitespace
+pub(crate) fn token_end(data: &[u8], start: usize) -> usize {
+    let b = data[start];
+    match b {
+        b'(' => string_end(data, start),
+        b'<' | b'>' if data.get(start + 1) == Some(&b) => start + 2,
+        b'<' => data[start..]
+            .iter()
+            .position(|&c| c == b'>')
+            .map_or(data.len(), |p| start + p + 1),
+        b'[' | b']' | b'{' | b'}' | b')' | b'>' => start + 1,
+        _ => {
+            let mut end = start + 1;
+            while end < data.len() && !is_space(data[end]) && !is_delimiter(data[end]) {
+                end += 1;
+            }
+            end
+        }
+    }
+}
+
+/// Content stream `data` rewritten with comments dropped, one space
+/// between operands and one line per operator
+pub(crate) fn clean_content(data: &[u8]) -> Vec<u8> {
+    let mut out = Vec::with_capacity(data.len());
+    let mut i = 0;
+    let mut line_start = true;
+
+    while i < data.len() {
+        let b = data[i];
+        if is_space(b) {
+            i += 1;
+            continue;
+        }
+        if b == b'%' {
+            while i < data.len() && !matches!(data[i], b'\r' | b'\n') {
+                i += 1;
+            }
+            continue;
+        }
+        if !line_start {
+            out.push(b' ');
+        }
+        line_start = false;
+        let end = token_end(data, i);
+        let token = &data[i..end];
+        i = end;
+
+        if b == b'/' || !token[0].is_ascii_alphabetic() && !matches!(b, b'\'' | b'"' | b'*') {
+            out.extend_from_slice(if is_number(token) {
+                trim_number(token)
+            } else {
+                token
+            });
+            continue;
+        }
+        if matches!(token, b"true" | b"false" | b"null") {
+            out.extend_from_slice(token);
+            continue;
+        }
+        // An operator ends the line
+        out.extend_from_slice(token);
+        if token == b"ID" {
+            // One whitespace byte, then binary data up to EI
+            let data_start = (i + 1).min(data.len());
+            let data_end = inline_image_end(data, data_start);
+            out.push(b' ');
+            out.extend_from_slice(&data[data_start..data_end]);
+            i = data_end;
+        }
+        out.push(b'\n');
+        line_start = true;
+    }
+    out
+}
+
+/// A content stream claimed by a page, as read from the source
+struct ContentStream {
+    num: i32,
+    dict: ParsedValue,
+    raw: Bytes,
+}
+
+/// Count one step on `cookie`; false if it asks to abort
+fn step(cookie: Option<&Cookie>) -> bool {
+    match cookie {
+        Some(cookie) if cookie.should_abort() => false,
+        Some(cookie) => {
+            cookie.inc_progress();
+            true
+        }
+        None => true,
+    }
+}
+
+/// Optimize the document in `data` into `out`, running the page stage on
+/// `settings.threads` threads then the document-wide stages `settings`
+/// asks for
+///
+/// Returns `None` if the document can't be read, and an `Interrupted`
+/// error if `cookie` aborted it.
+pub fn optimize_document<S: PdfSink>(
+    data: Arc<FileBytes>,
+    settings: &WriteSettings,
+    cookie: Option<&Cookie>,
+    out: S,
+) -> Option<io::Result<()>> {
+    let mut xref = open_source(&data, settings.threads)?;
+    xref.read_all_sections();
+    let encrypted = dict_get(xref.source_trailer()?, "Encrypt").is_some();
+    let pages: Vec<i32> = (0..).map_while(|i| xref.lazy_page_object(i)).collect();
+    if let Some(cookie) = cookie {
+        cookie.set_progress(0);
+        cookie.set_progress_max(pages.len() as i32 + 1);
+    }
+
+    // Each page claims the content streams no earlier page has
+    let mut claimed = HashSet::new();
+    let mut work: Vec<Vec<ContentStream>> = Vec::with_capacity(pages.len());
+    for &page in &pages {
+        let mut streams = Vec::new();
+        let contents = xref
+            .fetch(page)
+            .and_then(|page| dict_get(&page.value, "Contents").cloned());
+        let nums: Vec<i32> = match &contents {
+            Some(ParsedValue::Array(items)) => items.iter().filter_map(as_ref).collect(),
+            Some(value) => as_ref(value).into_iter().collect(),
+            None => Vec::new(),
+        };
+        // Encrypted content can't be read without decrypting it
+        for num in nums.into_iter().filter(|_| !encrypted) {
+            if !claimed.insert(num) {
+                continue;
+            }
+            if let Some(fetched) = xref.fetch(num) {
+                if let Some(raw) = fetched.stream {
+                    streams.push(ContentStream {
+                        num,
+                        dict: fetched.value,
+                        raw,
+                    });
+                }
+            }
+        }
+        work.push(streams);
+    }
+
+    let cleaned = parallel_map(&work, settings.threads, |streams| {
+        if !step(cookie) {
+            return None;
+        }
+        let mut edits = Vec::with_capacity(streams.len());
+        for stream in streams {
+            let Some(plain) = decode_stream(&stream.dict, &stream.raw) else {
+                continue;
+            };
+            let mut dict = stream.dict.clone();
+            for key in ["Filter", "DecodeParms", "DL"] {
+                set_key(&mut dict, key, None);
+            }
+            edits.push((stream.num, (dict, Bytes::from(clean_content(&plain)))));
+        }
+        Some(edits)
+    });
+
+    let mut edits = Edits {
+        cookie,
+        ..Edits::default()
+    };
+    for page in cleaned {
+        let Some(page) = page else {
+            return Some(Err(io::Error::new(
+                io::ErrorKind::Interrupted,
+                "optimize aborted",
+            )));
+        };
+        edits.streams.extend(page);
+    }
+    if settings.subset_fonts && !encrypted {
+        edits
+            .streams
+            .extend(subset_font_edits(&mut xref, &pages, settings.threads));
+    }
+
+    let result = write_opened(xref, settings, &edits, out)?;
+    if result.is_ok() {
+        step(cookie);
+    }
+    Some(result)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::super::pdf_xref::Xref;
+    use super::super::pdf_xref_lazy::tests::sample_pdf;
+    use super::*;
+
+    #[test]
+    fn test_clean_content_normalizes_tokens() {
+        let content = b"% comment\nq  1.500 0 0 1.0 0.0 .50 cm\r\n/F1 12 Tf(a (b)\\) c)Tj\
+                        [<41 42>-2.250]TJ\n<</MCID 0>>BDC EMC Q";
+        assert_eq!(
+            clean_content(content),
+            b"q\n1.5 0 0 1 0 .5 cm\n/F1 12 Tf\n(a (b)\\) c) Tj\n\
+              [ <41 42> -2.25 ] TJ\n<< /MCID 0 >> BDC\nEMC\nQ\n"
+        );
+    }
+
+    #[test]
+    fn test_clean_content_keeps_inline_images() {
+        let content = b"BI /W 2 /H 1 /BPC 8 /CS /G ID \x00% \nEI  Q";
+        assert_eq!(
+            clean_content(content),
+            b"BI\n/W 2 /H 1 /BPC 8 /CS /G ID \x00% \nEI\nQ\n"
+        );
+    }
+
+    #[test]
+    fn test_optimize_cleans_pages_and_counts_progress() {
+        let data: Arc<FileBytes> = Arc::new(sample_pdf().into());
+        let cookie = Cookie::new();
+        let settings = WriteSettings {
+            compress: false,
+            garbage: true,
+            renumber: true,
+            ..WriteSettings::default()
+        };
+        let mut out = Vec::new();
+        assert!(matches!(
+            optimize_document(data, &settings, Some(&cookie), &mut out),
+            Some(Ok(()))
+        ));
+        assert_eq!((cookie.progress(), cookie.progress_max()), (3, 3));
+
+        let mut xref = Xref::open_lazy(0, Arc::new(out.into())).unwrap();
+        for (index, expected) in [(0, &b"BT\n1 Tf\nET\n"[..]), (1, b"0 0 m\nS\n")] {
+            let page = xref.lazy_page_object(index).unwrap();
+            let contents = dict_get(&xref.fetch(page).unwrap().value, "Contents")
+                .and_then(as_ref)
+                .unwrap();
+            let stream = xref.fetch(contents).unwrap().stream.unwrap();
+            assert_eq!(&stream[..], expected);
+        }
+    }
+
+    #[test]
+    fn test_optimize_stops_on_abort() {
+        let cookie = Cookie::new();
+        cookie.abort();
+        let mut out = Vec::new();
+        let result = optimize_document(
+            Arc::new(sample_pdf().into()),
+            &WriteSettings::default(),
+            Some(&cookie),
+            &mut out,
+        );
+        assert!(matches!(result, Some(Err(e)) if e.kind() == io::ErrorKind::Interrupted));
+        assert!(out.is_empty());
+    }
+}
@@ -3,12 +3,20 @@
 //! Provides page loading, manipulation, and rendering capabilities for PDF documents.
 //! This module implements the MuPDF pdf_page API for handling PDF pages.
 
-use crate::ffi::{Handle, HandleStore};
+use crate::ffi::pdf_object::check::pdf_is_dict;
+use crate::ffi::pdf_object::create::pdf_new_indirect;
+use crate::ffi::pdf_object::dict::{pdf_dict_gets, pdf_dict_puts};
+use crate::ffi::pdf_object::extract::pdf_to_num;
+use crate::ffi::pdf_object::refcount::{pdf_drop_obj, with_obj};
+use crate::ffi::pdf_object::types::PdfObjType;
+use crate::ffi::pdf_page_tree::PageIndex;
+use crate::ffi::pdf_vectorize::vectorize_pages;
+use crate::ffi::{DOCUMENTS, Handle, HandleStore};
 use crate::fitz::geometry::{Matrix, Rect};
-use std::collections::HashMap;
+use std::collections::{HashMap, HashSet};
 use std::ffi::{CStr, CString, c_char, c_void};
 use std::ptr;
-use std::sync::{Arc, LazyLock, Mutex};
+use std::sync::{Arc, LazyLock, Mutex, OnceLock};
 
 // ============================================================================
 // Type Aliases for Handles
@@ -311,6 +319,61 @@ pub static PDF_PAGES: LazyLock<HandleStore<PdfPage>> = LazyLock::new(HandleStore
 static PAGE_CACHE: LazyLock<Mutex<HashMap<DocumentHandle, Vec<PageHandle>>>> =
     LazyLock::new(|| Mutex::new(HashMap::new()));
 
+/// A document's page index, with the page objects handed out from it
+struct PageTree {
+    index: PageIndex,
+    /// Page object handles, made on first lookup and owned by the tree
+    objects: Vec<OnceLock<PdfObjHandle>>,
+}
+
+impl PageTree {
+    fn new(index: PageIndex) -> Self {
+        let objects = (0..index.len()).map(|_| OnceLock::new()).collect();
+        Self { index, objects }
+    }
+}
+
+impl Drop for PageTree {
+    fn drop(&mut self) {
+        for obj in self.objects.iter().filter_map(OnceLock::get) {
+            pdf_drop_obj(0, *obj);
+        }
+    }
+}
+
+// Page trees loaded for documents (document handle -> index)
+static PAGE_TREES: LazyLock<Mutex<HashMap<DocumentHandle, Arc<PageTree>>>> =
+    LazyLock::new(|| Mutex::new(HashMap::new()));
+
+// Documents whose page tree isn't kept between lookups
+static UNCACHED_PAGE_TREES: LazyLock<Mutex<HashSet<DocumentHandle>>> =
+    LazyLock::new(|| Mutex::new(HashSet::new()));
+
+/// The page tree of `doc`, indexing it on first use
+///
+/// The index is kept until `pdf_drop_page_tree` unless the document's
+/// page tree cache is off; the second value says whether it was kept.
+fn page_tree(doc: DocumentHandle) -> Option<(Arc<PageTree>, bool)> {
+    if let Some(tree) = PAGE_TREES.lock().ok()?.get(&doc) {
+        return Some((Arc::clone(tree), true));
+    }
+    let data = DOCUMENTS.get(doc)?.lock().ok()?.data();
+    let tree = Arc::new(PageTree::new(PageIndex::build(&data)?));
+    if UNCACHED_PAGE_TREES.lock().ok()?.contains(&doc) {
+        return Some((tree, false));
+    }
+    let mut trees = PAGE_TREES.lock().ok()?;
+    let tree = trees.entry(doc).or_insert(tree);
+    Some((Arc::clone(tree), true))
+}
+
+/// Label of page `number` of `doc`, from its `/PageLabels`
+pub(crate) fn page_label(doc: DocumentHandle, number: i32) -> Option<String> {
+    let (tree, _) = page_tree(doc)?;
+    let page = tree.index.page(usize::try_from(number).ok()?)?;
+    Some(page.label.clone())
+}
+
 // ============================================================================
 // FFI Functions - Page Lifecycle
 // ============================================================================
@@ -396,8 +459,14 @@ pub extern "C" fn pdf_count_pages(_ctx: ContextHandle, doc: DocumentHandle) -> i
         return 0;
     }
 
-    // In a real implementation, this would query the document's page tree
-    // For now, return a placeholder based on cached pages
+    // A loaded page tree knows; otherwise count from cached pages
+    if let Some(tree) = PAGE_TREES
+        .lock()
+        .ok()
+        .and_then(|t| t.get(&doc).map(Arc::clone))
+    {
+        return tree.index.len() as i32;
+    }
     if let Ok(cache) = PAGE_CACHE.lock() {
         if let Some(pages) = cache.get(&doc) {
             return pages.len() as i32;
@@ -409,36 +478,56 @@ pub extern "C" fn pdf_count_pages(_ctx: ContextHandle, doc: DocumentHandle) -> i
 }
 
 /// Lookup the page number for a page object
+///
+/// Answered from the document's page index (see `pdf_load_page_tree`)
+/// by the object's number.
+///
+/// # Returns
+/// The 0-based page number, or -1 if `pageobj` isn't a page of `doc`
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_lookup_page_number(
-    _ctx: ContextHandle,
-    _doc: DocumentHandle,
+    ctx: ContextHandle,
+    doc: DocumentHandle,
     pageobj: PdfObjHandle,
 ) -> i32 {
-    // Search through cached pages for matching object
-    // In a real implementation, this would traverse the page tree
-    if pageobj == 0 {
+    let num = pdf_to_num(ctx, pageobj);
+    if num <= 0 {
         return -1;
     }
-
-    // Return -1 if not found
-    -1
+    page_tree(doc)
+        .and_then(|(tree, _)| tree.index.page_number(num))
+        .map_or(-1, |n| n as i32)
 }
 
 /// Lookup a page object by page number
+///
+/// Answered from the document's page index (see `pdf_load_page_tree`).
+///
+/// # Returns
+/// An indirect reference to the page object, or 0 if there is no such
+/// page. With the page tree cache on (the default) the reference is
+/// borrowed from the index; with it off the caller owns it.
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_lookup_page_obj(
-    _ctx: ContextHandle,
+    ctx: ContextHandle,
     doc: DocumentHandle,
     number: i32,
 ) -> PdfObjHandle {
-    if doc == 0 || number < 0 {
+    let Ok(number) = usize::try_from(number) else {
+        return 0;
+    };
+    let Some((tree, cached)) = page_tree(doc) else {
         return 0;
+    };
+    let Some(page) = tree.index.page(number) else {
+        return 0;
+    };
+    let new_obj = || pdf_new_indirect(ctx, doc, page.num, 0);
+    if cached {
+        *tree.objects[number].get_or_init(new_obj)
+    } else {
+        new_obj()
     }
-
-    // In a real implementation, this would return the actual page object
-    // For now, return a synthetic handle
-    (number as u64 + 1) * 1000
 }
 
 // ============================================================================
@@ -529,6 +618,38 @@ pub extern "C" fn pdf_bound_page(_ctx: ContextHandle, page: PageHandle, box_type
     Rect::default()
 }
 
+/// Get the bounds of every page of a document without loading them
+///
+/// Writes `x0, y0, x1, y1` for each page, in page order, to `out` until
+/// `max` pages are written. The bounds come from the page index (see
+/// `pdf_load_page_tree`): the crop box clipped to the media box, scaled
+/// by `/UserUnit` and rotated, as `pdf_bound_page` gives them. Pass a
+/// null `out` to size the array first.
+///
+/// # Returns
+/// The number of pages in the document, or -1 if it has no page tree
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_bound_pages(
+    _ctx: ContextHandle,
+    doc: DocumentHandle,
+    out: *mut f32,
+    max: i32,
+) -> i32 {
+    let Some((tree, _)) = page_tree(doc) else {
+        return -1;
+    };
+    let pages = tree.index.pages();
+    if !out.is_null() && max > 0 {
+        let n = pages.len().min(max as usize);
+        // SAFETY: Caller guarantees `out` holds `max * 4` floats
+        let out = unsafe { std::slice::from_raw_parts_mut(out, n * 4) };
+        for (dst, page) in out.chunks_exact_mut(4).zip(pages) {
+            dst.copy_from_slice(&page.bounds);
+        }
+    }
+    pages.len() as i32
+}
+
 /// Get the page transformation matrix
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_page_transform(
@@ -810,37 +931,99 @@ pub extern "C" fn pdf_page_separations(
 // ============================================================================
 
 /// Enable or disable page tree cache
+///
+/// With the cache on (the default) a document's page index is built once
+/// and kept for every later page lookup. Turning it off drops the index,
+/// and lookups then index the tree afresh each time.
 #[unsafe(no_mangle)]
-pub extern "C" fn pdf_set_page_tree_cache(
-    _ctx: ContextHandle,
-    _doc: DocumentHandle,
-    _enabled: i32,
-) {
-    // No-op in this implementation
+pub extern "C" fn pdf_set_page_tree_cache(ctx: ContextHandle, doc: DocumentHandle, enabled: i32) {
+    if let Ok(mut uncached) = UNCACHED_PAGE_TREES.lock() {
+        if enabled != 0 {
+            uncached.remove(&doc);
+        } else {
+            uncached.insert(doc);
+        }
+    }
+    if enabled == 0 {
+        pdf_drop_page_tree(ctx, doc);
+    }
 }
 
-/// Load page tree (no-op, loaded on demand)
+/// Load page tree
+///
+/// Walks the document's page tree once into a flat index of page objects,
+/// inherited attributes and page labels, in parallel for large files (see
+/// `pdf_page_tree`). Lookups load it on demand, so calling this is only
+/// needed to pay the cost up front.
 #[unsafe(no_mangle)]
-pub extern "C" fn pdf_load_page_tree(_ctx: ContextHandle, _doc: DocumentHandle) {
-    // No-op - page tree is loaded on demand
+pub extern "C" fn pdf_load_page_tree(_ctx: ContextHandle, doc: DocumentHandle) {
+    let _ = page_tree(doc);
 }
 
-/// Drop page tree (no-op)
+/// Drop page tree
+///
+/// Call after editing the page tree; the next lookup indexes it again.
+/// `fz_drop_document` does this automatically.
 #[unsafe(no_mangle)]
-pub extern "C" fn pdf_drop_page_tree(_ctx: ContextHandle, _doc: DocumentHandle) {
-    // No-op
+pub extern "C" fn pdf_drop_page_tree(_ctx: ContextHandle, doc: DocumentHandle) {
+    let tree = PAGE_TREES.lock().ok().and_then(|mut t| t.remove(&doc));
+    drop(tree);
 }
 
 /// Internal: Drop page tree
 #[unsafe(no_mangle)]
-pub extern "C" fn pdf_drop_page_tree_internal(_ctx: ContextHandle, _doc: DocumentHandle) {
-    // Clear page cache for document
+pub extern "C" fn pdf_drop_page_tree_internal(ctx: ContextHandle, doc: DocumentHandle) {
+    pdf_drop_page_tree(ctx, doc);
 }
 
+/// Page attributes a page can take from its ancestors
+const INHERITABLE: [&CStr; 4] = [c"Resources", c"MediaBox", c"CropBox", c"Rotate"];
+
+/// Most `/Parent` links followed looking for inherited attributes
+const MAX_INHERIT_DEPTH: usize = 64;
+
 /// Flatten inheritable page items
+///
+/// Copies the Resources, MediaBox, CropBox and Rotate a page takes from
+/// its nearest ancestors onto the page itself, so it reads the same under
+/// any parent. Rebuilding a whole page tree does this for every page at
+/// once (see `pdf_page_edit`).
 #[unsafe(no_mangle)]
-pub extern "C" fn pdf_flatten_inheritable_page_items(_ctx: ContextHandle, _pageobj: PdfObjHandle) {
-    // In a real implementation, this would copy inherited attributes to the page object
+pub extern "C" fn pdf_flatten_inheritable_page_items(ctx: ContextHandle, pageobj: PdfObjHandle) {
+    if pdf_is_dict(ctx, pageobj) == 0 {
+        return;
+    }
+    let mut missing: Vec<&CStr> = INHERITABLE
+        .into_iter()
+        .filter(|key| !dict_has(pageobj, key))
+        .collect();
+    let mut node = pdf_dict_gets(ctx, pageobj, c"Parent".as_ptr());
+    for _ in 0..MAX_INHERIT_DEPTH {
+        if node == 0 || missing.is_empty() {
+            break;
+        }
+        missing.retain(|key| {
+            let value = pdf_dict_gets(ctx, node, key.as_ptr());
+            if value == 0 {
+                return true;
+            }
+            pdf_dict_puts(ctx, pageobj, key.as_ptr(), value);
+            pdf_drop_obj(ctx, value);
+            false
+        });
+        let parent = pdf_dict_gets(ctx, node, c"Parent".as_ptr());
+        pdf_drop_obj(ctx, node);
+        node = parent;
+    }
+    pdf_drop_obj(ctx, node);
+}
+
+fn dict_has(dict: PdfObjHandle, key: &CStr) -> bool {
+    let key = key.to_str().unwrap_or("");
+    with_obj(dict, false, |o| match &o.obj_type {
+        PdfObjType::Dict(entries) => entries.get(key).is_some(),
+        _ => false,
+    })
 }
 
 // ============================================================================
@@ -1005,10 +1188,19 @@ pub extern "C" fn pdf_clip_page(_ctx: ContextHandle, _page: PageHandle, _clip: *
     // In a real implementation, this would add a clip path to the page
 }
 
-/// Vectorize page content
+/// Vectorize page content: draw the page's text as paths
+///
+/// Only text in fonts with drawable glyphs is converted (see
+/// `pdf_vectorize`). The page handle keeps its cached boxes.
 #[unsafe(no_mangle)]
-pub extern "C" fn pdf_vectorize_page(_ctx: ContextHandle, _page: PageHandle) {
-    // In a real implementation, this would convert text to paths
+pub extern "C" fn pdf_vectorize_page(_ctx: ContextHandle, page: PageHandle) {
+    let Some((doc, number)) = PDF_PAGES.get(page).map(|p| {
+        let p = p.lock().unwrap();
+        (p.doc, p.number)
+    }) else {
+        return;
+    };
+    vectorize_pages(doc, Some(&[number]), 0);
 }
 
 // ============================================================================
@@ -1226,6 +1418,92 @@ mod tests {
         pdf_drop_page(ctx, page2);
     }
 
+    #[test]
+    fn test_page_tree_index() {
+        use crate::ffi::document::{Document, fz_drop_document};
+
+        let ctx = 1;
+        let mut pdf = b"%PDF-1.7\n".to_vec();
+        let objects = [
+            "<< /Type /Catalog /Pages 2 0 R /PageLabels << /Nums [0 << /S /R >>] >> >>",
+            "<< /Type /Pages /Kids [3 0 R 4 0 R] /Count 3 >>",
+            "<< /Type /Page >>",
+            "<< /Type /Pages /Kids [5 0 R] /Count 1 /MediaBox [0 0 200 100] >>",
+            "<< /Type /Page /Rotate 90 >>",
+        ];
+        for (i, body) in objects.iter().enumerate() {
+            pdf.extend_from_slice(format!("{} 0 obj\n{body}\nendobj\n", i + 1).as_bytes());
+        }
+        pdf.extend_from_slice(b"trailer\n<< /Root 1 0 R >>\n%%EOF\n");
+        let doc = DOCUMENTS.insert(Document::new(pdf));
+
+        pdf_load_page_tree(ctx, doc);
+        assert_eq!(pdf_count_pages(ctx, doc), 2);
+        let second = pdf_lookup_page_obj(ctx, doc, 1);
+        assert_eq!(pdf_to_num(ctx, second), 5);
+        assert_eq!(pdf_lookup_page_obj(ctx, doc, 1), second);
+        assert_eq!(pdf_lookup_page_obj(ctx, doc, 2), 0);
+        assert_eq!(pdf_lookup_page_obj(ctx, doc, -1), 0);
+        assert_eq!(pdf_lookup_page_number(ctx, doc, second), 1);
+        let node = pdf_new_indirect(ctx, doc, 4, 0);
+        assert_eq!(pdf_lookup_page_number(ctx, doc, node), -1);
+        assert_eq!(page_label(doc, 1).as_deref(), Some("II"));
+
+        assert_eq!(pdf_bound_pages(ctx, doc, ptr::null_mut(), 0), 2);
+        let mut bounds = [-1.0f32; 12];
+        assert_eq!(pdf_bound_pages(ctx, doc, bounds.as_mut_ptr(), 3), 2);
+        assert_eq!(
+            bounds[..8],
+            [0.0, 0.0, 612.0, 792.0, 0.0, 0.0, 100.0, 200.0]
+        );
+        assert_eq!(bounds[8], -1.0);
+
+        // Without the cache, lookups hand out references the caller owns
+        pdf_set_page_tree_cache(ctx, doc, 0);
+        let first = pdf_lookup_page_obj(ctx, doc, 0);
+        assert_eq!(pdf_to_num(ctx, first), 3);
+        assert_ne!(pdf_lookup_page_obj(ctx, doc, 0), first);
+        pdf_set_page_tree_cache(ctx, doc, 1);
+
+        fz_drop_document(ctx, doc);
+        assert!(PAGE_TREES.lock().unwrap().get(&doc).is_none());
+        assert_eq!(pdf_lookup_page_obj(ctx, doc, 0), 0);
+    }
+
+    #[test]
+    fn test_flatten_inheritable_page_items() {
+        use crate::ffi::pdf_object::create::{pdf_new_dict, pdf_new_int};
+        use crate::ffi::pdf_object::extract::pdf_to_int;
+
+        let ctx = 0;
+        let root = pdf_new_dict(ctx, 0, 2);
+        let rotate = pdf_new_int(ctx, 90);
+        pdf_dict_puts(ctx, root, c"Rotate".as_ptr(), rotate);
+        let media_box = pdf_new_int(ctx, 1);
+        pdf_dict_puts(ctx, root, c"MediaBox".as_ptr(), media_box);
+        let node = pdf_new_dict(ctx, 0, 2);
+        let nearer = pdf_new_int(ctx, 2);
+        pdf_dict_puts(ctx, node, c"MediaBox".as_ptr(), nearer);
+        pdf_dict_puts(ctx, node, c"Parent".as_ptr(), root);
+        let page = pdf_new_dict(ctx, 0, 2);
+        pdf_dict_puts(ctx, page, c"Parent".as_ptr(), node);
+
+        pdf_flatten_inheritable_page_items(ctx, page);
+        let get = |key: &CStr| {
+            let value = pdf_dict_gets(ctx, page, key.as_ptr());
+            let n = pdf_to_int(ctx, value);
+            pdf_drop_obj(ctx, value);
+            n
+        };
+        assert_eq!(get(c"MediaBox"), 2);
+        assert_eq!(get(c"Rotate"), 90);
+        assert!(!dict_has(page, c"Resources"));
+
+        for obj in [root, rotate, media_box, node, nearer, page] {
+            pdf_drop_obj(ctx, obj);
+        }
+    }
+
     #[test]
     fn test_run_page() {
         let ctx = 1;
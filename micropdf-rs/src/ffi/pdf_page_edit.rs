@@ -0,0 +1,400 @@
+//! Page Tree Rebuilding
+//!
+//! Reordering, dropping or adding pages one at a time means a walk and a
+//! splice in the page tree for each page, which turns quadratic over a
+//! whole document. Edits here lay the new page list out in one pass
+//! instead, as a balanced tree of at most `TREE_FANOUT` kids per node, and
+//! each page takes the attributes it inherited from its old ancestors onto
+//! itself, resolved for every page at once by the flat page index, so it
+//! reads the same under any parent.
+//!
+//! The document is then written out again with the new tree in place of
+//! the old one. Everything else is copied as it is.
+
+use super::display_list::fz_purge_display_list_cache;
+use super::mmap::FileBytes;
+use super::pdf_page::pdf_drop_page_tree;
+use super::pdf_page_tree::PageIndex;
+use super::pdf_parse::ParsedValue;
+use super::pdf_write::{Edits, PdfSink, WriteSettings, open_source, set_key, write_opened};
+use super::pdf_xref_lazy::{as_int, as_ref, dict_get};
+use super::{DOCUMENTS, Handle};
+use std::collections::{HashMap, HashSet};
+use std::io;
+use std::sync::Arc;
+
+/// Most kids a rebuilt page tree node has
+pub const TREE_FANOUT: usize = 32;
+
+/// A page of a rebuilt page tree
+#[derive(Debug, Clone)]
+pub enum NewPage {
+    /// Page `n` (0-based) of the source; listing one twice copies it
+    Existing(usize),
+    /// A page object the source doesn't have, e.g. a blank page
+    Created(ParsedValue),
+}
+
+/// A blank `width` x `height` page
+pub fn blank_page(width: f32, height: f32) -> NewPage {
+    let media_box = [0.0, 0.0, width, height]
+        .into_iter()
+        .map(ParsedValue::Real)
+        .collect();
+    NewPage::Created(ParsedValue::Dict(vec![
+        ("Type".into(), ParsedValue::Name("Page".into())),
+        ("MediaBox".into(), ParsedValue::Array(media_box)),
+        ("Resources".into(), ParsedValue::Dict(Vec::new())),
+    ]))
+}
+
+fn reference(num: i32) -> ParsedValue {
+    ParsedValue::Reference { num, generation: 0 }
+}
+
+/// Write the document in `data` out again with the pages `layout` picks
+/// from its index as its page tree
+///
+/// Pages of the source left out are left out of the file. With
+/// `drop_structure`, so is the structure tree, which points into pages
+/// that may be gone. Garbage collection is off whatever `settings` says,
+/// since it would walk the old tree. Returns `None` if the document has no
+/// page tree to read or is encrypted, or if `layout` names a page past the
+/// end.
+pub fn rebuild_page_tree<S: PdfSink>(
+    data: &Arc<FileBytes>,
+    layout: impl FnOnce(&PageIndex) -> Vec<NewPage>,
+    drop_structure: bool,
+    settings: &WriteSettings,
+    out: S,
+) -> Option<io::Result<()>> {
+    let mut xref = open_source(data, settings.threads)?;
+    let index = PageIndex::read(&mut xref, settings.threads)?;
+    let pages = layout(&index);
+    xref.read_all_sections();
+    let trailer = xref.source_trailer()?.clone();
+    if dict_get(&trailer, "Encrypt").is_some() {
+        return None;
+    }
+    let catalog_num = dict_get(&trailer, "Root").and_then(as_ref)?;
+    let mut catalog = xref.fetch(catalog_num)?.value;
+    let mut catalog_edited = false;
+
+    // Old nodes are reused before new numbers are taken
+    let first_new = dict_get(&trailer, "Size")
+        .and_then(as_int)
+        .map_or(0, |n| n as i32)
+        .max(xref.num_objects)
+        .max(1);
+    let mut next = first_new;
+    let mut spare = index.nodes().iter().skip(1).copied();
+    let mut take = move || {
+        spare.next().unwrap_or_else(|| {
+            next += 1;
+            next - 1
+        })
+    };
+    let root = match index.nodes().first() {
+        Some(&root) => root,
+        None => {
+            let root = take();
+            set_key(&mut catalog, "Pages", Some(reference(root)));
+            catalog_edited = true;
+            root
+        }
+    };
+
+    let mut used = HashSet::new();
+    let mut leaves = Vec::with_capacity(pages.len());
+    for page in pages {
+        let (num, mut value) = match page {
+            NewPage::Existing(i) => {
+                let page = index.page(i)?;
+                let mut value = xref.fetch(page.num).map_or(ParsedValue::Null, |f| f.value);
+                for (key, inherited) in &page.inherited {
+                    set_key(&mut value, key, Some(inherited.clone()));
+                }
+                let num = if used.insert(page.num) {
+                    page.num
+                } else {
+                    take()
+                };
+                (num, value)
+            }
+            NewPage::Created(value) => (take(), value),
+        };
+        if drop_structure {
+            set_key(&mut value, "StructParents", None);
+        }
+        leaves.push((num, value));
+    }
+
+    // Bottom up, so every page ends up at the same depth
+    let mut nodes = Vec::new();
+    let mut level: Vec<(i32, usize)> = leaves.iter().map(|(num, _)| (*num, 1)).collect();
+    while level.len() > TREE_FANOUT {
+        level = level
+            .chunks(TREE_FANOUT)
+            .map(|kids| {
+                let num = take();
+                let count = kids.iter().map(|(_, count)| count).sum();
+                nodes.push((num, kids.to_vec(), count));
+                (num, count)
+            })
+            .collect();
+    }
+    let count = level.iter().map(|(_, count)| count).sum();
+    nodes.push((root, level, count));
+
+    let parents: HashMap<i32, i32> = nodes
+        .iter()
+        .flat_map(|(num, kids, _)| kids.iter().map(move |(kid, _)| (*kid, *num)))
+        .collect();
+    let mut edits = Edits::default();
+    let mut put = |num: i32, value: ParsedValue| {
+        if num < first_new {
+            edits.objects.insert(num, value);
+        } else {
+            edits.added.push((num, value));
+        }
+    };
+    for (num, mut value) in leaves {
+        set_key(
+            &mut value,
+            "Parent",
+            parents.get(&num).copied().map(reference),
+        );
+        put(num, value);
+    }
+    for (num, kids, count) in nodes {
+        let mut node = vec![("Type".to_string(), ParsedValue::Name("Pages".into()))];
+        if let Some(&parent) = parents.get(&num) {
+            node.push(("Parent".into(), reference(parent)));
+        }
+        let kids = kids.iter().map(|&(kid, _)| reference(kid)).collect();
+        node.push(("Kids".into(), ParsedValue::Array(kids)));
+        node.push(("Count".into(), ParsedValue::Int(count as i64)));
+        put(num, ParsedValue::Dict(node));
+    }
+    if drop_structure && dict_get(&catalog, "StructTreeRoot").is_some() {
+        set_key(&mut catalog, "StructTreeRoot", None);
+        catalog_edited = true;
+    }
+    if catalog_edited {
+        put(catalog_num, catalog);
+    }
+
+    let reused: HashSet<i32> = edits.objects.keys().copied().collect();
+    edits.removed = index
+        .nodes()
+        .iter()
+        .copied()
+        .chain(index.pages().iter().map(|page| page.num))
+        .filter(|num| !reused.contains(num))
+        .collect();
+    let settings = WriteSettings {
+        garbage: false,
+        ..*settings
+    };
+    write_opened(xref, &settings, &edits, out)
+}
+
+/// Rebuild the page tree of open document `doc` in place, swapping in the
+/// rewritten file and dropping what was cached for the old one
+///
+/// Returns whether the document changed.
+pub(crate) fn edit_pages(
+    doc: Handle,
+    layout: impl FnOnce(&PageIndex) -> Vec<NewPage>,
+    drop_structure: bool,
+) -> bool {
+    let Some(document) = DOCUMENTS.get(doc) else {
+        return false;
+    };
+    let data = document.lock().unwrap().data();
+    let mut count = 0;
+    let layout = |index: &PageIndex| {
+        let pages = layout(index);
+        count = pages.len();
+        pages
+    };
+    let mut out = Vec::new();
+    match rebuild_page_tree(
+        &data,
+        layout,
+        drop_structure,
+        &WriteSettings::default(),
+        &mut out,
+    ) {
+        Some(Ok(())) => {}
+        _ => return false,
+    }
+    {
+        let mut document = document.lock().unwrap();
+        document.replace_data(out);
+        document.set_page_count(count as i32);
+    }
+    pdf_drop_page_tree(0, doc);
+    fz_purge_display_list_cache(0, doc);
+    true
+}
+
+#[cfg(test)]
+mod tests {
+    use super::super::pdf_xref::Xref;
+    use super::super::pdf_xref_lazy::decode_stream;
+    use super::*;
+
+    /// A PDF whose pages hang off one long chain of page tree nodes, each
+    /// page with a content stream naming it, under a root holding the
+    /// MediaBox
+    fn chain_pdf(pages: i32) -> Arc<FileBytes> {
+        let node = |i: i32| 2 + 3 * i;
+        let mut objects = vec![(
+            1,
+            "<< /Type /Catalog /Pages 2 0 R /StructTreeRoot << /Type /StructTreeRoot >> >>"
+                .to_string(),
+        )];
+        for i in 0..pages {
+            let page = node(i) + 1;
+            let kids = if i + 1 < pages {
+                format!("[{page} 0 R {} 0 R]", node(i + 1))
+            } else {
+                format!("[{page} 0 R]")
+            };
+            let media_box = if i == 0 {
+                "/MediaBox [0 0 612 792]"
+            } else {
+                ""
+            };
+            objects.push((
+                node(i),
+                format!(
+                    "<< /Type /Pages /Kids {kids} /Count {} {media_box} >>",
+                    pages - i
+                ),
+            ));
+            objects.push((
+                page,
+                format!(
+                    "<< /Type /Page /Parent {} 0 R /Contents {} 0 R /StructParents {i} >>",
+                    node(i),
+                    page + 1
+                ),
+            ));
+            let content = format!("% page {i}");
+            objects.push((
+                page + 1,
+                format!(
+                    "<< /Length {} >>\nstream\n{content}\nendstream",
+                    content.len()
+                ),
+            ));
+        }
+        let mut pdf = b"%PDF-1.7\n".to_vec();
+        for (num, body) in objects {
+            pdf.extend_from_slice(format!("{num} 0 obj\n{body}\nendobj\n").as_bytes());
+        }
+        pdf.extend_from_slice(b"trailer\n<< /Root 1 0 R >>\n%%EOF\n");
+        Arc::new(pdf.into())
+    }
+
+    fn rebuild(
+        data: &Arc<FileBytes>,
+        layout: impl FnOnce(&PageIndex) -> Vec<NewPage>,
+    ) -> Arc<FileBytes> {
+        let mut out = Vec::new();
+        rebuild_page_tree(data, layout, true, &WriteSettings::default(), &mut out)
+            .unwrap()
+            .unwrap();
+        Arc::new(out.into())
+    }
+
+    /// Depth of every page under the root
+    fn depths(data: &Arc<FileBytes>) -> Vec<usize> {
+        let mut xref = Xref::open_lazy(0, Arc::clone(data)).unwrap();
+        let trailer = xref.source_trailer().unwrap().clone();
+        let catalog = xref
+            .load_value(dict_get(&trailer, "Root").and_then(as_ref).unwrap())
+            .unwrap();
+        let mut depths = Vec::new();
+        let mut stack = vec![(dict_get(&catalog, "Pages").and_then(as_ref).unwrap(), 0)];
+        while let Some((num, depth)) = stack.pop() {
+            let value = xref.load_value(num).unwrap();
+            match dict_get(&value, "Kids") {
+                Some(ParsedValue::Array(kids)) => {
+                    assert!(kids.len() <= TREE_FANOUT);
+                    stack.extend(kids.iter().rev().filter_map(as_ref).map(|k| (k, depth + 1)));
+                }
+                _ => depths.push(depth),
+            }
+        }
+        depths
+    }
+
+    #[test]
+    fn test_reverse_builds_balanced_tree() {
+        let data = chain_pdf(60);
+        let out = rebuild(&data, |index| {
+            (0..index.len()).rev().map(NewPage::Existing).collect()
+        });
+        assert_eq!(depths(&out), vec![2; 60]);
+
+        let index = PageIndex::build(&out).unwrap();
+        assert_eq!(index.len(), 60);
+        let mut xref = Xref::open_lazy(0, Arc::clone(&out)).unwrap();
+        for (i, page) in index.pages().iter().enumerate() {
+            // Each page carries what it used to inherit, and its content
+            let value = xref.load_value(page.num).unwrap();
+            assert!(dict_get(&value, "MediaBox").is_some());
+            assert!(dict_get(&value, "StructParents").is_none());
+            let contents = dict_get(&value, "Contents").and_then(as_ref).unwrap();
+            let fetched = xref.fetch(contents).unwrap();
+            let content = decode_stream(&fetched.value, &fetched.stream.unwrap()).unwrap();
+            assert_eq!(content, format!("% page {}", 59 - i).as_bytes());
+        }
+        let trailer = xref.source_trailer().unwrap().clone();
+        let catalog = xref
+            .load_value(dict_get(&trailer, "Root").and_then(as_ref).unwrap())
+            .unwrap();
+        assert!(dict_get(&catalog, "StructTreeRoot").is_none());
+    }
+
+    #[test]
+    fn test_drop_copy_and_add_pages() {
+        let data = chain_pdf(5);
+        let out = rebuild(&data, |_| {
+            vec![
+                NewPage::Existing(3),
+                NewPage::Existing(3),
+                NewPage::Existing(0),
+                blank_page(100.0, 50.0),
+            ]
+        });
+        assert_eq!(depths(&out), vec![1; 4]);
+        let index = PageIndex::build(&out).unwrap();
+        assert_eq!(index.len(), 4);
+        let nums: HashSet<i32> = index.pages().iter().map(|p| p.num).collect();
+        assert_eq!(nums.len(), 4);
+
+        // Pages 1, 2 and 4 are gone, and the inner nodes the copy and the
+        // blank page didn't take over
+        let mut xref = Xref::open_lazy(0, Arc::clone(&out)).unwrap();
+        for gone in [6, 9, 15, 11, 14] {
+            assert!(xref.load_value(gone).is_none(), "{gone}");
+        }
+        let blank = xref.load_value(index.page(3).unwrap().num).unwrap();
+        assert!(dict_get(&blank, "Contents").is_none());
+
+        assert!(
+            rebuild_page_tree(
+                &data,
+                |_| vec![NewPage::Existing(5)],
+                false,
+                &WriteSettings::default(),
+                &mut Vec::new()
+            )
+            .is_none()
+        );
+    }
+}
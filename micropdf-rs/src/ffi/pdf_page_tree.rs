@@ -0,0 +1,605 @@
+//! Flat Page Index
+//!
+//! Finding page N through the page tree means a walk down from the root,
+//! and generators that emit deep or unbalanced trees make every such walk
+//! long. The index walks the tree once and keeps, for each page, its
+//! object number, the attributes it inherits and its label, so page
+//! lookups either way round are a vector index or a hash lookup. Each
+//! page's bounds are worked out in the same walk, so every page size is
+//! known without loading a page.
+//!
+//! Documents past `PARALLEL_INDEX_BYTES` load the tree a level at a time
+//! on a pool of threads, as garbage collection does: every node in a level
+//! is parsed through the shared xref, and only the order-preserving walk
+//! over the parsed nodes runs on one thread.
+
+use super::mmap::FileBytes;
+use super::pdf_parse::ParsedValue;
+use super::pdf_stream_prefetch::parallel_map;
+use super::pdf_write::open_source;
+use super::pdf_xref::Xref;
+use super::pdf_xref_lazy::{as_int, as_ref, dict_get, is_name};
+use std::collections::{HashMap, HashSet};
+use std::sync::Arc;
+
+/// Size of a page with no usable `/MediaBox`: US Letter
+const DEFAULT_MEDIA_BOX: [f32; 4] = [0.0, 0.0, 612.0, 792.0];
+
+/// Page attributes a page can take from its ancestors
+const INHERITED: [&str; 4] = ["Resources", "MediaBox", "CropBox", "Rotate"];
+
+/// Deepest page tree walked
+const MAX_TREE_DEPTH: usize = 64;
+
+/// Files at least this large build their index in parallel
+pub const PARALLEL_INDEX_BYTES: usize = 8 << 20;
+
+/// Page tree nodes one task parses
+const FRONTIER_CHUNK: usize = 64;
+
+/// A page as the index knows it
+#[derive(Debug, Clone)]
+pub struct IndexedPage {
+    /// Object number of the page object
+    pub num: i32,
+    /// Attributes taken from ancestors, nearest ancestor winning; the
+    /// page's own entries override these
+    pub inherited: Vec<(String, ParsedValue)>,
+    /// Label from the document's `/PageLabels`, or the 1-based page
+    /// number if it has none
+    pub label: String,
+    /// Bounds as `pdf_bound_page` gives them: the crop box clipped to the
+    /// media box, scaled by `/UserUnit` and turned by `/Rotate`, with its
+    /// origin moved to 0,0
+    pub bounds: [f32; 4],
+}
+
+/// Every page of a document, in order
+#[derive(Debug, Default)]
+pub struct PageIndex {
+    pages: Vec<IndexedPage>,
+    by_num: HashMap<i32, usize>,
+    /// Page tree nodes other than pages, root first
+    nodes: Vec<i32>,
+}
+
+impl PageIndex {
+    /// Index the document in `data`, in parallel if it is large
+    pub fn build(data: &Arc<FileBytes>) -> Option<Self> {
+        let threads = if data.len() >= PARALLEL_INDEX_BYTES {
+            0
+        } else {
+            1
+        };
+        Self::build_with(data, threads)
+    }
+
+    /// Index the document in `data` on up to `threads` threads (0 = one
+    /// per core)
+    ///
+    /// Returns `None` if the document has no page tree to read.
+    pub fn build_with(data: &Arc<FileBytes>, threads: usize) -> Option<Self> {
+        let mut xref = open_source(data, threads)?;
+        Self::read(&mut xref, threads)
+    }
+
+    /// Index the document `xref` was opened on, for callers that go on to
+    /// read more of it
+    pub(crate) fn read(xref: &mut Xref, threads: usize) -> Option<Self> {
+        let trailer = xref.source_trailer()?.clone();
+        let catalog = dict_get(&trailer, "Root")
+            .and_then(as_ref)
+            .and_then(|num| fetch_value(xref, num))?;
+        let top = dict_get(&catalog, "Pages").and_then(as_ref)?;
+        let nodes = load_tree(xref, top, threads);
+
+        let mut pages = Vec::new();
+        let mut interior = Vec::new();
+        let mut seen = HashSet::new();
+        let mut stack = vec![(top, Vec::new(), 0)];
+        while let Some((num, mut inherited, depth)) = stack.pop() {
+            if depth > MAX_TREE_DEPTH || !seen.insert(num) {
+                continue;
+            }
+            let Some(value) = nodes.get(&num) else {
+                continue;
+            };
+            match dict_get(value, "Kids") {
+                Some(ParsedValue::Array(kids)) if !is_name(dict_get(value, "Type"), "Page") => {
+                    interior.push(num);
+                    for key in INHERITED {
+                        if let Some(v) = dict_get(value, key) {
+                            inherited.retain(|(k, _): &(String, _)| k != key);
+                            inherited.push((key.to_string(), v.clone()));
+                        }
+                    }
+                    for kid in kids.iter().rev().filter_map(as_ref) {
+                        stack.push((kid, inherited.clone(), depth + 1));
+                    }
+                }
+                _ => {
+                    // The page's own entries win over inherited ones
+                    inherited.retain(|(k, _)| dict_get(value, k).is_none());
+                    let bounds = page_bounds(xref, value, &inherited);
+                    pages.push(IndexedPage {
+                        num,
+                        inherited,
+                        label: String::new(),
+                        bounds,
+                    });
+                }
+            }
+        }
+
+        let labels = page_labels(xref, &catalog, pages.len());
+        for (i, page) in pages.iter_mut().enumerate() {
+            page.label = labels.label(i);
+        }
+        let by_num = pages
+            .iter()
+            .enumerate()
+            .rev()
+            .map(|(i, page)| (page.num, i))
+            .collect();
+        Some(Self {
+            pages,
+            by_num,
+            nodes: interior,
+        })
+    }
+
+    /// Number of pages
+    pub fn len(&self) -> usize {
+        self.pages.len()
+    }
+
+    pub fn is_empty(&self) -> bool {
+        self.pages.is_empty()
+    }
+
+    /// Page `index` (0-based)
+    pub fn page(&self, index: usize) -> Option<&IndexedPage> {
+        self.pages.get(index)
+    }
+
+    /// Index of the page whose object is `num`; the first, if the tree
+    /// lists it more than once
+    pub fn page_number(&self, num: i32) -> Option<usize> {
+        self.by_num.get(&num).copied()
+    }
+
+    pub fn pages(&self) -> &[IndexedPage] {
+        &self.pages
+    }
+
+    /// Object numbers of the page tree nodes that aren't pages, root
+    /// first; empty if the catalog's `/Pages` is itself a page
+    pub fn nodes(&self) -> &[i32] {
+        &self.nodes
+    }
+}
+
+/// Object `num`'s value, without caching it as a document object
+fn fetch_value(xref: &mut Xref, num: i32) -> Option<ParsedValue> {
+    xref.fetch(num).map(|f| f.value)
+}
+
+fn as_number(value: &ParsedValue) -> Option<f32> {
+    match value {
+        ParsedValue::Int(i) => Some(*i as f32),
+        ParsedValue::Real(r) => Some(*r),
+        _ => None,
+    }
+}
+
+/// A rectangle array, normalized so x0 <= x1 and y0 <= y1
+fn as_rect(value: &ParsedValue) -> Option<[f32; 4]> {
+    let ParsedValue::Array(items) = value else {
+        return None;
+    };
+    let [x0, y0, x1, y1] = items.as_slice() else {
+        return None;
+    };
+    let [x0, y0, x1, y1] = [x0, y0, x1, y1].map(as_number);
+    let (x0, y0, x1, y1) = (x0?, y0?, x1?, y1?);
+    Some([x0.min(x1), y0.min(y1), x0.max(x1), y0.max(y1)])
+}
+
+/// Bounds of the page whose dictionary is `page`, as `pdf_bound_page`
+/// would give them once the page was loaded
+fn page_bounds(
+    xref: &mut Xref,
+    page: &ParsedValue,
+    inherited: &[(String, ParsedValue)],
+) -> [f32; 4] {
+    let mut attr = |key: &str| {
+        let value = dict_get(page, key)
+            .or_else(|| inherited.iter().find(|(k, _)| k == key).map(|(_, v)| v))?
+            .clone();
+        match as_ref(&value) {
+            Some(num) => fetch_value(xref, num),
+            None => Some(value),
+        }
+    };
+
+    let media = attr("MediaBox")
+        .and_then(|v| as_rect(&v))
+        .filter(|r| r[2] > r[0] && r[3] > r[1])
+        .unwrap_or(DEFAULT_MEDIA_BOX);
+    let mut area = attr("CropBox")
+        .and_then(|v| as_rect(&v))
+        .map_or(media, |c| {
+            [
+                c[0].max(media[0]),
+                c[1].max(media[1]),
+                c[2].min(media[2]),
+                c[3].min(media[3]),
+            ]
+        });
+    // A crop box outside the media box is ignored
+    if area[2] <= area[0] || area[3] <= area[1] {
+        area = media;
+    }
+    let unit = attr("UserUnit")
+        .and_then(|v| as_number(&v))
+        .filter(|u| *u > 0.0)
+        .unwrap_or(1.0);
+    // Snapped to a quarter turn, as MuPDF does
+    let rotate = attr("Rotate")
+        .and_then(|v| as_int(&v))
+        .map_or(0, |r| (r.rem_euclid(360) + 45) / 90 % 4);
+
+    let (w, h) = ((area[2] - area[0]) * unit, (area[3] - area[1]) * unit);
+    if rotate % 2 == 1 {
+        [0.0, 0.0, h, w]
+    } else {
+        [0.0, 0.0, w, h]
+    }
+}
+
+/// Parse every page tree node under `top`, a level at a time
+fn load_tree(xref: &mut Xref, top: i32, threads: usize) -> HashMap<i32, ParsedValue> {
+    let parallel = threads != 1;
+    if parallel {
+        xref.read_all_sections();
+        xref.prefetch_objstms(threads);
+    }
+
+    let mut nodes = HashMap::new();
+    let mut queued = HashSet::from([top]);
+    let mut frontier = vec![top];
+    for _ in 0..=MAX_TREE_DEPTH {
+        if frontier.is_empty() {
+            break;
+        }
+        let parsed: Vec<Option<ParsedValue>> = if parallel {
+            let shared = &*xref;
+            let chunks: Vec<&[i32]> = frontier.chunks(FRONTIER_CHUNK).collect();
+            parallel_map(&chunks, threads, |chunk| {
+                chunk
+                    .iter()
+                    .map(|&num| shared.peek_value(num))
+                    .collect::<Vec<_>>()
+            })
+            .concat()
+        } else {
+            vec![None; frontier.len()]
+        };
+
+        let mut next = Vec::new();
+        for (&num, value) in frontier.iter().zip(parsed) {
+            // Peeking misses what it can't reach without the xref
+            let Some(value) = value.or_else(|| fetch_value(xref, num)) else {
+                continue;
+            };
+            if !is_name(dict_get(&value, "Type"), "Page") {
+                if let Some(ParsedValue::Array(kids)) = dict_get(&value, "Kids") {
+                    next.extend(kids.iter().filter_map(as_ref).filter(|&k| queued.insert(k)));
+                }
+            }
+            nodes.insert(num, value);
+        }
+        frontier = next;
+    }
+    nodes
+}
+
+// ============================================================================
+// Page Labels
+// ============================================================================
+
+/// Numbering style of a page label range
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum LabelStyle {
+    None,
+    Decimal,
+    UpperRoman,
+    LowerRoman,
+    UpperLetters,
+    LowerLetters,
+}
+
+/// A `/PageLabels` range, from its first page to the next range's
+#[derive(Debug, Clone)]
+struct LabelRange {
+    first: usize,
+    style: LabelStyle,
+    prefix: String,
+    start: i64,
+}
+
+/// The page label ranges of a document, sorted by first page
+#[derive(Debug, Default)]
+struct PageLabels {
+    ranges: Vec<LabelRange>,
+}
+
+impl PageLabels {
+    fn label(&self, page: usize) -> String {
+        let at = self.ranges.partition_point(|r| r.first <= page);
+        let Some(range) = at.checked_sub(1).map(|i| &self.ranges[i]) else {
+            return (page + 1).to_string();
+        };
+        let n = range.start + (page - range.first) as i64;
+        let mut label = range.prefix.clone();
+        match range.style {
+            LabelStyle::None => {}
+            LabelStyle::Decimal => label.push_str(&n.to_string()),
+            LabelStyle::UpperRoman => label.push_str(&roman(n)),
+            LabelStyle::LowerRoman => label.push_str(&roman(n).to_lowercase()),
+            LabelStyle::UpperLetters => label.push_str(&letters(n)),
+            LabelStyle::LowerLetters => label.push_str(&letters(n).to_lowercase()),
+        }
+        label
+    }
+}
+
+/// Deepest `/PageLabels` number tree walked
+const MAX_LABEL_DEPTH: usize = 16;
+
+/// Read the catalog's `/PageLabels` number tree
+fn page_labels(xref: &mut Xref, catalog: &ParsedValue, page_count: usize) -> PageLabels {
+    let mut labels = PageLabels::default();
+    let Some(root) = dict_get(catalog, "PageLabels").and_then(|v| resolve(xref, v)) else {
+        return labels;
+    };
+    let mut stack = vec![(root, 0)];
+    while let Some((node, depth)) = stack.pop() {
+        if let Some(ParsedValue::Array(nums)) = dict_get(&node, "Nums") {
+            for pair in nums.chunks_exact(2) {
+                let (Some(first), Some(dict)) = (as_int(&pair[0]), resolve(xref, &pair[1])) else {
+                    continue;
+                };
+                let Ok(first) = usize::try_from(first) else {
+                    continue;
+                };
+                if first < page_count {
+                    labels.ranges.push(label_range(first, &dict));
+                }
+            }
+        }
+        if depth < MAX_LABEL_DEPTH {
+            if let Some(ParsedValue::Array(kids)) = dict_get(&node, "Kids") {
+                for kid in kids {
+                    if let Some(kid) = resolve(xref, kid) {
+                        stack.push((kid, depth + 1));
+                    }
+                }
+            }
+        }
+    }
+    labels.ranges.sort_by_key(|r| r.first);
+    labels
+}
+
+/// `value`, or the object it refers to
+fn resolve(xref: &mut Xref, value: &ParsedValue) -> Option<ParsedValue> {
+    match as_ref(value) {
+        Some(num) => fetch_value(xref, num),
+        None => Some(value.clone()),
+    }
+}
+
+fn label_range(first: usize, dict: &ParsedValue) -> LabelRange {
+    let style = match dict_get(dict, "S") {
+        Some(ParsedValue::Name(s)) => match s.as_str() {
+            "D" => LabelStyle::Decimal,
+            "R" => LabelStyle::UpperRoman,
+            "r" => LabelStyle::LowerRoman,
+            "A" => LabelStyle::UpperLetters,
+            "a" => LabelStyle::LowerLetters,
+            _ => LabelStyle::None,
+        },
+        _ => LabelStyle::None,
+    };
+    let prefix = match dict_get(dict, "P") {
+        Some(ParsedValue::String(p)) => String::from_utf8_lossy(p).into_owned(),
+        _ => String::new(),
+    };
+    let start = dict_get(dict, "St")
+        .and_then(as_int)
+        .filter(|&s| s >= 1)
+        .unwrap_or(1);
+    LabelRange {
+        first,
+        style,
+        prefix,
+        start,
+    }
+}
+
+/// `n` in upper-case roman numerals
+fn roman(mut n: i64) -> String {
+    const NUMERALS: [(i64, &str); 13] = [
+        (1000, "M"),
+        (900, "CM"),
+        (500, "D"),
+        (400, "CD"),
+        (100, "C"),
+        (90, "XC"),
+        (50, "L"),
+        (40, "XL"),
+        (10, "X"),
+        (9, "IX"),
+        (5, "V"),
+        (4, "IV"),
+        (1, "I"),
+    ];
+    let mut out = String::new();
+    for (value, numeral) in NUMERALS {
+        while n >= value {
+            out.push_str(numeral);
+            n -= value;
+        }
+    }
+    out
+}
+
+/// `n` as PDF letter numbering: A..Z, then AA..ZZ, AAA..
+fn letters(n: i64) -> String {
+    let Ok(n) = usize::try_from(n - 1) else {
+        return String::new();
+    };
+    let letter = char::from(b'A' + (n % 26) as u8);
+    std::iter::repeat_n(letter, n / 26 + 1).collect()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    /// A PDF with no xref, holding `objects` as (number, body)
+    fn pdf(objects: &[(i32, String)]) -> Arc<FileBytes> {
+        let mut pdf = b"%PDF-1.7\n".to_vec();
+        for (num, body) in objects {
+            pdf.extend_from_slice(format!("{num} 0 obj\n{body}\nendobj\n").as_bytes());
+        }
+        pdf.extend_from_slice(b"trailer\n<< /Root 1 0 R >>\n%%EOF\n");
+        Arc::new(pdf.into())
+    }
+
+    /// A page tree that is one long chain: each node holds a page and the
+    /// next node, with a /Rotate halfway down
+    fn chain_pdf(pages: i32) -> Arc<FileBytes> {
+        let mut objects = vec![(
+            1,
+            "<< /Type /Catalog /Pages 2 0 R /PageLabels << /Nums [0 << /S /r >> 2 << /S /D /P (p-) /St 5 >> 4 << /S /A >>] >> >>"
+                .to_string(),
+        )];
+        let node = |i: i32| 2 + 2 * i;
+        for i in 0..pages {
+            let page = node(i) + 1;
+            let kids = if i + 1 < pages {
+                format!("[{page} 0 R {} 0 R]", node(i + 1))
+            } else {
+                format!("[{page} 0 R]")
+            };
+            let rotate = if i == pages / 2 { "/Rotate 90" } else { "" };
+            objects.push((
+                node(i),
+                format!(
+                    "<< /Type /Pages /Kids {kids} /Count {} {rotate} >>",
+                    pages - i
+                ),
+            ));
+            objects.push((page, "<< /Type /Page >>".to_string()));
+        }
+        objects[1].1 = objects[1].1.replace(">>", "/MediaBox [0 0 612 792] >>");
+        pdf(&objects)
+    }
+
+    #[test]
+    fn test_index_of_unbalanced_tree() {
+        let index = PageIndex::build(&chain_pdf(40)).unwrap();
+        assert_eq!(index.len(), 40);
+        for i in 0..40 {
+            let page = index.page(i).unwrap();
+            assert_eq!(page.num, 3 + 2 * i as i32);
+            assert_eq!(index.page_number(page.num), Some(i));
+            let keys: Vec<&str> = page.inherited.iter().map(|(k, _)| k.as_str()).collect();
+            if i >= 20 {
+                assert_eq!(keys, ["MediaBox", "Rotate"]);
+            } else {
+                assert_eq!(keys, ["MediaBox"]);
+            }
+        }
+        assert_eq!(index.page_number(2), None);
+        assert!(index.page(40).is_none());
+
+        let labels: Vec<&str> = index.pages()[..7]
+            .iter()
+            .map(|p| p.label.as_str())
+            .collect();
+        assert_eq!(labels, ["i", "ii", "p-5", "p-6", "A", "B", "C"]);
+    }
+
+    #[test]
+    fn test_parallel_index_matches_serial() {
+        let data = chain_pdf(70);
+        let serial = PageIndex::build_with(&data, 1).unwrap();
+        let parallel = PageIndex::build_with(&data, 4).unwrap();
+        assert_eq!(parallel.len(), serial.len());
+        for (a, b) in serial.pages().iter().zip(parallel.pages()) {
+            assert_eq!((a.num, &a.label), (b.num, &b.label));
+            assert_eq!(format!("{:?}", a.inherited), format!("{:?}", b.inherited));
+        }
+    }
+
+    #[test]
+    fn test_page_bounds() {
+        let data = pdf(&[
+            (1, "<< /Type /Catalog /Pages 2 0 R >>".to_string()),
+            (
+                2,
+                "<< /Type /Pages /Kids [3 0 R 4 0 R 5 0 R] /MediaBox 6 0 R /Rotate -90 >>"
+                    .to_string(),
+            ),
+            (
+                3,
+                "<< /Type /Page /CropBox [50 -10 250 100] /UserUnit 2 >>".to_string(),
+            ),
+            (
+                4,
+                "<< /Type /Page /Rotate 180 /MediaBox [100 0 0 50] >>".to_string(),
+            ),
+            (
+                5,
+                "<< /Type /Page /MediaBox [0 0 0 0] /Rotate 0 >>".to_string(),
+            ),
+            (6, "[0 0 300 400]".to_string()),
+        ]);
+        let index = PageIndex::build(&data).unwrap();
+        let bounds: Vec<[f32; 4]> = index.pages().iter().map(|p| p.bounds).collect();
+        assert_eq!(
+            bounds,
+            [
+                [0.0, 0.0, 200.0, 400.0],
+                [0.0, 0.0, 100.0, 50.0],
+                DEFAULT_MEDIA_BOX
+            ]
+        );
+    }
+
+    #[test]
+    fn test_labels() {
+        assert_eq!(roman(1994), "MCMXCIV");
+        assert_eq!(letters(1), "A");
+        assert_eq!(letters(28), "BB");
+        let labels = PageLabels::default();
+        assert_eq!(labels.label(4), "5");
+
+        // A page's own attributes win, and a cycle in the tree is cut
+        let data = pdf(&[
+            (1, "<< /Type /Catalog /Pages 2 0 R >>".to_string()),
+            (
+                2,
+                "<< /Type /Pages /Kids [3 0 R 2 0 R] /Rotate 90 >>".to_string(),
+            ),
+            (3, "<< /Type /Page /Rotate 0 >>".to_string()),
+        ]);
+        let index = PageIndex::build(&data).unwrap();
+        assert_eq!(index.len(), 1);
+        assert!(index.page(0).unwrap().inherited.is_empty());
+        assert_eq!(index.page(0).unwrap().label, "1");
+    }
+}
@@ -4,6 +4,8 @@
 //! This module implements the MuPDF pdf_parse API for tokenizing and
 //! parsing PDF syntax structures.
 
+use crate::ffi::pdf_object::{PdfObj, PdfObjHandle, PdfObjType, new_document_object};
+use crate::ffi::simd_util::{self, PdfByteClass, scan_pdf_class};
 use crate::ffi::{Handle, HandleStore};
 use std::ffi::{CStr, CString, c_char, c_void};
 use std::ptr;
@@ -275,7 +277,7 @@ impl PdfParser {
             match ch {
                 // Whitespace characters
                 b' ' | b'\t' | b'\r' | b'\n' | 0x00 | 0x0c => {
-                    self.pos += 1;
+                    self.pos += scan_pdf_class(&self.data[self.pos..], PdfByteClass::Whitespace);
                 }
                 // Comment
                 b'%' => {
@@ -295,21 +297,31 @@ impl PdfParser {
 
     /// Check if character is a PDF delimiter
     fn is_delimiter(ch: u8) -> bool {
-        matches!(
-            ch,
-            b'(' | b')' | b'<' | b'>' | b'[' | b']' | b'{' | b'}' | b'/' | b'%'
-        )
+        simd_util::is_pdf_delimiter(ch)
     }
 
     /// Check if character is whitespace
     fn is_whitespace(ch: u8) -> bool {
-        matches!(ch, b' ' | b'\t' | b'\r' | b'\n' | 0x00 | 0x0c)
+        simd_util::is_pdf_whitespace(ch)
+    }
+
+    /// Length of the run of regular characters at the current position
+    fn regular_run(&self) -> usize {
+        scan_pdf_class(&self.data[self.pos..], PdfByteClass::Regular)
     }
 
     /// Read a name token (after /)
     fn read_name(&mut self) -> PdfToken {
         self.lexbuf.scratch.clear();
 
+        // Names without #XX escapes are copied as one run
+        let run = self.regular_run();
+        let body = &self.data[self.pos..self.pos + run];
+        if !body.contains(&b'#') {
+            self.lexbuf.scratch.extend_from_slice(body);
+            self.pos += run;
+        }
+
         while let Some(ch) = self.peek() {
             if Self::is_whitespace(ch) || Self::is_delimiter(ch) {
                 break;
@@ -349,45 +361,55 @@ impl PdfParser {
 
     /// Read a number (integer or real)
     fn read_number(&mut self, first: u8) -> PdfToken {
-        self.lexbuf.scratch.clear();
-        self.lexbuf.scratch.push(first);
+        let start = self.pos - 1;
 
         // If the first character is '.', it's already a real number
         let mut is_real = first == b'.';
-
-        while let Some(ch) = self.peek() {
-            match ch {
-                b'0'..=b'9' => {
-                    self.pos += 1;
-                    self.lexbuf.scratch.push(ch);
-                }
-                b'.' => {
-                    if is_real {
-                        break; // Second dot, stop
-                    }
-                    is_real = true;
-                    self.pos += 1;
-                    self.lexbuf.scratch.push(ch);
-                }
-                b'+' | b'-' => {
-                    // Sign only valid at start (but we already have first char)
-                    break;
-                }
-                _ => break,
-            }
+        self.pos += scan_pdf_class(&self.data[self.pos..], PdfByteClass::Digit);
+        // One '.' may follow the integer part; a second dot or a sign ends the token
+        if !is_real && self.peek() == Some(b'.') {
+            is_real = true;
+            self.pos += 1;
+            self.pos += scan_pdf_class(&self.data[self.pos..], PdfByteClass::Digit);
         }
 
-        let num_str = String::from_utf8_lossy(&self.lexbuf.scratch).to_string();
+        let token = &self.data[start..self.pos];
+        self.lexbuf.scratch.clear();
+        self.lexbuf.scratch.extend_from_slice(token);
 
         if is_real {
-            self.lexbuf.f = num_str.parse().unwrap_or(0.0);
+            // Only ASCII digits, signs and '.' reach here
+            self.lexbuf.f = std::str::from_utf8(token)
+                .ok()
+                .and_then(|t| t.parse().ok())
+                .unwrap_or(0.0);
             PdfToken::Real
         } else {
-            self.lexbuf.i = num_str.parse().unwrap_or(0);
+            self.lexbuf.i = Self::parse_int(token);
             PdfToken::Int
         }
     }
 
+    /// Parse `[+-]digits`, with `str::parse` semantics (0 on error or overflow)
+    fn parse_int(token: &[u8]) -> i64 {
+        let (negative, digits) = match token.split_first() {
+            Some((b'-', rest)) => (true, rest),
+            Some((b'+', rest)) => (false, rest),
+            _ => (false, token),
+        };
+        // 18 digits always fit in an i64
+        if digits.is_empty() || digits.len() > 18 {
+            return std::str::from_utf8(token)
+                .ok()
+                .and_then(|t| t.parse().ok())
+                .unwrap_or(0);
+        }
+        let value = digits
+            .iter()
+            .fold(0i64, |acc, &d| acc * 10 + i64::from(d - b'0'));
+        if negative { -value } else { value }
+    }
+
     /// Read a literal string (...)
     fn read_string(&mut self) -> PdfToken {
         self.lexbuf.scratch.clear();
@@ -514,13 +536,11 @@ impl PdfParser {
         self.lexbuf.scratch.clear();
         self.lexbuf.scratch.push(first);
 
-        while let Some(ch) = self.peek() {
-            if Self::is_whitespace(ch) || Self::is_delimiter(ch) {
-                break;
-            }
-            self.pos += 1;
-            self.lexbuf.scratch.push(ch);
-        }
+        let run = self.regular_run();
+        self.lexbuf
+            .scratch
+            .extend_from_slice(&self.data[self.pos..self.pos + run]);
+        self.pos += run;
 
         let keyword = String::from_utf8_lossy(&self.lexbuf.scratch).to_string();
         self.lexbuf.string_value = keyword.clone();
@@ -594,8 +614,73 @@ impl PdfParser {
         // For simplicity, same as lex for now
         self.lex()
     }
+
+    /// Parse one object at the current position
+    ///
+    /// Unlike the handle-based `pdf_parse_*` entry points this works on the
+    /// parser directly, for readers that pull objects out of a file
+    /// themselves. `num gen R` comes back as a reference.
+    pub fn parse_value(&mut self) -> Option<ParsedValue> {
+        let token = self.lex();
+        self.parse_value_from(token, 0)
+    }
+
+    fn parse_value_from(&mut self, token: PdfToken, depth: usize) -> Option<ParsedValue> {
+        if depth > MAX_PARSE_DEPTH {
+            self.error = Some("Objects nested too deeply".to_string());
+            return None;
+        }
+        match token {
+            PdfToken::OpenArray => {
+                let mut items = Vec::new();
+                loop {
+                    match self.lex() {
+                        PdfToken::CloseArray => return Some(ParsedValue::Array(items)),
+                        t => items.push(self.parse_value_from(t, depth + 1)?),
+                    }
+                }
+            }
+            PdfToken::OpenDict => {
+                let mut entries = Vec::new();
+                loop {
+                    match self.lex() {
+                        PdfToken::CloseDict => return Some(ParsedValue::Dict(entries)),
+                        PdfToken::Name => {
+                            let key = std::mem::take(&mut self.lexbuf.string_value);
+                            let t = self.lex();
+                            entries.push((key, self.parse_value_from(t, depth + 1)?));
+                        }
+                        _ => {
+                            self.error = Some("Expected name in dict".to_string());
+                            return None;
+                        }
+                    }
+                }
+            }
+            PdfToken::Int => {
+                let num = self.lexbuf.i;
+                // Look ahead for `gen R`
+                let save_pos = self.pos;
+                if self.lex() == PdfToken::Int {
+                    let generation = self.lexbuf.i;
+                    if self.lex() == PdfToken::R {
+                        return Some(ParsedValue::Reference {
+                            num: num as i32,
+                            generation: generation as i32,
+                        });
+                    }
+                }
+                self.pos = save_pos;
+                Some(ParsedValue::Int(num))
+            }
+            _ => token_to_value(&self.lexbuf, token),
+        }
+    }
 }
 
+/// Nesting limit for `PdfParser::parse_value`
+const MAX_PARSE_DEPTH: usize = 256;
+
 // ============================================================================
 // Global Handle Stores
 // ============================================================================
@@ -936,20 +1021,17 @@ pub extern "C" fn pdf_parse_dict(_ctx: Handle, _doc: Handle, parser: Handle) ->
                 } else if value_token == PdfToken::OpenArray {
                     // Parse nested array recursively
                     let arr_handle = pdf_parse_array(_ctx, _doc, parser);
-                    if arr_handle == 0 {
+                    let Some(value) = take_parsed_value(arr_handle) else {
                         return 0;
-                    }
-                    // Store as array placeholder
-                    entries.push((key, ParsedValue::Array(Vec::new())));
-                    PARSED_OBJECTS.remove(arr_handle);
+                    };
+                    entries.push((key, value));
                 } else if value_token == PdfToken::OpenDict {
                     // Parse nested dict recursively
                     let dict_handle = pdf_parse_dict(_ctx, _doc, parser);
-                    if dict_handle == 0 {
+                    let Some(value) = take_parsed_value(dict_handle) else {
                         return 0;
-                    }
-                    entries.push((key, ParsedValue::Dict(Vec::new())));
-                    PARSED_OBJECTS.remove(dict_handle);
+                    };
+                    entries.push((key, value));
                 } else {
                     let mut parser_guard = parser_arc.lock().unwrap();
                     parser_guard.error = Some("Invalid value in dict".to_string());
@@ -1110,6 +1192,72 @@ pub enum ParsedObject {
 
 pub static PARSED_OBJECTS: LazyLock<HandleStore<ParsedObject>> = LazyLock::new(HandleStore::new);
 
+/// Remove a parsed object from the store and return it as a value
+fn take_parsed_value(handle: Handle) -> Option<ParsedValue> {
+    let arc = PARSED_OBJECTS.remove(handle)?;
+    let mut guard = arc.lock().ok()?;
+    Some(
+        match std::mem::replace(&mut *guard, ParsedObject::Value(ParsedValue::Null)) {
+            ParsedObject::Value(v) => v,
+            ParsedObject::Array(items) => ParsedValue::Array(items),
+            ParsedObject::Dict(entries) => ParsedValue::Dict(entries),
+            ParsedObject::IndirectObject { value, .. } => *value,
+        },
+    )
+}
+
+/// Build the pdf_obj tree for a parsed value
+pub(crate) fn parsed_value_to_obj(value: &ParsedValue) -> PdfObj {
+    let mut obj = PdfObj::new_null();
+    obj.obj_type = match value {
+        ParsedValue::Null => PdfObjType::Null,
+        ParsedValue::Bool(b) => PdfObjType::Bool(*b),
+        ParsedValue::Int(i) => PdfObjType::Int(*i),
+        ParsedValue::Real(f) => PdfObjType::Real(*f as f64),
+        ParsedValue::String(data) => PdfObjType::String(data.clone()),
+        ParsedValue::Name(name) => PdfObjType::Name(name.clone()),
+        ParsedValue::Array(items) => {
+            PdfObjType::Array(items.iter().map(parsed_value_to_obj).collect())
+        }
+        ParsedValue::Dict(entries) => PdfObjType::Dict(
+            entries
+                .iter()
+                .map(|(k, v)| (k.clone(), parsed_value_to_obj(v)))
+                .collect(),
+        ),
+        ParsedValue::Reference { num, generation } => PdfObjType::Indirect {
+            num: *num,
+            generation: *generation,
+        },
+    };
+    obj
+}
+
+/// Parsed value for a pdf_obj tree; a stream gives its dictionary
+pub(crate) fn obj_to_parsed_value(obj: &PdfObj) -> ParsedValue {
+    match &obj.obj_type {
+        PdfObjType::Null => ParsedValue::Null,
+        PdfObjType::Bool(b) => ParsedValue::Bool(*b),
+        PdfObjType::Int(i) => ParsedValue::Int(*i),
+        PdfObjType::Real(f) => ParsedValue::Real(*f as f32),
+        PdfObjType::String(data) => ParsedValue::String(data.clone()),
+        PdfObjType::Name(name) => ParsedValue::Name(name.clone()),
+        PdfObjType::Array(items) => {
+            ParsedValue::Array(items.iter().map(obj_to_parsed_value).collect())
+        }
+        PdfObjType::Dict(dict) => ParsedValue::Dict(
+            dict.iter()
+                .map(|(k, v)| (k.clone(), obj_to_parsed_value(v)))
+                .collect(),
+        ),
+        PdfObjType::Indirect { num, generation } => ParsedValue::Reference {
+            num: *num,
+            generation: *generation,
+        },
+        PdfObjType::Stream { dict, .. } => obj_to_parsed_value(dict),
+    }
+}
+
 /// Convert a token to a parsed value
 fn token_to_value(lexbuf: &PdfLexbuf, token: PdfToken) -> Option<ParsedValue> {
     match token {
@@ -1155,6 +1303,29 @@ pub extern "C" fn pdf_parsed_obj_type(_ctx: Handle, obj: Handle) -> i32 {
     -1
 }
 
+/// Convert a parsed object into a pdf_obj owned by `doc`
+///
+/// When the document has an object arena (`pdf_set_document_object_arena`)
+/// the result lives there and is freed with the document; otherwise it is
+/// an ordinary object released with `pdf_drop_obj`. The parsed object is
+/// left untouched.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_parsed_obj_to_object(_ctx: Handle, doc: Handle, obj: Handle) -> PdfObjHandle {
+    let Some(obj_arc) = PARSED_OBJECTS.get(obj) else {
+        return 0;
+    };
+    let pdf_obj = {
+        let obj_guard = obj_arc.lock().unwrap();
+        match &*obj_guard {
+            ParsedObject::Value(v) => parsed_value_to_obj(v),
+            ParsedObject::Array(items) => parsed_value_to_obj(&ParsedValue::Array(items.clone())),
+            ParsedObject::Dict(entries) => parsed_value_to_obj(&ParsedValue::Dict(entries.clone())),
+            ParsedObject::IndirectObject { value, .. } => parsed_value_to_obj(value),
+        }
+    };
+    new_document_object(doc, pdf_obj)
+}
+
 /// Get array length
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_parsed_array_len(_ctx: Handle, obj: Handle) -> i32 {
@@ -1323,6 +1494,39 @@ mod tests {
         assert_eq!(parser.lexbuf.string_value, "Type");
     }
 
+    #[test]
+    fn test_lex_long_runs() {
+        // Tokens and gaps longer than a vector, ending at every kind of stop
+        let name = "A".repeat(40);
+        let mut data = format!("/{name}#41/{name}[");
+        data.push_str(&" \t\r\n".repeat(10));
+        data.push_str("123456789012345678 12345678901234567890 -12.5.5 ");
+        data.push_str(&format!("{name}true endobj"));
+        let mut parser = PdfParser::new(data.into_bytes());
+
+        assert_eq!(parser.lex(), PdfToken::Name);
+        assert_eq!(parser.lexbuf.string_value, format!("{name}A"));
+        assert_eq!(parser.lex(), PdfToken::Name);
+        assert_eq!(parser.lexbuf.string_value, name);
+        assert_eq!(parser.lex(), PdfToken::OpenArray);
+
+        assert_eq!(parser.lex(), PdfToken::Int);
+        assert_eq!(parser.lexbuf.i, 123456789012345678);
+        // Out of range, as str::parse reports it
+        assert_eq!(parser.lex(), PdfToken::Int);
+        assert_eq!(parser.lexbuf.i, 0);
+        assert_eq!(parser.lex(), PdfToken::Real);
+        assert_eq!(parser.lexbuf.f, -12.5);
+        assert_eq!(&parser.lexbuf.scratch, b"-12.5");
+        assert_eq!(parser.lex(), PdfToken::Real);
+        assert_eq!(parser.lexbuf.f, 0.5);
+
+        assert_eq!(parser.lex(), PdfToken::Keyword);
+        assert_eq!(parser.lexbuf.string_value, format!("{name}true"));
+        assert_eq!(parser.lex(), PdfToken::EndObj);
+        assert_eq!(parser.lex(), PdfToken::Eof);
+    }
+
     #[test]
     fn test_lex_strings() {
         let data = b"(Hello World) (Nested (parens)) (Escape \\n\\t)".to_vec();
@@ -1465,6 +1669,44 @@ mod tests {
         pdf_parser_drop(ctx, parser);
     }
 
+    #[test]
+    fn test_parse_into_document_arena() {
+        use crate::ffi::pdf_object::{
+            ArenaHandle, pdf_dict_gets, pdf_dict_len, pdf_document_object_arena, pdf_is_dict,
+            pdf_object_arena_stats, pdf_set_document_object_arena, pdf_to_int,
+        };
+
+        let ctx = 1;
+        let doc: Handle = 0x7fff_0002;
+        let data = b"<</Type /Page /Box <</W 612>> /Parent 3 0 R>>".to_vec();
+        let parser = pdf_parser_new(ctx, data.as_ptr(), data.len());
+        pdf_lex(ctx, parser);
+        let parsed = pdf_parse_dict(ctx, doc, parser);
+        assert!(parsed > 0);
+
+        let arena_id = pdf_set_document_object_arena(ctx, doc, 1);
+        let dict = pdf_parsed_obj_to_object(ctx, doc, parsed);
+        assert_eq!(ArenaHandle::from_handle(dict).arena_id, arena_id);
+        assert_eq!(pdf_is_dict(ctx, dict), 1);
+        assert_eq!(pdf_dict_len(ctx, dict), 3);
+
+        // Nested dicts survive parsing and their children stay in the arena
+        let bx = pdf_dict_gets(ctx, dict, c"Box".as_ptr());
+        assert_eq!(ArenaHandle::from_handle(bx).arena_id, arena_id);
+        let w = pdf_dict_gets(ctx, bx, c"W".as_ptr());
+        assert_eq!(pdf_to_int(ctx, w), 612);
+        // The int came back as an immediate, so only the two dicts are stored
+        assert_eq!(pdf_object_arena_stats(ctx, arena_id).active, 2);
+
+        // Closing the document's arena frees the whole tree at once
+        pdf_set_document_object_arena(ctx, doc, 0);
+        assert_eq!(pdf_document_object_arena(ctx, doc), 0);
+        assert_eq!(pdf_is_dict(ctx, dict), 0);
+
+        pdf_parsed_obj_drop(ctx, parsed);
+        pdf_parser_drop(ctx, parser);
+    }
+
     #[test]
     fn test_token_conversion() {
         assert_eq!(PdfToken::from_i32(0), PdfToken::Error);
@@ -3,9 +3,12 @@
 //! Provides support for PDF portfolios (packages/collections), including
 //! embedded file management, collection structure, and navigator schema.
 
+use super::output::OUTPUTS;
+use super::pdf_embedded_stream::{EmbeddedStream, embedded_files, stream_decoded};
+use super::pdf_stream_prefetch::parallel_map;
 use crate::ffi::{Handle, HandleStore};
 use std::collections::HashMap;
-use std::ffi::{CStr, CString, c_char};
+use std::ffi::{CStr, CString, c_char, c_void};
 use std::ptr;
 use std::sync::LazyLock;
 
@@ -659,6 +662,144 @@ pub extern "C" fn pdf_portfolio_set_sort(
     0
 }
 
+// ============================================================================
+// FFI Functions - Document Attachments
+// ============================================================================
+
+/// Receives an embedded file's data a chunk at a time; a nonzero return
+/// stops extraction
+pub type EmbeddedFileWriteFn =
+    Option<unsafe extern "C" fn(opaque: *mut c_void, data: *const u8, len: usize) -> i32>;
+
+/// The embedded file of `doc` named `name`
+fn find_embedded(doc: DocumentHandle, name: *const c_char) -> Option<EmbeddedStream> {
+    if name.is_null() {
+        return None;
+    }
+    let name = unsafe { CStr::from_ptr(name).to_string_lossy() };
+    embedded_files(doc)?.into_iter().find(|f| f.name == name)
+}
+
+/// Decode `file` into output `out`, holding it for the whole file
+fn write_to_output(file: &EmbeddedStream, out: Handle) -> Option<u64> {
+    let output = OUTPUTS.get(out)?;
+    let mut output = output.lock().ok()?;
+    let written = stream_decoded(file, &mut |chunk| output.write_data(chunk).is_ok())?;
+    output.flush().ok()?;
+    Some(written)
+}
+
+/// Count the files embedded in a document's `/EmbeddedFiles` name tree.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_count_embedded_files(_ctx: ContextHandle, doc: DocumentHandle) -> i32 {
+    embedded_files(doc).map_or(0, |files| files.len() as i32)
+}
+
+/// Get the name of a document's embedded file by index, in name tree
+/// order (caller frees with `pdf_portfolio_free_string`).
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_embedded_file_name(
+    _ctx: ContextHandle,
+    doc: DocumentHandle,
+    index: i32,
+) -> *mut c_char {
+    let file = usize::try_from(index)
+        .ok()
+        .and_then(|i| embedded_files(doc)?.into_iter().nth(i));
+    if let Some(file) = file {
+        if let Ok(cstr) = CString::new(file.name) {
+            return cstr.into_raw();
+        }
+    }
+    ptr::null_mut()
+}
+
+/// Write a document's embedded file, decoded, to an output.
+///
+/// Unfiltered and flate-compressed files are decoded a chunk at a time,
+/// so memory use doesn't grow with the file. Returns the number of bytes
+/// written, or -1 if the file isn't found or can't be decoded or written.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_write_embedded_file(
+    _ctx: ContextHandle,
+    doc: DocumentHandle,
+    name: *const c_char,
+    out: Handle,
+) -> i64 {
+    find_embedded(doc, name)
+        .and_then(|file| write_to_output(&file, out))
+        .map_or(-1, |n| n as i64)
+}
+
+/// Pass a document's embedded file, decoded, to `write` a chunk at a time.
+///
+/// Returns the number of bytes passed, or -1 if the file isn't found or
+/// can't be decoded, or `write` stopped.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_stream_embedded_file(
+    _ctx: ContextHandle,
+    doc: DocumentHandle,
+    name: *const c_char,
+    write: EmbeddedFileWriteFn,
+    opaque: *mut c_void,
+) -> i64 {
+    let Some(write) = write else {
+        return -1;
+    };
+    let Some(file) = find_embedded(doc, name) else {
+        return -1;
+    };
+    stream_decoded(&file, &mut |chunk| unsafe {
+        write(opaque, chunk.as_ptr(), chunk.len()) == 0
+    })
+    .map_or(-1, |n| n as i64)
+}
+
+/// Write several of a document's embedded files, each to its own output,
+/// on up to `threads` threads (0 = one per core).
+///
+/// File `i` goes to `outputs[i]`. With `names` NULL the first `count`
+/// files are written in name tree order; otherwise `names[i]` picks the
+/// file, and an unknown or NULL name is skipped. Returns the number of
+/// files written.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_extract_embedded_files(
+    _ctx: ContextHandle,
+    doc: DocumentHandle,
+    names: *const *const c_char,
+    outputs: *const Handle,
+    count: i32,
+    threads: i32,
+) -> i32 {
+    let count = usize::try_from(count).unwrap_or(0);
+    if outputs.is_null() || count == 0 {
+        return 0;
+    }
+    let Some(files) = embedded_files(doc) else {
+        return 0;
+    };
+    let outputs = unsafe { std::slice::from_raw_parts(outputs, count) };
+    let jobs: Vec<(Option<usize>, Handle)> = (0..count)
+        .map(|i| {
+            if names.is_null() {
+                return (Some(i), outputs[i]);
+            }
+            let name = unsafe { *names.add(i) };
+            if name.is_null() {
+                return (None, outputs[i]);
+            }
+            let name = unsafe { CStr::from_ptr(name).to_string_lossy() };
+            (files.iter().position(|f| f.name == name), outputs[i])
+        })
+        .collect();
+
+    let threads = usize::try_from(threads).unwrap_or(0);
+    let written = parallel_map(&jobs, threads, |&(index, out)| {
+        write_to_output(files.get(index?)?, out)
+    });
+    written.iter().filter(|w| w.is_some()).count() as i32
+}
+
 // ============================================================================
 // FFI Functions - Utility
 // ============================================================================
@@ -925,4 +1066,82 @@ mod tests {
             pdf_portfolio_free_string(s);
         }
     }
+
+    #[test]
+    fn test_ffi_extract_embedded_files() {
+        use crate::ffi::DOCUMENTS;
+        use crate::ffi::document::Document;
+        use crate::ffi::output::{fz_close_output, fz_drop_output, fz_new_output_with_path};
+        use crate::ffi::pdf_embedded_stream::tests::{attachments_pdf, large_contents};
+
+        unsafe extern "C" fn collect(opaque: *mut c_void, data: *const u8, len: usize) -> i32 {
+            let out = unsafe { &mut *(opaque as *mut Vec<u8>) };
+            out.extend_from_slice(unsafe { std::slice::from_raw_parts(data, len) });
+            0
+        }
+
+        let doc = DOCUMENTS.insert(Document::new(attachments_pdf()));
+        assert_eq!(pdf_count_embedded_files(0, doc), 3);
+        let name = pdf_embedded_file_name(0, doc, 1);
+        assert_eq!(
+            unsafe { CStr::from_ptr(name) }.to_str().unwrap(),
+            "notes.txt"
+        );
+        pdf_portfolio_free_string(name);
+        assert!(pdf_embedded_file_name(0, doc, 3).is_null());
+
+        let mut data = Vec::new();
+        let opaque = &mut data as *mut Vec<u8> as *mut c_void;
+        let n = pdf_stream_embedded_file(0, doc, c"big.bin".as_ptr(), Some(collect), opaque);
+        assert_eq!(n, large_contents().len() as i64);
+        assert_eq!(data, large_contents());
+        let missing = pdf_stream_embedded_file(0, doc, c"none".as_ptr(), Some(collect), opaque);
+        assert_eq!(missing, -1);
+
+        // Every file at once, each to its own output
+        let paths: Vec<_> = (0..3)
+            .map(|i| std::env::temp_dir().join(format!("embedded_{}_{i}.bin", std::process::id())))
+            .collect();
+        let outputs: Vec<Handle> = paths
+            .iter()
+            .map(|p| {
+                let path = CString::new(p.to_str().unwrap()).unwrap();
+                fz_new_output_with_path(0, path.as_ptr(), 0)
+            })
+            .collect();
+        assert_eq!(
+            pdf_extract_embedded_files(0, doc, ptr::null(), outputs.as_ptr(), 3, 0),
+            3
+        );
+        for &out in &outputs {
+            fz_close_output(0, out);
+            fz_drop_output(0, out);
+        }
+        assert_eq!(std::fs::read(&paths[0]).unwrap(), large_contents());
+        assert_eq!(std::fs::read(&paths[1]).unwrap(), b"some notes");
+        assert_eq!(std::fs::read(&paths[2]).unwrap(), b"abcd");
+
+        // Picked by name; an unknown name is skipped
+        let out = {
+            let path = CString::new(paths[0].to_str().unwrap()).unwrap();
+            fz_new_output_with_path(0, path.as_ptr(), 0)
+        };
+        let names = [c"rows.dat".as_ptr(), c"none".as_ptr()];
+        assert_eq!(
+            pdf_extract_embedded_files(0, doc, names.as_ptr(), [out, out].as_ptr(), 2, 2),
+            1
+        );
+        assert_eq!(
+            pdf_write_embedded_file(0, doc, c"notes.txt".as_ptr(), out),
+            10
+        );
+        fz_close_output(0, out);
+        fz_drop_output(0, out);
+        assert_eq!(std::fs::read(&paths[0]).unwrap(), b"abcdsome notes");
+
+        for path in &paths {
+            let _ = std::fs::remove_file(path);
+        }
+        DOCUMENTS.remove(doc);
+    }
 }
@@ -2,8 +2,30 @@
 //!
 //! Provides PDF color conversion functionality including page recoloring,
 //! shade recoloring, and output intent management.
-
-use crate::ffi::{Handle, HandleStore};
+//!
+//! A document is recolored resource by resource rather than page by page:
+//! the content streams, images and shadings its pages use are found first,
+//! through forms and patterns, once each however many pages share them.
+//! They are converted on a pool of threads, images through the SIMD pixel
+//! kernels, and written back in one rewrite.
+
+use super::colorspace::{
+    FZ_COLORSPACE_CMYK, FZ_COLORSPACE_GRAY, FZ_COLORSPACE_RGB, fz_colorspace_n,
+};
+use super::pdf_image_rewriter::{MAX_RESOURCE_DEPTH, components, inherited, resolve};
+use super::pdf_optimize::{inline_image_end, is_number, is_space, token_end};
+use super::pdf_parse::ParsedValue;
+use super::pdf_stream_prefetch::parallel_map;
+use super::pdf_write::{Edits, WriteSettings, open_source, set_key, write_opened};
+use super::pdf_xref::Xref;
+use super::pdf_xref_lazy::{as_int, as_ref, decode_stream, dict_get, is_name};
+use super::pixel_convert::convert_pixels;
+use super::shade::SHADES;
+use crate::ffi::{DOCUMENTS, Handle, HandleStore};
+use crate::fitz::output::push_fixed;
+use crate::pdf::filter::{decode_dct, encode_flate};
+use bytes::Bytes;
+use std::collections::{HashMap, HashSet};
 use std::ffi::c_void;
 use std::sync::LazyLock;
 
@@ -197,6 +219,697 @@ pub struct RecolorStats {
 pub static SHADE_RECOLOR_CONTEXTS: LazyLock<HandleStore<ShadeRecolorContext>> =
     LazyLock::new(HandleStore::new);
 
+// ============================================================================
+// Document Recoloring
+// ============================================================================
+
+/// Device colourspace name for `n` components
+fn device_name(n: usize) -> &'static str {
+    match n {
+        1 => "DeviceGray",
+        3 => "DeviceRGB",
+        _ => "DeviceCMYK",
+    }
+}
+
+fn device_handle(n: usize) -> ColorspaceHandle {
+    match n {
+        1 => FZ_COLORSPACE_GRAY,
+        3 => FZ_COLORSPACE_RGB,
+        _ => FZ_COLORSPACE_CMYK,
+    }
+}
+
+/// Operator setting a device colour of `n` components
+fn device_operator(n: usize, stroke: bool) -> &'static [u8] {
+    match (n, stroke) {
+        (1, false) => b"g",
+        (1, true) => b"G",
+        (3, false) => b"rg",
+        (3, true) => b"RG",
+        (_, false) => b"k",
+        (_, true) => b"K",
+    }
+}
+
+/// `src` (gray, RGB or CMYK, by its length) in the device space of
+/// `dst_n` components, padded with zeros to four
+pub(crate) fn convert_components(src: &[f32], dst_n: usize) -> [f32; 4] {
+    let mut out = [0.0; 4];
+    match (src.len(), dst_n) {
+        (s, d) if s == d && s <= 4 => out[..s].copy_from_slice(src),
+        (1, 3) => out[..3].fill(src[0]),
+        (1, 4) => out[3] = 1.0 - src[0],
+        (3, 1) => out[0] = pdf_rgb_to_gray(src[0], src[1], src[2]),
+        (3, 4) => {
+            let [c, m, y, k] = &mut out;
+            pdf_rgb_to_cmyk(src[0], src[1], src[2], c, m, y, k);
+        }
+        (4, 1 | 3) => {
+            let mut rgb = [0.0f32; 3];
+            let [r, g, b] = &mut rgb;
+            pdf_cmyk_to_rgb(src[0], src[1], src[2], src[3], r, g, b);
+            match dst_n {
+                1 => out[0] = pdf_rgb_to_gray(rgb[0], rgb[1], rgb[2]),
+                _ => out[..3].copy_from_slice(&rgb),
+            }
+        }
+        _ => {}
+    }
+    out
+}
+
+fn number(value: &ParsedValue) -> Option<f32> {
+    match value {
+        ParsedValue::Int(n) => Some(*n as f32),
+        ParsedValue::Real(r) => Some(*r),
+        _ => None,
+    }
+}
+
+fn numbers(value: Option<&ParsedValue>) -> Option<Vec<f32>> {
+    match value? {
+        ParsedValue::Array(items) => items.iter().map(number).collect(),
+        _ => None,
+    }
+}
+
+fn reals(values: &[f32]) -> ParsedValue {
+    ParsedValue::Array(values.iter().map(|&v| ParsedValue::Real(v)).collect())
+}
+
+/// `values` as content stream operands, then `op`
+fn colour_operation(values: &[f32], op: &[u8]) -> Vec<u8> {
+    let mut out = Vec::new();
+    for v in values {
+        push_fixed(&mut out, v.clamp(0.0, 1.0), 4);
+        out.push(b' ');
+    }
+    out.extend_from_slice(op);
+    out
+}
+
+/// Components of a content stream's fill and stroke colourspaces, `None`
+/// for spaces whose colours are left alone
+#[derive(Debug, Clone, Copy)]
+struct ColourState {
+    fill: Option<usize>,
+    stroke: Option<usize>,
+}
+
+/// Content stream `data` with its colours converted to the device space
+/// of `target` components, and how many were
+///
+/// Colours are converted when set in a device space, directly (`g`, `rg`,
+/// `k`) or after `cs` selects one by name or through `spaces` (resource
+/// name to components), and in the space of `initial` components the
+/// stream starts in, if that is known. `cs` choosing a converted space is
+/// rewritten to choose the target. Everything else, inline images
+/// included, is copied as it is.
+pub(crate) fn recolor_content(
+    data: &[u8],
+    spaces: &HashMap<String, usize>,
+    initial: Option<usize>,
+    target: usize,
+) -> (Vec<u8>, i32) {
+    let mut out = Vec::with_capacity(data.len());
+    let mut copied = 0;
+    let mut converted = 0;
+    let mut state = ColourState {
+        fill: initial,
+        stroke: initial,
+    };
+    let mut saved = Vec::new();
+    // Spans of the operands read since the last operator
+    let mut operands: Vec<(usize, usize)> = Vec::new();
+    let mut i = 0;
+
+    while i < data.len() {
+        let b = data[i];
+        if is_space(b) {
+            i += 1;
+            continue;
+        }
+        if b == b'%' {
+            while i < data.len() && !matches!(data[i], b'\r' | b'\n') {
+                i += 1;
+            }
+            continue;
+        }
+        let start = i;
+        i = token_end(data, i);
+        let token = &data[start..i];
+        if b == b'/'
+            || !token[0].is_ascii_alphabetic() && !matches!(b, b'\'' | b'"' | b'*')
+            || matches!(token, b"true" | b"false" | b"null")
+        {
+            operands.push((start, i));
+            continue;
+        }
+        if token == b"ID" {
+            i = inline_image_end(data, (i + 1).min(data.len()));
+            operands.clear();
+            continue;
+        }
+        match token {
+            b"q" => saved.push(state),
+            b"Q" => state = saved.pop().unwrap_or(state),
+            _ => {}
+        }
+
+        let values: Option<Vec<f32>> = operands
+            .iter()
+            .map(|&(s, e)| {
+                let operand = &data[s..e];
+                is_number(operand)
+                    .then(|| std::str::from_utf8(operand).ok()?.parse().ok())
+                    .flatten()
+            })
+            .collect();
+        let colour = |n: usize| {
+            values
+                .as_ref()
+                .filter(|v| v.len() == n && n != target)
+                .map(|v| convert_components(v, target))
+        };
+        let stroke = token[0].is_ascii_uppercase();
+        let space = match stroke {
+            true => &mut state.stroke,
+            false => &mut state.fill,
+        };
+        let replacement = match token.to_ascii_lowercase().as_slice() {
+            op @ (b"g" | b"rg" | b"k") => {
+                let n = match op {
+                    b"g" => 1,
+                    b"rg" => 3,
+                    _ => 4,
+                };
+                *space = Some(n);
+                colour(n).map(|c| {
+                    (
+                        colour_operation(&c[..target], device_operator(target, stroke)),
+                        true,
+                    )
+                })
+            }
+            b"cs" => {
+                let name = match operands.as_slice() {
+                    [(s, e)] if data[*s] == b'/' => std::str::from_utf8(&data[s + 1..*e]).ok(),
+                    _ => None,
+                };
+                *space = name.and_then(|name| match name {
+                    "DeviceGray" => Some(1),
+                    "DeviceRGB" => Some(3),
+                    "DeviceCMYK" => Some(4),
+                    _ => spaces.get(name).copied(),
+                });
+                space.filter(|&n| n != target).map(|_| {
+                    let mut op = format!("/{} ", device_name(target)).into_bytes();
+                    op.extend_from_slice(token);
+                    (op, false)
+                })
+            }
+            b"sc" | b"scn" => space
+                .and_then(colour)
+                .map(|c| (colour_operation(&c[..target], token), true)),
+            _ => None,
+        };
+        if let Some((replacement, is_colour)) = replacement {
+            let from = operands.first().map_or(start, |o| o.0);
+            out.extend_from_slice(&data[copied..from]);
+            out.extend_from_slice(&replacement);
+            copied = i;
+            converted += i32::from(is_colour);
+        }
+        operands.clear();
+    }
+    out.extend_from_slice(&data[copied..]);
+    (out, converted)
+}
+
+/// What a colour resource is
+enum ResourceKind {
+    /// Content stream (page, form or tiling pattern), with its resources'
+    /// named colourspaces and the components of the space it starts in
+    Content {
+        spaces: HashMap<String, usize>,
+        initial: Option<usize>,
+    },
+    /// Image of `n` components
+    Image { n: usize },
+    /// Shading of `n` components, its functions resolved in place
+    Shading { n: usize },
+}
+
+/// A unique colour resource, however many pages and forms use it
+struct ColourResource {
+    num: i32,
+    dict: ParsedValue,
+    /// Raw (still encoded) data, for streams
+    raw: Option<Bytes>,
+    kind: ResourceKind,
+}
+
+/// Objects referenced from resource category `key` of `resources`
+fn resource_refs(xref: &mut Xref, resources: &ParsedValue, key: &str) -> Vec<i32> {
+    match dict_get(resources, key).and_then(|d| resolve(xref, d)) {
+        Some(ParsedValue::Dict(entries)) => entries.iter().filter_map(|(_, v)| as_ref(v)).collect(),
+        _ => Vec::new(),
+    }
+}
+
+/// Components of each named colourspace of `resources` that has plain ones
+fn named_spaces(xref: &mut Xref, resources: &ParsedValue) -> HashMap<String, usize> {
+    let Some(ParsedValue::Dict(entries)) =
+        dict_get(resources, "ColorSpace").and_then(|d| resolve(xref, d))
+    else {
+        return HashMap::new();
+    };
+    entries
+        .iter()
+        .filter_map(|(name, cs)| Some((name.clone(), components(xref, Some(cs))?)))
+        .collect()
+}
+
+/// `value` with every reference in it replaced by the object, or `None`
+/// if one is a stream or they nest too deep
+fn inline_refs(xref: &mut Xref, value: &ParsedValue, depth: usize) -> Option<ParsedValue> {
+    if depth > MAX_RESOURCE_DEPTH {
+        return None;
+    }
+    match value {
+        ParsedValue::Reference { num, .. } => {
+            let fetched = xref.fetch(*num)?;
+            if fetched.stream.is_some() {
+                return None;
+            }
+            inline_refs(xref, &fetched.value, depth + 1)
+        }
+        ParsedValue::Array(items) => items
+            .iter()
+            .map(|v| inline_refs(xref, v, depth + 1))
+            .collect::<Option<_>>()
+            .map(ParsedValue::Array),
+        ParsedValue::Dict(entries) => entries
+            .iter()
+            .map(|(k, v)| Some((k.clone(), inline_refs(xref, v, depth + 1)?)))
+            .collect::<Option<_>>()
+            .map(ParsedValue::Dict),
+        other => Some(other.clone()),
+    }
+}
+
+/// Every content stream, image and shading `pages` use, directly or
+/// through forms and patterns, once each, in page order
+fn collect_resources(xref: &mut Xref, pages: &[i32]) -> Vec<ColourResource> {
+    let mut found = Vec::new();
+    let mut seen = HashSet::new();
+
+    for &page in pages {
+        let resources = inherited(xref, page, "Resources");
+        let spaces = resources
+            .as_ref()
+            .map(|r| named_spaces(xref, r))
+            .unwrap_or_default();
+        let contents = xref
+            .fetch(page)
+            .and_then(|page| dict_get(&page.value, "Contents").cloned());
+        let nums: Vec<i32> = match &contents {
+            Some(ParsedValue::Array(items)) => items.iter().filter_map(as_ref).collect(),
+            Some(value) => as_ref(value).into_iter().collect(),
+            None => Vec::new(),
+        };
+        for num in nums {
+            let Some(fetched) = seen.insert(num).then(|| xref.fetch(num)).flatten() else {
+                continue;
+            };
+            if fetched.stream.is_some() {
+                found.push(ColourResource {
+                    num,
+                    dict: fetched.value,
+                    raw: fetched.stream,
+                    // Pages start in DeviceGray
+                    kind: ResourceKind::Content {
+                        spaces: spaces.clone(),
+                        initial: Some(1),
+                    },
+                });
+            }
+        }
+
+        let mut stack: Vec<(ParsedValue, HashMap<String, usize>, usize)> =
+            resources.map(|r| (r, spaces, 0)).into_iter().collect();
+        while let Some((resources, spaces, depth)) = stack.pop() {
+            let mut nums = resource_refs(xref, &resources, "XObject");
+            nums.extend(resource_refs(xref, &resources, "Pattern"));
+            nums.extend(resource_refs(xref, &resources, "Shading"));
+            while let Some(num) = nums.pop() {
+                let Some(fetched) = seen.insert(num).then(|| xref.fetch(num)).flatten() else {
+                    continue;
+                };
+                let value = fetched.value;
+                let subtype = dict_get(&value, "Subtype");
+                let pattern = dict_get(&value, "PatternType").and_then(as_int);
+                if is_name(subtype, "Image") {
+                    let cs = dict_get(&value, "ColorSpace").cloned();
+                    if let (Some(n), Some(_)) = (components(xref, cs.as_ref()), &fetched.stream) {
+                        found.push(ColourResource {
+                            num,
+                            dict: value,
+                            raw: fetched.stream,
+                            kind: ResourceKind::Image { n },
+                        });
+                    }
+                } else if is_name(subtype, "Form") || pattern == Some(1) {
+                    if fetched.stream.is_none() || depth >= MAX_RESOURCE_DEPTH {
+                        continue;
+                    }
+                    // Forms without resources of their own use their parent's
+                    let own = dict_get(&value, "Resources").and_then(|r| resolve(xref, r));
+                    let (resources, spaces) = match own {
+                        Some(own) => {
+                            let spaces = named_spaces(xref, &own);
+                            (own, spaces)
+                        }
+                        None => (resources.clone(), spaces.clone()),
+                    };
+                    found.push(ColourResource {
+                        num,
+                        dict: value,
+                        raw: fetched.stream,
+                        // A form's colours before it sets any are its caller's
+                        kind: ResourceKind::Content {
+                            spaces: spaces.clone(),
+                            initial: None,
+                        },
+                    });
+                    stack.push((resources, spaces, depth + 1));
+                } else if pattern == Some(2) {
+                    // Shadings inside a pattern are converted with it only
+                    // when they are objects of their own
+                    nums.extend(dict_get(&value, "Shading").and_then(as_ref));
+                } else if dict_get(&value, "ShadingType").is_some() {
+                    let cs = dict_get(&value, "ColorSpace").cloned();
+                    let Some(n) = components(xref, cs.as_ref()) else {
+                        continue;
+                    };
+                    let Some(dict) = inline_refs(xref, &value, 0) else {
+                        continue;
+                    };
+                    found.push(ColourResource {
+                        num,
+                        dict,
+                        raw: fetched.stream,
+                        kind: ResourceKind::Shading { n },
+                    });
+                }
+            }
+        }
+    }
+    found
+}
+
+/// Function `function`, giving colours of `n` components, changed to give
+/// them in the device space of `target` components
+///
+/// Exponential functions have their end colours converted, and stitching
+/// ones each of theirs; sampled and PostScript functions aren't changed.
+fn recolor_function(
+    function: &ParsedValue,
+    n: usize,
+    target: usize,
+    depth: usize,
+) -> Option<ParsedValue> {
+    if depth > MAX_RESOURCE_DEPTH {
+        return None;
+    }
+    let mut function = function.clone();
+    match dict_get(&function, "FunctionType").and_then(as_int) {
+        Some(2) => {
+            let c0 = numbers(dict_get(&function, "C0")).unwrap_or_else(|| vec![0.0]);
+            let c1 = numbers(dict_get(&function, "C1")).unwrap_or_else(|| vec![1.0]);
+            if c0.len() != n || c1.len() != n {
+                return None;
+            }
+            for (key, colour) in [("C0", c0), ("C1", c1)] {
+                let colour = convert_components(&colour, target);
+                set_key(&mut function, key, Some(reals(&colour[..target])));
+            }
+        }
+        Some(3) => {
+            let Some(ParsedValue::Array(functions)) = dict_get(&function, "Functions") else {
+                return None;
+            };
+            let functions = functions
+                .iter()
+                .map(|f| recolor_function(f, n, target, depth + 1))
+                .collect::<Option<_>>()?;
+            set_key(
+                &mut function,
+                "Functions",
+                Some(ParsedValue::Array(functions)),
+            );
+        }
+        _ => return None,
+    }
+    set_key(&mut function, "Range", None);
+    Some(function)
+}
+
+/// Shading `dict`, in a space of `n` components, changed to the device
+/// space of `target` components, if its colours come from a function
+/// that can be
+///
+/// Mesh shadings without a function keep their colours in the packed
+/// stream data, which isn't rewritten.
+fn recolor_shading(dict: &ParsedValue, n: usize, target: usize) -> Option<ParsedValue> {
+    let function = recolor_function(dict_get(dict, "Function")?, n, target, 0)?;
+    let background = numbers(dict_get(dict, "Background"))
+        .filter(|b| b.len() == n)
+        .map(|b| reals(&convert_components(&b, target)[..target]));
+    let mut dict = dict.clone();
+    set_key(&mut dict, "Function", Some(function));
+    set_key(&mut dict, "Background", background);
+    set_key(
+        &mut dict,
+        "ColorSpace",
+        Some(ParsedValue::Name(device_name(target).into())),
+    );
+    Some(dict)
+}
+
+/// Image `dict` of `n` components converted to the device space of
+/// `target` components, through the SIMD pixel kernels: new dictionary
+/// and data, or `None` for images it can't decode
+fn recolor_image(
+    dict: &ParsedValue,
+    raw: &Bytes,
+    n: usize,
+    target: usize,
+) -> Option<(ParsedValue, Bytes)> {
+    let int = |key| dict_get(dict, key).and_then(as_int).unwrap_or(0);
+    let mask = matches!(dict_get(dict, "ImageMask"), Some(ParsedValue::Bool(true)));
+    if mask || int("BitsPerComponent") != 8 || dict_get(dict, "Decode").is_some() {
+        return None;
+    }
+    let count = usize::try_from(int("Width")).ok()? * usize::try_from(int("Height")).ok()?;
+    let jpeg = match dict_get(dict, "Filter") {
+        Some(ParsedValue::Array(filters)) => {
+            filters.len() == 1 && is_name(filters.first(), "DCTDecode")
+        }
+        filter => is_name(filter, "DCTDecode"),
+    };
+    let pixels = match jpeg {
+        // CMYK JPEGs may be stored inverted, which the decoder doesn't say
+        true if n == 4 => return None,
+        true => decode_dct(raw, None).ok()?,
+        false => decode_stream(dict, raw)?,
+    };
+    if count == 0 || pixels.len() != count * n {
+        return None;
+    }
+    let mut converted = vec![0; count * target];
+    let (from, to) = (device_handle(n), device_handle(target));
+    if !convert_pixels(&pixels, from, false, &mut converted, to, false, count) {
+        return None;
+    }
+    let data = encode_flate(&converted, 6).ok()?;
+
+    let mut dict = dict.clone();
+    for key in ["DecodeParms", "DL"] {
+        set_key(&mut dict, key, None);
+    }
+    set_key(
+        &mut dict,
+        "Filter",
+        Some(ParsedValue::Name("FlateDecode".into())),
+    );
+    set_key(
+        &mut dict,
+        "ColorSpace",
+        Some(ParsedValue::Name(device_name(target).into())),
+    );
+    set_key(
+        &mut dict,
+        "Length",
+        Some(ParsedValue::Int(data.len() as i64)),
+    );
+    Some((dict, Bytes::from(data)))
+}
+
+/// Content stream `dict` and `raw` data recolored: new dictionary and
+/// data, and the colours converted; `None` if nothing changed
+fn recolor_stream(
+    dict: &ParsedValue,
+    raw: &Bytes,
+    spaces: &HashMap<String, usize>,
+    initial: Option<usize>,
+    target: usize,
+) -> Option<(ParsedValue, Bytes, i32)> {
+    let plain = decode_stream(dict, raw)?;
+    let (content, converted) = recolor_content(&plain, spaces, initial, target);
+    if content == plain {
+        return None;
+    }
+    let data = encode_flate(&content, 6).ok()?;
+    let mut dict = dict.clone();
+    for key in ["DecodeParms", "DL"] {
+        set_key(&mut dict, key, None);
+    }
+    set_key(
+        &mut dict,
+        "Filter",
+        Some(ParsedValue::Name("FlateDecode".into())),
+    );
+    set_key(
+        &mut dict,
+        "Length",
+        Some(ParsedValue::Int(data.len() as i64)),
+    );
+    Some((dict, Bytes::from(data), converted))
+}
+
+/// One resource converted to the device space of `target` components:
+/// new dictionary, stream data if it has any, and colours converted
+fn recolor_resource(
+    resource: &ColourResource,
+    target: usize,
+) -> Option<(ParsedValue, Option<Bytes>, i32)> {
+    match &resource.kind {
+        ResourceKind::Content { spaces, initial } => {
+            let raw = resource.raw.as_ref()?;
+            let (dict, data, converted) =
+                recolor_stream(&resource.dict, raw, spaces, *initial, target)?;
+            Some((dict, Some(data), converted))
+        }
+        ResourceKind::Image { n } if *n != target => {
+            let (dict, data) = recolor_image(&resource.dict, resource.raw.as_ref()?, *n, target)?;
+            Some((dict, Some(data), 0))
+        }
+        ResourceKind::Shading { n } if *n != target => {
+            let dict = recolor_shading(&resource.dict, *n, target)?;
+            Some((dict, resource.raw.clone(), 0))
+        }
+        _ => None,
+    }
+}
+
+/// Recolor pages `start..=end` of `doc` (to the last page, if `end` is
+/// past it) to the device space of `target` components
+///
+/// The pages' content streams, images and shadings are found first, each
+/// shared one once, then converted on `threads` threads (0 = one per
+/// core) and written back under their own numbers, so references to them
+/// are unchanged. The document's data is replaced if anything changed.
+pub(crate) fn recolor_pages(
+    doc: DocumentHandle,
+    start: i32,
+    end: i32,
+    target: usize,
+    threads: usize,
+) -> RecolorStats {
+    let mut stats = RecolorStats::default();
+    if !matches!(target, 1 | 3 | 4) {
+        return stats;
+    }
+    let Some(data) = DOCUMENTS.get(doc).map(|d| d.lock().unwrap().data()) else {
+        return stats;
+    };
+    let Some(mut xref) = open_source(&data, threads) else {
+        return stats;
+    };
+    xref.read_all_sections();
+    let pages: Vec<i32> = (start.max(0)..=end)
+        .map_while(|i| xref.lazy_page_object(i))
+        .collect();
+    stats.pages_processed = pages.len() as i32;
+    // Encrypted streams can't be read without decrypting them
+    if xref
+        .source_trailer()
+        .is_none_or(|t| dict_get(t, "Encrypt").is_some())
+    {
+        return stats;
+    }
+
+    let resources = collect_resources(&mut xref, &pages);
+    let recolored = parallel_map(&resources, threads, |r| recolor_resource(r, target));
+    let mut edits = Edits::default();
+    let mut converted = RecolorStats::default();
+    for (resource, result) in resources.iter().zip(recolored) {
+        let Some((dict, data, colours)) = result else {
+            continue;
+        };
+        match resource.kind {
+            ResourceKind::Content { .. } => converted.colors_converted += colours,
+            ResourceKind::Image { .. } => converted.images_processed += 1,
+            ResourceKind::Shading { .. } => converted.shades_recolored += 1,
+        }
+        match data {
+            Some(data) => {
+                edits.streams.insert(resource.num, (dict, data));
+            }
+            None => {
+                edits.objects.insert(resource.num, dict);
+            }
+        }
+    }
+    if edits.streams.is_empty() && edits.objects.is_empty() {
+        return stats;
+    }
+
+    let settings = WriteSettings {
+        compress: false,
+        decompress: false,
+        threads,
+        ..WriteSettings::default()
+    };
+    let mut out = Vec::new();
+    let saved = matches!(
+        write_opened(xref, &settings, &edits, &mut out),
+        Some(Ok(()))
+    );
+    if let Some(d) = DOCUMENTS.get(doc).filter(|_| saved) {
+        d.lock().unwrap().replace_data(out);
+        stats.colors_converted = converted.colors_converted;
+        stats.images_processed = converted.images_processed;
+        stats.shades_recolored = converted.shades_recolored;
+    }
+    stats
+}
+
+/// The document catalog's number and value
+fn catalog(xref: &mut Xref) -> Option<(i32, ParsedValue)> {
+    let root = dict_get(xref.source_trailer()?, "Root").and_then(as_ref)?;
+    Some((root, xref.fetch(root)?.value))
+}
+
+fn output_intents(xref: &mut Xref, catalog: &ParsedValue) -> i32 {
+    match dict_get(catalog, "OutputIntents").and_then(|v| resolve(xref, v)) {
+        Some(ParsedValue::Array(intents)) => intents.len() as i32,
+        _ => 0,
+    }
+}
+
 // ============================================================================
 // FFI Functions - Recolor Options
 // ============================================================================
@@ -241,40 +954,38 @@ pub extern "C" fn pdf_recolor_options_is_valid(opts: *const RecolorOptions) -> i
 /// Recolor a given document page.
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_recolor_page(
-    _ctx: ContextHandle,
-    _doc: DocumentHandle,
-    _pagenum: i32,
-    _opts: *const RecolorOptions,
+    ctx: ContextHandle,
+    doc: DocumentHandle,
+    pagenum: i32,
+    opts: *const RecolorOptions,
 ) {
-    // In a full implementation, this would:
-    // 1. Load the page content stream
-    // 2. Process all color operators (g, rg, k, cs, scn, etc.)
-    // 3. Convert colors to target colorspace
-    // 4. Rewrite the content stream with new colors
+    pdf_recolor_pages(ctx, doc, pagenum, pagenum, opts);
 }
 
 /// Recolor all pages in a document.
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_recolor_document(
-    _ctx: ContextHandle,
-    _doc: DocumentHandle,
-    _opts: *const RecolorOptions,
+    ctx: ContextHandle,
+    doc: DocumentHandle,
+    opts: *const RecolorOptions,
 ) -> RecolorStats {
-    // In a full implementation, this would recolor all pages
-    RecolorStats::default()
+    pdf_recolor_pages(ctx, doc, 0, i32::MAX, opts)
 }
 
-/// Recolor a range of pages.
+/// Recolor pages `start_page` to `end_page`, inclusive.
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_recolor_pages(
     _ctx: ContextHandle,
-    _doc: DocumentHandle,
-    _start_page: i32,
-    _end_page: i32,
-    _opts: *const RecolorOptions,
+    doc: DocumentHandle,
+    start_page: i32,
+    end_page: i32,
+    opts: *const RecolorOptions,
 ) -> RecolorStats {
-    // In a full implementation, this would recolor specified pages
-    RecolorStats::default()
+    if opts.is_null() {
+        return RecolorStats::default();
+    }
+    let num_comp = unsafe { (*opts).num_comp };
+    recolor_pages(doc, start_page, end_page, num_comp.max(0) as usize, 0)
 }
 
 // ============================================================================
@@ -283,18 +994,51 @@ pub extern "C" fn pdf_recolor_pages(
 
 /// Remove output intents from a document.
 #[unsafe(no_mangle)]
-pub extern "C" fn pdf_remove_output_intents(_ctx: ContextHandle, _doc: DocumentHandle) {
-    // In a full implementation, this would:
-    // 1. Access the document catalog
-    // 2. Remove the OutputIntents array
-    // 3. Update any ICC profile references
+pub extern "C" fn pdf_remove_output_intents(_ctx: ContextHandle, doc: DocumentHandle) {
+    let Some(data) = DOCUMENTS.get(doc).map(|d| d.lock().unwrap().data()) else {
+        return;
+    };
+    let Some(mut xref) = open_source(&data, 0) else {
+        return;
+    };
+    xref.read_all_sections();
+    let Some((root, mut catalog)) = catalog(&mut xref) else {
+        return;
+    };
+    if output_intents(&mut xref, &catalog) == 0 {
+        return;
+    }
+    // The intents' profiles stay, unreferenced, for garbage collection
+    set_key(&mut catalog, "OutputIntents", None);
+    let mut edits = Edits::default();
+    edits.objects.insert(root, catalog);
+    let settings = WriteSettings {
+        compress: false,
+        decompress: false,
+        ..WriteSettings::default()
+    };
+    let mut out = Vec::new();
+    if let (Some(Ok(())), Some(d)) = (
+        write_opened(xref, &settings, &edits, &mut out),
+        DOCUMENTS.get(doc),
+    ) {
+        d.lock().unwrap().replace_data(out);
+    }
 }
 
 /// Count output intents in a document.
 #[unsafe(no_mangle)]
-pub extern "C" fn pdf_count_output_intents(_ctx: ContextHandle, _doc: DocumentHandle) -> i32 {
-    // In a full implementation, this would count OutputIntents
-    0
+pub extern "C" fn pdf_count_output_intents(_ctx: ContextHandle, doc: DocumentHandle) -> i32 {
+    let Some(data) = DOCUMENTS.get(doc).map(|d| d.lock().unwrap().data()) else {
+        return 0;
+    };
+    let Some(mut xref) = open_source(&data, 1) else {
+        return 0;
+    };
+    match catalog(&mut xref) {
+        Some((_, catalog)) => output_intents(&mut xref, &catalog),
+        None => 0,
+    }
 }
 
 // ============================================================================
@@ -332,17 +1076,80 @@ pub extern "C" fn pdf_shade_recolor_set_opaque(
 }
 
 /// Recolor a shade object.
+///
+/// Returns a new shade with every colour (gradient stops, mesh vertices,
+/// patch corners and background) converted to the context's destination
+/// colourspace, through its vertex callback if it has one; a shade
+/// callback may pick the destination and callback per shade, or decline
+/// by returning null. Returns 0 if nothing was recolored.
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_recolor_shade(
-    _ctx: ContextHandle,
-    _shade: ShadeHandle,
-    _recolor_ctx: Handle,
+    ctx: ContextHandle,
+    shade: ShadeHandle,
+    recolor_ctx: Handle,
 ) -> ShadeHandle {
-    // In a full implementation, this would:
-    // 1. Get the shade's colorspace and function
-    // 2. Convert colors using the recolor context
-    // 3. Create a new shade with converted colors
-    0
+    let Some(mut shade) = SHADES.get(shade).map(|s| s.lock().unwrap().clone()) else {
+        return 0;
+    };
+    let Some(context) = SHADE_RECOLOR_CONTEXTS.get(recolor_ctx) else {
+        return 0;
+    };
+    let (opaque, src_cs, mut dst_cs, mut vertex_fn, shade_fn) = {
+        let c = context.lock().unwrap();
+        let src_cs = match shade.colorspace {
+            0 => c.src_colorspace,
+            cs => cs,
+        };
+        (c.opaque, src_cs, c.dst_colorspace, c.vertex_fn, c.shade_fn)
+    };
+    if let Some(shade_fn) = shade_fn {
+        let chosen = shade_fn(ctx, opaque, src_cs, &mut dst_cs);
+        if chosen.is_null() {
+            return 0;
+        }
+        // SAFETY: a non-null result points at the callback to use
+        vertex_fn = Some(unsafe { *chosen });
+    }
+    let (src_n, dst_n) = (
+        fz_colorspace_n(ctx, src_cs) as usize,
+        fz_colorspace_n(ctx, dst_cs) as usize,
+    );
+    if !matches!(src_n, 1..=4) || !matches!(dst_n, 1..=4) {
+        return 0;
+    }
+
+    let convert = |colour: &mut [f32; 4]| {
+        *colour = match vertex_fn {
+            Some(f) => {
+                let mut out = [0.0; 4];
+                f(
+                    ctx,
+                    opaque,
+                    dst_cs,
+                    out.as_mut_ptr(),
+                    src_cs,
+                    colour.as_ptr(),
+                );
+                out
+            }
+            None => convert_components(&colour[..src_n], dst_n),
+        };
+    };
+    for stop in &mut shade.color_stops {
+        convert(&mut stop.color);
+        stop.n = dst_n as i32;
+    }
+    for vertex in &mut shade.vertices {
+        convert(&mut vertex.color);
+    }
+    for patch in &mut shade.patches {
+        patch.colors.iter_mut().for_each(convert);
+    }
+    if let Some(background) = shade.background.as_mut() {
+        convert(background);
+    }
+    shade.colorspace = dst_cs;
+    SHADES.insert(shade)
 }
 
 // ============================================================================
@@ -364,65 +1171,21 @@ pub extern "C" fn pdf_convert_color(
         return;
     }
 
-    // Basic conversion - in a full implementation this would use
-    // proper color management
-    unsafe {
-        match (src_n, dst_n) {
-            // Gray to RGB
-            (1, 3) => {
-                let gray = *src;
-                *dst = gray;
-                *dst.add(1) = gray;
-                *dst.add(2) = gray;
-            }
-            // RGB to Gray
-            (3, 1) => {
-                let r = *src;
-                let g = *src.add(1);
-                let b = *src.add(2);
-                // Standard luminance formula
-                *dst = 0.299 * r + 0.587 * g + 0.114 * b;
-            }
-            // CMYK to RGB
-            (4, 3) => {
-                let c = *src;
-                let m = *src.add(1);
-                let y = *src.add(2);
-                let k = *src.add(3);
-                *dst = (1.0 - c) * (1.0 - k);
-                *dst.add(1) = (1.0 - m) * (1.0 - k);
-                *dst.add(2) = (1.0 - y) * (1.0 - k);
-            }
-            // RGB to CMYK
-            (3, 4) => {
-                let r = *src;
-                let g = *src.add(1);
-                let b = *src.add(2);
-                let k = 1.0 - r.max(g).max(b);
-                if k < 1.0 {
-                    *dst = (1.0 - r - k) / (1.0 - k);
-                    *dst.add(1) = (1.0 - g - k) / (1.0 - k);
-                    *dst.add(2) = (1.0 - b - k) / (1.0 - k);
-                } else {
-                    *dst = 0.0;
-                    *dst.add(1) = 0.0;
-                    *dst.add(2) = 0.0;
-                }
-                *dst.add(3) = k;
-            }
-            // Same number of components - direct copy
-            _ if src_n == dst_n => {
-                for i in 0..src_n as usize {
-                    *dst.add(i) = *src.add(i);
-                }
-            }
-            // Unsupported conversion
-            _ => {
-                for i in 0..dst_n as usize {
-                    *dst.add(i) = 0.0;
-                }
-            }
-        }
+    let (src_n, dst_n) = (src_n.max(0) as usize, dst_n.max(0) as usize);
+    // SAFETY: the caller passes `src_n` and `dst_n` floats at `src` and `dst`
+    let (src, dst) = unsafe {
+        (
+            std::slice::from_raw_parts(src, src_n),
+            std::slice::from_raw_parts_mut(dst, dst_n),
+        )
+    };
+    if src_n == dst_n {
+        dst.copy_from_slice(src);
+    } else if matches!(src_n, 1 | 3 | 4) && matches!(dst_n, 1 | 3 | 4) {
+        dst.copy_from_slice(&convert_components(src, dst_n)[..dst_n]);
+    } else {
+        // Unsupported conversion
+        dst.fill(0.0);
     }
 }
 
@@ -512,7 +1275,120 @@ pub extern "C" fn pdf_rgb_to_cmyk(
 
 #[cfg(test)]
 mod tests {
+    use super::super::pdf_image_rewriter::tests::{pdf_with, stream};
+    use super::super::shade::{ColorStop, Shade};
     use super::*;
+    use crate::ffi::document::Document;
+
+    #[test]
+    fn test_recolor_content_converts_device_colours() {
+        let spaces = HashMap::from([("CS0".to_string(), 3)]);
+        let content = b"q 1 0 0 rg /CS0 cs 0 1 0 sc Q 0.5 g (rg) Tj /Pattern cs /P0 scn \
+                        BI /CS /RGB ID \x01 rg EI 0 0 1 RG";
+        let (out, converted) = recolor_content(content, &spaces, Some(1), 1);
+        assert_eq!(
+            out,
+            b"q 0.299 g /DeviceGray cs 0.587 sc Q 0.5 g (rg) Tj /Pattern cs /P0 scn \
+              BI /CS /RGB ID \x01 rg EI 0.114 G"
+        );
+        assert_eq!(converted, 3);
+
+        // A form's fill space is its caller's until it sets one
+        let (out, converted) = recolor_content(b"1 sc 0 g", &spaces, None, 4);
+        assert_eq!((&out[..], converted), (&b"1 sc 0 0 0 1 k"[..], 1));
+    }
+
+    /// Two pages sharing a content stream, an RGB image (one through a
+    /// form) and an axial shading, with one output intent
+    fn colour_pdf() -> Vec<u8> {
+        pdf_with(&[
+            b"<< /Type /Catalog /Pages 2 0 R /OutputIntents [<< /S /GTS_PDFX >>] >>".to_vec(),
+            b"<< /Type /Pages /Kids [3 0 R 4 0 R] /Count 2 >>".to_vec(),
+            b"<< /Type /Page /Parent 2 0 R /Contents 5 0 R \
+               /Resources << /XObject << /Im0 6 0 R >> /Shading << /Sh0 7 0 R >> >> >>"
+                .to_vec(),
+            b"<< /Type /Page /Parent 2 0 R /Contents 5 0 R \
+               /Resources << /XObject << /Fm0 8 0 R >> >> >>"
+                .to_vec(),
+            stream("", b"1 0 0 rg 0 0 10 10 re f"),
+            stream(
+                "/Type /XObject /Subtype /Image /Width 2 /Height 1 /ColorSpace /DeviceRGB \
+                 /BitsPerComponent 8",
+                &[255, 0, 0, 0, 0, 255],
+            ),
+            b"<< /ShadingType 2 /ColorSpace /DeviceRGB /Coords [0 0 1 0] \
+               /Function 9 0 R >>"
+                .to_vec(),
+            stream(
+                "/Type /XObject /Subtype /Form /Resources << /XObject << /Im0 6 0 R >> >>",
+                b"/Im0 Do",
+            ),
+            b"<< /FunctionType 2 /Domain [0 1] /C0 [1 0 0] /C1 [0 0 1] /N 1 >>".to_vec(),
+        ])
+    }
+
+    #[test]
+    fn test_recolor_document_converts_shared_resources_once() {
+        let doc = DOCUMENTS.insert(Document::new(colour_pdf()));
+        let stats = recolor_pages(doc, 0, i32::MAX, 1, 4);
+        assert_eq!(
+            (
+                stats.pages_processed,
+                stats.colors_converted,
+                stats.images_processed,
+                stats.shades_recolored
+            ),
+            (2, 1, 1, 1)
+        );
+
+        let data = DOCUMENTS.get(doc).unwrap().lock().unwrap().data();
+        let mut xref = Xref::open_lazy(0, data).unwrap();
+        let content = xref.fetch(5).unwrap();
+        let plain = decode_stream(&content.value, content.stream.as_ref().unwrap()).unwrap();
+        assert_eq!(plain, b"0.299 g 0 0 10 10 re f");
+        let image = xref.fetch(6).unwrap();
+        assert!(is_name(dict_get(&image.value, "ColorSpace"), "DeviceGray"));
+        let pixels = decode_stream(&image.value, image.stream.as_ref().unwrap()).unwrap();
+        assert_eq!(pixels, [76, 28]);
+        let shading = xref.fetch(7).unwrap().value;
+        assert!(is_name(dict_get(&shading, "ColorSpace"), "DeviceGray"));
+        let function = dict_get(&shading, "Function").unwrap();
+        assert_eq!(numbers(dict_get(function, "C0")), Some(vec![0.299]));
+
+        // Nothing is left to convert
+        let again = pdf_recolor_document(0, doc, &RecolorOptions::gray());
+        assert_eq!(again.colors_converted + again.images_processed, 0);
+
+        assert_eq!(pdf_count_output_intents(0, doc), 1);
+        pdf_remove_output_intents(0, doc);
+        assert_eq!(pdf_count_output_intents(0, doc), 0);
+        DOCUMENTS.remove(doc);
+    }
+
+    #[test]
+    fn test_recolor_shade_converts_every_colour() {
+        let shade = SHADES.insert(Shade {
+            colorspace: FZ_COLORSPACE_RGB,
+            background: Some([1.0, 1.0, 1.0, 0.0]),
+            color_stops: vec![ColorStop {
+                offset: 0.0,
+                color: [0.0, 0.0, 0.0, 0.0],
+                n: 3,
+            }],
+            ..Shade::default()
+        });
+        let context = pdf_new_shade_recolor_context(0, FZ_COLORSPACE_RGB, FZ_COLORSPACE_CMYK);
+        let recolored = pdf_recolor_shade(0, shade, context);
+        let result = SHADES.get(recolored).unwrap().lock().unwrap().clone();
+        assert_eq!(result.colorspace, FZ_COLORSPACE_CMYK);
+        assert_eq!(result.color_stops[0].color, [0.0, 0.0, 0.0, 1.0]);
+        assert_eq!(result.color_stops[0].n, 4);
+        assert_eq!(result.background, Some([0.0; 4]));
+        for handle in [shade, recolored] {
+            SHADES.remove(handle);
+        }
+        pdf_drop_shade_recolor_context(0, context);
+    }
 
     #[test]
     fn test_recolor_constants() {
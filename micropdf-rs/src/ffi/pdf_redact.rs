@@ -3,7 +3,13 @@
 //! Provides PDF redaction functionality including redaction annotations,
 //! content removal, image handling, and metadata sanitization.
 
+use crate::ffi::pdf_page::PDF_PAGES;
+use crate::ffi::pdf_redact_engine::{Region, Regions, redact_document};
+use crate::ffi::pdf_redact_search::PatternSet;
 use crate::ffi::{Handle, HandleStore};
+use crate::fitz::geometry::Rect;
+use std::collections::HashMap;
+use std::ffi::{CStr, c_char};
 use std::sync::LazyLock;
 
 // ============================================================================
@@ -207,16 +213,38 @@ impl RedactContext {
     }
 
     /// Apply all redactions
+    ///
+    /// The regions not yet applied are redacted from the page's content
+    /// if the page is open; either way they count as applied.
     pub fn apply(&mut self) -> i32 {
-        let mut count = 0;
+        let mut regions = Vec::new();
         for region in &mut self.regions {
             if !region.applied {
-                // In a full implementation, this would modify the page content
+                let [x0, y0, x1, y1] = region.rect;
+                regions.push(Region {
+                    rect: Rect::new(x0, y0, x1, y1),
+                    color: region.color,
+                });
                 region.applied = true;
-                count += 1;
-                self.stats.regions_applied += 1;
             }
         }
+        let count = regions.len() as i32;
+        let page = PDF_PAGES.get(self.page).map(|p| p.lock().unwrap().number);
+        if let Some(number) = page.filter(|_| count > 0) {
+            let given = HashMap::from([(number, regions)]);
+            let found = redact_document(
+                self.document,
+                Some(&[number]),
+                Regions::Given(&given),
+                &self.options,
+                0,
+            );
+            self.stats.text_removed += found.text_removed;
+            self.stats.images_removed += found.images_removed;
+            self.stats.images_modified += found.images_modified;
+            self.stats.line_art_removed += found.line_art_removed;
+        }
+        self.stats.regions_applied += count;
         count
     }
 }
@@ -378,16 +406,30 @@ pub extern "C" fn pdf_apply_redactions(_ctx: ContextHandle, redact_ctx: Handle)
     0
 }
 
+/// Options `opts` points to, or the defaults if it is null
+fn options_or_default(opts: *const RedactOptions) -> RedactOptions {
+    if opts.is_null() {
+        return RedactOptions::new();
+    }
+    // SAFETY: Caller guarantees a non-null opts points to valid options
+    unsafe { *opts }
+}
+
 /// Redact a page with options (applies all redaction annotations).
+///
+/// Returns the number of regions redacted.
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_redact_page_annotations(
     _ctx: ContextHandle,
-    _doc: DocumentHandle,
-    _page: PageHandle,
-    _opts: *const RedactOptions,
+    doc: DocumentHandle,
+    page: PageHandle,
+    opts: *const RedactOptions,
 ) -> i32 {
-    // In a full implementation, this would redact all redaction annotations on the page
-    0
+    let Some(number) = PDF_PAGES.get(page).map(|p| p.lock().unwrap().number) else {
+        return 0;
+    };
+    let opts = options_or_default(opts);
+    redact_document(doc, Some(&[number]), Regions::Annotations, &opts, 0).regions_applied
 }
 
 /// Apply a single redaction annotation.
@@ -528,25 +570,62 @@ pub extern "C" fn pdf_add_redact_annot_quad(
 // ============================================================================
 
 /// Redact all pages in document.
+///
+/// Every page's Redact annotations are applied, the pages redacted in
+/// parallel. Returns the number of regions redacted.
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_redact_document(
     _ctx: ContextHandle,
-    _doc: DocumentHandle,
-    _opts: *const RedactOptions,
+    doc: DocumentHandle,
+    opts: *const RedactOptions,
 ) -> i32 {
-    // In a full implementation, this would redact all pages
-    0
+    let opts = options_or_default(opts);
+    redact_document(doc, None, Regions::Annotations, &opts, 0).regions_applied
 }
 
 /// Apply all redaction annotations in document.
+///
+/// Returns the number of regions redacted.
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_apply_all_redactions(
     _ctx: ContextHandle,
-    _doc: DocumentHandle,
-    _opts: *const RedactOptions,
+    doc: DocumentHandle,
+    opts: *const RedactOptions,
 ) -> i32 {
-    // In a full implementation, this would apply all redaction annotations
-    0
+    pdf_redact_document(0, doc, opts)
+}
+
+/// Redact every match of `count` UTF-8 patterns in document text.
+///
+/// The patterns are compiled once, and every page is searched for all of
+/// them and redacted in one parallel pass. Matching ignores case and never
+/// crosses lines. Returns the number of regions redacted, one per match
+/// per line, or -1 on invalid arguments.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_redact_text_matches(
+    _ctx: ContextHandle,
+    doc: DocumentHandle,
+    patterns: *const *const c_char,
+    count: i32,
+    opts: *const RedactOptions,
+) -> i32 {
+    if patterns.is_null() || count < 0 {
+        return -1;
+    }
+    // SAFETY: the caller passes `count` pattern pointers
+    let patterns = unsafe { std::slice::from_raw_parts(patterns, count as usize) };
+    let patterns: Vec<&str> = patterns
+        .iter()
+        .filter(|p| !p.is_null())
+        // SAFETY: non-null patterns are NUL-terminated strings
+        .filter_map(|&p| unsafe { CStr::from_ptr(p) }.to_str().ok())
+        .collect();
+    let patterns = PatternSet::new(&patterns);
+    if patterns.is_empty() {
+        return 0;
+    }
+    let opts = options_or_default(opts);
+    redact_document(doc, None, Regions::Matches(&patterns), &opts, 0).regions_applied
 }
 
 // ============================================================================
@@ -0,0 +1,1272 @@
+//! Redaction Engine
+//!
+//! Redaction removes what falls under a page's regions from its content.
+//! Pages are read serially first. This gathers each page's regions, from
+//! its Redact annotations (their QuadPoints, or else their Rect) or from
+//! the caller, and its content streams, fonts and images. Each page is
+//! then redacted on a pool of threads, after matching its text against a
+//! pattern set for its regions if they come from one (see
+//! `pdf_redact_search`). Its content is lexed once and
+//! measured as it goes: every shown glyph gets a box from its font's
+//! widths, ascent and descent under the text and graphics state, and every
+//! path and image placement gets its bounds. The regions go into a grid,
+//! so each box is tested only against the regions near it.
+//!
+//! Glyphs under a region are cut from their strings, and a kerning gap the
+//! width of each cut glyph keeps the rest in place. Paths and image
+//! placements are removed, or the image pixels under regions are painted
+//! black, as the options say. Images are decoded and re-encoded on the
+//! same pool. Black boxes go over each region last, and the Redact
+//! annotations that were applied are removed with their popups.
+//!
+//! Forms and annotation appearances are not descended into. A content
+//! stream shared by several pages is redacted for the first page only.
+
+use super::pdf_image_rewriter::{components, inherited, resolve};
+use super::pdf_parse::ParsedValue;
+use super::pdf_redact::{
+    PDF_REDACT_IMAGE_NONE, PDF_REDACT_IMAGE_PIXELS, PDF_REDACT_LINE_ART_NONE,
+    PDF_REDACT_LINE_ART_REMOVE_IF_COVERED, PDF_REDACT_TEXT_NONE, PDF_REDACT_TEXT_REMOVE_INVISIBLE,
+    RedactOptions, RedactStats,
+};
+use super::pdf_redact_search::{PatternSet, match_regions, to_unicode};
+use super::pdf_stream_prefetch::parallel_map;
+use super::pdf_vectorize::{
+    Op, cid_widths, number, operand, operators, simple_widths, string, write_number,
+};
+use super::pdf_write::{Edits, WriteSettings, open_source, set_key, write_opened};
+use super::pdf_xref::Xref;
+use super::pdf_xref_lazy::{as_int, as_ref, decode_stream, dict_get, is_name};
+use crate::ffi::display_list::fz_purge_display_list_cache;
+use crate::ffi::pdf_interpret::pdf_purge_content_program_cache;
+use crate::ffi::{DOCUMENTS, Handle};
+use crate::fitz::geometry::{Matrix, Point, Rect};
+use crate::pdf::filter::{decode_dct, encode_flate};
+use bytes::Bytes;
+use std::collections::{HashMap, HashSet};
+use std::sync::Arc;
+
+/// Most grid cells along each side of a region index
+const MAX_GRID: usize = 16;
+
+/// A region to redact, in default user space, with the colour of its box
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub(crate) struct Region {
+    pub(crate) rect: Rect,
+    pub(crate) color: [f32; 3],
+}
+
+/// A page's regions, bucketed into a grid over their bounds so a box is
+/// only tested against the regions in the cells it overlaps
+struct RegionIndex {
+    rects: Vec<Rect>,
+    bounds: Rect,
+    cols: usize,
+    rows: usize,
+    cells: Vec<Vec<usize>>,
+}
+
+impl RegionIndex {
+    fn new(regions: &[Region]) -> Self {
+        let rects: Vec<Rect> = regions.iter().map(|r| r.rect).collect();
+        let bounds = rects.iter().fold(Rect::EMPTY, |b, r| b.union(r));
+        let side = (rects.len() as f64).sqrt().ceil() as usize;
+        let (cols, rows) = (side.clamp(1, MAX_GRID), side.clamp(1, MAX_GRID));
+        let mut index = Self {
+            rects,
+            bounds,
+            cols,
+            rows,
+            cells: vec![Vec::new(); cols * rows],
+        };
+        for (i, rect) in index.rects.iter().enumerate() {
+            let (c0, c1, r0, r1) = index.span(rect);
+            for row in r0..=r1 {
+                for col in c0..=c1 {
+                    index.cells[row * cols + col].push(i);
+                }
+            }
+        }
+        index
+    }
+
+    /// The cells `rect` overlaps, as column and row ranges
+    fn span(&self, rect: &Rect) -> (usize, usize, usize, usize) {
+        let cell = |v: f32, lo: f32, hi: f32, n: usize| {
+            let t = if hi > lo { (v - lo) / (hi - lo) } else { 0.0 };
+            ((t * n as f32) as usize).min(n - 1)
+        };
+        let b = &self.bounds;
+        (
+            cell(rect.x0.max(b.x0), b.x0, b.x1, self.cols),
+            cell(rect.x1.min(b.x1), b.x0, b.x1, self.cols),
+            cell(rect.y0.max(b.y0), b.y0, b.y1, self.rows),
+            cell(rect.y1.min(b.y1), b.y0, b.y1, self.rows),
+        )
+    }
+
+    /// The regions `rect` may overlap
+    fn near(&self, rect: &Rect) -> Vec<&Rect> {
+        if self.rects.is_empty()
+            || rect.x0 > self.bounds.x1
+            || rect.x1 < self.bounds.x0
+            || rect.y0 > self.bounds.y1
+            || rect.y1 < self.bounds.y0
+        {
+            return Vec::new();
+        }
+        let (c0, c1, r0, r1) = self.span(rect);
+        let mut found: Vec<usize> = (r0..=r1)
+            .flat_map(|row| (c0..=c1).map(move |col| row * self.cols + col))
+            .flat_map(|cell| self.cells[cell].iter().copied())
+            .collect();
+        found.sort_unstable();
+        found.dedup();
+        found.into_iter().map(|i| &self.rects[i]).collect()
+    }
+
+    /// Whether a region overlaps `rect` with some area
+    fn overlaps(&self, rect: &Rect) -> bool {
+        self.near(rect).iter().any(|r| r.intersects(rect))
+    }
+
+    /// Whether a region touches `rect`, even only along an edge
+    fn touches(&self, rect: &Rect) -> bool {
+        self.near(rect)
+            .iter()
+            .any(|r| r.x0 <= rect.x1 && r.x1 >= rect.x0 && r.y0 <= rect.y1 && r.y1 >= rect.y0)
+    }
+
+    /// Whether one region holds all of `rect`
+    fn covers(&self, rect: &Rect) -> bool {
+        self.near(rect)
+            .iter()
+            .any(|r| r.x0 <= rect.x0 && r.x1 >= rect.x1 && r.y0 <= rect.y0 && r.y1 >= rect.y1)
+    }
+}
+
+/// What a font's strings measure, and the text they stand for
+pub(crate) struct FontMetrics {
+    /// Codes are two bytes, not one
+    two_byte: bool,
+    /// Advances by code, in text space units per unit of font size
+    widths: HashMap<u32, f32>,
+    default_width: f32,
+    ascent: f32,
+    descent: f32,
+    /// Text by code, from the font's ToUnicode map
+    unicode: HashMap<u32, Vec<u32>>,
+}
+
+impl FontMetrics {
+    fn advance(&self, code: u32) -> f32 {
+        self.widths
+            .get(&code)
+            .copied()
+            .unwrap_or(self.default_width)
+    }
+
+    /// Append the text `code` stands for: its ToUnicode mapping, or for
+    /// simple fonts without one the code itself, taken as Latin-1
+    pub(crate) fn text(&self, code: u32, out: &mut Vec<u32>) {
+        match self.unicode.get(&code) {
+            Some(text) => out.extend_from_slice(text),
+            None if !self.two_byte => out.push(code),
+            None => {}
+        }
+    }
+}
+
+/// The metrics of `font`
+///
+/// Type0 fonts are taken to use two-byte codes, and simple fonts without
+/// Widths, like the standard 14, half an em a glyph.
+fn font_metrics(xref: &mut Xref, font: &ParsedValue) -> FontMetrics {
+    let descendant = if is_name(dict_get(font, "Subtype"), "Type0") {
+        match dict_get(font, "DescendantFonts").and_then(|d| resolve(xref, d)) {
+            Some(ParsedValue::Array(items)) => items.first().and_then(|d| resolve(xref, d)),
+            _ => None,
+        }
+    } else {
+        None
+    };
+    let program = descendant.as_ref().unwrap_or(font);
+    let descriptor = dict_get(program, "FontDescriptor").and_then(|d| resolve(xref, d));
+    let metric = |key, default: f32| {
+        descriptor
+            .as_ref()
+            .and_then(|d| dict_get(d, key))
+            .and_then(number)
+            .filter(|&v| v != 0.0)
+            .map_or(default, |v| v / 1000.0)
+    };
+    let (ascent, descent) = (metric("Ascent", 0.8), metric("Descent", -0.2));
+    let unicode = dict_get(font, "ToUnicode")
+        .and_then(as_ref)
+        .and_then(|num| xref.fetch(num))
+        .and_then(|f| decode_stream(&f.value, f.stream.as_ref()?))
+        .map(|cmap| to_unicode(&cmap))
+        .unwrap_or_default();
+
+    match &descendant {
+        Some(cid) => FontMetrics {
+            two_byte: true,
+            widths: cid_widths(xref, dict_get(cid, "W")),
+            default_width: dict_get(cid, "DW").and_then(number).unwrap_or(1000.0) / 1000.0,
+            ascent,
+            descent,
+            unicode,
+        },
+        None => {
+            let scale = match dict_get(font, "FontMatrix").and_then(|m| resolve(xref, m)) {
+                Some(ParsedValue::Array(m)) if is_name(dict_get(font, "Subtype"), "Type3") => {
+                    m.first().and_then(number).unwrap_or(0.001)
+                }
+                _ => 0.001,
+            };
+            let default_width = match dict_get(font, "Widths") {
+                Some(_) => metric("MissingWidth", 0.0),
+                None => 0.5,
+            };
+            FontMetrics {
+                two_byte: false,
+                widths: simple_widths(xref, font, scale),
+                default_width,
+                ascent,
+                descent,
+                unicode,
+            }
+        }
+    }
+}
+
+/// An image XObject a page shows
+struct ImageSource {
+    dict: ParsedValue,
+    /// Encoded data, read only if image pixels may be painted over
+    raw: Option<Bytes>,
+    components: Option<usize>,
+}
+
+/// What one page needs to be redacted, read from the source
+struct PageJob {
+    page: i32,
+    streams: Vec<(i32, ParsedValue, Bytes)>,
+    fonts: HashMap<String, Arc<FontMetrics>>,
+    images: HashMap<String, Arc<ImageSource>>,
+    /// Every XObject name the page's resources hold
+    names: HashSet<String>,
+    regions: Vec<Region>,
+}
+
+/// A redacted page: its content, the images it now shows by new resource
+/// names, and what was removed
+struct Redacted {
+    content: Vec<u8>,
+    images: Vec<(String, ParsedValue, Bytes)>,
+    stats: RedactStats,
+}
+
+/// The graphics and text state content operators set
+#[derive(Clone)]
+pub(crate) struct State {
+    pub(crate) ctm: Matrix,
+    pub(crate) font: Option<Arc<FontMetrics>>,
+    pub(crate) size: f32,
+    char_space: f32,
+    word_space: f32,
+    scale: f32,
+    leading: f32,
+    rise: f32,
+    render: i32,
+}
+
+impl Default for State {
+    fn default() -> Self {
+        Self {
+            ctm: Matrix::IDENTITY,
+            font: None,
+            size: 0.0,
+            char_space: 0.0,
+            word_space: 0.0,
+            scale: 1.0,
+            leading: 0.0,
+            rise: 0.0,
+            render: 0,
+        }
+    }
+}
+
+/// One glyph of a shown string: its code and code bytes, its box in
+/// user space, its advance in unscaled text space, and whether it is cut
+pub(crate) struct Glyph {
+    bytes: (usize, usize),
+    pub(crate) code: u32,
+    pub(crate) bbox: Rect,
+    advance: f32,
+    cut: bool,
+}
+
+impl State {
+    /// The glyphs of string `bytes` shown at `tm`, moving `tm` past them
+    pub(crate) fn glyphs(&self, bytes: &[u8], tm: &mut Matrix) -> Vec<Glyph> {
+        let Some(font) = &self.font else {
+            // Nothing can be measured, so it may be anywhere
+            return vec![Glyph {
+                bytes: (0, bytes.len()),
+                code: 0,
+                bbox: Rect::INFINITE,
+                advance: 0.0,
+                cut: false,
+            }];
+        };
+        let width = if font.two_byte { 2 } else { 1 };
+        let mut glyphs = Vec::with_capacity(bytes.len() / width);
+        for start in (0..bytes.len() - bytes.len() % width).step_by(width) {
+            let code = bytes[start..start + width]
+                .iter()
+                .fold(0, |code, &b| code << 8 | u32::from(b));
+            let w0 = font.advance(code);
+            let mut advance = w0 * self.size + self.char_space;
+            if !font.two_byte && code == 32 {
+                advance += self.word_space;
+            }
+            let extent = Rect::new(
+                0.0,
+                font.descent * self.size + self.rise,
+                w0 * self.size * self.scale,
+                font.ascent * self.size + self.rise,
+            );
+            let trm = tm.concat(&self.ctm);
+            let bbox = Rect::new(
+                extent.x0.min(extent.x1),
+                extent.y0,
+                extent.x0.max(extent.x1),
+                extent.y1,
+            )
+            .transform(&trm);
+            glyphs.push(Glyph {
+                bytes: (start, start + width),
+                code,
+                bbox,
+                advance,
+                cut: false,
+            });
+            *tm = Matrix::translate(advance * self.scale, 0.0).concat(tm);
+        }
+        glyphs
+    }
+}
+
+/// The strings a text showing operator shows, with a TJ's adjustments
+/// and brackets among them
+pub(crate) fn shown<'o>(op: &'o Op) -> &'o [(usize, usize)] {
+    match op.name {
+        b"TJ" => &op.operands,
+        _ => op.operands.last().map(std::slice::from_ref).unwrap_or(&[]),
+    }
+}
+
+/// The font or XObject resource name operand `op` starts with
+fn resource_name<'d>(data: &'d [u8], op: &Op) -> Option<&'d str> {
+    let &(s, e) = op.operands.first()?;
+    let token = data.get(s + 1..e).filter(|_| data[s] == b'/')?;
+    std::str::from_utf8(token).ok()
+}
+
+/// The text and graphics state through a content stream, as far as
+/// placing glyphs needs it
+pub(crate) struct TextWalk {
+    pub(crate) state: State,
+    saved: Vec<State>,
+    pub(crate) tm: Matrix,
+    tlm: Matrix,
+}
+
+impl TextWalk {
+    pub(crate) fn new() -> Self {
+        Self {
+            state: State::default(),
+            saved: Vec::new(),
+            tm: Matrix::IDENTITY,
+            tlm: Matrix::IDENTITY,
+        }
+    }
+
+    /// Apply what operator `op` does to the state, with fonts by resource
+    /// name in `fonts`; false if it does something more
+    ///
+    /// `'` and `"` move to the next line, and `"` sets the spacing, before
+    /// they show their string.
+    pub(crate) fn step(
+        &mut self,
+        data: &[u8],
+        op: &Op,
+        fonts: &HashMap<String, Arc<FontMetrics>>,
+    ) -> bool {
+        let num = |i| operand(data, op, i).unwrap_or(0.0);
+        let state = &mut self.state;
+        match op.name {
+            b"q" => self.saved.push(state.clone()),
+            b"Q" => {
+                if let Some(outer) = self.saved.pop() {
+                    *state = outer;
+                }
+            }
+            b"cm" => {
+                let m = Matrix::new(num(0), num(1), num(2), num(3), num(4), num(5));
+                state.ctm = m.concat(&state.ctm);
+            }
+            b"BT" => {
+                self.tm = Matrix::IDENTITY;
+                self.tlm = Matrix::IDENTITY;
+            }
+            b"Tc" => state.char_space = num(0),
+            b"Tw" => state.word_space = num(0),
+            b"Tz" => state.scale = num(0) / 100.0,
+            b"TL" => state.leading = num(0),
+            b"Ts" => state.rise = num(0),
+            b"Tr" => state.render = num(0) as i32,
+            b"Tf" => {
+                state.font = resource_name(data, op).and_then(|n| fonts.get(n).cloned());
+                state.size = num(1);
+            }
+            b"Td" | b"TD" => {
+                if op.name == b"TD" {
+                    state.leading = -num(1);
+                }
+                self.tlm = Matrix::translate(num(0), num(1)).concat(&self.tlm);
+                self.tm = self.tlm;
+            }
+            b"Tm" => {
+                self.tlm = Matrix::new(num(0), num(1), num(2), num(3), num(4), num(5));
+                self.tm = self.tlm;
+            }
+            b"T*" | b"'" | b"\"" => {
+                if op.name == b"\"" {
+                    state.word_space = num(0);
+                    state.char_space = num(1);
+                }
+                self.tlm = Matrix::translate(0.0, -state.leading).concat(&self.tlm);
+                self.tm = self.tlm;
+                return op.name == b"T*";
+            }
+            _ => return false,
+        }
+        true
+    }
+
+    /// Move past TJ adjustment `adjust`, in thousandths of an em
+    pub(crate) fn kern(&mut self, adjust: f32) {
+        let state = &self.state;
+        self.tm =
+            Matrix::translate(-adjust / 1000.0 * state.size * state.scale, 0.0).concat(&self.tm);
+    }
+}
+
+/// TJ adjustment at `span`, if it is one
+pub(crate) fn adjustment(data: &[u8], (s, e): (usize, usize)) -> Option<f32> {
+    std::str::from_utf8(&data[s..e]).ok()?.parse().ok()
+}
+
+/// Append TJ array items showing string `bytes` without its cut glyphs,
+/// each replaced by a gap as wide
+fn write_kept(bytes: &[u8], glyphs: &[Glyph], size: f32, out: &mut Vec<u8>) {
+    let mut gap = 0.0;
+    let mut run = Vec::new();
+    let flush_run = |run: &mut Vec<u8>, out: &mut Vec<u8>| {
+        if !run.is_empty() {
+            out.push(b'<');
+            for b in run.iter() {
+                out.extend_from_slice(format!("{b:02x}").as_bytes());
+            }
+            out.extend_from_slice(b"> ");
+            run.clear();
+        }
+    };
+    for glyph in glyphs {
+        if glyph.cut {
+            flush_run(&mut run, out);
+            if size != 0.0 {
+                gap -= glyph.advance * 1000.0 / size;
+            }
+        } else {
+            if gap != 0.0 {
+                write_number(gap, out);
+                gap = 0.0;
+            }
+            run.extend_from_slice(&bytes[glyph.bytes.0..glyph.bytes.1]);
+        }
+    }
+    flush_run(&mut run, out);
+    if gap != 0.0 {
+        write_number(gap, out);
+    }
+}
+
+/// The points of path construction operator `op`, in user space
+fn path_points(data: &[u8], op: &Op, ctm: &Matrix) -> Vec<Point> {
+    let n = |i| operand(data, op, i).unwrap_or(0.0);
+    let points = match op.name {
+        b"re" => {
+            let (x, y, w, h) = (n(0), n(1), n(2), n(3));
+            vec![(x, y), (x + w, y), (x, y + h), (x + w, y + h)]
+        }
+        _ => (0..op.operands.len() / 2)
+            .map(|k| (n(2 * k), n(2 * k + 1)))
+            .collect(),
+    };
+    points
+        .into_iter()
+        .map(|(x, y)| ctm.transform_point(Point::new(x, y)))
+        .collect()
+}
+
+fn invert(m: &Matrix) -> Option<Matrix> {
+    let det = m.a * m.d - m.b * m.c;
+    if det.abs() < 1e-9 {
+        return None;
+    }
+    Some(Matrix::new(
+        m.d / det,
+        -m.b / det,
+        -m.c / det,
+        m.a / det,
+        (m.c * m.f - m.d * m.e) / det,
+        (m.b * m.e - m.a * m.f) / det,
+    ))
+}
+
+/// `image`, shown through `ctm`, with the pixels under regions painted
+/// black; `None` if it isn't an 8-bit image of plain components it can
+/// decode
+fn black_out(
+    image: &ImageSource,
+    ctm: &Matrix,
+    index: &RegionIndex,
+) -> Option<(ParsedValue, Bytes)> {
+    let dict = &image.dict;
+    let int = |key| dict_get(dict, key).and_then(as_int).unwrap_or(0);
+    let (width, height, n) = (
+        int("Width") as usize,
+        int("Height") as usize,
+        image.components?,
+    );
+    if int("BitsPerComponent") != 8
+        || width == 0
+        || height == 0
+        || dict_get(dict, "Decode").is_some()
+        || matches!(dict_get(dict, "ImageMask"), Some(ParsedValue::Bool(true)))
+    {
+        return None;
+    }
+    let raw = image.raw.as_ref()?;
+    let jpeg = match dict_get(dict, "Filter") {
+        Some(ParsedValue::Array(f)) => f.len() == 1 && is_name(f.first(), "DCTDecode"),
+        filter => is_name(filter, "DCTDecode"),
+    };
+    let mut pixels = match jpeg {
+        true => decode_dct(raw, None).ok()?,
+        false => decode_stream(dict, raw)?,
+    };
+    if pixels.len() != width * height * n {
+        return None;
+    }
+
+    // Image space is the unit square, with the first row at the top
+    let to_image = invert(ctm)?;
+    let black: &[u8] = if n == 4 { &[0, 0, 0, 255] } else { &[0, 0, 0] };
+    let placed = Rect::UNIT.transform(ctm);
+    for region in index.near(&placed) {
+        let r = region.transform(&to_image);
+        let x0 = (r.x0.clamp(0.0, 1.0) * width as f32).floor() as usize;
+        let x1 = (r.x1.clamp(0.0, 1.0) * width as f32).ceil() as usize;
+        let y0 = ((1.0 - r.y1.clamp(0.0, 1.0)) * height as f32).floor() as usize;
+        let y1 = ((1.0 - r.y0.clamp(0.0, 1.0)) * height as f32).ceil() as usize;
+        for row in y0..y1.min(height) {
+            for col in x0..x1.min(width) {
+                let at = (row * width + col) * n;
+                pixels[at..at + n].copy_from_slice(&black[..n]);
+            }
+        }
+    }
+
+    let data = encode_flate(&pixels, 6).ok()?;
+    let mut dict = dict.clone();
+    for key in ["DecodeParms", "DL"] {
+        set_key(&mut dict, key, None);
+    }
+    set_key(
+        &mut dict,
+        "Filter",
+        Some(ParsedValue::Name("FlateDecode".into())),
+    );
+    set_key(
+        &mut dict,
+        "Length",
+        Some(ParsedValue::Int(data.len() as i64)),
+    );
+    Some((dict, Bytes::from(data)))
+}
+
+/// Content stream `data` of `job` with what falls under `regions`,
+/// indexed in `index`, removed
+fn redact_content(
+    data: &[u8],
+    job: &PageJob,
+    regions: &[Region],
+    index: &RegionIndex,
+    opts: &RedactOptions,
+) -> Redacted {
+    let ops = operators(data);
+    let mut stats = RedactStats::default();
+    let mut images = Vec::new();
+    // Spans of `data` replaced, in order
+    let mut splices: Vec<(usize, usize, Vec<u8>)> = Vec::new();
+    let mut walk = TextWalk::new();
+    let mut path_start = None;
+    let mut path_box = Rect::EMPTY;
+    let mut clip = false;
+    let mut inline_start = 0;
+
+    for op in &ops {
+        if walk.step(data, op, &job.fonts) {
+            continue;
+        }
+        let state = &walk.state;
+        match op.name {
+            b"m" | b"l" | b"c" | b"v" | b"y" | b"re" | b"h" => {
+                path_start.get_or_insert(op.start);
+                for p in path_points(data, op, &state.ctm) {
+                    path_box.include_point(p);
+                }
+            }
+            b"W" | b"W*" => clip = true,
+            b"S" | b"s" | b"f" | b"F" | b"f*" | b"B" | b"B*" | b"b" | b"b*" | b"n" => {
+                let hit = match opts.line_art {
+                    PDF_REDACT_LINE_ART_NONE => false,
+                    PDF_REDACT_LINE_ART_REMOVE_IF_COVERED => index.covers(&path_box),
+                    _ => index.touches(&path_box),
+                };
+                if let Some(start) = path_start.filter(|_| hit && op.name != b"n") {
+                    // A clip stays; only its painting goes
+                    match clip {
+                        true => splices.push((op.start, op.end, b"n".to_vec())),
+                        false => splices.push((start, op.end, Vec::new())),
+                    }
+                    stats.line_art_removed += 1;
+                }
+                path_start = None;
+                path_box = Rect::EMPTY;
+                clip = false;
+            }
+            b"Tj" | b"'" | b"\"" | b"TJ" => {
+                let mut prefix = Vec::new();
+                if op.name == b"\"" {
+                    write_number(state.word_space, &mut prefix);
+                    prefix.extend_from_slice(b"Tw ");
+                    write_number(state.char_space, &mut prefix);
+                    prefix.extend_from_slice(b"Tc ");
+                }
+                if op.name != b"Tj" && op.name != b"TJ" {
+                    prefix.extend_from_slice(b"T* ");
+                }
+                let cut = match opts.text {
+                    PDF_REDACT_TEXT_NONE => false,
+                    PDF_REDACT_TEXT_REMOVE_INVISIBLE => matches!(state.render, 3 | 7),
+                    _ => true,
+                };
+                let mut items = b"[".to_vec();
+                let mut changed = false;
+                for &span in shown(op) {
+                    if let Some(bytes) = string(data, span) {
+                        let mut glyphs = walk.state.glyphs(&bytes, &mut walk.tm);
+                        for glyph in glyphs.iter_mut() {
+                            glyph.cut = cut && index.overlaps(&glyph.bbox);
+                            changed |= glyph.cut;
+                        }
+                        write_kept(&bytes, &glyphs, walk.state.size, &mut items);
+                    } else if let Some(adjust) = adjustment(data, span) {
+                        walk.kern(adjust);
+                        items.extend_from_slice(&data[span.0..span.1]);
+                        items.push(b' ');
+                    }
+                }
+                if changed {
+                    items.extend_from_slice(b"] TJ");
+                    prefix.extend(items);
+                    splices.push((op.start, op.end, prefix));
+                    stats.text_removed += 1;
+                }
+            }
+            b"Do" => {
+                let name = resource_name(data, op);
+                let Some((name, image)) = name.and_then(|n| Some((n, job.images.get(n)?))) else {
+                    continue;
+                };
+                let placed = Rect::UNIT.transform(&state.ctm);
+                if opts.image_method == PDF_REDACT_IMAGE_NONE || !index.overlaps(&placed) {
+                    continue;
+                }
+                let painted = (opts.image_method == PDF_REDACT_IMAGE_PIXELS)
+                    .then(|| black_out(image, &state.ctm, index))
+                    .flatten();
+                match painted {
+                    Some((dict, bytes)) => {
+                        let fresh = (images.len()..)
+                            .map(|k| format!("{name}R{k}"))
+                            .find(|n| !job.names.contains(n))
+                            .unwrap_or_default();
+                        splices.push((op.start, op.end, format!("/{fresh} Do").into_bytes()));
+                        images.push((fresh, dict, bytes));
+                        stats.images_modified += 1;
+                    }
+                    None => {
+                        splices.push((op.start, op.end, Vec::new()));
+                        stats.images_removed += 1;
+                    }
+                }
+            }
+            b"BI" => inline_start = op.start,
+            b"ID" => {
+                let placed = Rect::UNIT.transform(&state.ctm);
+                if opts.image_method != PDF_REDACT_IMAGE_NONE && index.overlaps(&placed) {
+                    splices.push((inline_start, op.end, Vec::new()));
+                    stats.images_removed += 1;
+                }
+            }
+            _ => {}
+        }
+    }
+
+    let mut content = Vec::with_capacity(data.len() + 64);
+    content.extend_from_slice(b"q\n");
+    let mut copied = 0;
+    for (start, end, replacement) in splices {
+        content.extend_from_slice(&data[copied..start]);
+        content.extend_from_slice(&replacement);
+        copied = end;
+    }
+    content.extend_from_slice(&data[copied..]);
+    content.extend_from_slice(b"\nQ\n");
+    if opts.black_boxes != 0 {
+        for region in regions {
+            let r = region.rect;
+            content.extend_from_slice(b"q ");
+            for v in region.color {
+                write_number(v, &mut content);
+            }
+            content.extend_from_slice(b"rg ");
+            for v in [r.x0, r.y0, r.x1 - r.x0, r.y1 - r.y0] {
+                write_number(v, &mut content);
+            }
+            content.extend_from_slice(b"re f Q\n");
+        }
+    }
+    stats.regions_applied = regions.len() as i32;
+    Redacted {
+        content,
+        images,
+        stats,
+    }
+}
+
+/// Redact `job`, finding its regions first if they come from `source`
+fn redact_page(job: &PageJob, source: &Regions, opts: &RedactOptions) -> Option<Redacted> {
+    let mut content = Vec::new();
+    for (_, dict, raw) in &job.streams {
+        content.extend_from_slice(&decode_stream(dict, raw)?);
+        content.push(b'\n');
+    }
+    let found;
+    let regions = match source {
+        Regions::Matches(patterns) => {
+            found = match_regions(&content, &job.fonts, patterns);
+            &found
+        }
+        _ => &job.regions,
+    };
+    if regions.is_empty() {
+        return None;
+    }
+    let index = RegionIndex::new(regions);
+    Some(redact_content(&content, job, regions, &index, opts))
+}
+
+/// The regions of a Redact annotation: its QuadPoints, or else its Rect
+fn annotation_regions(annot: &ParsedValue) -> Vec<Region> {
+    let numbers = |key| match dict_get(annot, key) {
+        Some(ParsedValue::Array(items)) => items.iter().filter_map(number).collect(),
+        _ => Vec::new(),
+    };
+    let color = match numbers("IC")[..] {
+        [r, g, b] => [r, g, b],
+        _ => [0.0; 3],
+    };
+    let bounds = |points: &[f32]| {
+        let mut rect = Rect::EMPTY;
+        for pair in points.chunks_exact(2) {
+            rect.include_point(Point::new(pair[0], pair[1]));
+        }
+        Region { rect, color }
+    };
+    let quads: Vec<f32> = numbers("QuadPoints");
+    if quads.len() >= 8 {
+        return quads.chunks_exact(8).map(bounds).collect();
+    }
+    match numbers("Rect")[..] {
+        [x0, y0, x1, y1] => vec![bounds(&[x0, y0, x1, y1])],
+        _ => Vec::new(),
+    }
+}
+
+/// A page's fonts and images by resource name, and every XObject name
+type PageResources = (
+    HashMap<String, Arc<FontMetrics>>,
+    HashMap<String, Arc<ImageSource>>,
+    HashSet<String>,
+);
+
+/// The metrics of the fonts `resources` holds, by resource name, with
+/// those of fonts already measured taken from `loaded`
+pub(crate) fn page_fonts(
+    xref: &mut Xref,
+    resources: &ParsedValue,
+    loaded: &mut HashMap<i32, Arc<FontMetrics>>,
+) -> HashMap<String, Arc<FontMetrics>> {
+    let mut fonts = HashMap::new();
+    if let Some(ParsedValue::Dict(entries)) =
+        dict_get(resources, "Font").and_then(|d| resolve(xref, d))
+    {
+        for (name, value) in entries {
+            let metrics = match as_ref(&value) {
+                Some(num) => match loaded.get(&num) {
+                    Some(found) => Arc::clone(found),
+                    None => {
+                        let font = xref
+                            .fetch(num)
+                            .map(|f| f.value)
+                            .unwrap_or(ParsedValue::Null);
+                        let found = Arc::new(font_metrics(xref, &font));
+                        loaded.insert(num, Arc::clone(&found));
+                        found
+                    }
+                },
+                None => Arc::new(font_metrics(xref, &value)),
+            };
+            fonts.insert(name, metrics);
+        }
+    }
+    fonts
+}
+
+/// Fonts, images and XObject names `resources` holds
+fn page_resources(
+    xref: &mut Xref,
+    resources: &ParsedValue,
+    loaded: &mut HashMap<i32, Arc<FontMetrics>>,
+    pixels: bool,
+) -> PageResources {
+    let fonts = page_fonts(xref, resources, loaded);
+    let mut images = HashMap::new();
+    let mut names = HashSet::new();
+    if let Some(ParsedValue::Dict(entries)) =
+        dict_get(resources, "XObject").and_then(|d| resolve(xref, d))
+    {
+        for (name, value) in entries {
+            names.insert(name.clone());
+            let Some(fetched) = as_ref(&value).and_then(|num| xref.fetch(num)) else {
+                continue;
+            };
+            if !is_name(dict_get(&fetched.value, "Subtype"), "Image") {
+                continue;
+            }
+            let components = components(xref, dict_get(&fetched.value, "ColorSpace"));
+            let image = ImageSource {
+                raw: fetched.stream.filter(|_| pixels),
+                dict: fetched.value,
+                components,
+            };
+            images.insert(name, Arc::new(image));
+        }
+    }
+    (fonts, images, names)
+}
+
+/// Where the regions to redact come from
+pub(crate) enum Regions<'a> {
+    /// Each page's Redact annotations, removed once applied
+    Annotations,
+    /// The caller, by page index
+    Given(&'a HashMap<i32, Vec<Region>>),
+    /// Matches of patterns in each page's text, found as it is redacted
+    Matches(&'a PatternSet),
+}
+
+/// Redact `pages` (page indices; `None` for every page) of document
+/// `doc` under the regions from `source`, on `threads` threads
+///
+/// The document's data is replaced if anything changed.
+pub(crate) fn redact_document(
+    doc: Handle,
+    pages: Option<&[i32]>,
+    source: Regions,
+    opts: &RedactOptions,
+    threads: usize,
+) -> RedactStats {
+    let mut stats = RedactStats::default();
+    let Some(data) = DOCUMENTS.get(doc).map(|d| d.lock().unwrap().data()) else {
+        return stats;
+    };
+    let Some(mut xref) = open_source(&data, threads) else {
+        return stats;
+    };
+    xref.read_all_sections();
+    // Encrypted streams can't be read without decrypting them
+    let Some(trailer) = xref
+        .source_trailer()
+        .filter(|t| dict_get(t, "Encrypt").is_none())
+        .cloned()
+    else {
+        return stats;
+    };
+    let indices: Vec<i32> = match pages {
+        Some(pages) => pages.to_vec(),
+        None => (0..)
+            .take_while(|&i| xref.lazy_page_object(i).is_some())
+            .collect(),
+    };
+
+    let mut edits = Edits::default();
+    let mut loaded = HashMap::new();
+    let mut claimed = HashSet::new();
+    let mut jobs = Vec::new();
+    for index in indices {
+        let Some(page) = xref.lazy_page_object(index) else {
+            continue;
+        };
+        let Some(mut page_dict) = xref.fetch(page).map(|f| f.value) else {
+            continue;
+        };
+        let regions = match source {
+            Regions::Given(given) => given.get(&index).cloned().unwrap_or_default(),
+            Regions::Matches(_) => Vec::new(),
+            Regions::Annotations => {
+                // Redact annotations go, with their popups
+                let annots_ref = dict_get(&page_dict, "Annots").and_then(as_ref);
+                let Some(ParsedValue::Array(annots)) =
+                    dict_get(&page_dict, "Annots").and_then(|a| resolve(&mut xref, a))
+                else {
+                    continue;
+                };
+                let mut regions = Vec::new();
+                let mut gone = HashSet::new();
+                for num in annots.iter().filter_map(as_ref) {
+                    let Some(annot) = xref.fetch(num).map(|f| f.value) else {
+                        continue;
+                    };
+                    if is_name(dict_get(&annot, "Subtype"), "Redact") {
+                        regions.extend(annotation_regions(&annot));
+                        gone.insert(num);
+                        gone.extend(dict_get(&annot, "Popup").and_then(as_ref));
+                    }
+                }
+                if gone.is_empty() {
+                    continue;
+                }
+                let kept: Vec<ParsedValue> = annots
+                    .into_iter()
+                    .filter(|a| as_ref(a).is_none_or(|n| !gone.contains(&n)))
+                    .collect();
+                match annots_ref {
+                    Some(num) => edits.objects.insert(num, ParsedValue::Array(kept)),
+                    None => {
+                        set_key(&mut page_dict, "Annots", Some(ParsedValue::Array(kept)));
+                        edits.objects.insert(page, page_dict.clone())
+                    }
+                };
+                stats.annotations_removed += gone.len() as i32;
+                edits.removed.extend(gone);
+                regions
+            }
+        };
+        if regions.is_empty() && !matches!(source, Regions::Matches(_)) {
+            continue;
+        }
+
+        let contents = dict_get(&page_dict, "Contents").cloned();
+        let nums: Vec<i32> = match contents.as_ref().and_then(|c| resolve(&mut xref, c)) {
+            Some(ParsedValue::Array(items)) => items.iter().filter_map(as_ref).collect(),
+            _ => contents.as_ref().and_then(as_ref).into_iter().collect(),
+        };
+        if nums.is_empty() || nums.iter().any(|num| claimed.contains(num)) {
+            continue;
+        }
+        claimed.extend(nums.iter().copied());
+        let streams: Option<Vec<_>> = nums
+            .iter()
+            .map(|&num| {
+                let fetched = xref.fetch(num)?;
+                Some((num, fetched.value, fetched.stream?))
+            })
+            .collect();
+        let Some(streams) = streams else {
+            continue;
+        };
+        let resources = inherited(&mut xref, page, "Resources").unwrap_or(ParsedValue::Null);
+        let pixels = opts.image_method == PDF_REDACT_IMAGE_PIXELS;
+        let (fonts, images, names) = page_resources(&mut xref, &resources, &mut loaded, pixels);
+        jobs.push(PageJob {
+            page,
+            streams,
+            fonts,
+            images,
+            names,
+            regions,
+        });
+    }
+    if jobs.is_empty() && edits.objects.is_empty() {
+        return stats;
+    }
+
+    let redacted = parallel_map(&jobs, threads, |job| redact_page(job, &source, opts));
+    let mut next = dict_get(&trailer, "Size")
+        .and_then(as_int)
+        .map_or(0, |n| n as i32)
+        .max(xref.num_objects)
+        .max(1);
+    for (job, page) in jobs.iter().zip(redacted) {
+        let Some(page) = page else {
+            continue;
+        };
+        let Ok(encoded) = encode_flate(&page.content, 6) else {
+            continue;
+        };
+        for (k, (num, dict, _)) in job.streams.iter().enumerate() {
+            let mut dict = dict.clone();
+            for key in ["DecodeParms", "DL", "Filter"] {
+                set_key(&mut dict, key, None);
+            }
+            let data = if k == 0 {
+                set_key(
+                    &mut dict,
+                    "Filter",
+                    Some(ParsedValue::Name("FlateDecode".into())),
+                );
+                Bytes::from(encoded.clone())
+            } else {
+                Bytes::new()
+            };
+            set_key(
+                &mut dict,
+                "Length",
+                Some(ParsedValue::Int(data.len() as i64)),
+            );
+            edits.streams.insert(*num, (dict, data));
+        }
+
+        // Painted images get new objects under new names in the page's
+        // own copy of its resources
+        if !page.images.is_empty() {
+            let mut page_dict = match edits.objects.get(&job.page) {
+                Some(edited) => edited.clone(),
+                None => xref.fetch(job.page).map_or(ParsedValue::Null, |f| f.value),
+            };
+            let mut resources = inherited(&mut xref, job.page, "Resources")
+                .filter(|r| matches!(r, ParsedValue::Dict(_)))
+                .unwrap_or_else(|| ParsedValue::Dict(Vec::new()));
+            let mut xobjects = dict_get(&resources, "XObject")
+                .and_then(|x| resolve(&mut xref, x))
+                .filter(|x| matches!(x, ParsedValue::Dict(_)))
+                .unwrap_or_else(|| ParsedValue::Dict(Vec::new()));
+            for (name, dict, data) in page.images {
+                set_key(
+                    &mut xobjects,
+                    &name,
+                    Some(ParsedValue::Reference {
+                        num: next,
+                        generation: 0,
+                    }),
+                );
+                edits.added_streams.push((next, dict, data));
+                next += 1;
+            }
+            set_key(&mut resources, "XObject", Some(xobjects));
+            set_key(&mut page_dict, "Resources", Some(resources));
+            edits.objects.insert(job.page, page_dict);
+        }
+        stats.regions_applied += page.stats.regions_applied;
+        stats.text_removed += page.stats.text_removed;
+        stats.images_removed += page.stats.images_removed;
+        stats.images_modified += page.stats.images_modified;
+        stats.line_art_removed += page.stats.line_art_removed;
+    }
+
+    let settings = WriteSettings {
+        compress: false,
+        decompress: false,
+        threads,
+        ..WriteSettings::default()
+    };
+    let mut out = Vec::new();
+    let saved = matches!(
+        write_opened(xref, &settings, &edits, &mut out),
+        Some(Ok(()))
+    );
+    match DOCUMENTS.get(doc).filter(|_| saved) {
+        Some(d) => {
+            d.lock().unwrap().replace_data(out);
+            pdf_purge_content_program_cache(0, doc);
+            fz_purge_display_list_cache(0, doc);
+            stats
+        }
+        None => RedactStats::default(),
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::document::Document;
+    use crate::ffi::pdf_image_rewriter::tests::{pdf_with, stream};
+
+    fn region(x0: f32, y0: f32, x1: f32, y1: f32) -> Region {
+        Region {
+            rect: Rect::new(x0, y0, x1, y1),
+            color: [0.0; 3],
+        }
+    }
+
+    fn content(xref: &mut Xref, num: i32) -> Vec<u8> {
+        let f = xref.fetch(num).unwrap();
+        decode_stream(&f.value, f.stream.as_ref().unwrap()).unwrap()
+    }
+
+    #[test]
+    fn test_region_index() {
+        let regions: Vec<Region> = (0..20)
+            .map(|i| region(i as f32 * 10.0, 0.0, i as f32 * 10.0 + 5.0, 5.0))
+            .collect();
+        let index = RegionIndex::new(&regions);
+        assert!(index.overlaps(&Rect::new(72.0, 1.0, 73.0, 2.0)));
+        assert!(!index.overlaps(&Rect::new(75.0, 1.0, 80.0, 2.0)));
+        assert!(index.touches(&Rect::new(75.0, 1.0, 80.0, 2.0)));
+        assert!(index.covers(&Rect::new(190.0, 0.0, 195.0, 5.0)));
+        assert!(!index.covers(&Rect::new(190.0, 0.0, 200.0, 5.0)));
+        assert!(!index.touches(&Rect::new(0.0, 6.0, 200.0, 9.0)));
+    }
+
+    #[test]
+    fn test_redact_cuts_glyphs_keeping_the_rest_in_place() {
+        let data = pdf_with(&[
+            b"<< /Type /Catalog /Pages 2 0 R >>".to_vec(),
+            b"<< /Type /Pages /Kids [3 0 R] /Count 1 >>".to_vec(),
+            b"<< /Type /Page /Parent 2 0 R /Contents 4 0 R \
+               /Resources << /Font << /F1 5 0 R >> >> >>"
+                .to_vec(),
+            stream("", b"BT /F1 10 Tf 0 0 Td (ABC) Tj 0 -20 Td (ABC) Tj ET"),
+            b"<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>".to_vec(),
+        ]);
+        let doc = DOCUMENTS.insert(Document::new(data));
+        // Half an em a glyph: B runs from 5 to 10 on the first line only
+        let given = HashMap::from([(0, vec![region(6.0, 0.0, 9.0, 5.0)])]);
+        let opts = RedactOptions::new();
+        let stats = redact_document(doc, None, Regions::Given(&given), &opts, 2);
+        assert_eq!(stats.regions_applied, 1);
+        assert_eq!(stats.text_removed, 1);
+
+        let data = DOCUMENTS.get(doc).unwrap().lock().unwrap().data();
+        let mut xref = Xref::open_lazy(0, data).unwrap();
+        let redacted = String::from_utf8(content(&mut xref, 4)).unwrap();
+        assert!(redacted.contains("[<41> -500 <43> ] TJ 0 -20 Td (ABC) Tj"));
+        assert!(redacted.ends_with("Q\nq 0 0 0 rg 6 0 3 5 re f Q\n"));
+        DOCUMENTS.remove(doc);
+    }
+
+    #[test]
+    fn test_redact_annotations_remove_line_art_and_images() {
+        let data = pdf_with(&[
+            b"<< /Type /Catalog /Pages 2 0 R >>".to_vec(),
+            b"<< /Type /Pages /Kids [3 0 R] /Count 1 >>".to_vec(),
+            b"<< /Type /Page /Parent 2 0 R /Contents 4 0 R /Annots [5 0 R 6 0 R 7 0 R] \
+               /Resources << /XObject << /Im0 8 0 R >> >> >>"
+                .to_vec(),
+            stream(
+                "",
+                b"0 0 10 10 re f 50 50 10 10 re f 0 0 m 20 20 l W n \
+                  q 10 0 0 10 0 0 cm /Im0 Do Q q 10 0 0 10 80 80 cm /Im0 Do Q",
+            ),
+            b"<< /Type /Annot /Subtype /Redact /Rect [0 0 20 20] /IC [1 0 0] /Popup 6 0 R >>"
+                .to_vec(),
+            b"<< /Type /Annot /Subtype /Popup /Rect [0 0 1 1] >>".to_vec(),
+            b"<< /Type /Annot /Subtype /Text /Rect [0 0 1 1] >>".to_vec(),
+            stream(
+                "/Type /XObject /Subtype /Image /Width 1 /Height 1 \
+                 /ColorSpace /DeviceGray /BitsPerComponent 8",
+                b"\x80",
+            ),
+        ]);
+        let doc = DOCUMENTS.insert(Document::new(data));
+        let stats = redact_document(doc, None, Regions::Annotations, &RedactOptions::new(), 1);
+        assert_eq!(stats.regions_applied, 1);
+        assert_eq!(stats.line_art_removed, 1);
+        assert_eq!(stats.images_removed, 1);
+        assert_eq!(stats.annotations_removed, 2);
+
+        let data = DOCUMENTS.get(doc).unwrap().lock().unwrap().data();
+        let mut xref = Xref::open_lazy(0, data).unwrap();
+        assert_eq!(
+            String::from_utf8(content(&mut xref, 4)).unwrap(),
+            "q\n 50 50 10 10 re f 0 0 m 20 20 l W n \
+             q 10 0 0 10 0 0 cm  Q q 10 0 0 10 80 80 cm /Im0 Do Q\n\n\
+             Q\nq 1 0 0 rg 0 0 20 20 re f Q\n"
+        );
+        let page = xref.fetch(3).unwrap().value;
+        match dict_get(&page, "Annots") {
+            Some(ParsedValue::Array(annots)) => {
+                assert_eq!(annots.iter().filter_map(as_ref).collect::<Vec<_>>(), [7]);
+            }
+            other => panic!("unexpected Annots {other:?}"),
+        }
+        DOCUMENTS.remove(doc);
+    }
+
+    #[test]
+    fn test_redact_paints_image_pixels_black() {
+        let data = pdf_with(&[
+            b"<< /Type /Catalog /Pages 2 0 R >>".to_vec(),
+            b"<< /Type /Pages /Kids [3 0 R] /Count 1 >>".to_vec(),
+            b"<< /Type /Page /Parent 2 0 R /Contents 4 0 R \
+               /Resources << /XObject << /Im0 5 0 R >> >> >>"
+                .to_vec(),
+            stream("", b"q 20 0 0 10 0 0 cm /Im0 Do Q"),
+            stream(
+                "/Type /XObject /Subtype /Image /Width 2 /Height 1 \
+                 /ColorSpace /DeviceGray /BitsPerComponent 8",
+                b"\x80\x80",
+            ),
+        ]);
+        let doc = DOCUMENTS.insert(Document::new(data));
+        let given = HashMap::from([(0, vec![region(0.0, 0.0, 10.0, 10.0)])]);
+        let opts = RedactOptions {
+            image_method: PDF_REDACT_IMAGE_PIXELS,
+            black_boxes: 0,
+            ..RedactOptions::new()
+        };
+        let stats = redact_document(doc, None, Regions::Given(&given), &opts, 2);
+        assert_eq!(stats.images_modified, 1);
+
+        let data = DOCUMENTS.get(doc).unwrap().lock().unwrap().data();
+        let mut xref = Xref::open_lazy(0, data).unwrap();
+        assert_eq!(
+            content(&mut xref, 4),
+            b"q\nq 20 0 0 10 0 0 cm /Im0R0 Do Q\n\nQ\n"
+        );
+        let resources = inherited(&mut xref, 3, "Resources").unwrap();
+        let xobjects = dict_get(&resources, "XObject").unwrap();
+        let image = dict_get(xobjects, "Im0R0").and_then(as_ref).unwrap();
+        assert_ne!(image, 5);
+        assert_eq!(content(&mut xref, image), [0, 0x80]);
+        DOCUMENTS.remove(doc);
+    }
+}
@@ -0,0 +1,371 @@
+//! Pattern Redaction
+//!
+//! Redacting search hits one call at a time costs a search per pattern
+//! per page and a call per hit to add its region. A `PatternSet` instead
+//! compiles every pattern into one Aho-Corasick automaton over case-folded
+//! code points. Each page's text is then scanned once for all of them as
+//! the page is redacted (see `pdf_redact_engine`), so the matches of every
+//! page are found and applied on the same threads in the same pass.
+//!
+//! A page's text is the ToUnicode text of the glyphs it shows, in content
+//! order. A line ends where a glyph leaves the baseline of the one before
+//! or moves back along it, and a space is assumed where a glyph starts
+//! well past the end of the one before. Like `fz_search_stext_page`,
+//! matching ignores case and never crosses lines.
+
+use super::pdf_redact_engine::{FontMetrics, Region, TextWalk, adjustment, shown};
+use super::pdf_vectorize::{operators, string};
+use super::string_util::fold_char;
+use crate::fitz::geometry::Rect;
+use std::collections::{HashMap, VecDeque};
+use std::sync::Arc;
+
+/// Ends each line of a page's text
+const LINE_END: u32 = '\n' as u32;
+
+/// A gap wider than this, in boxes' heights, reads as a space
+pub(crate) const SPACE_GAP: f32 = 0.15;
+
+/// A state of the automaton
+#[derive(Debug, Default)]
+struct Node {
+    next: HashMap<u32, usize>,
+    /// The state for the longest proper suffix of this one's text
+    fail: usize,
+    /// Lengths of the patterns this state's text ends with
+    lengths: Vec<usize>,
+}
+
+/// Patterns compiled to match all at once
+#[derive(Debug)]
+pub(crate) struct PatternSet {
+    /// States by number, the root first
+    nodes: Vec<Node>,
+}
+
+impl PatternSet {
+    /// Compile `patterns`; empty ones, and ones spanning lines, are left
+    /// out
+    pub(crate) fn new<S: AsRef<str>>(patterns: &[S]) -> Self {
+        let mut nodes = vec![Node::default()];
+        for pattern in patterns {
+            let pattern = pattern.as_ref();
+            if pattern.is_empty() || pattern.contains('\n') {
+                continue;
+            }
+            let mut state = 0;
+            let mut length = 0;
+            for c in pattern.chars() {
+                let c = fold_char(c as u32);
+                state = match nodes[state].next.get(&c) {
+                    Some(&next) => next,
+                    None => {
+                        nodes.push(Node::default());
+                        let next = nodes.len() - 1;
+                        nodes[state].next.insert(c, next);
+                        next
+                    }
+                };
+                length += 1;
+            }
+            if !nodes[state].lengths.contains(&length) {
+                nodes[state].lengths.push(length);
+            }
+        }
+
+        // Breadth first, so a state's fail state is done before it
+        let mut queue: VecDeque<usize> = nodes[0].next.values().copied().collect();
+        while let Some(state) = queue.pop_front() {
+            let edges: Vec<(u32, usize)> =
+                nodes[state].next.iter().map(|(&c, &n)| (c, n)).collect();
+            for (c, next) in edges {
+                let mut fail = nodes[state].fail;
+                while fail != 0 && !nodes[fail].next.contains_key(&c) {
+                    fail = nodes[fail].fail;
+                }
+                let fail = nodes[fail]
+                    .next
+                    .get(&c)
+                    .copied()
+                    .filter(|&f| f != next)
+                    .unwrap_or(0);
+                let inherited = nodes[fail].lengths.clone();
+                let node = &mut nodes[next];
+                node.fail = fail;
+                node.lengths.extend(inherited);
+                queue.push_back(next);
+            }
+        }
+        Self { nodes }
+    }
+
+    /// Whether no pattern can match
+    pub(crate) fn is_empty(&self) -> bool {
+        self.nodes.len() == 1
+    }
+
+    /// Where each pattern matches `text`, as (start, end) positions,
+    /// overlapping matches included
+    fn matches(&self, text: &[u32]) -> Vec<(usize, usize)> {
+        let mut found = Vec::new();
+        let mut state = 0;
+        for (i, &c) in text.iter().enumerate() {
+            let c = fold_char(c);
+            while state != 0 && !self.nodes[state].next.contains_key(&c) {
+                state = self.nodes[state].fail;
+            }
+            state = self.nodes[state].next.get(&c).copied().unwrap_or(0);
+            found.extend(
+                self.nodes[state]
+                    .lengths
+                    .iter()
+                    .map(|&n| (i + 1 - n, i + 1)),
+            );
+        }
+        found
+    }
+}
+
+/// Most codes a ToUnicode bfrange maps
+const MAX_RANGE: u32 = 0x10000;
+
+/// `bytes` as a big-endian code
+fn code(bytes: &[u8]) -> u32 {
+    bytes.iter().fold(0, |code, &b| code << 8 | u32::from(b))
+}
+
+/// UTF-16BE `bytes` as code points
+fn utf16(bytes: &[u8]) -> Vec<u32> {
+    let units = bytes
+        .chunks_exact(2)
+        .map(|u| u16::from_be_bytes([u[0], u[1]]));
+    char::decode_utf16(units)
+        .map(|c| c.map_or(0xfffd, u32::from))
+        .collect()
+}
+
+/// The text each code stands for in ToUnicode CMap `cmap`
+pub(crate) fn to_unicode(cmap: &[u8]) -> HashMap<u32, Vec<u32>> {
+    let mut map = HashMap::new();
+    for op in operators(cmap) {
+        // Strings as `Some`, brackets as `None`
+        let items: Vec<Option<Vec<u8>>> = op
+            .operands
+            .iter()
+            .filter_map(|&span| match string(cmap, span) {
+                Some(bytes) => Some(Some(bytes)),
+                None => matches!(cmap[span.0], b'[' | b']').then_some(None),
+            })
+            .collect();
+        match op.name {
+            b"endbfchar" => {
+                for pair in items.chunks_exact(2) {
+                    if let [Some(src), Some(dst)] = pair {
+                        map.insert(code(src), utf16(dst));
+                    }
+                }
+            }
+            b"endbfrange" => {
+                let mut items = items.into_iter();
+                while let (Some(Some(lo)), Some(Some(hi))) = (items.next(), items.next()) {
+                    let (lo, hi) = (code(&lo), code(&hi));
+                    let count = hi.saturating_sub(lo).min(MAX_RANGE - 1);
+                    match items.next() {
+                        Some(Some(mut dst)) if dst.len() >= 2 => {
+                            for offset in 0..=count {
+                                map.insert(lo + offset, utf16(&dst));
+                                // Each code maps to the one before plus one
+                                let at = dst.len() - 2;
+                                let last = u16::from_be_bytes([dst[at], dst[at + 1]]);
+                                dst[at..].copy_from_slice(&last.wrapping_add(1).to_be_bytes());
+                            }
+                        }
+                        Some(None) => {
+                            let dsts = items.by_ref().map_while(|item| item);
+                            for (offset, dst) in (0..).zip(dsts) {
+                                if offset <= count {
+                                    map.insert(lo + offset, utf16(&dst));
+                                }
+                            }
+                        }
+                        _ => break,
+                    }
+                }
+            }
+            _ => {}
+        }
+    }
+    map
+}
+
+/// The text content stream `data` shows, with fonts by resource name in
+/// `fonts`, and the box of each character; assumed spaces and line ends
+/// have empty boxes
+fn page_text(data: &[u8], fonts: &HashMap<String, Arc<FontMetrics>>) -> (Vec<u32>, Vec<Rect>) {
+    let mut chars = Vec::new();
+    let mut boxes = Vec::new();
+    let mut walk = TextWalk::new();
+    let mut last: Option<Rect> = None;
+    for op in operators(data) {
+        if walk.step(data, &op, fonts) || !matches!(op.name, b"Tj" | b"'" | b"\"" | b"TJ") {
+            continue;
+        }
+        let Some(font) = walk.state.font.clone() else {
+            continue;
+        };
+        for &span in shown(&op) {
+            let Some(bytes) = string(data, span) else {
+                if let Some(adjust) = adjustment(data, span) {
+                    walk.kern(adjust);
+                }
+                continue;
+            };
+            for glyph in walk.state.glyphs(&bytes, &mut walk.tm) {
+                let bbox = glyph.bbox;
+                if let Some(prev) = last {
+                    let height = (prev.y1 - prev.y0).max(bbox.y1 - bbox.y0);
+                    let breaks = (bbox.y0 - prev.y0).abs() > height / 2.0 || bbox.x1 < prev.x0;
+                    if breaks {
+                        chars.push(LINE_END);
+                        boxes.push(Rect::EMPTY);
+                    } else if bbox.x0 - prev.x1 > height * SPACE_GAP
+                        && chars.last() != Some(&(' ' as u32))
+                    {
+                        chars.push(' ' as u32);
+                        boxes.push(Rect::EMPTY);
+                    }
+                }
+                let before = chars.len();
+                font.text(glyph.code, &mut chars);
+                boxes.resize(chars.len(), bbox);
+                if chars.len() > before {
+                    last = Some(bbox);
+                }
+            }
+        }
+    }
+    if chars.last().is_some_and(|&c| c != LINE_END) {
+        chars.push(LINE_END);
+        boxes.push(Rect::EMPTY);
+    }
+    (chars, boxes)
+}
+
+/// Regions over every match of `patterns` in content stream `data`, one
+/// per match per line
+///
+/// Each region is inset a little from its glyphs' boxes, so glyphs beside
+/// a match that only touch it are kept.
+pub(crate) fn match_regions(
+    data: &[u8],
+    fonts: &HashMap<String, Arc<FontMetrics>>,
+    patterns: &PatternSet,
+) -> Vec<Region> {
+    let (chars, boxes) = page_text(data, fonts);
+    let mut regions = Vec::new();
+    for (start, end) in patterns.matches(&chars) {
+        let mut rect = Rect::EMPTY;
+        for i in start..=end {
+            if i == end || chars[i] == LINE_END {
+                if !rect.is_empty() {
+                    let inset = ((rect.y1 - rect.y0) * 0.01).min((rect.x1 - rect.x0) / 4.0);
+                    rect.x0 += inset;
+                    rect.x1 -= inset;
+                    regions.push(Region {
+                        rect,
+                        color: [0.0; 3],
+                    });
+                }
+                rect = Rect::EMPTY;
+            } else {
+                rect = rect.union(&boxes[i]);
+            }
+        }
+    }
+    regions
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::DOCUMENTS;
+    use crate::ffi::document::Document;
+    use crate::ffi::pdf_image_rewriter::tests::{pdf_with, stream};
+    use crate::ffi::pdf_redact::RedactOptions;
+    use crate::ffi::pdf_redact_engine::{Regions, redact_document};
+    use crate::ffi::pdf_xref::Xref;
+    use crate::ffi::pdf_xref_lazy::decode_stream;
+
+    fn text(s: &str) -> Vec<u32> {
+        s.chars().map(|c| c as u32).collect()
+    }
+
+    #[test]
+    fn test_to_unicode() {
+        let cmap = b"/CIDInit /ProcSet findresource begin 12 dict begin begincmap \
+            1 begincodespacerange <0000> <ffff> endcodespacerange \
+            2 beginbfchar <0001> <0041> <0002> <00660069> endbfchar \
+            2 beginbfrange <0010> <0012> <0061> <0020> <0021> [<0031> <d83dde00>] endbfrange \
+            endcmap CMapName currentdict /CMap defineresource pop end end";
+        let map = to_unicode(cmap);
+        assert_eq!(map[&1], [0x41]);
+        assert_eq!(map[&2], [0x66, 0x69]);
+        assert_eq!(map[&0x12], [0x63]);
+        assert_eq!(map[&0x20], [0x31]);
+        assert_eq!(map[&0x21], [0x1f600]);
+        assert_eq!(map.len(), 7);
+    }
+
+    #[test]
+    fn test_pattern_set_finds_every_match() {
+        let patterns = PatternSet::new(&["he", "she", "hers", "", "a\nb"]);
+        assert!(!patterns.is_empty());
+        assert_eq!(patterns.matches(&text("uSHErs")), [(1, 4), (2, 4), (2, 6)]);
+        assert!(patterns.matches(&text("a\nb")).is_empty());
+        assert!(PatternSet::new(&[""]).is_empty());
+    }
+
+    #[test]
+    fn test_redact_matches_across_pages() {
+        let data = pdf_with(&[
+            b"<< /Type /Catalog /Pages 2 0 R >>".to_vec(),
+            b"<< /Type /Pages /Kids [3 0 R 4 0 R] /Count 2 >>".to_vec(),
+            b"<< /Type /Page /Parent 2 0 R /Contents 5 0 R \
+               /Resources << /Font << /F1 7 0 R >> >> >>"
+                .to_vec(),
+            b"<< /Type /Page /Parent 2 0 R /Contents 6 0 R \
+               /Resources << /Font << /F1 7 0 R >> >> >>"
+                .to_vec(),
+            stream("", b"BT /F1 10 Tf (Hello secret world) Tj ET"),
+            stream("", b"BT /F1 10 Tf (Nothing) Tj 0 -20 Td (to hide) Tj ET"),
+            b"<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>".to_vec(),
+        ]);
+        let doc = DOCUMENTS.insert(Document::new(data));
+        let patterns = PatternSet::new(&["SECRET", "ing to"]);
+        let stats = redact_document(
+            doc,
+            None,
+            Regions::Matches(&patterns),
+            &RedactOptions::new(),
+            2,
+        );
+        assert_eq!(stats.regions_applied, 1);
+        assert_eq!(stats.text_removed, 1);
+
+        let data = DOCUMENTS.get(doc).unwrap().lock().unwrap().data();
+        let mut xref = Xref::open_lazy(0, data).unwrap();
+        let f = xref.fetch(5).unwrap();
+        let content = decode_stream(&f.value, f.stream.as_ref().unwrap()).unwrap();
+        let content = String::from_utf8(content).unwrap();
+        // Each glyph is half an em, so "secret" runs from 30 to 60
+        assert!(content.contains("[<48656c6c6f20> -3000 <20776f726c64> ] TJ"));
+        assert!(content.contains("re f Q"));
+        // A match can't span the line break
+        let f = xref.fetch(6).unwrap();
+        assert_eq!(
+            decode_stream(&f.value, f.stream.as_ref().unwrap()).unwrap(),
+            b"BT /F1 10 Tf (Nothing) Tj 0 -20 Td (to hide) Tj ET"
+        );
+        DOCUMENTS.remove(doc);
+    }
+}
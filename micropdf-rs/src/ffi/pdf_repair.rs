@@ -0,0 +1,391 @@
+//! Xref Reconstruction
+//!
+//! When a file's xref is missing or unusable, the only way back to its
+//! objects is to scan the whole file for `N G obj` headers. The scan is
+//! split into chunks that are searched on separate threads with the SIMD
+//! substring search, then merged in file order so that, as in an
+//! incremental update, the last definition of an object wins.
+
+use super::mmap::MAPPED_FILES;
+use super::pdf_object::new_document_object;
+use super::pdf_parse::{ParsedValue, PdfParser, PdfToken, parsed_value_to_obj};
+use super::pdf_xref::{XREFS, Xref, XrefEntry, XrefSubsection};
+use super::pdf_xref_lazy::{XrefSource, header_version};
+use super::simd_util::{self, PdfByteClass};
+use super::{DOCUMENTS, Handle};
+
+/// Smallest chunk a scan thread is given; smaller files use fewer threads
+const MIN_CHUNK: usize = 1 << 20;
+/// Largest object number accepted from a header (MuPDF's `PDF_MAX_OBJECT_NUMBER`)
+const MAX_OBJECT_NUMBER: i64 = 8_388_607;
+/// How far past a header is searched for `/Catalog`
+const CATALOG_WINDOW: usize = 256;
+/// Parse window for the trailer dict
+const TRAILER_WINDOW: usize = 64 * 1024;
+
+/// An object header found by the scan
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct ScannedObject {
+    pub num: i32,
+    pub generation: u16,
+    /// Offset of the object number
+    pub offset: usize,
+    /// Whether `/Catalog` appears right after the header
+    pub catalog: bool,
+}
+
+/// Everything the scan found
+#[derive(Debug, Default)]
+pub struct RepairScan {
+    /// Object headers in file order
+    pub objects: Vec<ScannedObject>,
+    /// Offset of the last `trailer` keyword
+    pub trailer: Option<usize>,
+}
+
+/// Parse the header whose `obj` keyword starts at `at`, if it is one
+fn header_at(data: &[u8], at: usize) -> Option<ScannedObject> {
+    // `obj` must end the token: rules out `object`, `objx`
+    if data
+        .get(at + 3)
+        .is_some_and(|&c| PdfByteClass::Regular.matches(c))
+    {
+        return None;
+    }
+    // Walk back over `num ws gen ws`; `endobj` fails the whitespace check
+    let digits_before = |end: usize| {
+        let start = data[..end]
+            .iter()
+            .rposition(|c| !c.is_ascii_digit())
+            .map_or(0, |p| p + 1);
+        (start < end).then_some(start)
+    };
+    let ws_before = |end: usize| {
+        let start = data[..end]
+            .iter()
+            .rposition(|&c| !simd_util::is_pdf_whitespace(c))
+            .map_or(0, |p| p + 1);
+        (start < end).then_some(start)
+    };
+    let gen_end = ws_before(at)?;
+    let gen_start = digits_before(gen_end)?;
+    let num_end = ws_before(gen_start)?;
+    let num_start = digits_before(num_end)?;
+    if num_start > 0 && PdfByteClass::Regular.matches(data[num_start - 1]) {
+        return None;
+    }
+    // Overlong digit runs are garbage, not object numbers
+    if num_end - num_start > 10 || gen_end - gen_start > 5 {
+        return None;
+    }
+    let parse = |s: &[u8]| {
+        s.iter()
+            .fold(0i64, |acc, &c| acc * 10 + i64::from(c - b'0'))
+    };
+    let num = parse(&data[num_start..num_end]);
+    let generation = parse(&data[gen_start..gen_end]);
+    if num > MAX_OBJECT_NUMBER || generation > 65535 {
+        return None;
+    }
+
+    let after = &data[at + 3..data.len().min(at + 3 + CATALOG_WINDOW)];
+    let body = simd_util::find_bytes(after, b"endobj").map_or(after, |end| &after[..end]);
+    Some(ScannedObject {
+        num: num as i32,
+        generation: generation as u16,
+        offset: num_start,
+        catalog: simd_util::find_bytes(body, b"/Catalog").is_some(),
+    })
+}
+
+/// Scan `data[start..end]` for headers; matches may read past `end` but
+/// only those starting before it belong to this chunk
+fn scan_chunk(data: &[u8], start: usize, end: usize) -> RepairScan {
+    let mut scan = RepairScan::default();
+    let find_in_chunk = |needle: &[u8], from: usize| {
+        let stop = data.len().min(end + needle.len() - 1);
+        if from >= stop {
+            return None;
+        }
+        simd_util::find_bytes(&data[from..stop], needle).map(|p| from + p)
+    };
+
+    let mut pos = start;
+    while let Some(at) = find_in_chunk(b"obj", pos) {
+        if let Some(obj) = header_at(data, at) {
+            scan.objects.push(obj);
+        }
+        pos = at + 3;
+    }
+    let mut pos = start;
+    while let Some(at) = find_in_chunk(b"trailer", pos) {
+        scan.trailer = Some(at);
+        pos = at + 7;
+    }
+    scan
+}
+
+fn scan_chunked(data: &[u8], chunk: usize, threads: usize) -> RepairScan {
+    let chunk = chunk.max(1);
+    let bounds: Vec<(usize, usize)> = (0..data.len())
+        .step_by(chunk)
+        .map(|s| (s, data.len().min(s + chunk)))
+        .collect();
+    let threads = threads.clamp(1, bounds.len().max(1));
+
+    let mut parts: Vec<RepairScan> = Vec::with_capacity(bounds.len());
+    if threads == 1 {
+        parts.extend(bounds.iter().map(|&(s, e)| scan_chunk(data, s, e)));
+    } else {
+        // Contiguous runs of chunks per thread keep the merge a plain concat
+        let per_thread = bounds.len().div_ceil(threads);
+        std::thread::scope(|scope| {
+            let workers: Vec<_> = bounds
+                .chunks(per_thread)
+                .map(|run| {
+                    scope.spawn(move || {
+                        run.iter()
+                            .map(|&(s, e)| scan_chunk(data, s, e))
+                            .collect::<Vec<_>>()
+                    })
+                })
+                .collect();
+            for worker in workers {
+                parts.extend(worker.join().unwrap_or_default());
+            }
+        });
+    }
+
+    let mut scan = RepairScan {
+        objects: Vec::with_capacity(parts.iter().map(|p| p.objects.len()).sum()),
+        trailer: None,
+    };
+    for part in parts {
+        scan.objects.extend(part.objects);
+        scan.trailer = part.trailer.or(scan.trailer);
+    }
+    scan
+}
+
+/// Scan a whole file for object headers and trailers
+///
+/// `threads` of 0 uses one thread per core.
+pub fn scan_objects(data: &[u8], threads: usize) -> RepairScan {
+    let threads = match threads {
+        0 => std::thread::available_parallelism().map_or(1, |n| n.get()),
+        n => n,
+    };
+    scan_chunked(data, data.len().div_ceil(threads).max(MIN_CHUNK), threads)
+}
+
+/// Trailer dict for a rebuilt xref: the file's last `trailer` dict without
+/// its links to the broken sections, with `/Size` reset and `/Root` filled
+/// in from the scan if it was missing
+fn rebuild_trailer(data: &[u8], scan: &RepairScan, size: i32) -> ParsedValue {
+    let mut entries = scan
+        .trailer
+        .and_then(|at| {
+            let end = data.len().min(at + TRAILER_WINDOW);
+            let mut parser = PdfParser::new(data[at..end].to_vec());
+            (parser.lex() == PdfToken::Trailer).then(|| parser.parse_value())?
+        })
+        .and_then(|v| match v {
+            ParsedValue::Dict(entries) => Some(entries),
+            _ => None,
+        })
+        .unwrap_or_default();
+
+    entries.retain(|(k, _)| !matches!(k.as_str(), "Prev" | "XRefStm" | "Size"));
+    entries.push(("Size".to_string(), ParsedValue::Int(i64::from(size))));
+    if !entries.iter().any(|(k, _)| k == "Root") {
+        if let Some(root) = scan.objects.iter().rev().find(|o| o.catalog) {
+            entries.push((
+                "Root".to_string(),
+                ParsedValue::Reference {
+                    num: root.num,
+                    generation: i32::from(root.generation),
+                },
+            ));
+        }
+    }
+    ParsedValue::Dict(entries)
+}
+
+impl Xref {
+    /// Rebuild an xref from a scan of the whole file
+    ///
+    /// Returns `None` if no object headers were found.
+    pub fn repair(document: Handle, data: &[u8], threads: usize) -> Option<(Self, ParsedValue)> {
+        let scan = scan_objects(data, threads);
+        let size = scan.objects.iter().map(|o| o.num).max()? + 1;
+
+        let mut subsec = XrefSubsection::with_capacity(0, size as usize);
+        subsec
+            .entries
+            .extend((0..size).map(|num| XrefEntry::free(num, 0)));
+        subsec.entries[0] = XrefEntry::free(0, 65535);
+        // File order: later definitions replace earlier ones
+        for obj in &scan.objects {
+            subsec.entries[obj.num as usize] =
+                XrefEntry::inuse(obj.num, obj.generation, obj.offset as i64);
+        }
+
+        let mut xref = Xref::new(document);
+        xref.add_subsection(subsec);
+        xref.version = header_version(data).unwrap_or(xref.version);
+        let trailer = rebuild_trailer(data, &scan, size);
+        xref.trailer = new_document_object(document, parsed_value_to_obj(&trailer));
+        Some((xref, trailer))
+    }
+}
+
+// ============================================================================
+// FFI Functions
+// ============================================================================
+
+fn thread_count(threads: i32) -> usize {
+    usize::try_from(threads).unwrap_or(0)
+}
+
+/// Rebuild a document's xref by scanning its data for objects
+///
+/// The result loads objects on demand like a lazily opened xref. `threads`
+/// of 0 or less uses one thread per core. Returns 0 if no objects were
+/// found.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_repair_xref(_ctx: Handle, doc: Handle, threads: i32) -> Handle {
+    let Some(data) = DOCUMENTS
+        .get(doc)
+        .and_then(|d| d.lock().ok().map(|d| d.data()))
+    else {
+        return 0;
+    };
+    match Xref::repair(doc, &data, thread_count(threads)) {
+        Some((mut xref, trailer)) => {
+            xref.source = Some(XrefSource::new(data, trailer));
+            XREFS.insert(xref)
+        }
+        None => 0,
+    }
+}
+
+/// Rebuild an xref by scanning a memory-mapped file for objects
+///
+/// Only the entries and trailer are rebuilt; the xref doesn't belong to a
+/// document and can't load objects. Returns 0 if no objects were found.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_repair_mapped_file(_ctx: Handle, file: Handle, threads: i32) -> Handle {
+    let Some(f) = MAPPED_FILES.get(file) else {
+        return 0;
+    };
+    let guard = f.lock().unwrap();
+    match Xref::repair(0, guard.as_slice(), thread_count(threads)) {
+        Some((xref, _)) => XREFS.insert(xref),
+        None => 0,
+    }
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::super::document::Document;
+    use super::super::pdf_xref::{
+        PDF_XREF_FREE, PDF_XREF_INUSE, pdf_cache_object, pdf_drop_xref, pdf_get_xref_entry,
+    };
+    use super::*;
+
+    fn damaged_pdf() -> Vec<u8> {
+        let mut pdf = b"%PDF-1.6\n".to_vec();
+        pdf.extend_from_slice(b"1 0 obj\n<< /Type /Catalog /Pages 2 0 R >>\nendobj\n");
+        pdf.extend_from_slice(b"2 0 obj\n<< /Type /Pages /Kids [] /Count 0 >>\nendobj\n");
+        pdf.extend_from_slice(b"12 3 obj (not an object: 4 0 objection)\nendobj\n");
+        pdf.extend_from_slice(b"x5 0 obj 99 0 obj\n42\nendobj\n");
+        // Incremental update redefining object 2
+        pdf.extend_from_slice(b"2 0 obj\n<< /Type /Pages /Kids [] /Count 0 /New true >>\nendobj\n");
+        pdf.extend_from_slice(b"xref\n0 1\ngarbage\ntrailer\n<< /Size 3 /Prev 12345 >>\n%%EOF");
+        pdf
+    }
+
+    fn offset_of(pdf: &[u8], needle: &[u8], nth: usize) -> usize {
+        (0..pdf.len())
+            .filter(|&i| pdf[i..].starts_with(needle))
+            .nth(nth)
+            .unwrap()
+    }
+
+    #[test]
+    fn test_scan_finds_only_real_headers() {
+        let pdf = damaged_pdf();
+        let nums: Vec<i32> = scan_objects(&pdf, 1)
+            .objects
+            .iter()
+            .map(|o| o.num)
+            .collect();
+        assert_eq!(nums, [1, 2, 12, 99, 2]);
+    }
+
+    #[test]
+    fn test_chunked_scan_matches_serial() {
+        let pdf = damaged_pdf();
+        let serial = scan_chunked(&pdf, pdf.len(), 1);
+        // Tiny chunks put headers and needles across every boundary
+        for chunk in [1, 2, 3, 7, 16, 61] {
+            for threads in [1, 3, 8] {
+                let scan = scan_chunked(&pdf, chunk, threads);
+                assert_eq!(scan.objects, serial.objects, "chunk {chunk} x{threads}");
+                assert_eq!(scan.trailer, serial.trailer);
+            }
+        }
+    }
+
+    #[test]
+    fn test_repair_last_definition_wins() {
+        let pdf = damaged_pdf();
+        let (xref, trailer) = Xref::repair(0, &pdf, 4).unwrap();
+        assert_eq!(xref.num_objects, 100);
+        assert_eq!(xref.version, 16);
+
+        let obj2 = xref.get_entry(2).unwrap();
+        assert_eq!(obj2.entry_type, PDF_XREF_INUSE);
+        assert_eq!(obj2.offset as usize, offset_of(&pdf, b"2 0 obj", 1));
+        assert_eq!(xref.get_entry(12).unwrap().generation, 3);
+        assert_eq!(xref.get_entry(5).unwrap().entry_type, PDF_XREF_FREE);
+
+        let ParsedValue::Dict(entries) = trailer else {
+            panic!("expected a dict");
+        };
+        let keys: Vec<&str> = entries.iter().map(|(k, _)| k.as_str()).collect();
+        assert_eq!(keys, ["Size", "Root"]);
+        assert!(matches!(entries[0].1, ParsedValue::Int(100)));
+        assert!(matches!(
+            entries[1].1,
+            ParsedValue::Reference { num: 1, .. }
+        ));
+    }
+
+    #[test]
+    fn test_ffi_repair_loads_objects() {
+        let doc = DOCUMENTS.insert(Document::new(damaged_pdf()));
+        let xref = pdf_repair_xref(0, doc, 0);
+        assert_ne!(xref, 0);
+
+        let mut entry = XrefEntry::new();
+        assert_eq!(pdf_get_xref_entry(0, xref, 99, &mut entry), 1);
+        assert_eq!(entry.entry_type, PDF_XREF_INUSE);
+        assert_eq!(pdf_cache_object(0, xref, 99), 1);
+
+        pdf_drop_xref(0, xref);
+        DOCUMENTS.remove(doc);
+        assert_eq!(pdf_repair_xref(0, doc, 0), 0);
+        assert_eq!(pdf_repair_mapped_file(0, 0, 0), 0);
+    }
+
+    #[test]
+    fn test_no_objects() {
+        assert!(Xref::repair(0, b"%PDF-1.4\nnothing here", 2).is_none());
+        assert!(Xref::repair(0, b"", 2).is_none());
+    }
+}
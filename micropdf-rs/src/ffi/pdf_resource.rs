@@ -3,6 +3,9 @@
 //! Provides PDF resource management including fonts, images, colorspaces,
 //! patterns, shadings, functions, and XObjects.
 
+use crate::ffi::ffi_safety::cstr_to_str;
+use crate::ffi::pdf_object::dict::{dict_key, pdf_dict_get, pdf_dict_gets};
+use crate::ffi::pdf_object::refcount::pdf_drop_obj;
 use crate::ffi::{Handle, HandleStore};
 use std::collections::HashMap;
 use std::ffi::{CStr, CString, c_char, c_void};
@@ -80,6 +83,9 @@ pub struct ResourceStack {
     pub resources: PdfObjHandle,
     /// Next stack entry (parent)
     pub next: Option<Handle>,
+    /// Lookups already made in `resources`, by (type, name): the object
+    /// found, or 0 if the dictionary has none
+    pub lookups: HashMap<(String, String), PdfObjHandle>,
 }
 
 impl Default for ResourceStack {
@@ -90,16 +96,48 @@ impl Default for ResourceStack {
 
 impl ResourceStack {
     pub fn new() -> Self {
-        Self {
-            resources: 0,
-            next: None,
-        }
+        Self::with_resources(0)
     }
 
     pub fn with_resources(resources: PdfObjHandle) -> Self {
         Self {
             resources,
             next: None,
+            lookups: HashMap::new(),
+        }
+    }
+
+    /// The `res_type` resource called `name` in this entry's dictionary,
+    /// resolved once and memoized
+    fn lookup(
+        &mut self,
+        ctx: ContextHandle,
+        res_type: &str,
+        type_obj: PdfObjHandle,
+        name: &str,
+    ) -> PdfObjHandle {
+        if let Some(&obj) = self.lookups.get(&(res_type.to_string(), name.to_string())) {
+            return obj;
+        }
+        let mut obj = 0;
+        let type_dict = pdf_dict_get(ctx, self.resources, type_obj);
+        if type_dict != 0 {
+            if let Ok(name_c) = CString::new(name) {
+                obj = pdf_dict_gets(ctx, type_dict, name_c.as_ptr());
+            }
+            pdf_drop_obj(ctx, type_dict);
+        }
+        self.lookups
+            .insert((res_type.to_string(), name.to_string()), obj);
+        obj
+    }
+
+    /// Drop the objects held by the lookup memo
+    fn release_lookups(&mut self, ctx: ContextHandle) {
+        for (_, obj) in self.lookups.drain() {
+            if obj != 0 {
+                pdf_drop_obj(ctx, obj);
+            }
         }
     }
 }
@@ -542,8 +580,9 @@ pub extern "C" fn pdf_push_resource_stack(
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_pop_resource_stack(_ctx: ContextHandle, stack: Handle) -> Handle {
     if let Some(stack_arc) = RESOURCE_STACKS.get(stack) {
-        let s = stack_arc.lock().unwrap();
+        let mut s = stack_arc.lock().unwrap();
         if let Some(next) = s.next {
+            s.release_lookups(_ctx);
             RESOURCE_STACKS.remove(stack);
             return next;
         }
@@ -554,18 +593,45 @@ pub extern "C" fn pdf_pop_resource_stack(_ctx: ContextHandle, stack: Handle) ->
 /// Drop a resource stack.
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_drop_resource_stack(_ctx: ContextHandle, stack: Handle) {
-    RESOURCE_STACKS.remove(stack);
+    if let Some(stack_arc) = RESOURCE_STACKS.remove(stack) {
+        stack_arc.lock().unwrap().release_lookups(_ctx);
+    }
 }
 
 /// Lookup a resource in the stack.
+///
+/// Searches the `res_type` subdictionary (e.g. /Font) of each entry's
+/// resources, innermost first. Each entry memoizes its lookups, hits and
+/// misses alike, so content that selects the same font or XObject many
+/// times resolves its name once per dictionary; the memo assumes the
+/// resource dictionaries aren't edited while the stack is in use.
+///
+/// # Returns
+/// The resource, borrowed from the stack (valid until its entry is popped
+/// or dropped), or 0 if no entry has it
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_lookup_resource(
-    _ctx: ContextHandle,
-    _stack: Handle,
-    _res_type: PdfObjHandle,
-    _name: *const c_char,
+    ctx: ContextHandle,
+    stack: Handle,
+    res_type: PdfObjHandle,
+    name: *const c_char,
 ) -> PdfObjHandle {
-    // In a full implementation, this would search the resource stack
+    let (Some(type_name), false) = (dict_key(res_type), name.is_null()) else {
+        return 0;
+    };
+    let name = cstr_to_str(name);
+    let mut entry = Some(stack);
+    while let Some(handle) = entry {
+        let Some(stack_arc) = RESOURCE_STACKS.get(handle) else {
+            break;
+        };
+        let mut s = stack_arc.lock().unwrap();
+        let obj = s.lookup(ctx, &type_name, res_type, name);
+        if obj != 0 {
+            return obj;
+        }
+        entry = s.next;
+    }
     0
 }
 
@@ -1035,6 +1101,45 @@ mod tests {
         pdf_drop_resource_stack(ctx, stack);
     }
 
+    #[test]
+    fn test_ffi_lookup_resource_memoizes() {
+        use crate::ffi::pdf_object::create::{pdf_new_dict, pdf_new_int, pdf_new_name};
+        use crate::ffi::pdf_object::dict::pdf_dict_puts;
+        use crate::ffi::pdf_object::extract::pdf_to_int;
+
+        let ctx = 0;
+        let font = pdf_new_name(ctx, c"Font".as_ptr());
+        let resources = |name: &std::ffi::CStr, value: i32| {
+            let fonts = pdf_new_dict(ctx, 0, 1);
+            pdf_dict_puts(ctx, fonts, name.as_ptr(), pdf_new_int(ctx, value as i64));
+            let res = pdf_new_dict(ctx, 0, 1);
+            pdf_dict_puts(ctx, res, c"Font".as_ptr(), fonts);
+            res
+        };
+        let page = pdf_new_resource_stack(ctx, resources(c"F1", 1));
+        let form = pdf_push_resource_stack(ctx, page, resources(c"F2", 2));
+
+        // Inner dictionaries first, then their parents
+        let f2 = pdf_lookup_resource(ctx, form, font, c"F2".as_ptr());
+        let f1 = pdf_lookup_resource(ctx, form, font, c"F1".as_ptr());
+        assert_eq!(pdf_to_int(ctx, f2), 2);
+        assert_eq!(pdf_to_int(ctx, f1), 1);
+        assert_eq!(pdf_lookup_resource(ctx, form, font, c"F3".as_ptr()), 0);
+        assert_eq!(pdf_lookup_resource(ctx, page, font, c"F2".as_ptr()), 0);
+        assert_eq!(pdf_lookup_resource(ctx, form, font, ptr::null()), 0);
+
+        // Repeat lookups return the memoized objects
+        assert_eq!(pdf_lookup_resource(ctx, form, font, c"F2".as_ptr()), f2);
+        assert_eq!(pdf_lookup_resource(ctx, form, font, c"F1".as_ptr()), f1);
+        let s = RESOURCE_STACKS.get(form).unwrap();
+        assert_eq!(s.lock().unwrap().lookups.len(), 3);
+        let s = RESOURCE_STACKS.get(page).unwrap();
+        assert_eq!(s.lock().unwrap().lookups.len(), 3);
+
+        assert_eq!(pdf_pop_resource_stack(ctx, form), page);
+        pdf_drop_resource_stack(ctx, page);
+    }
+
     #[test]
     fn test_ffi_function() {
         let ctx = 0;
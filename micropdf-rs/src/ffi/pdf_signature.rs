@@ -3,7 +3,13 @@
 //! Provides support for PDF digital signatures, including signature
 //! verification, signing, and certificate handling.
 
-use crate::ffi::{Handle, HandleStore};
+use crate::ffi::pdf_object::extract::pdf_to_num;
+use crate::ffi::pdf_signature_digest::check_digests;
+use crate::ffi::pdf_signature_prepare::{
+    Prepared, SignRequest, contents_hex, embed, is_hole, prepare,
+};
+use crate::ffi::pdf_stream_prefetch::parallel_map;
+use crate::ffi::{DOCUMENTS, Handle, HandleStore};
 use std::collections::HashMap;
 use std::ffi::{CStr, CString, c_char};
 use std::ptr;
@@ -328,6 +334,7 @@ pub static VERIFIERS: LazyLock<HandleStore<Pkcs7Verifier>> = LazyLock::new(Handl
 pub static DISTINGUISHED_NAMES: LazyLock<HandleStore<DistinguishedName>> =
     LazyLock::new(HandleStore::new);
 pub static SIGNATURE_INFOS: LazyLock<HandleStore<SignatureInfo>> = LazyLock::new(HandleStore::new);
+pub static PREPARED_SIGNATURES: LazyLock<HandleStore<Prepared>> = LazyLock::new(HandleStore::new);
 
 // Store signatures per document
 pub static DOC_SIGNATURES: LazyLock<Mutex<HashMap<DocumentHandle, Vec<SignatureInfo>>>> =
@@ -441,13 +448,26 @@ pub extern "C" fn pdf_signature_incremental_change_since_signing(
 // ============================================================================
 
 /// Check signature digest.
+///
+/// For a signature field of an opened file, the digest of its ByteRange
+/// is checked against the one it was signed with.
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_check_digest(
-    _ctx: ContextHandle,
+    ctx: ContextHandle,
     verifier: Handle,
     doc: DocumentHandle,
-    _signature: PdfObjHandle,
+    signature: PdfObjHandle,
 ) -> i32 {
+    let num = pdf_to_num(ctx, signature);
+    if num > 0 {
+        let checked = check_digests(doc, 0).unwrap_or_default();
+        if let Some(&(_, _, status)) = checked
+            .iter()
+            .find(|&&(field, value, _)| field == num || value == num)
+        {
+            return status as i32;
+        }
+    }
     let store = DOC_SIGNATURES.lock().unwrap();
     if let Some(sigs) = store.get(&doc) {
         if let Some(sig) = sigs.first() {
@@ -461,6 +481,27 @@ pub extern "C" fn pdf_check_digest(
     SignatureError::NotSigned as i32
 }
 
+/// Check the digest of every signature field of a document in one pass
+/// over the file.
+///
+/// Writes the status of up to `max` signatures, in field tree order, to
+/// `results` and returns how many signature fields there are.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_check_all_digests(
+    _ctx: ContextHandle,
+    doc: DocumentHandle,
+    results: *mut i32,
+    max: i32,
+) -> i32 {
+    let checked = check_digests(doc, 0).unwrap_or_default();
+    if !results.is_null() {
+        for (i, &(_, _, status)) in checked.iter().take(max.max(0) as usize).enumerate() {
+            unsafe { *results.add(i) = status as i32 };
+        }
+    }
+    checked.len() as i32
+}
+
 /// Check signature certificate.
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_check_certificate(
@@ -784,6 +825,219 @@ pub extern "C" fn pdf_signature_set_value(
     }
 }
 
+// ============================================================================
+// FFI Functions - Two-Phase Signing
+// ============================================================================
+
+fn opt_str<'a>(s: *const c_char) -> Option<&'a str> {
+    if s.is_null() {
+        return None;
+    }
+    // SAFETY: caller guarantees a non-null `s` is a C string
+    unsafe { CStr::from_ptr(s) }.to_str().ok()
+}
+
+/// Signer's name and the bytes its blobs need, or defaults for no signer
+fn signer_request(signer: Handle) -> (Option<String>, usize) {
+    match SIGNERS.get(signer) {
+        Some(s) => {
+            let s = s.lock().unwrap();
+            (s.dn.cn.clone(), s.max_digest_size())
+        }
+        None => (None, Pkcs7Signer::new("").max_digest_size()),
+    }
+}
+
+/// Prepare signature field `field` of `doc`, once its number is known
+fn prepare_document(doc: DocumentHandle, request: &SignRequest) -> Option<Prepared> {
+    let document = DOCUMENTS.get(doc)?;
+    let data = document.lock().unwrap().data();
+    let (file, prepared) = prepare(&data, request)?;
+    document.lock().unwrap().replace_data(file);
+    Some(prepared)
+}
+
+/// Phase one of signing a field: append an update giving it a signature
+/// dictionary whose /Contents is left blank for the signer's blob.
+///
+/// Writes the SHA-256 digest of the signed byte ranges (32 bytes) to
+/// `digest`, for the signer to sign. Returns a handle to pass to
+/// `pdf_embed_signature` or `pdf_embed_signature_file` with the blob, or
+/// 0 if the field can't be signed.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_prepare_signature(
+    ctx: ContextHandle,
+    doc: DocumentHandle,
+    field: PdfObjHandle,
+    signer: Handle,
+    date: i64,
+    reason: *const c_char,
+    location: *const c_char,
+    digest: *mut u8,
+) -> Handle {
+    let (name, capacity) = signer_request(signer);
+    let request = SignRequest {
+        field: pdf_to_num(ctx, field),
+        capacity,
+        date,
+        name: name.as_deref(),
+        reason: opt_str(reason),
+        location: opt_str(location),
+    };
+    let Some(prepared) = prepare_document(doc, &request) else {
+        return 0;
+    };
+    if !digest.is_null() {
+        // SAFETY: caller guarantees `digest` holds 32 bytes
+        unsafe { ptr::copy_nonoverlapping(prepared.digest.as_ptr(), digest, 32) };
+    }
+    PREPARED_SIGNATURES.insert(prepared)
+}
+
+/// Prepare field `fields[i]` of each document `docs[i]` for signing by
+/// `signer`, in parallel.
+///
+/// Writes each digest to its 32 bytes of `digests` and each handle to
+/// `prepared` (0 for a field that can't be signed, with its digest
+/// zeroed). Returns how many were prepared.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_prepare_signatures(
+    ctx: ContextHandle,
+    docs: *const DocumentHandle,
+    fields: *const PdfObjHandle,
+    count: i32,
+    signer: Handle,
+    date: i64,
+    digests: *mut u8,
+    prepared: *mut Handle,
+) -> i32 {
+    if docs.is_null() || fields.is_null() || count <= 0 {
+        return 0;
+    }
+    let count = count as usize;
+    // SAFETY: caller guarantees `docs` and `fields` hold `count` handles
+    let docs = unsafe { std::slice::from_raw_parts(docs, count) };
+    let fields = unsafe { std::slice::from_raw_parts(fields, count) };
+    let nums: Vec<i32> = fields.iter().map(|&f| pdf_to_num(ctx, f)).collect();
+    let (name, capacity) = signer_request(signer);
+    let jobs: Vec<(DocumentHandle, i32)> = docs.iter().copied().zip(nums).collect();
+    let results = parallel_map(&jobs, 0, |&(doc, field)| {
+        let request = SignRequest {
+            field,
+            capacity,
+            date,
+            name: name.as_deref(),
+            reason: None,
+            location: None,
+        };
+        prepare_document(doc, &request)
+    });
+
+    let mut done = 0;
+    for (i, result) in results.into_iter().enumerate() {
+        let digest = result.as_ref().map_or([0; 32], |p| p.digest);
+        if !digests.is_null() {
+            // SAFETY: caller guarantees `digests` holds 32 bytes a document
+            unsafe { ptr::copy_nonoverlapping(digest.as_ptr(), digests.add(i * 32), 32) };
+        }
+        let handle = result.map_or(0, |p| {
+            done += 1;
+            PREPARED_SIGNATURES.insert(p)
+        });
+        if !prepared.is_null() {
+            // SAFETY: caller guarantees `prepared` holds `count` handles
+            unsafe { *prepared.add(i) = handle };
+        }
+    }
+    done
+}
+
+fn pkcs7_arg<'a>(pkcs7: *const u8, len: usize) -> Option<&'a [u8]> {
+    // SAFETY: caller guarantees a non-null `pkcs7` holds `len` bytes
+    (!pkcs7.is_null()).then(|| unsafe { std::slice::from_raw_parts(pkcs7, len) })
+}
+
+/// Phase two: write the signer's PKCS#7 blob into the /Contents left
+/// blank in `doc` by `pdf_prepare_signature`.
+///
+/// No other byte of the document changes. Returns 1 on success, or 0 if
+/// the document changed since it was prepared, the blob doesn't fit or
+/// its messageDigest attribute signs other bytes.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_embed_signature(
+    _ctx: ContextHandle,
+    doc: DocumentHandle,
+    prepared: Handle,
+    pkcs7: *const u8,
+    len: usize,
+) -> i32 {
+    let (Some(document), Some(prepared), Some(pkcs7)) = (
+        DOCUMENTS.get(doc),
+        PREPARED_SIGNATURES.get(prepared),
+        pkcs7_arg(pkcs7, len),
+    ) else {
+        return 0;
+    };
+    let prepared = prepared.lock().unwrap();
+    let mut document = document.lock().unwrap();
+    let mut file = document.data().to_vec();
+    if embed(&mut file, &prepared, pkcs7).is_err() {
+        return 0;
+    }
+    document.replace_data(file);
+    1
+}
+
+/// Phase two for a prepared document already saved to `filename`: write
+/// the blob into the file's blank /Contents where it lies.
+///
+/// Only the /Contents digits are written. Returns 1 on success, or 0 if
+/// the file isn't the prepared document or the blob can't be embedded.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_embed_signature_file(
+    _ctx: ContextHandle,
+    prepared: Handle,
+    filename: *const c_char,
+    pkcs7: *const u8,
+    len: usize,
+) -> i32 {
+    use std::io::{Read, Seek, SeekFrom, Write};
+    let (Some(path), Some(prepared), Some(pkcs7)) = (
+        opt_str(filename),
+        PREPARED_SIGNATURES.get(prepared),
+        pkcs7_arg(pkcs7, len),
+    ) else {
+        return 0;
+    };
+    let prepared = prepared.lock().unwrap();
+    let Ok(hex) = contents_hex(&prepared, pkcs7) else {
+        return 0;
+    };
+    let result = std::fs::OpenOptions::new()
+        .read(true)
+        .write(true)
+        .open(path)
+        .and_then(|mut file| {
+            let mut hole = vec![0; prepared.capacity * 2 + 2];
+            file.seek(SeekFrom::Start(prepared.contents as u64 - 1))?;
+            file.read_exact(&mut hole)?;
+            if file.metadata()?.len() != prepared.len as u64 || !is_hole(&prepared, &hole) {
+                return Ok(false);
+            }
+            file.seek(SeekFrom::Start(prepared.contents as u64))?;
+            file.write_all(&hex)?;
+            file.sync_data()?;
+            Ok(true)
+        });
+    i32::from(result.unwrap_or(false))
+}
+
+/// Drop a prepared signature handle.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_drop_prepared_signature(_ctx: ContextHandle, prepared: Handle) {
+    PREPARED_SIGNATURES.remove(prepared);
+}
+
 // ============================================================================
 // FFI Functions - Signature Info Formatting
 // ============================================================================
@@ -1187,4 +1441,63 @@ mod tests {
 
         DISTINGUISHED_NAMES.remove(dn_handle);
     }
+
+    #[test]
+    fn test_prepare_then_embed_in_file() {
+        use crate::ffi::document::Document;
+        use crate::ffi::pdf_image_rewriter::tests::pdf_with;
+        use crate::ffi::pdf_object::create::pdf_new_indirect;
+
+        let data = pdf_with(&[
+            b"<< /Type /Catalog /Pages 2 0 R /AcroForm << /Fields [3 0 R] >> >>".to_vec(),
+            b"<< /Type /Pages /Kids [] /Count 0 >>".to_vec(),
+            b"<< /FT /Sig /T (a) >>".to_vec(),
+        ]);
+        let docs = [
+            DOCUMENTS.insert(Document::new(data.clone())),
+            DOCUMENTS.insert(Document::new(data)),
+        ];
+        let fields = [pdf_new_indirect(0, 0, 3, 0), pdf_new_indirect(0, 0, 2, 0)];
+        let signer = pdf_pkcs7_signer_new(0, c"Signer".as_ptr());
+        let mut digests = [0u8; 64];
+        let mut prepared = [0; 2];
+        let count = pdf_prepare_signatures(
+            0,
+            docs.as_ptr(),
+            fields.as_ptr(),
+            2,
+            signer,
+            0,
+            digests.as_mut_ptr(),
+            prepared.as_mut_ptr(),
+        );
+        assert_eq!(count, 1);
+        assert_ne!(prepared[0], 0);
+        assert_eq!(prepared[1], 0);
+        assert_ne!(digests[..32], [0; 32]);
+
+        let dir = tempfile::tempdir().unwrap();
+        let path = dir.path().join("signed.pdf");
+        let file = DOCUMENTS.get(docs[0]).unwrap().lock().unwrap().data();
+        std::fs::write(&path, &file[..]).unwrap();
+        let c_path = CString::new(path.to_str().unwrap()).unwrap();
+        let blob = [0x30, 0x82, 0x01, 0x00];
+        let embedded =
+            pdf_embed_signature_file(0, prepared[0], c_path.as_ptr(), blob.as_ptr(), blob.len());
+        assert_eq!(embedded, 1);
+        assert_eq!(
+            pdf_embed_signature(0, docs[0], prepared[0], blob.as_ptr(), blob.len()),
+            1
+        );
+        let saved = std::fs::read(&path).unwrap();
+        let patched = DOCUMENTS.get(docs[0]).unwrap().lock().unwrap().data();
+        assert_eq!(saved, &patched[..]);
+        assert_eq!(saved.len(), file.len());
+
+        pdf_drop_prepared_signature(0, prepared[0]);
+        pdf_drop_signer(0, signer);
+        for doc in docs {
+            DOCUMENTS.remove(doc);
+        }
+    }
 }
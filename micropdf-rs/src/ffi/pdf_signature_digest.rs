@@ -0,0 +1,458 @@
+//! Signature Digests
+//!
+//! Checking a signature's digest hashes every byte its ByteRange covers,
+//! which for a document with many incremental signatures is nearly the
+//! whole file once per signature. Here every signature is found up front
+//! and all of their digests are computed in one front-to-back pass over
+//! the document's bytes: the file is cut into windows, and each window is
+//! fed to every signature's hasher on its own thread before the pass moves
+//! on, so each page of a mapped file is read from disk once and hashed
+//! while it is still in cache.
+//!
+//! A digest is checked against the messageDigest attribute of the
+//! signature's PKCS#7 SignedData. This checks the signed bytes are
+//! unchanged, not who signed them. SHA-256, SHA-384 and SHA-512 are
+//! supported; `sha2` picks SHA-NI or other accelerated code at run time
+//! where the CPU has it.
+
+use super::mmap::{AccessPattern, FileBytes};
+use super::pdf_image_rewriter::resolve;
+use super::pdf_parse::ParsedValue;
+use super::pdf_signature::SignatureError;
+use super::pdf_stream_prefetch::parallel_map;
+use super::pdf_write::open_source;
+use super::pdf_xref::Xref;
+use super::pdf_xref_lazy::{as_int, as_ref, dict_get, is_name};
+use super::simd_util::find_bytes;
+use super::{DOCUMENTS, Handle};
+use sha2::{Digest, Sha256, Sha384, Sha512};
+use std::collections::{HashMap, HashSet};
+use std::ops::Range;
+use std::sync::{Arc, LazyLock, Mutex, Weak};
+
+/// Bytes every hasher takes in before the pass moves on
+const WINDOW: usize = 4 << 20;
+
+/// Deepest field tree walked
+const MAX_FIELD_DEPTH: usize = 32;
+
+/// DER of the messageDigest attribute type, 1.2.840.113549.1.9.4
+const MESSAGE_DIGEST: &[u8] = &[
+    0x06, 0x09, 0x2a, 0x86, 0x48, 0x86, 0xf7, 0x0d, 0x01, 0x09, 0x04,
+];
+
+/// DER of the SHA-2 algorithm identifiers, up to their last byte
+const SHA2_PREFIX: &[u8] = &[0x06, 0x09, 0x60, 0x86, 0x48, 0x01, 0x65, 0x03, 0x04, 0x02];
+
+/// Hash algorithms a signature's digest can use
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub(crate) enum Algorithm {
+    Sha256,
+    Sha384,
+    Sha512,
+}
+
+impl Algorithm {
+    /// The algorithm a SHA-2 identifier ending in `last` names
+    fn from_oid(last: u8) -> Option<Self> {
+        match last {
+            1 => Some(Self::Sha256),
+            2 => Some(Self::Sha384),
+            3 => Some(Self::Sha512),
+            _ => None,
+        }
+    }
+
+    /// The algorithm whose digests are `len` bytes
+    fn from_len(len: usize) -> Option<Self> {
+        match len {
+            32 => Some(Self::Sha256),
+            48 => Some(Self::Sha384),
+            64 => Some(Self::Sha512),
+            _ => None,
+        }
+    }
+}
+
+enum Hasher {
+    Sha256(Sha256),
+    Sha384(Sha384),
+    Sha512(Sha512),
+}
+
+impl Hasher {
+    fn new(algorithm: Algorithm) -> Self {
+        match algorithm {
+            Algorithm::Sha256 => Self::Sha256(Sha256::new()),
+            Algorithm::Sha384 => Self::Sha384(Sha384::new()),
+            Algorithm::Sha512 => Self::Sha512(Sha512::new()),
+        }
+    }
+
+    fn update(&mut self, data: &[u8]) {
+        match self {
+            Self::Sha256(h) => h.update(data),
+            Self::Sha384(h) => h.update(data),
+            Self::Sha512(h) => h.update(data),
+        }
+    }
+
+    fn finalize(self) -> Vec<u8> {
+        match self {
+            Self::Sha256(h) => h.finalize().to_vec(),
+            Self::Sha384(h) => h.finalize().to_vec(),
+            Self::Sha512(h) => h.finalize().to_vec(),
+        }
+    }
+}
+
+/// The algorithm and the signed digest in DER PKCS#7 SignedData
+/// `contents`, from its first SHA-2 identifier and its messageDigest
+/// attribute
+pub(crate) fn signed_digest(contents: &[u8]) -> Option<(Algorithm, Vec<u8>)> {
+    let at = find_bytes(contents, MESSAGE_DIGEST)? + MESSAGE_DIGEST.len();
+    // SET { OCTET STRING }, both short enough for one length byte
+    let value = contents.get(at..)?;
+    let (&[0x31, _, 0x04, len], rest) = value.split_first_chunk::<4>()? else {
+        return None;
+    };
+    let digest = rest.get(..usize::from(len))?.to_vec();
+    let named = find_bytes(contents, SHA2_PREFIX)
+        .and_then(|i| contents.get(i + SHA2_PREFIX.len()))
+        .and_then(|&last| Algorithm::from_oid(last));
+    let algorithm = named
+        .filter(|_| Algorithm::from_len(digest.len()) == named)
+        .or_else(|| Algorithm::from_len(digest.len()))?;
+    Some((algorithm, digest))
+}
+
+/// A signature field of the document, and what its digest is checked
+/// against
+struct Signed {
+    /// Object numbers of the field and its signature dictionary
+    field: i32,
+    value: i32,
+    ranges: Option<Vec<Range<usize>>>,
+    digest: Option<(Algorithm, Vec<u8>)>,
+}
+
+/// ByteRange `value` as ranges of a file of `len` bytes; `None` if any
+/// is out of the file
+fn byte_ranges(value: Option<&ParsedValue>, len: usize) -> Option<Vec<Range<usize>>> {
+    let Some(ParsedValue::Array(items)) = value else {
+        return None;
+    };
+    let numbers: Vec<i64> = items.iter().map(as_int).collect::<Option<_>>()?;
+    if numbers.is_empty() || numbers.len() % 2 != 0 {
+        return None;
+    }
+    numbers
+        .chunks_exact(2)
+        .map(|pair| {
+            let start = usize::try_from(pair[0]).ok()?;
+            let end = start.checked_add(usize::try_from(pair[1]).ok()?)?;
+            (end <= len).then_some(start..end)
+        })
+        .collect()
+}
+
+/// Every signed signature field of `xref`, in field tree order
+fn signature_fields(xref: &mut Xref, len: usize) -> Vec<Signed> {
+    let root = xref
+        .source_trailer()
+        .and_then(|t| dict_get(t, "Root"))
+        .cloned();
+    let form = root
+        .and_then(|r| resolve(xref, &r))
+        .and_then(|catalog| dict_get(&catalog, "AcroForm").cloned())
+        .and_then(|f| resolve(xref, &f));
+    let fields = match form
+        .as_ref()
+        .and_then(|f| dict_get(f, "Fields"))
+        .and_then(|f| resolve(xref, f))
+    {
+        Some(ParsedValue::Array(fields)) => fields,
+        _ => return Vec::new(),
+    };
+
+    // (field, inherited FT, depth), walked depth first in order
+    let mut stack: Vec<(ParsedValue, bool, usize)> =
+        fields.into_iter().rev().map(|f| (f, false, 0)).collect();
+    let mut seen = HashSet::new();
+    let mut found = Vec::new();
+    while let Some((field, inherited_sig, depth)) = stack.pop() {
+        let Some(num) = as_ref(&field).filter(|&n| seen.insert(n)) else {
+            continue;
+        };
+        let Some(dict) = resolve(xref, &field) else {
+            continue;
+        };
+        let is_sig = match dict_get(&dict, "FT") {
+            Some(ft) => is_name(Some(ft), "Sig"),
+            None => inherited_sig,
+        };
+        if let Some(ParsedValue::Array(kids)) =
+            dict_get(&dict, "Kids").and_then(|k| resolve(xref, k))
+        {
+            if depth < MAX_FIELD_DEPTH {
+                stack.extend(kids.into_iter().rev().map(|k| (k, is_sig, depth + 1)));
+            }
+        }
+        let Some(v) = dict_get(&dict, "V").filter(|_| is_sig) else {
+            continue;
+        };
+        let value = as_ref(v).unwrap_or(num);
+        let Some(sig) = resolve(xref, v) else {
+            continue;
+        };
+        let digest = match dict_get(&sig, "Contents") {
+            Some(ParsedValue::String(contents)) => signed_digest(contents),
+            _ => None,
+        };
+        found.push(Signed {
+            field: num,
+            value,
+            ranges: byte_ranges(dict_get(&sig, "ByteRange"), len),
+            digest,
+        });
+    }
+    found
+}
+
+/// The digest of `ranges` of `data`, for each job, hashed in one pass on
+/// up to `threads` threads
+///
+/// Each job's ranges must be in ascending order and not overlap.
+fn hash_ranges(data: &[u8], jobs: &[(Algorithm, &[Range<usize>])], threads: usize) -> Vec<Vec<u8>> {
+    let hashers: Vec<Mutex<Hasher>> = jobs
+        .iter()
+        .map(|&(algorithm, _)| Mutex::new(Hasher::new(algorithm)))
+        .collect();
+    let order: Vec<usize> = (0..jobs.len()).collect();
+    let end = jobs
+        .iter()
+        .filter_map(|(_, ranges)| ranges.last())
+        .map(|r| r.end)
+        .max()
+        .unwrap_or(0);
+    for start in (0..end).step_by(WINDOW) {
+        let window = start..(start + WINDOW).min(end);
+        parallel_map(&order, threads, |&i| {
+            let mut hasher = hashers[i].lock().unwrap();
+            for range in jobs[i].1 {
+                let (lo, hi) = (range.start.max(window.start), range.end.min(window.end));
+                if lo < hi {
+                    hasher.update(&data[lo..hi]);
+                }
+            }
+        });
+    }
+    hashers
+        .into_iter()
+        .map(|h| h.into_inner().unwrap().finalize())
+        .collect()
+}
+
+/// The digest status of each signature in `signed`
+fn check(data: &[u8], signed: &[Signed], threads: usize) -> Vec<SignatureError> {
+    let mut status = vec![SignatureError::NotSigned; signed.len()];
+    let mut jobs = Vec::new();
+    let mut owners = Vec::new();
+    for (i, sig) in signed.iter().enumerate() {
+        status[i] = match (&sig.ranges, &sig.digest) {
+            (None, _) => SignatureError::DigestFailure,
+            (Some(_), None) => SignatureError::Unknown,
+            (Some(ranges), Some((algorithm, _))) => {
+                if ranges.windows(2).all(|w| w[0].end <= w[1].start) {
+                    jobs.push((*algorithm, &ranges[..]));
+                    owners.push(i);
+                    continue;
+                }
+                // Ranges out of order don't fit the pass; hash them as
+                // they come
+                let mut hasher = Hasher::new(*algorithm);
+                for range in ranges {
+                    hasher.update(&data[range.clone()]);
+                }
+                verdict(&hasher.finalize(), sig)
+            }
+        };
+    }
+    for (digest, i) in hash_ranges(data, &jobs, threads).into_iter().zip(owners) {
+        status[i] = verdict(&digest, &signed[i]);
+    }
+    status
+}
+
+fn verdict(digest: &[u8], sig: &Signed) -> SignatureError {
+    match &sig.digest {
+        Some((_, signed)) if signed == digest => SignatureError::Okay,
+        _ => SignatureError::DigestFailure,
+    }
+}
+
+/// Digest status of a document's signatures: the data they were checked
+/// against, and (field, signature dictionary, status) by field
+struct Checked {
+    data: Weak<FileBytes>,
+    signatures: Vec<(i32, i32, SignatureError)>,
+}
+
+/// Digest status by document, until its data changes
+static CHECKED: LazyLock<Mutex<HashMap<Handle, Checked>>> =
+    LazyLock::new(|| Mutex::new(HashMap::new()));
+
+/// The digest status of every signature field in document `doc`, as
+/// (field, signature dictionary, status) in field tree order, checked on
+/// `threads` threads; `None` if `doc` isn't an open document
+///
+/// The result is kept until the document's data changes.
+pub(crate) fn check_digests(
+    doc: Handle,
+    threads: usize,
+) -> Option<Vec<(i32, i32, SignatureError)>> {
+    let data = DOCUMENTS.get(doc)?.lock().unwrap().data();
+    if let Some(checked) = CHECKED.lock().unwrap().get(&doc) {
+        if Weak::ptr_eq(&checked.data, &Arc::downgrade(&data)) {
+            return Some(checked.signatures.clone());
+        }
+    }
+
+    let signed = match open_source(&data, threads) {
+        Some(mut xref) => signature_fields(&mut xref, data.len()),
+        None => Vec::new(),
+    };
+    data.advise(AccessPattern::Sequential);
+    let status = check(&data, &signed, threads);
+    data.advise(AccessPattern::Random);
+    let signatures: Vec<_> = signed
+        .iter()
+        .zip(status)
+        .map(|(sig, status)| (sig.field, sig.value, status))
+        .collect();
+    let checked = Checked {
+        data: Arc::downgrade(&data),
+        signatures: signatures.clone(),
+    };
+    CHECKED.lock().unwrap().insert(doc, checked);
+    Some(signatures)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::document::Document;
+    use crate::ffi::pdf_image_rewriter::tests::pdf_with;
+
+    /// A SignedData fragment naming `oid_last` and holding `digest`
+    fn contents(oid_last: u8, digest: &[u8]) -> Vec<u8> {
+        let mut der = vec![0x30, 0x80];
+        der.extend_from_slice(SHA2_PREFIX);
+        der.push(oid_last);
+        der.extend_from_slice(&[0x30, 0x00]);
+        der.extend_from_slice(MESSAGE_DIGEST);
+        der.extend_from_slice(&[0x31, digest.len() as u8 + 2, 0x04, digest.len() as u8]);
+        der.extend_from_slice(digest);
+        der.resize(der.len() + 16, 0);
+        der
+    }
+
+    fn hex(bytes: &[u8]) -> String {
+        bytes.iter().map(|b| format!("{b:02x}")).collect()
+    }
+
+    #[test]
+    fn test_signed_digest() {
+        let digest = [7u8; 48];
+        assert_eq!(
+            signed_digest(&contents(2, &digest)),
+            Some((Algorithm::Sha384, digest.to_vec()))
+        );
+        // A named algorithm that doesn't fit the digest gives way to its
+        // length
+        assert_eq!(
+            signed_digest(&contents(1, &[1; 64])).map(|d| d.0),
+            Some(Algorithm::Sha512)
+        );
+        assert_eq!(signed_digest(&[0x30, 0x00]), None);
+    }
+
+    #[test]
+    fn test_hash_ranges_in_windows() {
+        let data: Vec<u8> = (0..WINDOW * 2 + 100).map(|i| i as u8).collect();
+        let whole = [0..data.len()];
+        let split = [10..WINDOW - 5, WINDOW + 7..WINDOW * 2 + 50];
+        let jobs = [
+            (Algorithm::Sha256, &whole[..]),
+            (Algorithm::Sha384, &split[..]),
+        ];
+        let digests = hash_ranges(&data, &jobs, 2);
+        assert_eq!(digests[0], Sha256::digest(&data).to_vec());
+        let mut expected = Sha384::new();
+        for range in &split {
+            expected.update(&data[range.clone()]);
+        }
+        assert_eq!(digests[1], expected.finalize().to_vec());
+    }
+
+    #[test]
+    fn test_check_digests_of_every_signature() {
+        // Each signature covers everything but its Contents; where they are
+        // is only known once the file is laid out, so the ranges and
+        // digests are patched in after
+        let placeholder = |n: u8| format!("<{}>", hex(&[n; 120]));
+        let sig = |n: u8| {
+            format!(
+                "<< /Type /Sig /ByteRange [0000000000 0000000000 0000000000 0000000000] \
+                 /Contents {} >>",
+                placeholder(n)
+            )
+            .into_bytes()
+        };
+        let mut data = pdf_with(&[
+            b"<< /Type /Catalog /Pages 2 0 R /AcroForm << /Fields [4 0 R 5 0 R] >> >>".to_vec(),
+            b"<< /Type /Pages /Kids [] /Count 0 >>".to_vec(),
+            b"<< /Type /Page >>".to_vec(),
+            b"<< /FT /Sig /T (a) /V 6 0 R >>".to_vec(),
+            b"<< /FT /Sig /T (b) /V 7 0 R >>".to_vec(),
+            sig(1),
+            sig(2),
+        ]);
+        let mut spans = Vec::new();
+        for n in [1u8, 2] {
+            let text = String::from_utf8_lossy(&data).into_owned();
+            let at = text.find(&placeholder(n)).unwrap();
+            let end = at + placeholder(n).len();
+            let ranges = format!("{:010} {:010} {:010} {:010}", 0, at, end, data.len() - end);
+            let range_at = text[..at].rfind("/ByteRange [").unwrap() + 12;
+            data[range_at..range_at + ranges.len()].copy_from_slice(ranges.as_bytes());
+            spans.push((at, end));
+        }
+        // The second covers the first's Contents, so it is signed first
+        // and tampered with
+        for (&(at, end), tamper) in spans.iter().zip([false, true]).rev() {
+            let mut hasher = Sha256::new();
+            hasher.update(&data[..at]);
+            hasher.update(&data[end..]);
+            let mut digest = hasher.finalize().to_vec();
+            if tamper {
+                digest[0] ^= 1;
+            }
+            let der = hex(&contents(1, &digest));
+            data[at + 1..at + 1 + der.len()].copy_from_slice(der.as_bytes());
+        }
+
+        let doc = DOCUMENTS.insert(Document::new(data));
+        let checked = check_digests(doc, 2).unwrap();
+        assert_eq!(
+            checked,
+            [
+                (4, 6, SignatureError::Okay),
+                (5, 7, SignatureError::DigestFailure)
+            ]
+        );
+        assert_eq!(check_digests(doc, 1).unwrap(), checked);
+        DOCUMENTS.remove(doc);
+        assert!(check_digests(doc, 1).is_none());
+    }
+}
@@ -0,0 +1,339 @@
+//! Two-Phase Signing
+//!
+//! Signing through an HSM means waiting on it for every document, and
+//! rewriting each file around the blob it sends back. Here signing is
+//! split in two. Preparing appends an update holding the field's new
+//! signature dictionary, with a zeroed /Contents of fixed size, fills in
+//! its /ByteRange and returns the SHA-256 digest of the ranged bytes.
+//! Embedding then writes the PKCS#7 blob into the zeroed /Contents, in
+//! memory or straight into the saved file, and touches no other byte, so
+//! digests for a whole batch can go to the HSM at once and come back in
+//! any order.
+
+use super::mmap::FileBytes;
+use super::pdf_incremental::finish_update;
+use super::pdf_parse::ParsedValue;
+use super::pdf_signature_digest::signed_digest;
+use super::pdf_write::{Counting, set_key, write_value};
+use super::pdf_xref::Xref;
+use super::pdf_xref_lazy::{as_int, dict_get, is_name};
+use super::simd_util::find_bytes;
+use sha2::{Digest, Sha256};
+use std::sync::Arc;
+
+/// Deepest /Parent chain searched for a field's type
+const MAX_FIELD_DEPTH: usize = 32;
+
+/// Width of each patched /ByteRange number
+const RANGE_DIGITS: usize = 10;
+
+/// What a prepared signature dictionary says
+pub(crate) struct SignRequest<'a> {
+    /// Object number of the signature field
+    pub(crate) field: i32,
+    /// Bytes reserved for the PKCS#7 blob
+    pub(crate) capacity: usize,
+    /// Signing time, in seconds since the Unix epoch
+    pub(crate) date: i64,
+    pub(crate) name: Option<&'a str>,
+    pub(crate) reason: Option<&'a str>,
+    pub(crate) location: Option<&'a str>,
+}
+
+/// Where a prepared document's blob goes, and what it must sign
+#[derive(Debug, Clone)]
+pub struct Prepared {
+    /// Length of the prepared file
+    pub len: usize,
+    /// Offset of the first hex digit of /Contents
+    pub contents: usize,
+    /// Bytes the hex digits hold
+    pub capacity: usize,
+    /// SHA-256 digest of the bytes /ByteRange covers
+    pub digest: [u8; 32],
+}
+
+/// Why a blob can't be embedded
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum EmbedError {
+    /// The bytes aren't the file the signature was prepared in
+    NotPrepared,
+    /// The blob is larger than the space reserved for it
+    TooLarge,
+    /// The blob's messageDigest attribute signs other bytes
+    WrongDigest,
+}
+
+/// PDF date string for `secs` since the Unix epoch, in UTC
+fn pdf_date(secs: i64) -> String {
+    let (days, rem) = (secs.div_euclid(86_400), secs.rem_euclid(86_400));
+    // Civil date from days since 1970-01-01, after Howard Hinnant
+    let z = days + 719_468;
+    let era = z.div_euclid(146_097);
+    let doe = z.rem_euclid(146_097);
+    let yoe = (doe - doe / 1460 + doe / 36_524 - doe / 146_096) / 365;
+    let doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    let mp = (5 * doy + 2) / 153;
+    let day = doy - (153 * mp + 2) / 5 + 1;
+    let month = if mp < 10 { mp + 3 } else { mp - 9 };
+    let year = yoe + era * 400 + i64::from(month <= 2);
+    format!(
+        "D:{year:04}{month:02}{day:02}{:02}{:02}{:02}Z",
+        rem / 3600,
+        rem / 60 % 60,
+        rem % 60
+    )
+}
+
+/// Whether field `num` of `xref`, or the nearest parent giving a type, is
+/// a signature field; also its value and generation
+fn signature_field(xref: &mut Xref, num: i32) -> Option<(ParsedValue, u16)> {
+    let generation = xref.get_entry(num).map_or(0, |e| e.generation);
+    let field = xref.fetch(num)?.value;
+    let mut dict = field.clone();
+    for _ in 0..MAX_FIELD_DEPTH {
+        if let Some(ft) = dict_get(&dict, "FT") {
+            return is_name(Some(ft), "Sig").then_some((field, generation));
+        }
+        let parent = match dict_get(&dict, "Parent") {
+            Some(ParsedValue::Reference { num, .. }) => *num,
+            _ => return None,
+        };
+        dict = xref.fetch(parent)?.value;
+    }
+    None
+}
+
+/// Signature dictionary object `num` for `request`, with a blank
+/// /ByteRange and zeroed /Contents
+fn signature_object(num: i32, request: &SignRequest) -> Vec<u8> {
+    let blank = format!("{:0width$}", 0, width = RANGE_DIGITS);
+    let mut out = format!(
+        "{num} 0 obj\n<< /Type /Sig /Filter /Adobe.PPKLite /SubFilter /adbe.pkcs7.detached \
+         /ByteRange [{blank} {blank} {blank} {blank}] /Contents <"
+    )
+    .into_bytes();
+    out.resize(out.len() + request.capacity * 2, b'0');
+    out.extend_from_slice(b"> /M ");
+    write_value(
+        &ParsedValue::String(pdf_date(request.date).into_bytes()),
+        &mut out,
+    );
+    for (key, value) in [
+        ("Name", request.name),
+        ("Reason", request.reason),
+        ("Location", request.location),
+    ] {
+        if let Some(value) = value {
+            out.extend_from_slice(format!(" /{key} ").as_bytes());
+            write_value(&ParsedValue::String(value.as_bytes().to_vec()), &mut out);
+        }
+    }
+    out.extend_from_slice(b" >>\nendobj\n");
+    out
+}
+
+/// `data` with an update signing `request.field` appended, and where its
+/// blob goes
+///
+/// `None` if the field isn't a signature field, the document is encrypted
+/// or the file has no xref section for the update to chain to.
+pub(crate) fn prepare(data: &Arc<FileBytes>, request: &SignRequest) -> Option<(Vec<u8>, Prepared)> {
+    let mut xref = Xref::open_lazy(0, Arc::clone(data))?;
+    let trailer = xref.source_trailer()?.clone();
+    let prev = xref.source.as_ref()?.newest_section()?;
+    if dict_get(&trailer, "Encrypt").is_some() || request.capacity == 0 {
+        return None;
+    }
+    let (mut field, generation) = signature_field(&mut xref, request.field)?;
+    let size = dict_get(&trailer, "Size")
+        .and_then(as_int)
+        .unwrap_or(0)
+        .max(i64::from(xref.num_objects));
+    let num = i32::try_from(size).ok()?;
+    set_key(
+        &mut field,
+        "V",
+        Some(ParsedValue::Reference { num, generation: 0 }),
+    );
+
+    let mut file = data.to_vec();
+    file.reserve(request.capacity * 2 + 4096);
+    let mut out = Counting {
+        pos: file.len(),
+        inner: &mut file,
+    };
+    if !matches!(data.last(), Some(b'\n' | b'\r')) {
+        out.put(b"\n").ok()?;
+    }
+    let field_at = out.pos;
+    let mut buf = format!("{} {generation} obj\n", request.field).into_bytes();
+    write_value(&field, &mut buf);
+    buf.extend_from_slice(b"\nendobj\n");
+    out.put(&buf).ok()?;
+    let sig_at = out.pos;
+    let sig = signature_object(num, request);
+    out.put(&sig).ok()?;
+    let entries = [
+        (request.field, Some(field_at), generation),
+        (num, Some(sig_at), 0),
+    ];
+    finish_update(&mut out, &trailer, prev, size + 1, &entries).ok()?;
+
+    let open = sig_at + find_bytes(&sig, b"/Contents <")? + b"/Contents ".len();
+    let close = open + request.capacity * 2 + 2;
+    let ranges = format!(
+        "{:0w$} {:0w$} {:0w$} {:0w$}",
+        0,
+        open,
+        close,
+        file.len() - close,
+        w = RANGE_DIGITS
+    );
+    let range_at = sig_at + find_bytes(&sig, b"/ByteRange [")? + b"/ByteRange [".len();
+    file[range_at..range_at + ranges.len()].copy_from_slice(ranges.as_bytes());
+
+    let mut hasher = Sha256::new();
+    hasher.update(&file[..open]);
+    hasher.update(&file[close..]);
+    let prepared = Prepared {
+        len: file.len(),
+        contents: open + 1,
+        capacity: request.capacity,
+        digest: hasher.finalize().into(),
+    };
+    Some((file, prepared))
+}
+
+/// The hex digits `pkcs7` is written as in `prepared`'s /Contents, zero
+/// padded to fill it
+pub(crate) fn contents_hex(prepared: &Prepared, pkcs7: &[u8]) -> Result<Vec<u8>, EmbedError> {
+    if pkcs7.len() > prepared.capacity {
+        return Err(EmbedError::TooLarge);
+    }
+    if let Some((_, digest)) = signed_digest(pkcs7) {
+        if digest != prepared.digest {
+            return Err(EmbedError::WrongDigest);
+        }
+    }
+    const HEX: &[u8; 16] = b"0123456789abcdef";
+    let mut hex = Vec::with_capacity(prepared.capacity * 2);
+    for &b in pkcs7 {
+        hex.extend_from_slice(&[HEX[usize::from(b >> 4)], HEX[usize::from(b & 15)]]);
+    }
+    hex.resize(prepared.capacity * 2, b'0');
+    Ok(hex)
+}
+
+/// Whether `hole`, the bytes from just before `prepared`'s /Contents to
+/// just after, still delimits it
+pub(crate) fn is_hole(prepared: &Prepared, hole: &[u8]) -> bool {
+    hole.len() == prepared.capacity * 2 + 2
+        && hole.first() == Some(&b'<')
+        && hole.last() == Some(&b'>')
+        && hole[1..hole.len() - 1].iter().all(u8::is_ascii_hexdigit)
+}
+
+/// Write `pkcs7` into `prepared`'s /Contents of `file`
+pub(crate) fn embed(file: &mut [u8], prepared: &Prepared, pkcs7: &[u8]) -> Result<(), EmbedError> {
+    let hole = prepared.contents - 1..prepared.contents + prepared.capacity * 2 + 1;
+    if file.len() != prepared.len || !is_hole(prepared, &file[hole]) {
+        return Err(EmbedError::NotPrepared);
+    }
+    let hex = contents_hex(prepared, pkcs7)?;
+    file[prepared.contents..prepared.contents + hex.len()].copy_from_slice(&hex);
+    Ok(())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::pdf_image_rewriter::tests::pdf_with;
+    use crate::ffi::pdf_xref_lazy::{as_ref, tests::sample_pdf};
+
+    fn doc() -> Arc<FileBytes> {
+        Arc::new(
+            pdf_with(&[
+                b"<< /Type /Catalog /Pages 2 0 R /AcroForm << /Fields [3 0 R] >> >>".to_vec(),
+                b"<< /Type /Pages /Kids [] /Count 0 >>".to_vec(),
+                b"<< /FT /Sig /T (a) >>".to_vec(),
+            ])
+            .into(),
+        )
+    }
+
+    fn request(field: i32) -> SignRequest<'static> {
+        SignRequest {
+            field,
+            capacity: 64,
+            date: 1_700_000_000,
+            name: Some("A (B)"),
+            reason: Some("Approved"),
+            location: None,
+        }
+    }
+
+    #[test]
+    fn test_pdf_date() {
+        assert_eq!(pdf_date(0), "D:19700101000000Z");
+        assert_eq!(pdf_date(1_700_000_000), "D:20231114221320Z");
+        assert_eq!(pdf_date(951_825_600), "D:20000229120000Z");
+    }
+
+    #[test]
+    fn test_prepare_appends_ranged_signature() {
+        let data = doc();
+        let (file, prepared) = prepare(&data, &request(3)).unwrap();
+        assert_eq!(&file[..data.len()], &data[..]);
+        assert_eq!(prepared.len, file.len());
+
+        let mut xref = Xref::open_lazy(0, Arc::new(file.clone().into())).unwrap();
+        let field = xref.fetch(3).unwrap().value;
+        let sig = xref.fetch(as_ref(dict_get(&field, "V").unwrap()).unwrap());
+        let sig = sig.unwrap().value;
+        assert!(is_name(dict_get(&sig, "Type"), "Sig"));
+        let Some(ParsedValue::Array(ranges)) = dict_get(&sig, "ByteRange") else {
+            panic!("no /ByteRange");
+        };
+        let ranges: Vec<usize> = ranges.iter().map(|r| as_int(r).unwrap() as usize).collect();
+        assert_eq!(ranges[0], 0);
+        assert_eq!(ranges[1], prepared.contents - 1);
+        assert_eq!(ranges[2] + ranges[3], file.len());
+        let mut hasher = Sha256::new();
+        hasher.update(&file[..ranges[1]]);
+        hasher.update(&file[ranges[2]..]);
+        assert_eq!(prepared.digest[..], hasher.finalize()[..]);
+
+        // A field that isn't for signatures can't be signed
+        let data = Arc::new(sample_pdf().into());
+        assert!(prepare(&data, &request(4)).is_none());
+    }
+
+    #[test]
+    fn test_embed_patches_only_contents() {
+        let (mut file, prepared) = prepare(&doc(), &request(3)).unwrap();
+        let before = file.clone();
+        embed(&mut file, &prepared, &[0xab, 0x01]).unwrap();
+        let hole = prepared.contents..prepared.contents + prepared.capacity * 2;
+        assert_eq!(&file[hole.clone()][..4], b"ab01");
+        assert_eq!(file[..hole.start], before[..hole.start]);
+        assert_eq!(file[hole.end..], before[hole.end..]);
+        let mut xref = Xref::open_lazy(0, Arc::new(file.clone().into())).unwrap();
+        let num = as_ref(dict_get(&xref.fetch(3).unwrap().value, "V").unwrap()).unwrap();
+        let Some(ParsedValue::String(contents)) =
+            dict_get(&xref.fetch(num).unwrap().value, "Contents").cloned()
+        else {
+            panic!("no /Contents");
+        };
+        assert_eq!(&contents[..2], &[0xab, 0x01]);
+
+        assert_eq!(
+            embed(&mut file, &prepared, &[0; 65]),
+            Err(EmbedError::TooLarge)
+        );
+        assert_eq!(
+            embed(&mut file[1..], &prepared, &[0; 2]),
+            Err(EmbedError::NotPrepared)
+        );
+    }
+}
@@ -0,0 +1,388 @@
+//! Parallel Stream Prefetch
+//!
+//! Decompressing a page's content streams one after another keeps a
+//! single core busy while the interpreter waits. The raw bytes are cheap
+//! to read from the file, so they are fetched first and the filter chains
+//! then run on a pool of threads; the decoded buffers land in the xref's
+//! stream cache before interpretation asks for them. Object streams are
+//! decompressed the same way ahead of passes that visit every object.
+
+use super::buffer::Buffer;
+use super::pdf_parse::ParsedValue;
+use super::pdf_xref::{PDF_XREF_OBJSTM, XREFS, Xref};
+use super::pdf_xref_lazy::{ObjStm, as_ref, decode_stream, dict_get};
+use super::{BUFFERS, Handle};
+use std::collections::HashSet;
+use std::sync::Mutex;
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+/// Threads to use for a requested count (0 = one per core)
+pub(crate) fn resolve_threads(threads: usize) -> usize {
+    match threads {
+        0 => std::thread::available_parallelism().map_or(1, |n| n.get()),
+        n => n,
+    }
+}
+
+/// Run `f` over `items` on up to `threads` threads (0 = one per core),
+/// keeping results in item order
+pub(crate) fn parallel_map<T: Sync, R: Send>(
+    items: &[T],
+    threads: usize,
+    f: impl Fn(&T) -> R + Sync,
+) -> Vec<R> {
+    let threads = resolve_threads(threads).min(items.len());
+    if threads <= 1 {
+        return items.iter().map(f).collect();
+    }
+
+    let next = AtomicUsize::new(0);
+    let results: Vec<Mutex<Option<R>>> = items.iter().map(|_| Mutex::new(None)).collect();
+    std::thread::scope(|scope| {
+        for _ in 0..threads {
+            scope.spawn(|| {
+                loop {
+                    let i = next.fetch_add(1, Ordering::Relaxed);
+                    let Some(item) = items.get(i) else {
+                        break;
+                    };
+                    *results[i].lock().unwrap() = Some(f(item));
+                }
+            });
+        }
+    });
+    results
+        .into_iter()
+        .map(|r| r.into_inner().unwrap().expect("every item is mapped"))
+        .collect()
+}
+
+/// References in `value`, which is either a reference or an array of them
+fn ref_list(value: Option<&ParsedValue>) -> Vec<i32> {
+    match value {
+        Some(ParsedValue::Array(items)) => items.iter().filter_map(as_ref).collect(),
+        Some(v) => as_ref(v).into_iter().collect(),
+        None => Vec::new(),
+    }
+}
+
+impl Xref {
+    /// `value`, or the object it refers to
+    fn resolve(&mut self, value: Option<&ParsedValue>) -> Option<ParsedValue> {
+        match value? {
+            ParsedValue::Reference { num, .. } => self.load_value(*num),
+            v => Some(v.clone()),
+        }
+    }
+
+    /// Decode streams `nums` in parallel into the stream cache
+    ///
+    /// Streams already cached, and those with image codecs, are skipped.
+    /// Returns how many were decoded.
+    pub fn prefetch_streams(&mut self, nums: &[i32], threads: usize) -> i32 {
+        let mut seen = HashSet::new();
+        let mut raw = Vec::new();
+        for &num in nums {
+            if !seen.insert(num) || self.stream_cache.contains_key(&num) {
+                continue;
+            }
+            if let Some((value, Some(data))) = self.fetch(num).map(|f| (f.value, f.stream)) {
+                raw.push((num, value, data));
+            }
+        }
+
+        let decoded = parallel_map(&raw, threads, |(_, dict, data)| decode_stream(dict, data));
+
+        let mut count = 0;
+        for ((num, _, _), data) in raw.iter().zip(decoded) {
+            let (Some(data), Some(entry)) = (data, self.get_entry_mut(*num)) else {
+                continue;
+            };
+            entry.has_stm_buf = 1;
+            let buffer = BUFFERS.insert(Buffer::from_vec(data));
+            self.stream_cache.insert(*num, buffer);
+            if let Some(source) = self.source.as_mut() {
+                source.prefetched.push(buffer);
+            }
+            count += 1;
+        }
+        count
+    }
+
+    /// Decode the content streams of page `index`, and of the form
+    /// XObjects it uses, in parallel
+    ///
+    /// Returns how many streams were decoded, or `None` if the page
+    /// doesn't exist.
+    pub fn prefetch_page_streams(&mut self, index: i32, threads: usize) -> Option<i32> {
+        let page_num = self.lazy_page_object(index)?;
+        let page = self.load_value(page_num)?;
+
+        let mut nums = match dict_get(&page, "Contents") {
+            Some(ParsedValue::Reference { num, .. }) => match self.load_value(*num) {
+                Some(ParsedValue::Array(items)) => items.iter().filter_map(as_ref).collect(),
+                _ => vec![*num],
+            },
+            contents => ref_list(contents),
+        };
+
+        let resources = self.resolve(dict_get(&page, "Resources"));
+        let xobjects = resources.and_then(|r| self.resolve(dict_get(&r, "XObject")));
+        if let Some(ParsedValue::Dict(entries)) = xobjects {
+            for (_, value) in &entries {
+                let Some(num) = as_ref(value) else {
+                    continue;
+                };
+                let is_form = self.load_value(num).is_some_and(|x| {
+                    matches!(dict_get(&x, "Subtype"), Some(ParsedValue::Name(n)) if n == "Form")
+                });
+                if is_form {
+                    nums.push(num);
+                }
+            }
+        }
+
+        Some(self.prefetch_streams(&nums, threads))
+    }
+
+    /// Decompress every object stream not decompressed yet, in parallel
+    ///
+    /// Reads all remaining xref sections first. Returns how many object
+    /// streams were decoded.
+    pub fn prefetch_objstms(&mut self, threads: usize) -> i32 {
+        if !self.is_lazy() {
+            return 0;
+        }
+        self.read_all_sections();
+
+        let mut seen = HashSet::new();
+        let objstm_nums: Vec<i32> = self
+            .subsections
+            .iter()
+            .flat_map(|s| &s.entries)
+            .filter(|e| e.entry_type == PDF_XREF_OBJSTM)
+            .map(|e| e.offset as i32)
+            .filter(|&num| seen.insert(num))
+            .collect();
+        let mut raw = Vec::new();
+        for num in objstm_nums {
+            if self.has_objstm(num) {
+                continue;
+            }
+            if let Some((value, Some(data))) = self.fetch(num).map(|f| (f.value, f.stream)) {
+                raw.push((num, value, data));
+            }
+        }
+
+        let decoded = parallel_map(&raw, threads, |(_, dict, data)| ObjStm::decode(dict, data));
+
+        let mut count = 0;
+        for ((num, _, _), objstm) in raw.iter().zip(decoded) {
+            if let Some(objstm) = objstm {
+                self.insert_objstm(*num, objstm);
+                count += 1;
+            }
+        }
+        count
+    }
+}
+
+// ============================================================================
+// FFI Functions
+// ============================================================================
+
+fn thread_count(threads: i32) -> usize {
+    usize::try_from(threads).unwrap_or(0)
+}
+
+/// Decode `count` streams listed in `nums` in parallel into the stream
+/// cache, so `pdf_get_stream_buffer` finds them decoded
+///
+/// `threads` of 0 uses one thread per core. Returns how many streams were
+/// decoded.
+///
+/// # Safety
+/// `nums` must point to `count` readable object numbers.
+#[unsafe(no_mangle)]
+pub unsafe extern "C" fn pdf_xref_prefetch_streams(
+    _ctx: Handle,
+    xref: Handle,
+    nums: *const i32,
+    count: i32,
+    threads: i32,
+) -> i32 {
+    if nums.is_null() || count <= 0 {
+        return 0;
+    }
+    let Some(x) = XREFS.get(xref) else {
+        return 0;
+    };
+    // SAFETY: caller guarantees `nums` points to `count` i32s
+    let nums = unsafe { std::slice::from_raw_parts(nums, count as usize) };
+    x.lock()
+        .unwrap()
+        .prefetch_streams(nums, thread_count(threads))
+}
+
+/// Decode page `index`'s content streams and form XObjects in parallel
+///
+/// Returns how many streams were decoded, or -1 if the page doesn't exist.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_xref_prefetch_page_streams(
+    _ctx: Handle,
+    xref: Handle,
+    index: i32,
+    threads: i32,
+) -> i32 {
+    let Some(x) = XREFS.get(xref) else {
+        return -1;
+    };
+    x.lock()
+        .unwrap()
+        .prefetch_page_streams(index, thread_count(threads))
+        .unwrap_or(-1)
+}
+
+/// Decompress every object stream in parallel, ahead of a pass over all
+/// objects
+///
+/// Returns how many object streams were decoded.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_xref_prefetch_objstms(_ctx: Handle, xref: Handle, threads: i32) -> i32 {
+    let Some(x) = XREFS.get(xref) else {
+        return 0;
+    };
+    x.lock().unwrap().prefetch_objstms(thread_count(threads))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::super::pdf_xref::pdf_get_stream_buffer;
+    use super::super::pdf_xref_lazy::tests::sample_pdf;
+    use super::*;
+    use crate::pdf::filter::encode_flate;
+    use std::sync::Arc;
+
+    /// One page whose contents are three Flate streams, using a form
+    /// XObject and an image XObject
+    fn multi_stream_pdf() -> Vec<u8> {
+        let mut pdf = b"%PDF-1.4\n".to_vec();
+        let mut offsets = vec![0];
+        let mut add = |pdf: &mut Vec<u8>, body: &[u8]| {
+            offsets.push(pdf.len());
+            pdf.extend_from_slice(format!("{} 0 obj\n", offsets.len() - 1).as_bytes());
+            pdf.extend_from_slice(body);
+            pdf.extend_from_slice(b"\nendobj\n");
+        };
+        let stream = |dict: &str, data: &[u8]| {
+            let packed = encode_flate(data, 6).unwrap();
+            let mut body = format!(
+                "<< {dict} /Length {} /Filter /FlateDecode >>\nstream\n",
+                packed.len()
+            )
+            .into_bytes();
+            body.extend_from_slice(&packed);
+            body.extend_from_slice(b"\nendstream");
+            body
+        };
+        add(&mut pdf, b"<< /Type /Catalog /Pages 2 0 R >>");
+        add(&mut pdf, b"<< /Type /Pages /Kids [3 0 R] /Count 1 >>");
+        add(
+            &mut pdf,
+            b"<< /Type /Page /Parent 2 0 R /Contents 4 0 R /Resources << /XObject << /Fm0 8 0 R /Im0 9 0 R >> >> >>",
+        );
+        add(&mut pdf, b"[5 0 R 6 0 R 7 0 R]");
+        add(&mut pdf, &stream("", b"q 1 0 0 1 0 0 cm"));
+        add(&mut pdf, &stream("", b"/Fm0 Do /Im0 Do"));
+        add(&mut pdf, &stream("", b"Q"));
+        add(
+            &mut pdf,
+            &stream("/Type /XObject /Subtype /Form", b"0 0 10 10 re f"),
+        );
+        add(
+            &mut pdf,
+            b"<< /Type /XObject /Subtype /Image /Length 2 /Filter /DCTDecode >>\nstream\n\xff\xd8\nendstream",
+        );
+
+        let table = pdf.len();
+        pdf.extend_from_slice(
+            format!("xref\n0 {}\n0000000000 65535 f \n", offsets.len()).as_bytes(),
+        );
+        for offset in &offsets[1..] {
+            pdf.extend_from_slice(format!("{offset:010} 00000 n \n").as_bytes());
+        }
+        pdf.extend_from_slice(
+            format!(
+                "trailer\n<< /Size {} /Root 1 0 R >>\nstartxref\n{table}\n%%EOF\n",
+                offsets.len()
+            )
+            .as_bytes(),
+        );
+        pdf
+    }
+
+    fn cached(xref: &Xref, num: i32) -> Vec<u8> {
+        let buffer = xref.stream_cache[&num];
+        BUFFERS.get(buffer).unwrap().lock().unwrap().data().to_vec()
+    }
+
+    #[test]
+    fn test_parallel_map_keeps_order() {
+        let items: Vec<usize> = (0..100).collect();
+        for threads in [0, 1, 3, 200] {
+            assert_eq!(
+                parallel_map(&items, threads, |i| i * 2),
+                (0..200).step_by(2).collect::<Vec<_>>()
+            );
+        }
+        assert!(parallel_map(&[] as &[usize], 4, |i| *i).is_empty());
+    }
+
+    #[test]
+    fn test_page_streams_decoded_into_cache() {
+        let mut xref = Xref::open_lazy(0, Arc::new(multi_stream_pdf().into())).unwrap();
+        // Three content streams and the form; the image is left alone
+        assert_eq!(xref.prefetch_page_streams(0, 4), Some(4));
+        assert_eq!(cached(&xref, 5), b"q 1 0 0 1 0 0 cm");
+        assert_eq!(cached(&xref, 6), b"/Fm0 Do /Im0 Do");
+        assert_eq!(cached(&xref, 7), b"Q");
+        assert_eq!(cached(&xref, 8), b"0 0 10 10 re f");
+        assert!(!xref.stream_cache.contains_key(&9));
+        assert_eq!(xref.get_entry(5).unwrap().has_stm_buf, 1);
+
+        // Already cached streams aren't decoded again
+        assert_eq!(xref.prefetch_page_streams(0, 4), Some(0));
+        assert_eq!(xref.prefetch_page_streams(1, 4), None);
+    }
+
+    #[test]
+    fn test_prefetch_through_ffi() {
+        let xref = XREFS.insert(Xref::open_lazy(0, Arc::new(multi_stream_pdf().into())).unwrap());
+        let nums = [6, 6, 7, 42];
+        let decoded = unsafe { pdf_xref_prefetch_streams(0, xref, nums.as_ptr(), 4, 2) };
+        assert_eq!(decoded, 2);
+        let buffer = pdf_get_stream_buffer(0, xref, 7);
+        assert!(BUFFERS.get(buffer).is_some());
+        assert_eq!(pdf_xref_prefetch_page_streams(0, xref, 0, 0), 2);
+        assert_eq!(pdf_xref_prefetch_page_streams(0, xref, 3, 0), -1);
+
+        // Prefetched buffers belong to the xref
+        super::super::pdf_xref::pdf_drop_xref(0, xref);
+        assert!(BUFFERS.get(buffer).is_none());
+    }
+
+    #[test]
+    fn test_objstms_decoded_ahead() {
+        let mut xref = Xref::open_lazy(0, Arc::new(sample_pdf().into())).unwrap();
+        assert_eq!(xref.prefetch_objstms(2), 1);
+        let stats = xref.lazy_stats().unwrap();
+        assert_eq!(stats.objstms_decoded, 1);
+        assert_eq!(stats.sections_read, 2);
+
+        // Members now load without decoding the object stream again
+        assert!(xref.load_value(7).is_some());
+        assert!(xref.load_value(10).is_some());
+        assert_eq!(xref.lazy_stats().unwrap().objstms_decoded, 1);
+        assert_eq!(xref.prefetch_objstms(2), 0);
+    }
+}
@@ -0,0 +1,547 @@
+//! Structure Tree Extraction
+//!
+//! Reading a tagged PDF's structure through the `fz_tree_*` calls takes
+//! several calls per element and leaves its marked content unresolved.
+//! Here the `/StructTreeRoot` is walked once, serially, into a list of
+//! elements in pre-order, each holding its kids in order: child elements
+//! and the marked content (by page and MCID) it owns. The pages that
+//! content is on are then read on a pool of threads. Each page's content
+//! is lexed once, and every glyph shown inside a sequence with an MCID is
+//! measured the way `pdf_redact_search` measures them, which gives each
+//! MCID its text and bounds.
+//!
+//! An element's text is its kids' text in order, so it holds the text of
+//! all its descendants, unless an `/ActualText` replaces it. Its bounds
+//! are those of its content on its own page. Marked content inside form
+//! XObjects, and object references (`OBJR`), are not followed.
+
+use super::pdf_form_fill::text_string;
+use super::pdf_image_rewriter::{inherited, resolve};
+use super::pdf_page_tree::PageIndex;
+use super::pdf_parse::{ParsedValue, PdfParser};
+use super::pdf_redact_engine::{FontMetrics, TextWalk, adjustment, page_fonts, shown};
+use super::pdf_redact_search::SPACE_GAP;
+use super::pdf_stream_prefetch::parallel_map;
+use super::pdf_vectorize::{operators, string};
+use super::pdf_write::open_source;
+use super::pdf_xref::Xref;
+use super::pdf_xref_lazy::{as_int, as_ref, decode_stream, dict_get, is_name};
+use super::tree::{FzStructureRecord, StructureType};
+use crate::ffi::{DOCUMENTS, Handle};
+use crate::fitz::geometry::Rect;
+use bytes::Bytes;
+use std::collections::{BTreeSet, HashMap, HashSet};
+use std::sync::Arc;
+
+/// Elements nested deeper than this are not read
+const MAX_STRUCT_DEPTH: usize = 256;
+
+/// RoleMap entries followed from a custom type to a standard one
+const MAX_ROLE_HOPS: usize = 8;
+
+/// What an element holds, in order
+enum Kid {
+    /// Marked content: page index and MCID
+    Marked(usize, i64),
+    /// Another element, by index
+    Element(usize),
+}
+
+/// A structure element as read from the tree
+struct Element {
+    struct_type: StructureType,
+    parent: i32,
+    page: Option<usize>,
+    actual_text: Option<String>,
+    kids: Vec<Kid>,
+}
+
+/// Reads the structure tree into elements in pre-order
+struct TreeReader<'a> {
+    index: &'a PageIndex,
+    roles: HashMap<String, String>,
+    elements: Vec<Element>,
+    seen: HashSet<i32>,
+}
+
+impl TreeReader<'_> {
+    /// The standard type `name` is, or maps to through the RoleMap
+    fn struct_type(&self, mut name: &str) -> StructureType {
+        for _ in 0..MAX_ROLE_HOPS {
+            match StructureType::from_name(name) {
+                StructureType::Unknown => match self.roles.get(name) {
+                    Some(role) => name = role,
+                    None => break,
+                },
+                found => return found,
+            }
+        }
+        StructureType::Unknown
+    }
+
+    /// The index of the page `dict`'s `/Pg` refers to
+    fn page(&self, dict: &ParsedValue) -> Option<usize> {
+        dict_get(dict, "Pg")
+            .and_then(as_ref)
+            .and_then(|num| self.index.page_number(num))
+    }
+
+    /// Read element `dict` (object `num`, if indirect), a child of
+    /// `parent` whose content is on `page` unless it says otherwise, with
+    /// its descendants; its index, or None if it was already read
+    fn element(
+        &mut self,
+        xref: &mut Xref,
+        num: Option<i32>,
+        dict: &ParsedValue,
+        parent: i32,
+        page: Option<usize>,
+        depth: usize,
+    ) -> Option<usize> {
+        if depth > MAX_STRUCT_DEPTH || num.is_some_and(|num| !self.seen.insert(num)) {
+            return None;
+        }
+        let struct_type = match dict_get(dict, "S") {
+            Some(ParsedValue::Name(name)) => self.struct_type(name),
+            _ => StructureType::Unknown,
+        };
+        let page = self.page(dict).or(page);
+        let actual_text = match dict_get(dict, "ActualText").and_then(|t| resolve(xref, t)) {
+            Some(ParsedValue::String(bytes)) => Some(text_string(&bytes)),
+            _ => None,
+        };
+        let at = self.elements.len();
+        self.elements.push(Element {
+            struct_type,
+            parent,
+            page,
+            actual_text,
+            kids: Vec::new(),
+        });
+
+        let kids = match dict_get(dict, "K") {
+            Some(ParsedValue::Array(items)) => items.clone(),
+            Some(kid) => match resolve(xref, kid) {
+                Some(ParsedValue::Array(items)) => items,
+                _ => vec![kid.clone()],
+            },
+            None => Vec::new(),
+        };
+        for kid in &kids {
+            if let Some(mcid) = as_int(kid) {
+                if let Some(page) = page {
+                    self.elements[at].kids.push(Kid::Marked(page, mcid));
+                }
+                continue;
+            }
+            let Some(kid_dict) = resolve(xref, kid) else {
+                continue;
+            };
+            let kind = dict_get(&kid_dict, "Type");
+            if is_name(kind, "MCR") {
+                let marked = self.page(&kid_dict).or(page).zip(
+                    dict_get(&kid_dict, "MCID")
+                        .and_then(as_int)
+                        .filter(|_| dict_get(&kid_dict, "Stm").is_none()),
+                );
+                if let Some((page, mcid)) = marked {
+                    self.elements[at].kids.push(Kid::Marked(page, mcid));
+                }
+            } else if !is_name(kind, "OBJR") {
+                let child = self.element(xref, as_ref(kid), &kid_dict, at as i32, page, depth + 1);
+                if let Some(child) = child {
+                    self.elements[at].kids.push(Kid::Element(child));
+                }
+            }
+        }
+        Some(at)
+    }
+}
+
+/// What one page needs for its marked content to be measured
+struct PageJob {
+    page: usize,
+    streams: Vec<(ParsedValue, Bytes)>,
+    fonts: HashMap<String, Arc<FontMetrics>>,
+    /// MCIDs of the property lists `/Properties` names
+    properties: HashMap<String, i64>,
+}
+
+/// The text and bounds of one MCID's content
+struct Marked {
+    text: String,
+    bbox: Rect,
+    /// Box of the last glyph that had text
+    last: Option<Rect>,
+}
+
+impl Marked {
+    fn new() -> Self {
+        Self {
+            text: String::new(),
+            bbox: Rect::EMPTY,
+            last: None,
+        }
+    }
+
+    /// Add a glyph standing for `chars`, assuming a space where it leaves
+    /// the line or starts well past the one before
+    fn push(&mut self, chars: &[u32], bbox: Rect) {
+        if let Some(prev) = self.last {
+            let height = prev.height().max(bbox.height());
+            let breaks = (bbox.y0 - prev.y0).abs() > height / 2.0 || bbox.x1 < prev.x0;
+            if (breaks || bbox.x0 - prev.x1 > height * SPACE_GAP) && !self.text.ends_with(' ') {
+                self.text.push(' ');
+            }
+        }
+        self.text
+            .extend(chars.iter().filter_map(|&c| char::from_u32(c)));
+        self.bbox = self.bbox.union(&bbox);
+        self.last = Some(bbox);
+    }
+}
+
+/// The MCID of the property list a BDC operator is given as `token`,
+/// inline or by its name in `/Properties`
+fn marked_mcid(token: &[u8], properties: &HashMap<String, i64>) -> Option<i64> {
+    match token.first()? {
+        b'<' => {
+            let dict = PdfParser::new(token.to_vec()).parse_value()?;
+            dict_get(&dict, "MCID").and_then(as_int)
+        }
+        b'/' => properties
+            .get(std::str::from_utf8(&token[1..]).ok()?)
+            .copied(),
+        _ => None,
+    }
+}
+
+/// The text and bounds of every MCID's content on `job`'s page
+fn marked_content(job: &PageJob) -> HashMap<i64, Marked> {
+    let mut content = Vec::new();
+    for (dict, raw) in &job.streams {
+        if let Some(data) = decode_stream(dict, raw) {
+            content.extend_from_slice(&data);
+        }
+        content.push(b'\n');
+    }
+    let data = &content[..];
+    let mut marked = HashMap::new();
+    // The MCID of each open marked-content sequence that has one
+    let mut open: Vec<Option<i64>> = Vec::new();
+    let mut walk = TextWalk::new();
+    let mut chars = Vec::new();
+    for op in operators(data) {
+        match op.name {
+            b"BMC" => open.push(None),
+            b"BDC" => {
+                // The property list runs from the second operand to the last
+                let mcid = match (op.operands.get(1), op.operands.last()) {
+                    (Some(&(s, _)), Some(&(_, e))) => marked_mcid(&data[s..e], &job.properties),
+                    _ => None,
+                };
+                open.push(mcid);
+            }
+            b"EMC" => {
+                open.pop();
+            }
+            _ => {}
+        }
+        if walk.step(data, &op, &job.fonts) || !matches!(op.name, b"Tj" | b"'" | b"\"" | b"TJ") {
+            continue;
+        }
+        let Some(font) = walk.state.font.clone() else {
+            continue;
+        };
+        let mcid = open.iter().rev().find_map(|&m| m);
+        for &span in shown(&op) {
+            let Some(bytes) = string(data, span) else {
+                if let Some(adjust) = adjustment(data, span) {
+                    walk.kern(adjust);
+                }
+                continue;
+            };
+            // Glyphs outside marked content still move the text matrix
+            let glyphs = walk.state.glyphs(&bytes, &mut walk.tm);
+            let Some(mcid) = mcid else {
+                continue;
+            };
+            let entry = marked.entry(mcid).or_insert_with(Marked::new);
+            for glyph in glyphs {
+                chars.clear();
+                font.text(glyph.code, &mut chars);
+                if !chars.is_empty() {
+                    entry.push(&chars, glyph.bbox);
+                }
+            }
+        }
+    }
+    marked
+}
+
+/// Read what the marked content on page `page` needs to be measured
+fn page_job(
+    xref: &mut Xref,
+    index: &PageIndex,
+    page: usize,
+    loaded: &mut HashMap<i32, Arc<FontMetrics>>,
+) -> Option<PageJob> {
+    let num = index.page(page)?.num;
+    let page_dict = xref.fetch(num)?.value;
+    let contents = dict_get(&page_dict, "Contents");
+    let nums: Vec<i32> = match contents.and_then(|c| resolve(xref, c)) {
+        Some(ParsedValue::Array(items)) => items.iter().filter_map(as_ref).collect(),
+        _ => contents.and_then(as_ref).into_iter().collect(),
+    };
+    let streams = nums
+        .iter()
+        .filter_map(|&num| {
+            let fetched = xref.fetch(num)?;
+            Some((fetched.value, fetched.stream?))
+        })
+        .collect();
+    let resources = inherited(xref, num, "Resources").unwrap_or(ParsedValue::Null);
+    let fonts = page_fonts(xref, &resources, loaded);
+    let mut properties = HashMap::new();
+    if let Some(ParsedValue::Dict(entries)) =
+        dict_get(&resources, "Properties").and_then(|d| resolve(xref, d))
+    {
+        for (name, value) in entries {
+            let list = resolve(xref, &value);
+            if let Some(mcid) = list
+                .as_ref()
+                .and_then(|l| dict_get(l, "MCID"))
+                .and_then(as_int)
+            {
+                properties.insert(name, mcid);
+            }
+        }
+    }
+    Some(PageJob {
+        page,
+        streams,
+        fonts,
+        properties,
+    })
+}
+
+/// Lays the elements out as records, with the text they index
+struct Flattener<'a> {
+    elements: &'a [Element],
+    marked: &'a HashMap<usize, HashMap<i64, Marked>>,
+    records: Vec<FzStructureRecord>,
+    text: String,
+}
+
+impl Flattener<'_> {
+    /// Append a piece of text, with a space after it unless it ends in one
+    fn append(&mut self, text: &str) {
+        self.text.push_str(text);
+        if !text.is_empty() && !text.ends_with(char::is_whitespace) {
+            self.text.push(' ');
+        }
+    }
+
+    /// Fill in element `at`'s record, and its descendants', leaving their
+    /// text out if `quiet`; the page and bounds of its content
+    fn flatten(&mut self, at: usize, quiet: bool) -> (Option<usize>, Rect) {
+        let (elements, marked) = (self.elements, self.marked);
+        let element = &elements[at];
+        let start = self.text.len();
+        if let (false, Some(text)) = (quiet, &element.actual_text) {
+            self.append(text);
+        }
+        let quiet = quiet || element.actual_text.is_some();
+        let mut page = element.page;
+        let mut bbox = Rect::EMPTY;
+        for kid in &element.kids {
+            let (kid_page, kid_box) = match *kid {
+                Kid::Marked(p, mcid) => match marked.get(&p).and_then(|m| m.get(&mcid)) {
+                    Some(content) => {
+                        if !quiet {
+                            self.append(&content.text);
+                        }
+                        (Some(p), content.bbox)
+                    }
+                    None => continue,
+                },
+                Kid::Element(child) => self.flatten(child, quiet),
+            };
+            page = page.or(kid_page);
+            if kid_page.is_some() && kid_page == page {
+                bbox = bbox.union(&kid_box);
+            }
+        }
+        let end = self.text.trim_end().len().max(start);
+        self.records[at] = FzStructureRecord {
+            struct_type: element.struct_type as i32,
+            parent: element.parent,
+            page: page.map_or(-1, |p| p as i32),
+            bbox: if bbox.is_empty() {
+                [0.0; 4]
+            } else {
+                [bbox.x0, bbox.y0, bbox.x1, bbox.y1]
+            },
+            text_offset: start as u32,
+            text_length: (end - start) as u32,
+        };
+        (page, bbox)
+    }
+}
+
+/// The structure tree of document `doc`, flattened in pre-order with its
+/// `/StructTreeRoot` as a Document record first, and the text the records
+/// index; pages are measured on up to `threads` threads (0 = one per core)
+///
+/// Returns `None` if the document has no structure tree, or is encrypted.
+pub(crate) fn extract(doc: Handle, threads: usize) -> Option<(Vec<FzStructureRecord>, String)> {
+    let data = DOCUMENTS.get(doc)?.lock().ok()?.data();
+    let mut xref = open_source(&data, threads)?;
+    xref.read_all_sections();
+    let trailer = xref
+        .source_trailer()
+        .filter(|t| dict_get(t, "Encrypt").is_none())?
+        .clone();
+    let catalog = dict_get(&trailer, "Root").and_then(|r| resolve(&mut xref, r))?;
+    let root_ref = dict_get(&catalog, "StructTreeRoot")?;
+    let root = resolve(&mut xref, root_ref)?;
+    let index = PageIndex::read(&mut xref, threads)?;
+
+    let mut roles = HashMap::new();
+    if let Some(ParsedValue::Dict(entries)) =
+        dict_get(&root, "RoleMap").and_then(|m| resolve(&mut xref, m))
+    {
+        for (name, role) in entries {
+            if let ParsedValue::Name(role) = role {
+                roles.insert(name, role);
+            }
+        }
+    }
+    let mut reader = TreeReader {
+        index: &index,
+        roles,
+        elements: Vec::new(),
+        seen: HashSet::new(),
+    };
+    reader.element(&mut xref, as_ref(root_ref), &root, -1, None, 0)?;
+    let mut elements = reader.elements;
+    elements[0].struct_type = StructureType::Document;
+
+    let pages: BTreeSet<usize> = elements
+        .iter()
+        .flat_map(|e| &e.kids)
+        .filter_map(|kid| match *kid {
+            Kid::Marked(page, _) => Some(page),
+            Kid::Element(_) => None,
+        })
+        .collect();
+    let mut loaded = HashMap::new();
+    let jobs: Vec<PageJob> = pages
+        .into_iter()
+        .filter_map(|page| page_job(&mut xref, &index, page, &mut loaded))
+        .collect();
+    let measured = parallel_map(&jobs, threads, marked_content);
+    let marked: HashMap<usize, HashMap<i64, Marked>> =
+        jobs.iter().map(|job| job.page).zip(measured).collect();
+
+    let mut flat = Flattener {
+        elements: &elements,
+        marked: &marked,
+        records: vec![FzStructureRecord::default(); elements.len()],
+        text: String::new(),
+    };
+    flat.flatten(0, false);
+    let mut text = flat.text;
+    text.truncate(text.trim_end().len());
+    Some((flat.records, text))
+}
+
+#[cfg(test)]
+pub(crate) mod tests {
+    use super::*;
+    use crate::ffi::document::Document;
+    use crate::ffi::pdf_image_rewriter::tests::{pdf_with, stream};
+
+    /// A two-page tagged document: a heading and a paragraph running onto
+    /// the second page, then a figure with actual text
+    pub(crate) fn tagged_pdf() -> Vec<u8> {
+        pdf_with(&[
+            b"<< /Type /Catalog /Pages 2 0 R /StructTreeRoot 6 0 R \
+               /MarkInfo << /Marked true >> >>"
+                .to_vec(),
+            b"<< /Type /Pages /Kids [3 0 R 4 0 R] /Count 2 >>".to_vec(),
+            b"<< /Type /Page /Parent 2 0 R /Contents 5 0 R \
+               /Resources << /Font << /F1 9 0 R >> /Properties << /MC1 << /MCID 1 >> >> >> >>"
+                .to_vec(),
+            b"<< /Type /Page /Parent 2 0 R /Contents 10 0 R \
+               /Resources << /Font << /F1 9 0 R >> >> >>"
+                .to_vec(),
+            stream(
+                "",
+                b"/Heading << /MCID 0 >> BDC BT /F1 10 Tf 0 0 Td (AB) Tj ET EMC \
+                  /P /MC1 BDC BT /F1 10 Tf 0 -20 Td (CD) Tj ET EMC \
+                  BT /F1 10 Tf 0 -40 Td (untagged) Tj ET",
+            ),
+            b"<< /Type /StructTreeRoot /K [7 0 R] /RoleMap << /Heading /H1 >> >>".to_vec(),
+            b"<< /Type /StructElem /S /Document /P 6 0 R /K [8 0 R 11 0 R 12 0 R] >>".to_vec(),
+            b"<< /Type /StructElem /S /Heading /P 7 0 R /Pg 3 0 R /K 0 >>".to_vec(),
+            b"<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>".to_vec(),
+            stream(
+                "",
+                b"/P << /MCID 0 >> BDC BT /F1 10 Tf 0 0 Td (EF) Tj ET EMC",
+            ),
+            b"<< /Type /StructElem /S /P /P 7 0 R /Pg 3 0 R \
+               /K [1 << /Type /MCR /Pg 4 0 R /MCID 0 >>] >>"
+                .to_vec(),
+            b"<< /Type /StructElem /S /Figure /P 7 0 R /Pg 3 0 R /ActualText (A chart) \
+               /K << /Type /OBJR /Obj 9 0 R >> >>"
+                .to_vec(),
+        ])
+    }
+
+    #[test]
+    fn test_extract_flattens_in_pre_order() {
+        let doc = DOCUMENTS.insert(Document::new(tagged_pdf()));
+        let (records, text) = extract(doc, 1).unwrap();
+        assert_eq!(text, "AB CD EF A chart");
+        let text_of = |r: &FzStructureRecord| {
+            &text[r.text_offset as usize..(r.text_offset + r.text_length) as usize]
+        };
+        let summary: Vec<_> = records
+            .iter()
+            .map(|r| (r.struct_type, r.parent, r.page, text_of(r)))
+            .collect();
+        assert_eq!(
+            summary,
+            [
+                (StructureType::Document as i32, -1, 0, "AB CD EF A chart"),
+                (StructureType::Document as i32, 0, 0, "AB CD EF A chart"),
+                (StructureType::H1 as i32, 1, 0, "AB"),
+                (StructureType::P as i32, 1, 0, "CD EF"),
+                (StructureType::Figure as i32, 1, 0, "A chart"),
+            ]
+        );
+        // Half an em a glyph, from the descent to the ascent; only the
+        // paragraph's content on its own page counts toward its box
+        assert_eq!(records[2].bbox, [0.0, -2.0, 10.0, 8.0]);
+        assert_eq!(records[3].bbox, [0.0, -22.0, 10.0, -12.0]);
+        assert_eq!(records[4].bbox, [0.0; 4]);
+        DOCUMENTS.remove(doc);
+    }
+
+    #[test]
+    fn test_extract_is_the_same_on_any_thread_count() {
+        let doc = DOCUMENTS.insert(Document::new(tagged_pdf()));
+        let serial = extract(doc, 1).unwrap();
+        assert_eq!(extract(doc, 4).unwrap(), serial);
+        DOCUMENTS.remove(doc);
+
+        let untagged = pdf_with(&[
+            b"<< /Type /Catalog /Pages 2 0 R >>".to_vec(),
+            b"<< /Type /Pages /Kids [] /Count 0 >>".to_vec(),
+        ]);
+        let doc = DOCUMENTS.insert(Document::new(untagged));
+        assert!(extract(doc, 1).is_none());
+        DOCUMENTS.remove(doc);
+    }
+}
@@ -0,0 +1,833 @@
+//! Font Subsetting
+//!
+//! Embedded TrueType CID fonts are cut down to the glyphs the document
+//! shows. The content streams of the pages, their forms, tiling patterns
+//! and annotation appearances are scanned on a pool of threads for the
+//! strings shown in each font, and the glyph sets are merged in stream
+//! order. Then each font program is closed over its composite glyphs and
+//! rebuilt on the pool, and the results are written back in object
+//! order, so the output doesn't depend on the thread count.
+//!
+//! Glyph ids are kept: dropped glyphs are left empty, so content streams,
+//! widths and CIDToGIDMaps stay valid as they are. Only Type0 fonts with
+//! an Identity encoding over a CIDFontType2 with a FontFile2 are subset.
+//! A font program that a font of any other kind also uses is left whole,
+//! and nothing is subset if a string is shown before any font is
+//! selected, since its glyphs can't be told.
+
+use super::pdf_image_rewriter::{MAX_RESOURCE_DEPTH, inherited, resolve};
+use super::pdf_optimize::{inline_image_end, is_space, token_end};
+use super::pdf_parse::{ParsedValue, PdfParser};
+use super::pdf_stream_prefetch::parallel_map;
+use super::pdf_write::{Edits, WriteSettings, open_source, set_key, write_opened};
+use super::pdf_xref::Xref;
+use super::pdf_xref_lazy::{as_ref, decode_stream, dict_get, is_name};
+use crate::ffi::{DOCUMENTS, Handle};
+use crate::pdf::filter::encode_flate;
+use bytes::Bytes;
+use std::borrow::Cow;
+use std::collections::{BTreeMap, HashMap, HashSet};
+use std::sync::Arc;
+
+// Composite glyph component flags
+const ARG_1_AND_2_ARE_WORDS: u16 = 0x0001;
+const WE_HAVE_A_SCALE: u16 = 0x0008;
+const MORE_COMPONENTS: u16 = 0x0020;
+const WE_HAVE_AN_X_AND_Y_SCALE: u16 = 0x0040;
+const WE_HAVE_A_TWO_BY_TWO: u16 = 0x0080;
+
+/// How a font resource turns shown strings into glyphs
+#[derive(Debug, Clone)]
+enum FontUse {
+    /// Two-byte CIDs, through a CIDToGIDMap (`None` for Identity), into
+    /// the font program in object `file`
+    Cid {
+        file: i32,
+        gids: Option<Arc<Vec<u16>>>,
+    },
+    /// Any other font; its strings don't matter
+    Other,
+}
+
+/// A content stream with the fonts its resources name
+struct TextStream {
+    dict: ParsedValue,
+    raw: Bytes,
+    fonts: Arc<HashMap<String, FontUse>>,
+}
+
+/// The glyphs one content stream shows, by font program
+#[derive(Default)]
+struct Shown {
+    glyphs: Vec<(i32, Vec<u16>)>,
+    /// A string was shown with no font selected, or the stream can't be read
+    blind: bool,
+}
+
+/// The font programs met, and whether each must be left whole
+#[derive(Default)]
+struct FontScan {
+    /// Font object number to how it is used and its program
+    fonts: HashMap<i32, (FontUse, Option<i32>)>,
+    files: BTreeMap<i32, bool>,
+}
+
+fn parse(token: &[u8]) -> Option<ParsedValue> {
+    PdfParser::new(token.to_vec()).parse_value()
+}
+
+/// Call `show` with every string the text operators in content stream
+/// `data` show, and the resource name of the font selected for it
+pub(crate) fn scan_text(data: &[u8], mut show: impl FnMut(Option<&str>, &[u8])) {
+    let mut font: Option<String> = None;
+    let mut saved = Vec::new();
+    // Spans of the operands read since the last operator
+    let mut operands: Vec<(usize, usize)> = Vec::new();
+    let mut i = 0;
+
+    while i < data.len() {
+        let b = data[i];
+        if is_space(b) {
+            i += 1;
+            continue;
+        }
+        if b == b'%' {
+            while i < data.len() && !matches!(data[i], b'\r' | b'\n') {
+                i += 1;
+            }
+            continue;
+        }
+        let start = i;
+        i = token_end(data, i);
+        let token = &data[start..i];
+        if !token[0].is_ascii_alphabetic() && !matches!(b, b'\'' | b'"' | b'*')
+            || matches!(token, b"true" | b"false" | b"null")
+        {
+            operands.push((start, i));
+            continue;
+        }
+        match token {
+            b"Tf" => {
+                font = match operands.first().and_then(|&(s, e)| parse(&data[s..e])) {
+                    Some(ParsedValue::Name(name)) => Some(name),
+                    _ => None,
+                };
+            }
+            b"Tj" | b"TJ" | b"'" | b"\"" => {
+                for &(s, e) in &operands {
+                    let string =
+                        data[s] == b'(' || data[s] == b'<' && data.get(s + 1) != Some(&b'<');
+                    if let Some(ParsedValue::String(bytes)) =
+                        string.then(|| parse(&data[s..e])).flatten()
+                    {
+                        show(font.as_deref(), &bytes);
+                    }
+                }
+            }
+            b"q" => saved.push(font.clone()),
+            b"Q" => {
+                if let Some(outer) = saved.pop() {
+                    font = outer;
+                }
+            }
+            b"ID" => i = inline_image_end(data, (i + 1).min(data.len())),
+            _ => {}
+        }
+        operands.clear();
+    }
+}
+
+/// How `font` shows glyphs, and the number of its TrueType program
+fn classify(xref: &mut Xref, font: &ParsedValue) -> (FontUse, Option<i32>) {
+    let descendant = if is_name(dict_get(font, "Subtype"), "Type0") {
+        match dict_get(font, "DescendantFonts").and_then(|d| resolve(xref, d)) {
+            Some(ParsedValue::Array(items)) => items.first().and_then(|d| resolve(xref, d)),
+            _ => None,
+        }
+    } else {
+        None
+    };
+    let program = descendant.as_ref().unwrap_or(font);
+    let file = dict_get(program, "FontDescriptor")
+        .and_then(|d| resolve(xref, d))
+        .and_then(|d| dict_get(&d, "FontFile2").and_then(as_ref));
+    let Some(file) = file else {
+        return (FontUse::Other, None);
+    };
+    let identity = is_name(dict_get(font, "Encoding"), "Identity-H")
+        || is_name(dict_get(font, "Encoding"), "Identity-V");
+    let Some(descendant) =
+        descendant.filter(|d| identity && is_name(dict_get(d, "Subtype"), "CIDFontType2"))
+    else {
+        return (FontUse::Other, Some(file));
+    };
+
+    let gids = match dict_get(&descendant, "CIDToGIDMap") {
+        None => None,
+        Some(map) if is_name(Some(map), "Identity") => None,
+        Some(map) => {
+            let map = as_ref(map)
+                .and_then(|num| xref.fetch(num))
+                .and_then(|f| decode_stream(&f.value, f.stream.as_ref()?));
+            let Some(map) = map else {
+                return (FontUse::Other, Some(file));
+            };
+            let gids = map
+                .chunks_exact(2)
+                .map(|pair| u16::from_be_bytes([pair[0], pair[1]]))
+                .collect();
+            Some(Arc::new(gids))
+        }
+    };
+    (FontUse::Cid { file, gids }, Some(file))
+}
+
+impl FontScan {
+    /// The fonts `resources` names, noting the programs they use
+    fn font_uses(&mut self, xref: &mut Xref, resources: &ParsedValue) -> HashMap<String, FontUse> {
+        let Some(ParsedValue::Dict(entries)) =
+            dict_get(resources, "Font").and_then(|d| resolve(xref, d))
+        else {
+            return HashMap::new();
+        };
+        let mut uses = HashMap::new();
+        for (name, value) in entries {
+            let classified = match as_ref(&value) {
+                Some(num) => match self.fonts.get(&num) {
+                    Some(found) => found.clone(),
+                    None => {
+                        let found = match xref.fetch(num) {
+                            Some(font) => classify(xref, &font.value),
+                            None => (FontUse::Other, None),
+                        };
+                        self.fonts.insert(num, found.clone());
+                        found
+                    }
+                },
+                None => classify(xref, &value),
+            };
+            match classified {
+                (FontUse::Other, Some(file)) => {
+                    self.files.insert(file, true);
+                }
+                (_, Some(file)) => {
+                    self.files.entry(file).or_insert(false);
+                }
+                _ => {}
+            }
+            uses.insert(name, classified.0);
+        }
+        uses
+    }
+}
+
+/// The forms and tiling patterns `resources` names
+fn form_refs(xref: &mut Xref, resources: &ParsedValue) -> Vec<i32> {
+    let mut nums = Vec::new();
+    for key in ["XObject", "Pattern"] {
+        if let Some(ParsedValue::Dict(entries)) =
+            dict_get(resources, key).and_then(|d| resolve(xref, d))
+        {
+            nums.extend(entries.iter().filter_map(|(_, v)| as_ref(v)));
+        }
+    }
+    nums
+}
+
+/// The appearance streams of the annotations on `page`
+fn appearance_refs(xref: &mut Xref, page: &ParsedValue) -> Vec<i32> {
+    let Some(ParsedValue::Array(annots)) = dict_get(page, "Annots").and_then(|a| resolve(xref, a))
+    else {
+        return Vec::new();
+    };
+    let mut nums = Vec::new();
+    for annot in annots {
+        let normal = resolve(xref, &annot)
+            .and_then(|a| dict_get(&a, "AP").and_then(|ap| resolve(xref, ap)))
+            .and_then(|ap| dict_get(&ap, "N").cloned());
+        match normal {
+            Some(ParsedValue::Reference { num, .. }) => {
+                // Either the stream or a dictionary of appearance states
+                match xref.fetch(num) {
+                    Some(f) if f.stream.is_none() => {
+                        if let ParsedValue::Dict(states) = f.value {
+                            nums.extend(states.iter().filter_map(|(_, v)| as_ref(v)));
+                        }
+                    }
+                    Some(_) => nums.push(num),
+                    None => {}
+                }
+            }
+            Some(ParsedValue::Dict(states)) => {
+                nums.extend(states.iter().filter_map(|(_, v)| as_ref(v)));
+            }
+            _ => {}
+        }
+    }
+    nums
+}
+
+/// Every content stream `pages` draw, directly or through forms, patterns
+/// and annotation appearances, once each, with the fonts it can use
+fn collect_streams(xref: &mut Xref, pages: &[i32], scan: &mut FontScan) -> Vec<TextStream> {
+    let mut found = Vec::new();
+    let mut seen = HashSet::new();
+
+    for &page in pages {
+        let Some(page_dict) = xref.fetch(page).map(|p| p.value) else {
+            continue;
+        };
+        let resources = inherited(xref, page, "Resources").unwrap_or(ParsedValue::Dict(Vec::new()));
+        let fonts = Arc::new(scan.font_uses(xref, &resources));
+        let nums: Vec<i32> = match dict_get(&page_dict, "Contents") {
+            Some(ParsedValue::Array(items)) => items.iter().filter_map(as_ref).collect(),
+            Some(value) => as_ref(value).into_iter().collect(),
+            None => Vec::new(),
+        };
+        for num in nums {
+            let Some(fetched) = seen.insert(num).then(|| xref.fetch(num)).flatten() else {
+                continue;
+            };
+            if let Some(raw) = fetched.stream {
+                found.push(TextStream {
+                    dict: fetched.value,
+                    raw,
+                    fonts: Arc::clone(&fonts),
+                });
+            }
+        }
+
+        // Forms to scan, with the resources and fonts of what draws them;
+        // appearance streams need no Subtype and have no parent resources
+        let empty = (ParsedValue::Dict(Vec::new()), Arc::new(HashMap::new()));
+        let mut stack: Vec<(i32, ParsedValue, Arc<HashMap<String, FontUse>>, usize, bool)> =
+            appearance_refs(xref, &page_dict)
+                .into_iter()
+                .map(|num| (num, empty.0.clone(), Arc::clone(&empty.1), 0, true))
+                .collect();
+        stack.extend(
+            form_refs(xref, &resources)
+                .into_iter()
+                .map(|num| (num, resources.clone(), Arc::clone(&fonts), 0, false)),
+        );
+        while let Some((num, parent, parent_fonts, depth, appearance)) = stack.pop() {
+            let Some(fetched) = seen.insert(num).then(|| xref.fetch(num)).flatten() else {
+                continue;
+            };
+            let value = fetched.value;
+            let form = appearance
+                || is_name(dict_get(&value, "Subtype"), "Form")
+                || matches!(dict_get(&value, "PatternType"), Some(ParsedValue::Int(1)));
+            let Some(raw) = fetched.stream.filter(|_| form) else {
+                continue;
+            };
+            // Forms without resources of their own use their parent's
+            let (resources, fonts) =
+                match dict_get(&value, "Resources").and_then(|r| resolve(xref, r)) {
+                    Some(own) => {
+                        let fonts = Arc::new(scan.font_uses(xref, &own));
+                        (own, fonts)
+                    }
+                    None => (parent, parent_fonts),
+                };
+            if depth < MAX_RESOURCE_DEPTH {
+                stack.extend(
+                    form_refs(xref, &resources)
+                        .into_iter()
+                        .map(|n| (n, resources.clone(), Arc::clone(&fonts), depth + 1, false)),
+                );
+            }
+            found.push(TextStream {
+                dict: value,
+                raw,
+                fonts,
+            });
+        }
+    }
+    found
+}
+
+/// The glyphs content stream `stream` shows in each TrueType CID font
+fn shown_glyphs(stream: &TextStream) -> Shown {
+    let Some(plain) = decode_stream(&stream.dict, &stream.raw) else {
+        return Shown {
+            glyphs: Vec::new(),
+            blind: true,
+        };
+    };
+    let mut glyphs: BTreeMap<i32, HashSet<u16>> = BTreeMap::new();
+    let mut blind = false;
+    scan_text(&plain, |font, bytes| {
+        let Some(font) = font else {
+            blind = true;
+            return;
+        };
+        if let Some(FontUse::Cid { file, gids }) = stream.fonts.get(font) {
+            let set = glyphs.entry(*file).or_default();
+            for pair in bytes.chunks_exact(2) {
+                let cid = u16::from_be_bytes([pair[0], pair[1]]);
+                set.extend(match gids {
+                    Some(map) => map.get(cid as usize).copied(),
+                    None => Some(cid),
+                });
+            }
+        }
+    });
+    Shown {
+        glyphs: glyphs
+            .into_iter()
+            .map(|(file, set)| (file, set.into_iter().collect()))
+            .collect(),
+        blind,
+    }
+}
+
+fn be16(data: &[u8], pos: usize) -> Option<u16> {
+    Some(u16::from_be_bytes(data.get(pos..pos + 2)?.try_into().ok()?))
+}
+
+fn be32(data: &[u8], pos: usize) -> Option<u32> {
+    Some(u32::from_be_bytes(data.get(pos..pos + 4)?.try_into().ok()?))
+}
+
+/// The glyphs composite glyph `glyph` is built from
+fn components(glyph: &[u8]) -> Vec<usize> {
+    let mut found = Vec::new();
+    if be16(glyph, 0).is_none_or(|contours| contours as i16 >= 0) {
+        return found;
+    }
+    let mut pos = 10;
+    while let (Some(flags), Some(gid)) = (be16(glyph, pos), be16(glyph, pos + 2)) {
+        found.push(gid as usize);
+        pos += if flags & ARG_1_AND_2_ARE_WORDS != 0 {
+            8
+        } else {
+            6
+        };
+        pos += if flags & WE_HAVE_A_SCALE != 0 {
+            2
+        } else if flags & WE_HAVE_AN_X_AND_Y_SCALE != 0 {
+            4
+        } else if flags & WE_HAVE_A_TWO_BY_TWO != 0 {
+            8
+        } else {
+            0
+        };
+        if flags & MORE_COMPONENTS == 0 {
+            break;
+        }
+    }
+    found
+}
+
+/// Sum of `data` as big-endian words, zero padded
+fn checksum(data: &[u8]) -> u32 {
+    data.chunks(4).fold(0u32, |sum, word| {
+        let mut padded = [0u8; 4];
+        padded[..word.len()].copy_from_slice(word);
+        sum.wrapping_add(u32::from_be_bytes(padded))
+    })
+}
+
+/// TrueType program `data` with every glyph emptied except `.notdef`,
+/// the glyphs in `keep` and the components they are built from
+///
+/// Returns `None` if `data` isn't a TrueType font with 'glyf' outlines.
+pub(crate) fn subset_truetype(data: &[u8], keep: &[u16]) -> Option<Vec<u8>> {
+    let num_tables = be16(data, 4)? as usize;
+    let mut tables: Vec<([u8; 4], Cow<[u8]>)> = Vec::with_capacity(num_tables);
+    for i in 0..num_tables {
+        let rec = 12 + 16 * i;
+        let tag: [u8; 4] = data.get(rec..rec + 4)?.try_into().ok()?;
+        let offset = be32(data, rec + 8)? as usize;
+        let len = be32(data, rec + 12)? as usize;
+        tables.push((
+            tag,
+            Cow::Borrowed(data.get(offset..offset.checked_add(len)?)?),
+        ));
+    }
+    let table = |tag: &[u8; 4]| tables.iter().find(|(t, _)| t == tag).map(|(_, d)| &d[..]);
+    let head = table(b"head").filter(|h| h.len() >= 54)?;
+    let glyf = table(b"glyf")?;
+    let loca = table(b"loca")?;
+    let num_glyphs = be16(table(b"maxp")?, 4)? as usize;
+    let long = be16(head, 50)? != 0;
+    let offset = |gid: usize| {
+        if long {
+            be32(loca, 4 * gid).map(|o| o as usize)
+        } else {
+            be16(loca, 2 * gid).map(|o| o as usize * 2)
+        }
+    };
+    let glyph = |gid: usize| -> &[u8] {
+        match (offset(gid), offset(gid + 1)) {
+            (Some(start), Some(end)) => glyf.get(start..end.max(start)).unwrap_or_default(),
+            _ => &[],
+        }
+    };
+
+    let mut kept = vec![false; num_glyphs];
+    let mut pending: Vec<usize> = std::iter::once(0)
+        .chain(keep.iter().map(|&g| g as usize))
+        .collect();
+    while let Some(gid) = pending.pop() {
+        if gid >= num_glyphs || kept[gid] {
+            continue;
+        }
+        kept[gid] = true;
+        pending.extend(components(glyph(gid)));
+    }
+
+    // Dropped glyphs take no space; the new 'loca' is always long
+    let mut new_glyf = Vec::new();
+    let mut new_loca = Vec::with_capacity(4 * (num_glyphs + 1));
+    for (gid, &kept) in kept.iter().enumerate() {
+        new_loca.extend_from_slice(&(new_glyf.len() as u32).to_be_bytes());
+        if kept {
+            new_glyf.extend_from_slice(glyph(gid));
+            new_glyf.resize(new_glyf.len().next_multiple_of(4), 0);
+        }
+    }
+    new_loca.extend_from_slice(&(new_glyf.len() as u32).to_be_bytes());
+    let mut new_head = head.to_vec();
+    new_head[8..12].fill(0);
+    new_head[50..52].copy_from_slice(&1u16.to_be_bytes());
+
+    // A signature no longer matches once the glyphs change
+    tables.retain(|(tag, _)| tag != b"DSIG");
+    for (tag, data) in &mut tables {
+        match &*tag {
+            b"glyf" => *data = Cow::Owned(std::mem::take(&mut new_glyf)),
+            b"loca" => *data = Cow::Owned(std::mem::take(&mut new_loca)),
+            b"head" => *data = Cow::Owned(std::mem::take(&mut new_head)),
+            _ => {}
+        }
+    }
+    tables.sort_by_key(|(tag, _)| *tag);
+
+    let count = tables.len() as u16;
+    let selector = (u16::BITS - 1 - count.leading_zeros()) as u16;
+    let search_range = 16u16 << selector;
+    let mut out = data[..4].to_vec();
+    for field in [count, search_range, selector, 16 * count - search_range] {
+        out.extend_from_slice(&field.to_be_bytes());
+    }
+    let mut offset = 12 + 16 * tables.len();
+    let mut head_offset = 0;
+    for (tag, data) in &tables {
+        if tag == b"head" {
+            head_offset = offset;
+        }
+        out.extend_from_slice(tag);
+        out.extend_from_slice(&checksum(data).to_be_bytes());
+        out.extend_from_slice(&(offset as u32).to_be_bytes());
+        out.extend_from_slice(&(data.len() as u32).to_be_bytes());
+        offset += data.len().next_multiple_of(4);
+    }
+    for (_, data) in &tables {
+        out.extend_from_slice(data);
+        out.resize(out.len().next_multiple_of(4), 0);
+    }
+    let adjustment = 0xB1B0_AFBAu32.wrapping_sub(checksum(&out));
+    out[head_offset + 8..head_offset + 12].copy_from_slice(&adjustment.to_be_bytes());
+    Some(out)
+}
+
+/// New streams for the TrueType CID font programs `pages` use, cut down
+/// to the glyphs they show, in object order
+///
+/// Streams are scanned and fonts subset on `threads` threads (0 = one per
+/// core). Programs the subset wouldn't shrink are left out.
+pub(crate) fn subset_font_edits(
+    xref: &mut Xref,
+    pages: &[i32],
+    threads: usize,
+) -> Vec<(i32, (ParsedValue, Bytes))> {
+    let mut scan = FontScan::default();
+    let streams = collect_streams(xref, pages, &mut scan);
+    let shown = parallel_map(&streams, threads, shown_glyphs);
+    if shown.iter().any(|s| s.blind) {
+        return Vec::new();
+    }
+    let mut used: HashMap<i32, HashSet<u16>> = HashMap::new();
+    for (file, glyphs) in shown.into_iter().flat_map(|s| s.glyphs) {
+        used.entry(file).or_default().extend(glyphs);
+    }
+
+    let programs: Vec<(i32, ParsedValue, Bytes, Vec<u16>)> = scan
+        .files
+        .iter()
+        .filter(|&(_, &whole)| !whole)
+        .filter_map(|(&num, _)| {
+            let fetched = xref.fetch(num)?;
+            let mut glyphs: Vec<u16> = used.remove(&num).unwrap_or_default().into_iter().collect();
+            glyphs.sort_unstable();
+            Some((num, fetched.value, fetched.stream?, glyphs))
+        })
+        .collect();
+    let subset = parallel_map(&programs, threads, |(_, dict, raw, glyphs)| {
+        let program = decode_stream(dict, raw)?;
+        let subset = subset_truetype(&program, glyphs).filter(|s| s.len() < program.len())?;
+        let data = encode_flate(&subset, 6).ok()?;
+        let mut dict = dict.clone();
+        for key in ["DecodeParms", "DL"] {
+            set_key(&mut dict, key, None);
+        }
+        set_key(
+            &mut dict,
+            "Filter",
+            Some(ParsedValue::Name("FlateDecode".into())),
+        );
+        set_key(
+            &mut dict,
+            "Length",
+            Some(ParsedValue::Int(data.len() as i64)),
+        );
+        set_key(
+            &mut dict,
+            "Length1",
+            Some(ParsedValue::Int(subset.len() as i64)),
+        );
+        Some((dict, Bytes::from(data)))
+    });
+    programs
+        .iter()
+        .zip(subset)
+        .filter_map(|((num, ..), stream)| Some((*num, stream?)))
+        .collect()
+}
+
+/// Subset the fonts of document `doc` to the glyphs `pages` (page
+/// indices; `None` for every page) show, on `threads` threads
+///
+/// Fonts are cut to what those pages need even if other pages use them
+/// too. The document's data is replaced if anything changed. Returns the
+/// number of font programs subset.
+pub(crate) fn subset_fonts(doc: Handle, pages: Option<&[i32]>, threads: usize) -> i32 {
+    let Some(data) = DOCUMENTS.get(doc).map(|d| d.lock().unwrap().data()) else {
+        return 0;
+    };
+    let Some(mut xref) = open_source(&data, threads) else {
+        return 0;
+    };
+    xref.read_all_sections();
+    // Encrypted streams can't be read without decrypting them
+    if xref
+        .source_trailer()
+        .is_none_or(|t| dict_get(t, "Encrypt").is_some())
+    {
+        return 0;
+    }
+    let pages: Vec<i32> = match pages {
+        Some(pages) => pages
+            .iter()
+            .filter_map(|&i| xref.lazy_page_object(i))
+            .collect(),
+        None => (0..).map_while(|i| xref.lazy_page_object(i)).collect(),
+    };
+
+    let mut edits = Edits::default();
+    edits
+        .streams
+        .extend(subset_font_edits(&mut xref, &pages, threads));
+    if edits.streams.is_empty() {
+        return 0;
+    }
+    let settings = WriteSettings {
+        compress: false,
+        decompress: false,
+        threads,
+        ..WriteSettings::default()
+    };
+    let mut out = Vec::new();
+    let saved = matches!(
+        write_opened(xref, &settings, &edits, &mut out),
+        Some(Ok(()))
+    );
+    match DOCUMENTS.get(doc).filter(|_| saved) {
+        Some(d) => {
+            d.lock().unwrap().replace_data(out);
+            edits.streams.len() as i32
+        }
+        None => 0,
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::document::Document;
+    use crate::ffi::pdf_image_rewriter::tests::{pdf_with, stream};
+
+    /// An sfnt of 'head', 'maxp', 'loca' and 'glyf' over `glyphs`, with a
+    /// short 'loca'
+    fn truetype(glyphs: &[Vec<u8>]) -> Vec<u8> {
+        let mut head = vec![0u8; 54];
+        head[18..20].copy_from_slice(&1000u16.to_be_bytes());
+        let mut maxp = vec![0u8; 6];
+        maxp[4..6].copy_from_slice(&(glyphs.len() as u16).to_be_bytes());
+        let mut glyf = Vec::new();
+        let mut loca = Vec::new();
+        for glyph in glyphs {
+            loca.extend_from_slice(&((glyf.len() / 2) as u16).to_be_bytes());
+            glyf.extend_from_slice(glyph);
+            glyf.resize(glyf.len().next_multiple_of(2), 0);
+        }
+        loca.extend_from_slice(&((glyf.len() / 2) as u16).to_be_bytes());
+
+        let tables = [
+            (b"glyf", glyf),
+            (b"head", head),
+            (b"loca", loca),
+            (b"maxp", maxp),
+        ];
+        let mut out = vec![0, 1, 0, 0];
+        out.extend_from_slice(&(tables.len() as u16).to_be_bytes());
+        out.extend_from_slice(&[0; 6]);
+        let mut offset = 12 + 16 * tables.len();
+        for (tag, table) in &tables {
+            out.extend_from_slice(*tag);
+            out.extend_from_slice(&[0; 4]);
+            out.extend_from_slice(&(offset as u32).to_be_bytes());
+            out.extend_from_slice(&(table.len() as u32).to_be_bytes());
+            offset += table.len();
+        }
+        for (_, table) in &tables {
+            out.extend_from_slice(table);
+        }
+        out
+    }
+
+    /// A simple glyph of one contour, filled out to `len` bytes
+    fn simple(len: usize, fill: u8) -> Vec<u8> {
+        let mut glyph = vec![fill; len];
+        glyph[..2].copy_from_slice(&1u16.to_be_bytes());
+        glyph
+    }
+
+    /// A composite glyph of `parts`, with byte offsets and no scale
+    fn composite(parts: &[u16]) -> Vec<u8> {
+        let mut glyph = (-1i16).to_be_bytes().to_vec();
+        glyph.extend_from_slice(&[0; 8]);
+        for (i, &part) in parts.iter().enumerate() {
+            let more = if i + 1 < parts.len() {
+                MORE_COMPONENTS
+            } else {
+                0
+            };
+            glyph.extend_from_slice(&more.to_be_bytes());
+            glyph.extend_from_slice(&part.to_be_bytes());
+            glyph.extend_from_slice(&[0, 0]);
+        }
+        glyph
+    }
+
+    fn glyph_lengths(font: &[u8]) -> Vec<usize> {
+        let table = |tag: &[u8]| {
+            (0..be16(font, 4).unwrap() as usize)
+                .map(|i| 12 + 16 * i)
+                .find(|&rec| &font[rec..rec + 4] == tag)
+                .map(|rec| be32(font, rec + 8).unwrap() as usize)
+                .unwrap()
+        };
+        let (head, loca) = (table(b"head"), table(b"loca"));
+        assert_eq!(be16(font, head + 50), Some(1));
+        let glyphs = be16(font, table(b"maxp") + 4).unwrap() as usize;
+        (0..glyphs)
+            .map(|g| {
+                (be32(font, loca + 4 * g + 4).unwrap() - be32(font, loca + 4 * g).unwrap()) as usize
+            })
+            .collect()
+    }
+
+    #[test]
+    fn test_scan_text_tracks_fonts() {
+        let content = b"BT /F1 12 Tf (ab) Tj q /F2 9 Tf [<0001> -250 <0002>] TJ Q (c) ' \
+                        BI /W 1 /H 1 ID \x28\x28 EI ET 1 0 0 1 0 0 cm (x) Tj";
+        let mut shown = Vec::new();
+        let mut first = Vec::new();
+        scan_text(b"(early) Tj /F1 1 Tf", |font, bytes| {
+            first.push((font.map(str::to_string), bytes.to_vec()))
+        });
+        assert_eq!(first, vec![(None, b"early".to_vec())]);
+
+        scan_text(content, |font, bytes| {
+            shown.push((font.unwrap().to_string(), bytes.to_vec()))
+        });
+        assert_eq!(
+            shown,
+            vec![
+                ("F1".into(), b"ab".to_vec()),
+                ("F2".into(), vec![0, 1]),
+                ("F2".into(), vec![0, 2]),
+                ("F1".into(), b"c".to_vec()),
+                ("F1".into(), b"x".to_vec()),
+            ]
+        );
+    }
+
+    #[test]
+    fn test_subset_keeps_composite_parts() {
+        let font = truetype(&[
+            simple(12, 1),
+            simple(40, 2),
+            composite(&[3, 4]),
+            simple(20, 3),
+            simple(16, 4),
+            simple(60, 5),
+        ]);
+        let subset = subset_truetype(&font, &[2]).unwrap();
+        assert_eq!(glyph_lengths(&subset), vec![12, 0, 24, 20, 16, 0]);
+        assert_eq!(checksum(&subset), 0xB1B0_AFBA);
+        assert!(subset.len() < font.len());
+
+        // Glyph ids past the end and cyclic components are harmless
+        let cyclic = truetype(&[simple(12, 1), composite(&[2]), composite(&[1])]);
+        let subset = subset_truetype(&cyclic, &[1, 900]).unwrap();
+        assert_eq!(glyph_lengths(&subset), vec![12, 16, 16]);
+        assert!(subset_truetype(b"OTTO", &[]).is_none());
+    }
+
+    #[test]
+    fn test_subset_fonts_rewrites_used_programs() {
+        let glyphs: Vec<Vec<u8>> = (0..8).map(|g| simple(200, g as u8)).collect();
+        let program = truetype(&glyphs);
+        let data = pdf_with(&[
+            b"<< /Type /Catalog /Pages 2 0 R >>".to_vec(),
+            b"<< /Type /Pages /Kids [3 0 R] /Count 1 >>".to_vec(),
+            b"<< /Type /Page /Parent 2 0 R /Contents 4 0 R \
+               /Resources << /Font << /F0 5 0 R >> /XObject << /Fm0 8 0 R >> >> >>"
+                .to_vec(),
+            stream("", b"BT /F0 12 Tf <0002> Tj ET /Fm0 Do"),
+            b"<< /Type /Font /Subtype /Type0 /BaseFont /Test /Encoding /Identity-H \
+               /DescendantFonts [6 0 R] >>"
+                .to_vec(),
+            b"<< /Type /Font /Subtype /CIDFontType2 /BaseFont /Test \
+               /CIDSystemInfo << /Registry (Adobe) /Ordering (Identity) /Supplement 0 >> \
+               /FontDescriptor 7 0 R /CIDToGIDMap /Identity >>"
+                .to_vec(),
+            b"<< /Type /FontDescriptor /FontName /Test /FontFile2 9 0 R >>".to_vec(),
+            stream(
+                "/Type /XObject /Subtype /Form /BBox [0 0 1 1]",
+                b"BT /F0 1 Tf [<0005>] TJ ET",
+            ),
+            stream(&format!("/Length1 {}", program.len()), &program),
+        ]);
+        let doc = DOCUMENTS.insert(Document::new(data));
+        assert_eq!(subset_fonts(doc, None, 4), 1);
+
+        let data = DOCUMENTS.get(doc).unwrap().lock().unwrap().data();
+        let mut xref = Xref::open_lazy(0, data).unwrap();
+        let file = xref.fetch(9).unwrap();
+        let subset = decode_stream(&file.value, file.stream.as_ref().unwrap()).unwrap();
+        assert_eq!(
+            dict_get(&file.value, "Length1"),
+            Some(&ParsedValue::Int(subset.len() as i64))
+        );
+        assert_eq!(glyph_lengths(&subset), vec![200, 0, 200, 0, 0, 200, 0, 0]);
+
+        // Nothing is left to cut
+        assert_eq!(subset_fonts(doc, None, 1), 0);
+        DOCUMENTS.remove(doc);
+    }
+}
@@ -0,0 +1,977 @@
+//! Page Vectorization
+//!
+//! Text is turned into the paths its glyphs paint, so pages look the same
+//! without their fonts. A text object is converted only if every string
+//! it shows is in a font whose glyphs can be drawn and in a rendering
+//! mode that fills or strokes (0-3); it then becomes the outlines of each
+//! shown string, filled, stroked or both as the mode says, under the same
+//! graphics state. The other operators in the object are kept in order,
+//! and the positioning ones, which only mean something inside a text
+//! object, are dropped. Any other text object is left as it is.
+//!
+//! Glyphs come from embedded TrueType programs, for Type0 fonts with an
+//! Identity-H encoding over a CIDFontType2 and for simple TrueType fonts
+//! mapped through the program's own cmap, and from the glyph procedures
+//! of Type 3 fonts without resources of their own. Fonts are read once
+//! per document and outlines are built once per face (see `font_cache`),
+//! then the pages are converted on a pool of threads and the new content
+//! goes out through the streaming rewrite with everything else copied as
+//! it is. Forms and annotation appearances are not converted, and a
+//! content stream shared by several pages is converted for the first.
+
+use super::pdf_image_rewriter::{inherited, resolve};
+use super::pdf_optimize::{inline_image_end, is_space, token_end};
+use super::pdf_parse::{ParsedValue, PdfParser};
+use super::pdf_stream_prefetch::parallel_map;
+use super::pdf_write::{Edits, WriteSettings, open_source, set_key, write_opened};
+use super::pdf_xref::Xref;
+use super::pdf_xref_lazy::{as_ref, decode_stream, dict_get, is_name};
+use crate::ffi::display_list::fz_purge_display_list_cache;
+use crate::ffi::pdf_interpret::pdf_purge_content_program_cache;
+use crate::ffi::{DOCUMENTS, Handle};
+use crate::fitz::font_cache::FontFace;
+use crate::fitz::geometry::{Matrix, Point};
+use crate::fitz::output::push_fixed;
+use crate::fitz::path::{Path, PathElement};
+use crate::pdf::filter::encode_flate;
+use bytes::Bytes;
+use std::collections::{HashMap, HashSet};
+use std::sync::Arc;
+
+/// Symbolic flag of a font descriptor
+const SYMBOLIC: i64 = 1 << 2;
+
+/// What draws the glyphs of a font
+enum Glyphs {
+    /// Outlines of a TrueType program, with glyph ids by code (`None`
+    /// for codes that are glyph ids)
+    Outlines {
+        face: Arc<FontFace>,
+        gids: Option<Vec<Option<u16>>>,
+    },
+    /// Type 3 glyph procedures by code, drawn through `matrix`
+    Procedures {
+        matrix: Matrix,
+        procs: HashMap<u32, Arc<[u8]>>,
+    },
+}
+
+/// A font whose glyphs can be drawn as paths
+struct VectorFont {
+    /// Codes are two bytes, not one
+    two_byte: bool,
+    /// Advances by code, in text space units per unit of font size
+    widths: HashMap<u32, f32>,
+    default_width: f32,
+    glyphs: Glyphs,
+}
+
+/// The fonts a page's resources name that can be drawn, by name
+type Fonts = HashMap<String, Arc<VectorFont>>;
+
+impl VectorFont {
+    fn advance(&self, code: u32) -> f32 {
+        self.widths
+            .get(&code)
+            .copied()
+            .unwrap_or(self.default_width)
+    }
+
+    /// The codes of shown string `bytes`
+    fn codes<'a>(&self, bytes: &'a [u8]) -> impl Iterator<Item = u32> + 'a {
+        let width = if self.two_byte { 2 } else { 1 };
+        bytes
+            .chunks_exact(width)
+            .map(|c| c.iter().fold(0, |code, &b| code << 8 | u32::from(b)))
+    }
+}
+
+pub(crate) fn number(value: &ParsedValue) -> Option<f32> {
+    match value {
+        ParsedValue::Int(n) => Some(*n as f32),
+        ParsedValue::Real(r) => Some(*r),
+        _ => None,
+    }
+}
+
+/// The TrueType program `font`'s descriptor embeds, read once per
+/// program object
+fn program(
+    xref: &mut Xref,
+    font: &ParsedValue,
+    faces: &mut HashMap<i32, Option<Arc<FontFace>>>,
+) -> Option<Arc<FontFace>> {
+    let descriptor = dict_get(font, "FontDescriptor").and_then(|d| resolve(xref, d))?;
+    let num = dict_get(&descriptor, "FontFile2").and_then(as_ref)?;
+    if let Some(face) = faces.get(&num) {
+        return face.clone();
+    }
+    let face = xref
+        .fetch(num)
+        .and_then(|f| decode_stream(&f.value, f.stream.as_ref()?))
+        .map(|data| FontFace::load(&data, 0))
+        .filter(|face| face.units_per_em() > 0);
+    faces.insert(num, face.clone());
+    face
+}
+
+/// Widths by code from a simple font's FirstChar and Widths, scaled by
+/// `scale`
+pub(crate) fn simple_widths(xref: &mut Xref, font: &ParsedValue, scale: f32) -> HashMap<u32, f32> {
+    let first = dict_get(font, "FirstChar").and_then(number).unwrap_or(0.0) as u32;
+    match dict_get(font, "Widths").and_then(|w| resolve(xref, w)) {
+        Some(ParsedValue::Array(widths)) => (first..)
+            .zip(&widths)
+            .filter_map(|(code, w)| Some((code, number(w)? * scale)))
+            .collect(),
+        _ => HashMap::new(),
+    }
+}
+
+/// Widths by CID from a CIDFont's W array, in thousandths
+pub(crate) fn cid_widths(xref: &mut Xref, w: Option<&ParsedValue>) -> HashMap<u32, f32> {
+    let mut widths = HashMap::new();
+    let Some(ParsedValue::Array(items)) = w.and_then(|w| resolve(xref, w)) else {
+        return widths;
+    };
+    let mut i = 0;
+    while let Some(first) = items.get(i).and_then(number) {
+        let first = first as u32;
+        match items.get(i + 1).and_then(|v| resolve(xref, v)) {
+            Some(ParsedValue::Array(run)) => {
+                for (cid, w) in (first..).zip(&run) {
+                    if let Some(w) = number(w) {
+                        widths.insert(cid, w / 1000.0);
+                    }
+                }
+                i += 2;
+            }
+            Some(last) => {
+                let (Some(last), Some(w)) = (number(&last), items.get(i + 2).and_then(number))
+                else {
+                    break;
+                };
+                for cid in first..=(last as u32).min(first + 0xffff) {
+                    widths.insert(cid, w / 1000.0);
+                }
+                i += 3;
+            }
+            None => break,
+        }
+    }
+    widths
+}
+
+/// A Type0 font with an Identity-H encoding over a CIDFontType2
+fn load_cid(
+    xref: &mut Xref,
+    font: &ParsedValue,
+    faces: &mut HashMap<i32, Option<Arc<FontFace>>>,
+) -> Option<VectorFont> {
+    // Vertical writing isn't drawn
+    if !is_name(dict_get(font, "Encoding"), "Identity-H") {
+        return None;
+    }
+    let descendant = match dict_get(font, "DescendantFonts").and_then(|d| resolve(xref, d)) {
+        Some(ParsedValue::Array(items)) => items.first().and_then(|d| resolve(xref, d))?,
+        _ => return None,
+    };
+    if !is_name(dict_get(&descendant, "Subtype"), "CIDFontType2") {
+        return None;
+    }
+    let face = program(xref, &descendant, faces)?;
+    let gids = match dict_get(&descendant, "CIDToGIDMap") {
+        None => None,
+        Some(map) if is_name(Some(map), "Identity") => None,
+        Some(map) => {
+            let map = as_ref(map)
+                .and_then(|num| xref.fetch(num))
+                .and_then(|f| decode_stream(&f.value, f.stream.as_ref()?))?;
+            let gids = map
+                .chunks_exact(2)
+                .map(|pair| Some(u16::from_be_bytes([pair[0], pair[1]])))
+                .collect();
+            Some(gids)
+        }
+    };
+    let default_width = dict_get(&descendant, "DW")
+        .and_then(number)
+        .unwrap_or(1000.0);
+    Some(VectorFont {
+        two_byte: true,
+        widths: cid_widths(xref, dict_get(&descendant, "W")),
+        default_width: default_width / 1000.0,
+        glyphs: Glyphs::Outlines { face, gids },
+    })
+}
+
+/// A simple TrueType font, with codes mapped through the program's cmap
+///
+/// Codes go through the (3,1) Unicode subtable only for a nonsymbolic
+/// font in the standard or WinAnsi encoding, and only where that agrees
+/// with Latin-1; otherwise through (3,0), then (1,0).
+fn load_truetype(
+    xref: &mut Xref,
+    font: &ParsedValue,
+    faces: &mut HashMap<i32, Option<Arc<FontFace>>>,
+) -> Option<VectorFont> {
+    let face = program(xref, font, faces)?;
+    let descriptor = dict_get(font, "FontDescriptor").and_then(|d| resolve(xref, d))?;
+    let symbolic =
+        matches!(dict_get(&descriptor, "Flags"), Some(ParsedValue::Int(f)) if f & SYMBOLIC != 0);
+    let encoding = dict_get(font, "Encoding");
+    let unicode = !symbolic && (encoding.is_none() || is_name(encoding, "WinAnsiEncoding"));
+
+    let gids = (0..256u32)
+        .map(|code| {
+            let latin = matches!(code, 0x20..=0x7e | 0xa0..=0xff);
+            (unicode && latin)
+                .then(|| face.cmap_glyph(3, 1, code))
+                .flatten()
+                .or_else(|| face.cmap_glyph(3, 0, 0xf000 + code))
+                .or_else(|| face.cmap_glyph(3, 0, code))
+                .or_else(|| face.cmap_glyph(1, 0, code))
+        })
+        .collect();
+    let missing = dict_get(&descriptor, "MissingWidth")
+        .and_then(number)
+        .unwrap_or(0.0);
+    Some(VectorFont {
+        two_byte: false,
+        widths: simple_widths(xref, font, 0.001),
+        default_width: missing / 1000.0,
+        glyphs: Glyphs::Outlines {
+            face,
+            gids: Some(gids),
+        },
+    })
+}
+
+/// The part of glyph procedure `data` after its d0 or d1
+fn glyph_body(data: &[u8]) -> &[u8] {
+    let mut i = 0;
+    while i < data.len() {
+        if is_space(data[i]) {
+            i += 1;
+            continue;
+        }
+        let end = token_end(data, i);
+        if matches!(&data[i..end], b"d0" | b"d1") {
+            return &data[end..];
+        }
+        i = end;
+    }
+    data
+}
+
+/// A Type 3 font whose glyph procedures use no resources of their own
+fn load_type3(xref: &mut Xref, font: &ParsedValue) -> Option<VectorFont> {
+    match dict_get(font, "Resources").and_then(|r| resolve(xref, r)) {
+        Some(ParsedValue::Dict(entries)) if !entries.is_empty() => return None,
+        _ => {}
+    }
+    let matrix = match dict_get(font, "FontMatrix").and_then(|m| resolve(xref, m)) {
+        Some(ParsedValue::Array(items)) if items.len() == 6 => {
+            let v = items.iter().map(number).collect::<Option<Vec<_>>>()?;
+            Matrix::new(v[0], v[1], v[2], v[3], v[4], v[5])
+        }
+        _ => return None,
+    };
+    let procs = dict_get(font, "CharProcs").and_then(|p| resolve(xref, p))?;
+    let differences = dict_get(font, "Encoding")
+        .and_then(|e| resolve(xref, e))
+        .and_then(|e| dict_get(&e, "Differences").and_then(|d| resolve(xref, d)));
+
+    let mut names = Vec::new();
+    if let Some(ParsedValue::Array(items)) = differences {
+        let mut code = 0u32;
+        for item in items {
+            match item {
+                ParsedValue::Int(n) => code = n as u32,
+                ParsedValue::Name(name) => {
+                    names.push((code, name));
+                    code += 1;
+                }
+                _ => {}
+            }
+        }
+    }
+    let mut glyphs = HashMap::new();
+    for (code, name) in names {
+        let proc = dict_get(&procs, &name)
+            .and_then(as_ref)
+            .and_then(|num| xref.fetch(num))
+            .and_then(|f| decode_stream(&f.value, f.stream.as_ref()?));
+        if let Some(proc) = proc {
+            glyphs.insert(code, Arc::from(glyph_body(&proc)));
+        }
+    }
+    Some(VectorFont {
+        two_byte: false,
+        widths: simple_widths(xref, font, matrix.a),
+        default_width: 0.0,
+        glyphs: Glyphs::Procedures {
+            matrix,
+            procs: glyphs,
+        },
+    })
+}
+
+/// `font` as one whose glyphs can be drawn, if it is one
+fn load_font(
+    xref: &mut Xref,
+    font: &ParsedValue,
+    faces: &mut HashMap<i32, Option<Arc<FontFace>>>,
+) -> Option<VectorFont> {
+    let subtype = dict_get(font, "Subtype");
+    if is_name(subtype, "Type0") {
+        load_cid(xref, font, faces)
+    } else if is_name(subtype, "TrueType") {
+        load_truetype(xref, font, faces)
+    } else if is_name(subtype, "Type3") {
+        load_type3(xref, font)
+    } else {
+        None
+    }
+}
+
+/// The fonts met so far, by object number
+#[derive(Default)]
+struct FontLoader {
+    fonts: HashMap<i32, Option<Arc<VectorFont>>>,
+    faces: HashMap<i32, Option<Arc<FontFace>>>,
+}
+
+impl FontLoader {
+    /// The drawable fonts `resources` names
+    fn page_fonts(&mut self, xref: &mut Xref, resources: &ParsedValue) -> Fonts {
+        let Some(ParsedValue::Dict(entries)) =
+            dict_get(resources, "Font").and_then(|d| resolve(xref, d))
+        else {
+            return Fonts::new();
+        };
+        let mut fonts = Fonts::new();
+        for (name, value) in entries {
+            let font = match as_ref(&value) {
+                Some(num) => match self.fonts.get(&num) {
+                    Some(found) => found.clone(),
+                    None => {
+                        let found = xref
+                            .fetch(num)
+                            .and_then(|f| load_font(xref, &f.value, &mut self.faces))
+                            .map(Arc::new);
+                        self.fonts.insert(num, found.clone());
+                        found
+                    }
+                },
+                None => load_font(xref, &value, &mut self.faces).map(Arc::new),
+            };
+            if let Some(font) = font {
+                fonts.insert(name, font);
+            }
+        }
+        fonts
+    }
+}
+
+/// An operator with its operands, as spans of the content
+pub(crate) struct Op<'a> {
+    /// From the first operand to the end of the operator
+    pub(crate) start: usize,
+    pub(crate) end: usize,
+    pub(crate) name: &'a [u8],
+    pub(crate) operands: Vec<(usize, usize)>,
+}
+
+/// The operators of content stream `data`, skipping comments
+pub(crate) fn operators(data: &[u8]) -> Vec<Op<'_>> {
+    let mut ops = Vec::new();
+    let mut operands = Vec::new();
+    let mut i = 0;
+    while i < data.len() {
+        let b = data[i];
+        if is_space(b) {
+            i += 1;
+            continue;
+        }
+        if b == b'%' {
+            while i < data.len() && !matches!(data[i], b'\r' | b'\n') {
+                i += 1;
+            }
+            continue;
+        }
+        let start = i;
+        i = token_end(data, i);
+        let token = &data[start..i];
+        if !token[0].is_ascii_alphabetic() && !matches!(b, b'\'' | b'"' | b'*')
+            || matches!(token, b"true" | b"false" | b"null")
+        {
+            operands.push((start, i));
+            continue;
+        }
+        if token == b"ID" {
+            i = inline_image_end(data, (i + 1).min(data.len()));
+        }
+        ops.push(Op {
+            start: operands.first().map_or(start, |&(s, _)| s),
+            end: i,
+            name: token,
+            operands: std::mem::take(&mut operands),
+        });
+    }
+    ops
+}
+
+fn parse(token: &[u8]) -> Option<ParsedValue> {
+    PdfParser::new(token.to_vec()).parse_value()
+}
+
+/// Operand `index` of `op` as a number
+pub(crate) fn operand(data: &[u8], op: &Op, index: usize) -> Option<f32> {
+    let &(s, e) = op.operands.get(index)?;
+    std::str::from_utf8(&data[s..e]).ok()?.parse().ok()
+}
+
+/// The string at `span`, if it is one
+pub(crate) fn string(data: &[u8], (s, e): (usize, usize)) -> Option<Vec<u8>> {
+    if data[s] != b'(' && (data[s] != b'<' || data.get(s + 1) == Some(&b'<')) {
+        return None;
+    }
+    match parse(&data[s..e])? {
+        ParsedValue::String(bytes) => Some(bytes),
+        _ => None,
+    }
+}
+
+/// Append `v`, rounded to thousandths, and a space
+pub(crate) fn write_number(v: f32, out: &mut Vec<u8>) {
+    push_fixed(out, v, 3);
+    out.push(b' ');
+}
+
+fn write_point(p: Point, m: &Matrix, out: &mut Vec<u8>) {
+    let p = m.transform_point(p);
+    write_number(p.x, out);
+    write_number(p.y, out);
+}
+
+/// Append the operators that construct `path` through `m`
+fn write_path(path: &Path, m: &Matrix, out: &mut Vec<u8>) {
+    let mut current = Point::ORIGIN;
+    for element in path.elements() {
+        match *element {
+            PathElement::MoveTo(p) => {
+                write_point(p, m, out);
+                out.extend_from_slice(b"m\n");
+                current = p;
+            }
+            PathElement::LineTo(p) => {
+                write_point(p, m, out);
+                out.extend_from_slice(b"l\n");
+                current = p;
+            }
+            PathElement::QuadTo(c, p) => {
+                // The same curve as a cubic, with controls 2/3 of the way
+                // to the quadratic's
+                let third = |a: Point| {
+                    Point::new(a.x + (c.x - a.x) * 2.0 / 3.0, a.y + (c.y - a.y) * 2.0 / 3.0)
+                };
+                write_point(third(current), m, out);
+                write_point(third(p), m, out);
+                write_point(p, m, out);
+                out.extend_from_slice(b"c\n");
+                current = p;
+            }
+            PathElement::CurveTo(c1, c2, p) => {
+                write_point(c1, m, out);
+                write_point(c2, m, out);
+                write_point(p, m, out);
+                out.extend_from_slice(b"c\n");
+                current = p;
+            }
+            PathElement::Close => out.extend_from_slice(b"h\n"),
+            PathElement::Rect(r) => {
+                write_point(Point::new(r.x0, r.y0), m, out);
+                out.extend_from_slice(b"m\n");
+                for (x, y) in [(r.x1, r.y0), (r.x1, r.y1), (r.x0, r.y1)] {
+                    write_point(Point::new(x, y), m, out);
+                    out.extend_from_slice(b"l\n");
+                }
+                out.extend_from_slice(b"h\n");
+                current = Point::new(r.x0, r.y0);
+            }
+        }
+    }
+}
+
+/// The text state operators set, saved and restored with q and Q
+#[derive(Clone)]
+struct TextState {
+    /// `None` if no font is selected or it can't be drawn
+    font: Option<Arc<VectorFont>>,
+    size: f32,
+    char_space: f32,
+    word_space: f32,
+    scale: f32,
+    leading: f32,
+    rise: f32,
+    render: i32,
+}
+
+impl Default for TextState {
+    fn default() -> Self {
+        Self {
+            font: None,
+            size: 0.0,
+            char_space: 0.0,
+            word_space: 0.0,
+            scale: 1.0,
+            leading: 0.0,
+            rise: 0.0,
+            render: 0,
+        }
+    }
+}
+
+impl TextState {
+    /// Apply `op` if it sets text state; false if it doesn't
+    fn apply(&mut self, data: &[u8], op: &Op, fonts: &Fonts) -> bool {
+        let value = operand(data, op, op.operands.len().saturating_sub(1));
+        match op.name {
+            b"Tc" => self.char_space = value.unwrap_or(0.0),
+            b"Tw" => self.word_space = value.unwrap_or(0.0),
+            b"Tz" => self.scale = value.unwrap_or(100.0) / 100.0,
+            b"TL" => self.leading = value.unwrap_or(0.0),
+            b"Ts" => self.rise = value.unwrap_or(0.0),
+            b"Tr" => self.render = value.map_or(0, |v| v as i32),
+            b"Tf" => {
+                self.font = match op.operands.first().and_then(|&(s, e)| parse(&data[s..e])) {
+                    Some(ParsedValue::Name(name)) => fonts.get(&name).cloned(),
+                    _ => None,
+                };
+                self.size = value.unwrap_or(0.0);
+            }
+            _ => return false,
+        }
+        true
+    }
+
+    /// Append the glyphs of string `bytes` shown at `tm` to `out`, if
+    /// given, moving `tm` past them; false if they can't be drawn
+    fn show(&self, bytes: &[u8], tm: &mut Matrix, mut out: Option<&mut Vec<u8>>) -> bool {
+        let Some(font) = self
+            .font
+            .as_ref()
+            .filter(|_| (0..=3).contains(&self.render))
+        else {
+            return false;
+        };
+        if self.render == 3 {
+            out = None;
+        }
+        let mut path = Vec::new();
+        for code in font.codes(bytes) {
+            let trm =
+                Matrix::new(self.size * self.scale, 0.0, 0.0, self.size, 0.0, self.rise).concat(tm);
+            match (&font.glyphs, out.as_deref_mut()) {
+                (_, None) => {}
+                (Glyphs::Outlines { face, gids }, Some(_)) => {
+                    let gid = match gids {
+                        None => u16::try_from(code).ok(),
+                        Some(gids) => gids.get(code as usize).copied().flatten(),
+                    };
+                    let Some(gid) = gid else {
+                        return false;
+                    };
+                    let units = 1.0 / f32::from(face.units_per_em());
+                    let m = Matrix::scale(units, units).concat(&trm);
+                    write_path(&face.glyph_path(gid), &m, &mut path);
+                }
+                (Glyphs::Procedures { matrix, procs }, Some(content)) => {
+                    if let Some(proc) = procs.get(&code) {
+                        let m = matrix.concat(&trm);
+                        content.extend_from_slice(b"q\n");
+                        for v in [m.a, m.b, m.c, m.d, m.e, m.f] {
+                            write_number(v, content);
+                        }
+                        content.extend_from_slice(b"cm\n");
+                        content.extend_from_slice(proc);
+                        content.extend_from_slice(b"\nQ\n");
+                    }
+                }
+            }
+            let mut advance = font.advance(code) * self.size + self.char_space;
+            if !font.two_byte && code == 32 {
+                advance += self.word_space;
+            }
+            *tm = Matrix::translate(advance * self.scale, 0.0).concat(tm);
+        }
+        if let Some(content) = out.filter(|_| !path.is_empty()) {
+            content.extend_from_slice(&path);
+            content.extend_from_slice(match self.render {
+                0 => b"f\n",
+                1 => b"S\n",
+                _ => b"B\n",
+            });
+        }
+        true
+    }
+}
+
+/// What text object `ops` (between BT and ET) draws, as paths and the
+/// state operators it holds, or `None` if it shows text that can't be
+/// drawn
+///
+/// `state` and `saved` follow the object either way.
+fn draw_text(
+    data: &[u8],
+    ops: &[Op],
+    state: &mut TextState,
+    saved: &mut Vec<TextState>,
+    fonts: &Fonts,
+) -> Option<Vec<u8>> {
+    let mut out = Some(Vec::new());
+    let mut tm = Matrix::IDENTITY;
+    let mut tlm = Matrix::IDENTITY;
+    let next_line = |tm: &mut Matrix, tlm: &mut Matrix, tx: f32, ty: f32| {
+        *tlm = Matrix::translate(tx, ty).concat(tlm);
+        *tm = *tlm;
+    };
+    for op in ops {
+        let num = |index| operand(data, op, index).unwrap_or(0.0);
+        match op.name {
+            b"Td" => next_line(&mut tm, &mut tlm, num(0), num(1)),
+            b"TD" => {
+                state.leading = -num(1);
+                next_line(&mut tm, &mut tlm, num(0), num(1));
+            }
+            b"Tm" => {
+                tlm = Matrix::new(num(0), num(1), num(2), num(3), num(4), num(5));
+                tm = tlm;
+            }
+            b"T*" => next_line(&mut tm, &mut tlm, 0.0, -state.leading),
+            b"Tj" | b"'" | b"\"" => {
+                if op.name == b"\"" {
+                    state.word_space = num(0);
+                    state.char_space = num(1);
+                    if let (Some(content), [(ws, we), (cs, ce), ..]) =
+                        (out.as_mut(), op.operands.as_slice())
+                    {
+                        content.extend_from_slice(&data[*ws..*we]);
+                        content.extend_from_slice(b" Tw ");
+                        content.extend_from_slice(&data[*cs..*ce]);
+                        content.extend_from_slice(b" Tc\n");
+                    }
+                }
+                if op.name != b"Tj" {
+                    next_line(&mut tm, &mut tlm, 0.0, -state.leading);
+                }
+                let shown = op.operands.last().and_then(|&span| string(data, span));
+                if !shown.is_some_and(|bytes| state.show(&bytes, &mut tm, out.as_mut())) {
+                    out = None;
+                }
+            }
+            b"TJ" => {
+                for &span in &op.operands {
+                    if let Some(bytes) = string(data, span) {
+                        if !state.show(&bytes, &mut tm, out.as_mut()) {
+                            out = None;
+                        }
+                    } else if let Some(n) = std::str::from_utf8(&data[span.0..span.1])
+                        .ok()
+                        .and_then(|t| t.parse::<f32>().ok())
+                    {
+                        let tx = -n / 1000.0 * state.size * state.scale;
+                        tm = Matrix::translate(tx, 0.0).concat(&tm);
+                    }
+                }
+            }
+            name => {
+                match name {
+                    b"q" => saved.push(state.clone()),
+                    b"Q" => {
+                        if let Some(outer) = saved.pop() {
+                            *state = outer;
+                        }
+                    }
+                    _ => {
+                        state.apply(data, op, fonts);
+                    }
+                }
+                if let Some(content) = out.as_mut() {
+                    content.extend_from_slice(&data[op.start..op.end]);
+                    content.push(b'\n');
+                }
+            }
+        }
+    }
+    out
+}
+
+/// Content stream `data` with each text object that can be drawn
+/// replaced by what it draws, or `None` if none can
+fn vectorize_content(data: &[u8], fonts: &Fonts) -> Option<Vec<u8>> {
+    let ops = operators(data);
+    let mut out = Vec::with_capacity(data.len());
+    let mut state = TextState::default();
+    let mut saved = Vec::new();
+    // Bytes of `data` copied to `out` so far
+    let mut copied = 0;
+    let mut changed = false;
+    let mut i = 0;
+    while i < ops.len() {
+        let op = &ops[i];
+        match op.name {
+            b"BT" => {
+                let end = ops[i + 1..]
+                    .iter()
+                    .position(|o| o.name == b"ET")
+                    .map(|p| i + 1 + p);
+                let body = &ops[i + 1..end.unwrap_or(ops.len())];
+                let drawn = draw_text(data, body, &mut state, &mut saved, fonts);
+                if let (Some(drawn), Some(end)) = (drawn, end) {
+                    out.extend_from_slice(&data[copied..op.start]);
+                    out.extend_from_slice(&drawn);
+                    copied = ops[end].end;
+                    changed = true;
+                }
+                i = end.map_or(ops.len(), |e| e + 1);
+                continue;
+            }
+            b"q" => saved.push(state.clone()),
+            b"Q" => {
+                if let Some(outer) = saved.pop() {
+                    state = outer;
+                }
+            }
+            _ => {
+                state.apply(data, op, fonts);
+            }
+        }
+        i += 1;
+    }
+    out.extend_from_slice(&data[copied..]);
+    changed.then_some(out)
+}
+
+/// A page's content streams, as read from the source, and its fonts
+struct PageText {
+    streams: Vec<(i32, ParsedValue, Bytes)>,
+    fonts: Fonts,
+}
+
+/// The content of `page`, all in its first stream, with its text drawn
+/// as paths; `None` if nothing changed
+fn vectorize_page(page: &PageText) -> Option<Vec<(i32, (ParsedValue, Bytes))>> {
+    let mut content = Vec::new();
+    for (_, dict, raw) in &page.streams {
+        content.extend_from_slice(&decode_stream(dict, raw)?);
+        content.push(b'\n');
+    }
+    let content = vectorize_content(&content, &page.fonts)?;
+    let encoded = encode_flate(&content, 6).ok()?;
+
+    let mut edits = Vec::with_capacity(page.streams.len());
+    for (k, (num, dict, _)) in page.streams.iter().enumerate() {
+        let mut dict = dict.clone();
+        for key in ["DecodeParms", "DL", "Filter"] {
+            set_key(&mut dict, key, None);
+        }
+        let data = if k == 0 {
+            set_key(
+                &mut dict,
+                "Filter",
+                Some(ParsedValue::Name("FlateDecode".into())),
+            );
+            Bytes::from(encoded.clone())
+        } else {
+            Bytes::new()
+        };
+        set_key(
+            &mut dict,
+            "Length",
+            Some(ParsedValue::Int(data.len() as i64)),
+        );
+        edits.push((*num, (dict, data)));
+    }
+    Some(edits)
+}
+
+/// Draw the text of `pages` (page indices; `None` for every page) of
+/// document `doc` as paths, on `threads` threads
+///
+/// The document's data is replaced if anything changed. Returns the
+/// number of pages changed.
+pub(crate) fn vectorize_pages(doc: Handle, pages: Option<&[i32]>, threads: usize) -> i32 {
+    let Some(data) = DOCUMENTS.get(doc).map(|d| d.lock().unwrap().data()) else {
+        return 0;
+    };
+    let Some(mut xref) = open_source(&data, threads) else {
+        return 0;
+    };
+    xref.read_all_sections();
+    // Encrypted streams can't be read without decrypting them
+    if xref
+        .source_trailer()
+        .is_none_or(|t| dict_get(t, "Encrypt").is_some())
+    {
+        return 0;
+    }
+    let pages: Vec<i32> = match pages {
+        Some(pages) => pages
+            .iter()
+            .filter_map(|&i| xref.lazy_page_object(i))
+            .collect(),
+        None => (0..).map_while(|i| xref.lazy_page_object(i)).collect(),
+    };
+
+    // Each page claims its content streams if no earlier page has
+    let mut loader = FontLoader::default();
+    let mut claimed = HashSet::new();
+    let mut work = Vec::with_capacity(pages.len());
+    for page in pages {
+        let contents = xref
+            .fetch(page)
+            .and_then(|p| dict_get(&p.value, "Contents").cloned());
+        let nums: Vec<i32> = match contents.as_ref().and_then(|c| resolve(&mut xref, c)) {
+            Some(ParsedValue::Array(items)) => items.iter().filter_map(as_ref).collect(),
+            _ => contents.as_ref().and_then(as_ref).into_iter().collect(),
+        };
+        if nums.is_empty() || nums.iter().any(|num| claimed.contains(num)) {
+            continue;
+        }
+        claimed.extend(nums.iter().copied());
+        let streams: Option<Vec<_>> = nums
+            .iter()
+            .map(|&num| {
+                let fetched = xref.fetch(num)?;
+                Some((num, fetched.value, fetched.stream?))
+            })
+            .collect();
+        let Some(streams) = streams else {
+            continue;
+        };
+        let fonts = match inherited(&mut xref, page, "Resources") {
+            Some(resources) => loader.page_fonts(&mut xref, &resources),
+            None => Fonts::new(),
+        };
+        if !fonts.is_empty() {
+            work.push(PageText { streams, fonts });
+        }
+    }
+
+    let converted = parallel_map(&work, threads, vectorize_page);
+    let mut edits = Edits::default();
+    let mut changed = 0;
+    for page in converted.into_iter().flatten() {
+        edits.streams.extend(page);
+        changed += 1;
+    }
+    if changed == 0 {
+        return 0;
+    }
+    let settings = WriteSettings {
+        compress: false,
+        decompress: false,
+        threads,
+        ..WriteSettings::default()
+    };
+    let mut out = Vec::new();
+    let saved = matches!(
+        write_opened(xref, &settings, &edits, &mut out),
+        Some(Ok(()))
+    );
+    match DOCUMENTS.get(doc).filter(|_| saved) {
+        Some(d) => {
+            d.lock().unwrap().replace_data(out);
+            pdf_purge_content_program_cache(0, doc);
+            fz_purge_display_list_cache(0, doc);
+            changed
+        }
+        None => 0,
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::document::Document;
+    use crate::ffi::pdf_image_rewriter::tests::{pdf_with, stream};
+    use crate::fitz::font_cache::tests::{sfnt_with, triangle};
+
+    #[test]
+    fn test_vectorize_type3_text() {
+        let procs = HashMap::from([(97, Arc::from(&b"0 0 1000 1000 re f"[..]))]);
+        let font = VectorFont {
+            two_byte: false,
+            widths: HashMap::from([(97, 0.5)]),
+            default_width: 0.0,
+            glyphs: Glyphs::Procedures {
+                matrix: Matrix::scale(0.001, 0.001),
+                procs,
+            },
+        };
+        let fonts = Fonts::from([("T3".to_string(), Arc::new(font))]);
+
+        // Invisible text only moves the pen; a glyph without a procedure
+        // draws nothing
+        let content = b"q BT /T3 2 Tf 1 0 0 1 10 20 Tm 3 Tr (a) Tj 0 Tr (ab) Tj ET Q";
+        assert_eq!(
+            vectorize_content(content, &fonts).unwrap(),
+            b"q /T3 2 Tf\n3 Tr\n0 Tr\nq\n0.002 0 0 0.002 11 20 cm\n0 0 1000 1000 re f\nQ\n Q"
+        );
+        // Clipping text, and text in fonts that can't be drawn, stay
+        assert_eq!(
+            vectorize_content(b"BT /T3 2 Tf 7 Tr (a) Tj ET", &fonts),
+            None
+        );
+        assert_eq!(vectorize_content(b"BT /F1 2 Tf (a) Tj ET", &fonts), None);
+    }
+
+    #[test]
+    fn test_vectorize_pages_draws_truetype_text() {
+        let glyf = triangle();
+        let loca: Vec<u8> = [0u16, 0, 15].iter().flat_map(|v| v.to_be_bytes()).collect();
+        let program = sfnt_with(1000, &[1000], 2, vec![(b"glyf", glyf), (b"loca", loca)]);
+        let data = pdf_with(&[
+            b"<< /Type /Catalog /Pages 2 0 R >>".to_vec(),
+            b"<< /Type /Pages /Kids [3 0 R] /Count 1 >>".to_vec(),
+            b"<< /Type /Page /Parent 2 0 R /Contents [4 0 R 9 0 R] \
+               /Resources << /Font << /F0 5 0 R /F1 8 0 R >> >> >>"
+                .to_vec(),
+            stream("", b"0 0 1 rg BT /F0 10 Tf 100 200 Td <0001"),
+            b"<< /Type /Font /Subtype /Type0 /BaseFont /Test /Encoding /Identity-H \
+               /DescendantFonts [6 0 R] >>"
+                .to_vec(),
+            b"<< /Type /Font /Subtype /CIDFontType2 /BaseFont /Test \
+               /CIDSystemInfo << /Registry (Adobe) /Ordering (Identity) /Supplement 0 >> \
+               /FontDescriptor 7 0 R /W [1 [500]] >>"
+                .to_vec(),
+            b"<< /Type /FontDescriptor /FontName /Test /FontFile2 10 0 R >>".to_vec(),
+            b"<< /Type /Font /Subtype /Type1 /BaseFont /Helvetica >>".to_vec(),
+            stream("", b"0001> Tj ET BT /F1 12 Tf (x) Tj ET"),
+            stream(&format!("/Length1 {}", program.len()), &program),
+        ]);
+        let doc = DOCUMENTS.insert(Document::new(data));
+        assert_eq!(vectorize_pages(doc, None, 4), 1);
+
+        let data = DOCUMENTS.get(doc).unwrap().lock().unwrap().data();
+        let mut xref = Xref::open_lazy(0, data).unwrap();
+        let content = |xref: &mut Xref, num| {
+            let f = xref.fetch(num).unwrap();
+            decode_stream(&f.value, f.stream.as_ref().unwrap()).unwrap()
+        };
+        assert_eq!(
+            content(&mut xref, 4),
+            b"0 0 1 rg /F0 10 Tf\n\
+              100 200 m\n101 200 l\n101 200.667 100.667 200.667 100 200 c\nh\n\
+              105 200 m\n106 200 l\n106 200.667 105.667 200.667 105 200 c\nh\nf\n \
+              BT /F1 12 Tf (x) Tj ET\n"
+        );
+        assert!(content(&mut xref, 9).is_empty());
+
+        // Nothing is left to draw
+        assert_eq!(vectorize_pages(doc, None, 1), 0);
+        DOCUMENTS.remove(doc);
+    }
+}
@@ -0,0 +1,1009 @@
+//! Full PDF Rewrite
+//!
+//! Writes a document out again from its objects, for saves that aren't
+//! incremental. Stream filtering dominates the cost, and streams don't
+//! depend on each other, so objects are taken in windows: every stream in
+//! a window is (de)compressed on a pool of threads, then the window is
+//! written in object order. The window closes once its stream data
+//! reaches the in-flight cap, which bounds memory on large files.
+//!
+//! Output is streamed: each object goes to the sink as soon as it is
+//! serialized and only the xref offsets table is kept, so with a cap of
+//! one byte the peak is about the largest single object.
+
+use super::buffered_io::VectoredWriter;
+use super::mmap::FileBytes;
+use super::pdf_clean::WriteOptions;
+use super::pdf_dedup::duplicate_objects;
+use super::pdf_gc::{mark_reachable, sweep};
+use super::pdf_objstm::{Packer, XrefRow, write_xref_stream};
+use super::pdf_parse::ParsedValue;
+use super::pdf_stream_prefetch::parallel_map;
+use super::pdf_xref::{PDF_XREF_INUSE, Xref};
+use super::pdf_xref_lazy::{XrefSource, decode_stream, dict_get, is_name};
+use crate::fitz::cookie::Cookie;
+use crate::fitz::output::{push_int, push_padded, push_real};
+use crate::pdf::filter::{
+    BROTLI_DICTIONARY_KEY, brotli_dictionary, encode_brotli, encode_flate,
+    format_brotli_dictionary_id,
+};
+use bytes::Bytes;
+use std::borrow::Cow;
+use std::collections::{HashMap, HashSet};
+use std::io::{self, Write};
+use std::sync::Arc;
+
+/// Stream bytes a window holds before it is written out
+pub const DEFAULT_INFLIGHT_BYTES: usize = 64 << 20;
+
+/// How streams are transformed on the way out
+#[derive(Debug, Clone, Copy)]
+pub struct WriteSettings {
+    pub compress: bool,
+    pub compress_images: bool,
+    pub compress_fonts: bool,
+    pub decompress: bool,
+    /// Drop objects the trailer can't reach
+    pub garbage: bool,
+    /// Write objects that come out the same only once
+    pub dedup: bool,
+    /// Number the objects written 1, 2, 3, ... with no gaps
+    pub renumber: bool,
+    /// Pack plain objects into object streams, with an xref stream
+    pub objstms: bool,
+    /// Cut embedded TrueType CID fonts down to the glyphs shown (optimize)
+    pub subset_fonts: bool,
+    /// Write streams as Brotli rather than Flate
+    pub brotli: bool,
+    /// Registered dictionary Brotli streams are compressed against
+    pub brotli_dictionary: Option<u64>,
+    /// Deflate level, 0-9
+    pub level: u32,
+    /// Threads for stream filtering (0 = one per core)
+    pub threads: usize,
+    /// Stream bytes per write window
+    pub inflight_bytes: usize,
+}
+
+impl Default for WriteSettings {
+    fn default() -> Self {
+        Self::from(&WriteOptions::new())
+    }
+}
+
+impl From<&WriteOptions> for WriteSettings {
+    fn from(opts: &WriteOptions) -> Self {
+        let level = match opts.compression_effort {
+            n if n <= 0 => 6,
+            n => 1 + (n.min(100) as u32 * 8) / 100,
+        };
+        Self {
+            compress: opts.do_compress != 0,
+            compress_images: opts.do_compress_images != 0,
+            compress_fonts: opts.do_compress_fonts != 0,
+            decompress: opts.do_decompress != 0,
+            garbage: opts.do_garbage != 0,
+            renumber: opts.do_garbage >= 2,
+            dedup: opts.do_garbage >= 3,
+            objstms: opts.do_use_objstms != 0,
+            subset_fonts: false,
+            brotli: opts.do_compress == 2,
+            brotli_dictionary: (opts.brotli_dictionary != 0).then_some(opts.brotli_dictionary),
+            level,
+            threads: 0,
+            inflight_bytes: DEFAULT_INFLIGHT_BYTES,
+        }
+    }
+}
+
+// ============================================================================
+// Serialization
+// ============================================================================
+
+fn is_delimiter(b: u8) -> bool {
+    matches!(
+        b,
+        b'(' | b')' | b'<' | b'>' | b'[' | b']' | b'{' | b'}' | b'/' | b'%'
+    )
+}
+
+pub(crate) fn write_name(name: &str, out: &mut Vec<u8>) {
+    out.push(b'/');
+    for &b in name.as_bytes() {
+        if (0x21..=0x7e).contains(&b) && b != b'#' && !is_delimiter(b) {
+            out.push(b);
+        } else {
+            out.extend_from_slice(format!("#{b:02X}").as_bytes());
+        }
+    }
+}
+
+/// Append `num generation obj` and a newline
+fn write_obj_header(num: i32, generation: u16, out: &mut Vec<u8>) {
+    push_int(out, num.into());
+    out.push(b' ');
+    push_int(out, generation.into());
+    out.extend_from_slice(b" obj\n");
+}
+
+pub(crate) fn write_string(s: &[u8], out: &mut Vec<u8>) {
+    out.push(b'(');
+    for &b in s {
+        match b {
+            b'(' | b')' | b'\\' => out.extend_from_slice(&[b'\\', b]),
+            b'\r' => out.extend_from_slice(b"\\r"),
+            b'\n' => out.extend_from_slice(b"\\n"),
+            _ => out.push(b),
+        }
+    }
+    out.push(b')');
+}
+
+/// Append `value` in PDF syntax
+pub fn write_value(value: &ParsedValue, out: &mut Vec<u8>) {
+    write_value_with(value, out, &mut |num, generation, out| {
+        push_int(out, num.into());
+        out.push(b' ');
+        push_int(out, generation.into());
+        out.extend_from_slice(b" R");
+    });
+}
+
+/// Append `value` in PDF syntax, letting `on_ref` write each reference
+pub(crate) fn write_value_with(
+    value: &ParsedValue,
+    out: &mut Vec<u8>,
+    on_ref: &mut dyn FnMut(i32, i32, &mut Vec<u8>),
+) {
+    match value {
+        ParsedValue::Null => out.extend_from_slice(b"null"),
+        ParsedValue::Bool(b) => out.extend_from_slice(if *b { b"true" } else { b"false" }),
+        ParsedValue::Int(i) => push_int(out, *i),
+        ParsedValue::Real(r) => push_real(out, *r),
+        ParsedValue::String(s) => write_string(s, out),
+        ParsedValue::Name(n) => write_name(n, out),
+        ParsedValue::Array(items) => {
+            out.push(b'[');
+            for (i, item) in items.iter().enumerate() {
+                if i > 0 {
+                    out.push(b' ');
+                }
+                write_value_with(item, out, on_ref);
+            }
+            out.push(b']');
+        }
+        ParsedValue::Dict(entries) => {
+            out.extend_from_slice(b"<<");
+            for (key, value) in entries {
+                write_name(key, out);
+                out.push(b' ');
+                write_value_with(value, out, on_ref);
+            }
+            out.extend_from_slice(b">>");
+        }
+        ParsedValue::Reference { num, generation } => on_ref(*num, *generation, out),
+    }
+}
+
+// ============================================================================
+// Stream Filtering
+// ============================================================================
+
+/// An object read for writing
+struct Job {
+    /// Number written, after any renumbering
+    num: i32,
+    generation: u16,
+    value: ParsedValue,
+    stream: Option<Bytes>,
+}
+
+pub(crate) fn set_key(dict: &mut ParsedValue, key: &str, value: Option<ParsedValue>) {
+    if let ParsedValue::Dict(entries) = dict {
+        entries.retain(|(k, _)| k != key);
+        if let Some(value) = value {
+            entries.push((key.to_string(), value));
+        }
+    }
+}
+
+fn is_font_stream(dict: &ParsedValue) -> bool {
+    dict_get(dict, "Length1").is_some()
+        || ["Type1C", "CIDFontType0C", "OpenType"]
+            .iter()
+            .any(|s| is_name(dict_get(dict, "Subtype"), s))
+}
+
+/// Compress a stream's data, with the filter and DecodeParms that undo it
+fn encode_stream(
+    data: &[u8],
+    settings: &WriteSettings,
+) -> Option<(&'static str, Option<ParsedValue>, Vec<u8>)> {
+    if !settings.brotli {
+        let packed = encode_flate(data, settings.level).ok()?;
+        return Some(("FlateDecode", None, packed));
+    }
+    // Deflate's 0-9 maps onto Brotli's 0-11, and an unregistered
+    // dictionary falls back to none rather than writing unreadable streams
+    let quality = (settings.level + 2).min(11);
+    let dictionary = settings
+        .brotli_dictionary
+        .and_then(|id| Some((id, brotli_dictionary(id)?)));
+    let packed = encode_brotli(data, quality, dictionary.as_ref().map(|(_, d)| &d[..])).ok()?;
+    let params = dictionary.map(|(id, _)| {
+        ParsedValue::Dict(vec![(
+            BROTLI_DICTIONARY_KEY.into(),
+            ParsedValue::String(format_brotli_dictionary_id(id).into_bytes()),
+        )])
+    });
+    Some(("BrotliDecode", params, packed))
+}
+
+/// Re-filter one stream's data per `settings`, updating its dictionary
+///
+/// Streams left as they are come back as the same `Bytes`, still pointing
+/// into the source file. `encrypted` streams are always left alone, since
+/// their data can't be filtered without decrypting it.
+fn filter_stream(
+    dict: &ParsedValue,
+    raw: &Bytes,
+    settings: &WriteSettings,
+    encrypted: bool,
+) -> (ParsedValue, Bytes) {
+    let mut dict = dict.clone();
+    let mut data = raw.clone();
+
+    if !encrypted {
+        let filtered = dict_get(&dict, "Filter").is_some();
+        let compress = settings.compress
+            && (settings.compress_images || !is_name(dict_get(&dict, "Subtype"), "Image"))
+            && (settings.compress_fonts || !is_font_stream(&dict));
+
+        let plain = match filtered {
+            false if compress => Some(Cow::Borrowed(&raw[..])),
+            true if settings.decompress => decode_stream(&dict, raw).map(Cow::Owned),
+            _ => None,
+        };
+        if let Some(plain) = plain {
+            let packed = compress.then(|| encode_stream(&plain, settings)).flatten();
+            let decoded_len = plain.len() as i64;
+            let (filter, params, bytes) = match packed {
+                Some((filter, params, packed)) => {
+                    (Some(ParsedValue::Name(filter.into())), params, packed)
+                }
+                None => (None, None, plain.into_owned()),
+            };
+            set_key(&mut dict, "DecodeParms", params);
+            set_key(
+                &mut dict,
+                "DL",
+                filter.is_some().then_some(ParsedValue::Int(decoded_len)),
+            );
+            set_key(&mut dict, "Filter", filter);
+            data = Bytes::from(bytes);
+        }
+    }
+
+    set_key(
+        &mut dict,
+        "Length",
+        Some(ParsedValue::Int(data.len() as i64)),
+    );
+    (dict, data)
+}
+
+// ============================================================================
+// Document Writer
+// ============================================================================
+
+/// Where a rewrite goes; each object is handed over as soon as it is
+/// serialized, so only the xref offsets stay behind
+pub trait PdfSink {
+    fn put(&mut self, bytes: &[u8]) -> io::Result<()>;
+
+    /// Hand over shared bytes, for sinks that can keep them without a copy
+    fn put_bytes(&mut self, bytes: Bytes) -> io::Result<()> {
+        self.put(&bytes)
+    }
+
+    fn finish(&mut self) -> io::Result<()>;
+}
+
+impl<W: Write> PdfSink for W {
+    fn put(&mut self, bytes: &[u8]) -> io::Result<()> {
+        self.write_all(bytes)
+    }
+
+    fn finish(&mut self) -> io::Result<()> {
+        self.flush()
+    }
+}
+
+/// Sink queueing each object's header, stream data and trailer on a
+/// vectored writer as separate buffers; unchanged stream data goes from
+/// the source file to `writev` without being copied
+pub struct Queued<'a>(pub &'a mut VectoredWriter);
+
+impl PdfSink for Queued<'_> {
+    fn put(&mut self, bytes: &[u8]) -> io::Result<()> {
+        self.0.queue_slice(bytes)
+    }
+
+    fn put_bytes(&mut self, bytes: Bytes) -> io::Result<()> {
+        self.0.queue_bytes(bytes)
+    }
+
+    fn finish(&mut self) -> io::Result<()> {
+        self.0.flush()
+    }
+}
+
+/// Sink that tracks how many bytes went through it
+pub(crate) struct Counting<S> {
+    pub(crate) inner: S,
+    pub(crate) pos: usize,
+}
+
+impl<S: PdfSink> Counting<S> {
+    pub(crate) fn new(inner: S) -> Self {
+        Self { inner, pos: 0 }
+    }
+
+    /// Write the file header for PDF `version` (e.g. 17)
+    pub(crate) fn put_header(&mut self, version: i32) -> io::Result<()> {
+        let version = version.max(10);
+        self.put(format!("%PDF-{}.{}\n", version / 10, version % 10).as_bytes())?;
+        self.put(b"%\xE2\xE3\xCF\xD3\n")
+    }
+
+    pub(crate) fn put(&mut self, bytes: &[u8]) -> io::Result<()> {
+        self.inner.put(bytes)?;
+        self.pos += bytes.len();
+        Ok(())
+    }
+
+    pub(crate) fn put_bytes(&mut self, bytes: Bytes) -> io::Result<()> {
+        self.pos += bytes.len();
+        self.inner.put_bytes(bytes)
+    }
+}
+
+/// Objects to write, in object number order
+fn object_numbers(xref: &mut Xref, trailer: &ParsedValue, settings: &WriteSettings) -> Vec<i32> {
+    // Everything reachable from the trailer, through /Parent too
+    let marks = settings
+        .garbage
+        .then(|| mark_reachable(xref, trailer, settings.threads));
+    sweep(xref, marks.as_ref(), settings.threads)
+}
+
+/// Whether an object only describes the old file's layout
+pub(crate) fn is_layout_object(value: &ParsedValue) -> bool {
+    is_name(dict_get(value, "Type"), "ObjStm")
+        || is_name(dict_get(value, "Type"), "XRef")
+        || dict_get(value, "Linearized").is_some()
+}
+
+/// Open `data` lazily, rebuilding the xref by scanning if that fails
+pub(crate) fn open_source(data: &Arc<FileBytes>, threads: usize) -> Option<Xref> {
+    match Xref::open_lazy(0, Arc::clone(data)) {
+        Some(xref) => Some(xref),
+        None => {
+            let (mut xref, trailer) = Xref::repair(0, data, threads)?;
+            xref.source = Some(XrefSource::new(Arc::clone(data), trailer));
+            Some(xref)
+        }
+    }
+}
+
+/// Write the document in `data` out again as a new file
+///
+/// Object streams and xref streams are unpacked into plain objects and a
+/// classic xref table. Returns `None` if the document can't be read.
+pub fn write_document<S: PdfSink>(
+    data: Arc<FileBytes>,
+    settings: &WriteSettings,
+    out: S,
+) -> Option<io::Result<()>> {
+    let xref = open_source(&data, settings.threads)?;
+    write_opened(xref, settings, &Edits::default(), out)
+}
+
+/// Changes a rewrite makes to the source on the way out
+#[derive(Default)]
+pub(crate) struct Edits<'a> {
+    /// Objects written with this dictionary and stream data instead of
+    /// their own; references must be unchanged, since the walk for
+    /// garbage collection reads the source
+    pub(crate) streams: HashMap<i32, (ParsedValue, Bytes)>,
+    /// Objects without streams written with this value instead of their
+    /// own, under the same condition
+    pub(crate) objects: HashMap<i32, ParsedValue>,
+    /// Objects the source doesn't have, numbered past its last and written
+    /// after everything else; only reachable if an edited object points at
+    /// them, so they don't mix with garbage collection either
+    pub(crate) added: Vec<(i32, ParsedValue)>,
+    /// Streams the source doesn't have, numbered and written like `added`
+    /// and filtered like every other stream
+    pub(crate) added_streams: Vec<(i32, ParsedValue, Bytes)>,
+    /// Objects left out of the rewrite
+    pub(crate) removed: HashSet<i32>,
+    /// Checked before each window; an abort stops the rewrite with an
+    /// `Interrupted` error
+    pub(crate) cookie: Option<&'a Cookie>,
+}
+
+/// [`write_document`] over an xref already opened on the source
+pub(crate) fn write_opened<S: PdfSink>(
+    mut xref: Xref,
+    settings: &WriteSettings,
+    edits: &Edits,
+    out: S,
+) -> Option<io::Result<()>> {
+    xref.read_all_sections();
+    let trailer = xref.source_trailer()?.clone();
+    let encrypted = dict_get(&trailer, "Encrypt").is_some();
+    let mut nums = object_numbers(&mut xref, &trailer, settings);
+
+    // Encrypted data is keyed to its object number, so equal bytes in two
+    // objects don't mean equal content, and objects can't be renumbered
+    let mut moved = HashMap::new();
+    if settings.dedup && !encrypted {
+        for (num, keep) in duplicate_objects(&mut xref, &nums, settings.threads) {
+            let generation = xref
+                .get_entry(keep)
+                .filter(|e| e.entry_type == PDF_XREF_INUSE)
+                .map_or(0, |e| e.generation);
+            moved.insert(num, (keep, generation));
+        }
+        nums.retain(|num| !moved.contains_key(num));
+    }
+    if settings.renumber && !encrypted {
+        let numbering: HashMap<i32, (i32, u16)> = nums
+            .iter()
+            .zip(1..)
+            .map(|(&num, new)| (num, (new, 0)))
+            .collect();
+        for target in moved.values_mut() {
+            if let Some(&renumbered) = numbering.get(&target.0) {
+                *target = renumbered;
+            }
+        }
+        moved.extend(numbering);
+    }
+
+    let mut out = Counting::new(out);
+    Some(write_objects(
+        &mut xref, &trailer, &nums, &moved, settings, edits, encrypted, &mut out,
+    ))
+}
+
+/// Point references to moved objects (merged into another, or renumbered)
+/// at their new number
+fn redirect(value: &mut ParsedValue, moved: &HashMap<i32, (i32, u16)>) {
+    match value {
+        ParsedValue::Reference { num, generation } => {
+            if let Some(&(new, new_generation)) = moved.get(num) {
+                *num = new;
+                *generation = i32::from(new_generation);
+            }
+        }
+        ParsedValue::Array(items) => items.iter_mut().for_each(|v| redirect(v, moved)),
+        ParsedValue::Dict(entries) => entries.iter_mut().for_each(|(_, v)| redirect(v, moved)),
+        _ => {}
+    }
+}
+
+#[allow(clippy::too_many_arguments)]
+fn write_objects<S: PdfSink>(
+    xref: &mut Xref,
+    trailer: &ParsedValue,
+    nums: &[i32],
+    moved: &HashMap<i32, (i32, u16)>,
+    settings: &WriteSettings,
+    edits: &Edits,
+    encrypted: bool,
+    out: &mut Counting<S>,
+) -> io::Result<()> {
+    // Encrypted files would need their packed objects encrypted as a whole
+    let mut packer = (settings.objstms && !encrypted).then(Packer::default);
+    let version = match packer {
+        Some(_) => xref.version.max(15),
+        None => xref.version,
+    };
+    out.put_header(version)?;
+
+    let size = nums
+        .iter()
+        .map(|n| moved.get(n).map_or(*n, |m| m.0) + 1)
+        .chain(edits.added.iter().map(|(n, _)| n + 1))
+        .chain(edits.added_streams.iter().map(|(n, ..)| n + 1))
+        .max()
+        .unwrap_or(1);
+    let mut offsets: Vec<Option<(usize, u16)>> = vec![None; size as usize];
+    let mut buf = Vec::new();
+    let mut rest = nums;
+
+    while !rest.is_empty() {
+        if edits.cookie.is_some_and(Cookie::should_abort) {
+            return Err(io::Error::new(
+                io::ErrorKind::Interrupted,
+                "rewrite aborted",
+            ));
+        }
+        // Read a window of objects, up to the in-flight cap
+        let mut jobs = Vec::new();
+        let mut inflight = 0;
+        while let Some((&num, tail)) = rest.split_first() {
+            if !jobs.is_empty() && inflight >= settings.inflight_bytes {
+                break;
+            }
+            rest = tail;
+            if edits.removed.contains(&num) {
+                continue;
+            }
+            let (out_num, generation) = moved.get(&num).copied().unwrap_or_else(|| {
+                let generation = xref
+                    .get_entry(num)
+                    .filter(|e| e.entry_type == PDF_XREF_INUSE)
+                    .map_or(0, |e| e.generation);
+                (num, generation)
+            });
+            let Some(mut fetched) = xref.fetch(num) else {
+                continue;
+            };
+            if let Some((dict, data)) = edits.streams.get(&num) {
+                fetched.value = dict.clone();
+                fetched.stream = Some(data.clone());
+            } else if let Some(value) = edits.objects.get(&num) {
+                fetched.value = value.clone();
+            }
+            if is_layout_object(&fetched.value) {
+                continue;
+            }
+            if !moved.is_empty() {
+                redirect(&mut fetched.value, moved);
+            }
+            inflight += fetched.stream.as_ref().map_or(0, Bytes::len);
+            jobs.push(Job {
+                num: out_num,
+                generation,
+                value: fetched.value,
+                stream: fetched.stream,
+            });
+        }
+
+        let streams = parallel_map(&jobs, settings.threads, |job| {
+            job.stream
+                .as_ref()
+                .map(|raw| filter_stream(&job.value, raw, settings, encrypted))
+        });
+
+        for (job, stream) in jobs.iter().zip(streams) {
+            if let Some(packer) = packer.as_mut() {
+                packer.link(job.num, &job.value);
+                if stream.is_none() && job.generation == 0 {
+                    packer.hold(job.num, &job.value);
+                    continue;
+                }
+            }
+            offsets[job.num as usize] = Some((out.pos, job.generation));
+            buf.clear();
+            write_obj_header(job.num, job.generation, &mut buf);
+            match stream {
+                Some((dict, data)) => {
+                    write_value(&dict, &mut buf);
+                    buf.extend_from_slice(b"\nstream\n");
+                    out.put(&buf)?;
+                    out.put_bytes(data)?;
+                    out.put_bytes(Bytes::from_static(b"\nendstream\nendobj\n"))?;
+                }
+                None => {
+                    write_value(&job.value, &mut buf);
+                    buf.extend_from_slice(b"\nendobj\n");
+                    out.put(&buf)?;
+                }
+            }
+        }
+    }
+
+    for (num, value) in &edits.added {
+        let mut value = value.clone();
+        if !moved.is_empty() {
+            redirect(&mut value, moved);
+        }
+        if let Some(packer) = packer.as_mut() {
+            packer.link(*num, &value);
+            packer.hold(*num, &value);
+            continue;
+        }
+        offsets[*num as usize] = Some((out.pos, 0));
+        buf.clear();
+        write_obj_header(*num, 0, &mut buf);
+        write_value(&value, &mut buf);
+        buf.extend_from_slice(b"\nendobj\n");
+        out.put(&buf)?;
+    }
+    for (num, dict, raw) in &edits.added_streams {
+        let (mut dict, data) = filter_stream(dict, raw, settings, encrypted);
+        if !moved.is_empty() {
+            redirect(&mut dict, moved);
+        }
+        if let Some(packer) = packer.as_mut() {
+            packer.link(*num, &dict);
+        }
+        offsets[*num as usize] = Some((out.pos, 0));
+        buf.clear();
+        write_obj_header(*num, 0, &mut buf);
+        write_value(&dict, &mut buf);
+        buf.extend_from_slice(b"\nstream\n");
+        out.put(&buf)?;
+        out.put_bytes(data)?;
+        out.put_bytes(Bytes::from_static(b"\nendstream\nendobj\n"))?;
+    }
+
+    let new_trailer = ["Root", "Info", "ID", "Encrypt"]
+        .into_iter()
+        .filter_map(|key| {
+            let mut value = dict_get(trailer, key)?.clone();
+            redirect(&mut value, moved);
+            Some((key.to_string(), value))
+        })
+        .collect();
+    match packer {
+        Some(packer) => {
+            let pages: Vec<i32> = (0..)
+                .map_while(|i| xref.lazy_page_object(i))
+                .map(|num| moved.get(&num).map_or(num, |m| m.0))
+                .collect();
+            // New streams, so only an explicit decompress leaves them plain
+            let compress = (!settings.decompress).then_some(settings.level);
+            let streams = packer.pack(&pages, size, compress, settings.threads);
+            let mut rows: Vec<XrefRow> = offsets
+                .iter()
+                .map(|o| {
+                    o.map_or(XrefRow::Free, |(at, generation)| {
+                        XrefRow::Offset(at, generation)
+                    })
+                })
+                .collect();
+            for stream in streams {
+                rows.resize(rows.len().max(stream.num as usize + 1), XrefRow::Free);
+                rows[stream.num as usize] = XrefRow::Offset(out.pos, 0);
+                for (index, &member) in stream.members.iter().enumerate() {
+                    rows[member as usize] = XrefRow::Packed(stream.num, index as u16);
+                }
+                buf.clear();
+                write_obj_header(stream.num, 0, &mut buf);
+                write_value(&stream.dict, &mut buf);
+                buf.extend_from_slice(b"\nstream\n");
+                out.put(&buf)?;
+                out.put(&stream.data)?;
+                out.put(b"\nendstream\nendobj\n")?;
+            }
+            write_xref_stream(out, rows, new_trailer, compress)
+        }
+        None => write_xref(out, &offsets, new_trailer),
+    }
+}
+
+/// Finish a file with a classic xref table over `offsets` (indexed by
+/// object number, slot 0 unused) and a trailer holding `/Size` and
+/// `trailer`'s entries, then flush the sink
+pub(crate) fn write_xref<S: PdfSink>(
+    out: &mut Counting<S>,
+    offsets: &[Option<(usize, u16)>],
+    trailer: Vec<(String, ParsedValue)>,
+) -> io::Result<()> {
+    let size = offsets.len().max(1);
+    let xref_offset = out.pos;
+    // Every row is 20 bytes
+    let mut buf = Vec::with_capacity(size * 20 + 256);
+    buf.extend_from_slice(format!("xref\n0 {size}\n0000000000 65535 f \n").as_bytes());
+    for entry in offsets.iter().skip(1) {
+        match entry {
+            Some((offset, generation)) => {
+                push_padded(&mut buf, *offset as u64, 10);
+                buf.push(b' ');
+                push_padded(&mut buf, (*generation).into(), 5);
+                buf.extend_from_slice(b" n \n");
+            }
+            None => buf.extend_from_slice(b"0000000000 00000 f \n"),
+        }
+    }
+
+    let mut dict = vec![("Size".to_string(), ParsedValue::Int(size as i64))];
+    dict.extend(trailer);
+    buf.extend_from_slice(b"trailer\n");
+    write_value(&ParsedValue::Dict(dict), &mut buf);
+    buf.extend_from_slice(format!("\nstartxref\n{xref_offset}\n%%EOF\n").as_bytes());
+    out.put(&buf)?;
+    out.inner.finish()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::super::pdf_parse::PdfParser;
+    use super::super::pdf_xref::PDF_XREF_OBJSTM;
+    use super::super::pdf_xref_lazy::tests::sample_pdf;
+    use super::super::pdf_xref_lazy::{as_int, as_ref};
+    use super::*;
+
+    fn rewrite(data: Vec<u8>, settings: &WriteSettings) -> Vec<u8> {
+        let mut out = Vec::new();
+        write_document(Arc::new(data.into()), settings, &mut out)
+            .unwrap()
+            .unwrap();
+        out
+    }
+
+    fn reopen(data: Vec<u8>) -> Xref {
+        let mut xref = Xref::open_lazy(0, Arc::new(data.into())).unwrap();
+        xref.read_all_sections();
+        xref
+    }
+
+    #[test]
+    fn test_write_value_round_trips() {
+        let value = ParsedValue::Dict(vec![
+            ("Type".into(), ParsedValue::Name("A#B C".into())),
+            ("S".into(), ParsedValue::String(b"a(b)\\c\n".to_vec())),
+            (
+                "K".into(),
+                ParsedValue::Array(vec![
+                    ParsedValue::Int(-3),
+                    ParsedValue::Real(0.5),
+                    ParsedValue::Bool(true),
+                    ParsedValue::Null,
+                    ParsedValue::Reference {
+                        num: 4,
+                        generation: 0,
+                    },
+                ]),
+            ),
+        ]);
+        let mut out = Vec::new();
+        write_value(&value, &mut out);
+        let parsed = PdfParser::new(out).parse_value().unwrap();
+        assert_eq!(format!("{parsed:?}"), format!("{value:?}"));
+    }
+
+    #[test]
+    fn test_unchanged_streams_are_not_copied() {
+        let data: Arc<FileBytes> = Arc::new(sample_pdf().into());
+        let mut xref = Xref::open_lazy(0, Arc::clone(&data)).unwrap();
+        let fetched = xref.fetch(9).unwrap();
+        let raw = fetched.stream.unwrap();
+        assert!(data.as_ptr_range().contains(&raw.as_ptr()));
+
+        // Already-filtered object stream, kept as it is
+        let (_, out) = filter_stream(&fetched.value, &raw, &WriteSettings::default(), false);
+        assert_eq!(out.as_ptr(), raw.as_ptr());
+        let settings = WriteSettings {
+            decompress: true,
+            ..WriteSettings::default()
+        };
+        let (dict, out) = filter_stream(&fetched.value, &raw, &settings, true);
+        assert_eq!(out.as_ptr(), raw.as_ptr());
+        assert_eq!(
+            dict_get(&dict, "Length").and_then(as_int),
+            Some(raw.len() as i64)
+        );
+    }
+
+    #[test]
+    fn test_rewrite_unpacks_and_compresses() {
+        let settings = WriteSettings {
+            threads: 3,
+            // One stream per window
+            inflight_bytes: 1,
+            ..WriteSettings::default()
+        };
+        let mut xref = reopen(rewrite(sample_pdf(), &settings));
+        assert_eq!(xref.lazy_stats().unwrap().sections_read, 1);
+
+        // Object stream members are now plain objects
+        let font = xref.fetch(7).unwrap().value;
+        assert!(is_name(dict_get(&font, "BaseFont"), "Helvetica"));
+        assert_eq!(xref.get_entry(7).unwrap().entry_type, PDF_XREF_INUSE);
+        assert!(
+            xref.get_entry(9)
+                .is_none_or(|e| e.entry_type != PDF_XREF_INUSE)
+        );
+
+        // The updated content stream is deflated, with its decoded length
+        let contents = xref.fetch(5).unwrap();
+        assert!(is_name(dict_get(&contents.value, "Filter"), "FlateDecode"));
+        assert_eq!(dict_get(&contents.value, "DL").and_then(as_int), Some(10));
+        let raw = contents.stream.unwrap();
+        assert_eq!(decode_stream(&contents.value, &raw).unwrap(), b"BT 1 Tf ET");
+    }
+
+    #[test]
+    fn test_rewrite_decompress_and_garbage() {
+        let mut data = sample_pdf();
+        // An object nothing points at, appended as its own update
+        let orphan = data.len();
+        data.extend_from_slice(b"12 0 obj\n<< /Orphan true >>\nendobj\n");
+        let table = data.len();
+        let prev = {
+            let text = String::from_utf8_lossy(&data);
+            let at = text.rfind("startxref\n").unwrap() + "startxref\n".len();
+            text[at..].lines().next().unwrap().to_string()
+        };
+        data.extend_from_slice(
+            format!(
+                "xref\n12 1\n{orphan:010} 00000 n \ntrailer\n<< /Size 13 /Root 1 0 R /Prev {prev} >>\nstartxref\n{table}\n%%EOF\n"
+            )
+            .as_bytes(),
+        );
+
+        let keep = reopen(rewrite(data.clone(), &WriteSettings::default()));
+        assert!(
+            keep.get_entry(12)
+                .is_some_and(|e| e.entry_type == PDF_XREF_INUSE)
+        );
+
+        let settings = WriteSettings {
+            compress: false,
+            decompress: true,
+            garbage: true,
+            ..WriteSettings::default()
+        };
+        let mut xref = reopen(rewrite(data, &settings));
+        assert!(
+            xref.get_entry(12)
+                .is_none_or(|e| e.entry_type != PDF_XREF_INUSE)
+        );
+        let contents = xref.fetch(6).unwrap();
+        assert!(dict_get(&contents.value, "Filter").is_none());
+        assert_eq!(contents.stream.as_deref(), Some(&b"0 0 m S"[..]));
+    }
+
+    #[test]
+    fn test_rewrite_brotli_with_dictionary() {
+        let id = crate::pdf::filter::register_brotli_dictionary(b"0 0 m S 0 0 m S");
+        let settings = WriteSettings {
+            brotli: true,
+            brotli_dictionary: Some(id),
+            ..WriteSettings::default()
+        };
+        let mut xref = reopen(rewrite(sample_pdf(), &settings));
+        let contents = xref.fetch(6).unwrap();
+        assert!(is_name(dict_get(&contents.value, "Filter"), "BrotliDecode"));
+        assert!(dict_get(&contents.value, "DecodeParms").is_some());
+        let raw = contents.stream.unwrap();
+        assert_eq!(
+            decode_stream(&contents.value, &raw).as_deref(),
+            Some(&b"0 0 m S"[..])
+        );
+    }
+
+    #[test]
+    fn test_rewrite_dedup_redirects_references() {
+        let mut data = sample_pdf();
+        // The first page's contents become a copy of the second's
+        let copy = data.len();
+        data.extend_from_slice(b"12 0 obj\n<< /Length 7 >>\nstream\n0 0 m S\nendstream\nendobj\n");
+        let page = data.len();
+        data.extend_from_slice(
+            b"3 0 obj\n<< /Type /Page /Parent 2 0 R /Contents 12 0 R >>\nendobj\n",
+        );
+        let table = data.len();
+        let prev = {
+            let text = String::from_utf8_lossy(&data);
+            let at = text.rfind("startxref\n").unwrap() + "startxref\n".len();
+            text[at..].lines().next().unwrap().to_string()
+        };
+        data.extend_from_slice(
+            format!(
+                "xref\n3 1\n{page:010} 00000 n \n12 1\n{copy:010} 00000 n \ntrailer\n<< /Size 13 /Root 1 0 R /Prev {prev} >>\nstartxref\n{table}\n%%EOF\n"
+            )
+            .as_bytes(),
+        );
+
+        let settings = WriteSettings {
+            compress: false,
+            dedup: true,
+            threads: 2,
+            ..WriteSettings::default()
+        };
+        let mut xref = reopen(rewrite(data, &settings));
+        assert!(
+            xref.get_entry(12)
+                .is_none_or(|e| e.entry_type != PDF_XREF_INUSE)
+        );
+        let first = xref.fetch(3).unwrap().value;
+        let second = xref.fetch(4).unwrap().value;
+        assert_eq!(
+            format!("{:?}", dict_get(&first, "Contents")),
+            format!("{:?}", dict_get(&second, "Contents"))
+        );
+        // Both pages are kept, equal or not
+        assert_eq!(xref.lazy_page_object(1), Some(4));
+    }
+
+    #[test]
+    fn test_rewrite_packs_objects_by_page() {
+        let settings = WriteSettings {
+            objstms: true,
+            threads: 2,
+            ..WriteSettings::default()
+        };
+        let mut xref = reopen(rewrite(sample_pdf(), &settings));
+        let stream_of = |xref: &Xref, num| {
+            let entry = xref.get_entry(num).unwrap();
+            assert_eq!(entry.entry_type, PDF_XREF_OBJSTM, "object {num}");
+            entry.offset
+        };
+        // Catalog and page tree, then each page's own objects
+        let shared = stream_of(&xref, 1);
+        assert_eq!(stream_of(&xref, 2), shared);
+        let first = stream_of(&xref, 3);
+        let second = stream_of(&xref, 4);
+        assert!(shared != first && first != second);
+        assert_eq!(stream_of(&xref, 7), second);
+        assert_eq!(stream_of(&xref, 8), second);
+
+        let page = xref.fetch(4).unwrap().value;
+        assert!(dict_get(&page, "Resources").is_some());
+        assert_eq!(xref.fetch(8).and_then(|f| as_int(&f.value)), Some(7));
+        let contents = xref.fetch(6).unwrap();
+        let raw = contents.stream.unwrap();
+        assert_eq!(decode_stream(&contents.value, &raw).unwrap(), b"0 0 m S");
+        assert_eq!(xref.lazy_page_object(1), Some(4));
+    }
+
+    #[test]
+    fn test_rewrite_garbage_renumbers_without_gaps() {
+        let mut data = sample_pdf();
+        // The first page's contents move to object 20, orphaning object 5
+        let moved = data.len();
+        data.extend_from_slice(b"20 0 obj\n<< /Length 3 >>\nstream\nNEW\nendstream\nendobj\n");
+        let page = data.len();
+        data.extend_from_slice(
+            b"3 0 obj\n<< /Type /Page /Parent 2 0 R /Contents 20 0 R >>\nendobj\n",
+        );
+        let table = data.len();
+        let prev = {
+            let text = String::from_utf8_lossy(&data);
+            let at = text.rfind("startxref\n").unwrap() + "startxref\n".len();
+            text[at..].lines().next().unwrap().to_string()
+        };
+        data.extend_from_slice(
+            format!(
+                "xref\n3 1\n{page:010} 00000 n \n20 1\n{moved:010} 00000 n \ntrailer\n<< /Size 21 /Root 1 0 R /Prev {prev} >>\nstartxref\n{table}\n%%EOF\n"
+            )
+            .as_bytes(),
+        );
+
+        let settings = WriteSettings {
+            compress: false,
+            garbage: true,
+            renumber: true,
+            threads: 2,
+            ..WriteSettings::default()
+        };
+        let mut xref = reopen(rewrite(data, &settings));
+        // Kept: 1-4 and 6-8 and 20, now 1-8
+        assert_eq!(
+            dict_get(xref.source_trailer().unwrap(), "Size").and_then(as_int),
+            Some(9)
+        );
+        for num in 1..9 {
+            assert!(xref.fetch(num).is_some(), "object {num}");
+        }
+        let first = xref.fetch(3).unwrap().value;
+        let contents = dict_get(&first, "Contents").and_then(as_ref).unwrap();
+        assert_eq!(contents, 8);
+        assert_eq!(xref.fetch(8).unwrap().stream.as_deref(), Some(&b"NEW"[..]));
+        // Object 6, whose /Length is object 8, read back through the new numbers
+        let second = xref.fetch(4).unwrap().value;
+        let contents = dict_get(&second, "Contents").and_then(as_ref).unwrap();
+        assert_eq!(contents, 5);
+        assert_eq!(
+            xref.fetch(5).unwrap().stream.as_deref(),
+            Some(&b"0 0 m S"[..])
+        );
+    }
+}
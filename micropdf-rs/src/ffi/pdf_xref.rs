@@ -3,8 +3,11 @@
 //! Provides support for PDF cross-reference table operations, including
 //! object management, stream handling, and document structure.
 
-use crate::ffi::{Handle, HandleStore};
-use std::collections::HashMap;
+use crate::ffi::pdf_xref_lazy::XrefSource;
+use crate::ffi::{BUFFERS, Handle, HandleStore};
+use crate::fitz::alloc_sampler::{self, Subsystem};
+use crate::fitz::memory_budget;
+use std::collections::{BTreeSet, HashMap};
 use std::ffi::{CStr, CString, c_char};
 use std::ptr;
 use std::sync::LazyLock;
@@ -169,6 +172,11 @@ pub struct Xref {
     pub stream_cache: HashMap<i32, BufferHandle>,
     /// PDF version (major * 10 + minor, e.g., 17 for 1.7)
     pub version: i32,
+    /// File read on demand, for xrefs opened with `pdf_open_xref_lazy`
+    pub source: Option<XrefSource>,
+    /// Objects created, replaced or deleted through the xref, which an
+    /// incremental save writes along with any dirty cached objects
+    pub edited: BTreeSet<i32>,
 }
 
 impl Xref {
@@ -182,10 +190,15 @@ impl Xref {
             cache: HashMap::new(),
             stream_cache: HashMap::new(),
             version: 17, // Default to PDF 1.7
+            source: None,
+            edited: BTreeSet::new(),
         }
     }
 
     pub fn add_subsection(&mut self, subsection: XrefSubsection) {
+        let bytes = subsection.entries.capacity() * std::mem::size_of::<XrefEntry>();
+        alloc_sampler::record(Subsystem::Xref, bytes);
+        memory_budget::charge(bytes);
         self.num_objects = self
             .num_objects
             .max(subsection.start + subsection.entries.len() as i32);
@@ -238,6 +251,7 @@ impl Xref {
             let entry = XrefEntry::inuse(num, 0, 0);
             subsec.entries.push(entry);
         }
+        self.edited.insert(num);
 
         num
     }
@@ -249,6 +263,7 @@ impl Xref {
         }
         self.cache.remove(&num);
         self.stream_cache.remove(&num);
+        self.edited.insert(num);
     }
 }
 
@@ -272,7 +287,13 @@ pub extern "C" fn pdf_new_xref(_ctx: ContextHandle, doc: DocumentHandle) -> Hand
 /// Drop an xref table.
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_drop_xref(_ctx: ContextHandle, xref: Handle) {
-    XREFS.remove(xref);
+    if let Some(x) = XREFS.remove(xref) {
+        if let Some(source) = x.lock().unwrap().source.as_mut() {
+            for buffer in source.prefetched.drain(..) {
+                BUFFERS.release(buffer);
+            }
+        }
+    }
 }
 
 /// Get the number of objects in the xref.
@@ -331,6 +352,7 @@ pub extern "C" fn pdf_create_object(_ctx: ContextHandle, xref: Handle) -> i32 {
 pub extern "C" fn pdf_delete_object(_ctx: ContextHandle, xref: Handle, num: i32) {
     if let Some(x) = XREFS.get(xref) {
         let mut x = x.lock().unwrap();
+        x.ensure_entry(num);
         x.delete_object(num);
     }
 }
@@ -339,7 +361,8 @@ pub extern "C" fn pdf_delete_object(_ctx: ContextHandle, xref: Handle, num: i32)
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_object_exists(_ctx: ContextHandle, xref: Handle, num: i32) -> i32 {
     if let Some(x) = XREFS.get(xref) {
-        let x = x.lock().unwrap();
+        let mut x = x.lock().unwrap();
+        x.ensure_entry(num);
         return if x.object_exists(num) { 1 } else { 0 };
     }
     0
@@ -355,9 +378,11 @@ pub extern "C" fn pdf_update_object(
 ) -> i32 {
     if let Some(x) = XREFS.get(xref) {
         let mut x = x.lock().unwrap();
+        x.ensure_entry(num);
         if let Some(entry) = x.get_entry_mut(num) {
             entry.has_obj = 1;
             x.cache.insert(num, obj);
+            x.edited.insert(num);
             return 1;
         }
     }
@@ -368,8 +393,9 @@ pub extern "C" fn pdf_update_object(
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_cache_object(_ctx: ContextHandle, xref: Handle, num: i32) -> i32 {
     if let Some(x) = XREFS.get(xref) {
-        let x = x.lock().unwrap();
-        if x.cache.contains_key(&num) {
+        let mut x = x.lock().unwrap();
+        // Lazy xrefs parse the object from the file on first use
+        if x.cache.contains_key(&num) || x.load_object(num) != 0 {
             return 1;
         }
     }
@@ -409,7 +435,8 @@ pub extern "C" fn pdf_get_xref_entry(
     }
 
     if let Some(x) = XREFS.get(xref) {
-        let x = x.lock().unwrap();
+        let mut x = x.lock().unwrap();
+        x.ensure_entry(num);
         if let Some(entry) = x.get_entry(num) {
             unsafe {
                 *entry_out = entry.clone();
@@ -566,9 +593,11 @@ pub extern "C" fn pdf_update_stream(
 ) -> i32 {
     if let Some(x) = XREFS.get(xref) {
         let mut x = x.lock().unwrap();
+        x.ensure_entry(num);
         if let Some(entry) = x.get_entry_mut(num) {
             entry.has_stm_buf = if compressed != 0 { 2 } else { 1 };
             x.stream_cache.insert(num, buffer);
+            x.edited.insert(num);
             return 1;
         }
     }
@@ -0,0 +1,1105 @@
+//! Lazy Xref Loading
+//!
+//! A lazily opened xref reads only the trailer and the newest xref section
+//! up front. Older sections (`/Prev`, `/XRefStm`) are read the first time a
+//! lookup misses everything read so far, object streams are decompressed
+//! when one of their members is first touched, and objects are parsed as
+//! they are asked for. What happens before the first page renders then
+//! depends on that page, not on the size of the file.
+
+use super::mmap::FileBytes;
+use super::pdf_object::{PdfObj, PdfObjType, new_document_object};
+use super::pdf_parse::{ParsedValue, PdfParser, PdfToken, parsed_value_to_obj};
+use super::pdf_xref::{
+    PDF_XREF_FREE, PDF_XREF_INUSE, PDF_XREF_OBJSTM, XREFS, Xref, XrefEntry, XrefSubsection,
+};
+use super::{DOCUMENTS, Handle};
+use crate::fitz::alloc_sampler::{self, Subsystem};
+use crate::fitz::memory_budget;
+use crate::pdf::filter::{
+    BROTLI_DICTIONARY_KEY, BrotliDecodeParams, FilterType, FlateDecodeParams, LZWDecodeParams,
+    decode_ascii_hex, decode_ascii85, decode_ascii85_flate, decode_brotli, decode_flate_sized,
+    decode_lzw, decode_run_length, parse_brotli_dictionary_id,
+};
+use bytes::Bytes;
+use std::borrow::Cow;
+use std::collections::{HashMap, HashSet, VecDeque};
+use std::sync::Arc;
+
+/// How far back from the end of the file `startxref` is searched for
+const STARTXREF_SEARCH: usize = 1024;
+/// First parse window for an object, doubled until the object fits
+const OBJECT_WINDOW: usize = 4096;
+/// First parse window for a classic xref section
+const SECTION_WINDOW: usize = 64 * 1024;
+/// Levels of references followed from a prefetched page
+const PREFETCH_DEPTH: usize = 2;
+/// Deepest page tree walked before the file is assumed to loop
+const MAX_TREE_DEPTH: usize = 64;
+
+/// Work a lazy xref has done so far
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+#[repr(C)]
+pub struct LazyXrefStats {
+    /// Xref sections read, counting the one read at open
+    pub sections_read: i32,
+    /// Object streams decompressed
+    pub objstms_decoded: i32,
+    /// Objects parsed into the cache
+    pub objects_loaded: i32,
+}
+
+/// A decompressed object stream
+#[derive(Debug)]
+pub(crate) struct ObjStm {
+    data: Vec<u8>,
+    /// (object number, offset into `data`) in stream order
+    members: Vec<(i32, usize)>,
+}
+
+impl ObjStm {
+    /// Decompress an object stream and read its member table
+    pub(crate) fn decode(dict: &ParsedValue, raw: &[u8]) -> Option<Self> {
+        let data = decode_stream(dict, raw)?;
+        let n = dict_get(dict, "N").and_then(as_int)?.max(0) as usize;
+        let first = dict_get(dict, "First").and_then(as_int)? as usize;
+
+        let mut header = PdfParser::new(data.get(..first)?.to_vec());
+        let mut members = Vec::with_capacity(n.min(1 << 16));
+        for _ in 0..n {
+            if header.lex() != PdfToken::Int {
+                break;
+            }
+            let member = header.lexbuf.i as i32;
+            if header.lex() != PdfToken::Int {
+                break;
+            }
+            members.push((member, first + header.lexbuf.i.max(0) as usize));
+        }
+        Some(Self { data, members })
+    }
+
+    /// Text of member `num`, which the xref entry says is at `index`
+    fn member(&self, num: i32, index: usize) -> Option<&[u8]> {
+        // Trust the stream's own numbering if the entry disagrees
+        let idx = match self.members.get(index) {
+            Some(&(n, _)) if n == num => index,
+            _ => self.members.iter().position(|&(n, _)| n == num)?,
+        };
+        let start = self.members[idx].1;
+        let end = self
+            .members
+            .get(idx + 1)
+            .map_or(self.data.len(), |&(_, o)| o.max(start));
+        self.data.get(start..end)
+    }
+}
+
+/// File backing a lazily opened xref
+#[derive(Debug, Clone)]
+pub struct XrefSource {
+    data: Arc<FileBytes>,
+    /// `data` again, for zero-copy stream slices
+    bytes: Bytes,
+    /// Offsets of sections still to read, newest first
+    pending: VecDeque<usize>,
+    /// Offsets already read, so a looping `/Prev` chain terminates
+    seen: HashSet<usize>,
+    /// Trailer of the newest section, kept parsed for page tree walks
+    trailer: ParsedValue,
+    objstms: HashMap<i32, Arc<ObjStm>>,
+    stats: LazyXrefStats,
+    /// Stream buffers decoded by prefetching, released with the xref
+    pub(crate) prefetched: Vec<Handle>,
+}
+
+/// An object as read from the file
+pub(crate) struct Fetched {
+    pub(crate) value: ParsedValue,
+    /// Raw (still encoded) stream data, pointing into the file
+    pub(crate) stream: Option<Bytes>,
+}
+
+impl Fetched {
+    fn into_obj(self) -> PdfObj {
+        let dict = parsed_value_to_obj(&self.value);
+        match self.stream {
+            Some(data) => {
+                let mut obj = PdfObj::new_null();
+                obj.obj_type = PdfObjType::Stream {
+                    dict: Box::new(dict),
+                    data: data.to_vec(),
+                };
+                obj
+            }
+            None => dict,
+        }
+    }
+}
+
+impl XrefSource {
+    /// The file this source reads from
+    pub(crate) fn data(&self) -> &Arc<FileBytes> {
+        &self.data
+    }
+
+    /// Offset of the file's newest xref section, if it was read from the
+    /// file rather than rebuilt by a repair
+    pub(crate) fn newest_section(&self) -> Option<usize> {
+        startxref(&self.data).filter(|offset| self.seen.contains(offset))
+    }
+
+    /// Source with no sections left to read, for xrefs built some other way
+    /// (like repair) that still load objects on demand
+    pub(crate) fn new(data: Arc<FileBytes>, trailer: ParsedValue) -> Self {
+        Self {
+            bytes: data.shared(),
+            data,
+            pending: VecDeque::new(),
+            seen: HashSet::new(),
+            trailer,
+            objstms: HashMap::new(),
+            stats: LazyXrefStats::default(),
+            prefetched: Vec::new(),
+        }
+    }
+}
+
+/// Version from a `%PDF-M.m` header, as major * 10 + minor
+pub(crate) fn header_version(data: &[u8]) -> Option<i32> {
+    match data.strip_prefix(b"%PDF-")? {
+        [major @ b'0'..=b'9', b'.', minor @ b'0'..=b'9', ..] => {
+            Some(i32::from(major - b'0') * 10 + i32::from(minor - b'0'))
+        }
+        _ => None,
+    }
+}
+
+/// Linearization parameters (ISO 32000-1, Annex F)
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct Linearization {
+    /// File length the parameters were written for (`/L`)
+    pub file_len: usize,
+    /// Object number of the first page's page object (`/O`)
+    pub first_page_obj: i32,
+    /// End of the first page's section (`/E`)
+    pub first_page_end: usize,
+    /// Number of pages (`/N`)
+    pub page_count: i32,
+    /// Offset and length of the primary hint stream (`/H`)
+    pub hint_offset: usize,
+    pub hint_len: usize,
+    /// Offset of the main xref table's first entry (`/T`)
+    pub main_xref: usize,
+    /// Offset of the first-page xref section, right after the dict
+    pub first_section: usize,
+}
+
+/// Linearization parameters of a file, read from its first object
+///
+/// Only the first object's bytes are needed, so this works on a partial
+/// download of the file's start.
+pub fn linearization(data: &[u8]) -> Option<Linearization> {
+    let mut parser = PdfParser::new(data[..data.len().min(STARTXREF_SEARCH)].to_vec());
+    let header = [parser.lex(), parser.lex(), parser.lex()];
+    if header != [PdfToken::Int, PdfToken::Int, PdfToken::Obj] {
+        return None;
+    }
+    let value = parser.parse_value()?;
+    if parser.lex() != PdfToken::EndObj {
+        return None;
+    }
+    parser.skip_whitespace();
+    dict_get(&value, "Linearized")?;
+
+    let get = |key| {
+        dict_get(&value, key)
+            .and_then(as_int)
+            .and_then(|v| usize::try_from(v).ok())
+    };
+    let hint = match dict_get(&value, "H")? {
+        ParsedValue::Array(items) => items.iter().filter_map(as_int).collect::<Vec<_>>(),
+        _ => return None,
+    };
+    let (&hint_offset, &hint_len) = (hint.first()?, hint.get(1)?);
+    Some(Linearization {
+        file_len: get("L")?,
+        first_page_obj: get("O")? as i32,
+        first_page_end: get("E")?,
+        page_count: get("N")? as i32,
+        hint_offset: usize::try_from(hint_offset).ok()?,
+        hint_len: usize::try_from(hint_len).ok()?,
+        main_xref: get("T")?,
+        first_section: parser.pos,
+    })
+}
+
+/// Offset given by the last `startxref` in the file's tail
+fn startxref(data: &[u8]) -> Option<usize> {
+    let tail = &data[data.len().saturating_sub(STARTXREF_SEARCH)..];
+    let at = tail.windows(9).rposition(|w| w == b"startxref")?;
+    let mut parser = PdfParser::new(tail[at + 9..].to_vec());
+    if parser.lex() != PdfToken::Int {
+        return None;
+    }
+    usize::try_from(parser.lexbuf.i).ok()
+}
+
+/// Decoded data of the stream object at `offset`, for streams with a
+/// direct `/Length` like hint streams
+pub(crate) fn read_stream_at(data: &[u8], offset: usize) -> Option<(ParsedValue, Vec<u8>)> {
+    let (value, rel) = parse_window(data, offset, OBJECT_WINDOW, parse_indirect)?;
+    let start = offset + rel?;
+    let len = usize::try_from(dict_get(&value, "Length").and_then(as_int)?).ok()?;
+    let raw = data.get(start..start.checked_add(len)?)?;
+    let decoded = decode_stream(&value, raw)?;
+    Some((value, decoded))
+}
+
+// ============================================================================
+// Parsed Value Helpers
+// ============================================================================
+
+pub(crate) fn dict_get<'a>(value: &'a ParsedValue, key: &str) -> Option<&'a ParsedValue> {
+    match value {
+        ParsedValue::Dict(entries) => entries.iter().find(|(k, _)| k == key).map(|(_, v)| v),
+        _ => None,
+    }
+}
+
+pub(crate) fn as_int(value: &ParsedValue) -> Option<i64> {
+    match value {
+        ParsedValue::Int(i) => Some(*i),
+        _ => None,
+    }
+}
+
+pub(crate) fn as_ref(value: &ParsedValue) -> Option<i32> {
+    match value {
+        ParsedValue::Reference { num, .. } => Some(*num),
+        _ => None,
+    }
+}
+
+pub(crate) fn is_name(value: Option<&ParsedValue>, name: &str) -> bool {
+    matches!(value, Some(ParsedValue::Name(n)) if n == name)
+}
+
+/// Every reference in `value`, skipping `/Parent` so walks don't climb
+pub(crate) fn collect_refs(value: &ParsedValue, out: &mut Vec<i32>) {
+    match value {
+        ParsedValue::Reference { num, .. } => out.push(*num),
+        ParsedValue::Array(items) => items.iter().for_each(|v| collect_refs(v, out)),
+        ParsedValue::Dict(entries) => entries
+            .iter()
+            .filter(|(k, _)| k != "Parent")
+            .for_each(|(_, v)| collect_refs(v, out)),
+        _ => {}
+    }
+}
+
+/// Run `f` over a window of `data` starting at `offset`, growing the
+/// window until the parse finishes short of its end
+///
+/// A token cut off by the window would otherwise parse as a shorter one.
+fn parse_window<T>(
+    data: &[u8],
+    offset: usize,
+    first_window: usize,
+    mut f: impl FnMut(&mut PdfParser) -> Option<T>,
+) -> Option<T> {
+    if offset >= data.len() {
+        return None;
+    }
+    let mut window = first_window;
+    loop {
+        let end = offset.saturating_add(window).min(data.len());
+        let mut parser = PdfParser::new(data[offset..end].to_vec());
+        let result = f(&mut parser);
+        let complete = end == data.len() || parser.pos < parser.data.len();
+        if complete {
+            return result;
+        }
+        window = window.saturating_mul(2);
+    }
+}
+
+/// Parse `num gen obj value [stream]`; the stream start is relative to the parser
+fn parse_indirect(parser: &mut PdfParser) -> Option<(ParsedValue, Option<usize>)> {
+    if parser.lex() != PdfToken::Int || parser.lex() != PdfToken::Int {
+        return None;
+    }
+    if parser.lex() != PdfToken::Obj {
+        return None;
+    }
+    let value = parser.parse_value()?;
+    if parser.lex() != PdfToken::Stream {
+        return Some((value, None));
+    }
+    // Data starts after the EOL that ends the `stream` line
+    if parser.peek() == Some(b'\r') {
+        parser.pos += 1;
+    }
+    if parser.peek() == Some(b'\n') {
+        parser.pos += 1;
+    }
+    Some((value, Some(parser.pos)))
+}
+
+/// Decode a stream's data through its filter chain
+///
+/// Covers the byte-stream filters that xref, object and content streams
+/// use; image codecs give `None`.
+pub(crate) fn decode_stream(dict: &ParsedValue, raw: &[u8]) -> Option<Vec<u8>> {
+    let (filters, params) = match (dict_get(dict, "Filter"), dict_get(dict, "DecodeParms")) {
+        (None, _) => return Some(raw.to_vec()),
+        (Some(ParsedValue::Array(f)), Some(ParsedValue::Array(p))) => {
+            (f.iter().collect::<Vec<_>>(), p.iter().map(Some).collect())
+        }
+        (Some(ParsedValue::Array(f)), _) => (f.iter().collect(), Vec::new()),
+        (Some(f), p) => (vec![f], vec![p]),
+    };
+
+    // `/DL` is the fully decoded length, so it only sizes a lone filter
+    let decoded_len = match filters.len() {
+        1 => dict_get(dict, "DL")
+            .and_then(as_int)
+            .and_then(|n| usize::try_from(n).ok())
+            .unwrap_or(0),
+        _ => 0,
+    };
+    let filter_at = |i: usize| match filters.get(i) {
+        Some(ParsedValue::Name(name)) => FilterType::from_name(name),
+        _ => None,
+    };
+    let get = |i: usize, key: &str, default: i64| {
+        params
+            .get(i)
+            .copied()
+            .flatten()
+            .and_then(|p| dict_get(p, key))
+            .and_then(as_int)
+            .unwrap_or(default) as i32
+    };
+    let flate_params = |i| FlateDecodeParams {
+        predictor: get(i, "Predictor", 1),
+        colors: get(i, "Colors", 1),
+        bits_per_component: get(i, "BitsPerComponent", 8),
+        columns: get(i, "Columns", 1),
+    };
+
+    // Each filter reads the last one's output; the raw bytes are only
+    // borrowed, and the common pairs run fused in one pass
+    let mut data = Cow::Borrowed(raw);
+    let mut i = 0;
+    while i < filters.len() {
+        let decoded = match filter_at(i)? {
+            // Predictor undone as the rows inflate
+            FilterType::FlateDecode => {
+                decode_flate_sized(&data, Some(&flate_params(i)), decoded_len).ok()?
+            }
+            // Decoded straight into the inflater's input
+            FilterType::ASCII85Decode if filter_at(i + 1) == Some(FilterType::FlateDecode) => {
+                i += 1;
+                decode_ascii85_flate(&data, Some(&flate_params(i))).ok()?
+            }
+            FilterType::LZWDecode => {
+                let params = LZWDecodeParams {
+                    predictor: get(i, "Predictor", 1),
+                    colors: get(i, "Colors", 1),
+                    bits_per_component: get(i, "BitsPerComponent", 8),
+                    columns: get(i, "Columns", 1),
+                    early_change: get(i, "EarlyChange", 1),
+                };
+                decode_lzw(&data, Some(&params)).ok()?
+            }
+            FilterType::ASCII85Decode => decode_ascii85(&data).ok()?,
+            FilterType::ASCIIHexDecode => decode_ascii_hex(&data).ok()?,
+            FilterType::RunLengthDecode => decode_run_length(&data).ok()?,
+            FilterType::BrotliDecode => {
+                let dictionary = match params
+                    .get(i)
+                    .copied()
+                    .flatten()
+                    .and_then(|p| dict_get(p, BROTLI_DICTIONARY_KEY))
+                {
+                    Some(ParsedValue::String(id)) => Some(parse_brotli_dictionary_id(id)?),
+                    _ => None,
+                };
+                decode_brotli(&data, Some(&BrotliDecodeParams { dictionary })).ok()?
+            }
+            // Image codecs decode with the image, not as a byte stream
+            _ => return None,
+        };
+        data = Cow::Owned(decoded);
+        i += 1;
+    }
+    let data = data.into_owned();
+    alloc_sampler::record(Subsystem::Decode, data.capacity());
+    // Decoded data is short-lived, so it need only fit, not stay charged
+    memory_budget::admit(data.len()).then_some(data)
+}
+
+/// Subsections and trailer of a classic `xref` table
+fn parse_xref_table(parser: &mut PdfParser) -> Option<(Vec<XrefSubsection>, ParsedValue)> {
+    if parser.lex() != PdfToken::Xref {
+        return None;
+    }
+    let mut subsections = Vec::new();
+    loop {
+        match parser.lex() {
+            PdfToken::Trailer => break,
+            PdfToken::Int => {
+                let start = parser.lexbuf.i as i32;
+                if parser.lex() != PdfToken::Int {
+                    return None;
+                }
+                let count = parser.lexbuf.i.max(0) as usize;
+                let mut subsec = XrefSubsection::with_capacity(start, count.min(1 << 20));
+                for k in 0..count {
+                    let num = start + k as i32;
+                    if parser.lex() != PdfToken::Int {
+                        return None;
+                    }
+                    let offset = parser.lexbuf.i;
+                    if parser.lex() != PdfToken::Int {
+                        return None;
+                    }
+                    let generation = parser.lexbuf.i as u16;
+                    if parser.lex() != PdfToken::Keyword {
+                        return None;
+                    }
+                    subsec
+                        .entries
+                        .push(match parser.lexbuf.string_value.as_str() {
+                            "n" => XrefEntry::inuse(num, generation, offset),
+                            _ => XrefEntry::free(num, generation),
+                        });
+                }
+                subsections.push(subsec);
+            }
+            _ => return None,
+        }
+    }
+    let trailer = parser.parse_value()?;
+    matches!(trailer, ParsedValue::Dict(_)).then_some((subsections, trailer))
+}
+
+/// Subsections described by a decoded xref stream
+fn xref_stream_subsections(dict: &ParsedValue, data: &[u8]) -> Option<Vec<XrefSubsection>> {
+    let widths: Vec<usize> = match dict_get(dict, "W")? {
+        ParsedValue::Array(items) => items
+            .iter()
+            .map(|v| as_int(v).map(|w| w.clamp(0, 8) as usize))
+            .collect::<Option<_>>()?,
+        _ => return None,
+    };
+    let [w0, w1, w2] = widths[..] else {
+        return None;
+    };
+    let size = dict_get(dict, "Size").and_then(as_int)?;
+    let index: Vec<i64> = match dict_get(dict, "Index") {
+        Some(ParsedValue::Array(items)) => items.iter().filter_map(as_int).collect(),
+        _ => vec![0, size],
+    };
+
+    let field = |row: &[u8], at: usize, width: usize| {
+        row[at..at + width]
+            .iter()
+            .fold(0i64, |acc, &b| (acc << 8) | i64::from(b))
+    };
+    let row_len = w0 + w1 + w2;
+    if row_len == 0 {
+        return None;
+    }
+    let mut rows = data.chunks_exact(row_len);
+    let mut subsections = Vec::new();
+    for pair in index.chunks_exact(2) {
+        let (start, count) = (pair[0] as i32, pair[1].max(0) as usize);
+        let mut subsec = XrefSubsection::with_capacity(start, count.min(1 << 20));
+        for k in 0..count {
+            let row = rows.next()?;
+            let num = start + k as i32;
+            // A missing type field means "in use"
+            let kind = if w0 == 0 { 1 } else { field(row, 0, w0) };
+            let f2 = field(row, w0, w1);
+            let f3 = field(row, w0 + w1, w2);
+            subsec.entries.push(match kind {
+                1 => XrefEntry::inuse(num, f3 as u16, f2),
+                2 => XrefEntry::objstm(num, f2, f3 as u16),
+                _ => XrefEntry::free(num, f3 as u16),
+            });
+        }
+        subsections.push(subsec);
+    }
+    Some(subsections)
+}
+
+// ============================================================================
+// Lazy Xref
+// ============================================================================
+
+impl Xref {
+    /// Open the xref of `data` lazily, reading only the newest section
+    ///
+    /// A linearized file that is still only partly downloaded (truncated,
+    /// or with its tail not yet fetched) starts from its first-page section
+    /// instead, which covers the first page.
+    pub fn open_lazy(document: Handle, data: Arc<FileBytes>) -> Option<Self> {
+        let _span = super::trace::span(c"xref");
+        let start = match linearization(&data) {
+            Some(lin) if lin.file_len > data.len() => Some(lin.first_section),
+            lin => startxref(&data).or(lin.map(|l| l.first_section)),
+        }?;
+
+        let mut xref = Xref::new(document);
+        xref.version = header_version(&data).unwrap_or(xref.version);
+        let mut source = XrefSource::new(data, ParsedValue::Null);
+        source.pending.push_back(start);
+        xref.source = Some(source);
+        if !xref.read_next_section() {
+            return None;
+        }
+
+        let source = xref.source.as_ref()?;
+        let size = dict_get(&source.trailer, "Size").and_then(as_int);
+        xref.num_objects = xref.num_objects.max(size.unwrap_or(0) as i32);
+        xref.trailer = new_document_object(document, parsed_value_to_obj(&source.trailer));
+        Some(xref)
+    }
+
+    /// Whether this xref reads its file on demand
+    pub fn is_lazy(&self) -> bool {
+        self.source.is_some()
+    }
+
+    /// Work done so far by a lazy xref
+    pub fn lazy_stats(&self) -> Option<LazyXrefStats> {
+        self.source.as_ref().map(|s| s.stats)
+    }
+
+    /// Read the next older section; false once there are none left
+    fn read_next_section(&mut self) -> bool {
+        let Some(source) = self.source.as_mut() else {
+            return false;
+        };
+        let Some(offset) = source.pending.pop_front() else {
+            return false;
+        };
+        let _span = super::trace::span_arg(c"xref", offset as i64);
+        let _sampled = alloc_sampler::scope(Subsystem::Xref);
+        if !source.seen.insert(offset) {
+            return self.read_next_section();
+        }
+        let data = Arc::clone(&source.data);
+        // Past the end of a partial download
+        let Some(rest) = data.get(offset..) else {
+            return self.read_next_section();
+        };
+
+        let section = if rest.trim_ascii_start().starts_with(b"xref") {
+            parse_window(&data, offset, SECTION_WINDOW, parse_xref_table)
+        } else {
+            self.fetch_at(offset).and_then(|f| {
+                let decoded = decode_stream(&f.value, f.stream.as_deref()?)?;
+                let subsections = xref_stream_subsections(&f.value, &decoded)?;
+                Some((subsections, f.value))
+            })
+        };
+        let Some((subsections, trailer)) = section else {
+            return false;
+        };
+
+        let Some(source) = self.source.as_mut() else {
+            return false;
+        };
+        source.stats.sections_read += 1;
+        // A hybrid file's stream section comes before the older chain
+        for key in ["XRefStm", "Prev"] {
+            if let Some(next) = dict_get(&trailer, key).and_then(as_int) {
+                source.pending.push_back(next as usize);
+            }
+        }
+        if matches!(source.trailer, ParsedValue::Null) {
+            source.trailer = trailer;
+        }
+        // Sections are read newest first, so earlier subsections win lookups
+        for subsec in subsections {
+            self.add_subsection(subsec);
+        }
+        true
+    }
+
+    /// Make sure the entry for `num` has been read, if any section has it
+    pub fn ensure_entry(&mut self, num: i32) {
+        while self.get_entry(num).is_none() && self.read_next_section() {}
+    }
+
+    /// Parse the indirect object at a file offset
+    fn fetch_at(&mut self, offset: usize) -> Option<Fetched> {
+        let data = self.source.as_ref()?.bytes.clone();
+        let (value, stream_start) = parse_window(&data, offset, OBJECT_WINDOW, parse_indirect)?;
+        let Some(rel) = stream_start else {
+            return Some(Fetched {
+                value,
+                stream: None,
+            });
+        };
+
+        let start = offset + rel;
+        let len = match dict_get(&value, "Length") {
+            Some(ParsedValue::Int(n)) => usize::try_from(*n).ok(),
+            Some(ParsedValue::Reference { num, .. }) => {
+                let num = *num;
+                self.fetch(num)
+                    .and_then(|f| as_int(&f.value))
+                    .and_then(|n| usize::try_from(n).ok())
+            }
+            _ => None,
+        };
+        // Fall back to the endstream marker for missing or bogus lengths
+        let end = match len {
+            Some(len) if start.saturating_add(len) <= data.len() => start + len,
+            _ => {
+                let marker = data[start..].windows(9).position(|w| w == b"endstream")?;
+                start + marker
+            }
+        };
+        Some(Fetched {
+            value,
+            stream: Some(data.slice(start..end)),
+        })
+    }
+
+    /// Read object `num` from the file, without caching it
+    pub(crate) fn fetch(&mut self, num: i32) -> Option<Fetched> {
+        self.ensure_entry(num);
+        let entry = self.get_entry(num)?.clone();
+        match entry.entry_type {
+            PDF_XREF_INUSE => self.fetch_at(usize::try_from(entry.offset).ok()?),
+            PDF_XREF_OBJSTM => {
+                // The entry's generation field holds the member's index
+                let objstm = self.objstm(entry.offset as i32)?;
+                let text = objstm.member(num, entry.generation as usize)?;
+                Some(Fetched {
+                    value: PdfParser::new(text.to_vec()).parse_value()?,
+                    stream: None,
+                })
+            }
+            _ => None,
+        }
+    }
+
+    /// Read object `num`'s value (a stream's dictionary) without touching
+    /// the xref, so threads can share it
+    ///
+    /// Only finds what has been read already: entries in sections not read
+    /// yet, and members of object streams not yet decompressed, give `None`.
+    pub(crate) fn peek_value(&self, num: i32) -> Option<ParsedValue> {
+        let source = self.source.as_ref()?;
+        let entry = self.get_entry(num)?;
+        match entry.entry_type {
+            PDF_XREF_INUSE => {
+                let offset = usize::try_from(entry.offset).ok()?;
+                parse_window(&source.bytes, offset, OBJECT_WINDOW, parse_indirect).map(|(v, _)| v)
+            }
+            PDF_XREF_OBJSTM => {
+                let objstm = source.objstms.get(&(entry.offset as i32))?;
+                let text = objstm.member(num, entry.generation as usize)?;
+                PdfParser::new(text.to_vec()).parse_value()
+            }
+            _ => None,
+        }
+    }
+
+    /// Object stream `num`, decompressing it on first use
+    fn objstm(&mut self, num: i32) -> Option<Arc<ObjStm>> {
+        if let Some(objstm) = self.source.as_ref()?.objstms.get(&num) {
+            return Some(Arc::clone(objstm));
+        }
+        let fetched = self.fetch(num)?;
+        let objstm = ObjStm::decode(&fetched.value, fetched.stream.as_deref()?)?;
+        Some(self.insert_objstm(num, objstm))
+    }
+
+    /// Whether object stream `num` has been decompressed
+    pub(crate) fn has_objstm(&self, num: i32) -> bool {
+        self.source
+            .as_ref()
+            .is_some_and(|s| s.objstms.contains_key(&num))
+    }
+
+    /// Store a decompressed object stream
+    pub(crate) fn insert_objstm(&mut self, num: i32, objstm: ObjStm) -> Arc<ObjStm> {
+        let objstm = Arc::new(objstm);
+        if let Some(source) = self.source.as_mut() {
+            source.stats.objstms_decoded += 1;
+            source.objstms.insert(num, Arc::clone(&objstm));
+        }
+        objstm
+    }
+
+    /// Trailer dictionary of the newest section
+    pub(crate) fn source_trailer(&self) -> Option<&ParsedValue> {
+        self.source.as_ref().map(|s| &s.trailer)
+    }
+
+    /// Read every xref section not read yet, for passes over all objects
+    pub(crate) fn read_all_sections(&mut self) {
+        while self.read_next_section() {}
+    }
+
+    /// Load object `num` into the cache, returning its handle (0 if absent)
+    pub fn load_object(&mut self, num: i32) -> Handle {
+        if let Some(&obj) = self.cache.get(&num) {
+            return obj;
+        }
+        self.load_value(num).map_or(0, |_| self.cache[&num])
+    }
+
+    /// Parse object `num`, caching it if it wasn't yet, and return its value
+    pub(crate) fn load_value(&mut self, num: i32) -> Option<ParsedValue> {
+        if !self.is_lazy() {
+            return None;
+        }
+        let fetched = self.fetch(num)?;
+        let value = fetched.value.clone();
+        if !self.cache.contains_key(&num) {
+            let obj = new_document_object(self.document, fetched.into_obj());
+            self.cache.insert(num, obj);
+            if let Some(entry) = self.get_entry_mut(num) {
+                entry.has_obj = 1;
+            }
+            if let Some(source) = self.source.as_mut() {
+                source.stats.objects_loaded += 1;
+            }
+        }
+        Some(value)
+    }
+
+    /// Object number of page `index`, loading only the page tree nodes on
+    /// the way down (and their kids, to read `/Count`)
+    pub fn lazy_page_object(&mut self, index: i32) -> Option<i32> {
+        let trailer = self.source.as_ref()?.trailer.clone();
+        let root = self.load_value(dict_get(&trailer, "Root").and_then(as_ref)?)?;
+        let mut node = dict_get(&root, "Pages").and_then(as_ref)?;
+        let mut remaining = i64::from(index);
+
+        for _ in 0..MAX_TREE_DEPTH {
+            let value = self.load_value(node)?;
+            if is_name(dict_get(&value, "Type"), "Page") {
+                return (remaining == 0).then_some(node);
+            }
+            let ParsedValue::Array(kids) = dict_get(&value, "Kids")? else {
+                return None;
+            };
+            let mut next = None;
+            for kid in kids.iter().filter_map(as_ref) {
+                let kid_value = self.load_value(kid)?;
+                let count = if is_name(dict_get(&kid_value, "Type"), "Pages") {
+                    dict_get(&kid_value, "Count").and_then(as_int).unwrap_or(0)
+                } else {
+                    1
+                };
+                if remaining < count {
+                    next = Some(kid);
+                    break;
+                }
+                remaining -= count;
+            }
+            node = next?;
+        }
+        None
+    }
+
+    /// Load page `index` and the objects it references, a few levels deep
+    ///
+    /// Returns how many objects were newly loaded, or `None` if the page
+    /// doesn't exist.
+    pub fn prefetch_page(&mut self, index: i32) -> Option<i32> {
+        let page = self.lazy_page_object(index)?;
+        let before = self.source.as_ref()?.stats.objects_loaded;
+
+        let mut seen = HashSet::from([page]);
+        let mut queue = VecDeque::from([(page, 0)]);
+        while let Some((num, depth)) = queue.pop_front() {
+            let Some(value) = self.load_value(num) else {
+                continue;
+            };
+            if depth == PREFETCH_DEPTH {
+                continue;
+            }
+            let mut refs = Vec::new();
+            collect_refs(&value, &mut refs);
+            for r in refs {
+                if seen.insert(r) {
+                    queue.push_back((r, depth + 1));
+                }
+            }
+        }
+        Some(self.source.as_ref()?.stats.objects_loaded - before)
+    }
+}
+
+// ============================================================================
+// FFI Functions
+// ============================================================================
+
+/// Open a document's xref in lazy mode
+///
+/// Only the trailer and the newest xref section are read; everything else
+/// is read when first needed. Returns 0 if the document or its xref can't
+/// be read.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_open_xref_lazy(_ctx: Handle, doc: Handle) -> Handle {
+    let Some(data) = DOCUMENTS
+        .get(doc)
+        .and_then(|d| d.lock().ok().map(|d| d.data()))
+    else {
+        return 0;
+    };
+    match Xref::open_lazy(doc, data) {
+        Some(xref) => XREFS.insert(xref),
+        None => 0,
+    }
+}
+
+/// Check whether an xref was opened lazily
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_xref_is_lazy(_ctx: Handle, xref: Handle) -> i32 {
+    XREFS
+        .get(xref)
+        .map_or(0, |x| i32::from(x.lock().unwrap().is_lazy()))
+}
+
+/// Get the work a lazy xref has done so far
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_xref_lazy_stats(
+    _ctx: Handle,
+    xref: Handle,
+    stats_out: *mut LazyXrefStats,
+) -> i32 {
+    if stats_out.is_null() {
+        return 0;
+    }
+    let Some(stats) = XREFS.get(xref).and_then(|x| x.lock().unwrap().lazy_stats()) else {
+        return 0;
+    };
+    unsafe {
+        *stats_out = stats;
+    }
+    1
+}
+
+/// Load a page's object and the objects it references
+///
+/// Returns the number of objects newly loaded, or -1 if the xref isn't
+/// lazy or has no such page.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_xref_prefetch_page(_ctx: Handle, xref: Handle, page: i32) -> i32 {
+    XREFS
+        .get(xref)
+        .and_then(|x| x.lock().unwrap().prefetch_page(page))
+        .unwrap_or(-1)
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+#[cfg(test)]
+pub(crate) mod tests {
+    use super::super::document::Document;
+    use super::super::pdf_xref::{pdf_cache_object, pdf_drop_xref, pdf_get_xref_entry};
+    use super::*;
+    use crate::pdf::filter::encode_flate;
+
+    /// Two pages behind an xref stream with an object stream, plus an
+    /// incremental update with a classic table that replaces object 5
+    pub(crate) fn sample_pdf() -> Vec<u8> {
+        let mut pdf = b"%PDF-1.5\n".to_vec();
+        let mut offsets = HashMap::new();
+        let mut add = |pdf: &mut Vec<u8>, num: i32, body: &[u8]| {
+            offsets.insert(num, pdf.len());
+            pdf.extend_from_slice(format!("{num} 0 obj\n").as_bytes());
+            pdf.extend_from_slice(body);
+            pdf.extend_from_slice(b"\nendobj\n");
+        };
+        add(&mut pdf, 1, b"<< /Type /Catalog /Pages 2 0 R >>");
+        add(
+            &mut pdf,
+            2,
+            b"<< /Type /Pages /Kids [3 0 R 4 0 R] /Count 2 >>",
+        );
+        add(
+            &mut pdf,
+            3,
+            b"<< /Type /Page /Parent 2 0 R /Contents 5 0 R >>",
+        );
+        add(
+            &mut pdf,
+            4,
+            b"<< /Type /Page /Parent 2 0 R /Contents 6 0 R /Resources << /Font << /F1 7 0 R >> >> >>",
+        );
+        add(&mut pdf, 5, b"<< /Length 5 >>\nstream\nBT ET\nendstream");
+        add(
+            &mut pdf,
+            6,
+            b"<< /Length 8 0 R >>\nstream\n0 0 m S\nendstream",
+        );
+        add(&mut pdf, 8, b"7");
+
+        let members = b"<< /Type /Font /BaseFont /Helvetica >> << /X 1 >>";
+        let header = b"7 0 10 39 ";
+        let mut objstm_data = header.to_vec();
+        objstm_data.extend_from_slice(members);
+        let packed = encode_flate(&objstm_data, 6).unwrap();
+        let mut body = format!(
+            "<< /Type /ObjStm /N 2 /First {} /Length {} /Filter /FlateDecode >>\nstream\n",
+            header.len(),
+            packed.len()
+        )
+        .into_bytes();
+        body.extend_from_slice(&packed);
+        body.extend_from_slice(b"\nendstream");
+        add(&mut pdf, 9, &body);
+
+        // Object 11 is the xref stream itself
+        let xref_offset = pdf.len();
+        offsets.insert(11, xref_offset);
+        let mut rows = Vec::new();
+        for num in 0..12 {
+            let (kind, f2, f3) = match num {
+                7 => (2, 9, 0),
+                10 => (2, 9, 1),
+                n => match offsets.get(&n) {
+                    Some(&o) => (1, o as u32, 0),
+                    None => (0, 0, 0xffff),
+                },
+            };
+            rows.push(kind as u8);
+            rows.extend_from_slice(&f2.to_be_bytes());
+            rows.extend_from_slice(&(f3 as u16).to_be_bytes());
+        }
+        let packed = encode_flate(&rows, 6).unwrap();
+        pdf.extend_from_slice(
+            format!(
+                "11 0 obj\n<< /Type /XRef /Size 12 /W [1 4 2] /Root 1 0 R /Length {} /Filter /FlateDecode >>\nstream\n",
+                packed.len()
+            )
+            .as_bytes(),
+        );
+        pdf.extend_from_slice(&packed);
+        pdf.extend_from_slice(b"\nendstream\nendobj\n");
+        pdf.extend_from_slice(format!("startxref\n{xref_offset}\n%%EOF\n").as_bytes());
+
+        // Incremental update replacing the first page's contents
+        let new5 = pdf.len();
+        pdf.extend_from_slice(
+            b"5 0 obj\n<< /Length 10 >>\nstream\nBT 1 Tf ET\nendstream\nendobj\n",
+        );
+        let table = pdf.len();
+        pdf.extend_from_slice(
+            format!(
+                "xref\n0 1\n0000000000 65535 f \n5 1\n{new5:010} 00000 n \ntrailer\n<< /Size 12 /Root 1 0 R /Prev {xref_offset} >>\nstartxref\n{table}\n%%EOF\n"
+            )
+            .as_bytes(),
+        );
+        pdf
+    }
+
+    fn open_sample() -> Xref {
+        Xref::open_lazy(0, Arc::new(sample_pdf().into())).unwrap()
+    }
+
+    #[test]
+    fn test_open_reads_only_newest_section() {
+        let xref = open_sample();
+        let stats = xref.lazy_stats().unwrap();
+        assert_eq!(stats.sections_read, 1);
+        assert_eq!(stats.objstms_decoded, 0);
+        assert_eq!(stats.objects_loaded, 0);
+        assert_eq!(xref.num_objects, 12);
+        assert_eq!(xref.version, 15);
+        assert!(xref.trailer != 0);
+    }
+
+    #[test]
+    fn test_older_sections_read_on_miss() {
+        let mut xref = open_sample();
+        // Object 5 is in the newest section and must be its updated version
+        let obj5 = xref.fetch(5).unwrap();
+        assert_eq!(obj5.stream.as_deref(), Some(&b"BT 1 Tf ET"[..]));
+        assert_eq!(xref.lazy_stats().unwrap().sections_read, 1);
+
+        // Object 3 only appears in the older xref stream
+        xref.ensure_entry(3);
+        assert_eq!(xref.lazy_stats().unwrap().sections_read, 2);
+        assert_eq!(xref.get_entry(3).unwrap().entry_type, PDF_XREF_INUSE);
+        // Indirect /Length
+        assert_eq!(
+            xref.fetch(6).unwrap().stream.as_deref(),
+            Some(&b"0 0 m S"[..])
+        );
+    }
+
+    #[test]
+    fn test_object_stream_decoded_once() {
+        let mut xref = open_sample();
+        let font = xref.fetch(7).unwrap().value;
+        assert!(is_name(dict_get(&font, "BaseFont"), "Helvetica"));
+        let other = xref.fetch(10).unwrap().value;
+        assert_eq!(dict_get(&other, "X").and_then(as_int), Some(1));
+        assert_eq!(xref.lazy_stats().unwrap().objstms_decoded, 1);
+        assert_eq!(xref.get_entry(10).unwrap().entry_type, PDF_XREF_OBJSTM);
+    }
+
+    #[test]
+    fn test_prefetch_page() {
+        let mut xref = open_sample();
+        assert_eq!(xref.lazy_page_object(1), Some(4));
+        assert_eq!(xref.lazy_page_object(2), None);
+
+        let loaded = xref.prefetch_page(1).unwrap();
+        // Contents, its length and the font come in with the page
+        for num in [4, 6, 7, 8] {
+            assert!(xref.cache.contains_key(&num), "object {num}");
+        }
+        assert!(loaded >= 3);
+        // The first page's contents were not needed
+        assert!(!xref.cache.contains_key(&5));
+        assert_eq!(xref.prefetch_page(1), Some(0));
+    }
+
+    #[test]
+    fn test_ffi_lazy_xref() {
+        let doc = DOCUMENTS.insert(Document::new(sample_pdf()));
+        let xref = pdf_open_xref_lazy(0, doc);
+        assert_ne!(xref, 0);
+        assert_eq!(pdf_xref_is_lazy(0, xref), 1);
+
+        assert_eq!(pdf_cache_object(0, xref, 10), 1);
+        let mut entry = XrefEntry::new();
+        assert_eq!(pdf_get_xref_entry(0, xref, 10, &mut entry), 1);
+        assert_eq!(entry.has_obj, 1);
+        assert_eq!(entry.entry_type, PDF_XREF_OBJSTM);
+
+        let mut stats = LazyXrefStats::default();
+        assert_eq!(pdf_xref_lazy_stats(0, xref, &mut stats), 1);
+        assert_eq!(stats.objects_loaded, 1);
+        assert_eq!(pdf_xref_prefetch_page(0, xref, 5), -1);
+
+        pdf_drop_xref(0, xref);
+        DOCUMENTS.remove(doc);
+        assert_eq!(pdf_open_xref_lazy(0, doc), 0);
+    }
+
+    #[test]
+    fn test_not_a_pdf() {
+        assert!(Xref::open_lazy(0, Arc::new(b"hello".to_vec().into())).is_none());
+        let mut plain = Xref::new(0);
+        assert!(!plain.is_lazy());
+        assert_eq!(plain.load_object(1), 0);
+        assert_eq!(PDF_XREF_FREE, 0);
+    }
+}
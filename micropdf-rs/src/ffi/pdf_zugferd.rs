@@ -3,10 +3,21 @@
 //! Provides support for ZUGFeRD and Factur-X electronic invoice formats,
 //! enabling extraction and embedding of XML invoice data in PDF documents.
 
-use crate::ffi::{Handle, HandleStore};
+use super::buffer::Buffer;
+use super::mmap::FileBytes;
+use super::pdf_embedded_stream::{EmbeddedStream, catalog_files, embedded_file, stream_decoded};
+use super::pdf_form_fill::text_string;
+use super::pdf_image_rewriter::resolve;
+use super::pdf_parse::ParsedValue;
+use super::pdf_stream_prefetch::parallel_map;
+use super::pdf_write::open_source;
+use super::pdf_xref::Xref;
+use super::pdf_xref_lazy::dict_get;
+use crate::ffi::xml::{XmlDocument, XmlSelect, XmlToken, XmlTokenizer};
+use crate::ffi::{BUFFERS, DOCUMENTS, Handle, HandleStore};
 use std::ffi::{CStr, CString, c_char};
 use std::ptr;
-use std::sync::LazyLock;
+use std::sync::{Arc, LazyLock};
 
 // ============================================================================
 // Type Aliases
@@ -152,6 +163,8 @@ pub struct ZugferdContext {
     pub info: Option<ZugferdInfo>,
     /// Extracted XML data
     pub xml_data: Option<Vec<u8>>,
+    /// Result of the last validation
+    pub validation: ZugferdValidation,
 }
 
 impl ZugferdContext {
@@ -160,6 +173,7 @@ impl ZugferdContext {
             document,
             info: None,
             xml_data: None,
+            validation: ZugferdValidation::default(),
         }
     }
 }
@@ -171,6 +185,147 @@ impl ZugferdContext {
 pub static ZUGFERD_CONTEXTS: LazyLock<HandleStore<ZugferdContext>> =
     LazyLock::new(HandleStore::new);
 
+// ============================================================================
+// Invoice Reading
+// ============================================================================
+
+/// Invoice file names, compared without case, each with the earliest
+/// version to use it; ZUGFeRD 1's `ZUGFeRD-invoice.xml` is told from 2.0's
+/// by its root element
+const INVOICE_FILENAMES: [(&str, f32); 3] = [
+    ("zugferd-invoice.xml", 2.0),
+    ("factur-x.xml", 2.1),
+    ("xrechnung.xml", 2.2),
+];
+
+/// Profiles by a word of their guideline ID, most specific first:
+/// "basicwl" holds "basic", and Basic, Extended and XRechnung IDs all
+/// name EN 16931
+const GUIDELINE_PROFILES: [(&str, i32); 7] = [
+    ("xrechnung", PDF_ZUGFERD_XRECHNUNG),
+    ("extended", PDF_ZUGFERD_EXTENDED),
+    ("basicwl", PDF_ZUGFERD_BASIC_WL),
+    ("minimum", PDF_ZUGFERD_MINIMUM),
+    ("basic", PDF_ZUGFERD_BASIC),
+    ("en16931", PDF_ZUGFERD_COMFORT),
+    ("comfort", PDF_ZUGFERD_COMFORT),
+];
+
+/// An invoice read from a PDF
+struct FoundInvoice {
+    info: ZugferdInfo,
+    xml: Vec<u8>,
+    header: Result<InvoiceHeader, String>,
+}
+
+/// The version an embedded file's name implies, if it names an invoice
+fn invoice_version(name: &str) -> Option<f32> {
+    let base = name.rsplit(['/', '\\']).next().unwrap_or(name);
+    INVOICE_FILENAMES
+        .iter()
+        .find(|(invoice, _)| base.eq_ignore_ascii_case(invoice))
+        .map(|&(_, version)| version)
+}
+
+fn guideline_profile(guideline: &str) -> i32 {
+    let guideline = guideline.to_ascii_lowercase();
+    GUIDELINE_PROFILES
+        .iter()
+        .find(|(word, _)| guideline.contains(word))
+        .map_or(PDF_ZUGFERD_UNKNOWN, |&(_, profile)| profile)
+}
+
+/// The first of the catalog's associated files (`/AF`) named as an invoice
+fn associated_invoice(xref: &mut Xref, catalog: &ParsedValue) -> Option<EmbeddedStream> {
+    let Some(ParsedValue::Array(specs)) = dict_get(catalog, "AF").and_then(|af| resolve(xref, af))
+    else {
+        return None;
+    };
+    specs.iter().find_map(|spec| {
+        let spec = resolve(xref, spec)?;
+        let name = ["UF", "F"]
+            .iter()
+            .find_map(|key| match dict_get(&spec, key) {
+                Some(ParsedValue::String(name)) => Some(text_string(name)),
+                _ => None,
+            })?;
+        invoice_version(&name)?;
+        embedded_file(xref, name, &spec)
+    })
+}
+
+/// Read the invoice of the PDF in `data`
+///
+/// Only the trailer, the catalog, its associated files and its
+/// `/EmbeddedFiles` name tree are read, then the invoice's stream is
+/// decoded; the page tree is never touched. The invoice is the first
+/// associated file, else the first embedded file, with an invoice file
+/// name. Returns `None` if there is none, or the document is encrypted
+/// or can't be read.
+fn read_invoice(data: &Arc<FileBytes>) -> Option<FoundInvoice> {
+    let mut xref = open_source(data, 1)?;
+    xref.read_all_sections();
+    let trailer = xref
+        .source_trailer()
+        .filter(|t| dict_get(t, "Encrypt").is_none())?
+        .clone();
+    let catalog = dict_get(&trailer, "Root").and_then(|r| resolve(&mut xref, r))?;
+    let file = associated_invoice(&mut xref, &catalog).or_else(|| {
+        catalog_files(&mut xref, &catalog)
+            .into_iter()
+            .find(|f| invoice_version(&f.name).is_some())
+    })?;
+
+    let mut xml = Vec::new();
+    stream_decoded(&file, &mut |chunk| {
+        xml.extend_from_slice(chunk);
+        true
+    })?;
+    let header = read_header(&xml);
+    let named = invoice_version(&file.name).unwrap_or(0.0);
+    let (profile, version, conformance) = match &header {
+        Ok(InvoiceHeader::Invoice {
+            zugferd1,
+            guideline,
+            ..
+        }) => {
+            let guideline = guideline.clone().unwrap_or_default();
+            let version = if *zugferd1 { 1.0 } else { named };
+            (guideline_profile(&guideline), version, guideline)
+        }
+        _ => (PDF_ZUGFERD_UNKNOWN, named, String::new()),
+    };
+    let info = ZugferdInfo {
+        profile,
+        version,
+        conformance,
+        xml_filename: file.name,
+        has_xmp: dict_get(&catalog, "Metadata").is_some(),
+    };
+    Some(FoundInvoice { info, xml, header })
+}
+
+fn document_data(doc: DocumentHandle) -> Option<Arc<FileBytes>> {
+    let data = DOCUMENTS.get(doc)?.lock().ok()?.data();
+    Some(data)
+}
+
+/// Read `zctx`'s invoice from its document, once
+///
+/// XML already set on the context is kept.
+fn load_invoice(zctx: &mut ZugferdContext) -> &ZugferdInfo {
+    let (document, xml_data) = (zctx.document, &mut zctx.xml_data);
+    zctx.info.get_or_insert_with(|| {
+        match document_data(document).and_then(|data| read_invoice(&data)) {
+            Some(found) => {
+                xml_data.get_or_insert(found.xml);
+                found.info
+            }
+            None => ZugferdInfo::new(),
+        }
+    })
+}
+
 // ============================================================================
 // FFI Functions - Context Management
 // ============================================================================
@@ -194,6 +349,9 @@ pub extern "C" fn pdf_drop_zugferd_context(_ctx: ContextHandle, zugferd: Handle)
 
 /// Detect the ZUGFeRD profile of a document.
 /// Returns the profile constant and optionally fills version.
+///
+/// The first call reads the invoice from the document's catalog, without
+/// loading pages; the profile is taken from its guideline ID.
 #[unsafe(no_mangle)]
 pub extern "C" fn pdf_zugferd_profile(
     _ctx: ContextHandle,
@@ -202,29 +360,13 @@ pub extern "C" fn pdf_zugferd_profile(
 ) -> i32 {
     if let Some(zctx) = ZUGFERD_CONTEXTS.get(zugferd) {
         let mut zctx = zctx.lock().unwrap();
-
-        // Return cached info if available
-        if let Some(ref info) = zctx.info {
-            if !version_out.is_null() {
-                unsafe {
-                    *version_out = info.version;
-                }
-            }
-            return info.profile;
-        }
-
-        // In a real implementation, this would parse the PDF's XMP metadata
-        // and embedded files to detect ZUGFeRD. For now, return not ZUGFeRD.
-        let info = ZugferdInfo::new();
-        let profile = info.profile;
-        zctx.info = Some(info);
-
+        let info = load_invoice(&mut zctx);
         if !version_out.is_null() {
             unsafe {
-                *version_out = 0.0;
+                *version_out = info.version;
             }
         }
-        return profile;
+        return info.profile;
     }
     PDF_NOT_ZUGFERD
 }
@@ -258,7 +400,8 @@ pub extern "C" fn pdf_zugferd_xml(
     len_out: *mut usize,
 ) -> *const u8 {
     if let Some(zctx) = ZUGFERD_CONTEXTS.get(zugferd) {
-        let zctx = zctx.lock().unwrap();
+        let mut zctx = zctx.lock().unwrap();
+        load_invoice(&mut zctx);
 
         if let Some(ref xml_data) = zctx.xml_data {
             if !len_out.is_null() {
@@ -439,33 +582,241 @@ pub struct ZugferdValidation {
     pub warnings: Vec<String>,
 }
 
-/// Validate ZUGFeRD compliance.
-/// Returns 1 if valid, 0 if invalid.
-#[unsafe(no_mangle)]
-pub extern "C" fn pdf_zugferd_validate(_ctx: ContextHandle, zugferd: Handle) -> i32 {
-    if let Some(zctx) = ZUGFERD_CONTEXTS.get(zugferd) {
-        let zctx = zctx.lock().unwrap();
+/// Header fields every invoice carries, for a selective parse
+///
+/// ZUGFeRD 2 / Factur-X (`CrossIndustryInvoice`) paths come first, then
+/// ZUGFeRD 1 (`CrossIndustryDocument`); only those under the actual root
+/// can match.
+const INVOICE_HEADER_PATHS: [&str; 4] = [
+    "CrossIndustryInvoice/ExchangedDocumentContext/GuidelineSpecifiedDocumentContextParameter/ID",
+    "CrossIndustryInvoice/ExchangedDocument/ID",
+    "CrossIndustryDocument/SpecifiedExchangedDocumentContext/GuidelineSpecifiedDocumentContextParameter/ID",
+    "CrossIndustryDocument/HeaderExchangedDocument/ID",
+];
+
+/// What the selective parse reads of an invoice
+#[derive(Debug)]
+enum InvoiceHeader {
+    /// No root element, only a declaration if anything
+    Empty,
+    /// A root element that isn't a cross industry invoice
+    Foreign(String),
+    /// A cross industry invoice's header fields, where present
+    Invoice {
+        /// The root is ZUGFeRD 1's `CrossIndustryDocument`
+        zugferd1: bool,
+        guideline: Option<String>,
+        number: Option<String>,
+    },
+}
+
+/// Read an invoice's root element and header fields
+///
+/// Only the header is built: the parse stops once the guideline and
+/// document IDs are read, so the line items of a large invoice are
+/// never tokenized. An error is the message validation reports.
+fn read_header(xml: &[u8]) -> Result<InvoiceHeader, String> {
+    let Ok(text) = std::str::from_utf8(xml) else {
+        return Err("XML is not valid UTF-8".to_string());
+    };
 
-        // Check if we have XML data
-        if zctx.xml_data.is_none() {
-            return 0;
+    // Peek at the root so the selection holds only the paths that can
+    // match under it, and the early stop doesn't wait on the others
+    let root_name = XmlTokenizer::new(text).find_map(|token| match token {
+        Ok(XmlToken::Start { name, .. }) => Some(Ok(name)),
+        Err(e) => Some(Err(e)),
+        _ => None,
+    });
+    let root_name = match root_name {
+        None => return Ok(InvoiceHeader::Empty),
+        Some(Err(e)) => return Err(format!("XML is not well-formed: {e}")),
+        Some(Ok(name)) => name,
+    };
+    let local = root_name.rsplit(':').next().unwrap_or(root_name);
+    let paths: Vec<&str> = INVOICE_HEADER_PATHS
+        .iter()
+        .copied()
+        .filter(|p| p.split('/').next() == Some(local))
+        .collect();
+    if paths.is_empty() {
+        return Ok(InvoiceHeader::Foreign(root_name.to_string()));
+    }
+
+    let select = XmlSelect::new(&paths).first_match();
+    let doc = XmlDocument::parse_selected(text, false, &select)
+        .map_err(|e| format!("XML is not well-formed: {e}"))?;
+    let field = |path: &str| {
+        let mut at = doc.root()?;
+        for segment in path.split('/').skip(1) {
+            at = doc.children(at).find(|&c| {
+                let name = doc.name(c);
+                name.rsplit(':').next() == Some(segment)
+            })?;
         }
+        doc.children(at)
+            .map(|c| doc.text(c))
+            .find(|t| !t.is_empty())
+            .map(|t| t.trim().to_string())
+    };
+    Ok(InvoiceHeader::Invoice {
+        zugferd1: local == "CrossIndustryDocument",
+        guideline: field(paths[0]),
+        number: field(paths[1]),
+    })
+}
+
+/// Check an invoice's root element and header fields
+fn validate_invoice(xml: &[u8]) -> ZugferdValidation {
+    validate_header(xml, &read_header(xml))
+}
 
-        // Basic XML validation
-        if let Some(ref xml) = zctx.xml_data {
-            // Check for XML declaration
-            if xml.starts_with(b"<?xml") || xml.starts_with(b"<rsm:") {
-                return 1;
+fn validate_header(xml: &[u8], header: &Result<InvoiceHeader, String>) -> ZugferdValidation {
+    let mut result = ZugferdValidation::default();
+    match header {
+        Err(e) => result.errors.push(e.clone()),
+        Ok(InvoiceHeader::Empty) => {
+            // Nothing to check yet beyond the declaration
+            result.warnings.push("XML has no root element".to_string());
+            result.is_valid = xml.starts_with(b"<?xml");
+        }
+        Ok(InvoiceHeader::Foreign(root_name)) => {
+            result.errors.push(format!(
+                "root element '{root_name}' is not a cross industry invoice"
+            ));
+        }
+        Ok(InvoiceHeader::Invoice {
+            guideline, number, ..
+        }) => {
+            if guideline.is_none() {
+                result
+                    .errors
+                    .push("missing guideline (profile) ID".to_string());
+            }
+            if number.is_none() {
+                result.errors.push("missing invoice number".to_string());
             }
+            result.is_valid = result.errors.is_empty();
         }
     }
+    result
+}
+
+/// Validate ZUGFeRD compliance.
+/// Returns 1 if valid, 0 if invalid.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_zugferd_validate(_ctx: ContextHandle, zugferd: Handle) -> i32 {
+    if let Some(zctx) = ZUGFERD_CONTEXTS.get(zugferd) {
+        let mut zctx = zctx.lock().unwrap();
+        load_invoice(&mut zctx);
+
+        let validation = match zctx.xml_data {
+            Some(ref xml) => validate_invoice(xml),
+            None => ZugferdValidation {
+                errors: vec!["no invoice XML".to_string()],
+                ..Default::default()
+            },
+        };
+        let valid = validation.is_valid;
+        zctx.validation = validation;
+        return i32::from(valid);
+    }
     0
 }
 
 /// Get validation error count.
+///
+/// Counts the errors found by the last [`pdf_zugferd_validate`].
 #[unsafe(no_mangle)]
-pub extern "C" fn pdf_zugferd_error_count(_ctx: ContextHandle, _zugferd: Handle) -> i32 {
-    0 // Simplified - full implementation would track errors
+pub extern "C" fn pdf_zugferd_error_count(_ctx: ContextHandle, zugferd: Handle) -> i32 {
+    ZUGFERD_CONTEXTS
+        .get(zugferd)
+        .and_then(|zctx| zctx.lock().ok().map(|z| z.validation.errors.len() as i32))
+        .unwrap_or(0)
+}
+
+// ============================================================================
+// FFI Functions - Batch Processing
+// ============================================================================
+
+/// Keep each invoice's XML, in a buffer in its result
+pub const PDF_ZUGFERD_BATCH_XML: i32 = 1;
+
+/// One file's result from [`pdf_zugferd_process_files`]
+#[derive(Debug, Clone, Copy, Default)]
+#[repr(C)]
+pub struct ZugferdFileResult {
+    /// Profile, `PDF_NOT_ZUGFERD` if the file has no invoice or can't be read
+    pub profile: i32,
+    /// Version
+    pub version: f32,
+    /// 1 if the invoice passes validation
+    pub valid: i32,
+    /// Number of validation errors
+    pub error_count: i32,
+    /// Buffer holding the XML with `PDF_ZUGFERD_BATCH_XML`, else 0; the
+    /// caller drops it
+    pub xml: BufferHandle,
+}
+
+/// Read and validate the invoices of many PDF files.
+///
+/// Each file is mapped and only its trailer, catalog, associated files
+/// and embedded files are read, never its pages, on up to `threads`
+/// threads (0 = one per core). `results[i]` is filled for `paths[i]`.
+/// Returns the number of files holding an invoice.
+#[unsafe(no_mangle)]
+pub extern "C" fn pdf_zugferd_process_files(
+    _ctx: ContextHandle,
+    paths: *const *const c_char,
+    count: i32,
+    threads: i32,
+    flags: i32,
+    results: *mut ZugferdFileResult,
+) -> i32 {
+    let count = usize::try_from(count).unwrap_or(0);
+    if paths.is_null() || results.is_null() || count == 0 {
+        return 0;
+    }
+    let paths: Vec<Option<String>> = unsafe { std::slice::from_raw_parts(paths, count) }
+        .iter()
+        .map(|&p| (!p.is_null()).then(|| unsafe { CStr::from_ptr(p) }.to_string_lossy().into()))
+        .collect();
+
+    let threads = usize::try_from(threads).unwrap_or(0);
+    let found = parallel_map(&paths, threads, |path| {
+        let data = Arc::new(FileBytes::map(path.as_ref()?).ok()?);
+        let found = read_invoice(&data)?;
+        let validation = validate_header(&found.xml, &found.header);
+        Some((found, validation))
+    });
+
+    let keep_xml = flags & PDF_ZUGFERD_BATCH_XML != 0;
+    let results = unsafe { std::slice::from_raw_parts_mut(results, count) };
+    let mut invoices = 0;
+    for (result, found) in results.iter_mut().zip(found) {
+        *result = match found {
+            Some((found, validation)) => {
+                invoices += 1;
+                ZugferdFileResult {
+                    profile: found.info.profile,
+                    version: found.info.version,
+                    valid: i32::from(validation.is_valid),
+                    error_count: validation.errors.len() as i32,
+                    xml: if keep_xml {
+                        BUFFERS.insert(Buffer::from_vec(found.xml))
+                    } else {
+                        0
+                    },
+                }
+            }
+            // As `pdf_zugferd_validate` reports a missing invoice
+            None => ZugferdFileResult {
+                error_count: 1,
+                ..Default::default()
+            },
+        };
+    }
+    invoices
 }
 
 // ============================================================================
@@ -512,6 +863,9 @@ pub extern "C" fn pdf_zugferd_af_relationship(_ctx: ContextHandle) -> *mut c_cha
 #[cfg(test)]
 mod tests {
     use super::*;
+    use crate::ffi::document::Document;
+    use crate::ffi::pdf_image_rewriter::tests::{pdf_with, stream};
+    use crate::pdf::filter::encode_flate;
 
     #[test]
     fn test_profile_constants() {
@@ -662,6 +1016,38 @@ mod tests {
         pdf_drop_zugferd_context(ctx, zugferd);
     }
 
+    #[test]
+    fn test_ffi_validation_reads_header() {
+        let ctx = 0;
+        let zugferd = pdf_new_zugferd_context(ctx, 1);
+
+        let mut xml = String::from(
+            "<?xml version=\"1.0\"?>\
+             <rsm:CrossIndustryInvoice xmlns:rsm=\"urn:rsm\" xmlns:ram=\"urn:ram\">\
+             <rsm:ExchangedDocumentContext><ram:GuidelineSpecifiedDocumentContextParameter>\
+             <ram:ID>urn:cen.eu:en16931:2017</ram:ID>\
+             </ram:GuidelineSpecifiedDocumentContextParameter></rsm:ExchangedDocumentContext>\
+             <rsm:ExchangedDocument><ram:ID>INV-1</ram:ID></rsm:ExchangedDocument>",
+        );
+        // Line items past the header are never parsed, even when broken
+        xml.push_str("<rsm:SupplyChainTradeTransaction><ram:unterminated");
+        pdf_zugferd_set_xml(ctx, zugferd, xml.as_ptr(), xml.len());
+        assert_eq!(pdf_zugferd_validate(ctx, zugferd), 1);
+        assert_eq!(pdf_zugferd_error_count(ctx, zugferd), 0);
+
+        let xml = b"<rsm:CrossIndustryInvoice xmlns:rsm=\"urn:rsm\"/>";
+        pdf_zugferd_set_xml(ctx, zugferd, xml.as_ptr(), xml.len());
+        assert_eq!(pdf_zugferd_validate(ctx, zugferd), 0);
+        assert_eq!(pdf_zugferd_error_count(ctx, zugferd), 2);
+
+        let xml = b"<?xml version=\"1.0\"?><invoice/>";
+        pdf_zugferd_set_xml(ctx, zugferd, xml.as_ptr(), xml.len());
+        assert_eq!(pdf_zugferd_validate(ctx, zugferd), 0);
+        assert_eq!(pdf_zugferd_error_count(ctx, zugferd), 1);
+
+        pdf_drop_zugferd_context(ctx, zugferd);
+    }
+
     #[test]
     fn test_ffi_standard_filename() {
         let ctx = 0;
@@ -703,4 +1089,146 @@ mod tests {
             pdf_zugferd_free_string(af);
         }
     }
+
+    const FACTURX_XML: &str = "<?xml version=\"1.0\"?>\
+        <rsm:CrossIndustryInvoice xmlns:rsm=\"urn:rsm\" xmlns:ram=\"urn:ram\">\
+        <rsm:ExchangedDocumentContext><ram:GuidelineSpecifiedDocumentContextParameter>\
+        <ram:ID>urn:cen.eu:en16931:2017</ram:ID>\
+        </ram:GuidelineSpecifiedDocumentContextParameter></rsm:ExchangedDocumentContext>\
+        <rsm:ExchangedDocument><ram:ID>INV-1</ram:ID></rsm:ExchangedDocument>\
+        </rsm:CrossIndustryInvoice>";
+
+    /// A Factur-X invoice, compressed, as the catalog's associated file
+    fn facturx_pdf() -> Vec<u8> {
+        let xml = encode_flate(FACTURX_XML.as_bytes(), 6).unwrap();
+        pdf_with(&[
+            b"<< /Type /Catalog /Pages 2 0 R /AF [3 0 R] /Metadata 5 0 R \
+               /Names << /EmbeddedFiles << /Names [(factur-x.xml) 3 0 R] >> >> >>"
+                .to_vec(),
+            b"<< /Type /Pages /Kids [] /Count 0 >>".to_vec(),
+            b"<< /Type /Filespec /F (factur-x.xml) /UF (factur-x.xml) \
+               /AFRelationship /Alternative /EF << /F 4 0 R >> >>"
+                .to_vec(),
+            stream("/Type /EmbeddedFile /Filter /FlateDecode", &xml),
+            stream("/Type /Metadata /Subtype /XML", b"<x:xmpmeta/>"),
+        ])
+    }
+
+    /// A ZUGFeRD 1 invoice, only in the embedded files name tree
+    fn zugferd1_pdf() -> Vec<u8> {
+        pdf_with(&[
+            b"<< /Type /Catalog /Pages 2 0 R \
+               /Names << /EmbeddedFiles << /Names [(ZUGFeRD-invoice.xml) 3 0 R] >> >> >>"
+                .to_vec(),
+            b"<< /Type /Pages /Kids [] /Count 0 >>".to_vec(),
+            b"<< /Type /Filespec /F (ZUGFeRD-invoice.xml) /EF << /F 4 0 R >> >>".to_vec(),
+            stream(
+                "/Type /EmbeddedFile",
+                b"<rsm:CrossIndustryDocument xmlns:rsm=\"urn:rsm\" xmlns:ram=\"urn:ram\">\
+                  <rsm:SpecifiedExchangedDocumentContext>\
+                  <ram:GuidelineSpecifiedDocumentContextParameter>\
+                  <ram:ID>urn:ferd:CrossIndustryDocument:invoice:1p0:basic</ram:ID>\
+                  </ram:GuidelineSpecifiedDocumentContextParameter>\
+                  </rsm:SpecifiedExchangedDocumentContext>\
+                  <rsm:HeaderExchangedDocument><ram:ID>471102</ram:ID></rsm:HeaderExchangedDocument>\
+                  </rsm:CrossIndustryDocument>",
+            ),
+        ])
+    }
+
+    #[test]
+    fn test_ffi_reads_invoice_from_document() {
+        let ctx = 0;
+        let doc = DOCUMENTS.insert(Document::new(facturx_pdf()));
+        let zugferd = pdf_new_zugferd_context(ctx, doc);
+
+        let mut version = 0.0;
+        assert_eq!(
+            pdf_zugferd_profile(ctx, zugferd, &mut version),
+            PDF_ZUGFERD_COMFORT
+        );
+        assert_eq!(version, 2.1);
+        let mut len = 0;
+        let xml = pdf_zugferd_xml(ctx, zugferd, &mut len);
+        assert_eq!(
+            unsafe { std::slice::from_raw_parts(xml, len) },
+            FACTURX_XML.as_bytes()
+        );
+        assert_eq!(pdf_zugferd_validate(ctx, zugferd), 1);
+        let info = ZUGFERD_CONTEXTS
+            .get(zugferd)
+            .unwrap()
+            .lock()
+            .unwrap()
+            .info
+            .clone();
+        let info = info.unwrap();
+        assert_eq!(info.xml_filename, "factur-x.xml");
+        assert_eq!(info.conformance, "urn:cen.eu:en16931:2017");
+        assert!(info.has_xmp);
+
+        pdf_drop_zugferd_context(ctx, zugferd);
+        DOCUMENTS.remove(doc);
+    }
+
+    #[test]
+    fn test_ffi_process_files() {
+        let plain = pdf_with(&[
+            b"<< /Type /Catalog /Pages 2 0 R >>".to_vec(),
+            b"<< /Type /Pages /Kids [] /Count 0 >>".to_vec(),
+        ]);
+        let files = [
+            ("facturx", facturx_pdf()),
+            ("zugferd1", zugferd1_pdf()),
+            ("plain", plain),
+        ];
+        let dir = std::env::temp_dir();
+        let mut paths: Vec<_> = files
+            .iter()
+            .map(|(name, bytes)| {
+                let path = dir.join(format!("zugferd_{name}_{}.pdf", std::process::id()));
+                std::fs::write(&path, bytes).unwrap();
+                path
+            })
+            .collect();
+        paths.push(dir.join(format!("zugferd_missing_{}.pdf", std::process::id())));
+        let names: Vec<CString> = paths
+            .iter()
+            .map(|p| CString::new(p.to_str().unwrap()).unwrap())
+            .collect();
+        let names: Vec<*const c_char> = names.iter().map(|n| n.as_ptr()).collect();
+
+        let mut results = [ZugferdFileResult::default(); 4];
+        let found = pdf_zugferd_process_files(
+            0,
+            names.as_ptr(),
+            4,
+            0,
+            PDF_ZUGFERD_BATCH_XML,
+            results.as_mut_ptr(),
+        );
+        assert_eq!(found, 2);
+        let r = &results[0];
+        assert_eq!(
+            (r.profile, r.version, r.valid, r.error_count),
+            (PDF_ZUGFERD_COMFORT, 2.1, 1, 0)
+        );
+        let xml = BUFFERS.get(r.xml).unwrap();
+        assert_eq!(xml.lock().unwrap().data(), FACTURX_XML.as_bytes());
+        let r = &results[1];
+        assert_eq!((r.profile, r.version, r.valid), (PDF_ZUGFERD_BASIC, 1.0, 1));
+        for r in &results[2..] {
+            assert_eq!(
+                (r.profile, r.valid, r.error_count, r.xml),
+                (PDF_NOT_ZUGFERD, 0, 1, 0)
+            );
+        }
+
+        for r in &results {
+            BUFFERS.remove(r.xml);
+        }
+        for path in &paths {
+            let _ = std::fs::remove_file(path);
+        }
+    }
 }
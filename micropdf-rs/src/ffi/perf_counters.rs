@@ -0,0 +1,197 @@
+//! FFI bindings for performance counters
+//!
+//! One snapshot of every counter in `crate::fitz::counters`, alongside the
+//! store and glyph cache hit counts (`fz_store_hits`, `fz_glyph_cache_hits`),
+//! for scraping into a metrics system. All values only ever grow; rates come
+//! from differences between snapshots.
+//!
+//! Counters are process wide: the context argument is accepted for MuPDF
+//! style but, as with the store counters, every context shares them.
+
+use std::ffi::{CStr, c_char};
+
+use super::Handle;
+use super::glyph_cache::{fz_glyph_cache_hits, fz_glyph_cache_misses};
+use super::store::{fz_store_hits, fz_store_misses};
+use crate::fitz::counters::{self, Counter};
+
+/// Snapshot of the performance counters
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+#[allow(non_camel_case_types)]
+pub struct fz_perf_counters {
+    pub bytes_inflated: u64,
+    pub images_decoded: u64,
+    pub image_pixels_decoded: u64,
+    pub image_decode_ns: u64,
+    pub glyphs_rasterized: u64,
+    pub paths_filled: u64,
+    pub paths_stroked: u64,
+    pub operators_interpreted: u64,
+    pub store_hits: u64,
+    pub store_misses: u64,
+    pub glyph_cache_hits: u64,
+    pub glyph_cache_misses: u64,
+    pub document_lookups: u64,
+    pub page_lookups: u64,
+    pub pixmap_lookups: u64,
+    pub image_lookups: u64,
+    pub font_lookups: u64,
+    pub buffer_lookups: u64,
+    pub stext_page_lookups: u64,
+}
+
+/// Field names of `fz_perf_counters`, in order
+const NAMES: [&CStr; FZ_PERF_COUNTER_COUNT as usize] = [
+    c"bytes_inflated",
+    c"images_decoded",
+    c"image_pixels_decoded",
+    c"image_decode_ns",
+    c"glyphs_rasterized",
+    c"paths_filled",
+    c"paths_stroked",
+    c"operators_interpreted",
+    c"store_hits",
+    c"store_misses",
+    c"glyph_cache_hits",
+    c"glyph_cache_misses",
+    c"document_lookups",
+    c"page_lookups",
+    c"pixmap_lookups",
+    c"image_lookups",
+    c"font_lookups",
+    c"buffer_lookups",
+    c"stext_page_lookups",
+];
+
+/// Number of counters in `fz_perf_counters`
+pub const FZ_PERF_COUNTER_COUNT: i32 = 19;
+
+impl fz_perf_counters {
+    fn take(ctx: Handle) -> Self {
+        let c = counters::snapshot();
+        let at = |counter: Counter| c[counter as usize];
+        Self {
+            bytes_inflated: at(Counter::BytesInflated),
+            images_decoded: at(Counter::ImagesDecoded),
+            image_pixels_decoded: at(Counter::ImagePixelsDecoded),
+            image_decode_ns: at(Counter::ImageDecodeNs),
+            glyphs_rasterized: at(Counter::GlyphsRasterized),
+            paths_filled: at(Counter::PathsFilled),
+            paths_stroked: at(Counter::PathsStroked),
+            operators_interpreted: at(Counter::OperatorsInterpreted),
+            store_hits: fz_store_hits(ctx),
+            store_misses: fz_store_misses(ctx),
+            glyph_cache_hits: fz_glyph_cache_hits(ctx),
+            glyph_cache_misses: fz_glyph_cache_misses(ctx),
+            document_lookups: at(Counter::DocumentLookups),
+            page_lookups: at(Counter::PageLookups),
+            pixmap_lookups: at(Counter::PixmapLookups),
+            image_lookups: at(Counter::ImageLookups),
+            font_lookups: at(Counter::FontLookups),
+            buffer_lookups: at(Counter::BufferLookups),
+            stext_page_lookups: at(Counter::StextPageLookups),
+        }
+    }
+
+    fn values(&self) -> [u64; FZ_PERF_COUNTER_COUNT as usize] {
+        [
+            self.bytes_inflated,
+            self.images_decoded,
+            self.image_pixels_decoded,
+            self.image_decode_ns,
+            self.glyphs_rasterized,
+            self.paths_filled,
+            self.paths_stroked,
+            self.operators_interpreted,
+            self.store_hits,
+            self.store_misses,
+            self.glyph_cache_hits,
+            self.glyph_cache_misses,
+            self.document_lookups,
+            self.page_lookups,
+            self.pixmap_lookups,
+            self.image_lookups,
+            self.font_lookups,
+            self.buffer_lookups,
+            self.stext_page_lookups,
+        ]
+    }
+}
+
+// ============================================================================
+// FFI Functions
+// ============================================================================
+
+/// Fill `out` with a snapshot of every performance counter
+///
+/// # Returns
+/// 1 on success, 0 if `out` is null
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_get_perf_counters(ctx: Handle, out: *mut fz_perf_counters) -> i32 {
+    if out.is_null() {
+        return 0;
+    }
+    // SAFETY: caller guarantees a non-null `out` is writable
+    unsafe { out.write(fz_perf_counters::take(ctx)) };
+    1
+}
+
+/// Number of counters, for iterating with `fz_perf_counter`
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_perf_counter_count() -> i32 {
+    FZ_PERF_COUNTER_COUNT
+}
+
+/// Current value of counter `index` (field order of `fz_perf_counters`),
+/// or 0 for an index out of range
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_perf_counter(ctx: Handle, index: i32) -> u64 {
+    usize::try_from(index)
+        .ok()
+        .and_then(|i| fz_perf_counters::take(ctx).values().get(i).copied())
+        .unwrap_or(0)
+}
+
+/// Name of counter `index` (its `fz_perf_counters` field), or NULL for an
+/// index out of range
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_perf_counter_name(index: i32) -> *const c_char {
+    usize::try_from(index)
+        .ok()
+        .and_then(|i| NAMES.get(i))
+        .map_or(std::ptr::null(), |name| name.as_ptr())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_names_match_fields() {
+        assert_eq!(
+            std::mem::size_of::<fz_perf_counters>(),
+            FZ_PERF_COUNTER_COUNT as usize * 8
+        );
+        let name = |i| unsafe { CStr::from_ptr(fz_perf_counter_name(i)) };
+        assert_eq!(name(0), c"bytes_inflated");
+        assert_eq!(name(FZ_PERF_COUNTER_COUNT - 1), c"stext_page_lookups");
+        assert!(fz_perf_counter_name(FZ_PERF_COUNTER_COUNT).is_null());
+        assert!(fz_perf_counter_name(-1).is_null());
+        assert_eq!(fz_perf_counter(0, FZ_PERF_COUNTER_COUNT), 0);
+    }
+
+    #[test]
+    fn test_snapshot_counts_inflates() {
+        let mut before = fz_perf_counters::default();
+        assert_eq!(fz_get_perf_counters(0, &mut before), 1);
+
+        let data = crate::pdf::filter::encode_flate(&[7u8; 1000], 6).unwrap();
+        crate::pdf::filter::decode_flate(&data, None).unwrap();
+
+        let mut after = fz_perf_counters::default();
+        assert_eq!(fz_get_perf_counters(0, &mut after), 1);
+        assert!(after.bytes_inflated >= before.bytes_inflated + 1000);
+        assert_eq!(fz_get_perf_counters(0, std::ptr::null_mut()), 0);
+    }
+}
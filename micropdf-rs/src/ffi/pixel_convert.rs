@@ -0,0 +1,711 @@
+//! Whole-Pixmap Colour Conversion
+//!
+//! Converts runs of pixels between the device spaces (gray, RGB, BGR,
+//! CMYK), with or without alpha, eight pixels at a time. Each block is
+//! split into one vector per component, converted with whole-vector
+//! arithmetic and interleaved again: one AVX2 instruction or two NEON ones
+//! per step, for eight pixels. The conversions are written once over a
+//! lane type and instantiated per instruction set, called through the
+//! kernel dispatch table; every instantiation gives the same bytes.
+//!
+//! Samples are premultiplied. The linear conversions (gray, RGB, BGR)
+//! apply to them as they are; the CMYK ones scale by each pixel's alpha,
+//! so a pixel converts as its unpremultiplied colour would, premultiplied
+//! again. A pixel without alpha is opaque.
+
+// Allow unsafe operations inside unsafe functions (Rust 2024 edition compat)
+#![allow(unsafe_op_in_unsafe_fn)]
+
+use super::colorspace::{
+    ColorspaceHandle, FZ_COLORSPACE_BGR, FZ_COLORSPACE_CMYK, FZ_COLORSPACE_GRAY, FZ_COLORSPACE_RGB,
+};
+use super::dispatch::kernels;
+use super::simd_util::SimdLevel;
+
+/// Pixels converted per block
+pub(crate) const BLOCK: usize = 8;
+
+/// Device space of a pixel run
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+enum Space {
+    Gray,
+    Rgb,
+    Bgr,
+    Cmyk,
+}
+
+impl Space {
+    fn from_handle(cs: ColorspaceHandle) -> Option<Self> {
+        match cs {
+            FZ_COLORSPACE_GRAY => Some(Space::Gray),
+            FZ_COLORSPACE_RGB => Some(Space::Rgb),
+            FZ_COLORSPACE_BGR => Some(Space::Bgr),
+            FZ_COLORSPACE_CMYK => Some(Space::Cmyk),
+            _ => None,
+        }
+    }
+
+    fn colorants(self) -> usize {
+        match self {
+            Space::Gray => 1,
+            Space::Rgb | Space::Bgr => 3,
+            Space::Cmyk => 4,
+        }
+    }
+}
+
+/// A conversion between two pixel layouts
+#[derive(Debug, Clone, Copy)]
+pub(super) struct Layouts {
+    from: Space,
+    from_alpha: bool,
+    to: Space,
+    to_alpha: bool,
+}
+
+impl Layouts {
+    fn src_n(&self) -> usize {
+        self.from.colorants() + usize::from(self.from_alpha)
+    }
+
+    fn dst_n(&self) -> usize {
+        self.to.colorants() + usize::from(self.to_alpha)
+    }
+}
+
+// ============================================================================
+// Lanes
+// ============================================================================
+
+/// `BLOCK` samples as `f32`, one per pixel of a block
+///
+/// Implementations are inlined into kernels built for their instruction
+/// set; callers must only use one the CPU has.
+pub(crate) trait Lanes: Copy {
+    fn splat(v: f32) -> Self;
+    fn load(v: &[f32; BLOCK]) -> Self;
+    fn store(self, out: &mut [f32; BLOCK]);
+    fn add(self, o: Self) -> Self;
+    fn sub(self, o: Self) -> Self;
+    fn mul(self, o: Self) -> Self;
+    fn div(self, o: Self) -> Self;
+    fn min(self, o: Self) -> Self;
+    fn max(self, o: Self) -> Self;
+    /// Integer part of non-negative values
+    fn trunc(self) -> Self;
+    fn sqrt(self) -> Self;
+    fn load_bytes(v: &[u8; BLOCK]) -> Self;
+    /// Values in 0 to 255, truncated to bytes
+    fn store_bytes(self, out: &mut [u8; BLOCK]);
+    /// `then` where `self <= o`, `otherwise` elsewhere
+    fn select_le(self, o: Self, then: Self, otherwise: Self) -> Self;
+}
+
+impl Lanes for [f32; BLOCK] {
+    #[inline(always)]
+    fn splat(v: f32) -> Self {
+        [v; BLOCK]
+    }
+    #[inline(always)]
+    fn load(v: &[f32; BLOCK]) -> Self {
+        *v
+    }
+    #[inline(always)]
+    fn store(self, out: &mut [f32; BLOCK]) {
+        *out = self;
+    }
+    #[inline(always)]
+    fn add(self, o: Self) -> Self {
+        std::array::from_fn(|i| self[i] + o[i])
+    }
+    #[inline(always)]
+    fn sub(self, o: Self) -> Self {
+        std::array::from_fn(|i| self[i] - o[i])
+    }
+    #[inline(always)]
+    fn mul(self, o: Self) -> Self {
+        std::array::from_fn(|i| self[i] * o[i])
+    }
+    #[inline(always)]
+    fn div(self, o: Self) -> Self {
+        std::array::from_fn(|i| self[i] / o[i])
+    }
+    #[inline(always)]
+    fn min(self, o: Self) -> Self {
+        std::array::from_fn(|i| self[i].min(o[i]))
+    }
+    #[inline(always)]
+    fn max(self, o: Self) -> Self {
+        std::array::from_fn(|i| self[i].max(o[i]))
+    }
+    #[inline(always)]
+    fn trunc(self) -> Self {
+        std::array::from_fn(|i| self[i] as i32 as f32)
+    }
+    #[inline(always)]
+    fn sqrt(self) -> Self {
+        std::array::from_fn(|i| self[i].sqrt())
+    }
+    #[inline(always)]
+    fn load_bytes(v: &[u8; BLOCK]) -> Self {
+        std::array::from_fn(|i| f32::from(v[i]))
+    }
+    #[inline(always)]
+    fn store_bytes(self, out: &mut [u8; BLOCK]) {
+        *out = std::array::from_fn(|i| self[i] as u8);
+    }
+    #[inline(always)]
+    fn select_le(self, o: Self, then: Self, otherwise: Self) -> Self {
+        std::array::from_fn(|i| match self[i] <= o[i] {
+            true => then[i],
+            false => otherwise[i],
+        })
+    }
+}
+
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+pub(crate) mod avx2 {
+    #[cfg(target_arch = "x86")]
+    use std::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use std::arch::x86_64::*;
+
+    use super::{BLOCK, Lanes};
+
+    #[derive(Clone, Copy)]
+    pub(crate) struct Avx2(__m256);
+
+    impl Lanes for Avx2 {
+        #[inline(always)]
+        fn splat(v: f32) -> Self {
+            unsafe { Avx2(_mm256_set1_ps(v)) }
+        }
+        #[inline(always)]
+        fn load(v: &[f32; BLOCK]) -> Self {
+            unsafe { Avx2(_mm256_loadu_ps(v.as_ptr())) }
+        }
+        #[inline(always)]
+        fn store(self, out: &mut [f32; BLOCK]) {
+            unsafe { _mm256_storeu_ps(out.as_mut_ptr(), self.0) }
+        }
+        #[inline(always)]
+        fn add(self, o: Self) -> Self {
+            unsafe { Avx2(_mm256_add_ps(self.0, o.0)) }
+        }
+        #[inline(always)]
+        fn sub(self, o: Self) -> Self {
+            unsafe { Avx2(_mm256_sub_ps(self.0, o.0)) }
+        }
+        #[inline(always)]
+        fn mul(self, o: Self) -> Self {
+            unsafe { Avx2(_mm256_mul_ps(self.0, o.0)) }
+        }
+        #[inline(always)]
+        fn div(self, o: Self) -> Self {
+            unsafe { Avx2(_mm256_div_ps(self.0, o.0)) }
+        }
+        #[inline(always)]
+        fn min(self, o: Self) -> Self {
+            unsafe { Avx2(_mm256_min_ps(self.0, o.0)) }
+        }
+        #[inline(always)]
+        fn max(self, o: Self) -> Self {
+            unsafe { Avx2(_mm256_max_ps(self.0, o.0)) }
+        }
+        #[inline(always)]
+        fn trunc(self) -> Self {
+            unsafe { Avx2(_mm256_cvtepi32_ps(_mm256_cvttps_epi32(self.0))) }
+        }
+        #[inline(always)]
+        fn sqrt(self) -> Self {
+            unsafe { Avx2(_mm256_sqrt_ps(self.0)) }
+        }
+        #[inline(always)]
+        fn load_bytes(v: &[u8; BLOCK]) -> Self {
+            unsafe {
+                let bytes = _mm_loadl_epi64(v.as_ptr() as *const __m128i);
+                Avx2(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(bytes)))
+            }
+        }
+        #[inline(always)]
+        fn store_bytes(self, out: &mut [u8; BLOCK]) {
+            unsafe {
+                let ints = _mm256_cvttps_epi32(self.0);
+                let words = _mm_packus_epi32(
+                    _mm256_castsi256_si128(ints),
+                    _mm256_extracti128_si256::<1>(ints),
+                );
+                let bytes = _mm_packus_epi16(words, words);
+                _mm_storel_epi64(out.as_mut_ptr() as *mut __m128i, bytes);
+            }
+        }
+        #[inline(always)]
+        fn select_le(self, o: Self, then: Self, otherwise: Self) -> Self {
+            unsafe {
+                let le = _mm256_cmp_ps::<_CMP_LE_OQ>(self.0, o.0);
+                Avx2(_mm256_blendv_ps(otherwise.0, then.0, le))
+            }
+        }
+    }
+}
+
+#[cfg(target_arch = "aarch64")]
+pub(crate) mod neon {
+    use std::arch::aarch64::*;
+
+    use super::{BLOCK, Lanes};
+
+    /// Eight lanes as two quad registers
+    #[derive(Clone, Copy)]
+    pub(crate) struct Neon(float32x4_t, float32x4_t);
+
+    macro_rules! lanewise {
+        ($op:ident, $a:expr, $b:expr) => {
+            unsafe { Neon($op($a.0, $b.0), $op($a.1, $b.1)) }
+        };
+    }
+
+    impl Lanes for Neon {
+        #[inline(always)]
+        fn splat(v: f32) -> Self {
+            unsafe { Neon(vdupq_n_f32(v), vdupq_n_f32(v)) }
+        }
+        #[inline(always)]
+        fn load(v: &[f32; BLOCK]) -> Self {
+            unsafe { Neon(vld1q_f32(v.as_ptr()), vld1q_f32(v.as_ptr().add(4))) }
+        }
+        #[inline(always)]
+        fn store(self, out: &mut [f32; BLOCK]) {
+            unsafe {
+                vst1q_f32(out.as_mut_ptr(), self.0);
+                vst1q_f32(out.as_mut_ptr().add(4), self.1);
+            }
+        }
+        #[inline(always)]
+        fn add(self, o: Self) -> Self {
+            lanewise!(vaddq_f32, self, o)
+        }
+        #[inline(always)]
+        fn sub(self, o: Self) -> Self {
+            lanewise!(vsubq_f32, self, o)
+        }
+        #[inline(always)]
+        fn mul(self, o: Self) -> Self {
+            lanewise!(vmulq_f32, self, o)
+        }
+        #[inline(always)]
+        fn div(self, o: Self) -> Self {
+            lanewise!(vdivq_f32, self, o)
+        }
+        #[inline(always)]
+        fn min(self, o: Self) -> Self {
+            lanewise!(vminq_f32, self, o)
+        }
+        #[inline(always)]
+        fn max(self, o: Self) -> Self {
+            lanewise!(vmaxq_f32, self, o)
+        }
+        #[inline(always)]
+        fn trunc(self) -> Self {
+            unsafe {
+                Neon(
+                    vcvtq_f32_s32(vcvtq_s32_f32(self.0)),
+                    vcvtq_f32_s32(vcvtq_s32_f32(self.1)),
+                )
+            }
+        }
+        #[inline(always)]
+        fn sqrt(self) -> Self {
+            unsafe { Neon(vsqrtq_f32(self.0), vsqrtq_f32(self.1)) }
+        }
+        #[inline(always)]
+        fn load_bytes(v: &[u8; BLOCK]) -> Self {
+            unsafe {
+                let words = vmovl_u8(vld1_u8(v.as_ptr()));
+                Neon(
+                    vcvtq_f32_u32(vmovl_u16(vget_low_u16(words))),
+                    vcvtq_f32_u32(vmovl_u16(vget_high_u16(words))),
+                )
+            }
+        }
+        #[inline(always)]
+        fn store_bytes(self, out: &mut [u8; BLOCK]) {
+            unsafe {
+                let words = vcombine_u16(
+                    vmovn_u32(vcvtq_u32_f32(self.0)),
+                    vmovn_u32(vcvtq_u32_f32(self.1)),
+                );
+                vst1_u8(out.as_mut_ptr(), vqmovn_u16(words));
+            }
+        }
+        #[inline(always)]
+        fn select_le(self, o: Self, then: Self, otherwise: Self) -> Self {
+            unsafe {
+                Neon(
+                    vbslq_f32(vcleq_f32(self.0, o.0), then.0, otherwise.0),
+                    vbslq_f32(vcleq_f32(self.1, o.1), then.1, otherwise.1),
+                )
+            }
+        }
+    }
+}
+
+// ============================================================================
+// Conversions
+// ============================================================================
+
+/// A block of pixels, one lane vector per component
+struct Planes<V> {
+    colour: [V; 4],
+    alpha: V,
+}
+
+/// Nearest integer of non-negative values
+#[inline(always)]
+fn round<V: Lanes>(v: V) -> V {
+    v.add(V::splat(0.5)).trunc()
+}
+
+/// Luma of RGB lanes, truncated
+#[inline(always)]
+fn luma<V: Lanes>(r: V, g: V, b: V) -> V {
+    let sum = r
+        .mul(V::splat(77.0))
+        .add(g.mul(V::splat(150.0)))
+        .add(b.mul(V::splat(29.0)));
+    sum.mul(V::splat(1.0 / 256.0)).trunc()
+}
+
+/// `(a - x) * (a - y) / a`: the product of two inverted premultiplied
+/// components, premultiplied once
+#[inline(always)]
+fn inverse_product<V: Lanes>(x: V, y: V, a: V) -> V {
+    let (ix, iy) = (a.sub(x.min(a)), a.sub(y.min(a)));
+    round(ix.mul(iy).div(a.max(V::splat(1.0))))
+}
+
+#[inline(always)]
+fn cmyk_to_rgb<V: Lanes>(p: &Planes<V>) -> [V; 3] {
+    let [c, m, y, k] = p.colour;
+    [
+        inverse_product(c, k, p.alpha),
+        inverse_product(m, k, p.alpha),
+        inverse_product(y, k, p.alpha),
+    ]
+}
+
+#[inline(always)]
+fn rgb_to_cmyk<V: Lanes>(r: V, g: V, b: V, a: V) -> [V; 4] {
+    let max = r.max(g).max(b).min(a);
+    let divisor = max.max(V::splat(1.0));
+    // Each of C, M, Y is (1 - x - K) / (1 - K), premultiplied
+    let ink = |x: V| round(max.sub(x.min(max)).mul(a).div(divisor));
+    [ink(r), ink(g), ink(b), a.sub(max)]
+}
+
+/// Colour lanes of `p`, in `layouts.from`, converted to `layouts.to`
+#[inline(always)]
+fn convert<V: Lanes>(p: &Planes<V>, layouts: &Layouts) -> [V; 4] {
+    let zero = V::splat(0.0);
+    let [c0, c1, c2, _] = p.colour;
+    match (layouts.from, layouts.to) {
+        (from, to) if from == to => p.colour,
+        (Space::Gray, Space::Rgb | Space::Bgr) => [c0, c0, c0, zero],
+        (Space::Rgb, Space::Bgr) | (Space::Bgr, Space::Rgb) => [c2, c1, c0, zero],
+        (Space::Rgb, Space::Gray) => [luma(c0, c1, c2), zero, zero, zero],
+        (Space::Bgr, Space::Gray) => [luma(c2, c1, c0), zero, zero, zero],
+        (Space::Gray, Space::Cmyk) => [zero, zero, zero, p.alpha.sub(c0.min(p.alpha))],
+        (Space::Rgb, Space::Cmyk) => rgb_to_cmyk(c0, c1, c2, p.alpha),
+        (Space::Bgr, Space::Cmyk) => rgb_to_cmyk(c2, c1, c0, p.alpha),
+        (Space::Cmyk, Space::Rgb) => {
+            let [r, g, b] = cmyk_to_rgb(p);
+            [r, g, b, zero]
+        }
+        (Space::Cmyk, Space::Bgr) => {
+            let [r, g, b] = cmyk_to_rgb(p);
+            [b, g, r, zero]
+        }
+        (Space::Cmyk, Space::Gray) => {
+            let [r, g, b] = cmyk_to_rgb(p);
+            [luma(r, g, b), zero, zero, zero]
+        }
+        _ => unreachable!("every pair of device spaces is covered"),
+    }
+}
+
+// ============================================================================
+// Kernels
+// ============================================================================
+
+/// Convert `count` pixels of `src` into `dst`, `BLOCK` at a time
+#[inline(always)]
+fn convert_run<V: Lanes>(src: &[u8], dst: &mut [u8], count: usize, layouts: &Layouts) {
+    let (sn, dn) = (layouts.src_n(), layouts.dst_n());
+    let (sc, dc) = (layouts.from.colorants(), layouts.to.colorants());
+    let mut lanes = [[0.0f32; BLOCK]; 5];
+    let mut start = 0;
+    while start < count {
+        let len = BLOCK.min(count - start);
+        let src = &src[start * sn..(start + len) * sn];
+        let dst = &mut dst[start * dn..(start + len) * dn];
+
+        lanes[4] = [255.0; BLOCK];
+        for (i, px) in src.chunks_exact(sn).enumerate() {
+            for c in 0..sc {
+                lanes[c][i] = f32::from(px[c]);
+            }
+            if layouts.from_alpha {
+                lanes[4][i] = f32::from(px[sc]);
+            }
+        }
+        let planes = Planes {
+            colour: std::array::from_fn(|c| V::load(&lanes[c])),
+            alpha: V::load(&lanes[4]),
+        };
+
+        let out = convert(&planes, layouts);
+        for (c, v) in out.into_iter().enumerate().take(dc) {
+            v.store(&mut lanes[c]);
+        }
+        for (i, px) in dst.chunks_exact_mut(dn).enumerate() {
+            for c in 0..dc {
+                px[c] = lanes[c][i] as u8;
+            }
+            if layouts.to_alpha {
+                px[dc] = lanes[4][i] as u8;
+            }
+        }
+        start += len;
+    }
+}
+
+/// Pixel converter, as held in the kernel dispatch table
+pub(super) type ConvertFn = unsafe fn(&[u8], &mut [u8], usize, &Layouts);
+
+/// Converter the dispatch table uses at `level`
+pub(super) fn convert_kernel(level: SimdLevel) -> ConvertFn {
+    match level {
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        SimdLevel::Avx2 => convert_avx2,
+        #[cfg(target_arch = "aarch64")]
+        SimdLevel::Neon => convert_neon,
+        _ => convert_scalar,
+    }
+}
+
+fn convert_scalar(src: &[u8], dst: &mut [u8], count: usize, layouts: &Layouts) {
+    convert_run::<[f32; BLOCK]>(src, dst, count, layouts)
+}
+
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "avx2")]
+unsafe fn convert_avx2(src: &[u8], dst: &mut [u8], count: usize, layouts: &Layouts) {
+    convert_run::<avx2::Avx2>(src, dst, count, layouts)
+}
+
+#[cfg(target_arch = "aarch64")]
+#[target_feature(enable = "neon")]
+unsafe fn convert_neon(src: &[u8], dst: &mut [u8], count: usize, layouts: &Layouts) {
+    convert_run::<neon::Neon>(src, dst, count, layouts)
+}
+
+fn dispatch(src: &[u8], dst: &mut [u8], count: usize, layouts: &Layouts, simd: bool) {
+    let convert: ConvertFn = if simd {
+        kernels().convert_pixels
+    } else {
+        convert_scalar
+    };
+    // The table only holds kernels the CPU runs
+    unsafe { convert(src, dst, count, layouts) }
+}
+
+/// Convert `count` pixels from `src` (in `src_cs`, alpha last if
+/// `src_alpha`) into `dst` (in `dst_cs`, alpha last if `dst_alpha`)
+///
+/// Returns false, leaving `dst` alone, unless both are device spaces and
+/// the buffers hold `count` pixels.
+pub fn convert_pixels(
+    src: &[u8],
+    src_cs: ColorspaceHandle,
+    src_alpha: bool,
+    dst: &mut [u8],
+    dst_cs: ColorspaceHandle,
+    dst_alpha: bool,
+    count: usize,
+) -> bool {
+    convert_pixels_with(src, src_cs, src_alpha, dst, dst_cs, dst_alpha, count, true)
+}
+
+#[allow(clippy::too_many_arguments)]
+fn convert_pixels_with(
+    src: &[u8],
+    src_cs: ColorspaceHandle,
+    src_alpha: bool,
+    dst: &mut [u8],
+    dst_cs: ColorspaceHandle,
+    dst_alpha: bool,
+    count: usize,
+    simd: bool,
+) -> bool {
+    let (Some(from), Some(to)) = (Space::from_handle(src_cs), Space::from_handle(dst_cs)) else {
+        return false;
+    };
+    let layouts = Layouts {
+        from,
+        from_alpha: src_alpha,
+        to,
+        to_alpha: dst_alpha,
+    };
+    if src.len() < count * layouts.src_n() || dst.len() < count * layouts.dst_n() {
+        return false;
+    }
+    dispatch(src, dst, count, &layouts, simd);
+    true
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const SPACES: [ColorspaceHandle; 4] = [
+        FZ_COLORSPACE_GRAY,
+        FZ_COLORSPACE_RGB,
+        FZ_COLORSPACE_BGR,
+        FZ_COLORSPACE_CMYK,
+    ];
+
+    fn n(cs: ColorspaceHandle, alpha: bool) -> usize {
+        Space::from_handle(cs).unwrap().colorants() + usize::from(alpha)
+    }
+
+    /// `count` premultiplied pixels
+    fn pattern(cs: ColorspaceHandle, alpha: bool, count: usize) -> Vec<u8> {
+        let n = n(cs, alpha);
+        let mut data: Vec<u8> = (0..count * n).map(|i| (i * 73 % 256) as u8).collect();
+        if alpha {
+            for px in data.chunks_exact_mut(n) {
+                let a = px[n - 1];
+                px[..n - 1].iter_mut().for_each(|c| *c = (*c).min(a));
+            }
+        }
+        data
+    }
+
+    fn convert(src: &[u8], from: ColorspaceHandle, to: ColorspaceHandle) -> Vec<u8> {
+        let count = src.len() / n(from, false);
+        let mut dst = vec![0; count * n(to, false)];
+        assert!(convert_pixels(src, from, false, &mut dst, to, false, count));
+        dst
+    }
+
+    #[test]
+    fn test_simd_matches_scalar_for_every_layout() {
+        let count = 37;
+        for from in SPACES {
+            for to in SPACES {
+                for (from_alpha, to_alpha) in
+                    [(false, false), (true, true), (true, false), (false, true)]
+                {
+                    let src = pattern(from, from_alpha, count);
+                    let mut simd = vec![0; count * n(to, to_alpha)];
+                    let mut scalar = simd.clone();
+                    for (dst, use_simd) in [(&mut simd, true), (&mut scalar, false)] {
+                        assert!(convert_pixels_with(
+                            &src, from, from_alpha, dst, to, to_alpha, count, use_simd
+                        ));
+                    }
+                    assert_eq!(simd, scalar, "{from} {from_alpha} -> {to} {to_alpha}");
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn test_device_conversions() {
+        assert_eq!(
+            convert(&[128], FZ_COLORSPACE_GRAY, FZ_COLORSPACE_RGB),
+            [128, 128, 128]
+        );
+        assert_eq!(
+            convert(&[10, 20, 30], FZ_COLORSPACE_RGB, FZ_COLORSPACE_BGR),
+            [30, 20, 10]
+        );
+        assert_eq!(
+            convert(&[255, 255, 255], FZ_COLORSPACE_RGB, FZ_COLORSPACE_GRAY),
+            [255]
+        );
+        assert_eq!(
+            convert(
+                &[0, 255, 255, 0, 0, 0, 0, 255],
+                FZ_COLORSPACE_CMYK,
+                FZ_COLORSPACE_RGB
+            ),
+            [255, 0, 0, 0, 0, 0]
+        );
+        assert_eq!(
+            convert(
+                &[255, 0, 0, 51, 51, 102],
+                FZ_COLORSPACE_RGB,
+                FZ_COLORSPACE_CMYK
+            ),
+            [0, 255, 255, 0, 128, 128, 0, 153]
+        );
+        assert_eq!(
+            convert(&[200], FZ_COLORSPACE_GRAY, FZ_COLORSPACE_CMYK),
+            [0, 0, 0, 55]
+        );
+    }
+
+    #[test]
+    fn test_cmyk_scales_by_alpha() {
+        // Half-transparent cyan stays half-transparent cyan
+        let src = [128, 0, 0, 0, 128];
+        let mut dst = [0; 4];
+        assert!(convert_pixels(
+            &src,
+            FZ_COLORSPACE_CMYK,
+            true,
+            &mut dst,
+            FZ_COLORSPACE_RGB,
+            true,
+            1
+        ));
+        assert_eq!(dst, [0, 128, 128, 128]);
+        // A source without alpha is opaque
+        let mut opaque = [0; 5];
+        assert!(convert_pixels(
+            &[0, 0, 0],
+            FZ_COLORSPACE_RGB,
+            false,
+            &mut opaque,
+            FZ_COLORSPACE_CMYK,
+            true,
+            1
+        ));
+        assert_eq!(opaque, [0, 0, 0, 255, 255]);
+    }
+
+    #[test]
+    fn test_other_spaces_are_left_alone() {
+        let mut dst = [7; 3];
+        assert!(!convert_pixels(
+            &[1, 2, 3],
+            5,
+            false,
+            &mut dst,
+            FZ_COLORSPACE_RGB,
+            false,
+            1
+        ));
+        assert!(!convert_pixels(
+            &[1],
+            FZ_COLORSPACE_GRAY,
+            false,
+            &mut dst,
+            FZ_COLORSPACE_RGB,
+            false,
+            2
+        ));
+        assert_eq!(dst, [7; 3]);
+    }
+}
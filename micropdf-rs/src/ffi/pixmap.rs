@@ -1,8 +1,11 @@
 //! C FFI for pixmap - MuPDF compatible
 //! Safe Rust implementation using handle-based resource management
 
-use super::colorspace::{ColorspaceHandle, FZ_COLORSPACE_RGB};
+use super::colorspace::{ColorspaceHandle, FZ_COLORSPACE_RGB, icc_transform};
 use super::geometry::fz_irect;
+use super::pixel_convert::convert_pixels;
+use super::pixmap_pool::Samples;
+use super::resample::{Filter, resample};
 use super::{Handle, PIXMAPS};
 
 /// Internal pixmap state
@@ -14,12 +17,20 @@ pub struct Pixmap {
     n: i32, // Number of components
     alpha: bool,
     stride: i32,
-    samples: Vec<u8>,
+    samples: Samples,
     colorspace: ColorspaceHandle,
 }
 
 impl Pixmap {
     pub fn new(cs: ColorspaceHandle, width: i32, height: i32, alpha: bool) -> Self {
+        Self::filled(cs, width, height, alpha, 0)
+    }
+
+    /// A pixmap with every sample set to `value`
+    ///
+    /// Cheaper than `new` then `clear_with_value`, since a recycled sample
+    /// buffer is written once rather than zeroed first.
+    pub fn filled(cs: ColorspaceHandle, width: i32, height: i32, alpha: bool, value: u8) -> Self {
         let n = super::colorspace::fz_colorspace_n(0, cs) + i32::from(alpha);
         let stride = width * n;
         let size = (stride * height) as usize;
@@ -32,12 +43,17 @@ impl Pixmap {
             n,
             alpha,
             stride,
-            samples: vec![0u8; size],
+            samples: Samples::filled(size, value),
             colorspace: cs,
         }
     }
 
     pub fn with_bbox(cs: ColorspaceHandle, bbox: fz_irect, alpha: bool) -> Self {
+        Self::with_bbox_filled(cs, bbox, alpha, 0)
+    }
+
+    /// A pixmap covering `bbox` with every sample set to `value`
+    pub fn with_bbox_filled(cs: ColorspaceHandle, bbox: fz_irect, alpha: bool, value: u8) -> Self {
         let width = bbox.x1 - bbox.x0;
         let height = bbox.y1 - bbox.y0;
         let n = super::colorspace::fz_colorspace_n(0, cs) + i32::from(alpha);
@@ -52,17 +68,18 @@ impl Pixmap {
             n,
             alpha,
             stride,
-            samples: vec![0u8; size],
+            samples: Samples::filled(size, value),
             colorspace: cs,
         }
     }
 
     pub fn clear(&mut self) {
-        self.samples.fill(0);
+        self.samples.fill_value(0);
     }
 
+    /// Set every sample to `value`; skipped when they are known to hold it
     pub fn clear_with_value(&mut self, value: u8) {
-        self.samples.fill(value);
+        self.samples.fill_value(value);
     }
 
     pub fn get_sample(&self, x: i32, y: i32, component: i32) -> Option<u8> {
@@ -119,6 +136,12 @@ impl Pixmap {
         self.y
     }
 
+    /// Move the pixmap to another origin, keeping its samples
+    pub fn set_origin(&mut self, x: i32, y: i32) {
+        self.x = x;
+        self.y = y;
+    }
+
     /// Get number of components (including alpha)
     pub fn n(&self) -> i32 {
         self.n
@@ -177,6 +200,96 @@ pub extern "C" fn fz_new_pixmap_with_bbox(
     PIXMAPS.insert(Pixmap::with_bbox(cs, bbox, alpha != 0))
 }
 
+/// Create a pixmap over caller-owned sample memory
+///
+/// Renders and other pixmap operations write straight into `samples`, so a
+/// caller that already holds the destination (a canvas buffer, shared
+/// memory, a staging buffer) needs no final copy. Rows are `stride` bytes
+/// apart and may be padded; the memory is never freed by the pixmap.
+///
+/// # Arguments
+/// * `stride` - Bytes per row, at least `w` times the component count
+/// * `samples` - At least `stride * h` bytes
+///
+/// # Safety
+/// `samples` must stay valid, and must not be freed, until the last
+/// reference to the pixmap is dropped.
+///
+/// # Returns
+/// Pixmap handle, or 0 if `samples` is null or `stride` is too small
+#[unsafe(no_mangle)]
+#[allow(clippy::too_many_arguments)]
+pub extern "C" fn fz_new_pixmap_with_data(
+    _ctx: Handle,
+    cs: ColorspaceHandle,
+    w: i32,
+    h: i32,
+    _seps: Handle,
+    alpha: i32,
+    stride: i32,
+    samples: *mut u8,
+) -> Handle {
+    let cs = if cs == 0 { FZ_COLORSPACE_RGB } else { cs };
+    let alpha = alpha != 0;
+    let n = super::colorspace::fz_colorspace_n(0, cs) + i32::from(alpha);
+    if w < 0 || h < 0 || w.checked_mul(n).is_none_or(|row| stride < row) {
+        return 0;
+    }
+    let Some(samples) = (unsafe { Samples::foreign(samples, stride as usize * h as usize) }) else {
+        return 0;
+    };
+    PIXMAPS.insert(Pixmap {
+        x: 0,
+        y: 0,
+        width: w,
+        height: h,
+        n,
+        alpha,
+        stride,
+        samples,
+        colorspace: cs,
+    })
+}
+
+/// Create a pixmap covering `bbox` over caller-owned sample memory
+///
+/// Rows are packed (`stride` is the width times the component count);
+/// otherwise as for `fz_new_pixmap_with_data`.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_pixmap_with_bbox_and_data(
+    ctx: Handle,
+    cs: ColorspaceHandle,
+    bbox: fz_irect,
+    seps: Handle,
+    alpha: i32,
+    samples: *mut u8,
+) -> Handle {
+    let cs = if cs == 0 { FZ_COLORSPACE_RGB } else { cs };
+    let (w, h) = (bbox.x1 - bbox.x0, bbox.y1 - bbox.y0);
+    let n = super::colorspace::fz_colorspace_n(0, cs) + i32::from(alpha != 0);
+    let pix = fz_new_pixmap_with_data(ctx, cs, w, h, seps, alpha, w * n, samples);
+    if let Some(p) = PIXMAPS.get(pix) {
+        if let Ok(mut guard) = p.lock() {
+            guard.set_origin(bbox.x0, bbox.y0);
+        }
+    }
+    pix
+}
+
+/// Create a pixmap with bounding box, every sample set to `value`
+///
+/// Render paths use this in place of `fz_new_pixmap_with_bbox` followed by
+/// `fz_clear_pixmap_with_value`, so a recycled buffer is only written once.
+pub(crate) fn new_pixmap_with_bbox_filled(
+    cs: ColorspaceHandle,
+    bbox: fz_irect,
+    alpha: bool,
+    value: u8,
+) -> Handle {
+    let cs = if cs == 0 { FZ_COLORSPACE_RGB } else { cs };
+    PIXMAPS.insert(Pixmap::with_bbox_filled(cs, bbox, alpha, value))
+}
+
 /// Keep (increment ref) pixmap
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_keep_pixmap(_ctx: Handle, pix: Handle) -> Handle {
@@ -186,7 +299,7 @@ pub extern "C" fn fz_keep_pixmap(_ctx: Handle, pix: Handle) -> Handle {
 /// Drop pixmap reference
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_drop_pixmap(_ctx: Handle, pix: Handle) {
-    let _ = PIXMAPS.remove(pix);
+    PIXMAPS.release(pix);
 }
 
 /// Get pixmap X origin
@@ -406,14 +519,42 @@ pub extern "C" fn fz_set_pixmap_sample(_ctx: Handle, pix: Handle, x: i32, y: i32
 
 /// Get pointer to pixmap samples
 ///
-/// Note: Returns null as we cannot safely expose internal pointers.
-/// Use fz_get_pixmap_sample to access individual samples.
+/// Returns a pointer to the pixmap's internal sample data, compatible with
+/// MuPDF's fz_pixmap_samples. The sample storage is allocated once when the
+/// pixmap is created and never resized, so bindings can expose it without
+/// copying (e.g. as an external ArrayBuffer).
+///
+/// # Safety
+/// The returned pointer is valid until the pixmap is dropped. Callers that
+/// hand it out must keep a reference (see fz_keep_pixmap) for as long as the
+/// memory is in use. Use fz_pixmap_size for the length in bytes.
 #[unsafe(no_mangle)]
-pub extern "C" fn fz_pixmap_samples(_ctx: Handle, _pix: Handle) -> *mut u8 {
-    // Cannot safely return pointer to internal data
+pub extern "C" fn fz_pixmap_samples(_ctx: Handle, pix: Handle) -> *mut u8 {
+    if let Some(pixmap) = PIXMAPS.get(pix) {
+        if let Ok(mut guard) = pixmap.lock() {
+            if guard.samples.is_empty() {
+                return std::ptr::null_mut();
+            }
+            return guard.samples.expose();
+        }
+    }
     std::ptr::null_mut()
 }
 
+/// Get size of pixmap sample data in bytes
+///
+/// # Returns
+/// `stride * height`, or 0 for an invalid handle
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_pixmap_size(_ctx: Handle, pix: Handle) -> usize {
+    if let Some(pixmap) = PIXMAPS.get(pix) {
+        if let Ok(guard) = pixmap.lock() {
+            return guard.samples.len();
+        }
+    }
+    0
+}
+
 /// Clone a pixmap
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_clone_pixmap(_ctx: Handle, pix: Handle) -> Handle {
@@ -457,13 +598,38 @@ pub extern "C" fn fz_convert_pixmap(
             let new_stride = guard.width * new_n;
             let new_size = (new_stride * guard.height).max(0) as usize;
 
-            let mut new_samples = vec![0u8; new_size];
+            let mut new_samples = Samples::zeroed(new_size);
+
+            let count = (guard.width.max(0) * guard.height.max(0)) as usize;
+            // ICC-based spaces convert through a cached transform's table
+            let icc = icc_transform(guard.colorspace, cs, 0, 0);
+            if let Some(transform) = &icc {
+                transform.convert_pixels(
+                    &guard.samples,
+                    guard.alpha,
+                    &mut new_samples,
+                    alpha,
+                    count,
+                );
+            }
 
-            // Simple conversion: copy/convert each pixel
+            // Device spaces convert a block of pixels at a time
+            let converted = icc.is_some()
+                || convert_pixels(
+                    &guard.samples,
+                    guard.colorspace,
+                    guard.alpha,
+                    &mut new_samples,
+                    cs,
+                    alpha,
+                    count,
+                );
+
+            // Otherwise copy/convert each pixel
             let src_colorants = (guard.n - i32::from(guard.alpha)) as usize;
             let dst_colorants = target_n as usize;
 
-            for y in 0..guard.height {
+            for y in (0..guard.height).filter(|_| !converted) {
                 for x in 0..guard.width {
                     let src_offset = (y * guard.stride + x * guard.n) as usize;
                     let dst_offset = (y * new_stride + x * new_n) as usize;
@@ -674,38 +840,78 @@ pub extern "C" fn fz_pixmap_is_valid(_ctx: Handle, pix: Handle) -> i32 {
     if PIXMAPS.get(pix).is_some() { 1 } else { 0 }
 }
 
+/// Box-filter resampling, averaging the source pixels each output covers
+pub const FZ_SCALE_BOX: i32 = 0;
+/// Bilinear resampling
+pub const FZ_SCALE_BILINEAR: i32 = 1;
+/// Lanczos (three-lobe) resampling
+pub const FZ_SCALE_LANCZOS: i32 = 2;
+
+/// Resample `pix` to `w` x `h` with `filter`, into a new pixmap
+fn scale_pixmap(pix: Handle, w: i32, h: i32, filter: Filter) -> Handle {
+    if w <= 0 || h <= 0 {
+        return 0;
+    }
+    let Some(p) = PIXMAPS.get(pix) else {
+        return 0;
+    };
+    let Ok(guard) = p.lock() else {
+        return 0;
+    };
+    let mut scaled = Pixmap::new(guard.colorspace, w, h, guard.alpha);
+    scaled.samples = resample(
+        &guard.samples,
+        guard.width as usize,
+        guard.height as usize,
+        guard.n as usize,
+        w as usize,
+        h as usize,
+        filter,
+        guard.alpha,
+    )
+    .into();
+    PIXMAPS.insert(scaled)
+}
+
 /// Scale pixmap to new dimensions
+///
+/// Shrinking averages boxes of source pixels; enlarging interpolates.
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_scale_pixmap(_ctx: Handle, pix: Handle, xscale: f32, yscale: f32) -> Handle {
-    if let Some(p) = PIXMAPS.get(pix) {
-        if let Ok(guard) = p.lock() {
-            let new_width = ((guard.width as f32) * xscale) as i32;
-            let new_height = ((guard.height as f32) * yscale) as i32;
-
-            if new_width <= 0 || new_height <= 0 {
-                return 0;
-            }
-
-            let mut scaled = Pixmap::new(guard.colorspace, new_width, new_height, guard.alpha);
-
-            // Simple nearest-neighbor scaling
-            for y in 0..new_height {
-                for x in 0..new_width {
-                    let src_x = ((x as f32) / xscale) as i32;
-                    let src_y = ((y as f32) / yscale) as i32;
-
-                    for c in 0..guard.n {
-                        if let Some(value) = guard.get_sample(src_x, src_y, c) {
-                            scaled.set_sample(x, y, c, value);
-                        }
-                    }
-                }
-            }
+    let Some((w, h)) = PIXMAPS
+        .get(pix)
+        .and_then(|p| p.lock().ok().map(|p| (p.width, p.height)))
+    else {
+        return 0;
+    };
+    let new_width = ((w as f32) * xscale) as i32;
+    let new_height = ((h as f32) * yscale) as i32;
+    let filter = if new_width <= w && new_height <= h {
+        Filter::Box
+    } else {
+        Filter::Bilinear
+    };
+    scale_pixmap(pix, new_width, new_height, filter)
+}
 
-            return PIXMAPS.insert(scaled);
-        }
-    }
-    0
+/// Resample pixmap to `w` x `h` with a `FZ_SCALE_*` filter
+///
+/// Returns a new pixmap, or 0 if the size or filter is invalid.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_scale_pixmap_filtered(
+    _ctx: Handle,
+    pix: Handle,
+    w: i32,
+    h: i32,
+    filter: i32,
+) -> Handle {
+    let filter = match filter {
+        FZ_SCALE_BOX => Filter::Box,
+        FZ_SCALE_BILINEAR => Filter::Bilinear,
+        FZ_SCALE_LANCZOS => Filter::Lanczos3,
+        _ => return 0,
+    };
+    scale_pixmap(pix, w, h, filter)
 }
 
 /// Get X resolution
@@ -792,6 +998,10 @@ mod tests {
         let kept = fz_keep_pixmap(0, handle);
         assert_eq!(kept, handle);
         fz_drop_pixmap(0, handle);
+        // The kept reference keeps the handle alive until it is dropped too
+        assert!(PIXMAPS.get(handle).is_some());
+        fz_drop_pixmap(0, kept);
+        assert!(PIXMAPS.get(handle).is_none());
     }
 
     #[test]
@@ -1044,14 +1254,49 @@ mod tests {
     // ============================================================================
 
     #[test]
-    fn test_pixmap_samples_returns_null() {
+    fn test_pixmap_samples_pointer() {
         let handle = fz_new_pixmap(0, FZ_COLORSPACE_RGB, 10, 10, 0, 0);
+        fz_set_pixmap_sample(0, handle, 2, 3, 1, 0xAB);
+
         let samples = fz_pixmap_samples(0, handle);
-        // Should return null for safety
-        assert!(samples.is_null());
+        assert!(!samples.is_null());
+        assert_eq!(fz_pixmap_size(0, handle), 10 * 10 * 3);
+
+        // The pointer aliases the pixmap's storage: writes are visible both ways
+        let offset = (3 * fz_pixmap_stride(0, handle) + 2 * 3 + 1) as usize;
+        assert_eq!(unsafe { *samples.add(offset) }, 0xAB);
+        unsafe { *samples.add(offset) = 0x12 };
+        assert_eq!(fz_get_pixmap_sample(0, handle, 2, 3, 1), 0x12);
+
         fz_drop_pixmap(0, handle);
     }
 
+    #[test]
+    fn test_pixmap_with_data() {
+        let mut memory = vec![0u8; 12 * 4];
+        let ptr = memory.as_mut_ptr();
+        // RGB rows of 3 pixels padded to 12 bytes
+        let handle = fz_new_pixmap_with_data(0, FZ_COLORSPACE_RGB, 3, 4, 0, 0, 12, ptr);
+        assert_ne!(handle, 0);
+        assert_eq!(fz_pixmap_stride(0, handle), 12);
+        assert_eq!(fz_pixmap_samples(0, handle), ptr);
+        fz_set_pixmap_sample(0, handle, 1, 2, 0, 9);
+        fz_drop_pixmap(0, handle);
+        assert_eq!(memory[2 * 12 + 3], 9);
+
+        assert_eq!(fz_new_pixmap_with_data(0, FZ_COLORSPACE_RGB, 3, 4, 0, 0, 8, ptr), 0);
+        assert_eq!(
+            fz_new_pixmap_with_data(0, FZ_COLORSPACE_RGB, 3, 4, 0, 0, 12, std::ptr::null_mut()),
+            0
+        );
+    }
+
+    #[test]
+    fn test_pixmap_samples_invalid_handle() {
+        assert!(fz_pixmap_samples(0, 0).is_null());
+        assert_eq!(fz_pixmap_size(0, 0), 0);
+    }
+
     // ============================================================================
     // Tint Tests
     // ============================================================================
@@ -1148,4 +1393,28 @@ mod tests {
         let result = convert_color(FZ_COLORSPACE_RGB, FZ_COLORSPACE_RGB, &[100, 150, 200], 3);
         assert_eq!(result, vec![100, 150, 200]);
     }
+
+    #[test]
+    fn test_scale_pixmap_averages_when_shrinking() {
+        let pix = fz_new_pixmap(0, FZ_COLORSPACE_GRAY, 4, 2, 0, 0);
+        for x in 0..4 {
+            for y in 0..2 {
+                fz_set_pixmap_sample(0, pix, x, y, 0, if x < 2 { 0 } else { 200 });
+            }
+        }
+        let half = fz_scale_pixmap(0, pix, 0.5, 0.5);
+        assert_eq!(
+            (fz_pixmap_width(0, half), fz_pixmap_height(0, half)),
+            (2, 1)
+        );
+        assert_eq!(fz_get_pixmap_sample(0, half, 0, 0, 0), 0);
+        assert_eq!(fz_get_pixmap_sample(0, half, 1, 0, 0), 200);
+
+        let wide = fz_scale_pixmap_filtered(0, pix, 9, 3, FZ_SCALE_LANCZOS);
+        assert_eq!(fz_pixmap_width(0, wide), 9);
+        assert_eq!(fz_scale_pixmap_filtered(0, pix, 9, 3, 7), 0);
+        for handle in [pix, half, wide] {
+            fz_drop_pixmap(0, handle);
+        }
+    }
 }
@@ -0,0 +1,559 @@
+//! Recycling Pool for Pixmap Sample Buffers
+//!
+//! Batch renders at a fixed resolution create and drop a pixmap of the same
+//! size for every page, so each page would otherwise fault in fresh memory
+//! from the allocator. Sample buffers of 64 KiB and up are instead taken
+//! from page-aligned blocks in size classes a quarter of a power of two
+//! apart, and a dropped pixmap hands its block back for the next one.
+//!
+//! Every block remembers the byte value it is known to be filled with, if
+//! any. A clear to that value is skipped, and a fresh block comes zeroed
+//! from the allocator without being written, so recycling never costs more
+//! than the one fill the new pixmap needs. Writing to the samples forgets
+//! the value, and a pixmap whose samples pointer has been handed to C never
+//! tracks one again.
+//!
+//! The pool holds at most `fz_pixmap_pool_limit` bytes, evicting the
+//! longest-cached blocks first; a limit of 0 turns recycling off. Blocks of
+//! 2 MiB and up can be backed by transparent or reserved huge pages.
+//!
+//! With NUMA placement on, a new block is bound to the node of the thread
+//! allocating it, and a cached block only goes to threads on its node, so
+//! render workers pinned to a node keep their pixmaps in local memory.
+//!
+//! Pixmaps over caller memory (`fz_new_pixmap_with_data`) wrap it as is,
+//! with no pooling and no fill tracking.
+
+use std::collections::VecDeque;
+use std::ops::{Deref, DerefMut};
+use std::ptr::NonNull;
+use std::sync::atomic::{AtomicBool, AtomicI32, AtomicU64, AtomicUsize, Ordering};
+use std::sync::{LazyLock, Mutex};
+
+use super::Handle;
+use super::data_locality::{
+    FZ_PAGE_BUFFER_HUGETLB, HugePages, Placement, RawPages, current_numa_node,
+};
+use crate::fitz::alloc_sampler::{self, Subsystem};
+use crate::fitz::memory_budget::{self, Charge};
+
+/// Smallest sample buffer taken from the pool
+const MIN_POOLED_SIZE: usize = 64 * 1024;
+
+/// Alignment of pooled blocks
+#[cfg(test)]
+const PAGE_SIZE: usize = 4096;
+
+/// Default upper bound on the bytes held by the pool
+pub const FZ_PIXMAP_POOL_DEFAULT_LIMIT: usize = 256 * 1024 * 1024;
+
+/// Capacity of the size class holding `size` bytes, or `None` below the
+/// pooled minimum
+fn size_class(size: usize) -> Option<usize> {
+    if size < MIN_POOLED_SIZE {
+        return None;
+    }
+    // Four classes per power of two bounds the slack at a quarter
+    let step = (1usize << (usize::BITS - 1 - (size - 1).leading_zeros())) / 4;
+    size.checked_next_multiple_of(step)
+}
+
+/// A page-aligned block
+struct Block {
+    pages: RawPages,
+    /// NUMA node the block is bound to
+    node: Option<usize>,
+}
+
+impl Block {
+    /// Allocate `capacity` bytes, zeroed if `zeroed`
+    fn new(capacity: usize, zeroed: bool, placement: Placement) -> Option<Self> {
+        let pages = RawPages::new(capacity, zeroed, placement)?;
+        Some(Self {
+            pages,
+            node: placement.node,
+        })
+    }
+
+    fn capacity(&self) -> usize {
+        self.pages.size()
+    }
+
+    fn as_ptr(&self) -> *mut u8 {
+        self.pages.as_ptr()
+    }
+}
+
+/// A known fill: the byte value and how many leading bytes hold it
+type Fill = Option<(u8, usize)>;
+
+/// A cached block with the byte it is known to be filled with
+struct Cached {
+    block: Block,
+    fill: Fill,
+}
+
+struct PixmapPool {
+    cached: Mutex<VecDeque<Cached>>,
+    bytes: AtomicUsize,
+    limit: AtomicUsize,
+    /// `FZ_PAGE_BUFFER_THP`, `FZ_PAGE_BUFFER_HUGETLB` or 0
+    huge_pages: AtomicI32,
+    numa: AtomicBool,
+    hits: AtomicU64,
+    misses: AtomicU64,
+}
+
+static PIXMAP_POOL: LazyLock<PixmapPool> = LazyLock::new(|| PixmapPool {
+    cached: Mutex::new(VecDeque::new()),
+    bytes: AtomicUsize::new(0),
+    limit: AtomicUsize::new(FZ_PIXMAP_POOL_DEFAULT_LIMIT),
+    huge_pages: AtomicI32::new(0),
+    numa: AtomicBool::new(false),
+    hits: AtomicU64::new(0),
+    misses: AtomicU64::new(0),
+});
+
+impl PixmapPool {
+    /// Take the most recently cached block of `capacity` bytes, preferring
+    /// one already filled with `want`; with a `node`, only blocks bound to
+    /// it qualify
+    fn acquire(&self, capacity: usize, want: u8, node: Option<usize>) -> Option<Cached> {
+        let mut cached = self.cached.lock().ok()?;
+        let mut found = None;
+        for (i, c) in cached.iter().enumerate().rev() {
+            if c.block.capacity() == capacity && (node.is_none() || c.block.node == node) {
+                found = Some(i);
+                if matches!(c.fill, Some((v, _)) if v == want) {
+                    break;
+                }
+            }
+        }
+        let taken = cached.remove(found?)?;
+        self.bytes.fetch_sub(capacity, Ordering::Relaxed);
+        Some(taken)
+    }
+
+    /// Cache a block, evicting the oldest ones beyond the limit
+    fn release(&self, block: Block, fill: Fill) {
+        let limit = self.limit.load(Ordering::Relaxed);
+        if block.capacity() > limit {
+            return;
+        }
+        let Ok(mut cached) = self.cached.lock() else {
+            return;
+        };
+        let mut bytes = self.bytes.load(Ordering::Relaxed) + block.capacity();
+        while bytes > limit {
+            match cached.pop_front() {
+                Some(old) => bytes -= old.block.capacity(),
+                None => break,
+            }
+        }
+        cached.push_back(Cached { block, fill });
+        self.bytes.store(bytes, Ordering::Relaxed);
+    }
+
+    fn clear(&self) {
+        if let Ok(mut cached) = self.cached.lock() {
+            cached.clear();
+            self.bytes.store(0, Ordering::Relaxed);
+        }
+    }
+}
+
+/// Caller-owned sample memory, never freed here
+struct Foreign {
+    ptr: NonNull<u8>,
+}
+
+// The caller hands the memory over for the pixmap's lifetime
+unsafe impl Send for Foreign {}
+unsafe impl Sync for Foreign {}
+
+enum Storage {
+    Heap(Vec<u8>),
+    Pooled(Block),
+    Foreign(Foreign),
+}
+
+/// Sample storage of a pixmap
+///
+/// Dereferences to the samples; mutable access forgets the known fill.
+pub struct Samples {
+    storage: Storage,
+    len: usize,
+    /// Byte the leading samples are known to hold, and how many
+    fill: Fill,
+    /// Set once a raw pointer has escaped, after which `fill` stays unknown
+    exposed: bool,
+    /// Held against the memory budgets entered when the samples were made
+    _charge: Option<Charge>,
+}
+
+impl Samples {
+    /// `len` samples, all `value`
+    pub fn filled(len: usize, value: u8) -> Self {
+        let Some(capacity) = size_class(len) else {
+            alloc_sampler::record(Subsystem::Pixmap, len);
+            return vec![value; len].into();
+        };
+        let pool = &*PIXMAP_POOL;
+        let node = if pool.numa.load(Ordering::Relaxed) {
+            current_numa_node()
+        } else {
+            None
+        };
+        if pool.limit.load(Ordering::Relaxed) > 0 {
+            if let Some(Cached { block, fill }) = pool.acquire(capacity, value, node) {
+                pool.hits.fetch_add(1, Ordering::Relaxed);
+                let mut samples = Self {
+                    storage: Storage::Pooled(block),
+                    len,
+                    fill,
+                    exposed: false,
+                    _charge: memory_budget::charge_scoped(len),
+                };
+                samples.fill_value(value);
+                return samples;
+            }
+        }
+        pool.misses.fetch_add(1, Ordering::Relaxed);
+        alloc_sampler::record(Subsystem::Pixmap, capacity);
+        let huge = match pool.huge_pages.load(Ordering::Relaxed) {
+            0 => HugePages::None,
+            FZ_PAGE_BUFFER_HUGETLB => HugePages::Explicit,
+            _ => HugePages::Transparent,
+        };
+        let Some(block) = Block::new(capacity, value == 0, Placement { huge, node }) else {
+            return vec![value; len].into();
+        };
+        let mut samples = Self {
+            storage: Storage::Pooled(block),
+            len,
+            fill: (value == 0).then_some((0, capacity)),
+            exposed: false,
+            _charge: memory_budget::charge_scoped(len),
+        };
+        samples.fill_value(value);
+        samples
+    }
+
+    /// `len` zero samples
+    pub fn zeroed(len: usize) -> Self {
+        Self::filled(len, 0)
+    }
+
+    /// Set every sample to `value`, unless they are known to hold it
+    pub fn fill_value(&mut self, value: u8) {
+        if self.fill_of() != Some(value) {
+            self.deref_mut().fill(value);
+            if !self.exposed {
+                self.fill = Some((value, self.len));
+            }
+        }
+    }
+
+    /// Byte every sample is known to hold
+    fn fill_of(&self) -> Option<u8> {
+        self.fill.filter(|&(_, n)| n >= self.len).map(|(v, _)| v)
+    }
+
+    /// Pointer to the samples for callers that keep it beyond this borrow
+    pub fn expose(&mut self) -> *mut u8 {
+        self.exposed = true;
+        self.as_mut_ptr()
+    }
+
+    /// Wrap `len` bytes of caller-owned memory
+    ///
+    /// The memory is never freed or recycled, and since the caller can
+    /// write to it at any time no fill is ever tracked for it.
+    ///
+    /// # Safety
+    /// `ptr` must be valid for reads and writes of `len` bytes, and stay
+    /// so, untouched by anything else while in use here, until the samples
+    /// are dropped.
+    pub unsafe fn foreign(ptr: *mut u8, len: usize) -> Option<Self> {
+        Some(Self {
+            storage: Storage::Foreign(Foreign {
+                ptr: NonNull::new(ptr)?,
+            }),
+            len,
+            fill: None,
+            exposed: true,
+            _charge: None,
+        })
+    }
+
+    /// Whether the samples live in caller-owned memory
+    pub fn is_foreign(&self) -> bool {
+        matches!(self.storage, Storage::Foreign(_))
+    }
+}
+
+impl From<Vec<u8>> for Samples {
+    fn from(data: Vec<u8>) -> Self {
+        Self {
+            len: data.len(),
+            _charge: memory_budget::charge_scoped(data.len()),
+            storage: Storage::Heap(data),
+            fill: None,
+            exposed: false,
+        }
+    }
+}
+
+impl Deref for Samples {
+    type Target = [u8];
+
+    fn deref(&self) -> &[u8] {
+        match &self.storage {
+            Storage::Heap(data) => data,
+            Storage::Pooled(block) => unsafe {
+                std::slice::from_raw_parts(block.as_ptr(), self.len)
+            },
+            Storage::Foreign(foreign) => unsafe {
+                std::slice::from_raw_parts(foreign.ptr.as_ptr(), self.len)
+            },
+        }
+    }
+}
+
+impl DerefMut for Samples {
+    fn deref_mut(&mut self) -> &mut [u8] {
+        self.fill = None;
+        match &mut self.storage {
+            Storage::Heap(data) => data,
+            Storage::Pooled(block) => unsafe {
+                std::slice::from_raw_parts_mut(block.as_ptr(), self.len)
+            },
+            Storage::Foreign(foreign) => unsafe {
+                std::slice::from_raw_parts_mut(foreign.ptr.as_ptr(), self.len)
+            },
+        }
+    }
+}
+
+impl Clone for Samples {
+    fn clone(&self) -> Self {
+        if size_class(self.len).is_none() {
+            return self.to_vec().into();
+        }
+        let fill = self.fill_of();
+        let mut copy = Self::filled(self.len, fill.unwrap_or(0));
+        if fill.is_none() {
+            copy.copy_from_slice(self);
+        }
+        copy
+    }
+}
+
+impl Drop for Samples {
+    fn drop(&mut self) {
+        if let Storage::Pooled(block) =
+            std::mem::replace(&mut self.storage, Storage::Heap(Vec::new()))
+        {
+            PIXMAP_POOL.release(block, self.fill);
+        }
+    }
+}
+
+// ============================================================================
+// FFI Functions
+// ============================================================================
+
+/// Drop every cached sample buffer
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_pixmap_pool_clear(_ctx: Handle) {
+    PIXMAP_POOL.clear();
+}
+
+/// Number of sample buffers waiting in the pool
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_pixmap_pool_count(_ctx: Handle) -> usize {
+    PIXMAP_POOL.cached.lock().map(|c| c.len()).unwrap_or(0)
+}
+
+/// Bytes held by the cached sample buffers
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_pixmap_pool_bytes(_ctx: Handle) -> usize {
+    PIXMAP_POOL.bytes.load(Ordering::Relaxed)
+}
+
+/// Pixmaps whose samples came from the pool
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_pixmap_pool_hits(_ctx: Handle) -> u64 {
+    PIXMAP_POOL.hits.load(Ordering::Relaxed)
+}
+
+/// Pooled-size pixmaps that needed a fresh allocation
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_pixmap_pool_misses(_ctx: Handle) -> u64 {
+    PIXMAP_POOL.misses.load(Ordering::Relaxed)
+}
+
+/// Get the most bytes the pool keeps
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_pixmap_pool_limit(_ctx: Handle) -> usize {
+    PIXMAP_POOL.limit.load(Ordering::Relaxed)
+}
+
+/// Set the most bytes the pool keeps, 0 to stop recycling
+///
+/// Cached buffers beyond a lowered limit are dropped at once.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_set_pixmap_pool_limit(_ctx: Handle, bytes: usize) {
+    PIXMAP_POOL.limit.store(bytes, Ordering::Relaxed);
+    if let Ok(mut cached) = PIXMAP_POOL.cached.lock() {
+        let mut held = PIXMAP_POOL.bytes.load(Ordering::Relaxed);
+        while held > bytes {
+            match cached.pop_front() {
+                Some(old) => held -= old.block.capacity(),
+                None => break,
+            }
+        }
+        PIXMAP_POOL.bytes.store(held, Ordering::Relaxed);
+    }
+}
+
+/// Back new buffers of 2 MiB and up with huge pages (Linux only; off by
+/// default)
+///
+/// `FZ_PAGE_BUFFER_HUGETLB` maps them from the reserved huge page pool,
+/// falling back to transparent huge pages when it is empty; any other
+/// non-zero value aligns them to, and advises them as, transparent huge
+/// pages.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_set_pixmap_pool_huge_pages(_ctx: Handle, enabled: i32) {
+    PIXMAP_POOL.huge_pages.store(enabled, Ordering::Relaxed);
+}
+
+/// Bind new buffers to the NUMA node of the thread allocating them, and
+/// recycle them only to threads on that node (Linux only; off by default)
+///
+/// Meant for render pools made with `FZ_RENDER_POOL_PIN_NODES`, whose
+/// workers each stay on one node.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_set_pixmap_pool_numa(_ctx: Handle, enabled: i32) {
+    PIXMAP_POOL.numa.store(enabled != 0, Ordering::Relaxed);
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_size_classes() {
+        assert_eq!(size_class(1000), None);
+        assert_eq!(size_class(64 * 1024), Some(64 * 1024));
+        assert_eq!(size_class(64 * 1024 + 1), Some(80 * 1024));
+        // A 612 x 792 RGB page rounds up by less than a quarter
+        let page = 612 * 792 * 3;
+        let class = size_class(page).unwrap();
+        assert!(class >= page && class < page + page / 4);
+        assert_eq!(class % PAGE_SIZE, 0);
+    }
+
+    #[test]
+    fn test_small_buffers_bypass_pool() {
+        let samples = Samples::filled(100, 7);
+        assert!(matches!(samples.storage, Storage::Heap(_)));
+        assert!(samples.iter().all(|&s| s == 7));
+    }
+
+    #[test]
+    fn test_recycled_buffer_is_refilled() {
+        // An odd size keeps this test's class clear of other tests
+        let len = 3 * 1024 * 1024 + 17;
+        let mut first = Samples::zeroed(len);
+        let ptr = first.as_ptr();
+        assert_eq!(ptr as usize % PAGE_SIZE, 0);
+        first[12345] = 9;
+        drop(first);
+
+        let again = Samples::zeroed(len);
+        assert_eq!(again.len(), len);
+        assert!(again.iter().all(|&s| s == 0));
+
+        let white = Samples::filled(len, 255);
+        assert!(white.iter().all(|&s| s == 255));
+    }
+
+    #[test]
+    fn test_blocks_recycle_within_their_node() {
+        let pool = PixmapPool {
+            cached: Mutex::new(VecDeque::new()),
+            bytes: AtomicUsize::new(0),
+            limit: AtomicUsize::new(FZ_PIXMAP_POOL_DEFAULT_LIMIT),
+            huge_pages: AtomicI32::new(0),
+            numa: AtomicBool::new(true),
+            hits: AtomicU64::new(0),
+            misses: AtomicU64::new(0),
+        };
+        let capacity = MIN_POOLED_SIZE;
+        let on = |node| {
+            let placement = Placement {
+                huge: HugePages::None,
+                node,
+            };
+            Block::new(capacity, true, placement).unwrap()
+        };
+        pool.release(on(Some(0)), None);
+        assert!(pool.acquire(capacity, 0, Some(1)).is_none());
+        assert!(pool.acquire(capacity, 0, Some(0)).is_some());
+
+        // Without a node any block will do
+        pool.release(on(Some(1)), None);
+        assert!(pool.acquire(capacity, 0, None).is_some());
+    }
+
+    #[test]
+    fn test_known_fill_is_kept() {
+        let len = 5 * 1024 * 1024 + 3;
+        let mut samples = Samples::filled(len, 255);
+        assert_eq!(samples.fill_of(), Some(255));
+        samples[0] = 1;
+        assert_eq!(samples.fill_of(), None);
+        samples.fill_value(255);
+        assert_eq!(samples.fill_of(), Some(255));
+
+        samples.expose();
+        samples.fill_value(0);
+        assert_eq!(samples.fill_of(), None);
+        assert!(samples.iter().all(|&s| s == 0));
+    }
+
+    #[test]
+    fn test_longer_reuse_fills_past_old_length() {
+        // Both lengths share the 7 MiB class
+        let long = 7 * 1024 * 1024 - 11;
+        drop(Samples::filled(long - 4096, 255));
+        let samples = Samples::filled(long, 255);
+        assert!(samples.iter().all(|&s| s == 255));
+    }
+
+    #[test]
+    fn test_foreign_memory_is_untracked() {
+        let mut memory = vec![3u8; 128 * 1024];
+        let mut samples = unsafe { Samples::foreign(memory.as_mut_ptr(), memory.len()) }.unwrap();
+        assert!(samples.is_foreign());
+        samples.fill_value(3);
+        samples[1] = 4;
+        let copy = samples.clone();
+        assert!(!copy.is_foreign());
+        assert_eq!(copy[1], 4);
+        drop(samples);
+        assert_eq!(memory[0], 3);
+        assert_eq!(memory[1], 4);
+    }
+
+    #[test]
+    fn test_clone_copies_samples() {
+        let mut samples = Samples::zeroed(200 * 1024);
+        samples[10] = 42;
+        let copy = samples.clone();
+        assert_eq!(copy[10], 42);
+        assert_eq!(&copy[..], &samples[..]);
+    }
+}
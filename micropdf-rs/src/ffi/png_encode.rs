@@ -0,0 +1,687 @@
+//! PNG Encoder with Vectorised Row Filters
+//!
+//! Encodes gray, gray+alpha, RGB and RGBA pixmaps. Rows are filtered
+//! sixteen bytes at a time (SSE2 or NEON) and deflated through flate2. An
+//! effort level from 0 to 9 trades size for speed: it is the deflate level,
+//! and from `ADAPTIVE_EFFORT` up every row also picks the filter whose
+//! output has the smallest sum of absolute values, as libpng does. Below
+//! that, rows use the Up filter, which suits rendered pages with long runs
+//! of repeated rows.
+//!
+//! Large images are split into bands of rows that deflate on separate
+//! threads. Every band but the last ends in a sync flush, so the raw
+//! deflate streams concatenate into one; the zlib header goes in front and
+//! the Adler-32 of the whole, combined from the per-band checksums, at the
+//! end. Filters reference the row above in the source pixmap, so bands
+//! filter exactly as a single-threaded encode would.
+
+// Allow unsafe operations inside unsafe functions (Rust 2024 edition compat)
+#![allow(unsafe_op_in_unsafe_fn)]
+
+use std::io::Write;
+
+use flate2::Compression;
+use flate2::write::DeflateEncoder;
+
+use super::dispatch::kernels;
+use super::pixmap::Pixmap;
+use super::render_pool::FZ_RENDER_POOL_MAX_THREADS;
+use super::simd_util::SimdLevel;
+
+/// Stored deflate blocks, unfiltered rows
+pub const FZ_PNG_EFFORT_STORE: i32 = 0;
+/// Fastest compressing effort
+pub const FZ_PNG_EFFORT_FAST: i32 = 1;
+/// Effort used by `fz_new_buffer_from_pixmap_as_png`
+pub const FZ_PNG_EFFORT_DEFAULT: i32 = 6;
+/// Smallest output
+pub const FZ_PNG_EFFORT_BEST: i32 = 9;
+
+/// Effort from which every row picks its own filter
+const ADAPTIVE_EFFORT: i32 = 4;
+
+/// Uncompressed bytes each band should at least hold
+const MIN_BAND_BYTES: usize = 256 * 1024;
+
+/// Largest IDAT chunk written
+const MAX_IDAT_BYTES: usize = 1 << 20;
+
+const PNG_SIGNATURE: [u8; 8] = [0x89, b'P', b'N', b'G', 0x0D, 0x0A, 0x1A, 0x0A];
+
+/// PNG row filter types
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+#[repr(u8)]
+pub(super) enum Filter {
+    None = 0,
+    Sub = 1,
+    Up = 2,
+    Average = 3,
+    Paeth = 4,
+}
+
+pub(super) const FILTERS: [Filter; 5] = [
+    Filter::None,
+    Filter::Sub,
+    Filter::Up,
+    Filter::Average,
+    Filter::Paeth,
+];
+
+/// Encode a pixmap as PNG
+///
+/// `effort` is clamped to 0-9; `threads` of 0 uses one per CPU. Returns an
+/// empty vector for pixmaps PNG cannot hold (CMYK, separations).
+pub(crate) fn encode(pix: &Pixmap, effort: i32, threads: i32) -> Vec<u8> {
+    let _span = super::trace::span(c"encode");
+    let n = pix.n();
+    let color_type = match (n, pix.has_alpha()) {
+        (1, false) => 0,
+        (2, true) => 4,
+        (3, false) => 2,
+        (4, true) => 6,
+        _ => return Vec::new(),
+    };
+    let (width, height) = (pix.w(), pix.h());
+    if width <= 0 || height <= 0 {
+        return Vec::new();
+    }
+    let effort = effort.clamp(FZ_PNG_EFFORT_STORE, FZ_PNG_EFFORT_BEST);
+    let bpp = n as usize;
+    let row_len = width as usize * bpp;
+    let stride = pix.stride() as usize;
+    let samples = pix.samples();
+    if stride < row_len || samples.len() < (height as usize - 1) * stride + row_len {
+        return Vec::new();
+    }
+    let rows = Rows {
+        samples,
+        stride,
+        row_len,
+        bpp,
+    };
+
+    let height = height as usize;
+    let bands = band_count(threads, height * (row_len + 1)).min(height);
+    let per_band = height.div_ceil(bands);
+    let mut encoded: Vec<(Vec<u8>, u32, usize)> = Vec::with_capacity(bands);
+    if bands == 1 {
+        encoded.push(deflate_rows(&rows, 0, height, effort, true));
+    } else {
+        std::thread::scope(|scope| {
+            let workers: Vec<_> = (0..bands)
+                .map(|band| {
+                    let y0 = band * per_band;
+                    let y1 = (y0 + per_band).min(height);
+                    let rows = &rows;
+                    scope.spawn(move || deflate_rows(rows, y0, y1, effort, y1 == height))
+                })
+                .collect();
+            for worker in workers {
+                encoded.push(worker.join().unwrap_or_default());
+            }
+        });
+    }
+    // Every stream holds at least a flush marker or a final block
+    if encoded.iter().any(|(data, _, _)| data.is_empty()) {
+        return Vec::new();
+    }
+
+    let deflated: usize = encoded.iter().map(|(data, _, _)| data.len()).sum();
+    let mut zlib = Vec::with_capacity(deflated + 6);
+    zlib.extend_from_slice(&zlib_header(effort));
+    let mut adler = 1;
+    for (data, band_adler, len) in &encoded {
+        zlib.extend_from_slice(data);
+        adler = adler32_combine(adler, *band_adler, *len);
+    }
+    zlib.extend_from_slice(&adler.to_be_bytes());
+
+    let mut ihdr = Vec::with_capacity(13);
+    ihdr.extend_from_slice(&(width as u32).to_be_bytes());
+    ihdr.extend_from_slice(&(height as u32).to_be_bytes());
+    ihdr.extend_from_slice(&[8, color_type, 0, 0, 0]);
+
+    let mut png = Vec::with_capacity(zlib.len() + 64);
+    png.extend_from_slice(&PNG_SIGNATURE);
+    write_chunk(&mut png, b"IHDR", &ihdr);
+    for idat in zlib.chunks(MAX_IDAT_BYTES) {
+        write_chunk(&mut png, b"IDAT", idat);
+    }
+    write_chunk(&mut png, b"IEND", &[]);
+    png
+}
+
+/// Rows of a pixmap as PNG scanlines
+struct Rows<'a> {
+    samples: &'a [u8],
+    stride: usize,
+    row_len: usize,
+    bpp: usize,
+}
+
+impl Rows<'_> {
+    fn row(&self, y: usize) -> &[u8] {
+        &self.samples[y * self.stride..y * self.stride + self.row_len]
+    }
+}
+
+/// Number of bands to deflate in parallel
+fn band_count(threads: i32, bytes: usize) -> usize {
+    let threads = if threads > 0 {
+        threads.min(FZ_RENDER_POOL_MAX_THREADS) as usize
+    } else {
+        std::thread::available_parallelism()
+            .map(|n| n.get())
+            .unwrap_or(1)
+            .min(FZ_RENDER_POOL_MAX_THREADS as usize)
+    };
+    threads.min(bytes / MIN_BAND_BYTES).max(1)
+}
+
+/// Filter and deflate rows `y0..y1` into a raw deflate stream
+///
+/// The stream ends in a final block when `last` is set and in a sync flush
+/// otherwise. Returns the stream, the Adler-32 of the filtered bytes and
+/// their length.
+fn deflate_rows(
+    rows: &Rows<'_>,
+    y0: usize,
+    y1: usize,
+    effort: i32,
+    last: bool,
+) -> (Vec<u8>, u32, usize) {
+    let row_len = rows.row_len;
+    let zero = vec![0u8; row_len];
+    let mut scratch = vec![vec![0u8; row_len]; FILTERS.len()];
+    let mut adler = Adler32::new();
+    let capacity = if effort == FZ_PNG_EFFORT_STORE {
+        (y1 - y0) * (row_len + 1) + (y1 - y0) / 64 + 16
+    } else {
+        (y1 - y0) * (row_len + 1) / 4 + 64
+    };
+    let mut encoder = DeflateEncoder::new(
+        Vec::with_capacity(capacity),
+        Compression::new(effort as u32),
+    );
+
+    for y in y0..y1 {
+        let row = rows.row(y);
+        let prior = if y > 0 { rows.row(y - 1) } else { &zero };
+        let (filter, out) = if effort == FZ_PNG_EFFORT_STORE {
+            (Filter::None, row)
+        } else if effort < ADAPTIVE_EFFORT {
+            filter_row(Filter::Up, row, prior, rows.bpp, &mut scratch[0]);
+            (Filter::Up, &scratch[0][..])
+        } else {
+            let mut best = (u64::MAX, 0);
+            for (k, &filter) in FILTERS.iter().enumerate() {
+                filter_row(filter, row, prior, rows.bpp, &mut scratch[k]);
+                let cost = row_cost(&scratch[k]);
+                if cost < best.0 {
+                    best = (cost, k);
+                }
+            }
+            (FILTERS[best.1], &scratch[best.1][..])
+        };
+        adler.update(&[filter as u8]);
+        adler.update(out);
+        if encoder.write_all(&[filter as u8]).is_err() || encoder.write_all(out).is_err() {
+            return Default::default();
+        }
+    }
+
+    let len = (y1 - y0) * (row_len + 1);
+    let data = if last {
+        encoder.finish().unwrap_or_default()
+    } else {
+        // Sync flush: byte-aligned and not final, so the next band's stream
+        // can follow directly
+        if encoder.flush().is_err() {
+            return Default::default();
+        }
+        std::mem::take(encoder.get_mut())
+    };
+    (data, adler.sum(), len)
+}
+
+fn zlib_header(effort: i32) -> [u8; 2] {
+    match effort {
+        0 | 1 => [0x78, 0x01],
+        2..=5 => [0x78, 0x5E],
+        6 => [0x78, 0x9C],
+        _ => [0x78, 0xDA],
+    }
+}
+
+fn write_chunk(output: &mut Vec<u8>, chunk_type: &[u8; 4], data: &[u8]) {
+    output.extend_from_slice(&(data.len() as u32).to_be_bytes());
+    output.extend_from_slice(chunk_type);
+    output.extend_from_slice(data);
+    let mut crc = flate2::Crc::new();
+    crc.update(chunk_type);
+    crc.update(data);
+    output.extend_from_slice(&crc.sum().to_be_bytes());
+}
+
+// ============================================================================
+// Adler-32
+// ============================================================================
+
+const ADLER_BASE: u32 = 65521;
+
+/// Bytes that can be summed before the 32-bit sums must be reduced
+const ADLER_NMAX: usize = 5552;
+
+struct Adler32 {
+    a: u32,
+    b: u32,
+}
+
+impl Adler32 {
+    fn new() -> Self {
+        Self { a: 1, b: 0 }
+    }
+
+    fn update(&mut self, data: &[u8]) {
+        for block in data.chunks(ADLER_NMAX) {
+            for &byte in block {
+                self.a += byte as u32;
+                self.b += self.a;
+            }
+            self.a %= ADLER_BASE;
+            self.b %= ADLER_BASE;
+        }
+    }
+
+    fn sum(&self) -> u32 {
+        (self.b << 16) | self.a
+    }
+}
+
+/// Adler-32 of two concatenated inputs, given the length of the second
+fn adler32_combine(adler1: u32, adler2: u32, len2: usize) -> u32 {
+    let rem = (len2 % ADLER_BASE as usize) as u32;
+    let mut a = adler1 & 0xFFFF;
+    let mut b = (rem * a) % ADLER_BASE;
+    a += (adler2 & 0xFFFF) + ADLER_BASE - 1;
+    b += (adler1 >> 16) + (adler2 >> 16) + ADLER_BASE - rem;
+    if a >= ADLER_BASE {
+        a -= ADLER_BASE;
+    }
+    if a >= ADLER_BASE {
+        a -= ADLER_BASE;
+    }
+    if b >= ADLER_BASE << 1 {
+        b -= ADLER_BASE << 1;
+    }
+    if b >= ADLER_BASE {
+        b -= ADLER_BASE;
+    }
+    (b << 16) | a
+}
+
+// ============================================================================
+// Row Filters
+// ============================================================================
+
+fn paeth(a: u8, b: u8, c: u8) -> u8 {
+    let p = a as i16 + b as i16 - c as i16;
+    let pa = (p - a as i16).abs();
+    let pb = (p - b as i16).abs();
+    let pc = (p - c as i16).abs();
+    if pa <= pb && pa <= pc {
+        a
+    } else if pb <= pc {
+        b
+    } else {
+        c
+    }
+}
+
+pub(super) fn predict(filter: Filter, a: u8, b: u8, c: u8) -> u8 {
+    match filter {
+        Filter::None => 0,
+        Filter::Sub => a,
+        Filter::Up => b,
+        Filter::Average => ((a as u16 + b as u16) >> 1) as u8,
+        Filter::Paeth => paeth(a, b, c),
+    }
+}
+
+/// Filter bytes `from..` of a row one at a time
+fn filter_scalar(
+    filter: Filter,
+    row: &[u8],
+    prior: &[u8],
+    bpp: usize,
+    out: &mut [u8],
+    from: usize,
+) {
+    for i in from..row.len() {
+        let (a, c) = if i >= bpp {
+            (row[i - bpp], prior[i - bpp])
+        } else {
+            (0, 0)
+        };
+        out[i] = row[i].wrapping_sub(predict(filter, a, prior[i], c));
+    }
+}
+
+/// Filter one row against the row above it (zeros for the first row)
+fn filter_row(filter: Filter, row: &[u8], prior: &[u8], bpp: usize, out: &mut [u8]) {
+    if filter == Filter::None {
+        out.copy_from_slice(row);
+        return;
+    }
+    let head = bpp.min(row.len());
+    filter_scalar(
+        filter,
+        &row[..head],
+        &prior[..head],
+        bpp,
+        &mut out[..head],
+        0,
+    );
+    let done = filter_vector(filter, row, prior, bpp, out);
+    filter_scalar(filter, row, prior, bpp, out, done);
+}
+
+/// Filter as many bytes from `bpp` on as the vector kernel covers,
+/// returning where it stopped
+fn filter_vector(filter: Filter, row: &[u8], prior: &[u8], bpp: usize, out: &mut [u8]) -> usize {
+    // The table only holds kernels the CPU runs
+    unsafe { (kernels().png_filter)(filter, row, prior, bpp, out) }
+}
+
+/// Sum of the filtered bytes taken as signed values
+fn row_cost(out: &[u8]) -> u64 {
+    unsafe { (kernels().png_cost)(out) }
+}
+
+/// Vector row filter, as held in the kernel dispatch table
+pub(super) type FilterFn = unsafe fn(Filter, &[u8], &[u8], usize, &mut [u8]) -> usize;
+
+/// Filtered-row cost, as held in the kernel dispatch table
+pub(super) type CostFn = unsafe fn(&[u8]) -> u64;
+
+/// Row filter the dispatch table uses at `level`
+pub(super) fn filter_kernel(level: SimdLevel) -> FilterFn {
+    match level {
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        SimdLevel::Sse2 | SimdLevel::Sse41 | SimdLevel::Avx | SimdLevel::Avx2 => sse2::filter,
+        #[cfg(target_arch = "aarch64")]
+        SimdLevel::Neon => neon::filter,
+        _ => filter_none,
+    }
+}
+
+/// Row cost the dispatch table uses at `level`
+pub(super) fn cost_kernel(level: SimdLevel) -> CostFn {
+    match level {
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        SimdLevel::Sse2 | SimdLevel::Sse41 | SimdLevel::Avx | SimdLevel::Avx2 => sse2::cost,
+        #[cfg(target_arch = "aarch64")]
+        SimdLevel::Neon => neon::cost,
+        _ => cost_scalar,
+    }
+}
+
+/// Vector filter for no vector unit: covers nothing past `bpp`
+fn filter_none(_: Filter, _: &[u8], _: &[u8], bpp: usize, _: &mut [u8]) -> usize {
+    bpp
+}
+
+fn cost_scalar(out: &[u8]) -> u64 {
+    out.iter().map(|&v| v.min(v.wrapping_neg()) as u64).sum()
+}
+
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+mod sse2 {
+    #[cfg(target_arch = "x86")]
+    use std::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use std::arch::x86_64::*;
+
+    use super::{Filter, cost_scalar};
+
+    #[inline(always)]
+    unsafe fn load(v: &[u8], i: usize) -> __m128i {
+        _mm_loadu_si128(v.as_ptr().add(i) as *const __m128i)
+    }
+
+    #[inline(always)]
+    unsafe fn select(mask: __m128i, then: __m128i, otherwise: __m128i) -> __m128i {
+        _mm_or_si128(_mm_and_si128(mask, then), _mm_andnot_si128(mask, otherwise))
+    }
+
+    #[inline(always)]
+    unsafe fn abs16(v: __m128i) -> __m128i {
+        _mm_max_epi16(v, _mm_sub_epi16(_mm_setzero_si128(), v))
+    }
+
+    /// Paeth predictor on eight 16-bit lanes
+    #[inline(always)]
+    unsafe fn paeth16(a: __m128i, b: __m128i, c: __m128i) -> __m128i {
+        let bc = _mm_sub_epi16(b, c);
+        let ac = _mm_sub_epi16(a, c);
+        let pa = abs16(bc);
+        let pb = abs16(ac);
+        let pc = abs16(_mm_add_epi16(ac, bc));
+        let not_a = _mm_or_si128(_mm_cmpgt_epi16(pa, pb), _mm_cmpgt_epi16(pa, pc));
+        let b_or_c = select(_mm_cmpgt_epi16(pb, pc), c, b);
+        select(not_a, b_or_c, a)
+    }
+
+    #[target_feature(enable = "sse2")]
+    pub(super) unsafe fn filter(
+        filter: Filter,
+        row: &[u8],
+        prior: &[u8],
+        bpp: usize,
+        out: &mut [u8],
+    ) -> usize {
+        let len = row.len();
+        let zero = _mm_setzero_si128();
+        let mut i = bpp;
+        while i + 16 <= len {
+            let x = load(row, i);
+            let pred = match filter {
+                Filter::None => zero,
+                Filter::Sub => load(row, i - bpp),
+                Filter::Up => load(prior, i),
+                Filter::Average => {
+                    // avg_epu8 rounds up; PNG rounds down
+                    let a = load(row, i - bpp);
+                    let b = load(prior, i);
+                    let odd = _mm_and_si128(_mm_xor_si128(a, b), _mm_set1_epi8(1));
+                    _mm_sub_epi8(_mm_avg_epu8(a, b), odd)
+                }
+                Filter::Paeth => {
+                    let a = load(row, i - bpp);
+                    let b = load(prior, i);
+                    let c = load(prior, i - bpp);
+                    let lo = paeth16(
+                        _mm_unpacklo_epi8(a, zero),
+                        _mm_unpacklo_epi8(b, zero),
+                        _mm_unpacklo_epi8(c, zero),
+                    );
+                    let hi = paeth16(
+                        _mm_unpackhi_epi8(a, zero),
+                        _mm_unpackhi_epi8(b, zero),
+                        _mm_unpackhi_epi8(c, zero),
+                    );
+                    _mm_packus_epi16(lo, hi)
+                }
+            };
+            _mm_storeu_si128(
+                out.as_mut_ptr().add(i) as *mut __m128i,
+                _mm_sub_epi8(x, pred),
+            );
+            i += 16;
+        }
+        i
+    }
+
+    #[target_feature(enable = "sse2")]
+    pub(super) unsafe fn cost(out: &[u8]) -> u64 {
+        let zero = _mm_setzero_si128();
+        let mut acc = zero;
+        let mut i = 0;
+        while i + 16 <= out.len() {
+            let v = load(out, i);
+            let abs = _mm_min_epu8(v, _mm_sub_epi8(zero, v));
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(abs, zero));
+            i += 16;
+        }
+        let mut sums = [0u64; 2];
+        _mm_storeu_si128(sums.as_mut_ptr() as *mut __m128i, acc);
+        sums[0] + sums[1] + cost_scalar(&out[i..])
+    }
+}
+
+#[cfg(target_arch = "aarch64")]
+mod neon {
+    use std::arch::aarch64::*;
+
+    use super::{Filter, cost_scalar};
+
+    #[target_feature(enable = "neon")]
+    pub(super) unsafe fn filter(
+        filter: Filter,
+        row: &[u8],
+        prior: &[u8],
+        bpp: usize,
+        out: &mut [u8],
+    ) -> usize {
+        let len = row.len();
+        let mut i = bpp;
+        while i + 16 <= len {
+            let x = vld1q_u8(row.as_ptr().add(i));
+            let pred = match filter {
+                Filter::None => vdupq_n_u8(0),
+                Filter::Sub => vld1q_u8(row.as_ptr().add(i - bpp)),
+                Filter::Up => vld1q_u8(prior.as_ptr().add(i)),
+                Filter::Average => vhaddq_u8(
+                    vld1q_u8(row.as_ptr().add(i - bpp)),
+                    vld1q_u8(prior.as_ptr().add(i)),
+                ),
+                Filter::Paeth => {
+                    let a = vld1q_u8(row.as_ptr().add(i - bpp));
+                    let b = vld1q_u8(prior.as_ptr().add(i));
+                    let c = vld1q_u8(prior.as_ptr().add(i - bpp));
+                    let pa = vabdq_u8(b, c);
+                    let pb = vabdq_u8(a, c);
+                    // |a + b - 2c| saturated to a byte; saturation cannot
+                    // change a comparison against pa or pb
+                    let pc_lo = vabsq_s16(vaddq_s16(
+                        vreinterpretq_s16_u16(vsubl_u8(vget_low_u8(a), vget_low_u8(c))),
+                        vreinterpretq_s16_u16(vsubl_u8(vget_low_u8(b), vget_low_u8(c))),
+                    ));
+                    let pc_hi = vabsq_s16(vaddq_s16(
+                        vreinterpretq_s16_u16(vsubl_high_u8(a, c)),
+                        vreinterpretq_s16_u16(vsubl_high_u8(b, c)),
+                    ));
+                    let pc = vcombine_u8(vqmovun_s16(pc_lo), vqmovun_s16(pc_hi));
+                    let not_a = vorrq_u8(vcgtq_u8(pa, pb), vcgtq_u8(pa, pc));
+                    let b_or_c = vbslq_u8(vcgtq_u8(pb, pc), c, b);
+                    vbslq_u8(not_a, b_or_c, a)
+                }
+            };
+            vst1q_u8(out.as_mut_ptr().add(i), vsubq_u8(x, pred));
+            i += 16;
+        }
+        i
+    }
+
+    #[target_feature(enable = "neon")]
+    pub(super) unsafe fn cost(out: &[u8]) -> u64 {
+        let mut acc = vdupq_n_u32(0);
+        let mut i = 0;
+        while i + 16 <= out.len() {
+            let v = vld1q_u8(out.as_ptr().add(i));
+            let abs = vminq_u8(v, vsubq_u8(vdupq_n_u8(0), v));
+            acc = vpadalq_u16(acc, vpaddlq_u8(abs));
+            i += 16;
+        }
+        vaddlvq_u32(acc) + cost_scalar(&out[i..])
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::colorspace::{
+        ColorspaceHandle, FZ_COLORSPACE_CMYK, FZ_COLORSPACE_GRAY, FZ_COLORSPACE_RGB,
+    };
+
+    fn pattern(cs: ColorspaceHandle, w: i32, h: i32, alpha: bool) -> Pixmap {
+        let mut pix = Pixmap::new(cs, w, h, alpha);
+        for (i, s) in pix.samples_mut().iter_mut().enumerate() {
+            *s = ((i * 7) ^ (i / 13)) as u8;
+        }
+        pix
+    }
+
+    fn decode(png: &[u8]) -> image::DynamicImage {
+        image::load_from_memory_with_format(png, image::ImageFormat::Png).unwrap()
+    }
+
+    #[test]
+    fn test_vector_filters_match_scalar() {
+        let bpp = 3;
+        let row: Vec<u8> = (0..100).map(|i| (i * 37 % 251) as u8).collect();
+        let prior: Vec<u8> = (0..100).map(|i| (i * 91 % 241) as u8).collect();
+        for filter in FILTERS {
+            let mut fast = vec![0u8; row.len()];
+            let mut slow = vec![0u8; row.len()];
+            filter_row(filter, &row, &prior, bpp, &mut fast);
+            filter_scalar(filter, &row, &prior, bpp, &mut slow, 0);
+            assert_eq!(fast, slow, "{filter:?}");
+            assert_eq!(row_cost(&fast), cost_scalar(&fast));
+        }
+    }
+
+    #[test]
+    fn test_round_trip_every_effort() {
+        let pix = pattern(FZ_COLORSPACE_RGB, 37, 23, true);
+        for effort in FZ_PNG_EFFORT_STORE..=FZ_PNG_EFFORT_BEST {
+            let png = encode(&pix, effort, 1);
+            assert_eq!(&png[..8], &PNG_SIGNATURE);
+            assert_eq!(
+                decode(&png).to_rgba8().as_raw(),
+                pix.samples(),
+                "effort {effort}"
+            );
+        }
+    }
+
+    #[test]
+    fn test_parallel_bands_decode_like_one() {
+        // Four bands of at least MIN_BAND_BYTES each
+        let pix = pattern(FZ_COLORSPACE_GRAY, 1024, 1100, false);
+        let serial = encode(&pix, FZ_PNG_EFFORT_FAST, 1);
+        let parallel = encode(&pix, FZ_PNG_EFFORT_FAST, 4);
+        assert_ne!(serial, parallel);
+        assert_eq!(decode(&parallel).to_luma8().as_raw(), pix.samples());
+        assert_eq!(decode(&serial).to_luma8().as_raw(), pix.samples());
+    }
+
+    #[test]
+    fn test_adler32_combine() {
+        let data: Vec<u8> = (0..20000).map(|i| (i % 253) as u8).collect();
+        let mut whole = Adler32::new();
+        whole.update(&data);
+        let (first, second) = data.split_at(7777);
+        let mut a = Adler32::new();
+        a.update(first);
+        let mut b = Adler32::new();
+        b.update(second);
+        assert_eq!(adler32_combine(a.sum(), b.sum(), second.len()), whole.sum());
+    }
+
+    #[test]
+    fn test_rejects_cmyk() {
+        let pix = Pixmap::new(FZ_COLORSPACE_CMYK, 4, 4, false);
+        assert!(encode(&pix, FZ_PNG_EFFORT_DEFAULT, 1).is_empty());
+    }
+}
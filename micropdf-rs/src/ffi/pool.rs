@@ -2,11 +2,16 @@
 //! Safe Rust implementation of fz_pool
 
 use super::{Handle, HandleStore};
+use std::cell::Cell;
 use std::sync::LazyLock;
+use std::sync::atomic::{AtomicBool, Ordering};
 
 /// Default block size for pool allocations
 const DEFAULT_BLOCK_SIZE: usize = 4096;
 
+/// Block size for per-thread render arenas
+const RENDER_ARENA_BLOCK_SIZE: usize = 64 * 1024;
+
 /// Memory block in a pool
 #[derive(Debug)]
 pub struct PoolBlock {
@@ -397,6 +402,150 @@ pub extern "C" fn fz_drop_pool(_ctx: Handle, pool: Handle) {
     POOLS.remove(pool);
 }
 
+// ============================================================================
+// Render Arenas
+// ============================================================================
+
+/// Whether page renders run inside a per-thread arena
+static RENDER_ARENA_ENABLED: AtomicBool = AtomicBool::new(true);
+
+/// This thread's render arena; the pool is released when the thread exits
+struct RenderArenaSlot {
+    pool: Cell<Handle>,
+    depth: Cell<u32>,
+}
+
+impl Drop for RenderArenaSlot {
+    fn drop(&mut self) {
+        let handle = self.pool.get();
+        if handle != 0 {
+            POOLS.remove(handle);
+        }
+    }
+}
+
+thread_local! {
+    static RENDER_ARENA: RenderArenaSlot = const {
+        RenderArenaSlot {
+            pool: Cell::new(0),
+            depth: Cell::new(0),
+        }
+    };
+}
+
+/// Handle of this thread's render arena pool, creating it on first use
+///
+/// Transient per-page allocations (path nodes, gstate copies, span
+/// buffers) can come from here and are discarded in one reset when the
+/// outermost [`RenderArenaScope`] ends. The pool is an ordinary entry in
+/// [`POOLS`], so `fz_pool_high_water` reports the per-page peak.
+pub fn render_arena() -> Handle {
+    RENDER_ARENA.with(|slot| {
+        let handle = slot.pool.get();
+        if handle != 0 && POOLS.get(handle).is_some() {
+            return handle;
+        }
+        let handle = POOLS.insert(Pool {
+            block_size: RENDER_ARENA_BLOCK_SIZE,
+            name: "render-arena".to_string(),
+            ..Default::default()
+        });
+        slot.pool.set(handle);
+        handle
+    })
+}
+
+/// Guard for one page render on the current thread
+///
+/// Scopes nest; only the outermost one resets the arena when dropped, so
+/// a page rendered from inside another render keeps its parent's memory.
+pub struct RenderArenaScope {
+    active: bool,
+}
+
+impl RenderArenaScope {
+    /// Enter a render on this thread (a no-op while arenas are disabled)
+    pub fn enter() -> Self {
+        if !render_arena_enabled() {
+            return Self { active: false };
+        }
+        RENDER_ARENA.with(|slot| slot.depth.set(slot.depth.get() + 1));
+        Self { active: true }
+    }
+}
+
+impl Drop for RenderArenaScope {
+    fn drop(&mut self) {
+        if !self.active {
+            return;
+        }
+        let outermost = RENDER_ARENA.with(|slot| {
+            let depth = slot.depth.get().saturating_sub(1);
+            slot.depth.set(depth);
+            depth == 0
+        });
+        if outermost {
+            end_render_arena();
+        }
+    }
+}
+
+/// Whether page renders run inside a per-thread arena
+pub fn render_arena_enabled() -> bool {
+    RENDER_ARENA_ENABLED.load(Ordering::Relaxed)
+}
+
+/// Discard everything the current page put in this thread's arena
+///
+/// Recycled draw-device buffers that grew past their retain limit are
+/// released at the same time.
+fn end_render_arena() {
+    if let Some(p) = POOLS.get(render_arena()) {
+        if let Ok(mut guard) = p.lock() {
+            guard.reset();
+        }
+    }
+    super::draw_device::trim_device_scratch();
+}
+
+/// Get this thread's render arena pool
+///
+/// Memory allocated from it with `fz_pool_alloc` stays valid until the
+/// current page render finishes.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_render_arena(_ctx: Handle) -> Handle {
+    render_arena()
+}
+
+/// Begin a render on this thread; pair with `fz_end_render_arena`
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_begin_render_arena(_ctx: Handle) {
+    std::mem::forget(RenderArenaScope::enter());
+}
+
+/// End a render begun with `fz_begin_render_arena`
+///
+/// The outermost call resets the arena.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_end_render_arena(_ctx: Handle) {
+    let open = RENDER_ARENA.with(|slot| slot.depth.get() > 0);
+    if open {
+        drop(RenderArenaScope { active: true });
+    }
+}
+
+/// Enable or disable per-thread render arenas and draw-device buffer reuse
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_set_render_arena_enabled(_ctx: Handle, enabled: i32) {
+    RENDER_ARENA_ENABLED.store(enabled != 0, Ordering::Relaxed);
+}
+
+/// Check whether per-thread render arenas are enabled
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_render_arena_enabled(_ctx: Handle) -> i32 {
+    i32::from(RENDER_ARENA_ENABLED.load(Ordering::Relaxed))
+}
+
 // ============================================================================
 // Tests
 // ============================================================================
@@ -522,6 +671,46 @@ mod tests {
         fz_drop_pool(0, pool);
     }
 
+    #[test]
+    fn test_render_arena_per_thread() {
+        let arena = fz_render_arena(0);
+        assert!(arena > 0);
+        assert_eq!(fz_render_arena(0), arena);
+
+        let other = std::thread::spawn(|| fz_render_arena(0)).join().unwrap();
+        assert_ne!(other, arena);
+        // The other thread's arena went away with it
+        assert!(POOLS.get(other).is_none());
+    }
+
+    #[test]
+    fn test_render_arena_resets_at_outermost_scope() {
+        let arena = fz_render_arena(0);
+        fz_pool_reset(0, arena);
+
+        {
+            let _page = RenderArenaScope::enter();
+            assert!(!fz_pool_alloc(0, arena, 1000).is_null());
+            {
+                let _nested = RenderArenaScope::enter();
+                assert!(!fz_pool_alloc(0, arena, 500).is_null());
+            }
+            // The nested render left the page's memory alone
+            assert!(fz_pool_used(0, arena) >= 1500);
+        }
+
+        assert_eq!(fz_pool_used(0, arena), 0);
+        assert!(fz_pool_high_water(0, arena) >= 1500);
+        assert!(fz_pool_allocated(0, arena) > 0);
+
+        fz_begin_render_arena(0);
+        assert!(!fz_pool_alloc(0, arena, 64).is_null());
+        fz_end_render_arena(0);
+        assert_eq!(fz_pool_used(0, arena), 0);
+        // Unbalanced ends are ignored
+        fz_end_render_arena(0);
+    }
+
     #[test]
     fn test_named_pool() {
         let name = c"test_pool";
@@ -0,0 +1,870 @@
+//! Byte-Range Document Source
+//!
+//! Loads a remote file through an asynchronous fetch callback, one block
+//! range at a time, so a document can be opened before the whole file has
+//! arrived. The host (an HTTP client doing range requests against object
+//! storage, say) is asked for ranges through the callback and hands the
+//! bytes back with `fz_range_source_supply`, from any thread.
+//!
+//! Requests are ordered by what is needed first. For a linearized file the
+//! first-page section goes first, so `fz_open_range_document` works once
+//! it is in; the hint stream's page offset table then lets
+//! `fz_range_source_request_page` move any page's bytes (and the main xref
+//! they need) to the front. Everything else streams in behind, front to
+//! back.
+
+use super::document::Document;
+use super::mmap::FileBytes;
+use super::pdf_xref_lazy::{Linearization, linearization, read_stream_at};
+use super::stream::Stream;
+use super::{DOCUMENTS, Handle, HandleStore, STREAMS};
+use std::collections::{HashMap, VecDeque};
+use std::ffi::c_void;
+use std::ops::Range;
+use std::sync::{Arc, LazyLock};
+
+/// Default block size: one request per 64 KiB
+const DEFAULT_BLOCK_SIZE: usize = 64 * 1024;
+/// Longest run of blocks merged into one request
+const MAX_RUN_BLOCKS: usize = 16;
+/// Requests kept in flight at once
+const MAX_INFLIGHT: usize = 4;
+/// Head of the file that must be in before linearization is checked
+const LINEARIZATION_HEAD: usize = 1024;
+/// Bytes before `/T` fetched with the main xref, for its `xref` keyword
+/// and subsection header
+const MAIN_XREF_LEAD: usize = 64;
+
+/// Ask the host for `len` bytes at `offset` of `source`
+///
+/// The host answers later (or right away) with `fz_range_source_supply`,
+/// or `fz_range_source_fail` to have the range retried.
+pub type RangeFetchFn = extern "C" fn(user: *mut c_void, source: Handle, offset: u64, len: u64);
+
+/// A file being loaded by byte ranges
+pub struct RangeSource {
+    /// File contents, zero where not yet loaded
+    data: Vec<u8>,
+    /// Whole file once every block is in; `data` is moved here
+    complete: Option<Arc<FileBytes>>,
+    block_size: usize,
+    loaded: Vec<bool>,
+    requested: Vec<bool>,
+    loaded_count: usize,
+    /// Requests in flight: offset -> length
+    inflight: HashMap<u64, u64>,
+    /// Block ranges wanted before the background fill, most urgent first
+    priority: VecDeque<Range<usize>>,
+    /// Next block of the front-to-back background fill
+    background: usize,
+    lin: Option<Linearization>,
+    /// Whether the head has been checked for linearization
+    lin_checked: bool,
+    /// Byte range of each page, from the hint stream
+    pages: Option<Vec<Range<usize>>>,
+    fetch: Option<RangeFetchFn>,
+    /// Host pointer passed back to `fetch`
+    user: usize,
+    /// Set while a thread is issuing requests; others leave it to that thread
+    pumping: bool,
+    repump: bool,
+}
+
+impl RangeSource {
+    pub fn new(file_len: usize, block_size: usize) -> Self {
+        let block_size = if block_size == 0 {
+            DEFAULT_BLOCK_SIZE
+        } else {
+            block_size
+        };
+        let blocks = file_len.div_ceil(block_size);
+        let head = LINEARIZATION_HEAD.min(file_len).div_ceil(block_size);
+        Self {
+            data: vec![0; file_len],
+            complete: None,
+            block_size,
+            loaded: vec![false; blocks],
+            requested: vec![false; blocks],
+            loaded_count: 0,
+            inflight: HashMap::new(),
+            // The linearization dict decides everything else
+            priority: VecDeque::from([0..head]),
+            background: 0,
+            lin: None,
+            lin_checked: false,
+            pages: None,
+            fetch: None,
+            user: 0,
+            pumping: false,
+            repump: false,
+        }
+    }
+
+    fn file_len(&self) -> usize {
+        self.complete.as_ref().map_or(self.data.len(), |c| c.len())
+    }
+
+    pub fn is_complete(&self) -> bool {
+        self.loaded_count == self.loaded.len()
+    }
+
+    /// Bytes loaded so far
+    pub fn loaded_bytes(&self) -> usize {
+        (0..self.loaded.len())
+            .filter(|&b| self.loaded[b])
+            .map(|b| self.block_range(b).len())
+            .sum()
+    }
+
+    /// Linearization parameters, once the first block is in
+    pub fn linearization(&self) -> Option<Linearization> {
+        self.lin
+    }
+
+    fn block_range(&self, block: usize) -> Range<usize> {
+        let start = block * self.block_size;
+        start..self.file_len().min(start + self.block_size)
+    }
+
+    fn blocks_of(&self, bytes: Range<usize>) -> Range<usize> {
+        let end = bytes.end.min(self.file_len());
+        if bytes.start >= end {
+            return 0..0;
+        }
+        bytes.start / self.block_size..end.div_ceil(self.block_size)
+    }
+
+    fn bytes_loaded(&self, bytes: Range<usize>) -> bool {
+        self.blocks_of(bytes).all(|b| self.loaded[b])
+    }
+
+    /// Whether the first page can be opened: its section for a linearized
+    /// file, the whole file otherwise
+    pub fn first_page_ready(&self) -> bool {
+        match self.lin {
+            Some(lin) => self.bytes_loaded(0..lin.first_page_end),
+            None => self.is_complete(),
+        }
+    }
+
+    /// Whether page `page`'s bytes (and for later pages, the main xref) are in
+    pub fn page_ready(&self, page: usize) -> bool {
+        if self.is_complete() {
+            return true;
+        }
+        if page == 0 {
+            return self.first_page_ready();
+        }
+        let (Some(lin), Some(pages)) = (self.lin, &self.pages) else {
+            return false;
+        };
+        // Later pages' objects are in the main xref, reached through the
+        // first-page section's trailer
+        pages.get(page).is_some_and(|r| {
+            self.first_page_ready()
+                && self.bytes_loaded(r.clone())
+                && self.bytes_loaded(main_xref(&lin))
+        })
+    }
+
+    /// Move page `page` to the front of the queue; false if the hint
+    /// stream hasn't given its location
+    pub fn request_page(&mut self, page: usize) -> bool {
+        if page == 0 {
+            return self.lin.is_some();
+        }
+        let (Some(lin), Some(range)) = (self.lin, self.pages.as_ref().and_then(|p| p.get(page)))
+        else {
+            return false;
+        };
+        let (page_blocks, xref_blocks) = (
+            self.blocks_of(range.clone()),
+            self.blocks_of(main_xref(&lin)),
+        );
+        self.priority.push_front(page_blocks);
+        self.priority.push_front(xref_blocks);
+        true
+    }
+
+    /// Take bytes from the host; returns false if they don't fit the file
+    pub fn supply(&mut self, offset: usize, bytes: &[u8]) -> bool {
+        let Some(end) = offset
+            .checked_add(bytes.len())
+            .filter(|&e| e <= self.file_len())
+        else {
+            return false;
+        };
+        if self.complete.is_some() {
+            return true;
+        }
+        self.data[offset..end].copy_from_slice(bytes);
+
+        for b in self.blocks_of(offset..end) {
+            let r = self.block_range(b);
+            if !self.loaded[b] && r.start >= offset && r.end <= end {
+                self.loaded[b] = true;
+                self.loaded_count += 1;
+            }
+        }
+        // A short answer leaves the rest of the request to be asked again
+        self.requeue(offset);
+        self.after_supply();
+        true
+    }
+
+    /// Forget an in-flight request so its blocks are asked for again
+    pub fn fail(&mut self, offset: usize) {
+        self.requeue(offset);
+    }
+
+    /// Retire the request at `offset`, putting blocks it didn't bring in
+    /// ahead of the background fill, which may already have passed them
+    fn requeue(&mut self, offset: usize) {
+        let Some(len) = self.inflight.remove(&(offset as u64)) else {
+            return;
+        };
+        let blocks = self.blocks_of(offset..offset + len as usize);
+        for b in blocks.clone() {
+            self.requested[b] = self.loaded[b];
+        }
+        if blocks.clone().any(|b| !self.loaded[b]) {
+            self.priority.push_front(blocks);
+        }
+    }
+
+    fn after_supply(&mut self) {
+        let head = 0..self.file_len().min(LINEARIZATION_HEAD);
+        if !self.lin_checked && self.bytes_loaded(head.clone()) {
+            self.lin_checked = true;
+            self.lin = linearization(&self.data[head]).filter(|l| l.file_len == self.data.len());
+            match self.lin {
+                Some(lin) => {
+                    let hint = lin.hint_offset..lin.hint_offset + lin.hint_len;
+                    let first = self.blocks_of(0..lin.first_page_end);
+                    self.priority.push_back(first);
+                    self.priority.push_back(self.blocks_of(hint));
+                }
+                // Not linearized: the trailer and xref at the end come first
+                None => {
+                    let tail = self.loaded.len().saturating_sub(1);
+                    self.priority.push_back(tail..self.loaded.len());
+                }
+            }
+        }
+        if let (Some(lin), None) = (self.lin, &self.pages) {
+            if self.bytes_loaded(lin.hint_offset..lin.hint_offset + lin.hint_len) {
+                self.pages = read_stream_at(&self.data, lin.hint_offset)
+                    .and_then(|(_, hints)| page_ranges(&lin, &hints));
+            }
+        }
+        if self.is_complete() {
+            let data = std::mem::take(&mut self.data);
+            self.complete = Some(Arc::new(FileBytes::from(data)));
+        }
+    }
+
+    /// Next run of unloaded, unrequested blocks, most urgent first
+    fn next_run(&mut self) -> Option<Range<usize>> {
+        let (loaded, requested) = (&self.loaded, &self.requested);
+        let free = |b: usize| !loaded[b] && !requested[b];
+        // Longest free run from `start`, capped at MAX_RUN_BLOCKS
+        let run = |start: usize, end: usize| {
+            let limit = end.min(start + MAX_RUN_BLOCKS);
+            start..(start..limit).find(|&b| !free(b)).unwrap_or(limit)
+        };
+
+        while let Some(range) = self.priority.front_mut() {
+            while range.start < range.end && !free(range.start) {
+                range.start += 1;
+            }
+            if range.start < range.end {
+                let next = run(range.start, range.end);
+                range.start = next.end;
+                return Some(next);
+            }
+            self.priority.pop_front();
+        }
+        while self.background < loaded.len() && !free(self.background) {
+            self.background += 1;
+        }
+        if self.background == loaded.len() {
+            return None;
+        }
+        let next = run(self.background, loaded.len());
+        self.background = next.end;
+        Some(next)
+    }
+
+    /// Requests to issue now, as (offset, length)
+    fn next_requests(&mut self) -> Vec<(u64, u64)> {
+        let mut out = Vec::new();
+        while self.inflight.len() < MAX_INFLIGHT {
+            let Some(blocks) = self.next_run() else {
+                break;
+            };
+            for b in blocks.clone() {
+                self.requested[b] = true;
+            }
+            let bytes = self.block_range(blocks.start).start..self.block_range(blocks.end - 1).end;
+            let (offset, len) = (bytes.start as u64, bytes.len() as u64);
+            self.inflight.insert(offset, len);
+            out.push((offset, len));
+        }
+        out
+    }
+
+    /// Bytes of a document over what has loaded so far
+    ///
+    /// Shared once the file is complete; before that, a snapshot with
+    /// zeros where blocks are still missing.
+    fn document_bytes(&self) -> Arc<FileBytes> {
+        match &self.complete {
+            Some(data) => Arc::clone(data),
+            None => Arc::new(FileBytes::from(self.data.clone())),
+        }
+    }
+}
+
+/// Main xref table of a linearized file, to the end of the file
+fn main_xref(lin: &Linearization) -> Range<usize> {
+    lin.main_xref.saturating_sub(MAIN_XREF_LEAD)..lin.file_len
+}
+
+/// Big-endian bit reader for hint tables
+struct BitReader<'a> {
+    data: &'a [u8],
+    bit: usize,
+}
+
+impl BitReader<'_> {
+    fn read(&mut self, bits: u32) -> Option<u64> {
+        let mut v = 0u64;
+        for _ in 0..bits.min(64) {
+            let byte = *self.data.get(self.bit / 8)?;
+            v = (v << 1) | u64::from((byte >> (7 - self.bit % 8)) & 1);
+            self.bit += 1;
+        }
+        Some(v)
+    }
+
+    /// Skip to the next byte boundary
+    fn sync(&mut self) {
+        self.bit = self.bit.div_ceil(8) * 8;
+    }
+}
+
+/// Byte range of each page from the page offset hint table
+/// (ISO 32000-1, F.4.1)
+///
+/// Hint table offsets are written as if the hint stream were absent, so
+/// ranges past it are shifted by its length.
+pub(crate) fn page_ranges(lin: &Linearization, hints: &[u8]) -> Option<Vec<Range<usize>>> {
+    let pages = usize::try_from(lin.page_count).ok().filter(|&n| n > 0)?;
+    let mut r = BitReader {
+        data: hints,
+        bit: 0,
+    };
+    let _least_objects = r.read(32)?;
+    let first_page_offset = r.read(32)? as usize;
+    let object_bits = r.read(16)? as u32;
+    let least_length = r.read(32)? as usize;
+    let length_bits = r.read(16)? as u32;
+    // Content stream and shared object items aren't needed for ranges
+    for bits in [32, 16, 32, 16, 16, 16, 16, 16] {
+        r.read(bits)?;
+    }
+
+    for _ in 0..pages {
+        r.read(object_bits)?;
+    }
+    r.sync();
+
+    let shift = |at: usize| {
+        if at >= lin.hint_offset {
+            at + lin.hint_len
+        } else {
+            at
+        }
+    };
+    // The first page is its whole section; later pages follow each other
+    let mut ranges = vec![0..lin.first_page_end];
+    let mut at = first_page_offset;
+    for page in 0..pages {
+        let len = least_length + r.read(length_bits)? as usize;
+        if page > 0 {
+            let start = shift(at);
+            // A hint stream in the middle of a page's objects
+            let end = if start < lin.hint_offset && at + len > lin.hint_offset {
+                at + len + lin.hint_len
+            } else {
+                shift(at + len)
+            };
+            ranges.push(start..end.min(lin.file_len));
+        }
+        at += len;
+    }
+    Some(ranges)
+}
+
+// ============================================================================
+// Handle Store
+// ============================================================================
+
+pub static RANGE_SOURCES: LazyLock<HandleStore<RangeSource>> = LazyLock::new(HandleStore::new);
+
+/// Issue whatever requests a source has room for
+///
+/// The callback runs without the source locked, so hosts may supply
+/// synchronously from inside it. A thread that finds another one already
+/// issuing requests leaves the new ones to it, which keeps synchronous
+/// hosts from recursing once per block.
+fn pump(source: Handle) {
+    let Some(src) = RANGE_SOURCES.get(source) else {
+        return;
+    };
+    let (fetch, user, mut requests) = {
+        let mut s = src.lock().unwrap();
+        if s.pumping {
+            s.repump = true;
+            return;
+        }
+        let Some(fetch) = s.fetch else {
+            return;
+        };
+        s.pumping = true;
+        (fetch, s.user, s.next_requests())
+    };
+    loop {
+        for (offset, len) in requests {
+            fetch(user as *mut c_void, source, offset, len);
+        }
+        let mut s = src.lock().unwrap();
+        if !s.repump {
+            s.pumping = false;
+            return;
+        }
+        s.repump = false;
+        requests = s.next_requests();
+    }
+}
+
+// ============================================================================
+// FFI Functions
+// ============================================================================
+
+/// Create a source for a file of `file_len` bytes fetched through `fetch`
+///
+/// `block_size` of 0 uses 64 KiB blocks. The first requests are issued
+/// before this returns.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_range_source(
+    _ctx: Handle,
+    file_len: u64,
+    block_size: usize,
+    fetch: Option<RangeFetchFn>,
+    user: *mut c_void,
+) -> Handle {
+    let Ok(file_len) = usize::try_from(file_len) else {
+        return 0;
+    };
+    let mut src = RangeSource::new(file_len, block_size);
+    src.fetch = fetch;
+    src.user = user as usize;
+    let handle = RANGE_SOURCES.insert(src);
+    pump(handle);
+    handle
+}
+
+/// Drop a range source
+///
+/// Answers to requests still in flight are ignored.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_drop_range_source(_ctx: Handle, source: Handle) {
+    let _ = RANGE_SOURCES.remove(source);
+}
+
+/// Hand the bytes of a requested range to the source
+///
+/// Callable from any thread. Returns 1 on success, 0 if the range is
+/// outside the file or the source is gone.
+///
+/// # Safety
+/// Caller must ensure `data` points to `len` readable bytes.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_range_source_supply(
+    _ctx: Handle,
+    source: Handle,
+    offset: u64,
+    data: *const u8,
+    len: usize,
+) -> i32 {
+    if data.is_null() && len > 0 {
+        return 0;
+    }
+    let Some(src) = RANGE_SOURCES.get(source) else {
+        return 0;
+    };
+    let bytes = if len == 0 {
+        &[][..]
+    } else {
+        // SAFETY: Caller guarantees data points to len readable bytes
+        unsafe { std::slice::from_raw_parts(data, len) }
+    };
+    let ok = usize::try_from(offset).is_ok_and(|o| src.lock().unwrap().supply(o, bytes));
+    drop(src);
+    pump(source);
+    i32::from(ok)
+}
+
+/// Report that a requested range couldn't be fetched; it is asked for again
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_range_source_fail(_ctx: Handle, source: Handle, offset: u64) {
+    if let Some(src) = RANGE_SOURCES.get(source) {
+        if let Ok(offset) = usize::try_from(offset) {
+            src.lock().unwrap().fail(offset);
+        }
+    }
+    pump(source);
+}
+
+/// Fetch a page's bytes ahead of everything else
+///
+/// Returns 1 if the page's location is known (from the hint stream of a
+/// linearized file), 0 otherwise.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_range_source_request_page(_ctx: Handle, source: Handle, page: i32) -> i32 {
+    let Ok(page) = usize::try_from(page) else {
+        return 0;
+    };
+    let ok = RANGE_SOURCES
+        .get(source)
+        .is_some_and(|s| s.lock().unwrap().request_page(page));
+    pump(source);
+    i32::from(ok)
+}
+
+/// Check whether a page's bytes have all arrived
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_range_source_page_ready(_ctx: Handle, source: Handle, page: i32) -> i32 {
+    let Ok(page) = usize::try_from(page) else {
+        return 0;
+    };
+    RANGE_SOURCES
+        .get(source)
+        .map_or(0, |s| i32::from(s.lock().unwrap().page_ready(page)))
+}
+
+/// Check whether the whole file has arrived
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_range_source_is_complete(_ctx: Handle, source: Handle) -> i32 {
+    RANGE_SOURCES
+        .get(source)
+        .map_or(0, |s| i32::from(s.lock().unwrap().is_complete()))
+}
+
+/// Number of bytes loaded so far
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_range_source_loaded(_ctx: Handle, source: Handle) -> u64 {
+    RANGE_SOURCES
+        .get(source)
+        .map_or(0, |s| s.lock().unwrap().loaded_bytes() as u64)
+}
+
+/// Check whether the file is linearized; 0 until the first block is in
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_range_source_is_linearized(_ctx: Handle, source: Handle) -> i32 {
+    RANGE_SOURCES.get(source).map_or(0, |s| {
+        i32::from(s.lock().unwrap().linearization().is_some())
+    })
+}
+
+/// Open a document over what has loaded so far
+///
+/// Works once the first page is ready; returns 0 before that (try again
+/// later). Until the file is complete the document is a snapshot, with
+/// later pages readable once `fz_range_source_page_ready` says so and the
+/// document is reopened.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_open_range_document(_ctx: Handle, source: Handle) -> Handle {
+    let Some(src) = RANGE_SOURCES.get(source) else {
+        return 0;
+    };
+    let s = src.lock().unwrap();
+    if !s.first_page_ready() {
+        return 0;
+    }
+    let mut doc = Document::from_bytes(s.document_bytes());
+    // Counting page objects in a partial file undercounts
+    if let Some(lin) = s.linearization() {
+        doc.set_page_count(lin.page_count);
+    }
+    DOCUMENTS.insert(doc)
+}
+
+/// Open a stream over the whole file once it has arrived; 0 before that
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_open_range_stream(_ctx: Handle, source: Handle) -> Handle {
+    let Some(src) = RANGE_SOURCES.get(source) else {
+        return 0;
+    };
+    let bytes = src.lock().unwrap().complete.clone();
+    match bytes {
+        Some(bytes) => STREAMS.insert(Stream::from_bytes(bytes)),
+        None => 0,
+    }
+}
+
+// ============================================================================
+// Tests
+// ============================================================================
+
+#[cfg(test)]
+mod tests {
+    use super::super::document::fz_count_pages;
+    use super::super::pdf_xref::{pdf_cache_object, pdf_drop_xref};
+    use super::super::pdf_xref_lazy::pdf_open_xref_lazy;
+    use super::*;
+    use std::sync::Mutex;
+
+    /// Two-page linearized file: first-page section with a hint stream,
+    /// the second page, filler, then the main xref
+    fn linearized_pdf() -> (Vec<u8>, Linearization) {
+        // Fixed-width numbers so the dict can be filled in after layout
+        let num = |v: usize| format!("{v:010}");
+        let lin_dict = |l: usize, h: (usize, usize), e: usize, t: usize| {
+            format!(
+                "8 0 obj\n<< /Linearized 1 /L {} /H [{} {}] /O 3 /E {} /N 2 /T {} >>\nendobj\n",
+                num(l),
+                num(h.0),
+                num(h.1),
+                num(e),
+                num(t)
+            )
+        };
+
+        let mut pdf = b"%PDF-1.7\n".to_vec();
+        let lin_at = pdf.len();
+        pdf.extend_from_slice(lin_dict(0, (0, 0), 0, 0).as_bytes());
+        let first_xref_at = pdf.len();
+        // Filled in after layout, also fixed-width
+        let first_xref = |offs: &[usize], main: usize| {
+            let mut s = String::from("xref\n1 5\n");
+            for o in &offs[1..6] {
+                s += &format!("{o:010} 00000 n \n");
+            }
+            s += &format!("8 1\n{:010} 00000 n \n", offs[8]);
+            s += &format!("trailer\n<< /Size 10 /Root 1 0 R /Prev {} >>\n", num(main));
+            s
+        };
+        let mut offs = vec![0usize; 10];
+        offs[8] = lin_at;
+        pdf.extend_from_slice(first_xref(&offs, 0).as_bytes());
+
+        let mut obj = |pdf: &mut Vec<u8>, offs: &mut Vec<usize>, n: usize, body: &[u8]| {
+            offs[n] = pdf.len();
+            pdf.extend_from_slice(format!("{n} 0 obj\n").as_bytes());
+            pdf.extend_from_slice(body);
+            pdf.extend_from_slice(b"\nendobj\n");
+        };
+        obj(&mut pdf, &mut offs, 1, b"<< /Type /Catalog /Pages 2 0 R >>");
+        obj(
+            &mut pdf,
+            &mut offs,
+            2,
+            b"<< /Type /Pages /Kids [3 0 R 6 0 R] /Count 2 >>",
+        );
+        obj(
+            &mut pdf,
+            &mut offs,
+            3,
+            b"<< /Type /Page /Parent 2 0 R /Contents 4 0 R >>",
+        );
+        obj(
+            &mut pdf,
+            &mut offs,
+            4,
+            b"<< /Length 5 >>\nstream\nBT ET\nendstream",
+        );
+        let hint_at = pdf.len();
+        // Page offset hint table, sizes filled in below (fixed length)
+        obj(&mut pdf, &mut offs, 5, &[b'X'; 96]);
+        let first_end = pdf.len();
+        obj(
+            &mut pdf,
+            &mut offs,
+            6,
+            b"<< /Type /Page /Parent 2 0 R /Contents 7 0 R >>",
+        );
+        obj(
+            &mut pdf,
+            &mut offs,
+            7,
+            b"<< /Length 7 >>\nstream\n0 0 m S\nendstream",
+        );
+        let page1_end = pdf.len();
+        obj(&mut pdf, &mut offs, 9, &[b' '; 3000]);
+        let main_at = pdf.len();
+        pdf.extend_from_slice(
+            format!(
+                "xref\n0 1\n0000000000 65535 f \n6 2\n{:010} 00000 n \n{:010} 00000 n \n9 1\n{:010} 00000 n \ntrailer\n<< /Size 10 /Root 1 0 R >>\nstartxref\n{first_xref_at}\n%%EOF\n",
+                offs[6], offs[7], offs[9]
+            )
+            .as_bytes(),
+        );
+
+        // Hint stream: lengths are measured as if it weren't there
+        let hint_len = first_end - hint_at;
+        let page0_len = hint_at - offs[3];
+        let page1_len = page1_end - first_end;
+        let least = page0_len.min(page1_len);
+        let mut table = Vec::new();
+        table.extend_from_slice(&2u32.to_be_bytes());
+        table.extend_from_slice(&(offs[3] as u32).to_be_bytes());
+        table.extend_from_slice(&0u16.to_be_bytes());
+        table.extend_from_slice(&(least as u32).to_be_bytes());
+        table.extend_from_slice(&16u16.to_be_bytes());
+        table.extend_from_slice(&[0; 20]);
+        table.extend_from_slice(&((page0_len - least) as u16).to_be_bytes());
+        table.extend_from_slice(&((page1_len - least) as u16).to_be_bytes());
+        let mut body = format!("<< /Length {} /S 0 >>\nstream\n", table.len()).into_bytes();
+        body.extend_from_slice(&table);
+        body.extend_from_slice(b"\nendstream");
+        body.resize(96, b'\n');
+        let hint_obj = [b"5 0 obj\n".as_slice(), &body, b"\nendobj\n"].concat();
+        pdf[hint_at..first_end].copy_from_slice(&hint_obj);
+
+        let dict = lin_dict(pdf.len(), (hint_at, hint_len), first_end, main_at);
+        pdf[lin_at..lin_at + dict.len()].copy_from_slice(dict.as_bytes());
+        let xref = first_xref(&offs, main_at);
+        pdf[first_xref_at..first_xref_at + xref.len()].copy_from_slice(xref.as_bytes());
+
+        let lin = linearization(&pdf).unwrap();
+        (pdf, lin)
+    }
+
+    /// Requests recorded by the test host
+    type Requests = Mutex<VecDeque<(u64, u64)>>;
+
+    extern "C" fn record(user: *mut c_void, _source: Handle, offset: u64, len: u64) {
+        let requests = unsafe { &*(user as *const Requests) };
+        requests.lock().unwrap().push_back((offset, len));
+    }
+
+    fn serve_one(source: Handle, pdf: &[u8], requests: &Requests) -> bool {
+        let Some((offset, len)) = requests.lock().unwrap().pop_front() else {
+            return false;
+        };
+        let bytes = &pdf[offset as usize..(offset + len) as usize];
+        assert_eq!(
+            fz_range_source_supply(0, source, offset, bytes.as_ptr(), bytes.len()),
+            1
+        );
+        true
+    }
+
+    #[test]
+    fn test_linearization_dict() {
+        let (pdf, lin) = linearized_pdf();
+        assert_eq!(lin.file_len, pdf.len());
+        assert_eq!(lin.page_count, 2);
+        assert_eq!(lin.first_page_obj, 3);
+        assert!(pdf[lin.first_section..].starts_with(b"xref"));
+        assert!(linearization(b"%PDF-1.4\n1 0 obj\n<< /Type /Catalog >>\nendobj\n").is_none());
+    }
+
+    #[test]
+    fn test_hint_table_page_ranges() {
+        let (pdf, lin) = linearized_pdf();
+        let (_, hints) = read_stream_at(&pdf, lin.hint_offset).unwrap();
+        let pages = page_ranges(&lin, &hints).unwrap();
+        assert_eq!(pages.len(), 2);
+        assert_eq!(pages[0], 0..lin.first_page_end);
+        // Page 2 starts right after the first-page section
+        assert!(pdf[pages[1].clone()].starts_with(b"6 0 obj"));
+        assert!(pdf[..pages[1].end].ends_with(b"endstream\nendobj\n"));
+    }
+
+    #[test]
+    fn test_first_page_before_whole_file() {
+        let (pdf, lin) = linearized_pdf();
+        let requests = Requests::default();
+        let user = &requests as *const Requests as *mut c_void;
+        // Small blocks, so the requests in flight cover less than the file
+        let source = fz_new_range_source(0, pdf.len() as u64, 16, Some(record), user);
+        assert_ne!(source, 0);
+        // The linearization dict's blocks are asked for first
+        assert_eq!(requests.lock().unwrap().len(), MAX_INFLIGHT);
+        assert_eq!(requests.lock().unwrap()[0], (0, 16 * MAX_RUN_BLOCKS as u64));
+        assert_eq!(fz_open_range_document(0, source), 0);
+
+        while fz_range_source_page_ready(0, source, 0) == 0 {
+            assert!(serve_one(source, &pdf, &requests));
+        }
+        assert_eq!(fz_range_source_is_linearized(0, source), 1);
+        assert_eq!(fz_range_source_is_complete(0, source), 0);
+        let loaded = fz_range_source_loaded(0, source) as usize;
+        assert!(loaded < pdf.len() && loaded >= lin.first_page_end);
+
+        // The first page loads from the partial file
+        let doc = fz_open_range_document(0, source);
+        assert_eq!(fz_count_pages(0, doc), 2);
+        let xref = pdf_open_xref_lazy(0, doc);
+        assert_ne!(xref, 0);
+        assert_eq!(pdf_cache_object(0, xref, 4), 1);
+        pdf_drop_xref(0, xref);
+        super::super::document::fz_drop_document(0, doc);
+
+        // Page 2 jumps the queue ahead of the filler object
+        assert_eq!(fz_range_source_request_page(0, source, 1), 1);
+        while fz_range_source_page_ready(0, source, 1) == 0 {
+            assert!(serve_one(source, &pdf, &requests));
+        }
+        assert_eq!(fz_range_source_is_complete(0, source), 0);
+        assert_eq!(fz_open_range_stream(0, source), 0);
+
+        while serve_one(source, &pdf, &requests) {}
+        assert_eq!(fz_range_source_is_complete(0, source), 1);
+        let stm = fz_open_range_stream(0, source);
+        let data = STREAMS.get(stm).unwrap().lock().unwrap().data.clone();
+        assert_eq!(&data[..], &pdf[..]);
+        STREAMS.remove(stm);
+        fz_drop_range_source(0, source);
+    }
+
+    #[test]
+    fn test_lost_and_short_ranges_are_retried() {
+        let pdf =
+            b"%PDF-1.4\n1 0 obj\n<< /Type /Catalog >>\nendobj\ntrailer\n<< /Root 1 0 R >>\n%%EOF\n"
+                .repeat(20);
+        let requests = Requests::default();
+        let user = &requests as *const Requests as *mut c_void;
+        let source = fz_new_range_source(0, pdf.len() as u64, 100, Some(record), user);
+
+        let (offset, len) = requests.lock().unwrap().pop_front().unwrap();
+        fz_range_source_fail(0, source, offset);
+        // Half an answer: the rest of the range is asked for again
+        let (offset, len) = loop {
+            let next = requests.lock().unwrap().pop_front().unwrap();
+            if next.0 == offset {
+                assert_eq!(next.1, len);
+                break next;
+            }
+            requests.lock().unwrap().push_back(next);
+        };
+        let half = &pdf[offset as usize..(offset + len / 2) as usize];
+        fz_range_source_supply(0, source, offset, half.as_ptr(), half.len());
+
+        while serve_one(source, &pdf, &requests) {}
+        assert_eq!(fz_range_source_is_complete(0, source), 1);
+        assert_eq!(fz_range_source_is_linearized(0, source), 0);
+        assert_eq!(fz_range_source_page_ready(0, source, 0), 1);
+        assert_eq!(fz_range_source_request_page(0, source, 1), 0);
+        let doc = fz_open_range_document(0, source);
+        assert_ne!(doc, 0);
+        super::super::document::fz_drop_document(0, doc);
+        fz_drop_range_source(0, source);
+
+        let bytes = b"x";
+        assert_eq!(fz_range_source_supply(0, source, 0, bytes.as_ptr(), 1), 0);
+    }
+}
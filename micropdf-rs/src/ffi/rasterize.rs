@@ -0,0 +1,934 @@
+//! Scan conversion for the draw device
+//!
+//! Paths are flattened (and strokes expanded) into device-space edges, and
+//! each pixel row turned into 8-bit coverage from an S×S grid of samples,
+//! where S follows the anti-aliasing level. Two rasterizers read the same
+//! crossings:
+//!
+//! - [`Rasterizer::Supersample`] counts every covered sample one by one,
+//!   S² of them per pixel.
+//! - [`Rasterizer::SparseScanline`] resolves each span of samples straight
+//!   into a per-pixel accumulation buffer: the pixels at its ends take the
+//!   partial count and the pixels between a single running-sum delta. Rows
+//!   and runs with nothing in them are never visited.
+//!
+//! Both count exactly the same samples, so their output is identical at
+//! every level; the sparse one just does a constant amount of work per span
+//! instead of per sample.
+//!
+//! Edge lists worth keeping are cached in the resource store keyed by the
+//! path, the linear part of the CTM and the stroke style, so repeated
+//! symbols are flattened and stroked once and replayed with a translation.
+
+use super::draw_device::{AntiAliasLevel, GraphicsState, PathOp};
+use super::store::{StoreType, store_find_and_keep, store_owned_item};
+use super::{Handle, HandleStore};
+use crate::fitz::counters::{self, Counter};
+use std::sync::LazyLock;
+
+/// Coverage rasterizer used by a draw device
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Default)]
+pub enum Rasterizer {
+    /// Count every sample of the anti-aliasing grid
+    #[default]
+    Supersample = 0,
+    /// Per-span coverage into a sparse accumulation buffer
+    SparseScanline = 1,
+}
+
+impl Rasterizer {
+    /// Rasterizer for its C value, if there is one
+    pub fn from_i32(value: i32) -> Option<Self> {
+        match value {
+            0 => Some(Self::Supersample),
+            1 => Some(Self::SparseScanline),
+            _ => None,
+        }
+    }
+}
+
+/// Samples per pixel along each axis
+pub(crate) fn samples_per_axis(level: AntiAliasLevel) -> usize {
+    match level {
+        AntiAliasLevel::None => 1,
+        AntiAliasLevel::Low => 2,
+        AntiAliasLevel::Medium => 4,
+        AntiAliasLevel::High => 8,
+    }
+}
+
+/// Greatest device-space distance of a flattened curve from the true one
+const FLATNESS: f32 = 0.25;
+
+/// Line segment in device space with `y0 < y1`
+#[derive(Debug, Clone, Copy)]
+struct Edge {
+    x0: f32,
+    y0: f32,
+    x1: f32,
+    y1: f32,
+    /// +1 if the path ran downwards, -1 if upwards
+    winding: i32,
+}
+
+impl Edge {
+    fn x_at(&self, y: f32) -> f32 {
+        self.x0 + (y - self.y0) * (self.x1 - self.x0) / (self.y1 - self.y0)
+    }
+}
+
+type Point = (f32, f32);
+
+/// Polyline in user space
+#[derive(Debug, Default)]
+struct Subpath {
+    points: Vec<Point>,
+    closed: bool,
+}
+
+/// Row buffers kept between fills so small paths don't allocate
+#[derive(Debug, Default)]
+pub struct RasterScratch {
+    edges: Vec<Edge>,
+    active: Vec<usize>,
+    crossings: Vec<(f32, i32)>,
+    counts: Vec<i32>,
+    deltas: Vec<i32>,
+    coverage: Vec<u8>,
+}
+
+fn transform(ctm: &[f32; 6], (x, y): Point) -> Point {
+    (
+        ctm[0] * x + ctm[2] * y + ctm[4],
+        ctm[1] * x + ctm[3] * y + ctm[5],
+    )
+}
+
+/// How much the CTM scales lengths, on average
+fn expansion(ctm: &[f32; 6]) -> f32 {
+    (ctm[0] * ctm[3] - ctm[1] * ctm[2]).abs().sqrt()
+}
+
+/// Flatten path operations into polylines, splitting curves finely enough
+/// to stay within [`FLATNESS`] once transformed by `ctm`
+fn flatten(path: &[PathOp], ctm: &[f32; 6]) -> Vec<Subpath> {
+    let mut subpaths: Vec<Subpath> = Vec::new();
+    let mut current = (0.0, 0.0);
+    let mut start = (0.0, 0.0);
+    let open = |subpaths: &mut Vec<Subpath>, at: Point| {
+        if subpaths
+            .last()
+            .is_none_or(|s| s.closed || s.points.len() > 1)
+        {
+            subpaths.push(Subpath::default());
+        }
+        let last = subpaths.last_mut().unwrap();
+        last.points.clear();
+        last.points.push(at);
+    };
+    for op in path {
+        match *op {
+            PathOp::MoveTo(x, y) => {
+                open(&mut subpaths, (x, y));
+                current = (x, y);
+                start = current;
+            }
+            PathOp::LineTo(x, y) => {
+                if subpaths.last().is_none_or(|s| s.closed) {
+                    open(&mut subpaths, current);
+                }
+                subpaths.last_mut().unwrap().points.push((x, y));
+                current = (x, y);
+            }
+            PathOp::CurveTo(x1, y1, x2, y2, x3, y3) => {
+                if subpaths.last().is_none_or(|s| s.closed) {
+                    open(&mut subpaths, current);
+                }
+                let p = [current, (x1, y1), (x2, y2), (x3, y3)];
+                let d = p.map(|q| transform(ctm, q));
+                // Largest second difference bounds how far the chords stray
+                let second = |a: Point, b: Point, c: Point| {
+                    let (x, y) = (a.0 - 2.0 * b.0 + c.0, a.1 - 2.0 * b.1 + c.1);
+                    (x * x + y * y).sqrt()
+                };
+                let dd = second(d[0], d[1], d[2]).max(second(d[1], d[2], d[3]));
+                let steps = (0.75 * dd / FLATNESS).sqrt().ceil().clamp(1.0, 256.0) as usize;
+                let points = &mut subpaths.last_mut().unwrap().points;
+                for i in 1..=steps {
+                    let t = i as f32 / steps as f32;
+                    let u = 1.0 - t;
+                    let (a, b, c, e) = (u * u * u, 3.0 * u * u * t, 3.0 * u * t * t, t * t * t);
+                    points.push((
+                        a * p[0].0 + b * p[1].0 + c * p[2].0 + e * p[3].0,
+                        a * p[0].1 + b * p[1].1 + c * p[2].1 + e * p[3].1,
+                    ));
+                }
+                current = (x3, y3);
+            }
+            PathOp::ClosePath => {
+                if let Some(last) = subpaths.last_mut().filter(|s| !s.closed) {
+                    last.closed = true;
+                }
+                current = start;
+            }
+        }
+    }
+    subpaths
+}
+
+/// Push the closed polygon `points` as edges in device space
+fn push_polygon(edges: &mut Vec<Edge>, ctm: &[f32; 6], points: &[Point]) {
+    let Some(&last) = points.last() else {
+        return;
+    };
+    let mut a = transform(ctm, last);
+    for &p in points {
+        let b = transform(ctm, p);
+        if a.1 != b.1 {
+            let (top, bottom, winding) = if a.1 < b.1 { (a, b, 1) } else { (b, a, -1) };
+            edges.push(Edge {
+                x0: top.0,
+                y0: top.1,
+                x1: bottom.0,
+                y1: bottom.1,
+                winding,
+            });
+        }
+        a = b;
+    }
+}
+
+/// Cut open polylines into their dashes
+fn dash(subpaths: Vec<Subpath>, array: &[f32], phase: f32) -> Vec<Subpath> {
+    // An odd-length array swaps dashes and gaps the second time round
+    let array = if array.len() % 2 == 1 {
+        array.repeat(2)
+    } else {
+        array.to_vec()
+    };
+    let total: f32 = array.iter().sum();
+    if array.iter().any(|&d| d < 0.0) || total <= 0.0 {
+        return subpaths;
+    }
+    let mut dashes = Vec::new();
+    for mut subpath in subpaths {
+        if subpath.closed {
+            let first = subpath.points[0];
+            subpath.points.push(first);
+        }
+        // Where the phase leaves us in the pattern
+        let (mut index, mut left) = (0, phase.rem_euclid(total));
+        while left >= array[index] {
+            left -= array[index];
+            index = (index + 1) % array.len();
+        }
+        left = array[index] - left;
+        let mut on = index % 2 == 0;
+        let mut piece = vec![subpath.points[0]];
+        for pair in subpath.points.windows(2) {
+            let (mut a, b) = (pair[0], pair[1]);
+            let mut length = ((b.0 - a.0).powi(2) + (b.1 - a.1).powi(2)).sqrt();
+            while length > left {
+                let t = left / length;
+                a = (a.0 + (b.0 - a.0) * t, a.1 + (b.1 - a.1) * t);
+                length -= left;
+                piece.push(a);
+                if on {
+                    dashes.push(Subpath {
+                        points: std::mem::take(&mut piece),
+                        closed: false,
+                    });
+                }
+                piece.clear();
+                piece.push(a);
+                on = !on;
+                index = (index + 1) % array.len();
+                left = array[index];
+            }
+            left -= length;
+            piece.push(b);
+        }
+        if on && piece.len() > 1 {
+            dashes.push(Subpath {
+                points: piece,
+                closed: false,
+            });
+        }
+    }
+    dashes
+}
+
+/// Polygon outlines covering the stroke of `subpaths`
+///
+/// Every piece is wound the same way, so filling them together with the
+/// non-zero rule gives the union, overlaps included.
+fn stroke(subpaths: Vec<Subpath>, state: &GraphicsState, ctm: &[f32; 6]) -> Vec<Vec<Point>> {
+    let scale = expansion(ctm).max(f32::EPSILON);
+    // A zero width is the thinnest line the device can show
+    let half = if state.line_width > 0.0 {
+        state.line_width / 2.0
+    } else {
+        0.5 / scale
+    };
+    let circle_steps = ((half * scale * 2.0).sqrt() * 4.0).clamp(8.0, 128.0) as usize;
+    let circle = |(x, y): Point| -> Vec<Point> {
+        (0..circle_steps)
+            .map(|i| {
+                let a = i as f32 / circle_steps as f32 * std::f32::consts::TAU;
+                (x + half * a.cos(), y + half * a.sin())
+            })
+            .collect()
+    };
+    let subpaths = if state.dash_array.is_empty() {
+        subpaths
+    } else {
+        dash(subpaths, &state.dash_array, state.dash_phase)
+    };
+
+    let mut polygons = Vec::new();
+    for mut subpath in subpaths {
+        // A bare move draws nothing; a move and a line to the same place
+        // still draws its caps
+        if subpath.points.len() < 2 {
+            continue;
+        }
+        subpath.points.dedup();
+        let closed = subpath.closed && subpath.points.len() > 2;
+        if closed && subpath.points.first() == subpath.points.last() {
+            subpath.points.pop();
+        }
+        let points = &subpath.points;
+        if points.len() == 1 {
+            // Zero-length subpaths draw only their caps
+            let (x, y) = points[0];
+            match state.line_cap {
+                1 => polygons.push(circle(points[0])),
+                2 => polygons.push(vec![
+                    (x - half, y - half),
+                    (x + half, y - half),
+                    (x + half, y + half),
+                    (x - half, y + half),
+                ]),
+                _ => {}
+            }
+            continue;
+        }
+        let count = if closed {
+            points.len()
+        } else {
+            points.len() - 1
+        };
+        let unit = |i: usize| {
+            let (a, b) = (points[i], points[(i + 1) % points.len()]);
+            let length = ((b.0 - a.0).powi(2) + (b.1 - a.1).powi(2)).sqrt();
+            ((b.0 - a.0) / length, (b.1 - a.1) / length)
+        };
+        for i in 0..count {
+            let (mut a, mut b) = (points[i], points[(i + 1) % points.len()]);
+            let d = unit(i);
+            if !closed && state.line_cap == 2 {
+                if i == 0 {
+                    a = (a.0 - d.0 * half, a.1 - d.1 * half);
+                }
+                if i == count - 1 {
+                    b = (b.0 + d.0 * half, b.1 + d.1 * half);
+                }
+            }
+            let n = (-d.1 * half, d.0 * half);
+            polygons.push(vec![
+                (a.0 + n.0, a.1 + n.1),
+                (b.0 + n.0, b.1 + n.1),
+                (b.0 - n.0, b.1 - n.1),
+                (a.0 - n.0, a.1 - n.1),
+            ]);
+        }
+        if !closed && state.line_cap == 1 {
+            polygons.push(circle(points[0]));
+            polygons.push(circle(points[points.len() - 1]));
+        }
+
+        // Joins at every vertex between two segments
+        let joins = if closed { 0..points.len() } else { 1..count };
+        for i in joins {
+            let v = points[i];
+            if state.line_join == 1 {
+                polygons.push(circle(v));
+                continue;
+            }
+            let d1 = unit((i + points.len() - 1) % points.len());
+            let d2 = unit(i);
+            let cross = d1.0 * d2.1 - d1.1 * d2.0;
+            if cross.abs() < 1e-6 {
+                continue;
+            }
+            // The outside of the turn
+            let side = if cross > 0.0 { -half } else { half };
+            let n1 = (-d1.1 * side, d1.0 * side);
+            let n2 = (-d2.1 * side, d2.0 * side);
+            let mut join = vec![v, (v.0 + n1.0, v.1 + n1.1)];
+            let (mx, my) = (n1.0 + n2.0, n1.1 + n2.1);
+            let m = (mx * mx + my * my).sqrt();
+            // 1 / sin(phi / 2) for the angle phi between the segments
+            let ratio = 2.0 * half / m;
+            if state.line_join == 0 && m > 0.0 && ratio <= state.miter_limit {
+                let reach = half * ratio / m;
+                join.push((v.0 + mx * reach, v.1 + my * reach));
+            }
+            join.push((v.0 + n2.0, v.1 + n2.1));
+            polygons.push(join);
+        }
+    }
+
+    for polygon in &mut polygons {
+        let area: f32 = (0..polygon.len())
+            .map(|i| {
+                let (a, b) = (polygon[i], polygon[(i + 1) % polygon.len()]);
+                a.0 * b.1 - b.0 * a.1
+            })
+            .sum();
+        if area < 0.0 {
+            polygon.reverse();
+        }
+    }
+    polygons
+}
+
+/// Pixel rectangle coverage is computed over
+#[derive(Debug, Clone, Copy)]
+pub(crate) struct Bounds {
+    pub x0: i32,
+    pub y0: i32,
+    pub x1: i32,
+    pub y1: i32,
+}
+
+// ============================================================================
+// Edge List Cache
+// ============================================================================
+
+/// Paths shorter than this without curves or stroking are cheaper to
+/// flatten again than to look up
+const MIN_CACHED_OPS: usize = 8;
+
+/// Device-space edges of one outline at one scale, before translation
+#[derive(Debug)]
+pub(crate) struct EdgeList {
+    edges: Vec<Edge>,
+}
+
+/// Edge lists held by the resource store
+pub(crate) static EDGE_LISTS: LazyLock<HandleStore<EdgeList>> = LazyLock::new(HandleStore::new);
+
+fn keep_edge_list(list: Handle) -> Handle {
+    EDGE_LISTS.keep(list)
+}
+
+fn release_edge_list(list: Handle) {
+    EDGE_LISTS.release(list);
+}
+
+/// Store key of the edges of `path` under the linear part of a CTM, filled
+/// or stroked with the style in `stroke`
+fn edge_list_key(path: &[PathOp], linear: &[f32; 6], stroke: Option<&GraphicsState>) -> Vec<u8> {
+    fn put(key: &mut Vec<u8>, values: &[f32]) {
+        for v in values {
+            key.extend_from_slice(&v.to_bits().to_le_bytes());
+        }
+    }
+    let mut key = Vec::with_capacity(32 + path.len() * 13);
+    key.extend_from_slice(b"edges");
+    put(&mut key, &linear[..4]);
+    match stroke {
+        None => key.push(0),
+        Some(state) => {
+            key.push(1);
+            put(
+                &mut key,
+                &[state.line_width, state.miter_limit, state.dash_phase],
+            );
+            key.extend_from_slice(&state.line_cap.to_le_bytes());
+            key.extend_from_slice(&state.line_join.to_le_bytes());
+            key.extend_from_slice(&(state.dash_array.len() as u32).to_le_bytes());
+            put(&mut key, &state.dash_array);
+        }
+    }
+    for op in path {
+        match *op {
+            PathOp::MoveTo(x, y) => {
+                key.push(b'm');
+                put(&mut key, &[x, y]);
+            }
+            PathOp::LineTo(x, y) => {
+                key.push(b'l');
+                put(&mut key, &[x, y]);
+            }
+            PathOp::CurveTo(x1, y1, x2, y2, x3, y3) => {
+                key.push(b'c');
+                put(&mut key, &[x1, y1, x2, y2, x3, y3]);
+            }
+            PathOp::ClosePath => key.push(b'h'),
+        }
+    }
+    key
+}
+
+/// Flatten, and for a stroke expand, `path` into edges under `linear`
+fn build_edges(
+    edges: &mut Vec<Edge>,
+    path: &[PathOp],
+    linear: &[f32; 6],
+    stroke: Option<&GraphicsState>,
+) {
+    let subpaths = flatten(path, linear);
+    match stroke {
+        None => {
+            for subpath in subpaths {
+                push_polygon(edges, linear, &subpath.points);
+            }
+        }
+        Some(state) => {
+            for polygon in self::stroke(subpaths, state, linear) {
+                push_polygon(edges, linear, &polygon);
+            }
+        }
+    }
+}
+
+/// Closed device-space polygons covering `path` under `ctm`, stroked with
+/// the line style in `stroke` if given, for renderers that tessellate
+/// rather than scan: a fill's polygons take its fill rule, a stroke's
+/// non-zero
+pub(crate) fn outline(
+    path: &[PathOp],
+    ctm: &[f32; 6],
+    stroke: Option<&GraphicsState>,
+) -> Vec<Vec<(f32, f32)>> {
+    let subpaths = flatten(path, ctm);
+    let polygons = match stroke {
+        None => subpaths.into_iter().map(|s| s.points).collect(),
+        Some(state) => self::stroke(subpaths, state, ctm),
+    };
+    polygons
+        .into_iter()
+        .filter(|p| p.len() >= 3)
+        .map(|p| p.into_iter().map(|q| transform(ctm, q)).collect())
+        .collect()
+}
+
+/// Fill `scratch.edges` with the device-space edges of `path` under `ctm`
+///
+/// Edges are built under the linear part of the CTM and then translated,
+/// so the same symbol drawn at many places is flattened and stroked once
+/// and replayed from the store as an `EdgeList` item. The translation is
+/// added after the linear terms exactly as a direct transform adds it, so
+/// replayed edges are bit for bit the ones a fresh build would give.
+fn load_edges(
+    scratch: &mut RasterScratch,
+    path: &[PathOp],
+    ctm: &[f32; 6],
+    stroke: Option<&GraphicsState>,
+) {
+    let linear = [ctm[0], ctm[1], ctm[2], ctm[3], 0.0, 0.0];
+    let (tx, ty) = (ctm[4], ctm[5]);
+    let translate = |e: &Edge| Edge {
+        x0: e.x0 + tx,
+        y0: e.y0 + ty,
+        x1: e.x1 + tx,
+        y1: e.y1 + ty,
+        winding: e.winding,
+    };
+    scratch.edges.clear();
+    let cacheable = stroke.is_some()
+        || path.len() >= MIN_CACHED_OPS
+        || path.iter().any(|op| matches!(op, PathOp::CurveTo(..)));
+    if !cacheable {
+        build_edges(&mut scratch.edges, path, &linear, stroke);
+        for edge in &mut scratch.edges {
+            *edge = translate(edge);
+        }
+        return;
+    }
+
+    let key = edge_list_key(path, &linear, stroke);
+    let cached = store_find_and_keep(&key, keep_edge_list);
+    if cached != 0 {
+        if let Some(list) = EDGE_LISTS.get(cached) {
+            let list = list.lock().unwrap();
+            scratch.edges.extend(list.edges.iter().map(translate));
+        }
+        release_edge_list(cached);
+        return;
+    }
+    let mut edges = Vec::new();
+    build_edges(&mut edges, path, &linear, stroke);
+    scratch.edges.extend(edges.iter().map(translate));
+    let size = edges.len() * std::mem::size_of::<Edge>() + key.len();
+    store_owned_item(
+        StoreType::EdgeList,
+        EDGE_LISTS.insert(EdgeList { edges }),
+        size,
+        &key,
+        release_edge_list,
+    );
+}
+
+// ============================================================================
+// Scan Conversion
+// ============================================================================
+
+/// Fill `path` transformed by `ctm`, calling `emit(x, y, coverage)` for each
+/// run of covered pixels
+#[allow(clippy::too_many_arguments)]
+pub(crate) fn fill_path(
+    scratch: &mut RasterScratch,
+    path: &[PathOp],
+    ctm: &[f32; 6],
+    even_odd: bool,
+    level: AntiAliasLevel,
+    rasterizer: Rasterizer,
+    bounds: Bounds,
+    emit: impl FnMut(i32, i32, &[u8]),
+) {
+    counters::add(Counter::PathsFilled, 1);
+    load_edges(scratch, path, ctm, None);
+    scan(scratch, even_odd, level, rasterizer, bounds, emit);
+}
+
+/// Stroke `path` with the line style in `state`, like [`fill_path`]
+pub(crate) fn stroke_path(
+    scratch: &mut RasterScratch,
+    path: &[PathOp],
+    state: &GraphicsState,
+    level: AntiAliasLevel,
+    rasterizer: Rasterizer,
+    bounds: Bounds,
+    emit: impl FnMut(i32, i32, &[u8]),
+) {
+    counters::add(Counter::PathsStroked, 1);
+    load_edges(scratch, path, &state.ctm, Some(state));
+    scan(scratch, false, level, rasterizer, bounds, emit);
+}
+
+fn scan(
+    scratch: &mut RasterScratch,
+    even_odd: bool,
+    level: AntiAliasLevel,
+    rasterizer: Rasterizer,
+    bounds: Bounds,
+    mut emit: impl FnMut(i32, i32, &[u8]),
+) {
+    let RasterScratch {
+        edges,
+        active,
+        crossings,
+        counts,
+        deltas,
+        coverage,
+    } = scratch;
+    edges.retain(|e| e.y0.is_finite() && e.y1.is_finite() && e.x0.is_finite() && e.x1.is_finite());
+    if edges.is_empty() || bounds.x0 >= bounds.x1 || bounds.y0 >= bounds.y1 {
+        return;
+    }
+    edges.sort_unstable_by(|a, b| a.y0.total_cmp(&b.y0));
+    let top = edges[0].y0;
+    let bottom = edges.iter().map(|e| e.y1).fold(f32::MIN, f32::max);
+    let y0 = (top.floor() as i32).max(bounds.y0);
+    let y1 = (bottom.ceil() as i32).min(bounds.y1);
+
+    let samples = samples_per_axis(level);
+    let width = (bounds.x1 - bounds.x0) as usize;
+    let columns = (width * samples) as i32;
+    let area = (samples * samples) as i32;
+    let level_of = |count: i32| ((count * 255 + area / 2) / area) as u8;
+    counts.clear();
+    counts.resize(width + 1, 0);
+    deltas.clear();
+    deltas.resize(width + 1, 0);
+    coverage.clear();
+    coverage.resize(width, 0);
+    active.clear();
+    let mut next = edges.partition_point(|e| e.y0 < y0 as f32);
+    // Edges over the starting row that began above it
+    active.extend((0..next).filter(|&i| edges[i].y1 > y0 as f32));
+
+    for y in y0..y1 {
+        let (mut first, mut last) = (width, 0);
+        for k in 0..samples {
+            let sy = y as f32 + (k as f32 + 0.5) / samples as f32;
+            while next < edges.len() && edges[next].y0 <= sy {
+                active.push(next);
+                next += 1;
+            }
+            active.retain(|&i| edges[i].y1 > sy);
+            crossings.clear();
+            crossings.extend(
+                active
+                    .iter()
+                    .map(|&i| &edges[i])
+                    .filter(|e| e.y0 <= sy)
+                    .map(|e| (e.x_at(sy), e.winding)),
+            );
+            crossings.sort_unstable_by(|a, b| a.0.total_cmp(&b.0));
+
+            let mut winding = 0;
+            let mut start = 0.0;
+            for &(x, w) in crossings.iter() {
+                let was_inside = if even_odd {
+                    winding & 1 != 0
+                } else {
+                    winding != 0
+                };
+                winding += w;
+                let inside = if even_odd {
+                    winding & 1 != 0
+                } else {
+                    winding != 0
+                };
+                if inside == was_inside {
+                    continue;
+                }
+                if inside {
+                    start = x;
+                    continue;
+                }
+                // Sample j of the row sits at (j + 0.5) / samples, so the
+                // span [start, x) holds samples ceil(start * s - 0.5) up to
+                // ceil(x * s - 0.5)
+                let column = |x: f32| {
+                    ((x - bounds.x0 as f32) * samples as f32 - 0.5)
+                        .ceil()
+                        .clamp(0.0, columns as f32) as usize
+                };
+                let (s0, s1) = (column(start), column(x));
+                if s0 >= s1 {
+                    continue;
+                }
+                let (p0, p1) = (s0 / samples, s1 / samples);
+                first = first.min(p0);
+                last = last.max(p1 + 1).min(width);
+                match rasterizer {
+                    Rasterizer::Supersample => {
+                        for s in s0..s1 {
+                            counts[s / samples] += 1;
+                        }
+                    }
+                    Rasterizer::SparseScanline => {
+                        let span = samples as i32;
+                        if p0 == p1 {
+                            counts[p0] += (s1 - s0) as i32;
+                        } else {
+                            counts[p0] += span - (s0 % samples) as i32;
+                            deltas[p0 + 1] += span;
+                            deltas[p1] -= span;
+                            counts[p1] += (s1 % samples) as i32;
+                        }
+                    }
+                }
+            }
+        }
+        if first >= last {
+            continue;
+        }
+
+        let mut running = 0;
+        for x in first..last {
+            running += deltas[x];
+            coverage[x] = level_of(counts[x] + running);
+            counts[x] = 0;
+            deltas[x] = 0;
+        }
+        counts[last] = 0;
+        deltas[last] = 0;
+        // Hand over the runs of covered pixels
+        let mut x = first;
+        while x < last {
+            if coverage[x] == 0 {
+                x += 1;
+                continue;
+            }
+            let run = x;
+            while x < last && coverage[x] != 0 {
+                x += 1;
+            }
+            emit(bounds.x0 + run as i32, y, &coverage[run..x]);
+        }
+        if active.is_empty() && next == edges.len() {
+            break;
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    const ALL: Bounds = Bounds {
+        x0: 0,
+        y0: 0,
+        x1: 64,
+        y1: 64,
+    };
+
+    fn render(
+        path: &[PathOp],
+        even_odd: bool,
+        level: AntiAliasLevel,
+        rasterizer: Rasterizer,
+    ) -> Vec<u8> {
+        let mut image = vec![0u8; 64 * 64];
+        let identity = [1.0, 0.0, 0.0, 1.0, 0.0, 0.0];
+        fill_path(
+            &mut RasterScratch::default(),
+            path,
+            &identity,
+            even_odd,
+            level,
+            rasterizer,
+            ALL,
+            |x, y, run| {
+                let at = y as usize * 64 + x as usize;
+                image[at..at + run.len()].copy_from_slice(run);
+            },
+        );
+        image
+    }
+
+    fn polygon(points: &[Point]) -> Vec<PathOp> {
+        let mut path = vec![PathOp::MoveTo(points[0].0, points[0].1)];
+        path.extend(points[1..].iter().map(|&(x, y)| PathOp::LineTo(x, y)));
+        path.push(PathOp::ClosePath);
+        path
+    }
+
+    #[test]
+    fn test_rectangle_coverage() {
+        // Half a pixel in on each side
+        let path = polygon(&[(2.5, 2.0), (6.0, 2.0), (6.0, 4.5), (2.5, 4.5)]);
+        for rasterizer in [Rasterizer::Supersample, Rasterizer::SparseScanline] {
+            let image = render(&path, false, AntiAliasLevel::High, rasterizer);
+            assert_eq!(&image[2 * 64 + 1..2 * 64 + 7], &[0, 128, 255, 255, 255, 0]);
+            assert_eq!(&image[4 * 64 + 1..4 * 64 + 7], &[0, 64, 128, 128, 128, 0]);
+            assert_eq!(image[5 * 64 + 3], 0);
+        }
+    }
+
+    #[test]
+    fn test_rasterizers_agree() {
+        let star = polygon(&[
+            (32.0, 1.3),
+            (50.2, 60.1),
+            (2.7, 22.4),
+            (61.9, 23.8),
+            (12.1, 58.6),
+        ]);
+        let mut curved = vec![PathOp::MoveTo(4.0, 40.0)];
+        curved.push(PathOp::CurveTo(10.0, -20.0, 70.0, 90.0, 60.0, 10.0));
+        curved.push(PathOp::LineTo(30.3, 63.7));
+        curved.push(PathOp::ClosePath);
+        // Off the device on the left and top
+        let clipped = polygon(&[(-10.0, -5.0), (20.5, 3.25), (7.75, 30.0)]);
+        for path in [&star, &curved, &clipped] {
+            for level in [
+                AntiAliasLevel::None,
+                AntiAliasLevel::Low,
+                AntiAliasLevel::Medium,
+                AntiAliasLevel::High,
+            ] {
+                for even_odd in [false, true] {
+                    let dense = render(path, even_odd, level, Rasterizer::Supersample);
+                    let sparse = render(path, even_odd, level, Rasterizer::SparseScanline);
+                    assert!(dense.iter().any(|&c| c != 0));
+                    assert_eq!(dense, sparse, "{level:?} even_odd={even_odd}");
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn test_stroke_covers_line() {
+        let state = GraphicsState {
+            line_width: 4.0,
+            line_cap: 2,
+            ..Default::default()
+        };
+        let path = [PathOp::MoveTo(10.0, 10.0), PathOp::LineTo(30.0, 10.0)];
+        let mut covered = Vec::new();
+        stroke_path(
+            &mut RasterScratch::default(),
+            &path,
+            &state,
+            AntiAliasLevel::High,
+            Rasterizer::SparseScanline,
+            ALL,
+            |x, y, run| covered.push((x, y, run.to_vec())),
+        );
+        // Square caps reach 2 units past each end, 2 above and below
+        assert_eq!(covered.len(), 4);
+        for (x, y, run) in covered {
+            assert_eq!((x, run.len()), (8, 24));
+            assert!((8..12).contains(&y));
+            assert!(run.iter().all(|&c| c == 255));
+        }
+    }
+
+    #[test]
+    fn test_repeated_outline_replays_cached_edges() {
+        use super::super::store::store_discard_matching;
+
+        let path = [
+            PathOp::MoveTo(1.0, 1.0),
+            PathOp::CurveTo(9.3, 0.5, 12.0, 14.0, 3.0, 11.0),
+            PathOp::ClosePath,
+        ];
+        let draw = |ctm: [f32; 6]| {
+            let mut runs = Vec::new();
+            fill_path(
+                &mut RasterScratch::default(),
+                &path,
+                &ctm,
+                false,
+                AntiAliasLevel::High,
+                Rasterizer::SparseScanline,
+                ALL,
+                |x, y, run| runs.push((x, y, run.to_vec())),
+            );
+            runs
+        };
+        let key = edge_list_key(&path, &[2.0, 0.0, 0.0, 2.0, 0.0, 0.0], None);
+        store_discard_matching(StoreType::EdgeList, &key);
+
+        assert!(!draw([2.0, 0.0, 0.0, 2.0, 0.25, 0.5]).is_empty());
+        let cached = store_find_and_keep(&key, keep_edge_list);
+        assert_ne!(cached, 0);
+        release_edge_list(cached);
+        // Elsewhere on the page from the cache, then built afresh
+        let moved = [2.0, 0.0, 0.0, 2.0, 20.25, 30.5];
+        let replayed = draw(moved);
+        store_discard_matching(StoreType::EdgeList, &key);
+        assert_eq!(replayed, draw(moved));
+
+        let stroked = GraphicsState::default();
+        let linear = [2.0, 0.0, 0.0, 2.0, 0.0, 0.0];
+        assert_ne!(key, edge_list_key(&path, &linear, Some(&stroked)));
+        assert_ne!(
+            key,
+            edge_list_key(&path, &[3.0, 0.0, 0.0, 2.0, 0.0, 0.0], None)
+        );
+        store_discard_matching(StoreType::EdgeList, &key);
+    }
+
+    #[test]
+    fn test_dash_splits_line() {
+        let line = vec![Subpath {
+            points: vec![(0.0, 0.0), (10.0, 0.0)],
+            closed: false,
+        }];
+        let dashes = dash(line, &[3.0, 2.0], 1.0);
+        let spans: Vec<_> = dashes
+            .iter()
+            .map(|d| (d.points[0].0, d.points.last().unwrap().0))
+            .collect();
+        assert_eq!(spans, vec![(0.0, 2.0), (4.0, 7.0), (9.0, 10.0)]);
+    }
+}
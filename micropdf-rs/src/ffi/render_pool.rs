@@ -0,0 +1,590 @@
+//! Render pool - parallel page rendering on cloned contexts
+//!
+//! A render pool owns a fixed set of worker threads, each bound to its own
+//! clone of the creating context. Clones keep separate error state but share
+//! the process-wide resource store and glyph cache, so resources decoded by
+//! one worker are reused by the others.
+//!
+//! Jobs are plain handles and values, so they can be submitted from any
+//! thread and from any language binding. Results are claimed with
+//! `fz_render_pool_wait`, which transfers ownership of the pixmap.
+//!
+//! With `FZ_RENDER_POOL_PIN_NODES` the workers are spread round-robin over
+//! the NUMA nodes, each pinned to its node's CPUs, so the pixmaps they
+//! render are placed in their node's memory.
+
+use std::collections::HashMap;
+use std::sync::mpsc::{self, Receiver, Sender};
+use std::sync::{Arc, Condvar, LazyLock, Mutex};
+use std::thread::JoinHandle;
+
+use super::context::{fz_aa_level, fz_clone_context, fz_drop_context};
+use super::cookie::{fz_cookie_abort, fz_cookie_should_abort, fz_drop_cookie, fz_new_cookie};
+use super::data_locality::{numa_nodes, pin_thread_to_node};
+use super::document::{fz_drop_page, fz_load_page, fz_new_pixmap_from_page_with_options};
+use super::geometry::fz_matrix;
+use super::pixmap::fz_drop_pixmap;
+use super::{Handle, HandleStore};
+
+/// Handle store for render pools
+pub static RENDER_POOLS: LazyLock<HandleStore<RenderPool>> = LazyLock::new(HandleStore::new);
+
+/// Upper bound on worker threads per pool
+pub const FZ_RENDER_POOL_MAX_THREADS: i32 = 64;
+
+/// Pin each worker to the CPUs of one NUMA node, round-robin
+pub const FZ_RENDER_POOL_PIN_NODES: i32 = 1;
+
+/// Job is queued and has not started yet
+pub const FZ_RENDER_JOB_PENDING: i32 = 0;
+/// Job is being rendered by a worker
+pub const FZ_RENDER_JOB_RUNNING: i32 = 1;
+/// Job finished and its pixmap is ready to be claimed
+pub const FZ_RENDER_JOB_DONE: i32 = 2;
+/// Job failed (invalid page, render error)
+pub const FZ_RENDER_JOB_FAILED: i32 = 3;
+/// Job was cancelled before it finished
+pub const FZ_RENDER_JOB_CANCELLED: i32 = 4;
+
+/// A queued render request
+struct Job {
+    id: u64,
+    doc: Handle,
+    page_number: i32,
+    ctm: fz_matrix,
+    cs: Handle,
+    alpha: i32,
+    aa_bits: i32,
+    flags: i32,
+    cookie: Handle,
+}
+
+/// Book-keeping for a submitted job until it is claimed
+struct JobSlot {
+    state: i32,
+    pixmap: Handle,
+    cookie: Handle,
+}
+
+/// State shared between the pool handle and its workers
+#[derive(Default)]
+struct Shared {
+    jobs: Mutex<HashMap<u64, JobSlot>>,
+    changed: Condvar,
+}
+
+impl Shared {
+    /// Move a pending job to running; false if it was cancelled meanwhile
+    fn start(&self, id: u64) -> bool {
+        let Ok(mut jobs) = self.jobs.lock() else {
+            return false;
+        };
+        match jobs.get_mut(&id) {
+            Some(slot) if slot.state == FZ_RENDER_JOB_PENDING => {
+                slot.state = FZ_RENDER_JOB_RUNNING;
+                true
+            }
+            _ => false,
+        }
+    }
+
+    /// Record the outcome of a job and wake any waiters
+    fn finish(&self, id: u64, pixmap: Handle) {
+        if let Ok(mut jobs) = self.jobs.lock() {
+            match jobs.get_mut(&id) {
+                Some(slot) => {
+                    if fz_cookie_should_abort(0, slot.cookie) != 0 {
+                        slot.state = FZ_RENDER_JOB_CANCELLED;
+                        if pixmap != 0 {
+                            fz_drop_pixmap(0, pixmap);
+                        }
+                    } else if pixmap == 0 {
+                        slot.state = FZ_RENDER_JOB_FAILED;
+                    } else {
+                        slot.state = FZ_RENDER_JOB_DONE;
+                        slot.pixmap = pixmap;
+                    }
+                }
+                None if pixmap != 0 => fz_drop_pixmap(0, pixmap),
+                None => {}
+            }
+        }
+        self.changed.notify_all();
+    }
+}
+
+/// A pool of render threads with one cloned context each
+pub struct RenderPool {
+    sender: Option<Sender<Job>>,
+    workers: Vec<JoinHandle<()>>,
+    contexts: Vec<Handle>,
+    /// NUMA node each worker is pinned to
+    nodes: Vec<Option<usize>>,
+    shared: Arc<Shared>,
+    next_job: u64,
+}
+
+impl RenderPool {
+    fn new(ctx: Handle, threads: usize, flags: i32) -> Option<Self> {
+        let (sender, receiver) = mpsc::channel::<Job>();
+        let receiver = Arc::new(Mutex::new(receiver));
+        let shared = Arc::new(Shared::default());
+        let mut pool = Self {
+            sender: Some(sender),
+            workers: Vec::with_capacity(threads),
+            contexts: Vec::with_capacity(threads),
+            nodes: Vec::with_capacity(threads),
+            shared,
+            next_job: 1,
+        };
+
+        let pin_nodes = (flags & FZ_RENDER_POOL_PIN_NODES != 0).then(numa_nodes);
+        for i in 0..threads {
+            let node = pin_nodes.as_ref().map(|nodes| nodes[i % nodes.len()]);
+            let worker_ctx = fz_clone_context(ctx);
+            if worker_ctx == 0 {
+                pool.shutdown();
+                return None;
+            }
+            pool.contexts.push(worker_ctx);
+
+            let receiver = Arc::clone(&receiver);
+            let shared = Arc::clone(&pool.shared);
+            let spawned = std::thread::Builder::new()
+                .name(format!("micropdf-render-{i}"))
+                .spawn(move || {
+                    if let Some(node) = node {
+                        pin_thread_to_node(node);
+                    }
+                    worker_main(worker_ctx, receiver, shared)
+                });
+            match spawned {
+                Ok(handle) => {
+                    pool.workers.push(handle);
+                    pool.nodes.push(node);
+                }
+                Err(_) => {
+                    pool.shutdown();
+                    return None;
+                }
+            }
+        }
+        Some(pool)
+    }
+
+    /// Cancel outstanding work, join the workers and release everything
+    fn shutdown(&mut self) {
+        if let Ok(mut jobs) = self.shared.jobs.lock() {
+            for slot in jobs.values_mut() {
+                match slot.state {
+                    FZ_RENDER_JOB_PENDING => slot.state = FZ_RENDER_JOB_CANCELLED,
+                    FZ_RENDER_JOB_RUNNING => fz_cookie_abort(0, slot.cookie),
+                    _ => {}
+                }
+            }
+        }
+        self.shared.changed.notify_all();
+
+        // Closing the channel ends each worker once the queue drains
+        self.sender = None;
+        for worker in self.workers.drain(..) {
+            let _ = worker.join();
+        }
+
+        if let Ok(mut jobs) = self.shared.jobs.lock() {
+            for slot in jobs.values_mut() {
+                if slot.pixmap != 0 {
+                    fz_drop_pixmap(0, slot.pixmap);
+                    slot.pixmap = 0;
+                }
+                if slot.cookie != 0 {
+                    fz_drop_cookie(0, slot.cookie);
+                    slot.cookie = 0;
+                }
+                if slot.state < FZ_RENDER_JOB_DONE {
+                    slot.state = FZ_RENDER_JOB_CANCELLED;
+                }
+            }
+        }
+        self.shared.changed.notify_all();
+
+        for ctx in self.contexts.drain(..) {
+            fz_drop_context(ctx);
+        }
+    }
+}
+
+fn worker_main(ctx: Handle, receiver: Arc<Mutex<Receiver<Job>>>, shared: Arc<Shared>) {
+    loop {
+        let job = match receiver.lock() {
+            Ok(receiver) => receiver.recv(),
+            Err(_) => return,
+        };
+        let Ok(job) = job else {
+            return;
+        };
+        if !shared.start(job.id) {
+            continue;
+        }
+        let pixmap = render_job(ctx, &job);
+        shared.finish(job.id, pixmap);
+    }
+}
+
+fn render_job(ctx: Handle, job: &Job) -> Handle {
+    let page = fz_load_page(ctx, job.doc, job.page_number);
+    if page == 0 {
+        return 0;
+    }
+    let aa_bits = if job.aa_bits < 0 {
+        fz_aa_level(ctx)
+    } else {
+        job.aa_bits
+    };
+    let pixmap = fz_new_pixmap_from_page_with_options(
+        ctx, page, job.ctm, job.cs, job.alpha, aa_bits, job.flags, job.cookie,
+    );
+    fz_drop_page(ctx, page);
+    pixmap
+}
+
+/// Get the shared job state of a pool without holding the pool lock
+fn pool_shared(pool: Handle) -> Option<Arc<Shared>> {
+    let pool = RENDER_POOLS.get(pool)?;
+    let guard = pool.lock().ok()?;
+    Some(Arc::clone(&guard.shared))
+}
+
+// ============================================================================
+// FFI Functions
+// ============================================================================
+
+/// Create a render pool with `threads` workers
+///
+/// Each worker gets its own clone of `ctx`. Pass 0 (or a negative value)
+/// to use one worker per available CPU. Returns 0 on failure.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_render_pool(ctx: Handle, threads: i32) -> Handle {
+    fz_new_render_pool_with_options(ctx, threads, 0)
+}
+
+/// Create a render pool with `threads` workers and `FZ_RENDER_POOL_*`
+/// `flags`
+///
+/// As `fz_new_render_pool`. Pinning a worker to its node is best effort;
+/// `fz_render_pool_worker_node` reports the node it was given.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_render_pool_with_options(ctx: Handle, threads: i32, flags: i32) -> Handle {
+    let threads = if threads > 0 {
+        threads.min(FZ_RENDER_POOL_MAX_THREADS) as usize
+    } else {
+        std::thread::available_parallelism()
+            .map(|n| n.get())
+            .unwrap_or(1)
+            .min(FZ_RENDER_POOL_MAX_THREADS as usize)
+    };
+    match RenderPool::new(ctx, threads, flags) {
+        Some(pool) => RENDER_POOLS.insert(pool),
+        None => 0,
+    }
+}
+
+/// Shut down a render pool
+///
+/// Pending jobs are cancelled, running jobs are aborted through their
+/// cookies, and workers are joined before this returns. Unclaimed pixmaps
+/// and the worker contexts are dropped.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_drop_render_pool(_ctx: Handle, pool: Handle) {
+    if let Some(pool) = RENDER_POOLS.remove(pool) {
+        if let Ok(mut guard) = pool.lock() {
+            guard.shutdown();
+        }
+    }
+}
+
+/// Number of worker threads in a pool (0 for an invalid pool)
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_render_pool_threads(_ctx: Handle, pool: Handle) -> i32 {
+    RENDER_POOLS
+        .get(pool)
+        .and_then(|p| p.lock().ok().map(|g| g.workers.len() as i32))
+        .unwrap_or(0)
+}
+
+/// Context bound to worker `index` (0 if out of range)
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_render_pool_context(_ctx: Handle, pool: Handle, index: i32) -> Handle {
+    if index < 0 {
+        return 0;
+    }
+    RENDER_POOLS
+        .get(pool)
+        .and_then(|p| p.lock().ok()?.contexts.get(index as usize).copied())
+        .unwrap_or(0)
+}
+
+/// NUMA node worker `index` is pinned to, or -1 if it isn't pinned
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_render_pool_worker_node(_ctx: Handle, pool: Handle, index: i32) -> i32 {
+    if index < 0 {
+        return -1;
+    }
+    RENDER_POOLS
+        .get(pool)
+        .and_then(|p| *p.lock().ok()?.nodes.get(index as usize)?)
+        .map_or(-1, |node| node as i32)
+}
+
+/// Queue a page for rendering
+///
+/// Arguments match `fz_new_pixmap_from_page_with_options`, except that the
+/// page is given by number and a negative `aa_bits` uses the worker
+/// context's AA level. Returns a non-zero job id, or 0 on failure.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_render_pool_submit(
+    ctx: Handle,
+    pool: Handle,
+    doc: Handle,
+    page_number: i32,
+    ctm: fz_matrix,
+    cs: Handle,
+    alpha: i32,
+    aa_bits: i32,
+    flags: i32,
+) -> u64 {
+    let Some(pool) = RENDER_POOLS.get(pool) else {
+        return 0;
+    };
+    let Ok(mut guard) = pool.lock() else {
+        return 0;
+    };
+    let Some(sender) = guard.sender.clone() else {
+        return 0;
+    };
+
+    let id = guard.next_job;
+    guard.next_job += 1;
+    let cookie = fz_new_cookie(ctx);
+    if let Ok(mut jobs) = guard.shared.jobs.lock() {
+        jobs.insert(
+            id,
+            JobSlot {
+                state: FZ_RENDER_JOB_PENDING,
+                pixmap: 0,
+                cookie,
+            },
+        );
+    }
+
+    let job = Job {
+        id,
+        doc,
+        page_number,
+        ctm,
+        cs,
+        alpha,
+        aa_bits,
+        flags,
+        cookie,
+    };
+    if sender.send(job).is_err() {
+        if let Ok(mut jobs) = guard.shared.jobs.lock() {
+            jobs.remove(&id);
+        }
+        fz_drop_cookie(ctx, cookie);
+        return 0;
+    }
+    id
+}
+
+/// Current state of a job (FZ_RENDER_JOB_*), or -1 if unknown
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_render_pool_poll(_ctx: Handle, pool: Handle, job: u64) -> i32 {
+    pool_shared(pool)
+        .and_then(|shared| shared.jobs.lock().ok()?.get(&job).map(|s| s.state))
+        .unwrap_or(-1)
+}
+
+/// Cancel a job
+///
+/// A pending job never starts; a running job is aborted through its
+/// cookie. Returns 1 if the job was still outstanding, 0 otherwise.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_render_pool_cancel(_ctx: Handle, pool: Handle, job: u64) -> i32 {
+    let Some(shared) = pool_shared(pool) else {
+        return 0;
+    };
+    let cancelled = match shared.jobs.lock() {
+        Ok(mut jobs) => match jobs.get_mut(&job) {
+            Some(slot) if slot.state == FZ_RENDER_JOB_PENDING => {
+                slot.state = FZ_RENDER_JOB_CANCELLED;
+                true
+            }
+            Some(slot) if slot.state == FZ_RENDER_JOB_RUNNING => {
+                fz_cookie_abort(0, slot.cookie);
+                true
+            }
+            _ => false,
+        },
+        Err(_) => false,
+    };
+    shared.changed.notify_all();
+    i32::from(cancelled)
+}
+
+/// Block until a job finishes and claim its pixmap
+///
+/// Ownership of the pixmap passes to the caller. The job id is released
+/// whatever the outcome; 0 is returned if the job failed, was cancelled
+/// or is unknown.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_render_pool_wait(ctx: Handle, pool: Handle, job: u64) -> Handle {
+    let Some(shared) = pool_shared(pool) else {
+        return 0;
+    };
+    let Ok(mut jobs) = shared.jobs.lock() else {
+        return 0;
+    };
+    loop {
+        match jobs.get(&job) {
+            None => return 0,
+            Some(slot) if slot.state >= FZ_RENDER_JOB_DONE => break,
+            Some(_) => {}
+        }
+        jobs = match shared.changed.wait(jobs) {
+            Ok(jobs) => jobs,
+            Err(_) => return 0,
+        };
+    }
+    let Some(slot) = jobs.remove(&job) else {
+        return 0;
+    };
+    drop(jobs);
+
+    fz_drop_cookie(ctx, slot.cookie);
+    slot.pixmap
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::DOCUMENTS;
+    use crate::ffi::colorspace::FZ_COLORSPACE_GRAY;
+    use crate::ffi::context::{fz_context_is_valid, fz_new_context};
+    use crate::ffi::document::Document;
+    use crate::ffi::pixmap::fz_pixmap_width;
+
+    fn thumbnail() -> fz_matrix {
+        fz_matrix {
+            a: 0.25,
+            b: 0.0,
+            c: 0.0,
+            d: 0.25,
+            e: 0.0,
+            f: 0.0,
+        }
+    }
+
+    #[test]
+    fn test_render_pool_renders_jobs() {
+        let ctx = unsafe { fz_new_context(std::ptr::null(), std::ptr::null(), 1024 * 1024) };
+        let doc = DOCUMENTS.insert(Document::new(b"%PDF-1.4\n/Type /Page\n%%EOF".to_vec()));
+        let pool = fz_new_render_pool(ctx, 2);
+        assert_ne!(pool, 0);
+        assert_eq!(fz_render_pool_threads(ctx, pool), 2);
+
+        let worker_ctx = fz_render_pool_context(ctx, pool, 0);
+        assert_ne!(worker_ctx, 0);
+        assert_ne!(worker_ctx, ctx);
+        assert_eq!(fz_render_pool_context(ctx, pool, 2), 0);
+
+        let jobs: Vec<u64> = (0..4)
+            .map(|_| {
+                fz_render_pool_submit(ctx, pool, doc, 0, thumbnail(), FZ_COLORSPACE_GRAY, 0, -1, 0)
+            })
+            .collect();
+        assert!(jobs.iter().all(|&id| id != 0));
+
+        for &id in &jobs {
+            let pix = fz_render_pool_wait(ctx, pool, id);
+            assert_ne!(pix, 0);
+            assert_eq!(fz_pixmap_width(ctx, pix), 153);
+            fz_drop_pixmap(ctx, pix);
+            assert_eq!(fz_render_pool_poll(ctx, pool, id), -1);
+        }
+
+        // Out-of-range pages fail without taking the pool down
+        let bad =
+            fz_render_pool_submit(ctx, pool, doc, 7, thumbnail(), FZ_COLORSPACE_GRAY, 0, 0, 0);
+        assert_ne!(bad, 0);
+        assert_eq!(fz_render_pool_wait(ctx, pool, bad), 0);
+
+        fz_drop_render_pool(ctx, pool);
+        assert_eq!(fz_context_is_valid(worker_ctx), 0);
+        assert_eq!(fz_context_is_valid(ctx), 1);
+        assert_eq!(
+            fz_render_pool_submit(ctx, pool, doc, 0, thumbnail(), FZ_COLORSPACE_GRAY, 0, 0, 0),
+            0
+        );
+        DOCUMENTS.remove(doc);
+        fz_drop_context(ctx);
+    }
+
+    #[test]
+    fn test_render_pool_cancel_and_shutdown() {
+        let ctx = unsafe { fz_new_context(std::ptr::null(), std::ptr::null(), 1024 * 1024) };
+        let doc = DOCUMENTS.insert(Document::new(b"%PDF-1.4\n/Type /Page\n%%EOF".to_vec()));
+        let pool = fz_new_render_pool(ctx, 1);
+        assert_ne!(pool, 0);
+
+        let jobs: Vec<u64> = (0..8)
+            .map(|_| {
+                fz_render_pool_submit(ctx, pool, doc, 0, thumbnail(), FZ_COLORSPACE_GRAY, 0, 0, 0)
+            })
+            .collect();
+        let last = *jobs.last().unwrap();
+        fz_render_pool_cancel(ctx, pool, last);
+        assert_eq!(fz_render_pool_wait(ctx, pool, last), 0);
+        assert_eq!(fz_render_pool_cancel(ctx, pool, last), 0);
+
+        // Dropping with work outstanding joins cleanly
+        fz_drop_render_pool(ctx, pool);
+        assert_eq!(fz_render_pool_threads(ctx, pool), 0);
+        assert_eq!(fz_render_pool_poll(ctx, pool, jobs[0]), -1);
+        assert_eq!(fz_render_pool_wait(ctx, pool, jobs[0]), 0);
+
+        assert_eq!(fz_new_render_pool(0, 1), 0);
+        DOCUMENTS.remove(doc);
+        fz_drop_context(ctx);
+    }
+
+    #[test]
+    fn test_render_pool_pins_workers_to_nodes() {
+        let ctx = unsafe { fz_new_context(std::ptr::null(), std::ptr::null(), 1024 * 1024) };
+        let doc = DOCUMENTS.insert(Document::new(b"%PDF-1.4\n/Type /Page\n%%EOF".to_vec()));
+        let pool = fz_new_render_pool_with_options(ctx, 3, FZ_RENDER_POOL_PIN_NODES);
+        assert_ne!(pool, 0);
+        let nodes = numa_nodes();
+        for i in 0..3 {
+            assert_eq!(
+                fz_render_pool_worker_node(ctx, pool, i),
+                nodes[i as usize % nodes.len()] as i32
+            );
+        }
+        assert_eq!(fz_render_pool_worker_node(ctx, pool, 3), -1);
+
+        let job =
+            fz_render_pool_submit(ctx, pool, doc, 0, thumbnail(), FZ_COLORSPACE_GRAY, 0, 0, 0);
+        let pix = fz_render_pool_wait(ctx, pool, job);
+        assert_ne!(pix, 0);
+        fz_drop_pixmap(ctx, pix);
+        fz_drop_render_pool(ctx, pool);
+
+        let unpinned = fz_new_render_pool(ctx, 1);
+        assert_eq!(fz_render_pool_worker_node(ctx, unpinned, 0), -1);
+        fz_drop_render_pool(ctx, unpinned);
+        DOCUMENTS.remove(doc);
+        fz_drop_context(ctx);
+    }
+}
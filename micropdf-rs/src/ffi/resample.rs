@@ -0,0 +1,665 @@
+//! Separable Image Resampling
+//!
+//! Pixmaps and decoded images are resampled in two passes, along rows then
+//! down columns, each output sample a weighted sum over a window of source
+//! samples. Windows and weights are computed once per axis; weights are
+//! 14-bit fixed point summing to exactly one, so the scalar and vector
+//! kernels give the same bytes.
+//!
+//! The column pass is the same sum for every byte of a row whatever the
+//! pixel layout, and runs 8 (AVX2, NEON) or 4 (SSE4.1) bytes at a time.
+//! The row pass is specialized per component count, with 4-component
+//! pixels (RGB with alpha, CMYK) summed a pixel per vector and two taps at
+//! once under AVX2. Kernels come from the kernel dispatch table.
+//!
+//! Samples are taken as premultiplied, so alpha needs no pass of its own;
+//! only Lanczos' negative lobes can push a colour past its alpha, and those
+//! are clamped.
+
+// Allow unsafe operations inside unsafe functions (Rust 2024 edition compat)
+#![allow(unsafe_op_in_unsafe_fn)]
+
+use super::dispatch::kernels;
+use super::simd_util::SimdLevel;
+
+/// Fraction bits of a weight
+const PRECISION: u32 = 14;
+
+/// A weight of one
+const ONE: i32 = 1 << PRECISION;
+
+/// Resampling filter
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Filter {
+    /// Average of the source samples an output sample covers
+    Box,
+    /// Triangle filter: linear interpolation, area-weighted when shrinking
+    Bilinear,
+    /// Windowed sinc over three lobes
+    Lanczos3,
+}
+
+impl Filter {
+    /// Half-width of the filter at unit scale
+    fn support(self) -> f64 {
+        match self {
+            Filter::Box => 0.5,
+            Filter::Bilinear => 1.0,
+            Filter::Lanczos3 => 3.0,
+        }
+    }
+
+    fn weight(self, x: f64) -> f64 {
+        match self {
+            Filter::Box if (-0.5..0.5).contains(&x) => 1.0,
+            Filter::Box => 0.0,
+            Filter::Bilinear => (1.0 - x.abs()).max(0.0),
+            Filter::Lanczos3 if x == 0.0 => 1.0,
+            Filter::Lanczos3 if x.abs() < 3.0 => {
+                let px = std::f64::consts::PI * x;
+                3.0 * px.sin() * (px / 3.0).sin() / (px * px)
+            }
+            Filter::Lanczos3 => 0.0,
+        }
+    }
+}
+
+/// Source windows and weights for one axis
+struct Taps {
+    /// First source index of each output index's window
+    starts: Vec<usize>,
+    /// Window length of each output index
+    lens: Vec<usize>,
+    /// Weights, `stride` per output index
+    weights: Vec<i16>,
+    stride: usize,
+}
+
+impl Taps {
+    /// Taps for resampling `in_len` samples to `out_len` with `filter`
+    fn new(in_len: usize, out_len: usize, filter: Filter) -> Self {
+        let scale = in_len as f64 / out_len as f64;
+        let filter_scale = scale.max(1.0);
+        let support = filter.support() * filter_scale;
+        let stride = (support.ceil() as usize * 2 + 1).min(in_len);
+        let mut taps = Self::with_capacity(out_len, stride);
+        let mut window = Vec::with_capacity(stride);
+        for i in 0..out_len {
+            let center = (i as f64 + 0.5) * scale;
+            let start = ((center - support + 0.5).floor().max(0.0) as usize).min(in_len - 1);
+            let end = ((center + support + 0.5).floor() as usize).clamp(start + 1, in_len);
+            window.clear();
+            window.extend(
+                (start..end).map(|j| filter.weight((j as f64 + 0.5 - center) / filter_scale)),
+            );
+            taps.push(start, &window);
+        }
+        taps
+    }
+
+    /// Taps averaging boxes of `factor` samples, the last one partial
+    fn boxes(in_len: usize, factor: usize) -> Self {
+        let out_len = in_len.div_ceil(factor);
+        let mut taps = Self::with_capacity(out_len, factor.min(in_len));
+        for i in 0..out_len {
+            let start = i * factor;
+            let len = factor.min(in_len - start);
+            taps.push(start, &vec![1.0; len]);
+        }
+        taps
+    }
+
+    fn with_capacity(out_len: usize, stride: usize) -> Self {
+        Self {
+            starts: Vec::with_capacity(out_len),
+            lens: Vec::with_capacity(out_len),
+            weights: Vec::with_capacity(out_len * stride),
+            stride,
+        }
+    }
+
+    /// Add a window at `start`, normalizing `window` to sum to one
+    fn push(&mut self, start: usize, window: &[f64]) {
+        // Trim zero weights off the ends
+        let first = window.iter().position(|&w| w != 0.0).unwrap_or(0);
+        let last = window.iter().rposition(|&w| w != 0.0).unwrap_or(0);
+        let window = &window[first..=last.max(first)];
+        let total: f64 = window.iter().sum();
+        let mut fixed: Vec<i32> = window
+            .iter()
+            .map(|&w| {
+                let w = if total == 0.0 {
+                    1.0 / window.len() as f64
+                } else {
+                    w / total
+                };
+                (w * f64::from(ONE)).round() as i32
+            })
+            .collect();
+        // Put the rounding error on the heaviest weight, so they sum to one
+        let heaviest = (0..fixed.len()).max_by_key(|&k| fixed[k]).unwrap_or(0);
+        fixed[heaviest] += ONE - fixed.iter().sum::<i32>();
+
+        let base = self.weights.len();
+        self.weights.resize(base + self.stride, 0);
+        for (slot, w) in self.weights[base..].iter_mut().zip(fixed) {
+            *slot = w as i16;
+        }
+        self.starts.push(start + first);
+        self.lens.push(window.len());
+    }
+
+    fn out_len(&self) -> usize {
+        self.starts.len()
+    }
+
+    /// First source index and weights of output index `i`
+    fn window(&self, i: usize) -> (usize, &[i16]) {
+        let base = i * self.stride;
+        (self.starts[i], &self.weights[base..base + self.lens[i]])
+    }
+}
+
+/// Kernel set to run
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub(super) enum Kernels {
+    Scalar,
+    #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+    Sse41,
+    #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+    Avx2,
+    #[cfg(target_arch = "aarch64")]
+    Neon,
+}
+
+impl Kernels {
+    /// Kernels the dispatch table uses at `level`
+    pub(super) fn for_level(level: SimdLevel) -> Self {
+        match level {
+            #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+            SimdLevel::Avx2 => Kernels::Avx2,
+            #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+            SimdLevel::Sse41 | SimdLevel::Avx => Kernels::Sse41,
+            #[cfg(target_arch = "aarch64")]
+            SimdLevel::Neon => Kernels::Neon,
+            _ => Kernels::Scalar,
+        }
+    }
+}
+
+#[inline]
+fn clamp8(acc: i32) -> u8 {
+    ((acc + ONE / 2) >> PRECISION).clamp(0, 255) as u8
+}
+
+// ============================================================================
+// Row Pass
+// ============================================================================
+
+/// Resample each of the `h` rows of `w` `n`-component pixels in `src` by
+/// `taps`
+fn resample_rows(
+    src: &[u8],
+    w: usize,
+    h: usize,
+    n: usize,
+    taps: &Taps,
+    kernels: Kernels,
+) -> Vec<u8> {
+    let in_row = w * n;
+    let out_row = taps.out_len() * n;
+    let mut out = vec![0u8; out_row * h];
+    let rows = src[..in_row * h]
+        .chunks_exact(in_row)
+        .zip(out.chunks_exact_mut(out_row));
+    for (row, dst) in rows {
+        match (n, kernels) {
+            #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+            (4, Kernels::Avx2) => unsafe { row4_avx2(row, dst, taps) },
+            #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+            (4, Kernels::Sse41) => unsafe { row4_sse41(row, dst, taps) },
+            #[cfg(target_arch = "aarch64")]
+            (4, Kernels::Neon) => unsafe { row4_neon(row, dst, taps) },
+            (1, _) => row_scalar::<1>(row, dst, taps),
+            (2, _) => row_scalar::<2>(row, dst, taps),
+            (3, _) => row_scalar::<3>(row, dst, taps),
+            (4, _) => row_scalar::<4>(row, dst, taps),
+            _ => row_any(row, dst, n, taps),
+        }
+    }
+    out
+}
+
+fn row_scalar<const N: usize>(row: &[u8], dst: &mut [u8], taps: &Taps) {
+    for (x, px) in dst.chunks_exact_mut(N).enumerate() {
+        let (start, weights) = taps.window(x);
+        let mut acc = [0i32; N];
+        let src = row[start * N..].chunks_exact(N);
+        for (&w, s) in weights.iter().zip(src) {
+            for c in 0..N {
+                acc[c] += i32::from(w) * i32::from(s[c]);
+            }
+        }
+        for c in 0..N {
+            px[c] = clamp8(acc[c]);
+        }
+    }
+}
+
+fn row_any(row: &[u8], dst: &mut [u8], n: usize, taps: &Taps) {
+    let mut acc = vec![0i32; n];
+    for (x, px) in dst.chunks_exact_mut(n).enumerate() {
+        let (start, weights) = taps.window(x);
+        acc.fill(0);
+        for (&w, s) in weights.iter().zip(row[start * n..].chunks_exact(n)) {
+            for (a, &v) in acc.iter_mut().zip(s) {
+                *a += i32::from(w) * i32::from(v);
+            }
+        }
+        for (p, &a) in px.iter_mut().zip(&acc) {
+            *p = clamp8(a);
+        }
+    }
+}
+
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "sse4.1")]
+unsafe fn row4_sse41(row: &[u8], dst: &mut [u8], taps: &Taps) {
+    #[cfg(target_arch = "x86")]
+    use std::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use std::arch::x86_64::*;
+
+    for (x, px) in dst.chunks_exact_mut(4).enumerate() {
+        let (start, weights) = taps.window(x);
+        let src = row.as_ptr().add(start * 4);
+        let mut acc = _mm_set1_epi32(ONE / 2);
+        for (k, &w) in weights.iter().enumerate() {
+            let p = (src.add(k * 4) as *const i32).read_unaligned();
+            let p = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(p));
+            acc = _mm_add_epi32(acc, _mm_mullo_epi32(p, _mm_set1_epi32(i32::from(w))));
+        }
+        let acc = _mm_srai_epi32(acc, PRECISION as i32);
+        let packed = _mm_packus_epi16(_mm_packs_epi32(acc, acc), _mm_setzero_si128());
+        (px.as_mut_ptr() as *mut i32).write_unaligned(_mm_cvtsi128_si32(packed));
+    }
+}
+
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "avx2")]
+unsafe fn row4_avx2(row: &[u8], dst: &mut [u8], taps: &Taps) {
+    #[cfg(target_arch = "x86")]
+    use std::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use std::arch::x86_64::*;
+
+    for (x, px) in dst.chunks_exact_mut(4).enumerate() {
+        let (start, weights) = taps.window(x);
+        let src = row.as_ptr().add(start * 4);
+        // Two pixels per step, one in each half
+        let mut acc = _mm256_setzero_si256();
+        let pairs = weights.len() / 2;
+        for k in 0..pairs {
+            let p = _mm_loadl_epi64(src.add(k * 8) as *const __m128i);
+            let w = _mm256_setr_epi32(
+                i32::from(weights[2 * k]),
+                i32::from(weights[2 * k]),
+                i32::from(weights[2 * k]),
+                i32::from(weights[2 * k]),
+                i32::from(weights[2 * k + 1]),
+                i32::from(weights[2 * k + 1]),
+                i32::from(weights[2 * k + 1]),
+                i32::from(weights[2 * k + 1]),
+            );
+            acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(_mm256_cvtepu8_epi32(p), w));
+        }
+        let mut sum = _mm_add_epi32(
+            _mm256_castsi256_si128(acc),
+            _mm256_extracti128_si256::<1>(acc),
+        );
+        if weights.len() % 2 == 1 {
+            let k = weights.len() - 1;
+            let p = (src.add(k * 4) as *const i32).read_unaligned();
+            let p = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(p));
+            let w = _mm_set1_epi32(i32::from(weights[k]));
+            sum = _mm_add_epi32(sum, _mm_mullo_epi32(p, w));
+        }
+        let sum = _mm_srai_epi32(
+            _mm_add_epi32(sum, _mm_set1_epi32(ONE / 2)),
+            PRECISION as i32,
+        );
+        let packed = _mm_packus_epi16(_mm_packs_epi32(sum, sum), _mm_setzero_si128());
+        (px.as_mut_ptr() as *mut i32).write_unaligned(_mm_cvtsi128_si32(packed));
+    }
+}
+
+#[cfg(target_arch = "aarch64")]
+#[target_feature(enable = "neon")]
+unsafe fn row4_neon(row: &[u8], dst: &mut [u8], taps: &Taps) {
+    use std::arch::aarch64::*;
+
+    for (x, px) in dst.chunks_exact_mut(4).enumerate() {
+        let (start, weights) = taps.window(x);
+        let src = row.as_ptr().add(start * 4);
+        let mut acc = vdupq_n_s32(0);
+        for (k, &w) in weights.iter().enumerate() {
+            let p = (src.add(k * 4) as *const u32).read_unaligned();
+            let p = vreinterpretq_s16_u16(vmovl_u8(vcreate_u8(u64::from(p))));
+            acc = vmlal_n_s16(acc, vget_low_s16(p), w);
+        }
+        let narrow = vqrshrn_n_s32::<14>(acc);
+        let packed = vqmovun_s16(vcombine_s16(narrow, narrow));
+        let packed = vget_lane_u32::<0>(vreinterpret_u32_u8(packed));
+        (px.as_mut_ptr() as *mut u32).write_unaligned(packed);
+    }
+}
+
+// ============================================================================
+// Column Pass
+// ============================================================================
+
+/// Resample the rows of `row_len` bytes in `src` down their columns by `taps`
+fn resample_columns(src: &[u8], row_len: usize, taps: &Taps, kernels: Kernels) -> Vec<u8> {
+    let mut out = vec![0u8; row_len * taps.out_len()];
+    let mut acc = vec![0i32; row_len];
+    for (y, dst) in out.chunks_exact_mut(row_len.max(1)).enumerate() {
+        let (start, weights) = taps.window(y);
+        let rows = &src[start * row_len..(start + weights.len()) * row_len];
+        let done = match kernels {
+            #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+            Kernels::Avx2 => unsafe { column_avx2(rows, dst, weights) },
+            #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+            Kernels::Sse41 => unsafe { column_sse41(rows, dst, weights) },
+            #[cfg(target_arch = "aarch64")]
+            Kernels::Neon => unsafe { column_neon(rows, dst, weights) },
+            Kernels::Scalar => 0,
+        };
+        column_scalar(rows, &mut dst[done..], done, weights, &mut acc);
+    }
+    out
+}
+
+/// Sum columns `from..` of `rows` into `dst`
+fn column_scalar(rows: &[u8], dst: &mut [u8], from: usize, weights: &[i16], acc: &mut [i32]) {
+    let row_len = rows.len() / weights.len();
+    let acc = &mut acc[..dst.len()];
+    acc.fill(0);
+    for (&w, row) in weights.iter().zip(rows.chunks_exact(row_len)) {
+        for (a, &v) in acc.iter_mut().zip(&row[from..]) {
+            *a += i32::from(w) * i32::from(v);
+        }
+    }
+    for (d, &a) in dst.iter_mut().zip(acc.iter()) {
+        *d = clamp8(a);
+    }
+}
+
+/// Sum whole 4-byte groups of columns; returns how many bytes were done
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "sse4.1")]
+unsafe fn column_sse41(rows: &[u8], dst: &mut [u8], weights: &[i16]) -> usize {
+    #[cfg(target_arch = "x86")]
+    use std::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use std::arch::x86_64::*;
+
+    let row_len = dst.len();
+    let done = row_len / 4 * 4;
+    for x in (0..done).step_by(4) {
+        let mut acc = _mm_set1_epi32(ONE / 2);
+        for (k, &w) in weights.iter().enumerate() {
+            let p = (rows.as_ptr().add(k * row_len + x) as *const i32).read_unaligned();
+            let p = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(p));
+            acc = _mm_add_epi32(acc, _mm_mullo_epi32(p, _mm_set1_epi32(i32::from(w))));
+        }
+        let acc = _mm_srai_epi32(acc, PRECISION as i32);
+        let packed = _mm_packus_epi16(_mm_packs_epi32(acc, acc), _mm_setzero_si128());
+        (dst.as_mut_ptr().add(x) as *mut i32).write_unaligned(_mm_cvtsi128_si32(packed));
+    }
+    done
+}
+
+/// Sum whole 8-byte groups of columns; returns how many bytes were done
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "avx2")]
+unsafe fn column_avx2(rows: &[u8], dst: &mut [u8], weights: &[i16]) -> usize {
+    #[cfg(target_arch = "x86")]
+    use std::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use std::arch::x86_64::*;
+
+    let row_len = dst.len();
+    let done = row_len / 8 * 8;
+    for x in (0..done).step_by(8) {
+        let mut acc = _mm256_set1_epi32(ONE / 2);
+        for (k, &w) in weights.iter().enumerate() {
+            let p = _mm_loadl_epi64(rows.as_ptr().add(k * row_len + x) as *const __m128i);
+            let p = _mm256_cvtepu8_epi32(p);
+            acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(p, _mm256_set1_epi32(i32::from(w))));
+        }
+        let acc = _mm256_srai_epi32(acc, PRECISION as i32);
+        let words = _mm_packs_epi32(
+            _mm256_castsi256_si128(acc),
+            _mm256_extracti128_si256::<1>(acc),
+        );
+        let packed = _mm_packus_epi16(words, words);
+        _mm_storel_epi64(dst.as_mut_ptr().add(x) as *mut __m128i, packed);
+    }
+    done
+}
+
+/// Sum whole 8-byte groups of columns; returns how many bytes were done
+#[cfg(target_arch = "aarch64")]
+#[target_feature(enable = "neon")]
+unsafe fn column_neon(rows: &[u8], dst: &mut [u8], weights: &[i16]) -> usize {
+    use std::arch::aarch64::*;
+
+    let row_len = dst.len();
+    let done = row_len / 8 * 8;
+    for x in (0..done).step_by(8) {
+        let mut lo = vdupq_n_s32(0);
+        let mut hi = vdupq_n_s32(0);
+        for (k, &w) in weights.iter().enumerate() {
+            let p = vld1_u8(rows.as_ptr().add(k * row_len + x));
+            let p = vreinterpretq_s16_u16(vmovl_u8(p));
+            lo = vmlal_n_s16(lo, vget_low_s16(p), w);
+            hi = vmlal_high_n_s16(hi, p, w);
+        }
+        let words = vcombine_s16(vqrshrn_n_s32::<14>(lo), vqrshrn_n_s32::<14>(hi));
+        vst1_u8(dst.as_mut_ptr().add(x), vqmovun_s16(words));
+    }
+    done
+}
+
+// ============================================================================
+// Resampling
+// ============================================================================
+
+fn run(
+    src: &[u8],
+    w: usize,
+    h: usize,
+    n: usize,
+    columns: Option<&Taps>,
+    rows: Option<&Taps>,
+    kernels: Kernels,
+) -> Vec<u8> {
+    let pixels = match columns {
+        Some(taps) => resample_rows(src, w, h, n, taps, kernels),
+        None => src[..w * h * n].to_vec(),
+    };
+    let out_w = columns.map_or(w, Taps::out_len);
+    match rows {
+        Some(taps) => resample_columns(&pixels, out_w * n, taps, kernels),
+        None => pixels,
+    }
+}
+
+/// Clamp each colour to its pixel's alpha, the last of `n` components
+fn clamp_to_alpha(pixels: &mut [u8], n: usize) {
+    for px in pixels.chunks_exact_mut(n) {
+        let (colour, alpha) = px.split_at_mut(n - 1);
+        colour.iter_mut().for_each(|c| *c = (*c).min(alpha[0]));
+    }
+}
+
+fn resample_with(
+    src: &[u8],
+    size: (usize, usize),
+    n: usize,
+    out: (usize, usize),
+    filter: Filter,
+    alpha: bool,
+    kernels: Kernels,
+) -> Vec<u8> {
+    let ((w, h), (out_w, out_h)) = (size, out);
+    if w == 0 || h == 0 || out_w == 0 || out_h == 0 || n == 0 {
+        return vec![0; out_w * out_h * n];
+    }
+    let columns = (out_w != w).then(|| Taps::new(w, out_w, filter));
+    let rows = (out_h != h).then(|| Taps::new(h, out_h, filter));
+    let mut pixels = run(src, w, h, n, columns.as_ref(), rows.as_ref(), kernels);
+    if alpha && n > 1 && filter == Filter::Lanczos3 {
+        clamp_to_alpha(&mut pixels, n);
+    }
+    pixels
+}
+
+/// Resample `w` x `h` pixels of `n` components (the last alpha if `alpha`)
+/// to `out_w` x `out_h` with `filter`
+#[allow(clippy::too_many_arguments)]
+pub fn resample(
+    src: &[u8],
+    w: usize,
+    h: usize,
+    n: usize,
+    out_w: usize,
+    out_h: usize,
+    filter: Filter,
+    alpha: bool,
+) -> Vec<u8> {
+    resample_with(
+        src,
+        (w, h),
+        n,
+        (out_w, out_h),
+        filter,
+        alpha,
+        kernels().resample,
+    )
+}
+
+/// `w` x `h` pixels of `n` components averaged over boxes of `f` x `f`,
+/// partial at the right and bottom edges, with the new size
+pub fn subsample(src: &[u8], w: usize, h: usize, n: usize, f: usize) -> (Vec<u8>, usize, usize) {
+    subsample_with(src, w, h, n, f, kernels().resample)
+}
+
+fn subsample_with(
+    src: &[u8],
+    w: usize,
+    h: usize,
+    n: usize,
+    f: usize,
+    kernels: Kernels,
+) -> (Vec<u8>, usize, usize) {
+    let f = f.max(1);
+    if w == 0 || h == 0 || n == 0 || f == 1 {
+        return (src[..w * h * n].to_vec(), w, h);
+    }
+    let columns = Taps::boxes(w, f);
+    let rows = Taps::boxes(h, f);
+    let pixels = run(src, w, h, n, Some(&columns), Some(&rows), kernels);
+    (pixels, columns.out_len(), rows.out_len())
+}
+
+#[cfg(test)]
+mod tests {
+    use super::super::simd_util::fz_simd_features;
+    use super::*;
+
+    fn available() -> Vec<Kernels> {
+        let mut kernels = vec![Kernels::Scalar];
+        let best = Kernels::for_level(fz_simd_features().best_level());
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        {
+            if matches!(best, Kernels::Sse41 | Kernels::Avx2) {
+                kernels.push(Kernels::Sse41);
+            }
+        }
+        if best != Kernels::Scalar && !kernels.contains(&best) {
+            kernels.push(best);
+        }
+        kernels
+    }
+
+    fn pattern(w: usize, h: usize, n: usize) -> Vec<u8> {
+        (0..w * h * n).map(|i| (i * 37 % 251) as u8).collect()
+    }
+
+    #[test]
+    fn test_taps_sum_to_one() {
+        for (in_len, out_len, filter) in [
+            (100, 7, Filter::Box),
+            (7, 100, Filter::Bilinear),
+            (33, 10, Filter::Lanczos3),
+            (3, 1, Filter::Lanczos3),
+        ] {
+            let taps = Taps::new(in_len, out_len, filter);
+            for i in 0..out_len {
+                let (start, weights) = taps.window(i);
+                assert!(start + weights.len() <= in_len);
+                assert_eq!(weights.iter().map(|&w| i32::from(w)).sum::<i32>(), ONE);
+            }
+        }
+    }
+
+    #[test]
+    fn test_kernels_agree_with_scalar() {
+        for n in [1, 2, 3, 4, 5] {
+            let (w, h) = (37, 23);
+            let src = pattern(w, h, n);
+            for filter in [Filter::Box, Filter::Bilinear, Filter::Lanczos3] {
+                for out in [(11, 9), (80, 50), (37, 5)] {
+                    let expected =
+                        resample_with(&src, (w, h), n, out, filter, false, Kernels::Scalar);
+                    for kernels in available() {
+                        let got = resample_with(&src, (w, h), n, out, filter, false, kernels);
+                        assert_eq!(got, expected, "{n} components, {filter:?}, {kernels:?}");
+                    }
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn test_flat_image_stays_flat() {
+        let src = [200u8, 100, 50, 255].repeat(16 * 16);
+        for filter in [Filter::Box, Filter::Bilinear, Filter::Lanczos3] {
+            let out = resample(&src, 16, 16, 4, 5, 29, filter, true);
+            assert!(out.chunks_exact(4).all(|px| px == [200, 100, 50, 255]));
+        }
+    }
+
+    #[test]
+    fn test_lanczos_colour_stays_under_alpha() {
+        // A hard edge from opaque white to transparent rings under Lanczos
+        let mut src = Vec::new();
+        for x in 0..16 {
+            src.extend_from_slice(if x < 8 { &[255, 255] } else { &[0, 0] });
+        }
+        let out = resample(&src, 16, 1, 2, 40, 1, Filter::Lanczos3, true);
+        assert!(out.chunks_exact(2).all(|px| px[0] <= px[1]));
+    }
+
+    #[test]
+    fn test_subsample_partial_boxes() {
+        let src = [10, 20, 90, 30, 40, 110];
+        for kernels in available() {
+            assert_eq!(
+                subsample_with(&src, 3, 2, 1, 2, kernels),
+                (vec![25, 100], 2, 1)
+            );
+        }
+    }
+}
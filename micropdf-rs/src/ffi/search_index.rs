@@ -0,0 +1,617 @@
+//! Document search index - find every hit in a whole document at once
+//!
+//! `fz_search_stext_page` rescans one page's text per query, which is fine
+//! for a page but slow for "find all" in a 2000-page manual. The index
+//! keeps the text of every page in one contiguous array of code points
+//! with a case-folded copy beside it and one quad per character. A
+//! trigram posting list over the folded text turns a query into a walk
+//! over the positions of its rarest trigram. Pages can be added one at a
+//! time, so an index grows alongside incremental extraction.
+//!
+//! Indexes can be saved to a versioned file tagged with the SHA-256 of the
+//! document bytes. `fz_open_search_index` reuses a file that matches the
+//! document and rebuilds (and rewrites) one that does not, so the
+//! extraction cost is paid once per document rather than once per process.
+//!
+//! File layout (little-endian): `MPSI`, version, 8 reserved bytes and the
+//! 32-byte document hash; then the page count and one (page number, first
+//! character) pair per page; then the character count, the code points and
+//! one 8-float quad per character. Trigrams are rebuilt on load.
+
+use std::collections::HashMap;
+use std::ffi::{CStr, c_char};
+use std::io::Write;
+use std::path::Path;
+use std::sync::LazyLock;
+
+use sha2::{Digest, Sha256};
+
+use super::document::{fz_count_pages, fz_drop_page, fz_load_page};
+use super::stext::{
+    FzQuad, Quad, STEXT_PAGES, SearchOption, StextBlockType, StextPage, fz_drop_stext_page,
+    fz_new_stext_page_from_page,
+};
+use super::string_util::fold_char;
+use super::{DOCUMENTS, Handle, HandleStore};
+
+/// File magic
+const MAGIC: &[u8; 4] = b"MPSI";
+
+/// Current file format version
+pub const SEARCH_INDEX_FILE_VERSION: u32 = 1;
+
+/// File header size: magic, version, reserved bytes and document hash
+const FILE_HEADER_LEN: usize = 48;
+
+/// Ends every line, so no hit spans two lines or two pages
+const SEPARATOR: u32 = '\n' as u32;
+
+/// Search index over the text of some or all pages of a document
+#[derive(Debug, Clone, Default)]
+pub struct SearchIndex {
+    /// SHA-256 of the document bytes, or zero for a hand-built index
+    doc_hash: [u8; 32],
+    chars: Vec<u32>,
+    /// `chars` with each code point case-folded
+    folded: Vec<u32>,
+    quads: Vec<Quad>,
+    /// (page number, index of its first character), in insertion order
+    pages: Vec<(i32, u32)>,
+    /// Start positions of each folded trigram, ascending
+    trigrams: HashMap<[u32; 3], Vec<u32>>,
+}
+
+impl SearchIndex {
+    pub fn new() -> Self {
+        Self::default()
+    }
+
+    /// Number of pages indexed
+    pub fn page_count(&self) -> usize {
+        self.pages.len()
+    }
+
+    /// Append the text of one page
+    ///
+    /// Returns false if the page is already indexed.
+    pub fn add_page(&mut self, page_number: i32, page: &StextPage) -> bool {
+        if self.pages.iter().any(|&(p, _)| p == page_number) {
+            return false;
+        }
+        let start = self.chars.len();
+        self.pages.push((page_number, start as u32));
+        for block in &page.blocks {
+            if block.block_type != StextBlockType::Text {
+                continue;
+            }
+            for line in &block.lines {
+                for ch in &line.chars {
+                    self.push(ch.c as u32, ch.quad);
+                }
+                self.push(SEPARATOR, Quad::default());
+            }
+        }
+        self.index_trigrams(start);
+        true
+    }
+
+    fn push(&mut self, c: u32, quad: Quad) {
+        self.chars.push(c);
+        self.folded.push(fold_char(c));
+        self.quads.push(quad);
+    }
+
+    /// Post the trigrams starting at `from` or later; none contain a separator
+    fn index_trigrams(&mut self, from: usize) {
+        for (i, w) in self.folded.windows(3).enumerate().skip(from) {
+            if w.contains(&SEPARATOR) {
+                continue;
+            }
+            self.trigrams
+                .entry([w[0], w[1], w[2]])
+                .or_default()
+                .push(i as u32);
+        }
+    }
+
+    fn page_of(&self, pos: usize) -> i32 {
+        let i = self
+            .pages
+            .partition_point(|&(_, start)| start as usize <= pos);
+        self.pages[i.saturating_sub(1)].0
+    }
+
+    fn hit_quad(&self, start: usize, len: usize) -> FzQuad {
+        let first = &self.quads[start];
+        let last = &self.quads[start + len - 1];
+        FzQuad {
+            ul: [first.ul_x, first.ul_y],
+            ur: [last.ur_x, last.ur_y],
+            ll: [first.ll_x, first.ll_y],
+            lr: [last.lr_x, last.lr_y],
+        }
+    }
+
+    /// Find every occurrence of `needle`, in document order
+    ///
+    /// `hit` receives the page number and the quad covering each hit.
+    /// Returns the number of hits.
+    pub fn search(
+        &self,
+        needle: &str,
+        ignore_case: bool,
+        mut hit: impl FnMut(i32, FzQuad),
+    ) -> usize {
+        let exact: Vec<u32> = needle.chars().map(|c| c as u32).collect();
+        if exact.is_empty() || exact.contains(&SEPARATOR) {
+            return 0;
+        }
+        let folded: Vec<u32> = exact.iter().map(|&c| fold_char(c)).collect();
+        let n = exact.len();
+        let matches = |start: usize| {
+            let Some(end) = start.checked_add(n).filter(|&end| end <= self.chars.len()) else {
+                return false;
+            };
+            if ignore_case {
+                self.folded[start..end] == folded[..]
+            } else {
+                self.chars[start..end] == exact[..]
+            }
+        };
+
+        let mut count = 0;
+        let mut report = |start: usize| {
+            count += 1;
+            hit(self.page_of(start), self.hit_quad(start, n));
+        };
+
+        if n < 3 {
+            for start in 0..self.chars.len() {
+                if matches(start) {
+                    report(start);
+                }
+            }
+            return count;
+        }
+
+        // Candidates come from the rarest trigram; a missing one means no hits
+        let mut rarest: Option<(usize, &Vec<u32>)> = None;
+        for offset in 0..=n - 3 {
+            let key = [folded[offset], folded[offset + 1], folded[offset + 2]];
+            let Some(list) = self.trigrams.get(&key) else {
+                return 0;
+            };
+            if rarest.is_none_or(|(_, best)| list.len() < best.len()) {
+                rarest = Some((offset, list));
+            }
+        }
+        if let Some((offset, list)) = rarest {
+            for &pos in list {
+                let pos = pos as usize;
+                if pos >= offset && matches(pos - offset) {
+                    report(pos - offset);
+                }
+            }
+        }
+        count
+    }
+
+    fn encode(&self) -> Vec<u8> {
+        let mut out =
+            Vec::with_capacity(FILE_HEADER_LEN + 8 + self.pages.len() * 8 + self.chars.len() * 36);
+        out.extend_from_slice(MAGIC);
+        out.extend_from_slice(&SEARCH_INDEX_FILE_VERSION.to_le_bytes());
+        out.extend_from_slice(&[0; 8]);
+        out.extend_from_slice(&self.doc_hash);
+        out.extend_from_slice(&(self.pages.len() as u32).to_le_bytes());
+        for &(page, start) in &self.pages {
+            out.extend_from_slice(&page.to_le_bytes());
+            out.extend_from_slice(&start.to_le_bytes());
+        }
+        out.extend_from_slice(&(self.chars.len() as u32).to_le_bytes());
+        for &c in &self.chars {
+            out.extend_from_slice(&c.to_le_bytes());
+        }
+        for q in &self.quads {
+            for v in [
+                q.ul_x, q.ul_y, q.ur_x, q.ur_y, q.ll_x, q.ll_y, q.lr_x, q.lr_y,
+            ] {
+                out.extend_from_slice(&v.to_le_bytes());
+            }
+        }
+        out
+    }
+
+    fn decode(bytes: &[u8]) -> Option<Self> {
+        if bytes.len() < FILE_HEADER_LEN
+            || &bytes[..4] != MAGIC
+            || bytes[4..8] != SEARCH_INDEX_FILE_VERSION.to_le_bytes()
+        {
+            return None;
+        }
+        let mut at = FILE_HEADER_LEN;
+        let mut u32_next = || {
+            let v = u32::from_le_bytes(bytes.get(at..at + 4)?.try_into().ok()?);
+            at += 4;
+            Some(v)
+        };
+
+        let mut index = SearchIndex {
+            doc_hash: (&bytes[16..48]).try_into().ok()?,
+            ..Self::default()
+        };
+        let page_count = u32_next()? as usize;
+        for _ in 0..page_count {
+            let page = u32_next()? as i32;
+            let start = u32_next()?;
+            index.pages.push((page, start));
+        }
+        let char_count = u32_next()? as usize;
+        for _ in 0..char_count {
+            let c = u32_next()?;
+            index.chars.push(c);
+            index.folded.push(fold_char(c));
+        }
+        for _ in 0..char_count {
+            let mut v = [0f32; 8];
+            for x in &mut v {
+                *x = f32::from_bits(u32_next()?);
+            }
+            index.quads.push(Quad {
+                ul_x: v[0],
+                ul_y: v[1],
+                ur_x: v[2],
+                ur_y: v[3],
+                ll_x: v[4],
+                ll_y: v[5],
+                lr_x: v[6],
+                lr_y: v[7],
+            });
+        }
+        if index
+            .pages
+            .iter()
+            .any(|&(_, start)| start as usize > char_count)
+        {
+            return None;
+        }
+        index.index_trigrams(0);
+        Some(index)
+    }
+
+    /// Write the index to `path` through a temporary file and a rename
+    pub fn save(&self, path: &Path) -> std::io::Result<()> {
+        let tmp = path.with_extension(format!("tmp{}", std::process::id()));
+        let mut file = std::fs::File::create(&tmp)?;
+        file.write_all(&self.encode())?;
+        file.sync_data()?;
+        drop(file);
+        std::fs::rename(&tmp, path)
+    }
+
+    /// Read an index file; None if it is missing, truncated or another version
+    pub fn load(path: &Path) -> Option<Self> {
+        Self::decode(&std::fs::read(path).ok()?)
+    }
+}
+
+fn document_hash(doc: Handle) -> Option<[u8; 32]> {
+    let doc = DOCUMENTS.get(doc)?;
+    let data = doc.lock().ok()?.data();
+    Some(Sha256::digest(&data[..]).into())
+}
+
+fn build_from_document(ctx: Handle, doc: Handle) -> Option<SearchIndex> {
+    let mut index = SearchIndex {
+        doc_hash: document_hash(doc)?,
+        ..SearchIndex::default()
+    };
+    for n in 0..fz_count_pages(ctx, doc) {
+        let page = fz_load_page(ctx, doc, n);
+        if page == 0 {
+            continue;
+        }
+        let stext = fz_new_stext_page_from_page(ctx, page, std::ptr::null());
+        fz_drop_page(ctx, page);
+        if let Some(p) = STEXT_PAGES.get(stext) {
+            if let Ok(p) = p.lock() {
+                index.add_page(n, &p);
+            }
+        }
+        fz_drop_stext_page(ctx, stext);
+    }
+    Some(index)
+}
+
+fn path_arg<'a>(path: *const c_char) -> Option<&'a Path> {
+    if path.is_null() {
+        return None;
+    }
+    // SAFETY: the caller passes a NUL-terminated path
+    let s = unsafe { CStr::from_ptr(path) }.to_str().ok()?;
+    Some(Path::new(s))
+}
+
+// ============================================================================
+// Handle Store
+// ============================================================================
+
+pub static SEARCH_INDEXES: LazyLock<HandleStore<SearchIndex>> = LazyLock::new(HandleStore::new);
+
+// ============================================================================
+// FFI Functions
+// ============================================================================
+
+/// Create an empty search index, to be filled with `fz_search_index_add_page`
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_search_index(_ctx: Handle) -> Handle {
+    SEARCH_INDEXES.insert(SearchIndex::new())
+}
+
+/// Index the text of every page of a document
+///
+/// # Returns
+/// Search index handle, or 0 if the document handle is invalid
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_search_index_from_document(ctx: Handle, doc: Handle) -> Handle {
+    match build_from_document(ctx, doc) {
+        Some(index) => SEARCH_INDEXES.insert(index),
+        None => 0,
+    }
+}
+
+/// Open the saved index of a document, building and saving it if needed
+///
+/// The file at `path` is used when it was saved for the same document
+/// bytes. Otherwise the index is rebuilt from the document and written
+/// back to `path`; a failed write still returns the fresh index.
+///
+/// # Returns
+/// Search index handle, or 0 if the document handle or path is invalid
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_open_search_index(ctx: Handle, doc: Handle, path: *const c_char) -> Handle {
+    let (Some(path), Some(hash)) = (path_arg(path), document_hash(doc)) else {
+        return 0;
+    };
+    if let Some(index) = SearchIndex::load(path).filter(|index| index.doc_hash == hash) {
+        return SEARCH_INDEXES.insert(index);
+    }
+    let Some(index) = build_from_document(ctx, doc) else {
+        return 0;
+    };
+    let _ = index.save(path);
+    SEARCH_INDEXES.insert(index)
+}
+
+/// Drop a search index
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_drop_search_index(_ctx: Handle, index: Handle) {
+    SEARCH_INDEXES.remove(index);
+}
+
+/// Add one page's structured text to an index
+///
+/// # Returns
+/// 0 on success, -1 if a handle is invalid or the page is already indexed
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_search_index_add_page(
+    _ctx: Handle,
+    index: Handle,
+    page_number: i32,
+    stext: Handle,
+) -> i32 {
+    let (Some(index), Some(page)) = (SEARCH_INDEXES.get(index), STEXT_PAGES.get(stext)) else {
+        return -1;
+    };
+    let (Ok(mut index), Ok(page)) = (index.lock(), page.lock()) else {
+        return -1;
+    };
+    if index.add_page(page_number, &page) {
+        0
+    } else {
+        -1
+    }
+}
+
+/// Number of pages in an index
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_search_index_page_count(_ctx: Handle, index: Handle) -> i32 {
+    SEARCH_INDEXES
+        .get(index)
+        .and_then(|i| i.lock().ok().map(|i| i.page_count() as i32))
+        .unwrap_or(0)
+}
+
+/// Save an index to a file
+///
+/// # Returns
+/// 0 on success, -1 on failure
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_save_search_index(_ctx: Handle, index: Handle, path: *const c_char) -> i32 {
+    let (Some(index), Some(path)) = (SEARCH_INDEXES.get(index), path_arg(path)) else {
+        return -1;
+    };
+    let Ok(index) = index.lock() else {
+        return -1;
+    };
+    if index.save(path).is_ok() { 0 } else { -1 }
+}
+
+/// Load an index saved with `fz_save_search_index`
+///
+/// # Returns
+/// Search index handle, or 0 if the file is missing or invalid
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_load_search_index(_ctx: Handle, path: *const c_char) -> Handle {
+    match path_arg(path).and_then(SearchIndex::load) {
+        Some(index) => SEARCH_INDEXES.insert(index),
+        None => 0,
+    }
+}
+
+/// Find every occurrence of a string in an indexed document
+///
+/// Hits come in document order and never span lines. The first `hit_max`
+/// hits are written to `hit_pages` (page numbers) and `hit_quads` (one quad
+/// per hit); either may be null.
+///
+/// # Arguments
+/// * `options` - `SearchOption::IgnoreCase` for a case-insensitive search
+///
+/// # Returns
+/// Total number of hits, which may exceed `hit_max`
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_search_index_search(
+    _ctx: Handle,
+    index: Handle,
+    needle: *const c_char,
+    options: i32,
+    hit_pages: *mut i32,
+    hit_quads: *mut FzQuad,
+    hit_max: i32,
+) -> i32 {
+    if needle.is_null() {
+        return 0;
+    }
+    // SAFETY: the caller passes a NUL-terminated string
+    let Ok(needle) = unsafe { CStr::from_ptr(needle) }.to_str() else {
+        return 0;
+    };
+    let Some(index) = SEARCH_INDEXES.get(index) else {
+        return 0;
+    };
+    let Ok(index) = index.lock() else {
+        return 0;
+    };
+
+    let ignore_case = options & SearchOption::IgnoreCase as i32 != 0;
+    let max = hit_max.max(0) as usize;
+    let mut written = 0;
+    let total = index.search(needle, ignore_case, |page, quad| {
+        if written < max {
+            // SAFETY: the caller provides `hit_max` writable entries
+            unsafe {
+                if !hit_pages.is_null() {
+                    *hit_pages.add(written) = page;
+                }
+                if !hit_quads.is_null() {
+                    *hit_quads.add(written) = quad;
+                }
+            }
+            written += 1;
+        }
+    });
+    total.min(i32::MAX as usize) as i32
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::stext::{
+        fz_add_stext_block, fz_add_stext_char, fz_add_stext_line, fz_new_stext_page,
+    };
+
+    fn stext_with_lines(lines: &[&str]) -> Handle {
+        let page = fz_new_stext_page(0, 0.0, 0.0, 612.0, 792.0);
+        let block = fz_add_stext_block(0, page, 0.0, 0.0, 612.0, 792.0);
+        for (l, text) in lines.iter().enumerate() {
+            let y = 100.0 + l as f32 * 20.0;
+            let line = fz_add_stext_line(0, page, block, 0.0, y - 10.0, 612.0, y);
+            for (i, c) in text.chars().enumerate() {
+                fz_add_stext_char(
+                    0,
+                    page,
+                    block,
+                    line,
+                    c as i32,
+                    10.0 + i as f32 * 6.0,
+                    y,
+                    10.0,
+                );
+            }
+        }
+        page
+    }
+
+    fn index_of(pages: &[&[&str]]) -> Handle {
+        let index = fz_new_search_index(0);
+        for (n, lines) in pages.iter().enumerate() {
+            let stext = stext_with_lines(lines);
+            assert_eq!(fz_search_index_add_page(0, index, n as i32, stext), 0);
+            fz_drop_stext_page(0, stext);
+        }
+        index
+    }
+
+    fn search(index: Handle, needle: &CStr, options: i32) -> (i32, Vec<i32>, Vec<FzQuad>) {
+        let mut pages = vec![0; 8];
+        let mut quads = vec![FzQuad::default(); 8];
+        let total = fz_search_index_search(
+            0,
+            index,
+            needle.as_ptr(),
+            options,
+            pages.as_mut_ptr(),
+            quads.as_mut_ptr(),
+            8,
+        );
+        let n = (total as usize).min(8);
+        pages.truncate(n);
+        quads.truncate(n);
+        (total, pages, quads)
+    }
+
+    #[test]
+    fn test_hits_across_pages_with_quads() {
+        let index = index_of(&[
+            &["The quick brown fox", "jumps over"],
+            &["the lazy dog", "and the fox again"],
+        ]);
+        assert_eq!(fz_search_index_page_count(0, index), 2);
+
+        let (total, pages, quads) = search(index, c"fox", 0);
+        assert_eq!(total, 2);
+        assert_eq!(pages, vec![0, 1]);
+        // "fox" starts at column 16 of the first line
+        assert!((quads[0].ul[0] - (10.0 + 16.0 * 6.0)).abs() < 0.01);
+        assert!((quads[0].lr[1] - 100.0).abs() < 0.01);
+        assert!((quads[1].lr[1] - 120.0).abs() < 0.01);
+
+        assert_eq!(search(index, c"THE", 0).0, 0);
+        assert_eq!(search(index, c"THE", SearchOption::IgnoreCase as i32).0, 3);
+        // Short needles fall back to a scan; hits never span lines
+        assert_eq!(search(index, c"ox", 0).0, 2);
+        assert_eq!(search(index, c"foxjumps", 0).0, 0);
+        assert_eq!(search(index, c"zebra", 0).0, 0);
+
+        let stext = stext_with_lines(&["dup"]);
+        assert_eq!(fz_search_index_add_page(0, index, 1, stext), -1);
+        fz_drop_stext_page(0, stext);
+        fz_drop_search_index(0, index);
+    }
+
+    #[test]
+    fn test_save_and_load_round_trip() {
+        let index = index_of(&[&["alpha beta"], &[], &["gamma alpha"]]);
+        let path = std::env::temp_dir().join(format!("micropdf-search-{}.idx", std::process::id()));
+        let c_path = std::ffi::CString::new(path.to_str().unwrap()).unwrap();
+        assert_eq!(fz_save_search_index(0, index, c_path.as_ptr()), 0);
+
+        let loaded = fz_load_search_index(0, c_path.as_ptr());
+        assert_ne!(loaded, 0);
+        assert_eq!(fz_search_index_page_count(0, loaded), 3);
+        let (total, pages, quads) = search(loaded, c"alpha", 0);
+        assert_eq!(total, 2);
+        assert_eq!(pages, vec![0, 2]);
+        assert_eq!(quads[1].ul, search(index, c"alpha", 0).2[1].ul);
+
+        // Truncated files are rejected
+        let bytes = std::fs::read(&path).unwrap();
+        std::fs::write(&path, &bytes[..bytes.len() - 3]).unwrap();
+        assert_eq!(fz_load_search_index(0, c_path.as_ptr()), 0);
+
+        let _ = std::fs::remove_file(&path);
+        fz_drop_search_index(0, loaded);
+        fz_drop_search_index(0, index);
+    }
+}
@@ -1,8 +1,9 @@
 //! C FFI for shading/gradients - MuPDF compatible
 //! Safe Rust implementation of fz_shade
 
+use super::shade_paint::{MeshCache, ShadeLut};
 use super::{Handle, HandleStore};
-use std::sync::LazyLock;
+use std::sync::{Arc, LazyLock};
 
 /// Shading type enumeration (PDF spec types)
 #[repr(C)]
@@ -101,6 +102,8 @@ pub struct Shade {
     pub colorspace: u64,
     /// Bounding box
     pub bbox: [f32; 4],
+    /// Whether `bbox` was set and clips painting
+    pub has_bbox: bool,
     /// Background color (if any)
     pub background: Option<[f32; 4]>,
     /// Whether to use function (vs stitching)
@@ -137,6 +140,10 @@ pub struct Shade {
     pub domain: [f32; 4],
     /// Matrix for function-based
     pub matrix: [f32; 6],
+    /// Colour stops sampled for painting, rebuilt when they change
+    pub lut: Option<Arc<ShadeLut>>,
+    /// Patches tessellated for painting, rebuilt when they change
+    pub mesh: Option<Arc<MeshCache>>,
 }
 
 impl Default for Shade {
@@ -145,6 +152,7 @@ impl Default for Shade {
             shade_type: ShadeType::None,
             colorspace: 0,
             bbox: [0.0, 0.0, 1.0, 1.0],
+            has_bbox: false,
             background: None,
             use_function: false,
             extend_start: false,
@@ -163,6 +171,8 @@ impl Default for Shade {
             bits_per_flag: 2,
             domain: [0.0, 1.0, 0.0, 1.0],
             matrix: [1.0, 0.0, 0.0, 1.0, 0.0, 0.0], // Identity
+            lut: None,
+            mesh: None,
         }
     }
 }
@@ -406,6 +416,7 @@ pub extern "C" fn fz_shade_set_bbox(
     if let Some(shade_arc) = SHADES.get(shade) {
         if let Ok(mut guard) = shade_arc.lock() {
             guard.bbox = [x0, y0, x1, y1];
+            guard.has_bbox = true;
         }
     }
 }
@@ -588,41 +599,41 @@ pub extern "C" fn fz_shade_sample(_ctx: Handle, shade: Handle, t: f32, color: *m
     if let Some(shade_arc) = SHADES.get(shade) {
         if let Ok(guard) = shade_arc.lock() {
             let color_slice = unsafe { std::slice::from_raw_parts_mut(color, 4) };
+            color_slice.copy_from_slice(&sample_stops(&guard.color_stops, t));
+        }
+    }
+}
 
-            // Default to black
-            color_slice.fill(0.0);
-
-            if guard.color_stops.is_empty() {
-                return;
-            }
+/// Colour of the gradient through `stops` at `t`, black if there are none
+pub(crate) fn sample_stops(stops: &[ColorStop], t: f32) -> [f32; 4] {
+    if stops.is_empty() {
+        return [0.0; 4];
+    }
 
-            let t = t.clamp(0.0, 1.0);
+    let t = t.clamp(0.0, 1.0);
 
-            // Find bounding stops
-            let mut prev_stop = &guard.color_stops[0];
-            let mut next_stop = &guard.color_stops[guard.color_stops.len() - 1];
+    // Find bounding stops
+    let mut prev_stop = &stops[0];
+    let mut next_stop = &stops[stops.len() - 1];
 
-            for stop in &guard.color_stops {
-                if stop.offset <= t {
-                    prev_stop = stop;
-                }
-                if stop.offset >= t && stop.offset <= next_stop.offset {
-                    next_stop = stop;
-                    break;
-                }
-            }
-
-            // Interpolate between stops
-            if (next_stop.offset - prev_stop.offset).abs() < f32::EPSILON {
-                color_slice.copy_from_slice(&prev_stop.color);
-            } else {
-                let blend = (t - prev_stop.offset) / (next_stop.offset - prev_stop.offset);
-                for i in 0..4 {
-                    color_slice[i] =
-                        prev_stop.color[i] + blend * (next_stop.color[i] - prev_stop.color[i]);
-                }
-            }
+    for stop in stops {
+        if stop.offset <= t {
+            prev_stop = stop;
         }
+        if stop.offset >= t && stop.offset <= next_stop.offset {
+            next_stop = stop;
+            break;
+        }
+    }
+
+    // Interpolate between stops
+    if (next_stop.offset - prev_stop.offset).abs() < f32::EPSILON {
+        prev_stop.color
+    } else {
+        let blend = (t - prev_stop.offset) / (next_stop.offset - prev_stop.offset);
+        std::array::from_fn(|i| {
+            prev_stop.color[i] + blend * (next_stop.color[i] - prev_stop.color[i])
+        })
     }
 }
 
@@ -0,0 +1,960 @@
+//! Shading rasterization for the draw device
+//!
+//! Axial and radial shades sample their colour stops once into a
+//! [`LUT_SIZE`]-entry table kept on the shade, converted to the target's
+//! colorants once per paint. Each row then needs only the gradient parameter
+//! per pixel, computed [`BLOCK`] pixels at a time on the same `Lanes` kernels
+//! as pixel conversion: the pixel maps to t and a coverage byte, and the
+//! span painters composite the looked-up colours through that coverage.
+//! Every kernel gives the same bytes.
+//!
+//! Patch meshes are tessellated into Gouraud triangles in shade space, at a
+//! subdivision chosen from their device size, and the triangles are kept on
+//! the shade so later renders at a similar scale skip the tessellation.
+
+use super::colorspace::{FZ_COLORSPACE_BGR, fz_colorspace_n};
+use super::composite::{SpanPaint, paint_span};
+use super::dispatch::kernels;
+use super::draw_device::BlendMode;
+use super::pdf_recolor::convert_components;
+use super::pixel_convert::{BLOCK, Lanes};
+use super::pixmap::Pixmap;
+use super::shade::{ColorStop, Shade, ShadePatch, ShadeType, sample_stops};
+use super::simd_util::SimdLevel;
+use std::collections::hash_map::DefaultHasher;
+use std::hash::Hasher;
+use std::sync::Arc;
+
+/// Entries in a sampled gradient
+pub const LUT_SIZE: usize = 256;
+
+/// Colour stops sampled at `LUT_SIZE` evenly spaced positions
+#[derive(Debug)]
+pub struct ShadeLut {
+    /// Hash of the stops it was sampled from
+    source: u64,
+    colors: Vec<[f32; 4]>,
+}
+
+/// Triangle with a shade-space colour at each corner
+#[derive(Debug, Clone, Copy)]
+struct MeshTriangle {
+    points: [(f32, f32); 3],
+    colors: [[f32; 4]; 3],
+}
+
+/// Tessellated patches of a mesh shade
+#[derive(Debug)]
+pub struct MeshCache {
+    /// Hash of the patches it was tessellated from
+    source: u64,
+    /// Grid steps along each side of every patch
+    steps: usize,
+    triangles: Vec<MeshTriangle>,
+}
+
+/// Device pixels per patch grid step, at most
+const PATCH_STEP_PIXELS: f32 = 8.0;
+
+/// Finest patch subdivision along each side
+const MAX_PATCH_STEPS: usize = 64;
+
+fn hash_floats(values: impl Iterator<Item = f32>) -> u64 {
+    let mut hasher = DefaultHasher::new();
+    for v in values {
+        hasher.write_u32(v.to_bits());
+    }
+    hasher.finish()
+}
+
+fn stops_hash(stops: &[ColorStop]) -> u64 {
+    hash_floats(
+        stops
+            .iter()
+            .flat_map(|s| std::iter::once(s.offset).chain(s.color)),
+    )
+}
+
+fn patches_hash(patches: &[ShadePatch]) -> u64 {
+    hash_floats(patches.iter().flat_map(|p| {
+        p.points
+            .iter()
+            .flat_map(|q| [q.x, q.y])
+            .chain(p.colors.iter().flatten().copied())
+            .collect::<Vec<_>>()
+    }))
+}
+
+/// The shade's sampled stops, sampling them again if they changed
+fn shade_lut(shade: &mut Shade) -> Arc<ShadeLut> {
+    let source = stops_hash(&shade.color_stops);
+    if let Some(lut) = shade.lut.as_ref().filter(|l| l.source == source) {
+        return Arc::clone(lut);
+    }
+    let colors = (0..LUT_SIZE)
+        .map(|i| sample_stops(&shade.color_stops, i as f32 / (LUT_SIZE - 1) as f32))
+        .collect();
+    let lut = Arc::new(ShadeLut { source, colors });
+    shade.lut = Some(Arc::clone(&lut));
+    lut
+}
+
+// ============================================================================
+// Gradient Kernels
+// ============================================================================
+
+/// Where a gradient puts each point, in shade space
+#[derive(Debug, Clone, Copy)]
+enum Geometry {
+    /// t = u * tu + v * tv + tc
+    Axial { tu: f32, tv: f32, tc: f32 },
+    /// Circles from (x0, y0, r0) to (x0 + dx, y0 + dy, r0 + dr); `a` is
+    /// dx² + dy² - dr², the quadratic's leading coefficient
+    Radial {
+        x0: f32,
+        y0: f32,
+        r0: f32,
+        dx: f32,
+        dy: f32,
+        dr: f32,
+        a: f32,
+    },
+}
+
+/// Gradient geometry with its extension flags
+#[derive(Debug, Clone, Copy)]
+pub(super) struct Gradient {
+    geometry: Geometry,
+    extend_start: bool,
+    extend_end: bool,
+}
+
+impl Gradient {
+    fn of(shade: &Shade) -> Option<Self> {
+        let geometry = match shade.shade_type {
+            ShadeType::Linear => {
+                let (p0, p1) = (shade.linear_start, shade.linear_end);
+                let (dx, dy) = (p1.x - p0.x, p1.y - p0.y);
+                let length = dx * dx + dy * dy;
+                if length <= 0.0 || !length.is_finite() {
+                    return None;
+                }
+                let (tu, tv) = (dx / length, dy / length);
+                Geometry::Axial {
+                    tu,
+                    tv,
+                    tc: -(p0.x * tu + p0.y * tv),
+                }
+            }
+            ShadeType::Radial => {
+                let (c0, c1) = (shade.radial_start, shade.radial_end);
+                let (dx, dy) = (c1.x - c0.x, c1.y - c0.y);
+                let dr = shade.radial_r1 - shade.radial_r0;
+                Geometry::Radial {
+                    x0: c0.x,
+                    y0: c0.y,
+                    r0: shade.radial_r0,
+                    dx,
+                    dy,
+                    dr,
+                    a: dx * dx + dy * dy - dr * dr,
+                }
+            }
+            _ => return None,
+        };
+        Some(Self {
+            geometry,
+            extend_start: shade.extend_start,
+            extend_end: shade.extend_end,
+        })
+    }
+}
+
+/// Lane offsets within a block
+const LANE_INDEX: [f32; BLOCK] = [0.0, 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0];
+
+/// 1 where `s` is inside the domain, taking the extensions into account
+#[inline(always)]
+fn in_domain<V: Lanes>(s: V, extend_start: V, extend_end: V) -> V {
+    let (zero, one) = (V::splat(0.0), V::splat(1.0));
+    zero.select_le(s, one, extend_start)
+        .mul(s.select_le(one, one, extend_end))
+}
+
+/// Gradient parameter and coverage (0 or 1) of a block of points
+#[inline(always)]
+fn gradient_block<V: Lanes>(g: &Gradient, u: V, v: V) -> (V, V) {
+    let (zero, one) = (V::splat(0.0), V::splat(1.0));
+    let flag = |on: bool| V::splat(if on { 1.0 } else { 0.0 });
+    let (start, end) = (flag(g.extend_start), flag(g.extend_end));
+    match g.geometry {
+        Geometry::Axial { tu, tv, tc } => {
+            let t = u
+                .mul(V::splat(tu))
+                .add(v.mul(V::splat(tv)))
+                .add(V::splat(tc));
+            (t, in_domain(t, start, end))
+        }
+        Geometry::Radial {
+            x0,
+            y0,
+            r0,
+            dx,
+            dy,
+            dr,
+            a,
+        } => {
+            // The largest s with |p - c(s)| = r(s) and r(s) >= 0, where
+            // a s² - 2 b s + c = 0
+            let pu = u.sub(V::splat(x0));
+            let pv = v.sub(V::splat(y0));
+            let b = pu
+                .mul(V::splat(dx))
+                .add(pv.mul(V::splat(dy)))
+                .add(V::splat(r0 * dr));
+            let c = pu.mul(pu).add(pv.mul(pv)).sub(V::splat(r0 * r0));
+            let usable = |s: V| {
+                let radius = V::splat(r0).add(s.mul(V::splat(dr)));
+                // Zero for NaN and infinities as well
+                let finite = s.select_le(
+                    V::splat(1e30),
+                    V::splat(-1e30).select_le(s, one, zero),
+                    zero,
+                );
+                zero.select_le(radius, one, zero)
+                    .mul(in_domain(s, start, end))
+                    .mul(finite)
+            };
+            if a == 0.0 {
+                let s = c.div(b.add(b));
+                return (s, usable(s));
+            }
+            let disc = b.mul(b).sub(V::splat(a).mul(c));
+            let root = disc.max(zero).sqrt();
+            let s1 = b.add(root).div(V::splat(a));
+            let s2 = b.sub(root).div(V::splat(a));
+            let (high, low) = (s1.max(s2), s1.min(s2));
+            let real = zero.select_le(disc, one, zero);
+            let high_ok = usable(high).mul(real);
+            let low_ok = usable(low).mul(real);
+            let s = high_ok.select_le(V::splat(0.5), low, high);
+            (s, high_ok.max(low_ok))
+        }
+    }
+}
+
+/// LUT index and coverage byte of `index.len()` points from `start`, `step`
+/// apart
+fn gradient_run<V: Lanes>(
+    g: &Gradient,
+    start: (f32, f32),
+    step: (f32, f32),
+    index: &mut [u8],
+    mask: &mut [u8],
+) {
+    let lanes = V::load(&LANE_INDEX);
+    let scale = V::splat((LUT_SIZE - 1) as f32);
+    let (mut ib, mut mb) = ([0u8; BLOCK], [0u8; BLOCK]);
+    let count = index.len();
+    let mut at = 0;
+    while at < count {
+        let i = lanes.add(V::splat(at as f32));
+        let u = V::splat(start.0).add(i.mul(V::splat(step.0)));
+        let v = V::splat(start.1).add(i.mul(V::splat(step.1)));
+        let (t, covered) = gradient_block(g, u, v);
+        t.max(V::splat(0.0))
+            .min(V::splat(1.0))
+            .mul(scale)
+            .add(V::splat(0.5))
+            .store_bytes(&mut ib);
+        covered.mul(V::splat(255.0)).store_bytes(&mut mb);
+        let len = BLOCK.min(count - at);
+        index[at..at + len].copy_from_slice(&ib[..len]);
+        mask[at..at + len].copy_from_slice(&mb[..len]);
+        at += len;
+    }
+}
+
+/// Gradient row kernel, as held in the kernel dispatch table
+pub(super) type GradientFn = unsafe fn(&Gradient, (f32, f32), (f32, f32), &mut [u8], &mut [u8]);
+
+/// Gradient row kernel the dispatch table uses at `level`
+pub(super) fn gradient_kernel(level: SimdLevel) -> GradientFn {
+    match level {
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        SimdLevel::Avx2 => gradient_avx2,
+        #[cfg(target_arch = "aarch64")]
+        SimdLevel::Neon => gradient_neon,
+        _ => gradient_scalar,
+    }
+}
+
+fn gradient_scalar(g: &Gradient, start: (f32, f32), step: (f32, f32), i: &mut [u8], m: &mut [u8]) {
+    gradient_run::<[f32; BLOCK]>(g, start, step, i, m)
+}
+
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "avx2")]
+unsafe fn gradient_avx2(
+    g: &Gradient,
+    start: (f32, f32),
+    step: (f32, f32),
+    i: &mut [u8],
+    m: &mut [u8],
+) {
+    gradient_run::<super::pixel_convert::avx2::Avx2>(g, start, step, i, m)
+}
+
+#[cfg(target_arch = "aarch64")]
+#[target_feature(enable = "neon")]
+unsafe fn gradient_neon(
+    g: &Gradient,
+    start: (f32, f32),
+    step: (f32, f32),
+    i: &mut [u8],
+    m: &mut [u8],
+) {
+    gradient_run::<super::pixel_convert::neon::Neon>(g, start, step, i, m)
+}
+
+fn gradient_row(
+    g: &Gradient,
+    start: (f32, f32),
+    step: (f32, f32),
+    index: &mut [u8],
+    mask: &mut [u8],
+    simd: bool,
+) {
+    let row: GradientFn = if simd {
+        kernels().gradient_row
+    } else {
+        gradient_scalar
+    };
+    // The table only holds kernels the CPU runs
+    unsafe { row(g, start, step, index, mask) }
+}
+
+// ============================================================================
+// Patch Tessellation
+// ============================================================================
+
+/// Grid position of each of a patch's 16 points: the 12 boundary points in
+/// PDF order, then the interior p11, p12, p22, p21
+const PATCH_ORDER: [(usize, usize); 16] = [
+    (0, 0),
+    (0, 1),
+    (0, 2),
+    (0, 3),
+    (1, 3),
+    (2, 3),
+    (3, 3),
+    (3, 2),
+    (3, 1),
+    (3, 0),
+    (2, 0),
+    (1, 0),
+    (1, 1),
+    (1, 2),
+    (2, 2),
+    (2, 1),
+];
+
+fn bernstein(t: f32) -> [f32; 4] {
+    let u = 1.0 - t;
+    [u * u * u, 3.0 * u * u * t, 3.0 * u * t * t, t * t * t]
+}
+
+/// Tensor-product control grid of a patch; Coons patches get the interior
+/// points their boundary implies
+fn control_grid(patch: &ShadePatch, coons: bool) -> [[(f32, f32); 4]; 4] {
+    let mut p = [[(0.0, 0.0); 4]; 4];
+    for (point, &(i, j)) in patch.points.iter().zip(&PATCH_ORDER) {
+        p[i][j] = (point.x, point.y);
+    }
+    if coons {
+        let boundary = p;
+        let mix = |terms: [(f32, (usize, usize)); 8]| {
+            let (mut x, mut y) = (0.0, 0.0);
+            for (w, (i, j)) in terms {
+                x += w * boundary[i][j].0;
+                y += w * boundary[i][j].1;
+            }
+            (x / 9.0, y / 9.0)
+        };
+        let c = |a, b, c, d, e, f, g, h| {
+            mix([
+                (-4.0, a),
+                (6.0, b),
+                (6.0, c),
+                (-2.0, d),
+                (-2.0, e),
+                (3.0, f),
+                (3.0, g),
+                (-1.0, h),
+            ])
+        };
+        let (p00, p01, p02, p03) = ((0, 0), (0, 1), (0, 2), (0, 3));
+        let (p10, p13, p20, p23) = ((1, 0), (1, 3), (2, 0), (2, 3));
+        let (p30, p31, p32, p33) = ((3, 0), (3, 1), (3, 2), (3, 3));
+        p[1][1] = c(p00, p01, p10, p03, p30, p31, p13, p33);
+        p[1][2] = c(p03, p02, p13, p00, p33, p32, p10, p30);
+        p[2][2] = c(p33, p32, p23, p30, p03, p20, p02, p00);
+        p[2][1] = c(p30, p31, p20, p33, p00, p23, p01, p03);
+    }
+    p
+}
+
+/// Split every patch along `steps` in each direction into triangles
+fn tessellate(patches: &[ShadePatch], coons: bool, steps: usize) -> Vec<MeshTriangle> {
+    let mut triangles = Vec::with_capacity(patches.len() * steps * steps * 2);
+    let side = steps + 1;
+    let mut grid = Vec::with_capacity(side * side);
+    for patch in patches {
+        let p = control_grid(patch, coons);
+        let [c00, c03, c33, c30] = patch.colors;
+        grid.clear();
+        for a in 0..side {
+            let u = a as f32 / steps as f32;
+            let bu = bernstein(u);
+            for b in 0..side {
+                let v = b as f32 / steps as f32;
+                let bv = bernstein(v);
+                let (mut x, mut y) = (0.0, 0.0);
+                for i in 0..4 {
+                    for j in 0..4 {
+                        x += p[i][j].0 * bu[i] * bv[j];
+                        y += p[i][j].1 * bu[i] * bv[j];
+                    }
+                }
+                let color = std::array::from_fn(|k| {
+                    (1.0 - u) * (1.0 - v) * c00[k]
+                        + (1.0 - u) * v * c03[k]
+                        + u * v * c33[k]
+                        + u * (1.0 - v) * c30[k]
+                });
+                grid.push(((x, y), color));
+            }
+        }
+        for a in 0..steps {
+            for b in 0..steps {
+                let corner = |da: usize, db: usize| grid[(a + da) * side + b + db];
+                let (g00, g10, g11, g01) = (corner(0, 0), corner(1, 0), corner(1, 1), corner(0, 1));
+                for [q, r, s] in [[g00, g10, g11], [g00, g11, g01]] {
+                    triangles.push(MeshTriangle {
+                        points: [q.0, r.0, s.0],
+                        colors: [q.1, r.1, s.1],
+                    });
+                }
+            }
+        }
+    }
+    triangles
+}
+
+fn transform(ctm: &[f32; 6], (x, y): (f32, f32)) -> (f32, f32) {
+    (
+        ctm[0] * x + ctm[2] * y + ctm[4],
+        ctm[1] * x + ctm[3] * y + ctm[5],
+    )
+}
+
+/// The shade's tessellated patches at a subdivision fine enough for `ctm`,
+/// tessellating them again if they changed or a finer one is needed
+fn shade_mesh(shade: &mut Shade, ctm: &[f32; 6]) -> Arc<MeshCache> {
+    let extent = shade
+        .patches
+        .iter()
+        .map(|patch| {
+            let points = patch.points.map(|q| transform(ctm, (q.x, q.y)));
+            let (mut x0, mut y0, mut x1, mut y1) = (f32::MAX, f32::MAX, f32::MIN, f32::MIN);
+            for (x, y) in points {
+                (x0, y0, x1, y1) = (x0.min(x), y0.min(y), x1.max(x), y1.max(y));
+            }
+            (x1 - x0).max(y1 - y0)
+        })
+        .fold(0.0, f32::max);
+    let wanted = ((extent / PATCH_STEP_PIXELS).ceil().max(1.0) as usize)
+        .next_power_of_two()
+        .clamp(2, MAX_PATCH_STEPS);
+    let source = patches_hash(&shade.patches);
+    // A finer tessellation than needed is reused; up to twice as fine
+    // as wanted keeps zooming out from re-tessellating every frame
+    if let Some(mesh) = shade
+        .mesh
+        .as_ref()
+        .filter(|m| m.source == source && m.steps >= wanted && m.steps <= wanted * 2)
+    {
+        return Arc::clone(mesh);
+    }
+    let coons = shade.shade_type == ShadeType::CoonsPatch;
+    let mesh = Arc::new(MeshCache {
+        source,
+        steps: wanted,
+        triangles: tessellate(&shade.patches, coons, wanted),
+    });
+    shade.mesh = Some(Arc::clone(&mesh));
+    mesh
+}
+
+// ============================================================================
+// Painting
+// ============================================================================
+
+/// Pixel rectangle painted into
+#[derive(Debug, Clone, Copy)]
+struct Area {
+    x0: i32,
+    y0: i32,
+    x1: i32,
+    y1: i32,
+}
+
+/// Shade-space colour as target colorants, 0 to 255
+fn device_color(colorspace: u64, n: usize, bgr: bool, color: &[f32; 4]) -> [f32; 4] {
+    let src_n = (fz_colorspace_n(0, colorspace).clamp(1, 4)) as usize;
+    let mut out = convert_components(&color[..src_n], n);
+    if bgr {
+        out[..3].reverse();
+    }
+    out.map(|c| c.clamp(0.0, 1.0) * 255.0)
+}
+
+fn paint_gradient(
+    shade: &mut Shade,
+    g: &Gradient,
+    target: &mut Pixmap,
+    area: Area,
+    ctm: &[f32; 6],
+    paint: &SpanPaint,
+    simd: bool,
+) -> bool {
+    let det = ctm[0] * ctm[3] - ctm[1] * ctm[2];
+    if det == 0.0 || !det.is_finite() {
+        return false;
+    }
+    let inv = [
+        ctm[3] / det,
+        -ctm[1] / det,
+        -ctm[2] / det,
+        ctm[0] / det,
+        (ctm[2] * ctm[5] - ctm[3] * ctm[4]) / det,
+        (ctm[1] * ctm[4] - ctm[0] * ctm[5]) / det,
+    ];
+    let n = paint.n;
+    let bgr = target.colorspace() == FZ_COLORSPACE_BGR;
+    let lut = shade_lut(shade);
+    let table: Vec<u8> = lut
+        .colors
+        .iter()
+        .flat_map(|c| {
+            let c = device_color(shade.colorspace, n, bgr, c);
+            (0..n).map(move |k| (c[k] + 0.5) as u8)
+        })
+        .collect();
+
+    let width = (area.x1 - area.x0) as usize;
+    let (mut index, mut mask) = (vec![0u8; width], vec![0u8; width]);
+    let mut source = vec![0u8; width * n];
+    let (px, py, pn, stride) = (target.x(), target.y(), target.n(), target.stride());
+    for y in area.y0..area.y1 {
+        let (cx, cy) = (area.x0 as f32 + 0.5, y as f32 + 0.5);
+        let start = (
+            inv[0] * cx + inv[2] * cy + inv[4],
+            inv[1] * cx + inv[3] * cy + inv[5],
+        );
+        gradient_row(g, start, (inv[0], inv[1]), &mut index, &mut mask, simd);
+        for (pixel, &i) in source.chunks_exact_mut(n).zip(&index) {
+            pixel.copy_from_slice(&table[usize::from(i) * n..][..n]);
+        }
+        let offset = ((y - py) * stride + (area.x0 - px) * pn) as usize;
+        paint_span(
+            &mut target.samples_mut()[offset..],
+            &source,
+            Some(&mask),
+            width,
+            paint,
+        );
+    }
+    true
+}
+
+/// Gouraud-shade triangles, each pixel whose centre is inside taking the
+/// colour interpolated there
+fn paint_triangles<'a>(
+    triangles: impl Iterator<Item = (&'a [(f32, f32); 3], &'a [[f32; 4]; 3])>,
+    colorspace: u64,
+    target: &mut Pixmap,
+    area: Area,
+    ctm: &[f32; 6],
+    paint: &SpanPaint,
+) {
+    let n = paint.n;
+    let bgr = target.colorspace() == FZ_COLORSPACE_BGR;
+    let (px, py, pn, stride) = (target.x(), target.y(), target.n(), target.stride());
+    let mut source = Vec::new();
+    for (points, colors) in triangles {
+        let p = points.map(|q| transform(ctm, q));
+        let c = colors.map(|c| device_color(colorspace, n, bgr, &c));
+        let (e1, e2) = (
+            (p[1].0 - p[0].0, p[1].1 - p[0].1),
+            (p[2].0 - p[0].0, p[2].1 - p[0].1),
+        );
+        let denom = e1.0 * e2.1 - e2.0 * e1.1;
+        if denom.abs() < 1e-9 || !denom.is_finite() {
+            continue;
+        }
+        // Colour planes: c(x, y) = c0 + gx (x - x0) + gy (y - y0)
+        let gx: [f32; 4] = std::array::from_fn(|k| {
+            ((c[1][k] - c[0][k]) * e2.1 - (c[2][k] - c[0][k]) * e1.1) / denom
+        });
+        let gy: [f32; 4] = std::array::from_fn(|k| {
+            ((c[2][k] - c[0][k]) * e1.0 - (c[1][k] - c[0][k]) * e2.0) / denom
+        });
+
+        let top = p.iter().map(|q| q.1).fold(f32::MAX, f32::min);
+        let bottom = p.iter().map(|q| q.1).fold(f32::MIN, f32::max);
+        let row = |y: f32| (y - 0.5).ceil() as i32;
+        for y in row(top).max(area.y0)..row(bottom).min(area.y1) {
+            let cy = y as f32 + 0.5;
+            let (mut xa, mut xb) = (f32::MAX, f32::MIN);
+            for k in 0..3 {
+                let (a, b) = (p[k], p[(k + 1) % 3]);
+                let (a, b) = if a.1 <= b.1 { (a, b) } else { (b, a) };
+                if a.1 <= cy && cy < b.1 {
+                    let x = a.0 + (cy - a.1) * (b.0 - a.0) / (b.1 - a.1);
+                    (xa, xb) = (xa.min(x), xb.max(x));
+                }
+            }
+            let first = ((xa - 0.5).ceil() as i32).max(area.x0);
+            let last = ((xb - 0.5).ceil() as i32).min(area.x1);
+            if first >= last {
+                continue;
+            }
+            let count = (last - first) as usize;
+            source.resize(count * n, 0);
+            let (cx, cy) = (first as f32 + 0.5 - p[0].0, cy - p[0].1);
+            for k in 0..n {
+                let mut value = c[0][k] + gx[k] * cx + gy[k] * cy;
+                for pixel in source.chunks_exact_mut(n) {
+                    pixel[k] = (value.clamp(0.0, 255.0) + 0.5) as u8;
+                    value += gx[k];
+                }
+            }
+            let offset = ((y - py) * stride + (first - px) * pn) as usize;
+            paint_span(
+                &mut target.samples_mut()[offset..],
+                &source,
+                None,
+                count,
+                paint,
+            );
+        }
+    }
+}
+
+/// Paint `shade` under `ctm` onto `target`, clipped to the shade's bbox
+///
+/// Returns false if the shade is of a kind this can't paint (function-based
+/// shades carry no function here) or the CTM is singular.
+pub(crate) fn paint_shade_with(
+    shade: &mut Shade,
+    target: &mut Pixmap,
+    ctm: &[f32; 6],
+    blend: BlendMode,
+    alpha: f32,
+    simd: bool,
+) -> bool {
+    let n = (target.n() - i32::from(target.has_alpha())) as usize;
+    let mut paint = SpanPaint {
+        n,
+        dst_alpha: target.has_alpha(),
+        src_alpha: false,
+        alpha,
+        blend,
+    };
+    if !paint.is_supported() {
+        paint.blend = BlendMode::Normal;
+    }
+    let mut area = Area {
+        x0: target.x(),
+        y0: target.y(),
+        x1: target.x() + target.w(),
+        y1: target.y() + target.h(),
+    };
+    if shade.has_bbox {
+        let [x0, y0, x1, y1] = shade.bbox;
+        let corners = [(x0, y0), (x1, y0), (x1, y1), (x0, y1)].map(|q| transform(ctm, q));
+        let xs = corners.map(|q| q.0);
+        let ys = corners.map(|q| q.1);
+        let lo = |v: [f32; 4]| v.into_iter().fold(f32::MAX, f32::min).floor() as i32;
+        let hi = |v: [f32; 4]| v.into_iter().fold(f32::MIN, f32::max).ceil() as i32;
+        area = Area {
+            x0: area.x0.max(lo(xs)),
+            y0: area.y0.max(lo(ys)),
+            x1: area.x1.min(hi(xs)),
+            y1: area.y1.min(hi(ys)),
+        };
+    }
+
+    match shade.shade_type {
+        ShadeType::Linear | ShadeType::Radial => {
+            let Some(g) = Gradient::of(shade) else {
+                return false;
+            };
+            if area.x0 >= area.x1 || area.y0 >= area.y1 {
+                return true;
+            }
+            paint_gradient(shade, &g, target, area, ctm, &paint, simd)
+        }
+        ShadeType::FreeFormTriangle | ShadeType::LatticeTriangle => {
+            // Vertices come in threes; the stream's strip flags and row
+            // lengths are resolved when the shade is built
+            let triangles: Vec<([(f32, f32); 3], [[f32; 4]; 3])> = shade
+                .vertices
+                .chunks_exact(3)
+                .map(|t| {
+                    (
+                        std::array::from_fn(|k| (t[k].point.x, t[k].point.y)),
+                        std::array::from_fn(|k| t[k].color),
+                    )
+                })
+                .collect();
+            let iter = triangles.iter().map(|(p, c)| (p, c));
+            paint_triangles(iter, shade.colorspace, target, area, ctm, &paint);
+            true
+        }
+        ShadeType::CoonsPatch | ShadeType::TensorPatch => {
+            let mesh = shade_mesh(shade, ctm);
+            let iter = mesh.triangles.iter().map(|t| (&t.points, &t.colors));
+            paint_triangles(iter, shade.colorspace, target, area, ctm, &paint);
+            true
+        }
+        ShadeType::Function | ShadeType::None => false,
+    }
+}
+
+/// [`paint_shade_with`] on the fastest kernel the CPU has
+pub(crate) fn paint_shade(
+    shade: &mut Shade,
+    target: &mut Pixmap,
+    ctm: &[f32; 6],
+    blend: BlendMode,
+    alpha: f32,
+) -> bool {
+    paint_shade_with(shade, target, ctm, blend, alpha, true)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::super::colorspace::{FZ_COLORSPACE_GRAY, FZ_COLORSPACE_RGB};
+    use super::super::shade::{ShadePoint, ShadeVertex};
+    use super::*;
+
+    const IDENTITY: [f32; 6] = [1.0, 0.0, 0.0, 1.0, 0.0, 0.0];
+
+    fn gray_stops() -> Vec<ColorStop> {
+        vec![
+            ColorStop {
+                offset: 0.0,
+                color: [0.0; 4],
+                n: 1,
+            },
+            ColorStop {
+                offset: 1.0,
+                color: [1.0, 0.0, 0.0, 0.0],
+                n: 1,
+            },
+        ]
+    }
+
+    fn render(shade: &mut Shade, width: i32, simd: bool) -> Vec<u8> {
+        let mut target = Pixmap::new(FZ_COLORSPACE_GRAY, width, 4, false);
+        target.clear_with_value(7);
+        assert!(paint_shade_with(
+            shade,
+            &mut target,
+            &IDENTITY,
+            BlendMode::Normal,
+            1.0,
+            simd
+        ));
+        target.samples().to_vec()
+    }
+
+    #[test]
+    fn test_axial_gradient_ramps_across_the_axis() {
+        let mut shade = Shade {
+            shade_type: ShadeType::Linear,
+            colorspace: FZ_COLORSPACE_GRAY,
+            linear_start: ShadePoint { x: 0.0, y: 0.0 },
+            linear_end: ShadePoint { x: 255.0, y: 0.0 },
+            color_stops: gray_stops(),
+            ..Default::default()
+        };
+        let row = render(&mut shade, 256, true);
+        // Pixel centres sit half a unit along
+        assert_eq!(&row[..3], &[1, 2, 3]);
+        assert_eq!(row[254], 255);
+        // Not extended past the end
+        assert_eq!(row[255], 7);
+        assert!(shade.lut.is_some());
+
+        shade.extend_end = true;
+        assert_eq!(render(&mut shade, 256, true)[255], 255);
+    }
+
+    #[test]
+    fn test_kernels_agree() {
+        let mut shapes = vec![Shade {
+            shade_type: ShadeType::Linear,
+            linear_start: ShadePoint { x: 3.3, y: -1.0 },
+            linear_end: ShadePoint { x: 40.1, y: 2.7 },
+            extend_start: true,
+            ..Default::default()
+        }];
+        for (r0, r1, end) in [
+            (0.0, 30.0, (20.0, 2.0)),
+            (5.0, 5.0, (30.0, 0.0)),
+            (10.0, 6.0, (4.0, 0.0)),
+        ] {
+            for extend in [false, true] {
+                shapes.push(Shade {
+                    shade_type: ShadeType::Radial,
+                    radial_start: ShadePoint { x: 10.0, y: 1.5 },
+                    radial_r0: r0,
+                    radial_end: ShadePoint { x: end.0, y: end.1 },
+                    radial_r1: r1,
+                    extend_start: extend,
+                    extend_end: extend,
+                    ..Default::default()
+                });
+            }
+        }
+        // Touching circles, where the quadratic degenerates
+        shapes.push(Shade {
+            shade_type: ShadeType::Radial,
+            radial_start: ShadePoint { x: 10.0, y: 2.0 },
+            radial_r0: 0.0,
+            radial_end: ShadePoint { x: 20.0, y: 2.0 },
+            radial_r1: 10.0,
+            ..Default::default()
+        });
+        for mut shade in shapes {
+            shade.colorspace = FZ_COLORSPACE_GRAY;
+            shade.color_stops = gray_stops();
+            let simd = render(&mut shade, 61, true);
+            assert_eq!(
+                simd,
+                render(&mut shade, 61, false),
+                "{:?}",
+                shade.shade_type
+            );
+            assert!(simd.iter().any(|&v| v != 7));
+        }
+    }
+
+    #[test]
+    fn test_radial_inner_circle_is_start_colour() {
+        let mut shade = Shade {
+            shade_type: ShadeType::Radial,
+            colorspace: FZ_COLORSPACE_GRAY,
+            radial_start: ShadePoint { x: 16.0, y: 2.0 },
+            radial_r0: 0.0,
+            radial_end: ShadePoint { x: 16.0, y: 2.0 },
+            radial_r1: 16.0,
+            color_stops: gray_stops(),
+            ..Default::default()
+        };
+        let row = render(&mut shade, 32, true);
+        // Pixel centres are 0.7 units from the centre: 255 * 0.707 / 16
+        assert_eq!(row[2 * 32 + 16], 11);
+        assert!(row[2 * 32 + 1] > 230);
+    }
+
+    #[test]
+    fn test_patch_tessellation_is_cached() {
+        let mut patch = ShadePatch::default();
+        // A flat square from (0, 0) to (24, 24)
+        for (point, &(i, j)) in patch.points.iter_mut().zip(&PATCH_ORDER) {
+            *point = ShadePoint {
+                x: j as f32 * 8.0,
+                y: i as f32 * 8.0,
+            };
+        }
+        patch.colors = [
+            [0.0; 4],
+            [1.0, 0.0, 0.0, 0.0],
+            [1.0, 0.0, 0.0, 0.0],
+            [0.0; 4],
+        ];
+        let mut shade = Shade {
+            shade_type: ShadeType::CoonsPatch,
+            colorspace: FZ_COLORSPACE_GRAY,
+            patches: vec![patch],
+            ..Default::default()
+        };
+        let mut target = Pixmap::new(FZ_COLORSPACE_RGB, 24, 24, false);
+        assert!(paint_shade(
+            &mut shade,
+            &mut target,
+            &IDENTITY,
+            BlendMode::Normal,
+            1.0
+        ));
+        let mesh = Arc::clone(shade.mesh.as_ref().unwrap());
+        assert_eq!(mesh.triangles.len(), mesh.steps * mesh.steps * 2);
+        // Ramps left to right, the same down the patch
+        let at = |x: i32, y: i32| target.get_sample(x, y, 0).unwrap();
+        assert!(at(0, 12) < 10 && at(23, 12) > 245);
+        assert_eq!(at(12, 1), at(12, 22));
+
+        assert!(paint_shade(
+            &mut shade,
+            &mut target,
+            &IDENTITY,
+            BlendMode::Normal,
+            1.0
+        ));
+        assert!(Arc::ptr_eq(&mesh, shade.mesh.as_ref().unwrap()));
+        // Edits invalidate it
+        shade.patches[0].colors[0] = [0.5, 0.0, 0.0, 0.0];
+        assert!(paint_shade(
+            &mut shade,
+            &mut target,
+            &IDENTITY,
+            BlendMode::Normal,
+            1.0
+        ));
+        assert!(!Arc::ptr_eq(&mesh, shade.mesh.as_ref().unwrap()));
+    }
+
+    #[test]
+    fn test_triangle_vertices_are_interpolated() {
+        let vertex = |x, y, c| ShadeVertex {
+            point: ShadePoint { x, y },
+            color: [c, 0.0, 0.0, 0.0],
+        };
+        let mut shade = Shade {
+            shade_type: ShadeType::FreeFormTriangle,
+            colorspace: FZ_COLORSPACE_GRAY,
+            vertices: vec![
+                vertex(0.0, 0.0, 0.0),
+                vertex(16.0, 0.0, 1.0),
+                vertex(0.0, 16.0, 0.0),
+            ],
+            ..Default::default()
+        };
+        let mut target = Pixmap::new(FZ_COLORSPACE_GRAY, 16, 16, false);
+        target.clear_with_value(7);
+        assert!(paint_shade(
+            &mut shade,
+            &mut target,
+            &IDENTITY,
+            BlendMode::Normal,
+            1.0
+        ));
+        // Colour follows x: 255 * 4.5 / 16
+        assert_eq!(target.get_sample(4, 2, 0), Some(72));
+        assert_eq!(target.get_sample(15, 15, 0), Some(7));
+    }
+}
@@ -7,11 +7,17 @@
 //! - Base64 encode/decode
 //!
 //! Uses runtime feature detection to select the best implementation.
+//! `set_level` pins every kernel to a lower level, so benchmarks and parity
+//! checks can run each implementation on the same machine; it also selects
+//! that level's kernel dispatch table for the pixel kernels.
 
 // Allow unsafe operations inside unsafe functions (Rust 2024 edition compat)
 #![allow(unsafe_op_in_unsafe_fn)]
 
 use std::ffi::c_float;
+use std::sync::atomic::{AtomicI32, Ordering};
+
+use super::dispatch::{self, kernels};
 
 // ============================================================================
 // Feature Detection
@@ -132,6 +138,75 @@ pub enum SimdLevel {
 static SIMD_FEATURES: std::sync::LazyLock<SimdFeatures> =
     std::sync::LazyLock::new(SimdFeatures::detect);
 
+/// Level pinned by `set_level`, as a `SimdLevel` value; -1 for the best
+static PINNED_LEVEL: AtomicI32 = AtomicI32::new(-1);
+
+impl SimdLevel {
+    const ALL: [SimdLevel; 6] = [
+        SimdLevel::Scalar,
+        SimdLevel::Sse2,
+        SimdLevel::Sse41,
+        SimdLevel::Avx,
+        SimdLevel::Avx2,
+        SimdLevel::Neon,
+    ];
+
+    /// Level from its `repr(C)` value
+    pub fn from_i32(value: i32) -> Option<Self> {
+        Self::ALL.into_iter().find(|&l| l as i32 == value)
+    }
+
+    /// Whether this CPU can run the level
+    pub fn is_available(self) -> bool {
+        let f = &*SIMD_FEATURES;
+        match self {
+            SimdLevel::Scalar => true,
+            SimdLevel::Sse2 => f.sse2,
+            SimdLevel::Sse41 => f.sse4_1,
+            SimdLevel::Avx => f.avx,
+            SimdLevel::Avx2 => f.avx2,
+            SimdLevel::Neon => f.neon,
+        }
+    }
+}
+
+/// Levels this CPU can run, scalar first
+pub fn available_levels() -> Vec<SimdLevel> {
+    SimdLevel::ALL
+        .into_iter()
+        .filter(|l| l.is_available())
+        .collect()
+}
+
+/// Level the kernels dispatch to: the best available unless pinned
+#[inline]
+pub fn active_level() -> SimdLevel {
+    match PINNED_LEVEL.load(Ordering::Relaxed) {
+        -1 => SIMD_FEATURES.best_level(),
+        pinned => SimdLevel::from_i32(pinned).unwrap_or(SimdLevel::Scalar),
+    }
+}
+
+/// Pin every kernel to `level`, or return to the best available with None
+///
+/// Process wide; meant for benchmarks and parity checks. Returns false,
+/// changing nothing, if this CPU can't run `level`.
+pub fn set_level(level: Option<SimdLevel>) -> bool {
+    match level {
+        Some(level) if !level.is_available() => false,
+        Some(level) => {
+            PINNED_LEVEL.store(level as i32, Ordering::Relaxed);
+            dispatch::select(level);
+            true
+        }
+        None => {
+            PINNED_LEVEL.store(-1, Ordering::Relaxed);
+            dispatch::select(SIMD_FEATURES.best_level());
+            true
+        }
+    }
+}
+
 // ============================================================================
 // Matrix Operations (SIMD)
 // ============================================================================
@@ -159,7 +234,7 @@ impl SimdMatrix {
 
 /// Concatenate two matrices using SIMD when available
 pub fn matrix_concat(left: &SimdMatrix, right: &SimdMatrix) -> SimdMatrix {
-    let level = SIMD_FEATURES.best_level();
+    let level = active_level();
 
     match level {
         #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
@@ -282,7 +357,7 @@ pub fn transform_point(x: f32, y: f32, m: &SimdMatrix) -> (f32, f32) {
 
 /// Transform multiple points by a matrix (batch operation)
 pub fn transform_points(points: &mut [(f32, f32)], m: &SimdMatrix) {
-    let level = SIMD_FEATURES.best_level();
+    let level = active_level();
 
     match level {
         #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
@@ -408,6 +483,216 @@ unsafe fn transform_points_neon(points: &mut [(f32, f32)], m: &SimdMatrix) {
     }
 }
 
+// ============================================================================
+// Geometry Batches
+// ============================================================================
+//
+// Rects are [x0, y0, x1, y1], quads [ul, ur, ll, lr] points and points
+// (x, y), all packed f32 so bindings can hand over their arrays as is.
+
+/// Bounding box of rect `r` transformed by `m`
+pub fn transform_rect(r: [f32; 4], m: &SimdMatrix) -> [f32; 4] {
+    let corners = [
+        transform_point(r[0], r[1], m),
+        transform_point(r[2], r[1], m),
+        transform_point(r[0], r[3], m),
+        transform_point(r[2], r[3], m),
+    ];
+    let mut out = [corners[0].0, corners[0].1, corners[0].0, corners[0].1];
+    for &(x, y) in &corners[1..] {
+        out = [out[0].min(x), out[1].min(y), out[2].max(x), out[3].max(y)];
+    }
+    out
+}
+
+/// Transform rects in place to the bounding boxes of their transformed
+/// corners
+pub fn transform_rects(rects: &mut [[f32; 4]], m: &SimdMatrix) {
+    match active_level() {
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        SimdLevel::Sse2 | SimdLevel::Sse41 | SimdLevel::Avx | SimdLevel::Avx2 => unsafe {
+            transform_rects_sse2(rects, m)
+        },
+        _ => {
+            for r in rects.iter_mut() {
+                *r = transform_rect(*r, m);
+            }
+        }
+    }
+}
+
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "sse2")]
+unsafe fn transform_rects_sse2(rects: &mut [[f32; 4]], m: &SimdMatrix) {
+    #[cfg(target_arch = "x86")]
+    use std::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use std::arch::x86_64::*;
+
+    let ma = _mm_set1_ps(m.data[0]);
+    let mb = _mm_set1_ps(m.data[1]);
+    let mc = _mm_set1_ps(m.data[2]);
+    let md = _mm_set1_ps(m.data[3]);
+    let me = _mm_set1_ps(m.data[4]);
+    let mf = _mm_set1_ps(m.data[5]);
+
+    for r in rects.iter_mut() {
+        // The four corners, one per lane
+        let xs = _mm_set_ps(r[2], r[0], r[2], r[0]);
+        let ys = _mm_set_ps(r[3], r[3], r[1], r[1]);
+        let nx = _mm_add_ps(_mm_add_ps(_mm_mul_ps(xs, ma), _mm_mul_ps(ys, mc)), me);
+        let ny = _mm_add_ps(_mm_add_ps(_mm_mul_ps(xs, mb), _mm_mul_ps(ys, md)), mf);
+
+        // Lanes 0/1 hold x/y minima, lanes 2/3 x/y maxima
+        let lo = _mm_min_ps(_mm_unpacklo_ps(nx, ny), _mm_unpackhi_ps(nx, ny));
+        let hi = _mm_max_ps(_mm_unpacklo_ps(nx, ny), _mm_unpackhi_ps(nx, ny));
+        let lo = _mm_min_ps(lo, _mm_movehl_ps(lo, lo));
+        let hi = _mm_max_ps(hi, _mm_movehl_ps(hi, hi));
+        _mm_storeu_ps(r.as_mut_ptr(), _mm_movelh_ps(lo, hi));
+    }
+}
+
+/// Bounding box of each quad
+pub fn quad_bounds(quads: &[[f32; 8]], out: &mut [[f32; 4]]) {
+    match active_level() {
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        SimdLevel::Sse2 | SimdLevel::Sse41 | SimdLevel::Avx | SimdLevel::Avx2 => unsafe {
+            quad_bounds_sse2(quads, out)
+        },
+        _ => {
+            for (q, o) in quads.iter().zip(out.iter_mut()) {
+                let mut b = [q[0], q[1], q[0], q[1]];
+                for p in q[2..].chunks_exact(2) {
+                    b = [
+                        b[0].min(p[0]),
+                        b[1].min(p[1]),
+                        b[2].max(p[0]),
+                        b[3].max(p[1]),
+                    ];
+                }
+                *o = b;
+            }
+        }
+    }
+}
+
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "sse2")]
+unsafe fn quad_bounds_sse2(quads: &[[f32; 8]], out: &mut [[f32; 4]]) {
+    #[cfg(target_arch = "x86")]
+    use std::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use std::arch::x86_64::*;
+
+    for (q, o) in quads.iter().zip(out.iter_mut()) {
+        // [ul, ur] and [ll, lr]
+        let top = _mm_loadu_ps(q.as_ptr());
+        let bottom = _mm_loadu_ps(q.as_ptr().add(4));
+        let lo = _mm_min_ps(top, bottom);
+        let hi = _mm_max_ps(top, bottom);
+        let lo = _mm_min_ps(lo, _mm_movehl_ps(lo, lo));
+        let hi = _mm_max_ps(hi, _mm_movehl_ps(hi, hi));
+        _mm_storeu_ps(o.as_mut_ptr(), _mm_movelh_ps(lo, hi));
+    }
+}
+
+/// Union of rects, or an empty rect (+inf, +inf, -inf, -inf) for none
+pub fn rect_union(rects: &[[f32; 4]]) -> [f32; 4] {
+    let empty = [
+        f32::INFINITY,
+        f32::INFINITY,
+        f32::NEG_INFINITY,
+        f32::NEG_INFINITY,
+    ];
+    let Some((first, rest)) = rects.split_first() else {
+        return empty;
+    };
+    match active_level() {
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        SimdLevel::Sse2 | SimdLevel::Sse41 | SimdLevel::Avx | SimdLevel::Avx2 => unsafe {
+            rect_union_sse2(*first, rest)
+        },
+        _ => rest.iter().fold(*first, |u, r| {
+            [
+                u[0].min(r[0]),
+                u[1].min(r[1]),
+                u[2].max(r[2]),
+                u[3].max(r[3]),
+            ]
+        }),
+    }
+}
+
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "sse2")]
+unsafe fn rect_union_sse2(first: [f32; 4], rest: &[[f32; 4]]) -> [f32; 4] {
+    #[cfg(target_arch = "x86")]
+    use std::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use std::arch::x86_64::*;
+
+    let mut lo = _mm_loadu_ps(first.as_ptr());
+    let mut hi = lo;
+    for r in rest {
+        let v = _mm_loadu_ps(r.as_ptr());
+        lo = _mm_min_ps(lo, v);
+        hi = _mm_max_ps(hi, v);
+    }
+    let mut out = [0.0f32; 4];
+    // Minima from lanes 0/1, maxima from lanes 2/3
+    _mm_storeu_ps(out.as_mut_ptr(), _mm_shuffle_ps(lo, hi, 0b11_10_01_00));
+    out
+}
+
+/// Set `out[i]` to 1 if point `i` is inside `r` (x0 <= x < x1, y0 <= y <
+/// y1) and 0 otherwise; returns the number inside
+pub fn points_in_rect(points: &[(f32, f32)], r: [f32; 4], out: &mut [u8]) -> usize {
+    match active_level() {
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        SimdLevel::Sse2 | SimdLevel::Sse41 | SimdLevel::Avx | SimdLevel::Avx2 => unsafe {
+            points_in_rect_sse2(points, r, out)
+        },
+        _ => points_in_rect_scalar(points, r, out),
+    }
+}
+
+fn points_in_rect_scalar(points: &[(f32, f32)], r: [f32; 4], out: &mut [u8]) -> usize {
+    let mut count = 0;
+    for (&(x, y), o) in points.iter().zip(out.iter_mut()) {
+        let inside = x >= r[0] && x < r[2] && y >= r[1] && y < r[3];
+        *o = inside as u8;
+        count += inside as usize;
+    }
+    count
+}
+
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "sse2")]
+unsafe fn points_in_rect_sse2(points: &[(f32, f32)], r: [f32; 4], out: &mut [u8]) -> usize {
+    #[cfg(target_arch = "x86")]
+    use std::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use std::arch::x86_64::*;
+
+    let lo = _mm_set_ps(r[1], r[0], r[1], r[0]);
+    let hi = _mm_set_ps(r[3], r[2], r[3], r[2]);
+    let n = points.len().min(out.len());
+    let pairs = n / 2;
+    let mut count = 0;
+    // Two points per register
+    for i in 0..pairs {
+        let v = _mm_loadu_ps(points.as_ptr().add(i * 2) as *const f32);
+        let inside = _mm_and_ps(_mm_cmpge_ps(v, lo), _mm_cmplt_ps(v, hi));
+        let mask = _mm_movemask_ps(inside);
+        let a = (mask & 0b0011 == 0b0011) as u8;
+        let b = (mask & 0b1100 == 0b1100) as u8;
+        out[i * 2] = a;
+        out[i * 2 + 1] = b;
+        count += (a + b) as usize;
+    }
+    count + points_in_rect_scalar(&points[pairs * 2..n], r, &mut out[pairs * 2..n])
+}
+
 // ============================================================================
 // Color Space Conversions (SIMD)
 // ============================================================================
@@ -434,7 +719,7 @@ pub fn cmyk_to_rgb(c: f32, m: f32, y: f32, k: f32) -> (f32, f32, f32) {
 
 /// Batch RGB to CMYK conversion
 pub fn rgb_to_cmyk_batch(rgb: &[(f32, f32, f32)], cmyk: &mut [(f32, f32, f32, f32)]) {
-    let level = SIMD_FEATURES.best_level();
+    let level = active_level();
 
     match level {
         #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
@@ -483,21 +768,16 @@ unsafe fn rgb_to_cmyk_batch_sse2(rgb: &[(f32, f32, f32)], cmyk: &mut [(f32, f32,
             continue;
         }
 
-        let inv_1_minus_k = _mm_set1_ps(1.0 / (1.0 - k_scalar));
-
-        // c = (1 - r - k) / (1 - k)
-        let c = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(ones, rv), k), inv_1_minus_k);
-        // m = (1 - g - k) / (1 - k)
-        let m = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(ones, gv), k), inv_1_minus_k);
-        // y = (1 - b - k) / (1 - k)
-        let y = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(ones, bv), k), inv_1_minus_k);
-
-        cmyk[i] = (
-            _mm_cvtss_f32(c),
-            _mm_cvtss_f32(m),
-            _mm_cvtss_f32(y),
-            k_scalar,
+        // c, m, y = (1 - [r, g, b] - k) / (1 - k), dividing rather than
+        // multiplying by the reciprocal so results match the scalar path
+        let cmy = _mm_div_ps(
+            _mm_sub_ps(_mm_sub_ps(ones, _mm_set_ps(0.0, b, g, r)), k),
+            _mm_sub_ps(ones, k),
         );
+        let mut out = [0.0f32; 4];
+        _mm_storeu_ps(out.as_mut_ptr(), cmy);
+
+        cmyk[i] = (out[0], out[1], out[2], k_scalar);
     }
 }
 
@@ -520,7 +800,7 @@ pub fn rgb_to_gray(r: f32, g: f32, b: f32) -> f32 {
 
 /// Fill buffer with a byte value using SIMD
 pub fn buffer_fill(dst: &mut [u8], value: u8) {
-    let level = SIMD_FEATURES.best_level();
+    let level = active_level();
 
     match level {
         #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
@@ -576,7 +856,7 @@ unsafe fn buffer_fill_neon(dst: &mut [u8], value: u8) {
 /// Copy buffer using SIMD
 pub fn buffer_copy(dst: &mut [u8], src: &[u8]) {
     let len = dst.len().min(src.len());
-    let level = SIMD_FEATURES.best_level();
+    let level = active_level();
 
     match level {
         #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
@@ -639,7 +919,7 @@ pub fn buffer_equal(a: &[u8], b: &[u8]) -> bool {
         return false;
     }
 
-    let level = SIMD_FEATURES.best_level();
+    let level = active_level();
 
     match level {
         #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
@@ -684,145 +964,1182 @@ unsafe fn buffer_equal_sse2(a: &[u8], b: &[u8]) -> bool {
 }
 
 // ============================================================================
-// Base64 Encode/Decode (SIMD)
+// PDF Lexer Byte Classification (SIMD)
 // ============================================================================
 
-const BASE64_ALPHABET: &[u8; 64] =
-    b"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-
-/// Base64 encode using SIMD when available
-pub fn base64_encode(input: &[u8]) -> Vec<u8> {
-    let level = SIMD_FEATURES.best_level();
+/// Character classes the PDF lexer scans runs of
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum PdfByteClass {
+    /// NUL, TAB, LF, FF, CR and space
+    Whitespace,
+    /// Neither whitespace nor a delimiter: the body of names, keywords and numbers
+    Regular,
+    /// ASCII `0`-`9`
+    Digit,
+}
 
-    match level {
-        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
-        SimdLevel::Sse2 | SimdLevel::Sse41 | SimdLevel::Avx | SimdLevel::Avx2 => {
-            base64_encode_scalar(input) // Use scalar for now, SIMD base64 is complex
+impl PdfByteClass {
+    /// Scalar classification, the reference for the vector paths
+    #[inline]
+    pub fn matches(self, ch: u8) -> bool {
+        match self {
+            Self::Whitespace => is_pdf_whitespace(ch),
+            Self::Regular => !is_pdf_whitespace(ch) && !is_pdf_delimiter(ch),
+            Self::Digit => ch.is_ascii_digit(),
         }
-        _ => base64_encode_scalar(input),
     }
 }
 
-fn base64_encode_scalar(input: &[u8]) -> Vec<u8> {
-    let output_len = ((input.len() + 2) / 3) * 4;
-    let mut output = Vec::with_capacity(output_len);
+/// PDF whitespace (ISO 32000-1, Table 1)
+#[inline]
+pub fn is_pdf_whitespace(ch: u8) -> bool {
+    matches!(ch, b' ' | b'\t' | b'\r' | b'\n' | 0x00 | 0x0c)
+}
 
-    for chunk in input.chunks(3) {
-        let b0 = chunk[0] as usize;
-        let b1 = chunk.get(1).copied().unwrap_or(0) as usize;
-        let b2 = chunk.get(2).copied().unwrap_or(0) as usize;
+/// PDF delimiter (ISO 32000-1, Table 2)
+#[inline]
+pub fn is_pdf_delimiter(ch: u8) -> bool {
+    matches!(
+        ch,
+        b'(' | b')' | b'<' | b'>' | b'[' | b']' | b'{' | b'}' | b'/' | b'%'
+    )
+}
 
-        let n = (b0 << 16) | (b1 << 8) | b2;
+/// Length of the run of `class` bytes at the start of `data`
+///
+/// Classifies 16 (SSE2/NEON) or 32 (AVX2) bytes per step. Runs in content
+/// streams are mostly short, so inputs under one vector go straight to the
+/// scalar loop.
+pub fn scan_pdf_class(data: &[u8], class: PdfByteClass) -> usize {
+    if data.len() < 16 {
+        return scan_pdf_class_scalar(data, class);
+    }
 
-        output.push(BASE64_ALPHABET[(n >> 18) & 0x3F]);
-        output.push(BASE64_ALPHABET[(n >> 12) & 0x3F]);
+    match active_level() {
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        SimdLevel::Avx2 => unsafe { scan_pdf_class_avx2(data, class) },
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        SimdLevel::Sse2 | SimdLevel::Sse41 | SimdLevel::Avx => unsafe {
+            scan_pdf_class_sse2(data, class)
+        },
+        #[cfg(target_arch = "aarch64")]
+        SimdLevel::Neon => unsafe { scan_pdf_class_neon(data, class) },
+        _ => scan_pdf_class_scalar(data, class),
+    }
+}
 
-        if chunk.len() > 1 {
-            output.push(BASE64_ALPHABET[(n >> 6) & 0x3F]);
-        } else {
-            output.push(b'=');
-        }
+/// Scalar fallback for [`scan_pdf_class`]
+pub fn scan_pdf_class_scalar(data: &[u8], class: PdfByteClass) -> usize {
+    data.iter()
+        .position(|&ch| !class.matches(ch))
+        .unwrap_or(data.len())
+}
 
-        if chunk.len() > 2 {
-            output.push(BASE64_ALPHABET[n & 0x3F]);
-        } else {
-            output.push(b'=');
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "sse2")]
+unsafe fn scan_pdf_class_sse2(data: &[u8], class: PdfByteClass) -> usize {
+    #[cfg(target_arch = "x86")]
+    use std::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use std::arch::x86_64::*;
+
+    let eq_any = |v: __m128i, set: &[u8]| {
+        set.iter().fold(_mm_setzero_si128(), |acc, &c| {
+            _mm_or_si128(acc, _mm_cmpeq_epi8(v, _mm_set1_epi8(c as i8)))
+        })
+    };
+
+    let chunks = data.len() / 16;
+    for i in 0..chunks {
+        let v = _mm_loadu_si128(data.as_ptr().add(i * 16) as *const __m128i);
+        let hits = match class {
+            PdfByteClass::Whitespace => eq_any(v, PDF_WHITESPACE),
+            PdfByteClass::Regular => _mm_xor_si128(
+                _mm_or_si128(eq_any(v, PDF_WHITESPACE), eq_any(v, PDF_DELIMITERS)),
+                _mm_set1_epi8(-1),
+            ),
+            // Signed compares: bytes >= 0x80 are negative and fail the lower bound
+            PdfByteClass::Digit => _mm_and_si128(
+                _mm_cmpgt_epi8(v, _mm_set1_epi8(b'0' as i8 - 1)),
+                _mm_cmplt_epi8(v, _mm_set1_epi8(b'9' as i8 + 1)),
+            ),
+        };
+        let mask = _mm_movemask_epi8(hits) as u32;
+        if mask != 0xFFFF {
+            return i * 16 + (!mask).trailing_zeros() as usize;
         }
     }
 
-    output
-}
-
-/// Base64 decode
-pub fn base64_decode(input: &[u8]) -> Option<Vec<u8>> {
-    base64_decode_scalar(input)
+    let tail = chunks * 16;
+    tail + scan_pdf_class_scalar(&data[tail..], class)
 }
 
-fn base64_decode_scalar(input: &[u8]) -> Option<Vec<u8>> {
-    // Build decode table
-    let mut decode_table = [255u8; 256];
-    for (i, &c) in BASE64_ALPHABET.iter().enumerate() {
-        decode_table[c as usize] = i as u8;
-    }
-    decode_table[b'=' as usize] = 0;
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "avx2")]
+unsafe fn scan_pdf_class_avx2(data: &[u8], class: PdfByteClass) -> usize {
+    #[cfg(target_arch = "x86")]
+    use std::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use std::arch::x86_64::*;
 
-    let mut output = Vec::with_capacity((input.len() / 4) * 3);
+    let eq_any = |v: __m256i, set: &[u8]| {
+        set.iter().fold(_mm256_setzero_si256(), |acc, &c| {
+            _mm256_or_si256(acc, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c as i8)))
+        })
+    };
 
-    for chunk in input.chunks(4) {
-        if chunk.len() < 4 {
-            return None;
+    let chunks = data.len() / 32;
+    for i in 0..chunks {
+        let v = _mm256_loadu_si256(data.as_ptr().add(i * 32) as *const __m256i);
+        let hits = match class {
+            PdfByteClass::Whitespace => eq_any(v, PDF_WHITESPACE),
+            PdfByteClass::Regular => _mm256_xor_si256(
+                _mm256_or_si256(eq_any(v, PDF_WHITESPACE), eq_any(v, PDF_DELIMITERS)),
+                _mm256_set1_epi8(-1),
+            ),
+            PdfByteClass::Digit => _mm256_and_si256(
+                _mm256_cmpgt_epi8(v, _mm256_set1_epi8(b'0' as i8 - 1)),
+                _mm256_cmpgt_epi8(_mm256_set1_epi8(b'9' as i8 + 1), v),
+            ),
+        };
+        let mask = _mm256_movemask_epi8(hits) as u32;
+        if mask != u32::MAX {
+            return i * 32 + (!mask).trailing_zeros() as usize;
         }
+    }
 
-        let a = decode_table[chunk[0] as usize];
-        let b = decode_table[chunk[1] as usize];
-        let c = decode_table[chunk[2] as usize];
-        let d = decode_table[chunk[3] as usize];
+    // At most 31 bytes left: finish with one SSE2 step and the scalar tail
+    let tail = chunks * 32;
+    tail + scan_pdf_class_sse2(&data[tail..], class)
+}
 
-        if a == 255 || b == 255 || c == 255 || d == 255 {
-            return None;
-        }
+#[cfg(target_arch = "aarch64")]
+#[target_feature(enable = "neon")]
+unsafe fn scan_pdf_class_neon(data: &[u8], class: PdfByteClass) -> usize {
+    use std::arch::aarch64::*;
 
-        let n = ((a as u32) << 18) | ((b as u32) << 12) | ((c as u32) << 6) | (d as u32);
+    let eq_any = |v: uint8x16_t, set: &[u8]| {
+        set.iter().fold(vdupq_n_u8(0), |acc, &c| {
+            vorrq_u8(acc, vceqq_u8(v, vdupq_n_u8(c)))
+        })
+    };
 
-        output.push((n >> 16) as u8);
-        if chunk[2] != b'=' {
-            output.push((n >> 8) as u8);
-        }
-        if chunk[3] != b'=' {
-            output.push(n as u8);
+    let chunks = data.len() / 16;
+    for i in 0..chunks {
+        let v = vld1q_u8(data.as_ptr().add(i * 16));
+        let hits = match class {
+            PdfByteClass::Whitespace => eq_any(v, PDF_WHITESPACE),
+            PdfByteClass::Regular => vmvnq_u8(vorrq_u8(
+                eq_any(v, PDF_WHITESPACE),
+                eq_any(v, PDF_DELIMITERS),
+            )),
+            PdfByteClass::Digit => vcltq_u8(vsubq_u8(v, vdupq_n_u8(b'0')), vdupq_n_u8(10)),
+        };
+        // Narrow each byte lane to a nibble: a 64-bit mask, 4 bits per byte
+        let mask = vget_lane_u64(
+            vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hits), 4)),
+            0,
+        );
+        if mask != u64::MAX {
+            return i * 16 + ((!mask).trailing_zeros() / 4) as usize;
         }
     }
 
-    Some(output)
+    let tail = chunks * 16;
+    tail + scan_pdf_class_scalar(&data[tail..], class)
 }
 
+const PDF_WHITESPACE: &[u8] = b" \t\r\n\x00\x0c";
+const PDF_DELIMITERS: &[u8] = b"()<>[]{}/%";
+
 // ============================================================================
-// FFI Functions
+// Byte Set Search (SIMD)
 // ============================================================================
 
-use super::Handle;
-use std::ffi::c_int;
+/// Length of the run at the start of `data` holding none of `stops`
+///
+/// For tokenizers skipping to their next delimiter, such as the `<` that
+/// ends XML character data or the quote closing an attribute value. Each
+/// stop byte costs one compare per 16 (SSE2/NEON) or 32 (AVX2) bytes, so
+/// keep `stops` short; inputs under one vector go straight to the scalar
+/// loop.
+pub fn scan_until_any(data: &[u8], stops: &[u8]) -> usize {
+    if data.len() < 16 {
+        return scan_until_any_scalar(data, stops);
+    }
 
-/// Get detected SIMD features
-#[unsafe(no_mangle)]
-pub extern "C" fn fz_simd_features() -> SimdFeatures {
-    *SIMD_FEATURES
+    match active_level() {
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        SimdLevel::Avx2 => unsafe { scan_until_any_avx2(data, stops) },
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        SimdLevel::Sse2 | SimdLevel::Sse41 | SimdLevel::Avx => unsafe {
+            scan_until_any_sse2(data, stops)
+        },
+        #[cfg(target_arch = "aarch64")]
+        SimdLevel::Neon => unsafe { scan_until_any_neon(data, stops) },
+        _ => scan_until_any_scalar(data, stops),
+    }
 }
 
-/// Get best SIMD level
-#[unsafe(no_mangle)]
-pub extern "C" fn fz_simd_level() -> c_int {
-    SIMD_FEATURES.best_level() as c_int
+/// Scalar fallback for [`scan_until_any`]
+pub fn scan_until_any_scalar(data: &[u8], stops: &[u8]) -> usize {
+    data.iter()
+        .position(|ch| stops.contains(ch))
+        .unwrap_or(data.len())
 }
 
-/// Check if SIMD is available
-#[unsafe(no_mangle)]
-pub extern "C" fn fz_has_simd() -> c_int {
-    if SIMD_FEATURES.has_simd() { 1 } else { 0 }
-}
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "sse2")]
+unsafe fn scan_until_any_sse2(data: &[u8], stops: &[u8]) -> usize {
+    #[cfg(target_arch = "x86")]
+    use std::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use std::arch::x86_64::*;
 
-/// SIMD matrix concatenation
-#[unsafe(no_mangle)]
-pub extern "C" fn fz_simd_matrix_concat(left: SimdMatrix, right: SimdMatrix) -> SimdMatrix {
-    matrix_concat(&left, &right)
-}
+    let chunks = data.len() / 16;
+    for i in 0..chunks {
+        let v = _mm_loadu_si128(data.as_ptr().add(i * 16) as *const __m128i);
+        let hits = stops.iter().fold(_mm_setzero_si128(), |acc, &c| {
+            _mm_or_si128(acc, _mm_cmpeq_epi8(v, _mm_set1_epi8(c as i8)))
+        });
+        let mask = _mm_movemask_epi8(hits) as u32;
+        if mask != 0 {
+            return i * 16 + mask.trailing_zeros() as usize;
+        }
+    }
 
-/// Transform a point using SIMD matrix
-#[unsafe(no_mangle)]
-pub extern "C" fn fz_simd_transform_point(x: c_float, y: c_float, m: SimdMatrix) -> [c_float; 2] {
-    let (nx, ny) = transform_point(x, y, &m);
-    [nx, ny]
+    let tail = chunks * 16;
+    tail + scan_until_any_scalar(&data[tail..], stops)
 }
 
-/// Transform multiple points
-#[unsafe(no_mangle)]
-pub extern "C" fn fz_simd_transform_points(
-    points: *mut c_float,
-    count: usize,
-    m: SimdMatrix,
-) -> c_int {
-    if points.is_null() || count == 0 {
-        return -1;
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "avx2")]
+unsafe fn scan_until_any_avx2(data: &[u8], stops: &[u8]) -> usize {
+    #[cfg(target_arch = "x86")]
+    use std::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use std::arch::x86_64::*;
+
+    let chunks = data.len() / 32;
+    for i in 0..chunks {
+        let v = _mm256_loadu_si256(data.as_ptr().add(i * 32) as *const __m256i);
+        let hits = stops.iter().fold(_mm256_setzero_si256(), |acc, &c| {
+            _mm256_or_si256(acc, _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c as i8)))
+        });
+        let mask = _mm256_movemask_epi8(hits) as u32;
+        if mask != 0 {
+            return i * 32 + mask.trailing_zeros() as usize;
+        }
+    }
+
+    // At most 31 bytes left: finish with one SSE2 step and the scalar tail
+    let tail = chunks * 32;
+    tail + scan_until_any_sse2(&data[tail..], stops)
+}
+
+#[cfg(target_arch = "aarch64")]
+#[target_feature(enable = "neon")]
+unsafe fn scan_until_any_neon(data: &[u8], stops: &[u8]) -> usize {
+    use std::arch::aarch64::*;
+
+    let chunks = data.len() / 16;
+    for i in 0..chunks {
+        let v = vld1q_u8(data.as_ptr().add(i * 16));
+        let hits = stops.iter().fold(vdupq_n_u8(0), |acc, &c| {
+            vorrq_u8(acc, vceqq_u8(v, vdupq_n_u8(c)))
+        });
+        // Narrow each byte lane to a nibble: a 64-bit mask, 4 bits per byte
+        let mask = vget_lane_u64(
+            vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hits), 4)),
+            0,
+        );
+        if mask != 0 {
+            return i * 16 + (mask.trailing_zeros() / 4) as usize;
+        }
+    }
+
+    let tail = chunks * 16;
+    tail + scan_until_any_scalar(&data[tail..], stops)
+}
+
+// ============================================================================
+// Substring Search (SIMD)
+// ============================================================================
+
+/// Offset of the first occurrence of `needle` in `haystack`
+///
+/// Compares the needle's first and last bytes against 16 (SSE2/NEON) or 32
+/// (AVX2) candidate positions at once and only checks the full needle where
+/// both match, which in PDF data is rare for needles like `obj` or
+/// `startxref`.
+pub fn find_bytes(haystack: &[u8], needle: &[u8]) -> Option<usize> {
+    if needle.is_empty() {
+        return Some(0);
+    }
+    if haystack.len() < needle.len() + 16 {
+        return find_bytes_scalar(haystack, needle);
+    }
+
+    // The table only holds kernels the CPU runs
+    unsafe { (kernels().find_bytes)(haystack, needle) }
+}
+
+/// Byte search, as held in the kernel dispatch table; the haystack is at
+/// least 16 bytes longer than the non-empty needle
+pub(super) type FindFn = unsafe fn(&[u8], &[u8]) -> Option<usize>;
+
+/// Byte search the dispatch table uses at `level`
+pub(super) fn find_kernel(level: SimdLevel) -> FindFn {
+    match level {
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        SimdLevel::Avx2 => find_bytes_avx2,
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        SimdLevel::Sse2 | SimdLevel::Sse41 | SimdLevel::Avx => find_bytes_sse2,
+        #[cfg(target_arch = "aarch64")]
+        SimdLevel::Neon => find_bytes_neon,
+        _ => find_bytes_scalar,
+    }
+}
+
+/// Scalar fallback for [`find_bytes`]
+pub fn find_bytes_scalar(haystack: &[u8], needle: &[u8]) -> Option<usize> {
+    if needle.is_empty() {
+        return Some(0);
+    }
+    haystack.windows(needle.len()).position(|w| w == needle)
+}
+
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "sse2")]
+unsafe fn find_bytes_sse2(haystack: &[u8], needle: &[u8]) -> Option<usize> {
+    #[cfg(target_arch = "x86")]
+    use std::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use std::arch::x86_64::*;
+
+    let last = needle.len() - 1;
+    let first_v = _mm_set1_epi8(needle[0] as i8);
+    let last_v = _mm_set1_epi8(needle[last] as i8);
+    // Candidate starts; the last-byte load at `i + last` stays in bounds
+    let starts = haystack.len() - last;
+
+    let mut i = 0;
+    while i + 16 <= starts {
+        let a = _mm_loadu_si128(haystack.as_ptr().add(i) as *const __m128i);
+        let b = _mm_loadu_si128(haystack.as_ptr().add(i + last) as *const __m128i);
+        let mut mask = _mm_movemask_epi8(_mm_and_si128(
+            _mm_cmpeq_epi8(a, first_v),
+            _mm_cmpeq_epi8(b, last_v),
+        )) as u32;
+        while mask != 0 {
+            let at = i + mask.trailing_zeros() as usize;
+            if &haystack[at..at + needle.len()] == needle {
+                return Some(at);
+            }
+            mask &= mask - 1;
+        }
+        i += 16;
+    }
+
+    find_bytes_scalar(&haystack[i..], needle).map(|p| p + i)
+}
+
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "avx2")]
+unsafe fn find_bytes_avx2(haystack: &[u8], needle: &[u8]) -> Option<usize> {
+    #[cfg(target_arch = "x86")]
+    use std::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use std::arch::x86_64::*;
+
+    let last = needle.len() - 1;
+    let first_v = _mm256_set1_epi8(needle[0] as i8);
+    let last_v = _mm256_set1_epi8(needle[last] as i8);
+    let starts = haystack.len() - last;
+
+    let mut i = 0;
+    while i + 32 <= starts {
+        let a = _mm256_loadu_si256(haystack.as_ptr().add(i) as *const __m256i);
+        let b = _mm256_loadu_si256(haystack.as_ptr().add(i + last) as *const __m256i);
+        let mut mask = _mm256_movemask_epi8(_mm256_and_si256(
+            _mm256_cmpeq_epi8(a, first_v),
+            _mm256_cmpeq_epi8(b, last_v),
+        )) as u32;
+        while mask != 0 {
+            let at = i + mask.trailing_zeros() as usize;
+            if &haystack[at..at + needle.len()] == needle {
+                return Some(at);
+            }
+            mask &= mask - 1;
+        }
+        i += 32;
+    }
+
+    find_bytes_sse2(&haystack[i..], needle).map(|p| p + i)
+}
+
+#[cfg(target_arch = "aarch64")]
+#[target_feature(enable = "neon")]
+unsafe fn find_bytes_neon(haystack: &[u8], needle: &[u8]) -> Option<usize> {
+    use std::arch::aarch64::*;
+
+    let last = needle.len() - 1;
+    let first_v = vdupq_n_u8(needle[0]);
+    let last_v = vdupq_n_u8(needle[last]);
+    let starts = haystack.len() - last;
+
+    let mut i = 0;
+    while i + 16 <= starts {
+        let a = vld1q_u8(haystack.as_ptr().add(i));
+        let b = vld1q_u8(haystack.as_ptr().add(i + last));
+        let hits = vandq_u8(vceqq_u8(a, first_v), vceqq_u8(b, last_v));
+        // 4 bits per byte lane, as in scan_pdf_class_neon
+        let mut mask = vget_lane_u64(
+            vreinterpret_u64_u8(vshrn_n_u16(vreinterpretq_u16_u8(hits), 4)),
+            0,
+        );
+        while mask != 0 {
+            let lane = (mask.trailing_zeros() / 4) as usize;
+            let at = i + lane;
+            if &haystack[at..at + needle.len()] == needle {
+                return Some(at);
+            }
+            mask &= !(0xF << (lane * 4));
+        }
+        i += 16;
+    }
+
+    find_bytes_scalar(&haystack[i..], needle).map(|p| p + i)
+}
+
+// ============================================================================
+// Content Hashing (SIMD)
+// ============================================================================
+
+/// Per-lane keys the hash starts from
+const HASH_KEYS: [u64; 4] = [
+    0x9e37_79b9_7f4a_7c15,
+    0xc2b2_ae3d_27d4_eb4f,
+    0x1656_67b1_9e37_79f9,
+    0x85eb_ca77_c2b2_ae63,
+];
+
+/// Added to every key after each block, so moving a block changes the hash
+const HASH_STEP: u64 = 0x27d4_eb2f_1656_67c5;
+
+/// 64-bit hash of `data`, for bucketing; equal hashes still need a compare
+///
+/// Each 32-byte block feeds four independent 64-bit lanes (the XXH3
+/// accumulate step: a 32x32-bit multiply of the keyed input plus the
+/// neighbouring lane's raw input) and the lanes are mixed at the end. The
+/// SSE2 path does two lanes per register and gives the same result.
+pub fn hash64(data: &[u8]) -> u64 {
+    let blocks = data.len() / 32;
+    let acc = match active_level() {
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        SimdLevel::Sse2 | SimdLevel::Sse41 | SimdLevel::Avx | SimdLevel::Avx2 => unsafe {
+            hash64_blocks_sse2(&data[..blocks * 32])
+        },
+        _ => hash64_blocks_scalar(&data[..blocks * 32]),
+    };
+    hash64_finish(acc, &data[blocks * 32..], data.len())
+}
+
+fn hash64_blocks_scalar(data: &[u8]) -> [u64; 4] {
+    let mut acc = [0u64; 4];
+    let mut keys = HASH_KEYS;
+    for block in data.chunks_exact(32) {
+        for i in 0..4 {
+            let v = u64::from_le_bytes(block[i * 8..i * 8 + 8].try_into().unwrap());
+            let k = v ^ keys[i];
+            acc[i ^ 1] = acc[i ^ 1].wrapping_add(v);
+            acc[i] = acc[i].wrapping_add((k & 0xffff_ffff).wrapping_mul(k >> 32));
+            keys[i] = keys[i].wrapping_add(HASH_STEP);
+        }
+    }
+    acc
+}
+
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "sse2")]
+unsafe fn hash64_blocks_sse2(data: &[u8]) -> [u64; 4] {
+    #[cfg(target_arch = "x86")]
+    use std::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use std::arch::x86_64::*;
+
+    let mut acc = [_mm_setzero_si128(); 2];
+    let mut keys = [
+        _mm_set_epi64x(HASH_KEYS[1] as i64, HASH_KEYS[0] as i64),
+        _mm_set_epi64x(HASH_KEYS[3] as i64, HASH_KEYS[2] as i64),
+    ];
+    let step = _mm_set1_epi64x(HASH_STEP as i64);
+
+    for block in 0..data.len() / 32 {
+        for j in 0..2 {
+            let v = _mm_loadu_si128(data.as_ptr().add(block * 32 + j * 16) as *const __m128i);
+            let k = _mm_xor_si128(v, keys[j]);
+            let product = _mm_mul_epu32(k, _mm_srli_epi64(k, 32));
+            // Swap the two 64-bit lanes: each takes its neighbour's input
+            let swapped = _mm_shuffle_epi32(v, 0b01_00_11_10);
+            acc[j] = _mm_add_epi64(acc[j], _mm_add_epi64(product, swapped));
+            keys[j] = _mm_add_epi64(keys[j], step);
+        }
+    }
+
+    let mut out = [0u64; 4];
+    _mm_storeu_si128(out.as_mut_ptr() as *mut __m128i, acc[0]);
+    _mm_storeu_si128(out.as_mut_ptr().add(2) as *mut __m128i, acc[1]);
+    out
+}
+
+/// Murmur3's 64-bit finalizer
+fn hash64_mix(mut x: u64) -> u64 {
+    x ^= x >> 33;
+    x = x.wrapping_mul(0xff51_afd7_ed55_8ccd);
+    x ^= x >> 33;
+    x = x.wrapping_mul(0xc4ce_b9fe_1a85_ec53);
+    x ^ (x >> 33)
+}
+
+fn hash64_finish(acc: [u64; 4], tail: &[u8], len: usize) -> u64 {
+    let mut h = hash64_mix(len as u64 ^ HASH_KEYS[0]);
+    for lane in acc {
+        h = hash64_mix(h ^ lane);
+    }
+    for chunk in tail.chunks(8) {
+        let mut word = [0u8; 8];
+        word[..chunk.len()].copy_from_slice(chunk);
+        h = hash64_mix(h ^ u64::from_le_bytes(word));
+    }
+    h
+}
+
+// ============================================================================
+// JSON Structural Classification (SIMD)
+// ============================================================================
+
+/// Bytes of one 64-byte JSON block, one bit per byte (bit i is byte i)
+#[derive(Debug, Clone, Copy, Default, PartialEq, Eq)]
+pub struct JsonBlockMasks {
+    /// `"`
+    pub quote: u64,
+    /// `\`
+    pub backslash: u64,
+    /// `{`, `}`, `[`, `]`, `:` and `,`
+    pub operator: u64,
+}
+
+/// Classify `data`, a whole number of 64-byte blocks, into `out`
+///
+/// Stage one of a simdjson-style parse: the caller turns the masks into
+/// structural positions, so string contents are never looked at byte by
+/// byte. `[` and `]` differ from `{` and `}` only in bit 5, so the vector
+/// paths fold them with one OR and need four compares for the operators.
+pub fn json_classify_blocks(data: &[u8], out: &mut [JsonBlockMasks]) {
+    assert_eq!(data.len(), out.len() * 64);
+
+    match active_level() {
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        SimdLevel::Avx2 => unsafe { json_classify_blocks_avx2(data, out) },
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        SimdLevel::Sse2 | SimdLevel::Sse41 | SimdLevel::Avx => unsafe {
+            json_classify_blocks_sse2(data, out)
+        },
+        #[cfg(target_arch = "aarch64")]
+        SimdLevel::Neon => unsafe { json_classify_blocks_neon(data, out) },
+        _ => json_classify_blocks_scalar(data, out),
+    }
+}
+
+/// Scalar fallback for [`json_classify_blocks`]
+pub fn json_classify_blocks_scalar(data: &[u8], out: &mut [JsonBlockMasks]) {
+    for (block, masks) in data.chunks_exact(64).zip(out.iter_mut()) {
+        *masks = JsonBlockMasks::default();
+        for (i, &ch) in block.iter().enumerate() {
+            let bit = 1u64 << i;
+            match ch {
+                b'"' => masks.quote |= bit,
+                b'\\' => masks.backslash |= bit,
+                b'{' | b'}' | b'[' | b']' | b':' | b',' => masks.operator |= bit,
+                _ => {}
+            }
+        }
+    }
+}
+
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "sse2")]
+unsafe fn json_classify_blocks_sse2(data: &[u8], out: &mut [JsonBlockMasks]) {
+    #[cfg(target_arch = "x86")]
+    use std::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use std::arch::x86_64::*;
+
+    let eq = |v: __m128i, c: u8| _mm_cmpeq_epi8(v, _mm_set1_epi8(c as i8));
+    for (block, masks) in out.iter_mut().enumerate() {
+        *masks = JsonBlockMasks::default();
+        for j in 0..4 {
+            let v = _mm_loadu_si128(data.as_ptr().add(block * 64 + j * 16) as *const __m128i);
+            let folded = _mm_or_si128(v, _mm_set1_epi8(0x20));
+            let op = _mm_or_si128(
+                _mm_or_si128(eq(folded, b'{'), eq(folded, b'}')),
+                _mm_or_si128(eq(v, b':'), eq(v, b',')),
+            );
+            let shift = j * 16;
+            masks.quote |= (_mm_movemask_epi8(eq(v, b'"')) as u16 as u64) << shift;
+            masks.backslash |= (_mm_movemask_epi8(eq(v, b'\\')) as u16 as u64) << shift;
+            masks.operator |= (_mm_movemask_epi8(op) as u16 as u64) << shift;
+        }
+    }
+}
+
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "avx2")]
+unsafe fn json_classify_blocks_avx2(data: &[u8], out: &mut [JsonBlockMasks]) {
+    #[cfg(target_arch = "x86")]
+    use std::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use std::arch::x86_64::*;
+
+    let eq = |v: __m256i, c: u8| _mm256_cmpeq_epi8(v, _mm256_set1_epi8(c as i8));
+    for (block, masks) in out.iter_mut().enumerate() {
+        *masks = JsonBlockMasks::default();
+        for j in 0..2 {
+            let v = _mm256_loadu_si256(data.as_ptr().add(block * 64 + j * 32) as *const __m256i);
+            let folded = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+            let op = _mm256_or_si256(
+                _mm256_or_si256(eq(folded, b'{'), eq(folded, b'}')),
+                _mm256_or_si256(eq(v, b':'), eq(v, b',')),
+            );
+            let shift = j * 32;
+            masks.quote |= (_mm256_movemask_epi8(eq(v, b'"')) as u32 as u64) << shift;
+            masks.backslash |= (_mm256_movemask_epi8(eq(v, b'\\')) as u32 as u64) << shift;
+            masks.operator |= (_mm256_movemask_epi8(op) as u32 as u64) << shift;
+        }
+    }
+}
+
+#[cfg(target_arch = "aarch64")]
+#[target_feature(enable = "neon")]
+unsafe fn json_classify_blocks_neon(data: &[u8], out: &mut [JsonBlockMasks]) {
+    use std::arch::aarch64::*;
+
+    // Weight each lane by its bit, then add pairs down to one byte per
+    // eight lanes: four compare results become one 64-bit mask
+    const WEIGHTS: [u8; 16] = [1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128];
+    let weights = vld1q_u8(WEIGHTS.as_ptr());
+    let bitmask = |m: [uint8x16_t; 4]| {
+        let s0 = vpaddq_u8(vandq_u8(m[0], weights), vandq_u8(m[1], weights));
+        let s1 = vpaddq_u8(vandq_u8(m[2], weights), vandq_u8(m[3], weights));
+        let s = vpaddq_u8(s0, s1);
+        vgetq_lane_u64(vreinterpretq_u64_u8(vpaddq_u8(s, s)), 0)
+    };
+
+    for (block, masks) in out.iter_mut().enumerate() {
+        let base = data.as_ptr().add(block * 64);
+        let v = [
+            vld1q_u8(base),
+            vld1q_u8(base.add(16)),
+            vld1q_u8(base.add(32)),
+            vld1q_u8(base.add(48)),
+        ];
+        let op = v.map(|v| {
+            let folded = vorrq_u8(v, vdupq_n_u8(0x20));
+            vorrq_u8(
+                vorrq_u8(
+                    vceqq_u8(folded, vdupq_n_u8(b'{')),
+                    vceqq_u8(folded, vdupq_n_u8(b'}')),
+                ),
+                vorrq_u8(vceqq_u8(v, vdupq_n_u8(b':')), vceqq_u8(v, vdupq_n_u8(b','))),
+            )
+        });
+        *masks = JsonBlockMasks {
+            quote: bitmask(v.map(|v| vceqq_u8(v, vdupq_n_u8(b'"')))),
+            backslash: bitmask(v.map(|v| vceqq_u8(v, vdupq_n_u8(b'\\')))),
+            operator: bitmask(op),
+        };
+    }
+}
+
+// ============================================================================
+// Base64 Encode/Decode (SIMD)
+// ============================================================================
+
+const BASE64_ALPHABET: &[u8; 64] =
+    b"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+/// Base64 encode using SIMD when available
+pub fn base64_encode(input: &[u8]) -> Vec<u8> {
+    let level = active_level();
+
+    match level {
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        SimdLevel::Sse2 | SimdLevel::Sse41 | SimdLevel::Avx | SimdLevel::Avx2 => {
+            base64_encode_scalar(input) // Use scalar for now, SIMD base64 is complex
+        }
+        _ => base64_encode_scalar(input),
+    }
+}
+
+fn base64_encode_scalar(input: &[u8]) -> Vec<u8> {
+    let output_len = ((input.len() + 2) / 3) * 4;
+    let mut output = Vec::with_capacity(output_len);
+
+    for chunk in input.chunks(3) {
+        let b0 = chunk[0] as usize;
+        let b1 = chunk.get(1).copied().unwrap_or(0) as usize;
+        let b2 = chunk.get(2).copied().unwrap_or(0) as usize;
+
+        let n = (b0 << 16) | (b1 << 8) | b2;
+
+        output.push(BASE64_ALPHABET[(n >> 18) & 0x3F]);
+        output.push(BASE64_ALPHABET[(n >> 12) & 0x3F]);
+
+        if chunk.len() > 1 {
+            output.push(BASE64_ALPHABET[(n >> 6) & 0x3F]);
+        } else {
+            output.push(b'=');
+        }
+
+        if chunk.len() > 2 {
+            output.push(BASE64_ALPHABET[n & 0x3F]);
+        } else {
+            output.push(b'=');
+        }
+    }
+
+    output
+}
+
+/// Base64 decode
+pub fn base64_decode(input: &[u8]) -> Option<Vec<u8>> {
+    base64_decode_scalar(input)
+}
+
+fn base64_decode_scalar(input: &[u8]) -> Option<Vec<u8>> {
+    // Build decode table
+    let mut decode_table = [255u8; 256];
+    for (i, &c) in BASE64_ALPHABET.iter().enumerate() {
+        decode_table[c as usize] = i as u8;
+    }
+    decode_table[b'=' as usize] = 0;
+
+    let mut output = Vec::with_capacity((input.len() / 4) * 3);
+
+    for chunk in input.chunks(4) {
+        if chunk.len() < 4 {
+            return None;
+        }
+
+        let a = decode_table[chunk[0] as usize];
+        let b = decode_table[chunk[1] as usize];
+        let c = decode_table[chunk[2] as usize];
+        let d = decode_table[chunk[3] as usize];
+
+        if a == 255 || b == 255 || c == 255 || d == 255 {
+            return None;
+        }
+
+        let n = ((a as u32) << 18) | ((b as u32) << 12) | ((c as u32) << 6) | (d as u32);
+
+        output.push((n >> 16) as u8);
+        if chunk[2] != b'=' {
+            output.push((n >> 8) as u8);
+        }
+        if chunk[3] != b'=' {
+            output.push(n as u8);
+        }
+    }
+
+    Some(output)
+}
+
+// ============================================================================
+// Bit Packing (SIMD)
+// ============================================================================
+
+/// Set bit `i` of `out`, MSB first, where `values[i] < thresholds[i]`
+///
+/// This is the inner loop of thresholding and ordered halftoning: 16
+/// (SSE2/NEON) or 32 (AVX2) pixels per compare, each compare giving two or
+/// four finished output bytes. `out` needs `values.len().div_ceil(8)`
+/// bytes; every covered byte is overwritten and padding bits in the last
+/// one are cleared.
+pub fn pack_below(values: &[u8], thresholds: &[u8], out: &mut [u8]) {
+    let len = values.len().min(thresholds.len());
+    assert!(out.len() >= len.div_ceil(8));
+    let (values, thresholds) = (&values[..len], &thresholds[..len]);
+
+    match active_level() {
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        SimdLevel::Avx2 => unsafe { pack_below_avx2(values, thresholds, out) },
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        SimdLevel::Sse2 | SimdLevel::Sse41 | SimdLevel::Avx => unsafe {
+            pack_below_sse2(values, thresholds, out)
+        },
+        #[cfg(target_arch = "aarch64")]
+        SimdLevel::Neon => unsafe { pack_below_neon(values, thresholds, out) },
+        _ => pack_below_scalar(values, thresholds, out),
+    }
+}
+
+/// Scalar fallback for [`pack_below`]
+pub fn pack_below_scalar(values: &[u8], thresholds: &[u8], out: &mut [u8]) {
+    for ((byte, v), t) in out
+        .iter_mut()
+        .zip(values.chunks(8))
+        .zip(thresholds.chunks(8))
+    {
+        *byte = v
+            .iter()
+            .zip(t)
+            .enumerate()
+            .fold(0, |acc, (k, (&v, &t))| acc | (((v < t) as u8) << (7 - k)));
+    }
+}
+
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "sse2")]
+unsafe fn pack_below_sse2(values: &[u8], thresholds: &[u8], out: &mut [u8]) {
+    #[cfg(target_arch = "x86")]
+    use std::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use std::arch::x86_64::*;
+
+    let chunks = values.len() / 16;
+    for i in 0..chunks {
+        let v = _mm_loadu_si128(values.as_ptr().add(i * 16) as *const __m128i);
+        let t = _mm_loadu_si128(thresholds.as_ptr().add(i * 16) as *const __m128i);
+        // No unsigned compare: v >= t exactly where max(v, t) == v
+        let at_least = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_max_epu8(v, t), v)) as u32;
+        let below = !at_least;
+        // movemask puts pixel 0 in bit 0; bitmaps want it in the MSB
+        out[i * 2] = (below as u8).reverse_bits();
+        out[i * 2 + 1] = ((below >> 8) as u8).reverse_bits();
+    }
+
+    let tail = chunks * 16;
+    pack_below_scalar(&values[tail..], &thresholds[tail..], &mut out[tail / 8..]);
+}
+
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "avx2")]
+unsafe fn pack_below_avx2(values: &[u8], thresholds: &[u8], out: &mut [u8]) {
+    #[cfg(target_arch = "x86")]
+    use std::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use std::arch::x86_64::*;
+
+    let chunks = values.len() / 32;
+    for i in 0..chunks {
+        let v = _mm256_loadu_si256(values.as_ptr().add(i * 32) as *const __m256i);
+        let t = _mm256_loadu_si256(thresholds.as_ptr().add(i * 32) as *const __m256i);
+        let at_least = _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_max_epu8(v, t), v)) as u32;
+        // Byte k of the mask is pixels 8k..8k+8, LSB first
+        let below = (!at_least).to_le_bytes();
+        for (k, b) in below.iter().enumerate() {
+            out[i * 4 + k] = b.reverse_bits();
+        }
+    }
+
+    // At most 31 pixels left: finish with one SSE2 step and the scalar tail
+    let tail = chunks * 32;
+    pack_below_sse2(&values[tail..], &thresholds[tail..], &mut out[tail / 8..]);
+}
+
+#[cfg(target_arch = "aarch64")]
+#[target_feature(enable = "neon")]
+unsafe fn pack_below_neon(values: &[u8], thresholds: &[u8], out: &mut [u8]) {
+    use std::arch::aarch64::*;
+
+    // Each lane's bit in its output byte, MSB first
+    const WEIGHTS: [u8; 16] = [128, 64, 32, 16, 8, 4, 2, 1, 128, 64, 32, 16, 8, 4, 2, 1];
+    let weights = vld1q_u8(WEIGHTS.as_ptr());
+
+    let chunks = values.len() / 16;
+    for i in 0..chunks {
+        let v = vld1q_u8(values.as_ptr().add(i * 16));
+        let t = vld1q_u8(thresholds.as_ptr().add(i * 16));
+        let bits = vandq_u8(vcltq_u8(v, t), weights);
+        // The weights in each half are distinct bits, so the sum is the byte
+        out[i * 2] = vaddv_u8(vget_low_u8(bits));
+        out[i * 2 + 1] = vaddv_u8(vget_high_u8(bits));
+    }
+
+    let tail = chunks * 16;
+    pack_below_scalar(&values[tail..], &thresholds[tail..], &mut out[tail / 8..]);
+}
+
+/// Length of the run of copies of `data[0]` at the start of `data`,
+/// counting at most `max` bytes
+///
+/// Compares eight bytes at a time, which is most of the work when
+/// run-length coding the long blank stretches of a print raster.
+pub fn run_length(data: &[u8], max: usize) -> usize {
+    let data = &data[..data.len().min(max)];
+    let Some(&first) = data.first() else {
+        return 0;
+    };
+    let pattern = u64::from_ne_bytes([first; 8]);
+    let mut n = 0;
+    for word in data.chunks_exact(8) {
+        let diff = u64::from_ne_bytes(word.try_into().unwrap()) ^ pattern;
+        if diff != 0 {
+            let same = if cfg!(target_endian = "little") {
+                diff.trailing_zeros()
+            } else {
+                diff.leading_zeros()
+            };
+            return n + (same / 8) as usize;
+        }
+        n += 8;
+    }
+    n + data[n..].iter().take_while(|&&b| b == first).count()
+}
+
+// ============================================================================
+// Codepoint Scanning (SIMD)
+// ============================================================================
+
+/// Length of the run at the start of `values` that is below `bound`
+///
+/// Text takes its fast paths this way: a line whose codepoints are all
+/// below 0x80 is ASCII, and one below 0x590 holds no right-to-left
+/// script. Compares 4 (SSE2/NEON) or 8 (AVX2) values at a time.
+pub fn prefix_below(values: &[u32], bound: u32) -> usize {
+    match active_level() {
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        SimdLevel::Avx2 => unsafe { prefix_below_avx2(values, bound) },
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        SimdLevel::Sse2 | SimdLevel::Sse41 | SimdLevel::Avx => unsafe {
+            prefix_below_sse2(values, bound)
+        },
+        #[cfg(target_arch = "aarch64")]
+        SimdLevel::Neon => unsafe { prefix_below_neon(values, bound) },
+        _ => prefix_below_scalar(values, bound),
+    }
+}
+
+/// Scalar fallback for [`prefix_below`]
+pub fn prefix_below_scalar(values: &[u32], bound: u32) -> usize {
+    values.iter().take_while(|&&v| v < bound).count()
+}
+
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "sse2")]
+unsafe fn prefix_below_sse2(values: &[u32], bound: u32) -> usize {
+    #[cfg(target_arch = "x86")]
+    use std::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use std::arch::x86_64::*;
+
+    // No unsigned compare: flipping the sign bits makes the signed one do
+    let flip = _mm_set1_epi32(i32::MIN);
+    let limit = _mm_xor_si128(_mm_set1_epi32(bound as i32), flip);
+    let chunks = values.len() / 4;
+    for i in 0..chunks {
+        let v = _mm_loadu_si128(values.as_ptr().add(i * 4) as *const __m128i);
+        let below = _mm_cmpgt_epi32(limit, _mm_xor_si128(v, flip));
+        let mask = _mm_movemask_ps(_mm_castsi128_ps(below)) as u32;
+        if mask != 0xF {
+            return i * 4 + (!mask).trailing_zeros() as usize;
+        }
+    }
+
+    let tail = chunks * 4;
+    tail + prefix_below_scalar(&values[tail..], bound)
+}
+
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "avx2")]
+unsafe fn prefix_below_avx2(values: &[u32], bound: u32) -> usize {
+    #[cfg(target_arch = "x86")]
+    use std::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use std::arch::x86_64::*;
+
+    let flip = _mm256_set1_epi32(i32::MIN);
+    let limit = _mm256_xor_si256(_mm256_set1_epi32(bound as i32), flip);
+    let chunks = values.len() / 8;
+    for i in 0..chunks {
+        let v = _mm256_loadu_si256(values.as_ptr().add(i * 8) as *const __m256i);
+        let below = _mm256_cmpgt_epi32(limit, _mm256_xor_si256(v, flip));
+        let mask = _mm256_movemask_ps(_mm256_castsi256_ps(below)) as u32;
+        if mask != 0xFF {
+            return i * 8 + (!mask).trailing_zeros() as usize;
+        }
+    }
+
+    // At most 7 values left: finish with one SSE2 step and the scalar tail
+    let tail = chunks * 8;
+    tail + prefix_below_sse2(&values[tail..], bound)
+}
+
+#[cfg(target_arch = "aarch64")]
+#[target_feature(enable = "neon")]
+unsafe fn prefix_below_neon(values: &[u32], bound: u32) -> usize {
+    use std::arch::aarch64::*;
+
+    let limit = vdupq_n_u32(bound);
+    let chunks = values.len() / 4;
+    for i in 0..chunks {
+        let v = vld1q_u32(values.as_ptr().add(i * 4));
+        // All lanes below: every mask lane is all ones
+        if vminvq_u32(vcltq_u32(v, limit)) != u32::MAX {
+            return i * 4 + prefix_below_scalar(&values[i * 4..i * 4 + 4], bound);
+        }
+    }
+
+    let tail = chunks * 4;
+    tail + prefix_below_scalar(&values[tail..], bound)
+}
+
+/// Length of the run of ASCII bytes at the start of `data`
+///
+/// An ASCII span is already normalized and folds byte by byte, so string
+/// batches find these with a 16 (SSE2/NEON) or 32 (AVX2) byte test of
+/// the high bits and only decode what lies between them.
+pub fn ascii_prefix(data: &[u8]) -> usize {
+    match active_level() {
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        SimdLevel::Avx2 => unsafe { ascii_prefix_avx2(data) },
+        #[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+        SimdLevel::Sse2 | SimdLevel::Sse41 | SimdLevel::Avx => unsafe { ascii_prefix_sse2(data) },
+        #[cfg(target_arch = "aarch64")]
+        SimdLevel::Neon => unsafe { ascii_prefix_neon(data) },
+        _ => ascii_prefix_scalar(data),
+    }
+}
+
+/// Scalar fallback for [`ascii_prefix`]
+pub fn ascii_prefix_scalar(data: &[u8]) -> usize {
+    data.iter().take_while(|b| b.is_ascii()).count()
+}
+
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "sse2")]
+unsafe fn ascii_prefix_sse2(data: &[u8]) -> usize {
+    #[cfg(target_arch = "x86")]
+    use std::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use std::arch::x86_64::*;
+
+    let chunks = data.len() / 16;
+    for i in 0..chunks {
+        let v = _mm_loadu_si128(data.as_ptr().add(i * 16) as *const __m128i);
+        // The mask is the high bit of each byte
+        let mask = _mm_movemask_epi8(v) as u32;
+        if mask != 0 {
+            return i * 16 + mask.trailing_zeros() as usize;
+        }
+    }
+
+    let tail = chunks * 16;
+    tail + ascii_prefix_scalar(&data[tail..])
+}
+
+#[cfg(any(target_arch = "x86_64", target_arch = "x86"))]
+#[target_feature(enable = "avx2")]
+unsafe fn ascii_prefix_avx2(data: &[u8]) -> usize {
+    #[cfg(target_arch = "x86")]
+    use std::arch::x86::*;
+    #[cfg(target_arch = "x86_64")]
+    use std::arch::x86_64::*;
+
+    let chunks = data.len() / 32;
+    for i in 0..chunks {
+        let v = _mm256_loadu_si256(data.as_ptr().add(i * 32) as *const __m256i);
+        let mask = _mm256_movemask_epi8(v) as u32;
+        if mask != 0 {
+            return i * 32 + mask.trailing_zeros() as usize;
+        }
+    }
+
+    // At most 31 bytes left: finish with one SSE2 step and the scalar tail
+    let tail = chunks * 32;
+    tail + ascii_prefix_sse2(&data[tail..])
+}
+
+#[cfg(target_arch = "aarch64")]
+#[target_feature(enable = "neon")]
+unsafe fn ascii_prefix_neon(data: &[u8]) -> usize {
+    use std::arch::aarch64::*;
+
+    let chunks = data.len() / 16;
+    for i in 0..chunks {
+        let v = vld1q_u8(data.as_ptr().add(i * 16));
+        if vmaxvq_u8(v) >= 0x80 {
+            return i * 16 + ascii_prefix_scalar(&data[i * 16..i * 16 + 16]);
+        }
+    }
+
+    let tail = chunks * 16;
+    tail + ascii_prefix_scalar(&data[tail..])
+}
+
+// ============================================================================
+// FFI Functions
+// ============================================================================
+
+use super::Handle;
+use std::ffi::c_int;
+
+/// Get detected SIMD features
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_simd_features() -> SimdFeatures {
+    *SIMD_FEATURES
+}
+
+/// Get the SIMD level kernels dispatch to
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_simd_level() -> c_int {
+    active_level() as c_int
+}
+
+/// Pin every SIMD kernel to `level` (a `SimdLevel` value), or return to the
+/// best available with a negative level
+///
+/// For benchmarking and checking kernels against each other; affects the
+/// whole process. Returns 1 on success, 0 if this CPU can't run `level`.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_simd_set_level(level: c_int) -> c_int {
+    let ok = if level < 0 {
+        set_level(None)
+    } else {
+        SimdLevel::from_i32(level).is_some_and(|l| set_level(Some(l)))
+    };
+    i32::from(ok)
+}
+
+/// Check if SIMD is available
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_has_simd() -> c_int {
+    if SIMD_FEATURES.has_simd() { 1 } else { 0 }
+}
+
+/// SIMD matrix concatenation
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_simd_matrix_concat(left: SimdMatrix, right: SimdMatrix) -> SimdMatrix {
+    matrix_concat(&left, &right)
+}
+
+/// Transform a point using SIMD matrix
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_simd_transform_point(x: c_float, y: c_float, m: SimdMatrix) -> [c_float; 2] {
+    let (nx, ny) = transform_point(x, y, &m);
+    [nx, ny]
+}
+
+/// Transform multiple points
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_simd_transform_points(
+    points: *mut c_float,
+    count: usize,
+    m: SimdMatrix,
+) -> c_int {
+    if points.is_null() || count == 0 {
+        return -1;
     }
 
     let slice = unsafe { std::slice::from_raw_parts_mut(points as *mut (f32, f32), count) };
@@ -889,6 +2206,82 @@ pub extern "C" fn fz_simd_buffer_equal(a: *const u8, b: *const u8, len: usize) -
     if buffer_equal(a_slice, b_slice) { 1 } else { 0 }
 }
 
+/// Transform rects (4 floats each) in place to the bounding boxes of their
+/// transformed corners
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_simd_transform_rects(
+    rects: *mut c_float,
+    count: usize,
+    m: SimdMatrix,
+) -> c_int {
+    if rects.is_null() || count == 0 {
+        return -1;
+    }
+    let slice = unsafe { std::slice::from_raw_parts_mut(rects as *mut [f32; 4], count) };
+    transform_rects(slice, &m);
+    0
+}
+
+/// Bounding boxes (4 floats each) of quads (8 floats each)
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_simd_quad_bounds(
+    quads: *const c_float,
+    count: usize,
+    out: *mut c_float,
+) -> c_int {
+    if quads.is_null() || out.is_null() || count == 0 {
+        return -1;
+    }
+    let quads = unsafe { std::slice::from_raw_parts(quads as *const [f32; 8], count) };
+    let out = unsafe { std::slice::from_raw_parts_mut(out as *mut [f32; 4], count) };
+    quad_bounds(quads, out);
+    0
+}
+
+/// Union of rects (4 floats each) into `out`
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_simd_rect_union(
+    rects: *const c_float,
+    count: usize,
+    out: *mut c_float,
+) -> c_int {
+    if rects.is_null() || out.is_null() {
+        return -1;
+    }
+    let slice = unsafe { std::slice::from_raw_parts(rects as *const [f32; 4], count) };
+    let union = rect_union(slice);
+    unsafe { std::ptr::copy_nonoverlapping(union.as_ptr(), out, 4) };
+    0
+}
+
+/// Test points (2 floats each) against a rect, half-open on the far edges
+///
+/// `out`, if not null, receives 1 or 0 per point.
+/// Returns the number of points inside, or -1 on invalid input
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_simd_points_in_rect(
+    points: *const c_float,
+    count: usize,
+    x0: c_float,
+    y0: c_float,
+    x1: c_float,
+    y1: c_float,
+    out: *mut u8,
+) -> c_int {
+    if points.is_null() {
+        return -1;
+    }
+    let slice = unsafe { std::slice::from_raw_parts(points as *const (f32, f32), count) };
+    let inside = if out.is_null() {
+        let mut scratch = vec![0u8; count];
+        points_in_rect(slice, [x0, y0, x1, y1], &mut scratch)
+    } else {
+        let out = unsafe { std::slice::from_raw_parts_mut(out, count) };
+        points_in_rect(slice, [x0, y0, x1, y1], out)
+    };
+    inside as c_int
+}
+
 // ============================================================================
 // Tests
 // ============================================================================
@@ -897,6 +2290,183 @@ pub extern "C" fn fz_simd_buffer_equal(a: *const u8, b: *const u8, len: usize) -
 mod tests {
     use super::*;
 
+    #[test]
+    fn test_hash64_paths_agree() {
+        let data: Vec<u8> = (0..1000u32).map(|i| (i * 31 % 251) as u8).collect();
+        for len in [0, 1, 31, 32, 33, 64, 100, 1000] {
+            let blocks = len / 32 * 32;
+            let scalar = hash64_finish(
+                hash64_blocks_scalar(&data[..blocks]),
+                &data[blocks..len],
+                len,
+            );
+            assert_eq!(hash64(&data[..len]), scalar);
+        }
+    }
+
+    #[test]
+    fn test_hash64_sees_block_order_and_length() {
+        let a: Vec<u8> = [[1u8; 32], [2u8; 32]].concat();
+        let b: Vec<u8> = [[2u8; 32], [1u8; 32]].concat();
+        assert_ne!(hash64(&a), hash64(&b));
+        assert_ne!(hash64(b"abc"), hash64(b"abc\0"));
+        assert_eq!(hash64(&a), hash64(&a.clone()));
+    }
+
+    /// Output of every dispatched kernel on the same pseudo-random input,
+    /// floats as their bits
+    fn kernel_outputs() -> Vec<(&'static str, Vec<u64>)> {
+        let mut state = 0x9e37_79b9_7f4a_7c15u64;
+        let mut next = move || {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            state
+        };
+        // Odd lengths leave a tail for every vector width
+        let bytes: Vec<u8> = (0..4099).map(|_| next() as u8).collect();
+        let coords: Vec<f32> = (0..4099 * 8)
+            .map(|_| (next() % 20001) as f32 / 10.0 - 1000.0)
+            .collect();
+        let unit: Vec<f32> = (0..4099 * 3)
+            .map(|_| (next() % 1001) as f32 / 1000.0)
+            .collect();
+        let text: Vec<u8> = bytes
+            .iter()
+            .map(|&b| b"ab 0123\n/()<>[]{}%x\t"[b as usize % 20])
+            .collect();
+        let m = SimdMatrix::new(1.5, 0.25, -0.5, 2.0, 10.0, -20.0);
+        let bits = |v: &[f32]| v.iter().map(|f| f.to_bits() as u64).collect::<Vec<_>>();
+
+        let mut out = Vec::new();
+        let concat = matrix_concat(&m, &SimdMatrix::new(0.6, 0.8, -0.8, 0.6, 3.0, 4.0));
+        out.push(("matrix_concat", bits(&concat.data)));
+
+        let mut points: Vec<(f32, f32)> = coords.chunks_exact(2).map(|p| (p[0], p[1])).collect();
+        let mut inside = vec![0u8; points.len()];
+        let count = points_in_rect(&points, [-500.0, -500.0, 500.0, 500.0], &mut inside);
+        let mut flags: Vec<u64> = inside.iter().map(|&b| b as u64).collect();
+        flags.push(count as u64);
+        out.push(("points_in_rect", flags));
+        transform_points(&mut points, &m);
+        let flat: Vec<f32> = points.iter().flat_map(|&(x, y)| [x, y]).collect();
+        out.push(("transform_points", bits(&flat)));
+
+        let mut rects: Vec<[f32; 4]> = coords
+            .chunks_exact(4)
+            .map(|r| {
+                [
+                    r[0].min(r[2]),
+                    r[1].min(r[3]),
+                    r[0].max(r[2]),
+                    r[1].max(r[3]),
+                ]
+            })
+            .collect();
+        out.push(("rect_union", bits(&rect_union(&rects))));
+        transform_rects(&mut rects, &m);
+        out.push(("transform_rects", bits(rects.as_flattened())));
+
+        let quads: Vec<[f32; 8]> = coords
+            .chunks_exact(8)
+            .map(|q| q.try_into().unwrap())
+            .collect();
+        let mut bounds = vec![[0.0f32; 4]; quads.len()];
+        quad_bounds(&quads, &mut bounds);
+        out.push(("quad_bounds", bits(bounds.as_flattened())));
+
+        let rgb: Vec<(f32, f32, f32)> = unit.chunks_exact(3).map(|c| (c[0], c[1], c[2])).collect();
+        let mut cmyk = vec![(0.0, 0.0, 0.0, 0.0); rgb.len()];
+        rgb_to_cmyk_batch(&rgb, &mut cmyk);
+        let flat: Vec<f32> = cmyk.iter().flat_map(|&(c, m, y, k)| [c, m, y, k]).collect();
+        out.push(("rgb_to_cmyk_batch", bits(&flat)));
+
+        let widen = |v: &[u8]| v.iter().map(|&b| b as u64).collect::<Vec<_>>();
+        let mut filled = vec![0u8; bytes.len()];
+        buffer_fill(&mut filled[1..], 0xa5);
+        out.push(("buffer_fill", widen(&filled)));
+        let mut copied = vec![0u8; bytes.len()];
+        buffer_copy(&mut copied[3..], &bytes[1..]);
+        out.push(("buffer_copy", widen(&copied)));
+        let mut other = bytes.clone();
+        other[4000] ^= 1;
+        out.push((
+            "buffer_equal",
+            vec![
+                buffer_equal(&bytes, &bytes.clone()) as u64,
+                buffer_equal(&bytes, &other) as u64,
+            ],
+        ));
+
+        let scans = [
+            PdfByteClass::Whitespace,
+            PdfByteClass::Regular,
+            PdfByteClass::Digit,
+        ];
+        let runs: Vec<u64> = (0..text.len())
+            .step_by(7)
+            .flat_map(|i| scans.map(|class| scan_pdf_class(&text[i..], class) as u64))
+            .collect();
+        out.push(("scan_pdf_class", runs));
+        let runs: Vec<u64> = (0..text.len())
+            .step_by(7)
+            .flat_map(|i| {
+                [&b"<"[..], b"x%", b"\n{}"].map(|stops| scan_until_any(&text[i..], stops) as u64)
+            })
+            .collect();
+        out.push(("scan_until_any", runs));
+        let found: Vec<u64> = [&b"0123"[..], b"x\t", b"%xab", b"zz", b"a"]
+            .iter()
+            .flat_map(|needle| {
+                (0..text.len())
+                    .step_by(331)
+                    .map(|i| find_bytes(&text[i..], needle).map_or(u64::MAX, |p| p as u64))
+            })
+            .collect();
+        out.push(("find_bytes", found));
+
+        let hashes: Vec<u64> = [0, 1, 31, 32, 33, 100, 1000, bytes.len()]
+            .iter()
+            .map(|&len| hash64(&bytes[..len]))
+            .collect();
+        out.push(("hash64", hashes));
+        let json: Vec<u8> = bytes
+            .iter()
+            .map(|&b| b"{\"k\\\":[1, 2]},\n\t\xc3x"[b as usize % 18])
+            .collect();
+        let mut classes = vec![JsonBlockMasks::default(); json.len() / 64];
+        json_classify_blocks(&json[..classes.len() * 64], &mut classes);
+        let flat: Vec<u64> = classes
+            .iter()
+            .flat_map(|m| [m.quote, m.backslash, m.operator])
+            .collect();
+        out.push(("json_classify_blocks", flat));
+        let encoded = base64_encode(&bytes);
+        out.push(("base64_decode", widen(&base64_decode(&encoded).unwrap())));
+        out.push(("base64_encode", widen(&encoded)));
+
+        let mut packed = vec![0u8; bytes.len().div_ceil(8)];
+        pack_below(&bytes, &text, &mut packed);
+        out.push(("pack_below", widen(&packed)));
+        out
+    }
+
+    #[test]
+    fn test_every_level_matches_scalar() {
+        assert!(set_level(Some(SimdLevel::Scalar)));
+        let expected = kernel_outputs();
+        for level in available_levels() {
+            assert!(set_level(Some(level)));
+            assert_eq!(active_level(), level);
+            for ((kernel, got), (_, want)) in kernel_outputs().iter().zip(&expected) {
+                assert!(got == want, "{} at {:?} differs from scalar", kernel, level);
+            }
+        }
+        assert!(set_level(None));
+        assert_eq!(active_level(), SimdFeatures::detect().best_level());
+        assert_eq!(fz_simd_set_level(99), 0);
+    }
+
     #[test]
     fn test_simd_features() {
         let features = SimdFeatures::detect();
@@ -948,6 +2518,52 @@ mod tests {
         assert!((points[4].1 - 10.0).abs() < 0.001);
     }
 
+    #[test]
+    fn test_geometry_batches_match_scalar() {
+        let m = SimdMatrix::new(0.6, 0.8, -0.8, 0.6, 10.0, -5.0);
+        let mut rects = vec![
+            [0.0, 0.0, 10.0, 20.0],
+            [-3.0, 4.0, 5.0, 6.0],
+            [1.0, 1.0, 1.0, 1.0],
+        ];
+        let expected: Vec<_> = rects.iter().map(|&r| transform_rect(r, &m)).collect();
+        transform_rects(&mut rects, &m);
+        for (got, want) in rects.iter().zip(&expected) {
+            for k in 0..4 {
+                assert!((got[k] - want[k]).abs() < 1e-4);
+            }
+        }
+
+        let quads = [[0.0, 0.0, 10.0, 1.0, -1.0, 5.0, 9.0, 6.0]];
+        let mut bounds = [[0.0; 4]];
+        quad_bounds(&quads, &mut bounds);
+        assert_eq!(bounds[0], [-1.0, 0.0, 10.0, 6.0]);
+
+        let union = rect_union(&[[0.0, 0.0, 1.0, 1.0], [-2.0, 0.5, 0.5, 3.0]]);
+        assert_eq!(union, [-2.0, 0.0, 1.0, 3.0]);
+        assert_eq!(rect_union(&[])[0], f32::INFINITY);
+
+        let points = [(0.0, 0.0), (1.0, 0.5), (0.5, 1.0), (0.5, 0.5), (-0.1, 0.5)];
+        let mut inside = [9u8; 5];
+        assert_eq!(
+            points_in_rect(&points, [0.0, 0.0, 1.0, 1.0], &mut inside),
+            2
+        );
+        assert_eq!(inside, [1, 0, 0, 1, 0]);
+        assert_eq!(
+            fz_simd_points_in_rect(
+                points.as_ptr() as *const f32,
+                5,
+                0.0,
+                0.0,
+                1.0,
+                1.0,
+                std::ptr::null_mut()
+            ),
+            2
+        );
+    }
+
     #[test]
     fn test_rgb_to_cmyk() {
         // Pure red
@@ -1007,6 +2623,65 @@ mod tests {
         assert!(!buffer_equal(&a, &c));
     }
 
+    #[test]
+    fn test_find_bytes_matches_scalar() {
+        let mut hay = Vec::new();
+        for i in 0..500u32 {
+            hay.extend_from_slice(format!("{i} 0 obj << /Len {} >> endobj\n", i * 7).as_bytes());
+        }
+        for needle in [
+            &b"obj"[..],
+            b"endobj",
+            b"499 0 obj",
+            b"o",
+            b"missing",
+            b"\n1",
+        ] {
+            for start in [0, 1, 5, 31, 33] {
+                let h = &hay[start..];
+                assert_eq!(
+                    find_bytes(h, needle),
+                    find_bytes_scalar(h, needle),
+                    "{needle:?} at {start}"
+                );
+            }
+        }
+        // Needle ending exactly at the end of the haystack
+        let end = b"endobj\n".len();
+        assert_eq!(
+            find_bytes(&hay, &hay[hay.len() - end..]),
+            Some(find_bytes_scalar(&hay, &hay[hay.len() - end..]).unwrap())
+        );
+        assert_eq!(find_bytes(b"short", b"longer needle"), None);
+        assert_eq!(find_bytes(b"abc", b""), Some(0));
+    }
+
+    #[test]
+    fn test_scan_pdf_class_matches_scalar() {
+        // Every byte value, at every alignment and run length the vector
+        // loops and tails can see
+        let classes = [
+            PdfByteClass::Whitespace,
+            PdfByteClass::Regular,
+            PdfByteClass::Digit,
+        ];
+        let fill = [b' ', b'a', b'7'];
+        for (class, fill) in classes.into_iter().zip(fill) {
+            for stop in 0..=255u8 {
+                for run in [0, 1, 15, 16, 17, 31, 32, 33, 70] {
+                    let mut data = vec![fill; run];
+                    data.push(stop);
+                    data.extend_from_slice(&[fill; 20]);
+                    assert_eq!(
+                        scan_pdf_class(&data, class),
+                        scan_pdf_class_scalar(&data, class),
+                        "{class:?} run {run} stop {stop:#x}"
+                    );
+                }
+            }
+        }
+    }
+
     #[test]
     fn test_base64_encode() {
         let encoded = base64_encode(b"Hello");
@@ -1027,6 +2702,69 @@ mod tests {
         assert_eq!(&decoded, original);
     }
 
+    #[test]
+    fn test_pack_below_matches_scalar() {
+        // Equal values must not set a bit, so include v == t and the extremes
+        let values: Vec<u8> = (0..300u32).map(|i| (i * 37 % 256) as u8).collect();
+        let thresholds: Vec<u8> = (0..300u32).map(|i| (i * 11 % 256) as u8).collect();
+        for len in [0usize, 1, 7, 8, 15, 16, 17, 31, 32, 33, 64, 100, 300] {
+            let mut fast = vec![0xAA; len.div_ceil(8)];
+            let mut slow = vec![0x55; len.div_ceil(8)];
+            pack_below(&values[..len], &thresholds[..len], &mut fast);
+            pack_below_scalar(&values[..len], &thresholds[..len], &mut slow);
+            assert_eq!(fast, slow, "len {len}");
+        }
+
+        let mut out = [0u8; 2];
+        pack_below(&[0, 255, 128, 127, 5, 5, 0, 1, 200], &[128; 9], &mut out);
+        assert_eq!(out, [0b1001_1111, 0]);
+    }
+
+    #[test]
+    fn test_run_length() {
+        let mut data = vec![0u8; 40];
+        data[29] = 1;
+        assert_eq!(run_length(&data, usize::MAX), 29);
+        assert_eq!(run_length(&data, 10), 10);
+        assert_eq!(run_length(&data[29..], 255), 1);
+        assert_eq!(run_length(&data[30..], 255), 10);
+        assert_eq!(run_length(&[], 255), 0);
+    }
+
+    #[test]
+    fn test_prefix_below_matches_scalar() {
+        let values: Vec<u32> = (0..100u32).map(|i| i % 0x7F).collect();
+        for len in [0usize, 1, 3, 4, 5, 7, 8, 15, 16, 17, 31, 32, 33, 100] {
+            assert_eq!(prefix_below(&values[..len], 0x80), len);
+            for stop in 0..len {
+                // Above the bound, and past the sign bit the compare flips
+                for high in [0x80, 0x0590, 0x8000_0000, u32::MAX] {
+                    let mut v = values[..len].to_vec();
+                    v[stop] = high;
+                    assert_eq!(prefix_below(&v, 0x80), stop, "len {len} stop {stop}");
+                    assert_eq!(prefix_below(&v, 0x80), prefix_below_scalar(&v, 0x80));
+                }
+            }
+        }
+        assert_eq!(prefix_below(&[0, 1, 2], 0), 0);
+        assert_eq!(prefix_below(&[u32::MAX - 1; 9], u32::MAX), 9);
+    }
+
+    #[test]
+    fn test_ascii_prefix_matches_scalar() {
+        let text: Vec<u8> = (0..100u32).map(|i| (i * 13 % 128) as u8).collect();
+        for len in [0usize, 1, 15, 16, 17, 31, 32, 33, 63, 64, 65, 100] {
+            assert_eq!(ascii_prefix(&text[..len]), len);
+            for stop in 0..len {
+                let mut t = text[..len].to_vec();
+                t[stop] = 0xC3;
+                assert_eq!(ascii_prefix(&t), stop, "len {len} stop {stop}");
+                assert_eq!(ascii_prefix(&t), ascii_prefix_scalar(&t));
+            }
+        }
+        assert_eq!(ascii_prefix("caf\u{e9}".as_bytes()), 3);
+    }
+
     #[test]
     fn test_ffi_simd_level() {
         let level = fz_simd_level();
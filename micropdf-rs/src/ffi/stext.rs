@@ -3,11 +3,20 @@
 //! This module provides C-compatible exports for structured text extraction operations.
 //! Used for text search, format conversion, accessibility, and OCR integration.
 
+use super::data_locality::{PointSoA, RectSoA};
+use super::json::{JsonWriter, OutputSink};
+use super::output::OUTPUTS;
+use super::simd_util::find_bytes;
+use super::string_util::fold_char;
 use super::{Handle, HandleStore};
 use std::ffi::{CStr, CString};
 use std::os::raw::c_char;
 use std::sync::LazyLock;
 
+use crate::fitz::counters::Counter;
+use crate::fitz::geometry::Rect as GeoRect;
+use crate::fitz::rtree::PackedRTree;
+
 // ============================================================================
 // Types and Constants
 // ============================================================================
@@ -210,6 +219,268 @@ pub struct StextPage {
     pub refs: i32,
     pub mediabox: Rect,
     pub blocks: Vec<StextBlock>,
+    /// Derived views, built on first use and dropped whenever blocks change
+    soa: Option<StextSoA>,
+    search_text: Option<StextSearchText>,
+    char_tree: Option<PackedRTree>,
+}
+
+impl StextPage {
+    /// Forget derived data after the blocks, lines or chars change
+    fn invalidate(&mut self) {
+        self.soa = None;
+        self.search_text = None;
+        self.char_tree = None;
+    }
+
+    /// The page's characters as parallel arrays
+    pub fn soa(&mut self) -> &StextSoA {
+        self.soa
+            .get_or_insert_with(|| StextSoA::build(&self.blocks))
+    }
+
+    /// The character arrays and the folded search text over them
+    fn search_view(&mut self) -> (&StextSoA, &StextSearchText) {
+        let soa = self
+            .soa
+            .get_or_insert_with(|| StextSoA::build(&self.blocks));
+        let text = self
+            .search_text
+            .get_or_insert_with(|| StextSearchText::build(soa));
+        (soa, text)
+    }
+
+    /// The character arrays and an R-tree over their quads for hit testing
+    fn hit_view(&mut self) -> (&StextSoA, &PackedRTree) {
+        let soa = self
+            .soa
+            .get_or_insert_with(|| StextSoA::build(&self.blocks));
+        let tree = self.char_tree.get_or_insert_with(|| {
+            PackedRTree::new((0..soa.char_count()).map(|i| (i as u32, soa.char_bounds(i))))
+        });
+        (soa, tree)
+    }
+}
+
+/// Structure-of-arrays copy of a page's characters
+///
+/// Blocks hold lines that hold vectors of `StextChar`, so walking a page
+/// with 20k characters hops between many small allocations. Here every
+/// per-character field is one contiguous array in reading order, which
+/// search, selection and export stream through linearly.
+///
+/// The chars of line `l` are `line_starts[l]..line_starts[l + 1]` and the
+/// lines of block `b` are `block_starts[b]..block_starts[b + 1]`; both
+/// tables end with the total count.
+#[derive(Debug, Clone, Default)]
+pub struct StextSoA {
+    pub codepoints: Vec<u32>,
+    pub origins: PointSoA,
+    /// Quad corners: upper-left, upper-right, lower-left, lower-right
+    pub ul: PointSoA,
+    pub ur: PointSoA,
+    pub ll: PointSoA,
+    pub lr: PointSoA,
+    /// Font handle per char, 0 when unknown
+    pub fonts: Vec<Handle>,
+    pub sizes: Vec<f32>,
+    pub line_bboxes: RectSoA,
+    pub line_starts: Vec<u32>,
+    pub block_types: Vec<StextBlockType>,
+    pub block_starts: Vec<u32>,
+}
+
+impl StextSoA {
+    fn build(blocks: &[StextBlock]) -> Self {
+        let lines: usize = blocks.iter().map(|b| b.lines.len()).sum();
+        let chars: usize = blocks
+            .iter()
+            .flat_map(|b| b.lines.iter())
+            .map(|l| l.chars.len())
+            .sum();
+        let mut soa = Self {
+            codepoints: Vec::with_capacity(chars),
+            origins: PointSoA::with_capacity(chars),
+            ul: PointSoA::with_capacity(chars),
+            ur: PointSoA::with_capacity(chars),
+            ll: PointSoA::with_capacity(chars),
+            lr: PointSoA::with_capacity(chars),
+            fonts: Vec::with_capacity(chars),
+            sizes: Vec::with_capacity(chars),
+            line_bboxes: RectSoA::with_capacity(lines),
+            line_starts: Vec::with_capacity(lines + 1),
+            block_types: Vec::with_capacity(blocks.len()),
+            block_starts: Vec::with_capacity(blocks.len() + 1),
+        };
+        for block in blocks {
+            soa.block_types.push(block.block_type);
+            soa.block_starts.push(soa.line_starts.len() as u32);
+            for line in &block.lines {
+                let b = &line.bbox;
+                soa.line_bboxes.push(b.x0, b.y0, b.x1, b.y1);
+                soa.line_starts.push(soa.codepoints.len() as u32);
+                for ch in &line.chars {
+                    let q = &ch.quad;
+                    soa.codepoints.push(ch.c as u32);
+                    soa.origins.push(ch.origin.x, ch.origin.y);
+                    soa.ul.push(q.ul_x, q.ul_y);
+                    soa.ur.push(q.ur_x, q.ur_y);
+                    soa.ll.push(q.ll_x, q.ll_y);
+                    soa.lr.push(q.lr_x, q.lr_y);
+                    soa.fonts.push(ch.font.unwrap_or(0));
+                    soa.sizes.push(ch.size);
+                }
+            }
+        }
+        soa.block_starts.push(soa.line_starts.len() as u32);
+        soa.line_starts.push(soa.codepoints.len() as u32);
+        soa
+    }
+
+    /// Number of characters
+    pub fn char_count(&self) -> usize {
+        self.codepoints.len()
+    }
+
+    /// Number of lines
+    pub fn line_count(&self) -> usize {
+        self.line_starts.len() - 1
+    }
+
+    /// Line indices of block `b`
+    pub fn block_lines(&self, b: usize) -> std::ops::Range<usize> {
+        self.block_starts[b] as usize..self.block_starts[b + 1] as usize
+    }
+
+    /// Char indices of line `l`
+    pub fn line_chars(&self, l: usize) -> std::ops::Range<usize> {
+        self.line_starts[l] as usize..self.line_starts[l + 1] as usize
+    }
+
+    /// Line indices of every text block, in reading order
+    pub fn text_lines(&self) -> impl Iterator<Item = usize> + '_ {
+        self.block_types
+            .iter()
+            .enumerate()
+            .filter(|(_, t)| **t == StextBlockType::Text)
+            .flat_map(|(b, _)| self.block_lines(b))
+    }
+
+    /// Quad spanning chars `first` to `last` of one line
+    pub fn span_quad(&self, first: usize, last: usize) -> FzQuad {
+        FzQuad {
+            ul: [self.ul.xs[first], self.ul.ys[first]],
+            ur: [self.ur.xs[last], self.ur.ys[last]],
+            ll: [self.ll.xs[first], self.ll.ys[first]],
+            lr: [self.lr.xs[last], self.lr.ys[last]],
+        }
+    }
+
+    /// Bounding box of char `i`'s quad
+    pub fn char_bounds(&self, i: usize) -> GeoRect {
+        let xs = [self.ul.xs[i], self.ur.xs[i], self.ll.xs[i], self.lr.xs[i]];
+        let ys = [self.ul.ys[i], self.ur.ys[i], self.ll.ys[i], self.lr.ys[i]];
+        GeoRect::new(
+            xs.iter().copied().fold(f32::INFINITY, f32::min),
+            ys.iter().copied().fold(f32::INFINITY, f32::min),
+            xs.iter().copied().fold(f32::NEG_INFINITY, f32::max),
+            ys.iter().copied().fold(f32::NEG_INFINITY, f32::max),
+        )
+    }
+
+    /// Line holding char `i`
+    pub fn char_line(&self, i: usize) -> usize {
+        self.line_starts.partition_point(|&s| s as usize <= i) - 1
+    }
+
+    /// Block holding line `l`
+    pub fn line_block(&self, l: usize) -> usize {
+        self.block_starts.partition_point(|&s| s as usize <= l) - 1
+    }
+
+    /// Text-block chars whose quad centre lies in `area`, as (line, char)
+    /// pairs in reading order
+    ///
+    /// Only chars of lines whose bbox overlaps the area vertically count.
+    /// The R-tree narrows the candidates to chars whose quads touch the
+    /// area, which holds every char whose centre lies inside it.
+    fn selection(&self, tree: &PackedRTree, area: &GeoRect) -> Vec<(usize, usize)> {
+        let mut chars = Vec::new();
+        tree.search(area, |i| chars.push(i as usize));
+        chars.sort_unstable();
+        chars
+            .into_iter()
+            .filter_map(|i| {
+                let l = self.char_line(i);
+                let (_, y0, _, y1) = self.line_bboxes.get(l).unwrap_or_default();
+                let cx = (self.ul.xs[i] + self.ur.xs[i]) / 2.0;
+                let cy = (self.ul.ys[i] + self.ll.ys[i]) / 2.0;
+                let selected = self.block_types[self.line_block(l)] == StextBlockType::Text
+                    && y1 >= area.y0
+                    && y0 <= area.y1
+                    && cx >= area.x0
+                    && cx <= area.x1
+                    && cy >= area.y0
+                    && cy <= area.y1;
+                selected.then_some((l, i))
+            })
+            .collect()
+    }
+}
+
+/// Case-folded page text laid out for substring search
+///
+/// Every character's folded code point is UTF-8 encoded into one buffer,
+/// with a newline after each line so matches never cross lines.
+/// `offsets` holds the byte offset of each text-block char and `chars` its
+/// index in the page's `StextSoA`.
+#[derive(Debug, Clone, Default)]
+struct StextSearchText {
+    text: Vec<u8>,
+    offsets: Vec<u32>,
+    chars: Vec<u32>,
+}
+
+impl StextSearchText {
+    fn build(soa: &StextSoA) -> Self {
+        let mut st = Self {
+            text: Vec::with_capacity(soa.char_count() + soa.line_count()),
+            offsets: Vec::with_capacity(soa.char_count()),
+            chars: Vec::with_capacity(soa.char_count()),
+        };
+        let mut utf8 = [0u8; 4];
+        for l in soa.text_lines() {
+            for i in soa.line_chars(l) {
+                let c = char::from_u32(fold_char(soa.codepoints[i]))
+                    .unwrap_or(char::REPLACEMENT_CHARACTER);
+                st.offsets.push(st.text.len() as u32);
+                st.chars.push(i as u32);
+                st.text
+                    .extend_from_slice(c.encode_utf8(&mut utf8).as_bytes());
+            }
+            st.text.push(b'\n');
+        }
+        st
+    }
+
+    /// Report the quad of every (possibly overlapping) match, in page order,
+    /// until `hit` returns false
+    ///
+    /// `needle` must already be folded and free of newlines.
+    fn find_all(&self, soa: &StextSoA, needle: &[u8], mut hit: impl FnMut(FzQuad) -> bool) {
+        let mut from = 0;
+        while let Some(at) = find_bytes(&self.text[from..], needle).map(|p| p + from) {
+            // Folded text is valid UTF-8, so matches start and end on chars
+            let first = self.offsets.partition_point(|&o| (o as usize) < at);
+            let end = at + needle.len();
+            let last = self.offsets.partition_point(|&o| (o as usize) < end) - 1;
+            let quad = soa.span_quad(self.chars[first] as usize, self.chars[last] as usize);
+            if !hit(quad) {
+                return;
+            }
+            from = at + 1;
+        }
+    }
 }
 
 impl Default for StextPage {
@@ -223,6 +494,9 @@ impl Default for StextPage {
                 y1: 792.0,
             },
             blocks: Vec::new(),
+            soa: None,
+            search_text: None,
+            char_tree: None,
         }
     }
 }
@@ -250,7 +524,8 @@ pub struct FzQuad {
 // Handle Store
 // ============================================================================
 
-pub static STEXT_PAGES: LazyLock<HandleStore<StextPage>> = LazyLock::new(HandleStore::new);
+pub static STEXT_PAGES: LazyLock<HandleStore<StextPage>> =
+    LazyLock::new(|| HandleStore::with_lookup_counter(Counter::StextPageLookups));
 
 // Thread-local storage for search results and text output
 thread_local! {
@@ -269,10 +544,34 @@ pub extern "C" fn fz_new_stext_page(_ctx: Handle, x0: f32, y0: f32, x1: f32, y1:
         refs: 1,
         mediabox: Rect { x0, y0, x1, y1 },
         blocks: Vec::new(),
+        soa: None,
+        search_text: None,
+        char_tree: None,
     };
     STEXT_PAGES.insert(page)
 }
 
+/// Create the structured text page for a document page
+///
+/// The stext page takes the page bounds as its mediabox and collects
+/// whatever text the page contents produce when run. `options` may be
+/// null for the defaults.
+///
+/// # Returns
+/// Stext page handle, or 0 if the page handle is invalid
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_stext_page_from_page(
+    ctx: Handle,
+    page: Handle,
+    _options: *const StextOptions,
+) -> Handle {
+    if super::document::PAGES.get(page).is_none() {
+        return 0;
+    }
+    let bounds = super::document::fz_bound_page(ctx, page);
+    fz_new_stext_page(ctx, bounds.x0, bounds.y0, bounds.x1, bounds.y1)
+}
+
 /// Keep (increment reference count) stext page
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_keep_stext_page(_ctx: Handle, page: Handle) -> Handle {
@@ -669,20 +968,14 @@ pub extern "C" fn fz_stext_char_size(
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_stext_page_as_text(_ctx: Handle, page: Handle) -> *const c_char {
     if let Some(arc) = STEXT_PAGES.get(page) {
-        if let Ok(p) = arc.lock() {
-            let mut text = String::new();
+        if let Ok(mut p) = arc.lock() {
+            let soa = p.soa();
+            let mut text = String::with_capacity(soa.char_count() + soa.line_count());
 
-            for block in &p.blocks {
-                if block.block_type == StextBlockType::Text {
-                    for line in &block.lines {
-                        for ch in &line.chars {
-                            if let Some(c) = char::from_u32(ch.c as u32) {
-                                text.push(c);
-                            }
-                        }
-                        text.push('\n');
-                    }
-                }
+            for l in soa.text_lines() {
+                let chars = &soa.codepoints[soa.line_chars(l)];
+                text.extend(chars.iter().filter_map(|&c| char::from_u32(c)));
+                text.push('\n');
             }
 
             if let Ok(cstr) = CString::new(text) {
@@ -816,79 +1109,92 @@ pub extern "C" fn fz_print_stext_page_as_xml(
 }
 
 /// Print stext page as JSON
+///
+/// With a live `output` the page is streamed there token by token and
+/// null is returned, so big pages never sit in memory as one string;
+/// otherwise the JSON is returned, valid until the next call on this thread.
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_print_stext_page_as_json(
     _ctx: Handle,
-    _output: Handle,
+    output: Handle,
     page: Handle,
     _scale: f32,
 ) -> *const c_char {
-    if let Some(arc) = STEXT_PAGES.get(page) {
-        if let Ok(p) = arc.lock() {
-            let mut json = String::from("{\"blocks\":[\n");
-            let mut first_block = true;
-
-            for block in &p.blocks {
-                if block.block_type == StextBlockType::Text {
-                    if !first_block {
-                        json.push_str(",\n");
-                    }
-                    first_block = false;
-
-                    json.push_str(&format!(
-                        "{{\"type\":\"text\",\"bbox\":[{},{},{},{}],\"lines\":[\n",
-                        block.bbox.x0, block.bbox.y0, block.bbox.x1, block.bbox.y1
-                    ));
-
-                    let mut first_line = true;
-                    for line in &block.lines {
-                        if !first_line {
-                            json.push_str(",\n");
-                        }
-                        first_line = false;
+    let Some(arc) = STEXT_PAGES.get(page) else {
+        return std::ptr::null();
+    };
+    let Ok(p) = arc.lock() else {
+        return std::ptr::null();
+    };
+    if OUTPUTS.get(output).is_some() {
+        let mut json = JsonWriter::new(OutputSink(output));
+        let _ = write_stext_json(&p, &mut json).and_then(|_| json.flush());
+        return std::ptr::null();
+    }
 
-                        let mut line_text = String::new();
-                        for ch in &line.chars {
-                            if let Some(c) = char::from_u32(ch.c as u32) {
-                                // Escape JSON special characters
-                                match c {
-                                    '"' => line_text.push_str("\\\""),
-                                    '\\' => line_text.push_str("\\\\"),
-                                    '\n' => line_text.push_str("\\n"),
-                                    '\r' => line_text.push_str("\\r"),
-                                    '\t' => line_text.push_str("\\t"),
-                                    _ if c.is_control() => {
-                                        line_text.push_str(&format!("\\u{:04x}", c as u32))
-                                    }
-                                    _ => line_text.push(c),
-                                }
-                            }
-                        }
+    let mut json = JsonWriter::new(Vec::new());
+    let Ok(bytes) = write_stext_json(&p, &mut json).and_then(|_| json.finish()) else {
+        return std::ptr::null();
+    };
+    if let Ok(cstr) = CString::new(bytes) {
+        TEXT_OUTPUT.with(|cell| {
+            *cell.borrow_mut() = Some(cstr);
+        });
+        return TEXT_OUTPUT.with(|cell| {
+            cell.borrow()
+                .as_ref()
+                .map(|s| s.as_ptr())
+                .unwrap_or(std::ptr::null())
+        });
+    }
+    std::ptr::null()
+}
 
-                        json.push_str(&format!(
-                            "{{\"bbox\":[{},{},{},{}],\"text\":\"{}\"}}",
-                            line.bbox.x0, line.bbox.y0, line.bbox.x1, line.bbox.y1, line_text
-                        ));
-                    }
-                    json.push_str("\n]}");
-                }
-            }
-            json.push_str("\n]}");
+/// Text blocks and their lines, as `{"blocks":[{"type","bbox","lines"}]}`
+fn write_stext_json<W: std::io::Write>(
+    page: &StextPage,
+    json: &mut JsonWriter<W>,
+) -> crate::fitz::error::Result<()> {
+    let bbox = |json: &mut JsonWriter<W>, r: &Rect| {
+        json.begin_array()?;
+        for v in [r.x0, r.y0, r.x1, r.y1] {
+            json.float(v)?;
+        }
+        json.end_array()
+    };
 
-            if let Ok(cstr) = CString::new(json) {
-                TEXT_OUTPUT.with(|cell| {
-                    *cell.borrow_mut() = Some(cstr);
-                });
-                return TEXT_OUTPUT.with(|cell| {
-                    cell.borrow()
-                        .as_ref()
-                        .map(|s| s.as_ptr())
-                        .unwrap_or(std::ptr::null())
-                });
-            }
+    json.begin_object()?;
+    json.key("blocks")?;
+    json.begin_array()?;
+    for block in &page.blocks {
+        if block.block_type != StextBlockType::Text {
+            continue;
+        }
+        json.begin_object()?;
+        json.key("type")?;
+        json.string("text")?;
+        json.key("bbox")?;
+        bbox(json, &block.bbox)?;
+        json.key("lines")?;
+        json.begin_array()?;
+        for line in &block.lines {
+            let text: String = line
+                .chars
+                .iter()
+                .filter_map(|ch| char::from_u32(ch.c as u32))
+                .collect();
+            json.begin_object()?;
+            json.key("bbox")?;
+            bbox(json, &line.bbox)?;
+            json.key("text")?;
+            json.string(&text)?;
+            json.end_object()?;
         }
+        json.end_array()?;
+        json.end_object()?;
     }
-    std::ptr::null()
+    json.end_array()?;
+    json.end_object()
 }
 
 // ============================================================================
@@ -896,6 +1202,13 @@ pub extern "C" fn fz_print_stext_page_as_json(
 // ============================================================================
 
 /// Search for text in stext page
+///
+/// Matching ignores case and never crosses lines; overlapping matches are
+/// all reported. The page's folded text is built by the first search and
+/// reused until the page changes. `hit_mark` receives each hit's ordinal.
+///
+/// # Returns
+/// Number of hits written, at most `hit_max`
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_search_stext_page(
     _ctx: Handle,
@@ -909,70 +1222,34 @@ pub extern "C" fn fz_search_stext_page(
         return 0;
     }
 
-    let needle_str = match unsafe { CStr::from_ptr(needle) }.to_str() {
-        Ok(s) => s.to_lowercase(),
+    let needle: String = match unsafe { CStr::from_ptr(needle) }.to_str() {
+        Ok(s) => s
+            .chars()
+            .map(|c| char::from_u32(fold_char(c as u32)).unwrap_or(c))
+            .collect(),
         Err(_) => return 0,
     };
+    if needle.is_empty() || needle.contains('\n') {
+        return 0;
+    }
 
     if let Some(arc) = STEXT_PAGES.get(page) {
-        if let Ok(p) = arc.lock() {
-            let mut hits = 0;
-            let mut hit_idx = 0;
-
-            for block in &p.blocks {
-                if block.block_type != StextBlockType::Text {
-                    continue;
-                }
-
-                for line in &block.lines {
-                    // Build line text
-                    let line_text: String = line
-                        .chars
-                        .iter()
-                        .filter_map(|ch| char::from_u32(ch.c as u32))
-                        .collect::<String>()
-                        .to_lowercase();
-
-                    // Find all occurrences
-                    let mut search_pos = 0;
-                    while let Some(pos) = line_text[search_pos..].find(&needle_str) {
-                        let actual_pos = search_pos + pos;
-
-                        if hit_idx < hit_max {
-                            // Calculate bounding quad for the match
-                            let start_char = actual_pos;
-                            let end_char = (actual_pos + needle_str.len()).min(line.chars.len());
-
-                            if start_char < line.chars.len() && end_char > 0 {
-                                let first_ch = &line.chars[start_char];
-                                let last_ch = &line.chars[end_char.saturating_sub(1)];
-
-                                if !hit_bbox.is_null() {
-                                    unsafe {
-                                        let quad = hit_bbox.add(hit_idx as usize);
-                                        (*quad).ul = [first_ch.quad.ul_x, first_ch.quad.ul_y];
-                                        (*quad).ur = [last_ch.quad.ur_x, last_ch.quad.ur_y];
-                                        (*quad).ll = [first_ch.quad.ll_x, first_ch.quad.ll_y];
-                                        (*quad).lr = [last_ch.quad.lr_x, last_ch.quad.lr_y];
-                                    }
-                                }
-
-                                if !hit_mark.is_null() {
-                                    unsafe {
-                                        *hit_mark.add(hit_idx as usize) = hits;
-                                    }
-                                }
-
-                                hit_idx += 1;
-                            }
-                        }
+        if let Ok(mut p) = arc.lock() {
+            let (soa, text) = p.search_view();
 
-                        hits += 1;
-                        search_pos = actual_pos + 1;
+            let mut hit_idx = 0;
+            text.find_all(soa, needle.as_bytes(), |quad| {
+                unsafe {
+                    if !hit_bbox.is_null() {
+                        *hit_bbox.add(hit_idx as usize) = quad;
+                    }
+                    if !hit_mark.is_null() {
+                        *hit_mark.add(hit_idx as usize) = hit_idx;
                     }
                 }
-            }
-
+                hit_idx += 1;
+                hit_idx < hit_max
+            });
             return hit_idx;
         }
     }
@@ -1000,44 +1277,20 @@ pub extern "C" fn fz_highlight_selection(
     }
 
     if let Some(arc) = STEXT_PAGES.get(page) {
-        if let Ok(p) = arc.lock() {
+        if let Ok(mut p) = arc.lock() {
+            let (soa, tree) = p.hit_view();
             let mut quad_count = 0;
 
             // Simple implementation: find all chars between points
-            let min_x = a_x.min(b_x);
-            let max_x = a_x.max(b_x);
-            let min_y = a_y.min(b_y);
-            let max_y = a_y.max(b_y);
-
-            for block in &p.blocks {
-                if block.block_type != StextBlockType::Text {
-                    continue;
-                }
+            let area = GeoRect::new(a_x.min(b_x), a_y.min(b_y), a_x.max(b_x), a_y.max(b_y));
 
-                for line in &block.lines {
-                    // Check if line overlaps selection
-                    if line.bbox.y1 < min_y || line.bbox.y0 > max_y {
-                        continue;
-                    }
-
-                    for ch in &line.chars {
-                        let cx = (ch.quad.ul_x + ch.quad.ur_x) / 2.0;
-                        let cy = (ch.quad.ul_y + ch.quad.ll_y) / 2.0;
-
-                        if cx >= min_x && cx <= max_x && cy >= min_y && cy <= max_y {
-                            if quad_count < max_quads && !quads.is_null() {
-                                unsafe {
-                                    let quad = quads.add(quad_count as usize);
-                                    (*quad).ul = [ch.quad.ul_x, ch.quad.ul_y];
-                                    (*quad).ur = [ch.quad.ur_x, ch.quad.ur_y];
-                                    (*quad).ll = [ch.quad.ll_x, ch.quad.ll_y];
-                                    (*quad).lr = [ch.quad.lr_x, ch.quad.lr_y];
-                                }
-                            }
-                            quad_count += 1;
-                        }
+            for (_, i) in soa.selection(tree, &area) {
+                if quad_count < max_quads && !quads.is_null() {
+                    unsafe {
+                        *quads.add(quad_count as usize) = soa.span_quad(i, i);
                     }
                 }
+                quad_count += 1;
             }
 
             return quad_count.min(max_quads);
@@ -1058,42 +1311,26 @@ pub extern "C" fn fz_copy_selection(
     crlf: i32,
 ) -> *const c_char {
     if let Some(arc) = STEXT_PAGES.get(page) {
-        if let Ok(p) = arc.lock() {
+        if let Ok(mut p) = arc.lock() {
+            let (soa, tree) = p.hit_view();
             let mut text = String::new();
             let line_ending = if crlf != 0 { "\r\n" } else { "\n" };
+            let area = GeoRect::new(a_x.min(b_x), a_y.min(b_y), a_x.max(b_x), a_y.max(b_y));
 
-            let min_x = a_x.min(b_x);
-            let max_x = a_x.max(b_x);
-            let min_y = a_y.min(b_y);
-            let max_y = a_y.max(b_y);
-
-            for block in &p.blocks {
-                if block.block_type != StextBlockType::Text {
+            // A line ends once text was copied from it
+            let mut open_line = None;
+            for (l, i) in soa.selection(tree, &area) {
+                let Some(c) = char::from_u32(soa.codepoints[i]) else {
                     continue;
+                };
+                if open_line.is_some_and(|open| open != l) {
+                    text.push_str(line_ending);
                 }
-
-                for line in &block.lines {
-                    if line.bbox.y1 < min_y || line.bbox.y0 > max_y {
-                        continue;
-                    }
-
-                    let mut line_has_selection = false;
-                    for ch in &line.chars {
-                        let cx = (ch.quad.ul_x + ch.quad.ur_x) / 2.0;
-                        let cy = (ch.quad.ul_y + ch.quad.ll_y) / 2.0;
-
-                        if cx >= min_x && cx <= max_x && cy >= min_y && cy <= max_y {
-                            if let Some(c) = char::from_u32(ch.c as u32) {
-                                text.push(c);
-                                line_has_selection = true;
-                            }
-                        }
-                    }
-
-                    if line_has_selection {
-                        text.push_str(line_ending);
-                    }
-                }
+                text.push(c);
+                open_line = Some(l);
+            }
+            if open_line.is_some() {
+                text.push_str(line_ending);
             }
 
             if let Ok(cstr) = CString::new(text) {
@@ -1126,6 +1363,56 @@ pub extern "C" fn fz_copy_rectangle(
     fz_copy_selection(ctx, page, x0, y0, x1, y1, crlf)
 }
 
+/// Find the character under a point, for click hit testing
+///
+/// Reports the first text-block character in reading order whose quad
+/// bounds contain the point, found through the page's character R-tree.
+/// Any output pointer may be null.
+///
+/// # Returns
+/// 1 with the block, line (within the block) and char (within the line)
+/// indices written, or 0 if no character is under the point
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_stext_char_at_point(
+    _ctx: Handle,
+    page: Handle,
+    x: f32,
+    y: f32,
+    block: *mut i32,
+    line: *mut i32,
+    ch: *mut i32,
+) -> i32 {
+    let Some(arc) = STEXT_PAGES.get(page) else {
+        return 0;
+    };
+    let Ok(mut p) = arc.lock() else {
+        return 0;
+    };
+    let (soa, tree) = p.hit_view();
+    let hit = tree.at_point(x, y).into_iter().find_map(|i| {
+        let i = i as usize;
+        let l = soa.char_line(i);
+        let b = soa.line_block(l);
+        (soa.block_types[b] == StextBlockType::Text).then_some((b, l, i))
+    });
+    let Some((b, l, i)) = hit else {
+        return 0;
+    };
+
+    unsafe {
+        if !block.is_null() {
+            *block = b as i32;
+        }
+        if !line.is_null() {
+            *line = (l - soa.block_starts[b] as usize) as i32;
+        }
+        if !ch.is_null() {
+            *ch = (i - soa.line_starts[l] as usize) as i32;
+        }
+    }
+    1
+}
+
 // ============================================================================
 // Segmentation Functions
 // ============================================================================
@@ -1139,6 +1426,7 @@ pub extern "C" fn fz_segment_stext_page(_ctx: Handle, page: Handle) -> i32 {
             let mut changes = 0;
 
             if p.blocks.len() > 1 {
+                p.invalidate();
                 // Sort blocks by vertical position
                 p.blocks.sort_by(|a, b| {
                     a.bbox
@@ -1333,6 +1621,7 @@ pub extern "C" fn fz_add_stext_block(
                 text_flags: 0,
             };
             let idx = p.blocks.len() as i32;
+            p.invalidate();
             p.blocks.push(block);
             return idx;
         }
@@ -1353,6 +1642,7 @@ pub extern "C" fn fz_add_stext_line(
 ) -> i32 {
     if let Some(arc) = STEXT_PAGES.get(page) {
         if let Ok(mut p) = arc.lock() {
+            p.invalidate();
             if let Some(block) = p.blocks.get_mut(block_idx as usize) {
                 let line = StextLine {
                     wmode: 0,
@@ -1384,6 +1674,7 @@ pub extern "C" fn fz_add_stext_char(
 ) -> i32 {
     if let Some(arc) = STEXT_PAGES.get(page) {
         if let Ok(mut p) = arc.lock() {
+            p.invalidate();
             if let Some(block) = p.blocks.get_mut(block_idx as usize) {
                 if let Some(line) = block.lines.get_mut(line_idx as usize) {
                     let ch = StextChar {
@@ -1463,6 +1754,175 @@ pub extern "C" fn fz_stext_char_count(
     0
 }
 
+// ============================================================================
+// Flat Export Functions
+// ============================================================================
+
+/// Count blocks, lines and characters for sizing `fz_stext_page_fill_flat`
+///
+/// Any output pointer may be null. Returns 0 on success, -1 for an invalid page.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_stext_page_flat_counts(
+    _ctx: Handle,
+    page: Handle,
+    blocks: *mut i32,
+    lines: *mut i32,
+    chars: *mut i32,
+) -> i32 {
+    let Some(arc) = STEXT_PAGES.get(page) else {
+        return -1;
+    };
+    let Ok(p) = arc.lock() else {
+        return -1;
+    };
+
+    let line_count: usize = p.blocks.iter().map(|b| b.lines.len()).sum();
+    let char_count: usize = p
+        .blocks
+        .iter()
+        .flat_map(|b| b.lines.iter())
+        .map(|l| l.chars.len())
+        .sum();
+
+    if !blocks.is_null() {
+        unsafe { *blocks = p.blocks.len() as i32 };
+    }
+    if !lines.is_null() {
+        unsafe { *lines = line_count as i32 };
+    }
+    if !chars.is_null() {
+        unsafe { *chars = char_count as i32 };
+    }
+    0
+}
+
+/// Export a whole page into packed arrays under a single lock
+///
+/// # Arguments
+/// * `quads` - `max_chars * 8` floats: ul, ur, ll, lr as x/y pairs per char
+/// * `codepoints` - `max_chars` Unicode values
+/// * `line_offsets` - `max_lines + 1` entries: index of the first char of
+///   each line, followed by the total char count
+/// * `block_offsets` - `max_blocks + 1` entries: index of the first line of
+///   each block, followed by the total line count
+///
+/// Size the arrays with `fz_stext_page_flat_counts`.
+///
+/// # Returns
+/// Number of characters written, or -1 if the page is invalid, a pointer is
+/// null or a capacity is too small
+#[unsafe(no_mangle)]
+#[allow(clippy::too_many_arguments)]
+pub extern "C" fn fz_stext_page_fill_flat(
+    _ctx: Handle,
+    page: Handle,
+    quads: *mut f32,
+    codepoints: *mut u32,
+    max_chars: i32,
+    line_offsets: *mut u32,
+    max_lines: i32,
+    block_offsets: *mut u32,
+    max_blocks: i32,
+) -> i32 {
+    if quads.is_null() || codepoints.is_null() || line_offsets.is_null() || block_offsets.is_null()
+    {
+        return -1;
+    }
+    let Some(arc) = STEXT_PAGES.get(page) else {
+        return -1;
+    };
+    let Ok(mut p) = arc.lock() else {
+        return -1;
+    };
+    let soa = p.soa();
+
+    let block_count = soa.block_types.len();
+    let line_count = soa.line_count();
+    let char_count = soa.char_count();
+    if max_blocks < 0
+        || max_lines < 0
+        || max_chars < 0
+        || block_count > max_blocks as usize
+        || line_count > max_lines as usize
+        || char_count > max_chars as usize
+    {
+        return -1;
+    }
+
+    let quads = unsafe { std::slice::from_raw_parts_mut(quads, char_count * 8) };
+    let codepoints = unsafe { std::slice::from_raw_parts_mut(codepoints, char_count) };
+    let line_offsets = unsafe { std::slice::from_raw_parts_mut(line_offsets, line_count + 1) };
+    let block_offsets = unsafe { std::slice::from_raw_parts_mut(block_offsets, block_count + 1) };
+
+    for (i, q) in quads.chunks_exact_mut(8).enumerate() {
+        q.copy_from_slice(&[
+            soa.ul.xs[i],
+            soa.ul.ys[i],
+            soa.ur.xs[i],
+            soa.ur.ys[i],
+            soa.ll.xs[i],
+            soa.ll.ys[i],
+            soa.lr.xs[i],
+            soa.lr.ys[i],
+        ]);
+    }
+    codepoints.copy_from_slice(&soa.codepoints);
+    line_offsets.copy_from_slice(&soa.line_starts);
+    block_offsets.copy_from_slice(&soa.block_starts);
+
+    char_count as i32
+}
+
+/// Export per-character origins, font sizes and font handles
+///
+/// Complements `fz_stext_page_fill_flat`: entry `i` belongs to the same
+/// character as its codepoint `i`. Any output pointer may be null.
+///
+/// # Arguments
+/// * `origins` - `max_chars * 2` floats: baseline origin x/y per char
+/// * `sizes` - `max_chars` font sizes
+/// * `fonts` - `max_chars` font handles, 0 where unknown
+///
+/// # Returns
+/// Number of characters written, or -1 if the page is invalid or
+/// `max_chars` is too small
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_stext_page_fill_char_styles(
+    _ctx: Handle,
+    page: Handle,
+    origins: *mut f32,
+    sizes: *mut f32,
+    fonts: *mut Handle,
+    max_chars: i32,
+) -> i32 {
+    let Some(arc) = STEXT_PAGES.get(page) else {
+        return -1;
+    };
+    let Ok(mut p) = arc.lock() else {
+        return -1;
+    };
+    let soa = p.soa();
+    let n = soa.char_count();
+    if max_chars < 0 || n > max_chars as usize {
+        return -1;
+    }
+
+    if !origins.is_null() {
+        let origins = unsafe { std::slice::from_raw_parts_mut(origins, n * 2) };
+        for (i, o) in origins.chunks_exact_mut(2).enumerate() {
+            o[0] = soa.origins.xs[i];
+            o[1] = soa.origins.ys[i];
+        }
+    }
+    if !sizes.is_null() {
+        unsafe { std::slice::from_raw_parts_mut(sizes, n) }.copy_from_slice(&soa.sizes);
+    }
+    if !fonts.is_null() {
+        unsafe { std::slice::from_raw_parts_mut(fonts, n) }.copy_from_slice(&soa.fonts);
+    }
+    n as i32
+}
+
 // ============================================================================
 // Tests
 // ============================================================================
@@ -1505,6 +1965,116 @@ mod tests {
         fz_drop_stext_page(ctx, page);
     }
 
+    #[test]
+    fn test_stext_page_fill_flat() {
+        let ctx = 0;
+        let page = fz_new_stext_page(ctx, 0.0, 0.0, 612.0, 792.0);
+
+        let b0 = fz_add_stext_block(ctx, page, 0.0, 0.0, 100.0, 50.0);
+        let l0 = fz_add_stext_line(ctx, page, b0, 0.0, 0.0, 100.0, 12.0);
+        fz_add_stext_char(ctx, page, b0, l0, 'H' as i32, 0.0, 12.0, 10.0);
+        fz_add_stext_char(ctx, page, b0, l0, 'i' as i32, 6.0, 12.0, 10.0);
+        let l1 = fz_add_stext_line(ctx, page, b0, 0.0, 12.0, 100.0, 24.0);
+        fz_add_stext_char(ctx, page, b0, l1, 0x00e9, 0.0, 24.0, 10.0);
+        let b1 = fz_add_stext_block(ctx, page, 0.0, 60.0, 100.0, 80.0);
+        let l2 = fz_add_stext_line(ctx, page, b1, 0.0, 60.0, 100.0, 72.0);
+        fz_add_stext_char(ctx, page, b1, l2, '!' as i32, 0.0, 72.0, 10.0);
+
+        let (mut nb, mut nl, mut nc) = (0, 0, 0);
+        assert_eq!(
+            fz_stext_page_flat_counts(ctx, page, &mut nb, &mut nl, &mut nc),
+            0
+        );
+        assert_eq!((nb, nl, nc), (2, 3, 4));
+
+        let mut quads = vec![0.0f32; nc as usize * 8];
+        let mut cps = vec![0u32; nc as usize];
+        let mut lofs = vec![0u32; nl as usize + 1];
+        let mut bofs = vec![0u32; nb as usize + 1];
+        let written = fz_stext_page_fill_flat(
+            ctx,
+            page,
+            quads.as_mut_ptr(),
+            cps.as_mut_ptr(),
+            nc,
+            lofs.as_mut_ptr(),
+            nl,
+            bofs.as_mut_ptr(),
+            nb,
+        );
+        assert_eq!(written, 4);
+        assert_eq!(cps, vec!['H' as u32, 'i' as u32, 0x00e9, '!' as u32]);
+        assert_eq!(lofs, vec![0, 2, 3, 4]);
+        assert_eq!(bofs, vec![0, 2, 3]);
+        // Second char: ul = (6, 2), lr = (12, 12)
+        assert_eq!(&quads[8..10], &[6.0, 2.0]);
+        assert_eq!(&quads[14..16], &[12.0, 12.0]);
+
+        // Undersized buffers are rejected
+        let short = fz_stext_page_fill_flat(
+            ctx,
+            page,
+            quads.as_mut_ptr(),
+            cps.as_mut_ptr(),
+            nc - 1,
+            lofs.as_mut_ptr(),
+            nl,
+            bofs.as_mut_ptr(),
+            nb,
+        );
+        assert_eq!(short, -1);
+        assert_eq!(
+            fz_stext_page_flat_counts(
+                ctx,
+                0,
+                std::ptr::null_mut(),
+                std::ptr::null_mut(),
+                std::ptr::null_mut()
+            ),
+            -1
+        );
+
+        let mut origins = vec![0.0f32; nc as usize * 2];
+        let mut sizes = vec![0.0f32; nc as usize];
+        assert_eq!(
+            fz_stext_page_fill_char_styles(
+                ctx,
+                page,
+                origins.as_mut_ptr(),
+                sizes.as_mut_ptr(),
+                std::ptr::null_mut(),
+                nc
+            ),
+            4
+        );
+        assert_eq!(&origins[2..4], &[6.0, 12.0]);
+        assert_eq!(sizes, vec![10.0; 4]);
+
+        // The arrays are rebuilt after the page changes
+        fz_add_stext_char(ctx, page, b1, l2, '?' as i32, 6.0, 72.0, 10.0);
+        let mut quads = vec![0.0f32; 5 * 8];
+        let mut cps = vec![0u32; 5];
+        let mut lofs = vec![0u32; 4];
+        assert_eq!(
+            fz_stext_page_fill_flat(
+                ctx,
+                page,
+                quads.as_mut_ptr(),
+                cps.as_mut_ptr(),
+                nc + 1,
+                lofs.as_mut_ptr(),
+                nl,
+                bofs.as_mut_ptr(),
+                nb,
+            ),
+            5
+        );
+        assert_eq!(cps[4], '?' as u32);
+        assert_eq!(lofs, vec![0, 2, 3, 5]);
+
+        fz_drop_stext_page(ctx, page);
+    }
+
     #[test]
     fn test_stext_text_extraction() {
         let ctx = 0;
@@ -1551,6 +2121,60 @@ mod tests {
             10,
         );
         assert_eq!(hits, 1);
+        // "World" starts at the seventh char, which sits at x = 48
+        assert!((quads[0].ul[0] - 48.0).abs() < 0.01);
+        assert!((quads[0].ur[0] - (80.0 + 12.0 * 0.6)).abs() < 0.01);
+
+        // Case-insensitive, overlapping, and limited to hit_max
+        let needle = CString::new("L").unwrap();
+        let hits = fz_search_stext_page(
+            ctx,
+            page,
+            needle.as_ptr(),
+            marks.as_mut_ptr(),
+            quads.as_mut_ptr(),
+            2,
+        );
+        assert_eq!(hits, 2);
+        assert_eq!(&marks[..2], &[0, 1]);
+
+        // Chars added after a search are found by the next one
+        let line2 = fz_add_stext_line(ctx, page, block, 0.0, 12.0, 200.0, 24.0);
+        for (i, c) in "Ünïcode".chars().enumerate() {
+            fz_add_stext_char(
+                ctx,
+                page,
+                block,
+                line2,
+                c as i32,
+                (i * 8) as f32,
+                24.0,
+                12.0,
+            );
+        }
+        let needle = CString::new("üNÏ").unwrap();
+        let hits = fz_search_stext_page(
+            ctx,
+            page,
+            needle.as_ptr(),
+            marks.as_mut_ptr(),
+            quads.as_mut_ptr(),
+            10,
+        );
+        assert_eq!(hits, 1);
+        assert!((quads[0].ll[1] - 24.0).abs() < 0.01);
+
+        // Matches never span the line break
+        let needle = CString::new("dü").unwrap();
+        let hits = fz_search_stext_page(
+            ctx,
+            page,
+            needle.as_ptr(),
+            marks.as_mut_ptr(),
+            quads.as_mut_ptr(),
+            10,
+        );
+        assert_eq!(hits, 0);
 
         fz_drop_stext_page(ctx, page);
     }
@@ -1611,6 +2235,34 @@ mod tests {
         fz_drop_stext_page(ctx, page);
     }
 
+    #[test]
+    fn test_stext_json_streams_to_output() {
+        use crate::ffi::output::{fz_drop_output, fz_new_output_with_path};
+
+        let ctx = 0;
+        let page = fz_new_stext_page(ctx, 0.0, 0.0, 612.0, 792.0);
+        let block = fz_add_stext_block(ctx, page, 0.0, 0.0, 100.0, 50.0);
+        let line = fz_add_stext_line(ctx, page, block, 0.0, 0.0, 100.0, 12.5);
+        for (i, c) in "a\"b".chars().enumerate() {
+            fz_add_stext_char(ctx, page, block, line, c as i32, (i * 8) as f32, 12.0, 12.0);
+        }
+
+        let path = std::env::temp_dir().join("micropdf_stext_json_test.json");
+        let c_path = CString::new(path.to_str().unwrap()).unwrap();
+        let out = fz_new_output_with_path(ctx, c_path.as_ptr(), 0);
+        assert!(fz_print_stext_page_as_json(ctx, out, page, 1.0).is_null());
+        fz_drop_output(ctx, out);
+        let streamed = std::fs::read_to_string(&path).unwrap();
+        let _ = std::fs::remove_file(&path);
+
+        let returned = fz_print_stext_page_as_json(ctx, 0, page, 1.0);
+        let returned = unsafe { CStr::from_ptr(returned) }.to_str().unwrap();
+        assert_eq!(streamed, returned);
+        assert!(returned.contains(r#""text":"a\"b""#));
+
+        fz_drop_stext_page(ctx, page);
+    }
+
     #[test]
     fn test_stext_selection() {
         let ctx = 0;
@@ -1629,6 +2281,49 @@ mod tests {
         let text_str = unsafe { CStr::from_ptr(text) }.to_str().unwrap();
         assert!(text_str.contains("Select Me"));
 
+        let line2 = fz_add_stext_line(ctx, page, block, 0.0, 12.0, 100.0, 24.0);
+        for (i, c) in "Second".chars().enumerate() {
+            fz_add_stext_char(
+                ctx,
+                page,
+                block,
+                line2,
+                c as i32,
+                (i * 8) as f32,
+                24.0,
+                12.0,
+            );
+        }
+        let copy = |x0: f32, y0: f32, x1: f32, y1: f32| {
+            let text = fz_copy_selection(ctx, page, x0, y0, x1, y1, 0);
+            unsafe { CStr::from_ptr(text) }
+                .to_str()
+                .unwrap()
+                .to_string()
+        };
+        assert_eq!(copy(0.0, 0.0, 100.0, 30.0), "Select Me\nSecond\n");
+        assert_eq!(copy(0.0, 14.0, 20.0, 30.0), "Sec\n");
+        assert_eq!(copy(200.0, 0.0, 300.0, 30.0), "");
+
+        let mut quads = [FzQuad::default(); 4];
+        assert_eq!(
+            fz_highlight_selection(ctx, page, 20.0, 30.0, 0.0, 14.0, quads.as_mut_ptr(), 4),
+            3
+        );
+        assert_eq!(quads[2].ul, [16.0, 12.0]);
+
+        let (mut b, mut l, mut c) = (-1, -1, -1);
+        assert_eq!(
+            fz_stext_char_at_point(ctx, page, 17.0, 20.0, &mut b, &mut l, &mut c),
+            1
+        );
+        assert_eq!((b, l, c), (0, 1, 2));
+        let none = std::ptr::null_mut();
+        assert_eq!(
+            fz_stext_char_at_point(ctx, page, 7.5, 5.0, none, none, none),
+            0
+        );
+
         fz_drop_stext_page(ctx, page);
     }
 }
@@ -1,12 +1,27 @@
 //! C FFI for resource store/caching - MuPDF compatible
 //! Safe Rust implementation of fz_store
+//!
+//! Besides the simple recency/frequency policies, `CostAware` ranks items
+//! with Greedy-Dual-Size-Frequency (frequency times re-creation cost over
+//! size, plus an aging clock) and puts a TinyLFU admission filter in front
+//! of the store, so a one-off scan cannot push out items in regular use.
+//!
+//! In pressure-aware mode the maximum size is the hard watermark and a
+//! background thread trims the store back to the soft watermark, or
+//! further while the host reports memory pressure (pushed with
+//! `fz_store_notify_pressure` or polled through a callback).
 
 use super::Handle;
 use std::collections::HashMap;
+use std::ffi::{c_int, c_void};
+use std::hash::{DefaultHasher, Hash, Hasher};
 use std::sync::{
-    LazyLock, Mutex,
+    Condvar, LazyLock, Mutex,
     atomic::{AtomicUsize, Ordering},
 };
+
+use super::band_writer::SendPtr;
+use crate::fitz::alloc_sampler::{self, Subsystem};
 use std::time::{Duration, Instant};
 
 /// Store item type enumeration
@@ -33,6 +48,46 @@ pub enum StoreType {
     Document = 8,
     /// Page
     Page = 9,
+    /// Flattened or stroked path edges
+    EdgeList = 10,
+    /// Decoded image level or subarea
+    DecodedImage = 11,
+    /// Pre-tokenized content stream
+    ContentProgram = 12,
+    /// Glyphs and advances of a shaped string
+    ShapedText = 13,
+}
+
+impl StoreType {
+    pub fn from_i32(value: i32) -> Self {
+        match value {
+            1 => StoreType::Font,
+            2 => StoreType::Image,
+            3 => StoreType::Colorspace,
+            4 => StoreType::Path,
+            5 => StoreType::Shade,
+            6 => StoreType::Glyph,
+            7 => StoreType::DisplayList,
+            8 => StoreType::Document,
+            9 => StoreType::Page,
+            10 => StoreType::EdgeList,
+            11 => StoreType::DecodedImage,
+            12 => StoreType::ContentProgram,
+            13 => StoreType::ShapedText,
+            _ => StoreType::Generic,
+        }
+    }
+
+    /// Default cost of re-creating an item of this type, relative to a
+    /// generic item; decoded images and recorded lists are the expensive ones
+    pub fn default_cost(self) -> f64 {
+        match self {
+            StoreType::Image | StoreType::DecodedImage | StoreType::DisplayList => 8.0,
+            StoreType::Font | StoreType::Shade | StoreType::Page => 4.0,
+            StoreType::Colorspace | StoreType::Document => 2.0,
+            _ => 1.0,
+        }
+    }
 }
 
 /// Cache eviction policy
@@ -47,6 +102,88 @@ pub enum EvictionPolicy {
     FIFO = 2,
     /// Random eviction
     Random = 3,
+    /// Greedy-Dual-Size-Frequency ranking with TinyLFU admission
+    CostAware = 4,
+}
+
+// ============================================================================
+// Admission Filter
+// ============================================================================
+
+/// Counters per sketch row (power of 2)
+const SKETCH_WIDTH: usize = 4096;
+
+/// Sketch rows, each with its own hash
+const SKETCH_DEPTH: usize = 4;
+
+/// Saturation value of a sketch counter (4 bits of history)
+const SKETCH_MAX: u8 = 15;
+
+/// Approximate access frequencies of recently requested keys
+///
+/// A count-min sketch over key hashes. Every `10 * SKETCH_WIDTH` recorded
+/// accesses all counters are halved, so old popularity fades.
+#[derive(Debug, Clone)]
+pub struct FrequencySketch {
+    counters: Box<[[u8; SKETCH_WIDTH]; SKETCH_DEPTH]>,
+    samples: usize,
+}
+
+impl Default for FrequencySketch {
+    fn default() -> Self {
+        Self {
+            counters: Box::new([[0; SKETCH_WIDTH]; SKETCH_DEPTH]),
+            samples: 0,
+        }
+    }
+}
+
+impl FrequencySketch {
+    fn slots(hash: u64) -> impl Iterator<Item = (usize, usize)> {
+        (0..SKETCH_DEPTH).map(move |row| {
+            let mixed = hash
+                .wrapping_add(row as u64)
+                .wrapping_mul(0x9E37_79B9_7F4A_7C15)
+                .rotate_right(17 + row as u32 * 8);
+            (row, mixed as usize & (SKETCH_WIDTH - 1))
+        })
+    }
+
+    /// Record one access
+    pub fn record(&mut self, hash: u64) {
+        for (row, col) in Self::slots(hash) {
+            let counter = &mut self.counters[row][col];
+            *counter = (*counter + 1).min(SKETCH_MAX);
+        }
+        self.samples += 1;
+        if self.samples >= 10 * SKETCH_WIDTH {
+            self.age();
+        }
+    }
+
+    /// Halve every counter
+    fn age(&mut self) {
+        for row in self.counters.iter_mut() {
+            for counter in row.iter_mut() {
+                *counter /= 2;
+            }
+        }
+        self.samples /= 2;
+    }
+
+    /// Estimate how often `hash` was recorded recently
+    pub fn estimate(&self, hash: u64) -> u8 {
+        Self::slots(hash)
+            .map(|(row, col)| self.counters[row][col])
+            .min()
+            .unwrap_or(0)
+    }
+}
+
+fn key_hash(key: &[u8]) -> u64 {
+    let mut hasher = DefaultHasher::new();
+    key.hash(&mut hasher);
+    hasher.finish()
 }
 
 /// Store item metadata
@@ -70,6 +207,35 @@ pub struct StoreItem {
     pub evictable: bool,
     /// Reference count
     pub refs: u32,
+    /// Releases the store's reference to `handle` when the item is
+    /// discarded (None for items the store only tracks)
+    pub release: Option<fn(Handle)>,
+    /// Relative cost of re-creating the item
+    pub cost: f64,
+    /// Cost-aware eviction priority; lowest is evicted first
+    pub priority: f64,
+}
+
+impl StoreItem {
+    /// Give up the store's reference to the resource, if it holds one
+    fn discard(self) {
+        if let Some(release) = self.release {
+            release(self.handle);
+        }
+    }
+
+    /// Recompute the GDSF priority against the store's clock
+    fn reprioritize(&mut self, clock: f64) {
+        let frequency = (self.access_count + 1) as f64;
+        self.priority = clock + frequency * self.cost / self.size.max(1) as f64;
+    }
+
+    /// Record an access
+    fn touch(&mut self, clock: f64) {
+        self.last_access = Instant::now();
+        self.access_count += 1;
+        self.reprioritize(clock);
+    }
 }
 
 impl Default for StoreItem {
@@ -84,6 +250,9 @@ impl Default for StoreItem {
             key: Vec::new(),
             evictable: true,
             refs: 1,
+            release: None,
+            cost: 1.0,
+            priority: 0.0,
         }
     }
 }
@@ -113,6 +282,61 @@ pub struct Store {
     pub type_limits: HashMap<StoreType, usize>,
     /// Per-type current sizes
     pub type_sizes: HashMap<StoreType, usize>,
+    /// Per-type re-creation costs overriding StoreType::default_cost
+    pub type_costs: HashMap<StoreType, f64>,
+    /// GDSF aging clock: the priority of the last cost-aware victim
+    pub clock: f64,
+    /// Recent key frequencies for admission
+    pub sketch: FrequencySketch,
+    /// Items the admission filter turned away
+    pub total_rejected: u64,
+    /// Soft watermark in bytes (0 = pressure-aware mode off)
+    pub soft_limit: usize,
+    /// Last memory pressure level reported by the host
+    pub pressure: PressureLevel,
+    /// Items evicted to relieve memory pressure
+    pub pressure_evicted: u64,
+}
+
+impl Store {
+    fn type_cost(&self, t: StoreType) -> f64 {
+        self.type_costs
+            .get(&t)
+            .copied()
+            .unwrap_or_else(|| t.default_cost())
+    }
+
+    /// Note a request for `key` in the admission sketch
+    fn record_access(&mut self, key: &[u8]) {
+        if self.policy == EvictionPolicy::CostAware && !key.is_empty() {
+            self.sketch.record(key_hash(key));
+        }
+    }
+
+    /// Mark an item accessed, returning its handle
+    fn touch(&mut self, id: u64) -> Option<Handle> {
+        let clock = self.clock;
+        let item = self.items.get_mut(&id)?;
+        item.touch(clock);
+        Some(item.handle)
+    }
+
+    /// TinyLFU admission: let a new key in only if it has been asked for at
+    /// least as often as the item it would displace
+    fn admit(&self, key: &[u8], size: usize) -> bool {
+        if self.policy != EvictionPolicy::CostAware
+            || key.is_empty()
+            || self.current_size + size <= self.max_size
+        {
+            return true;
+        }
+        let victim = select_victim(self);
+        let Some(victim) = self.items.get(&victim) else {
+            return true;
+        };
+        victim.key.is_empty()
+            || self.sketch.estimate(key_hash(key)) >= self.sketch.estimate(key_hash(&victim.key))
+    }
 }
 
 impl Default for Store {
@@ -129,6 +353,13 @@ impl Default for Store {
             misses: 0,
             type_limits: HashMap::new(),
             type_sizes: HashMap::new(),
+            type_costs: HashMap::new(),
+            clock: 0.0,
+            sketch: FrequencySketch::default(),
+            total_rejected: 0,
+            soft_limit: 0,
+            pressure: PressureLevel::None,
+            pressure_evicted: 0,
         }
     }
 }
@@ -200,6 +431,7 @@ pub extern "C" fn fz_store_set_policy(_ctx: Handle, policy: i32) {
         1 => EvictionPolicy::LFU,
         2 => EvictionPolicy::FIFO,
         3 => EvictionPolicy::Random,
+        4 => EvictionPolicy::CostAware,
         _ => EvictionPolicy::LRU,
     };
 
@@ -221,6 +453,10 @@ pub extern "C" fn fz_store_set_type_limit(_ctx: Handle, item_type: i32, max_size
         7 => StoreType::DisplayList,
         8 => StoreType::Document,
         9 => StoreType::Page,
+        10 => StoreType::EdgeList,
+        11 => StoreType::DecodedImage,
+        12 => StoreType::ContentProgram,
+        13 => StoreType::ShapedText,
         _ => StoreType::Generic,
     };
 
@@ -233,6 +469,45 @@ pub extern "C" fn fz_store_set_type_limit(_ctx: Handle, item_type: i32, max_size
     }
 }
 
+/// Set the relative re-creation cost used for new items of a type
+///
+/// Only the cost-aware policy uses it. A cost of 0 or less restores the
+/// type's default.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_store_set_type_cost(_ctx: Handle, item_type: i32, cost: f64) {
+    if let Ok(mut store) = STORE.lock() {
+        let t = StoreType::from_i32(item_type);
+        if cost > 0.0 {
+            store.type_costs.insert(t, cost);
+        } else {
+            store.type_costs.remove(&t);
+        }
+    }
+}
+
+/// Set the relative re-creation cost of one stored item
+///
+/// For example, the measured decode time of an image.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_store_set_item_cost(_ctx: Handle, id: u64, cost: f64) {
+    if let Ok(mut store) = STORE.lock() {
+        let clock = store.clock;
+        if let Some(item) = store.items.get_mut(&id) {
+            item.cost = cost.max(0.0);
+            item.reprioritize(clock);
+        }
+    }
+}
+
+/// Get the number of items the cost-aware admission filter rejected
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_store_total_rejected(_ctx: Handle) -> u64 {
+    if let Ok(store) = STORE.lock() {
+        return store.total_rejected;
+    }
+    0
+}
+
 // ============================================================================
 // Store Items
 // ============================================================================
@@ -260,6 +535,10 @@ pub extern "C" fn fz_store_item(
         7 => StoreType::DisplayList,
         8 => StoreType::Document,
         9 => StoreType::Page,
+        10 => StoreType::EdgeList,
+        11 => StoreType::DecodedImage,
+        12 => StoreType::ContentProgram,
+        13 => StoreType::ShapedText,
         _ => StoreType::Generic,
     };
 
@@ -269,26 +548,149 @@ pub extern "C" fn fz_store_item(
         unsafe { std::slice::from_raw_parts(key, key_len) }.to_vec()
     };
 
+    insert_item(t, handle, size, key_data, None)
+}
+
+/// Store an item the store holds a reference to
+///
+/// `release` is called with `handle` once the store discards the item:
+/// on eviction, `fz_store_clear` or the last `fz_store_drop`. An existing
+/// item with the same key is discarded first. Items handed back by
+/// `fz_store_remove`/`fz_store_remove_by_key` pass the reference to the
+/// caller instead.
+pub fn store_owned_item(
+    item_type: StoreType,
+    handle: Handle,
+    size: usize,
+    key: &[u8],
+    release: fn(Handle),
+) -> u64 {
+    if let Ok(mut store) = STORE.lock() {
+        if let Some(old) = store.key_map.get(key).copied() {
+            if let Some(item) = take_item(&mut store, old) {
+                item.discard();
+            }
+        }
+    }
+    insert_item(item_type, handle, size, key.to_vec(), Some(release))
+}
+
+/// Look up an item by key and take a reference to it while the store is
+/// locked, so that a concurrent eviction cannot release it in between
+pub fn store_find_and_keep(key: &[u8], keep: fn(Handle) -> Handle) -> Handle {
     if let Ok(mut store) = STORE.lock() {
+        store.record_access(key);
+        if let Some(&id) = store.key_map.get(key) {
+            if let Some(handle) = store.touch(id) {
+                store.hits += 1;
+                return keep(handle);
+            }
+        }
+        store.misses += 1;
+    }
+    0
+}
+
+/// Discard every item of `item_type` whose key starts with `prefix`
+///
+/// Returns the number of items removed.
+pub fn store_discard_matching(item_type: StoreType, prefix: &[u8]) -> usize {
+    let Ok(mut store) = STORE.lock() else {
+        return 0;
+    };
+    let victims: Vec<u64> = store
+        .items
+        .iter()
+        .filter(|(_, item)| item.item_type == item_type && item.key.starts_with(prefix))
+        .map(|(&id, _)| id)
+        .collect();
+    let count = victims.len();
+    for id in victims {
+        if let Some(item) = take_item(&mut store, id) {
+            item.discard();
+        }
+    }
+    count
+}
+
+/// Most bytes items of `item_type` may take: its type limit if one is
+/// set, the store's size otherwise
+pub fn store_type_budget(item_type: StoreType) -> usize {
+    let Ok(store) = STORE.lock() else {
+        return 0;
+    };
+    store
+        .type_limits
+        .get(&item_type)
+        .copied()
+        .unwrap_or(store.max_size)
+}
+
+/// Internal: insert an item, evicting to make room for it
+///
+/// Returns 0 if the admission filter rejects the item; an owned item is
+/// then released straight away.
+fn insert_item(
+    t: StoreType,
+    handle: Handle,
+    size: usize,
+    key_data: Vec<u8>,
+    release: Option<fn(Handle)>,
+) -> u64 {
+    let Ok(mut store) = STORE.lock() else {
+        return 0;
+    };
+    match insert_into(&mut store, t, handle, size, key_data, release) {
+        Some(id) => id,
+        None => {
+            drop(store);
+            if let Some(release) = release {
+                release(handle);
+            }
+            0
+        }
+    }
+}
+
+/// Internal: insert an item into a locked store
+fn insert_into(
+    store: &mut Store,
+    t: StoreType,
+    handle: Handle,
+    size: usize,
+    key_data: Vec<u8>,
+    release: Option<fn(Handle)>,
+) -> Option<u64> {
+    {
+        store.record_access(&key_data);
+        if !store.admit(&key_data, size) {
+            store.total_rejected += 1;
+            return None;
+        }
+
         // Check if we need to evict items first
         if store.current_size + size > store.max_size {
             let target_size = store.max_size.saturating_sub(size);
-            evict_to_size(&mut store, target_size);
+            evict_to_size(store, target_size);
         }
 
         // Check type limit
         if let Some(&limit) = store.type_limits.get(&t) {
             let current = store.type_sizes.get(&t).copied().unwrap_or(0);
             if current + size > limit {
-                evict_type_to_size(&mut store, t, limit.saturating_sub(size));
+                evict_type_to_size(store, t, limit.saturating_sub(size));
             }
         }
 
         // Generate item ID
         let id = new_store_id();
+        alloc_sampler::record(
+            Subsystem::Store,
+            std::mem::size_of::<StoreItem>() + 2 * key_data.len(),
+        );
 
         // Create item
-        let item = StoreItem {
+        let mut item = StoreItem {
             item_type: t,
             handle,
             size,
@@ -298,7 +700,11 @@ pub extern "C" fn fz_store_item(
             key: key_data.clone(),
             evictable: true,
             refs: 1,
+            release,
+            cost: store.type_cost(t),
+            priority: 0.0,
         };
+        item.reprioritize(store.clock);
 
         // Update size tracking
         store.current_size += size;
@@ -312,10 +718,12 @@ pub extern "C" fn fz_store_item(
 
         store.total_stored += 1;
 
-        return id;
-    }
+        if store.soft_limit > 0 && store.current_size > store.soft_limit {
+            PRESSURE_MONITOR.wake();
+        }
 
-    0
+        Some(id)
+    }
 }
 
 /// Look up an item by key
@@ -331,17 +739,9 @@ pub extern "C" fn fz_store_find(_ctx: Handle, key: *const u8, key_len: usize) ->
     let key_data = unsafe { std::slice::from_raw_parts(key, key_len) };
 
     if let Ok(mut store) = STORE.lock() {
+        store.record_access(key_data);
         if let Some(&id) = store.key_map.get(key_data) {
-            let result = if let Some(item) = store.items.get_mut(&id) {
-                // Update access tracking
-                item.last_access = Instant::now();
-                item.access_count += 1;
-                Some(item.handle)
-            } else {
-                None
-            };
-
-            if let Some(handle) = result {
+            if let Some(handle) = store.touch(id) {
                 store.hits += 1;
                 return handle;
             }
@@ -356,15 +756,7 @@ pub extern "C" fn fz_store_find(_ctx: Handle, key: *const u8, key_len: usize) ->
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_store_find_by_id(_ctx: Handle, id: u64) -> Handle {
     if let Ok(mut store) = STORE.lock() {
-        let result = if let Some(item) = store.items.get_mut(&id) {
-            item.last_access = Instant::now();
-            item.access_count += 1;
-            Some(item.handle)
-        } else {
-            None
-        };
-
-        if let Some(handle) = result {
+        if let Some(handle) = store.touch(id) {
             store.hits += 1;
             return handle;
         }
@@ -447,14 +839,8 @@ pub extern "C" fn fz_store_drop(_ctx: Handle, id: u64) {
         };
 
         if should_remove {
-            if let Some(item) = store.items.remove(&id) {
-                if !item.key.is_empty() {
-                    store.key_map.remove(&item.key);
-                }
-                store.current_size = store.current_size.saturating_sub(item.size);
-                if let Some(type_size) = store.type_sizes.get_mut(&item.item_type) {
-                    *type_size = type_size.saturating_sub(item.size);
-                }
+            if let Some(item) = take_item(&mut store, id) {
+                item.discard();
             }
         }
     }
@@ -593,6 +979,10 @@ pub extern "C" fn fz_store_type_size(_ctx: Handle, item_type: i32) -> usize {
         7 => StoreType::DisplayList,
         8 => StoreType::Document,
         9 => StoreType::Page,
+        10 => StoreType::EdgeList,
+        11 => StoreType::DecodedImage,
+        12 => StoreType::ContentProgram,
+        13 => StoreType::ShapedText,
         _ => StoreType::Generic,
     };
 
@@ -615,6 +1005,10 @@ pub extern "C" fn fz_store_type_count(_ctx: Handle, item_type: i32) -> usize {
         7 => StoreType::DisplayList,
         8 => StoreType::Document,
         9 => StoreType::Page,
+        10 => StoreType::EdgeList,
+        11 => StoreType::DecodedImage,
+        12 => StoreType::ContentProgram,
+        13 => StoreType::ShapedText,
         _ => StoreType::Generic,
     };
 
@@ -628,6 +1022,19 @@ pub extern "C" fn fz_store_type_count(_ctx: Handle, item_type: i32) -> usize {
 // Eviction
 // ============================================================================
 
+/// Internal: unlink an item and update the size accounting
+fn take_item(store: &mut Store, id: u64) -> Option<StoreItem> {
+    let item = store.items.remove(&id)?;
+    if !item.key.is_empty() && store.key_map.get(&item.key) == Some(&id) {
+        store.key_map.remove(&item.key);
+    }
+    store.current_size = store.current_size.saturating_sub(item.size);
+    if let Some(type_size) = store.type_sizes.get_mut(&item.item_type) {
+        *type_size = type_size.saturating_sub(item.size);
+    }
+    Some(item)
+}
+
 /// Internal: evict items to reach target size
 fn evict_to_size(store: &mut Store, target_size: usize) {
     while store.current_size > target_size && !store.items.is_empty() {
@@ -636,15 +1043,12 @@ fn evict_to_size(store: &mut Store, target_size: usize) {
             break;
         }
 
-        if let Some(item) = store.items.remove(&victim_id) {
-            if !item.key.is_empty() {
-                store.key_map.remove(&item.key);
-            }
-            store.current_size = store.current_size.saturating_sub(item.size);
-            if let Some(type_size) = store.type_sizes.get_mut(&item.item_type) {
-                *type_size = type_size.saturating_sub(item.size);
-            }
+        if let Some(item) = take_item(store, victim_id) {
             store.total_evicted += 1;
+            if store.policy == EvictionPolicy::CostAware {
+                store.clock = store.clock.max(item.priority);
+            }
+            item.discard();
         }
     }
 }
@@ -673,6 +1077,7 @@ fn evict_type_to_size(store: &mut Store, item_type: StoreType, target_size: usiz
             EvictionPolicy::LFU => item_a.access_count.cmp(&item_b.access_count),
             EvictionPolicy::FIFO => item_a.created.cmp(&item_b.created),
             EvictionPolicy::Random => std::cmp::Ordering::Equal,
+            EvictionPolicy::CostAware => item_a.priority.total_cmp(&item_b.priority),
         }
     });
 
@@ -685,16 +1090,13 @@ fn evict_type_to_size(store: &mut Store, item_type: StoreType, target_size: usiz
             break;
         }
 
-        if let Some(item) = store.items.remove(&victim_id) {
-            if !item.key.is_empty() {
-                store.key_map.remove(&item.key);
-            }
+        if let Some(item) = take_item(store, victim_id) {
             evicted_size += item.size;
-            store.current_size = store.current_size.saturating_sub(item.size);
-            if let Some(type_size) = store.type_sizes.get_mut(&item.item_type) {
-                *type_size = type_size.saturating_sub(item.size);
-            }
             store.total_evicted += 1;
+            if store.policy == EvictionPolicy::CostAware {
+                store.clock = store.clock.max(item.priority);
+            }
+            item.discard();
         }
     }
 }
@@ -731,7 +1133,274 @@ fn select_victim(store: &Store) -> u64 {
             // Use simple deterministic selection for reproducibility
             evictable.first().map(|(id, _)| **id).unwrap_or(0)
         }
+        EvictionPolicy::CostAware => evictable
+            .iter()
+            .min_by(|(_, a), (_, b)| a.priority.total_cmp(&b.priority))
+            .map(|(id, _)| **id)
+            .unwrap_or(0),
+    }
+}
+
+// ============================================================================
+// Memory Pressure
+// ============================================================================
+
+/// Memory pressure reported by the host
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, PartialOrd, Ord, Default)]
+pub enum PressureLevel {
+    /// Trim back to the soft watermark only
+    #[default]
+    None = 0,
+    /// Trim to half the soft watermark
+    Moderate = 1,
+    /// Drop everything evictable
+    Critical = 2,
+}
+
+impl PressureLevel {
+    pub fn from_i32(value: i32) -> Self {
+        match value {
+            i32::MIN..=0 => PressureLevel::None,
+            1 => PressureLevel::Moderate,
+            _ => PressureLevel::Critical,
+        }
+    }
+}
+
+/// Polled by the background evictor; returns a PressureLevel value
+///
+/// Bindings can back this with Node's heap statistics, Go's GC stats or
+/// Linux PSI. Called from the evictor thread, never with the store locked.
+pub type StorePressureCallback = extern "C" fn(user: *mut c_void) -> c_int;
+
+/// Size the store should shrink to at `level`, if it is above it
+fn pressure_target(store: &Store, level: PressureLevel) -> Option<usize> {
+    let soft = if store.soft_limit > 0 {
+        store.soft_limit
+    } else {
+        store.max_size
+    };
+    match level {
+        PressureLevel::None if store.soft_limit > 0 => Some(soft),
+        PressureLevel::None => None,
+        PressureLevel::Moderate => Some(soft / 2),
+        PressureLevel::Critical => Some(0),
+    }
+}
+
+/// Internal: evict down to the target for `level`, returning items evicted
+fn relieve_pressure(store: &mut Store, level: PressureLevel) -> usize {
+    let Some(target) = pressure_target(store, level) else {
+        return 0;
+    };
+    let before = store.items.len();
+    evict_to_size(store, target);
+    let evicted = before - store.items.len();
+    store.pressure_evicted += evicted as u64;
+    evicted
+}
+
+struct MonitorState {
+    running: bool,
+    /// Set when the evictor should run without waiting for its interval
+    pending: bool,
+    callback: Option<StorePressureCallback>,
+    user: SendPtr,
+    interval: Duration,
+}
+
+/// Background evictor thread and what it waits on
+struct PressureMonitor {
+    state: Mutex<MonitorState>,
+    wake: Condvar,
+}
+
+static PRESSURE_MONITOR: LazyLock<PressureMonitor> = LazyLock::new(|| PressureMonitor {
+    state: Mutex::new(MonitorState {
+        running: false,
+        pending: false,
+        callback: None,
+        user: SendPtr(0),
+        interval: Duration::from_secs(1),
+    }),
+    wake: Condvar::new(),
+});
+
+impl PressureMonitor {
+    /// Start the evictor thread if needed
+    fn start(&'static self) {
+        let mut state = self.state.lock().unwrap();
+        if state.running {
+            return;
+        }
+        let spawned = std::thread::Builder::new()
+            .name("fz-store-evictor".into())
+            .spawn(move || self.run());
+        state.running = spawned.is_ok();
+    }
+
+    /// Ask the evictor to run now (cheap if it is not running)
+    fn wake(&self) {
+        let mut state = self.state.lock().unwrap();
+        if state.running {
+            state.pending = true;
+            self.wake.notify_one();
+        }
+    }
+
+    fn run(&self) {
+        loop {
+            let polled = {
+                let mut state = self.state.lock().unwrap();
+                while !state.pending {
+                    if state.callback.is_some() {
+                        let interval = state.interval;
+                        let (guard, timeout) = self.wake.wait_timeout(state, interval).unwrap();
+                        state = guard;
+                        if timeout.timed_out() {
+                            break;
+                        }
+                    } else {
+                        state = self.wake.wait(state).unwrap();
+                    }
+                }
+                state.pending = false;
+                state.callback.map(|cb| (cb, state.user.as_ptr()))
+            };
+
+            let polled = polled.map(|(cb, user)| PressureLevel::from_i32(cb(user)));
+            if let Ok(mut store) = STORE.lock() {
+                if let Some(level) = polled {
+                    store.pressure = level;
+                }
+                let level = store.pressure;
+                relieve_pressure(&mut store, level);
+            }
+        }
+    }
+}
+
+/// Enable pressure-aware mode with a soft and a hard watermark
+///
+/// `hard` becomes the maximum store size, enforced on insert as before.
+/// Whenever the store grows past `soft`, a background thread evicts back
+/// down to it. A `soft` of 0 turns the background trimming off; a `hard`
+/// of 0 leaves the maximum size unchanged.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_store_set_watermarks(_ctx: Handle, soft: usize, hard: usize) {
+    if let Ok(mut store) = STORE.lock() {
+        if hard > 0 {
+            store.max_size = hard;
+            evict_to_size(&mut store, hard);
+        }
+        store.soft_limit = if store.max_size > 0 {
+            soft.min(store.max_size)
+        } else {
+            soft
+        };
+    }
+    if soft > 0 {
+        PRESSURE_MONITOR.start();
+        PRESSURE_MONITOR.wake();
+    }
+}
+
+/// Get the soft watermark (0 when pressure-aware mode is off)
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_store_soft_limit(_ctx: Handle) -> usize {
+    if let Ok(store) = STORE.lock() {
+        return store.soft_limit;
+    }
+    0
+}
+
+/// Install a callback the background evictor polls for memory pressure
+///
+/// It is called every `interval_ms` milliseconds (at least 10) and whenever
+/// the store passes its soft watermark. Pass None to remove it.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_store_set_pressure_callback(
+    _ctx: Handle,
+    callback: Option<StorePressureCallback>,
+    user: *mut c_void,
+    interval_ms: u64,
+) {
+    {
+        let mut state = PRESSURE_MONITOR.state.lock().unwrap();
+        state.callback = callback;
+        state.user = SendPtr::new(user);
+        state.interval = Duration::from_millis(interval_ms.max(10));
+    }
+    if callback.is_some() {
+        PRESSURE_MONITOR.start();
+    }
+    PRESSURE_MONITOR.wake();
+}
+
+/// Report memory pressure from the host (0 none, 1 moderate, 2 critical)
+///
+/// The level stays in effect until the next report or callback poll; the
+/// background evictor trims the store accordingly.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_store_notify_pressure(_ctx: Handle, level: c_int) {
+    if let Ok(mut store) = STORE.lock() {
+        store.pressure = PressureLevel::from_i32(level);
     }
+    PRESSURE_MONITOR.start();
+    PRESSURE_MONITOR.wake();
+}
+
+/// Get the current memory pressure level
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_store_pressure(_ctx: Handle) -> c_int {
+    if let Ok(store) = STORE.lock() {
+        return store.pressure as c_int;
+    }
+    0
+}
+
+/// Trim the store for a pressure level right away, on the calling thread
+///
+/// Returns the number of items evicted.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_store_relieve_pressure(_ctx: Handle, level: c_int) -> usize {
+    if let Ok(mut store) = STORE.lock() {
+        return relieve_pressure(&mut store, PressureLevel::from_i32(level));
+    }
+    0
+}
+
+/// Get the number of items evicted to relieve memory pressure
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_store_pressure_evictions(_ctx: Handle) -> u64 {
+    if let Ok(store) = STORE.lock() {
+        return store.pressure_evicted;
+    }
+    0
+}
+
+/// Shrink the store to `percent` of its maximum size
+///
+/// Returns the number of items evicted.
+pub fn store_shrink(percent: u32) -> usize {
+    if let Ok(mut store) = STORE.lock() {
+        let target = (store.max_size as u64 * percent.min(100) as u64 / 100) as usize;
+        let before = store.items.len();
+        evict_to_size(&mut store, target);
+        return before - store.items.len();
+    }
+    0
+}
+
+/// Evict at least `size` bytes if possible, returning the bytes freed
+pub fn store_scavenge(size: usize) -> usize {
+    if let Ok(mut store) = STORE.lock() {
+        let before = store.current_size;
+        evict_to_size(&mut store, before.saturating_sub(size));
+        return before - store.current_size;
+    }
+    0
 }
 
 /// Manually trigger eviction
@@ -758,6 +1427,10 @@ pub extern "C" fn fz_store_evict_type(_ctx: Handle, item_type: i32) -> usize {
         7 => StoreType::DisplayList,
         8 => StoreType::Document,
         9 => StoreType::Page,
+        10 => StoreType::EdgeList,
+        11 => StoreType::DecodedImage,
+        12 => StoreType::ContentProgram,
+        13 => StoreType::ShapedText,
         _ => StoreType::Generic,
     };
 
@@ -788,15 +1461,9 @@ pub extern "C" fn fz_store_evict_old(_ctx: Handle, max_age_ms: u64) -> usize {
         let count = victims.len();
 
         for id in victims {
-            if let Some(item) = store.items.remove(&id) {
-                if !item.key.is_empty() {
-                    store.key_map.remove(&item.key);
-                }
-                store.current_size = store.current_size.saturating_sub(item.size);
-                if let Some(type_size) = store.type_sizes.get_mut(&item.item_type) {
-                    *type_size = type_size.saturating_sub(item.size);
-                }
+            if let Some(item) = take_item(&mut store, id) {
                 store.total_evicted += 1;
+                item.discard();
             }
         }
 
@@ -810,7 +1477,9 @@ pub extern "C" fn fz_store_evict_old(_ctx: Handle, max_age_ms: u64) -> usize {
 pub extern "C" fn fz_store_clear(_ctx: Handle) {
     if let Ok(mut store) = STORE.lock() {
         let count = store.items.len() as u64;
-        store.items.clear();
+        for (_, item) in store.items.drain() {
+            item.discard();
+        }
         store.key_map.clear();
         store.current_size = 0;
         store.type_sizes.clear();
@@ -826,6 +1495,7 @@ pub extern "C" fn fz_store_reset_stats(_ctx: Handle) {
         store.misses = 0;
         store.total_stored = 0;
         store.total_evicted = 0;
+        store.total_rejected = 0;
     }
 }
 
@@ -856,6 +1526,11 @@ pub extern "C" fn fz_store_debug(_ctx: Handle) {
 // Tests
 // ============================================================================
 
+/// Serializes tests that clear the whole store against tests that rely on
+/// items staying cached
+#[cfg(test)]
+pub(crate) static STORE_TEST_LOCK: Mutex<()> = Mutex::new(());
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -990,6 +1665,7 @@ mod tests {
 
     #[test]
     fn test_store_clear() {
+        let _guard = STORE_TEST_LOCK.lock().unwrap_or_else(|e| e.into_inner());
         // Add items with unique prefix
         let prefix = unique_key("clear");
         let prefix_str = String::from_utf8_lossy(&prefix);
@@ -1054,6 +1730,130 @@ mod tests {
         fz_store_remove(0, id);
     }
 
+    fn cost_aware_store(max_size: usize) -> Store {
+        Store {
+            max_size,
+            policy: EvictionPolicy::CostAware,
+            ..Default::default()
+        }
+    }
+
+    fn put(store: &mut Store, t: StoreType, key: &str, size: usize) -> Option<u64> {
+        insert_into(store, t, 1, size, key.as_bytes().to_vec(), None)
+    }
+
+    fn find(store: &mut Store, key: &str) -> bool {
+        store.record_access(key.as_bytes());
+        let id = store.key_map.get(key.as_bytes()).copied();
+        id.and_then(|id| store.touch(id)).is_some()
+    }
+
+    #[test]
+    fn test_frequency_sketch() {
+        let mut sketch = FrequencySketch::default();
+        for _ in 0..5 {
+            sketch.record(key_hash(b"hot"));
+        }
+        sketch.record(key_hash(b"cold"));
+        assert!(sketch.estimate(key_hash(b"hot")) >= 5);
+        assert!(sketch.estimate(key_hash(b"cold")) >= 1);
+        assert_eq!(sketch.estimate(key_hash(b"never")), 0);
+
+        // Aging halves old counts
+        let hot = sketch.estimate(key_hash(b"hot"));
+        sketch.age();
+        assert_eq!(sketch.estimate(key_hash(b"hot")), hot / 2);
+        assert_eq!(sketch.estimate(key_hash(b"cold")), 0);
+    }
+
+    #[test]
+    fn test_cost_aware_prefers_evicting_large_items() {
+        let mut store = cost_aware_store(10_000);
+        for i in 0..50 {
+            put(&mut store, StoreType::Font, &format!("font{i}"), 100).unwrap();
+        }
+        put(&mut store, StoreType::Image, "image", 5_000).unwrap();
+        for i in 0..50 {
+            assert!(find(&mut store, &format!("font{i}")));
+        }
+
+        // Room is made by dropping the big image, not dozens of small fonts
+        put(&mut store, StoreType::Font, "font_new", 1_000).unwrap();
+        assert!(!store.key_map.contains_key(&b"image"[..]));
+        assert!((0..50).all(|i| store.key_map.contains_key(format!("font{i}").as_bytes())));
+        assert!(store.clock > 0.0);
+    }
+
+    #[test]
+    fn test_cost_aware_rejects_one_off_scan() {
+        let mut store = cost_aware_store(1_000);
+        for i in 0..10 {
+            let key = format!("hot{i}");
+            put(&mut store, StoreType::Path, &key, 100).unwrap();
+            for _ in 0..3 {
+                assert!(find(&mut store, &key));
+            }
+        }
+
+        // Keys seen once do not displace keys in regular use
+        for i in 0..100 {
+            assert_eq!(
+                put(&mut store, StoreType::Path, &format!("scan{i}"), 100),
+                None
+            );
+        }
+        assert_eq!(store.total_rejected, 100);
+        assert!((0..10).all(|i| store.key_map.contains_key(format!("hot{i}").as_bytes())));
+
+        // A key that keeps being asked for gets in
+        for _ in 0..6 {
+            assert!(!find(&mut store, "wanted"));
+        }
+        assert!(put(&mut store, StoreType::Path, "wanted", 100).is_some());
+    }
+
+    #[test]
+    fn test_pressure_targets() {
+        let mut store = Store {
+            max_size: 1_000,
+            ..Default::default()
+        };
+        for i in 0..10 {
+            insert_into(
+                &mut store,
+                StoreType::Generic,
+                1,
+                100,
+                format!("p{i}").into_bytes(),
+                None,
+            )
+            .unwrap();
+        }
+
+        // Without a soft watermark, no pressure means nothing to do
+        assert_eq!(relieve_pressure(&mut store, PressureLevel::None), 0);
+
+        store.soft_limit = 800;
+        assert_eq!(relieve_pressure(&mut store, PressureLevel::None), 2);
+        assert_eq!(store.current_size, 800);
+        assert_eq!(relieve_pressure(&mut store, PressureLevel::Moderate), 4);
+        assert_eq!(store.current_size, 400);
+
+        // Pinned items survive even critical pressure
+        let pinned = *store.key_map.get(&b"p9"[..]).unwrap();
+        store.items.get_mut(&pinned).unwrap().evictable = false;
+        assert_eq!(relieve_pressure(&mut store, PressureLevel::Critical), 3);
+        assert_eq!(store.current_size, 100);
+        assert_eq!(store.pressure_evicted, 9);
+    }
+
+    #[test]
+    fn test_pressure_level_from_i32() {
+        assert_eq!(PressureLevel::from_i32(-3), PressureLevel::None);
+        assert_eq!(PressureLevel::from_i32(1), PressureLevel::Moderate);
+        assert_eq!(PressureLevel::from_i32(7), PressureLevel::Critical);
+    }
+
     #[test]
     fn test_non_evictable() {
         let key1 = unique_key("pinned");
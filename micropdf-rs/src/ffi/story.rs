@@ -8,7 +8,9 @@ use std::ffi::{CStr, CString};
 use std::os::raw::c_char;
 use std::sync::LazyLock;
 
+use crate::ffi::hyphen::{Hyphenator, TextLanguage};
 use crate::ffi::stext::Rect;
+use crate::ffi::string_util::{is_cjk_char, is_line_break_after};
 use crate::ffi::{Handle, HandleStore};
 
 /// Global store for stories
@@ -164,6 +166,219 @@ pub struct PlacedRegion {
     pub filled: Rect,
 }
 
+// ============================================================================
+// Text Measurement and Line Breaking
+// ============================================================================
+
+/// Average glyph advance, in ems
+const STORY_ADVANCE: f32 = 0.5;
+/// Advance of CJK glyphs, in ems
+const STORY_CJK_ADVANCE: f32 = 1.0;
+/// Line height, in ems
+const STORY_LINE_HEIGHT: f32 = 1.2;
+
+fn char_advance(c: char) -> f32 {
+    if is_cjk_char(c) {
+        STORY_CJK_ADVANCE
+    } else {
+        STORY_ADVANCE
+    }
+}
+
+/// Text between two line break opportunities, measured in ems
+#[derive(Debug, Clone)]
+struct Segment {
+    /// Byte range in the element text, trailing space excluded
+    start: usize,
+    end: usize,
+    /// Width without the trailing space
+    width: f32,
+    /// Width of the trailing space
+    space: f32,
+    /// Hyphenation points: byte offset and the width before it
+    hyphens: Vec<(usize, f32)>,
+}
+
+/// An element's text cut at its break opportunities
+///
+/// Widths are in ems and don't depend on the rectangle or the font
+/// size, so measuring happens once per element however often the story
+/// is placed or re-placed.
+#[derive(Debug, Clone, Default)]
+struct MeasuredText {
+    segments: Vec<Segment>,
+}
+
+impl MeasuredText {
+    fn new(text: &str, hyphenator: Option<&Hyphenator>) -> Self {
+        let mut segments = Vec::new();
+        let mut seg = Segment {
+            start: 0,
+            end: 0,
+            width: 0.0,
+            space: 0.0,
+            hyphens: Vec::new(),
+        };
+        for (i, c) in text.char_indices() {
+            if c.is_whitespace() {
+                seg.space += STORY_ADVANCE;
+            } else {
+                if c != '\u{00AD}' {
+                    seg.width += char_advance(c);
+                }
+                seg.end = i + c.len_utf8();
+            }
+            if is_line_break_after(c) && !text[i + c.len_utf8()..].starts_with(char::is_whitespace)
+            {
+                let next = i + c.len_utf8();
+                let done = std::mem::replace(
+                    &mut seg,
+                    Segment {
+                        start: next,
+                        end: next,
+                        width: 0.0,
+                        space: 0.0,
+                        hyphens: Vec::new(),
+                    },
+                );
+                segments.push(done);
+            }
+        }
+        if seg.end > seg.start || segments.is_empty() {
+            segments.push(seg);
+        }
+
+        if let Some(hyph) = hyphenator {
+            for seg in &mut segments {
+                seg.hyphens = hyphen_points(&text[seg.start..seg.end], seg.start, hyph);
+            }
+        }
+        Self { segments }
+    }
+}
+
+/// Hyphenation points in the alphabetic run at the start of `word`
+fn hyphen_points(word: &str, offset: usize, hyph: &Hyphenator) -> Vec<(usize, f32)> {
+    let letters = word
+        .char_indices()
+        .find(|&(_, c)| !c.is_alphabetic())
+        .map_or(word.len(), |(i, _)| i);
+    let run = &word[..letters];
+    let mut points = Vec::new();
+    let mut width = 0.0;
+    for ((i, c), hyphen) in run.char_indices().zip(hyph.hyphenate(run)) {
+        width += char_advance(c);
+        if hyphen {
+            points.push((offset + i + c.len_utf8(), width));
+        }
+    }
+    points
+}
+
+/// One line of an element
+#[derive(Debug, Clone, Copy, PartialEq)]
+pub struct StoryLine {
+    /// Byte range in the element text
+    pub start: usize,
+    pub end: usize,
+    /// Width in ems, a break hyphen included
+    pub width: f32,
+    /// The line ends in an inserted hyphen
+    pub hyphenated: bool,
+}
+
+/// An element broken into lines for one line width
+#[derive(Debug, Clone)]
+struct ElementLines {
+    /// Line width and font size the lines were broken for, as float bits
+    key: (u32, u32),
+    lines: Vec<StoryLine>,
+    /// Some text is wider than the line even where hyphenated
+    overflow: bool,
+}
+
+/// Break measured text greedily into lines `max` ems wide
+///
+/// A segment that doesn't fit is hyphenated at the last point that
+/// does, else moved to the next line; a segment wider than a whole line
+/// overflows.
+fn break_lines(measured: &MeasuredText, max: f32) -> (Vec<StoryLine>, bool) {
+    let hyphen = char_advance('-');
+    let mut lines = Vec::new();
+    let mut overflow = false;
+    let mut line = StoryLine {
+        start: 0,
+        end: 0,
+        width: 0.0,
+        hyphenated: false,
+    };
+    let mut gap = 0.0;
+
+    for seg in &measured.segments {
+        // Width of the segment already put on earlier lines
+        let mut consumed = 0.0;
+        let mut from = seg.start;
+        loop {
+            let rest = seg.width - consumed;
+            let gap_here = if line.end > line.start { gap } else { 0.0 };
+            if line.width + gap_here + rest <= max {
+                line.width += gap_here + rest;
+                line.end = seg.end;
+                break;
+            }
+            let fit = seg.hyphens.iter().rev().find(|&&(at, w)| {
+                at > from && line.width + gap_here + (w - consumed) + hyphen <= max
+            });
+            if let Some(&(at, w)) = fit {
+                lines.push(StoryLine {
+                    end: at,
+                    width: line.width + gap_here + (w - consumed) + hyphen,
+                    hyphenated: true,
+                    ..line
+                });
+                line = StoryLine {
+                    start: at,
+                    end: at,
+                    width: 0.0,
+                    hyphenated: false,
+                };
+                consumed = w;
+                from = at;
+                continue;
+            }
+            if line.end > line.start {
+                lines.push(line);
+                line = StoryLine {
+                    start: from,
+                    end: from,
+                    width: 0.0,
+                    hyphenated: false,
+                };
+                continue;
+            }
+            // Nothing fits on an empty line
+            overflow = true;
+            line.width = rest;
+            line.end = seg.end;
+            break;
+        }
+        gap = seg.space;
+    }
+    if line.end > line.start || lines.is_empty() {
+        lines.push(line);
+    }
+    (lines, overflow)
+}
+
+/// Font size of an element relative to the story's em
+fn font_scale(elem: &StoryElement) -> f32 {
+    if elem.is_heading() {
+        1.5 + (6 - elem.heading_level) as f32 * 0.2
+    } else {
+        1.0
+    }
+}
+
 /// HTML Story for layout and rendering
 pub struct Story {
     /// Original HTML content
@@ -186,6 +401,17 @@ pub struct Story {
     pub placed_regions: Vec<PlacedRegion>,
     /// Current rectangle number
     pub rectangle_num: i32,
+    /// Lines of the element at `layout_position` already placed
+    pub line_position: usize,
+    /// Hyphenator for line breaking, if hyphenation is on
+    hyphenator: Option<Hyphenator>,
+    /// Measured text per element, kept across placements and resets
+    measured: Vec<Option<MeasuredText>>,
+    /// Line breaks per element for the last width it was placed at
+    lines: Vec<Option<ElementLines>>,
+    /// Elements measured and broken into lines so far
+    measure_count: usize,
+    break_count: usize,
     /// Cached strings for FFI
     cached_strings: HashMap<String, CString>,
 }
@@ -204,6 +430,12 @@ impl Story {
             layout_position: 0,
             placed_regions: Vec::new(),
             rectangle_num: 0,
+            line_position: 0,
+            hyphenator: None,
+            measured: Vec::new(),
+            lines: Vec::new(),
+            measure_count: 0,
+            break_count: 0,
             cached_strings: HashMap::new(),
         };
 
@@ -316,7 +548,55 @@ impl Story {
         None
     }
 
+    /// Hyphenate with the patterns for `language`, or not at all for
+    /// [`TextLanguage::Unset`]
+    pub fn set_hyphenation(&mut self, language: TextLanguage) {
+        self.hyphenator = match language {
+            TextLanguage::Unset => None,
+            lang => Some(Hyphenator::with_language(lang)),
+        };
+        self.measured.clear();
+        self.lines.clear();
+    }
+
+    /// Lines of element `index` at a line width in points
+    ///
+    /// Measurement is cached per element and line breaks per element and
+    /// width, so placing into rectangles of the same width only redoes
+    /// the vertical fit, and a new width only redoes line breaking.
+    fn element_lines(&mut self, index: usize, width: f32) -> &ElementLines {
+        let Some(doc) = self.document.as_ref() else {
+            unreachable!("placing a story without a document");
+        };
+        let elem = &doc.children[index];
+        let size = self.em * font_scale(elem);
+        let key = (width.to_bits(), size.to_bits());
+        if self.measured.len() < doc.children.len() {
+            self.measured.resize(doc.children.len(), None);
+            self.lines.resize(doc.children.len(), None);
+        }
+
+        if self.lines[index].as_ref().is_none_or(|l| l.key != key) {
+            let measured = self.measured[index].get_or_insert_with(|| {
+                self.measure_count += 1;
+                MeasuredText::new(elem.text.as_deref().unwrap_or(""), self.hyphenator.as_ref())
+            });
+            self.break_count += 1;
+            let (lines, overflow) = break_lines(measured, width / size);
+            self.lines[index] = Some(ElementLines {
+                key,
+                lines,
+                overflow,
+            });
+        }
+        self.lines[index].as_ref().expect("just broken")
+    }
+
     /// Place story content into a rectangle
+    ///
+    /// Elements are broken into lines for the rectangle's width and
+    /// placed a line at a time, so an element can continue into the next
+    /// rectangle.
     pub fn place(&mut self, where_rect: Rect, flags: i32) -> (PlaceStoryReturn, Rect) {
         if self.state == StoryState::Complete {
             return (PlaceStoryReturn::AllFitted, Rect::default());
@@ -333,73 +613,77 @@ impl Story {
         };
 
         // Get elements to place
-        let elements = if let Some(ref doc) = self.document {
-            &doc.children
-        } else {
-            return (PlaceStoryReturn::AllFitted, filled);
+        let count = match self.document {
+            Some(ref doc) => doc.children.len(),
+            None => return (PlaceStoryReturn::AllFitted, filled),
         };
 
-        if self.layout_position >= elements.len() {
+        if self.layout_position >= count {
             self.state = StoryState::Complete;
             return (PlaceStoryReturn::AllFitted, filled);
         }
 
-        // Simple layout: stack elements vertically
-        let mut y = where_rect.y0;
-        let line_height = self.em * 1.2;
+        let width = where_rect.x1 - where_rect.x0;
         let margin = self.em * 0.5;
-
-        let mut placed_count = 0;
         let check_overflow = flags & (PlaceStoryFlag::NoOverflow as i32) != 0;
 
-        while self.layout_position < elements.len() {
-            let elem = &elements[self.layout_position];
-
-            // Calculate element height based on content
-            let elem_height = if elem.is_heading() {
-                line_height * (1.5 + (6 - elem.heading_level) as f32 * 0.2)
-            } else {
-                line_height
-            };
+        let mut y = where_rect.y0;
+        let first = self.layout_position;
+        'elements: while self.layout_position < count {
+            let index = self.layout_position;
+            let scale = self
+                .document
+                .as_ref()
+                .map_or(1.0, |d| font_scale(&d.children[index]));
+            let line_height = self.em * scale * STORY_LINE_HEIGHT;
+            let line_position = self.line_position;
+            let lines = self.element_lines(index, width);
+            let (total, overflow) = (lines.lines.len(), lines.overflow);
 
-            // Check if element fits
-            if y + elem_height + margin > where_rect.y1 {
-                // No more room
-                break;
+            // Check width overflow if flag set
+            if check_overflow && overflow {
+                self.state = StoryState::Placed;
+                return (PlaceStoryReturn::OverflowWidth, filled);
             }
 
-            // Check width overflow if flag set
-            if check_overflow {
-                if let Some(ref text) = elem.text {
-                    let estimated_width = text.len() as f32 * self.em * 0.5;
-                    if estimated_width > (where_rect.x1 - where_rect.x0) {
-                        self.state = StoryState::Placed;
-                        return (PlaceStoryReturn::OverflowWidth, filled);
-                    }
+            for line in line_position..total {
+                // The last line also needs room for the element's margin
+                let needed = if line + 1 == total {
+                    line_height + margin
+                } else {
+                    line_height
+                };
+                if y + needed > where_rect.y1 {
+                    // No more room
+                    break 'elements;
                 }
+                y += line_height;
+                self.line_position = line + 1;
             }
 
-            // Place element
-            y += elem_height + margin;
-            placed_count += 1;
+            // Element done
+            y += margin;
             self.layout_position += 1;
+            self.line_position = 0;
+        }
 
-            // Update filled rect
+        if y > where_rect.y0 {
             filled.x1 = where_rect.x1;
-            filled.y1 = y;
+            filled.y1 = y.min(where_rect.y1);
         }
 
         // Create placed region
+        let last = self.layout_position + usize::from(self.line_position > 0);
         let region = PlacedRegion {
             rect: where_rect,
-            elements: (self.layout_position - placed_count..self.layout_position).collect(),
+            elements: (first..last).collect(),
             filled,
         };
         self.placed_regions.push(region);
 
         self.state = StoryState::Placed;
 
-        if self.layout_position >= elements.len() {
+        if self.layout_position >= count {
             self.state = StoryState::Complete;
             (PlaceStoryReturn::AllFitted, filled)
         } else {
@@ -416,8 +700,12 @@ impl Story {
     }
 
     /// Reset layout position to start
+    ///
+    /// Measured text and line breaks are kept, so placing the story again
+    /// into rectangles of the same widths does no text work.
     pub fn reset(&mut self) {
         self.layout_position = 0;
+        self.line_position = 0;
         self.placed_regions.clear();
         self.rectangle_num = 0;
         self.state = StoryState::Created;
@@ -687,6 +975,15 @@ pub extern "C" fn fz_story_positions(
 // Additional Utility Functions
 // ============================================================================
 
+/// Set the hyphenation language (0 turns hyphenation off)
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_story_set_hyphenation(story: Handle, language: i32) {
+    if let Some(story_arc) = STORIES.get(story) {
+        let mut story_guard = story_arc.lock().unwrap();
+        story_guard.set_hyphenation(TextLanguage::from_i32(language));
+    }
+}
+
 /// Get story state
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_story_state(story: Handle) -> i32 {
@@ -884,6 +1181,72 @@ mod tests {
         crate::ffi::buffer::fz_drop_buffer(ctx, buf);
     }
 
+    #[test]
+    fn test_break_lines_hyphenates() {
+        let mut hyph = Hyphenator::new();
+        hyph.add_pattern("1ba");
+        let text = "x basketball";
+        let measured = MeasuredText::new(text, Some(&hyph));
+        assert_eq!(measured.segments.len(), 2);
+
+        let (lines, overflow) = break_lines(&measured, 4.5);
+        assert!(!overflow);
+        let parts: Vec<&str> = lines.iter().map(|l| &text[l.start..l.end]).collect();
+        assert_eq!(parts, ["x basket", "ball"]);
+        assert!(lines[0].hyphenated);
+
+        // Without hyphenation the word moves down, and overflows a line too narrow for it
+        let (lines, overflow) = break_lines(&MeasuredText::new(text, None), 4.5);
+        let parts: Vec<&str> = lines.iter().map(|l| &text[l.start..l.end]).collect();
+        assert_eq!(parts, ["x", "basketball"]);
+        assert!(overflow);
+    }
+
+    #[test]
+    fn test_story_flows_across_rectangles() {
+        let words = "lorem ipsum dolor sit amet ".repeat(40);
+        let html = format!("<h1>Report</h1><p>{words}</p><p>{words}</p>");
+        let mut story = Story::new(&html, "", 12.0, None);
+        let column = |y1| Rect {
+            x0: 0.0,
+            y0: 0.0,
+            x1: 200.0,
+            y1,
+        };
+
+        let mut rects = 0;
+        while story.place(column(150.0), 0).0 == PlaceStoryReturn::MoreToFit {
+            rects += 1;
+            assert!(rects < 100);
+        }
+        assert!(rects > 2);
+        // Each element is measured and broken once for all those rectangles
+        assert_eq!((story.measure_count, story.break_count), (3, 3));
+        let lines = story.lines[1].as_ref().unwrap().lines.len();
+        assert!(lines > 10);
+
+        // Taller rectangles of the same width reuse the line breaks
+        story.reset();
+        while story.place(column(400.0), 0).0 == PlaceStoryReturn::MoreToFit {}
+        assert_eq!((story.measure_count, story.break_count), (3, 3));
+
+        // A new width re-breaks lines but never re-measures
+        story.reset();
+        let wide = Rect {
+            x1: 600.0,
+            ..column(792.0)
+        };
+        assert_eq!(story.place(wide, 0).0, PlaceStoryReturn::AllFitted);
+        assert_eq!((story.measure_count, story.break_count), (3, 6));
+        assert!(story.lines[1].as_ref().unwrap().lines.len() < lines);
+
+        // Hyphenation changes the measurement
+        story.set_hyphenation(TextLanguage::En);
+        story.reset();
+        story.place(wide, 0);
+        assert_eq!(story.measure_count, 6);
+    }
+
     #[test]
     fn test_story_is_complete() {
         let ctx = 1;
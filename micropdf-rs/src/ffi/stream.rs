@@ -1,26 +1,32 @@
 //! C FFI for stream - MuPDF compatible
 //! Safe Rust implementation using handle-based resource management
 
+use super::mmap::{AccessPattern, FileBytes};
 use super::{BUFFERS, Handle, STREAMS};
 use std::ffi::c_char;
+use std::sync::Arc;
 
 /// Internal stream state
+///
+/// The bytes are shared, so a document opened from a stream (or a mapped
+/// file) reuses them instead of copying.
 pub struct Stream {
-    pub(crate) data: Vec<u8>,
+    pub(crate) data: Arc<FileBytes>,
     position: usize,
     eof: bool,
 }
 
 impl Stream {
     pub fn new() -> Self {
-        Self {
-            data: Vec::new(),
-            position: 0,
-            eof: true,
-        }
+        Self::from_memory(Vec::new())
     }
 
     pub fn from_memory(data: Vec<u8>) -> Self {
+        Self::from_bytes(Arc::new(FileBytes::from(data)))
+    }
+
+    /// Stream over shared (possibly mapped) bytes
+    pub fn from_bytes(data: Arc<FileBytes>) -> Self {
         let eof = data.is_empty();
         Self {
             data,
@@ -67,6 +73,24 @@ impl Stream {
         Some(self.data[self.position])
     }
 
+    /// Up to `max` bytes from the current position, without consuming them
+    ///
+    /// The bytes are the stream's own, so a bulk reader parses them in
+    /// place and then [`consume`](Self::consume)s what it used.
+    pub fn peek(&self, max: usize) -> &[u8] {
+        let start = self.position.min(self.data.len());
+        let end = start + max.min(self.data.len() - start);
+        &self.data[start..end]
+    }
+
+    /// Move past `n` bytes (at most what's left), returning how many
+    pub fn consume(&mut self, n: usize) -> usize {
+        let n = n.min(self.data.len().saturating_sub(self.position));
+        self.position += n;
+        self.eof = self.position >= self.data.len();
+        n
+    }
+
     pub fn seek(&mut self, offset: i64, whence: i32) {
         let new_pos = match whence {
             0 => offset as usize,                            // SEEK_SET
@@ -122,8 +146,12 @@ pub extern "C" fn fz_open_file(_ctx: Handle, filename: *const c_char) -> Handle
         Err(_) => return 0,
     };
 
-    match std::fs::read(path) {
-        Ok(data) => STREAMS.insert(Stream::from_memory(data)),
+    // Mapped, so reads come straight from the page cache
+    match FileBytes::map(path) {
+        Ok(data) => {
+            data.advise(AccessPattern::Sequential);
+            STREAMS.insert(Stream::from_bytes(Arc::new(data)))
+        }
         Err(_) => 0,
     }
 }
@@ -200,6 +228,49 @@ pub extern "C" fn fz_peek_byte(_ctx: Handle, stm: Handle) -> i32 {
     -1
 }
 
+/// Borrow up to `max` bytes at the stream's position, without copying or
+/// consuming them; `len` receives how many there are
+///
+/// The bytes never move while the stream is open (reads and seeks only
+/// change the position), so the pointer stays valid until the stream is
+/// dropped. Parse the window in place and `fz_consume` what was used.
+///
+/// # Safety
+/// Caller must ensure `len` points to writable memory for a `usize`.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_peek_bytes(
+    _ctx: Handle,
+    stm: Handle,
+    max: usize,
+    len: *mut usize,
+) -> *const u8 {
+    if len.is_null() {
+        return std::ptr::null();
+    }
+    let mut window: (*const u8, usize) = (std::ptr::null(), 0);
+    if let Some(stream) = STREAMS.get(stm) {
+        if let Ok(guard) = stream.lock() {
+            let bytes = guard.peek(max);
+            window = (bytes.as_ptr(), bytes.len());
+        }
+    }
+    // SAFETY: Caller guarantees len points to a writable usize
+    unsafe { *len = window.1 };
+    window.0
+}
+
+/// Consume `n` bytes of a window taken with `fz_peek_bytes`, returning how
+/// many the stream had left to skip
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_consume(_ctx: Handle, stm: Handle, n: usize) -> usize {
+    if let Some(stream) = STREAMS.get(stm) {
+        if let Ok(mut guard) = stream.lock() {
+            return guard.consume(n);
+        }
+    }
+    0
+}
+
 /// Check if stream is at EOF
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_is_eof(_ctx: Handle, stm: Handle) -> i32 {
@@ -497,6 +568,33 @@ mod tests {
         fz_drop_stream(0, handle);
     }
 
+    #[test]
+    fn test_stream_peek_consume() {
+        let data = vec![1, 2, 3, 4, 5];
+        let handle = STREAMS.insert(Stream::from_memory(data));
+
+        let mut len = 0;
+        let ptr = fz_peek_bytes(0, handle, 3, &mut len);
+        assert_eq!(len, 3);
+        // SAFETY: the stream is still open
+        assert_eq!(unsafe { std::slice::from_raw_parts(ptr, len) }, [1, 2, 3]);
+        assert_eq!(fz_tell(0, handle), 0);
+
+        assert_eq!(fz_consume(0, handle, 2), 2);
+        assert_eq!(fz_read_byte(0, handle), 3);
+
+        let ptr = fz_peek_bytes(0, handle, 100, &mut len);
+        assert_eq!(len, 2);
+        assert_eq!(unsafe { std::slice::from_raw_parts(ptr, len) }, [4, 5]);
+        assert_eq!(fz_consume(0, handle, 100), 2);
+        assert_eq!(fz_is_eof(0, handle), 1);
+
+        fz_peek_bytes(0, handle, 4, &mut len);
+        assert_eq!(len, 0);
+
+        fz_drop_stream(0, handle);
+    }
+
     #[test]
     fn test_stream_eof() {
         let data = vec![1];
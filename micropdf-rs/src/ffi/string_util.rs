@@ -1,7 +1,10 @@
 //! C FFI for advanced string handling - MuPDF compatible
 //! Safe Rust implementation of fz_string utilities
 
-use super::Handle;
+use super::buffer::Buffer;
+use super::simd_util::{ascii_prefix, prefix_below};
+use super::stext::{STEXT_PAGES, StextSoA};
+use super::{BUFFERS, Handle};
 use std::ffi::{CStr, c_char};
 
 /// Unicode normalization form
@@ -402,13 +405,7 @@ pub extern "C" fn fz_find_line_breaks(
     let mut break_count = 0;
 
     for (i, c) in text_str.char_indices() {
-        // Break after spaces, hyphens, and CJK characters
-        let is_break_after = c.is_whitespace()
-            || c == '-'
-            || c == '\u{00AD}' // Soft hyphen
-            || is_cjk_char(c);
-
-        if is_break_after && break_count < max_breaks {
+        if is_line_break_after(c) && break_count < max_breaks {
             breaks_slice[break_count] = (i + c.len_utf8()) as i32;
             break_count += 1;
         }
@@ -417,7 +414,13 @@ pub extern "C" fn fz_find_line_breaks(
     break_count
 }
 
-fn is_cjk_char(c: char) -> bool {
+/// Check if a line may break after `c`: spaces, hyphens (soft hyphens
+/// included) and CJK characters
+pub(crate) fn is_line_break_after(c: char) -> bool {
+    c.is_whitespace() || c == '-' || c == '\u{00AD}' || is_cjk_char(c)
+}
+
+pub(crate) fn is_cjk_char(c: char) -> bool {
     matches!(c,
         '\u{4E00}'..='\u{9FFF}' |   // CJK Unified Ideographs
         '\u{3400}'..='\u{4DBF}' |   // CJK Extension A
@@ -471,10 +474,216 @@ fn char_script(c: char) -> ScriptCategory {
     }
 }
 
+// ============================================================================
+// Page Batches
+// ============================================================================
+//
+// The per-string functions above, run over every line of a structured text
+// page at once. Most lines of most documents are plain ASCII, or at least
+// hold no right-to-left script, so each line's codepoints are first scanned
+// with `prefix_below`; only lines that fail the scan take the general path.
+
+/// Codepoints below this are ASCII
+const ASCII_END: u32 = 0x80;
+/// No right-to-left script starts below this (Hebrew)
+const RTL_START: u32 = 0x0590;
+
+/// Run `f` over the char arrays of stext page `page`
+fn with_page_chars<R>(page: Handle, f: impl FnOnce(&StextSoA) -> R) -> Option<R> {
+    let arc = STEXT_PAGES.get(page)?;
+    let mut p = arc.lock().ok()?;
+    Some(f(p.soa()))
+}
+
+fn page_char(c: u32) -> char {
+    char::from_u32(c).unwrap_or(char::REPLACEMENT_CHARACTER)
+}
+
+fn is_ascii_space(c: u32) -> bool {
+    matches!(c, 0x09..=0x0D | 0x20)
+}
+
+/// Copy out up to `max` of `found`, returning how many were written
+fn write_breaks(found: &[i32], breaks: *mut i32, max: usize) -> usize {
+    let n = found.len().min(max);
+    let out = unsafe { std::slice::from_raw_parts_mut(breaks, n) };
+    out.copy_from_slice(&found[..n]);
+    n
+}
+
+/// Reorder every line of an stext page for display
+///
+/// Lines are written in page order, each in visual order and ended with
+/// `'\n'`. Lines with no right-to-left characters are copied as they are.
+///
+/// # Returns
+/// A buffer handle holding the UTF-8 text, or 0 if the page is invalid
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_bidi_reorder_stext_page(_ctx: Handle, page: Handle, base_dir: i32) -> Handle {
+    let base_rtl = base_dir == BiDiDirection::RTL as i32;
+    with_page_chars(page, |soa| {
+        let mut text = String::with_capacity(soa.char_count() + soa.line_count());
+        for l in 0..soa.line_count() {
+            let cps = &soa.codepoints[soa.line_chars(l)];
+            if prefix_below(cps, RTL_START) == cps.len() {
+                text.extend(cps.iter().map(|&c| page_char(c)));
+            } else {
+                let line: String = cps.iter().map(|&c| page_char(c)).collect();
+                text.push_str(&bidi_reorder_simple(&line, base_rtl));
+            }
+            text.push('\n');
+        }
+        BUFFERS.insert(Buffer::from_vec(text.into_bytes()))
+    })
+    .unwrap_or(0)
+}
+
+/// Find word starts over a whole stext page
+///
+/// Breaks are page char indices, in the order of `fz_stext_page_fill_flat`;
+/// a word never runs on across the end of a line.
+///
+/// # Returns
+/// Number of breaks written, at most `max_breaks`
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_find_stext_word_breaks(
+    _ctx: Handle,
+    page: Handle,
+    breaks: *mut i32,
+    max_breaks: usize,
+) -> usize {
+    if breaks.is_null() || max_breaks == 0 {
+        return 0;
+    }
+    with_page_chars(page, |soa| {
+        let mut found = Vec::new();
+        for l in 0..soa.line_count() {
+            let range = soa.line_chars(l);
+            let cps = &soa.codepoints[range.clone()];
+            let ascii = prefix_below(cps, ASCII_END) == cps.len();
+            let mut prev_was_space = true;
+            for (i, &c) in range.zip(cps) {
+                let is_space = if ascii {
+                    is_ascii_space(c)
+                } else {
+                    page_char(c).is_whitespace()
+                };
+                if prev_was_space && !is_space {
+                    found.push(i as i32);
+                }
+                prev_was_space = is_space;
+            }
+        }
+        write_breaks(&found, breaks, max_breaks)
+    })
+    .unwrap_or(0)
+}
+
+/// Find line break opportunities over a whole stext page
+///
+/// Each break is the page char index just after a char the line may break
+/// after, as `fz_find_line_breaks` gives byte offsets.
+///
+/// # Returns
+/// Number of breaks written, at most `max_breaks`
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_find_stext_line_breaks(
+    _ctx: Handle,
+    page: Handle,
+    breaks: *mut i32,
+    max_breaks: usize,
+) -> usize {
+    if breaks.is_null() || max_breaks == 0 {
+        return 0;
+    }
+    with_page_chars(page, |soa| {
+        let mut found = Vec::new();
+        for l in 0..soa.line_count() {
+            let range = soa.line_chars(l);
+            let cps = &soa.codepoints[range.clone()];
+            let ascii = prefix_below(cps, ASCII_END) == cps.len();
+            for (i, &c) in range.zip(cps) {
+                let breaks_after = if ascii {
+                    is_ascii_space(c) || c == '-' as u32
+                } else {
+                    is_line_break_after(page_char(c))
+                };
+                if breaks_after {
+                    found.push(i as i32 + 1);
+                }
+            }
+        }
+        write_breaks(&found, breaks, max_breaks)
+    })
+    .unwrap_or(0)
+}
+
+/// Detect the script of each line of an stext page
+///
+/// `scripts` receives one `ScriptCategory` per line, in page order: that of
+/// the line's first char with a script, as `fz_detect_script` does.
+///
+/// # Returns
+/// Number of lines written, at most `max_lines`
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_detect_stext_line_scripts(
+    _ctx: Handle,
+    page: Handle,
+    scripts: *mut i32,
+    max_lines: usize,
+) -> usize {
+    if scripts.is_null() || max_lines == 0 {
+        return 0;
+    }
+    with_page_chars(page, |soa| {
+        let n = soa.line_count().min(max_lines);
+        let out = unsafe { std::slice::from_raw_parts_mut(scripts, n) };
+        for (l, script) in out.iter_mut().enumerate() {
+            let cps = &soa.codepoints[soa.line_chars(l)];
+            // Within ASCII only letters have a script, and they are Latin
+            let ascii = prefix_below(cps, ASCII_END);
+            let category = if cps[..ascii]
+                .iter()
+                .any(|&c| page_char(c).is_ascii_alphabetic())
+            {
+                ScriptCategory::Latin
+            } else {
+                cps[ascii..]
+                    .iter()
+                    .map(|&c| char_script(page_char(c)))
+                    .find(|&s| s != ScriptCategory::Common)
+                    .unwrap_or(ScriptCategory::Common)
+            };
+            *script = category as i32;
+        }
+        n
+    })
+    .unwrap_or(0)
+}
+
 // ============================================================================
 // Language-Aware Operations
 // ============================================================================
 
+/// Case-fold one code point, keeping text and its per-character data aligned
+///
+/// Uses the lowercase mapping when it is a single character (the simple
+/// folding `fz_casefold` agrees with for all but a few expanding ones like
+/// 'İ'); other code points, and invalid ones, fold to themselves.
+pub fn fold_char(c: u32) -> u32 {
+    if c < 0x80 {
+        return (c as u8).to_ascii_lowercase() as u32;
+    }
+    let Some(ch) = char::from_u32(c) else {
+        return c;
+    };
+    let mut lower = ch.to_lowercase();
+    match (lower.next(), lower.next()) {
+        (Some(l), None) => l as u32,
+        _ => c,
+    }
+}
+
 /// Case-fold string for comparison
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_casefold(
@@ -492,7 +701,7 @@ pub extern "C" fn fz_casefold(
         Err(_) => return 0,
     };
 
-    let folded: String = input_str.chars().flat_map(|c| c.to_lowercase()).collect();
+    let folded = casefold_simple(input_str);
 
     let bytes = folded.as_bytes();
     let copy_len = bytes.len().min(output_size - 1);
@@ -504,6 +713,10 @@ pub extern "C" fn fz_casefold(
     copy_len
 }
 
+fn casefold_simple(s: &str) -> String {
+    s.chars().flat_map(|c| c.to_lowercase()).collect()
+}
+
 /// Compare strings with collation
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_strcoll(
@@ -597,6 +810,159 @@ pub extern "C" fn fz_byte_to_char_offset(
     -1
 }
 
+// ============================================================================
+// String Batches
+// ============================================================================
+//
+// Packed string arrays hold many strings back to back in one byte array:
+// string `i` is `data[offsets[i]..offsets[i + 1]]`, so `offsets` has
+// `count + 1` entries, as the flat stext arrays do. Search indexing
+// normalizes every extracted token this way without a C string or output
+// buffer per token.
+
+/// The strings of a packed array, `None` for one that isn't UTF-8
+///
+/// Returns `None` if a pointer is null or the offsets decrease.
+fn packed_strings<'a>(
+    data: *const u8,
+    offsets: *const u32,
+    count: usize,
+) -> Option<Vec<Option<&'a str>>> {
+    if offsets.is_null() || (data.is_null() && count > 0) {
+        return None;
+    }
+    let offsets = unsafe { std::slice::from_raw_parts(offsets, count + 1) };
+    if offsets.windows(2).any(|w| w[0] > w[1]) {
+        return None;
+    }
+    if count == 0 {
+        return Some(Vec::new());
+    }
+    let data = unsafe { std::slice::from_raw_parts(data, offsets[count] as usize) };
+    Some(
+        offsets
+            .windows(2)
+            .map(|w| std::str::from_utf8(&data[w[0] as usize..w[1] as usize]).ok())
+            .collect(),
+    )
+}
+
+/// Append `s` to `out`, passing ASCII spans through `ascii` and the spans
+/// between them through `other`
+///
+/// Both transforms work a character at a time, so splitting at ASCII
+/// boundaries doesn't change the result.
+fn map_spans(s: &str, out: &mut Vec<u8>, ascii: fn(&mut [u8]), other: fn(&str) -> String) {
+    let mut rest = s;
+    while !rest.is_empty() {
+        let n = ascii_prefix(rest.as_bytes());
+        let start = out.len();
+        out.extend_from_slice(&rest.as_bytes()[..n]);
+        ascii(&mut out[start..]);
+        rest = &rest[n..];
+
+        // Multibyte UTF-8 has no ASCII bytes, so this is a char boundary
+        let m = rest
+            .bytes()
+            .position(|b| b.is_ascii())
+            .unwrap_or(rest.len());
+        if m > 0 {
+            out.extend_from_slice(other(&rest[..m]).as_bytes());
+            rest = &rest[m..];
+        }
+    }
+}
+
+/// Map each string of a packed array into a buffer, recording where each
+/// result starts in `out_offsets` (`count + 1` entries)
+fn map_packed(
+    data: *const u8,
+    offsets: *const u32,
+    count: usize,
+    out_offsets: *mut u32,
+    ascii: fn(&mut [u8]),
+    other: fn(&str) -> String,
+) -> Handle {
+    if out_offsets.is_null() {
+        return 0;
+    }
+    let Some(strings) = packed_strings(data, offsets, count) else {
+        return 0;
+    };
+    let out_offsets = unsafe { std::slice::from_raw_parts_mut(out_offsets, count + 1) };
+    let mut out = Vec::with_capacity(strings.iter().flatten().map(|s| s.len()).sum());
+    out_offsets[0] = 0;
+    for (s, end) in strings.iter().zip(&mut out_offsets[1..]) {
+        // Invalid UTF-8 maps to an empty string, as the single-string calls
+        // return nothing for it
+        if let Some(s) = s {
+            map_spans(s, &mut out, ascii, other);
+        }
+        let Ok(len) = u32::try_from(out.len()) else {
+            return 0;
+        };
+        *end = len;
+    }
+    BUFFERS.insert(Buffer::from_vec(out))
+}
+
+/// Normalize every string of a packed array
+///
+/// ASCII spans are already normalized and copied straight through; only
+/// the text between them is normalized, as `fz_normalize_string` does.
+/// `form` is taken as there.
+///
+/// # Safety
+/// - `offsets` must hold `count + 1` entries and `data` `offsets[count]`
+///   bytes
+/// - `out_offsets` must have space for `count + 1` entries
+///
+/// # Returns
+/// A buffer handle holding the normalized strings packed by `out_offsets`,
+/// or 0 on invalid arguments
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_normalize_strings(
+    _ctx: Handle,
+    data: *const u8,
+    offsets: *const u32,
+    count: usize,
+    _form: i32,
+    out_offsets: *mut u32,
+) -> Handle {
+    map_packed(data, offsets, count, out_offsets, |_| {}, normalize_simple)
+}
+
+/// Case-fold every string of a packed array
+///
+/// ASCII spans are lowercased byte by byte; the text between them is
+/// folded as `fz_casefold` does.
+///
+/// # Safety
+/// - `offsets` must hold `count + 1` entries and `data` `offsets[count]`
+///   bytes
+/// - `out_offsets` must have space for `count + 1` entries
+///
+/// # Returns
+/// A buffer handle holding the folded strings packed by `out_offsets`, or
+/// 0 on invalid arguments
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_casefold_strings(
+    _ctx: Handle,
+    data: *const u8,
+    offsets: *const u32,
+    count: usize,
+    out_offsets: *mut u32,
+) -> Handle {
+    map_packed(
+        data,
+        offsets,
+        count,
+        out_offsets,
+        <[u8]>::make_ascii_lowercase,
+        casefold_simple,
+    )
+}
+
 // ============================================================================
 // Tests
 // ============================================================================
@@ -670,6 +1036,59 @@ mod tests {
         );
     }
 
+    #[test]
+    fn test_stext_page_batches() {
+        use crate::ffi::stext::{
+            fz_add_stext_block, fz_add_stext_char, fz_add_stext_line, fz_drop_stext_page,
+            fz_new_stext_page,
+        };
+
+        // An ASCII line, a Hebrew one after a digit and a blank one
+        let page = fz_new_stext_page(0, 0.0, 0.0, 612.0, 792.0);
+        let block = fz_add_stext_block(0, page, 0.0, 0.0, 612.0, 100.0);
+        for text in ["ab cd-ef", "1 \u{05E9}\u{05DC}\u{05D5}\u{05DD}", "  "] {
+            let line = fz_add_stext_line(0, page, block, 0.0, 0.0, 612.0, 12.0);
+            for (i, c) in text.chars().enumerate() {
+                fz_add_stext_char(0, page, block, line, c as i32, i as f32 * 6.0, 12.0, 10.0);
+            }
+        }
+
+        let buf = fz_bidi_reorder_stext_page(0, page, BiDiDirection::LTR as i32);
+        let text = BUFFERS.get(buf).unwrap().lock().unwrap().data().to_vec();
+        assert_eq!(
+            String::from_utf8(text).unwrap(),
+            "ab cd-ef\n1 \u{05DD}\u{05D5}\u{05DC}\u{05E9}\n  \n"
+        );
+        BUFFERS.remove(buf);
+
+        let mut breaks = [0i32; 8];
+        let n = fz_find_stext_word_breaks(0, page, breaks.as_mut_ptr(), 8);
+        assert_eq!(&breaks[..n], [0, 3, 8, 10]);
+        let n = fz_find_stext_line_breaks(0, page, breaks.as_mut_ptr(), 8);
+        assert_eq!(&breaks[..n], [3, 6, 10, 15, 16]);
+        assert_eq!(
+            fz_find_stext_line_breaks(0, page, breaks.as_mut_ptr(), 2),
+            2
+        );
+
+        let mut scripts = [-1i32; 4];
+        assert_eq!(
+            fz_detect_stext_line_scripts(0, page, scripts.as_mut_ptr(), 4),
+            3
+        );
+        assert_eq!(
+            scripts[..3],
+            [
+                ScriptCategory::Latin as i32,
+                ScriptCategory::Hebrew as i32,
+                ScriptCategory::Common as i32
+            ]
+        );
+
+        fz_drop_stext_page(0, page);
+        assert_eq!(fz_bidi_reorder_stext_page(0, page, 0), 0);
+    }
+
     #[test]
     fn test_casefold() {
         let input = c"Hello WORLD";
@@ -681,6 +1100,77 @@ mod tests {
         assert_eq!(result, "hello world");
     }
 
+    #[test]
+    fn test_packed_string_batches() {
+        fn pack(strings: &[&[u8]]) -> (Vec<u8>, Vec<u32>) {
+            let mut offsets = vec![0];
+            for s in strings {
+                offsets.push(offsets.last().unwrap() + s.len() as u32);
+            }
+            (strings.concat(), offsets)
+        }
+        fn unpack(buf: Handle, offsets: &[u32]) -> Vec<String> {
+            let data = BUFFERS.get(buf).unwrap().lock().unwrap().data().to_vec();
+            BUFFERS.remove(buf);
+            offsets
+                .windows(2)
+                .map(|w| String::from_utf8(data[w[0] as usize..w[1] as usize].to_vec()).unwrap())
+                .collect()
+        }
+
+        let strings: [&[u8]; 5] = [
+            b"Plain ASCII",
+            "\u{FB01}nding \u{FB02}owers".as_bytes(),
+            b"",
+            "Caf\u{00C9} \u{0394}ELTA".as_bytes(),
+            b"bad \xFF",
+        ];
+        let (data, offsets) = pack(&strings);
+        let mut out = [0u32; 6];
+
+        let buf = fz_normalize_strings(0, data.as_ptr(), offsets.as_ptr(), 5, 1, out.as_mut_ptr());
+        assert_eq!(
+            unpack(buf, &out),
+            [
+                "Plain ASCII",
+                "finding flowers",
+                "",
+                "Caf\u{00C9} \u{0394}ELTA",
+                ""
+            ]
+        );
+
+        let buf = fz_casefold_strings(0, data.as_ptr(), offsets.as_ptr(), 5, out.as_mut_ptr());
+        assert_eq!(
+            unpack(buf, &out),
+            [
+                "plain ascii",
+                "\u{FB01}nding \u{FB02}owers",
+                "",
+                "caf\u{00E9} \u{03B4}elta",
+                ""
+            ]
+        );
+
+        // Each string matches the single-string call
+        let mut single = [0u8; 64];
+        let len = fz_casefold(
+            0,
+            c"Caf\u{00C9} \u{0394}ELTA".as_ptr(),
+            single.as_mut_ptr().cast(),
+            64,
+        );
+        assert_eq!(&single[..len], "caf\u{00E9} \u{03B4}elta".as_bytes());
+
+        let bad = [0u32, 4, 2];
+        assert_eq!(
+            fz_casefold_strings(0, data.as_ptr(), bad.as_ptr(), 2, out.as_mut_ptr()),
+            0
+        );
+        let buf = fz_normalize_strings(0, std::ptr::null(), [0].as_ptr(), 0, 0, out.as_mut_ptr());
+        assert_eq!((unpack(buf, &out[..1]).len(), out[0]), (0, 0));
+    }
+
     #[test]
     fn test_char_count() {
         let ascii = c"Hello";
@@ -2,10 +2,17 @@
 //!
 //! This module provides algorithms for detecting tables in PDF pages,
 //! extracting their structure, and converting them to various formats.
+//! `fz_detect_document_tables` runs detection over every page of a
+//! document concurrently and streams each table out as text.
 
-use std::ffi::{CString, c_char, c_int};
+use std::ffi::{CString, c_char, c_int, c_void};
 use std::sync::LazyLock;
 
+use crate::ffi::document::{fz_count_pages, fz_drop_page, fz_load_page};
+use crate::ffi::stext::{
+    STEXT_PAGES, StextSoA, fz_drop_stext_page, fz_new_stext_page_from_page, fz_segment_stext_page,
+};
+use crate::ffi::text_extract::{batch_threads, for_each_page_in_order};
 use crate::ffi::{Handle, HandleStore};
 use crate::fitz::geometry::Rect;
 
@@ -518,10 +525,205 @@ impl TableDetector {
     }
 }
 
+// ============================================================================
+// Structured Text Input
+// ============================================================================
+
+/// Export format: `Table::to_csv`
+pub const FZ_TABLE_FORMAT_CSV: i32 = 0;
+/// Export format: `Table::to_markdown`
+pub const FZ_TABLE_FORMAT_MARKDOWN: i32 = 1;
+/// Export format: `Table::to_html`
+pub const FZ_TABLE_FORMAT_HTML: i32 = 2;
+
+/// Receives one exported table
+///
+/// `table` counts the tables of `page` from 0. `data` holds `len` bytes of
+/// UTF-8 (not NUL terminated) and is only valid during the call. Return 0
+/// to continue, anything else to stop the detection.
+pub type FzTableCallback = Option<
+    unsafe extern "C" fn(
+        opaque: *mut c_void,
+        page: c_int,
+        table: c_int,
+        data: *const u8,
+        len: usize,
+    ) -> c_int,
+>;
+
+/// Split the text lines of an stext page into positioned cells
+///
+/// A cell ends at a run of two or more spaces or at a gap between
+/// neighbouring characters wider than half the font size; single spaces
+/// stay inside the cell text.
+pub fn stext_cells(soa: &StextSoA) -> Vec<(Rect, String)> {
+    let mut cells = Vec::new();
+    let flush = |cells: &mut Vec<(Rect, String)>, cell: &mut Option<(Rect, String)>| {
+        if let Some((rect, text)) = cell.take() {
+            cells.push((rect, text.trim_end().to_string()));
+        }
+    };
+
+    for l in soa.text_lines() {
+        let mut cell: Option<(Rect, String)> = None;
+        let mut spaces = 0;
+        let mut prev_right = f32::NEG_INFINITY;
+        for i in soa.line_chars(l) {
+            let (left, right) = (soa.ul.xs[i], soa.ur.xs[i]);
+            let gap = left - prev_right;
+            prev_right = right;
+            let Some(c) = char::from_u32(soa.codepoints[i]) else {
+                continue;
+            };
+            if c == ' ' {
+                spaces += 1;
+                continue;
+            }
+
+            if spaces >= 2 || gap > soa.sizes[i] * 0.5 {
+                flush(&mut cells, &mut cell);
+            }
+            let (top, bottom) = (soa.ul.ys[i], soa.ll.ys[i]);
+            match &mut cell {
+                Some((rect, text)) => {
+                    if spaces == 1 {
+                        text.push(' ');
+                    }
+                    text.push(c);
+                    rect.x0 = rect.x0.min(left);
+                    rect.y0 = rect.y0.min(top);
+                    rect.x1 = rect.x1.max(right);
+                    rect.y1 = rect.y1.max(bottom);
+                }
+                None => cell = Some((Rect::new(left, top, right, bottom), c.to_string())),
+            }
+            spaces = 0;
+        }
+        flush(&mut cells, &mut cell);
+    }
+    cells
+}
+
+/// Detect the tables of one document page, exported in `format`
+fn detect_page_tables(
+    ctx: Handle,
+    doc: Handle,
+    n: i32,
+    config: &TableDetectorConfig,
+    format: i32,
+) -> Vec<String> {
+    let page = fz_load_page(ctx, doc, n);
+    if page == 0 {
+        return Vec::new();
+    }
+    let stext = fz_new_stext_page_from_page(ctx, page, std::ptr::null());
+    fz_drop_page(ctx, page);
+    fz_segment_stext_page(ctx, stext);
+
+    let cells = match STEXT_PAGES.get(stext) {
+        Some(arc) => match arc.lock() {
+            Ok(mut p) => stext_cells(p.soa()),
+            Err(_) => Vec::new(),
+        },
+        None => Vec::new(),
+    };
+    fz_drop_stext_page(ctx, stext);
+
+    let mut detector = TableDetector::new(config.clone());
+    detector.detect_from_positions(&cells);
+    detector
+        .tables()
+        .iter()
+        .map(|t| match format {
+            FZ_TABLE_FORMAT_MARKDOWN => t.to_markdown(),
+            FZ_TABLE_FORMAT_HTML => t.to_html(),
+            _ => t.to_csv(),
+        })
+        .collect()
+}
+
 // ============================================================================
 // FFI Functions
 // ============================================================================
 
+/// Detect the tables on every page of a document in parallel
+///
+/// Pages are segmented and searched for tables on up to `threads` workers
+/// (0 for one per core). Each table is exported in `format` on its worker
+/// and passed to `callback` on the calling thread in page order; the
+/// table structures themselves are dropped as soon as they are exported.
+/// At most `max_in_flight` pages (0 for twice the thread count) are
+/// detected but not yet delivered at any time. `config` may be null for
+/// the default detector settings.
+///
+/// # Arguments
+/// * `format` - `FZ_TABLE_FORMAT_CSV`, `FZ_TABLE_FORMAT_MARKDOWN` or
+///   `FZ_TABLE_FORMAT_HTML`
+///
+/// # Returns
+/// Number of tables delivered, or -1 if the callback is null, the format
+/// is unknown or the document has no pages
+#[unsafe(no_mangle)]
+#[allow(clippy::too_many_arguments)]
+pub extern "C" fn fz_detect_document_tables(
+    ctx: Handle,
+    doc: Handle,
+    config: *const TableDetectorConfig,
+    format: i32,
+    threads: i32,
+    max_in_flight: i32,
+    callback: FzTableCallback,
+    opaque: *mut c_void,
+) -> i32 {
+    let Some(callback) = callback else {
+        return -1;
+    };
+    if !(FZ_TABLE_FORMAT_CSV..=FZ_TABLE_FORMAT_HTML).contains(&format) {
+        return -1;
+    }
+    let pages = fz_count_pages(ctx, doc);
+    if pages <= 0 {
+        return -1;
+    }
+    let pages = pages as usize;
+    let config = if config.is_null() {
+        TableDetectorConfig::default()
+    } else {
+        // SAFETY: the caller passes a valid config or null
+        unsafe { (*config).clone() }
+    };
+
+    let threads = batch_threads(threads, pages);
+    let window = if max_in_flight > 0 {
+        max_in_flight as usize
+    } else {
+        threads * 2
+    };
+
+    let mut delivered = 0;
+    for_each_page_in_order(
+        ctx,
+        pages,
+        threads,
+        window,
+        |worker_ctx, n| detect_page_tables(worker_ctx, doc, n, &config, format),
+        |n, tables| {
+            for (i, table) in tables.iter().enumerate() {
+                // SAFETY: the caller guarantees the callback and its opaque pointer
+                let status = unsafe {
+                    callback(opaque, n as c_int, i as c_int, table.as_ptr(), table.len())
+                };
+                delivered += 1;
+                if status != 0 {
+                    return false;
+                }
+            }
+            true
+        },
+    );
+    delivered
+}
+
 /// Create a new table detector
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_new_table_detector(
@@ -866,4 +1068,88 @@ mod tests {
 
         fz_drop_table_detector(0, handle);
     }
+
+    #[test]
+    fn test_stext_cells_split_columns() {
+        use crate::ffi::stext::{
+            fz_add_stext_block, fz_add_stext_char, fz_add_stext_line, fz_new_stext_page,
+        };
+
+        let page = fz_new_stext_page(0, 0.0, 0.0, 612.0, 792.0);
+        let block = fz_add_stext_block(0, page, 0.0, 0.0, 612.0, 792.0);
+        for (row, text) in ["NAME  QTY", "Apple  3", "Kiwi fruit  12"]
+            .iter()
+            .enumerate()
+        {
+            let y = 20.0 + row as f32 * 14.0;
+            let line = fz_add_stext_line(0, page, block, 0.0, y - 10.0, 612.0, y);
+            for (i, c) in text.chars().enumerate() {
+                fz_add_stext_char(0, page, block, line, c as i32, i as f32 * 6.0, y, 10.0);
+            }
+        }
+        let cells = {
+            let arc = STEXT_PAGES.get(page).unwrap();
+            let mut p = arc.lock().unwrap();
+            stext_cells(p.soa())
+        };
+        fz_drop_stext_page(0, page);
+
+        let texts: Vec<&str> = cells.iter().map(|(_, t)| t.as_str()).collect();
+        assert_eq!(texts, vec!["NAME", "QTY", "Apple", "3", "Kiwi fruit", "12"]);
+        assert_eq!(cells[1].0.x0, 36.0);
+        assert_eq!(cells[4].0.x1, 9.0 * 6.0 + 6.0);
+    }
+
+    unsafe extern "C" fn count_tables(
+        opaque: *mut c_void,
+        _page: c_int,
+        _table: c_int,
+        _data: *const u8,
+        _len: usize,
+    ) -> c_int {
+        unsafe { *(opaque as *mut usize) += 1 };
+        0
+    }
+
+    #[test]
+    fn test_detect_document_tables_args() {
+        use crate::ffi::DOCUMENTS;
+        use crate::ffi::document::Document;
+
+        let doc = DOCUMENTS.insert(Document::new(
+            b"%PDF-1.4\n/Type /Page\n/Type /Page\n%%EOF".to_vec(),
+        ));
+        let mut seen = 0usize;
+        let opaque = &mut seen as *mut usize as *mut c_void;
+
+        // Pages without text hold no tables
+        let delivered = fz_detect_document_tables(
+            0,
+            doc,
+            std::ptr::null(),
+            FZ_TABLE_FORMAT_MARKDOWN,
+            2,
+            1,
+            Some(count_tables),
+            opaque,
+        );
+        assert!(delivered <= 0);
+        assert_eq!(seen, 0);
+
+        let bad_format = fz_detect_document_tables(
+            0,
+            doc,
+            std::ptr::null(),
+            7,
+            0,
+            0,
+            Some(count_tables),
+            opaque,
+        );
+        assert_eq!(bad_format, -1);
+        let no_callback =
+            fz_detect_document_tables(0, doc, std::ptr::null(), 0, 0, 0, None, opaque);
+        assert_eq!(no_callback, -1);
+        DOCUMENTS.remove(doc);
+    }
 }
@@ -2,7 +2,9 @@
 //!
 //! Provides FFI bindings for text buffer and text span operations.
 
+use super::store::{StoreType, store_discard_matching, store_find_and_keep, store_owned_item};
 use super::{Handle, HandleStore, safe_helpers};
+use crate::fitz::font::Font;
 use crate::fitz::geometry::Matrix;
 use crate::fitz::text::Text;
 use std::sync::{Arc, LazyLock};
@@ -78,6 +80,9 @@ pub extern "C" fn fz_show_glyph(
 
 /// Show a string of text
 ///
+/// Glyphs and advances come from the shaping cache, so a label shown
+/// over and over is only encoded and measured once.
+///
 /// # Safety
 /// Caller must ensure string is a valid null-terminated C string.
 #[unsafe(no_mangle)]
@@ -93,13 +98,17 @@ pub extern "C" fn fz_show_string(
         Some(s) => s,
         None => return,
     };
+    // Shaped at unit size: the transform carries the font size
+    let Some(shaped) = shape_text(font, 1.0, 0, 0, s) else {
+        return;
+    };
 
     if let Some(t) = TEXTS.get(text) {
         if let Ok(mut guard) = t.lock() {
             // Get font from handle
             if let Some(f) = super::font::FONTS.get(font) {
                 if let Ok(font_guard) = f.lock() {
-                    let matrix = Matrix::new(
+                    let mut trm = Matrix::new(
                         transform.a,
                         transform.b,
                         transform.c,
@@ -111,15 +120,31 @@ pub extern "C" fn fz_show_string(
                     // Clone the font and wrap in Arc for the Text API
                     let font_arc = Arc::new(font_guard.clone());
 
-                    let _ = guard.show_string(
-                        font_arc,
-                        matrix,
-                        s,
-                        wmode != 0,
-                        0,                                      // bidi_level
-                        crate::fitz::text::BidiDirection::Ltr,  // markup_dir
-                        crate::fitz::text::TextLanguage::Unset, // language
-                    );
+                    for ((&glyph, &unicode), &advance) in shaped
+                        .glyphs
+                        .iter()
+                        .zip(&shaped.unicodes)
+                        .zip(&shaped.advances)
+                    {
+                        guard.show_glyph(
+                            Arc::clone(&font_arc),
+                            trm,
+                            glyph,
+                            unicode,
+                            wmode != 0,
+                            0,                                      // bidi_level
+                            crate::fitz::text::BidiDirection::Ltr,  // markup_dir
+                            crate::fitz::text::TextLanguage::Unset, // language
+                        );
+                        // Pre-translate by the advance, down for vertical text
+                        if wmode != 0 {
+                            trm.e -= advance * trm.c;
+                            trm.f -= advance * trm.d;
+                        } else {
+                            trm.e += advance * trm.a;
+                            trm.f += advance * trm.b;
+                        }
+                    }
                 }
             }
         }
@@ -330,6 +355,162 @@ pub extern "C" fn fz_text_walk(
     0
 }
 
+// ============================================================================
+// Shaping Cache
+// ============================================================================
+
+/// Glyphs of a string shaped in one font at one size
+#[derive(Debug, Default)]
+pub struct ShapedText {
+    /// Glyph IDs, one per character
+    pub glyphs: Vec<i32>,
+    /// Character each glyph shows
+    pub unicodes: Vec<i32>,
+    /// Advance of each glyph at the shaped size
+    pub advances: Vec<f32>,
+}
+
+impl ShapedText {
+    fn shape(font: &Font, size: f32, text: &str) -> Self {
+        let mut shaped = Self::default();
+        for ch in text.chars() {
+            let gid = font.encode_character(ch as u32);
+            shaped.glyphs.push(gid as i32);
+            shaped.unicodes.push(ch as i32);
+            shaped.advances.push(font.glyph_advance(gid) * size);
+        }
+        shaped
+    }
+
+    /// Total advance
+    pub fn width(&self) -> f32 {
+        self.advances.iter().sum()
+    }
+
+    fn size(&self) -> usize {
+        std::mem::size_of::<Self>() + self.glyphs.len() * 12
+    }
+}
+
+/// Shaped strings held by the store
+static SHAPED_TEXTS: LazyLock<HandleStore<Arc<ShapedText>>> = LazyLock::new(HandleStore::new);
+
+/// Key prefix for strings shaped in one font
+fn shaped_text_key_prefix(font: Handle) -> Vec<u8> {
+    let mut key = b"fz_shaped_text:".to_vec();
+    key.extend_from_slice(&font.to_le_bytes());
+    key
+}
+
+fn shaped_text_key(font: Handle, size: f32, script: i32, language: i32, text: &str) -> Vec<u8> {
+    let mut key = shaped_text_key_prefix(font);
+    key.extend_from_slice(&size.to_bits().to_le_bytes());
+    key.extend_from_slice(&script.to_le_bytes());
+    key.extend_from_slice(&language.to_le_bytes());
+    key.extend_from_slice(text.as_bytes());
+    key
+}
+
+fn keep_shaped_text(shaped: Handle) -> Handle {
+    if SHAPED_TEXTS.get(shaped).is_none() {
+        return 0;
+    }
+    SHAPED_TEXTS.keep(shaped)
+}
+
+fn release_shaped_text(shaped: Handle) {
+    SHAPED_TEXTS.release(shaped);
+}
+
+/// `text` shaped in `font` at `size`, from the store, shaping it on a miss
+///
+/// Runs are `StoreType::ShapedText` items keyed by (font, size, script,
+/// language, text), so generated documents that repeat the same headers
+/// and labels shape each once until the store evicts it.
+pub fn shape_text(
+    font: Handle,
+    size: f32,
+    script: i32,
+    language: i32,
+    text: &str,
+) -> Option<Arc<ShapedText>> {
+    let key = shaped_text_key(font, size, script, language, text);
+    let cached = store_find_and_keep(&key, keep_shaped_text);
+    if cached != 0 {
+        let shaped = SHAPED_TEXTS
+            .get(cached)
+            .and_then(|s| s.lock().ok().map(|g| Arc::clone(&g)));
+        SHAPED_TEXTS.release(cached);
+        if shaped.is_some() {
+            return shaped;
+        }
+    }
+
+    let font_arc = super::font::FONTS.get(font)?;
+    let shaped = Arc::new(ShapedText::shape(&font_arc.lock().ok()?, size, text));
+    let handle = SHAPED_TEXTS.insert(Arc::clone(&shaped));
+    store_owned_item(
+        StoreType::ShapedText,
+        handle,
+        shaped.size() + key.len(),
+        &key,
+        release_shaped_text,
+    );
+    Some(shaped)
+}
+
+/// Shape a string, through the shaping cache
+///
+/// Writes up to `max` glyph IDs and advances (either array may be null).
+///
+/// # Returns
+/// Number of glyphs in the shaped string, or -1 if the font or string is
+/// invalid
+///
+/// # Safety
+/// `text` must be a valid null-terminated C string; `glyphs` and
+/// `advances` must have room for `max` entries when not null.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_shape_text(
+    _ctx: Handle,
+    font: Handle,
+    size: f32,
+    script: i32,
+    language: i32,
+    text: *const std::ffi::c_char,
+    glyphs: *mut i32,
+    advances: *mut f32,
+    max: i32,
+) -> i32 {
+    let Some(s) = safe_helpers::c_str_to_str(text) else {
+        return -1;
+    };
+    let Some(shaped) = shape_text(font, size, script, language, s) else {
+        return -1;
+    };
+    let n = shaped.glyphs.len().min(max.max(0) as usize);
+    if !glyphs.is_null() {
+        unsafe { std::slice::from_raw_parts_mut(glyphs, n) }.copy_from_slice(&shaped.glyphs[..n]);
+    }
+    if !advances.is_null() {
+        unsafe { std::slice::from_raw_parts_mut(advances, n) }
+            .copy_from_slice(&shaped.advances[..n]);
+    }
+    shaped.glyphs.len() as i32
+}
+
+/// Drop the cached shaping of a font
+///
+/// Call after changing a font's encoding or widths. `fz_drop_font` does
+/// this automatically.
+///
+/// # Returns
+/// Number of shaped strings removed from the store
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_purge_shaped_text_cache(_ctx: Handle, font: Handle) -> i32 {
+    store_discard_matching(StoreType::ShapedText, &shaped_text_key_prefix(font)) as i32
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -436,4 +617,79 @@ mod tests {
         fz_drop_text(0, text_handle);
         super::super::font::FONTS.remove(font_handle);
     }
+
+    #[test]
+    fn test_shape_text_cached() {
+        let mut font = Font::new("ShapeTest");
+        let mut charmap = crate::fitz::font::CharMap::new();
+        charmap.add_mapping('A' as u32, 3);
+        charmap.add_mapping('B' as u32, 4);
+        font.set_charmap(charmap);
+        font.set_glyph_advance(3, 0.5);
+        font.set_glyph_advance(4, 0.75);
+        let font_handle = super::super::font::FONTS.insert(font);
+
+        let shaped = shape_text(font_handle, 10.0, 0, 0, "ABA").unwrap();
+        assert_eq!(shaped.glyphs, [3, 4, 3]);
+        assert_eq!(shaped.unicodes, ['A' as i32, 'B' as i32, 'A' as i32]);
+        assert_eq!(shaped.advances, [5.0, 7.5, 5.0]);
+        assert_eq!(shaped.width(), 17.5);
+        // The same label again comes from the store
+        let again = shape_text(font_handle, 10.0, 0, 0, "ABA").unwrap();
+        assert!(Arc::ptr_eq(&shaped, &again));
+        let other = shape_text(font_handle, 12.0, 0, 0, "ABA").unwrap();
+        assert!(!Arc::ptr_eq(&shaped, &other));
+        assert_eq!(other.advances[1], 9.0);
+
+        let mut glyphs = [0i32; 2];
+        let mut advances = [0f32; 2];
+        let n = fz_shape_text(
+            0,
+            font_handle,
+            10.0,
+            0,
+            0,
+            c"BAB".as_ptr(),
+            glyphs.as_mut_ptr(),
+            advances.as_mut_ptr(),
+            2,
+        );
+        assert_eq!(n, 3);
+        assert_eq!((glyphs, advances), ([4, 3], [7.5, 5.0]));
+        assert_eq!(
+            fz_shape_text(
+                0,
+                0,
+                10.0,
+                0,
+                0,
+                c"A".as_ptr(),
+                std::ptr::null_mut(),
+                std::ptr::null_mut(),
+                0
+            ),
+            -1
+        );
+
+        // Show the string, advancing by the shaped widths
+        let text_handle = fz_new_text(0);
+        let mut trm = super::super::geometry::fz_matrix::identity();
+        trm.a = 10.0;
+        trm.d = 10.0;
+        fz_show_string(0, text_handle, font_handle, trm, c"AB".as_ptr(), 0);
+        {
+            let text = TEXTS.get(text_handle).unwrap();
+            let text = text.lock().unwrap();
+            let xs: Vec<f32> = text
+                .spans()
+                .iter()
+                .flat_map(|span| span.items().iter().map(|item| item.x))
+                .collect();
+            assert_eq!(xs, [0.0, 5.0]);
+        }
+        fz_drop_text(0, text_handle);
+
+        super::super::font::fz_drop_font(0, font_handle);
+        assert_eq!(fz_purge_shaped_text_cache(0, font_handle), 0);
+    }
 }
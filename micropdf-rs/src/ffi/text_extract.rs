@@ -0,0 +1,363 @@
+//! Document text extraction - every page's structured text in one call
+//!
+//! Pages are loaded, turned into stext pages and serialised as plain text
+//! or JSON on worker threads with cloned contexts. Results are handed to a
+//! callback on the calling thread strictly in page order. Workers can run
+//! at most `max_in_flight` pages ahead of the last page delivered, so
+//! memory stays bounded on a 10,000-page corpus even when one early page
+//! is slow or the consumer falls behind.
+
+use std::collections::BTreeMap;
+use std::ffi::{CStr, c_void};
+use std::os::raw::{c_char, c_int};
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::{Condvar, Mutex, mpsc};
+
+use super::Handle;
+use super::context::{fz_clone_context, fz_drop_context};
+use super::document::{fz_count_pages, fz_drop_page, fz_load_page};
+use super::render_pool::FZ_RENDER_POOL_MAX_THREADS;
+use super::stext::{
+    StextOptions, fz_drop_stext_page, fz_new_stext_page_from_page, fz_print_stext_page_as_json,
+    fz_stext_page_as_text,
+};
+
+/// Output format: the text of each line, one line per row
+pub const FZ_TEXT_FORMAT_TEXT: i32 = 0;
+/// Output format: `fz_print_stext_page_as_json` blocks and lines
+pub const FZ_TEXT_FORMAT_JSON: i32 = 1;
+
+/// Receives one page of extracted text
+///
+/// `data` holds `len` bytes of UTF-8 (not NUL terminated) and is only
+/// valid during the call; it is null for a page that failed to load.
+/// Return 0 to continue, anything else to stop the extraction.
+pub type FzTextPageCallback = Option<
+    unsafe extern "C" fn(opaque: *mut c_void, page: c_int, data: *const u8, len: usize) -> c_int,
+>;
+
+/// Delivery progress shared between the workers and the calling thread
+struct Window {
+    /// Pages delivered so far; page `delivered` is the next one due
+    delivered: usize,
+    stopped: bool,
+}
+
+/// Worker count for a batch: `threads` if positive, else one per core,
+/// capped by the render pool limit and the page count
+pub(crate) fn batch_threads(threads: i32, pages: usize) -> usize {
+    if threads > 0 {
+        threads.min(FZ_RENDER_POOL_MAX_THREADS) as usize
+    } else {
+        std::thread::available_parallelism()
+            .map(|n| n.get())
+            .unwrap_or(1)
+            .min(FZ_RENDER_POOL_MAX_THREADS as usize)
+    }
+    .min(pages)
+    .max(1)
+}
+
+/// Run `work` on pages `0..pages` in parallel and hand each result to
+/// `deliver` on the calling thread, strictly in page order
+///
+/// Each of `threads` workers runs `work` with its own cloned context and
+/// may run at most `window` pages ahead of the last page delivered, so
+/// only that many results are ever held. `deliver` returns false to stop
+/// the batch early.
+pub(crate) fn for_each_page_in_order<T: Send>(
+    ctx: Handle,
+    pages: usize,
+    threads: usize,
+    window: usize,
+    work: impl Fn(Handle, i32) -> T + Sync,
+    mut deliver: impl FnMut(i32, T) -> bool,
+) {
+    let window = window.max(1);
+    let next = AtomicUsize::new(0);
+    let progress = Mutex::new(Window {
+        delivered: 0,
+        stopped: false,
+    });
+    let advanced = Condvar::new();
+    let (tx, rx) = mpsc::channel::<(usize, T)>();
+
+    std::thread::scope(|scope| {
+        for _ in 0..threads {
+            let tx = tx.clone();
+            let (next, progress, advanced, work) = (&next, &progress, &advanced, &work);
+            scope.spawn(move || {
+                let worker_ctx = fz_clone_context(ctx);
+                if worker_ctx == 0 {
+                    return;
+                }
+                loop {
+                    let n = next.fetch_add(1, Ordering::Relaxed);
+                    if n >= pages {
+                        break;
+                    }
+                    // Page `delivered` never waits, so the window always drains
+                    let Ok(mut w) = progress.lock() else { break };
+                    while !w.stopped && n >= w.delivered + window {
+                        w = match advanced.wait(w) {
+                            Ok(w) => w,
+                            Err(_) => return,
+                        };
+                    }
+                    if w.stopped {
+                        break;
+                    }
+                    drop(w);
+
+                    if tx.send((n, work(worker_ctx, n as i32))).is_err() {
+                        break;
+                    }
+                }
+                fz_drop_context(worker_ctx);
+            });
+        }
+        drop(tx);
+
+        // Reorder on the calling thread and deliver each page once it is due
+        let mut pending: BTreeMap<usize, T> = BTreeMap::new();
+        let mut due = 0;
+        'receive: for (n, result) in rx.iter() {
+            pending.insert(n, result);
+            while let Some(result) = pending.remove(&due) {
+                let more = deliver(due as i32, result);
+                due += 1;
+
+                if let Ok(mut w) = progress.lock() {
+                    w.delivered = due;
+                    w.stopped = !more;
+                }
+                advanced.notify_all();
+                if !more {
+                    break 'receive;
+                }
+            }
+        }
+        // Wake workers still waiting on a window that will never move
+        if let Ok(mut w) = progress.lock() {
+            w.stopped = true;
+        }
+        advanced.notify_all();
+    });
+}
+
+fn extract_page(
+    ctx: Handle,
+    doc: Handle,
+    n: i32,
+    format: i32,
+    options: &StextOptions,
+) -> Option<Vec<u8>> {
+    let page = fz_load_page(ctx, doc, n);
+    if page == 0 {
+        return None;
+    }
+    let stext = fz_new_stext_page_from_page(ctx, page, options);
+    fz_drop_page(ctx, page);
+    if stext == 0 {
+        return None;
+    }
+    let text: *const c_char = if format == FZ_TEXT_FORMAT_JSON {
+        fz_print_stext_page_as_json(ctx, 0, stext, 1.0)
+    } else {
+        fz_stext_page_as_text(ctx, stext)
+    };
+    // The output lives in this thread's scratch slot until the next call
+    let bytes = if text.is_null() {
+        Vec::new()
+    } else {
+        // SAFETY: non-null results are NUL-terminated strings
+        unsafe { CStr::from_ptr(text) }.to_bytes().to_vec()
+    };
+    fz_drop_stext_page(ctx, stext);
+    Some(bytes)
+}
+
+/// Extract the text of every page of a document in parallel
+///
+/// Pages are extracted on up to `threads` workers (0 for one per core) and
+/// passed to `callback` on the calling thread in page order, so the
+/// callback needs no locking. At most `max_in_flight` pages (0 for twice
+/// the thread count) are extracted but not yet delivered at any time.
+/// `options` may be null for the default stext options.
+///
+/// # Arguments
+/// * `format` - `FZ_TEXT_FORMAT_TEXT` or `FZ_TEXT_FORMAT_JSON`
+///
+/// # Returns
+/// Number of pages delivered with text, or -1 if the callback is null, the
+/// format is unknown or the document has no pages
+#[unsafe(no_mangle)]
+#[allow(clippy::too_many_arguments)]
+pub extern "C" fn fz_extract_document_text(
+    ctx: Handle,
+    doc: Handle,
+    format: i32,
+    options: *const StextOptions,
+    threads: i32,
+    max_in_flight: i32,
+    callback: FzTextPageCallback,
+    opaque: *mut c_void,
+) -> i32 {
+    let Some(callback) = callback else {
+        return -1;
+    };
+    if format != FZ_TEXT_FORMAT_TEXT && format != FZ_TEXT_FORMAT_JSON {
+        return -1;
+    }
+    let pages = fz_count_pages(ctx, doc);
+    if pages <= 0 {
+        return -1;
+    }
+    let pages = pages as usize;
+    let options = if options.is_null() {
+        StextOptions::default()
+    } else {
+        // SAFETY: the caller passes a valid options struct or null
+        unsafe { *options }
+    };
+
+    let threads = batch_threads(threads, pages);
+    let window = if max_in_flight > 0 {
+        max_in_flight as usize
+    } else {
+        threads * 2
+    };
+
+    let mut delivered = 0;
+    for_each_page_in_order(
+        ctx,
+        pages,
+        threads,
+        window,
+        |worker_ctx, n| extract_page(worker_ctx, doc, n, format, &options),
+        |n, text| {
+            let (data, len) = match &text {
+                Some(bytes) => (bytes.as_ptr(), bytes.len()),
+                None => (std::ptr::null(), 0),
+            };
+            // SAFETY: the caller guarantees the callback and its opaque pointer
+            let status = unsafe { callback(opaque, n as c_int, data, len) };
+            if text.is_some() {
+                delivered += 1;
+            }
+            status == 0
+        },
+    );
+    delivered
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::DOCUMENTS;
+    use crate::ffi::context::fz_new_context;
+    use crate::ffi::document::Document;
+
+    fn pages(count: usize) -> Handle {
+        let mut data = b"%PDF-1.4\n".to_vec();
+        for _ in 0..count {
+            data.extend_from_slice(b"/Type /Page\n");
+        }
+        data.extend_from_slice(b"%%EOF");
+        DOCUMENTS.insert(Document::new(data))
+    }
+
+    struct Seen {
+        pages: Vec<i32>,
+        stop_after: usize,
+    }
+
+    unsafe extern "C" fn record(
+        opaque: *mut c_void,
+        page: c_int,
+        data: *const u8,
+        _len: usize,
+    ) -> c_int {
+        let seen = unsafe { &mut *(opaque as *mut Seen) };
+        assert!(!data.is_null());
+        seen.pages.push(page);
+        (seen.pages.len() >= seen.stop_after) as c_int
+    }
+
+    #[test]
+    fn test_pages_arrive_in_order() {
+        let ctx = unsafe { fz_new_context(std::ptr::null(), std::ptr::null(), 1024 * 1024) };
+        let doc = pages(7);
+        let count = fz_count_pages(ctx, doc);
+        let mut seen = Seen {
+            pages: Vec::new(),
+            stop_after: usize::MAX,
+        };
+
+        let delivered = fz_extract_document_text(
+            ctx,
+            doc,
+            FZ_TEXT_FORMAT_JSON,
+            std::ptr::null(),
+            3,
+            1,
+            Some(record),
+            &mut seen as *mut Seen as *mut c_void,
+        );
+        assert_eq!(delivered, count);
+        assert_eq!(seen.pages, (0..count).collect::<Vec<_>>());
+    }
+
+    #[test]
+    fn test_callback_stops_extraction() {
+        let ctx = unsafe { fz_new_context(std::ptr::null(), std::ptr::null(), 1024 * 1024) };
+        let doc = pages(7);
+        if fz_count_pages(ctx, doc) < 3 {
+            return;
+        }
+        let mut seen = Seen {
+            pages: Vec::new(),
+            stop_after: 2,
+        };
+
+        let delivered = fz_extract_document_text(
+            ctx,
+            doc,
+            FZ_TEXT_FORMAT_TEXT,
+            std::ptr::null(),
+            2,
+            0,
+            Some(record),
+            &mut seen as *mut Seen as *mut c_void,
+        );
+        assert_eq!(delivered, 2);
+        assert_eq!(seen.pages, vec![0, 1]);
+
+        assert_eq!(
+            fz_extract_document_text(
+                ctx,
+                doc,
+                9,
+                std::ptr::null(),
+                0,
+                0,
+                Some(record),
+                std::ptr::null_mut()
+            ),
+            -1
+        );
+        assert_eq!(
+            fz_extract_document_text(
+                ctx,
+                doc,
+                0,
+                std::ptr::null(),
+                0,
+                0,
+                None,
+                std::ptr::null_mut()
+            ),
+            -1
+        );
+    }
+}
@@ -0,0 +1,335 @@
+//! Document thumbnails - one call renders every page small
+//!
+//! The thumbnail pipeline trades fidelity for throughput: pages render at
+//! reduced anti-aliasing, without annotations or widgets, straight into an
+//! opaque gray or RGB pixmap, and images decode at the reduced resolution
+//! the thumbnail matrix asks for. Pages are shared out to worker threads on
+//! cloned contexts, and the results come back either packed into one sprite
+//! sheet or as one small JPEG per page.
+
+use std::sync::Mutex;
+use std::sync::atomic::{AtomicUsize, Ordering};
+
+use super::colorspace::{FZ_COLORSPACE_GRAY, FZ_COLORSPACE_RGB};
+use super::context::{fz_clone_context, fz_drop_context};
+use super::document::{
+    fz_bound_page, fz_count_pages, fz_drop_page, fz_load_page, fz_new_pixmap_from_page_with_options,
+};
+use super::geometry::{fz_irect, fz_matrix};
+use super::pixmap::{Pixmap, fz_drop_pixmap};
+use super::render_pool::FZ_RENDER_POOL_MAX_THREADS;
+use super::write_pixmap::fz_new_buffer_from_pixmap_as_jpeg;
+use super::{Handle, PIXMAPS};
+
+/// Anti-aliasing bits used for thumbnails (4 levels)
+pub const FZ_THUMBNAIL_AA_BITS: i32 = 2;
+
+/// JPEG quality used when the caller passes 0
+pub const FZ_THUMBNAIL_DEFAULT_QUALITY: i32 = 75;
+
+/// Gray stays gray; everything else renders as RGB
+fn thumbnail_colorspace(cs: Handle) -> Handle {
+    if cs == FZ_COLORSPACE_GRAY {
+        FZ_COLORSPACE_GRAY
+    } else {
+        FZ_COLORSPACE_RGB
+    }
+}
+
+/// Uniform scale that fits the page bounds into a `max_size` square
+fn thumbnail_matrix(ctx: Handle, page: Handle, max_size: i32) -> fz_matrix {
+    let bounds = fz_bound_page(ctx, page);
+    let extent = (bounds.x1 - bounds.x0).max(bounds.y1 - bounds.y0);
+    let scale = if extent > 0.0 {
+        max_size as f32 / extent
+    } else {
+        1.0
+    };
+    fz_matrix {
+        a: scale,
+        b: 0.0,
+        c: 0.0,
+        d: scale,
+        e: 0.0,
+        f: 0.0,
+    }
+}
+
+fn render_thumbnail(
+    ctx: Handle,
+    doc: Handle,
+    page_number: i32,
+    max_size: i32,
+    cs: Handle,
+) -> Handle {
+    let page = fz_load_page(ctx, doc, page_number);
+    if page == 0 {
+        return 0;
+    }
+    let ctm = thumbnail_matrix(ctx, page, max_size);
+    let pix =
+        fz_new_pixmap_from_page_with_options(ctx, page, ctm, cs, 0, FZ_THUMBNAIL_AA_BITS, 0, 0);
+    fz_drop_page(ctx, page);
+    pix
+}
+
+/// Run `work` for every page on up to `threads` workers
+///
+/// Each worker pulls the next page number from a shared counter and runs
+/// on its own cloned context. Returns one result per page, in page order.
+fn for_each_page<T, F>(ctx: Handle, pages: usize, threads: i32, work: F) -> Vec<T>
+where
+    T: Default + Send,
+    F: Fn(Handle, i32) -> T + Sync,
+{
+    let threads = if threads > 0 {
+        threads.min(FZ_RENDER_POOL_MAX_THREADS) as usize
+    } else {
+        std::thread::available_parallelism()
+            .map(|n| n.get())
+            .unwrap_or(1)
+            .min(FZ_RENDER_POOL_MAX_THREADS as usize)
+    }
+    .min(pages)
+    .max(1);
+
+    let results: Mutex<Vec<T>> = Mutex::new((0..pages).map(|_| T::default()).collect());
+    let next = AtomicUsize::new(0);
+    std::thread::scope(|scope| {
+        for _ in 0..threads {
+            scope.spawn(|| {
+                let worker_ctx = fz_clone_context(ctx);
+                if worker_ctx == 0 {
+                    return;
+                }
+                loop {
+                    let n = next.fetch_add(1, Ordering::Relaxed);
+                    if n >= pages {
+                        break;
+                    }
+                    let value = work(worker_ctx, n as i32);
+                    if let Ok(mut results) = results.lock() {
+                        results[n] = value;
+                    }
+                }
+                fz_drop_context(worker_ctx);
+            });
+        }
+    });
+    results.into_inner().unwrap_or_default()
+}
+
+/// Render every page of a document into one sprite sheet
+///
+/// The sheet is a grid of `max_size` x `max_size` cells, `columns` wide
+/// (0 picks a near-square grid), on a white background. Page `i` sits in
+/// the top-left corner of cell `i`; when `rects` is non-null its first
+/// `count` entries receive each page's area within the sheet, with an empty
+/// rect for pages that failed to render. `cs` selects gray or RGB output
+/// (anything other than gray renders RGB) and `threads` works as for
+/// `fz_new_render_pool`.
+///
+/// # Returns
+/// Pixmap handle without alpha, or 0 if the document has no pages or
+/// `max_size` is not positive
+#[unsafe(no_mangle)]
+#[allow(clippy::too_many_arguments)]
+pub extern "C" fn fz_new_thumbnail_sheet(
+    ctx: Handle,
+    doc: Handle,
+    max_size: i32,
+    cs: Handle,
+    columns: i32,
+    threads: i32,
+    rects: *mut fz_irect,
+    count: i32,
+) -> Handle {
+    let pages = fz_count_pages(ctx, doc);
+    if pages <= 0 || max_size <= 0 {
+        return 0;
+    }
+    let cs = thumbnail_colorspace(cs);
+    let columns = if columns > 0 {
+        columns.min(pages)
+    } else {
+        (pages as f64).sqrt().ceil() as i32
+    };
+    let rows = (pages + columns - 1) / columns;
+    let (Some(width), Some(height)) = (columns.checked_mul(max_size), rows.checked_mul(max_size))
+    else {
+        return 0;
+    };
+
+    let sheet = PIXMAPS.insert(Pixmap::filled(cs, width, height, false, 255));
+    let Some(sheet_ref) = PIXMAPS.get(sheet) else {
+        return 0;
+    };
+    let placed: Vec<fz_irect> = for_each_page(ctx, pages as usize, threads, |wctx, n| {
+        let pix = render_thumbnail(wctx, doc, n, max_size, cs);
+        let mut area = fz_irect::default();
+        if let Some(thumb) = PIXMAPS.get(pix) {
+            if let (Ok(thumb), Ok(mut sheet)) = (thumb.lock(), sheet_ref.lock()) {
+                let x = (n % columns) * max_size;
+                let y = (n / columns) * max_size;
+                let w = thumb.w().min(max_size) as usize;
+                let h = thumb.h().min(max_size);
+                let row_bytes = w * thumb.n() as usize;
+                let src_stride = thumb.stride() as usize;
+                let dst_stride = sheet.stride() as usize;
+                let dst_x = x as usize * sheet.n() as usize;
+                let src = thumb.samples();
+                let dst = sheet.samples_mut();
+                for row in 0..h as usize {
+                    let s = row * src_stride;
+                    let d = (y as usize + row) * dst_stride + dst_x;
+                    dst[d..d + row_bytes].copy_from_slice(&src[s..s + row_bytes]);
+                }
+                area = fz_irect {
+                    x0: x,
+                    y0: y,
+                    x1: x + w as i32,
+                    y1: y + h,
+                };
+            }
+        }
+        if pix != 0 {
+            fz_drop_pixmap(wctx, pix);
+        }
+        area
+    });
+
+    if !rects.is_null() && count > 0 {
+        for (i, area) in placed.iter().take(count as usize).enumerate() {
+            // SAFETY: the caller provides `count` writable rects
+            unsafe { *rects.add(i) = *area };
+        }
+    }
+    sheet
+}
+
+/// Render every page of a document to its own small JPEG
+///
+/// Pages are scaled to fit a `max_size` square and encoded at `quality`
+/// (1-100, 0 for the default). When `buffers` is non-null its first
+/// `count` entries receive one buffer handle per page, 0 for pages that
+/// failed; the caller drops them. `cs` and `threads` work as for
+/// `fz_new_thumbnail_sheet`.
+///
+/// # Returns
+/// Number of pages encoded, or -1 if `max_size` is not positive or
+/// `buffers` is null
+#[unsafe(no_mangle)]
+#[allow(clippy::too_many_arguments)]
+pub extern "C" fn fz_new_thumbnail_jpegs(
+    ctx: Handle,
+    doc: Handle,
+    max_size: i32,
+    cs: Handle,
+    quality: i32,
+    threads: i32,
+    buffers: *mut Handle,
+    count: i32,
+) -> i32 {
+    if max_size <= 0 || buffers.is_null() {
+        return -1;
+    }
+    let pages = fz_count_pages(ctx, doc).min(count).max(0);
+    let cs = thumbnail_colorspace(cs);
+    let quality = if quality > 0 {
+        quality
+    } else {
+        FZ_THUMBNAIL_DEFAULT_QUALITY
+    };
+
+    let encoded: Vec<Handle> = for_each_page(ctx, pages as usize, threads, |wctx, n| {
+        let pix = render_thumbnail(wctx, doc, n, max_size, cs);
+        if pix == 0 {
+            return 0;
+        }
+        let buf = fz_new_buffer_from_pixmap_as_jpeg(wctx, pix, quality, 0);
+        fz_drop_pixmap(wctx, pix);
+        buf
+    });
+
+    for (i, &buf) in encoded.iter().enumerate() {
+        // SAFETY: the caller provides `count` writable handles
+        unsafe { *buffers.add(i) = buf };
+    }
+    encoded.iter().filter(|&&buf| buf != 0).count() as i32
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::DOCUMENTS;
+    use crate::ffi::buffer::{fz_buffer_len, fz_drop_buffer};
+    use crate::ffi::context::fz_new_context;
+    use crate::ffi::document::Document;
+    use crate::ffi::pixmap::{fz_pixmap_components, fz_pixmap_height, fz_pixmap_width};
+
+    fn three_pages() -> Handle {
+        DOCUMENTS.insert(Document::new(
+            b"%PDF-1.4\n/Type /Page\n/Type /Page\n/Type /Page\n%%EOF".to_vec(),
+        ))
+    }
+
+    #[test]
+    fn test_thumbnail_sheet_places_every_page() {
+        let ctx = unsafe { fz_new_context(std::ptr::null(), std::ptr::null(), 1024 * 1024) };
+        let doc = three_pages();
+        let pages = fz_count_pages(ctx, doc);
+        assert!(pages >= 1);
+
+        let mut rects = vec![fz_irect::default(); pages as usize];
+        let sheet = fz_new_thumbnail_sheet(
+            ctx,
+            doc,
+            64,
+            FZ_COLORSPACE_GRAY,
+            2,
+            2,
+            rects.as_mut_ptr(),
+            pages,
+        );
+        assert_ne!(sheet, 0);
+        assert_eq!(fz_pixmap_components(ctx, sheet), 1);
+        let columns = pages.min(2);
+        assert_eq!(fz_pixmap_width(ctx, sheet), columns * 64);
+        assert_eq!(fz_pixmap_height(ctx, sheet), (pages + 1) / 2 * 64);
+
+        for (i, r) in rects.iter().enumerate() {
+            let i = i as i32;
+            assert_eq!((r.x0, r.y0), ((i % 2) * 64, (i / 2) * 64));
+            // Letter pages fit on their long edge
+            assert_eq!(r.y1 - r.y0, 64);
+            assert!(r.x1 - r.x0 < 64 && r.x1 > r.x0);
+        }
+
+        fz_drop_pixmap(ctx, sheet);
+        assert_eq!(
+            fz_new_thumbnail_sheet(ctx, doc, 0, 0, 0, 0, std::ptr::null_mut(), 0),
+            0
+        );
+    }
+
+    #[test]
+    fn test_thumbnail_jpegs_one_buffer_per_page() {
+        let ctx = unsafe { fz_new_context(std::ptr::null(), std::ptr::null(), 1024 * 1024) };
+        let doc = three_pages();
+        let pages = fz_count_pages(ctx, doc);
+
+        let mut buffers = vec![0 as Handle; pages as usize];
+        let encoded = fz_new_thumbnail_jpegs(ctx, doc, 48, 0, 0, 0, buffers.as_mut_ptr(), pages);
+        assert_eq!(encoded, pages);
+        for &buf in &buffers {
+            assert_ne!(buf, 0);
+            assert!(fz_buffer_len(ctx, buf) > 0);
+            fz_drop_buffer(ctx, buf);
+        }
+
+        assert_eq!(
+            fz_new_thumbnail_jpegs(ctx, doc, 48, 0, 0, 0, std::ptr::null_mut(), 1),
+            -1
+        );
+    }
+}
@@ -3,9 +3,12 @@
 //! This module provides tile-based parallel rendering for PDF pages,
 //! enabling efficient use of multi-core processors for large documents.
 
-use std::ffi::c_int;
-use std::sync::LazyLock;
+use std::collections::VecDeque;
+use std::ffi::{c_int, c_void};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{Arc, LazyLock, Mutex};
 
+use crate::ffi::band_writer::SendPtr;
 use crate::ffi::{Handle, HandleStore, new_handle};
 use crate::fitz::geometry::{IRect, Rect};
 use crate::fitz::pixmap::Pixmap;
@@ -72,6 +75,8 @@ pub struct Tile {
     pub pixmap: Option<Pixmap>,
     /// Error message (if failed)
     pub error: Option<String>,
+    /// Scheduling priority; higher values render first
+    pub priority: i32,
 }
 
 impl Tile {
@@ -86,6 +91,7 @@ impl Tile {
             status: TileStatus::Pending,
             pixmap: None,
             error: None,
+            priority: 0,
         }
     }
 }
@@ -306,6 +312,110 @@ impl TileRenderer {
         Some(output)
     }
 
+    /// Set the scheduling priority of one tile
+    pub fn set_priority(&mut self, index: usize, priority: i32) -> bool {
+        match self.tiles.get_mut(index) {
+            Some(tile) => {
+                tile.priority = priority;
+                true
+            }
+            None => false,
+        }
+    }
+
+    /// Prioritise tiles for a viewport given in pixel coordinates
+    ///
+    /// Tiles overlapping the viewport get priority 2, tiles touching those
+    /// get 1 and all others 0, so visible content renders first and
+    /// scrolling into a neighbour finds it already drawn.
+    pub fn prioritize_viewport(&mut self, viewport: IRect) {
+        let visible: Vec<(u32, u32)> = self
+            .tiles
+            .iter()
+            .filter(|t| {
+                let r = t.pixel_rect;
+                r.x0 < viewport.x1 && viewport.x0 < r.x1 && r.y0 < viewport.y1 && viewport.y0 < r.y1
+            })
+            .map(|t| (t.row, t.col))
+            .collect();
+        for tile in &mut self.tiles {
+            tile.priority = if visible.contains(&(tile.row, tile.col)) {
+                2
+            } else if visible
+                .iter()
+                .any(|&(row, col)| tile.row.abs_diff(row) <= 1 && tile.col.abs_diff(col) <= 1)
+            {
+                1
+            } else {
+                0
+            };
+        }
+    }
+
+    /// Tile indices in render order: highest priority first, then grid order
+    pub fn schedule(&self) -> Vec<usize> {
+        let mut order: Vec<usize> = (0..self.tiles.len()).collect();
+        order.sort_by_key(|&i| std::cmp::Reverse(self.tiles[i].priority));
+        order
+    }
+
+    /// Whether any tile has a priority hint
+    pub fn has_priorities(&self) -> bool {
+        self.tiles
+            .iter()
+            .any(|t| t.priority != self.tiles[0].priority)
+    }
+
+    /// Reset every tile to pending before a new render pass
+    pub fn reset(&mut self) {
+        for tile in &mut self.tiles {
+            tile.status = TileStatus::Pending;
+            tile.pixmap = None;
+            tile.error = None;
+        }
+        self.completed = 0;
+        self.failed = 0;
+    }
+
+    /// Mark a tile as being rendered
+    pub fn start_tile(&mut self, index: usize) {
+        if let Some(tile) = self.tiles.get_mut(index) {
+            tile.status = TileStatus::InProgress;
+        }
+    }
+
+    /// Mark a tile as complete when its pixels went straight to a shared pixmap
+    pub fn finish_tile(&mut self, index: usize) {
+        if let Some(tile) = self.tiles.get_mut(index) {
+            if tile.status != TileStatus::Complete {
+                tile.status = TileStatus::Complete;
+                self.completed += 1;
+            }
+        }
+    }
+
+    /// Mark every tile that has not been rendered as cancelled
+    pub fn cancel_pending(&mut self) {
+        for tile in &mut self.tiles {
+            if matches!(tile.status, TileStatus::Pending | TileStatus::InProgress) {
+                tile.status = TileStatus::Cancelled;
+            }
+        }
+    }
+
+    /// Device transform mapping the page bounds to tile pixel coordinates
+    pub fn ctm(&self) -> crate::fitz::geometry::Matrix {
+        let s = self.config.scale;
+        crate::fitz::geometry::Matrix::new(
+            s,
+            0.0,
+            0.0,
+            s,
+            -self.page_bounds.x0 * s,
+            -self.page_bounds.y0 * s,
+        )
+    }
+
     /// Get configuration
     pub fn config(&self) -> &TileConfig {
         &self.config
@@ -332,31 +442,162 @@ pub struct RenderTask {
     renderer_handle: Handle,
     /// Current tile index being processed
     current_tile: Option<usize>,
-    /// Cancelled flag
-    cancelled: bool,
+    /// Cancelled flag, shared with the threads of a running render
+    cancelled: Arc<AtomicBool>,
+    /// Called as each tile (or the preview, as tile -1) lands in the output
+    callback: Option<TileCallback>,
+    /// Callback user data
+    callback_data: SendPtr,
+    /// Preview downscale factor (0 or 1 = no preview pass)
+    preview_factor: u32,
+    /// Output pixmap of the current or last render
+    output: Handle,
 }
 
+/// Tile completion callback: task handle, tile index (-1 for the preview)
+/// and user data. Called on a render thread.
+pub type TileCallback = extern "C" fn(task: Handle, tile: c_int, user_data: *mut c_void);
+
 impl RenderTask {
     /// Create a new render task
     pub fn new(renderer_handle: Handle) -> Self {
         Self {
             renderer_handle,
             current_tile: None,
-            cancelled: false,
+            cancelled: Arc::new(AtomicBool::new(false)),
+            callback: None,
+            callback_data: SendPtr::new(std::ptr::null_mut()),
+            preview_factor: 0,
+            output: 0,
         }
     }
 
     /// Cancel the rendering task
+    ///
+    /// A running render stops before starting any further tile.
     pub fn cancel(&mut self) {
-        self.cancelled = true;
+        self.cancelled.store(true, Ordering::Release);
     }
 
     /// Check if cancelled
     pub fn is_cancelled(&self) -> bool {
-        self.cancelled
+        self.cancelled.load(Ordering::Acquire)
     }
 }
 
+// ============================================================================
+// Work-Stealing Scheduler
+// ============================================================================
+
+/// Per-thread tile queues with stealing
+///
+/// Each thread starts with a contiguous run of tiles so neighbouring tiles
+/// (which tend to share content) stay on one core. A thread takes work from
+/// the front of its own queue and, once empty, steals from the back of the
+/// others, so a few expensive tiles do not leave the other cores idle.
+struct WorkQueues {
+    queues: Vec<Mutex<VecDeque<usize>>>,
+}
+
+impl WorkQueues {
+    fn new(tiles: &[usize], threads: usize) -> Self {
+        let threads = threads.max(1);
+        let chunk = tiles.len().div_ceil(threads).max(1);
+        let mut queues: Vec<Mutex<VecDeque<usize>>> = tiles
+            .chunks(chunk)
+            .map(|c| Mutex::new(c.iter().copied().collect()))
+            .collect();
+        queues.resize_with(threads, || Mutex::new(VecDeque::new()));
+        Self { queues }
+    }
+
+    /// Deal tiles out round-robin so every queue starts with the most
+    /// urgent work and the global order is roughly kept
+    fn interleaved(tiles: &[usize], threads: usize) -> Self {
+        let threads = threads.max(1);
+        let mut queues: Vec<VecDeque<usize>> = vec![VecDeque::new(); threads];
+        for (i, &tile) in tiles.iter().enumerate() {
+            queues[i % threads].push_back(tile);
+        }
+        Self {
+            queues: queues.into_iter().map(Mutex::new).collect(),
+        }
+    }
+
+    fn next(&self, me: usize) -> Option<usize> {
+        if let Some(index) = self.queues[me].lock().ok()?.pop_front() {
+            return Some(index);
+        }
+        let n = self.queues.len();
+        (1..n).find_map(|k| self.queues[(me + k) % n].lock().ok()?.pop_back())
+    }
+}
+
+/// Render one tile of `list` and copy it into the shared output pixmap
+fn render_tile(
+    ctx: Handle,
+    list: &crate::fitz::display_list::DisplayList,
+    ctm: &crate::fitz::geometry::Matrix,
+    cs: Handle,
+    alpha: bool,
+    rect: IRect,
+    output: &Mutex<super::pixmap::Pixmap>,
+) -> bool {
+    let bbox = super::geometry::fz_irect {
+        x0: rect.x0,
+        y0: rect.y0,
+        x1: rect.x1,
+        y1: rect.y1,
+    };
+    let pix =
+        super::pixmap::new_pixmap_with_bbox_filled(cs, bbox, alpha, if alpha { 0 } else { 255 });
+    let Some(tile_pix) = super::PIXMAPS.get(pix) else {
+        return false;
+    };
+
+    let fz_ctm = super::geometry::fz_matrix {
+        a: ctm.a,
+        b: ctm.b,
+        c: ctm.c,
+        d: ctm.d,
+        e: ctm.e,
+        f: ctm.f,
+    };
+    let dev = super::device::fz_new_draw_device(ctx, fz_ctm, pix);
+    if let Some(device) = super::device::DEVICES.get(dev) {
+        if let Ok(mut dev_guard) = device.lock() {
+            let scissor = Rect::new(
+                rect.x0 as f32,
+                rect.y0 as f32,
+                rect.x1 as f32,
+                rect.y1 as f32,
+            );
+            list.run(&mut **dev_guard, ctm, scissor);
+        }
+    }
+    super::device::fz_close_device(ctx, dev);
+    super::device::fz_drop_device(ctx, dev);
+
+    let copied = match (tile_pix.lock(), output.lock()) {
+        (Ok(src), Ok(mut dst)) => {
+            let n = src.n() as usize;
+            let row = src.w() as usize * n;
+            let (src_stride, dst_stride) = (src.stride() as usize, dst.stride() as usize);
+            let x = rect.x0 as usize * n;
+            let samples = dst.samples_mut();
+            for y in 0..src.h() as usize {
+                let d = (rect.y0 as usize + y) * dst_stride + x;
+                samples[d..d + row].copy_from_slice(&src.samples()[y * src_stride..][..row]);
+            }
+            true
+        }
+        _ => false,
+    };
+    drop(tile_pix);
+    super::pixmap::fz_drop_pixmap(ctx, pix);
+    copied
+}
+
 // ============================================================================
 // FFI Functions
 // ============================================================================
@@ -525,6 +766,315 @@ pub extern "C" fn fz_cancel_render_task(_ctx: Handle, task: Handle) {
     }
 }
 
+/// Draw the whole list at `1 / factor` resolution and scale it up into the
+/// output, so a viewer has something to show before the first tile lands
+fn render_preview(
+    ctx: Handle,
+    list: &crate::fitz::display_list::DisplayList,
+    ctm: &crate::fitz::geometry::Matrix,
+    cs: Handle,
+    alpha: bool,
+    factor: u32,
+    output: &Mutex<super::pixmap::Pixmap>,
+) {
+    let Ok((w, h)) = output.lock().map(|o| (o.w(), o.h())) else {
+        return;
+    };
+    let f = factor as i32;
+    let (pw, ph) = ((w + f - 1) / f, (h + f - 1) / f);
+    let inv = 1.0 / factor as f32;
+    let small_ctm = crate::fitz::geometry::Matrix::new(
+        ctm.a * inv,
+        ctm.b * inv,
+        ctm.c * inv,
+        ctm.d * inv,
+        ctm.e * inv,
+        ctm.f * inv,
+    );
+    let preview = Mutex::new(super::pixmap::Pixmap::new(cs, pw, ph, alpha));
+    if !render_tile(
+        ctx,
+        list,
+        &small_ctm,
+        cs,
+        alpha,
+        IRect::new(0, 0, pw, ph),
+        &preview,
+    ) {
+        return;
+    }
+
+    let (Ok(src), Ok(mut dst)) = (preview.lock(), output.lock()) else {
+        return;
+    };
+    let n = dst.n() as usize;
+    let (src_stride, dst_stride) = (src.stride() as usize, dst.stride() as usize);
+    let samples = dst.samples_mut();
+    for y in 0..h as usize {
+        let src_row = &src.samples()[(y / factor as usize) * src_stride..];
+        let dst_row = &mut samples[y * dst_stride..];
+        for x in 0..w as usize {
+            let s = (x / factor as usize) * n;
+            dst_row[x * n..x * n + n].copy_from_slice(&src_row[s..s + n]);
+        }
+    }
+}
+
+/// Render all tiles of a display list in parallel into one pixmap
+///
+/// Tiles of the task's renderer are spread over `threads` threads (0 = one
+/// per core) with work stealing; each tile replays the display list under
+/// its own scissor and is copied into the shared result as soon as it is
+/// drawn. Tile status and `fz_tile_renderer_progress` update live, and
+/// `fz_cancel_render_task` from another thread stops the render before the
+/// next tile on every thread. Blocks until the render finishes.
+///
+/// # Returns
+/// Pixmap handle covering the whole renderer area, or 0 if the task,
+/// renderer or list is invalid, or the task was cancelled
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_render_task_run(
+    ctx: Handle,
+    task: Handle,
+    list: Handle,
+    cs: Handle,
+    threads: c_int,
+) -> Handle {
+    let Some((renderer_handle, cancelled, callback, callback_data, preview_factor)) =
+        RENDER_TASKS.get(task).and_then(|t| {
+            t.lock().ok().map(|t| {
+                (
+                    t.renderer_handle,
+                    t.cancelled.clone(),
+                    t.callback,
+                    t.callback_data,
+                    t.preview_factor,
+                )
+            })
+        })
+    else {
+        return 0;
+    };
+    let notify = |tile: c_int| {
+        if let Some(cb) = callback {
+            cb(task, tile, callback_data.as_ptr());
+        }
+    };
+    let Some(renderer) = TILE_RENDERERS.get(renderer_handle) else {
+        return 0;
+    };
+    // Workers replay a private snapshot so they do not serialise on the
+    // list's lock
+    let Some(snapshot) = super::display_list::DISPLAY_LISTS
+        .get(list)
+        .and_then(|l| l.lock().ok().map(|guard| guard.clone()))
+    else {
+        return 0;
+    };
+
+    let cs = if cs == 0 {
+        super::colorspace::FZ_COLORSPACE_RGB
+    } else {
+        cs
+    };
+    let (tiles, order, prioritized, ctm, alpha, (width, height)) = match renderer.lock() {
+        Ok(mut r) => {
+            r.reset();
+            let tiles: Vec<(usize, IRect)> =
+                r.tiles.iter().map(|t| (t.index, t.pixel_rect)).collect();
+            let prioritized = r.has_priorities();
+            (
+                tiles,
+                r.schedule(),
+                prioritized,
+                r.ctm(),
+                r.config.alpha,
+                r.dimensions(),
+            )
+        }
+        Err(_) => return 0,
+    };
+
+    let out = super::PIXMAPS.insert(super::pixmap::Pixmap::new(
+        cs,
+        width as i32,
+        height as i32,
+        alpha,
+    ));
+    let Some(output_arc) = super::PIXMAPS.get(out) else {
+        return 0;
+    };
+    let output: &Mutex<super::pixmap::Pixmap> = &output_arc;
+    if let Some(t) = RENDER_TASKS.get(task) {
+        if let Ok(mut t) = t.lock() {
+            t.output = out;
+        }
+    }
+
+    if preview_factor > 1 && !cancelled.load(Ordering::Acquire) {
+        render_preview(ctx, &snapshot, &ctm, cs, alpha, preview_factor, output);
+        notify(-1);
+    }
+
+    let threads = match threads {
+        n if n > 0 => n as usize,
+        _ => std::thread::available_parallelism().map_or(1, |n| n.get()),
+    }
+    .min(tiles.len().max(1));
+    let queues = if prioritized {
+        WorkQueues::interleaved(&order, threads)
+    } else {
+        WorkQueues::new(&order, threads)
+    };
+
+    std::thread::scope(|scope| {
+        for me in 0..threads {
+            let (queues, tiles, snapshot, renderer, cancelled, notify) =
+                (&queues, &tiles, &snapshot, &renderer, &cancelled, &notify);
+            scope.spawn(move || {
+                while let Some(i) = queues.next(me) {
+                    if cancelled.load(Ordering::Acquire) {
+                        return;
+                    }
+                    let (index, rect) = tiles[i];
+                    if let Ok(mut r) = renderer.lock() {
+                        r.start_tile(index);
+                    }
+                    let ok = render_tile(ctx, snapshot, &ctm, cs, alpha, rect, output);
+                    if let Ok(mut r) = renderer.lock() {
+                        if ok {
+                            r.finish_tile(index);
+                        } else {
+                            r.fail_tile(index, "tile render failed".to_string());
+                        }
+                    }
+                    notify(index as c_int);
+                }
+            });
+        }
+    });
+
+    drop(output_arc);
+    if cancelled.load(Ordering::Acquire) {
+        if let Ok(mut r) = renderer.lock() {
+            r.cancel_pending();
+        }
+        if let Some(t) = RENDER_TASKS.get(task) {
+            if let Ok(mut t) = t.lock() {
+                t.output = 0;
+            }
+        }
+        super::pixmap::fz_drop_pixmap(ctx, out);
+        return 0;
+    }
+
+    out
+}
+
+/// Set the tile completion callback of a render task
+///
+/// The callback runs on a render thread after each tile has been copied
+/// into the output (see `fz_render_task_pixmap`), and once with tile -1
+/// after the preview pass.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_render_task_set_callback(
+    _ctx: Handle,
+    task: Handle,
+    callback: Option<TileCallback>,
+    user_data: *mut c_void,
+) {
+    if let Some(arc) = RENDER_TASKS.get(task) {
+        if let Ok(mut t) = arc.lock() {
+            t.callback = callback;
+            t.callback_data = SendPtr::new(user_data);
+        }
+    }
+}
+
+/// Enable a low-resolution preview pass
+///
+/// Before any tile, the whole page is drawn at `1 / factor` resolution and
+/// scaled into the output. 0 or 1 disables the preview.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_render_task_set_preview(_ctx: Handle, task: Handle, factor: c_int) {
+    if let Some(arc) = RENDER_TASKS.get(task) {
+        if let Ok(mut t) = arc.lock() {
+            t.preview_factor = factor.clamp(0, 64) as u32;
+        }
+    }
+}
+
+/// Get the output pixmap of a running (or the last) render
+///
+/// Lets a viewer show tiles as they arrive from the completion callback.
+/// Returns a new reference the caller must drop, or 0 if none.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_render_task_pixmap(_ctx: Handle, task: Handle) -> Handle {
+    let out = RENDER_TASKS
+        .get(task)
+        .and_then(|t| t.lock().ok().map(|t| t.output))
+        .unwrap_or(0);
+    if out == 0 || super::PIXMAPS.get(out).is_none() {
+        return 0;
+    }
+    super::PIXMAPS.keep(out)
+}
+
+/// Set the scheduling priority of a tile (higher renders first)
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_tile_renderer_set_priority(
+    _ctx: Handle,
+    renderer: Handle,
+    index: c_int,
+    priority: c_int,
+) -> c_int {
+    if index < 0 {
+        return 0;
+    }
+    if let Some(arc) = TILE_RENDERERS.get(renderer) {
+        if let Ok(mut r) = arc.lock() {
+            return i32::from(r.set_priority(index as usize, priority));
+        }
+    }
+    0
+}
+
+/// Get the scheduling priority of a tile
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_tile_renderer_get_priority(
+    _ctx: Handle,
+    renderer: Handle,
+    index: c_int,
+) -> c_int {
+    if let Some(arc) = TILE_RENDERERS.get(renderer) {
+        if let Ok(r) = arc.lock() {
+            if let Some(tile) = r.get_tile(index.max(0) as usize) {
+                return tile.priority;
+            }
+        }
+    }
+    0
+}
+
+/// Prioritise the tiles of a viewport (pixel coordinates)
+///
+/// Visible tiles render first, then their neighbours, then the rest.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_tile_renderer_prioritize_viewport(
+    _ctx: Handle,
+    renderer: Handle,
+    x0: c_int,
+    y0: c_int,
+    x1: c_int,
+    y1: c_int,
+) {
+    if let Some(arc) = TILE_RENDERERS.get(renderer) {
+        if let Ok(mut r) = arc.lock() {
+            r.prioritize_viewport(IRect::new(x0, y0, x1, y1));
+        }
+    }
+}
+
 /// Check if a render task is cancelled
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_render_task_is_cancelled(_ctx: Handle, task: Handle) -> c_int {
@@ -653,6 +1203,128 @@ mod tests {
         fz_drop_tile_renderer(0, renderer);
     }
 
+    fn test_list(w: f32, h: f32) -> Handle {
+        crate::ffi::display_list::DISPLAY_LISTS.insert(crate::fitz::display_list::DisplayList::new(
+            Rect::new(0.0, 0.0, w, h),
+        ))
+    }
+
+    #[test]
+    fn test_work_queues_steal() {
+        let order: Vec<usize> = (0..10).collect();
+        let queues = WorkQueues::new(&order, 3);
+
+        // Thread 2 drains its own run first, then steals from the back of others
+        let mine: Vec<usize> = std::iter::from_fn(|| queues.next(2)).take(3).collect();
+        assert_eq!(mine, vec![8, 9, 3]);
+
+        let mut rest: Vec<usize> = std::iter::from_fn(|| queues.next(0)).collect();
+        rest.sort_unstable();
+        assert_eq!(rest, vec![0, 1, 2, 4, 5, 6, 7]);
+        assert_eq!(queues.next(1), None);
+    }
+
+    #[test]
+    fn test_render_task_run() {
+        let renderer = fz_new_tile_renderer(0, 0.0, 0.0, 300.0, 200.0, 64, 64, 1.0, 0);
+        let task = fz_new_render_task(0, renderer);
+        let list = test_list(300.0, 200.0);
+
+        let pix = fz_render_task_run(0, task, list, 0, 4);
+        assert_ne!(pix, 0);
+        assert_eq!(crate::ffi::pixmap::fz_pixmap_width(0, pix), 300);
+        assert_eq!(crate::ffi::pixmap::fz_pixmap_height(0, pix), 200);
+        // Every tile was drawn: the white background covers the far corner
+        assert_eq!(
+            crate::ffi::pixmap::fz_get_pixmap_sample(0, pix, 299, 199, 0),
+            255
+        );
+        assert_eq!(fz_tile_renderer_is_complete(0, renderer), 1);
+        assert_eq!(fz_tile_renderer_progress(0, renderer), 1.0);
+
+        crate::ffi::pixmap::fz_drop_pixmap(0, pix);
+        crate::ffi::display_list::DISPLAY_LISTS.remove(list);
+        fz_drop_render_task(0, task);
+        fz_drop_tile_renderer(0, renderer);
+    }
+
+    #[test]
+    fn test_render_task_run_cancelled() {
+        let renderer = fz_new_tile_renderer(0, 0.0, 0.0, 300.0, 200.0, 64, 64, 1.0, 0);
+        let task = fz_new_render_task(0, renderer);
+        let list = test_list(300.0, 200.0);
+
+        fz_cancel_render_task(0, task);
+        assert_eq!(fz_render_task_run(0, task, list, 0, 2), 0);
+        assert_eq!(fz_tile_renderer_progress(0, renderer), 0.0);
+        if let Some(r) = TILE_RENDERERS.get(renderer) {
+            let r = r.lock().unwrap();
+            assert!(r.tiles.iter().all(|t| t.status == TileStatus::Cancelled));
+        }
+
+        crate::ffi::display_list::DISPLAY_LISTS.remove(list);
+        fz_drop_render_task(0, task);
+        fz_drop_tile_renderer(0, renderer);
+    }
+
+    #[test]
+    fn test_prioritize_viewport() {
+        let bounds = Rect::new(0.0, 0.0, 1024.0, 1024.0);
+        let mut renderer = TileRenderer::new(bounds, TileConfig::default());
+        assert!(!renderer.has_priorities());
+
+        // A viewport inside the bottom-right tile of a 4x4 grid
+        renderer.prioritize_viewport(IRect::new(800, 800, 900, 900));
+        assert!(renderer.has_priorities());
+        assert_eq!(renderer.get_tile(15).unwrap().priority, 2);
+        assert_eq!(renderer.get_tile(10).unwrap().priority, 1);
+        assert_eq!(renderer.get_tile(0).unwrap().priority, 0);
+
+        let order = renderer.schedule();
+        assert_eq!(order[0], 15);
+        assert_eq!(&order[1..4], &[10, 11, 14]);
+    }
+
+    static EVENTS: Mutex<Vec<(Handle, c_int)>> = Mutex::new(Vec::new());
+
+    extern "C" fn record_tile(task: Handle, tile: c_int, _user: *mut c_void) {
+        EVENTS.lock().unwrap().push((task, tile));
+    }
+
+    #[test]
+    fn test_render_task_callback_and_preview() {
+        let renderer = fz_new_tile_renderer(0, 0.0, 0.0, 256.0, 256.0, 128, 128, 1.0, 0);
+        fz_tile_renderer_prioritize_viewport(0, renderer, 200, 200, 256, 256);
+        assert_eq!(fz_tile_renderer_get_priority(0, renderer, 3), 2);
+        let task = fz_new_render_task(0, renderer);
+        let list = test_list(256.0, 256.0);
+
+        fz_render_task_set_callback(0, task, Some(record_tile), std::ptr::null_mut());
+        fz_render_task_set_preview(0, task, 4);
+        let pix = fz_render_task_run(0, task, list, 0, 1);
+        assert_ne!(pix, 0);
+
+        // Preview first, then the visible tile, then the rest
+        let events: Vec<c_int> = EVENTS
+            .lock()
+            .unwrap()
+            .iter()
+            .filter(|(t, _)| *t == task)
+            .map(|&(_, tile)| tile)
+            .collect();
+        assert_eq!(events[..2], [-1, 3]);
+        assert_eq!(events.len(), 5);
+
+        let live = fz_render_task_pixmap(0, task);
+        assert_eq!(live, pix);
+        crate::ffi::pixmap::fz_drop_pixmap(0, live);
+
+        crate::ffi::pixmap::fz_drop_pixmap(0, pix);
+        crate::ffi::display_list::DISPLAY_LISTS.remove(list);
+        fz_drop_render_task(0, task);
+        fz_drop_tile_renderer(0, renderer);
+    }
+
     #[test]
     fn test_scaled_tiles() {
         let bounds = Rect::new(0.0, 0.0, 100.0, 100.0);
@@ -0,0 +1,335 @@
+//! Tracing spans - where the time goes inside a render
+//!
+//! The main pipeline stages (open, xref, interpret, form XObjects, image
+//! decode, rasterize, encode, write) each open a span with `span`. Built
+//! without the `trace` feature a span is an empty struct and compiles away.
+//! With it, nothing is recorded until `fz_trace_enable`, and a span taken
+//! while tracing is off costs one relaxed load.
+//!
+//! Finished spans go into a ring buffer per thread, where the oldest are
+//! overwritten once it holds `fz_trace_set_capacity` events, so recording
+//! never takes a lock another thread is holding. They can be fetched as
+//! Chrome trace JSON (chrome://tracing, Perfetto) with
+//! `fz_trace_export_chrome`, or handed to a callback as each one ends, for
+//! instance to forward them to an OpenTelemetry exporter.
+
+use std::ffi::{CStr, c_char, c_void};
+
+use super::buffer::Buffer;
+use super::{BUFFERS, Handle};
+
+/// Span callback: stage name, start and duration in nanoseconds since the
+/// first span, recording thread and the span's argument (or `i64::MIN`)
+pub type TraceCallback = Option<
+    extern "C" fn(
+        user: *mut c_void,
+        name: *const c_char,
+        start_ns: u64,
+        dur_ns: u64,
+        thread: u64,
+        arg: i64,
+    ),
+>;
+
+/// Argument value of a span recorded without one
+const NO_ARG: i64 = i64::MIN;
+
+/// Default events kept per thread
+pub const FZ_TRACE_DEFAULT_CAPACITY: usize = 4096;
+
+#[cfg(feature = "trace")]
+mod imp {
+    use std::collections::VecDeque;
+    use std::ffi::CStr;
+    use std::sync::atomic::{AtomicBool, AtomicU64, AtomicUsize, Ordering};
+    use std::sync::{Arc, LazyLock, Mutex, RwLock};
+    use std::time::Instant;
+
+    use super::{FZ_TRACE_DEFAULT_CAPACITY, TraceCallback};
+
+    pub(super) static ENABLED: AtomicBool = AtomicBool::new(false);
+    pub(super) static CAPACITY: AtomicUsize = AtomicUsize::new(FZ_TRACE_DEFAULT_CAPACITY);
+    pub(super) static CALLBACK: RwLock<(TraceCallback, usize)> = RwLock::new((None, 0));
+
+    static EPOCH: LazyLock<Instant> = LazyLock::new(Instant::now);
+    static NEXT_THREAD: AtomicU64 = AtomicU64::new(1);
+    /// Every thread's ring, kept after the thread exits so its spans can
+    /// still be exported
+    pub(super) static RINGS: Mutex<Vec<Arc<Mutex<Ring>>>> = Mutex::new(Vec::new());
+
+    #[derive(Clone, Copy)]
+    pub(super) struct Event {
+        pub name: &'static CStr,
+        pub start_ns: u64,
+        pub dur_ns: u64,
+        pub arg: i64,
+    }
+
+    pub(super) struct Ring {
+        pub thread: u64,
+        pub events: VecDeque<Event>,
+    }
+
+    thread_local! {
+        static LOCAL: Arc<Mutex<Ring>> = {
+            let ring = Arc::new(Mutex::new(Ring {
+                thread: NEXT_THREAD.fetch_add(1, Ordering::Relaxed),
+                events: VecDeque::new(),
+            }));
+            RINGS.lock().unwrap().push(Arc::clone(&ring));
+            ring
+        };
+    }
+
+    pub(super) fn now_ns() -> u64 {
+        EPOCH.elapsed().as_nanos() as u64
+    }
+
+    /// Record a finished span on this thread and pass it to the callback
+    pub(super) fn record(event: Event) {
+        let cap = CAPACITY.load(Ordering::Relaxed);
+        let thread = LOCAL.try_with(|ring| {
+            // Only the exporter ever contends for this lock
+            let mut ring = ring.lock().unwrap();
+            while ring.events.len() >= cap.max(1) {
+                ring.events.pop_front();
+            }
+            if cap > 0 {
+                ring.events.push_back(event);
+            }
+            ring.thread
+        });
+        // Spans ending while the thread shuts down are dropped
+        let Ok(thread) = thread else {
+            return;
+        };
+        if let (Some(cb), user) = *CALLBACK.read().unwrap() {
+            cb(
+                user as *mut _,
+                event.name.as_ptr(),
+                event.start_ns,
+                event.dur_ns,
+                thread,
+                event.arg,
+            );
+        }
+    }
+}
+
+/// A pipeline stage in progress, recorded when dropped
+#[must_use = "a span measures until it is dropped"]
+pub(crate) struct Span {
+    #[cfg(feature = "trace")]
+    open: Option<(&'static CStr, u64, i64)>,
+}
+
+/// Open a span for stage `name`; hold it for the stage's duration
+#[inline(always)]
+pub(crate) fn span(name: &'static CStr) -> Span {
+    span_arg(name, NO_ARG)
+}
+
+/// Open a span carrying an argument, such as an object number
+#[inline(always)]
+#[allow(unused_variables)]
+pub(crate) fn span_arg(name: &'static CStr, arg: i64) -> Span {
+    #[cfg(feature = "trace")]
+    {
+        use std::sync::atomic::Ordering;
+        let open = imp::ENABLED
+            .load(Ordering::Relaxed)
+            .then(|| (name, imp::now_ns(), arg));
+        Span { open }
+    }
+    #[cfg(not(feature = "trace"))]
+    Span {}
+}
+
+#[cfg(feature = "trace")]
+impl Drop for Span {
+    fn drop(&mut self) {
+        if let Some((name, start_ns, arg)) = self.open.take() {
+            imp::record(imp::Event {
+                name,
+                start_ns,
+                dur_ns: imp::now_ns().saturating_sub(start_ns),
+                arg,
+            });
+        }
+    }
+}
+
+/// Render the recorded spans as a Chrome trace event file
+fn chrome_trace_json() -> String {
+    let mut out = String::from("{\"traceEvents\":[");
+    #[cfg(feature = "trace")]
+    {
+        use std::fmt::Write;
+        let pid = std::process::id();
+        let rings: Vec<_> = imp::RINGS.lock().unwrap().clone();
+        let mut first = true;
+        for ring in rings {
+            let ring = ring.lock().unwrap();
+            for e in &ring.events {
+                if !first {
+                    out.push(',');
+                }
+                first = false;
+                // Stage names are plain identifiers and need no escaping
+                let _ = write!(
+                    out,
+                    "{{\"name\":\"{}\",\"cat\":\"micropdf\",\"ph\":\"X\",\"ts\":{}.{:03},\"dur\":{}.{:03},\"pid\":{},\"tid\":{}",
+                    e.name.to_str().unwrap_or("?"),
+                    e.start_ns / 1000,
+                    e.start_ns % 1000,
+                    e.dur_ns / 1000,
+                    e.dur_ns % 1000,
+                    pid,
+                    ring.thread
+                );
+                if e.arg != NO_ARG {
+                    let _ = write!(out, ",\"args\":{{\"arg\":{}}}", e.arg);
+                }
+                out.push('}');
+            }
+        }
+    }
+    out.push_str("],\"displayTimeUnit\":\"ms\"}");
+    out
+}
+
+// ============================================================================
+// FFI Functions
+// ============================================================================
+
+/// Check whether the library was built with tracing (the `trace` feature)
+///
+/// Without it the other `fz_trace_*` functions do nothing and exports are
+/// empty.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_trace_available(_ctx: Handle) -> i32 {
+    i32::from(cfg!(feature = "trace"))
+}
+
+/// Start (nonzero) or stop (0) recording spans
+#[unsafe(no_mangle)]
+#[allow(unused_variables)]
+pub extern "C" fn fz_trace_enable(_ctx: Handle, enabled: i32) {
+    #[cfg(feature = "trace")]
+    imp::ENABLED.store(enabled != 0, std::sync::atomic::Ordering::Relaxed);
+}
+
+/// Check whether spans are being recorded
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_trace_is_enabled(_ctx: Handle) -> i32 {
+    #[cfg(feature = "trace")]
+    return i32::from(imp::ENABLED.load(std::sync::atomic::Ordering::Relaxed));
+    #[cfg(not(feature = "trace"))]
+    0
+}
+
+/// Set how many spans each thread keeps before overwriting its oldest
+///
+/// 0 keeps none, leaving only the callback. Takes effect as each thread
+/// records its next span.
+#[unsafe(no_mangle)]
+#[allow(unused_variables)]
+pub extern "C" fn fz_trace_set_capacity(_ctx: Handle, events_per_thread: usize) {
+    #[cfg(feature = "trace")]
+    imp::CAPACITY.store(events_per_thread, std::sync::atomic::Ordering::Relaxed);
+}
+
+/// Set a callback run on the recording thread as each span ends, or None
+///
+/// The callback must not call `fz_trace_set_callback` itself.
+#[unsafe(no_mangle)]
+#[allow(unused_variables)]
+pub extern "C" fn fz_trace_set_callback(_ctx: Handle, callback: TraceCallback, user: *mut c_void) {
+    #[cfg(feature = "trace")]
+    {
+        *imp::CALLBACK.write().unwrap() = (callback, user as usize);
+    }
+}
+
+/// Number of spans currently held across all threads
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_trace_event_count(_ctx: Handle) -> usize {
+    #[cfg(feature = "trace")]
+    return imp::RINGS
+        .lock()
+        .unwrap()
+        .iter()
+        .map(|r| r.lock().unwrap().events.len())
+        .sum();
+    #[cfg(not(feature = "trace"))]
+    0
+}
+
+/// Discard every recorded span
+///
+/// Rings of threads that have exited are released.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_trace_clear(_ctx: Handle) {
+    #[cfg(feature = "trace")]
+    {
+        let mut rings = imp::RINGS.lock().unwrap();
+        rings.retain(|r| std::sync::Arc::strong_count(r) > 1);
+        for ring in rings.iter() {
+            ring.lock().unwrap().events.clear();
+        }
+    }
+}
+
+/// Export the recorded spans as Chrome trace JSON
+///
+/// Each span is a complete ("X") event with microsecond timestamps; spans
+/// carrying an argument (such as an XObject's object number) have it under
+/// `args.arg`. Recording continues; use `fz_trace_clear` to start afresh.
+///
+/// # Returns
+/// Buffer handle holding the JSON (drop with `fz_drop_buffer`)
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_trace_export_chrome(_ctx: Handle) -> Handle {
+    BUFFERS.insert(Buffer::from_data(chrome_trace_json().as_bytes()))
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::ffi::buffer::fz_drop_buffer;
+
+    fn exported() -> String {
+        let buf = fz_trace_export_chrome(0);
+        let data = BUFFERS.get(buf).unwrap().lock().unwrap().data().to_vec();
+        fz_drop_buffer(0, buf);
+        String::from_utf8(data).unwrap()
+    }
+
+    #[test]
+    fn test_export_is_a_trace_file() {
+        let json = exported();
+        assert!(json.starts_with("{\"traceEvents\":["));
+        assert!(json.ends_with("],\"displayTimeUnit\":\"ms\"}"));
+        assert_eq!(fz_trace_available(0), i32::from(cfg!(feature = "trace")));
+    }
+
+    #[cfg(feature = "trace")]
+    #[test]
+    fn test_spans_record_when_enabled() {
+        {
+            let _s = span(c"test_off");
+        }
+        fz_trace_enable(0, 1);
+        {
+            let _outer = span(c"test_outer");
+            let _inner = span_arg(c"test_inner", 42);
+        }
+        fz_trace_enable(0, 0);
+
+        let json = exported();
+        assert!(!json.contains("\"test_off\""));
+        assert!(json.contains("\"name\":\"test_outer\""));
+        assert!(json.contains("\"name\":\"test_inner\""));
+        assert!(json.contains("\"args\":{\"arg\":42}"));
+    }
+}
@@ -1,7 +1,8 @@
 //! C FFI for structured content tree - MuPDF compatible
 //! Safe Rust implementation of fz_tree (for tagged PDF support)
 
-use super::{Handle, HandleStore};
+use super::buffer::Buffer;
+use super::{BUFFERS, Handle, HandleStore};
 use std::ffi::{CStr, c_char};
 use std::sync::LazyLock;
 
@@ -102,6 +103,57 @@ pub enum StructureType {
     Form = 62,
 }
 
+impl StructureType {
+    /// The standard structure type `name`, or `Unknown`
+    pub fn from_name(name: &str) -> Self {
+        match name {
+            "Document" => Self::Document,
+            "Part" => Self::Part,
+            "Art" => Self::Art,
+            "Sect" => Self::Sect,
+            "Div" => Self::Div,
+            "BlockQuote" => Self::BlockQuote,
+            "Caption" => Self::Caption,
+            "TOC" => Self::TOC,
+            "TOCI" => Self::TOCI,
+            "Index" => Self::Index,
+            "NonStruct" => Self::NonStruct,
+            "Private" => Self::Private,
+            "P" => Self::P,
+            "H" => Self::H,
+            "H1" => Self::H1,
+            "H2" => Self::H2,
+            "H3" => Self::H3,
+            "H4" => Self::H4,
+            "H5" => Self::H5,
+            "H6" => Self::H6,
+            "L" => Self::L,
+            "LI" => Self::LI,
+            "Lbl" => Self::Lbl,
+            "LBody" => Self::LBody,
+            "Table" => Self::Table,
+            "TR" => Self::TR,
+            "TH" => Self::TH,
+            "TD" => Self::TD,
+            "THead" => Self::THead,
+            "TBody" => Self::TBody,
+            "TFoot" => Self::TFoot,
+            "Span" => Self::Span,
+            "Quote" => Self::Quote,
+            "Note" => Self::Note,
+            "Reference" => Self::Reference,
+            "BibEntry" => Self::BibEntry,
+            "Code" => Self::Code,
+            "Link" => Self::Link,
+            "Annot" => Self::Annot,
+            "Figure" => Self::Figure,
+            "Formula" => Self::Formula,
+            "Form" => Self::Form,
+            _ => Self::Unknown,
+        }
+    }
+}
+
 /// Reading order for tree traversal
 #[repr(C)]
 #[derive(Debug, Clone, Copy, PartialEq, Eq)]
@@ -195,6 +247,24 @@ impl Default for StructureTree {
     }
 }
 
+/// One element of a structure tree extracted by `fz_extract_structure_tree`
+#[repr(C)]
+#[derive(Debug, Clone, Copy, Default, PartialEq)]
+pub struct FzStructureRecord {
+    /// Structure type, through the document's RoleMap
+    pub struct_type: i32,
+    /// Index of the parent record, or -1 for the root
+    pub parent: i32,
+    /// Page index of its content, or -1 if it has none
+    pub page: i32,
+    /// Bounds of its content on that page [x0, y0, x1, y1]
+    pub bbox: [f32; 4],
+    /// Byte offset of its text in the text after the records
+    pub text_offset: u32,
+    /// Byte length of its text, which holds its descendants' text
+    pub text_length: u32,
+}
+
 /// Global tree node storage
 pub static TREE_NODES: LazyLock<HandleStore<TreeNode>> = LazyLock::new(HandleStore::new);
 
@@ -661,6 +731,55 @@ fn collect_text_recursive(node: Handle, text: &mut String) {
     }
 }
 
+// ============================================================================
+// Bulk Extraction
+// ============================================================================
+
+/// Extract the structure tree of document `doc` in one call
+///
+/// The `/StructTreeRoot` is read once and its marked content resolved to
+/// text and bounds, page by page on up to `threads` threads (0 = one per
+/// core). The buffer holds `*count` `fz_structure_record`s in pre-order,
+/// each parent before its children with the root first, followed by the
+/// UTF-8 text their offsets index.
+///
+/// # Returns
+/// Buffer handle, or 0 if the document has no structure tree
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_extract_structure_tree(
+    _ctx: Handle,
+    doc: Handle,
+    threads: i32,
+    count: *mut i32,
+) -> Handle {
+    let threads = usize::try_from(threads).unwrap_or(0);
+    let Some((records, text)) = super::pdf_struct_tree::extract(doc, threads) else {
+        return 0;
+    };
+    let mut out = Vec::with_capacity(records.len() * size_of::<FzStructureRecord>() + text.len());
+    for r in &records {
+        let words = [
+            r.struct_type.to_ne_bytes(),
+            r.parent.to_ne_bytes(),
+            r.page.to_ne_bytes(),
+            r.bbox[0].to_ne_bytes(),
+            r.bbox[1].to_ne_bytes(),
+            r.bbox[2].to_ne_bytes(),
+            r.bbox[3].to_ne_bytes(),
+            r.text_offset.to_ne_bytes(),
+            r.text_length.to_ne_bytes(),
+        ];
+        out.extend(words.iter().flatten());
+    }
+    out.extend_from_slice(text.as_bytes());
+    if !count.is_null() {
+        unsafe {
+            *count = records.len() as i32;
+        }
+    }
+    BUFFERS.insert(Buffer::from_vec(out))
+}
+
 // ============================================================================
 // Reference Counting
 // ============================================================================
@@ -754,4 +873,33 @@ mod tests {
 
         fz_drop_structure_tree(0, tree);
     }
+
+    #[test]
+    fn test_extract_structure_tree() {
+        use crate::ffi::DOCUMENTS;
+        use crate::ffi::document::Document;
+        use crate::ffi::pdf_struct_tree::tests::tagged_pdf;
+
+        let doc = DOCUMENTS.insert(Document::new(tagged_pdf()));
+        let mut count = 0;
+        let buf = fz_extract_structure_tree(0, doc, 0, &mut count);
+        assert!(buf > 0);
+        assert_eq!(count, 5);
+        assert_eq!(size_of::<FzStructureRecord>(), 36);
+        let data = BUFFERS.get(buf).unwrap().lock().unwrap().data().to_vec();
+        let (records, text) = data.split_at(5 * 36);
+        assert_eq!(text, b"AB CD EF A chart");
+        // The heading, third in pre-order: H1 under the Document element
+        let word =
+            |i: usize| i32::from_ne_bytes(records[2 * 36 + i * 4..][..4].try_into().unwrap());
+        assert_eq!(
+            (word(0), word(1), word(2)),
+            (StructureType::H1 as i32, 1, 0)
+        );
+        assert_eq!((word(7), word(8)), (0, 2));
+        BUFFERS.remove(buf);
+        DOCUMENTS.remove(doc);
+
+        assert_eq!(fz_extract_structure_tree(0, 0, 0, std::ptr::null_mut()), 0);
+    }
 }
@@ -3,8 +3,10 @@
 //! Provides functions to save pixmaps as various image formats.
 
 use crate::ffi::buffer::Buffer;
+use crate::ffi::jpeg_encode;
 use crate::ffi::output::OUTPUTS;
 use crate::ffi::pixmap::Pixmap;
+use crate::ffi::png_encode::{self, FZ_PNG_EFFORT_DEFAULT};
 use crate::ffi::{BUFFERS, Handle, PIXMAPS};
 use std::ffi::{CStr, c_char};
 use std::fs::File;
@@ -100,6 +102,71 @@ pub extern "C" fn fz_new_buffer_from_pixmap_as_png(_ctx: Handle, pixmap: Handle)
     BUFFERS.insert(buffer)
 }
 
+/// Create a buffer containing the pixmap as PNG, choosing the effort
+///
+/// # Arguments
+/// * `effort` - 0 (stored, fastest) to 9 (smallest); 1 is the fast preset
+///   and 6 what `fz_new_buffer_from_pixmap_as_png` uses
+/// * `threads` - Threads compressing bands of rows, 0 for one per CPU;
+///   small images always encode on one
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_buffer_from_pixmap_as_png_with_options(
+    _ctx: Handle,
+    pixmap: Handle,
+    effort: i32,
+    threads: i32,
+) -> Handle {
+    let pix_arc = match PIXMAPS.get(pixmap) {
+        Some(p) => p,
+        None => return 0,
+    };
+    let pix = pix_arc.lock().unwrap();
+
+    let png_data = png_encode::encode(&pix, effort, threads);
+    if png_data.is_empty() {
+        return 0;
+    }
+
+    let buffer = Buffer::from_data(&png_data);
+    BUFFERS.insert(buffer)
+}
+
+/// Write a pixmap as PNG to an output stream, choosing the effort
+///
+/// `effort` and `threads` work as for
+/// `fz_new_buffer_from_pixmap_as_png_with_options`.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_write_pixmap_as_png_with_options(
+    _ctx: Handle,
+    out: Handle,
+    pixmap: Handle,
+    effort: i32,
+    threads: i32,
+) -> i32 {
+    let pix_arc = match PIXMAPS.get(pixmap) {
+        Some(p) => p,
+        None => return -1,
+    };
+    let pix = pix_arc.lock().unwrap();
+
+    let png_data = png_encode::encode(&pix, effort, threads);
+    if png_data.is_empty() {
+        return -1;
+    }
+
+    let out_arc = match OUTPUTS.get(out) {
+        Some(o) => o,
+        None => return -1,
+    };
+    let mut output = out_arc.lock().unwrap();
+
+    if output.write_data(&png_data).is_ok() {
+        0
+    } else {
+        -1
+    }
+}
+
 // ============================================================================
 // JPEG Functions
 // ============================================================================
@@ -201,6 +268,70 @@ pub extern "C" fn fz_new_buffer_from_pixmap_as_jpeg(
     BUFFERS.insert(buffer)
 }
 
+/// Create a buffer containing the pixmap as JPEG, choosing the threads
+///
+/// # Arguments
+/// * `quality` - 1 (smallest) to 100 (best), 0 for the default of 90
+/// * `threads` - Threads encoding restart strips of MCU rows, 0 for one per
+///   CPU; small images always encode on one
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_buffer_from_pixmap_as_jpeg_with_options(
+    _ctx: Handle,
+    pixmap: Handle,
+    quality: i32,
+    threads: i32,
+) -> Handle {
+    let pix_arc = match PIXMAPS.get(pixmap) {
+        Some(p) => p,
+        None => return 0,
+    };
+    let pix = pix_arc.lock().unwrap();
+
+    let jpeg_data = jpeg_encode::encode(&pix, quality, threads);
+    if jpeg_data.is_empty() {
+        return 0;
+    }
+
+    let buffer = Buffer::from_data(&jpeg_data);
+    BUFFERS.insert(buffer)
+}
+
+/// Write a pixmap as JPEG to an output stream, choosing the threads
+///
+/// `quality` and `threads` work as for
+/// `fz_new_buffer_from_pixmap_as_jpeg_with_options`.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_write_pixmap_as_jpeg_with_options(
+    _ctx: Handle,
+    out: Handle,
+    pixmap: Handle,
+    quality: i32,
+    threads: i32,
+) -> i32 {
+    let pix_arc = match PIXMAPS.get(pixmap) {
+        Some(p) => p,
+        None => return -1,
+    };
+    let pix = pix_arc.lock().unwrap();
+
+    let jpeg_data = jpeg_encode::encode(&pix, quality, threads);
+    if jpeg_data.is_empty() {
+        return -1;
+    }
+
+    let out_arc = match OUTPUTS.get(out) {
+        Some(o) => o,
+        None => return -1,
+    };
+    let mut output = out_arc.lock().unwrap();
+
+    if output.write_data(&jpeg_data).is_ok() {
+        0
+    } else {
+        -1
+    }
+}
+
 // ============================================================================
 // PNM/PPM/PGM Functions (Portable Any Map)
 // ============================================================================
@@ -755,27 +886,62 @@ pub extern "C" fn fz_write_ps_file_trailer(_ctx: Handle, out: Handle, pages: i32
 }
 
 // ============================================================================
-// Data URI Functions
+// QOI Functions (Quite OK Image)
 // ============================================================================
 
-/// Write a pixmap as a data URI (base64 encoded PNG)
+/// Save a pixmap as QOI to a file
 #[unsafe(no_mangle)]
-pub extern "C" fn fz_write_pixmap_as_data_uri(_ctx: Handle, out: Handle, pixmap: Handle) -> i32 {
+pub extern "C" fn fz_save_pixmap_as_qoi(
+    _ctx: Handle,
+    pixmap: Handle,
+    filename: *const c_char,
+) -> i32 {
+    if filename.is_null() {
+        return -1;
+    }
+
+    let filename_str = unsafe { CStr::from_ptr(filename) };
+    let filename_str = match filename_str.to_str() {
+        Ok(s) => s,
+        Err(_) => return -1,
+    };
+
     let pix_arc = match PIXMAPS.get(pixmap) {
         Some(p) => p,
         None => return -1,
     };
     let pix = pix_arc.lock().unwrap();
 
-    let png_data = encode_png(&pix);
-    if png_data.is_empty() {
+    let qoi_data = encode_qoi(&pix);
+    if qoi_data.is_empty() {
         return -1;
     }
 
-    // Encode as base64
-    let base64_encoded =
-        base64::Engine::encode(&base64::engine::general_purpose::STANDARD, &png_data);
-    let data_uri = format!("data:image/png;base64,{}", base64_encoded);
+    match File::create(filename_str) {
+        Ok(mut file) => {
+            if file.write_all(&qoi_data).is_ok() {
+                0
+            } else {
+                -1
+            }
+        }
+        Err(_) => -1,
+    }
+}
+
+/// Write a pixmap as QOI to an output stream
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_write_pixmap_as_qoi(_ctx: Handle, out: Handle, pixmap: Handle) -> i32 {
+    let pix_arc = match PIXMAPS.get(pixmap) {
+        Some(p) => p,
+        None => return -1,
+    };
+    let pix = pix_arc.lock().unwrap();
+
+    let qoi_data = encode_qoi(&pix);
+    if qoi_data.is_empty() {
+        return -1;
+    }
 
     let out_arc = match OUTPUTS.get(out) {
         Some(o) => o,
@@ -783,89 +949,292 @@ pub extern "C" fn fz_write_pixmap_as_data_uri(_ctx: Handle, out: Handle, pixmap:
     };
     let mut output = out_arc.lock().unwrap();
 
-    if output.write_data(data_uri.as_bytes()).is_ok() {
+    if output.write_data(&qoi_data).is_ok() {
         0
     } else {
         -1
     }
 }
 
+/// Create a buffer containing the pixmap as QOI
+///
+/// QOI encodes in one linear pass, close to the cost of a copy, and
+/// suits internal caches more than delivery. Gray pixmaps are written as
+/// RGB, gray with alpha as RGBA.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_buffer_from_pixmap_as_qoi(_ctx: Handle, pixmap: Handle) -> Handle {
+    let pix_arc = match PIXMAPS.get(pixmap) {
+        Some(p) => p,
+        None => return 0,
+    };
+    let pix = pix_arc.lock().unwrap();
+
+    let qoi_data = encode_qoi(&pix);
+    if qoi_data.is_empty() {
+        return 0;
+    }
+
+    let buffer = Buffer::from_data(&qoi_data);
+    BUFFERS.insert(buffer)
+}
+
 // ============================================================================
-// Internal Encoding Functions
+// WebP Functions
 // ============================================================================
 
-/// Encode pixmap as PNG using the image crate
-fn encode_png(pix: &Pixmap) -> Vec<u8> {
-    use image::codecs::png::PngEncoder;
-    use image::{ExtendedColorType, ImageEncoder};
+/// Save a pixmap as WebP to a file
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_save_pixmap_as_webp(
+    _ctx: Handle,
+    pixmap: Handle,
+    filename: *const c_char,
+) -> i32 {
+    if filename.is_null() {
+        return -1;
+    }
 
-    let width = pix.w() as u32;
-    let height = pix.h() as u32;
-    let n = pix.n();
-    let samples = pix.samples();
+    let filename_str = unsafe { CStr::from_ptr(filename) };
+    let filename_str = match filename_str.to_str() {
+        Ok(s) => s,
+        Err(_) => return -1,
+    };
 
-    let color_type = match (n, pix.has_alpha()) {
-        (1, false) => ExtendedColorType::L8,
-        (2, true) => ExtendedColorType::La8,
-        (3, false) => ExtendedColorType::Rgb8,
-        (4, true) => ExtendedColorType::Rgba8,
-        _ => return Vec::new(), // Unsupported format
+    let pix_arc = match PIXMAPS.get(pixmap) {
+        Some(p) => p,
+        None => return -1,
     };
+    let pix = pix_arc.lock().unwrap();
 
-    let mut buf = Vec::new();
-    let encoder = PngEncoder::new(&mut buf);
-    if encoder
-        .write_image(samples, width, height, color_type)
-        .is_ok()
-    {
-        buf
+    let webp_data = encode_webp(&pix);
+    if webp_data.is_empty() {
+        return -1;
+    }
+
+    match File::create(filename_str) {
+        Ok(mut file) => {
+            if file.write_all(&webp_data).is_ok() {
+                0
+            } else {
+                -1
+            }
+        }
+        Err(_) => -1,
+    }
+}
+
+/// Write a pixmap as WebP to an output stream
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_write_pixmap_as_webp(_ctx: Handle, out: Handle, pixmap: Handle) -> i32 {
+    let pix_arc = match PIXMAPS.get(pixmap) {
+        Some(p) => p,
+        None => return -1,
+    };
+    let pix = pix_arc.lock().unwrap();
+
+    let webp_data = encode_webp(&pix);
+    if webp_data.is_empty() {
+        return -1;
+    }
+
+    let out_arc = match OUTPUTS.get(out) {
+        Some(o) => o,
+        None => return -1,
+    };
+    let mut output = out_arc.lock().unwrap();
+
+    if output.write_data(&webp_data).is_ok() {
+        0
     } else {
-        Vec::new()
+        -1
     }
 }
 
-/// Encode pixmap as JPEG using the image crate
-fn encode_jpeg(pix: &Pixmap, quality: u8) -> Vec<u8> {
-    use image::codecs::jpeg::JpegEncoder;
-    use image::{ExtendedColorType, ImageEncoder};
+/// Create a buffer containing the pixmap as WebP
+///
+/// The image is lossless, which keeps text edges sharp at a fraction of
+/// the PNG size. Returns 0 unless built with the `webp` feature.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_buffer_from_pixmap_as_webp(_ctx: Handle, pixmap: Handle) -> Handle {
+    let pix_arc = match PIXMAPS.get(pixmap) {
+        Some(p) => p,
+        None => return 0,
+    };
+    let pix = pix_arc.lock().unwrap();
 
-    let width = pix.w() as u32;
-    let height = pix.h() as u32;
-    let n = pix.n();
-    let samples = pix.samples();
+    let webp_data = encode_webp(&pix);
+    if webp_data.is_empty() {
+        return 0;
+    }
 
-    // JPEG only supports L8 and Rgb8
-    let color_type = match n {
-        1 => ExtendedColorType::L8,
-        3 => ExtendedColorType::Rgb8,
-        4 => {
-            // Remove alpha channel for JPEG
-            let rgb_samples = remove_alpha(samples, 4);
-            let mut buf = Vec::new();
-            let encoder = JpegEncoder::new_with_quality(&mut buf, quality);
-            if encoder
-                .write_image(&rgb_samples, width, height, ExtendedColorType::Rgb8)
-                .is_ok()
-            {
-                return buf;
+    let buffer = Buffer::from_data(&webp_data);
+    BUFFERS.insert(buffer)
+}
+
+// ============================================================================
+// AVIF Functions
+// ============================================================================
+
+/// AVIF quality used when the caller passes 0
+pub const FZ_AVIF_DEFAULT_QUALITY: i32 = 70;
+
+/// AVIF speed preset used when the caller passes 0
+pub const FZ_AVIF_DEFAULT_SPEED: i32 = 8;
+
+/// Save a pixmap as AVIF to a file
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_save_pixmap_as_avif(
+    _ctx: Handle,
+    pixmap: Handle,
+    filename: *const c_char,
+    quality: i32,
+    speed: i32,
+) -> i32 {
+    if filename.is_null() {
+        return -1;
+    }
+
+    let filename_str = unsafe { CStr::from_ptr(filename) };
+    let filename_str = match filename_str.to_str() {
+        Ok(s) => s,
+        Err(_) => return -1,
+    };
+
+    let pix_arc = match PIXMAPS.get(pixmap) {
+        Some(p) => p,
+        None => return -1,
+    };
+    let pix = pix_arc.lock().unwrap();
+
+    let avif_data = encode_avif(&pix, quality, speed);
+    if avif_data.is_empty() {
+        return -1;
+    }
+
+    match File::create(filename_str) {
+        Ok(mut file) => {
+            if file.write_all(&avif_data).is_ok() {
+                0
+            } else {
+                -1
             }
-            return Vec::new();
         }
-        _ => return Vec::new(),
+        Err(_) => -1,
+    }
+}
+
+/// Write a pixmap as AVIF to an output stream
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_write_pixmap_as_avif(
+    _ctx: Handle,
+    out: Handle,
+    pixmap: Handle,
+    quality: i32,
+    speed: i32,
+) -> i32 {
+    let pix_arc = match PIXMAPS.get(pixmap) {
+        Some(p) => p,
+        None => return -1,
     };
+    let pix = pix_arc.lock().unwrap();
 
-    let mut buf = Vec::new();
-    let encoder = JpegEncoder::new_with_quality(&mut buf, quality);
-    if encoder
-        .write_image(samples, width, height, color_type)
-        .is_ok()
-    {
-        buf
+    let avif_data = encode_avif(&pix, quality, speed);
+    if avif_data.is_empty() {
+        return -1;
+    }
+
+    let out_arc = match OUTPUTS.get(out) {
+        Some(o) => o,
+        None => return -1,
+    };
+    let mut output = out_arc.lock().unwrap();
+
+    if output.write_data(&avif_data).is_ok() {
+        0
     } else {
-        Vec::new()
+        -1
+    }
+}
+
+/// Create a buffer containing the pixmap as AVIF
+///
+/// # Arguments
+/// * `quality` - 1-100, 0 for `FZ_AVIF_DEFAULT_QUALITY`
+/// * `speed` - Encoder speed preset from 1 (slowest, smallest) to 10
+///   (fastest), 0 for `FZ_AVIF_DEFAULT_SPEED`
+///
+/// Returns 0 unless built with the `avif` feature.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_buffer_from_pixmap_as_avif(
+    _ctx: Handle,
+    pixmap: Handle,
+    quality: i32,
+    speed: i32,
+) -> Handle {
+    let pix_arc = match PIXMAPS.get(pixmap) {
+        Some(p) => p,
+        None => return 0,
+    };
+    let pix = pix_arc.lock().unwrap();
+
+    let avif_data = encode_avif(&pix, quality, speed);
+    if avif_data.is_empty() {
+        return 0;
+    }
+
+    let buffer = Buffer::from_data(&avif_data);
+    BUFFERS.insert(buffer)
+}
+
+// ============================================================================
+// Data URI Functions
+// ============================================================================
+
+/// Write a pixmap as a data URI (base64 encoded PNG)
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_write_pixmap_as_data_uri(_ctx: Handle, out: Handle, pixmap: Handle) -> i32 {
+    let pix_arc = match PIXMAPS.get(pixmap) {
+        Some(p) => p,
+        None => return -1,
+    };
+    let pix = pix_arc.lock().unwrap();
+
+    let png_data = encode_png(&pix);
+    if png_data.is_empty() {
+        return -1;
+    }
+
+    // Encode as base64
+    let base64_encoded =
+        base64::Engine::encode(&base64::engine::general_purpose::STANDARD, &png_data);
+    let data_uri = format!("data:image/png;base64,{}", base64_encoded);
+
+    let out_arc = match OUTPUTS.get(out) {
+        Some(o) => o,
+        None => return -1,
+    };
+    let mut output = out_arc.lock().unwrap();
+
+    if output.write_data(data_uri.as_bytes()).is_ok() {
+        0
+    } else {
+        -1
     }
 }
 
+// ============================================================================
+// Internal Encoding Functions
+// ============================================================================
+
+/// Encode pixmap as PNG at the default effort on the calling thread
+fn encode_png(pix: &Pixmap) -> Vec<u8> {
+    png_encode::encode(pix, FZ_PNG_EFFORT_DEFAULT, 1)
+}
+
+/// Encode pixmap as JPEG on the calling thread
+fn encode_jpeg(pix: &Pixmap, quality: u8) -> Vec<u8> {
+    jpeg_encode::encode(pix, quality as i32, 1)
+}
+
 /// Encode pixmap as PNM (PPM for RGB, PGM for grayscale)
 fn encode_pnm(pix: &Pixmap) -> Vec<u8> {
     let width = pix.w();
@@ -1098,6 +1467,208 @@ fn encode_ps(pix: &Pixmap) -> Vec<u8> {
     buf
 }
 
+/// Encode pixmap as QOI
+fn encode_qoi(pix: &Pixmap) -> Vec<u8> {
+    const OP_INDEX: u8 = 0x00;
+    const OP_DIFF: u8 = 0x40;
+    const OP_LUMA: u8 = 0x80;
+    const OP_RUN: u8 = 0xC0;
+    const OP_RGB: u8 = 0xFE;
+    const OP_RGBA: u8 = 0xFF;
+    const MAX_RUN: u8 = 62;
+
+    let n = pix.n() as usize;
+    let channels: u8 = match (n, pix.has_alpha()) {
+        (1, false) | (3, false) => 3,
+        (2, true) | (4, true) => 4,
+        _ => return Vec::new(),
+    };
+    let (width, height) = (pix.w().max(0) as usize, pix.h().max(0) as usize);
+    let stride = pix.stride() as usize;
+    let samples = pix.samples();
+    if width == 0 || height == 0 || samples.len() < (height - 1) * stride + width * n {
+        return Vec::new();
+    }
+
+    let mut out = Vec::with_capacity(14 + width * height * (channels as usize + 1) + 8);
+    out.extend_from_slice(b"qoif");
+    out.extend_from_slice(&(width as u32).to_be_bytes());
+    out.extend_from_slice(&(height as u32).to_be_bytes());
+    out.push(channels);
+    out.push(0); // sRGB with linear alpha
+
+    let mut index = [[0u8; 4]; 64];
+    let mut prev = [0u8, 0, 0, 255];
+    let mut run = 0u8;
+    for y in 0..height {
+        let row = &samples[y * stride..y * stride + width * n];
+        for p in row.chunks_exact(n) {
+            let px = match n {
+                1 => [p[0], p[0], p[0], 255],
+                2 => [p[0], p[0], p[0], p[1]],
+                3 => [p[0], p[1], p[2], 255],
+                _ => [p[0], p[1], p[2], p[3]],
+            };
+            if px == prev {
+                run += 1;
+                if run == MAX_RUN {
+                    out.push(OP_RUN | (run - 1));
+                    run = 0;
+                }
+                continue;
+            }
+            if run > 0 {
+                out.push(OP_RUN | (run - 1));
+                run = 0;
+            }
+
+            let hash = (px[0] as usize * 3
+                + px[1] as usize * 5
+                + px[2] as usize * 7
+                + px[3] as usize * 11)
+                % 64;
+            if index[hash] == px {
+                out.push(OP_INDEX | hash as u8);
+            } else {
+                index[hash] = px;
+                if px[3] == prev[3] {
+                    let vr = px[0].wrapping_sub(prev[0]) as i8;
+                    let vg = px[1].wrapping_sub(prev[1]) as i8;
+                    let vb = px[2].wrapping_sub(prev[2]) as i8;
+                    let vg_r = vr.wrapping_sub(vg);
+                    let vg_b = vb.wrapping_sub(vg);
+                    if (-2..2).contains(&vr) && (-2..2).contains(&vg) && (-2..2).contains(&vb) {
+                        out.push(
+                            OP_DIFF
+                                | ((vr + 2) as u8) << 4
+                                | ((vg + 2) as u8) << 2
+                                | (vb + 2) as u8,
+                        );
+                    } else if (-8..8).contains(&vg_r)
+                        && (-32..32).contains(&vg)
+                        && (-8..8).contains(&vg_b)
+                    {
+                        out.push(OP_LUMA | (vg + 32) as u8);
+                        out.push(((vg_r + 8) as u8) << 4 | (vg_b + 8) as u8);
+                    } else {
+                        out.extend_from_slice(&[OP_RGB, px[0], px[1], px[2]]);
+                    }
+                } else {
+                    out.extend_from_slice(&[OP_RGBA, px[0], px[1], px[2], px[3]]);
+                }
+            }
+            prev = px;
+        }
+    }
+    if run > 0 {
+        out.push(OP_RUN | (run - 1));
+    }
+    out.extend_from_slice(&[0, 0, 0, 0, 0, 0, 0, 1]);
+    out
+}
+
+/// Pixmap samples in a layout the image crate encoders accept
+#[cfg(any(feature = "webp", feature = "avif"))]
+fn image_samples(pix: &Pixmap) -> Option<(Vec<u8>, image::ExtendedColorType)> {
+    use image::ExtendedColorType;
+
+    let row_len = pix.w().max(0) as usize * pix.n() as usize;
+    let samples: Vec<u8> = pix
+        .samples()
+        .chunks(pix.stride().max(1) as usize)
+        .take(pix.h().max(0) as usize)
+        .flat_map(|row| &row[..row_len.min(row.len())])
+        .copied()
+        .collect();
+    let color_type = match (pix.n(), pix.has_alpha()) {
+        (1, false) => ExtendedColorType::L8,
+        (2, true) => ExtendedColorType::La8,
+        (3, false) => ExtendedColorType::Rgb8,
+        (4, true) => ExtendedColorType::Rgba8,
+        _ => return None,
+    };
+    Some((samples, color_type))
+}
+
+/// Encode pixmap as lossless WebP using the image crate
+#[cfg(feature = "webp")]
+fn encode_webp(pix: &Pixmap) -> Vec<u8> {
+    use image::ImageEncoder;
+    use image::codecs::webp::WebPEncoder;
+
+    let Some((samples, color_type)) = image_samples(pix) else {
+        return Vec::new();
+    };
+    let mut buf = Vec::new();
+    let encoder = WebPEncoder::new_lossless(&mut buf);
+    if encoder
+        .write_image(&samples, pix.w() as u32, pix.h() as u32, color_type)
+        .is_ok()
+    {
+        buf
+    } else {
+        Vec::new()
+    }
+}
+
+#[cfg(not(feature = "webp"))]
+fn encode_webp(_pix: &Pixmap) -> Vec<u8> {
+    Vec::new()
+}
+
+/// Encode pixmap as AVIF using the image crate
+///
+/// Gray pixmaps are widened to RGB first.
+#[cfg(feature = "avif")]
+fn encode_avif(pix: &Pixmap, quality: i32, speed: i32) -> Vec<u8> {
+    use image::codecs::avif::AvifEncoder;
+    use image::{ExtendedColorType, ImageEncoder};
+
+    let Some((samples, color_type)) = image_samples(pix) else {
+        return Vec::new();
+    };
+    let (samples, color_type) = match color_type {
+        ExtendedColorType::L8 => (
+            samples.iter().flat_map(|&g| [g, g, g]).collect(),
+            ExtendedColorType::Rgb8,
+        ),
+        ExtendedColorType::La8 => (
+            samples
+                .chunks_exact(2)
+                .flat_map(|p| [p[0], p[0], p[0], p[1]])
+                .collect(),
+            ExtendedColorType::Rgba8,
+        ),
+        _ => (samples, color_type),
+    };
+    let quality = if quality > 0 {
+        quality.min(100)
+    } else {
+        FZ_AVIF_DEFAULT_QUALITY
+    };
+    let speed = if speed > 0 {
+        speed.min(10)
+    } else {
+        FZ_AVIF_DEFAULT_SPEED
+    };
+
+    let mut buf = Vec::new();
+    let encoder = AvifEncoder::new_with_speed_quality(&mut buf, speed as u8, quality as u8);
+    if encoder
+        .write_image(&samples, pix.w() as u32, pix.h() as u32, color_type)
+        .is_ok()
+    {
+        buf
+    } else {
+        Vec::new()
+    }
+}
+
+#[cfg(not(feature = "avif"))]
+fn encode_avif(_pix: &Pixmap, _quality: i32, _speed: i32) -> Vec<u8> {
+    Vec::new()
+}
+
 // ============================================================================
 // Helper Functions
 // ============================================================================
@@ -1277,6 +1848,74 @@ mod tests {
         crate::ffi::pixmap::fz_drop_pixmap(ctx, pix);
     }
 
+    #[test]
+    fn test_png_buffer_with_options() {
+        let ctx = 1;
+        let pix = create_test_pixmap();
+
+        for effort in [0, 1, 9] {
+            let buf = fz_new_buffer_from_pixmap_as_png_with_options(ctx, pix, effort, 0);
+            assert!(buf > 0);
+            if let Some(buf_arc) = BUFFERS.get(buf) {
+                let decoded = image::load_from_memory(buf_arc.lock().unwrap().data()).unwrap();
+                assert_eq!(decoded.width(), 10);
+                assert_eq!(decoded.height(), 10);
+            }
+            crate::ffi::buffer::fz_drop_buffer(ctx, buf);
+        }
+
+        crate::ffi::pixmap::fz_drop_pixmap(ctx, pix);
+    }
+
+    #[test]
+    fn test_jpeg_buffer_with_options() {
+        let ctx = 1;
+        let pix = create_test_pixmap();
+
+        for threads in [1, 0] {
+            let buf = fz_new_buffer_from_pixmap_as_jpeg_with_options(ctx, pix, 0, threads);
+            assert!(buf > 0);
+            if let Some(buf_arc) = BUFFERS.get(buf) {
+                let decoded = image::load_from_memory(buf_arc.lock().unwrap().data()).unwrap();
+                assert_eq!(decoded.width(), 10);
+                assert_eq!(decoded.height(), 10);
+            }
+            crate::ffi::buffer::fz_drop_buffer(ctx, buf);
+        }
+
+        crate::ffi::pixmap::fz_drop_pixmap(ctx, pix);
+    }
+
+    #[test]
+    fn test_qoi_buffer() {
+        let ctx = 1;
+        let pix = create_test_pixmap();
+
+        let buf = fz_new_buffer_from_pixmap_as_qoi(ctx, pix);
+        assert!(buf > 0);
+
+        if let Some(buf_arc) = BUFFERS.get(buf) {
+            let buf_guard = buf_arc.lock().unwrap();
+            let data = buf_guard.data();
+            assert_eq!(&data[0..4], b"qoif");
+            assert_eq!(&data[4..8], &10u32.to_be_bytes());
+            assert_eq!(&data[8..12], &10u32.to_be_bytes());
+            assert_eq!(data[12], 4);
+            assert_eq!(&data[data.len() - 8..], &[0, 0, 0, 0, 0, 0, 0, 1]);
+        }
+
+        crate::ffi::buffer::fz_drop_buffer(ctx, buf);
+        crate::ffi::pixmap::fz_drop_pixmap(ctx, pix);
+    }
+
+    #[test]
+    fn test_qoi_runs_and_diffs() {
+        let pix = Pixmap::new(crate::ffi::colorspace::FZ_COLORSPACE_GRAY, 100, 1, false);
+        let data = encode_qoi(&pix);
+        // 100 black pixels repeat the initial opaque black: runs of 62 and 38
+        assert_eq!(&data[14..data.len() - 8], &[0xC0 | 61, 0xC0 | 37]);
+    }
+
     #[test]
     fn test_jpeg_buffer() {
         let ctx = 1;
@@ -6,11 +6,19 @@
 use super::ffi_safety::{cstr_to_str, cstr_to_string};
 use std::collections::HashMap;
 use std::ffi::{CStr, CString};
+use std::fs::File;
+use std::io::BufWriter;
 use std::os::raw::c_char;
 use std::sync::{LazyLock, Mutex};
 
-use crate::ffi::stext::Rect;
+use crate::ffi::document::{fz_bound_page, fz_count_pages, fz_drop_page, fz_load_page};
+use crate::ffi::stext::{
+    Rect, fz_drop_stext_page, fz_new_stext_page_from_page, fz_print_stext_page_as_html,
+    fz_stext_page_as_text,
+};
+use crate::ffi::text_extract::{batch_threads, for_each_page_in_order};
 use crate::ffi::{Handle, HandleStore};
+use crate::fitz::zip_writer::ZipWriter;
 
 /// Global store for document writers
 pub static WRITERS: LazyLock<HandleStore<DocumentWriter>> = LazyLock::new(HandleStore::new);
@@ -44,6 +52,9 @@ pub enum WriterFormat {
     Ppm = 19,
     Pbm = 20,
     Pkm = 21,
+    Webp = 22,
+    Qoi = 23,
+    Avif = 24,
 }
 
 impl WriterFormat {
@@ -72,6 +83,9 @@ impl WriterFormat {
             "ppm" => Some(WriterFormat::Ppm),
             "pbm" => Some(WriterFormat::Pbm),
             "pkm" => Some(WriterFormat::Pkm),
+            "webp" => Some(WriterFormat::Webp),
+            "qoi" => Some(WriterFormat::Qoi),
+            "avif" => Some(WriterFormat::Avif),
             _ => None,
         }
     }
@@ -101,6 +115,9 @@ impl WriterFormat {
             WriterFormat::Ppm => "ppm",
             WriterFormat::Pbm => "pbm",
             WriterFormat::Pkm => "pkm",
+            WriterFormat::Webp => "webp",
+            WriterFormat::Qoi => "qoi",
+            WriterFormat::Avif => "avif",
         }
     }
 
@@ -125,6 +142,19 @@ impl WriterFormat {
         )
     }
 
+    /// Check if pages are converted to text for this format
+    pub fn is_text(&self) -> bool {
+        matches!(
+            self,
+            WriterFormat::Text
+                | WriterFormat::Html
+                | WriterFormat::Xhtml
+                | WriterFormat::Odt
+                | WriterFormat::Docx
+                | WriterFormat::Csv
+        )
+    }
+
     /// Check if format is image-based
     pub fn is_image(&self) -> bool {
         matches!(
@@ -137,6 +167,9 @@ impl WriterFormat {
                 | WriterFormat::Ppm
                 | WriterFormat::Pbm
                 | WriterFormat::Pkm
+                | WriterFormat::Webp
+                | WriterFormat::Qoi
+                | WriterFormat::Avif
         )
     }
 }
@@ -172,6 +205,8 @@ pub struct WriterOptions {
     pub encrypt: bool,
     /// OCR language
     pub ocr_language: Option<String>,
+    /// Worker threads for `fz_write_document` (one per core if unset)
+    pub threads: Option<i32>,
 }
 
 impl WriterOptions {
@@ -212,6 +247,9 @@ impl WriterOptions {
                     "language" | "lang" | "ocr-language" => {
                         options.ocr_language = Some(value.to_string());
                     }
+                    "threads" => {
+                        options.threads = value.parse().ok();
+                    }
                     _ => {}
                 }
             } else {
@@ -260,6 +298,8 @@ pub struct DocumentWriter {
     pub current_page: Option<WriterPage>,
     pub current_device: Option<Handle>,
     pub page_count: i32,
+    /// DOCX/ODT package streamed to `path` as pages end
+    package: Option<ZipWriter<BufWriter<File>>>,
 }
 
 impl DocumentWriter {
@@ -276,6 +316,7 @@ impl DocumentWriter {
             current_page: None,
             current_device: None,
             page_count: 0,
+            package: None,
         }
     }
 
@@ -319,7 +360,12 @@ impl DocumentWriter {
             return false;
         }
 
-        if let Some(page) = self.current_page.take() {
+        if let Some(mut page) = self.current_page.take() {
+            if self.streams_package() {
+                // The text is in the package now; keep only the page record
+                self.stream_page(&page.content);
+                page.content = Vec::new();
+            }
             self.pages.push(page);
             self.page_count += 1;
         }
@@ -329,6 +375,17 @@ impl DocumentWriter {
         true
     }
 
+    /// Write a complete page with the given content
+    pub fn add_page(&mut self, mediabox: Rect, content: Vec<u8>) -> bool {
+        if !self.begin_page(mediabox) {
+            return false;
+        }
+        if let Some(page) = self.current_page.as_mut() {
+            page.content = content;
+        }
+        self.end_page()
+    }
+
     /// Close the writer
     pub fn close(&mut self) -> bool {
         if self.state == WriterState::Closed {
@@ -348,12 +405,14 @@ impl DocumentWriter {
     }
 
     /// Write output (format-specific)
-    fn write_output(&self) {
+    fn write_output(&mut self) {
         match self.format {
             WriterFormat::Pdf => self.write_pdf(),
             WriterFormat::Svg => self.write_svg(),
             WriterFormat::Text => self.write_text(),
             WriterFormat::Html | WriterFormat::Xhtml => self.write_html(),
+            WriterFormat::Csv => self.write_csv(),
+            WriterFormat::Docx | WriterFormat::Odt => self.finish_package(),
             WriterFormat::Cbz => self.write_cbz(),
             WriterFormat::Png
             | WriterFormat::Jpeg
@@ -362,7 +421,10 @@ impl DocumentWriter {
             | WriterFormat::Pgm
             | WriterFormat::Ppm
             | WriterFormat::Pbm
-            | WriterFormat::Pkm => self.write_image(),
+            | WriterFormat::Pkm
+            | WriterFormat::Webp
+            | WriterFormat::Qoi
+            | WriterFormat::Avif => self.write_image(),
             _ => {
                 // Other formats use generic write
             }
@@ -473,12 +535,12 @@ impl DocumentWriter {
     /// Write text output
     fn write_text(&self) {
         let mut text = String::new();
-        for (i, _page) in self.pages.iter().enumerate() {
+        for (i, page) in self.pages.iter().enumerate() {
             if i > 0 {
                 text.push_str("\n\n--- Page Break ---\n\n");
             }
             text.push_str(&format!("--- Page {} ---\n", i + 1));
-            // Page content would be added here
+            text.push_str(&String::from_utf8_lossy(&page.content));
         }
 
         if let Some(ref path) = self.path {
@@ -501,8 +563,9 @@ impl DocumentWriter {
             "<html>\n<head>\n<meta charset=\"UTF-8\">\n<title>Document</title>\n</head>\n<body>\n",
         );
 
-        for (i, _page) in self.pages.iter().enumerate() {
+        for (i, page) in self.pages.iter().enumerate() {
             html.push_str(&format!("<div class=\"page\" id=\"page-{}\">\n", i + 1));
+            html.push_str(&String::from_utf8_lossy(&page.content));
             html.push_str("</div>\n");
         }
 
@@ -513,6 +576,82 @@ impl DocumentWriter {
         }
     }
 
+    /// Write CSV output: one quoted row per line of text, pages in order
+    fn write_csv(&self) {
+        if let Some(ref path) = self.path {
+            let csv: Vec<u8> = self
+                .pages
+                .iter()
+                .flat_map(|p| p.content.iter().copied())
+                .collect();
+            let _ = std::fs::write(path, csv);
+        }
+    }
+
+    /// Check if pages go straight into a DOCX/ODT package on disk
+    fn streams_package(&self) -> bool {
+        matches!(self.format, WriterFormat::Docx | WriterFormat::Odt) && self.path.is_some()
+    }
+
+    /// Create the package and open its document part
+    fn open_package(&self) -> Option<ZipWriter<BufWriter<File>>> {
+        let file = File::create(self.path.as_ref()?).ok()?;
+        let mut zip = ZipWriter::new(BufWriter::new(file));
+        let started = if self.format == WriterFormat::Docx {
+            zip.add_entry("[Content_Types].xml", DOCX_CONTENT_TYPES.as_bytes(), true)
+                .and_then(|_| zip.add_entry("_rels/.rels", DOCX_RELS.as_bytes(), true))
+                .and_then(|_| zip.begin_entry("word/document.xml"))
+                .and_then(|_| zip.write(DOCX_HEAD.as_bytes()))
+        } else {
+            // The mimetype must come first and stored, for sniffing
+            zip.add_entry("mimetype", ODT_MIMETYPE.as_bytes(), false)
+                .and_then(|_| zip.add_entry("META-INF/manifest.xml", ODT_MANIFEST.as_bytes(), true))
+                .and_then(|_| zip.begin_entry("content.xml"))
+                .and_then(|_| zip.write(ODT_HEAD.as_bytes()))
+        };
+        started.ok().map(|_| zip)
+    }
+
+    /// Deflate one page of text into the document part
+    ///
+    /// The package is opened on the first page; a write error drops it
+    /// and the remaining pages are discarded, like the other writers'
+    /// ignored I/O errors.
+    fn stream_page(&mut self, content: &[u8]) {
+        if self.page_count == 0 {
+            self.package = self.open_package();
+        }
+        let Some(zip) = self.package.as_mut() else {
+            return;
+        };
+        let xml = if self.format == WriterFormat::Docx {
+            docx_page(content, self.page_count > 0)
+        } else {
+            odt_page(content, self.page_count > 0)
+        };
+        if zip.write(xml.as_bytes()).is_err() {
+            self.package = None;
+        }
+    }
+
+    /// Close the document part and write the central directory
+    fn finish_package(&mut self) {
+        if !self.streams_package() {
+            return;
+        }
+        if self.page_count == 0 {
+            self.package = self.open_package();
+        }
+        if let Some(mut zip) = self.package.take() {
+            let tail = if self.format == WriterFormat::Docx {
+                DOCX_TAIL
+            } else {
+                ODT_TAIL
+            };
+            let _ = zip.write(tail.as_bytes()).and_then(|_| zip.finish());
+        }
+    }
+
     /// Write CBZ (Comic Book ZIP) output
     fn write_cbz(&self) {
         // CBZ is just a ZIP file with images
@@ -543,6 +682,79 @@ impl DocumentWriter {
     }
 }
 
+// ============================================================================
+// DOCX/ODT Package Parts
+// ============================================================================
+
+const DOCX_CONTENT_TYPES: &str = r#"<?xml version="1.0" encoding="UTF-8" standalone="yes"?>
+<Types xmlns="http://schemas.openxmlformats.org/package/2006/content-types"><Default Extension="rels" ContentType="application/vnd.openxmlformats-package.relationships+xml"/><Default Extension="xml" ContentType="application/xml"/><Override PartName="/word/document.xml" ContentType="application/vnd.openxmlformats-officedocument.wordprocessingml.document.main+xml"/></Types>
+"#;
+
+const DOCX_RELS: &str = r#"<?xml version="1.0" encoding="UTF-8" standalone="yes"?>
+<Relationships xmlns="http://schemas.openxmlformats.org/package/2006/relationships"><Relationship Id="rId1" Type="http://schemas.openxmlformats.org/officeDocument/2006/relationships/officeDocument" Target="word/document.xml"/></Relationships>
+"#;
+
+const DOCX_HEAD: &str = r#"<?xml version="1.0" encoding="UTF-8" standalone="yes"?>
+<w:document xmlns:w="http://schemas.openxmlformats.org/wordprocessingml/2006/main"><w:body>
+"#;
+
+const DOCX_TAIL: &str = "</w:body></w:document>\n";
+
+const ODT_MIMETYPE: &str = "application/vnd.oasis.opendocument.text";
+
+const ODT_MANIFEST: &str = r#"<?xml version="1.0" encoding="UTF-8"?>
+<manifest:manifest xmlns:manifest="urn:oasis:names:tc:opendocument:xmlns:manifest:1.0" manifest:version="1.2"><manifest:file-entry manifest:full-path="/" manifest:version="1.2" manifest:media-type="application/vnd.oasis.opendocument.text"/><manifest:file-entry manifest:full-path="content.xml" manifest:media-type="text/xml"/></manifest:manifest>
+"#;
+
+const ODT_HEAD: &str = r#"<?xml version="1.0" encoding="UTF-8"?>
+<office:document-content xmlns:office="urn:oasis:names:tc:opendocument:xmlns:office:1.0" xmlns:style="urn:oasis:names:tc:opendocument:xmlns:style:1.0" xmlns:text="urn:oasis:names:tc:opendocument:xmlns:text:1.0" xmlns:fo="urn:oasis:names:tc:opendocument:xmlns:xsl-fo-compatible:1.0" office:version="1.2"><office:automatic-styles><style:style style:name="PageBreak" style:family="paragraph"><style:paragraph-properties fo:break-before="page"/></style:style></office:automatic-styles><office:body><office:text>
+"#;
+
+const ODT_TAIL: &str = "</office:text></office:body></office:document-content>\n";
+
+/// One WordprocessingML paragraph per line of page text
+fn docx_page(content: &[u8], page_break: bool) -> String {
+    let mut xml = String::new();
+    if page_break {
+        xml.push_str("<w:p><w:r><w:br w:type=\"page\"/></w:r></w:p>\n");
+    }
+    for line in String::from_utf8_lossy(content).lines() {
+        xml.push_str("<w:p><w:r><w:t xml:space=\"preserve\">");
+        push_xml_escaped(&mut xml, line);
+        xml.push_str("</w:t></w:r></w:p>\n");
+    }
+    xml
+}
+
+/// One ODF paragraph per line of page text
+fn odt_page(content: &[u8], page_break: bool) -> String {
+    let mut xml = String::new();
+    if page_break {
+        xml.push_str("<text:p text:style-name=\"PageBreak\"/>\n");
+    }
+    for line in String::from_utf8_lossy(content).lines() {
+        xml.push_str("<text:p>");
+        push_xml_escaped(&mut xml, line);
+        xml.push_str("</text:p>\n");
+    }
+    xml
+}
+
+/// Escape text for XML, dropping control characters XML 1.0 can't carry
+fn push_xml_escaped(xml: &mut String, text: &str) {
+    for c in text.chars() {
+        match c {
+            '&' => xml.push_str("&amp;"),
+            '<' => xml.push_str("&lt;"),
+            '>' => xml.push_str("&gt;"),
+            '"' => xml.push_str("&quot;"),
+            '\t' => xml.push(c),
+            c if c < ' ' => {}
+            c => xml.push(c),
+        }
+    }
+}
+
 /// Writer device (borrowed from begin_page)
 pub struct WriterDevice {
     pub writer: Handle,
@@ -1487,6 +1699,78 @@ pub extern "C" fn fz_new_pkm_pixmap_writer(
     WRITERS.insert(writer)
 }
 
+/// Create WebP pixmap writer
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_webp_pixmap_writer(
+    _ctx: Handle,
+    path: *const c_char,
+    options: *const c_char,
+) -> Handle {
+    let path_str = if path.is_null() {
+        None
+    } else {
+        unsafe { CStr::from_ptr(path).to_str().ok().map(String::from) }
+    };
+
+    let opts = if options.is_null() {
+        WriterOptions::default()
+    } else {
+        let opts_str = unsafe { CStr::from_ptr(options).to_str().unwrap_or("") };
+        WriterOptions::parse(opts_str)
+    };
+
+    let writer = DocumentWriter::new(WriterFormat::Webp, path_str, opts);
+    WRITERS.insert(writer)
+}
+
+/// Create QOI pixmap writer
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_qoi_pixmap_writer(
+    _ctx: Handle,
+    path: *const c_char,
+    options: *const c_char,
+) -> Handle {
+    let path_str = if path.is_null() {
+        None
+    } else {
+        unsafe { CStr::from_ptr(path).to_str().ok().map(String::from) }
+    };
+
+    let opts = if options.is_null() {
+        WriterOptions::default()
+    } else {
+        let opts_str = unsafe { CStr::from_ptr(options).to_str().unwrap_or("") };
+        WriterOptions::parse(opts_str)
+    };
+
+    let writer = DocumentWriter::new(WriterFormat::Qoi, path_str, opts);
+    WRITERS.insert(writer)
+}
+
+/// Create AVIF pixmap writer
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_avif_pixmap_writer(
+    _ctx: Handle,
+    path: *const c_char,
+    options: *const c_char,
+) -> Handle {
+    let path_str = if path.is_null() {
+        None
+    } else {
+        unsafe { CStr::from_ptr(path).to_str().ok().map(String::from) }
+    };
+
+    let opts = if options.is_null() {
+        WriterOptions::default()
+    } else {
+        let opts_str = unsafe { CStr::from_ptr(options).to_str().unwrap_or("") };
+        WriterOptions::parse(opts_str)
+    };
+
+    let writer = DocumentWriter::new(WriterFormat::Avif, path_str, opts);
+    WRITERS.insert(writer)
+}
+
 // ============================================================================
 // FFI Functions - Page Lifecycle
 // ============================================================================
@@ -1537,27 +1821,98 @@ pub extern "C" fn fz_end_page(_ctx: Handle, wri: Handle) {
 }
 
 /// Write a full document
+///
+/// Pages are loaded and converted (to text, HTML or CSV rows for the
+/// text-based formats) on worker threads with cloned contexts, one per
+/// core unless the writer has a `threads=N` option, and added to the
+/// writer strictly in page order. Pages that fail to load are skipped.
 #[unsafe(no_mangle)]
-pub extern "C" fn fz_write_document(_ctx: Handle, wri: Handle, doc: Handle) {
-    // Get page count from document and write each page
-    if let Some(_doc_arc) = crate::ffi::DOCUMENTS.get(doc) {
-        if let Some(writer_arc) = WRITERS.get(wri) {
-            let mut writer = writer_arc.lock().unwrap();
-            // For a basic implementation, we'd iterate through document pages
-            // and call begin_page/end_page for each
-            // This requires document page enumeration which depends on document.rs
-
-            // For now, create a single empty page as placeholder
-            let mediabox = Rect {
-                x0: 0.0,
-                y0: 0.0,
-                x1: 612.0,
-                y1: 792.0,
-            }; // Letter size
-            writer.begin_page(mediabox);
-            writer.end_page();
+pub extern "C" fn fz_write_document(ctx: Handle, wri: Handle, doc: Handle) {
+    let Some(writer_arc) = WRITERS.get(wri) else {
+        return;
+    };
+    let pages = fz_count_pages(ctx, doc);
+    if pages <= 0 {
+        return;
+    }
+    let pages = pages as usize;
+    let Ok(mut writer) = writer_arc.lock() else {
+        return;
+    };
+    let format = writer.format;
+    let threads = batch_threads(writer.options.threads.unwrap_or(0), pages);
+
+    for_each_page_in_order(
+        ctx,
+        pages,
+        threads,
+        threads * 2,
+        |worker_ctx, n| convert_page(worker_ctx, doc, n, format),
+        |_, page| match page {
+            Some(page) => writer.add_page(page.mediabox, page.content),
+            None => true,
+        },
+    );
+}
+
+/// Load page `n` for `fz_write_document`, with its text in the writer's
+/// markup when the format is text-based
+fn convert_page(ctx: Handle, doc: Handle, n: i32, format: WriterFormat) -> Option<WriterPage> {
+    let page = fz_load_page(ctx, doc, n);
+    if page == 0 {
+        return None;
+    }
+    let bounds = fz_bound_page(ctx, page);
+    let mut content = Vec::new();
+    if format.is_text() {
+        let stext = fz_new_stext_page_from_page(ctx, page, std::ptr::null());
+        if stext != 0 {
+            content = page_markup(ctx, stext, n, format);
+            fz_drop_stext_page(ctx, stext);
+        }
+    }
+    fz_drop_page(ctx, page);
+    Some(WriterPage {
+        index: n,
+        mediabox: Rect {
+            x0: bounds.x0,
+            y0: bounds.y0,
+            x1: bounds.x1,
+            y1: bounds.y1,
+        },
+        content,
+    })
+}
+
+/// An stext page as the writer's page content
+fn page_markup(ctx: Handle, stext: Handle, n: i32, format: WriterFormat) -> Vec<u8> {
+    let out = match format {
+        WriterFormat::Html | WriterFormat::Xhtml => {
+            fz_print_stext_page_as_html(ctx, 0, stext, n + 1)
+        }
+        _ => fz_stext_page_as_text(ctx, stext),
+    };
+    if out.is_null() {
+        return Vec::new();
+    }
+    // SAFETY: non-null results are NUL-terminated and live in this
+    // thread's scratch slot until the next call
+    let text = unsafe { CStr::from_ptr(out) }.to_bytes();
+    if format != WriterFormat::Csv {
+        return text.to_vec();
+    }
+    let mut csv = Vec::with_capacity(text.len() + text.len() / 8);
+    for line in text.split(|&b| b == b'\n').filter(|l| !l.is_empty()) {
+        csv.push(b'"');
+        for &b in line {
+            if b == b'"' {
+                csv.push(b'"');
+            }
+            csv.push(b);
         }
+        csv.extend_from_slice(b"\"\n");
     }
+    csv
 }
 
 /// Close the document writer
@@ -1643,6 +1998,19 @@ pub struct OcrProgressCallback {
 unsafe impl Send for OcrProgressCallback {}
 unsafe impl Sync for OcrProgressCallback {}
 
+/// Report OCR progress on a page to the writer's callback, if one is set
+///
+/// Returns false if the callback asked to abort.
+pub(crate) fn report_ocr_progress(ctx: Handle, wri: Handle, page: i32, percent: i32) -> bool {
+    let Ok(callbacks) = OCR_PROGRESS_CALLBACKS.lock() else {
+        return true;
+    };
+    match callbacks.get(&wri) {
+        Some(cb) => (cb.callback)(ctx, cb.user_data, page, percent) == 0,
+        None => true,
+    }
+}
+
 /// Set OCR progress callback for writer
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_pdfocr_writer_set_progress(
@@ -1678,6 +2046,7 @@ mod tests {
         assert_eq!(WriterFormat::from_str("png"), Some(WriterFormat::Png));
         assert_eq!(WriterFormat::from_str("jpeg"), Some(WriterFormat::Jpeg));
         assert_eq!(WriterFormat::from_str("jpg"), Some(WriterFormat::Jpeg));
+        assert_eq!(WriterFormat::from_str("qoi"), Some(WriterFormat::Qoi));
         assert_eq!(WriterFormat::from_str("unknown"), None);
     }
 
@@ -1862,6 +2231,9 @@ mod tests {
             fz_new_ppm_pixmap_writer(ctx, std::ptr::null(), std::ptr::null()),
             fz_new_pbm_pixmap_writer(ctx, std::ptr::null(), std::ptr::null()),
             fz_new_pkm_pixmap_writer(ctx, std::ptr::null(), std::ptr::null()),
+            fz_new_webp_pixmap_writer(ctx, std::ptr::null(), std::ptr::null()),
+            fz_new_qoi_pixmap_writer(ctx, std::ptr::null(), std::ptr::null()),
+            fz_new_avif_pixmap_writer(ctx, std::ptr::null(), std::ptr::null()),
         ];
 
         for wri in writers {
@@ -1869,4 +2241,93 @@ mod tests {
             fz_drop_document_writer(ctx, wri);
         }
     }
+
+    #[test]
+    fn test_write_document_in_page_order() {
+        use crate::ffi::DOCUMENTS;
+        use crate::ffi::context::fz_new_context;
+        use crate::ffi::document::Document;
+
+        let ctx = unsafe { fz_new_context(std::ptr::null(), std::ptr::null(), 1024 * 1024) };
+        let mut data = b"%PDF-1.4\n".to_vec();
+        for _ in 0..9 {
+            data.extend_from_slice(b"/Type /Page\n");
+        }
+        data.extend_from_slice(b"%%EOF");
+        let doc = DOCUMENTS.insert(Document::new(data));
+        let pages = fz_count_pages(ctx, doc);
+        assert!(pages > 0);
+
+        let write = |format: &str, threads: i32| {
+            let path = std::env::temp_dir().join(format!("micropdf_write_doc_{threads}.{format}"));
+            let c_path = CString::new(path.to_str().unwrap()).unwrap();
+            let c_format = CString::new(format).unwrap();
+            let opts = CString::new(format!("threads={threads}")).unwrap();
+            let wri =
+                fz_new_document_writer(ctx, c_path.as_ptr(), c_format.as_ptr(), opts.as_ptr());
+            fz_write_document(ctx, wri, doc);
+            assert_eq!(fz_document_writer_page_count(wri), pages);
+            fz_drop_document_writer(ctx, wri);
+            let out = std::fs::read_to_string(&path).unwrap();
+            let _ = std::fs::remove_file(&path);
+            out
+        };
+
+        let text = write("text", 4);
+        assert!(text.contains(&format!("--- Page {pages} ---")));
+        assert_eq!(write("text", 1), text);
+        let html = write("html", 3);
+        assert!(html.contains(&format!("<div class=\"page\" id=\"page-{pages}\">")));
+
+        DOCUMENTS.remove(doc);
+    }
+
+    #[test]
+    fn test_office_package_streams_pages() {
+        use crate::fitz::archive::Archive;
+
+        let mediabox = Rect {
+            x0: 0.0,
+            y0: 0.0,
+            x1: 612.0,
+            y1: 792.0,
+        };
+        let read = |format: WriterFormat, ext: &str| {
+            let path = std::env::temp_dir().join(format!("micropdf_package_test.{ext}"));
+            let mut writer = DocumentWriter::new(
+                format,
+                Some(path.to_str().unwrap().to_string()),
+                WriterOptions::default(),
+            );
+            for n in 0..3 {
+                assert!(writer.add_page(mediabox, format!("page {n}\n<a & b>\n").into_bytes()));
+            }
+            // Only the page records stay in memory
+            assert!(writer.pages.iter().all(|p| p.content.is_empty()));
+            assert!(writer.close());
+            let bytes = std::fs::read(&path).unwrap();
+            let _ = std::fs::remove_file(&path);
+            bytes
+        };
+
+        let mut docx = Archive::from_buffer(read(WriterFormat::Docx, "docx")).unwrap();
+        assert!(docx.has_entry("[Content_Types].xml"));
+        let body = String::from_utf8(docx.read_entry("word/document.xml").unwrap()).unwrap();
+        assert_eq!(body.matches("w:type=\"page\"").count(), 2);
+        assert!(body.contains(">page 2</w:t>"));
+        assert!(body.contains("&lt;a &amp; b&gt;"));
+        assert!(body.ends_with("</w:body></w:document>\n"));
+
+        let bytes = read(WriterFormat::Odt, "odt");
+        // The stored mimetype leads the package, where readers sniff for it
+        assert_eq!(&bytes[30..38], b"mimetype");
+        let mut odt = Archive::from_buffer(bytes).unwrap();
+        assert_eq!(odt.read_entry("mimetype").unwrap(), ODT_MIMETYPE.as_bytes());
+        let content = String::from_utf8(odt.read_entry("content.xml").unwrap()).unwrap();
+        assert_eq!(
+            content.matches("text:style-name=\"PageBreak\"/>").count(),
+            2
+        );
+        assert!(content.contains("<text:p>page 0</text:p>"));
+    }
 }
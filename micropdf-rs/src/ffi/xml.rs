@@ -1,7 +1,28 @@
 //! C FFI for XML parsing - MuPDF compatible
 //! Safe Rust implementation of fz_xml
-
+//!
+//! Parsing is split into a pull tokenizer ([`XmlTokenizer`]) and a tree
+//! builder. The tokenizer finds its delimiters with the SIMD byte search
+//! in `simd_util`, so long runs of character data, attribute values,
+//! comments and CDATA are crossed a vector at a time.
+//!
+//! A document keeps its whole tree in three arenas: one `Vec` of nodes
+//! linked by index, one of attributes, and one string holding every
+//! name and value back to back, each NUL-terminated so the C accessors
+//! hand out pointers straight into it. Node handles encode the document
+//! handle and the node index instead of taking a handle store entry per
+//! node, and dropping the document frees the tree all at once.
+//!
+//! [`XmlSelect`] turns on selective parsing: only the elements at the
+//! given paths are built (with their ancestors), everything else is
+//! tokenized and thrown away, and with `first_match` the parse stops as
+//! soon as each path has been found. Reading a few header fields of a
+//! large invoice costs a scan of the header, not a tree of the invoice.
+
+use super::simd_util::{find_bytes, scan_until_any};
 use super::{Handle, HandleStore};
+use crate::fitz::error::{Error, Result};
+use std::borrow::Cow;
 use std::collections::HashMap;
 use std::ffi::{CStr, c_char};
 use std::sync::LazyLock;
@@ -24,44 +45,68 @@ pub enum XmlNodeType {
     ProcessingInstruction = 5,
 }
 
-/// XML node structure
+/// No node: the end of a sibling chain, or the parent of the document node
+const NO_NODE: u32 = u32::MAX;
+
+/// Index bits of a node handle; the document handle sits above them
+const XML_NODE_BITS: u32 = 22;
+const XML_NODE_MASK: Handle = (1 << XML_NODE_BITS) - 1;
+
+static EMPTY: &[u8] = b"\0";
+
+/// A string in the document's text arena, NUL excluded
+#[derive(Debug, Clone, Copy, Default)]
+struct Span {
+    start: u32,
+    len: u32,
+}
+
+/// Attribute of an element
+#[derive(Debug, Clone, Copy)]
+struct XmlAttribute {
+    name: Span,
+    value: Span,
+}
+
+/// XML node structure, linked to its neighbours by arena index
 #[derive(Debug, Clone)]
 pub struct XmlNode {
     /// Node type
     pub node_type: XmlNodeType,
     /// Tag name (for elements)
-    pub name: String,
-    /// Namespace URI
-    pub namespace_uri: String,
-    /// Namespace prefix
-    pub namespace_prefix: String,
+    name: Span,
+    /// Default namespace declared on the element
+    namespace_uri: Span,
     /// Text content
-    pub content: String,
-    /// Attributes
-    pub attributes: HashMap<String, String>,
-    /// Child nodes
-    pub children: Vec<Handle>,
+    content: Span,
+    /// First attribute and attribute count
+    attributes: (u32, u32),
     /// Parent node
-    pub parent: Handle,
-    /// Next sibling
-    pub next: Handle,
-    /// Previous sibling
-    pub prev: Handle,
+    parent: u32,
+    /// First and last child
+    first_child: u32,
+    last_child: u32,
+    /// Next and previous sibling
+    next: u32,
+    prev: u32,
+    /// Number of children
+    child_count: u32,
 }
 
-impl Default for XmlNode {
-    fn default() -> Self {
+impl XmlNode {
+    fn new(node_type: XmlNodeType, parent: u32) -> Self {
         Self {
-            node_type: XmlNodeType::Element,
-            name: String::new(),
-            namespace_uri: String::new(),
-            namespace_prefix: String::new(),
-            content: String::new(),
-            attributes: HashMap::new(),
-            children: Vec::new(),
-            parent: 0,
-            next: 0,
-            prev: 0,
+            node_type,
+            name: Span::default(),
+            namespace_uri: Span::default(),
+            content: Span::default(),
+            attributes: (0, 0),
+            parent,
+            first_child: NO_NODE,
+            last_child: NO_NODE,
+            next: NO_NODE,
+            prev: NO_NODE,
+            child_count: 0,
         }
     }
 }
@@ -69,10 +114,12 @@ impl Default for XmlNode {
 /// XML document structure
 #[derive(Debug)]
 pub struct XmlDocument {
-    /// Root element
-    pub root: Handle,
-    /// All nodes (for handle lookup)
-    pub nodes: Vec<Handle>,
+    /// Node arena; index 0 is the document node
+    nodes: Vec<XmlNode>,
+    /// Attribute arena, in element order
+    attributes: Vec<XmlAttribute>,
+    /// Every name and value, each followed by a NUL
+    text: String,
     /// Namespace declarations
     pub namespaces: HashMap<String, String>,
     /// XML version
@@ -86,8 +133,9 @@ pub struct XmlDocument {
 impl Default for XmlDocument {
     fn default() -> Self {
         Self {
-            root: 0,
-            nodes: Vec::new(),
+            nodes: vec![XmlNode::new(XmlNodeType::Document, NO_NODE)],
+            attributes: Vec::new(),
+            text: String::new(),
             namespaces: HashMap::new(),
             version: "1.0".to_string(),
             encoding: "UTF-8".to_string(),
@@ -96,293 +144,775 @@ impl Default for XmlDocument {
     }
 }
 
-/// Global XML node storage
-pub static XML_NODES: LazyLock<HandleStore<XmlNode>> = LazyLock::new(HandleStore::new);
+impl XmlDocument {
+    /// Parse a whole document
+    ///
+    /// Text is trimmed and whitespace-only text dropped unless
+    /// `preserve_whitespace` is set.
+    pub fn parse(xml: &str, preserve_whitespace: bool) -> Result<Self> {
+        build(xml, preserve_whitespace, None)
+    }
 
-/// Global XML document storage
-pub static XML_DOCS: LazyLock<HandleStore<XmlDocument>> = LazyLock::new(HandleStore::new);
+    /// Parse only the elements `select` asks for
+    pub fn parse_selected(
+        xml: &str,
+        preserve_whitespace: bool,
+        select: &XmlSelect,
+    ) -> Result<Self> {
+        build(xml, preserve_whitespace, Some(select))
+    }
 
-// ============================================================================
-// Document Creation and Parsing
-// ============================================================================
+    /// Number of nodes, the document node included
+    pub fn len(&self) -> usize {
+        self.nodes.len()
+    }
 
-/// Create a new empty XML document
-#[unsafe(no_mangle)]
-pub extern "C" fn fz_new_xml_document(_ctx: Handle) -> Handle {
-    XML_DOCS.insert(XmlDocument::default())
-}
+    /// Check if the document has no nodes besides the document node
+    pub fn is_empty(&self) -> bool {
+        self.nodes.len() == 1
+    }
 
-/// Parse XML from string
-///
-/// # Safety
-/// `xml_string` must be a valid null-terminated UTF-8 string.
-#[unsafe(no_mangle)]
-pub extern "C" fn fz_parse_xml(
-    _ctx: Handle,
-    xml_string: *const c_char,
-    _preserve_whitespace: i32,
-) -> Handle {
-    if xml_string.is_null() {
-        return 0;
+    /// The root element
+    pub fn root(&self) -> Option<u32> {
+        self.children(0)
+            .find(|&i| self.nodes[i as usize].node_type == XmlNodeType::Element)
     }
 
-    let xml_str = unsafe { CStr::from_ptr(xml_string) };
-    let xml = match xml_str.to_str() {
-        Ok(s) => s,
-        Err(_) => return 0,
-    };
+    /// Node at `index`
+    pub fn node(&self, index: u32) -> Option<&XmlNode> {
+        self.nodes.get(index as usize)
+    }
 
-    // Simple XML parser
-    match parse_xml_string(xml) {
-        Some(doc_handle) => doc_handle,
-        None => 0,
+    /// Children of `index`, in document order
+    pub fn children(&self, index: u32) -> impl Iterator<Item = u32> + '_ {
+        let first = self.node(index).map_or(NO_NODE, |n| n.first_child);
+        std::iter::successors(Some(first).filter(|&i| i != NO_NODE), |&i| {
+            Some(self.nodes[i as usize].next).filter(|&n| n != NO_NODE)
+        })
     }
-}
 
-/// Parse XML from buffer
-#[unsafe(no_mangle)]
-pub extern "C" fn fz_parse_xml_from_buffer(
-    _ctx: Handle,
-    buffer: Handle,
-    _preserve_whitespace: i32,
-) -> Handle {
-    if let Some(buf) = super::BUFFERS.get(buffer) {
-        if let Ok(guard) = buf.lock() {
-            if let Ok(xml_str) = std::str::from_utf8(guard.data()) {
-                return parse_xml_string(xml_str).unwrap_or(0);
-            }
+    /// Tag name of an element, empty for other nodes
+    pub fn name(&self, index: u32) -> &str {
+        self.node(index).map_or("", |n| self.span(n.name))
+    }
+
+    /// Content of a text node
+    pub fn text(&self, index: u32) -> &str {
+        self.node(index).map_or("", |n| self.span(n.content))
+    }
+
+    /// Default namespace an element declares with `xmlns`
+    pub fn namespace_uri(&self, index: u32) -> &str {
+        self.node(index).map_or("", |n| self.span(n.namespace_uri))
+    }
+
+    /// Value of attribute `name` on an element
+    pub fn attribute(&self, index: u32, name: &str) -> Option<&str> {
+        let node = self.node(index)?;
+        self.attribute_list(node)
+            .iter()
+            .find(|a| self.span(a.name) == name)
+            .map(|a| self.span(a.value))
+    }
+
+    /// Follow a `/`-separated path of child tag names from `index`
+    pub fn find(&self, index: u32, path: &str) -> Option<u32> {
+        path.split('/')
+            .filter(|s| !s.is_empty())
+            .try_fold(index, |at, segment| {
+                self.children(at).find(|&c| self.name(c) == segment)
+            })
+    }
+
+    fn attribute_list(&self, node: &XmlNode) -> &[XmlAttribute] {
+        let (first, count) = node.attributes;
+        &self.attributes[first as usize..(first + count) as usize]
+    }
+
+    fn span(&self, span: Span) -> &str {
+        &self.text[span.start as usize..(span.start + span.len) as usize]
+    }
+
+    /// Pointer to a span's NUL-terminated copy
+    fn span_ptr(&self, span: Span) -> *const c_char {
+        if span.len == 0 {
+            return EMPTY.as_ptr().cast();
         }
+        self.text[span.start as usize..].as_ptr().cast()
     }
-    0
-}
 
-/// Simple XML parser
-fn parse_xml_string(xml: &str) -> Option<Handle> {
-    let mut doc = XmlDocument::default();
+    fn intern(&mut self, s: &str) -> Result<Span> {
+        let start = self.text.len();
+        if start + s.len() >= u32::MAX as usize {
+            return Err(Error::limit("xml document text over 4 GiB"));
+        }
+        self.text.push_str(s);
+        self.text.push('\0');
+        Ok(Span {
+            start: start as u32,
+            len: s.len() as u32,
+        })
+    }
 
-    // Create root document node
-    let root_node = XmlNode {
-        node_type: XmlNodeType::Document,
-        ..Default::default()
-    };
-    let root_handle = XML_NODES.insert(root_node);
-    doc.root = root_handle;
-    doc.nodes.push(root_handle);
-
-    // Simple recursive descent parser
-    let mut chars = xml.chars().peekable();
-    let mut current_parent = root_handle;
-
-    while chars.peek().is_some() {
-        skip_whitespace(&mut chars);
-
-        if chars.peek() == Some(&'<') {
-            chars.next(); // consume '<'
-
-            if chars.peek() == Some(&'/') {
-                // Closing tag
-                chars.next();
-                let _tag_name = read_until(&mut chars, '>');
-
-                // Move up to parent
-                if let Some(node) = XML_NODES.get(current_parent) {
-                    if let Ok(guard) = node.lock() {
-                        if guard.parent != 0 {
-                            current_parent = guard.parent;
-                        }
-                    }
-                }
-            } else if chars.peek() == Some(&'?') {
-                // Processing instruction
-                chars.next();
-                let _pi = read_until(&mut chars, '>');
-            } else if chars.peek() == Some(&'!') {
-                // Comment or CDATA
-                chars.next();
-                if chars.peek() == Some(&'-') {
-                    // Comment
-                    read_until(&mut chars, '>');
-                } else {
-                    // CDATA or DOCTYPE
-                    read_until(&mut chars, '>');
-                }
+    /// Append `node` as the last child of `parent`
+    fn link(&mut self, parent: u32, mut node: XmlNode) -> Result<u32> {
+        let index = self.nodes.len() as u32;
+        if Handle::from(index) >= XML_NODE_MASK {
+            return Err(Error::limit("too many xml nodes"));
+        }
+        let last = self.nodes[parent as usize].last_child;
+        node.prev = last;
+        if last == NO_NODE {
+            self.nodes[parent as usize].first_child = index;
+        } else {
+            self.nodes[last as usize].next = index;
+        }
+        let p = &mut self.nodes[parent as usize];
+        p.last_child = index;
+        p.child_count += 1;
+        self.nodes.push(node);
+        Ok(index)
+    }
+
+    fn push_element(&mut self, parent: u32, name: &str, attributes: &str) -> Result<u32> {
+        let mut node = XmlNode::new(XmlNodeType::Element, parent);
+        node.name = self.intern(name)?;
+        let first = self.attributes.len() as u32;
+        for attr in XmlAttributes::new(attributes) {
+            let (key, raw) = attr?;
+            let value = decode_entities(raw);
+            if key == "xmlns" {
+                node.namespace_uri = self.intern(&value)?;
+            } else if let Some(prefix) = key.strip_prefix("xmlns:") {
+                self.namespaces
+                    .insert(prefix.to_string(), value.into_owned());
             } else {
-                // Opening tag
-                let (tag_name, attributes, self_closing) = parse_start_tag(&mut chars);
-
-                let mut new_node = XmlNode {
-                    node_type: XmlNodeType::Element,
-                    name: tag_name,
-                    parent: current_parent,
-                    ..Default::default()
+                let attr = XmlAttribute {
+                    name: self.intern(key)?,
+                    value: self.intern(&value)?,
                 };
+                self.attributes.push(attr);
+            }
+        }
+        node.attributes = (first, self.attributes.len() as u32 - first);
+        self.link(parent, node)
+    }
 
-                // Parse attributes
-                for (key, mut value) in attributes {
-                    // Append null terminator for C string compatibility
-                    value.push('\0');
-
-                    if key.starts_with("xmlns") {
-                        // Namespace declaration
-                        if key == "xmlns" {
-                            new_node.namespace_uri = value;
-                        } else if let Some(prefix) = key.strip_prefix("xmlns:") {
-                            doc.namespaces.insert(prefix.to_string(), value);
-                        }
-                    } else {
-                        new_node.attributes.insert(key, value);
-                    }
-                }
+    fn push_text(&mut self, parent: u32, text: &str) -> Result<u32> {
+        let mut node = XmlNode::new(XmlNodeType::Text, parent);
+        node.content = self.intern(text)?;
+        self.link(parent, node)
+    }
 
-                let new_handle = XML_NODES.insert(new_node);
-                doc.nodes.push(new_handle);
-
-                // Link to parent
-                if let Some(parent_node) = XML_NODES.get(current_parent) {
-                    if let Ok(mut guard) = parent_node.lock() {
-                        // Update sibling links
-                        if let Some(&prev_sibling) = guard.children.last() {
-                            if let Some(prev) = XML_NODES.get(prev_sibling) {
-                                if let Ok(mut prev_guard) = prev.lock() {
-                                    prev_guard.next = new_handle;
-                                }
-                            }
-                            if let Some(new) = XML_NODES.get(new_handle) {
-                                if let Ok(mut new_guard) = new.lock() {
-                                    new_guard.prev = prev_sibling;
-                                }
-                            }
-                        }
-                        guard.children.push(new_handle);
-                    }
-                }
+    /// Pick version, encoding and standalone out of `<?xml ...?>`
+    fn read_declaration(&mut self, body: &str) {
+        for (key, value) in XmlAttributes::new(body).map_while(Result::ok) {
+            match key {
+                "version" => self.version = value.to_string(),
+                "encoding" => self.encoding = value.to_string(),
+                "standalone" => self.standalone = value == "yes",
+                _ => {}
+            }
+        }
+    }
+}
 
-                if !self_closing {
-                    current_parent = new_handle;
-                }
+// ============================================================================
+// Tokenizer
+// ============================================================================
+
+/// One piece of markup or character data
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum XmlToken<'a> {
+    /// Start tag; `attributes` is the raw text after the name
+    Start {
+        name: &'a str,
+        attributes: &'a str,
+        empty: bool,
+    },
+    /// End tag
+    End { name: &'a str },
+    /// Character data, entities still encoded
+    Text(&'a str),
+    /// Contents of a CDATA section
+    CData(&'a str),
+    /// Comment body
+    Comment(&'a str),
+    /// Processing instruction body, target included
+    Pi(&'a str),
+    /// `<!DOCTYPE ...>` and other declarations
+    Declaration(&'a str),
+}
+
+/// Pull tokenizer over a document held in memory
+///
+/// Tokens borrow from the input, so nothing is copied until a builder
+/// decides to keep it. After an error the iterator is exhausted.
+pub struct XmlTokenizer<'a> {
+    input: &'a str,
+    pos: usize,
+}
+
+impl<'a> XmlTokenizer<'a> {
+    /// Tokenize `input` from the start
+    pub fn new(input: &'a str) -> Self {
+        Self { input, pos: 0 }
+    }
+
+    /// Byte offset of the next token
+    pub fn position(&self) -> usize {
+        self.pos
+    }
+
+    fn next_token(&mut self) -> Result<XmlToken<'a>> {
+        let bytes = self.input.as_bytes();
+        let at = self.pos;
+        if bytes[at] != b'<' {
+            let n = scan_until_any(&bytes[at..], b"<");
+            self.pos = at + n;
+            return Ok(XmlToken::Text(&self.input[at..at + n]));
+        }
+
+        let rest = &bytes[at..];
+        if rest.starts_with(b"<!--") {
+            self.delimited(4, "-->", "comment").map(XmlToken::Comment)
+        } else if rest.starts_with(b"<![CDATA[") {
+            self.delimited(9, "]]>", "CDATA section")
+                .map(XmlToken::CData)
+        } else if rest.starts_with(b"<?") {
+            self.delimited(2, "?>", "processing instruction")
+                .map(XmlToken::Pi)
+        } else if rest.starts_with(b"<!") {
+            // An internal DTD subset may hold '>' of its own
+            let mut end = at + 2;
+            end += scan_until_any(&bytes[end..], b"[>");
+            if bytes.get(end) == Some(&b'[') {
+                end +=
+                    find_bytes(&bytes[end..], b"]").ok_or_else(|| self.unterminated("DOCTYPE"))?;
+                end += scan_until_any(&bytes[end..], b">");
+            }
+            if end >= bytes.len() {
+                return Err(self.unterminated("declaration"));
+            }
+            self.pos = end + 1;
+            Ok(XmlToken::Declaration(&self.input[at + 2..end]))
+        } else if rest.starts_with(b"</") {
+            let end = at + 2 + scan_until_any(&rest[2..], b">");
+            if end >= bytes.len() {
+                return Err(self.unterminated("end tag"));
             }
+            self.pos = end + 1;
+            Ok(XmlToken::End {
+                name: self.input[at + 2..end].trim_end_matches(is_xml_space),
+            })
         } else {
-            // Text content
-            let text = read_until_char(&mut chars, '<');
-            let trimmed = text.trim();
-
-            if !trimmed.is_empty() {
-                let text_node = XmlNode {
-                    node_type: XmlNodeType::Text,
-                    content: trimmed.to_string(),
-                    parent: current_parent,
-                    ..Default::default()
-                };
-                let text_handle = XML_NODES.insert(text_node);
-                doc.nodes.push(text_handle);
+            self.start_tag()
+        }
+    }
 
-                if let Some(parent_node) = XML_NODES.get(current_parent) {
-                    if let Ok(mut guard) = parent_node.lock() {
-                        guard.children.push(text_handle);
+    fn start_tag(&mut self) -> Result<XmlToken<'a>> {
+        let bytes = self.input.as_bytes();
+        let at = self.pos;
+        // '>' may appear inside quoted attribute values
+        let mut end = at + 1;
+        loop {
+            end += scan_until_any(&bytes[end..], b"\"'>");
+            match bytes.get(end) {
+                Some(b'>') => break,
+                Some(&quote) => {
+                    end += 1;
+                    end += scan_until_any(&bytes[end..], &[quote]);
+                    if end >= bytes.len() {
+                        return Err(self.unterminated("attribute value"));
                     }
+                    end += 1;
                 }
+                None => return Err(self.unterminated("start tag")),
             }
         }
+        self.pos = end + 1;
+
+        let body = &self.input[at + 1..end];
+        let (body, empty) = match body.strip_suffix('/') {
+            Some(body) => (body, true),
+            None => (body, false),
+        };
+        let name_len = body.find(is_xml_space).unwrap_or(body.len());
+        if name_len == 0 {
+            return Err(Error::syntax(format!("empty tag name at byte {at}")));
+        }
+        Ok(XmlToken::Start {
+            name: &body[..name_len],
+            attributes: &body[name_len..],
+            empty,
+        })
+    }
+
+    /// Body of a construct opened by `open` bytes and closed by `close`
+    fn delimited(&mut self, open: usize, close: &str, what: &str) -> Result<&'a str> {
+        let body = self.pos + open;
+        let n = find_bytes(&self.input.as_bytes()[body..], close.as_bytes())
+            .ok_or_else(|| self.unterminated(what))?;
+        self.pos = body + n + close.len();
+        Ok(&self.input[body..body + n])
+    }
+
+    fn unterminated(&self, what: &str) -> Error {
+        Error::syntax(format!("unterminated {what} at byte {}", self.pos))
+    }
+}
+
+impl<'a> Iterator for XmlTokenizer<'a> {
+    type Item = Result<XmlToken<'a>>;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        if self.pos >= self.input.len() {
+            return None;
+        }
+        let token = self.next_token();
+        if token.is_err() {
+            self.pos = self.input.len();
+        }
+        Some(token)
     }
+}
 
-    Some(XML_DOCS.insert(doc))
+/// Attributes of a start tag, as (name, raw value) pairs
+pub struct XmlAttributes<'a> {
+    rest: &'a str,
 }
 
-fn skip_whitespace(chars: &mut std::iter::Peekable<std::str::Chars>) {
-    while chars.peek().map(|c| c.is_whitespace()).unwrap_or(false) {
-        chars.next();
+impl<'a> XmlAttributes<'a> {
+    /// Iterate the attribute text of [`XmlToken::Start`]
+    pub fn new(attributes: &'a str) -> Self {
+        Self { rest: attributes }
     }
 }
 
-fn read_until(chars: &mut std::iter::Peekable<std::str::Chars>, end: char) -> String {
-    let mut result = String::new();
-    while let Some(&c) = chars.peek() {
-        chars.next();
-        if c == end {
-            break;
+impl<'a> Iterator for XmlAttributes<'a> {
+    type Item = Result<(&'a str, &'a str)>;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        loop {
+            let s = self.rest.trim_start_matches(is_xml_space);
+            if s.is_empty() {
+                return None;
+            }
+            let name_end = s.find(|c| c == '=' || is_xml_space(c)).unwrap_or(s.len());
+            let name = &s[..name_end];
+            let Some(after) = s[name_end..]
+                .trim_start_matches(is_xml_space)
+                .strip_prefix('=')
+            else {
+                // A bare name carries no value; skip it
+                self.rest = &s[name_end..];
+                continue;
+            };
+            let after = after.trim_start_matches(is_xml_space);
+            let value = after
+                .chars()
+                .next()
+                .filter(|&q| q == '"' || q == '\'')
+                .and_then(|q| after[1..].find(q));
+            let Some(close) = value else {
+                self.rest = "";
+                return Some(Err(Error::syntax(format!(
+                    "unquoted value for attribute '{name}'"
+                ))));
+            };
+            self.rest = &after[close + 2..];
+            return Some(Ok((name, &after[1..close + 1])));
         }
-        result.push(c);
     }
-    result
 }
 
-fn read_until_char(chars: &mut std::iter::Peekable<std::str::Chars>, end: char) -> String {
-    let mut result = String::new();
-    while let Some(&c) = chars.peek() {
-        if c == end {
-            break;
+fn is_xml_space(c: char) -> bool {
+    matches!(c, ' ' | '\t' | '\r' | '\n')
+}
+
+/// Replace character and predefined entity references
+///
+/// Unknown entities are kept as written. Text without a `&` is
+/// handed back borrowed.
+pub fn decode_entities(raw: &str) -> Cow<'_, str> {
+    let bytes = raw.as_bytes();
+    let mut amp = scan_until_any(bytes, b"&");
+    if amp == bytes.len() {
+        return Cow::Borrowed(raw);
+    }
+
+    let mut out = String::with_capacity(raw.len());
+    let mut done = 0;
+    while amp < bytes.len() {
+        out.push_str(&raw[done..amp]);
+        let rest = &raw[amp + 1..];
+        let decoded = rest
+            .find(';')
+            .filter(|&semi| semi <= 10)
+            .and_then(|semi| Some((entity_char(&rest[..semi])?, semi + 2)));
+        match decoded {
+            Some((ch, used)) => {
+                out.push(ch);
+                done = amp + used;
+            }
+            None => {
+                out.push('&');
+                done = amp + 1;
+            }
         }
-        chars.next();
-        result.push(c);
+        amp = done + scan_until_any(&bytes[done..], b"&");
     }
-    result
+    out.push_str(&raw[done..]);
+    Cow::Owned(out)
 }
 
-fn parse_start_tag(
-    chars: &mut std::iter::Peekable<std::str::Chars>,
-) -> (String, Vec<(String, String)>, bool) {
-    let mut tag_name = String::new();
-    let mut attributes = Vec::new();
-    let mut self_closing = false;
+fn entity_char(name: &str) -> Option<char> {
+    match name {
+        "lt" => Some('<'),
+        "gt" => Some('>'),
+        "amp" => Some('&'),
+        "quot" => Some('"'),
+        "apos" => Some('\''),
+        _ => {
+            let num = name.strip_prefix('#')?;
+            let code = match num.strip_prefix(['x', 'X']) {
+                Some(hex) => u32::from_str_radix(hex, 16).ok()?,
+                None => num.parse().ok()?,
+            };
+            char::from_u32(code)
+        }
+    }
+}
 
-    // Read tag name
-    while let Some(&c) = chars.peek() {
-        if c.is_whitespace() || c == '>' || c == '/' {
-            break;
+// ============================================================================
+// Tree Building
+// ============================================================================
+
+/// Element paths for a selective parse
+///
+/// A path lists tag names down from the root element, separated by `/`:
+/// `"CrossIndustryInvoice/ExchangedDocument/ID"`. A segment without a
+/// prefix matches the local name under any namespace prefix.
+#[derive(Debug, Clone, Default)]
+pub struct XmlSelect {
+    paths: Vec<Vec<String>>,
+    first_match: bool,
+}
+
+impl XmlSelect {
+    /// Build the subtrees at `paths`
+    pub fn new<S: AsRef<str>>(paths: &[S]) -> Self {
+        Self {
+            paths: paths
+                .iter()
+                .map(|p| {
+                    p.as_ref()
+                        .split('/')
+                        .filter(|s| !s.is_empty())
+                        .map(str::to_string)
+                        .collect()
+                })
+                .collect(),
+            first_match: false,
         }
-        chars.next();
-        tag_name.push(c);
     }
 
-    // Read attributes
-    loop {
-        skip_whitespace(chars);
+    /// Build only the first element at each path, and stop parsing once
+    /// all of them are complete
+    pub fn first_match(mut self) -> Self {
+        self.first_match = true;
+        self
+    }
+}
 
-        match chars.peek() {
-            Some(&'>') => {
-                chars.next();
-                break;
+fn segment_matches(segment: &str, name: &str) -> bool {
+    segment == name
+        || (!segment.contains(':')
+            && name
+                .split_once(':')
+                .is_some_and(|(_, local)| local == segment))
+}
+
+/// An element still waiting for its end tag
+struct OpenElement<'a> {
+    name: &'a str,
+    node: u32,
+    /// Inside a selected subtree: everything below is built
+    inside: bool,
+    /// The selected path this element completes
+    hit: Option<usize>,
+}
+
+/// How a selective parse treats a new element
+enum Selected {
+    /// Build it and everything below
+    Subtree(Option<usize>),
+    /// Build it as an ancestor of a selected path
+    Ancestor,
+    /// Skip its subtree
+    Skip,
+}
+
+fn classify(select: &XmlSelect, taken: &[bool], open: &[OpenElement], name: &str) -> Selected {
+    let depth = open.len() + 1;
+    let mut ancestor = false;
+    for (i, path) in select.paths.iter().enumerate() {
+        if taken[i] || path.len() < depth {
+            continue;
+        }
+        let on_path = open
+            .iter()
+            .map(|o| o.name)
+            .chain([name])
+            .zip(path)
+            .all(|(n, s)| segment_matches(s, n));
+        if !on_path {
+            continue;
+        }
+        if path.len() == depth {
+            return Selected::Subtree(Some(i));
+        }
+        ancestor = true;
+    }
+    if ancestor {
+        Selected::Ancestor
+    } else {
+        Selected::Skip
+    }
+}
+
+fn build(xml: &str, preserve_whitespace: bool, select: Option<&XmlSelect>) -> Result<XmlDocument> {
+    let mut doc = XmlDocument::default();
+    let mut open: Vec<OpenElement> = Vec::new();
+    // Depth inside a subtree that isn't being built
+    let mut skip = 0usize;
+    // Selected paths already found, when building first matches only
+    let mut taken = vec![false; select.map_or(0, |s| s.paths.len())];
+    let first_match = select.is_some_and(|s| s.first_match);
+
+    for token in XmlTokenizer::new(xml) {
+        let token = token?;
+        if skip > 0 {
+            match token {
+                XmlToken::Start { empty: false, .. } => skip += 1,
+                XmlToken::End { .. } => skip -= 1,
+                _ => {}
+            }
+            continue;
+        }
+
+        let (parent, inside) = open
+            .last()
+            .map_or((0, select.is_none()), |o| (o.node, o.inside));
+        match token {
+            XmlToken::Start {
+                name,
+                attributes,
+                empty,
+            } => {
+                let selected = match select {
+                    Some(s) if !inside => classify(s, &taken, &open, name),
+                    _ => Selected::Subtree(None),
+                };
+                let (inside, hit) = match selected {
+                    Selected::Subtree(hit) => (true, hit),
+                    Selected::Ancestor => (false, None),
+                    Selected::Skip => {
+                        skip = usize::from(!empty);
+                        continue;
+                    }
+                };
+                if let Some(i) = hit.filter(|_| first_match) {
+                    taken[i] = true;
+                }
+                let node = doc.push_element(parent, name, attributes)?;
+                if !empty {
+                    open.push(OpenElement {
+                        name,
+                        node,
+                        inside,
+                        hit,
+                    });
+                }
             }
-            Some(&'/') => {
-                chars.next();
-                if chars.peek() == Some(&'>') {
-                    chars.next();
-                    self_closing = true;
+            XmlToken::End { name } => {
+                // Close up to the matching element; a stray end tag is ignored
+                if let Some(at) = open.iter().rposition(|o| o.name == name) {
+                    open.truncate(at);
                 }
-                break;
             }
-            Some(_) => {
-                // Read attribute name
-                let attr_name = read_until_chars(chars, &['=', '>', '/', ' ']);
-                skip_whitespace(chars);
-
-                if chars.peek() == Some(&'=') {
-                    chars.next();
-                    skip_whitespace(chars);
-
-                    // Read attribute value
-                    let quote = chars.next().unwrap_or('"');
-                    let attr_value = read_until(chars, quote);
-                    attributes.push((attr_name, attr_value));
+            XmlToken::Text(raw) if inside => {
+                let text = decode_entities(raw);
+                let text = if preserve_whitespace {
+                    &text[..]
+                } else {
+                    text.trim_matches(is_xml_space)
+                };
+                if !text.is_empty() {
+                    doc.push_text(parent, text)?;
                 }
             }
-            None => break,
+            XmlToken::CData(raw) if inside && !raw.is_empty() => {
+                doc.push_text(parent, raw)?;
+            }
+            XmlToken::Pi(body) if doc.is_empty() => {
+                if let Some(decl) = body
+                    .strip_prefix("xml")
+                    .filter(|d| d.starts_with(is_xml_space))
+                {
+                    doc.read_declaration(decl);
+                }
+            }
+            _ => {}
+        }
+
+        // Every path found and closed: the rest of the input can't matter
+        if first_match && taken.iter().all(|&t| t) && !open.iter().any(|o| o.hit.is_some()) {
+            break;
         }
     }
+    Ok(doc)
+}
+
+// ============================================================================
+// Handles
+// ============================================================================
+
+/// Global XML document storage
+pub static XML_DOCS: LazyLock<HandleStore<XmlDocument>> = LazyLock::new(HandleStore::new);
 
-    (tag_name, attributes, self_closing)
+/// Handle for node `index` of document `doc`
+fn node_handle(doc: Handle, index: u32) -> Handle {
+    if index == NO_NODE {
+        return 0;
+    }
+    (doc << XML_NODE_BITS) | Handle::from(index)
 }
 
-fn read_until_chars(chars: &mut std::iter::Peekable<std::str::Chars>, ends: &[char]) -> String {
-    let mut result = String::new();
-    while let Some(&c) = chars.peek() {
-        if ends.contains(&c) {
-            break;
+/// Run `f` on the document and index a node handle refers to
+fn with_node<T>(node: Handle, missing: T, f: impl FnOnce(Handle, &XmlDocument, u32) -> T) -> T {
+    let (doc, index) = (node >> XML_NODE_BITS, (node & XML_NODE_MASK) as u32);
+    let Some(d) = XML_DOCS.get(doc) else {
+        return missing;
+    };
+    let Ok(guard) = d.lock() else {
+        return missing;
+    };
+    if index as usize >= guard.nodes.len() {
+        return missing;
+    }
+    f(doc, &guard, index)
+}
+
+/// Handle of the node `pick` links to from `node`
+fn linked(node: Handle, pick: impl FnOnce(&XmlNode) -> u32) -> Handle {
+    with_node(node, 0, |doc, d, i| {
+        node_handle(doc, pick(&d.nodes[i as usize]))
+    })
+}
+
+fn insert_document(doc: Result<XmlDocument>) -> Handle {
+    doc.map_or(0, |doc| XML_DOCS.insert(doc))
+}
+
+// ============================================================================
+// Document Creation and Parsing
+// ============================================================================
+
+/// Create a new empty XML document
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_new_xml_document(_ctx: Handle) -> Handle {
+    XML_DOCS.insert(XmlDocument::default())
+}
+
+/// Parse XML from string
+///
+/// # Safety
+/// `xml_string` must be a valid null-terminated UTF-8 string.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_parse_xml(
+    _ctx: Handle,
+    xml_string: *const c_char,
+    preserve_whitespace: i32,
+) -> Handle {
+    if xml_string.is_null() {
+        return 0;
+    }
+
+    let xml_str = unsafe { CStr::from_ptr(xml_string) };
+    let xml = match xml_str.to_str() {
+        Ok(s) => s,
+        Err(_) => return 0,
+    };
+
+    insert_document(XmlDocument::parse(xml, preserve_whitespace != 0))
+}
+
+/// Parse XML from buffer
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_parse_xml_from_buffer(
+    _ctx: Handle,
+    buffer: Handle,
+    preserve_whitespace: i32,
+) -> Handle {
+    if let Some(buf) = super::BUFFERS.get(buffer) {
+        if let Ok(guard) = buf.lock() {
+            if let Ok(xml_str) = std::str::from_utf8(guard.data()) {
+                return insert_document(XmlDocument::parse(xml_str, preserve_whitespace != 0));
+            }
+        }
+    }
+    0
+}
+
+/// Parse only the elements at `paths` from a string
+///
+/// Each path runs from the root element, e.g. `"Invoice/Header/ID"`;
+/// unprefixed segments match any namespace prefix. The selected
+/// elements are built with their ancestors and everything below them;
+/// all else is skipped. With `first_match` set, only the first element
+/// at each path is built and parsing stops once all are complete.
+///
+/// # Safety
+/// `xml_string` must be a valid null-terminated UTF-8 string and
+/// `paths` must point to `path_count` null-terminated strings.
+#[unsafe(no_mangle)]
+pub extern "C" fn fz_parse_xml_subtrees(
+    _ctx: Handle,
+    xml_string: *const c_char,
+    paths: *const *const c_char,
+    path_count: i32,
+    preserve_whitespace: i32,
+    first_match: i32,
+) -> Handle {
+    if xml_string.is_null() || paths.is_null() || path_count <= 0 {
+        return 0;
+    }
+
+    let Ok(xml) = unsafe { CStr::from_ptr(xml_string) }.to_str() else {
+        return 0;
+    };
+    let paths = unsafe { std::slice::from_raw_parts(paths, path_count as usize) };
+    let mut wanted = Vec::with_capacity(paths.len());
+    for &path in paths {
+        if path.is_null() {
+            return 0;
+        }
+        match unsafe { CStr::from_ptr(path) }.to_str() {
+            Ok(p) => wanted.push(p),
+            Err(_) => return 0,
         }
-        chars.next();
-        result.push(c);
     }
-    result
+
+    let mut select = XmlSelect::new(&wanted);
+    if first_match != 0 {
+        select = select.first_match();
+    }
+    insert_document(XmlDocument::parse_selected(
+        xml,
+        preserve_whitespace != 0,
+        &select,
+    ))
 }
 
 // ============================================================================
@@ -394,12 +924,7 @@ fn read_until_chars(chars: &mut std::iter::Peekable<std::str::Chars>, ends: &[ch
 pub extern "C" fn fz_xml_root(_ctx: Handle, doc: Handle) -> Handle {
     if let Some(d) = XML_DOCS.get(doc) {
         if let Ok(guard) = d.lock() {
-            // Return first child of document node
-            if let Some(root) = XML_NODES.get(guard.root) {
-                if let Ok(root_guard) = root.lock() {
-                    return root_guard.children.first().copied().unwrap_or(0);
-                }
-            }
+            return guard.root().map_or(0, |root| node_handle(doc, root));
         }
     }
     0
@@ -408,45 +933,25 @@ pub extern "C" fn fz_xml_root(_ctx: Handle, doc: Handle) -> Handle {
 /// Get first child element
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_xml_down(_ctx: Handle, node: Handle) -> Handle {
-    if let Some(n) = XML_NODES.get(node) {
-        if let Ok(guard) = n.lock() {
-            return guard.children.first().copied().unwrap_or(0);
-        }
-    }
-    0
+    linked(node, |n| n.first_child)
 }
 
 /// Get next sibling element
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_xml_next(_ctx: Handle, node: Handle) -> Handle {
-    if let Some(n) = XML_NODES.get(node) {
-        if let Ok(guard) = n.lock() {
-            return guard.next;
-        }
-    }
-    0
+    linked(node, |n| n.next)
 }
 
 /// Get previous sibling element
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_xml_prev(_ctx: Handle, node: Handle) -> Handle {
-    if let Some(n) = XML_NODES.get(node) {
-        if let Ok(guard) = n.lock() {
-            return guard.prev;
-        }
-    }
-    0
+    linked(node, |n| n.prev)
 }
 
 /// Get parent element
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_xml_up(_ctx: Handle, node: Handle) -> Handle {
-    if let Some(n) = XML_NODES.get(node) {
-        if let Ok(guard) = n.lock() {
-            return guard.parent;
-        }
-    }
-    0
+    linked(node, |n| n.parent)
 }
 
 // ============================================================================
@@ -456,16 +961,9 @@ pub extern "C" fn fz_xml_up(_ctx: Handle, node: Handle) -> Handle {
 /// Get node tag name
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_xml_tag(_ctx: Handle, node: Handle) -> *const c_char {
-    static EMPTY: &[u8] = b"\0";
-
-    if let Some(n) = XML_NODES.get(node) {
-        if let Ok(guard) = n.lock() {
-            if !guard.name.is_empty() {
-                return guard.name.as_ptr().cast();
-            }
-        }
-    }
-    EMPTY.as_ptr().cast()
+    with_node(node, EMPTY.as_ptr().cast(), |_, d, i| {
+        d.span_ptr(d.nodes[i as usize].name)
+    })
 }
 
 /// Check if node has specific tag
@@ -478,27 +976,20 @@ pub extern "C" fn fz_xml_is_tag(_ctx: Handle, node: Handle, tag: *const c_char)
     let tag_str = unsafe { CStr::from_ptr(tag) };
     let tag_name = tag_str.to_str().unwrap_or("");
 
-    if let Some(n) = XML_NODES.get(node) {
-        if let Ok(guard) = n.lock() {
-            return i32::from(guard.name == tag_name);
-        }
-    }
-    0
+    with_node(node, 0, |_, d, i| i32::from(d.name(i) == tag_name))
 }
 
 /// Get node text content
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_xml_text(_ctx: Handle, node: Handle) -> *const c_char {
-    static EMPTY: &[u8] = b"\0";
-
-    if let Some(n) = XML_NODES.get(node) {
-        if let Ok(guard) = n.lock() {
-            if guard.node_type == XmlNodeType::Text && !guard.content.is_empty() {
-                return guard.content.as_ptr().cast();
-            }
+    with_node(node, EMPTY.as_ptr().cast(), |_, d, i| {
+        let n = &d.nodes[i as usize];
+        if n.node_type == XmlNodeType::Text {
+            d.span_ptr(n.content)
+        } else {
+            EMPTY.as_ptr().cast()
         }
-    }
-    EMPTY.as_ptr().cast()
+    })
 }
 
 /// Get attribute value
@@ -511,47 +1002,30 @@ pub extern "C" fn fz_xml_att(_ctx: Handle, node: Handle, name: *const c_char) ->
     let name_str = unsafe { CStr::from_ptr(name) };
     let attr_name = name_str.to_str().unwrap_or("");
 
-    if let Some(n) = XML_NODES.get(node) {
-        if let Ok(guard) = n.lock() {
-            if let Some(value) = guard.attributes.get(attr_name) {
-                return value.as_ptr().cast();
-            }
-        }
-    }
-    std::ptr::null()
+    with_node(node, std::ptr::null(), |_, d, i| {
+        d.attribute_list(&d.nodes[i as usize])
+            .iter()
+            .find(|a| d.span(a.name) == attr_name)
+            .map_or(std::ptr::null(), |a| d.span_ptr(a.value))
+    })
 }
 
 /// Get attribute count
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_xml_att_count(_ctx: Handle, node: Handle) -> i32 {
-    if let Some(n) = XML_NODES.get(node) {
-        if let Ok(guard) = n.lock() {
-            return guard.attributes.len() as i32;
-        }
-    }
-    0
+    with_node(node, 0, |_, d, i| d.nodes[i as usize].attributes.1 as i32)
 }
 
 /// Get child count
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_xml_child_count(_ctx: Handle, node: Handle) -> i32 {
-    if let Some(n) = XML_NODES.get(node) {
-        if let Ok(guard) = n.lock() {
-            return guard.children.len() as i32;
-        }
-    }
-    0
+    with_node(node, 0, |_, d, i| d.nodes[i as usize].child_count as i32)
 }
 
 /// Get node type
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_xml_node_type(_ctx: Handle, node: Handle) -> i32 {
-    if let Some(n) = XML_NODES.get(node) {
-        if let Ok(guard) = n.lock() {
-            return guard.node_type as i32;
-        }
-    }
-    -1
+    with_node(node, -1, |_, d, i| d.nodes[i as usize].node_type as i32)
 }
 
 // ============================================================================
@@ -568,36 +1042,9 @@ pub extern "C" fn fz_xml_find(_ctx: Handle, node: Handle, path: *const c_char) -
     let path_str = unsafe { CStr::from_ptr(path) };
     let xpath = path_str.to_str().unwrap_or("");
 
-    let mut current = node;
-    for segment in xpath.split('/') {
-        if segment.is_empty() {
-            continue;
-        }
-
-        current = find_child_by_tag(current, segment);
-        if current == 0 {
-            return 0;
-        }
-    }
-
-    current
-}
-
-fn find_child_by_tag(parent: Handle, tag: &str) -> Handle {
-    if let Some(n) = XML_NODES.get(parent) {
-        if let Ok(guard) = n.lock() {
-            for &child in &guard.children {
-                if let Some(child_node) = XML_NODES.get(child) {
-                    if let Ok(child_guard) = child_node.lock() {
-                        if child_guard.name == tag {
-                            return child;
-                        }
-                    }
-                }
-            }
-        }
-    }
-    0
+    with_node(node, 0, |doc, d, i| {
+        d.find(i, xpath).map_or(0, |found| node_handle(doc, found))
+    })
 }
 
 /// Find all elements matching tag
@@ -615,33 +1062,30 @@ pub extern "C" fn fz_xml_find_all(
 
     let tag_str = unsafe { CStr::from_ptr(tag) };
     let tag_name = tag_str.to_str().unwrap_or("");
-
-    let mut found = Vec::new();
-    find_all_recursive(node, tag_name, &mut found, max_results as usize);
-
-    let count = found.len().min(max_results as usize);
-    let result_slice = unsafe { std::slice::from_raw_parts_mut(results, count) };
-    result_slice.copy_from_slice(&found[..count]);
-
-    count as i32
-}
-
-fn find_all_recursive(node: Handle, tag: &str, results: &mut Vec<Handle>, max: usize) {
-    if results.len() >= max {
-        return;
-    }
-
-    if let Some(n) = XML_NODES.get(node) {
-        if let Ok(guard) = n.lock() {
-            if guard.name == tag {
-                results.push(node);
+    let max = max_results as usize;
+
+    let found = with_node(node, Vec::new(), |doc, d, i| {
+        // Pre-order walk, the starting node included
+        let mut found = Vec::new();
+        let mut stack = vec![i];
+        while let Some(at) = stack.pop() {
+            if found.len() >= max {
+                break;
             }
-
-            for &child in &guard.children {
-                find_all_recursive(child, tag, results, max);
+            if d.name(at) == tag_name {
+                found.push(node_handle(doc, at));
             }
+            let first = stack.len();
+            stack.extend(d.children(at));
+            stack[first..].reverse();
         }
-    }
+        found
+    });
+
+    let result_slice = unsafe { std::slice::from_raw_parts_mut(results, found.len()) };
+    result_slice.copy_from_slice(&found);
+
+    found.len() as i32
 }
 
 // ============================================================================
@@ -649,16 +1093,10 @@ fn find_all_recursive(node: Handle, tag: &str, results: &mut Vec<Handle>, max: u
 // ============================================================================
 
 /// Drop XML document
+///
+/// Its node handles die with it.
 #[unsafe(no_mangle)]
 pub extern "C" fn fz_drop_xml(_ctx: Handle, doc: Handle) {
-    if let Some(d) = XML_DOCS.get(doc) {
-        if let Ok(guard) = d.lock() {
-            // Drop all nodes
-            for &node in &guard.nodes {
-                XML_NODES.remove(node);
-            }
-        }
-    }
     XML_DOCS.remove(doc);
 }
 
@@ -737,4 +1175,154 @@ mod tests {
 
         fz_drop_xml(0, doc);
     }
+
+    #[test]
+    fn test_xml_strings_are_terminated() {
+        let xml = c"<root><child>text</child><other/></root>";
+        let doc = fz_parse_xml(0, xml.as_ptr(), 0);
+        let child = fz_xml_down(0, fz_xml_root(0, doc));
+
+        let tag = unsafe { CStr::from_ptr(fz_xml_tag(0, child)) };
+        assert_eq!(tag.to_str().unwrap(), "child");
+        let text = unsafe { CStr::from_ptr(fz_xml_text(0, fz_xml_down(0, child))) };
+        assert_eq!(text.to_str().unwrap(), "text");
+        assert_eq!(
+            fz_xml_node_type(0, fz_xml_down(0, child)),
+            XmlNodeType::Text as i32
+        );
+
+        // Node handles die with their document
+        fz_drop_xml(0, doc);
+        assert_eq!(fz_xml_node_type(0, child), -1);
+        assert_eq!(fz_xml_down(0, child), 0);
+    }
+
+    #[test]
+    fn test_xml_entities_cdata_and_comments() {
+        let xml = "<?xml version=\"1.1\" encoding=\"ISO-8859-1\"?>\n\
+                   <!DOCTYPE r [<!ENTITY x \"y\">]>\n\
+                   <r a=\"x &amp; &#x41;&#66; &bogus;\" b='q>\"'>1 &lt; 2<![CDATA[<raw> &amp;]]><!-- <not/> --></r>";
+        let doc = XmlDocument::parse(xml, false).unwrap();
+        assert_eq!(doc.version, "1.1");
+        assert_eq!(doc.encoding, "ISO-8859-1");
+
+        let r = doc.root().unwrap();
+        assert_eq!(doc.name(r), "r");
+        assert_eq!(doc.attribute(r, "a"), Some("x & AB &bogus;"));
+        assert_eq!(doc.attribute(r, "b"), Some("q>\""));
+        let texts: Vec<&str> = doc.children(r).map(|c| doc.text(c)).collect();
+        assert_eq!(texts, ["1 < 2", "<raw> &amp;"]);
+    }
+
+    #[test]
+    fn test_xml_preserve_whitespace() {
+        let xml = c"<r> <a/>\n x </r>";
+        let doc = fz_parse_xml(0, xml.as_ptr(), 0);
+        assert_eq!(fz_xml_child_count(0, fz_xml_root(0, doc)), 2);
+        fz_drop_xml(0, doc);
+
+        let doc = XmlDocument::parse("<r> <a/>\n x </r>", true).unwrap();
+        let r = doc.root().unwrap();
+        let texts: Vec<&str> = doc.children(r).map(|c| doc.text(c)).collect();
+        assert_eq!(texts, [" ", "", "\n x "]);
+    }
+
+    #[test]
+    fn test_xml_tokenizer() {
+        let tokens: Vec<XmlToken> = XmlTokenizer::new("<a x='1'>hi<b/></a >")
+            .collect::<Result<_>>()
+            .unwrap();
+        assert_eq!(
+            tokens,
+            [
+                XmlToken::Start {
+                    name: "a",
+                    attributes: " x='1'",
+                    empty: false
+                },
+                XmlToken::Text("hi"),
+                XmlToken::Start {
+                    name: "b",
+                    attributes: "",
+                    empty: true
+                },
+                XmlToken::End { name: "a" },
+            ]
+        );
+
+        for bad in ["<a", "<a x='1>", "<!-- open", "<![CDATA[x", "<>"] {
+            assert!(XmlDocument::parse(bad, false).is_err(), "{bad}");
+        }
+        let bad = std::ffi::CString::new("<root><!-- open").unwrap();
+        assert_eq!(fz_parse_xml(0, bad.as_ptr(), 0), 0);
+    }
+
+    #[test]
+    fn test_xml_long_text_crosses_vectors() {
+        let body = "word ".repeat(1000);
+        let xml = format!("<r t=\"{body}\">{body}&amp;{body}</r>");
+        let doc = XmlDocument::parse(&xml, true).unwrap();
+        let r = doc.root().unwrap();
+        assert_eq!(doc.attribute(r, "t"), Some(&body[..]));
+        let text = doc.text(doc.children(r).next().unwrap());
+        assert_eq!(text, format!("{body}&{body}"));
+    }
+
+    #[test]
+    fn test_xml_subtrees() {
+        let mut xml = String::from(
+            "<rsm:Invoice xmlns:rsm=\"urn:x\"><rsm:Header><ram:ID>INV-1</ram:ID>\
+             <ram:Note>n</ram:Note></rsm:Header>",
+        );
+        for i in 0..100 {
+            xml.push_str(&format!("<rsm:Line><ram:ID>{i}</ram:ID></rsm:Line>"));
+        }
+        xml.push_str("<rsm:Trailer><ram:Sum>9</ram:Sum></rsm:Trailer></rsm:Invoice>");
+
+        let doc = XmlDocument::parse_selected(
+            &xml,
+            false,
+            &XmlSelect::new(&["Invoice/Header/ID", "Invoice/Trailer"]),
+        )
+        .unwrap();
+        let root = doc.root().unwrap();
+        assert_eq!(doc.name(root), "rsm:Invoice");
+        assert_eq!(doc.namespaces.get("rsm").map(String::as_str), Some("urn:x"));
+        let names: Vec<&str> = doc.children(root).map(|c| doc.name(c)).collect();
+        assert_eq!(names, ["rsm:Header", "rsm:Trailer"]);
+        // The header is an ancestor only: its other children are skipped
+        let id = doc.find(root, "rsm:Header/ram:ID").unwrap();
+        assert_eq!(doc.text(doc.children(id).next().unwrap()), "INV-1");
+        assert!(doc.find(root, "rsm:Header/ram:Note").is_none());
+        assert!(doc.find(root, "rsm:Trailer/ram:Sum").is_some());
+        assert!(doc.len() < 10);
+
+        // First matches only: parsing stops after the header
+        let select = XmlSelect::new(&["Invoice/Header/ID", "Invoice/Line/ID"]).first_match();
+        let truncated = format!("{}<rsm:Line", &xml[..xml.find("</rsm:Line>").unwrap()]);
+        let doc = XmlDocument::parse_selected(&truncated, false, &select).unwrap();
+        let root = doc.root().unwrap();
+        assert_eq!(doc.children(root).count(), 2);
+        let line_id = doc.find(root, "rsm:Line/ram:ID").unwrap();
+        assert_eq!(doc.text(doc.children(line_id).next().unwrap()), "0");
+    }
+
+    #[test]
+    fn test_ffi_parse_xml_subtrees() {
+        let xml = c"<a><b><c>1</c></b><d><c>2</c></d></a>";
+        let paths = [c"a/d".as_ptr()];
+        let doc = fz_parse_xml_subtrees(0, xml.as_ptr(), paths.as_ptr(), 1, 0, 0);
+        assert!(doc > 0);
+        let root = fz_xml_root(0, doc);
+        assert_eq!(fz_xml_child_count(0, root), 1);
+        let c = fz_xml_find(0, root, c"d/c".as_ptr());
+        assert!(c > 0);
+        assert_eq!(fz_xml_up(0, fz_xml_up(0, c)), root);
+        fz_drop_xml(0, doc);
+
+        assert_eq!(
+            fz_parse_xml_subtrees(0, xml.as_ptr(), paths.as_ptr(), 0, 0, 0),
+            0
+        );
+    }
 }
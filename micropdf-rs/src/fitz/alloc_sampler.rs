@@ -0,0 +1,305 @@
+//! Sampling allocation profiler
+//!
+//! Attributes the memory the library allocates to the subsystem that asked
+//! for it (store, glyph cache, xref, pixmap, font, decode buffers), cheaply
+//! enough to leave on in a release build. Allocation sites report their
+//! sizes with `record`; about one allocation per `set_interval` bytes is
+//! sampled, and each sample is weighted to stand for the bytes around it,
+//! so the totals estimate what was allocated without counting every byte.
+//!
+//! Sampling is a Poisson process over the bytes allocated: the distance to
+//! the next sample is drawn from an exponential distribution, so periodic
+//! allocation patterns cannot alias with it, and an allocation of `s` bytes
+//! taken with probability `1 - exp(-s / interval)` weighs
+//! `s / (1 - exp(-s / interval))`.
+//!
+//! Subsystems nest through `scope`: a pixmap allocated while a glyph is
+//! rendered is filed under `glyph_cache;pixmap`. `folded` renders the
+//! samples as folded stacks for `flamegraph.pl` or inferno, optionally
+//! extended with the call stack of each sampled allocation.
+
+use std::cell::{Cell, RefCell};
+use std::collections::HashMap;
+use std::fmt::Write;
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::{LazyLock, Mutex};
+
+/// Subsystem an allocation is charged to
+#[repr(C)]
+#[derive(Debug, Clone, Copy, PartialEq, Eq, Hash)]
+pub enum Subsystem {
+    /// Resource store bookkeeping
+    Store = 0,
+    /// Glyph rendering and the glyph atlas
+    GlyphCache = 1,
+    /// Cross-reference sections
+    Xref = 2,
+    /// Pixmap samples
+    Pixmap = 3,
+    /// Font programs
+    Font = 4,
+    /// Decoded stream and image data
+    Decode = 5,
+}
+
+/// Number of subsystems
+pub const SUBSYSTEM_COUNT: usize = Subsystem::Decode as usize + 1;
+
+impl Subsystem {
+    /// Frame name in folded stacks
+    pub fn name(self) -> &'static str {
+        match self {
+            Subsystem::Store => "store",
+            Subsystem::GlyphCache => "glyph_cache",
+            Subsystem::Xref => "xref",
+            Subsystem::Pixmap => "pixmap",
+            Subsystem::Font => "font",
+            Subsystem::Decode => "decode",
+        }
+    }
+
+    /// Subsystem from its `repr(C)` value
+    pub fn from_i32(value: i32) -> Option<Self> {
+        Some(match value {
+            0 => Subsystem::Store,
+            1 => Subsystem::GlyphCache,
+            2 => Subsystem::Xref,
+            3 => Subsystem::Pixmap,
+            4 => Subsystem::Font,
+            5 => Subsystem::Decode,
+            _ => return None,
+        })
+    }
+}
+
+/// Mean bytes between samples; 0 when sampling is off
+static INTERVAL: AtomicU64 = AtomicU64::new(0);
+/// Whether samples carry the allocating call stack
+static CAPTURE_STACKS: AtomicBool = AtomicBool::new(false);
+
+#[derive(Default)]
+struct Samples {
+    /// Folded stack -> (samples, estimated bytes)
+    stacks: HashMap<String, (u64, u64)>,
+    /// Estimated bytes per subsystem, by `Subsystem as usize`
+    by_subsystem: [u64; SUBSYSTEM_COUNT],
+    count: u64,
+}
+
+static SAMPLES: LazyLock<Mutex<Samples>> = LazyLock::new(|| Mutex::new(Samples::default()));
+
+thread_local! {
+    /// Interval the countdown was drawn for, and bytes left until a sample
+    static COUNTDOWN: Cell<(u64, u64)> = const { Cell::new((0, 0)) };
+    static RNG: Cell<u64> = Cell::new(seed());
+    /// Enclosing subsystems, outermost first
+    static SCOPES: RefCell<Vec<Subsystem>> = const { RefCell::new(Vec::new()) };
+}
+
+fn seed() -> u64 {
+    let local = 0u8;
+    let addr = &local as *const u8 as u64;
+    (addr ^ 0x9e37_79b9_7f4a_7c15).max(1)
+}
+
+/// Bytes until the next sample, exponentially distributed around `interval`
+fn next_distance(interval: u64) -> u64 {
+    let bits = RNG.with(|rng| {
+        // xorshift64*
+        let mut x = rng.get();
+        x ^= x >> 12;
+        x ^= x << 25;
+        x ^= x >> 27;
+        rng.set(x);
+        x.wrapping_mul(0x2545_f491_4f6c_dd1d)
+    });
+    // Uniform in (0, 1]
+    let u = ((bits >> 11) as f64 + 1.0) / (1u64 << 53) as f64;
+    (-u.ln() * interval as f64).max(1.0) as u64
+}
+
+/// Sample about one allocation per `bytes` allocated; 0 turns sampling off
+pub fn set_interval(bytes: u64) {
+    INTERVAL.store(bytes, Ordering::Relaxed);
+}
+
+/// Current sampling interval in bytes, 0 when off
+pub fn interval() -> u64 {
+    INTERVAL.load(Ordering::Relaxed)
+}
+
+/// Record the call stack of each sample (slow, but only paid per sample)
+pub fn set_capture_stacks(enabled: bool) {
+    CAPTURE_STACKS.store(enabled, Ordering::Relaxed);
+}
+
+/// Report an allocation of `bytes` made by `subsystem`
+///
+/// Costs a relaxed load while sampling is off and a thread-local
+/// subtraction for allocations that are not sampled.
+#[inline]
+pub fn record(subsystem: Subsystem, bytes: usize) {
+    let interval = INTERVAL.load(Ordering::Relaxed);
+    if interval == 0 || bytes == 0 {
+        return;
+    }
+    let bytes = bytes as u64;
+    let due = COUNTDOWN.try_with(|countdown| {
+        let (drawn_for, left) = countdown.get();
+        let left = if drawn_for == interval {
+            left
+        } else {
+            next_distance(interval)
+        };
+        if bytes < left {
+            countdown.set((interval, left - bytes));
+            false
+        } else {
+            countdown.set((interval, next_distance(interval)));
+            true
+        }
+    });
+    if due == Ok(true) {
+        take_sample(subsystem, bytes, interval);
+    }
+}
+
+#[cold]
+fn take_sample(subsystem: Subsystem, bytes: u64, interval: u64) {
+    let p = -(-(bytes as f64) / interval as f64).exp_m1();
+    let weight = (bytes as f64 / p).round() as u64;
+
+    let mut stack = String::from("micropdf");
+    let _ = SCOPES.try_with(|scopes| {
+        for s in scopes.borrow().iter() {
+            stack.push(';');
+            stack.push_str(s.name());
+        }
+        // A subsystem allocating inside its own scope is one frame
+        if scopes.borrow().last() != Some(&subsystem) {
+            stack.push(';');
+            stack.push_str(subsystem.name());
+        }
+    });
+    if CAPTURE_STACKS.load(Ordering::Relaxed) {
+        append_call_stack(&mut stack);
+    }
+
+    let mut samples = SAMPLES.lock().unwrap();
+    let entry = samples.stacks.entry(stack).or_insert((0, 0));
+    entry.0 += 1;
+    entry.1 += weight;
+    samples.by_subsystem[subsystem as usize] += weight;
+    samples.count += 1;
+}
+
+/// Append the library frames of the current call stack, outermost first
+fn append_call_stack(stack: &mut String) {
+    let trace = std::backtrace::Backtrace::force_capture().to_string();
+    // Frames print innermost first as "  N: path::to::function"
+    let frames: Vec<&str> = trace
+        .lines()
+        .filter_map(|line| {
+            let (index, name) = line.trim_start().split_once(": ")?;
+            index.bytes().all(|b| b.is_ascii_digit()).then_some(name)
+        })
+        .filter(|name| name.starts_with("micropdf::") && !name.contains("::alloc_sampler::"))
+        .collect();
+    for name in frames.iter().rev() {
+        let name = name.strip_prefix("micropdf::").unwrap_or(name);
+        // Drop a symbol hash suffix such as "::h0123456789abcdef"
+        let name = match name.rsplit_once("::h") {
+            Some((path, hash))
+                if hash.len() == 16 && hash.bytes().all(|b| b.is_ascii_hexdigit()) =>
+            {
+                path
+            }
+            _ => name,
+        };
+        stack.push(';');
+        stack.push_str(&name.replace(';', ","));
+    }
+}
+
+/// Charges allocations made while it lives to a subsystem; see `scope`
+#[must_use = "a scope lasts until it is dropped"]
+pub struct Scope {
+    entered: bool,
+}
+
+/// Nest the allocations made until the returned guard drops under
+/// `subsystem`
+#[inline]
+pub fn scope(subsystem: Subsystem) -> Scope {
+    let entered = INTERVAL.load(Ordering::Relaxed) != 0
+        && SCOPES
+            .try_with(|scopes| scopes.borrow_mut().push(subsystem))
+            .is_ok();
+    Scope { entered }
+}
+
+impl Drop for Scope {
+    fn drop(&mut self) {
+        if self.entered {
+            let _ = SCOPES.try_with(|scopes| scopes.borrow_mut().pop());
+        }
+    }
+}
+
+/// Number of samples taken
+pub fn sample_count() -> u64 {
+    SAMPLES.lock().unwrap().count
+}
+
+/// Estimated bytes allocated by a subsystem while sampling was on
+pub fn sampled_bytes(subsystem: Subsystem) -> u64 {
+    SAMPLES.lock().unwrap().by_subsystem[subsystem as usize]
+}
+
+/// Discard every sample
+pub fn clear() {
+    *SAMPLES.lock().unwrap() = Samples::default();
+}
+
+/// The samples as folded stacks, one "frame;frame;... bytes" line each
+///
+/// Lines are sorted so that successive exports diff cleanly.
+pub fn folded() -> String {
+    let samples = SAMPLES.lock().unwrap();
+    let mut stacks: Vec<_> = samples.stacks.iter().collect();
+    stacks.sort();
+    let mut out = String::new();
+    for (stack, (_, bytes)) in stacks {
+        let _ = writeln!(out, "{} {}", stack, bytes);
+    }
+    out
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_nested_scopes_fold() {
+        // Other tests may sample concurrently, so only look for our stack
+        set_interval(1);
+        {
+            let _xref = scope(Subsystem::Xref);
+            record(Subsystem::Decode, 1 << 20);
+            let _decode = scope(Subsystem::Decode);
+            record(Subsystem::Decode, 1 << 20);
+        }
+        set_interval(0);
+        record(Subsystem::Font, 1 << 20);
+
+        let folded = folded();
+        let line = folded
+            .lines()
+            .find(|l| l.starts_with("micropdf;xref;decode "))
+            .unwrap();
+        let bytes: u64 = line.rsplit_once(' ').unwrap().1.parse().unwrap();
+        assert!(bytes >= 2 << 20);
+        assert!(!folded.contains("micropdf;xref;decode;decode"));
+        assert!(sampled_bytes(Subsystem::Decode) >= 2 << 20);
+    }
+}
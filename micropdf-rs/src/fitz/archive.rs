@@ -1,13 +1,27 @@
 //! Archive support for ZIP and TAR files
 //!
 //! Provides reading from archive files (ZIP, TAR) and directories.
+//!
+//! A ZIP central directory is indexed into a hash map once when the
+//! archive is opened, so lookups never rescan it. Archives opened from a
+//! path are memory-mapped; stored (uncompressed) entries are returned as
+//! slices of the mapping without copying, and deflated entries can be
+//! decoded on several threads at once with [`Archive::read_entries`].
 
 use crate::fitz::buffer::Buffer;
 use crate::fitz::error::{Error, Result};
+use bytes::Bytes;
+use flate2::read::DeflateDecoder;
 use std::collections::HashMap;
 use std::fs;
+use std::io::Read;
 use std::path::{Path, PathBuf};
 
+/// ZIP compression method: stored without compression
+pub const ZIP_METHOD_STORED: u16 = 0;
+/// ZIP compression method: raw deflate
+pub const ZIP_METHOD_DEFLATED: u16 = 8;
+
 /// Archive format
 #[derive(Debug, Clone, Copy, PartialEq, Eq)]
 pub enum ArchiveFormat {
@@ -44,6 +58,10 @@ pub struct ArchiveEntry {
     pub is_dir: bool,
     /// Offset in archive (for seeking)
     pub offset: u64,
+    /// Size of the entry as stored in the archive
+    pub compressed_size: u64,
+    /// Compression method (`ZIP_METHOD_*`)
+    pub method: u16,
 }
 
 impl ArchiveEntry {
@@ -53,6 +71,8 @@ impl ArchiveEntry {
             size,
             is_dir,
             offset: 0,
+            compressed_size: size,
+            method: ZIP_METHOD_STORED,
         }
     }
 }
@@ -71,8 +91,11 @@ trait ArchiveReader {
     /// Check if entry exists
     fn has_entry(&self, name: &str) -> bool;
 
-    /// Read entry data
-    fn read_entry(&mut self, name: &str) -> Result<Vec<u8>>;
+    /// Read entry data, sharing the archive's bytes where possible
+    fn read_entry(&self, name: &str) -> Result<Bytes>;
+
+    /// Uncompressed size of an entry, without reading it
+    fn entry_size(&self, name: &str) -> Option<u64>;
 
     /// Get all entry names
     fn entry_names(&self) -> Vec<&str>;
@@ -82,11 +105,11 @@ trait ArchiveReader {
 struct ZipArchive {
     entries: HashMap<String, ArchiveEntry>,
     entry_order: Vec<String>,
-    data: Vec<u8>,
+    data: Bytes,
 }
 
 impl ZipArchive {
-    fn new(data: Vec<u8>) -> Result<Self> {
+    fn new(data: Bytes) -> Result<Self> {
         let mut archive = Self {
             entries: HashMap::new(),
             entry_order: Vec::new(),
@@ -105,8 +128,14 @@ impl ZipArchive {
         let eocd_sig = [0x50, 0x4b, 0x05, 0x06];
         let mut eocd_pos = None;
 
-        // Search backwards for EOCD (usually at end, but can have comment)
-        for i in (0..self.data.len().saturating_sub(22)).rev() {
+        // Search backwards for EOCD (usually at end, but can have a
+        // comment of up to 64 KiB)
+        let last = self
+            .data
+            .len()
+            .checked_sub(22)
+            .ok_or_else(|| Error::Generic("Not a valid ZIP archive: EOCD not found".into()))?;
+        for i in (last.saturating_sub(u16::MAX as usize)..=last).rev() {
             if self.data.get(i..i + 4) == Some(&eocd_sig) {
                 eocd_pos = Some(i);
                 break;
@@ -148,8 +177,11 @@ impl ZipArchive {
             let comment_len =
                 u16::from_le_bytes([self.data[pos + 32], self.data[pos + 33]]) as usize;
 
+            let flags = u16::from_le_bytes([self.data[pos + 8], self.data[pos + 9]]);
+            let method = u16::from_le_bytes([self.data[pos + 10], self.data[pos + 11]]);
+
             // Read compressed and uncompressed sizes
-            let _compressed_size = u32::from_le_bytes([
+            let compressed_size = u32::from_le_bytes([
                 self.data[pos + 20],
                 self.data[pos + 21],
                 self.data[pos + 22],
@@ -176,12 +208,15 @@ impl ZipArchive {
             }
 
             let filename_bytes = &self.data[pos + 46..pos + 46 + filename_len];
-            if let Ok(filename) = std::str::from_utf8(filename_bytes) {
+            // Encrypted entries can't be read, so leave them out of the index
+            if let (Ok(filename), 0) = (std::str::from_utf8(filename_bytes), flags & 1) {
                 let entry = ArchiveEntry {
                     name: filename.to_string(),
                     size: uncompressed_size as u64,
                     offset: local_offset as u64,
                     is_dir: filename.ends_with('/'),
+                    compressed_size: compressed_size as u64,
+                    method,
                 };
 
                 self.entry_order.push(filename.to_string());
@@ -194,6 +229,29 @@ impl ZipArchive {
 
         Ok(())
     }
+
+    /// The entry's stored bytes, found through its local file header
+    fn stored_data(&self, entry: &ArchiveEntry) -> Result<Bytes> {
+        let truncated = || Error::Generic(format!("Truncated ZIP entry: {}", entry.name));
+        let pos = entry.offset as usize;
+        let header = self.data.get(pos..pos + 30).ok_or_else(truncated)?;
+        if header[..4] != [0x50, 0x4b, 0x03, 0x04] {
+            return Err(Error::Generic(format!(
+                "Bad local header for ZIP entry: {}",
+                entry.name
+            )));
+        }
+        // The local name and extra field lengths may differ from the
+        // central directory's, so the data offset comes from here
+        let name_len = u16::from_le_bytes([header[26], header[27]]) as usize;
+        let extra_len = u16::from_le_bytes([header[28], header[29]]) as usize;
+        let start = pos + 30 + name_len + extra_len;
+        let end = start + entry.compressed_size as usize;
+        if end > self.data.len() {
+            return Err(truncated());
+        }
+        Ok(self.data.slice(start..end))
+    }
 }
 
 impl ArchiveReader for ZipArchive {
@@ -216,14 +274,35 @@ impl ArchiveReader for ZipArchive {
         self.entries.contains_key(name)
     }
 
-    fn read_entry(&mut self, name: &str) -> Result<Vec<u8>> {
-        let _entry = self
+    fn read_entry(&self, name: &str) -> Result<Bytes> {
+        let entry = self
             .entries
             .get(name)
             .ok_or_else(|| Error::Argument(format!("Entry not found: {}", name)))?;
+        let stored = self.stored_data(entry)?;
+
+        match entry.method {
+            ZIP_METHOD_STORED => Ok(stored),
+            ZIP_METHOD_DEFLATED => {
+                let mut data = Vec::with_capacity(entry.size as usize);
+                DeflateDecoder::new(&stored[..])
+                    .take(entry.size)
+                    .read_to_end(&mut data)
+                    .map_err(Error::System)?;
+                if data.len() as u64 != entry.size {
+                    return Err(Error::Generic(format!("Corrupt ZIP entry: {}", entry.name)));
+                }
+                Ok(Bytes::from(data))
+            }
+            method => Err(Error::Unsupported(format!(
+                "Unsupported ZIP compression method {} for entry: {}",
+                method, name
+            ))),
+        }
+    }
 
-        // Simplified: would extract and decompress here
-        Ok(Vec::new())
+    fn entry_size(&self, name: &str) -> Option<u64> {
+        self.entries.get(name).map(|e| e.size)
     }
 
     fn entry_names(&self) -> Vec<&str> {
@@ -236,11 +315,11 @@ impl ArchiveReader for ZipArchive {
 struct TarArchive {
     entries: HashMap<String, ArchiveEntry>,
     entry_order: Vec<String>,
-    data: Vec<u8>,
+    data: Bytes,
 }
 
 impl TarArchive {
-    fn new(data: Vec<u8>) -> Result<Self> {
+    fn new(data: Bytes) -> Result<Self> {
         let mut archive = Self {
             entries: HashMap::new(),
             entry_order: Vec::new(),
@@ -277,14 +356,18 @@ impl ArchiveReader for TarArchive {
         self.entries.contains_key(name)
     }
 
-    fn read_entry(&mut self, name: &str) -> Result<Vec<u8>> {
+    fn read_entry(&self, name: &str) -> Result<Bytes> {
         let _entry = self
             .entries
             .get(name)
             .ok_or_else(|| Error::Argument(format!("Entry not found: {}", name)))?;
 
         // Simplified: would extract here
-        Ok(Vec::new())
+        Ok(Bytes::new())
+    }
+
+    fn entry_size(&self, name: &str) -> Option<u64> {
+        self.entries.get(name).map(|e| e.size)
     }
 
     fn entry_names(&self) -> Vec<&str> {
@@ -378,13 +461,19 @@ impl ArchiveReader for DirectoryArchive {
         entry_path.exists()
     }
 
-    fn read_entry(&mut self, name: &str) -> Result<Vec<u8>> {
+    fn read_entry(&self, name: &str) -> Result<Bytes> {
         let entry_path = self.path.join(name);
         if !entry_path.exists() {
             return Err(Error::Argument(format!("Entry not found: {}", name)));
         }
 
-        fs::read(&entry_path).map_err(Error::System)
+        fs::read(&entry_path)
+            .map(Bytes::from)
+            .map_err(Error::System)
+    }
+
+    fn entry_size(&self, name: &str) -> Option<u64> {
+        fs::metadata(self.path.join(name)).ok().map(|m| m.len())
     }
 
     fn entry_names(&self) -> Vec<&str> {
@@ -394,7 +483,7 @@ impl ArchiveReader for DirectoryArchive {
 
 /// Archive handle
 pub struct Archive {
-    reader: Box<dyn ArchiveReader + Send>,
+    reader: Box<dyn ArchiveReader + Send + Sync>,
 }
 
 impl Archive {
@@ -407,22 +496,17 @@ impl Archive {
             return Self::open_directory(path);
         }
 
-        // Read file data
-        let data = fs::read(path).map_err(Error::System)?;
-
-        // Detect format
-        let format = Self::detect_format(&data);
+        Self::from_bytes(Self::map_file(path)?)
+    }
 
-        match format {
-            ArchiveFormat::Zip => Ok(Self {
-                reader: Box::new(ZipArchive::new(data)?),
-            }),
-            ArchiveFormat::Tar => Ok(Self {
-                reader: Box::new(TarArchive::new(data)?),
-            }),
-            _ => Err(Error::Unsupported(
-                "Unknown or unsupported archive format".into(),
-            )),
+    /// Map a file into memory, falling back to reading it
+    fn map_file(path: &Path) -> Result<Bytes> {
+        let file = fs::File::open(path).map_err(Error::System)?;
+        // SAFETY: the mapping is read-only; as with any mapped file, the
+        // archive must not be truncated while it is open
+        match unsafe { memmap2::Mmap::map(&file) } {
+            Ok(map) => Ok(Bytes::from_owner(map)),
+            Err(_) => fs::read(path).map(Bytes::from).map_err(Error::System),
         }
     }
 
@@ -436,6 +520,11 @@ impl Archive {
 
     /// Open archive from buffer
     pub fn from_buffer(data: Vec<u8>) -> Result<Self> {
+        Self::from_bytes(Bytes::from(data))
+    }
+
+    /// Open archive from shared bytes without copying them
+    pub fn from_bytes(data: Bytes) -> Result<Self> {
         let format = Self::detect_format(&data);
 
         match format {
@@ -492,13 +581,64 @@ impl Archive {
 
     /// Read entry data
     pub fn read_entry(&mut self, name: &str) -> Result<Vec<u8>> {
+        self.reader.read_entry(name).map(Vec::from)
+    }
+
+    /// Read entry data; stored entries share the archive's bytes
+    pub fn read_entry_bytes(&self, name: &str) -> Result<Bytes> {
         self.reader.read_entry(name)
     }
 
+    /// Read several entries, decoding them on up to `threads` threads
+    ///
+    /// Results come back in the order of `names`. `threads` of 0 uses one
+    /// per core.
+    pub fn read_entries(&self, names: &[&str], threads: usize) -> Vec<Result<Bytes>> {
+        let threads = if threads > 0 {
+            threads
+        } else {
+            std::thread::available_parallelism().map_or(1, |n| n.get())
+        }
+        .min(names.len());
+        if threads <= 1 {
+            return names.iter().map(|n| self.reader.read_entry(n)).collect();
+        }
+
+        let chunk = names.len().div_ceil(threads);
+        std::thread::scope(|scope| {
+            let workers: Vec<_> = names
+                .chunks(chunk)
+                .map(|chunk| {
+                    let worker = scope.spawn(move || {
+                        chunk
+                            .iter()
+                            .map(|n| self.reader.read_entry(n))
+                            .collect::<Vec<_>>()
+                    });
+                    (chunk.len(), worker)
+                })
+                .collect();
+            workers
+                .into_iter()
+                .flat_map(|(len, worker)| {
+                    worker.join().unwrap_or_else(|_| {
+                        (0..len)
+                            .map(|_| Err(Error::Generic("Archive reader panicked".into())))
+                            .collect()
+                    })
+                })
+                .collect()
+        })
+    }
+
+    /// Uncompressed size of an entry, without reading it
+    pub fn entry_size(&self, name: &str) -> Option<u64> {
+        self.reader.entry_size(name)
+    }
+
     /// Read entry as buffer
     pub fn read_entry_buffer(&mut self, name: &str) -> Result<Buffer> {
-        let data = self.read_entry(name)?;
-        Ok(Buffer::from_data(data))
+        Ok(Buffer::from_bytes(self.read_entry_bytes(name)?))
     }
 
     /// Get all entry names
@@ -512,6 +652,61 @@ impl Archive {
     }
 }
 
+/// Build a ZIP holding `entries`, deflating those marked true
+#[cfg(test)]
+pub(crate) fn build_test_zip(entries: &[(&str, &[u8], bool)]) -> Vec<u8> {
+    use flate2::Compression;
+    use flate2::write::DeflateEncoder;
+    use std::io::Write;
+
+    let mut zip = Vec::new();
+    let mut central = Vec::new();
+    for &(name, data, deflate) in entries {
+        let (method, stored) = if deflate {
+            let mut enc = DeflateEncoder::new(Vec::new(), Compression::default());
+            enc.write_all(data).unwrap();
+            (ZIP_METHOD_DEFLATED, enc.finish().unwrap())
+        } else {
+            (ZIP_METHOD_STORED, data.to_vec())
+        };
+        let offset = zip.len() as u32;
+        let sizes = [stored.len() as u32, data.len() as u32];
+
+        zip.extend_from_slice(&[0x50, 0x4b, 0x03, 0x04, 20, 0, 0, 0]);
+        zip.extend_from_slice(&method.to_le_bytes());
+        zip.extend_from_slice(&[0; 8]); // time, date, crc
+        sizes
+            .iter()
+            .for_each(|s| zip.extend_from_slice(&s.to_le_bytes()));
+        zip.extend_from_slice(&(name.len() as u16).to_le_bytes());
+        zip.extend_from_slice(&4u16.to_le_bytes());
+        zip.extend_from_slice(name.as_bytes());
+        zip.extend_from_slice(&[0; 4]); // extra field only in the local header
+        zip.extend_from_slice(&stored);
+
+        central.extend_from_slice(&[0x50, 0x4b, 0x01, 0x02, 20, 0, 20, 0, 0, 0]);
+        central.extend_from_slice(&method.to_le_bytes());
+        central.extend_from_slice(&[0; 8]);
+        sizes
+            .iter()
+            .for_each(|s| central.extend_from_slice(&s.to_le_bytes()));
+        central.extend_from_slice(&(name.len() as u16).to_le_bytes());
+        central.extend_from_slice(&[0; 12]);
+        central.extend_from_slice(&offset.to_le_bytes());
+        central.extend_from_slice(name.as_bytes());
+    }
+    let cd_offset = zip.len() as u32;
+    zip.extend_from_slice(&central);
+    zip.extend_from_slice(&[0x50, 0x4b, 0x05, 0x06, 0, 0, 0, 0]);
+    let count = entries.len() as u16;
+    zip.extend_from_slice(&count.to_le_bytes());
+    zip.extend_from_slice(&count.to_le_bytes());
+    zip.extend_from_slice(&(central.len() as u32).to_le_bytes());
+    zip.extend_from_slice(&cd_offset.to_le_bytes());
+    zip.extend_from_slice(&[0, 0]);
+    zip
+}
+
 #[cfg(test)]
 mod tests {
     use super::*;
@@ -635,6 +830,63 @@ mod tests {
         assert!(names.contains(&"b.txt"));
     }
 
+    #[test]
+    fn test_zip_stored_and_deflated() {
+        let text = b"deflate me ".repeat(200);
+        let zip = build_test_zip(&[
+            ("page1.jpg", b"\xff\xd8stored", false),
+            ("pages/page2.txt", &text, true),
+        ]);
+        let data = Bytes::from(zip);
+        let mut archive = Archive::from_bytes(data.clone()).unwrap();
+
+        assert_eq!(archive.count_entries().unwrap(), 2);
+        assert_eq!(archive.list_entry(1).unwrap(), "pages/page2.txt");
+        assert_eq!(
+            archive.entry_size("pages/page2.txt"),
+            Some(text.len() as u64)
+        );
+        assert_eq!(archive.entry_size("missing"), None);
+
+        let stored = archive.read_entry_bytes("page1.jpg").unwrap();
+        assert_eq!(&stored[..], b"\xff\xd8stored");
+        // Stored entries point into the archive's own bytes
+        let range = data.as_ptr() as usize..data.as_ptr() as usize + data.len();
+        assert!(range.contains(&(stored.as_ptr() as usize)));
+
+        assert_eq!(archive.read_entry("pages/page2.txt").unwrap(), text);
+        assert!(archive.read_entry("missing").is_err());
+    }
+
+    #[test]
+    fn test_zip_parallel_read_from_file() {
+        let contents: Vec<Vec<u8>> = (0..12)
+            .map(|i| format!("entry {} ", i).repeat(50 + i).into_bytes())
+            .collect();
+        let names: Vec<String> = (0..12).map(|i| format!("{:02}.png", i)).collect();
+        let entries: Vec<(&str, &[u8], bool)> = names
+            .iter()
+            .zip(&contents)
+            .enumerate()
+            .map(|(i, (n, c))| (n.as_str(), c.as_slice(), i % 2 == 0))
+            .collect();
+
+        let temp_dir = TempDir::new().unwrap();
+        let path = temp_dir.path().join("book.cbz");
+        fs::write(&path, build_test_zip(&entries)).unwrap();
+        let archive = Archive::open(&path).unwrap();
+        assert_eq!(archive.format(), ArchiveFormat::Zip);
+
+        let wanted: Vec<&str> = names.iter().rev().map(|n| n.as_str()).collect();
+        for threads in [1, 4, 0] {
+            let read = archive.read_entries(&wanted, threads);
+            assert_eq!(read.len(), 12);
+            for (data, expected) in read.iter().zip(contents.iter().rev()) {
+                assert_eq!(&data.as_ref().unwrap()[..], &expected[..]);
+            }
+        }
+    }
+
     #[test]
     fn test_read_entry_buffer() {
         let temp_dir = TempDir::new().unwrap();
@@ -6,6 +6,8 @@
 use std::sync::Arc;
 use std::sync::atomic::{AtomicBool, AtomicI32, Ordering};
 
+use crate::fitz::memory_budget::MemoryBudget;
+
 /// Cookie for tracking progress and handling cancellation
 #[derive(Clone)]
 pub struct Cookie {
@@ -19,6 +21,8 @@ pub struct Cookie {
     errors: Arc<AtomicI32>,
     /// Incomplete flag - set if operation was incomplete
     incomplete: Arc<AtomicBool>,
+    /// Memory charged to operations run with this cookie
+    memory: Arc<MemoryBudget>,
 }
 
 impl Cookie {
@@ -30,6 +34,7 @@ impl Cookie {
             progress_max: Arc::new(AtomicI32::new(0)),
             errors: Arc::new(AtomicI32::new(0)),
             incomplete: Arc::new(AtomicBool::new(false)),
+            memory: Arc::new(MemoryBudget::default()),
         }
     }
 
@@ -63,6 +68,11 @@ impl Cookie {
         self.progress.fetch_add(1, Ordering::Relaxed);
     }
 
+    /// Add `n` to progress
+    pub fn add_progress(&self, n: i32) {
+        self.progress.fetch_add(n, Ordering::Relaxed);
+    }
+
     /// Get progress maximum
     pub fn progress_max(&self) -> i32 {
         self.progress_max.load(Ordering::Relaxed)
@@ -115,6 +125,13 @@ impl Cookie {
         self.progress_max.store(0, Ordering::Relaxed);
         self.errors.store(0, Ordering::Relaxed);
         self.incomplete.store(false, Ordering::Relaxed);
+        self.memory.reset();
+    }
+
+    /// Memory budget of the operations run with this cookie (no limit
+    /// until one is set)
+    pub fn memory(&self) -> &Arc<MemoryBudget> {
+        &self.memory
     }
 }
 
@@ -164,6 +181,9 @@ mod tests {
 
         cookie.inc_progress();
         assert_eq!(cookie.progress(), 51);
+
+        cookie.add_progress(9);
+        assert_eq!(cookie.progress(), 60);
     }
 
     #[test]
@@ -0,0 +1,133 @@
+//! Performance counters
+//!
+//! Monotonic counts of the work done inside the library: bytes inflated,
+//! images decoded, glyphs rasterized, paths filled, operators interpreted
+//! and handle lookups per object type. Each thread bumps its own slots with
+//! plain relaxed stores, so counting never contends; `snapshot` sums every
+//! live thread plus what exited threads left behind.
+
+use std::sync::atomic::{AtomicU64, Ordering};
+use std::sync::{Arc, Mutex};
+
+/// What a counter counts
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum Counter {
+    /// Bytes produced by FlateDecode
+    BytesInflated,
+    /// Images decoded (decoded-image cache misses)
+    ImagesDecoded,
+    /// Pixels those decodes produced
+    ImagePixelsDecoded,
+    /// Nanoseconds spent in those decodes
+    ImageDecodeNs,
+    /// Glyphs rasterized (glyph cache misses)
+    GlyphsRasterized,
+    /// Paths scan converted for fills
+    PathsFilled,
+    /// Paths scan converted for strokes
+    PathsStroked,
+    /// Content stream operators run
+    OperatorsInterpreted,
+    /// Document handle lookups
+    DocumentLookups,
+    /// Page handle lookups
+    PageLookups,
+    /// Pixmap handle lookups
+    PixmapLookups,
+    /// Image handle lookups
+    ImageLookups,
+    /// Font handle lookups
+    FontLookups,
+    /// Buffer handle lookups
+    BufferLookups,
+    /// Structured text page handle lookups
+    StextPageLookups,
+}
+
+/// Number of counters
+pub const COUNTER_COUNT: usize = Counter::StextPageLookups as usize + 1;
+
+struct Slots([AtomicU64; COUNTER_COUNT]);
+
+impl Slots {
+    const fn new() -> Self {
+        Self([const { AtomicU64::new(0) }; COUNTER_COUNT])
+    }
+}
+
+/// Slots of the running threads
+static LIVE: Mutex<Vec<Arc<Slots>>> = Mutex::new(Vec::new());
+/// Totals of exited threads
+static RETIRED: Slots = Slots::new();
+
+/// A thread's slots; folded into `RETIRED` when the thread exits
+struct Local(Arc<Slots>);
+
+impl Drop for Local {
+    fn drop(&mut self) {
+        let mut live = LIVE.lock().unwrap();
+        for (total, slot) in RETIRED.0.iter().zip(&self.0.0) {
+            total.fetch_add(slot.load(Ordering::Relaxed), Ordering::Relaxed);
+        }
+        live.retain(|s| !Arc::ptr_eq(s, &self.0));
+    }
+}
+
+thread_local! {
+    static LOCAL: Local = {
+        let slots = Arc::new(Slots::new());
+        LIVE.lock().unwrap().push(Arc::clone(&slots));
+        Local(slots)
+    };
+}
+
+/// Add `n` to `counter`
+#[inline]
+pub fn add(counter: Counter, n: u64) {
+    let counted = LOCAL.try_with(|local| {
+        // Only this thread writes its slots
+        let slot = &local.0.0[counter as usize];
+        slot.store(
+            slot.load(Ordering::Relaxed).wrapping_add(n),
+            Ordering::Relaxed,
+        );
+    });
+    if counted.is_err() {
+        // The thread is shutting down
+        RETIRED.0[counter as usize].fetch_add(n, Ordering::Relaxed);
+    }
+}
+
+/// Current totals, indexed by `Counter as usize`
+pub fn snapshot() -> [u64; COUNTER_COUNT] {
+    let live = LIVE.lock().unwrap();
+    let mut totals: [u64; COUNTER_COUNT] =
+        std::array::from_fn(|i| RETIRED.0[i].load(Ordering::Relaxed));
+    for slots in live.iter() {
+        for (total, slot) in totals.iter_mut().zip(&slots.0) {
+            *total = total.wrapping_add(slot.load(Ordering::Relaxed));
+        }
+    }
+    totals
+}
+
+/// Current total of one counter
+pub fn get(counter: Counter) -> u64 {
+    snapshot()[counter as usize]
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_counts_survive_thread_exit() {
+        let before = get(Counter::PathsStroked);
+        add(Counter::PathsStroked, 2);
+        std::thread::spawn(|| add(Counter::PathsStroked, 3))
+            .join()
+            .unwrap();
+        // Other tests may count concurrently
+        assert!(get(Counter::PathsStroked) >= before + 5);
+    }
+}
@@ -190,6 +190,12 @@ pub trait Device {
 
     fn end_tile(&mut self);
 
+    // Optional content: what lies between begin_layer and end_layer
+    // belongs to the named layer (OCG)
+    fn begin_layer(&mut self, _name: &str) {}
+
+    fn end_layer(&mut self) {}
+
     // Control
     fn close(&mut self) {}
 }
@@ -562,6 +568,18 @@ impl Device for TraceDevice {
         self.log("end_tile");
     }
 
+    fn begin_layer(&mut self, name: &str) {
+        self.log(&format!("begin_layer '{}'", name));
+        self.indent += 1;
+    }
+
+    fn end_layer(&mut self) {
+        if self.indent > 0 {
+            self.indent -= 1;
+        }
+        self.log("end_layer");
+    }
+
     fn close(&mut self) {
         self.log("close");
     }
@@ -1,13 +1,24 @@
 //! Display list - record and replay drawing operations
 //!
 //! Display lists capture drawing operations for caching and multi-threaded rendering.
+//! A list serializes to a compact binary form, so one process can record a
+//! page and others replay it without parsing the document again.
 
 use crate::fitz::colorspace::Colorspace;
+use crate::fitz::cookie::Cookie;
 use crate::fitz::device::{BlendMode, Device};
+use crate::fitz::error::{Error, Result};
+use crate::fitz::font::{Font, FontFlags, FontMetrics, FontStretch, FontType, FontWeight};
+use crate::fitz::font_cache::{FontFace, cached_faces};
 use crate::fitz::geometry::{Matrix, Rect};
-use crate::fitz::image::Image;
-use crate::fitz::path::{Path, StrokeState};
-use crate::fitz::text::Text;
+use crate::fitz::image::{Image, ImageFormat, MaskType};
+use crate::fitz::path::{LineCap, LineJoin, Path, PathElement, StrokeState};
+use crate::fitz::pixmap::Pixmap;
+use crate::fitz::text::{BidiDirection, Text, TextItem, TextLanguage, TextSpan};
+use sha2::{Digest, Sha256};
+use std::collections::HashMap;
+use std::ops::Range;
+use std::sync::{Arc, Mutex, OnceLock};
 
 /// Display list command
 #[derive(Clone)]
@@ -112,6 +123,11 @@ enum Command {
         ctm: Matrix,
     },
     EndTile,
+    /// Start of content in an optional content group, by name
+    BeginLayer {
+        name: Arc<str>,
+    },
+    EndLayer,
 }
 
 /// Display list - records drawing operations for playback
@@ -119,6 +135,8 @@ enum Command {
 pub struct DisplayList {
     mediabox: Rect,
     commands: Vec<Command>,
+    /// Bbox tree for scissored playback, built on close or first use
+    index: OnceLock<ListIndex>,
 }
 
 impl DisplayList {
@@ -127,6 +145,7 @@ impl DisplayList {
         Self {
             mediabox,
             commands: Vec::new(),
+            index: OnceLock::new(),
         }
     }
 
@@ -146,183 +165,334 @@ impl DisplayList {
     }
 
     /// Run the display list through a device
+    ///
+    /// With a finite scissor, the list's spatial index is walked instead
+    /// so that commands, clip blocks and groups the scissor misses are
+    /// skipped whole.
     pub fn run(&self, device: &mut dyn Device, ctm: &Matrix, scissor: Rect) {
-        for cmd in &self.commands {
-            // Check if command is within scissor bounds (simplified)
-            match cmd {
-                Command::FillPath {
-                    path,
-                    even_odd,
-                    ctm: cmd_ctm,
-                    colorspace,
-                    color,
-                    alpha,
-                } => {
-                    let final_ctm = cmd_ctm.concat(ctm);
-                    device.fill_path(path, *even_odd, &final_ctm, colorspace, color, *alpha);
-                }
-                Command::StrokePath {
-                    path,
-                    stroke,
-                    ctm: cmd_ctm,
-                    colorspace,
-                    color,
-                    alpha,
-                } => {
-                    let final_ctm = cmd_ctm.concat(ctm);
-                    device.stroke_path(path, stroke, &final_ctm, colorspace, color, *alpha);
-                }
-                Command::ClipPath {
-                    path,
-                    even_odd,
-                    ctm: cmd_ctm,
-                    scissor: cmd_scissor,
-                } => {
-                    let final_ctm = cmd_ctm.concat(ctm);
-                    let final_scissor = scissor.intersect(cmd_scissor);
-                    device.clip_path(path, *even_odd, &final_ctm, final_scissor);
-                }
-                Command::ClipStrokePath {
-                    path,
-                    stroke,
-                    ctm: cmd_ctm,
-                    scissor: cmd_scissor,
-                } => {
-                    let final_ctm = cmd_ctm.concat(ctm);
-                    let final_scissor = scissor.intersect(cmd_scissor);
-                    device.clip_stroke_path(path, stroke, &final_ctm, final_scissor);
-                }
-                Command::FillText {
-                    text,
-                    ctm: cmd_ctm,
-                    colorspace,
-                    color,
-                    alpha,
-                } => {
-                    let final_ctm = cmd_ctm.concat(ctm);
-                    device.fill_text(text, &final_ctm, colorspace, color, *alpha);
-                }
-                Command::StrokeText {
-                    text,
-                    stroke,
-                    ctm: cmd_ctm,
-                    colorspace,
-                    color,
-                    alpha,
-                } => {
-                    let final_ctm = cmd_ctm.concat(ctm);
-                    device.stroke_text(text, stroke, &final_ctm, colorspace, color, *alpha);
-                }
-                Command::ClipText {
-                    text,
-                    ctm: cmd_ctm,
-                    scissor: cmd_scissor,
-                } => {
-                    let final_ctm = cmd_ctm.concat(ctm);
-                    let final_scissor = scissor.intersect(cmd_scissor);
-                    device.clip_text(text, &final_ctm, final_scissor);
-                }
-                Command::ClipStrokeText {
-                    text,
-                    stroke,
-                    ctm: cmd_ctm,
-                    scissor: cmd_scissor,
-                } => {
-                    let final_ctm = cmd_ctm.concat(ctm);
-                    let final_scissor = scissor.intersect(cmd_scissor);
-                    device.clip_stroke_text(text, stroke, &final_ctm, final_scissor);
-                }
-                Command::IgnoreText { text, ctm: cmd_ctm } => {
-                    let final_ctm = cmd_ctm.concat(ctm);
-                    device.ignore_text(text, &final_ctm);
-                }
-                Command::FillImage {
-                    image,
-                    ctm: cmd_ctm,
-                    alpha,
-                } => {
-                    let final_ctm = cmd_ctm.concat(ctm);
-                    device.fill_image(image, &final_ctm, *alpha);
-                }
-                Command::FillImageMask {
-                    image,
-                    ctm: cmd_ctm,
-                    colorspace,
-                    color,
-                    alpha,
-                } => {
-                    let final_ctm = cmd_ctm.concat(ctm);
-                    device.fill_image_mask(image, &final_ctm, colorspace, color, *alpha);
-                }
-                Command::ClipImageMask {
-                    image,
-                    ctm: cmd_ctm,
-                    scissor: cmd_scissor,
-                } => {
-                    let final_ctm = cmd_ctm.concat(ctm);
-                    let final_scissor = scissor.intersect(cmd_scissor);
-                    device.clip_image_mask(image, &final_ctm, final_scissor);
-                }
-                Command::PopClip => {
-                    device.pop_clip();
-                }
-                Command::BeginMask {
-                    area,
-                    luminosity,
-                    colorspace,
-                    color,
-                } => {
-                    device.begin_mask(*area, *luminosity, colorspace, color);
-                }
-                Command::EndMask => {
-                    device.end_mask();
-                }
-                Command::BeginGroup {
-                    area,
-                    colorspace,
-                    isolated,
-                    knockout,
-                    blendmode,
-                    alpha,
-                } => {
-                    device.begin_group(
-                        *area,
-                        colorspace.as_ref(),
-                        *isolated,
-                        *knockout,
-                        *blendmode,
-                        *alpha,
-                    );
-                }
-                Command::EndGroup => {
-                    device.end_group();
+        self.run_with_layers(device, ctm, scissor, &|_| true);
+    }
+
+    /// Run the display list with only the layers `visible` accepts
+    ///
+    /// Content recorded between `begin_layer` and `end_layer` for a
+    /// layer `visible` rejects is skipped, along with any layers nested
+    /// in it, so one recorded list serves every layer configuration.
+    pub fn run_with_layers(
+        &self,
+        device: &mut dyn Device,
+        ctm: &Matrix,
+        scissor: Rect,
+        visible: &dyn Fn(&str) -> bool,
+    ) {
+        self.replay(device, ctm, scissor, visible, None);
+    }
+
+    /// Run the display list, stopping as soon as `cookie` is aborted
+    ///
+    /// The cookie's progress goes up by one per command, whether run or
+    /// culled, so a complete run adds `len()`. Returns false if the run
+    /// was stopped.
+    pub fn run_with_cookie(
+        &self,
+        device: &mut dyn Device,
+        ctm: &Matrix,
+        scissor: Rect,
+        cookie: &Cookie,
+    ) -> bool {
+        self.replay(device, ctm, scissor, &|_| true, Some(cookie));
+        !cookie.should_abort()
+    }
+
+    fn replay(
+        &self,
+        device: &mut dyn Device,
+        ctm: &Matrix,
+        scissor: Rect,
+        visible: &dyn Fn(&str) -> bool,
+        cookie: Option<&Cookie>,
+    ) {
+        let mut replay = Replay {
+            visible,
+            hidden: 0,
+            cookie,
+        };
+        if scissor.is_infinite() || self.commands.is_empty() {
+            for cmd in &self.commands {
+                if replay.aborted() {
+                    return;
                 }
-                Command::BeginTile {
-                    area,
-                    view,
-                    xstep,
-                    ystep,
-                    ctm: cmd_ctm,
-                } => {
-                    let final_ctm = cmd_ctm.concat(ctm);
-                    device.begin_tile(*area, *view, *xstep, *ystep, &final_ctm);
+                replay.advance(1);
+                if !replay.skips(cmd) {
+                    run_command(cmd, device, ctm, scissor);
                 }
-                Command::EndTile => {
-                    device.end_tile();
+            }
+            return;
+        }
+        let index = self.index.get_or_init(|| ListIndex::build(&self.commands));
+        if let Some(root) = index.nodes.last() {
+            index.run(&self.commands, root, device, ctm, scissor, &mut replay);
+        }
+    }
+
+    /// Names of the layers the list's content is tagged with, in first
+    /// use order
+    pub fn layers(&self) -> Vec<&str> {
+        let mut names: Vec<&str> = Vec::new();
+        for cmd in &self.commands {
+            if let Command::BeginLayer { name } = cmd {
+                if !names.contains(&&**name) {
+                    names.push(name);
                 }
             }
         }
+        names
+    }
+
+    /// Build the spatial index now rather than on the first scissored run
+    pub fn build_index(&self) {
+        self.index.get_or_init(|| ListIndex::build(&self.commands));
+    }
+
+    /// Whether the spatial index is built
+    pub fn is_indexed(&self) -> bool {
+        self.index.get().is_some()
     }
 
     /// Clear all commands
     pub fn clear(&mut self) {
         self.commands.clear();
+        self.index.take();
+    }
+
+    /// Approximate memory held by the list, for store accounting
+    pub fn approx_size(&self) -> usize {
+        std::mem::size_of::<Self>()
+            + self.commands.capacity() * std::mem::size_of::<Command>()
+            + self.index.get().map_or(0, ListIndex::approx_size)
+    }
+}
+
+/// Replay one command through a device
+fn run_command(cmd: &Command, device: &mut dyn Device, ctm: &Matrix, scissor: Rect) {
+    match cmd {
+        Command::FillPath {
+            path,
+            even_odd,
+            ctm: cmd_ctm,
+            colorspace,
+            color,
+            alpha,
+        } => {
+            let final_ctm = cmd_ctm.concat(ctm);
+            device.fill_path(path, *even_odd, &final_ctm, colorspace, color, *alpha);
+        }
+        Command::StrokePath {
+            path,
+            stroke,
+            ctm: cmd_ctm,
+            colorspace,
+            color,
+            alpha,
+        } => {
+            let final_ctm = cmd_ctm.concat(ctm);
+            device.stroke_path(path, stroke, &final_ctm, colorspace, color, *alpha);
+        }
+        Command::ClipPath {
+            path,
+            even_odd,
+            ctm: cmd_ctm,
+            scissor: cmd_scissor,
+        } => {
+            let final_ctm = cmd_ctm.concat(ctm);
+            let final_scissor = scissor.intersect(cmd_scissor);
+            device.clip_path(path, *even_odd, &final_ctm, final_scissor);
+        }
+        Command::ClipStrokePath {
+            path,
+            stroke,
+            ctm: cmd_ctm,
+            scissor: cmd_scissor,
+        } => {
+            let final_ctm = cmd_ctm.concat(ctm);
+            let final_scissor = scissor.intersect(cmd_scissor);
+            device.clip_stroke_path(path, stroke, &final_ctm, final_scissor);
+        }
+        Command::FillText {
+            text,
+            ctm: cmd_ctm,
+            colorspace,
+            color,
+            alpha,
+        } => {
+            let final_ctm = cmd_ctm.concat(ctm);
+            device.fill_text(text, &final_ctm, colorspace, color, *alpha);
+        }
+        Command::StrokeText {
+            text,
+            stroke,
+            ctm: cmd_ctm,
+            colorspace,
+            color,
+            alpha,
+        } => {
+            let final_ctm = cmd_ctm.concat(ctm);
+            device.stroke_text(text, stroke, &final_ctm, colorspace, color, *alpha);
+        }
+        Command::ClipText {
+            text,
+            ctm: cmd_ctm,
+            scissor: cmd_scissor,
+        } => {
+            let final_ctm = cmd_ctm.concat(ctm);
+            let final_scissor = scissor.intersect(cmd_scissor);
+            device.clip_text(text, &final_ctm, final_scissor);
+        }
+        Command::ClipStrokeText {
+            text,
+            stroke,
+            ctm: cmd_ctm,
+            scissor: cmd_scissor,
+        } => {
+            let final_ctm = cmd_ctm.concat(ctm);
+            let final_scissor = scissor.intersect(cmd_scissor);
+            device.clip_stroke_text(text, stroke, &final_ctm, final_scissor);
+        }
+        Command::IgnoreText { text, ctm: cmd_ctm } => {
+            let final_ctm = cmd_ctm.concat(ctm);
+            device.ignore_text(text, &final_ctm);
+        }
+        Command::FillImage {
+            image,
+            ctm: cmd_ctm,
+            alpha,
+        } => {
+            let final_ctm = cmd_ctm.concat(ctm);
+            device.fill_image(image, &final_ctm, *alpha);
+        }
+        Command::FillImageMask {
+            image,
+            ctm: cmd_ctm,
+            colorspace,
+            color,
+            alpha,
+        } => {
+            let final_ctm = cmd_ctm.concat(ctm);
+            device.fill_image_mask(image, &final_ctm, colorspace, color, *alpha);
+        }
+        Command::ClipImageMask {
+            image,
+            ctm: cmd_ctm,
+            scissor: cmd_scissor,
+        } => {
+            let final_ctm = cmd_ctm.concat(ctm);
+            let final_scissor = scissor.intersect(cmd_scissor);
+            device.clip_image_mask(image, &final_ctm, final_scissor);
+        }
+        Command::PopClip => {
+            device.pop_clip();
+        }
+        Command::BeginMask {
+            area,
+            luminosity,
+            colorspace,
+            color,
+        } => {
+            device.begin_mask(*area, *luminosity, colorspace, color);
+        }
+        Command::EndMask => {
+            device.end_mask();
+        }
+        Command::BeginGroup {
+            area,
+            colorspace,
+            isolated,
+            knockout,
+            blendmode,
+            alpha,
+        } => {
+            device.begin_group(
+                *area,
+                colorspace.as_ref(),
+                *isolated,
+                *knockout,
+                *blendmode,
+                *alpha,
+            );
+        }
+        Command::EndGroup => {
+            device.end_group();
+        }
+        Command::BeginTile {
+            area,
+            view,
+            xstep,
+            ystep,
+            ctm: cmd_ctm,
+        } => {
+            let final_ctm = cmd_ctm.concat(ctm);
+            device.begin_tile(*area, *view, *xstep, *ystep, &final_ctm);
+        }
+        Command::EndTile => {
+            device.end_tile();
+        }
+        Command::BeginLayer { name } => {
+            device.begin_layer(name);
+        }
+        Command::EndLayer => {
+            device.end_layer();
+        }
+    }
+}
+
+/// Which commands a replay leaves out: those of hidden layers, and all
+/// that are left once its cookie is aborted
+struct Replay<'a> {
+    visible: &'a dyn Fn(&str) -> bool,
+    /// Depth of hidden layers the replay is inside
+    hidden: usize,
+    /// Checked before each command and told of every one passed
+    cookie: Option<&'a Cookie>,
+}
+
+impl Replay<'_> {
+    /// Whether the cookie asks the replay to stop
+    fn aborted(&self) -> bool {
+        self.cookie.is_some_and(Cookie::should_abort)
+    }
+
+    /// Count `n` commands as done, run or not
+    fn advance(&self, n: usize) {
+        if let Some(cookie) = self.cookie {
+            cookie.add_progress(i32::try_from(n).unwrap_or(i32::MAX));
+        }
+    }
+
+    /// Whether `cmd` is left out, tracking layer brackets as it goes
+    fn skips(&mut self, cmd: &Command) -> bool {
+        match cmd {
+            Command::BeginLayer { name } => {
+                if self.hidden > 0 || !(self.visible)(name) {
+                    self.hidden += 1;
+                }
+            }
+            Command::EndLayer => {
+                if self.hidden > 0 {
+                    self.hidden -= 1;
+                    return true;
+                }
+            }
+            _ => {}
+        }
+        self.hidden > 0
     }
 }
 
 /// List device - records drawing operations to a display list
 pub struct ListDevice {
     list: DisplayList,
+    /// Shared list that receives the recorded commands on close
+    target: Option<Arc<Mutex<DisplayList>>>,
 }
 
 impl ListDevice {
@@ -330,6 +500,16 @@ impl ListDevice {
     pub fn new(mediabox: Rect) -> Self {
         Self {
             list: DisplayList::new(mediabox),
+            target: None,
+        }
+    }
+
+    /// Create a list device that appends to `target` when closed
+    pub fn with_target(target: Arc<Mutex<DisplayList>>) -> Self {
+        let mediabox = target.lock().map(|l| l.mediabox()).unwrap_or(Rect::EMPTY);
+        Self {
+            list: DisplayList::new(mediabox),
+            target: Some(target),
         }
     }
 
@@ -553,6 +733,1555 @@ impl Device for ListDevice {
     fn end_tile(&mut self) {
         self.list.commands.push(Command::EndTile);
     }
+
+    fn begin_layer(&mut self, name: &str) {
+        self.list
+            .commands
+            .push(Command::BeginLayer { name: name.into() });
+    }
+
+    fn end_layer(&mut self) {
+        self.list.commands.push(Command::EndLayer);
+    }
+
+    fn close(&mut self) {
+        if let Some(target) = self.target.take() {
+            if let Ok(mut list) = target.lock() {
+                list.commands.append(&mut self.list.commands);
+                list.index.take();
+                list.build_index();
+            }
+        }
+    }
+}
+
+// ============================================================================
+// Optimization
+// ============================================================================
+
+/// Box assumed to hold any glyph, in text space (units of the font size)
+///
+/// Glyph outlines aren't consulted, so this errs wide of the advance,
+/// ascender and descender of real fonts.
+const GLYPH_CULL_BOX: Rect = Rect {
+    x0: -1.0,
+    y0: -1.0,
+    x1: 2.0,
+    y1: 2.0,
+};
+
+impl DisplayList {
+    /// Optimize the list for repeated playback
+    ///
+    /// Drops drawing commands outside the mediabox or their clip, clip
+    /// blocks whose region is empty, rectangle clips that cover their
+    /// parent, and clips, masks and groups with nothing inside. Runs of
+    /// fills in one colour whose paths are disjoint become one fill.
+    ///
+    /// Playback is assumed to be confined to the mediabox. Tile cells are
+    /// left alone, since they repeat outside their own bounds.
+    ///
+    /// Returns the number of commands removed.
+    pub fn optimize(&mut self) -> usize {
+        let before = self.commands.len();
+        let page = if self.mediabox.is_empty() {
+            Rect::INFINITE
+        } else {
+            self.mediabox
+        };
+        let commands = std::mem::take(&mut self.commands);
+        let ends = match_ends(&commands);
+        let mut out: Vec<Command> = Vec::with_capacity(commands.len());
+        // Enclosing clip bbox of each open clip, and whether it was kept
+        let mut clips: Vec<(Rect, bool)> = Vec::new();
+        let mut clip = page;
+        // Union of the paths merged into the fill at the end of `out`
+        let mut fill_run = Rect::EMPTY;
+        let mut tiles = 0usize;
+        let mut resume = 0;
+
+        for (i, cmd) in commands.into_iter().enumerate() {
+            if i < resume {
+                continue;
+            }
+            if tiles > 0 {
+                match cmd {
+                    Command::BeginTile { .. } => tiles += 1,
+                    Command::EndTile => tiles -= 1,
+                    _ => {}
+                }
+                out.push(cmd);
+                continue;
+            }
+            match cmd {
+                Command::BeginTile { .. } => {
+                    tiles = 1;
+                    out.push(cmd);
+                }
+                Command::PopClip => match clips.pop() {
+                    Some((parent, kept)) => {
+                        clip = parent;
+                        if !kept {
+                            continue;
+                        }
+                        match out.as_slice() {
+                            [.., last] if is_clip(last) => {
+                                out.pop();
+                            }
+                            [.., Command::BeginMask { .. }, Command::EndMask] => {
+                                out.truncate(out.len() - 2);
+                            }
+                            _ => out.push(cmd),
+                        }
+                    }
+                    None => out.push(cmd),
+                },
+                Command::BeginMask { .. } => {
+                    clips.push((clip, true));
+                    out.push(cmd);
+                }
+                Command::EndGroup => {
+                    if let Some(Command::BeginGroup { .. }) = out.last() {
+                        out.pop();
+                    } else {
+                        out.push(cmd);
+                    }
+                }
+                Command::EndLayer => {
+                    if let Some(Command::BeginLayer { .. }) = out.last() {
+                        out.pop();
+                    } else {
+                        out.push(cmd);
+                    }
+                }
+                _ if is_clip(&cmd) => {
+                    let region = command_bounds(&cmd);
+                    if ends[i] > i && !region.intersects(&clip) {
+                        resume = ends[i] + 1;
+                    } else if covers_clip(&cmd, &clip) {
+                        clips.push((clip, false));
+                    } else {
+                        clips.push((clip, true));
+                        clip = region.intersect(&clip);
+                        out.push(cmd);
+                    }
+                }
+                _ if is_drawing(&cmd) => {
+                    let bbox = command_bounds(&cmd);
+                    if !bbox.intersects(&clip) {
+                        continue;
+                    }
+                    if let Command::FillPath { path, .. } = &cmd {
+                        let mergeable = out.last().is_some_and(|last| same_fill(last, &cmd));
+                        if mergeable && !bbox.intersects(&fill_run) {
+                            if let Some(Command::FillPath { path: run, .. }) = out.last_mut() {
+                                run.append(path);
+                            }
+                            fill_run = fill_run.union(&bbox);
+                            continue;
+                        }
+                        fill_run = bbox;
+                    }
+                    out.push(cmd);
+                }
+                _ => out.push(cmd),
+            }
+        }
+
+        self.commands = out;
+        self.index.take();
+        before - self.commands.len()
+    }
+}
+
+/// For each clip, mask, group, tile or layer, the index of the command closing
+/// it; otherwise the command's own index
+fn match_ends(commands: &[Command]) -> Vec<usize> {
+    let mut ends: Vec<usize> = (0..commands.len()).collect();
+    let mut open: Vec<usize> = Vec::new();
+    for (i, cmd) in commands.iter().enumerate() {
+        match cmd {
+            Command::PopClip | Command::EndGroup | Command::EndTile | Command::EndLayer => {
+                // A closer of the wrong kind for the innermost block is stray
+                if let Some(&start) = open.last().filter(|&&s| closes(&commands[s], cmd)) {
+                    open.pop();
+                    ends[start] = i;
+                }
+            }
+            Command::BeginMask { .. }
+            | Command::BeginGroup { .. }
+            | Command::BeginTile { .. }
+            | Command::BeginLayer { .. } => open.push(i),
+            _ if is_clip(cmd) => open.push(i),
+            _ => {}
+        }
+    }
+    ends
+}
+
+/// Whether `close` ends a block opened by `open`
+fn closes(open: &Command, close: &Command) -> bool {
+    match close {
+        Command::PopClip => is_clip(open) || matches!(open, Command::BeginMask { .. }),
+        Command::EndGroup => matches!(open, Command::BeginGroup { .. }),
+        Command::EndTile => matches!(open, Command::BeginTile { .. }),
+        Command::EndLayer => matches!(open, Command::BeginLayer { .. }),
+        _ => false,
+    }
+}
+
+/// Whether a command opens a clip closed by PopClip (masks aside)
+fn is_clip(cmd: &Command) -> bool {
+    matches!(
+        cmd,
+        Command::ClipPath { .. }
+            | Command::ClipStrokePath { .. }
+            | Command::ClipText { .. }
+            | Command::ClipStrokeText { .. }
+            | Command::ClipImageMask { .. }
+    )
+}
+
+/// Whether a command marks the page
+fn is_drawing(cmd: &Command) -> bool {
+    matches!(
+        cmd,
+        Command::FillPath { .. }
+            | Command::StrokePath { .. }
+            | Command::FillText { .. }
+            | Command::StrokeText { .. }
+            | Command::FillImage { .. }
+            | Command::FillImageMask { .. }
+    )
+}
+
+/// Whether a clip is a rectangle covering the whole of `clip`
+fn covers_clip(cmd: &Command, clip: &Rect) -> bool {
+    let Command::ClipPath { path, ctm, .. } = cmd else {
+        return false;
+    };
+    let [PathElement::Rect(r)] = path.elements() else {
+        return false;
+    };
+    if ctm.b != 0.0 || ctm.c != 0.0 {
+        return false;
+    }
+    let r = r.transform(ctm);
+    r.x0 <= clip.x0 && r.y0 <= clip.y0 && r.x1 >= clip.x1 && r.y1 >= clip.y1
+}
+
+/// Whether two fills paint with the same colour and rule, so their paths
+/// can share a command
+fn same_fill(a: &Command, b: &Command) -> bool {
+    match (a, b) {
+        (
+            Command::FillPath {
+                even_odd: eo1,
+                ctm: m1,
+                colorspace: cs1,
+                color: c1,
+                alpha: a1,
+                ..
+            },
+            Command::FillPath {
+                even_odd: eo2,
+                ctm: m2,
+                colorspace: cs2,
+                color: c2,
+                alpha: a2,
+                ..
+            },
+        ) => {
+            eo1 == eo2
+                && m1 == m2
+                && cs1.name() == cs2.name()
+                && cs1.n() == cs2.n()
+                && c1 == c2
+                && a1 == a2
+        }
+        _ => false,
+    }
+}
+
+/// Conservative bbox of what a drawing or clip command covers, in list
+/// space; infinite for the rest
+fn command_bounds(cmd: &Command) -> Rect {
+    match cmd {
+        Command::FillPath { path, ctm, .. } | Command::ClipPath { path, ctm, .. } => {
+            path.bounds().transform(ctm)
+        }
+        Command::StrokePath {
+            path, stroke, ctm, ..
+        }
+        | Command::ClipStrokePath {
+            path, stroke, ctm, ..
+        } => path.bounds().expand(stroke_reach(stroke)).transform(ctm),
+        Command::FillText { text, ctm, .. }
+        | Command::ClipText { text, ctm, .. }
+        | Command::IgnoreText { text, ctm } => text_bounds(text).transform(ctm),
+        Command::StrokeText {
+            text, stroke, ctm, ..
+        }
+        | Command::ClipStrokeText {
+            text, stroke, ctm, ..
+        } => text_bounds(text)
+            .expand(stroke_reach(stroke))
+            .transform(ctm),
+        Command::FillImage { ctm, .. }
+        | Command::FillImageMask { ctm, .. }
+        | Command::ClipImageMask { ctm, .. } => Rect::UNIT.transform(ctm),
+        _ => Rect::INFINITE,
+    }
+}
+
+/// How far a stroke can reach past its path, allowing for miters and
+/// square caps
+fn stroke_reach(stroke: &StrokeState) -> f32 {
+    // Hairlines still cover a pixel
+    let half = (stroke.linewidth.abs() * 0.5).max(0.5);
+    let miter = match stroke.linejoin {
+        LineJoin::Miter | LineJoin::MiterXPS => stroke.miterlimit.max(1.0),
+        _ => 1.0,
+    };
+    half * miter.max(std::f32::consts::SQRT_2)
+}
+
+/// Bbox of a text object's glyphs in user space
+fn text_bounds(text: &Text) -> Rect {
+    let mut bbox = Rect::EMPTY;
+    for span in text.spans() {
+        let m = span.trm;
+        for item in span.items() {
+            let trm = Matrix::new(m.a, m.b, m.c, m.d, item.x, item.y);
+            bbox = bbox.union(&GLYPH_CULL_BOX.transform(&trm));
+        }
+    }
+    bbox
+}
+
+// ============================================================================
+// Spatial index
+// ============================================================================
+
+/// Most children an index node holds before siblings are chunked
+const INDEX_FANOUT: usize = 16;
+
+/// Bbox tree over a list's commands for scissored playback
+///
+/// Clip, mask, group and tile blocks are nodes, so a scissor that misses
+/// one skips it with its contents; long runs of siblings are chunked
+/// into nodes of up to `INDEX_FANOUT` so dense pages skip by the chunk.
+#[derive(Clone)]
+struct ListIndex {
+    /// Per-command bbox in list space, within its clips
+    bounds: Vec<Rect>,
+    /// Tree nodes, each node's children contiguous; the root is last
+    nodes: Vec<IndexNode>,
+}
+
+/// A run of commands covered by one bbox
+///
+/// Commands in the run that aren't under a child node are tested and
+/// run one by one.
+#[derive(Clone)]
+struct IndexNode {
+    /// What the run draws, or infinite if it mustn't be skipped
+    bbox: Rect,
+    commands: Range<usize>,
+    children: Range<usize>,
+}
+
+/// A node-to-be while the index is built
+struct Sibling {
+    commands: Range<usize>,
+    /// What the run draws
+    extent: Rect,
+    /// Whether the run holds a command that must not be skipped
+    pinned: bool,
+    node: Option<IndexNode>,
+}
+
+impl ListIndex {
+    fn build(commands: &[Command]) -> Self {
+        let mut index = Self {
+            bounds: command_extents(commands),
+            nodes: Vec::new(),
+        };
+        let ends = match_ends(commands);
+        let top = index.level(commands, &ends, 0..commands.len());
+        let root = index.parent(Rect::INFINITE, 0..commands.len(), top);
+        index.nodes.push(root);
+        index
+    }
+
+    /// Split `span` into single commands and blocks
+    fn level(&mut self, commands: &[Command], ends: &[usize], span: Range<usize>) -> Vec<Sibling> {
+        let mut siblings = Vec::new();
+        let mut i = span.start;
+        while i < span.end {
+            let cmd = &commands[i];
+            let end = ends[i];
+            if end <= i || end >= span.end {
+                // A stray opener or closer has to run whatever the scissor
+                let drawn = is_drawing(cmd) || matches!(cmd, Command::IgnoreText { .. });
+                siblings.push(Sibling {
+                    commands: i..i + 1,
+                    extent: if drawn { self.bounds[i] } else { Rect::EMPTY },
+                    pinned: !drawn,
+                    node: None,
+                });
+                i += 1;
+                continue;
+            }
+            let kids = self.level(commands, ends, i + 1..end);
+            let mut extent = kids.iter().fold(Rect::EMPTY, |r, k| r.union(&k.extent));
+            let mut pinned = kids.iter().any(|k| k.pinned);
+            match cmd {
+                Command::BeginTile { .. } => extent = Rect::INFINITE,
+                // Only what follows the EndMask is drawn, and the EndMask
+                // itself goes with the mask
+                Command::BeginMask { .. } => {
+                    let is_end = |k: &Sibling| {
+                        k.node.is_none() && matches!(commands[k.commands.start], Command::EndMask)
+                    };
+                    if let Some(at) = kids.iter().position(is_end) {
+                        extent = kids[at + 1..]
+                            .iter()
+                            .fold(Rect::EMPTY, |r, k| r.union(&k.extent));
+                    }
+                    pinned = kids.iter().any(|k| k.pinned && !is_end(k));
+                }
+                _ if is_clip(cmd) => extent = extent.intersect(&self.bounds[i]),
+                _ => {}
+            }
+            let bbox = if pinned { Rect::INFINITE } else { extent };
+            let node = self.parent(bbox, i..end + 1, kids);
+            siblings.push(Sibling {
+                commands: i..end + 1,
+                extent,
+                pinned,
+                node: Some(node),
+            });
+            i = end + 1;
+        }
+        siblings
+    }
+
+    /// Make a node over `commands` with `kids` under it, chunking them
+    /// while there are more than `INDEX_FANOUT`
+    fn parent(&mut self, bbox: Rect, commands: Range<usize>, mut kids: Vec<Sibling>) -> IndexNode {
+        while kids.len() > INDEX_FANOUT {
+            let mut chunks = Vec::with_capacity(kids.len().div_ceil(INDEX_FANOUT));
+            for chunk in kids.chunks(INDEX_FANOUT) {
+                let extent = chunk.iter().fold(Rect::EMPTY, |r, k| r.union(&k.extent));
+                let pinned = chunk.iter().any(|k| k.pinned);
+                let span = chunk[0].commands.start..chunk[chunk.len() - 1].commands.end;
+                let node = IndexNode {
+                    bbox: if pinned { Rect::INFINITE } else { extent },
+                    commands: span.clone(),
+                    children: self.store(chunk),
+                };
+                chunks.push(Sibling {
+                    commands: span,
+                    extent,
+                    pinned,
+                    node: Some(node),
+                });
+            }
+            kids = chunks;
+        }
+        IndexNode {
+            bbox,
+            commands,
+            children: self.store(&kids),
+        }
+    }
+
+    /// Append the nodes among `siblings`, returning where they went
+    fn store(&mut self, siblings: &[Sibling]) -> Range<usize> {
+        let start = self.nodes.len();
+        self.nodes
+            .extend(siblings.iter().filter_map(|s| s.node.clone()));
+        start..self.nodes.len()
+    }
+
+    /// Run the commands under `node` that may touch `scissor`
+    fn run(
+        &self,
+        commands: &[Command],
+        node: &IndexNode,
+        device: &mut dyn Device,
+        ctm: &Matrix,
+        scissor: Rect,
+        replay: &mut Replay<'_>,
+    ) {
+        let mut next = node.commands.start;
+        for kid in &self.nodes[node.children.clone()] {
+            let span = next..kid.commands.start;
+            self.run_span(commands, span, device, ctm, scissor, replay);
+            if replay.aborted() {
+                return;
+            }
+            // A skipped node's layer brackets pair up inside it
+            if touches(&kid.bbox, ctm, &scissor) {
+                self.run(commands, kid, device, ctm, scissor, replay);
+            } else {
+                replay.advance(kid.commands.len());
+            }
+            next = kid.commands.end;
+        }
+        let span = next..node.commands.end;
+        self.run_span(commands, span, device, ctm, scissor, replay);
+    }
+
+    /// Run single commands, skipping drawing the scissor misses
+    fn run_span(
+        &self,
+        commands: &[Command],
+        span: Range<usize>,
+        device: &mut dyn Device,
+        ctm: &Matrix,
+        scissor: Rect,
+        replay: &mut Replay<'_>,
+    ) {
+        for i in span {
+            if replay.aborted() {
+                return;
+            }
+            replay.advance(1);
+            let cmd = &commands[i];
+            let drawn = is_drawing(cmd) || matches!(cmd, Command::IgnoreText { .. });
+            if drawn && !touches(&self.bounds[i], ctm, &scissor) {
+                continue;
+            }
+            if replay.skips(cmd) {
+                continue;
+            }
+            run_command(cmd, device, ctm, scissor);
+        }
+    }
+
+    fn approx_size(&self) -> usize {
+        self.bounds.capacity() * std::mem::size_of::<Rect>()
+            + self.nodes.capacity() * std::mem::size_of::<IndexNode>()
+    }
+}
+
+/// Each command's bbox in list space, within its clips; infinite for
+/// structure and tile contents
+fn command_extents(commands: &[Command]) -> Vec<Rect> {
+    let mut bounds = Vec::with_capacity(commands.len());
+    let mut clips = Vec::new();
+    let mut clip = Rect::INFINITE;
+    let mut tiles = 0usize;
+    for cmd in commands {
+        let mut bbox = Rect::INFINITE;
+        match cmd {
+            Command::BeginTile { .. } => tiles += 1,
+            Command::EndTile => tiles = tiles.saturating_sub(1),
+            _ if tiles > 0 => {}
+            Command::BeginMask { .. } => clips.push(clip),
+            Command::PopClip => clip = clips.pop().unwrap_or(Rect::INFINITE),
+            _ if is_clip(cmd) => {
+                clips.push(clip);
+                clip = command_bounds(cmd).intersect(&clip);
+                bbox = clip;
+            }
+            Command::IgnoreText { .. } => bbox = command_bounds(cmd).intersect(&clip),
+            _ if is_drawing(cmd) => bbox = command_bounds(cmd).intersect(&clip),
+            _ => {}
+        }
+        bounds.push(bbox);
+    }
+    bounds
+}
+
+/// Whether a list-space bbox may touch `scissor` when run under `ctm`
+fn touches(bbox: &Rect, ctm: &Matrix, scissor: &Rect) -> bool {
+    if bbox.is_empty() {
+        return false;
+    }
+    if ![bbox.x0, bbox.y0, bbox.x1, bbox.y1]
+        .iter()
+        .all(|v| v.is_finite())
+    {
+        return true;
+    }
+    // A device pixel of slack for antialiasing
+    bbox.transform(ctm).expand(1.0).intersects(scissor)
+}
+
+// ============================================================================
+// Serialization
+// ============================================================================
+
+/// Serialized list magic
+const LIST_MAGIC: &[u8; 4] = b"MPDL";
+
+/// Current serialized list format version
+///
+/// Version 2 added layer brackets; version 1 lists still read.
+pub const DISPLAY_LIST_VERSION: u32 = 2;
+
+/// Serialized list header size
+const LIST_HEADER_LEN: usize = 16;
+
+/// A font program or image's data that a serialized list names by hash
+pub struct ListResource<'a> {
+    /// SHA-256 of the data
+    pub hash: [u8; 32],
+    pub data: &'a [u8],
+}
+
+impl DisplayList {
+    /// Serialize the list
+    ///
+    /// Commands, paths and text runs are written in full. Fonts and images
+    /// are written once each however many commands use them, with their
+    /// data named by SHA-256: stored inline with `embed`, otherwise left
+    /// for the reader to supply (see [`DisplayList::resources`]).
+    ///
+    /// Layout: a 16-byte header (`MPDL`, version, 8 reserved bytes), the
+    /// mediabox, then the font table, the image table and the commands,
+    /// each led by its count. Numbers are little-endian.
+    pub fn to_bytes(&self, embed: bool) -> Vec<u8> {
+        let mut enc = ListEncoder {
+            embed,
+            ..Default::default()
+        };
+        self.commands.iter().for_each(|cmd| enc.command(cmd));
+
+        let mut out = Vec::with_capacity(
+            LIST_HEADER_LEN + 28 + enc.fonts.len() + enc.images.len() + enc.commands.len(),
+        );
+        out.extend_from_slice(LIST_MAGIC);
+        put_u32(&mut out, DISPLAY_LIST_VERSION);
+        out.extend_from_slice(&[0; 8]);
+        put_rect(&mut out, &self.mediabox);
+        put_u32(&mut out, enc.font_ids.len() as u32);
+        out.extend_from_slice(&enc.fonts);
+        put_u32(&mut out, enc.image_ids.len() as u32);
+        out.extend_from_slice(&enc.images);
+        put_u32(&mut out, self.commands.len() as u32);
+        out.extend_from_slice(&enc.commands);
+        out
+    }
+
+    /// The font programs and image data the list uses, once each
+    ///
+    /// These are what a list serialized without `embed` leaves out; store
+    /// them by hash for [`DisplayList::from_bytes`] to fetch.
+    pub fn resources(&self) -> Vec<ListResource<'_>> {
+        let mut enc = ListEncoder::default();
+        self.commands.iter().for_each(|cmd| enc.command(cmd));
+        enc.resources
+    }
+
+    /// Read a list written by [`DisplayList::to_bytes`]
+    ///
+    /// Data that was not stored inline comes from `fetch`, given its hash.
+    /// Font faces already in the face cache, such as those of an open
+    /// context snapshot, are used without fetching.
+    pub fn from_bytes(
+        bytes: &[u8],
+        fetch: &mut dyn FnMut(&[u8; 32]) -> Option<Vec<u8>>,
+    ) -> Result<Self> {
+        if bytes.len() < LIST_HEADER_LEN || &bytes[..4] != LIST_MAGIC {
+            return Err(Error::format("not a serialized display list"));
+        }
+        let version = u32::from_le_bytes([bytes[4], bytes[5], bytes[6], bytes[7]]);
+        if !(1..=DISPLAY_LIST_VERSION).contains(&version) {
+            return Err(Error::format(format!(
+                "unsupported display list version {version}"
+            )));
+        }
+
+        let mut r = ListReader {
+            bytes: &bytes[LIST_HEADER_LEN..],
+            fonts: Vec::new(),
+            images: Vec::new(),
+        };
+        let mediabox = r.rect()?;
+        for _ in 0..r.len()? {
+            let font = r.font(fetch)?;
+            r.fonts.push(font);
+        }
+        for _ in 0..r.len()? {
+            let image = r.image(fetch)?;
+            r.images.push(image);
+        }
+        let count = r.len()?;
+        let mut commands = Vec::with_capacity(count.min(r.bytes.len()));
+        for _ in 0..count {
+            commands.push(r.command()?);
+        }
+        let mut list = Self::new(mediabox);
+        list.commands = commands;
+        Ok(list)
+    }
+}
+
+fn put_u16(out: &mut Vec<u8>, v: u16) {
+    out.extend_from_slice(&v.to_le_bytes());
+}
+
+fn put_u32(out: &mut Vec<u8>, v: u32) {
+    out.extend_from_slice(&v.to_le_bytes());
+}
+
+fn put_i32(out: &mut Vec<u8>, v: i32) {
+    out.extend_from_slice(&v.to_le_bytes());
+}
+
+fn put_f32(out: &mut Vec<u8>, v: f32) {
+    out.extend_from_slice(&v.to_le_bytes());
+}
+
+fn put_bytes(out: &mut Vec<u8>, data: &[u8]) {
+    put_u32(out, data.len() as u32);
+    out.extend_from_slice(data);
+}
+
+fn put_floats(out: &mut Vec<u8>, values: &[f32]) {
+    put_u32(out, values.len() as u32);
+    values.iter().for_each(|&v| put_f32(out, v));
+}
+
+fn put_matrix(out: &mut Vec<u8>, m: &Matrix) {
+    [m.a, m.b, m.c, m.d, m.e, m.f]
+        .into_iter()
+        .for_each(|v| put_f32(out, v));
+}
+
+fn put_rect(out: &mut Vec<u8>, r: &Rect) {
+    [r.x0, r.y0, r.x1, r.y1]
+        .into_iter()
+        .for_each(|v| put_f32(out, v));
+}
+
+fn put_colorspace(out: &mut Vec<u8>, cs: Option<&Colorspace>) {
+    match cs {
+        Some(cs) => {
+            out.push(cs.n());
+            put_bytes(out, cs.name().as_bytes());
+        }
+        None => out.push(0),
+    }
+}
+
+fn put_stroke(out: &mut Vec<u8>, stroke: &StrokeState) {
+    put_f32(out, stroke.linewidth);
+    put_f32(out, stroke.miterlimit);
+    out.extend_from_slice(&[
+        stroke.start_cap as u8,
+        stroke.dash_cap as u8,
+        stroke.end_cap as u8,
+        stroke.linejoin as u8,
+    ]);
+    put_f32(out, stroke.dash_phase);
+    put_floats(out, &stroke.dash_pattern);
+}
+
+/// Builds the tables and command stream of a serialized list
+#[derive(Default)]
+struct ListEncoder<'a> {
+    embed: bool,
+    fonts: Vec<u8>,
+    /// Font table index by font, so spans sharing a font share its entry
+    font_ids: HashMap<*const Font, u32>,
+    images: Vec<u8>,
+    /// Image table index by data hash and description
+    image_ids: HashMap<([u8; 32], Vec<u8>), u32>,
+    commands: Vec<u8>,
+    resources: Vec<ListResource<'a>>,
+}
+
+impl<'a> ListEncoder<'a> {
+    /// Append a reference to `data`, inline if embedding
+    fn blob(&mut self, out: &mut Vec<u8>, hash: [u8; 32], data: &'a [u8]) {
+        out.extend_from_slice(&hash);
+        let inline = self.embed || data.is_empty();
+        out.push(inline as u8);
+        if inline {
+            put_bytes(out, data);
+        }
+        if !data.is_empty() && !self.resources.iter().any(|r| r.hash == hash) {
+            self.resources.push(ListResource { hash, data });
+        }
+    }
+
+    fn font(&mut self, font: &'a Arc<Font>) -> u32 {
+        if let Some(&id) = self.font_ids.get(&Arc::as_ptr(font)) {
+            return id;
+        }
+        let mut rec = Vec::new();
+        put_bytes(&mut rec, font.name().as_bytes());
+        put_bytes(&mut rec, font.font_type().to_string().as_bytes());
+        put_u32(&mut rec, font.flags().value());
+        put_u16(&mut rec, font.weight().value());
+        rec.push(font.stretch() as u8);
+        rec.push(font.is_italic() as u8);
+        match font.encoding() {
+            Some(encoding) => {
+                rec.push(1);
+                put_bytes(&mut rec, encoding.as_bytes());
+            }
+            None => rec.push(0),
+        }
+        let m = font.metrics();
+        [
+            m.ascender,
+            m.descender,
+            m.line_height,
+            m.cap_height,
+            m.x_height,
+            m.italic_angle,
+            m.underline_position,
+            m.underline_thickness,
+        ]
+        .into_iter()
+        .for_each(|v| put_f32(&mut rec, v));
+        match font.face() {
+            Some(face) => {
+                rec.push(1);
+                put_u32(&mut rec, face.index() as u32);
+                self.blob(&mut rec, face.content_hash(), face.data());
+            }
+            None => rec.push(0),
+        }
+
+        let id = self.font_ids.len() as u32;
+        self.font_ids.insert(Arc::as_ptr(font), id);
+        self.fonts.extend_from_slice(&rec);
+        id
+    }
+
+    fn image(&mut self, image: &'a Image) -> u32 {
+        // A mask goes in the table ahead of the image using it
+        let mask = image.mask().map_or(0, |m| self.image(m) + 1);
+        let pixmap = image.cached_pixmap().filter(|_| image.data().is_empty());
+        let data = pixmap.map_or(image.data(), Pixmap::samples);
+        let hash: [u8; 32] = Sha256::digest(data).into();
+
+        let mut rec = Vec::new();
+        put_i32(&mut rec, image.width());
+        put_i32(&mut rec, image.height());
+        rec.push(image.bpc());
+        put_colorspace(&mut rec, image.colorspace());
+        rec.push(image.format() as u8);
+        rec.push((image.mask_type() == MaskType::Stencil) as u8);
+        let (xres, yres) = image.resolution();
+        put_i32(&mut rec, xres);
+        put_i32(&mut rec, yres);
+        rec.push(image.interpolate() as u8);
+        match pixmap {
+            Some(pix) => {
+                rec.push(1);
+                put_colorspace(&mut rec, pix.colorspace());
+                rec.push(pix.has_alpha() as u8);
+            }
+            None => rec.push(0),
+        }
+        put_u32(&mut rec, mask);
+
+        let key = (hash, rec);
+        if let Some(&id) = self.image_ids.get(&key) {
+            return id;
+        }
+        let id = self.image_ids.len() as u32;
+        let mut rec = key.1.clone();
+        self.image_ids.insert(key, id);
+        self.blob(&mut rec, hash, data);
+        self.images.extend_from_slice(&rec);
+        id
+    }
+
+    fn text(&mut self, text: &'a Text) {
+        put_u32(&mut self.commands, text.spans().len() as u32);
+        for span in text.spans() {
+            let font = self.font(&span.font);
+            let out = &mut self.commands;
+            put_u32(out, font);
+            put_matrix(out, &span.trm);
+            out.extend_from_slice(&[span.wmode as u8, span.bidi_level, span.markup_dir as u8]);
+            put_u16(out, span.language as u16);
+            put_u32(out, span.items().len() as u32);
+            for item in span.items() {
+                put_f32(out, item.x);
+                put_f32(out, item.y);
+                put_f32(out, item.advance);
+                put_i32(out, item.gid);
+                put_i32(out, item.ucs);
+                put_i32(out, item.cid);
+            }
+        }
+    }
+
+    /// Append a command: its tag (the variant's position in [`Command`])
+    /// and then its fields in declaration order
+    fn command(&mut self, cmd: &'a Command) {
+        match cmd {
+            Command::FillPath {
+                path,
+                even_odd,
+                ctm,
+                colorspace,
+                color,
+                alpha,
+            } => {
+                let out = &mut self.commands;
+                out.push(0);
+                put_bytes(out, &path.to_bytes());
+                out.push(*even_odd as u8);
+                put_matrix(out, ctm);
+                put_colorspace(out, Some(colorspace));
+                put_floats(out, color);
+                put_f32(out, *alpha);
+            }
+            Command::StrokePath {
+                path,
+                stroke,
+                ctm,
+                colorspace,
+                color,
+                alpha,
+            } => {
+                let out = &mut self.commands;
+                out.push(1);
+                put_bytes(out, &path.to_bytes());
+                put_stroke(out, stroke);
+                put_matrix(out, ctm);
+                put_colorspace(out, Some(colorspace));
+                put_floats(out, color);
+                put_f32(out, *alpha);
+            }
+            Command::ClipPath {
+                path,
+                even_odd,
+                ctm,
+                scissor,
+            } => {
+                let out = &mut self.commands;
+                out.push(2);
+                put_bytes(out, &path.to_bytes());
+                out.push(*even_odd as u8);
+                put_matrix(out, ctm);
+                put_rect(out, scissor);
+            }
+            Command::ClipStrokePath {
+                path,
+                stroke,
+                ctm,
+                scissor,
+            } => {
+                let out = &mut self.commands;
+                out.push(3);
+                put_bytes(out, &path.to_bytes());
+                put_stroke(out, stroke);
+                put_matrix(out, ctm);
+                put_rect(out, scissor);
+            }
+            Command::FillText {
+                text,
+                ctm,
+                colorspace,
+                color,
+                alpha,
+            } => {
+                self.commands.push(4);
+                self.text(text);
+                let out = &mut self.commands;
+                put_matrix(out, ctm);
+                put_colorspace(out, Some(colorspace));
+                put_floats(out, color);
+                put_f32(out, *alpha);
+            }
+            Command::StrokeText {
+                text,
+                stroke,
+                ctm,
+                colorspace,
+                color,
+                alpha,
+            } => {
+                self.commands.push(5);
+                self.text(text);
+                let out = &mut self.commands;
+                put_stroke(out, stroke);
+                put_matrix(out, ctm);
+                put_colorspace(out, Some(colorspace));
+                put_floats(out, color);
+                put_f32(out, *alpha);
+            }
+            Command::ClipText { text, ctm, scissor } => {
+                self.commands.push(6);
+                self.text(text);
+                put_matrix(&mut self.commands, ctm);
+                put_rect(&mut self.commands, scissor);
+            }
+            Command::ClipStrokeText {
+                text,
+                stroke,
+                ctm,
+                scissor,
+            } => {
+                self.commands.push(7);
+                self.text(text);
+                let out = &mut self.commands;
+                put_stroke(out, stroke);
+                put_matrix(out, ctm);
+                put_rect(out, scissor);
+            }
+            Command::IgnoreText { text, ctm } => {
+                self.commands.push(8);
+                self.text(text);
+                put_matrix(&mut self.commands, ctm);
+            }
+            Command::FillImage { image, ctm, alpha } => {
+                let image = self.image(image);
+                let out = &mut self.commands;
+                out.push(9);
+                put_u32(out, image);
+                put_matrix(out, ctm);
+                put_f32(out, *alpha);
+            }
+            Command::FillImageMask {
+                image,
+                ctm,
+                colorspace,
+                color,
+                alpha,
+            } => {
+                let image = self.image(image);
+                let out = &mut self.commands;
+                out.push(10);
+                put_u32(out, image);
+                put_matrix(out, ctm);
+                put_colorspace(out, Some(colorspace));
+                put_floats(out, color);
+                put_f32(out, *alpha);
+            }
+            Command::ClipImageMask {
+                image,
+                ctm,
+                scissor,
+            } => {
+                let image = self.image(image);
+                let out = &mut self.commands;
+                out.push(11);
+                put_u32(out, image);
+                put_matrix(out, ctm);
+                put_rect(out, scissor);
+            }
+            Command::PopClip => self.commands.push(12),
+            Command::BeginMask {
+                area,
+                luminosity,
+                colorspace,
+                color,
+            } => {
+                let out = &mut self.commands;
+                out.push(13);
+                put_rect(out, area);
+                out.push(*luminosity as u8);
+                put_colorspace(out, Some(colorspace));
+                put_floats(out, color);
+            }
+            Command::EndMask => self.commands.push(14),
+            Command::BeginGroup {
+                area,
+                colorspace,
+                isolated,
+                knockout,
+                blendmode,
+                alpha,
+            } => {
+                let out = &mut self.commands;
+                out.push(15);
+                put_rect(out, area);
+                put_colorspace(out, colorspace.as_ref());
+                out.extend_from_slice(&[*isolated as u8, *knockout as u8, *blendmode as u8]);
+                put_f32(out, *alpha);
+            }
+            Command::EndGroup => self.commands.push(16),
+            Command::BeginTile {
+                area,
+                view,
+                xstep,
+                ystep,
+                ctm,
+            } => {
+                let out = &mut self.commands;
+                out.push(17);
+                put_rect(out, area);
+                put_rect(out, view);
+                put_f32(out, *xstep);
+                put_f32(out, *ystep);
+                put_matrix(out, ctm);
+            }
+            Command::EndTile => self.commands.push(18),
+            Command::BeginLayer { name } => {
+                self.commands.push(19);
+                put_bytes(&mut self.commands, name.as_bytes());
+            }
+            Command::EndLayer => self.commands.push(20),
+        }
+    }
+}
+
+fn truncated() -> Error {
+    Error::format("truncated display list")
+}
+
+/// The value with code `code` in a C-like enum's declaration order
+fn pick<T: Copy>(values: &[T], code: u8) -> Result<T> {
+    values
+        .get(code as usize)
+        .copied()
+        .ok_or_else(|| Error::format(format!("bad enum code {code} in display list")))
+}
+
+fn hex(hash: &[u8; 32]) -> String {
+    hash.iter().map(|b| format!("{b:02x}")).collect()
+}
+
+/// Reads a serialized list, holding the font and image tables read so far
+struct ListReader<'a> {
+    bytes: &'a [u8],
+    fonts: Vec<Arc<Font>>,
+    images: Vec<Image>,
+}
+
+impl<'a> ListReader<'a> {
+    fn take(&mut self, n: usize) -> Result<&'a [u8]> {
+        let (head, rest) = self.bytes.split_at_checked(n).ok_or_else(truncated)?;
+        self.bytes = rest;
+        Ok(head)
+    }
+
+    fn u8(&mut self) -> Result<u8> {
+        Ok(self.take(1)?[0])
+    }
+
+    fn bool(&mut self) -> Result<bool> {
+        Ok(self.u8()? != 0)
+    }
+
+    fn u16(&mut self) -> Result<u16> {
+        Ok(u16::from_le_bytes(self.take(2)?.try_into().unwrap()))
+    }
+
+    fn u32(&mut self) -> Result<u32> {
+        Ok(u32::from_le_bytes(self.take(4)?.try_into().unwrap()))
+    }
+
+    fn i32(&mut self) -> Result<i32> {
+        Ok(i32::from_le_bytes(self.take(4)?.try_into().unwrap()))
+    }
+
+    fn f32(&mut self) -> Result<f32> {
+        Ok(f32::from_le_bytes(self.take(4)?.try_into().unwrap()))
+    }
+
+    fn len(&mut self) -> Result<usize> {
+        Ok(self.u32()? as usize)
+    }
+
+    fn bytes(&mut self) -> Result<&'a [u8]> {
+        let len = self.len()?;
+        self.take(len)
+    }
+
+    fn str(&mut self) -> Result<&'a str> {
+        std::str::from_utf8(self.bytes()?).map_err(|_| Error::format("bad string in display list"))
+    }
+
+    fn floats(&mut self) -> Result<Vec<f32>> {
+        let len = self.len()?;
+        let data = self.take(len.checked_mul(4).ok_or_else(truncated)?)?;
+        Ok(data
+            .chunks_exact(4)
+            .map(|b| f32::from_le_bytes(b.try_into().unwrap()))
+            .collect())
+    }
+
+    fn matrix(&mut self) -> Result<Matrix> {
+        Ok(Matrix {
+            a: self.f32()?,
+            b: self.f32()?,
+            c: self.f32()?,
+            d: self.f32()?,
+            e: self.f32()?,
+            f: self.f32()?,
+        })
+    }
+
+    fn rect(&mut self) -> Result<Rect> {
+        Ok(Rect::new(
+            self.f32()?,
+            self.f32()?,
+            self.f32()?,
+            self.f32()?,
+        ))
+    }
+
+    /// Colorspaces other than the device ones come back as the device
+    /// space with the same number of components
+    fn colorspace(&mut self) -> Result<Option<Colorspace>> {
+        let n = self.u8()?;
+        if n == 0 {
+            return Ok(None);
+        }
+        Ok(Some(match (self.str()?, n) {
+            ("DeviceGray", _) | (_, 1) => Colorspace::device_gray(),
+            ("DeviceCMYK", _) | (_, 4) => Colorspace::device_cmyk(),
+            _ => Colorspace::device_rgb(),
+        }))
+    }
+
+    fn device_colorspace(&mut self) -> Result<Colorspace> {
+        self.colorspace()?
+            .ok_or_else(|| Error::format("missing colorspace in display list"))
+    }
+
+    fn path(&mut self) -> Result<Path> {
+        Path::from_bytes(self.bytes()?).ok_or_else(|| Error::format("bad path in display list"))
+    }
+
+    fn stroke(&mut self) -> Result<StrokeState> {
+        const CAPS: [LineCap; 4] = [
+            LineCap::Butt,
+            LineCap::Round,
+            LineCap::Square,
+            LineCap::Triangle,
+        ];
+        const JOINS: [LineJoin; 4] = [
+            LineJoin::Miter,
+            LineJoin::Round,
+            LineJoin::Bevel,
+            LineJoin::MiterXPS,
+        ];
+        Ok(StrokeState {
+            linewidth: self.f32()?,
+            miterlimit: self.f32()?,
+            start_cap: pick(&CAPS, self.u8()?)?,
+            dash_cap: pick(&CAPS, self.u8()?)?,
+            end_cap: pick(&CAPS, self.u8()?)?,
+            linejoin: pick(&JOINS, self.u8()?)?,
+            dash_phase: self.f32()?,
+            dash_pattern: self.floats()?,
+        })
+    }
+
+    /// Data stored inline, or `None` if the reader has to supply it
+    fn blob(&mut self) -> Result<([u8; 32], Option<&'a [u8]>)> {
+        let hash = self.take(32)?.try_into().unwrap();
+        let data = if self.bool()? {
+            Some(self.bytes()?)
+        } else {
+            None
+        };
+        Ok((hash, data))
+    }
+
+    fn font(&mut self, fetch: &mut dyn FnMut(&[u8; 32]) -> Option<Vec<u8>>) -> Result<Arc<Font>> {
+        let mut font = Font::with_type(self.str()?, FontType::from_string(self.str()?));
+        font.set_flags(FontFlags::new(self.u32()?));
+        font.set_weight(FontWeight::new(self.u16()?));
+        font.set_stretch(pick(
+            &[
+                FontStretch::UltraCondensed,
+                FontStretch::ExtraCondensed,
+                FontStretch::Condensed,
+                FontStretch::SemiCondensed,
+                FontStretch::Normal,
+                FontStretch::SemiExpanded,
+                FontStretch::Expanded,
+                FontStretch::ExtraExpanded,
+                FontStretch::UltraExpanded,
+            ],
+            self.u8()?.wrapping_sub(1),
+        )?);
+        font.set_italic(self.bool()?);
+        if self.bool()? {
+            font.set_encoding(Some(self.str()?.to_string()));
+        }
+        font.set_metrics(FontMetrics {
+            ascender: self.f32()?,
+            descender: self.f32()?,
+            line_height: self.f32()?,
+            cap_height: self.f32()?,
+            x_height: self.f32()?,
+            italic_angle: self.f32()?,
+            underline_position: self.f32()?,
+            underline_thickness: self.f32()?,
+        });
+        if self.bool()? {
+            let index = self.len()?;
+            let face = match self.blob()? {
+                (_, Some(data)) => FontFace::load(data, index),
+                (hash, None) => {
+                    let cached = cached_faces()
+                        .into_iter()
+                        .find(|f| f.index() == index && f.content_hash() == hash);
+                    match cached {
+                        Some(face) => face,
+                        None => {
+                            let data = fetch(&hash).ok_or_else(|| {
+                                Error::Font(format!("font program {} not available", hex(&hash)))
+                            })?;
+                            FontFace::load(&data, index)
+                        }
+                    }
+                }
+            };
+            font.set_face(face);
+        }
+        Ok(Arc::new(font))
+    }
+
+    fn image(&mut self, fetch: &mut dyn FnMut(&[u8; 32]) -> Option<Vec<u8>>) -> Result<Image> {
+        let (width, height) = (self.i32()?, self.i32()?);
+        let bpc = self.u8()?;
+        let colorspace = self.colorspace()?;
+        let format = pick(
+            &[
+                ImageFormat::Raw,
+                ImageFormat::Jpeg,
+                ImageFormat::Jpeg2000,
+                ImageFormat::Jbig2,
+                ImageFormat::Ccitt,
+                ImageFormat::Flate,
+                ImageFormat::Lzw,
+                ImageFormat::RunLength,
+            ],
+            self.u8()?,
+        )?;
+        let stencil = self.bool()?;
+        let (xres, yres) = (self.i32()?, self.i32()?);
+        let interpolate = self.bool()?;
+        let pixmap = if self.bool()? {
+            Some((self.colorspace()?, self.bool()?))
+        } else {
+            None
+        };
+        let mask = match self.len()? {
+            0 => None,
+            id => Some(self.images.get(id - 1).cloned().ok_or_else(truncated)?),
+        };
+        let fetched;
+        let data = match self.blob()? {
+            (_, Some(data)) => data,
+            (hash, None) => {
+                fetched = fetch(&hash).ok_or_else(|| {
+                    Error::Image(format!("image data {} not available", hex(&hash)))
+                })?;
+                &fetched[..]
+            }
+        };
+
+        let mut image = match pixmap {
+            Some((cs, alpha)) => {
+                let mut pix = Pixmap::new(cs, width, height, alpha)?;
+                if pix.samples().len() != data.len() {
+                    return Err(Error::format("bad pixmap size in display list"));
+                }
+                pix.samples_mut().copy_from_slice(data);
+                Image::new(width, height, Some(pix))
+            }
+            None if stencil => Image::from_mask(width, height, data.to_vec())?,
+            None if data.is_empty() => Image::new(width, height, None),
+            None => Image::from_compressed(width, height, bpc, colorspace, format, data.to_vec())?,
+        };
+        image.set_resolution(xres, yres);
+        image.set_interpolate(interpolate);
+        if mask.is_some() {
+            image.set_mask(mask);
+        }
+        Ok(image)
+    }
+
+    fn text(&mut self) -> Result<Text> {
+        let spans = self.len()?;
+        let mut text = Text::with_capacity(spans.min(self.bytes.len()));
+        for _ in 0..spans {
+            let font = self.len()?;
+            let font = self.fonts.get(font).cloned().ok_or_else(truncated)?;
+            let mut span = TextSpan::new(font, self.matrix()?);
+            span.wmode = self.bool()?;
+            span.bidi_level = self.u8()?;
+            span.markup_dir = pick(
+                &[
+                    BidiDirection::Ltr,
+                    BidiDirection::Rtl,
+                    BidiDirection::Neutral,
+                ],
+                self.u8()?,
+            )?;
+            let language = self.u16()?;
+            span.language = [
+                TextLanguage::Ur,
+                TextLanguage::Urd,
+                TextLanguage::Ko,
+                TextLanguage::Ja,
+                TextLanguage::Zh,
+                TextLanguage::ZhHans,
+                TextLanguage::ZhHant,
+            ]
+            .into_iter()
+            .find(|l| *l as u16 == language)
+            .unwrap_or(TextLanguage::Unset);
+            let items = self.len()?;
+            span.items_mut().reserve(items.min(self.bytes.len() / 24));
+            for _ in 0..items {
+                span.add_glyph(TextItem::with_advance(
+                    self.f32()?,
+                    self.f32()?,
+                    self.f32()?,
+                    self.i32()?,
+                    self.i32()?,
+                    self.i32()?,
+                ));
+            }
+            text.add_span(span);
+        }
+        Ok(text)
+    }
+
+    fn image_ref(&mut self) -> Result<Image> {
+        let id = self.len()?;
+        self.images.get(id).cloned().ok_or_else(truncated)
+    }
+
+    fn command(&mut self) -> Result<Command> {
+        Ok(match self.u8()? {
+            0 => Command::FillPath {
+                path: self.path()?,
+                even_odd: self.bool()?,
+                ctm: self.matrix()?,
+                colorspace: self.device_colorspace()?,
+                color: self.floats()?,
+                alpha: self.f32()?,
+            },
+            1 => Command::StrokePath {
+                path: self.path()?,
+                stroke: self.stroke()?,
+                ctm: self.matrix()?,
+                colorspace: self.device_colorspace()?,
+                color: self.floats()?,
+                alpha: self.f32()?,
+            },
+            2 => Command::ClipPath {
+                path: self.path()?,
+                even_odd: self.bool()?,
+                ctm: self.matrix()?,
+                scissor: self.rect()?,
+            },
+            3 => Command::ClipStrokePath {
+                path: self.path()?,
+                stroke: self.stroke()?,
+                ctm: self.matrix()?,
+                scissor: self.rect()?,
+            },
+            4 => Command::FillText {
+                text: self.text()?,
+                ctm: self.matrix()?,
+                colorspace: self.device_colorspace()?,
+                color: self.floats()?,
+                alpha: self.f32()?,
+            },
+            5 => Command::StrokeText {
+                text: self.text()?,
+                stroke: self.stroke()?,
+                ctm: self.matrix()?,
+                colorspace: self.device_colorspace()?,
+                color: self.floats()?,
+                alpha: self.f32()?,
+            },
+            6 => Command::ClipText {
+                text: self.text()?,
+                ctm: self.matrix()?,
+                scissor: self.rect()?,
+            },
+            7 => Command::ClipStrokeText {
+                text: self.text()?,
+                stroke: self.stroke()?,
+                ctm: self.matrix()?,
+                scissor: self.rect()?,
+            },
+            8 => Command::IgnoreText {
+                text: self.text()?,
+                ctm: self.matrix()?,
+            },
+            9 => Command::FillImage {
+                image: self.image_ref()?,
+                ctm: self.matrix()?,
+                alpha: self.f32()?,
+            },
+            10 => Command::FillImageMask {
+                image: self.image_ref()?,
+                ctm: self.matrix()?,
+                colorspace: self.device_colorspace()?,
+                color: self.floats()?,
+                alpha: self.f32()?,
+            },
+            11 => Command::ClipImageMask {
+                image: self.image_ref()?,
+                ctm: self.matrix()?,
+                scissor: self.rect()?,
+            },
+            12 => Command::PopClip,
+            13 => Command::BeginMask {
+                area: self.rect()?,
+                luminosity: self.bool()?,
+                colorspace: self.device_colorspace()?,
+                color: self.floats()?,
+            },
+            14 => Command::EndMask,
+            15 => Command::BeginGroup {
+                area: self.rect()?,
+                colorspace: self.colorspace()?,
+                isolated: self.bool()?,
+                knockout: self.bool()?,
+                blendmode: pick(
+                    &[
+                        BlendMode::Normal,
+                        BlendMode::Multiply,
+                        BlendMode::Screen,
+                        BlendMode::Overlay,
+                        BlendMode::Darken,
+                        BlendMode::Lighten,
+                        BlendMode::ColorDodge,
+                        BlendMode::ColorBurn,
+                        BlendMode::HardLight,
+                        BlendMode::SoftLight,
+                        BlendMode::Difference,
+                        BlendMode::Exclusion,
+                        BlendMode::Hue,
+                        BlendMode::Saturation,
+                        BlendMode::Color,
+                        BlendMode::Luminosity,
+                    ],
+                    self.u8()?,
+                )?,
+                alpha: self.f32()?,
+            },
+            16 => Command::EndGroup,
+            17 => Command::BeginTile {
+                area: self.rect()?,
+                view: self.rect()?,
+                xstep: self.f32()?,
+                ystep: self.f32()?,
+                ctm: self.matrix()?,
+            },
+            18 => Command::EndTile,
+            19 => Command::BeginLayer {
+                name: self.str()?.into(),
+            },
+            20 => Command::EndLayer,
+            tag => return Err(Error::format(format!("bad command {tag} in display list"))),
+        })
+    }
 }
 
 #[cfg(test)]
@@ -591,6 +2320,30 @@ mod tests {
         assert_eq!(device.display_list().len(), 1);
     }
 
+    #[test]
+    fn test_list_device_with_target() {
+        use crate::fitz::geometry::Point;
+
+        let target = Arc::new(Mutex::new(DisplayList::new(Rect::new(
+            0.0, 0.0, 50.0, 50.0,
+        ))));
+        let mut device = ListDevice::with_target(Arc::clone(&target));
+        assert_eq!(device.display_list().mediabox().x1, 50.0);
+
+        let mut path = Path::new();
+        path.move_to(Point::new(10.0, 10.0));
+        path.line_to(Point::new(40.0, 40.0));
+        let cs = Colorspace::device_rgb();
+        device.fill_path(&path, false, &Matrix::IDENTITY, &cs, &[0.0, 0.0, 0.0], 1.0);
+        assert!(target.lock().unwrap().is_empty());
+
+        device.close();
+        assert_eq!(target.lock().unwrap().len(), 1);
+        assert!(target.lock().unwrap().approx_size() > 0);
+        device.close();
+        assert_eq!(target.lock().unwrap().len(), 1);
+    }
+
     #[test]
     fn test_list_device_record_fill_text() {
         let mediabox = Rect::new(0.0, 0.0, 100.0, 100.0);
@@ -783,4 +2536,603 @@ mod tests {
 
         assert_eq!(device.display_list().len(), 2);
     }
+
+    /// A list using every kind of resource, for the serialization tests
+    fn sample_list(program: &[u8]) -> DisplayList {
+        use crate::fitz::geometry::Point;
+
+        let mut device = ListDevice::new(Rect::new(0.0, 0.0, 200.0, 100.0));
+        let cs = Colorspace::device_rgb();
+
+        let mut path = Path::new();
+        path.move_to(Point::new(1.0, 2.0));
+        path.curve_to(
+            Point::new(3.0, 4.0),
+            Point::new(5.0, 6.0),
+            Point::new(7.0, 8.5),
+        );
+        path.close();
+        let mut stroke = StrokeState::new();
+        stroke.linewidth = 2.5;
+        stroke.linejoin = LineJoin::Bevel;
+        stroke.dash_pattern = vec![3.0, 1.0];
+        device.fill_path(
+            &path,
+            true,
+            &Matrix::scale(2.0, 2.0),
+            &cs,
+            &[1.0, 0.5, 0.0],
+            0.75,
+        );
+        device.stroke_path(
+            &path,
+            &stroke,
+            &Matrix::IDENTITY,
+            &cs,
+            &[0.0, 0.0, 0.0],
+            1.0,
+        );
+
+        let font = Arc::new(Font::from_data("Embedded", program, 0).unwrap());
+        let mut text = Text::new();
+        let mut span = TextSpan::new(Arc::clone(&font), Matrix::scale(12.0, 12.0));
+        span.language = TextLanguage::Ja;
+        span.add_glyph(TextItem::with_advance(10.0, 20.0, 0.5, 7, 0x41, 65));
+        span.add_glyph(TextItem::with_advance(16.0, 20.0, 0.5, 8, 0x42, 66));
+        text.add_span(span);
+        text.add_span(TextSpan::new(font, Matrix::IDENTITY));
+        device.fill_text(&text, &Matrix::IDENTITY, &cs, &[0.0, 0.0, 1.0], 1.0);
+        device.clip_text(&text, &Matrix::IDENTITY, Rect::new(0.0, 0.0, 50.0, 50.0));
+        device.pop_clip();
+
+        let mut image = Image::from_raw(2, 1, 8, cs.clone(), vec![1, 2, 3, 4, 5, 6]).unwrap();
+        image.set_mask(Some(Image::from_mask(2, 1, vec![0x80]).unwrap()));
+        device.fill_image(&image, &Matrix::IDENTITY, 1.0);
+        device.fill_image(&image, &Matrix::scale(2.0, 2.0), 0.5);
+        let mut pix = Pixmap::new(Some(Colorspace::device_gray()), 2, 2, true).unwrap();
+        pix.samples_mut().copy_from_slice(&[1, 2, 3, 4, 5, 6, 7, 8]);
+        device.fill_image(&Image::new(2, 2, Some(pix)), &Matrix::IDENTITY, 1.0);
+
+        device.begin_group(
+            Rect::new(0.0, 0.0, 10.0, 10.0),
+            None,
+            true,
+            false,
+            BlendMode::Multiply,
+            0.5,
+        );
+        device.end_group();
+        device.into_display_list()
+    }
+
+    #[test]
+    fn test_display_list_serialize_embedded() {
+        let program = b"serialized list font program";
+        let list = sample_list(program);
+        let bytes = list.to_bytes(true);
+        assert_eq!(&bytes[..4], b"MPDL");
+
+        let decoded = DisplayList::from_bytes(&bytes, &mut |_| None).unwrap();
+        assert_eq!(decoded.len(), list.len());
+        assert_eq!(decoded.mediabox().x1, 200.0);
+        assert_eq!(decoded.to_bytes(true), bytes);
+
+        // Spans keep sharing one font, and images their data and mask
+        let Command::FillText { text, .. } = &decoded.commands[2] else {
+            panic!("expected fill text");
+        };
+        let spans = text.spans();
+        assert!(Arc::ptr_eq(&spans[0].font, &spans[1].font));
+        assert_eq!(spans[0].font.font_data(), Some(&program[..]));
+        assert_eq!(spans[0].language, TextLanguage::Ja);
+        assert_eq!(spans[0].items()[1].gid, 8);
+        let Command::FillImage { image, .. } = &decoded.commands[5] else {
+            panic!("expected fill image");
+        };
+        assert_eq!(image.data(), &[1, 2, 3, 4, 5, 6]);
+        assert_eq!(image.mask_type(), MaskType::ImageMask);
+        assert_eq!(image.mask().unwrap().data(), &[0x80]);
+        let Command::FillImage { image, .. } = &decoded.commands[7] else {
+            panic!("expected fill image");
+        };
+        let pix = image.cached_pixmap().unwrap();
+        assert!(pix.has_alpha());
+        assert_eq!(pix.samples(), &[1, 2, 3, 4, 5, 6, 7, 8]);
+
+        let mut bbox = BBoxDevice::new();
+        decoded.run(&mut bbox, &Matrix::IDENTITY, Rect::INFINITE);
+        assert!(!bbox.bbox().is_empty());
+    }
+
+    #[test]
+    fn test_display_list_serialize_by_reference() {
+        let program = b"referenced list font program";
+        let list = sample_list(program);
+        let bytes = list.to_bytes(false);
+        assert!(bytes.len() < list.to_bytes(true).len());
+
+        // Font program, image data, mask, pixmap
+        let resources = list.resources();
+        assert_eq!(resources.len(), 4);
+        let store: HashMap<[u8; 32], Vec<u8>> = resources
+            .iter()
+            .map(|r| (r.hash, r.data.to_vec()))
+            .collect();
+        let mut fetched = Vec::new();
+        let decoded = DisplayList::from_bytes(&bytes, &mut |hash| {
+            fetched.push(*hash);
+            store.get(hash).cloned()
+        })
+        .unwrap();
+        assert_eq!(decoded.to_bytes(true), list.to_bytes(true));
+        // The font's face is still cached, so only images are fetched
+        assert_eq!(fetched.len(), 3);
+
+        let err = DisplayList::from_bytes(&bytes, &mut |_| None);
+        assert!(matches!(err, Err(Error::Image(_))));
+    }
+
+    #[test]
+    fn test_display_list_from_bad_bytes() {
+        let bytes = sample_list(b"truncated list font program").to_bytes(true);
+        assert!(DisplayList::from_bytes(&bytes[..8], &mut |_| None).is_err());
+        assert!(DisplayList::from_bytes(&bytes[..bytes.len() - 1], &mut |_| None).is_err());
+        let mut other = bytes.clone();
+        other[4] = 99;
+        assert!(DisplayList::from_bytes(&other, &mut |_| None).is_err());
+    }
+
+    fn rect_path(x0: f32, y0: f32, x1: f32, y1: f32) -> Path {
+        let mut path = Path::new();
+        path.rect_coords(x0, y0, x1, y1);
+        path
+    }
+
+    #[test]
+    fn test_display_list_optimize() {
+        let cs = Colorspace::device_rgb();
+        let red = [1.0, 0.0, 0.0];
+        let id = Matrix::IDENTITY;
+        let mut dev = ListDevice::new(Rect::new(0.0, 0.0, 100.0, 100.0));
+        // Two disjoint red fills, then one off the page
+        dev.fill_path(
+            &rect_path(10.0, 10.0, 20.0, 20.0),
+            false,
+            &id,
+            &cs,
+            &red,
+            1.0,
+        );
+        dev.fill_path(
+            &rect_path(30.0, 10.0, 40.0, 20.0),
+            false,
+            &id,
+            &cs,
+            &red,
+            1.0,
+        );
+        dev.fill_path(
+            &rect_path(200.0, 0.0, 210.0, 10.0),
+            false,
+            &id,
+            &cs,
+            &red,
+            1.0,
+        );
+        // A clip covering the page around a stroke
+        dev.clip_path(
+            &rect_path(-5.0, -5.0, 105.0, 105.0),
+            false,
+            &id,
+            Rect::INFINITE,
+        );
+        dev.stroke_path(
+            &rect_path(50.0, 50.0, 60.0, 60.0),
+            &StrokeState::new(),
+            &id,
+            &cs,
+            &red,
+            1.0,
+        );
+        dev.pop_clip();
+        // A clip off the page, an empty clip and an empty group
+        dev.clip_path(
+            &rect_path(300.0, 300.0, 400.0, 400.0),
+            false,
+            &id,
+            Rect::INFINITE,
+        );
+        dev.fill_path(
+            &rect_path(310.0, 310.0, 320.0, 320.0),
+            false,
+            &id,
+            &cs,
+            &red,
+            1.0,
+        );
+        dev.pop_clip();
+        dev.clip_path(
+            &rect_path(10.0, 10.0, 20.0, 20.0),
+            false,
+            &id,
+            Rect::INFINITE,
+        );
+        dev.pop_clip();
+        dev.begin_group(Rect::INFINITE, None, false, false, BlendMode::Normal, 1.0);
+        dev.end_group();
+        // Overlapping fills stay apart
+        dev.fill_path(
+            &rect_path(70.0, 70.0, 80.0, 80.0),
+            false,
+            &id,
+            &cs,
+            &red,
+            1.0,
+        );
+        dev.fill_path(
+            &rect_path(75.0, 75.0, 85.0, 85.0),
+            false,
+            &id,
+            &cs,
+            &red,
+            1.0,
+        );
+        let mut list = dev.into_display_list();
+        assert_eq!(list.len(), 15);
+
+        assert_eq!(list.optimize(), 11);
+        assert!(matches!(
+            list.commands.as_slice(),
+            [
+                Command::FillPath { .. },
+                Command::StrokePath { .. },
+                Command::FillPath { .. },
+                Command::FillPath { .. }
+            ]
+        ));
+        let Command::FillPath { path, .. } = &list.commands[0] else {
+            unreachable!();
+        };
+        assert_eq!(path.len(), 2);
+        assert_eq!(list.optimize(), 0);
+    }
+
+    #[test]
+    fn test_display_list_scissor_culling() {
+        let cs = Colorspace::device_gray();
+        let id = Matrix::IDENTITY;
+        let mut dev = ListDevice::new(Rect::new(0.0, 0.0, 100.0, 100.0));
+        dev.fill_path(
+            &rect_path(10.0, 10.0, 40.0, 40.0),
+            false,
+            &id,
+            &cs,
+            &[0.0],
+            1.0,
+        );
+        dev.fill_path(
+            &rect_path(60.0, 60.0, 90.0, 90.0),
+            false,
+            &id,
+            &cs,
+            &[0.5],
+            1.0,
+        );
+        dev.clip_path(
+            &rect_path(60.0, 0.0, 100.0, 40.0),
+            false,
+            &id,
+            Rect::INFINITE,
+        );
+        dev.fill_path(
+            &rect_path(0.0, 0.0, 100.0, 100.0),
+            false,
+            &id,
+            &cs,
+            &[1.0],
+            1.0,
+        );
+        dev.pop_clip();
+        let mut list = dev.into_display_list();
+
+        let count = |list: &DisplayList, ctm: &Matrix, scissor: Rect| {
+            let mut rec = ListDevice::new(scissor);
+            list.run(&mut rec, ctm, scissor);
+            rec.display_list().len()
+        };
+        let tile = Rect::new(0.0, 0.0, 50.0, 50.0);
+        assert_eq!(count(&list, &id, Rect::INFINITE), 5);
+        assert!(!list.is_indexed());
+        assert_eq!(count(&list, &id, tile), 1);
+        assert!(list.is_indexed());
+
+        list.optimize();
+        assert!(!list.is_indexed());
+        assert_eq!(list.len(), 5);
+        assert_eq!(count(&list, &id, tile), 1);
+        assert_eq!(count(&list, &id, Rect::new(70.0, 10.0, 80.0, 20.0)), 3);
+        assert_eq!(count(&list, &id, Rect::INFINITE), 5);
+        // Bboxes are in list space, so zoomed tiles cull too
+        let zoom = Matrix::new(2.0, 0.0, 0.0, 2.0, 0.0, 0.0);
+        assert_eq!(
+            count(&list, &zoom, Rect::new(120.0, 120.0, 200.0, 200.0)),
+            1
+        );
+        assert_eq!(
+            count(&list, &zoom, Rect::new(300.0, 300.0, 400.0, 400.0)),
+            0
+        );
+    }
+
+    #[test]
+    fn test_display_list_optimize_keeps_tiles() {
+        let cs = Colorspace::device_gray();
+        let id = Matrix::IDENTITY;
+        let mut dev = ListDevice::new(Rect::new(0.0, 0.0, 100.0, 100.0));
+        let cell = Rect::new(0.0, 0.0, 10.0, 10.0);
+        dev.begin_tile(cell, cell, 10.0, 10.0, &id);
+        dev.fill_path(
+            &rect_path(500.0, 500.0, 510.0, 510.0),
+            false,
+            &id,
+            &cs,
+            &[0.0],
+            1.0,
+        );
+        dev.end_tile();
+        let mut list = dev.into_display_list();
+        assert_eq!(list.optimize(), 0);
+
+        let mut rec = ListDevice::new(cell);
+        list.run(&mut rec, &id, cell);
+        assert_eq!(rec.display_list().len(), 3);
+    }
+
+    #[test]
+    fn test_display_list_index_dense_page() {
+        let cs = Colorspace::device_gray();
+        let id = Matrix::IDENTITY;
+        let mut dev = ListDevice::new(Rect::new(0.0, 0.0, 400.0, 400.0));
+        for y in 0..40 {
+            for x in 0..40 {
+                let (x, y) = (x as f32 * 10.0, y as f32 * 10.0);
+                let shade = [(x + y) / 800.0];
+                dev.fill_path(
+                    &rect_path(x + 2.0, y + 2.0, x + 8.0, y + 8.0),
+                    false,
+                    &id,
+                    &cs,
+                    &shade,
+                    1.0,
+                );
+            }
+        }
+        let list = dev.into_display_list();
+        list.build_index();
+        let index = list.index.get().unwrap();
+        // 1600 fills chunk into 100, 7 and then the root
+        assert_eq!(index.nodes.len(), 108);
+
+        let mut rec = ListDevice::new(Rect::INFINITE);
+        list.run(&mut rec, &id, Rect::new(203.5, 103.5, 206.5, 106.5));
+        assert_eq!(rec.display_list().len(), 1);
+        let mut rec = ListDevice::new(Rect::INFINITE);
+        list.run(&mut rec, &id, Rect::new(0.0, 0.0, 400.0, 400.0));
+        assert_eq!(rec.display_list().len(), 1600);
+    }
+
+    #[test]
+    fn test_display_list_index_skips_blocks() {
+        let cs = Colorspace::device_gray();
+        let id = Matrix::IDENTITY;
+        let target = Arc::new(Mutex::new(DisplayList::new(Rect::new(
+            0.0, 0.0, 100.0, 100.0,
+        ))));
+        let mut dev = ListDevice::with_target(Arc::clone(&target));
+        // A page-sized clip with a group and a masked fill in one corner
+        dev.clip_path(
+            &rect_path(0.0, 0.0, 100.0, 100.0),
+            false,
+            &id,
+            Rect::INFINITE,
+        );
+        dev.begin_group(Rect::INFINITE, None, false, false, BlendMode::Multiply, 0.5);
+        dev.fill_path(
+            &rect_path(80.0, 80.0, 90.0, 90.0),
+            false,
+            &id,
+            &cs,
+            &[0.0],
+            1.0,
+        );
+        dev.end_group();
+        dev.begin_mask(Rect::INFINITE, true, &cs, &[0.0]);
+        dev.fill_path(
+            &rect_path(0.0, 0.0, 100.0, 100.0),
+            false,
+            &id,
+            &cs,
+            &[1.0],
+            1.0,
+        );
+        dev.end_mask();
+        dev.fill_path(
+            &rect_path(85.0, 85.0, 95.0, 95.0),
+            false,
+            &id,
+            &cs,
+            &[0.0],
+            1.0,
+        );
+        dev.pop_clip();
+        dev.pop_clip();
+        dev.close();
+        let list = target.lock().unwrap();
+        assert!(list.is_indexed());
+
+        let count = |scissor: Rect| {
+            let mut rec = ListDevice::new(scissor);
+            list.run(&mut rec, &id, scissor);
+            rec.display_list().len()
+        };
+        // Only the mask's own contents reach here, so the whole clip goes
+        assert_eq!(count(Rect::new(0.0, 0.0, 10.0, 10.0)), 0);
+        // On the group only
+        assert_eq!(count(Rect::new(80.0, 80.0, 84.0, 84.0)), 5);
+        assert_eq!(count(Rect::new(80.0, 80.0, 100.0, 100.0)), 10);
+    }
+
+    #[test]
+    fn test_display_list_layers() {
+        let cs = Colorspace::device_gray();
+        let id = Matrix::IDENTITY;
+        let mut dev = ListDevice::new(Rect::new(0.0, 0.0, 100.0, 100.0));
+        let fill = |dev: &mut ListDevice, x: f32| {
+            let path = rect_path(x, x, x + 10.0, x + 10.0);
+            dev.fill_path(&path, false, &id, &cs, &[0.0], 1.0);
+        };
+        dev.begin_layer("Roads");
+        fill(&mut dev, 10.0);
+        dev.begin_layer("Labels");
+        fill(&mut dev, 20.0);
+        dev.end_layer();
+        dev.end_layer();
+        dev.begin_layer("Water");
+        fill(&mut dev, 30.0);
+        dev.end_layer();
+        fill(&mut dev, 40.0);
+        dev.begin_layer("Empty");
+        dev.end_layer();
+        let list = dev.into_display_list();
+        assert_eq!(list.len(), 12);
+        assert_eq!(list.layers(), ["Roads", "Labels", "Water", "Empty"]);
+
+        let count = |list: &DisplayList, hidden: &str, scissor: Rect| {
+            let mut rec = ListDevice::new(scissor);
+            list.run_with_layers(&mut rec, &id, scissor, &|name| name != hidden);
+            rec.display_list().len()
+        };
+        // Scissored runs go through the index and must hide the same
+        for scissor in [Rect::INFINITE, Rect::new(0.0, 0.0, 100.0, 100.0)] {
+            assert_eq!(count(&list, "", scissor), 12);
+            // Hiding a layer hides the layers nested in it
+            assert_eq!(count(&list, "Roads", scissor), 6);
+            assert_eq!(count(&list, "Labels", scissor), 9);
+            assert_eq!(count(&list, "Water", scissor), 9);
+        }
+
+        let bytes = list.to_bytes(false);
+        let mut decoded = DisplayList::from_bytes(&bytes, &mut |_| None).unwrap();
+        assert_eq!(decoded.layers(), list.layers());
+        assert_eq!(count(&decoded, "Roads", Rect::INFINITE), 6);
+        // An empty layer goes, the rest keep their brackets
+        assert_eq!(decoded.optimize(), 2);
+        assert_eq!(decoded.layers(), ["Roads", "Labels", "Water"]);
+
+        // Lists written before layers still read
+        let mut old = sample_list(b"version one font program").to_bytes(true);
+        old[4..8].copy_from_slice(&1u32.to_le_bytes());
+        assert!(DisplayList::from_bytes(&old, &mut |_| None).is_ok());
+    }
+
+    /// Counts fills and aborts its cookie when the count reaches `limit`
+    struct AbortAfter {
+        cookie: Cookie,
+        limit: usize,
+        fills: usize,
+    }
+
+    impl Device for AbortAfter {
+        fn fill_path(&mut self, _: &Path, _: bool, _: &Matrix, _: &Colorspace, _: &[f32], _: f32) {
+            self.fills += 1;
+            if self.fills == self.limit {
+                self.cookie.abort();
+            }
+        }
+        fn stroke_path(
+            &mut self,
+            _: &Path,
+            _: &StrokeState,
+            _: &Matrix,
+            _: &Colorspace,
+            _: &[f32],
+            _: f32,
+        ) {
+        }
+        fn clip_path(&mut self, _: &Path, _: bool, _: &Matrix, _: Rect) {}
+        fn clip_stroke_path(&mut self, _: &Path, _: &StrokeState, _: &Matrix, _: Rect) {}
+        fn fill_text(&mut self, _: &Text, _: &Matrix, _: &Colorspace, _: &[f32], _: f32) {}
+        fn stroke_text(
+            &mut self,
+            _: &Text,
+            _: &StrokeState,
+            _: &Matrix,
+            _: &Colorspace,
+            _: &[f32],
+            _: f32,
+        ) {
+        }
+        fn clip_text(&mut self, _: &Text, _: &Matrix, _: Rect) {}
+        fn clip_stroke_text(&mut self, _: &Text, _: &StrokeState, _: &Matrix, _: Rect) {}
+        fn ignore_text(&mut self, _: &Text, _: &Matrix) {}
+        fn fill_image(&mut self, _: &Image, _: &Matrix, _: f32) {}
+        fn fill_image_mask(&mut self, _: &Image, _: &Matrix, _: &Colorspace, _: &[f32], _: f32) {}
+        fn clip_image_mask(&mut self, _: &Image, _: &Matrix, _: Rect) {}
+        fn pop_clip(&mut self) {}
+        fn begin_mask(&mut self, _: Rect, _: bool, _: &Colorspace, _: &[f32]) {}
+        fn end_mask(&mut self) {}
+        fn begin_group(
+            &mut self,
+            _: Rect,
+            _: Option<&Colorspace>,
+            _: bool,
+            _: bool,
+            _: BlendMode,
+            _: f32,
+        ) {
+        }
+        fn end_group(&mut self) {}
+        fn begin_tile(&mut self, _: Rect, _: Rect, _: f32, _: f32, _: &Matrix) -> i32 {
+            0
+        }
+        fn end_tile(&mut self) {}
+    }
+
+    #[test]
+    fn test_display_list_run_with_cookie() {
+        let cs = Colorspace::device_gray();
+        let id = Matrix::IDENTITY;
+        let mut dev = ListDevice::new(Rect::new(0.0, 0.0, 1000.0, 10.0));
+        for x in 0..100 {
+            let x = x as f32 * 10.0;
+            let path = rect_path(x, 0.0, x + 5.0, 5.0);
+            dev.fill_path(&path, false, &id, &cs, &[0.0], 1.0);
+        }
+        let list = dev.into_display_list();
+
+        let cookie = Cookie::new();
+        let mut rec = ListDevice::new(Rect::INFINITE);
+        assert!(list.run_with_cookie(&mut rec, &id, Rect::INFINITE, &cookie));
+        assert_eq!(rec.display_list().len(), 100);
+        assert_eq!(cookie.progress(), 100);
+
+        // Both the flat loop and the index stop on the command after the abort
+        for scissor in [Rect::INFINITE, Rect::new(0.0, 0.0, 1000.0, 10.0)] {
+            let mut dev = AbortAfter {
+                cookie: Cookie::new(),
+                limit: 7,
+                fills: 0,
+            };
+            let cookie = dev.cookie.clone();
+            assert!(!list.run_with_cookie(&mut dev, &id, scissor, &cookie));
+            assert_eq!(dev.fills, 7);
+            assert_eq!(cookie.progress(), 7);
+        }
+
+        // An aborted cookie runs nothing
+        cookie.abort();
+        let mut rec = ListDevice::new(Rect::INFINITE);
+        assert!(!list.run_with_cookie(&mut rec, &id, Rect::INFINITE, &cookie));
+        assert!(rec.display_list().is_empty());
+    }
 }
@@ -3,6 +3,7 @@
 //! Provides comprehensive font support for various PDF font formats.
 
 use crate::fitz::error::{Error, Result};
+use crate::fitz::font_cache::FontFace;
 use std::collections::HashMap;
 use std::sync::Arc;
 
@@ -256,8 +257,8 @@ pub struct Font {
     charmap: Arc<CharMap>,
     /// Glyph widths (glyph ID to advance width)
     widths: HashMap<u16, f32>,
-    /// Font data (embedded font file)
-    font_data: Option<Vec<u8>>,
+    /// Parsed embedded font program, shared with other fonts of the same data
+    face: Option<Arc<FontFace>>,
     /// Encoding name
     encoding: Option<String>,
 }
@@ -275,7 +276,7 @@ impl Font {
             metrics: FontMetrics::default(),
             charmap: Arc::new(CharMap::new()),
             widths: HashMap::new(),
-            font_data: None,
+            face: None,
             encoding: None,
         }
     }
@@ -393,9 +394,16 @@ impl Font {
         self.charmap.lookup(unicode)
     }
 
-    /// Get glyph advance width
+    /// Get glyph advance width, falling back to the font program's metrics
     pub fn glyph_advance(&self, gid: u16) -> f32 {
-        self.widths.get(&gid).copied().unwrap_or(1.0)
+        match self.widths.get(&gid) {
+            Some(&w) => w,
+            None => self
+                .face
+                .as_ref()
+                .and_then(|f| f.advance(gid))
+                .unwrap_or(1.0),
+        }
     }
 
     /// Set glyph advance width
@@ -429,27 +437,40 @@ impl Font {
 
     /// Get font data
     pub fn font_data(&self) -> Option<&[u8]> {
-        self.font_data.as_deref()
+        self.face.as_deref().map(FontFace::data)
     }
 
     /// Set font data
     pub fn set_font_data(&mut self, data: Vec<u8>) {
-        self.font_data = Some(data);
+        self.face = Some(FontFace::load(&data, 0));
+    }
+
+    /// Get the shared face parsed from the font data
+    pub fn face(&self) -> Option<&Arc<FontFace>> {
+        self.face.as_ref()
+    }
+
+    /// Use an already parsed face as the font data
+    pub fn set_face(&mut self, face: Arc<FontFace>) {
+        self.face = Some(face);
     }
 
     /// Check if font has embedded data
     pub fn is_embedded(&self) -> bool {
-        self.font_data.is_some()
+        self.face.is_some()
     }
 
     /// Create font from font data
-    pub fn from_data(name: &str, data: &[u8], _index: usize) -> Result<Self> {
+    ///
+    /// Fonts made from identical data share one cached face, so loading a
+    /// font another document already embeds neither copies nor reparses it.
+    pub fn from_data(name: &str, data: &[u8], index: usize) -> Result<Self> {
         if data.is_empty() {
             return Err(Error::Argument("Empty font data".into()));
         }
 
         let mut font = Font::new(name);
-        font.set_font_data(data.to_vec());
+        font.face = Some(FontFace::load(data, index));
 
         // Try to infer font type from data
         // This is a stub - real implementation would parse font file
@@ -484,10 +505,16 @@ impl Font {
         )
     }
 
-    /// Get glyph outline path (stub)
-    pub fn outline_glyph(&self, _gid: u16) -> crate::fitz::path::Path {
-        // Stub implementation - would need actual glyph outline extraction
-        crate::fitz::path::Path::new()
+    /// Get glyph outline path, in font units
+    ///
+    /// Outlines of embedded TrueType fonts are kept on the shared face, so
+    /// each glyph is built once per process. Fonts without one give an
+    /// empty path.
+    pub fn outline_glyph(&self, gid: u16) -> crate::fitz::path::Path {
+        match &self.face {
+            Some(face) => (*face.glyph_path(gid)).clone(),
+            None => crate::fitz::path::Path::new(),
+        }
     }
 }
 
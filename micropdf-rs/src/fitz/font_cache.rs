@@ -0,0 +1,716 @@
+//! Font face cache - parsed font programs shared across documents
+//!
+//! Documents routinely embed byte-identical font programs (the same subset
+//! of a corporate font, the same Arial), so parsed faces are cached process
+//! wide, keyed by a hash of the font data and face index. Every `Font`
+//! loaded from the same bytes shares one `FontFace` through an `Arc`,
+//! whichever context or document loaded it. The cache only holds weak
+//! references: a face is freed when the last font using it is dropped.
+
+use crate::fitz::alloc_sampler::{self, Subsystem};
+use crate::fitz::geometry::{Matrix, Point};
+use crate::fitz::memory_budget;
+use crate::fitz::path::Path;
+use bytes::Bytes;
+use sha2::{Digest, Sha256};
+use std::collections::HashMap;
+use std::hash::{DefaultHasher, Hash, Hasher};
+use std::sync::{Arc, LazyLock, Mutex, OnceLock, Weak};
+
+/// Deepest nesting of composite glyphs followed
+const MAX_COMPONENT_DEPTH: usize = 8;
+
+// Composite glyph component flags
+const ARG_1_AND_2_ARE_WORDS: u16 = 0x0001;
+const ARGS_ARE_XY_VALUES: u16 = 0x0002;
+const WE_HAVE_A_SCALE: u16 = 0x0008;
+const MORE_COMPONENTS: u16 = 0x0020;
+const WE_HAVE_AN_X_AND_Y_SCALE: u16 = 0x0040;
+const WE_HAVE_A_TWO_BY_TWO: u16 = 0x0080;
+
+/// Faces by content hash; a bucket holds more than one face only on a
+/// hash collision
+static FACES: LazyLock<Mutex<FaceTable>> = LazyLock::new(Mutex::default);
+
+#[derive(Default)]
+struct FaceTable {
+    faces: HashMap<u64, Vec<Weak<FontFace>>>,
+    /// Bucket count after the last sweep of dead entries
+    swept: usize,
+}
+
+/// Horizontal metrics read from a TrueType/OpenType face
+#[derive(Default)]
+struct FaceMetrics {
+    units_per_em: u16,
+    num_glyphs: u16,
+    /// Advance widths from 'hmtx'; glyphs past the end use the last one
+    advances: Vec<u16>,
+}
+
+/// A parsed font program, shared by every font loaded from the same bytes
+pub struct FontFace {
+    /// Owned, or a slice of a mapped context snapshot
+    data: Bytes,
+    index: usize,
+    key: u64,
+    metrics: FaceMetrics,
+    /// Glyph outlines built so far
+    outlines: Mutex<HashMap<u16, Arc<Path>>>,
+    /// SHA-256 of the data, for identities that outlive the process
+    digest: OnceLock<[u8; 32]>,
+}
+
+impl FontFace {
+    /// Get the shared face for a font program, parsing it on first use
+    pub fn load(data: &[u8], index: usize) -> Arc<FontFace> {
+        Self::find_or_insert(data, index, |key| {
+            alloc_sampler::record(Subsystem::Font, data.len());
+            memory_budget::charge(data.len());
+            Self::new(Bytes::copy_from_slice(data), index, key, OnceLock::new())
+        })
+    }
+
+    /// Get the shared face for a font program without copying it
+    ///
+    /// Used for programs in a mapped context snapshot, whose SHA-256 is
+    /// stored alongside. A face already loaded from the same bytes is
+    /// returned as is.
+    pub fn load_shared(data: Bytes, index: usize, digest: [u8; 32]) -> Arc<FontFace> {
+        let bytes = data.clone();
+        Self::find_or_insert(&bytes, index, |key| {
+            Self::new(data, index, key, OnceLock::from(digest))
+        })
+    }
+
+    fn new(data: Bytes, index: usize, key: u64, digest: OnceLock<[u8; 32]>) -> Self {
+        FontFace {
+            metrics: parse_metrics(&data, index).unwrap_or_default(),
+            data,
+            index,
+            key,
+            outlines: Mutex::new(HashMap::new()),
+            digest,
+        }
+    }
+
+    fn find_or_insert(
+        data: &[u8],
+        index: usize,
+        create: impl FnOnce(u64) -> FontFace,
+    ) -> Arc<FontFace> {
+        let key = face_key(data, index);
+        let mut table = FACES.lock().unwrap_or_else(|e| e.into_inner());
+
+        let bucket = table.faces.entry(key).or_default();
+        bucket.retain(|w| w.strong_count() > 0);
+        let found = bucket
+            .iter()
+            .filter_map(Weak::upgrade)
+            .find(|f| f.index == index && *f.data == *data);
+        if let Some(face) = found {
+            return face;
+        }
+
+        let face = Arc::new(create(key));
+        bucket.push(Arc::downgrade(&face));
+
+        // Drop buckets of freed faces once the table has doubled
+        if table.faces.len() > 2 * table.swept.max(32) {
+            table.faces.retain(|_, b| {
+                b.retain(|w| w.strong_count() > 0);
+                !b.is_empty()
+            });
+            table.swept = table.faces.len();
+        }
+        face
+    }
+
+    /// The font program
+    pub fn data(&self) -> &[u8] {
+        &self.data
+    }
+
+    /// Face index within a collection
+    pub fn index(&self) -> usize {
+        self.index
+    }
+
+    /// In-process content hash (the cache key)
+    pub fn key(&self) -> u64 {
+        self.key
+    }
+
+    /// SHA-256 of the font program, computed once per face
+    pub fn content_hash(&self) -> [u8; 32] {
+        *self
+            .digest
+            .get_or_init(|| Sha256::digest(&self.data[..]).into())
+    }
+
+    /// Units per em, or 0 if the data is not a TrueType/OpenType face
+    pub fn units_per_em(&self) -> u16 {
+        self.metrics.units_per_em
+    }
+
+    /// Number of glyphs, or 0 if unknown
+    pub fn num_glyphs(&self) -> u16 {
+        self.metrics.num_glyphs
+    }
+
+    /// Advance width of a glyph in em units, from the face's 'hmtx' table
+    pub fn advance(&self, gid: u16) -> Option<f32> {
+        let m = &self.metrics;
+        if m.units_per_em == 0 || gid >= m.num_glyphs {
+            return None;
+        }
+        let adv = m.advances.get(gid as usize).or(m.advances.last())?;
+        Some(*adv as f32 / m.units_per_em as f32)
+    }
+
+    /// A glyph's outline in font units (see [`Self::units_per_em`]), read
+    /// from the face's 'glyf' table the first time it is asked for
+    ///
+    /// Glyphs without an outline, like spaces, and faces without 'glyf'
+    /// outlines give an empty path.
+    pub fn glyph_path(&self, gid: u16) -> Arc<Path> {
+        self.outline(gid, || {
+            let mut path = Path::new();
+            if let Some(tables) = sfnt_tables(&self.data, self.index) {
+                append_glyph(&tables, gid, &Matrix::IDENTITY, 0, &mut path);
+            }
+            path
+        })
+    }
+
+    /// The glyph character `code` maps to in the face's cmap subtable for
+    /// `platform` and `encoding`, if it has one and maps the code
+    ///
+    /// Subtable formats 0, 4, 6 and 12 are read; a code mapped to glyph 0
+    /// counts as unmapped.
+    pub fn cmap_glyph(&self, platform: u16, encoding: u16, code: u32) -> Option<u16> {
+        let tables = sfnt_tables(&self.data, self.index)?;
+        let cmap = tables.get(b"cmap")?;
+        let offset = (0..be16(cmap, 2)? as usize).find_map(|i| {
+            let rec = 4 + 8 * i;
+            (be16(cmap, rec)? == platform && be16(cmap, rec + 2)? == encoding)
+                .then(|| be32(cmap, rec + 4))
+                .flatten()
+        })?;
+        let sub = cmap.get(offset as usize..)?;
+        cmap_lookup(sub, code).filter(|&gid| gid != 0)
+    }
+
+    /// Outlines built so far, by glyph
+    pub fn outlines(&self) -> Vec<(u16, Arc<Path>)> {
+        self.outlines.lock().map_or_else(
+            |_| Vec::new(),
+            |o| {
+                o.iter()
+                    .map(|(&gid, path)| (gid, Arc::clone(path)))
+                    .collect()
+            },
+        )
+    }
+
+    /// A glyph's outline, built by `build` the first time it is asked for
+    pub fn outline(&self, gid: u16, build: impl FnOnce() -> Path) -> Arc<Path> {
+        if let Some(path) = self.outlines.lock().ok().and_then(|o| o.get(&gid).cloned()) {
+            return path;
+        }
+        // Build outside the lock; a racing builder's result is discarded
+        let path = Arc::new(build());
+        match self.outlines.lock() {
+            Ok(mut o) => Arc::clone(o.entry(gid).or_insert(path)),
+            Err(_) => path,
+        }
+    }
+}
+
+impl std::fmt::Debug for FontFace {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("FontFace")
+            .field("len", &self.data.len())
+            .field("index", &self.index)
+            .field("units_per_em", &self.metrics.units_per_em)
+            .field("num_glyphs", &self.metrics.num_glyphs)
+            .finish()
+    }
+}
+
+/// Every live face in the process-wide cache
+pub fn cached_faces() -> Vec<Arc<FontFace>> {
+    let table = FACES.lock().unwrap_or_else(|e| e.into_inner());
+    table
+        .faces
+        .values()
+        .flatten()
+        .filter_map(Weak::upgrade)
+        .collect()
+}
+
+/// Number of live faces in the process-wide cache
+pub fn cached_face_count() -> usize {
+    let table = FACES.lock().unwrap_or_else(|e| e.into_inner());
+    table
+        .faces
+        .values()
+        .flatten()
+        .filter(|w| w.strong_count() > 0)
+        .count()
+}
+
+fn face_key(data: &[u8], index: usize) -> u64 {
+    let mut hasher = DefaultHasher::new();
+    index.hash(&mut hasher);
+    data.hash(&mut hasher);
+    hasher.finish()
+}
+
+fn be16(data: &[u8], pos: usize) -> Option<u16> {
+    Some(u16::from_be_bytes(data.get(pos..pos + 2)?.try_into().ok()?))
+}
+
+fn be32(data: &[u8], pos: usize) -> Option<u32> {
+    Some(u32::from_be_bytes(data.get(pos..pos + 4)?.try_into().ok()?))
+}
+
+/// The tables of an sfnt face, by tag
+fn sfnt_tables(data: &[u8], index: usize) -> Option<HashMap<[u8; 4], &[u8]>> {
+    // A collection points at each face's table directory
+    let base = if data.get(..4)? == b"ttcf" {
+        if index >= be32(data, 8)? as usize {
+            return None;
+        }
+        be32(data, 12 + 4 * index)? as usize
+    } else {
+        0
+    };
+
+    let num_tables = be16(data, base + 4)? as usize;
+    let mut tables = HashMap::new();
+    for i in 0..num_tables {
+        let rec = base + 12 + 16 * i;
+        let tag: [u8; 4] = data.get(rec..rec + 4)?.try_into().ok()?;
+        let offset = be32(data, rec + 8)? as usize;
+        let len = be32(data, rec + 12)? as usize;
+        tables.insert(tag, data.get(offset..offset.checked_add(len)?)?);
+    }
+    Some(tables)
+}
+
+/// Read units per em, glyph count and advances from an sfnt face
+fn parse_metrics(data: &[u8], index: usize) -> Option<FaceMetrics> {
+    let tables = sfnt_tables(data, index)?;
+    let head = tables.get(b"head")?;
+    let maxp = tables.get(b"maxp")?;
+    let hhea = tables.get(b"hhea")?;
+    let hmtx = tables.get(b"hmtx")?;
+    let num_glyphs = be16(maxp, 4)?;
+    let num_hmetrics = (be16(hhea, 34)? as usize).min(hmtx.len() / 4);
+    Some(FaceMetrics {
+        units_per_em: be16(head, 18)?,
+        num_glyphs,
+        advances: (0..num_hmetrics)
+            .map(|i| be16(hmtx, 4 * i).unwrap_or(0))
+            .collect(),
+    })
+}
+
+/// The glyph cmap subtable `sub` maps `code` to
+fn cmap_lookup(sub: &[u8], code: u32) -> Option<u16> {
+    match be16(sub, 0)? {
+        0 => sub
+            .get(6 + usize::try_from(code).ok().filter(|&c| c < 256)?)
+            .map(|&g| u16::from(g)),
+        4 => {
+            let code = u16::try_from(code).ok()?;
+            let seg_x2 = be16(sub, 6)? as usize;
+            let ends = 14;
+            let starts = ends + seg_x2 + 2;
+            let deltas = starts + seg_x2;
+            let ranges = deltas + seg_x2;
+            for seg in (0..seg_x2).step_by(2) {
+                if code > be16(sub, ends + seg)? {
+                    continue;
+                }
+                let start = be16(sub, starts + seg)?;
+                if code < start {
+                    return None;
+                }
+                let delta = be16(sub, deltas + seg)?;
+                let range = be16(sub, ranges + seg)? as usize;
+                if range == 0 {
+                    return Some(code.wrapping_add(delta));
+                }
+                let pos = ranges + seg + range + 2 * usize::from(code - start);
+                return match be16(sub, pos)? {
+                    0 => None,
+                    gid => Some(gid.wrapping_add(delta)),
+                };
+            }
+            None
+        }
+        6 => {
+            let first = u32::from(be16(sub, 6)?);
+            let count = u32::from(be16(sub, 8)?);
+            let index = code.checked_sub(first).filter(|&i| i < count)?;
+            be16(sub, 10 + 2 * index as usize)
+        }
+        12 => (0..be32(sub, 12)? as usize).find_map(|i| {
+            let group = 16 + 12 * i;
+            let (start, end) = (be32(sub, group)?, be32(sub, group + 4)?);
+            (start..=end)
+                .contains(&code)
+                .then(|| be32(sub, group + 8)?.checked_add(code - start))
+                .flatten()
+                .and_then(|g| u16::try_from(g).ok())
+        }),
+        _ => None,
+    }
+}
+
+/// Add glyph `gid` of the face with `tables` to `path`, through `m`
+fn append_glyph(
+    tables: &HashMap<[u8; 4], &[u8]>,
+    gid: u16,
+    m: &Matrix,
+    depth: usize,
+    path: &mut Path,
+) -> Option<()> {
+    let (head, loca, glyf) = (
+        tables.get(b"head")?,
+        tables.get(b"loca")?,
+        tables.get(b"glyf")?,
+    );
+    let gid = usize::from(gid);
+    let (start, end) = if be16(head, 50)? != 0 {
+        (
+            be32(loca, 4 * gid)? as usize,
+            be32(loca, 4 * gid + 4)? as usize,
+        )
+    } else {
+        (
+            2 * be16(loca, 2 * gid)? as usize,
+            2 * be16(loca, 2 * gid + 2)? as usize,
+        )
+    };
+    let glyph = glyf.get(start..end)?;
+    if glyph.is_empty() {
+        return Some(());
+    }
+    match be16(glyph, 0)? as i16 {
+        contours if contours < 0 => append_composite(tables, glyph, m, depth, path),
+        contours => append_simple(glyph, contours as usize, m, path),
+    }
+}
+
+/// Add the quadratic contours of a simple glyph to `path`
+fn append_simple(glyph: &[u8], contours: usize, m: &Matrix, path: &mut Path) -> Option<()> {
+    let ends = (0..contours)
+        .map(|i| be16(glyph, 10 + 2 * i).map(usize::from))
+        .collect::<Option<Vec<_>>>()?;
+    let points = ends.last().map_or(0, |&e| e + 1);
+    let mut pos = 12 + 2 * contours + be16(glyph, 10 + 2 * contours)? as usize;
+
+    let mut flags = Vec::with_capacity(points);
+    while flags.len() < points {
+        let flag = *glyph.get(pos)?;
+        pos += 1;
+        flags.push(flag);
+        if flag & 0x08 != 0 {
+            let repeat = *glyph.get(pos)?;
+            pos += 1;
+            flags.extend(std::iter::repeat_n(flag, usize::from(repeat)));
+        }
+    }
+    flags.truncate(points);
+
+    // Coordinates are deltas, short (with a sign flag) or long
+    let mut coords = |short: u8, same: u8| -> Option<Vec<f32>> {
+        let mut v = 0i32;
+        let mut out = Vec::with_capacity(points);
+        for &flag in &flags {
+            if flag & short != 0 {
+                let d = i32::from(*glyph.get(pos)?);
+                pos += 1;
+                v += if flag & same != 0 { d } else { -d };
+            } else if flag & same == 0 {
+                v += i32::from(be16(glyph, pos)? as i16);
+                pos += 2;
+            }
+            out.push(v as f32);
+        }
+        Some(out)
+    };
+    let xs = coords(0x02, 0x10)?;
+    let ys = coords(0x04, 0x20)?;
+
+    let point = |i: usize| m.transform_point(Point::new(xs[i], ys[i]));
+    let mid = |a: Point, b: Point| Point::new((a.x + b.x) / 2.0, (a.y + b.y) / 2.0);
+    let on = |i: usize| flags[i] & 0x01 != 0;
+    let mut first = 0;
+    for &last in &ends {
+        if last < first || last >= points {
+            return None;
+        }
+        let len = last - first + 1;
+        // Start on a point on the curve, or between two that are off it
+        let (start, order): (Point, Vec<usize>) = match (0..len).find(|&k| on(first + k)) {
+            Some(k) => (
+                point(first + k),
+                (1..=len).map(|step| first + (k + step) % len).collect(),
+            ),
+            None => (mid(point(last), point(first)), (first..=last).collect()),
+        };
+        path.move_to(start);
+        let mut control = None;
+        for i in order {
+            let p = point(i);
+            if on(i) {
+                match control.take() {
+                    Some(c) => path.quad_to(c, p),
+                    None => path.line_to(p),
+                }
+            } else {
+                if let Some(c) = control {
+                    path.quad_to(c, mid(c, p));
+                }
+                control = Some(p);
+            }
+        }
+        if let Some(c) = control {
+            path.quad_to(c, start);
+        }
+        path.close();
+        first = last + 1;
+    }
+    Some(())
+}
+
+/// Add the components of a composite glyph to `path`
+fn append_composite(
+    tables: &HashMap<[u8; 4], &[u8]>,
+    glyph: &[u8],
+    m: &Matrix,
+    depth: usize,
+    path: &mut Path,
+) -> Option<()> {
+    let f2dot14 = |pos: usize| be16(glyph, pos).map(|v| f32::from(v as i16) / 16384.0);
+    let mut pos = 10;
+    loop {
+        let flags = be16(glyph, pos)?;
+        let component = be16(glyph, pos + 2)?;
+        pos += 4;
+        let (dx, dy) = if flags & ARG_1_AND_2_ARE_WORDS != 0 {
+            pos += 4;
+            (
+                f32::from(be16(glyph, pos - 4)? as i16),
+                f32::from(be16(glyph, pos - 2)? as i16),
+            )
+        } else {
+            pos += 2;
+            (
+                f32::from(*glyph.get(pos - 2)? as i8),
+                f32::from(*glyph.get(pos - 1)? as i8),
+            )
+        };
+        // Anchoring by matched points isn't followed
+        let (dx, dy) = if flags & ARGS_ARE_XY_VALUES != 0 {
+            (dx, dy)
+        } else {
+            (0.0, 0.0)
+        };
+        let (a, b, c, d) = if flags & WE_HAVE_A_SCALE != 0 {
+            pos += 2;
+            let s = f2dot14(pos - 2)?;
+            (s, 0.0, 0.0, s)
+        } else if flags & WE_HAVE_AN_X_AND_Y_SCALE != 0 {
+            pos += 4;
+            (f2dot14(pos - 4)?, 0.0, 0.0, f2dot14(pos - 2)?)
+        } else if flags & WE_HAVE_A_TWO_BY_TWO != 0 {
+            pos += 8;
+            (
+                f2dot14(pos - 8)?,
+                f2dot14(pos - 6)?,
+                f2dot14(pos - 4)?,
+                f2dot14(pos - 2)?,
+            )
+        } else {
+            (1.0, 0.0, 0.0, 1.0)
+        };
+        if depth < MAX_COMPONENT_DEPTH {
+            let local = Matrix::new(a, b, c, d, dx, dy);
+            append_glyph(tables, component, &local.concat(m), depth + 1, path);
+        }
+        if flags & MORE_COMPONENTS == 0 {
+            return Some(());
+        }
+    }
+}
+
+#[cfg(test)]
+pub(crate) mod tests {
+    use super::*;
+    use crate::fitz::path::PathElement;
+
+    /// A minimal sfnt with 'head', 'hhea', 'maxp' and 'hmtx' tables
+    fn sfnt(units_per_em: u16, advances: &[u16], num_glyphs: u16) -> Vec<u8> {
+        sfnt_with(units_per_em, advances, num_glyphs, Vec::new())
+    }
+
+    /// A minimal sfnt with `extra` tables too
+    pub(crate) fn sfnt_with(
+        units_per_em: u16,
+        advances: &[u16],
+        num_glyphs: u16,
+        extra: Vec<(&[u8; 4], Vec<u8>)>,
+    ) -> Vec<u8> {
+        let mut head = vec![0u8; 54];
+        head[18..20].copy_from_slice(&units_per_em.to_be_bytes());
+        let mut hhea = vec![0u8; 36];
+        hhea[34..36].copy_from_slice(&(advances.len() as u16).to_be_bytes());
+        let mut maxp = vec![0u8; 6];
+        maxp[4..6].copy_from_slice(&num_glyphs.to_be_bytes());
+        let hmtx: Vec<u8> = advances
+            .iter()
+            .flat_map(|a| [a.to_be_bytes(), [0, 0]].concat())
+            .collect();
+
+        let mut tables = vec![
+            (b"head", head),
+            (b"hhea", hhea),
+            (b"hmtx", hmtx),
+            (b"maxp", maxp),
+        ];
+        tables.extend(extra);
+        let mut out = vec![0, 1, 0, 0];
+        out.extend_from_slice(&(tables.len() as u16).to_be_bytes());
+        out.extend_from_slice(&[0; 6]);
+        let mut offset = 12 + 16 * tables.len();
+        for (tag, table) in &tables {
+            out.extend_from_slice(*tag);
+            out.extend_from_slice(&[0; 4]);
+            out.extend_from_slice(&(offset as u32).to_be_bytes());
+            out.extend_from_slice(&(table.len() as u32).to_be_bytes());
+            offset += table.len();
+        }
+        for (_, table) in &tables {
+            out.extend_from_slice(table);
+        }
+        out
+    }
+
+    #[test]
+    fn test_identical_data_shares_a_face() {
+        let data = sfnt(1000, &[500, 250, 750], 5);
+        let a = FontFace::load(&data, 0);
+        let b = FontFace::load(&data.clone(), 0);
+        assert!(Arc::ptr_eq(&a, &b));
+        assert!(!Arc::ptr_eq(&a, &FontFace::load(&data, 1)));
+
+        let mut other = data.clone();
+        other.push(0);
+        let c = FontFace::load(&other, 0);
+        assert!(!Arc::ptr_eq(&a, &c));
+        assert_eq!(a.content_hash(), <[u8; 32]>::from(Sha256::digest(&data)));
+
+        // Once every user is gone the face is freed
+        let weak = Arc::downgrade(&a);
+        drop((a, b));
+        assert!(weak.upgrade().is_none());
+    }
+
+    #[test]
+    fn test_hmtx_advances() {
+        let face = FontFace::load(&sfnt(2048, &[1024, 512], 4), 0);
+        assert_eq!(face.units_per_em(), 2048);
+        assert_eq!(face.num_glyphs(), 4);
+        assert_eq!(face.advance(0), Some(0.5));
+        assert_eq!(face.advance(1), Some(0.25));
+        assert_eq!(face.advance(3), Some(0.25));
+        assert_eq!(face.advance(4), None);
+
+        let junk = FontFace::load(b"not a font", 0);
+        assert_eq!(junk.units_per_em(), 0);
+        assert_eq!(junk.advance(0), None);
+    }
+
+    #[test]
+    fn test_outlines_are_built_once() {
+        let face = FontFace::load(&sfnt(1000, &[600], 1), 0);
+        let mut builds = 0;
+        for _ in 0..3 {
+            face.outline(0, || {
+                builds += 1;
+                Path::new()
+            });
+        }
+        assert_eq!(builds, 1);
+    }
+
+    /// A simple glyph: a triangle with one control point, (0,0) (100,0)
+    /// and (100,100) off the curve, padded to 30 bytes
+    pub(crate) fn triangle() -> Vec<u8> {
+        let mut glyph = vec![0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 0, 1, 1, 0];
+        for v in [0i16, 100, 0, 0, 0, 100] {
+            glyph.extend_from_slice(&v.to_be_bytes());
+        }
+        glyph.push(0);
+        glyph
+    }
+
+    #[test]
+    fn test_glyf_outlines() {
+        // The triangle, and a composite moving it
+        let mut glyf = triangle();
+        glyf.extend_from_slice(&[0xff, 0xff, 0, 0, 0, 0, 0, 0, 0, 0, 0, 3, 0, 0, 0, 10, 0, 20]);
+        let loca: Vec<u8> = [0u16, 15, 24]
+            .iter()
+            .flat_map(|v| v.to_be_bytes())
+            .collect();
+        let data = sfnt_with(1000, &[600], 2, vec![(b"glyf", glyf), (b"loca", loca)]);
+        let face = FontFace::load(&data, 0);
+
+        let p = Point::new;
+        let expected = |dx: f32, dy: f32| {
+            vec![
+                PathElement::MoveTo(p(dx, dy)),
+                PathElement::LineTo(p(100.0 + dx, dy)),
+                PathElement::QuadTo(p(100.0 + dx, 100.0 + dy), p(dx, dy)),
+                PathElement::Close,
+            ]
+        };
+        assert_eq!(face.glyph_path(0).elements(), expected(0.0, 0.0));
+        assert_eq!(face.glyph_path(1).elements(), expected(10.0, 20.0));
+        assert!(face.glyph_path(2).is_empty());
+        assert!(
+            FontFace::load(&sfnt(1000, &[600], 1), 0)
+                .glyph_path(0)
+                .is_empty()
+        );
+    }
+
+    #[test]
+    fn test_cmap_glyph() {
+        // A format 4 subtable mapping 'A' and 'B' to glyphs 1 and 2
+        let mut sub = Vec::new();
+        for v in [4u16, 32, 0, 4, 4, 1, 0, 0x42, 0xffff, 0, 0x41, 0xffff] {
+            sub.extend_from_slice(&v.to_be_bytes());
+        }
+        for v in [1u16.wrapping_sub(0x41), 1, 0, 0] {
+            sub.extend_from_slice(&v.to_be_bytes());
+        }
+        let mut cmap = Vec::new();
+        for v in [0u16, 1, 3, 1, 0, 12] {
+            cmap.extend_from_slice(&v.to_be_bytes());
+        }
+        cmap.extend(sub);
+        let face = FontFace::load(&sfnt_with(1000, &[600], 3, vec![(b"cmap", cmap)]), 0);
+
+        assert_eq!(face.cmap_glyph(3, 1, 0x41), Some(1));
+        assert_eq!(face.cmap_glyph(3, 1, 0x42), Some(2));
+        assert_eq!(face.cmap_glyph(3, 1, 0x43), None);
+        assert_eq!(face.cmap_glyph(3, 0, 0x41), None);
+    }
+}
@@ -350,6 +350,11 @@ impl Image {
         Ok(self.pixmap.as_ref().unwrap())
     }
 
+    /// Get the decoded pixmap, if one has been made or was given
+    pub fn cached_pixmap(&self) -> Option<&Pixmap> {
+        self.pixmap.as_ref()
+    }
+
     /// Convert image to pixmap
     pub fn to_pixmap(&mut self) -> Result<Pixmap> {
         // Decode if compressed
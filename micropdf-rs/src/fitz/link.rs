@@ -3,6 +3,8 @@
 //! Provides structures and functions for managing interactive links in documents.
 
 use crate::fitz::geometry::Rect;
+use crate::fitz::rtree::PackedRTree;
+use std::sync::OnceLock;
 
 /// Link destination type
 #[derive(Debug, Clone, Copy, PartialEq, Eq)]
@@ -151,17 +153,23 @@ impl Link {
 #[derive(Clone)]
 pub struct LinkList {
     links: Vec<Link>,
+    /// Spatial index over `links`, built on first hit test
+    tree: OnceLock<PackedRTree>,
 }
 
 impl LinkList {
     /// Create a new empty link list
     pub fn new() -> Self {
-        Self { links: Vec::new() }
+        Self {
+            links: Vec::new(),
+            tree: OnceLock::new(),
+        }
     }
 
     /// Add a link to the list
     pub fn push(&mut self, link: Link) {
         self.links.push(link);
+        self.tree = OnceLock::new();
     }
 
     /// Get all links as a slice
@@ -192,11 +200,25 @@ impl LinkList {
     /// Clear all links
     pub fn clear(&mut self) {
         self.links.clear();
+        self.tree = OnceLock::new();
     }
 
     /// Find link at a given point
+    ///
+    /// Overlapping links resolve to the first one in the list.
     pub fn link_at_point(&self, x: f32, y: f32) -> Option<&Link> {
-        self.links.iter().find(|link| link.rect.contains(x, y))
+        let tree = self.tree.get_or_init(|| {
+            PackedRTree::new(
+                self.links
+                    .iter()
+                    .enumerate()
+                    .map(|(i, link)| (i as u32, link.rect)),
+            )
+        });
+        tree.at_point(x, y)
+            .into_iter()
+            .map(|i| &self.links[i as usize])
+            .find(|link| link.rect.contains(x, y))
     }
 }
 
@@ -330,6 +352,21 @@ mod tests {
         assert!(found3.is_none());
     }
 
+    #[test]
+    fn test_link_at_point_after_push() {
+        let mut list = LinkList::new();
+        list.push(Link::new(Rect::new(0.0, 0.0, 100.0, 100.0), "#under"));
+        list.push(Link::new(Rect::new(50.0, 50.0, 150.0, 150.0), "#over"));
+        assert_eq!(list.link_at_point(75.0, 75.0).unwrap().uri, "#under");
+        assert!(list.link_at_point(100.0, 20.0).is_none());
+
+        // The index is rebuilt once the list changes
+        list.push(Link::new(Rect::new(400.0, 0.0, 500.0, 10.0), "#late"));
+        assert_eq!(list.link_at_point(450.0, 5.0).unwrap().uri, "#late");
+        list.clear();
+        assert!(list.link_at_point(75.0, 75.0).is_none());
+    }
+
     #[test]
     fn test_link_list_into_iter() {
         let mut list = LinkList::new();
@@ -0,0 +1,265 @@
+//! Memory budgets - hard limits on what one document or operation allocates
+//!
+//! A `MemoryBudget` counts the bytes charged to it against a limit. Code
+//! working on behalf of a document or cookie `enter`s their budgets on the
+//! current thread, and the allocation sites for pixmap samples, decoded
+//! streams, parsed objects, xref sections and fonts charge every budget
+//! entered. Pixmap memory is credited back when the pixmap is freed; the
+//! rest stays charged for the budget's lifetime, as it lives about as long
+//! as the document that made it.
+//!
+//! Exceeding a limit marks the budget; the caller checks the mark when the
+//! operation ends and fails it. Allocations that can be refused up front,
+//! such as a page pixmap or an image decode of known size, are checked
+//! with `admit` before the memory is touched.
+
+use std::cell::RefCell;
+use std::sync::Arc;
+use std::sync::atomic::{AtomicBool, AtomicUsize, Ordering};
+
+/// Bytes charged against a limit
+#[derive(Debug, Default)]
+pub struct MemoryBudget {
+    /// Limit in bytes; 0 for none
+    limit: AtomicUsize,
+    used: AtomicUsize,
+    peak: AtomicUsize,
+    /// Set when a charge or admission went over the limit
+    exceeded: AtomicBool,
+}
+
+impl MemoryBudget {
+    /// A budget of `limit` bytes (0 for unlimited)
+    pub fn new(limit: usize) -> Self {
+        Self {
+            limit: AtomicUsize::new(limit),
+            ..Default::default()
+        }
+    }
+
+    pub fn limit(&self) -> usize {
+        self.limit.load(Ordering::Relaxed)
+    }
+
+    pub fn set_limit(&self, limit: usize) {
+        self.limit.store(limit, Ordering::Relaxed);
+    }
+
+    /// Bytes currently charged
+    pub fn used(&self) -> usize {
+        self.used.load(Ordering::Relaxed)
+    }
+
+    /// Most bytes ever charged at once
+    pub fn peak(&self) -> usize {
+        self.peak.load(Ordering::Relaxed)
+    }
+
+    /// Whether the limit has been exceeded since the last `take_exceeded`
+    pub fn exceeded(&self) -> bool {
+        self.exceeded.load(Ordering::Relaxed)
+    }
+
+    /// Clear the exceeded mark, returning whether it was set
+    pub fn take_exceeded(&self) -> bool {
+        self.exceeded.swap(false, Ordering::Relaxed)
+    }
+
+    /// Forget every charge and the exceeded mark
+    pub fn reset(&self) {
+        self.used.store(0, Ordering::Relaxed);
+        self.peak.store(0, Ordering::Relaxed);
+        self.exceeded.store(false, Ordering::Relaxed);
+    }
+
+    /// Whether `bytes` more would stay within the limit
+    fn fits(&self, bytes: usize) -> bool {
+        let limit = self.limit();
+        limit == 0 || self.used().saturating_add(bytes) <= limit
+    }
+
+    fn add(&self, bytes: usize) {
+        let used = self.used.fetch_add(bytes, Ordering::Relaxed) + bytes;
+        self.peak.fetch_max(used, Ordering::Relaxed);
+        let limit = self.limit();
+        if limit != 0 && used > limit {
+            self.exceeded.store(true, Ordering::Relaxed);
+        }
+    }
+
+    fn sub(&self, bytes: usize) {
+        // A reset may have zeroed the count under an outstanding charge
+        let _ = self
+            .used
+            .fetch_update(Ordering::Relaxed, Ordering::Relaxed, |u| {
+                Some(u.saturating_sub(bytes))
+            });
+    }
+}
+
+thread_local! {
+    /// Budgets entered on this thread, outermost first
+    static ACTIVE: RefCell<Vec<Arc<MemoryBudget>>> = const { RefCell::new(Vec::new()) };
+}
+
+/// Budgets entered on this thread until dropped; see `enter`
+#[must_use = "a budget is entered until the scope is dropped"]
+pub struct Scope {
+    pushed: usize,
+}
+
+/// Charge the current thread's allocations to `budgets` until the returned
+/// scope drops
+///
+/// A budget that is already entered is not entered again, so nested
+/// operations on one document charge it once.
+pub fn enter(budgets: impl IntoIterator<Item = Arc<MemoryBudget>>) -> Scope {
+    let pushed = ACTIVE
+        .try_with(|active| {
+            let mut active = active.borrow_mut();
+            let before = active.len();
+            for budget in budgets {
+                if !active.iter().any(|b| Arc::ptr_eq(b, &budget)) {
+                    active.push(budget);
+                }
+            }
+            active.len() - before
+        })
+        .unwrap_or(0);
+    Scope { pushed }
+}
+
+impl Scope {
+    /// Clear the exceeded marks of the budgets this scope entered,
+    /// returning whether any was set
+    ///
+    /// Only the outermost scope of a budget sees it here, so an operation
+    /// nested in another leaves reporting to the outer one.
+    pub fn take_exceeded(&self) -> bool {
+        if self.pushed == 0 {
+            return false;
+        }
+        ACTIVE
+            .try_with(|active| {
+                let active = active.borrow();
+                let entered = &active[active.len().saturating_sub(self.pushed)..];
+                entered.iter().fold(false, |any, b| b.take_exceeded() | any)
+            })
+            .unwrap_or(false)
+    }
+}
+
+impl Drop for Scope {
+    fn drop(&mut self) {
+        if self.pushed > 0 {
+            let _ = ACTIVE.try_with(|active| {
+                let mut active = active.borrow_mut();
+                let keep = active.len().saturating_sub(self.pushed);
+                active.truncate(keep);
+            });
+        }
+    }
+}
+
+/// Run `f` on the budgets entered on this thread, if any
+#[inline]
+fn with_active<R>(f: impl FnOnce(&[Arc<MemoryBudget>]) -> R) -> Option<R> {
+    ACTIVE
+        .try_with(|active| {
+            let active = active.borrow();
+            (!active.is_empty()).then(|| f(&active))
+        })
+        .ok()
+        .flatten()
+}
+
+/// Whether a budget entered on this thread has been exceeded
+#[inline]
+pub fn over_limit() -> bool {
+    with_active(|budgets| budgets.iter().any(|b| b.exceeded())).unwrap_or(false)
+}
+
+/// Charge `bytes` to the entered budgets for as long as they live
+#[inline]
+pub fn charge(bytes: usize) {
+    if bytes > 0 {
+        with_active(|budgets| budgets.iter().for_each(|b| b.add(bytes)));
+    }
+}
+
+/// Charge `bytes` to the entered budgets until the returned charge drops
+#[inline]
+pub fn charge_scoped(bytes: usize) -> Option<Charge> {
+    if bytes == 0 {
+        return None;
+    }
+    with_active(|budgets| {
+        budgets.iter().for_each(|b| b.add(bytes));
+        Charge {
+            budgets: budgets.to_vec(),
+            bytes,
+        }
+    })
+}
+
+/// Check that allocating `bytes` would keep every entered budget within
+/// its limit, without charging them; a budget it would not fit is marked
+/// exceeded
+#[inline]
+pub fn admit(bytes: usize) -> bool {
+    with_active(|budgets| {
+        let mut fits = true;
+        for b in budgets.iter().filter(|b| !b.fits(bytes)) {
+            b.exceeded.store(true, Ordering::Relaxed);
+            fits = false;
+        }
+        fits
+    })
+    .unwrap_or(true)
+}
+
+/// Bytes charged to budgets, credited back when dropped
+#[derive(Debug)]
+pub struct Charge {
+    budgets: Vec<Arc<MemoryBudget>>,
+    bytes: usize,
+}
+
+impl Drop for Charge {
+    fn drop(&mut self) {
+        for b in &self.budgets {
+            b.sub(self.bytes);
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn test_charges_inside_scope_only() {
+        let budget = Arc::new(MemoryBudget::new(1000));
+        charge(500);
+        assert_eq!(budget.used(), 0);
+        {
+            let outer = enter([Arc::clone(&budget)]);
+            let inner = enter([Arc::clone(&budget)]);
+            charge(300);
+            let pixels = charge_scoped(600);
+            assert_eq!(budget.used(), 900);
+            assert!(!admit(200));
+            assert!(over_limit());
+            assert!(!inner.take_exceeded());
+            assert!(outer.take_exceeded());
+            assert!(!over_limit());
+            drop(pixels);
+            assert_eq!(budget.used(), 300);
+            assert!(admit(200));
+            charge(800);
+        }
+        assert!(budget.exceeded());
+        assert_eq!(budget.peak(), 1100);
+        assert!(admit(1 << 40));
+    }
+}
@@ -3,25 +3,31 @@
 //! This module provides foundational types for document handling,
 //! geometry, rendering, and I/O operations.
 
+pub mod alloc_sampler;
 pub mod archive;
 pub mod buffer;
 pub mod colorspace;
 pub mod cookie;
+pub mod counters;
 pub mod device;
 pub mod display_list;
 pub mod document;
 pub mod error;
 pub mod font;
+pub mod font_cache;
 pub mod geometry;
 pub mod hash;
 pub mod image;
 pub mod link;
+pub mod memory_budget;
 pub mod output;
 pub mod page;
 pub mod path;
 pub mod pixmap;
+pub mod rtree;
 pub mod stream;
 pub mod text;
+pub mod zip_writer;
 
 #[cfg(feature = "parallel")]
 pub mod parallel;
@@ -5,9 +5,121 @@
 use crate::fitz::buffer::Buffer;
 use crate::fitz::error::{Error, Result};
 use std::fs::{File, OpenOptions};
-use std::io::Write;
+use std::io::{BufWriter, Write};
 use std::path::Path;
 
+/// Bytes a file output gathers before writing them out, so runs of small
+/// writes (single bytes, numbers) don't each cost a system call
+pub const OUTPUT_BUFFER_SIZE: usize = 64 << 10;
+
+/// Longest text an `i64` formats to
+const INT_LEN: usize = 20;
+
+/// Longest text an `f32` formats to: a sign, then 39 integer digits or
+/// "0." and 45 fraction digits
+const REAL_LEN: usize = 48;
+
+/// `n` in decimal, with a leading `-` if `negative`, in the tail of `buf`
+fn format_digits(mut n: u64, negative: bool, buf: &mut [u8; INT_LEN]) -> &[u8] {
+    let mut at = buf.len();
+    loop {
+        at -= 1;
+        buf[at] = b'0' + (n % 10) as u8;
+        n /= 10;
+        if n == 0 {
+            break;
+        }
+    }
+    if negative {
+        at -= 1;
+        buf[at] = b'-';
+    }
+    &buf[at..]
+}
+
+fn format_int(v: i64, buf: &mut [u8; INT_LEN]) -> &[u8] {
+    format_digits(v.unsigned_abs(), v < 0, buf)
+}
+
+/// `v` as PDF writes reals: the shortest decimal that reads back as the
+/// same `f32`, never in exponent form, whole numbers without a point, and
+/// non-finite values (which PDF can't express) as 0
+fn format_real(v: f32, buf: &mut [u8; REAL_LEN]) -> &[u8] {
+    if !v.is_finite() {
+        buf[0] = b'0';
+        return &buf[..1];
+    }
+    // Whole numbers skip float formatting; below 2^24 every f32 integer
+    // fits, and -0 comes out as 0
+    if v.fract() == 0.0 && v.abs() < 16_777_216.0 {
+        let mut digits = [0; INT_LEN];
+        let text = format_int(v as i64, &mut digits);
+        buf[..text.len()].copy_from_slice(text);
+        return &buf[..text.len()];
+    }
+    // std's Display is already shortest round-trip (Grisu, falling back
+    // to Dragon4); writing it in place skips the String
+    let mut cursor = std::io::Cursor::new(&mut buf[..]);
+    let _ = write!(cursor, "{v}");
+    let len = cursor.position() as usize;
+    &buf[..len]
+}
+
+/// Append `v` in decimal
+pub fn push_int(out: &mut Vec<u8>, v: i64) {
+    out.extend_from_slice(format_int(v, &mut [0; INT_LEN]));
+}
+
+/// Append `v` in decimal, zero-padded to `width` digits
+pub fn push_padded(out: &mut Vec<u8>, v: u64, width: usize) {
+    let mut buf = [0; INT_LEN];
+    let text = format_digits(v, false, &mut buf);
+    out.resize(out.len() + width.saturating_sub(text.len()), b'0');
+    out.extend_from_slice(text);
+}
+
+/// Append `v` rounded to `digits` decimal places (at most 9), without
+/// trailing zeros or an exponent
+///
+/// The text is `format!("{v:.digits$}")` with its zeros trimmed, but made
+/// in integer arithmetic: `v` scaled by 10^digits is exact in an `f64`
+/// (24 mantissa bits times at most 21 odd bits), so rounding it ties to
+/// even lands where decimal formatting would.
+pub fn push_fixed(out: &mut Vec<u8>, v: f32, digits: u32) {
+    let digits = digits.min(9);
+    let scale = 10u64.pow(digits);
+    let scaled = (f64::from(v) * scale as f64).round_ties_even();
+    // Past i64 the value has no fraction left to round
+    if scaled.is_nan() || scaled.abs() >= 9.0e18 {
+        push_real(out, v);
+        return;
+    }
+    let n = scaled.abs() as u64;
+    if n == 0 {
+        out.push(b'0');
+        return;
+    }
+    if scaled < 0.0 {
+        out.push(b'-');
+    }
+    let mut buf = [0; INT_LEN];
+    out.extend_from_slice(format_digits(n / scale, false, &mut buf));
+    let (mut frac, mut width) = (n % scale, digits as usize);
+    if frac != 0 {
+        while frac % 10 == 0 {
+            frac /= 10;
+            width -= 1;
+        }
+        out.push(b'.');
+        push_padded(out, frac, width);
+    }
+}
+
+/// Append `v` as a PDF real (see [`Output::write_real`])
+pub fn push_real(out: &mut Vec<u8>, v: f32) {
+    out.extend_from_slice(format_real(v, &mut [0; REAL_LEN]));
+}
+
 /// Output writer trait for abstracting output destinations
 pub trait OutputWriter: Write + Send {
     /// Seek to a position
@@ -117,6 +229,30 @@ impl Output {
         self.write_string(&s)
     }
 
+    /// Write an integer as decimal text
+    pub fn write_int(&mut self, value: i64) -> Result<()> {
+        self.write_data(format_int(value, &mut [0; INT_LEN]))
+    }
+
+    /// Write a real as PDF syntax writes it: the shortest decimal that
+    /// reads back as the same `f32`, with no exponent
+    pub fn write_real(&mut self, value: f32) -> Result<()> {
+        self.write_data(format_real(value, &mut [0; REAL_LEN]))
+    }
+
+    /// Write reals separated by spaces, as a content stream's operands
+    /// are, in one write
+    pub fn write_reals(&mut self, values: &[f32]) -> Result<()> {
+        let mut text = Vec::with_capacity(values.len() * 8);
+        for (i, &v) in values.iter().enumerate() {
+            if i > 0 {
+                text.push(b' ');
+            }
+            push_real(&mut text, v);
+        }
+        self.write_data(&text)
+    }
+
     /// Write a single byte
     pub fn write_byte(&mut self, byte: u8) -> Result<()> {
         self.write_data(&[byte])
@@ -245,12 +381,14 @@ impl Output {
 // ============================================================================
 
 struct FileOutput {
-    file: File,
+    file: BufWriter<File>,
 }
 
 impl FileOutput {
     fn new(file: File) -> Self {
-        Self { file }
+        Self {
+            file: BufWriter::with_capacity(OUTPUT_BUFFER_SIZE, file),
+        }
     }
 }
 
@@ -259,6 +397,10 @@ impl Write for FileOutput {
         self.file.write(buf)
     }
 
+    fn write_all(&mut self, buf: &[u8]) -> std::io::Result<()> {
+        self.file.write_all(buf)
+    }
+
     fn flush(&mut self) -> std::io::Result<()> {
         self.file.flush()
     }
@@ -267,12 +409,19 @@ impl Write for FileOutput {
 impl OutputWriter for FileOutput {
     fn seek(&mut self, _offset: i64, whence: SeekFrom) -> Result<u64> {
         use std::io::Seek;
+        // Flushes what's buffered first
         self.file.seek(whence.into()).map_err(Error::System)
     }
 
     fn tell(&mut self) -> Result<u64> {
         use std::io::Seek;
-        self.file.stream_position().map_err(Error::System)
+        // The file's position plus what's still buffered, without flushing
+        let written = self
+            .file
+            .get_mut()
+            .stream_position()
+            .map_err(Error::System)?;
+        Ok(written + self.file.buffer().len() as u64)
     }
 
     fn flush_output(&mut self) -> Result<()> {
@@ -280,8 +429,9 @@ impl OutputWriter for FileOutput {
     }
 
     fn truncate(&mut self) -> Result<()> {
+        self.flush_output()?;
         let pos = self.tell()?;
-        self.file.set_len(pos).map_err(Error::System)
+        self.file.get_ref().set_len(pos).map_err(Error::System)
     }
 }
 
@@ -551,6 +701,85 @@ mod tests {
         assert_eq!(output.tell().unwrap(), 0);
     }
 
+    #[test]
+    fn test_file_output_buffered() {
+        let temp_file = NamedTempFile::new().unwrap();
+        let path = temp_file.path();
+
+        let mut output = Output::from_path(path, false).unwrap();
+        for _ in 0..OUTPUT_BUFFER_SIZE {
+            output.write_byte(b'x').unwrap();
+        }
+        output.write_string("tail").unwrap();
+        assert_eq!(output.tell().unwrap(), OUTPUT_BUFFER_SIZE as u64 + 4);
+        output.seek(2, SeekFrom::End(-2)).unwrap();
+        output.truncate().unwrap();
+        output.close().unwrap();
+
+        let content = std::fs::read(path).unwrap();
+        assert_eq!(content.len(), OUTPUT_BUFFER_SIZE + 2);
+        assert!(content.ends_with(b"xta"));
+    }
+
+    #[test]
+    fn test_format_numbers() {
+        let int = |v| format_int(v, &mut [0; INT_LEN]).to_vec();
+        assert_eq!(int(0), b"0");
+        assert_eq!(int(-42), b"-42");
+        assert_eq!(int(i64::MIN), b"-9223372036854775808");
+
+        let real = |v| String::from_utf8(format_real(v, &mut [0; REAL_LEN]).to_vec()).unwrap();
+        assert_eq!(real(12.0), "12");
+        assert_eq!(real(-0.0), "0");
+        assert_eq!(real(0.1), "0.1");
+        assert_eq!(real(-1.25), "-1.25");
+        assert_eq!(real(1e20), "100000000000000000000");
+        assert_eq!(real(f32::NAN), "0");
+        for v in [f32::MAX, -f32::MAX, f32::MIN_POSITIVE, 1e-45, 612.3456] {
+            assert_eq!(real(v).parse::<f32>().unwrap(), v);
+        }
+
+        let mut out = Vec::new();
+        push_padded(&mut out, 1234, 10);
+        assert_eq!(out, b"0000001234");
+    }
+
+    #[test]
+    fn test_push_fixed() {
+        let fixed = |v: f32, digits| {
+            let mut out = Vec::new();
+            push_fixed(&mut out, v, digits);
+            String::from_utf8(out).unwrap()
+        };
+        assert_eq!(fixed(12.0, 3), "12");
+        assert_eq!(fixed(0.1, 3), "0.1");
+        assert_eq!(fixed(-0.0004, 3), "0");
+        assert_eq!(fixed(-612.25, 1), "-612.2");
+        assert_eq!(fixed(0.00123, 4), "0.0012");
+        assert_eq!(fixed(f32::INFINITY, 3), "0");
+        // Agrees with formatting then trimming
+        for v in [0.125f32, 2.5, 99.9995, -3.14159, 1e-7, 123456.79, 4e12] {
+            for digits in 0..=6 {
+                let text = format!("{v:.*}", digits as usize);
+                let text = match text.contains('.') {
+                    true => text.trim_end_matches('0').trim_end_matches('.'),
+                    false => &text,
+                };
+                let text = if text == "-0" { "0" } else { text };
+                assert_eq!(fixed(v, digits), text, "{v} to {digits}");
+            }
+        }
+    }
+
+    #[test]
+    fn test_output_write_reals() {
+        let mut out = Output::from_writer(MemoryOutput::new());
+        out.write_reals(&[1.0, 0.5, -612.25]).unwrap();
+        out.write_byte(b' ').unwrap();
+        out.write_int(-7).unwrap();
+        assert_eq!(out.tell().unwrap(), "1 0.5 -612.25 -7".len() as u64);
+    }
+
     #[test]
     fn test_output_write_floats() {
         let output = MemoryOutput::new();
@@ -116,6 +116,11 @@ impl Path {
         }
     }
 
+    /// Reserve room for at least `additional` more elements
+    pub fn reserve(&mut self, additional: usize) {
+        self.elements.reserve(additional);
+    }
+
     /// Move to a point (starts a new subpath)
     pub fn move_to(&mut self, p: Point) {
         self.elements.push(PathElement::MoveTo(p));
@@ -190,6 +195,11 @@ impl Path {
         &self.elements
     }
 
+    /// Append another path's subpaths
+    pub fn append(&mut self, other: &Path) {
+        self.elements.extend_from_slice(&other.elements);
+    }
+
     /// Clear all elements from the path
     pub fn clear(&mut self) {
         self.elements.clear();
@@ -262,6 +272,53 @@ impl Path {
             .iter()
             .all(|e| matches!(e, PathElement::Rect(_)))
     }
+
+    /// Encode the path as a tag byte per element followed by its
+    /// coordinates as little-endian f32
+    pub fn to_bytes(&self) -> Vec<u8> {
+        let mut out = Vec::with_capacity(self.len() * 13);
+        let mut put = |tag: u8, coords: &[f32]| {
+            out.push(tag);
+            coords
+                .iter()
+                .for_each(|c| out.extend_from_slice(&c.to_le_bytes()));
+        };
+        for element in &self.elements {
+            match *element {
+                PathElement::MoveTo(p) => put(0, &[p.x, p.y]),
+                PathElement::LineTo(p) => put(1, &[p.x, p.y]),
+                PathElement::QuadTo(a, b) => put(2, &[a.x, a.y, b.x, b.y]),
+                PathElement::CurveTo(a, b, c) => put(3, &[a.x, a.y, b.x, b.y, c.x, c.y]),
+                PathElement::Close => put(4, &[]),
+                PathElement::Rect(r) => put(5, &[r.x0, r.y0, r.x1, r.y1]),
+            }
+        }
+        out
+    }
+
+    /// Decode [`Path::to_bytes`] output; `None` if it is malformed
+    pub fn from_bytes(mut bytes: &[u8]) -> Option<Path> {
+        let mut path = Path::new();
+        let mut coords = [0.0f32; 6];
+        while let Some((&tag, rest)) = bytes.split_first() {
+            let count = [2, 2, 4, 6, 0, 4].get(tag as usize).copied()?;
+            let (data, rest) = rest.split_at_checked(count * 4)?;
+            for (c, b) in coords.iter_mut().zip(data.chunks_exact(4)) {
+                *c = f32::from_le_bytes(b.try_into().unwrap());
+            }
+            let p = |i: usize| Point::new(coords[i], coords[i + 1]);
+            match tag {
+                0 => path.move_to(p(0)),
+                1 => path.line_to(p(0)),
+                2 => path.quad_to(p(0), p(2)),
+                3 => path.curve_to(p(0), p(2), p(4)),
+                4 => path.close(),
+                _ => path.rect(Rect::new(coords[0], coords[1], coords[2], coords[3])),
+            }
+            bytes = rest;
+        }
+        Some(path)
+    }
 }
 impl Default for Path {
     fn default() -> Self {
@@ -551,4 +608,27 @@ mod tests {
         assert_eq!(bounds.width(), 100.0);
         assert_eq!(bounds.height(), 50.0);
     }
+
+    #[test]
+    fn test_path_roundtrip() {
+        let mut path = Path::new();
+        path.move_to(Point::new(1.0, 2.0));
+        path.line_to(Point::new(3.0, -4.5));
+        path.quad_to(Point::new(5.0, 6.0), Point::new(7.0, 8.0));
+        path.curve_to(
+            Point::new(9.0, 10.0),
+            Point::new(11.0, 12.0),
+            Point::new(13.0, 14.0),
+        );
+        path.close();
+        path.rect(Rect::new(0.0, 0.0, 10.0, 20.0));
+
+        let bytes = path.to_bytes();
+        let decoded = Path::from_bytes(&bytes).unwrap();
+        assert_eq!(decoded.to_bytes(), bytes);
+        assert_eq!(decoded.len(), path.len());
+
+        assert!(Path::from_bytes(&bytes[..bytes.len() - 1]).is_none());
+        assert!(Path::from_bytes(&[9]).is_none());
+    }
 }
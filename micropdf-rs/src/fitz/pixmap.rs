@@ -1,5 +1,6 @@
 //! Pixmap - Pixel buffer for rendering
 
+use crate::fitz::alloc_sampler::{self, Subsystem};
 use crate::fitz::colorspace::Colorspace;
 use crate::fitz::error::{Error, Result};
 use std::sync::Arc;
@@ -34,6 +35,7 @@ impl Pixmap {
             None => return Err(Error::argument("Pixmap must have colorspace or alpha")),
         };
         let stride = (w as usize) * (n as usize);
+        alloc_sampler::record(Subsystem::Pixmap, stride * (h as usize));
         Ok(Self {
             inner: Arc::new(PixmapInner {
                 x: 0,
@@ -0,0 +1,193 @@
+//! Packed R-tree - static spatial index for hit testing
+//!
+//! Items are sorted along a Hilbert curve through their centres and packed
+//! bottom-up into nodes of `NODE_SIZE` children, so the whole tree lives in
+//! two flat arrays and a query touches O(log n) nodes plus the hits. The
+//! tree is immutable once built; rebuild it when the items change.
+
+use crate::fitz::geometry::Rect;
+
+/// Children per node
+pub const NODE_SIZE: usize = 16;
+
+/// Static R-tree over `(id, rect)` items
+#[derive(Debug, Clone, Default)]
+pub struct PackedRTree {
+    /// Node boxes, leaves first, then each level up to the root
+    boxes: Vec<Rect>,
+    /// Item id for leaves; offset of the first child for internal nodes
+    indices: Vec<u32>,
+    /// End offset in `boxes` of each level, leaves first
+    level_ends: Vec<usize>,
+}
+
+impl PackedRTree {
+    /// Build a tree over `items`
+    pub fn new(items: impl IntoIterator<Item = (u32, Rect)>) -> Self {
+        let mut items: Vec<(u32, Rect)> = items.into_iter().collect();
+        if items.is_empty() {
+            return Self::default();
+        }
+
+        let extent = items.iter().fold(Rect::EMPTY, |acc, (_, r)| acc.union(r));
+        let (w, h) = (
+            extent.width().max(f32::MIN_POSITIVE),
+            extent.height().max(f32::MIN_POSITIVE),
+        );
+        let scale =
+            |v: f32, lo: f32, span: f32| (((v - lo) / span).clamp(0.0, 1.0) * 65535.0) as u32;
+        items.sort_by_cached_key(|(_, r)| {
+            let cx = scale((r.x0 + r.x1) / 2.0, extent.x0, w);
+            let cy = scale((r.y0 + r.y1) / 2.0, extent.y0, h);
+            hilbert(cx, cy)
+        });
+
+        let mut tree = Self {
+            boxes: Vec::with_capacity(items.len() * 17 / 16 + 1),
+            indices: Vec::with_capacity(items.len() * 17 / 16 + 1),
+            level_ends: Vec::new(),
+        };
+        for (id, rect) in items {
+            tree.boxes.push(rect);
+            tree.indices.push(id);
+        }
+        tree.level_ends.push(tree.boxes.len());
+
+        let mut start = 0;
+        while tree.boxes.len() - start > 1 {
+            let end = tree.boxes.len();
+            for first in (start..end).step_by(NODE_SIZE) {
+                let last = (first + NODE_SIZE).min(end);
+                let bounds = tree.boxes[first..last]
+                    .iter()
+                    .fold(Rect::EMPTY, |acc, r| acc.union(r));
+                tree.boxes.push(bounds);
+                tree.indices.push(first as u32);
+            }
+            start = end;
+            tree.level_ends.push(tree.boxes.len());
+        }
+        tree
+    }
+
+    /// Number of items
+    pub fn len(&self) -> usize {
+        self.level_ends.first().copied().unwrap_or(0)
+    }
+
+    /// Check if the tree holds no items
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Visit the id of every item whose rect touches `area`
+    ///
+    /// Edges count as touching, so a zero-sized `area` finds the items
+    /// under a point. Ids come in no particular order.
+    pub fn search(&self, area: &Rect, mut visit: impl FnMut(u32)) {
+        let Some(&root) = self.level_ends.last() else {
+            return;
+        };
+        let touches =
+            |r: &Rect| r.x0 <= area.x1 && r.x1 >= area.x0 && r.y0 <= area.y1 && r.y1 >= area.y0;
+        let mut stack = vec![(root - 1, self.level_ends.len() - 1)];
+        while let Some((node, level)) = stack.pop() {
+            if !touches(&self.boxes[node]) {
+                continue;
+            }
+            if level == 0 {
+                visit(self.indices[node]);
+                continue;
+            }
+            let first = self.indices[node] as usize;
+            let last = (first + NODE_SIZE).min(self.level_ends[level - 1]);
+            stack.extend((first..last).map(|child| (child, level - 1)));
+        }
+    }
+
+    /// Ids of the items under a point, in ascending order
+    pub fn at_point(&self, x: f32, y: f32) -> Vec<u32> {
+        let mut ids = Vec::new();
+        self.search(&Rect::new(x, y, x, y), |id| ids.push(id));
+        ids.sort_unstable();
+        ids
+    }
+}
+
+/// Distance along a 16-bit Hilbert curve
+fn hilbert(mut x: u32, mut y: u32) -> u64 {
+    const N: u32 = 1 << 16;
+    let mut d = 0u64;
+    let mut s = N / 2;
+    while s > 0 {
+        let rx = (x & s > 0) as u32;
+        let ry = (y & s > 0) as u32;
+        d += s as u64 * s as u64 * ((3 * rx) ^ ry) as u64;
+        if ry == 0 {
+            if rx == 1 {
+                x = N - 1 - x;
+                y = N - 1 - y;
+            }
+            std::mem::swap(&mut x, &mut y);
+        }
+        s /= 2;
+    }
+    d
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn grid(n: u32) -> Vec<(u32, Rect)> {
+        (0..n * n)
+            .map(|i| {
+                let (x, y) = ((i % n) as f32 * 10.0, (i / n) as f32 * 10.0);
+                (i, Rect::new(x, y, x + 8.0, y + 8.0))
+            })
+            .collect()
+    }
+
+    #[test]
+    fn test_matches_linear_scan() {
+        let items = grid(40);
+        let tree = PackedRTree::new(items.clone());
+        assert_eq!(tree.len(), 1600);
+
+        for area in [
+            Rect::new(0.0, 0.0, 0.0, 0.0),
+            Rect::new(55.0, 55.0, 125.0, 95.0),
+            Rect::new(-10.0, -10.0, 1000.0, 1000.0),
+            Rect::new(8.5, 0.0, 9.5, 400.0),
+        ] {
+            let mut found = Vec::new();
+            tree.search(&area, |id| found.push(id));
+            found.sort_unstable();
+            let expected: Vec<u32> = items
+                .iter()
+                .filter(|(_, r)| {
+                    r.x0 <= area.x1 && r.x1 >= area.x0 && r.y0 <= area.y1 && r.y1 >= area.y0
+                })
+                .map(|(id, _)| *id)
+                .collect();
+            assert_eq!(found, expected);
+        }
+    }
+
+    #[test]
+    fn test_point_queries() {
+        let tree = PackedRTree::new(grid(5));
+        assert_eq!(tree.at_point(12.0, 3.0), vec![1]);
+        assert!(tree.at_point(9.0, 9.0).is_empty());
+
+        let overlapping = PackedRTree::new([
+            (7, Rect::new(0.0, 0.0, 10.0, 10.0)),
+            (3, Rect::new(5.0, 5.0, 15.0, 15.0)),
+        ]);
+        assert_eq!(overlapping.at_point(6.0, 6.0), vec![3, 7]);
+
+        let single = PackedRTree::new([(9, Rect::new(1.0, 1.0, 2.0, 2.0))]);
+        assert_eq!(single.at_point(1.5, 1.5), vec![9]);
+        assert!(PackedRTree::new([]).at_point(0.0, 0.0).is_empty());
+    }
+}
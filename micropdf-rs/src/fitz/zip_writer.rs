@@ -0,0 +1,326 @@
+//! Streaming ZIP writer
+//!
+//! Entries go straight to the output as they are written: an entry
+//! opened with [`ZipWriter::begin_entry`] is deflated chunk by chunk and
+//! closed with a data descriptor, so its size never has to be known (or
+//! held) up front. The central directory is written by
+//! [`ZipWriter::finish`]. Only what the central directory needs is kept
+//! per entry, so memory stays flat however large the archive grows.
+//!
+//! ZIP64 is not written; an archive past 4 GiB or 65535 entries fails.
+
+use crate::fitz::archive::{ZIP_METHOD_DEFLATED, ZIP_METHOD_STORED};
+use crate::fitz::error::{Error, Result};
+use flate2::{Compress, Compression, Crc, FlushCompress, Status};
+use std::io::Write;
+
+/// General purpose flag: sizes and CRC follow the data
+const FLAG_DATA_DESCRIPTOR: u16 = 1 << 3;
+/// General purpose flag: the name is UTF-8
+const FLAG_UTF8: u16 = 1 << 11;
+/// Version needed to extract: deflate
+const ZIP_VERSION: u16 = 20;
+/// DOS date for 1980-01-01, so output doesn't depend on the clock
+const ZIP_DATE: u16 = (1 << 5) | 1;
+
+/// Deflate output is written out in chunks of this size
+const ZIP_CHUNK: usize = 64 * 1024;
+
+/// What the central directory records for an entry
+struct ZipEntry {
+    name: String,
+    flags: u16,
+    method: u16,
+    crc: u32,
+    compressed: u32,
+    size: u32,
+    offset: u32,
+}
+
+/// The entry being streamed
+struct OpenEntry {
+    name: String,
+    offset: u32,
+    crc: Crc,
+    deflate: Compress,
+}
+
+/// Writes a ZIP archive to `W` as entries arrive
+pub struct ZipWriter<W: Write> {
+    out: W,
+    /// Bytes written so far
+    offset: u64,
+    entries: Vec<ZipEntry>,
+    open: Option<OpenEntry>,
+    chunk: Vec<u8>,
+}
+
+impl<W: Write> ZipWriter<W> {
+    /// Start an archive on `out`
+    pub fn new(out: W) -> Self {
+        Self {
+            out,
+            offset: 0,
+            entries: Vec::new(),
+            open: None,
+            chunk: vec![0; ZIP_CHUNK],
+        }
+    }
+
+    /// Number of entries written or open
+    pub fn len(&self) -> usize {
+        self.entries.len() + usize::from(self.open.is_some())
+    }
+
+    /// Check if nothing has been written
+    pub fn is_empty(&self) -> bool {
+        self.len() == 0
+    }
+
+    /// Write a whole entry, deflated with `compress`, else stored
+    pub fn add_entry(&mut self, name: &str, data: &[u8], compress: bool) -> Result<()> {
+        if self.open.is_some() {
+            return Err(Error::argument("zip entry still open"));
+        }
+        let mut crc = Crc::new();
+        crc.update(data);
+        let deflated;
+        let (method, body) = if compress {
+            let mut encoder =
+                flate2::write::DeflateEncoder::new(Vec::new(), Compression::default());
+            encoder.write_all(data)?;
+            deflated = encoder.finish()?;
+            (ZIP_METHOD_DEFLATED, &deflated[..])
+        } else {
+            (ZIP_METHOD_STORED, data)
+        };
+        let entry = ZipEntry {
+            name: name.to_string(),
+            flags: FLAG_UTF8,
+            method,
+            crc: crc.sum(),
+            compressed: zip32(body.len() as u64)?,
+            size: zip32(data.len() as u64)?,
+            offset: zip32(self.offset)?,
+        };
+        self.write_local_header(&entry)?;
+        self.emit(body)?;
+        self.entries.push(entry);
+        Ok(())
+    }
+
+    /// Open a deflated entry whose data follows in [`ZipWriter::write`]
+    /// calls, up to [`ZipWriter::end_entry`]
+    pub fn begin_entry(&mut self, name: &str) -> Result<()> {
+        if self.open.is_some() {
+            return Err(Error::argument("zip entry still open"));
+        }
+        let header = ZipEntry {
+            name: name.to_string(),
+            flags: FLAG_UTF8 | FLAG_DATA_DESCRIPTOR,
+            method: ZIP_METHOD_DEFLATED,
+            crc: 0,
+            compressed: 0,
+            size: 0,
+            offset: zip32(self.offset)?,
+        };
+        self.write_local_header(&header)?;
+        self.open = Some(OpenEntry {
+            name: header.name,
+            offset: header.offset,
+            crc: Crc::new(),
+            deflate: Compress::new(Compression::default(), false),
+        });
+        Ok(())
+    }
+
+    /// Append to the open entry
+    pub fn write(&mut self, mut data: &[u8]) -> Result<()> {
+        let Some(entry) = self.open.as_mut() else {
+            return Err(Error::argument("no zip entry open"));
+        };
+        entry.crc.update(data);
+        while !data.is_empty() {
+            let (read, written) = (entry.deflate.total_in(), entry.deflate.total_out());
+            entry
+                .deflate
+                .compress(data, &mut self.chunk, FlushCompress::None)
+                .map_err(|e| Error::generic(format!("deflate: {e}")))?;
+            let consumed = (entry.deflate.total_in() - read) as usize;
+            let produced = (entry.deflate.total_out() - written) as usize;
+            self.out.write_all(&self.chunk[..produced])?;
+            self.offset += produced as u64;
+            data = &data[consumed..];
+        }
+        Ok(())
+    }
+
+    /// Finish the open entry and write its data descriptor
+    pub fn end_entry(&mut self) -> Result<()> {
+        let Some(mut entry) = self.open.take() else {
+            return Err(Error::argument("no zip entry open"));
+        };
+        loop {
+            let written = entry.deflate.total_out();
+            let status = entry
+                .deflate
+                .compress(&[], &mut self.chunk, FlushCompress::Finish)
+                .map_err(|e| Error::generic(format!("deflate: {e}")))?;
+            let produced = (entry.deflate.total_out() - written) as usize;
+            self.out.write_all(&self.chunk[..produced])?;
+            self.offset += produced as u64;
+            if status == Status::StreamEnd {
+                break;
+            }
+        }
+        let done = ZipEntry {
+            name: entry.name,
+            flags: FLAG_UTF8 | FLAG_DATA_DESCRIPTOR,
+            method: ZIP_METHOD_DEFLATED,
+            crc: entry.crc.sum(),
+            compressed: zip32(entry.deflate.total_out())?,
+            size: zip32(entry.deflate.total_in())?,
+            offset: entry.offset,
+        };
+        let mut descriptor = Vec::with_capacity(16);
+        put32(&mut descriptor, 0x0807_4b50);
+        put32(&mut descriptor, done.crc);
+        put32(&mut descriptor, done.compressed);
+        put32(&mut descriptor, done.size);
+        self.emit(&descriptor)?;
+        self.entries.push(done);
+        Ok(())
+    }
+
+    /// Write the central directory and hand back the output
+    pub fn finish(mut self) -> Result<W> {
+        if self.open.is_some() {
+            self.end_entry()?;
+        }
+        let count = u16::try_from(self.entries.len())
+            .map_err(|_| Error::limit("zip archive has too many entries"))?;
+        let start = zip32(self.offset)?;
+        let mut dir = Vec::new();
+        for e in &self.entries {
+            put32(&mut dir, 0x0201_4b50);
+            put16(&mut dir, ZIP_VERSION);
+            put16(&mut dir, ZIP_VERSION);
+            put16(&mut dir, e.flags);
+            put16(&mut dir, e.method);
+            put16(&mut dir, 0);
+            put16(&mut dir, ZIP_DATE);
+            put32(&mut dir, e.crc);
+            put32(&mut dir, e.compressed);
+            put32(&mut dir, e.size);
+            put16(&mut dir, e.name.len() as u16);
+            // Extra field, comment, disk, internal and external attributes
+            dir.extend_from_slice(&[0; 12]);
+            put32(&mut dir, e.offset);
+            dir.extend_from_slice(e.name.as_bytes());
+        }
+        let size = zip32(dir.len() as u64)?;
+        put32(&mut dir, 0x0605_4b50);
+        put32(&mut dir, 0);
+        put16(&mut dir, count);
+        put16(&mut dir, count);
+        put32(&mut dir, size);
+        put32(&mut dir, start);
+        put16(&mut dir, 0);
+        self.emit(&dir)?;
+        self.out.flush()?;
+        Ok(self.out)
+    }
+
+    fn write_local_header(&mut self, e: &ZipEntry) -> Result<()> {
+        if e.name.len() > u16::MAX as usize {
+            return Err(Error::argument("zip entry name too long"));
+        }
+        let mut header = Vec::with_capacity(30 + e.name.len());
+        put32(&mut header, 0x0403_4b50);
+        put16(&mut header, ZIP_VERSION);
+        put16(&mut header, e.flags);
+        put16(&mut header, e.method);
+        put16(&mut header, 0);
+        put16(&mut header, ZIP_DATE);
+        put32(&mut header, e.crc);
+        put32(&mut header, e.compressed);
+        put32(&mut header, e.size);
+        put16(&mut header, e.name.len() as u16);
+        put16(&mut header, 0);
+        header.extend_from_slice(e.name.as_bytes());
+        self.emit(&header)
+    }
+
+    fn emit(&mut self, bytes: &[u8]) -> Result<()> {
+        self.out.write_all(bytes)?;
+        self.offset += bytes.len() as u64;
+        Ok(())
+    }
+}
+
+/// A size or offset as the 32 bits a non-ZIP64 archive allows
+fn zip32(n: u64) -> Result<u32> {
+    u32::try_from(n).map_err(|_| Error::limit("zip archive over 4 GiB"))
+}
+
+fn put16(out: &mut Vec<u8>, v: u16) {
+    out.extend_from_slice(&v.to_le_bytes());
+}
+
+fn put32(out: &mut Vec<u8>, v: u32) {
+    out.extend_from_slice(&v.to_le_bytes());
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::fitz::archive::Archive;
+
+    #[test]
+    fn test_zip_writer_roundtrip() {
+        let mut zip = ZipWriter::new(Vec::new());
+        zip.add_entry("mimetype", b"application/x-test", false)
+            .unwrap();
+        zip.begin_entry("pages.xml").unwrap();
+        let mut expected = Vec::new();
+        for page in 0..500 {
+            let line = format!("<page n=\"{page}\">some repeated page text</page>\n");
+            zip.write(line.as_bytes()).unwrap();
+            expected.extend_from_slice(line.as_bytes());
+        }
+        zip.end_entry().unwrap();
+        zip.add_entry("small.txt", b"hello hello hello", true)
+            .unwrap();
+        assert_eq!(zip.len(), 3);
+        let bytes = zip.finish().unwrap();
+        // The first entry is stored where readers sniff for it
+        assert_eq!(&bytes[30..38], b"mimetype");
+        assert!(bytes.len() < expected.len());
+
+        let mut archive = Archive::from_buffer(bytes).unwrap();
+        assert_eq!(archive.count_entries().unwrap(), 3);
+        assert_eq!(
+            archive.read_entry("mimetype").unwrap(),
+            b"application/x-test"
+        );
+        assert_eq!(archive.read_entry("pages.xml").unwrap(), expected);
+        assert_eq!(
+            archive.read_entry("small.txt").unwrap(),
+            b"hello hello hello"
+        );
+    }
+
+    #[test]
+    fn test_zip_writer_misuse() {
+        let mut zip = ZipWriter::new(Vec::new());
+        assert!(zip.write(b"x").is_err());
+        assert!(zip.end_entry().is_err());
+        zip.begin_entry("a").unwrap();
+        assert!(zip.begin_entry("b").is_err());
+        assert!(zip.add_entry("c", b"", false).is_err());
+        // finish closes the open entry
+        let bytes = zip.finish().unwrap();
+        let mut archive = Archive::from_buffer(bytes).unwrap();
+        assert_eq!(archive.read_entry("a").unwrap(), b"");
+    }
+}
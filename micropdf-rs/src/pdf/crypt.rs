@@ -3,14 +3,9 @@
 //! Supports RC4 and AES encryption algorithms with password authentication.
 
 use crate::fitz::error::{Error, Result};
-use aes::cipher::{BlockDecryptMut, BlockEncryptMut, KeyIvInit};
+use crate::pdf::filter::{aes_decrypt, aes_encrypt};
 use md5::{Digest, Md5};
 
-type Aes128CbcEnc = cbc::Encryptor<aes::Aes128>;
-type Aes128CbcDec = cbc::Decryptor<aes::Aes128>;
-type Aes256CbcEnc = cbc::Encryptor<aes::Aes256>;
-type Aes256CbcDec = cbc::Decryptor<aes::Aes256>;
-
 /// PDF encryption algorithm type
 #[derive(Debug, Clone, Copy, PartialEq, Eq)]
 pub enum EncryptionAlgorithm {
@@ -214,6 +209,10 @@ impl Crypt {
 
     /// Compute object encryption key
     fn compute_object_key(&self, num: i32, generation: i32) -> Vec<u8> {
+        // AESV3 uses the file key for every object
+        if self.algorithm == EncryptionAlgorithm::Aes256 {
+            return self.key.clone();
+        }
         let mut hasher = Md5::new();
         hasher.update(&self.key);
         hasher.update(&num.to_le_bytes()[..3]); // Lower 3 bytes of object number
@@ -263,92 +262,18 @@ impl Crypt {
         self.encrypt_rc4(data, obj_key)
     }
 
-    /// Encrypt data using AES-128
-    fn encrypt_aes128(&self, data: &[u8], obj_key: &[u8]) -> Result<Vec<u8>> {
-        // Generate random IV (16 bytes for AES)
-        let iv = [0u8; 16]; // In production, use random IV
-
-        // Pad data to block size (16 bytes)
-        let mut padded = data.to_vec();
-        let padding_len = 16 - (data.len() % 16);
-        padded.extend(vec![padding_len as u8; padding_len]);
-
-        // Encrypt
-        let cipher = Aes128CbcEnc::new_from_slices(obj_key, &iv)
-            .map_err(|e| Error::Generic(format!("AES key/IV error: {:?}", e)))?;
-
-        let mut result = vec![0u8; padded.len()];
-        cipher
-            .encrypt_padded_b2b_mut::<aes::cipher::block_padding::NoPadding>(&padded, &mut result)
-            .map_err(|e| Error::Generic(format!("AES encryption error: {:?}", e)))?;
-
-        // Prepend IV
-        let mut output = iv.to_vec();
-        output.extend(result);
-        Ok(output)
-    }
-
-    /// Decrypt data using AES-128
-    fn decrypt_aes128(&self, data: &[u8], obj_key: &[u8]) -> Result<Vec<u8>> {
-        if data.len() < 16 {
-            return Err(Error::Generic("Invalid AES encrypted data".to_string()));
-        }
-
-        // Extract IV (first 16 bytes)
-        let iv = &data[..16];
-        let encrypted = &data[16..];
-
-        // Decrypt
-        let cipher = Aes128CbcDec::new_from_slices(obj_key, iv)
-            .map_err(|e| Error::Generic(format!("AES key/IV error: {:?}", e)))?;
-
-        let mut result = vec![0u8; encrypted.len()];
-        cipher
-            .decrypt_padded_b2b_mut::<aes::cipher::block_padding::Pkcs7>(encrypted, &mut result)
-            .map_err(|e| Error::Generic(format!("AES decryption error: {:?}", e)))?;
-
-        Ok(result)
-    }
-
-    /// Encrypt data using AES-256
-    fn encrypt_aes256(&self, data: &[u8], obj_key: &[u8]) -> Result<Vec<u8>> {
+    /// Encrypt data using AES (128-bit or 256-bit, by key length)
+    fn encrypt_aes(&self, data: &[u8], obj_key: &[u8]) -> Result<Vec<u8>> {
         let iv = [0u8; 16]; // In production, use random IV
-
-        let mut padded = data.to_vec();
-        let padding_len = 16 - (data.len() % 16);
-        padded.extend(vec![padding_len as u8; padding_len]);
-
-        let cipher = Aes256CbcEnc::new_from_slices(obj_key, &iv)
-            .map_err(|e| Error::Generic(format!("AES key/IV error: {:?}", e)))?;
-
-        let mut result = vec![0u8; padded.len()];
-        cipher
-            .encrypt_padded_b2b_mut::<aes::cipher::block_padding::NoPadding>(&padded, &mut result)
-            .map_err(|e| Error::Generic(format!("AES encryption error: {:?}", e)))?;
-
-        let mut output = iv.to_vec();
-        output.extend(result);
-        Ok(output)
+        aes_encrypt(obj_key, &iv, data)
     }
 
-    /// Decrypt data using AES-256
-    fn decrypt_aes256(&self, data: &[u8], obj_key: &[u8]) -> Result<Vec<u8>> {
+    /// Decrypt data using AES (128-bit or 256-bit, by key length)
+    fn decrypt_aes(&self, data: &[u8], obj_key: &[u8]) -> Result<Vec<u8>> {
         if data.len() < 16 {
             return Err(Error::Generic("Invalid AES encrypted data".to_string()));
         }
-
-        let iv = &data[..16];
-        let encrypted = &data[16..];
-
-        let cipher = Aes256CbcDec::new_from_slices(obj_key, iv)
-            .map_err(|e| Error::Generic(format!("AES key/IV error: {:?}", e)))?;
-
-        let mut result = vec![0u8; encrypted.len()];
-        cipher
-            .decrypt_padded_b2b_mut::<aes::cipher::block_padding::Pkcs7>(encrypted, &mut result)
-            .map_err(|e| Error::Generic(format!("AES decryption error: {:?}", e)))?;
-
-        Ok(result)
+        aes_decrypt(obj_key, data)
     }
 
     /// Encrypt data for a specific object
@@ -363,8 +288,9 @@ impl Crypt {
             EncryptionAlgorithm::Rc4_40 | EncryptionAlgorithm::Rc4_128 => {
                 self.encrypt_rc4(data, &obj_key)
             }
-            EncryptionAlgorithm::Aes128 => self.encrypt_aes128(data, &obj_key),
-            EncryptionAlgorithm::Aes256 => self.encrypt_aes256(data, &obj_key),
+            EncryptionAlgorithm::Aes128 | EncryptionAlgorithm::Aes256 => {
+                self.encrypt_aes(data, &obj_key)
+            }
             _ => Err(Error::Generic(
                 "Unsupported encryption algorithm".to_string(),
             )),
@@ -383,8 +309,9 @@ impl Crypt {
             EncryptionAlgorithm::Rc4_40 | EncryptionAlgorithm::Rc4_128 => {
                 self.decrypt_rc4(data, &obj_key)
             }
-            EncryptionAlgorithm::Aes128 => self.decrypt_aes128(data, &obj_key),
-            EncryptionAlgorithm::Aes256 => self.decrypt_aes256(data, &obj_key),
+            EncryptionAlgorithm::Aes128 | EncryptionAlgorithm::Aes256 => {
+                self.decrypt_aes(data, &obj_key)
+            }
             _ => Err(Error::Generic(
                 "Unsupported encryption algorithm".to_string(),
             )),
@@ -545,6 +472,24 @@ mod tests {
         assert_eq!(decrypted, original);
     }
 
+    #[test]
+    fn test_aes128_encrypt_decrypt() {
+        let crypt = Crypt::new_encrypt(
+            "owner",
+            "user",
+            vec![1, 2, 3, 4],
+            0xFFFFF0C0,
+            EncryptionAlgorithm::Aes128,
+        )
+        .unwrap();
+
+        let original = b"Hello, World! This is a test.";
+        let encrypted = crypt.encrypt_data(original, 7, 0).unwrap();
+        assert_eq!(encrypted.len(), 16 + 32);
+        assert_eq!(crypt.decrypt_data(&encrypted, 7, 0).unwrap(), original);
+        assert_ne!(crypt.decrypt_data(&encrypted, 8, 0).unwrap(), original);
+    }
+
     #[test]
     fn test_permissions() {
         let doc_id = vec![1, 2, 3, 4, 5, 6, 7, 8];
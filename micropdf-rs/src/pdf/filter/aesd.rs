@@ -0,0 +1,243 @@
+//! AES-CBC Decryption for Encrypted Documents
+//!
+//! Strings and streams of documents under the AESV2 (128-bit) and AESV3
+//! (256-bit) crypt filters are a 16-byte IV followed by PKCS#7 padded
+//! CBC ciphertext. The `aes` crate picks AES-NI on x86 and the ARMv8
+//! crypto extensions on aarch64 at run time, falling back to a constant
+//! time software cipher; CBC decryption has no dependency between blocks,
+//! so handing it whole chunks lets it keep eight blocks in flight.
+//!
+//! `decrypt_inflate` runs decryption and inflate together: each chunk is
+//! decrypted into a fixed buffer and inflated from there, so the whole
+//! plaintext of a compressed stream never exists at once.
+
+use super::flate::{InflateInput, inflate_from};
+use crate::fitz::error::{Error, Result};
+use aes::cipher::block_padding::{NoPadding, Pkcs7};
+use aes::cipher::{BlockDecryptMut, BlockEncryptMut, KeyIvInit};
+
+type Aes128CbcEnc = cbc::Encryptor<aes::Aes128>;
+type Aes128CbcDec = cbc::Decryptor<aes::Aes128>;
+type Aes256CbcEnc = cbc::Encryptor<aes::Aes256>;
+type Aes256CbcDec = cbc::Decryptor<aes::Aes256>;
+
+/// AES block and IV size
+pub const AES_BLOCK: usize = 16;
+
+/// Ciphertext decrypted per step when decrypting into inflate
+const DECRYPT_CHUNK: usize = 16 * 1024;
+
+fn check_key(key: &[u8]) -> Result<()> {
+    match key.len() {
+        16 | 32 => Ok(()),
+        n => Err(Error::Generic(format!(
+            "AES key must be 16 or 32 bytes, not {}",
+            n
+        ))),
+    }
+}
+
+/// Decrypt whole blocks of `input` into `out`, chaining from `iv`
+fn cbc_decrypt(key: &[u8], iv: &[u8], input: &[u8], out: &mut [u8]) -> Result<()> {
+    let done = match key.len() {
+        16 => Aes128CbcDec::new_from_slices(key, iv)
+            .ok()
+            .map(|c| c.decrypt_padded_b2b_mut::<NoPadding>(input, out).is_ok()),
+        32 => Aes256CbcDec::new_from_slices(key, iv)
+            .ok()
+            .map(|c| c.decrypt_padded_b2b_mut::<NoPadding>(input, out).is_ok()),
+        _ => None,
+    };
+    match done {
+        Some(true) => Ok(()),
+        _ => Err(Error::Generic("AES decryption failed".to_string())),
+    }
+}
+
+/// Length of `plain` without its PKCS#7 padding
+///
+/// Padding that is out of range is kept, as MuPDF does, rather than
+/// failing the stream.
+fn unpadded_len(plain: &[u8]) -> usize {
+    match plain.last() {
+        Some(&pad) if (1..=AES_BLOCK as u8).contains(&pad) && usize::from(pad) <= plain.len() => {
+            plain.len() - usize::from(pad)
+        }
+        _ => plain.len(),
+    }
+}
+
+/// The ciphertext of an encrypted string or stream, decrypted a chunk at
+/// a time
+struct CbcChunks<'a> {
+    key: &'a [u8],
+    iv: [u8; AES_BLOCK],
+    /// Whole blocks not yet decrypted
+    rest: &'a [u8],
+}
+
+impl<'a> CbcChunks<'a> {
+    /// A partial block at the end is dropped, and data too short for an
+    /// IV decrypts to nothing.
+    fn new(key: &'a [u8], data: &'a [u8]) -> Result<Self> {
+        check_key(key)?;
+        let mut iv = [0u8; AES_BLOCK];
+        let rest = match data.split_at_checked(AES_BLOCK) {
+            Some((head, rest)) => {
+                iv.copy_from_slice(head);
+                &rest[..rest.len() / AES_BLOCK * AES_BLOCK]
+            }
+            None => &[],
+        };
+        Ok(Self { key, iv, rest })
+    }
+
+    fn len(&self) -> usize {
+        self.rest.len()
+    }
+
+    /// Decrypt the next chunk into `out`, whose length must be a whole
+    /// number of blocks; the last chunk comes without its padding
+    ///
+    /// Returns the plaintext length, or `None` once all is decrypted.
+    fn next_into(&mut self, out: &mut [u8]) -> Result<Option<usize>> {
+        if self.rest.is_empty() {
+            return Ok(None);
+        }
+        let n = self.rest.len().min(out.len() / AES_BLOCK * AES_BLOCK);
+        let (chunk, rest) = self.rest.split_at(n);
+        cbc_decrypt(self.key, &self.iv, chunk, &mut out[..n])?;
+        self.iv.copy_from_slice(&chunk[n - AES_BLOCK..]);
+        self.rest = rest;
+        Ok(Some(if rest.is_empty() {
+            unpadded_len(&out[..n])
+        } else {
+            n
+        }))
+    }
+}
+
+/// Decrypt an AES-CBC encrypted string or stream with `key` (16 or 32
+/// bytes)
+///
+/// The plaintext is written once, straight from the ciphertext.
+pub fn aes_decrypt(key: &[u8], data: &[u8]) -> Result<Vec<u8>> {
+    let mut chunks = CbcChunks::new(key, data)?;
+    let mut out = vec![0u8; chunks.len()];
+    let len = chunks.next_into(&mut out)?.unwrap_or(0);
+    out.truncate(len);
+    Ok(out)
+}
+
+/// Encrypt `data` with `key` (16 or 32 bytes) as an AES-CBC string or
+/// stream: `iv`, then the PKCS#7 padded ciphertext
+pub fn aes_encrypt(key: &[u8], iv: &[u8; AES_BLOCK], data: &[u8]) -> Result<Vec<u8>> {
+    check_key(key)?;
+    let padded = (data.len() / AES_BLOCK + 1) * AES_BLOCK;
+    let mut out = vec![0u8; AES_BLOCK + padded];
+    out[..AES_BLOCK].copy_from_slice(iv);
+    let body = &mut out[AES_BLOCK..];
+    let done = match key.len() {
+        16 => Aes128CbcEnc::new_from_slices(key, iv)
+            .ok()
+            .map(|c| c.encrypt_padded_b2b_mut::<Pkcs7>(data, body).is_ok()),
+        _ => Aes256CbcEnc::new_from_slices(key, iv)
+            .ok()
+            .map(|c| c.encrypt_padded_b2b_mut::<Pkcs7>(data, body).is_ok()),
+    };
+    match done {
+        Some(true) => Ok(out),
+        _ => Err(Error::Generic("AES encryption failed".to_string())),
+    }
+}
+
+/// Ciphertext fed to inflate, decrypted a chunk at a time into a fixed
+/// buffer
+struct CbcInput<'a> {
+    chunks: CbcChunks<'a>,
+    plain: Vec<u8>,
+}
+
+impl InflateInput for CbcInput<'_> {
+    fn size_hint(&self) -> usize {
+        self.chunks.len()
+    }
+
+    fn next_piece(&mut self) -> Result<Option<&[u8]>> {
+        let n = self.chunks.next_into(&mut self.plain)?;
+        Ok(n.map(|n| &self.plain[..n]))
+    }
+}
+
+/// Decrypt an AES-CBC encrypted, Flate compressed stream and inflate it
+///
+/// Only `DECRYPT_CHUNK` bytes of plaintext are held at a time. `zlib_header`
+/// and `size_hint` are as for `inflate`; a stream that ends early keeps
+/// what was inflated.
+pub fn decrypt_inflate(
+    key: &[u8],
+    data: &[u8],
+    zlib_header: bool,
+    size_hint: usize,
+) -> Result<Vec<u8>> {
+    let chunks = CbcChunks::new(key, data)?;
+    let plain = vec![0u8; DECRYPT_CHUNK.min(chunks.len())];
+    inflate_from(
+        &mut CbcInput { chunks, plain },
+        zlib_header,
+        size_hint,
+        None,
+    )
+}
+
+#[cfg(test)]
+mod tests {
+    use super::super::flate::encode_flate;
+    use super::*;
+
+    fn text(len: usize) -> Vec<u8> {
+        (0..len)
+            .map(|i| b"BT /F1 12 Tf (aes) Tj ET\n"[i % 25])
+            .collect()
+    }
+
+    #[test]
+    fn test_aes_round_trip() {
+        let iv = [7u8; AES_BLOCK];
+        for key in [&[1u8; 16][..], &[2u8; 32][..]] {
+            for len in [0, 1, 15, 16, 17, 4096] {
+                let plain = text(len);
+                let encrypted = aes_encrypt(key, &iv, &plain).unwrap();
+                assert_eq!(encrypted.len() % AES_BLOCK, 0);
+                assert_eq!(&encrypted[..AES_BLOCK], &iv);
+                assert_eq!(aes_decrypt(key, &encrypted).unwrap(), plain);
+            }
+        }
+        assert!(aes_decrypt(&[0u8; 24], &[0u8; 32]).is_err());
+        assert!(aes_decrypt(&[0u8; 16], b"short").unwrap().is_empty());
+    }
+
+    #[test]
+    fn test_decrypt_inflate_matches_two_steps() {
+        let key = [9u8; 32];
+        // Several decrypt chunks' worth of compressed data
+        let plain: Vec<u8> = (0..400_000u32)
+            .flat_map(|i| (i / 3).wrapping_mul(2_654_435_761).to_le_bytes())
+            .collect();
+        let compressed = encode_flate(&plain, 6).unwrap();
+        assert!(compressed.len() > 2 * DECRYPT_CHUNK);
+        let encrypted = aes_encrypt(&key, &[3u8; AES_BLOCK], &compressed).unwrap();
+
+        assert_eq!(aes_decrypt(&key, &encrypted).unwrap(), compressed);
+        assert_eq!(decrypt_inflate(&key, &encrypted, true, 0).unwrap(), plain);
+        assert_eq!(
+            decrypt_inflate(&key, &encrypted, true, plain.len()).unwrap(),
+            plain
+        );
+
+        // Truncated ciphertext keeps what inflated
+        let cut = &encrypted[..encrypted.len() / 2 / AES_BLOCK * AES_BLOCK];
+        let partial = decrypt_inflate(&key, cut, true, 0).unwrap();
+        assert!(!partial.is_empty() && plain.starts_with(&partial));
+    }
+}
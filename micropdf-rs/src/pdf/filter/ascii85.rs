@@ -1,67 +1,152 @@
 //! ASCII85Decode Filter Implementation
 
+use super::flate::{InflateInput, inflate_from};
+use super::params::FlateDecodeParams;
 use crate::fitz::error::{Error, Result};
 
+/// Decoded bytes produced per step when decoding into inflate
+const A85_CHUNK: usize = 16 * 1024;
+
 /// Decode ASCII85 encoded data
 pub fn decode_ascii85(data: &[u8]) -> Result<Vec<u8>> {
     let mut result = Vec::with_capacity(data.len() * 4 / 5);
-    let mut group: u32 = 0;
-    let mut count = 0;
+    A85Decoder::new(data).decode_into(&mut result, usize::MAX)?;
+    Ok(result)
+}
 
-    for &byte in data {
-        // Skip whitespace
-        if byte.is_ascii_whitespace() {
-            continue;
-        }
+/// Decode ASCII85 encoded, Flate compressed data (the `[/ASCII85Decode
+/// /FlateDecode]` chain) in one pass
+///
+/// The ASCII85 is decoded `A85_CHUNK` bytes at a time into a fixed buffer
+/// that is inflated from, rather than into a buffer of the whole
+/// compressed stream.
+pub fn decode_ascii85_flate(data: &[u8], params: Option<&FlateDecodeParams>) -> Result<Vec<u8>> {
+    let mut input = A85Input {
+        decoder: A85Decoder::new(data),
+        chunk: Vec::with_capacity(A85_CHUNK),
+    };
+    inflate_from(&mut input, true, 0, params)
+}
+
+/// ASCII85 decoding that can stop and resume between groups
+struct A85Decoder<'a> {
+    data: &'a [u8],
+    pos: usize,
+    group: u32,
+    count: usize,
+    done: bool,
+}
 
-        // End of data marker
-        if byte == b'~' {
-            break;
+impl<'a> A85Decoder<'a> {
+    fn new(data: &'a [u8]) -> Self {
+        Self {
+            data,
+            pos: 0,
+            group: 0,
+            count: 0,
+            done: false,
         }
+    }
 
-        // Special 'z' character represents 4 zero bytes
-        if byte == b'z' {
-            if count != 0 {
-                return Err(Error::Generic("Invalid 'z' in ASCII85 stream".into()));
+    /// Decode into `out` until the data ends or `out` has no room for
+    /// another group below `limit`
+    fn decode_into(&mut self, out: &mut Vec<u8>, limit: usize) -> Result<()> {
+        while !self.done && out.len().saturating_add(4) <= limit {
+            // Five digits in a row, the bulk of any stream, in one step
+            if self.count == 0 {
+                if let Some(digits) = self.data.get(self.pos..self.pos + 5) {
+                    if digits.iter().all(|b| (b'!'..=b'u').contains(b)) {
+                        let group = digits.iter().fold(0u32, |group, &b| {
+                            group.wrapping_mul(85).wrapping_add(u32::from(b - b'!'))
+                        });
+                        out.extend_from_slice(&group.to_be_bytes());
+                        self.pos += 5;
+                        continue;
+                    }
+                }
             }
-            result.extend_from_slice(&[0, 0, 0, 0]);
-            continue;
-        }
 
-        // Regular ASCII85 character
-        if !(b'!'..=b'u').contains(&byte) {
-            return Err(Error::Generic(format!(
-                "Invalid ASCII85 character: {}",
-                byte
-            )));
-        }
+            let Some(&byte) = self.data.get(self.pos) else {
+                self.finish(out);
+                break;
+            };
+            self.pos += 1;
+
+            // Skip whitespace
+            if byte.is_ascii_whitespace() {
+                continue;
+            }
+
+            // End of data marker
+            if byte == b'~' {
+                self.finish(out);
+                break;
+            }
+
+            // Special 'z' character represents 4 zero bytes
+            if byte == b'z' {
+                if self.count != 0 {
+                    return Err(Error::Generic("Invalid 'z' in ASCII85 stream".into()));
+                }
+                out.extend_from_slice(&[0, 0, 0, 0]);
+                continue;
+            }
 
-        group = group * 85 + (byte - b'!') as u32;
-        count += 1;
+            // Regular ASCII85 character
+            if !(b'!'..=b'u').contains(&byte) {
+                return Err(Error::Generic(format!(
+                    "Invalid ASCII85 character: {}",
+                    byte
+                )));
+            }
+
+            self.group = self
+                .group
+                .wrapping_mul(85)
+                .wrapping_add(u32::from(byte - b'!'));
+            self.count += 1;
 
-        if count == 5 {
-            result.push((group >> 24) as u8);
-            result.push((group >> 16) as u8);
-            result.push((group >> 8) as u8);
-            result.push(group as u8);
-            group = 0;
-            count = 0;
+            if self.count == 5 {
+                out.extend_from_slice(&self.group.to_be_bytes());
+                self.group = 0;
+                self.count = 0;
+            }
         }
+        Ok(())
     }
 
-    // Handle remaining bytes
-    if count > 0 {
-        // Pad with 'u' characters
-        for _ in count..5 {
-            group = group * 85 + 84;
+    /// Write out a partial last group
+    fn finish(&mut self, out: &mut Vec<u8>) {
+        self.done = true;
+        if self.count > 0 {
+            // Pad with 'u' characters
+            for _ in self.count..5 {
+                self.group = self.group.wrapping_mul(85).wrapping_add(84);
+            }
+            out.extend_from_slice(&self.group.to_be_bytes()[..self.count - 1]);
         }
+    }
+}
 
-        for i in 0..(count - 1) {
-            result.push((group >> (24 - i * 8)) as u8);
-        }
+/// ASCII85 fed to inflate, decoded a chunk at a time
+struct A85Input<'a> {
+    decoder: A85Decoder<'a>,
+    chunk: Vec<u8>,
+}
+
+impl InflateInput for A85Input<'_> {
+    fn size_hint(&self) -> usize {
+        self.decoder.data.len() * 4 / 5
     }
 
-    Ok(result)
+    fn next_piece(&mut self) -> Result<Option<&[u8]>> {
+        if self.decoder.done {
+            return Ok(None);
+        }
+        self.chunk.clear();
+        self.decoder.decode_into(&mut self.chunk, A85_CHUNK)?;
+        Ok(Some(&self.chunk))
+    }
 }
 
 /// Encode data with ASCII85
@@ -138,4 +223,30 @@ mod tests {
         let decoded = decode_ascii85(&encoded).unwrap();
         assert_eq!(decoded, empty);
     }
+
+    #[test]
+    fn test_ascii85_flate_matches_two_steps() {
+        use super::super::flate::{decode_flate, encode_flate};
+
+        // Several chunks' worth of compressed data, wrapped like a PDF
+        let original: Vec<u8> = (0..200_000u32)
+            .flat_map(|i| (i / 5).wrapping_mul(2_654_435_761).to_le_bytes())
+            .collect();
+        let compressed = encode_flate(&original, 6).unwrap();
+        let mut encoded = Vec::new();
+        for line in encode_ascii85(&compressed).unwrap().chunks(64) {
+            encoded.extend_from_slice(line);
+            encoded.push(b'\n');
+        }
+        assert!(compressed.len() > 2 * A85_CHUNK);
+
+        let two_steps = decode_flate(&decode_ascii85(&encoded).unwrap(), None).unwrap();
+        assert_eq!(two_steps, original);
+        assert_eq!(decode_ascii85_flate(&encoded, None).unwrap(), original);
+
+        // Truncated input keeps what inflated; bad digits still fail
+        let partial = decode_ascii85_flate(&encoded[..encoded.len() / 2], None).unwrap();
+        assert!(!partial.is_empty() && original.starts_with(&partial));
+        assert!(decode_ascii85_flate(b"GhQ{ ~>", None).is_err());
+    }
 }
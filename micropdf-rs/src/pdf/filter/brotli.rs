@@ -0,0 +1,180 @@
+//! BrotliDecode Filter Implementation
+//!
+//! Brotli (RFC 7932) streams, optionally compressed against a shared
+//! dictionary: bytes, typically trained on a document corpus, that prime
+//! the compressor's window so even short streams find matches. The
+//! dictionary isn't stored in the file. A stream names it by ID in its
+//! DecodeParms (`/DictID`, 16 hex digits of its SHA-256), and readers
+//! look it up among the dictionaries registered with
+//! [`register_brotli_dictionary`], so one dictionary serves every stream
+//! of every document.
+
+use super::params::BrotliDecodeParams;
+use crate::fitz::error::{Error, Result};
+use sha2::{Digest, Sha256};
+use std::collections::HashMap;
+use std::io::{self, Read, Write};
+use std::sync::{Arc, LazyLock, RwLock};
+
+/// DecodeParms key naming a stream's dictionary
+pub const BROTLI_DICTIONARY_KEY: &str = "DictID";
+
+/// Size of the buffers between the codec and its input and output
+const BUFFER_SIZE: usize = 4096;
+
+/// Window bits; the largest standard window, since dictionary matches
+/// reach back past the start of the data
+const WINDOW_BITS: i32 = 24;
+
+static DICTIONARIES: LazyLock<RwLock<HashMap<u64, Arc<[u8]>>>> =
+    LazyLock::new(|| RwLock::new(HashMap::new()));
+
+/// ID of a dictionary: the first eight bytes of its SHA-256
+pub fn brotli_dictionary_id(dictionary: &[u8]) -> u64 {
+    let digest = Sha256::digest(dictionary);
+    u64::from_be_bytes(digest[..8].try_into().unwrap())
+}
+
+/// Make a dictionary available to every Brotli stream that names it,
+/// returning its ID
+pub fn register_brotli_dictionary(dictionary: &[u8]) -> u64 {
+    let id = brotli_dictionary_id(dictionary);
+    if let Ok(mut dictionaries) = DICTIONARIES.write() {
+        dictionaries.entry(id).or_insert_with(|| dictionary.into());
+    }
+    id
+}
+
+/// A registered dictionary
+pub fn brotli_dictionary(id: u64) -> Option<Arc<[u8]>> {
+    DICTIONARIES.read().ok()?.get(&id).cloned()
+}
+
+/// A dictionary ID as DecodeParms holds it
+pub fn format_brotli_dictionary_id(id: u64) -> String {
+    format!("{id:016x}")
+}
+
+/// Parse a DecodeParms dictionary ID
+pub fn parse_brotli_dictionary_id(text: &[u8]) -> Option<u64> {
+    u64::from_str_radix(std::str::from_utf8(text).ok()?, 16).ok()
+}
+
+/// Decode Brotli compressed data
+pub fn decode_brotli(data: &[u8], params: Option<&BrotliDecodeParams>) -> Result<Vec<u8>> {
+    let mut output = Vec::with_capacity(data.len().saturating_mul(4));
+    let result = match params.and_then(|p| p.dictionary) {
+        Some(id) => {
+            let dictionary = brotli_dictionary(id).ok_or_else(|| {
+                Error::Format(format!(
+                    "BrotliDecode: dictionary {} not registered",
+                    format_brotli_dictionary_id(id)
+                ))
+            })?;
+            let (mut input_buffer, mut output_buffer) = ([0; BUFFER_SIZE], [0; BUFFER_SIZE]);
+            brotli::BrotliDecompressCustomDict(
+                &mut &data[..],
+                &mut output,
+                &mut input_buffer,
+                &mut output_buffer,
+                dictionary.to_vec(),
+            )
+        }
+        None => brotli::Decompressor::new(data, BUFFER_SIZE)
+            .read_to_end(&mut output)
+            .map(drop),
+    };
+    result.map_err(|e| Error::Generic(format!("BrotliDecode failed: {e}")))?;
+    Ok(output)
+}
+
+/// Encode data with Brotli at `quality` (0-11), against `dictionary` if
+/// given; decoding needs the same dictionary registered
+pub fn encode_brotli(data: &[u8], quality: u32, dictionary: Option<&[u8]>) -> Result<Vec<u8>> {
+    let params = brotli::enc::BrotliEncoderParams {
+        quality: quality.min(11) as i32,
+        lgwin: WINDOW_BITS,
+        size_hint: data.len(),
+        ..Default::default()
+    };
+    let mut output = Vec::with_capacity(data.len() / 2);
+    let result = match dictionary {
+        Some(dictionary) => {
+            use brotli::enc::{BrotliCompressCustomIoCustomDict, StandardAlloc};
+            use brotli::{IoReaderWrapper, IoWriterWrapper};
+
+            let (mut input_buffer, mut output_buffer) = ([0; BUFFER_SIZE], [0; BUFFER_SIZE]);
+            BrotliCompressCustomIoCustomDict(
+                &mut IoReaderWrapper(&mut &data[..]),
+                &mut IoWriterWrapper(&mut output),
+                &mut input_buffer,
+                &mut output_buffer,
+                &params,
+                StandardAlloc::default(),
+                &mut |_, _, _, _| (),
+                dictionary,
+                io::Error::from(io::ErrorKind::UnexpectedEof),
+            )
+            .map(drop)
+        }
+        None => {
+            let mut encoder =
+                brotli::CompressorWriter::with_params(&mut output, BUFFER_SIZE, &params);
+            encoder.write_all(data)
+        }
+    };
+    result.map_err(|e| Error::Generic(format!("Brotli compression failed: {e}")))?;
+    Ok(output)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    fn sample(seed: usize) -> Vec<u8> {
+        (0..40)
+            .flat_map(|i| {
+                format!(
+                    "BT /F1 12 Tf {} {} Td (Line {}) Tj ET\n",
+                    i * 3 + seed,
+                    700 - i * 14,
+                    i
+                )
+                .into_bytes()
+            })
+            .collect()
+    }
+
+    #[test]
+    fn test_brotli_round_trip() {
+        let data = sample(0);
+        let encoded = encode_brotli(&data, 9, None).unwrap();
+        assert!(encoded.len() < data.len());
+        assert_eq!(decode_brotli(&encoded, None).unwrap(), data);
+    }
+
+    #[test]
+    fn test_brotli_dictionary() {
+        let dictionary = sample(1);
+        let id = register_brotli_dictionary(&dictionary);
+        assert_eq!(id, brotli_dictionary_id(&dictionary));
+        assert_eq!(
+            parse_brotli_dictionary_id(format_brotli_dictionary_id(id).as_bytes()),
+            Some(id)
+        );
+
+        let data = sample(2);
+        let plain = encode_brotli(&data, 9, None).unwrap();
+        let primed = encode_brotli(&data, 9, Some(&dictionary)).unwrap();
+        assert!(primed.len() < plain.len());
+        let params = BrotliDecodeParams {
+            dictionary: Some(id),
+        };
+        assert_eq!(decode_brotli(&primed, Some(&params)).unwrap(), data);
+
+        let unknown = BrotliDecodeParams {
+            dictionary: Some(id ^ 1),
+        };
+        assert!(decode_brotli(&primed, Some(&unknown)).is_err());
+    }
+}
@@ -1,7 +1,7 @@
 //! Filter Chain Implementation
 
 use super::FilterType;
-use super::params::CCITTFaxDecodeParams;
+use super::params::{BrotliDecodeParams, CCITTFaxDecodeParams};
 use super::*;
 use crate::fitz::error::{Error, Result};
 
@@ -9,28 +9,49 @@ use crate::fitz::error::{Error, Result};
 #[derive(Debug, Clone)]
 pub struct FilterChain {
     filters: Vec<FilterType>,
+    /// DecodeParms of each filter that is a BrotliDecode, by position
+    brotli: Vec<BrotliDecodeParams>,
 }
 
 impl FilterChain {
     pub fn new() -> Self {
         Self {
             filters: Vec::new(),
+            brotli: Vec::new(),
         }
     }
 
     pub fn add(&mut self, filter: FilterType) {
         self.filters.push(filter);
+        self.brotli.push(BrotliDecodeParams::default());
+    }
+
+    /// Add a BrotliDecode filter with its DecodeParms (the /DictID
+    /// shared dictionary)
+    pub fn add_brotli(&mut self, params: BrotliDecodeParams) {
+        self.filters.push(FilterType::BrotliDecode);
+        self.brotli.push(params);
     }
 
     /// Decode data through the filter chain (in order)
     pub fn decode(&self, mut data: Vec<u8>) -> Result<Vec<u8>> {
-        for filter in &self.filters {
+        let mut filters = self.filters.iter().zip(&self.brotli).peekable();
+        while let Some((filter, brotli)) = filters.next() {
             data = match filter {
+                // Decoded straight into the inflater's input
+                FilterType::ASCII85Decode
+                    if filters
+                        .next_if(|(next, _)| **next == FilterType::FlateDecode)
+                        .is_some() =>
+                {
+                    decode_ascii85_flate(&data, None)?
+                }
                 FilterType::FlateDecode => decode_flate(&data, None)?,
                 FilterType::LZWDecode => decode_lzw(&data, None)?,
                 FilterType::ASCII85Decode => decode_ascii85(&data)?,
                 FilterType::ASCIIHexDecode => decode_ascii_hex(&data)?,
                 FilterType::RunLengthDecode => decode_run_length(&data)?,
+                FilterType::BrotliDecode => decode_brotli(&data, Some(brotli))?,
                 FilterType::CCITTFaxDecode => {
                     decode_ccitt_fax(&data, &CCITTFaxDecodeParams::default())?
                 }
@@ -45,13 +66,25 @@ impl FilterChain {
 
     /// Encode data through the filter chain (in reverse order)
     pub fn encode(&self, mut data: Vec<u8>) -> Result<Vec<u8>> {
-        for filter in self.filters.iter().rev() {
+        for (filter, brotli) in self.filters.iter().zip(&self.brotli).rev() {
             data = match filter {
                 FilterType::FlateDecode => encode_flate(&data, 6)?,
                 FilterType::LZWDecode => encode_lzw(&data)?,
                 FilterType::ASCII85Decode => encode_ascii85(&data)?,
                 FilterType::ASCIIHexDecode => encode_ascii_hex(&data)?,
                 FilterType::RunLengthDecode => encode_run_length(&data)?,
+                FilterType::BrotliDecode => {
+                    let dictionary = match brotli.dictionary {
+                        Some(id) => Some(brotli_dictionary(id).ok_or_else(|| {
+                            Error::Format(format!(
+                                "BrotliEncode: dictionary {} not registered",
+                                format_brotli_dictionary_id(id)
+                            ))
+                        })?),
+                        None => None,
+                    };
+                    encode_brotli(&data, 6, dictionary.as_deref())?
+                }
                 FilterType::CCITTFaxDecode => {
                     return Err(Error::Generic("CCITTFaxEncode not supported".into()));
                 }
@@ -177,6 +210,28 @@ mod tests {
         assert_eq!(decoded, original);
     }
 
+    #[test]
+    fn test_filter_chain_brotli_dictionary() {
+        let dictionary = b"shared brotli dictionary for the filter chain test";
+        let params = BrotliDecodeParams {
+            dictionary: Some(register_brotli_dictionary(dictionary)),
+        };
+        let mut chain = FilterChain::new();
+        chain.add(FilterType::ASCIIHexDecode);
+        chain.add_brotli(params);
+
+        let original = b"shared brotli dictionary for the filter chain test, twice";
+        let encoded = chain.encode(original.to_vec()).unwrap();
+        let decoded = chain.decode(encoded.clone()).unwrap();
+        assert_eq!(decoded, original);
+
+        // Without its DecodeParms the stream can't be decoded
+        let mut plain = FilterChain::new();
+        plain.add(FilterType::ASCIIHexDecode);
+        plain.add(FilterType::BrotliDecode);
+        assert_ne!(plain.decode(encoded).ok().as_deref(), Some(&original[..]));
+    }
+
     #[test]
     fn test_filter_chain_crypt() {
         let mut chain = FilterChain::new();
@@ -237,6 +292,7 @@ mod tests {
     fn test_filter_chain_default() {
         let chain = FilterChain::default();
         assert_eq!(chain.filters.len(), 0);
+        assert_eq!(chain.brotli.len(), 0);
     }
 
     #[test]
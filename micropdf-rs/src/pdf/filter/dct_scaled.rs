@@ -0,0 +1,1349 @@
+//! Scaled DCTDecode (JPEG)
+//!
+//! Decodes baseline JPEG straight to 1/2, 1/4 or 1/8 size by running a
+//! reduced inverse DCT over each block's low-frequency coefficients: a
+//! 4x4, 2x2 or 1x1 transform in place of the 8x8 one, as libjpeg's
+//! `scale_denom` does. Only the coefficients the smaller transform reads
+//! are dequantized, and the full-size image is never held, so a 1/8
+//! decode needs 1/64 of the sample memory.
+//!
+//! Progressive files are only decoded at 1/8 size, which needs nothing
+//! but the DC coefficients: the DC scans are read and every AC scan is
+//! stepped over. Progressive files at other sizes, and lossless,
+//! arithmetic-coded and 12-bit files, aren't handled; callers fall back to
+//! a full decode.
+//!
+//! [`decode_dct_scaled_region`] decodes only the MCU rows covering part of
+//! the image: rows below it aren't read at all, whole restart intervals
+//! above it are stepped over without entropy decoding, and blocks outside
+//! it are entropy decoded but never transformed.
+//!
+//! [`decode_dct_coefficients`] stops after entropy decoding and returns the
+//! quantized blocks, for renderers that run dequantization, the inverse
+//! DCT and colour conversion on a GPU. [`JpegCoefficients::reconstruct`]
+//! is the same transform on the CPU, and gives the bytes
+//! [`decode_dct_scaled`] does.
+
+use crate::fitz::error::{Error, Result};
+use std::f32::consts::PI;
+use std::ops::Range;
+
+/// Natural (row-major) index of each zigzag position
+const ZIGZAG: [usize; 64] = [
+    0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5, 12, 19, 26, 33, 40, 48, 41, 34, 27, 20,
+    13, 6, 7, 14, 21, 28, 35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51, 58, 59,
+    52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63,
+];
+
+/// Bits the Huffman lookup table resolves in one step
+const LOOKUP_BITS: u32 = 9;
+
+/// A decoded, possibly reduced, JPEG
+#[derive(Debug)]
+pub struct ScaledJpeg {
+    pub width: u32,
+    pub height: u32,
+    /// Components per pixel: gray, RGB (converted from YCbCr) or CMYK
+    pub components: u8,
+    /// Interleaved 8-bit samples
+    pub samples: Vec<u8>,
+}
+
+/// Quantized DCT blocks of one JPEG component
+#[derive(Debug, Clone)]
+pub struct CoefficientPlane {
+    /// Horizontal and vertical sampling factors
+    pub h: usize,
+    pub v: usize,
+    /// Blocks across and down, padded out to whole MCUs
+    pub blocks_w: usize,
+    pub blocks_h: usize,
+    /// Quantization table, natural order
+    pub quant: [u16; 64],
+    /// 64 quantized coefficients per block, natural order, blocks row by row
+    pub blocks: Vec<i16>,
+}
+
+/// An entropy-decoded JPEG
+#[derive(Debug, Clone)]
+pub struct JpegCoefficients {
+    pub width: u32,
+    pub height: u32,
+    /// Largest sampling factors over the components
+    pub max_h: usize,
+    pub max_v: usize,
+    /// Gray, three-component or four-component
+    pub components: Vec<CoefficientPlane>,
+    adobe_transform: Option<u8>,
+}
+
+impl JpegCoefficients {
+    /// Whether the reconstructed components are YCbCr (or YCCK, for four)
+    /// and need converting to RGB (or CMYK)
+    pub fn is_ycc(&self) -> bool {
+        is_ycc(self.components.len(), self.adobe_transform)
+    }
+
+    /// Dequantize and inverse transform at 1/2^`l2factor` size (0-3)
+    pub fn reconstruct(&self, l2factor: u32) -> Result<ScaledJpeg> {
+        if l2factor > 3 {
+            return Err(Error::Argument("JPEG scale must be 1/1 to 1/8".into()));
+        }
+        let size = 8 >> l2factor;
+        let table = idct_table(size);
+        let planes: Vec<Vec<u8>> = self
+            .components
+            .iter()
+            .map(|c| {
+                let stride = c.blocks_w * size;
+                let mut plane = vec![0u8; stride * c.blocks_h * size];
+                let mut coef = [0i32; 64];
+                for (b, block) in c.blocks.chunks_exact(64).enumerate() {
+                    for (i, (&value, &q)) in block.iter().zip(&c.quant).enumerate() {
+                        coef[i] = i32::from(value) * i32::from(q);
+                    }
+                    let (bx, by) = (b % c.blocks_w, b / c.blocks_w);
+                    let at = by * size * stride + bx * size;
+                    reduced_idct(&coef, size, &table, &mut plane[at..], stride);
+                }
+                plane
+            })
+            .collect();
+        let views: Vec<_> = self
+            .components
+            .iter()
+            .zip(&planes)
+            .map(|(c, plane)| Plane {
+                h: c.h,
+                v: c.v,
+                stride: c.blocks_w * size,
+                first_row: 0,
+                samples: plane,
+            })
+            .collect();
+        let window = [
+            0,
+            0,
+            (self.width as usize).div_ceil(1 << l2factor),
+            (self.height as usize).div_ceil(1 << l2factor),
+        ];
+        Ok(assemble(
+            (self.max_h, self.max_v),
+            self.is_ycc(),
+            &views,
+            window,
+        ))
+    }
+}
+
+/// Whether `n` components with the Adobe `transform` flag are YCbCr/YCCK
+fn is_ycc(n: usize, transform: Option<u8>) -> bool {
+    // JFIF three-component files are YCbCr unless Adobe says otherwise;
+    // four-component ones only when Adobe says YCCK
+    match n {
+        3 => transform != Some(0),
+        4 => transform == Some(2),
+        _ => false,
+    }
+}
+
+fn corrupt(what: &str) -> Error {
+    Error::Generic(format!("DCTDecode failed: {what}"))
+}
+
+struct Huffman {
+    /// `(length << 8) | symbol` for codes up to `LOOKUP_BITS` long, by
+    /// their bits padded on the right; 0 for longer codes
+    lookup: Vec<u16>,
+    /// Largest code of each length (index = length), -1 if none
+    max_code: [i32; 18],
+    /// Index into `values` minus the first code of each length
+    offset: [i32; 17],
+    values: Vec<u8>,
+}
+
+impl Huffman {
+    fn new(counts: &[u8; 16], values: Vec<u8>) -> Result<Self> {
+        if counts.iter().map(|&c| c as usize).sum::<usize>() != values.len() {
+            return Err(corrupt("bad Huffman table"));
+        }
+        let mut lookup = vec![0u16; 1 << LOOKUP_BITS];
+        let mut max_code = [-1i32; 18];
+        let mut offset = [0i32; 17];
+        let (mut code, mut k) = (0i32, 0usize);
+        for len in 1..=16 {
+            let count = counts[len - 1] as usize;
+            offset[len] = k as i32 - code;
+            for &symbol in &values[k..k + count] {
+                if len as u32 <= LOOKUP_BITS {
+                    let shift = LOOKUP_BITS - len as u32;
+                    let first = (code as usize) << shift;
+                    for entry in &mut lookup[first..first + (1 << shift)] {
+                        *entry = ((len as u16) << 8) | u16::from(symbol);
+                    }
+                }
+                code += 1;
+            }
+            k += count;
+            max_code[len] = if count > 0 { code - 1 } else { -1 };
+            if code > 1 << len {
+                return Err(corrupt("bad Huffman table"));
+            }
+            code <<= 1;
+        }
+        max_code[17] = i32::MAX;
+        Ok(Self {
+            lookup,
+            max_code,
+            offset,
+            values,
+        })
+    }
+}
+
+/// Entropy-coded data, with byte stuffing removed and markers stopping
+/// the bits
+struct BitReader<'a> {
+    data: &'a [u8],
+    pos: usize,
+    bits: u32,
+    count: u32,
+}
+
+impl<'a> BitReader<'a> {
+    fn new(data: &'a [u8], pos: usize) -> Self {
+        Self {
+            data,
+            pos,
+            bits: 0,
+            count: 0,
+        }
+    }
+
+    /// Top up to at least 25 bits, zeros once a marker is reached
+    fn fill(&mut self) {
+        while self.count <= 24 {
+            let mut byte = 0;
+            if self.pos < self.data.len() {
+                byte = self.data[self.pos];
+                if byte == 0xFF {
+                    match self.data.get(self.pos + 1) {
+                        Some(0) => self.pos += 2,
+                        // A marker: leave it for the caller
+                        _ => byte = 0,
+                    }
+                } else {
+                    self.pos += 1;
+                }
+            }
+            self.bits |= u32::from(byte) << (24 - self.count);
+            self.count += 8;
+        }
+    }
+
+    fn peek(&mut self, n: u32) -> u32 {
+        self.fill();
+        self.bits >> (32 - n)
+    }
+
+    fn consume(&mut self, n: u32) {
+        self.bits <<= n;
+        self.count -= n;
+    }
+
+    fn bits(&mut self, n: u32) -> i32 {
+        if n == 0 {
+            return 0;
+        }
+        let value = self.peek(n);
+        self.consume(n);
+        value as i32
+    }
+
+    /// `n` bits as a signed coefficient (F.2.2.1 EXTEND)
+    fn receive_extend(&mut self, n: u32) -> i32 {
+        let value = self.bits(n);
+        if n > 0 && value < 1 << (n - 1) {
+            value - (1 << n) + 1
+        } else {
+            value
+        }
+    }
+
+    fn decode(&mut self, table: &Huffman) -> Result<u8> {
+        let entry = table.lookup[self.peek(LOOKUP_BITS) as usize];
+        if entry != 0 {
+            self.consume(u32::from(entry >> 8));
+            return Ok(entry as u8);
+        }
+        let code = self.peek(16) as i32;
+        for len in LOOKUP_BITS as usize + 1..=16 {
+            let prefix = code >> (16 - len);
+            if prefix <= table.max_code[len] {
+                self.consume(len as u32);
+                let index = (prefix + table.offset[len]) as usize;
+                return table
+                    .values
+                    .get(index)
+                    .copied()
+                    .ok_or_else(|| corrupt("bad Huffman code"));
+            }
+        }
+        Err(corrupt("bad Huffman code"))
+    }
+
+    /// Drop buffered bits and step over the RSTn marker at the read point
+    fn restart(&mut self) -> Result<()> {
+        self.bits = 0;
+        self.count = 0;
+        while self.pos + 1 < self.data.len() {
+            if self.data[self.pos] == 0xFF && (0xD0..=0xD7).contains(&self.data[self.pos + 1]) {
+                self.pos += 2;
+                return Ok(());
+            }
+            self.pos += 1;
+        }
+        Err(corrupt("missing restart marker"))
+    }
+}
+
+struct Component {
+    id: u8,
+    h: usize,
+    v: usize,
+    quant: usize,
+    /// Blocks across and down, padded out to whole MCUs
+    blocks_w: usize,
+    blocks_h: usize,
+    /// Reduced samples, `blocks_w * size` wide, from block row `row0`
+    plane: Vec<u8>,
+    row0: usize,
+    /// Quantized blocks, when keeping coefficients
+    coefficients: Vec<i16>,
+    /// Quantized DC coefficient of each block, for progressive files
+    dc_values: Vec<i32>,
+    pred: i32,
+    dc: usize,
+    ac: usize,
+}
+
+/// `cos` terms of an `size`-point inverse DCT, `[x][u]`, with the
+/// `C(u) / 2` factor folded in
+fn idct_table(size: usize) -> Vec<f32> {
+    let mut table = vec![0.0; size * size];
+    for x in 0..size {
+        for u in 0..size {
+            let c = if u == 0 {
+                std::f32::consts::FRAC_1_SQRT_2
+            } else {
+                1.0
+            };
+            table[x * size + u] =
+                0.5 * c * ((2 * x + 1) as f32 * u as f32 * PI / (2 * size) as f32).cos();
+        }
+    }
+    table
+}
+
+/// Inverse DCT of the top-left `size` x `size` coefficients of `coef`
+/// (natural order, dequantized) into `out` at `stride`
+fn reduced_idct(coef: &[i32; 64], size: usize, table: &[f32], out: &mut [u8], stride: usize) {
+    if size == 1 {
+        out[0] = (coef[0] as f32 / 8.0 + 128.0).round().clamp(0.0, 255.0) as u8;
+        return;
+    }
+    let mut rows = [0f32; 64];
+    for v in 0..size {
+        for x in 0..size {
+            let t = &table[x * size..(x + 1) * size];
+            rows[v * size + x] = (0..size).map(|u| coef[v * 8 + u] as f32 * t[u]).sum();
+        }
+    }
+    for y in 0..size {
+        let t = &table[y * size..(y + 1) * size];
+        for x in 0..size {
+            let value: f32 = (0..size).map(|v| t[v] * rows[v * size + x]).sum();
+            out[y * stride + x] = (value + 128.0).round().clamp(0.0, 255.0) as u8;
+        }
+    }
+}
+
+fn be16(data: &[u8], at: usize) -> Result<usize> {
+    match data.get(at..at + 2) {
+        Some(b) => Ok(usize::from(b[0]) << 8 | usize::from(b[1])),
+        None => Err(corrupt("truncated")),
+    }
+}
+
+struct Decoder {
+    size: usize,
+    table: Vec<f32>,
+    width: usize,
+    height: usize,
+    max_h: usize,
+    max_v: usize,
+    components: Vec<Component>,
+    quant: [[i32; 64]; 4],
+    dc: [Option<Huffman>; 4],
+    ac: [Option<Huffman>; 4],
+    restart_interval: usize,
+    adobe_transform: Option<u8>,
+    /// Keep quantized blocks instead of transforming them
+    keep_coefficients: bool,
+    /// Part of the image to decode, in full-size pixels
+    region: Option<[usize; 4]>,
+    /// Output pixels `[x0, y0, x1, y1]`, and the MCU rows and columns
+    /// covering them
+    window: [usize; 4],
+    mcu_rows: Range<usize>,
+    mcu_cols: Range<usize>,
+    /// Progressive file, decoded from its DC scans alone
+    progressive: bool,
+    /// Successive approximation bit positions `(Ah, Al)` of the scan
+    approximation: (u32, u32),
+}
+
+impl Decoder {
+    fn frame(&mut self, seg: &[u8]) -> Result<()> {
+        if seg.len() < 6 || seg[0] != 8 {
+            return Err(corrupt("only 8-bit samples are supported"));
+        }
+        self.height = be16(seg, 1)?;
+        self.width = be16(seg, 3)?;
+        let count = usize::from(seg[5]);
+        if self.width == 0 || self.height == 0 || !matches!(count, 1 | 3 | 4) {
+            return Err(corrupt("unsupported frame"));
+        }
+        for i in 0..count {
+            let c = seg
+                .get(6 + i * 3..9 + i * 3)
+                .ok_or_else(|| corrupt("truncated"))?;
+            let (h, v) = (usize::from(c[1] >> 4), usize::from(c[1] & 15));
+            if !(1..=4).contains(&h) || !(1..=4).contains(&v) || c[2] > 3 {
+                return Err(corrupt("bad component"));
+            }
+            self.components.push(Component {
+                id: c[0],
+                h,
+                v,
+                quant: usize::from(c[2]),
+                blocks_w: 0,
+                blocks_h: 0,
+                plane: Vec::new(),
+                row0: 0,
+                coefficients: Vec::new(),
+                dc_values: Vec::new(),
+                pred: 0,
+                dc: 0,
+                ac: 0,
+            });
+        }
+        self.max_h = self.components.iter().map(|c| c.h).max().unwrap_or(1);
+        self.max_v = self.components.iter().map(|c| c.v).max().unwrap_or(1);
+        let mcus_w = self.width.div_ceil(8 * self.max_h);
+        let mcus_h = self.height.div_ceil(8 * self.max_v);
+
+        let scale = 8 / self.size;
+        let (out_w, out_h) = (self.width.div_ceil(scale), self.height.div_ceil(scale));
+        self.window = match self.region {
+            Some([x0, y0, x1, y1]) => [
+                (x0 / scale).min(out_w),
+                (y0 / scale).min(out_h),
+                x1.div_ceil(scale).min(out_w),
+                y1.div_ceil(scale).min(out_h),
+            ],
+            None => [0, 0, out_w, out_h],
+        };
+        let [x0, y0, x1, y1] = self.window;
+        if x0 >= x1 || y0 >= y1 {
+            return Err(Error::Argument("JPEG region is empty".into()));
+        }
+        let (mcu_w, mcu_h) = (self.max_h * self.size, self.max_v * self.size);
+        self.mcu_rows = y0 / mcu_h..y1.div_ceil(mcu_h);
+        self.mcu_cols = x0 / mcu_w..x1.div_ceil(mcu_w);
+
+        for c in &mut self.components {
+            c.blocks_w = mcus_w * c.h;
+            c.blocks_h = mcus_h * c.v;
+            if self.keep_coefficients {
+                c.coefficients = vec![0; c.blocks_w * c.blocks_h * 64];
+            } else if self.progressive {
+                c.dc_values = vec![0; c.blocks_w * c.blocks_h];
+            }
+            if !self.keep_coefficients {
+                // Only the band of block rows under the window
+                c.row0 = self.mcu_rows.start * c.v;
+                let rows = self.mcu_rows.len() * c.v;
+                c.plane = vec![0; c.blocks_w * rows * self.size * self.size];
+            }
+        }
+        Ok(())
+    }
+
+    fn huffman_tables(&mut self, mut seg: &[u8]) -> Result<()> {
+        while !seg.is_empty() {
+            let (class, id) = (seg[0] >> 4, usize::from(seg[0] & 15));
+            let counts: [u8; 16] = seg
+                .get(1..17)
+                .and_then(|c| c.try_into().ok())
+                .ok_or_else(|| corrupt("truncated"))?;
+            let total: usize = counts.iter().map(|&c| usize::from(c)).sum();
+            let values = seg
+                .get(17..17 + total)
+                .ok_or_else(|| corrupt("truncated"))?;
+            if id > 3 || class > 1 {
+                return Err(corrupt("bad Huffman table"));
+            }
+            let table = Some(Huffman::new(&counts, values.to_vec())?);
+            match class {
+                0 => self.dc[id] = table,
+                _ => self.ac[id] = table,
+            }
+            seg = &seg[17 + total..];
+        }
+        Ok(())
+    }
+
+    fn quant_tables(&mut self, mut seg: &[u8]) -> Result<()> {
+        while !seg.is_empty() {
+            let (precision, id) = (seg[0] >> 4, usize::from(seg[0] & 15));
+            let len = if precision == 0 { 64 } else { 128 };
+            let values = seg.get(1..1 + len).ok_or_else(|| corrupt("truncated"))?;
+            if id > 3 {
+                return Err(corrupt("bad quantization table"));
+            }
+            for k in 0..64 {
+                self.quant[id][k] = match precision {
+                    0 => i32::from(values[k]),
+                    _ => i32::from(values[2 * k]) << 8 | i32::from(values[2 * k + 1]),
+                };
+            }
+            seg = &seg[1 + len..];
+        }
+        Ok(())
+    }
+
+    /// Decode one block into component `ci`'s plane at block `(bx, by)`,
+    /// or only step over its bits if `transform` is false
+    fn block(
+        &mut self,
+        reader: &mut BitReader,
+        ci: usize,
+        (bx, by): (usize, usize),
+        transform: bool,
+    ) -> Result<()> {
+        if self.progressive {
+            return self.dc_block(reader, ci, (bx, by));
+        }
+        let size = self.size;
+        let c = &self.components[ci];
+        let (dc, ac) = match (&self.dc[c.dc], &self.ac[c.ac]) {
+            (Some(dc), Some(ac)) => (dc, ac),
+            _ => return Err(corrupt("missing Huffman table")),
+        };
+        let quant = &self.quant[c.quant];
+        let keep = self.keep_coefficients;
+        let mut coef = [0i32; 64];
+
+        let t = u32::from(reader.decode(dc)?);
+        let pred = c.pred + reader.receive_extend(t);
+        coef[0] = if keep { pred } else { pred * quant[0] };
+        let mut k = 1;
+        while k < 64 {
+            let rs = reader.decode(ac)?;
+            let (run, bits) = (usize::from(rs >> 4), u32::from(rs & 15));
+            if bits == 0 {
+                if run != 15 {
+                    break;
+                }
+                k += 16;
+                continue;
+            }
+            k += run;
+            if k > 63 {
+                return Err(corrupt("coefficient out of range"));
+            }
+            let value = reader.receive_extend(bits);
+            // Only the coefficients the reduced transform reads
+            let natural = ZIGZAG[k];
+            if keep {
+                coef[natural] = value;
+            } else if transform && natural / 8 < size && natural % 8 < size {
+                coef[natural] = value * quant[k];
+            }
+            k += 1;
+        }
+
+        let c = &mut self.components[ci];
+        c.pred = pred;
+        if keep {
+            let at = (by * c.blocks_w + bx) * 64;
+            for (out, &value) in c.coefficients[at..at + 64].iter_mut().zip(&coef) {
+                *out = value.clamp(i16::MIN.into(), i16::MAX.into()) as i16;
+            }
+            return Ok(());
+        }
+        if !transform {
+            return Ok(());
+        }
+        let stride = c.blocks_w * size;
+        let at = (by - c.row0) * size * stride + bx * size;
+        reduced_idct(&coef, size, &self.table, &mut c.plane[at..], stride);
+        Ok(())
+    }
+
+    /// Decode one block's DC coefficient in a progressive DC scan: its top
+    /// bits in the first scan, one more bit in each refinement (G.1.2.1)
+    fn dc_block(
+        &mut self,
+        reader: &mut BitReader,
+        ci: usize,
+        (bx, by): (usize, usize),
+    ) -> Result<()> {
+        let (ah, al) = self.approximation;
+        let c = &mut self.components[ci];
+        let at = by * c.blocks_w + bx;
+        if ah == 0 {
+            let table = self.dc[c.dc]
+                .as_ref()
+                .ok_or_else(|| corrupt("missing Huffman table"))?;
+            let t = u32::from(reader.decode(table)?);
+            c.pred += reader.receive_extend(t);
+            c.dc_values[at] = c.pred << al;
+        } else if reader.bits(1) != 0 {
+            c.dc_values[at] |= 1 << al;
+        }
+        Ok(())
+    }
+
+    /// Decode the scan whose header is `seg`, its entropy-coded data
+    /// starting at `data[start]`; returns where the data ends
+    fn scan(&mut self, seg: &[u8], data: &[u8], start: usize) -> Result<usize> {
+        let count = usize::from(*seg.first().ok_or_else(|| corrupt("truncated"))?);
+        let mut members = Vec::with_capacity(count);
+        for i in 0..count {
+            let s = seg
+                .get(1 + i * 2..3 + i * 2)
+                .ok_or_else(|| corrupt("truncated"))?;
+            let ci = self
+                .components
+                .iter()
+                .position(|c| c.id == s[0])
+                .ok_or_else(|| corrupt("scan names an unknown component"))?;
+            let c = &mut self.components[ci];
+            (c.dc, c.ac) = (usize::from(s[1] >> 4) & 3, usize::from(s[1] & 15) & 3);
+            c.pred = 0;
+            members.push(ci);
+        }
+        let tail = seg
+            .get(1 + count * 2..4 + count * 2)
+            .ok_or_else(|| corrupt("truncated"))?;
+        let (spectral_start, approximation) = (tail[0], tail[2]);
+        self.approximation = (u32::from(approximation >> 4), u32::from(approximation & 15));
+
+        let mut reader = BitReader::new(data, start);
+        // AC scans of a progressive file add nothing at 1/8 size
+        let skip = self.progressive && spectral_start > 0;
+        if skip {
+            reader.pos = data.len();
+        }
+        let (units_w, units_h) = match members.as_slice() {
+            // A lone component's blocks, not padded to whole MCUs
+            &[ci] => {
+                let c = &self.components[ci];
+                (
+                    (self.width * c.h).div_ceil(self.max_h).div_ceil(8),
+                    (self.height * c.v).div_ceil(self.max_v).div_ceil(8),
+                )
+            }
+            _ => (
+                self.width.div_ceil(8 * self.max_h),
+                self.height.div_ceil(8 * self.max_v),
+            ),
+        };
+        // MCU row and column of a unit: a lone component's units are its
+        // blocks
+        let (unit_h, unit_v) = match members.as_slice() {
+            &[ci] => (self.components[ci].h, self.components[ci].v),
+            _ => (1, 1),
+        };
+        let mcu_row = |unit: usize| unit / units_w / unit_v;
+        let (rows, cols) = (self.mcu_rows.clone(), self.mcu_cols.clone());
+        let total = if skip { 0 } else { units_w * units_h };
+        let mut unit = 0;
+        while unit < total && mcu_row(unit) < rows.end {
+            if self.restart_interval > 0 && unit % self.restart_interval == 0 {
+                if unit > 0 {
+                    reader.restart()?;
+                    for &ci in &members {
+                        self.components[ci].pred = 0;
+                    }
+                }
+                // An interval wholly above the band is never decoded; the
+                // next restart finds the marker ending it
+                let end = (unit + self.restart_interval).min(total);
+                if end < total && mcu_row(end - 1) < rows.start {
+                    unit = end;
+                    continue;
+                }
+            }
+            let (ux, uy) = (unit % units_w, unit / units_w);
+            let wanted = rows.contains(&(uy / unit_v)) && cols.contains(&(ux / unit_h));
+            unit += 1;
+            if let &[ci] = members.as_slice() {
+                self.block(&mut reader, ci, (ux, uy), wanted)?;
+                continue;
+            }
+            for &ci in &members {
+                let (h, v) = (self.components[ci].h, self.components[ci].v);
+                for by in 0..v {
+                    for bx in 0..h {
+                        self.block(&mut reader, ci, (ux * h + bx, uy * v + by), wanted)?;
+                    }
+                }
+            }
+        }
+
+        // Skip to the next marker that isn't a restart
+        let mut pos = if skip { start } else { reader.pos };
+        while pos + 1 < data.len() {
+            if data[pos] == 0xFF && !matches!(data[pos + 1], 0 | 0xD0..=0xD7) {
+                break;
+            }
+            pos += 1;
+        }
+        Ok(pos)
+    }
+
+    fn finish(mut self) -> ScaledJpeg {
+        if self.progressive {
+            self.transform_dc();
+        }
+        let ycc = is_ycc(self.components.len(), self.adobe_transform);
+        let views: Vec<_> = self
+            .components
+            .iter()
+            .map(|c| Plane {
+                h: c.h,
+                v: c.v,
+                stride: c.blocks_w * self.size,
+                first_row: c.row0 * self.size,
+                samples: &c.plane,
+            })
+            .collect();
+        assemble((self.max_h, self.max_v), ycc, &views, self.window)
+    }
+
+    /// Fill the planes of a progressive file from its DC coefficients
+    fn transform_dc(&mut self) {
+        let mut coef = [0i32; 64];
+        for c in &mut self.components {
+            let q = self.quant[c.quant][0];
+            let rows = c.plane.len() / c.blocks_w.max(1);
+            for by in 0..rows {
+                for bx in 0..c.blocks_w {
+                    coef[0] = c.dc_values[(c.row0 + by) * c.blocks_w + bx] * q;
+                    let at = by * c.blocks_w + bx;
+                    reduced_idct(&coef, 1, &self.table, &mut c.plane[at..], c.blocks_w);
+                }
+            }
+        }
+    }
+
+    /// The entropy-decoded blocks, when keeping coefficients
+    fn into_coefficients(self) -> JpegCoefficients {
+        let quant = self.quant;
+        JpegCoefficients {
+            width: self.width as u32,
+            height: self.height as u32,
+            max_h: self.max_h,
+            max_v: self.max_v,
+            components: self
+                .components
+                .into_iter()
+                .map(|c| {
+                    let mut natural = [0u16; 64];
+                    for (k, &z) in ZIGZAG.iter().enumerate() {
+                        natural[z] = quant[c.quant][k].clamp(0, i32::from(u16::MAX)) as u16;
+                    }
+                    CoefficientPlane {
+                        h: c.h,
+                        v: c.v,
+                        blocks_w: c.blocks_w,
+                        blocks_h: c.blocks_h,
+                        quant: natural,
+                        blocks: c.coefficients,
+                    }
+                })
+                .collect(),
+            adobe_transform: self.adobe_transform,
+        }
+    }
+}
+
+/// Reduced samples of one component
+struct Plane<'a> {
+    /// Sampling factors
+    h: usize,
+    v: usize,
+    stride: usize,
+    /// Component row `samples` starts at
+    first_row: usize,
+    samples: &'a [u8],
+}
+
+/// Interleave the output pixels `[x0, y0, x1, y1]` of reduced component
+/// planes, upsampling subsampled components and converting YCbCr/YCCK
+fn assemble(
+    (max_h, max_v): (usize, usize),
+    ycc: bool,
+    planes: &[Plane],
+    [x0, y0, x1, y1]: [usize; 4],
+) -> ScaledJpeg {
+    let (width, height) = (x1 - x0, y1 - y0);
+    let n = planes.len();
+    let mut samples = vec![0u8; width * height * n];
+    for (ci, plane) in planes.iter().enumerate() {
+        for y in 0..height {
+            let row = (y0 + y) * plane.v / max_v - plane.first_row;
+            let row = &plane.samples[row * plane.stride..];
+            for x in 0..width {
+                samples[(y * width + x) * n + ci] = row[(x0 + x) * plane.h / max_h];
+            }
+        }
+    }
+
+    if ycc {
+        for px in samples.chunks_exact_mut(n) {
+            let (y, cb, cr) = (
+                f32::from(px[0]),
+                f32::from(px[1]) - 128.0,
+                f32::from(px[2]) - 128.0,
+            );
+            let rgb = [
+                y + 1.402 * cr,
+                y - 0.344_136 * cb - 0.714_136 * cr,
+                y + 1.772 * cb,
+            ];
+            for (out, value) in px.iter_mut().zip(rgb) {
+                let value = value.round().clamp(0.0, 255.0) as u8;
+                // YCCK carries inverted CMY
+                *out = if n == 4 { 255 - value } else { value };
+            }
+        }
+    }
+    ScaledJpeg {
+        width: width as u32,
+        height: height as u32,
+        components: n as u8,
+        samples,
+    }
+}
+
+/// Decode baseline JPEG `data` at 1/2^`l2factor` size (`l2factor` 0-3)
+pub fn decode_dct_scaled(data: &[u8], l2factor: u32) -> Result<ScaledJpeg> {
+    if l2factor > 3 {
+        return Err(Error::Argument("JPEG scale must be 1/1 to 1/8".into()));
+    }
+    Ok(parse(data, 8 >> l2factor, false, None)?.finish())
+}
+
+/// Decode the part `[x0, y0, x1, y1]` (in full-size pixels) of baseline
+/// JPEG `data` at 1/2^`l2factor` size
+///
+/// The result holds output pixels `x0 >> l2factor` up to `x1` divided by
+/// 2^`l2factor` rounded up, clipped to the image, and likewise down.
+pub fn decode_dct_scaled_region(
+    data: &[u8],
+    l2factor: u32,
+    region: [u32; 4],
+) -> Result<ScaledJpeg> {
+    if l2factor > 3 {
+        return Err(Error::Argument("JPEG scale must be 1/1 to 1/8".into()));
+    }
+    let region = region.map(|v| v as usize);
+    Ok(parse(data, 8 >> l2factor, false, Some(region))?.finish())
+}
+
+/// Entropy-decode baseline JPEG `data`, leaving its blocks quantized
+pub fn decode_dct_coefficients(data: &[u8]) -> Result<JpegCoefficients> {
+    Ok(parse(data, 8, true, None)?.into_coefficients())
+}
+
+/// Run `data`'s markers and scans through a decoder
+fn parse(
+    data: &[u8],
+    size: usize,
+    keep_coefficients: bool,
+    region: Option<[usize; 4]>,
+) -> Result<Decoder> {
+    if !data.starts_with(&[0xFF, 0xD8]) {
+        return Err(corrupt("not a JPEG"));
+    }
+    let mut decoder = Decoder {
+        size,
+        table: idct_table(size),
+        width: 0,
+        height: 0,
+        max_h: 1,
+        max_v: 1,
+        components: Vec::new(),
+        quant: [[1; 64]; 4],
+        dc: [None, None, None, None],
+        ac: [None, None, None, None],
+        restart_interval: 0,
+        adobe_transform: None,
+        keep_coefficients,
+        region,
+        window: [0; 4],
+        mcu_rows: 0..0,
+        mcu_cols: 0..0,
+        progressive: false,
+        approximation: (0, 0),
+    };
+
+    let mut pos = 2;
+    let mut scanned = false;
+    loop {
+        while data.get(pos) == Some(&0xFF) && data.get(pos + 1) == Some(&0xFF) {
+            pos += 1;
+        }
+        let (Some(0xFF), Some(&marker)) = (data.get(pos), data.get(pos + 1)) else {
+            break;
+        };
+        pos += 2;
+        if marker == 0xD9 {
+            break;
+        }
+        if matches!(marker, 0x01 | 0xD0..=0xD8) {
+            continue;
+        }
+        let len = be16(data, pos)?;
+        let seg = data
+            .get(pos + 2..pos + len)
+            .filter(|_| len >= 2)
+            .ok_or_else(|| corrupt("truncated"))?;
+        pos += len;
+        match marker {
+            0xC0 | 0xC1 => decoder.frame(seg)?,
+            0xC2 if size == 1 && !keep_coefficients => {
+                decoder.progressive = true;
+                decoder.frame(seg)?;
+            }
+            0xC2..=0xCF if !matches!(marker, 0xC4 | 0xC8 | 0xCC) => {
+                return Err(corrupt("only baseline Huffman JPEG is supported"));
+            }
+            0xC4 => decoder.huffman_tables(seg)?,
+            0xDB => decoder.quant_tables(seg)?,
+            0xDD => decoder.restart_interval = be16(seg, 0)?,
+            0xEE if seg.starts_with(b"Adobe") => decoder.adobe_transform = seg.get(11).copied(),
+            0xDA => {
+                if decoder.components.is_empty() {
+                    return Err(corrupt("scan before frame"));
+                }
+                pos = decoder.scan(seg, data, pos)?;
+                scanned = true;
+            }
+            _ => {}
+        }
+    }
+    if !scanned {
+        return Err(corrupt("no image data"));
+    }
+    Ok(decoder)
+}
+
+#[cfg(test)]
+pub(crate) mod tests {
+    use super::*;
+
+    /// Writes baseline JPEG from given coefficients, with every DC symbol
+    /// 4 bits and every AC symbol 8 bits long
+    pub(crate) struct TestJpeg {
+        out: Vec<u8>,
+        acc: u32,
+        nbits: u32,
+    }
+
+    const DC_SYMBOLS: usize = 12;
+    const AC_SYMBOLS: [u8; 162] = {
+        let mut symbols = [0u8; 162];
+        symbols[0] = 0x00;
+        symbols[1] = 0xF0;
+        let mut i = 2;
+        let mut run = 0;
+        while run < 16 {
+            let mut size = 1;
+            while size <= 10 {
+                symbols[i] = (run << 4) | size;
+                i += 1;
+                size += 1;
+            }
+            run += 1;
+        }
+        symbols
+    };
+
+    impl TestJpeg {
+        fn put(&mut self, value: u32, n: u32) {
+            for i in (0..n).rev() {
+                self.acc = self.acc << 1 | (value >> i) & 1;
+                self.nbits += 1;
+                if self.nbits == 8 {
+                    self.out.push(self.acc as u8);
+                    if self.acc == 0xFF {
+                        self.out.push(0);
+                    }
+                    (self.acc, self.nbits) = (0, 0);
+                }
+            }
+        }
+
+        fn coefficient(&mut self, value: i32) -> (u32, u32) {
+            let size = 32 - value.unsigned_abs().leading_zeros();
+            let bits = (if value < 0 { value - 1 } else { value }) as u32 & ((1 << size) - 1);
+            (size, bits)
+        }
+
+        fn segment(&mut self, marker: u8, body: &[u8]) {
+            self.out.extend_from_slice(&[0xFF, marker]);
+            self.out
+                .extend_from_slice(&((body.len() + 2) as u16).to_be_bytes());
+            self.out.extend_from_slice(body);
+        }
+
+        /// Quantization (all 1), frame and Huffman table segments
+        fn header(&mut self, sof: u8, width: u16, height: u16, sampling: &[(u8, u8)]) {
+            let jpeg = self;
+            let mut dqt = vec![0u8];
+            dqt.extend_from_slice(&[1; 64]);
+            jpeg.segment(0xDB, &dqt);
+            let mut sof_body = vec![8];
+            sof_body.extend_from_slice(&height.to_be_bytes());
+            sof_body.extend_from_slice(&width.to_be_bytes());
+            sof_body.push(sampling.len() as u8);
+            for (i, &(h, v)) in sampling.iter().enumerate() {
+                sof_body.extend_from_slice(&[i as u8 + 1, h << 4 | v, 0]);
+            }
+            jpeg.segment(sof, &sof_body);
+            let mut dht = vec![0x00];
+            dht.extend_from_slice(&[
+                0,
+                0,
+                0,
+                DC_SYMBOLS as u8,
+                0,
+                0,
+                0,
+                0,
+                0,
+                0,
+                0,
+                0,
+                0,
+                0,
+                0,
+                0,
+            ]);
+            dht.extend(0..DC_SYMBOLS as u8);
+            dht.push(0x10);
+            dht.extend_from_slice(&[0, 0, 0, 0, 0, 0, 0, 162, 0, 0, 0, 0, 0, 0, 0, 0]);
+            dht.extend_from_slice(&AC_SYMBOLS);
+            jpeg.segment(0xC4, &dht);
+        }
+
+        /// A file of `width` x `height` with components sampled `(h, v)`,
+        /// all quantized by 1; `block(component, bx, by)` gives each
+        /// block's coefficients in natural order
+        pub(crate) fn encode(
+            width: u16,
+            height: u16,
+            sampling: &[(u8, u8)],
+            restart: u16,
+            block: impl Fn(usize, usize, usize) -> [i32; 64],
+        ) -> Vec<u8> {
+            let mut jpeg = TestJpeg {
+                out: vec![0xFF, 0xD8],
+                acc: 0,
+                nbits: 0,
+            };
+            jpeg.header(0xC0, width, height, sampling);
+            if restart > 0 {
+                jpeg.segment(0xDD, &restart.to_be_bytes());
+            }
+            let mut sos = vec![sampling.len() as u8];
+            for i in 0..sampling.len() {
+                sos.extend_from_slice(&[i as u8 + 1, 0x00]);
+            }
+            sos.extend_from_slice(&[0, 63, 0]);
+            jpeg.segment(0xDA, &sos);
+
+            let max_h = sampling.iter().map(|s| usize::from(s.0)).max().unwrap();
+            let max_v = sampling.iter().map(|s| usize::from(s.1)).max().unwrap();
+            let mcus_w = usize::from(width).div_ceil(8 * max_h);
+            let mcus_h = usize::from(height).div_ceil(8 * max_v);
+            let mut preds = vec![0; sampling.len()];
+            for mcu in 0..mcus_w * mcus_h {
+                if restart > 0 && mcu > 0 && mcu % usize::from(restart) == 0 {
+                    let pad = (8 - jpeg.nbits) % 8;
+                    jpeg.put((1 << pad) - 1, pad);
+                    jpeg.out.extend_from_slice(&[
+                        0xFF,
+                        0xD0 + ((mcu / usize::from(restart) - 1) % 8) as u8,
+                    ]);
+                    preds.iter_mut().for_each(|p| *p = 0);
+                }
+                let (mx, my) = (mcu % mcus_w, mcu / mcus_w);
+                for (ci, &(h, v)) in sampling.iter().enumerate() {
+                    for by in 0..usize::from(v) {
+                        for bx in 0..usize::from(h) {
+                            let coef =
+                                block(ci, mx * usize::from(h) + bx, my * usize::from(v) + by);
+                            let (size, bits) = jpeg.coefficient(coef[0] - preds[ci]);
+                            preds[ci] = coef[0];
+                            jpeg.put(size, 4);
+                            jpeg.put(bits, size);
+                            let mut run = 0;
+                            for k in 1..64 {
+                                let value = coef[ZIGZAG[k]];
+                                if value == 0 {
+                                    run += 1;
+                                    continue;
+                                }
+                                while run > 15 {
+                                    jpeg.put(1, 8);
+                                    run -= 16;
+                                }
+                                let (size, bits) = jpeg.coefficient(value);
+                                let symbol = (run << 4) | size as u8;
+                                let index = AC_SYMBOLS.iter().position(|&s| s == symbol).unwrap();
+                                jpeg.put(index as u32, 8);
+                                jpeg.put(bits, size);
+                                run = 0;
+                            }
+                            if run > 0 {
+                                jpeg.put(0, 8);
+                            }
+                        }
+                    }
+                }
+            }
+            let pad = (8 - jpeg.nbits) % 8;
+            jpeg.put((1 << pad) - 1, pad);
+            jpeg.out.extend_from_slice(&[0xFF, 0xD9]);
+            jpeg.out
+        }
+
+        /// A progressive file of the same blocks as `encode` with no
+        /// restarts: the DC coefficients in a first scan without their
+        /// low bit and a refinement scan adding it, then an AC scan
+        pub(crate) fn encode_progressive(
+            width: u16,
+            height: u16,
+            sampling: &[(u8, u8)],
+            block: impl Fn(usize, usize, usize) -> [i32; 64],
+        ) -> Vec<u8> {
+            let mut jpeg = TestJpeg {
+                out: vec![0xFF, 0xD8],
+                acc: 0,
+                nbits: 0,
+            };
+            jpeg.header(0xC2, width, height, sampling);
+            let max_h = sampling.iter().map(|s| usize::from(s.0)).max().unwrap();
+            let max_v = sampling.iter().map(|s| usize::from(s.1)).max().unwrap();
+            let mcus_w = usize::from(width).div_ceil(8 * max_h);
+            let mcus_h = usize::from(height).div_ceil(8 * max_v);
+            for (ah, al) in [(0, 1), (1, 0)] {
+                let mut sos = vec![sampling.len() as u8];
+                for i in 0..sampling.len() {
+                    sos.extend_from_slice(&[i as u8 + 1, 0x00]);
+                }
+                sos.extend_from_slice(&[0, 0, ah << 4 | al]);
+                jpeg.segment(0xDA, &sos);
+                let mut preds = vec![0; sampling.len()];
+                for mcu in 0..mcus_w * mcus_h {
+                    let (mx, my) = (mcu % mcus_w, mcu / mcus_w);
+                    for (ci, &(h, v)) in sampling.iter().enumerate() {
+                        for by in 0..usize::from(v) {
+                            for bx in 0..usize::from(h) {
+                                let dc =
+                                    block(ci, mx * usize::from(h) + bx, my * usize::from(v) + by)
+                                        [0];
+                                if ah == 1 {
+                                    jpeg.put(dc as u32 & 1, 1);
+                                    continue;
+                                }
+                                let (size, bits) = jpeg.coefficient((dc >> 1) - preds[ci]);
+                                preds[ci] = dc >> 1;
+                                jpeg.put(size, 4);
+                                jpeg.put(bits, size);
+                            }
+                        }
+                    }
+                }
+                let pad = (8 - jpeg.nbits) % 8;
+                jpeg.put((1 << pad) - 1, pad);
+            }
+            // AC bands are never read at 1/8 size
+            jpeg.segment(0xDA, &[1, 1, 0x00, 1, 63, 0]);
+            jpeg.out
+                .extend_from_slice(&[0x12, 0xFF, 0x00, 0x34, 0xFF, 0xD0, 0x56]);
+            jpeg.out.extend_from_slice(&[0xFF, 0xD9]);
+            jpeg.out
+        }
+    }
+
+    /// A smooth gradient: DC ramps across blocks, one low AC term each
+    fn gradient(_ci: usize, bx: usize, by: usize) -> [i32; 64] {
+        let mut coef = [0; 64];
+        coef[0] = (bx as i32 * 40 + by as i32 * 24) - 400;
+        coef[1] = -30;
+        coef[8] = 12;
+        coef
+    }
+
+    #[test]
+    fn test_scaled_decode_sizes() {
+        let jpeg = TestJpeg::encode(37, 21, &[(1, 1)], 0, gradient);
+        for (l2, size) in [(0, (37, 21)), (1, (19, 11)), (2, (10, 6)), (3, (5, 3))] {
+            let image = decode_dct_scaled(&jpeg, l2).unwrap();
+            assert_eq!((image.width, image.height), size);
+            assert_eq!(image.samples.len(), (size.0 * size.1) as usize);
+        }
+    }
+
+    #[test]
+    fn test_eighth_scale_is_block_dc() {
+        let jpeg = TestJpeg::encode(32, 16, &[(1, 1)], 0, gradient);
+        let image = decode_dct_scaled(&jpeg, 3).unwrap();
+        let expected: Vec<u8> = (0..2)
+            .flat_map(|by| (0..4).map(move |bx| gradient(0, bx, by)[0] as f32 / 8.0 + 128.0))
+            .map(|v| v.round() as u8)
+            .collect();
+        assert_eq!(image.samples, expected);
+    }
+
+    #[test]
+    fn test_reduced_scales_track_full_decode() {
+        let jpeg = TestJpeg::encode(64, 32, &[(1, 1)], 0, gradient);
+        let full = decode_dct_scaled(&jpeg, 0).unwrap();
+        for l2 in 1..=2 {
+            let f = 1 << l2;
+            let half = decode_dct_scaled(&jpeg, l2).unwrap();
+            for y in 0..half.height as usize {
+                for x in 0..half.width as usize {
+                    let mut sum = 0u32;
+                    for dy in 0..f {
+                        for dx in 0..f {
+                            sum += u32::from(full.samples[(y * f + dy) * 64 + x * f + dx]);
+                        }
+                    }
+                    let average = (sum / (f * f) as u32) as i32;
+                    let sample = i32::from(half.samples[y * half.width as usize + x]);
+                    assert!((average - sample).abs() <= 3, "{l2}: {average} vs {sample}");
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn test_subsampled_color_with_restarts() {
+        // Flat blocks: white luma, neutral chroma
+        let flat = |ci: usize, _bx: usize, _by: usize| {
+            let mut coef = [0; 64];
+            coef[0] = if ci == 0 { 1016 } else { 0 };
+            coef
+        };
+        let jpeg = TestJpeg::encode(40, 24, &[(2, 2), (1, 1), (1, 1)], 2, flat);
+        for l2 in [0, 1, 3] {
+            let image = decode_dct_scaled(&jpeg, l2).unwrap();
+            assert_eq!(image.components, 3);
+            assert!(image.samples.iter().all(|&s| s == 255), "scale {l2}");
+        }
+    }
+
+    #[test]
+    fn test_region_matches_crop_of_whole_decode() {
+        let jpegs = [
+            TestJpeg::encode(37, 61, &[(1, 1)], 0, gradient),
+            // One restart interval per MCU row, so rows above are skipped
+            TestJpeg::encode(40, 64, &[(2, 2), (1, 1), (1, 1)], 3, gradient),
+        ];
+        for jpeg in jpegs {
+            for l2 in 0..=3 {
+                let whole = decode_dct_scaled(&jpeg, l2).unwrap();
+                let (w, n) = (whole.width as usize, usize::from(whole.components));
+                for region in [[9, 5, 30, 18], [0, 40, 40, 56], [16, 0, 17, 1]] {
+                    let part = decode_dct_scaled_region(&jpeg, l2, region).unwrap();
+                    let [x0, y0] = [region[0], region[1]].map(|v| (v >> l2) as usize);
+                    let (pw, ph) = (part.width as usize, part.height as usize);
+                    assert_eq!(pw, (region[2].div_ceil(1 << l2) as usize).min(w) - x0);
+                    for y in 0..ph {
+                        let at = ((y0 + y) * w + x0) * n;
+                        assert_eq!(
+                            part.samples[y * pw * n..(y + 1) * pw * n],
+                            whole.samples[at..at + pw * n],
+                            "scale {l2} region {region:?} row {y}"
+                        );
+                    }
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn test_coefficients_reconstruct_like_scaled_decode() {
+        let jpegs = [
+            TestJpeg::encode(37, 21, &[(1, 1)], 0, gradient),
+            TestJpeg::encode(40, 24, &[(2, 2), (1, 1), (1, 1)], 2, gradient),
+        ];
+        for jpeg in jpegs {
+            let coefficients = decode_dct_coefficients(&jpeg).unwrap();
+            let luma = &coefficients.components[0];
+            let first: Vec<i32> = luma.blocks[..64].iter().map(|&c| c.into()).collect();
+            assert_eq!(first, gradient(0, 0, 0));
+            for l2 in 0..=3 {
+                let direct = decode_dct_scaled(&jpeg, l2).unwrap();
+                let rebuilt = coefficients.reconstruct(l2).unwrap();
+                assert_eq!(
+                    (rebuilt.width, rebuilt.height),
+                    (direct.width, direct.height)
+                );
+                assert_eq!(rebuilt.samples, direct.samples, "scale {l2}");
+            }
+        }
+    }
+
+    #[test]
+    fn test_progressive_eighth_scale_from_dc_scans() {
+        let jpegs = [
+            (
+                TestJpeg::encode(37, 21, &[(1, 1)], 0, gradient),
+                TestJpeg::encode_progressive(37, 21, &[(1, 1)], gradient),
+            ),
+            (
+                TestJpeg::encode(40, 24, &[(2, 2), (1, 1), (1, 1)], 0, gradient),
+                TestJpeg::encode_progressive(40, 24, &[(2, 2), (1, 1), (1, 1)], gradient),
+            ),
+        ];
+        for (baseline, progressive) in jpegs {
+            let expected = decode_dct_scaled(&baseline, 3).unwrap();
+            let decoded = decode_dct_scaled(&progressive, 3).unwrap();
+            assert_eq!(
+                (decoded.width, decoded.height),
+                (expected.width, expected.height)
+            );
+            assert_eq!(decoded.samples, expected.samples);
+            assert!(decode_dct_scaled(&progressive, 2).is_err());
+        }
+    }
+
+    #[test]
+    fn test_rejects_progressive() {
+        let mut jpeg = TestJpeg::encode(8, 8, &[(1, 1)], 0, gradient);
+        let sof = jpeg.windows(2).position(|w| w == [0xFF, 0xC0]).unwrap();
+        jpeg[sof + 1] = 0xC2;
+        assert!(decode_dct_scaled(&jpeg, 1).is_err());
+        assert!(decode_dct_scaled(&[1, 2, 3], 1).is_err());
+    }
+}
@@ -1,28 +1,368 @@
 //! FlateDecode (zlib/deflate) Filter Implementation
+//!
+//! The inflate/deflate implementation is picked at build time through
+//! flate2: the pure Rust miniz_oxide by default, or the SIMD-optimized
+//! zlib-ng / zlib-rs with the `zlib-ng` / `zlib-rs` features.
+//!
+//! Filters that commonly come before or after Flate are fused with it
+//! rather than run as stages each writing a whole buffer: the decoder in
+//! front (AES decryption, ASCII85) hands `inflate_from` its output a piece
+//! at a time, and a predictor after it is undone on each row as the row
+//! comes out of the inflater, in the same buffer.
 
 use super::params::FlateDecodeParams;
-use super::predictor::apply_predictor_decode;
+use super::predictor::{predictor_geometry, unfilter_png_row, untiff_row};
+use crate::fitz::counters::{self, Counter};
 use crate::fitz::error::{Error, Result};
-use flate2::Compression;
-use flate2::read::{ZlibDecoder, ZlibEncoder};
-use std::io::Read;
+use flate2::{Compress, Compression, Decompress, FlushCompress, FlushDecompress, Status};
+use std::ops::Range;
+
+/// Smallest output buffer an inflate starts with when the size isn't known
+const MIN_INFLATE_CAPACITY: usize = 4096;
+
+/// Name of the inflate/deflate implementation this build uses
+pub const fn flate_backend() -> &'static str {
+    if cfg!(feature = "zlib-ng") {
+        "zlib-ng"
+    } else if cfg!(feature = "zlib-rs") {
+        "zlib-rs"
+    } else {
+        "miniz_oxide"
+    }
+}
+
+/// Inflate zlib data (or raw deflate with `zlib_header` false)
+///
+/// `size_hint` is the expected decompressed size; when it is right the
+/// whole stream is inflated in one call into a single allocation. Data
+/// after a truncated stream is dropped, keeping what was decoded.
+pub fn inflate(data: &[u8], zlib_header: bool, size_hint: usize) -> Result<Vec<u8>> {
+    if size_hint > 0 {
+        // One spare byte lets the end of the stream be seen without growing
+        let mut out = Vec::with_capacity(size_hint.saturating_add(1));
+        let mut inflater = Decompress::new(zlib_header);
+        let status = inflater.decompress_vec(data, &mut out, FlushDecompress::Finish);
+        if let Ok(Status::StreamEnd) = status {
+            counters::add(Counter::BytesInflated, out.len() as u64);
+            return Ok(out);
+        }
+        // Wrong hint or damaged data: start over incrementally
+    }
+
+    let mut out = Vec::with_capacity(data.len().saturating_mul(4).max(MIN_INFLATE_CAPACITY));
+    let mut inflater = Decompress::new(zlib_header);
+
+    loop {
+        if out.len() == out.capacity() {
+            out.reserve(out.capacity().max(MIN_INFLATE_CAPACITY));
+        }
+        let consumed = inflater.total_in() as usize;
+        let produced = out.len();
+        let status = inflater
+            .decompress_vec(&data[consumed..], &mut out, FlushDecompress::None)
+            .map_err(|e| Error::Generic(format!("FlateDecode failed: {}", e)))?;
+        if status == Status::StreamEnd {
+            break;
+        }
+        let stalled = inflater.total_in() as usize == consumed && out.len() == produced;
+        if stalled && out.len() < out.capacity() {
+            break;
+        }
+    }
+    counters::add(Counter::BytesInflated, out.len() as u64);
+    Ok(out)
+}
+
+/// Inflate zlib data straight into `out` in one call
+///
+/// Returns how many bytes were written; output that doesn't fit is
+/// dropped.
+pub fn inflate_into(data: &[u8], out: &mut [u8]) -> Result<usize> {
+    let mut inflater = Decompress::new(true);
+    inflater
+        .decompress(data, out, FlushDecompress::Finish)
+        .map_err(|e| Error::Generic(format!("FlateDecode failed: {}", e)))?;
+    counters::add(Counter::BytesInflated, inflater.total_out());
+    Ok(inflater.total_out() as usize)
+}
 
 /// Decode FlateDecode (zlib/deflate) compressed data
 pub fn decode_flate(data: &[u8], params: Option<&FlateDecodeParams>) -> Result<Vec<u8>> {
-    let mut decoder = ZlibDecoder::new(data);
-    let mut decompressed = Vec::new();
-    decoder
-        .read_to_end(&mut decompressed)
-        .map_err(|e| Error::Generic(format!("FlateDecode failed: {}", e)))?;
+    decode_flate_sized(data, params, 0)
+}
+
+/// Decode FlateDecode data whose decoded length is known (like a stream's
+/// `/DL`), inflating it in one pass into an exactly sized buffer
+///
+/// A `decoded_len` of 0 means unknown.
+pub fn decode_flate_sized(
+    data: &[u8],
+    params: Option<&FlateDecodeParams>,
+    decoded_len: usize,
+) -> Result<Vec<u8>> {
+    match params.filter(|p| p.predictor > 1) {
+        Some(params) => inflate_from(&mut Whole(Some(data)), true, decoded_len, Some(params)),
+        None => inflate(data, true, decoded_len),
+    }
+}
+
+/// Compressed data a decoder fused in front of inflate produces, handed
+/// to `inflate_from` a piece at a time
+pub(super) trait InflateInput {
+    /// Compressed bytes still to come, or an estimate of them
+    fn size_hint(&self) -> usize;
+
+    /// The next piece of compressed data, or `None` after the last
+    fn next_piece(&mut self) -> Result<Option<&[u8]>>;
+}
+
+/// Compressed data that is already one slice
+struct Whole<'a>(Option<&'a [u8]>);
+
+impl InflateInput for Whole<'_> {
+    fn size_hint(&self) -> usize {
+        self.0.map_or(0, <[u8]>::len)
+    }
+
+    fn next_piece(&mut self) -> Result<Option<&[u8]>> {
+        Ok(self.0.take())
+    }
+}
+
+/// Undoes a predictor on inflated data in place, a row at a time as the
+/// rows come out of the inflater
+///
+/// The buffer holds the decoded rows followed by inflated data not yet
+/// decoded. PNG rows lose their filter type byte as they are decoded, so
+/// each decoded row lands at or before its own encoded bytes.
+struct RowPredictor {
+    png: bool,
+    bytes_per_pixel: usize,
+    row_bytes: usize,
+    /// Rows decoded so far
+    rows: usize,
+    /// The row above the first
+    zeros: Vec<u8>,
+}
+
+impl RowPredictor {
+    /// `None` without a predictor
+    fn new(params: Option<&FlateDecodeParams>) -> Result<Option<Self>> {
+        let Some(params) = params.filter(|p| p.predictor > 1) else {
+            return Ok(None);
+        };
+        let png = match params.predictor {
+            2 => false,
+            10..=15 => true,
+            predictor => {
+                return Err(Error::Generic(format!(
+                    "Unsupported predictor: {}",
+                    predictor
+                )));
+            }
+        };
+        let (bytes_per_pixel, row_bytes) = predictor_geometry(params);
+        Ok(Some(Self {
+            png,
+            bytes_per_pixel,
+            row_bytes,
+            rows: 0,
+            zeros: if png { vec![0; row_bytes] } else { Vec::new() },
+        }))
+    }
+
+    /// Length of one row as inflated
+    fn encoded_row(&self) -> usize {
+        self.row_bytes + usize::from(self.png)
+    }
+
+    /// Inflated length of `decoded_len` bytes of rows
+    fn encoded_len(&self, decoded_len: usize) -> usize {
+        decoded_len.div_ceil(self.row_bytes) * self.encoded_row()
+    }
+
+    /// Decode the next row, which must be all in `out`
+    fn decode_row(&mut self, out: &mut [u8]) -> Result<()> {
+        let (src, dst) = (self.rows * self.encoded_row(), self.rows * self.row_bytes);
+        if self.png {
+            let filter_type = out[src];
+            out.copy_within(src + 1..src + 1 + self.row_bytes, dst);
+            let (done, rest) = out.split_at_mut(dst);
+            let prev = if self.rows == 0 {
+                &self.zeros
+            } else {
+                &done[dst - self.row_bytes..]
+            };
+            unfilter_png_row(
+                filter_type,
+                &mut rest[..self.row_bytes],
+                prev,
+                self.bytes_per_pixel,
+            )?;
+        } else {
+            untiff_row(&mut out[dst..dst + self.row_bytes], self.bytes_per_pixel);
+        }
+        self.rows += 1;
+        Ok(())
+    }
+
+    /// Decode every complete row inflated into `out` so far
+    fn advance(&mut self, out: &mut [u8]) -> Result<()> {
+        while out.len() - self.rows * self.encoded_row() >= self.encoded_row() {
+            self.decode_row(out)?;
+        }
+        Ok(())
+    }
+
+    /// Decode what is left of an incomplete last row, as
+    /// `apply_predictor_decode` does, and drop the encoded bytes
+    fn finish(mut self, out: &mut Vec<u8>) -> Result<()> {
+        let read = self.rows * self.encoded_row();
+        if out.len() > read {
+            if self.png {
+                // Padded with zeros
+                out.resize(read + self.encoded_row(), 0);
+                self.decode_row(out)?;
+            } else {
+                untiff_row(&mut out[read..], self.bytes_per_pixel);
+                return Ok(());
+            }
+        }
+        out.truncate(self.rows * self.row_bytes);
+        Ok(())
+    }
+}
 
-    // Apply predictor if specified
-    if let Some(params) = params {
-        if params.predictor > 1 {
-            decompressed = apply_predictor_decode(&decompressed, params)?;
+/// Inflate zlib data (or raw deflate with `zlib_header` false) from
+/// `input`, undoing the predictor `params` gives as the rows come out
+///
+/// `size_hint` is the expected decoded size, as for `inflate`. A stream
+/// that ends early keeps what was inflated.
+pub(super) fn inflate_from(
+    input: &mut impl InflateInput,
+    zlib_header: bool,
+    size_hint: usize,
+    params: Option<&FlateDecodeParams>,
+) -> Result<Vec<u8>> {
+    let mut rows = RowPredictor::new(params)?;
+    let capacity = if size_hint > 0 {
+        let inflated = rows
+            .as_ref()
+            .map_or(size_hint, |r| r.encoded_len(size_hint));
+        inflated.saturating_add(1)
+    } else {
+        input
+            .size_hint()
+            .saturating_mul(4)
+            .max(MIN_INFLATE_CAPACITY)
+    };
+    let mut out = Vec::with_capacity(capacity);
+    let mut inflater = Decompress::new(zlib_header);
+    let mut piece: &[u8] = &[];
+    let mut ended = false;
+
+    loop {
+        if piece.is_empty() && !ended {
+            piece = match input.next_piece()? {
+                Some(next) => next,
+                None => {
+                    ended = true;
+                    &[]
+                }
+            };
+            continue;
+        }
+        if out.len() == out.capacity() {
+            out.reserve(out.capacity().max(MIN_INFLATE_CAPACITY));
+        }
+        let (consumed, produced) = (inflater.total_in(), out.len());
+        let status = inflater
+            .decompress_vec(piece, &mut out, FlushDecompress::None)
+            .map_err(|e| Error::Generic(format!("FlateDecode failed: {}", e)))?;
+        piece = &piece[(inflater.total_in() - consumed) as usize..];
+        if let Some(rows) = &mut rows {
+            rows.advance(&mut out)?;
+        }
+        if status == Status::StreamEnd {
+            break;
+        }
+        // Stuck with room to spare: damaged, or out of input
+        let stalled = inflater.total_in() == consumed && out.len() == produced;
+        if stalled && out.len() < out.capacity() && (ended || !piece.is_empty()) {
+            break;
         }
     }
+    counters::add(Counter::BytesInflated, inflater.total_out());
+    if let Some(rows) = rows {
+        rows.finish(&mut out)?;
+    }
+    Ok(out)
+}
+
+/// Decode `rows` of FlateDecode image data whose decoded rows are
+/// `row_bytes` long
+///
+/// The stream is inflated one row at a time and stops after the last row
+/// asked for. Rows before the range are only un-predicted (PNG predictors
+/// need the row above) and never stored. A truncated stream gives fewer
+/// rows.
+pub fn decode_flate_rows(
+    data: &[u8],
+    params: Option<&FlateDecodeParams>,
+    row_bytes: usize,
+    rows: Range<usize>,
+) -> Result<Vec<u8>> {
+    let predictor = params.map_or(1, |p| p.predictor);
+    let bytes_per_pixel = params.map_or(1, |p| predictor_geometry(p).0);
+    // PNG rows carry a leading filter type byte
+    let png = predictor >= 10;
+    let encoded = row_bytes + usize::from(png);
+    let mut inflater = Decompress::new(true);
+    let mut raw = vec![0u8; encoded];
+    let mut prev = vec![0u8; row_bytes];
+    let mut out = Vec::with_capacity(rows.len() * row_bytes);
 
-    Ok(decompressed)
+    for y in 0..rows.end {
+        let mut filled = 0;
+        while filled < encoded {
+            let (consumed, produced) = (inflater.total_in(), inflater.total_out());
+            let status = inflater
+                .decompress(
+                    &data[consumed as usize..],
+                    &mut raw[filled..],
+                    FlushDecompress::None,
+                )
+                .map_err(|e| Error::Generic(format!("FlateDecode failed: {}", e)))?;
+            filled += (inflater.total_out() - produced) as usize;
+            let stalled = inflater.total_in() == consumed && inflater.total_out() == produced;
+            if status == Status::StreamEnd || stalled {
+                break;
+            }
+        }
+        if filled < encoded {
+            break;
+        }
+
+        let wanted = y >= rows.start;
+        match predictor {
+            2 if wanted => {
+                untiff_row(&mut raw, bytes_per_pixel);
+                out.extend_from_slice(&raw);
+            }
+            10..=15 => {
+                unfilter_png_row(raw[0], &mut raw[1..], &prev, bytes_per_pixel)?;
+                prev.copy_from_slice(&raw[1..]);
+                if wanted {
+                    out.extend_from_slice(&prev);
+                }
+            }
+            2 => {}
+            _ if wanted => out.extend_from_slice(&raw),
+            _ => {}
+        }
+    }
+    counters::add(Counter::BytesInflated, inflater.total_out());
+    Ok(out)
 }
 
 /// Encode data with FlateDecode (zlib/deflate)
@@ -34,11 +374,20 @@ pub fn encode_flate(data: &[u8], level: u32) -> Result<Vec<u8>> {
         _ => Compression::best(),
     };
 
-    let mut encoder = ZlibEncoder::new(data, compression);
-    let mut compressed = Vec::new();
-    encoder
-        .read_to_end(&mut compressed)
-        .map_err(|e| Error::Generic(format!("FlateDecode encode failed: {}", e)))?;
+    // Deflate in one call into a buffer of zlib's worst-case bound
+    let bound = data.len() + (data.len() >> 12) + (data.len() >> 14) + (data.len() >> 25) + 13;
+    let mut deflater = Compress::new(compression, true);
+    let mut compressed = Vec::with_capacity(bound);
+    loop {
+        let consumed = deflater.total_in() as usize;
+        let status = deflater
+            .compress_vec(&data[consumed..], &mut compressed, FlushCompress::Finish)
+            .map_err(|e| Error::Generic(format!("FlateDecode encode failed: {}", e)))?;
+        if status == Status::StreamEnd {
+            break;
+        }
+        compressed.reserve(MIN_INFLATE_CAPACITY);
+    }
 
     Ok(compressed)
 }
@@ -47,6 +396,123 @@ pub fn encode_flate(data: &[u8], level: u32) -> Result<Vec<u8>> {
 mod tests {
     use super::*;
 
+    fn sample_text() -> Vec<u8> {
+        (0..2000)
+            .flat_map(|i| format!("{i} 0 0 1 {} {} cm\n", i % 7, i % 13).into_bytes())
+            .collect()
+    }
+
+    #[test]
+    fn test_flate_rows_through_png_predictor() {
+        let (row_bytes, height) = (12, 8);
+        let image: Vec<u8> = (0..row_bytes * height)
+            .map(|i| (i * 7 % 251) as u8)
+            .collect();
+        // Every row Up-filtered, so each depends on the one above
+        let mut encoded = Vec::new();
+        for y in 0..height {
+            encoded.push(2);
+            for x in 0..row_bytes {
+                let above = if y > 0 {
+                    image[(y - 1) * row_bytes + x]
+                } else {
+                    0
+                };
+                encoded.push(image[y * row_bytes + x].wrapping_sub(above));
+            }
+        }
+        let compressed = encode_flate(&encoded, 6).unwrap();
+        let params = FlateDecodeParams {
+            predictor: 12,
+            colors: 3,
+            bits_per_component: 8,
+            columns: 4,
+        };
+        let rows = decode_flate_rows(&compressed, Some(&params), row_bytes, 3..6).unwrap();
+        assert_eq!(rows, image[3 * row_bytes..6 * row_bytes]);
+        // Past the end of the stream
+        let rows = decode_flate_rows(&compressed, Some(&params), row_bytes, 6..20).unwrap();
+        assert_eq!(rows, image[6 * row_bytes..]);
+    }
+
+    #[test]
+    fn test_flate_predictor_fused_matches_two_steps() {
+        use super::super::predictor::apply_predictor_decode;
+
+        // Rows cycling through every PNG filter type, then TIFF rows
+        let (row_bytes, height) = (30, 500);
+        let mut png = Vec::new();
+        for y in 0..height {
+            png.push((y % 5) as u8);
+            png.extend((0..row_bytes).map(|x| (x * 31 + y * 17) as u8));
+        }
+        let tiff: Vec<u8> = (0..row_bytes * height).map(|i| (i % 7) as u8).collect();
+
+        for (predictor, encoded) in [(12, &png), (2, &tiff)] {
+            let params = FlateDecodeParams {
+                predictor,
+                colors: 3,
+                bits_per_component: 8,
+                columns: 10,
+            };
+            let compressed = encode_flate(encoded, 6).unwrap();
+            let expected = apply_predictor_decode(encoded, &params).unwrap();
+            for hint in [0, expected.len()] {
+                let fused = decode_flate_sized(&compressed, Some(&params), hint).unwrap();
+                assert_eq!(fused, expected);
+            }
+
+            // An incomplete last row decodes as the two steps do
+            let cut = encode_flate(&encoded[..encoded.len() - 7], 6).unwrap();
+            let expected = apply_predictor_decode(&encoded[..encoded.len() - 7], &params).unwrap();
+            assert_eq!(decode_flate(&cut, Some(&params)).unwrap(), expected);
+        }
+
+        let bad = FlateDecodeParams {
+            predictor: 5,
+            ..Default::default()
+        };
+        assert!(decode_flate(&encode_flate(&png, 6).unwrap(), Some(&bad)).is_err());
+    }
+
+    #[test]
+    fn test_flate_sized_decode() {
+        let original = sample_text();
+        let compressed = encode_flate(&original, 6).unwrap();
+
+        // Exact, short and long hints all decode the same
+        for hint in [original.len(), 10, original.len() * 3] {
+            let decoded = decode_flate_sized(&compressed, None, hint).unwrap();
+            assert_eq!(decoded, original);
+        }
+        let exact = decode_flate_sized(&compressed, None, original.len()).unwrap();
+        assert_eq!(exact.capacity(), original.len() + 1);
+    }
+
+    #[test]
+    fn test_flate_truncated_keeps_prefix() {
+        let original = sample_text();
+        let compressed = encode_flate(&original, 6).unwrap();
+        let decoded = decode_flate(&compressed[..compressed.len() / 2], None).unwrap();
+        assert!(!decoded.is_empty());
+        assert!(original.starts_with(&decoded));
+        assert!(decode_flate(b"not zlib at all", None).is_err());
+    }
+
+    #[test]
+    fn test_flate_inflate_into() {
+        let original = sample_text();
+        let compressed = encode_flate(&original, 9).unwrap();
+        let mut out = vec![0u8; original.len()];
+        assert_eq!(inflate_into(&compressed, &mut out).unwrap(), original.len());
+        assert_eq!(out, original);
+
+        let mut short = vec![0u8; 100];
+        assert_eq!(inflate_into(&compressed, &mut short).unwrap(), 100);
+        assert_eq!(short, original[..100]);
+        assert!(!flate_backend().is_empty());
+    }
+
     #[test]
     fn test_flate_encode_decode() {
         // Use longer text with repetition for better compression
@@ -47,14 +47,114 @@ pub fn decode_jpx(_data: &[u8]) -> Result<Vec<u8>> {
     ))
 }
 
+/// A JPEG 2000 image decoded at reduced resolution
+#[derive(Debug)]
+pub struct JpxImage {
+    pub width: u32,
+    pub height: u32,
+    /// Components per pixel
+    pub components: u8,
+    /// Interleaved 8-bit samples
+    pub samples: Vec<u8>,
+}
+
+/// Decode JPEG 2000 `data` with its `reduce` highest resolution levels
+/// discarded, at 1/2^`reduce` size rounded up
+///
+/// Only the code blocks of the remaining levels are decoded and the
+/// inverse wavelet transform stops at their resolution, so a thumbnail
+/// costs a fraction of the full decode. Fails if the codestream has
+/// fewer than `reduce` levels.
+#[cfg(feature = "jpeg2000")]
+pub fn decode_jpx_reduced(data: &[u8], reduce: u32) -> Result<JpxImage> {
+    use jpeg2k::{DecodeParameters, Image};
+
+    let image = Image::from_bytes_with(data, DecodeParameters::new().reduce(reduce))
+        .map_err(|e| Error::Generic(format!("JPXDecode failed: {:?}", e)))?;
+    let components = image.components();
+    let first = components
+        .first()
+        .ok_or_else(|| Error::Generic("JPXDecode failed: no components".into()))?;
+    // The reference grid keeps its full size; components are reduced
+    let (width, height) = (first.width() as usize, first.height() as usize);
+    let mut samples = Vec::with_capacity(width * height * components.len());
+    for y in 0..height {
+        for x in 0..width {
+            for comp in components {
+                let value = comp.data().get(y * comp.width() as usize + x).copied();
+                samples.push(value.unwrap_or(0).clamp(0, 255) as u8);
+            }
+        }
+    }
+    Ok(JpxImage {
+        width: width as u32,
+        height: height as u32,
+        components: components.len() as u8,
+        samples,
+    })
+}
+
+#[cfg(not(feature = "jpeg2000"))]
+pub fn decode_jpx_reduced(_data: &[u8], _reduce: u32) -> Result<JpxImage> {
+    Err(Error::Generic(
+        "JPEG 2000 support not enabled. Enable 'jpeg2000' feature.".into(),
+    ))
+}
+
 #[cfg(test)]
-mod tests {
+pub(crate) mod tests {
+    use super::*;
+
+    /// An 8x4 8-bit gray codestream with two reversible wavelet levels
+    /// whose packets are all empty, so every sample decodes to mid-gray
+    pub(crate) const GRAY_8X4: &[u8] = &[
+        0xFF, 0x4F, // SOC
+        0xFF, 0x51, 0x00, 0x29, 0x00, 0x00, // SIZ
+        0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x04, // image size
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // image offset
+        0x00, 0x00, 0x00, 0x08, 0x00, 0x00, 0x00, 0x04, // one tile
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, // tile offset
+        0x00, 0x01, 0x07, 0x01, 0x01, // one unsigned 8-bit component
+        0xFF, 0x52, 0x00, 0x0C, 0x00, // COD
+        0x00, 0x00, 0x01, 0x00, // LRCP, one layer, no colour transform
+        0x02, 0x04, 0x04, 0x00, 0x01, // two levels, 64x64 blocks, 5/3
+        0xFF, 0x5C, 0x00, 0x0A, 0x40, // QCD: no quantization
+        0x40, 0x48, 0x48, 0x50, 0x48, 0x48, 0x50, // subband exponents
+        0xFF, 0x90, 0x00, 0x0A, 0x00, 0x00, // SOT
+        0x00, 0x00, 0x00, 0x11, 0x00, 0x01, // 17 bytes, one tile-part
+        0xFF, 0x93, // SOD
+        0x00, 0x00, 0x00, // an empty packet per resolution
+        0xFF, 0xD9, // EOC
+    ];
+
     #[test]
     #[cfg(not(feature = "jpeg2000"))]
     fn test_jpx_disabled() {
-        use super::*;
         let data = &[0u8; 100];
         let result = decode_jpx(data);
         assert!(result.is_err());
+        assert!(decode_jpx_reduced(GRAY_8X4, 1).is_err());
+    }
+
+    #[test]
+    #[cfg(feature = "jpeg2000")]
+    fn test_decode_jpx() {
+        assert_eq!(decode_jpx(GRAY_8X4).unwrap(), vec![128; 32]);
+    }
+
+    #[test]
+    #[cfg(feature = "jpeg2000")]
+    fn test_decode_jpx_reduced() {
+        let full = decode_jpx_reduced(GRAY_8X4, 0).unwrap();
+        assert_eq!((full.width, full.height, full.components), (8, 4, 1));
+        assert_eq!(full.samples, vec![128; 32]);
+
+        let half = decode_jpx_reduced(GRAY_8X4, 1).unwrap();
+        assert_eq!((half.width, half.height), (4, 2));
+        assert_eq!(half.samples, vec![128; 8]);
+        let quarter = decode_jpx_reduced(GRAY_8X4, 2).unwrap();
+        assert_eq!((quarter.width, quarter.height), (2, 1));
+        // Only two levels to drop
+        assert!(decode_jpx_reduced(GRAY_8X4, 3).is_err());
     }
 }
@@ -4,11 +4,14 @@
 //! Supports the complete set of PDF filters as defined in PDF 1.7 specification.
 
 // Module declarations
+pub mod aesd;
 pub mod ascii85;
 pub mod asciihex;
+pub mod brotli;
 pub mod ccitt;
 pub mod chain;
 pub mod dct;
+pub mod dct_scaled;
 pub mod flate;
 pub mod jbig2;
 pub mod jpx;
@@ -18,11 +21,14 @@ pub mod predictor;
 pub mod runlength;
 
 // Re-exports
+pub use aesd::*;
 pub use ascii85::*;
 pub use asciihex::*;
+pub use self::brotli::*;
 pub use ccitt::*;
 pub use chain::*;
 pub use dct::*;
+pub use dct_scaled::*;
 pub use flate::*;
 pub use jbig2::*;
 pub use jpx::*;
@@ -44,6 +50,8 @@ pub enum FilterType {
     ASCIIHexDecode,
     /// RunLengthDecode - Run-length encoding
     RunLengthDecode,
+    /// BrotliDecode - Brotli compression
+    BrotliDecode,
     /// CCITTFaxDecode - CCITT Group 3 and Group 4 fax encoding
     CCITTFaxDecode,
     /// DCTDecode - JPEG compression
@@ -65,6 +73,7 @@ impl FilterType {
             "ASCII85Decode" | "A85" => Some(FilterType::ASCII85Decode),
             "ASCIIHexDecode" | "AHx" => Some(FilterType::ASCIIHexDecode),
             "RunLengthDecode" | "RL" => Some(FilterType::RunLengthDecode),
+            "BrotliDecode" => Some(FilterType::BrotliDecode),
             "CCITTFaxDecode" | "CCF" => Some(FilterType::CCITTFaxDecode),
             "DCTDecode" | "DCT" => Some(FilterType::DCTDecode),
             "JPXDecode" => Some(FilterType::JPXDecode),
@@ -82,6 +91,7 @@ impl FilterType {
             FilterType::ASCII85Decode => "ASCII85Decode",
             FilterType::ASCIIHexDecode => "ASCIIHexDecode",
             FilterType::RunLengthDecode => "RunLengthDecode",
+            FilterType::BrotliDecode => "BrotliDecode",
             FilterType::CCITTFaxDecode => "CCITTFaxDecode",
             FilterType::DCTDecode => "DCTDecode",
             FilterType::JPXDecode => "JPXDecode",
@@ -28,10 +28,17 @@ pub struct LZWDecodeParams {
     pub early_change: i32,
 }
 
+/// Parameters for BrotliDecode filter
+#[derive(Debug, Clone, Default)]
+pub struct BrotliDecodeParams {
+    /// ID of the registered dictionary the stream was compressed against
+    pub dictionary: Option<u64>,
+}
+
 /// Parameters for CCITTFaxDecode filter
 #[derive(Debug, Clone)]
 pub struct CCITTFaxDecodeParams {
-    /// Encoding scheme: 0 = Group 3 1D, <0 = Group 3 2D, >0 = Group 4
+    /// Encoding scheme: <0 = Group 4, 0 = Group 3 1D, >0 = Group 3 mixed 1D/2D
     pub k: i32,
     /// If true, end-of-line bit patterns are required
     pub end_of_line: bool,
@@ -3,16 +3,21 @@
 use super::params::FlateDecodeParams;
 use crate::fitz::error::{Error, Result};
 
-/// Apply PNG/TIFF predictor for decoding
-pub fn apply_predictor_decode(data: &[u8], params: &FlateDecodeParams) -> Result<Vec<u8>> {
-    let predictor = params.predictor;
+/// Bytes per pixel and bytes per row of the data a predictor runs over
+pub fn predictor_geometry(params: &FlateDecodeParams) -> (usize, usize) {
     let colors = params.colors.max(1) as usize;
     let bits = params.bits_per_component.max(8) as usize;
     let columns = params.columns.max(1) as usize;
+    (
+        (colors * bits).div_ceil(8),
+        (colors * bits * columns).div_ceil(8),
+    )
+}
 
-    // Calculate bytes per pixel and bytes per row
-    let bytes_per_pixel = (colors * bits).div_ceil(8);
-    let bytes_per_row = (colors * bits * columns).div_ceil(8);
+/// Apply PNG/TIFF predictor for decoding
+pub fn apply_predictor_decode(data: &[u8], params: &FlateDecodeParams) -> Result<Vec<u8>> {
+    let predictor = params.predictor;
+    let (bytes_per_pixel, bytes_per_row) = predictor_geometry(params);
 
     match predictor {
         1 => Ok(data.to_vec()), // No predictor
@@ -31,20 +36,10 @@ pub fn apply_tiff_predictor_decode(
     bytes_per_row: usize,
     bytes_per_pixel: usize,
 ) -> Result<Vec<u8>> {
-    let mut result = Vec::with_capacity(data.len());
-
-    for row in data.chunks(bytes_per_row) {
-        let mut prev = vec![0u8; bytes_per_pixel];
-
-        for pixel in row.chunks(bytes_per_pixel) {
-            for (i, &byte) in pixel.iter().enumerate() {
-                let decoded = byte.wrapping_add(prev[i]);
-                result.push(decoded);
-                prev[i] = decoded;
-            }
-        }
+    let mut result = data.to_vec();
+    for row in result.chunks_mut(bytes_per_row) {
+        untiff_row(row, bytes_per_pixel);
     }
-
     Ok(result)
 }
 
@@ -60,37 +55,13 @@ pub fn apply_png_predictor_decode(
     let mut prev_row = vec![0u8; bytes_per_row];
 
     for row_data in data.chunks(row_size) {
-        if row_data.is_empty() {
-            continue;
-        }
-
-        let filter_type = row_data[0];
-        let row = &row_data[1..];
-
-        if row.len() < bytes_per_row {
-            // Incomplete row, pad with zeros
-            let mut padded = row.to_vec();
-            padded.resize(bytes_per_row, 0);
-            decode_png_filter(
-                filter_type,
-                &padded,
-                &prev_row,
-                bytes_per_pixel,
-                &mut result,
-            )?;
-        } else {
-            decode_png_filter(
-                filter_type,
-                &row[..bytes_per_row],
-                &prev_row,
-                bytes_per_pixel,
-                &mut result,
-            )?;
-        }
-
-        // Update previous row
-        let start = result.len().saturating_sub(bytes_per_row);
-        prev_row.copy_from_slice(&result[start..]);
+        let start = result.len();
+        // An incomplete row is padded with zeros
+        result.extend_from_slice(&row_data[1..]);
+        result.resize(start + bytes_per_row, 0);
+        let row = &mut result[start..];
+        unfilter_png_row(row_data[0], row, &prev_row, bytes_per_pixel)?;
+        prev_row.copy_from_slice(row);
     }
 
     Ok(result)
@@ -104,58 +75,64 @@ pub fn decode_png_filter(
     bytes_per_pixel: usize,
     output: &mut Vec<u8>,
 ) -> Result<()> {
+    // A short row above counts as zeros past its end
+    let padded;
+    let prev_row = if prev_row.len() >= row.len() {
+        prev_row
+    } else {
+        padded = [prev_row, &vec![0; row.len() - prev_row.len()]].concat();
+        &padded
+    };
+    let start = output.len();
+    output.extend_from_slice(row);
+    unfilter_png_row(filter_type, &mut output[start..], prev_row, bytes_per_pixel)
+        .inspect_err(|_| output.truncate(start))
+}
+
+/// Undo PNG filter `filter_type` on `row` in place, given the decoded row
+/// above it (`prev_row`, at least as long)
+///
+/// The filters work on whole slices: Up, the one PDF producers mostly
+/// write, is a lane-wise add the compiler vectorizes, and Sub, Average
+/// and Paeth only depend on the pixel to the left.
+pub fn unfilter_png_row(
+    filter_type: u8,
+    row: &mut [u8],
+    prev_row: &[u8],
+    bytes_per_pixel: usize,
+) -> Result<()> {
+    let prev_row = &prev_row[..row.len()];
+    let bpp = bytes_per_pixel.clamp(1, row.len().max(1));
     match filter_type {
-        0 => {
-            // None
-            output.extend_from_slice(row);
-        }
-        1 => {
-            // Sub
-            for (i, &byte) in row.iter().enumerate() {
-                let left = if i >= bytes_per_pixel {
-                    output[output.len() - bytes_per_pixel]
-                } else {
-                    0
-                };
-                output.push(byte.wrapping_add(left));
-            }
-        }
+        // None
+        0 => {}
+        // Sub
+        1 => untiff_row(row, bpp),
+        // Up
         2 => {
-            // Up
-            for (i, &byte) in row.iter().enumerate() {
-                let up = prev_row.get(i).copied().unwrap_or(0);
-                output.push(byte.wrapping_add(up));
+            for (byte, &up) in row.iter_mut().zip(prev_row) {
+                *byte = byte.wrapping_add(up);
             }
         }
+        // Average
         3 => {
-            // Average
-            for (i, &byte) in row.iter().enumerate() {
-                let left = if i >= bytes_per_pixel {
-                    output[output.len() - bytes_per_pixel] as u32
-                } else {
-                    0
-                };
-                let up = prev_row.get(i).copied().unwrap_or(0) as u32;
-                let avg = ((left + up) / 2) as u8;
-                output.push(byte.wrapping_add(avg));
+            for (byte, &up) in row.iter_mut().zip(prev_row).take(bpp) {
+                *byte = byte.wrapping_add(up / 2);
+            }
+            for i in bpp..row.len() {
+                let avg = (u16::from(row[i - bpp]) + u16::from(prev_row[i])) / 2;
+                row[i] = row[i].wrapping_add(avg as u8);
             }
         }
+        // Paeth
         4 => {
-            // Paeth
-            for (i, &byte) in row.iter().enumerate() {
-                let left = if i >= bytes_per_pixel {
-                    output[output.len() - bytes_per_pixel]
-                } else {
-                    0
-                };
-                let up = prev_row.get(i).copied().unwrap_or(0);
-                let up_left = if i >= bytes_per_pixel {
-                    prev_row.get(i - bytes_per_pixel).copied().unwrap_or(0)
-                } else {
-                    0
-                };
-                let paeth = paeth_predictor(left, up, up_left);
-                output.push(byte.wrapping_add(paeth));
+            // With nothing to the left, Paeth picks the byte above
+            for (byte, &up) in row.iter_mut().zip(prev_row).take(bpp) {
+                *byte = byte.wrapping_add(up);
+            }
+            for i in bpp..row.len() {
+                let paeth = paeth_predictor(row[i - bpp], prev_row[i], prev_row[i - bpp]);
+                row[i] = row[i].wrapping_add(paeth);
             }
         }
         _ => {
@@ -169,6 +146,14 @@ pub fn decode_png_filter(
     Ok(())
 }
 
+/// Undo TIFF horizontal differencing on one row in place
+pub fn untiff_row(row: &mut [u8], bytes_per_pixel: usize) {
+    let bpp = bytes_per_pixel.max(1);
+    for i in bpp..row.len() {
+        row[i] = row[i].wrapping_add(row[i - bpp]);
+    }
+}
+
 /// Paeth predictor function
 pub fn paeth_predictor(a: u8, b: u8, c: u8) -> u8 {
     let a = a as i32;
@@ -324,6 +309,34 @@ mod tests {
         assert_eq!(output.len(), 4);
     }
 
+    #[test]
+    fn test_unfilter_png_row_matches_decode() {
+        let prev: Vec<u8> = (0..48).map(|i| (i * 37 % 256) as u8).collect();
+        let row: Vec<u8> = (0..48).map(|i| (i * 101 % 256) as u8).collect();
+        for filter_type in 0..5 {
+            for bpp in [1, 3, 4, 64] {
+                let mut expected = Vec::new();
+                // Byte at a time, as the filters are specified
+                for (i, &byte) in row.iter().enumerate() {
+                    let left = if i >= bpp { expected[i - bpp] } else { 0 };
+                    let up_left = if i >= bpp { prev[i - bpp] } else { 0 };
+                    let predicted = match filter_type {
+                        0 => 0,
+                        1 => left,
+                        2 => prev[i],
+                        3 => ((u16::from(left) + u16::from(prev[i])) / 2) as u8,
+                        _ => paeth_predictor(left, prev[i], up_left),
+                    };
+                    expected.push(byte.wrapping_add(predicted));
+                }
+                let mut unfiltered = row.clone();
+                unfilter_png_row(filter_type, &mut unfiltered, &prev, bpp).unwrap();
+                assert_eq!(unfiltered, expected);
+            }
+        }
+        assert!(unfilter_png_row(5, &mut [0; 4], &[0; 4], 1).is_err());
+    }
+
     #[test]
     fn test_decode_png_filter_unknown() {
         let row = vec![1, 2, 3];
@@ -45,17 +45,15 @@ impl Name {
 
     /// Check if this is a standard interned name (cheap pointer comparison)
     pub fn is_interned(&self) -> bool {
-        COMMON_NAMES
-            .iter()
-            .any(|(_, arc)| Arc::ptr_eq(&self.0, arc))
+        common_name_slot(&self.0)
+            .and_then(|(_, slot)| slot.get())
+            .is_some_and(|arc| Arc::ptr_eq(&self.0, arc))
     }
 
     /// Try to get a pre-interned common name
     fn get_interned(s: &str) -> Option<Self> {
-        COMMON_NAMES
-            .iter()
-            .find(|(name, _)| *name == s)
-            .map(|(_, arc)| Self(Arc::clone(arc)))
+        let (name, slot) = common_name_slot(s)?;
+        Some(Self(Arc::clone(slot.get_or_init(|| Arc::from(name)))))
     }
 }
 
@@ -104,130 +102,125 @@ impl From<String> for Name {
 // Pre-interned Common PDF Names
 // ============================================================================
 
-use std::sync::LazyLock;
-
-/// Common PDF names pre-interned for fast comparison
-static COMMON_NAMES: LazyLock<Vec<(&'static str, Arc<str>)>> = LazyLock::new(|| {
-    vec![
-        // Document structure (most common)
-        ("Type", Arc::from("Type")),
-        ("Subtype", Arc::from("Subtype")),
-        ("Length", Arc::from("Length")),
-        ("Filter", Arc::from("Filter")),
-        ("Parent", Arc::from("Parent")),
-        ("Kids", Arc::from("Kids")),
-        ("Count", Arc::from("Count")),
-        // Page structure
-        ("Catalog", Arc::from("Catalog")),
-        ("Pages", Arc::from("Pages")),
-        ("Page", Arc::from("Page")),
-        ("Resources", Arc::from("Resources")),
-        ("Contents", Arc::from("Contents")),
-        ("MediaBox", Arc::from("MediaBox")),
-        ("CropBox", Arc::from("CropBox")),
-        ("Rotate", Arc::from("Rotate")),
-        // Resources
-        ("Font", Arc::from("Font")),
-        ("XObject", Arc::from("XObject")),
-        ("ExtGState", Arc::from("ExtGState")),
-        ("ColorSpace", Arc::from("ColorSpace")),
-        ("Pattern", Arc::from("Pattern")),
-        ("Shading", Arc::from("Shading")),
-        // XObjects
-        ("Image", Arc::from("Image")),
-        ("Form", Arc::from("Form")),
-        // Stream properties
-        ("DecodeParms", Arc::from("DecodeParms")),
-        // Filters
-        ("FlateDecode", Arc::from("FlateDecode")),
-        ("DCTDecode", Arc::from("DCTDecode")),
-        ("ASCII85Decode", Arc::from("ASCII85Decode")),
-        ("ASCIIHexDecode", Arc::from("ASCIIHexDecode")),
-        ("LZWDecode", Arc::from("LZWDecode")),
-        ("RunLengthDecode", Arc::from("RunLengthDecode")),
-        ("CCITTFaxDecode", Arc::from("CCITTFaxDecode")),
-        ("JBIG2Decode", Arc::from("JBIG2Decode")),
-        ("JPXDecode", Arc::from("JPXDecode")),
-        // Color spaces
-        ("DeviceGray", Arc::from("DeviceGray")),
-        ("DeviceRGB", Arc::from("DeviceRGB")),
-        ("DeviceCMYK", Arc::from("DeviceCMYK")),
-        ("ICCBased", Arc::from("ICCBased")),
-        ("Indexed", Arc::from("Indexed")),
-        ("Separation", Arc::from("Separation")),
-        ("DeviceN", Arc::from("DeviceN")),
-        // Fonts
-        ("BaseFont", Arc::from("BaseFont")),
-        ("Encoding", Arc::from("Encoding")),
-        ("Widths", Arc::from("Widths")),
-        ("FirstChar", Arc::from("FirstChar")),
-        ("LastChar", Arc::from("LastChar")),
-        ("ToUnicode", Arc::from("ToUnicode")),
-        ("FontDescriptor", Arc::from("FontDescriptor")),
-        ("DescendantFonts", Arc::from("DescendantFonts")),
-        ("Type0", Arc::from("Type0")),
-        ("Type1", Arc::from("Type1")),
-        ("TrueType", Arc::from("TrueType")),
-        ("CIDFontType0", Arc::from("CIDFontType0")),
-        ("CIDFontType2", Arc::from("CIDFontType2")),
-        // Image properties
-        ("Width", Arc::from("Width")),
-        ("Height", Arc::from("Height")),
-        ("BitsPerComponent", Arc::from("BitsPerComponent")),
-        ("SMask", Arc::from("SMask")),
-        ("Mask", Arc::from("Mask")),
-        ("Decode", Arc::from("Decode")),
-        ("Interpolate", Arc::from("Interpolate")),
-        // Metadata
-        ("Root", Arc::from("Root")),
-        ("Info", Arc::from("Info")),
-        ("Title", Arc::from("Title")),
-        ("Author", Arc::from("Author")),
-        ("Subject", Arc::from("Subject")),
-        ("Keywords", Arc::from("Keywords")),
-        ("Creator", Arc::from("Creator")),
-        ("Producer", Arc::from("Producer")),
-        ("CreationDate", Arc::from("CreationDate")),
-        ("ModDate", Arc::from("ModDate")),
-        // Annotations
-        ("Annot", Arc::from("Annot")),
-        ("Annots", Arc::from("Annots")),
-        ("Rect", Arc::from("Rect")),
-        ("AP", Arc::from("AP")),
-        ("N", Arc::from("N")),
-        ("R", Arc::from("R")),
-        ("D", Arc::from("D")),
-        // Actions
-        ("A", Arc::from("A")),
-        ("Action", Arc::from("Action")),
-        ("S", Arc::from("S")),
-        ("Dest", Arc::from("Dest")),
-        ("URI", Arc::from("URI")),
-        // Forms
-        ("AcroForm", Arc::from("AcroForm")),
-        ("Fields", Arc::from("Fields")),
-        ("T", Arc::from("T")),
-        ("V", Arc::from("V")),
-        ("FT", Arc::from("FT")),
-        // Encryption
-        ("Encrypt", Arc::from("Encrypt")),
-        // Outlines
-        ("Outlines", Arc::from("Outlines")),
-        ("First", Arc::from("First")),
-        ("Last", Arc::from("Last")),
-        ("Next", Arc::from("Next")),
-        ("Prev", Arc::from("Prev")),
-        // XRef
-        ("XRef", Arc::from("XRef")),
-        ("Size", Arc::from("Size")),
-        ("Index", Arc::from("Index")),
-        ("W", Arc::from("W")),
-        // Graphics state
-        ("CA", Arc::from("CA")),
-        ("ca", Arc::from("ca")),
-        ("BM", Arc::from("BM")),
-    ]
-});
+use std::sync::OnceLock;
+
+/// Common PDF names pre-interned for fast comparison, in byte order
+///
+/// The list is plain static data; a name's shared storage is only made the
+/// first time it is used, so nothing is allocated up front.
+const COMMON_NAMES: [&str; 100] = [
+    "A",
+    "AP",
+    "ASCII85Decode",
+    "ASCIIHexDecode",
+    "AcroForm",
+    "Action",
+    "Annot",
+    "Annots",
+    "Author",
+    "BM",
+    "BaseFont",
+    "BitsPerComponent",
+    "CA",
+    "CCITTFaxDecode",
+    "CIDFontType0",
+    "CIDFontType2",
+    "Catalog",
+    "ColorSpace",
+    "Contents",
+    "Count",
+    "CreationDate",
+    "Creator",
+    "CropBox",
+    "D",
+    "DCTDecode",
+    "Decode",
+    "DecodeParms",
+    "DescendantFonts",
+    "Dest",
+    "DeviceCMYK",
+    "DeviceGray",
+    "DeviceN",
+    "DeviceRGB",
+    "Encoding",
+    "Encrypt",
+    "ExtGState",
+    "FT",
+    "Fields",
+    "Filter",
+    "First",
+    "FirstChar",
+    "FlateDecode",
+    "Font",
+    "FontDescriptor",
+    "Form",
+    "Height",
+    "ICCBased",
+    "Image",
+    "Index",
+    "Indexed",
+    "Info",
+    "Interpolate",
+    "JBIG2Decode",
+    "JPXDecode",
+    "Keywords",
+    "Kids",
+    "LZWDecode",
+    "Last",
+    "LastChar",
+    "Length",
+    "Mask",
+    "MediaBox",
+    "ModDate",
+    "N",
+    "Next",
+    "Outlines",
+    "Page",
+    "Pages",
+    "Parent",
+    "Pattern",
+    "Prev",
+    "Producer",
+    "R",
+    "Rect",
+    "Resources",
+    "Root",
+    "Rotate",
+    "RunLengthDecode",
+    "S",
+    "SMask",
+    "Separation",
+    "Shading",
+    "Size",
+    "Subject",
+    "Subtype",
+    "T",
+    "Title",
+    "ToUnicode",
+    "TrueType",
+    "Type",
+    "Type0",
+    "Type1",
+    "URI",
+    "V",
+    "W",
+    "Width",
+    "Widths",
+    "XObject",
+    "XRef",
+    "ca",
+];
+
+/// Shared storage of each of `COMMON_NAMES`, made on first use
+static COMMON_NAME_ARCS: [OnceLock<Arc<str>>; COMMON_NAMES.len()] =
+    [const { OnceLock::new() }; COMMON_NAMES.len()];
+
+/// Storage slot of a common name
+#[inline]
+fn common_name_slot(s: &str) -> Option<(&'static str, &'static OnceLock<Arc<str>>)> {
+    let i = COMMON_NAMES.binary_search(&s).ok()?;
+    Some((COMMON_NAMES[i], &COMMON_NAME_ARCS[i]))
+}
 
 #[derive(Debug, Clone)]
 pub struct PdfString(Vec<u8>);
@@ -352,6 +345,15 @@ mod tests {
         assert!(Arc::ptr_eq(&n1.arc(), &n2.arc()));
     }
 
+    #[test]
+    fn test_common_names_sorted() {
+        assert!(COMMON_NAMES.windows(2).all(|w| w[0] < w[1]));
+        for name in COMMON_NAMES {
+            assert_eq!(common_name_slot(name).unwrap().0, name);
+        }
+        assert!(common_name_slot("Typ").is_none());
+    }
+
     #[test]
     fn test_name_non_interned() {
         // Uncommon names should not be interned